@@ -0,0 +1,35 @@
+/* contrib/auto_explain/auto_explain--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION auto_explain" to load this file. \quit
+
+-- Register functions.
+CREATE FUNCTION auto_explain_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+CREATE FUNCTION auto_explain_plans(
+    OUT logged_at timestamptz,
+    OUT pid int4,
+    OUT dbid oid,
+    OUT userid oid,
+    OUT queryid bigint,
+    OUT nesting_level int4,
+    OUT duration float8,
+    OUT nested_statements int8,
+    OUT nested_time float8,
+    OUT plan text
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- Register a view on the function for ease of use.
+CREATE VIEW auto_explain_plans AS
+  SELECT * FROM auto_explain_plans();
+
+GRANT SELECT ON auto_explain_plans TO PUBLIC;
+
+-- Don't want this to be available to non-superusers.
+REVOKE ALL ON FUNCTION auto_explain_reset() FROM PUBLIC;
@@ -14,12 +14,58 @@
 
 #include <limits.h>
 
+#include "access/htup_details.h"
 #include "commands/explain.h"
 #include "executor/instrument.h"
+#include "funcapi.h"
+#include "mb/pg_wchar.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/timestamp.h"
 
 PG_MODULE_MAGIC;
 
+/* Where explained plans go */
+typedef enum
+{
+	AE_DEST_LOG,				/* the server log */
+	AE_DEST_BUFFER				/* the shared plan buffer */
+} AEDestination;
+
+/*
+ * A plan stored in the shared plan buffer.  The buffer is an array of
+ * auto_explain.buffer_plans of these, each followed by room for
+ * auto_explain.buffer_plan_size of plan text; longer plans are truncated.
+ */
+typedef struct aePlanEntry
+{
+	TimestampTz logged_at;		/* when the statement finished */
+	int			pid;
+	Oid			dbid;
+	Oid			userid;
+	uint32		queryid;		/* 0 if none was computed */
+	int			nesting_level;	/* 0 for top-level statements */
+	double		duration;		/* in msec */
+	int64		nested_count;	/* directly nested statements ... */
+	double		nested_time;	/* ... and their total duration in msec */
+	int			plan_len;		/* 0 if the slot was never used */
+	char		plan[FLEXIBLE_ARRAY_MEMBER];
+} aePlanEntry;
+
+/*
+ * Global shared state
+ */
+typedef struct aeSharedState
+{
+	LWLock	   *lock;			/* protects everything below */
+	int			next;			/* slot to be overwritten next */
+	char		entries[FLEXIBLE_ARRAY_MEMBER];
+} aeSharedState;
+
 /* GUC variables */
 static int	auto_explain_log_min_duration = -1; /* msec or -1 */
 static bool auto_explain_log_analyze = false;
@@ -29,6 +75,10 @@ static bool auto_explain_log_triggers = false;
 static bool auto_explain_log_timing = true;
 static int	auto_explain_log_format = EXPLAIN_FORMAT_TEXT;
 static bool auto_explain_log_nested_statements = false;
+static double auto_explain_sample_rate = 1;
+static int	auto_explain_log_destination = AE_DEST_LOG;
+static int	auto_explain_buffer_plans = 0;
+static int	auto_explain_buffer_plan_size = 8;	/* kB */
 
 static const struct config_enum_entry format_options[] = {
 	{"text", EXPLAIN_FORMAT_TEXT, false},
@@ -38,22 +88,68 @@ static const struct config_enum_entry format_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry destination_options[] = {
+	{"log", AE_DEST_LOG, false},
+	{"buffer", AE_DEST_BUFFER, false},
+	{NULL, 0, false}
+};
+
 /* Current nesting depth of ExecutorRun calls */
 static int	nesting_level = 0;
 
+/* Is the current top-level statement sampled? */
+static bool current_query_sampled = false;
+
+/*
+ * Number and total duration of the statements run directly below each
+ * nesting level, so that a statement's plan can tell how much of its time
+ * went to statements it invoked (from functions or triggers, say).  Levels
+ * deeper than AE_MAX_NESTING aren't tracked.
+ */
+#define AE_MAX_NESTING	32
+
+static int64 nested_count[AE_MAX_NESTING];
+static double nested_time[AE_MAX_NESTING];
+
+/* Links to shared memory state */
+static aeSharedState *aes = NULL;
+
 /* Saved hook values in case of unload */
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 static ExecutorStart_hook_type prev_ExecutorStart = NULL;
 static ExecutorRun_hook_type prev_ExecutorRun = NULL;
 static ExecutorFinish_hook_type prev_ExecutorFinish = NULL;
 static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
 
+/* Is the current statement timed, for itself or for its caller's sake? */
+#define auto_explain_tracking() \
+	(auto_explain_log_min_duration >= 0 && current_query_sampled)
+
+/* Will the current statement's plan be explained if it is slow enough? */
 #define auto_explain_enabled() \
-	(auto_explain_log_min_duration >= 0 && \
+	(auto_explain_tracking() && \
 	 (nesting_level == 0 || auto_explain_log_nested_statements))
 
+#define AE_ENTRY_SIZE \
+	MAXALIGN(offsetof(aePlanEntry, plan) + auto_explain_buffer_plan_size * 1024L)
+
+#define AE_ENTRY(i) \
+	((aePlanEntry *) (aes->entries + (i) * AE_ENTRY_SIZE))
+
 void		_PG_init(void);
 void		_PG_fini(void);
 
+Datum		auto_explain_reset(PG_FUNCTION_ARGS);
+Datum		auto_explain_plans(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(auto_explain_reset);
+PG_FUNCTION_INFO_V1(auto_explain_plans);
+
+static Size ae_memsize(void);
+static void ae_shmem_startup(void);
+static void ae_store_plan(QueryDesc *queryDesc, double msec,
+			  int64 ncount, double ntime, StringInfo plan);
+
 static void explain_ExecutorStart(QueryDesc *queryDesc, int eflags);
 static void explain_ExecutorRun(QueryDesc *queryDesc,
 					ScanDirection direction,
@@ -159,8 +255,72 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomRealVariable("auto_explain.sample_rate",
+							 "Fraction of queries to process.",
+							 NULL,
+							 &auto_explain_sample_rate,
+							 1.0,
+							 0.0,
+							 1.0,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomEnumVariable("auto_explain.log_destination",
+							 "Where to send plans: the server log, or the shared plan buffer.",
+							 NULL,
+							 &auto_explain_log_destination,
+							 AE_DEST_LOG,
+							 destination_options,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("auto_explain.buffer_plans",
+							"Sets the number of plans kept in the shared plan buffer.",
+							"Zero disables the buffer.  This only has an effect if "
+							"auto_explain is in shared_preload_libraries.",
+							&auto_explain_buffer_plans,
+							0,
+							0, INT_MAX / 1024,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("auto_explain.buffer_plan_size",
+							"Sets the space for each plan in the shared plan buffer.",
+							"Longer plans are truncated.",
+							&auto_explain_buffer_plan_size,
+							8,
+							1, 1024,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
 	EmitWarningsOnPlaceholders("auto_explain");
 
+	/*
+	 * Request the shared plan buffer.  (These are no-ops if we're not in the
+	 * postmaster process.)
+	 */
+	if (process_shared_preload_libraries_in_progress &&
+		auto_explain_buffer_plans > 0)
+	{
+		RequestAddinShmemSpace(ae_memsize());
+		RequestAddinLWLocks(1);
+
+		prev_shmem_startup_hook = shmem_startup_hook;
+		shmem_startup_hook = ae_shmem_startup;
+	}
+
 	/* Install hooks. */
 	prev_ExecutorStart = ExecutorStart_hook;
 	ExecutorStart_hook = explain_ExecutorStart;
@@ -179,18 +339,76 @@ void
 _PG_fini(void)
 {
 	/* Uninstall hooks. */
+	if (shmem_startup_hook == ae_shmem_startup)
+		shmem_startup_hook = prev_shmem_startup_hook;
 	ExecutorStart_hook = prev_ExecutorStart;
 	ExecutorRun_hook = prev_ExecutorRun;
 	ExecutorFinish_hook = prev_ExecutorFinish;
 	ExecutorEnd_hook = prev_ExecutorEnd;
 }
 
+/*
+ * Estimate shared memory space needed.
+ */
+static Size
+ae_memsize(void)
+{
+	return add_size(offsetof(aeSharedState, entries),
+					mul_size(auto_explain_buffer_plans, AE_ENTRY_SIZE));
+}
+
+/*
+ * shmem_startup hook: allocate or attach to the shared plan buffer
+ */
+static void
+ae_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	/* reset in case this is a restart within the postmaster */
+	aes = NULL;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	aes = ShmemInitStruct("auto_explain", ae_memsize(), &found);
+
+	if (!found)
+	{
+		/* First time through ... */
+		memset(aes, 0, ae_memsize());
+		aes->lock = LWLockAssign();
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
 /*
  * ExecutorStart hook: start up logging if needed
  */
 static void
 explain_ExecutorStart(QueryDesc *queryDesc, int eflags)
 {
+	/*
+	 * Decide whether to sample this statement once, at the top level; nested
+	 * statements follow that decision.  Statements that aren't sampled pay
+	 * for nothing but this.
+	 */
+	if (nesting_level == 0)
+		current_query_sampled = (auto_explain_log_min_duration >= 0 &&
+								 (auto_explain_sample_rate >= 1.0 ||
+								  random() < auto_explain_sample_rate *
+								  ((double) MAX_RANDOM_VALUE + 1)));
+
+	if (auto_explain_tracking() && nesting_level < AE_MAX_NESTING)
+	{
+		/* start counting the statements this one runs */
+		nested_count[nesting_level] = 0;
+		nested_time[nesting_level] = 0;
+	}
+
 	if (auto_explain_enabled())
 	{
 		/* Enable per-node instrumentation iff log_analyze is required. */
@@ -210,10 +428,12 @@ explain_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	else
 		standard_ExecutorStart(queryDesc, eflags);
 
-	if (auto_explain_enabled())
+	if (auto_explain_tracking())
 	{
 		/*
-		 * Set up to track total elapsed time in ExecutorRun.  Make sure the
+		 * Set up to track total elapsed time in ExecutorRun, which we need
+		 * even for nested statements that won't be explained themselves, to
+		 * charge their time to the statement that ran them.  Make sure the
 		 * space is allocated in the per-query context so it will go away at
 		 * ExecutorEnd.
 		 */
@@ -280,19 +500,33 @@ explain_ExecutorFinish(QueryDesc *queryDesc)
 static void
 explain_ExecutorEnd(QueryDesc *queryDesc)
 {
-	if (queryDesc->totaltime && auto_explain_enabled())
+	if (queryDesc->totaltime && auto_explain_tracking())
 	{
 		double		msec;
+		int64		ncount = 0;
+		double		ntime = 0;
 
 		/*
 		 * Make sure stats accumulation is done.  (Note: it's okay if several
 		 * levels of hook all do this.)
 		 */
 		InstrEndLoop(queryDesc->totaltime);
+		msec = queryDesc->totaltime->total * 1000.0;
+
+		/* Charge our time to the statement that ran us, if any */
+		if (nesting_level > 0 && nesting_level <= AE_MAX_NESTING)
+		{
+			nested_count[nesting_level - 1]++;
+			nested_time[nesting_level - 1] += msec;
+		}
+		if (nesting_level < AE_MAX_NESTING)
+		{
+			ncount = nested_count[nesting_level];
+			ntime = nested_time[nesting_level];
+		}
 
 		/* Log plan if duration is exceeded. */
-		msec = queryDesc->totaltime->total * 1000.0;
-		if (msec >= auto_explain_log_min_duration)
+		if (auto_explain_enabled() && msec >= auto_explain_log_min_duration)
 		{
 			ExplainState *es = NewExplainState();
 
@@ -308,6 +542,11 @@ explain_ExecutorEnd(QueryDesc *queryDesc)
 			ExplainPrintPlan(es, queryDesc);
 			if (es->analyze && auto_explain_log_triggers)
 				ExplainPrintTriggers(es, queryDesc);
+			if (ncount > 0)
+			{
+				ExplainPropertyLong("Nested Statements", (long) ncount, es);
+				ExplainPropertyFloat("Nested Statement Time", ntime, 3, es);
+			}
 			ExplainEndOutput(es);
 
 			/* Remove last line break */
@@ -327,10 +566,13 @@ explain_ExecutorEnd(QueryDesc *queryDesc)
 			 * reported.  This isn't ideal but trying to do it here would
 			 * often result in duplication.
 			 */
-			ereport(LOG,
-					(errmsg("duration: %.3f ms  plan:\n%s",
-							msec, es->str->data),
-					 errhidestmt(true)));
+			if (auto_explain_log_destination == AE_DEST_BUFFER && aes)
+				ae_store_plan(queryDesc, msec, ncount, ntime, es->str);
+			else
+				ereport(LOG,
+						(errmsg("duration: %.3f ms  plan:\n%s",
+								msec, es->str->data),
+						 errhidestmt(true)));
 
 			pfree(es->str->data);
 		}
@@ -341,3 +583,154 @@ explain_ExecutorEnd(QueryDesc *queryDesc)
 	else
 		standard_ExecutorEnd(queryDesc);
 }
+
+/*
+ * Store an explained plan in the shared plan buffer, overwriting the oldest
+ * one.
+ */
+static void
+ae_store_plan(QueryDesc *queryDesc, double msec, int64 ncount, double ntime,
+			  StringInfo plan)
+{
+	aePlanEntry *entry;
+	Size		maxlen = auto_explain_buffer_plan_size * 1024L - 1;
+	int			len = plan->len;
+
+	if (len > maxlen)
+		len = pg_mbcliplen(plan->data, len, maxlen);
+
+	LWLockAcquire(aes->lock, LW_EXCLUSIVE);
+
+	entry = AE_ENTRY(aes->next);
+	aes->next = (aes->next + 1) % auto_explain_buffer_plans;
+
+	entry->logged_at = GetCurrentTimestamp();
+	entry->pid = MyProcPid;
+	entry->dbid = MyDatabaseId;
+	entry->userid = GetUserId();
+	entry->queryid = queryDesc->plannedstmt->queryId;
+	entry->nesting_level = nesting_level;
+	entry->duration = msec;
+	entry->nested_count = ncount;
+	entry->nested_time = ntime;
+	memcpy(entry->plan, plan->data, len);
+	entry->plan[len] = '\0';
+	entry->plan_len = len;
+
+	LWLockRelease(aes->lock);
+}
+
+/*
+ * Reset the shared plan buffer.
+ */
+Datum
+auto_explain_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	if (!aes)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("auto_explain plan buffer is not available"),
+				 errhint("auto_explain must be loaded via shared_preload_libraries, with auto_explain.buffer_plans set.")));
+
+	LWLockAcquire(aes->lock, LW_EXCLUSIVE);
+	for (i = 0; i < auto_explain_buffer_plans; i++)
+		AE_ENTRY(i)->plan_len = 0;
+	aes->next = 0;
+	LWLockRelease(aes->lock);
+
+	PG_RETURN_VOID();
+}
+
+#define AUTO_EXPLAIN_PLANS_COLS		10
+
+/*
+ * Retrieve the plans in the shared plan buffer, oldest first.
+ */
+Datum
+auto_explain_plans(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Oid			userid = GetUserId();
+	bool		is_superuser = superuser();
+	int			i;
+
+	if (!aes)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("auto_explain plan buffer is not available"),
+				 errhint("auto_explain must be loaded via shared_preload_libraries, with auto_explain.buffer_plans set.")));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(aes->lock, LW_SHARED);
+
+	for (i = 0; i < auto_explain_buffer_plans; i++)
+	{
+		aePlanEntry *entry;
+		Datum		values[AUTO_EXPLAIN_PLANS_COLS];
+		bool		nulls[AUTO_EXPLAIN_PLANS_COLS];
+
+		entry = AE_ENTRY((aes->next + i) % auto_explain_buffer_plans);
+		if (entry->plan_len == 0)
+			continue;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[0] = TimestampTzGetDatum(entry->logged_at);
+		values[1] = Int32GetDatum(entry->pid);
+		values[2] = ObjectIdGetDatum(entry->dbid);
+		values[3] = ObjectIdGetDatum(entry->userid);
+		if (entry->queryid != 0)
+			values[4] = Int64GetDatum((int64) entry->queryid);
+		else
+			nulls[4] = true;
+		values[5] = Int32GetDatum(entry->nesting_level);
+		values[6] = Float8GetDatumFast(entry->duration);
+		values[7] = Int64GetDatumFast(entry->nested_count);
+		values[8] = Float8GetDatumFast(entry->nested_time);
+
+		/* as in pg_stat_statements, only show others' plans to superusers */
+		if (is_superuser || entry->userid == userid)
+			values[9] = CStringGetTextDatum(entry->plan);
+		else
+			values[9] = CStringGetTextDatum("<insufficient privilege>");
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	LWLockRelease(aes->lock);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -0,0 +1,16 @@
+/* contrib/pg_buffercache/pg_buffercache--1.1--1.2.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_buffercache UPDATE TO '1.2'" to load this file. \quit
+
+CREATE FUNCTION pg_buffercache_partitions(
+	OUT partition integer, OUT numa_node integer,
+	OUT first_buffer integer, OUT num_buffers integer,
+	OUT used_buffers integer, OUT dirty_buffers integer,
+	OUT complete_passes int8, OUT allocations int8,
+	OUT remote_allocations int8)
+RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pg_buffercache_partitions'
+LANGUAGE C;
+
+REVOKE ALL ON FUNCTION pg_buffercache_partitions() FROM PUBLIC;
@@ -1,4 +1,4 @@
-/* contrib/pg_buffercache/pg_buffercache--1.1.sql */
+/* contrib/pg_buffercache/pg_buffercache--1.2.sql */
 
 -- complain if script is sourced in psql, rather than via CREATE EXTENSION
 \echo Use "CREATE EXTENSION pg_buffercache" to load this file. \quit
@@ -16,6 +16,18 @@ CREATE VIEW pg_buffercache AS
 	 relforknumber int2, relblocknumber int8, isdirty bool, usagecount int2,
 	 pinning_backends int4);
 
+-- Register the function showing the partitions of the buffers.
+CREATE FUNCTION pg_buffercache_partitions(
+	OUT partition integer, OUT numa_node integer,
+	OUT first_buffer integer, OUT num_buffers integer,
+	OUT used_buffers integer, OUT dirty_buffers integer,
+	OUT complete_passes int8, OUT allocations int8,
+	OUT remote_allocations int8)
+RETURNS SETOF RECORD
+AS 'MODULE_PATHNAME', 'pg_buffercache_partitions'
+LANGUAGE C;
+
 -- Don't want these to be available to public.
 REVOKE ALL ON FUNCTION pg_buffercache_pages() FROM PUBLIC;
 REVOKE ALL ON pg_buffercache FROM PUBLIC;
+REVOKE ALL ON FUNCTION pg_buffercache_partitions() FROM PUBLIC;
@@ -17,6 +17,7 @@
 
 #define NUM_BUFFERCACHE_PAGES_MIN_ELEM	8
 #define NUM_BUFFERCACHE_PAGES_ELEM	9
+#define NUM_BUFFERCACHE_PARTITIONS_ELEM	9
 
 PG_MODULE_MAGIC;
 
@@ -249,3 +250,87 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 	else
 		SRF_RETURN_DONE(funcctx);
 }
+
+/*
+ * Function returning a row for each partition of the shared buffers (see
+ * freelist.c), with its NUMA node, its range of buffers, how many of them
+ * are in use and dirty, and how its clock sweep has been doing.
+ */
+PG_FUNCTION_INFO_V1(pg_buffercache_partitions);
+
+Datum
+pg_buffercache_partitions(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		MemoryContext oldcontext;
+		TupleDesc	tupledesc;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		if (get_call_result_type(fcinfo, NULL, &tupledesc) != TYPEFUNC_COMPOSITE)
+			elog(ERROR, "return type must be a row type");
+		funcctx->tuple_desc = BlessTupleDesc(tupledesc);
+
+		funcctx->max_calls = StrategyNumPartitions();
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+
+	if (funcctx->call_cntr < funcctx->max_calls)
+	{
+		int			partno = (int) funcctx->call_cntr;
+		Datum		values[NUM_BUFFERCACHE_PARTITIONS_ELEM];
+		bool		nulls[NUM_BUFFERCACHE_PARTITIONS_ELEM];
+		int			first_buffer;
+		int			num_buffers;
+		int			node;
+		uint32		complete_passes;
+		uint32		num_allocs;
+		uint32		num_remote_allocs;
+		int			used_buffers = 0;
+		int			dirty_buffers = 0;
+		int			i;
+		HeapTuple	tuple;
+
+		StrategyGetPartitionStats(partno, &first_buffer, &num_buffers, &node,
+								  &complete_passes, &num_allocs,
+								  &num_remote_allocs);
+
+		for (i = first_buffer; i < first_buffer + num_buffers; i++)
+		{
+			volatile BufferDesc *bufHdr = GetBufferDescriptor(i);
+
+			LockBufHdr(bufHdr);
+			if (bufHdr->flags & BM_VALID)
+				used_buffers++;
+			if (bufHdr->flags & BM_DIRTY)
+				dirty_buffers++;
+			UnlockBufHdr(bufHdr);
+		}
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(partno);
+		values[1] = Int32GetDatum(node);
+		nulls[1] = (node < 0);
+		values[2] = Int32GetDatum(first_buffer + 1);
+		values[3] = Int32GetDatum(num_buffers);
+		values[4] = Int32GetDatum(used_buffers);
+		values[5] = Int32GetDatum(dirty_buffers);
+		values[6] = Int64GetDatum((int64) complete_passes);
+		values[7] = Int64GetDatum((int64) num_allocs);
+		values[8] = Int64GetDatum((int64) num_remote_allocs);
+
+		tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+	else
+		SRF_RETURN_DONE(funcctx);
+}
@@ -0,0 +1,18 @@
+/* contrib/pg_calibrate/pg_calibrate--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION pg_calibrate" to load this file. \quit
+
+-- Measure each tablespace and the CPU, and propose cost settings.
+CREATE FUNCTION pg_calibrate_costs(size_mb integer DEFAULT 64,
+								   cache_hit_ratio float8 DEFAULT 0.9,
+								   tablespace OUT name,
+								   parameter OUT text,
+								   current_value OUT float8,
+								   proposed_value OUT float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_calibrate_costs'
+LANGUAGE C STRICT VOLATILE;
+
+-- Don't want this to be available to non-superusers.
+REVOKE ALL ON FUNCTION pg_calibrate_costs(integer, float8) FROM PUBLIC;
@@ -0,0 +1,431 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_calibrate.c
+ *		  derive planner cost settings from measurements of this machine
+ *
+ * The planner's cost constants are in units of one sequential page fetch.
+ * We time sequential and random reads of a scratch file in each tablespace,
+ * with the kernel's cache of the file dropped first, and the CPU time of
+ * the basic per-tuple and per-operator work, and express everything in
+ * units of a sequential read from pg_default.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  contrib/pg_calibrate/pg_calibrate.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/itup.h"
+#include "catalog/pg_tablespace.h"
+#include "catalog/pg_type.h"
+#include "executor/tuptable.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "optimizer/cost.h"
+#include "portability/instr_time.h"
+#include "storage/fd.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/spccache.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(pg_calibrate_costs);
+
+/* number of pages read at random offsets of each scratch file */
+#define CALIBRATE_RANDOM_READS	1024
+
+/* iterations of each CPU timing loop */
+#define CALIBRATE_CPU_LOOPS		1000000
+
+/* columns of the synthetic tuples used for the CPU timings */
+#define CALIBRATE_HEAP_COLS		8
+#define CALIBRATE_INDEX_COLS	2
+
+#define CALIBRATE_OUTPUT_COLS	4
+
+typedef struct TablespaceTimes
+{
+	Oid			spcoid;
+	char	   *spcname;
+	double		seq_read_time;	/* seconds per sequential page read */
+	double		random_read_time;	/* seconds per random page read */
+} TablespaceTimes;
+
+static void measure_tablespace(TablespaceTimes *times, int64 nblocks);
+static double measure_tuple_time(int natts);
+static double measure_index_tuple_time(int natts);
+static double measure_operator_time(void);
+static TupleDesc make_int4_tupdesc(int natts, Datum *values, bool *isnull);
+static void put_cost(Tuplestorestate *tupstore, TupleDesc tupdesc,
+		 const char *spcname, const char *parameter,
+		 double current_value, double proposed_value);
+
+/* keeps the compiler from optimizing the timing loops away */
+static volatile int32 calibrate_sink;
+
+
+/*
+ * pg_calibrate_costs(size_mb int, cache_hit_ratio float8)
+ *
+ * Writes a scratch file of size_mb megabytes in each tablespace and times
+ * reading it, then times the CPU work, and returns the current and the
+ * proposed value of each cost setting.  Page costs are proposed per
+ * tablespace; the CPU costs apply to the whole server, and are returned
+ * with a null tablespace.
+ *
+ * The random page cost assumes that the given fraction of random reads is
+ * served from cache, as the default of 4.0 assumes 90% of reads 40 times
+ * slower than sequential ones to be cached.
+ */
+Datum
+pg_calibrate_costs(PG_FUNCTION_ARGS)
+{
+	int32		size_mb = PG_GETARG_INT32(0);
+	float8		cache_hit_ratio = PG_GETARG_FLOAT8(1);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Relation	rel;
+	HeapScanDesc scan;
+	HeapTuple	tuple;
+	TablespaceTimes *spaces;
+	TablespaceTimes *ref = NULL;
+	int			nspaces = 0;
+	int			maxspaces = 8;
+	int64		nblocks;
+	double		tuple_time;
+	double		index_tuple_time;
+	double		operator_time;
+	int			i;
+
+	if (size_mb < 1 || size_mb > 1024 * 1024)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("size_mb must be between 1 and %d", 1024 * 1024)));
+	if (cache_hit_ratio < 0.0 || cache_hit_ratio >= 1.0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cache_hit_ratio must be at least 0 and less than 1")));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	nblocks = (int64) size_mb * (1024 * 1024 / BLCKSZ);
+
+	/* Collect the tablespaces that can hold files */
+	spaces = (TablespaceTimes *) palloc(maxspaces * sizeof(TablespaceTimes));
+	rel = heap_open(TableSpaceRelationId, AccessShareLock);
+	scan = heap_beginscan_catalog(rel, 0, NULL);
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_tablespace spcform = (Form_pg_tablespace) GETSTRUCT(tuple);
+
+		if (HeapTupleGetOid(tuple) == GLOBALTABLESPACE_OID)
+			continue;
+		if (nspaces >= maxspaces)
+		{
+			maxspaces *= 2;
+			spaces = (TablespaceTimes *)
+				repalloc(spaces, maxspaces * sizeof(TablespaceTimes));
+		}
+		spaces[nspaces].spcoid = HeapTupleGetOid(tuple);
+		spaces[nspaces].spcname = pstrdup(NameStr(spcform->spcname));
+		nspaces++;
+	}
+	heap_endscan(scan);
+	heap_close(rel, AccessShareLock);
+
+	/* Time the storage, then the CPU */
+	for (i = 0; i < nspaces; i++)
+	{
+		measure_tablespace(&spaces[i], nblocks);
+		if (spaces[i].spcoid == DEFAULTTABLESPACE_OID)
+			ref = &spaces[i];
+	}
+	if (ref == NULL)
+		elog(ERROR, "tablespace pg_default not found");
+
+	tuple_time = measure_tuple_time(CALIBRATE_HEAP_COLS);
+	index_tuple_time = measure_index_tuple_time(CALIBRATE_INDEX_COLS);
+	operator_time = measure_operator_time();
+
+	/* Switch into long-lived context to construct returned data structures */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	if (tupdesc->natts != CALIBRATE_OUTPUT_COLS)
+		elog(ERROR, "incorrect number of output arguments");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < nspaces; i++)
+	{
+		TablespaceTimes *times = &spaces[i];
+		float8		cur_random_page_cost;
+		float8		cur_seq_page_cost;
+		double		seq_cost;
+		double		random_cost;
+
+		get_tablespace_page_costs(times->spcoid, &cur_random_page_cost,
+								  &cur_seq_page_cost);
+
+		seq_cost = times->seq_read_time / ref->seq_read_time;
+		random_cost = times->random_read_time / ref->seq_read_time *
+			(1.0 - cache_hit_ratio);
+		random_cost = Max(random_cost, seq_cost);
+
+		put_cost(tupstore, tupdesc, times->spcname, "seq_page_cost",
+				 cur_seq_page_cost, seq_cost);
+		put_cost(tupstore, tupdesc, times->spcname, "random_page_cost",
+				 cur_random_page_cost, random_cost);
+	}
+
+	put_cost(tupstore, tupdesc, NULL, "cpu_tuple_cost",
+			 cpu_tuple_cost, tuple_time / ref->seq_read_time);
+	put_cost(tupstore, tupdesc, NULL, "cpu_index_tuple_cost",
+			 cpu_index_tuple_cost, index_tuple_time / ref->seq_read_time);
+	put_cost(tupstore, tupdesc, NULL, "cpu_operator_cost",
+			 cpu_operator_cost, operator_time / ref->seq_read_time);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Time sequential and random page reads of a scratch file in a tablespace.
+ *
+ * The file is synced and then evicted from the kernel's cache, so that the
+ * reads have to go to storage.  Where the kernel can't be asked to do that,
+ * reads of a file smaller than memory will mostly measure the cache.
+ */
+static void
+measure_tablespace(TablespaceTimes *times, int64 nblocks)
+{
+	char	   *buffer = (char *) palloc(BLCKSZ);
+	File		file;
+	instr_time	start;
+	instr_time	duration;
+	int64		blkno;
+	int			nreads;
+	int			i;
+
+	/* use incompressible contents, so that the storage can't cheat */
+	for (i = 0; i < BLCKSZ / sizeof(uint32); i++)
+		((uint32 *) buffer)[i] = (uint32) random();
+
+	file = OpenTablespaceTemporaryFile(times->spcoid);
+
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		/* and make every page different */
+		memcpy(buffer, &blkno, sizeof(blkno));
+		if (FileWrite(file, buffer, BLCKSZ) != BLCKSZ)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							FilePathName(file))));
+	}
+	if (FileSync(file) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m",
+						FilePathName(file))));
+
+	/* sequential reads */
+	(void) FileDropCache(file, 0, 0);
+	if (FileSeek(file, 0, SEEK_SET) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek in file \"%s\": %m",
+						FilePathName(file))));
+	INSTR_TIME_SET_CURRENT(start);
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (FileRead(file, buffer, BLCKSZ) != BLCKSZ)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m",
+							FilePathName(file))));
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	times->seq_read_time = INSTR_TIME_GET_DOUBLE(duration) / nblocks;
+
+	/* random reads */
+	(void) FileDropCache(file, 0, 0);
+	nreads = (int) Min(nblocks, CALIBRATE_RANDOM_READS);
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < nreads; i++)
+	{
+		off_t		offset = (off_t) (random() % nblocks) * BLCKSZ;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (FileSeek(file, offset, SEEK_SET) != offset ||
+			FileRead(file, buffer, BLCKSZ) != BLCKSZ)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m",
+							FilePathName(file))));
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	times->random_read_time = INSTR_TIME_GET_DOUBLE(duration) / nreads;
+
+	FileClose(file);
+	pfree(buffer);
+}
+
+/*
+ * Time the basic work of processing a heap tuple: storing it in a slot and
+ * extracting its columns.
+ */
+static double
+measure_tuple_time(int natts)
+{
+	Datum	   *values = (Datum *) palloc(natts * sizeof(Datum));
+	bool	   *isnull = (bool *) palloc(natts * sizeof(bool));
+	TupleDesc	tupdesc = make_int4_tupdesc(natts, values, isnull);
+	HeapTuple	tuple = heap_form_tuple(tupdesc, values, isnull);
+	TupleTableSlot *slot = MakeSingleTupleTableSlot(tupdesc);
+	instr_time	start;
+	instr_time	duration;
+	int			i;
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < CALIBRATE_CPU_LOOPS; i++)
+	{
+		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+		slot_getallattrs(slot);
+		calibrate_sink += DatumGetInt32(slot->tts_values[natts - 1]);
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	ExecDropSingleTupleTableSlot(slot);
+
+	return INSTR_TIME_GET_DOUBLE(duration) / CALIBRATE_CPU_LOOPS;
+}
+
+/*
+ * Time the basic work of processing an index tuple: extracting its columns.
+ */
+static double
+measure_index_tuple_time(int natts)
+{
+	Datum	   *values = (Datum *) palloc(natts * sizeof(Datum));
+	bool	   *isnull = (bool *) palloc(natts * sizeof(bool));
+	TupleDesc	tupdesc = make_int4_tupdesc(natts, values, isnull);
+	IndexTuple	itup = index_form_tuple(tupdesc, values, isnull);
+	instr_time	start;
+	instr_time	duration;
+	int			i;
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < CALIBRATE_CPU_LOOPS; i++)
+	{
+		index_deform_tuple(itup, tupdesc, values, isnull);
+		calibrate_sink += DatumGetInt32(values[natts - 1]);
+	}
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	return INSTR_TIME_GET_DOUBLE(duration) / CALIBRATE_CPU_LOOPS;
+}
+
+/*
+ * Time a call of a cheap operator's function through the function manager.
+ */
+static double
+measure_operator_time(void)
+{
+	FmgrInfo	flinfo;
+	instr_time	start;
+	instr_time	duration;
+	int			i;
+
+	fmgr_info(F_INT4LT, &flinfo);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < CALIBRATE_CPU_LOOPS; i++)
+		calibrate_sink += DatumGetBool(FunctionCall2(&flinfo,
+													 Int32GetDatum(i),
+												Int32GetDatum(calibrate_sink)));
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	return INSTR_TIME_GET_DOUBLE(duration) / CALIBRATE_CPU_LOOPS;
+}
+
+/*
+ * Build a descriptor for natts int4 columns, and fill values/isnull with a
+ * row for it.
+ */
+static TupleDesc
+make_int4_tupdesc(int natts, Datum *values, bool *isnull)
+{
+	TupleDesc	tupdesc = CreateTemplateTupleDesc(natts, false);
+	int			i;
+
+	for (i = 0; i < natts; i++)
+	{
+		TupleDescInitEntry(tupdesc, (AttrNumber) (i + 1), NULL,
+						   INT4OID, -1, 0);
+		values[i] = Int32GetDatum(i);
+		isnull[i] = false;
+	}
+
+	return tupdesc;
+}
+
+static void
+put_cost(Tuplestorestate *tupstore, TupleDesc tupdesc,
+		 const char *spcname, const char *parameter,
+		 double current_value, double proposed_value)
+{
+	Datum		values[CALIBRATE_OUTPUT_COLS];
+	bool		nulls[CALIBRATE_OUTPUT_COLS];
+
+	memset(nulls, 0, sizeof(nulls));
+
+	if (spcname)
+		values[0] = DirectFunctionCall1(namein, CStringGetDatum(spcname));
+	else
+		nulls[0] = true;
+	values[1] = CStringGetTextDatum(parameter);
+	values[2] = Float8GetDatum(current_value);
+	values[3] = Float8GetDatum(proposed_value);
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
@@ -0,0 +1,1055 @@
+/*-------------------------------------------------------------------------
+ *
+ * autoprewarm.c
+ *		Periodically dump information about the blocks present in
+ *		shared_buffers, and reload them on server restart.
+ *
+ *		Due to locking considerations, we can't actually begin prewarming
+ *		until the server reaches a consistent state.  We need the catalogs
+ *		to be consistent so that we can figure out which relation to lock,
+ *		and we need to lock the relations so that we don't try to prewarm
+ *		pages from a relation that is in the process of being dropped.
+ *
+ *		The main worker reads the dump file, sorts the blocks by database,
+ *		file and block, and then, one database at a time, starts up to
+ *		pg_prewarm.autoprewarm_workers workers connected to the database.
+ *		These take runs of consecutive blocks of a relation fork from the
+ *		sorted list in turn, and read them into shared buffers.  Blocks
+ *		of relations that have been dropped since the dump are skipped.
+ *		Prewarming stops once there are no free buffers left, so that it
+ *		never pushes out pages that are already in use.
+ *
+ *		After prewarming, the main worker stays around to dump the list of
+ *		blocks every pg_prewarm.autoprewarm_interval, and once more when the
+ *		server shuts down.
+ *
+ *	Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ *	IDENTIFICATION
+ *		contrib/pg_prewarm/autoprewarm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/heapam.h"
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/postmaster.h"
+#include "storage/buf_internals.h"
+#include "storage/dsm.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/read_stream.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/rel.h"
+#include "utils/relfilenodemap.h"
+#include "utils/resowner.h"
+#include "utils/timestamp.h"
+
+#define AUTOPREWARM_FILE "autoprewarm.blocks"
+
+/* Most blocks a worker claims at once, so that big relations get shared */
+#define AUTOPREWARM_RUN_BLOCKS	1024
+
+/* Metadata for each block we dump. */
+typedef struct BlockInfoRecord
+{
+	Oid			database;
+	Oid			tablespace;
+	Oid			filenode;
+	ForkNumber	forknum;
+	BlockNumber blocknum;
+} BlockInfoRecord;
+
+/* Shared state information for autoprewarm bgworker. */
+typedef struct AutoPrewarmSharedState
+{
+	LWLock	   *lock;			/* mutual exclusion */
+	pid_t		bgworker_pid;	/* for main bgworker */
+	pid_t		pid_using_dumpfile;		/* for autoprewarm or block dump */
+
+	/* Following items are for communication with per-database workers */
+	dsm_handle	block_info_handle;
+	Oid			database;
+	int			prewarm_next_idx;		/* next block to be claimed */
+	int			prewarm_stop_idx;		/* end of this database's blocks */
+	int			prewarmed_blocks;
+} AutoPrewarmSharedState;
+
+/* State of the read stream a per-database worker uses for one run */
+typedef struct AutoPrewarmRun
+{
+	BlockInfoRecord *blocks;
+	int			nblocks;		/* # of entries in blocks */
+	int			pos;			/* next entry to hand out */
+	BlockNumber relnblocks;		/* current size of the relation fork */
+	bool		out_of_buffers; /* have we run out of free buffers? */
+} AutoPrewarmRun;
+
+void		_PG_init(void);
+void		autoprewarm_main(Datum main_arg);
+void		autoprewarm_database_main(Datum main_arg);
+
+PG_FUNCTION_INFO_V1(autoprewarm_start_worker);
+PG_FUNCTION_INFO_V1(autoprewarm_dump_now);
+
+static void apw_load_buffers(void);
+static bool apw_start_database_workers(int nworkers);
+static bool apw_claim_run(BlockInfoRecord *block_info, int *start, int *stop);
+static bool apw_load_run(BlockInfoRecord *blocks, int nblocks, int *loaded);
+static BlockNumber apw_run_next_block(ReadStream *stream,
+				   void *callback_private_data,
+				   void *per_buffer_data);
+static int	apw_dump_now(bool is_bgworker, bool dump_unlogged);
+static void apw_start_master_worker(void);
+static bool apw_init_shmem(void);
+static void apw_detach_shmem(int code, Datum arg);
+static int	apw_compare_blockinfo(const void *p, const void *q);
+static bool apw_same_fork(const BlockInfoRecord *a, const BlockInfoRecord *b);
+static void apw_sigterm_handler(SIGNAL_ARGS);
+static void apw_sighup_handler(SIGNAL_ARGS);
+
+/* Flags set by signal handlers */
+static volatile sig_atomic_t got_sigterm = false;
+static volatile sig_atomic_t got_sighup = false;
+
+/* Pointer to shared-memory state. */
+static AutoPrewarmSharedState *apw_state = NULL;
+
+/* GUC variables. */
+static bool autoprewarm = true; /* start worker? */
+static int	autoprewarm_interval;		/* dump interval */
+static int	autoprewarm_workers;	/* workers per database */
+
+/*
+ * Module load callback.
+ */
+void
+_PG_init(void)
+{
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_interval",
+							"Sets the interval between dumps of shared buffers",
+							"If set to zero, time-based dumping is disabled.",
+							&autoprewarm_interval,
+							300,
+							0, INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_workers",
+							"Sets the number of workers that prewarm each database",
+							NULL,
+							&autoprewarm_workers,
+							2,
+							1, MAX_BACKENDS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	/* can't define PGC_POSTMASTER variable after startup */
+	DefineCustomBoolVariable("pg_prewarm.autoprewarm",
+							 "Starts the autoprewarm worker.",
+							 NULL,
+							 &autoprewarm,
+							 true,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	EmitWarningsOnPlaceholders("pg_prewarm");
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(AutoPrewarmSharedState)));
+	RequestAddinLWLocks(1);
+
+	/* Register autoprewarm worker, if enabled. */
+	if (autoprewarm)
+		apw_start_master_worker();
+}
+
+/*
+ * Main entry point for the master autoprewarm process.  Per-database workers
+ * have a separate entry point.
+ */
+void
+autoprewarm_main(Datum main_arg)
+{
+	bool		first_time = true;
+	TimestampTz last_dump_time = 0;
+
+	/* Establish signal handlers; once that's done, unblock signals. */
+	pqsignal(SIGTERM, apw_sigterm_handler);
+	pqsignal(SIGHUP, apw_sighup_handler);
+	BackgroundWorkerUnblockSignals();
+
+	/* We need a resource owner for the dynamic shared memory we create */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "autoprewarm");
+
+	/* Create (if necessary) and attach to our shared memory area. */
+	if (apw_init_shmem())
+		first_time = false;
+
+	/* Set on-detach hook so that our PID will be cleared on exit. */
+	on_shmem_exit(apw_detach_shmem, 0);
+
+	/*
+	 * Store our PID in the shared memory area --- unless there's already
+	 * another worker running, in which case just exit.
+	 */
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	if (apw_state->bgworker_pid != InvalidPid)
+	{
+		LWLockRelease(apw_state->lock);
+		ereport(LOG,
+				(errmsg("autoprewarm worker is already running under PID %lu",
+						(unsigned long) apw_state->bgworker_pid)));
+		return;
+	}
+	apw_state->bgworker_pid = MyProcPid;
+	LWLockRelease(apw_state->lock);
+
+	/*
+	 * Preload buffers from the dump file only if we just created the shared
+	 * memory region.  Otherwise, it's either already been done or shouldn't
+	 * be done - e.g. because the old dump file has been overwritten since the
+	 * server was started.
+	 *
+	 * There's not much point in performing a dump immediately after we finish
+	 * preloading; so, if we do end up preloading, consider the last dump time
+	 * to be equal to the current time.
+	 */
+	if (first_time)
+	{
+		apw_load_buffers();
+		last_dump_time = GetCurrentTimestamp();
+	}
+
+	/* Periodically dump buffers until terminated. */
+	while (!got_sigterm)
+	{
+		int			rc;
+
+		/* In case of a SIGHUP, just reload the configuration. */
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (autoprewarm_interval <= 0)
+		{
+			/* We're only dumping at shutdown, so just wait forever. */
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH,
+						   -1L,
+						   PG_WAIT_EXTENSION);
+		}
+		else
+		{
+			TimestampTz next_dump_time;
+			long		secs;
+			int			usecs;
+			long		delay_in_ms;
+
+			/* Compute the next dump time. */
+			next_dump_time =
+				TimestampTzPlusMilliseconds(last_dump_time,
+											autoprewarm_interval * 1000);
+			TimestampDifference(GetCurrentTimestamp(), next_dump_time,
+								&secs, &usecs);
+			delay_in_ms = secs * 1000 + (usecs / 1000);
+
+			/* Perform a dump if it's time. */
+			if (delay_in_ms <= 0)
+			{
+				last_dump_time = GetCurrentTimestamp();
+				apw_dump_now(true, false);
+				continue;
+			}
+
+			/* Sleep until the next dump time. */
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+						   delay_in_ms,
+						   PG_WAIT_EXTENSION);
+		}
+
+		/* Reset the latch, bail out if postmaster died, otherwise loop. */
+		ResetLatch(MyLatch);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+
+	/*
+	 * Dump one last time.  We assume this is probably the result of an
+	 * instance shutdown and thus no more work is happening.
+	 */
+	apw_dump_now(true, true);
+}
+
+/*
+ * Read the dump file and launch per-database workers one at a time to
+ * prewarm the buffers found there.
+ */
+static void
+apw_load_buffers(void)
+{
+	FILE	   *file = NULL;
+	int			num_elements,
+				i;
+	int			start_idx;
+	BlockInfoRecord *blkinfo;
+	dsm_segment *seg;
+
+	/*
+	 * Skip the prewarm if the dump file is in use; otherwise, prevent any
+	 * other process from writing it while we're using it.
+	 */
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	if (apw_state->pid_using_dumpfile == InvalidPid)
+		apw_state->pid_using_dumpfile = MyProcPid;
+	else
+	{
+		LWLockRelease(apw_state->lock);
+		ereport(LOG,
+				(errmsg("skipping prewarm because block dump file is being written by PID %lu",
+						(unsigned long) apw_state->pid_using_dumpfile)));
+		return;
+	}
+	LWLockRelease(apw_state->lock);
+
+	/*
+	 * Open the block dump file.  Exit quietly if it doesn't exist, but report
+	 * any other error.
+	 */
+	file = AllocateFile(AUTOPREWARM_FILE, "r");
+	if (!file)
+	{
+		if (errno == ENOENT)
+		{
+			LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+			apw_state->pid_using_dumpfile = InvalidPid;
+			LWLockRelease(apw_state->lock);
+			return;				/* No file to load. */
+		}
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m",
+						AUTOPREWARM_FILE)));
+	}
+
+	/* First line of the file is a record count. */
+	if (fscanf(file, "<<%d>>\n", &num_elements) != 1 || num_elements < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from file \"%s\": %m",
+						AUTOPREWARM_FILE)));
+
+	if (num_elements == 0)
+	{
+		FreeFile(file);
+		LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+		apw_state->pid_using_dumpfile = InvalidPid;
+		LWLockRelease(apw_state->lock);
+		return;
+	}
+
+	/* Allocate a dynamic shared memory segment to store the record data. */
+	seg = dsm_create(sizeof(BlockInfoRecord) * num_elements, 0);
+	blkinfo = (BlockInfoRecord *) dsm_segment_address(seg);
+
+	/* Read records, one per line. */
+	for (i = 0; i < num_elements; i++)
+	{
+		unsigned	forknum;
+
+		if (fscanf(file, "%u,%u,%u,%u,%u\n", &blkinfo[i].database,
+				   &blkinfo[i].tablespace, &blkinfo[i].filenode,
+				   &forknum, &blkinfo[i].blocknum) != 5)
+			ereport(ERROR,
+					(errmsg("autoprewarm block dump file is corrupted at line %d",
+							i + 1)));
+		if (forknum > MAX_FORKNUM)
+			ereport(ERROR,
+					(errmsg("autoprewarm block dump file is corrupted at line %d",
+							i + 1)));
+		blkinfo[i].forknum = (ForkNumber) forknum;
+	}
+
+	FreeFile(file);
+
+	/* Sort the blocks to be loaded. */
+	pg_qsort(blkinfo, num_elements, sizeof(BlockInfoRecord),
+			 apw_compare_blockinfo);
+
+	/* Populate shared memory state. */
+	apw_state->block_info_handle = dsm_segment_handle(seg);
+	apw_state->prewarmed_blocks = 0;
+
+	/* Find the blocks of each database in turn, and prewarm them. */
+	start_idx = 0;
+	while (start_idx < num_elements)
+	{
+		int			j = start_idx;
+		Oid			current_db = blkinfo[j].database;
+		int			nruns = 1;
+
+		/*
+		 * Advance j to the first BlockInfoRecord that does not belong to this
+		 * database, counting the runs a worker could claim on the way.
+		 */
+		j++;
+		while (j < num_elements)
+		{
+			if (current_db != blkinfo[j].database)
+			{
+				/*
+				 * Combine BlockInfoRecords for global objects with those of
+				 * the database.
+				 */
+				if (current_db != InvalidOid)
+					break;
+				current_db = blkinfo[j].database;
+			}
+			if (!apw_same_fork(&blkinfo[j - 1], &blkinfo[j]))
+				nruns++;
+
+			j++;
+		}
+
+		/*
+		 * If we reach this point with current_db == InvalidOid, then only
+		 * BlockInfoRecords belonging to global objects exist.  We can't
+		 * prewarm without a database connection, so just bail out.
+		 */
+		if (current_db == InvalidOid)
+			break;
+
+		/* If we've run out of free buffers, don't launch more workers. */
+		if (!StrategyHaveFreeBuffer())
+			break;
+
+		/* Configure the range and database for the per-database workers */
+		LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+		apw_state->database = current_db;
+		apw_state->prewarm_next_idx = start_idx;
+		apw_state->prewarm_stop_idx = j;
+		LWLockRelease(apw_state->lock);
+
+		/*
+		 * Start per-database workers to load blocks for this database; this
+		 * function will return once they have all exited.
+		 */
+		if (!apw_start_database_workers(Min(autoprewarm_workers, nruns)))
+			break;
+
+		/* Prepare for next database, unless we've been asked to stop. */
+		if (got_sigterm)
+			break;
+		start_idx = j;
+	}
+
+	/* Clean up. */
+	dsm_detach(seg);
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	apw_state->pid_using_dumpfile = InvalidPid;
+	LWLockRelease(apw_state->lock);
+
+	ereport(LOG,
+			(errmsg("autoprewarm prewarmed %d of %d previously-loaded blocks",
+					apw_state->prewarmed_blocks, num_elements)));
+}
+
+/*
+ * Prewarm the blocks of the database set up by apw_load_buffers, with up to
+ * nworkers workers, and wait for them to finish.  Returns false if no worker
+ * could be started.
+ */
+static bool
+apw_start_database_workers(int nworkers)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle **handles;
+	int			nstarted;
+	int			i;
+
+	MemSet(&worker, 0, sizeof(BackgroundWorker));
+	worker.bgw_flags =
+		BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	strcpy(worker.bgw_library_name, "pg_prewarm");
+	strcpy(worker.bgw_function_name, "autoprewarm_database_main");
+	strcpy(worker.bgw_name, "autoprewarm per-database worker");
+
+	/* must set notify PID to wait for shutdown */
+	worker.bgw_notify_pid = MyProcPid;
+
+	handles = (BackgroundWorkerHandle **)
+		palloc(nworkers * sizeof(BackgroundWorkerHandle *));
+
+	for (nstarted = 0; nstarted < nworkers; nstarted++)
+	{
+		if (!RegisterDynamicBackgroundWorker(&worker, &handles[nstarted]))
+			break;
+	}
+
+	/* We can make do with fewer workers, but not with none */
+	if (nstarted == 0)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("registering dynamic bgworker autoprewarm failed"),
+				 errhint("Consider increasing configuration parameter \"max_worker_processes\".")));
+		pfree(handles);
+		return false;
+	}
+
+	for (i = 0; i < nstarted; i++)
+	{
+		/*
+		 * Ignore return value; if it fails, postmaster has died, but we have
+		 * checks for that elsewhere.
+		 */
+		WaitForBackgroundWorkerShutdown(handles[i]);
+		pfree(handles[i]);
+	}
+
+	pfree(handles);
+	return true;
+}
+
+/*
+ * Prewarm blocks of one database, taking runs of them from the list set up
+ * by apw_load_buffers until there are none left.
+ */
+void
+autoprewarm_database_main(Datum main_arg)
+{
+	BlockInfoRecord *block_info;
+	dsm_segment *seg;
+	int			start;
+	int			stop;
+
+	/* Establish signal handlers; once that's done, unblock signals. */
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* We need a resource owner to attach the dynamic shared memory */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL,
+											   "autoprewarm per-database worker");
+
+	/* Connect to correct database and get block information. */
+	apw_init_shmem();
+	seg = dsm_attach(apw_state->block_info_handle);
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	BackgroundWorkerInitializeConnectionByOid(apw_state->database, InvalidOid);
+	block_info = (BlockInfoRecord *) dsm_segment_address(seg);
+
+	while (apw_claim_run(block_info, &start, &stop))
+	{
+		int			loaded = 0;
+		bool		more;
+
+		more = apw_load_run(block_info + start, stop - start, &loaded);
+
+		LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+		apw_state->prewarmed_blocks += loaded;
+		/* once we're out of free buffers, tell the others to stop, too */
+		if (!more)
+			apw_state->prewarm_next_idx = apw_state->prewarm_stop_idx;
+		LWLockRelease(apw_state->lock);
+	}
+
+	dsm_detach(seg);
+}
+
+/*
+ * Claim the next run of blocks from the current database's range, that is,
+ * consecutive entries of one relation fork, and at most
+ * AUTOPREWARM_RUN_BLOCKS of them.  Returns false if there are none left.
+ */
+static bool
+apw_claim_run(BlockInfoRecord *block_info, int *start, int *stop)
+{
+	int			pos;
+	int			end;
+
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	pos = apw_state->prewarm_next_idx;
+	end = pos;
+	while (end < apw_state->prewarm_stop_idx &&
+		   end - pos < AUTOPREWARM_RUN_BLOCKS &&
+		   apw_same_fork(&block_info[pos], &block_info[end]))
+		end++;
+	apw_state->prewarm_next_idx = end;
+	LWLockRelease(apw_state->lock);
+
+	*start = pos;
+	*stop = end;
+	return pos < end;
+}
+
+/*
+ * Read a run of blocks of one relation fork into shared buffers, through a
+ * read stream so that consecutive blocks are read together.  *loaded is
+ * set to the number of blocks read.  Returns false if we ran out of free
+ * buffers.
+ */
+static bool
+apw_load_run(BlockInfoRecord *blocks, int nblocks, int *loaded)
+{
+	AutoPrewarmRun run;
+	Oid			reloid;
+	Relation	rel = NULL;
+
+	run.blocks = blocks;
+	run.nblocks = nblocks;
+	run.pos = 0;
+	run.relnblocks = 0;
+	run.out_of_buffers = false;
+
+	StartTransactionCommand();
+
+	/*
+	 * Find the relation, if it still exists.  We skip blocks of relations
+	 * that have been dropped since the dump.
+	 */
+	reloid = RelidByRelfilenode(blocks[0].tablespace, blocks[0].filenode);
+	if (OidIsValid(reloid))
+		rel = try_relation_open(reloid, AccessShareLock);
+
+	if (rel)
+	{
+		RelationOpenSmgr(rel);
+
+		/* Check whether the fork exists, and how big it is. */
+		if (smgrexists(rel->rd_smgr, blocks[0].forknum))
+		{
+			ReadStream *stream;
+			Buffer		buf;
+
+			run.relnblocks = RelationGetNumberOfBlocksInFork(rel,
+														 blocks[0].forknum);
+
+			stream = read_stream_begin_relation(rel, blocks[0].forknum, NULL,
+												apw_run_next_block, &run, 0);
+			while ((buf = read_stream_next_buffer(stream, NULL)) !=
+				   InvalidBuffer)
+			{
+				CHECK_FOR_INTERRUPTS();
+				ReleaseBuffer(buf);
+				(*loaded)++;
+			}
+			read_stream_end(stream);
+		}
+
+		relation_close(rel, AccessShareLock);
+	}
+
+	CommitTransactionCommand();
+
+	return !run.out_of_buffers;
+}
+
+/*
+ * Read stream callback for apw_load_run.
+ */
+static BlockNumber
+apw_run_next_block(ReadStream *stream, void *callback_private_data,
+				   void *per_buffer_data)
+{
+	AutoPrewarmRun *run = (AutoPrewarmRun *) callback_private_data;
+	BlockNumber blocknum;
+
+	if (run->pos >= run->nblocks)
+		return InvalidBlockNumber;
+
+	/* Stop if the relation fork has been truncated since the dump. */
+	blocknum = run->blocks[run->pos].blocknum;
+	if (blocknum >= run->relnblocks)
+		return InvalidBlockNumber;
+
+	/* Prewarming mustn't evict anything. */
+	if (!StrategyHaveFreeBuffer())
+	{
+		run->out_of_buffers = true;
+		return InvalidBlockNumber;
+	}
+
+	run->pos++;
+	return blocknum;
+}
+
+/*
+ * Dump information on blocks in shared buffers.  We use a text format here
+ * so that it's easy to understand and even change the file contents if
+ * necessary.
+ * Returns the number of blocks dumped.
+ */
+static int
+apw_dump_now(bool is_bgworker, bool dump_unlogged)
+{
+	int			num_blocks;
+	int			i;
+	int			ret;
+	BlockInfoRecord *block_info_array;
+	volatile BufferDesc *bufHdr;
+	FILE	   *file;
+	char		transient_dump_file_path[MAXPGPATH];
+	pid_t		pid;
+
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	pid = apw_state->pid_using_dumpfile;
+	if (apw_state->pid_using_dumpfile == InvalidPid)
+		apw_state->pid_using_dumpfile = MyProcPid;
+	LWLockRelease(apw_state->lock);
+
+	if (pid != InvalidPid)
+	{
+		if (!is_bgworker)
+			ereport(ERROR,
+					(errmsg("could not perform block dump because dump file is being used by PID %lu",
+							(unsigned long) pid)));
+
+		ereport(LOG,
+				(errmsg("skipping block dump because it is already being performed by PID %lu",
+						(unsigned long) pid)));
+		return 0;
+	}
+
+	block_info_array =
+		(BlockInfoRecord *) palloc(sizeof(BlockInfoRecord) * NBuffers);
+
+	for (num_blocks = 0, i = 0; i < NBuffers; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		bufHdr = GetBufferDescriptor(i);
+
+		/* Lock each buffer header before inspecting. */
+		LockBufHdr(bufHdr);
+
+		/*
+		 * Unlogged tables will be automatically truncated after a crash or
+		 * unclean shutdown.  In such cases we need not prewarm them.  Dump
+		 * them only if requested by caller.
+		 */
+		if ((bufHdr->flags & BM_TAG_VALID) &&
+			((bufHdr->flags & BM_PERMANENT) || dump_unlogged))
+		{
+			block_info_array[num_blocks].database = bufHdr->tag.rnode.dbNode;
+			block_info_array[num_blocks].tablespace = bufHdr->tag.rnode.spcNode;
+			block_info_array[num_blocks].filenode = bufHdr->tag.rnode.relNode;
+			block_info_array[num_blocks].forknum = bufHdr->tag.forkNum;
+			block_info_array[num_blocks].blocknum = bufHdr->tag.blockNum;
+			++num_blocks;
+		}
+
+		UnlockBufHdr(bufHdr);
+	}
+
+	snprintf(transient_dump_file_path, MAXPGPATH, "%s.tmp", AUTOPREWARM_FILE);
+	file = AllocateFile(transient_dump_file_path, "w");
+	if (!file)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m",
+						transient_dump_file_path)));
+
+	ret = fprintf(file, "<<%d>>\n", num_blocks);
+	if (ret < 0)
+	{
+		int			save_errno = errno;
+
+		FreeFile(file);
+		unlink(transient_dump_file_path);
+		errno = save_errno;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m",
+						transient_dump_file_path)));
+	}
+
+	for (i = 0; i < num_blocks; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		ret = fprintf(file, "%u,%u,%u,%u,%u\n",
+					  block_info_array[i].database,
+					  block_info_array[i].tablespace,
+					  block_info_array[i].filenode,
+					  (uint32) block_info_array[i].forknum,
+					  block_info_array[i].blocknum);
+		if (ret < 0)
+		{
+			int			save_errno = errno;
+
+			FreeFile(file);
+			unlink(transient_dump_file_path);
+			errno = save_errno;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							transient_dump_file_path)));
+		}
+	}
+
+	pfree(block_info_array);
+
+	/*
+	 * Rename transient_dump_file_path to AUTOPREWARM_FILE to make things
+	 * permanent.
+	 */
+	ret = FreeFile(file);
+	if (ret != 0)
+	{
+		int			save_errno = errno;
+
+		unlink(transient_dump_file_path);
+		errno = save_errno;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m",
+						transient_dump_file_path)));
+	}
+
+	(void) durable_rename(transient_dump_file_path, AUTOPREWARM_FILE, ERROR);
+
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	apw_state->pid_using_dumpfile = InvalidPid;
+	LWLockRelease(apw_state->lock);
+
+	ereport(DEBUG1,
+			(errmsg("wrote block details for %d blocks", num_blocks)));
+	return num_blocks;
+}
+
+/*
+ * SQL-callable function to launch autoprewarm.
+ */
+Datum
+autoprewarm_start_worker(PG_FUNCTION_ARGS)
+{
+	pid_t		pid;
+
+	if (!autoprewarm)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("autoprewarm is disabled")));
+
+	apw_init_shmem();
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	pid = apw_state->bgworker_pid;
+	LWLockRelease(apw_state->lock);
+
+	if (pid != InvalidPid)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("autoprewarm worker is already running under PID %lu",
+						(unsigned long) pid)));
+
+	apw_start_master_worker();
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * SQL-callable function to perform an immediate block dump.
+ *
+ * Note: this is declared to return int8, as insurance against some
+ * very distant day when we might make NBuffers wider than int.
+ */
+Datum
+autoprewarm_dump_now(PG_FUNCTION_ARGS)
+{
+	int			num_blocks;
+
+	apw_init_shmem();
+
+	PG_ENSURE_ERROR_CLEANUP(apw_detach_shmem, 0);
+	{
+		num_blocks = apw_dump_now(false, true);
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(apw_detach_shmem, 0);
+
+	PG_RETURN_INT64((int64) num_blocks);
+}
+
+/*
+ * Allocate and initialize autoprewarm related shared memory, if not already
+ * done, and set up backend-local pointer to that state.  Returns true if an
+ * existing shared memory segment was found.
+ */
+static bool
+apw_init_shmem(void)
+{
+	bool		found;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	apw_state = (AutoPrewarmSharedState *)
+		ShmemInitStruct("autoprewarm",
+						sizeof(AutoPrewarmSharedState),
+						&found);
+	if (!found)
+	{
+		/* First time through ... */
+		apw_state->lock = LWLockAssign();
+		apw_state->bgworker_pid = InvalidPid;
+		apw_state->pid_using_dumpfile = InvalidPid;
+	}
+	LWLockRelease(AddinShmemInitLock);
+
+	return found;
+}
+
+/*
+ * Clear our PID from autoprewarm shared state.
+ */
+static void
+apw_detach_shmem(int code, Datum arg)
+{
+	LWLockAcquire(apw_state->lock, LW_EXCLUSIVE);
+	if (apw_state->pid_using_dumpfile == MyProcPid)
+		apw_state->pid_using_dumpfile = InvalidPid;
+	if (apw_state->bgworker_pid == MyProcPid)
+		apw_state->bgworker_pid = InvalidPid;
+	LWLockRelease(apw_state->lock);
+}
+
+/*
+ * Start autoprewarm master worker process.
+ */
+static void
+apw_start_master_worker(void)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+	BgwHandleStatus status;
+	pid_t		pid;
+
+	MemSet(&worker, 0, sizeof(BackgroundWorker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_DEFAULT_RESTART_INTERVAL;
+	strcpy(worker.bgw_library_name, "pg_prewarm");
+	strcpy(worker.bgw_function_name, "autoprewarm_main");
+	strcpy(worker.bgw_name, "autoprewarm");
+
+	if (process_shared_preload_libraries_in_progress)
+	{
+		RegisterBackgroundWorker(&worker);
+		return;
+	}
+
+	/* must set notify PID to wait for startup */
+	worker.bgw_notify_pid = MyProcPid;
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not register background process"),
+				 errhint("You may need to increase max_worker_processes.")));
+
+	status = WaitForBackgroundWorkerStartup(handle, &pid);
+	if (status != BGWH_STARTED)
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not start background process"),
+				 errhint("More details may be available in the server log.")));
+}
+
+/*
+ * Are the two blocks of the same relation fork?
+ */
+static bool
+apw_same_fork(const BlockInfoRecord *a, const BlockInfoRecord *b)
+{
+	return a->database == b->database &&
+		a->tablespace == b->tablespace &&
+		a->filenode == b->filenode &&
+		a->forknum == b->forknum;
+}
+
+/*
+ * Compare function for sorting BlockInfoRecords by database, tablespace,
+ * file, fork and block, so that each file is read in order.
+ */
+#define cmp_member_elem(fld)	\
+do { \
+	if (a->fld < b->fld)		\
+		return -1;				\
+	else if (a->fld > b->fld)	\
+		return 1;				\
+} while(0)
+
+static int
+apw_compare_blockinfo(const void *p, const void *q)
+{
+	const BlockInfoRecord *a = (const BlockInfoRecord *) p;
+	const BlockInfoRecord *b = (const BlockInfoRecord *) q;
+
+	cmp_member_elem(database);
+	cmp_member_elem(tablespace);
+	cmp_member_elem(filenode);
+	cmp_member_elem(forknum);
+	cmp_member_elem(blocknum);
+
+	return 0;
+}
+
+/*
+ * Signal handler for SIGTERM
+ */
+static void
+apw_sigterm_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sigterm = true;
+
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Signal handler for SIGHUP
+ */
+static void
+apw_sighup_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
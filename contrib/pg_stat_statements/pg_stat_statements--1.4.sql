@@ -1,4 +1,4 @@
-/* contrib/pg_stat_statements/pg_stat_statements--1.3.sql */
+/* contrib/pg_stat_statements/pg_stat_statements--1.4.sql */
 
 -- complain if script is sourced in psql, rather than via CREATE EXTENSION
 \echo Use "CREATE EXTENSION pg_stat_statements" to load this file. \quit
@@ -32,10 +32,17 @@ CREATE FUNCTION pg_stat_statements(IN showtext boolean,
     OUT temp_blks_read int8,
     OUT temp_blks_written int8,
     OUT blk_read_time float8,
-    OUT blk_write_time float8
+    OUT blk_write_time float8,
+    OUT plans int8,
+    OUT total_plan_time float8,
+    OUT wal_records int8,
+    OUT wal_bytes int8,
+    OUT p50_time float8,
+    OUT p95_time float8,
+    OUT p99_time float8
 )
 RETURNS SETOF record
-AS 'MODULE_PATHNAME', 'pg_stat_statements_1_3'
+AS 'MODULE_PATHNAME', 'pg_stat_statements_1_4'
 LANGUAGE C STRICT VOLATILE;
 
 -- Register a view on the function for ease of use.
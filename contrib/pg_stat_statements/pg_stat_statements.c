@@ -33,6 +33,13 @@
  * strings in a temporary external query-texts file.  Offsets into this
  * file are kept in shared memory.
  *
+ * To keep the shared state off the hot path, each backend accumulates the
+ * counters of the statements it runs in a local hashtable and merges them
+ * into the shared entries at most once per PGSS_FLUSH_INTERVAL, and when it
+ * exits.  A statement that has not been seen since the last merge still
+ * takes the shared lock once, to make sure its shared entry (and query text)
+ * exists; after that, further executions touch only local memory.
+ *
  * Note about locking issues: to create or delete an entry in the shared
  * hashtable, one must hold pgss->lock exclusively.  Modifying any field
  * in an entry except the counters requires the same.  To look up an entry,
@@ -43,9 +50,11 @@
  * query-text file) should be accessed only while holding either the
  * pgss->mutex spinlock, or exclusive lock on pgss->lock.  We use the mutex to
  * allow reserving file space while holding only shared lock on pgss->lock.
- * Rewriting the entire external query-text file, eg for garbage collection,
- * requires holding pgss->lock exclusively; this allows individual entries
- * in the file to be read or written while holding only shared lock.
+ * Rewriting the entire external query-text file requires holding pgss->lock
+ * exclusively; this allows individual entries in the file to be read or
+ * written while holding only shared lock.  Garbage collection writes the
+ * compacted copy under shared lock, and takes the exclusive lock only to
+ * swap it into place.
  *
  *
  * Copyright (c) 2008-2015, PostgreSQL Global Development Group
@@ -62,10 +71,12 @@
 #include <unistd.h>
 
 #include "access/hash.h"
+#include "access/xact.h"
 #include "executor/instrument.h"
 #include "funcapi.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "optimizer/planner.h"
 #include "parser/analyze.h"
 #include "parser/parsetree.h"
 #include "parser/scanner.h"
@@ -76,6 +87,7 @@
 #include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 
 PG_MODULE_MAGIC;
 
@@ -93,7 +105,7 @@ PG_MODULE_MAGIC;
 #define PGSS_TEXT_FILE	PG_STAT_TMP_DIR "/pgss_query_texts.stat"
 
 /* Magic number identifying the stats file format */
-static const uint32 PGSS_FILE_HEADER = 0x20140125;
+static const uint32 PGSS_FILE_HEADER = 0x20161015;
 
 /* PostgreSQL major version number, changes in which invalidate all entries */
 static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
@@ -109,6 +121,18 @@ static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
 
 #define JUMBLE_SIZE				1024	/* query serialization buffer size */
 
+#define PGSS_FLUSH_INTERVAL		500 /* msec between merges of local counters */
+#define PGSS_LOCAL_MAX			1024	/* merge early past this many statements */
+
+/*
+ * Execution times are also counted in a histogram, from which percentiles
+ * are estimated.  Bucket 0 holds times below PGSS_HIST_FIRST_BOUND; each
+ * following bucket is twice as wide as the one before, and the last one is
+ * open-ended.  With 32 buckets the last bound is about 3 hours.
+ */
+#define PGSS_HIST_BUCKETS		32
+#define PGSS_HIST_FIRST_BOUND	(0.01)	/* msec */
+
 /*
  * Extension version number, for supporting older extension versions' objects
  */
@@ -117,7 +141,8 @@ typedef enum pgssVersion
 	PGSS_V1_0 = 0,
 	PGSS_V1_1,
 	PGSS_V1_2,
-	PGSS_V1_3
+	PGSS_V1_3,
+	PGSS_V1_4
 } pgssVersion;
 
 /*
@@ -155,6 +180,11 @@ typedef struct Counters
 	int64		temp_blks_written;		/* # of temp blocks written */
 	double		blk_read_time;	/* time spent reading, in msec */
 	double		blk_write_time; /* time spent writing, in msec */
+	int64		plans;			/* # of times planned */
+	double		total_plan_time;	/* total planning time, in msec */
+	int64		wal_records;	/* # of WAL records generated */
+	int64		wal_bytes;		/* # of WAL bytes generated */
+	int64		hist[PGSS_HIST_BUCKETS];	/* execution time histogram */
 	double		usage;			/* usage factor */
 } Counters;
 
@@ -175,6 +205,18 @@ typedef struct pgssEntry
 	slock_t		mutex;			/* protects the counters only */
 } pgssEntry;
 
+/*
+ * Counters accumulated by this backend and not yet merged into the shared
+ * entry.  "verified" means we have seen the shared entry since the last
+ * merge; planning-only counts may be recorded before that.
+ */
+typedef struct pgssLocalEntry
+{
+	pgssHashKey key;			/* hash key of entry - MUST BE FIRST */
+	bool		verified;		/* shared entry known to exist */
+	Counters	counters;		/* pending counts */
+} pgssLocalEntry;
+
 /*
  * Global shared state
  */
@@ -187,6 +229,9 @@ typedef struct pgssSharedState
 	Size		extent;			/* current extent of query file */
 	int			n_writers;		/* number of active writers to query file */
 	int			gc_count;		/* query file garbage collection cycle count */
+	bool		gc_in_progress; /* is some process collecting garbage? */
+	uint64		generation;		/* bumped when entries are added or removed;
+								 * changed only under exclusive lock */
 } pgssSharedState;
 
 /*
@@ -228,6 +273,7 @@ static int	nested_level = 0;
 /* Saved hook values in case of unload */
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
+static planner_hook_type prev_planner_hook = NULL;
 static ExecutorStart_hook_type prev_ExecutorStart = NULL;
 static ExecutorRun_hook_type prev_ExecutorRun = NULL;
 static ExecutorFinish_hook_type prev_ExecutorFinish = NULL;
@@ -238,6 +284,10 @@ static ProcessUtility_hook_type prev_ProcessUtility = NULL;
 static pgssSharedState *pgss = NULL;
 static HTAB *pgss_hash = NULL;
 
+/* Counters not yet merged into shared memory, and when we last merged */
+static HTAB *pgss_local_hash = NULL;
+static TimestampTz pgss_last_flush = 0;
+
 /*---- GUC variables ----*/
 
 typedef enum
@@ -258,6 +308,7 @@ static const struct config_enum_entry track_options[] =
 static int	pgss_max;			/* max # statements to track */
 static int	pgss_track;			/* tracking level */
 static bool pgss_track_utility; /* whether to track utility commands */
+static bool pgss_track_planning;	/* whether to track planning time */
 static bool pgss_save;			/* whether to save stats across shutdown */
 
 
@@ -281,11 +332,14 @@ void		_PG_fini(void);
 PG_FUNCTION_INFO_V1(pg_stat_statements_reset);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_2);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_3);
+PG_FUNCTION_INFO_V1(pg_stat_statements_1_4);
 PG_FUNCTION_INFO_V1(pg_stat_statements);
 
 static void pgss_shmem_startup(void);
 static void pgss_shmem_shutdown(int code, Datum arg);
 static void pgss_post_parse_analyze(ParseState *pstate, Query *query);
+static PlannedStmt *pgss_planner(Query *parse, int cursorOptions,
+			 ParamListInfo boundParams);
 static void pgss_ExecutorStart(QueryDesc *queryDesc, int eflags);
 static void pgss_ExecutorRun(QueryDesc *queryDesc,
 				 ScanDirection direction,
@@ -302,6 +356,14 @@ static void pgss_store(const char *query, uint32 queryId,
 		   double total_time, uint64 rows,
 		   const BufferUsage *bufusage,
 		   pgssJumbleState *jstate);
+static void pgss_store_plan(uint32 queryId, double plan_time);
+static pgssLocalEntry *pgss_local_entry(pgssHashKey *key);
+static void counters_merge(Counters *dst, const Counters *src);
+static void pgss_flush_local(void);
+static void pgss_flush_local_if_due(void);
+static void pgss_backend_shutdown(int code, Datum arg);
+static int	hist_bucket(double msec);
+static double hist_percentile(const Counters *c, double fraction);
 static void pg_stat_statements_internal(FunctionCallInfo fcinfo,
 							pgssVersion api_version,
 							bool showtext);
@@ -385,6 +447,17 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("pg_stat_statements.track_planning",
+			"Selects whether planning time is tracked by pg_stat_statements.",
+							 NULL,
+							 &pgss_track_planning,
+							 true,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	DefineCustomBoolVariable("pg_stat_statements.save",
 			   "Save pg_stat_statements statistics across server shutdowns.",
 							 NULL,
@@ -413,6 +486,8 @@ _PG_init(void)
 	shmem_startup_hook = pgss_shmem_startup;
 	prev_post_parse_analyze_hook = post_parse_analyze_hook;
 	post_parse_analyze_hook = pgss_post_parse_analyze;
+	prev_planner_hook = planner_hook;
+	planner_hook = pgss_planner;
 	prev_ExecutorStart = ExecutorStart_hook;
 	ExecutorStart_hook = pgss_ExecutorStart;
 	prev_ExecutorRun = ExecutorRun_hook;
@@ -434,6 +509,7 @@ _PG_fini(void)
 	/* Uninstall hooks. */
 	shmem_startup_hook = prev_shmem_startup_hook;
 	post_parse_analyze_hook = prev_post_parse_analyze_hook;
+	planner_hook = prev_planner_hook;
 	ExecutorStart_hook = prev_ExecutorStart;
 	ExecutorRun_hook = prev_ExecutorRun;
 	ExecutorFinish_hook = prev_ExecutorFinish;
@@ -487,6 +563,8 @@ pgss_shmem_startup(void)
 		pgss->extent = 0;
 		pgss->n_writers = 0;
 		pgss->gc_count = 0;
+		pgss->gc_in_progress = false;
+		pgss->generation = 0;
 	}
 
 	memset(&info, 0, sizeof(info));
@@ -519,8 +597,9 @@ pgss_shmem_startup(void)
 	 * processes running when this code is reached.
 	 */
 
-	/* Unlink query text file possibly left over from crash */
+	/* Unlink query text files possibly left over from crash */
 	unlink(PGSS_TEXT_FILE);
+	unlink(PGSS_TEXT_FILE ".gc");
 
 	/* Allocate new query text temp file */
 	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
@@ -828,6 +907,58 @@ pgss_post_parse_analyze(ParseState *pstate, Query *query)
 				   &jstate);
 }
 
+/*
+ * Planner hook: track planning time of optimizable statements
+ */
+static PlannedStmt *
+pgss_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
+{
+	PlannedStmt *result;
+
+	/*
+	 * As in the executor hooks, a queryId of zero marks a statement we
+	 * account for at the utility level.  Anything executed while planning
+	 * (eg, constant-folding of functions) counts as nested.
+	 */
+	if (pgss_track_planning && pgss_enabled() && parse->queryId != 0)
+	{
+		instr_time	start;
+		instr_time	duration;
+
+		INSTR_TIME_SET_CURRENT(start);
+
+		nested_level++;
+		PG_TRY();
+		{
+			if (prev_planner_hook)
+				result = prev_planner_hook(parse, cursorOptions, boundParams);
+			else
+				result = standard_planner(parse, cursorOptions, boundParams);
+			nested_level--;
+		}
+		PG_CATCH();
+		{
+			nested_level--;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+
+		pgss_store_plan(parse->queryId, INSTR_TIME_GET_MILLISEC(duration));
+	}
+	else
+	{
+		if (prev_planner_hook)
+			result = prev_planner_hook(parse, cursorOptions, boundParams);
+		else
+			result = standard_planner(parse, cursorOptions, boundParams);
+	}
+
+	return result;
+}
+
 /*
  * ExecutorStart hook: start up tracking if needed
  */
@@ -1032,6 +1163,10 @@ pgss_ProcessUtility(Node *parsetree, const char *queryString,
 			pgBufferUsage.temp_blks_read - bufusage_start.temp_blks_read;
 		bufusage.temp_blks_written =
 			pgBufferUsage.temp_blks_written - bufusage_start.temp_blks_written;
+		bufusage.wal_records =
+			pgBufferUsage.wal_records - bufusage_start.wal_records;
+		bufusage.wal_bytes =
+			pgBufferUsage.wal_bytes - bufusage_start.wal_bytes;
 		bufusage.blk_read_time = pgBufferUsage.blk_read_time;
 		INSTR_TIME_SUBTRACT(bufusage.blk_read_time, bufusage_start.blk_read_time);
 		bufusage.blk_write_time = pgBufferUsage.blk_write_time;
@@ -1107,6 +1242,9 @@ pgss_hash_string(const char *str)
  * If jstate is not NULL then we're trying to create an entry for which
  * we have no statistics as yet; we just want to record the normalized
  * query string.  total_time, rows, bufusage are ignored in this case.
+ *
+ * Otherwise the counts are added to this backend's pending counters, to be
+ * merged into the shared entry later by pgss_flush_local().
  */
 static void
 pgss_store(const char *query, uint32 queryId,
@@ -1116,9 +1254,11 @@ pgss_store(const char *query, uint32 queryId,
 {
 	pgssHashKey key;
 	pgssEntry  *entry;
+	pgssLocalEntry *local = NULL;
 	char	   *norm_query = NULL;
 	int			encoding = GetDatabaseEncoding();
 	int			query_len;
+	bool		do_gc = false;
 
 	Assert(query != NULL);
 
@@ -1126,13 +1266,24 @@ pgss_store(const char *query, uint32 queryId,
 	if (!pgss || !pgss_hash)
 		return;
 
-	query_len = strlen(query);
-
 	/* Set up key for hashtable search */
 	key.userid = GetUserId();
 	key.dbid = MyDatabaseId;
 	key.queryid = queryId;
 
+	/*
+	 * If we've already seen the shared entry since the last merge, there's
+	 * no need to look at shared memory at all.
+	 */
+	if (!jstate)
+	{
+		local = pgss_local_entry(&key);
+		if (local->verified)
+			goto accumulate;
+	}
+
+	query_len = strlen(query);
+
 	/* Lookup the hash table entry with shared lock. */
 	LWLockAcquire(pgss->lock, LW_SHARED);
 
@@ -1144,7 +1295,6 @@ pgss_store(const char *query, uint32 queryId,
 		Size		query_offset;
 		int			gc_count;
 		bool		stored;
-		bool		do_gc;
 
 		/*
 		 * Create a new, normalized query string if caller asked.  We don't
@@ -1190,83 +1340,330 @@ pgss_store(const char *query, uint32 queryId,
 
 		/* If we failed to write to the text file, give up */
 		if (!stored)
+		{
+			LWLockRelease(pgss->lock);
 			goto done;
+		}
 
 		/* OK to create a new hashtable entry */
 		entry = entry_alloc(&key, query_offset, query_len, encoding,
 							jstate != NULL);
+	}
+
+	LWLockRelease(pgss->lock);
 
-		/* If needed, perform garbage collection while exclusive lock held */
-		if (do_gc)
-			gc_qtexts();
+	/*
+	 * If needed, perform garbage collection.  This takes the lock by itself,
+	 * and only briefly in exclusive mode.
+	 */
+	if (do_gc)
+		gc_qtexts();
+
+	/* Nothing more to do if we were only recording the query text */
+	if (jstate)
+		goto done;
+
+	local->verified = true;
+
+accumulate:
+	{
+		Counters	c;
+
+		memset(&c, 0, sizeof(Counters));
+		c.calls = 1;
+		c.total_time = total_time;
+		c.min_time = total_time;
+		c.max_time = total_time;
+		c.mean_time = total_time;
+		c.rows = rows;
+		c.shared_blks_hit = bufusage->shared_blks_hit;
+		c.shared_blks_read = bufusage->shared_blks_read;
+		c.shared_blks_dirtied = bufusage->shared_blks_dirtied;
+		c.shared_blks_written = bufusage->shared_blks_written;
+		c.local_blks_hit = bufusage->local_blks_hit;
+		c.local_blks_read = bufusage->local_blks_read;
+		c.local_blks_dirtied = bufusage->local_blks_dirtied;
+		c.local_blks_written = bufusage->local_blks_written;
+		c.temp_blks_read = bufusage->temp_blks_read;
+		c.temp_blks_written = bufusage->temp_blks_written;
+		c.blk_read_time = INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
+		c.blk_write_time = INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
+		c.wal_records = bufusage->wal_records;
+		c.wal_bytes = bufusage->wal_bytes;
+		c.hist[hist_bucket(total_time)] = 1;
+		c.usage = USAGE_EXEC(total_time);
+
+		counters_merge(&local->counters, &c);
 	}
 
-	/* Increment the counts, except when jstate is not NULL */
-	if (!jstate)
+	pgss_flush_local_if_due();
+
+done:
+	/* We postpone this clean-up until we're out of the lock */
+	if (norm_query)
+		pfree(norm_query);
+}
+
+/*
+ * Store the planning time of a statement.
+ *
+ * The planner doesn't have the query text at hand, so we can't create the
+ * shared entry here; the counts are just kept locally, and are dropped at
+ * merge time if nobody has created the entry meanwhile.  Normally the
+ * execution of the same statement will have done that.
+ */
+static void
+pgss_store_plan(uint32 queryId, double plan_time)
+{
+	pgssHashKey key;
+	pgssLocalEntry *local;
+
+	/* Safety check... */
+	if (!pgss || !pgss_hash)
+		return;
+
+	key.userid = GetUserId();
+	key.dbid = MyDatabaseId;
+	key.queryid = queryId;
+
+	local = pgss_local_entry(&key);
+	local->counters.plans += 1;
+	local->counters.total_plan_time += plan_time;
+
+	pgss_flush_local_if_due();
+}
+
+/*
+ * Find or create this backend's pending counters for a statement.
+ */
+static pgssLocalEntry *
+pgss_local_entry(pgssHashKey *key)
+{
+	pgssLocalEntry *local;
+	bool		found;
+
+	if (pgss_local_hash == NULL)
 	{
-		/*
-		 * Grab the spinlock while updating the counters (see comment about
-		 * locking rules at the head of the file)
-		 */
-		volatile pgssEntry *e = (volatile pgssEntry *) entry;
+		HASHCTL		info;
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(pgssHashKey);
+		info.entrysize = sizeof(pgssLocalEntry);
+		info.hcxt = TopMemoryContext;
+		pgss_local_hash = hash_create("pg_stat_statements local hash",
+									  64, &info,
+									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		/* Make sure the last counts are merged when we go away */
+		before_shmem_exit(pgss_backend_shutdown, (Datum) 0);
+		pgss_last_flush = GetCurrentTimestamp();
+	}
 
-		SpinLockAcquire(&e->mutex);
+	local = (pgssLocalEntry *) hash_search(pgss_local_hash, key,
+										   HASH_ENTER, &found);
+	if (!found)
+	{
+		local->verified = false;
+		memset(&local->counters, 0, sizeof(Counters));
+	}
 
-		/* "Unstick" entry if it was previously sticky */
-		if (e->counters.calls == 0)
-			e->counters.usage = USAGE_INIT;
+	return local;
+}
 
-		e->counters.calls += 1;
-		e->counters.total_time += total_time;
-		if (e->counters.calls == 1)
+/*
+ * Add the counts in src to those in dst.
+ *
+ * The execution time statistics are combined using the pairwise form of
+ * Welford's method (Chan et al.), so that merging a single execution gives
+ * exactly the classic running update.
+ */
+static void
+counters_merge(Counters *dst, const Counters *src)
+{
+	int			i;
+
+	if (src->calls > 0)
+	{
+		if (dst->calls == 0)
 		{
-			e->counters.min_time = total_time;
-			e->counters.max_time = total_time;
-			e->counters.mean_time = total_time;
+			dst->min_time = src->min_time;
+			dst->max_time = src->max_time;
+			dst->mean_time = src->mean_time;
+			dst->sum_var_time = src->sum_var_time;
 		}
 		else
+		{
+			double		n = (double) (dst->calls + src->calls);
+			double		delta = src->mean_time - dst->mean_time;
+
+			dst->mean_time += delta * src->calls / n;
+			dst->sum_var_time += src->sum_var_time +
+				delta * delta * dst->calls * src->calls / n;
+			if (dst->min_time > src->min_time)
+				dst->min_time = src->min_time;
+			if (dst->max_time < src->max_time)
+				dst->max_time = src->max_time;
+		}
+		dst->calls += src->calls;
+	}
+
+	dst->total_time += src->total_time;
+	dst->rows += src->rows;
+	dst->shared_blks_hit += src->shared_blks_hit;
+	dst->shared_blks_read += src->shared_blks_read;
+	dst->shared_blks_dirtied += src->shared_blks_dirtied;
+	dst->shared_blks_written += src->shared_blks_written;
+	dst->local_blks_hit += src->local_blks_hit;
+	dst->local_blks_read += src->local_blks_read;
+	dst->local_blks_dirtied += src->local_blks_dirtied;
+	dst->local_blks_written += src->local_blks_written;
+	dst->temp_blks_read += src->temp_blks_read;
+	dst->temp_blks_written += src->temp_blks_written;
+	dst->blk_read_time += src->blk_read_time;
+	dst->blk_write_time += src->blk_write_time;
+	dst->plans += src->plans;
+	dst->total_plan_time += src->total_plan_time;
+	dst->wal_records += src->wal_records;
+	dst->wal_bytes += src->wal_bytes;
+	for (i = 0; i < PGSS_HIST_BUCKETS; i++)
+		dst->hist[i] += src->hist[i];
+	dst->usage += src->usage;
+}
+
+/*
+ * Merge this backend's pending counters into the shared entries.
+ *
+ * Pending counts whose shared entry has gone away (deallocated, or removed by
+ * a reset) are discarded.  Either way the local entries are removed, so the
+ * next execution of each statement checks the shared entry again.
+ */
+static void
+pgss_flush_local(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	pgssLocalEntry *local;
+
+	if (!pgss || !pgss_hash || pgss_local_hash == NULL)
+		return;
+
+	pgss_last_flush = GetCurrentTimestamp();
+
+	if (hash_get_num_entries(pgss_local_hash) == 0)
+		return;
+
+	LWLockAcquire(pgss->lock, LW_SHARED);
+
+	hash_seq_init(&hash_seq, pgss_local_hash);
+	while ((local = hash_seq_search(&hash_seq)) != NULL)
+	{
+		pgssEntry  *entry;
+
+		entry = (pgssEntry *) hash_search(pgss_hash, &local->key,
+										  HASH_FIND, NULL);
+		if (entry)
 		{
 			/*
-			 * Welford's method for accurately computing variance. See
-			 * <http://www.johndcook.com/blog/standard_deviation/>
+			 * Grab the spinlock while updating the counters (see comment
+			 * about locking rules at the head of the file)
 			 */
-			double		old_mean = e->counters.mean_time;
-
-			e->counters.mean_time +=
-				(total_time - old_mean) / e->counters.calls;
-			e->counters.sum_var_time +=
-				(total_time - old_mean) * (total_time - e->counters.mean_time);
-
-			/* calculate min and max time */
-			if (e->counters.min_time > total_time)
-				e->counters.min_time = total_time;
-			if (e->counters.max_time < total_time)
-				e->counters.max_time = total_time;
+			volatile pgssEntry *e = (volatile pgssEntry *) entry;
+
+			SpinLockAcquire(&e->mutex);
+
+			/* "Unstick" entry if it was previously sticky */
+			if (e->counters.calls == 0 && local->counters.calls > 0)
+				e->counters.usage = USAGE_INIT;
+
+			counters_merge((Counters *) &e->counters, &local->counters);
+
+			SpinLockRelease(&e->mutex);
 		}
-		e->counters.rows += rows;
-		e->counters.shared_blks_hit += bufusage->shared_blks_hit;
-		e->counters.shared_blks_read += bufusage->shared_blks_read;
-		e->counters.shared_blks_dirtied += bufusage->shared_blks_dirtied;
-		e->counters.shared_blks_written += bufusage->shared_blks_written;
-		e->counters.local_blks_hit += bufusage->local_blks_hit;
-		e->counters.local_blks_read += bufusage->local_blks_read;
-		e->counters.local_blks_dirtied += bufusage->local_blks_dirtied;
-		e->counters.local_blks_written += bufusage->local_blks_written;
-		e->counters.temp_blks_read += bufusage->temp_blks_read;
-		e->counters.temp_blks_written += bufusage->temp_blks_written;
-		e->counters.blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
-		e->counters.blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
-		e->counters.usage += USAGE_EXEC(total_time);
-
-		SpinLockRelease(&e->mutex);
+
+		hash_search(pgss_local_hash, &local->key, HASH_REMOVE, NULL);
 	}
 
-done:
 	LWLockRelease(pgss->lock);
+}
 
-	/* We postpone this clean-up until we're out of the lock */
-	if (norm_query)
-		pfree(norm_query);
+/*
+ * Merge pending counters if enough time has passed since the last merge,
+ * or if there are many of them.
+ */
+static void
+pgss_flush_local_if_due(void)
+{
+	if (hash_get_num_entries(pgss_local_hash) >= PGSS_LOCAL_MAX ||
+		TimestampDifferenceExceeds(pgss_last_flush, GetCurrentTimestamp(),
+								   PGSS_FLUSH_INTERVAL))
+		pgss_flush_local();
+}
+
+/*
+ * before_shmem_exit hook: merge the last pending counters.
+ */
+static void
+pgss_backend_shutdown(int code, Datum arg)
+{
+	pgss_flush_local();
+}
+
+/*
+ * Find the histogram bucket for an execution time.
+ */
+static int
+hist_bucket(double msec)
+{
+	int			bucket = 0;
+	double		bound = PGSS_HIST_FIRST_BOUND;
+
+	while (bucket < PGSS_HIST_BUCKETS - 1 && msec >= bound)
+	{
+		bucket++;
+		bound *= 2;
+	}
+
+	return bucket;
+}
+
+/*
+ * Estimate a percentile of execution time from the histogram.
+ *
+ * We find the bucket holding the requested rank and interpolate linearly
+ * within it, after clamping the bucket's bounds to the observed minimum and
+ * maximum; the estimate is therefore never outside the observed range.
+ */
+static double
+hist_percentile(const Counters *c, double fraction)
+{
+	int64		target;
+	int64		seen = 0;
+	int			i;
+
+	target = (int64) ceil(fraction * c->calls);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0; i < PGSS_HIST_BUCKETS; i++)
+	{
+		if (c->hist[i] > 0 && seen + c->hist[i] >= target)
+		{
+			double		lo;
+			double		hi;
+
+			lo = (i == 0) ? 0.0 : ldexp(PGSS_HIST_FIRST_BOUND, i - 1);
+			hi = (i == PGSS_HIST_BUCKETS - 1) ? c->max_time :
+				ldexp(PGSS_HIST_FIRST_BOUND, i);
+			lo = Max(lo, c->min_time);
+			hi = Min(hi, c->max_time);
+			if (hi < lo)
+				hi = lo;
+
+			return lo + (hi - lo) * (target - seen) / c->hist[i];
+		}
+		seen += c->hist[i];
+	}
+
+	return c->max_time;
 }
 
 /*
@@ -1288,7 +1685,8 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
 #define PG_STAT_STATEMENTS_COLS_V1_1	18
 #define PG_STAT_STATEMENTS_COLS_V1_2	19
 #define PG_STAT_STATEMENTS_COLS_V1_3	23
-#define PG_STAT_STATEMENTS_COLS			23		/* maximum of above */
+#define PG_STAT_STATEMENTS_COLS_V1_4	30
+#define PG_STAT_STATEMENTS_COLS			30		/* maximum of above */
 
 /*
  * Retrieve statement statistics.
@@ -1300,6 +1698,16 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
  * expected API version is identified by embedding it in the C name of the
  * function.  Unfortunately we weren't bright enough to do that for 1.1.
  */
+Datum
+pg_stat_statements_1_4(PG_FUNCTION_ARGS)
+{
+	bool		showtext = PG_GETARG_BOOL(0);
+
+	pg_stat_statements_internal(fcinfo, PGSS_V1_4, showtext);
+
+	return (Datum) 0;
+}
+
 Datum
 pg_stat_statements_1_3(PG_FUNCTION_ARGS)
 {
@@ -1403,6 +1811,10 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			if (api_version != PGSS_V1_3)
 				elog(ERROR, "incorrect number of output arguments");
 			break;
+		case PG_STAT_STATEMENTS_COLS_V1_4:
+			if (api_version != PGSS_V1_4)
+				elog(ERROR, "incorrect number of output arguments");
+			break;
 		default:
 			elog(ERROR, "incorrect number of output arguments");
 	}
@@ -1414,6 +1826,9 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 
 	MemoryContextSwitchTo(oldcontext);
 
+	/* Make our own pending counts visible */
+	pgss_flush_local();
+
 	/*
 	 * We'd like to load the query text file (if needed) while not holding any
 	 * lock on pgss->lock.  In the worst case we'll have to do this again
@@ -1599,11 +2014,22 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			values[i++] = Float8GetDatumFast(tmp.blk_read_time);
 			values[i++] = Float8GetDatumFast(tmp.blk_write_time);
 		}
+		if (api_version >= PGSS_V1_4)
+		{
+			values[i++] = Int64GetDatumFast(tmp.plans);
+			values[i++] = Float8GetDatumFast(tmp.total_plan_time);
+			values[i++] = Int64GetDatumFast(tmp.wal_records);
+			values[i++] = Int64GetDatumFast(tmp.wal_bytes);
+			values[i++] = Float8GetDatum(hist_percentile(&tmp, 0.50));
+			values[i++] = Float8GetDatum(hist_percentile(&tmp, 0.95));
+			values[i++] = Float8GetDatum(hist_percentile(&tmp, 0.99));
+		}
 
 		Assert(i == (api_version == PGSS_V1_0 ? PG_STAT_STATEMENTS_COLS_V1_0 :
 					 api_version == PGSS_V1_1 ? PG_STAT_STATEMENTS_COLS_V1_1 :
 					 api_version == PGSS_V1_2 ? PG_STAT_STATEMENTS_COLS_V1_2 :
 					 api_version == PGSS_V1_3 ? PG_STAT_STATEMENTS_COLS_V1_3 :
+					 api_version == PGSS_V1_4 ? PG_STAT_STATEMENTS_COLS_V1_4 :
 					 -1 /* fail if you forget to update this assert */ ));
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -1678,6 +2104,7 @@ entry_alloc(pgssHashKey *key, Size query_offset, int query_len, int encoding,
 		entry->query_offset = query_offset;
 		entry->query_len = query_len;
 		entry->encoding = encoding;
+		pgss->generation++;
 	}
 
 	return entry;
@@ -1771,6 +2198,7 @@ entry_dealloc(void)
 	{
 		hash_search(pgss_hash, &entries[i]->key, HASH_REMOVE, NULL);
 	}
+	pgss->generation++;
 
 	pfree(entries);
 }
@@ -2017,7 +2445,14 @@ need_gc_qtexts(void)
  * becomes unreasonably large, with no other method of compaction likely to
  * occur in the foreseeable future.
  *
- * The caller must hold an exclusive lock on pgss->lock.
+ * The caller must not hold pgss->lock.  The compacted copy is written to a
+ * side file while we hold only shared lock, so that other sessions can go on
+ * recording statements meanwhile (texts they append to the old file in the
+ * interim are rewritten by them, as they notice the gc_count change).  We
+ * take the exclusive lock just long enough to rename the copy into place and
+ * adopt the new offsets.  If any entry was added or removed while we weren't
+ * looking, the copy is stale; it is thrown away and a later call retries.
+ * Only one process collects garbage at a time; others return immediately.
  *
  * At the first sign of trouble we unlink the query text file to get a clean
  * slate (although existing statistics are retained), rather than risk
@@ -2026,182 +2461,283 @@ need_gc_qtexts(void)
 static void
 gc_qtexts(void)
 {
-	char	   *qbuffer;
+	char	   *qbuffer = NULL;
 	Size		qbuffer_size;
 	FILE	   *qfile = NULL;
 	HASH_SEQ_STATUS hash_seq;
 	pgssEntry  *entry;
+	Size	   *offsets;
 	Size		extent;
 	int			nentries;
+	int			i;
+	uint64		generation;
+	bool		failed = false;
 
-	/*
-	 * When called from pgss_store, some other session might have proceeded
-	 * with garbage collection in the no-lock-held interim of lock strength
-	 * escalation.  Check once more that this is actually necessary.
-	 */
-	if (!need_gc_qtexts())
-		return;
-
-	/*
-	 * Load the old texts file.  If we fail (out of memory, for instance),
-	 * invalidate query texts.  Hopefully this is rare.  It might seem better
-	 * to leave things alone on an OOM failure, but the problem is that the
-	 * file is only going to get bigger; hoping for a future non-OOM result is
-	 * risky and can easily lead to complete denial of service.
-	 */
-	qbuffer = qtext_load_file(&qbuffer_size);
-	if (qbuffer == NULL)
-		goto gc_fail;
+	/* Allocate this first, so an error can't leave gc_in_progress set */
+	offsets = (Size *) palloc(pgss_max * sizeof(Size));
 
-	/*
-	 * We overwrite the query texts file in place, so as to reduce the risk of
-	 * an out-of-disk-space failure.  Since the file is guaranteed not to get
-	 * larger, this should always work on traditional filesystems; though we
-	 * could still lose on copy-on-write filesystems.
-	 */
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
-	if (qfile == NULL)
+	/* Claim the collection for ourselves */
 	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not write pg_stat_statement file \"%s\": %m",
-						PGSS_TEXT_FILE)));
-		goto gc_fail;
-	}
+		volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
+		bool		busy;
 
-	extent = 0;
-	nentries = 0;
+		SpinLockAcquire(&s->mutex);
+		busy = s->gc_in_progress;
+		s->gc_in_progress = true;
+		SpinLockRelease(&s->mutex);
 
-	hash_seq_init(&hash_seq, pgss_hash);
-	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		if (busy)
+		{
+			pfree(offsets);
+			return;
+		}
+	}
+
+	PG_TRY();
 	{
-		int			query_len = entry->query_len;
-		char	   *qry = qtext_fetch(entry->query_offset,
-									  query_len,
-									  qbuffer,
-									  qbuffer_size);
+		LWLockAcquire(pgss->lock, LW_SHARED);
 
-		if (qry == NULL)
+		/*
+		 * Some other session might have collected garbage since our caller
+		 * looked.  Check once more that this is actually necessary.
+		 */
+		if (!need_gc_qtexts())
 		{
-			/* Trouble ... drop the text */
-			entry->query_offset = 0;
-			entry->query_len = -1;
-			/* entry will not be counted in mean query length computation */
-			continue;
+			LWLockRelease(pgss->lock);
+			goto done;
+		}
+
+		generation = pgss->generation;
+
+		/*
+		 * Load the old texts file.  If we fail (out of memory, for instance),
+		 * invalidate query texts.  Hopefully this is rare.  It might seem
+		 * better to leave things alone on an OOM failure, but the problem is
+		 * that the file is only going to get bigger; hoping for a future
+		 * non-OOM result is risky and can easily lead to complete denial of
+		 * service.
+		 */
+		qbuffer = qtext_load_file(&qbuffer_size);
+		if (qbuffer == NULL)
+		{
+			LWLockRelease(pgss->lock);
+			failed = true;
+			goto done;
 		}
 
-		if (fwrite(qry, 1, query_len + 1, qfile) != query_len + 1)
+		qfile = AllocateFile(PGSS_TEXT_FILE ".gc", PG_BINARY_W);
+		if (qfile == NULL)
 		{
 			ereport(LOG,
 					(errcode_for_file_access(),
 				  errmsg("could not write pg_stat_statement file \"%s\": %m",
-						 PGSS_TEXT_FILE)));
-			hash_seq_term(&hash_seq);
-			goto gc_fail;
+						 PGSS_TEXT_FILE ".gc")));
+			LWLockRelease(pgss->lock);
+			failed = true;
+			goto done;
 		}
 
-		entry->query_offset = extent;
-		extent += query_len + 1;
-		nentries++;
-	}
+		/*
+		 * Copy the live texts, remembering their new offsets in hash scan
+		 * order.  With no entries added or removed, a second scan visits them
+		 * in the same order.  A text we can't fetch is marked to be dropped.
+		 */
+		extent = 0;
+		nentries = 0;
+		i = 0;
 
-	/*
-	 * Truncate away any now-unused space.  If this fails for some odd reason,
-	 * we log it, but there's no need to fail.
-	 */
-	if (ftruncate(fileno(qfile), extent) != 0)
-		ereport(LOG,
-				(errcode_for_file_access(),
-			   errmsg("could not truncate pg_stat_statement file \"%s\": %m",
-					  PGSS_TEXT_FILE)));
+		hash_seq_init(&hash_seq, pgss_hash);
+		while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		{
+			int			query_len = entry->query_len;
+			char	   *qry = qtext_fetch(entry->query_offset,
+										  query_len,
+										  qbuffer,
+										  qbuffer_size);
 
-	if (FreeFile(qfile))
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not write pg_stat_statement file \"%s\": %m",
-						PGSS_TEXT_FILE)));
+			if (qry == NULL)
+			{
+				offsets[i++] = (Size) -1;
+				continue;
+			}
+
+			if (fwrite(qry, 1, query_len + 1, qfile) != query_len + 1)
+			{
+				ereport(LOG,
+						(errcode_for_file_access(),
+				  errmsg("could not write pg_stat_statement file \"%s\": %m",
+						 PGSS_TEXT_FILE ".gc")));
+				hash_seq_term(&hash_seq);
+				LWLockRelease(pgss->lock);
+				failed = true;
+				goto done;
+			}
+
+			offsets[i++] = extent;
+			extent += query_len + 1;
+			nentries++;
+		}
+
+		LWLockRelease(pgss->lock);
+
+		free(qbuffer);
+		qbuffer = NULL;
+
+		if (FreeFile(qfile))
+		{
+			ereport(LOG,
+					(errcode_for_file_access(),
+				  errmsg("could not write pg_stat_statement file \"%s\": %m",
+						 PGSS_TEXT_FILE ".gc")));
+			qfile = NULL;
+			failed = true;
+			goto done;
+		}
 		qfile = NULL;
-		goto gc_fail;
-	}
 
-	elog(DEBUG1, "pgss gc of queries file shrunk size from %zu to %zu",
-		 pgss->extent, extent);
+		/* Now swap the new file into place, if it's still accurate */
+		LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
 
-	/* Reset the shared extent pointer */
-	pgss->extent = extent;
+		if (pgss->generation == generation)
+		{
+			if (rename(PGSS_TEXT_FILE ".gc", PGSS_TEXT_FILE) != 0)
+			{
+				ereport(LOG,
+						(errcode_for_file_access(),
+						 errmsg("could not rename pg_stat_statement file \"%s\" to \"%s\": %m",
+								PGSS_TEXT_FILE ".gc", PGSS_TEXT_FILE)));
+				LWLockRelease(pgss->lock);
+				failed = true;
+				goto done;
+			}
 
-	/*
-	 * Also update the mean query length, to be sure that need_gc_qtexts()
-	 * won't still think we have a problem.
-	 */
-	if (nentries > 0)
-		pgss->mean_query_len = extent / nentries;
-	else
-		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
+			i = 0;
+			hash_seq_init(&hash_seq, pgss_hash);
+			while ((entry = hash_seq_search(&hash_seq)) != NULL)
+			{
+				if (offsets[i] == (Size) -1)
+				{
+					/* Trouble ... drop the text */
+					entry->query_offset = 0;
+					entry->query_len = -1;
+					/* entry will not be counted in mean query length */
+				}
+				else
+					entry->query_offset = offsets[i];
+				i++;
+			}
 
-	free(qbuffer);
+			elog(DEBUG1, "pgss gc of queries file shrunk size from %zu to %zu",
+				 pgss->extent, extent);
 
-	/*
-	 * OK, count a garbage collection cycle.  (Note: even though we have
-	 * exclusive lock on pgss->lock, we must take pgss->mutex for this, since
-	 * other processes may examine gc_count while holding only the mutex.
-	 * Also, we have to advance the count *after* we've rewritten the file,
-	 * else other processes might not realize they read a stale file.)
-	 */
-	record_gc_qtexts();
+			/* Reset the shared extent pointer */
+			pgss->extent = extent;
 
-	return;
+			/*
+			 * Also update the mean query length, to be sure that
+			 * need_gc_qtexts() won't still think we have a problem.
+			 */
+			if (nentries > 0)
+				pgss->mean_query_len = extent / nentries;
+			else
+				pgss->mean_query_len = ASSUMED_LENGTH_INIT;
+
+			/*
+			 * OK, count a garbage collection cycle.  (Note: even though we
+			 * have exclusive lock on pgss->lock, we must take pgss->mutex for
+			 * this, since other processes may examine gc_count while holding
+			 * only the mutex.  Also, we have to advance the count *after*
+			 * we've replaced the file, else other processes might not realize
+			 * they read a stale file.)
+			 */
+			record_gc_qtexts();
+		}
+		else
+			elog(DEBUG1, "pgss gc of queries file abandoned due to concurrent changes");
+
+		LWLockRelease(pgss->lock);
+
+done:
+		;
+	}
+	PG_CATCH();
+	{
+		volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
+
+		SpinLockAcquire(&s->mutex);
+		s->gc_in_progress = false;
+		SpinLockRelease(&s->mutex);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
 
-gc_fail:
 	/* clean up resources */
 	if (qfile)
 		FreeFile(qfile);
 	if (qbuffer)
 		free(qbuffer);
+	pfree(offsets);
+	(void) unlink(PGSS_TEXT_FILE ".gc");
 
-	/*
-	 * Since the contents of the external file are now uncertain, mark all
-	 * hashtable entries as having invalid texts.
-	 */
-	hash_seq_init(&hash_seq, pgss_hash);
-	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	if (failed)
 	{
-		entry->query_offset = 0;
-		entry->query_len = -1;
-	}
+		/*
+		 * Since the contents of the external file are now uncertain, mark all
+		 * hashtable entries as having invalid texts.
+		 */
+		LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
 
-	/*
-	 * Destroy the query text file and create a new, empty one
-	 */
-	(void) unlink(PGSS_TEXT_FILE);
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
-	if (qfile == NULL)
-		ereport(LOG,
-				(errcode_for_file_access(),
+		hash_seq_init(&hash_seq, pgss_hash);
+		while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		{
+			entry->query_offset = 0;
+			entry->query_len = -1;
+		}
+
+		/*
+		 * Destroy the query text file and create a new, empty one
+		 */
+		(void) unlink(PGSS_TEXT_FILE);
+		qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
+		if (qfile == NULL)
+			ereport(LOG,
+					(errcode_for_file_access(),
 			  errmsg("could not write new pg_stat_statement file \"%s\": %m",
 					 PGSS_TEXT_FILE)));
-	else
-		FreeFile(qfile);
+		else
+			FreeFile(qfile);
 
-	/* Reset the shared extent pointer */
-	pgss->extent = 0;
+		/* Reset the shared extent pointer */
+		pgss->extent = 0;
 
-	/* Reset mean_query_len to match the new state */
-	pgss->mean_query_len = ASSUMED_LENGTH_INIT;
+		/* Reset mean_query_len to match the new state */
+		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
 
-	/*
-	 * Bump the GC count even though we failed.
-	 *
-	 * This is needed to make concurrent readers of file without any lock on
-	 * pgss->lock notice existence of new version of file.  Once readers
-	 * subsequently observe a change in GC count with pgss->lock held, that
-	 * forces a safe reopen of file.  Writers also require that we bump here,
-	 * of course.  (As required by locking protocol, readers and writers don't
-	 * trust earlier file contents until gc_count is found unchanged after
-	 * pgss->lock acquired in shared or exclusive mode respectively.)
-	 */
-	record_gc_qtexts();
+		/*
+		 * Bump the GC count even though we failed.
+		 *
+		 * This is needed to make concurrent readers of file without any lock
+		 * on pgss->lock notice existence of new version of file.  Once
+		 * readers subsequently observe a change in GC count with pgss->lock
+		 * held, that forces a safe reopen of file.  Writers also require that
+		 * we bump here, of course.  (As required by locking protocol, readers
+		 * and writers don't trust earlier file contents until gc_count is
+		 * found unchanged after pgss->lock acquired in shared or exclusive
+		 * mode respectively.)
+		 */
+		record_gc_qtexts();
+
+		LWLockRelease(pgss->lock);
+	}
+
+	/* Let the next collection proceed */
+	{
+		volatile pgssSharedState *s = (volatile pgssSharedState *) pgss;
+
+		SpinLockAcquire(&s->mutex);
+		s->gc_in_progress = false;
+		SpinLockRelease(&s->mutex);
+	}
 }
 
 /*
@@ -2214,6 +2750,16 @@ entry_reset(void)
 	pgssEntry  *entry;
 	FILE	   *qfile;
 
+	/* Our own pending counts go too; other backends' will find no entry */
+	if (pgss_local_hash != NULL)
+	{
+		pgssLocalEntry *local;
+
+		hash_seq_init(&hash_seq, pgss_local_hash);
+		while ((local = hash_seq_search(&hash_seq)) != NULL)
+			hash_search(pgss_local_hash, &local->key, HASH_REMOVE, NULL);
+	}
+
 	LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
 
 	hash_seq_init(&hash_seq, pgss_hash);
@@ -2221,6 +2767,7 @@ entry_reset(void)
 	{
 		hash_search(pgss_hash, &entry->key, HASH_REMOVE, NULL);
 	}
+	pgss->generation++;
 
 	/*
 	 * Write new empty query file, perhaps even creating a new one to recover
@@ -2801,6 +3348,7 @@ JumbleExpr(pgssJumbleState *jstate, Node *node)
 
 				/* we store the string name because RTE_CTE RTEs need it */
 				APP_JUMB_STRING(cte->ctename);
+				APP_JUMB(cte->ctematerialized);
 				JumbleQuery(jstate, (Query *) cte->ctequery);
 			}
 			break;
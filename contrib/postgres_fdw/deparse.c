@@ -47,6 +47,8 @@
 #include "commands/defrem.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
+#include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
 #include "optimizer/var.h"
 #include "parser/parsetree.h"
 #include "utils/builtins.h"
@@ -55,13 +57,20 @@
 #include "utils/syscache.h"
 
 
+/*
+ * Prefix of the aliases given to the base relations in the remote query
+ * for a join; relation with RT index n is aliased rn.
+ */
+#define REL_ALIAS_PREFIX	"r"
+
 /*
  * Global context for foreign_expr_walker's search of an expression tree.
  */
 typedef struct foreign_glob_cxt
 {
 	PlannerInfo *root;			/* global planner state */
-	RelOptInfo *foreignrel;		/* the foreign relation we are planning for */
+	RelOptInfo *foreignrel;		/* the foreign relation or join we are
+								 * planning for */
 } foreign_glob_cxt;
 
 /*
@@ -120,8 +129,11 @@ static void deparseReturningList(StringInfo buf, PlannerInfo *root,
 					 List *returningList,
 					 List **retrieved_attrs);
 static void deparseColumnRef(StringInfo buf, int varno, int varattno,
-				 PlannerInfo *root);
+				 PlannerInfo *root, bool qualify_col);
 static void deparseRelation(StringInfo buf, Relation rel);
+static void deparseFromExprForRel(StringInfo buf, PlannerInfo *root,
+					  RelOptInfo *foreignrel, List **params);
+static void appendConditions(List *exprs, deparse_expr_cxt *context);
 static void deparseExpr(Expr *expr, deparse_expr_cxt *context);
 static void deparseVar(Var *node, deparse_expr_cxt *context);
 static void deparseConst(Const *node, deparse_expr_cxt *context);
@@ -249,13 +261,13 @@ foreign_expr_walker(Node *node,
 				Var		   *var = (Var *) node;
 
 				/*
-				 * If the Var is from the foreign table, we consider its
-				 * collation (if any) safe to use.  If it is from another
-				 * table, we treat its collation the same way as we would a
-				 * Param's collation, ie it's not safe for it to have a
-				 * non-default collation.
+				 * If the Var is from the foreign table, or one of the tables
+				 * of a foreign join, we consider its collation (if any) safe
+				 * to use.  If it is from another table, we treat its
+				 * collation the same way as we would a Param's collation, ie
+				 * it's not safe for it to have a non-default collation.
 				 */
-				if (var->varno == glob_cxt->foreignrel->relid &&
+				if (bms_is_member(var->varno, glob_cxt->foreignrel->relids) &&
 					var->varlevelsup == 0)
 				{
 					/* Var belongs to foreign table */
@@ -693,6 +705,30 @@ is_builtin(Oid oid)
 	return (oid < FirstBootstrapObjectId);
 }
 
+/*
+ * Build the targetlist for the remote query of a foreign join: the columns
+ * needed above the join, plus those needed to evaluate the conditions that
+ * have to be checked locally.
+ */
+List *
+build_tlist_to_deparse(RelOptInfo *foreignrel)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	List	   *tlist = NIL;
+
+	tlist = add_to_flat_tlist(tlist,
+							  pull_var_clause((Node *) foreignrel->reltargetlist,
+											  PVC_REJECT_AGGREGATES,
+											  PVC_RECURSE_PLACEHOLDERS));
+	tlist = add_to_flat_tlist(tlist,
+				pull_var_clause((Node *) extract_actual_clauses(fpinfo->local_conds,
+																false),
+								PVC_REJECT_AGGREGATES,
+								PVC_RECURSE_PLACEHOLDERS));
+
+	return tlist;
+}
+
 
 /*
  * Construct a simple SELECT statement that retrieves desired columns
@@ -781,7 +817,7 @@ deparseTargetList(StringInfo buf,
 				appendStringInfoString(buf, " RETURNING ");
 			first = false;
 
-			deparseColumnRef(buf, rtindex, i, root);
+			deparseColumnRef(buf, rtindex, i, root, false);
 
 			*retrieved_attrs = lappend_int(*retrieved_attrs, i);
 		}
@@ -869,6 +905,182 @@ appendWhereClause(StringInfo buf,
 	reset_transmission_modes(nestlevel);
 }
 
+/*
+ * Construct a SELECT statement that performs the given foreign join on the
+ * remote server, and append it to buf.
+ *
+ * tlist is the list of Vars to retrieve, as made by build_tlist_to_deparse;
+ * the result columns appear in that order.  remote_conds is a list of
+ * RestrictInfos to put in the WHERE clause.  The base relations are
+ * referred to by the aliases REL_ALIAS_PREFIX followed by their RT index.
+ *
+ * params is as for appendWhereClause: if not NULL, it receives the list of
+ * Params used in the ON and WHERE clauses; if NULL, we're generating the
+ * query for EXPLAIN, and dummy values are printed instead.
+ */
+void
+deparseJoinSelectSql(StringInfo buf,
+					 PlannerInfo *root,
+					 RelOptInfo *joinrel,
+					 List *tlist,
+					 List *remote_conds,
+					 List **params)
+{
+	deparse_expr_cxt context;
+	ListCell   *lc;
+
+	Assert(joinrel->reloptkind == RELOPT_JOINREL);
+
+	if (params)
+		*params = NIL;			/* initialize result list to empty */
+
+	context.root = root;
+	context.foreignrel = joinrel;
+	context.buf = buf;
+	context.params_list = params;
+
+	/*
+	 * Construct SELECT list
+	 */
+	appendStringInfoString(buf, "SELECT ");
+	foreach(lc, tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (lc != list_head(tlist))
+			appendStringInfoString(buf, ", ");
+		deparseVar((Var *) tle->expr, &context);
+	}
+
+	/* Don't generate bad syntax if no columns are needed */
+	if (tlist == NIL)
+		appendStringInfoString(buf, "NULL");
+
+	/*
+	 * Construct FROM and WHERE clauses
+	 */
+	appendStringInfoString(buf, " FROM ");
+	deparseFromExprForRel(buf, root, joinrel, params);
+
+	if (remote_conds)
+	{
+		int			nestlevel;
+
+		/* Make sure any constants in the exprs are printed portably */
+		nestlevel = set_transmission_modes();
+		appendStringInfoString(buf, " WHERE ");
+		appendConditions(remote_conds, &context);
+		reset_transmission_modes(nestlevel);
+	}
+}
+
+/*
+ * Construct the FROM clause item for the given relation: the table with
+ * its alias for a base relation, or a parenthesized JOIN expression for a
+ * join.
+ */
+static void
+deparseFromExprForRel(StringInfo buf, PlannerInfo *root,
+					  RelOptInfo *foreignrel, List **params)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+
+	if (foreignrel->reloptkind == RELOPT_JOINREL)
+	{
+		deparse_expr_cxt context;
+
+		appendStringInfoChar(buf, '(');
+		deparseFromExprForRel(buf, root, fpinfo->outerrel, params);
+		appendStringInfo(buf, " %s JOIN ",
+						 get_jointype_name(fpinfo->jointype));
+		deparseFromExprForRel(buf, root, fpinfo->innerrel, params);
+		appendStringInfoString(buf, " ON ");
+
+		if (fpinfo->joinclauses)
+		{
+			int			nestlevel;
+
+			context.root = root;
+			context.foreignrel = foreignrel;
+			context.buf = buf;
+			context.params_list = params;
+
+			nestlevel = set_transmission_modes();
+			appendStringInfoChar(buf, '(');
+			appendConditions(fpinfo->joinclauses, &context);
+			appendStringInfoChar(buf, ')');
+			reset_transmission_modes(nestlevel);
+		}
+		else
+		{
+			/* An inner join with no join clauses is a cross join */
+			appendStringInfoString(buf, "(TRUE)");
+		}
+
+		appendStringInfoChar(buf, ')');
+	}
+	else
+	{
+		RangeTblEntry *rte = planner_rt_fetch(foreignrel->relid, root);
+		Relation	rel;
+
+		/*
+		 * Core code already has some lock on each rel being planned, so we
+		 * can use NoLock here.
+		 */
+		rel = heap_open(rte->relid, NoLock);
+		deparseRelation(buf, rel);
+		heap_close(rel, NoLock);
+
+		appendStringInfo(buf, " %s%d", REL_ALIAS_PREFIX, foreignrel->relid);
+	}
+}
+
+/*
+ * Deparse a list of RestrictInfos, connecting them with "AND" and
+ * parenthesizing each condition.
+ */
+static void
+appendConditions(List *exprs, deparse_expr_cxt *context)
+{
+	StringInfo	buf = context->buf;
+	ListCell   *lc;
+
+	foreach(lc, exprs)
+	{
+		RestrictInfo *ri = (RestrictInfo *) lfirst(lc);
+
+		if (lc != list_head(exprs))
+			appendStringInfoString(buf, " AND ");
+
+		appendStringInfoChar(buf, '(');
+		deparseExpr(ri->clause, context);
+		appendStringInfoChar(buf, ')');
+	}
+}
+
+/*
+ * Output the SQL keyword for the given join type.
+ */
+const char *
+get_jointype_name(JoinType jointype)
+{
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			return "INNER";
+		case JOIN_LEFT:
+			return "LEFT";
+		case JOIN_RIGHT:
+			return "RIGHT";
+		case JOIN_FULL:
+			return "FULL";
+		default:
+			elog(ERROR, "unsupported join type %d", (int) jointype);
+			return NULL;		/* keep compiler quiet */
+	}
+}
+
 /*
  * deparse remote INSERT statement
  *
@@ -902,7 +1114,7 @@ deparseInsertSql(StringInfo buf, PlannerInfo *root,
 				appendStringInfoString(buf, ", ");
 			first = false;
 
-			deparseColumnRef(buf, rtindex, attnum, root);
+			deparseColumnRef(buf, rtindex, attnum, root, false);
 		}
 
 		appendStringInfoString(buf, ") VALUES (");
@@ -932,6 +1144,41 @@ deparseInsertSql(StringInfo buf, PlannerInfo *root,
 						 returningList, retrieved_attrs);
 }
 
+/*
+ * deparse remote INSERT statement that inserts num_rows rows at once
+ *
+ * orig_query is the single-row statement made by deparseInsertSql, which
+ * must end with its VALUES list, that is have no ON CONFLICT or RETURNING
+ * clause.  The statement takes num_params parameters per row, numbered
+ * consecutively row after row.
+ */
+void
+deparseBatchInsertSql(StringInfo buf, const char *orig_query,
+					  int num_params, int num_rows)
+{
+	int			pindex;
+	int			i;
+	int			j;
+
+	Assert(num_params > 0);
+
+	appendStringInfoString(buf, orig_query);
+
+	pindex = num_params + 1;
+	for (i = 1; i < num_rows; i++)
+	{
+		appendStringInfoString(buf, ", (");
+		for (j = 0; j < num_params; j++)
+		{
+			if (j > 0)
+				appendStringInfoString(buf, ", ");
+			appendStringInfo(buf, "$%d", pindex);
+			pindex++;
+		}
+		appendStringInfoChar(buf, ')');
+	}
+}
+
 /*
  * deparse remote UPDATE statement
  *
@@ -963,7 +1210,7 @@ deparseUpdateSql(StringInfo buf, PlannerInfo *root,
 			appendStringInfoString(buf, ", ");
 		first = false;
 
-		deparseColumnRef(buf, rtindex, attnum, root);
+		deparseColumnRef(buf, rtindex, attnum, root, false);
 		appendStringInfo(buf, " = $%d", pindex);
 		pindex++;
 	}
@@ -1118,9 +1365,12 @@ deparseAnalyzeSql(StringInfo buf, Relation rel, List **retrieved_attrs)
 /*
  * Construct name to use for given column, and emit it into buf.
  * If it has a column_name FDW option, use that instead of attribute name.
+ * If qualify_col is true, qualify it with the relation's alias, as used in
+ * the remote query for a join.
  */
 static void
-deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root)
+deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root,
+				 bool qualify_col)
 {
 	RangeTblEntry *rte;
 	char	   *colname = NULL;
@@ -1156,6 +1406,8 @@ deparseColumnRef(StringInfo buf, int varno, int varattno, PlannerInfo *root)
 	if (colname == NULL)
 		colname = get_relid_attribute_name(rte->relid, varattno);
 
+	if (qualify_col)
+		appendStringInfo(buf, "%s%d.", REL_ALIAS_PREFIX, varno);
 	appendStringInfoString(buf, quote_identifier(colname));
 }
 
@@ -1303,11 +1555,12 @@ deparseVar(Var *node, deparse_expr_cxt *context)
 {
 	StringInfo	buf = context->buf;
 
-	if (node->varno == context->foreignrel->relid &&
+	if (bms_is_member(node->varno, context->foreignrel->relids) &&
 		node->varlevelsup == 0)
 	{
-		/* Var belongs to foreign table */
-		deparseColumnRef(buf, node->varno, node->varattno, context->root);
+		/* Var belongs to foreign table, or to one of a foreign join's */
+		deparseColumnRef(buf, node->varno, node->varattno, context->root,
+						 context->foreignrel->reloptkind == RELOPT_JOINREL);
 	}
 	else
 	{
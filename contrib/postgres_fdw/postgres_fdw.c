@@ -47,39 +47,8 @@ PG_MODULE_MAGIC;
 /* Default CPU cost to process 1 row (above and beyond cpu_tuple_cost). */
 #define DEFAULT_FDW_TUPLE_COST		0.01
 
-/*
- * FDW-specific planner information kept in RelOptInfo.fdw_private for a
- * foreign table.  This information is collected by postgresGetForeignRelSize.
- */
-typedef struct PgFdwRelationInfo
-{
-	/* baserestrictinfo clauses, broken down into safe and unsafe subsets. */
-	List	   *remote_conds;
-	List	   *local_conds;
-
-	/* Bitmap of attr numbers we need to fetch from the remote server. */
-	Bitmapset  *attrs_used;
-
-	/* Cost and selectivity of local_conds. */
-	QualCost	local_conds_cost;
-	Selectivity local_conds_sel;
-
-	/* Estimated size and cost for a scan with baserestrictinfo quals. */
-	double		rows;
-	int			width;
-	Cost		startup_cost;
-	Cost		total_cost;
-
-	/* Options extracted from catalogs. */
-	bool		use_remote_estimate;
-	Cost		fdw_startup_cost;
-	Cost		fdw_tuple_cost;
-
-	/* Cached catalog information. */
-	ForeignTable *table;
-	ForeignServer *server;
-	UserMapping *user;			/* only set in use_remote_estimate mode */
-} PgFdwRelationInfo;
+/* Number of rows to get from the remote cursor with each FETCH. */
+#define DEFAULT_FETCH_SIZE			100
 
 /*
  * Indexes of FDW-private information stored in fdw_private lists.
@@ -89,6 +58,7 @@ typedef struct PgFdwRelationInfo
  *
  * 1) SELECT statement text to be sent to the remote server
  * 2) Integer list of attribute numbers retrieved by the SELECT
+ * 3) For a foreign join, the names of the joined relations, for EXPLAIN
  *
  * These items are indexed with the enum FdwScanPrivateIndex, so an item
  * can be fetched with list_nth().  For example, to get the SELECT statement:
@@ -99,7 +69,9 @@ enum FdwScanPrivateIndex
 	/* SQL statement to execute remotely (as a String node) */
 	FdwScanPrivateSelectSql,
 	/* Integer list of attribute numbers retrieved by the SELECT */
-	FdwScanPrivateRetrievedAttrs
+	FdwScanPrivateRetrievedAttrs,
+	/* Description of a join's relations (as a String node), joins only */
+	FdwScanPrivateRelations
 };
 
 /*
@@ -111,6 +83,7 @@ enum FdwScanPrivateIndex
  *	  (NIL for a DELETE)
  * 3) Boolean flag showing if the remote query has a RETURNING clause
  * 4) Integer list of attribute numbers retrieved by RETURNING, if any
+ * 5) Number of rows to send in each INSERT statement
  */
 enum FdwModifyPrivateIndex
 {
@@ -121,7 +94,9 @@ enum FdwModifyPrivateIndex
 	/* has-returning flag (as an integer Value node) */
 	FdwModifyPrivateHasReturning,
 	/* Integer list of attribute numbers retrieved by RETURNING */
-	FdwModifyPrivateRetrievedAttrs
+	FdwModifyPrivateRetrievedAttrs,
+	/* Rows per INSERT statement (as an integer Value node) */
+	FdwModifyPrivateBatchSize
 };
 
 /*
@@ -129,7 +104,8 @@ enum FdwModifyPrivateIndex
  */
 typedef struct PgFdwScanState
 {
-	Relation	rel;			/* relcache entry for the foreign table */
+	Relation	rel;			/* relcache entry for the foreign table, or
+								 * NULL for a foreign join */
 	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
 
 	/* extracted fdw_private data */
@@ -138,6 +114,7 @@ typedef struct PgFdwScanState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	unsigned int cursor_number; /* quasi-unique ID for my cursor */
 	bool		cursor_exists;	/* have we created the cursor? */
 	int			numParams;		/* number of parameters passed to query */
@@ -154,6 +131,10 @@ typedef struct PgFdwScanState
 	int			fetch_ct_2;		/* Min(# of fetches done, 2) */
 	bool		eof_reached;	/* true if last fetch reached EOF */
 
+	/* for asynchronous execution */
+	bool		async_capable;	/* may we send FETCHes ahead of need? */
+	bool		async_pending;	/* is a FETCH outstanding on conn? */
+
 	/* working memory contexts */
 	MemoryContext batch_cxt;	/* context holding current batch of tuples */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
@@ -169,6 +150,7 @@ typedef struct PgFdwModifyState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	char	   *p_name;			/* name of prepared statement, if created */
 
 	/* extracted fdw_private data */
@@ -182,7 +164,15 @@ typedef struct PgFdwModifyState
 	int			p_nums;			/* number of parameters to transmit */
 	FmgrInfo   *p_flinfo;		/* output conversion functions for them */
 
-	/* working memory context */
+	/* for sending inserted rows in batches */
+	int			batch_size;		/* rows per INSERT; 1 means no batching */
+	int			num_rows;		/* # of rows waiting to be sent */
+	const char **batch_values;	/* their parameter values, row after row */
+	char	   *batch_query;	/* text of INSERT for a full batch */
+	char	   *batch_p_name;	/* name of its prepared statement, if made */
+
+	/* working memory contexts */
+	MemoryContext batch_cxt;	/* context holding the waiting rows' values */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 } PgFdwModifyState;
 
@@ -217,6 +207,12 @@ typedef struct ConversionLocation
 {
 	Relation	rel;			/* foreign table's relcache entry */
 	AttrNumber	cur_attno;		/* attribute number being processed, or 0 */
+
+	/*
+	 * In case of a foreign join, rel is NULL, and we use fsstate to find out
+	 * which table's column the result column at cur_attno is.
+	 */
+	ForeignScanState *fsstate;
 } ConversionLocation;
 
 /* Callback argument for ec_member_matches_foreign */
@@ -241,7 +237,7 @@ static void postgresGetForeignPaths(PlannerInfo *root,
 						RelOptInfo *baserel,
 						Oid foreigntableid);
 static ForeignScan *postgresGetForeignPlan(PlannerInfo *root,
-					   RelOptInfo *baserel,
+					   RelOptInfo *foreignrel,
 					   Oid foreigntableid,
 					   ForeignPath *best_path,
 					   List *tlist,
@@ -251,6 +247,12 @@ static void postgresBeginForeignScan(ForeignScanState *node, int eflags);
 static TupleTableSlot *postgresIterateForeignScan(ForeignScanState *node);
 static void postgresReScanForeignScan(ForeignScanState *node);
 static void postgresEndForeignScan(ForeignScanState *node);
+static void postgresGetForeignJoinPaths(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra);
 static void postgresAddForeignUpdateTargets(Query *parsetree,
 								RangeTblEntry *target_rte,
 								Relation target_relation);
@@ -285,6 +287,8 @@ static void postgresExplainForeignModify(ModifyTableState *mtstate,
 							 List *fdw_private,
 							 int subplan_index,
 							 ExplainState *es);
+static bool postgresForeignAsyncRequest(ForeignScanState *node);
+static bool postgresForeignAsyncReady(ForeignScanState *node);
 static bool postgresAnalyzeForeignTable(Relation relation,
 							AcquireSampleRowsFunc *func,
 							BlockNumber *totalpages);
@@ -294,8 +298,11 @@ static List *postgresImportForeignSchema(ImportForeignSchemaStmt *stmt,
 /*
  * Helper functions
  */
+static bool foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel,
+				JoinType jointype, RelOptInfo *outerrel,
+				RelOptInfo *innerrel, JoinPathExtraData *extra);
 static void estimate_path_cost_size(PlannerInfo *root,
-						RelOptInfo *baserel,
+						RelOptInfo *foreignrel,
 						List *join_conds,
 						double *p_rows, int *p_width,
 						Cost *p_startup_cost, Cost *p_total_cost);
@@ -310,8 +317,15 @@ static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
 						  void *arg);
 static void create_cursor(ForeignScanState *node);
 static void fetch_more_data(ForeignScanState *node);
+static void fetch_more_data_begin(ForeignScanState *node);
+static void process_pending_request(PgFdwConnState *conn_state);
 static void close_cursor(PGconn *conn, unsigned int cursor_number);
-static void prepare_foreign_modify(PgFdwModifyState *fmstate);
+static char *prepare_foreign_modify(PgFdwModifyState *fmstate,
+					   const char *query);
+static void deallocate_foreign_modify(PgFdwModifyState *fmstate,
+						  const char *p_name);
+static int	get_batch_size_option(Relation rel);
+static void execute_foreign_insert_batch(PgFdwModifyState *fmstate);
 static const char **convert_prep_stmt_params(PgFdwModifyState *fmstate,
 						 ItemPointer tupleid,
 						 TupleTableSlot *slot);
@@ -328,6 +342,7 @@ static HeapTuple make_tuple_from_result_row(PGresult *res,
 						   Relation rel,
 						   AttInMetadata *attinmeta,
 						   List *retrieved_attrs,
+						   ForeignScanState *fsstate,
 						   MemoryContext temp_context);
 static void conversion_error_callback(void *arg);
 
@@ -350,6 +365,9 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	routine->ReScanForeignScan = postgresReScanForeignScan;
 	routine->EndForeignScan = postgresEndForeignScan;
 
+	/* Support function for join push-down */
+	routine->GetForeignJoinPaths = postgresGetForeignJoinPaths;
+
 	/* Functions for updating foreign tables */
 	routine->AddForeignUpdateTargets = postgresAddForeignUpdateTargets;
 	routine->PlanForeignModify = postgresPlanForeignModify;
@@ -367,6 +385,10 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	/* Support functions for ANALYZE */
 	routine->AnalyzeForeignTable = postgresAnalyzeForeignTable;
 
+	/* Support functions for asynchronous execution */
+	routine->ForeignAsyncRequest = postgresForeignAsyncRequest;
+	routine->ForeignAsyncReady = postgresForeignAsyncReady;
+
 	/* Support functions for IMPORT FOREIGN SCHEMA */
 	routine->ImportForeignSchema = postgresImportForeignSchema;
 
@@ -386,6 +408,10 @@ postgresGetForeignRelSize(PlannerInfo *root,
 						  Oid foreigntableid)
 {
 	PgFdwRelationInfo *fpinfo;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	const char *nspname;
+	const char *relname;
+	const char *refname;
 	ListCell   *lc;
 
 	/*
@@ -395,6 +421,9 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
 	baserel->fdw_private = (void *) fpinfo;
 
+	/* Base foreign tables need to be pushed down always. */
+	fpinfo->pushdown_safe = true;
+
 	/* Look up foreign-table catalog info. */
 	fpinfo->table = GetForeignTable(foreigntableid);
 	fpinfo->server = GetForeignServer(fpinfo->table->serverid);
@@ -435,9 +464,9 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	 * should match what ExecCheckRTEPerms() does.  If we fail due to lack of
 	 * permissions, the query would have failed at runtime anyway.
 	 */
+	fpinfo->checkAsUser = rte->checkAsUser;
 	if (fpinfo->use_remote_estimate)
 	{
-		RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
 		Oid			userid = rte->checkAsUser ? rte->checkAsUser : GetUserId();
 
 		fpinfo->user = GetUserMapping(userid, fpinfo->server->serverid);
@@ -532,6 +561,22 @@ postgresGetForeignRelSize(PlannerInfo *root,
 								&fpinfo->rows, &fpinfo->width,
 								&fpinfo->startup_cost, &fpinfo->total_cost);
 	}
+
+	/*
+	 * Set the name of the relation in fpinfo, for EXPLAIN of a join that
+	 * includes it: the schema-qualified table name, followed by the alias
+	 * if there is one.
+	 */
+	fpinfo->relation_name = makeStringInfo();
+	nspname = get_namespace_name(get_rel_namespace(foreigntableid));
+	relname = get_rel_name(foreigntableid);
+	refname = rte->eref->aliasname;
+	appendStringInfo(fpinfo->relation_name, "%s.%s",
+					 quote_identifier(nspname),
+					 quote_identifier(relname));
+	if (*refname && strcmp(refname, relname) != 0)
+		appendStringInfo(fpinfo->relation_name, " %s",
+						 quote_identifier(refname));
 }
 
 /*
@@ -741,24 +786,71 @@ postgresGetForeignPaths(PlannerInfo *root,
  */
 static ForeignScan *
 postgresGetForeignPlan(PlannerInfo *root,
-					   RelOptInfo *baserel,
+					   RelOptInfo *foreignrel,
 					   Oid foreigntableid,
 					   ForeignPath *best_path,
 					   List *tlist,
 					   List *scan_clauses,
 					   Plan *outer_plan)
 {
-	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
-	Index		scan_relid = baserel->relid;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	Index		scan_relid;
 	List	   *fdw_private;
 	List	   *remote_conds = NIL;
 	List	   *remote_exprs = NIL;
 	List	   *local_exprs = NIL;
 	List	   *params_list = NIL;
+	List	   *fdw_scan_tlist = NIL;
 	List	   *retrieved_attrs;
 	StringInfoData sql;
 	ListCell   *lc;
 
+	if (foreignrel->reloptkind == RELOPT_JOINREL)
+	{
+		int			i;
+
+		/*
+		 * For a join, postgresGetForeignJoinPaths already decided which
+		 * conditions go to the remote server; we only have to check the
+		 * local_conds here.  A join path is never parameterized, so there
+		 * are no scan_clauses.  We don't pass any recheck quals, since we
+		 * don't push down joins that might need EvalPlanQual rechecks.
+		 */
+		Assert(scan_clauses == NIL);
+		scan_relid = 0;
+		foreach(lc, fpinfo->local_conds)
+		{
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+			local_exprs = lappend(local_exprs, rinfo->clause);
+		}
+
+		/* The remote query returns the columns of fdw_scan_tlist, in order */
+		fdw_scan_tlist = build_tlist_to_deparse(foreignrel);
+		retrieved_attrs = NIL;
+		for (i = 1; i <= list_length(fdw_scan_tlist); i++)
+			retrieved_attrs = lappend_int(retrieved_attrs, i);
+
+		initStringInfo(&sql);
+		deparseJoinSelectSql(&sql, root, foreignrel, fdw_scan_tlist,
+							 fpinfo->remote_conds, &params_list);
+
+		fdw_private = list_make3(makeString(sql.data),
+								 retrieved_attrs,
+								 makeString(fpinfo->relation_name->data));
+
+		return make_foreignscan(tlist,
+								local_exprs,
+								scan_relid,
+								params_list,
+								fdw_private,
+								fdw_scan_tlist,
+								NIL,
+								outer_plan);
+	}
+
+	scan_relid = foreignrel->relid;
+
 	/*
 	 * Separate the scan_clauses into those that can be executed remotely and
 	 * those that can't.  baserestrictinfo clauses that were previously
@@ -795,7 +887,7 @@ postgresGetForeignPlan(PlannerInfo *root,
 		}
 		else if (list_member_ptr(fpinfo->local_conds, rinfo))
 			local_exprs = lappend(local_exprs, rinfo->clause);
-		else if (is_foreign_expr(root, baserel, rinfo->clause))
+		else if (is_foreign_expr(root, foreignrel, rinfo->clause))
 		{
 			remote_conds = lappend(remote_conds, rinfo);
 			remote_exprs = lappend(remote_exprs, rinfo->clause);
@@ -809,10 +901,10 @@ postgresGetForeignPlan(PlannerInfo *root,
 	 * expressions to be sent as parameters.
 	 */
 	initStringInfo(&sql);
-	deparseSelectSql(&sql, root, baserel, fpinfo->attrs_used,
+	deparseSelectSql(&sql, root, foreignrel, fpinfo->attrs_used,
 					 &retrieved_attrs);
 	if (remote_conds)
-		appendWhereClause(&sql, root, baserel, remote_conds,
+		appendWhereClause(&sql, root, foreignrel, remote_conds,
 						  true, &params_list);
 
 	/*
@@ -825,7 +917,7 @@ postgresGetForeignPlan(PlannerInfo *root,
 	 * Note: because we actually run the query as a cursor, this assumes that
 	 * DECLARE CURSOR ... FOR UPDATE is supported, which it isn't before 8.3.
 	 */
-	if (baserel->relid == root->parse->resultRelation &&
+	if (foreignrel->relid == root->parse->resultRelation &&
 		(root->parse->commandType == CMD_UPDATE ||
 		 root->parse->commandType == CMD_DELETE))
 	{
@@ -834,7 +926,7 @@ postgresGetForeignPlan(PlannerInfo *root,
 	}
 	else
 	{
-		PlanRowMark *rc = get_plan_rowmark(root->rowMarks, baserel->relid);
+		PlanRowMark *rc = get_plan_rowmark(root->rowMarks, foreignrel->relid);
 
 		if (rc)
 		{
@@ -905,6 +997,7 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	ForeignTable *table;
 	ForeignServer *server;
 	UserMapping *user;
+	int			rtindex;
 	int			numParams;
 	int			i;
 	ListCell   *lc;
@@ -923,14 +1016,19 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 
 	/*
 	 * Identify which user to do the remote access as.  This should match what
-	 * ExecCheckRTEPerms() does.
+	 * ExecCheckRTEPerms() does.  For a join, use the lowest-numbered member
+	 * RTE as a representative; the planner made sure they all agree.
 	 */
-	rte = rt_fetch(fsplan->scan.scanrelid, estate->es_range_table);
+	if (fsplan->scan.scanrelid > 0)
+		rtindex = fsplan->scan.scanrelid;
+	else
+		rtindex = bms_next_member(fsplan->fs_relids, -1);
+	rte = rt_fetch(rtindex, estate->es_range_table);
 	userid = rte->checkAsUser ? rte->checkAsUser : GetUserId();
 
 	/* Get info about foreign table. */
 	fsstate->rel = node->ss.ss_currentRelation;
-	table = GetForeignTable(RelationGetRelid(fsstate->rel));
+	table = GetForeignTable(rte->relid);
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(userid, server->serverid);
 
@@ -938,12 +1036,36 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	 * Get connection to the foreign server.  Connection manager will
 	 * establish new connection if necessary.
 	 */
-	fsstate->conn = GetConnection(server, user, false);
+	fsstate->conn = GetConnection(server, user, false, &fsstate->conn_state);
 
 	/* Assign a unique ID for my cursor */
 	fsstate->cursor_number = GetCursorNumber(fsstate->conn);
 	fsstate->cursor_exists = false;
 
+	/*
+	 * See whether we may run ahead of the executor with asynchronous
+	 * FETCHes.  A table-level setting overrides the server-level one.
+	 */
+	fsstate->async_capable = false;
+	fsstate->async_pending = false;
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "async_capable") == 0)
+			fsstate->async_capable = defGetBoolean(def);
+	}
+	if (fsstate->rel)
+	{
+		foreach(lc, table->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "async_capable") == 0)
+				fsstate->async_capable = defGetBoolean(def);
+		}
+	}
+
 	/* Get private info created by planner functions. */
 	fsstate->query = strVal(list_nth(fsplan->fdw_private,
 									 FdwScanPrivateSelectSql));
@@ -962,8 +1084,14 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 											  ALLOCSET_SMALL_INITSIZE,
 											  ALLOCSET_SMALL_MAXSIZE);
 
-	/* Get info we'll need for input data conversion. */
-	fsstate->attinmeta = TupleDescGetAttInMetadata(RelationGetDescr(fsstate->rel));
+	/*
+	 * Get info we'll need for input data conversion.  For a join, the result
+	 * rows have the shape of the scan tuple, which follows fdw_scan_tlist.
+	 */
+	if (fsstate->rel)
+		fsstate->attinmeta = TupleDescGetAttInMetadata(RelationGetDescr(fsstate->rel));
+	else
+		fsstate->attinmeta = TupleDescGetAttInMetadata(node->ss.ss_ScanTupleSlot->tts_tupleDescriptor);
 
 	/* Prepare for output conversion of parameters used in remote query. */
 	numParams = list_length(fsplan->fdw_exprs);
@@ -1060,6 +1188,14 @@ postgresReScanForeignScan(ForeignScanState *node)
 	if (!fsstate->cursor_exists)
 		return;
 
+	/*
+	 * The connection must be idle before we can send anything.  If the
+	 * outstanding FETCH is our own, this just stores its result as the
+	 * current batch, which the logic below accounts for.
+	 */
+	if (fsstate->conn_state->pendingScan)
+		process_pending_request(fsstate->conn_state);
+
 	/*
 	 * If any internal parameters affecting this node have changed, we'd
 	 * better destroy and recreate the cursor.  Otherwise, rewinding it should
@@ -1114,9 +1250,21 @@ postgresEndForeignScan(ForeignScanState *node)
 	if (fsstate == NULL)
 		return;
 
+	/* Discard the result of our own outstanding FETCH, if any */
+	if (fsstate->async_pending)
+	{
+		PQclear(pgfdw_get_result(fsstate->conn, fsstate->query));
+		fsstate->async_pending = false;
+		fsstate->conn_state->pendingScan = NULL;
+	}
+
 	/* Close the cursor if open, to prevent accumulation of cursors */
 	if (fsstate->cursor_exists)
+	{
+		if (fsstate->conn_state->pendingScan)
+			process_pending_request(fsstate->conn_state);
 		close_cursor(fsstate->conn, fsstate->cursor_number);
+	}
 
 	/* Release remote connection */
 	ReleaseConnection(fsstate->conn);
@@ -1125,6 +1273,71 @@ postgresEndForeignScan(ForeignScanState *node)
 	/* MemoryContexts will be deleted automatically. */
 }
 
+/*
+ * postgresForeignAsyncRequest
+ *		Start fetching the scan's next batch in the background, if it is
+ *		async-capable and needs one.  Returns true if a FETCH is now in
+ *		progress for the scan.
+ *
+ * Only one query can be outstanding on a connection, so this does nothing
+ * if another scan sharing our connection got there first.
+ */
+static bool
+postgresForeignAsyncRequest(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	/* if fsstate is NULL, we are in EXPLAIN; nothing to do */
+	if (fsstate == NULL || !fsstate->async_capable)
+		return false;
+
+	if (fsstate->async_pending)
+		return true;
+
+	/* Nothing to do if there are tuples left, or none to come */
+	if (fsstate->cursor_exists &&
+		(fsstate->next_tuple < fsstate->num_tuples || fsstate->eof_reached))
+		return false;
+
+	if (fsstate->conn_state->pendingScan != NULL)
+		return false;
+
+	fetch_more_data_begin(node);
+
+	return true;
+}
+
+/*
+ * postgresForeignAsyncReady
+ *		Report whether the next IterateForeignScan call can be answered
+ *		without waiting for the remote server.
+ *
+ * Scans that are not async-capable always claim to be ready, since there
+ * is nothing to be gained by putting them off.
+ */
+static bool
+postgresForeignAsyncReady(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	if (fsstate == NULL || !fsstate->async_capable)
+		return true;
+
+	if (fsstate->async_pending)
+	{
+		if (!PQconsumeInput(fsstate->conn))
+			pgfdw_report_error(ERROR, NULL, fsstate->conn, false,
+							   fsstate->query);
+		return !PQisBusy(fsstate->conn);
+	}
+
+	if (!fsstate->cursor_exists)
+		return false;
+
+	return (fsstate->next_tuple < fsstate->num_tuples ||
+			fsstate->eof_reached);
+}
+
 /*
  * postgresAddForeignUpdateTargets
  *		Add resjunk column(s) needed for update/delete on a foreign table
@@ -1187,6 +1400,7 @@ postgresPlanForeignModify(PlannerInfo *root,
 	List	   *returningList = NIL;
 	List	   *retrieved_attrs = NIL;
 	bool		doNothing = false;
+	int			batch_size = 1;
 
 	initStringInfo(&sql);
 
@@ -1275,16 +1489,36 @@ postgresPlanForeignModify(PlannerInfo *root,
 			break;
 	}
 
+	/*
+	 * An INSERT can send several rows per remote command, if the table or
+	 * server asks for it.  That's only possible when nothing needs to see a
+	 * row as inserted before the batch is sent: there must be no RETURNING
+	 * list and no AFTER triggers, and ON CONFLICT DO NOTHING is excluded
+	 * since the row count it reports would be wrong.  A remote command can
+	 * have at most 65535 parameters, which limits the rows in a batch.
+	 */
+	if (operation == CMD_INSERT && targetAttrs != NIL &&
+		returningList == NIL && !doNothing &&
+		!(rel->trigdesc &&
+		  (rel->trigdesc->trig_insert_after_row ||
+		   rel->trigdesc->trig_insert_after_statement)))
+	{
+		batch_size = get_batch_size_option(rel);
+		batch_size = Min(batch_size, 65535 / list_length(targetAttrs));
+		batch_size = Max(batch_size, 1);
+	}
+
 	heap_close(rel, NoLock);
 
 	/*
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match enum FdwModifyPrivateIndex, above.
 	 */
-	return list_make4(makeString(sql.data),
-					  targetAttrs,
-					  makeInteger((retrieved_attrs != NIL)),
-					  retrieved_attrs);
+	return lappend(list_make4(makeString(sql.data),
+							  targetAttrs,
+							  makeInteger((retrieved_attrs != NIL)),
+							  retrieved_attrs),
+				   makeInteger(batch_size));
 }
 
 /*
@@ -1336,7 +1570,7 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 	user = GetUserMapping(userid, server->serverid);
 
 	/* Open connection; report that we'll create a prepared statement. */
-	fmstate->conn = GetConnection(server, user, true);
+	fmstate->conn = GetConnection(server, user, true, &fmstate->conn_state);
 	fmstate->p_name = NULL;		/* prepared statement not made yet */
 
 	/* Deconstruct fdw_private data. */
@@ -1348,6 +1582,8 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 											 FdwModifyPrivateHasReturning));
 	fmstate->retrieved_attrs = (List *) list_nth(fdw_private,
 											 FdwModifyPrivateRetrievedAttrs);
+	fmstate->batch_size = intVal(list_nth(fdw_private,
+										  FdwModifyPrivateBatchSize));
 
 	/* Create context for per-tuple temp workspace. */
 	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
@@ -1399,6 +1635,28 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 
 	Assert(fmstate->p_nums <= n_params);
 
+	/* Set up to collect rows for batched INSERTs. */
+	if (fmstate->batch_size > 1)
+	{
+		StringInfoData sql;
+
+		fmstate->num_rows = 0;
+		fmstate->batch_values = (const char **)
+			MemoryContextAlloc(estate->es_query_cxt,
+							   sizeof(char *) * fmstate->p_nums *
+							   fmstate->batch_size);
+		fmstate->batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
+												   "postgres_fdw batch data",
+												   ALLOCSET_DEFAULT_MINSIZE,
+												   ALLOCSET_DEFAULT_INITSIZE,
+												   ALLOCSET_DEFAULT_MAXSIZE);
+
+		initStringInfo(&sql);
+		deparseBatchInsertSql(&sql, fmstate->query, fmstate->p_nums,
+							  fmstate->batch_size);
+		fmstate->batch_query = sql.data;
+	}
+
 	resultRelInfo->ri_FdwState = fmstate;
 }
 
@@ -1417,9 +1675,36 @@ postgresExecForeignInsert(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/*
+	 * When batching, just add the row's parameters to the batch, and send it
+	 * once it's full.  The row is reported as inserted now; any failure to
+	 * insert it will be reported when the batch is sent.
+	 */
+	if (fmstate->batch_size > 1)
+	{
+		const char **dest;
+		int			i;
+
+		p_values = convert_prep_stmt_params(fmstate, NULL, slot);
+		dest = fmstate->batch_values + fmstate->num_rows * fmstate->p_nums;
+		for (i = 0; i < fmstate->p_nums; i++)
+			dest[i] = p_values[i] ?
+				MemoryContextStrdup(fmstate->batch_cxt, p_values[i]) : NULL;
+		MemoryContextReset(fmstate->temp_cxt);
+
+		if (++fmstate->num_rows >= fmstate->batch_size)
+			execute_foreign_insert_batch(fmstate);
+
+		return slot;
+	}
+
+	/* The connection must not be busy with an asynchronous FETCH */
+	if (fmstate->conn_state->pendingScan)
+		process_pending_request(fmstate->conn_state);
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
-		prepare_foreign_modify(fmstate);
+		fmstate->p_name = prepare_foreign_modify(fmstate, fmstate->query);
 
 	/* Convert parameters needed by prepared statement to text form */
 	p_values = convert_prep_stmt_params(fmstate, NULL, slot);
@@ -1477,9 +1762,13 @@ postgresExecForeignUpdate(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/* The connection must not be busy with an asynchronous FETCH */
+	if (fmstate->conn_state->pendingScan)
+		process_pending_request(fmstate->conn_state);
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
-		prepare_foreign_modify(fmstate);
+		fmstate->p_name = prepare_foreign_modify(fmstate, fmstate->query);
 
 	/* Get the ctid that was passed up as a resjunk column */
 	datum = ExecGetJunkAttribute(planSlot,
@@ -1547,9 +1836,13 @@ postgresExecForeignDelete(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/* The connection must not be busy with an asynchronous FETCH */
+	if (fmstate->conn_state->pendingScan)
+		process_pending_request(fmstate->conn_state);
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
-		prepare_foreign_modify(fmstate);
+		fmstate->p_name = prepare_foreign_modify(fmstate, fmstate->query);
 
 	/* Get the ctid that was passed up as a resjunk column */
 	datum = ExecGetJunkAttribute(planSlot,
@@ -1614,24 +1907,21 @@ postgresEndForeignModify(EState *estate,
 	if (fmstate == NULL)
 		return;
 
-	/* If we created a prepared statement, destroy it */
+	/* Send any rows still waiting in a partial batch */
+	if (fmstate->num_rows > 0)
+		execute_foreign_insert_batch(fmstate);
+
+	/* If we created prepared statements, destroy them */
 	if (fmstate->p_name)
 	{
-		char		sql[64];
-		PGresult   *res;
-
-		snprintf(sql, sizeof(sql), "DEALLOCATE %s", fmstate->p_name);
-
-		/*
-		 * We don't use a PG_TRY block here, so be careful not to throw error
-		 * without releasing the PGresult.
-		 */
-		res = PQexec(fmstate->conn, sql);
-		if (PQresultStatus(res) != PGRES_COMMAND_OK)
-			pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
-		PQclear(res);
+		deallocate_foreign_modify(fmstate, fmstate->p_name);
 		fmstate->p_name = NULL;
 	}
+	if (fmstate->batch_p_name)
+	{
+		deallocate_foreign_modify(fmstate, fmstate->batch_p_name);
+		fmstate->batch_p_name = NULL;
+	}
 
 	/* Release remote connection */
 	ReleaseConnection(fmstate->conn);
@@ -1692,10 +1982,22 @@ postgresExplainForeignScan(ForeignScanState *node, ExplainState *es)
 {
 	List	   *fdw_private;
 	char	   *sql;
+	char	   *relations;
+
+	fdw_private = ((ForeignScan *) node->ss.ps.plan)->fdw_private;
+
+	/*
+	 * Add names of relations handled by the foreign scan when the scan is a
+	 * join
+	 */
+	if (list_length(fdw_private) > FdwScanPrivateRelations)
+	{
+		relations = strVal(list_nth(fdw_private, FdwScanPrivateRelations));
+		ExplainPropertyText("Relations", relations, es);
+	}
 
 	if (es->verbose)
 	{
-		fdw_private = ((ForeignScan *) node->ss.ps.plan)->fdw_private;
 		sql = strVal(list_nth(fdw_private, FdwScanPrivateSelectSql));
 		ExplainPropertyText("Remote SQL", sql, es);
 	}
@@ -1716,27 +2018,32 @@ postgresExplainForeignModify(ModifyTableState *mtstate,
 	{
 		char	   *sql = strVal(list_nth(fdw_private,
 										  FdwModifyPrivateUpdateSql));
+		int			batch_size = intVal(list_nth(fdw_private,
+												 FdwModifyPrivateBatchSize));
 
 		ExplainPropertyText("Remote SQL", sql, es);
+		if (batch_size > 1)
+			ExplainPropertyInteger("Batch Size", batch_size, es);
 	}
 }
 
 
 /*
  * estimate_path_cost_size
- *		Get cost and size estimates for a foreign scan
+ *		Get cost and size estimates for a foreign scan on given foreign
+ *		relation, either a base relation or a join between foreign relations.
  *
  * We assume that all the baserestrictinfo clauses will be applied, plus
  * any join clauses listed in join_conds.
  */
 static void
 estimate_path_cost_size(PlannerInfo *root,
-						RelOptInfo *baserel,
+						RelOptInfo *foreignrel,
 						List *join_conds,
 						double *p_rows, int *p_width,
 						Cost *p_startup_cost, Cost *p_total_cost)
 {
-	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
 	double		rows;
 	double		retrieved_rows;
 	int			width;
@@ -1766,7 +2073,7 @@ estimate_path_cost_size(PlannerInfo *root,
 		 * join_conds might contain both clauses that are safe to send across,
 		 * and clauses that aren't.
 		 */
-		classifyConditions(root, baserel, join_conds,
+		classifyConditions(root, foreignrel, join_conds,
 						   &remote_join_conds, &local_join_conds);
 
 		/*
@@ -1776,17 +2083,28 @@ estimate_path_cost_size(PlannerInfo *root,
 		 */
 		initStringInfo(&sql);
 		appendStringInfoString(&sql, "EXPLAIN ");
-		deparseSelectSql(&sql, root, baserel, fpinfo->attrs_used,
-						 &retrieved_attrs);
-		if (fpinfo->remote_conds)
-			appendWhereClause(&sql, root, baserel, fpinfo->remote_conds,
-							  true, NULL);
-		if (remote_join_conds)
-			appendWhereClause(&sql, root, baserel, remote_join_conds,
-							  (fpinfo->remote_conds == NIL), NULL);
+		if (foreignrel->reloptkind == RELOPT_JOINREL)
+		{
+			/* join_conds is always NIL for a join */
+			Assert(join_conds == NIL);
+			deparseJoinSelectSql(&sql, root, foreignrel,
+								 build_tlist_to_deparse(foreignrel),
+								 fpinfo->remote_conds, NULL);
+		}
+		else
+		{
+			deparseSelectSql(&sql, root, foreignrel, fpinfo->attrs_used,
+							 &retrieved_attrs);
+			if (fpinfo->remote_conds)
+				appendWhereClause(&sql, root, foreignrel, fpinfo->remote_conds,
+								  true, NULL);
+			if (remote_join_conds)
+				appendWhereClause(&sql, root, foreignrel, remote_join_conds,
+								  (fpinfo->remote_conds == NIL), NULL);
+		}
 
 		/* Get the remote estimate */
-		conn = GetConnection(fpinfo->server, fpinfo->user, false);
+		conn = GetConnection(fpinfo->server, fpinfo->user, false, NULL);
 		get_remote_estimate(sql.data, conn, &rows, &width,
 							&startup_cost, &total_cost);
 		ReleaseConnection(conn);
@@ -1796,7 +2114,7 @@ estimate_path_cost_size(PlannerInfo *root,
 		/* Factor in the selectivity of the locally-checked quals */
 		local_sel = clauselist_selectivity(root,
 										   local_join_conds,
-										   baserel->relid,
+										   foreignrel->relid,
 										   JOIN_INNER,
 										   NULL);
 		local_sel *= fpinfo->local_conds_sel;
@@ -1818,31 +2136,94 @@ estimate_path_cost_size(PlannerInfo *root,
 		 */
 		Assert(join_conds == NIL);
 
-		/* Use rows/width estimates made by set_baserel_size_estimates. */
-		rows = baserel->rows;
-		width = baserel->width;
+		/* Use rows/width estimates made by the core code. */
+		rows = foreignrel->rows;
+		width = foreignrel->width;
 
-		/*
-		 * Back into an estimate of the number of retrieved rows.  Just in
-		 * case this is nuts, clamp to at most baserel->tuples.
-		 */
-		retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
-		retrieved_rows = Min(retrieved_rows, baserel->tuples);
+		if (foreignrel->reloptkind == RELOPT_JOINREL)
+		{
+			PgFdwRelationInfo *fpinfo_i;
+			PgFdwRelationInfo *fpinfo_o;
+			QualCost	join_cost;
+			QualCost	remote_conds_cost;
+			double		nrows;
 
-		/*
-		 * Cost as though this were a seqscan, which is pessimistic.  We
-		 * effectively imagine the local_conds are being evaluated remotely,
-		 * too.
-		 */
-		startup_cost = 0;
-		run_cost = 0;
-		run_cost += seq_page_cost * baserel->pages;
+			/* For join we expect inner and outer relations set */
+			Assert(fpinfo->innerrel && fpinfo->outerrel);
+
+			fpinfo_i = (PgFdwRelationInfo *) fpinfo->innerrel->fdw_private;
+			fpinfo_o = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
 
-		startup_cost += baserel->baserestrictcost.startup;
-		cpu_per_tuple = cpu_tuple_cost + baserel->baserestrictcost.per_tuple;
-		run_cost += cpu_per_tuple * baserel->tuples;
+			/* Estimate of number of rows in cross product */
+			nrows = fpinfo_i->rows * fpinfo_o->rows;
 
-		total_cost = startup_cost + run_cost;
+			/*
+			 * Back into an estimate of the number of retrieved rows.  Just in
+			 * case this is nuts, clamp to at most nrows.
+			 */
+			retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
+			retrieved_rows = Min(retrieved_rows, nrows);
+
+			/*
+			 * The cost of foreign join is estimated as cost of generating
+			 * rows for the joining relations + cost for applying quals on the
+			 * rows.  This is pessimistic, since the remote server is free to
+			 * pick a better plan than the nested loop this implies.
+			 */
+			cost_qual_eval(&join_cost, fpinfo->joinclauses, root);
+			cost_qual_eval(&remote_conds_cost, fpinfo->remote_conds, root);
+
+			startup_cost = fpinfo_i->rel_startup_cost +
+				fpinfo_o->rel_startup_cost;
+			startup_cost += join_cost.startup;
+			startup_cost += remote_conds_cost.startup;
+			startup_cost += fpinfo->local_conds_cost.startup;
+
+			run_cost = fpinfo_i->rel_total_cost - fpinfo_i->rel_startup_cost;
+			run_cost += fpinfo_o->rel_total_cost - fpinfo_o->rel_startup_cost;
+			run_cost += nrows * join_cost.per_tuple;
+			nrows = clamp_row_est(nrows * fpinfo->joinclause_sel);
+			run_cost += nrows * remote_conds_cost.per_tuple;
+			run_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
+
+			total_cost = startup_cost + run_cost;
+		}
+		else
+		{
+			/*
+			 * Back into an estimate of the number of retrieved rows.  Just in
+			 * case this is nuts, clamp to at most foreignrel->tuples.
+			 */
+			retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
+			retrieved_rows = Min(retrieved_rows, foreignrel->tuples);
+
+			/*
+			 * Cost as though this were a seqscan, which is pessimistic.  We
+			 * effectively imagine the local_conds are being evaluated
+			 * remotely, too.
+			 */
+			startup_cost = 0;
+			run_cost = 0;
+			run_cost += seq_page_cost * foreignrel->pages;
+
+			startup_cost += foreignrel->baserestrictcost.startup;
+			cpu_per_tuple = cpu_tuple_cost +
+				foreignrel->baserestrictcost.per_tuple;
+			run_cost += cpu_per_tuple * foreignrel->tuples;
+
+			total_cost = startup_cost + run_cost;
+		}
+	}
+
+	/*
+	 * Cache the costs of the relation itself, without the transfer overhead
+	 * added below, for use in costing joins that include it.  Only the
+	 * unparameterized estimate is of interest for that.
+	 */
+	if (join_conds == NIL)
+	{
+		fpinfo->rel_startup_cost = startup_cost;
+		fpinfo->rel_total_cost = total_cost;
 	}
 
 	/*
@@ -1959,6 +2340,10 @@ create_cursor(ForeignScanState *node)
 	StringInfoData buf;
 	PGresult   *res;
 
+	/* The connection must not be busy with another scan's FETCH */
+	if (fsstate->conn_state->pendingScan)
+		process_pending_request(fsstate->conn_state);
+
 	/*
 	 * Construct array of query parameter values in text format.  We do the
 	 * conversions in the short-lived per-tuple context, so as not to cause a
@@ -2045,6 +2430,13 @@ fetch_more_data(ForeignScanState *node)
 	PGresult   *volatile res = NULL;
 	MemoryContext oldcontext;
 
+	/*
+	 * If another scan has a FETCH outstanding on our connection, we have to
+	 * collect its result before we can send ours.
+	 */
+	if (!fsstate->async_pending && fsstate->conn_state->pendingScan)
+		process_pending_request(fsstate->conn_state);
+
 	/*
 	 * We'll store the tuples in the batch_cxt.  First, flush the previous
 	 * batch.
@@ -2063,12 +2455,22 @@ fetch_more_data(ForeignScanState *node)
 		int			i;
 
 		/* The fetch size is arbitrary, but shouldn't be enormous. */
-		fetch_size = 100;
+		fetch_size = DEFAULT_FETCH_SIZE;
 
-		snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
-				 fetch_size, fsstate->cursor_number);
+		if (fsstate->async_pending)
+		{
+			/* Collect the result of the FETCH sent by fetch_more_data_begin */
+			res = pgfdw_get_result(conn, fsstate->query);
+			fsstate->async_pending = false;
+			fsstate->conn_state->pendingScan = NULL;
+		}
+		else
+		{
+			snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+					 fetch_size, fsstate->cursor_number);
 
-		res = PQexec(conn, sql);
+			res = PQexec(conn, sql);
+		}
 		/* On error, report the original query, not the FETCH. */
 		if (PQresultStatus(res) != PGRES_TUPLES_OK)
 			pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
@@ -2086,6 +2488,7 @@ fetch_more_data(ForeignScanState *node)
 										   fsstate->rel,
 										   fsstate->attinmeta,
 										   fsstate->retrieved_attrs,
+										   node,
 										   fsstate->temp_cxt);
 		}
 
@@ -2110,6 +2513,77 @@ fetch_more_data(ForeignScanState *node)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Send a FETCH for the node's next batch without waiting for the result,
+ * creating the cursor first if needed.  The result is collected by the next
+ * fetch_more_data call on the node.
+ */
+static void
+fetch_more_data_begin(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	StringInfoData buf;
+
+	Assert(!fsstate->async_pending);
+	Assert(fsstate->conn_state->pendingScan == NULL);
+
+	initStringInfo(&buf);
+
+	if (!fsstate->cursor_exists)
+	{
+		if (fsstate->numParams > 0)
+		{
+			/* Parameter values can't go in a multi-command string */
+			create_cursor(node);
+		}
+		else
+		{
+			/*
+			 * Send the DECLARE together with the first FETCH, so that the
+			 * whole scan startup takes a single round trip.
+			 */
+			appendStringInfo(&buf, "DECLARE c%u CURSOR FOR\n%s;\n",
+							 fsstate->cursor_number, fsstate->query);
+
+			/* Same setup as at the end of create_cursor */
+			fsstate->cursor_exists = true;
+			fsstate->tuples = NULL;
+			fsstate->num_tuples = 0;
+			fsstate->next_tuple = 0;
+			fsstate->fetch_ct_2 = 0;
+			fsstate->eof_reached = false;
+		}
+	}
+
+	appendStringInfo(&buf, "FETCH %d FROM c%u",
+					 DEFAULT_FETCH_SIZE, fsstate->cursor_number);
+
+	pgfdw_send_query(fsstate->conn, buf.data);
+
+	fsstate->async_pending = true;
+	fsstate->conn_state->pendingScan = node;
+
+	pfree(buf.data);
+}
+
+/*
+ * Collect the result of the FETCH that some scan has outstanding on the
+ * connection, storing it as that scan's next batch, so that the connection
+ * can be used for something else.
+ */
+static void
+process_pending_request(PgFdwConnState *conn_state)
+{
+	ForeignScanState *node = conn_state->pendingScan;
+
+	Assert(node != NULL);
+	Assert(((PgFdwScanState *) node->fdw_state)->async_pending);
+
+	fetch_more_data(node);
+
+	Assert(conn_state->pendingScan == NULL);
+}
+
 /*
  * Force assorted GUC parameters to settings that ensure that we'll output
  * data values in a form that is unambiguous to the remote server.
@@ -2184,9 +2658,10 @@ close_cursor(PGconn *conn, unsigned int cursor_number)
 /*
  * prepare_foreign_modify
  *		Establish a prepared statement for execution of INSERT/UPDATE/DELETE
+ *		command "query", and return its name
  */
-static void
-prepare_foreign_modify(PgFdwModifyState *fmstate)
+static char *
+prepare_foreign_modify(PgFdwModifyState *fmstate, const char *query)
 {
 	char		prep_name[NAMEDATALEN];
 	char	   *p_name;
@@ -2209,16 +2684,134 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 	 */
 	res = PQprepare(fmstate->conn,
 					p_name,
-					fmstate->query,
+					query,
 					0,
 					NULL);
 
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
-		pgfdw_report_error(ERROR, res, fmstate->conn, true, fmstate->query);
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, query);
 	PQclear(res);
 
-	/* This action shows that the prepare has been done. */
-	fmstate->p_name = p_name;
+	return p_name;
+}
+
+/*
+ * deallocate_foreign_modify
+ *		Destroy a prepared statement made by prepare_foreign_modify
+ */
+static void
+deallocate_foreign_modify(PgFdwModifyState *fmstate, const char *p_name)
+{
+	char		sql[64];
+	PGresult   *res;
+
+	if (fmstate->conn_state->pendingScan)
+		process_pending_request(fmstate->conn_state);
+
+	snprintf(sql, sizeof(sql), "DEALLOCATE %s", p_name);
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = PQexec(fmstate->conn, sql);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
+	PQclear(res);
+}
+
+/*
+ * get_batch_size_option
+ *		Get the number of rows to send per INSERT for a foreign table.
+ *		The table's setting overrides the server's; the default is 1.
+ */
+static int
+get_batch_size_option(Relation rel)
+{
+	ForeignTable *table = GetForeignTable(RelationGetRelid(rel));
+	ForeignServer *server = GetForeignServer(table->serverid);
+	int			batch_size = 1;
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = strtol(defGetString(def), NULL, 10);
+	}
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = strtol(defGetString(def), NULL, 10);
+	}
+
+	return batch_size;
+}
+
+/*
+ * execute_foreign_insert_batch
+ *		Send the rows collected for a batched INSERT to the remote server
+ *
+ * A full batch uses a statement prepared on first use; the partial batch
+ * left at the end of the statement is sent with a one-off query.
+ */
+static void
+execute_foreign_insert_batch(PgFdwModifyState *fmstate)
+{
+	int			nparams = fmstate->num_rows * fmstate->p_nums;
+	PGresult   *res;
+	char	   *sql;
+
+	Assert(fmstate->num_rows > 0);
+
+	/* The connection must not be busy with an asynchronous FETCH */
+	if (fmstate->conn_state->pendingScan)
+		process_pending_request(fmstate->conn_state);
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	if (fmstate->num_rows == fmstate->batch_size)
+	{
+		if (!fmstate->batch_p_name)
+			fmstate->batch_p_name = prepare_foreign_modify(fmstate,
+														fmstate->batch_query);
+		sql = fmstate->batch_query;
+		res = PQexecPrepared(fmstate->conn,
+							 fmstate->batch_p_name,
+							 nparams,
+							 fmstate->batch_values,
+							 NULL,
+							 NULL,
+							 0);
+	}
+	else
+	{
+		StringInfoData buf;
+
+		initStringInfo(&buf);
+		deparseBatchInsertSql(&buf, fmstate->query, fmstate->p_nums,
+							  fmstate->num_rows);
+		sql = buf.data;
+		res = PQexecParams(fmstate->conn,
+						   sql,
+						   nparams,
+						   NULL,
+						   fmstate->batch_values,
+						   NULL,
+						   NULL,
+						   0);
+	}
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
+	PQclear(res);
+
+	fmstate->num_rows = 0;
+	MemoryContextReset(fmstate->batch_cxt);
 }
 
 /*
@@ -2304,6 +2897,7 @@ store_returning_result(PgFdwModifyState *fmstate,
 											fmstate->rel,
 											fmstate->attinmeta,
 											fmstate->retrieved_attrs,
+											NULL,
 											fmstate->temp_cxt);
 		/* tuple will be deleted when it is cleared from the slot */
 		ExecStoreTuple(newtup, slot, InvalidBuffer, true);
@@ -2350,7 +2944,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	table = GetForeignTable(RelationGetRelid(relation));
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(relation->rd_rel->relowner, server->serverid);
-	conn = GetConnection(server, user, false);
+	conn = GetConnection(server, user, false, NULL);
 
 	/*
 	 * Construct command to get page count for relation.
@@ -2442,7 +3036,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 	table = GetForeignTable(RelationGetRelid(relation));
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(relation->rd_rel->relowner, server->serverid);
-	conn = GetConnection(server, user, false);
+	conn = GetConnection(server, user, false, NULL);
 
 	/*
 	 * Construct cursor that retrieves whole rows from remote.
@@ -2595,6 +3189,7 @@ analyze_row_processor(PGresult *res, int row, PgFdwAnalyzeState *astate)
 													   astate->rel,
 													   astate->attinmeta,
 													 astate->retrieved_attrs,
+													   NULL,
 													   astate->temp_cxt);
 
 		MemoryContextSwitchTo(oldcontext);
@@ -2643,7 +3238,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	 */
 	server = GetForeignServer(serverOid);
 	mapping = GetUserMapping(GetUserId(), server->serverid);
-	conn = GetConnection(server, mapping, false);
+	conn = GetConnection(server, mapping, false, NULL);
 
 	/* Don't attempt to import collation if remote server hasn't got it */
 	if (PQserverVersion(conn) < 90100)
@@ -2869,12 +3464,327 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	return commands;
 }
 
+/*
+ * Assess whether the join between inner and outer relations can be pushed down
+ * to the foreign server.  As a side effect, save information we obtain in this
+ * function to PgFdwRelationInfo passed in.
+ */
+static bool
+foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel, JoinType jointype,
+				RelOptInfo *outerrel, RelOptInfo *innerrel,
+				JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	PgFdwRelationInfo *fpinfo_o;
+	PgFdwRelationInfo *fpinfo_i;
+	ListCell   *lc;
+	List	   *joinclauses;
+	List	   *otherclauses;
+
+	/*
+	 * We support pushing down INNER, LEFT, RIGHT and FULL OUTER joins.
+	 * Constructing queries representing SEMI and ANTI joins is hard, hence
+	 * not considered right now.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT &&
+		jointype != JOIN_RIGHT && jointype != JOIN_FULL)
+		return false;
+
+	/*
+	 * If either of the joining relations is marked as unsafe to pushdown, the
+	 * join can not be pushed down.
+	 */
+	fpinfo = (PgFdwRelationInfo *) joinrel->fdw_private;
+	fpinfo_o = (PgFdwRelationInfo *) outerrel->fdw_private;
+	fpinfo_i = (PgFdwRelationInfo *) innerrel->fdw_private;
+	if (!fpinfo_o || !fpinfo_o->pushdown_safe ||
+		!fpinfo_i || !fpinfo_i->pushdown_safe)
+		return false;
+
+	/*
+	 * If joining relations have local conditions, those conditions are
+	 * required to be applied before joining the relations.  Hence the join
+	 * can not be pushed down.
+	 */
+	if (fpinfo_o->local_conds || fpinfo_i->local_conds)
+		return false;
+
+	/*
+	 * The remote query is run as a single user, so all the tables in it must
+	 * be checked as the same one; views owned by different users can't be
+	 * joined remotely.
+	 */
+	if (fpinfo_o->checkAsUser != fpinfo_i->checkAsUser)
+		return false;
+
+	/*
+	 * A placeholder that can be evaluated within this join would have to be
+	 * computed by the remote query, which we can't do.
+	 */
+	foreach(lc, root->placeholder_list)
+	{
+		PlaceHolderInfo *phinfo = (PlaceHolderInfo *) lfirst(lc);
+
+		if (bms_is_subset(phinfo->ph_eval_at, joinrel->relids))
+			return false;
+	}
+
+	/*
+	 * We can only fetch plain columns of the joined tables; anything else
+	 * in the target list, such as a whole-row reference or a system column,
+	 * keeps the join local.
+	 */
+	foreach(lc, joinrel->reltargetlist)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (!IsA(var, Var) || var->varattno <= 0)
+			return false;
+	}
+
+	/*
+	 * Separate restrict list into join quals and quals on join relation.  For
+	 * an outer join, the join quals are the ones in its ON clause, which must
+	 * all be shippable since they decide which rows get null-extended; any
+	 * other quals filter the join result.  For an inner join it makes no
+	 * difference, so we put the shippable quals in the ON clause and apply
+	 * the rest locally.
+	 */
+	joinclauses = NIL;
+	otherclauses = NIL;
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		bool		is_remote_clause = is_foreign_expr(root, joinrel,
+													   rinfo->clause);
+
+		if (IS_OUTER_JOIN(jointype) && !rinfo->is_pushed_down)
+		{
+			if (!is_remote_clause)
+				return false;
+			joinclauses = lappend(joinclauses, rinfo);
+		}
+		else if (IS_OUTER_JOIN(jointype))
+			otherclauses = lappend(otherclauses, rinfo);
+		else if (is_remote_clause)
+			joinclauses = lappend(joinclauses, rinfo);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+	}
+
+	foreach(lc, otherclauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (is_foreign_expr(root, joinrel, rinfo->clause))
+			fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+		else
+			fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+	}
+
+	/*
+	 * Pull the other remote conditions from the joining relations into join
+	 * clauses or other remote clauses (WHERE clause) as appropriate.  For an
+	 * inner join, the joining relations' conditions can go to the WHERE
+	 * clause.  For a left join, the outer relation's conditions filter the
+	 * result and go to the WHERE clause, while the inner relation's have to
+	 * be applied before null-extending, so they go to the ON clause; a right
+	 * join is the mirror image.  For a full join, neither side's conditions
+	 * can be moved without changing the result, so we give up.
+	 */
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										  list_copy(fpinfo_o->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										  list_copy(fpinfo_i->remote_conds));
+			break;
+
+		case JOIN_LEFT:
+			joinclauses = list_concat(joinclauses,
+									  list_copy(fpinfo_i->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										  list_copy(fpinfo_o->remote_conds));
+			break;
+
+		case JOIN_RIGHT:
+			joinclauses = list_concat(joinclauses,
+									  list_copy(fpinfo_o->remote_conds));
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+										  list_copy(fpinfo_i->remote_conds));
+			break;
+
+		case JOIN_FULL:
+			if (fpinfo_o->remote_conds || fpinfo_i->remote_conds)
+				return false;
+			break;
+
+		default:
+			/* Should not happen, we have just checked this above */
+			elog(ERROR, "unsupported join type %d", jointype);
+	}
+
+	fpinfo->outerrel = outerrel;
+	fpinfo->innerrel = innerrel;
+	fpinfo->jointype = jointype;
+	fpinfo->joinclauses = joinclauses;
+
+	/*
+	 * Both relations are on the same server, so take the server and the cost
+	 * options from the outer one.  Use remote estimates if either side asks
+	 * for them.
+	 */
+	fpinfo->server = fpinfo_o->server;
+	fpinfo->fdw_startup_cost = fpinfo_o->fdw_startup_cost;
+	fpinfo->fdw_tuple_cost = fpinfo_o->fdw_tuple_cost;
+	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate ||
+		fpinfo_i->use_remote_estimate;
+	fpinfo->checkAsUser = fpinfo_o->checkAsUser;
+	if (fpinfo->use_remote_estimate)
+	{
+		Oid			userid = fpinfo->checkAsUser ? fpinfo->checkAsUser : GetUserId();
+
+		fpinfo->user = GetUserMapping(userid, fpinfo->server->serverid);
+	}
+	else
+		fpinfo->user = NULL;
+
+	/*
+	 * Selectivity of the join clauses, used in local cost estimation; the
+	 * core code's estimate of the join's size covers all the quals.
+	 */
+	fpinfo->joinclause_sel = clauselist_selectivity(root, joinclauses, 0,
+													jointype, extra->sjinfo);
+
+	/*
+	 * Set the string describing this join relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.
+	 */
+	fpinfo->relation_name = makeStringInfo();
+	appendStringInfo(fpinfo->relation_name, "(%s) %s JOIN (%s)",
+					 fpinfo_o->relation_name->data,
+					 get_jointype_name(fpinfo->jointype),
+					 fpinfo_i->relation_name->data);
+
+	/* Mark that this join can be pushed down safely */
+	fpinfo->pushdown_safe = true;
+
+	return true;
+}
+
+/*
+ * postgresGetForeignJoinPaths
+ *		Add possible ForeignPath to joinrel, if join is safe to push down.
+ */
+static void
+postgresGetForeignJoinPaths(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	ForeignPath *joinpath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/*
+	 * Skip if this join combination has been considered already.  The core
+	 * code calls us once for each way of forming the join, but the remote
+	 * server gets the same query whichever pair we are given, so the first
+	 * one decides.
+	 */
+	if (joinrel->fdw_private)
+		return;
+
+	/*
+	 * A joined row can't be re-fetched from the remote server to recheck it
+	 * after a concurrent update, so only plain SELECTs without row locks are
+	 * considered; for anything else the join is done locally, where
+	 * EvalPlanQual works on the individual tables.
+	 */
+	if (root->parse->commandType != CMD_SELECT || root->rowMarks != NIL)
+		return;
+
+	/*
+	 * Create unfinished PgFdwRelationInfo entry which is used to indicate
+	 * that the join relation is already considered, so that we won't waste
+	 * time in judging safety of join pushdown and adding the same paths
+	 * again if found safe.  Once we know that this join can be pushed down,
+	 * we fill the entry.
+	 */
+	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	joinrel->fdw_private = fpinfo;
+
+	if (!foreign_join_ok(root, joinrel, jointype, outerrel, innerrel, extra))
+		return;
+
+	/*
+	 * Compute the selectivity and cost of the local_conds, so we don't have
+	 * to do it over again for each path.  The best we can do for these
+	 * conditions is to estimate selectivity on the basis of local statistics.
+	 * The local conditions are applied after the join has been computed on
+	 * the remote side like quals in WHERE clause, so pass jointype as
+	 * JOIN_INNER.
+	 */
+	fpinfo->local_conds_sel = clauselist_selectivity(root,
+													 fpinfo->local_conds,
+													 0,
+													 JOIN_INNER,
+													 NULL);
+	cost_qual_eval(&fpinfo->local_conds_cost, fpinfo->local_conds, root);
+
+	/* Estimate costs for bare join relation */
+	estimate_path_cost_size(root, joinrel, NIL, &rows, &width,
+							&startup_cost, &total_cost);
+
+	/*
+	 * If we are going to estimate costs locally, the core code's estimates
+	 * of the join's size stand; otherwise report what the remote server
+	 * thinks.
+	 */
+	if (fpinfo->use_remote_estimate)
+	{
+		joinrel->rows = rows;
+		joinrel->width = width;
+	}
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/*
+	 * Create a new join path and add it to the joinrel which represents a
+	 * join between foreign tables.  No sort orders are offered, and the path
+	 * is never parameterized.
+	 */
+	joinpath = create_foreignscan_path(root,
+									   joinrel,
+									   rows,
+									   startup_cost,
+									   total_cost,
+									   NIL,		/* no pathkeys */
+									   NULL,	/* no required_outer */
+									   NULL,	/* no epq_path */
+									   NIL);	/* no fdw_private */
+
+	/* Add generated path into joinrel by add_path(). */
+	add_path(joinrel, (Path *) joinpath);
+}
+
 /*
  * Create a tuple from the specified row of the PGresult.
  *
  * rel is the local representation of the foreign table, attinmeta is
  * conversion data for the rel's tupdesc, and retrieved_attrs is an
  * integer list of the table column numbers present in the PGresult.
+ * For a foreign join, rel is NULL, attinmeta is for the scan tuple's
+ * tupdesc, and fsstate is the scan, used to report conversion errors.
  * temp_context is a working context that can be reset after each tuple.
  */
 static HeapTuple
@@ -2883,10 +3793,11 @@ make_tuple_from_result_row(PGresult *res,
 						   Relation rel,
 						   AttInMetadata *attinmeta,
 						   List *retrieved_attrs,
+						   ForeignScanState *fsstate,
 						   MemoryContext temp_context)
 {
 	HeapTuple	tuple;
-	TupleDesc	tupdesc = RelationGetDescr(rel);
+	TupleDesc	tupdesc = attinmeta->tupdesc;
 	Datum	   *values;
 	bool	   *nulls;
 	ItemPointer ctid = NULL;
@@ -2915,6 +3826,7 @@ make_tuple_from_result_row(PGresult *res,
 	 */
 	errpos.rel = rel;
 	errpos.cur_attno = 0;
+	errpos.fsstate = fsstate;
 	errcallback.callback = conversion_error_callback;
 	errcallback.arg = (void *) &errpos;
 	errcallback.previous = error_context_stack;
@@ -3004,10 +3916,41 @@ static void
 conversion_error_callback(void *arg)
 {
 	ConversionLocation *errpos = (ConversionLocation *) arg;
-	TupleDesc	tupdesc = RelationGetDescr(errpos->rel);
 
-	if (errpos->cur_attno > 0 && errpos->cur_attno <= tupdesc->natts)
+	if (errpos->cur_attno <= 0)
+		return;
+
+	if (errpos->rel)
+	{
+		/* error occurred in a scan against a foreign table */
+		TupleDesc	tupdesc = RelationGetDescr(errpos->rel);
+
+		if (errpos->cur_attno <= tupdesc->natts)
+			errcontext("column \"%s\" of foreign table \"%s\"",
+					   NameStr(tupdesc->attrs[errpos->cur_attno - 1]->attname),
+					   RelationGetRelationName(errpos->rel));
+	}
+	else
+	{
+		/*
+		 * error occurred in a scan against a foreign join; the result column
+		 * is a Var of fdw_scan_tlist, which tells us the table and column
+		 */
+		ForeignScanState *fsstate = errpos->fsstate;
+		ForeignScan *fsplan = (ForeignScan *) fsstate->ss.ps.plan;
+		EState	   *estate = fsstate->ss.ps.state;
+		TargetEntry *tle;
+		Var		   *var;
+		RangeTblEntry *rte;
+
+		tle = (TargetEntry *) list_nth(fsplan->fdw_scan_tlist,
+									   errpos->cur_attno - 1);
+		var = (Var *) tle->expr;
+		Assert(IsA(var, Var));
+		rte = rt_fetch(var->varno, estate->es_range_table);
+
 		errcontext("column \"%s\" of foreign table \"%s\"",
-				   NameStr(tupdesc->attrs[errpos->cur_attno - 1]->attname),
-				   RelationGetRelationName(errpos->rel));
+				   get_relid_attribute_name(rte->relid, var->varattno),
+				   get_rel_name(rte->relid));
+	}
 }
@@ -20,16 +20,92 @@
 
 #include "libpq-fe.h"
 
+/*
+ * Extra state that is shared by all users of a remote connection.
+ *
+ * Only one query can be in progress on a connection at a time, so a scan
+ * that has sent an asynchronous FETCH records itself here; anybody else who
+ * wants to use the connection must collect that scan's result first.
+ */
+typedef struct PgFdwConnState
+{
+	struct ForeignScanState *pendingScan;	/* scan with a FETCH in flight */
+} PgFdwConnState;
+
+/*
+ * FDW-specific planner information kept in RelOptInfo.fdw_private for a
+ * foreign table or a foreign join.  For a foreign table this information is
+ * collected by postgresGetForeignRelSize, for a join by
+ * postgresGetForeignJoinPaths.
+ */
+typedef struct PgFdwRelationInfo
+{
+	/*
+	 * True means that the relation can be pushed down.  Always true for a
+	 * simple foreign table scan.
+	 */
+	bool		pushdown_safe;
+
+	/*
+	 * Restriction clauses, broken down into safe and unsafe subsets.  For a
+	 * join, remote_conds go in the remote query's WHERE clause.
+	 */
+	List	   *remote_conds;
+	List	   *local_conds;
+
+	/* Bitmap of attr numbers we need to fetch from the remote server. */
+	Bitmapset  *attrs_used;
+
+	/* Cost and selectivity of local_conds. */
+	QualCost	local_conds_cost;
+	Selectivity local_conds_sel;
+
+	/* Selectivity of join conditions */
+	Selectivity joinclause_sel;
+
+	/* Estimated size and cost for a scan or join with restriction quals. */
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/* Same costs, excluding the costs of transferring the rows. */
+	Cost		rel_startup_cost;
+	Cost		rel_total_cost;
+
+	/* Options extracted from catalogs. */
+	bool		use_remote_estimate;
+	Cost		fdw_startup_cost;
+	Cost		fdw_tuple_cost;
+
+	/* Cached catalog information. */
+	ForeignTable *table;		/* NULL for a join */
+	ForeignServer *server;
+	UserMapping *user;			/* only set in use_remote_estimate mode */
+	Oid			checkAsUser;	/* user to do the remote access as, or 0 */
+
+	/* Name of the relation, as shown by EXPLAIN */
+	StringInfo	relation_name;
+
+	/* Join information */
+	RelOptInfo *outerrel;
+	RelOptInfo *innerrel;
+	JoinType	jointype;
+	List	   *joinclauses;	/* conditions for the remote ON clause */
+} PgFdwRelationInfo;
+
 /* in postgres_fdw.c */
 extern int	set_transmission_modes(void);
 extern void reset_transmission_modes(int nestlevel);
 
 /* in connection.c */
 extern PGconn *GetConnection(ForeignServer *server, UserMapping *user,
-			  bool will_prep_stmt);
+			  bool will_prep_stmt, PgFdwConnState **state);
 extern void ReleaseConnection(PGconn *conn);
 extern unsigned int GetCursorNumber(PGconn *conn);
 extern unsigned int GetPrepStmtNumber(PGconn *conn);
+extern void pgfdw_send_query(PGconn *conn, const char *sql);
+extern PGresult *pgfdw_get_result(PGconn *conn, const char *query);
 extern void pgfdw_report_error(int elevel, PGresult *res, PGconn *conn,
 				   bool clear, const char *sql);
 
@@ -47,6 +123,7 @@ extern void classifyConditions(PlannerInfo *root,
 extern bool is_foreign_expr(PlannerInfo *root,
 				RelOptInfo *baserel,
 				Expr *expr);
+extern List *build_tlist_to_deparse(RelOptInfo *foreignrel);
 extern void deparseSelectSql(StringInfo buf,
 				 PlannerInfo *root,
 				 RelOptInfo *baserel,
@@ -58,10 +135,19 @@ extern void appendWhereClause(StringInfo buf,
 				  List *exprs,
 				  bool is_first,
 				  List **params);
+extern void deparseJoinSelectSql(StringInfo buf,
+					 PlannerInfo *root,
+					 RelOptInfo *joinrel,
+					 List *tlist,
+					 List *remote_conds,
+					 List **params);
+extern const char *get_jointype_name(JoinType jointype);
 extern void deparseInsertSql(StringInfo buf, PlannerInfo *root,
 				 Index rtindex, Relation rel,
 				 List *targetAttrs, bool doNothing, List *returningList,
 				 List **retrieved_attrs);
+extern void deparseBatchInsertSql(StringInfo buf, const char *orig_query,
+					  int num_params, int num_rows);
 extern void deparseUpdateSql(StringInfo buf, PlannerInfo *root,
 				 Index rtindex, Relation rel,
 				 List *targetAttrs, List *returningList,
@@ -201,10 +201,14 @@ EXPLAIN (VERBOSE, COSTS false) SELECT * FROM ft1 t1 WHERE c1 = ANY(ARRAY[c2, 1,
 EXPLAIN (VERBOSE, COSTS false) SELECT * FROM ft1 t1 WHERE c1 = (ARRAY[c1,c2,3])[1]; -- ArrayRef
 EXPLAIN (VERBOSE, COSTS false) SELECT * FROM ft1 t1 WHERE c6 = E'foo''s\\bar';  -- check special chars
 EXPLAIN (VERBOSE, COSTS false) SELECT * FROM ft1 t1 WHERE c8 = 'foo';  -- can't be sent to remote
--- parameterized remote path
+-- join between foreign tables on the same server is pushed down
 EXPLAIN (VERBOSE, COSTS false)
   SELECT * FROM ft2 a, ft2 b WHERE a.c1 = 47 AND b.c1 = a.c2;
 SELECT * FROM ft2 a, ft2 b WHERE a.c1 = 47 AND b.c1 = a.c2;
+-- parameterized remote path
+EXPLAIN (VERBOSE, COSTS false)
+  SELECT * FROM "S 1"."T 1" a, ft2 b WHERE a."C 1" = 47 AND b.c1 = a.c2;
+SELECT * FROM "S 1"."T 1" a, ft2 b WHERE a."C 1" = 47 AND b.c1 = a.c2;
 -- check both safe and unsafe join conditions
 EXPLAIN (VERBOSE, COSTS false)
   SELECT * FROM ft2 a, ft2 b
@@ -293,6 +297,7 @@ DROP FUNCTION f_test(int);
 -- ===================================================================
 ALTER FOREIGN TABLE ft1 ALTER COLUMN c8 TYPE int;
 SELECT * FROM ft1 WHERE c1 = 1;  -- ERROR
+SELECT ft1.c1, ft2.c2, ft1.c8 FROM ft1, ft2 WHERE ft1.c1 = ft2.c1 AND ft1.c1 = 1; -- ERROR
 ALTER FOREIGN TABLE ft1 ALTER COLUMN c8 TYPE user_enum;
 
 -- ===================================================================
@@ -792,6 +797,49 @@ drop table bar cascade;
 drop table loct1;
 drop table loct2;
 
+-- Check asynchronous execution of an inherited scan
+create table async_p (a int, b int);
+create table async_loct1 (a int, b int);
+create table async_loct2 (a int, b int);
+create foreign table async_p1 () inherits (async_p)
+  server loopback options (table_name 'async_loct1', async_capable 'true');
+create foreign table async_p2 () inherits (async_p)
+  server loopback options (table_name 'async_loct2', async_capable 'true');
+
+insert into async_loct1 select i, i % 10 from generate_series(1, 250) i;
+insert into async_loct2 select i, i % 10 from generate_series(251, 600) i;
+
+select count(*), sum(a), min(a), max(a) from async_p;
+select * from async_p where b = 3 order by a limit 5;
+select (select count(*) from async_p where a < t.x) from (values (10), (300)) t(x);
+
+drop table async_p cascade;
+drop table async_loct1;
+drop table async_loct2;
+
+-- ===================================================================
+-- test batched INSERT
+-- ===================================================================
+create table batch_loct (a int, b int);
+create foreign table batch_ft (a int, b int)
+  server loopback options (table_name 'batch_loct', batch_size '4');
+
+-- 10 rows make two full batches and a partial one
+explain (verbose, costs off)
+insert into batch_ft select i, i % 3 from generate_series(1, 10) i;
+insert into batch_ft select i, i % 3 from generate_series(1, 10) i;
+select count(*), sum(a), sum(b) from batch_loct;
+
+-- rows are sent one by one when RETURNING needs them
+explain (verbose, costs off)
+insert into batch_ft values (11, 2) returning *;
+insert into batch_ft values (11, 2) returning *;
+
+alter foreign table batch_ft options (set batch_size '0');  -- ERROR
+
+drop foreign table batch_ft;
+drop table batch_loct;
+
 -- ===================================================================
 -- test IMPORT FOREIGN SCHEMA
 -- ===================================================================
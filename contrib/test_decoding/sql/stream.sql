@@ -0,0 +1,37 @@
+SET synchronous_commit = on;
+
+-- small enough for the transactions below to exceed it
+SET logical_decoding_work_mem = '64kB';
+
+CREATE TABLE stream_test(data text);
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding');
+
+-- a large transaction is streamed in blocks while in progress
+INSERT INTO stream_test SELECT 'data' || g.i FROM generate_series(1, 5000) g(i);
+
+SELECT count(*) FILTER (WHERE data ~ '^opening') > 1 AS several_blocks,
+    count(*) FILTER (WHERE data ~ '^opening') = count(*) FILTER (WHERE data ~ '^closing') AS blocks_closed,
+    count(*) FILTER (WHERE data ~ '^streaming change') AS changes,
+    count(*) FILTER (WHERE data ~ '^committing') AS commits
+FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'stream-changes', '1');
+
+-- the blocks streamed for an aborted transaction have to be discarded
+BEGIN;
+INSERT INTO stream_test SELECT 'data' || g.i FROM generate_series(1, 5000) g(i);
+ROLLBACK;
+
+SELECT count(*) FILTER (WHERE data ~ '^opening') > 1 AS several_blocks,
+    count(*) FILTER (WHERE data ~ '^streaming change') BETWEEN 1 AND 4999 AS some_changes,
+    count(*) FILTER (WHERE data ~ '^aborting') AS aborts
+FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'stream-changes', '1');
+
+-- without the option, the transaction is only decoded at its commit
+INSERT INTO stream_test SELECT 'data' || g.i FROM generate_series(1, 5000) g(i);
+
+SELECT count(*), min(data), max(data) FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0')
+WHERE data !~ '^table';
+
+DROP TABLE stream_test;
+
+SELECT pg_drop_replication_slot('regression_slot');
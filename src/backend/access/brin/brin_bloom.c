@@ -0,0 +1,409 @@
+/*
+ * brin_bloom.c
+ *		Implementation of Bloom opclass for BRIN
+ *
+ * The minmax opclass is of no use for columns whose values are not
+ * correlated with the physical order of the table, such as identifiers or
+ * hostnames: every page range then covers most of the value space.  This
+ * opclass instead summarizes each page range as a bloom filter of the hashes
+ * of the values in it, which can still answer equality searches by saying
+ * "definitely not here" for most ranges, as long as each range holds a
+ * moderate number of distinct values.
+ *
+ * The filter is sized when the first value is added to a range, assuming
+ * that a tenth of the tuples that fit in the range are distinct, and for a
+ * false positive rate of about 1%.  Its size is capped so that the summary
+ * tuple fits comfortably in an index page even with several columns; ranges
+ * with many more distinct values than that simply produce more false
+ * positives.  The opclass needs the type's hash function as support
+ * procedure 15; only equality searches are supported.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/brin/brin_bloom.c
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/brin.h"
+#include "access/brin_internal.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/hash.h"
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/rel.h"
+
+
+/*
+ * Procedure numbers 11 to 14 are used by the inclusion opclasses, with other
+ * signatures; use the next free one.
+ */
+#define BLOOM_PROCNUM_HASH		15	/* required */
+
+/* assumed fraction of distinct values among the tuples of a range */
+#define BLOOM_NDISTINCT_FRACTION	0.1
+/* target false positive rate */
+#define BLOOM_FALSE_POSITIVE_RATE	0.01
+/* filter size limits, in bits */
+#define BLOOM_MIN_NBITS			(64 * BITS_PER_BYTE)
+#define BLOOM_MAX_NBITS			((BLCKSZ / 4) * BITS_PER_BYTE)
+/* number of hash functions limits */
+#define BLOOM_MAX_HASHES		8
+
+/*
+ * The summary stored for each column of a range.  It is a bytea as far as
+ * the BRIN tuple is concerned.
+ */
+typedef struct BloomFilter
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	uint16		nhashes;		/* number of hash functions */
+	uint16		flags;			/* currently unused */
+	uint32		nbits;			/* size of the bitmap, a multiple of 8 */
+	uint32		nbits_set;		/* number of bits set in the bitmap */
+	uint8		bitmap[FLEXIBLE_ARRAY_MEMBER];
+} BloomFilter;
+
+#define BloomFilterSize(nbits) \
+	(offsetof(BloomFilter, bitmap) + (nbits) / BITS_PER_BYTE)
+
+typedef struct BloomOpaque
+{
+	FmgrInfo	hash_procinfo;	/* initialized lazily */
+	uint32		nbits;			/* filter sizing; 0 if not computed yet */
+	uint16		nhashes;
+} BloomOpaque;
+
+Datum		brin_bloom_opcinfo(PG_FUNCTION_ARGS);
+Datum		brin_bloom_add_value(PG_FUNCTION_ARGS);
+Datum		brin_bloom_consistent(PG_FUNCTION_ARGS);
+Datum		brin_bloom_union(PG_FUNCTION_ARGS);
+static BloomFilter *bloom_create(BrinDesc *bdesc, uint16 attno);
+static bool bloom_add_hash(BloomFilter *filter, uint32 hash);
+static bool bloom_contains_hash(BloomFilter *filter, uint32 hash);
+static uint32 bloom_hash_value(BrinDesc *bdesc, uint16 attno, Oid colloid,
+				 Datum value);
+
+
+Datum
+brin_bloom_opcinfo(PG_FUNCTION_ARGS)
+{
+	BrinOpcInfo *result;
+
+	/*
+	 * opaque->hash_procinfo is initialized lazily; here it is set to
+	 * uninitialized by palloc0 which sets fn_oid to InvalidOid.
+	 *
+	 * The stored summary is a bytea, whatever the type of the column.
+	 */
+	result = palloc0(MAXALIGN(SizeofBrinOpcInfo(1)) +
+					 sizeof(BloomOpaque));
+	result->oi_nstored = 1;
+	result->oi_opaque = (BloomOpaque *)
+		MAXALIGN((char *) result + SizeofBrinOpcInfo(1));
+	result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Add the hash of the new value to the filter of the range.  Return true if
+ * this changed the filter, false otherwise.
+ */
+Datum
+brin_bloom_add_value(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum		newval = PG_GETARG_DATUM(2);
+	bool		isnull = PG_GETARG_DATUM(3);
+	Oid			colloid = PG_GET_COLLATION();
+	BloomFilter *filter;
+	uint32		hash;
+	bool		updated;
+
+	/*
+	 * If the new value is null, we record that we saw it if it's the first
+	 * one; otherwise, there's nothing to do.
+	 */
+	if (isnull)
+	{
+		if (column->bv_hasnulls)
+			PG_RETURN_BOOL(false);
+
+		column->bv_hasnulls = true;
+		PG_RETURN_BOOL(true);
+	}
+
+	hash = bloom_hash_value(bdesc, column->bv_attno, colloid, newval);
+
+	/*
+	 * If the recorded value is null, start a new filter with just the new
+	 * value in it, and we're done.
+	 */
+	if (column->bv_allnulls)
+	{
+		filter = bloom_create(bdesc, column->bv_attno);
+		bloom_add_hash(filter, hash);
+		column->bv_values[0] = PointerGetDatum(filter);
+		column->bv_allnulls = false;
+		PG_RETURN_BOOL(true);
+	}
+
+	/*
+	 * Otherwise, add it to a copy of the existing filter, which we only keep
+	 * if that changed anything.
+	 */
+	filter = (BloomFilter *) PG_DETOAST_DATUM_COPY(column->bv_values[0]);
+	updated = bloom_add_hash(filter, hash);
+	if (updated)
+	{
+		pfree(DatumGetPointer(column->bv_values[0]));
+		column->bv_values[0] = PointerGetDatum(filter);
+	}
+	else
+		pfree(filter);
+
+	PG_RETURN_BOOL(updated);
+}
+
+/*
+ * Given an index tuple corresponding to a certain page range and a scan key,
+ * return whether the scan key is consistent with the index tuple's filter.
+ * Return true if so, false otherwise.
+ */
+Datum
+brin_bloom_consistent(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	ScanKey		key = (ScanKey) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION();
+	BloomFilter *filter;
+	uint32		hash;
+
+	Assert(key->sk_attno == column->bv_attno);
+
+	/* handle IS NULL/IS NOT NULL tests */
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+		{
+			if (column->bv_allnulls || column->bv_hasnulls)
+				PG_RETURN_BOOL(true);
+			PG_RETURN_BOOL(false);
+		}
+
+		/*
+		 * For IS NOT NULL, we can only skip ranges that are known to have
+		 * only nulls.
+		 */
+		if (key->sk_flags & SK_SEARCHNOTNULL)
+			PG_RETURN_BOOL(!column->bv_allnulls);
+
+		/*
+		 * Neither IS NULL nor IS NOT NULL was used; assume all indexable
+		 * operators are strict and return false.
+		 */
+		PG_RETURN_BOOL(false);
+	}
+
+	/* if the range is all empty, it cannot possibly be consistent */
+	if (column->bv_allnulls)
+		PG_RETURN_BOOL(false);
+
+	if (key->sk_strategy != HTEqualStrategyNumber)
+		elog(ERROR, "invalid strategy number %d", key->sk_strategy);
+
+	filter = (BloomFilter *) PG_DETOAST_DATUM(column->bv_values[0]);
+	hash = bloom_hash_value(bdesc, key->sk_attno, colloid,
+							key->sk_argument);
+
+	PG_RETURN_BOOL(bloom_contains_hash(filter, hash));
+}
+
+/*
+ * Given two BrinValues, update the first of them as a union of the summary
+ * values contained in both.  The second one is untouched.
+ */
+Datum
+brin_bloom_union(PG_FUNCTION_ARGS)
+{
+	BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+	BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+	BloomFilter *filter_a;
+	BloomFilter *filter_b;
+	uint32		i;
+
+	Assert(col_a->bv_attno == col_b->bv_attno);
+
+	/* Adjust "hasnulls" */
+	if (!col_a->bv_hasnulls && col_b->bv_hasnulls)
+		col_a->bv_hasnulls = true;
+
+	/* If there are no values in B, there's nothing left to do */
+	if (col_b->bv_allnulls)
+		PG_RETURN_VOID();
+
+	/*
+	 * Adjust "allnulls".  If A doesn't have values, just copy the filter from
+	 * B into A, and we're done.
+	 */
+	if (col_a->bv_allnulls)
+	{
+		col_a->bv_allnulls = false;
+		col_a->bv_values[0] =
+			PointerGetDatum(PG_DETOAST_DATUM_COPY(col_b->bv_values[0]));
+		PG_RETURN_VOID();
+	}
+
+	filter_a = (BloomFilter *) PG_DETOAST_DATUM_COPY(col_a->bv_values[0]);
+	filter_b = (BloomFilter *) PG_DETOAST_DATUM(col_b->bv_values[0]);
+
+	/* both filters were sized for the same index, so they must agree */
+	if (filter_a->nbits != filter_b->nbits ||
+		filter_a->nhashes != filter_b->nhashes)
+		elog(ERROR, "cannot merge bloom filters of different sizes");
+
+	filter_a->nbits_set = 0;
+	for (i = 0; i < filter_a->nbits / BITS_PER_BYTE; i++)
+	{
+		uint8		byte;
+		int			bit;
+
+		filter_a->bitmap[i] |= filter_b->bitmap[i];
+		for (byte = filter_a->bitmap[i], bit = 0; bit < BITS_PER_BYTE; bit++)
+			filter_a->nbits_set += (byte >> bit) & 1;
+	}
+
+	pfree(DatumGetPointer(col_a->bv_values[0]));
+	col_a->bv_values[0] = PointerGetDatum(filter_a);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Create an empty filter, sized for the page ranges of the index.
+ */
+static BloomFilter *
+bloom_create(BrinDesc *bdesc, uint16 attno)
+{
+	BloomOpaque *opaque;
+	BloomFilter *filter;
+	Size		size;
+
+	opaque = (BloomOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	if (opaque->nbits == 0)
+	{
+		double		ndistinct;
+		double		nbits;
+		double		nhashes;
+
+		ndistinct = (double) BrinGetPagesPerRange(bdesc->bd_index) *
+			MaxHeapTuplesPerPage * BLOOM_NDISTINCT_FRACTION;
+		ndistinct = Max(ndistinct, 1.0);
+
+		/* optimal filter size for the target false positive rate ... */
+		nbits = ceil(-ndistinct * log(BLOOM_FALSE_POSITIVE_RATE) /
+					 (M_LN2 * M_LN2));
+		nbits = Max(nbits, BLOOM_MIN_NBITS);
+		nbits = Min(nbits, BLOOM_MAX_NBITS);
+		opaque->nbits = (uint32) (ceil(nbits / BITS_PER_BYTE) * BITS_PER_BYTE);
+
+		/* ... and number of hash functions for that size */
+		nhashes = rint(opaque->nbits / ndistinct * M_LN2);
+		nhashes = Max(nhashes, 1);
+		nhashes = Min(nhashes, BLOOM_MAX_HASHES);
+		opaque->nhashes = (uint16) nhashes;
+	}
+
+	size = BloomFilterSize(opaque->nbits);
+	filter = (BloomFilter *) palloc0(size);
+	SET_VARSIZE(filter, size);
+	filter->nhashes = opaque->nhashes;
+	filter->nbits = opaque->nbits;
+
+	return filter;
+}
+
+/*
+ * Add a hash value to the filter.  Returns whether any bit changed.
+ *
+ * The nhashes bit positions are derived from the one hash value by double
+ * hashing, the second hash being a rehash of the first one.
+ */
+static bool
+bloom_add_hash(BloomFilter *filter, uint32 hash)
+{
+	uint32		h2 = DatumGetUInt32(hash_uint32(hash)) | 1;
+	bool		updated = false;
+	int			i;
+
+	for (i = 0; i < filter->nhashes; i++)
+	{
+		uint32		bit = (hash + i * h2) % filter->nbits;
+		uint8		mask = 1 << (bit % BITS_PER_BYTE);
+
+		if ((filter->bitmap[bit / BITS_PER_BYTE] & mask) == 0)
+		{
+			filter->bitmap[bit / BITS_PER_BYTE] |= mask;
+			filter->nbits_set++;
+			updated = true;
+		}
+	}
+
+	return updated;
+}
+
+/*
+ * Might the filter contain a value with the given hash?
+ */
+static bool
+bloom_contains_hash(BloomFilter *filter, uint32 hash)
+{
+	uint32		h2 = DatumGetUInt32(hash_uint32(hash)) | 1;
+	int			i;
+
+	/* a saturated filter matches everything; don't bother checking */
+	if (filter->nbits_set == filter->nbits)
+		return true;
+
+	for (i = 0; i < filter->nhashes; i++)
+	{
+		uint32		bit = (hash + i * h2) % filter->nbits;
+
+		if ((filter->bitmap[bit / BITS_PER_BYTE] &
+			 (1 << (bit % BITS_PER_BYTE))) == 0)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Hash a value of the column with the opclass' hash support procedure,
+ * which is looked up on first use and cached in the opaque struct.
+ */
+static uint32
+bloom_hash_value(BrinDesc *bdesc, uint16 attno, Oid colloid, Datum value)
+{
+	BloomOpaque *opaque;
+
+	opaque = (BloomOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	if (opaque->hash_procinfo.fn_oid == InvalidOid)
+		fmgr_info_copy(&opaque->hash_procinfo,
+					   index_getprocinfo(bdesc->bd_index, attno,
+										 BLOOM_PROCNUM_HASH),
+					   bdesc->bd_context);
+
+	return DatumGetUInt32(FunctionCall1Coll(&opaque->hash_procinfo, colloid,
+											value));
+}
@@ -0,0 +1,733 @@
+/*
+ * brin_minmax_multi.c
+ *		Implementation of Multi Min/Max opclass for BRIN
+ *
+ * The minmax opclass summarizes a page range with a single [min, max]
+ * interval, which becomes useless as soon as a range contains a few outlier
+ * values, for example after some old rows were updated into the most recent
+ * pages of a time-series table.  This opclass keeps up to
+ * MINMAX_MULTI_MAX_RANGES disjoint intervals per page range instead.  A new
+ * value not covered by any of them is added as a single-point interval; when
+ * there are too many intervals, the two that are closest to each other are
+ * merged, so the summary keeps the large gaps between clusters of values,
+ * which are the ones that let scans skip the range.
+ *
+ * Finding the closest intervals needs a notion of distance between values,
+ * so each opclass provides a distance function as support procedure 11.  The
+ * comparisons themselves use the btree-strategy operators of the opfamily,
+ * as in minmax.  Only fixed-length types are supported; the intervals are
+ * stored as a bytea holding their boundaries one after another.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/brin/brin_minmax_multi.c
+ */
+#include "postgres.h"
+
+#include "access/brin_internal.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/stratnum.h"
+#include "catalog/pg_amop.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+
+#define MINMAX_MULTI_PROCNUM_DISTANCE	11	/* required */
+
+/* maximum number of intervals kept per page range */
+#define MINMAX_MULTI_MAX_RANGES		16
+
+/*
+ * The summary stored for each column of a range.  It is a bytea as far as
+ * the BRIN tuple is concerned; the boundaries, typlen bytes each and not
+ * necessarily aligned, follow the header in order: min and max of the first
+ * interval, then of the second one, and so on.
+ */
+typedef struct MinmaxMultiSummary
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int32		nranges;		/* number of intervals */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} MinmaxMultiSummary;
+
+/*
+ * In-memory, deserialized form of a summary.  It has room for twice the
+ * number of intervals kept on disk, which is what a union may temporarily
+ * need.
+ */
+typedef struct MinmaxMultiRanges
+{
+	int			nranges;
+	Datum		values[4 * MINMAX_MULTI_MAX_RANGES];
+} MinmaxMultiRanges;
+
+#define RangeMin(r, i)	((r)->values[2 * (i)])
+#define RangeMax(r, i)	((r)->values[2 * (i) + 1])
+
+typedef struct MinmaxMultiOpaque
+{
+	Oid			cached_subtype;
+	FmgrInfo	distance_procinfo;	/* initialized lazily */
+	FmgrInfo	strategy_procinfos[BTMaxStrategyNumber];
+} MinmaxMultiOpaque;
+
+Datum		brin_minmax_multi_opcinfo(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_add_value(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_consistent(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_union(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_int4(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_int8(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_float8(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_date(PG_FUNCTION_ARGS);
+Datum		brin_minmax_multi_distance_timestamp(PG_FUNCTION_ARGS);
+static Datum fetch_unaligned_byval(const char *ptr, int16 typlen);
+static void store_unaligned_byval(char *ptr, Datum value, int16 typlen);
+static void ranges_deserialize(Form_pg_attribute attr, Datum summary,
+				   MinmaxMultiRanges *ranges);
+static Datum ranges_serialize(Form_pg_attribute attr,
+				 MinmaxMultiRanges *ranges);
+static void ranges_reduce(BrinDesc *bdesc, uint16 attno, Oid colloid,
+			  MinmaxMultiRanges *ranges, int maxranges);
+static bool value_less_than(BrinDesc *bdesc, uint16 attno, Oid colloid,
+				Datum a, Datum b);
+static FmgrInfo *minmax_multi_get_strategy_procinfo(BrinDesc *bdesc,
+								   uint16 attno, Oid subtype,
+								   uint16 strategynum);
+
+
+Datum
+brin_minmax_multi_opcinfo(PG_FUNCTION_ARGS)
+{
+	Oid			typoid = PG_GETARG_OID(0);
+	BrinOpcInfo *result;
+
+	if (get_typlen(typoid) <= 0)
+		elog(ERROR, "multi-minmax opclass does not support variable-length type %s",
+			 format_type_be(typoid));
+
+	/*
+	 * opaque->strategy_procinfos and opaque->distance_procinfo are
+	 * initialized lazily; here they are set to all-uninitialized by palloc0
+	 * which sets fn_oid to InvalidOid.
+	 *
+	 * The stored summary is a bytea, whatever the type of the column.
+	 */
+	result = palloc0(MAXALIGN(SizeofBrinOpcInfo(1)) +
+					 sizeof(MinmaxMultiOpaque));
+	result->oi_nstored = 1;
+	result->oi_opaque = (MinmaxMultiOpaque *)
+		MAXALIGN((char *) result + SizeofBrinOpcInfo(1));
+	result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Examine the given index tuple (which contains partial status of a certain
+ * page range) by comparing it to the given value that comes from another heap
+ * tuple.  If the new value is not covered by any of the intervals of the
+ * existing tuple, add it, update the index tuple and return true.  Otherwise,
+ * return false and do not modify in this case.
+ */
+Datum
+brin_minmax_multi_add_value(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum		newval = PG_GETARG_DATUM(2);
+	bool		isnull = PG_GETARG_DATUM(3);
+	Oid			colloid = PG_GET_COLLATION();
+	Form_pg_attribute attr;
+	AttrNumber	attno;
+	MinmaxMultiRanges ranges;
+	int			i;
+
+	/*
+	 * If the new value is null, we record that we saw it if it's the first
+	 * one; otherwise, there's nothing to do.
+	 */
+	if (isnull)
+	{
+		if (column->bv_hasnulls)
+			PG_RETURN_BOOL(false);
+
+		column->bv_hasnulls = true;
+		PG_RETURN_BOOL(true);
+	}
+
+	attno = column->bv_attno;
+	attr = bdesc->bd_tupdesc->attrs[attno - 1];
+
+	/*
+	 * If the recorded value is null, store the new value as the only
+	 * interval, and we're done.
+	 */
+	if (column->bv_allnulls)
+	{
+		ranges.nranges = 1;
+		RangeMin(&ranges, 0) = RangeMax(&ranges, 0) = newval;
+		column->bv_values[0] = ranges_serialize(attr, &ranges);
+		column->bv_allnulls = false;
+		PG_RETURN_BOOL(true);
+	}
+
+	/*
+	 * Otherwise, look for the first interval whose maximum is not less than
+	 * the new value.  If its minimum isn't greater than the value either, the
+	 * value is already covered.
+	 */
+	ranges_deserialize(attr, column->bv_values[0], &ranges);
+	for (i = 0; i < ranges.nranges; i++)
+	{
+		if (!value_less_than(bdesc, attno, colloid, RangeMax(&ranges, i),
+							 newval))
+			break;
+	}
+	if (i < ranges.nranges &&
+		!value_less_than(bdesc, attno, colloid, newval, RangeMin(&ranges, i)))
+		PG_RETURN_BOOL(false);
+
+	/* insert a single-point interval before the i'th one */
+	memmove(&RangeMin(&ranges, i + 1), &RangeMin(&ranges, i),
+			sizeof(Datum) * 2 * (ranges.nranges - i));
+	RangeMin(&ranges, i) = RangeMax(&ranges, i) = newval;
+	ranges.nranges++;
+
+	ranges_reduce(bdesc, attno, colloid, &ranges, MINMAX_MULTI_MAX_RANGES);
+
+	pfree(DatumGetPointer(column->bv_values[0]));
+	column->bv_values[0] = ranges_serialize(attr, &ranges);
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Given an index tuple corresponding to a certain page range and a scan key,
+ * return whether the scan key is consistent with the index tuple's intervals.
+ * Return true if so, false otherwise.
+ */
+Datum
+brin_minmax_multi_consistent(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	ScanKey		key = (ScanKey) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION(),
+				subtype;
+	AttrNumber	attno;
+	Datum		value;
+	Datum		matches;
+	FmgrInfo   *finfo;
+	MinmaxMultiRanges ranges;
+	int			i;
+
+	Assert(key->sk_attno == column->bv_attno);
+
+	/* handle IS NULL/IS NOT NULL tests */
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+		{
+			if (column->bv_allnulls || column->bv_hasnulls)
+				PG_RETURN_BOOL(true);
+			PG_RETURN_BOOL(false);
+		}
+
+		/*
+		 * For IS NOT NULL, we can only skip ranges that are known to have
+		 * only nulls.
+		 */
+		if (key->sk_flags & SK_SEARCHNOTNULL)
+			PG_RETURN_BOOL(!column->bv_allnulls);
+
+		/*
+		 * Neither IS NULL nor IS NOT NULL was used; assume all indexable
+		 * operators are strict and return false.
+		 */
+		PG_RETURN_BOOL(false);
+	}
+
+	/* if the range is all empty, it cannot possibly be consistent */
+	if (column->bv_allnulls)
+		PG_RETURN_BOOL(false);
+
+	attno = key->sk_attno;
+	subtype = key->sk_subtype;
+	value = key->sk_argument;
+	ranges_deserialize(bdesc->bd_tupdesc->attrs[attno - 1],
+					   column->bv_values[0], &ranges);
+	switch (key->sk_strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			/* only the overall minimum matters */
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   key->sk_strategy);
+			matches = FunctionCall2Coll(finfo, colloid,
+										RangeMin(&ranges, 0), value);
+			break;
+		case BTEqualStrategyNumber:
+
+			/*
+			 * In the equality case (WHERE col = someval), we want to return
+			 * the current page range if any of the intervals contains the
+			 * scan key.
+			 */
+			matches = BoolGetDatum(false);
+			for (i = 0; i < ranges.nranges; i++)
+			{
+				finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+												 BTLessEqualStrategyNumber);
+				if (!DatumGetBool(FunctionCall2Coll(finfo, colloid,
+													RangeMin(&ranges, i),
+													value)))
+					break;		/* this and all later intervals are above */
+				finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+											  BTGreaterEqualStrategyNumber);
+				if (DatumGetBool(FunctionCall2Coll(finfo, colloid,
+												   RangeMax(&ranges, i),
+												   value)))
+				{
+					matches = BoolGetDatum(true);
+					break;
+				}
+			}
+			break;
+		case BTGreaterEqualStrategyNumber:
+		case BTGreaterStrategyNumber:
+			/* only the overall maximum matters */
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   key->sk_strategy);
+			matches = FunctionCall2Coll(finfo, colloid,
+										RangeMax(&ranges, ranges.nranges - 1),
+										value);
+			break;
+		default:
+			/* shouldn't happen */
+			elog(ERROR, "invalid strategy number %d", key->sk_strategy);
+			matches = 0;
+			break;
+	}
+
+	PG_RETURN_DATUM(matches);
+}
+
+/*
+ * Given two BrinValues, update the first of them as a union of the summary
+ * values contained in both.  The second one is untouched.
+ */
+Datum
+brin_minmax_multi_union(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+	BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION();
+	AttrNumber	attno;
+	Form_pg_attribute attr;
+	MinmaxMultiRanges ranges_a;
+	MinmaxMultiRanges ranges_b;
+	MinmaxMultiRanges merged;
+	int			ia,
+				ib;
+
+	Assert(col_a->bv_attno == col_b->bv_attno);
+
+	/* Adjust "hasnulls" */
+	if (!col_a->bv_hasnulls && col_b->bv_hasnulls)
+		col_a->bv_hasnulls = true;
+
+	/* If there are no values in B, there's nothing left to do */
+	if (col_b->bv_allnulls)
+		PG_RETURN_VOID();
+
+	attno = col_a->bv_attno;
+	attr = bdesc->bd_tupdesc->attrs[attno - 1];
+
+	/*
+	 * Adjust "allnulls".  If A doesn't have values, just copy the values from
+	 * B into A, and we're done.  We cannot run the operators in this case,
+	 * because values in A might contain garbage.  Note we already established
+	 * that B contains values.
+	 */
+	if (col_a->bv_allnulls)
+	{
+		col_a->bv_allnulls = false;
+		col_a->bv_values[0] =
+			PointerGetDatum(PG_DETOAST_DATUM_COPY(col_b->bv_values[0]));
+		PG_RETURN_VOID();
+	}
+
+	ranges_deserialize(attr, col_a->bv_values[0], &ranges_a);
+	ranges_deserialize(attr, col_b->bv_values[0], &ranges_b);
+
+	/*
+	 * Merge the two sorted lists of intervals by their minimum, coalescing
+	 * the ones that overlap.
+	 */
+	merged.nranges = 0;
+	ia = ib = 0;
+	while (ia < ranges_a.nranges || ib < ranges_b.nranges)
+	{
+		Datum		min;
+		Datum		max;
+
+		if (ib >= ranges_b.nranges ||
+			(ia < ranges_a.nranges &&
+			 !value_less_than(bdesc, attno, colloid, RangeMin(&ranges_b, ib),
+							  RangeMin(&ranges_a, ia))))
+		{
+			min = RangeMin(&ranges_a, ia);
+			max = RangeMax(&ranges_a, ia);
+			ia++;
+		}
+		else
+		{
+			min = RangeMin(&ranges_b, ib);
+			max = RangeMax(&ranges_b, ib);
+			ib++;
+		}
+
+		if (merged.nranges > 0 &&
+			!value_less_than(bdesc, attno, colloid,
+							 RangeMax(&merged, merged.nranges - 1), min))
+		{
+			/* overlaps the previous interval; extend it if needed */
+			if (value_less_than(bdesc, attno, colloid,
+								RangeMax(&merged, merged.nranges - 1), max))
+				RangeMax(&merged, merged.nranges - 1) = max;
+		}
+		else
+		{
+			RangeMin(&merged, merged.nranges) = min;
+			RangeMax(&merged, merged.nranges) = max;
+			merged.nranges++;
+		}
+	}
+
+	ranges_reduce(bdesc, attno, colloid, &merged, MINMAX_MULTI_MAX_RANGES);
+
+	pfree(DatumGetPointer(col_a->bv_values[0]));
+	col_a->bv_values[0] = ranges_serialize(attr, &merged);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Distance functions, support procedure 11 of the opclasses.  They return
+ * how far apart two values are, the first never being greater than the
+ * second.  Only the relative order of distances matters.
+ */
+Datum
+brin_minmax_multi_distance_int4(PG_FUNCTION_ARGS)
+{
+	int32		a = PG_GETARG_INT32(0);
+	int32		b = PG_GETARG_INT32(1);
+
+	PG_RETURN_FLOAT8((float8) b - (float8) a);
+}
+
+Datum
+brin_minmax_multi_distance_int8(PG_FUNCTION_ARGS)
+{
+	int64		a = PG_GETARG_INT64(0);
+	int64		b = PG_GETARG_INT64(1);
+
+	PG_RETURN_FLOAT8((float8) b - (float8) a);
+}
+
+Datum
+brin_minmax_multi_distance_float8(PG_FUNCTION_ARGS)
+{
+	float8		a = PG_GETARG_FLOAT8(0);
+	float8		b = PG_GETARG_FLOAT8(1);
+
+	PG_RETURN_FLOAT8(b - a);
+}
+
+Datum
+brin_minmax_multi_distance_date(PG_FUNCTION_ARGS)
+{
+	DateADT		a = PG_GETARG_DATEADT(0);
+	DateADT		b = PG_GETARG_DATEADT(1);
+
+	PG_RETURN_FLOAT8((float8) b - (float8) a);
+}
+
+/* used for both timestamp and timestamptz */
+Datum
+brin_minmax_multi_distance_timestamp(PG_FUNCTION_ARGS)
+{
+	Timestamp	a = PG_GETARG_TIMESTAMP(0);
+	Timestamp	b = PG_GETARG_TIMESTAMP(1);
+
+	PG_RETURN_FLOAT8((float8) b - (float8) a);
+}
+
+/*
+ * Fetch and store pass-by-value datums at possibly unaligned addresses.
+ */
+static Datum
+fetch_unaligned_byval(const char *ptr, int16 typlen)
+{
+	switch (typlen)
+	{
+		case sizeof(char):
+			return CharGetDatum(*ptr);
+		case sizeof(int16):
+			{
+				int16		v;
+
+				memcpy(&v, ptr, sizeof(v));
+				return Int16GetDatum(v);
+			}
+		case sizeof(int32):
+			{
+				int32		v;
+
+				memcpy(&v, ptr, sizeof(v));
+				return Int32GetDatum(v);
+			}
+#if SIZEOF_DATUM == 8
+		case sizeof(Datum):
+			{
+				Datum		v;
+
+				memcpy(&v, ptr, sizeof(v));
+				return v;
+			}
+#endif
+		default:
+			elog(ERROR, "unsupported byval length: %d", (int) typlen);
+			return 0;			/* keep compiler quiet */
+	}
+}
+
+static void
+store_unaligned_byval(char *ptr, Datum value, int16 typlen)
+{
+	switch (typlen)
+	{
+		case sizeof(char):
+			*ptr = DatumGetChar(value);
+			break;
+		case sizeof(int16):
+			{
+				int16		v = DatumGetInt16(value);
+
+				memcpy(ptr, &v, sizeof(v));
+				break;
+			}
+		case sizeof(int32):
+			{
+				int32		v = DatumGetInt32(value);
+
+				memcpy(ptr, &v, sizeof(v));
+				break;
+			}
+#if SIZEOF_DATUM == 8
+		case sizeof(Datum):
+			memcpy(ptr, &value, sizeof(value));
+			break;
+#endif
+		default:
+			elog(ERROR, "unsupported byval length: %d", (int) typlen);
+	}
+}
+
+/*
+ * Unpack a stored summary.  Pass-by-reference values are copied out, since
+ * the boundaries in the summary are not aligned.
+ */
+static void
+ranges_deserialize(Form_pg_attribute attr, Datum summary,
+				   MinmaxMultiRanges *ranges)
+{
+	MinmaxMultiSummary *s;
+	char	   *ptr;
+	int			i;
+
+	s = (MinmaxMultiSummary *) PG_DETOAST_DATUM(summary);
+	Assert(s->nranges > 0 && s->nranges <= MINMAX_MULTI_MAX_RANGES);
+
+	ranges->nranges = s->nranges;
+	ptr = s->data;
+	for (i = 0; i < 2 * s->nranges; i++)
+	{
+		if (attr->attbyval)
+			ranges->values[i] = fetch_unaligned_byval(ptr, attr->attlen);
+		else
+		{
+			char	   *copy = (char *) palloc(attr->attlen);
+
+			memcpy(copy, ptr, attr->attlen);
+			ranges->values[i] = PointerGetDatum(copy);
+		}
+		ptr += attr->attlen;
+	}
+}
+
+/*
+ * Pack a set of intervals into a new summary.
+ */
+static Datum
+ranges_serialize(Form_pg_attribute attr, MinmaxMultiRanges *ranges)
+{
+	MinmaxMultiSummary *s;
+	Size		size;
+	char	   *ptr;
+	int			i;
+
+	Assert(ranges->nranges > 0 &&
+		   ranges->nranges <= MINMAX_MULTI_MAX_RANGES);
+
+	size = offsetof(MinmaxMultiSummary, data) +
+		(Size) attr->attlen * 2 * ranges->nranges;
+	s = (MinmaxMultiSummary *) palloc(size);
+	SET_VARSIZE(s, size);
+	s->nranges = ranges->nranges;
+
+	ptr = s->data;
+	for (i = 0; i < 2 * ranges->nranges; i++)
+	{
+		if (attr->attbyval)
+			store_unaligned_byval(ptr, ranges->values[i], attr->attlen);
+		else
+			memcpy(ptr, DatumGetPointer(ranges->values[i]), attr->attlen);
+		ptr += attr->attlen;
+	}
+
+	return PointerGetDatum(s);
+}
+
+/*
+ * Merge the closest neighboring intervals until there are no more than
+ * maxranges of them.
+ */
+static void
+ranges_reduce(BrinDesc *bdesc, uint16 attno, Oid colloid,
+			  MinmaxMultiRanges *ranges, int maxranges)
+{
+	MinmaxMultiOpaque *opaque;
+
+	opaque = (MinmaxMultiOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+	if (ranges->nranges > maxranges &&
+		opaque->distance_procinfo.fn_oid == InvalidOid)
+		fmgr_info_copy(&opaque->distance_procinfo,
+					   index_getprocinfo(bdesc->bd_index, attno,
+										 MINMAX_MULTI_PROCNUM_DISTANCE),
+					   bdesc->bd_context);
+
+	while (ranges->nranges > maxranges)
+	{
+		int			closest = 0;
+		float8		mindist = 0;
+		int			i;
+
+		for (i = 0; i < ranges->nranges - 1; i++)
+		{
+			float8		dist;
+
+			dist = DatumGetFloat8(FunctionCall2Coll(&opaque->distance_procinfo,
+													colloid,
+													RangeMax(ranges, i),
+													RangeMin(ranges, i + 1)));
+			if (i == 0 || dist < mindist)
+			{
+				closest = i;
+				mindist = dist;
+			}
+		}
+
+		/* the merged interval takes the maximum of the next one */
+		RangeMax(ranges, closest) = RangeMax(ranges, closest + 1);
+		memmove(&RangeMin(ranges, closest + 1), &RangeMin(ranges, closest + 2),
+				sizeof(Datum) * 2 * (ranges->nranges - closest - 2));
+		ranges->nranges--;
+	}
+}
+
+/*
+ * Is a less than b, per the opfamily's operator for the column type?
+ */
+static bool
+value_less_than(BrinDesc *bdesc, uint16 attno, Oid colloid, Datum a, Datum b)
+{
+	FmgrInfo   *cmpFn;
+
+	cmpFn = minmax_multi_get_strategy_procinfo(bdesc, attno,
+								  bdesc->bd_tupdesc->attrs[attno - 1]->atttypid,
+											   BTLessStrategyNumber);
+	return DatumGetBool(FunctionCall2Coll(cmpFn, colloid, a, b));
+}
+
+/*
+ * Cache and return the procedure for the given strategy.
+ *
+ * Note: this function mirrors minmax_get_strategy_procinfo; see notes
+ * there.  If changes are made here, see that function too.
+ */
+static FmgrInfo *
+minmax_multi_get_strategy_procinfo(BrinDesc *bdesc, uint16 attno, Oid subtype,
+								   uint16 strategynum)
+{
+	MinmaxMultiOpaque *opaque;
+
+	Assert(strategynum >= 1 &&
+		   strategynum <= BTMaxStrategyNumber);
+
+	opaque = (MinmaxMultiOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	/*
+	 * We cache the procedures for the previous subtype in the opaque struct,
+	 * to avoid repetitive syscache lookups.  If the subtype changed,
+	 * invalidate all the cached entries.
+	 */
+	if (opaque->cached_subtype != subtype)
+	{
+		uint16		i;
+
+		for (i = 1; i <= BTMaxStrategyNumber; i++)
+			opaque->strategy_procinfos[i - 1].fn_oid = InvalidOid;
+		opaque->cached_subtype = subtype;
+	}
+
+	if (opaque->strategy_procinfos[strategynum - 1].fn_oid == InvalidOid)
+	{
+		Form_pg_attribute attr;
+		HeapTuple	tuple;
+		Oid			opfamily,
+					oprid;
+		bool		isNull;
+
+		opfamily = bdesc->bd_index->rd_opfamily[attno - 1];
+		attr = bdesc->bd_tupdesc->attrs[attno - 1];
+		tuple = SearchSysCache4(AMOPSTRATEGY, ObjectIdGetDatum(opfamily),
+								ObjectIdGetDatum(attr->atttypid),
+								ObjectIdGetDatum(subtype),
+								Int16GetDatum(strategynum));
+
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+				 strategynum, attr->atttypid, subtype, opfamily);
+
+		oprid = DatumGetObjectId(SysCacheGetAttr(AMOPSTRATEGY, tuple,
+											 Anum_pg_amop_amopopr, &isNull));
+		ReleaseSysCache(tuple);
+		Assert(!isNull && RegProcedureIsValid(oprid));
+
+		fmgr_info_cxt(get_opcode(oprid),
+					  &opaque->strategy_procinfos[strategynum - 1],
+					  bdesc->bd_context);
+	}
+
+	return &opaque->strategy_procinfos[strategynum - 1];
+}
@@ -0,0 +1,692 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_encoding.c
+ *	  Encoding and compression of columnar table chunks.
+ *
+ * A chunk holds up to COLUMNAR_CHUNK_ROWS values of one column.  Its NULLs
+ * are kept in a bitmap, and the remaining values are encoded with whichever
+ * of the following gives the smallest result for the data at hand:
+ *
+ *	PLAIN	the values one after another
+ *	RLE		(repeat count, value) pairs, for runs of equal values
+ *	DELTA	the first value, then the differences between consecutive
+ *			values; only for pass-by-value integer-like types
+ *	DICT	the distinct values, then an index into them for each row
+ *
+ * Finally the encoded chunk is compressed with pglz, if that makes it
+ * smaller.  Values are compared for RLE and DICT by their binary
+ * representation, which is never wrong, only sometimes less efficient than
+ * comparing them with the type's equality operator would be.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_encoding.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar_internal.h"
+#include "access/hash.h"
+#include "access/tupmacs.h"
+#include "catalog/pg_type.h"
+#include "common/pg_lzcompress.h"
+
+
+/* Serialized non-null values of a chunk, as used by the encoders */
+typedef struct ChunkValues
+{
+	StringInfoData data;		/* the values in PLAIN format */
+	int			nvalues;
+	int		   *offsets;		/* [nvalues + 1] start of each value */
+} ChunkValues;
+
+#define VALUE_PTR(cv, i)	((cv)->data.data + (cv)->offsets[i])
+#define VALUE_LEN(cv, i)	((cv)->offsets[(i) + 1] - (cv)->offsets[i])
+
+static void append_varint(StringInfo out, uint64 value);
+static uint64 read_varint(const char **ptr, const char *end);
+static Datum read_value(Form_pg_attribute att, const char **ptr,
+		   const char *end, char **arena);
+static bool delta_applicable(Form_pg_attribute att);
+static void encode_rle(ChunkValues *cv, StringInfo out);
+static void encode_delta(Form_pg_attribute att, Datum *values, bool *isnull,
+			 int nrows, StringInfo out);
+static bool encode_dict(ChunkValues *cv, StringInfo out);
+
+
+static void
+append_varint(StringInfo out, uint64 value)
+{
+	char		buf[10];
+	int			n = 0;
+
+	do
+	{
+		uint8		b = value & 0x7F;
+
+		value >>= 7;
+		if (value != 0)
+			b |= 0x80;
+		buf[n++] = (char) b;
+	} while (value != 0);
+
+	appendBinaryStringInfo(out, buf, n);
+}
+
+static uint64
+read_varint(const char **ptr, const char *end)
+{
+	uint64		value = 0;
+	int			shift = 0;
+
+	for (;;)
+	{
+		uint8		b;
+
+		if (*ptr >= end || shift > 63)
+			elog(ERROR, "corrupted columnar chunk");
+		b = (uint8) **ptr;
+		(*ptr)++;
+		value |= ((uint64) (b & 0x7F)) << shift;
+		if ((b & 0x80) == 0)
+			return value;
+		shift += 7;
+	}
+}
+
+static inline uint64
+zigzag_encode(int64 value)
+{
+	return ((uint64) value << 1) ^ (uint64) (value >> 63);
+}
+
+static inline int64
+zigzag_decode(uint64 value)
+{
+	return (int64) ((value >> 1) ^ (~(value & 1) + 1));
+}
+
+static inline int64
+datum_to_int64(Datum value, int16 attlen)
+{
+	switch (attlen)
+	{
+		case 2:
+			return DatumGetInt16(value);
+		case 4:
+			return DatumGetInt32(value);
+		default:
+			return DatumGetInt64(value);
+	}
+}
+
+static inline Datum
+int64_to_datum(int64 value, int16 attlen)
+{
+	switch (attlen)
+	{
+		case 2:
+			return Int16GetDatum((int16) value);
+		case 4:
+			return Int32GetDatum((int32) value);
+		default:
+			return Int64GetDatum(value);
+	}
+}
+
+/*
+ * Bytes a value takes in memory, for deciding when a chunk is big enough.
+ */
+Size
+columnar_datum_size(Form_pg_attribute att, Datum value)
+{
+	if (att->attlen > 0)
+		return att->attlen;
+	if (att->attlen == -1)
+		return VARSIZE_ANY(DatumGetPointer(value));
+	return strlen(DatumGetCString(value)) + 1;
+}
+
+/*
+ * Append a value in PLAIN format: fixed-length types as their bytes,
+ * varlenas as a length followed by their data, cstrings with their NUL.
+ * Varlenas must not be toasted, but may have a short header.
+ */
+void
+columnar_serialize_datum(Form_pg_attribute att, Datum value, StringInfo out)
+{
+	if (att->attlen > 0)
+	{
+		if (att->attbyval)
+		{
+			Datum		tmp;
+
+			store_att_byval(&tmp, value, att->attlen);
+			appendBinaryStringInfo(out, (char *) &tmp, att->attlen);
+		}
+		else
+			appendBinaryStringInfo(out, DatumGetPointer(value), att->attlen);
+	}
+	else if (att->attlen == -1)
+	{
+		struct varlena *v = (struct varlena *) DatumGetPointer(value);
+
+		Assert(!VARATT_IS_EXTERNAL(v) && !VARATT_IS_COMPRESSED(v));
+		append_varint(out, VARSIZE_ANY_EXHDR(v));
+		appendBinaryStringInfo(out, VARDATA_ANY(v), VARSIZE_ANY_EXHDR(v));
+	}
+	else
+	{
+		char	   *s = DatumGetCString(value);
+
+		appendBinaryStringInfo(out, s, strlen(s) + 1);
+	}
+}
+
+/*
+ * Read back a value written by columnar_serialize_datum.  Pass-by-reference
+ * values are copied to *arena, suitably aligned, and *arena is advanced past
+ * them; each takes at most its serialized size plus
+ * MAXIMUM_ALIGNOF + VARHDRSZ bytes there.
+ */
+static Datum
+read_value(Form_pg_attribute att, const char **ptr, const char *end,
+		   char **arena)
+{
+	const char *p = *ptr;
+	char	   *dest;
+	Size		len;
+
+	if (att->attlen > 0)
+	{
+		if (end - p < att->attlen)
+			elog(ERROR, "corrupted columnar chunk");
+		*ptr = p + att->attlen;
+		if (att->attbyval)
+		{
+			Datum		tmp;
+
+			memcpy(&tmp, p, att->attlen);
+			return fetch_att(&tmp, true, att->attlen);
+		}
+		dest = (char *) att_align_nominal(*arena, att->attalign);
+		memcpy(dest, p, att->attlen);
+		*arena = dest + att->attlen;
+		return PointerGetDatum(dest);
+	}
+
+	if (att->attlen == -1)
+	{
+		len = (Size) read_varint(&p, end);
+		if ((Size) (end - p) < len)
+			elog(ERROR, "corrupted columnar chunk");
+		dest = (char *) att_align_nominal(*arena, att->attalign);
+		SET_VARSIZE(dest, len + VARHDRSZ);
+		memcpy(VARDATA(dest), p, len);
+		*arena = dest + len + VARHDRSZ;
+		*ptr = p + len;
+		return PointerGetDatum(dest);
+	}
+
+	len = strnlen(p, end - p);
+	if (len == (Size) (end - p))
+		elog(ERROR, "corrupted columnar chunk");
+	dest = *arena;
+	memcpy(dest, p, len + 1);
+	*arena = dest + len + 1;
+	*ptr = p + len + 1;
+	return PointerGetDatum(dest);
+}
+
+/*
+ * Datum version of read_value, for min/max values: the result is palloc'd
+ * in the current memory context.
+ */
+Datum
+columnar_deserialize_datum(Form_pg_attribute att, const char *data,
+						   int length)
+{
+	char	   *arena = NULL;
+
+	if (!att->attbyval)
+		arena = (char *) palloc(length + MAXIMUM_ALIGNOF + VARHDRSZ);
+
+	return read_value(att, &data, data + length, &arena);
+}
+
+/*
+ * Differences between consecutive values are only likely to be small for
+ * integers, dates and timestamps, so don't try DELTA on anything else.
+ */
+static bool
+delta_applicable(Form_pg_attribute att)
+{
+	if (!att->attbyval)
+		return false;
+	if (att->attlen != 2 && att->attlen != 4 && att->attlen != 8)
+		return false;
+	return att->atttypid != FLOAT4OID && att->atttypid != FLOAT8OID;
+}
+
+static void
+encode_rle(ChunkValues *cv, StringInfo out)
+{
+	int			nruns = 0;
+	int			i;
+	int			start;
+
+	for (i = 0; i < cv->nvalues; i++)
+	{
+		if (i == 0 || VALUE_LEN(cv, i) != VALUE_LEN(cv, i - 1) ||
+			memcmp(VALUE_PTR(cv, i), VALUE_PTR(cv, i - 1), VALUE_LEN(cv, i)) != 0)
+			nruns++;
+	}
+
+	append_varint(out, nruns);
+	start = 0;
+	for (i = 1; i <= cv->nvalues; i++)
+	{
+		if (i == cv->nvalues || VALUE_LEN(cv, i) != VALUE_LEN(cv, start) ||
+			memcmp(VALUE_PTR(cv, i), VALUE_PTR(cv, start), VALUE_LEN(cv, i)) != 0)
+		{
+			append_varint(out, i - start);
+			appendBinaryStringInfo(out, VALUE_PTR(cv, start),
+								   VALUE_LEN(cv, start));
+			start = i;
+		}
+	}
+}
+
+static void
+encode_delta(Form_pg_attribute att, Datum *values, bool *isnull, int nrows,
+			 StringInfo out)
+{
+	int64		prev = 0;
+	int			i;
+
+	for (i = 0; i < nrows; i++)
+	{
+		int64		value;
+
+		if (isnull[i])
+			continue;
+		value = datum_to_int64(values[i], att->attlen);
+		/* wraparound is fine, decoding wraps back the same way */
+		append_varint(out, zigzag_encode((int64) ((uint64) value - (uint64) prev)));
+		prev = value;
+	}
+}
+
+/*
+ * Returns false, without writing anything, if there are too many distinct
+ * values for DICT to pay off.
+ */
+static bool
+encode_dict(ChunkValues *cv, StringInfo out)
+{
+	int			maxdict = Min(cv->nvalues / 2, 65536);
+	int			tabsize = 1;
+	int		   *table;
+	int		   *dict;
+	uint16	   *indexes;
+	int			ndict = 0;
+	int			i;
+
+	while (tabsize < cv->nvalues * 2)
+		tabsize <<= 1;
+	table = (int *) palloc(tabsize * sizeof(int));
+	memset(table, -1, tabsize * sizeof(int));
+	dict = (int *) palloc(Max(maxdict, 1) * sizeof(int));
+	indexes = (uint16 *) palloc(cv->nvalues * sizeof(uint16));
+
+	for (i = 0; i < cv->nvalues; i++)
+	{
+		uint32		h;
+		int			slot;
+
+		h = DatumGetUInt32(hash_any((unsigned char *) VALUE_PTR(cv, i),
+									VALUE_LEN(cv, i)));
+		slot = h & (tabsize - 1);
+		for (;;)
+		{
+			int			d = table[slot];
+
+			if (d < 0)
+			{
+				if (ndict >= maxdict)
+				{
+					pfree(table);
+					pfree(dict);
+					pfree(indexes);
+					return false;
+				}
+				table[slot] = ndict;
+				dict[ndict] = i;
+				indexes[i] = (uint16) ndict;
+				ndict++;
+				break;
+			}
+			if (VALUE_LEN(cv, dict[d]) == VALUE_LEN(cv, i) &&
+				memcmp(VALUE_PTR(cv, dict[d]), VALUE_PTR(cv, i),
+					   VALUE_LEN(cv, i)) == 0)
+			{
+				indexes[i] = (uint16) d;
+				break;
+			}
+			slot = (slot + 1) & (tabsize - 1);
+		}
+	}
+
+	append_varint(out, ndict);
+	for (i = 0; i < ndict; i++)
+		appendBinaryStringInfo(out, VALUE_PTR(cv, dict[i]),
+							   VALUE_LEN(cv, dict[i]));
+	for (i = 0; i < cv->nvalues; i++)
+	{
+		uint8		b[2];
+
+		b[0] = indexes[i] & 0xFF;
+		b[1] = indexes[i] >> 8;
+		appendBinaryStringInfo(out, (char *) b, ndict <= 256 ? 1 : 2);
+	}
+
+	pfree(table);
+	pfree(dict);
+	pfree(indexes);
+	return true;
+}
+
+/*
+ * columnar_encode_chunk - encode one chunk of a column
+ *
+ * The chunk is appended to "out", and *desc is filled in, except for the
+ * min/max fields.
+ */
+void
+columnar_encode_chunk(Form_pg_attribute att, Datum *values, bool *isnull,
+					  int nrows, StringInfo out, ColumnarChunkDesc *desc)
+{
+	ChunkValues cv;
+	StringInfoData raw;
+	StringInfoData best;
+	StringInfoData candidate;
+	char	   *compressed;
+	int32		clen;
+	int			i;
+
+	desc->offset = out->len;
+	desc->flags = 0;
+	desc->encoding = COLUMNAR_ENCODING_PLAIN;
+
+	/* serialize the non-null values */
+	initStringInfo(&cv.data);
+	cv.offsets = (int *) palloc((nrows + 1) * sizeof(int));
+	cv.nvalues = 0;
+	for (i = 0; i < nrows; i++)
+	{
+		if (isnull[i])
+			continue;
+		cv.offsets[cv.nvalues++] = cv.data.len;
+		columnar_serialize_datum(att, values[i], &cv.data);
+	}
+	cv.offsets[cv.nvalues] = cv.data.len;
+
+	if (cv.nvalues == 0)
+	{
+		desc->flags = COLUMNAR_CHUNK_ALLNULL;
+		desc->length = desc->rawlength = 0;
+		pfree(cv.data.data);
+		pfree(cv.offsets);
+		return;
+	}
+
+	initStringInfo(&raw);
+	if (cv.nvalues < nrows)
+	{
+		int			nbytes = (nrows + 7) / 8;
+
+		desc->flags |= COLUMNAR_CHUNK_HASNULLS;
+		enlargeStringInfo(&raw, nbytes);
+		memset(raw.data, 0, nbytes);
+		for (i = 0; i < nrows; i++)
+		{
+			if (!isnull[i])
+				raw.data[i / 8] |= 1 << (i % 8);
+		}
+		raw.len = nbytes;
+		raw.data[raw.len] = '\0';
+	}
+
+	/* PLAIN is the baseline; keep whichever candidate beats it */
+	best = cv.data;
+	initStringInfo(&candidate);
+
+	if (delta_applicable(att))
+	{
+		encode_delta(att, values, isnull, nrows, &candidate);
+		if (candidate.len < best.len)
+		{
+			desc->encoding = COLUMNAR_ENCODING_DELTA;
+			best = candidate;
+			initStringInfo(&candidate);
+		}
+		else
+			resetStringInfo(&candidate);
+	}
+
+	encode_rle(&cv, &candidate);
+	if (candidate.len < best.len)
+	{
+		if (best.data != cv.data.data)
+			pfree(best.data);
+		desc->encoding = COLUMNAR_ENCODING_RLE;
+		best = candidate;
+		initStringInfo(&candidate);
+	}
+	else
+		resetStringInfo(&candidate);
+
+	if (cv.nvalues >= 4 && encode_dict(&cv, &candidate) &&
+		candidate.len < best.len)
+	{
+		if (best.data != cv.data.data)
+			pfree(best.data);
+		desc->encoding = COLUMNAR_ENCODING_DICT;
+		best = candidate;
+	}
+	else
+		pfree(candidate.data);
+
+	appendBinaryStringInfo(&raw, best.data, best.len);
+	if (best.data != cv.data.data)
+		pfree(best.data);
+	pfree(cv.data.data);
+	pfree(cv.offsets);
+
+	/* and compress the result, if that helps */
+	compressed = (char *) palloc(PGLZ_MAX_OUTPUT(raw.len));
+	clen = pglz_compress(raw.data, raw.len, compressed, PGLZ_strategy_default);
+	desc->rawlength = raw.len;
+	if (clen >= 0)
+	{
+		desc->flags |= COLUMNAR_CHUNK_COMPRESSED;
+		desc->length = clen;
+		appendBinaryStringInfo(out, compressed, clen);
+	}
+	else
+	{
+		desc->length = raw.len;
+		appendBinaryStringInfo(out, raw.data, raw.len);
+	}
+	pfree(compressed);
+	pfree(raw.data);
+}
+
+/*
+ * columnar_decode_chunk - decode a chunk written by columnar_encode_chunk
+ *
+ * "data" holds the desc->length stored bytes.  Pass-by-reference values are
+ * palloc'd in the current memory context.
+ */
+void
+columnar_decode_chunk(Form_pg_attribute att, const char *data,
+					  ColumnarChunkDesc *desc, int nrows,
+					  Datum *values, bool *isnull)
+{
+	const char *raw = data;
+	const char *p;
+	const char *end;
+	const char *bitmap = NULL;
+	char	   *arena = NULL;
+	int			nvalues = nrows;
+	int			i;
+	int			j;
+
+	if (desc->flags & COLUMNAR_CHUNK_ALLNULL)
+	{
+		for (i = 0; i < nrows; i++)
+		{
+			values[i] = (Datum) 0;
+			isnull[i] = true;
+		}
+		return;
+	}
+
+	if (desc->flags & COLUMNAR_CHUNK_COMPRESSED)
+	{
+		char	   *buf = (char *) palloc(desc->rawlength);
+
+		if (pglz_decompress(data, desc->length, buf,
+							desc->rawlength) != (int32) desc->rawlength)
+			elog(ERROR, "corrupted columnar chunk");
+		raw = buf;
+	}
+	p = raw;
+	end = raw + desc->rawlength;
+
+	if (desc->flags & COLUMNAR_CHUNK_HASNULLS)
+	{
+		bitmap = p;
+		p += (nrows + 7) / 8;
+		if (p > end)
+			elog(ERROR, "corrupted columnar chunk");
+		nvalues = 0;
+		for (i = 0; i < nrows; i++)
+		{
+			if (bitmap[i / 8] & (1 << (i % 8)))
+				nvalues++;
+		}
+	}
+
+	if (!att->attbyval)
+		arena = (char *) palloc(desc->rawlength +
+								nvalues * (MAXIMUM_ALIGNOF + VARHDRSZ));
+
+	/* decode the non-null values into the start of values[] */
+	switch (desc->encoding)
+	{
+		case COLUMNAR_ENCODING_PLAIN:
+			for (j = 0; j < nvalues; j++)
+				values[j] = read_value(att, &p, end, &arena);
+			break;
+
+		case COLUMNAR_ENCODING_RLE:
+			{
+				uint64		nruns = read_varint(&p, end);
+				uint64		r;
+
+				j = 0;
+				for (r = 0; r < nruns; r++)
+				{
+					uint64		count = read_varint(&p, end);
+					Datum		value = read_value(att, &p, end, &arena);
+
+					if (count > (uint64) (nvalues - j))
+						elog(ERROR, "corrupted columnar chunk");
+					while (count-- > 0)
+						values[j++] = value;
+				}
+				if (j != nvalues)
+					elog(ERROR, "corrupted columnar chunk");
+			}
+			break;
+
+		case COLUMNAR_ENCODING_DELTA:
+			{
+				int64		value = 0;
+
+				if (!delta_applicable(att))
+					elog(ERROR, "corrupted columnar chunk");
+				for (j = 0; j < nvalues; j++)
+				{
+					value = (int64) ((uint64) value +
+									 (uint64) zigzag_decode(read_varint(&p, end)));
+					values[j] = int64_to_datum(value, att->attlen);
+				}
+			}
+			break;
+
+		case COLUMNAR_ENCODING_DICT:
+			{
+				uint64		ndict = read_varint(&p, end);
+				Datum	   *dict;
+				int			width = ndict <= 256 ? 1 : 2;
+
+				if (ndict > 65536 || ndict > (uint64) nvalues)
+					elog(ERROR, "corrupted columnar chunk");
+				dict = (Datum *) palloc(Max(ndict, 1) * sizeof(Datum));
+				for (i = 0; i < (int) ndict; i++)
+					dict[i] = read_value(att, &p, end, &arena);
+				if (end - p < (ptrdiff_t) nvalues * width)
+					elog(ERROR, "corrupted columnar chunk");
+				for (j = 0; j < nvalues; j++)
+				{
+					uint32		idx = (uint8) p[0];
+
+					if (width == 2)
+						idx |= ((uint32) (uint8) p[1]) << 8;
+					p += width;
+					if (idx >= ndict)
+						elog(ERROR, "corrupted columnar chunk");
+					values[j] = dict[idx];
+				}
+				pfree(dict);
+			}
+			break;
+
+		default:
+			elog(ERROR, "unrecognized columnar chunk encoding %d",
+				 desc->encoding);
+	}
+
+	if (p != end)
+		elog(ERROR, "corrupted columnar chunk");
+
+	/* spread the values out to their rows, back to front */
+	if (bitmap != NULL)
+	{
+		j = nvalues - 1;
+		for (i = nrows - 1; i >= 0; i--)
+		{
+			if (bitmap[i / 8] & (1 << (i % 8)))
+			{
+				values[i] = values[j--];
+				isnull[i] = false;
+			}
+			else
+			{
+				values[i] = (Datum) 0;
+				isnull[i] = true;
+			}
+		}
+	}
+	else
+		memset(isnull, 0, nrows * sizeof(bool));
+
+	if (raw != data)
+		pfree((char *) raw);
+}
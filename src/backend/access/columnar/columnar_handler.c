@@ -0,0 +1,226 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_handler.c
+ *	  columnar table access method handler
+ *
+ * A columnar table stores its rows column by column, in compressed stripes
+ * that are written once and never updated, which makes it cheap to scan a
+ * few columns of many rows, but impossible to update or delete rows.  See
+ * columnar_internal.h for the storage format.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_handler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/columnar_internal.h"
+#include "access/multixact.h"
+#include "access/tableam.h"
+#include "access/transam.h"
+#include "commands/vacuum.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/bufmgr.h"
+#include "utils/builtins.h"
+#include "utils/rel.h"
+
+
+static HTSU_Result columnar_tuple_delete(Relation rel, ItemPointer tid,
+					  CommandId cid, Snapshot crosscheck, bool wait,
+					  HeapUpdateFailureData *hufd);
+static HTSU_Result columnar_tuple_update(Relation rel, ItemPointer otid,
+					  HeapTuple newtup, CommandId cid, Snapshot crosscheck,
+					  bool wait, HeapUpdateFailureData *hufd,
+					  LockTupleMode *lockmode);
+static HTSU_Result columnar_tuple_lock(Relation rel, HeapTuple tuple,
+					CommandId cid, LockTupleMode mode,
+					LockWaitPolicy wait_policy, bool follow_update,
+					Buffer *buffer, HeapUpdateFailureData *hufd);
+static void columnar_relation_vacuum(Relation rel, int options,
+						 VacuumParams *params,
+						 BufferAccessStrategy bstrategy);
+static bool columnar_relation_analyze(Relation rel,
+						  AcquireSampleRowsFunc *func,
+						  BlockNumber *totalpages);
+
+
+/*
+ * Stripes are never modified, so rows can't be deleted, updated or locked.
+ */
+static HTSU_Result
+columnar_tuple_delete(Relation rel, ItemPointer tid, CommandId cid,
+					  Snapshot crosscheck, bool wait,
+					  HeapUpdateFailureData *hufd)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot delete rows from columnar table \"%s\"",
+					RelationGetRelationName(rel))));
+	return HeapTupleInvisible;	/* keep compiler quiet */
+}
+
+static HTSU_Result
+columnar_tuple_update(Relation rel, ItemPointer otid, HeapTuple newtup,
+					  CommandId cid, Snapshot crosscheck, bool wait,
+					  HeapUpdateFailureData *hufd, LockTupleMode *lockmode)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot update rows in columnar table \"%s\"",
+					RelationGetRelationName(rel))));
+	return HeapTupleInvisible;	/* keep compiler quiet */
+}
+
+static HTSU_Result
+columnar_tuple_lock(Relation rel, HeapTuple tuple, CommandId cid,
+					LockTupleMode mode, LockWaitPolicy wait_policy,
+					bool follow_update, Buffer *buffer,
+					HeapUpdateFailureData *hufd)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot lock rows in columnar table \"%s\"",
+					RelationGetRelationName(rel))));
+	return HeapTupleInvisible;	/* keep compiler quiet */
+}
+
+/*
+ * columnar_relation_vacuum - VACUUM a columnar table
+ *
+ * There are no dead rows to remove, but the xmin of every stripe older than
+ * OldestXmin is frozen, or cleared if its transaction aborted, so that
+ * relfrozenxid can be advanced to OldestXmin.  The space taken by aborted
+ * stripes is not reclaimed.
+ */
+static void
+columnar_relation_vacuum(Relation rel, int options, VacuumParams *params,
+						 BufferAccessStrategy bstrategy)
+{
+	TransactionId OldestXmin;
+	TransactionId FreezeLimit;
+	TransactionId xidFullScanLimit;
+	MultiXactId MultiXactCutoff;
+	MultiXactId mxactFullScanLimit;
+	ColumnarStripeHeader hdr;
+	BlockNumber nblocks;
+	BlockNumber start;
+	double		live_rows = 0;
+	int			nstripes = 0;
+	int			nfrozen = 0;
+	int			naborted = 0;
+	int			elevel;
+
+	elevel = (options & VACOPT_VERBOSE) ? INFO : DEBUG2;
+
+	vacuum_set_xid_limits(rel,
+						  params->freeze_min_age,
+						  params->freeze_table_age,
+						  params->multixact_freeze_min_age,
+						  params->multixact_freeze_table_age,
+						  &OldestXmin, &FreezeLimit, &xidFullScanLimit,
+						  &MultiXactCutoff, &mxactFullScanLimit);
+
+	nblocks = RelationGetNumberOfBlocks(rel);
+	for (start = COLUMNAR_FIRST_STRIPE_BLKNO;
+		 columnar_read_stripe_header(rel, bstrategy, start, nblocks, &hdr);
+		 start += hdr.nblocks)
+	{
+		TransactionId xmin = hdr.xmin;
+
+		vacuum_delay_point();
+
+		nstripes++;
+		if (!TransactionIdIsValid(xmin))
+			continue;
+		if (TransactionIdIsNormal(xmin) &&
+			TransactionIdPrecedes(xmin, OldestXmin))
+		{
+			/* nothing older than OldestXmin can still be running */
+			if (TransactionIdDidCommit(xmin))
+			{
+				columnar_set_stripe_xmin(rel, bstrategy, start,
+										 FrozenTransactionId);
+				nfrozen++;
+			}
+			else
+			{
+				columnar_set_stripe_xmin(rel, bstrategy, start,
+										 InvalidTransactionId);
+				naborted++;
+				continue;
+			}
+		}
+		else if (!TransactionIdDidCommit(xmin))
+			continue;			/* still in progress, or aborted recently */
+
+		live_rows += hdr.nrows;
+	}
+
+	vac_update_relstats(rel, nblocks, live_rows, 0, false,
+						OldestXmin, InvalidMultiXactId, false);
+
+	pgstat_report_vacuum(RelationGetRelid(rel), rel->rd_rel->relisshared,
+						 (PgStat_Counter) live_rows, 0);
+
+	ereport(elevel,
+			(errmsg("\"%s\": found %.0f rows in %d stripes in %u pages",
+					RelationGetRelationName(rel),
+					live_rows, nstripes, nblocks),
+			 errdetail("%d stripes were frozen, %d stripes of aborted transactions were marked unused.",
+					   nfrozen, naborted)));
+}
+
+/*
+ * ANALYZE reads the whole table, see columnar_acquire_sample_rows.
+ */
+static bool
+columnar_relation_analyze(Relation rel, AcquireSampleRowsFunc *func,
+						  BlockNumber *totalpages)
+{
+	*func = columnar_acquire_sample_rows;
+	*totalpages = RelationGetNumberOfBlocks(rel);
+	return true;
+}
+
+/*
+ * columnar_tableam_handler - SQL-callable handler of the columnar table
+ * access method, for CREATE TABLE ... USING columnar
+ */
+Datum
+columnar_tableam_handler(PG_FUNCTION_ARGS)
+{
+	TableAmRoutine *routine = makeNode(TableAmRoutine);
+
+	routine->scan_begin = columnar_beginscan;
+	routine->scan_getnext = columnar_getnext;
+	routine->scan_rescan = columnar_rescan;
+	routine->scan_end = columnar_endscan;
+	routine->scan_set_columns = columnar_scan_set_columns;
+	routine->scan_getbatch = columnar_getbatch;
+
+	routine->tuple_fetch = columnar_fetch;
+	/* rows are never updated, so a TID always names the latest version */
+	routine->tuple_get_latest_tid = NULL;
+	routine->tuple_insert = columnar_tuple_insert;
+	/* rows are buffered anyway, so one at a time is as good */
+	routine->multi_insert = NULL;
+	routine->tuple_delete = columnar_tuple_delete;
+	routine->tuple_update = columnar_tuple_update;
+	routine->tuple_lock = columnar_tuple_lock;
+	routine->finish_bulk_insert = columnar_finish_bulk_insert;
+
+	/* every page is WAL-logged, so there's nothing to sync */
+	routine->relation_sync = NULL;
+	routine->relation_vacuum = columnar_relation_vacuum;
+	routine->relation_analyze = columnar_relation_analyze;
+	routine->relation_estimate_size = NULL;
+
+	PG_RETURN_POINTER(routine);
+}
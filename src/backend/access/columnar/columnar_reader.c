@@ -0,0 +1,849 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_reader.c
+ *	  Scanning and fetching rows of columnar tables.
+ *
+ * A scan reads the stripes one at a time, and within a stripe decodes one
+ * chunk group at a time, but only for the columns it has been asked to
+ * project (see columnar_scan_set_columns); the others read as NULL.  Chunk
+ * groups whose min/max values show that a scan key can't be satisfied are
+ * skipped without decoding anything.  The keys are only used for that, so
+ * the rows returned need not satisfy them.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_reader.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar_internal.h"
+#include "access/relscan.h"
+#include "access/stratnum.h"
+#include "commands/vacuum.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/bufmgr.h"
+#include "storage/predicate.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/sampling.h"
+#include "utils/snapmgr.h"
+#include "utils/typcache.h"
+
+
+/* A scan key usable for skipping chunk groups */
+typedef struct ColumnarSkipKey
+{
+	int			attoff;			/* column number, from 0 */
+	StrategyNumber strategy;	/* btree strategy of the operator */
+	Datum		arg;
+	Oid			collation;
+	FmgrInfo   *cmpfunc;		/* the column type's btree comparison */
+} ColumnarSkipKey;
+
+typedef struct ColumnarScanDescData
+{
+	HeapScanDescData rs_base;	/* rs_ctup holds the current row */
+
+	TupleDesc	tupdesc;
+	bool	   *projected;		/* [natts] columns to decode */
+	bool	   *needdir;		/* [natts] projected or used by a key */
+	int			nskeys;
+	ColumnarSkipKey *skeys;
+
+	MemoryContext stripecxt;	/* the current stripe's directories */
+	MemoryContext chunkcxt;		/* the current chunk group's values */
+	MemoryContext tuplecxt;		/* the last tuple returned */
+
+	BlockNumber next_stripe;	/* where the next stripe starts */
+
+	/* the current stripe */
+	bool		have_stripe;
+	ColumnarStripe stripe;
+	char	  **dirs;			/* [natts] directory, for needed columns */
+	uint32	   *chunk_first;	/* [nchunks] first row of each chunk group */
+	int			next_chunk;
+
+	/* the current chunk group */
+	int			chunk_nrows;
+	int			chunk_row;		/* next row to return */
+	uint32		chunk_start;	/* its first row's number within the stripe */
+	Datum	  **values;			/* [natts][COLUMNAR_CHUNK_ROWS] */
+	bool	  **isnull;			/* [natts][COLUMNAR_CHUNK_ROWS] */
+	Datum	   *tupvalues;		/* [natts] */
+	bool	   *tupisnull;		/* [natts] */
+} ColumnarScanDescData;
+
+typedef ColumnarScanDescData *ColumnarScanDesc;
+
+
+static void columnar_init_skip_keys(ColumnarScanDesc scan);
+static bool columnar_next_stripe(ColumnarScanDesc scan);
+static bool columnar_chunk_excluded(ColumnarScanDesc scan, int chunk);
+static void columnar_load_chunk(ColumnarScanDesc scan, int chunk);
+static bool columnar_next_row(ColumnarScanDesc scan);
+static void columnar_set_tuple_header(Relation rel, HeapTuple tuple,
+						  ColumnarStripeHeader *hdr, uint64 rowno);
+static int	compare_rows(const void *a, const void *b);
+
+
+/*
+ * Pick out the scan keys we can compare against min/max values: plain
+ * comparisons of a column against a value of the column's own type, with
+ * the column's collation.
+ */
+static void
+columnar_init_skip_keys(ColumnarScanDesc scan)
+{
+	HeapScanDesc base = &scan->rs_base;
+	TupleDesc	tupdesc = scan->tupdesc;
+	int			i;
+
+	scan->nskeys = 0;
+	if (scan->skeys == NULL)
+		scan->skeys = (ColumnarSkipKey *)
+			palloc(Max(base->rs_nkeys, 1) * sizeof(ColumnarSkipKey));
+
+	for (i = 0; i < base->rs_nkeys; i++)
+	{
+		ScanKey		key = &base->rs_key[i];
+		Form_pg_attribute att;
+		TypeCacheEntry *typentry;
+		ColumnarSkipKey *skey;
+
+		if (key->sk_flags != 0 ||
+			key->sk_attno < 1 || key->sk_attno > tupdesc->natts ||
+			key->sk_strategy < BTLessStrategyNumber ||
+			key->sk_strategy > BTGreaterStrategyNumber)
+			continue;
+		att = tupdesc->attrs[key->sk_attno - 1];
+		if (att->attisdropped ||
+			(OidIsValid(key->sk_subtype) && key->sk_subtype != att->atttypid) ||
+			key->sk_collation != att->attcollation)
+			continue;
+		typentry = lookup_type_cache(att->atttypid, TYPECACHE_CMP_PROC_FINFO);
+		if (!OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+			continue;
+
+		skey = &scan->skeys[scan->nskeys++];
+		skey->attoff = key->sk_attno - 1;
+		skey->strategy = key->sk_strategy;
+		skey->arg = key->sk_argument;
+		skey->collation = key->sk_collation;
+		skey->cmpfunc = &typentry->cmp_proc_finfo;
+		scan->needdir[skey->attoff] = true;
+	}
+}
+
+/*
+ * columnar_beginscan - begin a sequential scan of a columnar table
+ */
+HeapScanDesc
+columnar_beginscan(Relation rel, Snapshot snapshot, int nkeys, ScanKey key)
+{
+	ColumnarScanDesc scan;
+	HeapScanDesc base;
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	int			natts = tupdesc->natts;
+	int			i;
+
+	/* see rows inserted earlier by this command */
+	columnar_flush_pending(rel);
+
+	RelationIncrementReferenceCount(rel);
+
+	scan = (ColumnarScanDesc) palloc0(sizeof(ColumnarScanDescData));
+	base = &scan->rs_base;
+	base->rs_rd = rel;
+	base->rs_snapshot = snapshot;
+	base->rs_nkeys = nkeys;
+	base->rs_cbuf = InvalidBuffer;
+	base->rs_cblock = InvalidBlockNumber;
+	base->rs_ctup.t_tableOid = RelationGetRelid(rel);
+	base->rs_ctup.t_data = NULL;
+	if (nkeys > 0)
+	{
+		base->rs_key = (ScanKey) palloc(sizeof(ScanKeyData) * nkeys);
+		memcpy(base->rs_key, key, sizeof(ScanKeyData) * nkeys);
+	}
+
+	/* a big table shouldn't push everything else out of shared buffers */
+	base->rs_nblocks = RelationGetNumberOfBlocks(rel);
+	if (base->rs_nblocks > (BlockNumber) (NBuffers / 4))
+		base->rs_strategy = GetAccessStrategy(BAS_BULKREAD);
+
+	scan->tupdesc = tupdesc;
+	scan->projected = (bool *) palloc(Max(natts, 1) * sizeof(bool));
+	scan->needdir = (bool *) palloc(Max(natts, 1) * sizeof(bool));
+	scan->values = (Datum **) palloc(Max(natts, 1) * sizeof(Datum *));
+	scan->isnull = (bool **) palloc(Max(natts, 1) * sizeof(bool *));
+	scan->tupvalues = (Datum *) palloc(Max(natts, 1) * sizeof(Datum));
+	scan->tupisnull = (bool *) palloc(Max(natts, 1) * sizeof(bool));
+	scan->dirs = (char **) palloc0(Max(natts, 1) * sizeof(char *));
+	for (i = 0; i < natts; i++)
+	{
+		scan->projected[i] = !tupdesc->attrs[i]->attisdropped;
+		scan->needdir[i] = scan->projected[i];
+		scan->values[i] = NULL;
+		scan->isnull[i] = NULL;
+	}
+
+	scan->stripecxt = AllocSetContextCreate(CurrentMemoryContext,
+											"columnar scan stripe",
+											ALLOCSET_DEFAULT_MINSIZE,
+											ALLOCSET_DEFAULT_INITSIZE,
+											ALLOCSET_DEFAULT_MAXSIZE);
+	scan->chunkcxt = AllocSetContextCreate(CurrentMemoryContext,
+										   "columnar scan chunk",
+										   ALLOCSET_DEFAULT_MINSIZE,
+										   ALLOCSET_DEFAULT_INITSIZE,
+										   ALLOCSET_DEFAULT_MAXSIZE);
+	scan->tuplecxt = AllocSetContextCreate(CurrentMemoryContext,
+										   "columnar scan tuple",
+										   ALLOCSET_SMALL_MINSIZE,
+										   ALLOCSET_SMALL_INITSIZE,
+										   ALLOCSET_DEFAULT_MAXSIZE);
+
+	columnar_init_skip_keys(scan);
+
+	scan->next_stripe = COLUMNAR_FIRST_STRIPE_BLKNO;
+
+	/* we can't tell which rows we'll skip, so lock the whole relation */
+	PredicateLockRelation(rel, snapshot);
+
+	pgstat_count_heap_scan(rel);
+
+	return base;
+}
+
+/*
+ * columnar_scan_set_columns - tell the scan which columns to decode
+ *
+ * "attrs" holds plain attribute numbers, and may be empty.  Must be called
+ * before the first row is fetched.
+ */
+void
+columnar_scan_set_columns(HeapScanDesc sscan, Bitmapset *attrs)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	TupleDesc	tupdesc = scan->tupdesc;
+	int			i;
+
+	Assert(!scan->have_stripe);
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		scan->projected[i] = !tupdesc->attrs[i]->attisdropped &&
+			bms_is_member(i + 1, attrs);
+		scan->needdir[i] = scan->projected[i];
+	}
+	for (i = 0; i < scan->nskeys; i++)
+		scan->needdir[scan->skeys[i].attoff] = true;
+}
+
+/*
+ * Advance to the next stripe visible to the scan's snapshot, and read its
+ * directories.  Returns false at the end of the table.
+ */
+static bool
+columnar_next_stripe(ColumnarScanDesc scan)
+{
+	HeapScanDesc base = &scan->rs_base;
+	Relation	rel = base->rs_rd;
+	ColumnarStripeHeader hdr;
+	MemoryContext oldcxt;
+	BlockNumber start;
+	uint32		first;
+	int			natts;
+	int			i;
+
+	scan->have_stripe = false;
+	scan->chunk_nrows = scan->chunk_row = 0;
+	MemoryContextReset(scan->stripecxt);
+
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		start = scan->next_stripe;
+		if (!columnar_read_stripe_header(rel, base->rs_strategy, start,
+										 base->rs_nblocks, &hdr))
+			return false;
+		scan->next_stripe = start + hdr.nblocks;
+
+		if (columnar_stripe_visible(&hdr, base->rs_snapshot))
+			break;
+	}
+
+	oldcxt = MemoryContextSwitchTo(scan->stripecxt);
+
+	columnar_read_stripe(rel, base->rs_strategy, start, &hdr, &scan->stripe);
+
+	natts = Min((int) hdr.natts, scan->tupdesc->natts);
+	for (i = 0; i < scan->tupdesc->natts; i++)
+	{
+		if (i < natts && scan->needdir[i])
+			scan->dirs[i] = columnar_read_directory(rel, base->rs_strategy,
+													&scan->stripe, i + 1);
+		else
+			scan->dirs[i] = NULL;
+	}
+
+	scan->chunk_first = (uint32 *) palloc(Max(hdr.nchunks, 1) * sizeof(uint32));
+	first = 0;
+	for (i = 0; i < (int) hdr.nchunks; i++)
+	{
+		scan->chunk_first[i] = first;
+		first += scan->stripe.chunk_nrows[i];
+	}
+	if (first != hdr.nrows)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid stripe header in block %u of columnar table \"%s\"",
+						start, RelationGetRelationName(rel))));
+
+	MemoryContextSwitchTo(oldcxt);
+
+	scan->next_chunk = 0;
+	scan->have_stripe = true;
+
+	return true;
+}
+
+/*
+ * Can we tell from its min/max values that no row of a chunk group can
+ * satisfy the scan keys?
+ */
+static bool
+columnar_chunk_excluded(ColumnarScanDesc scan, int chunk)
+{
+	ColumnarStripeHeader *hdr = &scan->stripe.hdr;
+	int			i;
+
+	for (i = 0; i < scan->nskeys; i++)
+	{
+		ColumnarSkipKey *skey = &scan->skeys[i];
+		Form_pg_attribute att = scan->tupdesc->attrs[skey->attoff];
+		ColumnarChunkDesc *desc;
+		const char *minmax;
+		Datum		min;
+		Datum		max;
+		bool		excluded = false;
+
+		/* the column is all NULLs, and the operators are strict */
+		if (skey->attoff >= (int) hdr->natts)
+			return true;
+		desc = &((ColumnarChunkDesc *) scan->dirs[skey->attoff])[chunk];
+		if (desc->flags & COLUMNAR_CHUNK_ALLNULL)
+			return true;
+		if (!(desc->flags & COLUMNAR_CHUNK_HASMINMAX))
+			continue;
+
+		minmax = scan->dirs[skey->attoff] +
+			hdr->nchunks * sizeof(ColumnarChunkDesc) + desc->minmax_offset;
+		min = columnar_deserialize_datum(att, minmax, desc->min_length);
+		max = columnar_deserialize_datum(att, minmax + desc->min_length,
+										 desc->max_length);
+
+#define CMP(a, b) \
+	DatumGetInt32(FunctionCall2Coll(skey->cmpfunc, skey->collation, (a), (b)))
+
+		switch (skey->strategy)
+		{
+			case BTLessStrategyNumber:
+				excluded = CMP(min, skey->arg) >= 0;
+				break;
+			case BTLessEqualStrategyNumber:
+				excluded = CMP(min, skey->arg) > 0;
+				break;
+			case BTEqualStrategyNumber:
+				excluded = CMP(min, skey->arg) > 0 || CMP(max, skey->arg) < 0;
+				break;
+			case BTGreaterEqualStrategyNumber:
+				excluded = CMP(max, skey->arg) < 0;
+				break;
+			case BTGreaterStrategyNumber:
+				excluded = CMP(max, skey->arg) <= 0;
+				break;
+		}
+
+#undef CMP
+
+		if (excluded)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Decode the projected columns of a chunk group.
+ */
+static void
+columnar_load_chunk(ColumnarScanDesc scan, int chunk)
+{
+	HeapScanDesc base = &scan->rs_base;
+	ColumnarStripe *stripe = &scan->stripe;
+	int			nrows = stripe->chunk_nrows[chunk];
+	MemoryContext oldcxt;
+	int			i;
+
+	oldcxt = MemoryContextSwitchTo(scan->chunkcxt);
+
+	for (i = 0; i < scan->tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = scan->tupdesc->attrs[i];
+		ColumnarChunkDesc *desc;
+		char	   *data;
+		int			j;
+
+		if (!scan->projected[i])
+			continue;
+
+		scan->values[i] = (Datum *) palloc(Max(nrows, 1) * sizeof(Datum));
+		scan->isnull[i] = (bool *) palloc(Max(nrows, 1) * sizeof(bool));
+
+		/* columns added after the stripe was written are NULL */
+		if (i >= (int) stripe->hdr.natts)
+		{
+			for (j = 0; j < nrows; j++)
+			{
+				scan->values[i][j] = (Datum) 0;
+				scan->isnull[i][j] = true;
+			}
+			continue;
+		}
+
+		desc = &((ColumnarChunkDesc *) scan->dirs[i])[chunk];
+		data = (char *) palloc(Max(desc->length, 1));
+		columnar_read_bytes(base->rs_rd, base->rs_strategy, stripe->start,
+							stripe->colinfo[i].data_offset + desc->offset,
+							desc->length, data);
+		columnar_decode_chunk(att, data, desc, nrows,
+							  scan->values[i], scan->isnull[i]);
+		pfree(data);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	scan->chunk_nrows = nrows;
+	scan->chunk_row = 0;
+	scan->chunk_start = scan->chunk_first[chunk];
+}
+
+/*
+ * Make sure the current chunk group has a row left to return, moving on to
+ * later chunk groups and stripes as needed.  Returns false at the end of
+ * the table.
+ */
+static bool
+columnar_next_row(ColumnarScanDesc scan)
+{
+	for (;;)
+	{
+		if (scan->chunk_row < scan->chunk_nrows)
+			return true;
+
+		if (scan->have_stripe &&
+			scan->next_chunk < (int) scan->stripe.hdr.nchunks)
+		{
+			int			chunk = scan->next_chunk++;
+			MemoryContext oldcxt;
+			bool		excluded;
+
+			MemoryContextReset(scan->chunkcxt);
+			scan->chunk_nrows = scan->chunk_row = 0;
+			oldcxt = MemoryContextSwitchTo(scan->chunkcxt);
+			excluded = columnar_chunk_excluded(scan, chunk);
+			MemoryContextSwitchTo(oldcxt);
+			if (!excluded)
+				columnar_load_chunk(scan, chunk);
+			continue;
+		}
+
+		if (!columnar_next_stripe(scan))
+			return false;
+	}
+}
+
+/*
+ * Fill in the header of a tuple from the stripe holding it.
+ */
+static void
+columnar_set_tuple_header(Relation rel, HeapTuple tuple,
+						  ColumnarStripeHeader *hdr, uint64 rowno)
+{
+	HeapTupleHeader td = tuple->t_data;
+
+	td->t_infomask &= ~(HEAP_XACT_MASK);
+	td->t_infomask2 &= ~(HEAP2_XACT_MASK);
+	td->t_infomask |= HEAP_XMAX_INVALID;
+	HeapTupleHeaderSetXmin(td, hdr->xmin);
+	HeapTupleHeaderSetCmin(td, hdr->cmin);
+	HeapTupleHeaderSetXmax(td, 0);
+	tuple->t_tableOid = RelationGetRelid(rel);
+	columnar_rowno_to_tid(rowno, &tuple->t_self);
+	td->t_ctid = tuple->t_self;
+}
+
+/*
+ * columnar_getnext - return the next row of the scan
+ */
+HeapTuple
+columnar_getnext(HeapScanDesc sscan, ScanDirection direction)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Relation	rel = sscan->rs_rd;
+	TupleDesc	tupdesc = scan->tupdesc;
+	MemoryContext oldcxt;
+	HeapTuple	tuple;
+	int			row;
+	int			i;
+
+	if (ScanDirectionIsBackward(direction))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("columnar tables do not support backward scans")));
+	if (ScanDirectionIsNoMovement(direction))
+		return sscan->rs_ctup.t_data != NULL ? &sscan->rs_ctup : NULL;
+
+	sscan->rs_inited = true;
+	if (!columnar_next_row(scan))
+	{
+		sscan->rs_ctup.t_data = NULL;
+		return NULL;
+	}
+
+	row = scan->chunk_row++;
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		if (scan->projected[i])
+		{
+			scan->tupvalues[i] = scan->values[i][row];
+			scan->tupisnull[i] = scan->isnull[i][row];
+		}
+		else
+		{
+			scan->tupvalues[i] = (Datum) 0;
+			scan->tupisnull[i] = true;
+		}
+	}
+
+	MemoryContextReset(scan->tuplecxt);
+	oldcxt = MemoryContextSwitchTo(scan->tuplecxt);
+	tuple = heap_form_tuple(tupdesc, scan->tupvalues, scan->tupisnull);
+	MemoryContextSwitchTo(oldcxt);
+
+	columnar_set_tuple_header(rel, tuple, &scan->stripe.hdr,
+							  scan->stripe.hdr.first_rowno +
+							  scan->chunk_start + row);
+	sscan->rs_ctup = *tuple;
+
+	pgstat_count_heap_getnext(rel);
+
+	return &sscan->rs_ctup;
+}
+
+/*
+ * columnar_getbatch - return the next rows of the scan in columnar form
+ *
+ * Fills values[col][] and isnull[col][] with the values of column
+ * attnums[col] of up to maxrows rows, and returns the number of rows, or 0
+ * at the end of the scan.  The columns must be projected.  Pass-by-reference
+ * values stay valid until the next call.
+ */
+int
+columnar_getbatch(HeapScanDesc sscan, int ncols, AttrNumber *attnums,
+				  Datum **values, bool **isnull, int maxrows)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	int			nrows;
+	int			col;
+
+	sscan->rs_inited = true;
+	sscan->rs_ctup.t_data = NULL;
+	if (!columnar_next_row(scan))
+		return 0;
+
+	nrows = Min(maxrows, scan->chunk_nrows - scan->chunk_row);
+	for (col = 0; col < ncols; col++)
+	{
+		int			attoff = attnums[col] - 1;
+
+		if (attoff < 0 || attoff >= scan->tupdesc->natts ||
+			!scan->projected[attoff])
+			elog(ERROR, "column %d is not projected by the columnar scan",
+				 attnums[col]);
+		memcpy(values[col], &scan->values[attoff][scan->chunk_row],
+			   nrows * sizeof(Datum));
+		memcpy(isnull[col], &scan->isnull[attoff][scan->chunk_row],
+			   nrows * sizeof(bool));
+	}
+	scan->chunk_row += nrows;
+
+	if (sscan->rs_rd->pgstat_info != NULL)
+		sscan->rs_rd->pgstat_info->t_counts.t_tuples_returned += nrows;
+
+	return nrows;
+}
+
+/*
+ * columnar_rescan - restart a scan, optionally with new keys
+ */
+void
+columnar_rescan(HeapScanDesc sscan, ScanKey key)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Relation	rel = sscan->rs_rd;
+	int			i;
+
+	columnar_flush_pending(rel);
+
+	if (key != NULL && sscan->rs_nkeys > 0)
+	{
+		memcpy(sscan->rs_key, key, sscan->rs_nkeys * sizeof(ScanKeyData));
+		for (i = 0; i < scan->tupdesc->natts; i++)
+			scan->needdir[i] = scan->projected[i];
+		columnar_init_skip_keys(scan);
+	}
+
+	sscan->rs_nblocks = RelationGetNumberOfBlocks(rel);
+	sscan->rs_inited = false;
+	sscan->rs_ctup.t_data = NULL;
+	scan->next_stripe = COLUMNAR_FIRST_STRIPE_BLKNO;
+	scan->have_stripe = false;
+	scan->chunk_nrows = scan->chunk_row = 0;
+	MemoryContextReset(scan->chunkcxt);
+	MemoryContextReset(scan->stripecxt);
+
+	pgstat_count_heap_scan(rel);
+}
+
+/*
+ * columnar_endscan - end a scan
+ */
+void
+columnar_endscan(HeapScanDesc sscan)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	MemoryContextDelete(scan->tuplecxt);
+	MemoryContextDelete(scan->chunkcxt);
+	MemoryContextDelete(scan->stripecxt);
+
+	RelationDecrementReferenceCount(sscan->rs_rd);
+
+	if (sscan->rs_strategy != NULL)
+		FreeAccessStrategy(sscan->rs_strategy);
+	if (sscan->rs_key)
+		pfree(sscan->rs_key);
+	if (scan->skeys)
+		pfree(scan->skeys);
+	pfree(scan->projected);
+	pfree(scan->needdir);
+	pfree(scan->values);
+	pfree(scan->isnull);
+	pfree(scan->tupvalues);
+	pfree(scan->tupisnull);
+	pfree(scan->dirs);
+	pfree(scan);
+}
+
+/*
+ * columnar_fetch - fetch a row by TID
+ *
+ * The stripe holding the row is found by reading the stripe headers in
+ * turn.  The tuple is palloc'd in the caller's memory context, and
+ * *userbuf is always set to InvalidBuffer.
+ */
+bool
+columnar_fetch(Relation rel, Snapshot snapshot, HeapTuple tuple,
+			   Buffer *userbuf, bool keep_buf, Relation stats_relation)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	ColumnarStripeHeader hdr;
+	ColumnarStripe stripe;
+	BlockNumber nblocks;
+	BlockNumber start;
+	MemoryContext fetchcxt;
+	MemoryContext oldcxt;
+	Datum	   *values;
+	bool	   *isnull;
+	HeapTuple	result;
+	uint64		rowno;
+	uint32		row;
+	uint32		chunk;
+	bool		found = false;
+	int			i;
+
+	*userbuf = InvalidBuffer;
+	tuple->t_data = NULL;
+
+	columnar_flush_pending(rel);
+
+	if (!columnar_tid_to_rowno(&tuple->t_self, &rowno))
+		return false;
+
+	nblocks = RelationGetNumberOfBlocks(rel);
+	for (start = COLUMNAR_FIRST_STRIPE_BLKNO;
+		 columnar_read_stripe_header(rel, NULL, start, nblocks, &hdr);
+		 start += hdr.nblocks)
+	{
+		if (rowno >= hdr.first_rowno && rowno < hdr.first_rowno + hdr.nrows)
+		{
+			found = true;
+			break;
+		}
+	}
+	if (!found || !columnar_stripe_visible(&hdr, snapshot))
+		return false;
+
+	fetchcxt = AllocSetContextCreate(CurrentMemoryContext,
+									 "columnar fetch",
+									 ALLOCSET_DEFAULT_MINSIZE,
+									 ALLOCSET_DEFAULT_INITSIZE,
+									 ALLOCSET_DEFAULT_MAXSIZE);
+	oldcxt = MemoryContextSwitchTo(fetchcxt);
+
+	columnar_read_stripe(rel, NULL, start, &hdr, &stripe);
+
+	/* find the chunk group */
+	row = (uint32) (rowno - hdr.first_rowno);
+	for (chunk = 0; chunk < hdr.nchunks; chunk++)
+	{
+		if (row < stripe.chunk_nrows[chunk])
+			break;
+		row -= stripe.chunk_nrows[chunk];
+	}
+	if (chunk >= hdr.nchunks)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid stripe header in block %u of columnar table \"%s\"",
+						start, RelationGetRelationName(rel))));
+
+	values = (Datum *) palloc(Max(tupdesc->natts, 1) * sizeof(Datum));
+	isnull = (bool *) palloc(Max(tupdesc->natts, 1) * sizeof(bool));
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = tupdesc->attrs[i];
+		ColumnarChunkDesc desc;
+		uint32		nrows = stripe.chunk_nrows[chunk];
+		Datum	   *chunkvalues;
+		bool	   *chunkisnull;
+		char	   *data;
+
+		values[i] = (Datum) 0;
+		isnull[i] = true;
+		if (att->attisdropped || i >= (int) hdr.natts)
+			continue;
+
+		columnar_read_bytes(rel, NULL, start,
+							stripe.colinfo[i].dir_offset +
+							chunk * sizeof(ColumnarChunkDesc),
+							sizeof(ColumnarChunkDesc), (char *) &desc);
+		data = (char *) palloc(Max(desc.length, 1));
+		columnar_read_bytes(rel, NULL, start,
+							stripe.colinfo[i].data_offset + desc.offset,
+							desc.length, data);
+		chunkvalues = (Datum *) palloc(nrows * sizeof(Datum));
+		chunkisnull = (bool *) palloc(nrows * sizeof(bool));
+		columnar_decode_chunk(att, data, &desc, nrows,
+							  chunkvalues, chunkisnull);
+		values[i] = chunkvalues[row];
+		isnull[i] = chunkisnull[row];
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	result = heap_form_tuple(tupdesc, values, isnull);
+	columnar_set_tuple_header(rel, result, &hdr, rowno);
+	tuple->t_len = result->t_len;
+	tuple->t_tableOid = result->t_tableOid;
+	tuple->t_data = result->t_data;
+
+	MemoryContextDelete(fetchcxt);
+
+	if (stats_relation != NULL)
+		pgstat_count_heap_fetch(stats_relation);
+
+	return true;
+}
+
+/*
+ * qsort comparator for sorting sample rows by TID, as ANALYZE expects
+ */
+static int
+compare_rows(const void *a, const void *b)
+{
+	HeapTuple	ha = *(const HeapTuple *) a;
+	HeapTuple	hb = *(const HeapTuple *) b;
+
+	return ItemPointerCompare(&ha->t_self, &hb->t_self);
+}
+
+/*
+ * columnar_acquire_sample_rows - ANALYZE's row sampler
+ *
+ * Stripes have no fixed number of rows per page for block sampling to work
+ * with, so we read the whole table and pick rows with Vitter's reservoir
+ * algorithm, like the foreign-data wrappers do.
+ */
+int
+columnar_acquire_sample_rows(Relation rel, int elevel,
+							 HeapTuple *rows, int targrows,
+							 double *totalrows, double *totaldeadrows)
+{
+	HeapScanDesc scan;
+	HeapTuple	tuple;
+	ReservoirStateData rstate;
+	double		samplerows = 0;
+	double		rowstoskip = -1;
+	int			numrows = 0;
+
+	reservoir_init_selection_state(&rstate, targrows);
+
+	scan = columnar_beginscan(rel, GetActiveSnapshot(), 0, NULL);
+	while ((tuple = columnar_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		vacuum_delay_point();
+
+		if (numrows < targrows)
+			rows[numrows++] = heap_copytuple(tuple);
+		else
+		{
+			/* see the comments in acquire_sample_rows */
+			if (rowstoskip < 0)
+				rowstoskip = reservoir_get_next_S(&rstate, samplerows, targrows);
+
+			if (rowstoskip <= 0)
+			{
+				int			k = (int) (targrows * sampler_random_fract(rstate.randstate));
+
+				Assert(k >= 0 && k < targrows);
+				heap_freetuple(rows[k]);
+				rows[k] = heap_copytuple(tuple);
+			}
+
+			rowstoskip -= 1;
+		}
+		samplerows += 1;
+	}
+	columnar_endscan(scan);
+
+	/* concurrently written stripes need not be in row number order */
+	qsort((void *) rows, numrows, sizeof(HeapTuple), compare_rows);
+
+	*totalrows = samplerows;
+	*totaldeadrows = 0;
+
+	ereport(elevel,
+			(errmsg("\"%s\": scanned %.0f rows; %d rows in sample",
+					RelationGetRelationName(rel), samplerows, numrows)));
+
+	return numrows;
+}
@@ -0,0 +1,410 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_storage.c
+ *	  Page-level storage of columnar tables.
+ *
+ * The metapage and the stripes go through the buffer manager like any
+ * other relation's pages.  Every page we write is WAL-logged as a full page
+ * image, which is no more WAL than the data itself since stripes are
+ * written once and never updated in place.
+ *
+ * A stripe's pages are added to the end of the relation while holding the
+ * relation extension lock, so that they are consecutive.  A concurrent scan
+ * may therefore see the first pages of a stripe that is still being
+ * written; it stops there, as such a stripe can't be visible to it anyway.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_storage.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar_internal.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "access/xloginsert.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
+#include "storage/procarray.h"
+#include "utils/rel.h"
+#include "utils/tqual.h"
+
+
+static Buffer columnar_lock_metapage(Relation rel);
+
+
+/*
+ * Pin and exclusively lock the metapage, creating it if the relation is
+ * still empty (it has just been created or truncated).
+ */
+static Buffer
+columnar_lock_metapage(Relation rel)
+{
+	Buffer		buf;
+	Page		page;
+	ColumnarMetaPageData *meta;
+
+	if (RelationGetNumberOfBlocks(rel) == 0)
+	{
+		LockRelationForExtension(rel, ExclusiveLock);
+		if (RelationGetNumberOfBlocks(rel) == 0)
+		{
+			buf = ReadBuffer(rel, P_NEW);
+			Assert(BufferGetBlockNumber(buf) == COLUMNAR_METAPAGE_BLKNO);
+			LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+			UnlockRelationForExtension(rel, ExclusiveLock);
+
+			page = BufferGetPage(buf);
+
+			START_CRIT_SECTION();
+
+			PageInit(page, BLCKSZ, 0);
+			meta = (ColumnarMetaPageData *) PageGetContents(page);
+			meta->magic = COLUMNAR_MAGIC;
+			meta->version = COLUMNAR_VERSION;
+			meta->next_rowno = 0;
+			((PageHeader) page)->pd_lower =
+				((char *) meta + sizeof(ColumnarMetaPageData)) - (char *) page;
+
+			MarkBufferDirty(buf);
+			if (RelationNeedsWAL(rel))
+				log_newpage_buffer(buf, true);
+
+			END_CRIT_SECTION();
+
+			return buf;
+		}
+		UnlockRelationForExtension(rel, ExclusiveLock);
+	}
+
+	buf = ReadBuffer(rel, COLUMNAR_METAPAGE_BLKNO);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+	page = BufferGetPage(buf);
+	meta = (ColumnarMetaPageData *) PageGetContents(page);
+	if (PageIsNew(page) || meta->magic != COLUMNAR_MAGIC)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("\"%s\" is not a columnar table",
+						RelationGetRelationName(rel))));
+	if (meta->version != COLUMNAR_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("columnar table \"%s\" has wrong version: %u, expected %u",
+						RelationGetRelationName(rel),
+						meta->version, COLUMNAR_VERSION)));
+
+	return buf;
+}
+
+/*
+ * columnar_reserve_rownos - reserve a range of row numbers
+ *
+ * Returns the first of nrows consecutive row numbers no other stripe will
+ * use.  Row numbers that end up unused are simply skipped.
+ */
+uint64
+columnar_reserve_rownos(Relation rel, uint32 nrows)
+{
+	Buffer		buf;
+	ColumnarMetaPageData *meta;
+	uint64		first;
+
+	buf = columnar_lock_metapage(rel);
+	meta = (ColumnarMetaPageData *) PageGetContents(BufferGetPage(buf));
+
+	first = meta->next_rowno;
+	if (first + nrows > (uint64) MaxBlockNumber * COLUMNAR_ROWS_PER_TID_BLOCK)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("columnar table \"%s\" has run out of row numbers",
+						RelationGetRelationName(rel))));
+
+	START_CRIT_SECTION();
+
+	meta->next_rowno = first + nrows;
+	MarkBufferDirty(buf);
+	if (RelationNeedsWAL(rel))
+		log_newpage_buffer(buf, true);
+
+	END_CRIT_SECTION();
+
+	UnlockReleaseBuffer(buf);
+
+	return first;
+}
+
+void
+columnar_rowno_to_tid(uint64 rowno, ItemPointer tid)
+{
+	ItemPointerSet(tid,
+				   (BlockNumber) (rowno / COLUMNAR_ROWS_PER_TID_BLOCK),
+				   (OffsetNumber) (rowno % COLUMNAR_ROWS_PER_TID_BLOCK + 1));
+}
+
+/*
+ * Returns false if the TID can't be that of a row in a columnar table.
+ */
+bool
+columnar_tid_to_rowno(ItemPointer tid, uint64 *rowno)
+{
+	OffsetNumber offnum;
+
+	if (!ItemPointerIsValid(tid))
+		return false;
+	offnum = ItemPointerGetOffsetNumber(tid);
+	if (offnum > COLUMNAR_ROWS_PER_TID_BLOCK)
+		return false;
+
+	*rowno = (uint64) ItemPointerGetBlockNumber(tid) * COLUMNAR_ROWS_PER_TID_BLOCK +
+		offnum - 1;
+	return true;
+}
+
+/*
+ * columnar_write_stripe - append a stripe to the relation
+ *
+ * The stripe stream is the concatenation of the "pieces", starting with
+ * the header; hdr->length and hdr->nblocks must already be set to match.
+ */
+void
+columnar_write_stripe(Relation rel, ColumnarStripeHeader *hdr,
+					  StringInfo pieces, int npieces)
+{
+	BufferAccessStrategy strategy = GetAccessStrategy(BAS_BULKWRITE);
+	bool		needwal = RelationNeedsWAL(rel);
+	int			piece = 0;
+	int			pieceoff = 0;
+	BlockNumber blkno;
+
+	LockRelationForExtension(rel, ExclusiveLock);
+
+	for (blkno = 0; blkno < hdr->nblocks; blkno++)
+	{
+		Buffer		buf;
+		Page		page;
+		char	   *dest;
+		int			used = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, P_NEW, RBM_NORMAL,
+								 strategy);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		START_CRIT_SECTION();
+
+		PageInit(page, BLCKSZ, 0);
+		dest = PageGetContents(page);
+		while (used < (int) COLUMNAR_PAGE_PAYLOAD && piece < npieces)
+		{
+			int			n = Min((int) COLUMNAR_PAGE_PAYLOAD - used,
+								pieces[piece].len - pieceoff);
+
+			memcpy(dest + used, pieces[piece].data + pieceoff, n);
+			used += n;
+			pieceoff += n;
+			if (pieceoff == pieces[piece].len)
+			{
+				piece++;
+				pieceoff = 0;
+			}
+		}
+		((PageHeader) page)->pd_lower = (dest + used) - (char *) page;
+
+		MarkBufferDirty(buf);
+		if (needwal)
+			log_newpage_buffer(buf, true);
+
+		END_CRIT_SECTION();
+
+		UnlockReleaseBuffer(buf);
+	}
+	Assert(piece == npieces);
+
+	UnlockRelationForExtension(rel, ExclusiveLock);
+
+	FreeAccessStrategy(strategy);
+}
+
+/*
+ * columnar_read_stripe_header - read the header of the stripe at "start"
+ *
+ * Returns false if there's no complete stripe there within the first
+ * "nblocks" pages, which means we've reached the end of the relation, as
+ * far as the caller is concerned.
+ */
+bool
+columnar_read_stripe_header(Relation rel, BufferAccessStrategy strategy,
+							BlockNumber start, BlockNumber nblocks,
+							ColumnarStripeHeader *hdr)
+{
+	Buffer		buf;
+	Page		page;
+	bool		isnew;
+
+	if (start >= nblocks)
+		return false;
+
+	buf = ReadBufferExtended(rel, MAIN_FORKNUM, start, RBM_NORMAL, strategy);
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buf);
+	/* a stripe being written has been extended but not yet filled */
+	isnew = PageIsNew(page);
+	if (!isnew)
+		memcpy(hdr, PageGetContents(page), sizeof(ColumnarStripeHeader));
+	UnlockReleaseBuffer(buf);
+
+	if (isnew)
+		return false;
+	if (hdr->magic != COLUMNAR_MAGIC)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid stripe header in block %u of columnar table \"%s\"",
+						start, RelationGetRelationName(rel))));
+
+	return start + hdr->nblocks <= nblocks;
+}
+
+/*
+ * columnar_read_stripe - read the rest of a stripe's header
+ */
+void
+columnar_read_stripe(Relation rel, BufferAccessStrategy strategy,
+					 BlockNumber start, ColumnarStripeHeader *hdr,
+					 ColumnarStripe *stripe)
+{
+	uint32		offset = sizeof(ColumnarStripeHeader);
+
+	stripe->start = start;
+	stripe->hdr = *hdr;
+	stripe->chunk_nrows = (uint32 *) palloc(Max(hdr->nchunks, 1) * sizeof(uint32));
+	columnar_read_bytes(rel, strategy, start, offset,
+						hdr->nchunks * sizeof(uint32),
+						(char *) stripe->chunk_nrows);
+	offset += hdr->nchunks * sizeof(uint32);
+	stripe->colinfo = (ColumnarColumnInfo *)
+		palloc(Max(hdr->natts, 1) * sizeof(ColumnarColumnInfo));
+	columnar_read_bytes(rel, strategy, start, offset,
+						hdr->natts * sizeof(ColumnarColumnInfo),
+						(char *) stripe->colinfo);
+}
+
+/*
+ * columnar_read_bytes - copy part of a stripe stream to "dest"
+ */
+void
+columnar_read_bytes(Relation rel, BufferAccessStrategy strategy,
+					BlockNumber start, uint32 offset, uint32 length,
+					char *dest)
+{
+	while (length > 0)
+	{
+		BlockNumber blkno = start + offset / COLUMNAR_PAGE_PAYLOAD;
+		uint32		pageoff = offset % COLUMNAR_PAGE_PAYLOAD;
+		uint32		n = Min(length, COLUMNAR_PAGE_PAYLOAD - pageoff);
+		Buffer		buf;
+		Page		page;
+
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
+								 strategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		if (PageIsNew(page))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("unexpected empty page in block %u of columnar table \"%s\"",
+							blkno, RelationGetRelationName(rel))));
+		memcpy(dest, PageGetContents(page) + pageoff, n);
+		UnlockReleaseBuffer(buf);
+
+		dest += n;
+		offset += n;
+		length -= n;
+	}
+}
+
+/*
+ * columnar_read_directory - read one column's chunk directory
+ *
+ * The result is palloc'd: the column's ColumnarChunkDesc array, followed
+ * by the min/max values they point to.
+ */
+char *
+columnar_read_directory(Relation rel, BufferAccessStrategy strategy,
+						ColumnarStripe *stripe, int attnum)
+{
+	ColumnarColumnInfo *ci = &stripe->colinfo[attnum - 1];
+	char	   *dir;
+
+	dir = (char *) palloc(Max(ci->dir_length, 1));
+	columnar_read_bytes(rel, strategy, stripe->start, ci->dir_offset,
+						ci->dir_length, dir);
+
+	return dir;
+}
+
+/*
+ * columnar_set_stripe_xmin - overwrite a stripe's xmin, for VACUUM
+ */
+void
+columnar_set_stripe_xmin(Relation rel, BufferAccessStrategy strategy,
+						 BlockNumber start, TransactionId xmin)
+{
+	Buffer		buf;
+	ColumnarStripeHeader *hdr;
+
+	buf = ReadBufferExtended(rel, MAIN_FORKNUM, start, RBM_NORMAL, strategy);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+	hdr = (ColumnarStripeHeader *) PageGetContents(BufferGetPage(buf));
+	Assert(hdr->magic == COLUMNAR_MAGIC);
+
+	START_CRIT_SECTION();
+
+	hdr->xmin = xmin;
+	MarkBufferDirty(buf);
+	if (RelationNeedsWAL(rel))
+		log_newpage_buffer(buf, true);
+
+	END_CRIT_SECTION();
+
+	UnlockReleaseBuffer(buf);
+}
+
+/*
+ * columnar_stripe_visible - are the stripe's rows visible to the snapshot?
+ *
+ * Stripes are never deleted, so this is the xmin half of the heap's
+ * visibility rules.
+ */
+bool
+columnar_stripe_visible(ColumnarStripeHeader *hdr, Snapshot snapshot)
+{
+	TransactionId xmin = hdr->xmin;
+
+	/* VACUUM found that the inserting transaction aborted */
+	if (!TransactionIdIsValid(xmin))
+		return false;
+
+	if (snapshot->satisfies == HeapTupleSatisfiesAny)
+		return true;
+
+	if (TransactionIdIsCurrentTransactionId(xmin))
+		return !IsMVCCSnapshot(snapshot) || hdr->cmin < snapshot->curcid;
+
+	if (IsMVCCSnapshot(snapshot))
+	{
+		if (XidInMVCCSnapshot(xmin, snapshot))
+			return false;
+	}
+	else if (TransactionIdIsInProgress(xmin))
+		return false;
+
+	return TransactionIdDidCommit(xmin);
+}
@@ -0,0 +1,553 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_writer.c
+ *	  Buffering inserted rows and writing them out as stripes.
+ *
+ * Rows inserted into a columnar table are collected in a per-relation write
+ * state, column by column, until there are enough of them to form a stripe,
+ * or the inserting statement ends.  Each completed chunk is encoded right
+ * away, so the write state holds at most one chunk of unencoded values.
+ *
+ * A stripe's rows must all have the same xmin and cmin, so the write state
+ * is flushed whenever a row arrives from a different command or
+ * subtransaction.  The write states of a subtransaction that aborts are
+ * thrown away, and any left at commit are flushed before the commit record
+ * is written.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_writer.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/columnar_internal.h"
+#include "access/tuptoaster.h"
+#include "access/xact.h"
+#include "pgstat.h"
+#include "storage/predicate.h"
+#include "utils/datum.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/typcache.h"
+
+
+typedef struct ColumnarWriteState
+{
+	struct ColumnarWriteState *next;
+
+	Oid			relid;
+	TransactionId xid;			/* xmin of the rows */
+	CommandId	cid;			/* cmin of the rows */
+	SubTransactionId subid;		/* subtransaction that inserted them */
+
+	MemoryContext context;		/* holds all of the below */
+	MemoryContext chunkcxt;		/* values of the current chunk */
+
+	TupleDesc	tupdesc;
+	int			natts;
+	FmgrInfo  **cmpfuncs;		/* [natts] btree comparison, or NULL */
+
+	/* the chunk being collected */
+	Datum	  **values;			/* [natts][COLUMNAR_CHUNK_ROWS] */
+	bool	  **isnull;			/* [natts][COLUMNAR_CHUNK_ROWS] */
+	int			chunk_nrows;
+	Size		chunk_bytes;
+
+	/* the encoded chunks of the stripe */
+	StringInfoData *data;		/* [natts] chunk data */
+	StringInfoData *descs;		/* [natts] ColumnarChunkDesc arrays */
+	StringInfoData *minmax;		/* [natts] min/max values */
+	StringInfoData chunk_rows;	/* uint32 array, rows of each chunk */
+	int			nchunks;
+	Size		stripe_bytes;
+
+	uint64		first_rowno;	/* reserved row numbers */
+	uint32		stripe_nrows;
+} ColumnarWriteState;
+
+/* write states of the current transaction, in TopTransactionContext */
+static ColumnarWriteState *write_states = NULL;
+
+
+static ColumnarWriteState *columnar_get_write_state(Relation rel,
+						 CommandId cid);
+static ColumnarWriteState *columnar_find_write_state(Oid relid);
+static void columnar_free_write_state(ColumnarWriteState *state);
+static void columnar_finish_chunk(ColumnarWriteState *state);
+static void columnar_flush_stripe(Relation rel, ColumnarWriteState *state);
+
+
+/*
+ * Look up the write state of a relation, without creating one.
+ */
+static ColumnarWriteState *
+columnar_find_write_state(Oid relid)
+{
+	ColumnarWriteState *state;
+
+	for (state = write_states; state != NULL; state = state->next)
+	{
+		if (state->relid == relid)
+			return state;
+	}
+	return NULL;
+}
+
+/*
+ * Unlink a write state and release its memory.
+ */
+static void
+columnar_free_write_state(ColumnarWriteState *state)
+{
+	ColumnarWriteState **prev;
+
+	for (prev = &write_states; *prev != NULL; prev = &(*prev)->next)
+	{
+		if (*prev == state)
+		{
+			*prev = state->next;
+			break;
+		}
+	}
+	MemoryContextDelete(state->context);
+}
+
+/*
+ * Get the write state for inserting into rel as command cid of the current
+ * subtransaction, flushing rows of another command or subtransaction first.
+ */
+static ColumnarWriteState *
+columnar_get_write_state(Relation rel, CommandId cid)
+{
+	TransactionId xid = GetCurrentTransactionId();
+	SubTransactionId subid = GetCurrentSubTransactionId();
+	ColumnarWriteState *state;
+	MemoryContext context;
+	MemoryContext oldcxt;
+	int			natts;
+	int			i;
+
+	state = columnar_find_write_state(RelationGetRelid(rel));
+	if (state != NULL)
+	{
+		if (state->xid == xid && state->cid == cid && state->subid == subid &&
+			state->natts == RelationGetNumberOfAttributes(rel))
+			return state;
+		columnar_flush_stripe(rel, state);
+		columnar_free_write_state(state);
+	}
+
+	context = AllocSetContextCreate(TopTransactionContext,
+									"columnar write state",
+									ALLOCSET_DEFAULT_MINSIZE,
+									ALLOCSET_DEFAULT_INITSIZE,
+									ALLOCSET_DEFAULT_MAXSIZE);
+	oldcxt = MemoryContextSwitchTo(context);
+
+	state = (ColumnarWriteState *) palloc0(sizeof(ColumnarWriteState));
+	state->relid = RelationGetRelid(rel);
+	state->xid = xid;
+	state->cid = cid;
+	state->subid = subid;
+	state->context = context;
+	state->chunkcxt = AllocSetContextCreate(context,
+											"columnar chunk",
+											ALLOCSET_DEFAULT_MINSIZE,
+											ALLOCSET_DEFAULT_INITSIZE,
+											ALLOCSET_DEFAULT_MAXSIZE);
+	state->tupdesc = CreateTupleDescCopy(RelationGetDescr(rel));
+	natts = state->natts = state->tupdesc->natts;
+
+	state->cmpfuncs = (FmgrInfo **) palloc0(Max(natts, 1) * sizeof(FmgrInfo *));
+	state->values = (Datum **) palloc(Max(natts, 1) * sizeof(Datum *));
+	state->isnull = (bool **) palloc(Max(natts, 1) * sizeof(bool *));
+	state->data = (StringInfoData *) palloc(Max(natts, 1) * sizeof(StringInfoData));
+	state->descs = (StringInfoData *) palloc(Max(natts, 1) * sizeof(StringInfoData));
+	state->minmax = (StringInfoData *) palloc(Max(natts, 1) * sizeof(StringInfoData));
+	for (i = 0; i < natts; i++)
+	{
+		Form_pg_attribute att = state->tupdesc->attrs[i];
+
+		if (!att->attisdropped)
+		{
+			TypeCacheEntry *typentry;
+
+			typentry = lookup_type_cache(att->atttypid,
+										 TYPECACHE_CMP_PROC_FINFO);
+			if (OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+				state->cmpfuncs[i] = &typentry->cmp_proc_finfo;
+		}
+		state->values[i] = (Datum *) palloc(COLUMNAR_CHUNK_ROWS * sizeof(Datum));
+		state->isnull[i] = (bool *) palloc(COLUMNAR_CHUNK_ROWS * sizeof(bool));
+		initStringInfo(&state->data[i]);
+		initStringInfo(&state->descs[i]);
+		initStringInfo(&state->minmax[i]);
+	}
+	initStringInfo(&state->chunk_rows);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	state->next = write_states;
+	write_states = state;
+
+	return state;
+}
+
+/*
+ * Encode the chunk collected so far, and compute its min/max values.
+ */
+static void
+columnar_finish_chunk(ColumnarWriteState *state)
+{
+	int			nrows = state->chunk_nrows;
+	uint32		nrows32 = nrows;
+	MemoryContext oldcxt;
+	int			i;
+
+	Assert(nrows > 0);
+
+	oldcxt = MemoryContextSwitchTo(state->chunkcxt);
+
+	for (i = 0; i < state->natts; i++)
+	{
+		Form_pg_attribute att = state->tupdesc->attrs[i];
+		FmgrInfo   *cmpfunc = state->cmpfuncs[i];
+		Datum	   *values = state->values[i];
+		bool	   *isnull = state->isnull[i];
+		ColumnarChunkDesc desc;
+		int			oldlen = state->data[i].len;
+
+		memset(&desc, 0, sizeof(desc));
+		columnar_encode_chunk(att, values, isnull, nrows,
+							  &state->data[i], &desc);
+		state->stripe_bytes += state->data[i].len - oldlen;
+
+		if (cmpfunc != NULL && !(desc.flags & COLUMNAR_CHUNK_ALLNULL))
+		{
+			Datum		min = (Datum) 0;
+			Datum		max = (Datum) 0;
+			bool		found = false;
+			StringInfoData buf;
+			int			j;
+
+			for (j = 0; j < nrows; j++)
+			{
+				if (isnull[j])
+					continue;
+				if (!found)
+				{
+					min = max = values[j];
+					found = true;
+					continue;
+				}
+				if (DatumGetInt32(FunctionCall2Coll(cmpfunc, att->attcollation,
+													values[j], min)) < 0)
+					min = values[j];
+				else if (DatumGetInt32(FunctionCall2Coll(cmpfunc,
+														 att->attcollation,
+														 values[j], max)) > 0)
+					max = values[j];
+			}
+
+			/* long values would make the directory as big as the data */
+			initStringInfo(&buf);
+			columnar_serialize_datum(att, min, &buf);
+			desc.min_length = buf.len;
+			columnar_serialize_datum(att, max, &buf);
+			desc.max_length = buf.len - desc.min_length;
+			if (desc.min_length <= COLUMNAR_MAX_MINMAX_LEN &&
+				desc.max_length <= COLUMNAR_MAX_MINMAX_LEN)
+			{
+				desc.flags |= COLUMNAR_CHUNK_HASMINMAX;
+				desc.minmax_offset = state->minmax[i].len;
+				appendBinaryStringInfo(&state->minmax[i], buf.data, buf.len);
+			}
+			else
+				desc.min_length = desc.max_length = 0;
+		}
+
+		appendBinaryStringInfo(&state->descs[i], (char *) &desc, sizeof(desc));
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	appendBinaryStringInfo(&state->chunk_rows, (char *) &nrows32,
+						   sizeof(uint32));
+	state->nchunks++;
+	state->chunk_nrows = 0;
+	state->chunk_bytes = 0;
+	MemoryContextReset(state->chunkcxt);
+}
+
+/*
+ * Write out the rows collected so far as a stripe, leaving the write state
+ * empty.
+ */
+static void
+columnar_flush_stripe(Relation rel, ColumnarWriteState *state)
+{
+	ColumnarStripeHeader hdr;
+	ColumnarColumnInfo *colinfo;
+	StringInfoData *pieces;
+	int			npieces;
+	uint64		offset;
+	int			natts = state->natts;
+	int			i;
+
+	if (state->chunk_nrows > 0)
+		columnar_finish_chunk(state);
+	if (state->stripe_nrows == 0)
+		return;
+
+	colinfo = (ColumnarColumnInfo *)
+		palloc(Max(natts, 1) * sizeof(ColumnarColumnInfo));
+	offset = sizeof(ColumnarStripeHeader) + state->chunk_rows.len +
+		natts * sizeof(ColumnarColumnInfo);
+	for (i = 0; i < natts; i++)
+	{
+		colinfo[i].dir_offset = (uint32) offset;
+		colinfo[i].dir_length = state->descs[i].len + state->minmax[i].len;
+		offset += colinfo[i].dir_length;
+		colinfo[i].data_offset = (uint32) offset;
+		colinfo[i].data_length = state->data[i].len;
+		offset += colinfo[i].data_length;
+	}
+	if (offset > PG_UINT32_MAX - BLCKSZ)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("columnar stripe of table \"%s\" is too large",
+						RelationGetRelationName(rel))));
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = COLUMNAR_MAGIC;
+	hdr.natts = natts;
+	hdr.length = (uint32) offset;
+	hdr.nblocks = (hdr.length + COLUMNAR_PAGE_PAYLOAD - 1) / COLUMNAR_PAGE_PAYLOAD;
+	hdr.xmin = state->xid;
+	hdr.cmin = state->cid;
+	hdr.first_rowno = state->first_rowno;
+	hdr.nrows = state->stripe_nrows;
+	hdr.nchunks = state->nchunks;
+
+	/* header, chunk sizes and column info go in the first piece */
+	npieces = 1 + 3 * natts;
+	pieces = (StringInfoData *) palloc(npieces * sizeof(StringInfoData));
+	initStringInfo(&pieces[0]);
+	appendBinaryStringInfo(&pieces[0], (char *) &hdr, sizeof(hdr));
+	appendBinaryStringInfo(&pieces[0], state->chunk_rows.data,
+						   state->chunk_rows.len);
+	appendBinaryStringInfo(&pieces[0], (char *) colinfo,
+						   natts * sizeof(ColumnarColumnInfo));
+	for (i = 0; i < natts; i++)
+	{
+		pieces[1 + 3 * i] = state->descs[i];
+		pieces[2 + 3 * i] = state->minmax[i];
+		pieces[3 + 3 * i] = state->data[i];
+	}
+
+	columnar_write_stripe(rel, &hdr, pieces, npieces);
+
+	pfree(pieces[0].data);
+	pfree(pieces);
+	pfree(colinfo);
+
+	for (i = 0; i < natts; i++)
+	{
+		resetStringInfo(&state->data[i]);
+		resetStringInfo(&state->descs[i]);
+		resetStringInfo(&state->minmax[i]);
+	}
+	resetStringInfo(&state->chunk_rows);
+	state->nchunks = 0;
+	state->stripe_bytes = 0;
+	state->stripe_nrows = 0;
+}
+
+/*
+ * columnar_tuple_insert - insert a row into a columnar table
+ *
+ * The row is only buffered; its TID is assigned right away, though.
+ */
+Oid
+columnar_tuple_insert(Relation rel, HeapTuple tup, CommandId cid,
+					  int options, BulkInsertState bistate)
+{
+	ColumnarWriteState *state;
+	MemoryContext oldcxt;
+	TupleDesc	tupdesc;
+	Datum	   *values;
+	bool	   *isnull;
+	int			row;
+	int			i;
+
+	if (rel->rd_rel->relhasoids)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("columnar tables cannot have OIDs")));
+
+	/* we can't tell which rows a reader saw; see heap_insert */
+	CheckForSerializableConflictIn(rel, NULL, InvalidBuffer);
+
+	state = columnar_get_write_state(rel, cid);
+	tupdesc = state->tupdesc;
+
+	if (state->stripe_nrows == 0)
+		state->first_rowno = columnar_reserve_rownos(rel, COLUMNAR_STRIPE_ROWS);
+
+	oldcxt = MemoryContextSwitchTo(state->chunkcxt);
+
+	values = (Datum *) palloc(Max(state->natts, 1) * sizeof(Datum));
+	isnull = (bool *) palloc(Max(state->natts, 1) * sizeof(bool));
+	heap_deform_tuple(tup, tupdesc, values, isnull);
+
+	row = state->chunk_nrows;
+	for (i = 0; i < state->natts; i++)
+	{
+		Form_pg_attribute att = tupdesc->attrs[i];
+		Datum		value = values[i];
+
+		state->isnull[i][row] = isnull[i];
+		if (isnull[i])
+		{
+			state->values[i][row] = (Datum) 0;
+			continue;
+		}
+
+		if (att->attlen == -1 &&
+			(VARATT_IS_EXTERNAL(DatumGetPointer(value)) ||
+			 VARATT_IS_COMPRESSED(DatumGetPointer(value))))
+			value = PointerGetDatum(heap_tuple_untoast_attr((struct varlena *)
+												 DatumGetPointer(value)));
+		else
+			value = datumCopy(value, att->attbyval, att->attlen);
+
+		state->values[i][row] = value;
+		state->chunk_bytes += columnar_datum_size(att, value);
+	}
+
+	pfree(values);
+	pfree(isnull);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	/* fill in the tuple header, as heap_insert would */
+	tup->t_data->t_infomask &= ~(HEAP_XACT_MASK);
+	tup->t_data->t_infomask2 &= ~(HEAP2_XACT_MASK);
+	tup->t_data->t_infomask |= HEAP_XMAX_INVALID;
+	HeapTupleHeaderSetXmin(tup->t_data, state->xid);
+	HeapTupleHeaderSetCmin(tup->t_data, cid);
+	HeapTupleHeaderSetXmax(tup->t_data, 0);
+	tup->t_tableOid = RelationGetRelid(rel);
+	columnar_rowno_to_tid(state->first_rowno + state->stripe_nrows,
+						  &tup->t_self);
+	tup->t_data->t_ctid = tup->t_self;
+
+	state->chunk_nrows++;
+	state->stripe_nrows++;
+
+	if (state->chunk_nrows >= COLUMNAR_CHUNK_ROWS ||
+		state->chunk_bytes >= COLUMNAR_CHUNK_MAX_BYTES)
+		columnar_finish_chunk(state);
+	if (state->stripe_nrows >= COLUMNAR_STRIPE_ROWS ||
+		state->stripe_bytes + state->chunk_bytes >= COLUMNAR_STRIPE_MAX_BYTES)
+		columnar_flush_stripe(rel, state);
+
+	pgstat_count_heap_insert(rel, 1);
+
+	return InvalidOid;
+}
+
+/*
+ * columnar_flush_pending - write out the rows buffered for a relation
+ *
+ * Called before scanning the relation, so that the scan sees rows inserted
+ * earlier by the same command, as with a heap.
+ */
+void
+columnar_flush_pending(Relation rel)
+{
+	ColumnarWriteState *state;
+
+	state = columnar_find_write_state(RelationGetRelid(rel));
+	if (state != NULL)
+	{
+		columnar_flush_stripe(rel, state);
+		columnar_free_write_state(state);
+	}
+}
+
+/*
+ * columnar_finish_bulk_insert - the inserting statement is done
+ */
+void
+columnar_finish_bulk_insert(Relation rel, int options)
+{
+	columnar_flush_pending(rel);
+}
+
+/*
+ * PreCommit_Columnar - write out rows still buffered at commit
+ *
+ * Normally the statement that inserted the rows has already done this.
+ */
+void
+PreCommit_Columnar(void)
+{
+	while (write_states != NULL)
+	{
+		ColumnarWriteState *state = write_states;
+		Relation	rel;
+
+		rel = RelationIdGetRelation(state->relid);
+		if (RelationIsValid(rel))
+		{
+			columnar_flush_stripe(rel, state);
+			RelationClose(rel);
+		}
+		columnar_free_write_state(state);
+	}
+}
+
+/*
+ * AtEOXact_Columnar - forget the write states at transaction end
+ *
+ * Their memory goes away with TopTransactionContext.
+ */
+void
+AtEOXact_Columnar(bool isCommit)
+{
+	write_states = NULL;
+}
+
+/*
+ * AtEOSubXact_Columnar - subtransaction commit or abort
+ *
+ * Rows of a committed subtransaction now belong to its parent; those of an
+ * aborted one are discarded.
+ */
+void
+AtEOSubXact_Columnar(bool isCommit, SubTransactionId mySubid,
+					 SubTransactionId parentSubid)
+{
+	ColumnarWriteState *state = write_states;
+
+	while (state != NULL)
+	{
+		ColumnarWriteState *next = state->next;
+
+		if (state->subid == mySubid)
+		{
+			if (isCommit)
+				state->subid = parentSubid;
+			else
+				columnar_free_write_state(state);
+		}
+		state = next;
+	}
+}
@@ -15,13 +15,22 @@
  */
 #include "postgres.h"
 
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
 #include "access/printtup.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
+#include "miscadmin.h"
 #include "tcop/pquery.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 
 
 static void printtup_startup(DestReceiver *self, int operation,
@@ -31,6 +40,9 @@ static void printtup_20(TupleTableSlot *slot, DestReceiver *self);
 static void printtup_internal_20(TupleTableSlot *slot, DestReceiver *self);
 static void printtup_shutdown(DestReceiver *self);
 static void printtup_destroy(DestReceiver *self);
+static bool printtup_has_fast_text(Oid typoutput);
+static void printtup_send_fast_text(StringInfo buf, Oid typoutput,
+						Datum attr);
 
 
 /* ----------------------------------------------------------------
@@ -50,6 +62,7 @@ typedef struct
 	Oid			typoutput;		/* Oid for the type's text output fn */
 	Oid			typsend;		/* Oid for the type's binary output fn */
 	bool		typisvarlena;	/* is it varlena (ie possibly toastable)? */
+	bool		fasttext;		/* use printtup_send_fast_text for output? */
 	int16		format;			/* format code for this column */
 	FmgrInfo	finfo;			/* Precomputed call info for output fn */
 } PrinttupAttrInfo;
@@ -280,6 +293,7 @@ printtup_prepare_info(DR_printtup *myState, TupleDesc typeinfo, int numAttrs)
 							  &thisState->typoutput,
 							  &thisState->typisvarlena);
 			fmgr_info(thisState->typoutput, &thisState->finfo);
+			thisState->fasttext = printtup_has_fast_text(thisState->typoutput);
 		}
 		else if (format == 1)
 		{
@@ -354,10 +368,15 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 		if (thisState->format == 0)
 		{
 			/* Text output */
-			char	   *outputstr;
+			if (thisState->fasttext)
+				printtup_send_fast_text(&buf, thisState->typoutput, attr);
+			else
+			{
+				char	   *outputstr;
 
-			outputstr = OutputFunctionCall(&thisState->finfo, attr);
-			pq_sendcountedtext(&buf, outputstr, strlen(outputstr), false);
+				outputstr = OutputFunctionCall(&thisState->finfo, attr);
+				pq_sendcountedtext(&buf, outputstr, strlen(outputstr), false);
+			}
 		}
 		else
 		{
@@ -378,6 +397,112 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 	MemoryContextReset(myState->tmpcontext);
 }
 
+/*
+ * Longest text printtup_send_fast_text can produce, plus the trailing null.
+ * The date/time encoders need the most room; the numbers need far less.
+ */
+#define FAST_TEXT_MAXLEN	(MAXDATELEN + 1)
+
+/*
+ * Does printtup_send_fast_text know how to do this output function's job?
+ */
+static bool
+printtup_has_fast_text(Oid typoutput)
+{
+	switch (typoutput)
+	{
+		case F_INT4OUT:
+		case F_INT8OUT:
+		case F_FLOAT8OUT:
+		case F_BOOLOUT:
+		case F_DATE_OUT:
+		case F_TIMESTAMP_OUT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * printtup_send_fast_text --- append the text form of a common type's value
+ *
+ * This produces the same bytes as the type's output function followed by
+ * pq_sendcountedtext, but writes the text straight into the message buffer
+ * instead of going through fmgr and a palloc'd string.  The output of all
+ * these types is plain ASCII, which is the same in every encoding we can
+ * convert to, so there's no encoding conversion to do.
+ */
+static void
+printtup_send_fast_text(StringInfo buf, Oid typoutput, Datum attr)
+{
+	char	   *str;
+	int			len;
+	uint32		n32;
+
+	/* Leave room for the length word, and write the text after it */
+	enlargeStringInfo(buf, 4 + FAST_TEXT_MAXLEN);
+	str = buf->data + buf->len + 4;
+
+	switch (typoutput)
+	{
+		case F_INT4OUT:
+			pg_ltoa(DatumGetInt32(attr), str);
+			break;
+		case F_INT8OUT:
+			pg_lltoa(DatumGetInt64(attr), str);
+			break;
+		case F_FLOAT8OUT:
+			float8out_internal(DatumGetFloat8(attr), str, FAST_TEXT_MAXLEN);
+			break;
+		case F_BOOLOUT:
+			str[0] = DatumGetBool(attr) ? 't' : 'f';
+			str[1] = '\0';
+			break;
+		case F_DATE_OUT:
+			{
+				/* See date_out */
+				DateADT		date = DatumGetDateADT(attr);
+				struct pg_tm tt,
+						   *tm = &tt;
+
+				if (DATE_NOT_FINITE(date))
+					EncodeSpecialDate(date, str);
+				else
+				{
+					j2date(date + POSTGRES_EPOCH_JDATE,
+						   &(tm->tm_year), &(tm->tm_mon), &(tm->tm_mday));
+					EncodeDateOnly(tm, DateStyle, str);
+				}
+			}
+			break;
+		case F_TIMESTAMP_OUT:
+			{
+				/* See timestamp_out */
+				Timestamp	timestamp = DatumGetTimestamp(attr);
+				struct pg_tm tt,
+						   *tm = &tt;
+				fsec_t		fsec;
+
+				if (TIMESTAMP_NOT_FINITE(timestamp))
+					EncodeSpecialTimestamp(timestamp, str);
+				else if (timestamp2tm(timestamp, NULL, tm, &fsec, NULL, NULL) == 0)
+					EncodeDateTime(tm, fsec, false, 0, NULL, DateStyle, str);
+				else
+					ereport(ERROR,
+							(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+							 errmsg("timestamp out of range")));
+			}
+			break;
+		default:
+			elog(ERROR, "no fast text output for function %u", typoutput);
+	}
+
+	len = strlen(str);
+	n32 = htonl((uint32) len);
+	memcpy(buf->data + buf->len, &n32, 4);
+	buf->len += 4 + len;
+}
+
 /* ----------------
  *		printtup_20 --- print a tuple in protocol 2.0
  * ----------------
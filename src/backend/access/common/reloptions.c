@@ -69,6 +69,22 @@ static relopt_bool boolRelOpts[] =
 		},
 		false
 	},
+	{
+		{
+			"compression",
+			"Stores the relation's pages compressed",
+			RELOPT_KIND_HEAP | RELOPT_KIND_BTREE
+		},
+		false
+	},
+	{
+		{
+			"autosummarize",
+			"Enables automatic summarization on this BRIN index",
+			RELOPT_KIND_BRIN
+		},
+		false
+	},
 	{
 		{
 			"fastupdate",
@@ -85,6 +101,14 @@ static relopt_bool boolRelOpts[] =
 		},
 		false
 	},
+	{
+		{
+			"incremental_maintenance",
+			"Keeps the materialized view up to date as its base tables change",
+			RELOPT_KIND_MATVIEW
+		},
+		false
+	},
 	/* list terminator */
 	{{NULL}}
 };
@@ -159,7 +183,7 @@ static relopt_int intRelOpts[] =
 		{
 			"autovacuum_vacuum_cost_limit",
 			"Vacuum cost amount available before napping, for autovacuum",
-			RELOPT_KIND_HEAP | RELOPT_KIND_TOAST
+			RELOPT_KIND_HEAP | RELOPT_KIND_TOAST | RELOPT_KIND_TABLESPACE
 		},
 		-1, 1, 10000
 	},
@@ -224,6 +248,14 @@ static relopt_int intRelOpts[] =
 			RELOPT_KIND_BRIN
 		}, 128, 1, 131072
 	},
+	{
+		{
+			"parallel_workers",
+			"Number of parallel workers to use for building indexes on this table",
+			RELOPT_KIND_HEAP
+		},
+		-1, 0, 1024
+	},
 	{
 		{
 			"gin_pending_list_limit",
@@ -1230,7 +1262,13 @@ default_reloptions(Datum reloptions, bool validate, relopt_kind kind)
 		{"autovacuum_analyze_scale_factor", RELOPT_TYPE_REAL,
 		offsetof(StdRdOptions, autovacuum) +offsetof(AutoVacOpts, analyze_scale_factor)},
 		{"user_catalog_table", RELOPT_TYPE_BOOL,
-		offsetof(StdRdOptions, user_catalog_table)}
+		offsetof(StdRdOptions, user_catalog_table)},
+		{"parallel_workers", RELOPT_TYPE_INT,
+		offsetof(StdRdOptions, parallel_workers)},
+		{"compression", RELOPT_TYPE_BOOL,
+		offsetof(StdRdOptions, compression)},
+		{"incremental_maintenance", RELOPT_TYPE_BOOL,
+		offsetof(StdRdOptions, incremental_maintenance)}
 	};
 
 	options = parseRelOptions(reloptions, validate, kind, &numoptions);
@@ -1303,8 +1341,10 @@ heap_reloptions(char relkind, Datum reloptions, bool validate)
 			}
 			return (bytea *) rdopts;
 		case RELKIND_RELATION:
-		case RELKIND_MATVIEW:
 			return default_reloptions(reloptions, validate, RELOPT_KIND_HEAP);
+		case RELKIND_MATVIEW:
+			return default_reloptions(reloptions, validate,
+						  (relopt_kind) (RELOPT_KIND_HEAP | RELOPT_KIND_MATVIEW));
 		default:
 			/* other relkinds are not supported */
 			return NULL;
@@ -1392,7 +1432,8 @@ tablespace_reloptions(Datum reloptions, bool validate)
 	int			numoptions;
 	static const relopt_parse_elt tab[] = {
 		{"random_page_cost", RELOPT_TYPE_REAL, offsetof(TableSpaceOpts, random_page_cost)},
-		{"seq_page_cost", RELOPT_TYPE_REAL, offsetof(TableSpaceOpts, seq_page_cost)}
+		{"seq_page_cost", RELOPT_TYPE_REAL, offsetof(TableSpaceOpts, seq_page_cost)},
+		{"autovacuum_vacuum_cost_limit", RELOPT_TYPE_INT, offsetof(TableSpaceOpts, autovacuum_vacuum_cost_limit)}
 	};
 
 	options = parseRelOptions(reloptions, validate, RELOPT_KIND_TABLESPACE,
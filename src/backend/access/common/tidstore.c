@@ -0,0 +1,261 @@
+/*-------------------------------------------------------------------------
+ *
+ * tidstore.c
+ *	  compact store of heap TIDs, such as the dead tuples found by vacuum
+ *
+ * A TID store lives in a single chunk of memory provided by the caller, so
+ * it can be placed in dynamic shared memory as easily as in local memory.
+ * The TIDs are kept per heap block: for each block there is a fixed-size
+ * entry giving its block number, and a bitmap of the offsets on it, just
+ * long enough to reach the highest one.  The block entries grow upwards
+ * from the start of the space, and the bitmaps downwards from its end; the
+ * store is full when they could meet at the next block.
+ *
+ * A block with a handful of dead tuples thus takes some 10 to 20 bytes, and
+ * one full of them a bit over a byte per 8 tuples, against 6 bytes for each
+ * TID in a plain array.  Blocks must be added in ascending order, all of
+ * a block's TIDs at once, which is how vacuum's heap scan finds them.
+ * Looking up a TID takes a binary search among the blocks rather than all
+ * the TIDs, and then a single bit test.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/common/tidstore.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/tidstore.h"
+#include "storage/bufpage.h"
+#include "storage/shmem.h"
+
+typedef struct TidStoreBlock
+{
+	BlockNumber blkno;
+	uint32		bitmap;			/* offset of the block's bitmap in the space */
+} TidStoreBlock;
+
+struct TidStore
+{
+	uint32		size;			/* size of the space, this header included */
+	uint32		bitmap_start;	/* offset of the lowest bitmap byte */
+	int			nblocks;		/* number of blocks stored */
+	int64		ntids;			/* number of TIDs stored */
+	TidStoreBlock blocks[FLEXIBLE_ARRAY_MEMBER];
+};
+
+#define SizeOfTidStore	offsetof(TidStore, blocks)
+
+/* bitmap bytes needed to reach offset number "off" */
+#define BITMAP_BYTES(off)	(((off) - 1) / BITS_PER_BYTE + 1)
+
+/* most space a single block can take */
+#define MAX_BLOCK_SPACE \
+	(sizeof(TidStoreBlock) + BITMAP_BYTES(MaxOffsetNumber))
+
+/*
+ * The bitmap of the i'th block ends where the previous block's begins.
+ */
+#define BlockBitmap(store, i) \
+	((uint8 *) (store) + (store)->blocks[i].bitmap)
+#define BlockBitmapBytes(store, i) \
+	(((i) == 0 ? (store)->size : (store)->blocks[(i) - 1].bitmap) - \
+	 (store)->blocks[i].bitmap)
+
+/*
+ * TidStoreSizeForBlocks - space that is sure to hold TIDs from nblocks blocks
+ */
+Size
+TidStoreSizeForBlocks(BlockNumber nblocks)
+{
+	Size		size;
+
+	size = add_size(SizeOfTidStore, mul_size(nblocks, MAX_BLOCK_SPACE));
+
+	return Min(size, TIDSTORE_MAX_SIZE);
+}
+
+/*
+ * TidStoreCreate - set up an empty TID store in the given space
+ *
+ * The space must be suitably aligned, and is used up to TIDSTORE_MAX_SIZE.
+ */
+TidStore *
+TidStoreCreate(void *space, Size size)
+{
+	TidStore   *store = (TidStore *) space;
+
+	if (size < SizeOfTidStore + MAX_BLOCK_SPACE)
+		elog(ERROR, "TID store of %zu bytes is too small", size);
+
+	store->size = (uint32) Min(size, TIDSTORE_MAX_SIZE);
+	TidStoreReset(store);
+
+	return store;
+}
+
+/*
+ * TidStoreReset - forget all the TIDs in the store
+ */
+void
+TidStoreReset(TidStore *store)
+{
+	store->bitmap_start = store->size;
+	store->nblocks = 0;
+	store->ntids = 0;
+}
+
+/*
+ * TidStoreIsFull - is there space left for another block's TIDs?
+ */
+bool
+TidStoreIsFull(TidStore *store)
+{
+	Size		used = SizeOfTidStore + store->nblocks * sizeof(TidStoreBlock);
+
+	return store->bitmap_start - used < MAX_BLOCK_SPACE;
+}
+
+/*
+ * TidStoreAddBlock - add TIDs from a heap block
+ *
+ * blkno must be higher than that of any block already in the store, and
+ * the store must not be full.  The offsets needn't be in order.
+ */
+void
+TidStoreAddBlock(TidStore *store, BlockNumber blkno,
+				 OffsetNumber *offsets, int noffsets)
+{
+	OffsetNumber maxoff = InvalidOffsetNumber;
+	uint8	   *bitmap;
+	int			nbytes;
+	int			i;
+
+	if (noffsets == 0)
+		return;
+
+	Assert(!TidStoreIsFull(store));
+	Assert(store->nblocks == 0 ||
+		   store->blocks[store->nblocks - 1].blkno < blkno);
+
+	for (i = 0; i < noffsets; i++)
+	{
+		Assert(OffsetNumberIsValid(offsets[i]));
+		maxoff = Max(maxoff, offsets[i]);
+	}
+
+	nbytes = BITMAP_BYTES(maxoff);
+	store->bitmap_start -= nbytes;
+	bitmap = (uint8 *) store + store->bitmap_start;
+	memset(bitmap, 0, nbytes);
+
+	for (i = 0; i < noffsets; i++)
+	{
+		int			bit = offsets[i] - 1;
+
+		bitmap[bit / BITS_PER_BYTE] |= 1 << (bit % BITS_PER_BYTE);
+	}
+
+	store->blocks[store->nblocks].blkno = blkno;
+	store->blocks[store->nblocks].bitmap = store->bitmap_start;
+	store->nblocks++;
+	store->ntids += noffsets;
+}
+
+/*
+ * TidStoreIsMember - is the TID in the store?
+ */
+bool
+TidStoreIsMember(TidStore *store, ItemPointer tid)
+{
+	BlockNumber blkno = ItemPointerGetBlockNumber(tid);
+	int			bit = ItemPointerGetOffsetNumber(tid) - 1;
+	int			low = 0,
+				high = store->nblocks - 1;
+
+	if (store->nblocks == 0 ||
+		blkno < store->blocks[0].blkno ||
+		blkno > store->blocks[high].blkno)
+		return false;
+
+	while (low <= high)
+	{
+		int			mid = low + (high - low) / 2;
+		BlockNumber midblk = store->blocks[mid].blkno;
+
+		if (midblk < blkno)
+			low = mid + 1;
+		else if (midblk > blkno)
+			high = mid - 1;
+		else
+		{
+			if (bit < 0 ||
+				bit / BITS_PER_BYTE >= (int) BlockBitmapBytes(store, mid))
+				return false;
+			return (BlockBitmap(store, mid)[bit / BITS_PER_BYTE] &
+					(1 << (bit % BITS_PER_BYTE))) != 0;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * TidStoreNumTids - number of TIDs in the store
+ */
+int64
+TidStoreNumTids(TidStore *store)
+{
+	return store->ntids;
+}
+
+/*
+ * TidStoreNumBlocks - number of blocks the TIDs in the store are on
+ */
+int
+TidStoreNumBlocks(TidStore *store)
+{
+	return store->nblocks;
+}
+
+/*
+ * TidStoreGetBlock - get the TIDs of the blockno'th block in the store
+ *
+ * The blocks are numbered from 0 up to TidStoreNumBlocks() - 1, in order of
+ * block number.  The offsets are returned in ascending order, in *offsets,
+ * which must have room for MaxOffsetNumber of them, and their count in
+ * *noffsets.  The block number is the result.
+ */
+BlockNumber
+TidStoreGetBlock(TidStore *store, int blockno,
+				 OffsetNumber *offsets, int *noffsets)
+{
+	uint8	   *bitmap;
+	int			nbytes;
+	int			n = 0;
+	int			i;
+
+	Assert(blockno >= 0 && blockno < store->nblocks);
+
+	bitmap = BlockBitmap(store, blockno);
+	nbytes = BlockBitmapBytes(store, blockno);
+
+	for (i = 0; i < nbytes; i++)
+	{
+		uint8		byte = bitmap[i];
+		int			bit;
+
+		for (bit = 0; byte != 0; bit++, byte >>= 1)
+		{
+			if (byte & 1)
+				offsets[n++] = (OffsetNumber) (i * BITS_PER_BYTE + bit + 1);
+		}
+	}
+
+	*noffsets = n;
+	return store->blocks[blockno].blkno;
+}
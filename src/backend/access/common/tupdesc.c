@@ -20,6 +20,7 @@
 #include "postgres.h"
 
 #include "access/htup_details.h"
+#include "access/tuptoaster.h"
 #include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "parser/parse_type.h"
@@ -92,6 +93,7 @@ CreateTemplateTupleDesc(int natts, bool hasoid)
 	desc->tdtypmod = -1;
 	desc->tdhasoid = hasoid;
 	desc->tdrefcount = -1;		/* assume not reference-counted */
+	desc->tdfixedprefix = -1;
 
 	return desc;
 }
@@ -125,6 +127,7 @@ CreateTupleDesc(int natts, bool hasoid, Form_pg_attribute *attrs)
 	desc->tdtypmod = -1;
 	desc->tdhasoid = hasoid;
 	desc->tdrefcount = -1;		/* assume not reference-counted */
+	desc->tdfixedprefix = -1;
 
 	return desc;
 }
@@ -252,6 +255,7 @@ TupleDescCopyEntry(TupleDesc dst, AttrNumber dstAttno,
 	 */
 	dst->attrs[dstAttno - 1]->attnum = dstAttno;
 	dst->attrs[dstAttno - 1]->attcacheoff = -1;
+	dst->tdfixedprefix = -1;
 
 	/* since we're not copying constraints or defaults, clear these */
 	dst->attrs[dstAttno - 1]->attnotnull = false;
@@ -408,6 +412,8 @@ equalTupleDescs(TupleDesc tupdesc1, TupleDesc tupdesc2)
 			return false;
 		if (attr1->attcollation != attr2->attcollation)
 			return false;
+		if (attr1->attcompression != attr2->attcompression)
+			return false;
 		/* attacl, attoptions and attfdwoptions are not even present... */
 	}
 
@@ -527,6 +533,7 @@ TupleDescInitEntry(TupleDesc desc,
 	att->attstattarget = -1;
 	att->attcacheoff = -1;
 	att->atttypmod = typmod;
+	desc->tdfixedprefix = -1;
 
 	att->attnum = attributeNumber;
 	att->attndims = attdim;
@@ -549,6 +556,7 @@ TupleDescInitEntry(TupleDesc desc,
 	att->attalign = typeForm->typalign;
 	att->attstorage = typeForm->typstorage;
 	att->attcollation = typeForm->typcollation;
+	att->attcompression = InvalidCompressionMethod;
 
 	ReleaseSysCache(tuple);
 }
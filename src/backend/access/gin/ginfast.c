@@ -3,9 +3,10 @@
  * ginfast.c
  *	  Fast insert routines for the Postgres inverted index access method.
  *	  Pending entries are stored in linear list of pages.  Later on
- *	  (typically during VACUUM), ginInsertCleanup() will be invoked to
- *	  transfer pending entries into the regular index structure.  This
- *	  wins because bulk insertion is much more efficient than retail.
+ *	  (typically during VACUUM, or by autovacuum at the request of the
+ *	  backend that made the list too long), ginInsertCleanup() will be
+ *	  invoked to transfer pending entries into the regular index structure.
+ *	  This wins because bulk insertion is much more efficient than retail.
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -19,9 +20,15 @@
 #include "postgres.h"
 
 #include "access/gin_private.h"
+#include "access/xlog.h"
 #include "access/xloginsert.h"
+#include "catalog/pg_am.h"
 #include "commands/vacuum.h"
 #include "miscadmin.h"
+#include "postmaster/autovacuum.h"
+#include "storage/lmgr.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 
@@ -31,6 +38,13 @@ int			gin_pending_list_limit = 0;
 #define GIN_PAGE_FREESIZE \
 	( BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXALIGN(sizeof(GinPageOpaqueData)) )
 
+/*
+ * Once the pending list is longer than the cleanup size, autovacuum is asked
+ * to clean it up.  Only when it gets this many times longer does the
+ * inserting backend do the cleanup itself.
+ */
+#define GIN_PENDING_LIST_HARD_LIMIT_FACTOR	4
+
 typedef struct KeyArray
 {
 	Datum	   *keys;			/* expansible array */
@@ -222,6 +236,7 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	ginxlogUpdateMeta data;
 	bool		separateList = false;
 	bool		needCleanup = false;
+	bool		needForegroundCleanup = false;
 	int			cleanupSize;
 	bool		needWal;
 
@@ -415,24 +430,42 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 		UnlockReleaseBuffer(buffer);
 
 	/*
-	 * Force pending list cleanup when it becomes too long. And,
-	 * ginInsertCleanup could take significant amount of time, so we prefer to
-	 * call it when it can do all the work in a single collection cycle. In
-	 * non-vacuum mode, it shouldn't require maintenance_work_mem, so fire it
-	 * while pending list is still small enough to fit into
-	 * gin_pending_list_limit.
+	 * Ask for pending list cleanup when it becomes too long.
+	 * ginInsertCleanup could take significant amount of time, so we'd rather
+	 * have autovacuum do it than stall this insertion; we only ask when we
+	 * added pages to the list, which is often enough to make up for requests
+	 * that autovacuum could not take.  If autovacuum doesn't keep up, and the
+	 * list grows much longer, clean it up here after all, lest searches get
+	 * too slow.  In that case we only need work_mem, since we clean up no
+	 * more than the list as it is now, and that shouldn't be very much longer
+	 * than gin_pending_list_limit.
 	 *
 	 * ginInsertCleanup() should not be called inside our CRIT_SECTION.
 	 */
 	cleanupSize = GinGetPendingListCleanupSize(index);
 	if (metadata->nPendingPages * GIN_PAGE_FREESIZE > cleanupSize * 1024L)
 		needCleanup = true;
+	if (metadata->nPendingPages * GIN_PAGE_FREESIZE >
+		cleanupSize * 1024L * GIN_PENDING_LIST_HARD_LIMIT_FACTOR)
+		needForegroundCleanup = true;
 
 	UnlockReleaseBuffer(metabuffer);
 
 	END_CRIT_SECTION();
 
-	if (needCleanup)
+	if (needCleanup && !needForegroundCleanup)
+	{
+		/* autovacuum can't read the local buffers of a temporary index */
+		if (!AutoVacuumingActive() || RelationUsesLocalBuffers(index))
+			needForegroundCleanup = true;
+		else if (separateList &&
+				 !AutoVacuumRequestWork(AVW_GINCleanPendingList,
+										RelationGetRelid(index),
+										InvalidBlockNumber))
+			needForegroundCleanup = true;
+	}
+
+	if (needForegroundCleanup)
 		ginInsertCleanup(ginstate, false, NULL);
 }
 
@@ -725,13 +758,23 @@ processPendingPage(BuildAccumulator *accum, KeyArray *ka,
  * action of removing a page from the pending list really needs exclusive
  * lock.
  *
- * vac_delay indicates that ginInsertCleanup is called from vacuum process,
- * so call vacuum_delay_point() periodically.
+ * Only one process cleans up the pending list of an index at a time; the
+ * others would only find the pages already gone.  This is enforced with a
+ * heavyweight lock on the metapage, which doesn't block insertions into the
+ * list.
+ *
+ * full_clean indicates that ginInsertCleanup is called from vacuum or
+ * autovacuum: we then wait for a concurrent cleanup to finish, process the
+ * whole list, and size the accumulator by maintenance_work_mem (or
+ * autovacuum_work_mem).  Otherwise we are a regular backend helping out:
+ * we give up if someone else is cleaning up already, stop at what was the
+ * tail of the list when we started, so that we don't go on forever while
+ * other backends keep inserting, and stay within work_mem.
  * If stats isn't null, we count deleted pending pages into the counts.
  */
 void
 ginInsertCleanup(GinState *ginstate,
-				 bool vac_delay, IndexBulkDeleteResult *stats)
+				 bool full_clean, IndexBulkDeleteResult *stats)
 {
 	Relation	index = ginstate->index;
 	Buffer		metabuffer,
@@ -743,7 +786,24 @@ ginInsertCleanup(GinState *ginstate,
 				oldCtx;
 	BuildAccumulator accum;
 	KeyArray	datums;
-	BlockNumber blkno;
+	BlockNumber blkno,
+				blknoFinish;
+	bool		cleanupFinish = false;
+	long		workMemory;
+
+	if (full_clean)
+	{
+		LockPage(index, GIN_METAPAGE_BLKNO, ExclusiveLock);
+		workMemory = (IsAutoVacuumWorkerProcess() &&
+					  autovacuum_work_mem != -1) ?
+			autovacuum_work_mem : maintenance_work_mem;
+	}
+	else
+	{
+		if (!ConditionalLockPage(index, GIN_METAPAGE_BLKNO, ExclusiveLock))
+			return;
+		workMemory = work_mem;
+	}
 
 	metabuffer = ReadBuffer(index, GIN_METAPAGE_BLKNO);
 	LockBuffer(metabuffer, GIN_SHARE);
@@ -754,9 +814,15 @@ ginInsertCleanup(GinState *ginstate,
 	{
 		/* Nothing to do */
 		UnlockReleaseBuffer(metabuffer);
+		UnlockPage(index, GIN_METAPAGE_BLKNO, ExclusiveLock);
 		return;
 	}
 
+	/*
+	 * Remember the tail page, to stop there in a partial cleanup
+	 */
+	blknoFinish = metadata->tail;
+
 	/*
 	 * Read and lock head of pending list
 	 */
@@ -803,17 +869,25 @@ ginInsertCleanup(GinState *ginstate,
 
 		vacuum_delay_point();
 
+		/*
+		 * Is this the last page we are to process?  The tail page always has
+		 * a full row, so we can stop there.
+		 */
+		if (!full_clean && blkno == blknoFinish)
+			cleanupFinish = true;
+
 		/*
 		 * Is it time to flush memory to disk?	Flush if we are at the end of
-		 * the pending list, or if we have a full row and memory is getting
-		 * full.
+		 * the pending list or of the part we are to process, or if we have a
+		 * full row and memory is getting full.
 		 *
 		 * XXX using up maintenance_work_mem here is probably unreasonably
 		 * much, since vacuum might already be using that much.
 		 */
 		if (GinPageGetOpaque(page)->rightlink == InvalidBlockNumber ||
+			cleanupFinish ||
 			(GinPageHasFullRow(page) &&
-			 (accum.allocatedMemory >= maintenance_work_mem * 1024L)))
+			 (accum.allocatedMemory >= workMemory * 1024L)))
 		{
 			ItemPointerData *list;
 			uint32		nlist;
@@ -900,9 +974,10 @@ ginInsertCleanup(GinState *ginstate,
 			LockBuffer(metabuffer, GIN_UNLOCK);
 
 			/*
-			 * if we removed the whole pending list just exit
+			 * if we removed the whole pending list, or the part of it we
+			 * were to process, just exit
 			 */
-			if (blkno == InvalidBlockNumber)
+			if (blkno == InvalidBlockNumber || cleanupFinish)
 				break;
 
 			/*
@@ -927,9 +1002,59 @@ ginInsertCleanup(GinState *ginstate,
 		page = BufferGetPage(buffer);
 	}
 
+	UnlockPage(index, GIN_METAPAGE_BLKNO, ExclusiveLock);
 	ReleaseBuffer(metabuffer);
 
 	/* Clean up temporary space */
 	MemoryContextSwitchTo(oldCtx);
 	MemoryContextDelete(opCtx);
 }
+
+/*
+ * SQL-callable function to clean the insert pending list
+ */
+Datum
+gin_clean_pending_list(PG_FUNCTION_ARGS)
+{
+	Oid			indexoid = PG_GETARG_OID(0);
+	Relation	indexRel = index_open(indexoid, AccessShareLock);
+	IndexBulkDeleteResult stats;
+	GinState	ginstate;
+
+	if (RecoveryInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("recovery is in progress"),
+		 errhint("GIN pending list cannot be cleaned up during recovery.")));
+
+	/* Must be a GIN index */
+	if (indexRel->rd_rel->relkind != RELKIND_INDEX ||
+		indexRel->rd_rel->relam != GIN_AM_OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a GIN index",
+						RelationGetRelationName(indexRel))));
+
+	/*
+	 * Reject attempts to read non-local temporary relations; we would be
+	 * likely to get wrong data since we have no visibility into the owning
+	 * session's local buffers.
+	 */
+	if (RELATION_IS_OTHER_TEMP(indexRel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			   errmsg("cannot access temporary indexes of other sessions")));
+
+	/* User must own the index (comparable to privileges needed for VACUUM) */
+	if (!pg_class_ownercheck(indexoid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, ACL_KIND_CLASS,
+					   RelationGetRelationName(indexRel));
+
+	memset(&stats, 0, sizeof(stats));
+	initGinState(&ginstate, indexRel);
+	ginInsertCleanup(&ginstate, true, &stats);
+
+	index_close(indexRel, AccessShareLock);
+
+	PG_RETURN_INT64((int64) stats.pages_deleted);
+}
@@ -3,6 +3,14 @@
  * gininsert.c
  *	  insert routines for the postgres inverted index access method.
  *
+ * On a large table, ginbuild lets parallel workers help with the heap scan
+ * (see ginParallelBuild).  Each participant collects entries for its share of
+ * the heap in its own BuildAccumulator as usual, but rather than inserting
+ * them into the index whenever that fills up, it sorts them as entry tuples
+ * holding compressed posting lists.  The leader merges all the sorted runs,
+ * combines the TIDs each key got from the different participants, and
+ * inserts each key into the index with all its TIDs at once.
+ *
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -15,15 +23,50 @@
 #include "postgres.h"
 
 #include "access/gin_private.h"
+#include "access/nbtree.h"
+#include "access/parallel.h"
+#include "access/relscan.h"
+#include "access/xact.h"
 #include "access/xloginsert.h"
 #include "catalog/index.h"
 #include "miscadmin.h"
 #include "storage/bufmgr.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
 #include "storage/smgr.h"
 #include "storage/indexfsm.h"
+#include "storage/spin.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/tqual.h"
+#include "utils/tuplesort.h"
+
+
+/* Magic numbers for parallel build state sharing */
+#define PARALLEL_KEY_GIN_SHARED		UINT64CONST(0xD000000000000001)
+#define PARALLEL_KEY_GIN_SCAN		UINT64CONST(0xD000000000000002)
+#define PARALLEL_KEY_GIN_QUEUES		UINT64CONST(0xD000000000000003)
+
+/* Size of the queue each worker streams its sorted entries through */
+#define PARALLEL_GIN_QUEUE_SIZE		65536
+
+/*
+ * Status record shared by the leader and the workers of a parallel build.
+ * The counters are summed up by the workers as they finish their scans.
+ */
+typedef struct GinShared
+{
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;	/* scanning with an MVCC snapshot? */
+	int			sortmem;		/* kB of memory for each participant */
 
+	slock_t		mutex;			/* protects the following */
+	double		reltuples;		/* # of heap tuples scanned by workers */
+	double		indtuples;		/* # of entries extracted by workers */
+	bool		brokenhotchain; /* did any worker see a broken HOT chain? */
+} GinShared;
 
 typedef struct
 {
@@ -33,8 +76,15 @@ typedef struct
 	MemoryContext tmpCtx;
 	MemoryContext funcCtx;
 	BuildAccumulator accum;
+	long		accumMem;		/* bytes accum may use before it's dumped */
+	Tuplesortstate *sortstate;	/* where to dump it in a parallel build, or
+								 * NULL to insert into the index directly */
 } GinBuildState;
 
+static void ginDumpBuildState(GinBuildState *buildstate);
+static double ginParallelBuild(GinBuildState *buildstate, Relation heap,
+				 Relation index, IndexInfo *indexInfo, int nworkers);
+
 
 /*
  * Adds array of item pointers to tuple's posting list, or
@@ -280,25 +330,10 @@ ginBuildCallback(Relation index, HeapTuple htup, Datum *values,
 							   values[i], isnull[i],
 							   &htup->t_self);
 
-	/* If we've maxed out our available memory, dump everything to the index */
-	if (buildstate->accum.allocatedMemory >= maintenance_work_mem * 1024L)
+	/* If we've maxed out our available memory, dump everything */
+	if (buildstate->accum.allocatedMemory >= buildstate->accumMem)
 	{
-		ItemPointerData *list;
-		Datum		key;
-		GinNullCategory category;
-		uint32		nlist;
-		OffsetNumber attnum;
-
-		ginBeginBAScan(&buildstate->accum);
-		while ((list = ginGetBAEntry(&buildstate->accum,
-								  &attnum, &key, &category, &nlist)) != NULL)
-		{
-			/* there could be many entries, so be willing to abort here */
-			CHECK_FOR_INTERRUPTS();
-			ginEntryInsert(&buildstate->ginstate, attnum, key, category,
-						   list, nlist, &buildstate->buildStats);
-		}
-
+		ginDumpBuildState(buildstate);
 		MemoryContextReset(buildstate->tmpCtx);
 		ginInitBA(&buildstate->accum);
 	}
@@ -306,6 +341,84 @@ ginBuildCallback(Relation index, HeapTuple htup, Datum *values,
 	MemoryContextSwitchTo(oldCtx);
 }
 
+/*
+ * Add the given TIDs of one key to the sort of a parallel build.
+ *
+ * The TIDs are stored as compressed posting lists, in as many entry tuples
+ * as it takes.  The tuples only live in the sort, so they need not fit on an
+ * index page, just within the size an index tuple can have.
+ */
+static void
+ginSpoolEntry(GinBuildState *buildstate, OffsetNumber attnum, Datum key,
+			  GinNullCategory category, ItemPointerData *items, uint32 nitem)
+{
+	IndexTuple	keytup;
+	Size		offset;
+
+	keytup = GinFormTuple(&buildstate->ginstate, attnum, key, category,
+						  NULL, 0, 0, true);
+	offset = GinGetPostingOffset(keytup);
+
+	while (nitem > 0)
+	{
+		GinPostingList *segment;
+		int			nwritten;
+		Size		segsize;
+		Size		newsize;
+		IndexTuple	itup;
+
+		segment = ginCompressPostingList(items, nitem,
+										 MAXALIGN_DOWN(INDEX_SIZE_MASK) - offset,
+										 &nwritten);
+		segsize = SizeOfGinPostingList(segment);
+		newsize = MAXALIGN(offset + segsize);
+
+		itup = (IndexTuple) palloc0(newsize);
+		memcpy(itup, keytup, offset);
+		itup->t_info &= ~INDEX_SIZE_MASK;
+		itup->t_info |= newsize;
+		memcpy(GinGetPosting(itup), segment, segsize);
+		GinSetNPosting(itup, nwritten);
+
+		tuplesort_putindextuple(buildstate->sortstate, itup);
+
+		pfree(itup);
+		pfree(segment);
+		items += nwritten;
+		nitem -= nwritten;
+	}
+
+	pfree(keytup);
+}
+
+/*
+ * Dump everything in the BuildAccumulator into the index, or into the sort
+ * in a parallel build.  Caller is responsible for resetting the accumulator
+ * afterwards.
+ */
+static void
+ginDumpBuildState(GinBuildState *buildstate)
+{
+	ItemPointerData *list;
+	Datum		key;
+	GinNullCategory category;
+	uint32		nlist;
+	OffsetNumber attnum;
+
+	ginBeginBAScan(&buildstate->accum);
+	while ((list = ginGetBAEntry(&buildstate->accum,
+								 &attnum, &key, &category, &nlist)) != NULL)
+	{
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+		if (buildstate->sortstate)
+			ginSpoolEntry(buildstate, attnum, key, category, list, nlist);
+		else
+			ginEntryInsert(&buildstate->ginstate, attnum, key, category,
+						   list, nlist, &buildstate->buildStats);
+	}
+}
+
 Datum
 ginbuild(PG_FUNCTION_ARGS)
 {
@@ -317,12 +430,8 @@ ginbuild(PG_FUNCTION_ARGS)
 	GinBuildState buildstate;
 	Buffer		RootBuffer,
 				MetaBuffer;
-	ItemPointerData *list;
-	Datum		key;
-	GinNullCategory category;
-	uint32		nlist;
 	MemoryContext oldCtx;
-	OffsetNumber attnum;
+	int			nworkers;
 
 	if (RelationGetNumberOfBlocks(index) != 0)
 		elog(ERROR, "index \"%s\" already contains data",
@@ -391,26 +500,28 @@ ginbuild(PG_FUNCTION_ARGS)
 
 	buildstate.accum.ginstate = &buildstate.ginstate;
 	ginInitBA(&buildstate.accum);
-
-	/*
-	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
-	 * prefers to receive tuples in TID order.
-	 */
-	reltuples = IndexBuildHeapScan(heap, index, indexInfo, false,
-								   ginBuildCallback, (void *) &buildstate);
-
-	/* dump remaining entries to the index */
-	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
-	ginBeginBAScan(&buildstate.accum);
-	while ((list = ginGetBAEntry(&buildstate.accum,
-								 &attnum, &key, &category, &nlist)) != NULL)
+	buildstate.accumMem = maintenance_work_mem * 1024L;
+	buildstate.sortstate = NULL;
+
+	/* We use the same rules as btree for deciding on parallelism */
+	nworkers = _bt_parallel_workers(heap, indexInfo);
+	if (nworkers > 0)
+		reltuples = ginParallelBuild(&buildstate, heap, index, indexInfo,
+									 nworkers);
+	else
 	{
-		/* there could be many entries, so be willing to abort here */
-		CHECK_FOR_INTERRUPTS();
-		ginEntryInsert(&buildstate.ginstate, attnum, key, category,
-					   list, nlist, &buildstate.buildStats);
+		/*
+		 * Do the heap scan.  We disallow sync scan here because
+		 * dataPlaceToPage prefers to receive tuples in TID order.
+		 */
+		reltuples = IndexBuildHeapScan(heap, index, indexInfo, false,
+									   ginBuildCallback, (void *) &buildstate);
+
+		/* dump remaining entries to the index */
+		oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+		ginDumpBuildState(&buildstate);
+		MemoryContextSwitchTo(oldCtx);
 	}
-	MemoryContextSwitchTo(oldCtx);
 
 	MemoryContextDelete(buildstate.funcCtx);
 	MemoryContextDelete(buildstate.tmpCtx);
@@ -543,3 +654,340 @@ gininsert(PG_FUNCTION_ARGS)
 
 	PG_RETURN_BOOL(false);
 }
+
+
+/*
+ * Parallel build
+ */
+
+static int
+qsortCompareItemPointers(const void *a, const void *b)
+{
+	return ginCompareItemPointers((ItemPointer) a, (ItemPointer) b);
+}
+
+/*
+ * Insert TIDs collected for one key in a parallel build into the index,
+ * sorting them first if they were not collected in order.
+ */
+static void
+ginInsertMergedEntry(GinBuildState *buildstate, OffsetNumber attnum,
+					 Datum key, GinNullCategory category,
+					 ItemPointerData *items, uint32 nitem, bool sorted)
+{
+	MemoryContext oldCtx;
+
+	if (!sorted)
+		qsort(items, nitem, sizeof(ItemPointerData), qsortCompareItemPointers);
+
+	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+	ginEntryInsert(&buildstate->ginstate, attnum, key, category,
+				   items, nitem, &buildstate->buildStats);
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->tmpCtx);
+}
+
+/*
+ * Read the merged entry tuples of a parallel build, and insert each key into
+ * the index with the TIDs of all its tuples.
+ *
+ * A key's tuples come ordered by their first TID, but the participants
+ * scanned interleaved ranges of blocks, so their lists can overlap; we sort
+ * the collected TIDs if they do.  A key with more TIDs than fit in our share
+ * of memory is inserted in several batches, which ginEntryInsert merges.
+ */
+static void
+ginInsertSortedEntries(GinBuildState *buildstate, Tuplesortstate *sortstate)
+{
+	GinState   *ginstate = &buildstate->ginstate;
+	IndexTuple	curtup = NULL;
+	OffsetNumber curattnum = InvalidOffsetNumber;
+	Datum		curkey = (Datum) 0;
+	GinNullCategory curcategory = GIN_CAT_NORM_KEY;
+	ItemPointerData *items;
+	uint32		maxitems;
+	uint32		nitems = 0;
+	bool		sorted = true;
+	IndexTuple	itup;
+	bool		should_free;
+
+	/* we need room for at least any one tuple's posting list */
+	maxitems = Min((Size) buildstate->accumMem, MaxAllocSize) /
+		sizeof(ItemPointerData);
+	maxitems = Max(maxitems, GIN_TREE_POSTING);
+	items = (ItemPointerData *) palloc(maxitems * sizeof(ItemPointerData));
+
+	while ((itup = tuplesort_getindextuple(sortstate, true,
+										   &should_free)) != NULL)
+	{
+		OffsetNumber attnum;
+		Datum		key;
+		GinNullCategory category;
+		ItemPointer list;
+		int			nlist;
+
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		attnum = gintuple_get_attrnum(ginstate, itup);
+		key = gintuple_get_key(ginstate, itup, &category);
+
+		if (curtup != NULL &&
+			ginCompareAttEntries(ginstate, attnum, key, category,
+								 curattnum, curkey, curcategory) != 0)
+		{
+			ginInsertMergedEntry(buildstate, curattnum, curkey, curcategory,
+								 items, nitems, sorted);
+			nitems = 0;
+			sorted = true;
+			pfree(curtup);
+			curtup = NULL;
+		}
+
+		if (curtup == NULL)
+		{
+			curtup = CopyIndexTuple(itup);
+			curattnum = attnum;
+			curkey = gintuple_get_key(ginstate, curtup, &curcategory);
+		}
+
+		list = ginReadTuple(ginstate, attnum, itup, &nlist);
+
+		if (nitems + nlist > maxitems)
+		{
+			ginInsertMergedEntry(buildstate, curattnum, curkey, curcategory,
+								 items, nitems, sorted);
+			nitems = 0;
+			sorted = true;
+		}
+
+		if (nitems > 0 && ginCompareItemPointers(&items[nitems - 1], list) > 0)
+			sorted = false;
+		memcpy(&items[nitems], list, nlist * sizeof(ItemPointerData));
+		nitems += nlist;
+
+		pfree(list);
+		if (should_free)
+			pfree(itup);
+	}
+
+	if (curtup != NULL)
+	{
+		ginInsertMergedEntry(buildstate, curattnum, curkey, curcategory,
+							 items, nitems, sorted);
+		pfree(curtup);
+	}
+
+	pfree(items);
+}
+
+/*
+ * ginParallelBuild
+ *
+ * Build a GIN index with the help of nworkers parallel workers, filling in
+ * buildstate as ginbuild's serial scan would.  Returns the number of heap
+ * tuples scanned.
+ *
+ * The leader scans part of the heap itself while the workers do the rest.
+ * Every participant splits its share of maintenance_work_mem between its
+ * accumulator and the sort of the entries it dumps.  The leader then merges
+ * the workers' sorted runs with its own and inserts the result.  We must
+ * keep reading from every queue until it is exhausted, or the worker would
+ * never finish; and we must wait for the workers before relying on any
+ * result, as a worker that fails just stops sending.
+ */
+static double
+ginParallelBuild(GinBuildState *buildstate, Relation heap, Relation index,
+				 IndexInfo *indexInfo, int nworkers)
+{
+	ParallelContext *pcxt;
+	GinShared  *ginshared;
+	ParallelHeapScanDesc pscan;
+	Snapshot	snapshot;
+	char	   *queuespace;
+	shm_mq_handle **queues;
+	int			nqueues;
+	int			sortmem;
+	HeapScanDesc scan;
+	Tuplesortstate *localsort;
+	MemoryContext oldCtx;
+	double		reltuples;
+
+	Assert(nworkers > 0);
+
+	/* The memory is split evenly among the workers and us */
+	sortmem = Max(maintenance_work_mem / (nworkers + 1), 128);
+
+	/* See _bt_parallel_build about the choice of snapshot */
+	if (indexInfo->ii_Concurrent)
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+	else
+		snapshot = SnapshotAny;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(ginParallelBuildMain, nworkers);
+
+	/* Estimate and allocate the shared state */
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(GinShared));
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   heap_parallelscan_estimate(snapshot));
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+	EstimateParallelQueues(pcxt, PARALLEL_GIN_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	ginshared = (GinShared *) shm_toc_allocate(pcxt->toc, sizeof(GinShared));
+	ginshared->heaprelid = RelationGetRelid(heap);
+	ginshared->indexrelid = RelationGetRelid(index);
+	ginshared->isconcurrent = indexInfo->ii_Concurrent;
+	ginshared->sortmem = sortmem;
+	SpinLockInit(&ginshared->mutex);
+	ginshared->reltuples = 0;
+	ginshared->indtuples = 0;
+	ginshared->brokenhotchain = false;
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_GIN_SHARED, ginshared);
+
+	pscan = (ParallelHeapScanDesc)
+		shm_toc_allocate(pcxt->toc, heap_parallelscan_estimate(snapshot));
+	heap_parallelscan_initialize(pscan, heap, snapshot);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_GIN_SCAN, pscan);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_GIN_QUEUES,
+										  PARALLEL_GIN_QUEUE_SIZE, false);
+
+	LaunchParallelWorkers(pcxt);
+
+	queues = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	nqueues = AttachParallelQueues(pcxt, queuespace, PARALLEL_GIN_QUEUE_SIZE,
+								   queues, NULL);
+
+	/* Do our share of the scan, just like a worker */
+	buildstate->accumMem = sortmem * 1024L / 2;
+	localsort = tuplesort_begin_index_gin(heap, index, sortmem / 2, false);
+	buildstate->sortstate = localsort;
+
+	scan = heap_beginscan_parallel(heap, pscan);
+	reltuples = IndexBuildHeapRangeScan(heap, index, indexInfo, true, false,
+										0, InvalidBlockNumber,
+										ginBuildCallback, (void *) buildstate,
+										scan);
+
+	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+	ginDumpBuildState(buildstate);
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->tmpCtx);
+
+	/*
+	 * Merge our run with the workers' runs.  The merge takes ownership of
+	 * our run, and ends it when it is done.
+	 */
+	tuplesort_performsort(localsort);
+	buildstate->sortstate = tuplesort_begin_index_gin(heap, index, sortmem,
+													  false);
+	tuplesort_merge_sorted(buildstate->sortstate, queues, nqueues, localsort);
+
+	ginInsertSortedEntries(buildstate, buildstate->sortstate);
+	tuplesort_end(buildstate->sortstate);
+	buildstate->sortstate = NULL;
+
+	/* This rethrows any error a worker ran into */
+	WaitForParallelWorkersToFinish(pcxt);
+
+	reltuples += ginshared->reltuples;
+	buildstate->indtuples += ginshared->indtuples;
+	if (ginshared->brokenhotchain)
+		indexInfo->ii_BrokenHotChain = true;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	if (snapshot != SnapshotAny)
+		UnregisterSnapshot(snapshot);
+
+	return reltuples;
+}
+
+/*
+ * ginParallelBuildMain
+ *
+ * Entry point of a parallel GIN build worker: collect the entries of our
+ * share of the heap, sort them, and send the result to the leader.
+ */
+void
+ginParallelBuildMain(dsm_segment *seg, shm_toc *toc)
+{
+	GinShared  *ginshared;
+	ParallelHeapScanDesc pscan;
+	char	   *queuespace;
+	shm_mq_handle *mqh;
+	Relation	heap;
+	Relation	index;
+	IndexInfo  *indexInfo;
+	GinBuildState buildstate;
+	HeapScanDesc scan;
+	MemoryContext oldCtx;
+	double		reltuples;
+
+	ginshared = (GinShared *) shm_toc_lookup(toc, PARALLEL_KEY_GIN_SHARED);
+	pscan = (ParallelHeapScanDesc) shm_toc_lookup(toc, PARALLEL_KEY_GIN_SCAN);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_GIN_QUEUES);
+	if (ginshared == NULL || pscan == NULL || queuespace == NULL)
+		elog(ERROR, "invalid parallel GIN build state");
+
+	mqh = AttachParallelLeaderQueue(seg, queuespace, PARALLEL_GIN_QUEUE_SIZE,
+									false);
+
+	/* The leader holds the locks for us, see _bt_parallel_build_main */
+	heap = heap_open(ginshared->heaprelid, NoLock);
+	index = index_open(ginshared->indexrelid, NoLock);
+
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = ginshared->isconcurrent;
+
+	initGinState(&buildstate.ginstate, index);
+	buildstate.indtuples = 0;
+	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+											  "Gin build temporary context",
+											  ALLOCSET_DEFAULT_MINSIZE,
+											  ALLOCSET_DEFAULT_INITSIZE,
+											  ALLOCSET_DEFAULT_MAXSIZE);
+	buildstate.funcCtx = AllocSetContextCreate(CurrentMemoryContext,
+					 "Gin build temporary context for user-defined function",
+											   ALLOCSET_DEFAULT_MINSIZE,
+											   ALLOCSET_DEFAULT_INITSIZE,
+											   ALLOCSET_DEFAULT_MAXSIZE);
+	buildstate.accum.ginstate = &buildstate.ginstate;
+	ginInitBA(&buildstate.accum);
+	buildstate.accumMem = ginshared->sortmem * 1024L / 2;
+	buildstate.sortstate = tuplesort_begin_index_gin(heap, index,
+													 ginshared->sortmem / 2,
+													 false);
+
+	scan = heap_beginscan_parallel(heap, pscan);
+	reltuples = IndexBuildHeapRangeScan(heap, index, indexInfo, true, false,
+										0, InvalidBlockNumber,
+										ginBuildCallback, (void *) &buildstate,
+										scan);
+
+	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+	ginDumpBuildState(&buildstate);
+	MemoryContextSwitchTo(oldCtx);
+
+	SpinLockAcquire(&ginshared->mutex);
+	ginshared->reltuples += reltuples;
+	ginshared->indtuples += buildstate.indtuples;
+	if (indexInfo->ii_BrokenHotChain)
+		ginshared->brokenhotchain = true;
+	SpinLockRelease(&ginshared->mutex);
+
+	tuplesort_performsort(buildstate.sortstate);
+	tuplesort_send_sorted(buildstate.sortstate, mqh);
+	tuplesort_end(buildstate.sortstate);
+
+	MemoryContextDelete(buildstate.funcCtx);
+	MemoryContextDelete(buildstate.tmpCtx);
+
+	index_close(index, NoLock);
+	heap_close(heap, NoLock);
+}
@@ -3,6 +3,24 @@
  * gistbuild.c
  *	  build algorithm for GiST indexes implementation.
  *
+ * There are two different strategies:
+ *
+ * 1. Sort all input tuples, pack them into GiST leaf pages in the sorted
+ *	  order, and create downlinks and internal pages as we go.  This builds
+ *	  the index from the bottom up, similar to how B-tree index build
+ *	  works.
+ *
+ * 2. Start with an empty index, and insert all tuples one by one.
+ *
+ * The sorted method is used if the operator classes for all columns have
+ * a 'sortsupport' defined.  Otherwise, we resort to the second strategy.
+ *
+ * The second strategy can optionally use buffers at different levels of
+ * the tree to reduce I/O, see "Buffering build algorithm" in the README
+ * for a more detailed explanation.  It initially calls insert over and
+ * over, but switches to the buffered algorithm after a certain number of
+ * tuples (unless buffering mode is disabled).
+ *
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -18,6 +36,7 @@
 
 #include "access/genam.h"
 #include "access/gist_private.h"
+#include "access/xlog.h"
 #include "access/xloginsert.h"
 #include "catalog/index.h"
 #include "miscadmin.h"
@@ -26,6 +45,7 @@
 #include "storage/smgr.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/tuplesort.h"
 
 /* Step of index tuples for check whether to switch to buffering build mode */
 #define BUFFERING_MODE_SWITCH_CHECK_STEP 256
@@ -40,6 +60,7 @@
 
 typedef enum
 {
+	GIST_SORTED_BUILD,			/* bottom-up build by sorting */
 	GIST_BUFFERING_DISABLED,	/* in regular build mode and aren't going to
 								 * switch */
 	GIST_BUFFERING_AUTO,		/* in regular build mode, but will switch to
@@ -49,7 +70,7 @@ typedef enum
 								 * before switching to the buffering build
 								 * mode */
 	GIST_BUFFERING_ACTIVE		/* in buffering build mode */
-} GistBufferingMode;
+} GistBuildMode;
 
 /* Working state for gistbuild and its callback */
 typedef struct
@@ -70,10 +91,47 @@ typedef struct
 	GISTBuildBuffers *gfbb;
 	HTAB	   *parentMap;
 
-	GistBufferingMode bufferingMode;
+	/*
+	 * Extra data structures used during a sorting build.  The pages are
+	 * written directly rather than through the buffer manager, as in a btree
+	 * build.
+	 */
+	Tuplesortstate *sortstate;	/* state data for tuplesort.c */
+	bool		use_wal;		/* dump pages to WAL? */
+	BlockNumber pages_allocated;	/* # of pages allocated */
+	BlockNumber pages_written;	/* # of pages written out */
+
+	GistBuildMode buildMode;
 } GISTBuildState;
 
+/*
+ * In sorted build, we use a stack of these structs, one for each level,
+ * to hold an in-memory buffer of the rightmost page at the level.  When the
+ * page fills up, it is written out and a new page is allocated.
+ */
+typedef struct GistSortedBuildPageState
+{
+	Page		page;
+	struct GistSortedBuildPageState *parent;	/* Upper level, if any */
+} GistSortedBuildPageState;
+
 /* prototypes for private functions */
+
+static void gistSortedBuildCallback(Relation index,
+						HeapTuple htup,
+						Datum *values,
+						bool *isnull,
+						bool tupleIsAlive,
+						void *state);
+static void gist_indexsortbuild(GISTBuildState *state);
+static void gist_indexsortbuild_pagestate_add(GISTBuildState *state,
+								  GistSortedBuildPageState *pagestate,
+								  IndexTuple itup);
+static void gist_indexsortbuild_pagestate_flush(GISTBuildState *state,
+									GistSortedBuildPageState *pagestate);
+static void gist_indexsortbuild_writepage(GISTBuildState *state, Page page,
+							  BlockNumber blkno);
+
 static void gistInitBuffering(GISTBuildState *buildstate);
 static int	calculatePagesPerBuffer(GISTBuildState *buildstate, int levelStep);
 static void gistBuildCallback(Relation index,
@@ -105,9 +163,7 @@ static void gistMemorizeAllDownlinks(GISTBuildState *buildstate, Buffer parent);
 static BlockNumber gistGetParent(GISTBuildState *buildstate, BlockNumber child);
 
 /*
- * Main entry point to GiST index build. Initially calls insert over and over,
- * but switches to more efficient buffering build algorithm after a certain
- * number of tuples (unless buffering mode is disabled).
+ * Main entry point to GiST index build.
  */
 Datum
 gistbuild(PG_FUNCTION_ARGS)
@@ -131,11 +187,11 @@ gistbuild(PG_FUNCTION_ARGS)
 		char	   *bufferingMode = (char *) options + options->bufferingModeOffset;
 
 		if (strcmp(bufferingMode, "on") == 0)
-			buildstate.bufferingMode = GIST_BUFFERING_STATS;
+			buildstate.buildMode = GIST_BUFFERING_STATS;
 		else if (strcmp(bufferingMode, "off") == 0)
-			buildstate.bufferingMode = GIST_BUFFERING_DISABLED;
+			buildstate.buildMode = GIST_BUFFERING_DISABLED;
 		else
-			buildstate.bufferingMode = GIST_BUFFERING_AUTO;
+			buildstate.buildMode = GIST_BUFFERING_AUTO;
 
 		fillfactor = options->fillfactor;
 	}
@@ -145,9 +201,32 @@ gistbuild(PG_FUNCTION_ARGS)
 		 * By default, switch to buffering mode when the index grows too large
 		 * to fit in cache.
 		 */
-		buildstate.bufferingMode = GIST_BUFFERING_AUTO;
+		buildstate.buildMode = GIST_BUFFERING_AUTO;
 		fillfactor = GIST_DEFAULT_FILLFACTOR;
 	}
+
+	/*
+	 * Unless buffering mode was forced, see if we can use sorting instead.
+	 */
+	if (buildstate.buildMode != GIST_BUFFERING_STATS)
+	{
+		bool		hasallsortsupports = true;
+		int			keyscount = IndexRelationGetNumberOfKeyAttributes(index);
+		int			i;
+
+		for (i = 0; i < keyscount; i++)
+		{
+			if (!OidIsValid(index_getprocid(index, i + 1,
+											GIST_SORTSUPPORT_PROC)))
+			{
+				hasallsortsupports = false;
+				break;
+			}
+		}
+		if (hasallsortsupports)
+			buildstate.buildMode = GIST_SORTED_BUILD;
+	}
+
 	/* Calculate target amount of free space to leave on pages */
 	buildstate.freespace = BLCKSZ * (100 - fillfactor) / 100;
 
@@ -169,53 +248,86 @@ gistbuild(PG_FUNCTION_ARGS)
 	 */
 	buildstate.giststate->tempCxt = createTempGistContext();
 
-	/* initialize the root page */
-	buffer = gistNewBuffer(index);
-	Assert(BufferGetBlockNumber(buffer) == GIST_ROOT_BLKNO);
-	page = BufferGetPage(buffer);
-
-	START_CRIT_SECTION();
+	/* build the index */
+	buildstate.indtuples = 0;
+	buildstate.indtuplesSize = 0;
 
-	GISTInitBuffer(buffer, F_LEAF);
+	if (buildstate.buildMode == GIST_SORTED_BUILD)
+	{
+		/*
+		 * Sort all data, build the index from bottom up.
+		 */
+		buildstate.sortstate = tuplesort_begin_index_gist(heap,
+														  index,
+														maintenance_work_mem,
+														  false);
 
-	MarkBufferDirty(buffer);
+		/* Scan the table, adding all tuples to the tuplesort */
+		reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
+									   gistSortedBuildCallback,
+									   (void *) &buildstate);
 
-	if (RelationNeedsWAL(index))
-	{
-		XLogRecPtr	recptr;
+		/*
+		 * Perform the sort and build index pages.
+		 */
+		tuplesort_performsort(buildstate.sortstate);
 
-		XLogBeginInsert();
-		XLogRegisterBuffer(0, buffer, REGBUF_WILL_INIT);
+		gist_indexsortbuild(&buildstate);
 
-		recptr = XLogInsert(RM_GIST_ID, XLOG_GIST_CREATE_INDEX);
-		PageSetLSN(page, recptr);
+		tuplesort_end(buildstate.sortstate);
 	}
 	else
-		PageSetLSN(page, gistGetFakeLSN(heap));
+	{
+		/*
+		 * Initialize an empty index and insert all tuples, possibly using
+		 * buffers on intermediate levels.
+		 */
 
-	UnlockReleaseBuffer(buffer);
+		/* initialize the root page */
+		buffer = gistNewBuffer(index);
+		Assert(BufferGetBlockNumber(buffer) == GIST_ROOT_BLKNO);
+		page = BufferGetPage(buffer);
 
-	END_CRIT_SECTION();
+		START_CRIT_SECTION();
 
-	/* build the index */
-	buildstate.indtuples = 0;
-	buildstate.indtuplesSize = 0;
+		GISTInitBuffer(buffer, F_LEAF);
 
-	/*
-	 * Do the heap scan.
-	 */
-	reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
-								   gistBuildCallback, (void *) &buildstate);
+		MarkBufferDirty(buffer);
 
-	/*
-	 * If buffering was used, flush out all the tuples that are still in the
-	 * buffers.
-	 */
-	if (buildstate.bufferingMode == GIST_BUFFERING_ACTIVE)
-	{
-		elog(DEBUG1, "all tuples processed, emptying buffers");
-		gistEmptyAllBuffers(&buildstate);
-		gistFreeBuildBuffers(buildstate.gfbb);
+		if (RelationNeedsWAL(index))
+		{
+			XLogRecPtr	recptr;
+
+			XLogBeginInsert();
+			XLogRegisterBuffer(0, buffer, REGBUF_WILL_INIT);
+
+			recptr = XLogInsert(RM_GIST_ID, XLOG_GIST_CREATE_INDEX);
+			PageSetLSN(page, recptr);
+		}
+		else
+			PageSetLSN(page, gistGetFakeLSN(heap));
+
+		UnlockReleaseBuffer(buffer);
+
+		END_CRIT_SECTION();
+
+		/*
+		 * Do the heap scan.
+		 */
+		reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
+									   gistBuildCallback,
+									   (void *) &buildstate);
+
+		/*
+		 * If buffering was used, flush out all the tuples that are still in
+		 * the buffers.
+		 */
+		if (buildstate.buildMode == GIST_BUFFERING_ACTIVE)
+		{
+			elog(DEBUG1, "all tuples processed, emptying buffers");
+			gistEmptyAllBuffers(&buildstate);
+			gistFreeBuildBuffers(buildstate.gfbb);
+		}
 	}
 
 	/* okay, all heap tuples are indexed */
@@ -235,6 +347,272 @@ gistbuild(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+/*-------------------------------------------------------------------------
+ * Routines for sorted build
+ *-------------------------------------------------------------------------
+ */
+
+/*
+ * Per-tuple callback from IndexBuildHeapScan, in sorted build mode.
+ */
+static void
+gistSortedBuildCallback(Relation index,
+						HeapTuple htup,
+						Datum *values,
+						bool *isnull,
+						bool tupleIsAlive,
+						void *state)
+{
+	GISTBuildState *buildstate = (GISTBuildState *) state;
+	MemoryContext oldCtx;
+	Datum		compressed_values[INDEX_MAX_KEYS];
+
+	oldCtx = MemoryContextSwitchTo(buildstate->giststate->tempCxt);
+
+	/* Compress the values; tuplesort forms the index tuple from them */
+	gistCompressValues(buildstate->giststate, index,
+					   values, isnull,
+					   true, compressed_values);
+
+	tuplesort_putindextuplevalues(buildstate->sortstate,
+								  buildstate->indexrel,
+								  &htup->t_self,
+								  compressed_values, isnull);
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->giststate->tempCxt);
+
+	/* Update tuple count. */
+	buildstate->indtuples += 1;
+}
+
+/*
+ * Build GiST index from bottom up from pre-sorted tuples.
+ */
+static void
+gist_indexsortbuild(GISTBuildState *state)
+{
+	IndexTuple	itup;
+	GistSortedBuildPageState *leafstate;
+	GistSortedBuildPageState *pagestate;
+	Page		page;
+	bool		should_free;
+
+	/*
+	 * We need to log index creation in WAL iff WAL archiving/streaming is
+	 * enabled UNLESS the index isn't WAL-logged anyway.  Otherwise the whole
+	 * index is fsync'd at the end, like in a btree build.
+	 */
+	state->use_wal = XLogIsNeeded() && RelationNeedsWAL(state->indexrel);
+
+	/* Ensure rd_smgr is open (could have been closed by relcache flush!) */
+	RelationOpenSmgr(state->indexrel);
+
+	/*
+	 * Write an empty page as a placeholder for the root page.  It will be
+	 * replaced with the real root page at the end.
+	 */
+	page = (Page) palloc0(BLCKSZ);
+	smgrextend(state->indexrel->rd_smgr, MAIN_FORKNUM, GIST_ROOT_BLKNO,
+			   (char *) page, true);
+	state->pages_allocated = 1;
+	state->pages_written = 1;
+
+	/* Allocate a temporary buffer for the first leaf page. */
+	leafstate = (GistSortedBuildPageState *)
+		palloc(sizeof(GistSortedBuildPageState));
+	leafstate->page = page;
+	leafstate->parent = NULL;
+	gistinitpage(page, BLCKSZ, F_LEAF);
+
+	/*
+	 * Fill index pages with tuples in the sorted order.
+	 */
+	while ((itup = tuplesort_getindextuple(state->sortstate, true,
+										   &should_free)) != NULL)
+	{
+		gist_indexsortbuild_pagestate_add(state, leafstate, itup);
+		if (should_free)
+			pfree(itup);
+		MemoryContextReset(state->giststate->tempCxt);
+	}
+
+	/*
+	 * Write out the partially full non-root pages.
+	 *
+	 * Keep in mind that flush can build a new root.
+	 */
+	pagestate = leafstate;
+	while (pagestate->parent != NULL)
+	{
+		GistSortedBuildPageState *parent;
+
+		gist_indexsortbuild_pagestate_flush(state, pagestate);
+		parent = pagestate->parent;
+		pfree(pagestate->page);
+		pfree(pagestate);
+		pagestate = parent;
+	}
+
+	/* Write out the root */
+	gist_indexsortbuild_writepage(state, pagestate->page, GIST_ROOT_BLKNO);
+	pfree(pagestate->page);
+	pfree(pagestate);
+
+	/*
+	 * If the index is WAL-logged, we must fsync it down to disk before it's
+	 * safe to commit the transaction.  (For a non-WAL-logged index we don't
+	 * care since the index will be uninteresting after a crash anyway.)
+	 *
+	 * As in _bt_load, it's sufficient to do this after the build, since no
+	 * checkpoint could have missed the writes.
+	 */
+	if (RelationNeedsWAL(state->indexrel))
+	{
+		RelationOpenSmgr(state->indexrel);
+		smgrimmedsync(state->indexrel->rd_smgr, MAIN_FORKNUM);
+	}
+}
+
+/*
+ * Add tuple to a page.  If the page is full, write it out and re-initialize
+ * a new page first.
+ */
+static void
+gist_indexsortbuild_pagestate_add(GISTBuildState *state,
+								  GistSortedBuildPageState *pagestate,
+								  IndexTuple itup)
+{
+	Size		sizeNeeded;
+
+	/* Does the tuple fit?  If not, flush */
+	sizeNeeded = IndexTupleSize(itup) + sizeof(ItemIdData) + state->freespace;
+	if (PageGetFreeSpace(pagestate->page) < sizeNeeded &&
+		!PageIsEmpty(pagestate->page))
+		gist_indexsortbuild_pagestate_flush(state, pagestate);
+
+	gistfillbuffer(pagestate->page, &itup, 1, InvalidOffsetNumber);
+}
+
+/*
+ * Write out a full page, and insert a downlink for it into the parent
+ * level, which is created if this was the topmost level so far.
+ */
+static void
+gist_indexsortbuild_pagestate_flush(GISTBuildState *state,
+									GistSortedBuildPageState *pagestate)
+{
+	GistSortedBuildPageState *parent;
+	IndexTuple *itvec;
+	IndexTuple	union_tuple;
+	int			vect_len;
+	bool		isleaf;
+	BlockNumber blkno;
+	MemoryContext oldCtx;
+
+	/* check once per page */
+	CHECK_FOR_INTERRUPTS();
+
+	/* The page is complete.  Assign a block number to it. */
+	blkno = state->pages_allocated++;
+	isleaf = GistPageIsLeaf(pagestate->page);
+
+	/*
+	 * Form a downlink tuple to represent all the tuples on the page.
+	 */
+	oldCtx = MemoryContextSwitchTo(state->giststate->tempCxt);
+	itvec = gistextractpage(pagestate->page, &vect_len);
+	union_tuple = gistunion(state->indexrel, itvec, vect_len,
+							state->giststate);
+	ItemPointerSetBlockNumber(&(union_tuple->t_tid), blkno);
+	MemoryContextSwitchTo(oldCtx);
+
+	/*
+	 * Write the page out.  Its buffer is kept for the next page on the
+	 * level.
+	 */
+	gist_indexsortbuild_writepage(state, pagestate->page, blkno);
+
+	/*
+	 * Insert the downlink to the parent page.  If this was the root, create
+	 * a new page as the parent, which becomes the new root.
+	 */
+	parent = pagestate->parent;
+	if (parent == NULL)
+	{
+		parent = (GistSortedBuildPageState *)
+			palloc(sizeof(GistSortedBuildPageState));
+		parent->page = (Page) palloc(BLCKSZ);
+		parent->parent = NULL;
+		gistinitpage(parent->page, BLCKSZ, 0);
+
+		pagestate->parent = parent;
+	}
+	gist_indexsortbuild_pagestate_add(state, parent, union_tuple);
+
+	/* Re-initialize the page buffer for next page on this level. */
+	gistinitpage(pagestate->page, BLCKSZ, isleaf ? F_LEAF : 0);
+
+	/*
+	 * Set the right link to point to the previous page.  This is just for
+	 * debugging purposes: GiST only follows the right link if a page is
+	 * split concurrently to a scan, and that cannot happen during index
+	 * build.  As long as the right-links form a chain through all the pages
+	 * of a level, their order doesn't matter.
+	 */
+	GistPageGetOpaque(pagestate->page)->rightlink = blkno;
+}
+
+/*
+ * Write a finished page to disk, WAL-logging it if needed.
+ *
+ * Pages are written in order of block number, except for the root, which
+ * overwrites the placeholder written at the start.
+ */
+static void
+gist_indexsortbuild_writepage(GISTBuildState *state, Page page,
+							  BlockNumber blkno)
+{
+	/* Ensure rd_smgr is open (could have been closed by relcache flush!) */
+	RelationOpenSmgr(state->indexrel);
+
+	/*
+	 * The page gets a real LSN if WAL-logged.  Otherwise it needs a valid
+	 * fake one all the same, for scans to tell it from a root that has never
+	 * been split; any real LSN generated later for a permanent index is
+	 * higher than GistBuildLSN.
+	 */
+	if (state->use_wal)
+		log_newpage(&state->indexrel->rd_node, MAIN_FORKNUM, blkno, page,
+					true);
+	else if (RelationNeedsWAL(state->indexrel))
+		PageSetLSN(page, GistBuildLSN);
+	else
+		PageSetLSN(page, gistGetFakeLSN(state->indexrel));
+
+	PageSetChecksumInplace(page, blkno);
+
+	if (blkno == state->pages_written)
+	{
+		/* extending the file... */
+		smgrextend(state->indexrel->rd_smgr, MAIN_FORKNUM, blkno,
+				   (char *) page, true);
+		state->pages_written++;
+	}
+	else
+	{
+		Assert(blkno == GIST_ROOT_BLKNO);
+		/* overwriting the root placeholder */
+		smgrwrite(state->indexrel->rd_smgr, MAIN_FORKNUM, blkno,
+				  (char *) page, true);
+	}
+}
+
+/*-------------------------------------------------------------------------
+ * Routines for non-sorted build
+ *-------------------------------------------------------------------------
+ */
+
 /*
  * Validator for "buffering" reloption on GiST indexes. Allows "on", "off"
  * and "auto" values.
@@ -257,9 +635,9 @@ gistValidateBufferingOption(char *value)
 /*
  * Attempt to switch to buffering mode.
  *
- * If there is not enough memory for buffering build, sets bufferingMode
+ * If there is not enough memory for buffering build, sets buildMode
  * to GIST_BUFFERING_DISABLED, so that we don't bother to try the switch
- * anymore. Otherwise initializes the build buffers, and sets bufferingMode to
+ * anymore. Otherwise initializes the build buffers, and sets buildMode to
  * GIST_BUFFERING_ACTIVE.
  */
 static void
@@ -393,7 +771,7 @@ gistInitBuffering(GISTBuildState *buildstate)
 	if (levelStep <= 0)
 	{
 		elog(DEBUG1, "failed to switch to buffered GiST build");
-		buildstate->bufferingMode = GIST_BUFFERING_DISABLED;
+		buildstate->buildMode = GIST_BUFFERING_DISABLED;
 		return;
 	}
 
@@ -410,7 +788,7 @@ gistInitBuffering(GISTBuildState *buildstate)
 
 	gistInitParentMap(buildstate);
 
-	buildstate->bufferingMode = GIST_BUFFERING_ACTIVE;
+	buildstate->buildMode = GIST_BUFFERING_ACTIVE;
 
 	elog(DEBUG1, "switched to buffered GiST build; level step = %d, pagesPerBuffer = %d",
 		 levelStep, pagesPerBuffer);
@@ -474,7 +852,7 @@ gistBuildCallback(Relation index,
 	itup = gistFormTuple(buildstate->giststate, index, values, isnull, true);
 	itup->t_tid = htup->t_self;
 
-	if (buildstate->bufferingMode == GIST_BUFFERING_ACTIVE)
+	if (buildstate->buildMode == GIST_BUFFERING_ACTIVE)
 	{
 		/* We have buffers, so use them. */
 		gistBufferingBuildInsert(buildstate, itup);
@@ -496,7 +874,7 @@ gistBuildCallback(Relation index,
 	MemoryContextSwitchTo(oldCtx);
 	MemoryContextReset(buildstate->giststate->tempCxt);
 
-	if (buildstate->bufferingMode == GIST_BUFFERING_ACTIVE &&
+	if (buildstate->buildMode == GIST_BUFFERING_ACTIVE &&
 		buildstate->indtuples % BUFFERING_MODE_TUPLE_SIZE_STATS_TARGET == 0)
 	{
 		/* Adjust the target buffer size now */
@@ -511,10 +889,10 @@ gistBuildCallback(Relation index,
 	 * To avoid excessive calls to smgrnblocks(), only check this every
 	 * BUFFERING_MODE_SWITCH_CHECK_STEP index tuples
 	 */
-	if ((buildstate->bufferingMode == GIST_BUFFERING_AUTO &&
+	if ((buildstate->buildMode == GIST_BUFFERING_AUTO &&
 		 buildstate->indtuples % BUFFERING_MODE_SWITCH_CHECK_STEP == 0 &&
 		 effective_cache_size < smgrnblocks(index->rd_smgr, MAIN_FORKNUM)) ||
-		(buildstate->bufferingMode == GIST_BUFFERING_STATS &&
+		(buildstate->buildMode == GIST_BUFFERING_STATS &&
 		 buildstate->indtuples >= BUFFERING_MODE_TUPLE_SIZE_STATS_TARGET))
 	{
 		/*
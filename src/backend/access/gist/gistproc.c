@@ -20,6 +20,7 @@
 #include "access/gist.h"
 #include "access/stratnum.h"
 #include "utils/geo_decls.h"
+#include "utils/sortsupport.h"
 
 
 static bool gist_box_leaf_consistent(BOX *key, BOX *query,
@@ -1515,3 +1516,177 @@ gist_bbox_distance(PG_FUNCTION_ARGS)
 
 	PG_RETURN_FLOAT8(distance);
 }
+
+
+/*
+ * Z-order routines for sorted index build
+ */
+
+/*
+ * Compute Z-value of a point
+ *
+ * Z-order (also known as Morton Code) maps a two-dimensional point to a
+ * single integer, in a way that preserves locality.  Points that are close
+ * in the two-dimensional space are mapped to integer that are not far from
+ * each other.  We do that by interleaving the bits in the X and Y
+ * components.
+ *
+ * Morton Code is normally defined only for integers, but the X and Y values
+ * of a point are floating point.  We expect floats to be in IEEE format, and
+ * map them to unsigned 32-bit integers that sort the same way as the
+ * floats, after converting them to single precision.  Only the order
+ * matters, so the precision lost doesn't hurt.
+ */
+/*
+ * Map a float to an unsigned integer that sorts the same way; NaNs sort
+ * after everything else.
+ */
+static uint32
+ieee_float32_to_uint32(float f)
+{
+	uint32		i;
+
+	if (isnan(f))
+		return 0xFFFFFFFF;
+
+	memcpy(&i, &f, sizeof(i));
+
+	/*
+	 * IEEE 754 floating point numbers are stored as sign and magnitude, so
+	 * flip all the bits of negative numbers, which puts them below the
+	 * positive ones in reverse order of magnitude, and set the sign bit of
+	 * the others.  -0 and +0 end up next to each other.
+	 */
+	if ((i & 0x80000000) != 0)
+		i ^= 0xFFFFFFFF;
+	else
+		i |= 0x80000000;
+
+	return i;
+}
+
+static uint64
+part_bits32_by2(uint32 x)
+{
+	uint64		n = x;
+
+	n = (n | (n << 16)) & UINT64CONST(0x0000FFFF0000FFFF);
+	n = (n | (n << 8)) & UINT64CONST(0x00FF00FF00FF00FF);
+	n = (n | (n << 4)) & UINT64CONST(0x0F0F0F0F0F0F0F0F);
+	n = (n | (n << 2)) & UINT64CONST(0x3333333333333333);
+	n = (n | (n << 1)) & UINT64CONST(0x5555555555555555);
+
+	return n;
+}
+
+static uint64
+point_zorder_internal(float4 x, float4 y)
+{
+	uint32		ix = ieee_float32_to_uint32(x);
+	uint32		iy = ieee_float32_to_uint32(y);
+
+	/* Interleave the bits */
+	return part_bits32_by2(ix) | (part_bits32_by2(iy) << 1);
+}
+
+/*
+ * Compare the Z-order of points.  The keys are stored as boxes in the index,
+ * but leaf entries of points have equal low and high corners.
+ */
+static int
+gist_bbox_zorder_cmp(Datum a, Datum b, SortSupport ssup)
+{
+	Point	   *p1 = &(DatumGetBoxP(a)->low);
+	Point	   *p2 = &(DatumGetBoxP(b)->low);
+	uint64		z1;
+	uint64		z2;
+
+	/*
+	 * Do a quick check for equality first.  It's not clear if this is worth
+	 * it in general, but certainly is when used as tie-breaker with
+	 * abbreviated keys.
+	 */
+	if (p1->x == p2->x && p1->y == p2->y)
+		return 0;
+
+	z1 = point_zorder_internal((float4) p1->x, (float4) p1->y);
+	z2 = point_zorder_internal((float4) p2->x, (float4) p2->y);
+	if (z1 > z2)
+		return 1;
+	else if (z1 < z2)
+		return -1;
+	else
+		return 0;
+}
+
+/*
+ * Abbreviated version of Z-order comparison
+ *
+ * The abbreviated format is a Z-order value computed from the two 32-bit
+ * floats.  If SIZEOF_DATUM == 8, the 64-bit Z-order value fits fully in the
+ * abbreviated Datum, otherwise use its most significant bits.
+ */
+static Datum
+gist_bbox_zorder_abbrev_convert(Datum original, SortSupport ssup)
+{
+	Point	   *p = &(DatumGetBoxP(original)->low);
+	uint64		z;
+
+	z = point_zorder_internal((float4) p->x, (float4) p->y);
+
+#if SIZEOF_DATUM == 8
+	return (Datum) z;
+#else
+	return (Datum) (z >> 32);
+#endif
+}
+
+static int
+gist_bbox_zorder_cmp_abbrev(Datum z1, Datum z2, SortSupport ssup)
+{
+	/*
+	 * Compare the pre-computed Z-orders as unsigned integers.  Datum is a
+	 * typedef for 'uintptr_t', so no casting is required.
+	 */
+	if (z1 > z2)
+		return 1;
+	else if (z1 < z2)
+		return -1;
+	else
+		return 0;
+}
+
+/*
+ * We never consider aborting the abbreviation.
+ *
+ * On 64-bit systems, the abbreviation is not lossy so it is always
+ * worthwhile.  (Perhaps it's not on 32-bit systems, but we don't bother with
+ * logic to decide.)
+ */
+static bool
+gist_bbox_zorder_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	return false;
+}
+
+/*
+ * Sort support routine for fast GiST index build by sorting.
+ */
+Datum
+gist_point_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	if (ssup->abbreviate)
+	{
+		ssup->comparator = gist_bbox_zorder_cmp_abbrev;
+		ssup->abbrev_converter = gist_bbox_zorder_abbrev_convert;
+		ssup->abbrev_abort = gist_bbox_zorder_abbrev_abort;
+		ssup->abbrev_full_comparator = gist_bbox_zorder_cmp;
+	}
+	else
+	{
+		ssup->comparator = gist_bbox_zorder_cmp;
+	}
+	PG_RETURN_VOID();
+}
@@ -564,12 +564,30 @@ gistFormTuple(GISTSTATE *giststate, Relation r,
 			  Datum attdata[], bool isnull[], bool isleaf)
 {
 	Datum		compatt[INDEX_MAX_KEYS];
-	int			i;
 	IndexTuple	res;
 
+	gistCompressValues(giststate, r, attdata, isnull, isleaf, compatt);
+
+	res = index_form_tuple(giststate->tupdesc, compatt, isnull);
+
 	/*
-	 * Call the compress method on each attribute.
+	 * The offset number on tuples on internal pages is unused. For historical
+	 * reasons, it is set to 0xffff.
 	 */
+	ItemPointerSetOffsetNumber(&(res->t_tid), 0xffff);
+	return res;
+}
+
+/*
+ * Call the compress method on each attribute, leaving the results in
+ * compatt[].
+ */
+void
+gistCompressValues(GISTSTATE *giststate, Relation r,
+				   Datum *attdata, bool *isnull, bool isleaf, Datum *compatt)
+{
+	int			i;
+
 	for (i = 0; i < r->rd_att->natts; i++)
 	{
 		if (isnull[i])
@@ -588,15 +606,6 @@ gistFormTuple(GISTSTATE *giststate, Relation r,
 			compatt[i] = cep->key;
 		}
 	}
-
-	res = index_form_tuple(giststate->tupdesc, compatt, isnull);
-
-	/*
-	 * The offset number on tuples on internal pages is unused. For historical
-	 * reasons, it is set to 0xffff.
-	 */
-	ItemPointerSetOffsetNumber(&(res->t_tid), 0xffff);
-	return res;
 }
 
 /*
@@ -696,12 +705,23 @@ gistpenalty(GISTSTATE *giststate, int attno,
 void
 GISTInitBuffer(Buffer b, uint32 f)
 {
-	GISTPageOpaque opaque;
 	Page		page;
 	Size		pageSize;
 
 	pageSize = BufferGetPageSize(b);
 	page = BufferGetPage(b);
+	gistinitpage(page, pageSize, f);
+}
+
+/*
+ * Initialize a new GiST page of the given size, in local memory or in a
+ * buffer.
+ */
+void
+gistinitpage(Page page, Size pageSize, uint32 f)
+{
+	GISTPageOpaque opaque;
+
 	PageInit(page, pageSize, sizeof(GISTPageOpaqueData));
 
 	opaque = GistPageGetOpaque(page);
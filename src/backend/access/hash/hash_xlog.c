@@ -0,0 +1,337 @@
+/*-------------------------------------------------------------------------
+ *
+ * hash_xlog.c
+ *	  WAL replay logic for hash index.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/hash/hash_xlog.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "access/hash_xlog.h"
+#include "access/xlogutils.h"
+
+
+/*
+ * replay a hash index insert without split
+ */
+static void
+hash_xlog_insert(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_insert *xlrec = (xl_hash_insert *) XLogRecGetData(record);
+	HashMetaPage metap;
+	Buffer		buffer;
+	Page		page;
+
+	if (XLogReadBufferForRedo(record, 0, &buffer) == BLK_NEEDS_REDO)
+	{
+		Size		datalen;
+		char	   *datapos = XLogRecGetBlockData(record, 0, &datalen);
+
+		page = BufferGetPage(buffer);
+
+		if (PageAddItem(page, (Item) datapos, datalen, xlrec->offnum,
+						false, false) == InvalidOffsetNumber)
+			elog(PANIC, "hash_xlog_insert: failed to add item");
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+
+	if (XLogReadBufferForRedo(record, 1, &buffer) == BLK_NEEDS_REDO)
+	{
+		/*
+		 * Note: in normal operation, we'd update the metapage while still
+		 * holding lock on the page we inserted into.  But during replay it's
+		 * not necessary to hold that lock, since no other index updates can
+		 * be happening concurrently.
+		 */
+		page = BufferGetPage(buffer);
+		metap = HashPageGetMeta(page);
+		metap->hashm_ntuples += 1;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * replay an overflow page operation: adding an overflow page to a bucket,
+ * moving tuples between pages of a bucket while squeezing it, or freeing an
+ * overflow page.  All the changed pages come with a full image.
+ */
+static void
+hash_xlog_restore_pages(XLogReaderState *record)
+{
+	Buffer		bucketbuf = InvalidBuffer;
+	Buffer		bufs[XLR_MAX_BLOCK_ID + 1];
+	int			block_id;
+
+	/*
+	 * Take a cleanup lock on the primary bucket page before changing anything
+	 * else in the bucket, so that no hot standby scan is stopped in the
+	 * bucket while tuples move around under it.  If the operation changed the
+	 * primary page itself, this also restores its image.
+	 */
+	if (XLogRecHasBlockRef(record, 0))
+		(void) XLogReadBufferForRedoExtended(record, 0, RBM_NORMAL, true,
+											 &bucketbuf);
+
+	/*
+	 * Restore the other pages.  Keep them all locked until every one of them
+	 * is restored, so that a concurrent scan can't see the chain half-way.
+	 */
+	for (block_id = 1; block_id <= record->max_block_id; block_id++)
+	{
+		bufs[block_id] = InvalidBuffer;
+		if (!XLogRecHasBlockRef(record, block_id))
+			continue;
+		if (XLogReadBufferForRedo(record, block_id, &bufs[block_id]) != BLK_RESTORED)
+			elog(PANIC, "hash_xlog_restore_pages: missing full page image for block %d",
+				 block_id);
+	}
+
+	for (block_id = 1; block_id <= record->max_block_id; block_id++)
+	{
+		if (BufferIsValid(bufs[block_id]))
+			UnlockReleaseBuffer(bufs[block_id]);
+	}
+	if (BufferIsValid(bucketbuf))
+		UnlockReleaseBuffer(bucketbuf);
+}
+
+/*
+ * replay allocation of a new splitpoint
+ */
+static void
+hash_xlog_new_splitpoint(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_new_splitpoint *xlrec = (xl_hash_new_splitpoint *) XLogRecGetData(record);
+	HashMetaPage metap;
+	Buffer		metabuf;
+	Page		page;
+
+	if (XLogReadBufferForRedo(record, 0, &metabuf) == BLK_NEEDS_REDO)
+	{
+		page = BufferGetPage(metabuf);
+		metap = HashPageGetMeta(page);
+
+		metap->hashm_spares[xlrec->ovflpoint] =
+			metap->hashm_spares[metap->hashm_ovflpoint];
+		metap->hashm_ovflpoint = xlrec->ovflpoint;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(metabuf);
+	}
+	if (BufferIsValid(metabuf))
+		UnlockReleaseBuffer(metabuf);
+}
+
+/*
+ * replay the completion of a bucket split
+ */
+static void
+hash_xlog_split_complete(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_split_complete *xlrec = (xl_hash_split_complete *) XLogRecGetData(record);
+	HashPageOpaque oldopaque;
+	HashMetaPage metap;
+	Buffer		oldbuf;
+	Buffer		metabuf;
+	Page		page;
+
+	/*
+	 * Keep the old bucket's primary page locked until the metapage is
+	 * updated, as the split did, so that a standby scan that finds the page's
+	 * split mark also finds the new bucket mapping in the metapage.
+	 */
+	if (XLogReadBufferForRedo(record, 0, &oldbuf) == BLK_NEEDS_REDO)
+	{
+		page = BufferGetPage(oldbuf);
+		oldopaque = (HashPageOpaque) PageGetSpecialPointer(page);
+
+		oldopaque->hasho_flag = xlrec->old_bucket_flag;
+		oldopaque->hasho_prevblkno = xlrec->maxbucket;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(oldbuf);
+	}
+
+	if (XLogReadBufferForRedo(record, 1, &metabuf) == BLK_NEEDS_REDO)
+	{
+		page = BufferGetPage(metabuf);
+		metap = HashPageGetMeta(page);
+
+		metap->hashm_maxbucket = xlrec->maxbucket;
+		metap->hashm_highmask = xlrec->highmask;
+		metap->hashm_lowmask = xlrec->lowmask;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(metabuf);
+	}
+	if (BufferIsValid(metabuf))
+		UnlockReleaseBuffer(metabuf);
+	if (BufferIsValid(oldbuf))
+		UnlockReleaseBuffer(oldbuf);
+}
+
+/*
+ * replay delete operation of hash index
+ */
+static void
+hash_xlog_delete(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_delete *xldata = (xl_hash_delete *) XLogRecGetData(record);
+	Buffer		bucketbuf = InvalidBuffer;
+	Buffer		deletebuf;
+	Page		page;
+	XLogRedoAction action;
+
+	/*
+	 * Ensure we have a cleanup lock on the primary bucket page before we
+	 * start.  Otherwise a standby scan stopped in the bucket could miss
+	 * tuples, or return the same tuple twice, once the bucket is squeezed.
+	 */
+	if (xldata->is_primary_bucket_page)
+		action = XLogReadBufferForRedoExtended(record, 1, RBM_NORMAL, true,
+											   &deletebuf);
+	else
+	{
+		/*
+		 * We don't care about the return value, as the primary page is read
+		 * only to get the cleanup lock on it.
+		 */
+		(void) XLogReadBufferForRedoExtended(record, 0, RBM_NORMAL, true,
+											 &bucketbuf);
+		action = XLogReadBufferForRedo(record, 1, &deletebuf);
+	}
+
+	if (action == BLK_NEEDS_REDO)
+	{
+		char	   *ptr;
+		Size		len;
+
+		ptr = XLogRecGetBlockData(record, 1, &len);
+		page = BufferGetPage(deletebuf);
+
+		if (len > 0)
+		{
+			OffsetNumber *unused;
+			OffsetNumber *unend;
+
+			unused = (OffsetNumber *) ptr;
+			unend = (OffsetNumber *) ((char *) ptr + len);
+
+			PageIndexMultiDelete(page, unused, unend - unused);
+		}
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(deletebuf);
+	}
+	if (BufferIsValid(deletebuf))
+		UnlockReleaseBuffer(deletebuf);
+	if (BufferIsValid(bucketbuf))
+		UnlockReleaseBuffer(bucketbuf);
+}
+
+/*
+ * replay clearing of the split-cleanup flag, once the tuples a split left
+ * behind in the old bucket are gone
+ */
+static void
+hash_xlog_split_cleanup(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	HashPageOpaque bucket_opaque;
+	Buffer		buffer;
+	Page		page;
+
+	if (XLogReadBufferForRedo(record, 0, &buffer) == BLK_NEEDS_REDO)
+	{
+		page = BufferGetPage(buffer);
+		bucket_opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+
+		bucket_opaque->hasho_flag &= ~LH_BUCKET_NEEDS_SPLIT_CLEANUP;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * replay the metapage update at the end of hash index vacuum
+ */
+static void
+hash_xlog_update_meta_page(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_hash_update_meta_page *xldata = (xl_hash_update_meta_page *) XLogRecGetData(record);
+	HashMetaPage metap;
+	Buffer		metabuf;
+	Page		page;
+
+	if (XLogReadBufferForRedo(record, 0, &metabuf) == BLK_NEEDS_REDO)
+	{
+		page = BufferGetPage(metabuf);
+		metap = HashPageGetMeta(page);
+
+		metap->hashm_ntuples = xldata->ntuples;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(metabuf);
+	}
+	if (BufferIsValid(metabuf))
+		UnlockReleaseBuffer(metabuf);
+}
+
+void
+hash_redo(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	switch (info)
+	{
+		case XLOG_HASH_INSERT:
+			hash_xlog_insert(record);
+			break;
+		case XLOG_HASH_ADD_OVFL_PAGE:
+		case XLOG_HASH_MOVE_PAGE_CONTENTS:
+		case XLOG_HASH_SQUEEZE_PAGE:
+			hash_xlog_restore_pages(record);
+			break;
+		case XLOG_HASH_NEW_SPLITPOINT:
+			hash_xlog_new_splitpoint(record);
+			break;
+		case XLOG_HASH_SPLIT_COMPLETE:
+			hash_xlog_split_complete(record);
+			break;
+		case XLOG_HASH_DELETE:
+			hash_xlog_delete(record);
+			break;
+		case XLOG_HASH_SPLIT_CLEANUP:
+			hash_xlog_split_cleanup(record);
+			break;
+		case XLOG_HASH_UPDATE_META_PAGE:
+			hash_xlog_update_meta_page(record);
+			break;
+		default:
+			elog(PANIC, "hash_redo: unknown op code %u", info);
+	}
+}
@@ -29,71 +29,24 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "access/hash_xlog.h"
+#include "access/xloginsert.h"
 #include "miscadmin.h"
-#include "storage/lmgr.h"
 #include "storage/smgr.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
 
 
 static bool _hash_alloc_buckets(Relation rel, BlockNumber firstblock,
 					uint32 nblocks);
 static void _hash_splitbucket(Relation rel, Buffer metabuf,
 				  Bucket obucket, Bucket nbucket,
-				  BlockNumber start_oblkno,
+				  Buffer obuf,
 				  Buffer nbuf,
 				  uint32 maxbucket,
 				  uint32 highmask, uint32 lowmask);
 
 
-/*
- * We use high-concurrency locking on hash indexes (see README for an overview
- * of the locking rules).  However, we can skip taking lmgr locks when the
- * index is local to the current backend (ie, either temp or new in the
- * current transaction).  No one else can see it, so there's no reason to
- * take locks.  We still take buffer-level locks, but not lmgr locks.
- */
-#define USELOCKING(rel)		(!RELATION_IS_LOCAL(rel))
-
-
-/*
- * _hash_getlock() -- Acquire an lmgr lock.
- *
- * 'whichlock' should the block number of a bucket's primary bucket page to
- * acquire the per-bucket lock.  (See README for details of the use of these
- * locks.)
- *
- * 'access' must be HASH_SHARE or HASH_EXCLUSIVE.
- */
-void
-_hash_getlock(Relation rel, BlockNumber whichlock, int access)
-{
-	if (USELOCKING(rel))
-		LockPage(rel, whichlock, access);
-}
-
-/*
- * _hash_try_getlock() -- Acquire an lmgr lock, but only if it's free.
- *
- * Same as above except we return FALSE without blocking if lock isn't free.
- */
-bool
-_hash_try_getlock(Relation rel, BlockNumber whichlock, int access)
-{
-	if (USELOCKING(rel))
-		return ConditionalLockPage(rel, whichlock, access);
-	else
-		return true;
-}
-
-/*
- * _hash_droplock() -- Release an lmgr lock.
- */
-void
-_hash_droplock(Relation rel, BlockNumber whichlock, int access)
-{
-	if (USELOCKING(rel))
-		UnlockPage(rel, whichlock, access);
-}
-
 /*
  *	_hash_getbuf() -- Get a buffer by block number for read or write.
  *
@@ -131,6 +84,40 @@ _hash_getbuf(Relation rel, BlockNumber blkno, int access, int flags)
 	return buf;
 }
 
+/*
+ *	_hash_getbuf_with_condlock_cleanup() -- Try to get a buffer for cleanup.
+ *
+ *		We read the page and try to acquire a cleanup lock.  If we get it,
+ *		we return the buffer; otherwise, we return InvalidBuffer.
+ *
+ *		A cleanup lock means that no one else holds a pin on the page, and
+ *		since every backend working in a bucket keeps the bucket's primary
+ *		page pinned, a cleanup lock on a primary bucket page means that no
+ *		one else is in the bucket at all.
+ */
+Buffer
+_hash_getbuf_with_condlock_cleanup(Relation rel, BlockNumber blkno, int flags)
+{
+	Buffer		buf;
+
+	if (blkno == P_NEW)
+		elog(ERROR, "hash AM does not use P_NEW");
+
+	buf = ReadBuffer(rel, blkno);
+
+	if (!ConditionalLockBufferForCleanup(buf))
+	{
+		ReleaseBuffer(buf);
+		return InvalidBuffer;
+	}
+
+	/* ref count and lock type are correct */
+
+	_hash_checkpage(rel, buf, flags);
+
+	return buf;
+}
+
 /*
  *	_hash_getinitbuf() -- Get and initialize a buffer by block number.
  *
@@ -266,22 +253,24 @@ _hash_dropbuf(Relation rel, Buffer buf)
 }
 
 /*
- *	_hash_wrtbuf() -- write a hash page to disk.
- *
- *		This routine releases the lock held on the buffer and our refcount
- *		for it.  It is an error to call _hash_wrtbuf() without a write lock
- *		and a pin on the buffer.
+ *	_hash_dropscanbuf() -- release buffers used in scan.
  *
- * NOTE: this routine should go away when/if hash indexes are WAL-ified.
- * The correct sequence of operations is to mark the buffer dirty, then
- * write the WAL record, then release the lock and pin; so marking dirty
- * can't be combined with releasing.
+ * This routine unpins the buffers used during scan on which we
+ * hold no lock.
  */
 void
-_hash_wrtbuf(Relation rel, Buffer buf)
+_hash_dropscanbuf(Relation rel, HashScanOpaque so)
 {
-	MarkBufferDirty(buf);
-	UnlockReleaseBuffer(buf);
+	/* release pin we hold on primary bucket page */
+	if (BufferIsValid(so->hashso_bucket_buf) &&
+		so->hashso_bucket_buf != so->hashso_curbuf)
+		_hash_dropbuf(rel, so->hashso_bucket_buf);
+	so->hashso_bucket_buf = InvalidBuffer;
+
+	/* release any pin we still hold */
+	if (BufferIsValid(so->hashso_curbuf))
+		_hash_dropbuf(rel, so->hashso_curbuf);
+	so->hashso_curbuf = InvalidBuffer;
 }
 
 /*
@@ -291,10 +280,9 @@ _hash_wrtbuf(Relation rel, Buffer buf)
  * from_access and to_access may be HASH_READ, HASH_WRITE, or HASH_NOLOCK,
  * the last indicating that no buffer-level lock is held or wanted.
  *
- * When from_access == HASH_WRITE, we assume the buffer is dirty and tell
- * bufmgr it must be written out.  If the caller wants to release a write
- * lock on a page that's not been modified, it's okay to pass from_access
- * as HASH_READ (a bit ugly, but handy in some places).
+ * This never marks the buffer dirty: a page that was changed has to be
+ * marked dirty and WAL-logged inside the critical section that changed it,
+ * before the lock is let go.
  */
 void
 _hash_chgbufaccess(Relation rel,
@@ -302,8 +290,6 @@ _hash_chgbufaccess(Relation rel,
 				   int from_access,
 				   int to_access)
 {
-	if (from_access == HASH_WRITE)
-		MarkBufferDirty(buf);
 	if (from_access != HASH_NOLOCK)
 		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
 	if (to_access != HASH_NOLOCK)
@@ -322,6 +308,10 @@ _hash_chgbufaccess(Relation rel,
  * We are fairly cavalier about locking here, since we know that no one else
  * could be accessing this index.  In particular the rule about not holding
  * multiple buffer locks is ignored.
+ *
+ * Every page is WAL-logged as a full page image as soon as it's initialized,
+ * if the index is WAL-logged at all.  The init fork of an unlogged index is
+ * always logged, since it must survive a crash to be copied into place.
  */
 uint32
 _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
@@ -330,7 +320,9 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 	HashPageOpaque pageopaque;
 	Buffer		metabuf;
 	Buffer		buf;
+	Buffer		bitmapbuf;
 	Page		pg;
+	bool		use_wal;
 	int32		data_width;
 	int32		item_width;
 	int32		ffactor;
@@ -344,6 +336,8 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 		elog(ERROR, "cannot initialize non-empty hash index \"%s\"",
 			 RelationGetRelationName(rel));
 
+	use_wal = RelationNeedsWAL(rel) || forkNum == INIT_FORKNUM;
+
 	/*
 	 * Determine the target fill factor (in tuples per bucket) for this index.
 	 * The idea is to make the fill factor correspond to pages about as full
@@ -435,12 +429,21 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 	metap->hashm_ovflpoint = log2_num_buckets;
 	metap->hashm_firstfree = 0;
 
+	/*
+	 * Set pd_lower just past the end of the metadata.  This is essential,
+	 * because without doing so, metadata will be lost if xlog.c compresses
+	 * the page.
+	 */
+	((PageHeader) pg)->pd_lower =
+		((char *) metap + sizeof(HashMetaPageData)) - (char *) pg;
+
 	/*
 	 * Release buffer lock on the metapage while we initialize buckets.
 	 * Otherwise, we'll be in interrupt holdoff and the CHECK_FOR_INTERRUPTS
 	 * won't accomplish anything.  It's a bad idea to hold buffer locks for
 	 * long intervals in any case, since that can block the bgwriter.
 	 */
+	MarkBufferDirty(metabuf);
 	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
 
 	/*
@@ -453,25 +456,62 @@ _hash_metapinit(Relation rel, double num_tuples, ForkNumber forkNum)
 
 		buf = _hash_getnewbuf(rel, BUCKET_TO_BLKNO(metap, i), forkNum);
 		pg = BufferGetPage(buf);
+
+		START_CRIT_SECTION();
+
 		pageopaque = (HashPageOpaque) PageGetSpecialPointer(pg);
-		pageopaque->hasho_prevblkno = InvalidBlockNumber;
+
+		/*
+		 * Set hasho_prevblkno with current hashm_maxbucket.  This value will
+		 * be used to validate cached HashMetaPageData.  See
+		 * _hash_getbucketbuf_from_hashkey().
+		 */
+		pageopaque->hasho_prevblkno = metap->hashm_maxbucket;
 		pageopaque->hasho_nextblkno = InvalidBlockNumber;
 		pageopaque->hasho_bucket = i;
 		pageopaque->hasho_flag = LH_BUCKET_PAGE;
 		pageopaque->hasho_page_id = HASHO_PAGE_ID;
-		_hash_wrtbuf(rel, buf);
+		MarkBufferDirty(buf);
+
+		if (use_wal)
+			log_newpage_buffer(buf, true);
+
+		END_CRIT_SECTION();
+
+		_hash_relbuf(rel, buf);
 	}
 
 	/* Now reacquire buffer lock on metapage */
 	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
 
 	/*
-	 * Initialize first bitmap page
+	 * Initialize first bitmap page.  It is okay to write-lock it while
+	 * holding metapage write lock, because no one else could be contending
+	 * for the new page.
 	 */
-	_hash_initbitmap(rel, metap, num_buckets + 1, forkNum);
+	bitmapbuf = _hash_getnewbuf(rel, num_buckets + 1, forkNum);
+
+	START_CRIT_SECTION();
+
+	_hash_initbitmapbuffer(bitmapbuf, metap->hashm_bmsize);
+	MarkBufferDirty(bitmapbuf);
+
+	/* add the new bitmap page to the metapage's list of bitmaps */
+	metap->hashm_mapp[metap->hashm_nmaps] = num_buckets + 1;
+	metap->hashm_nmaps++;
+	MarkBufferDirty(metabuf);
+
+	if (use_wal)
+	{
+		log_newpage_buffer(bitmapbuf, true);
+		log_newpage_buffer(metabuf, true);
+	}
+
+	END_CRIT_SECTION();
 
 	/* all done */
-	_hash_wrtbuf(rel, metabuf);
+	_hash_relbuf(rel, bitmapbuf);
+	_hash_relbuf(rel, metabuf);
 
 	return num_buckets;
 }
@@ -489,7 +529,16 @@ _hash_pageinit(Page page, Size size)
 /*
  * Attempt to expand the hash table by creating one new bucket.
  *
- * This will silently do nothing if it cannot get the needed locks.
+ * This will silently do nothing if we don't get cleanup lock on the old
+ * bucket, or if someone else already did the split.
+ *
+ * The split happens in three steps, each of them crash-safe on its own.
+ * First the tuples that belong in the new bucket are copied there, while
+ * the new bucket is still invisible to everyone else.  Then one WAL record
+ * publishes the new bucket in the metapage and flags the old bucket as
+ * needing cleanup.  Finally the copied tuples are deleted from the old
+ * bucket and the flag is cleared.  If we fail or crash partway, the next
+ * attempt to split the old bucket picks up the pieces; see README.
  *
  * The caller should hold no locks on the hash index.
  *
@@ -505,11 +554,18 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 	uint32		spare_ndx;
 	BlockNumber start_oblkno;
 	BlockNumber start_nblkno;
+	Buffer		buf_oblkno;
 	Buffer		buf_nblkno;
+	Page		opage;
+	Page		npage;
+	HashPageOpaque oopaque;
+	HashPageOpaque nopaque;
 	uint32		maxbucket;
 	uint32		highmask;
 	uint32		lowmask;
 
+restart_expand:
+
 	/*
 	 * Write-lock the meta page.  It used to be necessary to acquire a
 	 * heavyweight lock to begin a split, but that is no longer required.
@@ -548,11 +604,15 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 		goto fail;
 
 	/*
-	 * Determine which bucket is to be split, and attempt to lock the old
-	 * bucket.  If we can't get the lock, give up.
+	 * Determine which bucket is to be split, and attempt to take cleanup lock
+	 * on the old bucket.  If we can't get the lock, give up.
 	 *
-	 * The lock protects us against other backends, but not against our own
-	 * backend.  Must check for active scans separately.
+	 * The cleanup lock protects us not only against other backends, but
+	 * against our own backend as well: every scan or insertion in progress
+	 * in the bucket holds a pin on its primary page.
+	 *
+	 * The cleanup lock also serializes splits, since the next split always
+	 * splits this same old bucket until our split has been published.
 	 */
 	new_bucket = metap->hashm_maxbucket + 1;
 
@@ -560,27 +620,46 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 
 	start_oblkno = BUCKET_TO_BLKNO(metap, old_bucket);
 
-	if (_hash_has_active_scan(rel, old_bucket))
+	buf_oblkno = _hash_getbuf_with_condlock_cleanup(rel, start_oblkno,
+													LH_BUCKET_PAGE);
+	if (!BufferIsValid(buf_oblkno))
 		goto fail;
 
-	if (!_hash_try_getlock(rel, start_oblkno, HASH_EXCLUSIVE))
-		goto fail;
+	opage = BufferGetPage(buf_oblkno);
+	oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
 
 	/*
-	 * Likewise lock the new bucket (should never fail).
-	 *
-	 * Note: it is safe to compute the new bucket's blkno here, even though we
-	 * may still need to update the BUCKET_TO_BLKNO mapping.  This is because
-	 * the current value of hashm_spares[hashm_ovflpoint] correctly shows
-	 * where we are going to put a new splitpoint's worth of buckets.
+	 * We want to finish any pending split cleanup of the old bucket before
+	 * splitting it again: the tuples moved away by the previous split must
+	 * be gone before we start moving tuples for the next one.  We don't need
+	 * the metapage lock for that, and VACUUM may be waiting on it, so let it
+	 * go and start over afterwards.
 	 */
-	start_nblkno = BUCKET_TO_BLKNO(metap, new_bucket);
+	if (H_NEEDS_SPLIT_CLEANUP(oopaque))
+	{
+		maxbucket = metap->hashm_maxbucket;
+		highmask = metap->hashm_highmask;
+		lowmask = metap->hashm_lowmask;
+
+		/* Release the metapage lock, but keep the pin. */
+		_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
-	if (_hash_has_active_scan(rel, new_bucket))
-		elog(ERROR, "scan in progress on supposedly new bucket");
+		hashbucketcleanup(rel, old_bucket, buf_oblkno, start_oblkno, NULL,
+						  maxbucket, highmask, lowmask, NULL, NULL, true,
+						  NULL, NULL);
 
-	if (!_hash_try_getlock(rel, start_nblkno, HASH_EXCLUSIVE))
-		elog(ERROR, "could not get lock on supposedly new bucket");
+		_hash_relbuf(rel, buf_oblkno);
+
+		goto restart_expand;
+	}
+
+	/*
+	 * It is safe to compute the new bucket's blkno here, even though we may
+	 * still need to update the BUCKET_TO_BLKNO mapping.  This is because the
+	 * current value of hashm_spares[hashm_ovflpoint] correctly shows where
+	 * we are going to put a new splitpoint's worth of buckets.
+	 */
+	start_nblkno = BUCKET_TO_BLKNO(metap, new_bucket);
 
 	/*
 	 * If the split point is increasing (hashm_maxbucket's log base 2
@@ -600,77 +679,179 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 		if (!_hash_alloc_buckets(rel, start_nblkno, new_bucket))
 		{
 			/* can't split due to BlockNumber overflow */
-			_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
-			_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
+			_hash_relbuf(rel, buf_oblkno);
 			goto fail;
 		}
+
+		/*
+		 * Adjust the hashm_spares[] array and hashm_ovflpoint so that future
+		 * overflow pages will be created beyond this new batch of bucket
+		 * pages.  This doesn't make the new bucket visible yet, so it's fine
+		 * to do it ahead of the split itself; if the split fails, the next
+		 * attempt will find the splitpoint already allocated.
+		 */
+		START_CRIT_SECTION();
+
+		metap->hashm_spares[spare_ndx] = metap->hashm_spares[metap->hashm_ovflpoint];
+		metap->hashm_ovflpoint = spare_ndx;
+
+		MarkBufferDirty(metabuf);
+
+		if (RelationNeedsWAL(rel))
+		{
+			xl_hash_new_splitpoint xlrec;
+			XLogRecPtr	recptr;
+
+			xlrec.ovflpoint = spare_ndx;
+
+			XLogBeginInsert();
+			XLogRegisterData((char *) &xlrec, SizeOfHashNewSplitpoint);
+			XLogRegisterBuffer(0, metabuf, REGBUF_STANDARD);
+
+			recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_NEW_SPLITPOINT);
+
+			PageSetLSN(BufferGetPage(metabuf), recptr);
+		}
+
+		END_CRIT_SECTION();
 	}
 
 	/*
 	 * Physically allocate the new bucket's primary page.  We want to do this
 	 * before changing the metapage's mapping info, in case we can't get the
 	 * disk space.
-	 */
-	buf_nblkno = _hash_getnewbuf(rel, start_nblkno, MAIN_FORKNUM);
-
-	/*
-	 * Okay to proceed with split.  Update the metapage bucket mapping info.
 	 *
-	 * Since we are scribbling on the metapage data right in the shared
-	 * buffer, any failure in this next little bit leaves us with a big
-	 * problem: the metapage is effectively corrupt but could get written back
-	 * to disk.  We don't really expect any failure, but just to be sure,
-	 * establish a critical section.
+	 * The page normally lies inside an allocated splitpoint and has never
+	 * been used.  But an earlier attempt to split into the same bucket might
+	 * have failed while copying tuples, leaving the page half-filled, maybe
+	 * with overflow pages chained to it.  Those must be given back to the
+	 * free space bitmaps before we can start over.  No one else can get to
+	 * the new bucket while it's unpublished, except some other backend
+	 * trying to split the same old bucket, which our lock on the old bucket
+	 * keeps out.
 	 */
-	START_CRIT_SECTION();
+	if (start_nblkno < RelationGetNumberOfBlocks(rel))
+	{
+		buf_nblkno = ReadBuffer(rel, start_nblkno);
+		LockBuffer(buf_nblkno, BUFFER_LOCK_EXCLUSIVE);
+		npage = BufferGetPage(buf_nblkno);
+
+		if (!PageIsNew(npage))
+		{
+			nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
+
+			if ((nopaque->hasho_flag & LH_BUCKET_PAGE) &&
+				nopaque->hasho_bucket == new_bucket &&
+				BlockNumberIsValid(nopaque->hasho_nextblkno))
+			{
+				/* Release the metapage lock, since freeing pages needs it. */
+				_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
-	metap->hashm_maxbucket = new_bucket;
+				while (BlockNumberIsValid(nopaque->hasho_nextblkno))
+				{
+					Buffer		ovflbuf;
 
-	if (new_bucket > metap->hashm_highmask)
+					ovflbuf = _hash_getbuf(rel, nopaque->hasho_nextblkno,
+										   HASH_WRITE, LH_OVERFLOW_PAGE);
+					(void) _hash_freeovflpage(rel, buf_nblkno, ovflbuf,
+											  buf_nblkno, NULL, 0, NULL);
+				}
+
+				_hash_relbuf(rel, buf_nblkno);
+				_hash_relbuf(rel, buf_oblkno);
+
+				goto restart_expand;
+			}
+
+			MemSet(npage, 0, BufferGetPageSize(buf_nblkno));
+		}
+
+		_hash_pageinit(npage, BufferGetPageSize(buf_nblkno));
+	}
+	else
+		buf_nblkno = _hash_getnewbuf(rel, start_nblkno, MAIN_FORKNUM);
+
+	/*
+	 * Compute the bucket mapping as it will be once the split is published.
+	 * This saves re-accessing the meta page inside _hash_splitbucket's inner
+	 * loop.  No one else can change the mapping meanwhile, because any other
+	 * split would need the lock we hold on the old bucket.
+	 */
+	maxbucket = new_bucket;
+	highmask = metap->hashm_highmask;
+	lowmask = metap->hashm_lowmask;
+	if (new_bucket > highmask)
 	{
 		/* Starting a new doubling */
-		metap->hashm_lowmask = metap->hashm_highmask;
-		metap->hashm_highmask = new_bucket | metap->hashm_lowmask;
+		lowmask = highmask;
+		highmask = new_bucket | lowmask;
 	}
 
+	/* Release the metapage lock, but keep the pin, while copying tuples */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+
+	/* Copy the tuples that belong in the new bucket there */
+	_hash_splitbucket(rel, metabuf,
+					  old_bucket, new_bucket,
+					  buf_oblkno, buf_nblkno,
+					  maxbucket, highmask, lowmask);
+
 	/*
-	 * If the split point is increasing (hashm_maxbucket's log base 2
-	 * increases), we need to adjust the hashm_spares[] array and
-	 * hashm_ovflpoint so that future overflow pages will be created beyond
-	 * this new batch of bucket pages.
+	 * Okay, the new bucket is complete.  Publish it, and flag the old bucket
+	 * as still holding the tuples that were moved.  This also sets the old
+	 * bucket's hasho_prevblkno to the new maxbucket, which is how backends
+	 * using a cached metapage find out that they must refresh their cache
+	 * before trusting it with this bucket.
 	 */
-	if (spare_ndx > metap->hashm_ovflpoint)
+	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
+
+	START_CRIT_SECTION();
+
+	metap->hashm_maxbucket = maxbucket;
+	metap->hashm_highmask = highmask;
+	metap->hashm_lowmask = lowmask;
+	MarkBufferDirty(metabuf);
+
+	oopaque->hasho_prevblkno = maxbucket;
+	oopaque->hasho_flag |= LH_BUCKET_NEEDS_SPLIT_CLEANUP;
+	MarkBufferDirty(buf_oblkno);
+
+	if (RelationNeedsWAL(rel))
 	{
-		metap->hashm_spares[spare_ndx] = metap->hashm_spares[metap->hashm_ovflpoint];
-		metap->hashm_ovflpoint = spare_ndx;
+		xl_hash_split_complete xlrec;
+		XLogRecPtr	recptr;
+
+		xlrec.maxbucket = maxbucket;
+		xlrec.highmask = highmask;
+		xlrec.lowmask = lowmask;
+		xlrec.old_bucket_flag = oopaque->hasho_flag;
+
+		XLogBeginInsert();
+		XLogRegisterData((char *) &xlrec, SizeOfHashSplitComplete);
+		XLogRegisterBuffer(0, buf_oblkno, REGBUF_STANDARD);
+		XLogRegisterBuffer(1, metabuf, REGBUF_STANDARD);
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_SPLIT_COMPLETE);
+
+		PageSetLSN(opage, recptr);
+		PageSetLSN(BufferGetPage(metabuf), recptr);
 	}
 
-	/* Done mucking with metapage */
 	END_CRIT_SECTION();
 
+	/* Done mucking with metapage */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+
 	/*
-	 * Copy bucket mapping info now; this saves re-accessing the meta page
-	 * inside _hash_splitbucket's inner loop.  Note that once we drop the
-	 * split lock, other splits could begin, so these values might be out of
-	 * date before _hash_splitbucket finishes.  That's okay, since all it
-	 * needs is to tell which of these two buckets to map hashkeys into.
+	 * Finally remove the moved tuples from the old bucket.  We've held the
+	 * old bucket's primary page locked all along, so no one can have entered
+	 * the bucket since we got our cleanup lock, and the lock still serves.
 	 */
-	maxbucket = metap->hashm_maxbucket;
-	highmask = metap->hashm_highmask;
-	lowmask = metap->hashm_lowmask;
+	hashbucketcleanup(rel, old_bucket, buf_oblkno, start_oblkno, NULL,
+					  maxbucket, highmask, lowmask, NULL, NULL, true,
+					  NULL, NULL);
 
-	/* Write out the metapage and drop lock, but keep pin */
-	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
-
-	/* Relocate records to the new bucket */
-	_hash_splitbucket(rel, metabuf,
-					  old_bucket, new_bucket,
-					  start_oblkno, buf_nblkno,
-					  maxbucket, highmask, lowmask);
-
-	/* Release bucket locks, allowing others to access them */
-	_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
-	_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
+	_hash_relbuf(rel, buf_oblkno);
 
 	return;
 
@@ -697,8 +878,11 @@ fail:
  * than if we forced it all to be allocated now; but since we don't scan
  * hash indexes sequentially anyway, that probably doesn't matter.
  *
+ * The page we write is initialized as an unused hash page and WAL-logged, so
+ * that WAL replay extends the relation the same way.
+ *
  * XXX It's annoying that this code is executed with the metapage lock held.
- * We need to interlock against _hash_getovflpage() adding a new overflow page
+ * We need to interlock against _hash_addovflpage() adding a new overflow page
  * concurrently, but it'd likely be better to use LockRelationForExtension
  * for the purpose.  OTOH, adding a splitpoint is a very infrequent operation,
  * so it may not be worth worrying about.
@@ -710,7 +894,8 @@ static bool
 _hash_alloc_buckets(Relation rel, BlockNumber firstblock, uint32 nblocks)
 {
 	BlockNumber lastblock;
-	char		zerobuf[BLCKSZ];
+	Page		page;
+	HashPageOpaque ovflopaque;
 
 	lastblock = firstblock + nblocks - 1;
 
@@ -721,85 +906,101 @@ _hash_alloc_buckets(Relation rel, BlockNumber firstblock, uint32 nblocks)
 	if (lastblock < firstblock || lastblock == InvalidBlockNumber)
 		return false;
 
-	MemSet(zerobuf, 0, sizeof(zerobuf));
+	page = (Page) palloc0(BLCKSZ);
+
+	_hash_pageinit(page, BLCKSZ);
+
+	ovflopaque = (HashPageOpaque) PageGetSpecialPointer(page);
+
+	ovflopaque->hasho_prevblkno = InvalidBlockNumber;
+	ovflopaque->hasho_nextblkno = InvalidBlockNumber;
+	ovflopaque->hasho_bucket = -1;
+	ovflopaque->hasho_flag = LH_UNUSED_PAGE;
+	ovflopaque->hasho_page_id = HASHO_PAGE_ID;
+
+	if (RelationNeedsWAL(rel))
+		log_newpage(&rel->rd_node, MAIN_FORKNUM, lastblock, page, true);
+
+	PageSetChecksumInplace(page, lastblock);
 
 	RelationOpenSmgr(rel);
-	smgrextend(rel->rd_smgr, MAIN_FORKNUM, lastblock, zerobuf, false);
+	smgrextend(rel->rd_smgr, MAIN_FORKNUM, lastblock, (char *) page, false);
+
+	pfree(page);
 
 	return true;
 }
 
 
 /*
- * _hash_splitbucket -- split 'obucket' into 'obucket' and 'nbucket'
+ * _hash_splitbucket -- copy the 'nbucket' tuples out of 'obucket'
  *
  * We are splitting a bucket that consists of a base bucket page and zero
- * or more overflow (bucket chain) pages.  We must relocate tuples that
- * belong in the new bucket, and compress out any free space in the old
- * bucket.
+ * or more overflow (bucket chain) pages.  We copy the tuples that belong in
+ * the new bucket under the new mapping there; the caller removes them from
+ * the old bucket once the split has been published.
  *
- * The caller must hold exclusive locks on both buckets to ensure that
- * no one else is trying to access them (see README).
+ * The new bucket isn't visible to anyone else yet, so its pages are filled
+ * without any particular care for concurrency, and each one is WAL-logged as
+ * a full page image once it's full.
  *
  * The caller must hold a pin, but no lock, on the metapage buffer.
  * The buffer is returned in the same state.  (The metapage is only
- * touched if it becomes necessary to add or remove overflow pages.)
+ * touched if it becomes necessary to add overflow pages.)
  *
- * In addition, the caller must have created the new bucket's base page,
- * which is passed in buffer nbuf, pinned and write-locked.  That lock and
- * pin are released here.  (The API is set up this way because we must do
- * _hash_getnewbuf() before releasing the metapage write lock.  So instead of
- * passing the new bucket's start block number, we pass an actual buffer.)
+ * 'obuf' is the old bucket's primary page, on which the caller holds a
+ * cleanup lock; it's returned in the same state.  The caller must also have
+ * initialized the new bucket's primary page, which is passed in buffer nbuf,
+ * pinned and write-locked.  That lock and pin are released here.
  */
 static void
 _hash_splitbucket(Relation rel,
 				  Buffer metabuf,
 				  Bucket obucket,
 				  Bucket nbucket,
-				  BlockNumber start_oblkno,
+				  Buffer obuf,
 				  Buffer nbuf,
 				  uint32 maxbucket,
 				  uint32 highmask,
 				  uint32 lowmask)
 {
-	Buffer		obuf;
+	Buffer		bucket_obuf = obuf;
 	Page		opage;
 	Page		npage;
 	HashPageOpaque oopaque;
 	HashPageOpaque nopaque;
+	IndexTuple	itups[MaxIndexTuplesPerPage];
+	Size		all_tups_size = 0;
+	int			nitups = 0;
+	int			i;
 
-	/*
-	 * It should be okay to simultaneously write-lock pages from each bucket,
-	 * since no one else can be trying to acquire buffer lock on pages of
-	 * either bucket.
-	 */
-	obuf = _hash_getbuf(rel, start_oblkno, HASH_WRITE, LH_BUCKET_PAGE);
 	opage = BufferGetPage(obuf);
 	oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
 
 	npage = BufferGetPage(nbuf);
 
-	/* initialize the new bucket's primary page */
+	/*
+	 * Initialize the new bucket's primary page.  Its hasho_prevblkno records
+	 * the maxbucket the bucket is created with, for the benefit of cached
+	 * metapages; see _hash_getbucketbuf_from_hashkey().
+	 */
 	nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
-	nopaque->hasho_prevblkno = InvalidBlockNumber;
+	nopaque->hasho_prevblkno = maxbucket;
 	nopaque->hasho_nextblkno = InvalidBlockNumber;
 	nopaque->hasho_bucket = nbucket;
 	nopaque->hasho_flag = LH_BUCKET_PAGE;
 	nopaque->hasho_page_id = HASHO_PAGE_ID;
 
 	/*
-	 * Partition the tuples in the old bucket between the old bucket and the
-	 * new bucket, advancing along the old bucket's overflow bucket chain and
-	 * adding overflow pages to the new bucket as needed.  Outer loop iterates
-	 * once per page in old bucket.
+	 * Copy the tuples that belong in the new bucket, advancing along the old
+	 * bucket's overflow bucket chain and adding overflow pages to the new
+	 * bucket as needed.  Outer loop iterates once per page in old bucket.
 	 */
 	for (;;)
 	{
 		BlockNumber oblkno;
 		OffsetNumber ooffnum;
 		OffsetNumber omaxoffnum;
-		OffsetNumber deletable[MaxOffsetNumber];
-		int			ndeletable = 0;
 
 		/* Scan each tuple in old page */
 		omaxoffnum = PageGetMaxOffsetNumber(opage);
@@ -823,41 +1024,42 @@ _hash_splitbucket(Relation rel,
 			if (bucket == nbucket)
 			{
 				/*
-				 * insert the tuple into the new bucket.  if it doesn't fit on
-				 * the current page in the new bucket, we must allocate a new
-				 * overflow page and place the tuple on that page instead.
-				 *
-				 * XXX we have a problem here if we fail to get space for a
-				 * new overflow page: we'll error out leaving the bucket split
-				 * only partially complete, meaning the index is corrupt,
-				 * since searches may fail to find entries they should find.
+				 * Collect the tuple for the current page of the new bucket.
+				 * If it doesn't fit there along with the tuples collected
+				 * already, write those out and chain to a new overflow page.
 				 */
 				itemsz = IndexTupleDSize(*itup);
 				itemsz = MAXALIGN(itemsz);
 
-				if (PageGetFreeSpace(npage) < itemsz)
+				if (PageGetFreeSpaceForMultipleTuples(npage, nitups + 1) <
+					(all_tups_size + itemsz))
 				{
-					/* write out nbuf and drop lock, but keep pin */
-					_hash_chgbufaccess(rel, nbuf, HASH_WRITE, HASH_NOLOCK);
+					START_CRIT_SECTION();
+
+					_hash_pgaddmultitup(rel, nbuf, itups, nitups);
+					MarkBufferDirty(nbuf);
+
+					if (RelationNeedsWAL(rel))
+						log_newpage_buffer(nbuf, true);
+
+					END_CRIT_SECTION();
+
+					/* drop lock, but keep pin until the page is chained */
+					_hash_chgbufaccess(rel, nbuf, HASH_READ, HASH_NOLOCK);
+
+					/* be tidy */
+					for (i = 0; i < nitups; i++)
+						pfree(itups[i]);
+					nitups = 0;
+					all_tups_size = 0;
+
 					/* chain to a new overflow page */
-					nbuf = _hash_addovflpage(rel, metabuf, nbuf);
+					nbuf = _hash_addovflpage(rel, metabuf, nbuf, false);
 					npage = BufferGetPage(nbuf);
-					/* we don't need nopaque within the loop */
 				}
 
-				/*
-				 * Insert tuple on new page, using _hash_pgaddtup to ensure
-				 * correct ordering by hashkey.  This is a tad inefficient
-				 * since we may have to shuffle itempointers repeatedly.
-				 * Possible future improvement: accumulate all the items for
-				 * the new page and qsort them before insertion.
-				 */
-				(void) _hash_pgaddtup(rel, nbuf, itemsz, itup);
-
-				/*
-				 * Mark tuple for deletion from old page.
-				 */
-				deletable[ndeletable++] = ooffnum;
+				itups[nitups++] = CopyIndexTuple(itup);
+				all_tups_size += itemsz;
 			}
 			else
 			{
@@ -870,16 +1072,8 @@ _hash_splitbucket(Relation rel,
 
 		oblkno = oopaque->hasho_nextblkno;
 
-		/*
-		 * Done scanning this old page.  If we moved any tuples, delete them
-		 * from the old page.
-		 */
-		if (ndeletable > 0)
-		{
-			PageIndexMultiDelete(opage, deletable, ndeletable);
-			_hash_wrtbuf(rel, obuf);
-		}
-		else
+		/* retain the lock on the primary bucket page */
+		if (obuf != bucket_obuf)
 			_hash_relbuf(rel, obuf);
 
 		/* Exit loop if no more overflow pages in old bucket */
@@ -887,18 +1081,226 @@ _hash_splitbucket(Relation rel,
 			break;
 
 		/* Else, advance to next old page */
-		obuf = _hash_getbuf(rel, oblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
+		obuf = _hash_getbuf(rel, oblkno, HASH_READ, LH_OVERFLOW_PAGE);
 		opage = BufferGetPage(obuf);
 		oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
 	}
 
 	/*
 	 * We're at the end of the old bucket chain, so we're done partitioning
-	 * the tuples.  Before quitting, call _hash_squeezebucket to ensure the
-	 * tuples remaining in the old bucket (including the overflow pages) are
-	 * packed as tightly as possible.  The new bucket is already tight.
+	 * the tuples.  Write out the last page of the new bucket; we log it even
+	 * if it's empty, since it may be the new primary page.
 	 */
-	_hash_wrtbuf(rel, nbuf);
+	START_CRIT_SECTION();
+
+	_hash_pgaddmultitup(rel, nbuf, itups, nitups);
+	MarkBufferDirty(nbuf);
+
+	if (RelationNeedsWAL(rel))
+		log_newpage_buffer(nbuf, true);
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, nbuf);
+
+	for (i = 0; i < nitups; i++)
+		pfree(itups[i]);
+}
+
+
+/*
+ *	_hash_getcachedmetap() -- Returns cached metapage data.
+ *
+ *	If metabuf is not InvalidBuffer, caller must hold a pin, but no lock, on
+ *	the metapage.  If not set, we'll set it before returning if we have to
+ *	refresh the cache, and return with a pin but no lock on it; caller is
+ *	responsible for releasing the pin.
+ *
+ *	We refresh the cache if it's not initialized yet or force_refresh is true.
+ */
+HashMetaPage
+_hash_getcachedmetap(Relation rel, Buffer *metabuf, bool force_refresh)
+{
+	Page		page;
+
+	Assert(metabuf);
+	if (force_refresh || rel->rd_amcache == NULL)
+	{
+		char	   *cache = NULL;
+
+		/*
+		 * It's important that we don't set rd_amcache to an invalid value.
+		 * Either MemoryContextAlloc or _hash_getbuf could fail, so don't
+		 * install a pointer to the newly-allocated storage in the actual
+		 * relcache entry until both have succeeded.
+		 */
+		if (rel->rd_amcache == NULL)
+			cache = (char *) MemoryContextAlloc(rel->rd_indexcxt,
+												sizeof(HashMetaPageData));
+
+		/* Read the metapage. */
+		if (BufferIsValid(*metabuf))
+			_hash_chgbufaccess(rel, *metabuf, HASH_NOLOCK, HASH_READ);
+		else
+			*metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_READ,
+									LH_META_PAGE);
+		page = BufferGetPage(*metabuf);
+
+		/* Populate the cache. */
+		if (rel->rd_amcache == NULL)
+			rel->rd_amcache = cache;
+		memcpy(rel->rd_amcache, HashPageGetMeta(page),
+			   sizeof(HashMetaPageData));
+
+		/* Release metapage lock, but keep the pin. */
+		_hash_chgbufaccess(rel, *metabuf, HASH_READ, HASH_NOLOCK);
+	}
+
+	return (HashMetaPage) rel->rd_amcache;
+}
+
+/*
+ *	_hash_getbucketbuf_from_hashkey() -- Get the bucket's buffer for the given
+ *										 hashkey.
+ *
+ *	Bucket pages do not move or get removed once they are allocated.  This
+ *	gives us an opportunity to use the previously saved metapage contents to
+ *	reach the target bucket buffer, instead of reading from the metapage
+ *	every time.  This saves one buffer access every time we want to reach
+ *	the target bucket buffer, which is a very helpful savings in bufmgr
+ *	traffic and contention.
+ *
+ *	The cached copy is stale if the bucket has been split since it was
+ *	taken.  We can tell, because a split stores the new hashm_maxbucket in
+ *	the old bucket's hasho_prevblkno; if that's larger than the cached
+ *	maxbucket, we refresh the cache and try again.
+ *
+ *	The access type parameter (HASH_READ or HASH_WRITE) indicates whether the
+ *	bucket buffer has to be locked for reading or writing.
+ *
+ *	The out parameter cachedmetap is set with metapage contents used for
+ *	hashkey to bucket buffer mapping, if the caller wants it.
+ */
+Buffer
+_hash_getbucketbuf_from_hashkey(Relation rel, uint32 hashkey, int access,
+								HashMetaPage *cachedmetap)
+{
+	HashMetaPage metap;
+	Buffer		buf;
+	Buffer		metabuf = InvalidBuffer;
+	Page		page;
+	Bucket		bucket;
+	BlockNumber blkno;
+	HashPageOpaque opaque;
+
+	/* We read from target bucket buffer, hence locking is must. */
+	Assert(access == HASH_READ || access == HASH_WRITE);
+
+	metap = _hash_getcachedmetap(rel, &metabuf, false);
+	Assert(metap != NULL);
+
+	/*
+	 * Loop until we get a lock on the correct target bucket.
+	 */
+	for (;;)
+	{
+		/*
+		 * Compute the target bucket number, and convert to block number.
+		 */
+		bucket = _hash_hashkey2bucket(hashkey,
+									  metap->hashm_maxbucket,
+									  metap->hashm_highmask,
+									  metap->hashm_lowmask);
+
+		blkno = BUCKET_TO_BLKNO(metap, bucket);
+
+		/* Fetch the primary bucket page for the bucket */
+		buf = _hash_getbuf(rel, blkno, access, LH_BUCKET_PAGE);
+		page = BufferGetPage(buf);
+		opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+		Assert(opaque->hasho_bucket == bucket);
+
+		/*
+		 * If this bucket hasn't been split, we're done.
+		 */
+		if (opaque->hasho_prevblkno <= metap->hashm_maxbucket)
+			break;
+
+		/* Drop lock on this buffer, update cached metapage, and retry. */
+		_hash_relbuf(rel, buf);
+		metap = _hash_getcachedmetap(rel, &metabuf, true);
+		Assert(metap != NULL);
+	}
+
+	if (BufferIsValid(metabuf))
+		_hash_dropbuf(rel, metabuf);
+
+	if (cachedmetap)
+		*cachedmetap = metap;
+
+	return buf;
+}
+
+/*
+ *	_hash_logpages() -- WAL-log a change to several pages as full images.
+ *
+ * This is how the overflow page operations are logged, since they change
+ * too many pages at once (the bucket chain neighbours, a bitmap page and the
+ * metapage) to be worth describing piecemeal.  'bufs' holds the changed
+ * pages; invalid and duplicate entries are ignored.  'bucketbuf', if valid,
+ * is the primary page of the bucket being reorganized: redo takes a cleanup
+ * lock on it first, to wait out hot standby scans of the bucket.  It's
+ * logged as an image only if it also appears in 'bufs'.
+ *
+ * Must be called in the caller's critical section, with every buffer
+ * exclusively locked and already marked dirty, and after
+ * XLogEnsureRecordSpace() if more than XLR_NORMAL_MAX_BLOCK_ID blocks could
+ * be registered.  Sets the LSN of all the changed pages.
+ */
+void
+_hash_logpages(uint8 info, Buffer bucketbuf, Buffer *bufs, int nbufs)
+{
+	Buffer		logged[HASH_XLOG_MAX_PAGES];
+	int			nlogged = 0;
+	bool		bucket_changed = false;
+	XLogRecPtr	recptr;
+	int			i,
+				j;
+
+	XLogBeginInsert();
+
+	for (i = 0; i < nbufs; i++)
+	{
+		if (!BufferIsValid(bufs[i]))
+			continue;
+		if (bufs[i] == bucketbuf)
+		{
+			bucket_changed = true;
+			continue;
+		}
+		for (j = 0; j < nlogged; j++)
+		{
+			if (logged[j] == bufs[i])
+				break;
+		}
+		if (j < nlogged)
+			continue;
+
+		Assert(nlogged < HASH_XLOG_MAX_PAGES - 1);
+		logged[nlogged++] = bufs[i];
+		XLogRegisterBuffer(nlogged, bufs[i],
+						   REGBUF_STANDARD | REGBUF_FORCE_IMAGE);
+	}
+
+	if (BufferIsValid(bucketbuf))
+		XLogRegisterBuffer(0, bucketbuf,
+						   REGBUF_STANDARD |
+						   (bucket_changed ? REGBUF_FORCE_IMAGE : REGBUF_NO_IMAGE));
+
+	recptr = XLogInsert(RM_HASH_ID, info);
 
-	_hash_squeezebucket(rel, obucket, start_oblkno, NULL);
+	for (j = 0; j < nlogged; j++)
+		PageSetLSN(BufferGetPage(logged[j]), recptr);
+	if (bucket_changed)
+		PageSetLSN(BufferGetPage(bucketbuf), recptr);
 }
@@ -0,0 +1,77 @@
+/*-------------------------------------------------------------------------
+ *
+ * heapam_handler.c
+ *	  heap table access method code
+ *
+ * The heap is the table access method of every table created without a
+ * USING clause.  Its callbacks are simply the heapam.c routines.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/heap/heapam_handler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/tableam.h"
+#include "commands/vacuum.h"
+#include "storage/bufmgr.h"
+#include "utils/builtins.h"
+
+
+/*
+ * ANALYZE samples heaps block by block, see acquire_sample_rows.
+ */
+static bool
+heapam_relation_analyze(Relation rel, AcquireSampleRowsFunc *func,
+						BlockNumber *totalpages)
+{
+	*func = acquire_sample_rows;
+	*totalpages = RelationGetNumberOfBlocks(rel);
+	return true;
+}
+
+/*
+ * GetHeapamTableAmRoutine - build the TableAmRoutine of the heap
+ */
+TableAmRoutine *
+GetHeapamTableAmRoutine(void)
+{
+	TableAmRoutine *routine = makeNode(TableAmRoutine);
+
+	routine->scan_begin = heap_beginscan;
+	routine->scan_getnext = heap_getnext;
+	routine->scan_rescan = heap_rescan;
+	routine->scan_end = heap_endscan;
+
+	routine->tuple_fetch = heap_fetch;
+	routine->tuple_get_latest_tid = heap_get_latest_tid;
+	routine->tuple_insert = heap_insert;
+	routine->multi_insert = heap_multi_insert;
+	routine->tuple_delete = heap_delete;
+	routine->tuple_update = heap_update;
+	routine->tuple_lock = heap_lock_tuple;
+
+	routine->relation_sync = heap_sync;
+	routine->relation_vacuum = lazy_vacuum_rel;
+	routine->relation_analyze = heapam_relation_analyze;
+	/* the planner's default size estimate is the heap's */
+	routine->relation_estimate_size = NULL;
+
+	return routine;
+}
+
+/*
+ * heap_tableam_handler - SQL-callable handler of the heap, for
+ * CREATE TABLE ... USING heap
+ */
+Datum
+heap_tableam_handler(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(GetHeapamTableAmRoutine());
+}
@@ -74,17 +74,19 @@ RelationPutHeapTuple(Relation relation,
 }
 
 /*
- * Read in a buffer, using bulk-insert strategy if bistate isn't NULL.
+ * Read in a buffer in some mode, using bulk-insert strategy if bistate isn't
+ * NULL.
  */
 static Buffer
 ReadBufferBI(Relation relation, BlockNumber targetBlock,
-			 BulkInsertState bistate)
+			 ReadBufferMode mode, BulkInsertState bistate)
 {
 	Buffer		buffer;
 
 	/* If not bulk-insert, exactly like ReadBuffer */
 	if (!bistate)
-		return ReadBuffer(relation, targetBlock);
+		return ReadBufferExtended(relation, MAIN_FORKNUM, targetBlock,
+								  mode, NULL);
 
 	/* If we have the desired block already pinned, re-pin and return it */
 	if (bistate->current_buf != InvalidBuffer)
@@ -101,7 +103,7 @@ ReadBufferBI(Relation relation, BlockNumber targetBlock,
 
 	/* Perform a read using the buffer strategy */
 	buffer = ReadBufferExtended(relation, MAIN_FORKNUM, targetBlock,
-								RBM_NORMAL, bistate->strategy);
+								mode, bistate->strategy);
 
 	/* Save the selected block as target for future inserts */
 	IncrBufferRefCount(buffer);
@@ -168,6 +170,109 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
 	}
 }
 
+/*
+ * Extend a relation by multiple blocks to avoid future contention on the
+ * relation extension lock.  Our goal is to pre-extend the relation by an
+ * amount which ramps up as the degree of contention ramps up, but limiting
+ * the result to some sane overall value.  The new pages are initialized
+ * and entered into the FSM, where the waiting backends will find them.
+ *
+ * Caller must hold the relation extension lock.
+ */
+static void
+RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
+{
+	BlockNumber firstBlock;
+	BlockNumber blockNum;
+	int			extraBlocks;
+	int			lockWaiters;
+	Size		freespace = 0;
+
+	/* Use the length of the lock wait queue to judge how much to extend. */
+	lockWaiters = RelationExtensionLockWaiterCount(relation);
+	if (lockWaiters <= 0)
+		return;
+
+	/*
+	 * It might seem like multiplying the number of lock waiters by as much
+	 * as 20 is too aggressive, but each waiter would otherwise take the lock
+	 * for one page, and then be back for another soon after.  512 is just an
+	 * arbitrary cap to prevent pathological results.
+	 */
+	extraBlocks = Min(512, lockWaiters * 20);
+
+	/* Extend the file by all the blocks at once */
+	firstBlock = RelationGetNumberOfBlocks(relation);
+	RelationOpenSmgr(relation);
+	smgrzeroextend(relation->rd_smgr, MAIN_FORKNUM, firstBlock, extraBlocks,
+				   false);
+
+	/*
+	 * Initialize the pages in shared buffers, without reading them, since
+	 * we know they're zeroes.  Like the single page we add below, this isn't
+	 * WAL-logged; after a crash, VACUUM initializes any page left empty.
+	 */
+	for (blockNum = firstBlock; blockNum < firstBlock + extraBlocks; blockNum++)
+	{
+		Buffer		buffer;
+		Page		page;
+
+		buffer = ReadBufferExtended(relation, MAIN_FORKNUM, blockNum,
+									RBM_ZERO_AND_LOCK,
+									bistate ? bistate->strategy : NULL);
+		page = BufferGetPage(buffer);
+		PageInit(page, BufferGetPageSize(buffer), 0);
+		freespace = PageGetHeapFreeSpace(page);
+		MarkBufferDirty(buffer);
+		UnlockReleaseBuffer(buffer);
+	}
+
+	/*
+	 * Updating the upper levels of the free space map is too expensive to do
+	 * for every block, but it's worth doing once at the end to make sure that
+	 * subsequent insertion activity sees all of those nifty free pages we
+	 * just inserted.
+	 */
+	UpdateFreeSpaceMap(relation, firstBlock, firstBlock + extraBlocks - 1,
+					   freespace);
+}
+
+/*
+ * Extend a temporary relation for a bulk insert by several blocks at once,
+ * and remember them in bistate for RelationGetBufferForTuple to use one by
+ * one.
+ *
+ * Other backends can't be waiting for a temporary relation, so this isn't
+ * RelationAddExtraBlocks' business; the point here is to save system calls.
+ * Adding blocks one at a time costs a lseek and a write of zeroes for each
+ * of them, before the block is filled and, eventually, written again.  We
+ * add a quarter of what this bulk insert has added so far, so the blocks
+ * left unused at its end are never much of the total, up to 512 blocks at a
+ * time.  Those are left all zeroes, which VACUUM and scans cope with.
+ */
+static void
+RelationAddLocalBlocks(Relation relation, BulkInsertState bistate)
+{
+	BlockNumber firstBlock;
+	uint32		extendBy;
+
+	extendBy = Min(512, Max(1, bistate->already_extended_by / 4));
+
+	RelationOpenSmgr(relation);
+	firstBlock = smgrnblocks(relation->rd_smgr, MAIN_FORKNUM);
+
+	/* don't run into the limit on the file size any sooner than we must */
+	if (firstBlock < MaxBlockNumber)
+		extendBy = Min(extendBy, MaxBlockNumber - firstBlock);
+
+	smgrzeroextend(relation->rd_smgr, MAIN_FORKNUM, firstBlock,
+				   (int) extendBy, false);
+
+	bistate->next_free = firstBlock;
+	bistate->last_free = firstBlock + extendBy - 1;
+	bistate->already_extended_by += extendBy;
+}
+
 /*
  * RelationGetBufferForTuple
  *
@@ -308,6 +413,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 		}
 	}
 
+loop:
 	while (targetBlock != InvalidBlockNumber)
 	{
 		/*
@@ -326,7 +432,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 		if (otherBuffer == InvalidBuffer)
 		{
 			/* easy case */
-			buffer = ReadBufferBI(relation, targetBlock, bistate);
+			buffer = ReadBufferBI(relation, targetBlock, RBM_NORMAL, bistate);
 			if (PageIsAllVisible(BufferGetPage(buffer)))
 				visibilitymap_pin(relation, targetBlock, vmbuffer);
 			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
@@ -437,19 +543,61 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	 * same time, else we will both try to initialize the same new page.  We
 	 * can skip locking for new or temp relations, however, since no one else
 	 * could be accessing them.
+	 *
+	 * If we have to wait for the lock, others are extending the relation as
+	 * well, so once we have it we add extra pages for everyone waiting (see
+	 * RelationAddExtraBlocks).  But first we check whether somebody who had
+	 * the lock before us already added a page we can use.
 	 */
 	needLock = !RELATION_IS_LOCAL(relation);
 
 	if (needLock)
-		LockRelationForExtension(relation, ExclusiveLock);
+	{
+		if (!use_fsm)
+			LockRelationForExtension(relation, ExclusiveLock);
+		else if (!ConditionalLockRelationForExtension(relation, ExclusiveLock))
+		{
+			/* Couldn't get the lock immediately; wait for it. */
+			LockRelationForExtension(relation, ExclusiveLock);
+
+			targetBlock = GetPageWithFreeSpace(relation, len + saveFreeSpace);
+			if (targetBlock != InvalidBlockNumber)
+			{
+				UnlockRelationForExtension(relation, ExclusiveLock);
+				goto loop;
+			}
+
+			/* Time to bulk-extend. */
+			RelationAddExtraBlocks(relation, bistate);
+		}
+	}
 
-	/*
-	 * XXX This does an lseek - rather expensive - but at the moment it is the
-	 * only way to accurately determine how many blocks are in a relation.  Is
-	 * it worth keeping an accurate file length in shared memory someplace,
-	 * rather than relying on the kernel to do it for us?
-	 */
-	buffer = ReadBufferBI(relation, P_NEW, bistate);
+	if (bistate && RelationUsesLocalBuffers(relation))
+	{
+		/*
+		 * A bulk insert into a temporary relation takes the next block that
+		 * RelationAddLocalBlocks added, adding some first if there are none
+		 * left.  The block is known to be all zeroes, so don't read it.
+		 */
+		if (bistate->next_free == InvalidBlockNumber)
+			RelationAddLocalBlocks(relation, bistate);
+
+		buffer = ReadBufferBI(relation, bistate->next_free,
+							  RBM_ZERO_AND_LOCK, bistate);
+
+		if (bistate->next_free == bistate->last_free)
+			bistate->next_free = bistate->last_free = InvalidBlockNumber;
+		else
+			bistate->next_free++;
+	}
+	else
+	{
+		/*
+		 * This finds the size with smgrnblocks, which is usually answered
+		 * from the shared relation size table rather than by an lseek.
+		 */
+		buffer = ReadBufferBI(relation, P_NEW, RBM_NORMAL, bistate);
+	}
 
 	/*
 	 * We can be certain that locking the otherBuffer first is OK, since it
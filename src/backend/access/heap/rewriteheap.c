@@ -648,10 +648,19 @@ raw_heap_insert(RewriteState state, HeapTuple tup)
 		heaptup = tup;
 	}
 	else if (HeapTupleHasExternal(tup) || tup->t_len > TOAST_TUPLE_THRESHOLD)
+	{
+		/*
+		 * A parallel CLUSTER writes while its workers are still sending it
+		 * sorted tuples.  Only we insert toast rows, under a command ID that
+		 * was marked used before the workers started.
+		 */
 		heaptup = toast_insert_or_update(state->rs_new_rel, tup, NULL,
 										 HEAP_INSERT_SKIP_FSM |
 										 (state->rs_use_wal ?
-										  0 : HEAP_INSERT_SKIP_WAL));
+										  0 : HEAP_INSERT_SKIP_WAL) |
+										 (IsInParallelMode() ?
+										  HEAP_INSERT_PARALLEL : 0));
+	}
 	else
 		heaptup = tup;
 
@@ -29,6 +29,9 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
 
 #include "access/genam.h"
 #include "access/heapam.h"
@@ -36,9 +39,13 @@
 #include "access/xact.h"
 #include "catalog/catalog.h"
 #include "common/pg_lzcompress.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 #include "utils/expandeddatum.h"
 #include "utils/fmgroids.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/typcache.h"
 #include "utils/tqual.h"
@@ -52,7 +59,8 @@
 typedef struct toast_compress_header
 {
 	int32		vl_len_;		/* varlena header (do not touch directly!) */
-	int32		rawsize;
+	uint32		tcinfo;			/* 2 bits for compression method and 30 bits
+								 * rawsize */
 } toast_compress_header;
 
 /*
@@ -60,11 +68,64 @@ typedef struct toast_compress_header
  * toast entries.
  */
 #define TOAST_COMPRESS_HDRSZ		((int32) sizeof(toast_compress_header))
-#define TOAST_COMPRESS_RAWSIZE(ptr) (((toast_compress_header *) (ptr))->rawsize)
+#define TOAST_COMPRESS_RAWSIZE(ptr) \
+	((int32) (((toast_compress_header *) (ptr))->tcinfo & VARLENA_EXTSIZE_MASK))
+#define TOAST_COMPRESS_METHOD(ptr) \
+	((ToastCompressionId) (((toast_compress_header *) (ptr))->tcinfo >> \
+						   VARLENA_EXTSIZE_BITS))
 #define TOAST_COMPRESS_RAWDATA(ptr) \
 	(((char *) (ptr)) + TOAST_COMPRESS_HDRSZ)
-#define TOAST_COMPRESS_SET_RAWSIZE(ptr, len) \
-	(((toast_compress_header *) (ptr))->rawsize = (len))
+#define TOAST_COMPRESS_SET_SIZE_AND_COMPRESS_METHOD(ptr, len, cm_method) \
+	do { \
+		Assert((len) > 0 && (len) <= VARLENA_EXTSIZE_MASK); \
+		Assert((cm_method) == TOAST_PGLZ_COMPRESSION_ID || \
+			   (cm_method) == TOAST_LZ4_COMPRESSION_ID); \
+		((toast_compress_header *) (ptr))->tcinfo = \
+			(len) | ((uint32) (cm_method) << VARLENA_EXTSIZE_BITS); \
+	} while (0)
+
+/* GUC variables */
+int			default_toast_compression = TOAST_PGLZ_COMPRESSION;
+int			detoast_cache_size = 4096;	/* kilobytes */
+
+/*
+ * Cache of fully detoasted out-of-line values.
+ *
+ * A query that references a toasted column several times, or a function
+ * called once per row that reads the same value, would otherwise fetch the
+ * chunks and decompress them every time.  heap_tuple_untoast_attr keeps the
+ * results here, keyed by toast relation and value OID, and hands out copies.
+ * The contents of a toast value never change while the value exists, but
+ * once it is deleted and vacuumed away its OID could in principle be
+ * reused, so the cache is discarded at the end of each transaction and
+ * whenever the toast relation is invalidated (e.g., by TRUNCATE).  The
+ * total size is bounded by detoast_cache_size, evicting the least recently
+ * used values first.
+ */
+typedef struct DetoastCacheKey
+{
+	Oid			toastrelid;		/* OID of the toast relation */
+	Oid			valueid;		/* OID of the value within it */
+} DetoastCacheKey;
+
+typedef struct DetoastCacheEntry
+{
+	DetoastCacheKey key;		/* hash key; must be first */
+	dlist_node	lru_node;		/* link in DetoastCacheLRU */
+	struct varlena *value;		/* detoasted value, in DetoastCacheContext */
+} DetoastCacheEntry;
+
+static MemoryContext DetoastCacheContext = NULL;
+static HTAB *DetoastCache = NULL;
+static dlist_head DetoastCacheLRU;	/* most recently used first */
+static Size DetoastCacheBytes = 0;	/* total VARSIZE of cached values */
+static bool DetoastCacheCallbackRegistered = false;
+
+static struct varlena *detoast_cache_lookup(struct varatt_external * toast_pointer);
+static void detoast_cache_insert(struct varatt_external * toast_pointer,
+					 struct varlena * value);
+static void detoast_cache_reset(void);
+static void DetoastCacheRelCallback(Datum arg, Oid relid);
 
 static void toast_delete_datum(Relation rel, Datum value);
 static Datum toast_save_datum(Relation rel, Datum value,
@@ -171,6 +232,15 @@ heap_tuple_untoast_attr(struct varlena * attr)
 {
 	if (VARATT_IS_EXTERNAL_ONDISK(attr))
 	{
+		struct varatt_external toast_pointer;
+		struct varlena *cached;
+
+		/* Use the detoast cache's copy, if it has one */
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+		cached = detoast_cache_lookup(&toast_pointer);
+		if (cached != NULL)
+			return cached;
+
 		/*
 		 * This is an externally stored datum --- fetch it back from there
 		 */
@@ -183,6 +253,8 @@ heap_tuple_untoast_attr(struct varlena * attr)
 			attr = toast_decompress_datum(tmp);
 			pfree(tmp);
 		}
+
+		detoast_cache_insert(&toast_pointer, attr);
 	}
 	else if (VARATT_IS_EXTERNAL_INDIRECT(attr))
 	{
@@ -245,6 +317,174 @@ heap_tuple_untoast_attr(struct varlena * attr)
 }
 
 
+/* ----------
+ * detoast_cache_lookup -
+ *
+ *	Return a palloc'd copy of the cached detoasted value for toast_pointer,
+ *	or NULL if it isn't cached.
+ * ----------
+ */
+static struct varlena *
+detoast_cache_lookup(struct varatt_external * toast_pointer)
+{
+	DetoastCacheKey key;
+	DetoastCacheEntry *entry;
+	struct varlena *result;
+
+	if (DetoastCache == NULL)
+		return NULL;
+
+	key.toastrelid = toast_pointer->va_toastrelid;
+	key.valueid = toast_pointer->va_valueid;
+	entry = (DetoastCacheEntry *) hash_search(DetoastCache, &key,
+											  HASH_FIND, NULL);
+	if (entry == NULL)
+		return NULL;
+
+	dlist_move_head(&DetoastCacheLRU, &entry->lru_node);
+
+	result = (struct varlena *) palloc(VARSIZE(entry->value));
+	memcpy(result, entry->value, VARSIZE(entry->value));
+	return result;
+}
+
+/* ----------
+ * detoast_cache_insert -
+ *
+ *	Remember a copy of value, the fully detoasted form of toast_pointer,
+ *	if it fits within detoast_cache_size.
+ * ----------
+ */
+static void
+detoast_cache_insert(struct varatt_external * toast_pointer,
+					 struct varlena * value)
+{
+	Size		limit = (Size) detoast_cache_size * 1024;
+	Size		size = VARSIZE(value);
+	DetoastCacheKey key;
+	DetoastCacheEntry *entry;
+	bool		found;
+
+	if (size > limit)
+		return;
+
+	if (DetoastCache == NULL)
+	{
+		HASHCTL		ctl;
+
+		DetoastCacheContext = AllocSetContextCreate(TopMemoryContext,
+													"Detoast cache",
+													ALLOCSET_DEFAULT_MINSIZE,
+													ALLOCSET_DEFAULT_INITSIZE,
+													ALLOCSET_DEFAULT_MAXSIZE);
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(DetoastCacheKey);
+		ctl.entrysize = sizeof(DetoastCacheEntry);
+		ctl.hcxt = DetoastCacheContext;
+		DetoastCache = hash_create("Detoast cache", 64, &ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		dlist_init(&DetoastCacheLRU);
+		DetoastCacheBytes = 0;
+
+		if (!DetoastCacheCallbackRegistered)
+		{
+			CacheRegisterRelcacheCallback(DetoastCacheRelCallback, (Datum) 0);
+			DetoastCacheCallbackRegistered = true;
+		}
+	}
+
+	/* Make room by discarding the least recently used values */
+	while (DetoastCacheBytes + size > limit)
+	{
+		DetoastCacheEntry *oldest;
+
+		oldest = dlist_tail_element(DetoastCacheEntry, lru_node,
+									&DetoastCacheLRU);
+		dlist_delete(&oldest->lru_node);
+		DetoastCacheBytes -= VARSIZE(oldest->value);
+		pfree(oldest->value);
+		hash_search(DetoastCache, &oldest->key, HASH_REMOVE, NULL);
+	}
+
+	key.toastrelid = toast_pointer->va_toastrelid;
+	key.valueid = toast_pointer->va_valueid;
+	entry = (DetoastCacheEntry *) hash_search(DetoastCache, &key,
+											  HASH_ENTER, &found);
+	if (found)
+	{
+		/* can happen if a lookup missed before an inval reset the cache */
+		dlist_move_head(&DetoastCacheLRU, &entry->lru_node);
+		return;
+	}
+
+	entry->value = (struct varlena *) MemoryContextAlloc(DetoastCacheContext,
+														 size);
+	memcpy(entry->value, value, size);
+	dlist_push_head(&DetoastCacheLRU, &entry->lru_node);
+	DetoastCacheBytes += size;
+}
+
+/* ----------
+ * detoast_cache_reset -
+ *
+ *	Discard the whole detoast cache.
+ * ----------
+ */
+static void
+detoast_cache_reset(void)
+{
+	if (DetoastCacheContext != NULL)
+		MemoryContextDelete(DetoastCacheContext);
+	DetoastCacheContext = NULL;
+	DetoastCache = NULL;
+	DetoastCacheBytes = 0;
+}
+
+/*
+ * Relcache invalidation callback: if the invalidated relation is a toast
+ * relation we have cached values from, or we're told to invalidate
+ * everything, discard the cache.
+ */
+static void
+DetoastCacheRelCallback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	DetoastCacheEntry *entry;
+
+	if (DetoastCache == NULL)
+		return;
+
+	if (!OidIsValid(relid))
+	{
+		detoast_cache_reset();
+		return;
+	}
+
+	hash_seq_init(&status, DetoastCache);
+	while ((entry = (DetoastCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (entry->key.toastrelid == relid)
+		{
+			hash_seq_term(&status);
+			detoast_cache_reset();
+			return;
+		}
+	}
+}
+
+/* ----------
+ * AtEOXact_DetoastCache -
+ *
+ *	Discard the detoast cache at transaction end.
+ * ----------
+ */
+void
+AtEOXact_DetoastCache(void)
+{
+	detoast_cache_reset();
+}
+
+
 /* ----------
  * heap_tuple_untoast_attr_slice -
  *
@@ -419,7 +659,7 @@ toast_datum_size(Datum value)
 		struct varatt_external toast_pointer;
 
 		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
-		result = toast_pointer.va_extsize;
+		result = VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer);
 	}
 	else if (VARATT_IS_EXTERNAL_INDIRECT(attr))
 	{
@@ -772,7 +1012,8 @@ toast_insert_or_update(Relation rel, HeapTuple newtup, HeapTuple oldtup,
 		if (att[i]->attstorage == 'x')
 		{
 			old_value = toast_values[i];
-			new_value = toast_compress_datum(old_value);
+			new_value = toast_compress_datum(old_value,
+											 att[i]->attcompression);
 
 			if (DatumGetPointer(new_value) != NULL)
 			{
@@ -911,7 +1152,7 @@ toast_insert_or_update(Relation rel, HeapTuple newtup, HeapTuple oldtup,
 		 */
 		i = biggest_attno;
 		old_value = toast_values[i];
-		new_value = toast_compress_datum(old_value);
+		new_value = toast_compress_datum(old_value, att[i]->attcompression);
 
 		if (DatumGetPointer(new_value) != NULL)
 		{
@@ -1286,10 +1527,84 @@ toast_flatten_tuple_to_datum(HeapTupleHeader tup,
 }
 
 
+/* ----------
+ * CompressionNameToMethod -
+ *
+ *	Look up a compression method by name
+ * ----------
+ */
+char
+CompressionNameToMethod(const char *compression)
+{
+	if (strcmp(compression, "pglz") == 0)
+		return TOAST_PGLZ_COMPRESSION;
+	else if (strcmp(compression, "lz4") == 0)
+	{
+#ifndef USE_LZ4
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("compression method lz4 not supported"),
+				 errdetail("This functionality requires the server to be built with lz4 support."),
+				 errhint("You need to rebuild PostgreSQL using --with-lz4.")));
+#endif
+		return TOAST_LZ4_COMPRESSION;
+	}
+
+	return InvalidCompressionMethod;
+}
+
+/* ----------
+ * GetCompressionMethodName -
+ *
+ *	Get the name of a compression method
+ * ----------
+ */
+const char *
+GetCompressionMethodName(char method)
+{
+	switch (method)
+	{
+		case TOAST_PGLZ_COMPRESSION:
+			return "pglz";
+		case TOAST_LZ4_COMPRESSION:
+			return "lz4";
+		default:
+			elog(ERROR, "invalid compression method %c", method);
+			return NULL;		/* keep compiler quiet */
+	}
+}
+
+/* ----------
+ * toast_get_compression_id -
+ *
+ *	Return the compression method of a compressed datum, whether in-line or
+ *	external, or TOAST_INVALID_COMPRESSION_ID if it isn't compressed
+ * ----------
+ */
+ToastCompressionId
+toast_get_compression_id(struct varlena * attr)
+{
+	if (VARATT_IS_EXTERNAL_ONDISK(attr))
+	{
+		struct varatt_external toast_pointer;
+
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+
+		if (VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
+			return (ToastCompressionId)
+				VARATT_EXTERNAL_GET_COMPRESS_METHOD(toast_pointer);
+	}
+	else if (VARATT_IS_COMPRESSED(attr))
+		return (ToastCompressionId) VARCOMPRESS_4B_C(attr);
+
+	return TOAST_INVALID_COMPRESSION_ID;
+}
+
 /* ----------
  * toast_compress_datum -
  *
- *	Create a compressed version of a varlena datum
+ *	Create a compressed version of a varlena datum, using the compression
+ *	method cmethod, or default_toast_compression if that's invalid
  *
  *	If we fail (ie, compressed result is actually bigger than original)
  *	then return NULL.  We must not use compressed data if it'd expand
@@ -1300,28 +1615,70 @@ toast_flatten_tuple_to_datum(HeapTupleHeader tup,
  * ----------
  */
 Datum
-toast_compress_datum(Datum value)
+toast_compress_datum(Datum value, char cmethod)
 {
 	struct varlena *tmp;
 	int32		valsize = VARSIZE_ANY_EXHDR(DatumGetPointer(value));
 	int32		len;
+	ToastCompressionId cmid;
 
 	Assert(!VARATT_IS_EXTERNAL(DatumGetPointer(value)));
 	Assert(!VARATT_IS_COMPRESSED(DatumGetPointer(value)));
 
-	/*
-	 * No point in wasting a palloc cycle if value size is out of the allowed
-	 * range for compression
-	 */
-	if (valsize < PGLZ_strategy_default->min_input_size ||
-		valsize > PGLZ_strategy_default->max_input_size)
-		return PointerGetDatum(NULL);
+	if (!CompressionMethodIsValid(cmethod))
+		cmethod = (char) default_toast_compression;
+
+	switch (cmethod)
+	{
+		case TOAST_PGLZ_COMPRESSION:
+
+			/*
+			 * No point in wasting a palloc cycle if value size is out of the
+			 * allowed range for compression
+			 */
+			if (valsize < PGLZ_strategy_default->min_input_size ||
+				valsize > PGLZ_strategy_default->max_input_size)
+				return PointerGetDatum(NULL);
+
+			tmp = (struct varlena *) palloc(PGLZ_MAX_OUTPUT(valsize) +
+											TOAST_COMPRESS_HDRSZ);
+			len = pglz_compress(VARDATA_ANY(DatumGetPointer(value)),
+								valsize,
+								TOAST_COMPRESS_RAWDATA(tmp),
+								PGLZ_strategy_default);
+			cmid = TOAST_PGLZ_COMPRESSION_ID;
+			break;
 
-	tmp = (struct varlena *) palloc(PGLZ_MAX_OUTPUT(valsize) +
-									TOAST_COMPRESS_HDRSZ);
+		case TOAST_LZ4_COMPRESSION:
+#ifdef USE_LZ4
+			{
+				int32		max_size = LZ4_compressBound(valsize);
+
+				tmp = (struct varlena *) palloc(max_size +
+												TOAST_COMPRESS_HDRSZ);
+				len = LZ4_compress_default(VARDATA_ANY(DatumGetPointer(value)),
+										   TOAST_COMPRESS_RAWDATA(tmp),
+										   valsize, max_size);
+				if (len <= 0)
+					elog(ERROR, "lz4 compression failed");
+				cmid = TOAST_LZ4_COMPRESSION_ID;
+			}
+			break;
+#else
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("compression method lz4 not supported"),
+					 errdetail("This functionality requires the server to be built with lz4 support.")));
+			return PointerGetDatum(NULL);	/* keep compiler quiet */
+#endif
+
+		default:
+			elog(ERROR, "invalid compression method %c", cmethod);
+			return PointerGetDatum(NULL);	/* keep compiler quiet */
+	}
 
 	/*
-	 * We recheck the actual size even if pglz_compress() reports success,
+	 * We recheck the actual size even if the compressor reports success,
 	 * because it might be satisfied with having saved as little as one byte
 	 * in the compressed data --- which could turn into a net loss once you
 	 * consider header and alignment padding.  Worst case, the compressed
@@ -1330,14 +1687,10 @@ toast_compress_datum(Datum value)
 	 * only one header byte and no padding if the value is short enough.  So
 	 * we insist on a savings of more than 2 bytes to ensure we have a gain.
 	 */
-	len = pglz_compress(VARDATA_ANY(DatumGetPointer(value)),
-						valsize,
-						TOAST_COMPRESS_RAWDATA(tmp),
-						PGLZ_strategy_default);
 	if (len >= 0 &&
 		len + TOAST_COMPRESS_HDRSZ < valsize - 2)
 	{
-		TOAST_COMPRESS_SET_RAWSIZE(tmp, valsize);
+		TOAST_COMPRESS_SET_SIZE_AND_COMPRESS_METHOD(tmp, valsize, cmid);
 		SET_VARSIZE_COMPRESSED(tmp, len + TOAST_COMPRESS_HDRSZ);
 		/* successful compression */
 		return PointerGetDatum(tmp);
@@ -1442,19 +1795,20 @@ toast_save_datum(Relation rel, Datum value,
 									&num_indexes);
 
 	/*
-	 * Get the data pointer and length, and compute va_rawsize and va_extsize.
+	 * Get the data pointer and length, and compute va_rawsize and va_extinfo.
 	 *
 	 * va_rawsize is the size of the equivalent fully uncompressed datum, so
 	 * we have to adjust for short headers.
 	 *
-	 * va_extsize is the actual size of the data payload in the toast records.
+	 * va_extinfo holds the actual size of the data payload in the toast
+	 * records, and the compression method if the payload is compressed.
 	 */
 	if (VARATT_IS_SHORT(dval))
 	{
 		data_p = VARDATA_SHORT(dval);
 		data_todo = VARSIZE_SHORT(dval) - VARHDRSZ_SHORT;
 		toast_pointer.va_rawsize = data_todo + VARHDRSZ;		/* as if not short */
-		toast_pointer.va_extsize = data_todo;
+		toast_pointer.va_extinfo = data_todo;
 	}
 	else if (VARATT_IS_COMPRESSED(dval))
 	{
@@ -1462,7 +1816,9 @@ toast_save_datum(Relation rel, Datum value,
 		data_todo = VARSIZE(dval) - VARHDRSZ;
 		/* rawsize in a compressed datum is just the size of the payload */
 		toast_pointer.va_rawsize = VARRAWSIZE_4B_C(dval) + VARHDRSZ;
-		toast_pointer.va_extsize = data_todo;
+		/* the external size keeps the compression method alongside */
+		VARATT_EXTERNAL_SET_SIZE_AND_COMPRESS_METHOD(toast_pointer, data_todo,
+													 VARCOMPRESS_4B_C(dval));
 		/* Assert that the numbers look like it's compressed */
 		Assert(VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer));
 	}
@@ -1471,7 +1827,7 @@ toast_save_datum(Relation rel, Datum value,
 		data_p = VARDATA(dval);
 		data_todo = VARSIZE(dval) - VARHDRSZ;
 		toast_pointer.va_rawsize = VARSIZE(dval);
-		toast_pointer.va_extsize = data_todo;
+		toast_pointer.va_extinfo = data_todo;
 	}
 
 	/*
@@ -1820,7 +2176,7 @@ toast_fetch_datum(struct varlena * attr)
 	/* Must copy to access aligned fields */
 	VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
 
-	ressize = toast_pointer.va_extsize;
+	ressize = VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer);
 	numchunks = ((ressize - 1) / TOAST_MAX_CHUNK_SIZE) + 1;
 
 	result = (struct varlena *) palloc(ressize + VARHDRSZ);
@@ -2003,7 +2359,7 @@ toast_fetch_datum_slice(struct varlena * attr, int32 sliceoffset, int32 length)
 	 */
 	Assert(!VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer));
 
-	attrsize = toast_pointer.va_extsize;
+	attrsize = VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer);
 	totalchunks = ((attrsize - 1) / TOAST_MAX_CHUNK_SIZE) + 1;
 
 	if (sliceoffset >= attrsize)
@@ -2202,11 +2558,34 @@ toast_decompress_datum(struct varlena * attr)
 		palloc(TOAST_COMPRESS_RAWSIZE(attr) + VARHDRSZ);
 	SET_VARSIZE(result, TOAST_COMPRESS_RAWSIZE(attr) + VARHDRSZ);
 
-	if (pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
-						VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
-						VARDATA(result),
-						TOAST_COMPRESS_RAWSIZE(attr)) < 0)
-		elog(ERROR, "compressed data is corrupted");
+	switch (TOAST_COMPRESS_METHOD(attr))
+	{
+		case TOAST_PGLZ_COMPRESSION_ID:
+			if (pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
+								VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
+								VARDATA(result),
+								TOAST_COMPRESS_RAWSIZE(attr)) < 0)
+				elog(ERROR, "compressed data is corrupted");
+			break;
+		case TOAST_LZ4_COMPRESSION_ID:
+#ifdef USE_LZ4
+			if (LZ4_decompress_safe(TOAST_COMPRESS_RAWDATA(attr),
+									VARDATA(result),
+									VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
+									TOAST_COMPRESS_RAWSIZE(attr)) !=
+				TOAST_COMPRESS_RAWSIZE(attr))
+				elog(ERROR, "compressed lz4 data is corrupted");
+#else
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("compression method lz4 not supported"),
+					 errdetail("This functionality requires the server to be built with lz4 support.")));
+#endif
+			break;
+		default:
+			elog(ERROR, "invalid compression method id %d",
+				 (int) TOAST_COMPRESS_METHOD(attr));
+	}
 
 	return result;
 }
@@ -20,6 +20,7 @@
  *		index_insert	- insert an index tuple into a relation
  *		index_markpos	- mark a scan position
  *		index_restrpos	- restore a scan position
+ *		index_setprefetch	- read ahead in the index to prefetch heap pages
  *		index_getnext_tid	- get the next TID from a scan
  *		index_fetch_heap		- get the scan's next heap tuple
  *		index_getnext	- get the next heap tuple from a scan
@@ -136,8 +137,17 @@ do { \
 	} \
 } while(0)
 
+/*
+ * Upper limit on how many TIDs an index scan reads ahead of the one it's
+ * returning, however high effective_io_concurrency is set.
+ */
+#define INDEX_PREFETCH_MAX_DISTANCE		256
+
 static IndexScanDesc index_beginscan_internal(Relation indexRelation,
 						 int nkeys, int norderbys, Snapshot snapshot);
+static bool index_fetch_tid(IndexScanDesc scan, ScanDirection direction);
+static bool index_prefetch_next_tid(IndexScanDesc scan,
+						ScanDirection direction);
 
 
 /* ----------------------------------------------------------------
@@ -350,6 +360,16 @@ index_rescan(IndexScanDesc scan,
 
 	scan->kill_prior_tuple = false;		/* for safety */
 
+	/* Forget any TIDs read ahead under the old keys */
+	if (scan->xs_prefetch != NULL)
+	{
+		scan->xs_prefetch->distance = 0;
+		scan->xs_prefetch->head = 0;
+		scan->xs_prefetch->count = 0;
+		scan->xs_prefetch->exhausted = false;
+		scan->xs_prefetch->last_block = InvalidBlockNumber;
+	}
+
 	FunctionCall5(procedure,
 				  PointerGetDatum(scan),
 				  PointerGetDatum(keys),
@@ -399,6 +419,9 @@ index_markpos(IndexScanDesc scan)
 	SCAN_CHECKS;
 	GET_SCAN_PROCEDURE(ammarkpos);
 
+	/* the AM's position is ahead of the caller's when reading ahead */
+	Assert(scan->xs_prefetch == NULL);
+
 	FunctionCall1(procedure, PointerGetDatum(scan));
 }
 
@@ -445,26 +468,16 @@ index_restrpos(IndexScanDesc scan)
 ItemPointer
 index_getnext_tid(IndexScanDesc scan, ScanDirection direction)
 {
-	FmgrInfo   *procedure;
 	bool		found;
 
 	SCAN_CHECKS;
-	GET_SCAN_PROCEDURE(amgettuple);
 
 	Assert(TransactionIdIsValid(RecentGlobalXmin));
 
-	/*
-	 * The AM's amgettuple proc finds the next index entry matching the scan
-	 * keys, and puts the TID into scan->xs_ctup.t_self.  It should also set
-	 * scan->xs_recheck and possibly scan->xs_itup, though we pay no attention
-	 * to those fields here.
-	 */
-	found = DatumGetBool(FunctionCall2(procedure,
-									   PointerGetDatum(scan),
-									   Int32GetDatum(direction)));
-
-	/* Reset kill flag immediately for safety */
-	scan->kill_prior_tuple = false;
+	if (scan->xs_prefetch != NULL)
+		found = index_prefetch_next_tid(scan, direction);
+	else
+		found = index_fetch_tid(scan, direction);
 
 	/* If we're out of index entries, we're done */
 	if (!found)
@@ -478,12 +491,161 @@ index_getnext_tid(IndexScanDesc scan, ScanDirection direction)
 		return NULL;
 	}
 
-	pgstat_count_index_tuples(scan->indexRelation, 1);
-
 	/* Return the TID of the tuple we found. */
 	return &scan->xs_ctup.t_self;
 }
 
+/*
+ * index_fetch_tid - ask the AM for the next TID
+ *
+ * The AM's amgettuple proc finds the next index entry matching the scan keys,
+ * and puts the TID into scan->xs_ctup.t_self.  It should also set
+ * scan->xs_recheck and possibly scan->xs_itup, though we pay no attention to
+ * those fields here.
+ */
+static bool
+index_fetch_tid(IndexScanDesc scan, ScanDirection direction)
+{
+	FmgrInfo   *procedure;
+	bool		found;
+
+	GET_SCAN_PROCEDURE(amgettuple);
+
+	found = DatumGetBool(FunctionCall2(procedure,
+									   PointerGetDatum(scan),
+									   Int32GetDatum(direction)));
+
+	/* Reset kill flag immediately for safety */
+	scan->kill_prior_tuple = false;
+
+	if (found)
+		pgstat_count_index_tuples(scan->indexRelation, 1);
+
+	return found;
+}
+
+/* ----------------
+ *		index_setprefetch - read ahead in the index to prefetch heap pages
+ *
+ * After this, index_getnext_tid reads up to "distance" TIDs ahead of the one
+ * it returns, and issues a PrefetchBuffer for the heap block of each, so
+ * that the heap fetches of a cold index scan overlap instead of being done
+ * one synchronous read at a time.  TIDs are still returned in index order.
+ * The lookahead starts at zero and doubles with each TID returned, so that
+ * a scan stopped early by a LIMIT doesn't read much it won't use.
+ *
+ * The caller must only scan in one direction, and must not use mark/restore,
+ * since the AM's position runs ahead of what's been returned.  The snapshot
+ * must be MVCC-safe: a TID that the AM has already stepped past is no longer
+ * protected by its pin on the index page against VACUUM removing the heap
+ * tuple and the line pointer being reused.  Index-only scans and scans that
+ * return ORDER BY values aren't supported either, since xs_itup and
+ * xs_orderbyvals only describe the latest TID the AM returned.
+ *
+ * kill_prior_tuple hints only reach the AM while the lookahead queue is
+ * empty, because otherwise the AM's current entry isn't the one the hint is
+ * about; a scan that's prefetching will therefore mark fewer dead index
+ * entries than one that isn't.
+ * ----------------
+ */
+void
+index_setprefetch(IndexScanDesc scan, int distance)
+{
+	IndexPrefetchData *prefetch;
+
+	SCAN_CHECKS;
+	Assert(scan->heapRelation != NULL);
+	Assert(IsMVCCSnapshot(scan->xs_snapshot));
+	Assert(!scan->xs_want_itup && scan->numberOfOrderBys == 0);
+
+	if (scan->xs_prefetch != NULL)
+	{
+		pfree(scan->xs_prefetch);
+		scan->xs_prefetch = NULL;
+	}
+
+	distance = Min(distance, INDEX_PREFETCH_MAX_DISTANCE);
+	if (distance <= 0)
+		return;
+
+	prefetch = (IndexPrefetchData *)
+		palloc(offsetof(IndexPrefetchData, queue) +
+			   (distance + 1) * sizeof(IndexPrefetchEntry));
+	prefetch->maxdistance = distance;
+	prefetch->distance = 0;
+	prefetch->head = 0;
+	prefetch->count = 0;
+	prefetch->exhausted = false;
+	prefetch->last_block = InvalidBlockNumber;
+
+	scan->xs_prefetch = prefetch;
+}
+
+/*
+ * index_prefetch_next_tid - index_getnext_tid for a scan that's reading ahead
+ *
+ * Top up the queue to the current lookahead distance, prefetching heap blocks
+ * as TIDs are added, then hand back the oldest TID in the queue.
+ */
+static bool
+index_prefetch_next_tid(IndexScanDesc scan, ScanDirection direction)
+{
+	IndexPrefetchData *prefetch = scan->xs_prefetch;
+	int			nslots = prefetch->maxdistance + 1;
+	IndexPrefetchEntry *entry;
+
+	/*
+	 * A kill hint is about the TID we returned last, which is the AM's
+	 * current entry only if nothing has been read past it.
+	 */
+	if (prefetch->count > 0)
+		scan->kill_prior_tuple = false;
+
+	while (!prefetch->exhausted && prefetch->count <= prefetch->distance)
+	{
+		BlockNumber block;
+
+		if (!index_fetch_tid(scan, direction))
+		{
+			prefetch->exhausted = true;
+			break;
+		}
+
+		entry = &prefetch->queue[(prefetch->head + prefetch->count) % nslots];
+		entry->tid = scan->xs_ctup.t_self;
+		entry->recheck = scan->xs_recheck;
+		prefetch->count++;
+
+		/*
+		 * Consecutive index entries often point into the same heap block,
+		 * and there's no point in prefetching that again.
+		 */
+		block = ItemPointerGetBlockNumber(&entry->tid);
+		if (block != prefetch->last_block)
+		{
+			PrefetchBuffer(scan->heapRelation, MAIN_FORKNUM, block);
+			prefetch->last_block = block;
+		}
+	}
+
+	if (prefetch->count == 0)
+		return false;
+
+	entry = &prefetch->queue[prefetch->head];
+	scan->xs_ctup.t_self = entry->tid;
+	scan->xs_recheck = entry->recheck;
+	prefetch->head = (prefetch->head + 1) % nslots;
+	prefetch->count--;
+
+	if (prefetch->distance == 0)
+		prefetch->distance = 1;
+	else
+		prefetch->distance = Min(prefetch->distance * 2,
+								 prefetch->maxdistance);
+
+	return true;
+}
+
 /* ----------------
  *		index_fetch_heap - get the scan's next heap tuple
  *
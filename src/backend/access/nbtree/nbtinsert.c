@@ -22,8 +22,23 @@
 #include "miscadmin.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
+#include "storage/smgr.h"
 #include "utils/tqual.h"
 
+/*
+ * Inserts remember the rightmost leaf page they used, so that the next one
+ * can go straight there if its key is at the right end of the index too.
+ * That's pointless unless the descent it saves visits at least this many
+ * levels above the leaf.
+ */
+#define BTREE_FASTPATH_MIN_LEVEL	2
+
+/*
+ * The most heap blocks _bt_bottomup_delete visits to find out which
+ * duplicates on a leaf page are dead, before giving up and splitting it.
+ */
+#define BTREE_BOTTOMUP_MAX_BLOCKS	6
+
 
 typedef struct
 {
@@ -45,6 +60,20 @@ typedef struct
 	int			best_delta;		/* best size delta so far */
 } FindSplitData;
 
+/* working state for _bt_bottomup_delete */
+typedef struct
+{
+	ItemPointerData htid;		/* a heap TID on the leaf page */
+	OffsetNumber offnum;		/* the leaf item it's in */
+} BTBottomUpTid;
+
+typedef struct
+{
+	BlockNumber blkno;			/* a heap block */
+	int			first;			/* its first TID in the sorted TID array */
+	int			ntids;			/* and how many there are */
+} BTBottomUpBlock;
+
 
 static Buffer _bt_newroot(Relation rel, Buffer lbuf, Buffer rbuf);
 
@@ -83,6 +112,12 @@ static bool _bt_pgaddtup(Page page, Size itemsize, IndexTuple itup,
 static bool _bt_isequal(TupleDesc itupdesc, Page page, OffsetNumber offnum,
 			int keysz, ScanKey scankey);
 static void _bt_vacuum_one_page(Relation rel, Buffer buffer, Relation heapRel);
+static bool _bt_bottomup_delete(Relation rel, Buffer buffer, int keysz,
+					ScanKey scankey, Relation heapRel);
+static int	_bt_bottomup_tid_cmp(const void *a, const void *b);
+static int	_bt_bottomup_block_cmp(const void *a, const void *b);
+static int	_bt_offset_cmp(const void *a, const void *b);
+static void _bt_dedup_one_page(Relation rel, Buffer buffer);
 
 
 /*
@@ -108,34 +143,92 @@ _bt_doinsert(Relation rel, IndexTuple itup,
 			 IndexUniqueCheck checkUnique, Relation heapRel)
 {
 	bool		is_unique = false;
-	int			natts = rel->rd_rel->relnatts;
+	int			natts = IndexRelationGetNumberOfKeyAttributes(rel);
 	ScanKey		itup_scankey;
-	BTStack		stack;
+	BTStack		stack = NULL;
 	Buffer		buf;
 	OffsetNumber offset;
+	bool		fastpath;
 
 	/* we need an insertion scan key to do our search, so build one */
 	itup_scankey = _bt_mkscankey(rel, itup);
 
 top:
-	/* find the first page containing this key */
-	stack = _bt_search(rel, natts, itup_scankey, false, &buf, BT_WRITE);
-
 	offset = InvalidOffsetNumber;
 
-	/* trade in our read lock for a write lock */
-	LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-	LockBuffer(buf, BT_WRITE);
-
 	/*
-	 * If the page was split between the time that we surrendered our read
-	 * lock and acquired our write lock, then this page may no longer be the
-	 * right place for the key we want to insert.  In this case, we need to
-	 * move right in the tree.  See Lehman and Yao for an excruciatingly
-	 * precise description.
+	 * If the last insertion in this backend went to the rightmost leaf page,
+	 * or to any leaf while inserts are arriving in key order, try that page
+	 * first.  It's the right place for the new tuple if it is still a live
+	 * leaf, and the new key is greater than its first data key and no
+	 * greater than its high key (if any); we also want the tuple to fit
+	 * without a split, which needs the stack that we skip building.  Then
+	 * there's no need to descend the tree.  If someone else holds the lock,
+	 * don't wait: that's a sign of concurrent inserts that are better served
+	 * by the normal path.
 	 */
-	buf = _bt_moveright(rel, buf, natts, itup_scankey, false,
-						true, stack, BT_WRITE);
+	fastpath = false;
+	if (RelationGetTargetBlock(rel) != InvalidBlockNumber)
+	{
+		Size		itemsz;
+		Page		page;
+		BTPageOpaque lpageop;
+
+		buf = ReadBuffer(rel, RelationGetTargetBlock(rel));
+
+		if (ConditionalLockBuffer(buf))
+		{
+			_bt_checkpage(rel, buf);
+
+			page = BufferGetPage(buf);
+			lpageop = (BTPageOpaque) PageGetSpecialPointer(page);
+			itemsz = MAXALIGN(IndexTupleDSize(*itup));
+
+			if (P_ISLEAF(lpageop) && !P_IGNORE(lpageop) &&
+				!P_INCOMPLETE_SPLIT(lpageop) &&
+				PageGetFreeSpace(page) > itemsz &&
+				PageGetMaxOffsetNumber(page) >= P_FIRSTDATAKEY(lpageop) &&
+				_bt_compare(rel, natts, itup_scankey, page,
+							P_FIRSTDATAKEY(lpageop)) > 0 &&
+				(P_RIGHTMOST(lpageop) ||
+				 _bt_compare(rel, natts, itup_scankey, page, P_HIKEY) <= 0))
+				fastpath = true;
+			else
+			{
+				_bt_relbuf(rel, buf);
+
+				/* the cached block is of no use any more; forget it */
+				RelationSetTargetBlock(rel, InvalidBlockNumber);
+			}
+		}
+		else
+		{
+			ReleaseBuffer(buf);
+
+			/* likewise, if we collided with someone */
+			RelationSetTargetBlock(rel, InvalidBlockNumber);
+		}
+	}
+
+	if (!fastpath)
+	{
+		/* find the first page containing this key */
+		stack = _bt_search(rel, natts, itup_scankey, false, &buf, BT_WRITE);
+
+		/* trade in our read lock for a write lock */
+		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+		LockBuffer(buf, BT_WRITE);
+
+		/*
+		 * If the page was split between the time that we surrendered our
+		 * read lock and acquired our write lock, then this page may no
+		 * longer be the right place for the key we want to insert.  In this
+		 * case, we need to move right in the tree.  See Lehman and Yao for
+		 * an excruciatingly precise description.
+		 */
+		buf = _bt_moveright(rel, buf, natts, itup_scankey, false,
+							true, stack, BT_WRITE);
+	}
 
 	/*
 	 * If we're not allowing duplicates, make sure the key isn't already in
@@ -184,6 +277,7 @@ top:
 
 			/* start over... */
 			_bt_freestack(stack);
+			stack = NULL;
 			goto top;
 		}
 	}
@@ -242,7 +336,7 @@ _bt_check_unique(Relation rel, IndexTuple itup, Relation heapRel,
 				 uint32 *speculativeToken)
 {
 	TupleDesc	itupdesc = RelationGetDescr(rel);
-	int			natts = rel->rd_rel->relnatts;
+	int			natts = IndexRelationGetNumberOfKeyAttributes(rel);
 	SnapshotData SnapshotDirty;
 	OffsetNumber maxoff;
 	Page		page;
@@ -622,7 +716,24 @@ _bt_findinsertloc(Relation rel,
 		if (P_RIGHTMOST(lpageop) ||
 			_bt_compare(rel, keysz, scankey, page, P_HIKEY) != 0 ||
 			random() <= (MAX_RANDOM_VALUE / 100))
+		{
+			/*
+			 * We're going to split this page, unless deleting dead versions
+			 * of the new key, or failing that merging its duplicates into
+			 * posting lists, frees enough space.  Both move tuples around,
+			 * so the caller's hint can't be used afterwards.
+			 */
+			if (P_ISLEAF(lpageop) &&
+				_bt_bottomup_delete(rel, buf, keysz, scankey, heapRel))
+				vacuumed = true;
+			if (P_ISLEAF(lpageop) && PageGetFreeSpace(page) < itemsz &&
+				_bt_dedup_allowed(rel))
+			{
+				_bt_dedup_one_page(rel, buf);
+				vacuumed = true;
+			}
 			break;
+		}
 
 		/*
 		 * step right to next non-dead page
@@ -800,6 +911,7 @@ _bt_insertonpg(Relation rel,
 		BTMetaPageData *metad = NULL;
 		OffsetNumber itup_off;
 		BlockNumber itup_blkno;
+		BlockNumber cachedBlock = InvalidBlockNumber;
 
 		itup_off = newitemoff;
 		itup_blkno = BufferGetBlockNumber(buf);
@@ -836,6 +948,16 @@ _bt_insertonpg(Relation rel,
 
 		MarkBufferDirty(buf);
 
+		/*
+		 * Remember the block for the next insertion if it's the rightmost
+		 * leaf page, or any leaf page if the caller has told us the inserts
+		 * are sorted, unless it's the root too: then there's no descent to
+		 * save.  See _bt_doinsert().
+		 */
+		if ((P_RIGHTMOST(lpageop) || rel->rd_sortedinsert) &&
+			P_ISLEAF(lpageop) && !P_ISROOT(lpageop))
+			cachedBlock = itup_blkno;
+
 		if (BufferIsValid(metabuf))
 		{
 			metad->btm_fastroot = itup_blkno;
@@ -887,6 +1009,7 @@ _bt_insertonpg(Relation rel,
 				xlmeta.level = metad->btm_level;
 				xlmeta.fastroot = metad->btm_fastroot;
 				xlmeta.fastlevel = metad->btm_fastlevel;
+				xlmeta.version = metad->btm_version;
 
 				XLogRegisterBuffer(2, metabuf, REGBUF_WILL_INIT);
 				XLogRegisterBufData(2, (char *) &xlmeta, sizeof(xl_btree_metadata));
@@ -928,6 +1051,15 @@ _bt_insertonpg(Relation rel,
 		if (BufferIsValid(cbuf))
 			_bt_relbuf(rel, cbuf);
 		_bt_relbuf(rel, buf);
+
+		/*
+		 * Cache the block only once the tree is tall enough for that to pay
+		 * off.  _bt_getrootheight() normally just looks in the relcache, and
+		 * isn't called while we hold buffer locks in any case.
+		 */
+		if (BlockNumberIsValid(cachedBlock) &&
+			_bt_getrootheight(rel) >= BTREE_FASTPATH_MIN_LEVEL)
+			RelationSetTargetBlock(rel, cachedBlock);
 	}
 }
 
@@ -966,6 +1098,7 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 	Size		itemsz;
 	ItemId		itemid;
 	IndexTuple	item;
+	IndexTuple	lefthikey;
 	OffsetNumber leftoff,
 				rightoff;
 	OffsetNumber maxoff;
@@ -1056,9 +1189,14 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 	/*
 	 * The "high key" for the new left page will be the first key that's going
 	 * to go into the new right page.  This might be either the existing data
-	 * item at position firstright, or the incoming tuple.
+	 * item at position firstright, or the incoming tuple.  On the leaf level,
+	 * it's truncated to what it takes to tell it from the last key staying
+	 * on the left page, if the index allows that; otherwise a posting list
+	 * tuple is at least cut down to its key and first heap TID, since high
+	 * keys are never posting lists.
 	 */
 	leftoff = P_HIKEY;
+	lefthikey = NULL;
 	if (!newitemonleft && newitemoff == firstright)
 	{
 		/* incoming tuple will become first on right page */
@@ -1072,6 +1210,25 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		itemsz = ItemIdGetLength(itemid);
 		item = (IndexTuple) PageGetItem(origpage, itemid);
 	}
+	if (isleaf && _bt_truncate_allowed(rel))
+	{
+		IndexTuple	lastleft;
+
+		if (newitemonleft && newitemoff == firstright)
+			lastleft = newitem;
+		else
+			lastleft = (IndexTuple) PageGetItem(origpage,
+									PageGetItemId(origpage,
+												  OffsetNumberPrev(firstright)));
+		lefthikey = _bt_truncate(rel, lastleft, item);
+	}
+	else if (BTreeTupleIsPosting(item))
+		lefthikey = _bt_form_posting(item, BTreeTupleGetHeapTID(item), 1);
+	if (lefthikey)
+	{
+		itemsz = IndexTupleSize(lefthikey);
+		item = lefthikey;
+	}
 	if (PageAddItem(leftpage, (Item) item, itemsz, leftoff,
 					false, false) == InvalidOffsetNumber)
 	{
@@ -1081,6 +1238,8 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 			 origpagenumber, RelationGetRelationName(rel));
 	}
 	leftoff = OffsetNumberNext(leftoff);
+	if (lefthikey)
+		pfree(lefthikey);
 
 	/*
 	 * Now transfer all the data items to the appropriate page.
@@ -1289,20 +1448,16 @@ _bt_split(Relation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		if (newitemonleft)
 			XLogRegisterBufData(0, (char *) newitem, MAXALIGN(newitemsz));
 
-		/* Log left page */
-		if (!isleaf)
-		{
-			/*
-			 * We must also log the left page's high key, because the right
-			 * page's leftmost key is suppressed on non-leaf levels.  Show it
-			 * as belonging to the left page buffer, so that it is not stored
-			 * if XLogInsert decides it needs a full-page image of the left
-			 * page.
-			 */
-			itemid = PageGetItemId(origpage, P_HIKEY);
-			item = (IndexTuple) PageGetItem(origpage, itemid);
-			XLogRegisterBufData(0, (char *) item, MAXALIGN(IndexTupleSize(item)));
-		}
+		/*
+		 * Log left page.  We must also log the left page's high key, because
+		 * the right page's leftmost key is suppressed on non-leaf levels, and
+		 * on the leaf level the high key may have been truncated.  Show it
+		 * as belonging to the left page buffer, so that it is not stored if
+		 * XLogInsert decides it needs a full-page image of the left page.
+		 */
+		itemid = PageGetItemId(origpage, P_HIKEY);
+		item = (IndexTuple) PageGetItem(origpage, itemid);
+		XLogRegisterBufData(0, (char *) item, MAXALIGN(IndexTupleSize(item)));
 
 		/*
 		 * Log the contents of the right page in the format understood by
@@ -1687,7 +1842,7 @@ _bt_insert_parent(Relation rel,
 
 		/* form an index tuple that points at the new right page */
 		new_item = CopyIndexTuple(ritem);
-		ItemPointerSet(&(new_item->t_tid), rbknum, P_HIKEY);
+		BTreeTupleSetDownLink(new_item, rbknum);
 
 		/*
 		 * Find the parent buffer and get the parent page.
@@ -1962,7 +2117,7 @@ _bt_newroot(Relation rel, Buffer lbuf, Buffer rbuf)
 	right_item_sz = ItemIdGetLength(itemid);
 	item = (IndexTuple) PageGetItem(lpage, itemid);
 	right_item = CopyIndexTuple(item);
-	ItemPointerSet(&(right_item->t_tid), rbkno, P_HIKEY);
+	BTreeTupleSetDownLink(right_item, rbkno);
 
 	/* NO EREPORT(ERROR) from here till newroot op is logged */
 	START_CRIT_SECTION();
@@ -2033,6 +2188,7 @@ _bt_newroot(Relation rel, Buffer lbuf, Buffer rbuf)
 		md.level = metad->btm_level;
 		md.fastroot = rootblknum;
 		md.fastlevel = metad->btm_level;
+		md.version = metad->btm_version;
 
 		XLogRegisterBufData(2, (char *) &md, sizeof(xl_btree_metadata));
 
@@ -2150,6 +2306,119 @@ _bt_isequal(TupleDesc itupdesc, Page page, OffsetNumber offnum,
 	return true;
 }
 
+/*
+ * _bt_dedup_one_page - merge duplicates on a leaf page into posting lists.
+ *
+ * Runs of adjacent items whose keys are bitwise identical are merged into
+ * posting list tuples, as long as those stay within BTMaxPostingSize.  This
+ * is done only when the page would otherwise have to be split, so that an
+ * index with many duplicates grows far more slowly.  LP_DEAD items are left
+ * alone; _bt_vacuum_one_page will have removed them if it could.  The
+ * passed buffer must be exclusive-locked.  Posting lists never move across
+ * pages, so there's nothing to tell predicate locking about.
+ */
+static void
+_bt_dedup_one_page(Relation rel, Buffer buffer)
+{
+	Page		page = BufferGetPage(buffer);
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	BTDedupInterval intervals[MaxIndexTuplesPerPage];
+	int			nintervals = 0;
+	Size		maxpostingsize = BTMaxPostingSize(page);
+	IndexTuple	base = NULL;
+	OffsetNumber baseoff = InvalidOffsetNumber;
+	int			nitems = 0;
+	int			nhtids = 0;
+	OffsetNumber offnum,
+				minoff,
+				maxoff;
+	Page		newpage;
+
+	minoff = P_FIRSTDATAKEY(opaque);
+	maxoff = PageGetMaxOffsetNumber(page);
+	for (offnum = minoff;
+		 offnum <= maxoff;
+		 offnum = OffsetNumberNext(offnum))
+	{
+		ItemId		itemId = PageGetItemId(page, offnum);
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, itemId);
+		int			ntids = BTreeTupleGetNHeapTIDs(itup);
+
+		if (!ItemIdIsDead(itemId) && nitems > 0 &&
+			_bt_keys_identical(base, itup) &&
+			MAXALIGN(BTreeTupleGetKeySize(base) +
+					 (nhtids + ntids) * sizeof(ItemPointerData)) <= maxpostingsize)
+		{
+			/* add it to the current run */
+			nitems++;
+			nhtids += ntids;
+			continue;
+		}
+
+		/* the current run ends here; remember it if worth merging */
+		if (nitems > 1)
+		{
+			intervals[nintervals].baseoff = baseoff;
+			intervals[nintervals].nitems = nitems;
+			nintervals++;
+		}
+
+		if (ItemIdIsDead(itemId))
+			nitems = 0;
+		else
+		{
+			base = itup;
+			baseoff = offnum;
+			nitems = 1;
+			nhtids = ntids;
+		}
+	}
+	if (nitems > 1)
+	{
+		intervals[nintervals].baseoff = baseoff;
+		intervals[nintervals].nitems = nitems;
+		nintervals++;
+	}
+
+	if (nintervals == 0)
+		return;
+
+	/* Build the new page before going into the critical section */
+	newpage = _bt_dedup_build_page(page, intervals, nintervals);
+
+	/* No ereport(ERROR) until changes are logged */
+	START_CRIT_SECTION();
+
+	PageRestoreTempPage(newpage, page);
+	MarkBufferDirty(buffer);
+
+	/* XLOG stuff */
+	if (RelationNeedsWAL(rel))
+	{
+		XLogRecPtr	recptr;
+		xl_btree_dedup xlrec;
+
+		xlrec.nintervals = nintervals;
+
+		XLogBeginInsert();
+		XLogRegisterBuffer(0, buffer, REGBUF_STANDARD);
+		XLogRegisterData((char *) &xlrec, SizeOfBtreeDedup);
+
+		/*
+		 * The intervals array is not in the buffer, but pretend that it is,
+		 * so that it needn't be stored with a full-page image.
+		 */
+		XLogRegisterBufData(0, (char *) intervals,
+							nintervals * sizeof(BTDedupInterval));
+
+		recptr = XLogInsert(RM_BTREE_ID, XLOG_BTREE_DEDUP);
+
+		PageSetLSN(page, recptr);
+	}
+
+	END_CRIT_SECTION();
+}
+
 /*
  * _bt_vacuum_one_page - vacuum just one index page.
  *
@@ -2194,3 +2463,173 @@ _bt_vacuum_one_page(Relation rel, Buffer buffer, Relation heapRel)
 	 * the page.
 	 */
 }
+
+/*
+ * _bt_bottomup_delete - delete old versions of the new tuple's key from a
+ *		leaf page that would otherwise have to be split.
+ *
+ * An UPDATE that can't be HOT inserts a new entry into every index, even
+ * those whose key didn't change, so a frequently updated row leaves a run
+ * of duplicates behind in such an index.  Until some scan happens to visit
+ * them and set LP_DEAD, nothing removes the entries for versions that have
+ * since become dead, and the page splits.  So before splitting, look up the
+ * heap tuples of the duplicates of the new key, and delete the entries whose
+ * every heap tuple is dead to all transactions, as _bt_check_unique would
+ * have marked them.  A posting list tuple goes only if all its TIDs are.
+ *
+ * The heap blocks holding the most candidates are visited first, and at most
+ * BTREE_BOTTOMUP_MAX_BLOCKS of them, to bound the cost of a page full of
+ * duplicates that are all live.  Returns true if anything was deleted.  The
+ * passed buffer must be exclusive-locked.
+ */
+static bool
+_bt_bottomup_delete(Relation rel, Buffer buffer, int keysz, ScanKey scankey,
+					Relation heapRel)
+{
+	Page		page = BufferGetPage(buffer);
+	OffsetNumber deletable[MaxOffsetNumber];
+	int			ndeletable = 0;
+	uint16		nlive[MaxOffsetNumber + 1];
+	BTBottomUpTid *tids;
+	int			ntids = 0;
+	BTBottomUpBlock *blocks;
+	int			nblocks = 0;
+	OffsetNumber offnum,
+				minoff,
+				maxoff;
+	int			i;
+
+	minoff = _bt_binsrch(rel, buffer, keysz, scankey, false);
+	maxoff = PageGetMaxOffsetNumber(page);
+	Assert(minoff >=
+		   P_FIRSTDATAKEY((BTPageOpaque) PageGetSpecialPointer(page)));
+
+	/* Collect the heap TIDs of all duplicates of the new key */
+	tids = (BTBottomUpTid *) palloc(BLCKSZ / sizeof(ItemPointerData) *
+									sizeof(BTBottomUpTid));
+	for (offnum = minoff;
+		 offnum <= maxoff;
+		 offnum = OffsetNumberNext(offnum))
+	{
+		ItemId		itemId = PageGetItemId(page, offnum);
+		IndexTuple	itup;
+		int			j;
+
+		if (_bt_compare(rel, keysz, scankey, page, offnum) != 0)
+			break;
+
+		if (ItemIdIsDead(itemId))
+		{
+			deletable[ndeletable++] = offnum;
+			continue;
+		}
+
+		itup = (IndexTuple) PageGetItem(page, itemId);
+		nlive[offnum] = BTreeTupleGetNHeapTIDs(itup);
+		for (j = 0; j < nlive[offnum]; j++)
+		{
+			tids[ntids].htid = BTreeTupleGetHeapTID(itup)[j];
+			tids[ntids].offnum = offnum;
+			ntids++;
+		}
+	}
+
+	if (ntids == 0 && ndeletable == 0)
+	{
+		pfree(tids);
+		return false;
+	}
+
+	/* Group them by heap block, and pick the blocks with the most */
+	qsort(tids, ntids, sizeof(BTBottomUpTid), _bt_bottomup_tid_cmp);
+	blocks = (BTBottomUpBlock *) palloc(Max(ntids, 1) *
+										sizeof(BTBottomUpBlock));
+	for (i = 0; i < ntids; i++)
+	{
+		BlockNumber blkno = ItemPointerGetBlockNumber(&tids[i].htid);
+
+		if (nblocks == 0 || blocks[nblocks - 1].blkno != blkno)
+		{
+			blocks[nblocks].blkno = blkno;
+			blocks[nblocks].first = i;
+			blocks[nblocks].ntids = 0;
+			nblocks++;
+		}
+		blocks[nblocks - 1].ntids++;
+	}
+	qsort(blocks, nblocks, sizeof(BTBottomUpBlock), _bt_bottomup_block_cmp);
+
+	for (i = 0; i < Min(nblocks, BTREE_BOTTOMUP_MAX_BLOCKS); i++)
+	{
+		Buffer		hbuffer;
+		int			j;
+
+		hbuffer = ReadBuffer(heapRel, blocks[i].blkno);
+		LockBuffer(hbuffer, BUFFER_LOCK_SHARE);
+		for (j = blocks[i].first; j < blocks[i].first + blocks[i].ntids; j++)
+		{
+			ItemPointerData htid = tids[j].htid;
+			HeapTupleData heapTuple;
+			bool		all_dead;
+
+			/* any snapshot that can't see dead tuples would do */
+			if (!heap_hot_search_buffer(&htid, heapRel, hbuffer, SnapshotSelf,
+										&heapTuple, &all_dead, true) &&
+				all_dead)
+				nlive[tids[j].offnum]--;
+		}
+		UnlockReleaseBuffer(hbuffer);
+	}
+
+	for (i = 0; i < ntids; i++)
+	{
+		/* TIDs of a posting list are adjacent, so this adds it just once */
+		if (nlive[tids[i].offnum] == 0)
+		{
+			deletable[ndeletable++] = tids[i].offnum;
+			nlive[tids[i].offnum] = 1;
+		}
+	}
+
+	pfree(blocks);
+	pfree(tids);
+
+	if (ndeletable == 0)
+		return false;
+
+	qsort(deletable, ndeletable, sizeof(OffsetNumber), _bt_offset_cmp);
+	_bt_delitems_delete(rel, buffer, deletable, ndeletable, heapRel);
+
+	return true;
+}
+
+/*
+ * qsort comparators for _bt_bottomup_delete
+ */
+static int
+_bt_bottomup_tid_cmp(const void *a, const void *b)
+{
+	return ItemPointerCompare((ItemPointer) &((const BTBottomUpTid *) a)->htid,
+							  (ItemPointer) &((const BTBottomUpTid *) b)->htid);
+}
+
+static int
+_bt_bottomup_block_cmp(const void *a, const void *b)
+{
+	const BTBottomUpBlock *ba = (const BTBottomUpBlock *) a;
+	const BTBottomUpBlock *bb = (const BTBottomUpBlock *) b;
+
+	/* most TIDs first; among equals, in physical order */
+	if (ba->ntids != bb->ntids)
+		return (ba->ntids > bb->ntids) ? -1 : 1;
+	return (ba->blkno > bb->blkno) ? 1 : ((ba->blkno < bb->blkno) ? -1 : 0);
+}
+
+static int
+_bt_offset_cmp(const void *a, const void *b)
+{
+	OffsetNumber oa = *(const OffsetNumber *) a;
+	OffsetNumber ob = *(const OffsetNumber *) b;
+
+	return (oa > ob) ? 1 : ((oa < ob) ? -1 : 0);
+}
@@ -32,6 +32,7 @@
 #include "storage/predicate.h"
 #include "utils/snapmgr.h"
 
+static uint32 _bt_getversion(Relation rel);
 static bool _bt_mark_page_halfdead(Relation rel, Buffer buf, BTStack stack);
 static bool _bt_unlink_halfdead_page(Relation rel, Buffer leafbuf,
 						 bool *rightsib_empty);
@@ -122,7 +123,7 @@ _bt_getroot(Relation rel, int access)
 		metad = (BTMetaPageData *) rel->rd_amcache;
 		/* We shouldn't have cached it if any of these fail */
 		Assert(metad->btm_magic == BTREE_MAGIC);
-		Assert(metad->btm_version == BTREE_VERSION);
+		Assert(metad->btm_version >= BTREE_MIN_VERSION);
 		Assert(metad->btm_root != P_NONE);
 
 		rootblkno = metad->btm_fastroot;
@@ -168,12 +169,13 @@ _bt_getroot(Relation rel, int access)
 				 errmsg("index \"%s\" is not a btree",
 						RelationGetRelationName(rel))));
 
-	if (metad->btm_version != BTREE_VERSION)
+	if (metad->btm_version < BTREE_MIN_VERSION ||
+		metad->btm_version > BTREE_VERSION)
 		ereport(ERROR,
 				(errcode(ERRCODE_INDEX_CORRUPTED),
-				 errmsg("version mismatch in index \"%s\": file version %d, code version %d",
+				 errmsg("version mismatch in index \"%s\": file version %d, current version %d, minimal supported version %d",
 						RelationGetRelationName(rel),
-						metad->btm_version, BTREE_VERSION)));
+						metad->btm_version, BTREE_VERSION, BTREE_MIN_VERSION)));
 
 	/* if no root page initialized yet, do it */
 	if (metad->btm_root == P_NONE)
@@ -246,6 +248,7 @@ _bt_getroot(Relation rel, int access)
 			md.level = 0;
 			md.fastroot = rootblkno;
 			md.fastlevel = 0;
+			md.version = metad->btm_version;
 
 			XLogRegisterBufData(2, (char *) &md, sizeof(xl_btree_metadata));
 
@@ -371,12 +374,13 @@ _bt_gettrueroot(Relation rel)
 				 errmsg("index \"%s\" is not a btree",
 						RelationGetRelationName(rel))));
 
-	if (metad->btm_version != BTREE_VERSION)
+	if (metad->btm_version < BTREE_MIN_VERSION ||
+		metad->btm_version > BTREE_VERSION)
 		ereport(ERROR,
 				(errcode(ERRCODE_INDEX_CORRUPTED),
-				 errmsg("version mismatch in index \"%s\": file version %d, code version %d",
+				 errmsg("version mismatch in index \"%s\": file version %d, current version %d, minimal supported version %d",
 						RelationGetRelationName(rel),
-						metad->btm_version, BTREE_VERSION)));
+						metad->btm_version, BTREE_VERSION, BTREE_MIN_VERSION)));
 
 	/* if no root page initialized yet, fail */
 	if (metad->btm_root == P_NONE)
@@ -458,12 +462,13 @@ _bt_getrootheight(Relation rel)
 					 errmsg("index \"%s\" is not a btree",
 							RelationGetRelationName(rel))));
 
-		if (metad->btm_version != BTREE_VERSION)
+		if (metad->btm_version < BTREE_MIN_VERSION ||
+			metad->btm_version > BTREE_VERSION)
 			ereport(ERROR,
 					(errcode(ERRCODE_INDEX_CORRUPTED),
-					 errmsg("version mismatch in index \"%s\": file version %d, code version %d",
+					 errmsg("version mismatch in index \"%s\": file version %d, current version %d, minimal supported version %d",
 							RelationGetRelationName(rel),
-							metad->btm_version, BTREE_VERSION)));
+							metad->btm_version, BTREE_VERSION, BTREE_MIN_VERSION)));
 
 		/*
 		 * If there's no root page yet, _bt_getroot() doesn't expect a cache
@@ -489,12 +494,60 @@ _bt_getrootheight(Relation rel)
 	metad = (BTMetaPageData *) rel->rd_amcache;
 	/* We shouldn't have cached it if any of these fail */
 	Assert(metad->btm_magic == BTREE_MAGIC);
-	Assert(metad->btm_version == BTREE_VERSION);
+	Assert(metad->btm_version >= BTREE_MIN_VERSION);
 	Assert(metad->btm_fastroot != P_NONE);
 
 	return metad->btm_fastlevel;
 }
 
+/*
+ *	_bt_dedup_allowed() -- May leaf items of the index be merged into
+ *						   posting list tuples?
+ *
+ *		Unique indexes aren't deduplicated: they have few duplicates, and the
+ *		uniqueness check expects to visit each heap TID's index item.  Nor
+ *		are indexes still in an older on-disk version.  The metapage data is
+ *		taken from the relcache if possible, as in _bt_getrootheight().
+ */
+bool
+_bt_dedup_allowed(Relation rel)
+{
+	if (rel->rd_index->indisunique)
+		return false;
+
+	return _bt_getversion(rel) >= BTREE_VERSION_DEDUP;
+}
+
+/*
+ *	_bt_truncate_allowed() -- May leaf page splits make truncated pivot
+ *							  tuples?
+ *
+ *		Only in indexes whose metapage version knows about them.
+ */
+bool
+_bt_truncate_allowed(Relation rel)
+{
+	return _bt_getversion(rel) >= BTREE_VERSION_TRUNCATE;
+}
+
+/*
+ *	_bt_getversion() -- Get the on-disk version of the index, from the
+ *						relcache if possible, as in _bt_getrootheight().
+ *
+ *		Returns 0 if there is no root page yet.
+ */
+static uint32
+_bt_getversion(Relation rel)
+{
+	if (rel->rd_amcache == NULL)
+		(void) _bt_getrootheight(rel);
+
+	if (rel->rd_amcache == NULL)
+		return 0;
+
+	return ((BTMetaPageData *) rel->rd_amcache)->btm_version;
+}
+
 /*
  *	_bt_checkpage() -- Verify that a freshly-read page looks sane.
  */
@@ -774,6 +827,10 @@ _bt_page_recyclable(Page page)
  * This routine assumes that the caller has pinned and locked the buffer.
  * Also, the given itemnos *must* appear in increasing order in the array.
  *
+ * Posting list tuples that have lost only some of their heap TIDs are
+ * given in updatedoffs, with their replacement tuples in updated; those
+ * are overwritten in place before the whole-item deletions are done.
+ *
  * We record VACUUMs and b-tree deletes differently in WAL. InHotStandby
  * we need to be able to pin all of the blocks in the btree in physical
  * order when replaying the effects of a VACUUM, just as we do for the
@@ -787,15 +844,44 @@ _bt_page_recyclable(Page page)
 void
 _bt_delitems_vacuum(Relation rel, Buffer buf,
 					OffsetNumber *itemnos, int nitems,
-					BlockNumber lastBlockVacuumed)
+					OffsetNumber *updatedoffs, IndexTuple *updated,
+					int nupdated, BlockNumber lastBlockVacuumed)
 {
 	Page		page = BufferGetPage(buf);
 	BTPageOpaque opaque;
+	char	   *updatedbuf = NULL;
+	Size		updatedbuflen = 0;
+	int			i;
+
+	/*
+	 * Gather the replacement tuples into one chunk for WAL, while we can
+	 * still allocate memory.
+	 */
+	if (nupdated > 0 && RelationNeedsWAL(rel))
+	{
+		for (i = 0; i < nupdated; i++)
+			updatedbuflen += IndexTupleSize(updated[i]);
+		updatedbuf = (char *) palloc(updatedbuflen);
+		updatedbuflen = 0;
+		for (i = 0; i < nupdated; i++)
+		{
+			memcpy(updatedbuf + updatedbuflen, updated[i],
+				   IndexTupleSize(updated[i]));
+			updatedbuflen += IndexTupleSize(updated[i]);
+		}
+	}
 
 	/* No ereport(ERROR) until changes are logged */
 	START_CRIT_SECTION();
 
-	/* Fix the page */
+	/* Fix the page; updates first, since deletions renumber the items */
+	for (i = 0; i < nupdated; i++)
+	{
+		if (!PageIndexTupleOverwrite(page, updatedoffs[i], (Item) updated[i],
+									 IndexTupleSize(updated[i])))
+			elog(PANIC, "failed to update posting list tuple in index \"%s\"",
+				 RelationGetRelationName(rel));
+	}
 	if (nitems > 0)
 		PageIndexMultiDelete(page, itemnos, nitems);
 
@@ -824,6 +910,8 @@ _bt_delitems_vacuum(Relation rel, Buffer buf,
 		xl_btree_vacuum xlrec_vacuum;
 
 		xlrec_vacuum.lastBlockVacuumed = lastBlockVacuumed;
+		xlrec_vacuum.ndeleted = nitems;
+		xlrec_vacuum.nupdated = nupdated;
 
 		XLogBeginInsert();
 		XLogRegisterBuffer(0, buf, REGBUF_STANDARD);
@@ -836,6 +924,12 @@ _bt_delitems_vacuum(Relation rel, Buffer buf,
 		 */
 		if (nitems > 0)
 			XLogRegisterBufData(0, (char *) itemnos, nitems * sizeof(OffsetNumber));
+		if (nupdated > 0)
+		{
+			XLogRegisterBufData(0, (char *) updatedoffs,
+								nupdated * sizeof(OffsetNumber));
+			XLogRegisterBufData(0, updatedbuf, updatedbuflen);
+		}
 
 		recptr = XLogInsert(RM_BTREE_ID, XLOG_BTREE_VACUUM);
 
@@ -843,6 +937,9 @@ _bt_delitems_vacuum(Relation rel, Buffer buf,
 	}
 
 	END_CRIT_SECTION();
+
+	if (updatedbuf)
+		pfree(updatedbuf);
 }
 
 /*
@@ -1254,8 +1351,10 @@ _bt_pagedel(Relation rel, Buffer buf)
 				/* we need an insertion scan key for the search, so build one */
 				itup_scankey = _bt_mkscankey(rel, targetkey);
 				/* find the leftmost leaf page containing this key */
-				stack = _bt_search(rel, rel->rd_rel->relnatts, itup_scankey,
-								   false, &lbuf, BT_READ);
+				stack = _bt_search(rel,
+								   Min(BTreeTupleGetNAtts(targetkey, rel),
+									   IndexRelationGetNumberOfKeyAttributes(rel)),
+								   itup_scankey, false, &lbuf, BT_READ);
 				/* don't need a pin on the page */
 				_bt_relbuf(rel, lbuf);
 
@@ -1422,7 +1521,7 @@ _bt_mark_page_halfdead(Relation rel, Buffer leafbuf, BTStack stack)
 
 	itemid = PageGetItemId(page, topoff);
 	itup = (IndexTuple) PageGetItem(page, itemid);
-	ItemPointerSet(&(itup->t_tid), rightsib, P_HIKEY);
+	BTreeTupleSetDownLink(itup, rightsib);
 
 	nextoffset = OffsetNumberNext(topoff);
 	PageIndexTupleDelete(page, nextoffset);
@@ -1813,6 +1912,7 @@ _bt_unlink_halfdead_page(Relation rel, Buffer leafbuf, bool *rightsib_empty)
 			xlmeta.level = metad->btm_level;
 			xlmeta.fastroot = metad->btm_fastroot;
 			xlmeta.fastlevel = metad->btm_fastlevel;
+			xlmeta.version = metad->btm_version;
 
 			XLogRegisterBufData(4, (char *) &xlmeta, sizeof(xl_btree_metadata));
 			xlinfo = XLOG_BTREE_UNLINK_PAGE_META;
@@ -31,22 +31,6 @@
 #include "utils/memutils.h"
 
 
-/* Working state for btbuild and its callback */
-typedef struct
-{
-	bool		isUnique;
-	bool		haveDead;
-	Relation	heapRel;
-	BTSpool    *spool;
-
-	/*
-	 * spool2 is needed only when the index is a unique index. Dead tuples are
-	 * put into spool2 instead of spool in order to avoid uniqueness check.
-	 */
-	BTSpool    *spool2;
-	double		indtuples;
-} BTBuildState;
-
 /* Working state needed by btvacuumpage */
 typedef struct
 {
@@ -62,12 +46,6 @@ typedef struct
 } BTVacState;
 
 
-static void btbuildCallback(Relation index,
-				HeapTuple htup,
-				Datum *values,
-				bool *isnull,
-				bool tupleIsAlive,
-				void *state);
 static void btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 			 IndexBulkDeleteCallback callback, void *callback_state,
 			 BTCycleId cycleid);
@@ -87,6 +65,7 @@ btbuild(PG_FUNCTION_ARGS)
 	IndexBuildResult *result;
 	double		reltuples;
 	BTBuildState buildstate;
+	int			nworkers;
 
 	buildstate.isUnique = indexInfo->ii_Unique;
 	buildstate.haveDead = false;
@@ -108,36 +87,48 @@ btbuild(PG_FUNCTION_ARGS)
 		elog(ERROR, "index \"%s\" already contains data",
 			 RelationGetRelationName(index));
 
-	buildstate.spool = _bt_spoolinit(heap, index, indexInfo->ii_Unique, false);
-
 	/*
-	 * If building a unique index, put dead tuples in a second spool to keep
-	 * them out of the uniqueness check.
+	 * On a large enough table, let parallel workers scan and sort parts of
+	 * the heap.  That does the whole build, see nbtsort.c.
 	 */
-	if (indexInfo->ii_Unique)
-		buildstate.spool2 = _bt_spoolinit(heap, index, false, true);
+	nworkers = _bt_parallel_workers(heap, indexInfo);
+	if (nworkers > 0)
+		reltuples = _bt_parallel_build(&buildstate, index, indexInfo,
+									   nworkers);
+	else
+	{
+		buildstate.spool = _bt_spoolinit(heap, index, indexInfo->ii_Unique,
+										 false);
 
-	/* do the heap scan */
-	reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
-								   btbuildCallback, (void *) &buildstate);
+		/*
+		 * If building a unique index, put dead tuples in a second spool to
+		 * keep them out of the uniqueness check.
+		 */
+		if (indexInfo->ii_Unique)
+			buildstate.spool2 = _bt_spoolinit(heap, index, false, true);
 
-	/* okay, all heap tuples are indexed */
-	if (buildstate.spool2 && !buildstate.haveDead)
-	{
-		/* spool2 turns out to be unnecessary */
-		_bt_spooldestroy(buildstate.spool2);
-		buildstate.spool2 = NULL;
-	}
+		/* do the heap scan */
+		reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
+									   btbuildCallback, (void *) &buildstate);
 
-	/*
-	 * Finish the build by (1) completing the sort of the spool file, (2)
-	 * inserting the sorted tuples into btree pages and (3) building the upper
-	 * levels.
-	 */
-	_bt_leafbuild(buildstate.spool, buildstate.spool2);
-	_bt_spooldestroy(buildstate.spool);
-	if (buildstate.spool2)
-		_bt_spooldestroy(buildstate.spool2);
+		/* okay, all heap tuples are indexed */
+		if (buildstate.spool2 && !buildstate.haveDead)
+		{
+			/* spool2 turns out to be unnecessary */
+			_bt_spooldestroy(buildstate.spool2);
+			buildstate.spool2 = NULL;
+		}
+
+		/*
+		 * Finish the build by (1) completing the sort of the spool file, (2)
+		 * inserting the sorted tuples into btree pages and (3) building the
+		 * upper levels.
+		 */
+		_bt_leafbuild(buildstate.spool, buildstate.spool2);
+		_bt_spooldestroy(buildstate.spool);
+		if (buildstate.spool2)
+			_bt_spooldestroy(buildstate.spool2);
+	}
 
 #ifdef BTREE_BUILD_STATS
 	if (log_btree_build_stats)
@@ -159,9 +150,9 @@ btbuild(PG_FUNCTION_ARGS)
 }
 
 /*
- * Per-tuple callback from IndexBuildHeapScan
+ * Per-tuple callback from IndexBuildHeapScan; also used by parallel builds
  */
-static void
+void
 btbuildCallback(Relation index,
 				HeapTuple htup,
 				Datum *values,
@@ -275,6 +266,10 @@ btgettuple(PG_FUNCTION_ARGS)
 		_bt_start_array_keys(scan, dir);
 	}
 
+	/* Likewise for the skip key of a skip scan */
+	if (so->skipActive && !BTScanPosIsValid(so->currPos))
+		_bt_start_skip_key(scan, dir);
+
 	/* This loop handles advancing to the next array elements, if any */
 	do
 	{
@@ -303,8 +298,8 @@ btgettuple(PG_FUNCTION_ARGS)
 				 */
 				if (so->killedItems == NULL)
 					so->killedItems = (int *)
-						palloc(MaxIndexTuplesPerPage * sizeof(int));
-				if (so->numKilled < MaxIndexTuplesPerPage)
+						palloc(MaxTIDsPerBTreePage * sizeof(int));
+				if (so->numKilled < MaxTIDsPerBTreePage)
 					so->killedItems[so->numKilled++] = so->currPos.itemIndex;
 			}
 
@@ -317,8 +312,9 @@ btgettuple(PG_FUNCTION_ARGS)
 		/* If we have a tuple, return it ... */
 		if (res)
 			break;
-		/* ... otherwise see if we have more array keys to deal with */
-	} while (so->numArrayKeys && _bt_advance_array_keys(scan, dir));
+		/* ... otherwise see if we have more array or skip keys to deal with */
+	} while ((so->numArrayKeys || so->skipActive) &&
+			 _bt_advance_scan_keys(scan, dir));
 
 	PG_RETURN_BOOL(res);
 }
@@ -333,7 +329,13 @@ btgetbitmap(PG_FUNCTION_ARGS)
 	TIDBitmap  *tbm = (TIDBitmap *) PG_GETARG_POINTER(1);
 	BTScanOpaque so = (BTScanOpaque) scan->opaque;
 	int64		ntids = 0;
-	ItemPointer heapTid;
+
+	/*
+	 * The TIDs are handed to the bitmap in batches, which lets it look up
+	 * the page just once for consecutive TIDs on the same page.
+	 */
+	ItemPointerData tids[MaxIndexTuplesPerPage];
+	int			nbatch = 0;
 
 	/*
 	 * If we have any array keys, initialize them.
@@ -347,6 +349,9 @@ btgetbitmap(PG_FUNCTION_ARGS)
 		_bt_start_array_keys(scan, ForwardScanDirection);
 	}
 
+	if (so->skipActive)
+		_bt_start_skip_key(scan, ForwardScanDirection);
+
 	/* This loop handles advancing to the next array elements, if any */
 	do
 	{
@@ -354,8 +359,12 @@ btgetbitmap(PG_FUNCTION_ARGS)
 		if (_bt_first(scan, ForwardScanDirection))
 		{
 			/* Save tuple ID, and continue scanning */
-			heapTid = &scan->xs_ctup.t_self;
-			tbm_add_tuples(tbm, heapTid, 1, false);
+			if (nbatch >= MaxIndexTuplesPerPage)
+			{
+				tbm_add_tuples(tbm, tids, nbatch, false);
+				nbatch = 0;
+			}
+			tids[nbatch++] = scan->xs_ctup.t_self;
 			ntids++;
 
 			for (;;)
@@ -372,13 +381,21 @@ btgetbitmap(PG_FUNCTION_ARGS)
 				}
 
 				/* Save tuple ID, and continue scanning */
-				heapTid = &so->currPos.items[so->currPos.itemIndex].heapTid;
-				tbm_add_tuples(tbm, heapTid, 1, false);
+				if (nbatch >= MaxIndexTuplesPerPage)
+				{
+					tbm_add_tuples(tbm, tids, nbatch, false);
+					nbatch = 0;
+				}
+				tids[nbatch++] = so->currPos.items[so->currPos.itemIndex].heapTid;
 				ntids++;
 			}
 		}
-		/* Now see if we have more array keys to deal with */
-	} while (so->numArrayKeys && _bt_advance_array_keys(scan, ForwardScanDirection));
+		/* Now see if we have more array or skip keys to deal with */
+	} while ((so->numArrayKeys || so->skipActive) &&
+			 _bt_advance_scan_keys(scan, ForwardScanDirection));
+
+	if (nbatch > 0)
+		tbm_add_tuples(tbm, tids, nbatch, false);
 
 	PG_RETURN_INT64(ntids);
 }
@@ -405,8 +422,9 @@ btbeginscan(PG_FUNCTION_ARGS)
 	so = (BTScanOpaque) palloc(sizeof(BTScanOpaqueData));
 	BTScanPosInvalidate(so->currPos);
 	BTScanPosInvalidate(so->markPos);
+	/* leave room for the extra key of a skip scan */
 	if (scan->numberOfKeys > 0)
-		so->keyData = (ScanKey) palloc(scan->numberOfKeys * sizeof(ScanKeyData));
+		so->keyData = (ScanKey) palloc((scan->numberOfKeys + 1) * sizeof(ScanKeyData));
 	else
 		so->keyData = NULL;
 
@@ -415,6 +433,9 @@ btbeginscan(PG_FUNCTION_ARGS)
 	so->arrayKeys = NULL;
 	so->arrayContext = NULL;
 
+	so->skipInfo = NULL;		/* until needed */
+	so->skipActive = false;
+
 	so->killedItems = NULL;		/* until needed */
 	so->numKilled = 0;
 
@@ -493,6 +514,9 @@ btrescan(PG_FUNCTION_ARGS)
 	/* If any keys are SK_SEARCHARRAY type, set up array-key info */
 	_bt_preprocess_array_keys(scan);
 
+	/* See if we can do a skip scan */
+	_bt_preprocess_skip_key(scan);
+
 	PG_RETURN_VOID();
 }
 
@@ -525,6 +549,12 @@ btendscan(PG_FUNCTION_ARGS)
 	/* so->arrayKeyData and so->arrayKeys are in arrayContext */
 	if (so->arrayContext != NULL)
 		MemoryContextDelete(so->arrayContext);
+	if (so->skipInfo != NULL)
+	{
+		MemoryContextDelete(so->skipInfo->skipContext);
+		pfree(so->skipInfo->inKeys);
+		pfree(so->skipInfo);
+	}
 	if (so->killedItems != NULL)
 		pfree(so->killedItems);
 	if (so->currTuples != NULL)
@@ -564,6 +594,8 @@ btmarkpos(PG_FUNCTION_ARGS)
 	/* Also record the current positions of any array keys */
 	if (so->numArrayKeys)
 		_bt_mark_array_keys(scan);
+	if (so->skipActive)
+		_bt_mark_skip_key(scan);
 
 	PG_RETURN_VOID();
 }
@@ -580,6 +612,8 @@ btrestrpos(PG_FUNCTION_ARGS)
 	/* Restore the marked positions of any array keys */
 	if (so->numArrayKeys)
 		_bt_restore_array_keys(scan);
+	if (so->skipActive)
+		_bt_restore_skip_key(scan);
 
 	if (so->markItemIndex >= 0)
 	{
@@ -847,7 +881,8 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 								 RBM_NORMAL, info->strategy);
 		LockBufferForCleanup(buf);
 		_bt_checkpage(rel, buf);
-		_bt_delitems_vacuum(rel, buf, NULL, 0, vstate.lastBlockVacuumed);
+		_bt_delitems_vacuum(rel, buf, NULL, 0, NULL, NULL, 0,
+							vstate.lastBlockVacuumed);
 		_bt_relbuf(rel, buf);
 	}
 
@@ -945,6 +980,12 @@ restart:
 	{
 		OffsetNumber deletable[MaxOffsetNumber];
 		int			ndeletable;
+		OffsetNumber updatedoffs[MaxIndexTuplesPerPage];
+		IndexTuple	updated[MaxIndexTuplesPerPage];
+		int			nupdated;
+		ItemPointer livetids = NULL;
+		double		nhtidsdead;
+		double		nhtidslive;
 		OffsetNumber offnum,
 					minoff,
 					maxoff;
@@ -981,24 +1022,66 @@ restart:
 
 		/*
 		 * Scan over all items to see which ones need deleted according to the
-		 * callback function.
+		 * callback function.  A posting list tuple is deleted once all its
+		 * heap TIDs are to go, and replaced by one with the rest of them if
+		 * only some are.  We count heap TIDs rather than index tuples, so
+		 * that the statistics are comparable with the heap's.
 		 */
 		ndeletable = 0;
+		nupdated = 0;
+		nhtidsdead = 0;
+		nhtidslive = 0;
 		minoff = P_FIRSTDATAKEY(opaque);
 		maxoff = PageGetMaxOffsetNumber(page);
-		if (callback)
+		for (offnum = minoff;
+			 offnum <= maxoff;
+			 offnum = OffsetNumberNext(offnum))
 		{
-			for (offnum = minoff;
-				 offnum <= maxoff;
-				 offnum = OffsetNumberNext(offnum))
+			IndexTuple	itup;
+			ItemPointer htup;
+
+			itup = (IndexTuple) PageGetItem(page,
+											PageGetItemId(page, offnum));
+
+			if (BTreeTupleIsPosting(itup))
 			{
-				IndexTuple	itup;
-				ItemPointer htup;
+				int			nposting = BTreeTupleGetNPosting(itup);
+				int			nlive = 0;
+				int			j;
 
-				itup = (IndexTuple) PageGetItem(page,
-												PageGetItemId(page, offnum));
-				htup = &(itup->t_tid);
+				if (!callback)
+				{
+					nhtidslive += nposting;
+					continue;
+				}
 
+				if (livetids == NULL)
+					livetids = (ItemPointer)
+						palloc(MaxTIDsPerBTreePage * sizeof(ItemPointerData));
+
+				for (j = 0; j < nposting; j++)
+				{
+					htup = BTreeTupleGetPostingN(itup, j);
+					if (!callback(htup, callback_state))
+						livetids[nlive++] = *htup;
+				}
+
+				if (nlive == 0)
+					deletable[ndeletable++] = offnum;
+				else if (nlive < nposting)
+				{
+					updatedoffs[nupdated] = offnum;
+					updated[nupdated] = _bt_form_posting(itup, livetids, nlive);
+					nupdated++;
+				}
+				nhtidsdead += nposting - nlive;
+				nhtidslive += nlive;
+				continue;
+			}
+
+			htup = &(itup->t_tid);
+			if (callback)
+			{
 				/*
 				 * During Hot Standby we currently assume that
 				 * XLOG_BTREE_VACUUM records do not produce conflicts. That is
@@ -1021,15 +1104,20 @@ restart:
 				 * killed.
 				 */
 				if (callback(htup, callback_state))
+				{
 					deletable[ndeletable++] = offnum;
+					nhtidsdead++;
+					continue;
+				}
 			}
+			nhtidslive++;
 		}
 
 		/*
-		 * Apply any needed deletes.  We issue just one _bt_delitems_vacuum()
-		 * call per page, so as to minimize WAL traffic.
+		 * Apply any needed deletes and updates.  We issue just one
+		 * _bt_delitems_vacuum() call per page, so as to minimize WAL traffic.
 		 */
-		if (ndeletable > 0)
+		if (ndeletable > 0 || nupdated > 0)
 		{
 			/*
 			 * Notice that the issued XLOG_BTREE_VACUUM WAL record includes an
@@ -1043,6 +1131,7 @@ restart:
 			 * that.
 			 */
 			_bt_delitems_vacuum(rel, buf, deletable, ndeletable,
+								updatedoffs, updated, nupdated,
 								vstate->lastBlockVacuumed);
 
 			/*
@@ -1052,9 +1141,12 @@ restart:
 			if (blkno > vstate->lastBlockVacuumed)
 				vstate->lastBlockVacuumed = blkno;
 
-			stats->tuples_removed += ndeletable;
+			stats->tuples_removed += nhtidsdead;
 			/* must recompute maxoff */
 			maxoff = PageGetMaxOffsetNumber(page);
+
+			while (nupdated > 0)
+				pfree(updated[--nupdated]);
 		}
 		else
 		{
@@ -1084,7 +1176,10 @@ restart:
 		if (minoff > maxoff)
 			delete_now = (blkno == orig_blkno);
 		else
-			stats->num_index_tuples += maxoff - minoff + 1;
+			stats->num_index_tuples += nhtidslive;
+
+		if (livetids)
+			pfree(livetids);
 	}
 
 	if (delete_now)
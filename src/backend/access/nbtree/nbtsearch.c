@@ -20,6 +20,7 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/predicate.h"
+#include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/tqual.h"
@@ -29,10 +30,15 @@ static bool _bt_readpage(IndexScanDesc scan, ScanDirection dir,
 			 OffsetNumber offnum);
 static void _bt_saveitem(BTScanOpaque so, int itemIndex,
 			 OffsetNumber offnum, IndexTuple itup);
+static void _bt_savepostingitems(BTScanOpaque so, int itemIndex,
+					 OffsetNumber offnum, IndexTuple itup);
 static bool _bt_steppage(IndexScanDesc scan, ScanDirection dir);
 static Buffer _bt_walk_left(Relation rel, Buffer buf);
 static bool _bt_endpoint(IndexScanDesc scan, ScanDirection dir);
 static void _bt_drop_lock_and_maybe_pin(IndexScanDesc scan, BTScanPos sp);
+static inline int32 _bt_compare_datum(ScanKey scankey, Datum datum);
+static inline int32 _bt_compare_first(Relation rel, int keysz,
+				  ScanKey scankey, Page page, OffsetNumber offnum);
 
 
 /*
@@ -318,6 +324,7 @@ _bt_binsrch(Relation rel,
 				high;
 	int32		result,
 				cmpval;
+	bool		intkey;
 
 	page = BufferGetPage(buf);
 	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
@@ -351,13 +358,25 @@ _bt_binsrch(Relation rel,
 
 	cmpval = nextkey ? 0 : 1;	/* select comparison value */
 
+	/*
+	 * If the first column is an integer, most probes are decided by it alone
+	 * with a plain comparison, so take a shortcut to that.
+	 */
+	intkey = (scankey->sk_attno == 1 &&
+			  !(scankey->sk_flags & SK_ISNULL) &&
+			  (scankey->sk_func.fn_addr == btint4cmp ||
+			   scankey->sk_func.fn_addr == btint8cmp));
+
 	while (high > low)
 	{
 		OffsetNumber mid = low + ((high - low) / 2);
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, keysz, scankey, page, mid);
+		if (intkey)
+			result = _bt_compare_first(rel, keysz, scankey, page, mid);
+		else
+			result = _bt_compare(rel, keysz, scankey, page, mid);
 
 		if (result >= cmpval)
 			low = mid + 1;
@@ -407,7 +426,8 @@ _bt_binsrch(Relation rel,
  * scankey.  The actual key value stored (if any, which there probably isn't)
  * does not matter.  This convention allows us to implement the Lehman and
  * Yao convention that the first down-link pointer is before the first key.
- * See backend/access/nbtree/README for details.
+ * Likewise, any attributes that were truncated away from a pivot tuple are
+ * taken to be minus infinity.  See backend/access/nbtree/README for details.
  *----------
  */
 int32
@@ -420,6 +440,7 @@ _bt_compare(Relation rel,
 	TupleDesc	itupdesc = RelationGetDescr(rel);
 	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
 	IndexTuple	itup;
+	int			ntupatts;
 	int			i;
 
 	/*
@@ -430,6 +451,7 @@ _bt_compare(Relation rel,
 		return 1;
 
 	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+	ntupatts = BTreeTupleGetNAtts(itup, rel);
 
 	/*
 	 * The scan key is set up with the attribute number associated with each
@@ -449,6 +471,13 @@ _bt_compare(Relation rel,
 		bool		isNull;
 		int32		result;
 
+		/*
+		 * The attributes a truncated pivot tuple lacks are minus infinity, so
+		 * the scan key is greater once all the ones it has are equal.
+		 */
+		if (scankey->sk_attno > ntupatts)
+			return 1;
+
 		datum = index_getattr(itup, scankey->sk_attno, itupdesc, &isNull);
 
 		/* see comments about NULLs handling in btbuild */
@@ -469,23 +498,7 @@ _bt_compare(Relation rel,
 				result = -1;	/* NOT_NULL "<" NULL */
 		}
 		else
-		{
-			/*
-			 * The sk_func needs to be passed the index value as left arg and
-			 * the sk_argument as right arg (they might be of different
-			 * types).  Since it is convenient for callers to think of
-			 * _bt_compare as comparing the scankey to the index item, we have
-			 * to flip the sign of the comparison result.  (Unless it's a DESC
-			 * column, in which case we *don't* flip the sign.)
-			 */
-			result = DatumGetInt32(FunctionCall2Coll(&scankey->sk_func,
-													 scankey->sk_collation,
-													 datum,
-													 scankey->sk_argument));
-
-			if (!(scankey->sk_flags & SK_BT_DESC))
-				result = -result;
-		}
+			result = _bt_compare_datum(scankey, datum);
 
 		/* if the keys are unequal, return the difference */
 		if (result != 0)
@@ -498,6 +511,85 @@ _bt_compare(Relation rel,
 	return 0;
 }
 
+/*
+ * Compare one non-null scan key column to the non-null index value datum,
+ * with the result sign convention of _bt_compare.
+ *
+ * The integer opclasses' comparison functions are done inline, which saves a
+ * function call per comparison, and most of the time spent in a descent.
+ */
+static inline int32
+_bt_compare_datum(ScanKey scankey, Datum datum)
+{
+	int32		result;
+
+	if (scankey->sk_func.fn_addr == btint4cmp)
+	{
+		int32		a = DatumGetInt32(datum);
+		int32		b = DatumGetInt32(scankey->sk_argument);
+
+		result = (a > b) ? 1 : ((a == b) ? 0 : -1);
+	}
+	else if (scankey->sk_func.fn_addr == btint8cmp)
+	{
+		int64		a = DatumGetInt64(datum);
+		int64		b = DatumGetInt64(scankey->sk_argument);
+
+		result = (a > b) ? 1 : ((a == b) ? 0 : -1);
+	}
+	else
+	{
+		/*
+		 * The sk_func needs to be passed the index value as left arg and the
+		 * sk_argument as right arg (they might be of different types).
+		 */
+		result = DatumGetInt32(FunctionCall2Coll(&scankey->sk_func,
+												 scankey->sk_collation,
+												 datum,
+												 scankey->sk_argument));
+	}
+
+	/*
+	 * Since it is convenient for callers to think of _bt_compare as comparing
+	 * the scankey to the index item, we have to flip the sign of the
+	 * comparison result.  (Unless it's a DESC column, in which case we
+	 * *don't* flip the sign.)
+	 */
+	if (!(scankey->sk_flags & SK_BT_DESC))
+		result = -result;
+
+	return result;
+}
+
+/*
+ * _bt_compare, for a scankey whose first column is not null: look at only the
+ * first column of the item if it decides the comparison, which spares a
+ * function call and the setup of the general case.  Anything unusual about
+ * the item is left to _bt_compare.
+ */
+static inline int32
+_bt_compare_first(Relation rel, int keysz, ScanKey scankey, Page page,
+				  OffsetNumber offnum)
+{
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	IndexTuple	itup;
+	Datum		datum;
+	bool		isNull;
+	int32		result;
+
+	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+	if ((!P_ISLEAF(opaque) && offnum == P_FIRSTDATAKEY(opaque)) ||
+		IndexTupleHasNulls(itup) || BTreeTupleGetNAtts(itup, rel) < 1)
+		return _bt_compare(rel, keysz, scankey, page, offnum);
+
+	datum = index_getattr(itup, 1, RelationGetDescr(rel), &isNull);
+	result = _bt_compare_datum(scankey, datum);
+
+	if (result == 0 && keysz > 1)
+		return _bt_compare(rel, keysz, scankey, page, offnum);
+	return result;
+}
+
 /*
  *	_bt_first() -- Find the first item in a scan.
  *
@@ -988,6 +1080,9 @@ _bt_first(IndexScanDesc scan, ScanDirection dir)
 		PredicateLockPage(rel, BufferGetBlockNumber(buf),
 						  scan->xs_snapshot);
 
+	if (so->skipActive)
+		_bt_skip_count_descent(scan, BufferGetBlockNumber(buf));
+
 	/* initialize moreLeft/moreRight appropriately for scan direction */
 	if (ScanDirectionIsForward(dir))
 	{
@@ -1133,7 +1228,7 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 	OffsetNumber maxoff;
 	int			itemIndex;
 	IndexTuple	itup;
-	bool		continuescan;
+	bool		continuescan = true;
 
 	/*
 	 * We must have the buffer pinned and locked, but the usual macro can't be
@@ -1188,8 +1283,16 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 			if (itup != NULL)
 			{
 				/* tuple passes all scan key conditions, so remember it */
-				_bt_saveitem(so, itemIndex, offnum, itup);
-				itemIndex++;
+				if (BTreeTupleIsPosting(itup))
+				{
+					_bt_savepostingitems(so, itemIndex, offnum, itup);
+					itemIndex += BTreeTupleGetNPosting(itup);
+				}
+				else
+				{
+					_bt_saveitem(so, itemIndex, offnum, itup);
+					itemIndex++;
+				}
 			}
 			if (!continuescan)
 			{
@@ -1201,7 +1304,7 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 			offnum = OffsetNumberNext(offnum);
 		}
 
-		Assert(itemIndex <= MaxIndexTuplesPerPage);
+		Assert(itemIndex <= MaxTIDsPerBTreePage);
 		so->currPos.firstItem = 0;
 		so->currPos.lastItem = itemIndex - 1;
 		so->currPos.itemIndex = 0;
@@ -1209,7 +1312,7 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 	else
 	{
 		/* load items[] in descending order */
-		itemIndex = MaxIndexTuplesPerPage;
+		itemIndex = MaxTIDsPerBTreePage;
 
 		offnum = Min(offnum, maxoff);
 
@@ -1219,8 +1322,16 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 			if (itup != NULL)
 			{
 				/* tuple passes all scan key conditions, so remember it */
-				itemIndex--;
-				_bt_saveitem(so, itemIndex, offnum, itup);
+				if (BTreeTupleIsPosting(itup))
+				{
+					itemIndex -= BTreeTupleGetNPosting(itup);
+					_bt_savepostingitems(so, itemIndex, offnum, itup);
+				}
+				else
+				{
+					itemIndex--;
+					_bt_saveitem(so, itemIndex, offnum, itup);
+				}
 			}
 			if (!continuescan)
 			{
@@ -1234,10 +1345,15 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 
 		Assert(itemIndex >= 0);
 		so->currPos.firstItem = itemIndex;
-		so->currPos.lastItem = MaxIndexTuplesPerPage - 1;
-		so->currPos.itemIndex = MaxIndexTuplesPerPage - 1;
+		so->currPos.lastItem = MaxTIDsPerBTreePage - 1;
+		so->currPos.itemIndex = MaxTIDsPerBTreePage - 1;
 	}
 
+	/* A skip scan wants to know where each primitive scan ended */
+	if (!continuescan && so->skipActive &&
+		so->skipInfo->cur.mode != BT_SKIP_PROBE)
+		so->skipInfo->lastPage = so->currPos.currPage;
+
 	return (so->currPos.firstItem <= so->currPos.lastItem);
 }
 
@@ -1260,6 +1376,44 @@ _bt_saveitem(BTScanOpaque so, int itemIndex,
 	}
 }
 
+/*
+ * Save the heap TIDs of a posting list tuple into so->currPos.items[],
+ * starting at itemIndex.  They go in ascending TID order whatever the scan
+ * direction, which _bt_killitems relies on.  For an index-only scan, all the
+ * items share one copy of the tuple's key, stored as a plain tuple.
+ */
+static void
+_bt_savepostingitems(BTScanOpaque so, int itemIndex,
+					 OffsetNumber offnum, IndexTuple itup)
+{
+	int			nposting = BTreeTupleGetNPosting(itup);
+	LocationIndex tupleOffset = 0;
+	int			i;
+
+	if (so->currTuples)
+	{
+		Size		keysize = BTreeTupleGetKeySize(itup);
+		IndexTuple	base;
+
+		tupleOffset = so->currPos.nextTupleOffset;
+		base = (IndexTuple) (so->currTuples + tupleOffset);
+		memcpy(base, itup, keysize);
+		base->t_info &= ~(INDEX_SIZE_MASK | BT_ALT_TID);
+		base->t_info |= keysize;
+		base->t_tid = *BTreeTupleGetPosting(itup);
+		so->currPos.nextTupleOffset += MAXALIGN(keysize);
+	}
+
+	for (i = 0; i < nposting; i++)
+	{
+		BTScanPosItem *currItem = &so->currPos.items[itemIndex + i];
+
+		currItem->heapTid = *BTreeTupleGetPostingN(itup, i);
+		currItem->indexOffset = offnum;
+		currItem->tupleOffset = tupleOffset;
+	}
+}
+
 /*
  *	_bt_steppage() -- Step to next page containing valid data for scan
  *
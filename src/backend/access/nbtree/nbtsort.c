@@ -55,6 +55,14 @@
  * This code isn't concerned about the FSM at all. The caller is responsible
  * for initializing that.
  *
+ * On a large table, the scan and sort can be done in parallel (see
+ * _bt_parallel_build).  Each parallel worker, and the leader, scans a share
+ * of the heap's blocks and sorts the resulting index tuples on its own.  The
+ * workers stream their sorted runs to the leader through shm_mq's, and the
+ * leader merges them together with its own run while loading the leaf pages.
+ * Page building itself stays in the leader, so what we write is exactly what
+ * a serial build of the same tuples would produce.
+ *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -67,16 +75,60 @@
 #include "postgres.h"
 
 #include "access/nbtree.h"
+#include "access/parallel.h"
+#include "access/relscan.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xloginsert.h"
+#include "catalog/catalog.h"
+#include "catalog/index.h"
 #include "miscadmin.h"
+#include "storage/dsm_impl.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "tcop/tcopprot.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
 #include "utils/sortsupport.h"
+#include "utils/tqual.h"
 #include "utils/tuplesort.h"
 
 
+/* Magic numbers for parallel build state sharing */
+#define PARALLEL_KEY_BTREE_SHARED	UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_BTREE_SCAN		UINT64CONST(0xB000000000000002)
+#define PARALLEL_KEY_BTREE_QUEUES	UINT64CONST(0xB000000000000003)
+
+/* Size of the queue each worker streams its sorted tuples through */
+#define PARALLEL_BTREE_QUEUE_SIZE	65536
+
+/* Smallest heap, in blocks, that we consider building with a worker */
+#define PARALLEL_BTREE_MIN_PAGES	1000
+
+/* Least share of maintenance_work_mem, in kB, each participant must get */
+#define PARALLEL_BTREE_MIN_SORTMEM	(32 * 1024)
+
+/*
+ * Status record shared by the leader and the workers of a parallel build.
+ * The counters are summed up by the workers as they finish their scans.
+ */
+typedef struct BTShared
+{
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isunique;
+	bool		isconcurrent;	/* scanning with an MVCC snapshot? */
+	int			sortmem;		/* kB of sort memory for each participant */
+
+	slock_t		mutex;			/* protects the following */
+	double		reltuples;		/* # of heap tuples scanned by workers */
+	double		indtuples;		/* # of index tuples spooled by workers */
+	bool		brokenhotchain; /* did any worker see a broken HOT chain? */
+} BTShared;
+
+
 /*
  * Status record for spooling/sorting phase.  (Note we may have two of
  * these due to the special requirements for uniqueness-checking with
@@ -135,9 +187,13 @@ static void _bt_sortaddtup(Page page, Size itemsize,
 			   IndexTuple itup, OffsetNumber itup_off);
 static void _bt_buildadd(BTWriteState *wstate, BTPageState *state,
 			 IndexTuple itup);
+static void _bt_buildadd_posting(BTWriteState *wstate, BTPageState *state,
+					 IndexTuple base, ItemPointer htids, int nhtids);
 static void _bt_uppershutdown(BTWriteState *wstate, BTPageState *state);
 static void _bt_load(BTWriteState *wstate,
 		 BTSpool *btspool, BTSpool *btspool2);
+static BTSpool *_bt_spoolinit_mem(Relation heap, Relation index,
+				  bool isunique, int btKbytes);
 
 
 /*
@@ -151,13 +207,8 @@ static void _bt_load(BTWriteState *wstate,
 BTSpool *
 _bt_spoolinit(Relation heap, Relation index, bool isunique, bool isdead)
 {
-	BTSpool    *btspool = (BTSpool *) palloc0(sizeof(BTSpool));
 	int			btKbytes;
 
-	btspool->heap = heap;
-	btspool->index = index;
-	btspool->isunique = isunique;
-
 	/*
 	 * We size the sort area as maintenance_work_mem rather than work_mem to
 	 * speed index creation.  This should be OK since a single backend can't
@@ -167,6 +218,21 @@ _bt_spoolinit(Relation heap, Relation index, bool isunique, bool isdead)
 	 * work_mem.
 	 */
 	btKbytes = isdead ? work_mem : maintenance_work_mem;
+
+	return _bt_spoolinit_mem(heap, index, isunique, btKbytes);
+}
+
+/*
+ * create a spool with a sort area of the given size
+ */
+static BTSpool *
+_bt_spoolinit_mem(Relation heap, Relation index, bool isunique, int btKbytes)
+{
+	BTSpool    *btspool = (BTSpool *) palloc0(sizeof(BTSpool));
+
+	btspool->heap = heap;
+	btspool->index = index;
+	btspool->isunique = isunique;
 	btspool->sortstate = tuplesort_begin_index_btree(heap, index, isunique,
 													 btKbytes, false);
 
@@ -510,6 +576,7 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 		ItemId		ii;
 		ItemId		hii;
 		IndexTuple	oitup;
+		IndexTuple	minkey;
 
 		/* Create new page of same level */
 		npage = _bt_blnewpage(state->btps_level);
@@ -537,6 +604,28 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 		ItemIdSetUnused(ii);	/* redundant */
 		((PageHeader) opage)->pd_lower -= sizeof(ItemIdData);
 
+		/*
+		 * On the leaf level, the high key is truncated to what it takes to
+		 * tell it from the item before it, as in _bt_split(), and the new
+		 * page's downlink made from the same item below is too.  That also
+		 * cuts a posting list tuple down to a plain one.  Above the leaf
+		 * level the item is a pivot tuple already.
+		 */
+		if (state->btps_level == 0)
+		{
+			IndexTuple	lastleft;
+
+			lastleft = (IndexTuple) PageGetItem(opage,
+							   PageGetItemId(opage, OffsetNumberPrev(last_off)));
+			minkey = _bt_truncate(wstate->index, lastleft, oitup);
+			if (!PageIndexTupleOverwrite(opage, P_HIKEY, (Item) minkey,
+										 IndexTupleSize(minkey)))
+				elog(ERROR, "failed to shrink high key in index \"%s\"",
+					 RelationGetRelationName(wstate->index));
+		}
+		else
+			minkey = CopyIndexTuple(oitup);
+
 		/*
 		 * Link the old page into its parent, using its minimum key. If we
 		 * don't have a parent, we have to create one; this adds a new btree
@@ -546,7 +635,7 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 			state->btps_next = _bt_pagestate(wstate, state->btps_level + 1);
 
 		Assert(state->btps_minkey != NULL);
-		ItemPointerSet(&(state->btps_minkey->t_tid), oblkno, P_HIKEY);
+		BTreeTupleSetDownLink(state->btps_minkey, oblkno);
 		_bt_buildadd(wstate, state->btps_next, state->btps_minkey);
 		pfree(state->btps_minkey);
 
@@ -555,7 +644,7 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 		 * it off the old page, not the new one, in case we are not at leaf
 		 * level.
 		 */
-		state->btps_minkey = CopyIndexTuple(oitup);
+		state->btps_minkey = minkey;
 
 		/*
 		 * Set the sibling links for both pages.
@@ -590,7 +679,11 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 	if (last_off == P_HIKEY)
 	{
 		Assert(state->btps_minkey == NULL);
-		state->btps_minkey = CopyIndexTuple(itup);
+		if (BTreeTupleIsPosting(itup))
+			state->btps_minkey = _bt_form_posting(itup,
+												BTreeTupleGetHeapTID(itup), 1);
+		else
+			state->btps_minkey = CopyIndexTuple(itup);
 	}
 
 	/*
@@ -604,6 +697,27 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 	state->btps_lastoff = last_off;
 }
 
+/*
+ * Add a run of tuples with identical keys to the leaf level, as a posting
+ * list tuple if there's more than one, and free the copy of its first tuple.
+ */
+static void
+_bt_buildadd_posting(BTWriteState *wstate, BTPageState *state,
+					 IndexTuple base, ItemPointer htids, int nhtids)
+{
+	if (nhtids > 1)
+	{
+		IndexTuple	posting = _bt_form_posting(base, htids, nhtids);
+
+		_bt_buildadd(wstate, state, posting);
+		pfree(posting);
+	}
+	else
+		_bt_buildadd(wstate, state, base);
+
+	pfree(base);
+}
+
 /*
  * Finish writing out the completed btree.
  */
@@ -643,7 +757,7 @@ _bt_uppershutdown(BTWriteState *wstate, BTPageState *state)
 		else
 		{
 			Assert(s->btps_minkey != NULL);
-			ItemPointerSet(&(s->btps_minkey->t_tid), blkno, P_HIKEY);
+			BTreeTupleSetDownLink(s->btps_minkey, blkno);
 			_bt_buildadd(wstate, s->btps_next, s->btps_minkey);
 			pfree(s->btps_minkey);
 			s->btps_minkey = NULL;
@@ -685,7 +799,7 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 				load1;
 	TupleDesc	tupdes = RelationGetDescr(wstate->index);
 	int			i,
-				keysz = RelationGetNumberOfAttributes(wstate->index);
+				keysz = IndexRelationGetNumberOfKeyAttributes(wstate->index);
 	ScanKey		indexScanKey = NULL;
 	SortSupport sortKeys;
 
@@ -791,6 +905,49 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 		}
 		pfree(sortKeys);
 	}
+	else if (!btspool->isunique)
+	{
+		/*
+		 * Merge is unnecessary, but we can deduplicate: tuples with identical
+		 * keys come out of the sort in heap TID order, so we just collect
+		 * each run of them into a posting list tuple, as long as it stays
+		 * within BTMaxPostingSize.
+		 */
+		IndexTuple	base = NULL;
+		ItemPointer htids;
+		int			nhtids = 0;
+
+		htids = (ItemPointer) palloc(MaxTIDsPerBTreePage *
+									 sizeof(ItemPointerData));
+
+		while ((itup = tuplesort_getindextuple(btspool->sortstate,
+											   true, &should_free)) != NULL)
+		{
+			/* When we see first tuple, create first index page */
+			if (state == NULL)
+				state = _bt_pagestate(wstate, 0);
+
+			if (base != NULL && _bt_keys_identical(base, itup) &&
+				MAXALIGN(IndexTupleSize(base) +
+						 (nhtids + 1) * sizeof(ItemPointerData)) <=
+				BTMaxPostingSize(state->btps_page))
+				htids[nhtids++] = itup->t_tid;
+			else
+			{
+				if (base != NULL)
+					_bt_buildadd_posting(wstate, state, base, htids, nhtids);
+				base = CopyIndexTuple(itup);
+				htids[0] = itup->t_tid;
+				nhtids = 1;
+			}
+			if (should_free)
+				pfree(itup);
+		}
+		if (base != NULL)
+			_bt_buildadd_posting(wstate, state, base, htids, nhtids);
+
+		pfree(htids);
+	}
 	else
 	{
 		/* merge is unnecessary */
@@ -831,3 +988,299 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 		smgrimmedsync(wstate->index->rd_smgr, MAIN_FORKNUM);
 	}
 }
+
+
+/*
+ * Parallel build
+ */
+
+
+/*
+ * _bt_parallel_workers
+ *
+ * Choose the number of parallel workers for building a btree on heap, or
+ * zero to build it serially.
+ */
+int
+_bt_parallel_workers(Relation heap, IndexInfo *indexInfo)
+{
+	int			nworkers;
+	double		heap_pages;
+	double		threshold;
+
+	/*
+	 * Workers can't wait for our catalog changes to commit, and temp tables
+	 * live in our local buffers.  A concurrent build is fine: it only waits
+	 * for other transactions between its scans, when the workers are gone.
+	 */
+	if (max_parallel_maintenance_workers == 0 ||
+		!IsUnderPostmaster ||
+		IsBootstrapProcessingMode() ||
+		IsSystemRelation(heap) ||
+		RelationUsesLocalBuffers(heap) ||
+		!ActiveSnapshotSet() ||
+		IsInParallelMode() ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
+
+	/* The table's parallel_workers setting overrides our heuristics */
+	nworkers = RelationGetParallelWorkers(heap, -1);
+	if (nworkers >= 0)
+		return Min(nworkers, max_parallel_maintenance_workers);
+
+	/*
+	 * Use one worker once the heap has PARALLEL_BTREE_MIN_PAGES blocks, and
+	 * another one each time it triples in size from there.
+	 */
+	heap_pages = RelationGetNumberOfBlocks(heap);
+	if (heap_pages < PARALLEL_BTREE_MIN_PAGES)
+		return 0;
+	nworkers = 1;
+	threshold = PARALLEL_BTREE_MIN_PAGES;
+	while (heap_pages >= threshold * 3 &&
+		   nworkers < max_parallel_maintenance_workers)
+	{
+		nworkers++;
+		threshold *= 3;
+	}
+	nworkers = Min(nworkers, max_parallel_maintenance_workers);
+
+	/*
+	 * Every participant sorts in its share of maintenance_work_mem, and a
+	 * worker with too little of it does more harm than good.
+	 */
+	while (nworkers > 0 &&
+		   maintenance_work_mem / (nworkers + 1) < PARALLEL_BTREE_MIN_SORTMEM)
+		nworkers--;
+
+	return nworkers;
+}
+
+/*
+ * _bt_parallel_build
+ *
+ * Build a btree index with the help of nworkers parallel workers, filling in
+ * buildstate as btbuild's serial scan would.  Returns the number of heap
+ * tuples scanned.
+ *
+ * The leader scans part of the heap itself while the workers do the rest,
+ * then merges the workers' sorted runs with its own.  For a unique index,
+ * each worker first sends its run of dead tuples, which we simply add to our
+ * own spool2, since it is expected to be small.  We must keep reading
+ * from every queue until it is exhausted, or the worker would never finish;
+ * and we must wait for the workers before relying on any result, as a worker
+ * that fails just stops sending.
+ */
+double
+_bt_parallel_build(BTBuildState *buildstate, Relation index,
+				   IndexInfo *indexInfo, int nworkers)
+{
+	Relation	heap = buildstate->heapRel;
+	ParallelContext *pcxt;
+	BTShared   *btshared;
+	ParallelHeapScanDesc pscan;
+	Snapshot	snapshot;
+	char	   *queuespace;
+	shm_mq_handle **queues;
+	int			nqueues;
+	int			sortmem;
+	HeapScanDesc scan;
+	Tuplesortstate *localsort;
+	double		reltuples;
+	int			i;
+
+	Assert(nworkers > 0);
+
+	/* The sort memory is split evenly among the workers and us */
+	sortmem = Max(maintenance_work_mem / (nworkers + 1), 64);
+
+	/*
+	 * Non-concurrent builds see everything, while concurrent builds all
+	 * index what's live according to one MVCC snapshot, which the parallel
+	 * scan passes on to the workers; see IndexBuildHeapRangeScan.
+	 */
+	if (indexInfo->ii_Concurrent)
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+	else
+		snapshot = SnapshotAny;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(_bt_parallel_build_main, nworkers);
+
+	/* Estimate and allocate the shared state */
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(BTShared));
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   heap_parallelscan_estimate(snapshot));
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+	EstimateParallelQueues(pcxt, PARALLEL_BTREE_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	btshared = (BTShared *) shm_toc_allocate(pcxt->toc, sizeof(BTShared));
+	btshared->heaprelid = RelationGetRelid(heap);
+	btshared->indexrelid = RelationGetRelid(index);
+	btshared->isunique = indexInfo->ii_Unique;
+	btshared->isconcurrent = indexInfo->ii_Concurrent;
+	btshared->sortmem = sortmem;
+	SpinLockInit(&btshared->mutex);
+	btshared->reltuples = 0;
+	btshared->indtuples = 0;
+	btshared->brokenhotchain = false;
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BTREE_SHARED, btshared);
+
+	pscan = (ParallelHeapScanDesc)
+		shm_toc_allocate(pcxt->toc, heap_parallelscan_estimate(snapshot));
+	heap_parallelscan_initialize(pscan, heap, snapshot);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BTREE_SCAN, pscan);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_BTREE_QUEUES,
+										  PARALLEL_BTREE_QUEUE_SIZE, false);
+
+	LaunchParallelWorkers(pcxt);
+
+	queues = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	nqueues = AttachParallelQueues(pcxt, queuespace, PARALLEL_BTREE_QUEUE_SIZE,
+								   queues, NULL);
+
+	/* Do our share of the scan, just like a worker */
+	buildstate->spool = _bt_spoolinit_mem(heap, index, indexInfo->ii_Unique,
+										  sortmem);
+	if (indexInfo->ii_Unique)
+		buildstate->spool2 = _bt_spoolinit(heap, index, false, true);
+
+	scan = heap_beginscan_parallel(heap, pscan);
+	reltuples = IndexBuildHeapRangeScan(heap, index, indexInfo, true, false,
+										0, InvalidBlockNumber,
+										btbuildCallback, (void *) buildstate,
+										scan);
+
+	/* Collect the dead tuples the workers found */
+	if (indexInfo->ii_Unique)
+	{
+		for (i = 0; i < nqueues; i++)
+		{
+			if (tuplesort_receive_sorted(buildstate->spool2->sortstate,
+										 queues[i]) > 0)
+				buildstate->haveDead = true;
+		}
+	}
+
+	if (buildstate->spool2 && !buildstate->haveDead)
+	{
+		/* spool2 turns out to be unnecessary */
+		_bt_spooldestroy(buildstate->spool2);
+		buildstate->spool2 = NULL;
+	}
+
+	/*
+	 * Replace our spool's sort by one merging it with the workers' runs.  The
+	 * merge takes ownership of our run, and ends it when it is done.
+	 */
+	localsort = buildstate->spool->sortstate;
+	tuplesort_performsort(localsort);
+	buildstate->spool->sortstate =
+		tuplesort_begin_index_btree(heap, index, indexInfo->ii_Unique,
+									sortmem, false);
+	tuplesort_merge_sorted(buildstate->spool->sortstate, queues, nqueues,
+						   localsort);
+
+	_bt_leafbuild(buildstate->spool, buildstate->spool2);
+	_bt_spooldestroy(buildstate->spool);
+	if (buildstate->spool2)
+		_bt_spooldestroy(buildstate->spool2);
+
+	/* This rethrows any error a worker ran into */
+	WaitForParallelWorkersToFinish(pcxt);
+
+	reltuples += btshared->reltuples;
+	buildstate->indtuples += btshared->indtuples;
+	if (btshared->brokenhotchain)
+		indexInfo->ii_BrokenHotChain = true;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	if (snapshot != SnapshotAny)
+		UnregisterSnapshot(snapshot);
+
+	return reltuples;
+}
+
+/*
+ * _bt_parallel_build_main
+ *
+ * Entry point of a parallel btree build worker: scan our share of the heap,
+ * sort it, and send the result to the leader.
+ */
+void
+_bt_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	BTShared   *btshared;
+	ParallelHeapScanDesc pscan;
+	char	   *queuespace;
+	shm_mq_handle *mqh;
+	Relation	heap;
+	Relation	index;
+	IndexInfo  *indexInfo;
+	BTBuildState buildstate;
+	HeapScanDesc scan;
+	double		reltuples;
+
+	btshared = (BTShared *) shm_toc_lookup(toc, PARALLEL_KEY_BTREE_SHARED);
+	pscan = (ParallelHeapScanDesc) shm_toc_lookup(toc, PARALLEL_KEY_BTREE_SCAN);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_BTREE_QUEUES);
+	if (btshared == NULL || pscan == NULL || queuespace == NULL)
+		elog(ERROR, "invalid parallel btree build state");
+
+	mqh = AttachParallelLeaderQueue(seg, queuespace, PARALLEL_BTREE_QUEUE_SIZE,
+									false);
+
+	/*
+	 * The leader holds the locks a build needs until we are done, and we
+	 * cannot take locks of our own that would conflict with them.
+	 */
+	heap = heap_open(btshared->heaprelid, NoLock);
+	index = index_open(btshared->indexrelid, NoLock);
+
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Unique = btshared->isunique;
+	indexInfo->ii_Concurrent = btshared->isconcurrent;
+
+	buildstate.isUnique = btshared->isunique;
+	buildstate.haveDead = false;
+	buildstate.heapRel = heap;
+	buildstate.spool = _bt_spoolinit_mem(heap, index, btshared->isunique,
+										 btshared->sortmem);
+	buildstate.spool2 = NULL;
+	if (btshared->isunique)
+		buildstate.spool2 = _bt_spoolinit(heap, index, false, true);
+	buildstate.indtuples = 0;
+
+	scan = heap_beginscan_parallel(heap, pscan);
+	reltuples = IndexBuildHeapRangeScan(heap, index, indexInfo, true, false,
+										0, InvalidBlockNumber,
+										btbuildCallback, (void *) &buildstate,
+										scan);
+
+	SpinLockAcquire(&btshared->mutex);
+	btshared->reltuples += reltuples;
+	btshared->indtuples += buildstate.indtuples;
+	if (indexInfo->ii_BrokenHotChain)
+		btshared->brokenhotchain = true;
+	SpinLockRelease(&btshared->mutex);
+
+	/* the leader reads the dead tuples first, see _bt_parallel_build */
+	if (buildstate.spool2)
+	{
+		tuplesort_performsort(buildstate.spool2->sortstate);
+		tuplesort_send_sorted(buildstate.spool2->sortstate, mqh);
+		_bt_spooldestroy(buildstate.spool2);
+	}
+
+	tuplesort_performsort(buildstate.spool->sortstate);
+	tuplesort_send_sorted(buildstate.spool->sortstate, mqh);
+	_bt_spooldestroy(buildstate.spool);
+
+	index_close(index, NoLock);
+	heap_close(heap, NoLock);
+}
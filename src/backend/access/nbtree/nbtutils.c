@@ -20,10 +20,15 @@
 #include "access/nbtree.h"
 #include "access/reloptions.h"
 #include "access/relscan.h"
+#include "catalog/pg_index.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "utils/array.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/pg_locale.h"
 #include "utils/rel.h"
 
 
@@ -34,6 +39,13 @@ typedef struct BTSortArrayContext
 	bool		reverse;
 } BTSortArrayContext;
 
+/*
+ * Number of consecutive descents for new first-column values that land on
+ * the page where the previous primitive scan ended, after which a skip scan
+ * gives up skipping and reads the rest of the index instead.
+ */
+#define BT_SKIP_MAX_WASTED	8
+
 static Datum _bt_find_extreme_element(IndexScanDesc scan, ScanKey skey,
 						 StrategyNumber strat,
 						 Datum *elems, int nelems);
@@ -44,11 +56,24 @@ static int	_bt_compare_array_elements(const void *a, const void *b, void *arg);
 static bool _bt_compare_scankey_args(IndexScanDesc scan, ScanKey op,
 						 ScanKey leftarg, ScanKey rightarg,
 						 bool *result);
+static void _bt_skip_set_pos(BTSkipKeyInfo *skip, BTSkipPos *pos,
+				 BTSkipMode mode, bool haveValue, Datum value, bool isnull,
+				 bool strict, ScanDirection dir);
+static void _bt_skip_move(BTSkipKeyInfo *skip, BTSkipMode mode,
+			  Datum value, bool isnull, bool strict, ScanDirection dir);
+static void _bt_skip_remember(BTScanOpaque so, Datum value, bool isnull,
+				  ScanDirection dir);
+static ScanKey _bt_build_skip_keys(IndexScanDesc scan, ScanKey keys,
+					int *numberOfKeys);
 static bool _bt_fix_scankey_strategy(ScanKey skey, int16 *indoption);
 static void _bt_mark_scankey_required(ScanKey skey);
 static bool _bt_check_rowcompare(ScanKey skey,
 					 IndexTuple tuple, TupleDesc tupdesc,
 					 ScanDirection dir, bool *continuescan);
+static int	_bt_int_cmp(const void *a, const void *b);
+static int	_bt_tid_cmp(const void *a, const void *b);
+static bool _bt_shorten_attr(Relation rel, int attno, Datum ldatum,
+				 Datum *rdatum);
 
 
 /*
@@ -56,7 +81,9 @@ static bool _bt_check_rowcompare(ScanKey skey,
  *		Build an insertion scan key that contains comparison data from itup
  *		as well as comparator routines appropriate to the key datatypes.
  *
- *		The result is intended for use with _bt_compare().
+ *		The result is intended for use with _bt_compare().  If itup is a
+ *		truncated pivot tuple, there are only as many keys as it has
+ *		attributes.  Included columns never become keys.
  */
 ScanKey
 _bt_mkscankey(Relation rel, IndexTuple itup)
@@ -68,7 +95,8 @@ _bt_mkscankey(Relation rel, IndexTuple itup)
 	int			i;
 
 	itupdesc = RelationGetDescr(rel);
-	natts = RelationGetNumberOfAttributes(rel);
+	natts = Min(BTreeTupleGetNAtts(itup, rel),
+				IndexRelationGetNumberOfKeyAttributes(rel));
 	indoption = rel->rd_indoption;
 
 	skey = (ScanKey) palloc(natts * sizeof(ScanKeyData));
@@ -119,7 +147,7 @@ _bt_mkscankey_nodata(Relation rel)
 	int16	   *indoption;
 	int			i;
 
-	natts = RelationGetNumberOfAttributes(rel);
+	natts = IndexRelationGetNumberOfKeyAttributes(rel);
 	indoption = rel->rd_indoption;
 
 	skey = (ScanKey) palloc(natts * sizeof(ScanKeyData));
@@ -655,13 +683,449 @@ _bt_restore_array_keys(IndexScanDesc scan)
 }
 
 
+/*
+ * _bt_preprocess_skip_key() -- Set up a skip scan, if the keys allow one
+ *
+ * We do a skip scan when there are no keys on the first index column, but
+ * there are on the second one.  (With keys only on later columns, an
+ * equality key on the first column would not make them required, so
+ * skipping could not save anything.)  This is called by btrescan, after
+ * _bt_preprocess_array_keys.
+ */
+void
+_bt_preprocess_skip_key(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	BTSkipKeyInfo *skip;
+	ScanKey		inkeys;
+
+	so->skipActive = false;
+
+	if (so->numArrayKeys < 0 || scan->numberOfKeys < 1 ||
+		IndexRelationGetNumberOfKeyAttributes(rel) < 2)
+		return;
+
+	/* the keys are sorted by attribute, so check only the first one */
+	if (so->arrayKeyData != NULL)
+		inkeys = so->arrayKeyData;
+	else
+		inkeys = scan->keyData;
+	if (inkeys[0].sk_attno != 2)
+		return;
+
+	/*
+	 * Look up the first column's comparison operators the first time
+	 * through.  The skip context holds the first-column values we keep; it
+	 * can be reset at each rescan.
+	 */
+	if (so->skipInfo == NULL)
+	{
+		Oid			opfamily = rel->rd_opfamily[0];
+		Oid			opcintype = rel->rd_opcintype[0];
+		Form_pg_attribute attr = RelationGetDescr(rel)->attrs[0];
+		int			strat;
+
+		skip = (BTSkipKeyInfo *) palloc0(sizeof(BTSkipKeyInfo));
+
+		for (strat = 1; strat <= BTMaxStrategyNumber; strat++)
+		{
+			Oid			cmp_op;
+			RegProcedure cmp_proc;
+
+			cmp_op = get_opfamily_member(opfamily, opcintype, opcintype,
+										 strat);
+			if (!OidIsValid(cmp_op))
+				break;
+			cmp_proc = get_opcode(cmp_op);
+			if (!RegProcedureIsValid(cmp_proc))
+				break;
+			fmgr_info(cmp_proc, &skip->procs[strat - 1]);
+		}
+		if (strat <= BTMaxStrategyNumber)
+		{
+			/* incomplete opfamily, so no skip scan */
+			pfree(skip);
+			return;
+		}
+
+		skip->inKeys = (ScanKey)
+			palloc((scan->numberOfKeys + 1) * sizeof(ScanKeyData));
+		skip->typlen = attr->attlen;
+		skip->typbyval = attr->attbyval;
+		skip->skipContext = AllocSetContextCreate(CurrentMemoryContext,
+												  "BTree Skip Context",
+												  ALLOCSET_SMALL_MINSIZE,
+												  ALLOCSET_SMALL_INITSIZE,
+												  ALLOCSET_SMALL_MAXSIZE);
+		so->skipInfo = skip;
+	}
+	else
+	{
+		skip = so->skipInfo;
+		MemoryContextReset(skip->skipContext);
+	}
+
+	memset(&skip->cur, 0, sizeof(BTSkipPos));
+	memset(&skip->mark, 0, sizeof(BTSkipPos));
+	skip->nextValid = false;
+	skip->nextValue = (Datum) 0;
+	skip->nextIsNull = false;
+	skip->lastPage = InvalidBlockNumber;
+	skip->nWasted = 0;
+	skip->newGroup = false;
+
+	so->skipActive = true;
+}
+
+/*
+ * _bt_skip_set_pos() -- Set up a skip position
+ *
+ * The value, if any, is copied into the skip context, and the position's
+ * previous value is freed.
+ */
+static void
+_bt_skip_set_pos(BTSkipKeyInfo *skip, BTSkipPos *pos, BTSkipMode mode,
+				 bool haveValue, Datum value, bool isnull,
+				 bool strict, ScanDirection dir)
+{
+	Datum		newvalue = (Datum) 0;
+
+	if (haveValue && !isnull)
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(skip->skipContext);
+
+		newvalue = datumCopy(value, skip->typbyval, skip->typlen);
+		MemoryContextSwitchTo(oldContext);
+	}
+	if (!skip->typbyval && DatumGetPointer(pos->value) != NULL)
+		pfree(DatumGetPointer(pos->value));
+
+	pos->mode = mode;
+	pos->haveValue = haveValue;
+	pos->value = newvalue;
+	pos->isnull = haveValue && isnull;
+	pos->strict = strict;
+	pos->dir = dir;
+}
+
+/*
+ * _bt_skip_move() -- Move the skip key to a new position
+ */
+static void
+_bt_skip_move(BTSkipKeyInfo *skip, BTSkipMode mode,
+			  Datum value, bool isnull, bool strict, ScanDirection dir)
+{
+	_bt_skip_set_pos(skip, &skip->cur, mode, true, value, isnull, strict, dir);
+	/* what we knew about the next value is for the old position */
+	skip->nextValid = false;
+	skip->newGroup = (mode == BT_SKIP_EQUAL);
+}
+
+/*
+ * _bt_skip_remember() -- Remember the first-column value that ended a
+ * primitive scan of a skip scan
+ */
+static void
+_bt_skip_remember(BTScanOpaque so, Datum value, bool isnull,
+				  ScanDirection dir)
+{
+	BTSkipKeyInfo *skip = so->skipInfo;
+	Datum		newvalue = (Datum) 0;
+
+	if (!isnull)
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(skip->skipContext);
+
+		newvalue = datumCopy(value, skip->typbyval, skip->typlen);
+		MemoryContextSwitchTo(oldContext);
+	}
+	if (!skip->typbyval && DatumGetPointer(skip->nextValue) != NULL)
+		pfree(DatumGetPointer(skip->nextValue));
+
+	skip->nextValid = true;
+	skip->nextValue = newvalue;
+	skip->nextIsNull = isnull;
+	skip->nextDir = dir;
+}
+
+/*
+ * _bt_start_skip_key() -- Initialize the skip key at start of a scan
+ *
+ * The first primitive scan just looks for the first tuple in the scan
+ * direction, to learn the first value of the first column.
+ */
+void
+_bt_start_skip_key(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipKeyInfo *skip = so->skipInfo;
+
+	_bt_skip_set_pos(skip, &skip->cur, BT_SKIP_PROBE, false, (Datum) 0, false,
+					 false, dir);
+	skip->nextValid = false;
+	skip->lastPage = InvalidBlockNumber;
+	skip->nWasted = 0;
+	skip->newGroup = false;
+}
+
+/*
+ * _bt_advance_skip_key() -- Advance to the next value of the first column
+ *
+ * Returns TRUE if there is another primitive scan to do, FALSE if not.
+ *
+ * A probe is followed by a scan of the value it found.  Once the scan of a
+ * value is finished, we know the next value if the scan ended on a tuple
+ * having it; otherwise we probe for it.  Once a search for the next value
+ * has proven wasteful too often, we instead scan everything beyond it (REST
+ * mode).  If the scan direction was reversed, we have to come back to the
+ * values left behind.
+ */
+bool
+_bt_advance_skip_key(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipKeyInfo *skip = so->skipInfo;
+	BTSkipPos  *cur = &skip->cur;
+	bool		wasted = (skip->nWasted >= BT_SKIP_MAX_WASTED);
+	bool		nullsFirst;
+
+	/*
+	 * With no array keys, the skip key can't have made the scan keys
+	 * contradictory, so no other primitive scan would return anything.
+	 */
+	if (!so->qual_ok && so->numArrayKeys == 0 && cur->mode != BT_SKIP_PROBE)
+		return false;
+
+	if (skip->nextValid && skip->nextDir == dir)
+	{
+		/*
+		 * We already have the next value in this direction.  The NULLs are
+		 * always scanned as a group of their own; they come first or last.
+		 */
+		if (wasted && !skip->nextIsNull)
+			_bt_skip_move(skip, BT_SKIP_REST, skip->nextValue, false,
+						  false, dir);
+		else
+			_bt_skip_move(skip, BT_SKIP_EQUAL, skip->nextValue,
+						  skip->nextIsNull, false, dir);
+		return true;
+	}
+
+	switch (cur->mode)
+	{
+		case BT_SKIP_PROBE:
+			/* nothing beyond the current value */
+			return false;
+
+		case BT_SKIP_EQUAL:
+			if (cur->isnull)
+			{
+				/* do the non-NULLs follow the NULLs in this direction? */
+				nullsFirst = (scan->indexRelation->rd_indoption[0] &
+							  INDOPTION_NULLS_FIRST) != 0;
+				if (nullsFirst != ScanDirectionIsForward(dir))
+					return false;
+			}
+			_bt_skip_move(skip, wasted ? BT_SKIP_REST : BT_SKIP_PROBE,
+						  cur->value, cur->isnull, true, dir);
+			return true;
+
+		case BT_SKIP_REST:
+			if (cur->dir == dir)
+				return false;
+
+			/*
+			 * The scan direction was reversed.  Come back to the current
+			 * value, unless it was already scanned.
+			 */
+			if (cur->strict)
+				_bt_skip_move(skip, BT_SKIP_EQUAL, cur->value, cur->isnull,
+							  false, dir);
+			else
+				_bt_skip_move(skip, BT_SKIP_PROBE, cur->value, cur->isnull,
+							  true, dir);
+			return true;
+	}
+
+	return false;				/* keep compiler quiet */
+}
+
+/*
+ * _bt_advance_scan_keys() -- Advance array keys and skip key
+ *
+ * The skip key is for the first index column, so it must advance most
+ * slowly: we go through all sets of array elements for each value of the
+ * first column.  A probe doesn't use the array keys at all.
+ */
+bool
+_bt_advance_scan_keys(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+
+	if (so->numArrayKeys &&
+		!(so->skipActive && so->skipInfo->cur.mode == BT_SKIP_PROBE) &&
+		_bt_advance_array_keys(scan, dir))
+		return true;
+
+	if (so->skipActive)
+		return _bt_advance_skip_key(scan, dir);
+
+	return false;
+}
+
+/*
+ * _bt_mark_skip_key() -- Handle the skip key during btmarkpos
+ */
+void
+_bt_mark_skip_key(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipKeyInfo *skip = so->skipInfo;
+
+	_bt_skip_set_pos(skip, &skip->mark, skip->cur.mode, skip->cur.haveValue,
+					 skip->cur.value, skip->cur.isnull, skip->cur.strict,
+					 skip->cur.dir);
+}
+
+/*
+ * _bt_restore_skip_key() -- Handle the skip key during btrestrpos
+ *
+ * As for array keys, we must redo _bt_preprocess_keys if the skip key moved
+ * since the mark was set.
+ */
+void
+_bt_restore_skip_key(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipKeyInfo *skip = so->skipInfo;
+	BTSkipPos  *cur = &skip->cur;
+	BTSkipPos  *mark = &skip->mark;
+
+	if (cur->mode == mark->mode &&
+		cur->haveValue == mark->haveValue &&
+		cur->isnull == mark->isnull &&
+		cur->strict == mark->strict &&
+		cur->dir == mark->dir &&
+		(!cur->haveValue || cur->isnull ||
+		 datumIsEqual(cur->value, mark->value,
+					  skip->typbyval, skip->typlen)))
+		return;
+
+	_bt_skip_set_pos(skip, cur, mark->mode, mark->haveValue,
+					 mark->value, mark->isnull, mark->strict, mark->dir);
+	skip->nextValid = false;
+	skip->newGroup = false;
+
+	_bt_preprocess_keys(scan);
+}
+
+/*
+ * _bt_skip_count_descent() -- Note where _bt_first's descent ended up
+ *
+ * If the descent for a new first-column value landed on the page where the
+ * previous primitive scan stopped, we could as well have read on.
+ */
+void
+_bt_skip_count_descent(IndexScanDesc scan, BlockNumber blkno)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipKeyInfo *skip = so->skipInfo;
+
+	if (!skip->newGroup)
+		return;
+
+	if (blkno == skip->lastPage)
+		skip->nWasted++;
+	else
+		skip->nWasted = 0;
+	skip->newGroup = false;
+}
+
+/*
+ * _bt_build_skip_keys() -- Make the input keys for _bt_preprocess_keys in a
+ * skip scan
+ *
+ * The key for the current skip position goes first, since it's for the first
+ * column, followed by the scan's keys, unless this is a probe.
+ */
+static ScanKey
+_bt_build_skip_keys(IndexScanDesc scan, ScanKey keys, int *numberOfKeys)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipKeyInfo *skip = so->skipInfo;
+	BTSkipPos  *pos = &skip->cur;
+	Relation	rel = scan->indexRelation;
+	ScanKey		skey = &skip->inKeys[0];
+	int			nkeys = 0;
+
+	if (pos->haveValue)
+	{
+		if (pos->isnull)
+		{
+			/* the NULLs, or everything but them */
+			ScanKeyEntryInitialize(skey,
+								   SK_BT_SKIP | SK_ISNULL |
+								   (pos->mode == BT_SKIP_EQUAL ?
+									SK_SEARCHNULL : SK_SEARCHNOTNULL),
+								   1,
+								   InvalidStrategy,
+								   InvalidOid,
+								   InvalidOid,
+								   InvalidOid,
+								   (Datum) 0);
+		}
+		else
+		{
+			StrategyNumber strat;
+
+			if (pos->mode == BT_SKIP_EQUAL)
+				strat = BTEqualStrategyNumber;
+			else
+			{
+				/* the values after the current one in index order */
+				if (ScanDirectionIsForward(pos->dir))
+					strat = pos->strict ? BTGreaterStrategyNumber :
+						BTGreaterEqualStrategyNumber;
+				else
+					strat = pos->strict ? BTLessStrategyNumber :
+						BTLessEqualStrategyNumber;
+				if (rel->rd_indoption[0] & INDOPTION_DESC)
+					strat = BTCommuteStrategyNumber(strat);
+			}
+
+			ScanKeyEntryInitializeWithInfo(skey,
+										   SK_BT_SKIP,
+										   1,
+										   strat,
+										   InvalidOid,
+										   rel->rd_indcollation[0],
+										   &skip->procs[strat - 1],
+										   pos->value);
+		}
+		nkeys++;
+	}
+
+	if (pos->mode != BT_SKIP_PROBE)
+	{
+		memcpy(&skip->inKeys[nkeys], keys,
+			   scan->numberOfKeys * sizeof(ScanKeyData));
+		nkeys += scan->numberOfKeys;
+	}
+
+	*numberOfKeys = nkeys;
+	return skip->inKeys;
+}
+
+
 /*
  *	_bt_preprocess_keys() -- Preprocess scan keys
  *
  * The given search-type keys (in scan->keyData[] or so->arrayKeyData[])
  * are copied to so->keyData[] with possible transformation.
  * scan->numberOfKeys is the number of input keys, so->numberOfKeys gets
- * the number of output keys (possibly less, never greater).
+ * the number of output keys (possibly less, never greater, except that a
+ * skip scan adds a key for the first column; see _bt_build_skip_keys).
  *
  * The output keys are marked with additional sk_flag bits beyond the
  * system-standard bits supplied by the caller.  The DESC and NULLS_FIRST
@@ -760,16 +1224,19 @@ _bt_preprocess_keys(IndexScanDesc scan)
 	so->qual_ok = true;
 	so->numberOfKeys = 0;
 
-	if (numberOfKeys < 1)
-		return;					/* done if qual-less scan */
-
 	/*
-	 * Read so->arrayKeyData if array keys are present, else scan->keyData
+	 * Read so->arrayKeyData if array keys are present, else scan->keyData.
+	 * In a skip scan these come after the skip key.
 	 */
 	if (so->arrayKeyData != NULL)
 		inkeys = so->arrayKeyData;
 	else
 		inkeys = scan->keyData;
+	if (so->skipActive)
+		inkeys = _bt_build_skip_keys(scan, inkeys, &numberOfKeys);
+
+	if (numberOfKeys < 1)
+		return;					/* done if qual-less scan */
 
 	outkeys = so->keyData;
 	cur = &inkeys[0];
@@ -1457,6 +1924,8 @@ _bt_checkkeys(IndexScanDesc scan,
 			/*
 			 * In any case, this indextuple doesn't match the qual.
 			 */
+			if (!*continuescan && (key->sk_flags & SK_BT_SKIP))
+				_bt_skip_remember(so, datum, isNull, dir);
 			return NULL;
 		}
 
@@ -1498,6 +1967,8 @@ _bt_checkkeys(IndexScanDesc scan,
 			/*
 			 * In any case, this indextuple doesn't match the qual.
 			 */
+			if (!*continuescan && (key->sk_flags & SK_BT_SKIP))
+				_bt_skip_remember(so, datum, isNull, dir);
 			return NULL;
 		}
 
@@ -1526,6 +1997,8 @@ _bt_checkkeys(IndexScanDesc scan,
 			/*
 			 * In any case, this indextuple doesn't match the qual.
 			 */
+			if (!*continuescan && (key->sk_flags & SK_BT_SKIP))
+				_bt_skip_remember(so, datum, isNull, dir);
 			return NULL;
 		}
 	}
@@ -1534,6 +2007,18 @@ _bt_checkkeys(IndexScanDesc scan,
 	if (!tuple_alive)
 		return NULL;
 
+	/* A skip scan's probe only wants the first column of the first match */
+	if (so->skipActive && so->skipInfo->cur.mode == BT_SKIP_PROBE)
+	{
+		Datum		datum;
+		bool		isNull;
+
+		datum = index_getattr(tuple, 1, tupdesc, &isNull);
+		_bt_skip_remember(so, datum, isNull, dir);
+		*continuescan = false;
+		return NULL;
+	}
+
 	/* If we get here, the tuple passes all index quals. */
 	return tuple;
 }
@@ -1784,6 +2269,15 @@ _bt_killitems(IndexScanDesc scan)
 	minoff = P_FIRSTDATAKEY(opaque);
 	maxoff = PageGetMaxOffsetNumber(page);
 
+	/*
+	 * The items of a posting list tuple are adjacent in currPos.items, in
+	 * the order of its heap TIDs, whichever way we scanned.  Put killedItems
+	 * in that order too, so that we can tell below whether all of a posting
+	 * list tuple's TIDs were killed.
+	 */
+	if (numKilled > 1)
+		qsort(so->killedItems, numKilled, sizeof(int), _bt_int_cmp);
+
 	for (i = 0; i < numKilled; i++)
 	{
 		int			itemIndex = so->killedItems[i];
@@ -1792,6 +2286,8 @@ _bt_killitems(IndexScanDesc scan)
 
 		Assert(itemIndex >= so->currPos.firstItem &&
 			   itemIndex <= so->currPos.lastItem);
+		if (i > 0 && itemIndex == so->killedItems[i - 1])
+			continue;			/* entered twice, see btgettuple */
 		if (offnum < minoff)
 			continue;			/* pure paranoia */
 		while (offnum <= maxoff)
@@ -1799,7 +2295,43 @@ _bt_killitems(IndexScanDesc scan)
 			ItemId		iid = PageGetItemId(page, offnum);
 			IndexTuple	ituple = (IndexTuple) PageGetItem(page, iid);
 
-			if (ItemPointerEquals(&ituple->t_tid, &kitem->heapTid))
+			if (BTreeTupleIsPosting(ituple))
+			{
+				int			nposting = BTreeTupleGetNPosting(ituple);
+				int			j;
+
+				/*
+				 * A posting list tuple can only be marked dead once all its
+				 * heap TIDs are, starting with this item.
+				 */
+				for (j = 0; j < nposting && i + j < numKilled; j++)
+				{
+					BTScanPosItem *item =
+					&so->currPos.items[so->killedItems[i + j]];
+
+					if (!ItemPointerEquals(BTreeTupleGetPostingN(ituple, j),
+										   &item->heapTid))
+						break;
+				}
+				if (j == nposting)
+				{
+					ItemIdMarkDead(iid);
+					killedsomething = true;
+					i += nposting - 1;
+					break;		/* out of inner search loop */
+				}
+
+				/* if the item belongs to this tuple, we're done with it */
+				for (j = 0; j < nposting; j++)
+				{
+					if (ItemPointerEquals(BTreeTupleGetPostingN(ituple, j),
+										  &kitem->heapTid))
+						break;
+				}
+				if (j < nposting)
+					break;		/* out of inner search loop */
+			}
+			else if (ItemPointerEquals(&ituple->t_tid, &kitem->heapTid))
 			{
 				/* found the item */
 				ItemIdMarkDead(iid);
@@ -1825,6 +2357,344 @@ _bt_killitems(IndexScanDesc scan)
 	LockBuffer(so->currPos.buf, BUFFER_LOCK_UNLOCK);
 }
 
+/*
+ * qsort comparators for _bt_killitems and _bt_dedup_build_page
+ */
+static int
+_bt_int_cmp(const void *a, const void *b)
+{
+	int			ia = *(const int *) a;
+	int			ib = *(const int *) b;
+
+	return (ia > ib) ? 1 : ((ia < ib) ? -1 : 0);
+}
+
+static int
+_bt_tid_cmp(const void *a, const void *b)
+{
+	return ItemPointerCompare((ItemPointer) a, (ItemPointer) b);
+}
+
+/*
+ * _bt_form_posting() -- build a leaf tuple with the key of "base" and the
+ *		given heap TIDs
+ *
+ * base can be a plain or a posting list tuple; only its key is used.  The
+ * TIDs must be in ascending order.  With a single TID the result is a plain
+ * tuple, which is also how a high key is made from a posting list tuple.
+ * The result is palloc'd.
+ */
+IndexTuple
+_bt_form_posting(IndexTuple base, ItemPointer htids, int nhtids)
+{
+	Size		keysize = BTreeTupleGetKeySize(base);
+	Size		newsize;
+	IndexTuple	itup;
+
+	Assert(nhtids > 0);
+
+	if (nhtids > 1)
+		newsize = MAXALIGN(keysize + nhtids * sizeof(ItemPointerData));
+	else
+		newsize = keysize;
+	Assert(newsize <= INDEX_SIZE_MASK);
+
+	itup = (IndexTuple) palloc0(newsize);
+	memcpy(itup, base, keysize);
+	itup->t_info &= ~(INDEX_SIZE_MASK | BT_ALT_TID);
+	itup->t_info |= newsize;
+
+	if (nhtids > 1)
+	{
+		BTreeTupleSetPosting(itup, nhtids, keysize);
+		memcpy(BTreeTupleGetPosting(itup), htids,
+			   nhtids * sizeof(ItemPointerData));
+	}
+	else
+		itup->t_tid = *htids;
+
+	return itup;
+}
+
+/*
+ * _bt_keys_identical() -- are the keys of two leaf tuples bitwise equal?
+ *
+ * Only such tuples are merged into posting lists.  Bitwise equality implies
+ * equality per the operator class for all the types we support, and it
+ * keeps apart values that compare equal but can still be told apart, such
+ * as numeric 1.0 and 1.00, so that an index-only scan returns each heap
+ * row's own value.  It costs no function calls either.
+ */
+bool
+_bt_keys_identical(IndexTuple itup1, IndexTuple itup2)
+{
+	Size		keysize = BTreeTupleGetKeySize(itup1);
+	uint16		mask = INDEX_NULL_MASK | INDEX_VAR_MASK;
+
+	if (keysize != BTreeTupleGetKeySize(itup2))
+		return false;
+	if ((itup1->t_info & mask) != (itup2->t_info & mask))
+		return false;
+
+	return memcmp((char *) itup1 + sizeof(IndexTupleData),
+				  (char *) itup2 + sizeof(IndexTupleData),
+				  keysize - sizeof(IndexTupleData)) == 0;
+}
+
+/*
+ * _bt_truncate() -- build the high key for the left half of a leaf split
+ *
+ * lastleft is the last item staying on the left page, and firstright the
+ * first one moving to the right page.  The result is a pivot tuple made from
+ * firstright that sorts above lastleft and no higher than firstright: the
+ * attributes after the first one that tells them apart are dropped, and that
+ * one is shortened if _bt_shorten_attr() can.  If the keys are equal, or
+ * truncating wouldn't make the tuple any smaller, it's a plain copy of
+ * firstright's key and first heap TID instead, as without truncation.
+ * Included columns are dropped in any case, since they're only needed in
+ * leaf tuples.  The result is palloc'd.
+ */
+IndexTuple
+_bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright)
+{
+	TupleDesc	itupdesc = RelationGetDescr(rel);
+	int			natts = RelationGetNumberOfAttributes(rel);
+	int			nkeyatts = IndexRelationGetNumberOfKeyAttributes(rel);
+	Datum		values[INDEX_MAX_KEYS];
+	bool		isnull[INDEX_MAX_KEYS];
+	bool		shortened = false;
+	int			keepnatts;
+	TupleDesc	truncdesc;
+	IndexTuple	plain;
+	IndexTuple	pivot;
+
+	plain = _bt_form_posting(firstright, BTreeTupleGetHeapTID(firstright), 1);
+
+	for (keepnatts = 1; keepnatts <= nkeyatts; keepnatts++)
+	{
+		int			i = keepnatts - 1;
+		Datum		ldatum;
+		bool		lnull;
+		int32		result;
+
+		ldatum = index_getattr(lastleft, keepnatts, itupdesc, &lnull);
+		values[i] = index_getattr(firstright, keepnatts, itupdesc, &isnull[i]);
+
+		/* NULLs are equal to each other and unequal to anything else */
+		if (lnull || isnull[i])
+		{
+			if (lnull && isnull[i])
+				continue;
+			break;
+		}
+
+		result = DatumGetInt32(FunctionCall2Coll(index_getprocinfo(rel,
+															 keepnatts,
+															 BTORDER_PROC),
+												 rel->rd_indcollation[i],
+												 ldatum, values[i]));
+		if (result != 0)
+		{
+			shortened = _bt_shorten_attr(rel, keepnatts, ldatum, &values[i]);
+			break;
+		}
+	}
+
+	/* nothing to drop if it takes every attribute to tell them apart */
+	if (keepnatts > nkeyatts)
+	{
+		if (nkeyatts == natts)
+			return plain;
+		keepnatts = nkeyatts;
+	}
+	else if (keepnatts == natts && !shortened)
+		return plain;
+
+	truncdesc = CreateTupleDescCopy(itupdesc);
+	truncdesc->natts = keepnatts;
+	pivot = index_form_tuple(truncdesc, values, isnull);
+	FreeTupleDesc(truncdesc);
+	if (shortened)
+		pfree(DatumGetPointer(values[keepnatts - 1]));
+
+	pivot->t_tid = plain->t_tid;
+	if (keepnatts < natts)
+		BTreeTupleSetNAtts(pivot, keepnatts);
+
+	/* a value that was compressed before might not be any more */
+	if (nkeyatts == natts && IndexTupleSize(pivot) >= IndexTupleSize(plain))
+	{
+		pfree(pivot);
+		return plain;
+	}
+
+	pfree(plain);
+	return pivot;
+}
+
+/*
+ * _bt_shorten_attr() -- shorten a high key attribute, if its ordering allows
+ *
+ * The attribute of the last item on the left page, ldatum, sorts below
+ * *rdatum, that of the first item on the right.  If the attribute is ordered
+ * by plain byte comparison, with shorter strings first on a tie --- bytea,
+ * text and varchar with the "C" collation or pattern_ops --- any prefix of
+ * *rdatum longer than the bytes it shares with ldatum still sorts above
+ * ldatum, so the shortest such prefix (in whole characters, for text) can
+ * replace it in the high key.  Other orderings, descending columns included,
+ * don't allow this.  Returns true if *rdatum was replaced by a palloc'd
+ * prefix.
+ */
+static bool
+_bt_shorten_attr(Relation rel, int attno, Datum ldatum, Datum *rdatum)
+{
+	bool		istext;
+	struct varlena *left;
+	struct varlena *right;
+	struct varlena *prefix;
+	char	   *lp;
+	char	   *rp;
+	int			llen;
+	int			rlen;
+	int			len;
+
+	if (rel->rd_indoption[attno - 1] & INDOPTION_DESC)
+		return false;
+
+	switch (index_getprocid(rel, attno, BTORDER_PROC))
+	{
+		case F_BYTEACMP:
+			istext = false;
+			break;
+		case F_BTTEXT_PATTERN_CMP:
+			istext = true;
+			break;
+		case F_BTTEXTCMP:
+			if (!lc_collate_is_c(rel->rd_indcollation[attno - 1]))
+				return false;
+			istext = true;
+			break;
+		default:
+			return false;
+	}
+
+	left = pg_detoast_datum_packed((struct varlena *) DatumGetPointer(ldatum));
+	right = pg_detoast_datum_packed((struct varlena *) DatumGetPointer(*rdatum));
+	lp = VARDATA_ANY(left);
+	llen = VARSIZE_ANY_EXHDR(left);
+	rp = VARDATA_ANY(right);
+	rlen = VARSIZE_ANY_EXHDR(right);
+
+	/* keep the common bytes, and the first one where right is greater */
+	for (len = 0; len < llen && len < rlen && lp[len] == rp[len]; len++)
+		;
+	len++;
+
+	if (istext)
+	{
+		int			charlen = 0;
+
+		while (charlen < len)
+			charlen += pg_mblen(rp + charlen);
+		len = charlen;
+	}
+
+	if (len >= rlen)
+		return false;
+
+	prefix = (struct varlena *) palloc(VARHDRSZ + len);
+	SET_VARSIZE(prefix, VARHDRSZ + len);
+	memcpy(VARDATA(prefix), rp, len);
+	*rdatum = PointerGetDatum(prefix);
+
+	return true;
+}
+
+/*
+ * _bt_dedup_build_page() -- apply a deduplication pass to a leaf page
+ *
+ * Each interval is a run of adjacent items with identical keys; they are
+ * merged into one posting list tuple, placed at the run's first offset.
+ * The other items are kept as they are, LP_DEAD bits included.  The result
+ * is a temp page to be put in place with PageRestoreTempPage(), which the
+ * caller can do inside a critical section.  Used by both _bt_findinsertloc
+ * and the redo routine, which replays the intervals the former logged.
+ */
+Page
+_bt_dedup_build_page(Page page, BTDedupInterval *intervals, int nintervals)
+{
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	Page		newpage;
+	ItemPointer htids;
+	OffsetNumber offnum;
+	OffsetNumber minoff;
+	OffsetNumber maxoff;
+	int			i = 0;
+
+	newpage = PageGetTempPageCopySpecial(page);
+	PageSetLSN(newpage, PageGetLSN(page));
+	htids = (ItemPointer) palloc(MaxTIDsPerBTreePage * sizeof(ItemPointerData));
+
+	minoff = P_FIRSTDATAKEY(opaque);
+	maxoff = PageGetMaxOffsetNumber(page);
+
+	/* the high key, if any, is kept as is */
+	for (offnum = P_HIKEY; offnum <= maxoff;)
+	{
+		ItemId		itemid = PageGetItemId(page, offnum);
+		IndexTuple	itup = (IndexTuple) PageGetItem(page, itemid);
+		OffsetNumber newoff = OffsetNumberNext(PageGetMaxOffsetNumber(newpage));
+
+		if (offnum >= minoff && i < nintervals &&
+			intervals[i].baseoff == offnum)
+		{
+			IndexTuple	posting;
+			int			nhtids = 0;
+			int			j;
+
+			Assert(intervals[i].nitems > 1);
+			Assert(offnum + intervals[i].nitems - 1 <= maxoff);
+
+			for (j = 0; j < intervals[i].nitems; j++)
+			{
+				IndexTuple	dup;
+				int			ndup;
+
+				dup = (IndexTuple) PageGetItem(page,
+											   PageGetItemId(page, offnum + j));
+				ndup = BTreeTupleGetNHeapTIDs(dup);
+				memcpy(htids + nhtids, BTreeTupleGetHeapTID(dup),
+					   ndup * sizeof(ItemPointerData));
+				nhtids += ndup;
+			}
+			qsort(htids, nhtids, sizeof(ItemPointerData), _bt_tid_cmp);
+
+			posting = _bt_form_posting(itup, htids, nhtids);
+			if (PageAddItem(newpage, (Item) posting, IndexTupleSize(posting),
+							newoff, false, false) == InvalidOffsetNumber)
+				elog(ERROR, "failed to add posting list tuple to index page");
+			pfree(posting);
+
+			offnum += intervals[i].nitems;
+			i++;
+		}
+		else
+		{
+			if (PageAddItem(newpage, (Item) itup, IndexTupleSize(itup),
+							newoff, false, false) == InvalidOffsetNumber)
+				elog(ERROR, "failed to add item to index page");
+			if (ItemIdIsDead(itemid))
+				ItemIdMarkDead(PageGetItemId(newpage, newoff));
+			offnum = OffsetNumberNext(offnum);
+		}
+	}
+	Assert(i == nintervals);
+
+	pfree(htids);
+
+	return newpage;
+}
+
 
 /*
  * The following routines manage a shared-memory area in which we track
@@ -0,0 +1,333 @@
+/*-------------------------------------------------------------------------
+ *
+ * tableam.c
+ *	  Table access method routines.
+ *
+ * Tables are read and modified through the functions in this file, which
+ * dispatch to the callbacks of the relation's table access method.  A table
+ * created without a USING clause (pg_class.relam = 0) uses the built-in
+ * heap; otherwise relam is the OID of the access method's handler function.
+ *
+ * System catalogs are always heaps, so catalog code goes on calling the
+ * heapam.c routines directly.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/table/tableam.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/tableam.h"
+#include "utils/memutils.h"
+
+
+/*
+ * GetTableAmRoutine --- get a TableAmRoutine struct by invoking the handler.
+ *
+ * This is a convenience routine that's just meant to check for errors.
+ */
+TableAmRoutine *
+GetTableAmRoutine(Oid amhandler)
+{
+	Datum		datum;
+	TableAmRoutine *routine;
+
+	datum = OidFunctionCall1(amhandler, PointerGetDatum(NULL));
+	routine = (TableAmRoutine *) DatumGetPointer(datum);
+
+	if (routine == NULL || !IsA(routine, TableAmRoutine))
+		elog(ERROR, "table access method handler function %u did not return a TableAmRoutine struct",
+			 amhandler);
+
+	return routine;
+}
+
+/*
+ * GetTableAmRoutineForRelation - look up the table access method of the
+ * given table, and retrieve its TableAmRoutine struct.
+ *
+ * The result is cached in the relcache entry, like GetFdwRoutineForRelation
+ * does for foreign tables.  If makecopy is true then the returned data is
+ * freshly palloc'd in the caller's memory context.  Otherwise, it's a pointer
+ * to the relcache data, which will be lost in any relcache reset --- so don't
+ * rely on it long.
+ */
+TableAmRoutine *
+GetTableAmRoutineForRelation(Relation relation, bool makecopy)
+{
+	TableAmRoutine *routine;
+	TableAmRoutine *croutine;
+
+	if (relation->rd_tableam == NULL)
+	{
+		if (RelationUsesHeapAM(relation))
+			routine = GetHeapamTableAmRoutine();
+		else
+			routine = GetTableAmRoutine(relation->rd_rel->relam);
+
+		/* Save the data for later reuse in CacheMemoryContext */
+		croutine = (TableAmRoutine *) MemoryContextAlloc(CacheMemoryContext,
+													  sizeof(TableAmRoutine));
+		memcpy(croutine, routine, sizeof(TableAmRoutine));
+		relation->rd_tableam = croutine;
+
+		/* Give back the locally palloc'd copy regardless of makecopy */
+		return routine;
+	}
+
+	/* We have valid cached data --- does the caller want a copy? */
+	if (makecopy)
+	{
+		routine = (TableAmRoutine *) palloc(sizeof(TableAmRoutine));
+		memcpy(routine, relation->rd_tableam, sizeof(TableAmRoutine));
+		return routine;
+	}
+
+	/* Only a short-lived reference is needed, so just hand back cached copy */
+	return relation->rd_tableam;
+}
+
+
+/* ----------------------------------------------------------------
+ *					 sequential scans
+ * ----------------------------------------------------------------
+ */
+
+HeapScanDesc
+table_beginscan(Relation rel, Snapshot snapshot, int nkeys, ScanKey key)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	return routine->scan_begin(rel, snapshot, nkeys, key);
+}
+
+HeapTuple
+table_getnext(HeapScanDesc scan, ScanDirection direction)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(scan->rs_rd, false);
+
+	return routine->scan_getnext(scan, direction);
+}
+
+void
+table_rescan(HeapScanDesc scan, ScanKey key)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(scan->rs_rd, false);
+
+	routine->scan_rescan(scan, key);
+}
+
+void
+table_endscan(HeapScanDesc scan)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(scan->rs_rd, false);
+
+	routine->scan_end(scan);
+}
+
+/*
+ * table_scan_set_columns - tell a scan which columns will be looked at
+ *
+ * "attrs" holds plain attribute numbers, and may be empty.  Access methods
+ * that can avoid reading the other columns may then return them as NULLs.
+ * Without a call, all columns are returned.  Must be called before the
+ * first tuple is fetched.
+ */
+void
+table_scan_set_columns(HeapScanDesc scan, Bitmapset *attrs)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(scan->rs_rd, false);
+
+	if (routine->scan_set_columns != NULL)
+		routine->scan_set_columns(scan, attrs);
+}
+
+/*
+ * table_scan_has_getbatch - can the scan return rows in columnar batches?
+ */
+bool
+table_scan_has_getbatch(HeapScanDesc scan)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(scan->rs_rd, false);
+
+	return routine->scan_getbatch != NULL;
+}
+
+/*
+ * table_scan_getbatch - fetch the next rows of a scan, column by column
+ *
+ * Fills values[col][] and isnull[col][] with column attnums[col] of up to
+ * maxrows rows, and returns how many rows there were, or 0 at the end of
+ * the scan.  Only valid if table_scan_has_getbatch says so.
+ */
+int
+table_scan_getbatch(HeapScanDesc scan, int ncols, AttrNumber *attnums,
+					Datum **values, bool **isnull, int maxrows)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(scan->rs_rd, false);
+
+	return routine->scan_getbatch(scan, ncols, attnums, values, isnull,
+								  maxrows);
+}
+
+
+/* ----------------------------------------------------------------
+ *					 tuple-level operations
+ * ----------------------------------------------------------------
+ */
+
+bool
+table_fetch(Relation rel, Snapshot snapshot, HeapTuple tuple,
+			Buffer *userbuf, bool keep_buf, Relation stats_relation)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	return routine->tuple_fetch(rel, snapshot, tuple, userbuf, keep_buf,
+								stats_relation);
+}
+
+/*
+ * table_get_latest_tid - find the latest version of a tuple
+ *
+ * Access methods whose tuples never move when updated need not provide a
+ * tuple_get_latest_tid callback; *tid is then left alone.
+ */
+void
+table_get_latest_tid(Relation rel, Snapshot snapshot, ItemPointer tid)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	if (routine->tuple_get_latest_tid != NULL)
+		routine->tuple_get_latest_tid(rel, snapshot, tid);
+}
+
+Oid
+table_insert(Relation rel, HeapTuple tup, CommandId cid,
+			 int options, BulkInsertState bistate)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	return routine->tuple_insert(rel, tup, cid, options, bistate);
+}
+
+/*
+ * table_multi_insert - insert several tuples at once
+ *
+ * Access methods that have no faster way to do it need not provide a
+ * multi_insert callback; the tuples are then inserted one at a time.
+ */
+void
+table_multi_insert(Relation rel, HeapTuple *tuples, int ntuples,
+				   CommandId cid, int options, BulkInsertState bistate)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+	int			i;
+
+	if (routine->multi_insert != NULL)
+	{
+		routine->multi_insert(rel, tuples, ntuples, cid, options, bistate);
+		return;
+	}
+
+	/* a relcache reset could free routine, so look it up each time */
+	for (i = 0; i < ntuples; i++)
+		(void) table_insert(rel, tuples[i], cid, options, bistate);
+}
+
+HTSU_Result
+table_delete(Relation rel, ItemPointer tid, CommandId cid,
+			 Snapshot crosscheck, bool wait, HeapUpdateFailureData *hufd)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	return routine->tuple_delete(rel, tid, cid, crosscheck, wait, hufd);
+}
+
+HTSU_Result
+table_update(Relation rel, ItemPointer otid, HeapTuple newtup,
+			 CommandId cid, Snapshot crosscheck, bool wait,
+			 HeapUpdateFailureData *hufd, LockTupleMode *lockmode)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	return routine->tuple_update(rel, otid, newtup, cid, crosscheck, wait,
+								 hufd, lockmode);
+}
+
+HTSU_Result
+table_lock_tuple(Relation rel, HeapTuple tuple, CommandId cid,
+				 LockTupleMode mode, LockWaitPolicy wait_policy,
+				 bool follow_update, Buffer *buffer,
+				 HeapUpdateFailureData *hufd)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	return routine->tuple_lock(rel, tuple, cid, mode, wait_policy,
+							   follow_update, buffer, hufd);
+}
+
+/*
+ * table_finish_bulk_insert - the statement inserting into a table is done
+ *
+ * Lets access methods that buffer inserted rows write them out.
+ */
+void
+table_finish_bulk_insert(Relation rel, int options)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	if (routine->finish_bulk_insert != NULL)
+		routine->finish_bulk_insert(rel, options);
+}
+
+
+/* ----------------------------------------------------------------
+ *					 relation-level operations
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * table_sync - make a table safe to use after inserting into it without WAL
+ *
+ * Only needed if the access method honors HEAP_INSERT_SKIP_WAL.
+ */
+void
+table_sync(Relation rel)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	if (routine->relation_sync != NULL)
+		routine->relation_sync(rel);
+}
+
+void
+table_vacuum(Relation rel, int options, struct VacuumParams *params,
+			 BufferAccessStrategy bstrategy)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	routine->relation_vacuum(rel, options, params, bstrategy);
+}
+
+/*
+ * table_analyze - get the function ANALYZE should use to sample the table
+ *
+ * Returns false if the access method doesn't support ANALYZE.
+ */
+bool
+table_analyze(Relation rel, AcquireSampleRowsFunc *func,
+			  BlockNumber *totalpages)
+{
+	TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+	if (routine->relation_analyze == NULL)
+		return false;
+
+	return routine->relation_analyze(rel, func, totalpages);
+}
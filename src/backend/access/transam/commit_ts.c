@@ -98,8 +98,9 @@ typedef struct CommitTimestampShared
 CommitTimestampShared *commitTsShared;
 
 
-/* GUC variable */
+/* GUC variables */
 bool		track_commit_timestamp;
+int			commit_ts_buffers = 0;
 
 static void SetXidCommitTsInPage(TransactionId xid, int nsubxids,
 					 TransactionId *subxids, TimestampTz ts,
@@ -461,6 +462,8 @@ pg_last_committed_xact(PG_FUNCTION_ARGS)
 Size
 CommitTsShmemBuffers(void)
 {
+	if (commit_ts_buffers > 0)
+		return commit_ts_buffers;
 	return Min(16, Max(4, NBuffers / 1024));
 }
 
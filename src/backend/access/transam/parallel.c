@@ -22,6 +22,7 @@
 #include "libpq/pqformat.h"
 #include "libpq/pqmq.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/ipc.h"
 #include "storage/sinval.h"
 #include "storage/spin.h"
@@ -439,6 +440,165 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Reserve room for one message queue of queue_size bytes per worker, next to
+ * the caller's own state, before InitializeParallelDSM.
+ *
+ * Operations that pass more than errors between the leader and its workers
+ * give each worker a queue of its own, running one way.  The caller sets them
+ * up with InitializeParallelQueues, attaches to them once the workers have
+ * been launched with AttachParallelQueues, and the workers attach to theirs
+ * with AttachParallelLeaderQueue.
+ */
+void
+EstimateParallelQueues(ParallelContext *pcxt, Size queue_size)
+{
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(queue_size, pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+}
+
+/*
+ * Create the workers' queues in the DSM segment, under the given key, with
+ * the leader on the sending or the receiving end.  Returns the queue space
+ * to pass to AttachParallelQueues.
+ */
+char *
+InitializeParallelQueues(ParallelContext *pcxt, uint64 key, Size queue_size,
+						 bool leader_sends)
+{
+	char	   *queuespace;
+	int			i;
+
+	queuespace = (char *) shm_toc_allocate(pcxt->toc,
+									mul_size(queue_size, pcxt->nworkers));
+	for (i = 0; i < pcxt->nworkers; ++i)
+	{
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(queuespace + i * queue_size, queue_size);
+		if (leader_sends)
+			shm_mq_set_sender(mq, MyProc);
+		else
+			shm_mq_set_receiver(mq, MyProc);
+	}
+	shm_toc_insert(pcxt->toc, key, queuespace);
+
+	return queuespace;
+}
+
+/*
+ * Attach to the queues of the workers that could be registered, after
+ * LaunchParallelWorkers.  The handles go to queues[], and if workers isn't
+ * NULL, the number of each queue's worker to workers[]; both need room for
+ * pcxt->nworkers entries.  Returns the number of queues attached to.
+ *
+ * Passing the worker's handle makes sending or receiving fail rather than
+ * hang if the worker dies before attaching.
+ */
+int
+AttachParallelQueues(ParallelContext *pcxt, char *queuespace, Size queue_size,
+					 shm_mq_handle **queues, int *workers)
+{
+	int			nqueues = 0;
+	int			i;
+
+	for (i = 0; i < pcxt->nworkers; ++i)
+	{
+		shm_mq	   *mq;
+
+		if (pcxt->worker[i].bgwhandle == NULL)
+			continue;
+		mq = (shm_mq *) (queuespace + i * queue_size);
+		queues[nqueues] = shm_mq_attach(mq, pcxt->seg,
+										pcxt->worker[i].bgwhandle);
+		if (workers != NULL)
+			workers[nqueues] = i;
+		nqueues++;
+	}
+
+	return nqueues;
+}
+
+/*
+ * Pass the messages the workers send through their queues to callback, as
+ * they come in, taking one from each queue in turn.  A worker detaches from
+ * its queue when it is done, or when it fails; such queues are removed from
+ * queues[], which is reordered.
+ *
+ * With nowait, we take what is there and return; otherwise we keep reading
+ * until every worker has detached, waiting for wait_event_info while all
+ * the queues are empty.  Either way, the caller must still wait for the
+ * workers to finish before relying on what they sent, as a worker that fails
+ * just stops sending.
+ */
+void
+ReceiveFromParallelQueues(shm_mq_handle **queues, int *nqueues, bool nowait,
+						  parallel_message_callback callback, void *arg,
+						  uint32 wait_event_info)
+{
+	while (*nqueues > 0)
+	{
+		bool		received = false;
+		int			i = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		while (i < *nqueues)
+		{
+			shm_mq_result res;
+			Size		nbytes;
+			void	   *data;
+
+			res = shm_mq_receive(queues[i], &nbytes, &data, true);
+			if (res == SHM_MQ_DETACHED)
+			{
+				queues[i] = queues[--(*nqueues)];
+				continue;
+			}
+			if (res == SHM_MQ_SUCCESS)
+			{
+				callback(arg, nbytes, data);
+				received = true;
+			}
+			i++;
+		}
+
+		if (received)
+			continue;
+		if (nowait)
+			break;
+		if (*nqueues > 0)
+		{
+			/* the workers set our latch as they fill their queues */
+			WaitLatch(MyLatch, WL_LATCH_SET, 0, wait_event_info);
+			ResetLatch(MyLatch);
+		}
+	}
+}
+
+/*
+ * Attach a parallel worker to its queue in the leader's queue space, which
+ * the worker has looked up in the TOC.  leader_sends must be as given to
+ * InitializeParallelQueues.
+ */
+shm_mq_handle *
+AttachParallelLeaderQueue(dsm_segment *seg, char *queuespace, Size queue_size,
+						  bool leader_sends)
+{
+	shm_mq	   *mq;
+
+	Assert(IsParallelWorker());
+
+	mq = (shm_mq *) (queuespace + ParallelWorkerNumber * queue_size);
+	if (leader_sends)
+		shm_mq_set_receiver(mq, MyProc);
+	else
+		shm_mq_set_sender(mq, MyProc);
+
+	return shm_mq_attach(mq, seg, NULL);
+}
+
 /*
  * Wait for all workers to exit.
  *
@@ -477,7 +637,8 @@ WaitForParallelWorkersToFinish(ParallelContext *pcxt)
 		if (!anyone_alive)
 			break;
 
-		WaitLatch(&MyProc->procLatch, WL_LATCH_SET, -1);
+		WaitLatch(&MyProc->procLatch, WL_LATCH_SET, -1,
+				  WAIT_EVENT_PARALLEL_FINISH);
 		ResetLatch(&MyProc->procLatch);
 	}
 
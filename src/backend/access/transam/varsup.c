@@ -228,7 +228,7 @@ GetNewTransactionId(bool isSubXact)
 		{
 			int			nxids = mypgxact->nxids;
 
-			if (nxids < PGPROC_MAX_CACHED_SUBXIDS)
+			if (nxids < max_cached_subxids)
 			{
 				myproc->subxids.xids[nxids] = xid;
 				mypgxact->nxids = nxids + 1;
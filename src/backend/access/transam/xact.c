@@ -20,11 +20,13 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "access/columnar.h"
 #include "access/commit_ts.h"
 #include "access/multixact.h"
 #include "access/parallel.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
+#include "access/tuptoaster.h"
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/xlog.h"
@@ -42,6 +44,7 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "replication/logical.h"
+#include "replication/logicallauncher.h"
 #include "replication/origin.h"
 #include "replication/syncrep.h"
 #include "replication/walsender.h"
@@ -445,6 +448,27 @@ MarkCurrentTransactionIdLoggedIfAny(void)
 		CurrentTransactionState->didLogXid = true;
 }
 
+/*
+ *	IsSubTransactionAssignmentPending
+ *
+ * Is the next WAL record the first one of the current subtransaction's XID?
+ * With wal_level = logical, that record names the toplevel transaction.
+ */
+bool
+IsSubTransactionAssignmentPending(void)
+{
+	if (!XLogLogicalInfoActive())
+		return false;
+
+	if (!IsSubTransaction())
+		return false;
+
+	if (!TransactionIdIsValid(CurrentTransactionState->transactionId))
+		return false;
+
+	return !CurrentTransactionState->didLogXid;
+}
+
 
 /*
  *	GetStableLatestTransactionId
@@ -688,11 +712,12 @@ GetCurrentCommandId(bool used)
 	{
 		/*
 		 * Forbid setting currentCommandIdUsed in parallel mode, because we
-		 * have no provision for communicating this back to the master.  We
-		 * could relax this restriction when currentCommandIdUsed was already
-		 * true at the start of the parallel operation.
+		 * have no provision for communicating this back to the master.  It's
+		 * fine if it was already true at the start of the parallel operation,
+		 * as it is for the workers of a parallel COPY FROM.
 		 */
-		Assert(CurrentTransactionState->parallelModeLevel == 0);
+		Assert(CurrentTransactionState->parallelModeLevel == 0 ||
+			   currentCommandIdUsed);
 		currentCommandIdUsed = true;
 	}
 	return currentCommandId;
@@ -1980,6 +2005,9 @@ CommitTransaction(void)
 	/* Shut down the deferred-trigger manager */
 	AfterTriggerEndXact(true);
 
+	/* Write out rows columnar tables still have buffered */
+	PreCommit_Columnar();
+
 	/*
 	 * Let ON COMMIT management do its thing (must happen after closing
 	 * cursors, to avoid dangling-reference problems)
@@ -2113,13 +2141,16 @@ CommitTransaction(void)
 	AtEOXact_GUC(true, 1);
 	AtEOXact_SPI(true);
 	AtEOXact_on_commit_actions(true);
+	AtEOXact_Columnar(true);
 	AtEOXact_Namespace(true, is_parallel_worker);
 	AtEOXact_SMgr();
 	AtEOXact_Files();
 	AtEOXact_ComboCid();
+	AtEOXact_DetoastCache();
 	AtEOXact_HashTables(true);
 	AtEOXact_PgStat(true);
 	AtEOXact_Snapshot(true);
+	AtEOXact_ApplyLauncher(true);
 	pgstat_report_xact_timestamp(0);
 
 	CurrentResourceOwner = NULL;
@@ -2210,6 +2241,9 @@ PrepareTransaction(void)
 	/* Shut down the deferred-trigger manager */
 	AfterTriggerEndXact(true);
 
+	/* Write out rows columnar tables still have buffered */
+	PreCommit_Columnar();
+
 	/*
 	 * Let ON COMMIT management do its thing (must happen after closing
 	 * cursors, to avoid dangling-reference problems)
@@ -2384,10 +2418,12 @@ PrepareTransaction(void)
 	AtEOXact_GUC(true, 1);
 	AtEOXact_SPI(true);
 	AtEOXact_on_commit_actions(true);
+	AtEOXact_Columnar(true);
 	AtEOXact_Namespace(true, false);
 	AtEOXact_SMgr();
 	AtEOXact_Files();
 	AtEOXact_ComboCid();
+	AtEOXact_DetoastCache();
 	AtEOXact_HashTables(true);
 	/* don't call AtEOXact_PgStat here; we fixed pgstat state above */
 	AtEOXact_Snapshot(true);
@@ -2446,6 +2482,7 @@ AbortTransaction(void)
 	 * while cleaning up!
 	 */
 	LWLockReleaseAll();
+	pgstat_report_wait_end();
 
 	/* Clean up buffer I/O and buffer context locks, too */
 	AbortBufferIO();
@@ -2580,12 +2617,15 @@ AbortTransaction(void)
 		AtEOXact_GUC(false, 1);
 		AtEOXact_SPI(false);
 		AtEOXact_on_commit_actions(false);
+		AtEOXact_Columnar(false);
 		AtEOXact_Namespace(false, is_parallel_worker);
 		AtEOXact_SMgr();
 		AtEOXact_Files();
 		AtEOXact_ComboCid();
+		AtEOXact_DetoastCache();
 		AtEOXact_HashTables(false);
 		AtEOXact_PgStat(false);
+		AtEOXact_ApplyLauncher(false);
 		pgstat_report_xact_timestamp(0);
 	}
 
@@ -4485,6 +4525,8 @@ CommitSubTransaction(void)
 	AtEOSubXact_SPI(true, s->subTransactionId);
 	AtEOSubXact_on_commit_actions(true, s->subTransactionId,
 								  s->parent->subTransactionId);
+	AtEOSubXact_Columnar(true, s->subTransactionId,
+						 s->parent->subTransactionId);
 	AtEOSubXact_Namespace(true, s->subTransactionId,
 						  s->parent->subTransactionId);
 	AtEOSubXact_Files(true, s->subTransactionId,
@@ -4537,6 +4579,7 @@ AbortSubTransaction(void)
 	 * Buffer locks, for example?  I don't think so but I'm not sure.
 	 */
 	LWLockReleaseAll();
+	pgstat_report_wait_end();
 
 	AbortBufferIO();
 	UnlockBuffers();
@@ -4633,6 +4676,8 @@ AbortSubTransaction(void)
 		AtEOSubXact_SPI(false, s->subTransactionId);
 		AtEOSubXact_on_commit_actions(false, s->subTransactionId,
 									  s->parent->subTransactionId);
+		AtEOSubXact_Columnar(false, s->subTransactionId,
+							 s->parent->subTransactionId);
 		AtEOSubXact_Namespace(false, s->subTransactionId,
 							  s->parent->subTransactionId);
 		AtEOSubXact_Files(false, s->subTransactionId,
@@ -4788,8 +4833,9 @@ Size
 EstimateTransactionStateSpace(void)
 {
 	TransactionState s;
-	Size		nxids = 6;		/* iso level, deferrable, top & current XID,
-								 * command counter, XID count */
+	Size		nxids = 7;		/* iso level, deferrable, top & current XID,
+								 * command counter, whether it's used, XID
+								 * count */
 
 	for (s = CurrentTransactionState; s != NULL; s = s->parent)
 	{
@@ -4812,7 +4858,8 @@ EstimateTransactionStateSpace(void)
  * contain XactDeferrable and XactIsoLevel; the next twelve bytes contain the
  * XID of the top-level transaction, the XID of the current transaction
  * (or, in each case, InvalidTransactionId if none), and the current command
- * counter.  After that, the next 4 bytes contain a count of how many
+ * counter; the next 4 bytes say whether the command counter has been used.
+ * After that, the next 4 bytes contain a count of how many
  * additional XIDs follow; this is followed by all of those XIDs one after
  * another.  We emit the XIDs in sorted order for the convenience of the
  * receiving process.
@@ -4832,6 +4879,7 @@ SerializeTransactionState(Size maxsize, char *start_address)
 	result[c++] = XactTopTransactionId;
 	result[c++] = CurrentTransactionState->transactionId;
 	result[c++] = (TransactionId) currentCommandId;
+	result[c++] = (TransactionId) currentCommandIdUsed;
 	Assert(maxsize >= c * sizeof(TransactionId));
 
 	/*
@@ -4898,8 +4946,9 @@ StartParallelWorkerTransaction(char *tstatespace)
 	XactTopTransactionId = tstate[2];
 	CurrentTransactionState->transactionId = tstate[3];
 	currentCommandId = tstate[4];
-	nParallelCurrentXids = (int) tstate[5];
-	ParallelCurrentXids = &tstate[6];
+	currentCommandIdUsed = (bool) tstate[5];
+	nParallelCurrentXids = (int) tstate[6];
+	ParallelCurrentXids = &tstate[7];
 
 	CurrentTransactionState->blockState = TBLOCK_PARALLEL_INPROGRESS;
 }
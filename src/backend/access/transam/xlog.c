@@ -33,16 +33,21 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
+#include "access/xlogparallel.h"
+#include "access/xlogprefetch.h"
 #include "access/xlogreader.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
 #include "catalog/pg_control.h"
 #include "catalog/pg_database.h"
+#include "commands/sequence.h"
 #include "commands/tablespace.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/startup.h"
+#include "postmaster/walwriter.h"
 #include "replication/basebackup.h"
 #include "replication/logical.h"
 #include "replication/slot.h"
@@ -92,7 +97,7 @@ char	   *XLogArchiveCommand = NULL;
 bool		EnableHotStandby = false;
 bool		fullPageWrites = true;
 bool		wal_log_hints = false;
-bool		wal_compression = false;
+int			wal_compression = WAL_COMPRESSION_NONE;
 bool		log_checkpoints = false;
 int			sync_method = DEFAULT_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_MINIMAL;
@@ -100,16 +105,23 @@ int			CommitDelay = 0;	/* precommit delay in microseconds */
 int			CommitSiblings = 5; /* # concurrent xacts needed to sleep */
 int			wal_retrieve_retry_interval = 5000;
 
-#ifdef WAL_DEBUG
-bool		XLOG_DEBUG = false;
-#endif
-
 /*
  * Number of WAL insertion locks to use. A higher value allows more insertions
  * to happen concurrently, but adds some CPU overhead to flushing the WAL,
  * which needs to iterate all the locks.
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			wal_insert_locks = 8;
+
+/*
+ * Number of WAL segments the WAL writer keeps ready ahead of the one being
+ * inserted into, so that backends don't have to create them while holding
+ * WALWriteLock.
+ */
+int			wal_preallocate_segments = 2;
+
+#ifdef WAL_DEBUG
+bool		XLOG_DEBUG = false;
+#endif
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -161,6 +173,30 @@ extern const struct config_enum_entry archive_mode_options[] = {
 	{NULL, 0, false}
 };
 
+/*
+ * "on" means pglz, for compatibility with the boolean this used to be.
+ * The algorithms that weren't built in are not accepted at all.
+ */
+// Peloton
+extern const struct config_enum_entry wal_compression_options[] = {
+	{"pglz", WAL_COMPRESSION_PGLZ, false},
+#ifdef USE_LZ4
+	{"lz4", WAL_COMPRESSION_LZ4, false},
+#endif
+#ifdef USE_ZSTD
+	{"zstd", WAL_COMPRESSION_ZSTD, false},
+#endif
+	{"on", WAL_COMPRESSION_PGLZ, false},
+	{"off", WAL_COMPRESSION_NONE, false},
+	{"true", WAL_COMPRESSION_PGLZ, true},
+	{"false", WAL_COMPRESSION_NONE, true},
+	{"yes", WAL_COMPRESSION_PGLZ, true},
+	{"no", WAL_COMPRESSION_NONE, true},
+	{"1", WAL_COMPRESSION_PGLZ, true},
+	{"0", WAL_COMPRESSION_NONE, true},
+	{NULL, 0, false}
+};
+
 /*
  * Statistics for current checkpoint are collected in this global struct.
  * Because only the checkpointer or a stand-alone backend can perform
@@ -323,7 +359,7 @@ static TimeLineID curFileTLI;
  * stored here.  The parallel leader advances its own copy, when necessary,
  * in WaitForParallelWorkersToFinish.
  */
-static XLogRecPtr ProcLastRecPtr = InvalidXLogRecPtr;
+XLogRecPtr	ProcLastRecPtr = InvalidXLogRecPtr;
 
 XLogRecPtr	XactLastRecEnd = InvalidXLogRecPtr;
 XLogRecPtr	XactLastCommitEnd = InvalidXLogRecPtr;
@@ -413,8 +449,8 @@ typedef struct XLogwrtResult
 } XLogwrtResult;
 
 /*
- * Inserting to WAL is protected by a small fixed number of WAL insertion
- * locks. To insert to the WAL, you must hold one of the locks - it doesn't
+ * Inserting to WAL is protected by a small number of WAL insertion locks,
+ * set by wal_insert_locks at server start. To insert to the WAL, you must hold one of the locks - it doesn't
  * matter which one. To lock out other concurrent insertions, you must hold
  * of them. Each WAL insertion lock consists of a lightweight lock, plus an
  * indicator of how far the insertion has progressed (insertingAt).
@@ -443,6 +479,14 @@ typedef struct
 {
 	LWLock		lock;
 	XLogRecPtr	insertingAt;
+
+	/*
+	 * Statistics, see pg_stat_get_wal_insert_locks(): how many times the lock
+	 * was acquired for an insertion, and how many of those had to wait.
+	 * Only the holder of the lock updates them.
+	 */
+	uint64		acquired;
+	uint64		contended;
 } WALInsertLock;
 
 /*
@@ -471,8 +515,14 @@ typedef struct XLogCtlInsert
 	 * previously inserted (or rather, reserved) record - it is copied to the
 	 * prev-link of the next record. These are stored as "usable byte
 	 * positions" rather than XLogRecPtrs (see XLogBytePosToRecPtr()).
+	 *
+	 * Both are only changed while holding insertpos_lck, as the prev-link
+	 * must be reserved together with the space. But CurrBytePos is an atomic
+	 * variable, so that processes that only want to know how much WAL has
+	 * been reserved, like WaitXLogInsertionsToFinish(), can read it without
+	 * competing with the inserters for the spinlock.
 	 */
-	uint64		CurrBytePos;
+	pg_atomic_uint64 CurrBytePos;
 	uint64		PrevBytePos;
 
 	/*
@@ -548,6 +598,32 @@ typedef struct XLogCtlData
 	 */
 	XLogwrtResult LogwrtResult;
 
+	/*
+	 * First member of the group of backends waiting for their WAL to be
+	 * flushed, or INVALID_PGPROCNO.  See XLogFlushGroup().
+	 */
+	pg_atomic_uint32 flushGroupFirst;
+
+	/*
+	 * Group flush statistics.  The number of flushes done by group leaders
+	 * and of the requests they satisfied are protected by WALWriteLock; the
+	 * time the members spent waiting (in microseconds) is added atomically.
+	 */
+	uint64		flushGroupFlushes;
+	uint64		flushGroupRequests;
+	pg_atomic_uint64 flushGroupWaitTime;
+
+	/*
+	 * Highest segment that XLogBackgroundPreallocate() knows to exist,
+	 * protected by info_lck.  The number of segments created while writing
+	 * WAL is protected by WALWriteLock, and the number of segments created
+	 * ahead of time is only updated by the WAL writer and the checkpointer's
+	 * PreallocXlogFiles(), which both hold no lock, so it's atomic.
+	 */
+	XLogSegNo	preallocSegNo;
+	uint64		segsCreatedForeground;
+	pg_atomic_uint64 segsCreatedBackground;
+
 	/*
 	 * Latest initialized page in the cache (last byte position + 1).
 	 *
@@ -808,6 +884,7 @@ static XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 static void AdvanceXLInsertBuffer(XLogRecPtr upto, bool opportunistic);
 static bool XLogCheckpointNeeded(XLogSegNo new_segno);
 static void XLogWrite(XLogwrtRqst WriteRqst, bool flexible);
+static void XLogFlushGroup(XLogRecPtr upto);
 static bool InstallXLogFileSegment(XLogSegNo *segno, char *tmppath,
 					   bool find_free, XLogSegNo max_segno,
 					   bool use_lock);
@@ -848,7 +925,6 @@ static bool read_backup_label(XLogRecPtr *checkPointLoc,
 				  bool *backupEndRequired, bool *backupFromStandby);
 static bool read_tablespace_map(List **tablespaces);
 
-static void rm_redo_error_callback(void *arg);
 static int	get_sync_bit(int method);
 
 static void CopyXLogRecordToWAL(int write_len, bool isLogSwitch,
@@ -919,7 +995,7 @@ XLogInsertRecord(XLogRecData *rdata, XLogRecPtr fpw_lsn)
 	 *
 	 * 1. Reserve the right amount of space from the WAL. The current head of
 	 *	  reserved space is kept in Insert->CurrBytePos, and is protected by
-	 *	  insertpos_lck.
+	 *	  insertpos_lck, although it can be read without it.
 	 *
 	 * 2. Copy the record to the reserved WAL space. This involves finding the
 	 *	  correct WAL buffer containing the reserved space, and copying the
@@ -928,8 +1004,8 @@ XLogInsertRecord(XLogRecData *rdata, XLogRecPtr fpw_lsn)
 	 * To keep track of which insertions are still in-progress, each concurrent
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
-	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
+	 * has progressed. There is a small number of insertion locks,
+	 * determined by wal_insert_locks. When an inserter crosses a page
 	 * boundary, it updates the value stored in the lock to the how far it has
 	 * inserted, to allow the previous buffer to be flushed.
 	 *
@@ -1009,6 +1085,10 @@ XLogInsertRecord(XLogRecData *rdata, XLogRecPtr fpw_lsn)
 		 */
 		CopyXLogRecordToWAL(rechdr->xl_tot_len, isLogSwitch, rdata,
 							StartPos, EndPos);
+
+		/* Charge the record to the statement's usage counters */
+		pgBufferUsage.wal_records++;
+		pgBufferUsage.wal_bytes += rechdr->xl_tot_len;
 	}
 	else
 	{
@@ -1169,10 +1249,10 @@ ReserveXLogInsertLocation(int size, XLogRecPtr *StartPos, XLogRecPtr *EndPos,
 	 */
 	SpinLockAcquire(&Insert->insertpos_lck);
 
-	startbytepos = Insert->CurrBytePos;
+	startbytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 	endbytepos = startbytepos + size;
 	prevbytepos = Insert->PrevBytePos;
-	Insert->CurrBytePos = endbytepos;
+	pg_atomic_write_u64(&Insert->CurrBytePos, endbytepos);
 	Insert->PrevBytePos = startbytepos;
 
 	SpinLockRelease(&Insert->insertpos_lck);
@@ -1218,7 +1298,7 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 	 */
 	SpinLockAcquire(&Insert->insertpos_lck);
 
-	startbytepos = Insert->CurrBytePos;
+	startbytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 
 	ptr = XLogBytePosToEndRecPtr(startbytepos);
 	if (ptr % XLOG_SEG_SIZE == 0)
@@ -1241,7 +1321,7 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 		*EndPos += segleft;
 		endbytepos = XLogRecPtrToBytePos(*EndPos);
 	}
-	Insert->CurrBytePos = endbytepos;
+	pg_atomic_write_u64(&Insert->CurrBytePos, endbytepos);
 	Insert->PrevBytePos = startbytepos;
 
 	SpinLockRelease(&Insert->insertpos_lck);
@@ -1403,7 +1483,7 @@ WALInsertLockAcquire(void)
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProc->pgprocno % NUM_XLOGINSERT_LOCKS;
+		lockToTry = MyProc->pgprocno % wal_insert_locks;
 	MyLockNo = lockToTry;
 
 	/*
@@ -1421,8 +1501,13 @@ WALInsertLockAcquire(void)
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		lockToTry = (lockToTry + 1) % wal_insert_locks;
 	}
+
+	/* we hold the lock, so nobody else can be updating these */
+	WALInsertLocks[MyLockNo].l.acquired++;
+	if (!immed)
+		WALInsertLocks[MyLockNo].l.contended++;
 }
 
 /*
@@ -1439,7 +1524,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < wal_insert_locks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1465,7 +1550,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < wal_insert_locks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1493,8 +1578,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-					 &WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[wal_insert_locks - 1].l.lock,
+						&WALInsertLocks[wal_insert_locks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1529,10 +1614,13 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	if (MyProc == NULL)
 		elog(PANIC, "cannot wait without a PGPROC structure");
 
-	/* Read the current insert position */
-	SpinLockAcquire(&Insert->insertpos_lck);
-	bytepos = Insert->CurrBytePos;
-	SpinLockRelease(&Insert->insertpos_lck);
+	/*
+	 * Read the current insert position.  We don't need insertpos_lck for
+	 * that, but the caller may have learned about 'upto' from another
+	 * backend, so make sure we don't see an older value than that backend.
+	 */
+	pg_memory_barrier();
+	bytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 	reservedUpto = XLogBytePosToEndRecPtr(bytepos);
 
 	/*
@@ -1561,7 +1649,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1949,6 +2037,15 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, bool opportunistic)
 
 		NewPage = (XLogPageHeader) (XLogCtl->pages + nextidx * (Size) XLOG_BLCKSZ);
 
+		/*
+		 * Mark the buffer as not holding any page before we start to
+		 * overwrite it.  XLogReadFromBuffers() copies pages out without
+		 * holding a lock, and relies on xlblocks changing whenever the
+		 * contents do.
+		 */
+		*((volatile XLogRecPtr *) &XLogCtl->xlblocks[nextidx]) = InvalidXLogRecPtr;
+		pg_write_barrier();
+
 		/*
 		 * Be sure to re-zero the buffer so that bytes beyond what we've
 		 * written will look like zeroes and not valid XLOG records...
@@ -2224,6 +2321,12 @@ XLogWrite(XLogwrtRqst WriteRqst, bool flexible)
 			use_existent = true;
 			openLogFile = XLogFileInit(openLogSegNo, &use_existent, true);
 			openLogOff = 0;
+			if (!use_existent)
+				XLogCtl->segsCreatedForeground++;
+
+			/* have the WAL writer prepare the segments after this one */
+			if (wal_preallocate_segments > 0 && ProcGlobal->walwriterLatch)
+				SetLatch(ProcGlobal->walwriterLatch);
 		}
 
 		/* Make sure we have the current logfile open */
@@ -2282,7 +2385,9 @@ XLogWrite(XLogwrtRqst WriteRqst, bool flexible)
 			do
 			{
 				errno = 0;
+				pgstat_report_wait_start(WAIT_EVENT_WAL_WRITE);
 				written = write(openLogFile, from, nleft);
+				pgstat_report_wait_end();
 				if (written <= 0)
 				{
 					if (errno == EINTR)
@@ -2571,7 +2676,6 @@ void
 XLogFlush(XLogRecPtr record)
 {
 	XLogRecPtr	WriteRqstPtr;
-	XLogwrtRqst WriteRqst;
 
 	/*
 	 * During REDO, we are reading not writing WAL.  Therefore, instead of
@@ -2612,8 +2716,7 @@ XLogFlush(XLogRecPtr record)
 	WriteRqstPtr = record;
 
 	/*
-	 * Now wait until we get the write lock, or someone else does the flush
-	 * for us.
+	 * Now wait until we've flushed, or someone else does the flush for us.
 	 */
 	for (;;)
 	{
@@ -2637,64 +2740,11 @@ XLogFlush(XLogRecPtr record)
 		insertpos = WaitXLogInsertionsToFinish(WriteRqstPtr);
 
 		/*
-		 * Try to get the write lock. If we can't get it immediately, wait
-		 * until it's released, and recheck if we still need to do the flush
-		 * or if the backend that held the lock did it for us already. This
-		 * helps to maintain a good rate of group committing when the system
-		 * is bottlenecked by the speed of fsyncing.
+		 * Have our group leader, or ourselves if we become the leader, write
+		 * and flush the WAL through insertpos, and any later additions that
+		 * the other members of the group need.
 		 */
-		if (!LWLockAcquireOrWait(WALWriteLock, LW_EXCLUSIVE))
-		{
-			/*
-			 * The lock is now free, but we didn't acquire it yet. Before we
-			 * do, loop back to check if someone else flushed the record for
-			 * us already.
-			 */
-			continue;
-		}
-
-		/* Got the lock; recheck whether request is satisfied */
-		LogwrtResult = XLogCtl->LogwrtResult;
-		if (record <= LogwrtResult.Flush)
-		{
-			LWLockRelease(WALWriteLock);
-			break;
-		}
-
-		/*
-		 * Sleep before flush! By adding a delay here, we may give further
-		 * backends the opportunity to join the backlog of group commit
-		 * followers; this can significantly improve transaction throughput,
-		 * at the risk of increasing transaction latency.
-		 *
-		 * We do not sleep if enableFsync is not turned on, nor if there are
-		 * fewer than CommitSiblings other backends with active transactions.
-		 */
-		if (CommitDelay > 0 && enableFsync &&
-			MinimumActiveBackends(CommitSiblings))
-		{
-			pg_usleep(CommitDelay);
-
-			/*
-			 * Re-check how far we can now flush the WAL. It's generally not
-			 * safe to call WaitXLogInsertionsToFinish while holding
-			 * WALWriteLock, because an in-progress insertion might need to
-			 * also grab WALWriteLock to make progress. But we know that all
-			 * the insertions up to insertpos have already finished, because
-			 * that's what the earlier WaitXLogInsertionsToFinish() returned.
-			 * We're only calling it again to allow insertpos to be moved
-			 * further forward, not to actually wait for anyone.
-			 */
-			insertpos = WaitXLogInsertionsToFinish(insertpos);
-		}
-
-		/* try to write/flush later additions to XLOG as well */
-		WriteRqst.Write = insertpos;
-		WriteRqst.Flush = insertpos;
-
-		XLogWrite(WriteRqst, false);
-
-		LWLockRelease(WALWriteLock);
+		XLogFlushGroup(insertpos);
 		/* done */
 		break;
 	}
@@ -2732,6 +2782,192 @@ XLogFlush(XLogRecPtr record)
 		   (uint32) (LogwrtResult.Flush >> 32), (uint32) LogwrtResult.Flush);
 }
 
+/*
+ * Subroutine of XLogFlush: write and flush WAL through at least 'upto',
+ * together with the requests of any other backends doing the same.
+ *
+ * All insertions before 'upto' must already have finished.
+ *
+ * Backends wanting a flush push themselves onto a list.  The one that finds
+ * the list empty becomes the group leader: it acquires WALWriteLock, which
+ * usually means waiting for the previous leader's fsync, while the others
+ * join the group.  It then takes the whole list, does one write and fsync
+ * that satisfies all members, and wakes them up.  The other members just
+ * sleep on their semaphores until that has happened.
+ *
+ * On return, LogwrtResult has been updated from shared memory.
+ */
+static void
+XLogFlushGroup(XLogRecPtr upto)
+{
+	PGPROC	   *proc = MyProc;
+	uint32		nextidx;
+	uint32		wakeidx;
+	XLogRecPtr	target;
+	uint64		nrequests;
+	bool		delayed = false;
+	instr_time	start_time;
+	instr_time	wait_time;
+
+	INSTR_TIME_SET_CURRENT(start_time);
+
+	/* Add ourselves to the list of backends waiting for a flush. */
+	proc->walFlushGroupUpto = upto;
+	proc->walFlushGroupMember = true;
+	nextidx = pg_atomic_read_u32(&XLogCtl->flushGroupFirst);
+	for (;;)
+	{
+		pg_atomic_write_u32(&proc->walFlushGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&XLogCtl->flushGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will flush for us.  Sleep until
+	 * it has.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		pgstat_report_wait_start(WAIT_EVENT_WAL_FLUSH_GROUP);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(&proc->sem);
+			if (!proc->walFlushGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(&proc->sem);
+
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+
+		INSTR_TIME_SET_CURRENT(wait_time);
+		INSTR_TIME_SUBTRACT(wait_time, start_time);
+		pg_atomic_fetch_add_u64(&XLogCtl->flushGroupWaitTime,
+								INSTR_TIME_GET_MICROSEC(wait_time));
+		return;
+	}
+
+	/* We are the leader. */
+	LWLockAcquire(WALWriteLock, LW_EXCLUSIVE);
+
+	/*
+	 * Sleep before flush! By adding a delay here, we give further backends
+	 * the opportunity to join the group; this can significantly improve
+	 * transaction throughput, at the risk of increasing transaction latency.
+	 *
+	 * We do not sleep if enableFsync is not turned on, nor if there are fewer
+	 * than CommitSiblings other backends with active transactions.
+	 */
+	if (CommitDelay > 0 && enableFsync &&
+		MinimumActiveBackends(CommitSiblings))
+	{
+		pg_usleep(CommitDelay);
+		delayed = true;
+	}
+
+	/*
+	 * Take the whole group, and find out how far we need to flush.  Anyone
+	 * arriving from now on starts the next group.
+	 */
+	nextidx = pg_atomic_exchange_u32(&XLogCtl->flushGroupFirst,
+									 INVALID_PGPROCNO);
+	wakeidx = nextidx;
+	target = InvalidXLogRecPtr;
+	nrequests = 0;
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[nextidx];
+
+		if (member->walFlushGroupUpto > target)
+			target = member->walFlushGroupUpto;
+		nrequests++;
+		nextidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+	}
+
+	/*
+	 * Also flush any later additions to XLOG that are already complete. It's
+	 * generally not safe to call WaitXLogInsertionsToFinish while holding
+	 * WALWriteLock, because an in-progress insertion might need to also grab
+	 * WALWriteLock to make progress. But we know that all the insertions up
+	 * to target have already finished, because every member got its request
+	 * from WaitXLogInsertionsToFinish().  We're only calling it again to
+	 * allow target to be moved further forward, not to actually wait for
+	 * anyone.
+	 */
+	if (delayed)
+		target = WaitXLogInsertionsToFinish(target);
+
+	/* Recheck whether someone else flushed far enough already. */
+	LogwrtResult = XLogCtl->LogwrtResult;
+	if (LogwrtResult.Flush < target)
+	{
+		XLogwrtRqst WriteRqst;
+
+		WriteRqst.Write = target;
+		WriteRqst.Flush = target;
+		XLogWrite(WriteRqst, false);
+
+		XLogCtl->flushGroupFlushes++;
+		XLogCtl->flushGroupRequests += nrequests;
+	}
+
+	LWLockRelease(WALWriteLock);
+
+	/*
+	 * Wake up the members.  We should not do this while holding WALWriteLock,
+	 * as they may need it right away for their next flush.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[wakeidx];
+
+		wakeidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+		pg_atomic_write_u32(&member->walFlushGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		member->walFlushGroupMember = false;
+
+		if (member != MyProc)
+			PGSemaphoreUnlock(&member->sem);
+	}
+
+	INSTR_TIME_SET_CURRENT(wait_time);
+	INSTR_TIME_SUBTRACT(wait_time, start_time);
+	pg_atomic_fetch_add_u64(&XLogCtl->flushGroupWaitTime,
+							INSTR_TIME_GET_MICROSEC(wait_time));
+}
+
+/*
+ * Report the statistics of group WAL flushes: the number of flushes done by
+ * group leaders, the number of flush requests they satisfied, and the total
+ * time, in microseconds, that backends spent waiting for a flush.
+ *
+ * The counters are read without a lock, so they can be slightly stale.
+ */
+void
+GetXLogFlushGroupStats(uint64 *flushes, uint64 *requests, uint64 *wait_time)
+{
+	*flushes = XLogCtl->flushGroupFlushes;
+	*requests = XLogCtl->flushGroupRequests;
+	*wait_time = pg_atomic_read_u64(&XLogCtl->flushGroupWaitTime);
+}
+
 /*
  * Flush xlog, but without specifying exactly where to flush to.
  *
@@ -2752,9 +2988,12 @@ XLogFlush(XLogRecPtr record)
 bool
 XLogBackgroundFlush(void)
 {
-	XLogRecPtr	WriteRqstPtr;
+	XLogwrtRqst WriteRqst;
 	bool		flexible = true;
 	bool		wrote_something = false;
+	static TimestampTz lastflush;
+	TimestampTz now;
+	int			flushbytes;
 
 	/* XLOG doesn't need flushing during recovery */
 	if (RecoveryInProgress())
@@ -2763,17 +3002,17 @@ XLogBackgroundFlush(void)
 	/* read LogwrtResult and update local state */
 	SpinLockAcquire(&XLogCtl->info_lck);
 	LogwrtResult = XLogCtl->LogwrtResult;
-	WriteRqstPtr = XLogCtl->LogwrtRqst.Write;
+	WriteRqst = XLogCtl->LogwrtRqst;
 	SpinLockRelease(&XLogCtl->info_lck);
 
 	/* back off to last completed page boundary */
-	WriteRqstPtr -= WriteRqstPtr % XLOG_BLCKSZ;
+	WriteRqst.Write -= WriteRqst.Write % XLOG_BLCKSZ;
 
 	/* if we have already flushed that far, consider async commit records */
-	if (WriteRqstPtr <= LogwrtResult.Flush)
+	if (WriteRqst.Write <= LogwrtResult.Flush)
 	{
 		SpinLockAcquire(&XLogCtl->info_lck);
-		WriteRqstPtr = XLogCtl->asyncXactLSN;
+		WriteRqst.Write = XLogCtl->asyncXactLSN;
 		SpinLockRelease(&XLogCtl->info_lck);
 		flexible = false;		/* ensure it all gets written */
 	}
@@ -2783,7 +3022,7 @@ XLogBackgroundFlush(void)
 	 * holding an open file handle to a logfile that's no longer in use,
 	 * preventing the file from being deleted.
 	 */
-	if (WriteRqstPtr <= LogwrtResult.Flush)
+	if (WriteRqst.Write <= LogwrtResult.Flush)
 	{
 		if (openLogFile >= 0)
 		{
@@ -2795,10 +3034,49 @@ XLogBackgroundFlush(void)
 		return false;
 	}
 
+	/*
+	 * Determine how far to flush WAL, based on the wal_writer_delay and
+	 * wal_writer_flush_after GUCs.  Writing without flushing lets the kernel
+	 * start on the I/O, while one fsync for a larger batch is much cheaper
+	 * than one every wal_writer_delay.
+	 */
+	now = GetCurrentTimestamp();
+	flushbytes =
+		WriteRqst.Write / XLOG_BLCKSZ - LogwrtResult.Flush / XLOG_BLCKSZ;
+
+	if (WalWriterFlushAfter == 0 || lastflush == 0)
+	{
+		/* first call, or block based limits disabled */
+		WriteRqst.Flush = WriteRqst.Write;
+		lastflush = now;
+	}
+	else if (TimestampDifferenceExceeds(lastflush, now, WalWriterDelay))
+	{
+		/*
+		 * Flush the writes at least every WalWriterDelay ms. This is
+		 * important to bound the amount of time it takes for an asynchronous
+		 * commit to hit disk.
+		 */
+		WriteRqst.Flush = WriteRqst.Write;
+		lastflush = now;
+	}
+	else if (flushbytes >= WalWriterFlushAfter)
+	{
+		/* exceeded wal_writer_flush_after blocks, flush */
+		WriteRqst.Flush = WriteRqst.Write;
+		lastflush = now;
+	}
+	else
+	{
+		/* no flushing, this time round */
+		WriteRqst.Flush = 0;
+	}
+
 #ifdef WAL_DEBUG
 	if (XLOG_DEBUG)
-		elog(LOG, "xlog bg flush request %X/%X; write %X/%X; flush %X/%X",
-			 (uint32) (WriteRqstPtr >> 32), (uint32) WriteRqstPtr,
+		elog(LOG, "xlog bg flush request write %X/%X; flush: %X/%X, current is write %X/%X; flush %X/%X",
+			 (uint32) (WriteRqst.Write >> 32), (uint32) WriteRqst.Write,
+			 (uint32) (WriteRqst.Flush >> 32), (uint32) WriteRqst.Flush,
 			 (uint32) (LogwrtResult.Write >> 32), (uint32) LogwrtResult.Write,
 		   (uint32) (LogwrtResult.Flush >> 32), (uint32) LogwrtResult.Flush);
 #endif
@@ -2806,15 +3084,12 @@ XLogBackgroundFlush(void)
 	START_CRIT_SECTION();
 
 	/* now wait for any in-progress insertions to finish and get write lock */
-	WaitXLogInsertionsToFinish(WriteRqstPtr);
+	WaitXLogInsertionsToFinish(WriteRqst.Write);
 	LWLockAcquire(WALWriteLock, LW_EXCLUSIVE);
 	LogwrtResult = XLogCtl->LogwrtResult;
-	if (WriteRqstPtr > LogwrtResult.Flush)
+	if (WriteRqst.Write > LogwrtResult.Write ||
+		WriteRqst.Flush > LogwrtResult.Flush)
 	{
-		XLogwrtRqst WriteRqst;
-
-		WriteRqst.Write = WriteRqstPtr;
-		WriteRqst.Flush = WriteRqstPtr;
 		XLogWrite(WriteRqst, flexible);
 		wrote_something = true;
 	}
@@ -2982,6 +3257,7 @@ XLogFileInit(XLogSegNo logsegno, bool *use_existent, bool use_lock)
 	 */
 	zbuffer = (char *) MAXALIGN(zbuffer_raw);
 	memset(zbuffer, 0, XLOG_BLCKSZ);
+	pgstat_report_wait_start(WAIT_EVENT_WAL_INIT_WRITE);
 	for (nbytes = 0; nbytes < XLogSegSize; nbytes += XLOG_BLCKSZ)
 	{
 		errno = 0;
@@ -3004,7 +3280,9 @@ XLogFileInit(XLogSegNo logsegno, bool *use_existent, bool use_lock)
 					 errmsg("could not write to file \"%s\": %m", tmppath)));
 		}
 	}
+	pgstat_report_wait_end();
 
+	pgstat_report_wait_start(WAIT_EVENT_WAL_INIT_SYNC);
 	if (pg_fsync(fd) != 0)
 	{
 		close(fd);
@@ -3012,6 +3290,7 @@ XLogFileInit(XLogSegNo logsegno, bool *use_existent, bool use_lock)
 				(errcode_for_file_access(),
 				 errmsg("could not fsync file \"%s\": %m", tmppath)));
 	}
+	pgstat_report_wait_end();
 
 	if (close(fd))
 		ereport(ERROR,
@@ -3485,12 +3764,10 @@ XLogFileClose(void)
 /*
  * Preallocate log files beyond the specified log endpoint.
  *
- * XXX this is currently extremely conservative, since it forces only one
- * future log segment to exist, and even that only if we are 75% done with
- * the current one.  This is only appropriate for very low-WAL-volume systems.
- * High-volume systems will be OK once they've built up a sufficient set of
- * recycled log segments, but the startup transient is likely to include
- * a lot of segment creations by foreground processes, which is not so good.
+ * This is extremely conservative, since it forces only one future log
+ * segment to exist, and even that only if we are 75% done with the current
+ * one.  Between checkpoints, the WAL writer keeps wal_preallocate_segments
+ * future segments around, see XLogBackgroundPreallocate().
  */
 static void
 PreallocXlogFiles(XLogRecPtr endptr)
@@ -3507,10 +3784,67 @@ PreallocXlogFiles(XLogRecPtr endptr)
 		lf = XLogFileInit(_logSegNo, &use_existent, true);
 		close(lf);
 		if (!use_existent)
+		{
 			CheckpointStats.ckpt_segs_added++;
+			pg_atomic_fetch_add_u64(&XLogCtl->segsCreatedBackground, 1);
+		}
 	}
 }
 
+/*
+ * Make sure that the wal_preallocate_segments segments after the one being
+ * inserted into exist, zero-filled or recycled, so that backends don't have
+ * to create them in XLogWrite().
+ *
+ * Only one segment is looked at per call, so that the WAL writer, which
+ * calls this periodically, can flush WAL in between.  Returns TRUE if it
+ * created or found a segment, meaning that it should be called again soon.
+ */
+bool
+XLogBackgroundPreallocate(void)
+{
+	XLogSegNo	insertSegNo;
+	XLogSegNo	segno;
+	int			fd;
+	bool		use_existent;
+
+	if (wal_preallocate_segments <= 0 || RecoveryInProgress())
+		return false;
+
+	XLByteToPrevSeg(GetXLogInsertRecPtr(), insertSegNo);
+
+	SpinLockAcquire(&XLogCtl->info_lck);
+	segno = Max(XLogCtl->preallocSegNo, insertSegNo) + 1;
+	SpinLockRelease(&XLogCtl->info_lck);
+
+	if (segno > insertSegNo + wal_preallocate_segments)
+		return false;
+
+	use_existent = true;
+	fd = XLogFileInit(segno, &use_existent, true);
+	close(fd);
+	if (!use_existent)
+		pg_atomic_fetch_add_u64(&XLogCtl->segsCreatedBackground, 1);
+
+	SpinLockAcquire(&XLogCtl->info_lck);
+	if (XLogCtl->preallocSegNo < segno)
+		XLogCtl->preallocSegNo = segno;
+	SpinLockRelease(&XLogCtl->info_lck);
+
+	return true;
+}
+
+/*
+ * Report the number of WAL segments created while writing WAL, and ahead of
+ * time, since server start.
+ */
+void
+GetXLogSegmentCreationStats(uint64 *foreground, uint64 *background)
+{
+	*foreground = XLogCtl->segsCreatedForeground;
+	*background = pg_atomic_read_u64(&XLogCtl->segsCreatedBackground);
+}
+
 /*
  * Throws an error if the given log segment has already been removed or
  * recycled. The caller should only pass a segment that it knows to have
@@ -4582,7 +4916,7 @@ XLOGShmemSize(void)
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), wal_insert_locks + 1));
 	/* xlblocks array */
 	size = add_size(size, mul_size(sizeof(XLogRecPtr), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
@@ -4659,7 +4993,7 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) %sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * wal_insert_locks;
 
 	XLogCtl->Insert.WALInsertLockTrancheId = LWLockNewTrancheId();
 
@@ -4668,11 +5002,13 @@ XLOGShmemInit(void)
 	XLogCtl->Insert.WALInsertLockTranche.array_stride = sizeof(WALInsertLockPadded);
 
 	LWLockRegisterTranche(XLogCtl->Insert.WALInsertLockTrancheId, &XLogCtl->Insert.WALInsertLockTranche);
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock,
 						 XLogCtl->Insert.WALInsertLockTrancheId);
 		WALInsertLocks[i].l.insertingAt = InvalidXLogRecPtr;
+		WALInsertLocks[i].l.acquired = 0;
+		WALInsertLocks[i].l.contended = 0;
 	}
 
 	/*
@@ -4694,7 +5030,11 @@ XLOGShmemInit(void)
 	XLogCtl->WalWriterSleeping = false;
 
 	SpinLockInit(&XLogCtl->Insert.insertpos_lck);
+	pg_atomic_init_u64(&XLogCtl->Insert.CurrBytePos, 0);
 	SpinLockInit(&XLogCtl->info_lck);
+	pg_atomic_init_u32(&XLogCtl->flushGroupFirst, INVALID_PGPROCNO);
+	pg_atomic_init_u64(&XLogCtl->flushGroupWaitTime, 0);
+	pg_atomic_init_u64(&XLogCtl->segsCreatedBackground, 0);
 	SpinLockInit(&XLogCtl->ulsn_lck);
 	InitSharedLatch(&XLogCtl->recoveryWakeupLatch);
 
@@ -5596,10 +5936,16 @@ recoveryPausesHere(void)
 	if (!LocalHotStandbyActive)
 		return;
 
+	/* Let sessions see everything up to where we pause */
+	ParallelRedoWaitForWorkers();
+
 	ereport(LOG,
 			(errmsg("recovery has paused"),
 			 errhint("Execute pg_xlog_replay_resume() to continue.")));
 
+	/* Don't leave hot standby sessions waiting for our prefetches */
+	CompleteAsyncReads();
+
 	while (RecoveryIsPaused())
 	{
 		pg_usleep(1000000L);	/* 1000 ms */
@@ -5688,6 +6034,9 @@ recoveryApplyDelay(XLogReaderState *record)
 	if (secs <= 0 && microsecs <= 0)
 		return false;
 
+	/* Don't leave hot standby sessions waiting for our prefetches */
+	CompleteAsyncReads();
+
 	while (true)
 	{
 		ResetLatch(&XLogCtl->recoveryWakeupLatch);
@@ -5714,7 +6063,8 @@ recoveryApplyDelay(XLogReaderState *record)
 
 		WaitLatch(&XLogCtl->recoveryWakeupLatch,
 				  WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-				  secs * 1000L + microsecs / 1000);
+				  secs * 1000L + microsecs / 1000,
+				  WAIT_EVENT_RECOVERY_APPLY_DELAY);
 	}
 	return true;
 }
@@ -6395,6 +6745,14 @@ StartupXLOG(void)
 		InRecovery = true;
 	}
 
+	/*
+	 * If no recovery is needed, restore the statistics saved at the last
+	 * shutdown; otherwise they are discarded below.  In single-user mode
+	 * there's no checkpointer to save them again, so leave the file alone.
+	 */
+	if (!InRecovery && IsUnderPostmaster)
+		pgstat_read_statsfile();
+
 	/* REDO */
 	if (InRecovery)
 	{
@@ -6663,6 +7021,7 @@ StartupXLOG(void)
 		{
 			ErrorContextCallback errcallback;
 			TimestampTz xtime;
+			XLogPrefetcher *prefetcher;
 
 			InRedo = true;
 
@@ -6670,6 +7029,8 @@ StartupXLOG(void)
 					(errmsg("redo starts at %X/%X",
 						 (uint32) (ReadRecPtr >> 32), (uint32) ReadRecPtr)));
 
+			prefetcher = XLogPrefetcherAllocate();
+
 			/*
 			 * main redo apply loop
 			 */
@@ -6741,6 +7102,15 @@ StartupXLOG(void)
 						recoveryPausesHere();
 				}
 
+				/*
+				 * Start reading the blocks that the next few records will
+				 * need.  The files restored from the archive are not in
+				 * pg_xlog, so there's only WAL to read ahead in otherwise.
+				 */
+				if (readSource != XLOG_FROM_ARCHIVE)
+					XLogPrefetcherReadAhead(prefetcher, ReadRecPtr, curFileTLI,
+											readSource == XLOG_FROM_STREAM);
+
 				/* Setup error traceback support for ereport() */
 				errcallback.callback = rm_redo_error_callback;
 				errcallback.arg = (void *) xlogreader;
@@ -6823,15 +7193,21 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
-				/* Now apply the WAL record itself */
-				RmgrTable[record->xl_rmid].rm_redo(xlogreader);
+				/*
+				 * Now apply the WAL record itself, unless a parallel redo
+				 * worker takes care of it.
+				 */
+				if (!ParallelRedoDispatch(xlogreader))
+					RmgrTable[record->xl_rmid].rm_redo(xlogreader);
 
 				/* Pop the error context stack */
 				error_context_stack = errcallback.previous;
 
 				/*
 				 * Update lastReplayedEndRecPtr after this record has been
-				 * successfully replayed.
+				 * successfully replayed.  If it was handed to a parallel redo
+				 * worker, it might not have been replayed yet, but it will be
+				 * before any record that isn't.
 				 */
 				SpinLockAcquire(&XLogCtl->info_lck);
 				XLogCtl->lastReplayedEndRecPtr = EndRecPtr;
@@ -6877,6 +7253,9 @@ StartupXLOG(void)
 			 * end of main redo apply loop
 			 */
 
+			ParallelRedoShutdown();
+			XLogPrefetcherFree(prefetcher);
+
 			if (reachedStopPoint)
 			{
 				if (!reachedConsistency)
@@ -7092,7 +7471,7 @@ StartupXLOG(void)
 	 */
 	Insert = &XLogCtl->Insert;
 	Insert->PrevBytePos = XLogRecPtrToBytePos(LastRec);
-	Insert->CurrBytePos = XLogRecPtrToBytePos(EndOfLog);
+	pg_atomic_write_u64(&Insert->CurrBytePos, XLogRecPtrToBytePos(EndOfLog));
 
 	/*
 	 * Tricky point here: readBuf contains the *last* block that the LastRec
@@ -7847,6 +8226,67 @@ GetFlushRecPtr(void)
 	return recptr;
 }
 
+/*
+ * XLogReadFromBuffers -- copy WAL that is still resident in WAL buffers.
+ *
+ * Copies WAL starting at 'startptr' into 'buf', for as long as the pages are
+ * found in WAL buffers, up to 'count' bytes.  Returns the number of bytes
+ * copied; the caller reads the rest from the segment files.  Nothing is
+ * returned during recovery, or if 'tli' is not the timeline we're inserting
+ * on.  The caller must make sure the range has been written out already, as
+ * bytes that are still being inserted would be copied as they are.
+ *
+ * No lock is held while copying.  The page can be evicted from the buffer
+ * concurrently, but AdvanceXLInsertBuffer() invalidates xlblocks before it
+ * touches the page, so checking xlblocks again after the copy tells us
+ * whether what we copied is still the page we wanted.
+ */
+Size
+XLogReadFromBuffers(char *buf, XLogRecPtr startptr, Size count,
+					TimeLineID tli)
+{
+	char	   *p = buf;
+	XLogRecPtr	recptr = startptr;
+	Size		nbytes = count;
+
+	if (RecoveryInProgress() || tli != XLogCtl->ThisTimeLineID)
+		return 0;
+
+	while (nbytes > 0)
+	{
+		int			idx = XLogRecPtrToBufIdx(recptr);
+		XLogRecPtr	expectedEndPtr;
+		XLogRecPtr	endptr;
+		uint32		offset;
+		Size		nread;
+
+		expectedEndPtr = recptr + XLOG_BLCKSZ - recptr % XLOG_BLCKSZ;
+
+		endptr = *((volatile XLogRecPtr *) &XLogCtl->xlblocks[idx]);
+		if (endptr != expectedEndPtr)
+			break;
+
+		/* read the page only after we've seen it's the right one */
+		pg_read_barrier();
+
+		offset = recptr % XLOG_BLCKSZ;
+		nread = Min(XLOG_BLCKSZ - offset, nbytes);
+		memcpy(p, XLogCtl->pages + idx * (Size) XLOG_BLCKSZ + offset, nread);
+
+		/* and check that it's still there after the copy */
+		pg_read_barrier();
+		endptr = *((volatile XLogRecPtr *) &XLogCtl->xlblocks[idx]);
+		if (endptr != expectedEndPtr)
+			break;
+
+		p += nread;
+		recptr += nread;
+		nbytes -= nread;
+	}
+
+	return count - nbytes;
+}
+
 /*
  * Get the time of the last xlog segment switch
  */
@@ -7912,6 +8352,9 @@ ShutdownXLOG(int code, Datum arg)
 		CreateRestartPoint(CHECKPOINT_IS_SHUTDOWN | CHECKPOINT_IMMEDIATE);
 	else
 	{
+		/* Save the sequence state kept in shared memory; this writes WAL */
+		ShutdownSequences();
+
 		/*
 		 * If archiving is enabled, rotate the last XLOG file so that all the
 		 * remaining records are archived (postmaster wakes up the archiver
@@ -8196,7 +8639,7 @@ CreateCheckPoint(int flags)
 	 * determine the checkpoint REDO pointer.
 	 */
 	WALInsertLockAcquireExclusive();
-	curInsert = XLogBytePosToRecPtr(Insert->CurrBytePos);
+	curInsert = XLogBytePosToRecPtr(pg_atomic_read_u64(&Insert->CurrBytePos));
 	prevPtr = XLogBytePosToRecPtr(Insert->PrevBytePos);
 
 	/*
@@ -9355,6 +9798,9 @@ xlog_redo(XLogReaderState *record)
 	else if (info == XLOG_FPI || info == XLOG_FPI_FOR_HINT)
 	{
 		Buffer		buffer;
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
 
 		/*
 		 * Full-page image (FPI) records contain nothing else but a backup
@@ -9373,6 +9819,17 @@ xlog_redo(XLogReaderState *record)
 		 */
 		if (XLogReadBufferForRedo(record, 0, &buffer) != BLK_RESTORED)
 			elog(ERROR, "unexpected XLogReadBufferForRedo result when restoring backup block");
+
+		/*
+		 * An init fork page, such as one of an unlogged hash index, must be
+		 * on disk before ResetUnloggedRelations() copies the init fork over
+		 * the main fork at the end of recovery, which happens before the
+		 * end-of-recovery checkpoint would write it out.
+		 */
+		XLogRecGetBlockTag(record, 0, &rnode, &forknum, &blkno);
+		if (forknum == INIT_FORKNUM)
+			FlushOneBuffer(buffer);
+
 		UnlockReleaseBuffer(buffer);
 	}
 	else if (info == XLOG_BACKUP_END)
@@ -9471,6 +9928,19 @@ xlog_redo(XLogReaderState *record)
 	}
 }
 
+/*
+ * Full-page images only overwrite their page, so they can be replayed by a
+ * parallel redo worker.  Everything else in the XLOG rmgr updates state kept
+ * by the startup process.
+ */
+bool
+xlog_parallel_safe(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	return info == XLOG_FPI || info == XLOG_FPI_FOR_HINT;
+}
+
 #ifdef WAL_DEBUG
 
 static void
@@ -9632,6 +10102,7 @@ assign_xlog_sync_method(int new_sync_method, void *extra)
 void
 issue_xlog_fsync(int fd, XLogSegNo segno)
 {
+	pgstat_report_wait_start(WAIT_EVENT_WAL_SYNC);
 	switch (sync_method)
 	{
 		case SYNC_METHOD_FSYNC:
@@ -9667,6 +10138,7 @@ issue_xlog_fsync(int fd, XLogSegNo segno)
 			elog(PANIC, "unrecognized wal_sync_method: %d", sync_method);
 			break;
 	}
+	pgstat_report_wait_end();
 }
 
 /*
@@ -10583,13 +11055,25 @@ GetXLogInsertRecPtr(void)
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	uint64		current_bytepos;
 
-	SpinLockAcquire(&Insert->insertpos_lck);
-	current_bytepos = Insert->CurrBytePos;
-	SpinLockRelease(&Insert->insertpos_lck);
+	current_bytepos = pg_atomic_read_u64(&Insert->CurrBytePos);
 
 	return XLogBytePosToRecPtr(current_bytepos);
 }
 
+/*
+ * Report the statistics of WAL insertion lock 'lockno', see WALInsertLock.
+ *
+ * The counters are read without the lock, so they can be slightly stale.
+ */
+void
+GetWALInsertLockStats(int lockno, uint64 *acquired, uint64 *contended)
+{
+	Assert(lockno >= 0 && lockno < wal_insert_locks);
+
+	*acquired = WALInsertLocks[lockno].l.acquired;
+	*contended = WALInsertLocks[lockno].l.contended;
+}
+
 /*
  * Get latest WAL write pointer
  */
@@ -10791,7 +11275,7 @@ read_tablespace_map(List **tablespaces)
 /*
  * Error context callback for errors occurring during rm_redo().
  */
-static void
+void
 rm_redo_error_callback(void *arg)
 {
 	XLogReaderState *record = (XLogReaderState *) arg;
@@ -11006,10 +11490,12 @@ retry:
 		goto next_record_is_invalid;
 	}
 
+	pgstat_report_wait_start(WAIT_EVENT_WAL_READ);
 	if (read(readFile, readBuf, XLOG_BLCKSZ) != XLOG_BLCKSZ)
 	{
 		char		fname[MAXFNAMELEN];
 
+		pgstat_report_wait_end();
 		XLogFileName(fname, curFileTLI, readSegNo);
 		ereport(emode_for_corrupt_record(emode, targetPagePtr + reqLen),
 				(errcode_for_file_access(),
@@ -11017,6 +11503,7 @@ retry:
 						fname, readOff)));
 		goto next_record_is_invalid;
 	}
+	pgstat_report_wait_end();
 
 	Assert(targetSegNo == readSegNo);
 	Assert(targetPageOff == readOff);
@@ -11098,6 +11585,13 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 	else if (currentSource == 0)
 		currentSource = XLOG_FROM_ARCHIVE;
 
+	/*
+	 * We might have to wait for the WAL, so finish the reads that the
+	 * prefetcher started first; hot standby sessions might be waiting for
+	 * them.
+	 */
+	CompleteAsyncReads();
+
 	for (;;)
 	{
 		int			oldSource = currentSource;
@@ -11238,7 +11732,8 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 
 						WaitLatch(&XLogCtl->recoveryWakeupLatch,
 							 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-								  wait_time);
+								  wait_time,
+								  WAIT_EVENT_RECOVERY_WAL_ALL);
 						ResetLatch(&XLogCtl->recoveryWakeupLatch);
 						now = GetCurrentTimestamp();
 					}
@@ -11401,7 +11896,8 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 					 */
 					WaitLatch(&XLogCtl->recoveryWakeupLatch,
 							  WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-							  5000L);
+							  5000L,
+							  WAIT_EVENT_RECOVERY_WAL_STREAM);
 					ResetLatch(&XLogCtl->recoveryWakeupLatch);
 					break;
 				}
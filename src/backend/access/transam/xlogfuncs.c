@@ -517,3 +517,125 @@ pg_backup_start_time(PG_FUNCTION_ARGS)
 
 	PG_RETURN_DATUM(xtime);
 }
+
+/*
+ * Returns, for each WAL insertion lock, how many times it was acquired to
+ * insert a record, and how many of those acquisitions had to wait for
+ * another inserter.
+ *
+ * A high ratio of contended to all acquisitions suggests that raising
+ * wal_insert_locks would help.
+ */
+Datum
+pg_stat_get_wal_insert_locks(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_WAL_INSERT_LOCKS_COLS	3
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < wal_insert_locks; i++)
+	{
+		uint64		acquired;
+		uint64		contended;
+		Datum		values[PG_STAT_GET_WAL_INSERT_LOCKS_COLS];
+		bool		nulls[PG_STAT_GET_WAL_INSERT_LOCKS_COLS];
+
+		GetWALInsertLockStats(i, &acquired, &contended);
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(i);
+		values[1] = Int64GetDatum((int64) acquired);
+		values[2] = Int64GetDatum((int64) contended);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Report the statistics of group WAL flushes, see XLogFlushGroup().
+ *
+ * The wait time is returned in milliseconds.
+ */
+Datum
+pg_stat_get_wal_flush_groups(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+	uint64		flushes;
+	uint64		requests;
+	uint64		wait_time;
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	GetXLogFlushGroupStats(&flushes, &requests, &wait_time);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum((int64) flushes);
+	values[1] = Int64GetDatum((int64) requests);
+	values[2] = Float8GetDatum((double) wait_time / 1000.0);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Report the number of WAL segments created while writing WAL, and ahead of
+ * time, since server start.
+ */
+Datum
+pg_stat_get_wal_segment_creations(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[2];
+	bool		nulls[2];
+	uint64		foreground;
+	uint64		background;
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	GetXLogSegmentCreationStats(&foreground, &background);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum((int64) foreground);
+	values[1] = Int64GetDatum((int64) background);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
@@ -0,0 +1,599 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.c
+ *		Parallel WAL redo on standbys.
+ *
+ * The startup process normally replays every record itself, which limits
+ * how fast a busy standby can keep up.  With recovery_parallel_workers set,
+ * it starts that many background workers, and hands each record that
+ * modifies a single block, and that its resource manager says is safe to
+ * replay out of order with respect to records for other blocks, to one of
+ * them.  The worker is chosen by hashing the block, so all the records for
+ * one block are replayed in order, by the same worker.
+ *
+ * Every other record is a barrier: the startup process waits for the
+ * workers to replay everything they've been sent, and then replays the
+ * record itself.  Commit records are barriers, so by the time a
+ * transaction becomes visible to hot standby queries, all of its changes
+ * have been applied, and so are checkpoint records, so that restartpoints
+ * cover everything before them.
+ *
+ * The workers are only started once a consistent state has been reached.
+ * Until then, the startup process keeps track of references to pages that
+ * don't exist yet, which workers couldn't do, so crash recovery and the
+ * start of archive recovery are always serial.
+ *
+ * Each worker gets a shm_mq in the main shared memory segment, on which the
+ * startup process sends it the raw records.  A worker counts the records
+ * it has replayed in shared memory, for the startup process to wait for at
+ * barriers.  The workers ignore SIGTERM: they exit when the startup process
+ * detaches from their queue, when recovery ends or the startup process
+ * itself exits.  An error in a worker makes the startup process exit too,
+ * just as if it had happened while replaying the record itself.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogparallel.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "access/hash.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
+#include "access/xlogreader.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/bufmgr.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/memutils.h"
+
+
+/* Size of the queue of each worker */
+#define PARALLEL_REDO_QUEUE_SIZE	(256 * 1024)
+
+/* GUCs */
+int			recovery_parallel_workers = 0;
+
+bool		am_parallel_redo_worker = false;
+
+/*
+ * Shared state.  smgrGeneration is advanced by the startup process before
+ * it replays a record that drops or truncates relations, so that the
+ * workers know to close the files they have open.
+ */
+typedef struct ParallelRedoCtlData
+{
+	PGPROC	   *startup;		/* startup process, to wake it up */
+	pg_atomic_uint32 startupWaiting;	/* startup process waits for us */
+	pg_atomic_uint32 smgrGeneration;
+	pg_atomic_uint64 applied[FLEXIBLE_ARRAY_MEMBER];	/* per worker */
+} ParallelRedoCtlData;
+
+static ParallelRedoCtlData *ParallelRedoCtl = NULL;
+static char *ParallelRedoQueues = NULL;
+
+#define ParallelRedoQueue(i) \
+	((shm_mq *) (ParallelRedoQueues + (Size) (i) * PARALLEL_REDO_QUEUE_SIZE))
+
+/* What precedes each record on a queue */
+typedef struct ParallelRedoRecordHeader
+{
+	XLogRecPtr	ReadRecPtr;
+	XLogRecPtr	EndRecPtr;
+} ParallelRedoRecordHeader;
+
+/* State of the startup process */
+static bool parallelRedoStarted = false;
+static int	nworkers = 0;
+static BackgroundWorkerHandle **workerHandles;
+static shm_mq_handle **workerQueues;
+static uint64 *workerSent;
+static uint64 nbarriers = 0;
+
+static void ParallelRedoStart(void);
+static void ParallelRedoDetach(int code, Datum arg);
+static void ParallelRedoSend(int worker, XLogReaderState *record);
+static bool ParallelRedoDropsRelations(XLogReaderState *record);
+static void ParallelRedoWorkerDetach(int code, Datum arg);
+
+
+Size
+ParallelRedoShmemSize(void)
+{
+	Size		size;
+
+	if (recovery_parallel_workers == 0)
+		return 0;
+
+	size = offsetof(ParallelRedoCtlData, applied);
+	size = add_size(size, mul_size(recovery_parallel_workers,
+								   sizeof(pg_atomic_uint64)));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(recovery_parallel_workers,
+								   PARALLEL_REDO_QUEUE_SIZE));
+	return size;
+}
+
+void
+ParallelRedoShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	if (recovery_parallel_workers == 0)
+		return;
+
+	ParallelRedoCtl = (ParallelRedoCtlData *)
+		ShmemInitStruct("Parallel Redo", ParallelRedoShmemSize(), &found);
+	ParallelRedoQueues = (char *) ParallelRedoCtl +
+		MAXALIGN(offsetof(ParallelRedoCtlData, applied) +
+				 recovery_parallel_workers * sizeof(pg_atomic_uint64));
+	if (!found)
+	{
+		ParallelRedoCtl->startup = NULL;
+		pg_atomic_init_u32(&ParallelRedoCtl->startupWaiting, 0);
+		pg_atomic_init_u32(&ParallelRedoCtl->smgrGeneration, 0);
+		for (i = 0; i < recovery_parallel_workers; i++)
+			pg_atomic_init_u64(&ParallelRedoCtl->applied[i], 0);
+	}
+}
+
+/*
+ * Called by the startup process for each record to replay.  Returns true if
+ * the record was handed to a worker, false if the caller should replay it,
+ * after we've made sure that the workers are done with all the records
+ * before it.
+ */
+bool
+ParallelRedoDispatch(XLogReaderState *record)
+{
+	RmgrId		rmid = XLogRecGetRmid(record);
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber blkno;
+	uint32		key[5];
+
+	if (recovery_parallel_workers == 0)
+		return false;
+
+	if (!parallelRedoStarted)
+	{
+		if (!reachedConsistency)
+			return false;
+		ParallelRedoStart();
+	}
+	if (nworkers == 0)
+		return false;
+
+	if (record->max_block_id == 0 &&
+		RmgrTable[rmid].rm_parallel_safe != NULL &&
+		RmgrTable[rmid].rm_parallel_safe(record))
+	{
+		XLogRecGetBlockTag(record, 0, &rnode, &forknum, &blkno);
+
+		key[0] = rnode.spcNode;
+		key[1] = rnode.dbNode;
+		key[2] = rnode.relNode;
+		key[3] = (uint32) forknum;
+		key[4] = blkno;
+
+		ParallelRedoSend(DatumGetUInt32(hash_any((unsigned char *) key,
+												 sizeof(key))) % nworkers,
+						 record);
+		return true;
+	}
+
+	/* A barrier */
+	ParallelRedoWaitForWorkers();
+	nbarriers++;
+
+	if (ParallelRedoDropsRelations(record))
+		pg_atomic_fetch_add_u32(&ParallelRedoCtl->smgrGeneration, 1);
+
+	return false;
+}
+
+/*
+ * Wait until the workers have replayed all the records they've been sent.
+ *
+ * This is called at barriers, before pausing recovery, and at the end of
+ * redo.
+ */
+void
+ParallelRedoWaitForWorkers(void)
+{
+	int			i;
+
+	if (nworkers == 0)
+		return;
+
+	/* the workers might be waiting for one of our reads */
+	CompleteAsyncReads();
+
+	for (;;)
+	{
+		bool		done = true;
+		int			rc;
+
+		pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 1);
+		pg_memory_barrier();
+
+		for (i = 0; i < nworkers; i++)
+		{
+			if (pg_atomic_read_u64(&ParallelRedoCtl->applied[i]) <
+				workerSent[i])
+			{
+				pid_t		pid;
+
+				if (GetBackgroundWorkerPid(workerHandles[i], &pid) !=
+					BGWH_STARTED)
+					ereport(FATAL,
+							(errmsg("parallel redo worker %d exited unexpectedly",
+									i)));
+				done = false;
+				break;
+			}
+		}
+		if (done)
+			break;
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   100L,
+					   WAIT_EVENT_PARALLEL_REDO_WAIT);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+		HandleStartupProcInterrupts();
+	}
+
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 0);
+}
+
+/*
+ * Called by the startup process at the end of redo.  The workers exit once
+ * they notice that we've detached from their queues.
+ */
+void
+ParallelRedoShutdown(void)
+{
+	uint64		nparallel = 0;
+	int			i;
+
+	if (nworkers == 0)
+		return;
+
+	ParallelRedoWaitForWorkers();
+
+	for (i = 0; i < nworkers; i++)
+		nparallel += workerSent[i];
+
+	ParallelRedoDetach(0, (Datum) 0);
+
+	ereport(DEBUG1,
+			(errmsg("parallel redo replayed " UINT64_FORMAT " records in workers, with " UINT64_FORMAT " barriers",
+					nparallel, nbarriers)));
+}
+
+/*
+ * Start the workers, and set up our end of their queues.
+ *
+ * We only try once.  Workers that can't be started, because all the
+ * background worker slots are in use for example, are just not used.
+ */
+static void
+ParallelRedoStart(void)
+{
+	BackgroundWorker worker;
+	int			i;
+
+	parallelRedoStarted = true;
+
+	workerHandles = (BackgroundWorkerHandle **)
+		MemoryContextAllocZero(TopMemoryContext,
+					recovery_parallel_workers * sizeof(BackgroundWorkerHandle *));
+	workerQueues = (shm_mq_handle **)
+		MemoryContextAllocZero(TopMemoryContext,
+						   recovery_parallel_workers * sizeof(shm_mq_handle *));
+	workerSent = (uint64 *)
+		MemoryContextAllocZero(TopMemoryContext,
+							   recovery_parallel_workers * sizeof(uint64));
+
+	ParallelRedoCtl->startup = MyProc;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main = ParallelRedoWorkerMain;
+	worker.bgw_notify_pid = MyProcPid;
+
+	on_shmem_exit(ParallelRedoDetach, (Datum) 0);
+
+	for (i = 0; i < recovery_parallel_workers; i++)
+	{
+		BackgroundWorkerHandle *handle;
+		shm_mq	   *mq;
+		pid_t		pid;
+
+		mq = shm_mq_create(ParallelRedoQueue(nworkers),
+						   PARALLEL_REDO_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+
+		snprintf(worker.bgw_name, BGW_MAXLEN, "parallel redo worker %d",
+				 nworkers);
+		worker.bgw_main_arg = Int32GetDatum(nworkers);
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+		{
+			ereport(LOG,
+					(errmsg("could not start parallel redo worker"),
+					 errhint("You might need to increase max_worker_processes.")));
+			break;
+		}
+		if (WaitForBackgroundWorkerStartup(handle, &pid) != BGWH_STARTED)
+		{
+			ereport(LOG,
+					(errmsg("could not start parallel redo worker")));
+			pfree(handle);
+			continue;
+		}
+
+		workerHandles[nworkers] = handle;
+		workerQueues[nworkers] = shm_mq_attach(mq, NULL, handle);
+		nworkers++;
+	}
+
+	if (nworkers > 0)
+		ereport(LOG,
+				(errmsg("started %d parallel redo workers", nworkers)));
+}
+
+/*
+ * Detach from the queues of the workers, at the end of redo or when the
+ * startup process exits.
+ */
+static void
+ParallelRedoDetach(int code, Datum arg)
+{
+	int			i;
+
+	for (i = 0; i < nworkers; i++)
+		shm_mq_detach(ParallelRedoQueue(i));
+	nworkers = 0;
+}
+
+/*
+ * Send a record to a worker, waiting for room on its queue if needed.
+ */
+static void
+ParallelRedoSend(int worker, XLogReaderState *record)
+{
+	ParallelRedoRecordHeader hdr;
+	shm_mq_iovec iov[2];
+
+	hdr.ReadRecPtr = record->ReadRecPtr;
+	hdr.EndRecPtr = record->EndRecPtr;
+	iov[0].data = (const char *) &hdr;
+	iov[0].len = sizeof(hdr);
+	iov[1].data = (const char *) record->decoded_record;
+	iov[1].len = XLogRecGetTotalLen(record);
+
+	for (;;)
+	{
+		shm_mq_result res;
+		int			rc;
+
+		res = shm_mq_sendv(workerQueues[worker], iov, 2, true);
+		if (res == SHM_MQ_SUCCESS)
+			break;
+		if (res == SHM_MQ_DETACHED)
+			ereport(FATAL,
+					(errmsg("parallel redo worker %d exited unexpectedly",
+							worker)));
+
+		/*
+		 * The queue is full.  The worker might be waiting for one of our
+		 * reads.
+		 */
+		CompleteAsyncReads();
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, 0,
+					   WAIT_EVENT_PARALLEL_REDO_SEND);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+		HandleStartupProcInterrupts();
+	}
+
+	workerSent[worker]++;
+}
+
+/*
+ * Does replaying this record remove relation files, or parts of them, that
+ * the workers might have open?
+ */
+static bool
+ParallelRedoDropsRelations(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record);
+
+	if (info & XLR_SPECIAL_REL_UPDATE)
+		return true;
+
+	if (XLogRecGetRmid(record) == RM_XACT_ID)
+	{
+		switch (info & XLOG_XACT_OPMASK)
+		{
+			case XLOG_XACT_COMMIT:
+			case XLOG_XACT_COMMIT_PREPARED:
+				{
+					xl_xact_parsed_commit parsed;
+
+					ParseCommitRecord(info,
+									  (xl_xact_commit *) XLogRecGetData(record),
+									  &parsed);
+					return parsed.nrels > 0;
+				}
+			case XLOG_XACT_ABORT:
+			case XLOG_XACT_ABORT_PREPARED:
+				{
+					xl_xact_parsed_abort parsed;
+
+					ParseAbortRecord(info,
+									 (xl_xact_abort *) XLogRecGetData(record),
+									 &parsed);
+					return parsed.nrels > 0;
+				}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Main entry point of a parallel redo worker.
+ */
+void
+ParallelRedoWorkerMain(Datum main_arg)
+{
+	int			worker = DatumGetInt32(main_arg);
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	XLogReaderState *reader;
+	MemoryContext redo_context;
+	char	   *recbuf = NULL;
+	Size		recbufsz = 0;
+	uint32		generation;
+
+	/* We exit when the startup process detaches, see above */
+	pqsignal(SIGTERM, SIG_IGN);
+	BackgroundWorkerUnblockSignals();
+
+	/* Release buffer locks if we fail */
+	InitBufferPoolBackend();
+
+	InRecovery = true;
+	reachedConsistency = true;
+	am_parallel_redo_worker = true;
+
+	MemoryContextSwitchTo(TopMemoryContext);
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "parallel redo",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE);
+
+	/* We only use the reader to decode records, not to read them */
+	reader = XLogReaderAllocate(NULL, NULL);
+	if (reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+
+	mq = ParallelRedoQueue(worker);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, NULL, NULL);
+	on_shmem_exit(ParallelRedoWorkerDetach, PointerGetDatum(mq));
+
+	generation = pg_atomic_read_u32(&ParallelRedoCtl->smgrGeneration);
+
+	for (;;)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+		ParallelRedoRecordHeader hdr;
+		XLogRecord *record;
+		char	   *errormsg;
+		ErrorContextCallback errcallback;
+		MemoryContext oldcontext;
+		uint32		newgeneration;
+
+		res = shm_mq_receive(mqh, &nbytes, &data, true);
+		if (res == SHM_MQ_DETACHED)
+			break;
+		if (res == SHM_MQ_WOULD_BLOCK)
+		{
+			int			rc;
+
+			rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, 0,
+						   WAIT_EVENT_PARALLEL_REDO_MAIN);
+			if (rc & WL_POSTMASTER_DEATH)
+				proc_exit(1);
+			ResetLatch(MyLatch);
+			continue;
+		}
+
+		/*
+		 * Copy the record, so that it's suitably aligned, and stays put while
+		 * it's replayed.
+		 */
+		Assert(nbytes > sizeof(hdr));
+		memcpy(&hdr, data, sizeof(hdr));
+		nbytes -= sizeof(hdr);
+		if (nbytes > recbufsz)
+		{
+			if (recbuf)
+				pfree(recbuf);
+			recbufsz = Max(nbytes, BLCKSZ);
+			recbuf = (char *) palloc(recbufsz);
+		}
+		memcpy(recbuf, (char *) data + sizeof(hdr), nbytes);
+		record = (XLogRecord *) recbuf;
+
+		reader->ReadRecPtr = hdr.ReadRecPtr;
+		reader->EndRecPtr = hdr.EndRecPtr;
+		if (!DecodeXLogRecord(reader, record, &errormsg))
+			elog(ERROR, "could not decode WAL record at %X/%X: %s",
+				 (uint32) (hdr.ReadRecPtr >> 32), (uint32) hdr.ReadRecPtr,
+				 errormsg);
+
+		/* Forget files that may have been dropped since the last record */
+		newgeneration = pg_atomic_read_u32(&ParallelRedoCtl->smgrGeneration);
+		if (newgeneration != generation)
+		{
+			smgrcloseall();
+			generation = newgeneration;
+		}
+
+		errcallback.callback = rm_redo_error_callback;
+		errcallback.arg = (void *) reader;
+		errcallback.previous = error_context_stack;
+		error_context_stack = &errcallback;
+
+		oldcontext = MemoryContextSwitchTo(redo_context);
+		RmgrTable[record->xl_rmid].rm_redo(reader);
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(redo_context);
+
+		error_context_stack = errcallback.previous;
+
+		/* Let the startup process know, if it's waiting for us */
+		pg_atomic_fetch_add_u64(&ParallelRedoCtl->applied[worker], 1);
+		if (pg_atomic_read_u32(&ParallelRedoCtl->startupWaiting))
+			SetLatch(&ParallelRedoCtl->startup->procLatch);
+	}
+
+	proc_exit(0);
+}
+
+static void
+ParallelRedoWorkerDetach(int code, Datum arg)
+{
+	shm_mq_detach((shm_mq *) DatumGetPointer(arg));
+}
@@ -0,0 +1,564 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching support for recovery.
+ *
+ * During recovery, the startup process replays one record at a time, and a
+ * record that modifies a block that isn't in shared buffers has to wait for
+ * it to be read in.  The prefetcher reads the WAL a little ahead of replay,
+ * with an xlogreader of its own, and initiates reads of the blocks that the
+ * upcoming records will need, so that the I/O is done by the time they're
+ * replayed.  How far ahead it reads is set by recovery_prefetch_distance.
+ *
+ * The prefetcher only reads WAL that is already in pg_xlog, up to what the
+ * WAL receiver has written when streaming.  If it can't read further, it
+ * waits for replay to catch up with it, and then starts over from the
+ * record being replayed.
+ *
+ * Some block references are not worth prefetching, or would be unsafe to
+ * prefetch: blocks that the record restores from a full-page image or
+ * initializes from scratch (the version on disk might be torn, and it isn't
+ * needed anyway), and blocks of relations that don't exist yet or beyond
+ * their current end.  For each of those, a filter suppresses prefetching of
+ * the same block (or, for new relations and blocks, the rest of the
+ * relation) until the record has been replayed.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogprefetch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "access/htup_details.h"
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogreader.h"
+#include "catalog/pg_class.h"
+#include "funcapi.h"
+#include "lib/ilist.h"
+#include "port/atomics.h"
+#include "replication/walreceiver.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+
+
+/*
+ * Number of recently prefetched blocks remembered, to skip repeated
+ * references to the same block in consecutive records cheaply.
+ */
+#define XLOGPREFETCHER_RECENT_SIZE		4
+
+/* GUCs */
+int			recovery_prefetch_distance = 256;	/* kB */
+
+/*
+ * Statistics, in shared memory so that they can be looked at from other
+ * backends.  They're only ever written by the startup process.
+ */
+typedef struct XLogPrefetchStats
+{
+	pg_atomic_uint64 prefetch;	/* blocks not in buffers, read initiated */
+	pg_atomic_uint64 hit;		/* blocks already in buffers */
+	pg_atomic_uint64 skip_new;	/* relation or block doesn't exist yet */
+	pg_atomic_uint64 skip_fpw;	/* block restored from FPI or initialized */
+	pg_atomic_uint64 skip_rep;	/* block referenced again */
+	pg_atomic_uint32 distance;	/* bytes of WAL decoded ahead of replay */
+} XLogPrefetchStats;
+
+static XLogPrefetchStats *SharedStats;
+
+/*
+ * A filter suppresses prefetching until the record at filter_until_replayed
+ * has been replayed.  Its key names a block, or with blkno set to
+ * InvalidBlockNumber, the blocks from filter_from_block onwards of a
+ * relation.
+ */
+typedef struct XLogPrefetcherFilterKey
+{
+	RelFileNode rnode;
+	BlockNumber blkno;
+} XLogPrefetcherFilterKey;
+
+typedef struct XLogPrefetcherFilter
+{
+	XLogPrefetcherFilterKey key;	/* hash key; must be first */
+	XLogRecPtr	filter_until_replayed;
+	BlockNumber filter_from_block;
+	dlist_node	link;			/* in filter_queue */
+} XLogPrefetcherFilter;
+
+struct XLogPrefetcher
+{
+	/* our own reader, ahead of the startup process's */
+	XLogReaderState *reader;
+	bool		reader_failed;	/* couldn't read the next record */
+
+	/* where the page read callback can get the WAL from */
+	TimeLineID	tli;
+	XLogRecPtr	read_upto;		/* or InvalidXLogRecPtr for no limit */
+	int			readFile;
+	XLogSegNo	readSegNo;
+	TimeLineID	readFileTLI;
+
+	/* filters, and a queue of them in filter_until_replayed order */
+	HTAB	   *filter_table;
+	dlist_head	filter_queue;
+
+	/* recently prefetched blocks */
+	RelFileNode recent_rnode[XLOGPREFETCHER_RECENT_SIZE];
+	BlockNumber recent_block[XLOGPREFETCHER_RECENT_SIZE];
+	int			recent_idx;
+};
+
+static int XLogPrefetcherReadPage(XLogReaderState *reader,
+					   XLogRecPtr targetPagePtr, int reqLen,
+					   XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI);
+static void XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher);
+static void XLogPrefetcherAddFilter(XLogPrefetcher *prefetcher,
+						RelFileNode rnode, BlockNumber blkno,
+						bool whole_relation, XLogRecPtr lsn);
+static void XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
+							  XLogRecPtr replaying_lsn);
+static bool XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher,
+						 RelFileNode rnode, BlockNumber blkno,
+						 pg_atomic_uint64 **counter);
+
+static inline void
+XLogPrefetchIncrement(pg_atomic_uint64 *counter)
+{
+	/* only the startup process updates the counters */
+	pg_atomic_write_u64(counter, pg_atomic_read_u64(counter) + 1);
+}
+
+Size
+XLogPrefetchShmemSize(void)
+{
+	return sizeof(XLogPrefetchStats);
+}
+
+void
+XLogPrefetchShmemInit(void)
+{
+	bool		found;
+
+	SharedStats = (XLogPrefetchStats *)
+		ShmemInitStruct("XLogPrefetchStats",
+						sizeof(XLogPrefetchStats),
+						&found);
+	if (!found)
+	{
+		pg_atomic_init_u64(&SharedStats->prefetch, 0);
+		pg_atomic_init_u64(&SharedStats->hit, 0);
+		pg_atomic_init_u64(&SharedStats->skip_new, 0);
+		pg_atomic_init_u64(&SharedStats->skip_fpw, 0);
+		pg_atomic_init_u64(&SharedStats->skip_rep, 0);
+		pg_atomic_init_u32(&SharedStats->distance, 0);
+	}
+}
+
+/*
+ * Create a prefetcher, at the start of redo.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(void)
+{
+	XLogPrefetcher *prefetcher;
+	HASHCTL		hash_ctl;
+
+	prefetcher = (XLogPrefetcher *) palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(&XLogPrefetcherReadPage,
+											prefetcher);
+	if (!prefetcher->reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+			errdetail("Failed while allocating an XLog reading processor.")));
+	prefetcher->reader_failed = false;
+	prefetcher->readFile = -1;
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(XLogPrefetcherFilterKey);
+	hash_ctl.entrysize = sizeof(XLogPrefetcherFilter);
+	prefetcher->filter_table = hash_create("XLogPrefetcherFilterTable", 1024,
+										   &hash_ctl,
+										   HASH_ELEM | HASH_BLOBS);
+	dlist_init(&prefetcher->filter_queue);
+
+	/* the statistics are for the current recovery */
+	pg_atomic_write_u64(&SharedStats->prefetch, 0);
+	pg_atomic_write_u64(&SharedStats->hit, 0);
+	pg_atomic_write_u64(&SharedStats->skip_new, 0);
+	pg_atomic_write_u64(&SharedStats->skip_fpw, 0);
+	pg_atomic_write_u64(&SharedStats->skip_rep, 0);
+	pg_atomic_write_u32(&SharedStats->distance, 0);
+
+	return prefetcher;
+}
+
+/*
+ * Destroy a prefetcher, at the end of redo.
+ *
+ * The reads it started are completed, so that none are left in progress
+ * after recovery.
+ */
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	CompleteAsyncReads();
+
+	if (prefetcher->readFile >= 0)
+		close(prefetcher->readFile);
+	XLogReaderFree(prefetcher->reader);
+	hash_destroy(prefetcher->filter_table);
+	pfree(prefetcher);
+
+	pg_atomic_write_u32(&SharedStats->distance, 0);
+}
+
+/*
+ * Read ahead of the record at replaying_lsn, which is about to be replayed,
+ * and initiate reads of the blocks that the records up to
+ * recovery_prefetch_distance bytes further will need.
+ *
+ * tli is the timeline of the WAL segment being replayed.  If streaming, the
+ * WAL is read no further than the WAL receiver has written it.
+ */
+void
+XLogPrefetcherReadAhead(XLogPrefetcher *prefetcher, XLogRecPtr replaying_lsn,
+						TimeLineID tli, bool streaming)
+{
+	XLogReaderState *reader = prefetcher->reader;
+	uint64		distance = (uint64) recovery_prefetch_distance * 1024;
+
+	/* Lift the filters of the records that have been replayed. */
+	XLogPrefetcherCompleteFilters(prefetcher, replaying_lsn);
+
+	if (distance == 0)
+		return;
+
+	/*
+	 * If replay has caught up with us, start over from the record being
+	 * replayed.  That's also where we start the first time, and where we
+	 * retry after failing to read further.
+	 */
+	if (reader->EndRecPtr <= replaying_lsn)
+		prefetcher->reader_failed = false;
+	else if (prefetcher->reader_failed)
+		return;
+
+	prefetcher->tli = tli;
+	if (streaming)
+		prefetcher->read_upto = GetWalRcvWriteRecPtr(NULL,
+													 &prefetcher->tli);
+	else
+		prefetcher->read_upto = InvalidXLogRecPtr;
+
+	while (reader->EndRecPtr <= replaying_lsn ||
+		   reader->EndRecPtr - replaying_lsn < distance)
+	{
+		XLogRecord *record;
+		char	   *errormsg;
+
+		if (reader->EndRecPtr <= replaying_lsn)
+			record = XLogReadRecord(reader, replaying_lsn, &errormsg);
+		else
+			record = XLogReadRecord(reader, InvalidXLogRecPtr, &errormsg);
+
+		if (record == NULL)
+		{
+			/*
+			 * We've reached the end of the WAL available to us, or of all
+			 * the WAL, or something is wrong with it.  Replay will find out
+			 * which; we just wait for it to catch up.
+			 */
+			prefetcher->reader_failed = true;
+			break;
+		}
+
+		XLogPrefetcherScanBlocks(prefetcher);
+	}
+
+	if (reader->EndRecPtr > replaying_lsn)
+		pg_atomic_write_u32(&SharedStats->distance,
+							(uint32) Min(reader->EndRecPtr - replaying_lsn,
+										 PG_UINT32_MAX));
+	else
+		pg_atomic_write_u32(&SharedStats->distance, 0);
+}
+
+/*
+ * Initiate reads of the blocks referenced by the record just decoded.
+ */
+static void
+XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher)
+{
+	XLogReaderState *reader = prefetcher->reader;
+	int			block_id;
+
+	for (block_id = 0; block_id <= reader->max_block_id; block_id++)
+	{
+		DecodedBkpBlock *block = &reader->blocks[block_id];
+		pg_atomic_uint64 *counter;
+		SMgrRelation reln;
+		int			i;
+
+		if (!block->in_use)
+			continue;
+
+		/* The other forks are small, and likely to be cached anyway. */
+		if (block->forknum != MAIN_FORKNUM)
+			continue;
+
+		/*
+		 * If the block will be restored from a full-page image or
+		 * initialized, we don't need to read it, and mustn't read it until
+		 * that has happened, for what's on disk could be torn.
+		 */
+		if (block->has_image || (block->flags & BKPBLOCK_WILL_INIT))
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_fpw);
+			XLogPrefetcherAddFilter(prefetcher, block->rnode, block->blkno,
+									false, reader->ReadRecPtr);
+			continue;
+		}
+
+		if (XLogPrefetcherIsFiltered(prefetcher, block->rnode, block->blkno,
+									 &counter))
+		{
+			XLogPrefetchIncrement(counter);
+			continue;
+		}
+
+		/* Skip repeated references to a block we've just prefetched. */
+		for (i = 0; i < XLOGPREFETCHER_RECENT_SIZE; i++)
+		{
+			if (block->blkno == prefetcher->recent_block[i] &&
+				RelFileNodeEquals(block->rnode, prefetcher->recent_rnode[i]))
+				break;
+		}
+		if (i < XLOGPREFETCHER_RECENT_SIZE)
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_rep);
+			continue;
+		}
+
+		/*
+		 * If the relation doesn't exist on disk (yet), for example because
+		 * the WAL that creates it hasn't been replayed, don't prefetch from
+		 * it until this record has been replayed.
+		 */
+		reln = smgropen(block->rnode, InvalidBackendId);
+		if (!smgrexists(reln, MAIN_FORKNUM))
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_new);
+			XLogPrefetcherAddFilter(prefetcher, block->rnode, 0,
+									true, reader->ReadRecPtr);
+			continue;
+		}
+
+		/* Likewise for a block beyond the end of the relation. */
+		if (block->blkno >= smgrnblocks(reln, MAIN_FORKNUM))
+		{
+			XLogPrefetchIncrement(&SharedStats->skip_new);
+			XLogPrefetcherAddFilter(prefetcher, block->rnode, block->blkno,
+									true, reader->ReadRecPtr);
+			continue;
+		}
+
+		if (PrefetchSharedBuffer(reln, RELPERSISTENCE_PERMANENT,
+								 MAIN_FORKNUM, block->blkno))
+			XLogPrefetchIncrement(&SharedStats->hit);
+		else
+			XLogPrefetchIncrement(&SharedStats->prefetch);
+
+		prefetcher->recent_rnode[prefetcher->recent_idx] = block->rnode;
+		prefetcher->recent_block[prefetcher->recent_idx] = block->blkno;
+		prefetcher->recent_idx =
+			(prefetcher->recent_idx + 1) % XLOGPREFETCHER_RECENT_SIZE;
+	}
+}
+
+/*
+ * Don't prefetch the given block, or if whole_relation is true, the blocks
+ * of the relation from the given one onwards, until the record at lsn has
+ * been replayed.
+ */
+static void
+XLogPrefetcherAddFilter(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						BlockNumber blkno, bool whole_relation,
+						XLogRecPtr lsn)
+{
+	XLogPrefetcherFilterKey key;
+	XLogPrefetcherFilter *filter;
+	bool		found;
+
+	key.rnode = rnode;
+	key.blkno = whole_relation ? InvalidBlockNumber : blkno;
+
+	filter = (XLogPrefetcherFilter *)
+		hash_search(prefetcher->filter_table, &key, HASH_ENTER, &found);
+	if (!found)
+		filter->filter_from_block = blkno;
+	else
+	{
+		/* move it to the end of the queue, as lsn can't be earlier */
+		dlist_delete(&filter->link);
+		filter->filter_from_block = Min(filter->filter_from_block, blkno);
+	}
+	filter->filter_until_replayed = lsn;
+	dlist_push_tail(&prefetcher->filter_queue, &filter->link);
+}
+
+/*
+ * Remove the filters of the records before replaying_lsn, which have been
+ * replayed.
+ */
+static void
+XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
+							  XLogRecPtr replaying_lsn)
+{
+	while (!dlist_is_empty(&prefetcher->filter_queue))
+	{
+		XLogPrefetcherFilter *filter;
+
+		filter = dlist_head_element(XLogPrefetcherFilter, link,
+									&prefetcher->filter_queue);
+		if (filter->filter_until_replayed >= replaying_lsn)
+			break;
+
+		dlist_delete(&filter->link);
+		hash_search(prefetcher->filter_table, &filter->key, HASH_REMOVE,
+					NULL);
+	}
+}
+
+/*
+ * Is the given block filtered?  If so, *counter is set to the statistics
+ * counter for the reason.
+ */
+static bool
+XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher, RelFileNode rnode,
+						 BlockNumber blkno, pg_atomic_uint64 **counter)
+{
+	XLogPrefetcherFilterKey key;
+	XLogPrefetcherFilter *filter;
+
+	if (dlist_is_empty(&prefetcher->filter_queue))
+		return false;
+
+	key.rnode = rnode;
+	key.blkno = blkno;
+	if (hash_search(prefetcher->filter_table, &key, HASH_FIND, NULL) != NULL)
+	{
+		*counter = &SharedStats->skip_fpw;
+		return true;
+	}
+
+	key.blkno = InvalidBlockNumber;
+	filter = (XLogPrefetcherFilter *)
+		hash_search(prefetcher->filter_table, &key, HASH_FIND, NULL);
+	if (filter != NULL && blkno >= filter->filter_from_block)
+	{
+		*counter = &SharedStats->skip_new;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * The prefetcher's page read callback.  It only reads WAL that is in pg_xlog
+ * already, and returns -1 rather than waiting for it or complaining.
+ */
+static int
+XLogPrefetcherReadPage(XLogReaderState *reader, XLogRecPtr targetPagePtr,
+					   int reqLen, XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) reader->private_data;
+	uint32		targetPageOff;
+	XLogSegNo	targetSegNo;
+	int			readLen;
+
+	if (prefetcher->read_upto != InvalidXLogRecPtr)
+	{
+		if (targetPagePtr + reqLen > prefetcher->read_upto)
+			return -1;
+		readLen = (int) Min(XLOG_BLCKSZ,
+							prefetcher->read_upto - targetPagePtr);
+	}
+	else
+		readLen = XLOG_BLCKSZ;
+
+	XLByteToSeg(targetPagePtr, targetSegNo);
+	targetPageOff = targetPagePtr % XLogSegSize;
+
+	/* Open the right segment, if it isn't already */
+	if (prefetcher->readFile >= 0 &&
+		(prefetcher->readSegNo != targetSegNo ||
+		 prefetcher->readFileTLI != prefetcher->tli))
+	{
+		close(prefetcher->readFile);
+		prefetcher->readFile = -1;
+	}
+	if (prefetcher->readFile < 0)
+	{
+		char		path[MAXPGPATH];
+
+		XLogFilePath(path, prefetcher->tli, targetSegNo);
+		prefetcher->readFile = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+		if (prefetcher->readFile < 0)
+			return -1;
+		prefetcher->readSegNo = targetSegNo;
+		prefetcher->readFileTLI = prefetcher->tli;
+	}
+
+	if (lseek(prefetcher->readFile, (off_t) targetPageOff, SEEK_SET) < 0 ||
+		read(prefetcher->readFile, readBuf, XLOG_BLCKSZ) != XLOG_BLCKSZ)
+	{
+		close(prefetcher->readFile);
+		prefetcher->readFile = -1;
+		return -1;
+	}
+
+	*pageTLI = prefetcher->readFileTLI;
+	return readLen;
+}
+
+/*
+ * SQL-callable function to report the recovery prefetching statistics.
+ */
+Datum
+pg_stat_get_recovery_prefetch(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_RECOVERY_PREFETCH_COLS 6
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+	bool		nulls[PG_STAT_GET_RECOVERY_PREFETCH_COLS];
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum((int64) pg_atomic_read_u64(&SharedStats->prefetch));
+	values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&SharedStats->hit));
+	values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&SharedStats->skip_new));
+	values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&SharedStats->skip_fpw));
+	values[4] = Int64GetDatum((int64) pg_atomic_read_u64(&SharedStats->skip_rep));
+	values[5] = Int64GetDatum((int64) pg_atomic_read_u32(&SharedStats->distance));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
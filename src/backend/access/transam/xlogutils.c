@@ -18,8 +18,10 @@
 #include "postgres.h"
 
 #include "access/xlog.h"
+#include "access/xlogparallel.h"
 #include "access/xlogutils.h"
 #include "catalog/catalog.h"
+#include "storage/lmgr.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
@@ -433,6 +435,7 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 	BlockNumber lastblock;
 	Buffer		buffer;
 	SMgrRelation smgr;
+	Relation	fakerel;
 
 	Assert(blkno != P_NEW);
 
@@ -468,29 +471,55 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		if (mode == RBM_NORMAL_NO_LOG)
 			return InvalidBuffer;
 		/* OK to extend the file */
-		/* we do this in recovery only - no rel-extension lock needed */
 		Assert(InRecovery);
-		buffer = InvalidBuffer;
-		do
+
+		/*
+		 * We do this in recovery only, so no rel-extension lock is needed,
+		 * unless parallel redo workers could be extending the same relation
+		 * concurrently.  Some other worker might have extended it while we
+		 * waited for the lock.
+		 */
+		fakerel = NULL;
+		if (am_parallel_redo_worker)
 		{
-			if (buffer != InvalidBuffer)
+			fakerel = CreateFakeRelcacheEntry(rnode);
+			LockRelationForExtension(fakerel, ExclusiveLock);
+			lastblock = smgrnblocks(smgr, forknum);
+		}
+
+		if (blkno < lastblock)
+			buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
+											   mode, NULL);
+		else
+		{
+			buffer = InvalidBuffer;
+			do
+			{
+				if (buffer != InvalidBuffer)
+				{
+					if (mode == RBM_ZERO_AND_LOCK || mode == RBM_ZERO_AND_CLEANUP_LOCK)
+						LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+					ReleaseBuffer(buffer);
+				}
+				buffer = ReadBufferWithoutRelcache(rnode, forknum,
+												   P_NEW, mode, NULL);
+			}
+			while (BufferGetBlockNumber(buffer) < blkno);
+			/* Handle the corner case that P_NEW returns non-consecutive pages */
+			if (BufferGetBlockNumber(buffer) != blkno)
 			{
 				if (mode == RBM_ZERO_AND_LOCK || mode == RBM_ZERO_AND_CLEANUP_LOCK)
 					LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 				ReleaseBuffer(buffer);
+				buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
+												   mode, NULL);
 			}
-			buffer = ReadBufferWithoutRelcache(rnode, forknum,
-											   P_NEW, mode, NULL);
 		}
-		while (BufferGetBlockNumber(buffer) < blkno);
-		/* Handle the corner case that P_NEW returns non-consecutive pages */
-		if (BufferGetBlockNumber(buffer) != blkno)
+
+		if (fakerel != NULL)
 		{
-			if (mode == RBM_ZERO_AND_LOCK || mode == RBM_ZERO_AND_CLEANUP_LOCK)
-				LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
-			ReleaseBuffer(buffer);
-			buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
-											   mode, NULL);
+			UnlockRelationForExtension(fakerel, ExclusiveLock);
+			FreeFakeRelcacheEntry(fakerel);
 		}
 	}
 
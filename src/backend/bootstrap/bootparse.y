@@ -224,6 +224,7 @@ Boot_CreateStmt:
 												   RELPERSISTENCE_PERMANENT,
 												   shared_relation,
 												   mapped_relation,
+												   false,
 												   true);
 						elog(DEBUG4, "bootstrap relation created");
 					}
@@ -238,6 +239,7 @@ Boot_CreateStmt:
 													  $7,
 													  InvalidOid,
 													  BOOTSTRAP_SUPERUSERID,
+													  InvalidOid,
 													  tupdesc,
 													  NIL,
 													  RELKIND_RELATION,
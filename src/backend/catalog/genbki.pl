@@ -412,6 +412,7 @@ sub emit_pgattr_row
 		attisdropped  => 'f',
 		attislocal    => 't',
 		attinhcount   => '0',
+		attcompression => '""',
 		attacl        => '_null_',
 		attoptions    => '_null_',
 		attfdwoptions => '_null_');
@@ -439,6 +440,7 @@ sub emit_schemapg_row
 	$row->{attname}    = q|{"| . $row->{attname} . q|"}|;
 	$row->{attstorage} = q|'| . $row->{attstorage} . q|'|;
 	$row->{attalign}   = q|'| . $row->{attalign} . q|'|;
+	$row->{attcompression} = q|'\0'|;
 
 	# We don't emit initializers for the variable length fields at all.
 	# Only the fixed-size portions of the descriptors are ever used.
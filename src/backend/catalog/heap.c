@@ -31,6 +31,7 @@
 
 #include "access/htup_details.h"
 #include "access/multixact.h"
+#include "access/reloptions.h"
 #include "access/sysattr.h"
 #include "access/transam.h"
 #include "access/xact.h"
@@ -47,6 +48,8 @@
 #include "catalog/pg_foreign_table.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_namespace.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_publication.h"
 #include "catalog/pg_statistic.h"
 #include "catalog/pg_tablespace.h"
 #include "catalog/pg_type.h"
@@ -237,6 +240,9 @@ SystemAttributeByName(const char *attname, bool relhasoids)
  *
  *		rel->rd_rel is initialized by RelationBuildLocalRelation,
  *		and is mostly zeroes at return.
+ *
+ *		If compressed is true, the storage is created compressed, see
+ *		RelationCreateStorage.
  * ----------------------------------------------------------------
  */
 Relation
@@ -250,6 +256,7 @@ heap_create(const char *relname,
 			char relpersistence,
 			bool shared_relation,
 			bool mapped_relation,
+			bool compressed,
 			bool allow_system_table_mods)
 {
 	bool		create_storage;
@@ -353,7 +360,7 @@ heap_create(const char *relname,
 	if (create_storage)
 	{
 		RelationOpenSmgr(rel);
-		RelationCreateStorage(rel->rd_node, relpersistence);
+		RelationCreateStorage(rel->rd_node, relpersistence, compressed);
 	}
 
 	return rel;
@@ -627,6 +634,7 @@ InsertPgAttributeTuple(Relation pg_attribute_rel,
 	values[Anum_pg_attribute_attislocal - 1] = BoolGetDatum(new_attribute->attislocal);
 	values[Anum_pg_attribute_attinhcount - 1] = Int32GetDatum(new_attribute->attinhcount);
 	values[Anum_pg_attribute_attcollation - 1] = ObjectIdGetDatum(new_attribute->attcollation);
+	values[Anum_pg_attribute_attcompression - 1] = CharGetDatum(new_attribute->attcompression);
 
 	/* start out with empty permissions and empty options */
 	nulls[Anum_pg_attribute_attacl - 1] = true;
@@ -992,6 +1000,8 @@ AddNewRelationType(const char *typename__,
  *	reltypeid: OID to assign to rel's rowtype, or InvalidOid to select one
  *	reloftypeid: if a typed table, OID of underlying type; else InvalidOid
  *	ownerid: OID of new rel's owner
+ *	relam: handler function of the table access method, or InvalidOid for
+ *		a heap
  *	tupdesc: tuple descriptor (source of column definitions)
  *	cooked_constraints: list of precooked check constraints and defaults
  *	relkind: relkind for new rel
@@ -1021,6 +1031,7 @@ heap_create_with_catalog(const char *relname,
 						 Oid reltypeid,
 						 Oid reloftypeid,
 						 Oid ownerid,
+						 Oid relam,
 						 TupleDesc tupdesc,
 						 List *cooked_constraints,
 						 char relkind,
@@ -1044,6 +1055,7 @@ heap_create_with_catalog(const char *relname,
 	Oid			new_type_oid;
 	ObjectAddress new_type_addr;
 	Oid			new_array_oid = InvalidOid;
+	bool		compressed = false;
 
 	pg_class_desc = heap_open(RelationRelationId, RowExclusiveLock);
 
@@ -1125,6 +1137,22 @@ heap_create_with_catalog(const char *relname,
 									  relpersistence);
 	}
 
+	/*
+	 * Check whether the storage is to be compressed.  The options have been
+	 * validated by the caller already.
+	 */
+	if (relkind == RELKIND_RELATION || relkind == RELKIND_MATVIEW)
+	{
+		StdRdOptions *rdopts;
+
+		rdopts = (StdRdOptions *) heap_reloptions(relkind, reloptions, false);
+		if (rdopts != NULL)
+		{
+			compressed = rdopts->compression;
+			pfree(rdopts);
+		}
+	}
+
 	/*
 	 * Determine the relation's initial permissions.
 	 */
@@ -1166,10 +1194,13 @@ heap_create_with_catalog(const char *relname,
 							   relpersistence,
 							   shared_relation,
 							   mapped_relation,
+							   compressed,
 							   allow_system_table_mods);
 
 	Assert(relid == RelationGetRelid(new_rel_desc));
 
+	new_rel_desc->rd_rel->relam = relam;
+
 	/*
 	 * Decide whether to create an array type over the relation's rowtype. We
 	 * do not create any array types for system catalogs (ie, those made
@@ -1318,6 +1349,14 @@ heap_create_with_catalog(const char *relname,
 			recordDependencyOn(&myself, &referenced, DEPENDENCY_NORMAL);
 		}
 
+		if (OidIsValid(relam))
+		{
+			referenced.classId = ProcedureRelationId;
+			referenced.objectId = relam;
+			referenced.objectSubId = 0;
+			recordDependencyOn(&myself, &referenced, DEPENDENCY_NORMAL);
+		}
+
 		if (relacl != NULL)
 		{
 			int			nnewmembers;
@@ -1379,7 +1418,7 @@ heap_create_init_fork(Relation rel)
 	RelationOpenSmgr(rel);
 	smgrcreate(rel->rd_smgr, INIT_FORKNUM, false);
 	if (XLogIsNeeded())
-		log_smgrcreate(&rel->rd_smgr->smgr_rnode.node, INIT_FORKNUM);
+		log_smgrcreate(&rel->rd_smgr->smgr_rnode.node, INIT_FORKNUM, false);
 	smgrimmedsync(rel->rd_smgr, INIT_FORKNUM);
 }
 
@@ -1839,6 +1878,11 @@ heap_drop_with_catalog(Oid relid)
 	 */
 	RemoveStatistics(relid, 0);
 
+	/*
+	 * remove the relation from any publications it was a member of
+	 */
+	RemovePublicationRelations(relid);
+
 	/*
 	 * delete attribute tuples
 	 */
@@ -24,7 +24,9 @@
 #include <unistd.h>
 
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/relscan.h"
+#include "access/reloptions.h"
 #include "access/sysattr.h"
 #include "access/transam.h"
 #include "access/visibilitymap.h"
@@ -53,10 +55,14 @@
 #include "optimizer/clauses.h"
 #include "parser/parser.h"
 #include "storage/bufmgr.h"
+#include "storage/dsm_impl.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
+#include "storage/proc.h"
 #include "storage/procarray.h"
+#include "storage/shm_mq.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/guc.h"
@@ -64,6 +70,7 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
+#include "utils/rel.h"
 #include "utils/syscache.h"
 #include "utils/tuplesort.h"
 #include "utils/snapmgr.h"
@@ -73,16 +80,59 @@
 /* Potentially set by pg_upgrade_support functions */
 Oid			binary_upgrade_next_index_pg_class_oid = InvalidOid;
 
+/* Magic numbers for parallel validate_index state sharing */
+#define PARALLEL_KEY_VALIDATE_SHARED	UINT64CONST(0xC000000000000001)
+#define PARALLEL_KEY_VALIDATE_SNAPSHOT	UINT64CONST(0xC000000000000002)
+#define PARALLEL_KEY_VALIDATE_QUEUES	UINT64CONST(0xC000000000000003)
+
+/* Size of the queue each worker receives its index TIDs through */
+#define PARALLEL_VALIDATE_QUEUE_SIZE	65536
+
+/* Number of index TIDs sent to a worker in one message */
+#define PARALLEL_VALIDATE_BATCH_SIZE	1024
+
+/* Smallest heap, in blocks, whose validation we share with a worker */
+#define PARALLEL_VALIDATE_MIN_PAGES		1000
+
 /* state info for validate_index bulkdelete callback */
 typedef struct
 {
 	Tuplesortstate *tuplesort;	/* for sorting the index TIDs */
+	/* in a parallel validation, one sort per range of heap blocks instead */
+	Tuplesortstate **rangesorts;
+	int			nranges;
+	BlockNumber range_pages;	/* # of heap blocks in each range */
 	/* statistics (for debug purposes only): */
 	double		htups,
 				itups,
 				tups_inserted;
 } v_i_state;
 
+/* Range of heap blocks a parallel validate_index participant scans */
+typedef struct ValidateIndexRange
+{
+	BlockNumber startblock;
+	BlockNumber numblocks;
+} ValidateIndexRange;
+
+/*
+ * Status record shared by the leader and the workers of a parallel
+ * validate_index.  The counters are summed up by the workers as they finish.
+ */
+typedef struct ValidateIndexShared
+{
+	Oid			heaprelid;
+	Oid			indexrelid;
+	int			sortmem;		/* kB of sort memory for each worker */
+
+	slock_t		mutex;			/* protects the following */
+	double		htups;			/* # of heap tuples scanned by workers */
+	double		tups_inserted;	/* # of them inserted by workers */
+
+	/* each worker's range, set before its TIDs are sent to it */
+	ValidateIndexRange ranges[FLEXIBLE_ARRAY_MEMBER];
+} ValidateIndexShared;
+
 /* non-export function prototypes */
 static bool relationHasPrimaryKey(Relation rel);
 static TupleDesc ConstructTupleDescriptor(Relation heapRelation,
@@ -114,7 +164,22 @@ static void validate_index_heapscan(Relation heapRelation,
 						Relation indexRelation,
 						IndexInfo *indexInfo,
 						Snapshot snapshot,
-						v_i_state *state);
+						v_i_state *state,
+						BlockNumber start_blockno,
+						BlockNumber numblocks);
+static int	validate_index_workers(Relation heapRelation);
+static void validate_index_parallel(Relation heapRelation,
+						Relation indexRelation,
+						IndexInfo *indexInfo,
+						Snapshot snapshot,
+						IndexVacuumInfo *ivinfo,
+						v_i_state *state,
+						int nworkers);
+static void validate_index_send_tids(ParallelContext *pcxt,
+						 Tuplesortstate *sortstate,
+						 shm_mq_handle *mqh);
+static void validate_index_send(ParallelContext *pcxt, shm_mq_handle *mqh,
+					ItemPointer tids, int ntids);
 static bool ReindexIsCurrentlyProcessingIndex(Oid indexOid);
 static void SetReindexProcessing(Oid heapOid, Oid indexOid);
 static void ResetReindexProcessing(void);
@@ -425,6 +490,10 @@ ConstructTupleDescriptor(Relation heapRelation,
 		namestrcpy(&to->attname, (const char *) lfirst(colnames_item));
 		colnames_item = lnext(colnames_item);
 
+		/* Included columns have no opclass, and are stored as they are */
+		if (i >= indexInfo->ii_NumIndexKeyAttrs)
+			continue;
+
 		/*
 		 * Check the opclass and index AM to see if either provides a keytype
 		 * (overriding the attribute type).  Opclass takes precedence.
@@ -606,6 +675,7 @@ UpdateIndexRelation(Oid indexoid,
 	values[Anum_pg_index_indexrelid - 1] = ObjectIdGetDatum(indexoid);
 	values[Anum_pg_index_indrelid - 1] = ObjectIdGetDatum(heapoid);
 	values[Anum_pg_index_indnatts - 1] = Int16GetDatum(indexInfo->ii_NumIndexAttrs);
+	values[Anum_pg_index_indnkeyatts - 1] = Int16GetDatum(indexInfo->ii_NumIndexKeyAttrs);
 	values[Anum_pg_index_indisunique - 1] = BoolGetDatum(indexInfo->ii_Unique);
 	values[Anum_pg_index_indisprimary - 1] = BoolGetDatum(primary);
 	values[Anum_pg_index_indisexclusion - 1] = BoolGetDatum(isexclusion);
@@ -713,6 +783,7 @@ index_create(Relation heapRelation,
 	Oid			namespaceId;
 	int			i;
 	char		relpersistence;
+	bool		compressed = false;
 
 	is_exclusion = (indexInfo->ii_ExclusionOps != NULL);
 
@@ -830,6 +901,23 @@ index_create(Relation heapRelation,
 		}
 	}
 
+	/*
+	 * Only btree indexes can be compressed.  The options have been validated
+	 * by the caller already.
+	 */
+	if (accessMethodObjectId == BTREE_AM_OID)
+	{
+		StdRdOptions *rdopts;
+
+		rdopts = (StdRdOptions *)
+			default_reloptions(reloptions, false, RELOPT_KIND_BTREE);
+		if (rdopts != NULL)
+		{
+			compressed = rdopts->compression;
+			pfree(rdopts);
+		}
+	}
+
 	/*
 	 * create the index relation's relcache entry and physical disk file. (If
 	 * we fail further down, it's the smgr's responsibility to remove the disk
@@ -845,6 +933,7 @@ index_create(Relation heapRelation,
 								relpersistence,
 								shared_relation,
 								mapped_relation,
+								compressed,
 								allow_system_table_mods);
 
 	Assert(indexRelationId == RelationGetRelid(indexRelation));
@@ -1011,7 +1100,7 @@ index_create(Relation heapRelation,
 		}
 
 		/* Store dependency on operator classes */
-		for (i = 0; i < indexInfo->ii_NumIndexAttrs; i++)
+		for (i = 0; i < indexInfo->ii_NumIndexKeyAttrs; i++)
 		{
 			referenced.classId = OperatorClassRelationId;
 			referenced.objectId = classObjectId[i];
@@ -1637,6 +1726,9 @@ BuildIndexInfo(Relation index)
 		elog(ERROR, "invalid indnatts %d for index %u",
 			 numKeys, RelationGetRelid(index));
 	ii->ii_NumIndexAttrs = numKeys;
+	ii->ii_NumIndexKeyAttrs = indexStruct->indnkeyatts;
+	Assert(ii->ii_NumIndexKeyAttrs > 0 &&
+		   ii->ii_NumIndexKeyAttrs <= ii->ii_NumIndexAttrs);
 	for (i = 0; i < numKeys; i++)
 		ii->ii_KeyAttrNumbers[i] = indexStruct->indkey.values[i];
 
@@ -1693,7 +1785,7 @@ BuildIndexInfo(Relation index)
 void
 BuildSpeculativeIndexInfo(Relation index, IndexInfo *ii)
 {
-	int			ncols = index->rd_rel->relnatts;
+	int			ncols = IndexRelationGetNumberOfKeyAttributes(index);
 	int			i;
 
 	/*
@@ -1921,7 +2013,7 @@ index_update_stats(Relation rel,
 		BlockNumber relallvisible;
 
 		if (rd_rel->relkind != RELKIND_INDEX)
-			relallvisible = visibilitymap_count(rel);
+			visibilitymap_count(rel, &relallvisible, NULL);
 		else	/* don't bother for indexes */
 			relallvisible = 0;
 
@@ -2163,7 +2255,7 @@ IndexBuildHeapScan(Relation heapRelation,
 								   indexInfo, allow_sync,
 								   false,
 								   0, InvalidBlockNumber,
-								   callback, callback_state);
+								   callback, callback_state, NULL);
 }
 
 /*
@@ -2175,6 +2267,11 @@ IndexBuildHeapScan(Relation heapRelation,
  * When "anyvisible" mode is requested, all tuples visible to any transaction
  * are considered, including those inserted or deleted by transactions that are
  * still in progress.
+ *
+ * If scan is not NULL, it is a scan of the heap begun by the caller, usually
+ * a participant's share of a parallel heap scan, and is used instead of
+ * starting one here; allow_sync and the range are then ignored.  Its snapshot
+ * must be what we would have chosen ourselves.  The scan is ended on return.
  */
 double
 IndexBuildHeapRangeScan(Relation heapRelation,
@@ -2185,11 +2282,12 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 						BlockNumber start_blockno,
 						BlockNumber numblocks,
 						IndexBuildCallback callback,
-						void *callback_state)
+						void *callback_state,
+						HeapScanDesc scan)
 {
 	bool		is_system_catalog;
 	bool		checking_uniqueness;
-	HeapScanDesc scan;
+	bool		registered_snapshot = false;
 	HeapTuple	heapTuple;
 	Datum		values[INDEX_MAX_KEYS];
 	bool		isnull[INDEX_MAX_KEYS];
@@ -2244,9 +2342,20 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 	 * concurrent build, or during bootstrap, we take a regular MVCC snapshot
 	 * and index whatever's live according to that.
 	 */
-	if (IsBootstrapProcessingMode() || indexInfo->ii_Concurrent)
+	if (scan != NULL)
+	{
+		snapshot = scan->rs_snapshot;
+		Assert((snapshot == SnapshotAny) ==
+			   !(IsBootstrapProcessingMode() || indexInfo->ii_Concurrent));
+		if (snapshot == SnapshotAny)
+			OldestXmin = GetOldestXmin(heapRelation, true);
+		else
+			OldestXmin = InvalidTransactionId;	/* not used */
+	}
+	else if (IsBootstrapProcessingMode() || indexInfo->ii_Concurrent)
 	{
 		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+		registered_snapshot = true;
 		OldestXmin = InvalidTransactionId;		/* not used */
 
 		/* "any visible" mode is not compatible with this */
@@ -2259,21 +2368,24 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 		OldestXmin = GetOldestXmin(heapRelation, true);
 	}
 
-	scan = heap_beginscan_strat(heapRelation,	/* relation */
-								snapshot,		/* snapshot */
-								0,		/* number of keys */
-								NULL,	/* scan key */
-								true,	/* buffer access strategy OK */
-								allow_sync);	/* syncscan OK? */
-
-	/* set our scan endpoints */
-	if (!allow_sync)
-		heap_setscanlimits(scan, start_blockno, numblocks);
-	else
+	if (scan == NULL)
 	{
-		/* syncscan can only be requested on whole relation */
-		Assert(start_blockno == 0);
-		Assert(numblocks == InvalidBlockNumber);
+		scan = heap_beginscan_strat(heapRelation,	/* relation */
+									snapshot,	/* snapshot */
+									0,	/* number of keys */
+									NULL,		/* scan key */
+									true,		/* buffer access strategy OK */
+									allow_sync);		/* syncscan OK? */
+
+		/* set our scan endpoints */
+		if (!allow_sync)
+			heap_setscanlimits(scan, start_blockno, numblocks);
+		else
+		{
+			/* syncscan can only be requested on whole relation */
+			Assert(start_blockno == 0);
+			Assert(numblocks == InvalidBlockNumber);
+		}
 	}
 
 	reltuples = 0;
@@ -2596,7 +2708,7 @@ IndexBuildHeapRangeScan(Relation heapRelation,
 	heap_endscan(scan);
 
 	/* we can now forget our snapshot, if set */
-	if (IsBootstrapProcessingMode() || indexInfo->ii_Concurrent)
+	if (registered_snapshot)
 		UnregisterSnapshot(snapshot);
 
 	ExecDropSingleTupleTableSlot(slot);
@@ -2780,6 +2892,12 @@ IndexCheckExclusion(Relation heapRelation,
  * not index).  Then we mark the index "indisvalid" and commit.  Subsequent
  * transactions will be able to use it for queries.
  *
+ * On a large table, parallel workers share the table scan (see
+ * validate_index_parallel).  The heap is divided into one contiguous range of
+ * blocks per participant, and the TIDs gathered from the index are sorted
+ * separately for each range, so that each participant can do the merge for
+ * its own range.
+ *
  * Doing two full table scans is a brute-force strategy.  We could try to be
  * cleverer, eg storing new tuples in a special area of the table (perhaps
  * making the table append-only by setting use_fsm).  However that would
@@ -2793,6 +2911,7 @@ validate_index(Oid heapId, Oid indexId, Snapshot snapshot)
 	IndexInfo  *indexInfo;
 	IndexVacuumInfo ivinfo;
 	v_i_state	state;
+	int			nworkers;
 	Oid			save_userid;
 	int			save_sec_context;
 	int			save_nestlevel;
@@ -2832,29 +2951,42 @@ validate_index(Oid heapId, Oid indexId, Snapshot snapshot)
 	ivinfo.num_heap_tuples = heapRelation->rd_rel->reltuples;
 	ivinfo.strategy = NULL;
 
-	state.tuplesort = tuplesort_begin_datum(TIDOID, TIDLessOperator,
-											InvalidOid, false,
-											maintenance_work_mem,
-											false);
+	state.tuplesort = NULL;
+	state.rangesorts = NULL;
+	state.nranges = 0;
+	state.range_pages = InvalidBlockNumber;
 	state.htups = state.itups = state.tups_inserted = 0;
 
-	(void) index_bulk_delete(&ivinfo, NULL,
-							 validate_index_callback, (void *) &state);
+	nworkers = validate_index_workers(heapRelation);
+	if (nworkers > 0)
+		validate_index_parallel(heapRelation, indexRelation, indexInfo,
+								snapshot, &ivinfo, &state, nworkers);
+	else
+	{
+		state.tuplesort = tuplesort_begin_datum(TIDOID, TIDLessOperator,
+												InvalidOid, false,
+												maintenance_work_mem,
+												false);
 
-	/* Execute the sort */
-	tuplesort_performsort(state.tuplesort);
+		(void) index_bulk_delete(&ivinfo, NULL,
+								 validate_index_callback, (void *) &state);
 
-	/*
-	 * Now scan the heap and "merge" it with the index
-	 */
-	validate_index_heapscan(heapRelation,
-							indexRelation,
-							indexInfo,
-							snapshot,
-							&state);
+		/* Execute the sort */
+		tuplesort_performsort(state.tuplesort);
 
-	/* Done with tuplesort object */
-	tuplesort_end(state.tuplesort);
+		/*
+		 * Now scan the heap and "merge" it with the index
+		 */
+		validate_index_heapscan(heapRelation,
+								indexRelation,
+								indexInfo,
+								snapshot,
+								&state,
+								0, InvalidBlockNumber);
+
+		/* Done with tuplesort object */
+		tuplesort_end(state.tuplesort);
+	}
 
 	elog(DEBUG2,
 		 "validate_index found %.0f heap tuples, %.0f index tuples; inserted %.0f missing tuples",
@@ -2878,8 +3010,18 @@ static bool
 validate_index_callback(ItemPointer itemptr, void *opaque)
 {
 	v_i_state  *state = (v_i_state *) opaque;
+	Tuplesortstate *sortstate = state->tuplesort;
+
+	/* in a parallel validation, the TID goes to the sort for its range */
+	if (state->nranges > 0)
+	{
+		BlockNumber range;
 
-	tuplesort_putdatum(state->tuplesort, PointerGetDatum(itemptr), false);
+		range = ItemPointerGetBlockNumber(itemptr) / state->range_pages;
+		sortstate = state->rangesorts[Min(range, (BlockNumber) state->nranges - 1)];
+	}
+
+	tuplesort_putdatum(sortstate, PointerGetDatum(itemptr), false);
 	state->itups += 1;
 	return false;				/* never actually delete anything */
 }
@@ -2889,13 +3031,19 @@ validate_index_callback(ItemPointer itemptr, void *opaque)
  *
  * This has much code in common with IndexBuildHeapScan, but it's enough
  * different that it seems cleaner to have two routines not one.
+ *
+ * Only the blocks from start_blockno on are scanned, numblocks of them, or up
+ * to the end of the heap if that is InvalidBlockNumber.  state->tuplesort
+ * must hold the sorted index TIDs of exactly that range.
  */
 static void
 validate_index_heapscan(Relation heapRelation,
 						Relation indexRelation,
 						IndexInfo *indexInfo,
 						Snapshot snapshot,
-						v_i_state *state)
+						v_i_state *state,
+						BlockNumber start_blockno,
+						BlockNumber numblocks)
 {
 	HeapScanDesc scan;
 	HeapTuple	heapTuple;
@@ -2947,6 +3095,16 @@ validate_index_heapscan(Relation heapRelation,
 								true,	/* buffer access strategy OK */
 								false); /* syncscan not OK */
 
+	/* Restrict the scan to our range, which can be empty */
+	if (start_blockno != 0 || numblocks != InvalidBlockNumber)
+	{
+		if (start_blockno >= scan->rs_nblocks)
+			start_blockno = numblocks = 0;
+		else if (numblocks == InvalidBlockNumber)
+			numblocks = scan->rs_nblocks - start_blockno;
+		heap_setscanlimits(scan, start_blockno, numblocks);
+	}
+
 	/*
 	 * Scan all tuples matching the snapshot.
 	 */
@@ -3104,6 +3262,358 @@ validate_index_heapscan(Relation heapRelation,
 	indexInfo->ii_PredicateState = NIL;
 }
 
+/*
+ * validate_index_workers - choose the number of parallel workers to share
+ * validate_index's heap scan with, or zero to do it serially
+ */
+static int
+validate_index_workers(Relation heapRelation)
+{
+	int			nworkers;
+	double		heap_pages;
+	double		threshold;
+
+	/* Workers can't see temp tables' local buffers */
+	if (max_parallel_maintenance_workers == 0 ||
+		!IsUnderPostmaster ||
+		RelationUsesLocalBuffers(heapRelation) ||
+		IsInParallelMode() ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
+
+	/* The table's parallel_workers setting overrides our heuristics */
+	nworkers = RelationGetParallelWorkers(heapRelation, -1);
+	if (nworkers >= 0)
+		return Min(nworkers, max_parallel_maintenance_workers);
+
+	/*
+	 * As for a parallel btree build, use one worker once the heap has
+	 * PARALLEL_VALIDATE_MIN_PAGES blocks, and another one each time it
+	 * triples in size from there.  Sorting TIDs takes much less memory than
+	 * sorting index tuples, so there's no need to hold back for that.
+	 */
+	heap_pages = RelationGetNumberOfBlocks(heapRelation);
+	if (heap_pages < PARALLEL_VALIDATE_MIN_PAGES)
+		return 0;
+	nworkers = 1;
+	threshold = PARALLEL_VALIDATE_MIN_PAGES;
+	while (heap_pages >= threshold * 3 &&
+		   nworkers < max_parallel_maintenance_workers)
+	{
+		nworkers++;
+		threshold *= 3;
+	}
+
+	return Min(nworkers, max_parallel_maintenance_workers);
+}
+
+/*
+ * validate_index_parallel - validate_index with the help of parallel workers
+ *
+ * The index scan stays with us, since how to do it is up to the index AM,
+ * but the heap scan and the merge are shared.  We split the heap into one
+ * range of blocks for each worker that could be registered, plus a last one
+ * for ourselves, and sort the index TIDs separately for each range.  Then we
+ * send each worker the TIDs of its range, which it sorts again (they arrive
+ * in order, so that's cheap), and the worker merges them against its range
+ * of the heap while we do the same for ours.
+ *
+ * The workers get all their TIDs up front, rather than reading them as the
+ * merge progresses, so that we don't wait for one worker's scan before we
+ * can feed the next one.
+ */
+static void
+validate_index_parallel(Relation heapRelation,
+						Relation indexRelation,
+						IndexInfo *indexInfo,
+						Snapshot snapshot,
+						IndexVacuumInfo *ivinfo,
+						v_i_state *state,
+						int nworkers)
+{
+	ParallelContext *pcxt;
+	ValidateIndexShared *vishared;
+	Size		sharedsize;
+	char	   *snapspace;
+	char	   *queuespace;
+	shm_mq_handle **queues;
+	int		   *queueworker;
+	int			nqueues;
+	int			sortmem;
+	BlockNumber nblocks;
+	BlockNumber range_pages;
+	BlockNumber startblock;
+	int			i;
+
+	Assert(nworkers > 0);
+
+	/* The sort memory is split evenly among the participants */
+	sortmem = Max(maintenance_work_mem / (nworkers + 1), 64);
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(validate_index_worker_main, nworkers);
+
+	/* Estimate and allocate the shared state */
+	sharedsize = add_size(offsetof(ValidateIndexShared, ranges),
+						  mul_size(sizeof(ValidateIndexRange), nworkers));
+	shm_toc_estimate_chunk(&pcxt->estimator, sharedsize);
+	shm_toc_estimate_chunk(&pcxt->estimator, EstimateSnapshotSpace(snapshot));
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+	EstimateParallelQueues(pcxt, PARALLEL_VALIDATE_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	vishared = (ValidateIndexShared *) shm_toc_allocate(pcxt->toc, sharedsize);
+	vishared->heaprelid = RelationGetRelid(heapRelation);
+	vishared->indexrelid = RelationGetRelid(indexRelation);
+	vishared->sortmem = sortmem;
+	SpinLockInit(&vishared->mutex);
+	vishared->htups = 0;
+	vishared->tups_inserted = 0;
+	for (i = 0; i < nworkers; i++)
+	{
+		vishared->ranges[i].startblock = 0;
+		vishared->ranges[i].numblocks = 0;
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_VALIDATE_SHARED, vishared);
+
+	/* Everyone must check the tuples against the same reference snapshot */
+	snapspace = (char *) shm_toc_allocate(pcxt->toc,
+										  EstimateSnapshotSpace(snapshot));
+	SerializeSnapshot(snapshot, snapspace);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_VALIDATE_SNAPSHOT, snapspace);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_VALIDATE_QUEUES,
+										  PARALLEL_VALIDATE_QUEUE_SIZE, true);
+
+	LaunchParallelWorkers(pcxt);
+
+	/* Each of the workers that could be registered gets a range */
+	queues = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	queueworker = (int *) palloc(nworkers * sizeof(int));
+	nqueues = AttachParallelQueues(pcxt, queuespace,
+								   PARALLEL_VALIDATE_QUEUE_SIZE,
+								   queues, queueworker);
+
+	/*
+	 * Divide the heap into ranges, the last one being ours.  Blocks added to
+	 * the heap from now on can't hold tuples visible to the reference
+	 * snapshot, which was taken before we measured the heap, so it doesn't
+	 * matter that some of them may not be scanned by anyone.
+	 */
+	nblocks = RelationGetNumberOfBlocks(heapRelation);
+	range_pages = Max((nblocks + nqueues) / (nqueues + 1), 1);
+	for (i = 0; i < nqueues; i++)
+	{
+		ValidateIndexRange *range = &vishared->ranges[queueworker[i]];
+
+		startblock = i * range_pages;
+		if (startblock < nblocks)
+		{
+			range->startblock = startblock;
+			range->numblocks = Min(range_pages, nblocks - startblock);
+		}
+	}
+	startblock = nqueues * range_pages;
+
+	/* Scan the index, sorting the TIDs by range */
+	state->nranges = nqueues + 1;
+	state->range_pages = range_pages;
+	state->rangesorts = (Tuplesortstate **)
+		palloc(state->nranges * sizeof(Tuplesortstate *));
+	for (i = 0; i < state->nranges; i++)
+		state->rangesorts[i] = tuplesort_begin_datum(TIDOID, TIDLessOperator,
+													 InvalidOid, false,
+													 sortmem, false);
+
+	(void) index_bulk_delete(ivinfo, NULL,
+							 validate_index_callback, (void *) state);
+
+	/* Hand each worker the TIDs of its range */
+	for (i = 0; i < nqueues; i++)
+	{
+		tuplesort_performsort(state->rangesorts[i]);
+		validate_index_send_tids(pcxt, state->rangesorts[i], queues[i]);
+		tuplesort_end(state->rangesorts[i]);
+	}
+
+	/* and do the merge for our own range */
+	state->tuplesort = state->rangesorts[nqueues];
+	tuplesort_performsort(state->tuplesort);
+	validate_index_heapscan(heapRelation,
+							indexRelation,
+							indexInfo,
+							snapshot,
+							state,
+							startblock, InvalidBlockNumber);
+	tuplesort_end(state->tuplesort);
+	state->tuplesort = NULL;
+
+	/* This rethrows any error a worker ran into */
+	WaitForParallelWorkersToFinish(pcxt);
+
+	state->htups += vishared->htups;
+	state->tups_inserted += vishared->tups_inserted;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * validate_index_send_tids - send the sorted TIDs of a range to a worker
+ *
+ * The TIDs go in batches of PARALLEL_VALIDATE_BATCH_SIZE, and an empty
+ * message marks the end.  The sort is consumed.
+ */
+static void
+validate_index_send_tids(ParallelContext *pcxt, Tuplesortstate *sortstate,
+						 shm_mq_handle *mqh)
+{
+	ItemPointerData tids[PARALLEL_VALIDATE_BATCH_SIZE];
+	int			ntids = 0;
+	Datum		ts_val;
+	bool		ts_isnull;
+
+	while (tuplesort_getdatum(sortstate, true, &ts_val, &ts_isnull))
+	{
+		ItemPointer tid = (ItemPointer) DatumGetPointer(ts_val);
+
+		Assert(!ts_isnull);
+		tids[ntids++] = *tid;
+		pfree(tid);
+
+		if (ntids == PARALLEL_VALIDATE_BATCH_SIZE)
+		{
+			validate_index_send(pcxt, mqh, tids, ntids);
+			ntids = 0;
+		}
+	}
+	if (ntids > 0)
+		validate_index_send(pcxt, mqh, tids, ntids);
+
+	validate_index_send(pcxt, mqh, NULL, 0);
+}
+
+/*
+ * Send one batch of TIDs to a worker.  A worker that has gone away has
+ * normally failed, and its error is the one to report.
+ */
+static void
+validate_index_send(ParallelContext *pcxt, shm_mq_handle *mqh,
+					ItemPointer tids, int ntids)
+{
+	if (shm_mq_send(mqh, ntids * sizeof(ItemPointerData), tids,
+					false) != SHM_MQ_SUCCESS)
+	{
+		WaitForParallelWorkersToFinish(pcxt);
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not send index TIDs to parallel worker")));
+	}
+}
+
+/*
+ * validate_index_worker_main
+ *
+ * Entry point of a parallel validate_index worker: receive the index TIDs of
+ * our range, and merge them against that range of the heap, inserting what's
+ * missing.
+ */
+void
+validate_index_worker_main(dsm_segment *seg, shm_toc *toc)
+{
+	ValidateIndexShared *vishared;
+	char	   *snapspace;
+	char	   *queuespace;
+	shm_mq_handle *mqh;
+	Relation	heapRelation;
+	Relation	indexRelation;
+	IndexInfo  *indexInfo;
+	Snapshot	snapshot;
+	ValidateIndexRange range;
+	v_i_state	state;
+
+	vishared = (ValidateIndexShared *)
+		shm_toc_lookup(toc, PARALLEL_KEY_VALIDATE_SHARED);
+	snapspace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_VALIDATE_SNAPSHOT);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_VALIDATE_QUEUES);
+	if (vishared == NULL || snapspace == NULL || queuespace == NULL)
+		elog(ERROR, "invalid parallel validate_index state");
+
+	mqh = AttachParallelLeaderQueue(seg, queuespace,
+									PARALLEL_VALIDATE_QUEUE_SIZE, true);
+
+	/*
+	 * The leader holds the locks validate_index needs until we are done, and
+	 * we cannot take locks of our own that would conflict with them.
+	 */
+	heapRelation = heap_open(vishared->heaprelid, NoLock);
+	indexRelation = index_open(vishared->indexrelid, NoLock);
+
+	indexInfo = BuildIndexInfo(indexRelation);
+	indexInfo->ii_Concurrent = true;
+
+	snapshot = RestoreSnapshot(snapspace);
+	RegisterSnapshot(snapshot);
+
+	state.tuplesort = tuplesort_begin_datum(TIDOID, TIDLessOperator,
+											InvalidOid, false,
+											vishared->sortmem,
+											false);
+	state.rangesorts = NULL;
+	state.nranges = 0;
+	state.range_pages = InvalidBlockNumber;
+	state.htups = state.itups = state.tups_inserted = 0;
+
+	for (;;)
+	{
+		shm_mq_result result;
+		Size		nbytes;
+		void	   *data;
+		ItemPointer tids;
+		int			ntids;
+		int			i;
+
+		result = shm_mq_receive(mqh, &nbytes, &data, false);
+		if (result != SHM_MQ_SUCCESS)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("could not receive index TIDs from parallel leader")));
+		if (nbytes == 0)
+			break;
+
+		tids = (ItemPointer) data;
+		ntids = nbytes / sizeof(ItemPointerData);
+		for (i = 0; i < ntids; i++)
+			tuplesort_putdatum(state.tuplesort, PointerGetDatum(&tids[i]),
+							   false);
+		state.itups += ntids;
+	}
+	tuplesort_performsort(state.tuplesort);
+
+	/* the leader has set our range before sending anything */
+	range = vishared->ranges[ParallelWorkerNumber];
+	if (range.numblocks > 0)
+		validate_index_heapscan(heapRelation,
+								indexRelation,
+								indexInfo,
+								snapshot,
+								&state,
+								range.startblock, range.numblocks);
+
+	tuplesort_end(state.tuplesort);
+
+	SpinLockAcquire(&vishared->mutex);
+	vishared->htups += state.htups;
+	vishared->tups_inserted += state.tups_inserted;
+	SpinLockRelease(&vishared->mutex);
+
+	UnregisterSnapshot(snapshot);
+
+	index_close(indexRelation, NoLock);
+	heap_close(heapRelation, NoLock);
+}
+
 
 /*
  * index_set_state_flags - adjust pg_index state flags
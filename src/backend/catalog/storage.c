@@ -27,6 +27,7 @@
 #include "catalog/catalog.h"
 #include "catalog/storage.h"
 #include "catalog/storage_xlog.h"
+#include "commands/sequence.h"
 #include "storage/freespace.h"
 #include "storage/smgr.h"
 #include "utils/memutils.h"
@@ -69,13 +70,14 @@ static PendingRelDelete *pendingDeletes = NULL; /* head of linked list */
  *
  * Create the underlying disk file storage for the relation. This only
  * creates the main fork; additional forks are created lazily by the
- * modules that need them.
+ * modules that need them.  If compressed is true, the main fork is set up
+ * to store its pages compressed, see storage/pagecompress.h.
  *
  * This function is transactional. The creation is WAL-logged, and if the
  * transaction aborts later on, the storage will be destroyed.
  */
 void
-RelationCreateStorage(RelFileNode rnode, char relpersistence)
+RelationCreateStorage(RelFileNode rnode, char relpersistence, bool compressed)
 {
 	PendingRelDelete *pending;
 	SMgrRelation srel;
@@ -103,9 +105,11 @@ RelationCreateStorage(RelFileNode rnode, char relpersistence)
 
 	srel = smgropen(rnode, backend);
 	smgrcreate(srel, MAIN_FORKNUM, false);
+	if (compressed)
+		smgrcompress(srel, MAIN_FORKNUM, false);
 
 	if (needs_wal)
-		log_smgrcreate(&srel->smgr_rnode.node, MAIN_FORKNUM);
+		log_smgrcreate(&srel->smgr_rnode.node, MAIN_FORKNUM, compressed);
 
 	/* Add the relation to the list of stuff to delete at abort */
 	pending = (PendingRelDelete *)
@@ -122,7 +126,7 @@ RelationCreateStorage(RelFileNode rnode, char relpersistence)
  * Perform XLogInsert of an XLOG_SMGR_CREATE record to WAL.
  */
 void
-log_smgrcreate(RelFileNode *rnode, ForkNumber forkNum)
+log_smgrcreate(RelFileNode *rnode, ForkNumber forkNum, bool compressed)
 {
 	xl_smgr_create xlrec;
 
@@ -131,6 +135,7 @@ log_smgrcreate(RelFileNode *rnode, ForkNumber forkNum)
 	 */
 	xlrec.rnode = *rnode;
 	xlrec.forkNum = forkNum;
+	xlrec.flags = compressed ? SMGR_CREATE_COMPRESSED : 0;
 
 	XLogBeginInsert();
 	XLogRegisterData((char *) &xlrec, sizeof(xlrec));
@@ -349,6 +354,10 @@ smgrDoPendingDeletes(bool isCommit)
 				}
 
 				srels[nrels++] = srel;
+
+				/* a dropped sequence's state must not outlive it */
+				if (pending->backend == InvalidBackendId)
+					SequenceForgetShared(pending->relnode);
 			}
 			/* must explicitly free the list entry */
 			pfree(pending);
@@ -488,6 +497,8 @@ smgr_redo(XLogReaderState *record)
 
 		reln = smgropen(xlrec->rnode, InvalidBackendId);
 		smgrcreate(reln, xlrec->forkNum, true);
+		if (xlrec->flags & SMGR_CREATE_COMPRESSED)
+			smgrcompress(reln, xlrec->forkNum, true);
 	}
 	else if (info == XLOG_SMGR_TRUNCATE)
 	{
@@ -217,6 +217,11 @@ CREATE VIEW pg_stats WITH (security_barrier) AS
 
 REVOKE ALL on pg_statistic FROM public;
 
+-- the MCV lists of extended statistics contain sample values, too
+REVOKE ALL on pg_statistic_ext FROM public;
+GRANT SELECT (stxrelid, stxname, stxnamespace, stxowner, stxkeys, stxkind)
+    ON pg_statistic_ext TO public;
+
 CREATE VIEW pg_locks AS
     SELECT * FROM pg_lock_status() AS L;
 
@@ -419,6 +424,19 @@ CREATE VIEW pg_file_settings AS
 REVOKE ALL on pg_file_settings FROM PUBLIC;
 REVOKE EXECUTE ON FUNCTION pg_show_all_file_settings() FROM PUBLIC;
 
+CREATE VIEW pg_backend_memory_contexts AS
+    SELECT * FROM pg_get_backend_memory_contexts();
+
+REVOKE ALL ON pg_backend_memory_contexts FROM PUBLIC;
+REVOKE EXECUTE ON FUNCTION pg_get_backend_memory_contexts() FROM PUBLIC;
+REVOKE EXECUTE ON FUNCTION pg_get_process_memory_contexts(integer) FROM PUBLIC;
+
+CREATE VIEW pg_catalog_cache_stats AS
+    SELECT * FROM pg_get_catalog_cache_stats();
+
+REVOKE ALL ON pg_catalog_cache_stats FROM PUBLIC;
+REVOKE EXECUTE ON FUNCTION pg_get_catalog_cache_stats() FROM PUBLIC;
+
 CREATE VIEW pg_timezone_abbrevs AS
     SELECT * FROM pg_timezone_abbrevs();
 
@@ -623,6 +641,8 @@ CREATE VIEW pg_stat_activity AS
             S.query_start,
             S.state_change,
             S.waiting,
+            S.wait_event_type,
+            S.wait_event,
             S.state,
             S.backend_xid,
             s.backend_xmin,
@@ -648,7 +668,10 @@ CREATE VIEW pg_stat_replication AS
             W.flush_location,
             W.replay_location,
             W.sync_priority,
-            W.sync_state
+            W.sync_state,
+            W.write_lag,
+            W.flush_lag,
+            W.replay_lag
     FROM pg_stat_get_activity(NULL) AS S, pg_authid U,
             pg_stat_get_wal_senders() AS W
     WHERE S.usesysid = U.oid AND
@@ -699,6 +722,7 @@ CREATE VIEW pg_stat_database AS
             pg_stat_get_db_temp_files(D.oid) AS temp_files,
             pg_stat_get_db_temp_bytes(D.oid) AS temp_bytes,
             pg_stat_get_db_deadlocks(D.oid) AS deadlocks,
+            pg_stat_get_db_overflowed_snapshots(D.oid) AS overflowed_snapshots,
             pg_stat_get_db_blk_read_time(D.oid) AS blk_read_time,
             pg_stat_get_db_blk_write_time(D.oid) AS blk_write_time,
             pg_stat_get_db_stat_reset_time(D.oid) AS stats_reset
@@ -750,6 +774,22 @@ CREATE VIEW pg_stat_archiver AS
         s.stats_reset
     FROM pg_stat_get_archiver() s;
 
+CREATE VIEW pg_stat_autovacuum AS
+    SELECT
+            W.pid,
+            W.datid,
+            D.datname,
+            W.relid,
+            W.tablespace,
+            W.priority,
+            W.wraparound,
+            W.cost_limit,
+            W.cost_limit_base,
+            W.cost_delay,
+            W.tablespace_cost_limit
+    FROM pg_stat_get_autovacuum_workers() AS W
+            LEFT JOIN pg_database D ON (W.datid = D.oid);
+
 CREATE VIEW pg_stat_bgwriter AS
     SELECT
         pg_stat_get_bgwriter_timed_checkpoints() AS checkpoints_timed,
@@ -764,6 +804,45 @@ CREATE VIEW pg_stat_bgwriter AS
         pg_stat_get_buf_alloc() AS buffers_alloc,
         pg_stat_get_bgwriter_stat_reset_time() AS stats_reset;
 
+CREATE VIEW pg_stat_relation_io_latency AS
+    SELECT
+            S.relid,
+            N.nspname AS schemaname,
+            C.relname,
+            S.operation,
+            S.calls,
+            S.total_time,
+            S.histogram
+    FROM pg_stat_get_io_latency() S
+            JOIN pg_class C ON (C.oid = S.relid)
+            LEFT JOIN pg_namespace N ON (N.oid = C.relnamespace);
+
+CREATE VIEW pg_stat_tablespace_io_latency AS
+    SELECT
+            T.oid AS spcid,
+            T.spcname,
+            S.operation,
+            S.calls,
+            S.total_time,
+            S.histogram
+    FROM pg_stat_get_io_latency() S
+            JOIN pg_tablespace T ON (T.oid = S.tablespace)
+    WHERE S.relfilenode = 0;
+
+CREATE VIEW pg_stat_profile AS
+    SELECT
+            S.datid,
+            D.datname,
+            S.queryid,
+            S.node_type,
+            S.wait_event_type,
+            S.wait_event,
+            count(*) AS samples
+    FROM pg_stat_get_profile_samples() S
+            LEFT JOIN pg_database D ON (D.oid = S.datid)
+    GROUP BY S.datid, D.datname, S.queryid, S.node_type,
+             S.wait_event_type, S.wait_event;
+
 CREATE VIEW pg_user_mappings AS
     SELECT
         U.oid       AS umid,
@@ -793,6 +872,12 @@ CREATE VIEW pg_replication_origin_status AS
 
 REVOKE ALL ON pg_replication_origin_status FROM public;
 
+-- the connection string of a subscription may contain a password
+REVOKE ALL ON pg_subscription FROM public;
+GRANT SELECT (oid, subdbid, subname, subowner, subenabled, substream,
+              subbinary, subslotname, subpublications)
+    ON pg_subscription TO public;
+
 --
 -- We have a few function definitions in here, too.
 -- At some point there might be enough to justify breaking them out into
@@ -17,6 +17,8 @@
 #include <math.h>
 
 #include "access/multixact.h"
+#include "access/parallel.h"
+#include "access/tableam.h"
 #include "access/transam.h"
 #include "access/tupconvert.h"
 #include "access/tuptoaster.h"
@@ -39,10 +41,14 @@
 #include "parser/parse_relation.h"
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
+#include "statistics/statistics.h"
 #include "storage/bufmgr.h"
+#include "storage/dsm_impl.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "storage/read_stream.h"
+#include "storage/shm_mq.h"
 #include "utils/acl.h"
 #include "utils/attoptcache.h"
 #include "utils/datum.h"
@@ -52,11 +58,75 @@
 #include "utils/pg_rusage.h"
 #include "utils/sampling.h"
 #include "utils/sortsupport.h"
+#include "utils/snapmgr.h"
 #include "utils/syscache.h"
 #include "utils/timestamp.h"
 #include "utils/tqual.h"
 
 
+/*
+ * An inheritance child needs at least this many pages to be worth a parallel
+ * worker of its own, unless the user asked for a number of workers.
+ */
+#define PARALLEL_ANALYZE_MIN_CHILD_PAGES \
+	((BlockNumber) ((8 * 1024 * 1024) / BLCKSZ))
+
+/* DSM keys for parallel sampling of inheritance children */
+#define PARALLEL_KEY_ANALYZE_SHARED		UINT64CONST(0xE000000000000001)
+#define PARALLEL_KEY_ANALYZE_QUEUES		UINT64CONST(0xE000000000000002)
+
+/* Size of each worker's queue of sample rows */
+#define PARALLEL_ANALYZE_QUEUE_SIZE		65536
+
+/*
+ * Shared state of a parallel sampling of inheritance children.  The
+ * AnlSharedChild array follows the struct; a child's counts are written by
+ * whoever samples it.
+ */
+typedef struct AnlSharedChild
+{
+	Oid			relid;			/* child to sample */
+	int			targrows;		/* rows to sample from it */
+	int			numrows;		/* rows actually sampled */
+	double		totalrows;		/* its estimated live rows */
+	double		totaldeadrows;	/* its estimated dead rows */
+} AnlSharedChild;
+
+typedef struct AnlShared
+{
+	int			elevel;
+	int			cost_delay;		/* cost-based delay settings of the leader */
+	int			cost_limit;
+	int			nchildren;
+	pg_atomic_uint32 nextchild; /* next child to hand out */
+} AnlShared;
+
+#define AnlSharedChildAt(shared, i) \
+	((AnlSharedChild *) ((char *) (shared) + MAXALIGN(sizeof(AnlShared))) + (i))
+
+/* Header of a sample row sent from a worker to the leader */
+typedef struct AnlRowHeader
+{
+	int			child;			/* index of the child in the shared array */
+	ItemPointerData t_self;
+	Oid			t_tableOid;
+} AnlRowHeader;
+
+/* Where the leader puts the sample rows the workers send */
+typedef struct AnlReceiveState
+{
+	HeapTuple  *rows;
+	int		   *childtargrows;
+	int		   *childoffsets;
+	int		   *sharedrels;		/* index in rels[] of each shared child */
+	int		   *received;		/* rows received of each, -1 if sampled here */
+} AnlReceiveState;
+
+/* Can this child be sampled by a parallel worker? */
+#define ANALYZE_CHILD_IS_SHAREABLE(rel, acquirefunc, targrows) \
+	((acquirefunc) == acquire_sample_rows && \
+	 !RelationUsesLocalBuffers(rel) && (targrows) > 0)
+
 /* Per-index data for ANALYZE */
 typedef struct AnlIndexData
 {
@@ -85,13 +155,24 @@ static void compute_index_stats(Relation onerel, double totalrows,
 					MemoryContext col_context);
 static VacAttrStats *examine_attribute(Relation onerel, int attnum,
 				  Node *index_expr);
-static int acquire_sample_rows(Relation onerel, int elevel,
-					HeapTuple *rows, int targrows,
-					double *totalrows, double *totaldeadrows);
+static BlockNumber analyze_stream_next_block(ReadStream *stream,
+						  void *callback_private_data,
+						  void *per_buffer_data);
 static int	compare_rows(const void *a, const void *b);
 static int acquire_inherited_sample_rows(Relation onerel, int elevel,
 							  HeapTuple *rows, int targrows,
-							  double *totalrows, double *totaldeadrows);
+							  double *totalrows, double *totaldeadrows,
+							  int nworkers);
+static int analyze_parallel_workers(Relation *rels,
+						 AcquireSampleRowsFunc *acquirefuncs,
+						 int *childtargrows, int nrels, int nrequested);
+static void analyze_parallel_sample(Relation *rels,
+						AcquireSampleRowsFunc *acquirefuncs,
+						int nrels, int elevel, HeapTuple *rows,
+						int *childtargrows, int *childoffsets,
+						int *childrows, double *childtotalrows,
+						double *childdeadrows, int nworkers);
+static void analyze_parallel_receive(void *arg, Size nbytes, void *data);
 static void update_attstats(Oid relid, bool inh,
 				int natts, VacAttrStats **vacattrstats);
 static Datum std_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull);
@@ -203,10 +284,18 @@ analyze_rel(Oid relid, RangeVar *relation, int options,
 	if (onerel->rd_rel->relkind == RELKIND_RELATION ||
 		onerel->rd_rel->relkind == RELKIND_MATVIEW)
 	{
-		/* Regular table, so we'll use the regular row acquisition function */
-		acquirefunc = acquire_sample_rows;
-		/* Also get regular table's size */
-		relpages = RelationGetNumberOfBlocks(onerel);
+		/*
+		 * Regular table, so ask its access method for the row acquisition
+		 * function and the table's size.
+		 */
+		if (!table_analyze(onerel, &acquirefunc, &relpages))
+		{
+			ereport(WARNING,
+					(errmsg("skipping \"%s\" --- its access method does not support ANALYZE",
+							RelationGetRelationName(onerel))));
+			relation_close(onerel, ShareUpdateExclusiveLock);
+			return;
+		}
 	}
 	else if (onerel->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
 	{
@@ -485,7 +574,8 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	if (inh)
 		numrows = acquire_inherited_sample_rows(onerel, elevel,
 												rows, targrows,
-												&totalrows, &totaldeadrows);
+												&totalrows, &totaldeadrows,
+												params->nworkers);
 	else
 		numrows = (*acquirefunc) (onerel, elevel,
 								  rows, targrows,
@@ -562,6 +652,13 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 			update_attstats(RelationGetRelid(Irel[ind]), false,
 							thisdata->attr_cnt, thisdata->vacattrstats);
 		}
+
+		/*
+		 * Build extended statistics (if there are any).  Like the table-wide
+		 * counts, they describe the table itself, not an inheritance tree.
+		 */
+		if (!inh)
+			BuildRelationExtStatistics(onerel, totalrows, numrows, rows);
 	}
 
 	/*
@@ -569,14 +666,20 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	 * inherited stats.
 	 */
 	if (!inh)
+	{
+		BlockNumber relallvisible;
+
+		visibilitymap_count(onerel, &relallvisible, NULL);
+
 		vac_update_relstats(onerel,
 							relpages,
 							totalrows,
-							visibilitymap_count(onerel),
+							relallvisible,
 							hasindex,
 							InvalidTransactionId,
 							InvalidMultiXactId,
 							in_outer_xact);
+	}
 
 	/*
 	 * Same for indexes. Vacuum always scans all indexes, so if we're part of
@@ -936,6 +1039,20 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
 	return stats;
 }
 
+/*
+ * Read stream callback of acquire_sample_rows: the next block to sample
+ */
+static BlockNumber
+analyze_stream_next_block(ReadStream *stream, void *callback_private_data,
+						  void *per_buffer_data)
+{
+	BlockSampler bs = (BlockSampler) callback_private_data;
+
+	if (!BlockSampler_HasMore(bs))
+		return InvalidBlockNumber;
+	return BlockSampler_Next(bs);
+}
+
 /*
  * acquire_sample_rows -- acquire a random sample of rows from the table
  *
@@ -968,8 +1085,10 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
  * unbiased estimates of the average numbers of live and dead rows per
  * block.  The previous sampling method put too much credence in the row
  * density near the start of the table.
+ *
+ * This is the sampling function of the heap table access method.
  */
-static int
+int
 acquire_sample_rows(Relation onerel, int elevel,
 					HeapTuple *rows, int targrows,
 					double *totalrows, double *totaldeadrows)
@@ -983,6 +1102,12 @@ acquire_sample_rows(Relation onerel, int elevel,
 	TransactionId OldestXmin;
 	BlockSamplerData bs;
 	ReservoirStateData rstate;
+	ReadStream *stream;
+	Buffer		targbuffer;
+#ifdef USE_PREFETCH
+	BlockSamplerData prefetch_bs;
+	int			prefetch_pages = 0;
+#endif
 
 	Assert(targrows > 0);
 
@@ -996,28 +1121,59 @@ acquire_sample_rows(Relation onerel, int elevel,
 	/* Prepare for sampling rows */
 	reservoir_init_selection_state(&rstate, targrows);
 
+	/*
+	 * The sampled blocks are read through a read stream, which asks the
+	 * block sampler for them some way ahead of us.  The blocks are scattered
+	 * over the table, so the kernel's readahead does nothing for them; to
+	 * keep the disks busy, a second sampler with the same seed, and so the
+	 * same sequence of blocks, runs up to target_prefetch_pages blocks ahead
+	 * of the first and prefetches them, as a bitmap heap scan does.
+	 */
+	stream = read_stream_begin_relation(onerel, MAIN_FORKNUM, vac_strategy,
+										analyze_stream_next_block, &bs, 0);
+#ifdef USE_PREFETCH
+	prefetch_bs = bs;
+#endif
+
 	/* Outer loop over blocks to sample */
-	while (BlockSampler_HasMore(&bs))
+	while (BufferIsValid(targbuffer = read_stream_next_buffer(stream, NULL)))
 	{
-		BlockNumber targblock = BlockSampler_Next(&bs);
-		Buffer		targbuffer;
+		BlockNumber targblock = BufferGetBlockNumber(targbuffer);
 		Page		targpage;
 		OffsetNumber targoffset,
 					maxoffset;
 
+#ifdef USE_PREFETCH
+		if (target_prefetch_pages > 0)
+		{
+			/* don't let the prefetch sampler fall behind this block */
+			if (prefetch_pages > 0)
+				prefetch_pages--;
+			else if (BlockSampler_HasMore(&prefetch_bs))
+				(void) BlockSampler_Next(&prefetch_bs);
+
+			while (prefetch_pages < target_prefetch_pages &&
+				   BlockSampler_HasMore(&prefetch_bs))
+			{
+				PrefetchBuffer(onerel, MAIN_FORKNUM,
+							   BlockSampler_Next(&prefetch_bs));
+				prefetch_pages++;
+			}
+		}
+#endif   /* USE_PREFETCH */
+
 		vacuum_delay_point();
 
 		/*
 		 * We must maintain a pin on the target page's buffer to ensure that
 		 * the maxoffset value stays good (else concurrent VACUUM might delete
-		 * tuples out from under us).  Hence, pin the page until we are done
-		 * looking at it.  We also choose to hold sharelock on the buffer
-		 * throughout --- we could release and re-acquire sharelock for each
-		 * tuple, but since we aren't doing much work per tuple, the extra
-		 * lock traffic is probably better avoided.
+		 * tuples out from under us).  The read stream hands us the page
+		 * pinned, and we keep the pin until we are done looking at it.  We
+		 * also choose to hold sharelock on the buffer throughout --- we could
+		 * release and re-acquire sharelock for each tuple, but since we
+		 * aren't doing much work per tuple, the extra lock traffic is
+		 * probably better avoided.
 		 */
-		targbuffer = ReadBufferExtended(onerel, MAIN_FORKNUM, targblock,
-										RBM_NORMAL, vac_strategy);
 		LockBuffer(targbuffer, BUFFER_LOCK_SHARE);
 		targpage = BufferGetPage(targbuffer);
 		maxoffset = PageGetMaxOffsetNumber(targpage);
@@ -1168,6 +1324,8 @@ acquire_sample_rows(Relation onerel, int elevel,
 		UnlockReleaseBuffer(targbuffer);
 	}
 
+	read_stream_end(stream);
+
 	/*
 	 * If we didn't find as many tuples as we wanted then we're done. No sort
 	 * is needed, since they're already in order.
@@ -1240,18 +1398,26 @@ compare_rows(const void *a, const void *b)
  * This has the same API as acquire_sample_rows, except that rows are
  * collected from all inheritance children as well as the specified table.
  * We fail and return zero if there are no inheritance children, or if all
- * children are foreign tables that don't support ANALYZE.
+ * children are foreign tables that don't support ANALYZE.  nworkers is the
+ * number of parallel workers asked for to sample the children, -1 to choose
+ * automatically.
  */
 static int
 acquire_inherited_sample_rows(Relation onerel, int elevel,
 							  HeapTuple *rows, int targrows,
-							  double *totalrows, double *totaldeadrows)
+							  double *totalrows, double *totaldeadrows,
+							  int nworkers)
 {
 	List	   *tableOIDs;
 	Relation   *rels;
 	AcquireSampleRowsFunc *acquirefuncs;
 	double	   *relblocks;
 	double		totalblocks;
+	int		   *childtargrows;
+	int		   *childoffsets;
+	int		   *childrows;
+	double	   *childtotalrows;
+	double	   *childdeadrows;
 	int			numrows,
 				nrels,
 				i;
@@ -1316,9 +1482,14 @@ acquire_inherited_sample_rows(Relation onerel, int elevel,
 		if (childrel->rd_rel->relkind == RELKIND_RELATION ||
 			childrel->rd_rel->relkind == RELKIND_MATVIEW)
 		{
-			/* Regular table, so use the regular row acquisition function */
-			acquirefunc = acquire_sample_rows;
-			relpages = RelationGetNumberOfBlocks(childrel);
+			/* Regular table, so ask its access method how to sample it */
+			if (!table_analyze(childrel, &acquirefunc, &relpages))
+			{
+				/* ignore, but release the lock on it */
+				Assert(childrel != onerel);
+				heap_close(childrel, AccessShareLock);
+				continue;
+			}
 		}
 		else if (childrel->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
 		{
@@ -1373,70 +1544,98 @@ acquire_inherited_sample_rows(Relation onerel, int elevel,
 	}
 
 	/*
-	 * Now sample rows from each relation, proportionally to its fraction of
-	 * the total block count.  (This might be less than desirable if the child
-	 * rels have radically different free-space percentages, but it's not
-	 * clear that it's worth working harder.)
+	 * Now decide how many rows to sample from each relation, proportionally
+	 * to its fraction of the total block count.  (This might be less than
+	 * desirable if the child rels have radically different free-space
+	 * percentages, but it's not clear that it's worth working harder.)  Each
+	 * child's rows go to its own stretch of rows[], so that the children can
+	 * be sampled in any order; we close up the gaps afterwards.
 	 */
+	childtargrows = (int *) palloc(nrels * sizeof(int));
+	childoffsets = (int *) palloc(nrels * sizeof(int));
+	childrows = (int *) palloc0(nrels * sizeof(int));
+	childtotalrows = (double *) palloc0(nrels * sizeof(double));
+	childdeadrows = (double *) palloc0(nrels * sizeof(double));
+	numrows = 0;
+	for (i = 0; i < nrels; i++)
+	{
+		int			childtarg = 0;
+
+		if (relblocks[i] > 0)
+		{
+			childtarg = (int) rint(targrows * relblocks[i] / totalblocks);
+			/* Make sure we don't overrun due to roundoff error */
+			childtarg = Min(childtarg, targrows - numrows);
+		}
+		childtargrows[i] = childtarg;
+		childoffsets[i] = numrows;
+		numrows += childtarg;
+	}
+
+	nworkers = analyze_parallel_workers(rels, acquirefuncs, childtargrows,
+										nrels, nworkers);
+	if (nworkers > 0)
+		analyze_parallel_sample(rels, acquirefuncs, nrels, elevel, rows,
+								childtargrows, childoffsets, childrows,
+								childtotalrows, childdeadrows, nworkers);
+	else
+	{
+		for (i = 0; i < nrels; i++)
+		{
+			/* Fetch a random sample of the child's rows */
+			if (childtargrows[i] > 0)
+				childrows[i] = (*acquirefuncs[i]) (rels[i], elevel,
+												   rows + childoffsets[i],
+												   childtargrows[i],
+												   &childtotalrows[i],
+												   &childdeadrows[i]);
+		}
+	}
+
 	numrows = 0;
 	*totalrows = 0;
 	*totaldeadrows = 0;
 	for (i = 0; i < nrels; i++)
 	{
 		Relation	childrel = rels[i];
-		AcquireSampleRowsFunc acquirefunc = acquirefuncs[i];
-		double		childblocks = relblocks[i];
 
-		if (childblocks > 0)
+		if (childrows[i] > 0)
 		{
-			int			childtargrows;
-
-			childtargrows = (int) rint(targrows * childblocks / totalblocks);
-			/* Make sure we don't overrun due to roundoff error */
-			childtargrows = Min(childtargrows, targrows - numrows);
-			if (childtargrows > 0)
+			/* Close up the gap left by the children before this one */
+			if (childoffsets[i] != numrows)
+				memmove(rows + numrows, rows + childoffsets[i],
+						childrows[i] * sizeof(HeapTuple));
+
+			/* We may need to convert from child's rowtype to parent's */
+			if (!equalTupleDescs(RelationGetDescr(childrel),
+								 RelationGetDescr(onerel)))
 			{
-				int			childrows;
-				double		trows,
-							tdrows;
-
-				/* Fetch a random sample of the child's rows */
-				childrows = (*acquirefunc) (childrel, elevel,
-											rows + numrows, childtargrows,
-											&trows, &tdrows);
-
-				/* We may need to convert from child's rowtype to parent's */
-				if (childrows > 0 &&
-					!equalTupleDescs(RelationGetDescr(childrel),
-									 RelationGetDescr(onerel)))
-				{
-					TupleConversionMap *map;
+				TupleConversionMap *map;
 
-					map = convert_tuples_by_name(RelationGetDescr(childrel),
-												 RelationGetDescr(onerel),
+				map = convert_tuples_by_name(RelationGetDescr(childrel),
+											 RelationGetDescr(onerel),
 								 gettext_noop("could not convert row type"));
-					if (map != NULL)
-					{
-						int			j;
+				if (map != NULL)
+				{
+					int			j;
 
-						for (j = 0; j < childrows; j++)
-						{
-							HeapTuple	newtup;
+					for (j = 0; j < childrows[i]; j++)
+					{
+						HeapTuple	newtup;
 
-							newtup = do_convert_tuple(rows[numrows + j], map);
-							heap_freetuple(rows[numrows + j]);
-							rows[numrows + j] = newtup;
-						}
-						free_conversion_map(map);
+						newtup = do_convert_tuple(rows[numrows + j], map);
+						heap_freetuple(rows[numrows + j]);
+						rows[numrows + j] = newtup;
 					}
+					free_conversion_map(map);
 				}
-
-				/* And add to counts */
-				numrows += childrows;
-				*totalrows += trows;
-				*totaldeadrows += tdrows;
 			}
+
+			/* And add to counts */
+			numrows += childrows[i];
 		}
+		*totalrows += childtotalrows[i];
+		*totaldeadrows += childdeadrows[i];
 
 		/*
 		 * Note: we cannot release the child-table locks, since we may have
@@ -1448,6 +1647,346 @@ acquire_inherited_sample_rows(Relation onerel, int elevel,
 	return numrows;
 }
 
+/*
+ * analyze_parallel_workers() -- choose the number of workers to sample the
+ *		children of an inheritance tree with, or zero to sample them serially.
+ *
+ *		Only children that the heap AM samples can be handed to a worker;
+ *		other sampling functions, an FDW's above all, need not be parallel
+ *		safe, and temp tables live in our local buffers.  nrequested is the
+ *		PARALLEL option of VACUUM, or -1 if none was given.  We never need
+ *		more workers than there are such children besides the one we take
+ *		ourselves.
+ */
+static int
+analyze_parallel_workers(Relation *rels, AcquireSampleRowsFunc *acquirefuncs,
+						 int *childtargrows, int nrels, int nrequested)
+{
+	int			nshared = 0;
+	int			nlarge = 0;
+	int			nworkers;
+	int			i;
+
+	if (nrequested == 0 ||
+		max_parallel_maintenance_workers == 0 ||
+		!IsUnderPostmaster ||
+		!ActiveSnapshotSet() ||
+		IsInParallelMode() ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
+
+	for (i = 0; i < nrels; i++)
+	{
+		if (!ANALYZE_CHILD_IS_SHAREABLE(rels[i], acquirefuncs[i],
+										childtargrows[i]))
+			continue;
+		nshared++;
+		if (RelationGetNumberOfBlocks(rels[i]) >=
+			PARALLEL_ANALYZE_MIN_CHILD_PAGES)
+			nlarge++;
+	}
+
+	/* one worker for each child that's big enough to be worth it */
+	nworkers = (nrequested > 0) ? nrequested : nlarge;
+	nworkers = Min(nworkers, nshared - 1);
+	nworkers = Min(nworkers, max_parallel_maintenance_workers);
+
+	return Max(nworkers, 0);
+}
+
+/*
+ * analyze_parallel_sample() -- sample the children of an inheritance tree
+ *		with the help of nworkers parallel workers.
+ *
+ *		The children that analyze_parallel_workers deems shareable are handed
+ *		out from shared->nextchild to the workers and to us alike; we sample
+ *		the others ourselves first.  A worker sends the rows it sampled from
+ *		a child through its queue, and we put them where the serial code
+ *		would have, so the results are filled in just the same.  We have to
+ *		keep draining the queues while we sample, or a worker with a full
+ *		queue could not go on to its next child; and we must wait for the
+ *		workers before relying on any result, as a worker that fails just
+ *		stops sending.
+ */
+static void
+analyze_parallel_sample(Relation *rels, AcquireSampleRowsFunc *acquirefuncs,
+						int nrels, int elevel, HeapTuple *rows,
+						int *childtargrows, int *childoffsets,
+						int *childrows, double *childtotalrows,
+						double *childdeadrows, int nworkers)
+{
+	ParallelContext *pcxt;
+	AnlShared  *shared;
+	char	   *queuespace;
+	shm_mq_handle **queues;
+	int			nqueues;
+	int		   *sharedrels;
+	int		   *received;
+	AnlReceiveState rstate;
+	int			nshared = 0;
+	int			saved_cost_limit = VacuumCostLimit;
+	int			i;
+
+	sharedrels = (int *) palloc(nrels * sizeof(int));
+	for (i = 0; i < nrels; i++)
+	{
+		if (ANALYZE_CHILD_IS_SHAREABLE(rels[i], acquirefuncs[i],
+									   childtargrows[i]))
+			sharedrels[nshared++] = i;
+	}
+	received = (int *) palloc0(nshared * sizeof(int));
+
+	rstate.rows = rows;
+	rstate.childtargrows = childtargrows;
+	rstate.childoffsets = childoffsets;
+	rstate.sharedrels = sharedrels;
+	rstate.received = received;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(analyze_parallel_sample_main, nworkers);
+
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   add_size(MAXALIGN(sizeof(AnlShared)),
+									mul_size(sizeof(AnlSharedChild),
+											 nshared)));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	EstimateParallelQueues(pcxt, PARALLEL_ANALYZE_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (AnlShared *)
+		shm_toc_allocate(pcxt->toc,
+						 add_size(MAXALIGN(sizeof(AnlShared)),
+								  mul_size(sizeof(AnlSharedChild), nshared)));
+	shared->elevel = elevel;
+	shared->cost_delay = VacuumCostDelay;
+	shared->cost_limit = Max(VacuumCostLimit / (nworkers + 1), 1);
+	shared->nchildren = nshared;
+	pg_atomic_init_u32(&shared->nextchild, 0);
+	for (i = 0; i < nshared; i++)
+	{
+		AnlSharedChild *child = AnlSharedChildAt(shared, i);
+
+		child->relid = RelationGetRelid(rels[sharedrels[i]]);
+		child->targrows = childtargrows[sharedrels[i]];
+		child->numrows = 0;
+		child->totalrows = 0;
+		child->totaldeadrows = 0;
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_ANALYZE_SHARED, shared);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_ANALYZE_QUEUES,
+										  PARALLEL_ANALYZE_QUEUE_SIZE, false);
+
+	LaunchParallelWorkers(pcxt);
+
+	queues = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	nqueues = AttachParallelQueues(pcxt, queuespace,
+								   PARALLEL_ANALYZE_QUEUE_SIZE, queues, NULL);
+
+	/* VacuumCostLimit may be a GUC variable, so put it back come what may */
+	PG_TRY();
+	{
+		if (VacuumCostActive)
+			VacuumCostLimit = shared->cost_limit;
+
+		/* Sample the children no worker can take */
+		for (i = 0; i < nrels; i++)
+		{
+			if (childtargrows[i] > 0 &&
+				!ANALYZE_CHILD_IS_SHAREABLE(rels[i], acquirefuncs[i],
+											childtargrows[i]))
+			{
+				childrows[i] = (*acquirefuncs[i]) (rels[i], elevel,
+												   rows + childoffsets[i],
+												   childtargrows[i],
+												   &childtotalrows[i],
+												   &childdeadrows[i]);
+				ReceiveFromParallelQueues(queues, &nqueues, true,
+										  analyze_parallel_receive, &rstate,
+										  WAIT_EVENT_MQ_RECEIVE);
+			}
+		}
+
+		/* Then help the workers with the shared ones */
+		for (;;)
+		{
+			uint32		idx = pg_atomic_fetch_add_u32(&shared->nextchild, 1);
+			int			relidx;
+
+			if (idx >= (uint32) nshared)
+				break;
+
+			relidx = sharedrels[idx];
+			childrows[relidx] = acquire_sample_rows(rels[relidx], elevel,
+													rows + childoffsets[relidx],
+													childtargrows[relidx],
+													&childtotalrows[relidx],
+													&childdeadrows[relidx]);
+			received[idx] = -1;		/* not to be sent by anyone */
+			ReceiveFromParallelQueues(queues, &nqueues, true,
+									  analyze_parallel_receive, &rstate,
+									  WAIT_EVENT_MQ_RECEIVE);
+		}
+
+		/* Collect whatever the workers have yet to send */
+		ReceiveFromParallelQueues(queues, &nqueues, false,
+								  analyze_parallel_receive, &rstate,
+								  WAIT_EVENT_MQ_RECEIVE);
+
+		/* This rethrows any error a worker ran into */
+		WaitForParallelWorkersToFinish(pcxt);
+	}
+	PG_CATCH();
+	{
+		VacuumCostLimit = saved_cost_limit;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	VacuumCostLimit = saved_cost_limit;
+
+	/* Pick up the results of the children the workers sampled */
+	for (i = 0; i < nshared; i++)
+	{
+		AnlSharedChild *child = AnlSharedChildAt(shared, i);
+		int			relidx = sharedrels[i];
+
+		if (received[i] < 0)
+			continue;
+		if (received[i] != child->numrows)
+			elog(ERROR, "parallel ANALYZE worker sent %d of %d sample rows of \"%s\"",
+				 received[i], child->numrows,
+				 RelationGetRelationName(rels[relidx]));
+		childrows[relidx] = child->numrows;
+		childtotalrows[relidx] = child->totalrows;
+		childdeadrows[relidx] = child->totaldeadrows;
+	}
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	pfree(queues);
+	pfree(received);
+	pfree(sharedrels);
+}
+
+/*
+ * analyze_parallel_receive() -- store a sample row a worker has sent.
+ *
+ *		arg is the AnlReceiveState of analyze_parallel_sample.
+ */
+static void
+analyze_parallel_receive(void *arg, Size nbytes, void *data)
+{
+	AnlReceiveState *rstate = (AnlReceiveState *) arg;
+	AnlRowHeader *hdr = (AnlRowHeader *) data;
+	int		   *received = rstate->received;
+	HeapTuple	tuple;
+	int			relidx;
+
+	relidx = rstate->sharedrels[hdr->child];
+	if (received[hdr->child] < 0 ||
+		received[hdr->child] >= rstate->childtargrows[relidx])
+		elog(ERROR, "unexpected sample row from parallel ANALYZE worker");
+
+	tuple = (HeapTuple) palloc(HEAPTUPLESIZE + nbytes -
+							   MAXALIGN(sizeof(AnlRowHeader)));
+	tuple->t_len = nbytes - MAXALIGN(sizeof(AnlRowHeader));
+	tuple->t_self = hdr->t_self;
+	tuple->t_tableOid = hdr->t_tableOid;
+	tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
+	memcpy(tuple->t_data,
+		   (char *) data + MAXALIGN(sizeof(AnlRowHeader)),
+		   tuple->t_len);
+
+	rstate->rows[rstate->childoffsets[relidx] + received[hdr->child]] = tuple;
+	received[hdr->child]++;
+}
+
+/*
+ * analyze_parallel_sample_main
+ *
+ * Entry point of a parallel ANALYZE worker: sample the children handed out
+ * from shared->nextchild until there are none left, and send each child's
+ * rows to the leader.
+ */
+void
+analyze_parallel_sample_main(dsm_segment *seg, shm_toc *toc)
+{
+	AnlShared  *shared;
+	char	   *queuespace;
+	shm_mq_handle *mqh;
+
+	shared = (AnlShared *) shm_toc_lookup(toc, PARALLEL_KEY_ANALYZE_SHARED);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_ANALYZE_QUEUES);
+	if (shared == NULL || queuespace == NULL)
+		elog(ERROR, "invalid parallel ANALYZE state");
+
+	mqh = AttachParallelLeaderQueue(seg, queuespace,
+									PARALLEL_ANALYZE_QUEUE_SIZE, false);
+
+	vac_strategy = GetAccessStrategy(BAS_VACUUM);
+
+	/* autovacuum's delay settings aren't GUCs, so take them from the leader */
+	VacuumCostDelay = shared->cost_delay;
+	VacuumCostLimit = shared->cost_limit;
+	VacuumCostActive = (VacuumCostDelay > 0);
+	VacuumCostBalance = 0;
+	VacuumPageHit = 0;
+	VacuumPageMiss = 0;
+	VacuumPageDirty = 0;
+
+	for (;;)
+	{
+		uint32		idx = pg_atomic_fetch_add_u32(&shared->nextchild, 1);
+		AnlSharedChild *child;
+		Relation	childrel;
+		HeapTuple  *rows;
+		int			numrows;
+		int			i;
+
+		if (idx >= (uint32) shared->nchildren)
+			break;
+		child = AnlSharedChildAt(shared, idx);
+
+		/* The leader holds the locks for us, see lazy_parallel_vacuum_main */
+		childrel = heap_open(child->relid, NoLock);
+
+		rows = (HeapTuple *) palloc(child->targrows * sizeof(HeapTuple));
+		numrows = acquire_sample_rows(childrel, shared->elevel,
+									  rows, child->targrows,
+									  &child->totalrows,
+									  &child->totaldeadrows);
+		child->numrows = numrows;
+
+		for (i = 0; i < numrows; i++)
+		{
+			char		header[MAXALIGN(sizeof(AnlRowHeader))];
+			AnlRowHeader *hdr = (AnlRowHeader *) header;
+			shm_mq_iovec iov[2];
+
+			memset(header, 0, sizeof(header));
+			hdr->child = (int) idx;
+			hdr->t_self = rows[i]->t_self;
+			hdr->t_tableOid = rows[i]->t_tableOid;
+			iov[0].data = header;
+			iov[0].len = sizeof(header);
+			iov[1].data = (const char *) rows[i]->t_data;
+			iov[1].len = rows[i]->t_len;
+			if (shm_mq_sendv(mqh, iov, 2, false) != SHM_MQ_SUCCESS)
+				ereport(ERROR,
+						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+						 errmsg("could not send sample rows to parallel leader")));
+			heap_freetuple(rows[i]);
+		}
+
+		pfree(rows);
+		heap_close(childrel, NoLock);
+	}
+
+	FreeAccessStrategy(vac_strategy);
+}
+
 
 /*
  *	update_attstats() -- update attribute statistics for one relation
@@ -24,8 +24,12 @@
  *	  All notification messages are placed in the queue and later read out
  *	  by listening backends.
  *
- *	  There is no central knowledge of which backend listens on which channel;
- *	  every backend has its own list of interesting channels.
+ *	  Every backend has its own list of interesting channels.  The only
+ *	  central knowledge of which backend listens on which channel is a
+ *	  small bitmap per listening backend, with one bit set for each hash
+ *	  value (modulo the bitmap size) of the names it listens on; it tells
+ *	  a notifying backend which listeners can't be interested in its
+ *	  notifications.
  *
  *	  Although there is only one queue, notifications are treated as being
  *	  database-local; this is done by including the sender's database OID
@@ -73,10 +77,13 @@
  *	  Finally, after we are out of the transaction altogether, we check if
  *	  we need to signal listening backends.  In SignalBackends() we scan the
  *	  list of listening backends and send a PROCSIG_NOTIFY_INTERRUPT signal
- *	  to every listening backend (we don't know which backend is listening on
- *	  which channel so we must signal them all). We can exclude backends that
- *	  are already up to date, though.  We don't bother with a self-signal
- *	  either, but just process the queue directly.
+ *	  to each backend in our database whose channel bitmap shares a bit with
+ *	  the channels we notified.  Other listeners have nothing to read in our
+ *	  notifications, but their queue positions must still advance so that
+ *	  the queue can be truncated; so a listener that has fallen more than
+ *	  QUEUE_CLEANUP_DELAY pages behind the head is signaled anyway.  We can
+ *	  exclude backends that are already up to date.  We don't bother with a
+ *	  self-signal either, but just process the queue directly.
  *
  * 5. Upon receipt of a PROCSIG_NOTIFY_INTERRUPT signal, the signal handler
  *	  sets the process's latch, which triggers the event to be processed
@@ -104,7 +111,7 @@
  * frontend during startup.)  The above design guarantees that notifies from
  * other backends will never be missed by ignoring self-notifies.
  *
- * The amount of shared memory used for notify management (NUM_ASYNC_BUFFERS)
+ * The amount of shared memory used for notify management (notify_buffers)
  * can be varied without affecting anything but performance.  The maximum
  * amount of notification data that can be queued at one time is determined
  * by slru.c's wraparound limit; see QUEUE_MAX_PAGE below.
@@ -134,6 +141,7 @@
 #include "storage/sinval.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
+#include "utils/hsearch.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/timestamp.h"
@@ -230,6 +238,7 @@ typedef struct QueueBackendStatus
 	int32		pid;			/* either a PID or InvalidPid */
 	Oid			dboid;			/* backend's database OID, or InvalidOid */
 	QueuePosition pos;			/* backend has read queue up to here */
+	uint64		channels;		/* bitmap of hashes of channels listened on */
 } QueueBackendStatus;
 
 /*
@@ -270,6 +279,11 @@ static AsyncQueueControl *asyncQueueControl;
 #define QUEUE_BACKEND_PID(i)		(asyncQueueControl->backend[i].pid)
 #define QUEUE_BACKEND_DBOID(i)		(asyncQueueControl->backend[i].dboid)
 #define QUEUE_BACKEND_POS(i)		(asyncQueueControl->backend[i].pos)
+#define QUEUE_BACKEND_CHANNELS(i)	(asyncQueueControl->backend[i].channels)
+
+/* Bit of a channel bitmap for a channel name */
+#define CHANNEL_HASH_BIT(channel) \
+	((uint64) 1 << (string_hash((channel), NAMEDATALEN) % 64))
 
 /*
  * The SLRU buffer area through which we access the notification queue
@@ -280,6 +294,13 @@ static SlruCtlData AsyncCtlData;
 #define QUEUE_PAGESIZE				BLCKSZ
 #define QUEUE_FULL_WARN_INTERVAL	5000		/* warn at most once every 5s */
 
+/*
+ * A listener that isn't interested in the notifications being sent is only
+ * signaled once it is this many pages behind the queue head, so that it
+ * reads past (and lets us truncate) the notifications in between.
+ */
+#define QUEUE_CLEANUP_DELAY			4
+
 /*
  * slru.c currently assumes that all filenames are four characters of hex
  * digits. That means that we can use segments 0000 through FFFF.
@@ -377,18 +398,23 @@ static bool amRegisteredListener = false;
 /* has this backend sent notifications in the current transaction? */
 static bool backendHasSentNotifications = false;
 
-/* GUC parameter */
+/* bitmap of the channels it sent them on, for SignalBackends */
+static uint64 sentNotifyChannels = 0;
+
+/* GUC parameters */
 bool		Trace_notify = false;
+int			notify_buffers = 16;
 
 /* local function prototypes */
 static bool asyncQueuePagePrecedes(int p, int q);
 static void queue_listen(ListenActionKind action, const char *channel);
 static void Async_UnlistenOnExit(int code, Datum arg);
-static void Exec_ListenPreCommit(void);
+static void Exec_ListenPreCommit(const char *channel);
 static void Exec_ListenCommit(const char *channel);
 static void Exec_UnlistenCommit(const char *channel);
 static void Exec_UnlistenAllCommit(void);
 static bool IsListeningOn(const char *channel);
+static void asyncQueuePublishChannels(void);
 static void asyncQueueUnregister(void);
 static bool asyncQueueIsFull(void);
 static bool asyncQueueAdvance(volatile QueuePosition *position, int entryLength);
@@ -443,7 +469,7 @@ AsyncShmemSize(void)
 	size = mul_size(MaxBackends + 1, sizeof(QueueBackendStatus));
 	size = add_size(size, offsetof(AsyncQueueControl, backend));
 
-	size = add_size(size, SimpleLruShmemSize(NUM_ASYNC_BUFFERS, 0));
+	size = add_size(size, SimpleLruShmemSize(notify_buffers, 0));
 
 	return size;
 }
@@ -484,6 +510,7 @@ AsyncShmemInit(void)
 			QUEUE_BACKEND_PID(i) = InvalidPid;
 			QUEUE_BACKEND_DBOID(i) = InvalidOid;
 			SET_QUEUE_POS(QUEUE_BACKEND_POS(i), 0, 0);
+			QUEUE_BACKEND_CHANNELS(i) = 0;
 		}
 	}
 
@@ -491,7 +518,7 @@ AsyncShmemInit(void)
 	 * Set up SLRU management of the pg_notify data.
 	 */
 	AsyncCtl->PagePrecedes = asyncQueuePagePrecedes;
-	SimpleLruInit(AsyncCtl, "Async Ctl", NUM_ASYNC_BUFFERS, 0,
+	SimpleLruInit(AsyncCtl, "Async Ctl", notify_buffers, 0,
 				  AsyncCtlLock, "pg_notify");
 	/* Override default assumption that writes should be fsync'd */
 	AsyncCtl->do_fsync = false;
@@ -649,6 +676,9 @@ Async_Listen(const char *channel)
 	if (Trace_notify)
 		elog(DEBUG1, "Async_Listen(%s,%d)", channel, MyProcPid);
 
+	/* notifications must reach this session, on this backend */
+	PinPooledSession("LISTEN");
+
 	queue_listen(LISTEN_LISTEN, channel);
 }
 
@@ -799,7 +829,7 @@ PreCommit_Notify(void)
 		switch (actrec->action)
 		{
 			case LISTEN_LISTEN:
-				Exec_ListenPreCommit();
+				Exec_ListenPreCommit(actrec->channel);
 				break;
 			case LISTEN_UNLISTEN:
 				/* there is no Exec_UnlistenPreCommit() */
@@ -844,6 +874,12 @@ PreCommit_Notify(void)
 
 		/* Now push the notifications into the queue */
 		backendHasSentNotifications = true;
+		foreach(p, pendingNotifies)
+		{
+			Notification *n = (Notification *) lfirst(p);
+
+			sentNotifyChannels |= CHANNEL_HASH_BIT(n->channel);
+		}
 
 		nextNotify = list_head(pendingNotifies);
 		while (nextNotify != NULL)
@@ -916,6 +952,8 @@ AtCommit_Notify(void)
 	/* If no longer listening to anything, get out of listener array */
 	if (amRegisteredListener && listenChannels == NIL)
 		asyncQueueUnregister();
+	else if (amRegisteredListener && pendingActions != NIL)
+		asyncQueuePublishChannels();
 
 	/* And clean up */
 	ClearPendingActionsAndNotifies();
@@ -925,20 +963,28 @@ AtCommit_Notify(void)
  * Exec_ListenPreCommit --- subroutine for PreCommit_Notify
  *
  * This function must make sure we are ready to catch any incoming messages.
+ * That includes adding the channel to our bitmap before we commit, so that
+ * any transaction that notifies it after our commit will signal us.
  */
 static void
-Exec_ListenPreCommit(void)
+Exec_ListenPreCommit(const char *channel)
 {
 	QueuePosition head;
 	QueuePosition max;
 	int			i;
 
 	/*
-	 * Nothing to do if we are already listening to something, nor if we
-	 * already ran this routine in this transaction.
+	 * If we are already listening to something, or already ran this routine
+	 * in this transaction, there is nothing to do but add the channel.  We
+	 * may update our own entry holding only shared lock.
 	 */
 	if (amRegisteredListener)
+	{
+		LWLockAcquire(AsyncQueueLock, LW_SHARED);
+		QUEUE_BACKEND_CHANNELS(MyBackendId) |= CHANNEL_HASH_BIT(channel);
+		LWLockRelease(AsyncQueueLock);
 		return;
+	}
 
 	if (Trace_notify)
 		elog(DEBUG1, "Exec_ListenPreCommit(%d)", MyProcPid);
@@ -988,6 +1034,7 @@ Exec_ListenPreCommit(void)
 	QUEUE_BACKEND_POS(MyBackendId) = max;
 	QUEUE_BACKEND_PID(MyBackendId) = MyProcPid;
 	QUEUE_BACKEND_DBOID(MyBackendId) = MyDatabaseId;
+	QUEUE_BACKEND_CHANNELS(MyBackendId) = CHANNEL_HASH_BIT(channel);
 	LWLockRelease(AsyncQueueLock);
 
 	/* Now we are listed in the global array, so remember we're listening */
@@ -1147,7 +1194,7 @@ ProcessCompletedNotifies(void)
 	else if (!signalled)
 	{
 		/*
-		 * If we found no other listening backends, and we aren't listening
+		 * If we signaled no other backends, and we aren't listening
 		 * ourselves, then we must execute asyncQueueAdvanceTail to flush the
 		 * queue, because ain't nobody else gonna do it.  This prevents queue
 		 * overflow when we're sending useless notifies to nobody. (A new
@@ -1187,6 +1234,25 @@ IsListeningOn(const char *channel)
 	return false;
 }
 
+/*
+ * Recompute our channel bitmap from listenChannels, dropping the bits of
+ * channels we no longer listen on.  (Bits set for a LISTEN that was rolled
+ * back only cause useless signals, so they can wait until we get here.)
+ */
+static void
+asyncQueuePublishChannels(void)
+{
+	uint64		channels = 0;
+	ListCell   *p;
+
+	foreach(p, listenChannels)
+		channels |= CHANNEL_HASH_BIT((char *) lfirst(p));
+
+	LWLockAcquire(AsyncQueueLock, LW_SHARED);
+	QUEUE_BACKEND_CHANNELS(MyBackendId) = channels;
+	LWLockRelease(AsyncQueueLock);
+}
+
 /*
  * Remove our entry from the listeners array when we are no longer listening
  * on any channel.  NB: must not fail if we're already not listening.
@@ -1208,6 +1274,7 @@ asyncQueueUnregister(void)
 	/* ... then mark it invalid */
 	QUEUE_BACKEND_PID(MyBackendId) = InvalidPid;
 	QUEUE_BACKEND_DBOID(MyBackendId) = InvalidOid;
+	QUEUE_BACKEND_CHANNELS(MyBackendId) = 0;
 	LWLockRelease(AsyncQueueLock);
 
 	/* mark ourselves as no longer listed in the global array */
@@ -1481,7 +1548,9 @@ asyncQueueFillWarning(void)
 }
 
 /*
- * Send signals to all listening backends (except our own).
+ * Send signals to the listening backends (except our own) that may be
+ * interested in the notifications we sent, or that are so far behind the
+ * queue head that they should read past them anyway.
  *
  * Returns true if we sent at least one signal.
  *
@@ -1504,9 +1573,8 @@ SignalBackends(void)
 	int32		pid;
 
 	/*
-	 * Identify all backends that are listening and not already up-to-date. We
-	 * don't want to send signals while holding the AsyncQueueLock, so we just
-	 * build a list of target PIDs.
+	 * Identify the backends to signal.  We don't want to send signals while
+	 * holding the AsyncQueueLock, so we just build a list of target PIDs.
 	 *
 	 * XXX in principle these pallocs could fail, which would be bad. Maybe
 	 * preallocate the arrays?	But in practice this is only run in trivial
@@ -1523,17 +1591,31 @@ SignalBackends(void)
 		if (pid != InvalidPid && pid != MyProcPid)
 		{
 			QueuePosition pos = QUEUE_BACKEND_POS(i);
+			int			lag;
 
-			if (!QUEUE_POS_EQUAL(pos, QUEUE_HEAD))
+			if (QUEUE_POS_EQUAL(pos, QUEUE_HEAD))
+				continue;
+
+			if (QUEUE_BACKEND_DBOID(i) != MyDatabaseId ||
+				(QUEUE_BACKEND_CHANNELS(i) & sentNotifyChannels) == 0)
 			{
-				pids[count] = pid;
-				ids[count] = i;
-				count++;
+				/* Not interested; leave it be unless it is far behind */
+				lag = QUEUE_POS_PAGE(QUEUE_HEAD) - QUEUE_POS_PAGE(pos);
+				if (lag < 0)
+					lag += QUEUE_MAX_PAGE + 1;
+				if (lag < QUEUE_CLEANUP_DELAY)
+					continue;
 			}
+
+			pids[count] = pid;
+			ids[count] = i;
+			count++;
 		}
 	}
 	LWLockRelease(AsyncQueueLock);
 
+	sentNotifyChannels = 0;
+
 	/* Now send signals */
 	for (i = 0; i < count; i++)
 	{
@@ -18,6 +18,8 @@
 #include "postgres.h"
 
 #include "access/multixact.h"
+#include "access/nbtree.h"
+#include "access/parallel.h"
 #include "access/relscan.h"
 #include "access/rewriteheap.h"
 #include "access/transam.h"
@@ -39,7 +41,9 @@
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
+#include "storage/shm_mq.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "utils/acl.h"
 #include "utils/fmgroids.h"
 #include "utils/inval.h"
@@ -64,12 +68,56 @@ typedef struct
 	Oid			indexOid;
 } RelToCluster;
 
+/* Magic numbers for parallel CLUSTER state sharing */
+#define PARALLEL_KEY_CLUSTER_SHARED		UINT64CONST(0xC000000000000001)
+#define PARALLEL_KEY_CLUSTER_SCAN		UINT64CONST(0xC000000000000002)
+#define PARALLEL_KEY_CLUSTER_QUEUES		UINT64CONST(0xC000000000000003)
+
+/* Size of the queue each worker streams its sorted tuples through */
+#define PARALLEL_CLUSTER_QUEUE_SIZE		65536
+
+/*
+ * Status record shared by the leader and the workers of a parallel
+ * seqscan-and-sort.  The counters are summed up by the workers as they
+ * finish their scans.
+ */
+typedef struct ClusterShared
+{
+	Oid			heaprelid;
+	Oid			indexrelid;
+	TransactionId OldestXmin;
+	int			sortmem;		/* kB of sort memory for each participant */
+
+	slock_t		mutex;			/* protects the following */
+	double		num_tuples;
+	double		tups_vacuumed;
+	double		tups_recently_dead;
+} ClusterShared;
+
+/* Leader's state for a parallel seqscan-and-sort */
+typedef struct ClusterParallelState
+{
+	ParallelContext *pcxt;
+	ClusterShared *shared;
+	ParallelHeapScanDesc pscan;
+	shm_mq_handle **queues;
+	int			nqueues;
+} ClusterParallelState;
+
 
 static void rebuild_relation(Relation OldHeap, Oid indexOid, bool verbose);
 static void copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex,
 			   bool verbose, bool *pSwapToastByContent,
 			   TransactionId *pFreezeXid, MultiXactId *pCutoffMulti);
 static List *get_tables_to_cluster(MemoryContext cluster_context);
+static bool cluster_tuple_is_dead(Relation OldHeap, HeapTuple tuple,
+					  Buffer buf, TransactionId OldestXmin,
+					  bool is_system_catalog, double *tups_recently_dead);
+static ClusterParallelState *cluster_begin_parallel(Relation OldHeap,
+					   Relation OldIndex, TransactionId OldestXmin,
+					   int nworkers, int sortmem);
+static void cluster_end_parallel(ClusterParallelState *ps, double *num_tuples,
+					 double *tups_vacuumed, double *tups_recently_dead);
 static void reform_and_rewrite_tuple(HeapTuple tuple,
 						 TupleDesc oldTupDesc, TupleDesc newTupDesc,
 						 Datum *values, bool *isnull,
@@ -665,6 +713,7 @@ make_new_heap(Oid OIDOldHeap, Oid NewTableSpace, char relpersistence,
 										  InvalidOid,
 										  InvalidOid,
 										  OldHeap->rd_rel->relowner,
+										  InvalidOid,
 										  OldHeapDesc,
 										  NIL,
 										  RELKIND_RELATION,
@@ -753,6 +802,9 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	RewriteState rwstate;
 	bool		use_sort;
 	Tuplesortstate *tuplesort;
+	ClusterParallelState *parallel = NULL;
+	int			nworkers = 0;
+	int			sortmem = maintenance_work_mem;
 	double		num_tuples = 0,
 				tups_vacuumed = 0,
 				tups_recently_dead = 0;
@@ -888,10 +940,24 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	else
 		use_sort = false;
 
+	/*
+	 * A seqscan-and-sort can be shared with parallel workers: each of them,
+	 * like us, takes blocks from a parallel heap scan and sorts what it
+	 * finds, and we merge their sorted runs with ours while writing the new
+	 * heap.  The sort follows a btree, so its build's heuristics decide how
+	 * many workers to use, and how to split maintenance_work_mem.
+	 */
+	if (use_sort)
+	{
+		nworkers = _bt_parallel_workers(OldHeap, NULL);
+		if (nworkers > 0)
+			sortmem = Max(maintenance_work_mem / (nworkers + 1), 64);
+	}
+
 	/* Set up sorting if wanted */
 	if (use_sort)
 		tuplesort = tuplesort_begin_cluster(oldTupDesc, OldIndex,
-											maintenance_work_mem, false);
+											sortmem, false);
 	else
 		tuplesort = NULL;
 
@@ -906,6 +972,13 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 		indexScan = index_beginscan(OldHeap, OldIndex, SnapshotAny, 0, 0);
 		index_rescan(indexScan, NULL, 0, NULL, 0);
 	}
+	else if (nworkers > 0)
+	{
+		parallel = cluster_begin_parallel(OldHeap, OldIndex, OldestXmin,
+										  nworkers, sortmem);
+		heapScan = heap_beginscan_parallel(OldHeap, parallel->pscan);
+		indexScan = NULL;
+	}
 	else
 	{
 		heapScan = heap_beginscan(OldHeap, SnapshotAny, 0, (ScanKey) NULL);
@@ -919,6 +992,12 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 						get_namespace_name(RelationGetNamespace(OldHeap)),
 						RelationGetRelationName(OldHeap),
 						RelationGetRelationName(OldIndex))));
+	else if (parallel != NULL)
+		ereport(elevel,
+				(errmsg("clustering \"%s.%s\" using parallel sequential scan and sort with %d workers",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap),
+						parallel->pcxt->nworkers)));
 	else if (tuplesort != NULL)
 		ereport(elevel,
 				(errmsg("clustering \"%s.%s\" using sequential scan and sort",
@@ -965,58 +1044,9 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 			buf = heapScan->rs_cbuf;
 		}
 
-		LockBuffer(buf, BUFFER_LOCK_SHARE);
-
-		switch (HeapTupleSatisfiesVacuum(tuple, OldestXmin, buf))
-		{
-			case HEAPTUPLE_DEAD:
-				/* Definitely dead */
-				isdead = true;
-				break;
-			case HEAPTUPLE_RECENTLY_DEAD:
-				tups_recently_dead += 1;
-				/* fall through */
-			case HEAPTUPLE_LIVE:
-				/* Live or recently dead, must copy it */
-				isdead = false;
-				break;
-			case HEAPTUPLE_INSERT_IN_PROGRESS:
-
-				/*
-				 * Since we hold exclusive lock on the relation, normally the
-				 * only way to see this is if it was inserted earlier in our
-				 * own transaction.  However, it can happen in system
-				 * catalogs, since we tend to release write lock before commit
-				 * there.  Give a warning if neither case applies; but in any
-				 * case we had better copy it.
-				 */
-				if (!is_system_catalog &&
-					!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(tuple->t_data)))
-					elog(WARNING, "concurrent insert in progress within table \"%s\"",
-						 RelationGetRelationName(OldHeap));
-				/* treat as live */
-				isdead = false;
-				break;
-			case HEAPTUPLE_DELETE_IN_PROGRESS:
-
-				/*
-				 * Similar situation to INSERT_IN_PROGRESS case.
-				 */
-				if (!is_system_catalog &&
-					!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetUpdateXid(tuple->t_data)))
-					elog(WARNING, "concurrent delete in progress within table \"%s\"",
-						 RelationGetRelationName(OldHeap));
-				/* treat as recently dead */
-				tups_recently_dead += 1;
-				isdead = false;
-				break;
-			default:
-				elog(ERROR, "unexpected HeapTupleSatisfiesVacuum result");
-				isdead = false; /* keep compiler quiet */
-				break;
-		}
-
-		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+		isdead = cluster_tuple_is_dead(OldHeap, tuple, buf, OldestXmin,
+									   is_system_catalog,
+									   &tups_recently_dead);
 
 		if (isdead)
 		{
@@ -1048,12 +1078,24 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 
 	/*
 	 * In scan-and-sort mode, complete the sort, then read out all live tuples
-	 * from the tuplestore and write them to the new relation.
+	 * from the tuplestore and write them to the new relation.  In parallel
+	 * mode, replace our sort by one merging it with the workers' runs; the
+	 * merge takes ownership of our run, and ends it when it is done.
 	 */
 	if (tuplesort != NULL)
 	{
 		tuplesort_performsort(tuplesort);
 
+		if (parallel != NULL)
+		{
+			Tuplesortstate *localsort = tuplesort;
+
+			tuplesort = tuplesort_begin_cluster(oldTupDesc, OldIndex,
+												sortmem, false);
+			tuplesort_merge_sorted(tuplesort, parallel->queues,
+								   parallel->nqueues, localsort);
+		}
+
 		for (;;)
 		{
 			HeapTuple	tuple;
@@ -1077,6 +1119,10 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 		tuplesort_end(tuplesort);
 	}
 
+	if (parallel != NULL)
+		cluster_end_parallel(parallel, &num_tuples, &tups_vacuumed,
+							 &tups_recently_dead);
+
 	/* Write out any remaining tuples, and fsync if needed */
 	end_heap_rewrite(rwstate);
 
@@ -1104,6 +1150,244 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	heap_close(NewHeap, NoLock);
 }
 
+/*
+ * Decide whether a tuple of the old heap is dead, that is, need not be
+ * copied to the new heap, counting recently-dead ones in
+ * *tups_recently_dead.
+ */
+static bool
+cluster_tuple_is_dead(Relation OldHeap, HeapTuple tuple, Buffer buf,
+					  TransactionId OldestXmin, bool is_system_catalog,
+					  double *tups_recently_dead)
+{
+	bool		isdead;
+
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+
+	switch (HeapTupleSatisfiesVacuum(tuple, OldestXmin, buf))
+	{
+		case HEAPTUPLE_DEAD:
+			/* Definitely dead */
+			isdead = true;
+			break;
+		case HEAPTUPLE_RECENTLY_DEAD:
+			*tups_recently_dead += 1;
+			/* fall through */
+		case HEAPTUPLE_LIVE:
+			/* Live or recently dead, must copy it */
+			isdead = false;
+			break;
+		case HEAPTUPLE_INSERT_IN_PROGRESS:
+
+			/*
+			 * Since we hold exclusive lock on the relation, normally the only
+			 * way to see this is if it was inserted earlier in our own
+			 * transaction.  However, it can happen in system catalogs, since
+			 * we tend to release write lock before commit there.  Give a
+			 * warning if neither case applies; but in any case we had better
+			 * copy it.
+			 */
+			if (!is_system_catalog &&
+				!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(tuple->t_data)))
+				elog(WARNING, "concurrent insert in progress within table \"%s\"",
+					 RelationGetRelationName(OldHeap));
+			/* treat as live */
+			isdead = false;
+			break;
+		case HEAPTUPLE_DELETE_IN_PROGRESS:
+
+			/*
+			 * Similar situation to INSERT_IN_PROGRESS case.
+			 */
+			if (!is_system_catalog &&
+				!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetUpdateXid(tuple->t_data)))
+				elog(WARNING, "concurrent delete in progress within table \"%s\"",
+					 RelationGetRelationName(OldHeap));
+			/* treat as recently dead */
+			*tups_recently_dead += 1;
+			isdead = false;
+			break;
+		default:
+			elog(ERROR, "unexpected HeapTupleSatisfiesVacuum result");
+			isdead = false;		/* keep compiler quiet */
+			break;
+	}
+
+	LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+
+	return isdead;
+}
+
+/*
+ * Set up a parallel seqscan-and-sort of OldHeap with nworkers workers, each
+ * sorting its share in sortmem kB.  The caller does its own share through
+ * the returned state's parallel heap scan, and then merges the workers'
+ * sorted runs, which they send through the returned queues, with its own.
+ */
+static ClusterParallelState *
+cluster_begin_parallel(Relation OldHeap, Relation OldIndex,
+					   TransactionId OldestXmin, int nworkers, int sortmem)
+{
+	ClusterParallelState *ps;
+	ParallelContext *pcxt;
+	ClusterShared *shared;
+	char	   *queuespace;
+
+	Assert(nworkers > 0);
+
+	/*
+	 * We'll be toasting tuples into the new heap while the workers are still
+	 * sending theirs (see raw_heap_insert), which requires our command ID to
+	 * have been marked used before parallel mode begins.
+	 */
+	(void) GetCurrentCommandId(true);
+
+	ps = (ClusterParallelState *) palloc(sizeof(ClusterParallelState));
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(cluster_parallel_sort_main, nworkers);
+	ps->pcxt = pcxt;
+
+	/* Estimate and allocate the shared state */
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(ClusterShared));
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   heap_parallelscan_estimate(SnapshotAny));
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+	EstimateParallelQueues(pcxt, PARALLEL_CLUSTER_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (ClusterShared *) shm_toc_allocate(pcxt->toc,
+												sizeof(ClusterShared));
+	shared->heaprelid = RelationGetRelid(OldHeap);
+	shared->indexrelid = RelationGetRelid(OldIndex);
+	shared->OldestXmin = OldestXmin;
+	shared->sortmem = sortmem;
+	SpinLockInit(&shared->mutex);
+	shared->num_tuples = 0;
+	shared->tups_vacuumed = 0;
+	shared->tups_recently_dead = 0;
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_CLUSTER_SHARED, shared);
+	ps->shared = shared;
+
+	/* Like a serial CLUSTER, we see everything and judge it ourselves */
+	ps->pscan = (ParallelHeapScanDesc)
+		shm_toc_allocate(pcxt->toc, heap_parallelscan_estimate(SnapshotAny));
+	heap_parallelscan_initialize(ps->pscan, OldHeap, SnapshotAny);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_CLUSTER_SCAN, ps->pscan);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_CLUSTER_QUEUES,
+										  PARALLEL_CLUSTER_QUEUE_SIZE, false);
+
+	LaunchParallelWorkers(pcxt);
+
+	ps->queues = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	ps->nqueues = AttachParallelQueues(pcxt, queuespace,
+									   PARALLEL_CLUSTER_QUEUE_SIZE,
+									   ps->queues, NULL);
+
+	return ps;
+}
+
+/*
+ * Finish a parallel seqscan-and-sort, once the merged sort has been read
+ * out, adding the workers' counts to ours.
+ */
+static void
+cluster_end_parallel(ClusterParallelState *ps, double *num_tuples,
+					 double *tups_vacuumed, double *tups_recently_dead)
+{
+	/* This rethrows any error a worker ran into */
+	WaitForParallelWorkersToFinish(ps->pcxt);
+
+	*num_tuples += ps->shared->num_tuples;
+	*tups_vacuumed += ps->shared->tups_vacuumed;
+	*tups_recently_dead += ps->shared->tups_recently_dead;
+
+	DestroyParallelContext(ps->pcxt);
+	ExitParallelMode();
+
+	pfree(ps->queues);
+	pfree(ps);
+}
+
+/*
+ * cluster_parallel_sort_main
+ *
+ * Entry point of a parallel CLUSTER worker: scan our share of the old heap,
+ * sort the tuples that must be kept, and send them to the leader.
+ */
+void
+cluster_parallel_sort_main(dsm_segment *seg, shm_toc *toc)
+{
+	ClusterShared *shared;
+	ParallelHeapScanDesc pscan;
+	char	   *queuespace;
+	shm_mq_handle *mqh;
+	Relation	OldHeap;
+	Relation	OldIndex;
+	Tuplesortstate *tuplesort;
+	HeapScanDesc scan;
+	HeapTuple	tuple;
+	double		num_tuples = 0,
+				tups_vacuumed = 0,
+				tups_recently_dead = 0;
+
+	shared = (ClusterShared *) shm_toc_lookup(toc, PARALLEL_KEY_CLUSTER_SHARED);
+	pscan = (ParallelHeapScanDesc) shm_toc_lookup(toc,
+												  PARALLEL_KEY_CLUSTER_SCAN);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_CLUSTER_QUEUES);
+	if (shared == NULL || pscan == NULL || queuespace == NULL)
+		elog(ERROR, "invalid parallel cluster state");
+
+	mqh = AttachParallelLeaderQueue(seg, queuespace,
+									PARALLEL_CLUSTER_QUEUE_SIZE, false);
+
+	/* The leader holds AccessExclusiveLock on both until we are done */
+	OldHeap = heap_open(shared->heaprelid, NoLock);
+	OldIndex = index_open(shared->indexrelid, NoLock);
+
+	tuplesort = tuplesort_begin_cluster(RelationGetDescr(OldHeap), OldIndex,
+										shared->sortmem, false);
+
+	/*
+	 * Unlike the leader, we don't report dead tuples to the heap rewrite
+	 * module.  That only matters for tuples that have already been written,
+	 * and in seqscan-and-sort mode none are until the scan is over.  System
+	 * catalogs are never clustered in parallel.
+	 */
+	scan = heap_beginscan_parallel(OldHeap, pscan);
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (cluster_tuple_is_dead(OldHeap, tuple, scan->rs_cbuf,
+								  shared->OldestXmin, false,
+								  &tups_recently_dead))
+		{
+			tups_vacuumed += 1;
+			continue;
+		}
+
+		num_tuples += 1;
+		tuplesort_putheaptuple(tuplesort, tuple);
+	}
+	heap_endscan(scan);
+
+	SpinLockAcquire(&shared->mutex);
+	shared->num_tuples += num_tuples;
+	shared->tups_vacuumed += tups_vacuumed;
+	shared->tups_recently_dead += tups_recently_dead;
+	SpinLockRelease(&shared->mutex);
+
+	tuplesort_performsort(tuplesort);
+	tuplesort_send_sorted(tuplesort, mqh);
+	tuplesort_end(tuplesort);
+
+	index_close(OldIndex, NoLock);
+	heap_close(OldHeap, NoLock);
+}
+
 /*
  * Swap the physical files of two given relations.
  *
@@ -15,16 +15,26 @@
 #include "postgres.h"
 
 #include <ctype.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/sysattr.h"
+#include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xlog.h"
+#include "catalog/catalog.h"
 #include "catalog/namespace.h"
 #include "catalog/pg_type.h"
 #include "commands/copy.h"
@@ -39,8 +49,14 @@
 #include "optimizer/planner.h"
 #include "parser/parse_relation.h"
 #include "nodes/makefuncs.h"
+#include "pgstat.h"
+#include "port/simd.h"
 #include "rewrite/rewriteHandler.h"
+#include "storage/dsm_impl.h"
 #include "storage/fd.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "storage/spin.h"
 #include "tcop/tcopprot.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
@@ -63,9 +79,20 @@ typedef enum CopyDest
 {
 	COPY_FILE,					/* to/from file (or a piped program) */
 	COPY_OLD_FE,				/* to/from frontend (2.0 protocol) */
-	COPY_NEW_FE					/* to/from frontend (3.0 protocol) */
+	COPY_NEW_FE,				/* to/from frontend (3.0 protocol) */
+	COPY_PARALLEL				/* to/from the leader of a parallel COPY */
 } CopyDest;
 
+/*
+ * Compression methods for the output of COPY TO and the input of COPY FROM
+ */
+typedef enum CopyCompression
+{
+	COPY_COMPRESSION_NONE,
+	COPY_COMPRESSION_GZIP,
+	COPY_COMPRESSION_ZSTD
+} CopyCompression;
+
 /*
  *	Represents the end-of-line terminator type of the input
  */
@@ -133,6 +160,8 @@ typedef struct CopyStateData
 	bool		convert_selectively;	/* do selective binary conversion? */
 	List	   *convert_select; /* list of column names (can be NIL) */
 	bool	   *convert_select_flags;	/* per-column CSV/TEXT CS flags */
+	int			parallel_workers;	/* # of workers to use, or 0 */
+	CopyCompression compression;	/* how the data is compressed */
 
 	/* these are just for error messages, see CopyFromErrorCallback */
 	const char *cur_relname;	/* table name for error messages */
@@ -150,6 +179,16 @@ typedef struct CopyStateData
 	 */
 	FmgrInfo   *out_functions;	/* lookup info for output functions */
 	MemoryContext rowcontext;	/* per-row evaluation context */
+	bool		file_eol;		/* end rows with the platform's EOL? */
+
+	/*
+	 * The compressed output is a series of self-contained gzip members or
+	 * zstd frames, see CopyCompressBegin.
+	 */
+	void	   *compressor;		/* z_stream or ZSTD_CStream */
+	bool		compressing;	/* is a member or frame in progress? */
+	Size		compressed_len; /* bytes fed into it so far */
+	char	   *compress_buf;	/* compressed output not written yet */
 
 	/*
 	 * Working state for COPY FROM
@@ -165,6 +204,24 @@ typedef struct CopyStateData
 	bool		volatile_defexprs;		/* is any of defexprs volatile? */
 	List	   *range_table;
 
+	/*
+	 * Compressed input is read into decompress_buf and decompressed from
+	 * there, see CopyDecompressData.
+	 */
+	void	   *decompressor;	/* z_stream or ZSTD_DStream */
+	bool		decompressing;	/* is a member or frame in progress? */
+	bool		decompress_eof; /* reached EOF of the compressed input? */
+	char	   *decompress_buf; /* compressed input not decompressed yet */
+	int			decompress_pos; /* next byte of it to decompress */
+	int			decompress_len; /* total # of bytes stored */
+
+	/*
+	 * Fields of the input that won't be converted, because of
+	 * convert_selectively, are only scanned past, not de-escaped.
+	 */
+	bool	   *skip_fields;	/* per-field flags: skip this field? */
+	int			skip_fields_len;	/* length of skip_fields */
+
 	/*
 	 * These variables are used to reduce overhead in textual COPY FROM.
 	 *
@@ -202,8 +259,112 @@ typedef struct CopyStateData
 	char	   *raw_buf;
 	int			raw_buf_index;	/* next byte to process */
 	int			raw_buf_len;	/* total # of bytes stored */
+
+	/*
+	 * In a parallel COPY FROM worker, the lines come from the leader in
+	 * chunks, see CopyReadLineFromLeader.  A parallel COPY TO worker sends
+	 * its output to the leader in chunks instead, see CopySendToLeader.
+	 */
+	struct CopyShared *pshared; /* shared state of the parallel COPY */
+	shm_mq_handle *leader_mqh;	/* queue the chunks go through */
+	char	   *chunk_data;		/* current chunk */
+	Size		chunk_len;		/* its length */
+	Size		chunk_pos;		/* next byte of it to process */
+	int			chunk_lineno;	/* line number of the next line in it */
+	ParallelHeapScanDesc pscan; /* COPY TO worker's share of the scan */
+	StringInfoData out_chunk;	/* COPY TO output not sent yet */
 } CopyStateData;
 
+/* Size of the buffer compressed output is collected in */
+#define COPY_COMPRESS_BUF_SIZE		65536
+
+/* Magic numbers for parallel COPY state sharing */
+#define PARALLEL_KEY_COPY_SHARED	UINT64CONST(0xD000000000000001)
+#define PARALLEL_KEY_COPY_NULL		UINT64CONST(0xD000000000000002)
+#define PARALLEL_KEY_COPY_QUEUES	UINT64CONST(0xD000000000000003)
+#define PARALLEL_KEY_COPY_TO_SHARED UINT64CONST(0xD000000000000004)
+#define PARALLEL_KEY_COPY_SCAN		UINT64CONST(0xD000000000000005)
+
+/* Size of the queue each worker receives its lines, or sends its rows, in */
+#define PARALLEL_COPY_QUEUE_SIZE	(256 * 1024)
+
+/* Approximate size of the chunks passed between the leader and a worker */
+#define PARALLEL_COPY_CHUNK_SIZE	65536
+
+/*
+ * Amount of output a parallel COPY TO worker compresses into one member or
+ * frame; every chunk it sends must end one, so this is much larger than a
+ * chunk to keep the compression ratio up.
+ */
+#define PARALLEL_COPY_COMPRESS_SIZE (1024 * 1024)
+
+/*
+ * Status record shared by the leader and the workers of a parallel COPY
+ * FROM.  Besides what's needed to open the table, it carries the options
+ * the workers parse the lines with; the null string is stored separately.
+ */
+typedef struct CopySharedAttr
+{
+	AttrNumber	attnum;			/* column to copy into */
+	bool		force_notnull;
+	bool		force_null;
+} CopySharedAttr;
+
+typedef struct CopyShared
+{
+	Oid			relid;
+	CommandId	cid;			/* command ID to insert with */
+	int			hi_options;		/* heap_insert options to insert with */
+	bool		csv_mode;
+	char		delim;
+	char		quote;
+	char		escape;
+
+	slock_t		mutex;			/* protects the following */
+	uint64		processed;		/* # of rows inserted by the workers */
+
+	int			natts;			/* # of columns in the input */
+	CopySharedAttr attrs[FLEXIBLE_ARRAY_MEMBER];
+} CopyShared;
+
+/*
+ * Status record shared by the leader and the workers of a parallel COPY TO.
+ * The null string is stored separately, as for COPY FROM.
+ */
+typedef struct CopyToSharedAttr
+{
+	AttrNumber	attnum;			/* column to copy from */
+	bool		force_quote;
+} CopyToSharedAttr;
+
+typedef struct CopyToShared
+{
+	Oid			relid;
+	bool		binary;
+	bool		oids;
+	bool		csv_mode;
+	bool		file_eol;
+	char		delim;
+	char		quote;
+	char		escape;
+	int			file_encoding;
+	CopyCompression compression;
+
+	slock_t		mutex;			/* protects the following */
+	uint64		processed;		/* # of rows sent by the workers */
+
+	int			natts;			/* # of columns in the output */
+	CopyToSharedAttr attrs[FLEXIBLE_ARRAY_MEMBER];
+} CopyToShared;
+
+/* A parallel COPY FROM leader's view of one worker's queue */
+typedef struct CopyLeaderQueue
+{
+	shm_mq_handle *mqh;
+	StringInfoData chunk;		/* lines not sent yet */
+	bool		sending;		/* is the chunk partly sent? */
+} CopyLeaderQueue;
+
 /* DestReceiver for COPY (SELECT) TO */
 typedef struct
 {
@@ -295,6 +456,9 @@ static uint64 DoCopyTo(CopyState cstate);
 static uint64 CopyTo(CopyState cstate);
 static void CopyOneRowTo(CopyState cstate, Oid tupleOid,
 			 Datum *values, bool *nulls);
+static int	CopyToParallelWorkers(CopyState cstate);
+static bool CopyToParallel(CopyState cstate, int nworkers, uint64 *processed);
+static void CopyToParallelReceive(void *arg, Size nbytes, void *data);
 static uint64 CopyFrom(CopyState cstate);
 static void CopyFromInsertBatch(CopyState cstate, EState *estate,
 					CommandId mycid, int hi_options,
@@ -302,8 +466,23 @@ static void CopyFromInsertBatch(CopyState cstate, EState *estate,
 					BulkInsertState bistate,
 					int nBufferedTuples, HeapTuple *bufferedTuples,
 					int firstBufferedLineNo);
+static int CopyFromParallelWorkers(CopyState cstate,
+						ResultRelInfo *resultRelInfo);
+static bool CopyFromParallel(CopyState cstate, int nworkers,
+				 CommandId mycid, int hi_options, uint64 *processed);
+static int CopyLeaderSendChunk(ParallelContext *pcxt,
+					CopyLeaderQueue *queues, int nqueues, int cur);
+static void CopyLeaderTrySend(ParallelContext *pcxt,
+				  CopyLeaderQueue *queues, int nqueues, int i, bool nowait);
 static bool CopyReadLine(CopyState cstate);
+static bool CopyReadLineFromLeader(CopyState cstate);
 static bool CopyReadLineText(CopyState cstate);
+static bool CopySkipFieldText(CopyState cstate, char **cur_ptr,
+				  char *line_end_ptr);
+static bool CopySkipFieldCSV(CopyState cstate, char **cur_ptr,
+				 char *line_end_ptr);
+static inline int CopySkipPlain(const char *s, int len,
+			  char c1, char c2, char c3, char c4);
 static int	CopyReadAttributesText(CopyState cstate);
 static int	CopyReadAttributesCSV(CopyState cstate);
 static Datum CopyReadBinaryAttribute(CopyState cstate,
@@ -325,8 +504,20 @@ static void CopySendData(CopyState cstate, const void *databuf, int datasize);
 static void CopySendString(CopyState cstate, const char *str);
 static void CopySendChar(CopyState cstate, char c);
 static void CopySendEndOfRow(CopyState cstate);
+static void CopyWriteOutput(CopyState cstate, const char *data, int len);
+static void CopySendToLeader(CopyState cstate);
+static void CopyCompressBegin(CopyState cstate);
+static void CopyCompressData(CopyState cstate, const char *data, int len);
+static void CopyCompressEnd(CopyState cstate);
+static void CopyCompressCleanup(void *arg);
 static int CopyGetData(CopyState cstate, void *databuf,
 			int minread, int maxread);
+static int CopyReadSource(CopyState cstate, void *databuf,
+			   int minread, int maxread);
+static void CopyDecompressBegin(CopyState cstate);
+static int CopyDecompressData(CopyState cstate, char *databuf,
+				   int minread, int maxread);
+static void CopyDecompressCleanup(void *arg);
 static void CopySendInt32(CopyState cstate, int32 val);
 static bool CopyGetInt32(CopyState cstate, int32 *val);
 static void CopySendInt16(CopyState cstate, int16 val);
@@ -342,10 +533,12 @@ SendCopyBegin(CopyState cstate)
 {
 	if (PG_PROTOCOL_MAJOR(FrontendProtocol) >= 3)
 	{
-		/* new way */
+		/* new way; compressed output is binary whatever the format */
 		StringInfoData buf;
 		int			natts = list_length(cstate->attnumlist);
-		int16		format = (cstate->binary ? 1 : 0);
+		int16		format = (cstate->binary ||
+							  cstate->compression != COPY_COMPRESSION_NONE ?
+							  1 : 0);
 		int			i;
 
 		pq_beginmessage(&buf, 'H');
@@ -363,6 +556,10 @@ SendCopyBegin(CopyState cstate)
 			ereport(ERROR,
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 			errmsg("COPY BINARY is not supported to stdout or from stdin")));
+		if (cstate->compression != COPY_COMPRESSION_NONE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				   errmsg("COPY compression is not supported to stdout")));
 		pq_putemptymessage('H');
 		/* grottiness needed for old COPY OUT protocol */
 		pq_startcopyout();
@@ -375,6 +572,10 @@ SendCopyBegin(CopyState cstate)
 			ereport(ERROR,
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 			errmsg("COPY BINARY is not supported to stdout or from stdin")));
+		if (cstate->compression != COPY_COMPRESSION_NONE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				   errmsg("COPY compression is not supported to stdout")));
 		pq_putemptymessage('B');
 		/* grottiness needed for old COPY OUT protocol */
 		pq_startcopyout();
@@ -387,10 +588,12 @@ ReceiveCopyBegin(CopyState cstate)
 {
 	if (PG_PROTOCOL_MAJOR(FrontendProtocol) >= 3)
 	{
-		/* new way */
+		/* new way; compressed input is binary whatever the format */
 		StringInfoData buf;
 		int			natts = list_length(cstate->attnumlist);
-		int16		format = (cstate->binary ? 1 : 0);
+		int16		format = (cstate->binary ||
+							  cstate->compression != COPY_COMPRESSION_NONE ?
+							  1 : 0);
 		int			i;
 
 		pq_beginmessage(&buf, 'G');
@@ -409,6 +612,10 @@ ReceiveCopyBegin(CopyState cstate)
 			ereport(ERROR,
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 			errmsg("COPY BINARY is not supported to stdout or from stdin")));
+		if (cstate->compression != COPY_COMPRESSION_NONE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				   errmsg("COPY compression is not supported from stdin")));
 		pq_putemptymessage('G');
 		/* any error in old protocol will make us lose sync */
 		pq_startmsgread();
@@ -421,6 +628,10 @@ ReceiveCopyBegin(CopyState cstate)
 			ereport(ERROR,
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 			errmsg("COPY BINARY is not supported to stdout or from stdin")));
+		if (cstate->compression != COPY_COMPRESSION_NONE)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				   errmsg("COPY compression is not supported from stdin")));
 		pq_putemptymessage('D');
 		/* any error in old protocol will make us lose sync */
 		pq_startmsgread();
@@ -482,21 +693,47 @@ CopySendEndOfRow(CopyState cstate)
 {
 	StringInfo	fe_msgbuf = cstate->fe_msgbuf;
 
-	switch (cstate->copy_dest)
+	if (!cstate->binary)
 	{
-		case COPY_FILE:
-			if (!cstate->binary)
-			{
-				/* Default line termination depends on platform */
-#ifndef WIN32
-				CopySendChar(cstate, '\n');
-#else
-				CopySendString(cstate, "\r\n");
+		/*
+		 * Default line termination of files depends on platform, while the
+		 * FE/BE protocol uses \n as newline for all platforms.
+		 */
+#ifdef WIN32
+		if (cstate->file_eol)
+			CopySendChar(cstate, '\r');
 #endif
-			}
+		CopySendChar(cstate, '\n');
+	}
+
+	if (cstate->compression != COPY_COMPRESSION_NONE)
+		CopyCompressData(cstate, fe_msgbuf->data, fe_msgbuf->len);
+	else
+		CopyWriteOutput(cstate, fe_msgbuf->data, fe_msgbuf->len);
+
+	resetStringInfo(fe_msgbuf);
+
+	/* A parallel COPY TO worker passes its output on in chunks */
+	if (cstate->copy_dest == COPY_PARALLEL)
+	{
+		if (cstate->compression != COPY_COMPRESSION_NONE ?
+			cstate->compressed_len >= PARALLEL_COPY_COMPRESS_SIZE :
+			cstate->out_chunk.len >= PARALLEL_COPY_CHUNK_SIZE)
+			CopySendToLeader(cstate);
+	}
+}
 
-			if (fwrite(fe_msgbuf->data, fe_msgbuf->len, 1,
-					   cstate->copy_file) != 1 ||
+/*
+ * CopyWriteOutput writes a piece of output to the destination.  It's the row
+ * itself unless the output is compressed.
+ */
+static void
+CopyWriteOutput(CopyState cstate, const char *data, int len)
+{
+	switch (cstate->copy_dest)
+	{
+		case COPY_FILE:
+			if (fwrite(data, len, 1, cstate->copy_file) != 1 ||
 				ferror(cstate->copy_file))
 			{
 				if (cstate->is_program)
@@ -529,11 +766,7 @@ CopySendEndOfRow(CopyState cstate)
 			}
 			break;
 		case COPY_OLD_FE:
-			/* The FE/BE protocol uses \n as newline for all platforms */
-			if (!cstate->binary)
-				CopySendChar(cstate, '\n');
-
-			if (pq_putbytes(fe_msgbuf->data, fe_msgbuf->len))
+			if (pq_putbytes(data, len))
 			{
 				/* no hope of recovering connection sync, so FATAL */
 				ereport(FATAL,
@@ -542,173 +775,686 @@ CopySendEndOfRow(CopyState cstate)
 			}
 			break;
 		case COPY_NEW_FE:
-			/* The FE/BE protocol uses \n as newline for all platforms */
-			if (!cstate->binary)
-				CopySendChar(cstate, '\n');
+			/* Dump the piece as one CopyData message */
+			(void) pq_putmessage('d', data, len);
+			break;
+		case COPY_PARALLEL:
 
-			/* Dump the accumulated row as one CopyData message */
-			(void) pq_putmessage('d', fe_msgbuf->data, fe_msgbuf->len);
+			/*
+			 * Keep the pieces apart, so that the leader can send each row as
+			 * a CopyData message of its own.
+			 */
+			appendBinaryStringInfo(&cstate->out_chunk, (char *) &len,
+								   sizeof(int));
+			appendBinaryStringInfo(&cstate->out_chunk, data, len);
 			break;
 	}
+}
 
-	resetStringInfo(fe_msgbuf);
+/*
+ * CopySendToLeader sends the output a parallel COPY TO worker has collected
+ * to the leader, ending the compressed member or frame first: the leader
+ * interleaves the chunks of all workers, so each must be self-contained.
+ */
+static void
+CopySendToLeader(CopyState cstate)
+{
+	shm_mq_result res;
+
+	if (cstate->compressing)
+		CopyCompressEnd(cstate);
+	if (cstate->out_chunk.len == 0)
+		return;
+
+	res = shm_mq_send(cstate->leader_mqh, cstate->out_chunk.len,
+					  cstate->out_chunk.data, false);
+	if (res != SHM_MQ_SUCCESS)
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("could not send COPY data to parallel leader")));
+	resetStringInfo(&cstate->out_chunk);
 }
 
 /*
- * CopyGetData reads data from the source (file or frontend)
- *
- * We attempt to read at least minread, and at most maxread, bytes from
- * the source.  The actual number of bytes read is returned; if this is
- * less than minread, EOF was detected.
+ * Compression of COPY TO output
  *
- * Note: when copying from the frontend, we expect a proper EOF mark per
- * protocol; if the frontend simply drops the connection, we raise error.
- * It seems unwise to allow the COPY IN to complete normally in that case.
+ * The output is compressed as one or more gzip members or zstd frames.
+ * Both formats allow any number of them to be concatenated, and the
+ * decompressors handle that transparently, which lets the workers of a
+ * parallel COPY TO compress their shares of the output independently.
  *
- * NB: no data conversion is applied here.
+ * The compressor is allocated with the library's own allocator, so we
+ * register a callback to free it along with the COPY's memory context.
  */
-static int
-CopyGetData(CopyState cstate, void *databuf, int minread, int maxread)
+static void
+CopyCompressBegin(CopyState cstate)
 {
-	int			bytesread = 0;
+	Assert(!cstate->compressing);
 
-	switch (cstate->copy_dest)
+	if (cstate->compress_buf == NULL)
 	{
-		case COPY_FILE:
-			bytesread = fread(databuf, 1, maxread, cstate->copy_file);
-			if (ferror(cstate->copy_file))
-				ereport(ERROR,
-						(errcode_for_file_access(),
-						 errmsg("could not read from COPY file: %m")));
-			break;
-		case COPY_OLD_FE:
+		MemoryContextCallback *cb;
+
+		cstate->compress_buf = (char *)
+			MemoryContextAlloc(cstate->copycontext, COPY_COMPRESS_BUF_SIZE);
+		cb = (MemoryContextCallback *)
+			MemoryContextAlloc(cstate->copycontext,
+							   sizeof(MemoryContextCallback));
+		cb->func = CopyCompressCleanup;
+		cb->arg = (void *) cstate;
+		MemoryContextRegisterResetCallback(cstate->copycontext, cb);
+	}
 
-			/*
-			 * We cannot read more than minread bytes (which in practice is 1)
-			 * because old protocol doesn't have any clear way of separating
-			 * the COPY stream from following data.  This is slow, but not any
-			 * slower than the code path was originally, and we don't care
-			 * much anymore about the performance of old protocol.
-			 */
-			if (pq_getbytes((char *) databuf, minread))
+	switch (cstate->compression)
+	{
+		case COPY_COMPRESSION_NONE:
+			elog(ERROR, "COPY output is not compressed");
+			break;
+		case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
 			{
-				/* Only a \. terminator is legal EOF in old protocol */
-				ereport(ERROR,
-						(errcode(ERRCODE_CONNECTION_FAILURE),
-						 errmsg("unexpected EOF on client connection with an open transaction")));
+				z_stream   *zs = (z_stream *) cstate->compressor;
+
+				if (zs == NULL)
+				{
+					zs = (z_stream *) MemoryContextAllocZero(cstate->copycontext,
+															 sizeof(z_stream));
+					/* windowBits above 15 asks for a gzip header and trailer */
+					if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+									 15 + 16, 8,
+									 Z_DEFAULT_STRATEGY) != Z_OK)
+						ereport(ERROR,
+								(errcode(ERRCODE_OUT_OF_MEMORY),
+								 errmsg("out of memory"),
+								 errdetail("Failed while creating a gzip compressor.")));
+					cstate->compressor = zs;
+				}
+				else if (deflateReset(zs) != Z_OK)
+					elog(ERROR, "could not reset gzip compressor");
 			}
-			bytesread = minread;
+#endif
 			break;
-		case COPY_NEW_FE:
-			while (maxread > 0 && bytesread < minread && !cstate->fe_eof)
+		case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
 			{
-				int			avail;
+				ZSTD_CStream *zcs = (ZSTD_CStream *) cstate->compressor;
+				size_t		ret;
 
-				while (cstate->fe_msgbuf->cursor >= cstate->fe_msgbuf->len)
+				if (zcs == NULL)
 				{
-					/* Try to receive another message */
-					int			mtype;
-
-			readmessage:
-					HOLD_CANCEL_INTERRUPTS();
-					pq_startmsgread();
-					mtype = pq_getbyte();
-					if (mtype == EOF)
+					zcs = ZSTD_createCStream();
+					if (zcs == NULL)
 						ereport(ERROR,
-								(errcode(ERRCODE_CONNECTION_FAILURE),
-								 errmsg("unexpected EOF on client connection with an open transaction")));
-					if (pq_getmessage(cstate->fe_msgbuf, 0))
-						ereport(ERROR,
-								(errcode(ERRCODE_CONNECTION_FAILURE),
-								 errmsg("unexpected EOF on client connection with an open transaction")));
-					RESUME_CANCEL_INTERRUPTS();
-					switch (mtype)
-					{
-						case 'd':		/* CopyData */
-							break;
-						case 'c':		/* CopyDone */
-							/* COPY IN correctly terminated by frontend */
-							cstate->fe_eof = true;
-							return bytesread;
-						case 'f':		/* CopyFail */
-							ereport(ERROR,
-									(errcode(ERRCODE_QUERY_CANCELED),
-									 errmsg("COPY from stdin failed: %s",
-									   pq_getmsgstring(cstate->fe_msgbuf))));
-							break;
-						case 'H':		/* Flush */
-						case 'S':		/* Sync */
-
-							/*
-							 * Ignore Flush/Sync for the convenience of client
-							 * libraries (such as libpq) that may send those
-							 * without noticing that the command they just
-							 * sent was COPY.
-							 */
-							goto readmessage;
-						default:
-							ereport(ERROR,
-									(errcode(ERRCODE_PROTOCOL_VIOLATION),
-									 errmsg("unexpected message type 0x%02X during COPY from stdin",
-											mtype)));
-							break;
-					}
+								(errcode(ERRCODE_OUT_OF_MEMORY),
+								 errmsg("out of memory"),
+								 errdetail("Failed while creating a zstd compressor.")));
+					cstate->compressor = zcs;
 				}
-				avail = cstate->fe_msgbuf->len - cstate->fe_msgbuf->cursor;
-				if (avail > maxread)
-					avail = maxread;
-				pq_copymsgbytes(cstate->fe_msgbuf, databuf, avail);
-				databuf = (void *) ((char *) databuf + avail);
-				maxread -= avail;
-				bytesread += avail;
+				ret = ZSTD_initCStream(zcs, ZSTD_CLEVEL_DEFAULT);
+				if (ZSTD_isError(ret))
+					elog(ERROR, "could not initialize zstd compressor: %s",
+						 ZSTD_getErrorName(ret));
 			}
+#endif
 			break;
 	}
 
-	return bytesread;
+	cstate->compressing = true;
+	cstate->compressed_len = 0;
 }
 
-
 /*
- * These functions do apply some data conversion
+ * CopyCompressData feeds a row to the compressor, starting a new member or
+ * frame if need be, and writes out whatever compressed output that yields.
  */
+static void
+CopyCompressData(CopyState cstate, const char *data, int len)
+{
+	if (!cstate->compressing)
+		CopyCompressBegin(cstate);
+	cstate->compressed_len += len;
+
+	switch (cstate->compression)
+	{
+		case COPY_COMPRESSION_NONE:
+			break;
+		case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			{
+				z_stream   *zs = (z_stream *) cstate->compressor;
+
+				zs->next_in = (Bytef *) data;
+				zs->avail_in = len;
+				do
+				{
+					zs->next_out = (Bytef *) cstate->compress_buf;
+					zs->avail_out = COPY_COMPRESS_BUF_SIZE;
+					if (deflate(zs, Z_NO_FLUSH) == Z_STREAM_ERROR)
+						elog(ERROR, "could not compress COPY data: %s",
+							 zs->msg ? zs->msg : "unknown error");
+					if (zs->avail_out < COPY_COMPRESS_BUF_SIZE)
+						CopyWriteOutput(cstate, cstate->compress_buf,
+									COPY_COMPRESS_BUF_SIZE - zs->avail_out);
+				} while (zs->avail_out == 0);
+			}
+#endif
+			break;
+		case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_CStream *zcs = (ZSTD_CStream *) cstate->compressor;
+				ZSTD_inBuffer in;
+
+				in.src = data;
+				in.size = len;
+				in.pos = 0;
+				while (in.pos < in.size)
+				{
+					ZSTD_outBuffer out;
+					size_t		ret;
+
+					out.dst = cstate->compress_buf;
+					out.size = COPY_COMPRESS_BUF_SIZE;
+					out.pos = 0;
+					ret = ZSTD_compressStream(zcs, &out, &in);
+					if (ZSTD_isError(ret))
+						elog(ERROR, "could not compress COPY data: %s",
+							 ZSTD_getErrorName(ret));
+					if (out.pos > 0)
+						CopyWriteOutput(cstate, cstate->compress_buf, out.pos);
+				}
+			}
+#endif
+			break;
+	}
+}
 
 /*
- * CopySendInt32 sends an int32 in network byte order
+ * CopyCompressEnd ends the current member or frame, writing out the rest of
+ * its compressed output.
  */
 static void
-CopySendInt32(CopyState cstate, int32 val)
+CopyCompressEnd(CopyState cstate)
 {
-	uint32		buf;
+	Assert(cstate->compressing);
 
-	buf = htonl((uint32) val);
-	CopySendData(cstate, &buf, sizeof(buf));
+	switch (cstate->compression)
+	{
+		case COPY_COMPRESSION_NONE:
+			break;
+		case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			{
+				z_stream   *zs = (z_stream *) cstate->compressor;
+				int			ret;
+
+				zs->next_in = NULL;
+				zs->avail_in = 0;
+				do
+				{
+					zs->next_out = (Bytef *) cstate->compress_buf;
+					zs->avail_out = COPY_COMPRESS_BUF_SIZE;
+					ret = deflate(zs, Z_FINISH);
+					if (ret == Z_STREAM_ERROR)
+						elog(ERROR, "could not compress COPY data: %s",
+							 zs->msg ? zs->msg : "unknown error");
+					if (zs->avail_out < COPY_COMPRESS_BUF_SIZE)
+						CopyWriteOutput(cstate, cstate->compress_buf,
+									COPY_COMPRESS_BUF_SIZE - zs->avail_out);
+				} while (ret != Z_STREAM_END);
+			}
+#endif
+			break;
+		case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_CStream *zcs = (ZSTD_CStream *) cstate->compressor;
+				size_t		ret;
+
+				do
+				{
+					ZSTD_outBuffer out;
+
+					out.dst = cstate->compress_buf;
+					out.size = COPY_COMPRESS_BUF_SIZE;
+					out.pos = 0;
+					ret = ZSTD_endStream(zcs, &out);
+					if (ZSTD_isError(ret))
+						elog(ERROR, "could not compress COPY data: %s",
+							 ZSTD_getErrorName(ret));
+					if (out.pos > 0)
+						CopyWriteOutput(cstate, cstate->compress_buf, out.pos);
+				} while (ret > 0);
+			}
+#endif
+			break;
+	}
+
+	cstate->compressing = false;
 }
 
 /*
- * CopyGetInt32 reads an int32 that appears in network byte order
- *
- * Returns true if OK, false if EOF
+ * Free the compressor when the COPY's memory context goes away, whether the
+ * COPY completed or not.
  */
-static bool
-CopyGetInt32(CopyState cstate, int32 *val)
+static void
+CopyCompressCleanup(void *arg)
 {
-	uint32		buf;
+	CopyState	cstate = (CopyState) arg;
 
-	if (CopyGetData(cstate, &buf, sizeof(buf), sizeof(buf)) != sizeof(buf))
+	if (cstate->compressor == NULL)
+		return;
+
+	switch (cstate->compression)
 	{
-		*val = 0;				/* suppress compiler warning */
-		return false;
+		case COPY_COMPRESSION_NONE:
+			break;
+		case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			deflateEnd((z_stream *) cstate->compressor);
+#endif
+			break;
+		case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			ZSTD_freeCStream((ZSTD_CStream *) cstate->compressor);
+#endif
+			break;
 	}
-	*val = (int32) ntohl(buf);
-	return true;
+	cstate->compressor = NULL;
 }
 
 /*
- * CopySendInt16 sends an int16 in network byte order
+ * Decompression of COPY FROM input
+ *
+ * The input may be any number of concatenated gzip members or zstd frames,
+ * as COPY TO and the usual command-line tools write them.  It is read from
+ * the source into decompress_buf, and decompressed from there straight into
+ * the caller's buffer.
  */
 static void
-CopySendInt16(CopyState cstate, int16 val)
+CopyDecompressBegin(CopyState cstate)
+{
+	MemoryContextCallback *cb;
+
+	cstate->decompress_buf = (char *)
+		MemoryContextAlloc(cstate->copycontext, COPY_COMPRESS_BUF_SIZE);
+	cstate->decompress_pos = cstate->decompress_len = 0;
+	cstate->decompress_eof = false;
+	cstate->decompressing = false;
+
+	cb = (MemoryContextCallback *)
+		MemoryContextAlloc(cstate->copycontext,
+						   sizeof(MemoryContextCallback));
+	cb->func = CopyDecompressCleanup;
+	cb->arg = (void *) cstate;
+	MemoryContextRegisterResetCallback(cstate->copycontext, cb);
+
+	switch (cstate->compression)
+	{
+		case COPY_COMPRESSION_NONE:
+			elog(ERROR, "COPY input is not compressed");
+			break;
+		case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			{
+				z_stream   *zs;
+
+				zs = (z_stream *) MemoryContextAllocZero(cstate->copycontext,
+														 sizeof(z_stream));
+				/* windowBits above 15 asks for a gzip header and trailer */
+				if (inflateInit2(zs, 15 + 16) != Z_OK)
+					ereport(ERROR,
+							(errcode(ERRCODE_OUT_OF_MEMORY),
+							 errmsg("out of memory"),
+							 errdetail("Failed while creating a gzip decompressor.")));
+				cstate->decompressor = zs;
+			}
+#endif
+			break;
+		case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_DStream *zds;
+				size_t		ret;
+
+				zds = ZSTD_createDStream();
+				if (zds == NULL)
+					ereport(ERROR,
+							(errcode(ERRCODE_OUT_OF_MEMORY),
+							 errmsg("out of memory"),
+							 errdetail("Failed while creating a zstd decompressor.")));
+				cstate->decompressor = zds;
+				ret = ZSTD_initDStream(zds);
+				if (ZSTD_isError(ret))
+					elog(ERROR, "could not initialize zstd decompressor: %s",
+						 ZSTD_getErrorName(ret));
+			}
+#endif
+			break;
+	}
+}
+
+/*
+ * CopyDecompressData is CopyGetData for compressed input: it returns at
+ * least minread, and at most maxread, decompressed bytes, or fewer at EOF.
+ * Input that ends in the middle of a member or frame is an error.
+ */
+static int
+CopyDecompressData(CopyState cstate, char *databuf, int minread, int maxread)
+{
+	int			bytesread = 0;
+
+	if (cstate->decompress_buf == NULL)
+		CopyDecompressBegin(cstate);
+
+	while (bytesread < minread)
+	{
+		int			consumed = 0;
+		int			produced = 0;
+
+		/* Get more compressed input if we've used up what we had */
+		if (cstate->decompress_pos >= cstate->decompress_len &&
+			!cstate->decompress_eof)
+		{
+			cstate->decompress_len = CopyReadSource(cstate,
+													cstate->decompress_buf,
+													1, COPY_COMPRESS_BUF_SIZE);
+			cstate->decompress_pos = 0;
+			if (cstate->decompress_len == 0)
+				cstate->decompress_eof = true;
+		}
+
+		/* Done if the input ended between members or frames */
+		if (cstate->decompress_pos >= cstate->decompress_len &&
+			!cstate->decompressing)
+			break;
+
+		switch (cstate->compression)
+		{
+			case COPY_COMPRESSION_NONE:
+				break;
+			case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+				{
+					z_stream   *zs = (z_stream *) cstate->decompressor;
+					int			ret;
+
+					/* each member needs a fresh start */
+					if (!cstate->decompressing)
+					{
+						if (inflateReset(zs) != Z_OK)
+							elog(ERROR, "could not reset gzip decompressor");
+						cstate->decompressing = true;
+					}
+
+					zs->next_in = (Bytef *) cstate->decompress_buf +
+						cstate->decompress_pos;
+					zs->avail_in = cstate->decompress_len -
+						cstate->decompress_pos;
+					zs->next_out = (Bytef *) databuf + bytesread;
+					zs->avail_out = maxread - bytesread;
+					ret = inflate(zs, Z_NO_FLUSH);
+					if (ret == Z_STREAM_END)
+						cstate->decompressing = false;
+					else if (ret != Z_OK && ret != Z_BUF_ERROR)
+						ereport(ERROR,
+								(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+								 errmsg("could not decompress COPY data: %s",
+									  zs->msg ? zs->msg : "unknown error")));
+					consumed = (cstate->decompress_len -
+								cstate->decompress_pos) - zs->avail_in;
+					produced = (maxread - bytesread) - zs->avail_out;
+				}
+#endif
+				break;
+			case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+				{
+					ZSTD_DStream *zds = (ZSTD_DStream *) cstate->decompressor;
+					ZSTD_inBuffer in;
+					ZSTD_outBuffer out;
+					size_t		ret;
+
+					in.src = cstate->decompress_buf + cstate->decompress_pos;
+					in.size = cstate->decompress_len - cstate->decompress_pos;
+					in.pos = 0;
+					out.dst = databuf + bytesread;
+					out.size = maxread - bytesread;
+					out.pos = 0;
+					ret = ZSTD_decompressStream(zds, &out, &in);
+					if (ZSTD_isError(ret))
+						ereport(ERROR,
+								(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+								 errmsg("could not decompress COPY data: %s",
+										ZSTD_getErrorName(ret))));
+					/* zero means a frame was completed and fully flushed */
+					cstate->decompressing = (ret != 0);
+					consumed = in.pos;
+					produced = out.pos;
+				}
+#endif
+				break;
+		}
+
+		cstate->decompress_pos += consumed;
+		bytesread += produced;
+
+		/* No progress with no more input to come means it was cut short */
+		if (consumed == 0 && produced == 0 && cstate->decompress_eof &&
+			cstate->decompressing)
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("unexpected end of compressed COPY data")));
+	}
+
+	return bytesread;
+}
+
+/*
+ * Free the decompressor when the COPY's memory context goes away.
+ */
+static void
+CopyDecompressCleanup(void *arg)
+{
+	CopyState	cstate = (CopyState) arg;
+
+	if (cstate->decompressor == NULL)
+		return;
+
+	switch (cstate->compression)
+	{
+		case COPY_COMPRESSION_NONE:
+			break;
+		case COPY_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			inflateEnd((z_stream *) cstate->decompressor);
+#endif
+			break;
+		case COPY_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			ZSTD_freeDStream((ZSTD_DStream *) cstate->decompressor);
+#endif
+			break;
+	}
+	cstate->decompressor = NULL;
+}
+
+/*
+ * CopyGetData reads data from the source (file or frontend)
+ *
+ * We attempt to read at least minread, and at most maxread, bytes from
+ * the source.  The actual number of bytes read is returned; if this is
+ * less than minread, EOF was detected.
+ *
+ * If the input is compressed, the bytes returned are the decompressed ones.
+ *
+ * NB: no data conversion is applied here.
+ */
+static int
+CopyGetData(CopyState cstate, void *databuf, int minread, int maxread)
+{
+	if (cstate->compression != COPY_COMPRESSION_NONE)
+		return CopyDecompressData(cstate, (char *) databuf, minread, maxread);
+	return CopyReadSource(cstate, databuf, minread, maxread);
+}
+
+/*
+ * CopyReadSource reads raw bytes from the source, for CopyGetData
+ *
+ * Note: when copying from the frontend, we expect a proper EOF mark per
+ * protocol; if the frontend simply drops the connection, we raise error.
+ * It seems unwise to allow the COPY IN to complete normally in that case.
+ */
+static int
+CopyReadSource(CopyState cstate, void *databuf, int minread, int maxread)
+{
+	int			bytesread = 0;
+
+	switch (cstate->copy_dest)
+	{
+		case COPY_FILE:
+			bytesread = fread(databuf, 1, maxread, cstate->copy_file);
+			if (ferror(cstate->copy_file))
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read from COPY file: %m")));
+			break;
+		case COPY_OLD_FE:
+
+			/*
+			 * We cannot read more than minread bytes (which in practice is 1)
+			 * because old protocol doesn't have any clear way of separating
+			 * the COPY stream from following data.  This is slow, but not any
+			 * slower than the code path was originally, and we don't care
+			 * much anymore about the performance of old protocol.
+			 */
+			if (pq_getbytes((char *) databuf, minread))
+			{
+				/* Only a \. terminator is legal EOF in old protocol */
+				ereport(ERROR,
+						(errcode(ERRCODE_CONNECTION_FAILURE),
+						 errmsg("unexpected EOF on client connection with an open transaction")));
+			}
+			bytesread = minread;
+			break;
+		case COPY_NEW_FE:
+			while (maxread > 0 && bytesread < minread && !cstate->fe_eof)
+			{
+				int			avail;
+
+				while (cstate->fe_msgbuf->cursor >= cstate->fe_msgbuf->len)
+				{
+					/* Try to receive another message */
+					int			mtype;
+
+			readmessage:
+					HOLD_CANCEL_INTERRUPTS();
+					pq_startmsgread();
+					mtype = pq_getbyte();
+					if (mtype == EOF)
+						ereport(ERROR,
+								(errcode(ERRCODE_CONNECTION_FAILURE),
+								 errmsg("unexpected EOF on client connection with an open transaction")));
+					if (pq_getmessage(cstate->fe_msgbuf, 0))
+						ereport(ERROR,
+								(errcode(ERRCODE_CONNECTION_FAILURE),
+								 errmsg("unexpected EOF on client connection with an open transaction")));
+					RESUME_CANCEL_INTERRUPTS();
+					switch (mtype)
+					{
+						case 'd':		/* CopyData */
+							break;
+						case 'c':		/* CopyDone */
+							/* COPY IN correctly terminated by frontend */
+							cstate->fe_eof = true;
+							return bytesread;
+						case 'f':		/* CopyFail */
+							ereport(ERROR,
+									(errcode(ERRCODE_QUERY_CANCELED),
+									 errmsg("COPY from stdin failed: %s",
+									   pq_getmsgstring(cstate->fe_msgbuf))));
+							break;
+						case 'H':		/* Flush */
+						case 'S':		/* Sync */
+
+							/*
+							 * Ignore Flush/Sync for the convenience of client
+							 * libraries (such as libpq) that may send those
+							 * without noticing that the command they just
+							 * sent was COPY.
+							 */
+							goto readmessage;
+						default:
+							ereport(ERROR,
+									(errcode(ERRCODE_PROTOCOL_VIOLATION),
+									 errmsg("unexpected message type 0x%02X during COPY from stdin",
+											mtype)));
+							break;
+					}
+				}
+				avail = cstate->fe_msgbuf->len - cstate->fe_msgbuf->cursor;
+				if (avail > maxread)
+					avail = maxread;
+				pq_copymsgbytes(cstate->fe_msgbuf, databuf, avail);
+				databuf = (void *) ((char *) databuf + avail);
+				maxread -= avail;
+				bytesread += avail;
+			}
+			break;
+		case COPY_PARALLEL:
+
+			/*
+			 * A parallel worker gets whole lines from the leader, in
+			 * CopyReadLineFromLeader, and never reads raw input itself.
+			 */
+			elog(ERROR, "cannot read raw COPY data in a parallel worker");
+			break;
+	}
+
+	return bytesread;
+}
+
+
+/*
+ * These functions do apply some data conversion
+ */
+
+/*
+ * CopySendInt32 sends an int32 in network byte order
+ */
+static void
+CopySendInt32(CopyState cstate, int32 val)
+{
+	uint32		buf;
+
+	buf = htonl((uint32) val);
+	CopySendData(cstate, &buf, sizeof(buf));
+}
+
+/*
+ * CopyGetInt32 reads an int32 that appears in network byte order
+ *
+ * Returns true if OK, false if EOF
+ */
+static bool
+CopyGetInt32(CopyState cstate, int32 *val)
+{
+	uint32		buf;
+
+	if (CopyGetData(cstate, &buf, sizeof(buf), sizeof(buf)) != sizeof(buf))
+	{
+		*val = 0;				/* suppress compiler warning */
+		return false;
+	}
+	*val = (int32) ntohl(buf);
+	return true;
+}
+
+/*
+ * CopySendInt16 sends an int16 in network byte order
+ */
+static void
+CopySendInt16(CopyState cstate, int16 val)
 {
 	uint16		buf;
 
@@ -987,6 +1733,7 @@ ProcessCopyOptions(CopyState cstate,
 				   List *options)
 {
 	bool		format_specified = false;
+	bool		compression_specified = false;
 	ListCell   *option;
 
 	/* Support external use for option sanity checking */
@@ -1153,20 +1900,72 @@ ProcessCopyOptions(CopyState cstate,
 						 errmsg("argument to option \"%s\" must be a valid encoding name",
 								defel->defname)));
 		}
-		else
-			ereport(ERROR,
-					(errcode(ERRCODE_SYNTAX_ERROR),
-					 errmsg("option \"%s\" not recognized",
-							defel->defname)));
-	}
-
-	/*
-	 * Check for incompatible options (must do these two before inserting
-	 * defaults)
-	 */
-	if (cstate->binary && cstate->delim)
-		ereport(ERROR,
-				(errcode(ERRCODE_SYNTAX_ERROR),
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			if (cstate->parallel_workers > 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			cstate->parallel_workers = defGetInt32(defel);
+			if (cstate->parallel_workers < 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("argument to option \"%s\" must not be negative",
+								defel->defname)));
+		}
+		else if (strcmp(defel->defname, "compression") == 0)
+		{
+			char	   *method = defGetString(defel);
+
+			if (compression_specified)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			compression_specified = true;
+			if (strcmp(method, "none") == 0)
+				cstate->compression = COPY_COMPRESSION_NONE;
+			else if (strcmp(method, "gzip") == 0)
+			{
+#ifndef HAVE_LIBZ
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("compression method gzip not supported"),
+						 errdetail("This functionality requires the server to be built with zlib support."),
+						 errhint("You need to rebuild PostgreSQL using --with-zlib.")));
+#endif
+				cstate->compression = COPY_COMPRESSION_GZIP;
+			}
+			else if (strcmp(method, "zstd") == 0)
+			{
+#ifndef USE_ZSTD
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("compression method zstd not supported"),
+						 errdetail("This functionality requires the server to be built with zstd support."),
+						 errhint("You need to rebuild PostgreSQL using --with-zstd.")));
+#endif
+				cstate->compression = COPY_COMPRESSION_ZSTD;
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("COPY compression method \"%s\" not recognized",
+								method)));
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("option \"%s\" not recognized",
+							defel->defname)));
+	}
+
+	/*
+	 * Check for incompatible options (must do these two before inserting
+	 * defaults)
+	 */
+	if (cstate->binary && cstate->delim)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
 				 errmsg("cannot specify DELIMITER in BINARY mode")));
 
 	if (cstate->binary && cstate->null_print)
@@ -1761,6 +2560,8 @@ DoCopyTo(CopyState cstate)
 	bool		fe_copy = (pipe && whereToSendOutput == DestRemote);
 	uint64		processed;
 
+	cstate->file_eol = !fe_copy;
+
 	PG_TRY();
 	{
 		if (fe_copy)
@@ -1811,6 +2612,7 @@ EndCopyTo(CopyState cstate)
 static uint64
 CopyTo(CopyState cstate)
 {
+	bool		is_worker = (cstate->copy_dest == COPY_PARALLEL);
 	TupleDesc	tupDesc;
 	int			num_phys_attrs;
 	Form_pg_attribute *attr;
@@ -1827,6 +2629,8 @@ CopyTo(CopyState cstate)
 
 	/* We use fe_msgbuf as a per-row buffer regardless of copy_dest */
 	cstate->fe_msgbuf = makeStringInfo();
+	if (is_worker)
+		initStringInfo(&cstate->out_chunk);
 
 	/* Get info about the columns we need to process. */
 	cstate->out_functions = (FmgrInfo *) palloc(num_phys_attrs * sizeof(FmgrInfo));
@@ -1859,7 +2663,8 @@ CopyTo(CopyState cstate)
 											   ALLOCSET_DEFAULT_INITSIZE,
 											   ALLOCSET_DEFAULT_MAXSIZE);
 
-	if (cstate->binary)
+	/* In a parallel COPY TO, the leader sends the header and trailer */
+	if (cstate->binary && !is_worker)
 	{
 		/* Generate header for a binary copy */
 		int32		tmp;
@@ -1875,7 +2680,7 @@ CopyTo(CopyState cstate)
 		tmp = 0;
 		CopySendInt32(cstate, tmp);
 	}
-	else
+	else if (!cstate->binary)
 	{
 		/*
 		 * For non-binary copy, we need to convert null_print to file
@@ -1887,7 +2692,7 @@ CopyTo(CopyState cstate)
 													  cstate->file_encoding);
 
 		/* if a header has been requested send the line */
-		if (cstate->header_line)
+		if (cstate->header_line && !is_worker)
 		{
 			bool		hdr_delim = false;
 
@@ -1912,33 +2717,46 @@ CopyTo(CopyState cstate)
 
 	if (cstate->rel)
 	{
-		Datum	   *values;
-		bool	   *nulls;
-		HeapScanDesc scandesc;
-		HeapTuple	tuple;
+		int			nworkers = is_worker ? 0 : CopyToParallelWorkers(cstate);
+
+		if (nworkers == 0 || !CopyToParallel(cstate, nworkers, &processed))
+		{
+			Datum	   *values;
+			bool	   *nulls;
+			HeapScanDesc scandesc;
+			HeapTuple	tuple;
 
-		values = (Datum *) palloc(num_phys_attrs * sizeof(Datum));
-		nulls = (bool *) palloc(num_phys_attrs * sizeof(bool));
+			values = (Datum *) palloc(num_phys_attrs * sizeof(Datum));
+			nulls = (bool *) palloc(num_phys_attrs * sizeof(bool));
 
-		scandesc = heap_beginscan(cstate->rel, GetActiveSnapshot(), 0, NULL);
+			if (is_worker)
+				scandesc = heap_beginscan_parallel(cstate->rel, cstate->pscan);
+			else
+				scandesc = table_beginscan(cstate->rel, GetActiveSnapshot(),
+										   0, NULL);
 
-		processed = 0;
-		while ((tuple = heap_getnext(scandesc, ForwardScanDirection)) != NULL)
-		{
-			CHECK_FOR_INTERRUPTS();
+			processed = 0;
+			while ((tuple = table_getnext(scandesc,
+										  ForwardScanDirection)) != NULL)
+			{
+				CHECK_FOR_INTERRUPTS();
 
-			/* Deconstruct the tuple ... faster than repeated heap_getattr */
-			heap_deform_tuple(tuple, tupDesc, values, nulls);
+				/*
+				 * Deconstruct the tuple ... faster than repeated
+				 * heap_getattr
+				 */
+				heap_deform_tuple(tuple, tupDesc, values, nulls);
 
-			/* Format and send the data */
-			CopyOneRowTo(cstate, HeapTupleGetOid(tuple), values, nulls);
-			processed++;
-		}
+				/* Format and send the data */
+				CopyOneRowTo(cstate, HeapTupleGetOid(tuple), values, nulls);
+				processed++;
+			}
 
-		heap_endscan(scandesc);
+			table_endscan(scandesc);
 
-		pfree(values);
-		pfree(nulls);
+			pfree(values);
+			pfree(nulls);
+		}
 	}
 	else
 	{
@@ -1947,12 +2765,28 @@ CopyTo(CopyState cstate)
 		processed = ((DR_copy *) cstate->queryDesc->dest)->processed;
 	}
 
-	if (cstate->binary)
+	if (is_worker)
 	{
-		/* Generate trailer for a binary copy */
-		CopySendInt16(cstate, -1);
-		/* Need to flush out the trailer */
-		CopySendEndOfRow(cstate);
+		/* Pass on the rest of our output */
+		CopySendToLeader(cstate);
+	}
+	else
+	{
+		if (cstate->binary)
+		{
+			/* Generate trailer for a binary copy */
+			CopySendInt16(cstate, -1);
+			/* Need to flush out the trailer */
+			CopySendEndOfRow(cstate);
+		}
+
+		/* Even empty compressed output must be a valid member or frame */
+		if (cstate->compression != COPY_COMPRESSION_NONE)
+		{
+			if (!cstate->compressing)
+				CopyCompressBegin(cstate);
+			CopyCompressEnd(cstate);
+		}
 	}
 
 	MemoryContextDelete(cstate->rowcontext);
@@ -2051,6 +2885,290 @@ CopyOneRowTo(CopyState cstate, Oid tupleOid, Datum *values, bool *nulls)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Choose the number of parallel workers to scan the table of a COPY TO with,
+ * or zero to scan it ourselves.
+ *
+ * The workers format the rows they scan and send them to us in chunks, in
+ * no particular order.  They can't see our temp tables' local buffers, and
+ * predicate locks are not shared with them.  Types with output functions of
+ * their own could do anything in them, so we leave those to a serial COPY.
+ */
+static int
+CopyToParallelWorkers(CopyState cstate)
+{
+	Relation	rel = cstate->rel;
+	ListCell   *cur;
+
+	if (cstate->parallel_workers == 0 ||
+		max_parallel_maintenance_workers == 0 ||
+		!IsUnderPostmaster ||
+		rel->rd_rel->relam != InvalidOid ||
+		RelationUsesLocalBuffers(rel) ||
+		IsolationIsSerializable() ||
+		IsInParallelMode() ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
+
+	foreach(cur, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(cur);
+
+		if (cstate->out_functions[attnum - 1].fn_oid >= FirstNormalObjectId)
+			return 0;
+	}
+
+	return Min(cstate->parallel_workers, max_parallel_maintenance_workers);
+}
+
+/*
+ * Copy the table of a COPY TO with the help of nworkers parallel workers,
+ * setting *processed to the number of rows they sent.  Returns false, with
+ * nothing scanned, if no worker could be registered.
+ *
+ * The workers share a parallel scan of the table, and send us their output
+ * through one queue per worker; each chunk holds whole rows, or with
+ * compression, whole gzip members or zstd frames.  We just pass the chunks
+ * on to the destination as they come in, which keeps up with a good number
+ * of workers doing the formatting and compression.
+ */
+static bool
+CopyToParallel(CopyState cstate, int nworkers, uint64 *processed)
+{
+	ParallelContext *pcxt;
+	CopyToShared *shared;
+	Size		sharedsize;
+	ParallelHeapScanDesc pscan;
+	Snapshot	snapshot = GetActiveSnapshot();
+	char	   *nullspace;
+	char	   *queuespace;
+	shm_mq_handle **queues;
+	int			nqueues;
+	int			natts = list_length(cstate->attnumlist);
+	ListCell   *lc;
+	int			i;
+
+	Assert(nworkers > 0);
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(CopyToParallelMain, nworkers);
+
+	/* Estimate and allocate the shared state */
+	sharedsize = add_size(offsetof(CopyToShared, attrs),
+						  mul_size(natts, sizeof(CopyToSharedAttr)));
+	shm_toc_estimate_chunk(&pcxt->estimator, sharedsize);
+	shm_toc_estimate_chunk(&pcxt->estimator, cstate->null_print_len + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   heap_parallelscan_estimate(snapshot));
+	shm_toc_estimate_keys(&pcxt->estimator, 3);
+	EstimateParallelQueues(pcxt, PARALLEL_COPY_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (CopyToShared *) shm_toc_allocate(pcxt->toc, sharedsize);
+	shared->relid = RelationGetRelid(cstate->rel);
+	shared->binary = cstate->binary;
+	shared->oids = cstate->oids;
+	shared->csv_mode = cstate->csv_mode;
+	shared->file_eol = cstate->file_eol;
+	shared->delim = cstate->binary ? '\0' : cstate->delim[0];
+	shared->quote = cstate->csv_mode ? cstate->quote[0] : '\0';
+	shared->escape = cstate->csv_mode ? cstate->escape[0] : '\0';
+	shared->file_encoding = cstate->file_encoding;
+	shared->compression = cstate->compression;
+	SpinLockInit(&shared->mutex);
+	shared->processed = 0;
+	shared->natts = natts;
+	i = 0;
+	foreach(lc, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(lc);
+		CopyToSharedAttr *attr = &shared->attrs[i++];
+
+		attr->attnum = attnum;
+		attr->force_quote = cstate->csv_mode &&
+			cstate->force_quote_flags[attnum - 1];
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_TO_SHARED, shared);
+
+	nullspace = (char *) shm_toc_allocate(pcxt->toc,
+										  cstate->null_print_len + 1);
+	strcpy(nullspace, cstate->null_print);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_NULL, nullspace);
+
+	pscan = (ParallelHeapScanDesc)
+		shm_toc_allocate(pcxt->toc, heap_parallelscan_estimate(snapshot));
+	heap_parallelscan_initialize(pscan, cstate->rel, snapshot);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_SCAN, pscan);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_COPY_QUEUES,
+										  PARALLEL_COPY_QUEUE_SIZE, false);
+
+	LaunchParallelWorkers(pcxt);
+
+	queues = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	nqueues = AttachParallelQueues(pcxt, queuespace, PARALLEL_COPY_QUEUE_SIZE,
+								   queues, NULL);
+	if (nqueues == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return false;
+	}
+
+	/*
+	 * Get the header out, and end its compressed member or frame, so that
+	 * the workers' chunks can follow.
+	 */
+	if (cstate->fe_msgbuf->len > 0)
+		CopySendEndOfRow(cstate);
+	if (cstate->compressing)
+		CopyCompressEnd(cstate);
+
+	/* Pass the chunks on as they come in */
+	ReceiveFromParallelQueues(queues, &nqueues, false, CopyToParallelReceive,
+							  (void *) cstate,
+							  WAIT_EVENT_PARALLEL_COPY_RECEIVE);
+
+	/* This rethrows any error a worker ran into */
+	WaitForParallelWorkersToFinish(pcxt);
+
+	*processed = shared->processed;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	return true;
+}
+
+/*
+ * Write out a chunk a parallel COPY TO worker sent, each piece of which is
+ * preceded by its length.
+ */
+static void
+CopyToParallelReceive(void *arg, Size nbytes, void *data)
+{
+	CopyState	cstate = (CopyState) arg;
+	Size		pos = 0;
+
+	while (pos < nbytes)
+	{
+		int			len;
+
+		memcpy(&len, (char *) data + pos, sizeof(int));
+		pos += sizeof(int);
+		CopyWriteOutput(cstate, (char *) data + pos, len);
+		pos += len;
+	}
+}
+
+/*
+ * CopyToParallelMain
+ *
+ * Entry point of a parallel COPY TO worker: format the rows of our share of
+ * the table, as CopyTo does for a serial COPY, and send them to the leader.
+ */
+void
+CopyToParallelMain(dsm_segment *seg, shm_toc *toc)
+{
+	CopyToShared *shared;
+	char	   *nullspace;
+	ParallelHeapScanDesc pscan;
+	char	   *queuespace;
+	Relation	rel;
+	TupleDesc	tupDesc;
+	List	   *attnamelist = NIL;
+	List	   *options = NIL;
+	List	   *force_quote = NIL;
+	const char *format;
+	CopyState	cstate;
+	uint64		processed;
+	int			i;
+
+	shared = (CopyToShared *) shm_toc_lookup(toc, PARALLEL_KEY_COPY_TO_SHARED);
+	nullspace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_COPY_NULL);
+	pscan = (ParallelHeapScanDesc) shm_toc_lookup(toc, PARALLEL_KEY_COPY_SCAN);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_COPY_QUEUES);
+	if (shared == NULL || nullspace == NULL || pscan == NULL ||
+		queuespace == NULL)
+		elog(ERROR, "invalid parallel COPY state");
+
+	/* The leader holds the lock on the table until we are done */
+	rel = heap_open(shared->relid, NoLock);
+	tupDesc = RelationGetDescr(rel);
+
+	/* Rebuild the leader's options, except for the header line */
+	for (i = 0; i < shared->natts; i++)
+	{
+		CopyToSharedAttr *attr = &shared->attrs[i];
+		Form_pg_attribute att = tupDesc->attrs[attr->attnum - 1];
+		Value	   *attname;
+
+		attname = makeString(pstrdup(NameStr(att->attname)));
+		attnamelist = lappend(attnamelist, attname);
+		if (attr->force_quote)
+			force_quote = lappend(force_quote, attname);
+	}
+
+	if (shared->binary)
+		format = "binary";
+	else if (shared->csv_mode)
+		format = "csv";
+	else
+		format = "text";
+	options = lappend(options,
+					  makeDefElem("format",
+								  (Node *) makeString(pstrdup(format))));
+	options = lappend(options,
+					  makeDefElem("oids",
+								  (Node *) makeInteger(shared->oids)));
+	options = lappend(options,
+					  makeDefElem("encoding",
+			(Node *) makeString(pstrdup(pg_encoding_to_char(shared->file_encoding)))));
+	if (!shared->binary)
+	{
+		options = lappend(options,
+						  makeDefElem("delimiter",
+								(Node *) makeString(pnstrdup(&shared->delim,
+															 1))));
+		options = lappend(options,
+						  makeDefElem("null", (Node *) makeString(nullspace)));
+	}
+	if (shared->csv_mode)
+	{
+		options = lappend(options,
+						  makeDefElem("quote",
+								(Node *) makeString(pnstrdup(&shared->quote,
+															 1))));
+		options = lappend(options,
+						  makeDefElem("escape",
+								(Node *) makeString(pnstrdup(&shared->escape,
+															 1))));
+		if (force_quote != NIL)
+			options = lappend(options,
+							  makeDefElem("force_quote", (Node *) force_quote));
+	}
+
+	cstate = BeginCopy(false, rel, NULL, NULL, InvalidOid, attnamelist,
+					   options);
+	cstate->copy_dest = COPY_PARALLEL;
+	cstate->file_eol = shared->file_eol;
+	cstate->compression = shared->compression;
+	cstate->pscan = pscan;
+	cstate->leader_mqh = AttachParallelLeaderQueue(seg, queuespace,
+												   PARALLEL_COPY_QUEUE_SIZE,
+												   false);
+
+	processed = CopyTo(cstate);
+	EndCopy(cstate);
+
+	SpinLockAcquire(&shared->mutex);
+	shared->processed += processed;
+	SpinLockRelease(&shared->mutex);
+
+	heap_close(rel, NoLock);
+}
+
 
 /*
  * error context callback for COPY FROM
@@ -2182,6 +3300,7 @@ CopyFrom(CopyState cstate)
 	uint64		processed = 0;
 	bool		useHeapMultiInsert;
 	int			nBufferedTuples = 0;
+	int			nworkers;
 
 #define MAX_BUFFERED_TUPLES 1000
 	HeapTuple  *bufferedTuples = NULL;	/* initialize to silence warning */
@@ -2289,6 +3408,13 @@ CopyFrom(CopyState cstate)
 		hi_options |= HEAP_INSERT_FROZEN;
 	}
 
+	/* A parallel COPY FROM worker inserts as its leader decided */
+	if (cstate->pshared)
+	{
+		mycid = cstate->pshared->cid;
+		hi_options = cstate->pshared->hi_options;
+	}
+
 	/*
 	 * We need a ResultRelInfo so we can use the regular executor's
 	 * index-entry-making machinery.  (There used to be a huge amount of code
@@ -2342,9 +3468,11 @@ CopyFrom(CopyState cstate)
 	 * Check BEFORE STATEMENT insertion triggers. It's debatable whether we
 	 * should do this for COPY, since it's not really an "INSERT" statement as
 	 * such. However, executing these triggers maintains consistency with the
-	 * EACH ROW triggers that we already fire on COPY.
+	 * EACH ROW triggers that we already fire on COPY.  In a parallel COPY,
+	 * the leader fires the statement triggers.
 	 */
-	ExecBSInsertTriggers(estate, resultRelInfo);
+	if (!cstate->pshared)
+		ExecBSInsertTriggers(estate, resultRelInfo);
 
 	values = (Datum *) palloc(tupDesc->natts * sizeof(Datum));
 	nulls = (bool *) palloc(tupDesc->natts * sizeof(bool));
@@ -2358,244 +3486,679 @@ CopyFrom(CopyState cstate)
 	errcallback.previous = error_context_stack;
 	error_context_stack = &errcallback;
 
-	for (;;)
+	/*
+	 * Hand the input lines over to parallel workers if we can.  They do
+	 * everything the loop below does, while we only read the input.
+	 */
+	nworkers = CopyFromParallelWorkers(cstate, resultRelInfo);
+	if (nworkers == 0 ||
+		!CopyFromParallel(cstate, nworkers, mycid, hi_options, &processed))
 	{
-		TupleTableSlot *slot;
-		bool		skip_tuple;
-		Oid			loaded_oid = InvalidOid;
+		for (;;)
+		{
+			TupleTableSlot *slot;
+			bool		skip_tuple;
+			Oid			loaded_oid = InvalidOid;
 
-		CHECK_FOR_INTERRUPTS();
+			CHECK_FOR_INTERRUPTS();
+
+			if (nBufferedTuples == 0)
+			{
+				/*
+				 * Reset the per-tuple exprcontext. We can only do this if the
+				 * tuple buffer is empty. (Calling the context the per-tuple
+				 * memory context is a bit of a misnomer now.)
+				 */
+				ResetPerTupleExprContext(estate);
+			}
+
+			/* Switch into its memory context */
+			MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+
+			if (!NextCopyFrom(cstate, econtext, values, nulls, &loaded_oid))
+				break;
+
+			/* And now we can form the input tuple. */
+			tuple = heap_form_tuple(tupDesc, values, nulls);
+
+			if (loaded_oid != InvalidOid)
+				HeapTupleSetOid(tuple, loaded_oid);
 
-		if (nBufferedTuples == 0)
-		{
 			/*
-			 * Reset the per-tuple exprcontext. We can only do this if the
-			 * tuple buffer is empty. (Calling the context the per-tuple
-			 * memory context is a bit of a misnomer now.)
+			 * Constraints might reference the tableoid column, so initialize
+			 * t_tableOid before evaluating them.
 			 */
-			ResetPerTupleExprContext(estate);
+			tuple->t_tableOid =
+				RelationGetRelid(resultRelInfo->ri_RelationDesc);
+
+			/* Triggers and stuff need to be invoked in query context. */
+			MemoryContextSwitchTo(oldcontext);
+
+			/* Place tuple in tuple slot --- but slot shouldn't free it */
+			slot = myslot;
+			ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+
+			skip_tuple = false;
+
+			/* BEFORE ROW INSERT Triggers */
+			if (resultRelInfo->ri_TrigDesc &&
+				resultRelInfo->ri_TrigDesc->trig_insert_before_row)
+			{
+				slot = ExecBRInsertTriggers(estate, resultRelInfo, slot);
+
+				if (slot == NULL)	/* "do nothing" */
+					skip_tuple = true;
+				else	/* trigger might have changed tuple */
+					tuple = ExecMaterializeSlot(slot);
+			}
+
+			if (!skip_tuple)
+			{
+				/* Check the constraints of the tuple */
+				if (cstate->rel->rd_att->constr)
+					ExecConstraints(resultRelInfo, slot, estate);
+
+				if (useHeapMultiInsert)
+				{
+					/* Add this tuple to the tuple buffer */
+					if (nBufferedTuples == 0)
+						firstBufferedLineNo = cstate->cur_lineno;
+					bufferedTuples[nBufferedTuples++] = tuple;
+					bufferedTuplesSize += tuple->t_len;
+
+					/*
+					 * If the buffer filled up, flush it. Also flush if the
+					 * total size of all the tuples in the buffer becomes
+					 * large, to avoid using large amounts of memory for the
+					 * buffers when the tuples are exceptionally wide.
+					 */
+					if (nBufferedTuples == MAX_BUFFERED_TUPLES ||
+						bufferedTuplesSize > 65535)
+					{
+						CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+											resultRelInfo, myslot, bistate,
+											nBufferedTuples, bufferedTuples,
+											firstBufferedLineNo);
+						nBufferedTuples = 0;
+						bufferedTuplesSize = 0;
+					}
+				}
+				else
+				{
+					List	   *recheckIndexes = NIL;
+
+					/* OK, store the tuple and create index entries for it */
+					table_insert(cstate->rel, tuple, mycid, hi_options,
+								 bistate);
+
+					if (resultRelInfo->ri_NumIndices > 0)
+						recheckIndexes = ExecInsertIndexTuples(slot,
+															&(tuple->t_self),
+															   estate, false,
+															   NULL, NIL);
+
+					/* AFTER ROW INSERT Triggers */
+					ExecARInsertTriggers(estate, resultRelInfo, tuple,
+										 recheckIndexes);
+
+					list_free(recheckIndexes);
+				}
+
+				/*
+				 * We count only tuples not suppressed by a BEFORE INSERT
+				 * trigger; this is the same definition used by execMain.c for
+				 * counting tuples inserted by an INSERT command.
+				 */
+				processed++;
+			}
 		}
 
-		/* Switch into its memory context */
-		MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+		/* Flush any remaining buffered tuples */
+		if (nBufferedTuples > 0)
+			CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+								resultRelInfo, myslot, bistate,
+								nBufferedTuples, bufferedTuples,
+								firstBufferedLineNo);
+	}
 
-		if (!NextCopyFrom(cstate, econtext, values, nulls, &loaded_oid))
-			break;
+	/* Done, clean up */
+	error_context_stack = errcallback.previous;
 
-		/* And now we can form the input tuple. */
-		tuple = heap_form_tuple(tupDesc, values, nulls);
+	FreeBulkInsertState(bistate);
 
-		if (loaded_oid != InvalidOid)
-			HeapTupleSetOid(tuple, loaded_oid);
+	MemoryContextSwitchTo(oldcontext);
 
-		/*
-		 * Constraints might reference the tableoid column, so initialize
-		 * t_tableOid before evaluating them.
-		 */
-		tuple->t_tableOid = RelationGetRelid(resultRelInfo->ri_RelationDesc);
+	/*
+	 * In the old protocol, tell pqcomm that we can process normal protocol
+	 * messages again.
+	 */
+	if (cstate->copy_dest == COPY_OLD_FE)
+		pq_endmsgread();
+
+	/* Let the table's access method write out rows it has buffered */
+	table_finish_bulk_insert(cstate->rel, hi_options);
+
+	/* Execute AFTER STATEMENT insertion triggers */
+	if (!cstate->pshared)
+		ExecASInsertTriggers(estate, resultRelInfo);
+
+	/* Handle queued AFTER triggers */
+	AfterTriggerEndQuery(estate);
+
+	pfree(values);
+	pfree(nulls);
+
+	ExecResetTupleTable(estate->es_tupleTable, false);
+
+	ExecCloseIndices(resultRelInfo);
+
+	FreeExecutorState(estate);
+
+	/*
+	 * If we skipped writing WAL, then we need to sync the heap (but not
+	 * indexes since those use WAL anyway).  The leader of a parallel COPY
+	 * does that once its workers are done.
+	 */
+	if ((hi_options & HEAP_INSERT_SKIP_WAL) && !cstate->pshared)
+		table_sync(cstate->rel);
+
+	return processed;
+}
+
+/*
+ * A subroutine of CopyFrom, to write the current batch of buffered heap
+ * tuples to the heap. Also updates indexes and runs AFTER ROW INSERT
+ * triggers.
+ */
+static void
+CopyFromInsertBatch(CopyState cstate, EState *estate, CommandId mycid,
+					int hi_options, ResultRelInfo *resultRelInfo,
+					TupleTableSlot *myslot, BulkInsertState bistate,
+					int nBufferedTuples, HeapTuple *bufferedTuples,
+					int firstBufferedLineNo)
+{
+	MemoryContext oldcontext;
+	int			i;
+	int			save_cur_lineno;
+
+	/*
+	 * Print error context information correctly, if one of the operations
+	 * below fail.
+	 */
+	cstate->line_buf_valid = false;
+	save_cur_lineno = cstate->cur_lineno;
+
+	/*
+	 * heap_multi_insert leaks memory, so switch to short-lived memory context
+	 * before calling it.
+	 */
+	oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	table_multi_insert(cstate->rel,
+					   bufferedTuples,
+					   nBufferedTuples,
+					   mycid,
+					   hi_options,
+					   bistate);
+	MemoryContextSwitchTo(oldcontext);
 
-		/* Triggers and stuff need to be invoked in query context. */
-		MemoryContextSwitchTo(oldcontext);
+	/*
+	 * If there are any indexes, update them for all the inserted tuples, and
+	 * run AFTER ROW INSERT triggers.
+	 */
+	if (resultRelInfo->ri_NumIndices > 0)
+	{
+		List	  **recheckIndexes;
+
+		recheckIndexes = (List **) palloc(nBufferedTuples * sizeof(List *));
+		ExecInsertIndexTuplesBatch(myslot, bufferedTuples, nBufferedTuples,
+								   estate, recheckIndexes,
+								   &cstate->cur_lineno, firstBufferedLineNo);
+		for (i = 0; i < nBufferedTuples; i++)
+		{
+			cstate->cur_lineno = firstBufferedLineNo + i;
+			ExecARInsertTriggers(estate, resultRelInfo,
+								 bufferedTuples[i],
+								 recheckIndexes[i]);
+			list_free(recheckIndexes[i]);
+		}
+		pfree(recheckIndexes);
+	}
+
+	/*
+	 * There's no indexes, but see if we need to run AFTER ROW INSERT triggers
+	 * anyway.
+	 */
+	else if (resultRelInfo->ri_TrigDesc != NULL &&
+			 resultRelInfo->ri_TrigDesc->trig_insert_after_row)
+	{
+		for (i = 0; i < nBufferedTuples; i++)
+		{
+			cstate->cur_lineno = firstBufferedLineNo + i;
+			ExecARInsertTriggers(estate, resultRelInfo,
+								 bufferedTuples[i],
+								 NIL);
+		}
+	}
+
+	/* reset cur_lineno to where we were */
+	cstate->cur_lineno = save_cur_lineno;
+}
+
+/*
+ * Choose the number of parallel workers to load the rows of a COPY FROM
+ * with, or zero to load them ourselves.
+ *
+ * The workers insert the rows in no particular order and see neither each
+ * other's rows nor ours until the command ends, so anything that could
+ * observe the order or the table itself while it's being loaded forces a
+ * serial load: row triggers (including foreign keys), deferred uniqueness
+ * checks, and volatile defaults or check constraints.  nextval() defaults
+ * are among the latter, as sequences can't be advanced in parallel mode.
+ */
+static int
+CopyFromParallelWorkers(CopyState cstate, ResultRelInfo *resultRelInfo)
+{
+	Relation	rel = cstate->rel;
+	TriggerDesc *trigdesc = resultRelInfo->ri_TrigDesc;
+	TupleConstr *constr = RelationGetDescr(rel)->constr;
+	int			i;
+
+	/*
+	 * Workers can't see our temp tables' local buffers, nor assign OIDs to
+	 * rows in a way we could report.  A table access method other than heap
+	 * might keep rows buffered in the backend, and predicate locks are not
+	 * shared with the workers.
+	 */
+	if (cstate->parallel_workers == 0 ||
+		max_parallel_maintenance_workers == 0 ||
+		!IsUnderPostmaster ||
+		cstate->binary ||
+		cstate->file_has_oids ||
+		rel->rd_rel->relhasoids ||
+		rel->rd_rel->relam != InvalidOid ||
+		IsSystemRelation(rel) ||
+		RelationUsesLocalBuffers(rel) ||
+		IsolationIsSerializable() ||
+		IsInParallelMode() ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
 
-		/* Place tuple in tuple slot --- but slot shouldn't free it */
-		slot = myslot;
-		ExecStoreTuple(tuple, slot, InvalidBuffer, false);
+	if (trigdesc != NULL &&
+		(trigdesc->trig_insert_before_row ||
+		 trigdesc->trig_insert_after_row ||
+		 trigdesc->trig_insert_instead_row))
+		return 0;
+
+	for (i = 0; i < resultRelInfo->ri_NumIndices; i++)
+	{
+		if (!resultRelInfo->ri_IndexRelationDescs[i]->rd_index->indimmediate)
+			return 0;
+	}
+
+	for (i = 0; i < cstate->num_defaults; i++)
+	{
+		if (contain_volatile_functions((Node *) cstate->defexprs[i]->expr))
+			return 0;
+	}
+
+	if (constr != NULL)
+	{
+		for (i = 0; i < constr->num_check; i++)
+		{
+			Node	   *ccbin = (Node *) stringToNode(constr->check[i].ccbin);
+
+			if (contain_volatile_functions(ccbin))
+				return 0;
+		}
+	}
+
+	return Min(cstate->parallel_workers, max_parallel_maintenance_workers);
+}
+
+/*
+ * Load the rows of a COPY FROM with the help of nworkers parallel workers,
+ * setting *processed to the number of rows they inserted.  Returns false,
+ * without having read any input, if no worker could be registered.
+ *
+ * We read the input and split it into lines, which takes much less time
+ * than turning them into rows and inserting those, and send the lines to
+ * the workers in chunks through one queue per worker.  We fill one chunk
+ * at a time, and once it is full start sending it without waiting; the
+ * queue is then busy until the send completes, and we move on to the next
+ * queue that isn't.  The workers insert with our transaction ID and
+ * command ID, which must have been assigned and marked used before
+ * entering parallel mode.
+ */
+static bool
+CopyFromParallel(CopyState cstate, int nworkers, CommandId mycid,
+				 int hi_options, uint64 *processed)
+{
+	ParallelContext *pcxt;
+	CopyShared *shared;
+	Size		sharedsize;
+	char	   *nullspace;
+	char	   *queuespace;
+	shm_mq_handle **handles;
+	CopyLeaderQueue *queues;
+	ErrorContextCallback *copycallback;
+	int			nqueues;
+	int			natts = list_length(cstate->attnumlist);
+	int			cur;
+	ListCell   *lc;
+	int			i;
+
+	Assert(nworkers > 0);
+
+	/* the workers can't assign our XID themselves */
+	(void) GetCurrentTransactionId();
+
+	/*
+	 * The workers' errors come with their own COPY context, so leave ours,
+	 * which our caller has just pushed, out of the parallel context's.
+	 */
+	copycallback = error_context_stack;
+	Assert(copycallback->callback == CopyFromErrorCallback);
+	error_context_stack = copycallback->previous;
+	EnterParallelMode();
+	pcxt = CreateParallelContext(CopyFromParallelMain, nworkers);
+	error_context_stack = copycallback;
+
+	/* Estimate and allocate the shared state */
+	sharedsize = add_size(offsetof(CopyShared, attrs),
+						  mul_size(natts, sizeof(CopySharedAttr)));
+	shm_toc_estimate_chunk(&pcxt->estimator, sharedsize);
+	shm_toc_estimate_chunk(&pcxt->estimator, cstate->null_print_len + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+	EstimateParallelQueues(pcxt, PARALLEL_COPY_QUEUE_SIZE);
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (CopyShared *) shm_toc_allocate(pcxt->toc, sharedsize);
+	shared->relid = RelationGetRelid(cstate->rel);
+	shared->cid = mycid;
+	shared->hi_options = hi_options | HEAP_INSERT_PARALLEL;
+	shared->csv_mode = cstate->csv_mode;
+	shared->delim = cstate->delim[0];
+	shared->quote = cstate->csv_mode ? cstate->quote[0] : '\0';
+	shared->escape = cstate->csv_mode ? cstate->escape[0] : '\0';
+	SpinLockInit(&shared->mutex);
+	shared->processed = 0;
+	shared->natts = natts;
+	i = 0;
+	foreach(lc, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(lc);
+		CopySharedAttr *attr = &shared->attrs[i++];
+
+		attr->attnum = attnum;
+		attr->force_notnull = cstate->force_notnull_flags[attnum - 1];
+		attr->force_null = cstate->force_null_flags[attnum - 1];
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_SHARED, shared);
+
+	nullspace = (char *) shm_toc_allocate(pcxt->toc,
+										  cstate->null_print_len + 1);
+	strcpy(nullspace, cstate->null_print);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_NULL, nullspace);
+
+	queuespace = InitializeParallelQueues(pcxt, PARALLEL_KEY_COPY_QUEUES,
+										  PARALLEL_COPY_QUEUE_SIZE, true);
+
+	LaunchParallelWorkers(pcxt);
+
+	handles = (shm_mq_handle **) palloc(nworkers * sizeof(shm_mq_handle *));
+	nqueues = AttachParallelQueues(pcxt, queuespace, PARALLEL_COPY_QUEUE_SIZE,
+								   handles, NULL);
+	queues = (CopyLeaderQueue *) palloc(nworkers * sizeof(CopyLeaderQueue));
+	for (i = 0; i < nqueues; i++)
+	{
+		queues[i].mqh = handles[i];
+		initStringInfo(&queues[i].chunk);
+		queues[i].sending = false;
+	}
+	pfree(handles);
+
+	if (nqueues == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return false;
+	}
+
+	/*
+	 * Split the input into lines as NextCopyFromRawFields does.  Each chunk
+	 * starts with the number of its first line, and each line is preceded
+	 * by its length.
+	 */
+	cur = 0;
+	for (;;)
+	{
+		CopyLeaderQueue *q = &queues[cur];
+		bool		done;
+		int			len;
 
-		skip_tuple = false;
+		CHECK_FOR_INTERRUPTS();
 
-		/* BEFORE ROW INSERT Triggers */
-		if (resultRelInfo->ri_TrigDesc &&
-			resultRelInfo->ri_TrigDesc->trig_insert_before_row)
+		/* on input just throw the header line away */
+		if (cstate->cur_lineno == 0 && cstate->header_line)
 		{
-			slot = ExecBRInsertTriggers(estate, resultRelInfo, slot);
-
-			if (slot == NULL)	/* "do nothing" */
-				skip_tuple = true;
-			else	/* trigger might have changed tuple */
-				tuple = ExecMaterializeSlot(slot);
+			cstate->cur_lineno++;
+			if (CopyReadLine(cstate))
+				break;
 		}
 
-		if (!skip_tuple)
-		{
-			/* Check the constraints of the tuple */
-			if (cstate->rel->rd_att->constr)
-				ExecConstraints(resultRelInfo, slot, estate);
-
-			if (useHeapMultiInsert)
-			{
-				/* Add this tuple to the tuple buffer */
-				if (nBufferedTuples == 0)
-					firstBufferedLineNo = cstate->cur_lineno;
-				bufferedTuples[nBufferedTuples++] = tuple;
-				bufferedTuplesSize += tuple->t_len;
-
-				/*
-				 * If the buffer filled up, flush it. Also flush if the total
-				 * size of all the tuples in the buffer becomes large, to
-				 * avoid using large amounts of memory for the buffers when
-				 * the tuples are exceptionally wide.
-				 */
-				if (nBufferedTuples == MAX_BUFFERED_TUPLES ||
-					bufferedTuplesSize > 65535)
-				{
-					CopyFromInsertBatch(cstate, estate, mycid, hi_options,
-										resultRelInfo, myslot, bistate,
-										nBufferedTuples, bufferedTuples,
-										firstBufferedLineNo);
-					nBufferedTuples = 0;
-					bufferedTuplesSize = 0;
-				}
-			}
-			else
-			{
-				List	   *recheckIndexes = NIL;
-
-				/* OK, store the tuple and create index entries for it */
-				heap_insert(cstate->rel, tuple, mycid, hi_options, bistate);
-
-				if (resultRelInfo->ri_NumIndices > 0)
-					recheckIndexes = ExecInsertIndexTuples(slot, &(tuple->t_self),
-														 estate, false, NULL,
-														   NIL);
+		cstate->cur_lineno++;
+		done = CopyReadLine(cstate);
+		if (done && cstate->line_buf.len == 0)
+			break;
 
-				/* AFTER ROW INSERT Triggers */
-				ExecARInsertTriggers(estate, resultRelInfo, tuple,
-									 recheckIndexes);
+		if (q->chunk.len == 0)
+			appendBinaryStringInfo(&q->chunk, (char *) &cstate->cur_lineno,
+								   sizeof(int));
+		len = cstate->line_buf.len;
+		appendBinaryStringInfo(&q->chunk, (char *) &len, sizeof(int));
+		appendBinaryStringInfo(&q->chunk, cstate->line_buf.data, len);
 
-				list_free(recheckIndexes);
-			}
+		if (q->chunk.len >= PARALLEL_COPY_CHUNK_SIZE)
+			cur = CopyLeaderSendChunk(pcxt, queues, nqueues, cur);
 
-			/*
-			 * We count only tuples not suppressed by a BEFORE INSERT trigger;
-			 * this is the same definition used by execMain.c for counting
-			 * tuples inserted by an INSERT command.
-			 */
-			processed++;
-		}
+		if (done)
+			break;
 	}
 
-	/* Flush any remaining buffered tuples */
-	if (nBufferedTuples > 0)
-		CopyFromInsertBatch(cstate, estate, mycid, hi_options,
-							resultRelInfo, myslot, bistate,
-							nBufferedTuples, bufferedTuples,
-							firstBufferedLineNo);
+	/* Send what's left, then let the workers know that was all */
+	for (i = 0; i < nqueues; i++)
+	{
+		if (queues[i].sending || queues[i].chunk.len > 0)
+			CopyLeaderTrySend(pcxt, queues, nqueues, i, false);
+	}
+	for (i = 0; i < nqueues; i++)
+		shm_mq_detach(shm_mq_get_queue(queues[i].mqh));
 
-	/* Done, clean up */
-	error_context_stack = errcallback.previous;
+	/* This rethrows any error a worker ran into */
+	WaitForParallelWorkersToFinish(pcxt);
 
-	FreeBulkInsertState(bistate);
+	*processed = shared->processed;
 
-	MemoryContextSwitchTo(oldcontext);
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
 
-	/*
-	 * In the old protocol, tell pqcomm that we can process normal protocol
-	 * messages again.
-	 */
-	if (cstate->copy_dest == COPY_OLD_FE)
-		pq_endmsgread();
+	return true;
+}
 
-	/* Execute AFTER STATEMENT insertion triggers */
-	ExecASInsertTriggers(estate, resultRelInfo);
+/*
+ * Start sending the full chunk of queue cur, and return the next queue that
+ * isn't busy sending, waiting for one to become free if need be.
+ */
+static int
+CopyLeaderSendChunk(ParallelContext *pcxt, CopyLeaderQueue *queues,
+					int nqueues, int cur)
+{
+	int			i;
 
-	/* Handle queued AFTER triggers */
-	AfterTriggerEndQuery(estate);
+	queues[cur].sending = true;
+	CopyLeaderTrySend(pcxt, queues, nqueues, cur, true);
 
-	pfree(values);
-	pfree(nulls);
+	for (;;)
+	{
+		for (i = 1; i <= nqueues; i++)
+		{
+			int			next = (cur + i) % nqueues;
 
-	ExecResetTupleTable(estate->es_tupleTable, false);
+			if (queues[next].sending)
+				CopyLeaderTrySend(pcxt, queues, nqueues, next, true);
+			if (!queues[next].sending)
+				return next;
+		}
 
-	ExecCloseIndices(resultRelInfo);
+		/* the workers set our latch as they make room in their queues */
+		WaitLatch(MyLatch, WL_LATCH_SET, 0, WAIT_EVENT_PARALLEL_COPY_SEND);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
 
-	FreeExecutorState(estate);
+/*
+ * Send, or go on sending, the chunk of queue i.  If nowait and the queue is
+ * full, the rest of the chunk is left for the next call.
+ *
+ * A worker that fails detaches from its queue.  Its error is normally
+ * rethrown by CHECK_FOR_INTERRUPTS, but if we get here first, we let the
+ * other workers finish and rethrow it ourselves.
+ */
+static void
+CopyLeaderTrySend(ParallelContext *pcxt, CopyLeaderQueue *queues,
+				  int nqueues, int i, bool nowait)
+{
+	CopyLeaderQueue *q = &queues[i];
+	shm_mq_result res;
 
-	/*
-	 * If we skipped writing WAL, then we need to sync the heap (but not
-	 * indexes since those use WAL anyway)
-	 */
-	if (hi_options & HEAP_INSERT_SKIP_WAL)
-		heap_sync(cstate->rel);
+	res = shm_mq_send(q->mqh, q->chunk.len, q->chunk.data, nowait);
+	if (res == SHM_MQ_WOULD_BLOCK)
+	{
+		q->sending = true;
+		return;
+	}
+	if (res == SHM_MQ_DETACHED)
+	{
+		for (i = 0; i < nqueues; i++)
+			shm_mq_detach(shm_mq_get_queue(queues[i].mqh));
+		WaitForParallelWorkersToFinish(pcxt);
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("parallel COPY worker exited unexpectedly")));
+	}
 
-	return processed;
+	resetStringInfo(&q->chunk);
+	q->sending = false;
 }
 
 /*
- * A subroutine of CopyFrom, to write the current batch of buffered heap
- * tuples to the heap. Also updates indexes and runs AFTER ROW INSERT
- * triggers.
+ * CopyFromParallelMain
+ *
+ * Entry point of a parallel COPY FROM worker: turn the lines the leader
+ * sends us into rows and insert them, as CopyFrom does for a serial COPY.
  */
-static void
-CopyFromInsertBatch(CopyState cstate, EState *estate, CommandId mycid,
-					int hi_options, ResultRelInfo *resultRelInfo,
-					TupleTableSlot *myslot, BulkInsertState bistate,
-					int nBufferedTuples, HeapTuple *bufferedTuples,
-					int firstBufferedLineNo)
+void
+CopyFromParallelMain(dsm_segment *seg, shm_toc *toc)
 {
-	MemoryContext oldcontext;
+	CopyShared *shared;
+	char	   *nullspace;
+	char	   *queuespace;
+	Relation	rel;
+	TupleDesc	tupDesc;
+	List	   *attnamelist = NIL;
+	List	   *options = NIL;
+	List	   *force_notnull = NIL;
+	List	   *force_null = NIL;
+	RangeTblEntry *rte;
+	CopyState	cstate;
+	uint64		processed;
 	int			i;
-	int			save_cur_lineno;
 
-	/*
-	 * Print error context information correctly, if one of the operations
-	 * below fail.
-	 */
-	cstate->line_buf_valid = false;
-	save_cur_lineno = cstate->cur_lineno;
+	shared = (CopyShared *) shm_toc_lookup(toc, PARALLEL_KEY_COPY_SHARED);
+	nullspace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_COPY_NULL);
+	queuespace = (char *) shm_toc_lookup(toc, PARALLEL_KEY_COPY_QUEUES);
+	if (shared == NULL || nullspace == NULL || queuespace == NULL)
+		elog(ERROR, "invalid parallel COPY state");
 
-	/*
-	 * heap_multi_insert leaks memory, so switch to short-lived memory context
-	 * before calling it.
-	 */
-	oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
-	heap_multi_insert(cstate->rel,
-					  bufferedTuples,
-					  nBufferedTuples,
-					  mycid,
-					  hi_options,
-					  bistate);
-	MemoryContextSwitchTo(oldcontext);
+	/* The leader holds the lock on the table until we are done */
+	rel = heap_open(shared->relid, NoLock);
+	tupDesc = RelationGetDescr(rel);
 
 	/*
-	 * If there are any indexes, update them for all the inserted tuples, and
-	 * run AFTER ROW INSERT triggers.
+	 * Rebuild the options the leader parses with.  Its lines are already in
+	 * the server encoding, and it skipped the header line.
 	 */
-	if (resultRelInfo->ri_NumIndices > 0)
+	rte = makeNode(RangeTblEntry);
+	rte->rtekind = RTE_RELATION;
+	rte->relid = shared->relid;
+	rte->relkind = rel->rd_rel->relkind;
+	rte->requiredPerms = ACL_INSERT;
+	for (i = 0; i < shared->natts; i++)
 	{
-		for (i = 0; i < nBufferedTuples; i++)
-		{
-			List	   *recheckIndexes;
-
-			cstate->cur_lineno = firstBufferedLineNo + i;
-			ExecStoreTuple(bufferedTuples[i], myslot, InvalidBuffer, false);
-			recheckIndexes =
-				ExecInsertIndexTuples(myslot, &(bufferedTuples[i]->t_self),
-									  estate, false, NULL, NIL);
-			ExecARInsertTriggers(estate, resultRelInfo,
-								 bufferedTuples[i],
-								 recheckIndexes);
-			list_free(recheckIndexes);
-		}
+		CopySharedAttr *attr = &shared->attrs[i];
+		Form_pg_attribute att = tupDesc->attrs[attr->attnum - 1];
+		Value	   *attname;
+
+		attname = makeString(pstrdup(NameStr(att->attname)));
+		attnamelist = lappend(attnamelist, attname);
+		if (attr->force_notnull)
+			force_notnull = lappend(force_notnull, attname);
+		if (attr->force_null)
+			force_null = lappend(force_null, attname);
+		rte->insertedCols =
+			bms_add_member(rte->insertedCols,
+						   attr->attnum - FirstLowInvalidHeapAttributeNumber);
 	}
 
-	/*
-	 * There's no indexes, but see if we need to run AFTER ROW INSERT triggers
-	 * anyway.
-	 */
-	else if (resultRelInfo->ri_TrigDesc != NULL &&
-			 resultRelInfo->ri_TrigDesc->trig_insert_after_row)
+	options = lappend(options,
+					  makeDefElem("format",
+								  (Node *) makeString(pstrdup(shared->csv_mode ?
+															  "csv" : "text"))));
+	options = lappend(options,
+					  makeDefElem("delimiter",
+								  (Node *) makeString(pnstrdup(&shared->delim,
+															   1))));
+	options = lappend(options,
+					  makeDefElem("null", (Node *) makeString(nullspace)));
+	options = lappend(options,
+					  makeDefElem("encoding",
+					  (Node *) makeString(pstrdup(GetDatabaseEncodingName()))));
+	if (shared->csv_mode)
 	{
-		for (i = 0; i < nBufferedTuples; i++)
-		{
-			cstate->cur_lineno = firstBufferedLineNo + i;
-			ExecARInsertTriggers(estate, resultRelInfo,
-								 bufferedTuples[i],
-								 NIL);
-		}
+		options = lappend(options,
+						  makeDefElem("quote",
+								(Node *) makeString(pnstrdup(&shared->quote,
+															 1))));
+		options = lappend(options,
+						  makeDefElem("escape",
+								(Node *) makeString(pnstrdup(&shared->escape,
+															 1))));
+		if (force_notnull != NIL)
+			options = lappend(options,
+							  makeDefElem("force_not_null",
+										  (Node *) force_notnull));
+		if (force_null != NIL)
+			options = lappend(options,
+							  makeDefElem("force_null", (Node *) force_null));
 	}
 
-	/* reset cur_lineno to where we were */
-	cstate->cur_lineno = save_cur_lineno;
+	cstate = BeginCopyFrom(rel, NULL, false, attnamelist, options);
+	cstate->range_table = list_make1(rte);
+	cstate->pshared = shared;
+	cstate->leader_mqh = AttachParallelLeaderQueue(seg, queuespace,
+												   PARALLEL_COPY_QUEUE_SIZE,
+												   true);
+
+	processed = CopyFrom(cstate);
+	EndCopyFrom(cstate);
+
+	SpinLockAcquire(&shared->mutex);
+	shared->processed += processed;
+	SpinLockRelease(&shared->mutex);
+
+	heap_close(rel, NoLock);
 }
 
 /*
@@ -2726,7 +4289,13 @@ BeginCopyFrom(Relation rel,
 	cstate->num_defaults = num_defaults;
 	cstate->is_program = is_program;
 
-	if (pipe)
+	if (IsParallelWorker())
+	{
+		/* the leader of a parallel COPY sends us the lines, see CopyFrom */
+		Assert(pipe);
+		cstate->copy_dest = COPY_PARALLEL;
+	}
+	else if (pipe)
 	{
 		Assert(!is_program);	/* the grammar does not allow this */
 		if (whereToSendOutput == DestRemote)
@@ -2768,6 +4337,12 @@ BeginCopyFrom(Relation rel,
 				ereport(ERROR,
 						(errcode(ERRCODE_WRONG_OBJECT_TYPE),
 						 errmsg("\"%s\" is a directory", cstate->filename)));
+
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+			/* we read the whole file front to back; ask for more read-ahead */
+			(void) posix_fadvise(fileno(cstate->copy_file), 0, 0,
+								 POSIX_FADV_SEQUENTIAL);
+#endif
 		}
 	}
 
@@ -2830,6 +4405,26 @@ BeginCopyFrom(Relation rel,
 
 		cstate->max_fields = nfields;
 		cstate->raw_fields = (char **) palloc(nfields * sizeof(char *));
+
+		/*
+		 * The fields of columns that won't be converted need not be
+		 * de-escaped either; the OID field is always looked at.
+		 */
+		if (cstate->convert_select_flags)
+		{
+			int			fieldno = cstate->file_has_oids ? 1 : 0;
+			ListCell   *cur;
+
+			cstate->skip_fields = (bool *) palloc0(nfields * sizeof(bool));
+			cstate->skip_fields_len = nfields;
+			foreach(cur, cstate->attnumlist)
+			{
+				int			attnum = lfirst_int(cur);
+
+				cstate->skip_fields[fieldno++] =
+					!cstate->convert_select_flags[attnum - 1];
+			}
+		}
 	}
 
 	MemoryContextSwitchTo(oldcontext);
@@ -3168,6 +4763,9 @@ CopyReadLine(CopyState cstate)
 	/* Mark that encoding conversion hasn't occurred yet */
 	cstate->line_buf_converted = false;
 
+	if (cstate->copy_dest == COPY_PARALLEL)
+		return CopyReadLineFromLeader(cstate);
+
 	/* Parse data and transfer into line_buf */
 	result = CopyReadLineText(cstate);
 
@@ -3243,6 +4841,92 @@ CopyReadLine(CopyState cstate)
 	return result;
 }
 
+/*
+ * CopyReadLineFromLeader - CopyReadLine for a parallel COPY FROM worker
+ *
+ * The leader has already split the input into lines and converted them to
+ * the server encoding, and sends them to us in chunks, see CopyFromParallel.
+ * We set cur_lineno to the line's number in the input.  The leader detaches
+ * from our queue once it has sent all its lines, which we report as EOF.
+ */
+static bool
+CopyReadLineFromLeader(CopyState cstate)
+{
+	int			len;
+
+	while (cstate->chunk_pos >= cstate->chunk_len)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+
+		res = shm_mq_receive(cstate->leader_mqh, &nbytes, &data, false);
+		if (res == SHM_MQ_DETACHED)
+			return true;
+		Assert(res == SHM_MQ_SUCCESS);
+
+		cstate->chunk_data = (char *) data;
+		cstate->chunk_len = nbytes;
+		memcpy(&cstate->chunk_lineno, cstate->chunk_data, sizeof(int));
+		cstate->chunk_pos = sizeof(int);
+	}
+
+	memcpy(&len, cstate->chunk_data + cstate->chunk_pos, sizeof(int));
+	cstate->chunk_pos += sizeof(int);
+	appendBinaryStringInfo(&cstate->line_buf,
+						   cstate->chunk_data + cstate->chunk_pos, len);
+	cstate->chunk_pos += len;
+	cstate->cur_lineno = cstate->chunk_lineno++;
+	cstate->line_buf_converted = true;
+
+	return false;
+}
+
+/*
+ * CopySkipPlain - return the length of the leading run of s[0..len) that
+ * contains none of the characters c1..c4
+ *
+ * The line and field scanners spend most of their time stepping over bytes
+ * that cannot end a line or field.  This lets them consume such runs in bulk,
+ * testing a whole vector of input at once where the platform allows.  Pass
+ * the same character more than once if fewer than four are interesting.
+ */
+static inline int
+CopySkipPlain(const char *s, int len, char c1, char c2, char c3, char c4)
+{
+	int			i = 0;
+
+#ifndef USE_NO_SIMD
+	const Vector8 v1 = vector8_broadcast(c1);
+	const Vector8 v2 = vector8_broadcast(c2);
+	const Vector8 v3 = vector8_broadcast(c3);
+	const Vector8 v4 = vector8_broadcast(c4);
+
+	for (; i + (int) sizeof(Vector8) <= len; i += sizeof(Vector8))
+	{
+		Vector8		chunk = vector8_load(s + i);
+		Vector8		match;
+
+		match = vector8_or(vector8_or(vector8_eq(chunk, v1),
+									  vector8_eq(chunk, v2)),
+						   vector8_or(vector8_eq(chunk, v3),
+									  vector8_eq(chunk, v4)));
+		if (vector8_any(match))
+			break;				/* find the exact position below */
+	}
+#endif
+
+	for (; i < len; i++)
+	{
+		char		c = s[i];
+
+		if (c == c1 || c == c2 || c == c3 || c == c4)
+			break;
+	}
+
+	return i;
+}
+
 /*
  * CopyReadLineText - inner loop of CopyReadLine for text mode
  */
@@ -3340,6 +5024,36 @@ CopyReadLineText(CopyState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip quickly over a run of bytes that can't be special.  Once past
+		 * the first character of the line, only newlines, backslashes (text
+		 * mode) and the quote and escape characters (CSV mode) matter.  We
+		 * can't do this if the encoding allows ASCII bytes inside multibyte
+		 * characters, since those must be stepped over one character at a
+		 * time.
+		 */
+		if (!first_char_in_line && !cstate->encoding_embeds_ascii)
+		{
+			int			nplain;
+
+			if (cstate->csv_mode)
+				nplain = CopySkipPlain(copy_raw_buf + raw_buf_ptr,
+									   copy_buf_len - raw_buf_ptr,
+									   '\n', '\r', quotec, escapec);
+			else
+				nplain = CopySkipPlain(copy_raw_buf + raw_buf_ptr,
+									   copy_buf_len - raw_buf_ptr,
+									   '\n', '\r', '\\', '\\');
+			if (nplain > 0)
+			{
+				raw_buf_ptr += nplain;
+				last_was_esc = false;
+				/* if we used up the buffer, go back to load some more */
+				if (raw_buf_ptr >= copy_buf_len)
+					continue;
+			}
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = raw_buf_ptr;
 		c = copy_raw_buf[raw_buf_ptr++];
@@ -3694,6 +5408,17 @@ CopyReadAttributesText(CopyState cstate)
 		start_ptr = cur_ptr;
 		cstate->raw_fields[fieldno] = output_ptr;
 
+		/* A field that won't be converted only needs its end found */
+		if (fieldno < cstate->skip_fields_len && cstate->skip_fields[fieldno])
+		{
+			found_delim = CopySkipFieldText(cstate, &cur_ptr, line_end_ptr);
+			*output_ptr++ = '\0';
+			fieldno++;
+			if (!found_delim)
+				break;
+			continue;
+		}
+
 		/*
 		 * Scan data for field.
 		 *
@@ -3708,6 +5433,17 @@ CopyReadAttributesText(CopyState cstate)
 		for (;;)
 		{
 			char		c;
+			int			nplain;
+
+			/* Copy any run of characters needing no de-escaping in one go */
+			nplain = CopySkipPlain(cur_ptr, line_end_ptr - cur_ptr,
+								   delimc, '\\', delimc, '\\');
+			if (nplain > 0)
+			{
+				memcpy(output_ptr, cur_ptr, nplain);
+				output_ptr += nplain;
+				cur_ptr += nplain;
+			}
 
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
@@ -3924,6 +5660,17 @@ CopyReadAttributesCSV(CopyState cstate)
 		start_ptr = cur_ptr;
 		cstate->raw_fields[fieldno] = output_ptr;
 
+		/* A field that won't be converted only needs its end found */
+		if (fieldno < cstate->skip_fields_len && cstate->skip_fields[fieldno])
+		{
+			found_delim = CopySkipFieldCSV(cstate, &cur_ptr, line_end_ptr);
+			*output_ptr++ = '\0';
+			fieldno++;
+			if (!found_delim)
+				break;
+			continue;
+		}
+
 		/*
 		 * Scan data for field,
 		 *
@@ -3934,10 +5681,20 @@ CopyReadAttributesCSV(CopyState cstate)
 		for (;;)
 		{
 			char		c;
+			int			nplain;
 
 			/* Not in quote */
 			for (;;)
 			{
+				nplain = CopySkipPlain(cur_ptr, line_end_ptr - cur_ptr,
+									   delimc, quotec, delimc, quotec);
+				if (nplain > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nplain);
+					output_ptr += nplain;
+					cur_ptr += nplain;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -3961,6 +5718,15 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* In quote */
 			for (;;)
 			{
+				nplain = CopySkipPlain(cur_ptr, line_end_ptr - cur_ptr,
+									   escapec, quotec, escapec, quotec);
+				if (nplain > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nplain);
+					output_ptr += nplain;
+					cur_ptr += nplain;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -4027,6 +5793,94 @@ endfield:
 }
 
 
+/*
+ * CopySkipFieldText - step over a text-format field without de-escaping it
+ *
+ * *cur_ptr is advanced past the field and its delimiter, if any.  Returns
+ * true if a delimiter ended the field, false if the end of the line did.
+ */
+static bool
+CopySkipFieldText(CopyState cstate, char **cur_ptr, char *line_end_ptr)
+{
+	char		delimc = cstate->delim[0];
+	char	   *ptr = *cur_ptr;
+	bool		found_delim = false;
+
+	for (;;)
+	{
+		ptr += CopySkipPlain(ptr, line_end_ptr - ptr,
+							 delimc, '\\', delimc, '\\');
+		if (ptr >= line_end_ptr)
+			break;
+		if (*ptr++ == delimc)
+		{
+			found_delim = true;
+			break;
+		}
+		/* a backslash: whatever follows it can't end the field */
+		if (ptr < line_end_ptr)
+			ptr++;
+	}
+
+	*cur_ptr = ptr;
+	return found_delim;
+}
+
+/*
+ * CopySkipFieldCSV - step over a CSV field without de-quoting it
+ *
+ * Works like CopySkipFieldText.  An unterminated quoted field is still an
+ * error, since the line can't be split correctly without knowing its end.
+ */
+static bool
+CopySkipFieldCSV(CopyState cstate, char **cur_ptr, char *line_end_ptr)
+{
+	char		delimc = cstate->delim[0];
+	char		quotec = cstate->quote[0];
+	char		escapec = cstate->escape[0];
+	char	   *ptr = *cur_ptr;
+
+	for (;;)
+	{
+		char		c;
+
+		/* Not in quote */
+		ptr += CopySkipPlain(ptr, line_end_ptr - ptr,
+							 delimc, quotec, delimc, quotec);
+		if (ptr >= line_end_ptr)
+			break;
+		if (*ptr++ == delimc)
+		{
+			*cur_ptr = ptr;
+			return true;
+		}
+
+		/* In quote */
+		for (;;)
+		{
+			ptr += CopySkipPlain(ptr, line_end_ptr - ptr,
+								 escapec, quotec, escapec, quotec);
+			if (ptr >= line_end_ptr)
+				ereport(ERROR,
+						(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+						 errmsg("unterminated CSV quoted field")));
+			c = *ptr++;
+			/* an escaped escape or quote char doesn't end the quote */
+			if (c == escapec && ptr < line_end_ptr &&
+				(*ptr == escapec || *ptr == quotec))
+			{
+				ptr++;
+				continue;
+			}
+			if (c == quotec)
+				break;
+		}
+	}
+
+	*cur_ptr = ptr;
+	return false;
+}
+
 /*
  * Read a binary attribute
  */
@@ -86,6 +86,7 @@ ExecCreateTableAs(CreateTableAsStmt *stmt, const char *queryString,
 	PlannedStmt *plan;
 	QueryDesc  *queryDesc;
 	ScanDirection dir;
+	bool		maintained;
 
 	if (stmt->if_not_exists)
 	{
@@ -127,6 +128,16 @@ ExecCreateTableAs(CreateTableAsStmt *stmt, const char *queryString,
 	}
 	Assert(query->commandType == CMD_SELECT);
 
+	/*
+	 * An incrementally maintained materialized view must not miss changes
+	 * made to its base tables between the snapshot it is filled from and the
+	 * creation of its maintenance triggers.  So lock the tables against
+	 * changes now, and fill it using a snapshot taken after the lock.
+	 */
+	maintained = is_matview && MatViewMaintenanceRequested(into->options);
+	if (maintained)
+		LockMatViewBaseTables(query);
+
 	/*
 	 * For materialized views, lock down security-restricted operations and
 	 * arrange to make GUC variable changes local to this command.  This is
@@ -171,7 +182,7 @@ ExecCreateTableAs(CreateTableAsStmt *stmt, const char *queryString,
 	 * database contents, but let's do it anyway to be parallel to the EXPLAIN
 	 * code path.)
 	 */
-	PushCopiedSnapshot(GetActiveSnapshot());
+	PushCopiedSnapshot(maintained ? GetLatestSnapshot() : GetActiveSnapshot());
 	UpdateActiveSnapshotCommandId();
 
 	/* Create a QueryDesc, redirecting output to our tuple receiver */
@@ -420,6 +431,10 @@ intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
 	 */
 	intoRelationDesc = heap_open(intoRelationAddr.objectId, AccessExclusiveLock);
 
+	/* Set up incremental maintenance, if asked for */
+	if (is_matview && RelationIsIncrementallyMaintained(intoRelationDesc))
+		CreateMatViewMaintenanceTriggers(intoRelationDesc);
+
 	/*
 	 * Check INSERT permission on the constructed table.
 	 *
@@ -43,6 +43,7 @@
 #include "commands/dbcommands_xlog.h"
 #include "commands/defrem.h"
 #include "commands/seclabel.h"
+#include "commands/sequence.h"
 #include "commands/tablespace.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
@@ -895,6 +896,12 @@ dropdb(const char *dbname, bool missing_ok)
 	 */
 	DropDatabaseBuffers(db_id);
 
+	/* Likewise, forget the sizes of its relations */
+	smgrforgetdb(db_id);
+
+	/* ... and the state of its sequences kept in shared memory */
+	SequenceForgetSharedDatabase(db_id);
+
 	/*
 	 * Tell the stats collector to forget it immediately, too.
 	 */
@@ -1170,8 +1177,13 @@ movedb(const char *dbname, const char *tblspcname)
 	 *
 	 * Note: it'd be sufficient to get rid of buffers matching db_id and
 	 * src_tblspcoid, but bufmgr.c presently provides no API for that.
+	 * The same goes for the sizes of the database's relations, and for the
+	 * state of its sequences kept in shared memory (whose pages show states
+	 * beyond any value handed out, so only unused values are lost).
 	 */
 	DropDatabaseBuffers(db_id);
+	smgrforgetdb(db_id);
+	SequenceForgetSharedDatabase(db_id);
 
 	/*
 	 * Check for existence of files in the target directory, i.e., objects of
@@ -2108,6 +2120,9 @@ dbase_redo(XLogReaderState *record)
 		/* Drop pages for this database that are in the shared buffer cache */
 		DropDatabaseBuffers(xlrec->db_id);
 
+		/* and the sizes of its relations */
+		smgrforgetdb(xlrec->db_id);
+
 		/* Also, clean out any fsync requests that might be pending in md.c */
 		ForgetDatabaseFsyncRequests(xlrec->db_id);
 
@@ -320,6 +320,13 @@ does_not_exist_skipping(ObjectType objtype, List *objname, List *objargs)
 				name = NameListToString(objname);
 			}
 			break;
+		case OBJECT_STATISTIC_EXT:
+			if (!schema_does_not_exist_skipping(objname, &msg, &name))
+			{
+				msg = gettext_noop("statistics object \"%s\" does not exist, skipping");
+				name = NameListToString(objname);
+			}
+			break;
 		case OBJECT_EXTENSION:
 			msg = gettext_noop("extension \"%s\" does not exist, skipping");
 			name = NameListToString(objname);
@@ -396,6 +403,10 @@ does_not_exist_skipping(ObjectType objtype, List *objname, List *objargs)
 			msg = gettext_noop("event trigger \"%s\" does not exist, skipping");
 			name = NameListToString(objname);
 			break;
+		case OBJECT_PUBLICATION:
+			msg = gettext_noop("publication \"%s\" does not exist, skipping");
+			name = NameListToString(objname);
+			break;
 		case OBJECT_RULE:
 			if (!owningrel_does_not_exist_skipping(objname, &msg, &name))
 			{
@@ -29,6 +29,7 @@
 #include "utils/builtins.h"
 #include "utils/json.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
@@ -78,6 +79,8 @@ static void show_upper_qual(List *qual, const char *qlabel,
 				ExplainState *es);
 static void show_sort_keys(SortState *sortstate, List *ancestors,
 			   ExplainState *es);
+static void show_incremental_sort_keys(IncrementalSortState *incrsortstate,
+						   List *ancestors, ExplainState *es);
 static void show_merge_append_keys(MergeAppendState *mstate, List *ancestors,
 					   ExplainState *es);
 static void show_agg_keys(AggState *astate, List *ancestors,
@@ -99,11 +102,18 @@ static void show_sortorder_options(StringInfo buf, Node *sortexpr,
 static void show_tablesample(TableSampleClause *tsc, PlanState *planstate,
 				 List *ancestors, ExplainState *es);
 static void show_sort_info(SortState *sortstate, ExplainState *es);
+static void show_incremental_sort_info(IncrementalSortState *incrsortstate,
+						   ExplainState *es);
 static void show_hash_info(HashState *hashstate, ExplainState *es);
+static void show_memory_info(PlanState *planstate, ExplainState *es);
+static void show_hashagg_info(AggState *aggstate, ExplainState *es);
+static void show_memoize_info(MemoizeState *mstate, List *ancestors,
+				  ExplainState *es);
 static void show_tidbitmap_info(BitmapHeapScanState *planstate,
 					ExplainState *es);
 static void show_instrumentation_count(const char *qlabel, int which,
 						   PlanState *planstate, ExplainState *es);
+static void show_runtime_filter(ScanState *scanstate, ExplainState *es);
 static void show_foreignscan_info(ForeignScanState *fsstate, ExplainState *es);
 static const char *explain_get_index_name(Oid indexId);
 static void ExplainIndexScanDetails(Oid indexid, ScanDirection indexorderdir,
@@ -113,7 +123,7 @@ static void ExplainModifyTarget(ModifyTable *plan, ExplainState *es);
 static void ExplainTargetRel(Plan *plan, Index rti, ExplainState *es);
 static void show_modifytable_info(ModifyTableState *mtstate, List *ancestors,
 					  ExplainState *es);
-static void ExplainMemberNodes(List *plans, PlanState **planstates,
+static void ExplainMemberNodes(PlanState **planstates, int nplans,
 				   List *ancestors, ExplainState *es);
 static void ExplainSubPlans(List *plans, List *ancestors,
 				const char *relationship, ExplainState *es);
@@ -161,6 +171,8 @@ ExplainQuery(ExplainStmt *stmt, const char *queryString,
 			es->costs = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "buffers") == 0)
 			es->buffers = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "memory") == 0)
+			es->memory = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "timing") == 0)
 		{
 			timing_set = true;
@@ -196,6 +208,11 @@ ExplainQuery(ExplainStmt *stmt, const char *queryString,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("EXPLAIN option BUFFERS requires ANALYZE")));
 
+	if (es->memory && !es->analyze)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("EXPLAIN option MEMORY requires ANALYZE")));
+
 	/* if the timing was not set explicitly, set default value */
 	es->timing = (timing_set) ? es->timing : es->analyze;
 
@@ -448,6 +465,8 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 
 	if (es->buffers)
 		instrument_option |= INSTRUMENT_BUFFERS;
+	if (es->memory)
+		instrument_option |= INSTRUMENT_MEMORY;
 
 	/*
 	 * We always collect timing for the entire statement, even when node-level
@@ -821,8 +840,9 @@ ExplainPreScanNode(PlanState *planstate, Bitmapset **rels_used)
  * Prescan the constituent plans of a ModifyTable, Append, MergeAppend,
  * BitmapAnd, or BitmapOr node.
  *
- * Note: we don't actually need to examine the Plan list members, but
- * we need the list in order to determine the length of the PlanState array.
+ * nplans is the length of the PlanState array.  For Append and MergeAppend
+ * that can be less than the length of the Plan's list, if some subplans
+ * were removed by run-time pruning at executor startup.
  */
 static void
 ExplainPreScanMemberNodes(List *plans, PlanState **planstates,
@@ -984,9 +1004,15 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		case T_Material:
 			pname = sname = "Materialize";
 			break;
+		case T_Memoize:
+			pname = sname = "Memoize";
+			break;
 		case T_Sort:
 			pname = sname = "Sort";
 			break;
+		case T_IncrementalSort:
+			pname = sname = "Incremental Sort";
+			break;
 		case T_Group:
 			pname = sname = "Group";
 			break;
@@ -1011,6 +1037,10 @@ ExplainNode(PlanState *planstate, List *ancestors,
 					strategy = "???";
 					break;
 			}
+			if (!((Agg *) plan)->finalizeAggs)
+				pname = psprintf("Partial %s", pname);
+			else if (((Agg *) plan)->combineStates)
+				pname = psprintf("Finalize %s", pname);
 			break;
 		case T_WindowAgg:
 			pname = sname = "WindowAgg";
@@ -1362,6 +1392,7 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			if (plan->qual)
 				show_instrumentation_count("Rows Removed by Filter", 1,
 										   planstate, es);
+			show_runtime_filter((ScanState *) planstate, es);
 			break;
 		case T_FunctionScan:
 			if (es->verbose)
@@ -1464,6 +1495,8 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			if (plan->qual)
 				show_instrumentation_count("Rows Removed by Filter", 1,
 										   planstate, es);
+			if (es->analyze)
+				show_hashagg_info((AggState *) planstate, es);
 			break;
 		case T_Group:
 			show_group_keys((GroupState *) planstate, ancestors, es);
@@ -1476,9 +1509,28 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			show_sort_keys((SortState *) planstate, ancestors, es);
 			show_sort_info((SortState *) planstate, es);
 			break;
+		case T_IncrementalSort:
+			show_incremental_sort_keys((IncrementalSortState *) planstate,
+									   ancestors, es);
+			show_incremental_sort_info((IncrementalSortState *) planstate,
+									   es);
+			break;
+		case T_Memoize:
+			show_memoize_info((MemoizeState *) planstate, ancestors, es);
+			break;
+		case T_Append:
+			if (((AppendState *) planstate)->as_nremoved > 0)
+				ExplainPropertyInteger("Subplans Removed",
+									((AppendState *) planstate)->as_nremoved,
+									   es);
+			break;
 		case T_MergeAppend:
 			show_merge_append_keys((MergeAppendState *) planstate,
 								   ancestors, es);
+			if (((MergeAppendState *) planstate)->ms_nremoved > 0)
+				ExplainPropertyInteger("Subplans Removed",
+								((MergeAppendState *) planstate)->ms_nremoved,
+									   es);
 			break;
 		case T_Result:
 			show_upper_qual((List *) ((Result *) plan)->resconstantqual,
@@ -1499,6 +1551,10 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			break;
 	}
 
+	/* Show peak memory and temp file usage */
+	if (es->memory && planstate->instrument)
+		show_memory_info(planstate, es);
+
 	/* Show buffer usage */
 	if (es->buffers && planstate->instrument)
 	{
@@ -1643,28 +1699,28 @@ ExplainNode(PlanState *planstate, List *ancestors,
 	switch (nodeTag(plan))
 	{
 		case T_ModifyTable:
-			ExplainMemberNodes(((ModifyTable *) plan)->plans,
-							   ((ModifyTableState *) planstate)->mt_plans,
+			ExplainMemberNodes(((ModifyTableState *) planstate)->mt_plans,
+							   list_length(((ModifyTable *) plan)->plans),
 							   ancestors, es);
 			break;
 		case T_Append:
-			ExplainMemberNodes(((Append *) plan)->appendplans,
-							   ((AppendState *) planstate)->appendplans,
+			ExplainMemberNodes(((AppendState *) planstate)->appendplans,
+							   ((AppendState *) planstate)->as_nplans,
 							   ancestors, es);
 			break;
 		case T_MergeAppend:
-			ExplainMemberNodes(((MergeAppend *) plan)->mergeplans,
-							   ((MergeAppendState *) planstate)->mergeplans,
+			ExplainMemberNodes(((MergeAppendState *) planstate)->mergeplans,
+							   ((MergeAppendState *) planstate)->ms_nplans,
 							   ancestors, es);
 			break;
 		case T_BitmapAnd:
-			ExplainMemberNodes(((BitmapAnd *) plan)->bitmapplans,
-							   ((BitmapAndState *) planstate)->bitmapplans,
+			ExplainMemberNodes(((BitmapAndState *) planstate)->bitmapplans,
+							   list_length(((BitmapAnd *) plan)->bitmapplans),
 							   ancestors, es);
 			break;
 		case T_BitmapOr:
-			ExplainMemberNodes(((BitmapOr *) plan)->bitmapplans,
-							   ((BitmapOrState *) planstate)->bitmapplans,
+			ExplainMemberNodes(((BitmapOrState *) planstate)->bitmapplans,
+							   list_length(((BitmapOr *) plan)->bitmapplans),
 							   ancestors, es);
 			break;
 		case T_SubqueryScan:
@@ -1830,6 +1886,27 @@ show_sort_keys(SortState *sortstate, List *ancestors, ExplainState *es)
 						 ancestors, es);
 }
 
+/*
+ * Likewise, for an IncrementalSort node; we also show the leading keys that
+ * the input is already sorted by.
+ */
+static void
+show_incremental_sort_keys(IncrementalSortState *incrsortstate,
+						   List *ancestors, ExplainState *es)
+{
+	IncrementalSort *plan = (IncrementalSort *) incrsortstate->ss.ps.plan;
+
+	show_sort_group_keys((PlanState *) incrsortstate, "Sort Key",
+						 plan->sort.numCols, plan->sort.sortColIdx,
+						 plan->sort.sortOperators, plan->sort.collations,
+						 plan->sort.nullsFirst,
+						 ancestors, es);
+	show_sort_group_keys((PlanState *) incrsortstate, "Presorted Key",
+						 plan->presortedCols, plan->sort.sortColIdx,
+						 NULL, NULL, NULL,
+						 ancestors, es);
+}
+
 /*
  * Likewise, for a MergeAppend node.
  */
@@ -2196,6 +2273,36 @@ show_sort_info(SortState *sortstate, ExplainState *es)
 	}
 }
 
+/*
+ * If it's EXPLAIN ANALYZE, show the number of batches an incremental sort
+ * node sorted and the space used by the largest of them
+ */
+static void
+show_incremental_sort_info(IncrementalSortState *incrsortstate,
+						   ExplainState *es)
+{
+	Assert(IsA(incrsortstate, IncrementalSortState));
+	if (es->analyze && incrsortstate->n_batches > 0)
+	{
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			appendStringInfoSpaces(es->str, es->indent * 2);
+			appendStringInfo(es->str, "Sort Batches: %ld  Peak %s: %ldkB\n",
+							 incrsortstate->n_batches,
+							 incrsortstate->peakSpaceType,
+							 incrsortstate->peakSpaceUsed);
+		}
+		else
+		{
+			ExplainPropertyLong("Sort Batches", incrsortstate->n_batches, es);
+			ExplainPropertyLong("Peak Sort Space Used",
+								incrsortstate->peakSpaceUsed, es);
+			ExplainPropertyText("Peak Sort Space Type",
+								incrsortstate->peakSpaceType, es);
+		}
+	}
+}
+
 /*
  * Show information on hash buckets/batches.
  */
@@ -2244,6 +2351,206 @@ show_hash_info(HashState *hashstate, ExplainState *es)
 	}
 }
 
+/*
+ * Show the peak memory of the contexts holding a node's working data, and
+ * how much it read from and wrote to temp files.
+ *
+ * Only nodes with a context of their own report memory; the expression
+ * contexts every node has are reset per tuple and not interesting.  The
+ * temp file numbers include those of the node's children, like the buffer
+ * counts do.
+ */
+static void
+show_memory_info(PlanState *planstate, ExplainState *es)
+{
+	const BufferUsage *usage = &planstate->instrument->bufusage;
+	bool		have_memory = true;
+	Size		peak = 0;
+
+	switch (nodeTag(planstate))
+	{
+		case T_SortState:
+			{
+				SortState  *sortstate = (SortState *) planstate;
+
+				if (sortstate->tuplesortstate != NULL)
+					peak = tuplesort_get_peak_memory((Tuplesortstate *) sortstate->tuplesortstate);
+				else
+					have_memory = false;
+			}
+			break;
+		case T_IncrementalSortState:
+			peak = ((IncrementalSortState *) planstate)->peakMemory;
+			break;
+		case T_HashState:
+			{
+				HashJoinTable hashtable = ((HashState *) planstate)->hashtable;
+
+				if (hashtable != NULL)
+					peak = MemoryContextMemPeak(hashtable->hashCxt, true);
+				else
+					have_memory = false;
+			}
+			break;
+		case T_AggState:
+			{
+				AggState   *aggstate = (AggState *) planstate;
+				int			i;
+
+				for (i = 0; i < aggstate->maxsets; i++)
+					peak += MemoryContextMemPeak(aggstate->aggcontexts[i]->ecxt_per_tuple_memory,
+												 true);
+			}
+			break;
+		case T_WindowAggState:
+			{
+				WindowAggState *winstate = (WindowAggState *) planstate;
+
+				peak = MemoryContextMemPeak(winstate->partcontext, true) +
+					MemoryContextMemPeak(winstate->aggcontext, true);
+			}
+			break;
+		case T_SetOpState:
+			{
+				SetOpState *setopstate = (SetOpState *) planstate;
+
+				if (setopstate->tableContext != NULL)
+					peak = MemoryContextMemPeak(setopstate->tableContext, true);
+				else
+					have_memory = false;
+			}
+			break;
+		case T_RecursiveUnionState:
+			{
+				RecursiveUnionState *rustate = (RecursiveUnionState *) planstate;
+
+				if (rustate->tableContext != NULL)
+					peak = MemoryContextMemPeak(rustate->tableContext, true);
+				else
+					have_memory = false;
+			}
+			break;
+		case T_MemoizeState:
+			peak = MemoryContextMemPeak(((MemoizeState *) planstate)->tablecxt,
+										true);
+			break;
+		default:
+			have_memory = false;
+			break;
+	}
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		if (have_memory)
+		{
+			appendStringInfoSpaces(es->str, es->indent * 2);
+			appendStringInfo(es->str, "Peak Memory: %ldkB\n",
+							 (long) ((peak + 1023) / 1024));
+		}
+		if (usage->temp_bytes_read > 0 || usage->temp_bytes_written > 0)
+		{
+			appendStringInfoSpaces(es->str, es->indent * 2);
+			appendStringInfo(es->str,
+							 "Temp Files: read=" INT64_FORMAT "kB written=" INT64_FORMAT "kB",
+							 (usage->temp_bytes_read + 1023) / 1024,
+							 (usage->temp_bytes_written + 1023) / 1024);
+			/* with compression, also show how much there was to write */
+			if (usage->temp_bytes_raw_written != usage->temp_bytes_written)
+				appendStringInfo(es->str, " (uncompressed=" INT64_FORMAT "kB)",
+							 (usage->temp_bytes_raw_written + 1023) / 1024);
+			appendStringInfoChar(es->str, '\n');
+		}
+	}
+	else
+	{
+		if (have_memory)
+			ExplainPropertyLong("Peak Memory", (long) ((peak + 1023) / 1024),
+								es);
+		ExplainPropertyLong("Temp Read",
+							(long) ((usage->temp_bytes_read + 1023) / 1024), es);
+		ExplainPropertyLong("Temp Written",
+						  (long) ((usage->temp_bytes_written + 1023) / 1024),
+							es);
+		if (usage->temp_bytes_raw_written != usage->temp_bytes_written)
+			ExplainPropertyLong("Temp Written Uncompressed",
+					  (long) ((usage->temp_bytes_raw_written + 1023) / 1024),
+								es);
+	}
+}
+
+/*
+ * Show how a hashed aggregation spilled to disk, if it did
+ */
+static void
+show_hashagg_info(AggState *aggstate, ExplainState *es)
+{
+	long		memPeakKb = (aggstate->hash_mem_peak + 1023) / 1024;
+
+	if (aggstate->hash_batches_used <= 1)
+		return;
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainPropertyLong("HashAgg Batches", aggstate->hash_batches_used, es);
+		ExplainPropertyLong("Peak Memory Usage", memPeakKb, es);
+	}
+	else
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str, "Batches: %d  Memory Usage: %ldkB\n",
+						 aggstate->hash_batches_used, memPeakKb);
+	}
+}
+
+/*
+ * Show the cache keys of a Memoize node, and for EXPLAIN ANALYZE, how well
+ * the cache did.
+ */
+static void
+show_memoize_info(MemoizeState *mstate, List *ancestors, ExplainState *es)
+{
+	Memoize    *plan = (Memoize *) mstate->ps.plan;
+	List	   *context;
+	List	   *result = NIL;
+	bool		useprefix;
+	ListCell   *lc;
+
+	/* Set up deparsing context */
+	context = set_deparse_context_planstate(es->deparse_cxt,
+											(Node *) mstate,
+											ancestors);
+	useprefix = (list_length(es->rtable) > 1 || es->verbose);
+
+	foreach(lc, plan->param_exprs)
+		result = lappend(result,
+						 deparse_expression((Node *) lfirst(lc), context,
+											useprefix, false));
+
+	ExplainPropertyList("Cache Key", result, es);
+
+	if (!es->analyze)
+		return;
+
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainPropertyLong("Cache Hits", mstate->cache_hits, es);
+		ExplainPropertyLong("Cache Misses", mstate->cache_misses, es);
+		ExplainPropertyLong("Cache Evictions", mstate->cache_evictions, es);
+		ExplainPropertyLong("Cache Overflows", mstate->cache_overflows, es);
+		ExplainPropertyLong("Peak Memory Usage",
+							(mstate->mem_peak + 1023) / 1024, es);
+	}
+	else if (mstate->cache_hits > 0 || mstate->cache_misses > 0)
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str,
+						 "Hits: %ld  Misses: %ld  Evictions: %ld  Overflows: %ld  Memory Usage: %ldkB\n",
+						 mstate->cache_hits, mstate->cache_misses,
+						 mstate->cache_evictions, mstate->cache_overflows,
+						 (long) ((mstate->mem_peak + 1023) / 1024));
+	}
+}
+
 /*
  * If it's EXPLAIN ANALYZE, show exact/lossy pages for a BitmapHeapScan node
  */
@@ -2301,6 +2608,33 @@ show_instrumentation_count(const char *qlabel, int which,
 	}
 }
 
+/*
+ * Show how many rows a runtime filter pushed down from a hash join removed,
+ * in the same way as show_instrumentation_count.
+ */
+static void
+show_runtime_filter(ScanState *scanstate, ExplainState *es)
+{
+	RuntimeFilterState *filter = scanstate->ss_runtimeFilter;
+	double		nloops;
+
+	if (filter == NULL || !es->analyze || !scanstate->ps.instrument)
+		return;
+
+	nloops = scanstate->ps.instrument->nloops;
+
+	/* In text mode, suppress zero counts; they're not interesting enough */
+	if (filter->nfiltered > 0 || es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		if (nloops > 0)
+			ExplainPropertyFloat("Rows Removed by Runtime Filter",
+								 filter->nfiltered / nloops, 0, es);
+		else
+			ExplainPropertyFloat("Rows Removed by Runtime Filter",
+								 0.0, 0, es);
+	}
+}
+
 /*
  * Show extra information for a ForeignScan node.
  */
@@ -2673,14 +3007,14 @@ show_modifytable_info(ModifyTableState *mtstate, List *ancestors,
  * The ancestors list should already contain the immediate parent of these
  * plans.
  *
- * Note: we don't actually need to examine the Plan list members, but
- * we need the list in order to determine the length of the PlanState array.
+ * nplans is the length of the PlanState array.  For Append and MergeAppend
+ * that can be less than the length of the Plan's list, if some subplans
+ * were removed by run-time pruning at executor startup.
  */
 static void
-ExplainMemberNodes(List *plans, PlanState **planstates,
+ExplainMemberNodes(PlanState **planstates, int nplans,
 				   List *ancestors, ExplainState *es)
 {
-	int			nplans = list_length(plans);
 	int			j;
 
 	for (j = 0; j < nplans; j++)
@@ -14,29 +14,51 @@
  */
 #include "postgres.h"
 
+#include "access/genam.h"
 #include "access/htup_details.h"
 #include "access/multixact.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
+#include "catalog/dependency.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_depend.h"
+#include "catalog/pg_inherits_fn.h"
+#include "catalog/pg_namespace.h"
 #include "catalog/pg_operator.h"
+#include "catalog/pg_trigger.h"
+#include "catalog/pg_type.h"
 #include "commands/cluster.h"
+#include "commands/defrem.h"
 #include "commands/matview.h"
 #include "commands/tablecmds.h"
 #include "commands/tablespace.h"
+#include "commands/trigger.h"
 #include "executor/executor.h"
 #include "executor/spi.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/tlist.h"
 #include "parser/parse_relation.h"
+#include "parser/parser.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/lmgr.h"
+#include "storage/proc.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"
+#include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 #include "utils/typcache.h"
@@ -55,12 +77,78 @@ typedef struct
 
 static int	matview_maintenance_depth = 0;
 
+/*
+ * What incremental maintenance needs to know about a matview's query; see
+ * mv_analyze_query.
+ */
+typedef struct MatViewDef
+{
+	List	   *baserels;		/* OIDs of the base tables */
+	bool		aggregated;		/* does the query aggregate its rows? */
+	bool		grouped;		/* ... by GROUP BY expressions? */
+	char	   *colkinds;		/* MV_COL_xxx, per matview column */
+	AttrNumber *countcols;		/* for MV_COL_SUM, the matching count column */
+	AttrNumber	countstar;		/* count(*) column, or 0 if none */
+} MatViewDef;
+
+#define MV_COL_PLAIN		'p' /* plain column, or a GROUP BY expression */
+#define MV_COL_COUNT_STAR	'*' /* count(*) */
+#define MV_COL_COUNT		'c' /* count(expr) */
+#define MV_COL_SUM			's' /* sum(expr) */
+
+/*
+ * Prepared statements used for incremental maintenance.  A matview's own
+ * cache entry holds the statements that change the matview; the entry for
+ * each of its base tables holds the statement computing a changed row's
+ * contribution to the matview (in plans[MV_PLAN_DELTA]).
+ */
+#define MV_PLAN_DELTA		0	/* rows derived from a base table row */
+#define MV_PLAN_INSERT		1	/* add a row */
+#define MV_PLAN_DELETE		2	/* remove one copy of a row */
+#define MV_PLAN_ADD			3	/* add to a group's aggregates */
+#define MV_PLAN_SUBTRACT	4	/* subtract from a group's aggregates */
+#define MV_PLAN_DROP_GROUP	5	/* remove a group that has no rows left */
+#define MV_PLAN_CLEAR		6	/* remove all rows */
+#define MV_PLAN_FILL		7	/* recompute all rows */
+#define MV_NUM_PLANS		8
+
+typedef struct MatViewMaintKey
+{
+	Oid			matviewid;		/* the matview */
+	Oid			baserelid;		/* a base table, or InvalidOid */
+} MatViewMaintKey;
+
+typedef struct MatViewMaintEntry
+{
+	MatViewMaintKey key;		/* hash key, must be first */
+	bool		valid;			/* false after a relcache invalidation */
+	bool		aggregated;		/* copied from the MatViewDef */
+	bool		grouped;
+	SPIPlanPtr	plans[MV_NUM_PLANS];	/* saved plans, or NULL */
+} MatViewMaintEntry;
+
+static HTAB *mv_maint_cache = NULL;
+
+/*
+ * Base table changes made by each command of the current transaction, for
+ * mv_check_command.
+ */
+typedef struct MatViewCommandChange
+{
+	Oid			matviewid;
+	CommandId	cid;
+	Oid			baserelid;
+} MatViewCommandChange;
+
+static List *mv_command_changes = NIL;
+static LocalTransactionId mv_command_changes_lxid = InvalidLocalTransactionId;
+
 static void transientrel_startup(DestReceiver *self, int operation, TupleDesc typeinfo);
 static void transientrel_receive(TupleTableSlot *slot, DestReceiver *self);
 static void transientrel_shutdown(DestReceiver *self);
 static void transientrel_destroy(DestReceiver *self);
 static void refresh_matview_datafill(DestReceiver *dest, Query *query,
-						 const char *queryString);
+						 const char *queryString, bool latest);
 
 static char *make_temptable_name_n(char *tempname, int n);
 static void mv_GenerateOper(StringInfo buf, Oid opoid);
@@ -72,6 +160,29 @@ static void refresh_by_heap_swap(Oid matviewOid, Oid OIDNewHeap, char relpersist
 static void OpenMatViewIncrementalMaintenance(void);
 static void CloseMatViewIncrementalMaintenance(void);
 
+static Query *get_matview_query(Relation matviewRel);
+static void mv_not_maintainable(Relation matviewRel, const char *detail);
+static bool mv_check_vars_walker(Node *node, void *context);
+static MatViewDef *mv_analyze_query(Relation matviewRel, Query *query);
+static void mv_create_trigger(Oid matviewOid, Oid baserelid, bool row);
+static void mv_InvalidateCallback(Datum arg, Oid relid);
+static MatViewMaintEntry *mv_get_entry(Relation matviewRel, Relation baseRel);
+static void mv_build_plans(MatViewMaintEntry *entry, Relation matviewRel,
+			   Relation baseRel);
+static SPIPlanPtr mv_prepare(const char *sql, int nargs, Oid *argtypes,
+		   int cursorOptions);
+static char *mv_delta_query(Query *query, Relation baseRel);
+static void mv_append_match(StringInfo buf, Relation matviewRel,
+				AttrNumber attnum);
+static uint32 mv_execute(SPIPlanPtr plan, Datum *values, const char *nulls,
+		   int expected);
+static void mv_check_command(Relation matviewRel, Oid baserelid,
+				 CommandId cid);
+static void mv_apply_row(Relation matviewRel, MatViewMaintEntry *mventry,
+			 MatViewMaintEntry *baseentry, Relation baseRel,
+			 HeapTuple tuple, Snapshot snapshot, bool inserted);
+static void mv_out_of_step(Relation matviewRel);
+
 /*
  * SetMatViewPopulatedState
  *		Mark a materialized view as populated, or not.
@@ -281,7 +392,8 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 
 	/* Generate the data, if wanted. */
 	if (!stmt->skipData)
-		refresh_matview_datafill(dest, dataQuery, queryString);
+		refresh_matview_datafill(dest, dataQuery, queryString,
+								 RelationIsIncrementallyMaintained(matviewRel));
 
 	heap_close(matviewRel, NoLock);
 
@@ -319,10 +431,15 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 
 /*
  * refresh_matview_datafill
+ *
+ * If latest is true, the data is generated with the latest snapshot rather
+ * than the statement's.  An incrementally maintained matview needs this: a
+ * change committed after our statement started has been applied only to the
+ * old contents, and would otherwise be lost.
  */
 static void
 refresh_matview_datafill(DestReceiver *dest, Query *query,
-						 const char *queryString)
+						 const char *queryString, bool latest)
 {
 	List	   *rewritten;
 	PlannedStmt *plan;
@@ -351,7 +468,7 @@ refresh_matview_datafill(DestReceiver *dest, Query *query,
 	 * the planner executed an allegedly-stable function that changed the
 	 * database contents, but let's do it anyway to be safe.)
 	 */
-	PushCopiedSnapshot(GetActiveSnapshot());
+	PushCopiedSnapshot(latest ? GetLatestSnapshot() : GetActiveSnapshot());
 	UpdateActiveSnapshotCommandId();
 
 	/* Create a QueryDesc, redirecting output to our tuple receiver */
@@ -653,10 +770,10 @@ refresh_by_match_merge(Oid matviewOid, Oid tempOid, Oid relowner,
 			RelationGetIndexExpressions(indexRel) == NIL &&
 			RelationGetIndexPredicate(indexRel) == NIL)
 		{
-			int			numatts = indexStruct->indnatts;
+			int			numatts = indexStruct->indnkeyatts;
 			int			i;
 
-			/* Add quals for all columns from this index. */
+			/* Add quals for all key columns from this index. */
 			for (i = 0; i < numatts; i++)
 			{
 				int			attnum = indexStruct->indkey.values[i];
@@ -805,3 +922,1148 @@ CloseMatViewIncrementalMaintenance(void)
 	matview_maintenance_depth--;
 	Assert(matview_maintenance_depth >= 0);
 }
+
+
+/*
+ * Incremental maintenance
+ *
+ * A materialized view with the incremental_maintenance option is kept up to
+ * date by internal AFTER triggers on its base tables, instead of waiting for
+ * REFRESH.  For each changed base table row, the trigger computes the rows
+ * that row contributes to the view, by running the view's query with the
+ * base table replaced by the single row, and removes or adds them.  That is
+ * supported for inner joins of plain tables, optionally aggregated with
+ * count() and sum():
+ *
+ * - Without aggregates, the view is a multiset of rows, so a deleted base
+ *	 row removes one copy of each row it contributed and an inserted one adds
+ *	 them.
+ *
+ * - With aggregates, the contribution is a row per affected group, holding
+ *	 the aggregates over just the changed row.  Those are added to or
+ *	 subtracted from the group's row; a new group gets a row of its own, and
+ *	 a group whose count(*) drops to zero is removed.  sum(x) is NULL for a
+ *	 group without non-null x, so it needs a count(x) beside it to notice
+ *	 that.
+ *
+ * An UPDATE is applied as a delete followed by an insert, and TRUNCATE by
+ * recomputing the whole view.
+ *
+ * The other base tables must be seen as they were before the command that
+ * changed the row: a later command of the same transaction, for instance in
+ * another trigger, may already have applied its own changes joined with the
+ * new state of this table.  So the query runs with a snapshot whose command
+ * ID is that of the changing command, which also means a single command must
+ * not change two base tables of a view; that is detected and rejected.
+ *
+ * Maintenance takes an ExclusiveLock on the view, so concurrent writers of
+ * its base tables are serialized, and uses the latest snapshot, so that a
+ * writer sees the committed changes of those it waited for.  For the same
+ * reason, REFRESH and the initial population use the latest snapshot, after
+ * no more changes to the base tables can be pending.
+ */
+
+/*
+ * MatViewMaintenanceRequested
+ *		Does a CREATE MATERIALIZED VIEW option list enable incremental
+ *		maintenance?
+ */
+bool
+MatViewMaintenanceRequested(List *options)
+{
+	ListCell   *cell;
+
+	foreach(cell, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(cell);
+
+		if (def->defnamespace == NULL &&
+			pg_strcasecmp(def->defname, "incremental_maintenance") == 0)
+			return defGetBoolean(def);
+	}
+
+	return false;
+}
+
+/*
+ * LockMatViewBaseTables
+ *		Lock the tables a materialized view's query reads against changes.
+ *
+ * This takes the same lock as creating the maintenance triggers will, so
+ * that no change can slip in before the triggers exist.
+ */
+void
+LockMatViewBaseTables(Query *query)
+{
+	ListCell   *lc;
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+		if (rte->rtekind == RTE_RELATION && rte->relkind == RELKIND_RELATION)
+			LockRelationOid(rte->relid, ShareRowExclusiveLock);
+	}
+}
+
+/*
+ * CreateMatViewMaintenanceTriggers
+ *		Check that a materialized view can be maintained incrementally, and
+ *		create the triggers that do it.
+ *
+ * The caller must own the view; TRIGGER privilege on its base tables is
+ * checked here.
+ */
+void
+CreateMatViewMaintenanceTriggers(Relation matviewRel)
+{
+	MatViewDef *def;
+	ListCell   *lc;
+
+	def = mv_analyze_query(matviewRel, get_matview_query(matviewRel));
+
+	foreach(lc, def->baserels)
+	{
+		Oid			relid = lfirst_oid(lc);
+		AclResult	aclresult;
+
+		aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_TRIGGER);
+		if (aclresult != ACLCHECK_OK)
+			aclcheck_error(aclresult, ACL_KIND_CLASS, get_rel_name(relid));
+
+		mv_create_trigger(RelationGetRelid(matviewRel), relid, true);
+		mv_create_trigger(RelationGetRelid(matviewRel), relid, false);
+	}
+
+	CommandCounterIncrement();
+}
+
+/*
+ * DropMatViewMaintenanceTriggers
+ *		Drop the triggers made by CreateMatViewMaintenanceTriggers.
+ */
+void
+DropMatViewMaintenanceTriggers(Relation matviewRel)
+{
+	Relation	depRel;
+	ScanKeyData key[2];
+	SysScanDesc scan;
+	HeapTuple	tup;
+	ObjectAddresses *objects = new_object_addresses();
+
+	depRel = heap_open(DependRelationId, AccessShareLock);
+
+	ScanKeyInit(&key[0],
+				Anum_pg_depend_refclassid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(RelationRelationId));
+	ScanKeyInit(&key[1],
+				Anum_pg_depend_refobjid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(RelationGetRelid(matviewRel)));
+
+	scan = systable_beginscan(depRel, DependReferenceIndexId, true,
+							  NULL, 2, key);
+
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_depend depform = (Form_pg_depend) GETSTRUCT(tup);
+		ObjectAddress obj;
+
+		if (depform->classid != TriggerRelationId ||
+			depform->deptype != DEPENDENCY_AUTO)
+			continue;
+
+		obj.classId = depform->classid;
+		obj.objectId = depform->objid;
+		obj.objectSubId = 0;
+		add_exact_object_address(&obj, objects);
+	}
+
+	systable_endscan(scan);
+	heap_close(depRel, AccessShareLock);
+
+	performMultipleDeletions(objects, DROP_RESTRICT,
+							 PERFORM_DELETION_INTERNAL);
+	free_object_addresses(objects);
+
+	CommandCounterIncrement();
+}
+
+/*
+ * SetMatViewIncrementalMaintenance
+ *		Start or stop maintaining a materialized view incrementally, after
+ *		ALTER MATERIALIZED VIEW changed its incremental_maintenance option.
+ *
+ * When maintenance starts, the view's contents may be out of date, so it is
+ * marked as not populated until the next REFRESH.
+ */
+void
+SetMatViewIncrementalMaintenance(Relation matviewRel, bool enable)
+{
+	/* Make the new reloptions visible */
+	CommandCounterIncrement();
+
+	if (enable)
+	{
+		CreateMatViewMaintenanceTriggers(matviewRel);
+		if (RelationIsPopulated(matviewRel))
+			SetMatViewPopulatedState(matviewRel, false);
+	}
+	else
+		DropMatViewMaintenanceTriggers(matviewRel);
+}
+
+/*
+ * Get the stored query of a materialized view.
+ */
+static Query *
+get_matview_query(Relation matviewRel)
+{
+	RewriteRule *rule;
+
+	if (!matviewRel->rd_rel->relhasrules ||
+		matviewRel->rd_rules->numLocks != 1)
+		elog(ERROR,
+			 "materialized view \"%s\" is missing rewrite information",
+			 RelationGetRelationName(matviewRel));
+
+	rule = matviewRel->rd_rules->rules[0];
+	if (rule->event != CMD_SELECT || !(rule->isInstead) ||
+		list_length(rule->actions) != 1)
+		elog(ERROR,
+			 "the rule for materialized view \"%s\" is not a single SELECT INSTEAD OF action",
+			 RelationGetRelationName(matviewRel));
+
+	return (Query *) linitial(rule->actions);
+}
+
+static void
+mv_not_maintainable(Relation matviewRel, const char *detail)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("materialized view \"%s\" cannot be maintained incrementally",
+					RelationGetRelationName(matviewRel)),
+			 errdetail("%s", detail)));
+}
+
+/*
+ * Find references to system columns or whole rows.
+ */
+static bool
+mv_check_vars_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Var))
+		return ((Var *) node)->varattno <= 0;
+	if (IsA(node, Query))
+		return query_tree_walker((Query *) node, mv_check_vars_walker,
+								 context, 0);
+	return expression_tree_walker(node, mv_check_vars_walker, context);
+}
+
+/*
+ * mv_analyze_query
+ *		Check that a materialized view's query is one we can maintain, and
+ *		describe it.
+ */
+static MatViewDef *
+mv_analyze_query(Relation matviewRel, Query *query)
+{
+	MatViewDef *def = (MatViewDef *) palloc0(sizeof(MatViewDef));
+	int			natts = RelationGetNumberOfAttributes(matviewRel);
+	AttrNumber	attnum;
+	ListCell   *lc;
+
+	if (query->cteList != NIL)
+		mv_not_maintainable(matviewRel, _("WITH queries are not supported."));
+	if (query->setOperations != NULL)
+		mv_not_maintainable(matviewRel, _("UNION, INTERSECT and EXCEPT are not supported."));
+	if (query->distinctClause != NIL)
+		mv_not_maintainable(matviewRel, _("DISTINCT is not supported."));
+	if (query->hasWindowFuncs)
+		mv_not_maintainable(matviewRel, _("Window functions are not supported."));
+	if (query->hasSubLinks)
+		mv_not_maintainable(matviewRel, _("Subqueries are not supported."));
+	if (query->limitOffset != NULL || query->limitCount != NULL)
+		mv_not_maintainable(matviewRel, _("LIMIT and OFFSET are not supported."));
+	if (query->havingQual != NULL)
+		mv_not_maintainable(matviewRel, _("HAVING is not supported."));
+	if (query->groupingSets != NIL)
+		mv_not_maintainable(matviewRel, _("GROUPING SETS, ROLLUP and CUBE are not supported."));
+	if (query->hasForUpdate || query->rowMarks != NIL)
+		mv_not_maintainable(matviewRel, _("FOR UPDATE and FOR SHARE are not supported."));
+	if (expression_returns_set((Node *) query->targetList))
+		mv_not_maintainable(matviewRel, _("Set-returning functions in the select list are not supported."));
+	if (contain_mutable_functions((Node *) query))
+		mv_not_maintainable(matviewRel, _("All functions and operators used must be immutable."));
+	if (query_tree_walker(query, mv_check_vars_walker, NULL, 0))
+		mv_not_maintainable(matviewRel, _("System columns and whole-row references are not supported."));
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+		switch (rte->rtekind)
+		{
+			case RTE_RELATION:
+				/* skip the OLD and NEW entries of the stored rule */
+				if (rte->relid == RelationGetRelid(matviewRel))
+					break;
+				if (rte->relkind != RELKIND_RELATION)
+					mv_not_maintainable(matviewRel, _("Only plain tables can be referenced."));
+				if (rte->tablesample != NULL)
+					mv_not_maintainable(matviewRel, _("TABLESAMPLE is not supported."));
+				if (rte->inh && has_subclass(rte->relid))
+					mv_not_maintainable(matviewRel, _("Tables with inheritance children are not supported."));
+				if (list_member_oid(def->baserels, rte->relid))
+					mv_not_maintainable(matviewRel, _("Each table can be referenced only once."));
+				def->baserels = lappend_oid(def->baserels, rte->relid);
+				break;
+			case RTE_JOIN:
+				if (rte->jointype != JOIN_INNER)
+					mv_not_maintainable(matviewRel, _("Outer joins are not supported."));
+				break;
+			default:
+				mv_not_maintainable(matviewRel, _("Only plain tables can be referenced."));
+				break;
+		}
+	}
+	if (def->baserels == NIL)
+		mv_not_maintainable(matviewRel, _("The query must read at least one table."));
+
+	def->aggregated = query->hasAggs || query->groupClause != NIL;
+	def->grouped = query->groupClause != NIL;
+	def->colkinds = (char *) palloc(natts * sizeof(char));
+	def->countcols = (AttrNumber *) palloc0(natts * sizeof(AttrNumber));
+
+	foreach(lc, query->groupClause)
+	{
+		SortGroupClause *sgc = (SortGroupClause *) lfirst(lc);
+
+		if (get_sortgroupclause_tle(sgc, query->targetList)->resjunk)
+			mv_not_maintainable(matviewRel, _("All GROUP BY expressions must appear in the select list."));
+	}
+
+	/* Classify the matview's columns */
+	attnum = 0;
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+		char		kind;
+
+		if (tle->resjunk)
+			continue;
+		if (!def->aggregated)
+			kind = MV_COL_PLAIN;
+		else if (IsA(tle->expr, Aggref))
+		{
+			Aggref	   *aggref = (Aggref *) tle->expr;
+			char	   *aggname = get_func_name(aggref->aggfnoid);
+
+			if (get_func_namespace(aggref->aggfnoid) != PG_CATALOG_NAMESPACE ||
+				(strcmp(aggname, "count") != 0 && strcmp(aggname, "sum") != 0))
+				mv_not_maintainable(matviewRel, _("Only the count() and sum() aggregates are supported."));
+			if (aggref->aggdistinct != NIL || aggref->aggorder != NIL ||
+				aggref->aggfilter != NULL)
+				mv_not_maintainable(matviewRel, _("Aggregates with DISTINCT, ORDER BY or FILTER are not supported."));
+
+			if (strcmp(aggname, "sum") == 0)
+				kind = MV_COL_SUM;
+			else if (aggref->aggstar)
+				kind = MV_COL_COUNT_STAR;
+			else
+				kind = MV_COL_COUNT;
+		}
+		else if (tle->ressortgroupref != 0 &&
+				 !contain_agg_clause((Node *) tle->expr))
+			kind = MV_COL_PLAIN;
+		else
+			mv_not_maintainable(matviewRel, _("Each column of an aggregated query must be a GROUP BY expression, count() or sum()."));
+
+		if (attnum >= natts)
+			elog(ERROR, "too many columns in query of materialized view \"%s\"",
+				 RelationGetRelationName(matviewRel));
+		def->colkinds[attnum++] = kind;
+		if (kind == MV_COL_COUNT_STAR && def->countstar == 0)
+			def->countstar = attnum;
+	}
+	if (attnum != natts)
+		elog(ERROR, "too few columns in query of materialized view \"%s\"",
+			 RelationGetRelationName(matviewRel));
+
+	if (def->grouped && def->countstar == 0)
+		mv_not_maintainable(matviewRel, _("A query with GROUP BY must have count(*) in its select list."));
+
+	/* Find the count(x) to go with each sum(x) */
+	for (attnum = 0; attnum < natts; attnum++)
+	{
+		Aggref	   *sumagg;
+		AttrNumber	other;
+
+		if (def->colkinds[attnum] != MV_COL_SUM)
+			continue;
+		sumagg = (Aggref *) ((TargetEntry *) list_nth(query->targetList,
+													  attnum))->expr;
+		for (other = 0; other < natts; other++)
+		{
+			Aggref	   *countagg;
+
+			if (def->colkinds[other] != MV_COL_COUNT)
+				continue;
+			countagg = (Aggref *) ((TargetEntry *) list_nth(query->targetList,
+															other))->expr;
+			if (equal(countagg->args, sumagg->args))
+			{
+				def->countcols[attnum] = other + 1;
+				break;
+			}
+		}
+		if (def->countcols[attnum] == 0)
+			mv_not_maintainable(matviewRel, _("Each sum(x) must be accompanied by count(x) in the select list."));
+	}
+
+	return def;
+}
+
+/*
+ * Make a maintenance trigger on baserelid: a row trigger for INSERT, UPDATE
+ * and DELETE, or a statement trigger for TRUNCATE.
+ */
+static void
+mv_create_trigger(Oid matviewOid, Oid baserelid, bool row)
+{
+	CreateTrigStmt *trigger = makeNode(CreateTrigStmt);
+	ObjectAddress trigaddr;
+	ObjectAddress mvaddr;
+	char		idbuf[12];
+
+	snprintf(idbuf, sizeof(idbuf), "%u", matviewOid);
+
+	trigger->trigname = "MatView_Maintenance";
+	trigger->relation = NULL;
+	trigger->funcname = SystemFuncName("matview_maintenance");
+	trigger->args = list_make1(makeString(pstrdup(idbuf)));
+	trigger->row = row;
+	trigger->timing = TRIGGER_TYPE_AFTER;
+	if (row)
+		trigger->events = TRIGGER_TYPE_INSERT | TRIGGER_TYPE_UPDATE |
+			TRIGGER_TYPE_DELETE;
+	else
+		trigger->events = TRIGGER_TYPE_TRUNCATE;
+	trigger->columns = NIL;
+	trigger->whenClause = NULL;
+	trigger->isconstraint = false;
+	trigger->deferrable = false;
+	trigger->initdeferred = false;
+	trigger->constrrel = NULL;
+
+	trigaddr = CreateTrigger(trigger, NULL, baserelid, InvalidOid,
+							 InvalidOid, InvalidOid, true);
+
+	/* Dropping the matview drops its triggers */
+	ObjectAddressSet(mvaddr, RelationRelationId, matviewOid);
+	recordDependencyOn(&trigaddr, &mvaddr, DEPENDENCY_AUTO);
+}
+
+/*
+ * Relcache invalidation callback: a matview or one of its base tables may
+ * have changed, so the cached plans must be made again.
+ */
+static void
+mv_InvalidateCallback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	MatViewMaintEntry *entry;
+
+	hash_seq_init(&status, mv_maint_cache);
+	while ((entry = (MatViewMaintEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (relid == InvalidOid || entry->key.matviewid == relid ||
+			entry->key.baserelid == relid)
+			entry->valid = false;
+	}
+}
+
+/*
+ * mv_get_entry
+ *		Look up the cache entry of a matview, or of one of its base tables,
+ *		making its plans if needed.
+ */
+static MatViewMaintEntry *
+mv_get_entry(Relation matviewRel, Relation baseRel)
+{
+	MatViewMaintKey key;
+	MatViewMaintEntry *entry;
+	bool		found;
+	int			i;
+
+	if (mv_maint_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(MatViewMaintKey);
+		ctl.entrysize = sizeof(MatViewMaintEntry);
+		mv_maint_cache = hash_create("Matview maintenance plans", 64,
+									 &ctl, HASH_ELEM | HASH_BLOBS);
+		CacheRegisterRelcacheCallback(mv_InvalidateCallback, (Datum) 0);
+	}
+
+	MemSet(&key, 0, sizeof(key));
+	key.matviewid = RelationGetRelid(matviewRel);
+	key.baserelid = baseRel ? RelationGetRelid(baseRel) : InvalidOid;
+
+	entry = (MatViewMaintEntry *) hash_search(mv_maint_cache, &key,
+											  HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->valid = false;
+		MemSet(entry->plans, 0, sizeof(entry->plans));
+	}
+
+	if (!entry->valid)
+	{
+		for (i = 0; i < MV_NUM_PLANS; i++)
+		{
+			if (entry->plans[i] != NULL)
+			{
+				SPI_freeplan(entry->plans[i]);
+				entry->plans[i] = NULL;
+			}
+		}
+
+		/*
+		 * Mark the entry valid first, so that an invalidation arriving while
+		 * we make the plans is not lost.
+		 */
+		entry->valid = true;
+		PG_TRY();
+		{
+			mv_build_plans(entry, matviewRel, baseRel);
+		}
+		PG_CATCH();
+		{
+			entry->valid = false;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+	}
+
+	return entry;
+}
+
+/*
+ * mv_build_plans
+ *		Make the plans of a cache entry.
+ *
+ * The statements are made by deparsing with only pg_catalog in the search
+ * path, so that every name in them is qualified and they mean the same
+ * whatever search_path is in effect when they are run.
+ */
+static void
+mv_build_plans(MatViewMaintEntry *entry, Relation matviewRel,
+			   Relation baseRel)
+{
+	Query	   *query = (Query *) copyObject(get_matview_query(matviewRel));
+	MatViewDef *def = mv_analyze_query(matviewRel, query);
+	TupleDesc	tupdesc = RelationGetDescr(matviewRel);
+	int			natts = tupdesc->natts;
+	char	   *matviewname;
+	Oid		   *argtypes;
+	StringInfoData buf;
+	StringInfoData match;
+	int			save_nestlevel;
+	int			i;
+
+	save_nestlevel = NewGUCNestLevel();
+	(void) set_config_option("search_path", "pg_catalog",
+							 PGC_USERSET, PGC_S_SESSION,
+							 GUC_ACTION_SAVE, true, 0, false);
+
+	entry->aggregated = def->aggregated;
+	entry->grouped = def->grouped;
+
+	if (baseRel != NULL)
+	{
+		TupleDesc	basedesc = RelationGetDescr(baseRel);
+
+		if (!list_member_oid(def->baserels, RelationGetRelid(baseRel)))
+			elog(ERROR, "\"%s\" is not a base table of materialized view \"%s\"",
+				 RelationGetRelationName(baseRel),
+				 RelationGetRelationName(matviewRel));
+
+		argtypes = (Oid *) palloc(basedesc->natts * sizeof(Oid));
+		for (i = 0; i < basedesc->natts; i++)
+			argtypes[i] = basedesc->attrs[i]->attisdropped ?
+				INT4OID : basedesc->attrs[i]->atttypid;
+
+		entry->plans[MV_PLAN_DELTA] =
+			mv_prepare(mv_delta_query(query, baseRel), basedesc->natts,
+					   argtypes, 0);
+
+		AtEOXact_GUC(true, save_nestlevel);
+		return;
+	}
+
+	matviewname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+										RelationGetRelationName(matviewRel));
+	argtypes = (Oid *) palloc(natts * sizeof(Oid));
+	for (i = 0; i < natts; i++)
+		argtypes[i] = tupdesc->attrs[i]->atttypid;
+
+	initStringInfo(&buf);
+	initStringInfo(&match);
+
+	/* INSERT: add a row, or a new group */
+	appendStringInfo(&buf, "INSERT INTO %s VALUES (", matviewname);
+	for (i = 1; i <= natts; i++)
+		appendStringInfo(&buf, "%s$%d", i > 1 ? ", " : "", i);
+	appendStringInfoChar(&buf, ')');
+	entry->plans[MV_PLAN_INSERT] = mv_prepare(buf.data, natts, argtypes, 0);
+
+	/*
+	 * The conditions identifying a row, or a group.  These are planned for
+	 * the actual parameter values, so that the tests for NULL drop out and
+	 * an index on the matview can be used.
+	 */
+	for (i = 1; i <= natts; i++)
+	{
+		if (def->aggregated && def->colkinds[i - 1] != MV_COL_PLAIN)
+			continue;
+		mv_append_match(&match, matviewRel, i);
+	}
+
+	if (!def->aggregated)
+	{
+		/* DELETE: remove one row identical to the given one */
+		resetStringInfo(&buf);
+		appendStringInfo(&buf,
+						 "DELETE FROM ONLY %s WHERE ctid OPERATOR(pg_catalog.=) "
+						 "(SELECT m.ctid FROM ONLY %s m WHERE %s"
+						 "m OPERATOR(pg_catalog.*=) ROW(",
+						 matviewname, matviewname, match.data);
+		for (i = 1; i <= natts; i++)
+			appendStringInfo(&buf, "%s$%d", i > 1 ? ", " : "", i);
+		appendStringInfo(&buf, ")::%s LIMIT 1)", matviewname);
+		entry->plans[MV_PLAN_DELETE] = mv_prepare(buf.data, natts, argtypes,
+												  CURSOR_OPT_CUSTOM_PLAN);
+	}
+	else
+	{
+		StringInfoData sets;
+		const char *sep;
+
+		initStringInfo(&sets);
+
+		/* ADD: add the given aggregates to those of the group */
+		sep = "";
+		for (i = 1; i <= natts; i++)
+		{
+			const char *col = quote_identifier(NameStr(tupdesc->attrs[i - 1]->attname));
+
+			switch (def->colkinds[i - 1])
+			{
+				case MV_COL_COUNT_STAR:
+				case MV_COL_COUNT:
+					appendStringInfo(&sets,
+									 "%s%s = m.%s OPERATOR(pg_catalog.+) $%d",
+									 sep, col, col, i);
+					break;
+				case MV_COL_SUM:
+					appendStringInfo(&sets,
+									 "%s%s = CASE WHEN $%d IS NULL THEN m.%s "
+									 "WHEN m.%s IS NULL THEN $%d "
+									 "ELSE m.%s OPERATOR(pg_catalog.+) $%d END",
+									 sep, col, i, col, col, i, col, i);
+					break;
+				default:
+					continue;
+			}
+			sep = ", ";
+		}
+		resetStringInfo(&buf);
+		appendStringInfo(&buf, "UPDATE ONLY %s m SET %s WHERE %strue",
+						 matviewname, sets.data, match.data);
+		entry->plans[MV_PLAN_ADD] = mv_prepare(buf.data, natts, argtypes,
+											   CURSOR_OPT_CUSTOM_PLAN);
+
+		/*
+		 * SUBTRACT: subtract the given aggregates from those of the group; a
+		 * sum becomes NULL when no non-null input is left.
+		 */
+		resetStringInfo(&sets);
+		sep = "";
+		for (i = 1; i <= natts; i++)
+		{
+			const char *col = quote_identifier(NameStr(tupdesc->attrs[i - 1]->attname));
+			const char *countcol;
+
+			switch (def->colkinds[i - 1])
+			{
+				case MV_COL_COUNT_STAR:
+				case MV_COL_COUNT:
+					appendStringInfo(&sets,
+									 "%s%s = m.%s OPERATOR(pg_catalog.-) $%d",
+									 sep, col, col, i);
+					break;
+				case MV_COL_SUM:
+					countcol = quote_identifier(NameStr(tupdesc->attrs[def->countcols[i - 1] - 1]->attname));
+					appendStringInfo(&sets,
+									 "%s%s = CASE WHEN m.%s OPERATOR(pg_catalog.=) $%d THEN NULL "
+									 "WHEN $%d IS NULL THEN m.%s "
+									 "ELSE m.%s OPERATOR(pg_catalog.-) $%d END",
+									 sep, col, countcol, def->countcols[i - 1],
+									 i, col, col, i);
+					break;
+				default:
+					continue;
+			}
+			sep = ", ";
+		}
+		resetStringInfo(&buf);
+		appendStringInfo(&buf, "UPDATE ONLY %s m SET %s WHERE %strue",
+						 matviewname, sets.data, match.data);
+		entry->plans[MV_PLAN_SUBTRACT] = mv_prepare(buf.data, natts, argtypes,
+													CURSOR_OPT_CUSTOM_PLAN);
+
+		/* DROP_GROUP: remove the group if the given rows are all it has */
+		if (def->grouped)
+		{
+			resetStringInfo(&buf);
+			appendStringInfo(&buf,
+							 "DELETE FROM ONLY %s m WHERE %sm.%s OPERATOR(pg_catalog.=) $%d",
+							 matviewname, match.data,
+							 quote_identifier(NameStr(tupdesc->attrs[def->countstar - 1]->attname)),
+							 def->countstar);
+			entry->plans[MV_PLAN_DROP_GROUP] = mv_prepare(buf.data, natts,
+														  argtypes,
+														  CURSOR_OPT_CUSTOM_PLAN);
+		}
+	}
+
+	/* CLEAR and FILL: recompute everything, after a TRUNCATE */
+	resetStringInfo(&buf);
+	appendStringInfo(&buf, "DELETE FROM ONLY %s", matviewname);
+	entry->plans[MV_PLAN_CLEAR] = mv_prepare(buf.data, 0, NULL, 0);
+
+	resetStringInfo(&buf);
+	appendStringInfo(&buf, "INSERT INTO %s %s", matviewname,
+					 pg_get_querydef(query, false));
+	entry->plans[MV_PLAN_FILL] = mv_prepare(buf.data, 0, NULL, 0);
+
+	AtEOXact_GUC(true, save_nestlevel);
+}
+
+static SPIPlanPtr
+mv_prepare(const char *sql, int nargs, Oid *argtypes, int cursorOptions)
+{
+	SPIPlanPtr	plan;
+
+	plan = SPI_prepare_cursor(sql, nargs, argtypes, cursorOptions);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare returned %d for %s", SPI_result, sql);
+	if (SPI_keepplan(plan))
+		elog(ERROR, "SPI_keepplan failed");
+
+	return plan;
+}
+
+/*
+ * mv_delta_query
+ *		Make the SQL of the matview's query, with a base table replaced by a
+ *		single row given as parameters $1 .. $n, one per table column.
+ */
+static char *
+mv_delta_query(Query *query, Relation baseRel)
+{
+	Query	   *delta = (Query *) copyObject(query);
+	TupleDesc	tupdesc = RelationGetDescr(baseRel);
+	Query	   *subquery;
+	RangeTblEntry *rte = NULL;
+	List	   *colnames = NIL;
+	ListCell   *lc;
+	int			i;
+
+	foreach(lc, delta->rtable)
+	{
+		rte = (RangeTblEntry *) lfirst(lc);
+		if (rte->rtekind == RTE_RELATION &&
+			rte->relid == RelationGetRelid(baseRel))
+			break;
+	}
+	if (lc == NULL)
+		elog(ERROR, "base table \"%s\" not found in matview query",
+			 RelationGetRelationName(baseRel));
+
+	/* SELECT $1 AS col1, $2 AS col2, ... */
+	subquery = makeNode(Query);
+	subquery->commandType = CMD_SELECT;
+	subquery->querySource = QSRC_ORIGINAL;
+	subquery->canSetTag = true;
+	subquery->jointree = makeFromExpr(NIL, NULL);
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = tupdesc->attrs[i];
+		Expr	   *expr;
+		char	   *colname;
+
+		if (attr->attisdropped)
+		{
+			/* keep the column numbering; nothing refers to it */
+			expr = (Expr *) makeNullConst(INT4OID, -1, InvalidOid);
+			colname = psprintf("pg.dropped.%d", i + 1);
+		}
+		else
+		{
+			Param	   *param = makeNode(Param);
+
+			param->paramkind = PARAM_EXTERN;
+			param->paramid = i + 1;
+			param->paramtype = attr->atttypid;
+			param->paramtypmod = -1;
+			param->paramcollid = attr->attcollation;
+			param->location = -1;
+			expr = (Expr *) param;
+
+			if (OidIsValid(attr->attcollation) &&
+				attr->attcollation != get_typcollation(attr->atttypid))
+			{
+				CollateExpr *collate = makeNode(CollateExpr);
+
+				collate->arg = expr;
+				collate->collOid = attr->attcollation;
+				collate->location = -1;
+				expr = (Expr *) collate;
+			}
+			colname = pstrdup(NameStr(attr->attname));
+		}
+
+		subquery->targetList = lappend(subquery->targetList,
+									   makeTargetEntry(expr, i + 1, colname,
+													   false));
+		colnames = lappend(colnames, makeString(colname));
+	}
+
+	rte->rtekind = RTE_SUBQUERY;
+	rte->subquery = subquery;
+	rte->security_barrier = false;
+	rte->relid = InvalidOid;
+	rte->relkind = 0;
+	rte->tablesample = NULL;
+	rte->inh = false;
+	rte->requiredPerms = 0;
+	rte->checkAsUser = InvalidOid;
+	rte->selectedCols = NULL;
+	rte->insertedCols = NULL;
+	rte->updatedCols = NULL;
+	if (rte->alias == NULL)
+		rte->alias = makeAlias(rte->eref->aliasname, NIL);
+	rte->eref = makeAlias(rte->eref->aliasname, colnames);
+
+	/* The order of the rows doesn't matter */
+	delta->sortClause = NIL;
+
+	return pg_get_querydef(delta, false);
+}
+
+/*
+ * Append a condition matching matview column attnum against parameter
+ * $attnum, followed by AND.  NULLs match each other, as in GROUP BY.  Types
+ * without an equality operator get no condition; the caller must compare
+ * them some other way.
+ */
+static void
+mv_append_match(StringInfo buf, Relation matviewRel, AttrNumber attnum)
+{
+	Form_pg_attribute attr = RelationGetDescr(matviewRel)->attrs[attnum - 1];
+	const char *col = quote_identifier(NameStr(attr->attname));
+	Oid			eqop;
+
+	eqop = lookup_type_cache(attr->atttypid, TYPECACHE_EQ_OPR)->eq_opr;
+	if (!OidIsValid(eqop))
+		return;
+
+	appendStringInfo(buf, "(m.%s ", col);
+	mv_GenerateOper(buf, eqop);
+	appendStringInfo(buf, " $%d OR (m.%s IS NULL AND $%d IS NULL)) AND ",
+					 attnum, col, attnum);
+}
+
+/*
+ * Run a maintenance statement against the latest snapshot, and return the
+ * number of rows it processed.
+ */
+static uint32
+mv_execute(SPIPlanPtr plan, Datum *values, const char *nulls, int expected)
+{
+	int			spi_result;
+
+	spi_result = SPI_execute_snapshot(plan, values, nulls,
+									  GetLatestSnapshot(), InvalidSnapshot,
+									  false, false, 0);
+	if (spi_result != expected)
+		elog(ERROR, "SPI_execute_snapshot returned %d", spi_result);
+
+	return SPI_processed;
+}
+
+/*
+ * mv_check_command
+ *		Check that the command with the given ID has changed no base table of
+ *		the matview but this one.
+ */
+static void
+mv_check_command(Relation matviewRel, Oid baserelid, CommandId cid)
+{
+	MatViewCommandChange *change;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+
+	/* The list is in TopTransactionContext, so forget any previous one */
+	if (mv_command_changes_lxid != MyProc->lxid)
+	{
+		mv_command_changes = NIL;
+		mv_command_changes_lxid = MyProc->lxid;
+	}
+
+	foreach(lc, mv_command_changes)
+	{
+		change = (MatViewCommandChange *) lfirst(lc);
+
+		if (change->matviewid == RelationGetRelid(matviewRel) &&
+			change->cid == cid)
+		{
+			if (change->baserelid != baserelid)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("cannot change more than one base table of incrementally maintained materialized view \"%s\" in a single command",
+								RelationGetRelationName(matviewRel))));
+			return;
+		}
+	}
+
+	oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+	change = (MatViewCommandChange *) palloc(sizeof(MatViewCommandChange));
+	change->matviewid = RelationGetRelid(matviewRel);
+	change->cid = cid;
+	change->baserelid = baserelid;
+	mv_command_changes = lappend(mv_command_changes, change);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * mv_apply_row
+ *		Apply the insertion or deletion of a base table row to the matview.
+ */
+static void
+mv_apply_row(Relation matviewRel, MatViewMaintEntry *mventry,
+			 MatViewMaintEntry *baseentry, Relation baseRel,
+			 HeapTuple tuple, Snapshot snapshot, bool inserted)
+{
+	TupleDesc	basedesc = RelationGetDescr(baseRel);
+	int			natts = RelationGetNumberOfAttributes(matviewRel);
+	SPITupleTable *delta;
+	uint32		ndelta;
+	Datum	   *values;
+	bool	   *isnull;
+	char	   *nulls;
+	uint32		i;
+	int			j;
+
+	/* Compute the row's contribution to the matview */
+	values = (Datum *) palloc(Max(basedesc->natts, natts) * sizeof(Datum));
+	isnull = (bool *) palloc(Max(basedesc->natts, natts) * sizeof(bool));
+	nulls = (char *) palloc(Max(basedesc->natts, natts) * sizeof(char));
+
+	heap_deform_tuple(tuple, basedesc, values, isnull);
+	for (j = 0; j < basedesc->natts; j++)
+		nulls[j] = isnull[j] ? 'n' : ' ';
+
+	if (SPI_execute_snapshot(baseentry->plans[MV_PLAN_DELTA], values, nulls,
+							 snapshot, InvalidSnapshot,
+							 true, false, 0) != SPI_OK_SELECT)
+		elog(ERROR, "SPI_execute_snapshot failed for delta query");
+	delta = SPI_tuptable;
+	ndelta = SPI_processed;
+
+	OpenMatViewIncrementalMaintenance();
+
+	for (i = 0; i < ndelta; i++)
+	{
+		heap_deform_tuple(delta->vals[i], delta->tupdesc, values, isnull);
+		for (j = 0; j < natts; j++)
+			nulls[j] = isnull[j] ? 'n' : ' ';
+
+		if (!mventry->aggregated)
+		{
+			if (inserted)
+				mv_execute(mventry->plans[MV_PLAN_INSERT], values, nulls,
+						   SPI_OK_INSERT);
+			else if (mv_execute(mventry->plans[MV_PLAN_DELETE], values, nulls,
+								SPI_OK_DELETE) != 1)
+				mv_out_of_step(matviewRel);
+		}
+		else if (inserted)
+		{
+			if (mv_execute(mventry->plans[MV_PLAN_ADD], values, nulls,
+						   SPI_OK_UPDATE) == 0)
+			{
+				if (!mventry->grouped)
+					mv_out_of_step(matviewRel);
+				mv_execute(mventry->plans[MV_PLAN_INSERT], values, nulls,
+						   SPI_OK_INSERT);
+			}
+		}
+		else
+		{
+			if (mventry->grouped &&
+				mv_execute(mventry->plans[MV_PLAN_DROP_GROUP], values, nulls,
+						   SPI_OK_DELETE) > 0)
+				continue;
+			if (mv_execute(mventry->plans[MV_PLAN_SUBTRACT], values, nulls,
+						   SPI_OK_UPDATE) == 0)
+				mv_out_of_step(matviewRel);
+		}
+	}
+
+	CloseMatViewIncrementalMaintenance();
+
+	SPI_freetuptable(delta);
+}
+
+static void
+mv_out_of_step(Relation matviewRel)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			 errmsg("materialized view \"%s\" does not match its base tables",
+					RelationGetRelationName(matviewRel)),
+			 errhint("Use REFRESH MATERIALIZED VIEW to bring it up to date.")));
+}
+
+/*
+ * matview_maintenance
+ *		Trigger function maintaining a materialized view, whose OID is the
+ *		trigger argument.
+ */
+Datum
+matview_maintenance(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	Relation	baseRel;
+	Relation	matviewRel;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			save_nestlevel;
+	int			old_depth = matview_maintenance_depth;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("function \"%s\" was not called by trigger manager",
+						"matview_maintenance")));
+	if (!TRIGGER_FIRED_AFTER(trigdata->tg_event) ||
+		trigdata->tg_trigger->tgnargs != 1)
+		elog(ERROR, "matview_maintenance called in an unexpected way");
+
+	baseRel = trigdata->tg_relation;
+
+	/*
+	 * Serialize the maintenance of this matview, and wait out REFRESH.  If
+	 * the matview is not populated, there's nothing to maintain.
+	 */
+	matviewRel = heap_open((Oid) strtoul(trigdata->tg_trigger->tgargs[0], NULL, 10),
+						   ExclusiveLock);
+	if (!RelationIsPopulated(matviewRel))
+	{
+		heap_close(matviewRel, NoLock);
+		return PointerGetDatum(NULL);
+	}
+
+	/* Run as the matview's owner, as REFRESH does */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(matviewRel->rd_rel->relowner,
+						   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+						   SECURITY_RESTRICTED_OPERATION);
+	save_nestlevel = NewGUCNestLevel();
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	PG_TRY();
+	{
+		MatViewMaintEntry *mventry = mv_get_entry(matviewRel, NULL);
+
+		if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+		{
+			OpenMatViewIncrementalMaintenance();
+			mv_execute(mventry->plans[MV_PLAN_CLEAR], NULL, NULL,
+					   SPI_OK_DELETE);
+			mv_execute(mventry->plans[MV_PLAN_FILL], NULL, NULL,
+					   SPI_OK_INSERT);
+			CloseMatViewIncrementalMaintenance();
+		}
+		else
+		{
+			MatViewMaintEntry *baseentry = mv_get_entry(matviewRel, baseRel);
+			HeapTuple	oldtuple = NULL;
+			HeapTuple	newtuple = NULL;
+			CommandId	cid;
+			Snapshot	snapshot;
+
+			if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+				newtuple = trigdata->tg_trigtuple;
+			else if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+			{
+				oldtuple = trigdata->tg_trigtuple;
+				newtuple = trigdata->tg_newtuple;
+			}
+			else
+				oldtuple = trigdata->tg_trigtuple;
+
+			/* The ID of the command that made the change */
+			if (newtuple != NULL)
+				cid = HeapTupleHeaderGetCmin(newtuple->t_data);
+			else
+				cid = HeapTupleHeaderGetCmax(oldtuple->t_data);
+
+			mv_check_command(matviewRel, RelationGetRelid(baseRel), cid);
+
+			/* See the other base tables as they were before that command */
+			snapshot = RegisterSnapshot(GetLatestSnapshot());
+			snapshot->curcid = cid;
+
+			if (oldtuple != NULL)
+				mv_apply_row(matviewRel, mventry, baseentry, baseRel,
+							 oldtuple, snapshot, false);
+			if (newtuple != NULL)
+				mv_apply_row(matviewRel, mventry, baseentry, baseRel,
+							 newtuple, snapshot, true);
+
+			UnregisterSnapshot(snapshot);
+		}
+	}
+	PG_CATCH();
+	{
+		matview_maintenance_depth = old_depth;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish failed");
+
+	/* Roll back any GUC changes */
+	AtEOXact_GUC(false, save_nestlevel);
+
+	/* Restore userid and security context */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	heap_close(matviewRel, NoLock);
+
+	return PointerGetDatum(NULL);
+}
@@ -29,6 +29,7 @@
 #include "parser/parse_type.h"
 #include "rewrite/rewriteHandler.h"
 #include "tcop/pquery.h"
+#include "tcop/tcopprot.h"
 #include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/snapmgr.h"
@@ -469,6 +470,9 @@ StorePreparedStatement(const char *stmt_name,
 	entry->from_sql = from_sql;
 	entry->prepare_time = cur_ts;
 
+	/* prepared statements tie a pooled session to its backend */
+	PinPooledSession("prepared statement");
+
 	/* Now it's safe to move the CachedPlanSource to permanent memory */
 	SaveCachedPlan(plansource);
 }
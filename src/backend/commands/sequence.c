@@ -31,9 +31,12 @@
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
+#include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -79,6 +82,53 @@ typedef struct SeqTableData
 
 typedef SeqTableData *SeqTable;
 
+/*
+ * Shared sequence state.
+ *
+ * Taking an exclusive lock on a sequence's page for every nextval() call
+ * makes the page a hot spot when many sessions draw from one sequence.  So
+ * when nextval() has just WAL-logged a new high-water mark for a sequence,
+ * it leaves the page showing the logged state, and publishes the true state
+ * -- the last value fetched and how many more the WAL record covers -- in a
+ * slot in shared memory.  Later nextval() calls take their values from the
+ * slot under its spinlock, without touching the page, until the logged
+ * values are used up or a limit is near; then they go back to the page.
+ * Values are still handed out one at a time in order, as before.
+ *
+ * Every value handed out from a slot is below the one shown on the page,
+ * so if a slot's state is lost at a crash, those values are merely skipped,
+ * as after a crash today.  Anything that reads the sequence tuple through
+ * read_seq_tuple(), and any heap scan of the sequence, first moves the
+ * slot's state back into the page (WAL-logged, see seq_shared_absorb) and
+ * empties the slot; the shutdown checkpoint does the same for all slots.
+ * Since nextval() reads the tuple again once the slot's values run out,
+ * slots empty themselves regularly.  A slot is forgotten when its
+ * sequence's storage is dropped.
+ *
+ * A sequence's slot is found by probing a few slots from one chosen by
+ * hashing its relfilenode.  If they are all in use, nextval() just keeps
+ * the sequence's state in its page as before.  Temporary sequences don't
+ * use slots at all.
+ */
+#define NUM_SEQ_SHARED_SLOTS	128
+#define SEQ_SHARED_PROBES		4
+
+typedef struct SeqSharedSlot
+{
+	slock_t		mutex;			/* protects the remaining fields */
+	bool		valid;			/* does the slot hold a sequence's state? */
+	RelFileNode rnode;			/* the sequence's relfilenode */
+	int64		last_value;		/* last value fetched */
+	int64		log_cnt;		/* number of fetches covered by WAL */
+	/* copies of the sequence's parameters: */
+	int64		increment_by;
+	int64		max_value;
+	int64		min_value;
+	int64		cache_value;
+} SeqSharedSlot;
+
+static SeqSharedSlot *SeqSharedSlots = NULL;
+
 static HTAB *seqhashtab = NULL; /* hash table for SeqTable items */
 
 /*
@@ -97,6 +147,12 @@ static Form_pg_sequence read_seq_tuple(SeqTable elm, Relation rel,
 static void init_params(List *options, bool isInit,
 			Form_pg_sequence new__, List **owned_by);
 static void do_setval(Oid relid, int64 next, bool iscalled);
+static SeqSharedSlot *seq_shared_lock_slot(RelFileNode *rnode);
+static bool seq_shared_nextval(SeqTable elm, Relation seqrel, int64 *result);
+static bool seq_shared_publish(Relation seqrel, Form_pg_sequence seq,
+				   int64 last, int64 log);
+static bool seq_shared_absorb(RelFileNode *rnode, Buffer buf,
+				  HeapTuple seqtuple);
 static void process_owned_by(Relation seqrel, List *owned_by);
 
 
@@ -582,6 +638,14 @@ nextval_internal(Oid relid)
 		return elm->last;
 	}
 
+	/* Take the values from shared memory if we can */
+	if (RelationNeedsWAL(seqrel) && seq_shared_nextval(elm, seqrel, &result))
+	{
+		relation_close(seqrel, NoLock);
+		last_used_seq = elm;
+		return result;
+	}
+
 	/* lock page' buffer and read tuple */
 	seq = read_seq_tuple(elm, seqrel, &buf, &seqtuple);
 	page = BufferGetPage(buf);
@@ -754,10 +818,18 @@ nextval_internal(Oid relid)
 		PageSetLSN(page, recptr);
 	}
 
-	/* Now update sequence tuple to the intended final state */
-	seq->last_value = last;		/* last fetched number */
-	seq->is_called = true;
-	seq->log_cnt = log;			/* how much is logged */
+	/*
+	 * If we can, leave the tuple in the state just logged, and let later
+	 * calls take the logged values from shared memory.
+	 */
+	if (!(logit && RelationNeedsWAL(seqrel) && log > 0 &&
+		  seq_shared_publish(seqrel, seq, last, log)))
+	{
+		/* Now update sequence tuple to the intended final state */
+		seq->last_value = last; /* last fetched number */
+		seq->is_called = true;
+		seq->log_cnt = log;		/* how much is logged */
+	}
 
 	END_CRIT_SECTION();
 
@@ -1148,12 +1220,386 @@ read_seq_tuple(SeqTable elm, Relation rel, Buffer *buf, HeapTuple seqtuple)
 
 	seq = (Form_pg_sequence) GETSTRUCT(seqtuple);
 
+	/*
+	 * If nextval() calls have been taking values from shared memory, the
+	 * tuple is behind; bring it up to date.
+	 */
+	if (RelationNeedsWAL(rel))
+		seq_shared_absorb(&rel->rd_node, *buf, seqtuple);
+
 	/* this is a handy place to update our copy of the increment */
 	elm->increment = seq->increment_by;
 
 	return seq;
 }
 
+/*
+ * Report shared-memory space needed by SequenceShmemInit
+ */
+Size
+SequenceShmemSize(void)
+{
+	return mul_size(NUM_SEQ_SHARED_SLOTS, sizeof(SeqSharedSlot));
+}
+
+/*
+ * Allocate and initialize the shared sequence slots
+ */
+void
+SequenceShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	SeqSharedSlots = (SeqSharedSlot *)
+		ShmemInitStruct("Sequence Slots", SequenceShmemSize(), &found);
+
+	if (!found)
+	{
+		for (i = 0; i < NUM_SEQ_SHARED_SLOTS; i++)
+		{
+			SpinLockInit(&SeqSharedSlots[i].mutex);
+			SeqSharedSlots[i].valid = false;
+		}
+	}
+}
+
+static int
+seq_shared_first_slot(RelFileNode *rnode)
+{
+	return (int) ((rnode->relNode ^ (rnode->dbNode * 31)) %
+				  NUM_SEQ_SHARED_SLOTS);
+}
+
+/*
+ * Find the slot holding the state of the sequence with the given
+ * relfilenode, and return it with its spinlock held; or NULL if none does.
+ */
+static SeqSharedSlot *
+seq_shared_lock_slot(RelFileNode *rnode)
+{
+	int			first = seq_shared_first_slot(rnode);
+	int			i;
+
+	for (i = 0; i < SEQ_SHARED_PROBES; i++)
+	{
+		SeqSharedSlot *slot;
+
+		slot = &SeqSharedSlots[(first + i) % NUM_SEQ_SHARED_SLOTS];
+		SpinLockAcquire(&slot->mutex);
+		if (slot->valid && RelFileNodeEquals(slot->rnode, *rnode))
+			return slot;
+		SpinLockRelease(&slot->mutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * Can n more values, stepping by incby from last, be fetched without going
+ * outside minv..maxv?
+ */
+static bool
+seq_values_fit(int64 last, int64 incby, int64 n, int64 minv, int64 maxv)
+{
+	if (incby > 0)
+		return ((uint64) maxv - (uint64) last) / (uint64) incby >= (uint64) n;
+	else
+		return ((uint64) last - (uint64) minv) /
+			((uint64) 0 - (uint64) incby) >= (uint64) n;
+}
+
+/*
+ * Try to take the next CACHE values of a sequence from its shared slot,
+ * setting up elm's cache like nextval_internal does.  Returns false if
+ * the caller must go to the sequence's page instead.
+ */
+static bool
+seq_shared_nextval(SeqTable elm, Relation seqrel, int64 *result)
+{
+	SeqSharedSlot *slot;
+	int64		incby;
+	int64		first;
+	int64		last;
+
+	slot = seq_shared_lock_slot(&seqrel->rd_node);
+	if (slot == NULL)
+		return false;
+
+	incby = slot->increment_by;
+	if (slot->log_cnt < slot->cache_value ||
+		!seq_values_fit(slot->last_value, incby, slot->cache_value,
+						slot->min_value, slot->max_value))
+	{
+		SpinLockRelease(&slot->mutex);
+		return false;
+	}
+
+	first = slot->last_value + incby;
+	slot->last_value += slot->cache_value * incby;
+	slot->log_cnt -= slot->cache_value;
+	last = slot->last_value;
+
+	SpinLockRelease(&slot->mutex);
+
+	elm->last = first;
+	elm->cached = last;
+	elm->last_valid = true;
+	elm->increment = incby;
+
+	*result = first;
+	return true;
+}
+
+/*
+ * Publish the state of a sequence whose tuple shows the state just WAL-
+ * logged: last is the last value actually fetched, and log the number of
+ * further fetches the WAL record covers.  The caller holds the exclusive
+ * lock on the sequence's buffer, and may be in a critical section.
+ *
+ * Returns false if there is no free slot for the sequence, in which case
+ * the caller must store the state in the tuple itself.  We never take over
+ * another sequence's slot, as that would lose the values it has reserved.
+ */
+static bool
+seq_shared_publish(Relation seqrel, Form_pg_sequence seq, int64 last,
+				   int64 log)
+{
+	RelFileNode *rnode = &seqrel->rd_node;
+	SeqSharedSlot *slot;
+
+	/*
+	 * Use the sequence's slot if it has one (it can't, as read_seq_tuple
+	 * emptied it, but be safe), else a free slot.
+	 */
+	slot = seq_shared_lock_slot(rnode);
+	if (slot == NULL)
+	{
+		int			first = seq_shared_first_slot(rnode);
+		int			i;
+
+		for (i = 0; i < SEQ_SHARED_PROBES; i++)
+		{
+			slot = &SeqSharedSlots[(first + i) % NUM_SEQ_SHARED_SLOTS];
+			SpinLockAcquire(&slot->mutex);
+			if (!slot->valid)
+				break;
+			SpinLockRelease(&slot->mutex);
+			slot = NULL;
+		}
+		if (slot == NULL)
+			return false;
+	}
+
+	slot->valid = true;
+	slot->rnode = *rnode;
+	slot->last_value = last;
+	slot->log_cnt = log;
+	slot->increment_by = seq->increment_by;
+	slot->max_value = seq->max_value;
+	slot->min_value = seq->min_value;
+	slot->cache_value = seq->cache_value;
+
+	SpinLockRelease(&slot->mutex);
+
+	return true;
+}
+
+/*
+ * If the sequence with the given relfilenode has its state in a slot, copy
+ * it into its tuple, which the caller has exclusively locked in buf, and
+ * empty the slot.  Returns true if the tuple was changed.
+ *
+ * The change is WAL-logged like any other.  While the state is in a slot,
+ * the tuple shows the state last WAL-logged by nextval(), so that is what
+ * we log again; it still covers every value the slot could have handed out
+ * and those the tuple will hand out from now on.
+ */
+static bool
+seq_shared_absorb(RelFileNode *rnode, Buffer buf, HeapTuple seqtuple)
+{
+	Form_pg_sequence seq = (Form_pg_sequence) GETSTRUCT(seqtuple);
+	SeqSharedSlot *slot;
+	int64		last;
+	int64		log;
+	xl_seq_rec	xlrec;
+	XLogRecPtr	recptr;
+
+	slot = seq_shared_lock_slot(rnode);
+	if (slot == NULL)
+		return false;
+
+	last = slot->last_value;
+	log = slot->log_cnt;
+	slot->valid = false;
+
+	SpinLockRelease(&slot->mutex);
+
+	START_CRIT_SECTION();
+
+	MarkBufferDirty(buf);
+
+	XLogBeginInsert();
+	XLogRegisterBuffer(0, buf, REGBUF_WILL_INIT);
+
+	xlrec.node = *rnode;
+
+	XLogRegisterData((char *) &xlrec, sizeof(xl_seq_rec));
+	XLogRegisterData((char *) seqtuple->t_data, seqtuple->t_len);
+
+	recptr = XLogInsert(RM_SEQ_ID, XLOG_SEQ_LOG);
+
+	PageSetLSN(BufferGetPage(buf), recptr);
+
+	seq->last_value = last;
+	seq->is_called = true;
+	seq->log_cnt = log;
+
+	END_CRIT_SECTION();
+
+	return true;
+}
+
+/*
+ * Move the state kept in shared memory back into the sequences' pages, so
+ * that it isn't lost over a restart.  This is called at shutdown, when no
+ * backends remain, before the shutdown checkpoint, since it writes WAL.
+ */
+void
+ShutdownSequences(void)
+{
+	int			i;
+
+	if (SeqSharedSlots == NULL)
+		return;
+
+	for (i = 0; i < NUM_SEQ_SHARED_SLOTS; i++)
+	{
+		SeqSharedSlot *slot = &SeqSharedSlots[i];
+		RelFileNode rnode;
+		SMgrRelation reln;
+		Buffer		buf;
+		Page		page;
+		ItemId		lp;
+		HeapTupleData seqtuple;
+
+		if (!slot->valid)
+			continue;
+		rnode = slot->rnode;
+
+		/* The sequence may have been dropped, so look before we read */
+		reln = smgropen(rnode, InvalidBackendId);
+		if (!smgrexists(reln, MAIN_FORKNUM) ||
+			smgrnblocks(reln, MAIN_FORKNUM) == 0)
+		{
+			slot->valid = false;
+			continue;
+		}
+
+		buf = ReadBufferWithoutRelcache(rnode, MAIN_FORKNUM, 0,
+										RBM_NORMAL, NULL);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		if (PageGetSpecialSize(page) == MAXALIGN(sizeof(sequence_magic)) &&
+			((sequence_magic *) PageGetSpecialPointer(page))->magic == SEQ_MAGIC &&
+			PageGetMaxOffsetNumber(page) >= FirstOffsetNumber)
+		{
+			lp = PageGetItemId(page, FirstOffsetNumber);
+			seqtuple.t_data = (HeapTupleHeader) PageGetItem(page, lp);
+			seqtuple.t_len = ItemIdGetLength(lp);
+			seq_shared_absorb(&rnode, buf, &seqtuple);
+		}
+		else
+			slot->valid = false;
+
+		UnlockReleaseBuffer(buf);
+	}
+}
+
+/*
+ * Bring a sequence's tuple up to date with its slot, if it has one, so that
+ * a plain heap scan of the sequence sees its current state.
+ */
+void
+SequenceSyncShared(Relation seqrel)
+{
+	Buffer		buf;
+	Page		page;
+	ItemId		lp;
+	sequence_magic *sm;
+	HeapTupleData seqtuple;
+	SeqSharedSlot *slot;
+
+	if (SeqSharedSlots == NULL || !RelationNeedsWAL(seqrel))
+		return;
+
+	/* Skip reading the page if the sequence has no slot */
+	slot = seq_shared_lock_slot(&seqrel->rd_node);
+	if (slot == NULL)
+		return;
+	SpinLockRelease(&slot->mutex);
+
+	buf = ReadBuffer(seqrel, 0);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+	page = BufferGetPage(buf);
+	sm = (sequence_magic *) PageGetSpecialPointer(page);
+
+	if (sm->magic != SEQ_MAGIC)
+		elog(ERROR, "bad magic number in sequence \"%s\": %08X",
+			 RelationGetRelationName(seqrel), sm->magic);
+
+	lp = PageGetItemId(page, FirstOffsetNumber);
+	Assert(ItemIdIsNormal(lp));
+	seqtuple.t_data = (HeapTupleHeader) PageGetItem(page, lp);
+	seqtuple.t_len = ItemIdGetLength(lp);
+
+	seq_shared_absorb(&seqrel->rd_node, buf, &seqtuple);
+
+	UnlockReleaseBuffer(buf);
+}
+
+/*
+ * Forget the slot of the sequence with the given relfilenode, whose storage
+ * is being dropped.
+ */
+void
+SequenceForgetShared(RelFileNode rnode)
+{
+	SeqSharedSlot *slot;
+
+	if (SeqSharedSlots == NULL)
+		return;
+
+	slot = seq_shared_lock_slot(&rnode);
+	if (slot == NULL)
+		return;
+	slot->valid = false;
+	SpinLockRelease(&slot->mutex);
+}
+
+/*
+ * Forget the slots of all sequences in a database being dropped.
+ */
+void
+SequenceForgetSharedDatabase(Oid dbid)
+{
+	int			i;
+
+	if (SeqSharedSlots == NULL)
+		return;
+
+	for (i = 0; i < NUM_SEQ_SHARED_SLOTS; i++)
+	{
+		SeqSharedSlot *slot = &SeqSharedSlots[i];
+
+		SpinLockAcquire(&slot->mutex);
+		if (slot->valid && slot->rnode.dbNode == dbid)
+			slot->valid = false;
+		SpinLockRelease(&slot->mutex);
+	}
+}
+
 /*
  * init_params: process the options list of CREATE or ALTER SEQUENCE,
  * and store the values into appropriate fields of *new.  Also set
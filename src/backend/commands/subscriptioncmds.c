@@ -0,0 +1,543 @@
+/*-------------------------------------------------------------------------
+ *
+ * subscriptioncmds.c
+ *		subscription catalog manipulation functions
+ *
+ * A subscription only records where to connect and what to ask for; the
+ * replication slot on the publisher has to be created separately, using the
+ * pgoutput plugin.  Starting and stopping the apply workers is left to the
+ * logical replication launcher, which is woken up at commit.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/backend/commands/subscriptioncmds.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "catalog/dependency.h"
+#include "catalog/indexing.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_subscription.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "commands/subscriptioncmds.h"
+#include "miscadmin.h"
+#include "replication/logicallauncher.h"
+#include "replication/origin.h"
+#include "replication/worker_internal.h"
+#include "storage/lmgr.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/syscache.h"
+
+
+/*
+ * Common option parsing function for CREATE and ALTER SUBSCRIPTION commands.
+ *
+ * Since not all options can be specified in both commands, this function
+ * will report an error on options if the target output pointer is NULL to
+ * accommodate that.
+ */
+static void
+parse_subscription_options(List *options, bool *enabled_given, bool *enabled,
+						   char **slot_name, bool *streaming_given,
+						   bool *streaming, bool *binary_given, bool *binary)
+{
+	ListCell   *lc;
+
+	*enabled_given = false;
+	*streaming_given = false;
+	*binary_given = false;
+	if (slot_name)
+		*slot_name = NULL;
+
+	foreach(lc, options)
+	{
+		DefElem    *defel = (DefElem *) lfirst(lc);
+
+		if (strcmp(defel->defname, "enabled") == 0)
+		{
+			if (*enabled_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+
+			*enabled_given = true;
+			*enabled = defGetBoolean(defel);
+		}
+		else if (strcmp(defel->defname, "slot_name") == 0 && slot_name)
+		{
+			if (*slot_name)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+
+			*slot_name = defGetString(defel);
+		}
+		else if (strcmp(defel->defname, "streaming") == 0)
+		{
+			if (*streaming_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+
+			*streaming_given = true;
+			*streaming = defGetBoolean(defel);
+		}
+		else if (strcmp(defel->defname, "binary") == 0)
+		{
+			if (*binary_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+
+			*binary_given = true;
+			*binary = defGetBoolean(defel);
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("unrecognized subscription parameter: \"%s\"",
+							defel->defname)));
+	}
+}
+
+/*
+ * Auxiliary function to return a text array out of a list of String nodes.
+ */
+static Datum
+publicationListToArray(List *publist)
+{
+	ArrayType  *arr;
+	Datum	   *datums;
+	int			j = 0;
+	ListCell   *cell;
+
+	datums = (Datum *) palloc(sizeof(Datum) * list_length(publist));
+
+	foreach(cell, publist)
+	{
+		char	   *name = strVal(lfirst(cell));
+		ListCell   *pcell;
+
+		/* Check for duplicates. */
+		foreach(pcell, publist)
+		{
+			char	   *pname = strVal(lfirst(pcell));
+
+			if (pcell == cell)
+				break;
+
+			if (strcmp(name, pname) == 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("publication name \"%s\" used more than once",
+								pname)));
+		}
+
+		datums[j++] = CStringGetTextDatum(name);
+	}
+
+	arr = construct_array(datums, list_length(publist),
+						  TEXTOID, -1, false, 'i');
+
+	return PointerGetDatum(arr);
+}
+
+/*
+ * Create new subscription.
+ */
+ObjectAddress
+CreateSubscription(CreateSubscriptionStmt *stmt)
+{
+	Relation	rel;
+	ObjectAddress myself;
+	Oid			subid;
+	bool		nulls[Natts_pg_subscription];
+	Datum		values[Natts_pg_subscription];
+	Oid			owner = GetUserId();
+	HeapTuple	tup;
+	bool		enabled_given;
+	bool		enabled = true;
+	bool		streaming_given;
+	bool		streaming = false;
+	bool		binary_given;
+	bool		binary = false;
+	char	   *slotname;
+	char		originname[NAMEDATALEN];
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 (errmsg("must be superuser to create subscriptions"))));
+
+	parse_subscription_options(stmt->options, &enabled_given, &enabled,
+							   &slotname, &streaming_given, &streaming,
+							   &binary_given, &binary);
+
+	/* The slot is named after the subscription unless told otherwise. */
+	if (slotname == NULL)
+		slotname = stmt->subname;
+
+	rel = heap_open(SubscriptionRelationId, RowExclusiveLock);
+
+	/* Check if name is used */
+	subid = GetSysCacheOid2(SUBSCRIPTIONNAME, ObjectIdGetDatum(MyDatabaseId),
+							CStringGetDatum(stmt->subname));
+	if (OidIsValid(subid))
+		ereport(ERROR,
+				(errcode(ERRCODE_DUPLICATE_OBJECT),
+				 errmsg("subscription \"%s\" already exists",
+						stmt->subname)));
+
+	/* Form a tuple. */
+	memset(values, 0, sizeof(values));
+	memset(nulls, false, sizeof(nulls));
+
+	values[Anum_pg_subscription_subdbid - 1] = ObjectIdGetDatum(MyDatabaseId);
+	values[Anum_pg_subscription_subname - 1] =
+		DirectFunctionCall1(namein, CStringGetDatum(stmt->subname));
+	values[Anum_pg_subscription_subowner - 1] = ObjectIdGetDatum(owner);
+	values[Anum_pg_subscription_subenabled - 1] = BoolGetDatum(enabled);
+	values[Anum_pg_subscription_substream - 1] = BoolGetDatum(streaming);
+	values[Anum_pg_subscription_subbinary - 1] = BoolGetDatum(binary);
+	values[Anum_pg_subscription_subslotname - 1] =
+		DirectFunctionCall1(namein, CStringGetDatum(slotname));
+	values[Anum_pg_subscription_subconninfo - 1] =
+		CStringGetTextDatum(stmt->conninfo);
+	values[Anum_pg_subscription_subpublications - 1] =
+		publicationListToArray(stmt->publication);
+
+	tup = heap_form_tuple(RelationGetDescr(rel), values, nulls);
+
+	/* Insert tuple into catalog. */
+	subid = simple_heap_insert(rel, tup);
+	CatalogUpdateIndexes(rel, tup);
+	heap_freetuple(tup);
+
+	recordDependencyOnOwner(SubscriptionRelationId, subid, owner);
+
+	/* The origin tracks how far the subscription has applied. */
+	snprintf(originname, sizeof(originname), "pg_%u", subid);
+	replorigin_create(originname);
+
+	heap_close(rel, RowExclusiveLock);
+
+	if (enabled)
+		ApplyLauncherWakeupAtCommit();
+
+	ObjectAddressSet(myself, SubscriptionRelationId, subid);
+
+	InvokeObjectPostCreateHook(SubscriptionRelationId, subid, 0);
+
+	return myself;
+}
+
+/*
+ * Alter the existing subscription.
+ *
+ * A running apply worker notices the change through its syscache callback
+ * and restarts with the new definition.
+ */
+ObjectAddress
+AlterSubscription(AlterSubscriptionStmt *stmt)
+{
+	Relation	rel;
+	ObjectAddress myself;
+	bool		nulls[Natts_pg_subscription];
+	bool		replaces[Natts_pg_subscription];
+	Datum		values[Natts_pg_subscription];
+	HeapTuple	tup;
+	Oid			subid;
+	bool		enabled_given;
+	bool		enabled;
+	bool		streaming_given;
+	bool		streaming;
+	bool		binary_given;
+	bool		binary;
+	char	   *slotname;
+
+	rel = heap_open(SubscriptionRelationId, RowExclusiveLock);
+
+	/* Fetch the existing tuple. */
+	tup = SearchSysCacheCopy2(SUBSCRIPTIONNAME, ObjectIdGetDatum(MyDatabaseId),
+							  CStringGetDatum(stmt->subname));
+
+	if (!HeapTupleIsValid(tup))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("subscription \"%s\" does not exist",
+						stmt->subname)));
+
+	subid = HeapTupleGetOid(tup);
+
+	/* must be owner */
+	if (!pg_subscription_ownercheck(subid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, ACL_KIND_SUBSCRIPTION,
+					   stmt->subname);
+
+	/* Form a new tuple. */
+	memset(values, 0, sizeof(values));
+	memset(nulls, false, sizeof(nulls));
+	memset(replaces, false, sizeof(replaces));
+
+	switch (stmt->kind)
+	{
+		case ALTER_SUBSCRIPTION_OPTIONS:
+		case ALTER_SUBSCRIPTION_ENABLED:
+			parse_subscription_options(stmt->options, &enabled_given,
+									   &enabled,
+									   stmt->kind == ALTER_SUBSCRIPTION_OPTIONS ?
+									   &slotname : NULL,
+									   &streaming_given, &streaming,
+									   &binary_given, &binary);
+
+			if (enabled_given)
+			{
+				values[Anum_pg_subscription_subenabled - 1] =
+					BoolGetDatum(enabled);
+				replaces[Anum_pg_subscription_subenabled - 1] = true;
+			}
+			if (stmt->kind == ALTER_SUBSCRIPTION_OPTIONS && slotname)
+			{
+				values[Anum_pg_subscription_subslotname - 1] =
+					DirectFunctionCall1(namein, CStringGetDatum(slotname));
+				replaces[Anum_pg_subscription_subslotname - 1] = true;
+			}
+			if (streaming_given)
+			{
+				values[Anum_pg_subscription_substream - 1] =
+					BoolGetDatum(streaming);
+				replaces[Anum_pg_subscription_substream - 1] = true;
+			}
+			if (binary_given)
+			{
+				values[Anum_pg_subscription_subbinary - 1] =
+					BoolGetDatum(binary);
+				replaces[Anum_pg_subscription_subbinary - 1] = true;
+			}
+			break;
+
+		case ALTER_SUBSCRIPTION_CONNECTION:
+			values[Anum_pg_subscription_subconninfo - 1] =
+				CStringGetTextDatum(stmt->conninfo);
+			replaces[Anum_pg_subscription_subconninfo - 1] = true;
+			break;
+
+		case ALTER_SUBSCRIPTION_PUBLICATION:
+			values[Anum_pg_subscription_subpublications - 1] =
+				publicationListToArray(stmt->publication);
+			replaces[Anum_pg_subscription_subpublications - 1] = true;
+			break;
+
+		default:
+			elog(ERROR, "unrecognized ALTER SUBSCRIPTION kind %d",
+				 stmt->kind);
+	}
+
+	tup = heap_modify_tuple(tup, RelationGetDescr(rel), values, nulls,
+							replaces);
+
+	/* Update the catalog. */
+	simple_heap_update(rel, &tup->t_self, tup);
+	CatalogUpdateIndexes(rel, tup);
+
+	ObjectAddressSet(myself, SubscriptionRelationId, subid);
+
+	/* Cleanup. */
+	heap_freetuple(tup);
+	heap_close(rel, RowExclusiveLock);
+
+	ApplyLauncherWakeupAtCommit();
+
+	InvokeObjectPostAlterHook(SubscriptionRelationId, subid, 0);
+
+	return myself;
+}
+
+/*
+ * Drop a subscription
+ *
+ * The apply workers are stopped before the catalog entry goes away, so that
+ * the replication origin can be dropped.  The slot on the publisher is left
+ * alone.
+ */
+void
+DropSubscription(DropSubscriptionStmt *stmt)
+{
+	Relation	rel;
+	HeapTuple	tup;
+	Oid			subid;
+	char	   *subname;
+	char		originname[NAMEDATALEN];
+	RepOriginId originid;
+
+	/*
+	 * Lock pg_subscription with AccessExclusiveLock to ensure that the
+	 * launcher doesn't restart new workers while we are stopping them.
+	 */
+	rel = heap_open(SubscriptionRelationId, AccessExclusiveLock);
+
+	tup = SearchSysCache2(SUBSCRIPTIONNAME, ObjectIdGetDatum(MyDatabaseId),
+						  CStringGetDatum(stmt->subname));
+
+	if (!HeapTupleIsValid(tup))
+	{
+		heap_close(rel, NoLock);
+
+		if (!stmt->missing_ok)
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_OBJECT),
+					 errmsg("subscription \"%s\" does not exist",
+							stmt->subname)));
+		else
+			ereport(NOTICE,
+					(errmsg("subscription \"%s\" does not exist, skipping",
+							stmt->subname)));
+
+		return;
+	}
+
+	subid = HeapTupleGetOid(tup);
+
+	/* must be owner */
+	if (!pg_subscription_ownercheck(subid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, ACL_KIND_SUBSCRIPTION,
+					   stmt->subname);
+
+	/* DROP hook for the subscription being removed */
+	InvokeObjectDropHook(SubscriptionRelationId, subid, 0);
+
+	/*
+	 * Lock the subscription so nobody else can do anything with it
+	 * (including the replication workers).
+	 */
+	LockSharedObject(SubscriptionRelationId, subid, 0, AccessExclusiveLock);
+
+	subname = pstrdup(NameStr(((Form_pg_subscription) GETSTRUCT(tup))->subname));
+
+	simple_heap_delete(rel, &tup->t_self);
+
+	ReleaseSysCache(tup);
+
+	/* Clean up dependencies */
+	deleteSharedDependencyRecordsFor(SubscriptionRelationId, subid, 0);
+
+	/* Kill the apply workers so that the origin becomes free. */
+	logicalrep_worker_stop(subid);
+
+	/* Remove the origin tracking if exists. */
+	snprintf(originname, sizeof(originname), "pg_%u", subid);
+	originid = replorigin_by_name(originname, true);
+	if (originid != InvalidRepOriginId)
+		replorigin_drop(originid);
+
+	heap_close(rel, NoLock);
+
+	elog(DEBUG1, "dropped subscription \"%s\"", subname);
+}
+
+/*
+ * Internal workhorse for changing a subscription owner
+ */
+static void
+AlterSubscriptionOwner_internal(Relation rel, HeapTuple tup, Oid newOwnerId)
+{
+	Form_pg_subscription form;
+
+	form = (Form_pg_subscription) GETSTRUCT(tup);
+
+	if (form->subowner == newOwnerId)
+		return;
+
+	if (!pg_subscription_ownercheck(HeapTupleGetOid(tup), GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, ACL_KIND_SUBSCRIPTION,
+					   NameStr(form->subname));
+
+	/* New owner must be a superuser */
+	if (!superuser_arg(newOwnerId))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+		  errmsg("permission denied to change owner of subscription \"%s\"",
+				 NameStr(form->subname)),
+			 errhint("The owner of a subscription must be a superuser.")));
+
+	form->subowner = newOwnerId;
+	simple_heap_update(rel, &tup->t_self, tup);
+	CatalogUpdateIndexes(rel, tup);
+
+	/* Update owner dependency reference */
+	changeDependencyOnOwner(SubscriptionRelationId,
+							HeapTupleGetOid(tup),
+							newOwnerId);
+
+	InvokeObjectPostAlterHook(SubscriptionRelationId,
+							  HeapTupleGetOid(tup), 0);
+}
+
+/*
+ * Change subscription owner -- by name
+ */
+ObjectAddress
+AlterSubscriptionOwner(const char *name, Oid newOwnerId)
+{
+	Oid			subid;
+	HeapTuple	tup;
+	Relation	rel;
+	ObjectAddress address;
+
+	rel = heap_open(SubscriptionRelationId, RowExclusiveLock);
+
+	tup = SearchSysCacheCopy2(SUBSCRIPTIONNAME, ObjectIdGetDatum(MyDatabaseId),
+							  CStringGetDatum(name));
+
+	if (!HeapTupleIsValid(tup))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("subscription \"%s\" does not exist", name)));
+
+	subid = HeapTupleGetOid(tup);
+
+	AlterSubscriptionOwner_internal(rel, tup, newOwnerId);
+
+	ObjectAddressSet(address, SubscriptionRelationId, subid);
+
+	heap_freetuple(tup);
+
+	heap_close(rel, RowExclusiveLock);
+
+	return address;
+}
+
+/*
+ * Change subscription owner -- by OID
+ */
+void
+AlterSubscriptionOwner_oid(Oid subid, Oid newOwnerId)
+{
+	HeapTuple	tup;
+	Relation	rel;
+
+	rel = heap_open(SubscriptionRelationId, RowExclusiveLock);
+
+	tup = SearchSysCacheCopy1(SUBSCRIPTIONOID, ObjectIdGetDatum(subid));
+
+	if (!HeapTupleIsValid(tup))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("subscription with OID %u does not exist", subid)));
+
+	AlterSubscriptionOwner_internal(rel, tup, newOwnerId);
+
+	heap_freetuple(tup);
+
+	heap_close(rel, RowExclusiveLock);
+}
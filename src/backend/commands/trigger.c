@@ -16,6 +16,7 @@
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "access/sysattr.h"
+#include "access/tableam.h"
 #include "access/htup_details.h"
 #include "access/xact.h"
 #include "catalog/catalog.h"
@@ -2705,10 +2706,10 @@ GetTupleForTrigger(EState *estate,
 		 */
 ltrmark:;
 		tuple.t_self = *tid;
-		test = heap_lock_tuple(relation, &tuple,
-							   estate->es_output_cid,
-							   lockmode, LockWaitBlock,
-							   false, &buffer, &hufd);
+		test = table_lock_tuple(relation, &tuple,
+								estate->es_output_cid,
+								lockmode, LockWaitBlock,
+								false, &buffer, &hufd);
 		switch (test)
 		{
 			case HeapTupleSelfUpdated:
@@ -2784,32 +2785,14 @@ ltrmark:;
 	}
 	else
 	{
-		Page		page;
-		ItemId		lp;
-
-		buffer = ReadBuffer(relation, ItemPointerGetBlockNumber(tid));
-
 		/*
-		 * Although we already know this tuple is valid, we must lock the
-		 * buffer to ensure that no one has a buffer cleanup lock; otherwise
-		 * they might move the tuple while we try to copy it.  But we can
-		 * release the lock before actually doing the heap_copytuple call,
-		 * since holding pin is sufficient to prevent anyone from getting a
-		 * cleanup lock they don't already hold.
+		 * We already know this tuple is valid, so fetch it without any
+		 * visibility check.  The fetch returns with the buffer pinned, which
+		 * is enough to keep the tuple in place while we copy it.
 		 */
-		LockBuffer(buffer, BUFFER_LOCK_SHARE);
-
-		page = BufferGetPage(buffer);
-		lp = PageGetItemId(page, ItemPointerGetOffsetNumber(tid));
-
-		Assert(ItemIdIsNormal(lp));
-
-		tuple.t_data = (HeapTupleHeader) PageGetItem(page, lp);
-		tuple.t_len = ItemIdGetLength(lp);
 		tuple.t_self = *tid;
-		tuple.t_tableOid = RelationGetRelid(relation);
-
-		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+		if (!table_fetch(relation, SnapshotAny, &tuple, &buffer, false, NULL))
+			elog(ERROR, "failed to fetch tuple for trigger");
 	}
 
 	result = heap_copytuple(&tuple);
@@ -3543,6 +3526,14 @@ AfterTriggerExecute(AfterTriggerEvent event,
 	if (LocTriggerData.tg_trigger == NULL)
 		elog(ERROR, "could not find trigger %u", tgoid);
 
+	/*
+	 * Foreign key existence checks may have been queued by earlier events,
+	 * to be done in a batch; other triggers could observe or change their
+	 * outcome, so do them before firing anything else.
+	 */
+	if (RI_FKey_trigger_type(LocTriggerData.tg_trigger->tgfoid) != RI_TRIGGER_FK)
+		RI_FlushPendingChecks();
+
 	/*
 	 * If doing EXPLAIN ANALYZE, start charging time to this trigger. We want
 	 * to include time spent re-fetching tuples in the trigger cost.
@@ -3597,7 +3588,7 @@ AfterTriggerExecute(AfterTriggerEvent event,
 			if (ItemPointerIsValid(&(event->ate_ctid1)))
 			{
 				ItemPointerCopy(&(event->ate_ctid1), &(tuple1.t_self));
-				if (!heap_fetch(rel, SnapshotAny, &tuple1, &buffer1, false, NULL))
+				if (!table_fetch(rel, SnapshotAny, &tuple1, &buffer1, false, NULL))
 					elog(ERROR, "failed to fetch tuple1 for AFTER trigger");
 				LocTriggerData.tg_trigtuple = &tuple1;
 				LocTriggerData.tg_trigtuplebuf = buffer1;
@@ -3614,7 +3605,7 @@ AfterTriggerExecute(AfterTriggerEvent event,
 				ItemPointerIsValid(&(event->ate_ctid2)))
 			{
 				ItemPointerCopy(&(event->ate_ctid2), &(tuple2.t_self));
-				if (!heap_fetch(rel, SnapshotAny, &tuple2, &buffer2, false, NULL))
+				if (!table_fetch(rel, SnapshotAny, &tuple2, &buffer2, false, NULL))
 					elog(ERROR, "failed to fetch tuple2 for AFTER trigger");
 				LocTriggerData.tg_newtuple = &tuple2;
 				LocTriggerData.tg_newtuplebuf = buffer2;
@@ -3865,6 +3856,10 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 				events->tailfree = chunk->freeptr;
 		}
 	}
+
+	/* Do any foreign key checks that the events left queued */
+	RI_FlushPendingChecks();
+
 	if (slot1 != NULL)
 	{
 		ExecDropSingleTupleTableSlot(slot1);
@@ -4124,6 +4119,9 @@ AfterTriggerEndXact(bool isCommit)
 	afterTriggers.firing_stack = NULL;
 	afterTriggers.maxtransdepth = 0;
 
+	/* And any foreign key checks an error left queued */
+	RI_DiscardPendingChecks();
+
 
 	/*
 	 * Forget the query stack and constraint-related state information.  As
@@ -4246,6 +4244,9 @@ AfterTriggerEndSubXact(bool isCommit)
 		if (my_level >= afterTriggers.maxtransdepth)
 			return;
 
+		/* Forget foreign key checks queued by the failed subxact */
+		RI_DiscardPendingChecks();
+
 		/*
 		 * Release any event lists from queries being aborted, and restore
 		 * query_depth to its pre-subxact value.  This assumes that a
@@ -4,24 +4,35 @@
  *	  Concurrent ("lazy") vacuuming.
  *
  *
- * The major space usage for LAZY VACUUM is storage for the array of dead
- * tuple TIDs, with the next biggest need being storage for per-disk-page
- * free space info.  We want to ensure we can vacuum even the very largest
- * relations with finite memory space usage.  To do that, we set upper bounds
- * on the number of tuples and pages we will keep track of at once.
+ * The major space usage for LAZY VACUUM is storage for the dead tuple TIDs,
+ * with the next biggest need being storage for per-disk-page free space
+ * info.  We want to ensure we can vacuum even the very largest relations
+ * with finite memory space usage.  To do that, we set upper bounds on the
+ * number of tuples and pages we will keep track of at once.
  *
  * We are willing to use at most maintenance_work_mem (or perhaps
  * autovacuum_work_mem) memory space to keep track of dead tuples.  We
- * initially allocate an array of TIDs of that size, with an upper limit that
- * depends on table size (this limit ensures we don't allocate a huge area
- * uselessly for vacuuming small tables).  If the array threatens to overflow,
- * we suspend the heap scan phase and perform a pass of index cleanup and page
- * compaction, then resume the heap scan with an empty TID array.
+ * initially allocate a TID store (see access/common/tidstore.c) of that
+ * size, with an upper limit that depends on table size (this limit ensures
+ * we don't allocate a huge area uselessly for vacuuming small tables).  The
+ * store keeps a small bitmap per heap page, so it holds many more TIDs than
+ * a plain array would, and it isn't bound by MaxAllocSize.  If the store
+ * threatens to overflow, we suspend the heap scan phase and perform a pass
+ * of index cleanup and page compaction, then resume the heap scan with an
+ * empty store.
  *
  * If we're processing a table with no indexes, we can just vacuum each page
  * as we go; there's no need to save up multiple tuples to minimize the number
  * of index scans performed.  So we don't use maintenance_work_mem memory for
- * the TID array, just enough to hold as many heap tuples as fit on one page.
+ * the TID store, just enough to hold the dead tuples of one page.
+ *
+ * A table with several indexes can have them vacuumed in parallel.  The TID
+ * store then lives in a dynamic shared memory segment, together with the
+ * statistics of each index, for as long as the heap scan.  For each round
+ * of index vacuuming, and for the final index cleanup, we launch parallel
+ * workers that take indexes one at a time, as we do ourselves, until all
+ * are done.  Updating pg_class for the indexes is left to us, since that
+ * cannot be done in parallel mode.
  *
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
@@ -42,8 +53,11 @@
 #include "access/heapam_xlog.h"
 #include "access/htup_details.h"
 #include "access/multixact.h"
+#include "access/parallel.h"
+#include "access/tidstore.h"
 #include "access/transam.h"
 #include "access/visibilitymap.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
 #include "catalog/storage.h"
@@ -54,8 +68,10 @@
 #include "portability/instr_time.h"
 #include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
+#include "storage/dsm.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
+#include "storage/read_stream.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
@@ -84,19 +100,22 @@
 #define VACUUM_TRUNCATE_LOCK_WAIT_INTERVAL		50		/* ms */
 #define VACUUM_TRUNCATE_LOCK_TIMEOUT			5000	/* ms */
 
-/*
- * Guesstimation of number of dead tuples per page.  This is used to
- * provide an upper limit to memory allocated when vacuuming small
- * tables.
- */
-#define LAZY_ALLOC_TUPLES		MaxHeapTuplesPerPage
-
 /*
  * Before we consider skipping a page that's marked as clean in
  * visibility map, we must've seen at least this many clean pages.
  */
 #define SKIP_PAGES_THRESHOLD	((BlockNumber) 32)
 
+/*
+ * Unless told otherwise, only indexes this large get a parallel worker of
+ * their own.
+ */
+#define PARALLEL_VACUUM_MIN_INDEX_PAGES \
+	((BlockNumber) ((8 * 1024 * 1024) / BLCKSZ))
+
+/* Key of the parallel vacuum's shared state in the parallel context's TOC */
+#define PARALLEL_KEY_VACUUM_SHARED	UINT64CONST(0xC000000000000001)
+
 typedef struct LVRelStats
 {
 	/* hasindex = true means two-pass strategy; false means one-pass */
@@ -106,6 +125,7 @@ typedef struct LVRelStats
 	BlockNumber rel_pages;		/* total number of pages */
 	BlockNumber scanned_pages;	/* number of pages we examined */
 	BlockNumber pinskipped_pages;		/* # of pages we skipped due to a pin */
+	BlockNumber frozenskipped_pages;	/* # of frozen pages we skipped */
 	double		scanned_tuples; /* counts only tuples on scanned pages */
 	double		old_rel_tuples; /* previous value of pg_class.reltuples */
 	double		new_rel_tuples; /* new estimated total # of tuples */
@@ -113,16 +133,76 @@ typedef struct LVRelStats
 	BlockNumber pages_removed;
 	double		tuples_deleted;
 	BlockNumber nonempty_pages; /* actually, last nonempty page + 1 */
-	/* List of TIDs of tuples we intend to delete */
-	/* NB: this list is ordered by TID address */
-	int			num_dead_tuples;	/* current # of entries */
-	int			max_dead_tuples;	/* # slots allocated in array */
-	ItemPointer dead_tuples;	/* array of ItemPointerData */
+	/* TIDs of tuples we intend to delete */
+	TidStore   *dead_tuples;
+	/* offsets of those found so far on the page being scanned */
+	int			num_page_dead;
+	OffsetNumber page_dead[MaxHeapTuplesPerPage];
 	int			num_index_scans;
 	TransactionId latestRemovedXid;
 	bool		lock_waiter_detected;
 } LVRelStats;
 
+/*
+ * State of lazy_scan_heap's read stream, which decides what pages to skip.
+ * For each page it returns, it tells what the visibility map is known to say
+ * about it, as a uint8 of VISIBILITYMAP_* bits in the page's per-buffer data.
+ */
+typedef struct LVScanState
+{
+	Relation	onerel;
+	LVRelStats *vacrelstats;
+	BlockNumber nblocks;
+	bool		scan_all;
+	BlockNumber next_block;		/* next page to consider */
+	BlockNumber next_unskippable_block;
+	bool		skipping_blocks;
+	Buffer		vmbuffer;		/* for visibility map lookups */
+} LVScanState;
+
+/*
+ * Shared state of a parallel vacuum.  The DSM segment holding it also holds
+ * an LVSharedIndStats for each index, and then the dead tuples' TID store.  The
+ * leader fills in the fields below relid and nindexes before each round of
+ * index vacuuming.
+ */
+typedef struct LVShared
+{
+	Oid			relid;			/* heap being vacuumed */
+	int			nindexes;
+	int			elevel;
+	int			cost_delay;		/* cost-based delay of each participant */
+	int			cost_limit;
+
+	bool		for_cleanup;	/* index cleanup rather than bulk delete */
+	BlockNumber rel_pages;
+	BlockNumber scanned_pages;
+	double		old_rel_tuples;
+	double		new_rel_tuples;
+	pg_atomic_uint32 nextindex; /* next index to hand out */
+} LVShared;
+
+typedef struct LVSharedIndStats
+{
+	Oid			indexrelid;
+	bool		updated;		/* has stats been filled in? */
+	IndexBulkDeleteResult stats;
+} LVSharedIndStats;
+
+#define LVSharedIndStatsAt(shared, i) \
+	((LVSharedIndStats *) ((char *) (shared) + MAXALIGN(sizeof(LVShared)) + \
+						   (i) * MAXALIGN(sizeof(LVSharedIndStats))))
+#define LVSharedDeadTuples(shared) \
+	((void *) LVSharedIndStatsAt(shared, (shared)->nindexes))
+
+/* Leader's handle on a parallel vacuum */
+typedef struct LVParallelState
+{
+	dsm_segment *seg;
+	LVShared   *shared;
+	int			nworkers;		/* workers to launch for each round */
+} LVParallelState;
+
 
 /* A few variables that don't seem worth passing around as parameters */
 static int	elevel = -1;
@@ -136,27 +216,53 @@ static BufferAccessStrategy vac_strategy;
 
 /* non-export function prototypes */
 static void lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
-			   Relation *Irel, int nindexes, bool scan_all);
+			   Relation *Irel, int nindexes, bool scan_all, int nworkers);
+static BlockNumber lazy_scan_next_block(ReadStream *stream,
+					 void *callback_private_data, void *per_buffer_data);
+static BlockNumber lazy_next_unskippable_block(LVScanState *scanstate,
+							BlockNumber blkno);
 static void lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats);
 static bool lazy_check_needs_freeze(Buffer buf);
+static void lazy_vacuum_all_indexes(Relation *Irel, int nindexes,
+						IndexBulkDeleteResult **indstats,
+						LVRelStats *vacrelstats, LVParallelState *lps);
+static void lazy_cleanup_all_indexes(Relation *Irel, int nindexes,
+						 IndexBulkDeleteResult **indstats,
+						 LVRelStats *vacrelstats, LVParallelState *lps);
 static void lazy_vacuum_index(Relation indrel,
 				  IndexBulkDeleteResult **stats,
 				  LVRelStats *vacrelstats);
 static void lazy_cleanup_index(Relation indrel,
-				   IndexBulkDeleteResult *stats,
+				   IndexBulkDeleteResult **stats,
 				   LVRelStats *vacrelstats);
-static int lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
-				 int tupindex, LVRelStats *vacrelstats, Buffer *vmbuffer);
+static void lazy_update_index_stats(Relation indrel,
+						IndexBulkDeleteResult *stats);
+static int lazy_parallel_workers(Relation onerel, Relation *Irel,
+					  int nindexes, int nrequested);
+static LVParallelState *begin_parallel_vacuum(Relation onerel,
+					  LVRelStats *vacrelstats, Relation *Irel, int nindexes,
+					  int nworkers);
+static void end_parallel_vacuum(LVParallelState *lps,
+					LVRelStats *vacrelstats);
+static void lazy_parallel_vacuum_indexes(LVParallelState *lps,
+							 Relation *Irel, LVRelStats *vacrelstats,
+							 bool for_cleanup);
+static void lazy_parallel_process_indexes(LVShared *shared, Relation *Irel,
+							  LVRelStats *vacrelstats);
+static void lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
+				 OffsetNumber *deadoffsets, int ndead,
+				 LVRelStats *vacrelstats, Buffer *vmbuffer);
 static void lazy_truncate_heap(Relation onerel, LVRelStats *vacrelstats);
 static BlockNumber count_nondeletable_pages(Relation onerel,
 						 LVRelStats *vacrelstats);
+static Size lazy_dead_tuples_space(LVRelStats *vacrelstats,
+					   BlockNumber relblocks);
 static void lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks);
 static void lazy_record_dead_tuple(LVRelStats *vacrelstats,
 					   ItemPointer itemptr);
 static bool lazy_tid_reaped(ItemPointer itemptr, void *state);
-static int	vac_cmp_itemptr(const void *left, const void *right);
 static bool heap_page_is_all_visible(Relation rel, Buffer buf,
-						 TransactionId *visibility_cutoff_xid);
+					 TransactionId *visibility_cutoff_xid, bool *all_frozen);
 
 
 /*
@@ -241,19 +347,21 @@ lazy_vacuum_rel(Relation onerel, int options, VacuumParams *params,
 	vacrelstats->hasindex = (nindexes > 0);
 
 	/* Do the vacuuming */
-	lazy_scan_heap(onerel, vacrelstats, Irel, nindexes, scan_all);
+	lazy_scan_heap(onerel, vacrelstats, Irel, nindexes, scan_all,
+				   params->nworkers);
 
 	/* Done with indexes */
 	vac_close_indexes(nindexes, Irel, NoLock);
 
 	/*
-	 * Compute whether we actually scanned the whole relation. If we did, we
-	 * can adjust relfrozenxid and relminmxid.
+	 * Compute whether we actually scanned all the unfrozen pages. If we did,
+	 * we can adjust relfrozenxid and relminmxid.
 	 *
 	 * NB: We need to check this before truncating the relation, because that
 	 * will change ->rel_pages.
 	 */
-	if (vacrelstats->scanned_pages < vacrelstats->rel_pages)
+	if ((vacrelstats->scanned_pages + vacrelstats->frozenskipped_pages)
+		< vacrelstats->rel_pages)
 	{
 		Assert(!scan_all);
 		scanned_all = false;
@@ -290,8 +398,9 @@ lazy_vacuum_rel(Relation onerel, int options, VacuumParams *params,
 	 * is all-visible we'd definitely like to know that.  But clamp the value
 	 * to be not more than what we're setting relpages to.
 	 *
-	 * Also, don't change relfrozenxid/relminmxid if we skipped any pages,
-	 * since then we don't know for certain that all tuples have a newer xmin.
+	 * Also, don't change relfrozenxid/relminmxid if we skipped any pages that
+	 * weren't all-frozen, since then we don't know for certain that all
+	 * tuples have a newer xmin.
 	 */
 	new_rel_pages = vacrelstats->rel_pages;
 	new_rel_tuples = vacrelstats->new_rel_tuples;
@@ -301,7 +410,7 @@ lazy_vacuum_rel(Relation onerel, int options, VacuumParams *params,
 		new_rel_tuples = vacrelstats->old_rel_tuples;
 	}
 
-	new_rel_allvisible = visibilitymap_count(onerel);
+	visibilitymap_count(onerel, &new_rel_allvisible, NULL);
 	if (new_rel_allvisible > new_rel_pages)
 		new_rel_allvisible = new_rel_pages;
 
@@ -436,7 +545,7 @@ vacuum_log_cleanup_info(Relation rel, LVRelStats *vacrelstats)
  */
 static void
 lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
-			   Relation *Irel, int nindexes, bool scan_all)
+			   Relation *Irel, int nindexes, bool scan_all, int nworkers)
 {
 	BlockNumber nblocks,
 				blkno;
@@ -452,10 +561,11 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 	int			i;
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
-	BlockNumber next_not_all_visible_block;
-	bool		skipping_all_visible_blocks;
+	LVScanState scanstate;
+	ReadStream *stream;
 	xl_heap_freeze_tuple *frozen;
 	StringInfoData buf;
+	LVParallelState *lps = NULL;
 
 	pg_rusage_init(&ru0);
 
@@ -477,109 +587,105 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 	vacrelstats->nonempty_pages = 0;
 	vacrelstats->latestRemovedXid = InvalidTransactionId;
 
-	lazy_space_alloc(vacrelstats, nblocks);
+	/*
+	 * Set up a parallel vacuum of the indexes if it's worth it; it brings its
+	 * own space for the dead tuples.
+	 */
+	nworkers = lazy_parallel_workers(onerel, Irel, nindexes, nworkers);
+	if (nworkers > 0)
+		lps = begin_parallel_vacuum(onerel, vacrelstats, Irel, nindexes,
+									nworkers);
+	if (lps == NULL)
+		lazy_space_alloc(vacrelstats, nblocks);
 	frozen = palloc(sizeof(xl_heap_freeze_tuple) * MaxHeapTuplesPerPage);
 
 	/*
 	 * We want to skip pages that don't require vacuuming according to the
 	 * visibility map, but only when we can skip at least SKIP_PAGES_THRESHOLD
-	 * consecutive pages.  Since we're reading sequentially, the OS should be
-	 * doing readahead for us, so there's no gain in skipping a page now and
-	 * then; that's likely to disable readahead and so be counterproductive.
-	 * Also, skipping even a single page means that we can't update
+	 * consecutive pages.  Since we're reading sequentially, the read stream
+	 * reads runs of consecutive pages with one system call each, so there's
+	 * no gain in skipping a page now and then; that would only break up the
+	 * runs.  Also, skipping even a single page means that we can't update
 	 * relfrozenxid, so we only want to do it if we can skip a goodly number
 	 * of pages.
 	 *
-	 * Before entering the main loop, establish the invariant that
-	 * next_not_all_visible_block is the next block number >= blkno that's not
-	 * all-visible according to the visibility map, or nblocks if there's no
-	 * such block.  Also, we set up the skipping_all_visible_blocks flag,
+	 * The read stream's callback, lazy_scan_next_block, decides which pages
+	 * to skip.  Before starting the stream, establish the invariant that
+	 * next_unskippable_block is the next block number >= next_block that we
+	 * can't skip based on the visibility map, either all-visible for a
+	 * regular vacuum or all-frozen for an anti-wraparound vacuum, or nblocks
+	 * if there's no such block.  Also, we set up the skipping_blocks flag,
 	 * which is needed because we need hysteresis in the decision: once we've
 	 * started skipping blocks, we may as well skip everything up to the next
 	 * not-all-visible block.
 	 *
-	 * Note: if scan_all is true, we won't actually skip any pages; but we
-	 * maintain next_not_all_visible_block anyway, so as to set up the
-	 * all_visible_according_to_vm flag correctly for each page.
-	 *
-	 * Note: The value returned by visibilitymap_test could be slightly
+	 * Note: The value returned by visibilitymap_get_status could be slightly
 	 * out-of-date, since we make this test before reading the corresponding
 	 * heap page or locking the buffer.  This is OK.  If we mistakenly think
-	 * that the page is all-visible when in fact the flag's just been cleared,
-	 * we might fail to vacuum the page.  But it's OK to skip pages when
-	 * scan_all is not set, so no great harm done; the next vacuum will find
-	 * them.  If we make the reverse mistake and vacuum a page unnecessarily,
-	 * it'll just be a no-op.
+	 * that the page is all-visible or all-frozen when in fact the flag's just
+	 * been cleared, we might fail to vacuum the page.  It's easy to see that
+	 * skipping a page when scan_all is not set is not a very big deal; we
+	 * might leave some dead tuples lying around, but the next vacuum will
+	 * find them.  But even when scan_all *is* set, it's still OK if we miss
+	 * a page whose all-frozen marking has just been cleared.  Any new XIDs
+	 * just added to that page are necessarily newer than the GlobalXmin we
+	 * computed, so they'll have no effect on the value to which we can
+	 * safely set relfrozenxid.  A similar argument applies for MXIDs and
+	 * relminmxid.
 	 */
-	for (next_not_all_visible_block = 0;
-		 next_not_all_visible_block < nblocks;
-		 next_not_all_visible_block++)
-	{
-		if (!visibilitymap_test(onerel, next_not_all_visible_block, &vmbuffer))
-			break;
-		vacuum_delay_point();
-	}
-	if (next_not_all_visible_block >= SKIP_PAGES_THRESHOLD)
-		skipping_all_visible_blocks = true;
+	scanstate.onerel = onerel;
+	scanstate.vacrelstats = vacrelstats;
+	scanstate.nblocks = nblocks;
+	scanstate.scan_all = scan_all;
+	scanstate.next_block = 0;
+	scanstate.vmbuffer = InvalidBuffer;
+	scanstate.next_unskippable_block = lazy_next_unskippable_block(&scanstate,
+																   0);
+	if (scanstate.next_unskippable_block >= SKIP_PAGES_THRESHOLD)
+		scanstate.skipping_blocks = true;
 	else
-		skipping_all_visible_blocks = false;
+		scanstate.skipping_blocks = false;
+
+	stream = read_stream_begin_relation(onerel, MAIN_FORKNUM, vac_strategy,
+										lazy_scan_next_block, &scanstate,
+										sizeof(uint8));
 
-	for (blkno = 0; blkno < nblocks; blkno++)
+	for (;;)
 	{
 		Buffer		buf;
+		void	   *per_buffer_data;
 		Page		page;
 		OffsetNumber offnum,
 					maxoff;
 		bool		tupgone,
 					hastup;
-		int			prev_dead_count;
 		int			nfrozen;
 		Size		freespace;
 		bool		all_visible_according_to_vm;
+		bool		all_frozen_according_to_vm;
 		bool		all_visible;
+		bool		all_frozen = true;	/* provided all_visible is also true */
 		bool		has_dead_tuples;
 		TransactionId visibility_cutoff_xid = InvalidTransactionId;
 
-		if (blkno == next_not_all_visible_block)
-		{
-			/* Time to advance next_not_all_visible_block */
-			for (next_not_all_visible_block++;
-				 next_not_all_visible_block < nblocks;
-				 next_not_all_visible_block++)
-			{
-				if (!visibilitymap_test(onerel, next_not_all_visible_block,
-										&vmbuffer))
-					break;
-				vacuum_delay_point();
-			}
-
-			/*
-			 * We know we can't skip the current block.  But set up
-			 * skipping_all_visible_blocks to do the right thing at the
-			 * following blocks.
-			 */
-			if (next_not_all_visible_block - blkno > SKIP_PAGES_THRESHOLD)
-				skipping_all_visible_blocks = true;
-			else
-				skipping_all_visible_blocks = false;
-			all_visible_according_to_vm = false;
-		}
-		else
-		{
-			/* Current block is all-visible */
-			if (skipping_all_visible_blocks && !scan_all)
-				continue;
-			all_visible_according_to_vm = true;
-		}
+		buf = read_stream_next_buffer(stream, &per_buffer_data);
+		if (!BufferIsValid(buf))
+			break;
+		blkno = BufferGetBlockNumber(buf);
+		all_visible_according_to_vm =
+			(*(uint8 *) per_buffer_data & VISIBILITYMAP_ALL_VISIBLE) != 0;
+		all_frozen_according_to_vm =
+			(*(uint8 *) per_buffer_data & VISIBILITYMAP_ALL_FROZEN) != 0;
 
 		vacuum_delay_point();
 
 		/*
 		 * If we are close to overrunning the available space for dead-tuple
 		 * TIDs, pause and do a cycle of vacuuming before we tackle this page.
+		 * (The pages we hold pins on for the read stream, this one included,
+		 * are all still to come, so they're not in the way.)
 		 */
-		if ((vacrelstats->max_dead_tuples - vacrelstats->num_dead_tuples) < MaxHeapTuplesPerPage &&
-			vacrelstats->num_dead_tuples > 0)
+		if (TidStoreIsFull(vacrelstats->dead_tuples))
 		{
 			/*
 			 * Before beginning index vacuuming, we release any pin we may
@@ -597,10 +703,8 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			vacuum_log_cleanup_info(onerel, vacrelstats);
 
 			/* Remove index entries */
-			for (i = 0; i < nindexes; i++)
-				lazy_vacuum_index(Irel[i],
-								  &indstats[i],
-								  vacrelstats);
+			lazy_vacuum_all_indexes(Irel, nindexes, indstats, vacrelstats,
+									lps);
 			/* Remove tuples from heap */
 			lazy_vacuum_heap(onerel, vacrelstats);
 
@@ -609,7 +713,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			 * not to reset latestRemovedXid since we want that value to be
 			 * valid.
 			 */
-			vacrelstats->num_dead_tuples = 0;
+			TidStoreReset(vacrelstats->dead_tuples);
 			vacrelstats->num_index_scans++;
 		}
 
@@ -617,15 +721,12 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 * Pin the visibility map page in case we need to mark the page
 		 * all-visible.  In most cases this will be very cheap, because we'll
 		 * already have the correct page pinned anyway.  However, it's
-		 * possible that (a) next_not_all_visible_block is covered by a
-		 * different VM page than the current block or (b) we released our pin
-		 * and did a cycle of index vacuuming.
+		 * possible that (a) the current block is covered by a different VM
+		 * page than the previous one or (b) we released our pin and did a
+		 * cycle of index vacuuming.
 		 */
 		visibilitymap_pin(onerel, blkno, &vmbuffer);
 
-		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, blkno,
-								 RBM_NORMAL, vac_strategy);
-
 		/* We need buffer cleanup lock so that we can prune HOT chains. */
 		if (!ConditionalLockBufferForCleanup(buf))
 		{
@@ -697,9 +798,14 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			LockBufferForCleanup(buf);
 			if (PageIsNew(page))
 			{
-				ereport(WARNING,
-				(errmsg("relation \"%s\" page %u is uninitialized --- fixing",
-						relname, blkno)));
+				/*
+				 * Bulk inserts into temporary relations leave such pages
+				 * behind routinely, see RelationAddLocalBlocks.
+				 */
+				if (!RelationUsesLocalBuffers(onerel))
+					ereport(WARNING,
+					(errmsg("relation \"%s\" page %u is uninitialized --- fixing",
+							relname, blkno)));
 				PageInit(page, BufferGetPageSize(buf), 0);
 				empty_pages++;
 			}
@@ -716,7 +822,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			empty_pages++;
 			freespace = PageGetHeapFreeSpace(page);
 
-			/* empty pages are always all-visible */
+			/* empty pages are always all-visible and all-frozen */
 			if (!PageIsAllVisible(page))
 			{
 				START_CRIT_SECTION();
@@ -740,7 +846,8 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 
 				PageSetAllVisible(page);
 				visibilitymap_set(onerel, blkno, buf, InvalidXLogRecPtr,
-								  vmbuffer, InvalidTransactionId);
+								  vmbuffer, InvalidTransactionId,
+					   VISIBILITYMAP_ALL_VISIBLE | VISIBILITYMAP_ALL_FROZEN);
 				END_CRIT_SECTION();
 			}
 
@@ -765,7 +872,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		has_dead_tuples = false;
 		nfrozen = 0;
 		hastup = false;
-		prev_dead_count = vacrelstats->num_dead_tuples;
+		vacrelstats->num_page_dead = 0;
 		maxoff = PageGetMaxOffsetNumber(page);
 
 		/*
@@ -917,6 +1024,8 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			}
 			else
 			{
+				bool		tuple_totally_frozen;
+
 				num_tuples += 1;
 				hastup = true;
 
@@ -925,8 +1034,12 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 				 * freezing.  Note we already have exclusive buffer lock.
 				 */
 				if (heap_prepare_freeze_tuple(tuple.t_data, FreezeLimit,
-										  MultiXactCutoff, &frozen[nfrozen]))
+										  MultiXactCutoff, &frozen[nfrozen],
+											  &tuple_totally_frozen))
 					frozen[nfrozen++].offset = offnum;
+
+				if (!tuple_totally_frozen)
+					all_frozen = false;
 			}
 		}						/* scan along page */
 
@@ -968,13 +1081,16 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 
 		/*
 		 * If there are no indexes then we can vacuum the page right now
-		 * instead of doing a second scan.
+		 * instead of doing a second scan.  Otherwise remember its dead
+		 * tuples for the index and heap vacuuming to come.
 		 */
 		if (nindexes == 0 &&
-			vacrelstats->num_dead_tuples > 0)
+			vacrelstats->num_page_dead > 0)
 		{
 			/* Remove tuples from heap */
-			lazy_vacuum_page(onerel, blkno, buf, 0, vacrelstats, &vmbuffer);
+			lazy_vacuum_page(onerel, blkno, buf, vacrelstats->page_dead,
+							 vacrelstats->num_page_dead, vacrelstats,
+							 &vmbuffer);
 			has_dead_tuples = false;
 
 			/*
@@ -982,15 +1098,24 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			 * not to reset latestRemovedXid since we want that value to be
 			 * valid.
 			 */
-			vacrelstats->num_dead_tuples = 0;
+			vacrelstats->num_page_dead = 0;
 			vacuumed_pages++;
 		}
+		else
+			TidStoreAddBlock(vacrelstats->dead_tuples, blkno,
+							 vacrelstats->page_dead,
+							 vacrelstats->num_page_dead);
 
 		freespace = PageGetHeapFreeSpace(page);
 
 		/* mark page all-visible, if appropriate */
 		if (all_visible && !all_visible_according_to_vm)
 		{
+			uint8		flags = VISIBILITYMAP_ALL_VISIBLE;
+
+			if (all_frozen)
+				flags |= VISIBILITYMAP_ALL_FROZEN;
+
 			/*
 			 * It should never be the case that the visibility map page is set
 			 * while the page-level bit is clear, but the reverse is allowed
@@ -1007,7 +1132,7 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 			PageSetAllVisible(page);
 			MarkBufferDirty(buf);
 			visibilitymap_set(onerel, blkno, buf, InvalidXLogRecPtr,
-							  vmbuffer, visibility_cutoff_xid);
+							  vmbuffer, visibility_cutoff_xid, flags);
 		}
 
 		/*
@@ -1018,11 +1143,12 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 * that something bad has happened.
 		 */
 		else if (all_visible_according_to_vm && !PageIsAllVisible(page)
-				 && visibilitymap_test(onerel, blkno, &vmbuffer))
+				 && VM_ALL_VISIBLE(onerel, blkno, &vmbuffer))
 		{
 			elog(WARNING, "page is not marked all-visible but visibility map bit is set in relation \"%s\" page %u",
 				 relname, blkno);
-			visibilitymap_clear(onerel, blkno, vmbuffer);
+			visibilitymap_clear(onerel, blkno, vmbuffer,
+								VISIBILITYMAP_VALID_BITS);
 		}
 
 		/*
@@ -1044,7 +1170,27 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 				 relname, blkno);
 			PageClearAllVisible(page);
 			MarkBufferDirty(buf);
-			visibilitymap_clear(onerel, blkno, vmbuffer);
+			visibilitymap_clear(onerel, blkno, vmbuffer,
+								VISIBILITYMAP_VALID_BITS);
+		}
+
+		/*
+		 * If the all-visible page is all-frozen but not marked as such yet,
+		 * mark it as all-frozen.  Note that all_frozen is only valid if
+		 * all_visible is true, so we must check both.
+		 */
+		else if (all_visible_according_to_vm && all_visible && all_frozen &&
+				 !all_frozen_according_to_vm &&
+				 !VM_ALL_FROZEN(onerel, blkno, &vmbuffer))
+		{
+			/*
+			 * We can pass InvalidTransactionId as the cutoff XID here,
+			 * because setting the all-frozen bit doesn't cause recovery
+			 * conflicts.
+			 */
+			visibilitymap_set(onerel, blkno, buf, InvalidXLogRecPtr,
+							  vmbuffer, InvalidTransactionId,
+							  VISIBILITYMAP_ALL_FROZEN);
 		}
 
 		UnlockReleaseBuffer(buf);
@@ -1060,10 +1206,14 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 		 * page, so remember its free space as-is.  (This path will always be
 		 * taken if there are no indexes.)
 		 */
-		if (vacrelstats->num_dead_tuples == prev_dead_count)
+		if (vacrelstats->num_page_dead == 0)
 			RecordPageWithFreeSpace(onerel, blkno, freespace);
 	}
 
+	read_stream_end(stream);
+	if (BufferIsValid(scanstate.vmbuffer))
+		ReleaseBuffer(scanstate.vmbuffer);
+
 	pfree(frozen);
 
 	/* save stats for use later */
@@ -1088,24 +1238,23 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 
 	/* If any tuples need to be deleted, perform final vacuum cycle */
 	/* XXX put a threshold on min number of tuples here? */
-	if (vacrelstats->num_dead_tuples > 0)
+	if (TidStoreNumTids(vacrelstats->dead_tuples) > 0)
 	{
 		/* Log cleanup info before we touch indexes */
 		vacuum_log_cleanup_info(onerel, vacrelstats);
 
 		/* Remove index entries */
-		for (i = 0; i < nindexes; i++)
-			lazy_vacuum_index(Irel[i],
-							  &indstats[i],
-							  vacrelstats);
+		lazy_vacuum_all_indexes(Irel, nindexes, indstats, vacrelstats, lps);
 		/* Remove tuples from heap */
 		lazy_vacuum_heap(onerel, vacrelstats);
 		vacrelstats->num_index_scans++;
 	}
 
 	/* Do post-vacuum cleanup and statistics update for each index */
-	for (i = 0; i < nindexes; i++)
-		lazy_cleanup_index(Irel[i], indstats[i], vacrelstats);
+	lazy_cleanup_all_indexes(Irel, nindexes, indstats, vacrelstats, lps);
+
+	if (lps != NULL)
+		end_parallel_vacuum(lps, vacrelstats);
 
 	/* If no indexes, make log report that lazy_vacuum_heap would've made */
 	if (vacuumed_pages)
@@ -1145,6 +1294,110 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 }
 
 
+/*
+ *	lazy_scan_next_block() -- choose the next page for lazy_scan_heap
+ *
+ *		This is the callback of lazy_scan_heap's read stream, which skips
+ *		all-visible, or for an anti-wraparound vacuum all-frozen, pages as
+ *		explained there.
+ */
+static BlockNumber
+lazy_scan_next_block(ReadStream *stream, void *callback_private_data,
+					 void *per_buffer_data)
+{
+	LVScanState *scanstate = (LVScanState *) callback_private_data;
+	uint8	   *vmstatus = (uint8 *) per_buffer_data;
+
+	while (scanstate->next_block < scanstate->nblocks)
+	{
+		BlockNumber blkno = scanstate->next_block++;
+
+		if (blkno == scanstate->next_unskippable_block)
+		{
+			/* Time to advance next_unskippable_block */
+			scanstate->next_unskippable_block =
+				lazy_next_unskippable_block(scanstate, blkno + 1);
+
+			/*
+			 * We know we can't skip the current block.  But set up
+			 * skipping_blocks to do the right thing at the following blocks.
+			 */
+			if (scanstate->next_unskippable_block - blkno >
+				SKIP_PAGES_THRESHOLD)
+				scanstate->skipping_blocks = true;
+			else
+				scanstate->skipping_blocks = false;
+
+			/*
+			 * Normally, the fact that we can't skip this block must mean that
+			 * it's not all-visible.  But in an anti-wraparound vacuum we know
+			 * only that it's not all-frozen, so it might still be
+			 * all-visible.
+			 */
+			if (scanstate->scan_all &&
+				VM_ALL_VISIBLE(scanstate->onerel, blkno, &scanstate->vmbuffer))
+				*vmstatus = VISIBILITYMAP_ALL_VISIBLE;
+			else
+				*vmstatus = 0;
+			return blkno;
+		}
+
+		/*
+		 * The current block is potentially skippable; if we've seen a long
+		 * enough run of skippable blocks to justify skipping it, go ahead
+		 * and skip.  Otherwise, the page must be at least all-visible if not
+		 * all-frozen.
+		 */
+		if (scanstate->skipping_blocks)
+		{
+			if (scanstate->scan_all ||
+				VM_ALL_FROZEN(scanstate->onerel, blkno, &scanstate->vmbuffer))
+				scanstate->vacrelstats->frozenskipped_pages++;
+			continue;
+		}
+		*vmstatus = VISIBILITYMAP_ALL_VISIBLE;
+		if (scanstate->scan_all)
+			*vmstatus |= VISIBILITYMAP_ALL_FROZEN;
+		return blkno;
+	}
+
+	return InvalidBlockNumber;
+}
+
+/*
+ *	lazy_next_unskippable_block() -- find the next page lazy_scan_heap can't
+ *									 skip
+ *
+ *		Returns the first block number >= blkno that isn't all-visible, or
+ *		all-frozen for an anti-wraparound vacuum, according to the visibility
+ *		map; or the number of blocks if there's no such block.
+ */
+static BlockNumber
+lazy_next_unskippable_block(LVScanState *scanstate, BlockNumber blkno)
+{
+	for (; blkno < scanstate->nblocks; blkno++)
+	{
+		uint8		vmstatus;
+
+		vmstatus = visibilitymap_get_status(scanstate->onerel, blkno,
+											&scanstate->vmbuffer);
+		if (scanstate->scan_all)
+		{
+			if ((vmstatus & VISIBILITYMAP_ALL_FROZEN) == 0)
+				break;
+		}
+		else
+		{
+			if ((vmstatus & VISIBILITYMAP_ALL_VISIBLE) == 0)
+				break;
+		}
+		vacuum_delay_point();
+	}
+
+	return blkno;
+}
+
+
 /*
  *	lazy_vacuum_heap() -- second pass over the heap
  *
@@ -1159,35 +1412,40 @@ lazy_scan_heap(Relation onerel, LVRelStats *vacrelstats,
 static void
 lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 {
-	int			tupindex;
+	TidStore   *store = vacrelstats->dead_tuples;
+	OffsetNumber deadoffsets[MaxOffsetNumber];
+	int			nblocks = TidStoreNumBlocks(store);
+	int			blockno;
+	double		ntuples;
 	int			npages;
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
 
 	pg_rusage_init(&ru0);
+	ntuples = 0;
 	npages = 0;
 
-	tupindex = 0;
-	while (tupindex < vacrelstats->num_dead_tuples)
+	for (blockno = 0; blockno < nblocks; blockno++)
 	{
 		BlockNumber tblk;
+		int			ndead;
 		Buffer		buf;
 		Page		page;
 		Size		freespace;
 
 		vacuum_delay_point();
 
-		tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]);
+		tblk = TidStoreGetBlock(store, blockno, deadoffsets, &ndead);
+		ntuples += ndead;
 		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, tblk, RBM_NORMAL,
 								 vac_strategy);
 		if (!ConditionalLockBufferForCleanup(buf))
 		{
 			ReleaseBuffer(buf);
-			++tupindex;
 			continue;
 		}
-		tupindex = lazy_vacuum_page(onerel, tblk, buf, tupindex, vacrelstats,
-									&vmbuffer);
+		lazy_vacuum_page(onerel, tblk, buf, deadoffsets, ndead, vacrelstats,
+						 &vmbuffer);
 
 		/* Now that we've compacted the page, record its available space */
 		page = BufferGetPage(buf);
@@ -1205,9 +1463,9 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 	}
 
 	ereport(elevel,
-			(errmsg("\"%s\": removed %d row versions in %d pages",
+			(errmsg("\"%s\": removed %.0f row versions in %d pages",
 					RelationGetRelationName(onerel),
-					tupindex, npages),
+					ntuples, npages),
 			 errdetail("%s.",
 					   pg_rusage_show(&ru0))));
 }
@@ -1218,31 +1476,28 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
  *
  * Caller must hold pin and buffer cleanup lock on the buffer.
  *
- * tupindex is the index in vacrelstats->dead_tuples of the first dead
- * tuple for this page.  We assume the rest follow sequentially.
- * The return value is the first tupindex after the tuples of this page.
+ * deadoffsets holds the offsets of the page's ndead dead tuples, in
+ * ascending order.
  */
-static int
+static void
 lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
-				 int tupindex, LVRelStats *vacrelstats, Buffer *vmbuffer)
+				 OffsetNumber *deadoffsets, int ndead,
+				 LVRelStats *vacrelstats, Buffer *vmbuffer)
 {
 	Page		page = BufferGetPage(buffer);
 	OffsetNumber unused[MaxOffsetNumber];
 	int			uncnt = 0;
 	TransactionId visibility_cutoff_xid;
+	bool		all_frozen;
+	int			i;
 
 	START_CRIT_SECTION();
 
-	for (; tupindex < vacrelstats->num_dead_tuples; tupindex++)
+	for (i = 0; i < ndead; i++)
 	{
-		BlockNumber tblk;
-		OffsetNumber toff;
+		OffsetNumber toff = deadoffsets[i];
 		ItemId		itemid;
 
-		tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]);
-		if (tblk != blkno)
-			break;				/* past end of tuples for this block */
-		toff = ItemPointerGetOffsetNumber(&vacrelstats->dead_tuples[tupindex]);
 		itemid = PageGetItemId(page, toff);
 		ItemIdSetUnused(itemid);
 		unused[uncnt++] = toff;
@@ -1281,22 +1536,31 @@ lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
 	 * dirty, exclusively locked, and, if needed, a full page image has been
 	 * emitted in the log_heap_clean() above.
 	 */
-	if (heap_page_is_all_visible(onerel, buffer, &visibility_cutoff_xid))
+	if (heap_page_is_all_visible(onerel, buffer, &visibility_cutoff_xid,
+								 &all_frozen))
 		PageSetAllVisible(page);
 
 	/*
 	 * All the changes to the heap page have been done. If the all-visible
-	 * flag is now set, also set the VM bit.
+	 * flag is now set, also set the VM all-visible bit (and, if possible, the
+	 * all-frozen bit) unless this has already been done previously.
 	 */
-	if (PageIsAllVisible(page) &&
-		!visibilitymap_test(onerel, blkno, vmbuffer))
+	if (PageIsAllVisible(page))
 	{
+		uint8		vm_status = visibilitymap_get_status(onerel, blkno, vmbuffer);
+		uint8		flags = 0;
+
+		/* Set the VM all-frozen bit to flag, if needed */
+		if ((vm_status & VISIBILITYMAP_ALL_VISIBLE) == 0)
+			flags |= VISIBILITYMAP_ALL_VISIBLE;
+		if ((vm_status & VISIBILITYMAP_ALL_FROZEN) == 0 && all_frozen)
+			flags |= VISIBILITYMAP_ALL_FROZEN;
+
 		Assert(BufferIsValid(*vmbuffer));
-		visibilitymap_set(onerel, blkno, buffer, InvalidXLogRecPtr, *vmbuffer,
-						  visibility_cutoff_xid);
+		if (flags != 0)
+			visibilitymap_set(onerel, blkno, buffer, InvalidXLogRecPtr,
+							  *vmbuffer, visibility_cutoff_xid, flags);
 	}
-
-	return tupindex;
 }
 
 /*
@@ -1344,6 +1608,67 @@ lazy_check_needs_freeze(Buffer buf)
 }
 
 
+/*
+ *	lazy_vacuum_all_indexes() -- vacuum all indexes of the relation.
+ *
+ *		In a parallel vacuum, the indexes' statistics are kept in shared
+ *		memory rather than in indstats.
+ */
+static void
+lazy_vacuum_all_indexes(Relation *Irel, int nindexes,
+						IndexBulkDeleteResult **indstats,
+						LVRelStats *vacrelstats, LVParallelState *lps)
+{
+	int			i;
+
+	if (lps != NULL)
+	{
+		lazy_parallel_vacuum_indexes(lps, Irel, vacrelstats, false);
+		return;
+	}
+
+	for (i = 0; i < nindexes; i++)
+		lazy_vacuum_index(Irel[i], &indstats[i], vacrelstats);
+}
+
+/*
+ *	lazy_cleanup_all_indexes() -- do post-vacuum cleanup for all indexes,
+ *		and update their statistics in pg_class.
+ */
+static void
+lazy_cleanup_all_indexes(Relation *Irel, int nindexes,
+						 IndexBulkDeleteResult **indstats,
+						 LVRelStats *vacrelstats, LVParallelState *lps)
+{
+	int			i;
+
+	if (lps != NULL)
+	{
+		lazy_parallel_vacuum_indexes(lps, Irel, vacrelstats, true);
+
+		/* We're out of parallel mode again, so pg_class can be updated */
+		for (i = 0; i < nindexes; i++)
+		{
+			LVSharedIndStats *s = LVSharedIndStatsAt(lps->shared, i);
+
+			if (s->updated)
+				lazy_update_index_stats(Irel[i], &s->stats);
+		}
+		return;
+	}
+
+	for (i = 0; i < nindexes; i++)
+	{
+		lazy_cleanup_index(Irel[i], &indstats[i], vacrelstats);
+		if (indstats[i])
+		{
+			lazy_update_index_stats(Irel[i], indstats[i]);
+			pfree(indstats[i]);
+			indstats[i] = NULL;
+		}
+	}
+}
+
 /*
  *	lazy_vacuum_index() -- vacuum one index relation.
  *
@@ -1372,18 +1697,21 @@ lazy_vacuum_index(Relation indrel,
 							   lazy_tid_reaped, (void *) vacrelstats);
 
 	ereport(elevel,
-			(errmsg("scanned index \"%s\" to remove %d row versions",
+			(errmsg("scanned index \"%s\" to remove %.0f row versions",
 					RelationGetRelationName(indrel),
-					vacrelstats->num_dead_tuples),
+					(double) TidStoreNumTids(vacrelstats->dead_tuples)),
 			 errdetail("%s.", pg_rusage_show(&ru0))));
 }
 
 /*
  *	lazy_cleanup_index() -- do post-vacuum cleanup for one index relation.
+ *
+ *		*stats is replaced by the final statistics, or NULL if the index AM
+ *		didn't return any.  The caller updates pg_class with them.
  */
 static void
 lazy_cleanup_index(Relation indrel,
-				   IndexBulkDeleteResult *stats,
+				   IndexBulkDeleteResult **stats,
 				   LVRelStats *vacrelstats)
 {
 	IndexVacuumInfo ivinfo;
@@ -1398,15 +1726,31 @@ lazy_cleanup_index(Relation indrel,
 	ivinfo.num_heap_tuples = vacrelstats->new_rel_tuples;
 	ivinfo.strategy = vac_strategy;
 
-	stats = index_vacuum_cleanup(&ivinfo, stats);
+	*stats = index_vacuum_cleanup(&ivinfo, *stats);
 
-	if (!stats)
+	if (!*stats)
 		return;
 
-	/*
-	 * Now update statistics in pg_class, but only if the index says the count
-	 * is accurate.
-	 */
+	ereport(elevel,
+			(errmsg("index \"%s\" now contains %.0f row versions in %u pages",
+					RelationGetRelationName(indrel),
+					(*stats)->num_index_tuples,
+					(*stats)->num_pages),
+			 errdetail("%.0f index row versions were removed.\n"
+			 "%u index pages have been deleted, %u are currently reusable.\n"
+					   "%s.",
+					   (*stats)->tuples_removed,
+					   (*stats)->pages_deleted, (*stats)->pages_free,
+					   pg_rusage_show(&ru0))));
+}
+
+/*
+ *	lazy_update_index_stats() -- update an index's statistics in pg_class,
+ *		but only if the index says the count is accurate.
+ */
+static void
+lazy_update_index_stats(Relation indrel, IndexBulkDeleteResult *stats)
+{
 	if (!stats->estimated_count)
 		vac_update_relstats(indrel,
 							stats->num_pages,
@@ -1416,20 +1760,294 @@ lazy_cleanup_index(Relation indrel,
 							InvalidTransactionId,
 							InvalidMultiXactId,
 							false);
+}
 
-	ereport(elevel,
-			(errmsg("index \"%s\" now contains %.0f row versions in %u pages",
-					RelationGetRelationName(indrel),
-					stats->num_index_tuples,
-					stats->num_pages),
-			 errdetail("%.0f index row versions were removed.\n"
-			 "%u index pages have been deleted, %u are currently reusable.\n"
-					   "%s.",
-					   stats->tuples_removed,
-					   stats->pages_deleted, stats->pages_free,
-					   pg_rusage_show(&ru0))));
+/*
+ * Parallel vacuum
+ */
+
+/*
+ *	lazy_parallel_workers() -- choose the number of workers to vacuum the
+ *		indexes with, or zero to vacuum them serially.
+ *
+ *		nrequested is the PARALLEL option, or -1 if none was given.  We never
+ *		need more workers than there are indexes besides the one we take
+ *		ourselves.
+ */
+static int
+lazy_parallel_workers(Relation onerel, Relation *Irel, int nindexes,
+					  int nrequested)
+{
+	int			nworkers;
+	int			i;
+
+	/* Workers can't see our temp tables' local buffers */
+	if (nrequested == 0 ||
+		nindexes < 2 ||
+		max_parallel_maintenance_workers == 0 ||
+		!IsUnderPostmaster ||
+		RelationUsesLocalBuffers(onerel) ||
+		IsInParallelMode() ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
+
+	if (nrequested > 0)
+		nworkers = nrequested;
+	else
+	{
+		/* one worker for each index that's big enough to be worth it */
+		nworkers = 0;
+		for (i = 0; i < nindexes; i++)
+		{
+			if (RelationGetNumberOfBlocks(Irel[i]) >=
+				PARALLEL_VACUUM_MIN_INDEX_PAGES)
+				nworkers++;
+		}
+	}
+
+	nworkers = Min(nworkers, nindexes - 1);
+	nworkers = Min(nworkers, max_parallel_maintenance_workers);
 
-	pfree(stats);
+	return nworkers;
+}
+
+/*
+ *	begin_parallel_vacuum() -- set up the shared state of a parallel vacuum,
+ *		including the space for the dead tuples.
+ *
+ *		Returns NULL if no DSM segment can be had, in which case the caller
+ *		falls back to a serial vacuum.
+ */
+static LVParallelState *
+begin_parallel_vacuum(Relation onerel, LVRelStats *vacrelstats,
+					  Relation *Irel, int nindexes, int nworkers)
+{
+	LVParallelState *lps;
+	LVShared   *shared;
+	dsm_segment *seg;
+	Size		space;
+	Size		size;
+	int			i;
+
+	space = lazy_dead_tuples_space(vacrelstats, vacrelstats->rel_pages);
+
+	size = add_size(MAXALIGN(sizeof(LVShared)),
+					mul_size(nindexes, MAXALIGN(sizeof(LVSharedIndStats))));
+	size = add_size(size, space);
+
+	seg = dsm_create(size, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (seg == NULL)
+		return NULL;
+
+	shared = (LVShared *) dsm_segment_address(seg);
+	memset(shared, 0, MAXALIGN(sizeof(LVShared)));
+	shared->relid = RelationGetRelid(onerel);
+	shared->nindexes = nindexes;
+	shared->elevel = elevel;
+	pg_atomic_init_u32(&shared->nextindex, 0);
+
+	for (i = 0; i < nindexes; i++)
+	{
+		LVSharedIndStats *s = LVSharedIndStatsAt(shared, i);
+
+		s->indexrelid = RelationGetRelid(Irel[i]);
+		s->updated = false;
+	}
+
+	vacrelstats->dead_tuples = TidStoreCreate(LVSharedDeadTuples(shared),
+											  space);
+
+	lps = (LVParallelState *) palloc(sizeof(LVParallelState));
+	lps->seg = seg;
+	lps->shared = shared;
+	lps->nworkers = nworkers;
+
+	return lps;
+}
+
+/*
+ *	end_parallel_vacuum() -- release the shared state, dead tuples included.
+ */
+static void
+end_parallel_vacuum(LVParallelState *lps, LVRelStats *vacrelstats)
+{
+	vacrelstats->dead_tuples = NULL;
+
+	dsm_detach(lps->seg);
+	pfree(lps);
+}
+
+/*
+ *	lazy_parallel_vacuum_indexes() -- do one round of parallel bulk deletion,
+ *		or the parallel index cleanup.
+ *
+ *		We launch the workers afresh each time, and vacuum indexes alongside
+ *		them until none is left.  The cost-based delay is shared out evenly,
+ *		so that all participants together stay within the limit that we
+ *		would have on our own.
+ */
+static void
+lazy_parallel_vacuum_indexes(LVParallelState *lps, Relation *Irel,
+							 LVRelStats *vacrelstats, bool for_cleanup)
+{
+	LVShared   *shared = lps->shared;
+	ParallelContext *pcxt;
+	dsm_handle *handle;
+	int			saved_cost_limit = VacuumCostLimit;
+
+	shared->for_cleanup = for_cleanup;
+	shared->rel_pages = vacrelstats->rel_pages;
+	shared->scanned_pages = vacrelstats->scanned_pages;
+	shared->old_rel_tuples = vacrelstats->old_rel_tuples;
+	shared->new_rel_tuples = vacrelstats->new_rel_tuples;
+	shared->cost_delay = VacuumCostDelay;
+	shared->cost_limit = Max(VacuumCostLimit / (lps->nworkers + 1), 1);
+	pg_atomic_write_u32(&shared->nextindex, 0);
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext(lazy_parallel_vacuum_main, lps->nworkers);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(dsm_handle));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	InitializeParallelDSM(pcxt);
+
+	handle = (dsm_handle *) shm_toc_allocate(pcxt->toc, sizeof(dsm_handle));
+	*handle = dsm_segment_handle(lps->seg);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_VACUUM_SHARED, handle);
+
+	LaunchParallelWorkers(pcxt);
+
+	/* VacuumCostLimit may be a GUC variable, so put it back come what may */
+	PG_TRY();
+	{
+		if (VacuumCostActive)
+			VacuumCostLimit = shared->cost_limit;
+
+		lazy_parallel_process_indexes(shared, Irel, vacrelstats);
+
+		/* This rethrows any error a worker ran into */
+		WaitForParallelWorkersToFinish(pcxt);
+	}
+	PG_CATCH();
+	{
+		VacuumCostLimit = saved_cost_limit;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	VacuumCostLimit = saved_cost_limit;
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+}
+
+/*
+ *	lazy_parallel_process_indexes() -- vacuum or clean up indexes handed out
+ *		from shared->nextindex, until there are none left.
+ *
+ *		This is done by the leader and the workers alike.  Irel must be in
+ *		the same order as the shared statistics.
+ */
+static void
+lazy_parallel_process_indexes(LVShared *shared, Relation *Irel,
+							  LVRelStats *vacrelstats)
+{
+	for (;;)
+	{
+		uint32		idx = pg_atomic_fetch_add_u32(&shared->nextindex, 1);
+		LVSharedIndStats *s;
+		IndexBulkDeleteResult *stats;
+
+		if (idx >= (uint32) shared->nindexes)
+			break;
+
+		s = LVSharedIndStatsAt(shared, idx);
+		stats = s->updated ? &s->stats : NULL;
+
+		if (shared->for_cleanup)
+			lazy_cleanup_index(Irel[idx], &stats, vacrelstats);
+		else
+			lazy_vacuum_index(Irel[idx], &stats, vacrelstats);
+
+		/* The AM may have allocated the statistics on its own */
+		if (stats == NULL)
+			s->updated = false;
+		else
+		{
+			if (stats != &s->stats)
+			{
+				memcpy(&s->stats, stats, sizeof(IndexBulkDeleteResult));
+				pfree(stats);
+			}
+			s->updated = true;
+		}
+	}
+}
+
+/*
+ * lazy_parallel_vacuum_main
+ *
+ * Entry point of a parallel vacuum worker: vacuum or clean up indexes, just
+ * as the leader does, until there are none left.
+ */
+void
+lazy_parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
+{
+	dsm_handle *handle;
+	dsm_segment *vacseg;
+	LVShared   *shared;
+	LVRelStats	vacrelstats;
+	Relation   *Irel;
+	int			i;
+
+	handle = (dsm_handle *) shm_toc_lookup(toc, PARALLEL_KEY_VACUUM_SHARED);
+	if (handle == NULL)
+		elog(ERROR, "invalid parallel vacuum state");
+
+	vacseg = dsm_attach(*handle);
+	if (vacseg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	shared = (LVShared *) dsm_segment_address(vacseg);
+
+	/*
+	 * The leader holds the locks a vacuum needs until we are done, and we
+	 * cannot take locks of our own that would conflict with them.
+	 */
+	Irel = (Relation *) palloc(shared->nindexes * sizeof(Relation));
+	for (i = 0; i < shared->nindexes; i++)
+		Irel[i] = index_open(LVSharedIndStatsAt(shared, i)->indexrelid,
+							 NoLock);
+
+	elevel = shared->elevel;
+	vac_strategy = GetAccessStrategy(BAS_VACUUM);
+
+	/* autovacuum's delay settings aren't GUCs, so take them from the leader */
+	VacuumCostDelay = shared->cost_delay;
+	VacuumCostLimit = shared->cost_limit;
+	VacuumCostActive = (VacuumCostDelay > 0);
+	VacuumCostBalance = 0;
+	VacuumPageHit = 0;
+	VacuumPageMiss = 0;
+	VacuumPageDirty = 0;
+
+	/* What the index AM calls need to know about the heap */
+	memset(&vacrelstats, 0, sizeof(LVRelStats));
+	vacrelstats.hasindex = true;
+	vacrelstats.rel_pages = shared->rel_pages;
+	vacrelstats.scanned_pages = shared->scanned_pages;
+	vacrelstats.old_rel_tuples = shared->old_rel_tuples;
+	vacrelstats.new_rel_tuples = shared->new_rel_tuples;
+	vacrelstats.dead_tuples = (TidStore *) LVSharedDeadTuples(shared);
+
+	lazy_parallel_process_indexes(shared, Irel, &vacrelstats);
+
+	for (i = 0; i < shared->nindexes; i++)
+		index_close(Irel[i], NoLock);
+
+	FreeAccessStrategy(vac_strategy);
+	dsm_detach(vacseg);
 }
 
 /*
@@ -1673,111 +2291,76 @@ count_nondeletable_pages(Relation onerel, LVRelStats *vacrelstats)
 }
 
 /*
- * lazy_space_alloc - space allocation decisions for lazy vacuum
+ * lazy_dead_tuples_space - how much memory do we use to track dead tuples?
  *
  * See the comments at the head of this file for rationale.
  */
-static void
-lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks)
+static Size
+lazy_dead_tuples_space(LVRelStats *vacrelstats, BlockNumber relblocks)
 {
-	long		maxtuples;
+	Size		space;
 	int			vac_work_mem = IsAutoVacuumWorkerProcess() &&
 	autovacuum_work_mem != -1 ?
 	autovacuum_work_mem : maintenance_work_mem;
 
 	if (vacrelstats->hasindex)
 	{
-		maxtuples = (vac_work_mem * 1024L) / sizeof(ItemPointerData);
-		maxtuples = Min(maxtuples, INT_MAX);
-		maxtuples = Min(maxtuples, MaxAllocSize / sizeof(ItemPointerData));
+		space = (Size) vac_work_mem * 1024;
 
-		/* curious coding here to ensure the multiplication can't overflow */
-		if ((BlockNumber) (maxtuples / LAZY_ALLOC_TUPLES) > relblocks)
-			maxtuples = relblocks * LAZY_ALLOC_TUPLES;
+		/* no more than the whole relation could need */
+		space = Min(space, TidStoreSizeForBlocks(relblocks));
 
 		/* stay sane if small maintenance_work_mem */
-		maxtuples = Max(maxtuples, MaxHeapTuplesPerPage);
+		space = Max(space, TidStoreSizeForBlocks(1));
 	}
 	else
 	{
-		maxtuples = MaxHeapTuplesPerPage;
+		space = TidStoreSizeForBlocks(1);
 	}
 
-	vacrelstats->num_dead_tuples = 0;
-	vacrelstats->max_dead_tuples = (int) maxtuples;
-	vacrelstats->dead_tuples = (ItemPointer)
-		palloc(maxtuples * sizeof(ItemPointerData));
+	return space;
+}
+
+/*
+ * lazy_space_alloc - allocate space for the dead tuples in local memory
+ */
+static void
+lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks)
+{
+	Size		space = lazy_dead_tuples_space(vacrelstats, relblocks);
+
+	vacrelstats->dead_tuples =
+		TidStoreCreate(MemoryContextAllocHuge(CurrentMemoryContext, space),
+					   space);
 }
 
 /*
  * lazy_record_dead_tuple - remember one deletable tuple
+ *
+ * The tuples of the page being scanned are collected in vacrelstats, and
+ * go into the TID store together once the page is done.
  */
 static void
 lazy_record_dead_tuple(LVRelStats *vacrelstats,
 					   ItemPointer itemptr)
 {
-	/*
-	 * The array shouldn't overflow under normal behavior, but perhaps it
-	 * could if we are given a really small maintenance_work_mem. In that
-	 * case, just forget the last few tuples (we'll get 'em next time).
-	 */
-	if (vacrelstats->num_dead_tuples < vacrelstats->max_dead_tuples)
-	{
-		vacrelstats->dead_tuples[vacrelstats->num_dead_tuples] = *itemptr;
-		vacrelstats->num_dead_tuples++;
-	}
+	Assert(vacrelstats->num_page_dead < MaxHeapTuplesPerPage);
+
+	vacrelstats->page_dead[vacrelstats->num_page_dead++] =
+		ItemPointerGetOffsetNumber(itemptr);
 }
 
 /*
  *	lazy_tid_reaped() -- is a particular tid deletable?
  *
  *		This has the right signature to be an IndexBulkDeleteCallback.
- *
- *		Assumes dead_tuples array is in sorted order.
  */
 static bool
 lazy_tid_reaped(ItemPointer itemptr, void *state)
 {
 	LVRelStats *vacrelstats = (LVRelStats *) state;
-	ItemPointer res;
-
-	res = (ItemPointer) bsearch((void *) itemptr,
-								(void *) vacrelstats->dead_tuples,
-								vacrelstats->num_dead_tuples,
-								sizeof(ItemPointerData),
-								vac_cmp_itemptr);
 
-	return (res != NULL);
-}
-
-/*
- * Comparator routines for use with qsort() and bsearch().
- */
-static int
-vac_cmp_itemptr(const void *left, const void *right)
-{
-	BlockNumber lblk,
-				rblk;
-	OffsetNumber loff,
-				roff;
-
-	lblk = ItemPointerGetBlockNumber((ItemPointer) left);
-	rblk = ItemPointerGetBlockNumber((ItemPointer) right);
-
-	if (lblk < rblk)
-		return -1;
-	if (lblk > rblk)
-		return 1;
-
-	loff = ItemPointerGetOffsetNumber((ItemPointer) left);
-	roff = ItemPointerGetOffsetNumber((ItemPointer) right);
-
-	if (loff < roff)
-		return -1;
-	if (loff > roff)
-		return 1;
-
-	return 0;
+	return TidStoreIsMember(vacrelstats->dead_tuples, itemptr);
 }
 
 /*
@@ -1786,7 +2369,9 @@ vac_cmp_itemptr(const void *left, const void *right)
  * xmin amongst the visible tuples.
  */
 static bool
-heap_page_is_all_visible(Relation rel, Buffer buf, TransactionId *visibility_cutoff_xid)
+heap_page_is_all_visible(Relation rel, Buffer buf,
+						 TransactionId *visibility_cutoff_xid,
+						 bool *all_frozen)
 {
 	Page		page = BufferGetPage(buf);
 	BlockNumber blockno = BufferGetBlockNumber(buf);
@@ -1795,6 +2380,7 @@ heap_page_is_all_visible(Relation rel, Buffer buf, TransactionId *visibility_cut
 	bool		all_visible = true;
 
 	*visibility_cutoff_xid = InvalidTransactionId;
+	*all_frozen = true;
 
 	/*
 	 * This is a stripped down version of the line pointer scan in
@@ -1823,6 +2409,7 @@ heap_page_is_all_visible(Relation rel, Buffer buf, TransactionId *visibility_cut
 		if (ItemIdIsDead(itemid))
 		{
 			all_visible = false;
+			*all_frozen = false;
 			break;
 		}
 
@@ -1842,6 +2429,7 @@ heap_page_is_all_visible(Relation rel, Buffer buf, TransactionId *visibility_cut
 					if (!HeapTupleHeaderXminCommitted(tuple.t_data))
 					{
 						all_visible = false;
+						*all_frozen = false;
 						break;
 					}
 
@@ -1853,12 +2441,18 @@ heap_page_is_all_visible(Relation rel, Buffer buf, TransactionId *visibility_cut
 					if (!TransactionIdPrecedes(xmin, OldestXmin))
 					{
 						all_visible = false;
+						*all_frozen = false;
 						break;
 					}
 
 					/* Track newest xmin on page. */
 					if (TransactionIdFollows(xmin, *visibility_cutoff_xid))
 						*visibility_cutoff_xid = xmin;
+
+					/* Check whether this tuple is already frozen or not */
+					if (all_visible && *all_frozen &&
+						heap_tuple_needs_eventual_freeze(tuple.t_data))
+						*all_frozen = false;
 				}
 				break;
 
@@ -1867,6 +2461,7 @@ heap_page_is_all_visible(Relation rel, Buffer buf, TransactionId *visibility_cut
 			case HEAPTUPLE_INSERT_IN_PROGRESS:
 			case HEAPTUPLE_DELETE_IN_PROGRESS:
 				all_visible = false;
+				*all_frozen = false;
 				break;
 
 			default:
@@ -0,0 +1,957 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Batch-at-a-time (vectorized) execution of simple scan pipelines.
+ *
+ * The regular executor hands one tuple at a time from node to node, and
+ * evaluates quals and aggregate transition functions through the generic
+ * ExprState and fmgr machinery for every row.  For the very common shape
+ * SeqScan -> simple quals -> plain aggregation, that per-row dispatch is
+ * most of the CPU cost.  This module lets nodeAgg.c pull batches of up to
+ * EXEC_BATCH_SIZE deformed tuples from a SeqScan in columnar arrays,
+ * filter them with tight loops specialized per datatype and comparison
+ * operator, and advance common aggregates (count, sum, avg, min, max on
+ * int4/int8/float8/date) over a whole batch at once.
+ *
+ * Only a deliberately narrow set of constructs is supported: quals must be
+ * "Var op Const" comparisons on pass-by-value columns, and aggregates must
+ * have a single plain Var argument (or none, for count(*)) and a
+ * recognized transition function.  ExecInitBatchScan and ExecBatchAggKind
+ * report when something can't be handled, in which case the caller keeps
+ * using the ordinary row-at-a-time path.  The kernels produce exactly the
+ * same results, including overflow errors, as the SQL-callable functions
+ * they stand in for, because they apply the same arithmetic in the same
+ * row order.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/heapam.h"
+#include "access/relscan.h"
+#include "access/tableam.h"
+#include "catalog/pg_type.h"
+#include "executor/execBatch.h"
+#include "executor/instrument.h"
+#include "miscadmin.h"
+#include "utils/array.h"
+#include "utils/fmgroids.h"
+#include "utils/rel.h"
+
+
+/* GUC variable */
+bool		enable_batch_execution = false;
+
+/* Datatype representation a qual kernel works on */
+typedef enum BatchCmpType
+{
+	BATCH_CMP_INT4,				/* int32 column, int32 constant */
+	BATCH_CMP_INT8,				/* int64 column, int64 constant */
+	BATCH_CMP_INT4_INT8,		/* int32 column, int64 constant */
+	BATCH_CMP_FLOAT8			/* float8 column, float8 constant */
+} BatchCmpType;
+
+typedef enum BatchCmpOp
+{
+	BATCH_OP_EQ,
+	BATCH_OP_NE,
+	BATCH_OP_LT,
+	BATCH_OP_LE,
+	BATCH_OP_GT,
+	BATCH_OP_GE
+} BatchCmpOp;
+
+/*
+ * Mapping from the comparison functions we can vectorize to their kernel.
+ * lefttype/righttype describe the function's declared argument types.
+ */
+typedef struct BatchCmpFunc
+{
+	Oid			funcid;
+	BatchCmpType lefttype;
+	BatchCmpType righttype;
+	BatchCmpOp	op;
+} BatchCmpFunc;
+
+static const BatchCmpFunc batch_cmp_funcs[] =
+{
+	{F_INT4EQ, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_EQ},
+	{F_INT4NE, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_NE},
+	{F_INT4LT, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_LT},
+	{F_INT4LE, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_LE},
+	{F_INT4GT, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_GT},
+	{F_INT4GE, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_GE},
+	{F_INT8EQ, BATCH_CMP_INT8, BATCH_CMP_INT8, BATCH_OP_EQ},
+	{F_INT8NE, BATCH_CMP_INT8, BATCH_CMP_INT8, BATCH_OP_NE},
+	{F_INT8LT, BATCH_CMP_INT8, BATCH_CMP_INT8, BATCH_OP_LT},
+	{F_INT8LE, BATCH_CMP_INT8, BATCH_CMP_INT8, BATCH_OP_LE},
+	{F_INT8GT, BATCH_CMP_INT8, BATCH_CMP_INT8, BATCH_OP_GT},
+	{F_INT8GE, BATCH_CMP_INT8, BATCH_CMP_INT8, BATCH_OP_GE},
+	{F_INT84EQ, BATCH_CMP_INT8, BATCH_CMP_INT4, BATCH_OP_EQ},
+	{F_INT84NE, BATCH_CMP_INT8, BATCH_CMP_INT4, BATCH_OP_NE},
+	{F_INT84LT, BATCH_CMP_INT8, BATCH_CMP_INT4, BATCH_OP_LT},
+	{F_INT84LE, BATCH_CMP_INT8, BATCH_CMP_INT4, BATCH_OP_LE},
+	{F_INT84GT, BATCH_CMP_INT8, BATCH_CMP_INT4, BATCH_OP_GT},
+	{F_INT84GE, BATCH_CMP_INT8, BATCH_CMP_INT4, BATCH_OP_GE},
+	{F_INT48EQ, BATCH_CMP_INT4, BATCH_CMP_INT8, BATCH_OP_EQ},
+	{F_INT48NE, BATCH_CMP_INT4, BATCH_CMP_INT8, BATCH_OP_NE},
+	{F_INT48LT, BATCH_CMP_INT4, BATCH_CMP_INT8, BATCH_OP_LT},
+	{F_INT48LE, BATCH_CMP_INT4, BATCH_CMP_INT8, BATCH_OP_LE},
+	{F_INT48GT, BATCH_CMP_INT4, BATCH_CMP_INT8, BATCH_OP_GT},
+	{F_INT48GE, BATCH_CMP_INT4, BATCH_CMP_INT8, BATCH_OP_GE},
+	{F_DATE_EQ, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_EQ},
+	{F_DATE_NE, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_NE},
+	{F_DATE_LT, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_LT},
+	{F_DATE_LE, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_LE},
+	{F_DATE_GT, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_GT},
+	{F_DATE_GE, BATCH_CMP_INT4, BATCH_CMP_INT4, BATCH_OP_GE},
+	{F_FLOAT8EQ, BATCH_CMP_FLOAT8, BATCH_CMP_FLOAT8, BATCH_OP_EQ},
+	{F_FLOAT8NE, BATCH_CMP_FLOAT8, BATCH_CMP_FLOAT8, BATCH_OP_NE},
+	{F_FLOAT8LT, BATCH_CMP_FLOAT8, BATCH_CMP_FLOAT8, BATCH_OP_LT},
+	{F_FLOAT8LE, BATCH_CMP_FLOAT8, BATCH_CMP_FLOAT8, BATCH_OP_LE},
+	{F_FLOAT8GT, BATCH_CMP_FLOAT8, BATCH_CMP_FLOAT8, BATCH_OP_GT},
+	{F_FLOAT8GE, BATCH_CMP_FLOAT8, BATCH_CMP_FLOAT8, BATCH_OP_GE}
+};
+
+/* One vectorized "column op constant" qual clause */
+typedef struct BatchQual
+{
+	int			col;			/* batch column number */
+	BatchCmpType type;			/* kernel datatype */
+	BatchCmpOp	op;				/* comparison, with column on the left */
+	Datum		constval;		/* comparison constant */
+} BatchQual;
+
+struct BatchScanState
+{
+	ScanState  *scanstate;		/* the SeqScan we pull tuples from */
+	AttrNumber	maxattno;		/* highest attno to deform */
+	int			nquals;
+	BatchQual  *quals;
+	bool		done;			/* heap scan exhausted? */
+	TupleBatch	batch;
+	/* for access methods that return batches themselves */
+	Datum	  **fillvalues;		/* [ncols] where the next rows go */
+	bool	  **fillisnull;		/* [ncols] */
+};
+
+typedef struct Int8TransTypeData
+{
+	int64		count;
+	int64		sum;
+} Int8TransTypeData;
+
+static bool batch_qual_from_clause(Expr *clause, BatchQual *qual,
+					   AttrNumber *attnum);
+static void batch_apply_qual(BatchQual *qual, TupleBatch *batch);
+
+
+/*
+ * Same ordering as float8_cmp_internal(): NaNs are equal to each other and
+ * sort after every non-NaN value.
+ */
+static inline int
+batch_float8_cmp(float8 a, float8 b)
+{
+	if (isnan(a))
+		return isnan(b) ? 0 : 1;
+	if (isnan(b))
+		return -1;
+	if (a > b)
+		return 1;
+	if (a < b)
+		return -1;
+	return 0;
+}
+
+/*
+ * float8 addition with the overflow check float8pl() applies.
+ */
+static inline float8
+batch_float8_add(float8 a, float8 b)
+{
+	float8		result = a + b;
+
+	if (isinf(result) && !(isinf(a) || isinf(b)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("value out of range: overflow")));
+	return result;
+}
+
+static inline BatchCmpOp
+batch_commute_op(BatchCmpOp op)
+{
+	switch (op)
+	{
+		case BATCH_OP_LT:
+			return BATCH_OP_GT;
+		case BATCH_OP_LE:
+			return BATCH_OP_GE;
+		case BATCH_OP_GT:
+			return BATCH_OP_LT;
+		case BATCH_OP_GE:
+			return BATCH_OP_LE;
+		default:
+			return op;
+	}
+}
+
+/*
+ * batch_qual_from_clause
+ *		Try to convert one implicitly-ANDed qual clause into a BatchQual.
+ *
+ * On success, fills *qual (except the column number) and *attnum with the
+ * scan attribute being compared.
+ */
+static bool
+batch_qual_from_clause(Expr *clause, BatchQual *qual, AttrNumber *attnum)
+{
+	OpExpr	   *opexpr;
+	Node	   *leftop;
+	Node	   *rightop;
+	Var		   *var;
+	Const	   *cst;
+	const BatchCmpFunc *func = NULL;
+	BatchCmpType vartype;
+	BatchCmpType consttype;
+	BatchCmpOp	op;
+	int			i;
+
+	if (!IsA(clause, OpExpr))
+		return false;
+	opexpr = (OpExpr *) clause;
+	if (list_length(opexpr->args) != 2)
+		return false;
+
+	for (i = 0; i < lengthof(batch_cmp_funcs); i++)
+	{
+		if (batch_cmp_funcs[i].funcid == opexpr->opfuncid)
+		{
+			func = &batch_cmp_funcs[i];
+			break;
+		}
+	}
+	if (func == NULL)
+		return false;
+
+	leftop = (Node *) linitial(opexpr->args);
+	rightop = (Node *) lsecond(opexpr->args);
+	op = func->op;
+	if (IsA(leftop, Var) && IsA(rightop, Const))
+	{
+		var = (Var *) leftop;
+		cst = (Const *) rightop;
+		vartype = func->lefttype;
+		consttype = func->righttype;
+	}
+	else if (IsA(leftop, Const) && IsA(rightop, Var))
+	{
+		var = (Var *) rightop;
+		cst = (Const *) leftop;
+		vartype = func->righttype;
+		consttype = func->lefttype;
+		op = batch_commute_op(op);
+	}
+	else
+		return false;
+
+	if (var->varattno <= 0 || var->varlevelsup != 0)
+		return false;
+	/* a null constant makes a strict comparison always fail; not worth it */
+	if (cst->constisnull)
+		return false;
+
+	qual->op = op;
+	if (vartype == consttype)
+	{
+		qual->type = vartype;
+		qual->constval = cst->constvalue;
+	}
+	else if (vartype == BATCH_CMP_INT8 && consttype == BATCH_CMP_INT4)
+	{
+		/* widen the constant once, rather than every column value */
+		qual->type = BATCH_CMP_INT8;
+		qual->constval = Int64GetDatum((int64) DatumGetInt32(cst->constvalue));
+	}
+	else
+	{
+		Assert(vartype == BATCH_CMP_INT4 && consttype == BATCH_CMP_INT8);
+		qual->type = BATCH_CMP_INT4_INT8;
+		qual->constval = cst->constvalue;
+	}
+
+	/*
+	 * int8 and float8 constants are pass-by-reference on some platforms; the
+	 * kernels fetch them once per batch, so that is fine.
+	 */
+	*attnum = var->varattno;
+	return true;
+}
+
+/*
+ * ExecInitBatchScan
+ *		Set up batch-at-a-time fetching from a SeqScan node.
+ *
+ * "attnums" lists the scan attributes the consumer wants to see in each
+ * batch, in addition to whatever the node's quals need.  Returns NULL if the
+ * node or its quals can't be executed in batch mode; the caller must then
+ * fetch tuples with ExecProcNode as usual.
+ */
+BatchScanState *
+ExecInitBatchScan(ScanState *node, Bitmapset *attnums)
+{
+	Plan	   *plan = node->ps.plan;
+	EState	   *estate = node->ps.state;
+	TupleDesc	tupdesc;
+	BatchScanState *bstate;
+	TupleBatch *batch;
+	Bitmapset  *allattnums;
+	AttrNumber *qualattnums;
+	ListCell   *lc;
+	int			nquals;
+	int			attnum;
+	int			col;
+	int			i;
+
+	if (!IsA(plan, SeqScan))
+		return NULL;
+
+	/* EvalPlanQual rechecks must go through ExecScanFetch */
+	if (estate->es_epqTuple != NULL)
+		return NULL;
+
+	/* Only forward scans; table_getnext is all we call */
+	if (!ScanDirectionIsForward(estate->es_direction))
+		return NULL;
+
+	tupdesc = RelationGetDescr(node->ss_currentRelation);
+
+	bstate = (BatchScanState *) palloc0(sizeof(BatchScanState));
+	bstate->scanstate = node;
+	nquals = list_length(plan->qual);
+	bstate->quals = (BatchQual *) palloc0(Max(nquals, 1) * sizeof(BatchQual));
+	qualattnums = (AttrNumber *) palloc0(Max(nquals, 1) * sizeof(AttrNumber));
+
+	allattnums = bms_copy(attnums);
+	i = 0;
+	foreach(lc, plan->qual)
+	{
+		if (!batch_qual_from_clause((Expr *) lfirst(lc), &bstate->quals[i],
+									&qualattnums[i]))
+			return NULL;
+		if (qualattnums[i] > tupdesc->natts ||
+			!tupdesc->attrs[qualattnums[i] - 1]->attbyval)
+			return NULL;
+		allattnums = bms_add_member(allattnums, qualattnums[i]);
+		i++;
+	}
+	bstate->nquals = nquals;
+
+	batch = &bstate->batch;
+	batch->ncols = bms_num_members(allattnums);
+	batch->attnums = (AttrNumber *) palloc(Max(batch->ncols, 1) * sizeof(AttrNumber));
+	batch->byval = (bool *) palloc(Max(batch->ncols, 1) * sizeof(bool));
+	batch->values = (Datum **) palloc(Max(batch->ncols, 1) * sizeof(Datum *));
+	batch->isnull = (bool **) palloc(Max(batch->ncols, 1) * sizeof(bool *));
+	batch->selection = (int *) palloc(EXEC_BATCH_SIZE * sizeof(int));
+	bstate->fillvalues = (Datum **) palloc(Max(batch->ncols, 1) * sizeof(Datum *));
+	bstate->fillisnull = (bool **) palloc(Max(batch->ncols, 1) * sizeof(bool *));
+
+	col = 0;
+	attnum = -1;
+	while ((attnum = bms_next_member(allattnums, attnum)) >= 0)
+	{
+		if (attnum <= 0 || attnum > tupdesc->natts)
+			return NULL;
+		batch->attnums[col] = (AttrNumber) attnum;
+		batch->byval[col] = tupdesc->attrs[attnum - 1]->attbyval;
+		batch->values[col] = (Datum *) palloc(EXEC_BATCH_SIZE * sizeof(Datum));
+		batch->isnull[col] = (bool *) palloc(EXEC_BATCH_SIZE * sizeof(bool));
+		bstate->maxattno = (AttrNumber) attnum;
+		col++;
+	}
+
+	for (i = 0; i < nquals; i++)
+		bstate->quals[i].col = ExecBatchScanColumn(bstate, qualattnums[i]);
+
+	pfree(qualattnums);
+	bms_free(allattnums);
+
+	return bstate;
+}
+
+/*
+ * ExecEndBatchScan
+ *		Release batch scan state.  The underlying scan node is shut down
+ *		separately by ExecEndNode.
+ */
+void
+ExecEndBatchScan(BatchScanState *bstate)
+{
+	TupleBatch *batch = &bstate->batch;
+	int			col;
+
+	for (col = 0; col < batch->ncols; col++)
+	{
+		pfree(batch->values[col]);
+		pfree(batch->isnull[col]);
+	}
+	pfree(batch->attnums);
+	pfree(batch->byval);
+	pfree(batch->values);
+	pfree(batch->isnull);
+	pfree(batch->selection);
+	pfree(bstate->fillvalues);
+	pfree(bstate->fillisnull);
+	pfree(bstate->quals);
+	pfree(bstate);
+}
+
+/*
+ * ExecReScanBatchScan
+ *		Prepare to fetch batches again after the scan node was rescanned.
+ */
+void
+ExecReScanBatchScan(BatchScanState *bstate)
+{
+	bstate->done = false;
+}
+
+/*
+ * ExecBatchScanColumn
+ *		Return the batch column number holding scan attribute "attnum".
+ */
+int
+ExecBatchScanColumn(BatchScanState *bstate, AttrNumber attnum)
+{
+	TupleBatch *batch = &bstate->batch;
+	int			col;
+
+	for (col = 0; col < batch->ncols; col++)
+	{
+		if (batch->attnums[col] == attnum)
+			return col;
+	}
+	elog(ERROR, "attribute %d is not part of the batch", attnum);
+	return -1;					/* keep compiler quiet */
+}
+
+/*
+ * ExecSeqScanBatch
+ *		Fetch the next batch of qualifying tuples.
+ *
+ * Returns NULL once the scan is exhausted.  A returned batch always has at
+ * least one selected row.  The batch's contents are only valid until the
+ * next call.
+ */
+TupleBatch *
+ExecSeqScanBatch(BatchScanState *bstate)
+{
+	ScanState  *node = bstate->scanstate;
+	HeapScanDesc scandesc = node->ss_currentScanDesc;
+	TupleTableSlot *slot = node->ss_ScanTupleSlot;
+	TupleBatch *batch = &bstate->batch;
+	int			ncols = batch->ncols;
+	bool		getbatch = table_scan_has_getbatch(scandesc);
+	int			i;
+
+	if (bstate->done)
+		return NULL;
+
+	if (node->ps.instrument)
+		InstrStartNode(node->ps.instrument);
+
+	for (;;)
+	{
+		int			ntuples = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/*
+		 * Access methods that store tuples column by column can hand us the
+		 * columns directly, without forming and deforming tuples.
+		 */
+		while (getbatch && ntuples < EXEC_BATCH_SIZE)
+		{
+			int			col;
+			int			n;
+
+			for (col = 0; col < ncols; col++)
+			{
+				bstate->fillvalues[col] = batch->values[col] + ntuples;
+				bstate->fillisnull[col] = batch->isnull[col] + ntuples;
+			}
+			n = table_scan_getbatch(scandesc, ncols, batch->attnums,
+									bstate->fillvalues, bstate->fillisnull,
+									EXEC_BATCH_SIZE - ntuples);
+			if (n == 0)
+			{
+				bstate->done = true;
+				break;
+			}
+			/* the AM's pass-by-reference values don't outlive the call */
+			for (col = 0; col < ncols; col++)
+			{
+				if (!batch->byval[col])
+					memset(bstate->fillvalues[col], 0, n * sizeof(Datum));
+			}
+			ntuples += n;
+		}
+
+		while (!getbatch && ntuples < EXEC_BATCH_SIZE)
+		{
+			HeapTuple	tuple;
+			int			col;
+
+			tuple = table_getnext(scandesc, ForwardScanDirection);
+			if (tuple == NULL)
+			{
+				bstate->done = true;
+				break;
+			}
+
+			ExecStoreTuple(tuple, slot, scandesc->rs_cbuf, false);
+			slot_getsomeattrs(slot, bstate->maxattno);
+
+			for (col = 0; col < ncols; col++)
+			{
+				int			attoff = batch->attnums[col] - 1;
+
+				batch->isnull[col][ntuples] = slot->tts_isnull[attoff];
+				if (batch->byval[col])
+					batch->values[col][ntuples] = slot->tts_values[attoff];
+				else
+					batch->values[col][ntuples] = (Datum) 0;
+			}
+			ntuples++;
+		}
+
+		/* drop the slot's buffer pin; the heap scan keeps its own */
+		ExecClearTuple(slot);
+
+		batch->ntuples = ntuples;
+		for (i = 0; i < ntuples; i++)
+			batch->selection[i] = i;
+		batch->nselected = ntuples;
+
+		for (i = 0; i < bstate->nquals && batch->nselected > 0; i++)
+			batch_apply_qual(&bstate->quals[i], batch);
+
+		if (batch->nselected > 0 || bstate->done)
+			break;
+	}
+
+	if (node->ps.instrument)
+		InstrStopNode(node->ps.instrument, (double) batch->nselected);
+
+	if (batch->nselected == 0)
+		return NULL;
+
+	return batch;
+}
+
+/*
+ * Filter loop shared by all qual kernels.  The selection vector is
+ * compacted in place: we never write ahead of the position we read.
+ * NULL inputs never qualify, as the comparison functions are strict.
+ */
+#define BATCH_FILTER(ctype, getcol, cval, test) \
+	do { \
+		for (i = 0; i < nin; i++) \
+		{ \
+			int			row = sel[i]; \
+			ctype		v; \
+			\
+			if (nulls[row]) \
+				continue; \
+			v = getcol(vals[row]); \
+			if (test) \
+				sel[nout++] = row; \
+		} \
+	} while (0)
+
+#define BATCH_FILTER_OPS(ctype, getcol, cval, cmp) \
+	do { \
+		switch (qual->op) \
+		{ \
+			case BATCH_OP_EQ: \
+				BATCH_FILTER(ctype, getcol, cval, cmp(v, cval) == 0); \
+				break; \
+			case BATCH_OP_NE: \
+				BATCH_FILTER(ctype, getcol, cval, cmp(v, cval) != 0); \
+				break; \
+			case BATCH_OP_LT: \
+				BATCH_FILTER(ctype, getcol, cval, cmp(v, cval) < 0); \
+				break; \
+			case BATCH_OP_LE: \
+				BATCH_FILTER(ctype, getcol, cval, cmp(v, cval) <= 0); \
+				break; \
+			case BATCH_OP_GT: \
+				BATCH_FILTER(ctype, getcol, cval, cmp(v, cval) > 0); \
+				break; \
+			case BATCH_OP_GE: \
+				BATCH_FILTER(ctype, getcol, cval, cmp(v, cval) >= 0); \
+				break; \
+		} \
+	} while (0)
+
+#define BATCH_INT_CMP(a, b)		((a) < (b) ? -1 : ((a) > (b) ? 1 : 0))
+#define BATCH_GETINT4_AS_INT8(d)	((int64) DatumGetInt32(d))
+
+/*
+ * batch_apply_qual
+ *		Narrow batch->selection to the rows satisfying one qual clause.
+ */
+static void
+batch_apply_qual(BatchQual *qual, TupleBatch *batch)
+{
+	Datum	   *vals = batch->values[qual->col];
+	bool	   *nulls = batch->isnull[qual->col];
+	int		   *sel = batch->selection;
+	int			nin = batch->nselected;
+	int			nout = 0;
+	int			i;
+
+	switch (qual->type)
+	{
+		case BATCH_CMP_INT4:
+			{
+				int32		c4 = DatumGetInt32(qual->constval);
+
+				BATCH_FILTER_OPS(int32, DatumGetInt32, c4, BATCH_INT_CMP);
+			}
+			break;
+		case BATCH_CMP_INT8:
+			{
+				int64		c8 = DatumGetInt64(qual->constval);
+
+				BATCH_FILTER_OPS(int64, DatumGetInt64, c8, BATCH_INT_CMP);
+			}
+			break;
+		case BATCH_CMP_INT4_INT8:
+			{
+				int64		c8 = DatumGetInt64(qual->constval);
+
+				BATCH_FILTER_OPS(int64, BATCH_GETINT4_AS_INT8, c8,
+								 BATCH_INT_CMP);
+			}
+			break;
+		case BATCH_CMP_FLOAT8:
+			{
+				float8		cf = DatumGetFloat8(qual->constval);
+
+				BATCH_FILTER_OPS(float8, DatumGetFloat8, cf,
+								 batch_float8_cmp);
+			}
+			break;
+	}
+
+	batch->nselected = nout;
+}
+
+
+/*
+ * ExecBatchAggKind
+ *		Identify the vectorized kernel for an aggregate transition function.
+ *
+ * inputByVal is whether the aggregated column is pass-by-value, and
+ * transtypeByVal whether the transition type is.  Returns BATCH_AGG_NONE if
+ * there is no suitable kernel.
+ */
+BatchAggKind
+ExecBatchAggKind(Oid transfn_oid, bool inputByVal, bool transtypeByVal)
+{
+	BatchAggKind kind;
+
+	switch (transfn_oid)
+	{
+		case F_INT8INC:
+			kind = BATCH_AGG_COUNT_STAR;
+			break;
+		case F_INT8INC_ANY:
+			/* only null flags are examined, so any input type will do */
+			return transtypeByVal ? BATCH_AGG_COUNT : BATCH_AGG_NONE;
+		case F_INT4_SUM:
+			kind = BATCH_AGG_INT4_SUM;
+			break;
+		case F_FLOAT8PL:
+			kind = BATCH_AGG_FLOAT8_SUM;
+			break;
+		case F_INT4LARGER:
+		case F_DATE_LARGER:
+			kind = BATCH_AGG_INT4_MAX;
+			break;
+		case F_INT4SMALLER:
+		case F_DATE_SMALLER:
+			kind = BATCH_AGG_INT4_MIN;
+			break;
+		case F_INT8LARGER:
+			kind = BATCH_AGG_INT8_MAX;
+			break;
+		case F_INT8SMALLER:
+			kind = BATCH_AGG_INT8_MIN;
+			break;
+		case F_FLOAT8LARGER:
+			kind = BATCH_AGG_FLOAT8_MAX;
+			break;
+		case F_FLOAT8SMALLER:
+			kind = BATCH_AGG_FLOAT8_MIN;
+			break;
+		case F_INT4_AVG_ACCUM:
+			/* transition value is an int8[] array, updated in place */
+			return inputByVal ? BATCH_AGG_INT4_AVG : BATCH_AGG_NONE;
+		case F_FLOAT8_ACCUM:
+			/* transition value is a float8[] array, updated in place */
+			return inputByVal ? BATCH_AGG_FLOAT8_AVG : BATCH_AGG_NONE;
+		default:
+			return BATCH_AGG_NONE;
+	}
+
+	/* the remaining kernels keep their running value directly in a Datum */
+	if (!transtypeByVal)
+		return BATCH_AGG_NONE;
+	if (kind != BATCH_AGG_COUNT_STAR && !inputByVal)
+		return BATCH_AGG_NONE;
+	return kind;
+}
+
+/*
+ * The strict min/max/sum kernels adopt the first non-null input as the
+ * transition value, exactly as advance_transition_function() does when the
+ * aggregate has no initial value.  If a strict transfn ever produced NULL
+ * the value stays NULL; none of our kernels do that, but be consistent.
+ */
+#define BATCH_AGG_STRICT_LOOP(ctype, getval, makedatum, step) \
+	do { \
+		ctype		acc = 0; \
+		bool		have = false; \
+		\
+		if (!*noTransValue) \
+		{ \
+			if (*transValueIsNull) \
+				return; \
+			acc = getval(*transValue); \
+			have = true; \
+		} \
+		for (i = 0; i < nsel; i++) \
+		{ \
+			int			row = sel[i]; \
+			ctype		v; \
+			\
+			if (nulls[row]) \
+				continue; \
+			v = getval(vals[row]); \
+			if (!have) \
+			{ \
+				acc = v; \
+				have = true; \
+				continue; \
+			} \
+			step; \
+		} \
+		if (have) \
+		{ \
+			*transValue = makedatum(acc); \
+			*transValueIsNull = false; \
+			*noTransValue = false; \
+		} \
+	} while (0)
+
+/*
+ * ExecBatchAdvanceAggregate
+ *		Advance one aggregate's transition state over the selected rows of
+ *		a batch.
+ *
+ * col is the batch column holding the aggregate's argument (ignored for
+ * count(*)).  The transition state fields are those of the aggregate's
+ * AggStatePerGroup.  Pass-by-reference transition arrays (for avg) are
+ * updated in place, which is safe because nodeAgg.c owns them.
+ */
+void
+ExecBatchAdvanceAggregate(BatchAggKind kind, TupleBatch *batch, int col,
+						  Datum *transValue, bool *transValueIsNull,
+						  bool *noTransValue)
+{
+	int		   *sel = batch->selection;
+	int			nsel = batch->nselected;
+	Datum	   *vals = NULL;
+	bool	   *nulls = NULL;
+	int			i;
+
+	if (kind != BATCH_AGG_COUNT_STAR)
+	{
+		vals = batch->values[col];
+		nulls = batch->isnull[col];
+	}
+
+	switch (kind)
+	{
+		case BATCH_AGG_NONE:
+			elog(ERROR, "unsupported batch aggregate");
+			break;
+
+		case BATCH_AGG_COUNT_STAR:
+		case BATCH_AGG_COUNT:
+			{
+				int64		count = 0;
+				int64		oldcount;
+				int64		result;
+
+				if (*transValueIsNull)
+					return;
+				if (kind == BATCH_AGG_COUNT_STAR)
+					count = nsel;
+				else
+				{
+					for (i = 0; i < nsel; i++)
+						count += !nulls[sel[i]];
+				}
+				oldcount = DatumGetInt64(*transValue);
+				result = oldcount + count;
+				/* Overflow check, as in int8inc */
+				if (result < oldcount)
+					ereport(ERROR,
+							(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+							 errmsg("bigint out of range")));
+				*transValue = Int64GetDatum(result);
+			}
+			break;
+
+		case BATCH_AGG_INT4_SUM:
+			{
+				/* int4_sum is not strict: a NULL state means no input yet */
+				int64		sum = 0;
+				bool		have = !*transValueIsNull;
+
+				if (have)
+					sum = DatumGetInt64(*transValue);
+				for (i = 0; i < nsel; i++)
+				{
+					int			row = sel[i];
+
+					if (nulls[row])
+						continue;
+					sum += (int64) DatumGetInt32(vals[row]);
+					have = true;
+				}
+				if (have)
+				{
+					*transValue = Int64GetDatum(sum);
+					*transValueIsNull = false;
+				}
+			}
+			break;
+
+		case BATCH_AGG_FLOAT8_SUM:
+			BATCH_AGG_STRICT_LOOP(float8, DatumGetFloat8, Float8GetDatum,
+								  acc = batch_float8_add(acc, v));
+			break;
+
+		case BATCH_AGG_INT4_MAX:
+			BATCH_AGG_STRICT_LOOP(int32, DatumGetInt32, Int32GetDatum,
+								  if (v > acc) acc = v);
+			break;
+		case BATCH_AGG_INT4_MIN:
+			BATCH_AGG_STRICT_LOOP(int32, DatumGetInt32, Int32GetDatum,
+								  if (v < acc) acc = v);
+			break;
+		case BATCH_AGG_INT8_MAX:
+			BATCH_AGG_STRICT_LOOP(int64, DatumGetInt64, Int64GetDatum,
+								  if (v > acc) acc = v);
+			break;
+		case BATCH_AGG_INT8_MIN:
+			BATCH_AGG_STRICT_LOOP(int64, DatumGetInt64, Int64GetDatum,
+								  if (v < acc) acc = v);
+			break;
+		case BATCH_AGG_FLOAT8_MAX:
+			BATCH_AGG_STRICT_LOOP(float8, DatumGetFloat8, Float8GetDatum,
+								if (batch_float8_cmp(v, acc) > 0) acc = v);
+			break;
+		case BATCH_AGG_FLOAT8_MIN:
+			BATCH_AGG_STRICT_LOOP(float8, DatumGetFloat8, Float8GetDatum,
+								if (batch_float8_cmp(v, acc) < 0) acc = v);
+			break;
+
+		case BATCH_AGG_INT4_AVG:
+			{
+				ArrayType  *transarray;
+				Int8TransTypeData *transdata;
+
+				if (*transValueIsNull)
+					return;
+				transarray = (ArrayType *) DatumGetPointer(*transValue);
+				if (ARR_HASNULL(transarray) ||
+					ARR_SIZE(transarray) != ARR_OVERHEAD_NONULLS(1) + sizeof(Int8TransTypeData))
+					elog(ERROR, "expected 2-element int8 array");
+				transdata = (Int8TransTypeData *) ARR_DATA_PTR(transarray);
+				for (i = 0; i < nsel; i++)
+				{
+					int			row = sel[i];
+
+					if (nulls[row])
+						continue;
+					transdata->count++;
+					transdata->sum += DatumGetInt32(vals[row]);
+				}
+			}
+			break;
+
+		case BATCH_AGG_FLOAT8_AVG:
+			{
+				ArrayType  *transarray;
+				float8	   *transvalues;
+				float8		N,
+							sumX,
+							sumX2;
+
+				if (*transValueIsNull)
+					return;
+				transarray = (ArrayType *) DatumGetPointer(*transValue);
+				if (ARR_NDIM(transarray) != 1 ||
+					ARR_DIMS(transarray)[0] != 3 ||
+					ARR_HASNULL(transarray) ||
+					ARR_ELEMTYPE(transarray) != FLOAT8OID)
+					elog(ERROR, "float8_accum: expected 3-element float8 array");
+				transvalues = (float8 *) ARR_DATA_PTR(transarray);
+				N = transvalues[0];
+				sumX = transvalues[1];
+				sumX2 = transvalues[2];
+				for (i = 0; i < nsel; i++)
+				{
+					int			row = sel[i];
+					float8		newval;
+					float8		oldsumX = sumX;
+					float8		oldsumX2 = sumX2;
+
+					if (nulls[row])
+						continue;
+					newval = DatumGetFloat8(vals[row]);
+					N += 1.0;
+					sumX += newval;
+					if (isinf(sumX) && !(isinf(oldsumX) || isinf(newval)))
+						ereport(ERROR,
+								(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+								 errmsg("value out of range: overflow")));
+					sumX2 += newval * newval;
+					if (isinf(sumX2) && !(isinf(oldsumX2) || isinf(newval)))
+						ereport(ERROR,
+								(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+								 errmsg("value out of range: overflow")));
+				}
+				transvalues[0] = N;
+				transvalues[1] = sumX;
+				transvalues[2] = sumX2;
+			}
+			break;
+	}
+}
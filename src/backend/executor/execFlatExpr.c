@@ -0,0 +1,1144 @@
+/*-------------------------------------------------------------------------
+ *
+ * execFlatExpr.c
+ *	  Flattened, opcode-based evaluation of expression state trees.
+ *
+ * ExecInitExpr builds a tree of ExprState nodes that is evaluated by
+ * recursing through each node's evalfunc.  For the expressions evaluated
+ * once per row by plan nodes -- quals, join quals and targetlist entries --
+ * that recursion, with its indirect call, isDone bookkeeping and repeated
+ * slot_getattr calls per node, is a measurable part of the per-row cost.
+ *
+ * The routines here replace the root of such a tree with a FlatExprState
+ * whose evaluation walks a linear array of FlatExprStep's instead.  Var,
+ * Const, FuncExpr, OpExpr, BoolExpr and scalar NullTest nodes get steps of
+ * their own; any other node becomes a FEOP_SUBTREE step that runs the
+ * ordinary recursive evaluator on that subtree, so every expression that
+ * reaches us can be flattened at least partially.  Function arguments are
+ * evaluated directly into the function's pre-initialized FunctionCallInfo,
+ * and the tuple deforming for all the Vars read from one slot is done by a
+ * single FEOP_*_FETCHSOME step at the start of the program.
+ *
+ * The steps are built on the first evaluation rather than at executor
+ * startup, for two reasons: expressions that are never evaluated (EXPLAIN
+ * without ANALYZE, for instance) cost nothing, and the permission checks
+ * on called functions happen at the same time they always did.  The same
+ * first time through we check Vars against the slot's tuple descriptor,
+ * exactly as ExecEvalScalarVar does.
+ *
+ * When the compiler supports it, the interpreter uses "computed goto"
+ * direct threading: once built, each step's opcode is replaced by the
+ * address of the code that implements it.
+ *
+ * The commonest builtin comparison and arithmetic operators on int4, int8
+ * and float8 are evaluated inline by steps of their own rather than through
+ * fmgr; see flat_inline_funcs[].  Everything they do must match the
+ * function they stand in for, including the overflow errors.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execFlatExpr.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/objectaccess.h"
+#include "executor/execFlatExpr.h"
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "pgstat.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+
+
+/* GUC parameter */
+bool		enable_flat_expressions = true;
+
+#if defined(__GNUC__)
+#define FLAT_USE_COMPUTED_GOTO
+#endif
+
+#define SAMESIGN(a,b)	(((a) < 0) == ((b) < 0))
+
+/*
+ * Builtin functions evaluated inline.  All are strict two-argument
+ * functions that never return NULL for non-NULL input.
+ */
+static const struct
+{
+	Oid			funcid;
+	FlatExprOp	opcode;
+	FlatCompareOp cmpop;
+}	flat_inline_funcs[] =
+{
+	{F_INT4EQ, FEOP_INT4_CMP, FLAT_CMP_EQ},
+	{F_INT4NE, FEOP_INT4_CMP, FLAT_CMP_NE},
+	{F_INT4LT, FEOP_INT4_CMP, FLAT_CMP_LT},
+	{F_INT4LE, FEOP_INT4_CMP, FLAT_CMP_LE},
+	{F_INT4GT, FEOP_INT4_CMP, FLAT_CMP_GT},
+	{F_INT4GE, FEOP_INT4_CMP, FLAT_CMP_GE},
+	{F_INT8EQ, FEOP_INT8_CMP, FLAT_CMP_EQ},
+	{F_INT8NE, FEOP_INT8_CMP, FLAT_CMP_NE},
+	{F_INT8LT, FEOP_INT8_CMP, FLAT_CMP_LT},
+	{F_INT8LE, FEOP_INT8_CMP, FLAT_CMP_LE},
+	{F_INT8GT, FEOP_INT8_CMP, FLAT_CMP_GT},
+	{F_INT8GE, FEOP_INT8_CMP, FLAT_CMP_GE},
+	{F_FLOAT8EQ, FEOP_FLOAT8_CMP, FLAT_CMP_EQ},
+	{F_FLOAT8NE, FEOP_FLOAT8_CMP, FLAT_CMP_NE},
+	{F_FLOAT8LT, FEOP_FLOAT8_CMP, FLAT_CMP_LT},
+	{F_FLOAT8LE, FEOP_FLOAT8_CMP, FLAT_CMP_LE},
+	{F_FLOAT8GT, FEOP_FLOAT8_CMP, FLAT_CMP_GT},
+	{F_FLOAT8GE, FEOP_FLOAT8_CMP, FLAT_CMP_GE},
+	{F_INT4PL, FEOP_INT4_PL, FLAT_CMP_EQ},
+	{F_INT4MI, FEOP_INT4_MI, FLAT_CMP_EQ},
+	{F_INT8PL, FEOP_INT8_PL, FLAT_CMP_EQ},
+	{F_INT8MI, FEOP_INT8_MI, FLAT_CMP_EQ}
+};
+
+/* Working state while building the steps of one FlatExprState */
+typedef struct FlatBuildState
+{
+	FlatExprState *fstate;
+	ExprContext *econtext;		/* supplies slots to check Vars against */
+	FlatExprStep *steps;
+	int			nsteps;
+	int			maxsteps;
+	int			last_inner;		/* highest attno read by a FEOP_INNER_VAR */
+	int			last_outer;
+	int			last_scan;
+} FlatBuildState;
+
+static Datum ExecEvalFlatExprFirst(FlatExprState *fstate,
+					  ExprContext *econtext,
+					  bool *isNull, ExprDoneCond *isDone);
+static Datum ExecEvalFlatExpr(FlatExprState *fstate, ExprContext *econtext,
+				 bool *isNull, ExprDoneCond *isDone);
+static Datum ExecInterpFlatExpr(FlatExprState *fstate, ExprContext *econtext,
+				   bool *isNull);
+static bool flat_expr_root_ok(ExprState *state);
+static void flat_build_steps(FlatExprState *fstate, ExprContext *econtext);
+static int flat_push_step(FlatBuildState *bs, FlatExprOp opcode,
+			   Datum *resvalue, bool *resnull);
+static void flat_build_node(FlatBuildState *bs, ExprState *state,
+				Datum *resvalue, bool *resnull);
+static bool flat_build_var(FlatBuildState *bs, Var *variable,
+			   Datum *resvalue, bool *resnull);
+static bool flat_build_func(FlatBuildState *bs, FuncExprState *fcache,
+				Oid funcid, Oid inputcollid,
+				Datum *resvalue, bool *resnull);
+static bool flat_build_bool(FlatBuildState *bs, BoolExprState *bstate,
+				Datum *resvalue, bool *resnull);
+
+
+/*
+ * ExecFlattenExpr
+ *
+ * Return a FlatExprState standing in for the given ExprState tree, or the
+ * tree itself if flattening would not help.  The tree must not be able to
+ * return a set, since the flat evaluator always produces a single result.
+ */
+ExprState *
+ExecFlattenExpr(ExprState *state)
+{
+	FlatExprState *fstate;
+
+	if (!enable_flat_expressions || state == NULL)
+		return state;
+	if (!flat_expr_root_ok(state))
+		return state;
+
+	fstate = makeNode(FlatExprState);
+	fstate->xprstate.evalfunc = (ExprStateEvalFunc) ExecEvalFlatExprFirst;
+	fstate->xprstate.expr = state->expr;
+	fstate->tree = state;
+	fstate->cxt = CurrentMemoryContext;
+	fstate->nsteps = 0;
+	fstate->steps = NULL;
+
+	return (ExprState *) fstate;
+}
+
+/*
+ * ExecFlattenPlanExprs
+ *
+ * Flatten the per-row expressions of a freshly initialized plan node: its
+ * qual, its targetlist entries and, for joins, the join qual.  The lists are
+ * updated in place, so a ProjectionInfo already built over the targetlist
+ * sees the flattened entries too.
+ */
+void
+ExecFlattenPlanExprs(PlanState *planstate)
+{
+	ListCell   *l;
+
+	if (!enable_flat_expressions)
+		return;
+
+	foreach(l, planstate->qual)
+		lfirst(l) = ExecFlattenExpr((ExprState *) lfirst(l));
+
+	foreach(l, planstate->targetlist)
+	{
+		GenericExprState *gstate = (GenericExprState *) lfirst(l);
+
+		if (IsA(gstate, GenericExprState))
+			gstate->arg = ExecFlattenExpr(gstate->arg);
+	}
+
+	switch (nodeTag(planstate))
+	{
+		case T_NestLoopState:
+		case T_MergeJoinState:
+		case T_HashJoinState:
+			foreach(l, ((JoinState *) planstate)->joinqual)
+				lfirst(l) = ExecFlattenExpr((ExprState *) lfirst(l));
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Is this a tree whose root is worth flattening?  Lone Vars and Consts
+ * already have fast evalfuncs (and ExecBuildProjectionInfo looks for
+ * simple Vars), and node types with no step of their own would just end up
+ * as one FEOP_SUBTREE step.
+ */
+static bool
+flat_expr_root_ok(ExprState *state)
+{
+	Expr	   *expr = state->expr;
+
+	if (expr == NULL)
+		return false;
+
+	switch (nodeTag(expr))
+	{
+		case T_FuncExpr:
+		case T_OpExpr:
+			if (!IsA(state, FuncExprState))
+				return false;
+			break;
+		case T_BoolExpr:
+			if (!IsA(state, BoolExprState))
+				return false;
+			break;
+		case T_NullTest:
+			if (!IsA(state, NullTestState) || ((NullTest *) expr)->argisrow)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	return !expression_returns_set((Node *) expr);
+}
+
+/*
+ * First evaluation: build the steps, then switch to the fast path.
+ */
+static Datum
+ExecEvalFlatExprFirst(FlatExprState *fstate, ExprContext *econtext,
+					  bool *isNull, ExprDoneCond *isDone)
+{
+	flat_build_steps(fstate, econtext);
+
+	fstate->xprstate.evalfunc = (ExprStateEvalFunc) ExecEvalFlatExpr;
+	return ExecEvalFlatExpr(fstate, econtext, isNull, isDone);
+}
+
+static Datum
+ExecEvalFlatExpr(FlatExprState *fstate, ExprContext *econtext,
+				 bool *isNull, ExprDoneCond *isDone)
+{
+	if (isDone)
+		*isDone = ExprSingleResult;
+
+	return ExecInterpFlatExpr(fstate, econtext, isNull);
+}
+
+/*
+ * Build the step array for fstate.
+ */
+static void
+flat_build_steps(FlatExprState *fstate, ExprContext *econtext)
+{
+	FlatBuildState bs;
+	MemoryContext oldcontext;
+	FlatExprStep fetch[3];
+	int			nfetch = 0;
+	int			i;
+
+	oldcontext = MemoryContextSwitchTo(fstate->cxt);
+
+	bs.fstate = fstate;
+	bs.econtext = econtext;
+	bs.maxsteps = 16;
+	bs.steps = (FlatExprStep *) palloc(bs.maxsteps * sizeof(FlatExprStep));
+	bs.nsteps = 0;
+	bs.last_inner = 0;
+	bs.last_outer = 0;
+	bs.last_scan = 0;
+
+	flat_build_node(&bs, fstate->tree, &fstate->resvalue, &fstate->resnull);
+	flat_push_step(&bs, FEOP_DONE, NULL, NULL);
+
+	/*
+	 * Now that we know which attributes are needed from each slot, put the
+	 * deforming steps in front and shift the jump targets to match.
+	 */
+	if (bs.last_inner > 0)
+	{
+		fetch[nfetch].opcode = FEOP_INNER_FETCHSOME;
+		fetch[nfetch++].d.fetch.last_var = bs.last_inner;
+	}
+	if (bs.last_outer > 0)
+	{
+		fetch[nfetch].opcode = FEOP_OUTER_FETCHSOME;
+		fetch[nfetch++].d.fetch.last_var = bs.last_outer;
+	}
+	if (bs.last_scan > 0)
+	{
+		fetch[nfetch].opcode = FEOP_SCAN_FETCHSOME;
+		fetch[nfetch++].d.fetch.last_var = bs.last_scan;
+	}
+
+	fstate->nsteps = bs.nsteps + nfetch;
+	fstate->steps = (FlatExprStep *)
+		palloc(fstate->nsteps * sizeof(FlatExprStep));
+	for (i = 0; i < nfetch; i++)
+	{
+		fetch[i].resvalue = NULL;
+		fetch[i].resnull = NULL;
+		fstate->steps[i] = fetch[i];
+	}
+	memcpy(fstate->steps + nfetch, bs.steps, bs.nsteps * sizeof(FlatExprStep));
+	pfree(bs.steps);
+
+	for (i = nfetch; i < fstate->nsteps; i++)
+	{
+		FlatExprStep *op = &fstate->steps[i];
+
+		switch ((FlatExprOp) op->opcode)
+		{
+			case FEOP_BOOL_AND_STEP_FIRST:
+			case FEOP_BOOL_AND_STEP:
+			case FEOP_BOOL_AND_STEP_LAST:
+			case FEOP_BOOL_OR_STEP_FIRST:
+			case FEOP_BOOL_OR_STEP:
+			case FEOP_BOOL_OR_STEP_LAST:
+				op->d.boolexpr.jumpdone += nfetch;
+				break;
+			default:
+				break;
+		}
+	}
+
+#ifdef FLAT_USE_COMPUTED_GOTO
+	{
+		const void *const *dispatch_table;
+
+		dispatch_table = (const void *const *)
+			DatumGetPointer(ExecInterpFlatExpr(NULL, NULL, NULL));
+		for (i = 0; i < fstate->nsteps; i++)
+			fstate->steps[i].opcode =
+				(intptr_t) dispatch_table[fstate->steps[i].opcode];
+	}
+#endif
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Append a step and return its index.  Callers must not hold pointers into
+ * bs->steps across this call, since the array may move.
+ */
+static int
+flat_push_step(FlatBuildState *bs, FlatExprOp opcode,
+			   Datum *resvalue, bool *resnull)
+{
+	FlatExprStep *op;
+
+	if (bs->nsteps >= bs->maxsteps)
+	{
+		bs->maxsteps *= 2;
+		bs->steps = (FlatExprStep *)
+			repalloc(bs->steps, bs->maxsteps * sizeof(FlatExprStep));
+	}
+
+	op = &bs->steps[bs->nsteps];
+	MemSet(op, 0, sizeof(FlatExprStep));
+	op->opcode = opcode;
+	op->resvalue = resvalue;
+	op->resnull = resnull;
+
+	return bs->nsteps++;
+}
+
+/*
+ * Emit the steps that compute "state" into the given result location.
+ */
+static void
+flat_build_node(FlatBuildState *bs, ExprState *state,
+				Datum *resvalue, bool *resnull)
+{
+	Expr	   *expr = state->expr;
+	int			stepno;
+
+	check_stack_depth();
+
+	switch (nodeTag(expr))
+	{
+		case T_Var:
+			if (flat_build_var(bs, (Var *) expr, resvalue, resnull))
+				return;
+			break;
+
+		case T_Const:
+			{
+				Const	   *con = (Const *) expr;
+
+				stepno = flat_push_step(bs, FEOP_CONST, resvalue, resnull);
+				bs->steps[stepno].d.constval.value = con->constvalue;
+				bs->steps[stepno].d.constval.isnull = con->constisnull;
+				return;
+			}
+
+		case T_FuncExpr:
+			if (IsA(state, FuncExprState))
+			{
+				FuncExpr   *func = (FuncExpr *) expr;
+
+				if (flat_build_func(bs, (FuncExprState *) state,
+									func->funcid, func->inputcollid,
+									resvalue, resnull))
+					return;
+			}
+			break;
+
+		case T_OpExpr:
+			if (IsA(state, FuncExprState))
+			{
+				OpExpr	   *op = (OpExpr *) expr;
+
+				if (flat_build_func(bs, (FuncExprState *) state,
+									op->opfuncid, op->inputcollid,
+									resvalue, resnull))
+					return;
+			}
+			break;
+
+		case T_BoolExpr:
+			if (IsA(state, BoolExprState) &&
+				flat_build_bool(bs, (BoolExprState *) state,
+								resvalue, resnull))
+				return;
+			break;
+
+		case T_NullTest:
+			if (IsA(state, NullTestState) && !((NullTest *) expr)->argisrow)
+			{
+				NullTestState *nstate = (NullTestState *) state;
+				FlatExprOp	opcode;
+
+				if (((NullTest *) expr)->nulltesttype == IS_NULL)
+					opcode = FEOP_NULLTEST_ISNULL;
+				else
+					opcode = FEOP_NULLTEST_ISNOTNULL;
+
+				flat_build_node(bs, nstate->arg, resvalue, resnull);
+				flat_push_step(bs, opcode, resvalue, resnull);
+				return;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	/* No step of its own; have the recursive evaluator do this subtree */
+	stepno = flat_push_step(bs, FEOP_SUBTREE, resvalue, resnull);
+	bs->steps[stepno].d.subtree.state = state;
+}
+
+/*
+ * Emit a step fetching a user attribute.  Returns false, leaving the Var to
+ * FEOP_SUBTREE, for system attributes, whole-row references and slots we
+ * can't see yet.
+ */
+static bool
+flat_build_var(FlatBuildState *bs, Var *variable,
+			   Datum *resvalue, bool *resnull)
+{
+	TupleTableSlot *slot;
+	FlatExprOp	opcode;
+	AttrNumber	attnum = variable->varattno;
+	int			stepno;
+
+	if (attnum <= 0)
+		return false;
+
+	switch (variable->varno)
+	{
+		case INNER_VAR:
+			slot = bs->econtext->ecxt_innertuple;
+			opcode = FEOP_INNER_VAR;
+			break;
+		case OUTER_VAR:
+			slot = bs->econtext->ecxt_outertuple;
+			opcode = FEOP_OUTER_VAR;
+			break;
+		default:
+			slot = bs->econtext->ecxt_scantuple;
+			opcode = FEOP_SCAN_VAR;
+			break;
+	}
+
+	if (slot == NULL)
+		return false;
+
+	/* same defenses as ExecEvalScalarVar */
+	{
+		TupleDesc	slot_tupdesc = slot->tts_tupleDescriptor;
+		Form_pg_attribute attr;
+
+		if (attnum > slot_tupdesc->natts)		/* should never happen */
+			elog(ERROR, "attribute number %d exceeds number of columns %d",
+				 attnum, slot_tupdesc->natts);
+
+		attr = slot_tupdesc->attrs[attnum - 1];
+
+		/* can't check type if dropped, since atttypid is probably 0 */
+		if (!attr->attisdropped)
+		{
+			if (variable->vartype != attr->atttypid)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATATYPE_MISMATCH),
+						 errmsg("attribute %d has wrong type", attnum),
+						 errdetail("Table has type %s, but query expects %s.",
+								   format_type_be(attr->atttypid),
+								   format_type_be(variable->vartype))));
+		}
+	}
+
+	switch (opcode)
+	{
+		case FEOP_INNER_VAR:
+			bs->last_inner = Max(bs->last_inner, attnum);
+			break;
+		case FEOP_OUTER_VAR:
+			bs->last_outer = Max(bs->last_outer, attnum);
+			break;
+		default:
+			bs->last_scan = Max(bs->last_scan, attnum);
+			break;
+	}
+
+	stepno = flat_push_step(bs, opcode, resvalue, resnull);
+	bs->steps[stepno].d.var.attnum = attnum - 1;
+
+	return true;
+}
+
+/*
+ * Emit the steps for a FuncExpr or OpExpr: each argument is computed into
+ * the function's own FunctionCallInfo, followed by the call itself.  This
+ * does the work init_fcache would otherwise do on the first call.
+ */
+static bool
+flat_build_func(FlatBuildState *bs, FuncExprState *fcache,
+				Oid funcid, Oid inputcollid,
+				Datum *resvalue, bool *resnull)
+{
+	FunctionCallInfo fcinfo = &fcache->fcinfo_data;
+	AclResult	aclresult;
+	ListCell   *arg;
+	FlatExprOp	opcode;
+	FlatCompareOp cmpop;
+	int			nargs = list_length(fcache->args);
+	int			stepno;
+	int			i;
+
+	/* let the ordinary code path report this */
+	if (nargs > FUNC_MAX_ARGS)
+		return false;
+
+	/* Check permission to call function */
+	aclresult = pg_proc_aclcheck(funcid, GetUserId(), ACL_EXECUTE);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, ACL_KIND_PROC, get_func_name(funcid));
+	InvokeFunctionExecuteHook(funcid);
+
+	fmgr_info_cxt(funcid, &(fcache->func), bs->fstate->cxt);
+	fmgr_info_set_expr((Node *) fcache->xprstate.expr, &(fcache->func));
+
+	/* we checked expression_returns_set already, but be safe */
+	if (fcache->func.fn_retset)
+		return false;
+
+	InitFunctionCallInfoData(*fcinfo, &(fcache->func), nargs,
+							 inputcollid, NULL, NULL);
+
+	i = 0;
+	foreach(arg, fcache->args)
+	{
+		flat_build_node(bs, (ExprState *) lfirst(arg),
+						&fcinfo->arg[i], &fcinfo->argnull[i]);
+		i++;
+	}
+
+	opcode = fcache->func.fn_strict ? FEOP_FUNCEXPR_STRICT : FEOP_FUNCEXPR;
+	cmpop = FLAT_CMP_EQ;
+	if (nargs == 2)
+	{
+		for (i = 0; i < lengthof(flat_inline_funcs); i++)
+		{
+			if (flat_inline_funcs[i].funcid == funcid)
+			{
+				opcode = flat_inline_funcs[i].opcode;
+				cmpop = flat_inline_funcs[i].cmpop;
+				break;
+			}
+		}
+	}
+
+	stepno = flat_push_step(bs, opcode, resvalue, resnull);
+	bs->steps[stepno].d.func.fcinfo = fcinfo;
+	bs->steps[stepno].d.func.nargs = nargs;
+	bs->steps[stepno].d.func.cmpop = cmpop;
+
+	return true;
+}
+
+/*
+ * Emit the steps for an AND, OR or NOT.  All arguments of an AND or OR are
+ * computed into the BoolExpr's own result location; the step following each
+ * one decides whether the result is already known, in which case it jumps
+ * past the remaining arguments.
+ */
+static bool
+flat_build_bool(FlatBuildState *bs, BoolExprState *bstate,
+				Datum *resvalue, bool *resnull)
+{
+	BoolExpr   *boolexpr = (BoolExpr *) bstate->xprstate.expr;
+	bool	   *anynull;
+	int		   *adjust;
+	int			nargs = list_length(bstate->args);
+	FlatExprOp	first;
+	FlatExprOp	middle;
+	FlatExprOp	last;
+	ListCell   *arg;
+	int			i;
+
+	switch (boolexpr->boolop)
+	{
+		case NOT_EXPR:
+			if (nargs != 1)
+				return false;
+			flat_build_node(bs, (ExprState *) linitial(bstate->args),
+							resvalue, resnull);
+			flat_push_step(bs, FEOP_BOOL_NOT_STEP, resvalue, resnull);
+			return true;
+		case AND_EXPR:
+			first = FEOP_BOOL_AND_STEP_FIRST;
+			middle = FEOP_BOOL_AND_STEP;
+			last = FEOP_BOOL_AND_STEP_LAST;
+			break;
+		case OR_EXPR:
+			first = FEOP_BOOL_OR_STEP_FIRST;
+			middle = FEOP_BOOL_OR_STEP;
+			last = FEOP_BOOL_OR_STEP_LAST;
+			break;
+		default:
+			return false;
+	}
+
+	/* the planner never makes these, and the step logic relies on it */
+	if (nargs < 2)
+		return false;
+
+	anynull = (bool *) palloc(sizeof(bool));
+	adjust = (int *) palloc(nargs * sizeof(int));
+
+	i = 0;
+	foreach(arg, bstate->args)
+	{
+		FlatExprOp	opcode;
+
+		flat_build_node(bs, (ExprState *) lfirst(arg), resvalue, resnull);
+
+		if (i == 0)
+			opcode = first;
+		else if (i == nargs - 1)
+			opcode = last;
+		else
+			opcode = middle;
+
+		adjust[i] = flat_push_step(bs, opcode, resvalue, resnull);
+		bs->steps[adjust[i]].d.boolexpr.anynull = anynull;
+		i++;
+	}
+
+	/* all the steps jump to whatever comes after the last argument */
+	for (i = 0; i < nargs; i++)
+		bs->steps[adjust[i]].d.boolexpr.jumpdone = bs->nsteps;
+	pfree(adjust);
+
+	return true;
+}
+
+/*
+ * Call the function of a FEOP_FUNCEXPR* step, its arguments being in place.
+ */
+static inline void
+flat_call_function(FlatExprStep *op)
+{
+	FunctionCallInfo fcinfo = op->d.func.fcinfo;
+	PgStat_FunctionCallUsage fcusage;
+
+	pgstat_init_function_usage(fcinfo, &fcusage);
+
+	fcinfo->isnull = false;
+	*op->resvalue = FunctionCallInvoke(fcinfo);
+	*op->resnull = fcinfo->isnull;
+
+	pgstat_end_function_usage(&fcusage, true);
+}
+
+/*
+ * Turn a three-way comparison result into the boolean asked for.
+ */
+static inline bool
+flat_compare_result(FlatCompareOp cmpop, int cmp)
+{
+	switch (cmpop)
+	{
+		case FLAT_CMP_EQ:
+			return cmp == 0;
+		case FLAT_CMP_NE:
+			return cmp != 0;
+		case FLAT_CMP_LT:
+			return cmp < 0;
+		case FLAT_CMP_LE:
+			return cmp <= 0;
+		case FLAT_CMP_GT:
+			return cmp > 0;
+		case FLAT_CMP_GE:
+			return cmp >= 0;
+	}
+	return false;				/* keep compiler quiet */
+}
+
+/*
+ * float8 comparison with NaN sorting above everything else, the same as
+ * float8_cmp_internal.
+ */
+static inline int
+flat_float8_cmp(float8 a, float8 b)
+{
+	if (isnan(a))
+		return isnan(b) ? 0 : 1;
+	if (isnan(b))
+		return -1;
+	if (a > b)
+		return 1;
+	if (a < b)
+		return -1;
+	return 0;
+}
+
+/*
+ * Common prologue of the inlined strict builtins: return NULL, and go on to
+ * the next step, if either argument is NULL.
+ */
+#define FEO_STRICT2_CHECK(fcinfo) \
+	do { \
+		if ((fcinfo)->argnull[0] || (fcinfo)->argnull[1]) \
+		{ \
+			*op->resvalue = (Datum) 0; \
+			*op->resnull = true; \
+			FEO_NEXT(); \
+		} \
+		*op->resnull = false; \
+	} while (0)
+
+#ifdef FLAT_USE_COMPUTED_GOTO
+#define FEO_SWITCH()		FEO_DISPATCH();
+#define FEO_CASE(name)		CASE_##name:
+#define FEO_DISPATCH()		goto *((void *) op->opcode)
+#else
+#define FEO_SWITCH()		starteval: switch ((FlatExprOp) op->opcode)
+#define FEO_CASE(name)		case name:
+#define FEO_DISPATCH()		goto starteval
+#endif
+
+#define FEO_NEXT() \
+	do { \
+		op++; \
+		FEO_DISPATCH(); \
+	} while (0)
+
+#define FEO_JUMP(stepno) \
+	do { \
+		op = &fstate->steps[stepno]; \
+		FEO_DISPATCH(); \
+	} while (0)
+
+/*
+ * The interpreter proper.
+ *
+ * Called with fstate == NULL, returns the dispatch table used to thread the
+ * steps (only when FLAT_USE_COMPUTED_GOTO).
+ */
+static Datum
+ExecInterpFlatExpr(FlatExprState *fstate, ExprContext *econtext,
+				   bool *isNull)
+{
+	FlatExprStep *op;
+	TupleTableSlot *innerslot;
+	TupleTableSlot *outerslot;
+	TupleTableSlot *scanslot;
+
+#ifdef FLAT_USE_COMPUTED_GOTO
+	/* must be kept in the order of enum FlatExprOp */
+	static const void *const dispatch_table[] = {
+		&&CASE_FEOP_DONE,
+		&&CASE_FEOP_INNER_FETCHSOME,
+		&&CASE_FEOP_OUTER_FETCHSOME,
+		&&CASE_FEOP_SCAN_FETCHSOME,
+		&&CASE_FEOP_INNER_VAR,
+		&&CASE_FEOP_OUTER_VAR,
+		&&CASE_FEOP_SCAN_VAR,
+		&&CASE_FEOP_CONST,
+		&&CASE_FEOP_FUNCEXPR,
+		&&CASE_FEOP_FUNCEXPR_STRICT,
+		&&CASE_FEOP_BOOL_AND_STEP_FIRST,
+		&&CASE_FEOP_BOOL_AND_STEP,
+		&&CASE_FEOP_BOOL_AND_STEP_LAST,
+		&&CASE_FEOP_BOOL_OR_STEP_FIRST,
+		&&CASE_FEOP_BOOL_OR_STEP,
+		&&CASE_FEOP_BOOL_OR_STEP_LAST,
+		&&CASE_FEOP_BOOL_NOT_STEP,
+		&&CASE_FEOP_NULLTEST_ISNULL,
+		&&CASE_FEOP_NULLTEST_ISNOTNULL,
+		&&CASE_FEOP_INT4_CMP,
+		&&CASE_FEOP_INT8_CMP,
+		&&CASE_FEOP_FLOAT8_CMP,
+		&&CASE_FEOP_INT4_PL,
+		&&CASE_FEOP_INT4_MI,
+		&&CASE_FEOP_INT8_PL,
+		&&CASE_FEOP_INT8_MI,
+		&&CASE_FEOP_SUBTREE
+	};
+
+	if (fstate == NULL)
+		return PointerGetDatum(dispatch_table);
+#endif
+
+	/* Guard against stack overflow, as ExecMakeFunctionResult does */
+	check_stack_depth();
+
+	op = fstate->steps;
+	innerslot = econtext->ecxt_innertuple;
+	outerslot = econtext->ecxt_outertuple;
+	scanslot = econtext->ecxt_scantuple;
+
+	FEO_SWITCH()
+	{
+		FEO_CASE(FEOP_DONE)
+		{
+			*isNull = fstate->resnull;
+			return fstate->resvalue;
+		}
+
+		FEO_CASE(FEOP_INNER_FETCHSOME)
+		{
+			if (innerslot->tts_nvalid < op->d.fetch.last_var)
+				slot_getsomeattrs(innerslot, op->d.fetch.last_var);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_OUTER_FETCHSOME)
+		{
+			if (outerslot->tts_nvalid < op->d.fetch.last_var)
+				slot_getsomeattrs(outerslot, op->d.fetch.last_var);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_SCAN_FETCHSOME)
+		{
+			if (scanslot->tts_nvalid < op->d.fetch.last_var)
+				slot_getsomeattrs(scanslot, op->d.fetch.last_var);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INNER_VAR)
+		{
+			*op->resvalue = innerslot->tts_values[op->d.var.attnum];
+			*op->resnull = innerslot->tts_isnull[op->d.var.attnum];
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_OUTER_VAR)
+		{
+			*op->resvalue = outerslot->tts_values[op->d.var.attnum];
+			*op->resnull = outerslot->tts_isnull[op->d.var.attnum];
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_SCAN_VAR)
+		{
+			*op->resvalue = scanslot->tts_values[op->d.var.attnum];
+			*op->resnull = scanslot->tts_isnull[op->d.var.attnum];
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_CONST)
+		{
+			*op->resvalue = op->d.constval.value;
+			*op->resnull = op->d.constval.isnull;
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_FUNCEXPR)
+		{
+			flat_call_function(op);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_FUNCEXPR_STRICT)
+		{
+			bool	   *argnull = op->d.func.fcinfo->argnull;
+			int			i;
+
+			for (i = 0; i < op->d.func.nargs; i++)
+			{
+				if (argnull[i])
+				{
+					*op->resvalue = (Datum) 0;
+					*op->resnull = true;
+					FEO_NEXT();
+				}
+			}
+			flat_call_function(op);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_BOOL_AND_STEP_FIRST)
+		{
+			*op->d.boolexpr.anynull = false;
+		}
+		/* FALL THRU */
+		FEO_CASE(FEOP_BOOL_AND_STEP)
+		{
+			if (*op->resnull)
+				*op->d.boolexpr.anynull = true;
+			else if (!DatumGetBool(*op->resvalue))
+			{
+				/* result is false, and already in place */
+				FEO_JUMP(op->d.boolexpr.jumpdone);
+			}
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_BOOL_AND_STEP_LAST)
+		{
+			/* a null or false last argument is itself the result */
+			if (!*op->resnull && DatumGetBool(*op->resvalue) &&
+				*op->d.boolexpr.anynull)
+			{
+				*op->resvalue = (Datum) 0;
+				*op->resnull = true;
+			}
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_BOOL_OR_STEP_FIRST)
+		{
+			*op->d.boolexpr.anynull = false;
+		}
+		/* FALL THRU */
+		FEO_CASE(FEOP_BOOL_OR_STEP)
+		{
+			if (*op->resnull)
+				*op->d.boolexpr.anynull = true;
+			else if (DatumGetBool(*op->resvalue))
+			{
+				/* result is true, and already in place */
+				FEO_JUMP(op->d.boolexpr.jumpdone);
+			}
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_BOOL_OR_STEP_LAST)
+		{
+			/* a null or true last argument is itself the result */
+			if (!*op->resnull && !DatumGetBool(*op->resvalue) &&
+				*op->d.boolexpr.anynull)
+			{
+				*op->resvalue = (Datum) 0;
+				*op->resnull = true;
+			}
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_BOOL_NOT_STEP)
+		{
+			if (!*op->resnull)
+				*op->resvalue = BoolGetDatum(!DatumGetBool(*op->resvalue));
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_NULLTEST_ISNULL)
+		{
+			*op->resvalue = BoolGetDatum(*op->resnull);
+			*op->resnull = false;
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_NULLTEST_ISNOTNULL)
+		{
+			*op->resvalue = BoolGetDatum(!*op->resnull);
+			*op->resnull = false;
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INT4_CMP)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int32		a;
+			int32		b;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			a = DatumGetInt32(fcinfo->arg[0]);
+			b = DatumGetInt32(fcinfo->arg[1]);
+			*op->resvalue = BoolGetDatum(flat_compare_result(op->d.func.cmpop,
+													  (a > b) - (a < b)));
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INT8_CMP)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int64		a;
+			int64		b;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			a = DatumGetInt64(fcinfo->arg[0]);
+			b = DatumGetInt64(fcinfo->arg[1]);
+			*op->resvalue = BoolGetDatum(flat_compare_result(op->d.func.cmpop,
+													  (a > b) - (a < b)));
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_FLOAT8_CMP)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			*op->resvalue = BoolGetDatum(flat_compare_result(op->d.func.cmpop,
+							   flat_float8_cmp(DatumGetFloat8(fcinfo->arg[0]),
+											 DatumGetFloat8(fcinfo->arg[1]))));
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INT4_PL)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int32		a;
+			int32		b;
+			int32		result;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			a = DatumGetInt32(fcinfo->arg[0]);
+			b = DatumGetInt32(fcinfo->arg[1]);
+			result = a + b;
+			if (SAMESIGN(a, b) && !SAMESIGN(result, a))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("integer out of range")));
+			*op->resvalue = Int32GetDatum(result);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INT4_MI)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int32		a;
+			int32		b;
+			int32		result;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			a = DatumGetInt32(fcinfo->arg[0]);
+			b = DatumGetInt32(fcinfo->arg[1]);
+			result = a - b;
+			if (!SAMESIGN(a, b) && !SAMESIGN(result, a))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("integer out of range")));
+			*op->resvalue = Int32GetDatum(result);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INT8_PL)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int64		a;
+			int64		b;
+			int64		result;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			a = DatumGetInt64(fcinfo->arg[0]);
+			b = DatumGetInt64(fcinfo->arg[1]);
+			result = a + b;
+			if (SAMESIGN(a, b) && !SAMESIGN(result, a))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("bigint out of range")));
+			*op->resvalue = Int64GetDatum(result);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_INT8_MI)
+		{
+			FunctionCallInfo fcinfo = op->d.func.fcinfo;
+			int64		a;
+			int64		b;
+			int64		result;
+
+			FEO_STRICT2_CHECK(fcinfo);
+			a = DatumGetInt64(fcinfo->arg[0]);
+			b = DatumGetInt64(fcinfo->arg[1]);
+			result = a - b;
+			if (!SAMESIGN(a, b) && !SAMESIGN(result, a))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("bigint out of range")));
+			*op->resvalue = Int64GetDatum(result);
+			FEO_NEXT();
+		}
+
+		FEO_CASE(FEOP_SUBTREE)
+		{
+			*op->resvalue = ExecEvalExpr(op->d.subtree.state, econtext,
+										 op->resnull, NULL);
+			FEO_NEXT();
+		}
+
+#ifndef FLAT_USE_COMPUTED_GOTO
+		case FEOP_LAST:
+			break;
+#endif
+	}
+
+	elog(ERROR, "unrecognized flat expression step");
+	return (Datum) 0;			/* keep compiler quiet */
+}
@@ -24,11 +24,30 @@
 #include "utils/memutils.h"
 
 
-static TupleHashTable CurTupleHashTable = NULL;
+static uint32 TupleHashTableHash(tuplehash_hash *tb, TupleHashEntry entry);
+static bool TupleHashTableMatch(tuplehash_hash *tb, TupleHashEntry entry1,
+					TupleHashEntry entry2);
+static TupleHashEntry TupleHashEntryAlloc(TupleHashTable hashtable);
 
-static uint32 TupleHashTableHash(const void *key, Size keysize);
-static int TupleHashTableMatch(const void *key1, const void *key2,
-					Size keysize);
+/*
+ * Define parameters for tuple hash table code generation. The interface is
+ * *also* declared in execnodes.h (to generate the types, which are externally
+ * visible).
+ */
+#define SH_PREFIX tuplehash
+#define SH_ELEMENT_TYPE TupleHashBucket
+#define SH_KEY_TYPE TupleHashEntry
+#define SH_KEY entry
+#define SH_HASH_KEY(tb, key) TupleHashTableHash(tb, key)
+#define SH_EQUAL(tb, a, b) TupleHashTableMatch(tb, a, b)
+#define SH_SCOPE extern
+#define SH_STORE_HASH
+#define SH_GET_HASH(tb, a) a->hash
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+/* number of entries allocated at once by TupleHashEntryAlloc */
+#define TUPLEHASH_ENTRY_BATCH	64
 
 
 /*****************************************************************************
@@ -279,7 +298,6 @@ BuildTupleHashTable(int numCols, AttrNumber *keyColIdx,
 					MemoryContext tablecxt, MemoryContext tempcxt)
 {
 	TupleHashTable hashtable;
-	HASHCTL		hash_ctl;
 
 	Assert(nbuckets > 0);
 	Assert(entrysize >= sizeof(TupleHashEntryData));
@@ -296,21 +314,17 @@ BuildTupleHashTable(int numCols, AttrNumber *keyColIdx,
 	hashtable->tab_eq_funcs = eqfunctions;
 	hashtable->tablecxt = tablecxt;
 	hashtable->tempcxt = tempcxt;
-	hashtable->entrysize = entrysize;
+	hashtable->entrysize = MAXALIGN(entrysize);
+	hashtable->entrybatch = NULL;
+	hashtable->nbatchfree = 0;
+	hashtable->freelist = NULL;
+	hashtable->removedentry = NULL;
 	hashtable->tableslot = NULL;	/* will be made on first lookup */
 	hashtable->inputslot = NULL;
 	hashtable->in_hash_funcs = NULL;
 	hashtable->cur_eq_funcs = NULL;
 
-	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(TupleHashEntryData);
-	hash_ctl.entrysize = entrysize;
-	hash_ctl.hash = TupleHashTableHash;
-	hash_ctl.match = TupleHashTableMatch;
-	hash_ctl.hcxt = tablecxt;
-	hashtable->hashtab = hash_create("TupleHashTable", nbuckets,
-									 &hash_ctl,
-					HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+	hashtable->hashtab = tuplehash_create(tablecxt, nbuckets, hashtable);
 
 	return hashtable;
 }
@@ -331,10 +345,9 @@ TupleHashEntry
 LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 					 bool *isnew)
 {
+	TupleHashBucket *bucket;
 	TupleHashEntry entry;
 	MemoryContext oldContext;
-	TupleHashTable saveCurHT;
-	TupleHashEntryData dummy;
 	bool		found;
 
 	/* If first time through, clone the input slot to make table slot */
@@ -356,42 +369,29 @@ LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 	/* Need to run the hash functions in short-lived context */
 	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
 
-	/*
-	 * Set up data needed by hash and match functions
-	 *
-	 * We save and restore CurTupleHashTable just in case someone manages to
-	 * invoke this code re-entrantly.
-	 */
+	/* Set up data needed by hash and match functions */
 	hashtable->inputslot = slot;
 	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
 	hashtable->cur_eq_funcs = hashtable->tab_eq_funcs;
 
-	saveCurHT = CurTupleHashTable;
-	CurTupleHashTable = hashtable;
-
-	/* Search the hash table */
-	dummy.firstTuple = NULL;	/* flag to reference inputslot */
-	entry = (TupleHashEntry) hash_search(hashtable->hashtab,
-										 &dummy,
-										 isnew ? HASH_ENTER : HASH_FIND,
-										 &found);
-
+	/* Search the hash table; a NULL key means "use the inputslot" */
 	if (isnew)
 	{
+		bucket = tuplehash_insert(hashtable->hashtab, NULL, &found);
+
 		if (found)
 		{
 			/* found pre-existing entry */
 			*isnew = false;
+			entry = bucket->entry;
 		}
 		else
 		{
-			/*
-			 * created new entry
-			 *
-			 * Zero any caller-requested space in the entry.  (This zaps the
-			 * "key data" dynahash.c copied into the new entry, but we don't
-			 * care since we're about to overwrite it anyway.)
-			 */
+			/* created new bucket; give it an entry */
+			entry = TupleHashEntryAlloc(hashtable);
+			bucket->entry = entry;
+
+			/* Zero any caller-requested space in the entry */
 			MemSet(entry, 0, hashtable->entrysize);
 
 			/* Copy the first tuple into the table context */
@@ -401,8 +401,11 @@ LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 			*isnew = true;
 		}
 	}
-
-	CurTupleHashTable = saveCurHT;
+	else
+	{
+		bucket = tuplehash_lookup(hashtable->hashtab, NULL);
+		entry = bucket ? bucket->entry : NULL;
+	}
 
 	MemoryContextSwitchTo(oldContext);
 
@@ -417,76 +420,152 @@ LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
  * table entries.  The caller must provide the hash functions to use for
  * the input tuple, as well as the equality functions, since these may be
  * different from the table's internal functions.
+ *
+ * Cross-type hash functions of a hash opfamily produce the same hash value
+ * for equal inputs, so comparing against the stored hash values is safe.
  */
 TupleHashEntry
 FindTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 				   FmgrInfo *eqfunctions,
 				   FmgrInfo *hashfunctions)
 {
-	TupleHashEntry entry;
+	TupleHashBucket *bucket;
 	MemoryContext oldContext;
-	TupleHashTable saveCurHT;
-	TupleHashEntryData dummy;
 
 	/* Need to run the hash functions in short-lived context */
 	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
 
-	/*
-	 * Set up data needed by hash and match functions
-	 *
-	 * We save and restore CurTupleHashTable just in case someone manages to
-	 * invoke this code re-entrantly.
-	 */
+	/* Set up data needed by hash and match functions */
 	hashtable->inputslot = slot;
 	hashtable->in_hash_funcs = hashfunctions;
 	hashtable->cur_eq_funcs = eqfunctions;
 
-	saveCurHT = CurTupleHashTable;
-	CurTupleHashTable = hashtable;
-
 	/* Search the hash table */
-	dummy.firstTuple = NULL;	/* flag to reference inputslot */
-	entry = (TupleHashEntry) hash_search(hashtable->hashtab,
-										 &dummy,
-										 HASH_FIND,
-										 NULL);
+	bucket = tuplehash_lookup(hashtable->hashtab, NULL);
+
+	MemoryContextSwitchTo(oldContext);
+
+	return bucket ? bucket->entry : NULL;
+}
+
+/*
+ * Remove the hashtable entry matching the given tuple, if there is one, and
+ * return it (else NULL).  The returned entry's storage stays valid only
+ * until the next insertion into or removal from the table; freeing its
+ * firstTuple and anything else hanging off it is the caller's business.
+ */
+TupleHashEntry
+RemoveTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot)
+{
+	TupleHashBucket *bucket;
+	TupleHashEntry entry;
+	MemoryContext oldContext;
+
+	/* Need to run the hash functions in short-lived context */
+	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
+
+	/* Set up data needed by hash and match functions */
+	hashtable->inputslot = slot;
+	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
+	hashtable->cur_eq_funcs = hashtable->tab_eq_funcs;
 
-	CurTupleHashTable = saveCurHT;
+	bucket = tuplehash_lookup(hashtable->hashtab, NULL);
+	if (bucket == NULL)
+		entry = NULL;
+	else
+	{
+		entry = bucket->entry;
+		(void) tuplehash_delete(hashtable->hashtab, NULL);
+
+		/*
+		 * Recycle the previously removed entry, and hold on to this one until
+		 * the next insertion or removal so the caller can still look at it.
+		 */
+		if (hashtable->removedentry)
+		{
+			hashtable->removedentry->firstTuple =
+				(MinimalTuple) hashtable->freelist;
+			hashtable->freelist = hashtable->removedentry;
+		}
+		hashtable->removedentry = entry;
+	}
 
 	MemoryContextSwitchTo(oldContext);
 
 	return entry;
 }
 
+/*
+ * Get storage for a new hashtable entry.
+ *
+ * Entries are carved out of batches allocated in the table context, rather
+ * than palloc'd one at a time, to save the per-chunk overhead.  Removed
+ * entries are chained through their firstTuple field and reused first.
+ */
+static TupleHashEntry
+TupleHashEntryAlloc(TupleHashTable hashtable)
+{
+	TupleHashEntry entry;
+
+	/* The entry removed last may be recycled now */
+	if (hashtable->removedentry)
+	{
+		hashtable->removedentry->firstTuple =
+			(MinimalTuple) hashtable->freelist;
+		hashtable->freelist = hashtable->removedentry;
+		hashtable->removedentry = NULL;
+	}
+
+	if (hashtable->freelist)
+	{
+		entry = hashtable->freelist;
+		hashtable->freelist = (TupleHashEntry) entry->firstTuple;
+		return entry;
+	}
+
+	if (hashtable->nbatchfree == 0)
+	{
+		hashtable->entrybatch = (char *)
+			MemoryContextAlloc(hashtable->tablecxt,
+							   TUPLEHASH_ENTRY_BATCH * hashtable->entrysize);
+		hashtable->nbatchfree = TUPLEHASH_ENTRY_BATCH;
+	}
+
+	entry = (TupleHashEntry) hashtable->entrybatch;
+	hashtable->entrybatch += hashtable->entrysize;
+	hashtable->nbatchfree--;
+
+	return entry;
+}
+
 /*
  * Compute the hash value for a tuple
  *
  * The passed-in key is a pointer to TupleHashEntryData.  In an actual hash
  * table entry, the firstTuple field points to a tuple (in MinimalTuple
- * format).  LookupTupleHashEntry sets up a dummy TupleHashEntryData with a
- * NULL firstTuple field --- that cues us to look at the inputslot instead.
- * This convention avoids the need to materialize virtual input tuples unless
- * they actually need to get copied into the table.
+ * format).  LookupTupleHashEntry passes a NULL key --- that cues us to look
+ * at the inputslot instead.  This convention avoids the need to materialize
+ * virtual input tuples unless they actually need to get copied into the
+ * table.
  *
- * CurTupleHashTable must be set before calling this, since dynahash.c
- * doesn't provide any API that would let us get at the hashtable otherwise.
+ * The hash values of table entries are stored in their buckets, so in
+ * practice we are only ever called for the inputslot.
  *
  * Also, the caller must select an appropriate memory context for running
- * the hash functions. (dynahash.c doesn't change CurrentMemoryContext.)
+ * the hash functions.
  */
 static uint32
-TupleHashTableHash(const void *key, Size keysize)
+TupleHashTableHash(tuplehash_hash *tb, TupleHashEntry entry)
 {
-	MinimalTuple tuple = ((const TupleHashEntryData *) key)->firstTuple;
-	TupleTableSlot *slot;
-	TupleHashTable hashtable = CurTupleHashTable;
+	TupleHashTable hashtable = (TupleHashTable) tb->private_data;
 	int			numCols = hashtable->numCols;
 	AttrNumber *keyColIdx = hashtable->keyColIdx;
+	TupleTableSlot *slot;
 	FmgrInfo   *hashfunctions;
 	uint32		hashkey = 0;
 	int			i;
 
-	if (tuple == NULL)
+	if (entry == NULL)
 	{
 		/* Process the current input tuple for the table */
 		slot = hashtable->inputslot;
@@ -495,9 +574,8 @@ TupleHashTableHash(const void *key, Size keysize)
 	else
 	{
 		/* Process a tuple already stored in the table */
-		/* (this case never actually occurs in current dynahash.c code) */
 		slot = hashtable->tableslot;
-		ExecStoreMinimalTuple(tuple, slot, false);
+		ExecStoreMinimalTuple(entry->firstTuple, slot, false);
 		hashfunctions = hashtable->tab_hash_funcs;
 	}
 
@@ -528,46 +606,31 @@ TupleHashTableHash(const void *key, Size keysize)
 /*
  * See whether two tuples (presumably of the same hash value) match
  *
- * As above, the passed pointers are pointers to TupleHashEntryData.
- *
- * CurTupleHashTable must be set before calling this, since dynahash.c
- * doesn't provide any API that would let us get at the hashtable otherwise.
+ * The first argument is always an actual table entry, and the second the
+ * NULL key standing for the inputslot.
  *
  * Also, the caller must select an appropriate memory context for running
- * the compare functions.  (dynahash.c doesn't change CurrentMemoryContext.)
+ * the compare functions.
  */
-static int
-TupleHashTableMatch(const void *key1, const void *key2, Size keysize)
+static bool
+TupleHashTableMatch(tuplehash_hash *tb, TupleHashEntry entry1,
+					TupleHashEntry entry2)
 {
-	MinimalTuple tuple1 = ((const TupleHashEntryData *) key1)->firstTuple;
-
-#ifdef USE_ASSERT_CHECKING
-	MinimalTuple tuple2 = ((const TupleHashEntryData *) key2)->firstTuple;
-#endif
+	TupleHashTable hashtable = (TupleHashTable) tb->private_data;
 	TupleTableSlot *slot1;
 	TupleTableSlot *slot2;
-	TupleHashTable hashtable = CurTupleHashTable;
 
-	/*
-	 * We assume that dynahash.c will only ever call us with the first
-	 * argument being an actual table entry, and the second argument being
-	 * LookupTupleHashEntry's dummy TupleHashEntryData.  The other direction
-	 * could be supported too, but is not currently used by dynahash.c.
-	 */
-	Assert(tuple1 != NULL);
+	Assert(entry1 != NULL);
 	slot1 = hashtable->tableslot;
-	ExecStoreMinimalTuple(tuple1, slot1, false);
-	Assert(tuple2 == NULL);
+	ExecStoreMinimalTuple(entry1->firstTuple, slot1, false);
+	Assert(entry2 == NULL);
 	slot2 = hashtable->inputslot;
 
 	/* For crosstype comparisons, the inputslot must be first */
-	if (execTuplesMatch(slot2,
-						slot1,
-						hashtable->numCols,
-						hashtable->keyColIdx,
-						hashtable->cur_eq_funcs,
-						hashtable->tempcxt))
-		return 0;
-	else
-		return 1;
+	return execTuplesMatch(slot2,
+						   slot1,
+						   hashtable->numCols,
+						   hashtable->keyColIdx,
+						   hashtable->cur_eq_funcs,
+						   hashtable->tempcxt);
 }
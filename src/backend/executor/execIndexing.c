@@ -7,7 +7,8 @@
  * ExecInsertIndexTuples() is the main entry point.  It's called after
  * inserting a tuple to the heap, and it inserts corresponding index tuples
  * into all indexes.  At the same time, it enforces any unique and
- * exclusion constraints:
+ * exclusion constraints.  ExecInsertIndexTuplesBatch() does the same for
+ * the rows of a multi-insert, visiting the indexes in turn:
  *
  * Unique Indexes
  * --------------
@@ -107,11 +108,14 @@
 #include "postgres.h"
 
 #include "access/relscan.h"
+#include "access/stratnum.h"
 #include "access/xact.h"
 #include "catalog/index.h"
+#include "catalog/pg_am.h"
 #include "executor/executor.h"
 #include "nodes/nodeFuncs.h"
 #include "storage/lmgr.h"
+#include "utils/sortsupport.h"
 #include "utils/tqual.h"
 
 /* waitMode argument to check_exclusion_or_unique_constraint() */
@@ -135,6 +139,32 @@ static bool index_recheck_constraint(Relation index, Oid *constr_procs,
 						 Datum *existing_values, bool *existing_isnull,
 						 Datum *new_values);
 
+/*
+ * One heap tuple's entry for an index, in ExecInsertIndexTuplesBatch
+ */
+typedef struct IndexBatchEntry
+{
+	int			tupno;			/* tuple's position in the batch */
+	Datum	   *values;			/* index column values */
+	bool	   *isnull;			/* and null flags */
+} IndexBatchEntry;
+
+/* Comparison state for sorting IndexBatchEntrys of a btree index */
+typedef struct IndexBatchSortState
+{
+	int			nkeys;			/* number of key columns */
+	SortSupport sortKeys;		/* array of length nkeys */
+} IndexBatchSortState;
+
+static bool ExecFormIndexValues(IndexInfo *indexInfo, TupleTableSlot *slot,
+					EState *estate, Datum *values, bool *isnull);
+static bool ExecInsertIndexTuple(ResultRelInfo *resultRelInfo, int i,
+					 Datum *values, bool *isnull, ItemPointer tupleid,
+					 EState *estate, bool noDupErr, bool arbiter);
+static void ExecSortIndexBatch(Relation indexRelation,
+				   IndexBatchEntry *entries, int nentries);
+static int	index_batch_entry_cmp(const void *a, const void *b, void *arg);
+
 /* ----------------------------------------------------------------
  *		ExecOpenIndices
  *
@@ -277,7 +307,6 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 	int			i;
 	int			numIndices;
 	RelationPtr relationDescs;
-	Relation	heapRelation;
 	IndexInfo **indexInfoArray;
 	ExprContext *econtext;
 	Datum		values[INDEX_MAX_KEYS];
@@ -290,7 +319,6 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 	numIndices = resultRelInfo->ri_NumIndices;
 	relationDescs = resultRelInfo->ri_IndexRelationDescs;
 	indexInfoArray = resultRelInfo->ri_IndexRelationInfo;
-	heapRelation = resultRelInfo->ri_RelationDesc;
 
 	/*
 	 * We will use the EState's per-tuple context for evaluating predicates
@@ -308,8 +336,6 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 	{
 		Relation	indexRelation = relationDescs[i];
 		IndexInfo  *indexInfo;
-		IndexUniqueCheck checkUnique;
-		bool		satisfiesConstraint;
 		bool		arbiter;
 
 		if (indexRelation == NULL)
@@ -325,129 +351,403 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 		if (!indexInfo->ii_ReadyForInserts)
 			continue;
 
-		/* Check for partial index */
-		if (indexInfo->ii_Predicate != NIL)
-		{
-			List	   *predicate;
+		/* Skip this index-update if a partial index's predicate fails */
+		if (!ExecFormIndexValues(indexInfo, slot, estate, values, isnull))
+			continue;
 
+		if (ExecInsertIndexTuple(resultRelInfo, i, values, isnull, tupleid,
+								 estate, noDupErr,
+								 arbiterIndexes == NIL || arbiter))
+		{
 			/*
-			 * If predicate state not set up yet, create it (in the estate's
-			 * per-query context)
+			 * The tuple potentially violates the uniqueness or exclusion
+			 * constraint, so make a note of the index so that we can re-check
+			 * it later.  Speculative inserters are told if there was a
+			 * speculative conflict, since that always requires a restart.
 			 */
-			predicate = indexInfo->ii_PredicateState;
-			if (predicate == NIL)
-			{
-				predicate = (List *)
-					ExecPrepareExpr((Expr *) indexInfo->ii_Predicate,
-									estate);
-				indexInfo->ii_PredicateState = predicate;
-			}
-
-			/* Skip this index-update if the predicate isn't satisfied */
-			if (!ExecQual(predicate, econtext, false))
-				continue;
+			result = lappend_oid(result, RelationGetRelid(indexRelation));
+			if (indexRelation->rd_index->indimmediate && specConflict)
+				*specConflict = true;
 		}
+	}
 
-		/*
-		 * FormIndexDatum fills in its values and isnull parameters with the
-		 * appropriate values for the column(s) of the index.
-		 */
-		FormIndexDatum(indexInfo,
-					   slot,
-					   estate,
-					   values,
-					   isnull);
+	return result;
+}
+
+/*
+ * ExecFormIndexValues -- compute the index columns for the tuple in slot
+ *
+ * Returns false without computing anything if the tuple doesn't satisfy a
+ * partial index's predicate.  The EState's per-tuple expression context
+ * must have the slot as its scan tuple.
+ */
+static bool
+ExecFormIndexValues(IndexInfo *indexInfo, TupleTableSlot *slot,
+					EState *estate, Datum *values, bool *isnull)
+{
+	/* Check for partial index */
+	if (indexInfo->ii_Predicate != NIL)
+	{
+		List	   *predicate;
 
 		/*
-		 * The index AM does the actual insertion, plus uniqueness checking.
-		 *
-		 * For an immediate-mode unique index, we just tell the index AM to
-		 * throw error if not unique.
-		 *
-		 * For a deferrable unique index, we tell the index AM to just detect
-		 * possible non-uniqueness, and we add the index OID to the result
-		 * list if further checking is needed.
-		 *
-		 * For a speculative insertion (used by INSERT ... ON CONFLICT), do
-		 * the same as for a deferrable unique index.
+		 * If predicate state not set up yet, create it (in the estate's
+		 * per-query context)
 		 */
-		if (!indexRelation->rd_index->indisunique)
-			checkUnique = UNIQUE_CHECK_NO;
-		else if (noDupErr && (arbiterIndexes == NIL || arbiter))
-			checkUnique = UNIQUE_CHECK_PARTIAL;
-		else if (indexRelation->rd_index->indimmediate)
-			checkUnique = UNIQUE_CHECK_YES;
+		predicate = indexInfo->ii_PredicateState;
+		if (predicate == NIL)
+		{
+			predicate = (List *)
+				ExecPrepareExpr((Expr *) indexInfo->ii_Predicate,
+								estate);
+			indexInfo->ii_PredicateState = predicate;
+		}
+
+		if (!ExecQual(predicate, GetPerTupleExprContext(estate), false))
+			return false;
+	}
+
+	/*
+	 * FormIndexDatum fills in its values and isnull parameters with the
+	 * appropriate values for the column(s) of the index.
+	 */
+	FormIndexDatum(indexInfo,
+				   slot,
+				   estate,
+				   values,
+				   isnull);
+
+	return true;
+}
+
+/*
+ * ExecInsertIndexTuple -- insert one entry into the i'th index of the
+ * result relation, for the heap tuple at tupleid
+ *
+ * values and isnull hold the index columns, as computed by
+ * ExecFormIndexValues.  Unique and exclusion constraints are enforced as
+ * described for ExecInsertIndexTuples; arbiter says whether the index is
+ * one that a noDupErr caller wants conflicts reported for.  Returns true if
+ * the tuple potentially violates the index's constraint, so that it must
+ * be re-checked later.
+ */
+static bool
+ExecInsertIndexTuple(ResultRelInfo *resultRelInfo, int i,
+					 Datum *values, bool *isnull, ItemPointer tupleid,
+					 EState *estate, bool noDupErr, bool arbiter)
+{
+	Relation	indexRelation = resultRelInfo->ri_IndexRelationDescs[i];
+	IndexInfo  *indexInfo = resultRelInfo->ri_IndexRelationInfo[i];
+	Relation	heapRelation = resultRelInfo->ri_RelationDesc;
+	IndexUniqueCheck checkUnique;
+	bool		satisfiesConstraint;
+
+	/*
+	 * The index AM does the actual insertion, plus uniqueness checking.
+	 *
+	 * For an immediate-mode unique index, we just tell the index AM to throw
+	 * error if not unique.
+	 *
+	 * For a deferrable unique index, we tell the index AM to just detect
+	 * possible non-uniqueness, and we add the index OID to the result list
+	 * if further checking is needed.
+	 *
+	 * For a speculative insertion (used by INSERT ... ON CONFLICT), do the
+	 * same as for a deferrable unique index.
+	 */
+	if (!indexRelation->rd_index->indisunique)
+		checkUnique = UNIQUE_CHECK_NO;
+	else if (noDupErr && arbiter)
+		checkUnique = UNIQUE_CHECK_PARTIAL;
+	else if (indexRelation->rd_index->indimmediate)
+		checkUnique = UNIQUE_CHECK_YES;
+	else
+		checkUnique = UNIQUE_CHECK_PARTIAL;
+
+	satisfiesConstraint =
+		index_insert(indexRelation,		/* index relation */
+					 values,	/* array of index Datums */
+					 isnull,	/* null flags */
+					 tupleid,	/* tid of heap tuple */
+					 heapRelation,		/* heap relation */
+					 checkUnique);		/* type of uniqueness check to do */
+
+	/*
+	 * If the index has an associated exclusion constraint, check that. This
+	 * is simpler than the process for uniqueness checks since we always
+	 * insert first and then check.  If the constraint is deferred, we check
+	 * now anyway, but don't throw error on violation or wait for a
+	 * conclusive outcome from a concurrent insertion; instead we'll queue a
+	 * recheck event.  Similarly, noDupErr callers (speculative inserters)
+	 * will recheck later, and wait for a conclusive outcome then.
+	 *
+	 * An index for an exclusion constraint can't also be UNIQUE (not an
+	 * essential property, we just don't allow it in the grammar), so no need
+	 * to preserve the prior state of satisfiesConstraint.
+	 */
+	if (indexInfo->ii_ExclusionOps != NULL)
+	{
+		bool		violationOK;
+		CEOUC_WAIT_MODE waitMode;
+
+		if (noDupErr)
+		{
+			violationOK = true;
+			waitMode = CEOUC_LIVELOCK_PREVENTING_WAIT;
+		}
+		else if (!indexRelation->rd_index->indimmediate)
+		{
+			violationOK = true;
+			waitMode = CEOUC_NOWAIT;
+		}
 		else
-			checkUnique = UNIQUE_CHECK_PARTIAL;
+		{
+			violationOK = false;
+			waitMode = CEOUC_WAIT;
+		}
 
 		satisfiesConstraint =
-			index_insert(indexRelation, /* index relation */
-						 values,	/* array of index Datums */
-						 isnull,	/* null flags */
-						 tupleid,		/* tid of heap tuple */
-						 heapRelation,	/* heap relation */
-						 checkUnique);	/* type of uniqueness check to do */
+			check_exclusion_or_unique_constraint(heapRelation,
+												 indexRelation, indexInfo,
+												 tupleid, values, isnull,
+												 estate, false,
+												 waitMode, violationOK, NULL);
+	}
 
-		/*
-		 * If the index has an associated exclusion constraint, check that.
-		 * This is simpler than the process for uniqueness checks since we
-		 * always insert first and then check.  If the constraint is deferred,
-		 * we check now anyway, but don't throw error on violation or wait for
-		 * a conclusive outcome from a concurrent insertion; instead we'll
-		 * queue a recheck event.  Similarly, noDupErr callers (speculative
-		 * inserters) will recheck later, and wait for a conclusive outcome
-		 * then.
-		 *
-		 * An index for an exclusion constraint can't also be UNIQUE (not an
-		 * essential property, we just don't allow it in the grammar), so no
-		 * need to preserve the prior state of satisfiesConstraint.
-		 */
-		if (indexInfo->ii_ExclusionOps != NULL)
+	return (checkUnique == UNIQUE_CHECK_PARTIAL ||
+			indexInfo->ii_ExclusionOps != NULL) &&
+		!satisfiesConstraint;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInsertIndexTuplesBatch
+ *
+ *		Like ExecInsertIndexTuples, for a batch of heap tuples that
+ *		were just inserted together by heap_multi_insert.  The list
+ *		of indexes that ExecInsertIndexTuples would have returned for
+ *		tuples[j] is stored in recheckIndexes[j].  Speculative
+ *		insertion isn't supported.
+ *
+ *		Rather than visiting every index for each tuple in turn, we
+ *		insert all of the batch's entries into one index after the
+ *		other, and into btree indexes in key order.  Consecutive
+ *		entries then mostly belong on the same leaf page, which the
+ *		btree code can return to without descending the tree again.
+ *		Entries with equal keys are inserted in batch order, so a
+ *		uniqueness violation is still reported for the later tuple.
+ *
+ *		If curpos isn't NULL, *curpos is set to firstpos plus the
+ *		tuple's position in the batch before each insertion, for the
+ *		benefit of the caller's error context callback.
+ * ----------------------------------------------------------------
+ */
+void
+ExecInsertIndexTuplesBatch(TupleTableSlot *slot, HeapTuple *tuples,
+						   int ntuples, EState *estate,
+						   List **recheckIndexes,
+						   int *curpos, int firstpos)
+{
+	ResultRelInfo *resultRelInfo;
+	int			numIndices;
+	RelationPtr relationDescs;
+	IndexInfo **indexInfoArray;
+	ExprContext *econtext;
+	IndexBatchEntry **entries;
+	int		   *nentries;
+	int			i;
+	int			j;
+
+	/*
+	 * Get information from the result relation info structure.
+	 */
+	resultRelInfo = estate->es_result_relation_info;
+	numIndices = resultRelInfo->ri_NumIndices;
+	relationDescs = resultRelInfo->ri_IndexRelationDescs;
+	indexInfoArray = resultRelInfo->ri_IndexRelationInfo;
+
+	/* As in ExecInsertIndexTuples, predicates are evaluated in econtext */
+	econtext = GetPerTupleExprContext(estate);
+	econtext->ecxt_scantuple = slot;
+
+	for (j = 0; j < ntuples; j++)
+		recheckIndexes[j] = NIL;
+
+	/*
+	 * First form the index columns of every tuple, for every index, so that
+	 * each tuple only needs to be stored in the slot once.
+	 */
+	entries = (IndexBatchEntry **) palloc0(numIndices *
+										   sizeof(IndexBatchEntry *));
+	nentries = (int *) palloc0(numIndices * sizeof(int));
+
+	for (i = 0; i < numIndices; i++)
+	{
+		IndexInfo  *indexInfo = indexInfoArray[i];
+		Datum	   *values;
+		bool	   *isnull;
+
+		/* If the index is marked as read-only, ignore it */
+		if (relationDescs[i] == NULL || !indexInfo->ii_ReadyForInserts)
+			continue;
+
+		entries[i] = (IndexBatchEntry *)
+			palloc(ntuples * sizeof(IndexBatchEntry));
+		values = (Datum *)
+			palloc(ntuples * indexInfo->ii_NumIndexAttrs * sizeof(Datum));
+		isnull = (bool *)
+			palloc(ntuples * indexInfo->ii_NumIndexAttrs * sizeof(bool));
+		for (j = 0; j < ntuples; j++)
 		{
-			bool		violationOK;
-			CEOUC_WAIT_MODE waitMode;
+			entries[i][j].values = values + j * indexInfo->ii_NumIndexAttrs;
+			entries[i][j].isnull = isnull + j * indexInfo->ii_NumIndexAttrs;
+		}
+	}
 
-			if (noDupErr)
-			{
-				violationOK = true;
-				waitMode = CEOUC_LIVELOCK_PREVENTING_WAIT;
-			}
-			else if (!indexRelation->rd_index->indimmediate)
-			{
-				violationOK = true;
-				waitMode = CEOUC_NOWAIT;
-			}
-			else
+	for (j = 0; j < ntuples; j++)
+	{
+		ExecStoreTuple(tuples[j], slot, InvalidBuffer, false);
+
+		for (i = 0; i < numIndices; i++)
+		{
+			IndexBatchEntry *entry;
+
+			if (entries[i] == NULL)
+				continue;
+
+			entry = &entries[i][nentries[i]];
+			if (ExecFormIndexValues(indexInfoArray[i], slot, estate,
+									entry->values, entry->isnull))
 			{
-				violationOK = false;
-				waitMode = CEOUC_WAIT;
+				entry->tupno = j;
+				nentries[i]++;
 			}
+		}
+	}
+
+	/*
+	 * Now insert the entries, one index at a time.
+	 */
+	for (i = 0; i < numIndices; i++)
+	{
+		Relation	indexRelation = relationDescs[i];
+		bool		sorted = false;
 
-			satisfiesConstraint =
-				check_exclusion_or_unique_constraint(heapRelation,
-													 indexRelation, indexInfo,
-													 tupleid, values, isnull,
-													 estate, false,
-												waitMode, violationOK, NULL);
+		if (nentries[i] == 0)
+			continue;
+
+		if (indexRelation->rd_rel->relam == BTREE_AM_OID && nentries[i] > 1)
+		{
+			ExecSortIndexBatch(indexRelation, entries[i], nentries[i]);
+			sorted = true;
 		}
 
-		if ((checkUnique == UNIQUE_CHECK_PARTIAL ||
-			 indexInfo->ii_ExclusionOps != NULL) &&
-			!satisfiesConstraint)
+		/*
+		 * Tell the index AM that the entries are coming in key order.  That's
+		 * only a hint, but make sure it doesn't outlive this batch.
+		 */
+		indexRelation->rd_sortedinsert = sorted;
+		PG_TRY();
 		{
-			/*
-			 * The tuple potentially violates the uniqueness or exclusion
-			 * constraint, so make a note of the index so that we can re-check
-			 * it later.  Speculative inserters are told if there was a
-			 * speculative conflict, since that always requires a restart.
-			 */
-			result = lappend_oid(result, RelationGetRelid(indexRelation));
-			if (indexRelation->rd_index->indimmediate && specConflict)
-				*specConflict = true;
+			for (j = 0; j < nentries[i]; j++)
+			{
+				IndexBatchEntry *entry = &entries[i][j];
+				HeapTuple	tuple = tuples[entry->tupno];
+
+				if (curpos)
+					*curpos = firstpos + entry->tupno;
+
+				if (ExecInsertIndexTuple(resultRelInfo, i,
+										 entry->values, entry->isnull,
+										 &(tuple->t_self), estate,
+										 false, false))
+					recheckIndexes[entry->tupno] =
+						lappend_oid(recheckIndexes[entry->tupno],
+									RelationGetRelid(indexRelation));
+			}
 		}
+		PG_CATCH();
+		{
+			indexRelation->rd_sortedinsert = false;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		indexRelation->rd_sortedinsert = false;
 	}
 
-	return result;
+	for (i = 0; i < numIndices; i++)
+	{
+		if (entries[i] == NULL)
+			continue;
+		pfree(entries[i][0].values);
+		pfree(entries[i][0].isnull);
+		pfree(entries[i]);
+	}
+	pfree(entries);
+	pfree(nentries);
+}
+
+/*
+ * ExecSortIndexBatch -- sort a batch of entries for a btree index into
+ * the index's key order, keeping entries with equal keys in batch order
+ */
+static void
+ExecSortIndexBatch(Relation indexRelation, IndexBatchEntry *entries,
+				   int nentries)
+{
+	IndexBatchSortState state;
+	int			k;
+
+	state.nkeys = IndexRelationGetNumberOfKeyAttributes(indexRelation);
+	state.sortKeys = (SortSupport) palloc0(state.nkeys *
+										   sizeof(SortSupportData));
+
+	for (k = 0; k < state.nkeys; k++)
+	{
+		SortSupport sortKey = state.sortKeys + k;
+		int16		indoption = indexRelation->rd_indoption[k];
+		int16		strategy;
+
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_collation = indexRelation->rd_indcollation[k];
+		sortKey->ssup_nulls_first = (indoption & INDOPTION_NULLS_FIRST) != 0;
+		sortKey->ssup_attno = k + 1;
+
+		strategy = (indoption & INDOPTION_DESC) != 0 ?
+			BTGreaterStrategyNumber : BTLessStrategyNumber;
+
+		PrepareSortSupportFromIndexRel(indexRelation, strategy, sortKey);
+	}
+
+	qsort_arg(entries, nentries, sizeof(IndexBatchEntry),
+			  index_batch_entry_cmp, &state);
+
+	pfree(state.sortKeys);
+}
+
+/*
+ * qsort_arg comparator for ExecSortIndexBatch
+ */
+static int
+index_batch_entry_cmp(const void *a, const void *b, void *arg)
+{
+	const IndexBatchEntry *ea = (const IndexBatchEntry *) a;
+	const IndexBatchEntry *eb = (const IndexBatchEntry *) b;
+	IndexBatchSortState *state = (IndexBatchSortState *) arg;
+	int			k;
+
+	for (k = 0; k < state->nkeys; k++)
+	{
+		int			compare;
+
+		compare = ApplySortComparator(ea->values[k], ea->isnull[k],
+									  eb->values[k], eb->isnull[k],
+									  &state->sortKeys[k]);
+		if (compare != 0)
+			return compare;
+	}
+
+	/* equal keys go in batch order, which is also heap TID order */
+	return ea->tupno - eb->tupno;
 }
 
 /* ----------------------------------------------------------------
@@ -646,7 +946,7 @@ check_exclusion_or_unique_constraint(Relation heap, Relation index,
 	Oid		   *constr_procs;
 	uint16	   *constr_strats;
 	Oid		   *index_collations = index->rd_indcollation;
-	int			index_natts = index->rd_index->indnatts;
+	int			index_natts = IndexRelationGetNumberOfKeyAttributes(index);
 	IndexScanDesc index_scan;
 	HeapTuple	tup;
 	ScanKeyData scankeys[INDEX_MAX_KEYS];
@@ -879,7 +1179,7 @@ index_recheck_constraint(Relation index, Oid *constr_procs,
 						 Datum *existing_values, bool *existing_isnull,
 						 Datum *new_values)
 {
-	int			index_natts = index->rd_index->indnatts;
+	int			index_natts = IndexRelationGetNumberOfKeyAttributes(index);
 	int			i;
 
 	for (i = 0; i < index_natts; i++)
@@ -39,6 +39,7 @@
 
 #include "access/htup_details.h"
 #include "access/sysattr.h"
+#include "access/tableam.h"
 #include "access/transam.h"
 #include "access/xact.h"
 #include "catalog/namespace.h"
@@ -56,6 +57,7 @@
 #include "utils/acl.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/profiler.h"
 #include "utils/rls.h"
 #include "utils/snapmgr.h"
 #include "utils/tqual.h"
@@ -294,6 +296,7 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 	DestReceiver *dest;
 	bool		sendTuples;
 	MemoryContext oldcontext;
+	uint32		save_queryid = ProfileActiveQueryId;
 
 	/* sanity checks */
 	Assert(queryDesc != NULL);
@@ -303,6 +306,9 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 	Assert(estate != NULL);
 	Assert(!(estate->es_top_eflags & EXEC_FLAG_EXPLAIN_ONLY));
 
+	/* Let the sampling profiler attribute samples to this query */
+	ProfileActiveQueryId = queryDesc->plannedstmt->queryId;
+
 	/*
 	 * Switch into per-query memory context
 	 */
@@ -351,6 +357,8 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 	if (queryDesc->totaltime)
 		InstrStopNode(queryDesc->totaltime, estate->es_processed);
 
+	ProfileActiveQueryId = save_queryid;
+
 	MemoryContextSwitchTo(oldcontext);
 }
 
@@ -2229,7 +2237,7 @@ EvalPlanQualFetch(EState *estate, Relation relation, int lockmode,
 	{
 		Buffer		buffer;
 
-		if (heap_fetch(relation, &SnapshotDirty, &tuple, &buffer, true, NULL))
+		if (table_fetch(relation, &SnapshotDirty, &tuple, &buffer, true, NULL))
 		{
 			HTSU_Result test;
 			HeapUpdateFailureData hufd;
@@ -2304,10 +2312,10 @@ EvalPlanQualFetch(EState *estate, Relation relation, int lockmode,
 			/*
 			 * This is a live tuple, so now try to lock it.
 			 */
-			test = heap_lock_tuple(relation, &tuple,
-								   estate->es_output_cid,
-								   lockmode, wait_policy,
-								   false, &buffer, &hufd);
+			test = table_lock_tuple(relation, &tuple,
+									estate->es_output_cid,
+									lockmode, wait_policy,
+									false, &buffer, &hufd);
 			/* We now have two pins on the buffer, get rid of one */
 			ReleaseBuffer(buffer);
 
@@ -2596,13 +2604,14 @@ EvalPlanQualFetchRowMarks(EPQState *epqstate)
 				Buffer		buffer;
 
 				tuple.t_self = *((ItemPointer) DatumGetPointer(datum));
-				if (!heap_fetch(erm->relation, SnapshotAny, &tuple, &buffer,
-								false, NULL))
+				if (!table_fetch(erm->relation, SnapshotAny, &tuple, &buffer,
+								 false, NULL))
 					elog(ERROR, "failed to fetch tuple for EvalPlanQual recheck");
 
 				/* successful, copy tuple */
 				copyTuple = heap_copytuple(&tuple);
-				ReleaseBuffer(buffer);
+				if (BufferIsValid(buffer))
+					ReleaseBuffer(buffer);
 			}
 
 			/* store tuple */
@@ -77,6 +77,7 @@
  */
 #include "postgres.h"
 
+#include "executor/execFlatExpr.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
 #include "executor/nodeAppend.h"
@@ -92,10 +93,12 @@
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
 #include "executor/nodeIndexonlyscan.h"
+#include "executor/nodeIncrementalSort.h"
 #include "executor/nodeIndexscan.h"
 #include "executor/nodeLimit.h"
 #include "executor/nodeLockRows.h"
 #include "executor/nodeMaterial.h"
+#include "executor/nodeMemoize.h"
 #include "executor/nodeMergeAppend.h"
 #include "executor/nodeMergejoin.h"
 #include "executor/nodeModifyTable.h"
@@ -114,6 +117,7 @@
 #include "executor/nodeWindowAgg.h"
 #include "executor/nodeWorktablescan.h"
 #include "miscadmin.h"
+#include "utils/profiler.h"
 
 
 /* ------------------------------------------------------------------------
@@ -282,11 +286,21 @@ ExecInitNode(Plan *node, EState *estate, int eflags)
 													estate, eflags);
 			break;
 
+		case T_Memoize:
+			result = (PlanState *) ExecInitMemoize((Memoize *) node,
+												   estate, eflags);
+			break;
+
 		case T_Sort:
 			result = (PlanState *) ExecInitSort((Sort *) node,
 												estate, eflags);
 			break;
 
+		case T_IncrementalSort:
+			result = (PlanState *) ExecInitIncrementalSort((IncrementalSort *) node,
+														   estate, eflags);
+			break;
+
 		case T_Group:
 			result = (PlanState *) ExecInitGroup((Group *) node,
 												 estate, eflags);
@@ -333,6 +347,9 @@ ExecInitNode(Plan *node, EState *estate, int eflags)
 			break;
 	}
 
+	/* Flatten the node's per-row expressions, if enabled */
+	ExecFlattenPlanExprs(result);
+
 	/*
 	 * Initialize any initPlans present in this node.  The planner put them in
 	 * a separate list for us.
@@ -367,6 +384,7 @@ TupleTableSlot *
 ExecProcNode(PlanState *node)
 {
 	TupleTableSlot *result;
+	NodeTag		save_plan_node = ProfileActivePlanNode;
 
 	CHECK_FOR_INTERRUPTS();
 
@@ -376,6 +394,9 @@ ExecProcNode(PlanState *node)
 	if (node->instrument)
 		InstrStartNode(node->instrument);
 
+	/* Time spent below here is charged to this node, until a child runs */
+	ProfileActivePlanNode = nodeTag(node->plan);
+
 	switch (nodeTag(node))
 	{
 			/*
@@ -484,10 +505,18 @@ ExecProcNode(PlanState *node)
 			result = ExecMaterial((MaterialState *) node);
 			break;
 
+		case T_MemoizeState:
+			result = ExecMemoize((MemoizeState *) node);
+			break;
+
 		case T_SortState:
 			result = ExecSort((SortState *) node);
 			break;
 
+		case T_IncrementalSortState:
+			result = ExecIncrementalSort((IncrementalSortState *) node);
+			break;
+
 		case T_GroupState:
 			result = ExecGroup((GroupState *) node);
 			break;
@@ -526,6 +555,8 @@ ExecProcNode(PlanState *node)
 			break;
 	}
 
+	ProfileActivePlanNode = save_plan_node;
+
 	if (node->instrument)
 		InstrStopNode(node->instrument, TupIsNull(result) ? 0.0 : 1.0);
 
@@ -550,12 +581,15 @@ Node *
 MultiExecProcNode(PlanState *node)
 {
 	Node	   *result;
+	NodeTag		save_plan_node = ProfileActivePlanNode;
 
 	CHECK_FOR_INTERRUPTS();
 
 	if (node->chgParam != NULL) /* something changed */
 		ExecReScan(node);		/* let ReScan handle this */
 
+	ProfileActivePlanNode = nodeTag(node->plan);
+
 	switch (nodeTag(node))
 	{
 			/*
@@ -584,6 +618,8 @@ MultiExecProcNode(PlanState *node)
 			break;
 	}
 
+	ProfileActivePlanNode = save_plan_node;
+
 	return result;
 }
 
@@ -728,10 +764,18 @@ ExecEndNode(PlanState *node)
 			ExecEndMaterial((MaterialState *) node);
 			break;
 
+		case T_MemoizeState:
+			ExecEndMemoize((MemoizeState *) node);
+			break;
+
 		case T_SortState:
 			ExecEndSort((SortState *) node);
 			break;
 
+		case T_IncrementalSortState:
+			ExecEndIncrementalSort((IncrementalSortState *) node);
+			break;
+
 		case T_GroupState:
 			ExecEndGroup((GroupState *) node);
 			break;
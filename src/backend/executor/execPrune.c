@@ -0,0 +1,213 @@
+/*-------------------------------------------------------------------------
+ *
+ * execPrune.c
+ *	  executor support for run-time pruning of Append and MergeAppend
+ *	  subplans
+ *
+ * The planner's constraint exclusion can only use quals whose values are
+ * known at plan time.  When a child's quals compare its columns to Params,
+ * the planner instead saves the child's CHECK constraints and those quals in
+ * the Append or MergeAppend node (see build_runtime_pruning_info), and here
+ * we substitute the Params' current values and try again to refute the
+ * constraints.  Subplans depending only on PARAM_EXTERN Params are pruned
+ * at executor startup, and never initialized at all; subplans depending on
+ * PARAM_EXEC Params are checked again at the start of every scan.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *	src/backend/executor/execPrune.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/executor.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/predtest.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+
+static bool contain_exec_param_walker(Node *node, void *context);
+static Node *substitute_params_mutator(Node *node, ExprContext *econtext);
+static bool subplan_is_refuted(List *constraints, List *clauses,
+				   ExprContext *econtext);
+
+
+/*
+ * ExecPruneSubplansAtInit
+ *
+ * Given the subplans of an Append or MergeAppend and the node's run-time
+ * pruning info, return the list of subplans that need to be initialized.
+ * *nremoved is set to the number of subplans left out.
+ *
+ * *constraints and *clauses are set to arrays parallel to the result, giving
+ * the pruning info to be checked at the start of each scan, or NIL for
+ * subplans that always have to be scanned.
+ *
+ * At least one subplan is always returned, since callers rely on having a
+ * first subplan to describe their output; if all of them could be pruned,
+ * the last one is kept with pruning info that will make it be skipped.
+ */
+List *
+ExecPruneSubplansAtInit(List *subplans,
+						List *prune_constraints, List *prune_clauses,
+						ExprContext *econtext,
+						List ***constraints, List ***clauses,
+						int *nremoved)
+{
+	List	   *result = NIL;
+	int			nsubplans = list_length(subplans);
+	int			n = 0;
+	ListCell   *lc1,
+			   *lc2,
+			   *lc3;
+
+	Assert(list_length(prune_constraints) == nsubplans);
+	Assert(list_length(prune_clauses) == nsubplans);
+
+	*constraints = (List **) palloc0(nsubplans * sizeof(List *));
+	*clauses = (List **) palloc0(nsubplans * sizeof(List *));
+
+	forthree(lc1, subplans, lc2, prune_constraints, lc3, prune_clauses)
+	{
+		Plan	   *subplan = (Plan *) lfirst(lc1);
+		List	   *subconstraints = (List *) lfirst(lc2);
+		List	   *subclauses = (List *) lfirst(lc3);
+
+		if (subclauses != NIL)
+		{
+			if (contain_exec_param_walker((Node *) subclauses, NULL))
+			{
+				/* Have to wait until the PARAM_EXEC values are known */
+				(*constraints)[n] = subconstraints;
+				(*clauses)[n] = subclauses;
+			}
+			else if (subplan_is_refuted(subconstraints, subclauses, econtext))
+			{
+				if (result == NIL && lnext(lc1) == NULL)
+				{
+					/* Keep a dummy subplan, see above */
+					(*constraints)[n] = subconstraints;
+					(*clauses)[n] = subclauses;
+				}
+				else
+					continue;
+			}
+		}
+
+		result = lappend(result, subplan);
+		n++;
+	}
+
+	*nremoved = nsubplans - n;
+
+	return result;
+}
+
+/*
+ * ExecPruneSubplansAtScan
+ *
+ * Set valid[i] to whether the i'th of nplans initialized subplans has to be
+ * scanned with the current Param values, given the pruning info returned by
+ * ExecPruneSubplansAtInit.
+ */
+void
+ExecPruneSubplansAtScan(int nplans, List **constraints, List **clauses,
+						ExprContext *econtext, bool *valid)
+{
+	int			i;
+
+	for (i = 0; i < nplans; i++)
+	{
+		if (clauses[i] == NIL)
+			valid[i] = true;
+		else
+			valid[i] = !subplan_is_refuted(constraints[i], clauses[i],
+										   econtext);
+	}
+}
+
+/*
+ * subplan_is_refuted
+ *
+ * Do the current values of the Params in the clauses prove that no row
+ * satisfying the constraints can pass the clauses?
+ */
+static bool
+subplan_is_refuted(List *constraints, List *clauses, ExprContext *econtext)
+{
+	MemoryContext oldcontext;
+	Node	   *quals;
+	bool		result;
+
+	/* Work in short-lived memory, the expressions are of no later use */
+	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	quals = substitute_params_mutator((Node *) clauses, econtext);
+	quals = eval_const_expressions(NULL, quals);
+
+	result = predicate_refuted_by(constraints, (List *) quals);
+
+	MemoryContextSwitchTo(oldcontext);
+	ResetExprContext(econtext);
+
+	return result;
+}
+
+/*
+ * substitute_params_mutator
+ *	  Replace every Param by a Const holding its current value.
+ */
+static Node *
+substitute_params_mutator(Node *node, ExprContext *econtext)
+{
+	if (node == NULL)
+		return NULL;
+	if (IsA(node, Param))
+	{
+		Param	   *param = (Param *) node;
+		ExprState  *exprstate;
+		Datum		value;
+		bool		isnull;
+		int16		typLen;
+		bool		typByVal;
+
+		exprstate = ExecInitExpr((Expr *) param, NULL);
+		value = ExecEvalExpr(exprstate, econtext, &isnull, NULL);
+
+		get_typlenbyval(param->paramtype, &typLen, &typByVal);
+		if (!isnull)
+			value = datumCopy(value, typByVal, typLen);
+		else
+			value = (Datum) 0;
+
+		return (Node *) makeConst(param->paramtype,
+								  param->paramtypmod,
+								  param->paramcollid,
+								  (int) typLen,
+								  value,
+								  isnull,
+								  typByVal);
+	}
+	return expression_tree_mutator(node, substitute_params_mutator,
+								   (void *) econtext);
+}
+
+/*
+ * contain_exec_param_walker
+ *	  Does the expression contain any PARAM_EXEC Params?
+ */
+static bool
+contain_exec_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+		return ((Param *) node)->paramkind == PARAM_EXEC;
+	return expression_tree_walker(node, contain_exec_param_walker, context);
+}
@@ -59,6 +59,35 @@
 #include "utils/xml.h"
 
 
+/*
+ * Hash table of the elements of a constant array, used to evaluate
+ * ScalarArrayOpExprs for which the planner has chosen hashed lookups.
+ */
+typedef struct SaopHashEntry
+{
+	Datum		key;			/* a non-null array element */
+	uint32		hash;			/* hash value of key */
+	char		status;			/* hash status */
+} SaopHashEntry;
+
+static uint32 saop_element_hash(struct saophash_hash *tb, Datum key);
+static bool saop_element_match(struct saophash_hash *tb, Datum key1,
+				   Datum key2);
+
+#define SH_PREFIX saophash
+#define SH_ELEMENT_TYPE SaopHashEntry
+#define SH_KEY_TYPE Datum
+#define SH_KEY key
+#define SH_HASH_KEY(tb, key) saop_element_hash(tb, key)
+#define SH_EQUAL(tb, a, b) saop_element_match(tb, a, b)
+#define SH_SCOPE static inline
+#define SH_STORE_HASH
+#define SH_GET_HASH(tb, a) a->hash
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+
 /* static function decls */
 static Datum ExecEvalArrayRef(ArrayRefExprState *astate,
 				 ExprContext *econtext,
@@ -118,6 +147,8 @@ static Datum ExecEvalDistinct(FuncExprState *fcache, ExprContext *econtext,
 static Datum ExecEvalScalarArrayOp(ScalarArrayOpExprState *sstate,
 					  ExprContext *econtext,
 					  bool *isNull, ExprDoneCond *isDone);
+static void build_saop_hash_table(ScalarArrayOpExprState *sstate,
+					  Datum arraydatum, MemoryContext tablecxt);
 static Datum ExecEvalNot(BoolExprState *notclause, ExprContext *econtext,
 			bool *isNull, ExprDoneCond *isDone);
 static Datum ExecEvalOr(BoolExprState *orExpr, ExprContext *econtext,
@@ -2517,6 +2548,123 @@ ExecEvalDistinct(FuncExprState *fcache,
 	return result;
 }
 
+/*
+ * Hash and equality support functions for the saophash table.  The table's
+ * private_data is the owning ScalarArrayOpExprState.
+ */
+static uint32
+saop_element_hash(struct saophash_hash *tb, Datum key)
+{
+	ScalarArrayOpExprState *sstate = (ScalarArrayOpExprState *) tb->private_data;
+
+	return DatumGetUInt32(FunctionCall1Coll(&sstate->hash_finfo,
+											sstate->fxprstate.fcinfo_data.fncollation,
+											key));
+}
+
+static bool
+saop_element_match(struct saophash_hash *tb, Datum key1, Datum key2)
+{
+	ScalarArrayOpExprState *sstate = (ScalarArrayOpExprState *) tb->private_data;
+
+	return DatumGetBool(FunctionCall2Coll(&sstate->eq_finfo,
+										  sstate->fxprstate.fcinfo_data.fncollation,
+										  key1, key2));
+}
+
+/*
+ * build_saop_hash_table
+ *
+ * Load the non-null elements of the array into a hash table, for a
+ * ScalarArrayOpExpr the planner marked with a hashfuncid.  Everything,
+ * including the detoasted array the keys point into, lives in tablecxt,
+ * which must last as long as the expression state does.
+ */
+static void
+build_saop_hash_table(ScalarArrayOpExprState *sstate, Datum arraydatum,
+					  MemoryContext tablecxt)
+{
+	ScalarArrayOpExpr *opexpr = (ScalarArrayOpExpr *) sstate->fxprstate.xprstate.expr;
+	Oid			eqfuncid;
+	AclResult	aclresult;
+	MemoryContext oldcontext;
+	ArrayType  *arr;
+	int			nitems;
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	char	   *s;
+	bits8	   *bitmap;
+	int			bitmask;
+	int			i;
+
+	/* For ALL, the table is probed with the operator's negator */
+	eqfuncid = OidIsValid(opexpr->negfuncid) ? opexpr->negfuncid :
+		opexpr->opfuncid;
+
+	/* Check permission to call the additional functions */
+	aclresult = pg_proc_aclcheck(opexpr->hashfuncid, GetUserId(), ACL_EXECUTE);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, ACL_KIND_PROC,
+					   get_func_name(opexpr->hashfuncid));
+	InvokeFunctionExecuteHook(opexpr->hashfuncid);
+	if (eqfuncid != opexpr->opfuncid)
+	{
+		aclresult = pg_proc_aclcheck(eqfuncid, GetUserId(), ACL_EXECUTE);
+		if (aclresult != ACLCHECK_OK)
+			aclcheck_error(aclresult, ACL_KIND_PROC, get_func_name(eqfuncid));
+		InvokeFunctionExecuteHook(eqfuncid);
+	}
+
+	fmgr_info_cxt(opexpr->hashfuncid, &sstate->hash_finfo, tablecxt);
+	fmgr_info_cxt(eqfuncid, &sstate->eq_finfo, tablecxt);
+	fmgr_info_set_expr((Node *) opexpr, &sstate->hash_finfo);
+	fmgr_info_set_expr((Node *) opexpr, &sstate->eq_finfo);
+
+	oldcontext = MemoryContextSwitchTo(tablecxt);
+
+	arr = DatumGetArrayTypeP(arraydatum);
+	nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
+
+	get_typlenbyvalalign(ARR_ELEMTYPE(arr), &typlen, &typbyval, &typalign);
+
+	sstate->elements_tab = saophash_create(tablecxt, nitems, sstate);
+	sstate->has_nulls = false;
+
+	s = (char *) ARR_DATA_PTR(arr);
+	bitmap = ARR_NULLBITMAP(arr);
+	bitmask = 1;
+
+	for (i = 0; i < nitems; i++)
+	{
+		if (bitmap && (*bitmap & bitmask) == 0)
+			sstate->has_nulls = true;
+		else
+		{
+			Datum		elt;
+			bool		found;
+
+			elt = fetch_att(s, typbyval, typlen);
+			s = att_addlength_pointer(s, typlen, s);
+			s = (char *) att_align_nominal(s, typalign);
+			saophash_insert(sstate->elements_tab, elt, &found);
+		}
+
+		/* advance bitmap pointer if any */
+		if (bitmap)
+		{
+			bitmask <<= 1;
+			if (bitmask == 0x100)
+			{
+				bitmap++;
+				bitmask = 1;
+			}
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
 /*
  * ExecEvalScalarArrayOp
  *
@@ -2524,6 +2672,10 @@ ExecEvalDistinct(FuncExprState *fcache,
  * and we combine the results across all array elements using OR and AND
  * (for ANY and ALL respectively).  Of course we short-circuit as soon as
  * the result is known.
+ *
+ * If the planner supplied a hashfuncid, the array is a constant whose
+ * elements we load into a hash table on first use; each call is then a
+ * single probe instead of a scan of the array.
  */
 static Datum
 ExecEvalScalarArrayOp(ScalarArrayOpExprState *sstate,
@@ -2604,6 +2756,27 @@ ExecEvalScalarArrayOp(ScalarArrayOpExprState *sstate,
 		return (Datum) 0;
 	}
 
+	/*
+	 * Use the hash table if the planner asked for one.  It only does so for
+	 * strict operators, so a NULL element can't equal the scalar; it merely
+	 * makes the result NULL rather than "not found".
+	 */
+	if (OidIsValid(opexpr->hashfuncid))
+	{
+		if (sstate->elements_tab == NULL)
+			build_saop_hash_table(sstate, fcinfo->arg[1],
+								  econtext->ecxt_per_query_memory);
+
+		if (saophash_lookup(sstate->elements_tab, fcinfo->arg[0]) != NULL)
+			return BoolGetDatum(useOr);
+		if (sstate->has_nulls)
+		{
+			*isNull = true;
+			return (Datum) 0;
+		}
+		return BoolGetDatum(!useOr);
+	}
+
 	/*
 	 * We arrange to look up info about the element type only once per series
 	 * of calls, assuming the element type doesn't change underneath us.
@@ -4667,6 +4840,7 @@ ExecInitExpr(Expr *node, PlanState *parent)
 					ExecInitExpr((Expr *) opexpr->args, parent);
 				sstate->fxprstate.func.fn_oid = InvalidOid;		/* not initialized */
 				sstate->element_type = InvalidOid;		/* ditto */
+				sstate->elements_tab = NULL;	/* built on first use */
 				state = (ExprState *) sstate;
 			}
 			break;
@@ -117,7 +117,23 @@
  *	  sensitive to the grouping set for which the aggregate function is
  *	  currently being called.
  *
- *	  TODO: AGG_HASHED doesn't support multiple grouping sets yet.
+ *	  AGG_HASHED supports grouping sets by giving each set a phase of its
+ *	  own, with its own hash table; the tables are all filled during a single
+ *	  pass over the input, and then read out one after another.  Spilling to
+ *	  disk is only done when there is a single hash table.
+ *
+ *	  Spilling:
+ *
+ *	  The planner picks AGG_HASHED when it thinks the groups will fit in
+ *	  work_mem, but its estimate of the number of groups can be far off.  So
+ *	  while filling the hash table we keep track of the memory it uses, and
+ *	  once that exceeds work_mem we stop creating groups.  Input tuples that
+ *	  belong to groups already in the table are still aggregated as usual; the
+ *	  rest are written out to temp files, partitioned by some bits of their
+ *	  hash value.  When the groups in memory have all been returned, the table
+ *	  is emptied and refilled from each partition in turn, which may spill
+ *	  again using the next bits of the hash.  Every partition read creates at
+ *	  least one group before it can spill, so this always terminates.
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -134,6 +150,8 @@
 #include "catalog/objectaccess.h"
 #include "catalog/pg_aggregate.h"
 #include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
 #include "miscadmin.h"
@@ -142,6 +160,8 @@
 #include "optimizer/tlist.h"
 #include "parser/parse_agg.h"
 #include "parser/parse_coerce.h"
+#include "parser/parsetree.h"
+#include "storage/buffile.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -288,6 +308,14 @@ typedef struct AggStatePerAggData
 	 * worth the extra space consumption.
 	 */
 	FunctionCallInfoData transfn_fcinfo;
+
+	/*
+	 * In batch mode (aggstate->batchscan != NULL), the vectorized kernel
+	 * replacing the transfn, and the batch column holding the aggregated
+	 * input (unused for count(*)).
+	 */
+	BatchAggKind batchkind;
+	int			batchcol;
 }	AggStatePerAggData;
 
 /*
@@ -332,6 +360,10 @@ typedef struct AggStatePerGroupData
  *
  * Accordingly, each phase specifies a list of grouping sets and group clause
  * information, plus each phase after the first also has a sort order.
+ *
+ * In AGG_HASHED mode there is no re-sorting: every phase has exactly one
+ * grouping set and a hash table of its own, and all the tables are filled
+ * from the same pass over the input.
  */
 typedef struct AggStatePerPhaseData
 {
@@ -341,6 +373,11 @@ typedef struct AggStatePerPhaseData
 	FmgrInfo   *eqfunctions;	/* per-grouping-field equality fns */
 	Agg		   *aggnode;		/* Agg node for phase data */
 	Sort	   *sortnode;		/* Sort node for input ordering for phase */
+	/* these fields are used in AGG_HASHED mode only: */
+	TupleHashTable hashtable;	/* hash table with one entry per group */
+	TupleTableSlot *hashslot;	/* slot for loading hash table */
+	List	   *hash_needed;	/* list of columns needed in hash table */
+	FmgrInfo   *hashfunctions;	/* per-grouping-field hash fns */
 }	AggStatePerPhaseData;
 
 /*
@@ -390,14 +427,45 @@ static TupleTableSlot *project_aggregates(AggState *aggstate);
 static Bitmapset *find_unaggregated_cols(AggState *aggstate);
 static bool find_unaggregated_cols_walker(Node *node, Bitmapset **colnos);
 static void build_hash_table(AggState *aggstate);
+static void select_hash_phase(AggState *aggstate, int phase);
 static AggHashEntry lookup_hash_entry(AggState *aggstate,
 				  TupleTableSlot *inputslot);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
+static TupleTableSlot *agg_retrieve_batch(AggState *aggstate);
+static BatchScanState *agg_init_batch_mode(AggState *aggstate);
 static void agg_fill_hash_table(AggState *aggstate);
+static bool agg_hash_next_batch(AggState *aggstate);
+static uint32 hash_agg_hash_value(AggState *aggstate, TupleTableSlot *slot);
+static void hash_agg_check_limit(AggState *aggstate);
+static void hash_agg_spill_tuple(AggState *aggstate, TupleTableSlot *slot);
+static TupleTableSlot *hash_agg_read_spilled(AggState *aggstate);
+static void hash_agg_finish_spill(AggState *aggstate);
+static void hash_agg_reset_spill(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
 static Datum GetAggInitVal(Datum textInitVal, Oid transtype);
 
 
+/*
+ * Spilled hash aggregation input.  Each level of spilling partitions the
+ * tuples using the next HASHAGG_SPILL_BITS bits of their hash value, starting
+ * from the most significant end.
+ */
+#define HASHAGG_SPILL_BITS			4
+#define HASHAGG_SPILL_PARTITIONS	(1 << HASHAGG_SPILL_BITS)
+
+typedef struct HashAggSpill
+{
+	int			input_bits;		/* hash bits used up by earlier levels */
+	BufFile    *files[HASHAGG_SPILL_PARTITIONS];	/* NULL until used */
+} HashAggSpill;
+
+/* A partition written by some HashAggSpill, not yet reloaded */
+typedef struct HashAggBatch
+{
+	BufFile    *file;			/* its tuples, rewound for reading */
+	int			used_bits;		/* hash bits used to partition it */
+} HashAggBatch;
+
 /*
  * Switch to phase "newphase", which must either be 0 (to reset) or
  * current_phase + 1. Juggle the tuplesorts accordingly.
@@ -1301,24 +1369,49 @@ find_unaggregated_cols_walker(Node *node, Bitmapset **colnos)
 static void
 build_hash_table(AggState *aggstate)
 {
-	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
 	MemoryContext tmpmem = aggstate->tmpcontext->ecxt_per_tuple_memory;
 	Size		entrysize;
-
-	Assert(node->aggstrategy == AGG_HASHED);
-	Assert(node->numGroups > 0);
+	int			phase;
 
 	entrysize = offsetof(AggHashEntryData, pergroup) +
 		aggstate->numaggs * sizeof(AggStatePerGroupData);
 
-	aggstate->hashtable = BuildTupleHashTable(node->numCols,
-											  node->grpColIdx,
-											  aggstate->phase->eqfunctions,
-											  aggstate->hashfunctions,
-											  node->numGroups,
-											  entrysize,
+	for (phase = 0; phase < aggstate->numphases; phase++)
+	{
+		AggStatePerPhase phasedata = &aggstate->phases[phase];
+		Agg		   *node = phasedata->aggnode;
+
+		Assert(node->aggstrategy == AGG_HASHED);
+		Assert(node->numGroups > 0);
+
+		phasedata->hashtable = BuildTupleHashTable(node->numCols,
+												   node->grpColIdx,
+												   phasedata->eqfunctions,
+												   phasedata->hashfunctions,
+												   node->numGroups,
+												   entrysize,
 							 aggstate->aggcontexts[0]->ecxt_per_tuple_memory,
-											  tmpmem);
+												   tmpmem);
+	}
+
+	select_hash_phase(aggstate, 0);
+}
+
+/*
+ * Make the given phase's hash table the current one, for lookup_hash_entry
+ * and for reading out groups.
+ */
+static void
+select_hash_phase(AggState *aggstate, int phase)
+{
+	AggStatePerPhase phasedata = &aggstate->phases[phase];
+
+	aggstate->current_phase = phase;
+	aggstate->phase = phasedata;
+	aggstate->hashtable = phasedata->hashtable;
+	aggstate->hashslot = phasedata->hashslot;
+	aggstate->hash_needed = phasedata->hash_needed;
+	aggstate->hashfunctions = phasedata->hashfunctions;
 }
 
 /*
@@ -1347,9 +1440,8 @@ build_hash_table(AggState *aggstate)
  * haven't been explicitly grouped by.
  */
 static List *
-find_hash_columns(AggState *aggstate)
+find_hash_columns(AggState *aggstate, Agg *node)
 {
-	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
 	Bitmapset  *colnos;
 	List	   *collist;
 	int			i;
@@ -1383,14 +1475,15 @@ hash_agg_entry_size(int numAggs)
 	entrysize = offsetof(AggHashEntryData, pergroup) +
 		numAggs * sizeof(AggStatePerGroupData);
 	entrysize = MAXALIGN(entrysize);
-	/* Account for hashtable overhead (assuming fill factor = 1) */
+	/* Account for hashtable overhead (the bucket, at a typical fill factor) */
 	entrysize += 3 * sizeof(void *);
 	return entrysize;
 }
 
 /*
  * Find or create a hashtable entry for the tuple group containing the
- * given tuple.
+ * given tuple.  Returns NULL if there is no such group and it couldn't be
+ * created because we are spilling.
  *
  * When called, CurrentMemoryContext should be the per-query context.
  */
@@ -1420,15 +1513,21 @@ lookup_hash_entry(AggState *aggstate, TupleTableSlot *inputslot)
 		hashslot->tts_isnull[varNumber] = inputslot->tts_isnull[varNumber];
 	}
 
-	/* find or create the hashtable entry using the filtered tuple */
+	/*
+	 * find or create the hashtable entry using the filtered tuple; but once
+	 * we're spilling, only look for existing entries
+	 */
 	entry = (AggHashEntry) LookupTupleHashEntry(aggstate->hashtable,
 												hashslot,
-												&isnew);
+									aggstate->hash_spill ? NULL : &isnew);
 
-	if (isnew)
+	if (entry != NULL && aggstate->hash_spill == NULL && isnew)
 	{
 		/* initialize aggregates for new tuple group */
 		initialize_aggregates(aggstate, aggstate->peragg, entry->pergroup, 0);
+
+		/* and see if that leaves us room for more */
+		hash_agg_check_limit(aggstate);
 	}
 
 	return entry;
@@ -1484,7 +1583,10 @@ ExecAgg(AggState *node)
 				result = agg_retrieve_hash_table(node);
 				break;
 			default:
-				result = agg_retrieve_direct(node);
+				if (node->batchscan != NULL)
+					result = agg_retrieve_batch(node);
+				else
+					result = agg_retrieve_direct(node);
 				break;
 		}
 
@@ -1816,6 +1918,65 @@ agg_retrieve_direct(AggState *aggstate)
 	return NULL;
 }
 
+/*
+ * ExecAgg for plain aggregation in batch mode
+ *
+ * This is the AGG_PLAIN, no-grouping-sets case of agg_retrieve_direct, but
+ * instead of pulling single tuples from the outer plan we pull batches of
+ * qualifying tuples straight from the underlying SeqScan and advance every
+ * aggregate over each batch with its vectorized kernel.
+ */
+static TupleTableSlot *
+agg_retrieve_batch(AggState *aggstate)
+{
+	ExprContext *econtext = aggstate->ss.ps.ps_ExprContext;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	AggStatePerAgg peragg = aggstate->peragg;
+	AggStatePerGroup pergroup = aggstate->pergroup;
+	TupleTableSlot *firstSlot = aggstate->ss.ss_ScanTupleSlot;
+	TupleBatch *batch;
+	int			aggno;
+
+	ReScanExprContext(econtext);
+	ReScanExprContext(aggstate->aggcontexts[0]);
+
+	/* ExecProcNode would do this for us, but we don't go through it */
+	if (outerstate->chgParam != NULL)
+		ExecReScan(outerstate);
+
+	aggstate->current_set = 0;
+	initialize_aggregates(aggstate, peragg, pergroup, 0);
+
+	while ((batch = ExecSeqScanBatch(aggstate->batchscan)) != NULL)
+	{
+		for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+		{
+			AggStatePerAgg peraggstate = &peragg[aggno];
+			AggStatePerGroup pergroupstate = &pergroup[aggno];
+
+			ExecBatchAdvanceAggregate(peraggstate->batchkind, batch,
+									  peraggstate->batchcol,
+									  &pergroupstate->transValue,
+									  &pergroupstate->transValueIsNull,
+									  &pergroupstate->noTransValue);
+		}
+	}
+
+	aggstate->agg_done = true;
+
+	/*
+	 * As in agg_retrieve_direct with no input rows: an ungrouped Agg can't
+	 * reference non-aggregated input columns, so an empty slot will do.
+	 */
+	econtext->ecxt_outertuple = ExecClearTuple(firstSlot);
+
+	prepare_projection_slot(aggstate, econtext->ecxt_outertuple, 0);
+
+	finalize_aggregates(aggstate, peragg, pergroup, 0);
+
+	return project_aggregates(aggstate);
+}
+
 /*
  * ExecAgg for hashed case: phase 1, read input and build hash table
  */
@@ -1839,22 +2000,89 @@ agg_fill_hash_table(AggState *aggstate)
 	 */
 	for (;;)
 	{
-		outerslot = fetch_input_tuple(aggstate);
+		if (aggstate->hash_input_file != NULL)
+			outerslot = hash_agg_read_spilled(aggstate);
+		else
+			outerslot = fetch_input_tuple(aggstate);
 		if (TupIsNull(outerslot))
 			break;
 		/* set up for advance_aggregates call */
 		tmpcontext->ecxt_outertuple = outerslot;
 
-		/* Find or build hashtable entry for this tuple's group */
-		entry = lookup_hash_entry(aggstate, outerslot);
+		if (aggstate->numphases > 1)
+		{
+			int			phase;
 
-		/* Advance the aggregates */
-		advance_aggregates(aggstate, entry->pergroup);
+			/* Each grouping set has its own hash table */
+			for (phase = 0; phase < aggstate->numphases; phase++)
+			{
+				select_hash_phase(aggstate, phase);
+				entry = lookup_hash_entry(aggstate, outerslot);
+				advance_aggregates(aggstate, entry->pergroup);
+			}
+		}
+		else
+		{
+			/* Find or build hashtable entry for this tuple's group */
+			entry = lookup_hash_entry(aggstate, outerslot);
+
+			if (entry != NULL)
+			{
+				/* Advance the aggregates */
+				advance_aggregates(aggstate, entry->pergroup);
+			}
+			else
+			{
+				/* No room for its group, so save it for a later batch */
+				hash_agg_spill_tuple(aggstate, outerslot);
+			}
+		}
 
 		/* Reset per-input-tuple context after each tuple */
 		ResetExprContext(tmpcontext);
 	}
 
+	if (aggstate->numphases > 1)
+	{
+		int			phase;
+
+		/*
+		 * An empty grouping set produces a row even if there was no input, so
+		 * make sure its hash table has its one group.
+		 */
+		for (phase = 0; phase < aggstate->numphases; phase++)
+		{
+			select_hash_phase(aggstate, phase);
+			if (aggstate->phase->aggnode->numCols == 0 &&
+				aggstate->hashtable->hashtab->members == 0)
+			{
+				TupleTableSlot *nullslot = aggstate->hashslot;
+				bool		isnew;
+
+				if (nullslot->tts_tupleDescriptor == NULL)
+					ExecSetSlotDescriptor(nullslot,
+							   ExecGetResultType(outerPlanState(aggstate)));
+				ExecStoreAllNullTuple(nullslot);
+				entry = (AggHashEntry) LookupTupleHashEntry(aggstate->hashtable,
+															nullslot,
+															&isnew);
+				initialize_aggregates(aggstate, aggstate->peragg,
+									  entry->pergroup, 0);
+			}
+		}
+		select_hash_phase(aggstate, 0);
+	}
+
+	/* We're done with what we read, and must finish what we wrote */
+	if (aggstate->hash_input_file != NULL)
+	{
+		BufFileClose(aggstate->hash_input_file);
+		aggstate->hash_input_file = NULL;
+	}
+	if (aggstate->hash_spill != NULL)
+		hash_agg_finish_spill(aggstate);
+	aggstate->hash_batches_used++;
+
 	aggstate->table_filled = true;
 	/* Initialize to walk the hash table */
 	ResetTupleHashIterator(aggstate->hashtable, &aggstate->hashiter);
@@ -1890,10 +2118,24 @@ agg_retrieve_hash_table(AggState *aggstate)
 		/*
 		 * Find the next entry in the hash table
 		 */
-		entry = (AggHashEntry) ScanTupleHashTable(&aggstate->hashiter);
+		entry = (AggHashEntry) ScanTupleHashTable(aggstate->hashtable,
+												   &aggstate->hashiter);
 		if (entry == NULL)
 		{
-			/* No more entries in hashtable, so done */
+			/* No more entries in hashtable; try the next grouping set's */
+			if (aggstate->current_phase < aggstate->numphases - 1)
+			{
+				select_hash_phase(aggstate, aggstate->current_phase + 1);
+				ResetTupleHashIterator(aggstate->hashtable,
+									   &aggstate->hashiter);
+				continue;
+			}
+
+			/* or the next spilled batch */
+			if (agg_hash_next_batch(aggstate))
+				continue;
+
+			/* No more batches either, so done */
 			aggstate->agg_done = TRUE;
 			return NULL;
 		}
@@ -1915,6 +2157,9 @@ agg_retrieve_hash_table(AggState *aggstate)
 							  firstSlot,
 							  false);
 
+		/* null out the columns this grouping set doesn't group by */
+		prepare_projection_slot(aggstate, firstSlot, 0);
+
 		pergroup = entry->pergroup;
 
 		finalize_aggregates(aggstate, peragg, pergroup, 0);
@@ -1934,6 +2179,264 @@ agg_retrieve_hash_table(AggState *aggstate)
 	return NULL;
 }
 
+/*
+ * Start on the next spilled batch of a hashed aggregation, if there is one:
+ * empty the hash table and refill it from the batch's file.
+ */
+static bool
+agg_hash_next_batch(AggState *aggstate)
+{
+	HashAggBatch *batch;
+
+	if (aggstate->hash_batches == NIL)
+		return false;
+
+	batch = (HashAggBatch *) linitial(aggstate->hash_batches);
+	aggstate->hash_batches = list_delete_first(aggstate->hash_batches);
+
+	/*
+	 * The groups returned so far are finished, so throw them away.  We must
+	 * rescan rather than reset, to fire any shutdown callbacks.
+	 */
+	ReScanExprContext(aggstate->aggcontexts[0]);
+	build_hash_table(aggstate);
+
+	aggstate->hash_input_file = batch->file;
+	aggstate->hash_input_bits = batch->used_bits;
+	pfree(batch);
+
+	agg_fill_hash_table(aggstate);
+
+	return true;
+}
+
+/*
+ * Compute the hash of a tuple's grouping columns, for partitioning spilled
+ * tuples.  This combines the per-column hash functions the same way the
+ * hash table itself does.
+ */
+static uint32
+hash_agg_hash_value(AggState *aggstate, TupleTableSlot *slot)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	MemoryContext oldContext;
+	uint32		hashkey = 0;
+	int			i;
+
+	/* the hash functions might leak */
+	oldContext = MemoryContextSwitchTo(aggstate->tmpcontext->ecxt_per_tuple_memory);
+
+	for (i = 0; i < node->numCols; i++)
+	{
+		Datum		attr;
+		bool		isNull;
+
+		/* rotate hashkey left 1 bit at each step */
+		hashkey = (hashkey << 1) | ((hashkey & 0x80000000) ? 1 : 0);
+
+		attr = slot_getattr(slot, node->grpColIdx[i], &isNull);
+
+		if (!isNull)			/* treat nulls as having hash key 0 */
+		{
+			uint32		hkey;
+
+			hkey = DatumGetUInt32(FunctionCall1(&aggstate->hashfunctions[i],
+												attr));
+			hashkey ^= hkey;
+		}
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	return hashkey;
+}
+
+/*
+ * Called after creating a new group: if the hash table has outgrown
+ * work_mem, stop creating groups and spill their tuples instead.
+ *
+ * Transition values that keep growing after their group is created (as
+ * array_agg's do) are only noticed when the next group is created.
+ */
+static void
+hash_agg_check_limit(AggState *aggstate)
+{
+	Size		mem;
+
+	mem = MemoryContextMemAllocated(aggstate->aggcontexts[0]->ecxt_per_tuple_memory,
+									true);
+	if (mem > aggstate->hash_mem_peak)
+		aggstate->hash_mem_peak = mem;
+
+	if (mem <= aggstate->hash_mem_limit)
+		return;
+
+	/* Spilling can't cope with more than one hash table */
+	if (aggstate->numphases > 1)
+		return;
+
+	/*
+	 * Once the hash bits are used up, partitioning further would be useless,
+	 * so just carry on in memory.
+	 */
+	if (aggstate->hash_input_bits + HASHAGG_SPILL_BITS > 32)
+		return;
+
+	aggstate->hash_spill = (HashAggSpill *)
+		MemoryContextAllocZero(aggstate->ss.ps.state->es_query_cxt,
+							   sizeof(HashAggSpill));
+	aggstate->hash_spill->input_bits = aggstate->hash_input_bits;
+}
+
+/*
+ * Write an input tuple whose group isn't in the hash table to the spill
+ * partition selected by its hash value.
+ */
+static void
+hash_agg_spill_tuple(AggState *aggstate, TupleTableSlot *slot)
+{
+	HashAggSpill *spill = aggstate->hash_spill;
+	MinimalTuple tuple;
+	uint32		hashvalue;
+	int			partition;
+	BufFile    *file;
+
+	hashvalue = hash_agg_hash_value(aggstate, slot);
+	partition = (hashvalue >> (32 - spill->input_bits - HASHAGG_SPILL_BITS)) &
+		(HASHAGG_SPILL_PARTITIONS - 1);
+
+	file = spill->files[partition];
+	if (file == NULL)
+	{
+		MemoryContext oldcxt;
+
+		/* the BufFile must outlive the hash table's memory */
+		oldcxt = MemoryContextSwitchTo(aggstate->ss.ps.state->es_query_cxt);
+		file = spill->files[partition] = BufFileCreateTemp(false);
+		MemoryContextSwitchTo(oldcxt);
+
+		/* we'll need to know how to read the tuples back */
+		if (aggstate->hash_spill_slot->tts_tupleDescriptor == NULL)
+			ExecSetSlotDescriptor(aggstate->hash_spill_slot,
+								  slot->tts_tupleDescriptor);
+	}
+
+	tuple = ExecFetchSlotMinimalTuple(slot);
+	if (BufFileWrite(file, (void *) tuple, tuple->t_len) != tuple->t_len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			 errmsg("could not write to hash-aggregate temporary file: %m")));
+}
+
+/*
+ * Read the next tuple of the batch being reloaded, or return NULL at the end
+ * of it.
+ */
+static TupleTableSlot *
+hash_agg_read_spilled(AggState *aggstate)
+{
+	BufFile    *file = aggstate->hash_input_file;
+	MinimalTuple tuple;
+	uint32		t_len;
+	size_t		nread;
+
+	nread = BufFileRead(file, (void *) &t_len, sizeof(uint32));
+	if (nread == 0)
+		return NULL;
+	if (nread != sizeof(uint32))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			errmsg("could not read from hash-aggregate temporary file: %m")));
+
+	tuple = (MinimalTuple) palloc(t_len);
+	tuple->t_len = t_len;
+	nread = BufFileRead(file,
+						(void *) ((char *) tuple + sizeof(uint32)),
+						t_len - sizeof(uint32));
+	if (nread != t_len - sizeof(uint32))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+			errmsg("could not read from hash-aggregate temporary file: %m")));
+
+	return ExecStoreMinimalTuple(tuple, aggstate->hash_spill_slot, true);
+}
+
+/*
+ * Queue up the partitions spilled into while filling the hash table.
+ */
+static void
+hash_agg_finish_spill(AggState *aggstate)
+{
+	HashAggSpill *spill = aggstate->hash_spill;
+	MemoryContext oldcxt;
+	int			i;
+
+	oldcxt = MemoryContextSwitchTo(aggstate->ss.ps.state->es_query_cxt);
+
+	for (i = 0; i < HASHAGG_SPILL_PARTITIONS; i++)
+	{
+		HashAggBatch *batch;
+
+		if (spill->files[i] == NULL)
+			continue;
+
+		if (BufFileSeek(spill->files[i], 0, 0L, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+			   errmsg("could not rewind hash-aggregate temporary file: %m")));
+
+		batch = (HashAggBatch *) palloc(sizeof(HashAggBatch));
+		batch->file = spill->files[i];
+		batch->used_bits = spill->input_bits + HASHAGG_SPILL_BITS;
+		aggstate->hash_batches = lappend(aggstate->hash_batches, batch);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	pfree(spill);
+	aggstate->hash_spill = NULL;
+}
+
+/*
+ * Throw away all spilled input, for rescan or shutdown.
+ */
+static void
+hash_agg_reset_spill(AggState *aggstate)
+{
+	ListCell   *lc;
+
+	if (aggstate->hash_spill != NULL)
+	{
+		int			i;
+
+		for (i = 0; i < HASHAGG_SPILL_PARTITIONS; i++)
+		{
+			if (aggstate->hash_spill->files[i] != NULL)
+				BufFileClose(aggstate->hash_spill->files[i]);
+		}
+		pfree(aggstate->hash_spill);
+		aggstate->hash_spill = NULL;
+	}
+
+	foreach(lc, aggstate->hash_batches)
+	{
+		HashAggBatch *batch = (HashAggBatch *) lfirst(lc);
+
+		BufFileClose(batch->file);
+		pfree(batch);
+	}
+	list_free(aggstate->hash_batches);
+	aggstate->hash_batches = NIL;
+
+	if (aggstate->hash_input_file != NULL)
+	{
+		BufFileClose(aggstate->hash_input_file);
+		aggstate->hash_input_file = NULL;
+	}
+	aggstate->hash_input_bits = 0;
+	aggstate->hash_batches_used = 0;
+}
+
 /* -----------------
  * ExecInitAgg
  *
@@ -1979,6 +2482,15 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	aggstate->curperagg = NULL;
 	aggstate->agg_done = false;
 	aggstate->input_done = false;
+	aggstate->hash_mem_limit = work_mem * 1024L;
+	aggstate->hash_spill = NULL;
+	aggstate->hash_batches = NIL;
+	aggstate->hash_input_file = NULL;
+	aggstate->hash_input_bits = 0;
+	aggstate->hash_batches_used = 0;
+	aggstate->hash_mem_peak = 0;
+	aggstate->combineStates = node->combineStates;
+	aggstate->finalizeAggs = node->finalizeAggs;
 	aggstate->pergroup = NULL;
 	aggstate->grp_firstTuple = NULL;
 	aggstate->hashtable = NULL;
@@ -1991,8 +2503,6 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	 */
 	if (node->groupingSets)
 	{
-		Assert(node->aggstrategy != AGG_HASHED);
-
 		numGroupingSets = list_length(node->groupingSets);
 
 		foreach(l, node->chain)
@@ -2039,7 +2549,7 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	 */
 	ExecInitScanTupleSlot(estate, &aggstate->ss);
 	ExecInitResultTupleSlot(estate, &aggstate->ss.ps);
-	aggstate->hashslot = ExecInitExtraTupleSlot(estate);
+	aggstate->hash_spill_slot = ExecInitExtraTupleSlot(estate);
 	aggstate->sort_slot = ExecInitExtraTupleSlot(estate);
 
 	/*
@@ -2116,7 +2626,14 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		Sort	   *sortnode;
 		int			num_sets;
 
-		if (phase > 0)
+		if (phase > 0 && node->aggstrategy == AGG_HASHED)
+		{
+			/* hashed grouping sets share the input, so there's no sort */
+			aggnode = list_nth(node->chain, phase - 1);
+			sortnode = NULL;
+			Assert(aggnode->aggstrategy == AGG_HASHED);
+		}
+		else if (phase > 0)
 		{
 			aggnode = list_nth(node->chain, phase - 1);
 			sortnode = (Sort *) aggnode->plan.lefttree;
@@ -2173,6 +2690,19 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 									   aggnode->grpOperators);
 		}
 
+		/*
+		 * If we are hashing, likewise for the hash table, which also needs a
+		 * slot of its own.
+		 */
+		if (aggnode->aggstrategy == AGG_HASHED)
+		{
+			execTuplesHashPrepare(aggnode->numCols,
+								  aggnode->grpOperators,
+								  &phasedata->eqfunctions,
+								  &phasedata->hashfunctions);
+			phasedata->hashslot = ExecInitExtraTupleSlot(estate);
+		}
+
 		phasedata->aggnode = aggnode;
 		phasedata->sortnode = sortnode;
 	}
@@ -2185,21 +2715,15 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		aggstate->all_grouped_cols = lcons_int(i, aggstate->all_grouped_cols);
 
 	/*
-	 * Hashing can only appear in the initial phase.
-	 */
-
-	if (node->aggstrategy == AGG_HASHED)
-		execTuplesHashPrepare(node->numCols,
-							  node->grpOperators,
-							  &aggstate->phases[0].eqfunctions,
-							  &aggstate->hashfunctions);
-
-	/*
-	 * Initialize current phase-dependent values to initial phase
+	 * Initialize current phase-dependent values to initial phase.  Hashed
+	 * phases have no tuplesorts to set up.
 	 */
 
 	aggstate->current_phase = 0;
-	initialize_phase(aggstate, 0);
+	if (node->aggstrategy == AGG_HASHED)
+		aggstate->phase = &aggstate->phases[0];
+	else
+		initialize_phase(aggstate, 0);
 
 	/*
 	 * Set up aggregate-result storage in the output expr context, and also
@@ -2214,10 +2738,12 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 
 	if (node->aggstrategy == AGG_HASHED)
 	{
+		/* Compute the columns we actually need to hash on */
+		for (phase = 0; phase < numPhases; phase++)
+			aggstate->phases[phase].hash_needed =
+				find_hash_columns(aggstate, aggstate->phases[phase].aggnode);
 		build_hash_table(aggstate);
 		aggstate->table_filled = false;
-		/* Compute the columns we actually need to hash on */
-		aggstate->hash_needed = find_hash_columns(aggstate);
 	}
 	else
 	{
@@ -2311,8 +2837,34 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 						   get_func_name(aggref->aggfnoid));
 		InvokeFunctionExecuteHook(aggref->aggfnoid);
 
-		peraggstate->transfn_oid = transfn_oid = aggform->aggtransfn;
-		peraggstate->finalfn_oid = finalfn_oid = aggform->aggfinalfn;
+		/*
+		 * When combining partial aggregates, the aggregate's single input is
+		 * a transition state produced by a lower partial Agg node, and the
+		 * combine function takes the place of the transition function.  When
+		 * not finalizing, the transition state itself is the result.
+		 */
+		if (aggstate->combineStates)
+		{
+			transfn_oid = aggform->aggcombinefn;
+			if (!OidIsValid(transfn_oid))
+				elog(ERROR, "combinefn not set for aggregate function %u",
+					 aggref->aggfnoid);
+			if (AGGKIND_IS_ORDERED_SET(aggref->aggkind) ||
+				aggref->aggdistinct != NIL || aggref->aggorder != NIL ||
+				list_length(aggref->args) != 1 ||
+				IsPolymorphicType(aggform->aggtranstype))
+				elog(ERROR, "cannot combine transition states of aggregate function %u",
+					 aggref->aggfnoid);
+		}
+		else
+			transfn_oid = aggform->aggtransfn;
+		peraggstate->transfn_oid = transfn_oid;
+
+		if (aggstate->finalizeAggs)
+			finalfn_oid = aggform->aggfinalfn;
+		else
+			finalfn_oid = InvalidOid;
+		peraggstate->finalfn_oid = finalfn_oid;
 
 		/* Check that aggregate owner has permission to call component fns */
 		{
@@ -2349,7 +2901,13 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		 * could be different from the agg's declared input types, when the
 		 * agg accepts ANY or a polymorphic type.
 		 */
-		numArguments = get_aggregate_argtypes(aggref, inputTypes);
+		if (aggstate->combineStates)
+		{
+			inputTypes[0] = aggform->aggtranstype;
+			numArguments = 1;
+		}
+		else
+			numArguments = get_aggregate_argtypes(aggref, inputTypes);
 		peraggstate->numArguments = numArguments;
 
 		/* Count the "direct" arguments, if any */
@@ -2412,7 +2970,7 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 								 (void *) aggstate, NULL);
 
 		/* get info about relevant datatypes */
-		get_typlenbyval(aggref->aggtype,
+		get_typlenbyval(aggstate->finalizeAggs ? aggref->aggtype : aggtranstype,
 						&peraggstate->resulttypeLen,
 						&peraggstate->resulttypeByVal);
 		get_typlenbyval(aggtranstype,
@@ -2577,9 +3135,123 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	/* Update numaggs to match number of unique aggregates found */
 	aggstate->numaggs = aggno + 1;
 
+	/*
+	 * See whether we can consume the input in batches rather than one tuple
+	 * at a time.
+	 */
+	if (enable_batch_execution)
+		aggstate->batchscan = agg_init_batch_mode(aggstate);
+
 	return aggstate;
 }
 
+/*
+ * agg_init_batch_mode
+ *		Set up batch-at-a-time input for an Agg node, if possible.
+ *
+ * This works only for a plain, ungrouped Agg directly above a SeqScan whose
+ * targetlist consists of plain Vars, when every aggregate is a simple call
+ * on a single column (or count(*)) that execBatch.c has a kernel for.
+ * Returns NULL if anything doesn't fit, and then we use the row path.
+ */
+static BatchScanState *
+agg_init_batch_mode(AggState *aggstate)
+{
+	Agg		   *node = (Agg *) aggstate->ss.ps.plan;
+	PlanState  *outerstate = outerPlanState(aggstate);
+	AttrNumber *scanattnos;
+	Bitmapset  *attnums = NULL;
+	BatchScanState *bstate;
+	ListCell   *lc;
+	int			aggno;
+
+	if (node->aggstrategy != AGG_PLAIN || aggstate->numphases != 1 ||
+		aggstate->phase->numsets > 0 || aggstate->numaggs == 0)
+		return NULL;
+	if (aggstate->combineStates || !aggstate->finalizeAggs)
+		return NULL;
+	if (!IsA(outerstate->plan, SeqScan))
+		return NULL;
+
+	/*
+	 * We read the scan tuple directly, bypassing the SeqScan's projection, so
+	 * insist that the projection couldn't have any side-effects.
+	 */
+	foreach(lc, outerstate->plan->targetlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (!IsA(tle->expr, Var) || ((Var *) tle->expr)->varattno <= 0)
+			return NULL;
+	}
+
+	scanattnos = (AttrNumber *) palloc0(aggstate->numaggs * sizeof(AttrNumber));
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+		Aggref	   *aggref = peraggstate->aggref;
+		bool		inputByVal = true;
+
+		if (aggref->aggfilter != NULL || aggref->aggdirectargs != NIL ||
+			AGGKIND_IS_ORDERED_SET(aggref->aggkind) ||
+			peraggstate->numSortCols > 0 ||
+			peraggstate->numTransInputs > 1)
+			return NULL;
+
+		if (peraggstate->numTransInputs == 1)
+		{
+			TargetEntry *argtle = (TargetEntry *) linitial(aggref->args);
+			Var		   *argvar = (Var *) argtle->expr;
+			TargetEntry *outertle;
+			Var		   *scanvar;
+
+			if (!IsA(argvar, Var) || argvar->varno != OUTER_VAR)
+				return NULL;
+			outertle = get_tle_by_resno(outerstate->plan->targetlist,
+										argvar->varattno);
+			if (outertle == NULL)
+				return NULL;
+			scanvar = (Var *) outertle->expr;
+			scanattnos[aggno] = scanvar->varattno;
+			inputByVal = get_typbyval(scanvar->vartype);
+		}
+
+		peraggstate->batchkind = ExecBatchAggKind(peraggstate->transfn_oid,
+												  inputByVal,
+												  peraggstate->transtypeByVal);
+		if (peraggstate->batchkind == BATCH_AGG_NONE)
+			return NULL;
+		/* count(*) is the only kernel that takes no input column */
+		if ((peraggstate->batchkind == BATCH_AGG_COUNT_STAR) !=
+			(peraggstate->numTransInputs == 0))
+			return NULL;
+
+		if (scanattnos[aggno] > 0)
+			attnums = bms_add_member(attnums, scanattnos[aggno]);
+	}
+
+	bstate = ExecInitBatchScan((ScanState *) outerstate, attnums);
+	if (bstate == NULL)
+		return NULL;
+
+	for (aggno = 0; aggno < aggstate->numaggs; aggno++)
+	{
+		AggStatePerAgg peraggstate = &aggstate->peragg[aggno];
+
+		if (scanattnos[aggno] > 0)
+			peraggstate->batchcol = ExecBatchScanColumn(bstate,
+														scanattnos[aggno]);
+		else
+			peraggstate->batchcol = -1;
+	}
+
+	pfree(scanattnos);
+	bms_free(attnums);
+
+	return bstate;
+}
+
 static Datum
 GetAggInitVal(Datum textInitVal, Oid transtype)
 {
@@ -2622,6 +3294,9 @@ ExecEndAgg(AggState *node)
 		}
 	}
 
+	/* Close any temp files left over from spilling */
+	hash_agg_reset_spill(node);
+
 	/* And ensure any agg shutdown callbacks have been called */
 	for (setno = 0; setno < numGroupingSets; setno++)
 		ReScanExprContext(node->aggcontexts[setno]);
@@ -2636,6 +3311,9 @@ ExecEndAgg(AggState *node)
 	/* clean up tuple table */
 	ExecClearTuple(node->ss.ss_ScanTupleSlot);
 
+	if (node->batchscan)
+		ExecEndBatchScan(node->batchscan);
+
 	outerPlan = outerPlanState(node);
 	ExecEndNode(outerPlan);
 }
@@ -2668,13 +3346,17 @@ ExecReScanAgg(AggState *node)
 		/*
 		 * If we do have the hash table and the subplan does not have any
 		 * parameter changes, then we can just rescan the existing hash table;
-		 * no need to build it again.
+		 * no need to build it again.  That doesn't work if we spilled, since
+		 * the table then holds only the last batch's groups.
 		 */
-		if (outerPlan->chgParam == NULL)
+		if (outerPlan->chgParam == NULL && node->hash_batches_used == 1)
 		{
+			select_hash_phase(node, 0);
 			ResetTupleHashIterator(node->hashtable, &node->hashiter);
 			return;
 		}
+
+		hash_agg_reset_spill(node);
 	}
 
 	/* Make sure we have closed any open tuplesorts */
@@ -2738,6 +3420,9 @@ ExecReScanAgg(AggState *node)
 		/* reset to phase 0 */
 		initialize_phase(node, 0);
 
+		if (node->batchscan)
+			ExecReScanBatchScan(node->batchscan);
+
 		node->input_done = false;
 		node->projected_set = -1;
 	}
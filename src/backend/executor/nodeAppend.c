@@ -53,14 +53,32 @@
  *			  nil	nil		 Scan	 Scan	  Scan	   Scan
  *							  |		  |		   |		|
  *							person employee student student-emp
+ *
+ *		When some of the subplans are foreign scans whose FDW supports
+ *		asynchronous execution (typically remote partitions of a sharded
+ *		table), running them strictly one after another would make the
+ *		total latency the sum of all their remote round trips.  Instead we
+ *		ask all of them to start fetching at once, and return tuples from
+ *		whichever subplan has some ready, waiting only when none has.  The
+ *		order in which subplans' tuples appear is then unpredictable, which
+ *		is fine since Append promises no ordering anyway.
+ *
+ *		If the planner left run-time pruning info in the Append, subplans
+ *		that the current parameter values prove to return no rows are
+ *		skipped; see execPrune.c.
  */
 
 #include "postgres.h"
 
 #include "executor/execdebug.h"
 #include "executor/nodeAppend.h"
+#include "executor/nodeForeignscan.h"
+#include "foreign/fdwapi.h"
 
 static bool exec_append_initialize_next(AppendState *appendstate);
+static TupleTableSlot *exec_append_async(AppendState *node);
+static bool exec_append_async_choose(AppendState *node);
+static void exec_append_prune(AppendState *node);
 
 
 /* ----------------------------------------------------------------
@@ -121,6 +139,7 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 {
 	AppendState *appendstate = makeNode(AppendState);
 	PlanState **appendplanstates;
+	List	   *subplans = node->appendplans;
 	int			nplans;
 	int			i;
 	ListCell   *lc;
@@ -128,10 +147,32 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 	/* check for unsupported flags */
 	Assert(!(eflags & EXEC_FLAG_MARK));
 
+	/*
+	 * If there's run-time pruning info, leave out the subplans that the
+	 * PARAM_EXTERN values already exclude.  We need an ExprContext to
+	 * evaluate the Params in.
+	 */
+	appendstate->as_nremoved = 0;
+	appendstate->as_prune_constraints = NULL;
+	appendstate->as_prune_clauses = NULL;
+	appendstate->as_valid = NULL;
+	appendstate->as_prune_pending = false;
+	if (node->prune_clauses != NIL)
+	{
+		ExecAssignExprContext(estate, &appendstate->ps);
+		subplans = ExecPruneSubplansAtInit(subplans,
+										   node->prune_constraints,
+										   node->prune_clauses,
+										   appendstate->ps.ps_ExprContext,
+										   &appendstate->as_prune_constraints,
+										   &appendstate->as_prune_clauses,
+										   &appendstate->as_nremoved);
+	}
+
 	/*
 	 * Set up empty vector of subplan states
 	 */
-	nplans = list_length(node->appendplans);
+	nplans = list_length(subplans);
 
 	appendplanstates = (PlanState **) palloc0(nplans * sizeof(PlanState *));
 
@@ -147,7 +188,7 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 	 * Miscellaneous initialization
 	 *
 	 * Append plans don't have expression contexts because they never call
-	 * ExecQual or ExecProject.
+	 * ExecQual or ExecProject, except for run-time pruning as above.
 	 */
 
 	/*
@@ -161,7 +202,7 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 	 * results into the array "appendplans".
 	 */
 	i = 0;
-	foreach(lc, node->appendplans)
+	foreach(lc, subplans)
 	{
 		Plan	   *initNode = (Plan *) lfirst(lc);
 
@@ -169,6 +210,55 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 		i++;
 	}
 
+	/*
+	 * The remaining subplans may still have to be pruned once PARAM_EXEC
+	 * values are known, at the start of each scan.
+	 */
+	for (i = 0; i < nplans; i++)
+	{
+		if (appendstate->as_prune_clauses != NULL &&
+			appendstate->as_prune_clauses[i] != NIL)
+		{
+			appendstate->as_valid = (bool *) palloc(nplans * sizeof(bool));
+			appendstate->as_prune_pending = true;
+			break;
+		}
+	}
+
+	/*
+	 * Look for async-capable subplans.  We can only run them out of order
+	 * when scanning forward, and there's no point during EvalPlanQual
+	 * rechecks, where foreign scans just return the test tuple.
+	 */
+	appendstate->as_async = false;
+	appendstate->as_asyncplans = NULL;
+	appendstate->as_finished = NULL;
+	if (!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_EXPLAIN_ONLY)) &&
+		estate->es_epqTuple == NULL)
+	{
+		bool	   *asyncplans = (bool *) palloc0(nplans * sizeof(bool));
+
+		for (i = 0; i < nplans; i++)
+		{
+			PlanState  *subnode = appendplanstates[i];
+
+			if (IsA(subnode, ForeignScanState) &&
+				((ForeignScanState *) subnode)->fdwroutine->ForeignAsyncRequest != NULL)
+			{
+				asyncplans[i] = true;
+				appendstate->as_async = true;
+			}
+		}
+
+		if (appendstate->as_async)
+		{
+			appendstate->as_asyncplans = asyncplans;
+			appendstate->as_finished = (bool *) palloc0(nplans * sizeof(bool));
+		}
+		else
+			pfree(asyncplans);
+	}
+
 	/*
 	 * initialize output tuple type
 	 */
@@ -193,29 +283,39 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 TupleTableSlot *
 ExecAppend(AppendState *node)
 {
+	if (node->as_prune_pending)
+		exec_append_prune(node);
+
+	if (node->as_async)
+		return exec_append_async(node);
+
 	for (;;)
 	{
-		PlanState  *subnode;
-		TupleTableSlot *result;
-
-		/*
-		 * figure out which subplan we are currently processing
-		 */
-		subnode = node->appendplans[node->as_whichplan];
+		/* skip subplans pruned for this scan */
+		if (node->as_valid == NULL || node->as_valid[node->as_whichplan])
+		{
+			PlanState  *subnode;
+			TupleTableSlot *result;
 
-		/*
-		 * get a tuple from the subplan
-		 */
-		result = ExecProcNode(subnode);
+			/*
+			 * figure out which subplan we are currently processing
+			 */
+			subnode = node->appendplans[node->as_whichplan];
 
-		if (!TupIsNull(result))
-		{
 			/*
-			 * If the subplan gave us something then return it as-is. We do
-			 * NOT make use of the result slot that was set up in
-			 * ExecInitAppend; there's no need for it.
+			 * get a tuple from the subplan
 			 */
-			return result;
+			result = ExecProcNode(subnode);
+
+			if (!TupIsNull(result))
+			{
+				/*
+				 * If the subplan gave us something then return it as-is. We
+				 * do NOT make use of the result slot that was set up in
+				 * ExecInitAppend; there's no need for it.
+				 */
+				return result;
+			}
 		}
 
 		/*
@@ -234,6 +334,147 @@ ExecAppend(AppendState *node)
 	}
 }
 
+/* ----------------------------------------------------------------
+ *		exec_append_async
+ *
+ *		ExecAppend for the case where some subplans are async-capable.
+ *		Subplans are taken in any order, but each runs to exhaustion
+ *		eventually; as_finished tracks which ones have done so.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+exec_append_async(AppendState *node)
+{
+	for (;;)
+	{
+		int			whichplan = node->as_whichplan;
+		PlanState  *subnode = node->appendplans[whichplan];
+		TupleTableSlot *result;
+
+		/* The current subplan may have been pruned for this scan */
+		if (node->as_finished[whichplan])
+		{
+			if (!exec_append_async_choose(node))
+				return ExecClearTuple(node->ps.ps_ResultTupleSlot);
+			continue;
+		}
+
+		/*
+		 * If the current subplan would have to wait for its remote server,
+		 * see whether some other subplan can go first.
+		 */
+		if (node->as_asyncplans[whichplan] && subnode->chgParam == NULL &&
+			!ExecForeignScanAsyncReady((ForeignScanState *) subnode))
+		{
+			(void) exec_append_async_choose(node);
+			subnode = node->appendplans[node->as_whichplan];
+		}
+
+		result = ExecProcNode(subnode);
+
+		if (!TupIsNull(result))
+			return result;
+
+		/* This subplan is done; pick the next one, if any are left */
+		node->as_finished[node->as_whichplan] = true;
+		if (!exec_append_async_choose(node))
+			return ExecClearTuple(node->ps.ps_ResultTupleSlot);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		exec_append_async_choose
+ *
+ *		Starts background fetches for all idle async-capable subplans,
+ *		then sets as_whichplan to an unfinished subplan, preferring one
+ *		that can return a tuple without waiting.  Subplans are considered
+ *		round-robin starting at the current one.
+ *
+ *		Returns false if all subplans are finished.
+ * ----------------------------------------------------------------
+ */
+static bool
+exec_append_async_choose(AppendState *node)
+{
+	int			nplans = node->as_nplans;
+	int			first = -1;
+	int			i;
+	int			k;
+
+	/*
+	 * Put every idle async-capable subplan to work.  Subplans with changed
+	 * parameters still have to be rescanned by ExecProcNode first.
+	 */
+	for (i = 0; i < nplans; i++)
+	{
+		PlanState  *subnode = node->appendplans[i];
+
+		if (node->as_finished[i] || !node->as_asyncplans[i] ||
+			subnode->chgParam != NULL)
+			continue;
+
+		(void) ExecForeignScanAsyncRequest((ForeignScanState *) subnode);
+	}
+
+	for (k = 0; k < nplans; k++)
+	{
+		PlanState  *subnode;
+
+		i = (node->as_whichplan + k) % nplans;
+		if (node->as_finished[i])
+			continue;
+
+		if (first < 0)
+			first = i;
+
+		subnode = node->appendplans[i];
+		if (!node->as_asyncplans[i] || subnode->chgParam != NULL ||
+			ExecForeignScanAsyncReady((ForeignScanState *) subnode))
+		{
+			node->as_whichplan = i;
+			return true;
+		}
+	}
+
+	if (first < 0)
+		return false;
+
+	/* Nobody is ready, so we'll have to wait for the first one */
+	node->as_whichplan = first;
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *		exec_append_prune
+ *
+ *		Works out which subplans need to be scanned with the current
+ *		parameter values.  In async mode, pruned subplans are simply
+ *		marked finished.
+ * ----------------------------------------------------------------
+ */
+static void
+exec_append_prune(AppendState *node)
+{
+	int			i;
+
+	ExecPruneSubplansAtScan(node->as_nplans,
+							node->as_prune_constraints,
+							node->as_prune_clauses,
+							node->ps.ps_ExprContext,
+							node->as_valid);
+
+	if (node->as_async)
+	{
+		for (i = 0; i < node->as_nplans; i++)
+		{
+			if (!node->as_valid[i])
+				node->as_finished[i] = true;
+		}
+	}
+
+	node->as_prune_pending = false;
+}
+
 /* ----------------------------------------------------------------
  *		ExecEndAppend
  *
@@ -255,6 +496,11 @@ ExecEndAppend(AppendState *node)
 	appendplans = node->appendplans;
 	nplans = node->as_nplans;
 
+	/*
+	 * Free the exprcontext, if we made one for run-time pruning
+	 */
+	ExecFreeExprContext(&node->ps);
+
 	/*
 	 * shut down each of the subscans
 	 */
@@ -285,6 +531,10 @@ ExecReScanAppend(AppendState *node)
 		if (subnode->chgParam == NULL)
 			ExecReScan(subnode);
 	}
+	if (node->as_async)
+		memset(node->as_finished, 0, node->as_nplans * sizeof(bool));
+	if (node->as_valid != NULL)
+		node->as_prune_pending = true;
 	node->as_whichplan = 0;
 	exec_append_initialize_next(node);
 }
@@ -42,14 +42,24 @@
 #include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/predicate.h"
+#include "storage/read_stream.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
 #include "utils/tqual.h"
 
 
+/* size of a TBMIterateResult with room for the offsets of any page */
+#define TBM_ITERATE_RESULT_SIZE \
+	(offsetof(TBMIterateResult, offsets) + \
+	 MaxHeapTuplesPerPage * sizeof(OffsetNumber))
+
 static TupleTableSlot *BitmapHeapNext(BitmapHeapScanState *node);
-static void bitgetpage(HeapScanDesc scan, TBMIterateResult *tbmres);
+static BlockNumber bitmap_stream_next_block(ReadStream *stream,
+						 void *callback_private_data,
+						 void *per_buffer_data);
+static void bitgetpage(HeapScanDesc scan, TBMIterateResult *tbmres,
+		   Buffer buffer);
 
 
 /* ----------------------------------------------------------------
@@ -64,7 +74,7 @@ BitmapHeapNext(BitmapHeapScanState *node)
 	ExprContext *econtext;
 	HeapScanDesc scan;
 	TIDBitmap  *tbm;
-	TBMIterator *tbmiterator;
+	ReadStream *stream;
 	TBMIterateResult *tbmres;
 
 #ifdef USE_PREFETCH
@@ -80,7 +90,7 @@ BitmapHeapNext(BitmapHeapScanState *node)
 	slot = node->ss.ss_ScanTupleSlot;
 	scan = node->ss.ss_currentScanDesc;
 	tbm = node->tbm;
-	tbmiterator = node->tbmiterator;
+	stream = node->stream;
 	tbmres = node->tbmres;
 #ifdef USE_PREFETCH
 	prefetch_iterator = node->prefetch_iterator;
@@ -88,7 +98,10 @@ BitmapHeapNext(BitmapHeapScanState *node)
 
 	/*
 	 * If we haven't yet performed the underlying index scan, do it, and begin
-	 * the iteration over the bitmap.
+	 * the iteration over the bitmap.  The pages are read through a read
+	 * stream, which runs the iterator some way ahead of us so as to read
+	 * consecutive pages together; it gives us a copy of the TBMIterateResult
+	 * of each page along with the page's buffer.
 	 *
 	 * For prefetching, we use *two* iterators, one for the pages we are
 	 * actually scanning and another that runs ahead of the first for
@@ -107,8 +120,13 @@ BitmapHeapNext(BitmapHeapScanState *node)
 			elog(ERROR, "unrecognized result from subplan");
 
 		node->tbm = tbm;
-		node->tbmiterator = tbmiterator = tbm_begin_iterate(tbm);
+		node->tbmiterator = tbm_begin_iterate(tbm);
 		node->tbmres = tbmres = NULL;
+		node->stream = stream =
+			read_stream_begin_relation(scan->rs_rd, MAIN_FORKNUM,
+									   scan->rs_strategy,
+									   bitmap_stream_next_block, node,
+									   TBM_ITERATE_RESULT_SIZE);
 
 #ifdef USE_PREFETCH
 		if (target_prefetch_pages > 0)
@@ -130,12 +148,16 @@ BitmapHeapNext(BitmapHeapScanState *node)
 		 */
 		if (tbmres == NULL)
 		{
-			node->tbmres = tbmres = tbm_iterate(tbmiterator);
-			if (tbmres == NULL)
+			Buffer		buffer;
+			void	   *per_buffer_data;
+
+			buffer = read_stream_next_buffer(stream, &per_buffer_data);
+			if (!BufferIsValid(buffer))
 			{
 				/* no more entries in the bitmap */
 				break;
 			}
+			node->tbmres = tbmres = (TBMIterateResult *) per_buffer_data;
 
 #ifdef USE_PREFETCH
 			if (node->prefetch_pages > 0)
@@ -146,7 +168,11 @@ BitmapHeapNext(BitmapHeapScanState *node)
 			else if (prefetch_iterator)
 			{
 				/* Do not let the prefetch iterator get behind the main one */
-				TBMIterateResult *tbmpre = tbm_iterate(prefetch_iterator);
+				TBMIterateResult *tbmpre;
+
+				do
+					tbmpre = tbm_iterate(prefetch_iterator);
+				while (tbmpre != NULL && tbmpre->blockno >= scan->rs_nblocks);
 
 				if (tbmpre == NULL || tbmpre->blockno != tbmres->blockno)
 					elog(ERROR, "prefetch and main iterators are out of sync");
@@ -154,21 +180,9 @@ BitmapHeapNext(BitmapHeapScanState *node)
 #endif   /* USE_PREFETCH */
 
 			/*
-			 * Ignore any claimed entries past what we think is the end of the
-			 * relation.  (This is probably not necessary given that we got at
-			 * least AccessShareLock on the table before performing any of the
-			 * indexscans, but let's be safe.)
-			 */
-			if (tbmres->blockno >= scan->rs_nblocks)
-			{
-				node->tbmres = tbmres = NULL;
-				continue;
-			}
-
-			/*
-			 * Fetch the current heap page and identify candidate tuples.
+			 * Identify candidate tuples on the current heap page.
 			 */
-			bitgetpage(scan, tbmres);
+			bitgetpage(scan, tbmres, buffer);
 
 			if (tbmres->ntuples >= 0)
 				node->exact_pages++;
@@ -247,6 +261,9 @@ BitmapHeapNext(BitmapHeapScanState *node)
 					node->prefetch_iterator = prefetch_iterator = NULL;
 					break;
 				}
+				/* skip the same pages bitmap_stream_next_block does */
+				if (tbmpre->blockno >= scan->rs_nblocks)
+					continue;
 				node->prefetch_pages++;
 				PrefetchBuffer(scan->rs_rd, MAIN_FORKNUM, tbmpre->blockno);
 			}
@@ -305,30 +322,67 @@ BitmapHeapNext(BitmapHeapScanState *node)
 	return ExecClearTuple(slot);
 }
 
+/*
+ * bitmap_stream_next_block - read stream callback for BitmapHeapNext()
+ *
+ * Returns the next page of the bitmap, after copying its TBMIterateResult
+ * into the stream's per-buffer data.
+ */
+static BlockNumber
+bitmap_stream_next_block(ReadStream *stream, void *callback_private_data,
+						 void *per_buffer_data)
+{
+	BitmapHeapScanState *node = (BitmapHeapScanState *) callback_private_data;
+	HeapScanDesc scan = node->ss.ss_currentScanDesc;
+	TBMIterateResult *tbmres;
+
+	for (;;)
+	{
+		tbmres = tbm_iterate(node->tbmiterator);
+		if (tbmres == NULL)
+			return InvalidBlockNumber;
+
+		/*
+		 * Ignore any claimed entries past what we think is the end of the
+		 * relation.  (This is probably not necessary given that we got at
+		 * least AccessShareLock on the table before performing any of the
+		 * indexscans, but let's be safe.)
+		 */
+		if (tbmres->blockno < scan->rs_nblocks)
+			break;
+	}
+
+	memcpy(per_buffer_data, tbmres,
+		   offsetof(TBMIterateResult, offsets) +
+		   Max(tbmres->ntuples, 0) * sizeof(OffsetNumber));
+
+	return tbmres->blockno;
+}
+
 /*
  * bitgetpage - subroutine for BitmapHeapNext()
  *
- * This routine reads and pins the specified page of the relation, then
- * builds an array indicating which tuples on the page are both potentially
- * interesting according to the bitmap, and visible according to the snapshot.
+ * This routine takes the pinned buffer of the specified page of the
+ * relation, then builds an array indicating which tuples on the page are
+ * both potentially interesting according to the bitmap, and visible
+ * according to the snapshot.
  */
 static void
-bitgetpage(HeapScanDesc scan, TBMIterateResult *tbmres)
+bitgetpage(HeapScanDesc scan, TBMIterateResult *tbmres, Buffer buffer)
 {
 	BlockNumber page = tbmres->blockno;
-	Buffer		buffer;
 	Snapshot	snapshot;
 	int			ntup;
 
 	/*
-	 * Acquire pin on the target heap page, trading in any pin we held before.
+	 * Trade in any pin we held before for the target heap page's.
 	 */
 	Assert(page < scan->rs_nblocks);
+	Assert(BufferGetBlockNumber(buffer) == page);
 
-	scan->rs_cbuf = ReleaseAndReadBuffer(scan->rs_cbuf,
-										 scan->rs_rd,
-										 page);
-	buffer = scan->rs_cbuf;
+	if (BufferIsValid(scan->rs_cbuf))
+		ReleaseBuffer(scan->rs_cbuf);
+	scan->rs_cbuf = buffer;
 	snapshot = scan->rs_snapshot;
 
 	ntup = 0;
@@ -454,6 +508,8 @@ ExecReScanBitmapHeapScan(BitmapHeapScanState *node)
 	/* rescan to release any page pin */
 	heap_rescan(node->ss.ss_currentScanDesc, NULL);
 
+	if (node->stream)
+		read_stream_end(node->stream);
 	if (node->tbmiterator)
 		tbm_end_iterate(node->tbmiterator);
 	if (node->prefetch_iterator)
@@ -462,6 +518,7 @@ ExecReScanBitmapHeapScan(BitmapHeapScanState *node)
 		tbm_free(node->tbm);
 	node->tbm = NULL;
 	node->tbmiterator = NULL;
+	node->stream = NULL;
 	node->tbmres = NULL;
 	node->prefetch_iterator = NULL;
 
@@ -510,6 +567,8 @@ ExecEndBitmapHeapScan(BitmapHeapScanState *node)
 	/*
 	 * release bitmap if any
 	 */
+	if (node->stream)
+		read_stream_end(node->stream);
 	if (node->tbmiterator)
 		tbm_end_iterate(node->tbmiterator);
 	if (node->prefetch_iterator)
@@ -558,6 +617,7 @@ ExecInitBitmapHeapScan(BitmapHeapScan *node, EState *estate, int eflags)
 
 	scanstate->tbm = NULL;
 	scanstate->tbmiterator = NULL;
+	scanstate->stream = NULL;
 	scanstate->tbmres = NULL;
 	scanstate->exact_pages = 0;
 	scanstate->lossy_pages = 0;
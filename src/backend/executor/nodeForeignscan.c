@@ -282,3 +282,38 @@ ExecReScanForeignScan(ForeignScanState *node)
 
 	ExecScanReScan(&node->ss);
 }
+
+/* ----------------------------------------------------------------
+ *		ExecForeignScanAsyncRequest
+ *
+ *		Asks the FDW to start fetching data for the node in the background.
+ *		Returns true if the FDW now has a request in progress for it.
+ * ----------------------------------------------------------------
+ */
+bool
+ExecForeignScanAsyncRequest(ForeignScanState *node)
+{
+	FdwRoutine *fdwroutine = node->fdwroutine;
+
+	if (fdwroutine->ForeignAsyncRequest == NULL)
+		return false;
+	return fdwroutine->ForeignAsyncRequest(node);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecForeignScanAsyncReady
+ *
+ *		Returns true if the next tuple can be produced without waiting
+ *		for a remote server.  FDWs without asynchronous support are
+ *		always considered ready.
+ * ----------------------------------------------------------------
+ */
+bool
+ExecForeignScanAsyncReady(ForeignScanState *node)
+{
+	FdwRoutine *fdwroutine = node->fdwroutine;
+
+	if (fdwroutine->ForeignAsyncReady == NULL)
+		return true;
+	return fdwroutine->ForeignAsyncReady(node);
+}
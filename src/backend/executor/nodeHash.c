@@ -32,6 +32,7 @@
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
+#include "storage/shmem.h"
 #include "utils/dynahash.h"
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
@@ -49,6 +50,14 @@ static void ExecHashSkewTableInsert(HashJoinTable hashtable,
 static void ExecHashRemoveNextSkewBucket(HashJoinTable hashtable);
 
 static void *dense_alloc(HashJoinTable hashtable, Size size);
+static void ExecHashSharedInsert(HashJoinTable hashtable,
+					 TupleTableSlot *slot,
+					 uint32 hashvalue);
+static Size shared_dense_alloc(HashJoinTable hashtable, Size size);
+static void ExecHashSharedBuildDone(HashJoinTable hashtable);
+static inline void ExecHashBloomAdd(HashJoinTable hashtable, uint32 hashvalue);
+static bool ExecScanHashBucketEntries(HashJoinState *hjstate,
+						  ExprContext *econtext);
 
 /* ----------------------------------------------------------------
  *		ExecHash
@@ -112,6 +121,9 @@ MultiExecHash(HashState *node)
 		{
 			int			bucketNumber;
 
+			if (hashtable->bloomFilter != NULL)
+				ExecHashBloomAdd(hashtable, hashvalue);
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -120,6 +132,11 @@ MultiExecHash(HashState *node)
 										bucketNumber);
 				hashtable->skewTuples += 1;
 			}
+			else if (hashtable->shared != NULL)
+			{
+				/* Add it to the table we're building with other backends */
+				ExecHashSharedInsert(hashtable, slot, hashvalue);
+			}
 			else
 			{
 				/* Not subject to skew optimization, so insert normally */
@@ -129,15 +146,25 @@ MultiExecHash(HashState *node)
 		}
 	}
 
-	/* resize the hash table if needed (NTUP_PER_BUCKET exceeded) */
-	if (hashtable->nbuckets != hashtable->nbuckets_optimal)
+	if (hashtable->shared != NULL)
+	{
+		/* the table isn't complete until everyone has added their tuples */
+		ExecHashSharedBuildDone(hashtable);
+	}
+	else if (hashtable->nbuckets != hashtable->nbuckets_optimal)
+	{
+		/* resize the hash table if needed (NTUP_PER_BUCKET exceeded) */
 		ExecHashIncreaseNumBuckets(hashtable);
+	}
 
 	/* Account for the buckets in spaceUsed (reported in EXPLAIN ANALYZE) */
 	hashtable->spaceUsed += hashtable->nbuckets * sizeof(HashJoinTuple);
 	if (hashtable->spaceUsed > hashtable->spacePeak)
 		hashtable->spacePeak = hashtable->spaceUsed;
 
+	/* Lay out the buckets for probing */
+	ExecHashBuildBucketEntries(hashtable);
+
 	/* must provide our own instrumentation support */
 	if (node->ps.instrument)
 		InstrStopNode(node->ps.instrument, hashtable->totalTuples);
@@ -174,6 +201,7 @@ ExecInitHash(Hash *node, EState *estate, int eflags)
 	hashstate->ps.state = estate;
 	hashstate->hashtable = NULL;
 	hashstate->hashkeys = NIL;	/* will be set by parent HashJoin */
+	hashstate->shared_table = NULL;	/* may be set by parallel setup */
 
 	/*
 	 * Miscellaneous initialization
@@ -306,6 +334,13 @@ ExecHashTableCreate(Hash *node, List *hashOperators, bool keepNulls)
 	hashtable->spaceAllowedSkew =
 		hashtable->spaceAllowed * SKEW_WORK_MEM_PERCENT / 100;
 	hashtable->chunks = NULL;
+	hashtable->bucketStart = NULL;
+	hashtable->bucketEntries = NULL;
+	hashtable->bloomFilter = NULL;
+	hashtable->log2_bloombits = 0;
+	hashtable->shared = NULL;
+	hashtable->sharedChunkPos = 0;
+	hashtable->sharedChunkEnd = 0;
 
 #ifdef HJDEBUG
 	printf("Hashjoin %p: initial nbatch = %d, nbuckets = %d\n",
@@ -707,7 +742,7 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 				memcpy(copyTuple, hashTuple, hashTupleSize);
 
 				/* and add it back to the appropriate bucket */
-				copyTuple->next = hashtable->buckets[bucketno];
+				copyTuple->next.unshared = hashtable->buckets[bucketno];
 				hashtable->buckets[bucketno] = copyTuple;
 			}
 			else
@@ -808,7 +843,7 @@ ExecHashIncreaseNumBuckets(HashJoinTable hashtable)
 									  &bucketno, &batchno);
 
 			/* add the tuple to the proper bucket */
-			hashTuple->next = hashtable->buckets[bucketno];
+			hashTuple->next.unshared = hashtable->buckets[bucketno];
 			hashtable->buckets[bucketno] = hashTuple;
 
 			/* advance index past the tuple */
@@ -870,7 +905,7 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(hashTuple));
 
 		/* Push it onto the front of the bucket's list */
-		hashTuple->next = hashtable->buckets[bucketno];
+		hashTuple->next.unshared = hashtable->buckets[bucketno];
 		hashtable->buckets[bucketno] = hashTuple;
 
 		/*
@@ -1050,6 +1085,18 @@ ExecHashGetBucketAndBatch(HashJoinTable hashtable,
 	}
 }
 
+/*
+ * ExecHashNextTuple
+ *		follow a tuple's bucket link, in either kind of table
+ */
+static inline HashJoinTuple
+ExecHashNextTuple(HashJoinTable hashtable, HashJoinTuple tuple)
+{
+	if (hashtable->shared != NULL)
+		return SHARED_HJ_TUPLE(hashtable->shared, tuple->next.shared);
+	return tuple->next.unshared;
+}
+
 /*
  * ExecScanHashBucket
  *		scan a hash bucket for matches to the current outer tuple
@@ -1069,6 +1116,10 @@ ExecScanHashBucket(HashJoinState *hjstate,
 	HashJoinTuple hashTuple = hjstate->hj_CurTuple;
 	uint32		hashvalue = hjstate->hj_CurHashValue;
 
+	if (hashtable->bucketEntries != NULL &&
+		hjstate->hj_CurSkewBucketNo == INVALID_SKEW_BUCKET_NO)
+		return ExecScanHashBucketEntries(hjstate, econtext);
+
 	/*
 	 * hj_CurTuple is the address of the tuple last returned from the current
 	 * bucket, or NULL if it's time to start scanning a new bucket.
@@ -1077,9 +1128,12 @@ ExecScanHashBucket(HashJoinState *hjstate,
 	 * otherwise scan the standard hashtable bucket.
 	 */
 	if (hashTuple != NULL)
-		hashTuple = hashTuple->next;
+		hashTuple = ExecHashNextTuple(hashtable, hashTuple);
 	else if (hjstate->hj_CurSkewBucketNo != INVALID_SKEW_BUCKET_NO)
 		hashTuple = hashtable->skewBucket[hjstate->hj_CurSkewBucketNo]->tuples;
+	else if (hashtable->shared != NULL)
+		hashTuple = SHARED_HJ_TUPLE(hashtable->shared,
+			pg_atomic_read_u32(&hashtable->shared->buckets[hjstate->hj_CurBucketNo]));
 	else
 		hashTuple = hashtable->buckets[hjstate->hj_CurBucketNo];
 
@@ -1105,7 +1159,7 @@ ExecScanHashBucket(HashJoinState *hjstate,
 			}
 		}
 
-		hashTuple = hashTuple->next;
+		hashTuple = ExecHashNextTuple(hashtable, hashTuple);
 	}
 
 	/*
@@ -1147,6 +1201,9 @@ ExecScanHashTableForUnmatched(HashJoinState *hjstate, ExprContext *econtext)
 	HashJoinTable hashtable = hjstate->hj_HashTable;
 	HashJoinTuple hashTuple = hjstate->hj_CurTuple;
 
+	/* right and full joins can't use a shared table */
+	Assert(hashtable->shared == NULL);
+
 	for (;;)
 	{
 		/*
@@ -1155,7 +1212,7 @@ ExecScanHashTableForUnmatched(HashJoinState *hjstate, ExprContext *econtext)
 		 * bucket.
 		 */
 		if (hashTuple != NULL)
-			hashTuple = hashTuple->next;
+			hashTuple = hashTuple->next.unshared;
 		else if (hjstate->hj_CurBucketNo < hashtable->nbuckets)
 		{
 			hashTuple = hashtable->buckets[hjstate->hj_CurBucketNo];
@@ -1194,7 +1251,7 @@ ExecScanHashTableForUnmatched(HashJoinState *hjstate, ExprContext *econtext)
 				return true;
 			}
 
-			hashTuple = hashTuple->next;
+			hashTuple = hashTuple->next.unshared;
 		}
 	}
 
@@ -1232,6 +1289,8 @@ ExecHashTableReset(HashJoinTable hashtable)
 
 	/* Forget the chunks (the memory was freed by the context reset above). */
 	hashtable->chunks = NULL;
+	hashtable->bucketStart = NULL;
+	hashtable->bucketEntries = NULL;
 }
 
 /*
@@ -1247,7 +1306,7 @@ ExecHashTableResetMatchFlags(HashJoinTable hashtable)
 	/* Reset all flags in the main table ... */
 	for (i = 0; i < hashtable->nbuckets; i++)
 	{
-		for (tuple = hashtable->buckets[i]; tuple != NULL; tuple = tuple->next)
+		for (tuple = hashtable->buckets[i]; tuple != NULL; tuple = tuple->next.unshared)
 			HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(tuple));
 	}
 
@@ -1257,7 +1316,7 @@ ExecHashTableResetMatchFlags(HashJoinTable hashtable)
 		int			j = hashtable->skewBucketNums[i];
 		HashSkewBucket *skewBucket = hashtable->skewBucket[j];
 
-		for (tuple = skewBucket->tuples; tuple != NULL; tuple = tuple->next)
+		for (tuple = skewBucket->tuples; tuple != NULL; tuple = tuple->next.unshared)
 			HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(tuple));
 	}
 }
@@ -1509,7 +1568,7 @@ ExecHashSkewTableInsert(HashJoinTable hashtable,
 	HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(hashTuple));
 
 	/* Push it onto the front of the skew bucket's list */
-	hashTuple->next = hashtable->skewBucket[bucketNumber]->tuples;
+	hashTuple->next.unshared = hashtable->skewBucket[bucketNumber]->tuples;
 	hashtable->skewBucket[bucketNumber]->tuples = hashTuple;
 
 	/* Account for space used, and back off if we've used too much */
@@ -1558,7 +1617,7 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 	hashTuple = bucket->tuples;
 	while (hashTuple != NULL)
 	{
-		HashJoinTuple nextHashTuple = hashTuple->next;
+		HashJoinTuple nextHashTuple = hashTuple->next.unshared;
 		MinimalTuple tuple;
 		Size		tupleSize;
 
@@ -1584,7 +1643,7 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 			memcpy(copyTuple, hashTuple, tupleSize);
 			pfree(hashTuple);
 
-			copyTuple->next = hashtable->buckets[bucketno];
+			copyTuple->next.unshared = hashtable->buckets[bucketno];
 			hashtable->buckets[bucketno] = copyTuple;
 
 			/* We have reduced skew space, but overall space doesn't change */
@@ -1713,3 +1772,563 @@ dense_alloc(HashJoinTable hashtable, Size size)
 	/* return pointer to the start of the tuple memory */
 	return ptr;
 }
+
+/*
+ * ExecHashBuildBucketEntries
+ *		lay out the current batch's tuples as bucket-grouped entries
+ *
+ * See the notes on HashJoinBucketEntry in executor/hashjoin.h.  This is
+ * called once the batch is completely loaded; the result is thrown away by
+ * ExecHashTableReset.  We skip it for small tables, which stay in cache
+ * anyway, and when the extra memory would exceed work_mem.
+ */
+void
+ExecHashBuildBucketEntries(HashJoinTable hashtable)
+{
+	uint32		nbuckets = (uint32) hashtable->nbuckets;
+	int			lowbits;
+	uint32		npartitions;
+	uint32		ntuples = 0;
+	Size		space;
+	HashMemoryChunk chunk;
+	HashJoinBucketEntry *scratch;
+	HashJoinBucketEntry *entries;
+	uint32	   *partStart;
+	uint32	   *bucketStart;
+	uint32		i;
+
+	hashtable->bucketStart = NULL;
+	hashtable->bucketEntries = NULL;
+
+	if (hashtable->shared != NULL)
+		return;
+
+	for (chunk = hashtable->chunks; chunk != NULL; chunk = chunk->next)
+		ntuples += chunk->ntuples;
+
+	if (ntuples < HJ_BUCKET_ENTRIES_MIN_TUPLES)
+		return;
+
+	/* we need a scratch copy of the entries while partitioning */
+	space = 2 * ntuples * sizeof(HashJoinBucketEntry) +
+		(nbuckets + 1) * sizeof(uint32);
+	if (hashtable->spaceUsed + space > hashtable->spaceAllowed)
+		return;
+
+	/*
+	 * The first pass partitions on the high-order half of the bucket number
+	 * bits, the second on the low-order half.
+	 */
+	lowbits = hashtable->log2_nbuckets / 2;
+	npartitions = nbuckets >> lowbits;
+
+	scratch = (HashJoinBucketEntry *)
+		MemoryContextAlloc(hashtable->batchCxt,
+						   ntuples * sizeof(HashJoinBucketEntry));
+	entries = (HashJoinBucketEntry *)
+		MemoryContextAlloc(hashtable->batchCxt,
+						   ntuples * sizeof(HashJoinBucketEntry));
+	partStart = (uint32 *)
+		MemoryContextAllocZero(hashtable->batchCxt,
+							   (npartitions + 1) * sizeof(uint32));
+	bucketStart = (uint32 *)
+		MemoryContextAllocZero(hashtable->batchCxt,
+							   (nbuckets + 1) * sizeof(uint32));
+
+	/*
+	 * Pass 1: count the tuples in each partition, and scatter them to their
+	 * partitions.  The tuples are read in the order they were stored in the
+	 * chunks, so that this is a sequential scan of memory.  partStart[p] is
+	 * used as partition p's insertion point, and ends up as the start of
+	 * partition p + 1.
+	 */
+	for (chunk = hashtable->chunks; chunk != NULL; chunk = chunk->next)
+	{
+		size_t		idx = 0;
+
+		while (idx < chunk->used)
+		{
+			HashJoinTuple hashTuple = (HashJoinTuple) (chunk->data + idx);
+			uint32		bucketno = hashTuple->hashvalue & (nbuckets - 1);
+
+			partStart[(bucketno >> lowbits) + 1]++;
+			idx += MAXALIGN(HJTUPLE_OVERHEAD +
+							HJTUPLE_MINTUPLE(hashTuple)->t_len);
+		}
+	}
+	for (i = 1; i < npartitions; i++)
+		partStart[i] += partStart[i - 1];
+
+	for (chunk = hashtable->chunks; chunk != NULL; chunk = chunk->next)
+	{
+		size_t		idx = 0;
+
+		while (idx < chunk->used)
+		{
+			HashJoinTuple hashTuple = (HashJoinTuple) (chunk->data + idx);
+			uint32		bucketno = hashTuple->hashvalue & (nbuckets - 1);
+			HashJoinBucketEntry *entry;
+
+			entry = &scratch[partStart[bucketno >> lowbits]++];
+			entry->hashvalue = hashTuple->hashvalue;
+			entry->tuple = hashTuple;
+			idx += MAXALIGN(HJTUPLE_OVERHEAD +
+							HJTUPLE_MINTUPLE(hashTuple)->t_len);
+		}
+	}
+
+	/*
+	 * Pass 2: the same again on the full bucket number, reading the entries
+	 * partition by partition, so each partition's buckets are all that's
+	 * being written to at any one time.
+	 */
+	for (i = 0; i < ntuples; i++)
+		bucketStart[(scratch[i].hashvalue & (nbuckets - 1)) + 1]++;
+	for (i = 1; i < nbuckets; i++)
+		bucketStart[i] += bucketStart[i - 1];
+	for (i = 0; i < ntuples; i++)
+		entries[bucketStart[scratch[i].hashvalue & (nbuckets - 1)]++] =
+			scratch[i];
+
+	/* each insertion point is now the start of the next bucket */
+	memmove(bucketStart + 1, bucketStart, nbuckets * sizeof(uint32));
+	bucketStart[0] = 0;
+	Assert(bucketStart[nbuckets] == ntuples);
+
+	pfree(scratch);
+	pfree(partStart);
+
+	hashtable->bucketStart = bucketStart;
+	hashtable->bucketEntries = entries;
+
+	hashtable->spaceUsed += ntuples * sizeof(HashJoinBucketEntry) +
+		(nbuckets + 1) * sizeof(uint32);
+	if (hashtable->spaceUsed > hashtable->spacePeak)
+		hashtable->spacePeak = hashtable->spaceUsed;
+}
+
+/*
+ * ExecScanHashBucketEntries
+ *		ExecScanHashBucket for a table with bucket-grouped entries
+ */
+static bool
+ExecScanHashBucketEntries(HashJoinState *hjstate,
+						  ExprContext *econtext)
+{
+	List	   *hjclauses = hjstate->hashclauses;
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	HashJoinBucketEntry *entries = hashtable->bucketEntries;
+	uint32		hashvalue = hjstate->hj_CurHashValue;
+	int			entryno;
+	int			end;
+
+	/* hj_CurTuple is NULL if it's time to start scanning a new bucket */
+	if (hjstate->hj_CurTuple != NULL)
+		entryno = hjstate->hj_CurEntryNo + 1;
+	else
+		entryno = hashtable->bucketStart[hjstate->hj_CurBucketNo];
+	end = hashtable->bucketStart[hjstate->hj_CurBucketNo + 1];
+
+	for (; entryno < end; entryno++)
+	{
+		HashJoinTuple hashTuple;
+		TupleTableSlot *inntuple;
+
+		if (entries[entryno].hashvalue != hashvalue)
+			continue;
+
+		/* insert hashtable's tuple into exec slot so ExecQual sees it */
+		hashTuple = entries[entryno].tuple;
+		inntuple = ExecStoreMinimalTuple(HJTUPLE_MINTUPLE(hashTuple),
+										 hjstate->hj_HashTupleSlot,
+										 false);	/* do not pfree */
+		econtext->ecxt_innertuple = inntuple;
+
+		/* reset temp memory each time to avoid leaks from qual expr */
+		ResetExprContext(econtext);
+
+		if (ExecQual(hjclauses, econtext, false))
+		{
+			hjstate->hj_CurTuple = hashTuple;
+			hjstate->hj_CurEntryNo = entryno;
+			return true;
+		}
+	}
+
+	/*
+	 * no match
+	 */
+	return false;
+}
+
+/* ----------------------------------------------------------------
+ *		Shared hash tables
+ *
+ * See the notes on SharedHashJoinTableData in executor/hashjoin.h.
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * ExecHashSharedEstimate
+ *		memory needed for a shared table with the given number of buckets
+ *		and bytes of tuple storage
+ */
+Size
+ExecHashSharedEstimate(int nbuckets, Size space)
+{
+	Size		size;
+
+	size = add_size(offsetof(SharedHashJoinTableData, buckets),
+					mul_size(nbuckets, sizeof(pg_atomic_uint32)));
+	return add_size(MAXALIGN(size), MAXALIGN(space));
+}
+
+/*
+ * ExecHashSharedInitialize
+ *		set up an empty shared table in the "size" bytes at "shared"
+ *
+ * nbuckets must be a power of 2, and size should have come from
+ * ExecHashSharedEstimate.  nparticipants is the number of backends that will
+ * each run the Hash node's subplan to fill the table.
+ */
+void
+ExecHashSharedInitialize(SharedHashJoinTable shared, Size size,
+						 int nbuckets, int nparticipants)
+{
+	int			i;
+
+	Assert(nbuckets == (1 << my_log2(nbuckets)));
+	Assert(nparticipants > 0);
+
+	SpinLockInit(&shared->mutex);
+	shared->spaceUsed = 0;
+	shared->nbuilt = 0;
+	shared->totalTuples = 0;
+	shared->nparticipants = nparticipants;
+	shared->nbuckets = nbuckets;
+	shared->log2_nbuckets = my_log2(nbuckets);
+	shared->tuplesOffset =
+		MAXALIGN(offsetof(SharedHashJoinTableData, buckets) +
+				 nbuckets * sizeof(pg_atomic_uint32));
+
+	/* tuples beyond what a 32-bit link can address are no use to us */
+	if (size / MAXIMUM_ALIGNOF > PG_UINT32_MAX)
+		size = (Size) PG_UINT32_MAX * MAXIMUM_ALIGNOF;
+	Assert(size >= shared->tuplesOffset);
+	shared->spaceAllowed = (size - shared->tuplesOffset) & ~((Size) MAXIMUM_ALIGNOF - 1);
+
+	for (i = 0; i < nbuckets; i++)
+		pg_atomic_init_u32(&shared->buckets[i], 0);
+}
+
+/*
+ * ExecHashTableAttachShared
+ *		make a newly created hashtable build and probe a shared table
+ *		instead of its own buckets
+ *
+ * The shared table has a single batch, so batching and the skew optimization
+ * are turned off.
+ */
+void
+ExecHashTableAttachShared(HashJoinTable hashtable, SharedHashJoinTable shared)
+{
+	Assert(hashtable->totalTuples == 0);
+
+	if (hashtable->keepNulls)
+		elog(ERROR, "shared hash tables cannot be used for right or full joins");
+
+	hashtable->shared = shared;
+	hashtable->nbuckets = shared->nbuckets;
+	hashtable->nbuckets_original = shared->nbuckets;
+	hashtable->nbuckets_optimal = shared->nbuckets;
+	hashtable->log2_nbuckets = shared->log2_nbuckets;
+	hashtable->log2_nbuckets_optimal = shared->log2_nbuckets;
+	hashtable->nbatch = 1;
+	hashtable->nbatch_original = 1;
+	hashtable->nbatch_outstart = 1;
+	hashtable->growEnabled = false;
+	hashtable->skewEnabled = false;
+	hashtable->spaceAllowed = shared->spaceAllowed;
+
+	/* our private bucket array won't be used */
+	if (hashtable->buckets != NULL)
+	{
+		pfree(hashtable->buckets);
+		hashtable->buckets = NULL;
+	}
+}
+
+/*
+ * ExecHashSharedInsert
+ *		add a tuple to the shared table
+ *
+ * This is ExecHashTableInsert for shared tables, minus the support for
+ * batching.
+ */
+static void
+ExecHashSharedInsert(HashJoinTable hashtable,
+					 TupleTableSlot *slot,
+					 uint32 hashvalue)
+{
+	SharedHashJoinTable shared = hashtable->shared;
+	MinimalTuple tuple = ExecFetchSlotMinimalTuple(slot);
+	HashJoinTuple hashTuple;
+	Size		hashTupleSize;
+	pg_atomic_uint32 *bucket;
+	uint32		head;
+	uint32		offset;
+	int			bucketno;
+	int			batchno;
+
+	ExecHashGetBucketAndBatch(hashtable, hashvalue,
+							  &bucketno, &batchno);
+	Assert(batchno == 0);
+
+	/* Create the HashJoinTuple */
+	hashTupleSize = MAXALIGN(HJTUPLE_OVERHEAD + tuple->t_len);
+	hashTuple = (HashJoinTuple)
+		((char *) shared + shared_dense_alloc(hashtable, hashTupleSize));
+
+	hashTuple->hashvalue = hashvalue;
+	memcpy(HJTUPLE_MINTUPLE(hashTuple), tuple, tuple->t_len);
+	HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(hashTuple));
+
+	/*
+	 * Push it onto the front of the bucket's list.  The compare-and-swap is a
+	 * full memory barrier, so anyone who sees the new list head also sees the
+	 * tuple's contents.
+	 */
+	bucket = &shared->buckets[bucketno];
+	offset = SHARED_HJ_OFFSET(shared, hashTuple);
+	head = pg_atomic_read_u32(bucket);
+	do
+	{
+		hashTuple->next.shared = head;
+	} while (!pg_atomic_compare_exchange_u32(bucket, &head, offset));
+
+	/* Account for the space we used, for EXPLAIN ANALYZE */
+	hashtable->spaceUsed += hashTupleSize;
+	if (hashtable->spaceUsed > hashtable->spacePeak)
+		hashtable->spacePeak = hashtable->spaceUsed;
+}
+
+/*
+ * shared_dense_alloc
+ *		carve "size" bytes out of the shared table's tuple storage, returning
+ *		their offset from the start of the table
+ *
+ * Like dense_alloc, we take space from the shared pool a chunk at a time, so
+ * that the mutex is taken only once per HASH_CHUNK_SIZE bytes of tuples, and
+ * give oversized tuples a piece of their own.
+ */
+static Size
+shared_dense_alloc(HashJoinTable hashtable, Size size)
+{
+	SharedHashJoinTable shared = hashtable->shared;
+	Size		request;
+	Size		result = 0;
+
+	Assert(size == MAXALIGN(size));
+
+	/* Serve it from our current chunk, if it fits */
+	if (hashtable->sharedChunkEnd - hashtable->sharedChunkPos >= size)
+	{
+		result = hashtable->sharedChunkPos;
+		hashtable->sharedChunkPos += size;
+		return result;
+	}
+
+	request = (size > HASH_CHUNK_THRESHOLD) ? size : HASH_CHUNK_SIZE;
+
+	SpinLockAcquire(&shared->mutex);
+	if (request > shared->spaceAllowed - shared->spaceUsed)
+		request = shared->spaceAllowed - shared->spaceUsed;
+	if (request >= size)
+	{
+		result = shared->tuplesOffset + shared->spaceUsed;
+		shared->spaceUsed += request;
+	}
+	SpinLockRelease(&shared->mutex);
+
+	if (request < size)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("shared hash table is full"),
+				 errdetail("The table has room for %zu bytes of tuples.",
+						   shared->spaceAllowed)));
+
+	/* Keep the rest of a fresh chunk for the following tuples */
+	if (request > size)
+	{
+		hashtable->sharedChunkPos = result + size;
+		hashtable->sharedChunkEnd = result + request;
+	}
+
+	return result;
+}
+
+/*
+ * ExecHashSharedBuildDone
+ *		report that we've inserted all our tuples, and wait until every other
+ *		participant has done the same
+ *
+ * On return, hashtable->totalTuples counts the tuples of all participants.
+ */
+static void
+ExecHashSharedBuildDone(HashJoinTable hashtable)
+{
+	SharedHashJoinTable shared = hashtable->shared;
+	bool		done;
+
+	SpinLockAcquire(&shared->mutex);
+	shared->nbuilt++;
+	shared->totalTuples += hashtable->totalTuples;
+	Assert(shared->nbuilt <= shared->nparticipants);
+	SpinLockRelease(&shared->mutex);
+
+	/*
+	 * Participants scan disjoint parts of the same input, so they should
+	 * finish at about the same time; polling is good enough.
+	 */
+	for (;;)
+	{
+		SpinLockAcquire(&shared->mutex);
+		done = (shared->nbuilt == shared->nparticipants);
+		if (done)
+			hashtable->totalTuples = shared->totalTuples;
+		SpinLockRelease(&shared->mutex);
+
+		if (done)
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(1000L);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		Runtime filters
+ *
+ * While the hash table is built, the hash value of every inner tuple is
+ * also recorded in a bloom filter.  A hash join whose outer side is a scan
+ * can then have the scan test each tuple's outer hash value against the
+ * filter, and drop tuples that can't have a match before they are qualified,
+ * projected and handed up to the join (or written to an outer batch file).
+ * The filter is checked with two bits derived from the 32-bit hash value.
+ * ----------------------------------------------------------------
+ */
+
+/* minimum and target size of the bloom filter */
+#define HASH_BLOOM_MIN_BITS		8192
+#define HASH_BLOOM_BITS_PER_TUPLE	8
+
+#define HASH_BLOOM_BIT1(hashtable, hashvalue) \
+	((hashvalue) & ((((uint64) 1) << (hashtable)->log2_bloombits) - 1))
+#define HASH_BLOOM_BIT2(hashtable, hashvalue) \
+	(((uint64) ((hashvalue) * 0x9E3779B1U)) >> (32 - (hashtable)->log2_bloombits))
+
+#define HASH_BLOOM_TEST(filter, bit) \
+	(((filter)[(bit) / 64] & (((uint64) 1) << ((bit) % 64))) != 0)
+#define HASH_BLOOM_SET(filter, bit) \
+	((filter)[(bit) / 64] |= (((uint64) 1) << ((bit) % 64)))
+
+/*
+ * ExecHashTableCreateBloom
+ *
+ *		Set up a bloom filter sized for the expected number of inner tuples,
+ *		for MultiExecHash to fill in.  It's kept to an eighth of work_mem, and
+ *		isn't built for a shared table, since each participant sees only some
+ *		of the inner tuples.
+ */
+void
+ExecHashTableCreateBloom(HashJoinTable hashtable, double ntuples)
+{
+	double		nbits;
+	double		maxbits;
+	int			log2_nbits;
+
+	if (hashtable->shared != NULL)
+		return;
+
+	/* work_mem is in kilobytes, so this is an eighth of it */
+	maxbits = Max((double) work_mem * 1024L, HASH_BLOOM_MIN_BITS);
+	nbits = Max(ntuples * HASH_BLOOM_BITS_PER_TUPLE, HASH_BLOOM_MIN_BITS);
+	nbits = Min(nbits, maxbits);
+
+	/* round to a power of 2, no more than the bits of a hash value */
+	log2_nbits = my_log2((long) nbits);
+	if ((double) ((uint64) 1 << log2_nbits) > maxbits)
+		log2_nbits--;
+	log2_nbits = Min(log2_nbits, 32);
+
+	hashtable->log2_bloombits = log2_nbits;
+	hashtable->bloomFilter = (uint64 *)
+		MemoryContextAllocZero(hashtable->hashCxt,
+							   ((uint64) 1 << log2_nbits) / 8);
+}
+
+/*
+ * Record an inner tuple's hash value in the bloom filter.
+ */
+static inline void
+ExecHashBloomAdd(HashJoinTable hashtable, uint32 hashvalue)
+{
+	uint64		bit1 = HASH_BLOOM_BIT1(hashtable, hashvalue);
+	uint64		bit2 = HASH_BLOOM_BIT2(hashtable, hashvalue);
+
+	HASH_BLOOM_SET(hashtable->bloomFilter, bit1);
+	HASH_BLOOM_SET(hashtable->bloomFilter, bit2);
+}
+
+/*
+ * ExecHashActivateRuntimeFilter
+ *
+ *		Called once the hash table is complete, to start filtering the outer
+ *		scan against it.  If the inner side turned out much bigger than
+ *		estimated, the filter would pass too many tuples to be worth its
+ *		cost, so it's left off.
+ */
+void
+ExecHashActivateRuntimeFilter(RuntimeFilterState *filter,
+							  HashJoinTable hashtable)
+{
+	filter->hashtable = hashtable;
+	filter->active = false;
+
+	if (hashtable->bloomFilter == NULL)
+		return;
+
+	if (hashtable->totalTuples * (HASH_BLOOM_BITS_PER_TUPLE / 2) >
+		(double) ((uint64) 1 << hashtable->log2_bloombits))
+		return;
+
+	filter->active = true;
+}
+
+/*
+ * ExecHashRuntimeFilterPasses
+ *
+ *		Could the scan tuple in econtext have a match in the hash table?
+ *		false means it certainly can't, so the scan may discard it.
+ */
+bool
+ExecHashRuntimeFilterPasses(RuntimeFilterState *filter, ExprContext *econtext)
+{
+	HashJoinTable hashtable = filter->hashtable;
+	uint32		hashvalue;
+
+	if (!filter->active)
+		return true;
+
+	/* tuples with null join keys can't match either */
+	if (ExecHashGetHashValue(hashtable, econtext, filter->hashkeys,
+							 true, false, &hashvalue) &&
+		HASH_BLOOM_TEST(hashtable->bloomFilter,
+						HASH_BLOOM_BIT1(hashtable, hashvalue)) &&
+		HASH_BLOOM_TEST(hashtable->bloomFilter,
+						HASH_BLOOM_BIT2(hashtable, hashvalue)))
+		return true;
+
+	filter->nfiltered += 1;
+	return false;
+}
@@ -21,6 +21,9 @@
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "parser/parsetree.h"
 #include "utils/memutils.h"
 
 
@@ -47,6 +50,8 @@ static TupleTableSlot *ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
 						  uint32 *hashvalue,
 						  TupleTableSlot *tupleSlot);
 static bool ExecHashJoinNewBatch(HashJoinState *hjstate);
+static RuntimeFilterState *ExecHashJoinInitRuntimeFilter(HashJoinState *hjstate,
+							  HashJoin *node);
 
 
 /* ----------------------------------------------------------------
@@ -142,9 +147,12 @@ ExecHashJoin(HashJoinState *node)
 				 * from the outer plan node.  If we succeed, we have to stash
 				 * it away for later consumption by ExecHashJoinOuterGetTuple.
 				 */
-				if (HJ_FILL_INNER(node))
+				if (HJ_FILL_INNER(node) || hashNode->shared_table != NULL)
 				{
-					/* no chance to not build the hash table */
+					/*
+					 * no chance to not build the hash table; with a shared
+					 * table, the other participants are counting on us
+					 */
 					node->hj_FirstOuterTupleSlot = NULL;
 				}
 				else if (HJ_FILL_OUTER(node) ||
@@ -169,6 +177,12 @@ ExecHashJoin(HashJoinState *node)
 				hashtable = ExecHashTableCreate((Hash *) hashNode->ps.plan,
 												node->hj_HashOperators,
 												HJ_FILL_INNER(node));
+				if (hashNode->shared_table != NULL)
+					ExecHashTableAttachShared(hashtable,
+											  hashNode->shared_table);
+				if (node->hj_RuntimeFilter != NULL)
+					ExecHashTableCreateBloom(hashtable,
+											 hashNode->ps.plan->plan_rows);
 				node->hj_HashTable = hashtable;
 
 				/*
@@ -177,6 +191,14 @@ ExecHashJoin(HashJoinState *node)
 				hashNode->hashtable = hashtable;
 				(void) MultiExecProcNode((PlanState *) hashNode);
 
+				/*
+				 * From now on the outer scan can skip tuples that certainly
+				 * have no match in the hash table.
+				 */
+				if (node->hj_RuntimeFilter != NULL)
+					ExecHashActivateRuntimeFilter(node->hj_RuntimeFilter,
+												  hashtable);
+
 				/*
 				 * If the inner relation is completely empty, and we're not
 				 * doing a left outer join, we can quit without scanning the
@@ -557,6 +579,7 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hjstate->hj_CurHashValue = 0;
 	hjstate->hj_CurBucketNo = 0;
 	hjstate->hj_CurSkewBucketNo = INVALID_SKEW_BUCKET_NO;
+	hjstate->hj_CurEntryNo = 0;
 	hjstate->hj_CurTuple = NULL;
 
 	/*
@@ -586,6 +609,8 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	/* child Hash node needs to evaluate inner hash keys, too */
 	((HashState *) innerPlanState(hjstate))->hashkeys = rclauses;
 
+	hjstate->hj_RuntimeFilter = ExecHashJoinInitRuntimeFilter(hjstate, node);
+
 	hjstate->js.ps.ps_TupFromTlist = false;
 	hjstate->hj_JoinState = HJ_BUILD_HASHTABLE;
 	hjstate->hj_MatchedOuter = false;
@@ -594,6 +619,86 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	return hjstate;
 }
 
+typedef struct
+{
+	List	   *scan_tlist;		/* targetlist of the outer scan */
+	bool		failed;			/* found a reference we can't rewrite? */
+} runtime_filter_key_context;
+
+/*
+ * Rewrite an outer hash key to reference the outer scan's own tuple rather
+ * than its output, for a runtime filter.  The referenced tlist entries have
+ * to be plain Vars; otherwise context->failed is set.
+ */
+static Node *
+runtime_filter_key_mutator(Node *node, runtime_filter_key_context *context)
+{
+	if (node == NULL)
+		return NULL;
+	if (IsA(node, Var) && ((Var *) node)->varno == OUTER_VAR)
+	{
+		TargetEntry *tle = get_tle_by_resno(context->scan_tlist,
+											((Var *) node)->varattno);
+
+		if (tle == NULL || !IsA(tle->expr, Var))
+		{
+			context->failed = true;
+			return node;
+		}
+		return (Node *) copyObject(tle->expr);
+	}
+	return expression_tree_mutator(node, runtime_filter_key_mutator,
+								   (void *) context);
+}
+
+/*
+ * ExecHashJoinInitRuntimeFilter
+ *
+ *		Set up a runtime filter in the outer scan, if the join allows one;
+ *		it's armed once the hash table has been built.
+ *
+ * Dropping outer tuples that have no match is only OK if the join would
+ * drop them too, so not when outer tuples are null-extended (or returned,
+ * for an anti join).  For now the outer side has to be a plain SeqScan.
+ */
+static RuntimeFilterState *
+ExecHashJoinInitRuntimeFilter(HashJoinState *hjstate, HashJoin *node)
+{
+	PlanState  *outerState = outerPlanState(hjstate);
+	RuntimeFilterState *filter;
+	runtime_filter_key_context context;
+	List	   *scankeys = NIL;
+	ListCell   *lc;
+
+	if (HJ_FILL_OUTER(hjstate) || !IsA(outerState, SeqScanState))
+		return NULL;
+
+	context.scan_tlist = outerState->plan->targetlist;
+	context.failed = false;
+
+	foreach(lc, node->hashclauses)
+	{
+		OpExpr	   *hclause = (OpExpr *) lfirst(lc);
+		Node	   *outerkey = (Node *) linitial(hclause->args);
+		Node	   *scankey;
+
+		/* the scan would evaluate these once more per tuple */
+		if (contain_volatile_functions(outerkey) || contain_subplans(outerkey))
+			return NULL;
+
+		scankey = runtime_filter_key_mutator(outerkey, &context);
+		if (context.failed)
+			return NULL;
+		scankeys = lappend(scankeys, scankey);
+	}
+
+	filter = (RuntimeFilterState *) palloc0(sizeof(RuntimeFilterState));
+	filter->hashkeys = (List *) ExecInitExpr((Expr *) scankeys, outerState);
+	((ScanState *) outerState)->ss_runtimeFilter = filter;
+
+	return filter;
+}
+
 /* ----------------------------------------------------------------
  *		ExecEndHashJoin
  *
@@ -608,6 +713,11 @@ ExecEndHashJoin(HashJoinState *node)
 	 */
 	if (node->hj_HashTable)
 	{
+		if (node->hj_RuntimeFilter != NULL)
+		{
+			node->hj_RuntimeFilter->active = false;
+			node->hj_RuntimeFilter->hashtable = NULL;
+		}
 		ExecHashTableDestroy(node->hj_HashTable);
 		node->hj_HashTable = NULL;
 	}
@@ -840,6 +950,9 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 		 */
 		BufFileClose(innerFile);
 		hashtable->innerBatchFile[curbatch] = NULL;
+
+		/* Lay out the buckets for probing */
+		ExecHashBuildBucketEntries(hashtable);
 	}
 
 	/*
@@ -981,6 +1094,14 @@ ExecReScanHashJoin(HashJoinState *node)
 		else
 		{
 			/* must destroy and rebuild hash table */
+			if (node->hj_HashTable->shared != NULL)
+				elog(ERROR, "cannot rebuild a shared hash table");
+			/* the outer scan must not filter against the old table */
+			if (node->hj_RuntimeFilter != NULL)
+			{
+				node->hj_RuntimeFilter->active = false;
+				node->hj_RuntimeFilter->hashtable = NULL;
+			}
 			ExecHashTableDestroy(node->hj_HashTable);
 			node->hj_HashTable = NULL;
 			node->hj_JoinState = HJ_BUILD_HASHTABLE;
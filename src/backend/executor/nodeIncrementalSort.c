@@ -0,0 +1,384 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeIncrementalSort.c
+ *	  Routines to handle incremental sorting of relations.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeIncrementalSort.c
+ *
+ * NOTES
+ *	  An IncrementalSort node is used in place of a Sort when its input is
+ *	  already sorted on a leading prefix of the sort keys, for example
+ *	  when an index scan provides ORDER BY a and the query wants ORDER BY
+ *	  a, b.  Rather than sorting the whole input at once, we read it in
+ *	  batches of at least MIN_BATCH_SIZE tuples, extended until the
+ *	  presorted keys change, and sort each batch separately on all keys.
+ *	  Since no later tuple can sort before any tuple of the current batch,
+ *	  each sorted batch can be returned as soon as it has been read.
+ *
+ *	  Compared to a full sort this needs only enough memory for one batch,
+ *	  and above all it lets a LIMIT stop reading the input early.
+ *
+ *	  Only forward scans are supported; a rescan starts over from the
+ *	  beginning of the outer plan.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/execdebug.h"
+#include "executor/nodeIncrementalSort.h"
+#include "miscadmin.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/tuplesort.h"
+
+/*
+ * Minimum number of tuples collected into a batch before we start looking
+ * for the end of the current group of presorted keys.  Sorting a batch at a
+ * time costs a tuplesort setup each, so this keeps that overhead in check
+ * when the presorted keys are (nearly) unique.
+ */
+#define MIN_BATCH_SIZE 32
+
+
+/*
+ * Check whether the given tuple matches the group pivot on the presorted
+ * keys.
+ */
+static bool
+isCurrentGroup(IncrementalSortState *node, TupleTableSlot *slot)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	ResetExprContext(econtext);
+
+	return execTuplesMatch(node->group_pivot, slot,
+						   plannode->presortedCols,
+						   plannode->sort.sortColIdx,
+						   node->eqfunctions,
+						   econtext->ecxt_per_tuple_memory);
+}
+
+/*
+ * Release the tuplesort of the current batch, if any.
+ */
+static void
+finishBatch(IncrementalSortState *node)
+{
+	if (node->tuplesortstate != NULL)
+	{
+		Tuplesortstate *state = (Tuplesortstate *) node->tuplesortstate;
+
+		/* EXPLAIN has to see the batch's memory usage before it's gone */
+		node->peakMemory = Max(node->peakMemory,
+							   tuplesort_get_peak_memory(state));
+		tuplesort_end(state);
+	}
+	node->tuplesortstate = NULL;
+	node->batch_Sorted = false;
+}
+
+/*
+ * Read the next batch of tuples from the outer plan and sort it.
+ *
+ * Returns false if there is nothing left to return.
+ */
+static bool
+sortNextBatch(IncrementalSortState *node)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	PlanState  *outerNode = outerPlanState(node);
+	Tuplesortstate *tuplesortstate;
+	TupleTableSlot *slot;
+	int64		ntuples = 0;
+
+	Assert(node->tuplesortstate == NULL);
+
+	if (node->bounded && node->tuples_returned >= node->bound)
+		return false;
+	if (node->outerNodeDone && !node->transfer_Valid)
+		return false;
+
+	tuplesortstate = tuplesort_begin_heap(ExecGetResultType(outerNode),
+										  plannode->sort.numCols,
+										  plannode->sort.sortColIdx,
+										  plannode->sort.sortOperators,
+										  plannode->sort.collations,
+										  plannode->sort.nullsFirst,
+										  work_mem,
+										  false);
+	if (node->bounded)
+		tuplesort_set_bound(tuplesortstate,
+							node->bound - node->tuples_returned);
+	node->tuplesortstate = (void *) tuplesortstate;
+
+	/* Start with the tuple that ended the previous batch, if any */
+	if (node->transfer_Valid)
+	{
+		tuplesort_puttupleslot(tuplesortstate, node->transfer_tuple);
+		ExecClearTuple(node->transfer_tuple);
+		node->transfer_Valid = false;
+		ntuples++;
+	}
+
+	while (!node->outerNodeDone)
+	{
+		slot = ExecProcNode(outerNode);
+
+		if (TupIsNull(slot))
+		{
+			node->outerNodeDone = true;
+			break;
+		}
+
+		/*
+		 * Once the batch is big enough, it extends only to the end of the
+		 * group that its last tuple belongs to.  The first tuple of the next
+		 * group has to be kept for the next batch.
+		 */
+		if (ntuples >= MIN_BATCH_SIZE && !isCurrentGroup(node, slot))
+		{
+			ExecCopySlot(node->transfer_tuple, slot);
+			node->transfer_Valid = true;
+			break;
+		}
+
+		tuplesort_puttupleslot(tuplesortstate, slot);
+		ntuples++;
+
+		if (ntuples == MIN_BATCH_SIZE)
+			ExecCopySlot(node->group_pivot, slot);
+	}
+
+	SO1_printf("ExecIncrementalSort: sorting batch of " INT64_FORMAT
+			   " tuples\n", ntuples);
+
+	tuplesort_performsort(tuplesortstate);
+	node->batch_Sorted = true;
+	node->n_batches++;
+
+	{
+		const char *spaceType;
+		const char *sortMethod;
+		long		spaceUsed;
+
+		tuplesort_get_stats(tuplesortstate, &sortMethod, &spaceType,
+							&spaceUsed);
+		if (spaceUsed > node->peakSpaceUsed || node->peakSpaceType == NULL)
+		{
+			node->peakSpaceUsed = spaceUsed;
+			node->peakSpaceType = spaceType;
+		}
+	}
+
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecIncrementalSort
+ *
+ *		Returns the next tuple of the current sorted batch, reading and
+ *		sorting a new batch from the outer plan whenever the current one
+ *		is used up.
+ * ----------------------------------------------------------------
+ */
+TupleTableSlot *
+ExecIncrementalSort(IncrementalSortState *node)
+{
+	TupleTableSlot *slot = node->ss.ps.ps_ResultTupleSlot;
+
+	Assert(ScanDirectionIsForward(node->ss.ps.state->es_direction));
+
+	for (;;)
+	{
+		if (node->batch_Sorted)
+		{
+			if (tuplesort_gettupleslot((Tuplesortstate *) node->tuplesortstate,
+									   true, slot))
+			{
+				node->tuples_returned++;
+				return slot;
+			}
+			finishBatch(node);
+		}
+
+		if (!sortNextBatch(node))
+		{
+			finishBatch(node);
+			return ExecClearTuple(slot);
+		}
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitIncrementalSort
+ *
+ *		Creates the run-time state information for the incremental sort
+ *		node produced by the planner and initializes its outer subtree.
+ * ----------------------------------------------------------------
+ */
+IncrementalSortState *
+ExecInitIncrementalSort(IncrementalSort *node, EState *estate, int eflags)
+{
+	IncrementalSortState *incrsortstate;
+	Oid		   *eqOperators;
+	int			i;
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "initializing incremental sort node");
+
+	/* check for unsupported flags */
+	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+	/*
+	 * create state structure
+	 */
+	incrsortstate = makeNode(IncrementalSortState);
+	incrsortstate->ss.ps.plan = (Plan *) node;
+	incrsortstate->ss.ps.state = estate;
+
+	incrsortstate->bounded = false;
+	incrsortstate->tuples_returned = 0;
+	incrsortstate->batch_Sorted = false;
+	incrsortstate->outerNodeDone = false;
+	incrsortstate->transfer_Valid = false;
+	incrsortstate->tuplesortstate = NULL;
+	incrsortstate->n_batches = 0;
+	incrsortstate->peakSpaceUsed = 0;
+	incrsortstate->peakSpaceType = NULL;
+	incrsortstate->peakMemory = 0;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * We need an ExprContext only to have a short-lived memory context for
+	 * comparing tuples on the presorted keys.
+	 */
+	ExecAssignExprContext(estate, &incrsortstate->ss.ps);
+
+	/*
+	 * tuple table initialization
+	 */
+	ExecInitResultTupleSlot(estate, &incrsortstate->ss.ps);
+	ExecInitScanTupleSlot(estate, &incrsortstate->ss);
+	incrsortstate->group_pivot = ExecInitExtraTupleSlot(estate);
+	incrsortstate->transfer_tuple = ExecInitExtraTupleSlot(estate);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We read the input only once per scan, so the child needs to support
+	 * neither BACKWARD nor MARK/RESTORE.
+	 */
+	eflags &= ~(EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK);
+
+	outerPlanState(incrsortstate) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * initialize tuple type.  no need to initialize projection info because
+	 * this node doesn't do projections.
+	 */
+	ExecAssignResultTypeFromTL(&incrsortstate->ss.ps);
+	ExecAssignScanTypeFromOuterPlan(&incrsortstate->ss);
+	incrsortstate->ss.ps.ps_ProjInfo = NULL;
+
+	ExecSetSlotDescriptor(incrsortstate->group_pivot,
+						  ExecGetResultType(outerPlanState(incrsortstate)));
+	ExecSetSlotDescriptor(incrsortstate->transfer_tuple,
+						  ExecGetResultType(outerPlanState(incrsortstate)));
+
+	/*
+	 * Precompute fmgr lookup data for comparing the presorted keys.  The
+	 * sort operators tell us which equality semantics to use.
+	 */
+	eqOperators = (Oid *) palloc(node->presortedCols * sizeof(Oid));
+	for (i = 0; i < node->presortedCols; i++)
+	{
+		Oid			sortop = node->sort.sortOperators[i];
+
+		eqOperators[i] = get_equality_op_for_ordering_op(sortop, NULL);
+		if (!OidIsValid(eqOperators[i]))
+			elog(ERROR, "could not find equality operator for ordering operator %u",
+				 sortop);
+	}
+	incrsortstate->eqfunctions = execTuplesMatchPrepare(node->presortedCols,
+														eqOperators);
+	pfree(eqOperators);
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "incremental sort node initialized");
+
+	return incrsortstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndIncrementalSort(node)
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndIncrementalSort(IncrementalSortState *node)
+{
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "shutting down incremental sort node");
+
+	/*
+	 * Free the exprcontext
+	 */
+	ExecFreeExprContext(&node->ss.ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	/* must drop pointer to sort result tuple */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->group_pivot);
+	ExecClearTuple(node->transfer_tuple);
+
+	/*
+	 * Release tuplesort resources
+	 */
+	finishBatch(node);
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "incremental sort node shutdown");
+}
+
+void
+ExecReScanIncrementalSort(IncrementalSortState *node)
+{
+	PlanState  *outerPlan = outerPlanState(node);
+
+	/* must drop pointer to sort result tuple */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->group_pivot);
+	ExecClearTuple(node->transfer_tuple);
+
+	/*
+	 * Batches are thrown away as soon as they have been returned, so there
+	 * is nothing to rewind; we always have to re-read the subplan.
+	 */
+	finishBatch(node);
+	node->tuples_returned = 0;
+	node->outerNodeDone = false;
+	node->transfer_Valid = false;
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (outerPlan->chgParam == NULL)
+		ExecReScan(outerPlan);
+}
@@ -32,11 +32,13 @@
 #include "lib/pairingheap.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
+#include "storage/bufmgr.h"
 #include "utils/array.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/tqual.h"
 
 /*
  * When an ordering operator is used, tuples fetched from the index that
@@ -1014,6 +1016,18 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 											   indexstate->iss_NumScanKeys,
 											 indexstate->iss_NumOrderByKeys);
 
+	/*
+	 * Read ahead in the index and prefetch heap pages, as a bitmap heap scan
+	 * would.  That needs a scan that only moves forward, with an MVCC
+	 * snapshot, and that doesn't need per-tuple ORDER BY values; see
+	 * index_setprefetch.
+	 */
+	if (target_prefetch_pages > 0 &&
+		!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)) &&
+		indexstate->iss_NumOrderByKeys == 0 &&
+		IsMVCCSnapshot(estate->es_snapshot))
+		index_setprefetch(indexstate->iss_ScanDesc, target_prefetch_pages);
+
 	/*
 	 * If no run-time keys to calculate, go ahead and pass the scankeys to the
 	 * index AM.
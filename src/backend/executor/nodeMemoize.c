@@ -0,0 +1,570 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeMemoize.c
+ *	  Routines to handle caching of the results of parameterized scans
+ *
+ * A Memoize node sits above the inner side of a parameterized nestloop and
+ * remembers what each scan of its subplan returned, keyed by the values of
+ * the parameters (the plan's param_exprs).  When the nestloop rescans us
+ * with a set of parameter values we have seen before, we return the stored
+ * tuples without running the subplan at all.
+ *
+ * The cache is a TupleHashTable whose entries carry the list of tuples
+ * returned for their key.  All entries are also kept in a list in least
+ * recently used order; when the cache grows beyond work_mem, we throw away
+ * entries from the front of that list.  An entry is only marked complete
+ * once its scan has run to the end, so a scan the caller abandoned early is
+ * not mistaken for a full result.  A single scan that doesn't fit in
+ * work_mem even on its own is not cached at all: we drop what we have
+ * stored of it and just pass the subplan's remaining tuples through.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeMemoize.c
+ *
+ *-------------------------------------------------------------------------
+ */
+/*
+ * INTERFACE ROUTINES
+ *		ExecMemoize			- return tuples from the cache or the subplan
+ *		ExecInitMemoize		- initialize node and subnodes
+ *		ExecEndMemoize		- shutdown node and subnodes
+ *		ExecReScanMemoize	- prepare to look up a new set of parameters
+ */
+#include "postgres.h"
+
+#include "executor/executor.h"
+#include "executor/nodeMemoize.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/memutils.h"
+
+/* States of the ExecMemoize state machine */
+typedef enum
+{
+	MEMO_CACHE_LOOKUP,			/* look up the current keys on next fetch */
+	MEMO_CACHE_FETCH_NEXT_TUPLE,	/* returning tuples of a complete entry */
+	MEMO_FILLING_CACHE,			/* reading the subplan into the entry */
+	MEMO_CACHE_BYPASS,			/* reading the subplan without caching */
+	MEMO_END_OF_SCAN			/* scan is finished */
+} MemoizeStatus;
+
+/* One cached tuple */
+typedef struct MemoizeTuple
+{
+	MinimalTuple mintuple;		/* the tuple itself */
+	struct MemoizeTuple *next;	/* next tuple of the same entry */
+} MemoizeTuple;
+
+/* One hash table entry, holding the results of one set of keys */
+typedef struct MemoizeEntry
+{
+	TupleHashEntryData shared;	/* common header for hash table entries */
+	dlist_node	lru_node;		/* link in the LRU list */
+	MemoizeTuple *tuplehead;	/* tuples of this entry, in scan order */
+	MemoizeTuple *tupletail;	/* last of them, for appending */
+	Size		mem;			/* memory used by this entry */
+	bool		complete;		/* did the scan run to completion? */
+} MemoizeEntry;
+
+/* memory charged for an entry with no tuples */
+#define EMPTY_ENTRY_MEMORY(entry) \
+	(sizeof(MemoizeEntry) + GetMemoryChunkSpace((entry)->shared.firstTuple))
+
+
+/*
+ * Collect the PARAM_EXEC params referenced by the cache keys, so we can
+ * tell on rescan whether anything else the subplan depends on has changed.
+ */
+static bool
+memoize_paramids_walker(Node *node, Bitmapset **paramids)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+	{
+		Param	   *param = (Param *) node;
+
+		if (param->paramkind == PARAM_EXEC)
+			*paramids = bms_add_member(*paramids, param->paramid);
+		return false;
+	}
+	return expression_tree_walker(node, reinterpret_cast<expression_tree_walker_fptr>(memoize_paramids_walker),
+								  (void *) paramids);
+}
+
+/*
+ * (Re)create an empty cache.
+ */
+static void
+build_memoize_table(MemoizeState *node)
+{
+	Memoize    *plan = (Memoize *) node->ps.plan;
+	long		nbuckets;
+
+	nbuckets = plan->est_entries > 0 ? (long) plan->est_entries : 1024;
+
+	node->hashtable = BuildTupleHashTable(node->numKeys,
+										  node->keyColIdx,
+										  node->eqfunctions,
+										  node->hashfunctions,
+										  nbuckets,
+										  sizeof(MemoizeEntry),
+										  node->tablecxt,
+							  node->ps.ps_ExprContext->ecxt_per_tuple_memory);
+	dlist_init(&node->lru_list);
+	node->mem_used = 0;
+}
+
+/*
+ * Throw away the whole cache.
+ */
+static void
+cache_purge_all(MemoizeState *node)
+{
+	MemoryContextReset(node->tablecxt);
+	build_memoize_table(node);
+	node->entry = NULL;
+	node->last_tuple = NULL;
+}
+
+/*
+ * Free the tuples stored in an entry, leaving it empty and incomplete.
+ */
+static void
+entry_purge_tuples(MemoizeState *node, MemoizeEntry *entry)
+{
+	MemoizeTuple *mtup = entry->tuplehead;
+
+	while (mtup != NULL)
+	{
+		MemoizeTuple *next = mtup->next;
+
+		pfree(mtup->mintuple);
+		pfree(mtup);
+		mtup = next;
+	}
+	entry->tuplehead = entry->tupletail = NULL;
+	entry->complete = false;
+
+	node->mem_used -= entry->mem - EMPTY_ENTRY_MEMORY(entry);
+	entry->mem = EMPTY_ENTRY_MEMORY(entry);
+}
+
+/*
+ * Remove an entry from the cache altogether.
+ */
+static void
+cache_remove_entry(MemoizeState *node, MemoizeEntry *entry)
+{
+	MinimalTuple key = entry->shared.firstTuple;
+	TupleHashEntry removed PG_USED_FOR_ASSERTS_ONLY;
+
+	entry_purge_tuples(node, entry);
+	dlist_delete(&entry->lru_node);
+	node->mem_used -= entry->mem;
+
+	/* the hash table finds the entry by its key... */
+	ExecStoreMinimalTuple(key, node->keyslot, false);
+	removed = RemoveTupleHashEntry(node->hashtable, node->keyslot);
+	Assert(removed == (TupleHashEntry) entry);
+	ExecClearTuple(node->keyslot);
+
+	/* ... which is ours to free */
+	pfree(key);
+}
+
+/*
+ * Evict least recently used entries until the cache fits in work_mem again.
+ *
+ * The entry of the current scan, which is always the most recently used
+ * one, is never evicted; if it's the only one left, return false.
+ */
+static bool
+cache_reduce_memory(MemoizeState *node)
+{
+	while (node->mem_used > node->mem_limit)
+	{
+		MemoizeEntry *victim;
+
+		Assert(!dlist_is_empty(&node->lru_list));
+		victim = dlist_head_element(MemoizeEntry, lru_node, &node->lru_list);
+		if (victim == node->entry)
+			return false;
+
+		cache_remove_entry(node, victim);
+		node->cache_evictions++;
+	}
+	return true;
+}
+
+/*
+ * Look up the current parameter values in the cache, adding an entry for
+ * them if there isn't one.  *found tells whether the entry existed already.
+ * The entry becomes the most recently used one.
+ *
+ * Returns NULL if a new entry was needed but couldn't be made to fit.
+ */
+static MemoizeEntry *
+cache_lookup(MemoizeState *node, bool *found)
+{
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	TupleTableSlot *probeslot = node->probeslot;
+	MemoizeEntry *entry;
+	ListCell   *lc;
+	bool		isnew;
+	int			i;
+
+	/* compute the keys */
+	ResetExprContext(econtext);
+	ExecClearTuple(probeslot);
+	i = 0;
+	foreach(lc, node->param_exprs)
+	{
+		ExprState  *expr = (ExprState *) lfirst(lc);
+
+		probeslot->tts_values[i] = ExecEvalExpr(expr, econtext,
+												&probeslot->tts_isnull[i],
+												NULL);
+		i++;
+	}
+	ExecStoreVirtualTuple(probeslot);
+
+	entry = (MemoizeEntry *) LookupTupleHashEntry(node->hashtable,
+												  probeslot, &isnew);
+	*found = !isnew;
+
+	if (!isnew)
+	{
+		/* move it to the end of the LRU list */
+		dlist_delete(&entry->lru_node);
+		dlist_push_tail(&node->lru_list, &entry->lru_node);
+		node->entry = entry;
+		return entry;
+	}
+
+	/* the new entry was zeroed by LookupTupleHashEntry */
+	entry->mem = EMPTY_ENTRY_MEMORY(entry);
+	node->mem_used += entry->mem;
+	dlist_push_tail(&node->lru_list, &entry->lru_node);
+	node->entry = entry;
+
+	if (node->mem_used > node->mem_limit && !cache_reduce_memory(node))
+	{
+		cache_remove_entry(node, entry);
+		node->entry = NULL;
+		return NULL;
+	}
+
+	if (node->mem_used > node->mem_peak)
+		node->mem_peak = node->mem_used;
+
+	return entry;
+}
+
+/*
+ * Append the tuple in slot to the current entry.  Returns false if the
+ * entry would no longer fit in work_mem even after evicting everything
+ * else; it's then been removed from the cache.
+ */
+static bool
+cache_store_tuple(MemoizeState *node, TupleTableSlot *slot)
+{
+	MemoizeEntry *entry = node->entry;
+	MemoizeTuple *mtup;
+	MemoryContext oldcxt;
+	Size		mem;
+
+	oldcxt = MemoryContextSwitchTo(node->tablecxt);
+	mtup = (MemoizeTuple *) palloc(sizeof(MemoizeTuple));
+	mtup->mintuple = ExecCopySlotMinimalTuple(slot);
+	mtup->next = NULL;
+	MemoryContextSwitchTo(oldcxt);
+
+	if (entry->tupletail == NULL)
+		entry->tuplehead = mtup;
+	else
+		entry->tupletail->next = mtup;
+	entry->tupletail = mtup;
+
+	mem = GetMemoryChunkSpace(mtup) + GetMemoryChunkSpace(mtup->mintuple);
+	entry->mem += mem;
+	node->mem_used += mem;
+
+	if (node->mem_used > node->mem_limit && !cache_reduce_memory(node))
+	{
+		cache_remove_entry(node, entry);
+		node->entry = NULL;
+		return false;
+	}
+
+	if (node->mem_used > node->mem_peak)
+		node->mem_peak = node->mem_used;
+
+	return true;
+}
+
+/*
+ * Return a cached tuple in our result slot.
+ */
+static TupleTableSlot *
+cache_return_tuple(MemoizeState *node, MemoizeTuple *mtup)
+{
+	node->last_tuple = mtup;
+	return ExecStoreMinimalTuple(mtup->mintuple,
+								 node->ps.ps_ResultTupleSlot,
+								 false);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecMemoize
+ *
+ *		On the first fetch of a scan, look up the parameter values in the
+ *		cache.  If we have a complete result for them, return the cached
+ *		tuples; otherwise run the subplan, storing its tuples as we go.
+ * ----------------------------------------------------------------
+ */
+TupleTableSlot *
+ExecMemoize(MemoizeState *node)
+{
+	PlanState  *outerNode = outerPlanState(node);
+	TupleTableSlot *outerslot;
+
+	switch (node->mstatus)
+	{
+		case MEMO_CACHE_LOOKUP:
+			{
+				MemoizeEntry *entry;
+				bool		found;
+
+				entry = cache_lookup(node, &found);
+
+				if (found && entry->complete)
+				{
+					node->cache_hits++;
+
+					if (entry->tuplehead == NULL)
+					{
+						node->mstatus = MEMO_END_OF_SCAN;
+						return NULL;
+					}
+					node->mstatus = MEMO_CACHE_FETCH_NEXT_TUPLE;
+					return cache_return_tuple(node, entry->tuplehead);
+				}
+
+				/*
+				 * We must run the subplan.  Any tuples left over from an
+				 * earlier scan that was not run to completion are useless.
+				 */
+				node->cache_misses++;
+				if (found)
+					entry_purge_tuples(node, entry);
+
+				ExecReScan(outerNode);
+				outerslot = ExecProcNode(outerNode);
+				if (TupIsNull(outerslot))
+				{
+					if (entry != NULL)
+						entry->complete = true;
+					node->mstatus = MEMO_END_OF_SCAN;
+					return NULL;
+				}
+
+				if (entry == NULL || !cache_store_tuple(node, outerslot))
+				{
+					node->cache_overflows++;
+					node->mstatus = MEMO_CACHE_BYPASS;
+				}
+				else
+					node->mstatus = MEMO_FILLING_CACHE;
+				return outerslot;
+			}
+
+		case MEMO_CACHE_FETCH_NEXT_TUPLE:
+			if (node->last_tuple->next == NULL)
+			{
+				node->mstatus = MEMO_END_OF_SCAN;
+				return NULL;
+			}
+			return cache_return_tuple(node, node->last_tuple->next);
+
+		case MEMO_FILLING_CACHE:
+			outerslot = ExecProcNode(outerNode);
+			if (TupIsNull(outerslot))
+			{
+				node->entry->complete = true;
+				node->mstatus = MEMO_END_OF_SCAN;
+				return NULL;
+			}
+			if (!cache_store_tuple(node, outerslot))
+			{
+				node->cache_overflows++;
+				node->mstatus = MEMO_CACHE_BYPASS;
+			}
+			return outerslot;
+
+		case MEMO_CACHE_BYPASS:
+			outerslot = ExecProcNode(outerNode);
+			if (TupIsNull(outerslot))
+			{
+				node->mstatus = MEMO_END_OF_SCAN;
+				return NULL;
+			}
+			return outerslot;
+
+		case MEMO_END_OF_SCAN:
+			return NULL;
+	}
+
+	elog(ERROR, "unrecognized memoize state: %d", node->mstatus);
+	return NULL;				/* keep compiler quiet */
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitMemoize
+ * ----------------------------------------------------------------
+ */
+MemoizeState *
+ExecInitMemoize(Memoize *node, EState *estate, int eflags)
+{
+	MemoizeState *mstate;
+	TupleDesc	keydesc;
+	int			i;
+
+	/* check for unsupported flags */
+	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+	/*
+	 * create state structure
+	 */
+	mstate = makeNode(MemoizeState);
+	mstate->ps.plan = (Plan *) node;
+	mstate->ps.state = estate;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * We need an ExprContext to compute the keys in, which is also where
+	 * the hash table runs its hash and equality functions.
+	 */
+	ExecAssignExprContext(estate, &mstate->ps);
+
+	/*
+	 * tuple table initialization
+	 */
+	ExecInitResultTupleSlot(estate, &mstate->ps);
+	mstate->probeslot = ExecInitExtraTupleSlot(estate);
+	mstate->keyslot = ExecInitExtraTupleSlot(estate);
+
+	/*
+	 * initialize child expressions
+	 */
+	mstate->param_exprs = (List *)
+		ExecInitExpr((Expr *) node->param_exprs, (PlanState *) mstate);
+	memoize_paramids_walker((Node *) node->param_exprs,
+							&mstate->keyparamids);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We shield the child node from the need to support REWIND, BACKWARD, or
+	 * MARK/RESTORE.
+	 */
+	eflags &= ~(EXEC_FLAG_REWIND | EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK);
+
+	outerPlanState(mstate) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * initialize tuple type.  no need to initialize projection info because
+	 * this node doesn't do projections.
+	 */
+	ExecAssignResultTypeFromTL(&mstate->ps);
+	mstate->ps.ps_ProjInfo = NULL;
+
+	keydesc = ExecTypeFromExprList(node->param_exprs);
+	ExecSetSlotDescriptor(mstate->probeslot, keydesc);
+	ExecSetSlotDescriptor(mstate->keyslot, keydesc);
+
+	/*
+	 * Set up the cache.  The keys are columns 1..numKeys of the probe slot.
+	 */
+	mstate->numKeys = node->numKeys;
+	mstate->keyColIdx = (AttrNumber *) palloc(node->numKeys * sizeof(AttrNumber));
+	for (i = 0; i < node->numKeys; i++)
+		mstate->keyColIdx[i] = i + 1;
+	execTuplesHashPrepare(node->numKeys, node->eqOperators,
+						  &mstate->eqfunctions, &mstate->hashfunctions);
+
+	mstate->tablecxt = AllocSetContextCreate(CurrentMemoryContext,
+											 "MemoizeHashTable",
+											 ALLOCSET_DEFAULT_MINSIZE,
+											 ALLOCSET_DEFAULT_INITSIZE,
+											 ALLOCSET_DEFAULT_MAXSIZE);
+	mstate->mem_limit = work_mem * 1024L;
+	build_memoize_table(mstate);
+
+	mstate->mstatus = MEMO_CACHE_LOOKUP;
+	mstate->entry = NULL;
+	mstate->last_tuple = NULL;
+
+	return mstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndMemoize
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndMemoize(MemoizeState *node)
+{
+	/*
+	 * Free the exprcontext
+	 */
+	ExecFreeExprContext(&node->ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->probeslot);
+	ExecClearTuple(node->keyslot);
+
+	/*
+	 * Release the cache
+	 */
+	MemoryContextDelete(node->tablecxt);
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+}
+
+/* ----------------------------------------------------------------
+ *		ExecReScanMemoize
+ *
+ *		The subplan itself is only rescanned if we end up needing to run
+ *		it, which is the whole point.
+ * ----------------------------------------------------------------
+ */
+void
+ExecReScanMemoize(MemoizeState *node)
+{
+	PlanState  *outerPlan = outerPlanState(node);
+
+	ExecClearTuple(node->ps.ps_ResultTupleSlot);
+
+	node->mstatus = MEMO_CACHE_LOOKUP;
+	node->entry = NULL;
+	node->last_tuple = NULL;
+
+	/*
+	 * If something the subplan depends on changed besides the cache keys,
+	 * none of the cached results can be trusted any more.
+	 */
+	if (bms_nonempty_difference(outerPlan->chgParam, node->keyparamids))
+		cache_purge_all(node);
+}
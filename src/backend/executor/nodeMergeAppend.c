@@ -34,6 +34,8 @@
  *				/	\		  |		 |		|
  *			  nil	nil		 ...    ...    ...
  *								 subplans
+ *
+ *		Run-time pruning of subplans works as in Append; see nodeAppend.c.
  */
 
 #include "postgres.h"
@@ -64,6 +66,7 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 {
 	MergeAppendState *mergestate = makeNode(MergeAppendState);
 	PlanState **mergeplanstates;
+	List	   *subplans = node->mergeplans;
 	int			nplans;
 	int			i;
 	ListCell   *lc;
@@ -71,10 +74,29 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 	/* check for unsupported flags */
 	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
 
+	/*
+	 * Leave out subplans excluded by PARAM_EXTERN values, as in Append.
+	 */
+	mergestate->ms_nremoved = 0;
+	mergestate->ms_prune_constraints = NULL;
+	mergestate->ms_prune_clauses = NULL;
+	mergestate->ms_valid = NULL;
+	if (node->prune_clauses != NIL)
+	{
+		ExecAssignExprContext(estate, &mergestate->ps);
+		subplans = ExecPruneSubplansAtInit(subplans,
+										   node->prune_constraints,
+										   node->prune_clauses,
+										   mergestate->ps.ps_ExprContext,
+										   &mergestate->ms_prune_constraints,
+										   &mergestate->ms_prune_clauses,
+										   &mergestate->ms_nremoved);
+	}
+
 	/*
 	 * Set up empty vector of subplan states
 	 */
-	nplans = list_length(node->mergeplans);
+	nplans = list_length(subplans);
 
 	mergeplanstates = (PlanState **) palloc0(nplans * sizeof(PlanState *));
 
@@ -94,7 +116,7 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 	 * Miscellaneous initialization
 	 *
 	 * MergeAppend plans don't have expression contexts because they never
-	 * call ExecQual or ExecProject.
+	 * call ExecQual or ExecProject, except for run-time pruning as above.
 	 */
 
 	/*
@@ -108,7 +130,7 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 	 * results into the array "mergeplans".
 	 */
 	i = 0;
-	foreach(lc, node->mergeplans)
+	foreach(lc, subplans)
 	{
 		Plan	   *initNode = (Plan *) lfirst(lc);
 
@@ -116,6 +138,17 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 		i++;
 	}
 
+	/* Do any of them need to be checked again at the start of each scan? */
+	for (i = 0; i < nplans; i++)
+	{
+		if (mergestate->ms_prune_clauses != NULL &&
+			mergestate->ms_prune_clauses[i] != NIL)
+		{
+			mergestate->ms_valid = (bool *) palloc(nplans * sizeof(bool));
+			break;
+		}
+	}
+
 	/*
 	 * initialize output tuple type
 	 */
@@ -173,10 +206,18 @@ ExecMergeAppend(MergeAppendState *node)
 	{
 		/*
 		 * First time through: pull the first tuple from each subplan, and set
-		 * up the heap.
+		 * up the heap.  Subplans pruned for this scan are left out.
 		 */
+		if (node->ms_valid != NULL)
+			ExecPruneSubplansAtScan(node->ms_nplans,
+									node->ms_prune_constraints,
+									node->ms_prune_clauses,
+									node->ps.ps_ExprContext,
+									node->ms_valid);
 		for (i = 0; i < node->ms_nplans; i++)
 		{
+			if (node->ms_valid != NULL && !node->ms_valid[i])
+				continue;
 			node->ms_slots[i] = ExecProcNode(node->mergeplans[i]);
 			if (!TupIsNull(node->ms_slots[i]))
 				binaryheap_add_unordered(node->ms_heap, Int32GetDatum(i));
@@ -276,6 +317,11 @@ ExecEndMergeAppend(MergeAppendState *node)
 	mergeplans = node->mergeplans;
 	nplans = node->ms_nplans;
 
+	/*
+	 * Free the exprcontext, if we made one for run-time pruning
+	 */
+	ExecFreeExprContext(&node->ps);
+
 	/*
 	 * shut down each of the subscans
 	 */
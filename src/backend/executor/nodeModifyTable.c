@@ -37,7 +37,9 @@
 
 #include "postgres.h"
 
+#include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/tableam.h"
 #include "access/xact.h"
 #include "commands/trigger.h"
 #include "executor/executor.h"
@@ -61,6 +63,17 @@ static bool ExecOnConflictUpdate(ModifyTableState *mtstate,
 					 EState *estate,
 					 bool canSetTag,
 					 TupleTableSlot **returning);
+static void ExecFlushBufferedInserts(ModifyTableState *mtstate,
+						 EState *estate);
+
+/*
+ * When an INSERT writes its rows with heap_multi_insert, we flush the
+ * buffered rows when there are this many of them, or once their total size
+ * reaches MAX_BUFFERED_BYTES, whichever comes first.  These are the same
+ * limits COPY uses.
+ */
+#define MAX_BUFFERED_TUPLES		1000
+#define MAX_BUFFERED_BYTES		65535
 
 /*
  * Verify that the tuples to be produced by INSERT or UPDATE match the
@@ -447,17 +460,42 @@ ExecInsert(ModifyTableState *mtstate,
 
 			/* Since there was no insertion conflict, we're done */
 		}
+		else if (mtstate->mt_multiInsert)
+		{
+			MemoryContext oldcontext;
+
+			/*
+			 * Buffer the tuple, to be written by heap_multi_insert together
+			 * with others.  Its index entries and AFTER ROW triggers are
+			 * taken care of at the same time; there is no RETURNING list
+			 * nor WITH CHECK OPTION to process, so we're done with it.
+			 */
+			oldcontext = MemoryContextSwitchTo(mtstate->mt_batchcxt);
+			mtstate->mt_bufferedTuples[mtstate->mt_nBufferedTuples++] =
+				heap_copytuple(tuple);
+			MemoryContextSwitchTo(oldcontext);
+			mtstate->mt_bufferedBytes += tuple->t_len;
+
+			if (canSetTag)
+				(estate->es_processed)++;
+
+			if (mtstate->mt_nBufferedTuples == MAX_BUFFERED_TUPLES ||
+				mtstate->mt_bufferedBytes >= MAX_BUFFERED_BYTES)
+				ExecFlushBufferedInserts(mtstate, estate);
+
+			return NULL;
+		}
 		else
 		{
 			/*
 			 * insert the tuple normally.
 			 *
-			 * Note: heap_insert returns the tid (location) of the new tuple
+			 * Note: table_insert returns the tid (location) of the new tuple
 			 * in the t_self field.
 			 */
-			newId = heap_insert(resultRelationDesc, tuple,
-								estate->es_output_cid,
-								0, NULL);
+			newId = table_insert(resultRelationDesc, tuple,
+								 estate->es_output_cid,
+								 0, NULL);
 
 			/* insert index entries for tuple */
 			if (resultRelInfo->ri_NumIndices > 0)
@@ -502,6 +540,71 @@ ExecInsert(ModifyTableState *mtstate,
 	return NULL;
 }
 
+/* ----------------------------------------------------------------
+ *		ExecFlushBufferedInserts
+ *
+ *		Write the rows buffered by ExecInsert to the heap in one
+ *		heap_multi_insert call, then insert their index entries (an
+ *		index at a time, see ExecInsertIndexTuplesBatch) and queue
+ *		their AFTER ROW triggers, as ExecInsert would have done for
+ *		each of them.
+ * ----------------------------------------------------------------
+ */
+static void
+ExecFlushBufferedInserts(ModifyTableState *mtstate, EState *estate)
+{
+	ResultRelInfo *resultRelInfo = mtstate->resultRelInfo;
+	ResultRelInfo *saved_resultRelInfo = estate->es_result_relation_info;
+	HeapTuple  *tuples = mtstate->mt_bufferedTuples;
+	int			ntuples = mtstate->mt_nBufferedTuples;
+	List	  **recheckIndexes;
+	MemoryContext oldcontext;
+	int			i;
+
+	if (ntuples == 0)
+		return;
+
+	/* ExecInsertIndexTuples expects this to be set */
+	estate->es_result_relation_info = resultRelInfo;
+
+	/*
+	 * heap_multi_insert leaks memory, so switch to short-lived memory context
+	 * before calling it.
+	 */
+	oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	table_multi_insert(resultRelInfo->ri_RelationDesc, tuples, ntuples,
+					   estate->es_output_cid, 0, mtstate->mt_bistate);
+	MemoryContextSwitchTo(oldcontext);
+
+	recheckIndexes = (List **) palloc0(ntuples * sizeof(List *));
+	if (resultRelInfo->ri_NumIndices > 0)
+		ExecInsertIndexTuplesBatch(mtstate->mt_batchslot, tuples, ntuples,
+								   estate, recheckIndexes, NULL, 0);
+
+	for (i = 0; i < ntuples; i++)
+	{
+		/* AFTER ROW INSERT Triggers */
+		ExecARInsertTriggers(estate, resultRelInfo, tuples[i],
+							 recheckIndexes[i]);
+
+		list_free(recheckIndexes[i]);
+	}
+	pfree(recheckIndexes);
+	ExecClearTuple(mtstate->mt_batchslot);
+
+	if (mtstate->canSetTag)
+	{
+		estate->es_lastoid = HeapTupleGetOid(tuples[ntuples - 1]);
+		setLastTid(&(tuples[ntuples - 1]->t_self));
+	}
+
+	MemoryContextReset(mtstate->mt_batchcxt);
+	mtstate->mt_nBufferedTuples = 0;
+	mtstate->mt_bufferedBytes = 0;
+
+	estate->es_result_relation_info = saved_resultRelInfo;
+}
+
 /* ----------------------------------------------------------------
  *		ExecDelete
  *
@@ -609,11 +712,11 @@ ExecDelete(ItemPointer tupleid,
 		 * mode transactions.
 		 */
 ldelete:;
-		result = heap_delete(resultRelationDesc, tupleid,
-							 estate->es_output_cid,
-							 estate->es_crosscheck_snapshot,
-							 true /* wait for commit */ ,
-							 &hufd);
+		result = table_delete(resultRelationDesc, tupleid,
+							  estate->es_output_cid,
+							  estate->es_crosscheck_snapshot,
+							  true /* wait for commit */ ,
+							  &hufd);
 		switch (result)
 		{
 			case HeapTupleSelfUpdated:
@@ -728,8 +831,8 @@ ldelete:;
 			else
 			{
 				deltuple.t_self = *tupleid;
-				if (!heap_fetch(resultRelationDesc, SnapshotAny,
-								&deltuple, &delbuffer, false, NULL))
+				if (!table_fetch(resultRelationDesc, SnapshotAny,
+								 &deltuple, &delbuffer, false, NULL))
 					elog(ERROR, "failed to fetch deleted tuple for DELETE RETURNING");
 			}
 
@@ -904,11 +1007,11 @@ lreplace:;
 		 * needed for referential integrity updates in transaction-snapshot
 		 * mode transactions.
 		 */
-		result = heap_update(resultRelationDesc, tupleid, tuple,
-							 estate->es_output_cid,
-							 estate->es_crosscheck_snapshot,
-							 true /* wait for commit */ ,
-							 &hufd, &lockmode);
+		result = table_update(resultRelationDesc, tupleid, tuple,
+							  estate->es_output_cid,
+							  estate->es_crosscheck_snapshot,
+							  true /* wait for commit */ ,
+							  &hufd, &lockmode);
 		switch (result)
 		{
 			case HeapTupleSelfUpdated:
@@ -991,7 +1094,7 @@ lreplace:;
 		/*
 		 * insert index entries for tuple
 		 *
-		 * Note: heap_update returns the tid (location) of the new tuple in
+		 * Note: table_update returns the tid (location) of the new tuple in
 		 * the t_self field.
 		 *
 		 * If it's a HOT update, we mustn't insert new index entries.
@@ -1299,6 +1402,7 @@ ExecModifyTable(ModifyTableState *node)
 	ItemPointerData tuple_ctid;
 	HeapTupleData oldtupdata;
 	HeapTuple	oldtuple;
+	int			i;
 
 	/*
 	 * This should NOT get called during EvalPlanQual; we should have passed a
@@ -1490,6 +1594,22 @@ ExecModifyTable(ModifyTableState *node)
 	/* Restore es_result_relation_info before exiting */
 	estate->es_result_relation_info = saved_resultRelInfo;
 
+	/* Write out any rows still buffered for heap_multi_insert */
+	if (node->mt_multiInsert)
+		ExecFlushBufferedInserts(node, estate);
+
+	/* ... and let access methods that buffer rows themselves do the same */
+	if (operation == CMD_INSERT)
+	{
+		for (i = 0; i < node->mt_nplans; i++)
+		{
+			Relation	rel = node->resultRelInfo[i].ri_RelationDesc;
+
+			if (rel->rd_rel->relkind == RELKIND_RELATION)
+				table_finish_bulk_insert(rel, 0);
+		}
+	}
+
 	/*
 	 * We're done, but fire AFTER STATEMENT triggers before exiting.
 	 */
@@ -1874,6 +1994,41 @@ ExecInitModifyTable(ModifyTable *node, EState *estate, int eflags)
 	if (estate->es_trig_tuple_slot == NULL)
 		estate->es_trig_tuple_slot = ExecInitExtraTupleSlot(estate);
 
+	/*
+	 * Decide whether an INSERT can buffer its rows and write them with
+	 * heap_multi_insert.  The planner has checked the query itself; but
+	 * BEFORE or INSTEAD OF row triggers might look at the table and expect
+	 * to see the rows processed so far, like volatile functions could.  We
+	 * also leave WITH CHECK OPTIONs, which are checked after each insertion,
+	 * and anything but plain tables to the row-at-a-time code.  AFTER ROW
+	 * triggers are only queued, so they don't get in the way.
+	 */
+	resultRelInfo = mtstate->resultRelInfo;
+	if (node->canMultiInsert && nplans == 1 &&
+		resultRelInfo->ri_RelationDesc->rd_rel->relkind == RELKIND_RELATION &&
+		resultRelInfo->ri_FdwRoutine == NULL &&
+		resultRelInfo->ri_WithCheckOptions == NIL &&
+		resultRelInfo->ri_projectReturning == NULL &&
+		!(resultRelInfo->ri_TrigDesc &&
+		  (resultRelInfo->ri_TrigDesc->trig_insert_before_row ||
+		   resultRelInfo->ri_TrigDesc->trig_insert_instead_row)))
+	{
+		mtstate->mt_multiInsert = true;
+		mtstate->mt_bufferedTuples = (HeapTuple *)
+			palloc(MAX_BUFFERED_TUPLES * sizeof(HeapTuple));
+		mtstate->mt_nBufferedTuples = 0;
+		mtstate->mt_bufferedBytes = 0;
+		mtstate->mt_batchcxt = AllocSetContextCreate(CurrentMemoryContext,
+													 "ModifyTable batch",
+												  ALLOCSET_DEFAULT_MINSIZE,
+												 ALLOCSET_DEFAULT_INITSIZE,
+												 ALLOCSET_DEFAULT_MAXSIZE);
+		mtstate->mt_bistate = GetBulkInsertState();
+		mtstate->mt_batchslot = ExecInitExtraTupleSlot(estate);
+		ExecSetSlotDescriptor(mtstate->mt_batchslot,
+							  RelationGetDescr(resultRelInfo->ri_RelationDesc));
+	}
+
 	/*
 	 * Lastly, if this is not the primary (canSetTag) ModifyTable node, add it
 	 * to estate->es_auxmodifytables so that it will be run to completion by
@@ -1916,6 +2071,17 @@ ExecEndModifyTable(ModifyTableState *node)
 														   resultRelInfo);
 	}
 
+	/*
+	 * Release the bulk-insert buffer.  Any rows not yet flushed will never be
+	 * written, but we only get here without having run to completion if the
+	 * query is being abandoned anyway.
+	 */
+	if (node->mt_multiInsert)
+	{
+		FreeBulkInsertState(node->mt_bistate);
+		MemoryContextDelete(node->mt_batchcxt);
+	}
+
 	/*
 	 * Free the exprcontext
 	 */
@@ -122,6 +122,13 @@ InitScanRelation(SampleScanState *node, EState *estate, int eflags)
 						   ((SampleScan *) node->ss.ps.plan)->scan.scanrelid,
 										   eflags);
 
+	/* sampling reads the heap's pages directly */
+	if (!RelationUsesHeapAM(currentRelation))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("TABLESAMPLE is not supported for table \"%s\" because it does not use the heap access method",
+						RelationGetRelationName(currentRelation))));
+
 	node->ss.ss_currentRelation = currentRelation;
 
 	/* we won't set up the HeapScanDesc till later */
@@ -23,11 +23,20 @@
 #include "postgres.h"
 
 #include "access/relscan.h"
+#include "access/sysattr.h"
+#include "access/tableam.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/var.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/typcache.h"
 
 static void InitScanRelation(SeqScanState *node, EState *estate, int eflags);
+static int	SeqScanBuildKeys(SeqScan *plan, Relation rel, ScanKey *keys);
+static Bitmapset *SeqScanProjectedColumns(SeqScan *plan, bool *wholerow);
 static TupleTableSlot *SeqNext(SeqScanState *node);
 
 /* ----------------------------------------------------------------
@@ -61,13 +70,13 @@ SeqNext(SeqScanState *node)
 	/*
 	 * get the next tuple from the table
 	 */
-	tuple = heap_getnext(scandesc, direction);
+	tuple = table_getnext(scandesc, direction);
 
 	/*
 	 * save the tuple and the buffer returned to us by the access methods in
 	 * our scan tuple slot and return the slot.  Note: we pass 'false' because
-	 * tuples returned by heap_getnext() are pointers onto disk pages and were
-	 * not created with palloc() and so should not be pfree()'d.  Note also
+	 * tuples returned by table_getnext() belong to the scan (for a heap, they
+	 * are pointers onto disk pages) and so should not be pfree()'d.  Note also
 	 * that ExecStoreTuple will increment the refcount of the buffer; the
 	 * refcount will not be dropped until the tuple table slot is cleared.
 	 */
@@ -92,6 +101,8 @@ SeqRecheck(SeqScanState *node, TupleTableSlot *slot)
 	/*
 	 * Note that unlike IndexScan, SeqScan never use keys in heap_beginscan
 	 * (and this is very bad) - so, here we do not check are keys ok or not.
+	 * The keys other access methods get only let them skip rows; the quals
+	 * are checked anyway.
 	 */
 	return true;
 }
@@ -113,6 +124,134 @@ ExecSeqScan(SeqScanState *node)
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/* ----------------------------------------------------------------
+ *		SeqScanBuildKeys
+ *
+ *		Turn the "column op constant" clauses of the node's quals that use
+ *		an operator of the column type's default btree opclass into scan
+ *		keys, with btree strategy numbers.  Access methods other than the
+ *		heap may use them to skip parts of the table; the quals are still
+ *		checked on every tuple returned.
+ * ----------------------------------------------------------------
+ */
+static int
+SeqScanBuildKeys(SeqScan *plan, Relation rel, ScanKey *keys)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	ScanKey		scankeys;
+	int			nkeys = 0;
+	ListCell   *lc;
+
+	scankeys = (ScanKey) palloc(Max(list_length(plan->plan.qual), 1) *
+								sizeof(ScanKeyData));
+
+	foreach(lc, plan->plan.qual)
+	{
+		Expr	   *clause = (Expr *) lfirst(lc);
+		OpExpr	   *op;
+		Node	   *leftop;
+		Node	   *rightop;
+		Var		   *var;
+		Const	   *con;
+		Oid			opno;
+		Form_pg_attribute att;
+		TypeCacheEntry *typentry;
+		int			strategy;
+		Oid			lefttype;
+		Oid			righttype;
+
+		if (!is_opclause(clause) || list_length(((OpExpr *) clause)->args) != 2)
+			continue;
+		op = (OpExpr *) clause;
+		opno = op->opno;
+		leftop = get_leftop(clause);
+		rightop = get_rightop(clause);
+
+		if (IsA(leftop, Var) && IsA(rightop, Const))
+		{
+			var = (Var *) leftop;
+			con = (Const *) rightop;
+		}
+		else if (IsA(rightop, Var) && IsA(leftop, Const))
+		{
+			/* put the column on the left */
+			var = (Var *) rightop;
+			con = (Const *) leftop;
+			opno = get_commutator(opno);
+			if (!OidIsValid(opno))
+				continue;
+		}
+		else
+			continue;
+
+		if (var->varno != plan->scanrelid || var->varlevelsup != 0 ||
+			var->varattno <= 0 || var->varattno > tupdesc->natts ||
+			con->constisnull)
+			continue;
+		att = tupdesc->attrs[var->varattno - 1];
+		if (var->vartype != att->atttypid || con->consttype != att->atttypid ||
+			op->inputcollid != att->attcollation)
+			continue;
+
+		typentry = lookup_type_cache(att->atttypid, TYPECACHE_BTREE_OPFAMILY);
+		if (!OidIsValid(typentry->btree_opf) ||
+			!op_in_opfamily(opno, typentry->btree_opf))
+			continue;
+		get_op_opfamily_properties(opno, typentry->btree_opf, false,
+								   &strategy, &lefttype, &righttype);
+		if (lefttype != att->atttypid || righttype != att->atttypid)
+			continue;
+
+		ScanKeyEntryInitialize(&scankeys[nkeys++],
+							   0,
+							   var->varattno,
+							   (StrategyNumber) strategy,
+							   righttype,
+							   op->inputcollid,
+							   get_opcode(opno),
+							   con->constvalue);
+	}
+
+	*keys = scankeys;
+	return nkeys;
+}
+
+/* ----------------------------------------------------------------
+ *		SeqScanProjectedColumns
+ *
+ *		Return the set of columns the node's targetlist and quals use.
+ *		*wholerow is set if they need all of them.
+ * ----------------------------------------------------------------
+ */
+static Bitmapset *
+SeqScanProjectedColumns(SeqScan *plan, bool *wholerow)
+{
+	Bitmapset  *varattnos = NULL;
+	Bitmapset  *attrs = NULL;
+	int			i;
+
+	*wholerow = false;
+
+	pull_varattnos((Node *) plan->plan.targetlist, plan->scanrelid,
+				   &varattnos);
+	pull_varattnos((Node *) plan->plan.qual, plan->scanrelid, &varattnos);
+
+	i = -1;
+	while ((i = bms_next_member(varattnos, i)) >= 0)
+	{
+		AttrNumber	attno = i + FirstLowInvalidHeapAttributeNumber;
+
+		/* a whole-row reference needs every column */
+		if (attno == InvalidAttrNumber)
+			*wholerow = true;
+		else if (attno > 0)
+			attrs = bms_add_member(attrs, attno);
+	}
+	bms_free(varattnos);
+
+	return attrs;
+}
+
 /* ----------------------------------------------------------------
  *		InitScanRelation
  *
@@ -122,22 +261,46 @@ ExecSeqScan(SeqScanState *node)
 static void
 InitScanRelation(SeqScanState *node, EState *estate, int eflags)
 {
+	SeqScan    *plan = (SeqScan *) node->ps.plan;
 	Relation	currentRelation;
 	HeapScanDesc currentScanDesc;
+	ScanKey		keys = NULL;
+	int			nkeys = 0;
 
 	/*
 	 * get the relation object id from the relid'th entry in the range table,
 	 * open that relation and acquire appropriate lock on it.
 	 */
 	currentRelation = ExecOpenScanRelation(estate,
-									  ((SeqScan *) node->ps.plan)->scanrelid,
+										   plan->scanrelid,
 										   eflags);
 
-	/* initialize a heapscan */
-	currentScanDesc = heap_beginscan(currentRelation,
-									 estate->es_snapshot,
-									 0,
-									 NULL);
+	/*
+	 * Heap scans can't skip anything, so only other access methods get scan
+	 * keys built from the quals.
+	 */
+	if (!RelationUsesHeapAM(currentRelation))
+		nkeys = SeqScanBuildKeys(plan, currentRelation, &keys);
+
+	/* initialize a scan through the table's access method */
+	currentScanDesc = table_beginscan(currentRelation,
+									  estate->es_snapshot,
+									  nkeys,
+									  keys);
+	if (keys != NULL)
+		pfree(keys);
+
+	/* let the access method skip columns we won't look at */
+	if (!RelationUsesHeapAM(currentRelation))
+	{
+		Bitmapset  *attrs;
+		bool		wholerow;
+
+		attrs = SeqScanProjectedColumns(plan, &wholerow);
+		if (!wholerow)
+			table_scan_set_columns(currentScanDesc, attrs);
+		bms_free(attrs);
+	}
 
 	node->ss_currentRelation = currentRelation;
 	node->ss_currentScanDesc = currentScanDesc;
@@ -241,7 +404,7 @@ ExecEndSeqScan(SeqScanState *node)
 	/*
 	 * close heap scan
 	 */
-	heap_endscan(scanDesc);
+	table_endscan(scanDesc);
 
 	/*
 	 * close the heap relation.
@@ -267,8 +430,8 @@ ExecReScanSeqScan(SeqScanState *node)
 
 	scan = node->ss_currentScanDesc;
 
-	heap_rescan(scan,			/* scan desc */
-				NULL);			/* new scan keys */
+	table_rescan(scan,			/* scan desc */
+				 NULL);			/* new scan keys */
 
 	ExecScanReScan((ScanState *) node);
 }
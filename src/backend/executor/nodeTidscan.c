@@ -23,6 +23,7 @@
 #include "postgres.h"
 
 #include "access/sysattr.h"
+#include "access/tableam.h"
 #include "catalog/pg_type.h"
 #include "executor/execdebug.h"
 #include "executor/nodeTidscan.h"
@@ -64,9 +65,13 @@ TidListCreate(TidScanState *tidstate)
 	 * We silently discard any TIDs that are out of range at the time of scan
 	 * start.  (Since we hold at least AccessShareLock on the table, it won't
 	 * be possible for someone to truncate away the blocks we intend to
-	 * visit.)
+	 * visit.)  The block numbers of other access methods' TIDs need not
+	 * have anything to do with the relation's size, though.
 	 */
-	nblocks = RelationGetNumberOfBlocks(tidstate->ss.ss_currentRelation);
+	if (RelationUsesHeapAM(tidstate->ss.ss_currentRelation))
+		nblocks = RelationGetNumberOfBlocks(tidstate->ss.ss_currentRelation);
+	else
+		nblocks = InvalidBlockNumber;
 
 	/*
 	 * We initialize the array with enough slots for the case that all quals
@@ -316,9 +321,9 @@ TidNext(TidScanState *node)
 		 * current according to our snapshot.
 		 */
 		if (node->tss_isCurrentOf)
-			heap_get_latest_tid(heapRelation, snapshot, &tuple->t_self);
+			table_get_latest_tid(heapRelation, snapshot, &tuple->t_self);
 
-		if (heap_fetch(heapRelation, snapshot, tuple, &buffer, false, NULL))
+		if (table_fetch(heapRelation, snapshot, tuple, &buffer, false, NULL))
 		{
 			/*
 			 * store the scanned tuple in the scan tuple slot of the scan
@@ -335,8 +340,11 @@ TidNext(TidScanState *node)
 			/*
 			 * At this point we have an extra pin on the buffer, because
 			 * ExecStoreTuple incremented the pin count. Drop our local pin.
+			 * (Access methods other than the heap may return tuples that
+			 * aren't in a buffer at all.)
 			 */
-			ReleaseBuffer(buffer);
+			if (BufferIsValid(buffer))
+				ReleaseBuffer(buffer);
 
 			return slot;
 		}
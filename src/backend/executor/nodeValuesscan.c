@@ -28,6 +28,7 @@
 
 
 static TupleTableSlot *ValuesNext(ValuesScanState *node);
+static bool ValuesRowIsConsts(List *exprlist);
 
 
 /* ----------------------------------------------------------------
@@ -104,6 +105,31 @@ ValuesNext(ValuesScanState *node)
 		 */
 		ReScanExprContext(econtext);
 
+		/*
+		 * If the row is all Consts, as the rows of a long INSERT ... VALUES
+		 * list usually are, just point the slot at their values; they live
+		 * in the plan, which outlasts the tuple.
+		 */
+		if (ValuesRowIsConsts(exprlist))
+		{
+			Assert(list_length(exprlist) == slot->tts_tupleDescriptor->natts);
+
+			values = slot->tts_values;
+			isnull = slot->tts_isnull;
+
+			resind = 0;
+			foreach(lc, exprlist)
+			{
+				Const	   *con = (Const *) lfirst(lc);
+
+				values[resind] = con->constvalue;
+				isnull[resind] = con->constisnull;
+				resind++;
+			}
+
+			return ExecStoreVirtualTuple(slot);
+		}
+
 		/*
 		 * Build the expression eval state in the econtext's per-tuple memory.
 		 * This is a tad unusual, but we want to delete the eval state again
@@ -153,6 +179,22 @@ ValuesNext(ValuesScanState *node)
 	return slot;
 }
 
+/*
+ * ValuesRowIsConsts -- is every item of a values sublist a Const?
+ */
+static bool
+ValuesRowIsConsts(List *exprlist)
+{
+	ListCell   *lc;
+
+	foreach(lc, exprlist)
+	{
+		if (!IsA(lfirst(lc), Const))
+			return false;
+	}
+	return true;
+}
+
 /*
  * ValuesRecheck -- access method routine to recheck a tuple in EvalPlanQual
  */
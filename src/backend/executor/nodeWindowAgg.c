@@ -37,6 +37,7 @@
 #include "catalog/objectaccess.h"
 #include "catalog/pg_aggregate.h"
 #include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
 #include "executor/executor.h"
 #include "executor/nodeWindowAgg.h"
 #include "miscadmin.h"
@@ -154,6 +155,24 @@ typedef struct WindowStatePerAggData
 
 	/* Data local to eval_windowaggregates() */
 	bool		restart;		/* need to restart this agg in this cycle? */
+
+	/*
+	 * Aggregates without an inverse transition function, but with a combine
+	 * function, can still be evaluated over a moving frame without restarting
+	 * at each row; see slide_windowaggregate().  Rows from frameheadpos to
+	 * frontEnd are then covered by the "front" values below, the rest of the
+	 * frame by transValue.  frontValues[k] is the combined transition value
+	 * of the rows from frontStart + k to frontEnd - 1, and lives in
+	 * frontcontext.
+	 */
+	bool		sliding;		/* use the front values? */
+	Oid			combinefn_oid;	/* valid if sliding */
+	FmgrInfo	combinefn;
+	MemoryContext frontcontext; /* valid if sliding */
+	Datum	   *frontValues;
+	bool	   *frontIsNull;
+	int64		frontStart;
+	int64		frontEnd;
 } WindowStatePerAggData;
 
 static void initialize_windowaggregate(WindowAggState *winstate,
@@ -165,6 +184,15 @@ static void advance_windowaggregate(WindowAggState *winstate,
 static bool advance_windowaggregate_base(WindowAggState *winstate,
 							 WindowStatePerFunc perfuncstate,
 							 WindowStatePerAgg peraggstate);
+static void combine_windowaggregate(WindowAggState *winstate,
+						WindowStatePerFunc perfuncstate,
+						WindowStatePerAgg peraggstate,
+						Datum *value, bool *isnull,
+						Datum other, bool otherisnull,
+						MemoryContext context);
+static void slide_windowaggregate(WindowAggState *winstate,
+					  WindowStatePerFunc perfuncstate,
+					  WindowStatePerAgg peraggstate);
 static void finalize_windowaggregate(WindowAggState *winstate,
 						 WindowStatePerFunc perfuncstate,
 						 WindowStatePerAgg peraggstate,
@@ -228,6 +256,16 @@ initialize_windowaggregate(WindowAggState *winstate,
 	peraggstate->transValueCount = 0;
 	peraggstate->resultValue = (Datum) 0;
 	peraggstate->resultValueIsNull = true;
+
+	/* A restarted sliding aggregate has no front rows */
+	if (peraggstate->sliding)
+	{
+		MemoryContextResetAndDeleteChildren(peraggstate->frontcontext);
+		peraggstate->frontValues = NULL;
+		peraggstate->frontIsNull = NULL;
+		peraggstate->frontStart = winstate->frameheadpos;
+		peraggstate->frontEnd = winstate->frameheadpos;
+	}
 }
 
 /*
@@ -540,6 +578,189 @@ advance_windowaggregate_base(WindowAggState *winstate,
 	return true;
 }
 
+/*
+ * combine_windowaggregate
+ * Combine the transition value "other" into *value.
+ *
+ * *value must be our own copy, allocated in "context" if pass-by-ref, since
+ * combine functions are allowed to modify their first input in place.  The
+ * result replaces it, again in "context".  "other" is not changed.
+ */
+static void
+combine_windowaggregate(WindowAggState *winstate,
+						WindowStatePerFunc perfuncstate,
+						WindowStatePerAgg peraggstate,
+						Datum *value, bool *isnull,
+						Datum other, bool otherisnull,
+						MemoryContext context)
+{
+	FunctionCallInfoData fcinfo;
+	MemoryContext oldContext;
+	Datum		newVal;
+
+	if (peraggstate->combinefn.fn_strict)
+	{
+		/*
+		 * Like a strict transition function, a strict combine function is not
+		 * called for NULL inputs; a NULL state just means no rows yet.
+		 */
+		if (otherisnull)
+			return;
+		if (*isnull)
+		{
+			oldContext = MemoryContextSwitchTo(context);
+			*value = datumCopy(other,
+							   peraggstate->transtypeByVal,
+							   peraggstate->transtypeLen);
+			*isnull = false;
+			MemoryContextSwitchTo(oldContext);
+			return;
+		}
+	}
+
+	oldContext = MemoryContextSwitchTo(winstate->tmpcontext->ecxt_per_tuple_memory);
+
+	InitFunctionCallInfoData(fcinfo, &(peraggstate->combinefn),
+							 2,
+							 perfuncstate->winCollation,
+							 (void *) winstate, NULL);
+	fcinfo.arg[0] = *value;
+	fcinfo.argnull[0] = *isnull;
+	fcinfo.arg[1] = other;
+	fcinfo.argnull[1] = otherisnull;
+	winstate->curaggcontext = context;
+	newVal = FunctionCallInvoke(&fcinfo);
+	winstate->curaggcontext = NULL;
+
+	/* As in advance_windowaggregate, keep the result in the right context */
+	if (!peraggstate->transtypeByVal &&
+		DatumGetPointer(newVal) != DatumGetPointer(*value))
+	{
+		if (!fcinfo.isnull)
+		{
+			MemoryContextSwitchTo(context);
+			newVal = datumCopy(newVal,
+							   peraggstate->transtypeByVal,
+							   peraggstate->transtypeLen);
+		}
+		if (!*isnull)
+			pfree(DatumGetPointer(*value));
+	}
+
+	MemoryContextSwitchTo(oldContext);
+	*value = newVal;
+	*isnull = fcinfo.isnull;
+}
+
+/*
+ * slide_windowaggregate
+ * Move the rows of transValue to the front of a sliding aggregate.
+ *
+ * This is called once the frame head has moved past all the front rows, so
+ * that rows can't be removed from the frame any other way.  We compute the
+ * transition value of each remaining row separately, and combine them from
+ * the last one backwards, so that frontValues[k] covers the rows from k to
+ * the end; each position the frame head can take then has its value ready.
+ * transValue starts over empty, to collect the rows that will be added at
+ * the end of the frame.
+ *
+ * This is the "two-stack" method of sliding-window aggregation: each row is
+ * moved to the front only once, so evaluating a frame of any size costs a
+ * constant number of transition and combine function calls per row, on
+ * average, instead of a number proportional to the frame size.
+ */
+static void
+slide_windowaggregate(WindowAggState *winstate,
+					  WindowStatePerFunc perfuncstate,
+					  WindowStatePerAgg peraggstate)
+{
+	WindowObject agg_winobj = winstate->agg_winobj;
+	TupleTableSlot *temp_slot = winstate->temp_slot_1;
+	MemoryContext aggcontext = peraggstate->aggcontext;
+	MemoryContext oldContext;
+	int64		nrows;
+	int64		k;
+
+	Assert(peraggstate->sliding);
+	Assert(winstate->frameheadpos > peraggstate->frontEnd);
+	Assert(winstate->frameheadpos < winstate->aggregatedupto);
+
+	/* All the old front rows are gone */
+	MemoryContextResetAndDeleteChildren(peraggstate->frontcontext);
+
+	nrows = winstate->aggregatedupto - winstate->frameheadpos;
+	peraggstate->frontValues = (Datum *)
+		MemoryContextAllocHuge(peraggstate->frontcontext,
+							   nrows * sizeof(Datum));
+	peraggstate->frontIsNull = (bool *)
+		MemoryContextAllocHuge(peraggstate->frontcontext,
+							   nrows * sizeof(bool));
+
+	/*
+	 * Aggregate each row on its own, building the values directly in
+	 * frontcontext.
+	 */
+	peraggstate->aggcontext = peraggstate->frontcontext;
+	for (k = 0; k < nrows; k++)
+	{
+		if (!window_gettupleslot(agg_winobj, winstate->frameheadpos + k,
+								 temp_slot))
+			elog(ERROR, "could not re-fetch previously fetched frame row");
+
+		if (peraggstate->initValueIsNull)
+			peraggstate->transValue = peraggstate->initValue;
+		else
+		{
+			oldContext = MemoryContextSwitchTo(peraggstate->frontcontext);
+			peraggstate->transValue = datumCopy(peraggstate->initValue,
+												peraggstate->transtypeByVal,
+												peraggstate->transtypeLen);
+			MemoryContextSwitchTo(oldContext);
+		}
+		peraggstate->transValueIsNull = peraggstate->initValueIsNull;
+		peraggstate->transValueCount = 0;
+
+		winstate->tmpcontext->ecxt_outertuple = temp_slot;
+		advance_windowaggregate(winstate, perfuncstate, peraggstate);
+		ResetExprContext(winstate->tmpcontext);
+
+		peraggstate->frontValues[k] = peraggstate->transValue;
+		peraggstate->frontIsNull[k] = peraggstate->transValueIsNull;
+	}
+	peraggstate->aggcontext = aggcontext;
+	ExecClearTuple(temp_slot);
+
+	/* Now accumulate them from the end */
+	for (k = nrows - 2; k >= 0; k--)
+	{
+		combine_windowaggregate(winstate, perfuncstate, peraggstate,
+								&peraggstate->frontValues[k],
+								&peraggstate->frontIsNull[k],
+								peraggstate->frontValues[k + 1],
+								peraggstate->frontIsNull[k + 1],
+								peraggstate->frontcontext);
+		ResetExprContext(winstate->tmpcontext);
+	}
+
+	peraggstate->frontStart = winstate->frameheadpos;
+	peraggstate->frontEnd = winstate->aggregatedupto;
+
+	/* Empty transValue; the caller already discarded the saved result */
+	MemoryContextResetAndDeleteChildren(aggcontext);
+	if (peraggstate->initValueIsNull)
+		peraggstate->transValue = peraggstate->initValue;
+	else
+	{
+		oldContext = MemoryContextSwitchTo(aggcontext);
+		peraggstate->transValue = datumCopy(peraggstate->initValue,
+											peraggstate->transtypeByVal,
+											peraggstate->transtypeLen);
+		MemoryContextSwitchTo(oldContext);
+	}
+	peraggstate->transValueIsNull = peraggstate->initValueIsNull;
+	peraggstate->transValueCount = 0;
+}
+
 /*
  * finalize_windowaggregate
  * parallel to finalize_aggregate in nodeAgg.c
@@ -630,6 +851,7 @@ eval_windowaggregates(WindowAggState *winstate)
 	int			wfuncno,
 				numaggs,
 				numaggs_restart,
+				numaggs_sliding,
 				i;
 	int64		aggregatedupto_nonrestarted;
 	MemoryContext oldContext;
@@ -676,6 +898,11 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * must perform the aggregation all over again for all tuples within the
 	 * new frame boundaries.
 	 *
+	 * Aggregates that have no inverse transition function, but do have a
+	 * combine function, like min() and max(), are instead evaluated as
+	 * "sliding" aggregates; see slide_windowaggregate().  They never need to
+	 * restart just because the frame head moved.
+	 *
 	 * In many common cases, multiple rows share the same frame and hence the
 	 * same aggregate value. (In particular, if there's no ORDER BY in a RANGE
 	 * window, then all rows are peers and so they all have window frame equal
@@ -740,19 +967,25 @@ eval_windowaggregates(WindowAggState *winstate)
 	 *----------
 	 */
 	numaggs_restart = 0;
+	numaggs_sliding = 0;
 	for (i = 0; i < numaggs; i++)
 	{
 		peraggstate = &winstate->peragg[i];
 		if (winstate->currentpos == 0 ||
 			(winstate->aggregatedbase != winstate->frameheadpos &&
-			 !OidIsValid(peraggstate->invtransfn_oid)) ||
+			 !OidIsValid(peraggstate->invtransfn_oid) &&
+			 !peraggstate->sliding) ||
 			winstate->aggregatedupto <= winstate->frameheadpos)
 		{
 			peraggstate->restart = true;
 			numaggs_restart++;
 		}
 		else
+		{
 			peraggstate->restart = false;
+			if (peraggstate->sliding)
+				numaggs_sliding++;
+		}
 	}
 
 	/*
@@ -760,9 +993,10 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * aggregatedbase to match the frame's head by removing input rows that
 	 * fell off the top of the frame from the aggregations.  This can fail,
 	 * i.e. advance_windowaggregate_base() can return false, in which case
-	 * we'll restart that aggregate below.
+	 * we'll restart that aggregate below.  Sliding aggregates don't need
+	 * this.
 	 */
-	while (numaggs_restart < numaggs &&
+	while (numaggs_restart + numaggs_sliding < numaggs &&
 		   winstate->aggregatedbase < winstate->frameheadpos)
 	{
 		/*
@@ -785,7 +1019,7 @@ eval_windowaggregates(WindowAggState *winstate)
 			bool		ok;
 
 			peraggstate = &winstate->peragg[i];
-			if (peraggstate->restart)
+			if (peraggstate->restart || peraggstate->sliding)
 				continue;
 
 			wfuncno = peraggstate->wfuncno;
@@ -859,6 +1093,22 @@ eval_windowaggregates(WindowAggState *winstate)
 		}
 	}
 
+	/*
+	 * Sliding aggregates whose frame head has moved past their front rows
+	 * must now move the remaining rows to the front.
+	 */
+	for (i = 0; i < numaggs; i++)
+	{
+		peraggstate = &winstate->peragg[i];
+		if (peraggstate->sliding && !peraggstate->restart &&
+			winstate->frameheadpos > peraggstate->frontEnd)
+		{
+			wfuncno = peraggstate->wfuncno;
+			slide_windowaggregate(winstate, &winstate->perfunc[wfuncno],
+								  peraggstate);
+		}
+	}
+
 	/*
 	 * Non-restarted aggregates now contain the rows between aggregatedbase
 	 * (i.e., frameheadpos) and aggregatedupto, while restarted aggregates
@@ -940,10 +1190,52 @@ eval_windowaggregates(WindowAggState *winstate)
 		wfuncno = peraggstate->wfuncno;
 		result = &econtext->ecxt_aggvalues[wfuncno];
 		isnull = &econtext->ecxt_aggnulls[wfuncno];
-		finalize_windowaggregate(winstate,
-								 &winstate->perfunc[wfuncno],
-								 peraggstate,
-								 result, isnull);
+
+		if (peraggstate->sliding &&
+			winstate->frameheadpos < peraggstate->frontEnd)
+		{
+			/*
+			 * The frame starts within the front rows, so finalize the
+			 * combination of their value and transValue instead.
+			 */
+			int64		k = winstate->frameheadpos - peraggstate->frontStart;
+			Datum		backValue = peraggstate->transValue;
+			bool		backIsNull = peraggstate->transValueIsNull;
+			Datum		value = peraggstate->frontValues[k];
+			bool		valueIsNull = peraggstate->frontIsNull[k];
+
+			if (peraggstate->transValueCount > 0)
+			{
+				MemoryContext tmpcxt = winstate->tmpcontext->ecxt_per_tuple_memory;
+
+				if (!valueIsNull)
+				{
+					oldContext = MemoryContextSwitchTo(tmpcxt);
+					value = datumCopy(value,
+									  peraggstate->transtypeByVal,
+									  peraggstate->transtypeLen);
+					MemoryContextSwitchTo(oldContext);
+				}
+				combine_windowaggregate(winstate, &winstate->perfunc[wfuncno],
+										peraggstate, &value, &valueIsNull,
+										backValue, backIsNull, tmpcxt);
+			}
+
+			peraggstate->transValue = value;
+			peraggstate->transValueIsNull = valueIsNull;
+			finalize_windowaggregate(winstate,
+									 &winstate->perfunc[wfuncno],
+									 peraggstate,
+									 result, isnull);
+			peraggstate->transValue = backValue;
+			peraggstate->transValueIsNull = backIsNull;
+			ResetExprContext(winstate->tmpcontext);
+		}
+		else
+			finalize_windowaggregate(winstate,
+									 &winstate->perfunc[wfuncno],
+									 peraggstate,
+									 result, isnull);
 
 		/*
 		 * save the result in case next row shares the same frame.
@@ -1225,6 +1517,8 @@ release_partition(WindowAggState *winstate)
 	{
 		if (winstate->peragg[i].aggcontext != winstate->aggcontext)
 			MemoryContextResetAndDeleteChildren(winstate->peragg[i].aggcontext);
+		if (winstate->peragg[i].sliding)
+			MemoryContextResetAndDeleteChildren(winstate->peragg[i].frontcontext);
 	}
 
 	if (winstate->buffer)
@@ -2039,6 +2333,8 @@ ExecEndWindowAgg(WindowAggState *node)
 	{
 		if (node->peragg[i].aggcontext != node->aggcontext)
 			MemoryContextDelete(node->peragg[i].aggcontext);
+		if (node->peragg[i].sliding)
+			MemoryContextDelete(node->peragg[i].frontcontext);
 	}
 	MemoryContextDelete(node->partcontext);
 	MemoryContextDelete(node->aggcontext);
@@ -2159,6 +2455,25 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 		initvalAttNo = Anum_pg_aggregate_agginitval;
 	}
 
+	/*
+	 * Failing that, a combine function lets us evaluate the aggregate as a
+	 * sliding aggregate, under the same conditions.  We need to copy
+	 * transition values, so an internal transtype won't do; nor do we have
+	 * expression trees to resolve a polymorphic combine function with.
+	 */
+	peraggstate->combinefn_oid = InvalidOid;
+	peraggstate->sliding = false;
+	if (!OidIsValid(invtransfn_oid) &&
+		OidIsValid(aggform->aggcombinefn) &&
+		aggtranstype != INTERNALOID &&
+		!IsPolymorphicType(aggtranstype) &&
+		!(winstate->frameOptions & FRAMEOPTION_START_UNBOUNDED_PRECEDING) &&
+		!contain_volatile_functions((Node *) wfunc))
+	{
+		peraggstate->combinefn_oid = aggform->aggcombinefn;
+		peraggstate->sliding = true;
+	}
+
 	/*
 	 * ExecInitWindowAgg already checked permission to call aggregate function
 	 * ... but we still need to check the component functions
@@ -2203,6 +2518,16 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 							   get_func_name(finalfn_oid));
 			InvokeFunctionExecuteHook(finalfn_oid);
 		}
+
+		if (peraggstate->sliding)
+		{
+			aclresult = pg_proc_aclcheck(peraggstate->combinefn_oid, aggOwner,
+										 ACL_EXECUTE);
+			if (aclresult != ACLCHECK_OK)
+				aclcheck_error(aclresult, ACL_KIND_PROC,
+							   get_func_name(peraggstate->combinefn_oid));
+			InvokeFunctionExecuteHook(peraggstate->combinefn_oid);
+		}
 	}
 
 	/* Detect how many arguments to pass to the finalfn */
@@ -2249,6 +2574,9 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 		fmgr_info_set_expr((Node *) finalfnexpr, &peraggstate->finalfn);
 	}
 
+	if (peraggstate->sliding)
+		fmgr_info(peraggstate->combinefn_oid, &peraggstate->combinefn);
+
 	/* get info about relevant datatypes */
 	get_typlenbyval(wfunc->wintype,
 					&peraggstate->resulttypeLen,
@@ -2315,7 +2643,7 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	 * they have historically been for plain aggregates, but that seems grotty
 	 * and likely to lead to memory leaks.
 	 */
-	if (OidIsValid(invtransfn_oid))
+	if (OidIsValid(invtransfn_oid) || peraggstate->sliding)
 		peraggstate->aggcontext =
 			AllocSetContextCreate(CurrentMemoryContext,
 								  "WindowAgg_AggregatePrivate",
@@ -2325,6 +2653,19 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	else
 		peraggstate->aggcontext = winstate->aggcontext;
 
+	/* Sliding aggregates keep their front values apart from transValue */
+	if (peraggstate->sliding)
+		peraggstate->frontcontext =
+			AllocSetContextCreate(CurrentMemoryContext,
+								  "WindowAgg_AggregateFront",
+								  ALLOCSET_DEFAULT_MINSIZE,
+								  ALLOCSET_DEFAULT_INITSIZE,
+								  ALLOCSET_DEFAULT_MAXSIZE);
+	peraggstate->frontValues = NULL;
+	peraggstate->frontIsNull = NULL;
+	peraggstate->frontStart = 0;
+	peraggstate->frontEnd = 0;
+
 	ReleaseSysCache(aggTuple);
 
 	return peraggstate;
@@ -56,13 +56,10 @@
 static inline uint8 rho(uint32 x, uint8 b);
 
 /*
- * Initialize HyperLogLog track state
- *
- * bwidth is bit width (so register size will be 2 to the power of bwidth).
- * Must be between 4 and 16 inclusive.
+ * Set up the parts of the state that depend only on the bit width
  */
-void
-initHyperLogLog(hyperLogLogState *cState, uint8 bwidth)
+static void
+initHyperLogLogCommon(hyperLogLogState *cState, uint8 bwidth)
 {
 	double		alpha;
 
@@ -71,13 +68,6 @@ initHyperLogLog(hyperLogLogState *cState, uint8 bwidth)
 
 	cState->registerWidth = bwidth;
 	cState->nRegisters = (Size) 1 << bwidth;
-	cState->arrSize = sizeof(uint8) * cState->nRegisters + 1;
-
-	/*
-	 * Initialize hashes array to zero, not negative infinity, per discussion
-	 * of the coupon collector problem in the HyperLogLog paper
-	 */
-	cState->hashesArr = palloc0(cState->arrSize);
 
 	/*
 	 * "alpha" is a value that for each possible number of registers (m) is
@@ -107,6 +97,40 @@ initHyperLogLog(hyperLogLogState *cState, uint8 bwidth)
 	cState->alphaMM = alpha * cState->nRegisters * cState->nRegisters;
 }
 
+/*
+ * Initialize HyperLogLog track state
+ *
+ * bwidth is bit width (so register size will be 2 to the power of bwidth).
+ * Must be between 4 and 16 inclusive.
+ */
+void
+initHyperLogLog(hyperLogLogState *cState, uint8 bwidth)
+{
+	initHyperLogLogCommon(cState, bwidth);
+	cState->arrSize = sizeof(uint8) * cState->nRegisters + 1;
+
+	/*
+	 * Initialize hashes array to zero, not negative infinity, per discussion
+	 * of the coupon collector problem in the HyperLogLog paper
+	 */
+	cState->hashesArr = palloc0(cState->arrSize);
+}
+
+/*
+ * Initialize HyperLogLog track state over a caller-supplied register array
+ *
+ * This is for estimators kept in some external form, such as a datum: the
+ * 2 ^ bwidth registers at registers are used and updated in place, and
+ * are not initialized here.  A newly made array must be zeroed.
+ */
+void
+attachHyperLogLog(hyperLogLogState *cState, uint8 bwidth, uint8 *registers)
+{
+	initHyperLogLogCommon(cState, bwidth);
+	cState->arrSize = sizeof(uint8) * cState->nRegisters;
+	cState->hashesArr = registers;
+}
+
 /*
  * Adds element to the estimator, from caller-supplied hash.
  *
@@ -308,6 +308,16 @@ ClientAuthentication(Port *port)
 
 	CHECK_FOR_INTERRUPTS();
 
+	/*
+	 * The connection proxy opens extra backends for a session pool on behalf
+	 * of clients it has already authenticated through a regular connection.
+	 */
+	if (port->proxy_trusted)
+	{
+		sendAuthRequest(port, AUTH_REQ_OK);
+		return;
+	}
+
 	/*
 	 * This is the first point where we have access to the hba record for the
 	 * current connection, so perform any verifications based on the hba
@@ -1423,6 +1433,18 @@ ident_inet(hbaPort *port)
 			   *la = NULL,
 				hints;
 
+	/*
+	 * The ident query names our end of the client's connection, which
+	 * belongs to the connection proxy if there is one.
+	 */
+	if (port->pooled)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("ident authentication is not supported through the connection proxy")));
+		return STATUS_ERROR;
+	}
+
 	/*
 	 * Might look a little weird to first convert it to text and then back to
 	 * sockaddr, but it's protocol independent.
@@ -1585,7 +1607,18 @@ auth_peer(hbaPort *port)
 	gid_t		gid;
 	struct passwd *pw;
 
-	if (getpeereid(port->sock, &uid, &gid) != 0)
+	if (port->pooled)
+	{
+		/* Our peer is the connection proxy, which told us who its client is */
+		if (!port->proxy_peer_known)
+		{
+			ereport(LOG,
+					(errmsg("could not get peer credentials of connection proxy client")));
+			return STATUS_ERROR;
+		}
+		uid = port->proxy_peer_uid;
+	}
+	else if (getpeereid(port->sock, &uid, &gid) != 0)
 	{
 		/* Provide special error message if getpeereid is a stub */
 		if (errno == ENOSYS)
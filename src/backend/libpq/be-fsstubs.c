@@ -58,8 +58,9 @@ bool		lo_compat_privileges;
 
 /* define this to enable debug logging */
 /* #define FSDB 1 */
-/* chunk size for lo_import/lo_export transfers */
+/* chunk sizes for lo_import and lo_export transfers */
 #define BUFSIZE			8192
+#define EXPORT_BUFSIZE	(2 * LO_READAHEAD_SIZE)
 
 /*
  * LO "FD"s are indexes into the cookies array.
@@ -511,7 +512,7 @@ lo_export(PG_FUNCTION_ARGS)
 	int			fd;
 	int			nbytes,
 				tmp;
-	char		buf[BUFSIZE];
+	char	   *buf;
 	char		fnamebuf[MAXPGPATH];
 	LargeObjectDesc *lobj;
 	mode_t		oumask;
@@ -550,9 +551,11 @@ lo_export(PG_FUNCTION_ARGS)
 						fnamebuf)));
 
 	/*
-	 * read in from the inversion file and write to the filesystem
+	 * read in from the inversion file and write to the filesystem, in
+	 * chunks big enough to bypass inv_read's read-ahead buffer
 	 */
-	while ((nbytes = inv_read(lobj, buf, BUFSIZE)) > 0)
+	buf = (char *) palloc(EXPORT_BUFSIZE);
+	while ((nbytes = inv_read(lobj, buf, EXPORT_BUFSIZE)) > 0)
 	{
 		tmp = write(fd, buf, nbytes);
 		if (tmp != nbytes)
@@ -562,6 +565,7 @@ lo_export(PG_FUNCTION_ARGS)
 							fnamebuf)));
 	}
 
+	pfree(buf);
 	CloseTransientFile(fd);
 	inv_close(lobj);
 
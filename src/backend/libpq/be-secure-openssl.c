@@ -59,9 +59,14 @@
 #if (OPENSSL_VERSION_NUMBER >= 0x0090800fL) && !defined(OPENSSL_NO_ECDH)
 #include <openssl/ec.h>
 #endif
+#if defined(HAVE_LINUX_TLS_H) && OPENSSL_VERSION_NUMBER >= 0x10100000L
+#include <linux/tls.h>
+#include <openssl/kdf.h>
+#endif
 
 #include "libpq/libpq.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/latch.h"
 #include "tcop/tcopprot.h"
 #include "utils/memutils.h"
@@ -78,6 +83,13 @@ static DH  *tmp_dh_cb(SSL *s, int is_export, int keylength);
 static int	verify_cb(int, X509_STORE_CTX *);
 static void info_cb(const SSL *ssl, int type, int args);
 static void initialize_ecdh(void);
+#if defined(HAVE_LINUX_TLS_H) && defined(TLS_TX) && \
+	OPENSSL_VERSION_NUMBER >= 0x10100000L
+#define USE_KTLS
+static void start_ktls_send(Port *port);
+static void ktls_msg_cb(int write_p, int version, int content_type,
+			const void *buf, size_t len, SSL *ssl, void *arg);
+#endif
 static const char *SSLerrmessage(unsigned long ecode);
 
 static char *X509_NAME_to_cstring(X509_NAME *name);
@@ -395,7 +407,8 @@ aloop:
 				else
 					waitfor = WL_SOCKET_WRITEABLE;
 
-				WaitLatchOrSocket(MyLatch, waitfor, port->sock, 0);
+				WaitLatchOrSocket(MyLatch, waitfor, port->sock, 0,
+								  WAIT_EVENT_SSL_OPEN_SERVER);
 				goto aloop;
 			case SSL_ERROR_SYSCALL:
 				if (r < 0)
@@ -482,6 +495,11 @@ aloop:
 	/* set up debugging/info callback */
 	SSL_CTX_set_info_callback(SSL_context, info_cb);
 
+#ifdef USE_KTLS
+	if (SSLKernelTLS)
+		start_ktls_send(port);
+#endif
+
 	return 0;
 }
 
@@ -497,6 +515,7 @@ be_tls_close(Port *port)
 		SSL_free(port->ssl);
 		port->ssl = NULL;
 		port->ssl_in_use = false;
+		port->ssl_ktls_tx = false;
 	}
 
 	if (port->peer)
@@ -582,6 +601,16 @@ be_tls_write(Port *port, void *ptr, size_t len, int *waitfor)
 	int			err;
 	unsigned long ecode;
 
+	/* With kernel TLS, the kernel encrypts what we send; see start_ktls_send */
+	if (port->ssl_ktls_tx)
+	{
+		n = secure_raw_write(port, ptr, len);
+		*waitfor = WL_SOCKET_WRITEABLE;
+		if (n > 0)
+			port->count += n;
+		return n;
+	}
+
 	errno = 0;
 	ERR_clear_error();
 	n = SSL_write(port->ssl, ptr, len);
@@ -650,8 +679,16 @@ be_tls_write(Port *port, void *ptr, size_t len, int *waitfor)
  * to retry; do we need to adopt their logic for that?
  */
 
-static bool my_bio_initialized = false;
-static BIO_METHOD my_bio_methods;
+/*
+ * OpenSSL 1.1.0 made BIO and BIO_METHOD opaque; provide its accessors for
+ * older versions.
+ */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define BIO_get_data(bio) ((bio)->ptr)
+#define BIO_set_data(bio, data) ((bio)->ptr = (data))
+#endif
+
+static BIO_METHOD *my_bio_methods = NULL;
 
 static int
 my_sock_read(BIO *h, char *buf, int size)
@@ -660,7 +697,7 @@ my_sock_read(BIO *h, char *buf, int size)
 
 	if (buf != NULL)
 	{
-		res = secure_raw_read(((Port *) h->ptr), buf, size);
+		res = secure_raw_read(((Port *) BIO_get_data(h)), buf, size);
 		BIO_clear_retry_flags(h);
 		if (res <= 0)
 		{
@@ -678,9 +715,29 @@ my_sock_read(BIO *h, char *buf, int size)
 static int
 my_sock_write(BIO *h, const char *buf, int size)
 {
+	Port	   *port = (Port *) BIO_get_data(h);
 	int			res = 0;
 
-	res = secure_raw_write(((Port *) h->ptr), buf, size);
+#ifdef USE_KTLS
+
+	/*
+	 * Once the kernel encrypts what we send, a record OpenSSL writes would
+	 * reach the client encrypted twice.  An alert is resent by ktls_msg_cb
+	 * as a kernel TLS control record, so just drop OpenSSL's copy.  Anything
+	 * else is a renegotiation, which can't work without OpenSSL's write
+	 * keys; fail, which breaks the connection.
+	 */
+	if (port->ssl_ktls_tx)
+	{
+		BIO_clear_retry_flags(h);
+		if (size > 0 && (unsigned char) buf[0] == SSL3_RT_ALERT)
+			return size;
+		errno = ECONNRESET;
+		return -1;
+	}
+#endif
+
+	res = secure_raw_write(port, buf, size);
 	BIO_clear_retry_flags(h);
 	if (res <= 0)
 	{
@@ -697,14 +754,43 @@ my_sock_write(BIO *h, const char *buf, int size)
 static BIO_METHOD *
 my_BIO_s_socket(void)
 {
-	if (!my_bio_initialized)
+	if (!my_bio_methods)
 	{
-		memcpy(&my_bio_methods, BIO_s_socket(), sizeof(BIO_METHOD));
-		my_bio_methods.bread = my_sock_read;
-		my_bio_methods.bwrite = my_sock_write;
-		my_bio_initialized = true;
+		BIO_METHOD *biom = (BIO_METHOD *) BIO_s_socket();
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		int			my_bio_index;
+
+		my_bio_index = BIO_get_new_index();
+		if (my_bio_index == -1)
+			return NULL;
+		my_bio_methods = BIO_meth_new(my_bio_index | BIO_TYPE_SOURCE_SINK,
+									  "PostgreSQL backend socket");
+		if (!my_bio_methods)
+			return NULL;
+		if (!BIO_meth_set_write(my_bio_methods, my_sock_write) ||
+			!BIO_meth_set_read(my_bio_methods, my_sock_read) ||
+			!BIO_meth_set_gets(my_bio_methods, BIO_meth_get_gets(biom)) ||
+			!BIO_meth_set_puts(my_bio_methods, BIO_meth_get_puts(biom)) ||
+			!BIO_meth_set_ctrl(my_bio_methods, BIO_meth_get_ctrl(biom)) ||
+			!BIO_meth_set_create(my_bio_methods, BIO_meth_get_create(biom)) ||
+			!BIO_meth_set_destroy(my_bio_methods, BIO_meth_get_destroy(biom)) ||
+			!BIO_meth_set_callback_ctrl(my_bio_methods,
+										BIO_meth_get_callback_ctrl(biom)))
+		{
+			BIO_meth_free(my_bio_methods);
+			my_bio_methods = NULL;
+			return NULL;
+		}
+#else
+		my_bio_methods = malloc(sizeof(BIO_METHOD));
+		if (!my_bio_methods)
+			return NULL;
+		memcpy(my_bio_methods, biom, sizeof(BIO_METHOD));
+		my_bio_methods->bread = my_sock_read;
+		my_bio_methods->bwrite = my_sock_write;
+#endif
 	}
-	return &my_bio_methods;
+	return my_bio_methods;
 }
 
 /* This should exactly match openssl's SSL_set_fd except for using my BIO */
@@ -712,17 +798,24 @@ static int
 my_SSL_set_fd(Port *port, int fd)
 {
 	int			ret = 0;
-	BIO		   *bio = NULL;
+	BIO		   *bio;
+	BIO_METHOD *bio_method;
 
-	bio = BIO_new(my_BIO_s_socket());
+	bio_method = my_BIO_s_socket();
+	if (bio_method == NULL)
+	{
+		SSLerr(SSL_F_SSL_SET_FD, ERR_R_BUF_LIB);
+		goto err;
+	}
+	bio = BIO_new(bio_method);
 
 	if (bio == NULL)
 	{
 		SSLerr(SSL_F_SSL_SET_FD, ERR_R_BUF_LIB);
 		goto err;
 	}
-	/* Use 'ptr' to store pointer to PGconn */
-	bio->ptr = port;
+	/* Use the BIO's data to store pointer to Port */
+	BIO_set_data(bio, port);
 
 	BIO_set_fd(bio, fd, BIO_NOCLOSE);
 	SSL_set_bio(port->ssl, bio, bio);
@@ -731,6 +824,243 @@ err:
 	return ret;
 }
 
+#ifdef USE_KTLS
+
+#ifndef SOL_TLS
+#define SOL_TLS		282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP		31
+#endif
+#ifndef TLS_SET_RECORD_TYPE
+#define TLS_SET_RECORD_TYPE	1
+#endif
+
+/*
+ * Hand encryption of the data we send over to the kernel (kTLS).
+ *
+ * After this, anything written to the socket is sent as TLS application
+ * data records encrypted by the kernel, so be_tls_write and secure_writev
+ * can write plain data to it with send() and sendmsg(), without copying it
+ * through OpenSSL.  Receiving still goes through OpenSSL, and so do the
+ * alerts OpenSSL sends, see ktls_msg_cb.
+ *
+ * The kernel supports the AES-GCM ciphers of TLS 1.2.  OpenSSL won't hand
+ * us the session keys, so we derive them from the master secret with its
+ * TLS 1.2 PRF, as in RFC 5246 section 6.3.  (SSL_export_keying_material
+ * can't do it: it refuses the "key expansion" label, and puts the client
+ * random first.)  If the cipher isn't one the kernel handles, or the kernel
+ * lacks TLS support, we quietly keep using OpenSSL.
+ *
+ * We're called right after the handshake, before we have sent any data.
+ */
+static void
+start_ktls_send(Port *port)
+{
+	SSL		   *ssl = port->ssl;
+	const EVP_MD *md;
+	int			keylen;
+	unsigned char master_key[SSL_MAX_MASTER_KEY_LENGTH];
+	size_t		master_key_len;
+	unsigned char client_random[SSL3_RANDOM_SIZE];
+	unsigned char server_random[SSL3_RANDOM_SIZE];
+	unsigned char keyblock[2 * 32 + 2 * 4];
+	size_t		keyblock_len;
+	unsigned char rec_seq[8];
+	unsigned char *key;
+	unsigned char *salt;
+	EVP_PKEY_CTX *pctx;
+	bool		derived;
+	union
+	{
+		struct tls_crypto_info info;
+		struct tls12_crypto_info_aes_gcm_128 gcm128;
+#ifdef TLS_CIPHER_AES_GCM_256
+		struct tls12_crypto_info_aes_gcm_256 gcm256;
+#endif
+	}			crypto_info;
+	socklen_t	crypto_info_len;
+
+	if (SSL_version(ssl) != TLS1_2_VERSION)
+	{
+		ereport(DEBUG1,
+				(errmsg_internal("kernel TLS not used: protocol %s is not supported",
+								 SSL_get_version(ssl))));
+		return;
+	}
+
+	switch (SSL_CIPHER_get_id(SSL_get_current_cipher(ssl)))
+	{
+		case TLS1_CK_RSA_WITH_AES_128_GCM_SHA256:
+		case TLS1_CK_DHE_RSA_WITH_AES_128_GCM_SHA256:
+		case TLS1_CK_ECDHE_RSA_WITH_AES_128_GCM_SHA256:
+		case TLS1_CK_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256:
+			md = EVP_sha256();
+			keylen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+			break;
+#ifdef TLS_CIPHER_AES_GCM_256
+		case TLS1_CK_RSA_WITH_AES_256_GCM_SHA384:
+		case TLS1_CK_DHE_RSA_WITH_AES_256_GCM_SHA384:
+		case TLS1_CK_ECDHE_RSA_WITH_AES_256_GCM_SHA384:
+		case TLS1_CK_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384:
+			md = EVP_sha384();
+			keylen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+			break;
+#endif
+		default:
+			ereport(DEBUG1,
+					(errmsg_internal("kernel TLS not used: cipher %s is not supported",
+									 SSL_get_cipher_name(ssl))));
+			return;
+	}
+
+	/*
+	 * key_block = PRF(master_secret, "key expansion", server_random +
+	 * client_random).  AEAD ciphers have no MAC keys, so it holds the client
+	 * and server write keys, followed by the client and server implicit IVs.
+	 */
+	master_key_len = SSL_SESSION_get_master_key(SSL_get_session(ssl),
+												master_key,
+												sizeof(master_key));
+	SSL_get_client_random(ssl, client_random, sizeof(client_random));
+	SSL_get_server_random(ssl, server_random, sizeof(server_random));
+	keyblock_len = 2 * keylen + 2 * 4;
+
+	pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, NULL);
+	derived = (pctx != NULL &&
+			   EVP_PKEY_derive_init(pctx) > 0 &&
+			   EVP_PKEY_CTX_set_tls1_prf_md(pctx, md) > 0 &&
+			   EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, master_key,
+												 master_key_len) > 0 &&
+			   EVP_PKEY_CTX_add1_tls1_prf_seed(pctx,
+											   TLS_MD_KEY_EXPANSION_CONST,
+									   TLS_MD_KEY_EXPANSION_CONST_SIZE) > 0 &&
+			   EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, server_random,
+											   sizeof(server_random)) > 0 &&
+			   EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, client_random,
+											   sizeof(client_random)) > 0 &&
+			   EVP_PKEY_derive(pctx, keyblock, &keyblock_len) > 0);
+	EVP_PKEY_CTX_free(pctx);
+	OPENSSL_cleanse(master_key, sizeof(master_key));
+	if (!derived)
+	{
+		ereport(DEBUG1,
+				(errmsg_internal("kernel TLS not used: could not derive keys: %s",
+								 SSLerrmessage(ERR_get_error()))));
+		OPENSSL_cleanse(keyblock, sizeof(keyblock));
+		return;
+	}
+	key = keyblock + keylen;
+	salt = keyblock + 2 * keylen + 4;
+
+	/*
+	 * Our Finished message was the first record under the new keys, so the
+	 * next one is number 1.  The kernel numbers the explicit nonces of its
+	 * records from the record sequence number, like OpenSSL's own kTLS
+	 * support does.
+	 */
+	memset(rec_seq, 0, sizeof(rec_seq));
+	rec_seq[sizeof(rec_seq) - 1] = 1;
+
+	memset(&crypto_info, 0, sizeof(crypto_info));
+	crypto_info.info.version = TLS_1_2_VERSION;
+	if (keylen == TLS_CIPHER_AES_GCM_128_KEY_SIZE)
+	{
+		crypto_info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+		memcpy(crypto_info.gcm128.key, key, keylen);
+		memcpy(crypto_info.gcm128.salt, salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+		memcpy(crypto_info.gcm128.iv, rec_seq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+		memcpy(crypto_info.gcm128.rec_seq, rec_seq,
+			   TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+		crypto_info_len = sizeof(crypto_info.gcm128);
+	}
+#ifdef TLS_CIPHER_AES_GCM_256
+	else
+	{
+		crypto_info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+		memcpy(crypto_info.gcm256.key, key, keylen);
+		memcpy(crypto_info.gcm256.salt, salt, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+		memcpy(crypto_info.gcm256.iv, rec_seq, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+		memcpy(crypto_info.gcm256.rec_seq, rec_seq,
+			   TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+		crypto_info_len = sizeof(crypto_info.gcm256);
+	}
+#endif
+	OPENSSL_cleanse(keyblock, sizeof(keyblock));
+
+	if (setsockopt(port->sock, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0 ||
+		setsockopt(port->sock, SOL_TLS, TLS_TX,
+				   &crypto_info, crypto_info_len) < 0)
+	{
+		/*
+		 * A socket with the TLS upper layer but no keys passes data through
+		 * unchanged, so it's fine to carry on with OpenSSL either way.
+		 */
+		ereport(DEBUG1,
+				(errmsg_internal("kernel TLS not used: %m")));
+		OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+		return;
+	}
+	OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+
+	port->ssl_ktls_tx = true;
+
+	/*
+	 * Have OpenSSL hand us the alerts it sends, and refuse renegotiation
+	 * with one rather than attempt it.
+	 */
+	SSL_set_msg_callback(ssl, ktls_msg_cb);
+	SSL_set_msg_callback_arg(ssl, port);
+#ifdef SSL_OP_NO_RENEGOTIATION
+	SSL_set_options(ssl, SSL_OP_NO_RENEGOTIATION);
+#endif
+
+	ereport(DEBUG2,
+			(errmsg_internal("kernel TLS enabled for sending")));
+}
+
+/*
+ * OpenSSL message callback, installed once the kernel encrypts what we send.
+ *
+ * The alerts OpenSSL writes itself are dropped by my_sock_write, so send each
+ * one again here, as a TLS control record of the kernel's: a cmsg tells the
+ * kernel the record type.  That way a close_notify or a fatal alert still
+ * reaches the client.  There's no way to report a failure from here; if the
+ * alert can't be sent, the client will just see the connection close.
+ */
+static void
+ktls_msg_cb(int write_p, int version, int content_type, const void *buf,
+			size_t len, SSL *ssl, void *arg)
+{
+	Port	   *port = (Port *) arg;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char		cbuf[CMSG_SPACE(sizeof(unsigned char))];
+
+	if (!write_p || content_type != SSL3_RT_ALERT || !port->ssl_ktls_tx)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+	*CMSG_DATA(cmsg) = SSL3_RT_ALERT;
+
+	if (sendmsg(port->sock, &msg, 0) < 0)
+		ereport(DEBUG1,
+				(errmsg_internal("could not send SSL alert through kernel TLS: %m")));
+}
+#endif   /* USE_KTLS */
+
 /*
  *	Load precomputed DH parameters.
  *
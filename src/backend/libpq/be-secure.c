@@ -25,6 +25,9 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <netdb.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 #include <netinet/in.h>
 #ifdef HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
@@ -33,6 +36,7 @@
 
 #include "libpq/libpq.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "tcop/tcopprot.h"
 #include "utils/memutils.h"
 #include "storage/proc.h"
@@ -56,6 +60,9 @@ char	   *SSLECDHCurve;
 /* GUC variable: if false, prefer client ciphers */
 bool		SSLPreferServerCiphers;
 
+/* GUC variable: hand TLS encryption of outgoing data to the kernel? */
+bool		SSLKernelTLS;
+
 /* ------------------------------------------------------------ */
 /*			 Procedures common to all secure sessions			*/
 /* ------------------------------------------------------------ */
@@ -139,16 +146,39 @@ retry:
 	/* In blocking mode, wait until the socket is ready */
 	if (n < 0 && !port->noblock && (errno == EWOULDBLOCK || errno == EAGAIN))
 	{
-		int			w;
+		WaitEvent	event;
 
 		Assert(waitfor);
 
-		w = WaitLatchOrSocket(MyLatch,
-							  WL_LATCH_SET | waitfor,
-							  port->sock, 0);
+		ModifyWaitEvent(FeBeWaitSet, FeBeWaitSetSocketPos, waitfor, NULL);
+
+		WaitEventSetWait(FeBeWaitSet, -1 /* no timeout */ , &event, 1,
+						 WAIT_EVENT_CLIENT_READ);
+
+		/*
+		 * If the postmaster has died, it's not safe to continue running,
+		 * because it is the postmaster's job to kill us if some other backend
+		 * exists uncleanly.  Moreover, we won't run very well in this state;
+		 * helper processes like walwriter and the bgwriter will exit, so
+		 * performance may be poor.  Finally, if we don't exit, pg_ctl will be
+		 * unable to restart the postmaster without manual intervention, so no
+		 * new connections can be accepted.  Exiting clears the deck for a
+		 * postmaster restart.
+		 *
+		 * (Note that we only make this check when we would otherwise sleep
+		 * on our latch.  We might still continue running for a while if the
+		 * postmaster is killed in mid-query, or even through multiple queries
+		 * if we never have to wait for read.  We don't want to burn too many
+		 * cycles checking for this very rare condition, and this should cause
+		 * us to exit quickly in most cases.)
+		 */
+		if (event.events & WL_POSTMASTER_DEATH)
+			ereport(FATAL,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("terminating connection due to unexpected postmaster exit")));
 
 		/* Handle interrupt. */
-		if (w & WL_LATCH_SET)
+		if (event.events & WL_LATCH_SET)
 		{
 			ResetLatch(MyLatch);
 			ProcessClientReadInterrupt(true);
@@ -193,6 +223,56 @@ secure_raw_read(Port *port, void *ptr, size_t len)
 }
 
 
+/*
+ * Wait until the socket is ready for another write attempt, handling
+ * interrupts and postmaster death meanwhile.
+ */
+static void
+secure_wait_write(int waitfor)
+{
+	WaitEvent	event;
+
+	ModifyWaitEvent(FeBeWaitSet, FeBeWaitSetSocketPos, waitfor, NULL);
+
+	WaitEventSetWait(FeBeWaitSet, -1 /* no timeout */ , &event, 1,
+					 WAIT_EVENT_CLIENT_WRITE);
+
+	/*
+	 * If the postmaster has died, it's not safe to continue running,
+	 * because it is the postmaster's job to kill us if some other backend
+	 * exists uncleanly.  Moreover, we won't run very well in this state;
+	 * helper processes like walwriter and the bgwriter will exit, so
+	 * performance may be poor.  Finally, if we don't exit, pg_ctl will be
+	 * unable to restart the postmaster without manual intervention, so no
+	 * new connections can be accepted.  Exiting clears the deck for a
+	 * postmaster restart.
+	 *
+	 * (Note that we only make this check when we would otherwise sleep
+	 * on our latch.  We might still continue running for a while if the
+	 * postmaster is killed in mid-query, or even through multiple queries
+	 * if we never have to wait for write.  We don't want to burn too many
+	 * cycles checking for this very rare condition, and this should cause
+	 * us to exit quickly in most cases.)
+	 */
+	if (event.events & WL_POSTMASTER_DEATH)
+		ereport(FATAL,
+				(errcode(ERRCODE_ADMIN_SHUTDOWN),
+				 errmsg("terminating connection due to unexpected postmaster exit")));
+
+	/* Handle interrupt. */
+	if (event.events & WL_LATCH_SET)
+	{
+		ResetLatch(MyLatch);
+		ProcessClientWriteInterrupt(true);
+
+		/*
+		 * We'll retry the write. Most likely it will return immediately
+		 * because there's still no data available, and we'll wait for the
+		 * socket to become ready again.
+		 */
+	}
+}
+
 /*
  *	Write data to a secure connection.
  */
@@ -218,26 +298,8 @@ retry:
 
 	if (n < 0 && !port->noblock && (errno == EWOULDBLOCK || errno == EAGAIN))
 	{
-		int			w;
-
 		Assert(waitfor);
-
-		w = WaitLatchOrSocket(MyLatch,
-							  WL_LATCH_SET | waitfor,
-							  port->sock, 0);
-
-		/* Handle interrupt. */
-		if (w & WL_LATCH_SET)
-		{
-			ResetLatch(MyLatch);
-			ProcessClientWriteInterrupt(true);
-
-			/*
-			 * We'll retry the write. Most likely it will return immediately
-			 * because there's still no data available, and we'll wait for the
-			 * socket to become ready again.
-			 */
-		}
+		secure_wait_write(waitfor);
 		goto retry;
 	}
 
@@ -266,3 +328,46 @@ secure_raw_write(Port *port, const void *ptr, size_t len)
 
 	return n;
 }
+
+#ifndef WIN32
+/*
+ *	Write data from several buffers to a plain (non-SSL) connection with a
+ *	single system call, waiting like secure_write does if the socket is
+ *	full.  If "more" is true the caller has more data to send right away,
+ *	so the kernel need not push out a partially filled segment yet.
+ */
+ssize_t
+secure_writev(Port *port, struct iovec *iov, int iovcnt, bool more)
+{
+	struct msghdr msg;
+	int			flags = 0;
+	ssize_t		n;
+
+	/* With kernel TLS, what we send here gets encrypted by the kernel */
+	Assert(!port->ssl_in_use || port->ssl_ktls_tx);
+
+#ifdef MSG_MORE
+	if (more)
+		flags |= MSG_MORE;
+#endif
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	for (;;)
+	{
+		n = sendmsg(port->sock, &msg, flags);
+		if (n < 0 && !port->noblock && (errno == EWOULDBLOCK || errno == EAGAIN))
+		{
+			secure_wait_write(WL_SOCKET_WRITEABLE);
+			continue;
+		}
+		break;
+	}
+
+	ProcessClientWriteInterrupt(false);
+
+	return n;
+}
+#endif   /* WIN32 */
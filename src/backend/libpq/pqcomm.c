@@ -57,6 +57,7 @@
  *		pq_flush		- flush pending output
  *		pq_flush_if_writable - flush pending output if writable without blocking
  *		pq_getbyte_if_available - get a byte if available without blocking
+ *		pq_enable_compression - compress traffic from now on
  *
  * message-level I/O (and old-style-COPY-OUT cruft):
  *		pq_putmessage	- send a normal message (suppressed in COPY OUT mode)
@@ -76,6 +77,9 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 #include <netdb.h>
 #include <netinet/in.h>
 #ifdef HAVE_NETINET_TCP_H
@@ -89,8 +93,10 @@
 #include <mstcpip.h>
 #endif
 
+#include "common/zpq_stream.h"
 #include "libpq/ip.h"
 #include "libpq/libpq.h"
+#include "libpq/pqformat.h"
 #include "miscadmin.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
@@ -108,13 +114,26 @@ static List *sock_paths = NIL;
 /*
  * Buffers for low-level I/O.
  *
- * The receive buffer is fixed size. Send buffer is usually 8k, but can be
+ * The receive buffer is fixed size. Send buffer starts out at 8k; each time
+ * it fills up it is doubled after being flushed, up to PQ_SEND_BUFFER_MAX,
+ * so that big results go out in fewer and larger writes.  It can also be
  * enlarged by pq_putmessage_noblock() if the message doesn't fit otherwise.
+ *
+ * Message bodies of at least PQ_DIRECT_SEND_SIZE bytes that don't fit in
+ * the send buffer are handed to the kernel directly with writev(), together
+ * with whatever is buffered, instead of being copied through the buffer.
+ * That is only possible when neither SSL nor compression is in use.
  */
 
 #define PQ_SEND_BUFFER_SIZE 8192
+#define PQ_SEND_BUFFER_MAX	65536
+#define PQ_DIRECT_SEND_SIZE 8192
 #define PQ_RECV_BUFFER_SIZE 8192
 
+#ifndef WIN32
+#define PQ_USE_WRITEV
+#endif
+
 static char *PqSendBuffer;
 static int	PqSendBufferSize;	/* Size send buffer */
 static int	PqSendPointer;		/* Next index to store a byte in PqSendBuffer */
@@ -127,6 +146,17 @@ static int	PqRecvLength;		/* End of data available in PqRecvBuffer */
 /*
  * Message status
  */
+/* Compression of the traffic, if pq_enable_compression was called */
+static ZpqStream *PqStream = NULL;
+
+/* Can data be written to the socket directly, bypassing SSL and compression? */
+#ifdef PQ_USE_WRITEV
+#define PqCanWritev() (PqStream == NULL && \
+					   (!MyProcPort->ssl_in_use || MyProcPort->ssl_ktls_tx))
+#else
+#define PqCanWritev() false
+#endif
+
 static bool PqCommBusy;			/* busy sending data to the client */
 static bool PqCommReadingMsg;	/* in the middle of reading a message */
 static bool DoingCopyOut;		/* in old-protocol COPY OUT processing */
@@ -145,6 +175,12 @@ static void socket_startcopyout(void);
 static void socket_endcopyout(bool errorAbort);
 static int	internal_putbytes(const char *s, size_t len);
 static int	internal_flush(void);
+static int	internal_flush_ext(const char *extra, size_t extralen, bool more);
+static ssize_t pq_stream_tx(void *arg, const void *data, size_t size);
+static ssize_t pq_stream_rx(void *arg, void *data, size_t size);
+static ssize_t pq_read(void *ptr, size_t len);
+static ssize_t pq_write(void *ptr, size_t len);
+static bool pq_stream_send_pending(void);
 static void socket_set_nonblocking(bool nonblocking);
 
 #ifdef HAVE_UNIX_SOCKETS
@@ -165,6 +201,8 @@ static PQcommMethods PqCommSocketMethods = {
 
 PQcommMethods *PqCommMethods = &PqCommSocketMethods;
 
+WaitEventSet *FeBeWaitSet;
+
 
 
 /* --------------------------------
@@ -201,6 +239,18 @@ pq_init(void)
 				(errmsg("could not set socket to nonblocking mode: %m")));
 #endif
 
+	/*
+	 * Register the socket, our latch and the postmaster once, rather than on
+	 * every wait for the client; secure_read and secure_write switch the
+	 * socket event between reading and writing as they go.
+	 */
+	FeBeWaitSet = CreateWaitEventSet(TopMemoryContext, FeBeWaitSetNEvents);
+	AddWaitEventToSet(FeBeWaitSet, WL_SOCKET_WRITEABLE, MyProcPort->sock,
+					  NULL, NULL);
+	AddWaitEventToSet(FeBeWaitSet, WL_LATCH_SET, PGINVALID_SOCKET,
+					  MyLatch, NULL);
+	AddWaitEventToSet(FeBeWaitSet, WL_POSTMASTER_DEATH, PGINVALID_SOCKET,
+					  NULL, NULL);
 }
 
 /* --------------------------------
@@ -880,8 +930,8 @@ pq_recvbuf(void)
 	{
 		int			r;
 
-		r = secure_read(MyProcPort, PqRecvBuffer + PqRecvLength,
-						PQ_RECV_BUFFER_SIZE - PqRecvLength);
+		r = pq_read(PqRecvBuffer + PqRecvLength,
+					PQ_RECV_BUFFER_SIZE - PqRecvLength);
 
 		if (r < 0)
 		{
@@ -972,7 +1022,7 @@ pq_getbyte_if_available(unsigned char *c)
 	/* Put the socket into non-blocking mode */
 	socket_set_nonblocking(true);
 
-	r = secure_read(MyProcPort, c, 1);
+	r = pq_read(c, 1);
 	if (r < 0)
 	{
 		/*
@@ -1004,6 +1054,117 @@ pq_getbyte_if_available(unsigned char *c)
 	return r;
 }
 
+/* --------------------------------
+ *		pq_enable_compression - compress traffic from now on
+ *
+ * Tells the client which algorithm was chosen, and then compresses all
+ * traffic in both directions.  This happens right after the startup
+ * packet: the client sends nothing more until it has seen our reply, so
+ * there's no uncompressed input left to worry about.
+ * --------------------------------
+ */
+void
+pq_enable_compression(const char *algorithm)
+{
+	ZpqStream  *stream;
+	StringInfoData buf;
+
+	Assert(PqStream == NULL);
+	Assert(PqRecvPointer == PqRecvLength);
+
+	stream = zpq_create(algorithm, pq_stream_tx, pq_stream_rx, MyProcPort,
+						NULL, 0);
+	if (stream == NULL)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("could not initialize \"%s\" compression",
+						algorithm)));
+
+	pq_beginmessage(&buf, 'z');
+	pq_sendstring(&buf, algorithm);
+	pq_endmessage(&buf);
+	pq_flush();
+
+	PqStream = stream;
+}
+
+/*
+ * Transport functions of the compression stream.
+ */
+static ssize_t
+pq_stream_tx(void *arg, const void *data, size_t size)
+{
+	return secure_write((Port *) arg, (void *) data, size);
+}
+
+static ssize_t
+pq_stream_rx(void *arg, void *data, size_t size)
+{
+	return secure_read((Port *) arg, data, size);
+}
+
+/* --------------------------------
+ *		pq_read		- read from the connection, decompressing if needed
+ *
+ * Returns what secure_read would.  Data that can't be decompressed is
+ * logged and reported as EOF, which ends the session.
+ * --------------------------------
+ */
+static ssize_t
+pq_read(void *ptr, size_t len)
+{
+	ssize_t		r;
+
+	if (PqStream == NULL)
+		return secure_read(MyProcPort, ptr, len);
+
+	r = zpq_read(PqStream, ptr, len);
+	if (r == ZPQ_STREAM_ERROR)
+	{
+		/* as for read errors, this must go only to the postmaster log */
+		ereport(COMMERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("could not decompress data from client: %s",
+						zpq_error(PqStream))));
+		r = 0;
+	}
+	return r;
+}
+
+/* --------------------------------
+ *		pq_write	- write to the connection, compressing if needed
+ *
+ * Returns what secure_write would.  A compression failure (which can only
+ * mean running out of memory) is logged and reported as an I/O error.
+ * --------------------------------
+ */
+static ssize_t
+pq_write(void *ptr, size_t len)
+{
+	ssize_t		r;
+
+	if (PqStream == NULL)
+		return secure_write(MyProcPort, ptr, len);
+
+	r = zpq_write(PqStream, ptr, len);
+	if (r == ZPQ_STREAM_ERROR)
+	{
+		ereport(COMMERROR,
+				(errmsg("could not compress data for client: %s",
+						zpq_error(PqStream))));
+		errno = EIO;
+		r = -1;
+	}
+	return r;
+}
+
+/* Does the compression stream hold output that has not been sent yet? */
+static bool
+pq_stream_send_pending(void)
+{
+	return PqStream != NULL && zpq_buffered_tx(PqStream) > 0;
+}
+
 /* --------------------------------
  *		pq_getbytes		- get a known number of bytes from connection
  *
@@ -1292,12 +1453,23 @@ internal_putbytes(const char *s, size_t len)
 
 	while (len > 0)
 	{
-		/* If buffer is full, then flush it out */
+		/*
+		 * If buffer is full, then flush it out, telling the kernel that the
+		 * rest of the data follows at once.  A buffer that fills up is then
+		 * made bigger, as the client is evidently receiving a lot.
+		 */
 		if (PqSendPointer >= PqSendBufferSize)
 		{
 			socket_set_nonblocking(false);
-			if (internal_flush())
+			if (internal_flush_ext(NULL, 0, true))
 				return EOF;
+			if (PqSendBufferSize < PQ_SEND_BUFFER_MAX)
+			{
+				pfree(PqSendBuffer);
+				PqSendBufferSize *= 2;
+				PqSendBuffer = (char *) MemoryContextAlloc(TopMemoryContext,
+														   PqSendBufferSize);
+			}
 		}
 		amount = PqSendBufferSize - PqSendPointer;
 		if (amount > len)
@@ -1340,19 +1512,58 @@ socket_flush(void)
  */
 static int
 internal_flush(void)
+{
+	return internal_flush_ext(NULL, 0, false);
+}
+
+/* --------------------------------
+ *		internal_flush_ext - flush pending output, plus extra data
+ *
+ * Sends the buffered data followed by extralen bytes at extra, which must
+ * be NULL unless PqCanWritev() is true and the socket is in blocking mode.
+ * If "more" is true, more data will be sent right after this.
+ * --------------------------------
+ */
+static int
+internal_flush_ext(const char *extra, size_t extralen, bool more)
 {
 	static int	last_reported_send_errno = 0;
 
 	char	   *bufptr = PqSendBuffer + PqSendStart;
 	char	   *bufend = PqSendBuffer + PqSendPointer;
 
-	while (bufptr < bufend)
+	Assert(extralen == 0 || (PqCanWritev() && !MyProcPort->noblock));
+
+	while (bufptr < bufend || extralen > 0 || pq_stream_send_pending())
 	{
-		int			r;
+		ssize_t		r;
+
+#ifdef PQ_USE_WRITEV
+		if ((extralen > 0 || more) && PqCanWritev())
+		{
+			struct iovec iov[2];
+			int			iovcnt = 0;
 
-		r = secure_write(MyProcPort, bufptr, bufend - bufptr);
+			if (bufptr < bufend)
+			{
+				iov[iovcnt].iov_base = bufptr;
+				iov[iovcnt].iov_len = bufend - bufptr;
+				iovcnt++;
+			}
+			if (extralen > 0)
+			{
+				iov[iovcnt].iov_base = (void *) extra;
+				iov[iovcnt].iov_len = extralen;
+				iovcnt++;
+			}
+			r = secure_writev(MyProcPort, iov, iovcnt, more);
+		}
+		else
+#endif
+			r = pq_write(bufptr, bufend - bufptr);
 
-		if (r <= 0)
+		/* (with compression, a zero-length write just sends pending data) */
+		if (r < 0 || (r == 0 && (bufptr < bufend || extralen > 0)))
 		{
 			if (errno == EINTR)
 				continue;		/* Ok if we were interrupted */
@@ -1397,8 +1608,20 @@ internal_flush(void)
 		}
 
 		last_reported_send_errno = 0;	/* reset after any successful send */
-		bufptr += r;
-		PqSendStart += r;
+		if (r > bufend - bufptr)
+		{
+			/* buffer is done, and part of the extra data went out too */
+			r -= bufend - bufptr;
+			PqSendStart += bufend - bufptr;
+			bufptr = bufend;
+			extra += r;
+			extralen -= r;
+		}
+		else
+		{
+			bufptr += r;
+			PqSendStart += r;
+		}
 	}
 
 	PqSendStart = PqSendPointer = 0;
@@ -1417,7 +1640,7 @@ socket_flush_if_writable(void)
 	int			res;
 
 	/* Quick exit if nothing to do */
-	if (PqSendPointer == PqSendStart)
+	if (PqSendPointer == PqSendStart && !pq_stream_send_pending())
 		return 0;
 
 	/* No-op if reentrant call */
@@ -1440,7 +1663,7 @@ socket_flush_if_writable(void)
 static bool
 socket_is_send_pending(void)
 {
-	return (PqSendStart < PqSendPointer);
+	return (PqSendStart < PqSendPointer || pq_stream_send_pending());
 }
 
 /* --------------------------------
@@ -1493,7 +1716,20 @@ socket_putmessage(char msgtype, const char *s, size_t len)
 		if (internal_putbytes((char *) &n32, 4))
 			goto fail;
 	}
-	if (internal_putbytes(s, len))
+
+	/*
+	 * A large body that would overflow the buffer anyway is sent straight
+	 * from the caller's memory, along with what's buffered ahead of it.
+	 */
+	if (len >= PQ_DIRECT_SEND_SIZE &&
+		len > (size_t) (PqSendBufferSize - PqSendPointer) &&
+		PqCanWritev())
+	{
+		socket_set_nonblocking(false);
+		if (internal_flush_ext(s, len, false))
+			goto fail;
+	}
+	else if (internal_putbytes(s, len))
 		goto fail;
 	PqCommBusy = false;
 	return 0;
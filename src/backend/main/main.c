@@ -33,6 +33,7 @@
 
 #include "bootstrap/bootstrap.h"
 #include "common/username.h"
+#include "portability/instr_time.h"
 #include "postmaster/postmaster.h"
 #include "storage/barrier.h"
 #include "storage/s_lock.h"
@@ -98,6 +99,9 @@ main(int argc, char *argv[])
 	 */
 	MemoryContextInit();
 
+	/* Set up the clock used for plan instrumentation */
+	pg_initialize_timing();
+
 	/*
 	 * Set up locale information from environment.  Note that LC_CTYPE and
 	 * LC_COLLATE will be overridden later from pg_control if we are in an
@@ -20,7 +20,8 @@
  */
 #include "postgres.h"
 
-#include "access/hash.h"
+#include "nodes/bitmapset.h"
+#include "utils/hashutils.h"
 
 
 #define WORDNUM(x)	((x) / BITS_PER_BITMAPWORD)
@@ -948,7 +949,7 @@ bms_next_member(const Bitmapset *a, int prevbit)
  * Note: we must ensure that any two bitmapsets that are bms_equal() will
  * hash to the same value; in practice this means that trailing all-zero
  * words must not affect the result.  Hence we strip those before applying
- * hash_any().
+ * hash_bytes_fast().
  */
 uint32
 bms_hash_value(const Bitmapset *a)
@@ -964,6 +965,6 @@ bms_hash_value(const Bitmapset *a)
 	}
 	if (lastword < 0)
 		return 0;				/* All empty sets hash to 0 */
-	return DatumGetUInt32(hash_any((const unsigned char *) a->words,
-								   (lastword + 1) * sizeof(bitmapword)));
+	return hash_bytes_fast((const unsigned char *) a->words,
+						   (lastword + 1) * sizeof(bitmapword));
 }
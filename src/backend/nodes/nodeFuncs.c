@@ -2124,6 +2124,10 @@ range_table_walker(List *rtable,
 
 		if (walker((Node *)rte->securityQuals, context))
 			return true;
+
+		if (flags & QTW_EXAMINE_RTES_AFTER)
+			if (walker((Node *)rte, context))
+				return true;
 	}
 	return false;
 }
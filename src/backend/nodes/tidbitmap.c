@@ -28,6 +28,11 @@
  * into a bitmap, and it can also happen internally when we AND a lossy
  * and a non-lossy page.
  *
+ * A bitmap is always built in backend-local memory, but once it is done,
+ * it can be copied into shared memory (typically a DSM segment), and then
+ * iterated over by several processes together, each getting the next page
+ * that no one else has got yet.
+ *
  *
  * Copyright (c) 2003-2015, PostgreSQL Global Development Group
  *
@@ -43,7 +48,9 @@
 #include "access/htup_details.h"
 #include "nodes/bitmapset.h"
 #include "nodes/tidbitmap.h"
-#include "utils/hsearch.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/hashutils.h"
 
 /*
  * The maximum number of tuples per page is not large (typically 256 with
@@ -61,15 +68,21 @@
  * for that page in the page table.
  *
  * We actually store both exact pages and lossy chunks in the same hash
- * table, using identical data structures.  (This is because dynahash.c's
- * memory management doesn't allow space to be transferred easily from one
- * hashtable to another.)  Therefore it's best if PAGES_PER_CHUNK is the
+ * table, using identical data structures.  (This is because the entries live
+ * directly in the hash table's bucket array, so space can't be transferred
+ * from one hashtable to another.)  Therefore it's best if PAGES_PER_CHUNK is the
  * same as MAX_TUPLES_PER_PAGE, or at least not too different.  But we
  * also want PAGES_PER_CHUNK to be a power of 2 to avoid expensive integer
  * remainder operations.  So, define it like this:
  */
 #define PAGES_PER_CHUNK  (BLCKSZ / 32)
 
+/*
+ * Below this many entries, the sorted page lists are made with qsort();
+ * above, with a radix sort.
+ */
+#define TBM_RADIX_SORT_MIN	256
+
 /* We use BITS_PER_BITMAPWORD and typedef bitmapword from nodes/bitmapset.h */
 
 #define WORDNUM(x)	((x) / BITS_PER_BITMAPWORD)
@@ -97,16 +110,17 @@
 typedef struct PagetableEntry
 {
 	BlockNumber blockno;		/* page number (hashtable key) */
+	char		status;			/* hash entry status */
 	bool		ischunk;		/* T = lossy storage, F = exact */
 	bool		recheck;		/* should the tuples be rechecked? */
 	bitmapword	words[Max(WORDS_PER_PAGE, WORDS_PER_CHUNK)];
 } PagetableEntry;
 
 /*
- * dynahash.c is optimized for relatively large, long-lived hash tables.
- * This is not ideal for TIDBitMap, particularly when we are using a bitmap
- * scan on the inside of a nestloop join: a bitmap may well live only long
- * enough to accumulate one entry in such cases.  We therefore avoid creating
+ * Creating and zeroing a bucket array is not free.  That matters for
+ * TIDBitMap, particularly when we are using a bitmap scan on the inside of a
+ * nestloop join: a bitmap may well live only long enough to accumulate one
+ * entry in such cases.  We therefore avoid creating
  * an actual hashtable until we need two pagetable entries.  When just one
  * pagetable entry is needed, we store it in a fixed field of TIDBitMap.
  * (NOTE: we don't get rid of the hashtable if the bitmap later shrinks down
@@ -128,7 +142,7 @@ struct TIDBitmap
 	NodeTag		type;			/* to make it a valid Node */
 	MemoryContext mcxt;			/* memory context containing me */
 	TBMStatus	status;			/* see codes above */
-	HTAB	   *pagetable;		/* hash table of PagetableEntry's */
+	struct pagetable_hash *pagetable;	/* hash table of PagetableEntry's */
 	int			nentries;		/* number of entries in pagetable */
 	int			maxentries;		/* limit on same to meet maxbytes */
 	int			npages;			/* number of exact entries in pagetable */
@@ -138,6 +152,7 @@ struct TIDBitmap
 	/* these are valid when iterating is true: */
 	PagetableEntry **spages;	/* sorted exact-page list, or NULL */
 	PagetableEntry **schunks;	/* sorted lossy-chunk list, or NULL */
+	uint32		lossify_start;	/* offset to start lossifying hashtable at */
 };
 
 /*
@@ -155,6 +170,33 @@ struct TBMIterator
 	TBMIterateResult output;	/* MUST BE LAST (because variable-size) */
 };
 
+/*
+ * A bitmap copied into shared memory for iterating over by several
+ * processes together.  It's made by tbm_prepare_shared_iterate(): the
+ * entries are the exact pages, sorted, followed by the lossy chunks,
+ * sorted.  The iteration pointers are shared, and protected by the
+ * spinlock; the entries are read-only.
+ */
+struct TBMSharedIteratorState
+{
+	slock_t		mutex;			/* protects the pointers below */
+	int			spageptr;		/* next exact page index */
+	int			schunkptr;		/* next lossy chunk index */
+	int			schunkbit;		/* next bit to check in current chunk */
+	int			npages;			/* number of exact pages */
+	int			nchunks;		/* number of lossy chunks */
+	PagetableEntry entries[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/*
+ * A process's handle on a shared iteration.
+ */
+struct TBMSharedIterator
+{
+	TBMSharedIteratorState *state;
+	TBMIterateResult output;	/* MUST BE LAST (because variable-size) */
+};
+
 
 /* Local function prototypes */
 static void tbm_union_page(TIDBitmap *a, const PagetableEntry *bpage);
@@ -166,8 +208,24 @@ static PagetableEntry *tbm_get_pageentry(TIDBitmap *tbm, BlockNumber pageno);
 static bool tbm_page_is_lossy(const TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_lossify(TIDBitmap *tbm);
+static void tbm_prepare_sorted(TIDBitmap *tbm);
+static void tbm_sort_entries(TIDBitmap *tbm, PagetableEntry **entries, int n);
+static void tbm_extract_page_tuples(const PagetableEntry *page,
+						TBMIterateResult *output);
 static int	tbm_comparator(const void *left, const void *right);
 
+/* define hashtable mapping block numbers to PagetableEntry's */
+#define SH_PREFIX pagetable
+#define SH_ELEMENT_TYPE PagetableEntry
+#define SH_KEY_TYPE BlockNumber
+#define SH_KEY blockno
+#define SH_HASH_KEY(tb, key) murmurhash32(key)
+#define SH_EQUAL(tb, a, b) a == b
+#define SH_SCOPE static inline
+#define SH_DEFINE
+#define SH_DECLARE
+#include "lib/simplehash.h"
+
 
 /*
  * tbm_create - create an initially-empty bitmap
@@ -189,15 +247,14 @@ tbm_create(long maxbytes)
 	tbm->status = TBM_EMPTY;
 
 	/*
-	 * Estimate number of hashtable entries we can have within maxbytes. This
-	 * estimates the hash overhead at MAXALIGN(sizeof(HASHELEMENT)) plus a
-	 * pointer per hash entry, which is crude but good enough for our purpose.
-	 * Also count an extra Pointer per entry for the arrays created during
-	 * iteration readout.
+	 * Estimate number of hashtable entries we can have within maxbytes. The
+	 * entries live directly in the bucket array, so this estimates the hash
+	 * overhead as one pointer's worth of unused buckets per entry, which is
+	 * crude but good enough for our purpose.  Also count an extra Pointer
+	 * per entry for the arrays created during iteration readout.
 	 */
 	nbuckets = maxbytes /
-		(MAXALIGN(sizeof(HASHELEMENT)) + MAXALIGN(sizeof(PagetableEntry))
-		 + sizeof(Pointer) + sizeof(Pointer));
+		(sizeof(PagetableEntry) + sizeof(Pointer) + sizeof(Pointer));
 	nbuckets = Min(nbuckets, INT_MAX - 1);		/* safety limit */
 	nbuckets = Max(nbuckets, 16);		/* sanity limit */
 	tbm->maxentries = (int) nbuckets;
@@ -212,32 +269,28 @@ tbm_create(long maxbytes)
 static void
 tbm_create_pagetable(TIDBitmap *tbm)
 {
-	HASHCTL		hash_ctl;
-
 	Assert(tbm->status != TBM_HASH);
 	Assert(tbm->pagetable == NULL);
 
 	/* Create the hashtable proper */
-	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(BlockNumber);
-	hash_ctl.entrysize = sizeof(PagetableEntry);
-	hash_ctl.hcxt = tbm->mcxt;
-	tbm->pagetable = hash_create("TIDBitmap",
-								 128,	/* start small and extend */
-								 &hash_ctl,
-								 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	tbm->pagetable = pagetable_create(tbm->mcxt,
+									  128,	/* start small and extend */
+									  NULL);
 
 	/* If entry1 is valid, push it into the hashtable */
 	if (tbm->status == TBM_ONE_PAGE)
 	{
 		PagetableEntry *page;
 		bool		found;
+		char		oldstatus;
 
-		page = (PagetableEntry *) hash_search(tbm->pagetable,
-											  (void *) &tbm->entry1.blockno,
-											  HASH_ENTER, &found);
+		page = pagetable_insert(tbm->pagetable,
+								tbm->entry1.blockno,
+								&found);
 		Assert(!found);
+		oldstatus = page->status;
 		memcpy(page, &tbm->entry1, sizeof(PagetableEntry));
+		page->status = oldstatus;
 	}
 
 	tbm->status = TBM_HASH;
@@ -250,7 +303,7 @@ void
 tbm_free(TIDBitmap *tbm)
 {
 	if (tbm->pagetable)
-		hash_destroy(tbm->pagetable);
+		pagetable_destroy(tbm->pagetable);
 	if (tbm->spages)
 		pfree(tbm->spages);
 	if (tbm->schunks)
@@ -357,12 +410,12 @@ tbm_union(TIDBitmap *a, const TIDBitmap *b)
 		tbm_union_page(a, &b->entry1);
 	else
 	{
-		HASH_SEQ_STATUS status;
+		pagetable_iterator i;
 		PagetableEntry *bpage;
 
 		Assert(b->status == TBM_HASH);
-		hash_seq_init(&status, b->pagetable);
-		while ((bpage = (PagetableEntry *) hash_seq_search(&status)) != NULL)
+		pagetable_start_iterate(b->pagetable, &i);
+		while ((bpage = pagetable_iterate(b->pagetable, &i)) != NULL)
 			tbm_union_page(a, bpage);
 	}
 }
@@ -449,12 +502,12 @@ tbm_intersect(TIDBitmap *a, const TIDBitmap *b)
 	}
 	else
 	{
-		HASH_SEQ_STATUS status;
+		pagetable_iterator i;
 		PagetableEntry *apage;
 
 		Assert(a->status == TBM_HASH);
-		hash_seq_init(&status, a->pagetable);
-		while ((apage = (PagetableEntry *) hash_seq_search(&status)) != NULL)
+		pagetable_start_iterate(a->pagetable, &i);
+		while ((apage = pagetable_iterate(a->pagetable, &i)) != NULL)
 		{
 			if (tbm_intersect_page(a, apage, b))
 			{
@@ -464,9 +517,7 @@ tbm_intersect(TIDBitmap *a, const TIDBitmap *b)
 				else
 					a->npages--;
 				a->nentries--;
-				if (hash_search(a->pagetable,
-								(void *) &apage->blockno,
-								HASH_REMOVE, NULL) == NULL)
+				if (!pagetable_delete(a->pagetable, apage->blockno))
 					elog(ERROR, "hash table corrupted");
 			}
 		}
@@ -598,15 +649,25 @@ tbm_begin_iterate(TIDBitmap *tbm)
 	iterator->schunkptr = 0;
 	iterator->schunkbit = 0;
 
-	/*
-	 * If we have a hashtable, create and fill the sorted page lists, unless
-	 * we already did that for a previous iterator.  Note that the lists are
-	 * attached to the bitmap not the iterator, so they can be used by more
-	 * than one iterator.
-	 */
+	tbm_prepare_sorted(tbm);
+
+	return iterator;
+}
+
+/*
+ * tbm_prepare_sorted - make the sorted page lists for iterating, if needed
+ *
+ * If we have a hashtable, create and fill the sorted page lists, unless we
+ * already did that for a previous iterator.  Note that the lists are
+ * attached to the bitmap not the iterator, so they can be used by more
+ * than one iterator.  Either way, the bitmap becomes read-only.
+ */
+static void
+tbm_prepare_sorted(TIDBitmap *tbm)
+{
 	if (tbm->status == TBM_HASH && !tbm->iterating)
 	{
-		HASH_SEQ_STATUS status;
+		pagetable_iterator i;
 		PagetableEntry *page;
 		int			npages;
 		int			nchunks;
@@ -620,9 +681,9 @@ tbm_begin_iterate(TIDBitmap *tbm)
 				MemoryContextAlloc(tbm->mcxt,
 								   tbm->nchunks * sizeof(PagetableEntry *));
 
-		hash_seq_init(&status, tbm->pagetable);
+		pagetable_start_iterate(tbm->pagetable, &i);
 		npages = nchunks = 0;
-		while ((page = (PagetableEntry *) hash_seq_search(&status)) != NULL)
+		while ((page = pagetable_iterate(tbm->pagetable, &i)) != NULL)
 		{
 			if (page->ischunk)
 				tbm->schunks[nchunks++] = page;
@@ -631,17 +692,75 @@ tbm_begin_iterate(TIDBitmap *tbm)
 		}
 		Assert(npages == tbm->npages);
 		Assert(nchunks == tbm->nchunks);
-		if (npages > 1)
-			qsort(tbm->spages, npages, sizeof(PagetableEntry *),
-				  tbm_comparator);
-		if (nchunks > 1)
-			qsort(tbm->schunks, nchunks, sizeof(PagetableEntry *),
-				  tbm_comparator);
+		tbm_sort_entries(tbm, tbm->spages, npages);
+		tbm_sort_entries(tbm, tbm->schunks, nchunks);
 	}
 
 	tbm->iterating = true;
+}
 
-	return iterator;
+/*
+ * tbm_sort_entries - sort PagetableEntry pointers by block number
+ *
+ * Big bitmaps are sorted with a radix sort, a byte of the block number at a
+ * time, which is a lot faster than qsort() on them.  A byte that is the
+ * same in all of the block numbers is skipped; that's usually true of the
+ * high bytes at least.
+ */
+static void
+tbm_sort_entries(TIDBitmap *tbm, PagetableEntry **entries, int n)
+{
+	PagetableEntry **src = entries;
+	PagetableEntry **dst;
+	PagetableEntry **tmp;
+	PagetableEntry **swap;
+	int			shift;
+
+	if (n < TBM_RADIX_SORT_MIN)
+	{
+		if (n > 1)
+			qsort(entries, n, sizeof(PagetableEntry *), tbm_comparator);
+		return;
+	}
+
+	tmp = dst = (PagetableEntry **)
+		MemoryContextAlloc(tbm->mcxt, n * sizeof(PagetableEntry *));
+
+	for (shift = 0; shift < 32; shift += 8)
+	{
+		int			offsets[256];
+		int			total;
+		int			b;
+		int			i;
+
+		memset(offsets, 0, sizeof(offsets));
+		for (i = 0; i < n; i++)
+			offsets[(src[i]->blockno >> shift) & 0xFF]++;
+		if (offsets[(src[0]->blockno >> shift) & 0xFF] == n)
+			continue;
+
+		/* turn the counts into the offsets each byte value starts at */
+		total = 0;
+		for (b = 0; b < 256; b++)
+		{
+			int			count = offsets[b];
+
+			offsets[b] = total;
+			total += count;
+		}
+
+		for (i = 0; i < n; i++)
+			dst[offsets[(src[i]->blockno >> shift) & 0xFF]++] = src[i];
+
+		/* the output of this pass is the input of the next */
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != entries)
+		memcpy(entries, src, n * sizeof(PagetableEntry *));
+	pfree(tmp);
 }
 
 /*
@@ -717,8 +836,6 @@ tbm_iterate(TBMIterator *iterator)
 	if (iterator->spageptr < tbm->npages)
 	{
 		PagetableEntry *page;
-		int			ntuples;
-		int			wordnum;
 
 		/* In ONE_PAGE state, we don't allocate an spages[] array */
 		if (tbm->status == TBM_ONE_PAGE)
@@ -726,28 +843,7 @@ tbm_iterate(TBMIterator *iterator)
 		else
 			page = tbm->spages[iterator->spageptr];
 
-		/* scan bitmap to extract individual offset numbers */
-		ntuples = 0;
-		for (wordnum = 0; wordnum < WORDS_PER_PAGE; wordnum++)
-		{
-			bitmapword	w = page->words[wordnum];
-
-			if (w != 0)
-			{
-				int			off = wordnum * BITS_PER_BITMAPWORD + 1;
-
-				while (w != 0)
-				{
-					if (w & 1)
-						output->offsets[ntuples++] = (OffsetNumber) off;
-					off++;
-					w >>= 1;
-				}
-			}
-		}
-		output->blockno = page->blockno;
-		output->ntuples = ntuples;
-		output->recheck = page->recheck;
+		tbm_extract_page_tuples(page, output);
 		iterator->spageptr++;
 		return output;
 	}
@@ -756,6 +852,39 @@ tbm_iterate(TBMIterator *iterator)
 	return NULL;
 }
 
+/*
+ * tbm_extract_page_tuples - report an exact page in a TBMIterateResult
+ */
+static void
+tbm_extract_page_tuples(const PagetableEntry *page, TBMIterateResult *output)
+{
+	int			ntuples;
+	int			wordnum;
+
+	/* scan bitmap to extract individual offset numbers */
+	ntuples = 0;
+	for (wordnum = 0; wordnum < WORDS_PER_PAGE; wordnum++)
+	{
+		bitmapword	w = page->words[wordnum];
+
+		if (w != 0)
+		{
+			int			off = wordnum * BITS_PER_BITMAPWORD + 1;
+
+			while (w != 0)
+			{
+				if (w & 1)
+					output->offsets[ntuples++] = (OffsetNumber) off;
+				off++;
+				w >>= 1;
+			}
+		}
+	}
+	output->blockno = page->blockno;
+	output->ntuples = ntuples;
+	output->recheck = page->recheck;
+}
+
 /*
  * tbm_end_iterate - finish an iteration over a TIDBitmap
  *
@@ -769,6 +898,159 @@ tbm_end_iterate(TBMIterator *iterator)
 	pfree(iterator);
 }
 
+/*
+ * tbm_shared_size - size of the shared memory tbm_prepare_shared_iterate
+ *		needs for a bitmap
+ */
+Size
+tbm_shared_size(const TIDBitmap *tbm)
+{
+	return add_size(offsetof(TBMSharedIteratorState, entries),
+					mul_size(tbm->npages + tbm->nchunks,
+							 sizeof(PagetableEntry)));
+}
+
+/*
+ * tbm_prepare_shared_iterate - copy a bitmap into shared memory for
+ *		iterating over it together with other processes
+ *
+ * space must have room for tbm_shared_size(tbm) bytes, and be suitably
+ * aligned, as shm_toc_allocate() does for instance.  The bitmap becomes
+ * read-only, as with tbm_begin_iterate, but the copy doesn't depend on it,
+ * so it can be freed afterwards.  The copy needs no cleanup.
+ *
+ * The shared iteration must be set up by a single process before any
+ * process attaches to it with tbm_attach_shared_iterate.
+ */
+TBMSharedIteratorState *
+tbm_prepare_shared_iterate(TIDBitmap *tbm, void *space)
+{
+	TBMSharedIteratorState *state = (TBMSharedIteratorState *) space;
+	PagetableEntry *entry;
+	int			i;
+
+	tbm_prepare_sorted(tbm);
+
+	SpinLockInit(&state->mutex);
+	state->spageptr = 0;
+	state->schunkptr = 0;
+	state->schunkbit = 0;
+	state->npages = tbm->npages;
+	state->nchunks = tbm->nchunks;
+
+	entry = state->entries;
+	if (tbm->status == TBM_ONE_PAGE)
+		memcpy(entry++, &tbm->entry1, sizeof(PagetableEntry));
+	else if (tbm->status == TBM_HASH)
+	{
+		for (i = 0; i < tbm->npages; i++)
+			memcpy(entry++, tbm->spages[i], sizeof(PagetableEntry));
+		for (i = 0; i < tbm->nchunks; i++)
+			memcpy(entry++, tbm->schunks[i], sizeof(PagetableEntry));
+	}
+
+	return state;
+}
+
+/*
+ * tbm_attach_shared_iterate - join a shared iteration
+ *
+ * The TBMSharedIterator is created in the caller's memory context; call
+ * tbm_end_shared_iterate when done with it.
+ */
+TBMSharedIterator *
+tbm_attach_shared_iterate(TBMSharedIteratorState *state)
+{
+	TBMSharedIterator *iterator;
+
+	iterator = (TBMSharedIterator *) palloc(sizeof(TBMSharedIterator) +
+								 MAX_TUPLES_PER_PAGE * sizeof(OffsetNumber));
+	iterator->state = state;
+
+	return iterator;
+}
+
+/*
+ * tbm_shared_iterate - get the next page of a shared iteration
+ *
+ * Like tbm_iterate, but each page goes to only one of the processes
+ * iterating together.  Each process gets its pages in numerical order, but
+ * of course the pages go out interleaved among them.
+ */
+TBMIterateResult *
+tbm_shared_iterate(TBMSharedIterator *iterator)
+{
+	TBMSharedIteratorState *state = iterator->state;
+	TBMIterateResult *output = &(iterator->output);
+	PagetableEntry *chunks = state->entries + state->npages;
+	PagetableEntry *page = NULL;
+
+	SpinLockAcquire(&state->mutex);
+
+	/* Advance to the next set bit of the lossy chunks, as in tbm_iterate */
+	while (state->schunkptr < state->nchunks)
+	{
+		PagetableEntry *chunk = &chunks[state->schunkptr];
+		int			schunkbit = state->schunkbit;
+
+		while (schunkbit < PAGES_PER_CHUNK)
+		{
+			int			wordnum = WORDNUM(schunkbit);
+			int			bitnum = BITNUM(schunkbit);
+
+			if ((chunk->words[wordnum] & ((bitmapword) 1 << bitnum)) != 0)
+				break;
+			schunkbit++;
+		}
+		if (schunkbit < PAGES_PER_CHUNK)
+		{
+			state->schunkbit = schunkbit;
+			break;
+		}
+		state->schunkptr++;
+		state->schunkbit = 0;
+	}
+
+	if (state->schunkptr < state->nchunks)
+	{
+		BlockNumber chunk_blockno;
+
+		chunk_blockno = chunks[state->schunkptr].blockno + state->schunkbit;
+		if (state->spageptr >= state->npages ||
+			chunk_blockno < state->entries[state->spageptr].blockno)
+		{
+			state->schunkbit++;
+			SpinLockRelease(&state->mutex);
+
+			/* Return a lossy page indicator from the chunk */
+			output->blockno = chunk_blockno;
+			output->ntuples = -1;
+			output->recheck = true;
+			return output;
+		}
+	}
+
+	if (state->spageptr < state->npages)
+		page = &state->entries[state->spageptr++];
+
+	SpinLockRelease(&state->mutex);
+
+	/* The entries don't change, so this can be done without the lock */
+	if (page == NULL)
+		return NULL;
+	tbm_extract_page_tuples(page, output);
+	return output;
+}
+
+/*
+ * tbm_end_shared_iterate - leave a shared iteration
+ */
+void
+tbm_end_shared_iterate(TBMSharedIterator *iterator)
+{
+	pfree(iterator);
+}
+
 /*
  * tbm_find_pageentry - find a PagetableEntry for the pageno
  *
@@ -791,9 +1073,7 @@ tbm_find_pageentry(const TIDBitmap *tbm, BlockNumber pageno)
 		return page;
 	}
 
-	page = (PagetableEntry *) hash_search(tbm->pagetable,
-										  (void *) &pageno,
-										  HASH_FIND, NULL);
+	page = pagetable_lookup(tbm->pagetable, pageno);
 	if (page == NULL)
 		return NULL;
 	if (page->ischunk)
@@ -834,15 +1114,16 @@ tbm_get_pageentry(TIDBitmap *tbm, BlockNumber pageno)
 		}
 
 		/* Look up or create an entry */
-		page = (PagetableEntry *) hash_search(tbm->pagetable,
-											  (void *) &pageno,
-											  HASH_ENTER, &found);
+		page = pagetable_insert(tbm->pagetable, pageno, &found);
 	}
 
 	/* Initialize it if not present before */
 	if (!found)
 	{
+		char		oldstatus = page->status;
+
 		MemSet(page, 0, sizeof(PagetableEntry));
+		page->status = oldstatus;
 		page->blockno = pageno;
 		/* must count it too */
 		tbm->nentries++;
@@ -869,9 +1150,7 @@ tbm_page_is_lossy(const TIDBitmap *tbm, BlockNumber pageno)
 
 	bitno = pageno % PAGES_PER_CHUNK;
 	chunk_pageno = pageno - bitno;
-	page = (PagetableEntry *) hash_search(tbm->pagetable,
-										  (void *) &chunk_pageno,
-										  HASH_FIND, NULL);
+	page = pagetable_lookup(tbm->pagetable, chunk_pageno);
 	if (page != NULL && page->ischunk)
 	{
 		int			wordnum = WORDNUM(bitno);
@@ -912,9 +1191,7 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 	 */
 	if (bitno != 0)
 	{
-		if (hash_search(tbm->pagetable,
-						(void *) &pageno,
-						HASH_REMOVE, NULL) != NULL)
+		if (pagetable_delete(tbm->pagetable, pageno))
 		{
 			/* It was present, so adjust counts */
 			tbm->nentries--;
@@ -923,14 +1200,15 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 	}
 
 	/* Look up or create entry for chunk-header page */
-	page = (PagetableEntry *) hash_search(tbm->pagetable,
-										  (void *) &chunk_pageno,
-										  HASH_ENTER, &found);
+	page = pagetable_insert(tbm->pagetable, chunk_pageno, &found);
 
 	/* Initialize it if not present before */
 	if (!found)
 	{
+		char		oldstatus = page->status;
+
 		MemSet(page, 0, sizeof(PagetableEntry));
+		page->status = oldstatus;
 		page->blockno = chunk_pageno;
 		page->ischunk = true;
 		/* must count it too */
@@ -940,7 +1218,10 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 	else if (!page->ischunk)
 	{
 		/* chunk header page was formerly non-lossy, make it lossy */
+		char		oldstatus = page->status;
+
 		MemSet(page, 0, sizeof(PagetableEntry));
+		page->status = oldstatus;
 		page->blockno = chunk_pageno;
 		page->ischunk = true;
 		/* we assume it had some tuple bit(s) set, so mark it lossy */
@@ -962,7 +1243,7 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 static void
 tbm_lossify(TIDBitmap *tbm)
 {
-	HASH_SEQ_STATUS status;
+	pagetable_iterator i;
 	PagetableEntry *page;
 
 	/*
@@ -977,8 +1258,12 @@ tbm_lossify(TIDBitmap *tbm)
 	Assert(!tbm->iterating);
 	Assert(tbm->status == TBM_HASH);
 
-	hash_seq_init(&status, tbm->pagetable);
-	while ((page = (PagetableEntry *) hash_seq_search(&status)) != NULL)
+	/*
+	 * Start where the previous call left off, so that repeated calls don't
+	 * keep lossifying the same region of the table.
+	 */
+	pagetable_start_iterate_at(tbm->pagetable, &i, tbm->lossify_start);
+	while ((page = pagetable_iterate(tbm->pagetable, &i)) != NULL)
 	{
 		if (page->ischunk)
 			continue;			/* already a chunk header */
@@ -996,14 +1281,15 @@ tbm_lossify(TIDBitmap *tbm)
 		if (tbm->nentries <= tbm->maxentries / 2)
 		{
 			/* we have done enough */
-			hash_seq_term(&status);
+			tbm->lossify_start = i.cur;
 			break;
 		}
 
 		/*
 		 * Note: tbm_mark_page_lossy may have inserted a lossy chunk into the
-		 * hashtable.  We can continue the same seq_search scan since we do
-		 * not care whether we visit lossy chunks or not.
+		 * hashtable and can have moved entries around.  We can continue the
+		 * same scan since we do not care whether we visit lossy chunks or
+		 * not, or whether we visit a page twice.
 		 */
 	}
 
@@ -132,6 +132,7 @@ make_one_rel(PlannerInfo *root, List *joinlist)
 {
 	RelOptInfo *rel;
 	Index		rti;
+	double		total_pages;
 
 	/*
 	 * Construct the all_baserels Relids set.
@@ -161,6 +162,41 @@ make_one_rel(PlannerInfo *root, List *joinlist)
 	 * Generate access paths for the base rels.
 	 */
 	set_base_rel_sizes(root);
+
+	/*
+	 * We should now have size estimates for every actual table involved in
+	 * the query, and we also know which if any have been deleted from the
+	 * query by join removal or excluded by constraints; so we can compute
+	 * total_table_pages.  This can't be done any earlier, because the sizes
+	 * of appendrel children are only fetched by set_append_rel_size.
+	 *
+	 * Note that appendrels are not double-counted here, even though we don't
+	 * bother to distinguish RelOptInfos for appendrel parents, because the
+	 * parents will still have size zero.
+	 *
+	 * XXX if a table is self-joined, we will count it once per appearance,
+	 * which perhaps is the wrong thing ... but that's not completely clear,
+	 * and detecting self-joins here is difficult, so ignore it for now.
+	 */
+	total_pages = 0;
+	for (rti = 1; rti < root->simple_rel_array_size; rti++)
+	{
+		RelOptInfo *brel = root->simple_rel_array[rti];
+
+		if (brel == NULL)
+			continue;
+
+		Assert(brel->relid == rti);		/* sanity check on array */
+
+		if (IS_DUMMY_REL(brel))
+			continue;
+
+		if (brel->reloptkind == RELOPT_BASEREL ||
+			brel->reloptkind == RELOPT_OTHER_MEMBER_REL)
+			total_pages += (double) brel->pages;
+	}
+	root->total_table_pages = total_pages;
+
 	set_base_rel_pathlists(root);
 
 	/*
@@ -752,6 +788,14 @@ set_append_rel_size(PlannerInfo *root, RelOptInfo *rel,
 		 * otherrels.  So we just leave the child's attr_needed empty.
 		 */
 
+		/*
+		 * Now that we know the child will be scanned, collect the catalog
+		 * information build_simple_rel left out for it.
+		 */
+		if (childRTE->rtekind == RTE_RELATION)
+			get_relation_physical_info(root, childRTE->relid, childRTE->inh,
+									   childrel);
+
 		/*
 		 * Compute the child's size.
 		 */
@@ -1726,7 +1770,8 @@ make_rel_from_joinlist(PlannerInfo *root, List *joinlist)
 	{
 		/*
 		 * Consider the different orders in which we could join the rels,
-		 * using a plugin, GEQO, or the regular join search code.
+		 * using a plugin, GEQO or the greedy heuristic, the hypergraph
+		 * search, or the regular join search code.
 		 *
 		 * We put the initial_rels list into a PlannerInfo field because
 		 * has_legal_joinclause() needs to look at it (ugly :-().
@@ -1736,7 +1781,14 @@ make_rel_from_joinlist(PlannerInfo *root, List *joinlist)
 		if (join_search_hook)
 			return (*join_search_hook) (root, levels_needed, initial_rels);
 		else if (enable_geqo && levels_needed >= geqo_threshold)
+		{
+			if (join_search_heuristic == JOIN_SEARCH_GREEDY)
+				return greedy_join_search(root, levels_needed, initial_rels);
 			return geqo(root, levels_needed, initial_rels);
+		}
+		else if (levels_needed >= hypergraph_join_threshold &&
+				 levels_needed <= HYPERGRAPH_MAX_NODES)
+			return hypergraph_join_search(root, levels_needed, initial_rels);
 		else
 			return standard_join_search(root, levels_needed, initial_rels);
 	}
@@ -2583,6 +2635,10 @@ print_path(PlannerInfo *root, Path *path, int indent)
 			ptype = "Material";
 			subpath = ((MaterialPath *) path)->subpath;
 			break;
+		case T_MemoizePath:
+			ptype = "Memoize";
+			subpath = ((MemoizePath *) path)->subpath;
+			break;
 		case T_UniquePath:
 			ptype = "Unique";
 			subpath = ((UniquePath *) path)->subpath;
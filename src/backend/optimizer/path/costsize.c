@@ -113,11 +113,15 @@ bool		enable_indexonlyscan = true;
 bool		enable_bitmapscan = true;
 bool		enable_tidscan = true;
 bool		enable_sort = true;
+bool		enable_eager_aggregate = false;
+bool		enable_incremental_sort = true;
 bool		enable_hashagg = true;
 bool		enable_nestloop = true;
 bool		enable_material = true;
+bool		enable_memoize = true;
 bool		enable_mergejoin = true;
 bool		enable_hashjoin = true;
+bool		enable_partitionwise_join = false;
 
 typedef struct
 {
@@ -131,6 +135,8 @@ static MergeScanSelCache *cached_scansel(PlannerInfo *root,
 			   PathKey *pathkey);
 static void cost_rescan(PlannerInfo *root, Path *path,
 			Cost *rescan_startup_cost, Cost *rescan_total_cost);
+static void cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
+					Cost *rescan_startup_cost, Cost *rescan_total_cost);
 static bool cost_qual_eval_walker(Node *node, cost_qual_eval_context *context);
 static void get_restriction_qual_cost(PlannerInfo *root, RelOptInfo *baserel,
 						  ParamPathInfo *param_info,
@@ -1441,6 +1447,107 @@ cost_sort(Path *path, PlannerInfo *root,
 	path->total_cost = startup_cost + run_cost;
 }
 
+/*
+ * cost_incremental_sort
+ *	  Determines and returns the cost of sorting input that is already
+ *	  sorted on a leading prefix of the wanted pathkeys.
+ *
+ * An IncrementalSort node divides its input into groups of tuples having
+ * equal values for the first 'presorted_keys' sort keys, and sorts each
+ * group separately on the full set of keys.  We estimate the number of such
+ * groups from the presorted key expressions and charge one cost_sort() worth
+ * of work per group, scaled up by 50% to allow for groups being of uneven
+ * size.  The first group has to be read and sorted before the first output
+ * tuple can be returned, which is what makes this attractive below a LIMIT.
+ *
+ * Besides the arguments accepted by cost_sort(), the caller supplies the
+ * input path's startup cost and the number of presorted leading pathkeys.
+ */
+void
+cost_incremental_sort(Path *path, PlannerInfo *root,
+					  List *pathkeys, int presorted_keys,
+					  Cost input_startup_cost, Cost input_total_cost,
+					  double input_tuples, int width, Cost comparison_cost,
+					  int sort_mem, double limit_tuples)
+{
+	Cost		startup_cost = 0;
+	Cost		run_cost = 0;
+	Cost		input_run_cost = input_total_cost - input_startup_cost;
+	Cost		group_startup_cost;
+	Cost		group_run_cost;
+	Cost		group_input_run_cost;
+	double		group_tuples;
+	double		input_groups;
+	List	   *presortedExprs = NIL;
+	ListCell   *l;
+	int			i = 0;
+	Path		sort_path;		/* dummy for result of cost_sort */
+
+	Assert(presorted_keys > 0 && presorted_keys < list_length(pathkeys));
+
+	/* Make sure the input row count is sane, as cost_sort does */
+	if (input_tuples < 2.0)
+		input_tuples = 2.0;
+
+	/* Collect one representative expression per presorted key */
+	foreach(l, pathkeys)
+	{
+		PathKey    *key = (PathKey *) lfirst(l);
+		EquivalenceMember *member = (EquivalenceMember *)
+		linitial(key->pk_eclass->ec_members);
+
+		presortedExprs = lappend(presortedExprs, member->em_expr);
+
+		if (++i >= presorted_keys)
+			break;
+	}
+
+	/* Estimate the number of groups with equal presorted keys */
+	input_groups = estimate_num_groups(root, presortedExprs, input_tuples,
+									   NULL);
+	group_tuples = input_tuples / input_groups;
+	group_input_run_cost = input_run_cost / input_groups;
+
+	/*
+	 * Estimate the cost of sorting one group.  We deliberately overestimate
+	 * the group size, since a single big group can make the whole sort much
+	 * more expensive than the average would suggest.
+	 */
+	cost_sort(&sort_path, root, pathkeys, 0.0,
+			  1.5 * group_tuples, width, comparison_cost, sort_mem,
+			  limit_tuples);
+
+	group_startup_cost = sort_path.startup_cost;
+	group_run_cost = sort_path.total_cost - sort_path.startup_cost;
+
+	/* enable_sort governs only full sorts; don't charge its penalty per group */
+	if (!enable_sort)
+		group_startup_cost -= disable_cost;
+
+	/*
+	 * Startup requires reading and sorting the first group; the remaining
+	 * groups are all charged to the run cost.
+	 */
+	startup_cost = group_startup_cost + input_startup_cost +
+		group_input_run_cost;
+	run_cost = group_run_cost + (group_run_cost + group_startup_cost) *
+		(input_groups - 1) + group_input_run_cost * (input_groups - 1);
+
+	/*
+	 * Each input tuple is also compared against the current group's pivot on
+	 * the presorted keys, and each group pays for resetting its tuplesort.
+	 */
+	run_cost += (cpu_tuple_cost + comparison_cost) * input_tuples;
+	run_cost += 2.0 * cpu_tuple_cost * input_groups;
+
+	if (!enable_incremental_sort)
+		startup_cost += disable_cost;
+
+	path->rows = input_tuples;
+	path->startup_cost = startup_cost;
+	path->total_cost = startup_cost + run_cost;
+}
+
 /*
  * cost_merge_append
  *	  Determines and returns the cost of a MergeAppend node.
@@ -3023,6 +3130,10 @@ cost_rescan(PlannerInfo *root, Path *path,
 				*rescan_total_cost = run_cost;
 			}
 			break;
+		case T_Memoize:
+			cost_memoize_rescan(root, (MemoizePath *) path,
+								rescan_startup_cost, rescan_total_cost);
+			break;
 		default:
 			*rescan_startup_cost = path->startup_cost;
 			*rescan_total_cost = path->total_cost;
@@ -3030,6 +3141,80 @@ cost_rescan(PlannerInfo *root, Path *path,
 	}
 }
 
+/*
+ * cost_memoize_rescan
+ *	  Determines the average cost of a rescan of a Memoize node.
+ *
+ * What a rescan costs depends on how likely its parameter values are to be
+ * found in the cache, which we estimate from the number of distinct values
+ * among the mpath->calls rescans and the number of entries that will fit in
+ * work_mem.  As a side effect, we remember the latter in mpath->est_entries
+ * so the executor can size its hash table.
+ */
+static void
+cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
+					Cost *rescan_startup_cost, Cost *rescan_total_cost)
+{
+	Path	   *subpath = mpath->subpath;
+	double		tuples = subpath->rows;
+	double		calls = mpath->calls;
+	double		work_mem_bytes = work_mem * 1024.0;
+	double		est_entry_bytes;
+	double		est_cache_entries;
+	double		ndistinct;
+	double		hit_ratio;
+	double		evict_ratio;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/*
+	 * Each entry stores its key and its tuples, and each tuple a link to the
+	 * next; charge a few words per entry and per tuple for that overhead.
+	 */
+	est_entry_bytes = relation_byte_size(tuples, subpath->parent->width) +
+		tuples * MAXALIGN(2 * sizeof(void *)) + MAXALIGN(8 * sizeof(void *));
+	est_cache_entries = floor(work_mem_bytes / est_entry_bytes);
+
+	ndistinct = estimate_num_groups(root, mpath->param_exprs, calls, NULL);
+
+	mpath->est_entries = (uint32) Max(Min(Min(ndistinct, est_cache_entries),
+										  (double) PG_UINT32_MAX), 1.0);
+
+	/*
+	 * If not all the distinct keys fit, we expect to evict an entry on this
+	 * fraction of the misses.
+	 */
+	evict_ratio = 1.0 - Min(est_cache_entries, ndistinct) / ndistinct;
+
+	/*
+	 * Every distinct key misses the first time it's seen; after that, it
+	 * hits if it's still in the cache, which we take to be likely in
+	 * proportion to the fraction of the keys that fit.
+	 */
+	hit_ratio = ((calls - ndistinct) / calls) *
+		(est_cache_entries / Max(ndistinct, est_cache_entries));
+	hit_ratio = Max(Min(hit_ratio, 1.0), 0.0);
+
+	/*
+	 * A miss costs a full scan of the subpath, plus a cpu_operator_cost per
+	 * tuple to store it, plus for the evictions a cpu_tuple_cost per entry
+	 * and a little per tuple.  Every rescan pays a cpu_tuple_cost for the
+	 * lookup.
+	 */
+	total_cost = (1.0 - hit_ratio) *
+		(subpath->total_cost + cpu_operator_cost * tuples +
+		 evict_ratio * (cpu_tuple_cost + cpu_operator_cost / 10.0 * tuples));
+	total_cost += cpu_tuple_cost;
+
+	/* a hit returns the cached tuples, about as cheaply as Material */
+	total_cost += hit_ratio * cpu_operator_cost * tuples;
+
+	startup_cost = (1.0 - hit_ratio) * subpath->startup_cost + cpu_tuple_cost;
+
+	*rescan_startup_cost = startup_cost;
+	*rescan_total_cost = total_cost;
+}
+
 
 /*
  * cost_qual_eval
@@ -3169,16 +3354,37 @@ cost_qual_eval_walker(Node *node, cost_qual_eval_context *context)
 	}
 	else if (IsA(node, ScalarArrayOpExpr))
 	{
-		/*
-		 * Estimate that the operator will be applied to about half of the
-		 * array elements before the answer is determined.
-		 */
 		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) node;
 		Node	   *arraynode = (Node *) lsecond(saop->args);
 
 		set_sa_opfuncid(saop);
-		context->total.per_tuple += get_func_cost(saop->opfuncid) *
-			cpu_operator_cost * estimate_array_length(arraynode) * 0.5;
+		if (OidIsValid(saop->hashfuncid))
+		{
+			/*
+			 * Hashing every element once is a startup cost; after that each
+			 * evaluation costs one hash of the scalar plus, typically, one
+			 * equality comparison.
+			 */
+			Cost		hashcost = get_func_cost(saop->hashfuncid) *
+			cpu_operator_cost;
+			Cost		eqcost = get_func_cost(OidIsValid(saop->negfuncid) ?
+											   saop->negfuncid :
+											   saop->opfuncid) *
+			cpu_operator_cost;
+
+			context->total.startup += hashcost *
+				estimate_array_length(arraynode);
+			context->total.per_tuple += hashcost + eqcost;
+		}
+		else
+		{
+			/*
+			 * Estimate that the operator will be applied to about half of the
+			 * array elements before the answer is determined.
+			 */
+			context->total.per_tuple += get_func_cost(saop->opfuncid) *
+				cpu_operator_cost * estimate_array_length(arraynode) * 0.5;
+		}
 	}
 	else if (IsA(node, Aggref) ||
 			 IsA(node, WindowFunc))
@@ -18,9 +18,12 @@
 
 #include "executor/executor.h"
 #include "foreign/fdwapi.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
+#include "utils/typcache.h"
 
 /* Hook for plugins to get control in add_paths_to_joinrel() */
 set_join_pathlist_hook_type set_join_pathlist_hook = NULL;
@@ -34,6 +37,9 @@ static void sort_inner_and_outer(PlannerInfo *root, RelOptInfo *joinrel,
 static void match_unsorted_outer(PlannerInfo *root, RelOptInfo *joinrel,
 					 RelOptInfo *outerrel, RelOptInfo *innerrel,
 					 JoinType jointype, JoinPathExtraData *extra);
+static Path *get_memoize_path(PlannerInfo *root, RelOptInfo *innerrel,
+				 RelOptInfo *outerrel, Path *inner_path,
+				 Path *outer_path, JoinType jointype);
 static void hash_inner_and_outer(PlannerInfo *root, RelOptInfo *joinrel,
 					 RelOptInfo *outerrel, RelOptInfo *innerrel,
 					 JoinType jointype, JoinPathExtraData *extra);
@@ -502,6 +508,99 @@ clause_sides_match_join(RestrictInfo *rinfo, RelOptInfo *outerrel,
 	return false;				/* no good for these input relations */
 }
 
+/*
+ * get_memoize_path
+ *	  If possible, make a Memoize path to cache the results of the
+ *	  parameterized 'inner_path' across rescans with the same parameter
+ *	  values from 'outer_path'.  Returns NULL if that's not possible.
+ *
+ * Whether the cache pays off is left to cost_rescan, based on how many
+ * distinct parameter values it expects.
+ */
+static Path *
+get_memoize_path(PlannerInfo *root, RelOptInfo *innerrel,
+				 RelOptInfo *outerrel, Path *inner_path,
+				 Path *outer_path, JoinType jointype)
+{
+	List	   *param_exprs = NIL;
+	List	   *eq_operators = NIL;
+	ListCell   *lc;
+
+	if (!enable_memoize)
+		return NULL;
+
+	/* The inner path must depend on the outer rel, else there's no point */
+	if (inner_path->param_info == NULL ||
+		inner_path->param_info->ppi_clauses == NIL)
+		return NULL;
+
+	/* Likewise if we don't expect to rescan more than once */
+	if (outer_path->rows < 2)
+		return NULL;
+
+	/*
+	 * Semi- and antijoins stop reading the inner side at the first match,
+	 * which would leave every cache entry incomplete.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT)
+		return NULL;
+
+	/*
+	 * The cache keys must capture everything the inner path gets from
+	 * outside.  We only know that to be the case for a plain base relation
+	 * without lateral references, parameterized by the outer rel alone:
+	 * then the parameterized clauses are all there is.
+	 */
+	if (innerrel->reloptkind != RELOPT_BASEREL ||
+		innerrel->lateral_relids != NULL ||
+		!bms_is_subset(PATH_REQ_OUTER(inner_path), outerrel->relids))
+		return NULL;
+
+	/* Volatile quals might produce different rows for the same keys */
+	if (contain_volatile_functions((Node *) innerrel->baserestrictinfo) ||
+		contain_volatile_functions((Node *) inner_path->param_info->ppi_clauses))
+		return NULL;
+
+	foreach(lc, inner_path->param_info->ppi_clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		Node	   *outer_expr;
+		TypeCacheEntry *typentry;
+
+		/*
+		 * Insist on hashable equality clauses of the form "outer = inner",
+		 * so that outer values which are equal can be relied on to produce
+		 * the same inner rows.
+		 */
+		if (!OidIsValid(rinfo->hashjoinoperator) ||
+			!clause_sides_match_join(rinfo, outerrel, innerrel))
+			return NULL;
+
+		if (rinfo->outer_is_left)
+			outer_expr = get_leftop(rinfo->clause);
+		else
+			outer_expr = get_rightop(rinfo->clause);
+
+		/* we must be able to hash and compare the outer values */
+		typentry = lookup_type_cache(exprType(outer_expr),
+									 TYPECACHE_EQ_OPR | TYPECACHE_HASH_PROC);
+		if (!OidIsValid(typentry->eq_opr) ||
+			!OidIsValid(typentry->hash_proc))
+			return NULL;
+
+		/* there's no need to key on the same value twice */
+		if (list_member(param_exprs, outer_expr))
+			continue;
+
+		param_exprs = lappend(param_exprs, outer_expr);
+		eq_operators = lappend_oid(eq_operators, typentry->eq_opr);
+	}
+
+	return (Path *) create_memoize_path(root, innerrel, inner_path,
+										param_exprs, eq_operators,
+										outer_path->rows);
+}
+
 /*
  * sort_inner_and_outer
  *	  Create mergejoin join paths by explicitly sorting both the outer and
@@ -838,6 +937,7 @@ match_unsorted_outer(PlannerInfo *root,
 			foreach(lc2, innerrel->cheapest_parameterized_paths)
 			{
 				Path	   *innerpath = (Path *) lfirst(lc2);
+				Path	   *mpath;
 
 				try_nestloop_path(root,
 								  joinrel,
@@ -846,6 +946,21 @@ match_unsorted_outer(PlannerInfo *root,
 								  merge_pathkeys,
 								  jointype,
 								  extra);
+
+				/*
+				 * Also consider caching the results of a parameterized inner
+				 * path, in case the outer side repeats parameter values.
+				 */
+				mpath = get_memoize_path(root, innerrel, outerrel,
+										 innerpath, outerpath, jointype);
+				if (mpath != NULL)
+					try_nestloop_path(root,
+									  joinrel,
+									  outerpath,
+									  mpath,
+									  merge_pathkeys,
+									  jointype,
+									  extra);
 			}
 
 			/* Also consider materialized form of the cheapest inner path */
@@ -14,12 +14,43 @@
  */
 #include "postgres.h"
 
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
 #include "optimizer/joininfo.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
+#include "optimizer/plancat.h"
+#include "optimizer/predtest.h"
+#include "optimizer/prep.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 
 
+/*
+ * Limits on the work try_inheritance_wise_join is willing to do: the number
+ * of child pairs whose constraints it compares, and the number of child
+ * joins it plans, as a multiple of the total number of children.
+ */
+#define INHERITANCE_JOIN_MAX_PAIR_TESTS		100000
+#define INHERITANCE_JOIN_MAX_PAIRS_FACTOR	2
+
+/* An appendrel child considered by try_inheritance_wise_join */
+typedef struct InheritanceJoinChild
+{
+	RelOptInfo *rel;			/* the child rel */
+	AppendRelInfo *appinfo;		/* its AppendRelInfo */
+	List	   *constraints;	/* its safe CHECK constraints */
+	List	   *keyvars;		/* join key Vars, translated to the child */
+	List	   *keyquals;		/* per join key, constraints on that key */
+} InheritanceJoinChild;
+
+typedef struct
+{
+	Var		   *from;
+	Var		   *to;
+} replace_key_var_context;
+
 static void make_rels_by_clause_joins(PlannerInfo *root,
 						  RelOptInfo *old_rel,
 						  ListCell *other_rels);
@@ -32,6 +63,20 @@ static bool is_dummy_rel(RelOptInfo *rel);
 static void mark_dummy_rel(RelOptInfo *rel);
 static bool restriction_is_constant_false(List *restrictlist,
 							  bool only_pushed_down);
+static void try_inheritance_wise_join(PlannerInfo *root, RelOptInfo *joinrel,
+						  RelOptInfo *rel1, RelOptInfo *rel2,
+						  List *restrictlist);
+static bool is_inheritance_parent(PlannerInfo *root, RelOptInfo *rel);
+static List *get_inheritance_join_children(PlannerInfo *root,
+							  RelOptInfo *parent,
+							  List *keys, List *opfamilies);
+static List *get_key_constraints(List *constraints, Var *keyvar,
+					List *opfamilies);
+static bool is_key_var(Node *node, Var *keyvar);
+static bool child_join_is_empty(InheritanceJoinChild *child1,
+					InheritanceJoinChild *child2);
+static Node *replace_key_var_mutator(Node *node,
+						replace_key_var_context *context);
 
 
 /*
@@ -757,6 +802,8 @@ make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
 			add_paths_to_joinrel(root, joinrel, rel2, rel1,
 								 JOIN_INNER, sjinfo,
 								 restrictlist);
+			try_inheritance_wise_join(root, joinrel, rel1, rel2,
+									  restrictlist);
 			break;
 		case JOIN_LEFT:
 			if (is_dummy_rel(rel1) ||
@@ -875,6 +922,422 @@ make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
 }
 
 
+/*
+ * try_inheritance_wise_join
+ *	  Consider joining two inheritance trees child by child.
+ *
+ * An inner join of two appendrels is the union of the joins of each child
+ * of one with each child of the other.  When the children's CHECK
+ * constraints partition the rows on the join keys, most of those child
+ * pairs provably can't produce any rows, and an Append of the joins of the
+ * remaining pairs is often much cheaper than joining the two complete
+ * Appends: each hash table or sort covers only a single child.
+ *
+ * A pair is proven empty if the constraints of one child on a join key,
+ * carried over to the other child's key by the join's equality operator,
+ * refute the other child's constraints.  We only carry over simple
+ * "key op constant" constraints whose operator belongs to the btree
+ * opfamily of the equality, since those are the only ones known to give
+ * the same answer for equal keys.
+ *
+ * Only plain inner joins of two inheritance parents are considered.  The
+ * path we build competes with the regular paths of the joinrel on cost.
+ */
+static void
+try_inheritance_wise_join(PlannerInfo *root, RelOptInfo *joinrel,
+						  RelOptInfo *rel1, RelOptInfo *rel2,
+						  List *restrictlist)
+{
+	List	   *keys1 = NIL;
+	List	   *keys2 = NIL;
+	List	   *opfamilies = NIL;
+	List	   *children1;
+	List	   *children2;
+	List	   *pairs = NIL;
+	List	   *subpaths = NIL;
+	int			maxpairs;
+	ListCell   *lc;
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	if (!enable_partitionwise_join)
+		return;
+
+	if (!is_inheritance_parent(root, rel1) ||
+		!is_inheritance_parent(root, rel2))
+		return;
+
+	/* We don't try to translate lateral references to the children */
+	if (rel1->lateral_relids || rel2->lateral_relids)
+		return;
+
+	/*
+	 * The child joins' targetlists are translations of the parent joinrel's,
+	 * which is only straightforward for plain Vars.
+	 */
+	foreach(lc, joinrel->reltargetlist)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (!IsA(var, Var) || var->varattno == 0)
+			return;
+	}
+
+	/* Collect the equality join keys, as parallel lists */
+	foreach(lc, restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr	   *clause;
+		Var		   *left;
+		Var		   *right;
+
+		if (rinfo->mergeopfamilies == NIL || !is_opclause(rinfo->clause))
+			continue;
+		clause = (OpExpr *) rinfo->clause;
+		if (list_length(clause->args) != 2)
+			continue;
+		left = (Var *) linitial(clause->args);
+		right = (Var *) lsecond(clause->args);
+		if (!IsA(left, Var) || !IsA(right, Var) ||
+			left->varattno <= 0 || right->varattno <= 0)
+			continue;
+
+		/* the constraints are carried over as-is, so the types must agree */
+		if (left->vartype != right->vartype ||
+			left->varcollid != right->varcollid)
+			continue;
+
+		if (left->varno == rel1->relid && right->varno == rel2->relid)
+		{
+			keys1 = lappend(keys1, left);
+			keys2 = lappend(keys2, right);
+		}
+		else if (left->varno == rel2->relid && right->varno == rel1->relid)
+		{
+			keys1 = lappend(keys1, right);
+			keys2 = lappend(keys2, left);
+		}
+		else
+			continue;
+		opfamilies = lappend(opfamilies, rinfo->mergeopfamilies);
+	}
+	if (keys1 == NIL)
+		return;
+
+	children1 = get_inheritance_join_children(root, rel1, keys1, opfamilies);
+	if (children1 == NIL)
+		return;
+	children2 = get_inheritance_join_children(root, rel2, keys2, opfamilies);
+	if (children2 == NIL)
+		return;
+
+	if ((double) list_length(children1) * list_length(children2) >
+		INHERITANCE_JOIN_MAX_PAIR_TESTS)
+		return;
+	maxpairs = INHERITANCE_JOIN_MAX_PAIRS_FACTOR *
+		(list_length(children1) + list_length(children2));
+
+	/*
+	 * Find the child pairs that might produce rows.  Give up if there are so
+	 * many of them that the children evidently aren't partitioned alike.
+	 */
+	foreach(lc1, children1)
+	{
+		InheritanceJoinChild *child1 = (InheritanceJoinChild *) lfirst(lc1);
+
+		foreach(lc2, children2)
+		{
+			InheritanceJoinChild *child2 = (InheritanceJoinChild *) lfirst(lc2);
+
+			if (child_join_is_empty(child1, child2))
+				continue;
+			if (list_length(pairs) >= maxpairs)
+				return;
+			pairs = lappend(pairs, list_make2(child1, child2));
+		}
+	}
+
+	/* If no pair can produce rows, neither can the whole join */
+	if (pairs == NIL)
+	{
+		mark_dummy_rel(joinrel);
+		return;
+	}
+
+	/* Plan the join of each remaining pair */
+	foreach(lc, pairs)
+	{
+		InheritanceJoinChild *child1;
+		InheritanceJoinChild *child2;
+		SpecialJoinInfo sjinfo;
+		RelOptInfo *child_joinrel;
+		List	   *child_restrictlist;
+		Path	   *cheapest;
+
+		child1 = (InheritanceJoinChild *) linitial((List *) lfirst(lc));
+		child2 = (InheritanceJoinChild *) lsecond((List *) lfirst(lc));
+
+		/* Make up a SpecialJoinInfo as make_join_rel does for inner joins */
+		sjinfo.type = T_SpecialJoinInfo;
+		sjinfo.min_lefthand = child1->rel->relids;
+		sjinfo.min_righthand = child2->rel->relids;
+		sjinfo.syn_lefthand = child1->rel->relids;
+		sjinfo.syn_righthand = child2->rel->relids;
+		sjinfo.jointype = JOIN_INNER;
+		sjinfo.lhs_strict = false;
+		sjinfo.delay_upper_joins = false;
+		sjinfo.semi_can_btree = false;
+		sjinfo.semi_can_hash = false;
+		sjinfo.semi_operators = NIL;
+		sjinfo.semi_rhs_exprs = NIL;
+
+		child_joinrel = build_child_join_rel(root, joinrel,
+											 child1->rel, child2->rel,
+											 child1->appinfo, child2->appinfo,
+											 &sjinfo, restrictlist,
+											 &child_restrictlist);
+
+		/* Translation might have reduced a join clause to constant false */
+		if (restriction_is_constant_false(child_restrictlist, false))
+			continue;
+
+		add_paths_to_joinrel(root, child_joinrel, child1->rel, child2->rel,
+							 JOIN_INNER, &sjinfo, child_restrictlist);
+		add_paths_to_joinrel(root, child_joinrel, child2->rel, child1->rel,
+							 JOIN_INNER, &sjinfo, child_restrictlist);
+		if (child_joinrel->pathlist == NIL)
+			return;
+		set_cheapest(child_joinrel);
+
+		cheapest = child_joinrel->cheapest_total_path;
+		if (cheapest == NULL || PATH_REQ_OUTER(cheapest) != NULL)
+			return;
+		subpaths = lappend(subpaths, cheapest);
+	}
+
+	add_path(joinrel, (Path *) create_append_path(joinrel, subpaths, NULL));
+}
+
+/*
+ * is_inheritance_parent
+ *		Is rel a base relation that has been expanded into an appendrel of
+ *		its inheritance children?
+ */
+static bool
+is_inheritance_parent(PlannerInfo *root, RelOptInfo *rel)
+{
+	return rel->reloptkind == RELOPT_BASEREL &&
+		rel->rtekind == RTE_RELATION &&
+		root->simple_rte_array[rel->relid]->inh;
+}
+
+/*
+ * get_inheritance_join_children
+ *		Collect the non-dummy children of an inheritance parent, with the
+ *		information try_inheritance_wise_join needs about each.
+ *
+ * Returns NIL if some child can't be handled.
+ */
+static List *
+get_inheritance_join_children(PlannerInfo *root, RelOptInfo *parent,
+							  List *keys, List *opfamilies)
+{
+	List	   *result = NIL;
+	ListCell   *l;
+
+	foreach(l, root->append_rel_list)
+	{
+		AppendRelInfo *appinfo = (AppendRelInfo *) lfirst(l);
+		RelOptInfo *childrel;
+		InheritanceJoinChild *child;
+		ListCell   *lc;
+		ListCell   *lc2;
+
+		/* append_rel_list contains all append rels; ignore others */
+		if (appinfo->parent_relid != parent->relid)
+			continue;
+
+		childrel = find_base_rel(root, appinfo->child_relid);
+
+		/* Excluded children don't take part in the join */
+		if (IS_DUMMY_REL(childrel))
+			continue;
+
+		foreach(lc, childrel->reltargetlist)
+		{
+			if (!IsA(lfirst(lc), Var))
+				return NIL;
+		}
+
+		child = (InheritanceJoinChild *) palloc(sizeof(InheritanceJoinChild));
+		child->rel = childrel;
+		child->appinfo = appinfo;
+		child->constraints =
+			get_relation_pruning_constraints(root, childrel,
+								root->simple_rte_array[appinfo->child_relid]);
+		child->keyvars = NIL;
+		child->keyquals = NIL;
+		forboth(lc, keys, lc2, opfamilies)
+		{
+			Node	   *keyvar;
+
+			keyvar = adjust_appendrel_attrs(root, (Node *) lfirst(lc),
+											appinfo);
+			if (!IsA(keyvar, Var))
+				return NIL;
+			child->keyvars = lappend(child->keyvars, keyvar);
+			child->keyquals =
+				lappend(child->keyquals,
+						get_key_constraints(child->constraints,
+											(Var *) keyvar,
+											(List *) lfirst(lc2)));
+		}
+
+		result = lappend(result, child);
+	}
+
+	return result;
+}
+
+/*
+ * get_key_constraints
+ *		Select the constraints of the form "keyvar op constant" (or
+ *		"keyvar op ANY (array constant)") whose operator is a member of one
+ *		of the given btree opfamilies.
+ */
+static List *
+get_key_constraints(List *constraints, Var *keyvar, List *opfamilies)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach(lc, constraints)
+	{
+		Node	   *clause = (Node *) lfirst(lc);
+		Oid			opno;
+		ListCell   *lc2;
+
+		if (is_opclause(clause) &&
+			list_length(((OpExpr *) clause)->args) == 2)
+		{
+			OpExpr	   *opclause = (OpExpr *) clause;
+			Node	   *leftop = (Node *) linitial(opclause->args);
+			Node	   *rightop = (Node *) lsecond(opclause->args);
+
+			if (!(is_key_var(leftop, keyvar) && IsA(rightop, Const)) &&
+				!(is_key_var(rightop, keyvar) && IsA(leftop, Const)))
+				continue;
+			opno = opclause->opno;
+		}
+		else if (IsA(clause, ScalarArrayOpExpr))
+		{
+			ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) clause;
+
+			if (!saop->useOr ||
+				!is_key_var((Node *) linitial(saop->args), keyvar) ||
+				!IsA(lsecond(saop->args), Const))
+				continue;
+			opno = saop->opno;
+		}
+		else
+			continue;
+
+		foreach(lc2, opfamilies)
+		{
+			if (op_in_opfamily(opno, lfirst_oid(lc2)))
+			{
+				result = lappend(result, clause);
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+/*
+ * is_key_var
+ *		Is node the given key Var, possibly under a binary-compatible
+ *		relabeling?
+ */
+static bool
+is_key_var(Node *node, Var *keyvar)
+{
+	while (node && IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	return node && IsA(node, Var) &&
+		((Var *) node)->varno == keyvar->varno &&
+		((Var *) node)->varattno == keyvar->varattno &&
+		((Var *) node)->varlevelsup == 0;
+}
+
+/*
+ * child_join_is_empty
+ *		Can we prove from the children's constraints that joining them on
+ *		the join keys yields no rows?
+ */
+static bool
+child_join_is_empty(InheritanceJoinChild *child1,
+					InheritanceJoinChild *child2)
+{
+	replace_key_var_context context;
+	List	   *quals;
+	ListCell   *lq;
+	ListCell   *lv1;
+	ListCell   *lv2;
+	ListCell   *lc;
+
+	/* child1's key constraints, applied to child2's keys */
+	quals = NIL;
+	forthree(lq, child1->keyquals, lv1, child1->keyvars, lv2, child2->keyvars)
+	{
+		context.from = (Var *) lfirst(lv1);
+		context.to = (Var *) lfirst(lv2);
+		foreach(lc, (List *) lfirst(lq))
+			quals = lappend(quals,
+							replace_key_var_mutator((Node *) lfirst(lc),
+													&context));
+	}
+	if (quals != NIL && predicate_refuted_by(child2->constraints, quals))
+		return true;
+
+	/* and the other way around */
+	quals = NIL;
+	forthree(lq, child2->keyquals, lv2, child2->keyvars, lv1, child1->keyvars)
+	{
+		context.from = (Var *) lfirst(lv2);
+		context.to = (Var *) lfirst(lv1);
+		foreach(lc, (List *) lfirst(lq))
+			quals = lappend(quals,
+							replace_key_var_mutator((Node *) lfirst(lc),
+													&context));
+	}
+	if (quals != NIL && predicate_refuted_by(child1->constraints, quals))
+		return true;
+
+	return false;
+}
+
+static Node *
+replace_key_var_mutator(Node *node, replace_key_var_context *context)
+{
+	if (node == NULL)
+		return NULL;
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+
+		if (var->varno == context->from->varno &&
+			var->varattno == context->from->varattno &&
+			var->varlevelsup == 0)
+			return (Node *) copyObject(context->to);
+	}
+	return expression_tree_mutator(node, replace_key_var_mutator,
+								   (void *) context);
+}
+
+
 /*
  * have_join_order_restriction
  *		Detect whether the two relations should be joined to satisfy
@@ -0,0 +1,771 @@
+/*-------------------------------------------------------------------------
+ *
+ * joinsearch.c
+ *	  Alternative join-order search strategies for planning problems with
+ *	  many jointree items
+ *
+ * standard_join_search() builds join rels level by level, and at each level
+ * scans the lists of lower-level rels for pairs worth joining.  For many
+ * items that spends most of its time on pairs that can't be joined.  Here we
+ * provide two other ways to search the same space:
+ *
+ * hypergraph_join_search() is an exact dynamic-programming search that
+ * enumerates only the pairs of connected sub-problems of the query's join
+ * hypergraph, each pair exactly once, following Moerkotte and Neumann's
+ * DPhyp algorithm ("Dynamic Programming Strikes Back", SIGMOD 2008).  It
+ * considers the same join rels as the standard search, so it finds the same
+ * cheapest plan, but without trying the pairs that go nowhere.
+ *
+ * greedy_join_search() is a deterministic heuristic for problems too large
+ * for any exhaustive search: it repeatedly performs the cheapest join it can
+ * find among the current partial results, until only one is left.  It can
+ * be used instead of GEQO, which is randomized.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/optimizer/path/joinsearch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "optimizer/joininfo.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+#include "utils/hsearch.h"
+
+
+/* These parameters are set by GUC */
+int			hypergraph_join_threshold = 9;
+int			join_search_heuristic = JOIN_SEARCH_GENETIC;
+
+/*
+ * A set of hypergraph nodes, ie, of jointree items of the planning problem,
+ * identified by their position in the initial_rels list.
+ */
+typedef uint64 NodeSet;
+
+#define NODESET_BIT(i)			(((NodeSet) 1) << (i))
+/* the set of nodes numbered 0 to i, inclusive */
+#define NODESET_UPTO(i)			(NODESET_BIT(i) | (NODESET_BIT(i) - 1))
+#define NODESET_IS_SUBSET(a, b)	(((a) & ~(b)) == 0)
+
+/*
+ * A hyperedge says that the nodes in "left" can be joined to the nodes in
+ * "right" once each side has been joined up.  Edges between single nodes
+ * are kept in the per-node neighbor sets instead.
+ */
+typedef struct JoinHyperedge
+{
+	NodeSet		left;
+	NodeSet		right;
+} JoinHyperedge;
+
+typedef struct JoinHypergraph
+{
+	PlannerInfo *root;
+	int			nnodes;			/* number of jointree items */
+	RelOptInfo **nodes;			/* the initial_rels, as an array */
+	NodeSet    *neighbors;		/* simple-edge neighbors of each node */
+	JoinHyperedge *hyperedges;	/* complex edges */
+	int			nhyperedges;
+	HTAB	   *memo;			/* NodeSet -> RelOptInfo built so far */
+	List	   *joinrels;		/* join rels built, in order of creation */
+} JoinHypergraph;
+
+typedef struct JoinMemoEntry
+{
+	NodeSet		nodes;			/* hash key --- MUST BE FIRST */
+	RelOptInfo *rel;
+} JoinMemoEntry;
+
+static void build_join_hypergraph(JoinHypergraph *graph, List *initial_rels);
+static void add_hyperedge(JoinHypergraph *graph, NodeSet left, NodeSet right);
+static NodeSet relids_to_nodeset(JoinHypergraph *graph, Relids relids);
+static NodeSet hypergraph_neighborhood(JoinHypergraph *graph,
+						NodeSet s, NodeSet excluded);
+static bool hypergraph_connected(JoinHypergraph *graph,
+					 NodeSet s1, NodeSet s2);
+static RelOptInfo *memo_lookup(JoinHypergraph *graph, NodeSet s);
+static void emit_csg(JoinHypergraph *graph, NodeSet s1);
+static void enumerate_csg_rec(JoinHypergraph *graph, NodeSet s1, NodeSet x);
+static void enumerate_cmp_rec(JoinHypergraph *graph, NodeSet s1, NodeSet s2,
+				  NodeSet x);
+static void emit_csg_cmp(JoinHypergraph *graph, NodeSet s1, NodeSet s2);
+static bool greedy_join_is_desirable(PlannerInfo *root,
+						 RelOptInfo *outer_rel, RelOptInfo *inner_rel);
+
+
+/* Return the lowest-numbered member of a nonempty NodeSet */
+static inline int
+nodeset_first(NodeSet s)
+{
+	int			i = 0;
+
+	Assert(s != 0);
+	while ((s & 1) == 0)
+	{
+		s >>= 1;
+		i++;
+	}
+	return i;
+}
+
+/*
+ * Iterate over the nonempty subsets of "set" in increasing numerical order:
+ * every subset of a given subset comes before it.
+ */
+#define foreach_nonempty_subset(sub, set) \
+	for ((sub) = (-(set)) & (set); (sub) != 0; (sub) = ((sub) - (set)) & (set))
+
+
+/*
+ * hypergraph_join_search
+ *	  Find the cheapest way to join the initial_rels with an exact
+ *	  dynamic-programming search over the join hypergraph.
+ *
+ * The arguments and result are as for standard_join_search().  The planning
+ * problem can have at most HYPERGRAPH_MAX_NODES items.
+ *
+ * The search is driven by the edges of the hypergraph, so it relies on the
+ * hypergraph describing every join that join_is_legal() would allow.  We
+ * build it conservatively (see build_join_hypergraph), but should some join
+ * order restriction still leave us unable to build the final join rel, we
+ * throw away what we built and fall back to standard_join_search().
+ */
+RelOptInfo *
+hypergraph_join_search(PlannerInfo *root, int levels_needed,
+					   List *initial_rels)
+{
+	JoinHypergraph graph;
+	HASHCTL		ctl;
+	RelOptInfo *rel;
+	ListCell   *lc;
+	int			savelength;
+	struct HTAB *savehash;
+	int			i;
+
+	Assert(levels_needed == list_length(initial_rels));
+	Assert(levels_needed <= HYPERGRAPH_MAX_NODES);
+	Assert(root->join_rel_level == NULL);
+
+	/*
+	 * As in geqo_eval(), arrange to be able to forget the join rels we build,
+	 * should we need to fall back to the standard search: new join rels are
+	 * appended to join_rel_list, and we hide any existing join_rel_hash so
+	 * that it doesn't acquire entries for them.  If we succeed, we keep
+	 * whatever hash table got built meanwhile, or none; find_join_rel()
+	 * builds a fresh one covering the whole list when it needs to.
+	 */
+	savelength = list_length(root->join_rel_list);
+	savehash = root->join_rel_hash;
+	root->join_rel_hash = NULL;
+
+	graph.root = root;
+	graph.joinrels = NIL;
+	build_join_hypergraph(&graph, initial_rels);
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(NodeSet);
+	ctl.entrysize = sizeof(JoinMemoEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	graph.memo = hash_create("hypergraph join search", 256, &ctl,
+							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (i = 0; i < graph.nnodes; i++)
+	{
+		NodeSet		s = NODESET_BIT(i);
+		JoinMemoEntry *entry;
+
+		entry = (JoinMemoEntry *) hash_search(graph.memo, &s, HASH_ENTER,
+											  NULL);
+		entry->rel = graph.nodes[i];
+	}
+
+	/*
+	 * Enumerate the connected subgraphs, starting from each node in turn in
+	 * descending order, and considering only larger-numbered nodes from
+	 * there.  This guarantees that all the ways of building a set of nodes
+	 * are tried before that set is used as a join input.
+	 */
+	for (i = graph.nnodes - 1; i >= 0; i--)
+	{
+		emit_csg(&graph, NODESET_BIT(i));
+		enumerate_csg_rec(&graph, NODESET_BIT(i), NODESET_UPTO(i));
+	}
+
+	rel = memo_lookup(&graph, NODESET_UPTO(graph.nnodes - 1));
+	hash_destroy(graph.memo);
+
+	if (rel == NULL)
+	{
+		root->join_rel_list = list_truncate(root->join_rel_list, savelength);
+		root->join_rel_hash = savehash;
+		return standard_join_search(root, levels_needed, initial_rels);
+	}
+
+	/*
+	 * Join rels that were used as inputs got set_cheapest() done on them
+	 * already; take care of the rest, including the final one.
+	 */
+	foreach(lc, graph.joinrels)
+	{
+		RelOptInfo *joinrel = (RelOptInfo *) lfirst(lc);
+
+		if (joinrel->cheapest_total_path == NULL)
+			set_cheapest(joinrel);
+
+#ifdef OPTIMIZER_DEBUG
+		debug_print_rel(root, joinrel);
+#endif
+	}
+
+	return rel;
+}
+
+/*
+ * build_join_hypergraph
+ *	  Set up the nodes and edges of the join hypergraph.
+ *
+ * Two nodes are neighbors if the standard search would consider joining
+ * them directly, ie, if they have a join clause or a join order restriction
+ * in common; the latter covers the rels that make up either side of an outer
+ * join or semijoin, and lateral references.  An outer join or semijoin whose
+ * minimal inputs span several nodes also gets a hyperedge between them.
+ *
+ * The standard search resorts to Cartesian products for rels linked to
+ * nothing else, and would do so as a last resort between groups of rels
+ * that have no clauses between them.  We model both by adding edges: a node
+ * with no edges at all becomes a neighbor of every other node, and nodes in
+ * different connected components become neighbors of each other.
+ */
+static void
+build_join_hypergraph(JoinHypergraph *graph, List *initial_rels)
+{
+	PlannerInfo *root = graph->root;
+	int			nnodes = list_length(initial_rels);
+	NodeSet		allnodes = NODESET_UPTO(nnodes - 1);
+	int		   *component;
+	bool		changed;
+	ListCell   *lc;
+	int			i,
+				j;
+
+	graph->nnodes = nnodes;
+	graph->nodes = (RelOptInfo **) palloc(nnodes * sizeof(RelOptInfo *));
+	graph->neighbors = (NodeSet *) palloc0(nnodes * sizeof(NodeSet));
+	graph->hyperedges = NULL;
+	graph->nhyperedges = 0;
+
+	i = 0;
+	foreach(lc, initial_rels)
+		graph->nodes[i++] = (RelOptInfo *) lfirst(lc);
+
+	for (i = 0; i < nnodes; i++)
+	{
+		for (j = i + 1; j < nnodes; j++)
+		{
+			RelOptInfo *rel1 = graph->nodes[i];
+			RelOptInfo *rel2 = graph->nodes[j];
+
+			if (have_relevant_joinclause(root, rel1, rel2) ||
+				have_join_order_restriction(root, rel1, rel2))
+			{
+				graph->neighbors[i] |= NODESET_BIT(j);
+				graph->neighbors[j] |= NODESET_BIT(i);
+			}
+		}
+	}
+
+	foreach(lc, root->join_info_list)
+	{
+		SpecialJoinInfo *sjinfo = (SpecialJoinInfo *) lfirst(lc);
+		NodeSet		left = relids_to_nodeset(graph, sjinfo->min_lefthand);
+		NodeSet		right = relids_to_nodeset(graph, sjinfo->min_righthand);
+
+		/* ignore joins within a single item, or outside this problem */
+		if (left == 0 || right == 0 || (left & right) != 0)
+			continue;
+		add_hyperedge(graph, left, right);
+	}
+
+	/* Give nodes that are linked to nothing an edge to everything */
+	for (i = 0; i < nnodes; i++)
+	{
+		bool		linked = (graph->neighbors[i] != 0);
+
+		for (j = 0; j < graph->nhyperedges && !linked; j++)
+		{
+			JoinHyperedge *edge = &graph->hyperedges[j];
+
+			if ((edge->left | edge->right) & NODESET_BIT(i))
+				linked = true;
+		}
+		if (linked)
+			continue;
+
+		graph->neighbors[i] = allnodes & ~NODESET_BIT(i);
+		for (j = 0; j < nnodes; j++)
+		{
+			if (j != i)
+				graph->neighbors[j] |= NODESET_BIT(i);
+		}
+	}
+
+	/*
+	 * Label the connected components by propagating the smallest node
+	 * number; this is quadratic at worst, which is nothing next to the
+	 * search itself.
+	 */
+	component = (int *) palloc(nnodes * sizeof(int));
+	for (i = 0; i < nnodes; i++)
+		component[i] = i;
+	do
+	{
+		changed = false;
+		for (i = 0; i < nnodes; i++)
+		{
+			for (j = 0; j < nnodes; j++)
+			{
+				if ((graph->neighbors[i] & NODESET_BIT(j)) &&
+					component[j] < component[i])
+				{
+					component[i] = component[j];
+					changed = true;
+				}
+			}
+		}
+		for (j = 0; j < graph->nhyperedges; j++)
+		{
+			JoinHyperedge *edge = &graph->hyperedges[j];
+			NodeSet		members = edge->left | edge->right;
+			int			lowest = nnodes;
+
+			for (i = 0; i < nnodes; i++)
+			{
+				if ((members & NODESET_BIT(i)) && component[i] < lowest)
+					lowest = component[i];
+			}
+			for (i = 0; i < nnodes; i++)
+			{
+				if ((members & NODESET_BIT(i)) && component[i] > lowest)
+				{
+					component[i] = lowest;
+					changed = true;
+				}
+			}
+		}
+	} while (changed);
+
+	for (i = 0; i < nnodes; i++)
+	{
+		for (j = i + 1; j < nnodes; j++)
+		{
+			if (component[i] != component[j])
+			{
+				graph->neighbors[i] |= NODESET_BIT(j);
+				graph->neighbors[j] |= NODESET_BIT(i);
+			}
+		}
+	}
+
+	pfree(component);
+}
+
+/*
+ * add_hyperedge
+ *	  Add an edge between two disjoint sets of nodes to the hypergraph.
+ */
+static void
+add_hyperedge(JoinHypergraph *graph, NodeSet left, NodeSet right)
+{
+	JoinHyperedge *edge;
+	int			i;
+
+	/* an edge between two single nodes is a plain neighbor relationship */
+	if ((left & (left - 1)) == 0 && (right & (right - 1)) == 0)
+	{
+		int			l = nodeset_first(left);
+		int			r = nodeset_first(right);
+
+		graph->neighbors[l] |= right;
+		graph->neighbors[r] |= left;
+		return;
+	}
+
+	for (i = 0; i < graph->nhyperedges; i++)
+	{
+		edge = &graph->hyperedges[i];
+		if ((edge->left == left && edge->right == right) ||
+			(edge->left == right && edge->right == left))
+			return;
+	}
+
+	if (graph->hyperedges == NULL)
+		graph->hyperedges = (JoinHyperedge *)
+			palloc(graph->nnodes * sizeof(JoinHyperedge));
+	else if (graph->nhyperedges % graph->nnodes == 0)
+		graph->hyperedges = (JoinHyperedge *)
+			repalloc(graph->hyperedges,
+					 (graph->nhyperedges + graph->nnodes) * sizeof(JoinHyperedge));
+
+	edge = &graph->hyperedges[graph->nhyperedges++];
+	edge->left = left;
+	edge->right = right;
+}
+
+/*
+ * relids_to_nodeset
+ *	  Return the set of nodes whose relids overlap the given relids.
+ */
+static NodeSet
+relids_to_nodeset(JoinHypergraph *graph, Relids relids)
+{
+	NodeSet		result = 0;
+	int			i;
+
+	for (i = 0; i < graph->nnodes; i++)
+	{
+		if (bms_overlap(graph->nodes[i]->relids, relids))
+			result |= NODESET_BIT(i);
+	}
+	return result;
+}
+
+/*
+ * hypergraph_neighborhood
+ *	  Return the nodes outside s and excluded that an edge leads to from s.
+ *
+ * For a hyperedge leading from within s to a set of several nodes, only the
+ * lowest-numbered of them is included; the enumeration reaches the others
+ * by growing the complement from there.
+ */
+static NodeSet
+hypergraph_neighborhood(JoinHypergraph *graph, NodeSet s, NodeSet excluded)
+{
+	NodeSet		result = 0;
+	NodeSet		members = s;
+	int			i;
+
+	excluded |= s;
+
+	while (members != 0)
+	{
+		result |= graph->neighbors[nodeset_first(members)];
+		members &= members - 1;
+	}
+	result &= ~excluded;
+
+	for (i = 0; i < graph->nhyperedges; i++)
+	{
+		JoinHyperedge *edge = &graph->hyperedges[i];
+
+		if (NODESET_IS_SUBSET(edge->left, s) && (edge->right & excluded) == 0)
+			result |= NODESET_BIT(nodeset_first(edge->right));
+		else if (NODESET_IS_SUBSET(edge->right, s) &&
+				 (edge->left & excluded) == 0)
+			result |= NODESET_BIT(nodeset_first(edge->left));
+	}
+
+	return result;
+}
+
+/*
+ * hypergraph_connected
+ *	  Is there an edge between the disjoint node sets s1 and s2?
+ */
+static bool
+hypergraph_connected(JoinHypergraph *graph, NodeSet s1, NodeSet s2)
+{
+	NodeSet		members = s1;
+	int			i;
+
+	while (members != 0)
+	{
+		if (graph->neighbors[nodeset_first(members)] & s2)
+			return true;
+		members &= members - 1;
+	}
+
+	for (i = 0; i < graph->nhyperedges; i++)
+	{
+		JoinHyperedge *edge = &graph->hyperedges[i];
+
+		if ((NODESET_IS_SUBSET(edge->left, s1) &&
+			 NODESET_IS_SUBSET(edge->right, s2)) ||
+			(NODESET_IS_SUBSET(edge->left, s2) &&
+			 NODESET_IS_SUBSET(edge->right, s1)))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * memo_lookup
+ *	  Return the rel built for the given set of nodes, or NULL if none.
+ */
+static RelOptInfo *
+memo_lookup(JoinHypergraph *graph, NodeSet s)
+{
+	JoinMemoEntry *entry;
+
+	entry = (JoinMemoEntry *) hash_search(graph->memo, &s, HASH_FIND, NULL);
+	return entry ? entry->rel : NULL;
+}
+
+/*
+ * emit_csg
+ *	  Consider joining the connected subgraph s1 to each connected subgraph
+ *	  of higher-numbered nodes it has an edge to.
+ */
+static void
+emit_csg(JoinHypergraph *graph, NodeSet s1)
+{
+	NodeSet		x = s1 | NODESET_UPTO(nodeset_first(s1));
+	NodeSet		neighborhood = hypergraph_neighborhood(graph, s1, x);
+	int			v;
+
+	for (v = graph->nnodes - 1; v >= 0; v--)
+	{
+		NodeSet		s2 = NODESET_BIT(v);
+
+		if ((neighborhood & s2) == 0)
+			continue;
+		if (hypergraph_connected(graph, s1, s2))
+			emit_csg_cmp(graph, s1, s2);
+		enumerate_cmp_rec(graph, s1, s2,
+						  x | (NODESET_UPTO(v) & neighborhood));
+	}
+}
+
+/*
+ * enumerate_csg_rec
+ *	  Extend the connected subgraph s1 through its neighbors outside x, and
+ *	  consider each extension that we managed to build a join rel for.
+ */
+static void
+enumerate_csg_rec(JoinHypergraph *graph, NodeSet s1, NodeSet x)
+{
+	NodeSet		neighborhood = hypergraph_neighborhood(graph, s1, x);
+	NodeSet		sub;
+
+	if (neighborhood == 0)
+		return;
+
+	foreach_nonempty_subset(sub, neighborhood)
+	{
+		if (memo_lookup(graph, s1 | sub) != NULL)
+			emit_csg(graph, s1 | sub);
+	}
+	foreach_nonempty_subset(sub, neighborhood)
+		enumerate_csg_rec(graph, s1 | sub, x | neighborhood);
+}
+
+/*
+ * enumerate_cmp_rec
+ *	  Extend the complement s2 of s1 through its neighbors outside x, and
+ *	  consider joining s1 to each extension that is connected to it.
+ */
+static void
+enumerate_cmp_rec(JoinHypergraph *graph, NodeSet s1, NodeSet s2, NodeSet x)
+{
+	NodeSet		neighborhood = hypergraph_neighborhood(graph, s2, x);
+	NodeSet		sub;
+
+	if (neighborhood == 0)
+		return;
+
+	foreach_nonempty_subset(sub, neighborhood)
+	{
+		if (memo_lookup(graph, s2 | sub) != NULL &&
+			hypergraph_connected(graph, s1, s2 | sub))
+			emit_csg_cmp(graph, s1, s2 | sub);
+	}
+	foreach_nonempty_subset(sub, neighborhood)
+		enumerate_cmp_rec(graph, s1, s2 | sub, x | neighborhood);
+}
+
+/*
+ * emit_csg_cmp
+ *	  Build paths for joining the rels for node sets s1 and s2.
+ *
+ * By the time a pair is emitted, all ways of building either input have
+ * been considered already, so we can fix the inputs' cheapest paths now.
+ */
+static void
+emit_csg_cmp(JoinHypergraph *graph, NodeSet s1, NodeSet s2)
+{
+	RelOptInfo *rel1 = memo_lookup(graph, s1);
+	RelOptInfo *rel2 = memo_lookup(graph, s2);
+	RelOptInfo *joinrel;
+	NodeSet		s = s1 | s2;
+	JoinMemoEntry *entry;
+	bool		found;
+
+	CHECK_FOR_INTERRUPTS();
+
+	Assert(rel1 != NULL && rel2 != NULL);
+	if (rel1->cheapest_total_path == NULL)
+		set_cheapest(rel1);
+	if (rel2->cheapest_total_path == NULL)
+		set_cheapest(rel2);
+
+	joinrel = make_join_rel(graph->root, rel1, rel2);
+	if (joinrel == NULL)
+		return;
+
+	entry = (JoinMemoEntry *) hash_search(graph->memo, &s, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->rel = joinrel;
+		graph->joinrels = lappend(graph->joinrels, joinrel);
+	}
+	Assert(entry->rel == joinrel);
+}
+
+
+/*
+ * greedy_join_search
+ *	  Find a good way to join the initial_rels by repeatedly making the
+ *	  cheapest available join.
+ *
+ * The arguments and result are as for standard_join_search().
+ *
+ * We keep a list of "clumps", the rels joined up so far, starting with the
+ * initial_rels.  Each step joins the pair of clumps whose join has the
+ * cheapest cheapest-total path, and replaces them with their join rel.
+ * Like GEQO's merge_clump(), we prefer joins that have a join clause or
+ * order restriction, and consider other joins only if no such join is legal.
+ *
+ * Only joins involving the clumps merged at the previous step need to be
+ * built anew at each step, so that we build O(N^2) join rels in all for N
+ * clumps.  Ties are broken by position in initial_rels, so that the result
+ * doesn't depend on anything but the query and the statistics.
+ */
+RelOptInfo *
+greedy_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	RelOptInfo **clumps;
+	RelOptInfo **candidates;
+	bool	   *tried;
+	int			nclumps = levels_needed;
+	ListCell   *lc;
+	int			i;
+
+	Assert(levels_needed == list_length(initial_rels));
+	Assert(root->join_rel_level == NULL);
+
+	/* candidates[i * levels_needed + j], i < j, is the join of clumps i, j */
+	clumps = (RelOptInfo **) palloc(levels_needed * sizeof(RelOptInfo *));
+	candidates = (RelOptInfo **)
+		palloc0(levels_needed * levels_needed * sizeof(RelOptInfo *));
+	tried = (bool *) palloc0(levels_needed * levels_needed * sizeof(bool));
+
+	i = 0;
+	foreach(lc, initial_rels)
+		clumps[i++] = (RelOptInfo *) lfirst(lc);
+
+	while (nclumps > 1)
+	{
+		RelOptInfo *best = NULL;
+		int			best_i = -1;
+		int			best_j = -1;
+		bool		force;
+		int			j;
+
+		for (force = false; best == NULL; force = true)
+		{
+			for (i = 0; i < levels_needed; i++)
+			{
+				if (clumps[i] == NULL)
+					continue;
+				for (j = i + 1; j < levels_needed; j++)
+				{
+					int			k = i * levels_needed + j;
+					RelOptInfo *joinrel;
+
+					if (clumps[j] == NULL)
+						continue;
+					if (!tried[k])
+					{
+						if (!force &&
+							!greedy_join_is_desirable(root, clumps[i],
+													  clumps[j]))
+							continue;
+						joinrel = make_join_rel(root, clumps[i], clumps[j]);
+						if (joinrel)
+							set_cheapest(joinrel);
+						candidates[k] = joinrel;
+						tried[k] = true;
+					}
+
+					joinrel = candidates[k];
+					if (joinrel == NULL)
+						continue;
+					if (best == NULL ||
+						joinrel->cheapest_total_path->total_cost <
+						best->cheapest_total_path->total_cost ||
+						(joinrel->cheapest_total_path->total_cost ==
+						 best->cheapest_total_path->total_cost &&
+						 joinrel->rows < best->rows))
+					{
+						best = joinrel;
+						best_i = i;
+						best_j = j;
+					}
+				}
+			}
+
+			if (best == NULL && force)
+				elog(ERROR, "failed to build any %d-way joins",
+					 levels_needed);
+		}
+
+		/* Replace clump best_i by the join, and forget clump best_j */
+		clumps[best_i] = best;
+		clumps[best_j] = NULL;
+		nclumps--;
+
+		for (j = 0; j < levels_needed; j++)
+		{
+			int			lo = Min(j, best_i);
+			int			hi = Max(j, best_i);
+
+			tried[lo * levels_needed + hi] = false;
+			candidates[lo * levels_needed + hi] = NULL;
+		}
+
+#ifdef OPTIMIZER_DEBUG
+		debug_print_rel(root, best);
+#endif
+	}
+
+	for (i = 0; i < levels_needed; i++)
+	{
+		if (clumps[i] != NULL)
+			return clumps[i];
+	}
+
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * greedy_join_is_desirable
+ *	  Does a join of the two rels use a join clause or a join order
+ *	  restriction?  This is the same test GEQO's desirable_join() applies.
+ */
+static bool
+greedy_join_is_desirable(PlannerInfo *root,
+						 RelOptInfo *outer_rel, RelOptInfo *inner_rel)
+{
+	if (have_relevant_joinclause(root, outer_rel, inner_rel))
+		return true;
+	if (have_join_order_restriction(root, outer_rel, inner_rel))
+		return true;
+	return false;
+}
@@ -55,6 +55,7 @@ static Plan *create_append_plan(PlannerInfo *root, AppendPath *best_path);
 static Plan *create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path);
 static Result *create_result_plan(PlannerInfo *root, ResultPath *best_path);
 static Material *create_material_plan(PlannerInfo *root, MaterialPath *best_path);
+static Memoize *create_memoize_plan(PlannerInfo *root, MemoizePath *best_path);
 static Plan *create_unique_plan(PlannerInfo *root, UniquePath *best_path);
 static SeqScan *create_seqscan_plan(PlannerInfo *root, Path *best_path,
 					List *tlist, List *scan_clauses);
@@ -92,6 +93,10 @@ static HashJoin *create_hashjoin_plan(PlannerInfo *root, HashPath *best_path,
 					 Plan *outer_plan, Plan *inner_plan);
 static Node *replace_nestloop_params(PlannerInfo *root, Node *expr);
 static Node *replace_nestloop_params_mutator(Node *node, PlannerInfo *root);
+static void build_runtime_pruning_info(PlannerInfo *root, List *subpaths,
+						   List **prune_constraints, List **prune_clauses);
+static bool contain_param_walker(Node *node, void *context);
+static bool agg_split_walker(Node *node, Agg *agg);
 static void process_subquery_nestloop_params(PlannerInfo *root,
 								 List *subplan_params);
 static List *fix_indexqual_references(PlannerInfo *root, IndexPath *index_path);
@@ -176,6 +181,8 @@ static EquivalenceMember *find_ec_member_for_tle(EquivalenceClass *ec,
 					   TargetEntry *tle,
 					   Relids relids);
 static Material *make_material(Plan *lefttree);
+static Memoize *make_memoize(Plan *lefttree, Oid *eqOperators,
+			 List *param_exprs, uint32 est_entries);
 
 
 /*
@@ -269,6 +276,10 @@ create_plan_recurse(PlannerInfo *root, Path *best_path)
 			plan = (Plan *) create_material_plan(root,
 												 (MaterialPath *) best_path);
 			break;
+		case T_Memoize:
+			plan = (Plan *) create_memoize_plan(root,
+												(MemoizePath *) best_path);
+			break;
 		case T_Unique:
 			plan = create_unique_plan(root,
 									  (UniquePath *) best_path);
@@ -745,6 +756,10 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path)
 
 	plan = make_append(subplans, tlist);
 
+	build_runtime_pruning_info(root, best_path->subpaths,
+							   &plan->prune_constraints,
+							   &plan->prune_clauses);
+
 	return (Plan *) plan;
 }
 
@@ -846,9 +861,114 @@ create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path)
 
 	node->mergeplans = subplans;
 
+	build_runtime_pruning_info(root, best_path->subpaths,
+							   &node->prune_constraints,
+							   &node->prune_clauses);
+
 	return (Plan *) node;
 }
 
+/*
+ * build_runtime_pruning_info
+ *	  Collect what the executor needs to skip Append or MergeAppend children
+ *	  whose constraints are refuted by parameter values.
+ *
+ * Constraint exclusion in the planner can't use quals that compare a child's
+ * columns to Params, since their values aren't known until execution: think
+ * of a prepared statement using a generic plan, or the inner side of a
+ * parameterized nestloop.  For every child whose quals (including the join
+ * clauses it is parameterized by) mention Params, we save its CHECK
+ * constraints and those quals; the executor substitutes the current Param
+ * values and tries to refute the constraints again.
+ *
+ * The results are lists of lists parallel to 'subpaths', with NIL entries
+ * for children for which there is nothing to do.  If there is nothing to do
+ * for any child, both results are NIL.
+ */
+static void
+build_runtime_pruning_info(PlannerInfo *root, List *subpaths,
+						   List **prune_constraints, List **prune_clauses)
+{
+	List	   *constraints = NIL;
+	List	   *clauses = NIL;
+	bool		any_pruning = false;
+	ListCell   *lc;
+
+	*prune_constraints = NIL;
+	*prune_clauses = NIL;
+
+	foreach(lc, subpaths)
+	{
+		Path	   *subpath = (Path *) lfirst(lc);
+		RelOptInfo *childrel = subpath->parent;
+		List	   *childconstraints = NIL;
+		List	   *childclauses = NIL;
+		List	   *candidates;
+		bool		has_params = false;
+		ListCell   *lc2;
+
+		if (childrel->reloptkind == RELOPT_OTHER_MEMBER_REL &&
+			childrel->rtekind == RTE_RELATION)
+		{
+			candidates = extract_actual_clauses(childrel->baserestrictinfo,
+												false);
+			if (subpath->param_info)
+				candidates = list_concat(candidates,
+										 extract_actual_clauses(subpath->param_info->ppi_clauses,
+																false));
+			/* Outer Vars of the join clauses become Params here */
+			candidates = (List *)
+				replace_nestloop_params(root, (Node *) candidates);
+
+			foreach(lc2, candidates)
+			{
+				Node	   *clause = (Node *) lfirst(lc2);
+
+				if (contain_volatile_functions(clause) ||
+					contain_subplans(clause))
+					continue;
+				if (contain_param_walker(clause, NULL))
+					has_params = true;
+				childclauses = lappend(childclauses, clause);
+			}
+
+			/* Without Params the planner has already done what it can */
+			if (has_params)
+				childconstraints =
+					get_relation_pruning_constraints(root, childrel,
+													 planner_rt_fetch(childrel->relid,
+																	  root));
+			if (childconstraints != NIL)
+				any_pruning = true;
+			else
+				childclauses = NIL;
+		}
+
+		constraints = lappend(constraints, childconstraints);
+		clauses = lappend(clauses, childclauses);
+	}
+
+	if (any_pruning)
+	{
+		*prune_constraints = constraints;
+		*prune_clauses = clauses;
+	}
+}
+
+/*
+ * contain_param_walker
+ *	  Does the expression contain any Param nodes?
+ */
+static bool
+contain_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+		return true;
+	return expression_tree_walker(node, contain_param_walker, context);
+}
+
 /*
  * create_result_plan
  *	  Create a Result plan for 'best_path'.
@@ -898,6 +1018,49 @@ create_material_plan(PlannerInfo *root, MaterialPath *best_path)
 	return plan;
 }
 
+/*
+ * create_memoize_plan
+ *	  Create a Memoize plan for 'best_path' and (recursively) plans
+ *	  for its subpaths.
+ *
+ *	  Returns a Plan node.
+ */
+static Memoize *
+create_memoize_plan(PlannerInfo *root, MemoizePath *best_path)
+{
+	Memoize    *plan;
+	Plan	   *subplan;
+	List	   *param_exprs;
+	Oid		   *eqOperators;
+	ListCell   *lc;
+	int			i;
+
+	subplan = create_plan_recurse(root, best_path->subpath);
+
+	/* We don't want any excess columns in the cached tuples */
+	disuse_physical_tlist(root, subplan, best_path->subpath);
+
+	/*
+	 * The cache keys are computed from the outer relation's values, so they
+	 * must be turned into references to the nestloop's params, just like the
+	 * subplan's uses of the same values.
+	 */
+	param_exprs = (List *) replace_nestloop_params(root,
+											  (Node *) best_path->param_exprs);
+
+	eqOperators = (Oid *) palloc(list_length(param_exprs) * sizeof(Oid));
+	i = 0;
+	foreach(lc, best_path->eq_operators)
+		eqOperators[i++] = lfirst_oid(lc);
+
+	plan = make_memoize(subplan, eqOperators, param_exprs,
+						best_path->est_entries);
+
+	copy_path_costsize(&plan->plan, (Path *) best_path);
+
+	return plan;
+}
+
 /*
  * create_unique_plan
  *	  Create a Unique plan for 'best_path' and (recursively) plans
@@ -4368,6 +4531,68 @@ make_sort_from_pathkeys(PlannerInfo *root, Plan *lefttree, List *pathkeys,
 					 nullsFirst, limit_tuples);
 }
 
+/*
+ * make_incrementalsort_from_pathkeys
+ *	  Create an incremental sort plan to sort according to given pathkeys,
+ *	  when the input is already sorted on the first 'presortedCols' of them
+ *
+ *	  'lefttree' is the node which yields input tuples
+ *	  'pathkeys' is the list of pathkeys by which the result is to be sorted
+ *	  'presortedCols' is the number of leading pathkeys lefttree satisfies
+ *	  'limit_tuples' is the bound on the number of output tuples;
+ *				-1 if no bound
+ */
+IncrementalSort *
+make_incrementalsort_from_pathkeys(PlannerInfo *root, Plan *lefttree,
+								   List *pathkeys, int presortedCols,
+								   double limit_tuples)
+{
+	IncrementalSort *node = makeNode(IncrementalSort);
+	Plan	   *plan = &node->sort.plan;
+	Path		sort_path;		/* dummy for result of cost_incremental_sort */
+	int			numsortkeys;
+	AttrNumber *sortColIdx;
+	Oid		   *sortOperators;
+	Oid		   *collations;
+	bool	   *nullsFirst;
+
+	/* Compute sort column info, and adjust lefttree as needed */
+	lefttree = prepare_sort_from_pathkeys(root, lefttree, pathkeys,
+										  NULL,
+										  NULL,
+										  false,
+										  &numsortkeys,
+										  &sortColIdx,
+										  &sortOperators,
+										  &collations,
+										  &nullsFirst);
+	Assert(presortedCols > 0 && presortedCols < numsortkeys);
+
+	copy_plan_costsize(plan, lefttree); /* only care about copying size */
+	cost_incremental_sort(&sort_path, root, pathkeys, presortedCols,
+						  lefttree->startup_cost,
+						  lefttree->total_cost,
+						  lefttree->plan_rows,
+						  lefttree->plan_width,
+						  0.0,
+						  work_mem,
+						  limit_tuples);
+	plan->startup_cost = sort_path.startup_cost;
+	plan->total_cost = sort_path.total_cost;
+	plan->targetlist = lefttree->targetlist;
+	plan->qual = NIL;
+	plan->lefttree = lefttree;
+	plan->righttree = NULL;
+	node->sort.numCols = numsortkeys;
+	node->sort.sortColIdx = sortColIdx;
+	node->sort.sortOperators = sortOperators;
+	node->sort.collations = collations;
+	node->sort.nullsFirst = nullsFirst;
+	node->presortedCols = presortedCols;
+
+	return node;
+}
+
 /*
  * make_sort_from_sortclauses
  *	  Create sort plan to sort according to given sortclauses
@@ -4481,6 +4706,27 @@ make_material(Plan *lefttree)
 	return node;
 }
 
+static Memoize *
+make_memoize(Plan *lefttree, Oid *eqOperators, List *param_exprs,
+			 uint32 est_entries)
+{
+	Memoize    *node = makeNode(Memoize);
+	Plan	   *plan = &node->plan;
+
+	/* cost should be inserted by caller */
+	plan->targetlist = lefttree->targetlist;
+	plan->qual = NIL;
+	plan->lefttree = lefttree;
+	plan->righttree = NULL;
+
+	node->numKeys = list_length(param_exprs);
+	node->eqOperators = eqOperators;
+	node->param_exprs = param_exprs;
+	node->est_entries = est_entries;
+
+	return node;
+}
+
 /*
  * materialize_finished_plan: stick a Material node atop a completed plan
  *
@@ -4517,6 +4763,33 @@ materialize_finished_plan(Plan *subplan)
 	return matplan;
 }
 
+/*
+ * agg_split_walker
+ *		Set the combineStates/finalizeAggs flags of an Agg node from the
+ *		aggregates it computes.
+ *
+ * An aggregate split by eager aggregation is marked partial in the lower Agg
+ * and combining in the upper one; see planeager.c.  All aggregates of one
+ * query level are split the same way.
+ */
+static bool
+agg_split_walker(Node *node, Agg *agg)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Aggref))
+	{
+		Aggref	   *aggref = (Aggref *) node;
+
+		if (aggref->aggcombine)
+			agg->combineStates = true;
+		if (aggref->aggpartial)
+			agg->finalizeAggs = false;
+		return false;			/* don't recurse into aggregate arguments */
+	}
+	return expression_tree_walker(node, agg_split_walker, (void *) agg);
+}
+
 Agg *
 make_agg(PlannerInfo *root, List *tlist, List *qual,
 		 AggStrategy aggstrategy, const AggClauseCosts *aggcosts,
@@ -4531,6 +4804,12 @@ make_agg(PlannerInfo *root, List *tlist, List *qual,
 	QualCost	qual_cost;
 
 	node->aggstrategy = aggstrategy;
+
+	/* split aggregates decide how the node passes transition states */
+	node->combineStates = false;
+	node->finalizeAggs = true;
+	(void) agg_split_walker((Node *) tlist, node);
+	(void) agg_split_walker((Node *) qual, node);
 	node->numCols = numGroupCols;
 	node->grpColIdx = grpColIdx;
 	node->grpOperators = grpOperators;
@@ -5026,6 +5305,21 @@ make_modifytable(PlannerInfo *root,
 
 	node->operation = operation;
 	node->canSetTag = canSetTag;
+
+	/*
+	 * An INSERT can buffer rows and write them with heap_multi_insert, as
+	 * COPY does, unless something might look at the rows of the target
+	 * table that have already been processed.  The executor checks for
+	 * triggers; here we rule out RETURNING and ON CONFLICT, and volatile
+	 * functions anywhere in the query, which might query the table.  As in
+	 * COPY, nextval() is harmless.  It's not worth setting up the buffering
+	 * for a single row.
+	 */
+	node->canMultiInsert = (operation == CMD_INSERT &&
+							plan->plan_rows > 1 &&
+							returningLists == NIL &&
+							onconflict == NULL &&
+					!contain_volatile_functions_not_nextval((Node *) root->parse));
 	node->nominalRelation = nominalRelation;
 	node->resultRelations = resultRelations;
 	node->resultRelIndex = -1;	/* will be set correctly in setrefs.c */
@@ -5123,7 +5417,9 @@ is_projection_capable_plan(Plan *plan)
 	{
 		case T_Hash:
 		case T_Material:
+		case T_Memoize:
 		case T_Sort:
+		case T_IncrementalSort:
 		case T_Unique:
 		case T_SetOp:
 		case T_LockRows:
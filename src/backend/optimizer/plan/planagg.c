@@ -318,6 +318,10 @@ find_minmax_aggs_walker(Node *node, List **context)
 		if (list_length(aggref->args) != 1)
 			return true;		/* it couldn't be MIN/MAX */
 
+		/* the steps of a split aggregate must stay in their Agg nodes */
+		if (aggref->aggcombine || aggref->aggpartial)
+			return true;
+
 		/*
 		 * ORDER BY is usually irrelevant for MIN/MAX, but it can change the
 		 * outcome if the aggsortop's operator class recognizes non-identical
@@ -0,0 +1,649 @@
+/*-------------------------------------------------------------------------
+ *
+ * planeager.c
+ *	  Eager aggregation: aggregate one relation before the joins.
+ *
+ * For a query like
+ *		SELECT d.name, sum(f.amount) FROM fact f JOIN dim d ON f.k = d.k
+ *		GROUP BY d.name
+ * whose aggregates all read the same relation, that relation can be grouped
+ * by every column the rest of the query needs from it (here f.k) before the
+ * join, with the aggregates computing partial transition states.  The join
+ * then processes one row per group instead of one per fact row, and the
+ * states are combined by the aggregation above the join.  This is exact for
+ * inner joins: the rows of one group have the same join partners, so each
+ * partner pairs with the group's combined state exactly as it would have
+ * paired with each of its rows.
+ *
+ * The rewritten query replaces the relation by a subquery of the form
+ *		(SELECT keys, partial aggregates FROM rel WHERE rel-only-quals
+ *		 GROUP BY keys)
+ * and is planned alongside the original one; subquery_planner keeps
+ * whichever plan is cheaper.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/optimizer/plan/planeager.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_type.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/planmain.h"
+#include "optimizer/var.h"
+#include "parser/parse_oper.h"
+#include "parser/parsetree.h"
+#include "rewrite/rewriteManip.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+
+typedef struct
+{
+	List	   *aggs;			/* distinct Aggrefs of the query */
+	List	   *transtypes;		/* their transition types (OIDs) */
+	Index		aggrelid;		/* the one relation the aggregates read */
+	bool		failed;			/* found something we can't handle */
+} eager_aggs_context;
+
+typedef struct
+{
+	Index		aggrelid;		/* RT index of the aggregated relation */
+	List	   *keyattnos;		/* its attnos present in the subquery output */
+	List	   *aggs;			/* Aggrefs, in subquery output order */
+	List	   *transtypes;		/* their transition types */
+} eager_replace_context;
+
+static bool eager_jointree_ok(Node *jtnode, Query *query,
+				  Relids *baserels, List **qualptrs);
+static bool eager_key_type_ok(Oid typid);
+static bool find_eager_aggs_walker(Node *node, eager_aggs_context *context);
+static bool has_outer_references_walker(Node *node, void *context);
+static Node *replace_eager_vars_mutator(Node *node,
+						   eager_replace_context *context);
+
+
+/*
+ * make_eager_aggregate_query
+ *		Build the eagerly aggregated form of a query, or return NULL if the
+ *		query doesn't qualify.
+ *
+ * This works on the query as it comes from the rewriter, before any of
+ * subquery_planner's preprocessing, so that the result can be planned
+ * independently.  The given query is not modified.
+ */
+Query *
+make_eager_aggregate_query(Query *parse)
+{
+	Query	   *query;
+	Query	   *subquery;
+	Relids		baserels = NULL;
+	List	   *qualptrs = NIL;
+	List	   *pushedquals = NIL;
+	List	   *keyvars;
+	List	   *keyattnos = NIL;
+	List	   *subtlist = NIL;
+	List	   *groupClause = NIL;
+	List	   *colnames = NIL;
+	eager_aggs_context actx;
+	eager_replace_context rctx;
+	RangeTblEntry *aggrte;
+	RangeTblEntry *subrte;
+	RangeTblRef *rtr;
+	Bitmapset  *keyset = NULL;
+	bool		hasJoinRTEs = false;
+	AttrNumber	resno;
+	int			attno;
+	ListCell   *lc;
+	ListCell   *lc2;
+
+	/* Cheap tests first: we want a plain aggregating SELECT */
+	if (parse->commandType != CMD_SELECT ||
+		parse->utilityStmt != NULL ||
+		!parse->hasAggs ||
+		parse->hasWindowFuncs ||
+		parse->hasSubLinks ||
+		parse->hasRecursive ||
+		parse->hasModifyingCTE ||
+		parse->hasForUpdate ||
+		parse->cteList != NIL ||
+		parse->setOperations != NULL ||
+		parse->groupingSets != NIL ||
+		parse->rowMarks != NIL)
+		return NULL;
+
+	/* Every relation must be inner-joined, and none may be LATERAL */
+	query = (Query *) copyObject(parse);
+	if (!eager_jointree_ok((Node *) query->jointree, query,
+						   &baserels, &qualptrs) ||
+		bms_num_members(baserels) < 2)
+		return NULL;
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+		if (rte->securityQuals != NIL)
+			return NULL;
+		if (rte->rtekind == RTE_JOIN)
+			hasJoinRTEs = true;
+	}
+
+	/* References to outer query levels would need adjusting; punt */
+	if (query_tree_walker(query, has_outer_references_walker, NULL,
+						  QTW_IGNORE_RT_SUBQUERIES))
+		return NULL;
+
+	/*
+	 * Replace join alias variables with the base-relation variables they
+	 * stand for, so that every reference to the aggregated relation is
+	 * visible below.
+	 */
+	if (hasJoinRTEs)
+	{
+		PlannerInfo *root = makeNode(PlannerInfo);
+
+		root->parse = query;
+		root->hasJoinRTEs = true;
+		query->targetList = (List *)
+			flatten_join_alias_vars(root, (Node *) query->targetList);
+		query->havingQual = flatten_join_alias_vars(root, query->havingQual);
+		foreach(lc, qualptrs)
+		{
+			Node	  **qualptr = (Node **) lfirst(lc);
+
+			*qualptr = flatten_join_alias_vars(root, *qualptr);
+		}
+	}
+
+	/* All aggregates must be splittable and read the same single relation */
+	actx.aggs = NIL;
+	actx.transtypes = NIL;
+	actx.aggrelid = 0;
+	actx.failed = false;
+	(void) find_eager_aggs_walker((Node *) query->targetList, &actx);
+	(void) find_eager_aggs_walker(query->havingQual, &actx);
+	if (actx.failed || actx.aggrelid == 0 ||
+		!bms_is_member(actx.aggrelid, baserels))
+		return NULL;
+	aggrte = rt_fetch(actx.aggrelid, query->rtable);
+	if (aggrte->rtekind != RTE_RELATION)
+		return NULL;
+
+	/*
+	 * Quals that read only the aggregated relation move into the subquery;
+	 * the rest stay.
+	 */
+	foreach(lc, qualptrs)
+	{
+		Node	  **qualptr = (Node **) lfirst(lc);
+		List	   *remaining = NIL;
+
+		foreach(lc2, make_ands_implicit((Expr *) *qualptr))
+		{
+			Node	   *qual = (Node *) lfirst(lc2);
+			Relids		varnos = pull_varnos(qual);
+
+			if (bms_get_singleton_member(varnos, &attno) &&
+				attno == (int) actx.aggrelid)
+				pushedquals = lappend(pushedquals, qual);
+			else
+				remaining = lappend(remaining, qual);
+		}
+		*qualptr = remaining ? (Node *) make_ands_explicit(remaining) : NULL;
+	}
+
+	/*
+	 * The grouping keys are all the columns of the aggregated relation that
+	 * are still referenced outside the aggregates.
+	 */
+	keyvars = pull_var_clause((Node *) query->targetList,
+							  PVC_INCLUDE_AGGREGATES,
+							  PVC_INCLUDE_PLACEHOLDERS);
+	keyvars = list_concat(keyvars,
+						  pull_var_clause(query->havingQual,
+										  PVC_INCLUDE_AGGREGATES,
+										  PVC_INCLUDE_PLACEHOLDERS));
+	foreach(lc, qualptrs)
+		keyvars = list_concat(keyvars,
+							  pull_var_clause(*(Node **) lfirst(lc),
+											  PVC_INCLUDE_AGGREGATES,
+											  PVC_INCLUDE_PLACEHOLDERS));
+	foreach(lc, keyvars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (!IsA(var, Var) || var->varno != actx.aggrelid)
+			continue;
+		/* system columns and whole-row references aren't supported */
+		if (var->varattno <= 0)
+			return NULL;
+		keyset = bms_add_member(keyset, var->varattno);
+	}
+
+	/*
+	 * Without any grouping key, the subquery would yield a row even for an
+	 * empty relation, so the joins could produce groups that shouldn't
+	 * exist.
+	 */
+	if (bms_is_empty(keyset))
+		return NULL;
+
+	/* Build the subquery's grouping columns */
+	resno = 0;
+	attno = -1;
+	while ((attno = bms_next_member(keyset, attno)) >= 0)
+	{
+		Var		   *keyvar = NULL;
+		TargetEntry *tle;
+		SortGroupClause *grpcl;
+		Oid			sortop;
+		Oid			eqop;
+		bool		hashable;
+
+		foreach(lc, keyvars)
+		{
+			Var		   *var = (Var *) lfirst(lc);
+
+			if (IsA(var, Var) && var->varno == actx.aggrelid &&
+				var->varattno == attno)
+			{
+				keyvar = var;
+				break;
+			}
+		}
+		Assert(keyvar != NULL);
+
+		if (!eager_key_type_ok(keyvar->vartype))
+			return NULL;
+		get_sort_group_operators(keyvar->vartype,
+								 false, false, false,
+								 &sortop, &eqop, NULL,
+								 &hashable);
+		if (!OidIsValid(eqop) || (!OidIsValid(sortop) && !hashable))
+			return NULL;
+
+		resno++;
+		tle = makeTargetEntry((Expr *) makeVar(1, (AttrNumber) attno,
+											   keyvar->vartype,
+											   keyvar->vartypmod,
+											   keyvar->varcollid, 0),
+							  resno,
+							  pstrdup(strVal(list_nth(aggrte->eref->colnames,
+													  attno - 1))),
+							  false);
+		tle->ressortgroupref = resno;
+		subtlist = lappend(subtlist, tle);
+		colnames = lappend(colnames, makeString(tle->resname));
+		keyattnos = lappend_int(keyattnos, attno);
+
+		grpcl = makeNode(SortGroupClause);
+		grpcl->tleSortGroupRef = resno;
+		grpcl->eqop = eqop;
+		grpcl->sortop = sortop;
+		grpcl->nulls_first = false;
+		grpcl->hashable = hashable;
+		groupClause = lappend(groupClause, grpcl);
+	}
+
+	/* ... followed by the partial aggregates */
+	forboth(lc, actx.aggs, lc2, actx.transtypes)
+	{
+		Aggref	   *aggref = (Aggref *) copyObject(lfirst(lc));
+		Oid			transtype = lfirst_oid(lc2);
+		TargetEntry *tle;
+
+		ChangeVarNodes((Node *) aggref, actx.aggrelid, 1, 0);
+		if (transtype != aggref->aggtype)
+			aggref->aggcollid = InvalidOid;
+		aggref->aggtype = transtype;
+		aggref->aggpartial = true;
+
+		resno++;
+		tle = makeTargetEntry((Expr *) aggref, resno,
+							  get_func_name(aggref->aggfnoid), false);
+		subtlist = lappend(subtlist, tle);
+		colnames = lappend(colnames, makeString(tle->resname));
+	}
+
+	subrte = (RangeTblEntry *) copyObject(aggrte);
+	pushedquals = (List *) copyObject(pushedquals);
+	ChangeVarNodes((Node *) pushedquals, actx.aggrelid, 1, 0);
+	rtr = makeNode(RangeTblRef);
+	rtr->rtindex = 1;
+
+	subquery = makeNode(Query);
+	subquery->commandType = CMD_SELECT;
+	subquery->querySource = QSRC_ORIGINAL;
+	subquery->canSetTag = true;
+	subquery->rtable = list_make1(subrte);
+	subquery->jointree = makeFromExpr(list_make1(rtr),
+									  pushedquals ?
+								 (Node *) make_ands_explicit(pushedquals) :
+									  NULL);
+	subquery->targetList = subtlist;
+	subquery->groupClause = groupClause;
+	subquery->hasAggs = true;
+
+	/*
+	 * Turn the relation's RTE into one for the subquery.  Its permissions are
+	 * checked through the copy inside the subquery.
+	 */
+	aggrte->rtekind = RTE_SUBQUERY;
+	aggrte->subquery = subquery;
+	aggrte->security_barrier = false;
+	aggrte->relid = InvalidOid;
+	aggrte->relkind = 0;
+	aggrte->tablesample = NULL;
+	aggrte->inh = false;
+	aggrte->requiredPerms = 0;
+	aggrte->checkAsUser = InvalidOid;
+	aggrte->selectedCols = NULL;
+	aggrte->insertedCols = NULL;
+	aggrte->updatedCols = NULL;
+	if (aggrte->alias)
+		aggrte->alias = makeAlias(aggrte->alias->aliasname, NIL);
+	aggrte->eref = makeAlias(aggrte->eref->aliasname, colnames);
+
+	/*
+	 * Finally, make the rest of the query read the subquery's columns and
+	 * combine the partial states.
+	 */
+	rctx.aggrelid = actx.aggrelid;
+	rctx.keyattnos = keyattnos;
+	rctx.aggs = actx.aggs;
+	rctx.transtypes = actx.transtypes;
+	query->targetList = (List *)
+		replace_eager_vars_mutator((Node *) query->targetList, &rctx);
+	query->havingQual = replace_eager_vars_mutator(query->havingQual, &rctx);
+	foreach(lc, qualptrs)
+	{
+		Node	  **qualptr = (Node **) lfirst(lc);
+
+		*qualptr = replace_eager_vars_mutator(*qualptr, &rctx);
+	}
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+		if (rte->rtekind == RTE_JOIN)
+			rte->joinaliasvars = (List *)
+				replace_eager_vars_mutator((Node *) rte->joinaliasvars, &rctx);
+	}
+
+	return query;
+}
+
+/*
+ * eager_jointree_ok
+ *		Check that a join tree contains only inner joins of non-LATERAL
+ *		relations, collecting the base relations and the places where quals
+ *		are attached.
+ */
+static bool
+eager_jointree_ok(Node *jtnode, Query *query,
+				  Relids *baserels, List **qualptrs)
+{
+	if (jtnode == NULL)
+		return true;
+	if (IsA(jtnode, RangeTblRef))
+	{
+		int			varno = ((RangeTblRef *) jtnode)->rtindex;
+
+		if (rt_fetch(varno, query->rtable)->lateral)
+			return false;
+		*baserels = bms_add_member(*baserels, varno);
+	}
+	else if (IsA(jtnode, FromExpr))
+	{
+		FromExpr   *f = (FromExpr *) jtnode;
+		ListCell   *lc;
+
+		foreach(lc, f->fromlist)
+		{
+			if (!eager_jointree_ok((Node *) lfirst(lc), query,
+								   baserels, qualptrs))
+				return false;
+		}
+		*qualptrs = lappend(*qualptrs, &f->quals);
+	}
+	else if (IsA(jtnode, JoinExpr))
+	{
+		JoinExpr   *j = (JoinExpr *) jtnode;
+
+		if (j->jointype != JOIN_INNER ||
+			!eager_jointree_ok(j->larg, query, baserels, qualptrs) ||
+			!eager_jointree_ok(j->rarg, query, baserels, qualptrs))
+			return false;
+		*qualptrs = lappend(*qualptrs, &j->quals);
+	}
+	else
+		elog(ERROR, "unrecognized node type: %d", (int) nodeTag(jtnode));
+	return true;
+}
+
+/*
+ * eager_key_type_ok
+ *		Check that equality of a grouping key type implies identity.
+ *
+ * Grouping keeps one value of each group of equal keys, which is only safe
+ * if the rest of the query can't tell equal values apart; numeric 1.0 and
+ * 1.00 are equal, for example, but convert to different text.  Without a
+ * catalog property saying so, we accept a list of builtin types known to be
+ * safe.
+ */
+static bool
+eager_key_type_ok(Oid typid)
+{
+	switch (getBaseType(typid))
+	{
+		case BOOLOID:
+		case CHAROID:
+		case NAMEOID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case OIDOID:
+		case TEXTOID:
+		case VARCHAROID:
+		case BYTEAOID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case UUIDOID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * find_eager_aggs_walker
+ *		Collect the distinct aggregates of a query, checking that each can be
+ *		split into partial and combining steps and that they all read the
+ *		same relation.
+ */
+static bool
+find_eager_aggs_walker(Node *node, eager_aggs_context *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Aggref))
+	{
+		Aggref	   *aggref = (Aggref *) node;
+		HeapTuple	aggTuple;
+		Form_pg_aggregate aggform;
+		Oid			transtype;
+		bool		combinable;
+		Relids		varnos;
+		int			varno;
+		ListCell   *lc;
+
+		if (aggref->aggkind != AGGKIND_NORMAL ||
+			aggref->aggdistinct != NIL ||
+			aggref->aggorder != NIL ||
+			aggref->aggcombine || aggref->aggpartial)
+		{
+			context->failed = true;
+			return true;
+		}
+
+		/* already seen? */
+		foreach(lc, context->aggs)
+		{
+			if (equal(lfirst(lc), aggref))
+				return false;
+		}
+
+		/*
+		 * Transition states of type internal are pointers into the Agg
+		 * node's memory and can't be passed to another node, and polymorphic
+		 * ones would need resolving against the original arguments.
+		 */
+		aggTuple = SearchSysCache1(AGGFNOID,
+								   ObjectIdGetDatum(aggref->aggfnoid));
+		if (!HeapTupleIsValid(aggTuple))
+			elog(ERROR, "cache lookup failed for aggregate %u",
+				 aggref->aggfnoid);
+		aggform = (Form_pg_aggregate) GETSTRUCT(aggTuple);
+		transtype = aggform->aggtranstype;
+		combinable = OidIsValid(aggform->aggcombinefn);
+		ReleaseSysCache(aggTuple);
+
+		if (!combinable || transtype == INTERNALOID ||
+			IsPolymorphicType(transtype))
+		{
+			context->failed = true;
+			return true;
+		}
+
+		/* aggregates without variables, like count(*), fit anywhere */
+		varnos = bms_union(pull_varnos((Node *) aggref->args),
+						   pull_varnos((Node *) aggref->aggfilter));
+		if (!bms_is_empty(varnos))
+		{
+			if (!bms_get_singleton_member(varnos, &varno) ||
+				(context->aggrelid != 0 &&
+				 context->aggrelid != (Index) varno))
+			{
+				context->failed = true;
+				return true;
+			}
+			context->aggrelid = varno;
+		}
+
+		context->aggs = lappend(context->aggs, aggref);
+		context->transtypes = lappend_oid(context->transtypes, transtype);
+		return false;			/* don't recurse into aggregate arguments */
+	}
+	return expression_tree_walker(node, find_eager_aggs_walker,
+								  (void *) context);
+}
+
+/*
+ * has_outer_references_walker
+ *		Detect Vars and aggregates belonging to an outer query level.
+ *
+ * Queries with SubLinks have been rejected already, so no deeper query
+ * levels need to be considered.
+ */
+static bool
+has_outer_references_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Var))
+		return ((Var *) node)->varlevelsup > 0;
+	if (IsA(node, Aggref))
+	{
+		if (((Aggref *) node)->agglevelsup > 0)
+			return true;
+	}
+	return expression_tree_walker(node, has_outer_references_walker, context);
+}
+
+/*
+ * replace_eager_vars_mutator
+ *		Redirect references to the aggregated relation to the output columns
+ *		of its subquery, and turn the aggregates into combining ones.
+ *
+ * Columns that aren't grouping keys can only appear in join alias lists,
+ * which nothing reads any more; they become NULL constants.
+ */
+static Node *
+replace_eager_vars_mutator(Node *node, eager_replace_context *context)
+{
+	if (node == NULL)
+		return NULL;
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+		AttrNumber	resno = 1;
+		ListCell   *lc;
+
+		if (var->varno != context->aggrelid || var->varlevelsup != 0)
+			return (Node *) copyObject(var);
+
+		foreach(lc, context->keyattnos)
+		{
+			if (lfirst_int(lc) == var->varattno)
+			{
+				Var		   *newvar = (Var *) copyObject(var);
+
+				newvar->varattno = resno;
+				return (Node *) newvar;
+			}
+			resno++;
+		}
+		return (Node *) makeNullConst(var->vartype, var->vartypmod,
+									  var->varcollid);
+	}
+	if (IsA(node, Aggref))
+	{
+		Aggref	   *aggref = (Aggref *) node;
+		Aggref	   *newagg;
+		AttrNumber	resno = list_length(context->keyattnos) + 1;
+		ListCell   *lc;
+		ListCell   *lc2;
+
+		forboth(lc, context->aggs, lc2, context->transtypes)
+		{
+			if (equal(lfirst(lc), aggref))
+				break;
+			resno++;
+		}
+		if (lc == NULL)
+			elog(ERROR, "could not find aggregate in eager aggregation subquery");
+
+		newagg = (Aggref *) palloc(sizeof(Aggref));
+		memcpy(newagg, aggref, sizeof(Aggref));
+		newagg->args = list_make1(makeTargetEntry((Expr *)
+												  makeVar(context->aggrelid,
+														  resno,
+														  lfirst_oid(lc2),
+														  -1,
+								lfirst_oid(lc2) == aggref->aggtype ?
+														  aggref->aggcollid :
+														  InvalidOid,
+														  0),
+												  1, NULL, false));
+		newagg->aggfilter = NULL;
+		newagg->aggstar = false;
+		newagg->aggvariadic = false;
+		newagg->aggcombine = true;
+		return (Node *) newagg;
+	}
+	return expression_tree_mutator(node, replace_eager_vars_mutator,
+								   (void *) context);
+}
@@ -76,6 +76,7 @@ typedef struct
 
 /* Local functions */
 static Node *preprocess_expression(PlannerInfo *root, Node *expr, int kind);
+static bool values_lists_are_consts(List *values_lists);
 static void preprocess_qual_conditions(PlannerInfo *root, Node *jtnode);
 static Plan *inheritance_planner(PlannerInfo *root);
 static Plan *grouping_planner(PlannerInfo *root, double tuple_fraction);
@@ -93,6 +94,12 @@ static bool choose_hashed_grouping(PlannerInfo *root,
 					   double path_rows, int path_width,
 					   Path *cheapest_path, Path *sorted_path,
 					   double dNumGroups, AggClauseCosts *agg_costs);
+static bool choose_hashed_grouping_sets(PlannerInfo *root,
+							double tuple_fraction, double limit_tuples,
+							double path_rows, int path_width,
+							Path *cheapest_path, Path *sorted_path,
+							double dNumGroups, AggClauseCosts *agg_costs,
+							List *rollup_groupclauses, List *rollup_lists);
 static bool choose_hashed_distinct(PlannerInfo *root,
 					   double tuple_fraction, double limit_tuples,
 					   double path_rows, int path_width,
@@ -100,6 +107,11 @@ static bool choose_hashed_distinct(PlannerInfo *root,
 					   Cost sorted_startup_cost, Cost sorted_total_cost,
 					   List *sorted_pathkeys,
 					   double dNumDistinctRows);
+static Path *choose_incremental_sort_path(PlannerInfo *root,
+							 RelOptInfo *final_rel,
+							 double tuple_fraction,
+							 double path_rows, int path_width,
+							 Path *cheapest_path, Path *sorted_path);
 static List *make_subplanTargetList(PlannerInfo *root, List *tlist,
 					   AttrNumber **groupColIdx, bool *need_tlist_eval);
 static int	get_grouping_column_index(Query *parse, TargetEntry *tle);
@@ -132,6 +144,14 @@ static Plan *build_grouping_chain(PlannerInfo *root,
 					 AggClauseCosts *agg_costs,
 					 long numGroups,
 					 Plan *result_plan);
+static Plan *build_hashed_grouping_sets(PlannerInfo *root,
+						   Query *parse,
+						   List *tlist,
+						   List *rollup_groupclauses,
+						   List *rollup_lists,
+						   AggClauseCosts *agg_costs,
+						   double path_rows,
+						   Plan *result_plan);
 
 /*****************************************************************************
  *
@@ -196,6 +216,7 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	glob->lastRowMarkId = 0;
 	glob->transientPlan = false;
 	glob->hasRowSecurity = false;
+	glob->statsslot_cache = NULL;
 
 	/* Determine what fraction of the plan is likely to be scanned */
 	if (cursorOptions & CURSOR_OPT_FAST_PLAN)
@@ -315,11 +336,26 @@ subquery_planner(PlannerGlobal *glob, Query *parse,
 	int			num_old_subplans = list_length(glob->subplans);
 	PlannerInfo *root;
 	Plan	   *plan;
+	Query	   *eager_parse;
+	PlannerInfo *eager_root = NULL;
+	Plan	   *eager_plan = NULL;
 	List	   *newWithCheckOptions;
 	List	   *newHaving;
 	bool		hasOuterJoins;
 	ListCell   *l;
 
+	/*
+	 * If one relation can be aggregated before it is joined to the others,
+	 * plan that form of the query first; we keep whichever plan is cheaper.
+	 * This must happen before the preprocessing below scribbles on parse.
+	 */
+	eager_parse = enable_eager_aggregate ?
+		make_eager_aggregate_query(parse) : NULL;
+	if (eager_parse)
+		eager_plan = subquery_planner(glob, eager_parse, parent_root,
+									  hasRecursion, tuple_fraction,
+									  &eager_root);
+
 	/* Create a PlannerInfo data structure for this subquery */
 	root = makeNode(PlannerInfo);
 	root->parse = parse;
@@ -531,10 +567,16 @@ subquery_planner(PlannerGlobal *glob, Query *parse,
 		}
 		else if (rte->rtekind == RTE_VALUES)
 		{
-			/* Preprocess the values lists fully */
+			/*
+			 * Preprocess the values lists fully, unless they're all Consts
+			 * (as the rows of a big INSERT ... VALUES usually are), in which
+			 * case all it would do is copy them.
+			 */
 			kind = rte->lateral ? EXPRKIND_VALUES_LATERAL : EXPRKIND_VALUES;
-			rte->values_lists = (List *)
-				preprocess_expression(root, (Node *) rte->values_lists, kind);
+			if (!values_lists_are_consts(rte->values_lists))
+				rte->values_lists = (List *)
+					preprocess_expression(root, (Node *) rte->values_lists,
+										  kind);
 		}
 	}
 
@@ -671,6 +713,12 @@ subquery_planner(PlannerGlobal *glob, Query *parse,
 		root->glob->nParamExec > 0)
 		SS_finalize_plan(root, plan, true);
 
+	if (eager_plan && eager_plan->total_cost < plan->total_cost)
+	{
+		plan = eager_plan;
+		root = eager_root;
+	}
+
 	/* Return internal info if caller wants it */
 	if (subroot)
 		*subroot = root;
@@ -739,6 +787,14 @@ preprocess_expression(PlannerInfo *root, Node *expr, int kind)
 #endif
 	}
 
+	/*
+	 * Have ScalarArrayOpExprs over large constant arrays use hash lookups.
+	 * This must follow eval_const_expressions, which is what folds an IN
+	 * list into a constant array.
+	 */
+	if (kind == EXPRKIND_QUAL || kind == EXPRKIND_TARGET)
+		convert_saop_to_hashed_saop(expr);
+
 	/* Expand SubLinks to SubPlans */
 	if (root->parse->hasSubLinks)
 		expr = SS_process_sublinks(root, expr, (kind == EXPRKIND_QUAL));
@@ -764,6 +820,29 @@ preprocess_expression(PlannerInfo *root, Node *expr, int kind)
 	return expr;
 }
 
+/*
+ * values_lists_are_consts
+ *		Are all the items of a VALUES RTE's lists simple constants?
+ *
+ * preprocess_expression would leave such lists unchanged.
+ */
+static bool
+values_lists_are_consts(List *values_lists)
+{
+	ListCell   *lc;
+	ListCell   *lc2;
+
+	foreach(lc, values_lists)
+	{
+		foreach(lc2, (List *) lfirst(lc))
+		{
+			if (!IsA(lfirst(lc2), Const))
+				return false;
+		}
+	}
+	return true;
+}
+
 /*
  * preprocess_qual_conditions
  *		Recursively scan the query's jointree and do subquery_planner's
@@ -1260,6 +1339,7 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 	double		dNumGroups = 0;
 	bool		use_hashed_distinct = false;
 	bool		tested_hashed_distinct = false;
+	bool		use_incremental_sort = false;
 
 	/* Tweak caller-supplied tuple_fraction if have LIMIT/OFFSET */
 	if (parse->limitCount || parse->limitOffset)
@@ -1732,6 +1812,32 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 			}
 		}
 
+		/*
+		 * For a plain query whose only ordering requirement is ORDER BY, a
+		 * path that is sorted on a prefix of the wanted pathkeys may be
+		 * finished off by an incremental sort more cheaply than either of
+		 * the above.
+		 */
+		if (parse->sortClause && !parse->groupClause &&
+			!parse->groupingSets && !parse->hasAggs &&
+			!root->hasHavingQual && !parse->distinctClause &&
+			!activeWindows)
+		{
+			Path	   *incremental_path;
+
+			incremental_path = choose_incremental_sort_path(root, final_rel,
+															tuple_fraction,
+															path_rows,
+															path_width,
+															cheapest_path,
+															sorted_path);
+			if (incremental_path)
+			{
+				sorted_path = incremental_path;
+				use_incremental_sort = true;
+			}
+		}
+
 		/*
 		 * Consider whether we want to use hashing instead of sorting.
 		 */
@@ -1739,13 +1845,20 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 		{
 			/*
 			 * If grouping, decide whether to use sorted or hashed grouping.
-			 * If grouping sets are present, we can currently do only sorted
-			 * grouping.
+			 * With grouping sets, hashing means building one hash table per
+			 * set in a single pass over the input.
 			 */
 
 			if (parse->groupingSets)
 			{
-				use_hashed_grouping = false;
+				use_hashed_grouping =
+					choose_hashed_grouping_sets(root,
+												tuple_fraction, limit_tuples,
+												path_rows, path_width,
+												cheapest_path, sorted_path,
+												dNumGroups, &agg_costs,
+												rollup_groupclauses,
+												rollup_lists);
 			}
 			else
 			{
@@ -1909,7 +2022,23 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 			 *
 			 * HAVING clause, if any, becomes qual of the Agg or Group node.
 			 */
-			if (use_hashed_grouping)
+			if (use_hashed_grouping && parse->groupingSets)
+			{
+				/* One hash table per grouping set --- no sort needed */
+				result_plan = build_hashed_grouping_sets(root,
+														 parse,
+														 tlist,
+														 rollup_groupclauses,
+														 rollup_lists,
+														 &agg_costs,
+														 path_rows,
+														 result_plan);
+				/* Hashed aggregation produces randomly-ordered results */
+				current_pathkeys = NIL;
+				rollup_groupclauses = NIL;
+				rollup_lists = NIL;
+			}
+			else if (use_hashed_grouping)
 			{
 				/* Hashed aggregate plan --- no sort needed */
 				result_plan = (Plan *) make_agg(root,
@@ -2291,7 +2420,24 @@ grouping_planner(PlannerInfo *root, double tuple_fraction)
 	 */
 	if (parse->sortClause)
 	{
-		if (!pathkeys_contained_in(root->sort_pathkeys, current_pathkeys))
+		int			presorted_keys;
+
+		if (pathkeys_count_contained_in(root->sort_pathkeys, current_pathkeys,
+										&presorted_keys))
+		{
+			/* already sorted */
+		}
+		else if (use_incremental_sort && presorted_keys > 0)
+		{
+			result_plan = (Plan *)
+				make_incrementalsort_from_pathkeys(root,
+												   result_plan,
+												   root->sort_pathkeys,
+												   presorted_keys,
+												   limit_tuples);
+			current_pathkeys = root->sort_pathkeys;
+		}
+		else
 		{
 			result_plan = (Plan *) make_sort_from_pathkeys(root,
 														   result_plan,
@@ -2373,6 +2519,93 @@ remap_groupColIdx(PlannerInfo *root, List *groupClause)
 	return new_grpColIdx;
 }
 
+/*
+ * Build Agg nodes to implement hashed grouping with grouping sets.
+ *
+ * Each grouping set gets an AGG_HASHED node of its own, whose grpColIdx
+ * holds just that set's columns.  The first becomes the real Agg node; the
+ * others are chained to it, without input or targetlist, to describe the
+ * additional hash tables the executor fills during the same pass over the
+ * input.
+ *
+ * rollup_groupclauses and rollup_lists are as for build_grouping_chain, and
+ * are likewise destroyed.
+ */
+static Plan *
+build_hashed_grouping_sets(PlannerInfo *root,
+						   Query *parse,
+						   List *tlist,
+						   List *rollup_groupclauses,
+						   List *rollup_lists,
+						   AggClauseCosts *agg_costs,
+						   double path_rows,
+						   Plan *result_plan)
+{
+	List	   *aggs = NIL;
+	Plan	   *top_plan;
+	ListCell   *lc,
+			   *lc2;
+
+	forboth(lc, rollup_groupclauses, lc2, rollup_lists)
+	{
+		List	   *groupClause = (List *) lfirst(lc);
+		List	   *groupExprs;
+		ListCell   *lc3;
+
+		groupExprs = get_sortgrouplist_exprs(groupClause, parse->targetList);
+
+		foreach(lc3, (List *) lfirst(lc2))
+		{
+			List	   *gset = (List *) lfirst(lc3);
+			int			numGroupCols = list_length(gset);
+			List	   *setClause;
+			double		dNumGroups;
+			Plan	   *agg_plan;
+
+			/* the sets of a rollup are prefixes of its groupClause */
+			setClause = list_truncate(list_copy(groupClause), numGroupCols);
+
+			dNumGroups = estimate_num_groups(root, groupExprs, path_rows,
+											 &gset);
+
+			agg_plan = (Plan *) make_agg(root,
+										 tlist,
+										 (List *) parse->havingQual,
+										 AGG_HASHED,
+										 agg_costs,
+										 numGroupCols,
+										 remap_groupColIdx(root, setClause),
+										 extract_grouping_ops(setClause),
+										 list_make1(gset),
+										 (long) Min(dNumGroups, (double) LONG_MAX),
+										 result_plan);
+
+			aggs = lappend(aggs, agg_plan);
+		}
+	}
+
+	top_plan = (Plan *) linitial(aggs);
+	((Agg *) top_plan)->chain = list_delete_first(aggs);
+
+	/*
+	 * Add the other tables' costs and rows, but not their input again, and
+	 * nuke what we don't need to avoid bloating debug output.
+	 */
+	foreach(lc, ((Agg *) top_plan)->chain)
+	{
+		Plan	   *subplan = (Plan *) lfirst(lc);
+
+		top_plan->total_cost += subplan->total_cost - result_plan->total_cost;
+		top_plan->plan_rows += subplan->plan_rows;
+
+		subplan->lefttree = NULL;
+		subplan->targetlist = NIL;
+		subplan->qual = NIL;
+	}
+
+	return top_plan;
+}
+
 /*
  * Build Agg and Sort nodes to implement sorted grouping with one or more
  * grouping sets. (A plain GROUP BY or just the presence of aggregates counts
@@ -3694,6 +3927,165 @@ choose_hashed_grouping(PlannerInfo *root,
 	return false;
 }
 
+/*
+ * choose_hashed_grouping_sets - should we use hashing for GROUPING SETS?
+ *
+ * This is choose_hashed_grouping for queries with grouping sets.  Hashing
+ * builds a hash table for every grouping set at once, so it needs to fit all
+ * of their groups in work_mem; the alternative is one sort-and-aggregate
+ * pass per rollup.
+ */
+static bool
+choose_hashed_grouping_sets(PlannerInfo *root,
+							double tuple_fraction, double limit_tuples,
+							double path_rows, int path_width,
+							Path *cheapest_path, Path *sorted_path,
+							double dNumGroups, AggClauseCosts *agg_costs,
+							List *rollup_groupclauses, List *rollup_lists)
+{
+	Query	   *parse = root->parse;
+	bool		can_hash;
+	bool		can_sort;
+	Size		hashentrysize;
+	List	   *target_pathkeys;
+	List	   *current_pathkeys;
+	Path		hashed_p;
+	Path		sorted_p;
+	ListCell   *lc,
+			   *lc2;
+
+	/* Same restrictions as for plain hashed grouping */
+	can_hash = (agg_costs->numOrderedAggs == 0 &&
+				grouping_is_hashable(parse->groupClause));
+	can_sort = grouping_is_sortable(parse->groupClause);
+
+	/* Quick out if only one choice is workable */
+	if (!(can_hash && can_sort))
+	{
+		if (can_hash)
+			return true;
+		else if (can_sort)
+			return false;
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("could not implement GROUP BY"),
+					 errdetail("Some of the datatypes only support hashing, while others only support sorting.")));
+	}
+
+	/* Prefer sorting when enable_hashagg is off */
+	if (!enable_hashagg)
+		return false;
+
+	/*
+	 * Don't do it if it doesn't look like all the hashtables will fit into
+	 * work_mem together.  dNumGroups is the total over all the sets.
+	 */
+	hashentrysize = MAXALIGN(path_width) + MAXALIGN(SizeofMinimalTupleHeader);
+	hashentrysize += agg_costs->transitionSpace;
+	hashentrysize += hash_agg_entry_size(agg_costs->numAggs);
+
+	if (hashentrysize * dNumGroups > work_mem * 1024L)
+		return false;
+
+	if (list_length(root->distinct_pathkeys) >
+		list_length(root->sort_pathkeys))
+		target_pathkeys = root->distinct_pathkeys;
+	else
+		target_pathkeys = root->sort_pathkeys;
+
+	/*
+	 * Hashing makes one pass over the cheapest path and aggregates every
+	 * input row once per grouping set.  Sorting needs a sort of the entire
+	 * input for each rollup beyond the first (and for the first one too if
+	 * the input isn't already in the right order), followed by an aggregation
+	 * pass over it.
+	 */
+	hashed_p.startup_cost = cheapest_path->startup_cost;
+	hashed_p.total_cost = cheapest_path->total_cost;
+
+	if (sorted_path)
+	{
+		sorted_p.startup_cost = sorted_path->startup_cost;
+		sorted_p.total_cost = sorted_path->total_cost;
+		current_pathkeys = sorted_path->pathkeys;
+	}
+	else
+	{
+		sorted_p.startup_cost = cheapest_path->startup_cost;
+		sorted_p.total_cost = cheapest_path->total_cost;
+		current_pathkeys = cheapest_path->pathkeys;
+	}
+	if (!pathkeys_contained_in(root->group_pathkeys, current_pathkeys))
+	{
+		cost_sort(&sorted_p, root, root->group_pathkeys, sorted_p.total_cost,
+				  path_rows, path_width,
+				  0.0, work_mem, -1.0);
+		current_pathkeys = root->group_pathkeys;
+	}
+
+	forboth(lc, rollup_groupclauses, lc2, rollup_lists)
+	{
+		List	   *groupClause = (List *) lfirst(lc);
+		List	   *groupExprs;
+		double		rollupGroups = 0;
+		ListCell   *lc3;
+
+		groupExprs = get_sortgrouplist_exprs(groupClause, parse->targetList);
+
+		foreach(lc3, (List *) lfirst(lc2))
+		{
+			List	   *gset = (List *) lfirst(lc3);
+			double		numGroups;
+
+			numGroups = estimate_num_groups(root, groupExprs, path_rows,
+											&gset);
+			rollupGroups += numGroups;
+
+			cost_agg(&hashed_p, root, AGG_HASHED, agg_costs,
+					 list_length(gset), numGroups,
+					 hashed_p.startup_cost, hashed_p.total_cost,
+					 path_rows);
+		}
+
+		/* the sort for the first rollup was accounted for above */
+		if (lnext(lc) != NULL)
+		{
+			Path		sort_p;
+
+			cost_sort(&sort_p, root, NIL, 0.0,
+					  path_rows, path_width,
+					  0.0, work_mem, -1.0);
+			sorted_p.total_cost += sort_p.total_cost;
+			current_pathkeys = NIL;
+		}
+
+		cost_agg(&sorted_p, root, AGG_SORTED, agg_costs,
+				 list_length(groupClause), rollupGroups,
+				 sorted_p.startup_cost, sorted_p.total_cost,
+				 path_rows);
+	}
+
+	/* Result of hashed agg is always unsorted */
+	if (target_pathkeys)
+		cost_sort(&hashed_p, root, target_pathkeys, hashed_p.total_cost,
+				  dNumGroups, path_width,
+				  0.0, work_mem, limit_tuples);
+	if (target_pathkeys &&
+		!pathkeys_contained_in(target_pathkeys, current_pathkeys))
+		cost_sort(&sorted_p, root, target_pathkeys, sorted_p.total_cost,
+				  dNumGroups, path_width,
+				  0.0, work_mem, limit_tuples);
+
+	if (compare_fractional_path_costs(&hashed_p, &sorted_p,
+									  tuple_fraction) < 0)
+	{
+		/* Hashed is cheaper, so use it */
+		return true;
+	}
+	return false;
+}
+
 /*
  * choose_hashed_distinct - should we use hashing for DISTINCT?
  *
@@ -3845,6 +4237,79 @@ choose_hashed_distinct(PlannerInfo *root,
 	return false;
 }
 
+/*
+ * choose_incremental_sort_path - look for a partially sorted input path
+ *
+ * Consider each unparameterized path of final_rel that is sorted on a
+ * non-empty proper prefix of the ORDER BY pathkeys, and cost finishing it
+ * with an incremental sort.  The best of these is returned if it beats both
+ * the presorted path (if any) and an explicit sort of the cheapest path, at
+ * the given tuple_fraction; otherwise NULL.
+ *
+ * The returned path's pathkeys are only a prefix of root->sort_pathkeys, so
+ * the caller must add the IncrementalSort node itself when it builds the
+ * ORDER BY step.
+ */
+static Path *
+choose_incremental_sort_path(PlannerInfo *root, RelOptInfo *final_rel,
+							 double tuple_fraction,
+							 double path_rows, int path_width,
+							 Path *cheapest_path, Path *sorted_path)
+{
+	List	   *pathkeys = root->sort_pathkeys;
+	Path		best_p;
+	Path		incr_p;
+	Path	   *best_path = NULL;
+	ListCell   *lc;
+	int			presorted_keys;
+
+	if (list_length(pathkeys) < 2)
+		return NULL;
+
+	/* Nothing to gain if the cheapest path comes out in the right order */
+	if (pathkeys_contained_in(pathkeys, cheapest_path->pathkeys))
+		return NULL;
+
+	/* Cost of the best plan found so far */
+	if (sorted_path)
+	{
+		best_p.startup_cost = sorted_path->startup_cost;
+		best_p.total_cost = sorted_path->total_cost;
+	}
+	else
+		cost_sort(&best_p, root, pathkeys, cheapest_path->total_cost,
+				  path_rows, path_width,
+				  0.0, work_mem, root->limit_tuples);
+
+	foreach(lc, final_rel->pathlist)
+	{
+		Path	   *path = (Path *) lfirst(lc);
+
+		if (path->param_info)
+			continue;
+
+		(void) pathkeys_count_contained_in(pathkeys, path->pathkeys,
+										   &presorted_keys);
+		if (presorted_keys == 0 || presorted_keys >= list_length(pathkeys))
+			continue;
+
+		cost_incremental_sort(&incr_p, root, pathkeys, presorted_keys,
+							  path->startup_cost, path->total_cost,
+							  path_rows, path_width,
+							  0.0, work_mem, root->limit_tuples);
+
+		if (compare_fractional_path_costs(&incr_p, &best_p,
+										  tuple_fraction) < 0)
+		{
+			best_p.startup_cost = incr_p.startup_cost;
+			best_p.total_cost = incr_p.total_cost;
+			best_path = path;
+		}
+	}
+
+	return best_path;
+}
+
 /*
  * make_subplanTargetList
  *	  Generate appropriate target list when grouping is required.
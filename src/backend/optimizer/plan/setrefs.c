@@ -600,6 +600,7 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 		case T_Hash:
 		case T_Material:
 		case T_Sort:
+		case T_IncrementalSort:
 		case T_Unique:
 		case T_SetOp:
 
@@ -618,6 +619,18 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 			 */
 			Assert(plan->qual == NIL);
 			break;
+		case T_Memoize:
+			{
+				Memoize    *mplan = (Memoize *) plan;
+
+				/* Like Material, except that the cache keys need fixing */
+				set_dummy_tlist_references(plan, rtoffset);
+				Assert(plan->qual == NIL);
+
+				mplan->param_exprs =
+					fix_scan_list(root, mplan->param_exprs, rtoffset);
+			}
+			break;
 		case T_LockRows:
 			{
 				LockRows   *splan = (LockRows *) plan;
@@ -835,6 +848,10 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 											  (Plan *) lfirst(l),
 											  rtoffset);
 				}
+				splan->prune_constraints =
+					fix_scan_list(root, splan->prune_constraints, rtoffset);
+				splan->prune_clauses =
+					fix_scan_list(root, splan->prune_clauses, rtoffset);
 			}
 			break;
 		case T_MergeAppend:
@@ -853,6 +870,10 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 											  (Plan *) lfirst(l),
 											  rtoffset);
 				}
+				splan->prune_constraints =
+					fix_scan_list(root, splan->prune_constraints, rtoffset);
+				splan->prune_clauses =
+					fix_scan_list(root, splan->prune_clauses, rtoffset);
 			}
 			break;
 		case T_RecursiveUnion:
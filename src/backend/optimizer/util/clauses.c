@@ -101,6 +101,7 @@ static bool contain_leaked_vars_walker(Node *node, void *context);
 static Relids find_nonnullable_rels_walker(Node *node, bool top_level);
 static List *find_nonnullable_vars_walker(Node *node, bool top_level);
 static bool is_strict_saop(ScalarArrayOpExpr *expr, bool falseOK);
+static bool convert_saop_to_hashed_saop_walker(Node *node, void *context);
 static Node *eval_const_expressions_mutator(Node *node,
 							   eval_const_expressions_context *context);
 static List *simplify_or_arguments(List *args,
@@ -487,8 +488,10 @@ count_agg_clauses_walker(Node *node, count_agg_clauses_context *context)
 			elog(ERROR, "cache lookup failed for aggregate %u",
 				 aggref->aggfnoid);
 		aggform = (Form_pg_aggregate) GETSTRUCT(aggTuple);
-		aggtransfn = aggform->aggtransfn;
-		aggfinalfn = aggform->aggfinalfn;
+		/* combining and partial steps use the combine function, no finalfn */
+		aggtransfn = aggref->aggcombine ? aggform->aggcombinefn :
+			aggform->aggtransfn;
+		aggfinalfn = aggref->aggpartial ? InvalidOid : aggform->aggfinalfn;
 		aggtranstype = aggform->aggtranstype;
 		aggtransspace = aggform->aggtransspace;
 		ReleaseSysCache(aggTuple);
@@ -1194,6 +1197,13 @@ contain_volatile_functions_not_nextval_walker(Node *node, void *context)
 		}
 		/* else fall through to check args */
 	}
+	else if (IsA(node, Query))
+	{
+		/* Recurse into subselects */
+		return query_tree_walker((Query *) node,
+								 contain_volatile_functions_not_nextval_walker,
+								 context, 0);
+	}
 	return expression_tree_walker(node, contain_volatile_functions_not_nextval_walker,
 								  context);
 }
@@ -2272,6 +2282,76 @@ CommuteRowCompareExpr(RowCompareExpr *clause)
 	clause->rargs = temp;
 }
 
+/*
+ * Smallest array for which a hash table beats comparing elements in turn.
+ * A successful linear search stops halfway on average, so a handful of
+ * comparisons is about what one hash computation plus a probe costs.
+ */
+#define MIN_ARRAY_SIZE_FOR_HASHED_SAOP 9
+
+/*
+ * convert_saop_to_hashed_saop
+ *		Arrange for ScalarArrayOpExprs over large constant arrays to be
+ *		evaluated by hashing.
+ *
+ * The executor normally compares the scalar against each array element in
+ * turn.  When the array is a Const with at least
+ * MIN_ARRAY_SIZE_FOR_HASHED_SAOP elements and the comparison is a hashable
+ * equality (for ANY) or the negator of one (for ALL, as NOT IN produces),
+ * we instead fill in hashfuncid, and for ALL negfuncid, telling the
+ * executor to build a hash table of the elements once and probe it per
+ * evaluation.  The operator functions must be strict, so that a NULL
+ * scalar or element yields NULL just as the linear search would.
+ *
+ * The expression tree is modified in place.
+ */
+void
+convert_saop_to_hashed_saop(Node *node)
+{
+	(void) convert_saop_to_hashed_saop_walker(node, NULL);
+}
+
+static bool
+convert_saop_to_hashed_saop_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) node;
+		Const	   *arrayarg = (Const *) lsecond(saop->args);
+		Oid			eqop;
+		Oid			lefthashfunc;
+		Oid			righthashfunc;
+
+		eqop = saop->useOr ? saop->opno : get_negator(saop->opno);
+
+		if (IsA(arrayarg, Const) && !arrayarg->constisnull &&
+			OidIsValid(eqop) &&
+			get_op_hash_functions(eqop, &lefthashfunc, &righthashfunc) &&
+			lefthashfunc == righthashfunc)
+		{
+			ArrayType  *arr = DatumGetArrayTypeP(arrayarg->constvalue);
+			int			nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
+			Oid			eqfunc = get_opcode(eqop);
+
+			set_sa_opfuncid(saop);
+			if (nitems >= MIN_ARRAY_SIZE_FOR_HASHED_SAOP &&
+				func_strict(saop->opfuncid) && func_strict(eqfunc))
+			{
+				saop->hashfuncid = lefthashfunc;
+				if (!saop->useOr)
+					saop->negfuncid = eqfunc;
+			}
+		}
+		/* fall through to process the operands */
+	}
+
+	return expression_tree_walker(node, convert_saop_to_hashed_saop_walker,
+								  context);
+}
+
 /*
  * Helper for eval_const_expressions: check that datatype of an attribute
  * is still what it was when the expression was parsed.  This is needed to
@@ -22,11 +22,13 @@
 #include "access/htup_details.h"
 #include "access/nbtree.h"
 #include "access/sysattr.h"
+#include "access/tableam.h"
 #include "access/transam.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
 #include "catalog/dependency.h"
 #include "catalog/heap.h"
+#include "catalog/pg_statistic_ext.h"
 #include "foreign/fdwapi.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
@@ -38,10 +40,12 @@
 #include "parser/parse_relation.h"
 #include "parser/parsetree.h"
 #include "rewrite/rewriteManip.h"
+#include "statistics/statistics.h"
 #include "storage/bufmgr.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
 
 
 /* GUC parameter */
@@ -57,8 +61,12 @@ static int32 get_rel_data_width(Relation rel, int32 *attr_widths);
 static List *get_relation_constraints(PlannerInfo *root,
 						 Oid relationObjectId, RelOptInfo *rel,
 						 bool include_notnull);
+static bool constraint_exclusion_enabled(PlannerInfo *root, RelOptInfo *rel);
+static List *get_relation_safe_constraints(PlannerInfo *root,
+							  RelOptInfo *rel, RangeTblEntry *rte);
 static List *build_index_tlist(PlannerInfo *root, IndexOptInfo *index,
 				  Relation heapRelation);
+static List *get_relation_statistics(RelOptInfo *rel, Relation relation);
 
 
 /*
@@ -71,6 +79,7 @@ static List *build_index_tlist(PlannerInfo *root, IndexOptInfo *index,
  *	min_attr	lowest valid AttrNumber
  *	max_attr	highest valid AttrNumber
  *	indexlist	list of IndexOptInfos for relation's indexes
+ *	statlist	list of StatisticExtInfo for relation's extended statistics
  *	serverid	if it's a foreign table, the server OID
  *	fdwroutine	if it's a foreign table, the FDW function pointers
  *	pages		number of pages
@@ -84,15 +93,34 @@ static List *build_index_tlist(PlannerInfo *root, IndexOptInfo *index,
  * the RelOptInfo actually represents the appendrel formed by an inheritance
  * tree, and so the parent rel's physical size and index information isn't
  * important for it.
+ *
+ * This is just get_relation_attr_info followed by get_relation_physical_info;
+ * appendrel children call the two halves separately.
  */
 void
 get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 				  RelOptInfo *rel)
 {
-	Index		varno = rel->relid;
+	get_relation_attr_info(root, relationObjectId, rel);
+	get_relation_physical_info(root, relationObjectId, inhparent, rel);
+}
+
+/*
+ * get_relation_attr_info -
+ *	  Set up min_attr, max_attr, reltablespace and the attr_needed[] and
+ *	  attr_widths[] arrays of a relation's RelOptInfo.
+ *
+ * This is all that's needed to build an appendrel child's RelOptInfo.  The
+ * rest of the catalog information is much more expensive to collect (it
+ * means opening all the indexes and the relation's storage), and is useless
+ * for children that constraint exclusion will throw away, so
+ * set_append_rel_size fetches it only for the children that survive.
+ */
+void
+get_relation_attr_info(PlannerInfo *root, Oid relationObjectId,
+					   RelOptInfo *rel)
+{
 	Relation	relation;
-	bool		hasindex;
-	List	   *indexinfos = NIL;
 
 	/*
 	 * We need not lock the relation since it was already locked, either by
@@ -117,6 +145,26 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 	rel->attr_widths = (int32 *)
 		palloc0((rel->max_attr - rel->min_attr + 1) * sizeof(int32));
 
+	heap_close(relation, NoLock);
+}
+
+/*
+ * get_relation_physical_info -
+ *	  Fill in the size estimates, indexlist, statlist and foreign-table
+ *	  fields of a RelOptInfo whose attr arrays are already set up.
+ */
+void
+get_relation_physical_info(PlannerInfo *root, Oid relationObjectId,
+						   bool inhparent, RelOptInfo *rel)
+{
+	Index		varno = rel->relid;
+	Relation	relation;
+	bool		hasindex;
+	List	   *indexinfos = NIL;
+
+	/* As above, the relation is already locked */
+	relation = heap_open(relationObjectId, NoLock);
+
 	/*
 	 * Estimate relation size --- unless it's an inheritance parent, in which
 	 * case the size will be computed later in set_append_rel_pathlist, and we
@@ -207,6 +255,7 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 				RelationGetForm(indexRelation)->reltablespace;
 			info->rel = rel;
 			info->ncolumns = ncolumns = index->indnatts;
+			info->nkeycolumns = index->indnkeyatts;
 			info->indexkeys = (int *) palloc(sizeof(int) * ncolumns);
 			info->indexcollations = (Oid *) palloc(sizeof(Oid) * ncolumns);
 			info->opfamily = (Oid *) palloc(sizeof(Oid) * ncolumns);
@@ -381,6 +430,13 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 
 	rel->indexlist = indexinfos;
 
+	/*
+	 * Extended statistics describe the table itself, so like the size
+	 * estimates they're of no use for an inheritance parent.
+	 */
+	if (!inhparent)
+		rel->statlist = get_relation_statistics(rel, relation);
+
 	/* Grab foreign-table info using the relcache, while we have it */
 	if (relation->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
 	{
@@ -587,8 +643,8 @@ infer_arbiter_indexes(PlannerInfo *root)
 		if (!idxForm->indisunique)
 			goto next;
 
-		/* Build BMS representation of cataloged index attributes */
-		for (natt = 0; natt < idxForm->indnatts; natt++)
+		/* Build BMS representation of cataloged index key attributes */
+		for (natt = 0; natt < idxForm->indnkeyatts; natt++)
 		{
 			int			attno = idxRel->rd_index->indkey.values[natt];
 
@@ -796,6 +852,19 @@ estimate_rel_size(Relation rel, int32 *attr_widths,
 	BlockNumber relallvisible;
 	double		density;
 
+	/* A table access method may have its own idea of the table's size */
+	if (rel->rd_rel->relkind == RELKIND_RELATION && !RelationUsesHeapAM(rel))
+	{
+		TableAmRoutine *routine = GetTableAmRoutineForRelation(rel, false);
+
+		if (routine->relation_estimate_size != NULL)
+		{
+			routine->relation_estimate_size(rel, attr_widths,
+											pages, tuples, allvisfrac);
+			return;
+		}
+	}
+
 	switch (rel->rd_rel->relkind)
 	{
 		case RELKIND_RELATION:
@@ -1005,6 +1074,90 @@ get_relation_data_width(Oid relid, int32 *attr_widths)
 }
 
 
+/*
+ * get_relation_statistics
+ *		Retrieve extended statistics defined on the table.
+ *
+ * Returns a List (possibly empty) of StatisticExtInfo objects describing
+ * the statistics.  Note that this doesn't load the actual statistics data,
+ * just the identifying metadata.  Only stats actually built are considered.
+ */
+static List *
+get_relation_statistics(RelOptInfo *rel, Relation relation)
+{
+	List	   *statoidlist;
+	List	   *stainfos = NIL;
+	ListCell   *l;
+
+	statoidlist = RelationGetStatExtList(relation);
+
+	foreach(l, statoidlist)
+	{
+		Oid			statOid = lfirst_oid(l);
+		Form_pg_statistic_ext staForm;
+		HeapTuple	htup;
+		Bitmapset  *keys = NULL;
+		int			i;
+
+		htup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(statOid));
+		if (!htup)
+			elog(ERROR, "cache lookup failed for statistics object %u", statOid);
+		staForm = (Form_pg_statistic_ext) GETSTRUCT(htup);
+
+		/*
+		 * First, build the array of columns covered.  This is ultimately
+		 * wasted if no stats within the object have actually been built, but
+		 * it doesn't seem worth troubling over that case.
+		 */
+		for (i = 0; i < staForm->stxkeys.dim1; i++)
+			keys = bms_add_member(keys, staForm->stxkeys.values[i]);
+
+		/* add one StatisticExtInfo for each kind built */
+		if (statext_is_kind_built(htup, STATS_EXT_NDISTINCT))
+		{
+			StatisticExtInfo *info = makeNode(StatisticExtInfo);
+
+			info->statOid = statOid;
+			info->rel = rel;
+			info->kind = STATS_EXT_NDISTINCT;
+			info->keys = bms_copy(keys);
+
+			stainfos = lcons(info, stainfos);
+		}
+
+		if (statext_is_kind_built(htup, STATS_EXT_DEPENDENCIES))
+		{
+			StatisticExtInfo *info = makeNode(StatisticExtInfo);
+
+			info->statOid = statOid;
+			info->rel = rel;
+			info->kind = STATS_EXT_DEPENDENCIES;
+			info->keys = bms_copy(keys);
+
+			stainfos = lcons(info, stainfos);
+		}
+
+		if (statext_is_kind_built(htup, STATS_EXT_MCV))
+		{
+			StatisticExtInfo *info = makeNode(StatisticExtInfo);
+
+			info->statOid = statOid;
+			info->rel = rel;
+			info->kind = STATS_EXT_MCV;
+			info->keys = bms_copy(keys);
+
+			stainfos = lcons(info, stainfos);
+		}
+
+		ReleaseSysCache(htup);
+		bms_free(keys);
+	}
+
+	list_free(statoidlist);
+
+	return stainfos;
+}
+
 /*
  * get_relation_constraints
  *
@@ -1116,6 +1269,90 @@ get_relation_constraints(PlannerInfo *root,
 }
 
 
+/*
+ * constraint_exclusion_enabled
+ *
+ * Is constraint exclusion to be attempted for the given relation, according
+ * to the constraint_exclusion setting?
+ */
+static bool
+constraint_exclusion_enabled(PlannerInfo *root, RelOptInfo *rel)
+{
+	if (constraint_exclusion == CONSTRAINT_EXCLUSION_OFF)
+		return false;
+	if (constraint_exclusion == CONSTRAINT_EXCLUSION_PARTITION &&
+		!(rel->reloptkind == RELOPT_OTHER_MEMBER_REL ||
+		  (root->hasInheritedTarget &&
+		   rel->reloptkind == RELOPT_BASEREL &&
+		   rel->relid == root->parse->resultRelation)))
+		return false;
+	return true;
+}
+
+/*
+ * get_relation_safe_constraints
+ *
+ * Return the relation's validated CHECK constraints, plus "col IS NOT NULL"
+ * expressions for attnotnull columns, leaving out any that contain mutable
+ * functions.  The result is an implicitly-ANDed list suitable for
+ * predicate_refuted_by().
+ *
+ * The relation must be a plain relation (rte->rtekind == RTE_RELATION).
+ */
+static List *
+get_relation_safe_constraints(PlannerInfo *root,
+							  RelOptInfo *rel, RangeTblEntry *rte)
+{
+	List	   *constraint_pred;
+	List	   *safe_constraints;
+	ListCell   *lc;
+
+	Assert(rte->rtekind == RTE_RELATION);
+
+	/*
+	 * OK to fetch the constraint expressions.  Include "col IS NOT NULL"
+	 * expressions for attnotnull columns, in case we can refute those.
+	 */
+	constraint_pred = get_relation_constraints(root, rte->relid, rel, true);
+
+	/*
+	 * We do not currently enforce that CHECK constraints contain only
+	 * immutable functions, so it's necessary to check here. We daren't draw
+	 * conclusions from plan-time evaluation of non-immutable functions. Since
+	 * they're ANDed, we can just ignore any mutable constraints in the list,
+	 * and reason about the rest.
+	 */
+	safe_constraints = NIL;
+	foreach(lc, constraint_pred)
+	{
+		Node	   *pred = (Node *) lfirst(lc);
+
+		if (!contain_mutable_functions(pred))
+			safe_constraints = lappend(safe_constraints, pred);
+	}
+
+	return safe_constraints;
+}
+
+/*
+ * get_relation_pruning_constraints
+ *
+ * Like get_relation_safe_constraints, but for use by run-time pruning of
+ * the relation as a child of an Append: returns NIL if constraint exclusion
+ * is disabled for the relation or it is not a plain relation.
+ */
+List *
+get_relation_pruning_constraints(PlannerInfo *root,
+								 RelOptInfo *rel, RangeTblEntry *rte)
+{
+	if (!constraint_exclusion_enabled(root, rel))
+		return NIL;
+	if (rte->rtekind != RTE_RELATION || rte->inh)
+		return NIL;
+	return get_relation_safe_constraints(root, rel, rte);
+}
+
+
 /*
  * relation_excluded_by_constraints
  *
@@ -1132,17 +1369,11 @@ relation_excluded_by_constraints(PlannerInfo *root,
 								 RelOptInfo *rel, RangeTblEntry *rte)
 {
 	List	   *safe_restrictions;
-	List	   *constraint_pred;
 	List	   *safe_constraints;
 	ListCell   *lc;
 
 	/* Skip the test if constraint exclusion is disabled for the rel */
-	if (constraint_exclusion == CONSTRAINT_EXCLUSION_OFF ||
-		(constraint_exclusion == CONSTRAINT_EXCLUSION_PARTITION &&
-		 !(rel->reloptkind == RELOPT_OTHER_MEMBER_REL ||
-		   (root->hasInheritedTarget &&
-			rel->reloptkind == RELOPT_BASEREL &&
-			rel->relid == root->parse->resultRelation))))
+	if (!constraint_exclusion_enabled(root, rel))
 		return false;
 
 	/*
@@ -1169,27 +1400,7 @@ relation_excluded_by_constraints(PlannerInfo *root,
 	if (rte->rtekind != RTE_RELATION || rte->inh)
 		return false;
 
-	/*
-	 * OK to fetch the constraint expressions.  Include "col IS NOT NULL"
-	 * expressions for attnotnull columns, in case we can refute those.
-	 */
-	constraint_pred = get_relation_constraints(root, rte->relid, rel, true);
-
-	/*
-	 * We do not currently enforce that CHECK constraints contain only
-	 * immutable functions, so it's necessary to check here. We daren't draw
-	 * conclusions from plan-time evaluation of non-immutable functions. Since
-	 * they're ANDed, we can just ignore any mutable constraints in the list,
-	 * and reason about the rest.
-	 */
-	safe_constraints = NIL;
-	foreach(lc, constraint_pred)
-	{
-		Node	   *pred = (Node *) lfirst(lc);
-
-		if (!contain_mutable_functions(pred))
-			safe_constraints = lappend(safe_constraints, pred);
-	}
+	safe_constraints = get_relation_safe_constraints(root, rel, rte);
 
 	/*
 	 * The constraints are effectively ANDed together, so we can just try to
@@ -1507,7 +1718,7 @@ has_unique_index(RelOptInfo *rel, AttrNumber attno)
 		 * just the specified attr is unique.
 		 */
 		if (index->unique &&
-			index->ncolumns == 1 &&
+			index->nkeycolumns == 1 &&
 			index->indexkeys[0] == attno &&
 			(index->indpred == NIL || index->predOK))
 			return true;
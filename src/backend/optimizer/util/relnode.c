@@ -19,6 +19,7 @@
 #include "optimizer/paths.h"
 #include "optimizer/placeholder.h"
 #include "optimizer/plancat.h"
+#include "optimizer/prep.h"
 #include "optimizer/restrictinfo.h"
 #include "utils/hsearch.h"
 
@@ -73,6 +74,32 @@ setup_simple_rel_arrays(PlannerInfo *root)
 
 		root->simple_rte_array[rti++] = rte;
 	}
+
+	/*
+	 * append_rel_array maps child relids to their AppendRelInfos, so that
+	 * large inheritance sets don't need a list search per child.
+	 */
+	if (root->append_rel_list == NIL)
+	{
+		root->append_rel_array = NULL;
+		return;
+	}
+
+	root->append_rel_array = (AppendRelInfo **)
+		palloc0(root->simple_rel_array_size * sizeof(AppendRelInfo *));
+	foreach(lc, root->append_rel_list)
+	{
+		AppendRelInfo *appinfo = (AppendRelInfo *) lfirst(lc);
+		Index		child_relid = appinfo->child_relid;
+
+		/* Sanity check */
+		Assert(child_relid < root->simple_rel_array_size);
+
+		if (root->append_rel_array[child_relid])
+			elog(ERROR, "child relation already exists");
+
+		root->append_rel_array[child_relid] = appinfo;
+	}
 }
 
 /*
@@ -117,6 +144,7 @@ build_simple_rel(PlannerInfo *root, int relid, RelOptKind reloptkind)
 	rel->lateral_vars = NIL;
 	rel->lateral_referencers = NULL;
 	rel->indexlist = NIL;
+	rel->statlist = NIL;
 	rel->pages = 0;
 	rel->tuples = 0;
 	rel->allvisfrac = 0;
@@ -136,8 +164,16 @@ build_simple_rel(PlannerInfo *root, int relid, RelOptKind reloptkind)
 	switch (rte->rtekind)
 	{
 		case RTE_RELATION:
-			/* Table --- retrieve statistics from the system catalogs */
-			get_relation_info(root, rte->relid, rte->inh, rel);
+
+			/*
+			 * Table --- retrieve statistics from the system catalogs.  For an
+			 * appendrel child, only set up the attr arrays for now; the rest
+			 * is fetched by set_append_rel_size if the child isn't excluded.
+			 */
+			if (reloptkind == RELOPT_OTHER_MEMBER_REL)
+				get_relation_attr_info(root, rte->relid, rel);
+			else
+				get_relation_info(root, rte->relid, rte->inh, rel);
 			break;
 		case RTE_SUBQUERY:
 		case RTE_FUNCTION:
@@ -386,6 +422,7 @@ build_join_rel(PlannerInfo *root,
 	joinrel->lateral_vars = NIL;
 	joinrel->lateral_referencers = NULL;
 	joinrel->indexlist = NIL;
+	joinrel->statlist = NIL;
 	joinrel->pages = 0;
 	joinrel->tuples = 0;
 	joinrel->allvisfrac = 0;
@@ -780,30 +817,124 @@ build_empty_join_rel(PlannerInfo *root)
 }
 
 
+/*
+ * build_child_join_rel
+ *	  Construct the RelOptInfo for the join of two appendrel children,
+ *	  outer_rel and inner_rel, as one member of an inheritance-wise join of
+ *	  their parents.
+ *
+ * Unlike build_join_rel, the targetlist isn't built from attr_needed (which
+ * is not maintained for child rels) but by translating the parent joinrel's
+ * targetlist, so that it lines up column-for-column with the parent's as
+ * Append requires.  For the same reason the restrictlist is the parent's
+ * translated to the children and returned in *restrictlist_ptr.  The new
+ * rel isn't entered in the query's joinrel list: nothing but the parent's
+ * Append path will ever refer to it.
+ */
+RelOptInfo *
+build_child_join_rel(PlannerInfo *root,
+					 RelOptInfo *parent_joinrel,
+					 RelOptInfo *outer_rel,
+					 RelOptInfo *inner_rel,
+					 AppendRelInfo *outer_appinfo,
+					 AppendRelInfo *inner_appinfo,
+					 SpecialJoinInfo *sjinfo,
+					 List *parent_restrictlist,
+					 List **restrictlist_ptr)
+{
+	RelOptInfo *joinrel;
+	List	   *restrictlist;
+
+	joinrel = makeNode(RelOptInfo);
+	joinrel->reloptkind = RELOPT_JOINREL;
+	joinrel->relids = bms_union(outer_rel->relids, inner_rel->relids);
+	joinrel->rows = 0;
+	joinrel->width = parent_joinrel->width;
+	joinrel->consider_startup = parent_joinrel->consider_startup;
+	joinrel->consider_param_startup = parent_joinrel->consider_param_startup;
+	joinrel->reltargetlist = (List *)
+		adjust_appendrel_attrs(root, (Node *) parent_joinrel->reltargetlist,
+							   outer_appinfo);
+	joinrel->reltargetlist = (List *)
+		adjust_appendrel_attrs(root, (Node *) joinrel->reltargetlist,
+							   inner_appinfo);
+	joinrel->pathlist = NIL;
+	joinrel->ppilist = NIL;
+	joinrel->cheapest_startup_path = NULL;
+	joinrel->cheapest_total_path = NULL;
+	joinrel->cheapest_unique_path = NULL;
+	joinrel->cheapest_parameterized_paths = NIL;
+	/* the caller doesn't consider lateral references */
+	joinrel->direct_lateral_relids = NULL;
+	joinrel->lateral_relids = NULL;
+	joinrel->relid = 0;			/* indicates not a baserel */
+	joinrel->rtekind = RTE_JOIN;
+	joinrel->min_attr = 0;
+	joinrel->max_attr = 0;
+	joinrel->attr_needed = NULL;
+	joinrel->attr_widths = NULL;
+	joinrel->lateral_vars = NIL;
+	joinrel->lateral_referencers = NULL;
+	joinrel->indexlist = NIL;
+	joinrel->statlist = NIL;
+	joinrel->pages = 0;
+	joinrel->tuples = 0;
+	joinrel->allvisfrac = 0;
+	joinrel->subplan = NULL;
+	joinrel->subroot = NULL;
+	joinrel->subplan_params = NIL;
+	joinrel->serverid = InvalidOid;
+	joinrel->fdwroutine = NULL;
+	joinrel->fdw_private = NULL;
+	joinrel->baserestrictinfo = NIL;
+	joinrel->baserestrictcost.startup = 0;
+	joinrel->baserestrictcost.per_tuple = 0;
+	joinrel->joininfo = NIL;
+	joinrel->has_eclass_joins = false;
+
+	/* Same foreign-join setup as in build_join_rel */
+	if (OidIsValid(outer_rel->serverid) &&
+		inner_rel->serverid == outer_rel->serverid)
+	{
+		joinrel->serverid = outer_rel->serverid;
+		joinrel->fdwroutine = outer_rel->fdwroutine;
+	}
+
+	restrictlist = (List *)
+		adjust_appendrel_attrs(root, (Node *) parent_restrictlist,
+							   outer_appinfo);
+	restrictlist = (List *)
+		adjust_appendrel_attrs(root, (Node *) restrictlist,
+							   inner_appinfo);
+	*restrictlist_ptr = restrictlist;
+
+	set_joinrel_size_estimates(root, joinrel, outer_rel, inner_rel,
+							   sjinfo, restrictlist);
+
+	return joinrel;
+}
+
+
 /*
  * find_childrel_appendrelinfo
  *		Get the AppendRelInfo associated with an appendrel child rel.
  *
- * This search could be eliminated by storing a link in child RelOptInfos,
- * but for now it doesn't seem performance-critical.  (Also, it might be
- * difficult to maintain such a link during mutation of the append_rel_list.)
+ * This is a simple lookup in root->append_rel_array, which is built by
+ * setup_simple_rel_arrays.
  */
 AppendRelInfo *
 find_childrel_appendrelinfo(PlannerInfo *root, RelOptInfo *rel)
 {
 	Index		relid = rel->relid;
-	ListCell   *lc;
 
 	/* Should only be called on child rels */
 	Assert(rel->reloptkind == RELOPT_OTHER_MEMBER_REL);
 
-	foreach(lc, root->append_rel_list)
-	{
-		AppendRelInfo *appinfo = (AppendRelInfo *) lfirst(lc);
+	if (root->append_rel_array != NULL &&
+		relid < root->simple_rel_array_size &&
+		root->append_rel_array[relid] != NULL)
+		return root->append_rel_array[relid];
 
-		if (appinfo->child_relid == relid)
-			return appinfo;
-	}
 	/* should have found the entry ... */
 	elog(ERROR, "child rel %d not found in append_rel_list", relid);
 	return NULL;				/* not reached */
@@ -24,7 +24,9 @@
 
 #include "postgres.h"
 
+#include "access/htup_details.h"
 #include "access/sysattr.h"
+#include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
@@ -40,9 +42,35 @@
 #include "parser/parse_param.h"
 #include "parser/parse_relation.h"
 #include "parser/parse_target.h"
+#include "parser/parse_type.h"
 #include "parser/parsetree.h"
 #include "rewrite/rewriteManip.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/syscache.h"
+
+
+/*
+ * Per-column state for a multi-row INSERT ... VALUES, so that the lookups
+ * needed to convert a literal to the column's type are done once per column
+ * rather than once per row; see transformInsertValue.
+ */
+typedef struct InsertValuesColumn
+{
+	bool		initialized;	/* have we looked at this column yet? */
+	bool		usable;			/* can transformInsertValue handle it? */
+	Oid			typid;			/* column's type */
+	int32		typmod;			/* column's typmod */
+	Oid			typcollation;	/* the type's collation */
+	int16		typlen;
+	bool		typbyval;
+	Oid			typioparam;
+	int32		inputtypmod;	/* typmod to pass to the input function */
+	int32		resulttypmod;	/* typmod of the converted value */
+	FmgrInfo	inputfn;		/* the type's input function */
+	FmgrInfo	lengthfn;		/* length coercion function, if needed */
+	int			lengthnargs;	/* number of arguments it takes */
+} InsertValuesColumn;
 
 
 /* Hook for plugins to get control at end of parse analysis */
@@ -51,7 +79,12 @@ post_parse_analyze_hook_type post_parse_analyze_hook = NULL;
 static Query *transformDeleteStmt(ParseState *pstate, DeleteStmt *stmt);
 static Query *transformInsertStmt(ParseState *pstate, InsertStmt *stmt);
 static List *transformInsertRow(ParseState *pstate, List *exprlist,
-				   List *stmtcols, List *icolumns, List *attrnos);
+				   List *stmtcols, List *icolumns, List *attrnos,
+				   InsertValuesColumn *vcols);
+static Expr *transformInsertValue(ParseState *pstate, Expr *expr,
+					 ResTarget *col, int attrno, InsertValuesColumn *vcol);
+static void initInsertValuesColumn(ParseState *pstate, ResTarget *col,
+					   int attrno, InsertValuesColumn *vcol);
 static OnConflictExpr *transformOnConflictClause(ParseState *pstate,
 						  OnConflictClause *onConflictClause);
 static int	count_rowexpr_columns(ParseState *pstate, Node *expr);
@@ -597,7 +630,7 @@ transformInsertStmt(ParseState *pstate, InsertStmt *stmt)
 		/* Prepare row for assignment to target table */
 		exprList = transformInsertRow(pstate, exprList,
 									  stmt->cols,
-									  icolumns, attrnos);
+									  icolumns, attrnos, NULL);
 	}
 	else if (list_length(selectStmt->valuesLists) > 1)
 	{
@@ -609,12 +642,16 @@ transformInsertStmt(ParseState *pstate, InsertStmt *stmt)
 		 */
 		List	   *exprsLists = NIL;
 		List	   *collations = NIL;
+		InsertValuesColumn *vcols;
 		int			sublist_length = -1;
 		bool		lateral = false;
 		int			i;
 
 		Assert(selectStmt->intoClause == NULL);
 
+		vcols = (InsertValuesColumn *)
+			palloc0(list_length(icolumns) * sizeof(InsertValuesColumn));
+
 		foreach(lc, selectStmt->valuesLists)
 		{
 			List	   *sublist = (List *) lfirst(lc);
@@ -644,7 +681,7 @@ transformInsertStmt(ParseState *pstate, InsertStmt *stmt)
 			/* Prepare row for assignment to target table */
 			sublist = transformInsertRow(pstate, sublist,
 										 stmt->cols,
-										 icolumns, attrnos);
+										 icolumns, attrnos, vcols);
 
 			/*
 			 * We must assign collations now because assign_query_collations
@@ -717,7 +754,7 @@ transformInsertStmt(ParseState *pstate, InsertStmt *stmt)
 		/* Prepare row for assignment to target table */
 		exprList = transformInsertRow(pstate, exprList,
 									  stmt->cols,
-									  icolumns, attrnos);
+									  icolumns, attrnos, NULL);
 	}
 
 	/*
@@ -787,16 +824,19 @@ transformInsertStmt(ParseState *pstate, InsertStmt *stmt)
  * Prepare an INSERT row for assignment to the target table.
  *
  * The row might be either a VALUES row, or variables referencing a
- * sub-SELECT output.
+ * sub-SELECT output.  For the rows of a multi-row VALUES list, vcols is an
+ * array of per-column state shared by all the rows; otherwise it's NULL.
  */
 static List *
 transformInsertRow(ParseState *pstate, List *exprlist,
-				   List *stmtcols, List *icolumns, List *attrnos)
+				   List *stmtcols, List *icolumns, List *attrnos,
+				   InsertValuesColumn *vcols)
 {
 	List	   *result;
 	ListCell   *lc;
 	ListCell   *icols;
 	ListCell   *attnos;
+	int			i;
 
 	/*
 	 * Check length of expr list.  It must not have more expressions than
@@ -842,6 +882,7 @@ transformInsertRow(ParseState *pstate, List *exprlist,
 	result = NIL;
 	icols = list_head(icolumns);
 	attnos = list_head(attrnos);
+	i = 0;
 	foreach(lc, exprlist)
 	{
 		Expr	   *expr = (Expr *) lfirst(lc);
@@ -850,22 +891,175 @@ transformInsertRow(ParseState *pstate, List *exprlist,
 		col = (ResTarget *) lfirst(icols);
 		Assert(IsA(col, ResTarget));
 
-		expr = transformAssignedExpr(pstate, expr,
-									 EXPR_KIND_INSERT_TARGET,
-									 col->name,
-									 lfirst_int(attnos),
-									 col->indirection,
-									 col->location);
+		if (vcols != NULL)
+			expr = transformInsertValue(pstate, expr, col,
+										lfirst_int(attnos), &vcols[i]);
+		else
+			expr = transformAssignedExpr(pstate, expr,
+										 EXPR_KIND_INSERT_TARGET,
+										 col->name,
+										 lfirst_int(attnos),
+										 col->indirection,
+										 col->location);
 
 		result = lappend(result, expr);
 
 		icols = lnext(icols);
 		attnos = lnext(attnos);
+		i++;
 	}
 
 	return result;
 }
 
+/*
+ * Prepare one item of a multi-row VALUES list for assignment to its column.
+ *
+ * The result is what transformAssignedExpr and the planner's constant folding
+ * would make of it, but the two commonest cases are handled cheaply: an item
+ * that already has the column's type is used as is, and an untyped literal
+ * is converted to a Const of the column's type right here, using the input
+ * and length coercion functions that were looked up for the column when the
+ * first row was processed.  That saves building, and later folding, a
+ * coercion expression for every item of a VALUES list that may have
+ * thousands of rows.  Anything else goes through transformAssignedExpr.
+ */
+static Expr *
+transformInsertValue(ParseState *pstate, Expr *expr, ResTarget *col,
+					 int attrno, InsertValuesColumn *vcol)
+{
+	Const	   *con;
+	Const	   *newcon;
+	Datum		value = (Datum) 0;
+	ParseCallbackState pcbstate;
+
+	if (!vcol->initialized)
+		initInsertValuesColumn(pstate, col, attrno, vcol);
+
+	if (vcol->usable)
+	{
+		/* no coercion needed, as in coerce_to_target_type */
+		if (exprType((Node *) expr) == vcol->typid &&
+			(vcol->typmod < 0 || exprTypmod((Node *) expr) == vcol->typmod))
+			return expr;
+
+		if (IsA(expr, Const) && exprType((Node *) expr) == UNKNOWNOID)
+		{
+			con = (Const *) expr;
+
+			/*
+			 * We assume here that UNKNOWN's internal representation is the
+			 * same as CSTRING.  Input errors are reported at the literal, as
+			 * coerce_type does; length coercion errors aren't, as they'd
+			 * otherwise come from the planner.  The length coercion function
+			 * is strict, so it needn't be called for a NULL.
+			 */
+			if (!con->constisnull)
+			{
+				setup_parser_errposition_callback(&pcbstate, pstate,
+												  con->location);
+				value = InputFunctionCall(&vcol->inputfn,
+										  DatumGetCString(con->constvalue),
+										  vcol->typioparam,
+										  vcol->inputtypmod);
+				cancel_parser_errposition_callback(&pcbstate);
+
+				if (vcol->lengthnargs == 2)
+					value = FunctionCall2Coll(&vcol->lengthfn,
+											  vcol->typcollation,
+											  value,
+											  Int32GetDatum(vcol->typmod));
+				else if (vcol->lengthnargs == 3)
+					value = FunctionCall3Coll(&vcol->lengthfn,
+											  vcol->typcollation,
+											  value,
+											  Int32GetDatum(vcol->typmod),
+											  BoolGetDatum(false));
+			}
+
+			newcon = makeConst(vcol->typid, vcol->resulttypmod,
+							   vcol->typcollation, vcol->typlen,
+							   value, con->constisnull, vcol->typbyval);
+			newcon->location = con->location;
+
+			return (Expr *) newcon;
+		}
+	}
+
+	return transformAssignedExpr(pstate, expr,
+								 EXPR_KIND_INSERT_TARGET,
+								 col->name,
+								 attrno,
+								 col->indirection,
+								 col->location);
+}
+
+/*
+ * Look up what transformInsertValue needs to know about a target column.
+ *
+ * Columns with indirection, domain columns (whose constraints must be
+ * checked by a CoerceToDomain), and columns whose length coercion isn't a
+ * plain immutable function are left to transformAssignedExpr.
+ */
+static void
+initInsertValuesColumn(ParseState *pstate, ResTarget *col, int attrno,
+					   InsertValuesColumn *vcol)
+{
+	Relation	rd = pstate->p_target_relation;
+	Type		typ;
+	Form_pg_type typeForm;
+	CoercionPathType pathtype;
+	Oid			funcId;
+
+	vcol->initialized = true;
+	vcol->usable = false;
+
+	if (col->indirection != NIL || attrno <= 0)
+		return;
+
+	vcol->typid = attnumTypeId(rd, attrno);
+	vcol->typmod = rd->rd_att->attrs[attrno - 1]->atttypmod;
+
+	typ = typeidType(vcol->typid);
+	typeForm = (Form_pg_type) GETSTRUCT(typ);
+	if (typeForm->typtype == TYPTYPE_DOMAIN ||
+		typeForm->typtype == TYPTYPE_PSEUDO)
+	{
+		ReleaseSysCache(typ);
+		return;
+	}
+	vcol->typcollation = typeForm->typcollation;
+	vcol->typlen = typeForm->typlen;
+	vcol->typbyval = typeForm->typbyval;
+	vcol->typioparam = getTypeIOParam(typ);
+	fmgr_info(typeForm->typinput, &vcol->inputfn);
+	ReleaseSysCache(typ);
+
+	/* see coerce_type for why INTERVAL's input function gets the typmod */
+	vcol->inputtypmod = (vcol->typid == INTERVALOID) ? vcol->typmod : -1;
+	vcol->resulttypmod = vcol->inputtypmod;
+	vcol->lengthnargs = 0;
+
+	if (vcol->typmod >= 0 && vcol->typmod != vcol->inputtypmod)
+	{
+		pathtype = find_typmod_coercion_function(vcol->typid, &funcId);
+		if (pathtype == COERCION_PATH_FUNC)
+		{
+			vcol->lengthnargs = get_func_nargs(funcId);
+			if (vcol->lengthnargs < 2 ||
+				func_volatile(funcId) != PROVOLATILE_IMMUTABLE ||
+				!func_strict(funcId))
+				return;
+			fmgr_info(funcId, &vcol->lengthfn);
+			vcol->resulttypmod = vcol->typmod;
+		}
+		else if (pathtype != COERCION_PATH_NONE)
+			return;
+	}
+
+	vcol->usable = true;
+}
+
 /*
  * transformSelectStmt -
  *	  transforms an OnConflictClause in an INSERT
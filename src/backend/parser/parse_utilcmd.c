@@ -1195,7 +1195,7 @@ generateClonedIndexStmt(CreateStmtContext *cxt, Relation source_idx,
 	index->indexParams = NIL;
 
 	indexpr_item = list_head(indexprs);
-	for (keyno = 0; keyno < idxrec->indnatts; keyno++)
+	for (keyno = 0; keyno < idxrec->indnkeyatts; keyno++)
 	{
 		IndexElem  *iparam;
 		AttrNumber	attnum = idxrec->indkey.values[keyno];
@@ -1282,6 +1282,29 @@ generateClonedIndexStmt(CreateStmtContext *cxt, Relation source_idx,
 		index->indexParams = lappend(index->indexParams, iparam);
 	}
 
+	/* Build the list of included columns, which are always simple columns */
+	index->indexIncludingParams = NIL;
+
+	for (keyno = idxrec->indnkeyatts; keyno < idxrec->indnatts; keyno++)
+	{
+		IndexElem  *iparam;
+		AttrNumber	attnum = idxrec->indkey.values[keyno];
+
+		Assert(AttributeNumberIsValid(attnum));
+
+		iparam = makeNode(IndexElem);
+		iparam->name = get_relid_attribute_name(indrelid, attnum);
+		iparam->expr = NULL;
+		iparam->indexcolname = pstrdup(NameStr(attrs[keyno]->attname));
+		iparam->collation = NIL;
+		iparam->opclass = NIL;
+		iparam->ordering = SORTBY_DEFAULT;
+		iparam->nulls_ordering = SORTBY_NULLS_DEFAULT;
+
+		index->indexIncludingParams = lappend(index->indexIncludingParams,
+											  iparam);
+	}
+
 	/* Copy reloptions if any */
 	datum = SysCacheGetAttr(RELOID, ht_idxrel,
 							Anum_pg_class_reloptions, &isnull);
@@ -1473,6 +1496,8 @@ transformIndexConstraints(CreateStmtContext *cxt)
 			IndexStmt  *priorindex = lfirst(k);
 
 			if (equal(index->indexParams, priorindex->indexParams) &&
+				equal(index->indexIncludingParams,
+					  priorindex->indexIncludingParams) &&
 				equal(index->whereClause, priorindex->whereClause) &&
 				equal(index->excludeOpNames, priorindex->excludeOpNames) &&
 				strcmp(index->accessMethod, priorindex->accessMethod) == 0 &&
@@ -1640,6 +1665,13 @@ transformIndexConstraint(Constraint *constraint, CreateStmtContext *cxt)
 					 errdetail("Cannot create a primary key or unique constraint using such an index."),
 					 parser_errposition(cxt->pstate, constraint->location)));
 
+		if (index_form->indnkeyatts != index_form->indnatts)
+			ereport(ERROR,
+					(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+					 errmsg("index \"%s\" has included columns", index_name),
+					 errdetail("Cannot create a primary key or unique constraint using such an index."),
+					 parser_errposition(cxt->pstate, constraint->location)));
+
 		/*
 		 * It's probably unsafe to change a deferred index to non-deferred. (A
 		 * non-constraint index couldn't be deferred anyway, so this case
@@ -66,6 +66,8 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#include "access/brin_internal.h"
+#include "access/gin.h"
 #include "access/heapam.h"
 #include "access/htup_details.h"
 #include "access/multixact.h"
@@ -77,6 +79,7 @@
 #include "catalog/pg_database.h"
 #include "commands/dbcommands.h"
 #include "commands/vacuum.h"
+#include "funcapi.h"
 #include "lib/ilist.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
@@ -98,10 +101,12 @@
 #include "utils/ps_status.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/spccache.h"
 #include "utils/syscache.h"
 #include "utils/timeout.h"
 #include "utils/timestamp.h"
 #include "utils/tqual.h"
+#include "utils/tuplestore.h"
 
 
 /*
@@ -120,6 +125,7 @@ int			autovacuum_multixact_freeze_max_age;
 
 int			autovacuum_vac_cost_delay;
 int			autovacuum_vac_cost_limit;
+int			autovacuum_parallel_workers = 0;
 
 int			Log_autovacuum_min_duration = -1;
 
@@ -181,6 +187,14 @@ typedef struct av_relation
 								 * reloptions, or NULL if none */
 } av_relation;
 
+/* struct to order the tables to vacuum and/or analyze, in 1st pass */
+typedef struct av_candidate
+{
+	Oid			ac_relid;
+	bool		ac_wraparound;	/* vacuum is forced to prevent wraparound */
+	double		ac_priority;	/* see relation_needs_vacanalyze */
+} av_candidate;
+
 /* struct to keep track of tables to vacuum and/or analyze, after rechecking */
 typedef struct autovac_table
 {
@@ -190,6 +204,9 @@ typedef struct autovac_table
 	int			at_vacuum_cost_delay;
 	int			at_vacuum_cost_limit;
 	bool		at_dobalance;
+	Oid			at_tablespace;
+	int			at_spc_cost_limit;	/* tablespace's cost limit, or -1 */
+	double		at_priority;
 	char	   *at_relname;
 	char	   *at_nspname;
 	char	   *at_datname;
@@ -206,6 +223,11 @@ typedef struct autovac_table
  * wi_proc		pointer to PGPROC of the running worker, NULL if not started
  * wi_launchtime Time at which this worker was launched
  * wi_cost_*	Vacuum cost-based delay parameters current in this worker
+ * wi_tablespace tablespace of that table
+ * wi_spc_cost_limit cost limit shared by the workers processing tables in
+ *				that tablespace, or -1 if they share the global limit
+ * wi_priority	priority with which that table was picked
+ * wi_wraparound whether that table is vacuumed to prevent wraparound
  *
  * All fields are protected by AutovacuumLock, except for wi_tableoid which is
  * protected by AutovacuumScheduleLock (which is read-only for everyone except
@@ -223,6 +245,10 @@ typedef struct WorkerInfoData
 	int			wi_cost_delay;
 	int			wi_cost_limit;
 	int			wi_cost_limit_base;
+	Oid			wi_tablespace;
+	int			wi_spc_cost_limit;
+	double		wi_priority;
+	bool		wi_wraparound;
 } WorkerInfoData;
 
 typedef struct WorkerInfoData *WorkerInfo;
@@ -239,6 +265,24 @@ typedef enum
 	AutoVacNumSignals			/* must be last */
 }	AutoVacuumSignal;
 
+/*
+ * Structure to hold a work item that some other process asked autovacuum to
+ * run, such as summarizing a BRIN page range that was just filled.  Items
+ * are processed by the next worker connected to their database, once it's
+ * done with its tables.
+ */
+typedef struct AutoVacuumWorkItem
+{
+	AutoVacuumWorkItemType avw_type;
+	bool		avw_used;		/* below data is valid */
+	bool		avw_active;		/* being processed */
+	Oid			avw_database;
+	Oid			avw_relation;
+	BlockNumber avw_blockNumber;
+} AutoVacuumWorkItem;
+
+#define NUM_WORKITEMS	256
+
 /*-------------
  * The main autovacuum shmem struct.  On shared memory we store this main
  * struct and the array of WorkerInfo structs.  This struct keeps:
@@ -249,6 +293,7 @@ typedef enum
  * av_runningWorkers the WorkerInfo non-free queue
  * av_startingWorker pointer to WorkerInfo currently being started (cleared by
  *					the worker itself as soon as it's up and running)
+ * av_workItems		work item array
  *
  * This struct is protected by AutovacuumLock, except for av_signal and parts
  * of the worker list (see above).
@@ -261,6 +306,7 @@ typedef struct
 	dlist_head	av_freeWorkers;
 	dlist_head	av_runningWorkers;
 	WorkerInfo	av_startingWorker;
+	AutoVacuumWorkItem av_workItems[NUM_WORKITEMS];
 } AutoVacuumShmemStruct;
 
 static AutoVacuumShmemStruct *AutoVacuumShmem;
@@ -304,8 +350,14 @@ static void relation_needs_vacanalyze(Oid relid, AutoVacOpts *relopts,
 						  Form_pg_class classForm,
 						  PgStat_StatTabEntry *tabentry,
 						  int effective_multixact_freeze_max_age,
-						  bool *dovacuum, bool *doanalyze, bool *wraparound);
-
+						  bool *dovacuum, bool *doanalyze, bool *wraparound,
+						  double *priority);
+static void av_add_candidate(av_candidate **candidates, int *ncandidates,
+				 int *maxcandidates, Oid relid, bool wraparound,
+				 double priority);
+static int	av_candidate_comparator(const void *a, const void *b);
+
+static void perform_work_item(AutoVacuumWorkItem *workitem);
 static void autovacuum_do_vac_analyze(autovac_table *tab,
 						  BufferAccessStrategy bstrategy);
 static AutoVacOpts *extract_autovac_opts(HeapTuple tup,
@@ -595,7 +647,8 @@ AutoVacLauncherMain(int argc, char *argv[])
 		 */
 		rc = WaitLatch(MyLatch,
 					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-					   (nap.tv_sec * 1000L) + (nap.tv_usec / 1000L));
+					   (nap.tv_sec * 1000L) + (nap.tv_usec / 1000L),
+					   WAIT_EVENT_AUTOVACUUM_MAIN);
 
 		ResetLatch(MyLatch);
 
@@ -1689,6 +1742,10 @@ FreeWorkerInfo(int code, Datum arg)
 		MyWorkerInfo->wi_cost_delay = 0;
 		MyWorkerInfo->wi_cost_limit = 0;
 		MyWorkerInfo->wi_cost_limit_base = 0;
+		MyWorkerInfo->wi_tablespace = InvalidOid;
+		MyWorkerInfo->wi_spc_cost_limit = -1;
+		MyWorkerInfo->wi_priority = 0;
+		MyWorkerInfo->wi_wraparound = false;
 		dlist_push_head(&AutoVacuumShmem->av_freeWorkers,
 						&MyWorkerInfo->wi_links);
 		/* not mine anymore */
@@ -1717,6 +1774,18 @@ AutoVacuumUpdateDelay(void)
 	}
 }
 
+/*
+ * The workers a worker shares its I/O budget with: those processing tables
+ * in the same tablespace if that has a cost limit of its own, else all the
+ * others processing tables in tablespaces without one.
+ */
+#define AV_BUDGET_GROUP(worker) \
+	((worker)->wi_spc_cost_limit > 0 ? (worker)->wi_tablespace : InvalidOid)
+
+#define AV_WORKER_BALANCES(worker) \
+	((worker)->wi_proc != NULL && (worker)->wi_dobalance && \
+	 (worker)->wi_cost_limit_base > 0 && (worker)->wi_cost_delay > 0)
+
 /*
  * autovac_balance_cost
  *		Recalculate the cost limit setting for each active worker.
@@ -1727,9 +1796,12 @@ static void
 autovac_balance_cost(void)
 {
 	/*
-	 * The idea here is that we ration out I/O equally.  The amount of I/O
-	 * that a worker can consume is determined by cost_limit/cost_delay, so we
-	 * try to equalize those ratios rather than the raw limit settings.
+	 * The idea here is that we ration out I/O equally among the workers
+	 * sharing a budget, which is autovacuum_vacuum_cost_limit except for
+	 * tablespaces having an autovacuum_vacuum_cost_limit option of their
+	 * own.  The amount of I/O that a worker can consume is determined by
+	 * cost_limit/cost_delay, so we try to equalize those ratios rather than
+	 * the raw limit settings.
 	 *
 	 * note: in cost_limit, zero also means use value from elsewhere, because
 	 * zero is not a valid value.
@@ -1738,46 +1810,48 @@ autovac_balance_cost(void)
 								autovacuum_vac_cost_limit : VacuumCostLimit);
 	int			vac_cost_delay = (autovacuum_vac_cost_delay >= 0 ?
 								autovacuum_vac_cost_delay : VacuumCostDelay);
-	double		cost_total;
-	double		cost_avail;
 	dlist_iter	iter;
 
 	/* not set? nothing to do */
 	if (vac_cost_limit <= 0 || vac_cost_delay <= 0)
 		return;
 
-	/* calculate the total base cost limit of participating active workers */
-	cost_total = 0.0;
-	dlist_foreach(iter, &AutoVacuumShmem->av_runningWorkers)
-	{
-		WorkerInfo	worker = dlist_container(WorkerInfoData, wi_links, iter.cur);
-
-		if (worker->wi_proc != NULL &&
-			worker->wi_dobalance &&
-			worker->wi_cost_limit_base > 0 && worker->wi_cost_delay > 0)
-			cost_total +=
-				(double) worker->wi_cost_limit_base / worker->wi_cost_delay;
-	}
-
-	/* there are no cost limits -- nothing to do */
-	if (cost_total <= 0)
-		return;
-
 	/*
 	 * Adjust cost limit of each active worker to balance the total of cost
-	 * limit to autovacuum_vacuum_cost_limit.
+	 * limit of the workers sharing its budget to that budget.  There are
+	 * only ever a few workers, so just look at them all for each one.
 	 */
-	cost_avail = (double) vac_cost_limit / vac_cost_delay;
 	dlist_foreach(iter, &AutoVacuumShmem->av_runningWorkers)
 	{
 		WorkerInfo	worker = dlist_container(WorkerInfoData, wi_links, iter.cur);
 
-		if (worker->wi_proc != NULL &&
-			worker->wi_dobalance &&
-			worker->wi_cost_limit_base > 0 && worker->wi_cost_delay > 0)
+		if (AV_WORKER_BALANCES(worker))
 		{
-			int			limit = (int)
-			(cost_avail * worker->wi_cost_limit_base / cost_total);
+			Oid			group = AV_BUDGET_GROUP(worker);
+			double		cost_total = 0.0;
+			double		cost_avail;
+			dlist_iter	iter2;
+			int			limit;
+
+			/* total base cost limit of the workers sharing the budget */
+			dlist_foreach(iter2, &AutoVacuumShmem->av_runningWorkers)
+			{
+				WorkerInfo	other = dlist_container(WorkerInfoData, wi_links,
+													iter2.cur);
+
+				if (AV_WORKER_BALANCES(other) &&
+					AV_BUDGET_GROUP(other) == group)
+					cost_total +=
+						(double) other->wi_cost_limit_base / other->wi_cost_delay;
+			}
+			Assert(cost_total > 0);
+
+			if (OidIsValid(group))
+				cost_avail = (double) worker->wi_spc_cost_limit / vac_cost_delay;
+			else
+				cost_avail = (double) vac_cost_limit / vac_cost_delay;
+
+			limit = (int) (cost_avail * worker->wi_cost_limit_base / cost_total);
 
 			/*
 			 * We put a lower bound of 1 on the cost_limit, to avoid division-
@@ -1791,11 +1865,12 @@ autovac_balance_cost(void)
 		}
 
 		if (worker->wi_proc != NULL)
-			elog(DEBUG2, "autovac_balance_cost(pid=%u db=%u, rel=%u, dobalance=%s cost_limit=%d, cost_limit_base=%d, cost_delay=%d)",
+			elog(DEBUG2, "autovac_balance_cost(pid=%u db=%u, rel=%u, spc=%u, dobalance=%s cost_limit=%d, cost_limit_base=%d, cost_delay=%d, spc_cost_limit=%d)",
 				 worker->wi_proc->pid, worker->wi_dboid, worker->wi_tableoid,
+				 worker->wi_tablespace,
 				 worker->wi_dobalance ? "yes" : "no",
 				 worker->wi_cost_limit, worker->wi_cost_limit_base,
-				 worker->wi_cost_delay);
+				 worker->wi_cost_delay, worker->wi_spc_cost_limit);
 	}
 }
 
@@ -1885,6 +1960,10 @@ do_autovacuum(void)
 	HeapScanDesc relScan;
 	Form_pg_database dbForm;
 	List	   *table_oids = NIL;
+	av_candidate *candidates;
+	int			ncandidates = 0;
+	int			maxcandidates = 64;
+	int			i;
 	HASHCTL		ctl;
 	HTAB	   *table_toast_map;
 	ListCell   *volatile cell;
@@ -1994,6 +2073,8 @@ do_autovacuum(void)
 	 */
 	relScan = heap_beginscan_catalog(classRel, 0, NULL);
 
+	candidates = (av_candidate *) palloc(maxcandidates * sizeof(av_candidate));
+
 	/*
 	 * On the first pass, we collect main tables to vacuum, and also the main
 	 * table relid to TOAST relid mapping.
@@ -2007,6 +2088,7 @@ do_autovacuum(void)
 		bool		dovacuum;
 		bool		doanalyze;
 		bool		wraparound;
+		double		priority;
 
 		if (classForm->relkind != RELKIND_RELATION &&
 			classForm->relkind != RELKIND_MATVIEW)
@@ -2022,7 +2104,8 @@ do_autovacuum(void)
 		/* Check if it needs vacuum or analyze */
 		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
 								  effective_multixact_freeze_max_age,
-								  &dovacuum, &doanalyze, &wraparound);
+								  &dovacuum, &doanalyze, &wraparound,
+								  &priority);
 
 		/*
 		 * Check if it is a temp table (presumably, of some other backend's).
@@ -2069,9 +2152,10 @@ do_autovacuum(void)
 		}
 		else
 		{
-			/* relations that need work are added to table_oids */
+			/* relations that need work are added to the candidates */
 			if (dovacuum || doanalyze)
-				table_oids = lappend_oid(table_oids, relid);
+				av_add_candidate(&candidates, &ncandidates, &maxcandidates,
+								 relid, wraparound, priority);
 
 			/*
 			 * Remember the association for the second pass.  Note: we must do
@@ -2121,6 +2205,7 @@ do_autovacuum(void)
 		bool		dovacuum;
 		bool		doanalyze;
 		bool		wraparound;
+		double		priority;
 
 		/*
 		 * We cannot safely process other backends' temp tables, so skip 'em.
@@ -2151,16 +2236,29 @@ do_autovacuum(void)
 
 		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
 								  effective_multixact_freeze_max_age,
-								  &dovacuum, &doanalyze, &wraparound);
+								  &dovacuum, &doanalyze, &wraparound,
+								  &priority);
 
 		/* ignore analyze for toast tables */
 		if (dovacuum)
-			table_oids = lappend_oid(table_oids, relid);
+			av_add_candidate(&candidates, &ncandidates, &maxcandidates,
+							 relid, wraparound, priority);
 	}
 
 	heap_endscan(relScan);
 	heap_close(classRel, AccessShareLock);
 
+	/*
+	 * Process the tables most urgently in need of attention first, so that
+	 * when there is more work than the workers can keep up with, it is the
+	 * least bloated and youngest tables that wait.
+	 */
+	qsort(candidates, ncandidates, sizeof(av_candidate),
+		  av_candidate_comparator);
+	for (i = 0; i < ncandidates; i++)
+		table_oids = lappend_oid(table_oids, candidates[i].ac_relid);
+	pfree(candidates);
+
 	/*
 	 * Create a buffer access strategy object for VACUUM to use.  We want to
 	 * use the same one across all the vacuum operations we perform, since the
@@ -2289,6 +2387,12 @@ do_autovacuum(void)
 		MyWorkerInfo->wi_cost_delay = tab->at_vacuum_cost_delay;
 		MyWorkerInfo->wi_cost_limit = tab->at_vacuum_cost_limit;
 		MyWorkerInfo->wi_cost_limit_base = tab->at_vacuum_cost_limit;
+		MyWorkerInfo->wi_tablespace = tab->at_tablespace;
+		MyWorkerInfo->wi_spc_cost_limit = tab->at_spc_cost_limit;
+
+		/* and why this table was chosen, for pg_stat_autovacuum */
+		MyWorkerInfo->wi_priority = tab->at_priority;
+		MyWorkerInfo->wi_wraparound = tab->at_params.is_wraparound;
 
 		/* do a balance */
 		autovac_balance_cost();
@@ -2375,13 +2479,15 @@ deleted:
 
 		/*
 		 * Remove my info from shared memory.  We could, but intentionally
-		 * don't, clear wi_cost_limit and friends --- this is on the
-		 * assumption that we probably have more to do with similar cost
-		 * settings, so we don't want to give up our share of I/O for a very
-		 * short interval and thereby thrash the global balance.
+		 * don't, clear wi_cost_limit and friends (wi_tablespace included)
+		 * --- this is on the assumption that we probably have more to do with
+		 * similar cost settings, so we don't want to give up our share of I/O
+		 * for a very short interval and thereby thrash the global balance.
 		 */
 		LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
 		MyWorkerInfo->wi_tableoid = InvalidOid;
+		MyWorkerInfo->wi_priority = 0;
+		MyWorkerInfo->wi_wraparound = false;
 		LWLockRelease(AutovacuumLock);
 
 		/* restore vacuum cost GUCs for the next iteration */
@@ -2389,6 +2495,47 @@ deleted:
 		VacuumCostLimit = stdVacuumCostLimit;
 	}
 
+	/*
+	 * Perform the work items that other processes have requested in this
+	 * database.  Each item is marked active while we work on it, so that a
+	 * concurrent worker in the same database doesn't pick it up too.
+	 */
+	LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
+	for (i = 0; i < NUM_WORKITEMS; i++)
+	{
+		AutoVacuumWorkItem *workitem = &AutoVacuumShmem->av_workItems[i];
+
+		if (!workitem->avw_used)
+			continue;
+		if (workitem->avw_active)
+			continue;
+		if (workitem->avw_database != MyDatabaseId)
+			continue;
+
+		/* claim this one, and release lock while performing it */
+		workitem->avw_active = true;
+		LWLockRelease(AutovacuumLock);
+
+		perform_work_item(workitem);
+
+		/*
+		 * Check for config changes before acquiring lock for further jobs.
+		 */
+		CHECK_FOR_INTERRUPTS();
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
+
+		/* and mark it done */
+		workitem->avw_active = false;
+		workitem->avw_used = false;
+	}
+	LWLockRelease(AutovacuumLock);
+
 	/*
 	 * We leak table_toast_map here (among other things), but since we're
 	 * going away soon, it's not a problem.
@@ -2404,6 +2551,112 @@ deleted:
 	CommitTransactionCommand();
 }
 
+/*
+ * Execute a previously registered work item.
+ */
+static void
+perform_work_item(AutoVacuumWorkItem *workitem)
+{
+	char	   *cur_datname = NULL;
+	char	   *cur_nspname = NULL;
+	char	   *cur_relname = NULL;
+
+	/*
+	 * Note we do not store table info in MyWorkerInfo, since this is not
+	 * vacuuming proper.
+	 */
+
+	/*
+	 * Save the relation name for a possible error message, to avoid a
+	 * catalog lookup in case of an error.  If any of these return NULL, then
+	 * the relation has been dropped since the item was requested; skip it.
+	 */
+	MemoryContextSwitchTo(AutovacMemCxt);
+
+	cur_relname = get_rel_name(workitem->avw_relation);
+	cur_nspname = get_namespace_name(get_rel_namespace(workitem->avw_relation));
+	cur_datname = get_database_name(MyDatabaseId);
+	if (!cur_relname || !cur_nspname || !cur_datname)
+		goto deleted;
+
+	/* clean up memory before each work item */
+	MemoryContextResetAndDeleteChildren(PortalContext);
+
+	/*
+	 * We will abort the current work item if something errors out, and
+	 * continue with the next one; in particular, this happens if we are
+	 * interrupted with SIGINT.  Note that this means that the work item list
+	 * can be lossy.
+	 */
+	PG_TRY();
+	{
+		/* have at it */
+		MemoryContextSwitchTo(TopTransactionContext);
+
+		switch (workitem->avw_type)
+		{
+			case AVW_BRINSummarizeRange:
+				pgstat_report_activity(STATE_RUNNING,
+									   "autovacuum: BRIN summarize");
+				DirectFunctionCall2(brin_summarize_range,
+									ObjectIdGetDatum(workitem->avw_relation),
+							Int64GetDatum((int64) workitem->avw_blockNumber));
+				break;
+			case AVW_GINCleanPendingList:
+				pgstat_report_activity(STATE_RUNNING,
+									   "autovacuum: GIN pending list cleanup");
+				DirectFunctionCall1(gin_clean_pending_list,
+									ObjectIdGetDatum(workitem->avw_relation));
+				break;
+			default:
+				elog(WARNING, "unrecognized work item found: type %d",
+					 workitem->avw_type);
+				break;
+		}
+
+		/*
+		 * Clear a possible query-cancel signal, to avoid a late reaction to
+		 * an automatically-sent signal because of working on this item
+		 * (we're done with it, so it would make no sense to cancel at this
+		 * point.)
+		 */
+		QueryCancelPending = false;
+	}
+	PG_CATCH();
+	{
+		/*
+		 * Abort the transaction, start a new one, and proceed with the next
+		 * work item.
+		 */
+		HOLD_INTERRUPTS();
+		errcontext("processing work entry for relation \"%s.%s.%s\"",
+				   cur_datname, cur_nspname, cur_relname);
+		EmitErrorReport();
+
+		/* this resets the PGXACT flags too */
+		AbortOutOfAnyTransaction();
+		FlushErrorState();
+		MemoryContextResetAndDeleteChildren(PortalContext);
+
+		/* restart our transaction for the following operations */
+		StartTransactionCommand();
+		RESUME_INTERRUPTS();
+	}
+	PG_END_TRY();
+
+	/* Make sure we're back in AutovacMemCxt */
+	MemoryContextSwitchTo(AutovacMemCxt);
+
+	/* be tidy */
+deleted:
+	if (cur_datname)
+		pfree(cur_datname);
+	if (cur_nspname)
+		pfree(cur_nspname);
+	if (cur_relname)
+		pfree(cur_relname);
+}
+
 /*
  * extract_autovac_opts
  *
@@ -2477,6 +2730,7 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 	PgStat_StatDBEntry *shared;
 	PgStat_StatDBEntry *dbentry;
 	bool		wraparound;
+	double		priority;
 	AutoVacOpts *avopts;
 
 	/* use fresh stats */
@@ -2513,7 +2767,7 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 
 	relation_needs_vacanalyze(relid, avopts, classForm, tabentry,
 							  effective_multixact_freeze_max_age,
-							  &dovacuum, &doanalyze, &wraparound);
+							  &dovacuum, &doanalyze, &wraparound, &priority);
 
 	/* ignore ANALYZE for toast tables */
 	if (classForm->relkind == RELKIND_TOASTVALUE)
@@ -2587,8 +2841,15 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 		tab->at_params.multixact_freeze_table_age = multixact_freeze_table_age;
 		tab->at_params.is_wraparound = wraparound;
 		tab->at_params.log_min_duration = log_min_duration;
+		tab->at_params.nworkers = autovacuum_parallel_workers;
 		tab->at_vacuum_cost_limit = vac_cost_limit;
 		tab->at_vacuum_cost_delay = vac_cost_delay;
+		tab->at_tablespace = OidIsValid(classForm->reltablespace)
+			? classForm->reltablespace
+			: MyDatabaseTableSpace;
+		tab->at_spc_cost_limit =
+			get_tablespace_autovac_cost_limit(tab->at_tablespace);
+		tab->at_priority = priority;
 		tab->at_relname = NULL;
 		tab->at_nspname = NULL;
 		tab->at_datname = NULL;
@@ -2643,6 +2904,14 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
  * autovacuum_vacuum_threshold GUC variable.  Similarly, a vac_scale_factor
  * value < 0 is substituted with the value of
  * autovacuum_vacuum_scale_factor GUC variable.  Ditto for analyze.
+ *
+ * "priority" says how urgently the table needs attention, to order the
+ * tables processed by a worker.  It is the sum of how far the dead (resp.
+ * changed) tuples are past their threshold, as a fraction of it; of that
+ * fraction per hour since the table was last vacuumed, so that tables
+ * bloating fast come before those that took long to get there; and of the
+ * table's Xid or multixact age as a fraction of its freeze_max_age, so that
+ * old tables catch up before they need an anti-wraparound vacuum.
  */
 static void
 relation_needs_vacanalyze(Oid relid,
@@ -2653,7 +2922,8 @@ relation_needs_vacanalyze(Oid relid,
  /* output params below */
 						  bool *dovacuum,
 						  bool *doanalyze,
-						  bool *wraparound)
+						  bool *wraparound,
+						  double *priority)
 {
 	bool		force_vacuum;
 	bool		av_enabled;
@@ -2679,6 +2949,9 @@ relation_needs_vacanalyze(Oid relid,
 	TransactionId xidForceLimit;
 	MultiXactId multiForceLimit;
 
+	/* how old the table is, as a fraction of the freeze parameters */
+	double		age_frac = 0.0;
+
 	AssertArg(classForm != NULL);
 	AssertArg(OidIsValid(relid));
 
@@ -2732,6 +3005,16 @@ relation_needs_vacanalyze(Oid relid,
 	}
 	*wraparound = force_vacuum;
 
+	if (TransactionIdIsNormal(classForm->relfrozenxid) && freeze_max_age > 0)
+		age_frac = (double) (int32) (recentXid - classForm->relfrozenxid) /
+			freeze_max_age;
+	if (MultiXactIdIsValid(classForm->relminmxid) &&
+		multixact_freeze_max_age > 0)
+		age_frac = Max(age_frac,
+					   (double) (int32) (recentMulti - classForm->relminmxid) /
+					   multixact_freeze_max_age);
+	*priority = Max(age_frac, 0.0);
+
 	/* User disabled it in pg_class.reloptions?  (But ignore if at risk) */
 	if (!av_enabled && !force_vacuum)
 	{
@@ -2768,6 +3051,26 @@ relation_needs_vacanalyze(Oid relid,
 		/* Determine if this table needs vacuum or analyze. */
 		*dovacuum = force_vacuum || (vactuples > vacthresh);
 		*doanalyze = (anltuples > anlthresh);
+
+		if (*dovacuum || *doanalyze)
+		{
+			double		dead_frac = vactuples / Max(vacthresh, 1.0);
+			double		anl_frac = anltuples / Max(anlthresh, 1.0);
+			TimestampTz last_vacuum = Max(tabentry->vacuum_timestamp,
+										  tabentry->autovac_vacuum_timestamp);
+
+			*priority += Max(dead_frac, anl_frac);
+
+			if (last_vacuum != 0)
+			{
+				long		secs;
+				int			usecs;
+
+				TimestampDifference(last_vacuum, GetCurrentTimestamp(),
+									&secs, &usecs);
+				*priority += dead_frac / Max(secs / 3600.0, 1.0);
+			}
+		}
 	}
 	else
 	{
@@ -2785,6 +3088,54 @@ relation_needs_vacanalyze(Oid relid,
 		*doanalyze = false;
 }
 
+/*
+ * av_add_candidate
+ *		Add a table to the array of those do_autovacuum is to process,
+ *		enlarging it as needed.
+ */
+static void
+av_add_candidate(av_candidate **candidates, int *ncandidates,
+				 int *maxcandidates, Oid relid, bool wraparound,
+				 double priority)
+{
+	av_candidate *cand;
+
+	if (*ncandidates >= *maxcandidates)
+	{
+		*maxcandidates *= 2;
+		*candidates = (av_candidate *)
+			repalloc(*candidates, *maxcandidates * sizeof(av_candidate));
+	}
+
+	cand = &(*candidates)[(*ncandidates)++];
+	cand->ac_relid = relid;
+	cand->ac_wraparound = wraparound;
+	cand->ac_priority = priority;
+}
+
+/*
+ * qsort comparator for av_candidate: anti-wraparound vacuums first, then by
+ * descending priority.  Ties are broken by OID to keep the order stable.
+ */
+static int
+av_candidate_comparator(const void *a, const void *b)
+{
+	const av_candidate *ca = (const av_candidate *) a;
+	const av_candidate *cb = (const av_candidate *) b;
+
+	if (ca->ac_wraparound != cb->ac_wraparound)
+		return ca->ac_wraparound ? -1 : 1;
+	if (ca->ac_priority > cb->ac_priority)
+		return -1;
+	if (ca->ac_priority < cb->ac_priority)
+		return 1;
+	if (ca->ac_relid < cb->ac_relid)
+		return -1;
+	if (ca->ac_relid > cb->ac_relid)
+		return 1;
+	return 0;
+}
+
 /*
  * autovacuum_do_vac_analyze
  *		Vacuum and/or analyze the specified table
@@ -2896,6 +3247,69 @@ IsAutoVacuumWorkerProcess(void)
 }
 
 
+/*
+ * AutoVacuumRequestWork
+ *		Request a work item to the next autovacuum run processing our database.
+ *
+ * Returns false if the request could not be recorded because the work item
+ * array is full; the caller may then simply leave things for the next vacuum.
+ * A request identical to one that is still waiting to be processed is
+ * taken as already recorded.
+ */
+bool
+AutoVacuumRequestWork(AutoVacuumWorkItemType type, Oid relationId,
+					  BlockNumber blkno)
+{
+	int			i;
+	bool		result = false;
+
+	LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
+
+	/*
+	 * Look for an equal pending request first.
+	 */
+	for (i = 0; i < NUM_WORKITEMS; i++)
+	{
+		AutoVacuumWorkItem *workitem = &AutoVacuumShmem->av_workItems[i];
+
+		if (workitem->avw_used && !workitem->avw_active &&
+			workitem->avw_type == type &&
+			workitem->avw_database == MyDatabaseId &&
+			workitem->avw_relation == relationId &&
+			workitem->avw_blockNumber == blkno)
+		{
+			LWLockRelease(AutovacuumLock);
+			return true;
+		}
+	}
+
+	/*
+	 * Locate an unused work item and fill it with the given data.
+	 */
+	for (i = 0; i < NUM_WORKITEMS; i++)
+	{
+		AutoVacuumWorkItem *workitem = &AutoVacuumShmem->av_workItems[i];
+
+		if (workitem->avw_used)
+			continue;
+
+		workitem->avw_used = true;
+		workitem->avw_active = false;
+		workitem->avw_type = type;
+		workitem->avw_database = MyDatabaseId;
+		workitem->avw_relation = relationId;
+		workitem->avw_blockNumber = blkno;
+		result = true;
+
+		/* done */
+		break;
+	}
+
+	LWLockRelease(AutovacuumLock);
+
+	return result;
+}
+
 /*
  * AutoVacuumShmemSize
  *		Compute space needed for autovacuum-related shared memory
@@ -2940,6 +3354,8 @@ AutoVacuumShmemInit(void)
 		dlist_init(&AutoVacuumShmem->av_freeWorkers);
 		dlist_init(&AutoVacuumShmem->av_runningWorkers);
 		AutoVacuumShmem->av_startingWorker = NULL;
+		memset(AutoVacuumShmem->av_workItems, 0,
+			   sizeof(AutoVacuumWorkItem) * NUM_WORKITEMS);
 
 		worker = (WorkerInfo) ((char *) AutoVacuumShmem +
 							   MAXALIGN(sizeof(AutoVacuumShmemStruct)));
@@ -2984,3 +3400,89 @@ autovac_refresh_stats(void)
 
 	pgstat_clear_snapshot();
 }
+
+/*
+ * Returns the tables the autovacuum workers are currently processing, why
+ * they were chosen, and the cost limits they have been given.
+ */
+Datum
+pg_stat_get_autovacuum_workers(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_AUTOVACUUM_WORKERS_COLS	10
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	dlist_iter	iter;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(AutovacuumLock, LW_SHARED);
+
+	dlist_foreach(iter, &AutoVacuumShmem->av_runningWorkers)
+	{
+		WorkerInfo	worker = dlist_container(WorkerInfoData, wi_links, iter.cur);
+		Datum		values[PG_STAT_GET_AUTOVACUUM_WORKERS_COLS];
+		bool		nulls[PG_STAT_GET_AUTOVACUUM_WORKERS_COLS];
+
+		if (worker->wi_proc == NULL)
+			continue;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, 0, sizeof(nulls));
+
+		values[0] = Int32GetDatum(worker->wi_proc->pid);
+		values[1] = ObjectIdGetDatum(worker->wi_dboid);
+
+		/* the rest is only meaningful while a table is being processed */
+		if (OidIsValid(worker->wi_tableoid))
+		{
+			values[2] = ObjectIdGetDatum(worker->wi_tableoid);
+			values[3] = ObjectIdGetDatum(worker->wi_tablespace);
+			values[4] = Float8GetDatum(worker->wi_priority);
+			values[5] = BoolGetDatum(worker->wi_wraparound);
+			values[6] = Int32GetDatum(worker->wi_cost_limit);
+			values[7] = Int32GetDatum(worker->wi_cost_limit_base);
+			values[8] = Int32GetDatum(worker->wi_cost_delay);
+			if (worker->wi_spc_cost_limit > 0)
+				values[9] = Int32GetDatum(worker->wi_spc_cost_limit);
+			else
+				nulls[9] = true;
+		}
+		else
+			memset(&nulls[2], true, sizeof(nulls) - 2 * sizeof(bool));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	LWLockRelease(AutovacuumLock);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
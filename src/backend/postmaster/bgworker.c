@@ -16,6 +16,7 @@
 
 #include "miscadmin.h"
 #include "libpq/pqsignal.h"
+#include "pgstat.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/postmaster.h"
 #include "storage/barrier.h"
@@ -745,7 +746,13 @@ RegisterBackgroundWorker(BackgroundWorker *worker)
 		ereport(DEBUG1,
 		 (errmsg("registering background worker \"%s\"", worker->bgw_name)));
 
-	if (!process_shared_preload_libraries_in_progress)
+	/*
+	 * Workers built into the server are registered by the postmaster itself,
+	 * right after the preloaded libraries.
+	 */
+	if (!process_shared_preload_libraries_in_progress &&
+		!(!IsUnderPostmaster &&
+		  strcmp(worker->bgw_library_name, "postgres") == 0))
 	{
 		if (!IsUnderPostmaster)
 			ereport(LOG,
@@ -975,7 +982,8 @@ WaitForBackgroundWorkerStartup(BackgroundWorkerHandle *handle, pid_t *pidp)
 				break;
 
 			rc = WaitLatch(MyLatch,
-						   WL_LATCH_SET | WL_POSTMASTER_DEATH, 0);
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH, 0,
+						   WAIT_EVENT_BGWORKER_STARTUP);
 
 			if (rc & WL_POSTMASTER_DEATH)
 			{
@@ -1028,7 +1036,8 @@ WaitForBackgroundWorkerShutdown(BackgroundWorkerHandle *handle)
 				return status;
 
 			rc = WaitLatch(&MyProc->procLatch,
-						   WL_LATCH_SET | WL_POSTMASTER_DEATH, 0);
+						   WL_LATCH_SET | WL_POSTMASTER_DEATH, 0,
+						   WAIT_EVENT_BGWORKER_SHUTDOWN);
 
 			if (rc & WL_POSTMASTER_DEATH)
 				return BGWH_POSTMASTER_DIED;
@@ -41,6 +41,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "access/hash.h"
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
 #include "libpq/pqsignal.h"
@@ -99,7 +100,13 @@
  * because the checkpointer failed to absorb their request.
  *
  * The requests array holds fsync requests sent by backends and not yet
- * absorbed by the checkpointer.
+ * absorbed by the checkpointer.  Backends write the same segments over and
+ * over, so most requests are for a segment already in the array.  To find
+ * those quickly, the array is indexed by an open-addressing hash table of
+ * requests[] slots, which follows the array (see CheckpointerRequestHash).
+ * Emptying the array must empty the hash table too, and to do that without
+ * touching all of it, an entry is only valid if its generation equals
+ * request_generation, which is advanced instead.
  *
  * Unlike the checkpoint fields, num_backend_writes, num_backend_fsync, and
  * the requests fields are protected by CheckpointerCommLock.
@@ -113,6 +120,12 @@ typedef struct
 	/* might add a real request-type field later; not needed yet */
 } CheckpointerRequest;
 
+typedef struct
+{
+	uint32		generation;		/* valid if equal to request_generation */
+	int			slot;			/* index of the request in requests[] */
+} CheckpointerRequestHashEntry;
+
 typedef struct
 {
 	pid_t		checkpointer_pid;		/* PID (0 if not started) */
@@ -130,11 +143,23 @@ typedef struct
 
 	int			num_requests;	/* current # of requests */
 	int			max_requests;	/* allocated array size */
+	uint32		request_generation;		/* see above */
+	uint32		request_hash_mask;	/* hash table size - 1 */
 	CheckpointerRequest requests[FLEXIBLE_ARRAY_MEMBER];
 } CheckpointerShmemStruct;
 
 static CheckpointerShmemStruct *CheckpointerShmem;
 
+/* The hash table of requests, right after requests[] */
+static CheckpointerRequestHashEntry *CheckpointerRequestHash;
+
+/*
+ * md.c uses segment numbers beyond any real one for requests to forget
+ * earlier requests, and the like.  A request following one of those mustn't
+ * be merged with an identical one preceding it.
+ */
+#define MAX_REAL_SEGNO		(MaxBlockNumber / RELSEG_SIZE)
+
 /* interval for calling AbsorbFsyncRequests in CheckpointWriteDelay */
 #define WRITES_PER_ABSORB		1000
 
@@ -170,7 +195,8 @@ static pg_time_t last_xlog_switch_time;
 static void CheckArchiveTimeout(void);
 static bool IsCheckpointOnSchedule(double progress);
 static bool ImmediateCheckpointRequested(void);
-static bool CompactCheckpointerRequestQueue(void);
+static uint32 CheckpointerRequestHashSize(void);
+static void NextCheckpointerRequestGeneration(void);
 static void UpdateSharedMemoryConfig(void);
 
 /* Signal handlers */
@@ -273,6 +299,7 @@ CheckpointerMain(void)
 		 * files.
 		 */
 		LWLockReleaseAll();
+		pgstat_report_wait_end();
 		AbortBufferIO();
 		UnlockBuffers();
 		/* buffer pins are released here: */
@@ -400,6 +427,9 @@ CheckpointerMain(void)
 			ExitOnAnyError = true;
 			/* Close down the database */
 			ShutdownXLOG(0, 0);
+			/* Save the statistics, including those of the last checkpoint */
+			pgstat_send_bgwriter();
+			pgstat_write_statsfile();
 			/* Normal exit from the checkpointer is here */
 			proc_exit(0);		/* done */
 		}
@@ -563,7 +593,8 @@ CheckpointerMain(void)
 
 		rc = WaitLatch(MyLatch,
 					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-					   cur_timeout * 1000L /* convert to ms */ );
+					   cur_timeout * 1000L /* convert to ms */,
+					   WAIT_EVENT_CHECKPOINTER_MAIN);
 
 		/*
 		 * Emergency bailout if postmaster has died.  This is to avoid the
@@ -905,7 +936,25 @@ CheckpointerShmemSize(void)
 	 */
 	size = offsetof(CheckpointerShmemStruct, requests);
 	size = add_size(size, mul_size(NBuffers, sizeof(CheckpointerRequest)));
+	size = add_size(size, mul_size(CheckpointerRequestHashSize(),
+								   sizeof(CheckpointerRequestHashEntry)));
+
+	return size;
+}
 
+/*
+ * CheckpointerRequestHashSize
+ *		Number of entries in the hash table of requests
+ *
+ * A power of 2, so that it's at most half full.
+ */
+static uint32
+CheckpointerRequestHashSize(void)
+{
+	uint32		size = 1;
+
+	while (size < (uint32) NBuffers * 2)
+		size <<= 1;
 	return size;
 }
 
@@ -927,13 +976,40 @@ CheckpointerShmemInit(void)
 	if (!found)
 	{
 		/*
-		 * First time through, so initialize.  Note that we zero the whole
-		 * requests array; this is so that CompactCheckpointerRequestQueue can
-		 * assume that any pad bytes in the request structs are zeroes.
+		 * First time through, so initialize.  Zeroing the whole thing also
+		 * marks all the entries of the hash table of requests unused.
 		 */
 		MemSet(CheckpointerShmem, 0, size);
 		SpinLockInit(&CheckpointerShmem->ckpt_lck);
 		CheckpointerShmem->max_requests = NBuffers;
+		CheckpointerShmem->request_generation = 1;
+		CheckpointerShmem->request_hash_mask =
+			CheckpointerRequestHashSize() - 1;
+	}
+
+	CheckpointerRequestHash = (CheckpointerRequestHashEntry *)
+		&CheckpointerShmem->requests[CheckpointerShmem->max_requests];
+}
+
+/*
+ * NextCheckpointerRequestGeneration
+ *		Invalidate all the entries of the hash table of requests
+ *
+ * Caller must hold CheckpointerCommLock in exclusive mode.
+ */
+static void
+NextCheckpointerRequestGeneration(void)
+{
+	/*
+	 * Zero means never used, so if we get there, really clear the table.
+	 * That happens after four billion absorbs at the least.
+	 */
+	if (++CheckpointerShmem->request_generation == 0)
+	{
+		MemSet(CheckpointerRequestHash, 0,
+			   (CheckpointerShmem->request_hash_mask + 1) *
+			   sizeof(CheckpointerRequestHashEntry));
+		CheckpointerShmem->request_generation = 1;
 	}
 }
 
@@ -1102,20 +1178,19 @@ RequestCheckpoint(int flags)
  * use high values for special flags; that's all internal to md.c, which
  * see for details.)
  *
- * To avoid holding the lock for longer than necessary, we normally write
- * to the requests[] queue without checking for duplicates.  The checkpointer
- * will have to eliminate dups internally anyway.  However, if we discover
- * that the queue is full, we make a pass over the entire queue to compact
- * it.  This is somewhat expensive, but the alternative is for the backend
- * to perform its own fsync, which is far more expensive in practice.  It
- * is theoretically possible a backend fsync might still be necessary, if
- * the queue is full and contains no duplicate entries.  In that case, we
- * let the backend know by returning false.
+ * A request that is already in the requests[] queue isn't added again;
+ * the hash table finds it in about one probe.  So the queue only fills up
+ * if more distinct segments than there are shared buffers are written
+ * between two absorbs by the checkpointer.  If it does, the backend has to
+ * perform its own fsync, and we let it know by returning false.
  */
 bool
 ForwardFsyncRequest(RelFileNode rnode, ForkNumber forknum, BlockNumber segno)
 {
 	CheckpointerRequest *request;
+	CheckpointerRequest newreq;
+	CheckpointerRequestHashEntry *entry = NULL;
+	uint32		generation;
 	bool		too_full;
 
 	if (!IsUnderPostmaster)
@@ -1130,14 +1205,48 @@ ForwardFsyncRequest(RelFileNode rnode, ForkNumber forknum, BlockNumber segno)
 	if (!AmBackgroundWriterProcess())
 		CheckpointerShmem->num_backend_writes++;
 
+	/*
+	 * If the same request is already queued, there's nothing to do.  Special
+	 * requests are never merged, and they start a new generation of the
+	 * hash table, so that no request is merged with one preceding them.
+	 *
+	 * We use the request struct directly as a hashtable key.  Note that
+	 * RelFileNode had better contain no pad bytes.
+	 */
+	MemSet(&newreq, 0, sizeof(newreq));
+	newreq.rnode = rnode;
+	newreq.forknum = forknum;
+	newreq.segno = segno;
+
+	generation = CheckpointerShmem->request_generation;
+	if (segno <= MAX_REAL_SEGNO && CheckpointerShmem->checkpointer_pid != 0)
+	{
+		uint32		mask = CheckpointerShmem->request_hash_mask;
+		uint32		i;
+
+		i = DatumGetUInt32(hash_any((unsigned char *) &newreq,
+									sizeof(newreq))) & mask;
+		for (;;)
+		{
+			entry = &CheckpointerRequestHash[i];
+			if (entry->generation != generation)
+				break;			/* not there; remember where it goes */
+			if (memcmp(&CheckpointerShmem->requests[entry->slot], &newreq,
+					   sizeof(newreq)) == 0)
+			{
+				LWLockRelease(CheckpointerCommLock);
+				return true;
+			}
+			i = (i + 1) & mask;
+		}
+	}
+
 	/*
 	 * If the checkpointer isn't running or the request queue is full, the
-	 * backend will have to perform its own fsync request.  But before forcing
-	 * that to happen, we can try to compact the request queue.
+	 * backend will have to perform its own fsync request.
 	 */
 	if (CheckpointerShmem->checkpointer_pid == 0 ||
-		(CheckpointerShmem->num_requests >= CheckpointerShmem->max_requests &&
-		 !CompactCheckpointerRequestQueue()))
+		CheckpointerShmem->num_requests >= CheckpointerShmem->max_requests)
 	{
 		/*
 		 * Count the subset of writes where backends have to do their own
@@ -1150,10 +1259,15 @@ ForwardFsyncRequest(RelFileNode rnode, ForkNumber forknum, BlockNumber segno)
 	}
 
 	/* OK, insert request */
+	if (entry != NULL)
+	{
+		entry->generation = generation;
+		entry->slot = CheckpointerShmem->num_requests;
+	}
+	else if (segno > MAX_REAL_SEGNO)
+		NextCheckpointerRequestGeneration();
 	request = &CheckpointerShmem->requests[CheckpointerShmem->num_requests++];
-	request->rnode = rnode;
-	request->forknum = forknum;
-	request->segno = segno;
+	*request = newreq;
 
 	/* If queue is more than half full, nudge the checkpointer to empty it */
 	too_full = (CheckpointerShmem->num_requests >=
@@ -1168,121 +1282,6 @@ ForwardFsyncRequest(RelFileNode rnode, ForkNumber forknum, BlockNumber segno)
 	return true;
 }
 
-/*
- * CompactCheckpointerRequestQueue
- *		Remove duplicates from the request queue to avoid backend fsyncs.
- *		Returns "true" if any entries were removed.
- *
- * Although a full fsync request queue is not common, it can lead to severe
- * performance problems when it does happen.  So far, this situation has
- * only been observed to occur when the system is under heavy write load,
- * and especially during the "sync" phase of a checkpoint.  Without this
- * logic, each backend begins doing an fsync for every block written, which
- * gets very expensive and can slow down the whole system.
- *
- * Trying to do this every time the queue is full could lose if there
- * aren't any removable entries.  But that should be vanishingly rare in
- * practice: there's one queue entry per shared buffer.
- */
-static bool
-CompactCheckpointerRequestQueue(void)
-{
-	struct CheckpointerSlotMapping
-	{
-		CheckpointerRequest request;
-		int			slot;
-	};
-
-	int			n,
-				preserve_count;
-	int			num_skipped = 0;
-	HASHCTL		ctl;
-	HTAB	   *htab;
-	bool	   *skip_slot;
-
-	/* must hold CheckpointerCommLock in exclusive mode */
-	Assert(LWLockHeldByMe(CheckpointerCommLock));
-
-	/* Initialize skip_slot array */
-	skip_slot = palloc0(sizeof(bool) * CheckpointerShmem->num_requests);
-
-	/* Initialize temporary hash table */
-	MemSet(&ctl, 0, sizeof(ctl));
-	ctl.keysize = sizeof(CheckpointerRequest);
-	ctl.entrysize = sizeof(struct CheckpointerSlotMapping);
-	ctl.hcxt = CurrentMemoryContext;
-
-	htab = hash_create("CompactCheckpointerRequestQueue",
-					   CheckpointerShmem->num_requests,
-					   &ctl,
-					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-	/*
-	 * The basic idea here is that a request can be skipped if it's followed
-	 * by a later, identical request.  It might seem more sensible to work
-	 * backwards from the end of the queue and check whether a request is
-	 * *preceded* by an earlier, identical request, in the hopes of doing less
-	 * copying.  But that might change the semantics, if there's an
-	 * intervening FORGET_RELATION_FSYNC or FORGET_DATABASE_FSYNC request, so
-	 * we do it this way.  It would be possible to be even smarter if we made
-	 * the code below understand the specific semantics of such requests (it
-	 * could blow away preceding entries that would end up being canceled
-	 * anyhow), but it's not clear that the extra complexity would buy us
-	 * anything.
-	 */
-	for (n = 0; n < CheckpointerShmem->num_requests; n++)
-	{
-		CheckpointerRequest *request;
-		struct CheckpointerSlotMapping *slotmap;
-		bool		found;
-
-		/*
-		 * We use the request struct directly as a hashtable key.  This
-		 * assumes that any padding bytes in the structs are consistently the
-		 * same, which should be okay because we zeroed them in
-		 * CheckpointerShmemInit.  Note also that RelFileNode had better
-		 * contain no pad bytes.
-		 */
-		request = &CheckpointerShmem->requests[n];
-		slotmap = hash_search(htab, request, HASH_ENTER, &found);
-		if (found)
-		{
-			/* Duplicate, so mark the previous occurrence as skippable */
-			skip_slot[slotmap->slot] = true;
-			num_skipped++;
-		}
-		/* Remember slot containing latest occurrence of this request value */
-		slotmap->slot = n;
-	}
-
-	/* Done with the hash table. */
-	hash_destroy(htab);
-
-	/* If no duplicates, we're out of luck. */
-	if (!num_skipped)
-	{
-		pfree(skip_slot);
-		return false;
-	}
-
-	/* We found some duplicates; remove them. */
-	preserve_count = 0;
-	for (n = 0; n < CheckpointerShmem->num_requests; n++)
-	{
-		if (skip_slot[n])
-			continue;
-		CheckpointerShmem->requests[preserve_count++] = CheckpointerShmem->requests[n];
-	}
-	ereport(DEBUG1,
-	   (errmsg("compacted fsync request queue from %d entries to %d entries",
-			   CheckpointerShmem->num_requests, preserve_count)));
-	CheckpointerShmem->num_requests = preserve_count;
-
-	/* Cleanup. */
-	pfree(skip_slot);
-	return true;
-}
-
 /*
  * AbsorbFsyncRequests
  *		Retrieve queued fsync requests and pass them to local smgr.
@@ -1331,6 +1330,7 @@ AbsorbFsyncRequests(void)
 	START_CRIT_SECTION();
 
 	CheckpointerShmem->num_requests = 0;
+	NextCheckpointerRequestGeneration();
 
 	LWLockRelease(CheckpointerCommLock);
 
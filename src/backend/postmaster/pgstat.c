@@ -1,10 +1,15 @@
 /* ----------
  * pgstat.c
  *
- *	All the statistics collector stuff hacked up in one big, ugly file.
+ *	All the statistics stuff hacked up in one big, ugly file.
  *
- *	TODO:	- Separate collector, postmaster and backend stuff
- *			  into different files.
+ *	Cumulative statistics live in shared memory.  Backends accumulate
+ *	counts locally and fold them into the shared hash tables in batches
+ *	(at most every PGSTAT_STAT_INTERVAL msec), under PgStatLock.  The
+ *	contents are written to disk only at shutdown, and read back at the
+ *	next startup unless crash recovery is needed.
+ *
+ *	TODO:	- Separate postmaster and backend stuff into different files.
  *
  *			- Add some automatic call for pgstat vacuuming.
  *
@@ -22,11 +27,6 @@
 #include <fcntl.h>
 #include <sys/param.h>
 #include <sys/time.h>
-#include <sys/socket.h>
-#include <netdb.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <signal.h>
 #include <time.h>
 
 #include "pgstat.h"
@@ -38,29 +38,25 @@
 #include "access/xact.h"
 #include "catalog/pg_database.h"
 #include "catalog/pg_proc.h"
-#include "lib/ilist.h"
-#include "libpq/ip.h"
 #include "libpq/libpq.h"
-#include "libpq/pqsignal.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "postmaster/autovacuum.h"
-#include "postmaster/fork_process.h"
 #include "postmaster/postmaster.h"
 #include "storage/proc.h"
 #include "storage/backendid.h"
-#include "storage/dsm.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
-#include "storage/latch.h"
-#include "storage/pg_shmem.h"
+#include "storage/lmgr.h"
+#include "storage/lwlock.h"
 #include "storage/procsignal.h"
+#include "storage/shmem.h"
 #include "storage/sinvaladt.h"
+#include "storage/spin.h"
 #include "utils/ascii.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
-#include "utils/ps_status.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
 #include "utils/timestamp.h"
@@ -71,34 +67,22 @@
  * Timer definitions.
  * ----------
  */
-#define PGSTAT_STAT_INTERVAL	500		/* Minimum time between stats file
-										 * updates; in milliseconds. */
-
-#define PGSTAT_RETRY_DELAY		10		/* How long to wait between checks for
-										 * a new file; in milliseconds. */
-
-#define PGSTAT_MAX_WAIT_TIME	10000	/* Maximum time to wait for a stats
-										 * file update; in milliseconds. */
-
-#define PGSTAT_INQ_INTERVAL		640		/* How often to ping the collector for
-										 * a new file; in milliseconds. */
-
-#define PGSTAT_RESTART_INTERVAL 60		/* How often to attempt to restart a
-										 * failed statistics collector; in
-										 * seconds. */
-
-#define PGSTAT_POLL_LOOP_COUNT	(PGSTAT_MAX_WAIT_TIME / PGSTAT_RETRY_DELAY)
-#define PGSTAT_INQ_LOOP_COUNT	(PGSTAT_INQ_INTERVAL / PGSTAT_RETRY_DELAY)
+#define PGSTAT_STAT_INTERVAL	500		/* Minimum time between flushes of a
+										 * backend's counts to shared memory;
+										 * in milliseconds. */
 
 
 /* ----------
- * The initial size hints for the hash tables used in the collector.
+ * The initial size hints for the hash tables used for statistics.
  * ----------
  */
 #define PGSTAT_DB_HASH_SIZE		16
 #define PGSTAT_TAB_HASH_SIZE	512
 #define PGSTAT_FUNCTION_HASH_SIZE	512
 
+/* Number of databases we reserve shared memory for up front */
+#define PGSTAT_SHARED_DB_HASH_SIZE	64
+
 
 /* ----------
  * GUC parameters
@@ -108,6 +92,7 @@ bool		pgstat_track_activities = false;
 bool		pgstat_track_counts = false;
 int			pgstat_track_functions = TRACK_FUNC_OFF;
 int			pgstat_track_activity_query_size = 1024;
+int			pgstat_max_objects = 10000;
 
 /* ----------
  * Built from GUC parameter
@@ -125,20 +110,63 @@ char	   *pgstat_stat_tmpname = NULL;
 PgStat_MsgBgWriter BgWriterStats;
 
 /* ----------
- * Local data
+ * Shared memory data
+ *
+ * Per-database entries are kept in one shared hash table, and per-table
+ * and per-function entries of all databases in another, keyed by database,
+ * object OID and kind.  The latter is of fixed size (max_stats_objects
+ * entries); objects beyond that are simply not tracked.  Both hash tables
+ * and the cluster-wide bgwriter counters are protected by PgStatLock.
+ *
+ * The archiver counters have their own spinlock instead, because the
+ * archiver process has no PGPROC and cannot take LWLocks.
  * ----------
  */
-NON_EXEC_STATIC pgsocket pgStatSock = PGINVALID_SOCKET;
+struct PgStatSharedState
+{
+	PgStat_GlobalStats globalStats;
+
+	slock_t		archiver_lck;	/* protects archiverStats */
+	PgStat_ArchiverStats archiverStats;
+};
+
+#define PGSTAT_KIND_TABLE		1
+#define PGSTAT_KIND_FUNCTION	2
+
+typedef struct PgStatObjectKey
+{
+	Oid			databaseid;		/* InvalidOid for shared relations */
+	Oid			objectid;		/* table or function OID */
+	uint32		kind;			/* PGSTAT_KIND_TABLE or PGSTAT_KIND_FUNCTION */
+} PgStatObjectKey;
+
+typedef struct PgStatObjectEntry
+{
+	PgStatObjectKey key;		/* hash key (must be first) */
+	union
+	{
+		PgStat_StatTabEntry table;
+		PgStat_StatFuncEntry function;
+	}			u;
+} PgStatObjectEntry;
 
-static struct sockaddr_storage pgStatAddr;
+NON_EXEC_STATIC PgStatSharedState *pgStatShared = NULL;
 
-static time_t last_pgstat_start_time;
+static HTAB *pgStatSharedDBHash = NULL;
+static HTAB *pgStatSharedObjectHash = NULL;
+static HTAB *pgStatSharedIOHash = NULL;
 
-static bool pgStatRunningInCollector = false;
+/* have we already complained about the object hash being full? */
+static bool pgstat_objects_full_reported = false;
+
+/* ----------
+ * Local data
+ * ----------
+ */
 
 /*
  * Structures in which backends store per-table info that's waiting to be
- * sent to the collector.
+ * flushed to shared memory.
  *
  * NOTE: once allocated, TabStatusArray structures are never moved or deleted
  * for the life of the backend.  Also, we zero out the t_id fields of the
@@ -159,17 +187,24 @@ typedef struct TabStatusArray
 static TabStatusArray *pgStatTabList = NULL;
 
 /*
- * Backends store per-function info that's waiting to be sent to the collector
- * in this hash table (indexed by function OID).
+ * Backends store per-function info that's waiting to be flushed to shared
+ * memory in this hash table (indexed by function OID).
  */
 static HTAB *pgStatFunctions = NULL;
 
 /*
  * Indicates if backend has some function stats that it hasn't yet
- * sent to the collector.
+ * flushed to shared memory.
  */
 static bool have_function_stats = false;
 
+/*
+ * I/O latencies measured by this backend that haven't been flushed to shared
+ * memory yet, indexed by RelFileNode.
+ */
+static HTAB *pgStatIOLatency = NULL;
+static bool have_io_latency = false;
+
 /*
  * Tuple insertion/deletion counts for an open transaction can't be propagated
  * into PgStat_TableStatus counters until we know if it is going to commit
@@ -190,6 +225,7 @@ static int	pgStatXactCommit = 0;
 static int	pgStatXactRollback = 0;
 PgStat_Counter pgStatBlockReadTime = 0;
 PgStat_Counter pgStatBlockWriteTime = 0;
+PgStat_Counter pgStatOverflowedSnapshots = 0;
 
 /* Record that's written to 2PC state file when pgstat state is persisted */
 typedef struct TwoPhasePgStatRecord
@@ -206,7 +242,7 @@ typedef struct TwoPhasePgStatRecord
 } TwoPhasePgStatRecord;
 
 /*
- * Info about current "snapshot" of stats file
+ * Info about current "snapshot" of the shared statistics
  */
 static MemoryContext pgStatLocalContext = NULL;
 static HTAB *pgStatDBHash = NULL;
@@ -214,27 +250,12 @@ static LocalPgBackendStatus *localBackendStatusTable = NULL;
 static int	localNumBackends = 0;
 
 /*
- * Cluster wide statistics, kept in the stats collector.
- * Contains statistics that are not collected per database
- * or per table.
+ * Snapshot copies of the cluster wide statistics, which are not
+ * collected per database or per table.
  */
 static PgStat_ArchiverStats archiverStats;
 static PgStat_GlobalStats globalStats;
 
-/* Write request info for each database */
-typedef struct DBWriteRequest
-{
-	Oid			databaseid;		/* OID of the database to write */
-	TimestampTz request_time;	/* timestamp of the last write request */
-	slist_node	next;
-} DBWriteRequest;
-
-/* Latest statistics request times from backends */
-static slist_head last_statrequests = SLIST_STATIC_INIT(last_statrequests);
-
-static volatile bool need_exit = false;
-static volatile bool got_SIGHUP = false;
-
 /*
  * Total time charged to functions so far in the current backend.
  * We use this to help separate "self" and "other" time charges.
@@ -247,40 +268,35 @@ static instr_time total_func_time;
  * Local function forward declarations
  * ----------
  */
-#ifdef EXEC_BACKEND
-static pid_t pgstat_forkexec(void);
-#endif
-
-NON_EXEC_STATIC void PgstatCollectorMain(int argc, char *argv[]) pg_attribute_noreturn();
-static void pgstat_exit(SIGNAL_ARGS);
 static void pgstat_beshutdown_hook(int code, Datum arg);
-static void pgstat_sighup_handler(SIGNAL_ARGS);
 
 static PgStat_StatDBEntry *pgstat_get_db_entry(Oid databaseid, bool create);
-static PgStat_StatTabEntry *pgstat_get_tab_entry(PgStat_StatDBEntry *dbentry,
+static PgStatObjectEntry *pgstat_get_object_entry(Oid databaseid,
+						Oid objectid, uint32 kind, bool create);
+static PgStat_StatTabEntry *pgstat_get_tab_entry(Oid databaseid,
 					 Oid tableoid, bool create);
-static void pgstat_write_statsfiles(bool permanent, bool allDbs);
-static void pgstat_write_db_statsfile(PgStat_StatDBEntry *dbentry, bool permanent);
-static HTAB *pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep);
-static void pgstat_read_db_statsfile(Oid databaseid, HTAB *tabhash, HTAB *funchash, bool permanent);
-static void backend_read_statsfile(void);
+static void pgstat_remove_db_objects(Oid databaseid);
+static void backend_snapshot_stats(void);
 static void pgstat_read_current_status(void);
 
-static bool pgstat_write_statsfile_needed(void);
-static bool pgstat_db_requested(Oid databaseid);
-
 static void pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg);
 static void pgstat_send_funcstats(void);
+static void pgstat_send_io_latency(void);
 static HTAB *pgstat_collect_oids(Oid catalogid);
 
 static PgStat_TableStatus *get_tabstat_entry(Oid rel_id, bool isshared);
 
 static void pgstat_setup_memcxt(void);
 
+static const char *pgstat_get_wait_activity(WaitEventActivity w);
+static const char *pgstat_get_wait_client(WaitEventClient w);
+static const char *pgstat_get_wait_ipc(WaitEventIPC w);
+static const char *pgstat_get_wait_timeout(WaitEventTimeout w);
+static const char *pgstat_get_wait_io(WaitEventIO w);
+
 static void pgstat_setheader(PgStat_MsgHdr *hdr, StatMsgType mtype);
 static void pgstat_send(void *msg, int len);
 
-static void pgstat_recv_inquiry(PgStat_MsgInquiry *msg, int len);
 static void pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len);
 static void pgstat_recv_tabpurge(PgStat_MsgTabpurge *msg, int len);
 static void pgstat_recv_dropdb(PgStat_MsgDropdb *msg, int len);
@@ -304,262 +320,90 @@ static void pgstat_recv_tempfile(PgStat_MsgTempFile *msg, int len);
  */
 
 /* ----------
- * pgstat_init() -
+ * PgStatShmemSize() -
+ *
+ *	Compute the space needed for the shared statistics.
+ * ----------
+ */
+Size
+PgStatShmemSize(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(PgStatSharedState));
+	size = add_size(size, hash_estimate_size(PGSTAT_SHARED_DB_HASH_SIZE,
+											 sizeof(PgStat_StatDBEntry)));
+	size = add_size(size, hash_estimate_size(pgstat_max_objects,
+											 sizeof(PgStatObjectEntry)));
+	size = add_size(size, hash_estimate_size(pgstat_max_objects,
+											 sizeof(PgStat_StatIOEntry)));
+
+	return size;
+}
+
+/* ----------
+ * PgStatShmemInit() -
  *
- *	Called from postmaster at startup. Create the resources required
- *	by the statistics collector process.  If unable to do so, do not
- *	fail --- better to let the postmaster start with stats collection
- *	disabled.
+ *	Allocate and initialize the shared statistics, or attach to them if
+ *	already created.  Statistics start out empty; pgstat_read_statsfile()
+ *	restores the contents saved at the last shutdown.
  * ----------
  */
 void
-pgstat_init(void)
+PgStatShmemInit(void)
 {
-	ACCEPT_TYPE_ARG3 alen;
-	struct addrinfo *addrs = NULL,
-			   *addr,
-				hints;
-	int			ret;
-	fd_set		rset;
-	struct timeval tv;
-	char		test_byte;
-	int			sel_res;
-	int			tries = 0;
-
-#define TESTBYTEVAL ((char) 199)
+	HASHCTL		info;
+	bool		found;
 
 	/*
 	 * This static assertion verifies that we didn't mess up the calculations
-	 * involved in selecting maximum payload sizes for our UDP messages.
-	 * Because the only consequence of overrunning PGSTAT_MAX_MSG_SIZE would
-	 * be silent performance loss from fragmentation, it seems worth having a
-	 * compile-time cross-check that we didn't.
+	 * involved in selecting maximum payload sizes for our messages, which
+	 * are built on the stack.
 	 */
 	StaticAssertStmt(sizeof(PgStat_Msg) <= PGSTAT_MAX_MSG_SIZE,
 				   "maximum stats message size exceeds PGSTAT_MAX_MSG_SIZE");
 
-	/*
-	 * Create the UDP socket for sending and receiving statistic messages
-	 */
-	hints.ai_flags = AI_PASSIVE;
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_DGRAM;
-	hints.ai_protocol = 0;
-	hints.ai_addrlen = 0;
-	hints.ai_addr = NULL;
-	hints.ai_canonname = NULL;
-	hints.ai_next = NULL;
-	ret = pg_getaddrinfo_all("localhost", NULL, &hints, &addrs);
-	if (ret || !addrs)
-	{
-		ereport(LOG,
-				(errmsg("could not resolve \"localhost\": %s",
-						gai_strerror(ret))));
-		goto startup_failed;
-	}
-
-	/*
-	 * On some platforms, pg_getaddrinfo_all() may return multiple addresses
-	 * only one of which will actually work (eg, both IPv6 and IPv4 addresses
-	 * when kernel will reject IPv6).  Worse, the failure may occur at the
-	 * bind() or perhaps even connect() stage.  So we must loop through the
-	 * results till we find a working combination. We will generate LOG
-	 * messages, but no error, for bogus combinations.
-	 */
-	for (addr = addrs; addr; addr = addr->ai_next)
-	{
-#ifdef HAVE_UNIX_SOCKETS
-		/* Ignore AF_UNIX sockets, if any are returned. */
-		if (addr->ai_family == AF_UNIX)
-			continue;
-#endif
-
-		if (++tries > 1)
-			ereport(LOG,
-			(errmsg("trying another address for the statistics collector")));
-
-		/*
-		 * Create the socket.
-		 */
-		if ((pgStatSock = socket(addr->ai_family, SOCK_DGRAM, 0)) == PGINVALID_SOCKET)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-			errmsg("could not create socket for statistics collector: %m")));
-			continue;
-		}
-
-		/*
-		 * Bind it to a kernel assigned port on localhost and get the assigned
-		 * port via getsockname().
-		 */
-		if (bind(pgStatSock, addr->ai_addr, addr->ai_addrlen) < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-			  errmsg("could not bind socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		alen = sizeof(pgStatAddr);
-		if (getsockname(pgStatSock, (struct sockaddr *) & pgStatAddr, &alen) < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not get address of socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/*
-		 * Connect the socket to its own address.  This saves a few cycles by
-		 * not having to respecify the target address on every send. This also
-		 * provides a kernel-level check that only packets from this same
-		 * address will be received.
-		 */
-		if (connect(pgStatSock, (struct sockaddr *) & pgStatAddr, alen) < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-			errmsg("could not connect socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/*
-		 * Try to send and receive a one-byte test message on the socket. This
-		 * is to catch situations where the socket can be created but will not
-		 * actually pass data (for instance, because kernel packet filtering
-		 * rules prevent it).
-		 */
-		test_byte = TESTBYTEVAL;
-
-retry1:
-		if (send(pgStatSock, &test_byte, 1, 0) != 1)
-		{
-			if (errno == EINTR)
-				goto retry1;	/* if interrupted, just retry */
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not send test message on socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/*
-		 * There could possibly be a little delay before the message can be
-		 * received.  We arbitrarily allow up to half a second before deciding
-		 * it's broken.
-		 */
-		for (;;)				/* need a loop to handle EINTR */
-		{
-			FD_ZERO(&rset);
-			FD_SET(pgStatSock, &rset);
-
-			tv.tv_sec = 0;
-			tv.tv_usec = 500000;
-			sel_res = select(pgStatSock + 1, &rset, NULL, NULL, &tv);
-			if (sel_res >= 0 || errno != EINTR)
-				break;
-		}
-		if (sel_res < 0)
-		{
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("select() failed in statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-		if (sel_res == 0 || !FD_ISSET(pgStatSock, &rset))
-		{
-			/*
-			 * This is the case we actually think is likely, so take pains to
-			 * give a specific message for it.
-			 *
-			 * errno will not be set meaningfully here, so don't use it.
-			 */
-			ereport(LOG,
-					(errcode(ERRCODE_CONNECTION_FAILURE),
-					 errmsg("test message did not get through on socket for statistics collector")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		test_byte++;			/* just make sure variable is changed */
-
-retry2:
-		if (recv(pgStatSock, &test_byte, 1, 0) != 1)
-		{
-			if (errno == EINTR)
-				goto retry2;	/* if interrupted, just retry */
-			ereport(LOG,
-					(errcode_for_socket_access(),
-					 errmsg("could not receive test message on socket for statistics collector: %m")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		if (test_byte != TESTBYTEVAL)	/* strictly paranoia ... */
-		{
-			ereport(LOG,
-					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("incorrect test message transmission on socket for statistics collector")));
-			closesocket(pgStatSock);
-			pgStatSock = PGINVALID_SOCKET;
-			continue;
-		}
-
-		/* If we get here, we have a working socket */
-		break;
-	}
-
-	/* Did we find a working address? */
-	if (!addr || pgStatSock == PGINVALID_SOCKET)
-		goto startup_failed;
+	pgStatShared = (PgStatSharedState *)
+		ShmemInitStruct("Shared Statistics", sizeof(PgStatSharedState),
+						&found);
 
-	/*
-	 * Set the socket to non-blocking IO.  This ensures that if the collector
-	 * falls behind, statistics messages will be discarded; backends won't
-	 * block waiting to send messages to the collector.
-	 */
-	if (!pg_set_noblock(pgStatSock))
+	if (!found)
 	{
-		ereport(LOG,
-				(errcode_for_socket_access(),
-				 errmsg("could not set statistics collector socket to nonblocking mode: %m")));
-		goto startup_failed;
+		MemSet(pgStatShared, 0, sizeof(PgStatSharedState));
+		pgStatShared->globalStats.stat_reset_timestamp = GetCurrentTimestamp();
+		pgStatShared->archiverStats.stat_reset_timestamp =
+			pgStatShared->globalStats.stat_reset_timestamp;
+		SpinLockInit(&pgStatShared->archiver_lck);
 	}
 
-	pg_freeaddrinfo_all(hints.ai_family, addrs);
-
-	return;
-
-startup_failed:
-	ereport(LOG,
-	  (errmsg("disabling statistics collector for lack of working socket")));
-
-	if (addrs)
-		pg_freeaddrinfo_all(hints.ai_family, addrs);
-
-	if (pgStatSock != PGINVALID_SOCKET)
-		closesocket(pgStatSock);
-	pgStatSock = PGINVALID_SOCKET;
-
-	/*
-	 * Adjust GUC variables to suppress useless activity, and for debugging
-	 * purposes (seeing track_counts off is a clue that we failed here). We
-	 * use PGC_S_OVERRIDE because there is no point in trying to turn it back
-	 * on from postgresql.conf without a restart.
-	 */
-	SetConfigOption("track_counts", "off", PGC_INTERNAL, PGC_S_OVERRIDE);
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(Oid);
+	info.entrysize = sizeof(PgStat_StatDBEntry);
+	pgStatSharedDBHash = ShmemInitHash("Shared Statistics Databases",
+									   PGSTAT_SHARED_DB_HASH_SIZE,
+									   PGSTAT_SHARED_DB_HASH_SIZE,
+									   &info,
+									   HASH_ELEM | HASH_BLOBS);
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(PgStatObjectKey);
+	info.entrysize = sizeof(PgStatObjectEntry);
+	pgStatSharedObjectHash = ShmemInitHash("Shared Statistics Objects",
+										   pgstat_max_objects,
+										   pgstat_max_objects,
+										   &info,
+										   HASH_ELEM | HASH_BLOBS |
+										   HASH_FIXED_SIZE);
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(RelFileNode);
+	info.entrysize = sizeof(PgStat_StatIOEntry);
+	pgStatSharedIOHash = ShmemInitHash("Shared Statistics I/O Latency",
+									   pgstat_max_objects,
+									   pgstat_max_objects,
+									   &info,
+									   HASH_ELEM | HASH_BLOBS |
+									   HASH_FIXED_SIZE);
 }
 
 /*
@@ -580,7 +424,8 @@ pgstat_reset_remove_files(const char *directory)
 
 		/*
 		 * Skip directory entries that don't match the file names we write.
-		 * See get_dbstat_filename for the database-specific pattern.
+		 * The per-database db_<oid> files were written by the statistics
+		 * collector of earlier releases; clean those up too.
 		 */
 		if (strncmp(entry->d_name, "global.", 7) == 0)
 			nchars = 7;
@@ -620,110 +465,6 @@ pgstat_reset_all(void)
 	pgstat_reset_remove_files(PGSTAT_STAT_PERMANENT_DIRECTORY);
 }
 
-#ifdef EXEC_BACKEND
-
-/*
- * pgstat_forkexec() -
- *
- * Format up the arglist for, then fork and exec, statistics collector process
- */
-static pid_t
-pgstat_forkexec(void)
-{
-	char	   *av[10];
-	int			ac = 0;
-
-	av[ac++] = "postgres";
-	av[ac++] = "--forkcol";
-	av[ac++] = NULL;			/* filled in by postmaster_forkexec */
-
-	av[ac] = NULL;
-	Assert(ac < lengthof(av));
-
-	return postmaster_forkexec(ac, av);
-}
-#endif   /* EXEC_BACKEND */
-
-
-/*
- * pgstat_start() -
- *
- *	Called from postmaster at startup or after an existing collector
- *	died.  Attempt to fire up a fresh statistics collector.
- *
- *	Returns PID of child process, or 0 if fail.
- *
- *	Note: if fail, we will be called again from the postmaster main loop.
- */
-int
-pgstat_start(void)
-{
-	time_t		curtime;
-	pid_t		pgStatPid;
-
-	/*
-	 * Check that the socket is there, else pgstat_init failed and we can do
-	 * nothing useful.
-	 */
-	if (pgStatSock == PGINVALID_SOCKET)
-		return 0;
-
-	/*
-	 * Do nothing if too soon since last collector start.  This is a safety
-	 * valve to protect against continuous respawn attempts if the collector
-	 * is dying immediately at launch.  Note that since we will be re-called
-	 * from the postmaster main loop, we will get another chance later.
-	 */
-	curtime = time(NULL);
-	if ((unsigned int) (curtime - last_pgstat_start_time) <
-		(unsigned int) PGSTAT_RESTART_INTERVAL)
-		return 0;
-	last_pgstat_start_time = curtime;
-
-	/*
-	 * Okay, fork off the collector.
-	 */
-#ifdef EXEC_BACKEND
-	switch ((pgStatPid = pgstat_forkexec()))
-#else
-	switch ((pgStatPid = fork_process()))
-#endif
-	{
-		case -1:
-			ereport(LOG,
-					(errmsg("could not fork statistics collector: %m")));
-			return 0;
-
-#ifndef EXEC_BACKEND
-		case 0:
-			/* in postmaster child ... */
-			InitPostmasterChild();
-
-			/* Close the postmaster's sockets */
-			ClosePostmasterPorts(false);
-
-			/* Drop our connection to postmaster's shared memory, as well */
-			dsm_detach_all();
-			PGSharedMemoryDetach();
-
-			PgstatCollectorMain(0, NULL);
-			break;
-#endif
-
-		default:
-			return (int) pgStatPid;
-	}
-
-	/* shouldn't get here */
-	return 0;
-}
-
-void
-allow_immediate_pgstat_restart(void)
-{
-	last_pgstat_start_time = 0;
-}
-
 /* ------------------------------------------------------------
  * public functions used by backends follow
  *------------------------------------------------------------
@@ -733,10 +474,13 @@ allow_immediate_pgstat_restart(void)
 /* ----------
  * pgstat_report_stat() -
  *
- *	Called from tcop/postgres.c to send the so far collected per-table
- *	and function usage statistics to the collector.  Note that this is
+ *	Called from tcop/postgres.c to flush the so far collected per-table
+ *	and function usage statistics to shared memory.  Note that this is
  *	called only when not within a transaction, so it is fair to use
  *	transaction stop time as an approximation of current time.
+ *
+ *	Unless forced, we don't wait for PgStatLock: if somebody else holds it,
+ *	we keep our counts and add them in at the next opportunity.
  * ----------
  */
 void
@@ -755,22 +499,28 @@ pgstat_report_stat(bool force)
 	/* Don't expend a clock check if nothing to do */
 	if ((pgStatTabList == NULL || pgStatTabList->tsa_used == 0) &&
 		pgStatXactCommit == 0 && pgStatXactRollback == 0 &&
-		!have_function_stats)
+		pgStatOverflowedSnapshots == 0 && !have_function_stats &&
+		!have_io_latency)
 		return;
 
 	/*
-	 * Don't send a message unless it's been at least PGSTAT_STAT_INTERVAL
-	 * msec since we last sent one, or the caller wants to force stats out.
+	 * Don't flush unless it's been at least PGSTAT_STAT_INTERVAL msec since
+	 * we last did, or the caller wants to force stats out.
 	 */
 	now = GetCurrentTransactionStopTimestamp();
 	if (!force &&
 		!TimestampDifferenceExceeds(last_report, now, PGSTAT_STAT_INTERVAL))
 		return;
+
+	if (force)
+		LWLockAcquire(PgStatLock, LW_EXCLUSIVE);
+	else if (!LWLockConditionalAcquire(PgStatLock, LW_EXCLUSIVE))
+		return;
 	last_report = now;
 
 	/*
 	 * Scan through the TabStatusArray struct(s) to find tables that actually
-	 * have counts, and build messages to send.  We have to separate shared
+	 * have counts, and build messages to apply.  We have to separate shared
 	 * relations from regular ones because the databaseid field in the message
 	 * header has to depend on that.
 	 */
@@ -799,7 +549,8 @@ pgstat_report_stat(bool force)
 				continue;
 
 			/*
-			 * OK, insert data into the appropriate message, and send if full.
+			 * OK, insert data into the appropriate message, and apply it if
+			 * full.
 			 */
 			this_msg = entry->t_shared ? &shared_msg : &regular_msg;
 			this_ent = &this_msg->m_entry[this_msg->m_nentries];
@@ -819,21 +570,28 @@ pgstat_report_stat(bool force)
 	}
 
 	/*
-	 * Send partial messages.  Make sure that any pending xact commit/abort
-	 * gets counted, even if there are no table stats to send.
+	 * Apply partial messages.  Make sure that any pending xact commit/abort
+	 * gets counted, even if there are no table stats to apply.
 	 */
 	if (regular_msg.m_nentries > 0 ||
-		pgStatXactCommit > 0 || pgStatXactRollback > 0)
+		pgStatXactCommit > 0 || pgStatXactRollback > 0 ||
+		pgStatOverflowedSnapshots > 0)
 		pgstat_send_tabstat(&regular_msg);
 	if (shared_msg.m_nentries > 0)
 		pgstat_send_tabstat(&shared_msg);
 
-	/* Now, send function statistics */
+	/* Now, apply function statistics */
 	pgstat_send_funcstats();
+
+	/* ... and I/O latencies */
+	pgstat_send_io_latency();
+
+	LWLockRelease(PgStatLock);
 }
 
 /*
- * Subroutine for pgstat_report_stat: finish and send a tabstat message
+ * Subroutine for pgstat_report_stat: finish and apply a tabstat message.
+ * Caller must hold PgStatLock exclusively.
  */
 static void
 pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg)
@@ -841,13 +599,9 @@ pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg)
 	int			n;
 	int			len;
 
-	/* It's unlikely we'd get here with no socket, but maybe not impossible */
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	/*
 	 * Report and reset accumulated xact commit/rollback and I/O timings
-	 * whenever we send a normal tabstat message
+	 * whenever we apply a normal tabstat message
 	 */
 	if (OidIsValid(tsmsg->m_databaseid))
 	{
@@ -855,10 +609,12 @@ pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg)
 		tsmsg->m_xact_rollback = pgStatXactRollback;
 		tsmsg->m_block_read_time = pgStatBlockReadTime;
 		tsmsg->m_block_write_time = pgStatBlockWriteTime;
+		tsmsg->m_overflowed_snapshots = pgStatOverflowedSnapshots;
 		pgStatXactCommit = 0;
 		pgStatXactRollback = 0;
 		pgStatBlockReadTime = 0;
 		pgStatBlockWriteTime = 0;
+		pgStatOverflowedSnapshots = 0;
 	}
 	else
 	{
@@ -866,6 +622,7 @@ pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg)
 		tsmsg->m_xact_rollback = 0;
 		tsmsg->m_block_read_time = 0;
 		tsmsg->m_block_write_time = 0;
+		tsmsg->m_overflowed_snapshots = 0;
 	}
 
 	n = tsmsg->m_nentries;
@@ -873,11 +630,12 @@ pgstat_send_tabstat(PgStat_MsgTabstat *tsmsg)
 		n * sizeof(PgStat_TableEntry);
 
 	pgstat_setheader(&tsmsg->m_hdr, PGSTAT_MTYPE_TABSTAT);
-	pgstat_send(tsmsg, len);
+	pgstat_recv_tabstat(tsmsg, len);
 }
 
 /*
- * Subroutine for pgstat_report_stat: populate and send a function stat message
+ * Subroutine for pgstat_report_stat: populate and apply function stat
+ * messages.  Caller must hold PgStatLock exclusively.
  */
 static void
 pgstat_send_funcstats(void)
@@ -915,8 +673,8 @@ pgstat_send_funcstats(void)
 
 		if (++msg.m_nentries >= PGSTAT_NUM_FUNCENTRIES)
 		{
-			pgstat_send(&msg, offsetof(PgStat_MsgFuncstat, m_entry[0]) +
-						msg.m_nentries * sizeof(PgStat_FunctionEntry));
+			pgstat_recv_funcstat(&msg, offsetof(PgStat_MsgFuncstat, m_entry[0]) +
+								 msg.m_nentries * sizeof(PgStat_FunctionEntry));
 			msg.m_nentries = 0;
 		}
 
@@ -925,80 +683,237 @@ pgstat_send_funcstats(void)
 	}
 
 	if (msg.m_nentries > 0)
-		pgstat_send(&msg, offsetof(PgStat_MsgFuncstat, m_entry[0]) +
-					msg.m_nentries * sizeof(PgStat_FunctionEntry));
+		pgstat_recv_funcstat(&msg, offsetof(PgStat_MsgFuncstat, m_entry[0]) +
+							 msg.m_nentries * sizeof(PgStat_FunctionEntry));
 
 	have_function_stats = false;
 }
 
-
-/* ----------
- * pgstat_vacuum_stat() -
- *
- *	Will tell the collector about objects he can get rid of.
- * ----------
+/*
+ * Add one backend's I/O latencies for a relation file or tablespace to the
+ * shared entry.  Caller must hold PgStatLock exclusively.
  */
-void
-pgstat_vacuum_stat(void)
+static void
+pgstat_add_io_latency(const RelFileNode *rnode, const PgStat_IOLatency *ops)
 {
-	HTAB	   *htab;
-	PgStat_MsgTabpurge msg;
-	PgStat_MsgFuncpurge f_msg;
-	HASH_SEQ_STATUS hstat;
-	PgStat_StatDBEntry *dbentry;
-	PgStat_StatTabEntry *tabentry;
-	PgStat_StatFuncEntry *funcentry;
-	int			len;
+	PgStat_StatIOEntry *entry;
+	bool		found;
+	int			op;
+	int			i;
 
-	if (pgStatSock == PGINVALID_SOCKET)
+	entry = (PgStat_StatIOEntry *) hash_search(pgStatSharedIOHash, rnode,
+											   HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+	{
+		if (!pgstat_objects_full_reported)
+		{
+			pgstat_objects_full_reported = true;
+			ereport(LOG,
+					(errmsg("too many objects to track statistics for"),
+					 errhint("You might need to increase max_stats_objects.")));
+		}
 		return;
+	}
 
-	/*
-	 * If not done for this transaction, read the statistics collector stats
-	 * file into some hash tables.
-	 */
-	backend_read_statsfile();
-
-	/*
-	 * Read pg_database and make a list of OIDs of all existing databases
-	 */
-	htab = pgstat_collect_oids(DatabaseRelationId);
+	if (!found)
+		MemSet(entry->ops, 0, sizeof(entry->ops));
 
-	/*
-	 * Search the database hash table for dead databases and tell the
-	 * collector to drop them.
-	 */
-	hash_seq_init(&hstat, pgStatDBHash);
-	while ((dbentry = (PgStat_StatDBEntry *) hash_seq_search(&hstat)) != NULL)
+	for (op = 0; op < PGSTAT_NUM_IO_OPS; op++)
 	{
-		Oid			dbid = dbentry->databaseid;
-
-		CHECK_FOR_INTERRUPTS();
-
-		/* the DB entry for shared tables (with InvalidOid) is never dropped */
-		if (OidIsValid(dbid) &&
-			hash_search(htab, (void *) &dbid, HASH_FIND, NULL) == NULL)
-			pgstat_drop_database(dbid);
+		entry->ops[op].count += ops[op].count;
+		entry->ops[op].total_time += ops[op].total_time;
+		for (i = 0; i < PGSTAT_IO_HIST_BUCKETS; i++)
+			entry->ops[op].hist[i] += ops[op].hist[i];
 	}
+}
 
-	/* Clean up */
-	hash_destroy(htab);
+/*
+ * Subroutine for pgstat_report_stat and pgstat_send_bgwriter: apply pending
+ * I/O latencies to both the relation file and its tablespace total.  Caller
+ * must hold PgStatLock exclusively.
+ */
+static void
+pgstat_send_io_latency(void)
+{
+	PgStat_StatIOEntry *entry;
+	HASH_SEQ_STATUS hstat;
 
-	/*
-	 * Lookup our own database entry; if not found, nothing more to do.
-	 */
-	dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
-												 (void *) &MyDatabaseId,
-												 HASH_FIND, NULL);
-	if (dbentry == NULL || dbentry->tables == NULL)
+	if (!have_io_latency)
 		return;
 
-	/*
-	 * Similarly to above, make a list of all known relations in this DB.
-	 */
-	htab = pgstat_collect_oids(RelationRelationId);
+	/* dynahash allows removing the entry just returned by the scan */
+	hash_seq_init(&hstat, pgStatIOLatency);
+	while ((entry = (PgStat_StatIOEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		RelFileNode spcnode;
 
-	/*
+		spcnode.spcNode = entry->rnode.spcNode;
+		spcnode.dbNode = InvalidOid;
+		spcnode.relNode = InvalidOid;
+
+		pgstat_add_io_latency(&entry->rnode, entry->ops);
+		pgstat_add_io_latency(&spcnode, entry->ops);
+
+		(void) hash_search(pgStatIOLatency, &entry->rnode, HASH_REMOVE, NULL);
+	}
+
+	have_io_latency = false;
+}
+
+/* ----------
+ * pgstat_count_io_latency() -
+ *
+ *	Count a read, write or fsync of a relation file that started at "start"
+ *	and has just completed.  The caller only reads the clock when
+ *	track_io_timing is on.
+ *
+ *	This can be called inside a critical section, where we mustn't allocate
+ *	memory; an operation on a file we have no pending entry for is then
+ *	simply not counted.
+ * ----------
+ */
+void
+pgstat_count_io_latency(const RelFileNode *rnode, PgStat_IOOp op,
+						instr_time start)
+{
+	PgStat_StatIOEntry *entry;
+	PgStat_IOLatency *lat;
+	instr_time	duration;
+	uint64		usecs;
+	uint64		bound;
+	int			bucket;
+	bool		found;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	usecs = INSTR_TIME_GET_MICROSEC(duration);
+
+	if (pgStatIOLatency == NULL)
+	{
+		HASHCTL		hash_ctl;
+
+		if (CritSectionCount > 0)
+			return;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(RelFileNode);
+		hash_ctl.entrysize = sizeof(PgStat_StatIOEntry);
+		pgStatIOLatency = hash_create("I/O latency stat entries",
+									  PGSTAT_TAB_HASH_SIZE,
+									  &hash_ctl,
+									  HASH_ELEM | HASH_BLOBS);
+	}
+
+	entry = (PgStat_StatIOEntry *)
+		hash_search(pgStatIOLatency, rnode,
+					CritSectionCount > 0 ? HASH_FIND : HASH_ENTER, &found);
+	if (entry == NULL)
+		return;
+	if (!found)
+		MemSet(entry->ops, 0, sizeof(entry->ops));
+
+	lat = &entry->ops[op];
+	lat->count++;
+	lat->total_time += usecs;
+
+	bound = PGSTAT_IO_HIST_FIRST_BOUND;
+	for (bucket = 0; bucket < PGSTAT_IO_HIST_BUCKETS - 1; bucket++)
+	{
+		if (usecs < bound)
+			break;
+		bound *= 2;
+	}
+	lat->hist[bucket]++;
+
+	have_io_latency = true;
+}
+
+/* ----------
+ * pgstat_drop_io_latency() -
+ *
+ *	Forget the I/O latencies of a relation file that is being unlinked.
+ *	The tablespace total keeps its share.
+ * ----------
+ */
+void
+pgstat_drop_io_latency(const RelFileNode *rnode)
+{
+	if (pgStatIOLatency != NULL)
+		(void) hash_search(pgStatIOLatency, rnode, HASH_REMOVE, NULL);
+
+	if (pgStatSharedIOHash == NULL)
+		return;
+
+	LWLockAcquire(PgStatLock, LW_EXCLUSIVE);
+	(void) hash_search(pgStatSharedIOHash, rnode, HASH_REMOVE, NULL);
+	LWLockRelease(PgStatLock);
+}
+
+
+/* ----------
+ * pgstat_vacuum_stat() -
+ *
+ *	Will tell the statistics system about objects it can get rid of.
+ * ----------
+ */
+void
+pgstat_vacuum_stat(void)
+{
+	HTAB	   *htab;
+	PgStat_MsgTabpurge msg;
+	PgStat_MsgFuncpurge f_msg;
+	HASH_SEQ_STATUS hstat;
+	PgStat_StatDBEntry *dbentry;
+	PgStat_StatTabEntry *tabentry;
+	PgStat_StatFuncEntry *funcentry;
+	int			len;
+
+	/*
+	 * If not done for this transaction, take a snapshot of the shared
+	 * statistics.
+	 */
+	backend_snapshot_stats();
+
+	/*
+	 * Read pg_database and make a list of OIDs of all existing databases
+	 */
+	htab = pgstat_collect_oids(DatabaseRelationId);
+
+	/*
+	 * Search the database hash table for dead databases and drop their
+	 * statistics.
+	 */
+	hash_seq_init(&hstat, pgStatDBHash);
+	while ((dbentry = (PgStat_StatDBEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		Oid			dbid = dbentry->databaseid;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* the DB entry for shared tables (with InvalidOid) is never dropped */
+		if (OidIsValid(dbid) &&
+			hash_search(htab, (void *) &dbid, HASH_FIND, NULL) == NULL)
+			pgstat_drop_database(dbid);
+	}
+
+	/* Clean up */
+	hash_destroy(htab);
+
+	/*
+	 * Lookup our own database entry; if not found, nothing more to do.
+	 */
+	dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
+												 (void *) &MyDatabaseId,
+												 HASH_FIND, NULL);
+	if (dbentry == NULL || dbentry->tables == NULL)
+		return;
+
+	/*
+	 * Similarly to above, make a list of all known relations in this DB.
+	 */
+	htab = pgstat_collect_oids(RelationRelationId);
+
+	/*
 	 * Initialize our messages table counter to zero
 	 */
 	msg.m_nentries = 0;
@@ -1161,7 +1076,7 @@ pgstat_collect_oids(Oid catalogid)
 /* ----------
  * pgstat_drop_database() -
  *
- *	Tell the collector that we just dropped a database.
+ *	Tell the statistics system that we just dropped a database.
  *	(If the message gets lost, we will still clean the dead DB eventually
  *	via future invocations of pgstat_vacuum_stat().)
  * ----------
@@ -1171,9 +1086,6 @@ pgstat_drop_database(Oid databaseid)
 {
 	PgStat_MsgDropdb msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_DROPDB);
 	msg.m_databaseid = databaseid;
 	pgstat_send(&msg, sizeof(msg));
@@ -1183,7 +1095,7 @@ pgstat_drop_database(Oid databaseid)
 /* ----------
  * pgstat_drop_relation() -
  *
- *	Tell the collector that we just dropped a relation.
+ *	Tell the statistics system that we just dropped a relation.
  *	(If the message gets lost, we will still clean the dead entry eventually
  *	via future invocations of pgstat_vacuum_stat().)
  *
@@ -1198,9 +1110,6 @@ pgstat_drop_relation(Oid relid)
 	PgStat_MsgTabpurge msg;
 	int			len;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	msg.m_tableid[0] = relid;
 	msg.m_nentries = 1;
 
@@ -1216,7 +1125,7 @@ pgstat_drop_relation(Oid relid)
 /* ----------
  * pgstat_reset_counters() -
  *
- *	Tell the statistics collector to reset counters for our database.
+ *	Tell the statistics system to reset counters for our database.
  * ----------
  */
 void
@@ -1224,9 +1133,6 @@ pgstat_reset_counters(void)
 {
 	PgStat_MsgResetcounter msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	if (!superuser())
 		ereport(ERROR,
 				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
@@ -1240,7 +1146,7 @@ pgstat_reset_counters(void)
 /* ----------
  * pgstat_reset_shared_counters() -
  *
- *	Tell the statistics collector to reset cluster-wide shared counters.
+ *	Tell the statistics system to reset cluster-wide shared counters.
  * ----------
  */
 void
@@ -1248,9 +1154,6 @@ pgstat_reset_shared_counters(const char *target)
 {
 	PgStat_MsgResetsharedcounter msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	if (!superuser())
 		ereport(ERROR,
 				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
@@ -1260,11 +1163,13 @@ pgstat_reset_shared_counters(const char *target)
 		msg.m_resettarget = RESET_ARCHIVER;
 	else if (strcmp(target, "bgwriter") == 0)
 		msg.m_resettarget = RESET_BGWRITER;
+	else if (strcmp(target, "io_latency") == 0)
+		msg.m_resettarget = RESET_IO_LATENCY;
 	else
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("unrecognized reset target: \"%s\"", target),
-				 errhint("Target must be \"archiver\" or \"bgwriter\".")));
+				 errhint("Target must be \"archiver\", \"bgwriter\" or \"io_latency\".")));
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RESETSHAREDCOUNTER);
 	pgstat_send(&msg, sizeof(msg));
@@ -1273,7 +1178,7 @@ pgstat_reset_shared_counters(const char *target)
 /* ----------
  * pgstat_reset_single_counter() -
  *
- *	Tell the statistics collector to reset a single counter.
+ *	Tell the statistics system to reset a single counter.
  * ----------
  */
 void
@@ -1281,9 +1186,6 @@ pgstat_reset_single_counter(Oid objoid, PgStat_Single_Reset_Type type)
 {
 	PgStat_MsgResetsinglecounter msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	if (!superuser())
 		ereport(ERROR,
 				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
@@ -1310,9 +1212,6 @@ pgstat_report_autovac(Oid dboid)
 {
 	PgStat_MsgAutovacStart msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_AUTOVAC_START);
 	msg.m_databaseid = dboid;
 	msg.m_start_time = GetCurrentTimestamp();
@@ -1324,7 +1223,7 @@ pgstat_report_autovac(Oid dboid)
 /* ---------
  * pgstat_report_vacuum() -
  *
- *	Tell the collector about the table we just vacuumed.
+ *	Tell the statistics system about the table we just vacuumed.
  * ---------
  */
 void
@@ -1333,7 +1232,7 @@ pgstat_report_vacuum(Oid tableoid, bool shared,
 {
 	PgStat_MsgVacuum msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (!pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_VACUUM);
@@ -1349,7 +1248,7 @@ pgstat_report_vacuum(Oid tableoid, bool shared,
 /* --------
  * pgstat_report_analyze() -
  *
- *	Tell the collector about the table we just analyzed.
+ *	Tell the statistics system about the table we just analyzed.
  * --------
  */
 void
@@ -1358,7 +1257,7 @@ pgstat_report_analyze(Relation rel,
 {
 	PgStat_MsgAnalyze msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (!pgstat_track_counts)
 		return;
 
 	/*
@@ -1366,9 +1265,9 @@ pgstat_report_analyze(Relation rel,
 	 * already inserted and/or deleted rows in the target table. ANALYZE will
 	 * have counted such rows as live or dead respectively. Because we will
 	 * report our counts of such rows at transaction end, we should subtract
-	 * off these counts from what we send to the collector now, else they'll
-	 * be double-counted after commit.  (This approach also ensures that the
-	 * collector ends up with the right numbers if we abort instead of
+	 * off these counts from what we report now, else they'll be
+	 * double-counted after commit.  (This approach also ensures that the
+	 * shared counts end up with the right numbers if we abort instead of
 	 * committing.)
 	 */
 	if (rel->pgstat_info != NULL)
@@ -1400,7 +1299,7 @@ pgstat_report_analyze(Relation rel,
 /* --------
  * pgstat_report_recovery_conflict() -
  *
- *	Tell the collector about a Hot Standby recovery conflict.
+ *	Tell the statistics system about a Hot Standby recovery conflict.
  * --------
  */
 void
@@ -1408,7 +1307,7 @@ pgstat_report_recovery_conflict(int reason)
 {
 	PgStat_MsgRecoveryConflict msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (!pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_RECOVERYCONFLICT);
@@ -1420,7 +1319,7 @@ pgstat_report_recovery_conflict(int reason)
 /* --------
  * pgstat_report_deadlock() -
  *
- *	Tell the collector about a deadlock detected.
+ *	Tell the statistics system about a deadlock detected.
  * --------
  */
 void
@@ -1428,7 +1327,7 @@ pgstat_report_deadlock(void)
 {
 	PgStat_MsgDeadlock msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (!pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_DEADLOCK);
@@ -1439,7 +1338,7 @@ pgstat_report_deadlock(void)
 /* --------
  * pgstat_report_tempfile() -
  *
- *	Tell the collector about a temporary file.
+ *	Tell the statistics system about a temporary file.
  * --------
  */
 void
@@ -1447,7 +1346,7 @@ pgstat_report_tempfile(size_t filesize)
 {
 	PgStat_MsgTempFile msg;
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (!pgstat_track_counts)
 		return;
 
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_TEMPFILE);
@@ -1457,43 +1356,6 @@ pgstat_report_tempfile(size_t filesize)
 }
 
 
-/* ----------
- * pgstat_ping() -
- *
- *	Send some junk data to the collector to increase traffic.
- * ----------
- */
-void
-pgstat_ping(void)
-{
-	PgStat_MsgDummy msg;
-
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
-
-	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_DUMMY);
-	pgstat_send(&msg, sizeof(msg));
-}
-
-/* ----------
- * pgstat_send_inquiry() -
- *
- *	Notify collector that we need fresh data.
- * ----------
- */
-static void
-pgstat_send_inquiry(TimestampTz clock_time, TimestampTz cutoff_time, Oid databaseid)
-{
-	PgStat_MsgInquiry msg;
-
-	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_INQUIRY);
-	msg.clock_time = clock_time;
-	msg.cutoff_time = cutoff_time;
-	msg.databaseid = databaseid;
-	pgstat_send(&msg, sizeof(msg));
-}
-
-
 /*
  * Initialize function call usage data.
  * Called by the executor before invoking a function.
@@ -1644,7 +1506,7 @@ pgstat_initstats(Relation rel)
 		return;
 	}
 
-	if (pgStatSock == PGINVALID_SOCKET || !pgstat_track_counts)
+	if (!pgstat_track_counts)
 	{
 		/* We're not counting at all */
 		rel->pgstat_info = NULL;
@@ -2170,7 +2032,7 @@ AtPrepare_PgStat(void)
  *
  * All we need do here is unlink the transaction stats state from the
  * nontransactional state.  The nontransactional action counts will be
- * reported to the stats collector immediately, while the effects on live
+ * reported to shared memory as usual, while the effects on live
  * and dead tuple counts are preserved in the 2PC state file.
  *
  * Note: AtEOXact_PgStat is not called during PREPARE.
@@ -2277,10 +2139,10 @@ PgStat_StatDBEntry *
 pgstat_fetch_stat_dbentry(Oid dbid)
 {
 	/*
-	 * If not done for this transaction, read the statistics collector stats
-	 * file into some hash tables.
+	 * If not done for this transaction, take a snapshot of the shared
+	 * statistics.
 	 */
-	backend_read_statsfile();
+	backend_snapshot_stats();
 
 	/*
 	 * Lookup the requested database; return NULL if not found
@@ -2308,10 +2170,10 @@ pgstat_fetch_stat_tabentry(Oid relid)
 	PgStat_StatTabEntry *tabentry;
 
 	/*
-	 * If not done for this transaction, read the statistics collector stats
-	 * file into some hash tables.
+	 * If not done for this transaction, take a snapshot of the shared
+	 * statistics.
 	 */
-	backend_read_statsfile();
+	backend_snapshot_stats();
 
 	/*
 	 * Lookup our database, then look in its table hash table.
@@ -2362,8 +2224,8 @@ pgstat_fetch_stat_funcentry(Oid func_id)
 	PgStat_StatDBEntry *dbentry;
 	PgStat_StatFuncEntry *funcentry = NULL;
 
-	/* load the stats file if needed */
-	backend_read_statsfile();
+	/* take a snapshot of the shared stats if needed */
+	backend_snapshot_stats();
 
 	/* Lookup our database, then find the requested function.  */
 	dbentry = pgstat_fetch_stat_dbentry(MyDatabaseId);
@@ -2448,7 +2310,7 @@ pgstat_fetch_stat_numbackends(void)
 PgStat_ArchiverStats *
 pgstat_fetch_stat_archiver(void)
 {
-	backend_read_statsfile();
+	backend_snapshot_stats();
 
 	return &archiverStats;
 }
@@ -2465,12 +2327,48 @@ pgstat_fetch_stat_archiver(void)
 PgStat_GlobalStats *
 pgstat_fetch_global(void)
 {
-	backend_read_statsfile();
+	backend_snapshot_stats();
 
 	return &globalStats;
 }
 
 
+/*
+ * ---------
+ * pgstat_fetch_io_latency() -
+ *
+ *	Support function for the SQL-callable pgstat* functions. Returns a
+ *	palloc'd copy of all I/O latency entries, and their number in *nentries.
+ *	Unlike the other fetch functions, this reads the current values rather
+ *	than the transaction's snapshot.
+ * ---------
+ */
+PgStat_StatIOEntry *
+pgstat_fetch_io_latency(int *nentries)
+{
+	HASH_SEQ_STATUS hstat;
+	PgStat_StatIOEntry *entry;
+	PgStat_StatIOEntry *result;
+	long		max_entries;
+	int			n = 0;
+
+	LWLockAcquire(PgStatLock, LW_SHARED);
+
+	max_entries = hash_get_num_entries(pgStatSharedIOHash);
+	result = (PgStat_StatIOEntry *)
+		palloc(Max(max_entries, 1) * sizeof(PgStat_StatIOEntry));
+
+	hash_seq_init(&hstat, pgStatSharedIOHash);
+	while ((entry = (PgStat_StatIOEntry *) hash_seq_search(&hstat)) != NULL)
+		memcpy(&result[n++], entry, sizeof(PgStat_StatIOEntry));
+
+	LWLockRelease(PgStatLock);
+
+	*nentries = n;
+	return result;
+}
+
+
 /* ------------------------------------------------------------
  * Functions for management of the shared-memory PgBackendStatus array
  * ------------------------------------------------------------
@@ -2742,7 +2640,7 @@ pgstat_bestart(void)
 /*
  * Shut down a single backend's statistics reporting at process exit.
  *
- * Flush any remaining statistics counts out to the collector.
+ * Flush any remaining statistics counts out to shared memory.
  * Without this, operations triggered during backend exit (such as
  * temp table deletions) won't be counted.
  *
@@ -2755,7 +2653,7 @@ pgstat_beshutdown_hook(int code, Datum arg)
 
 	/*
 	 * If we got as far as discovering our own database ID, we can report what
-	 * we did to the collector.  Otherwise, we'd be sending an invalid
+	 * we did to shared memory.  Otherwise, we'd be reporting an invalid
 	 * database ID, so forget it.  (This means that accesses to pg_database
 	 * during failed backend starts might never get counted.)
 	 */
@@ -2929,79 +2827,450 @@ pgstat_report_waiting(bool waiting)
 	beentry->st_waiting = waiting;
 }
 
-
 /* ----------
- * pgstat_read_current_status() -
+ * pgstat_get_wait_event_type() -
  *
- *	Copy the current contents of the PgBackendStatus array to local memory,
- *	if not already done in this transaction.
+ *	Return a string representing the class of the given wait event, or
+ *	NULL if the process is not waiting.
  * ----------
  */
-static void
-pgstat_read_current_status(void)
+const char *
+pgstat_get_wait_event_type(uint32 wait_event_info)
 {
-	volatile PgBackendStatus *beentry;
-	LocalPgBackendStatus *localtable;
-	LocalPgBackendStatus *localentry;
-	char	   *localappname,
-			   *localactivity;
-#ifdef USE_SSL
-	PgBackendSSLStatus *localsslstatus;
-#endif
-	int			i;
+	const char *event_type;
 
-	Assert(!pgStatRunningInCollector);
-	if (localBackendStatusTable)
-		return;					/* already done */
+	/* report process as not waiting. */
+	if (wait_event_info == 0)
+		return NULL;
 
-	pgstat_setup_memcxt();
+	switch (wait_event_info & 0xFF000000)
+	{
+		case PG_WAIT_LWLOCK:
+			event_type = "LWLock";
+			break;
+		case PG_WAIT_LOCK:
+			event_type = "Lock";
+			break;
+		case PG_WAIT_BUFFER_PIN:
+			event_type = "BufferPin";
+			break;
+		case PG_WAIT_ACTIVITY:
+			event_type = "Activity";
+			break;
+		case PG_WAIT_CLIENT:
+			event_type = "Client";
+			break;
+		case PG_WAIT_EXTENSION:
+			event_type = "Extension";
+			break;
+		case PG_WAIT_IPC:
+			event_type = "IPC";
+			break;
+		case PG_WAIT_TIMEOUT:
+			event_type = "Timeout";
+			break;
+		case PG_WAIT_IO:
+			event_type = "IO";
+			break;
+		default:
+			event_type = "???";
+			break;
+	}
 
-	localtable = (LocalPgBackendStatus *)
-		MemoryContextAlloc(pgStatLocalContext,
-						   sizeof(LocalPgBackendStatus) * MaxBackends);
-	localappname = (char *)
-		MemoryContextAlloc(pgStatLocalContext,
-						   NAMEDATALEN * MaxBackends);
-	localactivity = (char *)
-		MemoryContextAlloc(pgStatLocalContext,
-						   pgstat_track_activity_query_size * MaxBackends);
-#ifdef USE_SSL
-	localsslstatus = (PgBackendSSLStatus *)
-		MemoryContextAlloc(pgStatLocalContext,
-						   sizeof(PgBackendSSLStatus) * MaxBackends);
-#endif
+	return event_type;
+}
 
-	localNumBackends = 0;
+/* ----------
+ * pgstat_get_wait_event() -
+ *
+ *	Return a string representing the given wait event, or NULL if the
+ *	process is not waiting.
+ * ----------
+ */
+const char *
+pgstat_get_wait_event(uint32 wait_event_info)
+{
+	uint16		eventId;
+	const char *event_name;
 
-	beentry = BackendStatusArray;
-	localentry = localtable;
-	for (i = 1; i <= MaxBackends; i++)
+	/* report process as not waiting. */
+	if (wait_event_info == 0)
+		return NULL;
+
+	eventId = wait_event_info & 0x0000FFFF;
+
+	switch (wait_event_info & 0xFF000000)
 	{
-		/*
-		 * Follow the protocol of retrying if st_changecount changes while we
-		 * copy the entry, or if it's odd.  (The check for odd is needed to
-		 * cover the case where we are able to completely copy the entry while
-		 * the source backend is between increment steps.)	We use a volatile
-		 * pointer here to ensure the compiler doesn't try to get cute.
-		 */
-		for (;;)
-		{
-			int			before_changecount;
-			int			after_changecount;
+		case PG_WAIT_LWLOCK:
+			event_name = GetLWLockIdentifier(eventId);
+			break;
+		case PG_WAIT_LOCK:
+			event_name = GetLockNameFromTagType(eventId);
+			break;
+		case PG_WAIT_BUFFER_PIN:
+			event_name = "BufferPin";
+			break;
+		case PG_WAIT_ACTIVITY:
+			event_name = pgstat_get_wait_activity((WaitEventActivity) wait_event_info);
+			break;
+		case PG_WAIT_CLIENT:
+			event_name = pgstat_get_wait_client((WaitEventClient) wait_event_info);
+			break;
+		case PG_WAIT_EXTENSION:
+			event_name = "Extension";
+			break;
+		case PG_WAIT_IPC:
+			event_name = pgstat_get_wait_ipc((WaitEventIPC) wait_event_info);
+			break;
+		case PG_WAIT_TIMEOUT:
+			event_name = pgstat_get_wait_timeout((WaitEventTimeout) wait_event_info);
+			break;
+		case PG_WAIT_IO:
+			event_name = pgstat_get_wait_io((WaitEventIO) wait_event_info);
+			break;
+		default:
+			event_name = "unknown wait event";
+			break;
+	}
 
-			pgstat_save_changecount_before(beentry, before_changecount);
+	return event_name;
+}
 
-			localentry->backendStatus.st_procpid = beentry->st_procpid;
-			if (localentry->backendStatus.st_procpid > 0)
-			{
-				memcpy(&localentry->backendStatus, (char *) beentry, sizeof(PgBackendStatus));
+/* ----------
+ * pgstat_get_wait_activity() -
+ *
+ * Convert WaitEventActivity to string.
+ * ----------
+ */
+static const char *
+pgstat_get_wait_activity(WaitEventActivity w)
+{
+	const char *event_name = "unknown wait event";
 
-				/*
-				 * strcpy is safe even if the string is modified concurrently,
-				 * because there's always a \0 at the end of the buffer.
-				 */
-				strcpy(localappname, (char *) beentry->st_appname);
-				localentry->backendStatus.st_appname = localappname;
+	switch (w)
+	{
+		case WAIT_EVENT_ARCHIVER_MAIN:
+			event_name = "ArchiverMain";
+			break;
+		case WAIT_EVENT_AUTOVACUUM_MAIN:
+			event_name = "AutoVacuumMain";
+			break;
+		case WAIT_EVENT_BGWRITER_HIBERNATE:
+			event_name = "BgWriterHibernate";
+			break;
+		case WAIT_EVENT_BGWRITER_MAIN:
+			event_name = "BgWriterMain";
+			break;
+		case WAIT_EVENT_CHECKPOINTER_MAIN:
+			event_name = "CheckpointerMain";
+			break;
+		case WAIT_EVENT_LOGICAL_APPLY_MAIN:
+			event_name = "LogicalApplyMain";
+			break;
+		case WAIT_EVENT_LOGICAL_LAUNCHER_MAIN:
+			event_name = "LogicalLauncherMain";
+			break;
+		case WAIT_EVENT_LOGICAL_PARALLEL_APPLY_MAIN:
+			event_name = "LogicalParallelApplyMain";
+			break;
+		case WAIT_EVENT_PARALLEL_REDO_MAIN:
+			event_name = "ParallelRedoMain";
+			break;
+		case WAIT_EVENT_RECOVERY_WAL_ALL:
+			event_name = "RecoveryWalAll";
+			break;
+		case WAIT_EVENT_RECOVERY_WAL_STREAM:
+			event_name = "RecoveryWalStream";
+			break;
+		case WAIT_EVENT_SPARE_BACKEND_MAIN:
+			event_name = "SpareBackendMain";
+			break;
+		case WAIT_EVENT_SYSLOGGER_MAIN:
+			event_name = "SysLoggerMain";
+			break;
+		case WAIT_EVENT_WAL_RECEIVER_MAIN:
+			event_name = "WalReceiverMain";
+			break;
+		case WAIT_EVENT_WAL_SENDER_MAIN:
+			event_name = "WalSenderMain";
+			break;
+		case WAIT_EVENT_WAL_WRITER_MAIN:
+			event_name = "WalWriterMain";
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
+	return event_name;
+}
+
+/* ----------
+ * pgstat_get_wait_client() -
+ *
+ * Convert WaitEventClient to string.
+ * ----------
+ */
+static const char *
+pgstat_get_wait_client(WaitEventClient w)
+{
+	const char *event_name = "unknown wait event";
+
+	switch (w)
+	{
+		case WAIT_EVENT_CLIENT_READ:
+			event_name = "ClientRead";
+			break;
+		case WAIT_EVENT_CLIENT_WRITE:
+			event_name = "ClientWrite";
+			break;
+		case WAIT_EVENT_SSL_OPEN_SERVER:
+			event_name = "SSLOpenServer";
+			break;
+		case WAIT_EVENT_WAL_RECEIVER_WAIT_START:
+			event_name = "WalReceiverWaitStart";
+			break;
+		case WAIT_EVENT_WAL_SENDER_WAIT_WAL:
+			event_name = "WalSenderWaitForWAL";
+			break;
+		case WAIT_EVENT_WAL_SENDER_WRITE_DATA:
+			event_name = "WalSenderWriteData";
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
+	return event_name;
+}
+
+/* ----------
+ * pgstat_get_wait_ipc() -
+ *
+ * Convert WaitEventIPC to string.
+ * ----------
+ */
+static const char *
+pgstat_get_wait_ipc(WaitEventIPC w)
+{
+	const char *event_name = "unknown wait event";
+
+	switch (w)
+	{
+		case WAIT_EVENT_BGWORKER_SHUTDOWN:
+			event_name = "BgWorkerShutdown";
+			break;
+		case WAIT_EVENT_BGWORKER_STARTUP:
+			event_name = "BgWorkerStartup";
+			break;
+		case WAIT_EVENT_CLOG_GROUP_UPDATE:
+			event_name = "ClogGroupUpdate";
+			break;
+		case WAIT_EVENT_LOGICAL_APPLY_SEND_DATA:
+			event_name = "LogicalApplySendData";
+			break;
+		case WAIT_EVENT_LOGICAL_PARALLEL_APPLY_STATE_CHANGE:
+			event_name = "LogicalParallelApplyStateChange";
+			break;
+		case WAIT_EVENT_MEMORY_CONTEXT_DUMP:
+			event_name = "MemoryContextDump";
+			break;
+		case WAIT_EVENT_MQ_INTERNAL:
+			event_name = "MessageQueueInternal";
+			break;
+		case WAIT_EVENT_MQ_PUT_MESSAGE:
+			event_name = "MessageQueuePutMessage";
+			break;
+		case WAIT_EVENT_MQ_RECEIVE:
+			event_name = "MessageQueueReceive";
+			break;
+		case WAIT_EVENT_MQ_SEND:
+			event_name = "MessageQueueSend";
+			break;
+		case WAIT_EVENT_PARALLEL_COPY_RECEIVE:
+			event_name = "ParallelCopyReceive";
+			break;
+		case WAIT_EVENT_PARALLEL_COPY_SEND:
+			event_name = "ParallelCopySend";
+			break;
+		case WAIT_EVENT_PARALLEL_FINISH:
+			event_name = "ParallelFinish";
+			break;
+		case WAIT_EVENT_PARALLEL_REDO_SEND:
+			event_name = "ParallelRedoSend";
+			break;
+		case WAIT_EVENT_PARALLEL_REDO_WAIT:
+			event_name = "ParallelRedoWait";
+			break;
+		case WAIT_EVENT_PROCARRAY_GROUP_UPDATE:
+			event_name = "ProcArrayGroupUpdate";
+			break;
+		case WAIT_EVENT_SAFE_SNAPSHOT:
+			event_name = "SafeSnapshot";
+			break;
+		case WAIT_EVENT_SYNC_REP:
+			event_name = "SyncRep";
+			break;
+		case WAIT_EVENT_WAL_FLUSH_GROUP:
+			event_name = "WALFlushGroup";
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
+	return event_name;
+}
+
+/* ----------
+ * pgstat_get_wait_timeout() -
+ *
+ * Convert WaitEventTimeout to string.
+ * ----------
+ */
+static const char *
+pgstat_get_wait_timeout(WaitEventTimeout w)
+{
+	const char *event_name = "unknown wait event";
+
+	switch (w)
+	{
+		case WAIT_EVENT_BASE_BACKUP_THROTTLE:
+			event_name = "BaseBackupThrottle";
+			break;
+		case WAIT_EVENT_PG_SLEEP:
+			event_name = "PgSleep";
+			break;
+		case WAIT_EVENT_RECOVERY_APPLY_DELAY:
+			event_name = "RecoveryApplyDelay";
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
+	return event_name;
+}
+
+/* ----------
+ * pgstat_get_wait_io() -
+ *
+ * Convert WaitEventIO to string.
+ * ----------
+ */
+static const char *
+pgstat_get_wait_io(WaitEventIO w)
+{
+	const char *event_name = "unknown wait event";
+
+	switch (w)
+	{
+		case WAIT_EVENT_DATA_FILE_EXTEND:
+			event_name = "DataFileExtend";
+			break;
+		case WAIT_EVENT_DATA_FILE_READ:
+			event_name = "DataFileRead";
+			break;
+		case WAIT_EVENT_DATA_FILE_SYNC:
+			event_name = "DataFileSync";
+			break;
+		case WAIT_EVENT_DATA_FILE_WRITE:
+			event_name = "DataFileWrite";
+			break;
+		case WAIT_EVENT_SLRU_READ:
+			event_name = "SLRURead";
+			break;
+		case WAIT_EVENT_SLRU_SYNC:
+			event_name = "SLRUSync";
+			break;
+		case WAIT_EVENT_SLRU_WRITE:
+			event_name = "SLRUWrite";
+			break;
+		case WAIT_EVENT_WAL_INIT_SYNC:
+			event_name = "WALInitSync";
+			break;
+		case WAIT_EVENT_WAL_INIT_WRITE:
+			event_name = "WALInitWrite";
+			break;
+		case WAIT_EVENT_WAL_READ:
+			event_name = "WALRead";
+			break;
+		case WAIT_EVENT_WAL_SYNC:
+			event_name = "WALSync";
+			break;
+		case WAIT_EVENT_WAL_WRITE:
+			event_name = "WALWrite";
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
+	return event_name;
+}
+
+
+/* ----------
+ * pgstat_read_current_status() -
+ *
+ *	Copy the current contents of the PgBackendStatus array to local memory,
+ *	if not already done in this transaction.
+ * ----------
+ */
+static void
+pgstat_read_current_status(void)
+{
+	volatile PgBackendStatus *beentry;
+	LocalPgBackendStatus *localtable;
+	LocalPgBackendStatus *localentry;
+	char	   *localappname,
+			   *localactivity;
+#ifdef USE_SSL
+	PgBackendSSLStatus *localsslstatus;
+#endif
+	int			i;
+
+	if (localBackendStatusTable)
+		return;					/* already done */
+
+	pgstat_setup_memcxt();
+
+	localtable = (LocalPgBackendStatus *)
+		MemoryContextAlloc(pgStatLocalContext,
+						   sizeof(LocalPgBackendStatus) * MaxBackends);
+	localappname = (char *)
+		MemoryContextAlloc(pgStatLocalContext,
+						   NAMEDATALEN * MaxBackends);
+	localactivity = (char *)
+		MemoryContextAlloc(pgStatLocalContext,
+						   pgstat_track_activity_query_size * MaxBackends);
+#ifdef USE_SSL
+	localsslstatus = (PgBackendSSLStatus *)
+		MemoryContextAlloc(pgStatLocalContext,
+						   sizeof(PgBackendSSLStatus) * MaxBackends);
+#endif
+
+	localNumBackends = 0;
+
+	beentry = BackendStatusArray;
+	localentry = localtable;
+	for (i = 1; i <= MaxBackends; i++)
+	{
+		/*
+		 * Follow the protocol of retrying if st_changecount changes while we
+		 * copy the entry, or if it's odd.  (The check for odd is needed to
+		 * cover the case where we are able to completely copy the entry while
+		 * the source backend is between increment steps.)	We use a volatile
+		 * pointer here to ensure the compiler doesn't try to get cute.
+		 */
+		for (;;)
+		{
+			int			before_changecount;
+			int			after_changecount;
+
+			pgstat_save_changecount_before(beentry, before_changecount);
+
+			localentry->backendStatus.st_procpid = beentry->st_procpid;
+			if (localentry->backendStatus.st_procpid > 0)
+			{
+				memcpy(&localentry->backendStatus, (char *) beentry, sizeof(PgBackendStatus));
+
+				/*
+				 * strcpy is safe even if the string is modified concurrently,
+				 * because there's always a \0 at the end of the buffer.
+				 */
+				strcpy(localappname, (char *) beentry->st_appname);
+				localentry->backendStatus.st_appname = localappname;
 				strcpy(localactivity, (char *) beentry->st_activity);
 				localentry->backendStatus.st_activity = localactivity;
 				localentry->backendStatus.st_ssl = beentry->st_ssl;
@@ -3221,37 +3490,98 @@ pgstat_setheader(PgStat_MsgHdr *hdr, StatMsgType mtype)
 /* ----------
  * pgstat_send() -
  *
- *		Send out one statistics message to the collector
+ *		Apply one statistics message to the shared statistics
  * ----------
  */
 static void
 pgstat_send(void *msg, int len)
 {
-	int			rc;
+	PgStat_Msg *m = (PgStat_Msg *) msg;
 
-	if (pgStatSock == PGINVALID_SOCKET)
-		return;
+	m->msg_hdr.m_size = len;
 
-	((PgStat_MsgHdr *) msg)->m_size = len;
+	LWLockAcquire(PgStatLock, LW_EXCLUSIVE);
 
-	/* We'll retry after EINTR, but ignore all other failures */
-	do
+	switch (m->msg_hdr.m_type)
 	{
-		rc = send(pgStatSock, msg, len, 0);
-	} while (rc < 0 && errno == EINTR);
+		case PGSTAT_MTYPE_TABSTAT:
+			pgstat_recv_tabstat(&m->msg_tabstat, len);
+			break;
 
-#ifdef USE_ASSERT_CHECKING
-	/* In debug builds, log send failures ... */
-	if (rc < 0)
-		elog(LOG, "could not send to statistics collector: %m");
-#endif
+		case PGSTAT_MTYPE_TABPURGE:
+			pgstat_recv_tabpurge(&m->msg_tabpurge, len);
+			break;
+
+		case PGSTAT_MTYPE_DROPDB:
+			pgstat_recv_dropdb(&m->msg_dropdb, len);
+			break;
+
+		case PGSTAT_MTYPE_RESETCOUNTER:
+			pgstat_recv_resetcounter(&m->msg_resetcounter, len);
+			break;
+
+		case PGSTAT_MTYPE_RESETSHAREDCOUNTER:
+			pgstat_recv_resetsharedcounter(&m->msg_resetsharedcounter, len);
+			break;
+
+		case PGSTAT_MTYPE_RESETSINGLECOUNTER:
+			pgstat_recv_resetsinglecounter(&m->msg_resetsinglecounter, len);
+			break;
+
+		case PGSTAT_MTYPE_AUTOVAC_START:
+			pgstat_recv_autovac(&m->msg_autovacuum, len);
+			break;
+
+		case PGSTAT_MTYPE_VACUUM:
+			pgstat_recv_vacuum(&m->msg_vacuum, len);
+			break;
+
+		case PGSTAT_MTYPE_ANALYZE:
+			pgstat_recv_analyze(&m->msg_analyze, len);
+			break;
+
+		case PGSTAT_MTYPE_BGWRITER:
+			pgstat_recv_bgwriter(&m->msg_bgwriter, len);
+			break;
+
+		case PGSTAT_MTYPE_FUNCSTAT:
+			pgstat_recv_funcstat(&m->msg_funcstat, len);
+			break;
+
+		case PGSTAT_MTYPE_FUNCPURGE:
+			pgstat_recv_funcpurge(&m->msg_funcpurge, len);
+			break;
+
+		case PGSTAT_MTYPE_RECOVERYCONFLICT:
+			pgstat_recv_recoveryconflict(&m->msg_recoveryconflict, len);
+			break;
+
+		case PGSTAT_MTYPE_DEADLOCK:
+			pgstat_recv_deadlock(&m->msg_deadlock, len);
+			break;
+
+		case PGSTAT_MTYPE_TEMPFILE:
+			pgstat_recv_tempfile(&m->msg_tempfile, len);
+			break;
+
+		default:
+			/* archiver messages don't come through here */
+			elog(LOG, "unexpected statistics message type %d",
+				 (int) m->msg_hdr.m_type);
+			break;
+	}
+
+	LWLockRelease(PgStatLock);
 }
 
 /* ----------
  * pgstat_send_archiver() -
  *
- *	Tell the collector about the WAL file that we successfully
+ *	Tell the statistics system about the WAL file that we successfully
  *	archived or failed to archive.
+ *
+ *	The archiver has no PGPROC, so this bypasses PgStatLock and updates the
+ *	archiver counters under their spinlock.
  * ----------
  */
 void
@@ -3260,19 +3590,20 @@ pgstat_send_archiver(const char *xlog, bool failed)
 	PgStat_MsgArchiver msg;
 
 	/*
-	 * Prepare and send the message
+	 * Prepare and apply the message
 	 */
 	pgstat_setheader(&msg.m_hdr, PGSTAT_MTYPE_ARCHIVER);
 	msg.m_failed = failed;
 	StrNCpy(msg.m_xlog, xlog, sizeof(msg.m_xlog));
 	msg.m_timestamp = GetCurrentTimestamp();
-	pgstat_send(&msg, sizeof(msg));
+	msg.m_hdr.m_size = sizeof(msg);
+	pgstat_recv_archiver(&msg, sizeof(msg));
 }
 
 /* ----------
  * pgstat_send_bgwriter() -
  *
- *		Send bgwriter statistics to the collector
+ *		Add bgwriter statistics to the shared counters
  * ----------
  */
 void
@@ -3281,16 +3612,23 @@ pgstat_send_bgwriter(void)
 	/* We assume this initializes to zeroes */
 	static const PgStat_MsgBgWriter all_zeroes;
 
+	/* The bgwriter and checkpointer report their own I/O latencies here */
+	if (have_io_latency)
+	{
+		LWLockAcquire(PgStatLock, LW_EXCLUSIVE);
+		pgstat_send_io_latency();
+		LWLockRelease(PgStatLock);
+	}
+
 	/*
 	 * This function can be called even if nothing at all has happened. In
-	 * this case, avoid sending a completely empty message to the stats
-	 * collector.
+	 * this case, avoid taking the lock for a completely empty message.
 	 */
 	if (memcmp(&BgWriterStats, &all_zeroes, sizeof(PgStat_MsgBgWriter)) == 0)
 		return;
 
 	/*
-	 * Prepare and send the message
+	 * Prepare and apply the message
 	 */
 	pgstat_setheader(&BgWriterStats.m_hdr, PGSTAT_MTYPE_BGWRITER);
 	pgstat_send(&BgWriterStats, sizeof(BgWriterStats));
@@ -3301,446 +3639,198 @@ pgstat_send_bgwriter(void)
 	MemSet(&BgWriterStats, 0, sizeof(BgWriterStats));
 }
 
-
-/* ----------
- * PgstatCollectorMain() -
- *
- *	Start up the statistics collector process.  This is the body of the
- *	postmaster child process.
+/*
+ * Subroutine to clear stats in a database entry
  *
- *	The argc/argv parameters are valid only in EXEC_BACKEND case.
- * ----------
+ * The database's table and function entries are not touched; see
+ * pgstat_remove_db_objects.
  */
-NON_EXEC_STATIC void
-PgstatCollectorMain(int argc, char *argv[])
+static void
+reset_dbentry_counters(PgStat_StatDBEntry *dbentry)
 {
-	int			len;
-	PgStat_Msg	msg;
-	int			wr;
-
-	/*
-	 * Ignore all signals usually bound to some action in the postmaster,
-	 * except SIGHUP and SIGQUIT.  Note we don't need a SIGUSR1 handler to
-	 * support latch operations, because we only use a local latch.
-	 */
-	pqsignal(SIGHUP, pgstat_sighup_handler);
-	pqsignal(SIGINT, SIG_IGN);
-	pqsignal(SIGTERM, SIG_IGN);
-	pqsignal(SIGQUIT, pgstat_exit);
-	pqsignal(SIGALRM, SIG_IGN);
-	pqsignal(SIGPIPE, SIG_IGN);
-	pqsignal(SIGUSR1, SIG_IGN);
-	pqsignal(SIGUSR2, SIG_IGN);
-	pqsignal(SIGCHLD, SIG_DFL);
-	pqsignal(SIGTTIN, SIG_DFL);
-	pqsignal(SIGTTOU, SIG_DFL);
-	pqsignal(SIGCONT, SIG_DFL);
-	pqsignal(SIGWINCH, SIG_DFL);
-	PG_SETMASK(&UnBlockSig);
+	dbentry->n_xact_commit = 0;
+	dbentry->n_xact_rollback = 0;
+	dbentry->n_blocks_fetched = 0;
+	dbentry->n_blocks_hit = 0;
+	dbentry->n_tuples_returned = 0;
+	dbentry->n_tuples_fetched = 0;
+	dbentry->n_tuples_inserted = 0;
+	dbentry->n_tuples_updated = 0;
+	dbentry->n_tuples_deleted = 0;
+	dbentry->last_autovac_time = 0;
+	dbentry->n_conflict_tablespace = 0;
+	dbentry->n_conflict_lock = 0;
+	dbentry->n_conflict_snapshot = 0;
+	dbentry->n_conflict_bufferpin = 0;
+	dbentry->n_conflict_startup_deadlock = 0;
+	dbentry->n_temp_files = 0;
+	dbentry->n_temp_bytes = 0;
+	dbentry->n_deadlocks = 0;
+	dbentry->n_block_read_time = 0;
+	dbentry->n_block_write_time = 0;
+	dbentry->n_overflowed_snapshots = 0;
 
-	/*
-	 * Identify myself via ps
-	 */
-	init_ps_display("stats collector process", "", "", "");
+	dbentry->stat_reset_timestamp = GetCurrentTimestamp();
+	dbentry->stats_timestamp = 0;
 
-	/*
-	 * Read in an existing statistics stats file or initialize the stats to
-	 * zero.
-	 */
-	pgStatRunningInCollector = true;
-	pgStatDBHash = pgstat_read_statsfiles(InvalidOid, true, true);
-
-	/*
-	 * Loop to process messages until we get SIGQUIT or detect ungraceful
-	 * death of our parent postmaster.
-	 *
-	 * For performance reasons, we don't want to do ResetLatch/WaitLatch after
-	 * every message; instead, do that only after a recv() fails to obtain a
-	 * message.  (This effectively means that if backends are sending us stuff
-	 * like mad, we won't notice postmaster death until things slack off a
-	 * bit; which seems fine.)	To do that, we have an inner loop that
-	 * iterates as long as recv() succeeds.  We do recognize got_SIGHUP inside
-	 * the inner loop, which means that such interrupts will get serviced but
-	 * the latch won't get cleared until next time there is a break in the
-	 * action.
-	 */
-	for (;;)
-	{
-		/* Clear any already-pending wakeups */
-		ResetLatch(MyLatch);
-
-		/*
-		 * Quit if we get SIGQUIT from the postmaster.
-		 */
-		if (need_exit)
-			break;
-
-		/*
-		 * Inner loop iterates as long as we keep getting messages, or until
-		 * need_exit becomes set.
-		 */
-		while (!need_exit)
-		{
-			/*
-			 * Reload configuration if we got SIGHUP from the postmaster.
-			 */
-			if (got_SIGHUP)
-			{
-				got_SIGHUP = false;
-				ProcessConfigFile(PGC_SIGHUP);
-			}
-
-			/*
-			 * Write the stats file if a new request has arrived that is not
-			 * satisfied by existing file.
-			 */
-			if (pgstat_write_statsfile_needed())
-				pgstat_write_statsfiles(false, false);
-
-			/*
-			 * Try to receive and process a message.  This will not block,
-			 * since the socket is set to non-blocking mode.
-			 *
-			 * XXX On Windows, we have to force pgwin32_recv to cooperate,
-			 * despite the previous use of pg_set_noblock() on the socket.
-			 * This is extremely broken and should be fixed someday.
-			 */
-#ifdef WIN32
-			pgwin32_noblock = 1;
-#endif
-
-			len = recv(pgStatSock, (char *) &msg,
-					   sizeof(PgStat_Msg), 0);
-
-#ifdef WIN32
-			pgwin32_noblock = 0;
-#endif
-
-			if (len < 0)
-			{
-				if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
-					break;		/* out of inner loop */
-				ereport(ERROR,
-						(errcode_for_socket_access(),
-						 errmsg("could not read statistics message: %m")));
-			}
-
-			/*
-			 * We ignore messages that are smaller than our common header
-			 */
-			if (len < sizeof(PgStat_MsgHdr))
-				continue;
-
-			/*
-			 * The received length must match the length in the header
-			 */
-			if (msg.msg_hdr.m_size != len)
-				continue;
-
-			/*
-			 * O.K. - we accept this message.  Process it.
-			 */
-			switch (msg.msg_hdr.m_type)
-			{
-				case PGSTAT_MTYPE_DUMMY:
-					break;
-
-				case PGSTAT_MTYPE_INQUIRY:
-					pgstat_recv_inquiry((PgStat_MsgInquiry *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_TABSTAT:
-					pgstat_recv_tabstat((PgStat_MsgTabstat *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_TABPURGE:
-					pgstat_recv_tabpurge((PgStat_MsgTabpurge *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_DROPDB:
-					pgstat_recv_dropdb((PgStat_MsgDropdb *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_RESETCOUNTER:
-					pgstat_recv_resetcounter((PgStat_MsgResetcounter *) &msg,
-											 len);
-					break;
-
-				case PGSTAT_MTYPE_RESETSHAREDCOUNTER:
-					pgstat_recv_resetsharedcounter(
-									   (PgStat_MsgResetsharedcounter *) &msg,
-												   len);
-					break;
-
-				case PGSTAT_MTYPE_RESETSINGLECOUNTER:
-					pgstat_recv_resetsinglecounter(
-									   (PgStat_MsgResetsinglecounter *) &msg,
-												   len);
-					break;
-
-				case PGSTAT_MTYPE_AUTOVAC_START:
-					pgstat_recv_autovac((PgStat_MsgAutovacStart *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_VACUUM:
-					pgstat_recv_vacuum((PgStat_MsgVacuum *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_ANALYZE:
-					pgstat_recv_analyze((PgStat_MsgAnalyze *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_ARCHIVER:
-					pgstat_recv_archiver((PgStat_MsgArchiver *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_BGWRITER:
-					pgstat_recv_bgwriter((PgStat_MsgBgWriter *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_FUNCSTAT:
-					pgstat_recv_funcstat((PgStat_MsgFuncstat *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_FUNCPURGE:
-					pgstat_recv_funcpurge((PgStat_MsgFuncpurge *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_RECOVERYCONFLICT:
-					pgstat_recv_recoveryconflict((PgStat_MsgRecoveryConflict *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_DEADLOCK:
-					pgstat_recv_deadlock((PgStat_MsgDeadlock *) &msg, len);
-					break;
-
-				case PGSTAT_MTYPE_TEMPFILE:
-					pgstat_recv_tempfile((PgStat_MsgTempFile *) &msg, len);
-					break;
-
-				default:
-					break;
-			}
-		}						/* end of inner message-processing loop */
-
-		/* Sleep until there's something to do */
-#ifndef WIN32
-		wr = WaitLatchOrSocket(MyLatch,
-					 WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_SOCKET_READABLE,
-							   pgStatSock,
-							   -1L);
-#else
-
-		/*
-		 * Windows, at least in its Windows Server 2003 R2 incarnation,
-		 * sometimes loses FD_READ events.  Waking up and retrying the recv()
-		 * fixes that, so don't sleep indefinitely.  This is a crock of the
-		 * first water, but until somebody wants to debug exactly what's
-		 * happening there, this is the best we can do.  The two-second
-		 * timeout matches our pre-9.2 behavior, and needs to be short enough
-		 * to not provoke "using stale statistics" complaints from
-		 * backend_read_statsfile.
-		 */
-		wr = WaitLatchOrSocket(MyLatch,
-		WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_SOCKET_READABLE | WL_TIMEOUT,
-							   pgStatSock,
-							   2 * 1000L /* msec */ );
-#endif
-
-		/*
-		 * Emergency bailout if postmaster has died.  This is to avoid the
-		 * necessity for manual cleanup of all postmaster children.
-		 */
-		if (wr & WL_POSTMASTER_DEATH)
-			break;
-	}							/* end of outer loop */
-
-	/*
-	 * Save the final stats to reuse at next startup.
-	 */
-	pgstat_write_statsfiles(true, true);
-
-	exit(0);
-}
-
-
-/* SIGQUIT signal handler for collector process */
-static void
-pgstat_exit(SIGNAL_ARGS)
-{
-	int			save_errno = errno;
-
-	need_exit = true;
-	SetLatch(MyLatch);
-
-	errno = save_errno;
-}
-
-/* SIGHUP handler for collector process */
-static void
-pgstat_sighup_handler(SIGNAL_ARGS)
-{
-	int			save_errno = errno;
-
-	got_SIGHUP = true;
-	SetLatch(MyLatch);
-
-	errno = save_errno;
-}
-
-/*
- * Subroutine to clear stats in a database entry
- *
- * Tables and functions hashes are initialized to empty.
- */
-static void
-reset_dbentry_counters(PgStat_StatDBEntry *dbentry)
-{
-	HASHCTL		hash_ctl;
-
-	dbentry->n_xact_commit = 0;
-	dbentry->n_xact_rollback = 0;
-	dbentry->n_blocks_fetched = 0;
-	dbentry->n_blocks_hit = 0;
-	dbentry->n_tuples_returned = 0;
-	dbentry->n_tuples_fetched = 0;
-	dbentry->n_tuples_inserted = 0;
-	dbentry->n_tuples_updated = 0;
-	dbentry->n_tuples_deleted = 0;
-	dbentry->last_autovac_time = 0;
-	dbentry->n_conflict_tablespace = 0;
-	dbentry->n_conflict_lock = 0;
-	dbentry->n_conflict_snapshot = 0;
-	dbentry->n_conflict_bufferpin = 0;
-	dbentry->n_conflict_startup_deadlock = 0;
-	dbentry->n_temp_files = 0;
-	dbentry->n_temp_bytes = 0;
-	dbentry->n_deadlocks = 0;
-	dbentry->n_block_read_time = 0;
-	dbentry->n_block_write_time = 0;
-
-	dbentry->stat_reset_timestamp = GetCurrentTimestamp();
-	dbentry->stats_timestamp = 0;
-
-	memset(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(Oid);
-	hash_ctl.entrysize = sizeof(PgStat_StatTabEntry);
-	dbentry->tables = hash_create("Per-database table",
-								  PGSTAT_TAB_HASH_SIZE,
-								  &hash_ctl,
-								  HASH_ELEM | HASH_BLOBS);
-
-	hash_ctl.keysize = sizeof(Oid);
-	hash_ctl.entrysize = sizeof(PgStat_StatFuncEntry);
-	dbentry->functions = hash_create("Per-database function",
-									 PGSTAT_FUNCTION_HASH_SIZE,
-									 &hash_ctl,
-									 HASH_ELEM | HASH_BLOBS);
+	dbentry->tables = NULL;
+	dbentry->functions = NULL;
 }
 
 /*
- * Lookup the hash table entry for the specified database. If no hash
+ * Lookup the shared hash table entry for the specified database. If no hash
  * table entry exists, initialize it, if the create parameter is true.
- * Else, return NULL.
+ * Else, return NULL.  NULL is also returned if we run out of shared memory
+ * for a new entry.
+ *
+ * Caller must hold PgStatLock, exclusively if create is true.
  */
 static PgStat_StatDBEntry *
 pgstat_get_db_entry(Oid databaseid, bool create)
 {
 	PgStat_StatDBEntry *result;
 	bool		found;
-	HASHACTION	action = (create ? HASH_ENTER : HASH_FIND);
+	HASHACTION	action = (create ? HASH_ENTER_NULL : HASH_FIND);
 
 	/* Lookup or create the hash table entry for this database */
-	result = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
+	result = (PgStat_StatDBEntry *) hash_search(pgStatSharedDBHash,
 												&databaseid,
 												action, &found);
 
-	if (!create && !found)
+	if (result == NULL)
 		return NULL;
 
-	/*
-	 * If not found, initialize the new one.  This creates empty hash tables
-	 * for tables and functions, too.
-	 */
+	/* If not found, initialize the new one. */
 	if (!found)
 		reset_dbentry_counters(result);
 
 	return result;
 }
 
-
 /*
- * Lookup the hash table entry for the specified table. If no hash
- * table entry exists, initialize it, if the create parameter is true.
- * Else, return NULL.
+ * Lookup the shared hash table entry for the specified table or function.
+ * If no hash table entry exists, initialize it to zeroes, if the create
+ * parameter is true.  Else, return NULL.  NULL is also returned if the
+ * hash table is full; we complain about that once per process.
+ *
+ * Caller must hold PgStatLock, exclusively if create is true.
  */
-static PgStat_StatTabEntry *
-pgstat_get_tab_entry(PgStat_StatDBEntry *dbentry, Oid tableoid, bool create)
+static PgStatObjectEntry *
+pgstat_get_object_entry(Oid databaseid, Oid objectid, uint32 kind,
+						bool create)
 {
-	PgStat_StatTabEntry *result;
+	PgStatObjectEntry *result;
+	PgStatObjectKey key;
 	bool		found;
-	HASHACTION	action = (create ? HASH_ENTER : HASH_FIND);
+	HASHACTION	action = (create ? HASH_ENTER_NULL : HASH_FIND);
 
-	/* Lookup or create the hash table entry for this table */
-	result = (PgStat_StatTabEntry *) hash_search(dbentry->tables,
-												 &tableoid,
-												 action, &found);
+	/* Make sure any padding bytes in the key are zero */
+	MemSet(&key, 0, sizeof(key));
+	key.databaseid = databaseid;
+	key.objectid = objectid;
+	key.kind = kind;
 
-	if (!create && !found)
+	result = (PgStatObjectEntry *) hash_search(pgStatSharedObjectHash,
+											   &key, action, &found);
+
+	if (result == NULL)
+	{
+		if (create && !pgstat_objects_full_reported)
+		{
+			pgstat_objects_full_reported = true;
+			ereport(LOG,
+					(errmsg("too many objects to track statistics for"),
+					 errhint("You might need to increase max_stats_objects.")));
+		}
 		return NULL;
+	}
 
-	/* If not found, initialize the new one. */
 	if (!found)
 	{
-		result->numscans = 0;
-		result->tuples_returned = 0;
-		result->tuples_fetched = 0;
-		result->tuples_inserted = 0;
-		result->tuples_updated = 0;
-		result->tuples_deleted = 0;
-		result->tuples_hot_updated = 0;
-		result->n_live_tuples = 0;
-		result->n_dead_tuples = 0;
-		result->changes_since_analyze = 0;
-		result->blocks_fetched = 0;
-		result->blocks_hit = 0;
-		result->vacuum_timestamp = 0;
-		result->vacuum_count = 0;
-		result->autovac_vacuum_timestamp = 0;
-		result->autovac_vacuum_count = 0;
-		result->analyze_timestamp = 0;
-		result->analyze_count = 0;
-		result->autovac_analyze_timestamp = 0;
-		result->autovac_analyze_count = 0;
+		MemSet(&result->u, 0, sizeof(result->u));
+		if (kind == PGSTAT_KIND_TABLE)
+			result->u.table.tableid = objectid;
+		else
+			result->u.function.functionid = objectid;
 	}
 
 	return result;
 }
 
+/*
+ * Lookup the shared hash table entry for the specified table; a wrapper
+ * around pgstat_get_object_entry.
+ */
+static PgStat_StatTabEntry *
+pgstat_get_tab_entry(Oid databaseid, Oid tableoid, bool create)
+{
+	PgStatObjectEntry *entry;
 
-/* ----------
- * pgstat_write_statsfiles() -
- *		Write the global statistics file, as well as requested DB files.
+	entry = pgstat_get_object_entry(databaseid, tableoid, PGSTAT_KIND_TABLE,
+									create);
+
+	return entry ? &entry->u.table : NULL;
+}
+
+/*
+ * Remove the table, function and relation file I/O entries belonging to a
+ * database.
  *
- *	If writing to the permanent files (happens when the collector is
- *	shutting down only), remove the temporary files so that backends
- *	starting up under a new postmaster can't read the old data before
- *	the new collector is ready.
+ * Caller must hold PgStatLock exclusively.
+ */
+static void
+pgstat_remove_db_objects(Oid databaseid)
+{
+	HASH_SEQ_STATUS hstat;
+	PgStatObjectEntry *entry;
+	PgStat_StatIOEntry *ioentry;
+
+	/* dynahash allows removing the entry just returned by the scan */
+	hash_seq_init(&hstat, pgStatSharedObjectHash);
+	while ((entry = (PgStatObjectEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		if (entry->key.databaseid != databaseid)
+			continue;
+
+		if (hash_search(pgStatSharedObjectHash, &entry->key,
+						HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "statistics hash table corrupted");
+	}
+
+	/* databaseid is never InvalidOid here, so tablespace totals survive */
+	hash_seq_init(&hstat, pgStatSharedIOHash);
+	while ((ioentry = (PgStat_StatIOEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		if (ioentry->rnode.dbNode != databaseid)
+			continue;
+
+		if (hash_search(pgStatSharedIOHash, &ioentry->rnode,
+						HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "statistics hash table corrupted");
+	}
+}
+
+
+/* ----------
+ * pgstat_write_statsfile() -
+ *		Write the shared statistics out to the permanent stats file.
  *
- *	When 'allDbs' is false, only the requested databases (listed in
- *	last_statrequests) will be written; otherwise, all databases will be
- *	written.
+ *	Called by the checkpointer at shutdown, after the shutdown checkpoint.
+ *	This is the only time statistics are written to disk.
  * ----------
  */
-static void
-pgstat_write_statsfiles(bool permanent, bool allDbs)
+void
+pgstat_write_statsfile(void)
 {
 	HASH_SEQ_STATUS hstat;
 	PgStat_StatDBEntry *dbentry;
+	PgStatObjectEntry *objentry;
+	PgStat_StatIOEntry *ioentry;
+	PgStat_ArchiverStats archiver;
 	FILE	   *fpout;
 	int32		format_id;
-	const char *tmpfile = permanent ? PGSTAT_STAT_PERMANENT_TMPFILE : pgstat_stat_tmpname;
-	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
+	const char *tmpfile = PGSTAT_STAT_PERMANENT_TMPFILE;
+	const char *statfile = PGSTAT_STAT_PERMANENT_FILENAME;
 	int			rc;
 
 	elog(DEBUG2, "writing stats file \"%s\"", statfile);
@@ -3758,10 +3848,11 @@ pgstat_write_statsfiles(bool permanent, bool allDbs)
 		return;
 	}
 
-	/*
-	 * Set the timestamp of the stats file.
-	 */
-	globalStats.stats_timestamp = GetCurrentTimestamp();
+	SpinLockAcquire(&pgStatShared->archiver_lck);
+	memcpy(&archiver, &pgStatShared->archiverStats, sizeof(archiver));
+	SpinLockRelease(&pgStatShared->archiver_lck);
+
+	LWLockAcquire(PgStatLock, LW_SHARED);
 
 	/*
 	 * Write the file header --- currently just a format ID.
@@ -3773,197 +3864,65 @@ pgstat_write_statsfiles(bool permanent, bool allDbs)
 	/*
 	 * Write global stats struct
 	 */
-	rc = fwrite(&globalStats, sizeof(globalStats), 1, fpout);
+	rc = fwrite(&pgStatShared->globalStats, sizeof(PgStat_GlobalStats), 1,
+				fpout);
 	(void) rc;					/* we'll check for error with ferror */
 
 	/*
 	 * Write archiver stats struct
 	 */
-	rc = fwrite(&archiverStats, sizeof(archiverStats), 1, fpout);
+	rc = fwrite(&archiver, sizeof(archiver), 1, fpout);
 	(void) rc;					/* we'll check for error with ferror */
 
 	/*
-	 * Walk through the database table.
+	 * Walk through the database table.  We don't write the tables or
+	 * functions pointers, since they're of no use to any other process.
 	 */
-	hash_seq_init(&hstat, pgStatDBHash);
+	hash_seq_init(&hstat, pgStatSharedDBHash);
 	while ((dbentry = (PgStat_StatDBEntry *) hash_seq_search(&hstat)) != NULL)
 	{
-		/*
-		 * Write out the tables and functions into the DB stat file, if
-		 * required.
-		 *
-		 * We need to do this before the dbentry write, to ensure the
-		 * timestamps written to both are consistent.
-		 */
-		if (allDbs || pgstat_db_requested(dbentry->databaseid))
-		{
-			dbentry->stats_timestamp = globalStats.stats_timestamp;
-			pgstat_write_db_statsfile(dbentry, permanent);
-		}
-
-		/*
-		 * Write out the DB entry. We don't write the tables or functions
-		 * pointers, since they're of no use to any other process.
-		 */
 		fputc('D', fpout);
 		rc = fwrite(dbentry, offsetof(PgStat_StatDBEntry, tables), 1, fpout);
 		(void) rc;				/* we'll check for error with ferror */
 	}
 
 	/*
-	 * No more output to be done. Close the temp file and replace the old
-	 * pgstat.stat with it.  The ferror() check replaces testing for error
-	 * after each individual fputc or fwrite above.
+	 * Walk through the table and function entries, each preceded by the OID
+	 * of the database it belongs to.
 	 */
-	fputc('E', fpout);
-
-	if (ferror(fpout))
+	hash_seq_init(&hstat, pgStatSharedObjectHash);
+	while ((objentry = (PgStatObjectEntry *) hash_seq_search(&hstat)) != NULL)
 	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-			   errmsg("could not write temporary statistics file \"%s\": %m",
-					  tmpfile)));
-		FreeFile(fpout);
-		unlink(tmpfile);
-	}
-	else if (FreeFile(fpout) < 0)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-			   errmsg("could not close temporary statistics file \"%s\": %m",
-					  tmpfile)));
-		unlink(tmpfile);
-	}
-	else if (rename(tmpfile, statfile) < 0)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not rename temporary statistics file \"%s\" to \"%s\": %m",
-						tmpfile, statfile)));
-		unlink(tmpfile);
-	}
-
-	if (permanent)
-		unlink(pgstat_stat_filename);
-
-	/*
-	 * Now throw away the list of requests.  Note that requests sent after we
-	 * started the write are still waiting on the network socket.
-	 */
-	if (!slist_is_empty(&last_statrequests))
-	{
-		slist_mutable_iter iter;
-
-		/*
-		 * Strictly speaking we should do slist_delete_current() before
-		 * freeing each request struct.  We skip that and instead
-		 * re-initialize the list header at the end.  Nonetheless, we must use
-		 * slist_foreach_modify, not just slist_foreach, since we will free
-		 * the node's storage before advancing.
-		 */
-		slist_foreach_modify(iter, &last_statrequests)
+		if (objentry->key.kind == PGSTAT_KIND_TABLE)
 		{
-			DBWriteRequest *req;
-
-			req = slist_container(DBWriteRequest, next, iter.cur);
-			pfree(req);
+			fputc('T', fpout);
+			rc = fwrite(&objentry->key.databaseid, sizeof(Oid), 1, fpout);
+			rc = fwrite(&objentry->u.table, sizeof(PgStat_StatTabEntry), 1,
+						fpout);
+		}
+		else
+		{
+			fputc('F', fpout);
+			rc = fwrite(&objentry->key.databaseid, sizeof(Oid), 1, fpout);
+			rc = fwrite(&objentry->u.function, sizeof(PgStat_StatFuncEntry), 1,
+						fpout);
 		}
-
-		slist_init(&last_statrequests);
-	}
-}
-
-/*
- * return the filename for a DB stat file; filename is the output buffer,
- * of length len.
- */
-static void
-get_dbstat_filename(bool permanent, bool tempname, Oid databaseid,
-					char *filename, int len)
-{
-	int			printed;
-
-	/* NB -- pgstat_reset_remove_files knows about the pattern this uses */
-	printed = snprintf(filename, len, "%s/db_%u.%s",
-					   permanent ? PGSTAT_STAT_PERMANENT_DIRECTORY :
-					   pgstat_stat_directory,
-					   databaseid,
-					   tempname ? "tmp" : "stat");
-	if (printed > len)
-		elog(ERROR, "overlength pgstat path");
-}
-
-/* ----------
- * pgstat_write_db_statsfile() -
- *		Write the stat file for a single database.
- *
- *	If writing to the permanent file (happens when the collector is
- *	shutting down only), remove the temporary file so that backends
- *	starting up under a new postmaster can't read the old data before
- *	the new collector is ready.
- * ----------
- */
-static void
-pgstat_write_db_statsfile(PgStat_StatDBEntry *dbentry, bool permanent)
-{
-	HASH_SEQ_STATUS tstat;
-	HASH_SEQ_STATUS fstat;
-	PgStat_StatTabEntry *tabentry;
-	PgStat_StatFuncEntry *funcentry;
-	FILE	   *fpout;
-	int32		format_id;
-	Oid			dbid = dbentry->databaseid;
-	int			rc;
-	char		tmpfile[MAXPGPATH];
-	char		statfile[MAXPGPATH];
-
-	get_dbstat_filename(permanent, true, dbid, tmpfile, MAXPGPATH);
-	get_dbstat_filename(permanent, false, dbid, statfile, MAXPGPATH);
-
-	elog(DEBUG2, "writing stats file \"%s\"", statfile);
-
-	/*
-	 * Open the statistics temp file to write out the current values.
-	 */
-	fpout = AllocateFile(tmpfile, PG_BINARY_W);
-	if (fpout == NULL)
-	{
-		ereport(LOG,
-				(errcode_for_file_access(),
-				 errmsg("could not open temporary statistics file \"%s\": %m",
-						tmpfile)));
-		return;
-	}
-
-	/*
-	 * Write the file header --- currently just a format ID.
-	 */
-	format_id = PGSTAT_FILE_FORMAT_ID;
-	rc = fwrite(&format_id, sizeof(format_id), 1, fpout);
-	(void) rc;					/* we'll check for error with ferror */
-
-	/*
-	 * Walk through the database's access stats per table.
-	 */
-	hash_seq_init(&tstat, dbentry->tables);
-	while ((tabentry = (PgStat_StatTabEntry *) hash_seq_search(&tstat)) != NULL)
-	{
-		fputc('T', fpout);
-		rc = fwrite(tabentry, sizeof(PgStat_StatTabEntry), 1, fpout);
 		(void) rc;				/* we'll check for error with ferror */
 	}
 
 	/*
-	 * Walk through the database's function stats table.
+	 * Walk through the relation file and tablespace I/O latency entries.
 	 */
-	hash_seq_init(&fstat, dbentry->functions);
-	while ((funcentry = (PgStat_StatFuncEntry *) hash_seq_search(&fstat)) != NULL)
+	hash_seq_init(&hstat, pgStatSharedIOHash);
+	while ((ioentry = (PgStat_StatIOEntry *) hash_seq_search(&hstat)) != NULL)
 	{
-		fputc('F', fpout);
-		rc = fwrite(funcentry, sizeof(PgStat_StatFuncEntry), 1, fpout);
+		fputc('I', fpout);
+		rc = fwrite(ioentry, sizeof(PgStat_StatIOEntry), 1, fpout);
 		(void) rc;				/* we'll check for error with ferror */
 	}
 
+	LWLockRelease(PgStatLock);
+
 	/*
 	 * No more output to be done. Close the temp file and replace the old
 	 * pgstat.stat with it.  The ferror() check replaces testing for error
@@ -3996,469 +3955,86 @@ pgstat_write_db_statsfile(PgStat_StatDBEntry *dbentry, bool permanent)
 						tmpfile, statfile)));
 		unlink(tmpfile);
 	}
-
-	if (permanent)
-	{
-		get_dbstat_filename(false, false, dbid, statfile, MAXPGPATH);
-
-		elog(DEBUG2, "removing temporary stats file \"%s\"", statfile);
-		unlink(statfile);
-	}
 }
 
 /* ----------
- * pgstat_read_statsfiles() -
- *
- *	Reads in the existing statistics collector files and initializes the
- *	databases' hash table.  If the permanent file name is requested (which
- *	only happens in the stats collector itself), also remove the file after
- *	reading; the in-memory status is now authoritative, and the permanent file
- *	would be out of date in case somebody else reads it.
- *
- *	If a deep read is requested, table/function stats are read also, otherwise
- *	the table/function hash tables remain empty.
- * ----------
- */
-static HTAB *
-pgstat_read_statsfiles(Oid onlydb, bool permanent, bool deep)
-{
-	PgStat_StatDBEntry *dbentry;
-	PgStat_StatDBEntry dbbuf;
-	HASHCTL		hash_ctl;
-	HTAB	   *dbhash;
-	FILE	   *fpin;
-	int32		format_id;
-	bool		found;
-	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
-
-	/*
-	 * The tables will live in pgStatLocalContext.
-	 */
-	pgstat_setup_memcxt();
-
-	/*
-	 * Create the DB hashtable
-	 */
-	memset(&hash_ctl, 0, sizeof(hash_ctl));
-	hash_ctl.keysize = sizeof(Oid);
-	hash_ctl.entrysize = sizeof(PgStat_StatDBEntry);
-	hash_ctl.hcxt = pgStatLocalContext;
-	dbhash = hash_create("Databases hash", PGSTAT_DB_HASH_SIZE, &hash_ctl,
-						 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-	/*
-	 * Clear out global and archiver statistics so they start from zero in
-	 * case we can't load an existing statsfile.
-	 */
-	memset(&globalStats, 0, sizeof(globalStats));
-	memset(&archiverStats, 0, sizeof(archiverStats));
-
-	/*
-	 * Set the current timestamp (will be kept only in case we can't load an
-	 * existing statsfile).
-	 */
-	globalStats.stat_reset_timestamp = GetCurrentTimestamp();
-	archiverStats.stat_reset_timestamp = globalStats.stat_reset_timestamp;
-
-	/*
-	 * Try to open the stats file. If it doesn't exist, the backends simply
-	 * return zero for anything and the collector simply starts from scratch
-	 * with empty counters.
-	 *
-	 * ENOENT is a possibility if the stats collector is not running or has
-	 * not yet written the stats file the first time.  Any other failure
-	 * condition is suspicious.
-	 */
-	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
-	{
-		if (errno != ENOENT)
-			ereport(pgStatRunningInCollector ? LOG : WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not open statistics file \"%s\": %m",
-							statfile)));
-		return dbhash;
-	}
-
-	/*
-	 * Verify it's of the expected format.
-	 */
-	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
-		format_id != PGSTAT_FILE_FORMAT_ID)
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		goto done;
-	}
-
-	/*
-	 * Read global stats struct
-	 */
-	if (fread(&globalStats, 1, sizeof(globalStats), fpin) != sizeof(globalStats))
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		goto done;
-	}
-
-	/*
-	 * Read archiver stats struct
-	 */
-	if (fread(&archiverStats, 1, sizeof(archiverStats), fpin) != sizeof(archiverStats))
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		goto done;
-	}
-
-	/*
-	 * We found an existing collector stats file. Read it and put all the
-	 * hashtable entries into place.
-	 */
-	for (;;)
-	{
-		switch (fgetc(fpin))
-		{
-				/*
-				 * 'D'	A PgStat_StatDBEntry struct describing a database
-				 * follows.
-				 */
-			case 'D':
-				if (fread(&dbbuf, 1, offsetof(PgStat_StatDBEntry, tables),
-						  fpin) != offsetof(PgStat_StatDBEntry, tables))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * Add to the DB hash
-				 */
-				dbentry = (PgStat_StatDBEntry *) hash_search(dbhash,
-												  (void *) &dbbuf.databaseid,
-															 HASH_ENTER,
-															 &found);
-				if (found)
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				memcpy(dbentry, &dbbuf, sizeof(PgStat_StatDBEntry));
-				dbentry->tables = NULL;
-				dbentry->functions = NULL;
-
-				/*
-				 * Don't collect tables if not the requested DB (or the
-				 * shared-table info)
-				 */
-				if (onlydb != InvalidOid)
-				{
-					if (dbbuf.databaseid != onlydb &&
-						dbbuf.databaseid != InvalidOid)
-						break;
-				}
-
-				memset(&hash_ctl, 0, sizeof(hash_ctl));
-				hash_ctl.keysize = sizeof(Oid);
-				hash_ctl.entrysize = sizeof(PgStat_StatTabEntry);
-				hash_ctl.hcxt = pgStatLocalContext;
-				dbentry->tables = hash_create("Per-database table",
-											  PGSTAT_TAB_HASH_SIZE,
-											  &hash_ctl,
-									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-				hash_ctl.keysize = sizeof(Oid);
-				hash_ctl.entrysize = sizeof(PgStat_StatFuncEntry);
-				hash_ctl.hcxt = pgStatLocalContext;
-				dbentry->functions = hash_create("Per-database function",
-												 PGSTAT_FUNCTION_HASH_SIZE,
-												 &hash_ctl,
-									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
-
-				/*
-				 * If requested, read the data from the database-specific
-				 * file. If there was onlydb specified (!= InvalidOid), we
-				 * would not get here because of a break above. So we don't
-				 * need to recheck.
-				 */
-				if (deep)
-					pgstat_read_db_statsfile(dbentry->databaseid,
-											 dbentry->tables,
-											 dbentry->functions,
-											 permanent);
-
-				break;
-
-			case 'E':
-				goto done;
-
-			default:
-				ereport(pgStatRunningInCollector ? LOG : WARNING,
-						(errmsg("corrupted statistics file \"%s\"",
-								statfile)));
-				goto done;
-		}
-	}
-
-done:
-	FreeFile(fpin);
-
-	/* If requested to read the permanent file, also get rid of it. */
-	if (permanent)
-	{
-		elog(DEBUG2, "removing permanent stats file \"%s\"", statfile);
-		unlink(statfile);
-	}
-
-	return dbhash;
-}
-
-
-/* ----------
- * pgstat_read_db_statsfile() -
- *
- *	Reads in the existing statistics collector file for the given database,
- *	and initializes the tables and functions hash tables.
- *
- *	As pgstat_read_statsfiles, if the permanent file is requested, it is
- *	removed after reading.
- * ----------
- */
-static void
-pgstat_read_db_statsfile(Oid databaseid, HTAB *tabhash, HTAB *funchash,
-						 bool permanent)
-{
-	PgStat_StatTabEntry *tabentry;
-	PgStat_StatTabEntry tabbuf;
-	PgStat_StatFuncEntry funcbuf;
-	PgStat_StatFuncEntry *funcentry;
-	FILE	   *fpin;
-	int32		format_id;
-	bool		found;
-	char		statfile[MAXPGPATH];
-
-	get_dbstat_filename(permanent, false, databaseid, statfile, MAXPGPATH);
-
-	/*
-	 * Try to open the stats file. If it doesn't exist, the backends simply
-	 * return zero for anything and the collector simply starts from scratch
-	 * with empty counters.
-	 *
-	 * ENOENT is a possibility if the stats collector is not running or has
-	 * not yet written the stats file the first time.  Any other failure
-	 * condition is suspicious.
-	 */
-	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
-	{
-		if (errno != ENOENT)
-			ereport(pgStatRunningInCollector ? LOG : WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not open statistics file \"%s\": %m",
-							statfile)));
-		return;
-	}
-
-	/*
-	 * Verify it's of the expected format.
-	 */
-	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
-		format_id != PGSTAT_FILE_FORMAT_ID)
-	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
-				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		goto done;
-	}
-
-	/*
-	 * We found an existing collector stats file. Read it and put all the
-	 * hashtable entries into place.
-	 */
-	for (;;)
-	{
-		switch (fgetc(fpin))
-		{
-				/*
-				 * 'T'	A PgStat_StatTabEntry follows.
-				 */
-			case 'T':
-				if (fread(&tabbuf, 1, sizeof(PgStat_StatTabEntry),
-						  fpin) != sizeof(PgStat_StatTabEntry))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * Skip if table belongs to a not requested database.
-				 */
-				if (tabhash == NULL)
-					break;
-
-				tabentry = (PgStat_StatTabEntry *) hash_search(tabhash,
-													(void *) &tabbuf.tableid,
-														 HASH_ENTER, &found);
-
-				if (found)
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				memcpy(tabentry, &tabbuf, sizeof(tabbuf));
-				break;
-
-				/*
-				 * 'F'	A PgStat_StatFuncEntry follows.
-				 */
-			case 'F':
-				if (fread(&funcbuf, 1, sizeof(PgStat_StatFuncEntry),
-						  fpin) != sizeof(PgStat_StatFuncEntry))
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				/*
-				 * Skip if function belongs to a not requested database.
-				 */
-				if (funchash == NULL)
-					break;
-
-				funcentry = (PgStat_StatFuncEntry *) hash_search(funchash,
-												(void *) &funcbuf.functionid,
-														 HASH_ENTER, &found);
-
-				if (found)
-				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
-							(errmsg("corrupted statistics file \"%s\"",
-									statfile)));
-					goto done;
-				}
-
-				memcpy(funcentry, &funcbuf, sizeof(funcbuf));
-				break;
-
-				/*
-				 * 'E'	The EOF marker of a complete stats file.
-				 */
-			case 'E':
-				goto done;
-
-			default:
-				ereport(pgStatRunningInCollector ? LOG : WARNING,
-						(errmsg("corrupted statistics file \"%s\"",
-								statfile)));
-				goto done;
-		}
-	}
-
-done:
-	FreeFile(fpin);
-
-	if (permanent)
-	{
-		elog(DEBUG2, "removing permanent stats file \"%s\"", statfile);
-		unlink(statfile);
-	}
-
-	return;
-}
-
-/* ----------
- * pgstat_read_db_statsfile_timestamp() -
- *
- *	Attempt to determine the timestamp of the last db statfile write.
- *	Returns TRUE if successful; the timestamp is stored in *ts.
- *
- *	This needs to be careful about handling databases for which no stats file
- *	exists, such as databases without a stat entry or those not yet written:
- *
- *	- if there's a database entry in the global file, return the corresponding
- *	stats_timestamp value.
+ * pgstat_read_statsfile() -
  *
- *	- if there's no db stat entry (e.g. for a new or inactive database),
- *	there's no stats_timestamp value, but also nothing to write so we return
- *	the timestamp of the global statfile.
+ *	Reads in the permanent statistics file written at the last shutdown
+ *	and loads it into shared memory.  Called by the startup process before
+ *	any backend can report statistics.  The file is removed after reading;
+ *	the shared memory contents are now authoritative, and the file would be
+ *	out of date in case somebody read it again after a crash.
  * ----------
  */
-static bool
-pgstat_read_db_statsfile_timestamp(Oid databaseid, bool permanent,
-								   TimestampTz *ts)
+void
+pgstat_read_statsfile(void)
 {
-	PgStat_StatDBEntry dbentry;
-	PgStat_GlobalStats myGlobalStats;
-	PgStat_ArchiverStats myArchiverStats;
+	PgStat_StatDBEntry dbbuf;
+	PgStat_StatDBEntry *dbentry;
+	PgStat_StatTabEntry tabbuf;
+	PgStat_StatFuncEntry funcbuf;
+	PgStat_StatIOEntry iobuf;
+	PgStatObjectEntry *objentry;
+	PgStat_StatIOEntry *ioentry;
+	Oid			dbid;
 	FILE	   *fpin;
 	int32		format_id;
-	const char *statfile = permanent ? PGSTAT_STAT_PERMANENT_FILENAME : pgstat_stat_filename;
+	bool		found;
+	const char *statfile = PGSTAT_STAT_PERMANENT_FILENAME;
 
 	/*
-	 * Try to open the stats file.  As above, anything but ENOENT is worthy of
-	 * complaining about.
+	 * Try to open the stats file. If it doesn't exist, we simply start from
+	 * scratch with empty counters.
 	 */
 	if ((fpin = AllocateFile(statfile, PG_BINARY_R)) == NULL)
 	{
 		if (errno != ENOENT)
-			ereport(pgStatRunningInCollector ? LOG : WARNING,
+			ereport(LOG,
 					(errcode_for_file_access(),
 					 errmsg("could not open statistics file \"%s\": %m",
 							statfile)));
-		return false;
+		return;
 	}
 
+	LWLockAcquire(PgStatLock, LW_EXCLUSIVE);
+
 	/*
 	 * Verify it's of the expected format.
 	 */
 	if (fread(&format_id, 1, sizeof(format_id), fpin) != sizeof(format_id) ||
 		format_id != PGSTAT_FILE_FORMAT_ID)
 	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
+		ereport(LOG,
 				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		FreeFile(fpin);
-		return false;
+		goto done;
 	}
 
 	/*
 	 * Read global stats struct
 	 */
-	if (fread(&myGlobalStats, 1, sizeof(myGlobalStats),
-			  fpin) != sizeof(myGlobalStats))
+	if (fread(&pgStatShared->globalStats, 1, sizeof(PgStat_GlobalStats),
+			  fpin) != sizeof(PgStat_GlobalStats))
 	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
+		ereport(LOG,
 				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		FreeFile(fpin);
-		return false;
+		goto done;
 	}
 
 	/*
-	 * Read archiver stats struct
+	 * Read archiver stats struct.  Nobody else can be looking at it yet.
 	 */
-	if (fread(&myArchiverStats, 1, sizeof(myArchiverStats),
-			  fpin) != sizeof(myArchiverStats))
+	if (fread(&pgStatShared->archiverStats, 1, sizeof(PgStat_ArchiverStats),
+			  fpin) != sizeof(PgStat_ArchiverStats))
 	{
-		ereport(pgStatRunningInCollector ? LOG : WARNING,
+		ereport(LOG,
 				(errmsg("corrupted statistics file \"%s\"", statfile)));
-		FreeFile(fpin);
-		return false;
+		goto done;
 	}
 
-	/* By default, we're going to return the timestamp of the global file. */
-	*ts = myGlobalStats.stats_timestamp;
-
 	/*
-	 * We found an existing collector stats file.  Read it and look for a
-	 * record for the requested database.  If found, use its timestamp.
+	 * Read the database, table and function entries and put them into
+	 * the shared hash tables.
 	 */
 	for (;;)
 	{
@@ -4469,32 +4045,102 @@ pgstat_read_db_statsfile_timestamp(Oid databaseid, bool permanent,
 				 * follows.
 				 */
 			case 'D':
-				if (fread(&dbentry, 1, offsetof(PgStat_StatDBEntry, tables),
+				if (fread(&dbbuf, 1, offsetof(PgStat_StatDBEntry, tables),
 						  fpin) != offsetof(PgStat_StatDBEntry, tables))
 				{
-					ereport(pgStatRunningInCollector ? LOG : WARNING,
+					ereport(LOG,
+							(errmsg("corrupted statistics file \"%s\"",
+									statfile)));
+					goto done;
+				}
+
+				dbentry = (PgStat_StatDBEntry *)
+					hash_search(pgStatSharedDBHash,
+								(void *) &dbbuf.databaseid,
+								HASH_ENTER_NULL, &found);
+				if (dbentry == NULL)
+					goto done;
+				if (found)
+				{
+					ereport(LOG,
+							(errmsg("corrupted statistics file \"%s\"",
+									statfile)));
+					goto done;
+				}
+
+				memcpy(dbentry, &dbbuf, offsetof(PgStat_StatDBEntry, tables));
+				dbentry->tables = NULL;
+				dbentry->functions = NULL;
+				break;
+
+				/*
+				 * 'T'	A database OID and a PgStat_StatTabEntry follow.
+				 */
+			case 'T':
+				if (fread(&dbid, 1, sizeof(Oid), fpin) != sizeof(Oid) ||
+					fread(&tabbuf, 1, sizeof(PgStat_StatTabEntry),
+						  fpin) != sizeof(PgStat_StatTabEntry))
+				{
+					ereport(LOG,
+							(errmsg("corrupted statistics file \"%s\"",
+									statfile)));
+					goto done;
+				}
+
+				objentry = pgstat_get_object_entry(dbid, tabbuf.tableid,
+												   PGSTAT_KIND_TABLE, true);
+				if (objentry == NULL)
+					goto done;
+				memcpy(&objentry->u.table, &tabbuf, sizeof(tabbuf));
+				break;
+
+				/*
+				 * 'F'	A database OID and a PgStat_StatFuncEntry follow.
+				 */
+			case 'F':
+				if (fread(&dbid, 1, sizeof(Oid), fpin) != sizeof(Oid) ||
+					fread(&funcbuf, 1, sizeof(PgStat_StatFuncEntry),
+						  fpin) != sizeof(PgStat_StatFuncEntry))
+				{
+					ereport(LOG,
 							(errmsg("corrupted statistics file \"%s\"",
 									statfile)));
 					goto done;
 				}
 
+				objentry = pgstat_get_object_entry(dbid, funcbuf.functionid,
+												   PGSTAT_KIND_FUNCTION, true);
+				if (objentry == NULL)
+					goto done;
+				memcpy(&objentry->u.function, &funcbuf, sizeof(funcbuf));
+				break;
+
 				/*
-				 * If this is the DB we're looking for, save its timestamp and
-				 * we're done.
+				 * 'I'	A PgStat_StatIOEntry follows.
 				 */
-				if (dbentry.databaseid == databaseid)
+			case 'I':
+				if (fread(&iobuf, 1, sizeof(PgStat_StatIOEntry),
+						  fpin) != sizeof(PgStat_StatIOEntry))
 				{
-					*ts = dbentry.stats_timestamp;
+					ereport(LOG,
+							(errmsg("corrupted statistics file \"%s\"",
+									statfile)));
 					goto done;
 				}
 
+				ioentry = (PgStat_StatIOEntry *)
+					hash_search(pgStatSharedIOHash, &iobuf.rnode,
+								HASH_ENTER_NULL, &found);
+				if (ioentry == NULL)
+					goto done;
+				memcpy(ioentry, &iobuf, sizeof(iobuf));
 				break;
 
 			case 'E':
 				goto done;
 
 			default:
-				ereport(pgStatRunningInCollector ? LOG : WARNING,
+				ereport(LOG,
 						(errmsg("corrupted statistics file \"%s\"",
 								statfile)));
 				goto done;
@@ -4502,127 +4148,132 @@ pgstat_read_db_statsfile_timestamp(Oid databaseid, bool permanent,
 	}
 
 done:
+	LWLockRelease(PgStatLock);
 	FreeFile(fpin);
-	return true;
+
+	elog(DEBUG2, "removing permanent stats file \"%s\"", statfile);
+	unlink(statfile);
 }
 
 /*
- * If not already done, read the statistics collector stats file into
- * some hash tables.  The results will be kept until pgstat_clear_snapshot()
- * is called (typically, at end of transaction).
+ * If not already done, take a snapshot of the shared statistics into some
+ * backend-local hash tables.  The results will be kept until
+ * pgstat_clear_snapshot() is called (typically, at end of transaction).
+ *
+ * Only the entries of our own database and the shared relations are copied.
+ * The autovacuum launcher just wants the per-database entries.
  */
 static void
-backend_read_statsfile(void)
+backend_snapshot_stats(void)
 {
-	TimestampTz min_ts = 0;
-	TimestampTz ref_ts = 0;
-	int			count;
+	HASHCTL		hash_ctl;
+	HASH_SEQ_STATUS hstat;
+	PgStat_StatDBEntry *shdbentry;
+	PgStat_StatDBEntry *dbentry;
+	PgStatObjectEntry *objentry;
+	TimestampTz now;
+	bool		deep;
 
-	/* already read it? */
+	/* already done? */
 	if (pgStatDBHash)
 		return;
-	Assert(!pgStatRunningInCollector);
 
 	/*
-	 * Loop until fresh enough stats file is available or we ran out of time.
-	 * The stats inquiry message is sent repeatedly in case collector drops
-	 * it; but not every single time, as that just swamps the collector.
+	 * The tables will live in pgStatLocalContext.
 	 */
-	for (count = 0; count < PGSTAT_POLL_LOOP_COUNT; count++)
+	pgstat_setup_memcxt();
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(Oid);
+	hash_ctl.entrysize = sizeof(PgStat_StatDBEntry);
+	hash_ctl.hcxt = pgStatLocalContext;
+	pgStatDBHash = hash_create("Databases hash", PGSTAT_DB_HASH_SIZE, &hash_ctl,
+							   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	deep = !IsAutoVacuumLauncherProcess();
+	now = GetCurrentTimestamp();
+
+	LWLockAcquire(PgStatLock, LW_SHARED);
+
+	hash_seq_init(&hstat, pgStatSharedDBHash);
+	while ((shdbentry = (PgStat_StatDBEntry *) hash_seq_search(&hstat)) != NULL)
 	{
-		bool		ok;
-		TimestampTz file_ts = 0;
-		TimestampTz cur_ts;
+		dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
+												 &shdbentry->databaseid,
+													 HASH_ENTER, NULL);
+		memcpy(dbentry, shdbentry, sizeof(PgStat_StatDBEntry));
+		dbentry->stats_timestamp = now;
+		dbentry->tables = NULL;
+		dbentry->functions = NULL;
+
+		if (!deep ||
+			(dbentry->databaseid != MyDatabaseId &&
+			 dbentry->databaseid != InvalidOid))
+			continue;
 
-		CHECK_FOR_INTERRUPTS();
+		hash_ctl.keysize = sizeof(Oid);
+		hash_ctl.entrysize = sizeof(PgStat_StatTabEntry);
+		hash_ctl.hcxt = pgStatLocalContext;
+		dbentry->tables = hash_create("Per-database table",
+									  PGSTAT_TAB_HASH_SIZE,
+									  &hash_ctl,
+									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
 
-		ok = pgstat_read_db_statsfile_timestamp(MyDatabaseId, false, &file_ts);
+		hash_ctl.keysize = sizeof(Oid);
+		hash_ctl.entrysize = sizeof(PgStat_StatFuncEntry);
+		hash_ctl.hcxt = pgStatLocalContext;
+		dbentry->functions = hash_create("Per-database function",
+										 PGSTAT_FUNCTION_HASH_SIZE,
+										 &hash_ctl,
+									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
 
-		cur_ts = GetCurrentTimestamp();
-		/* Calculate min acceptable timestamp, if we didn't already */
-		if (count == 0 || cur_ts < ref_ts)
+	if (deep)
+	{
+		hash_seq_init(&hstat, pgStatSharedObjectHash);
+		while ((objentry = (PgStatObjectEntry *) hash_seq_search(&hstat)) != NULL)
 		{
-			/*
-			 * We set the minimum acceptable timestamp to PGSTAT_STAT_INTERVAL
-			 * msec before now.  This indirectly ensures that the collector
-			 * needn't write the file more often than PGSTAT_STAT_INTERVAL. In
-			 * an autovacuum worker, however, we want a lower delay to avoid
-			 * using stale data, so we use PGSTAT_RETRY_DELAY (since the
-			 * number of workers is low, this shouldn't be a problem).
-			 *
-			 * We don't recompute min_ts after sleeping, except in the
-			 * unlikely case that cur_ts went backwards.  So we might end up
-			 * accepting a file a bit older than PGSTAT_STAT_INTERVAL.  In
-			 * practice that shouldn't happen, though, as long as the sleep
-			 * time is less than PGSTAT_STAT_INTERVAL; and we don't want to
-			 * tell the collector that our cutoff time is less than what we'd
-			 * actually accept.
-			 */
-			ref_ts = cur_ts;
-			if (IsAutoVacuumWorkerProcess())
-				min_ts = TimestampTzPlusMilliseconds(ref_ts,
-													 -PGSTAT_RETRY_DELAY);
-			else
-				min_ts = TimestampTzPlusMilliseconds(ref_ts,
-													 -PGSTAT_STAT_INTERVAL);
-		}
+			void	   *localentry;
 
-		/*
-		 * If the file timestamp is actually newer than cur_ts, we must have
-		 * had a clock glitch (system time went backwards) or there is clock
-		 * skew between our processor and the stats collector's processor.
-		 * Accept the file, but send an inquiry message anyway to make
-		 * pgstat_recv_inquiry do a sanity check on the collector's time.
-		 */
-		if (ok && file_ts > cur_ts)
-		{
-			/*
-			 * A small amount of clock skew between processors isn't terribly
-			 * surprising, but a large difference is worth logging.  We
-			 * arbitrarily define "large" as 1000 msec.
-			 */
-			if (file_ts >= TimestampTzPlusMilliseconds(cur_ts, 1000))
+			if (objentry->key.databaseid != MyDatabaseId &&
+				objentry->key.databaseid != InvalidOid)
+				continue;
+
+			dbentry = (PgStat_StatDBEntry *) hash_search(pgStatDBHash,
+											   &objentry->key.databaseid,
+														 HASH_FIND, NULL);
+			if (dbentry == NULL || dbentry->tables == NULL)
+				continue;
+
+			if (objentry->key.kind == PGSTAT_KIND_TABLE)
 			{
-				char	   *filetime;
-				char	   *mytime;
-
-				/* Copy because timestamptz_to_str returns a static buffer */
-				filetime = pstrdup(timestamptz_to_str(file_ts));
-				mytime = pstrdup(timestamptz_to_str(cur_ts));
-				elog(LOG, "stats collector's time %s is later than backend local time %s",
-					 filetime, mytime);
-				pfree(filetime);
-				pfree(mytime);
+				localentry = hash_search(dbentry->tables,
+										 &objentry->key.objectid,
+										 HASH_ENTER, NULL);
+				memcpy(localentry, &objentry->u.table,
+					   sizeof(PgStat_StatTabEntry));
+			}
+			else
+			{
+				localentry = hash_search(dbentry->functions,
+										 &objentry->key.objectid,
+										 HASH_ENTER, NULL);
+				memcpy(localentry, &objentry->u.function,
+					   sizeof(PgStat_StatFuncEntry));
 			}
-
-			pgstat_send_inquiry(cur_ts, min_ts, MyDatabaseId);
-			break;
 		}
+	}
 
-		/* Normal acceptance case: file is not older than cutoff time */
-		if (ok && file_ts >= min_ts)
-			break;
-
-		/* Not there or too old, so kick the collector and wait a bit */
-		if ((count % PGSTAT_INQ_LOOP_COUNT) == 0)
-			pgstat_send_inquiry(cur_ts, min_ts, MyDatabaseId);
+	memcpy(&globalStats, &pgStatShared->globalStats, sizeof(globalStats));
 
-		pg_usleep(PGSTAT_RETRY_DELAY * 1000L);
-	}
+	LWLockRelease(PgStatLock);
 
-	if (count >= PGSTAT_POLL_LOOP_COUNT)
-		ereport(LOG,
-				(errmsg("using stale statistics instead of current ones "
-						"because stats collector is not responding")));
+	SpinLockAcquire(&pgStatShared->archiver_lck);
+	memcpy(&archiverStats, &pgStatShared->archiverStats,
+		   sizeof(archiverStats));
+	SpinLockRelease(&pgStatShared->archiver_lck);
 
-	/*
-	 * Autovacuum launcher wants stats about all databases, but a shallow read
-	 * is sufficient.
-	 */
-	if (IsAutoVacuumLauncherProcess())
-		pgStatDBHash = pgstat_read_statsfiles(InvalidOid, false, false);
-	else
-		pgStatDBHash = pgstat_read_statsfiles(MyDatabaseId, false, true);
+	globalStats.stats_timestamp = now;
 }
 
 
@@ -4669,89 +4320,6 @@ pgstat_clear_snapshot(void)
 }
 
 
-/* ----------
- * pgstat_recv_inquiry() -
- *
- *	Process stat inquiry requests.
- * ----------
- */
-static void
-pgstat_recv_inquiry(PgStat_MsgInquiry *msg, int len)
-{
-	slist_iter	iter;
-	DBWriteRequest *newreq;
-	PgStat_StatDBEntry *dbentry;
-
-	elog(DEBUG2, "received inquiry for database %u", msg->databaseid);
-
-	/*
-	 * Find the last write request for this DB.  If it's older than the
-	 * request's cutoff time, update it; otherwise there's nothing to do.
-	 *
-	 * Note that if a request is found, we return early and skip the below
-	 * check for clock skew.  This is okay, since the only way for a DB
-	 * request to be present in the list is that we have been here since the
-	 * last write round.
-	 */
-	slist_foreach(iter, &last_statrequests)
-	{
-		DBWriteRequest *req = slist_container(DBWriteRequest, next, iter.cur);
-
-		if (req->databaseid != msg->databaseid)
-			continue;
-
-		if (msg->cutoff_time > req->request_time)
-			req->request_time = msg->cutoff_time;
-		return;
-	}
-
-	/*
-	 * There's no request for this DB yet, so create one.
-	 */
-	newreq = palloc(sizeof(DBWriteRequest));
-
-	newreq->databaseid = msg->databaseid;
-	newreq->request_time = msg->clock_time;
-	slist_push_head(&last_statrequests, &newreq->next);
-
-	/*
-	 * If the requestor's local clock time is older than stats_timestamp, we
-	 * should suspect a clock glitch, ie system time going backwards; though
-	 * the more likely explanation is just delayed message receipt.  It is
-	 * worth expending a GetCurrentTimestamp call to be sure, since a large
-	 * retreat in the system clock reading could otherwise cause us to neglect
-	 * to update the stats file for a long time.
-	 */
-	dbentry = pgstat_get_db_entry(msg->databaseid, false);
-	if ((dbentry != NULL) && (msg->clock_time < dbentry->stats_timestamp))
-	{
-		TimestampTz cur_ts = GetCurrentTimestamp();
-
-		if (cur_ts < dbentry->stats_timestamp)
-		{
-			/*
-			 * Sure enough, time went backwards.  Force a new stats file write
-			 * to get back in sync; but first, log a complaint.
-			 */
-			char	   *writetime;
-			char	   *mytime;
-
-			/* Copy because timestamptz_to_str returns a static buffer */
-			writetime = pstrdup(timestamptz_to_str(dbentry->stats_timestamp));
-			mytime = pstrdup(timestamptz_to_str(cur_ts));
-			elog(LOG,
-				 "stats_timestamp %s is later than collector's time %s for database %u",
-				 writetime, mytime, dbentry->databaseid);
-			pfree(writetime);
-			pfree(mytime);
-
-			newreq->request_time = cur_ts;
-			dbentry->stats_timestamp = cur_ts - 1;
-		}
-	}
-}
-
-
 /* ----------
  * pgstat_recv_tabstat() -
  *
@@ -4764,9 +4332,10 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 	PgStat_StatDBEntry *dbentry;
 	PgStat_StatTabEntry *tabentry;
 	int			i;
-	bool		found;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	if (dbentry == NULL)
+		return;
 
 	/*
 	 * Update database-wide stats.
@@ -4775,6 +4344,7 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 	dbentry->n_xact_rollback += (PgStat_Counter) (msg->m_xact_rollback);
 	dbentry->n_block_read_time += msg->m_block_read_time;
 	dbentry->n_block_write_time += msg->m_block_write_time;
+	dbentry->n_overflowed_snapshots += msg->m_overflowed_snapshots;
 
 	/*
 	 * Process all table entries in the message.
@@ -4783,70 +4353,9 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 	{
 		PgStat_TableEntry *tabmsg = &(msg->m_entry[i]);
 
-		tabentry = (PgStat_StatTabEntry *) hash_search(dbentry->tables,
-													(void *) &(tabmsg->t_id),
-													   HASH_ENTER, &found);
-
-		if (!found)
-		{
-			/*
-			 * If it's a new table entry, initialize counters to the values we
-			 * just got.
-			 */
-			tabentry->numscans = tabmsg->t_counts.t_numscans;
-			tabentry->tuples_returned = tabmsg->t_counts.t_tuples_returned;
-			tabentry->tuples_fetched = tabmsg->t_counts.t_tuples_fetched;
-			tabentry->tuples_inserted = tabmsg->t_counts.t_tuples_inserted;
-			tabentry->tuples_updated = tabmsg->t_counts.t_tuples_updated;
-			tabentry->tuples_deleted = tabmsg->t_counts.t_tuples_deleted;
-			tabentry->tuples_hot_updated = tabmsg->t_counts.t_tuples_hot_updated;
-			tabentry->n_live_tuples = tabmsg->t_counts.t_delta_live_tuples;
-			tabentry->n_dead_tuples = tabmsg->t_counts.t_delta_dead_tuples;
-			tabentry->changes_since_analyze = tabmsg->t_counts.t_changed_tuples;
-			tabentry->blocks_fetched = tabmsg->t_counts.t_blocks_fetched;
-			tabentry->blocks_hit = tabmsg->t_counts.t_blocks_hit;
-
-			tabentry->vacuum_timestamp = 0;
-			tabentry->vacuum_count = 0;
-			tabentry->autovac_vacuum_timestamp = 0;
-			tabentry->autovac_vacuum_count = 0;
-			tabentry->analyze_timestamp = 0;
-			tabentry->analyze_count = 0;
-			tabentry->autovac_analyze_timestamp = 0;
-			tabentry->autovac_analyze_count = 0;
-		}
-		else
-		{
-			/*
-			 * Otherwise add the values to the existing entry.
-			 */
-			tabentry->numscans += tabmsg->t_counts.t_numscans;
-			tabentry->tuples_returned += tabmsg->t_counts.t_tuples_returned;
-			tabentry->tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
-			tabentry->tuples_inserted += tabmsg->t_counts.t_tuples_inserted;
-			tabentry->tuples_updated += tabmsg->t_counts.t_tuples_updated;
-			tabentry->tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
-			tabentry->tuples_hot_updated += tabmsg->t_counts.t_tuples_hot_updated;
-			/* If table was truncated, first reset the live/dead counters */
-			if (tabmsg->t_counts.t_truncated)
-			{
-				tabentry->n_live_tuples = 0;
-				tabentry->n_dead_tuples = 0;
-			}
-			tabentry->n_live_tuples += tabmsg->t_counts.t_delta_live_tuples;
-			tabentry->n_dead_tuples += tabmsg->t_counts.t_delta_dead_tuples;
-			tabentry->changes_since_analyze += tabmsg->t_counts.t_changed_tuples;
-			tabentry->blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
-			tabentry->blocks_hit += tabmsg->t_counts.t_blocks_hit;
-		}
-
-		/* Clamp n_live_tuples in case of negative delta_live_tuples */
-		tabentry->n_live_tuples = Max(tabentry->n_live_tuples, 0);
-		/* Likewise for n_dead_tuples */
-		tabentry->n_dead_tuples = Max(tabentry->n_dead_tuples, 0);
-
 		/*
-		 * Add per-table stats to the per-database entry, too.
+		 * Add per-table stats to the per-database entry, even if we have no
+		 * room to track the table itself.
 		 */
 		dbentry->n_tuples_returned += tabmsg->t_counts.t_tuples_returned;
 		dbentry->n_tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
@@ -4855,6 +4364,35 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 		dbentry->n_tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
 		dbentry->n_blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
 		dbentry->n_blocks_hit += tabmsg->t_counts.t_blocks_hit;
+
+		/* New entries start out zeroed, so we can just add the values */
+		tabentry = pgstat_get_tab_entry(msg->m_databaseid, tabmsg->t_id, true);
+		if (tabentry == NULL)
+			continue;
+
+		tabentry->numscans += tabmsg->t_counts.t_numscans;
+		tabentry->tuples_returned += tabmsg->t_counts.t_tuples_returned;
+		tabentry->tuples_fetched += tabmsg->t_counts.t_tuples_fetched;
+		tabentry->tuples_inserted += tabmsg->t_counts.t_tuples_inserted;
+		tabentry->tuples_updated += tabmsg->t_counts.t_tuples_updated;
+		tabentry->tuples_deleted += tabmsg->t_counts.t_tuples_deleted;
+		tabentry->tuples_hot_updated += tabmsg->t_counts.t_tuples_hot_updated;
+		/* If table was truncated, first reset the live/dead counters */
+		if (tabmsg->t_counts.t_truncated)
+		{
+			tabentry->n_live_tuples = 0;
+			tabentry->n_dead_tuples = 0;
+		}
+		tabentry->n_live_tuples += tabmsg->t_counts.t_delta_live_tuples;
+		tabentry->n_dead_tuples += tabmsg->t_counts.t_delta_dead_tuples;
+		tabentry->changes_since_analyze += tabmsg->t_counts.t_changed_tuples;
+		tabentry->blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
+		tabentry->blocks_hit += tabmsg->t_counts.t_blocks_hit;
+
+		/* Clamp n_live_tuples in case of negative delta_live_tuples */
+		tabentry->n_live_tuples = Max(tabentry->n_live_tuples, 0);
+		/* Likewise for n_dead_tuples */
+		tabentry->n_dead_tuples = Max(tabentry->n_dead_tuples, 0);
 	}
 }
 
@@ -4868,16 +4406,12 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 static void
 pgstat_recv_tabpurge(PgStat_MsgTabpurge *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
+	PgStatObjectKey key;
 	int			i;
 
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, false);
-
-	/*
-	 * No need to purge if we don't even know the database.
-	 */
-	if (!dbentry || !dbentry->tables)
-		return;
+	MemSet(&key, 0, sizeof(key));
+	key.databaseid = msg->m_databaseid;
+	key.kind = PGSTAT_KIND_TABLE;
 
 	/*
 	 * Process all table entries in the message.
@@ -4885,8 +4419,8 @@ pgstat_recv_tabpurge(PgStat_MsgTabpurge *msg, int len)
 	for (i = 0; i < msg->m_nentries; i++)
 	{
 		/* Remove from hashtable if present; we don't care if it's not. */
-		(void) hash_search(dbentry->tables,
-						   (void *) &(msg->m_tableid[i]),
+		key.objectid = msg->m_tableid[i];
+		(void) hash_search(pgStatSharedObjectHash, (void *) &key,
 						   HASH_REMOVE, NULL);
 	}
 }
@@ -4902,36 +4436,14 @@ static void
 pgstat_recv_dropdb(PgStat_MsgDropdb *msg, int len)
 {
 	Oid			dbid = msg->m_databaseid;
-	PgStat_StatDBEntry *dbentry;
 
 	/*
-	 * Lookup the database in the hashtable.
+	 * Remove the database's objects, then the database entry itself if we
+	 * know it.
 	 */
-	dbentry = pgstat_get_db_entry(dbid, false);
+	pgstat_remove_db_objects(dbid);
 
-	/*
-	 * If found, remove it (along with the db statfile).
-	 */
-	if (dbentry)
-	{
-		char		statfile[MAXPGPATH];
-
-		get_dbstat_filename(false, false, dbid, statfile, MAXPGPATH);
-
-		elog(DEBUG2, "removing stats file \"%s\"", statfile);
-		unlink(statfile);
-
-		if (dbentry->tables != NULL)
-			hash_destroy(dbentry->tables);
-		if (dbentry->functions != NULL)
-			hash_destroy(dbentry->functions);
-
-		if (hash_search(pgStatDBHash,
-						(void *) &dbid,
-						HASH_REMOVE, NULL) == NULL)
-			ereport(ERROR,
-					(errmsg("database hash table corrupted during cleanup --- abort")));
-	}
+	(void) hash_search(pgStatSharedDBHash, (void *) &dbid, HASH_REMOVE, NULL);
 }
 
 
@@ -4955,20 +4467,12 @@ pgstat_recv_resetcounter(PgStat_MsgResetcounter *msg, int len)
 		return;
 
 	/*
-	 * We simply throw away all the database's table entries by recreating a
-	 * new hash table for them.
+	 * We simply throw away all the database's table and function entries.
 	 */
-	if (dbentry->tables != NULL)
-		hash_destroy(dbentry->tables);
-	if (dbentry->functions != NULL)
-		hash_destroy(dbentry->functions);
-
-	dbentry->tables = NULL;
-	dbentry->functions = NULL;
+	pgstat_remove_db_objects(msg->m_databaseid);
 
 	/*
-	 * Reset database-level stats, too.  This creates empty hash tables for
-	 * tables and functions.
+	 * Reset database-level stats, too.
 	 */
 	reset_dbentry_counters(dbentry);
 }
@@ -4985,14 +4489,29 @@ pgstat_recv_resetsharedcounter(PgStat_MsgResetsharedcounter *msg, int len)
 	if (msg->m_resettarget == RESET_BGWRITER)
 	{
 		/* Reset the global background writer statistics for the cluster. */
-		memset(&globalStats, 0, sizeof(globalStats));
-		globalStats.stat_reset_timestamp = GetCurrentTimestamp();
+		memset(&pgStatShared->globalStats, 0, sizeof(PgStat_GlobalStats));
+		pgStatShared->globalStats.stat_reset_timestamp = GetCurrentTimestamp();
 	}
 	else if (msg->m_resettarget == RESET_ARCHIVER)
 	{
+		TimestampTz now = GetCurrentTimestamp();
+
 		/* Reset the archiver statistics for the cluster. */
-		memset(&archiverStats, 0, sizeof(archiverStats));
-		archiverStats.stat_reset_timestamp = GetCurrentTimestamp();
+		SpinLockAcquire(&pgStatShared->archiver_lck);
+		memset(&pgStatShared->archiverStats, 0, sizeof(PgStat_ArchiverStats));
+		pgStatShared->archiverStats.stat_reset_timestamp = now;
+		SpinLockRelease(&pgStatShared->archiver_lck);
+	}
+	else if (msg->m_resettarget == RESET_IO_LATENCY)
+	{
+		HASH_SEQ_STATUS hstat;
+		PgStat_StatIOEntry *entry;
+
+		/* Forget the I/O latencies of all relation files and tablespaces. */
+		hash_seq_init(&hstat, pgStatSharedIOHash);
+		while ((entry = (PgStat_StatIOEntry *) hash_seq_search(&hstat)) != NULL)
+			(void) hash_search(pgStatSharedIOHash, &entry->rnode,
+							   HASH_REMOVE, NULL);
 	}
 
 	/*
@@ -5011,6 +4530,7 @@ static void
 pgstat_recv_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len)
 {
 	PgStat_StatDBEntry *dbentry;
+	PgStatObjectKey key;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, false);
 
@@ -5021,12 +4541,18 @@ pgstat_recv_resetsinglecounter(PgStat_MsgResetsinglecounter *msg, int len)
 	dbentry->stat_reset_timestamp = GetCurrentTimestamp();
 
 	/* Remove object if it exists, ignore it if not */
+	MemSet(&key, 0, sizeof(key));
+	key.databaseid = msg->m_databaseid;
+	key.objectid = msg->m_objectid;
 	if (msg->m_resettype == RESET_TABLE)
-		(void) hash_search(dbentry->tables, (void *) &(msg->m_objectid),
-						   HASH_REMOVE, NULL);
+		key.kind = PGSTAT_KIND_TABLE;
 	else if (msg->m_resettype == RESET_FUNCTION)
-		(void) hash_search(dbentry->functions, (void *) &(msg->m_objectid),
-						   HASH_REMOVE, NULL);
+		key.kind = PGSTAT_KIND_FUNCTION;
+	else
+		return;
+
+	(void) hash_search(pgStatSharedObjectHash, (void *) &key,
+					   HASH_REMOVE, NULL);
 }
 
 /* ----------
@@ -5044,6 +4570,8 @@ pgstat_recv_autovac(PgStat_MsgAutovacStart *msg, int len)
 	 * Store the last autovacuum time in the database's hashtable entry.
 	 */
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	if (dbentry == NULL)
+		return;
 
 	dbentry->last_autovac_time = msg->m_start_time;
 }
@@ -5057,15 +4585,16 @@ pgstat_recv_autovac(PgStat_MsgAutovacStart *msg, int len)
 static void
 pgstat_recv_vacuum(PgStat_MsgVacuum *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
 	PgStat_StatTabEntry *tabentry;
 
 	/*
 	 * Store the data in the table's hashtable entry.
 	 */
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	(void) pgstat_get_db_entry(msg->m_databaseid, true);
 
-	tabentry = pgstat_get_tab_entry(dbentry, msg->m_tableoid, true);
+	tabentry = pgstat_get_tab_entry(msg->m_databaseid, msg->m_tableoid, true);
+	if (tabentry == NULL)
+		return;
 
 	tabentry->n_live_tuples = msg->m_live_tuples;
 	tabentry->n_dead_tuples = msg->m_dead_tuples;
@@ -5091,15 +4620,16 @@ pgstat_recv_vacuum(PgStat_MsgVacuum *msg, int len)
 static void
 pgstat_recv_analyze(PgStat_MsgAnalyze *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
 	PgStat_StatTabEntry *tabentry;
 
 	/*
 	 * Store the data in the table's hashtable entry.
 	 */
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	(void) pgstat_get_db_entry(msg->m_databaseid, true);
 
-	tabentry = pgstat_get_tab_entry(dbentry, msg->m_tableoid, true);
+	tabentry = pgstat_get_tab_entry(msg->m_databaseid, msg->m_tableoid, true);
+	if (tabentry == NULL)
+		return;
 
 	tabentry->n_live_tuples = msg->m_live_tuples;
 	tabentry->n_dead_tuples = msg->m_dead_tuples;
@@ -5126,28 +4656,34 @@ pgstat_recv_analyze(PgStat_MsgAnalyze *msg, int len)
 /* ----------
  * pgstat_recv_archiver() -
  *
- *	Process a ARCHIVER message.
+ *	Process a ARCHIVER message.  Unlike the other recv functions, this is
+ *	called without PgStatLock; the archiver counters have their own
+ *	spinlock.
  * ----------
  */
 static void
 pgstat_recv_archiver(PgStat_MsgArchiver *msg, int len)
 {
+	PgStat_ArchiverStats *archiver = &pgStatShared->archiverStats;
+
+	SpinLockAcquire(&pgStatShared->archiver_lck);
 	if (msg->m_failed)
 	{
 		/* Failed archival attempt */
-		++archiverStats.failed_count;
-		memcpy(archiverStats.last_failed_wal, msg->m_xlog,
-			   sizeof(archiverStats.last_failed_wal));
-		archiverStats.last_failed_timestamp = msg->m_timestamp;
+		++archiver->failed_count;
+		memcpy(archiver->last_failed_wal, msg->m_xlog,
+			   sizeof(archiver->last_failed_wal));
+		archiver->last_failed_timestamp = msg->m_timestamp;
 	}
 	else
 	{
 		/* Successful archival operation */
-		++archiverStats.archived_count;
-		memcpy(archiverStats.last_archived_wal, msg->m_xlog,
-			   sizeof(archiverStats.last_archived_wal));
-		archiverStats.last_archived_timestamp = msg->m_timestamp;
+		++archiver->archived_count;
+		memcpy(archiver->last_archived_wal, msg->m_xlog,
+			   sizeof(archiver->last_archived_wal));
+		archiver->last_archived_timestamp = msg->m_timestamp;
 	}
+	SpinLockRelease(&pgStatShared->archiver_lck);
 }
 
 /* ----------
@@ -5159,16 +4695,18 @@ pgstat_recv_archiver(PgStat_MsgArchiver *msg, int len)
 static void
 pgstat_recv_bgwriter(PgStat_MsgBgWriter *msg, int len)
 {
-	globalStats.timed_checkpoints += msg->m_timed_checkpoints;
-	globalStats.requested_checkpoints += msg->m_requested_checkpoints;
-	globalStats.checkpoint_write_time += msg->m_checkpoint_write_time;
-	globalStats.checkpoint_sync_time += msg->m_checkpoint_sync_time;
-	globalStats.buf_written_checkpoints += msg->m_buf_written_checkpoints;
-	globalStats.buf_written_clean += msg->m_buf_written_clean;
-	globalStats.maxwritten_clean += msg->m_maxwritten_clean;
-	globalStats.buf_written_backend += msg->m_buf_written_backend;
-	globalStats.buf_fsync_backend += msg->m_buf_fsync_backend;
-	globalStats.buf_alloc += msg->m_buf_alloc;
+	PgStat_GlobalStats *global = &pgStatShared->globalStats;
+
+	global->timed_checkpoints += msg->m_timed_checkpoints;
+	global->requested_checkpoints += msg->m_requested_checkpoints;
+	global->checkpoint_write_time += msg->m_checkpoint_write_time;
+	global->checkpoint_sync_time += msg->m_checkpoint_sync_time;
+	global->buf_written_checkpoints += msg->m_buf_written_checkpoints;
+	global->buf_written_clean += msg->m_buf_written_clean;
+	global->maxwritten_clean += msg->m_maxwritten_clean;
+	global->buf_written_backend += msg->m_buf_written_backend;
+	global->buf_fsync_backend += msg->m_buf_fsync_backend;
+	global->buf_alloc += msg->m_buf_alloc;
 }
 
 /* ----------
@@ -5183,6 +4721,8 @@ pgstat_recv_recoveryconflict(PgStat_MsgRecoveryConflict *msg, int len)
 	PgStat_StatDBEntry *dbentry;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	if (dbentry == NULL)
+		return;
 
 	switch (msg->m_reason)
 	{
@@ -5223,6 +4763,8 @@ pgstat_recv_deadlock(PgStat_MsgDeadlock *msg, int len)
 	PgStat_StatDBEntry *dbentry;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	if (dbentry == NULL)
+		return;
 
 	dbentry->n_deadlocks++;
 }
@@ -5239,6 +4781,8 @@ pgstat_recv_tempfile(PgStat_MsgTempFile *msg, int len)
 	PgStat_StatDBEntry *dbentry;
 
 	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	if (dbentry == NULL)
+		return;
 
 	dbentry->n_temp_bytes += msg->m_filesize;
 	dbentry->n_temp_files += 1;
@@ -5254,41 +4798,27 @@ static void
 pgstat_recv_funcstat(PgStat_MsgFuncstat *msg, int len)
 {
 	PgStat_FunctionEntry *funcmsg = &(msg->m_entry[0]);
-	PgStat_StatDBEntry *dbentry;
+	PgStatObjectEntry *entry;
 	PgStat_StatFuncEntry *funcentry;
 	int			i;
-	bool		found;
 
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, true);
+	(void) pgstat_get_db_entry(msg->m_databaseid, true);
 
 	/*
-	 * Process all function entries in the message.
+	 * Process all function entries in the message.  New entries start out
+	 * zeroed, so we can just add the values.
 	 */
 	for (i = 0; i < msg->m_nentries; i++, funcmsg++)
 	{
-		funcentry = (PgStat_StatFuncEntry *) hash_search(dbentry->functions,
-												   (void *) &(funcmsg->f_id),
-														 HASH_ENTER, &found);
+		entry = pgstat_get_object_entry(msg->m_databaseid, funcmsg->f_id,
+										PGSTAT_KIND_FUNCTION, true);
+		if (entry == NULL)
+			continue;
+		funcentry = &entry->u.function;
 
-		if (!found)
-		{
-			/*
-			 * If it's a new function entry, initialize counters to the values
-			 * we just got.
-			 */
-			funcentry->f_numcalls = funcmsg->f_numcalls;
-			funcentry->f_total_time = funcmsg->f_total_time;
-			funcentry->f_self_time = funcmsg->f_self_time;
-		}
-		else
-		{
-			/*
-			 * Otherwise add the values to the existing entry.
-			 */
-			funcentry->f_numcalls += funcmsg->f_numcalls;
-			funcentry->f_total_time += funcmsg->f_total_time;
-			funcentry->f_self_time += funcmsg->f_self_time;
-		}
+		funcentry->f_numcalls += funcmsg->f_numcalls;
+		funcentry->f_total_time += funcmsg->f_total_time;
+		funcentry->f_self_time += funcmsg->f_self_time;
 	}
 }
 
@@ -5301,16 +4831,12 @@ pgstat_recv_funcstat(PgStat_MsgFuncstat *msg, int len)
 static void
 pgstat_recv_funcpurge(PgStat_MsgFuncpurge *msg, int len)
 {
-	PgStat_StatDBEntry *dbentry;
+	PgStatObjectKey key;
 	int			i;
 
-	dbentry = pgstat_get_db_entry(msg->m_databaseid, false);
-
-	/*
-	 * No need to purge if we don't even know the database.
-	 */
-	if (!dbentry || !dbentry->functions)
-		return;
+	MemSet(&key, 0, sizeof(key));
+	key.databaseid = msg->m_databaseid;
+	key.kind = PGSTAT_KIND_FUNCTION;
 
 	/*
 	 * Process all function entries in the message.
@@ -5318,47 +4844,8 @@ pgstat_recv_funcpurge(PgStat_MsgFuncpurge *msg, int len)
 	for (i = 0; i < msg->m_nentries; i++)
 	{
 		/* Remove from hashtable if present; we don't care if it's not. */
-		(void) hash_search(dbentry->functions,
-						   (void *) &(msg->m_functionid[i]),
+		key.objectid = msg->m_functionid[i];
+		(void) hash_search(pgStatSharedObjectHash, (void *) &key,
 						   HASH_REMOVE, NULL);
 	}
 }
-
-/* ----------
- * pgstat_write_statsfile_needed() -
- *
- *	Do we need to write out the files?
- * ----------
- */
-static bool
-pgstat_write_statsfile_needed(void)
-{
-	if (!slist_is_empty(&last_statrequests))
-		return true;
-
-	/* Everything was written recently */
-	return false;
-}
-
-/* ----------
- * pgstat_db_requested() -
- *
- *	Checks whether stats for a particular DB need to be written to a file.
- * ----------
- */
-static bool
-pgstat_db_requested(Oid databaseid)
-{
-	slist_iter	iter;
-
-	/* Check the databases if they need to refresh the stats. */
-	slist_foreach(iter, &last_statrequests)
-	{
-		DBWriteRequest *req = slist_container(DBWriteRequest, next, iter.cur);
-
-		if (req->databaseid == databaseid)
-			return true;
-	}
-
-	return false;
-}
@@ -95,6 +95,7 @@
 #include "access/xlog.h"
 #include "bootstrap/bootstrap.h"
 #include "catalog/pg_control.h"
+#include "common/zpq_stream.h"
 #include "lib/ilist.h"
 #include "libpq/auth.h"
 #include "libpq/ip.h"
@@ -108,13 +109,17 @@
 #include "postmaster/fork_process.h"
 #include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/proxy.h"
 #include "postmaster/syslogger.h"
+#include "replication/logicallauncher.h"
 #include "replication/walsender.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/pg_shmem.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
+#include "storage/procsignal.h"
+#include "storage/sinval.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/datetime.h"
@@ -171,6 +176,9 @@ typedef struct bkend
 	int			bkend_type;
 	bool		dead_end;		/* is it going to send an error and quit? */
 	bool		bgworker_notify;	/* gets bgworker start/stop notifications */
+	pgsocket	spare_sock;		/* if a spare backend awaiting a connection,
+								 * socket to pass it on; else
+								 * PGINVALID_SOCKET */
 	dlist_node	elem;			/* list link in BackendList */
 } Backend;
 
@@ -187,6 +195,9 @@ BackgroundWorker *MyBgworkerEntry = NULL;
 /* The socket number we are listening for connections on */
 int			PostPortNumber;
 
+/* The number of pre-forked backends to keep ready for new connections */
+int			SpareBackends;
+
 /* The directory names for Unix socket(s) */
 char	   *Unix_socket_directories;
 
@@ -245,8 +256,8 @@ static pid_t StartupPID = 0,
 			WalReceiverPID = 0,
 			AutoVacPID = 0,
 			PgArchPID = 0,
-			PgStatPID = 0,
-			SysLoggerPID = 0;
+			SysLoggerPID = 0,
+			ProxyPID = 0;
 
 /* Startup process's status */
 typedef enum
@@ -352,6 +363,19 @@ static volatile bool avlauncher_needs_signal = false;
 
 /* set when there's a worker that needs to be started up */
 static volatile bool StartWorkerNeeded = true;
+
+#ifdef HAVE_SPARE_BACKENDS
+/* How many backends in BackendList are spares */
+static int	NumSpareBackends = 0;
+
+/* When we last failed to start a spare, or one exited before it was used */
+static time_t LastSpareFailureTime = 0;
+
+#define SPARE_RESTART_INTERVAL 5	/* seconds to wait after that */
+
+/* Set in a spare backend by its SIGHUP handler */
+static volatile sig_atomic_t spare_got_SIGHUP = false;
+#endif
 static volatile bool HaveCrashedWorker = false;
 
 /*
@@ -395,6 +419,7 @@ static void ExitPostmaster(int status) pg_attribute_noreturn();
 static int	ServerLoop(void);
 static int	BackendStartup(Port *port);
 static int	ProcessStartupPacket(Port *port, bool SSLdone);
+static void proxy_set_client(Port *port, const char *peer);
 static void processCancelRequest(Port *port, void *pkt);
 static int	initMasks(fd_set *rmask);
 static void report_fork_failure_to_client(Port *port, int errnum);
@@ -414,6 +439,15 @@ static pid_t StartChildProcess(AuxProcType type);
 static void StartAutovacuumWorker(void);
 static void InitPostmasterDeathWatchHandle(void);
 
+#ifdef HAVE_SPARE_BACKENDS
+static void MaintainSpareBackends(void);
+static bool StartSpareBackend(void);
+static bool PassConnectionToSpare(Port *port);
+static void CloseSpareSocket(Backend *bp);
+static void spare_sighup_handler(SIGNAL_ARGS);
+static void SpareBackendMain(pgsocket sock) pg_attribute_noreturn();
+#endif
+
 /*
  * Archiver is allowed to start up at the current postmaster state?
  *
@@ -487,7 +521,7 @@ typedef struct
 	PGPROC	   *AuxiliaryProcs;
 	PGPROC	   *PreparedXactProcs;
 	PMSignalData *PMSignalState;
-	InheritableSocket pgStatSock;
+	PgStatSharedState *pgStatShared;
 	pid_t		PostmasterPid;
 	TimestampTz PgStartTime;
 	TimestampTz PgReloadTime;
@@ -496,6 +530,7 @@ typedef struct
 	bool		IsBinaryUpgrade;
 	int			max_safe_fds;
 	int			MaxBackends;
+	int			FastPathLockGroupsPerBackend;
 #ifdef WIN32
 	HANDLE		PostmasterHandle;
 	HANDLE		initial_signal_pipe;
@@ -591,7 +626,7 @@ PostmasterMain(int argc, char *argv[])
 	 * CAUTION: when changing this list, check for side-effects on the signal
 	 * handling setup of child processes.  See tcop/postgres.c,
 	 * bootstrap/bootstrap.c, postmaster/bgwriter.c, postmaster/walwriter.c,
-	 * postmaster/autovacuum.c, postmaster/pgarch.c, postmaster/pgstat.c,
+	 * postmaster/autovacuum.c, postmaster/pgarch.c,
 	 * postmaster/syslogger.c, postmaster/bgworker.c and
 	 * postmaster/checkpointer.c.
 	 */
@@ -847,6 +882,22 @@ PostmasterMain(int argc, char *argv[])
 		write_stderr("%s: max_wal_senders must be less than max_connections\n", progname);
 		ExitPostmaster(1);
 	}
+	if (ProxyPortNumber != 0)
+	{
+#ifndef HAVE_CONNECTION_PROXY
+		ereport(FATAL,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("connection proxy is not supported on this platform")));
+#endif
+		if (ProxyPortNumber == PostPortNumber)
+			ereport(FATAL,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("proxy_port must be different from port")));
+		if (Unix_socket_directories == NULL || Unix_socket_directories[0] == '\0')
+			ereport(FATAL,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("connection proxy requires unix_socket_directories to be set")));
+	}
 	if (XLogArchiveMode > ARCHIVE_MODE_OFF && wal_level == WAL_LEVEL_MINIMAL)
 		ereport(ERROR,
 				(errmsg("WAL archival cannot be enabled when wal_level is \"minimal\"")));
@@ -919,6 +970,9 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	process_shared_preload_libraries();
 
+	/* Register the built-in logical replication launcher */
+	ApplyLauncherRegister();
+
 	/*
 	 * Now that loadable modules have had their chance to register background
 	 * workers, calculate MaxBackends.
@@ -933,6 +987,8 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	for (i = 0; i < MAXLISTEN; i++)
 		ListenSocket[i] = PGINVALID_SOCKET;
+	for (i = 0; i < PROXY_MAXLISTEN; i++)
+		ProxyListenSocket[i] = PGINVALID_SOCKET;
 
 	on_proc_exit(CloseServerPorts, 0);
 
@@ -985,6 +1041,17 @@ PostmasterMain(int argc, char *argv[])
 				ereport(WARNING,
 						(errmsg("could not create listen socket for \"%s\"",
 								curhost)));
+
+			if (ProxyPortNumber != 0 &&
+				StreamServerPort(AF_UNSPEC,
+								 strcmp(curhost, "*") == 0 ? NULL : curhost,
+								 (unsigned short) ProxyPortNumber,
+								 NULL,
+								 ProxyListenSocket,
+								 PROXY_MAXLISTEN) != STATUS_OK)
+				ereport(WARNING,
+						(errmsg("could not create connection proxy socket for \"%s\"",
+								curhost)));
 		}
 
 		if (!success && elemlist != NIL)
@@ -1074,6 +1141,16 @@ PostmasterMain(int argc, char *argv[])
 				ereport(WARNING,
 						(errmsg("could not create Unix-domain socket in directory \"%s\"",
 								socketdir)));
+
+			if (ProxyPortNumber != 0 &&
+				StreamServerPort(AF_UNIX, NULL,
+								 (unsigned short) ProxyPortNumber,
+								 socketdir,
+								 ProxyListenSocket,
+								 PROXY_MAXLISTEN) != STATUS_OK)
+				ereport(WARNING,
+						(errmsg("could not create connection proxy socket in directory \"%s\"",
+								socketdir)));
 		}
 
 		if (!success && elemlist != NIL)
@@ -1220,12 +1297,6 @@ PostmasterMain(int argc, char *argv[])
 
 	whereToSendOutput = DestNone;
 
-	/*
-	 * Initialize stats collection subsystem (this does NOT start the
-	 * collector process!)
-	 */
-	pgstat_init();
-
 	/*
 	 * Initialize the autovacuum subsystem (again, no process start yet)
 	 */
@@ -1278,6 +1349,13 @@ PostmasterMain(int argc, char *argv[])
 	/* PostmasterRandom wants its own copy */
 	gettimeofday(&random_start_time, NULL);
 
+	/*
+	 * Generate the secret the connection proxy presents when it opens pooled
+	 * backends on its own behalf.
+	 */
+	if (ProxyPortNumber != 0)
+		proxy_init_token();
+
 	/*
 	 * We're ready to rock and roll...
 	 */
@@ -1322,6 +1400,14 @@ CloseServerPorts(int status, Datum arg)
 			ListenSocket[i] = PGINVALID_SOCKET;
 		}
 	}
+	for (i = 0; i < PROXY_MAXLISTEN; i++)
+	{
+		if (ProxyListenSocket[i] != PGINVALID_SOCKET)
+		{
+			StreamClose(ProxyListenSocket[i]);
+			ProxyListenSocket[i] = PGINVALID_SOCKET;
+		}
+	}
 
 	/*
 	 * Next, remove any filesystem entries for Unix sockets.  To avoid race
@@ -1643,6 +1729,20 @@ ServerLoop(void)
 			/* Needs to run with blocked signals! */
 			DetermineSleepTime(&timeout);
 
+#ifdef HAVE_SPARE_BACKENDS
+
+			/*
+			 * If we are short of spares because starting them failed, come
+			 * back when it's time to try again.
+			 */
+			if (NumSpareBackends < SpareBackends && LastSpareFailureTime != 0 &&
+				timeout.tv_sec > SPARE_RESTART_INTERVAL)
+			{
+				timeout.tv_sec = SPARE_RESTART_INTERVAL;
+				timeout.tv_usec = 0;
+			}
+#endif
+
 			PG_SETMASK(&UnBlockSig);
 
 			selres = select(nSockets, &rmask, NULL, NULL, &timeout);
@@ -1681,7 +1781,10 @@ ServerLoop(void)
 					port = ConnCreate(ListenSocket[i]);
 					if (port)
 					{
-						BackendStartup(port);
+#ifdef HAVE_SPARE_BACKENDS
+						if (!PassConnectionToSpare(port))
+#endif
+							BackendStartup(port);
 
 						/*
 						 * We no longer need the open socket or port structure
@@ -1735,14 +1838,16 @@ ServerLoop(void)
 				start_autovac_launcher = false; /* signal processed */
 		}
 
-		/* If we have lost the stats collector, try to start a new one */
-		if (PgStatPID == 0 && pmState == PM_RUN)
-			PgStatPID = pgstat_start();
-
 		/* If we have lost the archiver, try to start a new one. */
 		if (PgArchPID == 0 && PgArchStartupAllowed())
 			PgArchPID = pgarch_start();
 
+		/* If we have lost the connection proxy, try to start a new one */
+		if (ProxyPID == 0 && ProxyPortNumber != 0 &&
+			Shutdown == NoShutdown &&
+			(pmState == PM_RUN || pmState == PM_HOT_STANDBY))
+			ProxyPID = proxy_start();
+
 		/* If we need to signal the autovacuum launcher, do so now */
 		if (avlauncher_needs_signal)
 		{
@@ -1755,6 +1860,11 @@ ServerLoop(void)
 		if (StartWorkerNeeded || HaveCrashedWorker)
 			maybe_start_bgworker();
 
+#ifdef HAVE_SPARE_BACKENDS
+		/* Replace spares that were used up, or retire unwanted ones */
+		MaintainSpareBackends();
+#endif
+
 #ifdef HAVE_PTHREAD_IS_THREADED_NP
 
 		/*
@@ -1873,6 +1983,8 @@ ProcessStartupPacket(Port *port, bool SSLdone)
 	void	   *buf;
 	ProtocolVersion proto;
 	MemoryContext oldcontext;
+	char	   *proxy_session = NULL;
+	char	   *proxy_client = NULL;
 
 	pq_startmsgread();
 	if (pq_getbytes((char *) &len, 4) == EOF)
@@ -2052,6 +2164,23 @@ retry1:
 									valptr),
 							 errhint("Valid values are: \"false\", 0, \"true\", 1, \"database\".")));
 			}
+			else if (strcmp(nameptr, "compression") == 0)
+			{
+				const char *algorithm;
+
+				/*
+				 * The client lists the protocol compression algorithms it
+				 * can use, best first.  If we support none of them, the
+				 * connection just goes on uncompressed.
+				 */
+				algorithm = zpq_choose_algorithm(valptr);
+				if (algorithm != NULL)
+					port->compression = pstrdup(algorithm);
+			}
+			else if (strcmp(nameptr, "proxy_session") == 0)
+				proxy_session = valptr;
+			else if (strcmp(nameptr, "proxy_client") == 0)
+				proxy_client = valptr;
 			else
 			{
 				/* Assume it's a generic GUC option */
@@ -2071,6 +2200,29 @@ retry1:
 			ereport(FATAL,
 					(errcode(ERRCODE_PROTOCOL_VIOLATION),
 					 errmsg("invalid startup packet layout: expected terminator as last byte")));
+
+		/*
+		 * The connection proxy identifies itself with its token, which is
+		 * only honoured on a Unix-domain socket, where the proxy connects.
+		 * With proxy_client, it relays a new client's authentication, which
+		 * must be checked against that client's address; without, it opens
+		 * another backend for clients it has already authenticated.
+		 */
+		if (proxy_session != NULL || proxy_client != NULL)
+		{
+			if (proxy_session == NULL ||
+				ProxyToken[0] == '\0' ||
+				!IS_AF_UNIX(port->laddr.addr.ss_family) ||
+				strcmp(proxy_session, ProxyToken) != 0)
+				ereport(FATAL,
+						(errcode(ERRCODE_INVALID_AUTHORIZATION_SPECIFICATION),
+						 errmsg("invalid connection proxy token")));
+			port->pooled = true;
+			if (proxy_client != NULL)
+				proxy_set_client(port, proxy_client);
+			else
+				port->proxy_trusted = true;
+		}
 	}
 	else
 	{
@@ -2185,6 +2337,65 @@ retry1:
 }
 
 
+/*
+ * Take on the identity of the client whose authentication the connection
+ * proxy relays, as described by proxy_client_peer(), so that pg_hba.conf is
+ * matched against it rather than against the proxy's Unix-domain socket
+ * connection.
+ */
+static void
+proxy_set_client(Port *port, const char *peer)
+{
+	char		host[NI_MAXHOST];
+	char		serv[NI_MAXSERV];
+	const char *sep;
+	unsigned long uid;
+	struct addrinfo hint;
+	struct addrinfo *addrs = NULL;
+	int			ret;
+
+	/* A Unix-domain socket client; its user ID is for peer authentication */
+	if (strcmp(peer, "local") == 0)
+		return;
+	if (sscanf(peer, "local %lu", &uid) == 1)
+	{
+		port->proxy_peer_uid = (uid_t) uid;
+		port->proxy_peer_known = true;
+		return;
+	}
+
+	/* Otherwise, the numeric host and port of a TCP client */
+	sep = strchr(peer, ' ');
+	if (sep == NULL || sep - peer >= sizeof(host) ||
+		strlen(sep + 1) >= sizeof(serv))
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid connection proxy client \"%s\"", peer)));
+	memcpy(host, peer, sep - peer);
+	host[sep - peer] = '\0';
+	strcpy(serv, sep + 1);
+
+	MemSet(&hint, 0, sizeof(hint));
+	hint.ai_family = AF_UNSPEC;
+	hint.ai_socktype = SOCK_STREAM;
+	hint.ai_flags = AI_NUMERICHOST;
+	ret = pg_getaddrinfo_all(host, serv, &hint, &addrs);
+	if (ret != 0 || addrs == NULL || IS_AF_UNIX(addrs->ai_family) ||
+		addrs->ai_addrlen > sizeof(port->raddr.addr))
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid connection proxy client \"%s\"", peer)));
+
+	memcpy(&port->raddr.addr, addrs->ai_addr, addrs->ai_addrlen);
+	port->raddr.salen = addrs->ai_addrlen;
+	pg_freeaddrinfo_all(hint.ai_family, addrs);
+
+	port->remote_host = strdup(host);
+	port->remote_port = strdup(serv);
+	port->remote_hostname = NULL;
+	port->remote_hostname_resolv = 0;
+}
+
 /*
  * The client has sent a cancel request packet, not a normal
  * start-a-new-connection packet.  Perform the necessary processing.
@@ -2409,6 +2620,33 @@ ClosePostmasterPorts(bool am_syslogger)
 		}
 	}
 
+	/* The connection proxy keeps its own listen sockets */
+	if (!IsConnectionProxy)
+	{
+		for (i = 0; i < PROXY_MAXLISTEN; i++)
+		{
+			if (ProxyListenSocket[i] != PGINVALID_SOCKET)
+			{
+				StreamClose(ProxyListenSocket[i]);
+				ProxyListenSocket[i] = PGINVALID_SOCKET;
+			}
+		}
+	}
+
+#ifdef HAVE_SPARE_BACKENDS
+	/* Close the sockets for passing connections to spare backends */
+	{
+		dlist_iter	iter;
+
+		dlist_foreach(iter, &BackendList)
+		{
+			Backend    *bp = dlist_container(Backend, elem, iter.cur);
+
+			CloseSpareSocket(bp);
+		}
+	}
+#endif
+
 	/* If using syslogger, close the read side of the pipe */
 	if (!am_syslogger)
 	{
@@ -2481,8 +2719,6 @@ SIGHUP_handler(SIGNAL_ARGS)
 			signal_child(PgArchPID, SIGHUP);
 		if (SysLoggerPID != 0)
 			signal_child(SysLoggerPID, SIGHUP);
-		if (PgStatPID != 0)
-			signal_child(PgStatPID, SIGHUP);
 
 		/* Reload authentication config files too */
 		if (!load_hba())
@@ -2550,6 +2786,9 @@ pmdie(SIGNAL_ARGS)
 				/* and the walwriter too */
 				if (WalWriterPID != 0)
 					signal_child(WalWriterPID, SIGTERM);
+				/* the connection proxy stops accepting new clients */
+				if (ProxyPID != 0)
+					signal_child(ProxyPID, SIGTERM);
 
 				/*
 				 * If we're in recovery, we can't kill the startup process
@@ -2621,6 +2860,9 @@ pmdie(SIGNAL_ARGS)
 				/* and the walwriter too */
 				if (WalWriterPID != 0)
 					signal_child(WalWriterPID, SIGTERM);
+				/* and the connection proxy */
+				if (ProxyPID != 0)
+					signal_child(ProxyPID, SIGINT);
 				pmState = PM_WAIT_BACKENDS;
 			}
 
@@ -2689,6 +2931,9 @@ reaper(SIGNAL_ARGS)
 		{
 			StartupPID = 0;
 
+			/* It might have started parallel redo workers */
+			BackgroundWorkerStopNotifications(pid);
+
 			/*
 			 * Startup process exited in response to a shutdown request (or it
 			 * completed normally regardless of the shutdown request).
@@ -2777,8 +3022,8 @@ reaper(SIGNAL_ARGS)
 				AutoVacPID = StartAutoVacLauncher();
 			if (PgArchStartupAllowed() && PgArchPID == 0)
 				PgArchPID = pgarch_start();
-			if (PgStatPID == 0)
-				PgStatPID = pgstat_start();
+			if (ProxyPortNumber != 0 && ProxyPID == 0)
+				ProxyPID = proxy_start();
 
 			/* workers may be scheduled to start now */
 			maybe_start_bgworker();
@@ -2839,13 +3084,6 @@ reaper(SIGNAL_ARGS)
 				SignalChildren(SIGUSR2);
 
 				pmState = PM_SHUTDOWN_2;
-
-				/*
-				 * We can also shut down the stats collector now; there's
-				 * nothing left for it to do.
-				 */
-				if (PgStatPID != 0)
-					signal_child(PgStatPID, SIGQUIT);
 			}
 			else
 			{
@@ -2922,18 +3160,16 @@ reaper(SIGNAL_ARGS)
 		}
 
 		/*
-		 * Was it the statistics collector?  If so, just try to start a new
-		 * one; no need to force reset of the rest of the system.  (If fail,
-		 * we'll try again in future cycles of the main loop.)
+		 * Was it the connection proxy?  Its clients have lost their
+		 * sessions, but the backends it was using notice that on their own;
+		 * ServerLoop will start a new proxy.
 		 */
-		if (pid == PgStatPID)
+		if (pid == ProxyPID)
 		{
-			PgStatPID = 0;
+			ProxyPID = 0;
 			if (!EXIT_STATUS_0(exitstatus))
-				LogChildExit(LOG, _("statistics collector process"),
+				LogChildExit(LOG, _("connection proxy process"),
 							 pid, exitstatus);
-			if (pmState == PM_RUN)
-				PgStatPID = pgstat_start();
 			continue;
 		}
 
@@ -3153,6 +3389,14 @@ CleanupBackend(int pid,
 				 */
 				BackgroundWorkerStopNotifications(bp->pid);
 			}
+#ifdef HAVE_SPARE_BACKENDS
+			if (bp->spare_sock != PGINVALID_SOCKET)
+			{
+				/* A spare that exits on its own is in trouble; back off */
+				CloseSpareSocket(bp);
+				LastSpareFailureTime = time(NULL);
+			}
+#endif
 			dlist_delete(iter.cur);
 			free(bp);
 			break;
@@ -3256,6 +3500,9 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 				ShmemBackendArrayRemove(bp);
 #endif
 			}
+#ifdef HAVE_SPARE_BACKENDS
+			CloseSpareSocket(bp);
+#endif
 			dlist_delete(iter.cur);
 			free(bp);
 			/* Keep looping so we can signal remaining backends */
@@ -3382,22 +3629,6 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 		signal_child(PgArchPID, SIGQUIT);
 	}
 
-	/*
-	 * Force a power-cycle of the pgstat process too.  (This isn't absolutely
-	 * necessary, but it seems like a good idea for robustness, and it
-	 * simplifies the state-machine logic in the case where a shutdown request
-	 * arrives during crash processing.)
-	 */
-	if (PgStatPID != 0 && take_action)
-	{
-		ereport(DEBUG2,
-				(errmsg_internal("sending %s to process %d",
-								 "SIGQUIT",
-								 (int) PgStatPID)));
-		signal_child(PgStatPID, SIGQUIT);
-		allow_immediate_pgstat_restart();
-	}
-
 	/* We do NOT restart the syslogger */
 
 	if (Shutdown != ImmediateShutdown)
@@ -3597,12 +3828,10 @@ PostmasterStateMachine(void)
 					FatalError = true;
 					pmState = PM_WAIT_DEAD_END;
 
-					/* Kill the walsenders, archiver and stats collector too */
+					/* Kill the walsenders and archiver too */
 					SignalChildren(SIGQUIT);
 					if (PgArchPID != 0)
 						signal_child(PgArchPID, SIGQUIT);
-					if (PgStatPID != 0)
-						signal_child(PgStatPID, SIGQUIT);
 				}
 			}
 		}
@@ -3630,10 +3859,9 @@ PostmasterStateMachine(void)
 	{
 		/*
 		 * PM_WAIT_DEAD_END state ends when the BackendList is entirely empty
-		 * (ie, no dead_end children remain), and the archiver and stats
-		 * collector are gone too.
+		 * (ie, no dead_end children remain), and the archiver is gone too.
 		 *
-		 * The reason we wait for those two is to protect them against a new
+		 * The reason we wait for the archiver is to protect it against a new
 		 * postmaster starting conflicting subprocesses; this isn't an
 		 * ironclad protection, but it at least helps in the
 		 * shutdown-and-immediately-restart scenario.  Note that they have
@@ -3641,8 +3869,7 @@ PostmasterStateMachine(void)
 		 * normal state transition leading up to PM_WAIT_DEAD_END, or during
 		 * FatalError processing.
 		 */
-		if (dlist_is_empty(&BackendList) &&
-			PgArchPID == 0 && PgStatPID == 0)
+		if (dlist_is_empty(&BackendList) && PgArchPID == 0)
 		{
 			/* These other guys should be dead already */
 			Assert(StartupPID == 0);
@@ -3838,8 +4065,8 @@ TerminateChildren(int signal)
 		signal_child(AutoVacPID, signal);
 	if (PgArchPID != 0)
 		signal_child(PgArchPID, signal);
-	if (PgStatPID != 0)
-		signal_child(PgStatPID, signal);
+	if (ProxyPID != 0)
+		signal_child(ProxyPID, signal);
 }
 
 /*
@@ -3891,6 +4118,7 @@ BackendStartup(Port *port)
 
 	/* Hasn't asked to be notified about any bgworkers yet */
 	bn->bgworker_notify = false;
+	bn->spare_sock = PGINVALID_SOCKET;
 
 #ifdef EXEC_BACKEND
 	pid = backend_forkexec(port);
@@ -3981,6 +4209,395 @@ report_fork_failure_to_client(Port *port, int errnum)
 }
 
 
+#ifdef HAVE_SPARE_BACKENDS
+
+/*
+ * MaintainSpareBackends -- keep SpareBackends pre-forked backends ready
+ *
+ * A spare backend is forked before any connection needs it.  It sets up its
+ * PGPROC, shared-invalidation state and the relcache entries for the shared
+ * catalogs, then waits for the postmaster to pass it a client socket over
+ * its spare_sock (see PassConnectionToSpare).  From there on it proceeds
+ * exactly like a backend forked for the connection, minus the work it has
+ * already done.
+ *
+ * Spares only make sense while we can accept connections, and they must not
+ * occupy the connection slots that are reserved for superusers.  When they
+ * aren't wanted (anymore), closing their socket tells them to exit.
+ */
+static void
+MaintainSpareBackends(void)
+{
+	dlist_iter	iter;
+	int			wanted = SpareBackends;
+
+	if (Shutdown > NoShutdown || FatalError ||
+		canAcceptConnections() != CAC_OK)
+		wanted = 0;
+
+	/* Retire any spares beyond the number wanted */
+	dlist_foreach(iter, &BackendList)
+	{
+		Backend    *bp = dlist_container(Backend, elem, iter.cur);
+
+		if (NumSpareBackends <= wanted)
+			break;
+		if (bp->spare_sock != PGINVALID_SOCKET)
+			CloseSpareSocket(bp);
+	}
+
+	/* Don't hammer the system with forks if spares keep failing */
+	if (NumSpareBackends < wanted && LastSpareFailureTime != 0 &&
+		time(NULL) - LastSpareFailureTime < SPARE_RESTART_INTERVAL)
+		return;
+
+	while (NumSpareBackends < wanted &&
+		   CountChildren(BACKEND_TYPE_NORMAL) < MaxConnections - ReservedBackends &&
+		   canAcceptConnections() == CAC_OK)
+	{
+		if (!StartSpareBackend())
+			break;
+	}
+}
+
+/*
+ * StartSpareBackend -- fork a spare backend
+ *
+ * returns: false if that failed, true otherwise.
+ */
+static bool
+StartSpareBackend(void)
+{
+	Backend    *bn;
+	pid_t		pid;
+	int			fds[2];
+
+	bn = (Backend *) malloc(sizeof(Backend));
+	if (!bn)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+		return false;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+	{
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not create socket pair for spare backend: %m")));
+		free(bn);
+		return false;
+	}
+
+	/* See BackendStartup */
+	MyCancelKey = PostmasterRandom();
+	bn->cancel_key = MyCancelKey;
+	bn->dead_end = false;
+	bn->child_slot = MyPMChildSlot = AssignPostmasterChildSlot();
+	bn->bgworker_notify = false;
+
+	pid = fork_process();
+	if (pid == 0)				/* child */
+	{
+		free(bn);
+
+		/* Detangle from postmaster */
+		InitPostmasterChild();
+
+		/* Close the postmaster's sockets, including other spares' */
+		ClosePostmasterPorts(false);
+		closesocket(fds[0]);
+
+		SpareBackendMain(fds[1]);
+	}
+
+	closesocket(fds[1]);
+
+	if (pid < 0)
+	{
+		/* in parent, fork failed */
+		int			save_errno = errno;
+
+		closesocket(fds[0]);
+		(void) ReleasePostmasterChildSlot(bn->child_slot);
+		free(bn);
+		errno = save_errno;
+		ereport(LOG,
+				(errmsg("could not fork spare backend: %m")));
+		LastSpareFailureTime = time(NULL);
+		return false;
+	}
+
+	/* in parent, successful fork */
+	ereport(DEBUG2,
+			(errmsg_internal("forked new spare backend, pid=%d", (int) pid)));
+
+	bn->pid = pid;
+	bn->bkend_type = BACKEND_TYPE_NORMAL;
+	bn->spare_sock = fds[0];
+	dlist_push_head(&BackendList, &bn->elem);
+	NumSpareBackends++;
+
+	return true;
+}
+
+/*
+ * PassConnectionToSpare -- hand a new connection to a spare backend
+ *
+ * The Port is sent as it stands, with the client socket attached as
+ * SCM_RIGHTS ancillary data.  The spare's socket is closed either way: a
+ * spare that didn't get a complete message exits when it sees EOF.
+ *
+ * returns: true if the connection was passed, false if the caller must
+ * start a backend for it the usual way.
+ */
+static bool
+PassConnectionToSpare(Port *port)
+{
+	dlist_iter	iter;
+	Backend    *bn = NULL;
+	struct msghdr msg;
+	struct iovec iov;
+	union
+	{
+		struct cmsghdr hdr;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	}			cmsgbuf;
+	struct cmsghdr *cmsg;
+	ssize_t		rc;
+
+	if (NumSpareBackends == 0)
+		return false;
+
+	/* Let BackendStartup deal with anything but a plain connection */
+	port->canAcceptConnections = canAcceptConnections();
+	if (port->canAcceptConnections != CAC_OK)
+		return false;
+
+	dlist_foreach(iter, &BackendList)
+	{
+		Backend    *bp = dlist_container(Backend, elem, iter.cur);
+
+		if (bp->spare_sock != PGINVALID_SOCKET)
+		{
+			bn = bp;
+			break;
+		}
+	}
+	Assert(bn != NULL);
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = (void *) port;
+	iov.iov_len = sizeof(Port);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	memset(&cmsgbuf, 0, sizeof(cmsgbuf));
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &port->sock, sizeof(int));
+
+	/* The socket pair is otherwise unused, so this can't block */
+	rc = sendmsg(bn->spare_sock, &msg, 0);
+	CloseSpareSocket(bn);
+
+	if (rc != (ssize_t) sizeof(Port))
+	{
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not pass connection to spare backend: %m")));
+		return false;
+	}
+
+	ereport(DEBUG2,
+			(errmsg_internal("passed connection to spare backend, pid=%d socket=%d",
+							 (int) bn->pid, (int) port->sock)));
+	return true;
+}
+
+/*
+ * CloseSpareSocket -- stop treating a backend as a spare
+ */
+static void
+CloseSpareSocket(Backend *bp)
+{
+	if (bp->spare_sock == PGINVALID_SOCKET)
+		return;
+	closesocket(bp->spare_sock);
+	bp->spare_sock = PGINVALID_SOCKET;
+	NumSpareBackends--;
+}
+
+/* SIGHUP handler for a spare backend that hasn't got a connection yet */
+static void
+spare_sighup_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	spare_got_SIGHUP = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * SpareBackendMain -- main loop of a spare backend
+ *
+ * Do as much of the backend startup as we can without a client, then wait
+ * for the postmaster to pass us one on sock.  Meanwhile, keep up with
+ * configuration reloads and shared invalidation messages, like an idle
+ * backend would.
+ */
+static void
+SpareBackendMain(pgsocket sock)
+{
+	Port	   *port;
+	struct msghdr msg;
+	struct iovec iov;
+	union
+	{
+		struct cmsghdr hdr;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	}			cmsgbuf;
+	struct cmsghdr *cmsg;
+	ssize_t		rc;
+	size_t		received;
+	pgsocket	client_sock;
+
+	IsPreforkedBackend = true;
+
+	/* Signal handling as in PostgresMain */
+	pqsignal(SIGHUP, spare_sighup_handler);
+	pqsignal(SIGINT, SIG_IGN);
+	pqsignal(SIGTERM, die);
+	pqsignal(SIGQUIT, quickdie);
+	InitializeTimeouts();		/* establishes SIGALRM handler */
+	pqsignal(SIGPIPE, SIG_IGN);
+	pqsignal(SIGUSR1, procsignal_sigusr1_handler);
+	pqsignal(SIGUSR2, SIG_IGN);
+	pqsignal(SIGFPE, FloatExceptionHandler);
+	pqsignal(SIGCHLD, SIG_DFL);
+
+	sigdelset(&BlockSig, SIGQUIT);
+
+	init_ps_display("spare backend", "", "", "");
+
+	SetProcessingMode(InitProcessing);
+
+	BaseInit();
+	InitProcess();
+	PG_SETMASK(&UnBlockSig);
+	InitPostgresEarly();
+
+	/* Wait for a connection */
+	for (;;)
+	{
+		rc = WaitLatchOrSocket(MyLatch,
+					 WL_LATCH_SET | WL_SOCKET_READABLE | WL_POSTMASTER_DEATH,
+							   sock, -1L,
+							   WAIT_EVENT_SPARE_BACKEND_MAIN);
+		ResetLatch(MyLatch);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (spare_got_SIGHUP)
+		{
+			spare_got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (catchupInterruptPending)
+			ProcessCatchupInterrupt();
+
+		if (rc & WL_SOCKET_READABLE)
+			break;
+	}
+
+	/* From here on we'll be treated like any other client's backend */
+	PG_SETMASK(&BlockSig);
+
+	port = (Port *) calloc(1, sizeof(Port));
+	if (!port)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = (void *) port;
+	iov.iov_len = sizeof(Port);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	do
+	{
+		rc = recvmsg(sock, &msg, 0);
+	} while (rc < 0 && errno == EINTR);
+
+	/* EOF means the postmaster doesn't need us after all */
+	if (rc == 0)
+		proc_exit(0);
+	if (rc < 0)
+		ereport(FATAL,
+				(errcode_for_socket_access(),
+				 errmsg("could not receive connection from postmaster: %m")));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL ||
+		cmsg->cmsg_level != SOL_SOCKET ||
+		cmsg->cmsg_type != SCM_RIGHTS ||
+		cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+		ereport(FATAL,
+				(errmsg("postmaster did not pass a connection to spare backend")));
+	memcpy(&client_sock, CMSG_DATA(cmsg), sizeof(int));
+
+	/* The rest of the Port may trickle in separately */
+	for (received = rc; received < sizeof(Port); received += rc)
+	{
+		rc = recv(sock, (char *) port + received, sizeof(Port) - received, 0);
+		if (rc < 0 && errno == EINTR)
+		{
+			rc = 0;
+			continue;
+		}
+		if (rc <= 0)
+			ereport(FATAL,
+					(errmsg("incomplete connection data from postmaster")));
+	}
+	closesocket(sock);
+
+	port->sock = client_sock;
+
+	/*
+	 * The pointers in the Port are the postmaster's; only the GSSAPI state
+	 * has been allocated by this point (see ConnCreate).
+	 */
+	port->gss = NULL;
+#if defined(ENABLE_GSS) || defined(ENABLE_SSPI)
+	port->gss = (pg_gssinfo *) calloc(1, sizeof(pg_gssinfo));
+	if (!port->gss)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+#endif
+
+	/* Perform additional initialization and collect startup packet */
+	BackendInitialize(port);
+
+	/* And run the backend */
+	BackendRun(port);
+}
+#endif   /* HAVE_SPARE_BACKENDS */
+
+
 /*
  * BackendInitialize -- initialize an interactive (postmaster-child)
  *				backend process, and collect the client's startup packet.
@@ -4137,6 +4754,13 @@ BackendInitialize(Port *port)
 	if (status != STATUS_OK)
 		proc_exit(0);
 
+	/*
+	 * If the client asked for a compression algorithm we can use, confirm
+	 * it, and compress everything from here on.
+	 */
+	if (port->compression != NULL)
+		pq_enable_compression(port->compression);
+
 	/*
 	 * Now that we have the user and database name, we can set the process
 	 * title for ps.  It's good to do this as early as possible in startup.
@@ -4639,6 +5263,7 @@ SubPostmasterMain(int argc, char *argv[])
 		strcmp(argv[1], "--forkavlauncher") == 0 ||
 		strcmp(argv[1], "--forkavworker") == 0 ||
 		strcmp(argv[1], "--forkboot") == 0 ||
+		strcmp(argv[1], "--forkarch") == 0 ||
 		strncmp(argv[1], "--forkbgworker=", 15) == 0)
 		PGSharedMemoryReAttach();
 	else
@@ -4659,6 +5284,9 @@ SubPostmasterMain(int argc, char *argv[])
 	pgwin32_signal_initialize();
 #endif
 
+	/* Now that the postmaster death pipe is known, set up WaitLatch */
+	InitializeLatchWaitSet();
+
 	/* In EXEC_BACKEND case we will not have inherited these settings */
 	pqinitmask();
 	PG_SETMASK(&BlockSig);
@@ -4806,19 +5434,14 @@ SubPostmasterMain(int argc, char *argv[])
 		/* Close the postmaster's sockets */
 		ClosePostmasterPorts(false);
 
-		/* Do not want to attach to shared memory */
+		/*
+		 * We are attached to shared memory only to update the archiver
+		 * statistics, through the pgStatShared pointer restored above; the
+		 * archiver has no PGPROC.
+		 */
 
 		PgArchiverMain(argc, argv);		/* does not return */
 	}
-	if (strcmp(argv[1], "--forkcol") == 0)
-	{
-		/* Close the postmaster's sockets */
-		ClosePostmasterPorts(false);
-
-		/* Do not want to attach to shared memory */
-
-		PgstatCollectorMain(argc, argv);		/* does not return */
-	}
 	if (strcmp(argv[1], "--forklog") == 0)
 	{
 		/* Close the postmaster's sockets */
@@ -4921,12 +5544,6 @@ sigusr1_handler(SIGNAL_ARGS)
 	if (CheckPostmasterSignal(PMSIGNAL_BEGIN_HOT_STANDBY) &&
 		pmState == PM_RECOVERY && Shutdown == NoShutdown)
 	{
-		/*
-		 * Likewise, start other special children as needed.
-		 */
-		Assert(PgStatPID == 0);
-		PgStatPID = pgstat_start();
-
 		ereport(LOG,
 		(errmsg("database system is ready to accept read only connections")));
 
@@ -5289,6 +5906,7 @@ StartAutovacuumWorker(void)
 			bn->dead_end = false;
 			bn->child_slot = MyPMChildSlot = AssignPostmasterChildSlot();
 			bn->bgworker_notify = false;
+			bn->spare_sock = PGINVALID_SOCKET;
 
 			bn->pid = StartAutoVacWorker();
 			if (bn->pid > 0)
@@ -5590,6 +6208,7 @@ assign_backendlist_entry(RegisteredBgWorker *rw)
 	bn->bkend_type = BACKEND_TYPE_BGWORKER;
 	bn->dead_end = false;
 	bn->bgworker_notify = false;
+	bn->spare_sock = PGINVALID_SOCKET;
 
 	rw->rw_backend = bn;
 	rw->rw_child_slot = bn->child_slot;
@@ -5699,7 +6318,9 @@ maybe_start_bgworker(void)
 /*
  * When a backend asks to be notified about worker state changes, we
  * set a flag in its backend entry.  The background worker machinery needs
- * to know when such backends exit.
+ * to know when such backends exit.  The startup process, which can start
+ * parallel redo workers, isn't in the backend list; reaper() takes care of
+ * it.
  */
 bool
 PostmasterMarkPIDForWorkerNotify(int pid)
@@ -5707,6 +6328,9 @@ PostmasterMarkPIDForWorkerNotify(int pid)
 	dlist_iter	iter;
 	Backend    *bp;
 
+	if (pid == StartupPID)
+		return true;
+
 	dlist_foreach(iter, &BackendList)
 	{
 		bp = dlist_container(Backend, elem, iter.cur);
@@ -5729,7 +6353,7 @@ extern slock_t *ShmemLock;
 extern slock_t *ProcStructLock;
 extern PGPROC *AuxiliaryProcs;
 extern PMSignalData *PMSignalState;
-extern pgsocket pgStatSock;
+extern PgStatSharedState *pgStatShared;
 extern pg_time_t first_syslogger_file_time;
 
 #ifndef WIN32
@@ -5780,8 +6404,7 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->AuxiliaryProcs = AuxiliaryProcs;
 	param->PreparedXactProcs = PreparedXactProcs;
 	param->PMSignalState = PMSignalState;
-	if (!write_inheritable_socket(&param->pgStatSock, pgStatSock, childPid))
-		return false;
+	param->pgStatShared = pgStatShared;
 
 	param->PostmasterPid = PostmasterPid;
 	param->PgStartTime = PgStartTime;
@@ -5793,6 +6416,7 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->max_safe_fds = max_safe_fds;
 
 	param->MaxBackends = MaxBackends;
+	param->FastPathLockGroupsPerBackend = FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	param->PostmasterHandle = PostmasterHandle;
@@ -6011,7 +6635,7 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	AuxiliaryProcs = param->AuxiliaryProcs;
 	PreparedXactProcs = param->PreparedXactProcs;
 	PMSignalState = param->PMSignalState;
-	read_inheritable_socket(&pgStatSock, &param->pgStatSock);
+	pgStatShared = param->pgStatShared;
 
 	PostmasterPid = param->PostmasterPid;
 	PgStartTime = param->PgStartTime;
@@ -6023,6 +6647,7 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	max_safe_fds = param->max_safe_fds;
 
 	MaxBackends = param->MaxBackends;
+	FastPathLockGroupsPerBackend = param->FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	PostmasterHandle = param->PostmasterHandle;
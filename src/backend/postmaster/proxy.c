@@ -0,0 +1,1656 @@
+/*-------------------------------------------------------------------------
+ *
+ * proxy.c
+ *
+ *	Connection proxy: serves many client sessions from a bounded pool of
+ *	backends.
+ *
+ *	When proxy_port is set, the postmaster starts a connection proxy process
+ *	that accepts clients on that port and speaks the frontend/backend
+ *	protocol with them and with the server.  A client session is attached to
+ *	a backend only while it has a query or transaction in progress.  Once the
+ *	backend reports ReadyForQuery outside a transaction block, it goes back
+ *	to the pool for its combination of startup parameters (database, user and
+ *	options) and may serve another session.  Each pool keeps at most
+ *	session_pool_size backends; sessions wait for one to come free.
+ *
+ *	Clients authenticate exactly as they would when connecting directly: the
+ *	proxy relays the startup and authentication exchange to a new backend on
+ *	the server's Unix-domain socket.  It passes ProxyToken, a secret shared
+ *	with the postmaster, as "proxy_session", and the client's address (or
+ *	for a Unix-domain socket client, its user ID) as "proxy_client".  The
+ *	server then matches pg_hba.conf against the client's address rather than
+ *	ours.  Once authentication succeeds, the backend joins the pool, or exits
+ *	if the pool is full.  To add backends to a pool later, the proxy connects
+ *	with ProxyToken and no proxy_client, which the server accepts in place of
+ *	authentication.
+ *
+ *	A session that acquires state outliving its transaction, such as prepared
+ *	statements, temporary tables or changed settings, can't move to another
+ *	backend.  The backend says so with a "session_pinned" ParameterStatus
+ *	message (see PinPooledSession), which the proxy doesn't pass on.  From
+ *	then on the session keeps its backend until it disconnects, and that
+ *	backend no longer counts against the pool size.
+ *
+ *	The proxy is a single process running a poll() loop; it does not attach
+ *	to shared memory.  It hands out its own cancel keys and forwards cancel
+ *	requests to whichever backend is serving the session at the time.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/proxy.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+
+#include "lib/ilist.h"
+#include "lib/stringinfo.h"
+#include "libpq/ip.h"
+#include "libpq/pqcomm.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "postmaster/fork_process.h"
+#include "postmaster/postmaster.h"
+#include "postmaster/proxy.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/pg_shmem.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/ps_status.h"
+
+
+#define PROXY_RESTART_INTERVAL 10	/* How often to attempt to restart a
+									 * failed proxy; in seconds. */
+
+/*
+ * We stop reading from a socket while more than this many bytes wait to be
+ * sent to its peer, so that a slow reader can't make us buffer without
+ * bound.
+ */
+#define PROXY_BUFFER_LIMIT	(256 * 1024)
+#define PROXY_RECV_SIZE		8192
+
+/* GUC options */
+int			ProxyPortNumber = 0;
+int			SessionPoolSize = 10;
+int			ProxyMaxClients = 1000;
+
+char		ProxyToken[PROXY_TOKEN_LEN + 1];
+pgsocket	ProxyListenSocket[PROXY_MAXLISTEN];
+bool		IsConnectionProxy = false;
+
+static time_t last_proxy_start_time;
+
+#ifdef HAVE_CONNECTION_PROXY
+
+typedef struct SessionPool SessionPool;
+typedef struct ProxyClient ProxyClient;
+typedef struct ProxyBackend ProxyBackend;
+
+/* Sessions with the same startup parameters share a pool of backends */
+struct SessionPool
+{
+	dlist_node	node;			/* in session_pools */
+	char	   *params;			/* startup packet parameters, as sent */
+	int			params_len;
+	int			n_backends;		/* unpinned backends, including starting ones */
+	int			n_clients;
+	int			n_conns;		/* backend connections referring to us */
+	dlist_head	idle;			/* idle backends */
+	dlist_head	waiting;		/* sessions waiting for a backend */
+};
+
+typedef enum
+{
+	CLIENT_STARTUP,				/* reading the startup packet */
+	CLIENT_AUTH,				/* authenticating through a backend */
+	CLIENT_SESSION				/* authenticated */
+} ClientState;
+
+struct ProxyClient
+{
+	dlist_node	node;			/* in clients */
+	dlist_node	wait_node;		/* in pool->waiting, if waiting */
+	pgsocket	sock;			/* PGINVALID_SOCKET once closed */
+	int			pollidx;		/* slot in the pollfd array, or -1 */
+	StringInfoData in;			/* received, not yet relayed from in.cursor */
+	StringInfoData out;			/* to be sent, from out.cursor */
+	ClientState state;
+	bool		waiting;
+	bool		pinned;			/* session can't leave its backend */
+	bool		closing;		/* close once "out" has been sent */
+	char	   *peer;			/* proxy_client parameter describing us */
+	SessionPool *pool;
+	ProxyBackend *backend;		/* attached backend, if any */
+	uint32		msg_remaining;	/* rest of a message being passed through */
+	int			pending;		/* queries and Syncs not answered yet */
+	bool		in_batch;		/* extended-query messages since last Sync */
+	int32		cancel_key;
+};
+
+typedef enum
+{
+	BACKEND_AUTH,				/* relaying a client's authentication */
+	BACKEND_STARTUP,			/* starting up with the proxy token */
+	BACKEND_READY				/* idle, or serving a session */
+} BackendState;
+
+struct ProxyBackend
+{
+	dlist_node	node;			/* in backends */
+	dlist_node	idle_node;		/* in pool->idle, if idle */
+	pgsocket	sock;			/* PGINVALID_SOCKET once closed */
+	int			pollidx;		/* slot in the pollfd array, or -1 */
+	StringInfoData in;
+	StringInfoData out;
+	BackendState state;
+	bool		idle;
+	bool		counted;		/* counted in pool->n_backends? */
+	bool		pinned;
+	bool		closing;		/* close once "out" has been sent */
+	SessionPool *pool;
+	ProxyClient *client;		/* session being served, if any */
+	uint32		msg_remaining;	/* rest of a message being passed through */
+	int32		pid;			/* from BackendKeyData */
+	int32		key;
+	char	   *startup_error;	/* ErrorResponse received during startup */
+	int			startup_error_len;
+};
+
+/*
+ * Flags set by interrupt handlers for later service in the main loop.
+ */
+static volatile sig_atomic_t got_SIGTERM = false;
+static volatile sig_atomic_t got_SIGINT = false;
+
+static MemoryContext ProxyContext;
+static dlist_head clients = DLIST_STATIC_INIT(clients);
+static dlist_head backends = DLIST_STATIC_INIT(backends);
+static dlist_head session_pools = DLIST_STATIC_INIT(session_pools);
+static int	n_clients = 0;
+static int	n_backends = 0;
+static char server_socket_path[MAXPGPATH];
+
+
+static void ProxyMain(void) pg_attribute_noreturn();
+static void proxy_loop(void) pg_attribute_noreturn();
+static void proxy_sigterm_handler(SIGNAL_ARGS);
+static void proxy_sigint_handler(SIGNAL_ARGS);
+static void proxy_quickdie(SIGNAL_ARGS);
+static bool proxy_recv(pgsocket sock, StringInfo buf);
+static bool proxy_send(pgsocket sock, StringInfo buf);
+static pgsocket proxy_connect_server(void);
+static void proxy_accept(pgsocket lsock);
+static char *proxy_client_peer(pgsocket sock, struct sockaddr_storage * addr,
+				  ACCEPT_TYPE_ARG3 addrlen);
+static void proxy_cancel(int32 pid, int32 key);
+static void client_startup(ProxyClient *client);
+static void client_process(ProxyClient *client);
+static void client_flush(ProxyClient *client);
+static void client_error(ProxyClient *client, const char *sqlstate,
+			 const char *msg);
+static void client_close(ProxyClient *client);
+static ProxyBackend *client_get_backend(ProxyClient *client);
+static ProxyBackend *backend_connect(SessionPool *pool, const char *session);
+static void backend_process(ProxyBackend *backend);
+static void backend_message(ProxyBackend *backend, char type,
+				const char *msg, uint32 len);
+static void backend_flush(ProxyBackend *backend);
+static void backend_release(ProxyBackend *backend);
+static void backend_terminate(ProxyBackend *backend);
+static void backend_lost(ProxyBackend *backend);
+static void backend_uncount(ProxyBackend *backend);
+static SessionPool *pool_lookup(const char *params, int params_len);
+static void pool_add_backend(SessionPool *pool);
+static void pool_fail_waiting(SessionPool *pool, const char *msg, int len);
+static void proxy_free_closed(void);
+
+#endif   /* HAVE_CONNECTION_PROXY */
+
+
+/*
+ * proxy_start
+ *
+ *	Called from postmaster at startup or after an existing proxy died.
+ *	Attempt to fire up a fresh proxy process.
+ *
+ *	Returns PID of child process, or 0 if fail.
+ *
+ *	Note: if fail, we will be called again from the postmaster main loop.
+ */
+int
+proxy_start(void)
+{
+#ifdef HAVE_CONNECTION_PROXY
+	time_t		curtime;
+	pid_t		proxyPid;
+
+	/*
+	 * Do nothing if too soon since last proxy start.  This is a safety valve
+	 * to protect against continuous respawn attempts if the proxy is dying
+	 * immediately at launch.
+	 */
+	curtime = time(NULL);
+	if ((unsigned int) (curtime - last_proxy_start_time) <
+		(unsigned int) PROXY_RESTART_INTERVAL)
+		return 0;
+	last_proxy_start_time = curtime;
+
+	switch ((proxyPid = fork_process()))
+	{
+		case -1:
+			ereport(LOG,
+					(errmsg("could not fork connection proxy: %m")));
+			return 0;
+
+		case 0:
+			/* in postmaster child ... */
+			InitPostmasterChild();
+
+			/* Close the postmaster's sockets, except for ours */
+			IsConnectionProxy = true;
+			ClosePostmasterPorts(false);
+
+			/* Drop our connection to postmaster's shared memory, as well */
+			dsm_detach_all();
+			PGSharedMemoryDetach();
+
+			ProxyMain();
+			break;
+
+		default:
+			return (int) proxyPid;
+	}
+#endif
+
+	/* shouldn't get here */
+	return 0;
+}
+
+/*
+ * proxy_init_token
+ *
+ *	Called from postmaster at startup to generate ProxyToken.
+ *
+ *	The token stands in for a client's authentication, so it must not be
+ *	guessable; we take it straight from the kernel's random number generator
+ *	rather than from PostmasterRandom(), whose seed has little entropy.
+ */
+void
+proxy_init_token(void)
+{
+	unsigned char buf[PROXY_TOKEN_LEN / 2];
+	int			fd;
+	int			i;
+
+	fd = open("/dev/urandom", O_RDONLY | PG_BINARY, 0);
+	if (fd < 0)
+		ereport(FATAL,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", "/dev/urandom")));
+	if (read(fd, buf, sizeof(buf)) != sizeof(buf))
+		ereport(FATAL,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", "/dev/urandom")));
+	close(fd);
+
+	for (i = 0; i < sizeof(buf); i++)
+		snprintf(ProxyToken + 2 * i, 3, "%02x", buf[i]);
+}
+
+#ifdef HAVE_CONNECTION_PROXY
+
+/*
+ * ProxyMain
+ *
+ *	Main entry point for the connection proxy process.
+ */
+static void
+ProxyMain(void)
+{
+	char	   *rawstring;
+	List	   *elemlist;
+	int			i;
+
+	pqsignal(SIGHUP, SIG_IGN);
+	pqsignal(SIGINT, proxy_sigint_handler);
+	pqsignal(SIGTERM, proxy_sigterm_handler);
+	pqsignal(SIGQUIT, proxy_quickdie);
+	pqsignal(SIGALRM, SIG_IGN);
+	pqsignal(SIGPIPE, SIG_IGN);
+	pqsignal(SIGUSR1, SIG_IGN);
+	pqsignal(SIGUSR2, SIG_IGN);
+	pqsignal(SIGCHLD, SIG_DFL);
+	pqsignal(SIGTTIN, SIG_DFL);
+	pqsignal(SIGTTOU, SIG_DFL);
+	pqsignal(SIGCONT, SIG_DFL);
+	pqsignal(SIGWINCH, SIG_DFL);
+	PG_SETMASK(&UnBlockSig);
+
+	/*
+	 * Identify myself via ps
+	 */
+	init_ps_display("connection proxy", "", "", "");
+
+	ProxyContext = AllocSetContextCreate(TopMemoryContext,
+										 "Connection proxy",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE);
+	MemoryContextSwitchTo(ProxyContext);
+
+	/* for our cancel keys */
+	srandom((unsigned int) (MyProcPid ^ MyStartTime));
+
+	/* We reach the server through the first of its Unix-domain sockets */
+	rawstring = pstrdup(Unix_socket_directories);
+	if (!SplitDirectoriesString(rawstring, ',', &elemlist) || elemlist == NIL)
+		ereport(FATAL,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("connection proxy requires \"unix_socket_directories\" to be set")));
+	UNIXSOCK_PATH(server_socket_path, PostPortNumber,
+				  (char *) linitial(elemlist));
+	list_free_deep(elemlist);
+	pfree(rawstring);
+
+	for (i = 0; i < PROXY_MAXLISTEN; i++)
+	{
+		if (ProxyListenSocket[i] == PGINVALID_SOCKET)
+			break;
+		if (!pg_set_noblock(ProxyListenSocket[i]))
+			ereport(FATAL,
+					(errcode_for_socket_access(),
+					 errmsg("could not set socket to nonblocking mode: %m")));
+	}
+
+	proxy_loop();
+}
+
+/* SIGTERM: stop accepting new clients, exit once all are gone */
+static void
+proxy_sigterm_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGTERM = true;
+
+	errno = save_errno;
+}
+
+/* SIGINT: disconnect everybody and exit */
+static void
+proxy_sigint_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGINT = true;
+
+	errno = save_errno;
+}
+
+/* SIGQUIT signal handler for proxy process */
+static void
+proxy_quickdie(SIGNAL_ARGS)
+{
+	PG_SETMASK(&BlockSig);
+
+	/*
+	 * We don't want to run any atexit callbacks; we have no shared memory to
+	 * clean up, and the kernel closes our sockets.
+	 */
+	_exit(1);
+}
+
+/*
+ * The main loop: wait for any socket to become ready, and move data along.
+ */
+static void
+proxy_loop(void)
+{
+	struct pollfd *fds = NULL;
+	int			fds_size = 0;
+	bool		listening = true;
+
+	for (;;)
+	{
+		int			nfds = 0;
+		int			nlisten = 0;
+		int			rc;
+		int			i;
+		dlist_iter	iter;
+
+		if (got_SIGINT)
+			proc_exit(0);
+
+		if (got_SIGTERM)
+		{
+			/* refuse new clients from now on */
+			if (listening)
+			{
+				for (i = 0; i < PROXY_MAXLISTEN; i++)
+				{
+					if (ProxyListenSocket[i] == PGINVALID_SOCKET)
+						break;
+					closesocket(ProxyListenSocket[i]);
+					ProxyListenSocket[i] = PGINVALID_SOCKET;
+				}
+				listening = false;
+			}
+			if (n_clients == 0)
+				proc_exit(0);
+		}
+
+		if (fds_size < PROXY_MAXLISTEN + 1 + n_clients + n_backends)
+		{
+			fds_size = 2 * (PROXY_MAXLISTEN + 1 + n_clients + n_backends);
+			if (fds)
+				pfree(fds);
+			fds = (struct pollfd *) palloc(fds_size * sizeof(struct pollfd));
+		}
+
+		fds[nfds].fd = postmaster_alive_fds[POSTMASTER_FD_WATCH];
+		fds[nfds].events = POLLIN;
+		nfds++;
+
+		for (i = 0; i < PROXY_MAXLISTEN; i++)
+		{
+			if (ProxyListenSocket[i] == PGINVALID_SOCKET)
+				break;
+			fds[nfds].fd = ProxyListenSocket[i];
+			fds[nfds].events = POLLIN;
+			nfds++;
+			nlisten++;
+		}
+
+		dlist_foreach(iter, &clients)
+		{
+			ProxyClient *client = dlist_container(ProxyClient, node, iter.cur);
+			ProxyBackend *backend = client->backend;
+
+			client->pollidx = -1;
+			if (client->sock == PGINVALID_SOCKET)
+				continue;
+			fds[nfds].fd = client->sock;
+			fds[nfds].events = 0;
+			if (client->out.cursor < client->out.len)
+				fds[nfds].events |= POLLOUT;
+			if (!client->closing &&
+				client->in.len - client->in.cursor < PROXY_BUFFER_LIMIT &&
+				(backend == NULL ||
+				 backend->out.len - backend->out.cursor < PROXY_BUFFER_LIMIT))
+				fds[nfds].events |= POLLIN;
+			client->pollidx = nfds++;
+		}
+
+		dlist_foreach(iter, &backends)
+		{
+			ProxyBackend *backend = dlist_container(ProxyBackend, node, iter.cur);
+			ProxyClient *client = backend->client;
+
+			backend->pollidx = -1;
+			if (backend->sock == PGINVALID_SOCKET)
+				continue;
+			fds[nfds].fd = backend->sock;
+			fds[nfds].events = 0;
+			if (backend->out.cursor < backend->out.len)
+				fds[nfds].events |= POLLOUT;
+			if (client == NULL ||
+				client->out.len - client->out.cursor < PROXY_BUFFER_LIMIT)
+				fds[nfds].events |= POLLIN;
+			backend->pollidx = nfds++;
+		}
+
+		/* wake up now and then to notice signals that arrived just before */
+		rc = poll(fds, nfds, 1000);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(FATAL,
+					(errcode_for_socket_access(),
+					 errmsg("poll() failed in connection proxy: %m")));
+		}
+		if (rc == 0)
+			continue;
+
+		/* exit at once if the postmaster is gone */
+		if (fds[0].revents != 0)
+			proc_exit(1);
+
+		for (i = 1; i <= nlisten; i++)
+		{
+			if (fds[i].revents & POLLIN)
+				proxy_accept(fds[i].fd);
+		}
+
+		/*
+		 * Service the sockets that are ready.  Anything created meanwhile has
+		 * no pollfd slot and waits for the next round; anything closed keeps
+		 * its list entry until proxy_free_closed.
+		 */
+		dlist_foreach(iter, &clients)
+		{
+			ProxyClient *client = dlist_container(ProxyClient, node, iter.cur);
+			short		revents;
+
+			if (client->pollidx < 0 || client->sock == PGINVALID_SOCKET)
+				continue;
+			revents = fds[client->pollidx].revents;
+			if (revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				if (proxy_recv(client->sock, &client->in))
+					client_process(client);
+				else
+					client_close(client);
+			}
+			if ((revents & POLLOUT) && client->sock != PGINVALID_SOCKET)
+				client_flush(client);
+		}
+
+		dlist_foreach(iter, &backends)
+		{
+			ProxyBackend *backend = dlist_container(ProxyBackend, node, iter.cur);
+			short		revents;
+
+			if (backend->pollidx < 0 || backend->sock == PGINVALID_SOCKET)
+				continue;
+			revents = fds[backend->pollidx].revents;
+			if (revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				if (proxy_recv(backend->sock, &backend->in))
+					backend_process(backend);
+				else
+					backend_lost(backend);
+			}
+			if ((revents & POLLOUT) && backend->sock != PGINVALID_SOCKET)
+				backend_flush(backend);
+		}
+
+		proxy_free_closed();
+	}
+}
+
+/*
+ * Read what the socket has into buf.  Returns false on EOF or error.
+ */
+static bool
+proxy_recv(pgsocket sock, StringInfo buf)
+{
+	int			n;
+
+	/* first drop what has been consumed already */
+	if (buf->cursor > 0)
+	{
+		memmove(buf->data, buf->data + buf->cursor, buf->len - buf->cursor);
+		buf->len -= buf->cursor;
+		buf->cursor = 0;
+	}
+
+	enlargeStringInfo(buf, PROXY_RECV_SIZE);
+	n = recv(sock, buf->data + buf->len, buf->maxlen - buf->len - 1, 0);
+	if (n < 0)
+		return (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK);
+	if (n == 0)
+		return false;
+
+	buf->len += n;
+	buf->data[buf->len] = '\0';
+	return true;
+}
+
+/*
+ * Send as much of buf as the socket takes.  Returns false on error.
+ */
+static bool
+proxy_send(pgsocket sock, StringInfo buf)
+{
+	while (buf->cursor < buf->len)
+	{
+		int			n;
+
+		n = send(sock, buf->data + buf->cursor, buf->len - buf->cursor, 0);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		buf->cursor += n;
+	}
+	resetStringInfo(buf);
+	return true;
+}
+
+/*
+ * Open a connection to the server's Unix-domain socket, in blocking mode.
+ */
+static pgsocket
+proxy_connect_server(void)
+{
+	struct sockaddr_un addr;
+	pgsocket	sock;
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock == PGINVALID_SOCKET)
+	{
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not create socket: %m")));
+		return PGINVALID_SOCKET;
+	}
+
+	MemSet(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strlcpy(addr.sun_path, server_socket_path, sizeof(addr.sun_path));
+	if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+	{
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("connection proxy could not connect to server socket \"%s\": %m",
+						server_socket_path)));
+		closesocket(sock);
+		return PGINVALID_SOCKET;
+	}
+
+	return sock;
+}
+
+/*
+ * Accept the connections waiting on a listen socket.
+ */
+static void
+proxy_accept(pgsocket lsock)
+{
+	for (;;)
+	{
+		struct sockaddr_storage addr;
+		ACCEPT_TYPE_ARG3 addrlen = sizeof(addr);
+		ProxyClient *client;
+		pgsocket	sock;
+
+		sock = accept(lsock, (struct sockaddr *) &addr, &addrlen);
+		if (sock == PGINVALID_SOCKET)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				ereport(LOG,
+						(errcode_for_socket_access(),
+						 errmsg("could not accept new connection: %m")));
+			return;
+		}
+
+		if (!pg_set_noblock(sock))
+		{
+			ereport(LOG,
+					(errcode_for_socket_access(),
+					 errmsg("could not set socket to nonblocking mode: %m")));
+			closesocket(sock);
+			continue;
+		}
+
+#ifdef TCP_NODELAY
+		if (addr.ss_family != AF_UNIX)
+		{
+			int			on = 1;
+
+			if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
+						   (char *) &on, sizeof(on)) < 0)
+				ereport(LOG,
+						(errmsg("setsockopt(TCP_NODELAY) failed: %m")));
+		}
+#endif
+
+		client = (ProxyClient *) palloc0(sizeof(ProxyClient));
+		client->sock = sock;
+		client->pollidx = -1;
+		client->peer = proxy_client_peer(sock, &addr, addrlen);
+		initStringInfo(&client->in);
+		initStringInfo(&client->out);
+		client->state = CLIENT_STARTUP;
+		client->cancel_key = (int32) random();
+		dlist_push_tail(&clients, &client->node);
+		n_clients++;
+
+		if (n_clients > ProxyMaxClients)
+			client_error(client, "53300", "sorry, too many clients already");
+	}
+}
+
+/*
+ * Describe a newly accepted client for the server, which applies pg_hba.conf
+ * to it: the numeric host and port of a TCP client, "local" and the user ID
+ * of a Unix-domain socket client, or just "local" if that isn't available,
+ * which makes peer authentication fail.
+ */
+static char *
+proxy_client_peer(pgsocket sock, struct sockaddr_storage * addr,
+				  ACCEPT_TYPE_ARG3 addrlen)
+{
+	char		host[NI_MAXHOST];
+	char		serv[NI_MAXSERV];
+
+	if (addr->ss_family == AF_UNIX)
+	{
+		uid_t		uid;
+		gid_t		gid;
+
+		if (getpeereid(sock, &uid, &gid) != 0)
+			return pstrdup("local");
+		return psprintf("local %lu", (unsigned long) uid);
+	}
+
+	if (pg_getnameinfo_all(addr, addrlen, host, sizeof(host),
+						   serv, sizeof(serv),
+						   NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+		return NULL;
+	return psprintf("%s %s", host, serv);
+}
+
+/*
+ * Forward a cancel request to the backend serving the session, if any.
+ */
+static void
+proxy_cancel(int32 pid, int32 key)
+{
+	dlist_iter	iter;
+
+	if (pid != MyProcPid)
+		return;
+
+	dlist_foreach(iter, &clients)
+	{
+		ProxyClient *client = dlist_container(ProxyClient, node, iter.cur);
+		ProxyBackend *backend = client->backend;
+		uint32		packet[4];
+		pgsocket	sock;
+
+		if (client->cancel_key != key || client->sock == PGINVALID_SOCKET)
+			continue;
+		if (backend == NULL || backend->pid == 0)
+			return;
+
+		sock = proxy_connect_server();
+		if (sock == PGINVALID_SOCKET)
+			return;
+		packet[0] = htonl(sizeof(packet));
+		packet[1] = htonl(CANCEL_REQUEST_CODE);
+		packet[2] = htonl(backend->pid);
+		packet[3] = htonl(backend->key);
+		if (send(sock, (char *) packet, sizeof(packet), 0) != sizeof(packet))
+			ereport(LOG,
+					(errcode_for_socket_access(),
+					 errmsg("could not send cancel request: %m")));
+		closesocket(sock);
+		return;
+	}
+}
+
+/*
+ * Process the client's startup packet, which is first SSL negotiation, a
+ * cancel request or the real thing.
+ */
+static void
+client_startup(ProxyClient *client)
+{
+	StringInfo	in = &client->in;
+	StringInfoData params;
+	bool		have_user = false;
+	ProxyBackend *backend;
+	uint32		len;
+	ProtocolVersion proto;
+	char	   *body;
+	char	   *end;
+
+	while (client->state == CLIENT_STARTUP && !client->closing)
+	{
+		if (in->len - in->cursor < 4)
+			return;
+		memcpy(&len, in->data + in->cursor, 4);
+		len = ntohl(len);
+		if (len < 8 || len > MAX_STARTUP_PACKET_LENGTH)
+		{
+			client_error(client, "08P01", "invalid length of startup packet");
+			return;
+		}
+		if (in->len - in->cursor < len)
+			return;
+
+		memcpy(&proto, in->data + in->cursor + 4, 4);
+		proto = ntohl(proto);
+		body = in->data + in->cursor + 8;
+		end = in->data + in->cursor + len;
+		in->cursor += len;
+
+		if (proto == NEGOTIATE_SSL_CODE)
+		{
+			/* we don't do SSL; the client may go on without it */
+			appendStringInfoChar(&client->out, 'N');
+			client_flush(client);
+			continue;
+		}
+
+		if (proto == CANCEL_REQUEST_CODE)
+		{
+			if (len == sizeof(CancelRequestPacket))
+			{
+				uint32		pid;
+				uint32		key;
+
+				memcpy(&pid, body, 4);
+				memcpy(&key, body + 4, 4);
+				proxy_cancel((int32) ntohl(pid), (int32) ntohl(key));
+			}
+			client_close(client);
+			return;
+		}
+
+		if (PG_PROTOCOL_MAJOR(proto) != 3)
+		{
+			client_error(client, "0A000",
+						 "the connection proxy supports only protocol 3");
+			return;
+		}
+
+		/*
+		 * Copy the parameters, leaving out those that the proxy handles (or
+		 * refuses) itself.  The result identifies the session pool.
+		 */
+		initStringInfo(&params);
+		while (body < end && *body != '\0')
+		{
+			char	   *name = body;
+			char	   *value;
+
+			value = (char *) memchr(name, '\0', end - name);
+			if (value == NULL || ++value >= end)
+				break;
+			body = (char *) memchr(value, '\0', end - value);
+			if (body == NULL)
+				break;
+			body++;
+
+			if (strcmp(name, "replication") == 0)
+			{
+				client_error(client, "0A000",
+							 "replication connections are not supported by the connection proxy");
+				pfree(params.data);
+				return;
+			}
+			if (strcmp(name, "compression") == 0 ||
+				strcmp(name, "proxy_session") == 0 ||
+				strcmp(name, "proxy_client") == 0)
+				continue;
+			if (strcmp(name, "user") == 0)
+				have_user = true;
+			appendBinaryStringInfo(&params, name, body - name);
+		}
+		if (body >= end || *body != '\0')
+		{
+			client_error(client, "08P01", "invalid startup packet layout");
+			pfree(params.data);
+			return;
+		}
+		if (!have_user)
+		{
+			client_error(client, "28000",
+						 "no PostgreSQL user name specified in startup packet");
+			pfree(params.data);
+			return;
+		}
+
+		client->pool = pool_lookup(params.data, params.len);
+		client->pool->n_clients++;
+		pfree(params.data);
+
+		/* authenticate the client through a backend of its own */
+		if (client->peer == NULL)
+		{
+			client_error(client, "08006",
+						 "the connection proxy could not determine the client address");
+			return;
+		}
+		backend = backend_connect(client->pool, client->peer);
+		if (backend == NULL)
+		{
+			client_error(client, "08006",
+						 "the connection proxy could not connect to the server");
+			return;
+		}
+		backend->state = BACKEND_AUTH;
+		backend->client = client;
+		client->backend = backend;
+		client->state = CLIENT_AUTH;
+	}
+}
+
+/*
+ * Pass on what the client sent, message by message, to its backend.
+ */
+static void
+client_process(ProxyClient *client)
+{
+	StringInfo	in = &client->in;
+
+	if (client->state == CLIENT_STARTUP)
+		client_startup(client);
+
+	while (client->state != CLIENT_STARTUP &&
+		   client->sock != PGINVALID_SOCKET && !client->closing)
+	{
+		ProxyBackend *backend = client->backend;
+		uint32		avail = in->len - in->cursor;
+		uint32		len;
+		char		type;
+
+		if (client->msg_remaining > 0)
+		{
+			uint32		n = Min(avail, client->msg_remaining);
+
+			if (n == 0)
+				break;
+			appendBinaryStringInfo(&backend->out, in->data + in->cursor, n);
+			in->cursor += n;
+			client->msg_remaining -= n;
+			continue;
+		}
+
+		if (avail < 5)
+			break;
+		type = in->data[in->cursor];
+		memcpy(&len, in->data + in->cursor + 1, 4);
+		len = ntohl(len);
+		if (len < 4)
+		{
+			client_error(client, "08P01", "invalid message length");
+			break;
+		}
+
+		if (type == 'X')
+		{
+			client_close(client);
+			return;
+		}
+
+		if (client->state == CLIENT_AUTH)
+		{
+			/* only authentication responses can be passed on yet */
+			if (type != 'p')
+				break;
+		}
+		else if (backend == NULL)
+		{
+			backend = client_get_backend(client);
+			if (backend == NULL)
+				break;
+		}
+
+		/* keep track of what the backend still has to answer */
+		switch (type)
+		{
+			case 'Q':			/* simple query */
+			case 'F':			/* fastpath function call */
+				client->pending++;
+				break;
+			case 'S':			/* sync */
+				client->pending++;
+				client->in_batch = false;
+				break;
+			case 'P':			/* parse */
+			case 'B':			/* bind */
+			case 'E':			/* execute */
+			case 'D':			/* describe */
+			case 'C':			/* close */
+			case 'H':			/* flush */
+				client->in_batch = true;
+				break;
+			default:
+				break;
+		}
+
+		appendBinaryStringInfo(&backend->out, in->data + in->cursor, 5);
+		in->cursor += 5;
+		client->msg_remaining = len - 4;
+	}
+
+	if (client->backend)
+		backend_flush(client->backend);
+}
+
+/*
+ * Send the client what has been queued for it, and close it if it's done.
+ */
+static void
+client_flush(ProxyClient *client)
+{
+	if (client->sock == PGINVALID_SOCKET)
+		return;
+	if (!proxy_send(client->sock, &client->out))
+		client_close(client);
+	else if (client->closing && client->out.len == 0)
+		client_close(client);
+}
+
+/*
+ * Report a fatal error to the client, and close the connection once it has
+ * been sent.
+ */
+static void
+client_error(ProxyClient *client, const char *sqlstate, const char *msg)
+{
+	StringInfo	out = &client->out;
+	uint32		len;
+
+	len = htonl(4 + 7 + 2 + strlen(sqlstate) + 2 + strlen(msg) + 1);
+	appendStringInfoChar(out, 'E');
+	appendBinaryStringInfo(out, (char *) &len, 4);
+	appendBinaryStringInfo(out, "SFATAL", 7);
+	appendStringInfoChar(out, 'C');
+	appendBinaryStringInfo(out, sqlstate, strlen(sqlstate) + 1);
+	appendStringInfoChar(out, 'M');
+	appendBinaryStringInfo(out, msg, strlen(msg) + 1);
+	appendStringInfoChar(out, '\0');
+
+	client->closing = true;
+	client_flush(client);
+}
+
+/*
+ * Close the client connection.
+ */
+static void
+client_close(ProxyClient *client)
+{
+	ProxyBackend *backend = client->backend;
+
+	if (client->sock == PGINVALID_SOCKET)
+		return;
+	closesocket(client->sock);
+	client->sock = PGINVALID_SOCKET;
+
+	if (client->waiting)
+	{
+		dlist_delete(&client->wait_node);
+		client->waiting = false;
+	}
+
+	/*
+	 * A backend still attached is authenticating, in the middle of a
+	 * transaction or holds the session's private state; in any case it
+	 * can't be used for anybody else.
+	 */
+	if (backend)
+	{
+		client->backend = NULL;
+		backend->client = NULL;
+		backend_terminate(backend);
+	}
+
+	if (client->pool)
+		client->pool->n_clients--;
+	n_clients--;
+}
+
+/*
+ * Find a backend to run the session's next transaction.  If there's none
+ * idle, the session waits, and backend_release will attach one later.
+ */
+static ProxyBackend *
+client_get_backend(ProxyClient *client)
+{
+	SessionPool *pool = client->pool;
+	ProxyBackend *backend;
+
+	if (!dlist_is_empty(&pool->idle))
+	{
+		backend = dlist_container(ProxyBackend, idle_node,
+								  dlist_pop_head_node(&pool->idle));
+		backend->idle = false;
+		backend->client = client;
+		client->backend = backend;
+		return backend;
+	}
+
+	if (!client->waiting)
+	{
+		dlist_push_tail(&pool->waiting, &client->wait_node);
+		client->waiting = true;
+	}
+	if (pool->n_backends < SessionPoolSize)
+		pool_add_backend(pool);
+	return NULL;
+}
+
+/*
+ * Open a new backend connection for the pool and queue its startup packet.
+ * "peer" is the value of the proxy_client startup parameter if the backend is
+ * to authenticate that client, or NULL to start a backend for the pool.
+ */
+static ProxyBackend *
+backend_connect(SessionPool *pool, const char *peer)
+{
+	ProxyBackend *backend;
+	pgsocket	sock;
+	uint32		n;
+
+	sock = proxy_connect_server();
+	if (sock == PGINVALID_SOCKET)
+		return NULL;
+	if (!pg_set_noblock(sock))
+	{
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not set socket to nonblocking mode: %m")));
+		closesocket(sock);
+		return NULL;
+	}
+
+	backend = (ProxyBackend *) palloc0(sizeof(ProxyBackend));
+	backend->sock = sock;
+	backend->pollidx = -1;
+	initStringInfo(&backend->in);
+	initStringInfo(&backend->out);
+	backend->pool = pool;
+	pool->n_conns++;
+
+	n = htonl(4 + 4 + pool->params_len + sizeof("proxy_session") +
+			  strlen(ProxyToken) + 1 +
+			  (peer ? sizeof("proxy_client") + strlen(peer) + 1 : 0) + 1);
+	appendBinaryStringInfo(&backend->out, (char *) &n, 4);
+	n = htonl(PG_PROTOCOL(3, 0));
+	appendBinaryStringInfo(&backend->out, (char *) &n, 4);
+	appendBinaryStringInfo(&backend->out, pool->params, pool->params_len);
+	appendBinaryStringInfo(&backend->out, "proxy_session",
+						   sizeof("proxy_session"));
+	appendBinaryStringInfo(&backend->out, ProxyToken, strlen(ProxyToken) + 1);
+	if (peer)
+	{
+		appendBinaryStringInfo(&backend->out, "proxy_client",
+							   sizeof("proxy_client"));
+		appendBinaryStringInfo(&backend->out, peer, strlen(peer) + 1);
+	}
+	appendStringInfoChar(&backend->out, '\0');
+
+	dlist_push_tail(&backends, &backend->node);
+	n_backends++;
+
+	return backend;
+}
+
+/*
+ * Pass on what the backend sent, message by message, to the session it
+ * serves.  Other than the few messages the proxy has to look at, messages
+ * are streamed through without waiting for them to arrive completely.
+ */
+static void
+backend_process(ProxyBackend *backend)
+{
+	StringInfo	in = &backend->in;
+
+	while (backend->sock != PGINVALID_SOCKET)
+	{
+		ProxyClient *client = backend->client;
+		uint32		avail = in->len - in->cursor;
+		uint32		len;
+		char		type;
+		char	   *msg;
+
+		if (backend->msg_remaining > 0)
+		{
+			uint32		n = Min(avail, backend->msg_remaining);
+
+			if (n == 0)
+				break;
+			if (client)
+				appendBinaryStringInfo(&client->out, in->data + in->cursor, n);
+			in->cursor += n;
+			backend->msg_remaining -= n;
+			continue;
+		}
+
+		if (avail < 5)
+			break;
+		msg = in->data + in->cursor;
+		type = msg[0];
+		memcpy(&len, msg + 1, 4);
+		len = ntohl(len);
+		if (len < 4)
+		{
+			ereport(LOG,
+					(errmsg("connection proxy received invalid message from server")));
+			backend_lost(backend);
+			break;
+		}
+
+		if (type != 'K' && type != 'Z' && type != 'S' &&
+			!(type == 'E' && client == NULL))
+		{
+			if (client)
+				appendBinaryStringInfo(&client->out, msg, 5);
+			in->cursor += 5;
+			backend->msg_remaining = len - 4;
+			continue;
+		}
+
+		if (avail < 1 + len)
+			break;
+		in->cursor += 1 + len;
+		backend_message(backend, type, msg, len - 4);
+	}
+
+	if (backend->client)
+		client_flush(backend->client);
+}
+
+/*
+ * Handle a complete message from the backend that the proxy has to look at.
+ * "msg" points to the type byte, followed by the length word and "len"
+ * bytes of message body.
+ */
+static void
+backend_message(ProxyBackend *backend, char type, const char *msg, uint32 len)
+{
+	ProxyClient *client = backend->client;
+	const char *body = msg + 5;
+
+	switch (type)
+	{
+		case 'K':				/* BackendKeyData */
+			if (len == 8)
+			{
+				uint32		n;
+
+				memcpy(&n, body, 4);
+				backend->pid = (int32) ntohl(n);
+				memcpy(&n, body + 4, 4);
+				backend->key = (int32) ntohl(n);
+			}
+
+			/* the client gets a key of ours, valid across backends */
+			if (client)
+			{
+				uint32		buf[3];
+
+				buf[0] = htonl(12);
+				buf[1] = htonl((uint32) MyProcPid);
+				buf[2] = htonl((uint32) client->cancel_key);
+				appendStringInfoChar(&client->out, 'K');
+				appendBinaryStringInfo(&client->out, (char *) buf, 12);
+			}
+			return;
+
+		case 'S':				/* ParameterStatus */
+			if (len > sizeof("session_pinned") &&
+				memcmp(body, "session_pinned", sizeof("session_pinned")) == 0)
+			{
+				if (client && !client->pinned)
+				{
+					SessionPool *pool = backend->pool;
+
+					ereport(DEBUG1,
+							(errmsg_internal("connection proxy: session pinned to backend %d",
+											 (int) backend->pid)));
+					client->pinned = true;
+					backend->pinned = true;
+					backend_uncount(backend);
+
+					/* the pool may start another backend in its place */
+					if (!dlist_is_empty(&pool->waiting) &&
+						pool->n_backends < SessionPoolSize)
+						pool_add_backend(pool);
+				}
+				return;
+			}
+			break;
+
+		case 'Z':				/* ReadyForQuery */
+			if (backend->state == BACKEND_STARTUP)
+			{
+				backend->state = BACKEND_READY;
+				backend_release(backend);
+				return;
+			}
+			if (backend->state == BACKEND_AUTH)
+			{
+				SessionPool *pool = backend->pool;
+
+				/* nothing to do if the client hung up meanwhile */
+				if (client == NULL)
+					return;
+
+				/* the client is in; its backend joins the pool if there's room */
+				backend->state = BACKEND_READY;
+				appendBinaryStringInfo(&client->out, msg, 1 + 4 + len);
+				client->state = CLIENT_SESSION;
+				client->backend = NULL;
+				backend->client = NULL;
+				if (pool->n_backends < SessionPoolSize)
+				{
+					pool->n_backends++;
+					backend->counted = true;
+					backend_release(backend);
+				}
+				else
+					backend_terminate(backend);
+
+				/* anything the client sent meanwhile can go now */
+				client_flush(client);
+				client_process(client);
+				return;
+			}
+			if (client == NULL)
+				return;
+
+			appendBinaryStringInfo(&client->out, msg, 1 + 4 + len);
+			if (client->pending > 0)
+				client->pending--;
+
+			/*
+			 * Between transactions, with nothing more to answer, the session
+			 * can give the backend back.
+			 */
+			if (len >= 1 && body[0] == 'I' && client->pending == 0 &&
+				!client->in_batch && client->msg_remaining == 0 &&
+				!client->pinned)
+			{
+				client->backend = NULL;
+				backend->client = NULL;
+				client_flush(client);
+				backend_release(backend);
+			}
+			return;
+
+		case 'E':				/* ErrorResponse, with nobody to send it to */
+			if (client == NULL)
+			{
+				if (backend->state == BACKEND_STARTUP &&
+					backend->startup_error == NULL)
+				{
+					backend->startup_error = (char *) palloc(1 + 4 + len);
+					memcpy(backend->startup_error, msg, 1 + 4 + len);
+					backend->startup_error_len = 1 + 4 + len;
+				}
+				return;
+			}
+			break;
+	}
+
+	if (client)
+		appendBinaryStringInfo(&client->out, msg, 1 + 4 + len);
+}
+
+/*
+ * Send the backend what has been queued for it, and close it if it's done.
+ */
+static void
+backend_flush(ProxyBackend *backend)
+{
+	if (backend->sock == PGINVALID_SOCKET)
+		return;
+	if (!proxy_send(backend->sock, &backend->out))
+		backend_lost(backend);
+	else if (backend->closing && backend->out.len == 0)
+		backend_lost(backend);
+}
+
+/*
+ * A backend has nothing to do: give it to a waiting session, or keep it in
+ * the pool.
+ */
+static void
+backend_release(ProxyBackend *backend)
+{
+	SessionPool *pool = backend->pool;
+	ProxyClient *client;
+
+	Assert(backend->client == NULL && !backend->pinned);
+
+	if (dlist_is_empty(&pool->waiting))
+	{
+		/* the most recently used backends are the first to be reused */
+		dlist_push_head(&pool->idle, &backend->idle_node);
+		backend->idle = true;
+		return;
+	}
+
+	client = dlist_container(ProxyClient, wait_node,
+							 dlist_pop_head_node(&pool->waiting));
+	client->waiting = false;
+	client->backend = backend;
+	backend->client = client;
+	client_process(client);
+}
+
+/*
+ * Ask a backend to exit, once it has been sent what's queued for it.
+ */
+static void
+backend_terminate(ProxyBackend *backend)
+{
+	SessionPool *pool = backend->pool;
+	uint32		len = htonl(4);
+
+	if (backend->sock == PGINVALID_SOCKET || backend->closing)
+		return;
+
+	appendStringInfoChar(&backend->out, 'X');
+	appendBinaryStringInfo(&backend->out, (char *) &len, 4);
+	backend->closing = true;
+	if (backend->idle)
+	{
+		dlist_delete(&backend->idle_node);
+		backend->idle = false;
+	}
+	backend_uncount(backend);
+	backend_flush(backend);
+
+	/* a waiting session may start another backend in its place */
+	if (!dlist_is_empty(&pool->waiting) && pool->n_backends < SessionPoolSize)
+		pool_add_backend(pool);
+}
+
+/*
+ * The backend connection is closed, or gone.
+ */
+static void
+backend_lost(ProxyBackend *backend)
+{
+	SessionPool *pool = backend->pool;
+	ProxyClient *client = backend->client;
+	bool		starting = (backend->state == BACKEND_STARTUP);
+
+	if (backend->sock == PGINVALID_SOCKET)
+		return;
+	closesocket(backend->sock);
+	backend->sock = PGINVALID_SOCKET;
+
+	if (backend->idle)
+	{
+		dlist_delete(&backend->idle_node);
+		backend->idle = false;
+	}
+	backend_uncount(backend);
+
+	/* the session can't go on without it; let it have what was sent */
+	if (client)
+	{
+		client->backend = NULL;
+		backend->client = NULL;
+		client->closing = true;
+		client_flush(client);
+	}
+
+	/*
+	 * If a backend failed to start and no other backend is left to serve the
+	 * pool, the sessions waiting for one get the error.
+	 */
+	if (starting && pool->n_backends == 0 && !dlist_is_empty(&pool->waiting))
+	{
+		if (backend->startup_error)
+			pool_fail_waiting(pool, backend->startup_error,
+							  backend->startup_error_len);
+		else
+			pool_fail_waiting(pool, NULL, 0);
+	}
+}
+
+/*
+ * The backend no longer counts against the size of its pool.
+ */
+static void
+backend_uncount(ProxyBackend *backend)
+{
+	if (backend->counted)
+	{
+		backend->pool->n_backends--;
+		backend->counted = false;
+	}
+}
+
+/*
+ * Find the pool for sessions with the given startup parameters, creating it
+ * if necessary.
+ */
+static SessionPool *
+pool_lookup(const char *params, int params_len)
+{
+	SessionPool *pool;
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &session_pools)
+	{
+		pool = dlist_container(SessionPool, node, iter.cur);
+		if (pool->params_len == params_len &&
+			memcmp(pool->params, params, params_len) == 0)
+			return pool;
+	}
+
+	pool = (SessionPool *) palloc0(sizeof(SessionPool));
+	pool->params = (char *) palloc(params_len);
+	memcpy(pool->params, params, params_len);
+	pool->params_len = params_len;
+	dlist_init(&pool->idle);
+	dlist_init(&pool->waiting);
+	dlist_push_tail(&session_pools, &pool->node);
+	return pool;
+}
+
+/*
+ * Start another backend for the pool, using the proxy token.
+ */
+static void
+pool_add_backend(SessionPool *pool)
+{
+	ProxyBackend *backend;
+
+	backend = backend_connect(pool, NULL);
+	if (backend == NULL)
+	{
+		if (pool->n_backends == 0)
+			pool_fail_waiting(pool, NULL, 0);
+		return;
+	}
+	backend->state = BACKEND_STARTUP;
+	backend->counted = true;
+	pool->n_backends++;
+}
+
+/*
+ * Disconnect the sessions waiting for a backend of the pool, sending them
+ * the given ErrorResponse message, or a generic one.
+ */
+static void
+pool_fail_waiting(SessionPool *pool, const char *msg, int len)
+{
+	while (!dlist_is_empty(&pool->waiting))
+	{
+		ProxyClient *client;
+
+		client = dlist_container(ProxyClient, wait_node,
+								 dlist_pop_head_node(&pool->waiting));
+		client->waiting = false;
+		if (msg)
+		{
+			appendBinaryStringInfo(&client->out, msg, len);
+			client->closing = true;
+			client_flush(client);
+		}
+		else
+			client_error(client, "08006",
+						 "the connection proxy could not start a server process");
+	}
+}
+
+/*
+ * Free the memory of closed connections, and of pools nobody uses.
+ */
+static void
+proxy_free_closed(void)
+{
+	dlist_mutable_iter miter;
+
+	dlist_foreach_modify(miter, &clients)
+	{
+		ProxyClient *client = dlist_container(ProxyClient, node, miter.cur);
+
+		if (client->sock != PGINVALID_SOCKET)
+			continue;
+		dlist_delete(&client->node);
+		pfree(client->in.data);
+		pfree(client->out.data);
+		if (client->peer)
+			pfree(client->peer);
+		pfree(client);
+	}
+
+	dlist_foreach_modify(miter, &backends)
+	{
+		ProxyBackend *backend = dlist_container(ProxyBackend, node, miter.cur);
+
+		if (backend->sock != PGINVALID_SOCKET)
+			continue;
+		dlist_delete(&backend->node);
+		backend->pool->n_conns--;
+		n_backends--;
+		if (backend->startup_error)
+			pfree(backend->startup_error);
+		pfree(backend->in.data);
+		pfree(backend->out.data);
+		pfree(backend);
+	}
+
+	dlist_foreach_modify(miter, &session_pools)
+	{
+		SessionPool *pool = dlist_container(SessionPool, node, miter.cur);
+
+		if (pool->n_clients > 0 || pool->n_conns > 0)
+			continue;
+		dlist_delete(&pool->node);
+		pfree(pool->params);
+		pfree(pool);
+	}
+}
+
+#endif   /* HAVE_CONNECTION_PROXY */
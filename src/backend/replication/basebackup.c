@@ -16,6 +16,12 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <time.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "access/xlog_internal.h"		/* for pg_start/stop_backup */
 #include "catalog/catalog.h"
@@ -34,10 +40,19 @@
 #include "storage/ipc.h"
 #include "utils/builtins.h"
 #include "utils/elog.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/timestamp.h"
 
 
+/* Server-side compression methods for the tar streams */
+typedef enum
+{
+	BACKUP_COMPRESSION_NONE,
+	BACKUP_COMPRESSION_GZIP,
+	BACKUP_COMPRESSION_ZSTD
+} BackupCompression;
+
 typedef struct
 {
 	const char *label;
@@ -47,6 +62,7 @@ typedef struct
 	bool		includewal;
 	uint32		maxrate;
 	bool		sendtblspcmapfile;
+	BackupCompression compression;
 } basebackup_options;
 
 
@@ -65,6 +81,11 @@ static void parse_basebackup_options(List *options, basebackup_options *opt);
 static void SendXlogRecPtrResult(XLogRecPtr ptr, TimeLineID tli);
 static int	compareWalFileNames(const void *a, const void *b);
 static void throttle(size_t increment);
+static void begin_tar_stream(void);
+static void send_tar_data(const char *data, size_t len);
+static void end_tar_stream(void);
+static void put_copy_data(const char *data, size_t len);
+static void compress_cleanup(void *arg);
 
 /* Was the backup currently in-progress initiated in recovery mode? */
 static bool backup_started_in_recovery = false;
@@ -94,6 +115,15 @@ static int64 elapsed_min_unit;
 /* The last check of the transfer rate. */
 static int64 throttled_last;
 
+/*
+ * Compression of the tar streams, if the client asked for it.  The
+ * compressor and its output buffer live in the replication command's memory
+ * context, and are set up again for each tar stream.
+ */
+static BackupCompression backup_compression = BACKUP_COMPRESSION_NONE;
+static void *backup_compressor = NULL;
+static char *compress_buf = NULL;
+
 /*
  * Called when ERROR or FATAL happens in perform_base_backup() after
  * we have started the backup - make sure we end it!
@@ -125,6 +155,7 @@ perform_base_backup(basebackup_options *opt, DIR *tblspcdir)
 	datadirpathlen = strlen(DataDir);
 
 	backup_started_in_recovery = RecoveryInProgress();
+	backup_compression = opt->compression;
 
 	startptr = do_pg_start_backup(opt->label, opt->fastcheckpoint, &starttli,
 								  &labelfile, tblspcdir, &tablespaces,
@@ -193,13 +224,8 @@ perform_base_backup(basebackup_options *opt, DIR *tblspcdir)
 		foreach(lc, tablespaces)
 		{
 			tablespaceinfo *ti = (tablespaceinfo *) lfirst(lc);
-			StringInfoData buf;
 
-			/* Send CopyOutResponse message */
-			pq_beginmessage(&buf, 'H');
-			pq_sendbyte(&buf, 0);		/* overall format */
-			pq_sendint(&buf, 0, 2);		/* natts */
-			pq_endmessage(&buf);
+			begin_tar_stream();
 
 			if (ti->path == NULL)
 			{
@@ -242,7 +268,7 @@ perform_base_backup(basebackup_options *opt, DIR *tblspcdir)
 				Assert(lnext(lc) == NULL);
 			}
 			else
-				pq_putemptymessage('c');		/* CopyDone */
+				end_tar_stream();
 		}
 	}
 	PG_END_ENSURE_ERROR_CLEANUP(base_backup_cleanup, (Datum) 0);
@@ -417,10 +443,7 @@ perform_base_backup(basebackup_options *opt, DIR *tblspcdir)
 			while ((cnt = fread(buf, 1, Min(sizeof(buf), XLogSegSize - len), fp)) > 0)
 			{
 				CheckXLogRemoved(segno, tli);
-				/* Send the chunk as a CopyData message */
-				if (pq_putmessage('d', buf, cnt))
-					ereport(ERROR,
-							(errmsg("base backup could not send data, aborting backup")));
+				send_tar_data(buf, cnt);
 
 				len += cnt;
 				throttle(cnt);
@@ -478,8 +501,8 @@ perform_base_backup(basebackup_options *opt, DIR *tblspcdir)
 			sendFileWithContent(pathbuf, "");
 		}
 
-		/* Send CopyDone message for the last tar file */
-		pq_putemptymessage('c');
+		/* Finish the last tar file */
+		end_tar_stream();
 	}
 	SendXlogRecPtrResult(endptr, endtli);
 }
@@ -511,6 +534,7 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 	bool		o_wal = false;
 	bool		o_maxrate = false;
 	bool		o_tablespace_map = false;
+	bool		o_compression = false;
 
 	MemSet(opt, 0, sizeof(*opt));
 	foreach(lopt, options)
@@ -590,6 +614,46 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 			opt->sendtblspcmapfile = true;
 			o_tablespace_map = true;
 		}
+		else if (strcmp(defel->defname, "compression") == 0)
+		{
+			char	   *method = strVal(defel->arg);
+
+			if (o_compression)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+
+			if (strcmp(method, "none") == 0)
+				opt->compression = BACKUP_COMPRESSION_NONE;
+			else if (strcmp(method, "gzip") == 0)
+			{
+#ifndef HAVE_LIBZ
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("compression method gzip not supported"),
+						 errdetail("This functionality requires the server to be built with zlib support."),
+						 errhint("You need to rebuild PostgreSQL using --with-zlib.")));
+#endif
+				opt->compression = BACKUP_COMPRESSION_GZIP;
+			}
+			else if (strcmp(method, "zstd") == 0)
+			{
+#ifndef USE_ZSTD
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("compression method zstd not supported"),
+						 errdetail("This functionality requires the server to be built with zstd support."),
+						 errhint("You need to rebuild PostgreSQL using --with-zstd.")));
+#endif
+				opt->compression = BACKUP_COMPRESSION_ZSTD;
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("base backup compression method \"%s\" not recognized",
+								method)));
+			o_compression = true;
+		}
 		else
 			elog(ERROR, "option \"%s\" not recognized",
 				 defel->defname);
@@ -806,7 +870,7 @@ sendFileWithContent(const char *filename, const char *content)
 
 	_tarWriteHeader(filename, NULL, &statbuf);
 	/* Send the contents as a CopyData message */
-	pq_putmessage('d', content, len);
+	send_tar_data(content, len);
 
 	/* Pad to 512 byte boundary, per tar format requirements */
 	pad = ((len + 511) & ~511) - len;
@@ -815,7 +879,7 @@ sendFileWithContent(const char *filename, const char *content)
 		char		buf[512];
 
 		MemSet(buf, 0, pad);
-		pq_putmessage('d', buf, pad);
+		send_tar_data(buf, pad);
 	}
 }
 
@@ -1164,9 +1228,7 @@ sendFile(char *readfilename, char *tarfilename, struct stat * statbuf,
 	while ((cnt = fread(buf, 1, Min(sizeof(buf), statbuf->st_size - len), fp)) > 0)
 	{
 		/* Send the chunk as a CopyData message */
-		if (pq_putmessage('d', buf, cnt))
-			ereport(ERROR,
-			   (errmsg("base backup could not send data, aborting backup")));
+		send_tar_data(buf, cnt);
 
 		len += cnt;
 		throttle(cnt);
@@ -1189,7 +1251,7 @@ sendFile(char *readfilename, char *tarfilename, struct stat * statbuf,
 		while (len < statbuf->st_size)
 		{
 			cnt = Min(sizeof(buf), statbuf->st_size - len);
-			pq_putmessage('d', buf, cnt);
+			send_tar_data(buf, cnt);
 			len += cnt;
 			throttle(cnt);
 		}
@@ -1203,7 +1265,7 @@ sendFile(char *readfilename, char *tarfilename, struct stat * statbuf,
 	if (pad > 0)
 	{
 		MemSet(buf, 0, pad);
-		pq_putmessage('d', buf, pad);
+		send_tar_data(buf, pad);
 	}
 
 	FreeFile(fp);
@@ -1241,7 +1303,266 @@ _tarWriteHeader(const char *filename, const char *linktarget,
 			elog(ERROR, "unrecognized tar error: %d", rc);
 	}
 
-	pq_putmessage('d', h, 512);
+	send_tar_data(h, 512);
+}
+
+/*
+ * Start a tar stream: send a CopyOutResponse and, if the tar streams are to
+ * be compressed, start a new gzip member or zstd frame for it.
+ */
+static void
+begin_tar_stream(void)
+{
+	StringInfoData buf;
+
+	/* Send CopyOutResponse message */
+	pq_beginmessage(&buf, 'H');
+	pq_sendbyte(&buf, 0);		/* overall format */
+	pq_sendint(&buf, 0, 2);		/* natts */
+	pq_endmessage(&buf);
+
+	if (backup_compression == BACKUP_COMPRESSION_NONE)
+		return;
+
+	if (compress_buf == NULL)
+	{
+		MemoryContextCallback *cb;
+
+		compress_buf = palloc(TAR_SEND_SIZE);
+		cb = palloc(sizeof(MemoryContextCallback));
+		cb->func = compress_cleanup;
+		cb->arg = NULL;
+		MemoryContextRegisterResetCallback(CurrentMemoryContext, cb);
+	}
+
+	switch (backup_compression)
+	{
+		case BACKUP_COMPRESSION_NONE:
+			break;
+		case BACKUP_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			{
+				z_stream   *zs = (z_stream *) backup_compressor;
+
+				if (zs == NULL)
+				{
+					zs = (z_stream *) palloc0(sizeof(z_stream));
+					/* windowBits above 15 asks for a gzip header and trailer */
+					if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+									 15 + 16, 8,
+									 Z_DEFAULT_STRATEGY) != Z_OK)
+						ereport(ERROR,
+								(errcode(ERRCODE_OUT_OF_MEMORY),
+								 errmsg("out of memory"),
+								 errdetail("Failed while creating a gzip compressor.")));
+					backup_compressor = zs;
+				}
+				else if (deflateReset(zs) != Z_OK)
+					elog(ERROR, "could not reset gzip compressor");
+			}
+#endif
+			break;
+		case BACKUP_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_CStream *zcs = (ZSTD_CStream *) backup_compressor;
+				size_t		ret;
+
+				if (zcs == NULL)
+				{
+					zcs = ZSTD_createCStream();
+					if (zcs == NULL)
+						ereport(ERROR,
+								(errcode(ERRCODE_OUT_OF_MEMORY),
+								 errmsg("out of memory"),
+								 errdetail("Failed while creating a zstd compressor.")));
+					backup_compressor = zcs;
+				}
+				ret = ZSTD_initCStream(zcs, ZSTD_CLEVEL_DEFAULT);
+				if (ZSTD_isError(ret))
+					elog(ERROR, "could not initialize zstd compressor: %s",
+						 ZSTD_getErrorName(ret));
+			}
+#endif
+			break;
+	}
+}
+
+/*
+ * Add data to the current tar stream, compressing it first if requested.
+ */
+static void
+send_tar_data(const char *data, size_t len)
+{
+	switch (backup_compression)
+	{
+		case BACKUP_COMPRESSION_NONE:
+			put_copy_data(data, len);
+			break;
+		case BACKUP_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			{
+				z_stream   *zs = (z_stream *) backup_compressor;
+
+				zs->next_in = (Bytef *) data;
+				zs->avail_in = len;
+				do
+				{
+					zs->next_out = (Bytef *) compress_buf;
+					zs->avail_out = TAR_SEND_SIZE;
+					if (deflate(zs, Z_NO_FLUSH) == Z_STREAM_ERROR)
+						elog(ERROR, "could not compress base backup data: %s",
+							 zs->msg ? zs->msg : "unknown error");
+					if (zs->avail_out < TAR_SEND_SIZE)
+						put_copy_data(compress_buf,
+									  TAR_SEND_SIZE - zs->avail_out);
+				} while (zs->avail_out == 0);
+			}
+#endif
+			break;
+		case BACKUP_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_CStream *zcs = (ZSTD_CStream *) backup_compressor;
+				ZSTD_inBuffer in;
+
+				in.src = data;
+				in.size = len;
+				in.pos = 0;
+				while (in.pos < in.size)
+				{
+					ZSTD_outBuffer out;
+					size_t		ret;
+
+					out.dst = compress_buf;
+					out.size = TAR_SEND_SIZE;
+					out.pos = 0;
+					ret = ZSTD_compressStream(zcs, &out, &in);
+					if (ZSTD_isError(ret))
+						elog(ERROR, "could not compress base backup data: %s",
+							 ZSTD_getErrorName(ret));
+					if (out.pos > 0)
+						put_copy_data(compress_buf, out.pos);
+				}
+			}
+#endif
+			break;
+	}
+}
+
+/*
+ * End a tar stream and send CopyDone.
+ *
+ * An uncompressed stream is left without the two zero blocks that end a tar
+ * archive; the client appends those itself, possibly after adding files of
+ * its own.  A compressed stream can't be appended to, so we add them here
+ * before ending the gzip member or zstd frame.
+ */
+static void
+end_tar_stream(void)
+{
+	if (backup_compression != BACKUP_COMPRESSION_NONE)
+	{
+		char		zerobuf[1024];
+
+		MemSet(zerobuf, 0, sizeof(zerobuf));
+		send_tar_data(zerobuf, sizeof(zerobuf));
+	}
+
+	switch (backup_compression)
+	{
+		case BACKUP_COMPRESSION_NONE:
+			break;
+		case BACKUP_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			{
+				z_stream   *zs = (z_stream *) backup_compressor;
+				int			ret;
+
+				zs->next_in = NULL;
+				zs->avail_in = 0;
+				do
+				{
+					zs->next_out = (Bytef *) compress_buf;
+					zs->avail_out = TAR_SEND_SIZE;
+					ret = deflate(zs, Z_FINISH);
+					if (ret == Z_STREAM_ERROR)
+						elog(ERROR, "could not compress base backup data: %s",
+							 zs->msg ? zs->msg : "unknown error");
+					if (zs->avail_out < TAR_SEND_SIZE)
+						put_copy_data(compress_buf,
+									  TAR_SEND_SIZE - zs->avail_out);
+				} while (ret != Z_STREAM_END);
+			}
+#endif
+			break;
+		case BACKUP_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_CStream *zcs = (ZSTD_CStream *) backup_compressor;
+				size_t		ret;
+
+				do
+				{
+					ZSTD_outBuffer out;
+
+					out.dst = compress_buf;
+					out.size = TAR_SEND_SIZE;
+					out.pos = 0;
+					ret = ZSTD_endStream(zcs, &out);
+					if (ZSTD_isError(ret))
+						elog(ERROR, "could not compress base backup data: %s",
+							 ZSTD_getErrorName(ret));
+					if (out.pos > 0)
+						put_copy_data(compress_buf, out.pos);
+				} while (ret > 0);
+			}
+#endif
+			break;
+	}
+
+	pq_putemptymessage('c');	/* CopyDone */
+}
+
+/*
+ * Send a chunk of the tar stream, as it goes over the wire, as a CopyData
+ * message.
+ */
+static void
+put_copy_data(const char *data, size_t len)
+{
+	if (pq_putmessage('d', data, len))
+		ereport(ERROR,
+				(errmsg("base backup could not send data, aborting backup")));
+}
+
+/*
+ * Free the compressor when the replication command's memory context goes
+ * away, whether the backup completed or not.
+ */
+static void
+compress_cleanup(void *arg)
+{
+	if (backup_compressor != NULL)
+	{
+		switch (backup_compression)
+		{
+			case BACKUP_COMPRESSION_NONE:
+				break;
+			case BACKUP_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+				deflateEnd((z_stream *) backup_compressor);
+#endif
+				break;
+			case BACKUP_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+				ZSTD_freeCStream((ZSTD_CStream *) backup_compressor);
+#endif
+				break;
+		}
+	}
+	backup_compressor = NULL;
+	compress_buf = NULL;
 }
 
 /*
@@ -1283,7 +1604,8 @@ throttle(size_t increment)
 		 */
 		wait_result = WaitLatch(MyLatch,
 							 WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-								(long) (sleep / 1000));
+								(long) (sleep / 1000),
+								WAIT_EVENT_BASE_BACKUP_THROTTLE);
 
 		if (wait_result & WL_LATCH_SET)
 			CHECK_FOR_INTERRUPTS();
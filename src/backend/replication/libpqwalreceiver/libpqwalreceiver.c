@@ -21,7 +21,9 @@
 
 #include "libpq-fe.h"
 #include "access/xlog.h"
+#include "lib/stringinfo.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "replication/walreceiver.h"
 #include "utils/builtins.h"
 
@@ -55,6 +57,9 @@ static void libpqrcv_endstreaming(TimeLineID *next_tli);
 static int	libpqrcv_receive(int timeout, char **buffer);
 static void libpqrcv_send(const char *buffer, int nbytes);
 static void libpqrcv_disconnect(void);
+static void libpqrcv_connect_logical(char *conninfo, char *appname);
+static void libpqrcv_startstreaming_logical(char *slotname,
+								XLogRecPtr startpoint, char *options);
 
 /* Prototypes for private functions */
 static bool libpq_select(int timeout_ms);
@@ -71,7 +76,8 @@ _PG_init(void)
 		walrcv_readtimelinehistoryfile != NULL ||
 		walrcv_startstreaming != NULL || walrcv_endstreaming != NULL ||
 		walrcv_receive != NULL || walrcv_send != NULL ||
-		walrcv_disconnect != NULL)
+		walrcv_disconnect != NULL || walrcv_connect_logical != NULL ||
+		walrcv_startstreaming_logical != NULL)
 		elog(ERROR, "libpqwalreceiver already loaded");
 	walrcv_connect = libpqrcv_connect;
 	walrcv_identify_system = libpqrcv_identify_system;
@@ -81,6 +87,8 @@ _PG_init(void)
 	walrcv_receive = libpqrcv_receive;
 	walrcv_send = libpqrcv_send;
 	walrcv_disconnect = libpqrcv_disconnect;
+	walrcv_connect_logical = libpqrcv_connect_logical;
+	walrcv_startstreaming_logical = libpqrcv_startstreaming_logical;
 }
 
 /*
@@ -117,6 +125,34 @@ libpqrcv_connect(char *conninfo)
 						PQerrorMessage(streamConn))));
 }
 
+/*
+ * Establish a logical replication connection to the publisher.
+ *
+ * Unlike libpqrcv_connect(), the connection is bound to the database named
+ * in the connection string, which logical decoding needs.
+ */
+static void
+libpqrcv_connect_logical(char *conninfo, char *appname)
+{
+	const char *keys[4];
+	const char *vals[4];
+
+	keys[0] = "dbname";
+	vals[0] = conninfo;
+	keys[1] = "replication";
+	vals[1] = "database";
+	keys[2] = "fallback_application_name";
+	vals[2] = appname;
+	keys[3] = NULL;
+	vals[3] = NULL;
+
+	streamConn = PQconnectdbParams(keys, vals, /* expand_dbname = */ true);
+	if (PQstatus(streamConn) != CONNECTION_OK)
+		ereport(ERROR,
+				(errmsg("could not connect to the publisher: %s",
+						PQerrorMessage(streamConn))));
+}
+
 /*
  * Check that primary's system identifier matches ours, and fetch the current
  * timeline ID of the primary.
@@ -215,6 +251,37 @@ libpqrcv_startstreaming(TimeLineID tli, XLogRecPtr startpoint, char *slotname)
 	return true;
 }
 
+/*
+ * Start logical decoding from the given slot, passing the output plugin
+ * options (already formatted as a parenthesized option list, or NULL).
+ */
+static void
+libpqrcv_startstreaming_logical(char *slotname, XLogRecPtr startpoint,
+								char *options)
+{
+	StringInfoData cmd;
+	PGresult   *res;
+
+	initStringInfo(&cmd);
+	appendStringInfo(&cmd, "START_REPLICATION SLOT \"%s\" LOGICAL %X/%X",
+					 slotname,
+					 (uint32) (startpoint >> 32), (uint32) startpoint);
+	if (options != NULL)
+		appendStringInfo(&cmd, " (%s)", options);
+
+	res = libpqrcv_PQexec(cmd.data);
+	pfree(cmd.data);
+
+	if (PQresultStatus(res) != PGRES_COPY_BOTH)
+	{
+		PQclear(res);
+		ereport(ERROR,
+				(errmsg("could not start logical replication: %s",
+						PQerrorMessage(streamConn))));
+	}
+	PQclear(res);
+}
+
 /*
  * Stop streaming WAL data. Returns the next timeline's ID in *next_tli, as
  * reported by the server, or 0 if it did not report it.
@@ -333,6 +400,8 @@ libpq_select(int timeout_ms)
 				(errcode_for_socket_access(),
 				 errmsg("socket not open")));
 
+	pgstat_report_wait_start(WAIT_EVENT_WAL_RECEIVER_MAIN);
+
 	/* We use poll(2) if available, otherwise select(2) */
 	{
 #ifdef HAVE_POLL
@@ -366,6 +435,8 @@ libpq_select(int timeout_ms)
 #endif   /* HAVE_POLL */
 	}
 
+	pgstat_report_wait_end();
+
 	if (ret == 0 || (ret < 0 && errno == EINTR))
 		return false;
 	if (ret < 0)
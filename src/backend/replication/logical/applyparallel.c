@@ -0,0 +1,940 @@
+/*-------------------------------------------------------------------------
+ * applyparallel.c
+ *	   Support routines for applying streamed transactions in parallel
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/logical/applyparallel.c
+ *
+ * NOTES
+ *	  When a subscription streams in-progress transactions, the leader apply
+ *	  worker hands each streamed transaction to a parallel apply worker, if
+ *	  one is free, instead of spooling it to a file until it commits.  The
+ *	  parallel apply worker applies the changes as they arrive, so that a
+ *	  large transaction is mostly applied by the time it commits on the
+ *	  publisher, and several transactions are applied at once.  The leader
+ *	  keeps a pool of up to max_parallel_apply_workers_per_subscription
+ *	  workers, which stay around for later transactions.
+ *
+ *	  Each worker has a dynamic shared memory segment holding a shm_mq, on
+ *	  which the leader sends it the protocol messages of its transaction as
+ *	  they were received, and a little shared state.  The worker runs the
+ *	  remote transaction in a local transaction block, and every remote
+ *	  subtransaction that makes changes in a savepoint, so that a remote
+ *	  subtransaction abort can be applied with ROLLBACK TO SAVEPOINT.
+ *
+ *	  The leader waits for the worker to finish applying at STREAM COMMIT,
+ *	  so that transactions still commit in the order of the publisher, and
+ *	  the worker commits with the leader's replication origin, which it
+ *	  shares.
+ *
+ *	  Two session-level locks, taken on the remote transaction with
+ *	  LockApplyTransactionForSession, make any wait between the two
+ *	  processes visible to the deadlock detector: the worker holds the
+ *	  transaction lock from the first block until it has committed or
+ *	  aborted, which is what the leader waits on at commit; and the leader
+ *	  holds the stream lock between the blocks of the transaction, which is
+ *	  what the worker waits on when it has applied a block.  If the leader
+ *	  then has to wait for a row lock held by the worker, while applying
+ *	  another transaction, the deadlock is detected instead of both waiting
+ *	  forever.
+ *
+ *	  A worker that fails just exits.  The leader then fails too, when it
+ *	  next talks to the worker, and the launcher restarts it; streaming
+ *	  restarts from the last transaction committed locally.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "access/xact.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "replication/logicallauncher.h"
+#include "replication/origin.h"
+#include "replication/walreceiver.h"
+#include "replication/worker_internal.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lmgr.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/timestamp.h"
+
+
+#define PARALLEL_APPLY_MAGIC		0x787ca067
+
+#define PARALLEL_APPLY_KEY_SHARED	1
+#define PARALLEL_APPLY_KEY_MQ		2
+
+/* Size of the queue of each worker */
+#define PARALLEL_APPLY_QUEUE_SIZE	(16 * 1024 * 1024)
+
+/* State of the transaction a worker applies */
+typedef enum ParallelTransState
+{
+	PARALLEL_TRANS_UNKNOWN,		/* handed to the worker, not yet started */
+	PARALLEL_TRANS_STARTED,		/* the worker holds the transaction lock */
+	PARALLEL_TRANS_FINISHED		/* committed or aborted */
+} ParallelTransState;
+
+/* Shared state of a parallel apply worker */
+typedef struct ParallelApplyWorkerShared
+{
+	slock_t		mutex;
+
+	/* Set up by the leader before the worker starts */
+	Oid			dbid;
+	Oid			userid;
+	Oid			subid;
+	int			leader_pid;
+	RepOriginId originid;
+
+	/* State of the transaction being applied, protected by the mutex */
+	ParallelTransState xact_state;
+	XLogRecPtr	last_commit_end;	/* end of the local commit record */
+} ParallelApplyWorkerShared;
+
+/* The leader's view of a worker of its pool */
+typedef struct ParallelApplyWorkerInfo
+{
+	BackgroundWorkerHandle *handle;
+	dsm_segment *seg;
+	shm_mq_handle *mq_handle;
+	ParallelApplyWorkerShared *shared;
+
+	TransactionId xid;			/* transaction handed to it, if any */
+	bool		stream_locked;	/* do we hold its stream lock? */
+} ParallelApplyWorkerInfo;
+
+/* Pool of workers of the leader */
+static List *ParallelApplyWorkerPool = NIL;
+
+/* In a parallel apply worker */
+bool		am_parallel_apply_worker = false;
+
+static ParallelApplyWorkerShared *MyParallelShared = NULL;
+
+/* The remote transaction we apply, and its subtransactions with savepoints */
+static TransactionId pa_xid = InvalidTransactionId;
+static TransactionId *pa_subxacts = NULL;
+static int	pa_nsubxacts = 0;
+static int	pa_maxsubxacts = 0;
+
+static volatile sig_atomic_t got_SIGHUP = false;
+
+static ParallelApplyWorkerInfo *pa_launch_worker(void);
+static void pa_stop_worker(ParallelApplyWorkerInfo *winfo);
+static void pa_send(ParallelApplyWorkerInfo *winfo, StringInfo s);
+static void pa_release_stream_lock(ParallelApplyWorkerInfo *winfo);
+static void pa_wait_for_xact_finish(ParallelApplyWorkerInfo *winfo);
+static void pa_free_worker(ParallelApplyWorkerInfo *winfo);
+static void pa_finish_xact(bool committed);
+
+
+/*
+ * Find the worker applying the given transaction.
+ */
+static ParallelApplyWorkerInfo *
+pa_find_worker(TransactionId xid)
+{
+	ListCell   *lc;
+
+	foreach(lc, ParallelApplyWorkerPool)
+	{
+		ParallelApplyWorkerInfo *winfo = (ParallelApplyWorkerInfo *) lfirst(lc);
+
+		if (winfo->xid == xid)
+			return winfo;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get an idle worker of the pool, starting a new one if the pool isn't full
+ * yet.  Returns NULL if there's none to be had.
+ */
+static ParallelApplyWorkerInfo *
+pa_get_free_worker(void)
+{
+	ListCell   *lc;
+
+	foreach(lc, ParallelApplyWorkerPool)
+	{
+		ParallelApplyWorkerInfo *winfo = (ParallelApplyWorkerInfo *) lfirst(lc);
+
+		if (!TransactionIdIsValid(winfo->xid))
+			return winfo;
+	}
+
+	if (list_length(ParallelApplyWorkerPool) >=
+		max_parallel_apply_workers_per_subscription)
+		return NULL;
+
+	return pa_launch_worker();
+}
+
+/*
+ * Set up the shared memory of a new worker, and start it.
+ */
+static ParallelApplyWorkerInfo *
+pa_launch_worker(void)
+{
+	MemoryContext oldctx;
+	shm_toc_estimator e;
+	Size		segsize;
+	dsm_segment *seg;
+	shm_toc    *toc;
+	ParallelApplyWorkerShared *shared;
+	shm_mq	   *mq;
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+	ParallelApplyWorkerInfo *winfo;
+
+	shm_toc_initialize_estimator(&e);
+	shm_toc_estimate_chunk(&e, sizeof(ParallelApplyWorkerShared));
+	shm_toc_estimate_chunk(&e, PARALLEL_APPLY_QUEUE_SIZE);
+	shm_toc_estimate_keys(&e, 2);
+	segsize = shm_toc_estimate(&e);
+
+	oldctx = MemoryContextSwitchTo(ApplyContext);
+
+	seg = dsm_create(segsize, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (seg == NULL)
+	{
+		MemoryContextSwitchTo(oldctx);
+		return NULL;
+	}
+	/* The segment lives as long as the worker */
+	dsm_pin_mapping(seg);
+
+	toc = shm_toc_create(PARALLEL_APPLY_MAGIC, dsm_segment_address(seg),
+						 segsize);
+
+	shared = (ParallelApplyWorkerShared *)
+		shm_toc_allocate(toc, sizeof(ParallelApplyWorkerShared));
+	SpinLockInit(&shared->mutex);
+	shared->dbid = MyDatabaseId;
+	shared->userid = GetUserId();
+	shared->subid = MySubscription->oid;
+	shared->leader_pid = MyProcPid;
+	shared->originid = replorigin_session_origin;
+	shared->xact_state = PARALLEL_TRANS_UNKNOWN;
+	shared->last_commit_end = InvalidXLogRecPtr;
+	shm_toc_insert(toc, PARALLEL_APPLY_KEY_SHARED, shared);
+
+	mq = shm_mq_create(shm_toc_allocate(toc, PARALLEL_APPLY_QUEUE_SIZE),
+					   PARALLEL_APPLY_QUEUE_SIZE);
+	shm_toc_insert(toc, PARALLEL_APPLY_KEY_MQ, mq);
+	shm_mq_set_sender(mq, MyProc);
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main = ParallelApplyWorkerMain;
+	snprintf(worker.bgw_name, BGW_MAXLEN,
+			 "logical replication parallel apply worker for subscription %u",
+			 MySubscription->oid);
+	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(seg));
+	worker.bgw_notify_pid = MyProcPid;
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+	{
+		ereport(LOG,
+				(errmsg("could not start logical replication parallel apply worker"),
+				 errhint("You might need to increase max_worker_processes.")));
+		dsm_detach(seg);
+		MemoryContextSwitchTo(oldctx);
+		return NULL;
+	}
+
+	winfo = (ParallelApplyWorkerInfo *) palloc0(sizeof(ParallelApplyWorkerInfo));
+	winfo->handle = handle;
+	winfo->seg = seg;
+	winfo->mq_handle = shm_mq_attach(mq, seg, handle);
+	winfo->shared = shared;
+	winfo->xid = InvalidTransactionId;
+	winfo->stream_locked = false;
+
+	ParallelApplyWorkerPool = lappend(ParallelApplyWorkerPool, winfo);
+
+	MemoryContextSwitchTo(oldctx);
+
+	return winfo;
+}
+
+/*
+ * Stop an idle worker, and forget about it.  The worker exits when it
+ * notices that we detached from its queue.
+ */
+static void
+pa_stop_worker(ParallelApplyWorkerInfo *winfo)
+{
+	Assert(!TransactionIdIsValid(winfo->xid));
+
+	ParallelApplyWorkerPool = list_delete_ptr(ParallelApplyWorkerPool, winfo);
+
+	dsm_detach(winfo->seg);
+	pfree(winfo->handle);
+	pfree(winfo);
+}
+
+/*
+ * Send a message to a worker, waiting for room on its queue if needed.
+ *
+ * A worker waiting for a lock held by another worker, while we wait here
+ * for it to make room, is a deadlock the deadlock detector doesn't see, if
+ * the other worker waits for our stream lock.  That takes conflicting
+ * changes that only conflict locally, in a unique index the publisher
+ * doesn't have for example, but it can happen, so we give up after
+ * wal_receiver_timeout rather than wait forever.
+ */
+static void
+pa_send(ParallelApplyWorkerInfo *winfo, StringInfo s)
+{
+	TimestampTz start_time = 0;
+
+	for (;;)
+	{
+		shm_mq_result result;
+		int			rc;
+
+		result = shm_mq_send(winfo->mq_handle, s->len, s->data, true);
+		if (result == SHM_MQ_SUCCESS)
+			break;
+		if (result == SHM_MQ_DETACHED)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("could not send data to logical replication parallel apply worker")));
+
+		/* The queue is full */
+		if (start_time == 0)
+			start_time = GetCurrentTimestamp();
+		else if (wal_receiver_timeout > 0 &&
+				 TimestampDifferenceExceeds(start_time, GetCurrentTimestamp(),
+											wal_receiver_timeout))
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("timed out sending data to logical replication parallel apply worker")));
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   1000L, WAIT_EVENT_LOGICAL_APPLY_SEND_DATA);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Hand the first block of a streamed transaction to a worker, or pass on
+ * a later block to the worker applying it.
+ *
+ * Returns false if the transaction isn't applied by a worker, and can't be
+ * because all of them are busy.  The caller then spools it.
+ */
+bool
+pa_send_stream_start(TransactionId xid, bool first_segment, StringInfo s)
+{
+	ParallelApplyWorkerInfo *winfo;
+
+	winfo = pa_find_worker(xid);
+	if (winfo != NULL)
+	{
+		pa_send(winfo, s);
+		pa_release_stream_lock(winfo);
+		return true;
+	}
+
+	/*
+	 * A later block of a transaction we don't know is treated as the first;
+	 * see apply_handle_stream_start.
+	 */
+	winfo = pa_get_free_worker();
+	if (winfo == NULL)
+		return false;
+
+	SpinLockAcquire(&winfo->shared->mutex);
+	winfo->shared->xact_state = PARALLEL_TRANS_UNKNOWN;
+	winfo->shared->last_commit_end = InvalidXLogRecPtr;
+	SpinLockRelease(&winfo->shared->mutex);
+
+	winfo->xid = xid;
+	winfo->stream_locked = false;
+
+	elog(DEBUG1, "handing streamed transaction %u to parallel apply worker",
+		 xid);
+
+	pa_send(winfo, s);
+
+	return true;
+}
+
+/*
+ * Pass on a change of a streamed transaction.
+ */
+void
+pa_send_data(TransactionId xid, StringInfo s)
+{
+	ParallelApplyWorkerInfo *winfo = pa_find_worker(xid);
+
+	Assert(winfo != NULL);
+	pa_send(winfo, s);
+}
+
+/*
+ * Pass on the end of a block of a streamed transaction.
+ *
+ * We take the stream lock first, for the worker to wait on until we send
+ * the next block, or the end of the transaction.
+ */
+void
+pa_send_stream_stop(TransactionId xid, StringInfo s)
+{
+	ParallelApplyWorkerInfo *winfo = pa_find_worker(xid);
+
+	Assert(winfo != NULL && !winfo->stream_locked);
+
+	LockApplyTransactionForSession(MySubscription->oid, xid,
+								   PARALLEL_APPLY_LOCK_STREAM,
+								   AccessExclusiveLock);
+	winfo->stream_locked = true;
+
+	pa_send(winfo, s);
+}
+
+/*
+ * Pass on the abort of a streamed transaction, or one of its
+ * subtransactions.  For the transaction itself, wait for the worker to
+ * have rolled back.
+ *
+ * Returns false if the transaction isn't applied by a worker.
+ */
+bool
+pa_send_stream_abort(TransactionId xid, TransactionId subxid, StringInfo s)
+{
+	ParallelApplyWorkerInfo *winfo = pa_find_worker(xid);
+
+	if (winfo == NULL)
+		return false;
+
+	pa_send(winfo, s);
+
+	if (subxid == xid)
+	{
+		pa_release_stream_lock(winfo);
+		pa_wait_for_xact_finish(winfo);
+		pa_free_worker(winfo);
+	}
+
+	return true;
+}
+
+/*
+ * Pass on the commit of a streamed transaction, and wait for the worker to
+ * have committed.  *local_end is set to the end of its commit record.
+ *
+ * Returns false if the transaction isn't applied by a worker.
+ */
+bool
+pa_send_stream_commit(TransactionId xid, StringInfo s, XLogRecPtr *local_end)
+{
+	ParallelApplyWorkerInfo *winfo = pa_find_worker(xid);
+
+	if (winfo == NULL)
+		return false;
+
+	pa_send(winfo, s);
+	pa_release_stream_lock(winfo);
+	pa_wait_for_xact_finish(winfo);
+
+	SpinLockAcquire(&winfo->shared->mutex);
+	*local_end = winfo->shared->last_commit_end;
+	SpinLockRelease(&winfo->shared->mutex);
+
+	pa_free_worker(winfo);
+
+	return true;
+}
+
+/*
+ * Let the worker go on with the next block, or the end of the transaction.
+ */
+static void
+pa_release_stream_lock(ParallelApplyWorkerInfo *winfo)
+{
+	if (!winfo->stream_locked)
+		return;
+
+	UnlockApplyTransactionForSession(MySubscription->oid, winfo->xid,
+									 PARALLEL_APPLY_LOCK_STREAM,
+									 AccessExclusiveLock);
+	winfo->stream_locked = false;
+}
+
+static ParallelTransState
+pa_get_xact_state(ParallelApplyWorkerShared *shared)
+{
+	ParallelTransState xact_state;
+
+	SpinLockAcquire(&shared->mutex);
+	xact_state = shared->xact_state;
+	SpinLockRelease(&shared->mutex);
+
+	return xact_state;
+}
+
+/*
+ * Wait for a worker to finish applying its transaction.
+ */
+static void
+pa_wait_for_xact_finish(ParallelApplyWorkerInfo *winfo)
+{
+	/*
+	 * Wait for the worker to take the transaction lock, which it does when
+	 * it starts applying the transaction.  It has certainly received the
+	 * first block, but might not have got to it yet.
+	 */
+	while (pa_get_xact_state(winfo->shared) == PARALLEL_TRANS_UNKNOWN)
+	{
+		pid_t		pid;
+		int			rc;
+
+		if (GetBackgroundWorkerPid(winfo->handle, &pid) != BGWH_STARTED &&
+			pa_get_xact_state(winfo->shared) == PARALLEL_TRANS_UNKNOWN)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("lost connection to the logical replication parallel apply worker")));
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   10L, WAIT_EVENT_LOGICAL_PARALLEL_APPLY_STATE_CHANGE);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	/* Now wait on the lock, until it has committed or aborted */
+	LockApplyTransactionForSession(MySubscription->oid, winfo->xid,
+								   PARALLEL_APPLY_LOCK_XACT, AccessShareLock);
+	UnlockApplyTransactionForSession(MySubscription->oid, winfo->xid,
+									 PARALLEL_APPLY_LOCK_XACT, AccessShareLock);
+
+	/* The lock is also released if the worker exits */
+	if (pa_get_xact_state(winfo->shared) != PARALLEL_TRANS_FINISHED)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("lost connection to the logical replication parallel apply worker")));
+}
+
+/*
+ * Put a worker back into the pool, or stop it if the pool is larger than
+ * max_parallel_apply_workers_per_subscription now allows.
+ */
+static void
+pa_free_worker(ParallelApplyWorkerInfo *winfo)
+{
+	Assert(!winfo->stream_locked);
+
+	winfo->xid = InvalidTransactionId;
+
+	if (list_length(ParallelApplyWorkerPool) >
+		max_parallel_apply_workers_per_subscription)
+		pa_stop_worker(winfo);
+}
+
+/*
+ * Stop all the workers, and wait for them to exit, when the leader exits.
+ *
+ * This must be done before the leader gives up the replication origin, as
+ * the workers might still commit with it.
+ */
+void
+pa_shutdown_workers(void)
+{
+	ListCell   *lc;
+
+	foreach(lc, ParallelApplyWorkerPool)
+	{
+		ParallelApplyWorkerInfo *winfo = (ParallelApplyWorkerInfo *) lfirst(lc);
+
+		shm_mq_detach(shm_mq_get_queue(winfo->mq_handle));
+		TerminateBackgroundWorker(winfo->handle);
+	}
+
+	foreach(lc, ParallelApplyWorkerPool)
+	{
+		ParallelApplyWorkerInfo *winfo = (ParallelApplyWorkerInfo *) lfirst(lc);
+
+		(void) WaitForBackgroundWorkerShutdown(winfo->handle);
+	}
+
+	ParallelApplyWorkerPool = NIL;
+}
+
+
+/*
+ * Start applying a block of our transaction.  The first one starts the
+ * local transaction block, and takes the transaction lock the leader waits
+ * on at the end of the transaction.
+ */
+void
+pa_apply_stream_start(TransactionId xid, bool first_segment)
+{
+	if (xid == pa_xid)
+		return;
+
+	if (TransactionIdIsValid(pa_xid))
+		elog(ERROR, "parallel apply worker received transaction %u while applying transaction %u",
+			 xid, pa_xid);
+
+	pa_xid = xid;
+	pa_nsubxacts = 0;
+
+	LockApplyTransactionForSession(MySubscription->oid, xid,
+								   PARALLEL_APPLY_LOCK_XACT,
+								   AccessExclusiveLock);
+
+	StartTransactionCommand();
+	BeginTransactionBlock();
+	CommitTransactionCommand();
+
+	SpinLockAcquire(&MyParallelShared->mutex);
+	MyParallelShared->xact_state = PARALLEL_TRANS_STARTED;
+	SpinLockRelease(&MyParallelShared->mutex);
+
+	pgstat_report_activity(STATE_RUNNING, NULL);
+}
+
+/*
+ * We've applied a block of our transaction.  Wait on the leader's stream
+ * lock until it sends the next one, rather than on the queue, see above.
+ */
+void
+pa_apply_stream_stop(void)
+{
+	Assert(TransactionIdIsValid(pa_xid));
+
+	pgstat_report_activity(STATE_IDLEINTRANSACTION, NULL);
+
+	LockApplyTransactionForSession(MySubscription->oid, pa_xid,
+								   PARALLEL_APPLY_LOCK_STREAM,
+								   AccessShareLock);
+	UnlockApplyTransactionForSession(MySubscription->oid, pa_xid,
+									 PARALLEL_APPLY_LOCK_STREAM,
+									 AccessShareLock);
+
+	pgstat_report_activity(STATE_RUNNING, NULL);
+}
+
+static void
+pa_savepoint_name(TransactionId xid, char *spname, Size szsp)
+{
+	snprintf(spname, szsp, "pg_sp_%u_%u", MySubscription->oid, xid);
+}
+
+/*
+ * Make sure that a change of the given remote (sub)transaction is applied
+ * in a savepoint of its own, if it's a subtransaction.
+ *
+ * The savepoints are simply nested in the order the subtransactions make
+ * their first change.  A subtransaction can only be aborted while it runs
+ * or with its parent, so all the subtransactions that made changes after
+ * it started are aborted with it, and the rollback to its savepoint undoes
+ * just the right changes.
+ */
+void
+pa_start_subtrans(TransactionId xid)
+{
+	char		spname[NAMEDATALEN];
+	int			i;
+
+	Assert(TransactionIdIsValid(pa_xid));
+
+	if (xid == pa_xid)
+		return;
+
+	for (i = pa_nsubxacts - 1; i >= 0; i--)
+	{
+		if (pa_subxacts[i] == xid)
+			return;
+	}
+
+	if (pa_nsubxacts >= pa_maxsubxacts)
+	{
+		pa_maxsubxacts = Max(16, pa_maxsubxacts * 2);
+		if (pa_subxacts == NULL)
+			pa_subxacts = (TransactionId *)
+				MemoryContextAlloc(TopMemoryContext,
+								   pa_maxsubxacts * sizeof(TransactionId));
+		else
+			pa_subxacts = (TransactionId *)
+				repalloc(pa_subxacts, pa_maxsubxacts * sizeof(TransactionId));
+	}
+
+	pa_savepoint_name(xid, spname, sizeof(spname));
+	elog(DEBUG1, "defining savepoint %s in logical replication parallel apply worker",
+		 spname);
+
+	DefineSavepoint(spname);
+	/* The subtransaction only starts with CommitTransactionCommand */
+	CommitTransactionCommand();
+
+	pa_subxacts[pa_nsubxacts++] = xid;
+}
+
+/*
+ * Apply the abort of our transaction, or one of its subtransactions.
+ */
+void
+pa_apply_stream_abort(TransactionId xid, TransactionId subxid)
+{
+	char		spname[NAMEDATALEN];
+	int			i;
+
+	if (xid != pa_xid)
+		elog(ERROR, "parallel apply worker received abort of transaction %u while applying transaction %u",
+			 xid, pa_xid);
+
+	if (subxid == xid)
+	{
+		AbortOutOfAnyTransaction();
+		pa_finish_xact(false);
+		return;
+	}
+
+	/* Nothing to do if the subtransaction made no changes */
+	for (i = 0; i < pa_nsubxacts; i++)
+	{
+		if (pa_subxacts[i] == subxid)
+			break;
+	}
+	if (i == pa_nsubxacts)
+		return;
+
+	pa_savepoint_name(subxid, spname, sizeof(spname));
+	elog(DEBUG1, "rolling back to savepoint %s in logical replication parallel apply worker",
+		 spname);
+
+	RollbackToSavepoint(list_make1(makeDefElem("savepoint_name",
+											   (Node *) makeString(spname))));
+	CommitTransactionCommand();
+
+	/* Forget the subtransactions rolled back with it */
+	pa_nsubxacts = i;
+}
+
+/*
+ * Commit our transaction, with the remote commit's position as progress of
+ * the replication origin.
+ */
+void
+pa_apply_stream_commit(LogicalRepCommitData *commit_data)
+{
+	Assert(TransactionIdIsValid(pa_xid));
+
+	replorigin_session_origin_lsn = commit_data->end_lsn;
+	replorigin_session_origin_timestamp = commit_data->committime;
+
+	EndTransactionBlock();
+	CommitTransactionCommand();
+
+	pa_finish_xact(true);
+}
+
+/*
+ * Tell the leader we're done with the transaction.
+ */
+static void
+pa_finish_xact(bool committed)
+{
+	SpinLockAcquire(&MyParallelShared->mutex);
+	MyParallelShared->last_commit_end =
+		committed ? XactLastCommitEnd : InvalidXLogRecPtr;
+	MyParallelShared->xact_state = PARALLEL_TRANS_FINISHED;
+	SpinLockRelease(&MyParallelShared->mutex);
+
+	UnlockApplyTransactionForSession(MySubscription->oid, pa_xid,
+									 PARALLEL_APPLY_LOCK_XACT,
+									 AccessExclusiveLock);
+
+	pa_xid = InvalidTransactionId;
+	pa_nsubxacts = 0;
+
+	/* Process any invalidation messages that might have accumulated. */
+	AcceptInvalidationMessages();
+
+	pgstat_report_activity(STATE_IDLE, NULL);
+}
+
+/* SIGHUP: set flag to reload configuration at next convenient time */
+static void
+pa_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+
+	/* Waken anything waiting on the process latch */
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Main entry point of a parallel apply worker.
+ */
+void
+ParallelApplyWorkerMain(Datum main_arg)
+{
+	dsm_segment *seg;
+	shm_toc    *toc;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	MemoryContext oldctx;
+
+	/* Setup signal handling */
+	pqsignal(SIGHUP, pa_sighup);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* Attach to the segment the leader set up for us */
+	Assert(CurrentResourceOwner == NULL);
+	CurrentResourceOwner = ResourceOwnerCreate(NULL,
+									 "logical replication parallel apply");
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	toc = shm_toc_attach(PARALLEL_APPLY_MAGIC, dsm_segment_address(seg));
+	if (toc == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("invalid magic number in dynamic shared memory segment")));
+
+	MyParallelShared = (ParallelApplyWorkerShared *)
+		shm_toc_lookup(toc, PARALLEL_APPLY_KEY_SHARED);
+	mq = (shm_mq *) shm_toc_lookup(toc, PARALLEL_APPLY_KEY_MQ);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	am_parallel_apply_worker = true;
+
+	/* Run as replica session replication role, like the leader. */
+	SetConfigOption("session_replication_role", "replica",
+					PGC_SUSET, PGC_S_OVERRIDE);
+
+	/* Connect to our database. */
+	BackgroundWorkerInitializeConnectionByOid(MyParallelShared->dbid,
+											  MyParallelShared->userid);
+
+	ApplyContext = AllocSetContextCreate(TopMemoryContext,
+										 "ApplyContext",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE);
+	ApplyMessageContext = AllocSetContextCreate(ApplyContext,
+												"ApplyMessageContext",
+												ALLOCSET_DEFAULT_MINSIZE,
+												ALLOCSET_DEFAULT_INITSIZE,
+												ALLOCSET_DEFAULT_MAXSIZE);
+
+	StartTransactionCommand();
+	oldctx = MemoryContextSwitchTo(ApplyContext);
+	MySubscription = GetSubscription(MyParallelShared->subid, true);
+	MemoryContextSwitchTo(oldctx);
+	CommitTransactionCommand();
+
+	/* The leader stops us before the subscription can go away */
+	if (!MySubscription)
+		proc_exit(0);
+
+	/* Commit with the leader's replication origin. */
+	replorigin_session_setup(MyParallelShared->originid,
+							 MyParallelShared->leader_pid);
+	replorigin_session_origin = MyParallelShared->originid;
+
+	elog(DEBUG1, "logical replication parallel apply worker for subscription \"%s\" has started",
+		 MySubscription->name);
+
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	for (;;)
+	{
+		shm_mq_result res;
+		Size		len;
+		void	   *data;
+
+		CHECK_FOR_INTERRUPTS();
+
+		MemoryContextSwitchTo(ApplyMessageContext);
+
+		res = shm_mq_receive(mqh, &len, &data, true);
+
+		if (res == SHM_MQ_SUCCESS)
+		{
+			StringInfoData s;
+
+			s.data = (char *) data;
+			s.len = len;
+			s.cursor = 0;
+			s.maxlen = -1;
+
+			apply_dispatch(&s);
+		}
+		else if (res == SHM_MQ_DETACHED)
+		{
+			/* The leader exited, or doesn't need us anymore */
+			if (TransactionIdIsValid(pa_xid))
+				ereport(ERROR,
+						(errcode(ERRCODE_CONNECTION_FAILURE),
+						 errmsg("lost connection to the logical replication apply worker")));
+			break;
+		}
+		else
+		{
+			int			rc;
+
+			Assert(res == SHM_MQ_WOULD_BLOCK);
+
+			rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, 0,
+						   WAIT_EVENT_LOGICAL_PARALLEL_APPLY_MAIN);
+			if (rc & WL_POSTMASTER_DEATH)
+				proc_exit(1);
+			ResetLatch(MyLatch);
+
+			if (got_SIGHUP)
+			{
+				got_SIGHUP = false;
+				ProcessConfigFile(PGC_SIGHUP);
+			}
+		}
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		MemoryContextReset(ApplyMessageContext);
+	}
+
+	proc_exit(0);
+}
@@ -96,6 +96,16 @@ LogicalDecodingProcessRecord(LogicalDecodingContext *ctx, XLogReaderState *recor
 	buf.endptr = ctx->reader->EndRecPtr;
 	buf.record = record;
 
+	/*
+	 * The first record of a subtransaction names its toplevel transaction;
+	 * tell the reorder buffer right away, rather than waiting for the commit
+	 * record, so that an in-progress transaction can be streamed as a whole.
+	 */
+	if (TransactionIdIsValid(XLogRecGetTopXid(record)) &&
+		SnapBuildCurrentState(ctx->snapshot_builder) >= SNAPBUILD_FULL_SNAPSHOT)
+		ReorderBufferAssignChild(ctx->reorder, XLogRecGetTopXid(record),
+								 XLogRecGetXid(record), buf.origptr);
+
 	/* cast so we get a warning when new rmgrs are added */
 	switch ((RmgrIds) XLogRecGetRmid(record))
 	{
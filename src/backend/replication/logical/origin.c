@@ -982,9 +982,14 @@ ReplicationOriginExitCleanup(int code, Datum arg)
  * Obviously only one such cached origin can exist per process and the current
  * cached value can only be set again after the previous value is torn down
  * with replorigin_session_reset().
+ *
+ * Normally the origin must not be in use by any other process.  A parallel
+ * apply worker instead passes the PID of its leader apply worker as
+ * acquired_by, and then shares the origin the leader has already acquired;
+ * ownership stays with the leader.
  */
 void
-replorigin_session_setup(RepOriginId node)
+replorigin_session_setup(RepOriginId node, int acquired_by)
 {
 	static bool registered_cleanup;
 	int			i;
@@ -1026,7 +1031,7 @@ replorigin_session_setup(RepOriginId node)
 		if (curstate->roident != node)
 			continue;
 
-		else if (curstate->acquired_by != 0)
+		else if (curstate->acquired_by != 0 && acquired_by == 0)
 		{
 			ereport(ERROR,
 					(errcode(ERRCODE_OBJECT_IN_USE),
@@ -1034,12 +1039,25 @@ replorigin_session_setup(RepOriginId node)
 					curstate->roident, curstate->acquired_by)));
 		}
 
+		else if (acquired_by != 0 && curstate->acquired_by != acquired_by)
+		{
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_IN_USE),
+			 errmsg("replication identifier %d is not active for PID %d",
+					curstate->roident, acquired_by)));
+		}
+
 		/* ok, found slot */
 		session_replication_state = curstate;
 	}
 
 
-	if (session_replication_state == NULL && free_slot == -1)
+	if (session_replication_state == NULL && acquired_by != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("replication identifier %d is not active for PID %d",
+						node, acquired_by)));
+	else if (session_replication_state == NULL && free_slot == -1)
 		ereport(ERROR,
 				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
 				 errmsg("could not find free replication state slot for replication origin with OID %u",
@@ -1057,7 +1075,8 @@ replorigin_session_setup(RepOriginId node)
 
 	Assert(session_replication_state->roident != InvalidRepOriginId);
 
-	session_replication_state->acquired_by = MyProcPid;
+	if (acquired_by == 0)
+		session_replication_state->acquired_by = MyProcPid;
 
 	LWLockRelease(ReplicationOriginLock);
 }
@@ -1080,7 +1099,9 @@ replorigin_session_reset(void)
 
 	LWLockAcquire(ReplicationOriginLock, LW_EXCLUSIVE);
 
-	session_replication_state->acquired_by = 0;
+	/* A parallel apply worker leaves the origin to its leader. */
+	if (session_replication_state->acquired_by == MyProcPid)
+		session_replication_state->acquired_by = 0;
 	session_replication_state = NULL;
 
 	LWLockRelease(ReplicationOriginLock);
@@ -1215,7 +1236,7 @@ pg_replication_origin_session_setup(PG_FUNCTION_ARGS)
 
 	name = text_to_cstring((text *) DatumGetPointer(PG_GETARG_DATUM(0)));
 	origin = replorigin_by_name(name, false);
-	replorigin_session_setup(origin);
+	replorigin_session_setup(origin, 0);
 
 	replorigin_session_origin = origin;
 
@@ -32,10 +32,19 @@
  *
  *	  In order to cope with large transactions - which can be several times as
  *	  big as the available memory - this module supports spooling the contents
- *	  of a large transactions to disk. When the transaction is replayed the
+ *	  of a large transactions to disk. That happens to the largest
+ *	  transactions whenever the changes of all transactions together take up
+ *	  more than logical_decoding_work_mem. When the transaction is replayed the
  *	  contents of individual (sub-)transactions will be read from disk in
  *	  chunks.
  *
+ *	  If the output plugin supports it, a large transaction can instead be
+ *	  passed to the plugin in blocks of changes while it is still in progress
+ *	  ("streamed"), leaving only the final block and the commit (or an abort)
+ *	  to be sent when the transaction ends. That avoids both the spooling and
+ *	  the latency of decoding the whole transaction at its commit. See
+ *	  ReorderBufferCanStream() for when this is possible.
+ *
  *	  This module also has to deal with reassembling toast records from the
  *	  individual chunks stored in WAL. When a new (or initial) version of a
  *	  tuple is stored in WAL it will always be preceded by the toast chunks
@@ -136,29 +145,27 @@ typedef struct ReorderBufferDiskChange
 } ReorderBufferDiskChange;
 
 /*
- * Maximum number of changes kept in memory, per transaction. After that,
- * changes are spooled to disk.
- *
- * The current value should be sufficient to decode the entire transaction
- * without hitting disk in OLTP workloads, while starting to spool to disk in
- * other workloads reasonably fast.
- *
- * At some point in the future it probably makes sense to have a more elaborate
- * resource management here, but it's not entirely clear what that would look
- * like.
+ * Memory the changes of all transactions together may use, in kilobytes.
+ * Once that is exceeded, the largest transaction is streamed to the output
+ * plugin if possible, or else spilled to disk.
+ */
+int			logical_decoding_work_mem = 65536;
+
+/*
+ * Maximum number of changes of a spilled transaction that are read back into
+ * memory at a time when it is replayed.
  */
 static const Size max_changes_in_memory = 4096;
 
 /*
- * We use a very simple form of a slab allocator for frequently allocated
- * objects, simply keeping a fixed number in a linked list when unused,
- * instead pfree()ing them. Without that in many workloads aset.c becomes a
- * major bottleneck, especially when spilling to disk while decoding batch
- * workloads.
+ * Changes and transactions, the most frequently allocated objects, come from
+ * slab contexts of their own.  Tuple buffers vary in size; they come from a
+ * generation context, as they are mostly freed in about the order they were
+ * allocated, a transaction at a time.  Either way, memory is returned once
+ * the transactions using it are gone, and allocation is cheap compared to
+ * aset.c, which otherwise becomes a major bottleneck, especially when
+ * spilling to disk while decoding batch workloads.
  */
-static const Size max_cached_changes = 4096 * 2;
-static const Size max_cached_tuplebufs = 4096 * 2;		/* ~8MB */
-static const Size max_cached_transactions = 512;
 
 
 /* ---------------------------------------
@@ -167,11 +174,19 @@ static const Size max_cached_transactions = 512;
  */
 static ReorderBufferTXN *ReorderBufferGetTXN(ReorderBuffer *rb);
 static void ReorderBufferReturnTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferFreeChanges(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static Size ReorderBufferChangeSize(ReorderBufferChange *change);
+static void ReorderBufferChangeMemoryUpdate(ReorderBuffer *rb,
+								ReorderBufferChange *change, bool addition);
 static ReorderBufferTXN *ReorderBufferTXNByXid(ReorderBuffer *rb,
 					  TransactionId xid, bool create, bool *is_new,
 					  XLogRecPtr lsn, bool create_as_top);
 
 static void AssertTXNLsnOrder(ReorderBuffer *rb);
+static void ReorderBufferTransferSnapToParent(ReorderBufferTXN *txn,
+								  ReorderBufferTXN *subtxn);
+static void ReorderBufferProcessTXN(ReorderBuffer *rb, ReorderBufferTXN *txn,
+						XLogRecPtr commit_lsn, bool streaming);
 
 /* ---------------------------------------
  * support functions for lsn-order iterating over the ->changes of a
@@ -193,7 +208,7 @@ static void ReorderBufferExecuteInvalidations(ReorderBuffer *rb, ReorderBufferTX
  * Disk serialization support functions
  * ---------------------------------------
  */
-static void ReorderBufferCheckSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferCheckMemoryLimit(ReorderBuffer *rb);
 static void ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
 static void ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 							 int fd, ReorderBufferChange *change);
@@ -203,6 +218,14 @@ static void ReorderBufferRestoreChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 						   char *change);
 static void ReorderBufferRestoreCleanup(ReorderBuffer *rb, ReorderBufferTXN *txn);
 
+/* ---------------------------------------
+ * Streaming support functions
+ * ---------------------------------------
+ */
+static bool ReorderBufferCanStream(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static bool ReorderBufferHasPendingSpecInsert(ReorderBufferTXN *txn);
+static void ReorderBufferStreamTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+
 static void ReorderBufferFreeSnap(ReorderBuffer *rb, Snapshot snap);
 static Snapshot ReorderBufferCopySnap(ReorderBuffer *rb, Snapshot orig_snap,
 					  ReorderBufferTXN *txn, CommandId cid);
@@ -243,6 +266,20 @@ ReorderBufferAllocate(void)
 
 	buffer->context = new_ctx;
 
+	buffer->change_context = SlabContextCreate(new_ctx,
+											   "Change",
+											   SLAB_DEFAULT_BLOCK_SIZE,
+											   sizeof(ReorderBufferChange));
+
+	buffer->txn_context = SlabContextCreate(new_ctx,
+											"TXN",
+											SLAB_DEFAULT_BLOCK_SIZE,
+											sizeof(ReorderBufferTXN));
+
+	buffer->tup_context = GenerationContextCreate(new_ctx,
+												  "Tuples",
+												  GENERATION_DEFAULT_BLOCK_SIZE);
+
 	hash_ctl.keysize = sizeof(TransactionId);
 	hash_ctl.entrysize = sizeof(ReorderBufferTXNByIdEnt);
 	hash_ctl.hcxt = buffer->context;
@@ -253,9 +290,7 @@ ReorderBufferAllocate(void)
 	buffer->by_txn_last_xid = InvalidTransactionId;
 	buffer->by_txn_last_txn = NULL;
 
-	buffer->nr_cached_transactions = 0;
-	buffer->nr_cached_changes = 0;
-	buffer->nr_cached_tuplebufs = 0;
+	buffer->size = 0;
 
 	buffer->outbuf = NULL;
 	buffer->outbufsize = 0;
@@ -263,9 +298,6 @@ ReorderBufferAllocate(void)
 	buffer->current_restart_decoding_lsn = InvalidXLogRecPtr;
 
 	dlist_init(&buffer->toplevel_by_lsn);
-	dlist_init(&buffer->cached_transactions);
-	dlist_init(&buffer->cached_changes);
-	slist_init(&buffer->cached_tuplebufs);
 
 	return buffer;
 }
@@ -286,26 +318,15 @@ ReorderBufferFree(ReorderBuffer *rb)
 }
 
 /*
- * Get an unused, possibly preallocated, ReorderBufferTXN.
+ * Get an unused ReorderBufferTXN.
  */
 static ReorderBufferTXN *
 ReorderBufferGetTXN(ReorderBuffer *rb)
 {
 	ReorderBufferTXN *txn;
 
-	/* check the slab cache */
-	if (rb->nr_cached_transactions > 0)
-	{
-		rb->nr_cached_transactions--;
-		txn = (ReorderBufferTXN *)
-			dlist_container(ReorderBufferTXN, node,
-							dlist_pop_head_node(&rb->cached_transactions));
-	}
-	else
-	{
-		txn = (ReorderBufferTXN *)
-			MemoryContextAlloc(rb->context, sizeof(ReorderBufferTXN));
-	}
+	txn = (ReorderBufferTXN *)
+		MemoryContextAlloc(rb->txn_context, sizeof(ReorderBufferTXN));
 
 	memset(txn, 0, sizeof(ReorderBufferTXN));
 
@@ -318,9 +339,6 @@ ReorderBufferGetTXN(ReorderBuffer *rb)
 
 /*
  * Free a ReorderBufferTXN.
- *
- * Deallocation might be delayed for efficiency purposes, for details check
- * the comments above max_cached_changes's definition.
  */
 static void
 ReorderBufferReturnTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
@@ -346,41 +364,19 @@ ReorderBufferReturnTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		txn->invalidations = NULL;
 	}
 
-	/* check whether to put into the slab cache */
-	if (rb->nr_cached_transactions < max_cached_transactions)
-	{
-		rb->nr_cached_transactions++;
-		dlist_push_head(&rb->cached_transactions, &txn->node);
-		VALGRIND_MAKE_MEM_UNDEFINED(txn, sizeof(ReorderBufferTXN));
-		VALGRIND_MAKE_MEM_DEFINED(&txn->node, sizeof(txn->node));
-	}
-	else
-	{
-		pfree(txn);
-	}
+	pfree(txn);
 }
 
 /*
- * Get an unused, possibly preallocated, ReorderBufferChange.
+ * Get an unused ReorderBufferChange.
  */
 ReorderBufferChange *
 ReorderBufferGetChange(ReorderBuffer *rb)
 {
 	ReorderBufferChange *change;
 
-	/* check the slab cache */
-	if (rb->nr_cached_changes)
-	{
-		rb->nr_cached_changes--;
-		change = (ReorderBufferChange *)
-			dlist_container(ReorderBufferChange, node,
-							dlist_pop_head_node(&rb->cached_changes));
-	}
-	else
-	{
-		change = (ReorderBufferChange *)
-			MemoryContextAlloc(rb->context, sizeof(ReorderBufferChange));
-	}
+	change = (ReorderBufferChange *)
+		MemoryContextAlloc(rb->change_context, sizeof(ReorderBufferChange));
 
 	memset(change, 0, sizeof(ReorderBufferChange));
 	return change;
@@ -388,13 +384,14 @@ ReorderBufferGetChange(ReorderBuffer *rb)
 
 /*
  * Free an ReorderBufferChange.
- *
- * Deallocation might be delayed for efficiency purposes, for details check
- * the comments above max_cached_changes's definition.
  */
 void
 ReorderBufferReturnChange(ReorderBuffer *rb, ReorderBufferChange *change)
 {
+	/* changes queued in a transaction are accounted for */
+	if (change->txn != NULL)
+		ReorderBufferChangeMemoryUpdate(rb, change, false);
+
 	/* free contained data */
 	switch (change->action)
 	{
@@ -428,24 +425,101 @@ ReorderBufferReturnChange(ReorderBuffer *rb, ReorderBufferChange *change)
 			break;
 	}
 
-	/* check whether to put into the slab cache */
-	if (rb->nr_cached_changes < max_cached_changes)
+	pfree(change);
+}
+
+
+/*
+ * Free all the in-memory changes of a transaction, after they have been
+ * streamed.
+ */
+static void
+ReorderBufferFreeChanges(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	dlist_mutable_iter iter;
+
+	Assert(txn->nentries == txn->nentries_mem);
+
+	dlist_foreach_modify(iter, &txn->changes)
 	{
-		rb->nr_cached_changes++;
-		dlist_push_head(&rb->cached_changes, &change->node);
-		VALGRIND_MAKE_MEM_UNDEFINED(change, sizeof(ReorderBufferChange));
-		VALGRIND_MAKE_MEM_DEFINED(&change->node, sizeof(change->node));
+		ReorderBufferChange *change;
+
+		change = dlist_container(ReorderBufferChange, node, iter.cur);
+
+		dlist_delete(&change->node);
+		ReorderBufferReturnChange(rb, change);
 	}
-	else
+
+	txn->nentries = 0;
+	txn->nentries_mem = 0;
+}
+
+/*
+ * Size of a change, as accounted for in the memory limit
+ */
+static Size
+ReorderBufferChangeSize(ReorderBufferChange *change)
+{
+	Size		sz = sizeof(ReorderBufferChange);
+
+	switch (change->action)
 	{
-		pfree(change);
+		case REORDER_BUFFER_CHANGE_INSERT:
+		case REORDER_BUFFER_CHANGE_UPDATE:
+		case REORDER_BUFFER_CHANGE_DELETE:
+		case REORDER_BUFFER_CHANGE_INTERNAL_SPEC_INSERT:
+			if (change->data.tp.newtuple)
+				sz += sizeof(ReorderBufferTupleBuf) +
+					change->data.tp.newtuple->alloc_tuple_size;
+			if (change->data.tp.oldtuple)
+				sz += sizeof(ReorderBufferTupleBuf) +
+					change->data.tp.oldtuple->alloc_tuple_size;
+			break;
+		case REORDER_BUFFER_CHANGE_INTERNAL_SNAPSHOT:
+			if (change->data.snapshot)
+				sz += sizeof(SnapshotData) +
+					sizeof(TransactionId) * (change->data.snapshot->xcnt +
+											 change->data.snapshot->subxcnt);
+			break;
+		case REORDER_BUFFER_CHANGE_INTERNAL_SPEC_CONFIRM:
+		case REORDER_BUFFER_CHANGE_INTERNAL_COMMAND_ID:
+		case REORDER_BUFFER_CHANGE_INTERNAL_TUPLECID:
+			break;
 	}
+
+	return sz;
 }
 
+/*
+ * Account for a change being added to (or removed from) the memory of the
+ * transaction it belongs to.
+ */
+static void
+ReorderBufferChangeMemoryUpdate(ReorderBuffer *rb,
+								ReorderBufferChange *change, bool addition)
+{
+	ReorderBufferTXN *txn = change->txn;
+	ReorderBufferTXN *toptxn = txn->toptxn ? txn->toptxn : txn;
+	Size		sz = ReorderBufferChangeSize(change);
+
+	if (addition)
+	{
+		txn->size += sz;
+		toptxn->total_size += sz;
+		rb->size += sz;
+	}
+	else
+	{
+		Assert(txn->size >= sz && toptxn->total_size >= sz && rb->size >= sz);
+		txn->size -= sz;
+		toptxn->total_size -= sz;
+		rb->size -= sz;
+	}
+}
 
 /*
- * Get an unused, possibly preallocated, ReorderBufferTupleBuf fitting at
- * least a tuple of size tuple_len (excluding header overhead).
+ * Get a ReorderBufferTupleBuf fitting at least a tuple of size tuple_len
+ * (excluding header overhead).
  */
 ReorderBufferTupleBuf *
 ReorderBufferGetTupleBuf(ReorderBuffer *rb, Size tuple_len)
@@ -455,70 +529,23 @@ ReorderBufferGetTupleBuf(ReorderBuffer *rb, Size tuple_len)
 
 	alloc_len = tuple_len + SizeofHeapTupleHeader;
 
-	/*
-	 * Most tuples are below MaxHeapTupleSize, so we use a slab allocator for
-	 * those. Thus always allocate at least MaxHeapTupleSize. Note that tuples
-	 * tuples generated for oldtuples can be bigger, as they don't have
-	 * out-of-line toast columns.
-	 */
-	if (alloc_len < MaxHeapTupleSize)
-		alloc_len = MaxHeapTupleSize;
-
-
-	/* if small enough, check the slab cache */
-	if (alloc_len <= MaxHeapTupleSize && rb->nr_cached_tuplebufs)
-	{
-		rb->nr_cached_tuplebufs--;
-		tuple = slist_container(ReorderBufferTupleBuf, node,
-								slist_pop_head_node(&rb->cached_tuplebufs));
-		Assert(tuple->alloc_tuple_size == MaxHeapTupleSize);
-#ifdef USE_ASSERT_CHECKING
-		memset(&tuple->tuple, 0xa9, sizeof(HeapTupleData));
-		VALGRIND_MAKE_MEM_UNDEFINED(&tuple->tuple, sizeof(HeapTupleData));
-#endif
-		tuple->tuple.t_data = ReorderBufferTupleBufData(tuple);
-#ifdef USE_ASSERT_CHECKING
-		memset(tuple->tuple.t_data, 0xa8, tuple->alloc_tuple_size);
-		VALGRIND_MAKE_MEM_UNDEFINED(tuple->tuple.t_data, tuple->alloc_tuple_size);
-#endif
-	}
-	else
-	{
-		tuple = (ReorderBufferTupleBuf *)
-			MemoryContextAlloc(rb->context,
-							   sizeof(ReorderBufferTupleBuf) +
-							   MAXIMUM_ALIGNOF + alloc_len);
-		tuple->alloc_tuple_size = alloc_len;
-		tuple->tuple.t_data = ReorderBufferTupleBufData(tuple);
-	}
+	tuple = (ReorderBufferTupleBuf *)
+		MemoryContextAlloc(rb->tup_context,
+						   sizeof(ReorderBufferTupleBuf) +
+						   MAXIMUM_ALIGNOF + alloc_len);
+	tuple->alloc_tuple_size = alloc_len;
+	tuple->tuple.t_data = ReorderBufferTupleBufData(tuple);
 
 	return tuple;
 }
 
 /*
  * Free an ReorderBufferTupleBuf.
- *
- * Deallocation might be delayed for efficiency purposes, for details check
- * the comments above max_cached_changes's definition.
  */
 void
 ReorderBufferReturnTupleBuf(ReorderBuffer *rb, ReorderBufferTupleBuf *tuple)
 {
-	/* check whether to put into the slab cache, oversized tuples never are */
-	if (tuple->alloc_tuple_size == MaxHeapTupleSize &&
-		rb->nr_cached_tuplebufs < max_cached_tuplebufs)
-	{
-		rb->nr_cached_tuplebufs++;
-		slist_push_head(&rb->cached_tuplebufs, &tuple->node);
-		VALGRIND_MAKE_MEM_UNDEFINED(tuple->tuple.t_data, tuple->alloc_tuple_size);
-		VALGRIND_MAKE_MEM_UNDEFINED(tuple, sizeof(ReorderBufferTupleBuf));
-		VALGRIND_MAKE_MEM_DEFINED(&tuple->node, sizeof(tuple->node));
-		VALGRIND_MAKE_MEM_DEFINED(&tuple->alloc_tuple_size, sizeof(tuple->alloc_tuple_size));
-	}
-	else
-	{
-		pfree(tuple);
-	}
+	pfree(tuple);
 }
 
 /*
@@ -619,12 +646,14 @@ ReorderBufferQueueChange(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn,
 	txn = ReorderBufferTXNByXid(rb, xid, true, NULL, lsn, true);
 
 	change->lsn = lsn;
+	change->txn = txn;
 	Assert(InvalidXLogRecPtr != lsn);
 	dlist_push_tail(&txn->changes, &change->node);
 	txn->nentries++;
 	txn->nentries_mem++;
 
-	ReorderBufferCheckSerializeTXN(rb, txn);
+	ReorderBufferChangeMemoryUpdate(rb, change, true);
+	ReorderBufferCheckMemoryLimit(rb);
 }
 
 static void
@@ -698,6 +727,7 @@ ReorderBufferAssignChild(ReorderBuffer *rb, TransactionId xid,
 		 */
 		dlist_push_tail(&txn->subtxns, &subtxn->node);
 		txn->nsubtxns++;
+		subtxn->toptxn = txn;
 	}
 	else if (!subtxn->is_known_as_subxact)
 	{
@@ -710,6 +740,9 @@ ReorderBufferAssignChild(ReorderBuffer *rb, TransactionId xid,
 		/* add to toplevel transaction */
 		dlist_push_tail(&txn->subtxns, &subtxn->node);
 		txn->nsubtxns++;
+		subtxn->toptxn = txn;
+		subtxn->total_size = 0;
+		txn->total_size += subtxn->size;
 	}
 	else if (new_top)
 	{
@@ -743,20 +776,7 @@ ReorderBufferCommitChild(ReorderBuffer *rb, TransactionId xid,
 	if (txn == NULL)
 		elog(ERROR, "subxact logged without previous toplevel record");
 
-	/*
-	 * Pass the our base snapshot to the parent transaction if it doesn't have
-	 * one, or ours is older. That can happen if there are no changes in the
-	 * toplevel transaction but in one of the child transactions. This allows
-	 * the parent to simply use it's base snapshot initially.
-	 */
-	if (txn->base_snapshot == NULL ||
-		txn->base_snapshot_lsn > subtxn->base_snapshot_lsn)
-	{
-		txn->base_snapshot = subtxn->base_snapshot;
-		txn->base_snapshot_lsn = subtxn->base_snapshot_lsn;
-		subtxn->base_snapshot = NULL;
-		subtxn->base_snapshot_lsn = InvalidXLogRecPtr;
-	}
+	ReorderBufferTransferSnapToParent(txn, subtxn);
 
 	subtxn->final_lsn = commit_lsn;
 	subtxn->end_lsn = end_lsn;
@@ -772,6 +792,36 @@ ReorderBufferCommitChild(ReorderBuffer *rb, TransactionId xid,
 		/* add to subtransaction list */
 		dlist_push_tail(&txn->subtxns, &subtxn->node);
 		txn->nsubtxns++;
+		subtxn->toptxn = txn;
+		subtxn->total_size = 0;
+		txn->total_size += subtxn->size;
+	}
+}
+
+/*
+ * Pass the base snapshot of a subtransaction to its toplevel transaction if
+ * that doesn't have one, or the subtransaction's is older. That can happen
+ * if there are no changes in the toplevel transaction but in one of the
+ * child transactions. This allows the parent to simply use its base
+ * snapshot initially.
+ */
+static void
+ReorderBufferTransferSnapToParent(ReorderBufferTXN *txn,
+								  ReorderBufferTXN *subtxn)
+{
+	if (subtxn->base_snapshot == NULL)
+		return;
+
+	if (txn->base_snapshot == NULL ||
+		txn->base_snapshot_lsn > subtxn->base_snapshot_lsn)
+	{
+		if (txn->base_snapshot != NULL)
+			SnapBuildSnapDecRefcount(txn->base_snapshot);
+
+		txn->base_snapshot = subtxn->base_snapshot;
+		txn->base_snapshot_lsn = subtxn->base_snapshot_lsn;
+		subtxn->base_snapshot = NULL;
+		subtxn->base_snapshot_lsn = InvalidXLogRecPtr;
 	}
 }
 
@@ -1096,6 +1146,15 @@ ReorderBufferCleanupTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		txn->base_snapshot_lsn = InvalidXLogRecPtr;
 	}
 
+	if (txn->snapshot_now != NULL)
+	{
+		ReorderBufferFreeSnap(rb, txn->snapshot_now);
+		txn->snapshot_now = NULL;
+	}
+
+	/* toast chunks a streamed transaction had not yet used up */
+	ReorderBufferToastReset(rb, txn);
+
 	/* delete from list of known subxacts */
 	if (txn->is_known_as_subxact)
 	{
@@ -1280,7 +1339,8 @@ ReorderBufferFreeSnap(ReorderBuffer *rb, Snapshot snap)
  * record is read because that's currently the only place where we know about
  * cache invalidations. Thus, once a toplevel commit is read, we iterate over
  * the top and subtransactions (using a k-way merge) and replay the changes in
- * lsn order.
+ * lsn order.  Transactions that have been streamed (see
+ * ReorderBufferStreamTXN) only have their remaining changes replayed here.
  */
 void
 ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
@@ -1289,10 +1349,6 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 					RepOriginId origin_id, XLogRecPtr origin_lsn)
 {
 	ReorderBufferTXN *txn;
-	volatile Snapshot snapshot_now;
-	volatile CommandId command_id = FirstCommandId;
-	bool		using_subtxn;
-	ReorderBufferIterTXNState *volatile iterstate = NULL;
 
 	txn = ReorderBufferTXNByXid(rb, xid, false, NULL, InvalidXLogRecPtr,
 								false);
@@ -1320,11 +1376,50 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 	if (txn->base_snapshot == NULL)
 	{
 		Assert(txn->ninvalidations == 0);
+		Assert(!txn->is_streamed);
 		ReorderBufferCleanupTXN(rb, txn);
 		return;
 	}
 
-	snapshot_now = txn->base_snapshot;
+	ReorderBufferProcessTXN(rb, txn, commit_lsn, false);
+}
+
+/*
+ * Pass the changes of a transaction and its subtransactions to the output
+ * plugin, in lsn order.
+ *
+ * If streaming is false, the transaction has committed at commit_lsn: the
+ * changes are followed by the commit callback, and the transaction is
+ * cleaned up afterwards.  If streaming is true, the transaction is still in
+ * progress: the changes queued so far are sent as one streamed block and
+ * then freed, and the snapshot state is kept in the transaction for the
+ * next block.
+ */
+static void
+ReorderBufferProcessTXN(ReorderBuffer *rb, ReorderBufferTXN *txn,
+						XLogRecPtr commit_lsn, bool streaming)
+{
+	volatile Snapshot snapshot_now;
+	volatile CommandId command_id = FirstCommandId;
+	bool		using_subtxn;
+	bool		use_stream = streaming || txn->is_streamed;
+	bool		stream_started = false;
+	ReorderBufferIterTXNState *volatile iterstate = NULL;
+
+	if (txn->snapshot_now != NULL)
+	{
+		/*
+		 * Continue where the previous streamed block left off, with a fresh
+		 * copy to account for subtransactions assigned since.
+		 */
+		command_id = txn->snapshot_now->curcid;
+		snapshot_now = ReorderBufferCopySnap(rb, txn->snapshot_now,
+											 txn, command_id);
+		ReorderBufferFreeSnap(rb, txn->snapshot_now);
+		txn->snapshot_now = NULL;
+	}
+	else
+		snapshot_now = txn->base_snapshot;
 
 	/* build data to be able to lookup the CommandIds of catalog tuples */
 	ReorderBufferBuildTupleCidHash(rb, txn);
@@ -1354,7 +1449,8 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		else
 			StartTransactionCommand();
 
-		rb->begin(rb, txn);
+		if (!use_stream)
+			rb->begin(rb, txn);
 
 		iterstate = ReorderBufferIterTXNInit(rb, txn);
 		while ((change = ReorderBufferIterTXNNext(rb, iterstate)) != NULL)
@@ -1421,7 +1517,20 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 					if (!IsToastRelation(relation))
 					{
 						ReorderBufferToastReplace(rb, txn, relation, change);
-						rb->apply_change(rb, txn, relation, change);
+
+						if (!use_stream)
+							rb->apply_change(rb, txn, relation, change);
+						else
+						{
+							/* open a block on the first change passed on */
+							if (!stream_started)
+							{
+								rb->stream_start(rb, txn);
+								stream_started = true;
+							}
+							rb->stream_change(rb, change->txn, relation,
+											  change);
+						}
 
 						/*
 						 * Only clear reassembled toast chunks if we're sure
@@ -1564,7 +1673,8 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		/*
 		 * There's a speculative insertion remaining, just clean in up, it
 		 * can't have been successful, otherwise we'd gotten a confirmation
-		 * record.
+		 * record.  (A streamed block is never cut off in the middle of a
+		 * speculative insertion, see ReorderBufferCheckMemoryLimit.)
 		 */
 		if (specinsert)
 		{
@@ -1576,14 +1686,28 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		ReorderBufferIterTXNFinish(rb, iterstate);
 		iterstate = NULL;
 
+		if (stream_started)
+			rb->stream_stop(rb, txn);
+
 		/* call commit callback */
-		rb->commit(rb, txn, commit_lsn);
+		if (!streaming)
+		{
+			if (use_stream)
+				rb->stream_commit(rb, txn, commit_lsn);
+			else
+				rb->commit(rb, txn, commit_lsn);
+		}
 
 		/* this is just a sanity check against bad output plugin behaviour */
 		if (GetCurrentTransactionIdIfAny() != InvalidTransactionId)
 			elog(ERROR, "output plugin used XID %u",
 				 GetCurrentTransactionId());
 
+		/* remember where to continue with the next streamed block */
+		if (streaming)
+			txn->snapshot_now = ReorderBufferCopySnap(rb, snapshot_now,
+													  txn, command_id);
+
 		/* cleanup */
 		TeardownHistoricSnapshot(false);
 
@@ -1604,8 +1728,30 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		if (snapshot_now->copied)
 			ReorderBufferFreeSnap(rb, snapshot_now);
 
-		/* remove potential on-disk data, and deallocate */
-		ReorderBufferCleanupTXN(rb, txn);
+		if (streaming)
+		{
+			dlist_iter	iter;
+
+			/*
+			 * The changes have been passed on, so free them; toast chunks not
+			 * yet used up stay in txn->toast_hash.
+			 */
+			ReorderBufferFreeChanges(rb, txn);
+			dlist_foreach(iter, &txn->subtxns)
+			{
+				ReorderBufferTXN *subtxn;
+
+				subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+				ReorderBufferFreeChanges(rb, subtxn);
+			}
+
+			txn->is_streamed = true;
+		}
+		else
+		{
+			/* remove potential on-disk data, and deallocate */
+			ReorderBufferCleanupTXN(rb, txn);
+		}
 	}
 	PG_CATCH();
 	{
@@ -1665,6 +1811,10 @@ ReorderBufferAbort(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn)
 	/* cosmetic... */
 	txn->final_lsn = lsn;
 
+	/* tell the output plugin to discard what it got of the transaction */
+	if ((txn->toptxn ? txn->toptxn : txn)->is_streamed)
+		rb->stream_abort(rb, txn, lsn);
+
 	/* remove potential on-disk data, and deallocate */
 	ReorderBufferCleanupTXN(rb, txn);
 }
@@ -1698,6 +1848,9 @@ ReorderBufferAbortOld(ReorderBuffer *rb, TransactionId oldestRunningXid)
 		{
 			elog(DEBUG1, "aborting old transaction %u", txn->xid);
 
+			if (txn->is_streamed)
+				rb->stream_abort(rb, txn, InvalidXLogRecPtr);
+
 			/* remove potential on-disk data, and deallocate this tx */
 			ReorderBufferCleanupTXN(rb, txn);
 		}
@@ -1763,6 +1916,10 @@ ReorderBufferForget(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn)
 	else
 		Assert(txn->ninvalidations == 0);
 
+	/* the output plugin has to discard what it got of the transaction */
+	if ((txn->toptxn ? txn->toptxn : txn)->is_streamed)
+		rb->stream_abort(rb, txn, lsn);
+
 	/* remove potential on-disk data, and deallocate */
 	ReorderBufferCleanupTXN(rb, txn);
 }
@@ -1965,6 +2122,132 @@ ReorderBufferXidHasBaseSnapshot(ReorderBuffer *rb, TransactionId xid)
 }
 
 
+/*
+ * ---------------------------------------
+ * Streaming support
+ * ---------------------------------------
+ */
+
+/*
+ * Can the changes of toplevel transaction txn be streamed to the output
+ * plugin before its commit?
+ *
+ * Apart from the plugin having to support it, this is only possible for
+ * transactions:
+ *
+ * - that the output plugin is certain to see the commit or abort of, i.e.
+ *   that begin after the snapshot builder became consistent and after the
+ *   point at which the consumer asked to start decoding. Their
+ *   subtransactions are then all known as such from their first record on,
+ *   see XLR_BLOCK_ID_TOPLEVEL_XID.
+ *
+ * - without catalog changes (so far), as the cache invalidations for those
+ *   only become known at commit.
+ *
+ * - that haven't been spilled to disk, as the streamed changes are simply
+ *   freed afterwards.
+ */
+static bool
+ReorderBufferCanStream(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	LogicalDecodingContext *ctx = rb->private_data;
+	dlist_iter	iter;
+
+	Assert(!txn->is_known_as_subxact);
+
+	if (rb->stream_start == NULL)
+		return false;
+
+	if (SnapBuildCurrentState(ctx->snapshot_builder) != SNAPBUILD_CONSISTENT ||
+		SnapBuildXactNeedsSkip(ctx->snapshot_builder, txn->first_lsn))
+		return false;
+
+	if (txn->has_catalog_changes || txn->nentries != txn->nentries_mem)
+		return false;
+
+	dlist_foreach(iter, &txn->subtxns)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+
+		if (subtxn->has_catalog_changes ||
+			subtxn->nentries != subtxn->nentries_mem)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Is the last change of txn, or of one of its subtransactions, a speculative
+ * insertion still waiting for its confirmation?
+ */
+static bool
+ReorderBufferHasPendingSpecInsert(ReorderBufferTXN *txn)
+{
+	dlist_iter	iter;
+
+	dlist_reverse_foreach(iter, &txn->changes)
+	{
+		ReorderBufferChange *change;
+
+		change = dlist_container(ReorderBufferChange, node, iter.cur);
+
+		/* these may have been queued for all running transactions since */
+		if (change->action == REORDER_BUFFER_CHANGE_INTERNAL_SNAPSHOT ||
+			change->action == REORDER_BUFFER_CHANGE_INTERNAL_COMMAND_ID)
+			continue;
+
+		if (change->action == REORDER_BUFFER_CHANGE_INTERNAL_SPEC_INSERT)
+			return true;
+		break;
+	}
+
+	dlist_foreach(iter, &txn->subtxns)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+
+		if (ReorderBufferHasPendingSpecInsert(subtxn))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Stream the changes queued so far for toplevel transaction txn and its
+ * subtransactions to the output plugin, as one block.
+ */
+static void
+ReorderBufferStreamTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	dlist_iter	iter;
+
+	/*
+	 * The changes may so far all be in subtransactions, whose base snapshot
+	 * ReorderBufferCommitChild would otherwise pass up at their commit.
+	 */
+	dlist_foreach(iter, &txn->subtxns)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+		ReorderBufferTransferSnapToParent(txn, subtxn);
+	}
+
+	/* no real changes in our database, nothing to stream */
+	if (txn->base_snapshot == NULL)
+		return;
+
+	elog(DEBUG2, "streaming " UINT64_FORMAT " changes of transaction %u",
+		 txn->nentries_mem, txn->xid);
+
+	ReorderBufferProcessTXN(rb, txn, InvalidXLogRecPtr, true);
+}
+
 /*
  * ---------------------------------------
  * Disk serialization support
@@ -1990,19 +2273,65 @@ ReorderBufferSerializeReserve(ReorderBuffer *rb, Size sz)
 }
 
 /*
- * Check whether the transaction tx should spill its data to disk.
+ * Check whether the changes of all transactions together exceed the memory
+ * limit, and if so, get rid of the changes of the largest transactions until
+ * they don't: by streaming them to the output plugin where that's possible,
+ * or else by spilling them to disk.
  */
 static void
-ReorderBufferCheckSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+ReorderBufferCheckMemoryLimit(ReorderBuffer *rb)
 {
-	/*
-	 * TODO: improve accounting so we cheaply can take subtransactions into
-	 * account here.
-	 */
-	if (txn->nentries_mem >= max_changes_in_memory)
+	while (rb->size >= logical_decoding_work_mem * 1024L)
 	{
-		ReorderBufferSerializeTXN(rb, txn);
-		Assert(txn->nentries_mem == 0);
+		Size		before = rb->size;
+		ReorderBufferTXN *largest = NULL;
+		HASH_SEQ_STATUS hash_seq;
+		ReorderBufferTXNByIdEnt *ent;
+
+		/* prefer streaming the largest toplevel transaction that allows it */
+		if (rb->stream_start != NULL)
+		{
+			dlist_iter	iter;
+
+			dlist_foreach(iter, &rb->toplevel_by_lsn)
+			{
+				ReorderBufferTXN *txn;
+
+				txn = dlist_container(ReorderBufferTXN, node, iter.cur);
+
+				if ((largest == NULL || txn->total_size > largest->total_size) &&
+					txn->total_size > 0 &&
+					ReorderBufferCanStream(rb, txn) &&
+					!ReorderBufferHasPendingSpecInsert(txn))
+					largest = txn;
+			}
+
+			if (largest != NULL)
+			{
+				ReorderBufferStreamTXN(rb, largest);
+				if (rb->size < before)
+					continue;
+			}
+		}
+
+		/* otherwise spill the largest (sub)transaction */
+		largest = NULL;
+		hash_seq_init(&hash_seq, rb->by_txn);
+		while ((ent = (ReorderBufferTXNByIdEnt *) hash_seq_search(&hash_seq)) != NULL)
+		{
+			if (largest == NULL || ent->txn->size > largest->size)
+				largest = ent->txn;
+		}
+
+		if (largest == NULL || largest->nentries_mem == 0)
+			break;
+
+		ReorderBufferSerializeTXN(rb, largest);
+		Assert(largest->nentries_mem == 0);
+
+		/* what's left can't be spilled, such as pending toast chunks */
+		if (rb->size >= before)
+			break;
 	}
 }
 
@@ -2365,6 +2694,7 @@ ReorderBufferRestoreChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	/* copy static part */
 	memcpy(change, &ondisk->change, sizeof(ReorderBufferChange));
+	change->txn = txn;
 
 	data += sizeof(ReorderBufferDiskChange);
 
@@ -2455,6 +2785,8 @@ ReorderBufferRestoreChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	dlist_push_tail(&txn->changes, &change->node);
 	txn->nentries_mem++;
+
+	ReorderBufferChangeMemoryUpdate(rb, change, true);
 }
 
 /*
@@ -2773,7 +3105,7 @@ ReorderBufferToastReplace(ReorderBuffer *rb, ReorderBufferTXN *txn,
 				   VARSIZE(chunk) - VARHDRSZ);
 			data_done += VARSIZE(chunk) - VARHDRSZ;
 		}
-		Assert(data_done == toast_pointer.va_extsize);
+		Assert(data_done == VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer));
 
 		/* make sure its marked as compressed or not */
 		if (VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
@@ -2797,9 +3129,24 @@ ReorderBufferToastReplace(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	 * the tuplebuf because attrs[] will point back into the current content.
 	 */
 	tmphtup = heap_form_tuple(desc, attrs, isnull);
-	Assert(newtup->tuple.t_len <= MaxHeapTupleSize);
 	Assert(ReorderBufferTupleBufData(newtup) == newtup->tuple.t_data);
 
+	/* tuple buffers are allocated to fit, so we may need a larger one */
+	if (tmphtup->t_len > newtup->alloc_tuple_size)
+	{
+		ReorderBufferTupleBuf *largertup;
+
+		largertup = ReorderBufferGetTupleBuf(rb,
+									 tmphtup->t_len - SizeofHeapTupleHeader);
+		largertup->tuple.t_self = newtup->tuple.t_self;
+		largertup->tuple.t_tableOid = newtup->tuple.t_tableOid;
+
+		ReorderBufferChangeMemoryUpdate(rb, change, false);
+		ReorderBufferReturnTupleBuf(rb, newtup);
+		change->data.tp.newtuple = newtup = largertup;
+		ReorderBufferChangeMemoryUpdate(rb, change, true);
+	}
+
 	memcpy(newtup->tuple.t_data, tmphtup->t_data, tmphtup->t_len);
 	newtup->tuple.t_len = tmphtup->t_len;
 
@@ -0,0 +1,2280 @@
+/*-------------------------------------------------------------------------
+ * worker.c
+ *	   PostgreSQL logical replication worker (apply)
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/logical/worker.c
+ *
+ * NOTES
+ *	  This file contains the worker which applies logical changes as they
+ *	  come from the remote logical replication stream.
+ *
+ *	  The main worker (apply) is started by the logical replication worker
+ *	  launcher for every enabled subscription in a database.  It uses the
+ *	  walsender protocol to communicate with the publisher, which sends the
+ *	  changes decoded by the pgoutput plugin.
+ *
+ *	  A transaction normally arrives in one piece, at commit time, and is
+ *	  applied in one local transaction.  When the subscription streams
+ *	  in-progress transactions, a large transaction instead arrives in
+ *	  blocks framed by STREAM START and STREAM STOP, interleaved with other
+ *	  transactions, and is finished by STREAM COMMIT or STREAM ABORT.  Such
+ *	  a transaction is handed to a parallel apply worker when one is free,
+ *	  which applies the changes as they arrive, see applyparallel.c.
+ *	  Otherwise the changes are spooled to a temporary file and applied by
+ *	  this worker at STREAM COMMIT.
+ *
+ *	  The local commits are tracked with the replication origin of the
+ *	  subscription, which is where streaming restarts after a crash, and the
+ *	  publisher is told which remote commits have been flushed locally, so
+ *	  that it can advance its replication slot.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/relscan.h"
+#include "access/stratnum.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "catalog/pg_index.h"
+#include "catalog/pg_subscription.h"
+#include "executor/executor.h"
+#include "lib/ilist.h"
+#include "libpq/pqformat.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "optimizer/planner.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "replication/logicalproto.h"
+#include "replication/logicalrelation.h"
+#include "replication/origin.h"
+#include "replication/walreceiver.h"
+#include "replication/worker_internal.h"
+#include "rewrite/rewriteHandler.h"
+#include "storage/buffile.h"
+#include "storage/bufmgr.h"
+#include "storage/ipc.h"
+#include "storage/lmgr.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/guc.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/tqual.h"
+
+
+#define NAPTIME_PER_CYCLE 1000	/* max sleep time between cycles (1s) */
+
+typedef struct FlushPosition
+{
+	dlist_node	node;
+	XLogRecPtr	local_end;
+	XLogRecPtr	remote_end;
+} FlushPosition;
+
+static dlist_head lsn_mapping = DLIST_STATIC_INIT(lsn_mapping);
+
+/*
+ * What the error context callback reports about the message being
+ * applied.
+ */
+typedef struct ApplyErrorCallbackArg
+{
+	char		command;		/* LOGICAL_REP_MSG_* of the message */
+	TransactionId remote_xid;	/* remote transaction, if known */
+	LogicalRepRelMapEntry *rel; /* target relation, if known */
+	int			local_attnum;	/* column being converted, or -1 */
+} ApplyErrorCallbackArg;
+
+static ApplyErrorCallbackArg apply_error_callback_arg =
+{
+	0, InvalidTransactionId, NULL, -1
+};
+
+/*
+ * A streamed transaction that isn't applied by a parallel apply worker is
+ * spooled to a temporary file.  A subtransaction that aborts is cut off the
+ * end of the file again, which is why we remember where the first change
+ * of each subtransaction was written.
+ */
+typedef struct SubXactPosition
+{
+	TransactionId xid;
+	int			fileno;
+	off_t		offset;
+} SubXactPosition;
+
+typedef struct StreamXidFile
+{
+	TransactionId xid;			/* hash key, must be first */
+	BufFile    *file;
+	int			end_fileno;		/* end of the changes spooled so far */
+	off_t		end_offset;
+	List	   *subxacts;		/* SubXactPosition, in order of first change */
+	TransactionId last_subxid;	/* (sub)transaction of the last change */
+} StreamXidFile;
+
+static HTAB *StreamXidHash = NULL;
+
+MemoryContext ApplyContext = NULL;
+
+/* Per-message memory context, reset after every message */
+MemoryContext ApplyMessageContext = NULL;
+
+Subscription *MySubscription = NULL;
+static bool MySubscriptionValid = false;
+
+bool		in_remote_transaction = false;
+static XLogRecPtr remote_final_lsn = InvalidXLogRecPtr;
+
+/* Are we inside a block of a streamed transaction, and where does it go? */
+static bool in_streamed_transaction = false;
+static TransactionId stream_xid = InvalidTransactionId;
+static bool stream_parallel = false;
+static StreamXidFile *stream_spool = NULL;
+
+/* Are we applying the spooled changes of a streamed transaction? */
+static bool applying_spooled_changes = false;
+
+static volatile sig_atomic_t got_SIGHUP = false;
+
+static void send_feedback(XLogRecPtr recvpos, bool force, bool requestReply);
+static void store_flush_position(XLogRecPtr remote_lsn, XLogRecPtr local_lsn);
+static void maybe_reread_subscription(void);
+static void apply_error_callback(void *arg);
+static void apply_worker_onexit(int code, Datum arg);
+
+static StreamXidFile *stream_spool_lookup(TransactionId xid, bool create);
+static void stream_write_change(StreamXidFile *spool, TransactionId subxid,
+					StringInfo s);
+static void stream_abort_spool(TransactionId xid, TransactionId subxid);
+static void stream_close_spool(StreamXidFile *spool);
+static void apply_spooled_messages(TransactionId xid,
+					   LogicalRepCommitData *commit_data);
+
+
+/*
+ * Make sure that we started local transaction.
+ *
+ * Also switches to ApplyMessageContext as necessary.
+ */
+static bool
+ensure_transaction(void)
+{
+	if (IsTransactionState())
+	{
+		if (CurrentMemoryContext != ApplyMessageContext)
+			MemoryContextSwitchTo(ApplyMessageContext);
+		return false;
+	}
+
+	StartTransactionCommand();
+
+	MemoryContextSwitchTo(ApplyMessageContext);
+	return true;
+}
+
+/*
+ * Handle a change of a streamed transaction.
+ *
+ * In a block of a streamed transaction, the leader passes the message on
+ * to the parallel apply worker or the spool file of the transaction, and
+ * we return true to tell the caller that there's nothing more to do.
+ *
+ * When the changes of a streamed transaction are applied, by a parallel
+ * apply worker or from the spool file, we only skip the xid the changes
+ * carry, and return false.  A parallel apply worker also makes sure that
+ * the change is applied in a subtransaction of its own if it was made in
+ * a remote subtransaction, see pa_start_subtrans.
+ */
+static bool
+handle_streamed_transaction(char action, StringInfo s)
+{
+	TransactionId xid;
+
+	if (!am_parallel_apply_worker && !applying_spooled_changes &&
+		!in_streamed_transaction)
+		return false;
+
+	/* The xid of the (sub)transaction that made the change */
+	xid = pq_getmsgint(s, 4);
+	if (!TransactionIdIsValid(xid))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid transaction ID in streamed replication transaction")));
+
+	if (am_parallel_apply_worker)
+	{
+		if (action != LOGICAL_REP_MSG_RELATION)
+			pa_start_subtrans(xid);
+		return false;
+	}
+	else if (applying_spooled_changes)
+		return false;
+
+	if (stream_parallel)
+		pa_send_data(stream_xid, s);
+	else
+		stream_write_change(stream_spool, xid, s);
+
+	return true;
+}
+
+/*
+ * Executor state preparation for evaluation of constraint expressions,
+ * indexes and triggers.
+ *
+ * This is based on similar code in copy.c
+ */
+static EState *
+create_estate_for_relation(LogicalRepRelMapEntry *rel)
+{
+	EState	   *estate;
+	ResultRelInfo *resultRelInfo;
+	RangeTblEntry *rte;
+
+	estate = CreateExecutorState();
+
+	rte = makeNode(RangeTblEntry);
+	rte->rtekind = RTE_RELATION;
+	rte->relid = RelationGetRelid(rel->localrel);
+	rte->relkind = rel->localrel->rd_rel->relkind;
+	estate->es_range_table = list_make1(rte);
+
+	resultRelInfo = makeNode(ResultRelInfo);
+	InitResultRelInfo(resultRelInfo, rel->localrel, 1, 0);
+
+	estate->es_result_relations = resultRelInfo;
+	estate->es_num_result_relations = 1;
+	estate->es_result_relation_info = resultRelInfo;
+	estate->es_output_cid = GetCurrentCommandId(true);
+
+	return estate;
+}
+
+/*
+ * Executes default values for columns for which we can't map to remote
+ * relation columns.
+ *
+ * This allows us to support tables which have more columns on the
+ * downstream than on the upstream.
+ */
+static void
+slot_fill_defaults(LogicalRepRelMapEntry *rel, EState *estate,
+				   TupleTableSlot *slot)
+{
+	TupleDesc	desc = RelationGetDescr(rel->localrel);
+	int			num_phys_attrs = desc->natts;
+	int			i;
+	int			attnum,
+				num_defaults = 0;
+	int		   *defmap;
+	ExprState **defexprs;
+	ExprContext *econtext;
+
+	econtext = GetPerTupleExprContext(estate);
+
+	/* We got all the data via replication, no need to evaluate anything. */
+	if (num_phys_attrs == rel->remoterel.natts)
+		return;
+
+	defmap = (int *) palloc(num_phys_attrs * sizeof(int));
+	defexprs = (ExprState **) palloc(num_phys_attrs * sizeof(ExprState *));
+
+	for (attnum = 0; attnum < num_phys_attrs; attnum++)
+	{
+		Expr	   *defexpr;
+
+		if (desc->attrs[attnum]->attisdropped)
+			continue;
+
+		if (rel->attrmap[attnum] >= 0)
+			continue;
+
+		defexpr = (Expr *) build_column_default(rel->localrel, attnum + 1);
+
+		if (defexpr != NULL)
+		{
+			/* Run the expression through planner */
+			defexpr = expression_planner(defexpr);
+
+			/* Initialize executable expression in copycontext */
+			defexprs[num_defaults] = ExecInitExpr(defexpr, NULL);
+			defmap[num_defaults] = attnum;
+			num_defaults++;
+		}
+
+	}
+
+	for (i = 0; i < num_defaults; i++)
+		slot->tts_values[defmap[i]] =
+			ExecEvalExpr(defexprs[i], econtext, &slot->tts_isnull[defmap[i]],
+						 NULL);
+}
+
+/*
+ * Convert the remote value of one column to a local datum.
+ */
+static Datum
+slot_store_column(Form_pg_attribute att, LogicalRepRelMapEntry *rel,
+				  int remoteattnum, LogicalRepTupleData *tupleData)
+{
+	StringInfo	colvalue = &tupleData->colvalues[remoteattnum];
+	Datum		value;
+
+	if (tupleData->colstatus[remoteattnum] == LOGICALREP_COLUMN_TEXT)
+	{
+		Oid			typinput;
+		Oid			typioparam;
+
+		getTypeInputInfo(att->atttypid, &typinput, &typioparam);
+		value = OidInputFunctionCall(typinput, colvalue->data,
+									 typioparam, att->atttypmod);
+	}
+	else
+	{
+		Oid			typreceive;
+		Oid			typioparam;
+
+		Assert(tupleData->colstatus[remoteattnum] == LOGICALREP_COLUMN_BINARY);
+
+		/*
+		 * The publisher only uses the binary format for built-in types, whose
+		 * OIDs are the same on both sides, but the binary representations of
+		 * different types are not interchangeable.
+		 */
+		if (rel->remoterel.atttyps[remoteattnum] != att->atttypid)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATATYPE_MISMATCH),
+					 errmsg("binary data of type %s cannot be stored in a column of type %s",
+							format_type_be(rel->remoterel.atttyps[remoteattnum]),
+							format_type_be(att->atttypid))));
+
+		getTypeBinaryInputInfo(att->atttypid, &typreceive, &typioparam);
+		value = OidReceiveFunctionCall(typreceive, colvalue,
+									   typioparam, att->atttypmod);
+
+		/* Trouble if it didn't eat the whole buffer */
+		if (colvalue->cursor != colvalue->len)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("incorrect binary data format in logical replication column %d",
+							remoteattnum + 1)));
+	}
+
+	return value;
+}
+
+/*
+ * Store data in C string form into slot.
+ *
+ * Columns the remote side doesn't have, or didn't send, are set to NULL;
+ * slot_fill_defaults and slot_modify_data take care of them.
+ */
+static void
+slot_store_data(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
+				LogicalRepTupleData *tupleData)
+{
+	int			natts = slot->tts_tupleDescriptor->natts;
+	int			i;
+
+	ExecClearTuple(slot);
+
+	/* Call the "in" function for each non-dropped attribute */
+	for (i = 0; i < natts; i++)
+	{
+		Form_pg_attribute att = slot->tts_tupleDescriptor->attrs[i];
+		int			remoteattnum = rel->attrmap[i];
+
+		if (!att->attisdropped && remoteattnum >= 0 &&
+			remoteattnum < tupleData->ncols &&
+			(tupleData->colstatus[remoteattnum] == LOGICALREP_COLUMN_TEXT ||
+			 tupleData->colstatus[remoteattnum] == LOGICALREP_COLUMN_BINARY))
+		{
+			apply_error_callback_arg.local_attnum = i;
+			slot->tts_values[i] = slot_store_column(att, rel, remoteattnum,
+													tupleData);
+			slot->tts_isnull[i] = false;
+			apply_error_callback_arg.local_attnum = -1;
+		}
+		else
+		{
+			/*
+			 * We assign NULL to dropped attributes, NULL values, and missing
+			 * values (missing values should be later filled using
+			 * slot_fill_defaults).
+			 */
+			slot->tts_values[i] = (Datum) 0;
+			slot->tts_isnull[i] = true;
+		}
+	}
+
+	ExecStoreVirtualTuple(slot);
+}
+
+/*
+ * Replace updated columns with data from the LogicalRepTupleData struct.
+ *
+ * The slot starts out as a copy of the existing local tuple; columns the
+ * remote side reports as unchanged keep their local value.
+ */
+static void
+slot_modify_data(TupleTableSlot *slot, TupleTableSlot *srcslot,
+				 LogicalRepRelMapEntry *rel,
+				 LogicalRepTupleData *tupleData)
+{
+	int			natts = slot->tts_tupleDescriptor->natts;
+	int			i;
+
+	slot_getallattrs(srcslot);
+
+	ExecClearTuple(slot);
+	memcpy(slot->tts_values, srcslot->tts_values, natts * sizeof(Datum));
+	memcpy(slot->tts_isnull, srcslot->tts_isnull, natts * sizeof(bool));
+
+	for (i = 0; i < natts; i++)
+	{
+		Form_pg_attribute att = slot->tts_tupleDescriptor->attrs[i];
+		int			remoteattnum = rel->attrmap[i];
+		char		status;
+
+		if (remoteattnum < 0 || remoteattnum >= tupleData->ncols)
+			continue;
+
+		status = tupleData->colstatus[remoteattnum];
+		if (status == LOGICALREP_COLUMN_UNCHANGED)
+			continue;
+
+		if (status == LOGICALREP_COLUMN_NULL)
+		{
+			slot->tts_values[i] = (Datum) 0;
+			slot->tts_isnull[i] = true;
+		}
+		else
+		{
+			apply_error_callback_arg.local_attnum = i;
+			slot->tts_values[i] = slot_store_column(att, rel, remoteattnum,
+													tupleData);
+			slot->tts_isnull[i] = false;
+			apply_error_callback_arg.local_attnum = -1;
+		}
+	}
+
+	ExecStoreVirtualTuple(slot);
+}
+
+/*
+ * Handle BEGIN message.
+ */
+static void
+apply_handle_begin(StringInfo s)
+{
+	LogicalRepBeginData begin_data;
+
+	logicalrep_read_begin(s, &begin_data);
+
+	remote_final_lsn = begin_data.final_lsn;
+	apply_error_callback_arg.remote_xid = begin_data.xid;
+
+	in_remote_transaction = true;
+
+	pgstat_report_activity(STATE_RUNNING, NULL);
+}
+
+/*
+ * Handle COMMIT message.
+ *
+ * TODO, support tracking of multiple origins
+ */
+static void
+apply_handle_commit(StringInfo s)
+{
+	LogicalRepCommitData commit_data;
+
+	logicalrep_read_commit(s, &commit_data);
+
+	if (commit_data.commit_lsn != remote_final_lsn)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("incorrect commit LSN %X/%X in commit message (expected %X/%X)",
+						(uint32) (commit_data.commit_lsn >> 32),
+						(uint32) commit_data.commit_lsn,
+						(uint32) (remote_final_lsn >> 32),
+						(uint32) remote_final_lsn)));
+
+	/* A transaction without changes for us didn't start a local one. */
+	if (IsTransactionState())
+	{
+		/*
+		 * Update origin state so we can restart streaming from correct
+		 * position in case of crash.
+		 */
+		replorigin_session_origin_lsn = commit_data.end_lsn;
+		replorigin_session_origin_timestamp = commit_data.committime;
+
+		CommitTransactionCommand();
+
+		store_flush_position(commit_data.end_lsn, XactLastCommitEnd);
+	}
+	else
+	{
+		/* Process any invalidation messages that might have accumulated. */
+		AcceptInvalidationMessages();
+	}
+
+	in_remote_transaction = false;
+	apply_error_callback_arg.remote_xid = InvalidTransactionId;
+
+	pgstat_report_activity(STATE_IDLE, NULL);
+}
+
+/*
+ * Handle STREAM START message.
+ *
+ * The leader hands the first block of a transaction to a free parallel
+ * apply worker if there is one, or starts spooling it, and keeps sending
+ * the later blocks the same way.
+ */
+static void
+apply_handle_stream_start(StringInfo s)
+{
+	TransactionId xid;
+	bool		first_segment;
+
+	if (in_streamed_transaction)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("duplicate STREAM START message")));
+
+	xid = logicalrep_read_stream_start(s, &first_segment);
+	if (!TransactionIdIsValid(xid))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid transaction ID in streamed replication transaction")));
+
+	apply_error_callback_arg.remote_xid = xid;
+
+	if (am_parallel_apply_worker)
+	{
+		pa_apply_stream_start(xid, first_segment);
+		return;
+	}
+
+	in_streamed_transaction = true;
+	stream_xid = xid;
+
+	/*
+	 * A transaction whose earlier blocks were spooled stays spooled.  The
+	 * publisher might also restart streaming a transaction halfway, after
+	 * we reconnect, in which case we don't know the transaction and treat
+	 * the block as the first one.
+	 */
+	stream_spool = stream_spool_lookup(xid, false);
+	stream_parallel = false;
+	if (stream_spool == NULL)
+		stream_parallel = pa_send_stream_start(xid, first_segment, s);
+	if (!stream_parallel && stream_spool == NULL)
+		stream_spool = stream_spool_lookup(xid, true);
+
+	pgstat_report_activity(STATE_RUNNING, NULL);
+}
+
+/*
+ * Handle STREAM STOP message.
+ */
+static void
+apply_handle_stream_stop(StringInfo s)
+{
+	if (am_parallel_apply_worker)
+	{
+		pa_apply_stream_stop();
+		apply_error_callback_arg.remote_xid = InvalidTransactionId;
+		return;
+	}
+
+	if (!in_streamed_transaction)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("STREAM STOP message without STREAM START")));
+
+	if (stream_parallel)
+		pa_send_stream_stop(stream_xid, s);
+
+	in_streamed_transaction = false;
+	stream_xid = InvalidTransactionId;
+	stream_parallel = false;
+	stream_spool = NULL;
+	apply_error_callback_arg.remote_xid = InvalidTransactionId;
+
+	pgstat_report_activity(STATE_IDLE, NULL);
+}
+
+/*
+ * Handle STREAM ABORT message, for a subtransaction or the whole
+ * transaction.
+ */
+static void
+apply_handle_stream_abort(StringInfo s)
+{
+	TransactionId xid;
+	TransactionId subxid;
+
+	if (in_streamed_transaction)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("STREAM ABORT message without STREAM STOP")));
+
+	logicalrep_read_stream_abort(s, &xid, &subxid);
+
+	if (am_parallel_apply_worker)
+	{
+		pa_apply_stream_abort(xid, subxid);
+		return;
+	}
+
+	if (!pa_send_stream_abort(xid, subxid, s))
+		stream_abort_spool(xid, subxid);
+}
+
+/*
+ * Handle STREAM COMMIT message.
+ *
+ * Commits are applied in the order the publisher sends them, so we wait
+ * for a parallel apply worker to commit before going on.
+ */
+static void
+apply_handle_stream_commit(StringInfo s)
+{
+	TransactionId xid;
+	LogicalRepCommitData commit_data;
+	XLogRecPtr	local_end;
+
+	if (in_streamed_transaction)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("STREAM COMMIT message without STREAM STOP")));
+
+	xid = logicalrep_read_stream_commit(s, &commit_data);
+	apply_error_callback_arg.remote_xid = xid;
+
+	if (am_parallel_apply_worker)
+	{
+		pa_apply_stream_commit(&commit_data);
+		apply_error_callback_arg.remote_xid = InvalidTransactionId;
+		return;
+	}
+
+	if (pa_send_stream_commit(xid, s, &local_end))
+		store_flush_position(commit_data.end_lsn, local_end);
+	else
+		apply_spooled_messages(xid, &commit_data);
+
+	/* Process any invalidation messages that might have accumulated. */
+	AcceptInvalidationMessages();
+
+	apply_error_callback_arg.remote_xid = InvalidTransactionId;
+
+	pgstat_report_activity(STATE_IDLE, NULL);
+}
+
+/*
+ * Handle RELATION message.
+ *
+ * Note we don't do validation against local schema here. The validation
+ * against local schema is postponed until first change for given relation
+ * comes as we only care about it when applying changes for it anyway and we
+ * do less locking this way.
+ */
+static void
+apply_handle_relation(StringInfo s)
+{
+	LogicalRepRelation *rel;
+
+	if (handle_streamed_transaction(LOGICAL_REP_MSG_RELATION, s))
+		return;
+
+	rel = logicalrep_read_rel(s);
+	logicalrep_relmap_update(rel);
+}
+
+/*
+ * Handle INSERT message.
+ */
+static void
+apply_handle_insert(StringInfo s)
+{
+	LogicalRepRelMapEntry *rel;
+	LogicalRepTupleData newtup;
+	LogicalRepRelId relid;
+	EState	   *estate;
+	ResultRelInfo *resultRelInfo;
+	TupleTableSlot *remoteslot;
+	HeapTuple	tuple;
+	MemoryContext oldctx;
+
+	if (handle_streamed_transaction(LOGICAL_REP_MSG_INSERT, s))
+		return;
+
+	ensure_transaction();
+
+	relid = logicalrep_read_insert(s, &newtup);
+	rel = logicalrep_rel_open(relid, RowExclusiveLock);
+	apply_error_callback_arg.rel = rel;
+
+	/* Initialize the executor state. */
+	estate = create_estate_for_relation(rel);
+	resultRelInfo = estate->es_result_relation_info;
+	remoteslot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(remoteslot, RelationGetDescr(rel->localrel));
+
+	/* Input functions may need an active snapshot, so get one */
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	/* Process and store remote tuple in the slot */
+	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	slot_store_data(remoteslot, rel, &newtup);
+	slot_fill_defaults(rel, estate, remoteslot);
+	MemoryContextSwitchTo(oldctx);
+
+	ExecOpenIndices(resultRelInfo, false);
+
+	/* Do the insert. */
+	tuple = ExecMaterializeSlot(remoteslot);
+	if (rel->localrel->rd_att->constr)
+		ExecConstraints(resultRelInfo, remoteslot, estate);
+	simple_heap_insert(rel->localrel, tuple);
+	if (resultRelInfo->ri_NumIndices > 0)
+		list_free(ExecInsertIndexTuples(remoteslot, &(tuple->t_self),
+										estate, false, NULL, NIL));
+
+	/* Cleanup. */
+	ExecCloseIndices(resultRelInfo);
+	PopActiveSnapshot();
+	ExecResetTupleTable(estate->es_tupleTable, false);
+	FreeExecutorState(estate);
+
+	apply_error_callback_arg.rel = NULL;
+	logicalrep_rel_close(rel, NoLock);
+
+	CommandCounterIncrement();
+}
+
+/*
+ * Check if the logical replication relation is updatable and throw
+ * appropriate error if it isn't.
+ */
+static void
+check_relation_updatable(LogicalRepRelMapEntry *rel)
+{
+	/* Updatable, no error. */
+	if (rel->updatable)
+		return;
+
+	/*
+	 * We are in error mode so it's fine this is somewhat slow. It's better to
+	 * give user correct error.
+	 */
+	if (OidIsValid(RelationGetReplicaIndex(rel->localrel)))
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("publisher did not send replica identity column "
+						"expected by the logical replication target relation \"%s.%s\"",
+						rel->remoterel.nspname, rel->remoterel.relname)));
+	}
+
+	ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			 errmsg("logical replication target relation \"%s.%s\" has "
+					"neither REPLICA IDENTITY index nor PRIMARY "
+					"KEY and published relation does not have "
+					"REPLICA IDENTITY FULL",
+					rel->remoterel.nspname, rel->remoterel.relname)));
+}
+
+/*
+ * Setup a ScanKey for a search in the relation 'rel' for a tuple 'key' that
+ * is setup to match 'rel' (*NOT* idxrel!).
+ *
+ * Returns whether any column contains NULLs.
+ */
+static bool
+build_replindex_scan_key(ScanKey skey, Relation rel, Relation idxrel,
+						 TupleTableSlot *searchslot)
+{
+	int			attoff;
+	bool		isnull;
+	Datum		indclassDatum;
+	oidvector  *opclass;
+	int2vector *indkey = &idxrel->rd_index->indkey;
+	bool		hasnulls = false;
+
+	indclassDatum = SysCacheGetAttr(INDEXRELID, idxrel->rd_indextuple,
+									Anum_pg_index_indclass, &isnull);
+	Assert(!isnull);
+	opclass = (oidvector *) DatumGetPointer(indclassDatum);
+
+	/* Build scankey for every attribute in the index. */
+	for (attoff = 0; attoff < RelationGetNumberOfAttributes(idxrel); attoff++)
+	{
+		Oid			eq_op;
+		Oid			opfamily;
+		RegProcedure regop;
+		int			pkattno = attoff + 1;
+		int			mainattno = indkey->values[attoff];
+		Oid			optype = get_opclass_input_type(opclass->values[attoff]);
+
+		/*
+		 * Load the operator info.  We need this to get the equality operator
+		 * function for the scan key.
+		 */
+		opfamily = get_opclass_family(opclass->values[attoff]);
+
+		eq_op = get_opfamily_member(opfamily, optype, optype,
+									BTEqualStrategyNumber);
+		if (!OidIsValid(eq_op))
+			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+				 BTEqualStrategyNumber, optype, optype, opfamily);
+
+		regop = get_opcode(eq_op);
+
+		/* Initialize the scankey. */
+		ScanKeyInit(&skey[attoff],
+					pkattno,
+					BTEqualStrategyNumber,
+					regop,
+					searchslot->tts_values[mainattno - 1]);
+		skey[attoff].sk_collation = idxrel->rd_indcollation[attoff];
+
+		/* Check for null value. */
+		if (searchslot->tts_isnull[mainattno - 1])
+		{
+			hasnulls = true;
+			skey[attoff].sk_flags |= SK_ISNULL;
+		}
+	}
+
+	return hasnulls;
+}
+
+/*
+ * Lock the tuple found by a search, which the caller has stored in
+ * outslot.  Returns false if the tuple was concurrently updated or
+ * deleted, and the search needs to be retried.
+ */
+static bool
+lock_found_tuple(Relation rel, TupleTableSlot *outslot)
+{
+	Buffer		buf;
+	HeapUpdateFailureData hufd;
+	HTSU_Result res;
+	HeapTupleData locktup;
+
+	ItemPointerCopy(&outslot->tts_tuple->t_self, &locktup.t_self);
+
+	PushActiveSnapshot(GetLatestSnapshot());
+
+	res = heap_lock_tuple(rel, &locktup, GetCurrentCommandId(false),
+						  LockTupleExclusive, LockWaitBlock,
+						  false /* don't follow updates */ ,
+						  &buf, &hufd);
+	/* the tuple slot already has the buffer pinned */
+	ReleaseBuffer(buf);
+
+	PopActiveSnapshot();
+
+	switch (res)
+	{
+		case HeapTupleMayBeUpdated:
+			return true;
+		case HeapTupleUpdated:
+			/* XXX: Improve handling here */
+			ereport(LOG,
+					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
+					 errmsg("concurrent update, retrying")));
+			return false;
+		case HeapTupleInvisible:
+			elog(ERROR, "attempted to lock invisible tuple");
+		default:
+			elog(ERROR, "unexpected heap_lock_tuple status: %u", res);
+	}
+
+	return false;				/* keep compiler quiet */
+}
+
+/*
+ * Search the relation 'rel' for tuple using the replica identity index
+ * 'idxoid', and lock it.
+ *
+ * If a matching tuple is found, lock it with LockTupleExclusive, fill the
+ * slot with its contents, and return true.  Return false otherwise.
+ */
+static bool
+find_tuple_by_index(Relation rel, Oid idxoid, TupleTableSlot *searchslot,
+					TupleTableSlot *outslot)
+{
+	HeapTuple	scantuple;
+	ScanKeyData skey[INDEX_MAX_KEYS];
+	IndexScanDesc scan;
+	SnapshotData snap;
+	TransactionId xwait;
+	Relation	idxrel;
+	bool		found;
+
+	/* Open the index. */
+	idxrel = index_open(idxoid, RowExclusiveLock);
+
+	/* Start an index scan. */
+	InitDirtySnapshot(snap);
+	scan = index_beginscan(rel, idxrel, &snap,
+						   RelationGetNumberOfAttributes(idxrel),
+						   0);
+
+	/* Build scan key. */
+	build_replindex_scan_key(skey, rel, idxrel, searchslot);
+
+retry:
+	found = false;
+
+	index_rescan(scan, skey, RelationGetNumberOfAttributes(idxrel), NULL, 0);
+
+	/* Try to find the tuple */
+	if ((scantuple = index_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		found = true;
+		ExecStoreTuple(scantuple, outslot, InvalidBuffer, false);
+		ExecMaterializeSlot(outslot);
+
+		xwait = TransactionIdIsValid(snap.xmin) ?
+			snap.xmin : snap.xmax;
+
+		/*
+		 * If the tuple is locked, wait for locking transaction to finish and
+		 * retry.
+		 */
+		if (TransactionIdIsValid(xwait))
+		{
+			XactLockTableWait(xwait, NULL, NULL, XLTW_None);
+			goto retry;
+		}
+	}
+
+	/* Found tuple, try to lock it in the lockmode. */
+	if (found && !lock_found_tuple(rel, outslot))
+		goto retry;
+
+	index_endscan(scan);
+
+	/* Don't release lock until commit. */
+	index_close(idxrel, NoLock);
+
+	return found;
+}
+
+/*
+ * Compare the tuple and slot and check if they have equal values.
+ *
+ * We use binary datum comparison which might return false negatives but
+ * that's the best we can do here as there may be multiple notions of
+ * equality for the data types and table columns don't specify which one
+ * to use.
+ */
+static bool
+tuple_equals_slot(TupleDesc desc, HeapTuple tup, TupleTableSlot *slot)
+{
+	Datum		values[MaxTupleAttributeNumber];
+	bool		isnull[MaxTupleAttributeNumber];
+	int			attrnum;
+
+	heap_deform_tuple(tup, desc, values, isnull);
+
+	/* Check equality of the attributes. */
+	for (attrnum = 0; attrnum < desc->natts; attrnum++)
+	{
+		Form_pg_attribute att;
+
+		/*
+		 * If one value is NULL and other is not, then they are certainly not
+		 * equal
+		 */
+		if (isnull[attrnum] != slot->tts_isnull[attrnum])
+			return false;
+
+		/*
+		 * If both are NULL, they can be considered equal.
+		 */
+		if (isnull[attrnum])
+			continue;
+
+		att = desc->attrs[attrnum];
+		if (!datumIsEqual(values[attrnum], slot->tts_values[attrnum],
+						  att->attbyval, att->attlen))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Search the relation 'rel' for tuple using the sequential scan, and lock
+ * it.
+ *
+ * If a matching tuple is found, lock it with LockTupleExclusive, fill the
+ * slot with its contents, and return true.  Return false otherwise.
+ *
+ * Note that this stops on the first matching tuple.
+ *
+ * This can obviously be quite slow on tables that have more than few rows.
+ */
+static bool
+find_tuple_seq(Relation rel, TupleTableSlot *searchslot,
+			   TupleTableSlot *outslot)
+{
+	HeapTuple	scantuple;
+	HeapScanDesc scan;
+	SnapshotData snap;
+	TransactionId xwait;
+	bool		found;
+	TupleDesc	desc = RelationGetDescr(rel);
+
+	/* Start a heap scan. */
+	InitDirtySnapshot(snap);
+	scan = heap_beginscan(rel, &snap, 0, NULL);
+
+retry:
+	found = false;
+
+	heap_rescan(scan, NULL);
+
+	/* Try to find the tuple */
+	while ((scantuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		if (!tuple_equals_slot(desc, scantuple, searchslot))
+			continue;
+
+		found = true;
+		ExecStoreTuple(scantuple, outslot, InvalidBuffer, false);
+		ExecMaterializeSlot(outslot);
+
+		xwait = TransactionIdIsValid(snap.xmin) ?
+			snap.xmin : snap.xmax;
+
+		/*
+		 * If the tuple is locked, wait for locking transaction to finish and
+		 * retry.
+		 */
+		if (TransactionIdIsValid(xwait))
+		{
+			XactLockTableWait(xwait, NULL, NULL, XLTW_None);
+			goto retry;
+		}
+
+		/* Found our tuple and it's not locked */
+		break;
+	}
+
+	/* Found tuple, try to lock it in the lockmode. */
+	if (found && !lock_found_tuple(rel, outslot))
+		goto retry;
+
+	heap_endscan(scan);
+
+	return found;
+}
+
+/*
+ * Find the local tuple matching the remote one in searchslot, by the
+ * replica identity index or the primary key if there is one, otherwise by
+ * comparing whole rows.
+ */
+static bool
+find_local_tuple(LogicalRepRelMapEntry *rel, TupleTableSlot *searchslot,
+				 TupleTableSlot *localslot)
+{
+	Oid			idxoid = RelationGetReplicaIndex(rel->localrel);
+
+	if (OidIsValid(idxoid))
+		return find_tuple_by_index(rel->localrel, idxoid, searchslot,
+								   localslot);
+
+	Assert(rel->remoterel.replident == REPLICA_IDENTITY_FULL);
+	return find_tuple_seq(rel->localrel, searchslot, localslot);
+}
+
+/*
+ * Handle UPDATE message.
+ *
+ * TODO: FDW support
+ */
+static void
+apply_handle_update(StringInfo s)
+{
+	LogicalRepRelMapEntry *rel;
+	LogicalRepRelId relid;
+	EState	   *estate;
+	ResultRelInfo *resultRelInfo;
+	LogicalRepTupleData oldtup;
+	LogicalRepTupleData newtup;
+	bool		has_oldtup;
+	TupleTableSlot *localslot;
+	TupleTableSlot *remoteslot;
+	bool		found;
+	MemoryContext oldctx;
+
+	if (handle_streamed_transaction(LOGICAL_REP_MSG_UPDATE, s))
+		return;
+
+	ensure_transaction();
+
+	relid = logicalrep_read_update(s, &has_oldtup, &oldtup,
+								   &newtup);
+	rel = logicalrep_rel_open(relid, RowExclusiveLock);
+	apply_error_callback_arg.rel = rel;
+
+	/* Check if we can do the update. */
+	check_relation_updatable(rel);
+
+	/* Initialize the executor state. */
+	estate = create_estate_for_relation(rel);
+	resultRelInfo = estate->es_result_relation_info;
+	remoteslot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(remoteslot, RelationGetDescr(rel->localrel));
+	localslot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(localslot, RelationGetDescr(rel->localrel));
+
+	PushActiveSnapshot(GetTransactionSnapshot());
+	ExecOpenIndices(resultRelInfo, false);
+
+	/* Build the search tuple. */
+	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	slot_store_data(remoteslot, rel,
+					has_oldtup ? &oldtup : &newtup);
+	MemoryContextSwitchTo(oldctx);
+
+	/*
+	 * Try to find tuple using either replica identity index, primary key or
+	 * if needed, sequential scan.
+	 */
+	found = find_local_tuple(rel, remoteslot, localslot);
+
+	if (found)
+	{
+		HeapTuple	tuple;
+
+		/* Process and store remote tuple in the slot */
+		oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+		slot_modify_data(remoteslot, localslot, rel, &newtup);
+		MemoryContextSwitchTo(oldctx);
+
+		/* Do the actual update. */
+		tuple = ExecMaterializeSlot(remoteslot);
+		if (rel->localrel->rd_att->constr)
+			ExecConstraints(resultRelInfo, remoteslot, estate);
+		simple_heap_update(rel->localrel, &localslot->tts_tuple->t_self,
+						   tuple);
+		if (resultRelInfo->ri_NumIndices > 0 && !HeapTupleIsHeapOnly(tuple))
+			list_free(ExecInsertIndexTuples(remoteslot, &(tuple->t_self),
+											estate, false, NULL, NIL));
+	}
+	else
+	{
+		/*
+		 * The tuple to be updated could not be found.
+		 *
+		 * TODO what to do here, change the log level to LOG perhaps?
+		 */
+		elog(DEBUG1,
+			 "logical replication did not find row for update "
+			 "in replication target relation \"%s\"",
+			 RelationGetRelationName(rel->localrel));
+	}
+
+	/* Cleanup. */
+	ExecCloseIndices(resultRelInfo);
+	PopActiveSnapshot();
+	ExecResetTupleTable(estate->es_tupleTable, false);
+	FreeExecutorState(estate);
+
+	apply_error_callback_arg.rel = NULL;
+	logicalrep_rel_close(rel, NoLock);
+
+	CommandCounterIncrement();
+}
+
+/*
+ * Handle DELETE message.
+ *
+ * TODO: FDW support
+ */
+static void
+apply_handle_delete(StringInfo s)
+{
+	LogicalRepRelMapEntry *rel;
+	LogicalRepTupleData oldtup;
+	LogicalRepRelId relid;
+	EState	   *estate;
+	TupleTableSlot *remoteslot;
+	TupleTableSlot *localslot;
+	bool		found;
+	MemoryContext oldctx;
+
+	if (handle_streamed_transaction(LOGICAL_REP_MSG_DELETE, s))
+		return;
+
+	ensure_transaction();
+
+	relid = logicalrep_read_delete(s, &oldtup);
+	rel = logicalrep_rel_open(relid, RowExclusiveLock);
+	apply_error_callback_arg.rel = rel;
+
+	/* Check if we can do the delete. */
+	check_relation_updatable(rel);
+
+	/* Initialize the executor state. */
+	estate = create_estate_for_relation(rel);
+	remoteslot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(remoteslot, RelationGetDescr(rel->localrel));
+	localslot = ExecInitExtraTupleSlot(estate);
+	ExecSetSlotDescriptor(localslot, RelationGetDescr(rel->localrel));
+
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	/* Find the tuple using the replica identity index. */
+	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	slot_store_data(remoteslot, rel, &oldtup);
+	MemoryContextSwitchTo(oldctx);
+
+	/*
+	 * Try to find tuple using either replica identity index, primary key or
+	 * if needed, sequential scan.
+	 */
+	found = find_local_tuple(rel, remoteslot, localslot);
+
+	/* If found delete it. */
+	if (found)
+		simple_heap_delete(rel->localrel, &localslot->tts_tuple->t_self);
+	else
+	{
+		/* The tuple to be deleted could not be found. */
+		elog(DEBUG1,
+			 "logical replication could not find row for delete "
+			 "in replication target relation \"%s\"",
+			 RelationGetRelationName(rel->localrel));
+	}
+
+	/* Cleanup. */
+	PopActiveSnapshot();
+	ExecResetTupleTable(estate->es_tupleTable, false);
+	FreeExecutorState(estate);
+
+	apply_error_callback_arg.rel = NULL;
+	logicalrep_rel_close(rel, NoLock);
+
+	CommandCounterIncrement();
+}
+
+
+/*
+ * Logical replication protocol message dispatcher.
+ */
+void
+apply_dispatch(StringInfo s)
+{
+	char		action = pq_getmsgbyte(s);
+	ErrorContextCallback errcallback;
+
+	/* Push apply error context callback. */
+	apply_error_callback_arg.command = action;
+	errcallback.callback = apply_error_callback;
+	errcallback.arg = (void *) &apply_error_callback_arg;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	switch (action)
+	{
+			/* BEGIN */
+		case LOGICAL_REP_MSG_BEGIN:
+			apply_handle_begin(s);
+			break;
+			/* COMMIT */
+		case LOGICAL_REP_MSG_COMMIT:
+			apply_handle_commit(s);
+			break;
+			/* INSERT */
+		case LOGICAL_REP_MSG_INSERT:
+			apply_handle_insert(s);
+			break;
+			/* UPDATE */
+		case LOGICAL_REP_MSG_UPDATE:
+			apply_handle_update(s);
+			break;
+			/* DELETE */
+		case LOGICAL_REP_MSG_DELETE:
+			apply_handle_delete(s);
+			break;
+			/* RELATION */
+		case LOGICAL_REP_MSG_RELATION:
+			apply_handle_relation(s);
+			break;
+			/* STREAM START */
+		case LOGICAL_REP_MSG_STREAM_START:
+			apply_handle_stream_start(s);
+			break;
+			/* STREAM STOP */
+		case LOGICAL_REP_MSG_STREAM_STOP:
+			apply_handle_stream_stop(s);
+			break;
+			/* STREAM ABORT */
+		case LOGICAL_REP_MSG_STREAM_ABORT:
+			apply_handle_stream_abort(s);
+			break;
+			/* STREAM COMMIT */
+		case LOGICAL_REP_MSG_STREAM_COMMIT:
+			apply_handle_stream_commit(s);
+			break;
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("invalid logical replication message type \"%c\"",
+							action)));
+	}
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+	apply_error_callback_arg.command = 0;
+}
+
+/*
+ * Name of a logical replication message type, for error context.
+ */
+static const char *
+logicalrep_message_type(char action)
+{
+	switch (action)
+	{
+		case LOGICAL_REP_MSG_BEGIN:
+			return "BEGIN";
+		case LOGICAL_REP_MSG_COMMIT:
+			return "COMMIT";
+		case LOGICAL_REP_MSG_INSERT:
+			return "INSERT";
+		case LOGICAL_REP_MSG_UPDATE:
+			return "UPDATE";
+		case LOGICAL_REP_MSG_DELETE:
+			return "DELETE";
+		case LOGICAL_REP_MSG_RELATION:
+			return "RELATION";
+		case LOGICAL_REP_MSG_STREAM_START:
+			return "STREAM START";
+		case LOGICAL_REP_MSG_STREAM_STOP:
+			return "STREAM STOP";
+		case LOGICAL_REP_MSG_STREAM_ABORT:
+			return "STREAM ABORT";
+		case LOGICAL_REP_MSG_STREAM_COMMIT:
+			return "STREAM COMMIT";
+	}
+
+	return "???";
+}
+
+/*
+ * Error context callback for errors during the apply of a message.
+ */
+static void
+apply_error_callback(void *arg)
+{
+	ApplyErrorCallbackArg *errarg = (ApplyErrorCallbackArg *) arg;
+	const char *command = logicalrep_message_type(errarg->command);
+
+	if (errarg->rel == NULL)
+	{
+		if (!TransactionIdIsValid(errarg->remote_xid))
+			errcontext("processing remote data for replication message type \"%s\"",
+					   command);
+		else
+			errcontext("processing remote data for replication message type \"%s\" in transaction %u",
+					   command, errarg->remote_xid);
+	}
+	else if (errarg->local_attnum < 0)
+		errcontext("processing remote data for replication message type \"%s\" for replication target relation \"%s.%s\" in transaction %u",
+				   command,
+				   errarg->rel->remoterel.nspname,
+				   errarg->rel->remoterel.relname,
+				   errarg->remote_xid);
+	else
+		errcontext("processing remote data for replication message type \"%s\" for replication target relation \"%s.%s\" column \"%s\" in transaction %u",
+				   command,
+				   errarg->rel->remoterel.nspname,
+				   errarg->rel->remoterel.relname,
+				   NameStr(RelationGetDescr(errarg->rel->localrel)->attrs[errarg->local_attnum]->attname),
+				   errarg->remote_xid);
+}
+
+
+/*
+ * Find the spool file of a streamed transaction, or create it.
+ */
+static StreamXidFile *
+stream_spool_lookup(TransactionId xid, bool create)
+{
+	StreamXidFile *spool;
+	bool		found;
+	MemoryContext oldctx;
+
+	if (StreamXidHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		if (!create)
+			return NULL;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(TransactionId);
+		ctl.entrysize = sizeof(StreamXidFile);
+		ctl.hcxt = ApplyContext;
+		StreamXidHash = hash_create("streamed transaction spool files", 64,
+									&ctl,
+									HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	spool = (StreamXidFile *) hash_search(StreamXidHash, &xid,
+										  create ? HASH_ENTER : HASH_FIND,
+										  &found);
+	if (!create || found)
+		return spool;
+
+	/* The file lives as long as the transaction is being streamed */
+	oldctx = MemoryContextSwitchTo(ApplyContext);
+	spool->file = BufFileCreateTemp(true);
+	MemoryContextSwitchTo(oldctx);
+	spool->end_fileno = 0;
+	spool->end_offset = 0;
+	spool->subxacts = NIL;
+	spool->last_subxid = xid;
+
+	return spool;
+}
+
+/*
+ * Append a change of (sub)transaction subxid to the spool file.
+ *
+ * The whole message is written, preceded by its length.
+ */
+static void
+stream_write_change(StreamXidFile *spool, TransactionId subxid, StringInfo s)
+{
+	int			len = s->len;
+
+	Assert(spool != NULL);
+
+	if (BufFileSeek(spool->file, spool->end_fileno, spool->end_offset,
+					SEEK_SET) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek in streamed transaction spool file: %m")));
+
+	/* Remember where the first change of a subtransaction went */
+	if (subxid != spool->last_subxid && subxid != spool->xid)
+	{
+		ListCell   *lc;
+		bool		known = false;
+
+		foreach(lc, spool->subxacts)
+		{
+			if (((SubXactPosition *) lfirst(lc))->xid == subxid)
+			{
+				known = true;
+				break;
+			}
+		}
+
+		if (!known)
+		{
+			MemoryContext oldctx = MemoryContextSwitchTo(ApplyContext);
+			SubXactPosition *pos = palloc(sizeof(SubXactPosition));
+
+			pos->xid = subxid;
+			pos->fileno = spool->end_fileno;
+			pos->offset = spool->end_offset;
+			spool->subxacts = lappend(spool->subxacts, pos);
+			MemoryContextSwitchTo(oldctx);
+		}
+	}
+	spool->last_subxid = subxid;
+
+	if (BufFileWrite(spool->file, &len, sizeof(len)) != sizeof(len) ||
+		BufFileWrite(spool->file, s->data, len) != len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to streamed transaction spool file: %m")));
+
+	BufFileTell(spool->file, &spool->end_fileno, &spool->end_offset);
+}
+
+/*
+ * Discard the spooled changes of an aborted (sub)transaction.
+ *
+ * Changes of a subtransaction, and of the subtransactions started in it,
+ * always follow its first change, so we just cut the file off there.
+ */
+static void
+stream_abort_spool(TransactionId xid, TransactionId subxid)
+{
+	StreamXidFile *spool = stream_spool_lookup(xid, false);
+	ListCell   *lc;
+	int			n = 0;
+
+	/* Nothing was spooled for the transaction */
+	if (spool == NULL)
+		return;
+
+	if (subxid == xid)
+	{
+		stream_close_spool(spool);
+		return;
+	}
+
+	foreach(lc, spool->subxacts)
+	{
+		SubXactPosition *pos = (SubXactPosition *) lfirst(lc);
+
+		if (pos->xid == subxid)
+		{
+			spool->end_fileno = pos->fileno;
+			spool->end_offset = pos->offset;
+			spool->subxacts = list_truncate(spool->subxacts, n);
+			spool->last_subxid = InvalidTransactionId;
+			break;
+		}
+		n++;
+	}
+}
+
+/*
+ * Remove the spool file of a transaction that committed or aborted.
+ */
+static void
+stream_close_spool(StreamXidFile *spool)
+{
+	TransactionId xid = spool->xid;
+
+	BufFileClose(spool->file);
+	list_free_deep(spool->subxacts);
+	hash_search(StreamXidHash, &xid, HASH_REMOVE, NULL);
+}
+
+/*
+ * Apply the spooled changes of a committed streamed transaction, in one
+ * local transaction.
+ */
+static void
+apply_spooled_messages(TransactionId xid, LogicalRepCommitData *commit_data)
+{
+	StreamXidFile *spool = stream_spool_lookup(xid, false);
+	int			nchanges = 0;
+
+	/* Nothing was spooled, or all of it was aborted */
+	if (spool == NULL)
+		return;
+
+	elog(DEBUG1, "replaying changes of streamed transaction %u", xid);
+
+	in_remote_transaction = true;
+	applying_spooled_changes = true;
+
+	if (BufFileSeek(spool->file, 0, 0, SEEK_SET) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek in streamed transaction spool file: %m")));
+
+	for (;;)
+	{
+		int			fileno;
+		off_t		offset;
+		int			len;
+		StringInfoData s2;
+
+		CHECK_FOR_INTERRUPTS();
+
+		BufFileTell(spool->file, &fileno, &offset);
+		if (fileno > spool->end_fileno ||
+			(fileno == spool->end_fileno && offset >= spool->end_offset))
+			break;
+
+		MemoryContextSwitchTo(ApplyMessageContext);
+
+		if (BufFileRead(spool->file, &len, sizeof(len)) != sizeof(len))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from streamed transaction spool file: %m")));
+
+		initStringInfo(&s2);
+		enlargeStringInfo(&s2, len);
+		if (BufFileRead(spool->file, s2.data, len) != len)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from streamed transaction spool file: %m")));
+		s2.len = len;
+		s2.data[len] = '\0';
+
+		apply_dispatch(&s2);
+
+		MemoryContextReset(ApplyMessageContext);
+		nchanges++;
+	}
+
+	if (IsTransactionState())
+	{
+		replorigin_session_origin_lsn = commit_data->end_lsn;
+		replorigin_session_origin_timestamp = commit_data->committime;
+
+		CommitTransactionCommand();
+
+		store_flush_position(commit_data->end_lsn, XactLastCommitEnd);
+	}
+
+	elog(DEBUG1, "replayed %d changes of streamed transaction %u",
+		 nchanges, xid);
+
+	applying_spooled_changes = false;
+	in_remote_transaction = false;
+
+	stream_close_spool(spool);
+}
+
+
+/*
+ * Figure out which write/flush positions to report to the walsender process.
+ *
+ * We can't simply report back the last LSN the walsender sent us because the
+ * local transaction might not yet be flushed to disk locally. Instead we
+ * build a list that associates local with remote LSNs for every commit. When
+ * reporting back the flush position to the sender we iterate that list and
+ * check which entries on it are already locally flushed. Those we can report
+ * as having been flushed.
+ *
+ * The have_pending_txes is true if there are outstanding transactions that
+ * need to be flushed.
+ */
+static void
+get_flush_position(XLogRecPtr *write, XLogRecPtr *flush,
+				   bool *have_pending_txes)
+{
+	dlist_mutable_iter iter;
+	XLogRecPtr	local_flush = GetFlushRecPtr();
+
+	*write = InvalidXLogRecPtr;
+	*flush = InvalidXLogRecPtr;
+
+	dlist_foreach_modify(iter, &lsn_mapping)
+	{
+		FlushPosition *pos =
+		dlist_container(FlushPosition, node, iter.cur);
+
+		*write = pos->remote_end;
+
+		if (pos->local_end <= local_flush)
+		{
+			*flush = pos->remote_end;
+			dlist_delete(iter.cur);
+			pfree(pos);
+		}
+		else
+		{
+			/*
+			 * Don't want to uselessly iterate over the rest of the list which
+			 * could potentially be long. Instead get the last element and
+			 * grab the write position from there.
+			 */
+			pos = dlist_tail_element(FlushPosition, node,
+									 &lsn_mapping);
+			*write = pos->remote_end;
+			*have_pending_txes = true;
+			return;
+		}
+	}
+
+	*have_pending_txes = !dlist_is_empty(&lsn_mapping);
+}
+
+/*
+ * Store current remote/local lsn pair in the tracking list.
+ */
+static void
+store_flush_position(XLogRecPtr remote_lsn, XLogRecPtr local_lsn)
+{
+	FlushPosition *flushpos;
+
+	/* Need to do this in permanent context */
+	flushpos = (FlushPosition *) MemoryContextAlloc(ApplyContext,
+													sizeof(FlushPosition));
+	flushpos->local_end = local_lsn;
+	flushpos->remote_end = remote_lsn;
+
+	dlist_push_tail(&lsn_mapping, &flushpos->node);
+}
+
+
+/*
+ * Apply main loop.
+ */
+static void
+LogicalRepApplyLoop(XLogRecPtr last_received)
+{
+	TimestampTz last_recv_timestamp = GetCurrentTimestamp();
+	bool		ping_sent = false;
+
+	/*
+	 * Init the ApplyMessageContext which we clean up after each replication
+	 * protocol message.
+	 */
+	ApplyMessageContext = AllocSetContextCreate(ApplyContext,
+												"ApplyMessageContext",
+												ALLOCSET_DEFAULT_MINSIZE,
+												ALLOCSET_DEFAULT_INITSIZE,
+												ALLOCSET_DEFAULT_MAXSIZE);
+
+	/* mark as idle, before starting to loop */
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	for (;;)
+	{
+		int			len;
+		char	   *buf = NULL;
+		bool		endofstream = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Wait for data, or the naptime to run out */
+		len = walrcv_receive(NAPTIME_PER_CYCLE, &buf);
+
+		/* Loop to process all available data (without blocking). */
+		while (len != 0)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			if (len < 0)
+			{
+				ereport(LOG,
+						(errmsg("data stream from publisher has ended")));
+				endofstream = true;
+				break;
+			}
+			else
+			{
+				int			c;
+				StringInfoData s;
+
+				/* Reset timeout. */
+				last_recv_timestamp = GetCurrentTimestamp();
+				ping_sent = false;
+
+				s.data = buf;
+				s.len = len;
+				s.cursor = 0;
+				s.maxlen = -1;
+
+				c = pq_getmsgbyte(&s);
+
+				if (c == 'w')
+				{
+					XLogRecPtr	start_lsn;
+					XLogRecPtr	end_lsn;
+					StringInfoData msg;
+
+					start_lsn = pq_getmsgint64(&s);
+					end_lsn = pq_getmsgint64(&s);
+					(void) pq_getmsgint64(&s);	/* sendTime */
+
+					if (last_received < start_lsn)
+						last_received = start_lsn;
+
+					if (last_received < end_lsn)
+						last_received = end_lsn;
+
+					/*
+					 * The logical replication message itself, which may be
+					 * passed on as it is.
+					 */
+					msg.data = s.data + s.cursor;
+					msg.len = s.len - s.cursor;
+					msg.cursor = 0;
+					msg.maxlen = -1;
+
+					MemoryContextSwitchTo(ApplyMessageContext);
+					apply_dispatch(&msg);
+					MemoryContextSwitchTo(TopMemoryContext);
+					MemoryContextReset(ApplyMessageContext);
+				}
+				else if (c == 'k')
+				{
+					XLogRecPtr	end_lsn;
+					bool		reply_requested;
+
+					end_lsn = pq_getmsgint64(&s);
+					(void) pq_getmsgint64(&s);	/* sendTime */
+					reply_requested = pq_getmsgbyte(&s);
+
+					if (last_received < end_lsn)
+						last_received = end_lsn;
+
+					send_feedback(last_received, reply_requested, false);
+				}
+				/* other message types are purposefully ignored */
+			}
+
+			len = walrcv_receive(0, &buf);
+		}
+
+		if (endofstream)
+			break;
+
+		/* confirm all writes so far */
+		send_feedback(last_received, false, false);
+
+		if (!in_remote_transaction && !in_streamed_transaction)
+		{
+			/*
+			 * If we didn't get any transactions for a while there might be
+			 * unconsumed invalidation messages in the queue, consume them
+			 * now.
+			 */
+			AcceptInvalidationMessages();
+			maybe_reread_subscription();
+		}
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/*
+		 * We didn't receive anything new.  If we haven't heard anything from
+		 * the server for more than wal_receiver_timeout / 2, ping the server.
+		 * Also, if it's been longer than wal_receiver_status_interval since
+		 * the last update we sent, send a status update to the master
+		 * anyway, to report any progress in applying WAL.
+		 */
+		if (len == 0)
+		{
+			bool		requestReply = false;
+
+			/*
+			 * Check if time since last receive from standby has reached the
+			 * configured limit.
+			 */
+			if (wal_receiver_timeout > 0)
+			{
+				TimestampTz now = GetCurrentTimestamp();
+				TimestampTz timeout;
+
+				timeout =
+					TimestampTzPlusMilliseconds(last_recv_timestamp,
+												wal_receiver_timeout);
+
+				if (now >= timeout)
+					ereport(ERROR,
+							(errmsg("terminating logical replication worker due to timeout")));
+
+				/*
+				 * We didn't receive anything new, for half of receiver
+				 * replication timeout. Ping the server.
+				 */
+				if (!ping_sent)
+				{
+					timeout = TimestampTzPlusMilliseconds(last_recv_timestamp,
+												 (wal_receiver_timeout / 2));
+					if (now >= timeout)
+					{
+						requestReply = true;
+						ping_sent = true;
+					}
+				}
+			}
+
+			send_feedback(last_received, requestReply, requestReply);
+		}
+	}
+
+	walrcv_disconnect();
+}
+
+/*
+ * Send a Standby Status Update message to server.
+ *
+ * 'recvpos' is the latest LSN we've received data to, force is set if we need
+ * to send a response to avoid timeouts.
+ */
+static void
+send_feedback(XLogRecPtr recvpos, bool force, bool requestReply)
+{
+	static StringInfo reply_message = NULL;
+	static TimestampTz send_time = 0;
+
+	static XLogRecPtr last_recvpos = InvalidXLogRecPtr;
+	static XLogRecPtr last_writepos = InvalidXLogRecPtr;
+	static XLogRecPtr last_flushpos = InvalidXLogRecPtr;
+
+	XLogRecPtr	writepos;
+	XLogRecPtr	flushpos;
+	TimestampTz now;
+	bool		have_pending_txes;
+
+	/*
+	 * If the user doesn't want status to be reported to the publisher, be
+	 * sure to exit before doing anything at all.
+	 */
+	if (!force && wal_receiver_status_interval <= 0)
+		return;
+
+	/* It's legal to not pass a recvpos */
+	if (recvpos < last_recvpos)
+		recvpos = last_recvpos;
+
+	get_flush_position(&writepos, &flushpos, &have_pending_txes);
+
+	/*
+	 * No outstanding transactions to flush, we can report the latest received
+	 * position. This is important for synchronous replication.
+	 */
+	if (!have_pending_txes)
+		flushpos = writepos = recvpos;
+
+	if (writepos < last_writepos)
+		writepos = last_writepos;
+
+	if (flushpos < last_flushpos)
+		flushpos = last_flushpos;
+
+	now = GetCurrentTimestamp();
+
+	/* if we've already reported everything we're good */
+	if (!force &&
+		writepos == last_writepos &&
+		flushpos == last_flushpos &&
+		!TimestampDifferenceExceeds(send_time, now,
+									wal_receiver_status_interval * 1000))
+		return;
+	send_time = now;
+
+	if (!reply_message)
+	{
+		MemoryContext oldctx = MemoryContextSwitchTo(ApplyContext);
+
+		reply_message = makeStringInfo();
+		MemoryContextSwitchTo(oldctx);
+	}
+	else
+		resetStringInfo(reply_message);
+
+	pq_sendbyte(reply_message, 'r');
+	pq_sendint64(reply_message, recvpos);		/* write */
+	pq_sendint64(reply_message, flushpos);		/* flush */
+	pq_sendint64(reply_message, writepos);		/* apply */
+	pq_sendint64(reply_message, GetCurrentIntegerTimestamp());	/* sendTime */
+	pq_sendbyte(reply_message, requestReply);	/* replyRequested */
+
+	elog(DEBUG2, "sending feedback (force %d) to recv %X/%X, write %X/%X, flush %X/%X",
+		 force,
+		 (uint32) (recvpos >> 32), (uint32) recvpos,
+		 (uint32) (writepos >> 32), (uint32) writepos,
+		 (uint32) (flushpos >> 32), (uint32) flushpos
+		);
+
+	walrcv_send(reply_message->data, reply_message->len);
+
+	if (recvpos > last_recvpos)
+		last_recvpos = recvpos;
+	if (writepos > last_writepos)
+		last_writepos = writepos;
+	if (flushpos > last_flushpos)
+		last_flushpos = flushpos;
+}
+
+/*
+ * Reread subscription info if needed.
+ *
+ * Any change of the subscription makes us exit, and the launcher starts
+ * us again with the new definition.
+ */
+static void
+maybe_reread_subscription(void)
+{
+	MemoryContext oldctx;
+	Subscription *newsub;
+	bool		started_tx = false;
+
+	/* When cache state is valid there is nothing to do here. */
+	if (MySubscriptionValid)
+		return;
+
+	/* This function might be called inside or outside of transaction. */
+	if (!IsTransactionState())
+	{
+		StartTransactionCommand();
+		started_tx = true;
+	}
+
+	/* Ensure allocations in permanent context. */
+	oldctx = MemoryContextSwitchTo(ApplyContext);
+
+	newsub = GetSubscription(MyLogicalRepWorker->subid, true);
+
+	/*
+	 * Exit if the subscription was removed. This normally should not happen
+	 * as the worker gets killed during DROP SUBSCRIPTION.
+	 */
+	if (!newsub)
+	{
+		ereport(LOG,
+				(errmsg("logical replication apply worker for subscription \"%s\" will "
+						"stop because the subscription was removed",
+						MySubscription->name)));
+
+		proc_exit(0);
+	}
+
+	/*
+	 * Exit if the subscription was disabled. This normally should not happen
+	 * as the worker gets killed during ALTER SUBSCRIPTION ... DISABLE.
+	 */
+	if (!newsub->enabled)
+	{
+		ereport(LOG,
+				(errmsg("logical replication apply worker for subscription \"%s\" will "
+						"stop because the subscription was disabled",
+						MySubscription->name)));
+
+		proc_exit(0);
+	}
+
+	/*
+	 * Exit if any parameter that affects the remote connection or the
+	 * options we started streaming with was changed.
+	 */
+	if (strcmp(newsub->name, MySubscription->name) != 0 ||
+		strcmp(newsub->conninfo, MySubscription->conninfo) != 0 ||
+		strcmp(newsub->slotname, MySubscription->slotname) != 0 ||
+		newsub->stream != MySubscription->stream ||
+		newsub->binary != MySubscription->binary ||
+		!equal(newsub->publications, MySubscription->publications))
+	{
+		ereport(LOG,
+				(errmsg("logical replication apply worker for subscription \"%s\" will "
+						"restart because of a parameter change",
+						MySubscription->name)));
+
+		proc_exit(0);
+	}
+
+	/* Check for other changes that should never happen too. */
+	if (newsub->dbid != MySubscription->dbid)
+		elog(ERROR, "subscription %u changed unexpectedly",
+			 MyLogicalRepWorker->subid);
+
+	/* Clean old subscription info and switch to new one. */
+	FreeSubscription(MySubscription);
+	MySubscription = newsub;
+
+	MemoryContextSwitchTo(oldctx);
+
+	if (started_tx)
+		CommitTransactionCommand();
+
+	MySubscriptionValid = true;
+}
+
+/*
+ * Callback from subscription syscache invalidation.
+ */
+static void
+subscription_change_cb(Datum arg, int cacheid, uint32 hashvalue)
+{
+	MySubscriptionValid = false;
+}
+
+/* SIGHUP: set flag to reload configuration at next convenient time */
+static void
+logicalrep_worker_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+
+	/* Waken anything waiting on the process latch */
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Shut down the parallel apply workers and give up the replication origin
+ * when we exit.  This runs before we detach from our slot, so that once
+ * logicalrep_worker_stop sees the slot free, DROP SUBSCRIPTION can drop the
+ * origin.
+ */
+static void
+apply_worker_onexit(int code, Datum arg)
+{
+	LWLockReleaseAll();
+
+	pa_shutdown_workers();
+
+	if (replorigin_session_origin != InvalidRepOriginId)
+	{
+		replorigin_session_reset();
+		replorigin_session_origin = InvalidRepOriginId;
+	}
+}
+
+/* Logical Replication Apply worker entry point */
+void
+ApplyWorkerMain(Datum main_arg)
+{
+	int			worker_slot = DatumGetInt32(main_arg);
+	MemoryContext oldctx;
+	char		originname[NAMEDATALEN];
+	RepOriginId originid;
+	XLogRecPtr	origin_startpos;
+	StringInfoData options;
+	ListCell   *lc;
+
+	/* Attach to slot */
+	logicalrep_worker_attach(worker_slot);
+	before_shmem_exit(apply_worker_onexit, (Datum) 0);
+
+	/* Setup signal handling */
+	pqsignal(SIGHUP, logicalrep_worker_sighup);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* Load the libpq-specific functions */
+	load_file("libpqwalreceiver", false);
+
+	/* Run as replica session replication role. */
+	SetConfigOption("session_replication_role", "replica",
+					PGC_SUSET, PGC_S_OVERRIDE);
+
+	/* Connect to our database. */
+	BackgroundWorkerInitializeConnectionByOid(MyLogicalRepWorker->dbid,
+											  MyLogicalRepWorker->userid);
+
+	/* Load the subscription into persistent memory context. */
+	ApplyContext = AllocSetContextCreate(TopMemoryContext,
+										 "ApplyContext",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE);
+	StartTransactionCommand();
+
+	/* Don't race with a concurrent DROP SUBSCRIPTION */
+	LockSharedObject(SubscriptionRelationId, MyLogicalRepWorker->subid, 0,
+					 AccessShareLock);
+
+	oldctx = MemoryContextSwitchTo(ApplyContext);
+	MySubscription = GetSubscription(MyLogicalRepWorker->subid, true);
+	MemoryContextSwitchTo(oldctx);
+
+	if (!MySubscription)
+	{
+		ereport(LOG,
+				(errmsg("logical replication apply worker for subscription %u will not "
+				"start because the subscription was removed during startup",
+						MyLogicalRepWorker->subid)));
+		proc_exit(0);
+	}
+
+	MySubscriptionValid = true;
+
+	if (!MySubscription->enabled)
+	{
+		ereport(LOG,
+				(errmsg("logical replication apply worker for subscription \"%s\" will not "
+						"start because the subscription was disabled during startup",
+						MySubscription->name)));
+
+		proc_exit(0);
+	}
+
+	/* Keep us informed about subscription changes. */
+	CacheRegisterSyscacheCallback(SUBSCRIPTIONOID,
+								  subscription_change_cb,
+								  (Datum) 0);
+
+	ereport(LOG,
+			(errmsg("logical replication apply worker for subscription \"%s\" has started",
+					MySubscription->name)));
+
+	/* Setup replication origin tracking. */
+	snprintf(originname, sizeof(originname), "pg_%u", MySubscription->oid);
+	originid = replorigin_by_name(originname, true);
+	if (!OidIsValid(originid))
+		originid = replorigin_create(originname);
+	replorigin_session_setup(originid, 0);
+	replorigin_session_origin = originid;
+	origin_startpos = replorigin_session_get_progress(false);
+
+	CommitTransactionCommand();
+
+	/* Connect to the origin and start the replication. */
+	elog(DEBUG1, "connecting to publisher using connection string \"%s\"",
+		 MySubscription->conninfo);
+	walrcv_connect_logical(MySubscription->conninfo, MySubscription->name);
+
+	/* Build logical replication streaming options. */
+	initStringInfo(&options);
+	appendStringInfo(&options, "proto_version '%u', publication_names '",
+					 LOGICALREP_PROTO_VERSION_NUM);
+	foreach(lc, MySubscription->publications)
+	{
+		char	   *pubname = strVal(lfirst(lc));
+		const char *p;
+
+		if (lc != list_head(MySubscription->publications))
+			appendStringInfoChar(&options, ',');
+
+		/* a quoted identifier, inside a quoted literal */
+		appendStringInfoChar(&options, '"');
+		for (p = pubname; *p; p++)
+		{
+			if (*p == '"')
+				appendStringInfoChar(&options, '"');
+			else if (*p == '\'')
+				appendStringInfoChar(&options, '\'');
+			appendStringInfoChar(&options, *p);
+		}
+		appendStringInfoChar(&options, '"');
+	}
+	appendStringInfoChar(&options, '\'');
+	if (MySubscription->stream)
+		appendStringInfoString(&options, ", streaming 'on'");
+	if (MySubscription->binary)
+		appendStringInfoString(&options, ", binary 'on'");
+
+	walrcv_startstreaming_logical(MySubscription->slotname, origin_startpos,
+								  options.data);
+	pfree(options.data);
+
+	/* Run the main loop. */
+	LogicalRepApplyLoop(origin_startpos);
+
+	proc_exit(0);
+}
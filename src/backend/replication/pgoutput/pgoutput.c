@@ -0,0 +1,792 @@
+/*-------------------------------------------------------------------------
+ *
+ * pgoutput.c
+ *		Logical Replication output plugin
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  src/backend/replication/pgoutput/pgoutput.c
+ *
+ * This is the output plugin used by the built-in logical replication.  It
+ * sends the changes of the tables in the requested publications in the
+ * binary protocol of replication/logicalproto.h.  When the subscriber asks
+ * for it, large transactions are streamed while still in progress.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "catalog/pg_publication.h"
+#include "replication/logical.h"
+#include "replication/logicalproto.h"
+#include "replication/origin.h"
+#include "replication/output_plugin.h"
+#include "utils/builtins.h"
+#include "utils/int8.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+PG_MODULE_MAGIC;
+
+extern void _PG_output_plugin_init(OutputPluginCallbacks *cb);
+
+typedef struct PGOutputData
+{
+	MemoryContext context;		/* private memory context for transient
+								 * allocations */
+
+	/* client info */
+	uint32		protocol_version;
+	List	   *publication_names;
+	List	   *publications;
+	bool		binary;
+	bool		streaming;
+} PGOutputData;
+
+static void pgoutput_startup(LogicalDecodingContext *ctx,
+				 OutputPluginOptions *opt, bool is_init);
+static void pgoutput_shutdown(LogicalDecodingContext *ctx);
+static void pgoutput_begin_txn(LogicalDecodingContext *ctx,
+				   ReorderBufferTXN *txn);
+static void pgoutput_commit_txn(LogicalDecodingContext *ctx,
+					ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
+static void pgoutput_change(LogicalDecodingContext *ctx,
+				ReorderBufferTXN *txn, Relation rel,
+				ReorderBufferChange *change);
+static void pgoutput_stream_start(LogicalDecodingContext *ctx,
+					  ReorderBufferTXN *txn);
+static void pgoutput_stream_stop(LogicalDecodingContext *ctx,
+					 ReorderBufferTXN *txn);
+static void pgoutput_stream_change(LogicalDecodingContext *ctx,
+					   ReorderBufferTXN *txn, Relation rel,
+					   ReorderBufferChange *change);
+static void pgoutput_stream_abort(LogicalDecodingContext *ctx,
+					  ReorderBufferTXN *txn, XLogRecPtr abort_lsn);
+static void pgoutput_stream_commit(LogicalDecodingContext *ctx,
+					   ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
+
+static bool publications_valid;
+
+static List *LoadPublications(List *pubnames);
+static void publication_invalidation_cb(Datum arg, int cacheid,
+							uint32 hashvalue);
+
+/*
+ * Entry in the map used to remember which relation schemas we sent, and
+ * whether the relation is published at all.
+ *
+ * A relation's schema is sent before its first change, and again after it
+ * has been invalidated.  Within a streamed transaction it is sent again, once
+ * per transaction: the subscriber may apply the transaction in a process of
+ * its own, that hasn't seen the earlier RELATION messages.  The streamed
+ * transactions that got the schema are remembered in streamed_txns; when
+ * one of them commits, the schema counts as sent for good.
+ */
+typedef struct RelationSyncEntry
+{
+	Oid			relid;			/* relation oid */
+	bool		replicate_valid;	/* is publish valid? */
+	bool		schema_sent;
+	List	   *streamed_txns;	/* streamed toplevel transactions with this
+								 * schema */
+	bool		publish;		/* is the relation in one of our
+								 * publications? */
+} RelationSyncEntry;
+
+/* Map used to remember which relation schemas we sent. */
+static HTAB *RelationSyncCache = NULL;
+
+static void init_rel_sync_cache(MemoryContext decoding_context);
+static RelationSyncEntry *get_rel_sync_entry(PGOutputData *data, Oid relid);
+static void cleanup_rel_sync_cache(TransactionId xid, bool is_commit);
+static void rel_sync_cache_relation_cb(Datum arg, Oid relid);
+static void rel_sync_cache_publication_cb(Datum arg, int cacheid,
+							  uint32 hashvalue);
+
+/*
+ * Specify output plugin callbacks
+ */
+void
+_PG_output_plugin_init(OutputPluginCallbacks *cb)
+{
+	AssertVariableIsOfType(&_PG_output_plugin_init, LogicalOutputPluginInit);
+
+	cb->startup_cb = pgoutput_startup;
+	cb->begin_cb = pgoutput_begin_txn;
+	cb->change_cb = pgoutput_change;
+	cb->commit_cb = pgoutput_commit_txn;
+	cb->shutdown_cb = pgoutput_shutdown;
+	cb->stream_start_cb = pgoutput_stream_start;
+	cb->stream_stop_cb = pgoutput_stream_stop;
+	cb->stream_change_cb = pgoutput_stream_change;
+	cb->stream_abort_cb = pgoutput_stream_abort;
+	cb->stream_commit_cb = pgoutput_stream_commit;
+}
+
+static void
+parse_output_parameters(List *options, uint32 *protocol_version,
+						List **publication_names, bool *binary,
+						bool *streaming)
+{
+	ListCell   *lc;
+	bool		protocol_version_given = false;
+	bool		publication_names_given = false;
+	bool		binary_given = false;
+	bool		streaming_given = false;
+
+	foreach(lc, options)
+	{
+		DefElem    *defel = (DefElem *) lfirst(lc);
+
+		Assert(defel->arg == NULL || IsA(defel->arg, String));
+
+		/* Check each param, whether or not we recognise it */
+		if (strcmp(defel->defname, "proto_version") == 0)
+		{
+			int64		parsed;
+
+			if (protocol_version_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			protocol_version_given = true;
+
+			if (defel->arg == NULL ||
+				!scanint8(strVal(defel->arg), true, &parsed))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("invalid proto_version")));
+
+			if (parsed > PG_UINT32_MAX || parsed < 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("proto_version \"%s\" out of range",
+								strVal(defel->arg))));
+
+			*protocol_version = (uint32) parsed;
+		}
+		else if (strcmp(defel->defname, "publication_names") == 0)
+		{
+			if (publication_names_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			publication_names_given = true;
+
+			if (defel->arg == NULL ||
+				!SplitIdentifierString(pstrdup(strVal(defel->arg)), ',',
+									   publication_names))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_NAME),
+						 errmsg("invalid publication_names syntax")));
+		}
+		else if (strcmp(defel->defname, "binary") == 0)
+		{
+			if (binary_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			binary_given = true;
+
+			if (defel->arg == NULL)
+				*binary = true;
+			else if (!parse_bool(strVal(defel->arg), binary))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				  errmsg("could not parse value \"%s\" for parameter \"%s\"",
+						 strVal(defel->arg), defel->defname)));
+		}
+		else if (strcmp(defel->defname, "streaming") == 0)
+		{
+			if (streaming_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			streaming_given = true;
+
+			if (defel->arg == NULL)
+				*streaming = true;
+			else if (!parse_bool(strVal(defel->arg), streaming))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				  errmsg("could not parse value \"%s\" for parameter \"%s\"",
+						 strVal(defel->arg), defel->defname)));
+		}
+		else
+			elog(ERROR, "unrecognized pgoutput option: %s", defel->defname);
+	}
+}
+
+/*
+ * Initialize this plugin
+ */
+static void
+pgoutput_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+				 bool is_init)
+{
+	PGOutputData *data = palloc0(sizeof(PGOutputData));
+
+	/* Create our memory context for private allocations. */
+	data->context = AllocSetContextCreate(ctx->context,
+										  "logical replication output context",
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+
+	ctx->output_plugin_private = data;
+
+	/* This plugin uses binary protocol. */
+	opt->output_type = OUTPUT_PLUGIN_BINARY_OUTPUT;
+
+	/*
+	 * This is replication start and not slot initialization.
+	 *
+	 * Parse and validate options passed by the client.
+	 */
+	if (!is_init)
+	{
+		/* Parse the params and ERROR if we see any we don't recognise */
+		parse_output_parameters(ctx->output_plugin_options,
+								&data->protocol_version,
+								&data->publication_names,
+								&data->binary,
+								&data->streaming);
+
+		/* Check if we support requested protocol */
+		if (data->protocol_version > LOGICALREP_PROTO_VERSION_NUM)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("client sent proto_version=%d but we only support protocol %d or lower",
+							data->protocol_version, LOGICALREP_PROTO_VERSION_NUM)));
+
+		if (data->protocol_version < LOGICALREP_PROTO_MIN_VERSION_NUM)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("client sent proto_version=%d but we only support protocol %d or higher",
+							data->protocol_version, LOGICALREP_PROTO_MIN_VERSION_NUM)));
+
+		if (list_length(data->publication_names) < 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("publication_names parameter missing")));
+
+		/* Init publication state. */
+		data->publications = NIL;
+		publications_valid = false;
+
+		/* Initialize relation schema cache. */
+		init_rel_sync_cache(CacheMemoryContext);
+	}
+
+	/* only stream in-progress transactions if the subscriber asked for it */
+	ctx->streaming = ctx->streaming && data->streaming;
+}
+
+/*
+ * BEGIN callback
+ */
+static void
+pgoutput_begin_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_begin(ctx->out, txn);
+	OutputPluginWrite(ctx, true);
+}
+
+/*
+ * COMMIT callback
+ */
+static void
+pgoutput_commit_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					XLogRecPtr commit_lsn)
+{
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_commit(ctx->out, txn, commit_lsn);
+	OutputPluginWrite(ctx, true);
+}
+
+/*
+ * Write the relation schema if the current schema hasn't been sent yet.
+ */
+static void
+maybe_send_schema(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				  Relation relation, RelationSyncEntry *relentry,
+				  bool streaming)
+{
+	TransactionId topxid = InvalidTransactionId;
+	bool		schema_sent;
+
+	/*
+	 * Within a streamed transaction, the schema has to be sent once per
+	 * transaction, see RelationSyncEntry.
+	 */
+	if (streaming)
+	{
+		topxid = txn->toptxn ? txn->toptxn->xid : txn->xid;
+		schema_sent = list_member_int(relentry->streamed_txns, (int) topxid);
+	}
+	else
+		schema_sent = relentry->schema_sent;
+
+	if (schema_sent)
+		return;
+
+	OutputPluginPrepareWrite(ctx, false);
+	logicalrep_write_rel(ctx->out, topxid, relation);
+	OutputPluginWrite(ctx, false);
+
+	if (streaming)
+	{
+		MemoryContext oldctx = MemoryContextSwitchTo(CacheMemoryContext);
+
+		relentry->streamed_txns = lappend_int(relentry->streamed_txns,
+											  (int) topxid);
+		MemoryContextSwitchTo(oldctx);
+	}
+	else
+		relentry->schema_sent = true;
+}
+
+/*
+ * Sends the decoded DML over wire, as part of a streamed transaction if
+ * streaming is set.
+ */
+static void
+pgoutput_change_internal(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						 Relation relation, ReorderBufferChange *change,
+						 bool streaming)
+{
+	PGOutputData *data = (PGOutputData *) ctx->output_plugin_private;
+	MemoryContext old;
+	RelationSyncEntry *relentry;
+	TransactionId xid = InvalidTransactionId;
+
+	if (!is_publishable_relation(relation))
+		return;
+
+	relentry = get_rel_sync_entry(data, RelationGetRelid(relation));
+	if (!relentry->publish)
+		return;
+
+	/* changes of a streamed transaction carry the (sub)transaction's xid */
+	if (streaming)
+		xid = txn->xid;
+
+	/* Avoid leaking memory by using and resetting our own context */
+	old = MemoryContextSwitchTo(data->context);
+
+	maybe_send_schema(ctx, txn, relation, relentry, streaming);
+
+	/* Send the data */
+	switch (change->action)
+	{
+		case REORDER_BUFFER_CHANGE_INSERT:
+			OutputPluginPrepareWrite(ctx, true);
+			logicalrep_write_insert(ctx->out, xid, relation,
+									&change->data.tp.newtuple->tuple,
+									data->binary);
+			OutputPluginWrite(ctx, true);
+			break;
+		case REORDER_BUFFER_CHANGE_UPDATE:
+			{
+				HeapTuple	oldtuple = change->data.tp.oldtuple ?
+				&change->data.tp.oldtuple->tuple : NULL;
+
+				OutputPluginPrepareWrite(ctx, true);
+				logicalrep_write_update(ctx->out, xid, relation, oldtuple,
+										&change->data.tp.newtuple->tuple,
+										data->binary);
+				OutputPluginWrite(ctx, true);
+				break;
+			}
+		case REORDER_BUFFER_CHANGE_DELETE:
+			if (change->data.tp.oldtuple)
+			{
+				OutputPluginPrepareWrite(ctx, true);
+				logicalrep_write_delete(ctx->out, xid, relation,
+										&change->data.tp.oldtuple->tuple,
+										data->binary);
+				OutputPluginWrite(ctx, true);
+			}
+			else
+				elog(DEBUG1, "didn't send DELETE change because of missing oldtuple");
+			break;
+		default:
+			Assert(false);
+	}
+
+	/* Cleanup */
+	MemoryContextSwitchTo(old);
+	MemoryContextReset(data->context);
+}
+
+/*
+ * Change callback
+ */
+static void
+pgoutput_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				Relation relation, ReorderBufferChange *change)
+{
+	pgoutput_change_internal(ctx, txn, relation, change, false);
+}
+
+/*
+ * Shutdown the output plugin.
+ *
+ * Note, we don't need to clean the data->context as it's child context
+ * of the ctx->context so it will be cleaned up by logical decoding machinery.
+ */
+static void
+pgoutput_shutdown(LogicalDecodingContext *ctx)
+{
+	if (RelationSyncCache)
+	{
+		hash_destroy(RelationSyncCache);
+		RelationSyncCache = NULL;
+	}
+}
+
+/*
+ * START STREAM callback
+ */
+static void
+pgoutput_stream_start(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	/* we can't nest streaming of transactions */
+	Assert(txn->toptxn == NULL);
+
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_stream_start(ctx->out, txn->xid, !txn->is_streamed);
+	OutputPluginWrite(ctx, true);
+}
+
+/*
+ * STOP STREAM callback
+ */
+static void
+pgoutput_stream_stop(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_stream_stop(ctx->out);
+	OutputPluginWrite(ctx, true);
+}
+
+/*
+ * Change callback within a streamed block.  txn is the (sub)transaction
+ * that made the change.
+ */
+static void
+pgoutput_stream_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					   Relation relation, ReorderBufferChange *change)
+{
+	pgoutput_change_internal(ctx, txn, relation, change, true);
+}
+
+/*
+ * Notify downstream to discard the streamed transaction, or one of its
+ * subtransactions.  This can be called outside of a streamed block.
+ */
+static void
+pgoutput_stream_abort(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					  XLogRecPtr abort_lsn)
+{
+	ReorderBufferTXN *toptxn = txn->toptxn ? txn->toptxn : txn;
+
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_stream_abort(ctx->out, toptxn->xid, txn->xid);
+	OutputPluginWrite(ctx, true);
+
+	if (toptxn == txn)
+		cleanup_rel_sync_cache(toptxn->xid, false);
+}
+
+/*
+ * Notify downstream to apply the streamed transaction, whose changes have
+ * all been sent already.
+ */
+static void
+pgoutput_stream_commit(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					   XLogRecPtr commit_lsn)
+{
+	Assert(txn->toptxn == NULL);
+
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_stream_commit(ctx->out, txn, commit_lsn);
+	OutputPluginWrite(ctx, true);
+
+	cleanup_rel_sync_cache(txn->xid, true);
+}
+
+/*
+ * Load publications from the list of publication names.
+ */
+static List *
+LoadPublications(List *pubnames)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach(lc, pubnames)
+	{
+		char	   *pubname = (char *) lfirst(lc);
+		Publication *pub = GetPublicationByName(pubname, false);
+
+		result = lappend(result, pub);
+	}
+
+	return result;
+}
+
+/*
+ * Publication cache invalidation callback.
+ */
+static void
+publication_invalidation_cb(Datum arg, int cacheid, uint32 hashvalue)
+{
+	publications_valid = false;
+
+	/*
+	 * Also invalidate per-relation cache so that next time the filtering info
+	 * is checked it will be updated with the new publication settings.
+	 */
+	rel_sync_cache_publication_cb(arg, cacheid, hashvalue);
+}
+
+/*
+ * Initialize the relation schema sync cache for a decoding session.
+ *
+ * The hash table is destroyed at the end of a decoding session. While
+ * relcache invalidations still exist and will still be invoked, they
+ * will just see the null hash table global and take no action.
+ */
+static void
+init_rel_sync_cache(MemoryContext cachectx)
+{
+	HASHCTL		ctl;
+	MemoryContext old_ctxt;
+	static bool relation_callbacks_registered = false;
+
+	if (RelationSyncCache != NULL)
+		return;
+
+	/* Make a new hash table for the cache */
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(RelationSyncEntry);
+	ctl.hcxt = cachectx;
+
+	old_ctxt = MemoryContextSwitchTo(cachectx);
+	RelationSyncCache = hash_create("logical replication output relation cache",
+									128, &ctl,
+									HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+	(void) MemoryContextSwitchTo(old_ctxt);
+
+	Assert(RelationSyncCache != NULL);
+
+	/* The callbacks can't be unregistered, so only do this once */
+	if (relation_callbacks_registered)
+		return;
+
+	CacheRegisterSyscacheCallback(PUBLICATIONOID,
+								  publication_invalidation_cb,
+								  (Datum) 0);
+	CacheRegisterRelcacheCallback(rel_sync_cache_relation_cb, (Datum) 0);
+	CacheRegisterSyscacheCallback(PUBLICATIONRELMAP,
+								  rel_sync_cache_publication_cb,
+								  (Datum) 0);
+	relation_callbacks_registered = true;
+}
+
+/*
+ * Find or create entry in the relation schema cache.
+ *
+ * This looks up the publications that the given relation is part of, and
+ * fills in whether it is published by any of ours.
+ */
+static RelationSyncEntry *
+get_rel_sync_entry(PGOutputData *data, Oid relid)
+{
+	RelationSyncEntry *entry;
+	bool		found;
+	MemoryContext oldctx;
+
+	Assert(RelationSyncCache != NULL);
+
+	/* Find cached relation info, creating if not found */
+	oldctx = MemoryContextSwitchTo(CacheMemoryContext);
+	entry = (RelationSyncEntry *) hash_search(RelationSyncCache,
+											  (void *) &relid,
+											  HASH_ENTER, &found);
+	MemoryContextSwitchTo(oldctx);
+	Assert(entry != NULL);
+
+	/* Not found means schema wasn't sent */
+	if (!found)
+	{
+		entry->schema_sent = false;
+		entry->streamed_txns = NIL;
+		entry->replicate_valid = false;
+		entry->publish = false;
+	}
+
+	/* Validate the entry */
+	if (!entry->replicate_valid)
+	{
+		List	   *pubids = GetRelationPublications(relid);
+		ListCell   *lc;
+
+		/* Reload publications if needed before use. */
+		if (!publications_valid)
+		{
+			oldctx = MemoryContextSwitchTo(CacheMemoryContext);
+			if (data->publications)
+				list_free_deep(data->publications);
+
+			data->publications = LoadPublications(data->publication_names);
+			MemoryContextSwitchTo(oldctx);
+			publications_valid = true;
+		}
+
+		entry->publish = false;
+		foreach(lc, data->publications)
+		{
+			Publication *pub = lfirst(lc);
+
+			if (pub->alltables || list_member_oid(pubids, pub->oid))
+			{
+				entry->publish = true;
+				break;
+			}
+		}
+
+		list_free(pubids);
+
+		entry->replicate_valid = true;
+	}
+
+	return entry;
+}
+
+/*
+ * Cleanup list of streamed transactions and update the schema_sent flag.
+ *
+ * When a streamed transaction commits or aborts, we need to remove the
+ * toplevel XID from the schema cache. If the transaction aborted, the
+ * subscriber will simply throw away the schema records we streamed, so
+ * we don't need to do anything else.
+ *
+ * If the transaction is committed, the subscriber will update the relation
+ * cache - so tweak the schema_sent flag accordingly.
+ */
+static void
+cleanup_rel_sync_cache(TransactionId xid, bool is_commit)
+{
+	HASH_SEQ_STATUS hash_seq;
+	RelationSyncEntry *entry;
+
+	Assert(RelationSyncCache != NULL);
+
+	hash_seq_init(&hash_seq, RelationSyncCache);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		/*
+		 * We can set the schema_sent flag for an entry that has committed xid
+		 * in the list as that ensures that the subscriber would have the
+		 * corresponding schema and we don't need to send it unless there is
+		 * any invalidation for that relation.
+		 */
+		if (list_member_int(entry->streamed_txns, (int) xid))
+		{
+			if (is_commit)
+				entry->schema_sent = true;
+
+			entry->streamed_txns =
+				list_delete_int(entry->streamed_txns, (int) xid);
+		}
+	}
+}
+
+/*
+ * Relcache invalidation callback
+ */
+static void
+rel_sync_cache_relation_cb(Datum arg, Oid relid)
+{
+	RelationSyncEntry *entry;
+
+	/*
+	 * We can get here if the plugin was used in SQL interface as the
+	 * RelSchemaSyncCache is destroyed when the decoding finishes, but there
+	 * is no way to unregister the relcache invalidation callback.
+	 */
+	if (RelationSyncCache == NULL)
+		return;
+
+	/*
+	 * Nobody keeps pointers to entries in this hash table around outside
+	 * logical decoding callback calls - but invalidation events can come in
+	 * *during* a callback if we access the relcache in the callback. Because
+	 * of that we must mark the cache entry as invalid but not remove it from
+	 * the hash while it could still be referenced, then prune it at a later
+	 * safe point.
+	 *
+	 * Getting invalidations for relations that aren't in the table is
+	 * entirely normal, since there's no way to unregister for an invalidation
+	 * event. So we don't care if it's found or not.
+	 */
+	if (OidIsValid(relid))
+	{
+		entry = (RelationSyncEntry *) hash_search(RelationSyncCache, &relid,
+												  HASH_FIND, NULL);
+		if (entry != NULL)
+		{
+			entry->schema_sent = false;
+			list_free(entry->streamed_txns);
+			entry->streamed_txns = NIL;
+			entry->replicate_valid = false;
+		}
+	}
+	else
+	{
+		/* Whole cache must be flushed. */
+		HASH_SEQ_STATUS status;
+
+		hash_seq_init(&status, RelationSyncCache);
+		while ((entry = (RelationSyncEntry *) hash_seq_search(&status)) != NULL)
+		{
+			entry->schema_sent = false;
+			list_free(entry->streamed_txns);
+			entry->streamed_txns = NIL;
+			entry->replicate_valid = false;
+		}
+	}
+}
+
+/*
+ * Publication relation map syscache invalidation callback
+ */
+static void
+rel_sync_cache_publication_cb(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	RelationSyncEntry *entry;
+
+	/*
+	 * We can get here if the plugin was used in SQL interface as the
+	 * RelSchemaSyncCache is destroyed when the decoding finishes, but there
+	 * is no way to unregister the relcache invalidation callback.
+	 */
+	if (RelationSyncCache == NULL)
+		return;
+
+	/*
+	 * There is no way to find which entry in our cache the hash belongs to so
+	 * mark the whole cache as invalid.
+	 */
+	hash_seq_init(&status, RelationSyncCache);
+	while ((entry = (RelationSyncEntry *) hash_seq_search(&status)) != NULL)
+		entry->replicate_valid = false;
+}
@@ -72,6 +72,7 @@ Node *replication_parse_result;
 %token K_MAX_RATE
 %token K_WAL
 %token K_TABLESPACE_MAP
+%token K_COMPRESSION
 %token K_TIMELINE
 %token K_PHYSICAL
 %token K_LOGICAL
@@ -178,6 +179,11 @@ base_backup_opt:
 				  $$ = makeDefElem("tablespace_map",
 								   (Node *)makeInteger(TRUE));
 				}
+			| K_COMPRESSION SCONST
+				{
+				  $$ = makeDefElem("compression",
+								   (Node *)makeString($2));
+				}
 			;
 
 create_replication_slot:
@@ -29,11 +29,15 @@
  * single ordered queue of waiting backends, so that we can avoid
  * searching the through all waiters each time we receive a reply.
  *
- * In 9.1 we support only a single synchronous standby, chosen from a
- * priority list of synchronous_standby_names. Before it can become the
- * synchronous standby it must have caught up with the primary; that may
- * take some time. Once caught up, the current highest priority standby
- * will release waiters from the queue.
+ * The standbys to wait for are listed in synchronous_standby_names, in one
+ * of two ways.  With priority-based synchronous replication, "FIRST k (...)"
+ * or just a plain list, the k standbys listed earliest among those connected
+ * are synchronous, and a commit waits for all of them.  With quorum-based
+ * synchronous replication, "ANY k (...)", every listed standby is a
+ * candidate, and a commit waits for whichever k of them acknowledge it
+ * first; so a single slow standby doesn't hold up commits.  Before a standby
+ * can become synchronous it must have caught up with the primary; that may
+ * take some time.
  *
  * Portions Copyright (c) 2010-2015, PostgreSQL Global Development Group
  *
@@ -44,10 +48,12 @@
  */
 #include "postgres.h"
 
+#include <ctype.h>
 #include <unistd.h>
 
 #include "access/xact.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "replication/syncrep.h"
 #include "replication/walsender.h"
 #include "replication/walsender_private.h"
@@ -60,6 +66,9 @@
 /* User-settable parameters for sync rep */
 char	   *SyncRepStandbyNames;
 
+/* Parsed synchronous_standby_names, or NULL if it's empty */
+SyncRepConfigData *SyncRepConfig = NULL;
+
 #define SyncStandbysDefined() \
 	(SyncRepStandbyNames != NULL && SyncRepStandbyNames[0] != '\0')
 
@@ -72,6 +81,12 @@ static void SyncRepCancelWait(void);
 static int	SyncRepWakeQueue(bool all, int mode);
 
 static int	SyncRepGetStandbyPriority(void);
+static bool SyncRepGetSyncRecPtr(XLogRecPtr *writePtr, XLogRecPtr *flushPtr,
+					 bool *am_sync);
+static int	standby_priority_cmp(const void *a, const void *b);
+static int	lsn_desc_cmp(const void *a, const void *b);
+static SyncRepConfigData *SyncRepParseConfig(const char *value,
+				   const char **errdetail);
 
 #ifdef USE_ASSERT_CHECKING
 static bool SyncRepQueueIsOrderedByLSN(int mode);
@@ -236,7 +251,8 @@ SyncRepWaitForLSN(XLogRecPtr XactCommitLSN)
 		 * Wait on latch.  Any condition that should wake us up will set the
 		 * latch, so no need for timeout.
 		 */
-		WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, -1);
+		WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, -1,
+				  WAIT_EVENT_SYNC_REP);
 	}
 
 	/*
@@ -348,19 +364,44 @@ SyncRepInitConfig(void)
 	}
 }
 
+/* A potential synchronous standby; see SyncRepGetSyncStandbys */
+typedef struct
+{
+	int			walsnd_index;	/* index into WalSndCtl->walsnds */
+	int			priority;		/* its sync_standby_priority */
+} SyncRepStandby;
+
 /*
- * Find the WAL sender servicing the synchronous standby with the lowest
- * priority value, or NULL if no synchronous standby is connected. If there
- * are multiple standbys with the same lowest priority value, the first one
- * found is selected. The caller must hold SyncRepLock.
+ * Return the list of synchronous standbys, as indexes into
+ * WalSndCtl->walsnds, or NIL if there are none.
+ *
+ * With priority-based synchronous replication these are the num_sync
+ * connected standbys with the lowest priority values; if several have the
+ * same priority, those that come first in WalSndCtl->walsnds win.  With
+ * quorum-based synchronous replication, all connected standbys that are
+ * listed in synchronous_standby_names are returned, as any of them can
+ * confirm a commit.
+ *
+ * If am_sync is not NULL, *am_sync is set to whether our own walsender is
+ * among them.  The caller must hold SyncRepLock.
  */
-WalSnd *
-SyncRepGetSynchronousStandby(void)
+List *
+SyncRepGetSyncStandbys(bool *am_sync)
 {
-	WalSnd	   *result = NULL;
-	int			result_priority = 0;
+	List	   *result = NIL;
+	SyncRepStandby *standbys;
+	int			nstandbys = 0;
 	int			i;
 
+	if (am_sync != NULL)
+		*am_sync = false;
+
+	/* Quick exit if sync replication is not requested */
+	if (SyncRepConfig == NULL)
+		return NIL;
+
+	standbys = (SyncRepStandby *) palloc(max_wal_senders * sizeof(SyncRepStandby));
+
 	for (i = 0; i < max_wal_senders; i++)
 	{
 		/* Use volatile pointer to prevent code rearrangement */
@@ -380,40 +421,165 @@ SyncRepGetSynchronousStandby(void)
 		if (this_priority == 0)
 			continue;
 
-		/* Must have a lower priority value than any previous ones */
-		if (result != NULL && result_priority <= this_priority)
-			continue;
-
 		/* Must have a valid flush position */
 		if (XLogRecPtrIsInvalid(walsnd->flush))
 			continue;
 
-		result = (WalSnd *) walsnd;
-		result_priority = this_priority;
+		standbys[nstandbys].walsnd_index = i;
+		standbys[nstandbys].priority = this_priority;
+		nstandbys++;
+	}
 
-		/*
-		 * If priority is equal to 1, there cannot be any other WAL senders
-		 * with a lower priority, so we're done.
-		 */
-		if (this_priority == 1)
-			return result;
+	if (SyncRepConfig->syncrep_method == SYNC_REP_PRIORITY)
+	{
+		qsort(standbys, nstandbys, sizeof(SyncRepStandby),
+			  standby_priority_cmp);
+		if (nstandbys > SyncRepConfig->num_sync)
+			nstandbys = SyncRepConfig->num_sync;
+	}
+
+	for (i = 0; i < nstandbys; i++)
+	{
+		int			walsnd_index = standbys[i].walsnd_index;
+
+		result = lappend_int(result, walsnd_index);
+		if (am_sync != NULL && &WalSndCtl->walsnds[walsnd_index] == MyWalSnd)
+			*am_sync = true;
 	}
 
+	pfree(standbys);
+
 	return result;
 }
 
 /*
- * Update the LSNs on each queue based upon our latest state. This
- * implements a simple policy of first-valid-standby-releases-waiter.
+ * Calculate the synchronous write and flush positions: the positions that
+ * enough synchronous standbys have confirmed for commits up to them to be
+ * released.
+ *
+ * With priority-based synchronous replication that's the oldest position
+ * among the synchronous standbys, as every one of them has to confirm.
+ * With quorum-based synchronous replication it's the num_sync'th newest
+ * position among the candidates, which is what the fastest num_sync of them
+ * have all confirmed.
  *
- * Other policies are possible, which would change what we do here and
- * perhaps also which information we store as well.
+ * Returns false, and sets *am_sync, if our walsender is not synchronous or
+ * there are not enough synchronous standbys connected.  The caller must hold
+ * SyncRepLock.
+ */
+static bool
+SyncRepGetSyncRecPtr(XLogRecPtr *writePtr, XLogRecPtr *flushPtr,
+					 bool *am_sync)
+{
+	List	   *sync_standbys;
+	XLogRecPtr *write_array;
+	XLogRecPtr *flush_array;
+	ListCell   *cell;
+	int			len;
+	int			i;
+
+	*writePtr = InvalidXLogRecPtr;
+	*flushPtr = InvalidXLogRecPtr;
+
+	sync_standbys = SyncRepGetSyncStandbys(am_sync);
+	len = list_length(sync_standbys);
+
+	if (!(*am_sync) || len < SyncRepConfig->num_sync)
+	{
+		list_free(sync_standbys);
+		return false;
+	}
+
+	write_array = (XLogRecPtr *) palloc(len * sizeof(XLogRecPtr));
+	flush_array = (XLogRecPtr *) palloc(len * sizeof(XLogRecPtr));
+
+	i = 0;
+	foreach(cell, sync_standbys)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile WalSnd *walsnd = &WalSndCtl->walsnds[lfirst_int(cell)];
+
+		SpinLockAcquire(&walsnd->mutex);
+		write_array[i] = walsnd->write;
+		flush_array[i] = walsnd->flush;
+		SpinLockRelease(&walsnd->mutex);
+		i++;
+	}
+
+	if (SyncRepConfig->syncrep_method == SYNC_REP_PRIORITY)
+	{
+		*writePtr = write_array[0];
+		*flushPtr = flush_array[0];
+		for (i = 1; i < len; i++)
+		{
+			if (write_array[i] < *writePtr)
+				*writePtr = write_array[i];
+			if (flush_array[i] < *flushPtr)
+				*flushPtr = flush_array[i];
+		}
+	}
+	else
+	{
+		qsort(write_array, len, sizeof(XLogRecPtr), lsn_desc_cmp);
+		qsort(flush_array, len, sizeof(XLogRecPtr), lsn_desc_cmp);
+		*writePtr = write_array[SyncRepConfig->num_sync - 1];
+		*flushPtr = flush_array[SyncRepConfig->num_sync - 1];
+	}
+
+	pfree(write_array);
+	pfree(flush_array);
+	list_free(sync_standbys);
+
+	return true;
+}
+
+/*
+ * qsort comparator to sort SyncRepStandbys by priority, and those with the
+ * same priority by their position in WalSndCtl->walsnds.
+ */
+static int
+standby_priority_cmp(const void *a, const void *b)
+{
+	const SyncRepStandby *sa = (const SyncRepStandby *) a;
+	const SyncRepStandby *sb = (const SyncRepStandby *) b;
+
+	if (sa->priority != sb->priority)
+		return (sa->priority < sb->priority) ? -1 : 1;
+	if (sa->walsnd_index != sb->walsnd_index)
+		return (sa->walsnd_index < sb->walsnd_index) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * qsort comparator to sort XLogRecPtrs in descending order.
+ */
+static int
+lsn_desc_cmp(const void *a, const void *b)
+{
+	XLogRecPtr	lsn1 = *((const XLogRecPtr *) a);
+	XLogRecPtr	lsn2 = *((const XLogRecPtr *) b);
+
+	if (lsn1 > lsn2)
+		return -1;
+	else if (lsn1 == lsn2)
+		return 0;
+	else
+		return 1;
+}
+
+/*
+ * Update the LSNs on each queue based upon our latest state, and release
+ * the waiters that enough synchronous standbys have now confirmed.
  */
 void
 SyncRepReleaseWaiters(void)
 {
 	volatile WalSndCtlData *walsndctl = WalSndCtl;
-	WalSnd	   *syncWalSnd;
+	XLogRecPtr	writePtr;
+	XLogRecPtr	flushPtr;
+	bool		got_recptr;
+	bool		advanced;
+	bool		am_sync;
 	int			numwrite = 0;
 	int			numflush = 0;
 
@@ -426,60 +592,75 @@ SyncRepReleaseWaiters(void)
 	if (MyWalSnd->sync_standby_priority == 0 ||
 		MyWalSnd->state < WALSNDSTATE_STREAMING ||
 		XLogRecPtrIsInvalid(MyWalSnd->flush))
+	{
+		announce_next_takeover = true;
 		return;
+	}
 
 	/*
-	 * We're a potential sync standby. Release waiters if we are the highest
-	 * priority standby.
+	 * Most replies don't move the synchronous positions: in quorum mode,
+	 * replies from all but the num_sync'th fastest standby don't, and in
+	 * priority mode neither do replies from the potential standbys.  Find
+	 * out with just a shared lock first, so that such replies don't
+	 * contend with the backends queueing up to wait.
 	 */
-	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
-	syncWalSnd = SyncRepGetSynchronousStandby();
-
-	/* We should have found ourselves at least */
-	Assert(syncWalSnd != NULL);
+	LWLockAcquire(SyncRepLock, LW_SHARED);
+	got_recptr = SyncRepGetSyncRecPtr(&writePtr, &flushPtr, &am_sync);
+	advanced = got_recptr &&
+		(walsndctl->lsn[SYNC_REP_WAIT_WRITE] < writePtr ||
+		 walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < flushPtr);
+	LWLockRelease(SyncRepLock);
 
 	/*
-	 * If we aren't managing the highest priority standby then just leave.
+	 * If we are managing a sync standby, though we weren't prior to this,
+	 * then announce we are now a sync standby.
 	 */
-	if (syncWalSnd != MyWalSnd)
+	if (announce_next_takeover && am_sync)
 	{
-		LWLockRelease(SyncRepLock);
+		announce_next_takeover = false;
+
+		if (SyncRepConfig->syncrep_method == SYNC_REP_PRIORITY)
+			ereport(LOG,
+					(errmsg("standby \"%s\" is now a synchronous standby with priority %u",
+							application_name, MyWalSnd->sync_standby_priority)));
+		else
+			ereport(LOG,
+					(errmsg("standby \"%s\" is now a candidate for quorum synchronous standby",
+							application_name)));
+	}
+	else if (!am_sync)
 		announce_next_takeover = true;
+
+	if (!advanced)
 		return;
-	}
 
 	/*
-	 * Set the lsn first so that when we wake backends they will release up to
-	 * this location.
+	 * The positions may have moved on while we weren't holding the lock, so
+	 * compute them again.
 	 */
-	if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] < MyWalSnd->write)
-	{
-		walsndctl->lsn[SYNC_REP_WAIT_WRITE] = MyWalSnd->write;
-		numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE);
-	}
-	if (walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < MyWalSnd->flush)
+	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
+	if (SyncRepGetSyncRecPtr(&writePtr, &flushPtr, &am_sync))
 	{
-		walsndctl->lsn[SYNC_REP_WAIT_FLUSH] = MyWalSnd->flush;
-		numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH);
+		/*
+		 * Set the lsn first so that when we wake backends they will release
+		 * up to this location.
+		 */
+		if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] < writePtr)
+		{
+			walsndctl->lsn[SYNC_REP_WAIT_WRITE] = writePtr;
+			numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE);
+		}
+		if (walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < flushPtr)
+		{
+			walsndctl->lsn[SYNC_REP_WAIT_FLUSH] = flushPtr;
+			numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH);
+		}
 	}
-
 	LWLockRelease(SyncRepLock);
 
 	elog(DEBUG3, "released %d procs up to write %X/%X, %d procs up to flush %X/%X",
-		 numwrite, (uint32) (MyWalSnd->write >> 32), (uint32) MyWalSnd->write,
-	   numflush, (uint32) (MyWalSnd->flush >> 32), (uint32) MyWalSnd->flush);
-
-	/*
-	 * If we are managing the highest priority standby, though we weren't
-	 * prior to this, then announce we are now the sync standby.
-	 */
-	if (announce_next_takeover)
-	{
-		announce_next_takeover = false;
-		ereport(LOG,
-				(errmsg("standby \"%s\" is now the synchronous standby with priority %u",
-						application_name, MyWalSnd->sync_standby_priority)));
-	}
+		 numwrite, (uint32) (writePtr >> 32), (uint32) writePtr,
+		 numflush, (uint32) (flushPtr >> 32), (uint32) flushPtr);
 }
 
 /*
@@ -489,14 +670,15 @@ SyncRepReleaseWaiters(void)
  *
  * Compare the parameter SyncRepStandbyNames against the application_name
  * for this WALSender, or allow any name if we find a wildcard "*".
+ *
+ * With quorum-based synchronous replication all listed standbys are equal,
+ * so they all get priority 1.
  */
 static int
 SyncRepGetStandbyPriority(void)
 {
-	char	   *rawstring;
-	List	   *elemlist;
-	ListCell   *l;
-	int			priority = 0;
+	const char *standby_name;
+	int			priority;
 	bool		found = false;
 
 	/*
@@ -506,37 +688,25 @@ SyncRepGetStandbyPriority(void)
 	if (am_cascading_walsender)
 		return 0;
 
-	/* Need a modifiable copy of string */
-	rawstring = pstrdup(SyncRepStandbyNames);
-
-	/* Parse string into list of identifiers */
-	if (!SplitIdentifierString(rawstring, ',', &elemlist))
-	{
-		/* syntax error in list */
-		pfree(rawstring);
-		list_free(elemlist);
-		/* GUC machinery will have already complained - no need to do again */
+	if (!SyncStandbysDefined() || SyncRepConfig == NULL)
 		return 0;
-	}
 
-	foreach(l, elemlist)
+	standby_name = SyncRepConfig->member_names;
+	for (priority = 1; priority <= SyncRepConfig->nmembers; priority++)
 	{
-		char	   *standby_name = (char *) lfirst(l);
-
-		priority++;
-
 		if (pg_strcasecmp(standby_name, application_name) == 0 ||
-			pg_strcasecmp(standby_name, "*") == 0)
+			strcmp(standby_name, "*") == 0)
 		{
 			found = true;
 			break;
 		}
+		standby_name += strlen(standby_name) + 1;
 	}
 
-	pfree(rawstring);
-	list_free(elemlist);
+	if (!found)
+		return 0;
 
-	return (found ? priority : 0);
+	return (SyncRepConfig->syncrep_method == SYNC_REP_PRIORITY) ? priority : 1;
 }
 
 /*
@@ -684,39 +854,184 @@ SyncRepQueueIsOrderedByLSN(int mode)
  * ===========================================================
  */
 
-bool
-check_synchronous_standby_names(char **newval, void **extra, GucSource source)
+/*
+ * Parse a non-empty synchronous_standby_names value.  It's one of
+ *
+ *		standby_name [, ...]
+ *		[FIRST] num_sync ( standby_name [, ...] )
+ *		ANY num_sync ( standby_name [, ...] )
+ *
+ * where the first form means FIRST 1.  Returns the result in a malloc'd
+ * SyncRepConfigData, or NULL with *errdetail set if the value is invalid.
+ */
+static SyncRepConfigData *
+SyncRepParseConfig(const char *value, const char **errdetail)
 {
+	SyncRepConfigData *config;
+	const char *p = value;
+	uint8		syncrep_method = SYNC_REP_PRIORITY;
+	bool		has_method = true;
+	long		num_sync = 1;
 	char	   *rawstring;
 	List	   *elemlist;
+	ListCell   *l;
+	Size		size;
+	char	   *ptr;
+
+	while (isspace((unsigned char) *p))
+		p++;
+
+	if (pg_strncasecmp(p, "ANY", 3) == 0 && isspace((unsigned char) p[3]))
+	{
+		syncrep_method = SYNC_REP_QUORUM;
+		p += 3;
+	}
+	else if (pg_strncasecmp(p, "FIRST", 5) == 0 && isspace((unsigned char) p[5]))
+		p += 5;
+	else
+		has_method = false;
+
+	while (isspace((unsigned char) *p))
+		p++;
 
-	/* Need a modifiable copy of string */
-	rawstring = pstrdup(*newval);
+	/*
+	 * A number followed by a parenthesized list is the number of synchronous
+	 * standbys.  Anything else without a method keyword is a plain list.
+	 */
+	if (isdigit((unsigned char) *p))
+	{
+		char	   *endptr;
+		const char *q;
+
+		errno = 0;
+		num_sync = strtol(p, &endptr, 10);
+		q = endptr;
+		while (isspace((unsigned char) *q))
+			q++;
+
+		if (*q == '(')
+		{
+			if (errno == ERANGE || num_sync > INT_MAX)
+			{
+				*errdetail = gettext_noop("Number of synchronous standbys is out of range.");
+				return NULL;
+			}
+			p = q;
+		}
+		else if (has_method)
+		{
+			*errdetail = gettext_noop("Expected a parenthesized list of standby names after the number of synchronous standbys.");
+			return NULL;
+		}
+		else
+			num_sync = 1;
+	}
+	else if (has_method)
+	{
+		*errdetail = gettext_noop("Expected the number of synchronous standbys.");
+		return NULL;
+	}
+
+	if (*p == '(')
+	{
+		const char *end = p + strlen(p);
+
+		/* the list must be closed by the last non-blank character */
+		while (end > p + 1 && isspace((unsigned char) end[-1]))
+			end--;
+		if (end[-1] != ')' || end == p + 1)
+		{
+			*errdetail = gettext_noop("Missing closing parenthesis.");
+			return NULL;
+		}
+		rawstring = pnstrdup(p + 1, end - p - 2);
+	}
+	else
+		rawstring = pstrdup(p);
+
+	if (num_sync <= 0)
+	{
+		*errdetail = gettext_noop("Number of synchronous standbys must be greater than zero.");
+		pfree(rawstring);
+		return NULL;
+	}
 
 	/* Parse string into list of identifiers */
 	if (!SplitIdentifierString(rawstring, ',', &elemlist))
 	{
 		/* syntax error in list */
-		GUC_check_errdetail("List syntax is invalid.");
+		*errdetail = gettext_noop("List syntax is invalid.");
 		pfree(rawstring);
 		list_free(elemlist);
-		return false;
+		return NULL;
 	}
 
-	/*
-	 * Any additional validation of standby names should go here.
-	 *
-	 * Don't attempt to set WALSender priority because this is executed by
-	 * postmaster at startup, not WALSender, so the application_name is not
-	 * yet correctly set.
-	 */
+	/* Compute space needed for flat representation */
+	size = offsetof(SyncRepConfigData, member_names);
+	foreach(l, elemlist)
+		size += strlen((char *) lfirst(l)) + 1;
+
+	/* GUC extra data must be malloc'd, not palloc'd */
+	config = (SyncRepConfigData *) malloc(size);
+	if (config != NULL)
+	{
+		config->config_size = size;
+		config->num_sync = (int) num_sync;
+		config->syncrep_method = syncrep_method;
+		config->nmembers = list_length(elemlist);
+		ptr = config->member_names;
+		foreach(l, elemlist)
+		{
+			strcpy(ptr, (char *) lfirst(l));
+			ptr += strlen(ptr) + 1;
+		}
+	}
+	else
+		*errdetail = gettext_noop("Out of memory.");
 
 	pfree(rawstring);
 	list_free(elemlist);
 
+	return config;
+}
+
+bool
+check_synchronous_standby_names(char **newval, void **extra, GucSource source)
+{
+	if (*newval != NULL && (*newval)[0] != '\0')
+	{
+		SyncRepConfigData *config;
+		const char *errdetail = NULL;
+
+		config = SyncRepParseConfig(*newval, &errdetail);
+		if (config == NULL)
+		{
+			GUC_check_errdetail("%s", _(errdetail));
+			return false;
+		}
+
+		/*
+		 * Any additional validation of standby names should go here.
+		 *
+		 * Don't attempt to set WALSender priority because this is executed
+		 * by postmaster at startup, not WALSender, so the application_name is
+		 * not yet correctly set.
+		 */
+
+		*extra = (void *) config;
+	}
+	else
+		*extra = NULL;
+
 	return true;
 }
 
+void
+assign_synchronous_standby_names(const char *newval, void *extra)
+{
+	SyncRepConfig = (SyncRepConfigData *) extra;
+}
+
 void
 assign_synchronous_commit(int newval, void *extra)
 {
@@ -55,6 +55,7 @@
 #include "libpq/pqformat.h"
 #include "miscadmin.h"
 #include "nodes/replnodes.h"
+#include "pgstat.h"
 #include "replication/basebackup.h"
 #include "replication/decode.h"
 #include "replication/logical.h"
@@ -183,6 +184,40 @@ static volatile sig_atomic_t replication_active = false;
 static LogicalDecodingContext *logical_decoding_ctx = NULL;
 static XLogRecPtr logical_startptr = InvalidXLogRecPtr;
 
+/*
+ * To measure the write, flush and apply lag of the standby, we remember when
+ * we sent each WAL location, and look that up when the standby reports the
+ * location written, flushed or applied.  The samples go into a circular
+ * buffer with a separate read head for each of the three; if the slowest
+ * of them falls a whole buffer behind, we stop taking samples until it
+ * catches up, which only makes the lag appear a little larger.
+ */
+#define LAG_TRACKER_WRITE_HEAD	0
+#define LAG_TRACKER_FLUSH_HEAD	1
+#define LAG_TRACKER_APPLY_HEAD	2
+#define LAG_TRACKER_NUM_READ_HEADS	3
+
+#define LAG_TRACKER_BUFFER_SIZE 8192
+
+typedef struct
+{
+	XLogRecPtr	lsn;
+	TimestampTz time;
+} WalTimeSample;
+
+typedef struct
+{
+	XLogRecPtr	last_lsn;
+	WalTimeSample buffer[LAG_TRACKER_BUFFER_SIZE];
+	int			write_head;
+	int			read_heads[LAG_TRACKER_NUM_READ_HEADS];
+} LagTracker;
+
+static LagTracker lag_tracker;
+
+/* did the standby report everything sent as applied in its last reply? */
+static bool fullyAppliedLastTime = false;
+
 /* Signal handlers */
 static void WalSndSigHupHandler(SIGNAL_ARGS);
 static void WalSndXLogSendHandler(SIGNAL_ARGS);
@@ -210,6 +245,7 @@ static void ProcessRepliesIfAny(void);
 static void WalSndKeepalive(bool requestReply);
 static void WalSndKeepaliveIfNecessary(TimestampTz now);
 static void WalSndCheckTimeOut(TimestampTz now);
+static void WalSndWait(uint32 socket_events, long timeout, uint32 wait_event);
 static long WalSndComputeSleeptime(TimestampTz now);
 static void WalSndPrepareWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
 static void WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
@@ -217,6 +253,10 @@ static XLogRecPtr WalSndWaitForWal(XLogRecPtr loc);
 
 static void XLogRead(char *buf, XLogRecPtr startptr, Size count);
 
+static void LagTrackerWrite(XLogRecPtr lsn, TimestampTz local_time);
+static int64 LagTrackerRead(int head, XLogRecPtr lsn, TimestampTz now);
+static Datum offset_to_interval(int64 offset);
+
 
 /* Initialize walsender process before entering the main command loop */
 void
@@ -252,6 +292,7 @@ void
 WalSndErrorCleanup()
 {
 	LWLockReleaseAll();
+	pgstat_report_wait_end();
 
 	if (sendFile >= 0)
 	{
@@ -1088,7 +1129,6 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 
 	for (;;)
 	{
-		int			wakeEvents;
 		long		sleeptime;
 		TimestampTz now;
 
@@ -1133,12 +1173,9 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 
 		sleeptime = WalSndComputeSleeptime(now);
 
-		wakeEvents = WL_LATCH_SET | WL_POSTMASTER_DEATH |
-			WL_SOCKET_WRITEABLE | WL_SOCKET_READABLE | WL_TIMEOUT;
-
 		/* Sleep until something happens or we time out */
-		WaitLatchOrSocket(MyLatch, wakeEvents,
-						  MyProcPort->sock, sleeptime);
+		WalSndWait(WL_SOCKET_WRITEABLE | WL_SOCKET_READABLE, sleeptime,
+				   WAIT_EVENT_WAL_SENDER_WRITE_DATA);
 	}
 
 	/* reactivate latch so WalSndLoop knows to continue */
@@ -1256,15 +1293,13 @@ WalSndWaitForWal(XLogRecPtr loc)
 
 		sleeptime = WalSndComputeSleeptime(now);
 
-		wakeEvents = WL_LATCH_SET | WL_POSTMASTER_DEATH |
-			WL_SOCKET_READABLE | WL_TIMEOUT;
+		wakeEvents = WL_SOCKET_READABLE;
 
 		if (pq_is_send_pending())
 			wakeEvents |= WL_SOCKET_WRITEABLE;
 
 		/* Sleep until something happens or we time out */
-		WaitLatchOrSocket(MyLatch, wakeEvents,
-						  MyProcPort->sock, sleeptime);
+		WalSndWait(wakeEvents, sleeptime, WAIT_EVENT_WAL_SENDER_WAIT_WAL);
 	}
 
 	/* reactivate latch so WalSndLoop knows to continue */
@@ -1540,6 +1575,11 @@ ProcessStandbyReplyMessage(void)
 				flushPtr,
 				applyPtr;
 	bool		replyRequested;
+	int64		writeLag,
+				flushLag,
+				applyLag;
+	bool		clearLagTimes;
+	TimestampTz now;
 
 	/* the caller already consumed the msgtype byte */
 	writePtr = pq_getmsgint64(&reply_message);
@@ -1558,6 +1598,28 @@ ProcessStandbyReplyMessage(void)
 	if (replyRequested)
 		WalSndKeepalive(false);
 
+	/* See if we can compute the round-trip lag for these positions. */
+	now = GetCurrentTimestamp();
+	writeLag = LagTrackerRead(LAG_TRACKER_WRITE_HEAD, writePtr, now);
+	flushLag = LagTrackerRead(LAG_TRACKER_FLUSH_HEAD, flushPtr, now);
+	applyLag = LagTrackerRead(LAG_TRACKER_APPLY_HEAD, applyPtr, now);
+
+	/*
+	 * If the standby reports that it has applied everything we sent in two
+	 * consecutive replies, the second one must be a periodic status update
+	 * from an idle standby.  Forget the lag measured for the last WAL it got,
+	 * rather than show it until more WAL is sent.
+	 */
+	clearLagTimes = false;
+	if (applyPtr == sentPtr)
+	{
+		if (fullyAppliedLastTime)
+			clearLagTimes = true;
+		fullyAppliedLastTime = true;
+	}
+	else
+		fullyAppliedLastTime = false;
+
 	/*
 	 * Update shared state for this WalSender process based on reply data from
 	 * standby.
@@ -1570,6 +1632,12 @@ ProcessStandbyReplyMessage(void)
 		walsnd->write = writePtr;
 		walsnd->flush = flushPtr;
 		walsnd->apply = applyPtr;
+		if (writeLag != -1 || clearLagTimes)
+			walsnd->writeLag = writeLag;
+		if (flushLag != -1 || clearLagTimes)
+			walsnd->flushLag = flushLag;
+		if (applyLag != -1 || clearLagTimes)
+			walsnd->applyLag = applyLag;
 		SpinLockRelease(&walsnd->mutex);
 	}
 
@@ -1784,6 +1852,23 @@ WalSndCheckTimeOut(TimestampTz now)
 	}
 }
 
+/*
+ * Sleep until the client socket becomes ready for socket_events, our latch
+ * is set, the postmaster dies or timeout milliseconds pass.
+ *
+ * This uses the connection's long-lived wait event set, so that the busy
+ * loops that stream WAL don't set up and tear down a kernel wait queue on
+ * every iteration.  The caller finds out what happened by looking around.
+ */
+static void
+WalSndWait(uint32 socket_events, long timeout, uint32 wait_event)
+{
+	WaitEvent	event;
+
+	ModifyWaitEvent(FeBeWaitSet, FeBeWaitSetSocketPos, socket_events, NULL);
+	(void) WaitEventSetWait(FeBeWaitSet, timeout, &event, 1, wait_event);
+}
+
 /* Main loop of walsender process that streams the WAL over Copy messages. */
 static void
 WalSndLoop(WalSndSendDataCallback send_data)
@@ -1908,8 +1993,7 @@ WalSndLoop(WalSndSendDataCallback send_data)
 			long		sleeptime;
 			int			wakeEvents;
 
-			wakeEvents = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT |
-				WL_SOCKET_READABLE;
+			wakeEvents = WL_SOCKET_READABLE;
 
 			sleeptime = WalSndComputeSleeptime(now);
 
@@ -1917,8 +2001,7 @@ WalSndLoop(WalSndSendDataCallback send_data)
 				wakeEvents |= WL_SOCKET_WRITEABLE;
 
 			/* Sleep until something happens or we time out */
-			WaitLatchOrSocket(MyLatch, wakeEvents,
-							  MyProcPort->sock, sleeptime);
+			WalSndWait(wakeEvents, sleeptime, WAIT_EVENT_WAL_SENDER_MAIN);
 		}
 	}
 	return;
@@ -1963,6 +2046,9 @@ InitWalSenderSlot(void)
 			walsnd->write = InvalidXLogRecPtr;
 			walsnd->flush = InvalidXLogRecPtr;
 			walsnd->apply = InvalidXLogRecPtr;
+			walsnd->writeLag = -1;
+			walsnd->flushLag = -1;
+			walsnd->applyLag = -1;
 			walsnd->state = WALSNDSTATE_STARTUP;
 			walsnd->latch = &MyProc->procLatch;
 			SpinLockRelease(&walsnd->mutex);
@@ -2004,8 +2090,10 @@ WalSndKill(int code, Datum arg)
 /*
  * Read 'count' bytes from WAL into 'buf', starting at location 'startptr'
  *
- * XXX probably this should be improved to suck data directly from the
- * WAL buffers when possible.
+ * WAL that is still in WAL buffers is copied from there; only the rest is
+ * read from the segment files.  As all walsenders streaming the same recent
+ * WAL copy it from the same buffers, they don't each need to read it back
+ * from the file system.
  *
  * Will open, and keep open, one WAL segment stored in the global file
  * descriptor sendFile. This means if XLogRead is used once, there will
@@ -2019,6 +2107,18 @@ XLogRead(char *buf, XLogRecPtr startptr, Size count)
 	XLogRecPtr	recptr;
 	Size		nbytes;
 	XLogSegNo	segno;
+	Size		nbuffered;
+
+	/*
+	 * Recently flushed WAL is usually still in WAL buffers.  Take what we can
+	 * from there, and read only the remainder from the files.
+	 */
+	nbuffered = XLogReadFromBuffers(buf, startptr, count, sendTimeLine);
+	if (nbuffered == count)
+		return;
+	buf += nbuffered;
+	startptr += nbuffered;
+	count -= nbuffered;
 
 retry:
 	p = buf;
@@ -2394,6 +2494,9 @@ XLogSendPhysical(void)
 
 	sentPtr = endptr;
 
+	/* Remember when we sent this WAL, to measure the standby's lag. */
+	LagTrackerWrite(sentPtr, GetCurrentTimestamp());
+
 	/* Update shared memory status */
 	{
 		/* use volatile pointer to prevent code rearrangement */
@@ -2750,13 +2853,13 @@ WalSndGetStateString(WalSndState state)
 Datum
 pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_WAL_SENDERS_COLS	8
+#define PG_STAT_GET_WAL_SENDERS_COLS	11
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	TupleDesc	tupdesc;
 	Tuplestorestate *tupstore;
 	MemoryContext per_query_ctx;
 	MemoryContext oldcontext;
-	WalSnd	   *sync_standby;
+	List	   *sync_standbys;
 	int			i;
 
 	/* check to see if caller supports us returning a tuplestore */
@@ -2785,10 +2888,10 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 	MemoryContextSwitchTo(oldcontext);
 
 	/*
-	 * Get the currently active synchronous standby.
+	 * Get the currently active synchronous standbys.
 	 */
 	LWLockAcquire(SyncRepLock, LW_SHARED);
-	sync_standby = SyncRepGetSynchronousStandby();
+	sync_standbys = SyncRepGetSyncStandbys(NULL);
 	LWLockRelease(SyncRepLock);
 
 	for (i = 0; i < max_wal_senders; i++)
@@ -2799,6 +2902,9 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		XLogRecPtr	write;
 		XLogRecPtr	flush;
 		XLogRecPtr	apply;
+		int64		writeLag;
+		int64		flushLag;
+		int64		applyLag;
 		int			priority;
 		WalSndState state;
 		Datum		values[PG_STAT_GET_WAL_SENDERS_COLS];
@@ -2813,6 +2919,9 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		write = walsnd->write;
 		flush = walsnd->flush;
 		apply = walsnd->apply;
+		writeLag = walsnd->writeLag;
+		flushLag = walsnd->flushLag;
+		applyLag = walsnd->applyLag;
 		priority = walsnd->sync_standby_priority;
 		SpinLockRelease(&walsnd->mutex);
 
@@ -2858,14 +2967,33 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 
 			/*
 			 * More easily understood version of standby state. This is purely
-			 * informational, not different from priority.
+			 * informational.  In quorum-based sync replication, every listed
+			 * standby is a candidate that can confirm a commit.
 			 */
 			if (priority == 0)
 				values[7] = CStringGetTextDatum("async");
-			else if (walsnd == sync_standby)
+			else if (SyncRepConfig != NULL &&
+					 SyncRepConfig->syncrep_method == SYNC_REP_QUORUM)
+				values[7] = CStringGetTextDatum("quorum");
+			else if (list_member_int(sync_standbys, i))
 				values[7] = CStringGetTextDatum("sync");
 			else
 				values[7] = CStringGetTextDatum("potential");
+
+			if (writeLag < 0)
+				nulls[8] = true;
+			else
+				values[8] = offset_to_interval(writeLag);
+
+			if (flushLag < 0)
+				nulls[9] = true;
+			else
+				values[9] = offset_to_interval(flushLag);
+
+			if (applyLag < 0)
+				nulls[10] = true;
+			else
+				values[10] = offset_to_interval(applyLag);
 		}
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -2877,6 +3005,85 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Record that we've sent WAL up to 'lsn' at 'local_time'.
+ */
+static void
+LagTrackerWrite(XLogRecPtr lsn, TimestampTz local_time)
+{
+	int			new_write_head;
+	int			i;
+
+	/* Only one sample per WAL location */
+	if (lag_tracker.last_lsn == lsn)
+		return;
+
+	new_write_head = (lag_tracker.write_head + 1) % LAG_TRACKER_BUFFER_SIZE;
+
+	/* Don't overwrite samples some read head hasn't reached yet. */
+	for (i = 0; i < LAG_TRACKER_NUM_READ_HEADS; i++)
+	{
+		if (lag_tracker.read_heads[i] == new_write_head)
+			return;
+	}
+
+	lag_tracker.buffer[lag_tracker.write_head].lsn = lsn;
+	lag_tracker.buffer[lag_tracker.write_head].time = local_time;
+	lag_tracker.write_head = new_write_head;
+	lag_tracker.last_lsn = lsn;
+}
+
+/*
+ * Find out how long ago we sent the WAL the standby has now reported as
+ * written, flushed or applied up to 'lsn', depending on 'head'.
+ *
+ * Returns the lag in microseconds, or -1 if the standby hasn't got as far
+ * as another sample since the last call.
+ */
+static int64
+LagTrackerRead(int head, XLogRecPtr lsn, TimestampTz now)
+{
+	TimestampTz time = 0;
+	bool		found = false;
+	long		secs;
+	int			usecs;
+
+	while (lag_tracker.read_heads[head] != lag_tracker.write_head &&
+		   lag_tracker.buffer[lag_tracker.read_heads[head]].lsn <= lsn)
+	{
+		time = lag_tracker.buffer[lag_tracker.read_heads[head]].time;
+		found = true;
+		lag_tracker.read_heads[head] =
+			(lag_tracker.read_heads[head] + 1) % LAG_TRACKER_BUFFER_SIZE;
+	}
+
+	if (!found)
+		return -1;
+
+	TimestampDifference(time, now, &secs, &usecs);
+
+	return (int64) secs * USECS_PER_SEC + usecs;
+}
+
+/*
+ * Convert a lag in microseconds to an interval datum.
+ */
+static Datum
+offset_to_interval(int64 offset)
+{
+	Interval   *result = (Interval *) palloc(sizeof(Interval));
+
+	result->month = 0;
+	result->day = 0;
+#ifdef HAVE_INT64_TIMESTAMP
+	result->time = offset;
+#else
+	result->time = offset / (double) USECS_PER_SEC;
+#endif
+
+	return IntervalPGetDatum(result);
+}
+
 /*
   * This function is used to send keepalive message to standby.
   * If requestReply is set, sets a flag in the message requesting the standby
@@ -0,0 +1,845 @@
+/*-------------------------------------------------------------------------
+ *
+ * extended_stats.c
+ *	  POSTGRES extended statistics
+ *
+ * Generic code supporting statistics objects created via CREATE STATISTICS.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/statistics/extended_stats.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "catalog/indexing.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_statistic_ext.h"
+#include "catalog/pg_type.h"
+#include "commands/vacuum.h"
+#include "nodes/relation.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
+#include "statistics/extended_stats_internal.h"
+#include "statistics/statistics.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/selfuncs.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+
+
+/*
+ * Used internally to refer to an individual statistics object, i.e.,
+ * a pg_statistic_ext entry.
+ */
+typedef struct StatExtEntry
+{
+	Oid			statOid;		/* OID of pg_statistic_ext entry */
+	char	   *schema;			/* statistics object's schema */
+	char	   *name;			/* statistics object's name */
+	int			ncolumns;		/* number of columns covered */
+	AttrNumber	columns[STATS_MAX_DIMENSIONS];	/* the columns, ascending */
+	List	   *types;			/* 'char' list of enabled statistic kinds */
+} StatExtEntry;
+
+
+static List *fetch_statentries_for_relation(Relation pg_statext, Oid relid);
+static StatsBuildData *build_stats_data(Relation onerel, StatExtEntry *stat,
+				 int numrows, HeapTuple *rows, int *stattarget);
+static void statext_store(Relation pg_stext, Oid relid,
+			  MVNDistinct *ndistinct, MVDependencies *dependencies,
+			  MCVList *mcv);
+static Selectivity statext_mcv_clauselist_selectivity(PlannerInfo *root,
+								   List *clauses, int varRelid,
+								   JoinType jointype,
+								   SpecialJoinInfo *sjinfo,
+								   RelOptInfo *rel,
+								   Bitmapset **estimatedclauses);
+
+
+/*
+ * Compute requested extended stats, using the rows sampled for the plain
+ * (single-column) stats.
+ *
+ * This fetches a list of stats types from pg_statistic_ext, computes the
+ * requested stats, and serializes them back into the catalog.
+ */
+void
+BuildRelationExtStatistics(Relation onerel, double totalrows,
+						   int numrows, HeapTuple *rows)
+{
+	Relation	pg_stext;
+	ListCell   *lc;
+	List	   *stats;
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+
+	pg_stext = heap_open(StatisticExtRelationId, RowExclusiveLock);
+	stats = fetch_statentries_for_relation(pg_stext, RelationGetRelid(onerel));
+
+	if (stats == NIL)
+	{
+		heap_close(pg_stext, RowExclusiveLock);
+		return;
+	}
+
+	cxt = AllocSetContextCreate(CurrentMemoryContext,
+								"BuildRelationExtStatistics",
+								ALLOCSET_DEFAULT_MINSIZE,
+								ALLOCSET_DEFAULT_INITSIZE,
+								ALLOCSET_DEFAULT_MAXSIZE);
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	foreach(lc, stats)
+	{
+		StatExtEntry *stat = (StatExtEntry *) lfirst(lc);
+		MVNDistinct *ndistinct = NULL;
+		MVDependencies *dependencies = NULL;
+		MCVList    *mcv = NULL;
+		StatsBuildData *data;
+		int			stattarget;
+		ListCell   *lc2;
+
+		data = build_stats_data(onerel, stat, numrows, rows, &stattarget);
+
+		/*
+		 * A statistics target of zero disables the statistics of the columns
+		 * involved; honor that for the extended statistics too.
+		 */
+		if (stattarget > 0)
+		{
+			/* compute statistic of each requested type */
+			foreach(lc2, stat->types)
+			{
+				char		t = (char) lfirst_int(lc2);
+
+				if (t == STATS_EXT_NDISTINCT)
+					ndistinct = statext_ndistinct_build(totalrows, data);
+				else if (t == STATS_EXT_DEPENDENCIES)
+					dependencies = statext_dependencies_build(data);
+				else if (t == STATS_EXT_MCV)
+					mcv = statext_mcv_build(data, stattarget);
+			}
+		}
+
+		/* store the statistics in the catalog */
+		statext_store(pg_stext, stat->statOid, ndistinct, dependencies, mcv);
+
+		MemoryContextReset(cxt);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(cxt);
+
+	list_free(stats);
+
+	heap_close(pg_stext, RowExclusiveLock);
+}
+
+/*
+ * statext_is_kind_built
+ *		Is this stat kind built in the given pg_statistic_ext tuple?
+ */
+bool
+statext_is_kind_built(HeapTuple htup, char type)
+{
+	AttrNumber	attnum;
+
+	switch (type)
+	{
+		case STATS_EXT_NDISTINCT:
+			attnum = Anum_pg_statistic_ext_stxndistinct;
+			break;
+
+		case STATS_EXT_DEPENDENCIES:
+			attnum = Anum_pg_statistic_ext_stxdependencies;
+			break;
+
+		case STATS_EXT_MCV:
+			attnum = Anum_pg_statistic_ext_stxmcv;
+			break;
+
+		default:
+			elog(ERROR, "unexpected statistics type requested: %d", type);
+			attnum = InvalidAttrNumber; /* keep compiler quiet */
+	}
+
+	return !heap_attisnull(htup, attnum);
+}
+
+/*
+ * Return a list (of StatExtEntry) of statistics objects for the given relation.
+ */
+static List *
+fetch_statentries_for_relation(Relation pg_statext, Oid relid)
+{
+	SysScanDesc scan;
+	ScanKeyData skey;
+	HeapTuple	htup;
+	List	   *result = NIL;
+
+	/*
+	 * Prepare to scan pg_statistic_ext for entries having stxrelid = this
+	 * rel.
+	 */
+	ScanKeyInit(&skey,
+				Anum_pg_statistic_ext_stxrelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(relid));
+
+	scan = systable_beginscan(pg_statext, StatisticExtRelidIndexId, true,
+							  NULL, 1, &skey);
+
+	while (HeapTupleIsValid(htup = systable_getnext(scan)))
+	{
+		StatExtEntry *entry;
+		Datum		datum;
+		bool		isnull;
+		int			i;
+		ArrayType  *arr;
+		char	   *enabled;
+		Form_pg_statistic_ext staForm;
+
+		entry = (StatExtEntry *) palloc0(sizeof(StatExtEntry));
+		entry->statOid = HeapTupleGetOid(htup);
+		staForm = (Form_pg_statistic_ext) GETSTRUCT(htup);
+		entry->schema = get_namespace_name(staForm->stxnamespace);
+		entry->name = pstrdup(NameStr(staForm->stxname));
+		entry->ncolumns = staForm->stxkeys.dim1;
+		if (entry->ncolumns < 2 || entry->ncolumns > STATS_MAX_DIMENSIONS)
+			elog(ERROR, "invalid number of columns in statistics object %u",
+				 entry->statOid);
+		for (i = 0; i < entry->ncolumns; i++)
+			entry->columns[i] = staForm->stxkeys.values[i];
+
+		/* decode the stxkind char array into a list of chars */
+		datum = SysCacheGetAttr(STATEXTOID, htup,
+								Anum_pg_statistic_ext_stxkind, &isnull);
+		Assert(!isnull);
+		arr = DatumGetArrayTypeP(datum);
+		if (ARR_NDIM(arr) != 1 ||
+			ARR_HASNULL(arr) ||
+			ARR_ELEMTYPE(arr) != CHAROID)
+			elog(ERROR, "stxkind is not a 1-D char array");
+		enabled = (char *) ARR_DATA_PTR(arr);
+		for (i = 0; i < ARR_DIMS(arr)[0]; i++)
+		{
+			Assert((enabled[i] == STATS_EXT_NDISTINCT) ||
+				   (enabled[i] == STATS_EXT_DEPENDENCIES) ||
+				   (enabled[i] == STATS_EXT_MCV));
+			entry->types = lappend_int(entry->types, (int) enabled[i]);
+		}
+
+		result = lappend(result, entry);
+	}
+
+	systable_endscan(scan);
+
+	return result;
+}
+
+/*
+ * build_stats_data
+ *		Extract the columns of a statistics object from the sample rows.
+ *
+ * Also compute the statistics target for the object, which is the largest
+ * target of its columns, into *stattarget.  If any of the columns has its
+ * statistics disabled (target zero), the result is zero.
+ */
+static StatsBuildData *
+build_stats_data(Relation onerel, StatExtEntry *stat,
+				 int numrows, HeapTuple *rows, int *stattarget)
+{
+	TupleDesc	tupdesc = RelationGetDescr(onerel);
+	StatsBuildData *data;
+	int			ncols = stat->ncolumns;
+	int			i;
+	int			j;
+
+	data = (StatsBuildData *) palloc(sizeof(StatsBuildData));
+	data->numrows = numrows;
+	data->nattnums = ncols;
+	data->attnums = (AttrNumber *) palloc(ncols * sizeof(AttrNumber));
+	data->types = (Oid *) palloc(ncols * sizeof(Oid));
+	data->collations = (Oid *) palloc(ncols * sizeof(Oid));
+	data->ltopers = (Oid *) palloc(ncols * sizeof(Oid));
+	data->typlens = (int16 *) palloc(ncols * sizeof(int16));
+	data->typbyvals = (bool *) palloc(ncols * sizeof(bool));
+	data->values = (Datum **) palloc(ncols * sizeof(Datum *));
+	data->nulls = (bool **) palloc(ncols * sizeof(bool *));
+
+	*stattarget = -1;
+
+	for (i = 0; i < ncols; i++)
+	{
+		AttrNumber	attnum = stat->columns[i];
+		Form_pg_attribute attr = tupdesc->attrs[attnum - 1];
+		TypeCacheEntry *type;
+		int			target;
+
+		/* the dependency on the columns keeps them from being dropped */
+		Assert(!attr->attisdropped);
+
+		type = lookup_type_cache(attr->atttypid, TYPECACHE_LT_OPR);
+		if (type->lt_opr == InvalidOid)
+			elog(ERROR, "cache lookup failed for ordering operator for type %u",
+				 attr->atttypid);
+
+		data->attnums[i] = attnum;
+		data->types[i] = attr->atttypid;
+		data->collations[i] = attr->attcollation;
+		data->ltopers[i] = type->lt_opr;
+		data->typlens[i] = attr->attlen;
+		data->typbyvals[i] = attr->attbyval;
+
+		target = attr->attstattarget;
+		if (target < 0)
+			target = default_statistics_target;
+		if (target == 0)
+			*stattarget = 0;
+		else if (*stattarget != 0 && target > *stattarget)
+			*stattarget = target;
+
+		data->values[i] = (Datum *) palloc(numrows * sizeof(Datum));
+		data->nulls[i] = (bool *) palloc(numrows * sizeof(bool));
+		for (j = 0; j < numrows; j++)
+			data->values[i][j] = heap_getattr(rows[j], attnum, tupdesc,
+											  &data->nulls[i][j]);
+	}
+
+	return data;
+}
+
+/*
+ * statext_store
+ *	Serializes the statistics and stores them into the pg_statistic_ext tuple.
+ */
+static void
+statext_store(Relation pg_stext, Oid statOid,
+			  MVNDistinct *ndistinct, MVDependencies *dependencies,
+			  MCVList *mcv)
+{
+	HeapTuple	stup,
+				oldtup;
+	Datum		values[Natts_pg_statistic_ext];
+	bool		nulls[Natts_pg_statistic_ext];
+	bool		replaces[Natts_pg_statistic_ext];
+
+	memset(nulls, true, sizeof(nulls));
+	memset(replaces, false, sizeof(replaces));
+	memset(values, 0, sizeof(values));
+
+	/*
+	 * Construct a new pg_statistic_ext tuple, replacing the calculated stats.
+	 */
+	if (ndistinct != NULL)
+	{
+		bytea	   *data = statext_ndistinct_serialize(ndistinct);
+
+		nulls[Anum_pg_statistic_ext_stxndistinct - 1] = (data == NULL);
+		values[Anum_pg_statistic_ext_stxndistinct - 1] = PointerGetDatum(data);
+	}
+
+	if (dependencies != NULL)
+	{
+		bytea	   *data = statext_dependencies_serialize(dependencies);
+
+		nulls[Anum_pg_statistic_ext_stxdependencies - 1] = (data == NULL);
+		values[Anum_pg_statistic_ext_stxdependencies - 1] = PointerGetDatum(data);
+	}
+
+	if (mcv != NULL)
+	{
+		bytea	   *data = statext_mcv_serialize(mcv);
+
+		nulls[Anum_pg_statistic_ext_stxmcv - 1] = (data == NULL);
+		values[Anum_pg_statistic_ext_stxmcv - 1] = PointerGetDatum(data);
+	}
+
+	/* always replace the value (either by bytea or NULL) */
+	replaces[Anum_pg_statistic_ext_stxndistinct - 1] = true;
+	replaces[Anum_pg_statistic_ext_stxdependencies - 1] = true;
+	replaces[Anum_pg_statistic_ext_stxmcv - 1] = true;
+
+	/* there should already be a pg_statistic_ext tuple */
+	oldtup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(statOid));
+	if (!HeapTupleIsValid(oldtup))
+		elog(ERROR, "cache lookup failed for statistics object %u", statOid);
+
+	/* replace it */
+	stup = heap_modify_tuple(oldtup,
+							 RelationGetDescr(pg_stext),
+							 values,
+							 nulls,
+							 replaces);
+	ReleaseSysCache(oldtup);
+	simple_heap_update(pg_stext, &stup->t_self, stup);
+	CatalogUpdateIndexes(pg_stext, stup);
+
+	heap_freetuple(stup);
+}
+
+/* initialize multi-dimensional sort */
+MultiSortSupport
+multi_sort_init(int ndims)
+{
+	MultiSortSupport mss;
+
+	Assert(ndims >= 1);
+
+	mss = (MultiSortSupport) palloc0(offsetof(MultiSortSupportData, ssup)
+									 + sizeof(SortSupportData) * ndims);
+
+	mss->ndims = ndims;
+
+	return mss;
+}
+
+/*
+ * Prepare sort support info using the given sort operator and collation
+ * at the position 'sortdim'
+ */
+void
+multi_sort_add_dimension(MultiSortSupport mss, int sortdim,
+						 Oid oper, Oid collation)
+{
+	SortSupport ssup = &mss->ssup[sortdim];
+
+	ssup->ssup_cxt = CurrentMemoryContext;
+	ssup->ssup_collation = collation;
+	ssup->ssup_nulls_first = false;
+
+	PrepareSortSupportFromOrderingOp(oper, ssup);
+}
+
+/* compare all the dimensions in the selected order */
+int
+multi_sort_compare(const void *a, const void *b, void *arg)
+{
+	MultiSortSupport mss = (MultiSortSupport) arg;
+	const SortItem *ia = (const SortItem *) a;
+	const SortItem *ib = (const SortItem *) b;
+	int			i;
+
+	for (i = 0; i < mss->ndims; i++)
+	{
+		int			compare;
+
+		compare = ApplySortComparator(ia->values[i], ia->isnull[i],
+									  ib->values[i], ib->isnull[i],
+									  &mss->ssup[i]);
+
+		if (compare != 0)
+			return compare;
+	}
+
+	/* equal by default */
+	return 0;
+}
+
+/* compare selected dimension */
+int
+multi_sort_compare_dim(int dim, const SortItem *a, const SortItem *b,
+					   MultiSortSupport mss)
+{
+	return ApplySortComparator(a->values[dim], a->isnull[dim],
+							   b->values[dim], b->isnull[dim],
+							   &mss->ssup[dim]);
+}
+
+/* compare dimensions start .. end (inclusive) */
+int
+multi_sort_compare_dims(int start, int end,
+						const SortItem *a, const SortItem *b,
+						MultiSortSupport mss)
+{
+	int			dim;
+
+	for (dim = start; dim <= end; dim++)
+	{
+		int			r = ApplySortComparator(a->values[dim], a->isnull[dim],
+											b->values[dim], b->isnull[dim],
+											&mss->ssup[dim]);
+
+		if (r != 0)
+			return r;
+	}
+
+	return 0;
+}
+
+/*
+ * build_sorted_items
+ *		Build an array of SortItems for the sample rows, restricted to the
+ *		given columns of the statistics object, and sort it.
+ *
+ * dims[] are indexes into the columns of the statistics object; the items
+ * get the values of those columns, in that order.  The sort support data
+ * used for the sort is returned in *mss, for the caller to compare the
+ * sorted items with.
+ */
+SortItem *
+build_sorted_items(StatsBuildData *data, int ndims, const int *dims,
+				   MultiSortSupport *mss)
+{
+	SortItem   *items;
+	Datum	   *values;
+	bool	   *isnull;
+	int			i;
+	int			j;
+
+	*mss = multi_sort_init(ndims);
+	for (j = 0; j < ndims; j++)
+		multi_sort_add_dimension(*mss, j,
+								 data->ltopers[dims[j]],
+								 data->collations[dims[j]]);
+
+	/* allocate the items and the arrays of values in one go */
+	items = (SortItem *) palloc(data->numrows * sizeof(SortItem));
+	values = (Datum *) palloc(data->numrows * ndims * sizeof(Datum));
+	isnull = (bool *) palloc(data->numrows * ndims * sizeof(bool));
+
+	for (i = 0; i < data->numrows; i++)
+	{
+		items[i].values = &values[i * ndims];
+		items[i].isnull = &isnull[i * ndims];
+		items[i].count = 1;
+
+		for (j = 0; j < ndims; j++)
+		{
+			items[i].values[j] = data->values[dims[j]][i];
+			items[i].isnull[j] = data->nulls[dims[j]][i];
+		}
+	}
+
+	qsort_arg((void *) items, data->numrows, sizeof(SortItem),
+			  multi_sort_compare, *mss);
+
+	return items;
+}
+
+/*
+ * has_stats_of_kind
+ *		Check whether the list contains statistic of a given kind
+ */
+bool
+has_stats_of_kind(List *stats, char requiredkind)
+{
+	ListCell   *l;
+
+	foreach(l, stats)
+	{
+		StatisticExtInfo *stat = (StatisticExtInfo *) lfirst(l);
+
+		if (stat->kind == requiredkind)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * choose_best_statistics
+ *		Look for and return statistics with the specified 'requiredkind' which
+ *		have keys that match at least two of the given attnums.  Return NULL if
+ *		there's no match.
+ *
+ * The current selection criteria is very simple - we choose the statistics
+ * object referencing the most of the requested attributes, breaking ties
+ * in favor of objects with fewer keys overall.
+ *
+ * XXX If multiple statistics objects tie on both criteria, then which object
+ * is chosen depends on the order that they appear in the stats list. Perhaps
+ * further tiebreakers are needed.
+ */
+StatisticExtInfo *
+choose_best_statistics(List *stats, Bitmapset *attnums, char requiredkind)
+{
+	ListCell   *lc;
+	StatisticExtInfo *best_match = NULL;
+	int			best_num_matched = 2;	/* goal #1: maximize */
+	int			best_match_keys = (STATS_MAX_DIMENSIONS + 1);	/* goal #2: minimize */
+
+	foreach(lc, stats)
+	{
+		StatisticExtInfo *info = (StatisticExtInfo *) lfirst(lc);
+		int			num_matched;
+		int			numkeys;
+		Bitmapset  *matched;
+
+		/* skip statistics that are not of the correct type */
+		if (info->kind != requiredkind)
+			continue;
+
+		/* determine how many attributes of these stats can be matched to */
+		matched = bms_intersect(attnums, info->keys);
+		num_matched = bms_num_members(matched);
+		bms_free(matched);
+
+		/*
+		 * save the actual number of keys in the stats so that we can choose
+		 * the narrowest stats with the most matching keys.
+		 */
+		numkeys = bms_num_members(info->keys);
+
+		/*
+		 * Use this object when it increases the number of matched clauses or
+		 * when it matches the same number of attributes but these stats have
+		 * fewer keys than any previous match.
+		 */
+		if (num_matched > best_num_matched ||
+			(num_matched == best_num_matched && numkeys < best_match_keys))
+		{
+			best_match = info;
+			best_num_matched = num_matched;
+			best_match_keys = numkeys;
+		}
+	}
+
+	return best_match;
+}
+
+/*
+ * statext_is_compatible_clause
+ *		Determines if the clause is compatible with extended statistics.
+ *
+ * Only "Var op Const" and "Const op Var" clauses are considered, where the
+ * Var is a user column of the given base relation and the operator is
+ * estimated with eqsel() (or, unless eqonly is true, scalarltsel() or
+ * scalargtsel()), plus "Var IS [NOT] NULL" unless eqonly is true.  When
+ * returning true, the column number of the Var is stored into *attnum.
+ */
+bool
+statext_is_compatible_clause(Node *clause, Index relid, bool eqonly,
+							 AttrNumber *attnum)
+{
+	Var		   *var;
+
+	if (IsA(clause, RestrictInfo))
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) clause;
+
+		/* Pseudoconstants are not really interesting here. */
+		if (rinfo->pseudoconstant)
+			return false;
+
+		clause = (Node *) rinfo->clause;
+	}
+
+	if (is_opclause(clause) && list_length(((OpExpr *) clause)->args) == 2)
+	{
+		OpExpr	   *expr = (OpExpr *) clause;
+		Node	   *left = (Node *) linitial(expr->args);
+		Node	   *right = (Node *) lsecond(expr->args);
+		RegProcedure oprrest;
+
+		/* strip binary-compatible relabeling of the column */
+		if (IsA(left, RelabelType))
+			left = (Node *) ((RelabelType *) left)->arg;
+		if (IsA(right, RelabelType))
+			right = (Node *) ((RelabelType *) right)->arg;
+
+		if (IsA(left, Var) && IsA(right, Const))
+			var = (Var *) left;
+		else if (IsA(right, Var) && IsA(left, Const))
+			var = (Var *) right;
+		else
+			return false;
+
+		/*
+		 * If it's not one of the supported operators, bail out.  We rely on
+		 * the restriction selectivity estimator to tell us what kind of
+		 * comparison the operator does, the way clauselist_selectivity()
+		 * recognizes range clauses.
+		 */
+		oprrest = get_oprrest(expr->opno);
+		if (oprrest != F_EQSEL &&
+			(eqonly || (oprrest != F_SCALARLTSEL && oprrest != F_SCALARGTSEL)))
+			return false;
+	}
+	else if (IsA(clause, NullTest) && !eqonly)
+	{
+		NullTest   *expr = (NullTest *) clause;
+
+		if (expr->argisrow || !IsA(expr->arg, Var))
+			return false;
+
+		var = (Var *) expr->arg;
+	}
+	else
+		return false;
+
+	/* the Var must be a user column of the relation at this query level */
+	if (var->varno != relid || var->varlevelsup != 0 ||
+		!AttrNumberIsForUserDefinedAttr(var->varattno))
+		return false;
+
+	*attnum = var->varattno;
+	return true;
+}
+
+/*
+ * statext_clauselist_selectivity
+ *		Estimate clauses using the best multi-column statistics.
+ *
+ * Clauses estimated this way are marked by their position in the list in
+ * *estimatedclauses, so that the caller doesn't apply them again.  The MCV
+ * list is tried first, as it captures the actual distribution of the
+ * combinations of values; functional dependencies are then applied to
+ * whatever compatible equality clauses remain.
+ */
+Selectivity
+statext_clauselist_selectivity(PlannerInfo *root, List *clauses, int varRelid,
+							   JoinType jointype, SpecialJoinInfo *sjinfo,
+							   RelOptInfo *rel, Bitmapset **estimatedclauses)
+{
+	Selectivity sel = 1.0;
+
+	if (has_stats_of_kind(rel->statlist, STATS_EXT_MCV))
+		sel *= statext_mcv_clauselist_selectivity(root, clauses, varRelid,
+												  jointype, sjinfo, rel,
+												  estimatedclauses);
+
+	if (has_stats_of_kind(rel->statlist, STATS_EXT_DEPENDENCIES))
+		sel *= dependencies_clauselist_selectivity(root, clauses, varRelid,
+												   jointype, sjinfo, rel,
+												   estimatedclauses);
+
+	return sel;
+}
+
+/*
+ * statext_mcv_clauselist_selectivity
+ *		Estimate clauses using the best multi-column MCV list.
+ *
+ * The MCV list only describes the most common combinations of values, so it
+ * is combined with the per-column estimates: the matching MCV items give an
+ * accurate selectivity for the part of the data they cover, and whatever
+ * the per-column estimate predicts beyond the part the MCV items would
+ * account for if the columns were independent (their base frequency) is
+ * attributed to the rest of the data, which the MCV list says is at most
+ * 1 - (total frequency of the MCV items).
+ */
+static Selectivity
+statext_mcv_clauselist_selectivity(PlannerInfo *root, List *clauses,
+								   int varRelid, JoinType jointype,
+								   SpecialJoinInfo *sjinfo, RelOptInfo *rel,
+								   Bitmapset **estimatedclauses)
+{
+	ListCell   *l;
+	Bitmapset  *clauses_attnums = NULL;
+	AttrNumber *list_attnums;
+	int			listidx;
+	StatisticExtInfo *stat;
+	List	   *stat_clauses = NIL;
+	Selectivity simple_sel,
+				mcv_sel,
+				mcv_basesel,
+				mcv_totalsel,
+				other_sel,
+				sel;
+
+	/* the clauses must all be on the same rel the statistics are for */
+	if (varRelid != 0 && varRelid != (int) rel->relid)
+		return 1.0;
+
+	list_attnums = (AttrNumber *) palloc(sizeof(AttrNumber) *
+										 list_length(clauses));
+
+	/*
+	 * Pre-process the clauses list to extract the attnums seen in each item.
+	 * We need to determine if there's any clauses which will be useful for
+	 * selectivity estimations with extended stats.  Along the way we'll
+	 * record all of the attnums for each clause in a list which we'll
+	 * reference later so we don't need to repeat the same work again.
+	 */
+	listidx = 0;
+	foreach(l, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(l);
+		AttrNumber	attnum;
+
+		list_attnums[listidx] = InvalidAttrNumber;
+
+		if (!bms_is_member(listidx, *estimatedclauses) &&
+			statext_is_compatible_clause(clause, rel->relid, false, &attnum))
+		{
+			list_attnums[listidx] = attnum;
+			clauses_attnums = bms_add_member(clauses_attnums, attnum);
+		}
+
+		listidx++;
+	}
+
+	/* We need at least two attributes for multivariate statistics. */
+	if (bms_num_members(clauses_attnums) < 2)
+	{
+		pfree(list_attnums);
+		return 1.0;
+	}
+
+	/* find the best suited statistics object for these attnums */
+	stat = choose_best_statistics(rel->statlist, clauses_attnums,
+								  STATS_EXT_MCV);
+
+	/* if no matching stats could be found then we've nothing to do */
+	if (!stat)
+	{
+		pfree(list_attnums);
+		return 1.0;
+	}
+
+	/*
+	 * Collect the clauses covered by the statistics object, and compute
+	 * their selectivity the usual way, assuming independence.
+	 */
+	simple_sel = 1.0;
+	listidx = 0;
+	foreach(l, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(l);
+
+		if (list_attnums[listidx] != InvalidAttrNumber &&
+			bms_is_member(list_attnums[listidx], stat->keys))
+		{
+			stat_clauses = lappend(stat_clauses, clause);
+			*estimatedclauses = bms_add_member(*estimatedclauses, listidx);
+
+			simple_sel *= clause_selectivity(root, clause, varRelid,
+											 jointype, sjinfo);
+		}
+
+		listidx++;
+	}
+
+	pfree(list_attnums);
+
+	/* evaluate all the clauses on the MCV items */
+	mcv_sel = mcv_clauselist_selectivity(root, stat, stat_clauses, rel,
+										 &mcv_basesel, &mcv_totalsel);
+
+	/* estimated selectivity of values not covered by MCV matches */
+	other_sel = simple_sel - mcv_basesel;
+	CLAMP_PROBABILITY(other_sel);
+
+	/* the non-MCV selectivity can't exceed 1 - mcv_totalsel */
+	if (other_sel > 1.0 - mcv_totalsel)
+		other_sel = 1.0 - mcv_totalsel;
+
+	sel = mcv_sel + other_sel;
+	CLAMP_PROBABILITY(sel);
+
+	return sel;
+}
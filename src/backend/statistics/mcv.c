@@ -0,0 +1,688 @@
+/*-------------------------------------------------------------------------
+ *
+ * mcv.c
+ *	  POSTGRES multivariate MCV lists
+ *
+ * A multi-column MCV list is the list of the most common combinations of
+ * values of the columns of a statistics object, with their frequencies.
+ * Unlike the per-column MCV lists in pg_statistic it captures how the
+ * values of the columns go together, so conditions on several of the
+ * columns can be estimated by simply adding up the frequencies of the
+ * matching combinations.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/statistics/mcv.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/tuptoaster.h"
+#include "catalog/pg_statistic_ext.h"
+#include "fmgr.h"
+#include "statistics/extended_stats_internal.h"
+#include "statistics/statistics.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+
+/*
+ * To avoid consuming too much memory, and to keep the serialized list
+ * reasonably small, combinations including values wider than this aren't
+ * put in the MCV list; the same limit compute_scalar_stats() applies to the
+ * per-column statistics.
+ */
+#define WIDTH_THRESHOLD  1024
+
+/* size of the serialized header, not counting the type OIDs */
+#define SizeOfMCVListHeader	(3 * sizeof(uint32) + sizeof(AttrNumber))
+
+/* a clause of the kind mcv_clauselist_selectivity() evaluates */
+typedef struct MCVClause
+{
+	int			dim;			/* dimension of the column in the MCV list */
+	bool		is_nulltest;	/* NullTest (otherwise an OpExpr)? */
+	NullTestType nulltesttype;	/* for a NullTest, IS NULL or IS NOT NULL */
+	FmgrInfo	opproc;			/* for an OpExpr, the operator function */
+	Oid			collation;		/* ... the operator's input collation */
+	bool		varonleft;		/* ... is the column the left argument? */
+	Datum		constvalue;		/* ... the value compared to */
+	bool		constisnull;
+} MCVClause;
+
+static int	compare_sort_item_count(const void *a, const void *b);
+static int	count_equal_values(SortItem *items, int nitems, SortItem *key,
+				   MultiSortSupport mss);
+static bool item_is_too_wide(StatsBuildData *data, SortItem *item);
+static void mcv_get_clause(Node *clause, StatisticExtInfo *stat,
+			   MCVClause *result);
+
+
+/*
+ * statext_mcv_build
+ *		Build a multi-column MCV list from the sample rows.
+ *
+ * The sample rows are sorted by all the columns and grouped, and then the
+ * most common groups are kept, in the way compute_scalar_stats() does for a
+ * single column: if all the groups fit in the list and none of them was
+ * seen only once, we believe we've seen every combination there is and
+ * keep them all; otherwise only those that are notably more common than
+ * the average group are kept.  The number of items is limited by the
+ * statistics target.
+ *
+ * Returns NULL if no combination is common enough.
+ */
+MCVList *
+statext_mcv_build(StatsBuildData *data, int stattarget)
+{
+	int			ndims = data->nattnums;
+	int			numrows = data->numrows;
+	int			dims[STATS_MAX_DIMENSIONS];
+	SortItem   *items;
+	SortItem   *groups;
+	MultiSortSupport mss;
+	SortItem   *colitems[STATS_MAX_DIMENSIONS];
+	MultiSortSupport colmss[STATS_MAX_DIMENSIONS];
+	int			ngroups;
+	int			nitems;
+	int			f1;
+	int			i;
+	int			j;
+	MCVList    *mcvlist;
+
+	for (j = 0; j < ndims; j++)
+		dims[j] = j;
+
+	items = build_sorted_items(data, ndims, dims, &mss);
+
+	/* collapse the sorted rows into groups of equal combinations */
+	groups = (SortItem *) palloc(numrows * sizeof(SortItem));
+	groups[0] = items[0];
+	ngroups = 1;
+	for (i = 1; i < numrows; i++)
+	{
+		if (multi_sort_compare(&items[i], &items[i - 1], mss) != 0)
+		{
+			groups[ngroups] = items[i];
+			ngroups++;
+		}
+		else
+			groups[ngroups - 1].count++;
+	}
+
+	f1 = 0;
+	for (i = 0; i < ngroups; i++)
+	{
+		if (groups[i].count == 1)
+			f1++;
+	}
+
+	/* most common groups first */
+	qsort(groups, ngroups, sizeof(SortItem), compare_sort_item_count);
+
+	/* decide how many of the groups to keep, skipping too-wide ones */
+	nitems = 0;
+	if (ngroups <= stattarget && f1 == 0)
+	{
+		for (i = 0; i < ngroups; i++)
+		{
+			if (!item_is_too_wide(data, &groups[i]))
+				groups[nitems++] = groups[i];
+		}
+	}
+	else
+	{
+		double		mincount;
+
+		/* like compute_scalar_stats(), require 25% above the average */
+		mincount = 1.25 * (double) numrows / (double) ngroups;
+		if (mincount < 2)
+			mincount = 2;
+
+		for (i = 0; i < ngroups && nitems < stattarget; i++)
+		{
+			if (groups[i].count < mincount)
+				break;
+			if (!item_is_too_wide(data, &groups[i]))
+				groups[nitems++] = groups[i];
+		}
+	}
+
+	if (nitems == 0)
+		return NULL;
+
+	/* sort each column separately, to compute the base frequencies */
+	for (j = 0; j < ndims; j++)
+		colitems[j] = build_sorted_items(data, 1, &j, &colmss[j]);
+
+	mcvlist = (MCVList *) palloc0(sizeof(MCVList));
+	mcvlist->magic = STATS_MCV_MAGIC;
+	mcvlist->type = STATS_MCV_TYPE_BASIC;
+	mcvlist->nitems = nitems;
+	mcvlist->ndimensions = ndims;
+	for (j = 0; j < ndims; j++)
+		mcvlist->types[j] = data->types[j];
+	mcvlist->items = (MCVItem **) palloc(nitems * sizeof(MCVItem *));
+
+	for (i = 0; i < nitems; i++)
+	{
+		MCVItem    *item = (MCVItem *) palloc(sizeof(MCVItem));
+
+		item->values = (Datum *) palloc(ndims * sizeof(Datum));
+		item->isnull = (bool *) palloc(ndims * sizeof(bool));
+		item->frequency = (double) groups[i].count / numrows;
+		item->base_frequency = 1.0;
+
+		for (j = 0; j < ndims; j++)
+		{
+			SortItem	key;
+			int			count;
+
+			key.values = &groups[i].values[j];
+			key.isnull = &groups[i].isnull[j];
+			count = count_equal_values(colitems[j], numrows, &key, colmss[j]);
+			item->base_frequency *= (double) count / numrows;
+
+			item->isnull[j] = groups[i].isnull[j];
+			if (item->isnull[j])
+				item->values[j] = (Datum) 0;
+			else if (data->typlens[j] == -1)
+				item->values[j] =
+					PointerGetDatum(PG_DETOAST_DATUM_COPY(groups[i].values[j]));
+			else
+				item->values[j] = datumCopy(groups[i].values[j],
+											data->typbyvals[j],
+											data->typlens[j]);
+		}
+
+		mcvlist->items[i] = item;
+	}
+
+	return mcvlist;
+}
+
+/* qsort comparator sorting SortItems by count, descending */
+static int
+compare_sort_item_count(const void *a, const void *b)
+{
+	const SortItem *ia = (const SortItem *) a;
+	const SortItem *ib = (const SortItem *) b;
+
+	if (ia->count == ib->count)
+		return 0;
+	else if (ia->count > ib->count)
+		return -1;
+
+	return 1;
+}
+
+/*
+ * Count the items of a sorted array equal to the given key, with two binary
+ * searches for the bounds of the run of equal items.
+ */
+static int
+count_equal_values(SortItem *items, int nitems, SortItem *key,
+				   MultiSortSupport mss)
+{
+	int			lo,
+				hi,
+				first;
+
+	/* find the first item not less than the key */
+	lo = 0;
+	hi = nitems;
+	while (lo < hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		if (multi_sort_compare(&items[mid], key, mss) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = lo;
+
+	/* find the first item greater than the key */
+	hi = nitems;
+	while (lo < hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		if (multi_sort_compare(&items[mid], key, mss) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo - first;
+}
+
+/* Does the combination include a value too wide to keep in the MCV list? */
+static bool
+item_is_too_wide(StatsBuildData *data, SortItem *item)
+{
+	int			j;
+
+	for (j = 0; j < data->nattnums; j++)
+	{
+		if (item->isnull[j] || data->typlens[j] != -1)
+			continue;
+
+		if (toast_raw_datum_size(item->values[j]) > WIDTH_THRESHOLD)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * statext_mcv_load
+ *		Load the MCV list for the indicated pg_statistic_ext tuple
+ */
+MCVList *
+statext_mcv_load(Oid mvoid)
+{
+	MCVList    *result;
+	bool		isnull;
+	Datum		mcvlist;
+	HeapTuple	htup;
+
+	htup = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(mvoid));
+	if (!HeapTupleIsValid(htup))
+		elog(ERROR, "cache lookup failed for statistics object %u", mvoid);
+
+	mcvlist = SysCacheGetAttr(STATEXTOID, htup,
+							  Anum_pg_statistic_ext_stxmcv, &isnull);
+	if (isnull)
+		elog(ERROR,
+			 "requested statistic kind \"%c\" is not yet built for statistics object %u",
+			 STATS_EXT_MCV, mvoid);
+
+	result = statext_mcv_deserialize(DatumGetByteaP(mcvlist));
+
+	ReleaseSysCache(htup);
+
+	return result;
+}
+
+/*
+ * statext_mcv_serialize
+ *		Serialize MCV list into a bytea value.
+ *
+ * The format is the header (magic, type, number of items and dimensions,
+ * and the OIDs of the column types), followed by the items.  Each item is
+ * the frequency and base frequency, and then for each column a null flag
+ * and, unless the value is NULL, the value itself: the whole Datum for
+ * pass-by-value types, and the contents otherwise.  Nothing is aligned;
+ * deserialization copies the values out.
+ */
+bytea *
+statext_mcv_serialize(MCVList *mcvlist)
+{
+	int			ndims = mcvlist->ndimensions;
+	int16		typlens[STATS_MAX_DIMENSIONS];
+	bool		typbyvals[STATS_MAX_DIMENSIONS];
+	Size		len;
+	bytea	   *output;
+	char	   *tmp;
+	int			i;
+	int			j;
+
+	for (j = 0; j < ndims; j++)
+		get_typlenbyval(mcvlist->types[j], &typlens[j], &typbyvals[j]);
+
+	/* compute the size of the serialized data */
+	len = VARHDRSZ + SizeOfMCVListHeader + ndims * sizeof(Oid);
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		MCVItem    *item = mcvlist->items[i];
+
+		len += 2 * sizeof(double) + ndims * sizeof(bool);
+		for (j = 0; j < ndims; j++)
+		{
+			if (item->isnull[j])
+				continue;
+			if (typbyvals[j])
+				len += sizeof(Datum);
+			else
+				len += datumGetSize(item->values[j], false, typlens[j]);
+		}
+	}
+
+	output = (bytea *) palloc0(len);
+	SET_VARSIZE(output, len);
+
+	tmp = VARDATA(output);
+
+	memcpy(tmp, &mcvlist->magic, sizeof(uint32));
+	tmp += sizeof(uint32);
+	memcpy(tmp, &mcvlist->type, sizeof(uint32));
+	tmp += sizeof(uint32);
+	memcpy(tmp, &mcvlist->nitems, sizeof(uint32));
+	tmp += sizeof(uint32);
+	memcpy(tmp, &mcvlist->ndimensions, sizeof(AttrNumber));
+	tmp += sizeof(AttrNumber);
+	memcpy(tmp, mcvlist->types, ndims * sizeof(Oid));
+	tmp += ndims * sizeof(Oid);
+
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		MCVItem    *item = mcvlist->items[i];
+
+		memcpy(tmp, &item->frequency, sizeof(double));
+		tmp += sizeof(double);
+		memcpy(tmp, &item->base_frequency, sizeof(double));
+		tmp += sizeof(double);
+
+		for (j = 0; j < ndims; j++)
+		{
+			memcpy(tmp, &item->isnull[j], sizeof(bool));
+			tmp += sizeof(bool);
+
+			if (item->isnull[j])
+				continue;
+
+			if (typbyvals[j])
+			{
+				memcpy(tmp, &item->values[j], sizeof(Datum));
+				tmp += sizeof(Datum);
+			}
+			else
+			{
+				Size		size = datumGetSize(item->values[j], false,
+												typlens[j]);
+
+				memcpy(tmp, DatumGetPointer(item->values[j]), size);
+				tmp += size;
+			}
+		}
+
+		/* protect against overflow */
+		Assert(tmp <= ((char *) output + len));
+	}
+
+	Assert(tmp == ((char *) output + len));
+
+	return output;
+}
+
+/*
+ * statext_mcv_deserialize
+ *		Reads serialized MCV list into MCVList structure.
+ */
+MCVList *
+statext_mcv_deserialize(bytea *data)
+{
+	MCVList    *mcvlist;
+	int16		typlens[STATS_MAX_DIMENSIONS];
+	bool		typbyvals[STATS_MAX_DIMENSIONS];
+	char	   *tmp;
+	char	   *end;
+	int			ndims;
+	int			i;
+	int			j;
+
+	if (data == NULL)
+		return NULL;
+
+	if (VARSIZE_ANY_EXHDR(data) < SizeOfMCVListHeader)
+		elog(ERROR, "invalid MCV list size %zd (expected at least %zd)",
+			 VARSIZE_ANY_EXHDR(data), SizeOfMCVListHeader);
+
+	mcvlist = (MCVList *) palloc0(sizeof(MCVList));
+
+	tmp = VARDATA_ANY(data);
+	end = (char *) data + VARSIZE_ANY(data);
+
+	/* read the header fields and perform basic sanity checks */
+	memcpy(&mcvlist->magic, tmp, sizeof(uint32));
+	tmp += sizeof(uint32);
+	memcpy(&mcvlist->type, tmp, sizeof(uint32));
+	tmp += sizeof(uint32);
+	memcpy(&mcvlist->nitems, tmp, sizeof(uint32));
+	tmp += sizeof(uint32);
+	memcpy(&mcvlist->ndimensions, tmp, sizeof(AttrNumber));
+	tmp += sizeof(AttrNumber);
+
+	if (mcvlist->magic != STATS_MCV_MAGIC)
+		elog(ERROR, "invalid MCV magic %u (expected %u)",
+			 mcvlist->magic, STATS_MCV_MAGIC);
+	if (mcvlist->type != STATS_MCV_TYPE_BASIC)
+		elog(ERROR, "invalid MCV type %u (expected %u)",
+			 mcvlist->type, STATS_MCV_TYPE_BASIC);
+	if (mcvlist->nitems == 0)
+		elog(ERROR, "invalid zero-length item array in MCVList");
+
+	ndims = mcvlist->ndimensions;
+	if (ndims < 2 || ndims > STATS_MAX_DIMENSIONS)
+		elog(ERROR, "invalid number of dimensions %d in MCVList", ndims);
+
+	if (tmp + ndims * sizeof(Oid) > end)
+		elog(ERROR, "invalid MCV list size %zd", VARSIZE_ANY_EXHDR(data));
+	memcpy(mcvlist->types, tmp, ndims * sizeof(Oid));
+	tmp += ndims * sizeof(Oid);
+
+	for (j = 0; j < ndims; j++)
+		get_typlenbyval(mcvlist->types[j], &typlens[j], &typbyvals[j]);
+
+	mcvlist->items = (MCVItem **) palloc(mcvlist->nitems * sizeof(MCVItem *));
+
+	for (i = 0; i < mcvlist->nitems; i++)
+	{
+		MCVItem    *item = (MCVItem *) palloc(sizeof(MCVItem));
+
+		item->values = (Datum *) palloc(ndims * sizeof(Datum));
+		item->isnull = (bool *) palloc(ndims * sizeof(bool));
+
+		memcpy(&item->frequency, tmp, sizeof(double));
+		tmp += sizeof(double);
+		memcpy(&item->base_frequency, tmp, sizeof(double));
+		tmp += sizeof(double);
+
+		for (j = 0; j < ndims; j++)
+		{
+			memcpy(&item->isnull[j], tmp, sizeof(bool));
+			tmp += sizeof(bool);
+
+			if (item->isnull[j])
+			{
+				item->values[j] = (Datum) 0;
+				continue;
+			}
+
+			if (typbyvals[j])
+			{
+				memcpy(&item->values[j], tmp, sizeof(Datum));
+				tmp += sizeof(Datum);
+			}
+			else
+			{
+				Size		size;
+				char	   *value;
+
+				/* the varlena header may be unaligned here, copy it first */
+				if (typlens[j] > 0)
+					size = typlens[j];
+				else if (typlens[j] == -1)
+				{
+					union
+					{
+						varattrib_4b hdr;
+						char		bytes[VARHDRSZ];
+					}			hdr;
+
+					memcpy(hdr.bytes, tmp, Min(VARHDRSZ, end - tmp));
+					size = VARSIZE_ANY(&hdr);
+				}
+				else
+					size = strlen(tmp) + 1;
+
+				value = (char *) palloc(size);
+				memcpy(value, tmp, size);
+				item->values[j] = PointerGetDatum(value);
+				tmp += size;
+			}
+		}
+
+		/* still within the bytea */
+		if (tmp > end)
+			elog(ERROR, "invalid MCV list size %zd", VARSIZE_ANY_EXHDR(data));
+
+		mcvlist->items[i] = item;
+	}
+
+	/* we should have consumed the whole bytea exactly */
+	Assert(tmp == end);
+
+	return mcvlist;
+}
+
+/*
+ * mcv_get_clause
+ *		Extract what we need to evaluate a clause on the MCV items.
+ *
+ * The clause must have been accepted by statext_is_compatible_clause(), and
+ * it must reference one of the columns of the statistics object.
+ */
+static void
+mcv_get_clause(Node *clause, StatisticExtInfo *stat, MCVClause *result)
+{
+	Var		   *var;
+	int			x;
+
+	if (IsA(clause, RestrictInfo))
+		clause = (Node *) ((RestrictInfo *) clause)->clause;
+
+	memset(result, 0, sizeof(MCVClause));
+
+	if (IsA(clause, NullTest))
+	{
+		NullTest   *expr = (NullTest *) clause;
+
+		var = (Var *) expr->arg;
+		result->is_nulltest = true;
+		result->nulltesttype = expr->nulltesttype;
+	}
+	else
+	{
+		OpExpr	   *expr = (OpExpr *) clause;
+		Node	   *left = (Node *) linitial(expr->args);
+		Node	   *right = (Node *) lsecond(expr->args);
+		Const	   *cst;
+
+		if (IsA(left, RelabelType))
+			left = (Node *) ((RelabelType *) left)->arg;
+		if (IsA(right, RelabelType))
+			right = (Node *) ((RelabelType *) right)->arg;
+
+		result->varonleft = IsA(left, Var);
+		var = (Var *) (result->varonleft ? left : right);
+		cst = (Const *) (result->varonleft ? right : left);
+		Assert(IsA(var, Var) && IsA(cst, Const));
+
+		fmgr_info(get_opcode(expr->opno), &result->opproc);
+		result->collation = expr->inputcollid;
+		result->constvalue = cst->constvalue;
+		result->constisnull = cst->constisnull;
+	}
+
+	/* the dimensions are the columns in ascending attnum order */
+	Assert(bms_is_member(var->varattno, stat->keys));
+	result->dim = 0;
+	x = -1;
+	while ((x = bms_next_member(stat->keys, x)) >= 0 && x < var->varattno)
+		result->dim++;
+}
+
+/*
+ * mcv_clauselist_selectivity
+ *		Return the selectivity estimate computed using an MCV list.
+ *
+ * Returns the total frequency of the MCV items matching all the clauses,
+ * which are implicitly ANDed.  The total base frequency of the matching
+ * items is returned in *basesel, and the total frequency of all the MCV
+ * items in *totalsel, for the caller to combine the result with the
+ * estimate for the part of the data not covered by the MCV list.
+ */
+Selectivity
+mcv_clauselist_selectivity(PlannerInfo *root, StatisticExtInfo *stat,
+						   List *clauses, RelOptInfo *rel,
+						   Selectivity *basesel, Selectivity *totalsel)
+{
+	MCVList    *mcv;
+	MCVClause  *mcvclauses;
+	int			nclauses = list_length(clauses);
+	Selectivity s = 0.0;
+	ListCell   *l;
+	int			i;
+	int			j;
+
+	*basesel = 0.0;
+	*totalsel = 0.0;
+
+	/* load the MCV list stored in the statistics object */
+	mcv = statext_mcv_load(stat->statOid);
+
+	mcvclauses = (MCVClause *) palloc(nclauses * sizeof(MCVClause));
+	i = 0;
+	foreach(l, clauses)
+		mcv_get_clause((Node *) lfirst(l), stat, &mcvclauses[i++]);
+
+	for (i = 0; i < mcv->nitems; i++)
+	{
+		MCVItem    *item = mcv->items[i];
+		bool		match = true;
+
+		*totalsel += item->frequency;
+
+		for (j = 0; j < nclauses && match; j++)
+		{
+			MCVClause  *c = &mcvclauses[j];
+			bool		isnull = item->isnull[c->dim];
+
+			if (c->is_nulltest)
+			{
+				if (c->nulltesttype == IS_NULL)
+					match = isnull;
+				else
+					match = !isnull;
+			}
+			else if (isnull || c->constisnull)
+			{
+				/* the operators we handle are all strict */
+				match = false;
+			}
+			else
+			{
+				Datum		value = item->values[c->dim];
+
+				if (c->varonleft)
+					match = DatumGetBool(FunctionCall2Coll(&c->opproc,
+														   c->collation,
+														   value,
+														   c->constvalue));
+				else
+					match = DatumGetBool(FunctionCall2Coll(&c->opproc,
+														   c->collation,
+														   c->constvalue,
+														   value));
+			}
+		}
+
+		if (match)
+		{
+			s += item->frequency;
+			*basesel += item->base_frequency;
+		}
+	}
+
+	pfree(mcvclauses);
+
+	return s;
+}
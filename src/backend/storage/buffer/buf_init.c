@@ -20,6 +20,7 @@
 
 BufferDescPadded *BufferDescriptors;
 char	   *BufferBlocks;
+CkptSortItem *CkptBufferIds;
 
 
 /*
@@ -65,7 +66,8 @@ void
 InitBufferPool(void)
 {
 	bool		foundBufs,
-				foundDescs;
+				foundDescs,
+				foundBufCkpt;
 
 	/* Align descriptors to a cacheline boundary. */
 	BufferDescriptors = (BufferDescPadded *) CACHELINEALIGN(
@@ -73,14 +75,25 @@ InitBufferPool(void)
 					NBuffers * sizeof(BufferDescPadded) + PG_CACHE_LINE_SIZE,
 														&foundDescs));
 
-	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
-
-	if (foundDescs || foundBufs)
+	/* Align the pages themselves for direct I/O, see md.c */
+	BufferBlocks = (char *) TYPEALIGN(PG_IO_ALIGN_SIZE,
+									  ShmemInitStruct("Buffer Blocks",
+						NBuffers * (Size) BLCKSZ + PG_IO_ALIGN_SIZE,
+													  &foundBufs));
+
+	/*
+	 * The array used to sort to-be-checkpointed buffer ids is allocated
+	 * here, rather than when a checkpoint needs it, so that a checkpoint
+	 * can't fail for want of memory.
+	 */
+	CkptBufferIds = (CkptSortItem *)
+		ShmemInitStruct("Checkpoint BufferIds",
+						NBuffers * sizeof(CkptSortItem), &foundBufCkpt);
+
+	if (foundDescs || foundBufs || foundBufCkpt)
 	{
-		/* both should be present or neither */
-		Assert(foundDescs && foundBufs);
+		/* all should be present or neither */
+		Assert(foundDescs && foundBufs && foundBufCkpt);
 		/* note: this path is only taken in EXEC_BACKEND case */
 	}
 	else
@@ -120,6 +133,10 @@ InitBufferPool(void)
 
 	/* Init other shared buffer-management stuff */
 	StrategyInitialize(!foundDescs);
+
+	/* Spread the buffers over the NUMA nodes before anyone touches them */
+	if (!foundBufs)
+		StrategyPlaceBuffers(BufferBlocks);
 }
 
 /*
@@ -140,9 +157,14 @@ BufferShmemSize(void)
 
 	/* size of data pages */
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
+	/* to allow aligning data pages */
+	size = add_size(size, PG_IO_ALIGN_SIZE);
 
 	/* size of stuff controlled by freelist.c */
 	size = add_size(size, StrategyShmemSize());
 
+	/* size of checkpoint sort array in bufmgr.c */
+	size = add_size(size, mul_size(NBuffers, sizeof(CkptSortItem)));
+
 	return size;
 }
@@ -3,11 +3,25 @@
  * buf_table.c
  *	  routines for mapping BufferTags to buffer indexes.
  *
- * Note: the routines in this file do no locking of their own.  The caller
- * must hold a suitable lock on the appropriate BufMappingLock, as specified
- * in the comments.  We can't do the locking inside these functions because
- * in most cases the caller needs to adjust the buffer header contents
- * before the lock is released (see notes in README).
+ * Note: the routines in this file do no locking of their own, except for
+ * BufTableLookupUnlocked.  The caller must hold a suitable lock on the
+ * appropriate BufMappingLock, as specified in the comments.  We can't do
+ * the locking inside these functions because in most cases the caller needs
+ * to adjust the buffer header contents before the lock is released (see
+ * notes in README).
+ *
+ * The table is a chained hash table of its own rather than a dynahash
+ * table, so that it can be searched while it is being changed.  The number
+ * of buckets is a power of 2 of at least NUM_BUFFER_PARTITIONS, so that all
+ * the entries in a bucket belong to the same partition, and a bucket is
+ * only changed by someone holding an exclusive lock on its partition.  A
+ * new entry is filled in before it is linked into its bucket, and an entry
+ * that is removed keeps its link to the next entry, so an unlocked reader
+ * following the chain never sees garbage.  It may however end up on an
+ * entry that has been removed and reused for a different tag, even in a
+ * different bucket, so it can miss the entry it is looking for or get
+ * stuck in a cycle; BufTableLookupUnlocked gives up after a bounded number
+ * of steps, and its result is only a hint to be verified by the caller.
  *
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
@@ -23,6 +37,9 @@
 
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/hashutils.h"
 
 
 /* entry for buffer lookup hashtable */
@@ -30,11 +47,39 @@ typedef struct
 {
 	BufferTag	key;			/* Tag of a disk page */
 	int			id;				/* Associated buffer ID */
+	int			next;			/* next entry in bucket, or -1 */
+	int			nextFree;		/* next entry in free list, or -1 */
 } BufferLookupEnt;
 
-static HTAB *SharedBufHash;
+/* the shared hashtable */
+typedef struct
+{
+	slock_t		mutex;			/* protects the free list */
+	int			freeList;		/* first free entry, or -1 */
+	uint32		nbuckets;		/* number of buckets, a power of 2 */
+	int			nentries;		/* number of entries */
+	int			buckets[FLEXIBLE_ARRAY_MEMBER]; /* first entry of each */
+} BufferLookupTable;
+
+static BufferLookupTable *SharedBufTable;
+static BufferLookupEnt *SharedBufEntries;
+
+static uint32 BufTableBuckets(int size);
 
 
+/*
+ * Number of buckets for a table of the given size
+ */
+static uint32
+BufTableBuckets(int size)
+{
+	uint32		nbuckets = NUM_BUFFER_PARTITIONS;
+
+	while (nbuckets < (uint32) size)
+		nbuckets <<= 1;
+	return nbuckets;
+}
+
 /*
  * Estimate space needed for mapping hashtable
  *		size is the desired hash table size (possibly more than NBuffers)
@@ -42,7 +87,12 @@ static HTAB *SharedBufHash;
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	Size		tabsize;
+
+	tabsize = add_size(offsetof(BufferLookupTable, buckets),
+					   mul_size(BufTableBuckets(size), sizeof(int)));
+	tabsize = MAXALIGN(tabsize);
+	return add_size(tabsize, mul_size(size, sizeof(BufferLookupEnt)));
 }
 
 /*
@@ -52,19 +102,40 @@ BufTableShmemSize(int size)
 void
 InitBufTable(int size)
 {
-	HASHCTL		info;
+	bool		found;
+	uint32		nbuckets = BufTableBuckets(size);
+	uint32		i;
 
 	/* assume no locking is needed yet */
 
-	/* BufferTag maps to Buffer */
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(BufferLookupEnt);
-	info.num_partitions = NUM_BUFFER_PARTITIONS;
+	SharedBufTable = (BufferLookupTable *)
+		ShmemInitStruct("Shared Buffer Lookup Table",
+						BufTableShmemSize(size), &found);
+	SharedBufEntries = (BufferLookupEnt *)
+		((char *) SharedBufTable +
+		 MAXALIGN(offsetof(BufferLookupTable, buckets) +
+				  nbuckets * sizeof(int)));
 
-	SharedBufHash = ShmemInitHash("Shared Buffer Lookup Table",
-								  size, size,
-								  &info,
-								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+	if (found)
+		return;
+
+	/* every bucket must lie in a single partition, see above */
+	StaticAssertStmt((NUM_BUFFER_PARTITIONS & (NUM_BUFFER_PARTITIONS - 1)) == 0,
+					 "NUM_BUFFER_PARTITIONS must be a power of 2");
+
+	SpinLockInit(&SharedBufTable->mutex);
+	SharedBufTable->nbuckets = nbuckets;
+	SharedBufTable->nentries = size;
+	for (i = 0; i < nbuckets; i++)
+		SharedBufTable->buckets[i] = -1;
+
+	/* all the entries start out in the free list */
+	for (i = 0; i < (uint32) size; i++)
+	{
+		SharedBufEntries[i].next = -1;
+		SharedBufEntries[i].nextFree = (i + 1 < (uint32) size) ? (int) i + 1 : -1;
+	}
+	SharedBufTable->freeList = 0;
 }
 
 /*
@@ -74,12 +145,12 @@ InitBufTable(int size)
  * This must be passed to the lookup/insert/delete routines along with the
  * tag.  We do it like this because the callers need to know the hash code
  * in order to determine which buffer partition to lock, and we don't want
- * to do the hash computation twice (hash_any is a bit slow).
+ * to do the hash computation twice.
  */
 uint32
 BufTableHashCode(BufferTag *tagPtr)
 {
-	return get_hash_value(SharedBufHash, (void *) tagPtr);
+	return hash_bytes_fast((const unsigned char *) tagPtr, sizeof(BufferTag));
 }
 
 /*
@@ -91,19 +162,57 @@ BufTableHashCode(BufferTag *tagPtr)
 int
 BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	int			entry;
+
+	entry = SharedBufTable->buckets[hashcode & (SharedBufTable->nbuckets - 1)];
+	while (entry >= 0)
+	{
+		BufferLookupEnt *ent = &SharedBufEntries[entry];
+
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;
+		entry = ent->next;
+	}
+
+	return -1;
+}
+
+/*
+ * BufTableLookupUnlocked
+ *		Lookup the given BufferTag without any lock
+ *
+ * Returns the buffer ID the tag seemed to be mapped to, or -1.  Because the
+ * table can change under us, the result is only a hint: the tag may not be
+ * in that buffer (anymore), and -1 doesn't prove that the tag is not in the
+ * table.  Callers have to check the buffer's tag after pinning it, and fall
+ * back to BufTableLookup with the partition lock held when in doubt.
+ */
+int
+BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode)
+{
+	volatile BufferLookupTable *table = SharedBufTable;
+	volatile BufferLookupEnt *entries = SharedBufEntries;
+	int			entry;
+	int			nsteps = 0;
+
+	entry = table->buckets[hashcode & (table->nbuckets - 1)];
+	while (entry >= 0 && entry < table->nentries)
+	{
+		volatile BufferLookupEnt *ent = &entries[entry];
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_FIND,
-									NULL);
+		/* the entry was initialized before it was linked, see above */
+		pg_read_barrier();
 
-	if (!result)
-		return -1;
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;
 
-	return result->id;
+		/* in case we've been sent around in circles */
+		if (++nsteps > table->nentries)
+			break;
+		entry = ent->next;
+	}
+
+	return -1;
 }
 
 /*
@@ -119,23 +228,36 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 int
 BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
-	BufferLookupEnt *result;
-	bool		found;
+	volatile BufferLookupTable *table = SharedBufTable;
+	int		   *bucket;
+	int			entry;
+	BufferLookupEnt *ent;
 
 	Assert(buf_id >= 0);		/* -1 is reserved for not-in-table */
 	Assert(tagPtr->blockNum != P_NEW);	/* invalid tag */
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_ENTER,
-									&found);
+	entry = BufTableLookup(tagPtr, hashcode);
+	if (entry >= 0)				/* found something already in the table */
+		return entry;
+
+	/* take an entry from the free list */
+	SpinLockAcquire(&table->mutex);
+	entry = table->freeList;
+	if (entry >= 0)
+		table->freeList = SharedBufEntries[entry].nextFree;
+	SpinLockRelease(&table->mutex);
 
-	if (found)					/* found something already in the table */
-		return result->id;
+	if (entry < 0)				/* shouldn't happen */
+		elog(ERROR, "shared buffer hash table is full");
 
-	result->id = buf_id;
+	/* fill it in before concurrent readers can see it */
+	bucket = &SharedBufTable->buckets[hashcode & (table->nbuckets - 1)];
+	ent = &SharedBufEntries[entry];
+	ent->key = *tagPtr;
+	ent->id = buf_id;
+	ent->next = *bucket;
+	pg_write_barrier();
+	*((volatile int *) bucket) = entry;
 
 	return -1;
 }
@@ -149,15 +271,32 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 void
 BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	volatile BufferLookupTable *table = SharedBufTable;
+	volatile int *link;
+	int			entry;
+
+	link = &SharedBufTable->buckets[hashcode & (table->nbuckets - 1)];
+	while ((entry = *link) >= 0)
+	{
+		BufferLookupEnt *ent = &SharedBufEntries[entry];
+
+		if (BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+		{
+			/*
+			 * Unlink it, but leave its own link alone for the sake of
+			 * concurrent readers standing on it.
+			 */
+			*link = ent->next;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_REMOVE,
-									NULL);
+			SpinLockAcquire(&table->mutex);
+			ent->nextFree = table->freeList;
+			table->freeList = entry;
+			SpinLockRelease(&table->mutex);
+			return;
+		}
+		link = &ent->next;
+	}
 
-	if (!result)				/* shouldn't happen */
-		elog(ERROR, "shared buffer hash table corrupted");
+	/* shouldn't happen */
+	elog(ERROR, "shared buffer hash table corrupted");
 }
@@ -37,6 +37,7 @@
 #include "catalog/catalog.h"
 #include "catalog/storage.h"
 #include "executor/instrument.h"
+#include "lib/binaryheap.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "pgstat.h"
@@ -66,6 +67,12 @@
 
 #define DROP_RELS_BSEARCH_THRESHOLD		20
 
+/*
+ * When dropping fewer buffers than this, look each of them up in the buffer
+ * mapping table instead of scanning the whole buffer pool.
+ */
+#define BUF_DROP_FULL_SCAN_THRESHOLD		(uint64) (NBuffers / 32)
+
 typedef struct PrivateRefCountEntry
 {
 	Buffer		buffer;
@@ -75,11 +82,42 @@ typedef struct PrivateRefCountEntry
 /* 64 bytes, about the size of a cache line on common systems */
 #define REFCOUNT_ARRAY_ENTRIES 8
 
+/*
+ * Status of buffers to checkpoint for a particular tablespace, used
+ * internally in BufferSync.
+ */
+typedef struct CkptTsStatus
+{
+	/* oid of the tablespace */
+	Oid			tsId;
+
+	/*
+	 * Checkpoint progress for this tablespace.  To make progress comparable
+	 * between tablespaces, the progress is, for each tablespace, measured as
+	 * a number between 0 and the total number of to-be-checkpointed pages.
+	 * Each page checkpointed in this tablespace increments this space's
+	 * progress by progress_slice.
+	 */
+	float8		progress;
+	float8		progress_slice;
+
+	/* number of to-be checkpointed pages in this tablespace */
+	int			num_to_scan;
+	/* already processed pages in this tablespace */
+	int			num_scanned;
+
+	/* current offset in CkptBufferIds for this tablespace */
+	int			index;
+} CkptTsStatus;
+
 /* GUC variables */
 bool		zero_damaged_pages = false;
 int			bgwriter_lru_maxpages = 100;
 double		bgwriter_lru_multiplier = 2.0;
 bool		track_io_timing = false;
+int			checkpoint_flush_after = DEFAULT_CHECKPOINT_FLUSH_AFTER;
+int			bgwriter_flush_after = DEFAULT_BGWRITER_FLUSH_AFTER;
+int			backend_flush_after = DEFAULT_BACKEND_FLUSH_AFTER;
 
 /*
  * How many buffers PrefetchBuffer callers should try to stay ahead of their
@@ -88,6 +126,9 @@ bool		track_io_timing = false;
  */
 int			target_prefetch_pages = 0;
 
+/* GUC: how many consecutive blocks ReadBuffers reads with one system call */
+int			io_combine_limit = DEFAULT_IO_COMBINE_LIMIT;
+
 /* local state for StartBufferIO and related functions */
 static volatile BufferDesc *InProgressBuf = NULL;
 static bool IsForInput;
@@ -95,6 +136,29 @@ static bool IsForInput;
 /* local state for LockBufferForCleanup */
 static volatile BufferDesc *PinCountWaitBuf = NULL;
 
+/* writeback requests for victim buffers this backend had to write itself */
+static WritebackContext BackendWritebackContext;
+
+/*
+ * Asynchronous reads in progress in this backend, oldest first; see
+ * StartReadBuffer.  Each holds a pin on its buffer that no resource owner
+ * knows about, and the buffer's io_in_progress_lock.
+ */
+typedef struct AsyncReadEntry
+{
+	volatile BufferDesc *buf;
+	int			handle;			/* from smgrstartread, or one of below */
+} AsyncReadEntry;
+
+/* handles of ReadBuffers' entries, which aren't really asynchronous */
+#define ASYNC_READ_PENDING	(-1)	/* not read yet */
+#define ASYNC_READ_DONE		(-2)	/* read, but not checked yet */
+
+#define MAX_ASYNC_READS		FILE_IO_MAX_INFLIGHT
+
+static AsyncReadEntry AsyncReads[MAX_ASYNC_READS];
+static int	NumAsyncReads = 0;
+
 /*
  * Backend-private refcount management:
  *
@@ -396,8 +460,18 @@ static bool PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy);
 static void PinBuffer_Locked(volatile BufferDesc *buf);
 static void UnpinBuffer(volatile BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
-static int	SyncOneBuffer(int buf_id, bool skip_recently_used);
+static bool EvictInactiveBuffer(int buf_id);
+static int SyncOneBuffer(int buf_id, bool skip_recently_used,
+			  WritebackContext *wb_context);
 static void WaitIO(volatile BufferDesc *buf);
+static volatile BufferDesc *AsyncReadStart(SMgrRelation smgr,
+			   char relpersistence, ForkNumber forkNum, BlockNumber blockNum,
+			   BufferAccessStrategy strategy, bool *hit, bool submit);
+static int	AsyncReadFind(volatile BufferDesc *buf);
+static void AsyncReadComplete(int i);
+static void ReadBuffersIssue(SMgrRelation smgr, ForkNumber forkNum);
+static void AbandonAsyncReads(void);
+static void BufferLockAcquire(LWLock *lock, LWLockMode mode);
 static bool StartBufferIO(volatile BufferDesc *buf, bool forInput);
 static void TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 				  int set_flag_bits);
@@ -410,9 +484,16 @@ static volatile BufferDesc *BufferAlloc(SMgrRelation smgr,
 			BufferAccessStrategy strategy,
 			bool *foundPtr);
 static void FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln);
+static void FindAndDropRelFileNodeBuffers(RelFileNode rnode,
+							  ForkNumber forkNum,
+							  BlockNumber nForkBlock,
+							  BlockNumber firstDelBlock);
 static void AtProcExit_Buffers(int code, Datum arg);
 static void CheckForBufferLeaks(void);
 static int	rnode_comparator(const void *p1, const void *p2);
+static int	buffertag_comparator(const void *p1, const void *p2);
+static int	ckpt_buforder_comparator(const void *pa, const void *pb);
+static int	ts_ckpt_progress_comparator(Datum a, Datum b, void *arg);
 
 
 /*
@@ -445,42 +526,79 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum);
 	}
 	else
-	{
-		BufferTag	newTag;		/* identity of requested block */
-		uint32		newHash;	/* hash value for newTag */
-		LWLock	   *newPartitionLock;	/* buffer partition lock for it */
-		int			buf_id;
+		(void) PrefetchSharedBuffer(reln->rd_smgr,
+									reln->rd_rel->relpersistence,
+									forkNum, blockNum);
+#endif   /* USE_PREFETCH */
+}
 
-		/* create a tag so we can lookup the buffer */
-		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
-					   forkNum, blockNum);
+/*
+ * PrefetchSharedBuffer -- guts of PrefetchBuffer for shared buffers
+ *
+ * This only needs an smgr relation, so that it can also be used during WAL
+ * replay, where there's no relcache.  Returns true if the block was found in
+ * the buffer pool already, false if a read of it was initiated (or would have
+ * been, if prefetching were compiled in).
+ */
+bool
+PrefetchSharedBuffer(SMgrRelation smgr_reln, char relpersistence,
+					 ForkNumber forkNum, BlockNumber blockNum)
+{
+	BufferTag	newTag;			/* identity of requested block */
+	uint32		newHash;		/* hash value for newTag */
+	int			buf_id;
 
-		/* determine its hash code and partition lock ID */
-		newHash = BufTableHashCode(&newTag);
-		newPartitionLock = BufMappingPartitionLock(newHash);
+	Assert(BlockNumberIsValid(blockNum));
 
-		/* see if the block is in the buffer pool already */
-		LWLockAcquire(newPartitionLock, LW_SHARED);
-		buf_id = BufTableLookup(&newTag, newHash);
-		LWLockRelease(newPartitionLock);
+	/* create a tag so we can lookup the buffer */
+	INIT_BUFFERTAG(newTag, smgr_reln->smgr_rnode.node, forkNum, blockNum);
 
-		/* If not in buffers, initiate prefetch */
-		if (buf_id < 0)
-			smgrprefetch(reln->rd_smgr, forkNum, blockNum);
+	/* determine its hash code */
+	newHash = BufTableHashCode(&newTag);
 
-		/*
-		 * If the block *is* in buffers, we do nothing.  This is not really
-		 * ideal: the block might be just about to be evicted, which would be
-		 * stupid since we know we are going to need it soon.  But the only
-		 * easy answer is to bump the usage_count, which does not seem like a
-		 * great solution: when the caller does ultimately touch the block,
-		 * usage_count would get bumped again, resulting in too much
-		 * favoritism for blocks that are involved in a prefetch sequence. A
-		 * real fix would involve some additional per-buffer state, and it's
-		 * not clear that there's enough of a problem to justify that.
-		 */
+	/*
+	 * See if the block is in the buffer pool already.  This is only a hint
+	 * anyway, so there's no need to lock the mapping partition.
+	 */
+	buf_id = BufTableLookupUnlocked(&newTag, newHash);
+
+	/*
+	 * If the block *is* in buffers, we do nothing.  This is not really
+	 * ideal: the block might be just about to be evicted, which would be
+	 * stupid since we know we are going to need it soon.  But the only easy
+	 * answer is to bump the usage_count, which does not seem like a great
+	 * solution: when the caller does ultimately touch the block, usage_count
+	 * would get bumped again, resulting in too much favoritism for blocks
+	 * that are involved in a prefetch sequence. A real fix would involve some
+	 * additional per-buffer state, and it's not clear that there's enough of
+	 * a problem to justify that.
+	 */
+	if (buf_id >= 0)
+		return true;
+
+#ifdef USE_PREFETCH
+
+	/*
+	 * Initiate prefetch.  If we can, read it into a buffer asynchronously,
+	 * rather than just hinting the kernel to read it into its cache.  The
+	 * read holds its own pin, so we can drop the one we got; it'll be
+	 * completed by whoever needs the buffer first.
+	 */
+	if (NumAsyncReads < MAX_ASYNC_READS && FileAsyncReadsAvailable())
+	{
+		volatile BufferDesc *bufHdr;
+		bool		hit;
+
+		bufHdr = AsyncReadStart(smgr_reln, relpersistence,
+								forkNum, blockNum, NULL, &hit, true);
+		ReleaseBuffer(BufferDescriptorGetBuffer(bufHdr));
+		return hit;
 	}
+	else
+		smgrprefetch(smgr_reln, forkNum, blockNum);
 #endif   /* USE_PREFETCH */
+
+	return false;
 }
 
 
@@ -591,6 +709,206 @@ ReadBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
 							 mode, strategy, &hit);
 }
 
+/*
+ * StartReadBuffer -- start reading a block of a relation into a buffer,
+ *		without waiting for the read to finish
+ *
+ * Returns the pinned buffer, like ReadBufferExtended in RBM_NORMAL mode, but
+ * its contents can't be used until WaitReadBuffer has been called for it.
+ * That gives the kernel a chance to read the page while the caller gets on
+ * with something else, such as starting reads of other pages.  If io_method
+ * doesn't allow asynchronous reads, or the page is already in the buffer
+ * pool, this is just ReadBufferExtended, and WaitReadBuffer does nothing.
+ *
+ * Between the two calls, the caller mustn't do anything that waits for
+ * other backends, except through the buffer manager; see the buffer README.
+ */
+Buffer
+StartReadBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+				BufferAccessStrategy strategy)
+{
+	volatile BufferDesc *bufHdr;
+	bool		hit;
+
+	Assert(BlockNumberIsValid(blockNum));
+
+	if (RelationUsesLocalBuffers(reln) || !FileAsyncReadsAvailable())
+		return ReadBufferExtended(reln, forkNum, blockNum, RBM_NORMAL,
+								  strategy);
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	/* Make room for another asynchronous read, if need be */
+	if (NumAsyncReads >= MAX_ASYNC_READS)
+		AsyncReadComplete(0);
+
+	pgstat_count_buffer_read(reln);
+	bufHdr = AsyncReadStart(reln->rd_smgr, reln->rd_rel->relpersistence,
+							forkNum, blockNum, strategy, &hit, true);
+	if (hit)
+	{
+		/* count it like ReadBuffer_common would */
+		pgstat_count_buffer_hit(reln);
+		pgBufferUsage.shared_blks_hit++;
+		VacuumPageHit++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageHit;
+	}
+
+	return BufferDescriptorGetBuffer(bufHdr);
+}
+
+/*
+ * WaitReadBuffer -- wait for a read started by StartReadBuffer to finish
+ *
+ * Afterwards, the buffer is valid and the caller can lock it.
+ */
+void
+WaitReadBuffer(Buffer buffer)
+{
+	int			i;
+
+	Assert(BufferIsPinned(buffer));
+
+	if (BufferIsLocal(buffer))
+		return;
+
+	i = AsyncReadFind(GetBufferDescriptor(buffer - 1));
+	if (i >= 0)
+		AsyncReadComplete(i);
+}
+
+/*
+ * ReadBuffers -- read consecutive blocks of a relation into buffers
+ *
+ * This is like calling ReadBufferExtended in RBM_NORMAL mode for each of
+ * the nblocks blocks starting at blockNum, and returns their pinned buffers
+ * in buffers[].  But the blocks that aren't in the buffer pool are read
+ * with as few system calls as possible, by smgrreadv.
+ *
+ * To that end, the buffers are set up for the reads one by one, like for
+ * StartReadBuffer, but left pending until they can all be read together.
+ * If we have to complete one of them early, say because we need to wait
+ * for another backend that might be waiting for it, it's read by itself.
+ */
+void
+ReadBuffers(Relation reln, ForkNumber forkNum, BlockNumber blockNum,
+			int nblocks, BufferAccessStrategy strategy, Buffer *buffers)
+{
+	int			i;
+
+	Assert(nblocks > 0 && nblocks <= MAX_IO_COMBINE_LIMIT);
+
+	if (RelationUsesLocalBuffers(reln) || nblocks == 1)
+	{
+		for (i = 0; i < nblocks; i++)
+			buffers[i] = ReadBufferExtended(reln, forkNum, blockNum + i,
+											RBM_NORMAL, strategy);
+		return;
+	}
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	for (i = 0; i < nblocks; i++)
+	{
+		volatile BufferDesc *bufHdr;
+		bool		hit;
+
+		/* Make room for another entry, if need be */
+		if (NumAsyncReads >= MAX_ASYNC_READS)
+		{
+			ReadBuffersIssue(reln->rd_smgr, forkNum);
+			if (NumAsyncReads >= MAX_ASYNC_READS)
+				AsyncReadComplete(0);
+		}
+
+		pgstat_count_buffer_read(reln);
+		bufHdr = AsyncReadStart(reln->rd_smgr, reln->rd_rel->relpersistence,
+								forkNum, blockNum + i, strategy, &hit, false);
+		if (hit)
+		{
+			/* count it like ReadBuffer_common would */
+			pgstat_count_buffer_hit(reln);
+			pgBufferUsage.shared_blks_hit++;
+			VacuumPageHit++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+		}
+
+		buffers[i] = BufferDescriptorGetBuffer(bufHdr);
+	}
+
+	ReadBuffersIssue(reln->rd_smgr, forkNum);
+}
+
+/*
+ * ReadBuffersIssue -- read the blocks of ReadBuffers' pending entries
+ *
+ * They're all for the same relation fork, and appear in AsyncReads in
+ * block order.  Each run of consecutive blocks among them is read with one
+ * smgrreadv call, and then the buffers are completed like after an
+ * asynchronous read.
+ */
+static void
+ReadBuffersIssue(SMgrRelation smgr, ForkNumber forkNum)
+{
+	char	   *blocks[MAX_ASYNC_READS];
+	int			i;
+
+	i = 0;
+	while (i < NumAsyncReads)
+	{
+		BlockNumber first;
+		int			n;
+		instr_time	io_start,
+					io_time;
+
+		if (AsyncReads[i].handle != ASYNC_READ_PENDING)
+		{
+			i++;
+			continue;
+		}
+
+		first = AsyncReads[i].buf->tag.blockNum;
+		n = 0;
+		while (i + n < NumAsyncReads && n < io_combine_limit &&
+			   AsyncReads[i + n].handle == ASYNC_READ_PENDING &&
+			   AsyncReads[i + n].buf->tag.blockNum == first + n)
+		{
+			blocks[n] = (char *) BufHdrGetBlock(AsyncReads[i + n].buf);
+			n++;
+		}
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		smgrreadv(smgr, forkNum, first, blocks, n);
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_SUBTRACT(io_time, io_start);
+			pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+			INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+		}
+
+		while (n-- > 0)
+			AsyncReads[i++].handle = ASYNC_READ_DONE;
+	}
+
+	/* Now check the pages, and let everyone use the buffers */
+	i = 0;
+	while (i < NumAsyncReads)
+	{
+		if (AsyncReads[i].handle == ASYNC_READ_DONE)
+			AsyncReadComplete(i);	/* removes the entry */
+		else
+			i++;
+	}
+}
+
 
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
@@ -878,10 +1196,12 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	BufferTag	oldTag;			/* previous identity of selected buffer */
 	uint32		oldHash;		/* hash value for oldTag */
 	LWLock	   *oldPartitionLock;		/* buffer partition lock for it */
+	BufferTag	writtenTag;		/* identity of a victim we had to write */
 	BufFlags	oldFlags;
 	int			buf_id;
 	volatile BufferDesc *buf;
 	bool		valid;
+	bool		probation;
 
 	/* create a tag so we can lookup the buffer */
 	INIT_BUFFERTAG(newTag, smgr->smgr_rnode.node, forkNum, blockNum);
@@ -890,22 +1210,56 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
+	/*
+	 * See if the block is in the buffer pool already.  First try without
+	 * the mapping lock: if the lookup finds a buffer, pin it and check that
+	 * it is still assigned to our tag, which it can't stop being while we
+	 * hold the pin.  If that doesn't work out, including when the lookup
+	 * finds nothing, which it might do spuriously, do it the normal way.
+	 */
+	buf_id = BufTableLookupUnlocked(&newTag, newHash);
 	if (buf_id >= 0)
 	{
-		/*
-		 * Found it.  Now, pin the buffer so no one can steal it from the
-		 * buffer pool, and check to see if the correct data has been loaded
-		 * into the buffer.
-		 */
+		bool		same;
+
 		buf = GetBufferDescriptor(buf_id);
 
 		valid = PinBuffer(buf, strategy);
 
+		LockBufHdr(buf);
+		same = BUFFERTAGS_EQUAL(buf->tag, newTag) &&
+			(buf->flags & BM_TAG_VALID) != 0;
+		UnlockBufHdr(buf);
+
+		if (!same)
+		{
+			UnpinBuffer(buf, true);
+			buf_id = -1;
+		}
+	}
+	if (buf_id < 0)
+	{
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		if (buf_id >= 0)
+		{
+			/*
+			 * Found it.  Now, pin the buffer so no one can steal it from the
+			 * buffer pool.
+			 */
+			buf = GetBufferDescriptor(buf_id);
+
+			valid = PinBuffer(buf, strategy);
+		}
+
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
+	}
+	if (buf_id >= 0)
+	{
+		/*
+		 * Check to see if the correct data has been loaded into the buffer.
+		 */
 
 		*foundPtr = TRUE;
 
@@ -933,9 +1287,13 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	/*
 	 * Didn't find it in the buffer pool.  We'll have to initialize a new
-	 * buffer.  Remember to unlock the mapping lock while doing the work.
+	 * buffer.
+	 *
+	 * With the 2Q policy, the page goes on probation, unless it was evicted
+	 * only recently (see freelist.c).
 	 */
-	LWLockRelease(newPartitionLock);
+	probation = (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q &&
+				 (strategy != NULL || !StrategyWasEvicted(newHash)));
 
 	/* Loop here in case we have to try another victim buffer */
 	for (;;)
@@ -1021,6 +1379,11 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 				FlushBuffer(buf, NULL);
 				LWLockRelease(buf->content_lock);
 
+				/* still pinned, so the tag is the one we just wrote */
+				writtenTag = buf->tag;
+				ScheduleBufferTagForWriteback(&BackendWritebackContext,
+											  &writtenTag);
+
 				TRACE_POSTGRESQL_BUFFER_WRITE_DIRTY_DONE(forkNum, blockNum,
 											   smgr->smgr_rnode.node.spcNode,
 												smgr->smgr_rnode.node.dbNode,
@@ -1168,23 +1531,40 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	 * Clearing BM_VALID here is necessary, clearing the dirtybits is just
 	 * paranoia.  We also reset the usage_count since any recency of use of
 	 * the old content is no longer relevant.  (The usage_count starts out at
-	 * 1 so that the buffer can survive one clock-sweep pass.)
+	 * 1 so that the buffer can survive one clock-sweep pass.  A page on
+	 * probation needn't, unless it's in a strategy ring, which relies on
+	 * that.)
 	 */
 	buf->tag = newTag;
-	buf->flags &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED | BM_CHECKPOINT_NEEDED | BM_IO_ERROR | BM_PERMANENT);
+	buf->flags &= ~(BM_VALID | BM_DIRTY | BM_JUST_DIRTIED | BM_CHECKPOINT_NEEDED | BM_IO_ERROR | BM_PERMANENT | BM_PROBATION);
 	if (relpersistence == RELPERSISTENCE_PERMANENT)
 		buf->flags |= BM_TAG_VALID | BM_PERMANENT;
 	else
 		buf->flags |= BM_TAG_VALID;
 	buf->usage_count = 1;
+	if (probation)
+	{
+		buf->flags |= BM_PROBATION;
+		if (strategy == NULL)
+			buf->usage_count = 0;
+	}
 
 	UnlockBufHdr(buf);
 
+	if ((oldFlags & BM_PROBATION) && !probation)
+		StrategyAdjustProbation(buf, -1);
+	else if (!(oldFlags & BM_PROBATION) && probation)
+		StrategyAdjustProbation(buf, 1);
+
 	if (oldFlags & BM_TAG_VALID)
 	{
 		BufTableDelete(&oldTag, oldHash);
 		if (oldPartitionLock != newPartitionLock)
 			LWLockRelease(oldPartitionLock);
+
+		/* remember the old page in case it's needed again soon */
+		if (strategy == NULL)
+			StrategyRememberEvicted(oldHash);
 	}
 
 	LWLockRelease(newPartitionLock);
@@ -1290,6 +1670,9 @@ retry:
 
 	UnlockBufHdr(buf);
 
+	if (oldFlags & BM_PROBATION)
+		StrategyAdjustProbation(buf, -1);
+
 	/*
 	 * Remove the buffer from the lookup hashtable, if it was in there.
 	 */
@@ -1434,6 +1817,8 @@ PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy)
 
 	if (ref == NULL)
 	{
+		bool		promoted = false;
+
 		ReservePrivateRefCountEntry();
 		ref = NewPrivateRefCountEntry(b);
 
@@ -1443,6 +1828,13 @@ PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy)
 		{
 			if (buf->usage_count < BM_MAX_USAGE_COUNT)
 				buf->usage_count++;
+
+			/* used again, so it's off probation */
+			if (buf->flags & BM_PROBATION)
+			{
+				buf->flags &= ~BM_PROBATION;
+				promoted = true;
+			}
 		}
 		else
 		{
@@ -1451,11 +1843,18 @@ PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy)
 		}
 		result = (buf->flags & BM_VALID) != 0;
 		UnlockBufHdr(buf);
+
+		if (promoted)
+			StrategyAdjustProbation(buf, -1);
 	}
 	else
 	{
-		/* If we previously pinned the buffer, it must surely be valid */
-		result = true;
+		/*
+		 * If we previously pinned the buffer, it must surely be valid,
+		 * unless the pin is one of our asynchronous reads into it.  We're
+		 * the one to set BM_VALID then, so no need for the spinlock.
+		 */
+		result = (NumAsyncReads == 0 || (buf->flags & BM_VALID) != 0);
 	}
 
 	ref->refcount++;
@@ -1570,15 +1969,27 @@ UnpinBuffer(volatile BufferDesc *buf, bool fixOwner)
  * CHECKPOINT_END_OF_RECOVERY or CHECKPOINT_FLUSH_ALL is set, we write even
  * unlogged buffers, which are otherwise skipped.  The remaining flags
  * currently have no effect here.
+ *
+ * The buffers are written in file and block order, rather than in the order
+ * they happen to sit in the pool, so that the kernel sees mostly sequential
+ * writes.  Writes to different tablespaces are interleaved in proportion to
+ * the number of buffers each of them has to write, so that all the disks get
+ * a share of the I/O throughout the checkpoint.
  */
 static void
 BufferSync(int flags)
 {
 	int			buf_id;
 	int			num_to_scan;
-	int			num_to_write;
+	int			num_spaces;
+	int			num_processed;
 	int			num_written;
+	CkptTsStatus *per_ts_stat = NULL;
+	Oid			last_tsid;
+	binaryheap *ts_heap;
+	int			i;
 	int			mask = BM_DIRTY;
+	WritebackContext wb_context;
 
 	/* Make sure we can handle the pin inside SyncOneBuffer */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
@@ -1594,8 +2005,9 @@ BufferSync(int flags)
 
 	/*
 	 * Loop over all buffers, and mark the ones that need to be written with
-	 * BM_CHECKPOINT_NEEDED.  Count them as we go (num_to_write), so that we
-	 * can estimate how much work needs to be done.
+	 * BM_CHECKPOINT_NEEDED.  Count them as we go (num_to_scan), so that we
+	 * can estimate how much work needs to be done.  Remember their tags in
+	 * CkptBufferIds, so that we can sort them.
 	 *
 	 * This allows us to write only those pages that were dirty when the
 	 * checkpoint began, and not those that get dirtied while it proceeds.
@@ -1608,7 +2020,7 @@ BufferSync(int flags)
 	 * BM_CHECKPOINT_NEEDED still set.  This is OK since any such buffer would
 	 * certainly need to be written for the next checkpoint attempt, too.
 	 */
-	num_to_write = 0;
+	num_to_scan = 0;
 	for (buf_id = 0; buf_id < NBuffers; buf_id++)
 	{
 		volatile BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
@@ -1621,86 +2033,204 @@ BufferSync(int flags)
 
 		if ((bufHdr->flags & mask) == mask)
 		{
+			CkptSortItem *item;
+
 			bufHdr->flags |= BM_CHECKPOINT_NEEDED;
-			num_to_write++;
+
+			item = &CkptBufferIds[num_to_scan++];
+			item->buf_id = buf_id;
+			item->tsId = bufHdr->tag.rnode.spcNode;
+			item->relNode = bufHdr->tag.rnode.relNode;
+			item->forkNum = bufHdr->tag.forkNum;
+			item->blockNum = bufHdr->tag.blockNum;
 		}
 
 		UnlockBufHdr(bufHdr);
 	}
 
-	if (num_to_write == 0)
+	if (num_to_scan == 0)
 		return;					/* nothing to do */
 
-	TRACE_POSTGRESQL_BUFFER_SYNC_START(NBuffers, num_to_write);
+	WritebackContextInit(&wb_context, &checkpoint_flush_after);
+
+	TRACE_POSTGRESQL_BUFFER_SYNC_START(NBuffers, num_to_scan);
 
 	/*
-	 * Loop over all buffers again, and write the ones (still) marked with
-	 * BM_CHECKPOINT_NEEDED.  In this loop, we start at the clock sweep point
-	 * since we might as well dump soon-to-be-recycled buffers first.
-	 *
-	 * Note that we don't read the buffer alloc count here --- that should be
-	 * left untouched till the next BgBufferSync() call.
+	 * Sort buffers that need to be written to reduce the likelihood of random
+	 * IO.  The sorting is also important for the implementation of balancing
+	 * writes between tablespaces.  Without balancing writes we'd potentially
+	 * end up writing to the tablespaces one-by-one; possibly overloading the
+	 * underlying system.
 	 */
-	buf_id = StrategySyncStart(NULL, NULL);
-	num_to_scan = NBuffers;
-	num_written = 0;
-	while (num_to_scan-- > 0)
+	qsort(CkptBufferIds, num_to_scan, sizeof(CkptSortItem),
+		  ckpt_buforder_comparator);
+
+	num_spaces = 0;
+
+	/*
+	 * Allocate progress status for each tablespace with buffers that need to
+	 * be flushed.  This requires the to-be-flushed array to be sorted.
+	 */
+	last_tsid = InvalidOid;
+	for (i = 0; i < num_to_scan; i++)
 	{
-		volatile BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
+		CkptTsStatus *s;
+		Oid			cur_tsid;
+
+		cur_tsid = CkptBufferIds[i].tsId;
 
 		/*
-		 * We don't need to acquire the lock here, because we're only looking
-		 * at a single bit. It's possible that someone else writes the buffer
-		 * and clears the flag right after we check, but that doesn't matter
-		 * since SyncOneBuffer will then do nothing.  However, there is a
-		 * further race condition: it's conceivable that between the time we
-		 * examine the bit here and the time SyncOneBuffer acquires lock,
-		 * someone else not only wrote the buffer but replaced it with another
-		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
-		 * write the buffer though we didn't need to.  It doesn't seem worth
-		 * guarding against this, though.
+		 * Grow array of per-tablespace status structs, every time a new
+		 * tablespace is found.
 		 */
-		if (bufHdr->flags & BM_CHECKPOINT_NEEDED)
+		if (last_tsid == InvalidOid || last_tsid != cur_tsid)
 		{
-			if (SyncOneBuffer(buf_id, false) & BUF_WRITTEN)
-			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				BgWriterStats.m_buf_written_checkpoints++;
-				num_written++;
+			Size		sz;
 
-				/*
-				 * We know there are at most num_to_write buffers with
-				 * BM_CHECKPOINT_NEEDED set; so we can stop scanning if
-				 * num_written reaches num_to_write.
-				 *
-				 * Note that num_written doesn't include buffers written by
-				 * other backends, or by the bgwriter cleaning scan. That
-				 * means that the estimate of how much progress we've made is
-				 * conservative, and also that this test will often fail to
-				 * trigger.  But it seems worth making anyway.
-				 */
-				if (num_written >= num_to_write)
-					break;
+			num_spaces++;
 
-				/*
-				 * Sleep to throttle our I/O rate.
-				 */
-				CheckpointWriteDelay(flags, (double) num_written / num_to_write);
-			}
-		}
+			/*
+			 * Not worth adding grow-by-power-of-2 logic here - even with a
+			 * few hundred tablespaces this should be fine.
+			 */
+			sz = sizeof(CkptTsStatus) * num_spaces;
 
-		if (++buf_id >= NBuffers)
-			buf_id = 0;
-	}
+			if (per_ts_stat == NULL)
+				per_ts_stat = (CkptTsStatus *) palloc(sz);
+			else
+				per_ts_stat = (CkptTsStatus *) repalloc(per_ts_stat, sz);
 
-	/*
-	 * Update checkpoint statistics. As noted above, this doesn't include
-	 * buffers written by other backends or bgwriter scan.
-	 */
-	CheckpointStats.ckpt_bufs_written += num_written;
+			s = &per_ts_stat[num_spaces - 1];
+			memset(s, 0, sizeof(*s));
+			s->tsId = cur_tsid;
 
-	TRACE_POSTGRESQL_BUFFER_SYNC_DONE(NBuffers, num_written, num_to_write);
-}
+			/*
+			 * The first buffer in this tablespace.  As CkptBufferIds is
+			 * sorted by tablespace all (s->num_to_scan) buffers in this
+			 * tablespace will follow afterwards.
+			 */
+			s->index = i;
+
+			/*
+			 * progress_slice will be determined once we know how many
+			 * buffers are in each tablespace, i.e. after this loop.
+			 */
+
+			last_tsid = cur_tsid;
+		}
+		else
+		{
+			s = &per_ts_stat[num_spaces - 1];
+		}
+
+		s->num_to_scan++;
+	}
+
+	Assert(num_spaces > 0);
+
+	/*
+	 * Build a min-heap over the write-progress in the individual tablespaces,
+	 * and compute how large a portion of the total progress a single
+	 * processed buffer is.
+	 */
+	ts_heap = binaryheap_allocate(num_spaces,
+								  ts_ckpt_progress_comparator,
+								  NULL);
+
+	for (i = 0; i < num_spaces; i++)
+	{
+		CkptTsStatus *ts_stat = &per_ts_stat[i];
+
+		ts_stat->progress_slice = (float8) num_to_scan / ts_stat->num_to_scan;
+
+		binaryheap_add_unordered(ts_heap, PointerGetDatum(ts_stat));
+	}
+
+	binaryheap_build(ts_heap);
+
+	/*
+	 * Iterate through to-be-checkpointed buffers and write the ones (still)
+	 * marked with BM_CHECKPOINT_NEEDED.  The writes are balanced between
+	 * tablespaces; otherwise the sorting would lead to only one tablespace
+	 * receiving writes at a time, making inefficient use of the hardware.
+	 */
+	num_processed = 0;
+	num_written = 0;
+	while (!binaryheap_empty(ts_heap))
+	{
+		volatile BufferDesc *bufHdr;
+		CkptTsStatus *ts_stat = (CkptTsStatus *)
+		DatumGetPointer(binaryheap_first(ts_heap));
+
+		buf_id = CkptBufferIds[ts_stat->index].buf_id;
+		Assert(buf_id != -1);
+
+		bufHdr = GetBufferDescriptor(buf_id);
+
+		num_processed++;
+
+		/*
+		 * We don't need to acquire the lock here, because we're only looking
+		 * at a single bit. It's possible that someone else writes the buffer
+		 * and clears the flag right after we check, but that doesn't matter
+		 * since SyncOneBuffer will then do nothing.  However, there is a
+		 * further race condition: it's conceivable that between the time we
+		 * examine the bit here and the time SyncOneBuffer acquires lock,
+		 * someone else not only wrote the buffer but replaced it with another
+		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
+		 * write the buffer though we didn't need to.  It doesn't seem worth
+		 * guarding against this, though.
+		 */
+		if (bufHdr->flags & BM_CHECKPOINT_NEEDED)
+		{
+			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
+			{
+				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
+				BgWriterStats.m_buf_written_checkpoints++;
+				num_written++;
+			}
+		}
+
+		/*
+		 * Measure progress independent of actually having to flush the
+		 * buffer - otherwise writing become unbalanced.
+		 */
+		ts_stat->progress += ts_stat->progress_slice;
+		ts_stat->num_scanned++;
+		ts_stat->index++;
+
+		/* Have all the buffers from the tablespace been processed? */
+		if (ts_stat->num_scanned == ts_stat->num_to_scan)
+		{
+			binaryheap_remove_first(ts_heap);
+		}
+		else
+		{
+			/* update heap with the new progress */
+			binaryheap_replace_first(ts_heap, PointerGetDatum(ts_stat));
+		}
+
+		/*
+		 * Sleep to throttle our I/O rate.
+		 */
+		CheckpointWriteDelay(flags, (double) num_processed / num_to_scan);
+	}
+
+	/* issue all pending flushes */
+	IssuePendingWritebacks(&wb_context);
+
+	pfree(per_ts_stat);
+	per_ts_stat = NULL;
+	binaryheap_free(ts_heap);
+
+	/*
+	 * Update checkpoint statistics. As noted above, this doesn't include
+	 * buffers written by other backends or bgwriter scan.
+	 */
+	CheckpointStats.ckpt_bufs_written += num_written;
+
+	TRACE_POSTGRESQL_BUFFER_SYNC_DONE(NBuffers, num_written, num_to_scan);
+}
 
 /*
  * BgBufferSync -- Write out some dirty buffers in the pool.
@@ -1712,9 +2242,12 @@ BufferSync(int flags)
  * has been "lapped" and no buffer allocations have occurred recently,
  * or if the bgwriter has been effectively disabled by setting
  * bgwriter_lru_maxpages to 0.)
+ *
+ * Writeback requests for the buffers written are queued in wb_context; the
+ * caller is responsible for issuing whatever is left pending.
  */
 bool
-BgBufferSync(void)
+BgBufferSync(WritebackContext *wb_context)
 {
 	/* info obtained from freelist.c */
 	int			strategy_buf_id;
@@ -1939,7 +2472,8 @@ BgBufferSync(void)
 	/* Execute the LRU scan */
 	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
 	{
-		int			buffer_state = SyncOneBuffer(next_to_clean, true);
+		int			buffer_state = SyncOneBuffer(next_to_clean, true,
+													 wb_context);
 
 		if (++next_to_clean >= NBuffers)
 		{
@@ -2013,13 +2547,18 @@ BgBufferSync(void)
  * (BUF_WRITTEN could be set in error if FlushBuffers finds the buffer clean
  * after locking it, but we don't care all that much.)
  *
+ * If wb_context isn't NULL, a writeback request is scheduled for a buffer we
+ * wrote, so that the kernel starts writing it to disk soon.
+ *
  * Note: caller must have done ResourceOwnerEnlargeBuffers.
  */
 static int
-SyncOneBuffer(int buf_id, bool skip_recently_used)
+SyncOneBuffer(int buf_id, bool skip_recently_used,
+			  WritebackContext *wb_context)
 {
 	volatile BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
 	int			result = 0;
+	BufferTag	tag;
 
 	ReservePrivateRefCountEntry();
 
@@ -2060,11 +2599,163 @@ SyncOneBuffer(int buf_id, bool skip_recently_used)
 	FlushBuffer(bufHdr, NULL);
 
 	LWLockRelease(bufHdr->content_lock);
+
+	/* the tag can't change as long as we hold the pin */
+	tag = bufHdr->tag;
+
 	UnpinBuffer(bufHdr, true);
 
+	if (wb_context != NULL)
+		ScheduleBufferTagForWriteback(wb_context, &tag);
+
 	return result | BUF_WRITTEN;
 }
 
+/*
+ * AdjustActiveBuffers -- bring the number of buffers in use in line with
+ *		active_shared_buffers
+ *
+ * Called by the bgwriter in each cycle.  Buffers are taken into use right
+ * away.  When buffers are taken out of use, they are no longer handed out
+ * for new pages, but may still hold pages, possibly dirty and pinned.  So
+ * in each cycle, we write out and evict what we can, and once they are all
+ * empty, give their memory back to the kernel.
+ *
+ * Returns true if there's nothing left to do.
+ */
+bool
+AdjustActiveBuffers(void)
+{
+	static bool inactive_released = false;
+	int			target;
+	int			buf_id;
+	bool		done = true;
+
+	if (active_shared_buffers < 0 || active_shared_buffers > NBuffers)
+		target = NBuffers;
+	else
+		target = active_shared_buffers;
+	if (target != StrategyActiveBuffers())
+	{
+		int			oldactive = StrategyActiveBuffers();
+
+		StrategySetActiveBuffers(target);
+		/* the partitions' minimum sizes may keep it from changing at all */
+		if (StrategyActiveBuffers() != oldactive)
+		{
+			elog(DEBUG1, "using %d of %d shared buffers",
+				 StrategyActiveBuffers(), NBuffers);
+			inactive_released = false;
+		}
+	}
+
+	if (inactive_released || StrategyActiveBuffers() == NBuffers)
+		return true;
+
+	/* Make sure we can handle the pin inside EvictInactiveBuffer */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+	for (buf_id = 0; buf_id < NBuffers; buf_id++)
+	{
+		if (StrategyBufferIsActive(buf_id))
+			continue;
+		if (!EvictInactiveBuffer(buf_id))
+			done = false;
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	if (done)
+	{
+		StrategyReleaseInactiveBuffers();
+		inactive_released = true;
+	}
+
+	return done;
+}
+
+/*
+ * EvictInactiveBuffer -- empty a buffer that is out of use
+ *
+ * A dirty buffer is written out first.  Unlike InvalidateBuffer(), we don't
+ * wait for anybody: if the buffer is pinned, or dirtied again while we
+ * write it, we give up and let the caller try again later.
+ *
+ * Returns true if the buffer is empty.
+ *
+ * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ */
+static bool
+EvictInactiveBuffer(int buf_id)
+{
+	volatile BufferDesc *bufHdr = GetBufferDescriptor(buf_id);
+	BufferTag	oldTag;
+	uint32		oldHash;
+	LWLock	   *oldPartitionLock;
+	BufFlags	oldFlags;
+
+	ReservePrivateRefCountEntry();
+
+	LockBufHdr(bufHdr);
+	if (bufHdr->refcount != 0)
+	{
+		UnlockBufHdr(bufHdr);
+		return false;
+	}
+	if (!(bufHdr->flags & BM_TAG_VALID))
+	{
+		UnlockBufHdr(bufHdr);
+		return true;
+	}
+
+	if (bufHdr->flags & BM_DIRTY)
+	{
+		/* Pin it, share-lock it, write it, as in SyncOneBuffer() */
+		PinBuffer_Locked(bufHdr);
+		LWLockAcquire(bufHdr->content_lock, LW_SHARED);
+		FlushBuffer(bufHdr, NULL);
+		LWLockRelease(bufHdr->content_lock);
+		UnpinBuffer(bufHdr, true);
+		LockBufHdr(bufHdr);
+	}
+
+	oldTag = bufHdr->tag;
+	UnlockBufHdr(bufHdr);
+
+	oldHash = BufTableHashCode(&oldTag);
+	oldPartitionLock = BufMappingPartitionLock(oldHash);
+	LWLockAcquire(oldPartitionLock, LW_EXCLUSIVE);
+
+	/*
+	 * Nobody can pin the buffer now without the mapping lock, but it might
+	 * have been pinned, dirtied or even recycled while we didn't hold the
+	 * header lock.
+	 */
+	LockBufHdr(bufHdr);
+	if (!BUFFERTAGS_EQUAL(bufHdr->tag, oldTag) ||
+		!(bufHdr->flags & BM_TAG_VALID) ||
+		bufHdr->refcount != 0 || (bufHdr->flags & BM_DIRTY))
+	{
+		UnlockBufHdr(bufHdr);
+		LWLockRelease(oldPartitionLock);
+		return false;
+	}
+
+	oldFlags = bufHdr->flags;
+	CLEAR_BUFFERTAG(bufHdr->tag);
+	bufHdr->flags = 0;
+	bufHdr->usage_count = 0;
+	UnlockBufHdr(bufHdr);
+
+	if (oldFlags & BM_PROBATION)
+		StrategyAdjustProbation(bufHdr, -1);
+
+	BufTableDelete(&oldTag, oldHash);
+	LWLockRelease(oldPartitionLock);
+
+	/* it's not put on the freelist; that happens if it comes into use */
+	return true;
+}
+
 /*
  *		AtEOXact_Buffers - clean up at end of transaction.
  *
@@ -2075,6 +2766,9 @@ SyncOneBuffer(int buf_id, bool skip_recently_used)
 void
 AtEOXact_Buffers(bool isCommit)
 {
+	/* nobody is going to wait for reads started in this transaction now */
+	AbandonAsyncReads();
+
 	CheckForBufferLeaks();
 
 	AtEOXact_LocalBuffers(isCommit);
@@ -2107,6 +2801,8 @@ InitBufferPoolAccess(void)
 
 	PrivateRefCountHash = hash_create("PrivateRefCount", 100, &hash_ctl,
 									  HASH_ELEM | HASH_BLOBS);
+
+	WritebackContextInit(&BackendWritebackContext, &backend_flush_after);
 }
 
 /*
@@ -2530,16 +3226,18 @@ BufferGetLSNAtomic(Buffer buffer)
  *		that no other process could be trying to load more pages of the
  *		relation into buffers.
  *
- *		XXX currently it sequentially searches the buffer pool, should be
- *		changed to more clever ways of searching.  However, this routine
- *		is used only in code paths that aren't very performance-critical,
- *		and we shouldn't slow down the hot paths to make it faster ...
+ *		If we know the exact size of the fork, and only a few blocks are to
+ *		be dropped, we look each of them up in the buffer mapping table.
+ *		Otherwise we sequentially search the whole buffer pool, which is
+ *		expensive with a large shared_buffers.
  * --------------------------------------------------------------------
  */
 void
-DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
+DropRelFileNodeBuffers(SMgrRelation smgr_reln, ForkNumber forkNum,
 					   BlockNumber firstDelBlock)
 {
+	RelFileNodeBackend rnode = smgr_reln->smgr_rnode;
+	BlockNumber nForkBlock;
 	int			i;
 
 	/* If it's a local relation, it's localbuf.c's problem. */
@@ -2550,6 +3248,28 @@ DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
 		return;
 	}
 
+	/* InvalidateBuffer can't cope with our asynchronous reads' pins */
+	AbandonAsyncReads();
+
+	/*
+	 * Looking up the buffers one by one is only correct if we know the exact
+	 * size of the fork: a buffer left behind beyond what we think is the end
+	 * would later be written out to a file that doesn't exist any more, or
+	 * resurrect truncated blocks.  We only know the size for sure in
+	 * recovery, see smgrnblocks_cached(); that covers the replay of TRUNCATE
+	 * and DROP on a standby, where the startup process can't afford a full
+	 * scan of a large buffer pool for every record.
+	 */
+	nForkBlock = smgrnblocks_cached(smgr_reln, forkNum);
+	if (nForkBlock != InvalidBlockNumber &&
+		(nForkBlock <= firstDelBlock ||
+		 nForkBlock - firstDelBlock < BUF_DROP_FULL_SCAN_THRESHOLD))
+	{
+		FindAndDropRelFileNodeBuffers(rnode.node, forkNum, nForkBlock,
+									  firstDelBlock);
+		return;
+	}
+
 	for (i = 0; i < NBuffers; i++)
 	{
 		volatile BufferDesc *bufHdr = GetBufferDescriptor(i);
@@ -2593,28 +3313,36 @@ DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
  * --------------------------------------------------------------------
  */
 void
-DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes)
+DropRelFileNodesAllBuffers(SMgrRelation *smgr_reln, int nnodes)
 {
 	int			i,
+				j,
 				n = 0;
+	SMgrRelation *rels;
+	BlockNumber (*block)[MAX_FORKNUM + 1];
+	uint64		nBlocksToInvalidate = 0;
+	bool		cached = true;
 	RelFileNode *nodes;
 	bool		use_bsearch;
 
 	if (nnodes == 0)
 		return;
 
-	nodes = palloc(sizeof(RelFileNode) * nnodes);		/* non-local relations */
+	/* InvalidateBuffer can't cope with our asynchronous reads' pins */
+	AbandonAsyncReads();
+
+	rels = (SMgrRelation *) palloc(sizeof(SMgrRelation) * nnodes);	/* non-local relations */
 
 	/* If it's a local relation, it's localbuf.c's problem. */
 	for (i = 0; i < nnodes; i++)
 	{
-		if (RelFileNodeBackendIsTemp(rnodes[i]))
+		if (RelFileNodeBackendIsTemp(smgr_reln[i]->smgr_rnode))
 		{
-			if (rnodes[i].backend == MyBackendId)
-				DropRelFileNodeAllLocalBuffers(rnodes[i].node);
+			if (smgr_reln[i]->smgr_rnode.backend == MyBackendId)
+				DropRelFileNodeAllLocalBuffers(smgr_reln[i]->smgr_rnode.node);
 		}
 		else
-			nodes[n++] = rnodes[i].node;
+			rels[n++] = smgr_reln[i];
 	}
 
 	/*
@@ -2623,10 +3351,63 @@ DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes)
 	 */
 	if (n == 0)
 	{
-		pfree(nodes);
+		pfree(rels);
 		return;
 	}
 
+	/*
+	 * As in DropRelFileNodeBuffers, we can avoid scanning the entire buffer
+	 * pool if we know the exact size of every fork of the given relations,
+	 * and there aren't too many blocks in total.  Forks that don't exist
+	 * don't need a size.
+	 */
+	block = (BlockNumber (*)[MAX_FORKNUM + 1])
+		palloc(sizeof(BlockNumber) * n * (MAX_FORKNUM + 1));
+
+	for (i = 0; i < n && cached; i++)
+	{
+		for (j = 0; j <= MAX_FORKNUM; j++)
+		{
+			block[i][j] = smgrnblocks_cached(rels[i], (ForkNumber) j);
+
+			if (block[i][j] == InvalidBlockNumber)
+			{
+				if (!smgrexists(rels[i], (ForkNumber) j))
+					continue;
+				cached = false;
+				break;
+			}
+
+			nBlocksToInvalidate += block[i][j];
+		}
+	}
+
+	if (cached && nBlocksToInvalidate < BUF_DROP_FULL_SCAN_THRESHOLD)
+	{
+		for (i = 0; i < n; i++)
+		{
+			for (j = 0; j <= MAX_FORKNUM; j++)
+			{
+				/* ignore forks that don't exist */
+				if (block[i][j] == InvalidBlockNumber)
+					continue;
+
+				FindAndDropRelFileNodeBuffers(rels[i]->smgr_rnode.node,
+											  (ForkNumber) j, block[i][j], 0);
+			}
+		}
+
+		pfree(block);
+		pfree(rels);
+		return;
+	}
+
+	pfree(block);
+
+	nodes = (RelFileNode *) palloc(sizeof(RelFileNode) * n);
+	for (i = 0; i < n; i++)
+		nodes[i] = rels[i]->smgr_rnode.node;
+
 	/*
 	 * For low number of relations to drop just use a simple walk through, to
 	 * save the bsearch overhead. The threshold to use is rather a guess than
@@ -2681,6 +3462,65 @@ DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes)
 	}
 
 	pfree(nodes);
+	pfree(rels);
+}
+
+/* ---------------------------------------------------------------------
+ *		FindAndDropRelFileNodeBuffers
+ *
+ *		This function performs look up in BufMapping table and removes from
+ *		the buffer pool all the pages of the specified relation fork that
+ *		have block numbers >= firstDelBlock, up to nForkBlock, the size of
+ *		the fork.
+ * --------------------------------------------------------------------
+ */
+static void
+FindAndDropRelFileNodeBuffers(RelFileNode rnode, ForkNumber forkNum,
+							  BlockNumber nForkBlock,
+							  BlockNumber firstDelBlock)
+{
+	BlockNumber curBlock;
+
+	for (curBlock = firstDelBlock; curBlock < nForkBlock; curBlock++)
+	{
+		uint32		bufHash;	/* hash value for tag */
+		BufferTag	bufTag;		/* identity of requested block */
+		LWLock	   *bufPartitionLock;	/* buffer partition lock for it */
+		int			buf_id;
+		volatile BufferDesc *bufHdr;
+
+		/* create a tag so we can lookup the buffer */
+		INIT_BUFFERTAG(bufTag, rnode, forkNum, curBlock);
+
+		/* determine its hash code and partition lock ID */
+		bufHash = BufTableHashCode(&bufTag);
+		bufPartitionLock = BufMappingPartitionLock(bufHash);
+
+		/* Check that it is in the buffer pool. If not, do nothing. */
+		LWLockAcquire(bufPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&bufTag, bufHash);
+		LWLockRelease(bufPartitionLock);
+
+		if (buf_id < 0)
+			continue;
+
+		bufHdr = GetBufferDescriptor(buf_id);
+
+		/*
+		 * We need to lock the buffer header and recheck if the buffer is
+		 * still associated with the same block because the buffer could be
+		 * evicted by some other backend loading blocks for some other
+		 * relation after we release the lock on the BufMapping table.
+		 */
+		LockBufHdr(bufHdr);
+
+		if (RelFileNodeEquals(bufHdr->tag.rnode, rnode) &&
+			bufHdr->tag.forkNum == forkNum &&
+			bufHdr->tag.blockNum >= firstDelBlock)
+			InvalidateBuffer(bufHdr);	/* releases spinlock */
+		else
+			UnlockBufHdr(bufHdr);
+	}
 }
 
 /* ---------------------------------------------------------------------
@@ -3195,9 +4035,9 @@ LockBuffer(Buffer buffer, int mode)
 	if (mode == BUFFER_LOCK_UNLOCK)
 		LWLockRelease(buf->content_lock);
 	else if (mode == BUFFER_LOCK_SHARE)
-		LWLockAcquire(buf->content_lock, LW_SHARED);
+		BufferLockAcquire(buf->content_lock, LW_SHARED);
 	else if (mode == BUFFER_LOCK_EXCLUSIVE)
-		LWLockAcquire(buf->content_lock, LW_EXCLUSIVE);
+		BufferLockAcquire(buf->content_lock, LW_EXCLUSIVE);
 	else
 		elog(ERROR, "unrecognized buffer lock mode: %d", mode);
 }
@@ -3255,6 +4095,9 @@ LockBufferForCleanup(Buffer buffer)
 		return;
 	}
 
+	/* We may sleep below, so don't leave anyone waiting for our reads */
+	CompleteAsyncReads();
+
 	/* There should be exactly one local pin */
 	if (GetPrivateRefCount(buffer) != 1)
 		elog(ERROR, "incorrect local pin count: %d",
@@ -3298,7 +4141,7 @@ LockBufferForCleanup(Buffer buffer)
 			SetStartupBufferPinWaitBufId(-1);
 		}
 		else
-			ProcWaitForSignal();
+			ProcWaitForSignal(PG_WAIT_BUFFER_PIN);
 
 		/*
 		 * Remove flag marking us as waiter. Normally this will not be set
@@ -3428,11 +4271,255 @@ WaitIO(volatile BufferDesc *buf)
 		UnlockBufHdr(buf);
 		if (!(sv_flags & BM_IO_IN_PROGRESS))
 			break;
-		LWLockAcquire(buf->io_in_progress_lock, LW_SHARED);
+		BufferLockAcquire(buf->io_in_progress_lock, LW_SHARED);
 		LWLockRelease(buf->io_in_progress_lock);
 	}
 }
 
+/*
+ * AsyncReadStart -- guts of StartReadBuffer
+ *
+ * Returns the buffer pinned for the caller; *hit is set to true if it was
+ * found in the buffer pool, otherwise a read into it has been started.  If
+ * submit is false, the read is left pending instead, for ReadBuffers.
+ */
+static volatile BufferDesc *
+AsyncReadStart(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
+			   BlockNumber blockNum, BufferAccessStrategy strategy, bool *hit,
+			   bool submit)
+{
+	volatile BufferDesc *bufHdr;
+	AsyncReadEntry *entry;
+	PrivateRefCountEntry *ref;
+	bool		found;
+
+	Assert(NumAsyncReads < MAX_ASYNC_READS);
+
+	/* Make sure we will have room to remember the buffer pin */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+	bufHdr = BufferAlloc(smgr, relpersistence, forkNum, blockNum,
+						 strategy, &found);
+	*hit = found;
+	if (found)
+		return bufHdr;
+	pgBufferUsage.shared_blks_read++;
+
+	/*
+	 * BufferAlloc has started I/O on the buffer, so we hold its
+	 * io_in_progress_lock.  If starting the read fails, AbortBufferIO cleans
+	 * up as for a synchronous read.
+	 */
+	Assert(InProgressBuf == bufHdr);
+
+	entry = &AsyncReads[NumAsyncReads];
+	entry->buf = bufHdr;
+	if (submit)
+		entry->handle = smgrstartread(smgr, forkNum, blockNum,
+									  (char *) BufHdrGetBlock(bufHdr));
+	else
+		entry->handle = ASYNC_READ_PENDING;
+	NumAsyncReads++;
+
+	/*
+	 * The read holds a pin of its own, known only to us, so the caller can
+	 * release theirs while it's in progress.
+	 */
+	ref = GetPrivateRefCountEntry(BufferDescriptorGetBuffer(bufHdr), true);
+	Assert(ref != NULL);
+	ref->refcount++;
+
+	/*
+	 * We keep holding the io_in_progress_lock until the read is complete,
+	 * but unlike for a synchronous read, there's no telling how long that
+	 * will be, so let interrupts be serviced meanwhile.  Any error will
+	 * release the lock, and AbortBufferIO takes care of the rest.
+	 */
+	InProgressBuf = NULL;
+	RESUME_INTERRUPTS();
+
+	return bufHdr;
+}
+
+/*
+ * AsyncReadFind -- is one of our asynchronous reads for this buffer?
+ *
+ * Returns its index in AsyncReads, or -1.
+ */
+static int
+AsyncReadFind(volatile BufferDesc *buf)
+{
+	int			i;
+
+	for (i = 0; i < NumAsyncReads; i++)
+	{
+		if (AsyncReads[i].buf == buf)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * AsyncReadComplete -- finish the i'th of our asynchronous reads
+ *
+ * This waits for the kernel, checks the page, and marks the buffer valid
+ * for everyone, just like ReadBuffer_common does after a synchronous read.
+ */
+static void
+AsyncReadComplete(int i)
+{
+	volatile BufferDesc *buf = AsyncReads[i].buf;
+	int			handle = AsyncReads[i].handle;
+	Buffer		buffer = BufferDescriptorGetBuffer(buf);
+	Block		bufBlock = BufHdrGetBlock(buf);
+	BufferTag	tag = buf->tag;
+	SMgrRelation smgr;
+	instr_time	io_start,
+				io_time;
+
+	Assert(InProgressBuf == NULL);
+
+	/*
+	 * From here on, treat it like a synchronous read in progress, so that an
+	 * error is cleaned up the same way: hand the read's pin over to the
+	 * resource owner, and make the buffer InProgressBuf again.
+	 */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+	ResourceOwnerRememberBuffer(CurrentResourceOwner, buffer);
+
+	NumAsyncReads--;
+	memmove(&AsyncReads[i], &AsyncReads[i + 1],
+			(NumAsyncReads - i) * sizeof(AsyncReadEntry));
+
+	HOLD_INTERRUPTS();
+	InProgressBuf = buf;
+	IsForInput = true;
+
+	/* the relation might have been closed meanwhile, so look it up again */
+	smgr = smgropen(tag.rnode, InvalidBackendId);
+
+	if (handle != ASYNC_READ_DONE)
+	{
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		if (handle == ASYNC_READ_PENDING)
+			smgrread(smgr, tag.forkNum, tag.blockNum, (char *) bufBlock);
+		else
+			smgrwaitread(smgr, tag.forkNum, tag.blockNum, (char *) bufBlock,
+						 handle);
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_SUBTRACT(io_time, io_start);
+			pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
+			INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
+		}
+	}
+
+	/* check for garbage data */
+	if (!PageIsVerified((Page) bufBlock, tag.blockNum))
+	{
+		if (zero_damaged_pages)
+		{
+			ereport(WARNING,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid page in block %u of relation %s; zeroing out page",
+							tag.blockNum,
+							relpath(smgr->smgr_rnode, tag.forkNum))));
+			MemSet((char *) bufBlock, 0, BLCKSZ);
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid page in block %u of relation %s",
+							tag.blockNum,
+							relpath(smgr->smgr_rnode, tag.forkNum))));
+	}
+
+	/* Set BM_VALID, terminate IO, and wake up any waiters */
+	TerminateBufferIO(buf, false, BM_VALID);
+	UnpinBuffer(buf, true);
+
+	VacuumPageMiss++;
+	if (VacuumCostActive)
+		VacuumCostBalance += VacuumCostPageMiss;
+}
+
+/*
+ * CompleteAsyncReads -- finish all of our asynchronous reads
+ *
+ * This must be done before waiting for anything another backend might be
+ * holding while it waits for one of our reads; see the buffer README.
+ */
+void
+CompleteAsyncReads(void)
+{
+	while (NumAsyncReads > 0)
+		AsyncReadComplete(0);
+}
+
+/*
+ * AbandonAsyncReads -- forget about all of our asynchronous reads
+ *
+ * We still have to wait for the kernel to be done with the buffers, but
+ * then they're just left invalid, like after a failed read, and unpinned.
+ * This is for error cleanup and the end of the transaction, where checking
+ * the pages and complaining about them would be out of place.
+ */
+static void
+AbandonAsyncReads(void)
+{
+	while (NumAsyncReads > 0)
+	{
+		AsyncReadEntry *entry = &AsyncReads[--NumAsyncReads];
+		volatile BufferDesc *buf = entry->buf;
+
+		Assert(InProgressBuf == NULL);
+
+		if (entry->handle >= 0)
+			(void) FileWaitRead(entry->handle);
+
+		/*
+		 * After an error, LWLockReleaseAll has released the
+		 * io_in_progress_lock, and we have to re-acquire it to use
+		 * TerminateBufferIO, as in AbortBufferIO.  Otherwise we still hold
+		 * it, but without holding off interrupts.
+		 */
+		if (LWLockHeldByMe(buf->io_in_progress_lock))
+			HOLD_INTERRUPTS();
+		else
+			LWLockAcquire(buf->io_in_progress_lock, LW_EXCLUSIVE);
+
+		InProgressBuf = buf;
+		IsForInput = true;
+		TerminateBufferIO(buf, false, BM_IO_ERROR);
+
+		UnpinBuffer(buf, false);
+	}
+}
+
+/*
+ * BufferLockAcquire -- LWLockAcquire for buffer content and I/O locks
+ *
+ * If we have asynchronous reads in progress, blocking on a lock whose
+ * holder may be waiting for one of them would deadlock, so finish them
+ * first if the lock isn't free.
+ */
+static void
+BufferLockAcquire(LWLock *lock, LWLockMode mode)
+{
+	/* (while doing synchronous I/O ourselves, we can't do anything else) */
+	if (NumAsyncReads > 0 && InProgressBuf == NULL)
+	{
+		if (LWLockConditionalAcquire(lock, mode))
+			return;
+		CompleteAsyncReads();
+	}
+	LWLockAcquire(lock, mode);
+}
+
 /*
  * StartBufferIO: begin I/O on this buffer
  *	(Assumptions)
@@ -3456,13 +4543,22 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 {
 	Assert(!InProgressBuf);
 
+	/* If we're reading it in asynchronously ourselves, just finish that */
+	if (NumAsyncReads > 0)
+	{
+		int			i = AsyncReadFind(buf);
+
+		if (i >= 0)
+			AsyncReadComplete(i);
+	}
+
 	for (;;)
 	{
 		/*
 		 * Grab the io_in_progress lock so that other processes can wait for
 		 * me to finish the I/O.
 		 */
-		LWLockAcquire(buf->io_in_progress_lock, LW_EXCLUSIVE);
+		BufferLockAcquire(buf->io_in_progress_lock, LW_EXCLUSIVE);
 
 		LockBufHdr(buf);
 
@@ -3545,7 +4641,8 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
  *	but we haven't yet released buffer pins, so the buffer is still pinned.
  *
  *	If I/O was in progress, we always set BM_IO_ERROR, even though it's
- *	possible the error condition wasn't related to the I/O.
+ *	possible the error condition wasn't related to the I/O.  That includes
+ *	any asynchronous reads we had in progress.
  */
 void
 AbortBufferIO(void)
@@ -3595,6 +4692,8 @@ AbortBufferIO(void)
 		}
 		TerminateBufferIO(buf, false, BM_IO_ERROR);
 	}
+
+	AbandonAsyncReads();
 }
 
 /*
@@ -3661,3 +4760,207 @@ rnode_comparator(const void *p1, const void *p2)
 	else
 		return 0;
 }
+
+/*
+ * BufferTag comparator.
+ */
+static int
+buffertag_comparator(const void *a, const void *b)
+{
+	const BufferTag *ba = (const BufferTag *) a;
+	const BufferTag *bb = (const BufferTag *) b;
+	int			ret;
+
+	ret = rnode_comparator(&ba->rnode, &bb->rnode);
+
+	if (ret != 0)
+		return ret;
+
+	if (ba->forkNum < bb->forkNum)
+		return -1;
+	if (ba->forkNum > bb->forkNum)
+		return 1;
+
+	if (ba->blockNum < bb->blockNum)
+		return -1;
+	if (ba->blockNum > bb->blockNum)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Comparator determining the writeout order in a checkpoint.
+ *
+ * It is important that tablespaces are compared first, the logic balancing
+ * writes between tablespaces relies on it.
+ */
+static int
+ckpt_buforder_comparator(const void *pa, const void *pb)
+{
+	const CkptSortItem *a = (const CkptSortItem *) pa;
+	const CkptSortItem *b = (const CkptSortItem *) pb;
+
+	/* compare tablespace */
+	if (a->tsId < b->tsId)
+		return -1;
+	else if (a->tsId > b->tsId)
+		return 1;
+	/* compare relation */
+	if (a->relNode < b->relNode)
+		return -1;
+	else if (a->relNode > b->relNode)
+		return 1;
+	/* compare fork */
+	else if (a->forkNum < b->forkNum)
+		return -1;
+	else if (a->forkNum > b->forkNum)
+		return 1;
+	/* compare block number */
+	else if (a->blockNum < b->blockNum)
+		return -1;
+	else if (a->blockNum > b->blockNum)
+		return 1;
+	/* equal page IDs are unlikely, but not impossible */
+	return 0;
+}
+
+/*
+ * Comparator for a Min-Heap over the per-tablespace checkpoint completion
+ * progress.
+ */
+static int
+ts_ckpt_progress_comparator(Datum a, Datum b, void *arg)
+{
+	CkptTsStatus *sa = (CkptTsStatus *) DatumGetPointer(a);
+	CkptTsStatus *sb = (CkptTsStatus *) DatumGetPointer(b);
+
+	/* we want a min-heap, so return 1 for the a < b */
+	if (sa->progress < sb->progress)
+		return 1;
+	else if (sa->progress == sb->progress)
+		return 0;
+	else
+		return -1;
+}
+
+/*
+ * Initialize a writeback context, discarding potential previous state.
+ *
+ * *max_pending is a pointer instead of an immediate value, so the coalesce
+ * limits can easily changed by the GUC mechanism, and so calling code does
+ * not have to check the current configuration.  A value is 0 means that no
+ * writeback control will be performed.
+ */
+void
+WritebackContextInit(WritebackContext *context, int *max_pending)
+{
+	Assert(*max_pending <= WRITEBACK_MAX_PENDING_FLUSHES);
+
+	context->max_pending = max_pending;
+	context->nr_pending = 0;
+}
+
+/*
+ * Add buffer to list of pending writeback requests.
+ */
+void
+ScheduleBufferTagForWriteback(WritebackContext *context, BufferTag *tag)
+{
+	PendingWriteback *pending;
+
+	/*
+	 * Add buffer to the pending writeback array, unless writeback control is
+	 * disabled.
+	 */
+	if (*context->max_pending > 0)
+	{
+		Assert(*context->max_pending <= WRITEBACK_MAX_PENDING_FLUSHES);
+
+		pending = &context->pending_writebacks[context->nr_pending++];
+
+		pending->tag = *tag;
+	}
+
+	/*
+	 * Perform pending flushes if the writeback limit is exceeded.  This
+	 * includes the case where previously an item has been added, but control
+	 * is now disabled.
+	 */
+	if (context->nr_pending >= *context->max_pending)
+		IssuePendingWritebacks(context);
+}
+
+/*
+ * Issue all pending writeback requests, previously scheduled with
+ * ScheduleBufferTagForWriteback, to the OS.
+ *
+ * Because this is only used to improve the OSs IO scheduling we try to never
+ * error out - it's just a hint.
+ */
+void
+IssuePendingWritebacks(WritebackContext *context)
+{
+	int			i;
+
+	if (context->nr_pending == 0)
+		return;
+
+	/*
+	 * Executing the writes in-order can make them a lot faster, and allows to
+	 * merge writeback requests to consecutive blocks into larger writebacks.
+	 */
+	qsort(&context->pending_writebacks, context->nr_pending,
+		  sizeof(PendingWriteback), buffertag_comparator);
+
+	/*
+	 * Coalesce neighbouring writes, but nothing else.  For that we iterate
+	 * through the, now sorted, array of pending flushes, and look forward to
+	 * find all neighbouring (or identical) writes.
+	 */
+	for (i = 0; i < context->nr_pending; i++)
+	{
+		PendingWriteback *cur;
+		PendingWriteback *next;
+		SMgrRelation reln;
+		int			ahead;
+		BufferTag	tag;
+		Size		nblocks = 1;
+
+		cur = &context->pending_writebacks[i];
+		tag = cur->tag;
+
+		/*
+		 * Peek ahead, into following writeback requests, to see if they can
+		 * be combined with the current one.
+		 */
+		for (ahead = 0; i + ahead + 1 < context->nr_pending; ahead++)
+		{
+			next = &context->pending_writebacks[i + ahead + 1];
+
+			/* different file, stop */
+			if (!RelFileNodeEquals(cur->tag.rnode, next->tag.rnode) ||
+				cur->tag.forkNum != next->tag.forkNum)
+				break;
+
+			/* ok, block queued twice, skip */
+			if (cur->tag.blockNum == next->tag.blockNum)
+				continue;
+
+			/* only merge consecutive writes */
+			if (cur->tag.blockNum + 1 != next->tag.blockNum)
+				break;
+
+			nblocks++;
+			cur = next;
+		}
+
+		i += ahead;
+
+		/* and finally tell the kernel to write the data to storage */
+		reln = smgropen(tag.rnode, InvalidBackendId);
+		smgrwriteback(reln, tag.forkNum, tag.blockNum, nblocks);
+	}
+
+	context->nr_pending = 0;
+}
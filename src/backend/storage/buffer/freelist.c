@@ -15,28 +15,132 @@
  */
 #include "postgres.h"
 
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "miscadmin.h"
 #include "port/atomics.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "storage/proc.h"
+#include "utils/memutils.h"
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
+/* Which buffers a clock sweep considers, see StrategyGetBuffer() */
+#define SWEEP_ALL			0	/* all of them */
+#define SWEEP_PROBATION		1	/* only those on probation (2Q) */
+#define SWEEP_REGULAR		2	/* only those not on probation (2Q) */
+
+/* Don't make partitions smaller than this many buffers */
+#define MIN_BUFFERS_PER_PARTITION	128
+
+/* Don't let fewer than this many buffers of a partition be in use */
+#define MIN_ACTIVE_BUFFERS_PER_PARTITION	16
+
+/* How many buffer allocations before a backend rechecks its NUMA node */
+#define HOME_PARTITION_REFRESH		1024
 
 /*
- * The shared freelist control information.
+ * With the 2Q policy, when more than this fraction of a partition's buffers
+ * are on probation, victims are taken from them only.
+ */
+#define PROBATION_FRACTION	4
+
+/* GUC variables */
+int			buffer_partitions = 0;
+int			buffer_replacement_policy = BUFFER_REPLACEMENT_CLOCK;
+int			active_shared_buffers = -1;
+
+/*
+ * The 2Q policy
+ *
+ * The plain clock sweep treats a page read in by a big scan, which will
+ * never be used again, almost like one that really is used often.  So a big
+ * enough scan can push all of the working set out.  And it can take many
+ * passes of decrementing usage counts to find a victim.  With the 2Q policy,
+ * which gets its idea from the 2Q algorithm of Johnson and Shasha, a page
+ * starts out "on probation" (BM_PROBATION), and only becomes a regular page
+ * if it is used again.  As long as more than 1 / PROBATION_FRACTION of its
+ * buffers are on probation, a partition's clock sweep takes victims only
+ * from them, and leaves the usage counts of the regular pages alone.
+ * Otherwise, it works as usual but leaves the pages on probation alone.
+ * So a scan only ever recycles a fixed fraction of the buffers.
+ *
+ * What the page on probation doesn't know is whether it was evicted only
+ * recently, which would mean that it's still of use.  For that, we keep a
+ * "ghost" table of the hash codes of the tags of recently evicted pages:
+ * NBuffers entries, each remembering the last page evicted with a hash code
+ * that maps to it.  That's cheap, needs no locking as the entries are
+ * single words, and forgets at random.  A page found in the ghost table is
+ * read in as a regular page.  Buffer access strategies, which handle big
+ * scans in their own way, don't use the ghost table.
+ */
+
+/*
+ * The buffers are divided into partitions of consecutive buffers, with a
+ * clock sweep of its own in each.  If the machine has several NUMA nodes,
+ * there is normally a partition per node, and the memory of its buffers is
+ * placed on that node.  A backend takes victim buffers from the partition
+ * of the node it is running on, unless that partition's hand has gone
+ * around more than once more than another partition's; then it helps out
+ * the partition that has fallen behind, so all the buffers stay in use
+ * even if most of the activity comes from one node.  Even without NUMA,
+ * several partitions spread contention on the clock hands.
+ *
+ * Not all of the buffers need to be in use.  shared_buffers sets how many
+ * there are room for, and active_shared_buffers how many of them are used,
+ * which can be changed without a restart.  Each partition then uses only
+ * its first activeBuffers buffers; the clock sweep goes around just those,
+ * and the rest are never handed out.  When the number is lowered, the
+ * bgwriter writes out and evicts what is left in the inactive buffers, and
+ * gives their memory back to the kernel, see AdjustActiveBuffers().
  */
 typedef struct
 {
-	/* Spinlock: protects the values below */
-	slock_t		buffer_strategy_lock;
+	/* Spinlock: makes nextVictimBuffer and completePasses consistent */
+	slock_t		lock;
 
 	/*
-	 * Clock sweep hand: index of next buffer to consider grabbing. Note that
-	 * this isn't a concrete buffer - we only ever increase the value. So, to
-	 * get an actual buffer, it needs to be used modulo NBuffers.
+	 * Clock sweep hand: index of next buffer to consider grabbing, relative
+	 * to firstBuffer. Note that this isn't a concrete buffer - we only ever
+	 * increase the value. So, to get an actual buffer, it needs to be used
+	 * modulo activeBuffers.
 	 */
 	pg_atomic_uint32 nextVictimBuffer;
+	uint32		completePasses; /* Complete cycles of the clock sweep */
+
+	int			firstBuffer;	/* first buffer of the partition */
+	int			numBuffers;		/* number of buffers in the partition */
+	int			activeBuffers;	/* number of them in use, <= numBuffers */
+	int			node;			/* NUMA node of the partition, or -1 */
+
+	/* number of buffers with BM_PROBATION, for the 2Q policy */
+	pg_atomic_uint32 numProbation;
+
+	/* Statistics.  These just wrap around. */
+	pg_atomic_uint32 numAllocs; /* victims taken by local backends */
+	pg_atomic_uint32 numRemoteAllocs;	/* victims taken by others */
+} BufferStrategyPartition;
+
+/* Each partition goes in a cache line of its own, to avoid false sharing */
+typedef union
+{
+	BufferStrategyPartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} BufferStrategyPartitionPadded;
+
+/*
+ * The shared freelist control information.
+ */
+typedef struct
+{
+	/* Spinlock: protects the values below */
+	slock_t		buffer_strategy_lock;
 
 	int			firstFreeBuffer;	/* Head of list of unused buffers */
 	int			lastFreeBuffer; /* Tail of list of unused buffers */
@@ -50,7 +154,6 @@ typedef struct
 	 * Statistics.  These counters should be wide enough that they can't
 	 * overflow during a single bgwriter cycle.
 	 */
-	uint32		completePasses; /* Complete cycles of the clock sweep */
 	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
 
 	/*
@@ -58,10 +161,23 @@ typedef struct
 	 * StrategyNotifyBgWriter.
 	 */
 	int			bgwprocno;
+
+	int			numPartitions;	/* number of clock sweep partitions */
+	int			activeBuffers;	/* total of the partitions' activeBuffers */
 } BufferStrategyControl;
 
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
+static BufferStrategyPartitionPadded *StrategyPartitions = NULL;
+static uint32 *StrategyGhosts = NULL;
+
+/* The NUMA nodes of the machine, found by StrategyFindNodes() */
+static int *numaNodes = NULL;
+static int	numNumaNodes = -1;
+
+/* The partition this backend prefers, and when to check that again */
+static int	homePartition = -1;
+static int	homePartitionRefresh = 0;
 
 /*
  * private (non-shared) state for managing a ring of shared buffers to re-use.
@@ -98,19 +214,212 @@ typedef struct BufferAccessStrategyData
 
 
 /* Prototypes for internal functions */
+static void StrategyFindNodes(void);
+static int	StrategyNumPartitionsWanted(void);
+static int	StrategyHomePartition(void);
+static int	StrategyChoosePartition(void);
+static uint32 PartitionPasses(BufferStrategyPartition *part);
+static inline BufferStrategyPartition *BufferPartition(int buf_id);
 static volatile BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy);
 static void AddBufferToRing(BufferAccessStrategy strategy,
 				volatile BufferDesc *buf);
 
+/*
+ * StrategyFindNodes -- find the NUMA nodes of the machine
+ *
+ * On Linux, they are listed in sysfs.  Elsewhere, we don't know of any.
+ */
+static void
+StrategyFindNodes(void)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	int			maxnodes = 8;
+
+	numaNodes = (int *) MemoryContextAlloc(TopMemoryContext,
+										   maxnodes * sizeof(int));
+	numNumaNodes = 0;
+
+	dir = AllocateDir("/sys/devices/system/node");
+	if (dir == NULL)
+		return;
+	while ((de = ReadDir(dir, "/sys/devices/system/node")) != NULL)
+	{
+		int			node;
+		int			i;
+
+		if (strncmp(de->d_name, "node", 4) != 0 ||
+			strspn(de->d_name + 4, "0123456789") != strlen(de->d_name + 4) ||
+			de->d_name[4] == '\0')
+			continue;
+		node = atoi(de->d_name + 4);
+
+		if (numNumaNodes >= maxnodes)
+		{
+			maxnodes *= 2;
+			numaNodes = (int *) repalloc(numaNodes, maxnodes * sizeof(int));
+		}
+
+		/* keep them sorted */
+		for (i = numNumaNodes; i > 0 && numaNodes[i - 1] > node; i--)
+			numaNodes[i] = numaNodes[i - 1];
+		numaNodes[i] = node;
+		numNumaNodes++;
+	}
+	FreeDir(dir);
+}
+
+/*
+ * StrategyNumPartitionsWanted -- decide the number of partitions
+ *
+ * That's buffer_partitions, or the number of NUMA nodes if it is 0, but
+ * never so many that the partitions get too small.
+ */
+static int
+StrategyNumPartitionsWanted(void)
+{
+	int			nparts = buffer_partitions;
+
+	if (numNumaNodes < 0)
+		StrategyFindNodes();
+	if (nparts == 0)
+		nparts = numNumaNodes;
+
+	nparts = Min(nparts, NBuffers / MIN_BUFFERS_PER_PARTITION);
+	return Max(nparts, 1);
+}
+
+/*
+ * StrategyHomePartition -- the partition this backend prefers to use
+ *
+ * That is the partition of the NUMA node we're running on.  Since the
+ * kernel moves processes around, we check again every so often.  Without
+ * NUMA, we go by process ID, which spreads backends among the partitions.
+ */
+static int
+StrategyHomePartition(void)
+{
+	int			nparts = StrategyControl->numPartitions;
+
+	if (homePartition >= 0 && --homePartitionRefresh > 0)
+		return homePartition;
+	homePartitionRefresh = HOME_PARTITION_REFRESH;
+
+	homePartition = MyProcPid % nparts;
+
+#if defined(__linux__) && defined(SYS_getcpu)
+	if (nparts > 1 && numNumaNodes > 1)
+	{
+		unsigned int cpu;
+		unsigned int node;
+		int			i;
+
+		if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		{
+			for (i = 0; i < numNumaNodes; i++)
+			{
+				if (numaNodes[i] == (int) node)
+				{
+					homePartition = i % nparts;
+					break;
+				}
+			}
+		}
+	}
+#endif
+
+	return homePartition;
+}
+
+/*
+ * PartitionPasses -- how often the partition's clock hand has gone around
+ *
+ * This is read without the lock; it's only used for balancing the use of
+ * the partitions, so it doesn't need to be exact.
+ */
+static uint32
+PartitionPasses(BufferStrategyPartition *part)
+{
+	return part->completePasses +
+		pg_atomic_read_u32(&part->nextVictimBuffer) /
+		INT_ACCESS_ONCE(part->activeBuffers);
+}
+
+/*
+ * StrategyChoosePartition -- choose the partition to take a victim from
+ *
+ * Normally the home partition, but if it is being swept more than one pass
+ * ahead of another, the partition that lags behind the most.
+ */
+static int
+StrategyChoosePartition(void)
+{
+	int			nparts = StrategyControl->numPartitions;
+	int			home;
+	int			result;
+	uint32		minpasses;
+	int			i;
+
+	if (nparts == 1)
+		return 0;
+
+	home = StrategyHomePartition();
+	result = home;
+	minpasses = PartitionPasses(&StrategyPartitions[home].part);
+	for (i = 0; i < nparts; i++)
+	{
+		uint32		passes = PartitionPasses(&StrategyPartitions[i].part);
+
+		/* careful about wraparound */
+		if ((int32) (minpasses - passes) > 1)
+		{
+			result = i;
+			minpasses = passes;
+		}
+	}
+
+	return result;
+}
+
+/*
+ * BufferPartition -- the partition a buffer belongs to
+ *
+ * Inverts the computation of firstBuffer in StrategyInitialize().
+ */
+static inline BufferStrategyPartition *
+BufferPartition(int buf_id)
+{
+	int			nparts = StrategyControl->numPartitions;
+
+	return &StrategyPartitions[(int) ((((int64) buf_id + 1) * nparts - 1) /
+									  NBuffers)].part;
+}
+
+/*
+ * StrategyBufferIsActive -- is a buffer among those in use?
+ *
+ * The answer can change as soon as we return.  But a buffer taken out of
+ * use is only evicted under its header lock, so a caller that holds that
+ * lock and gets true can go on using the buffer.
+ */
+bool
+StrategyBufferIsActive(int buf_id)
+{
+	BufferStrategyPartition *part = BufferPartition(buf_id);
+
+	return buf_id - part->firstBuffer < INT_ACCESS_ONCE(part->activeBuffers);
+}
+
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
  *
- * Move the clock hand one buffer ahead of its current position and return the
- * id of the buffer now under the hand.
+ * Move the clock hand of the partition one buffer ahead of its current
+ * position and return the id of the buffer now under the hand.
  */
 static inline uint32
-ClockSweepTick(void)
+ClockSweepTick(BufferStrategyPartition *part)
 {
+	uint32		nactive = (uint32) INT_ACCESS_ONCE(part->activeBuffers);
 	uint32		victim;
 
 	/*
@@ -119,14 +428,14 @@ ClockSweepTick(void)
 	 * apparent order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&part->nextVictimBuffer, 1);
 
-	if (victim >= NBuffers)
+	if (victim >= nactive)
 	{
 		uint32		originalVictim = victim;
 
 		/* always wrap what we look up in BufferDescriptors */
-		victim = victim % NBuffers;
+		victim = victim % nactive;
 
 		/*
 		 * If we're the one that just caused a wraparound, force
@@ -152,19 +461,19 @@ ClockSweepTick(void)
 				 * could lead to an overflow of nextVictimBuffers, but that's
 				 * highly unlikely and wouldn't be particularly harmful.
 				 */
-				SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+				SpinLockAcquire(&part->lock);
 
-				wrapped = expected % NBuffers;
+				wrapped = expected % nactive;
 
-				success = pg_atomic_compare_exchange_u32(&StrategyControl->nextVictimBuffer,
+				success = pg_atomic_compare_exchange_u32(&part->nextVictimBuffer,
 														 &expected, wrapped);
 				if (success)
-					StrategyControl->completePasses++;
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+					part->completePasses++;
+				SpinLockRelease(&part->lock);
 			}
 		}
 	}
-	return victim;
+	return part->firstBuffer + victim;
 }
 
 /*
@@ -185,6 +494,9 @@ StrategyGetBuffer(BufferAccessStrategy strategy)
 	volatile BufferDesc *buf;
 	int			bgwprocno;
 	int			trycounter;
+	int			partno;
+	int			nparts;
+	int			i;
 
 	/*
 	 * If given a strategy object, see whether it can select a buffer. We
@@ -277,10 +589,12 @@ StrategyGetBuffer(BufferAccessStrategy strategy)
 			 * use it; discard it and retry.  (This can only happen if VACUUM
 			 * put a valid buffer in the freelist and then someone else used
 			 * it before we got to it.  It's probably impossible altogether as
-			 * of 8.3, but we'd better check anyway.)
+			 * of 8.3, but we'd better check anyway.)  If the buffer has gone
+			 * out of use since it was freed, just drop it from the list.
 			 */
 			LockBufHdr(buf);
-			if (buf->refcount == 0 && buf->usage_count == 0)
+			if (buf->refcount == 0 && buf->usage_count == 0 &&
+				StrategyBufferIsActive(buf->buf_id))
 			{
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
@@ -291,47 +605,108 @@ StrategyGetBuffer(BufferAccessStrategy strategy)
 		}
 	}
 
-	/* Nothing on the freelist, so run the "clock sweep" algorithm */
-	trycounter = NBuffers;
-	for (;;)
+	/*
+	 * Nothing on the freelist, so run the "clock sweep" algorithm, in the
+	 * partition we prefer first.
+	 */
+	nparts = StrategyControl->numPartitions;
+	partno = StrategyChoosePartition();
+	for (i = 0; i < nparts; i++)
 	{
+		BufferStrategyPartition *part =
+		&StrategyPartitions[(partno + i) % nparts].part;
+		int			nactive = INT_ACCESS_ONCE(part->activeBuffers);
+		int			sweep = SWEEP_ALL;
 
-		buf = GetBufferDescriptor(ClockSweepTick());
-
-		/*
-		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
-		 * it; decrement the usage_count (unless pinned) and keep scanning.
-		 */
-		LockBufHdr(buf);
-		if (buf->refcount == 0)
+		/* with 2Q, decide which pages to consider */
+		if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
 		{
-			if (buf->usage_count > 0)
-			{
-				buf->usage_count--;
-				trycounter = NBuffers;
-			}
+			if (pg_atomic_read_u32(&part->numProbation) >
+				(uint32) (nactive / PROBATION_FRACTION))
+				sweep = SWEEP_PROBATION;
 			else
-			{
-				/* Found a usable buffer */
-				if (strategy != NULL)
-					AddBufferToRing(strategy, buf);
-				return buf;
-			}
+				sweep = SWEEP_REGULAR;
 		}
-		else if (--trycounter == 0)
+
+		trycounter = nactive;
+		for (;;)
 		{
+			buf = GetBufferDescriptor(ClockSweepTick(part));
+
 			/*
-			 * We've scanned all the buffers without making any state changes,
-			 * so all the buffers are pinned (or were when we looked at them).
-			 * We could hope that someone will free one eventually, but it's
-			 * probably better to fail than to risk getting stuck in an
-			 * infinite loop.
+			 * If the buffer is pinned or has a nonzero usage_count, we cannot
+			 * use it; decrement the usage_count (unless pinned) and keep
+			 * scanning.  Skip it altogether if it's not the kind of page we
+			 * consider.  And skip it if it has just gone out of use; the
+			 * hand can't come back to it.
 			 */
+			LockBufHdr(buf);
+			if (!StrategyBufferIsActive(buf->buf_id))
+			{
+				UnlockBufHdr(buf);
+				continue;
+			}
+			if (buf->refcount == 0 &&
+				((sweep == SWEEP_PROBATION &&
+				  (buf->flags & (BM_TAG_VALID | BM_PROBATION)) == BM_TAG_VALID) ||
+				 (sweep == SWEEP_REGULAR && (buf->flags & BM_PROBATION))))
+			{
+				/* skip it, but don't go around forever */
+				if (--trycounter == 0)
+				{
+					sweep = SWEEP_ALL;
+					trycounter = nactive;
+				}
+			}
+			else if (buf->refcount == 0)
+			{
+				if (buf->usage_count > 0)
+				{
+					buf->usage_count--;
+					trycounter = nactive;
+				}
+				else
+				{
+					/* Found a usable buffer */
+					if (nparts > 1 && (partno + i) % nparts != homePartition)
+						pg_atomic_fetch_add_u32(&part->numRemoteAllocs, 1);
+					else
+						pg_atomic_fetch_add_u32(&part->numAllocs, 1);
+					if (strategy != NULL)
+						AddBufferToRing(strategy, buf);
+					return buf;
+				}
+			}
+			else if (--trycounter == 0)
+			{
+				/*
+				 * We've scanned all the buffers of the partition without
+				 * making any state changes, so they are all pinned (or were
+				 * when we looked at them), or skipped.  If we've been
+				 * skipping any, try again considering all of them, else try
+				 * the next partition.
+				 */
+				if (sweep != SWEEP_ALL)
+				{
+					sweep = SWEEP_ALL;
+					trycounter = nactive;
+					UnlockBufHdr(buf);
+					continue;
+				}
+				UnlockBufHdr(buf);
+				break;
+			}
 			UnlockBufHdr(buf);
-			elog(ERROR, "no unpinned buffers available");
 		}
-		UnlockBufHdr(buf);
 	}
+
+	/*
+	 * All the buffers are pinned.  We could hope that someone will free one
+	 * eventually, but it's probably better to fail than to risk getting
+	 * stuck in an infinite loop.
+	 */
+	elog(ERROR, "no unpinned buffers available");
+	return NULL;				/* keep compiler quiet */
 }
 
 /*
@@ -344,9 +719,11 @@ StrategyFreeBuffer(volatile BufferDesc *buf)
 
 	/*
 	 * It is possible that we are told to put something in the freelist that
-	 * is already in it; don't screw up the list if so.
+	 * is already in it; don't screw up the list if so.  Buffers out of use
+	 * don't go on it either; StrategyGetBuffer() would just drop them again.
 	 */
-	if (buf->freeNext == FREENEXT_NOT_IN_LIST)
+	if (buf->freeNext == FREENEXT_NOT_IN_LIST &&
+		StrategyBufferIsActive(buf->buf_id))
 	{
 		buf->freeNext = StrategyControl->firstFreeBuffer;
 		if (buf->freeNext < 0)
@@ -357,6 +734,24 @@ StrategyFreeBuffer(volatile BufferDesc *buf)
 	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
 }
 
+/*
+ * StrategyHaveFreeBuffer -- is there any buffer left on the freelist?
+ *
+ * This is meant for code that wants to load pages only as long as that
+ * doesn't push others out, like autoprewarm in contrib/pg_prewarm.
+ */
+bool
+StrategyHaveFreeBuffer(void)
+{
+	bool		result;
+
+	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+	result = (StrategyControl->firstFreeBuffer >= 0);
+	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+
+	return result;
+}
+
 /*
  * StrategySyncStart -- tell BufferSync where to start syncing
  *
@@ -367,27 +762,45 @@ StrategyFreeBuffer(volatile BufferDesc *buf)
  * the higher-order bits of nextVictimBuffer) and the count of recent buffer
  * allocs if non-NULL pointers are passed.  The alloc count is reset after
  * being read.
+ *
+ * With several partitions, what we report is a virtual clock hand that
+ * advances by the number of buffers all the partitions' hands have swept
+ * together.  That keeps the bgwriter's estimate of how fast buffers are
+ * being recycled right, though of course it only shows where the partitions'
+ * hands are when there is a single partition.
  */
 int
 StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
 {
-	uint32		nextVictimBuffer;
+	uint64		ticks = 0;
 	int			result;
+	int			i;
 
 	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
-	nextVictimBuffer = pg_atomic_read_u32(&StrategyControl->nextVictimBuffer);
-	result = nextVictimBuffer % NBuffers;
-
-	if (complete_passes)
+	for (i = 0; i < StrategyControl->numPartitions; i++)
 	{
-		*complete_passes = StrategyControl->completePasses;
+		BufferStrategyPartition *part = &StrategyPartitions[i].part;
+		uint32		nextVictimBuffer;
+		uint32		nactive;
+		uint64		passes;
+
+		SpinLockAcquire(&part->lock);
+		nextVictimBuffer = pg_atomic_read_u32(&part->nextVictimBuffer);
+		nactive = (uint32) part->activeBuffers;
 
 		/*
-		 * Additionally add the number of wraparounds that happened before
-		 * completePasses could be incremented. C.f. ClockSweepTick().
+		 * Add the number of wraparounds that happened before completePasses
+		 * could be incremented. C.f. ClockSweepTick().
 		 */
-		*complete_passes += nextVictimBuffer / NBuffers;
+		passes = (uint64) part->completePasses + nextVictimBuffer / nactive;
+		SpinLockRelease(&part->lock);
+
+		ticks += passes * nactive + nextVictimBuffer % nactive;
 	}
+	result = (int) (ticks % NBuffers);
+
+	if (complete_passes)
+		*complete_passes = (uint32) (ticks / NBuffers);
 
 	if (num_buf_alloc)
 	{
@@ -438,6 +851,15 @@ StrategyShmemSize(void)
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the clock sweep partitions, plus alignment padding */
+	size = add_size(size, mul_size(StrategyNumPartitionsWanted(),
+								   sizeof(BufferStrategyPartitionPadded)));
+	size = add_size(size, PG_CACHE_LINE_SIZE);
+
+	/* size of the ghost table of the 2Q policy */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+		size = add_size(size, mul_size(NBuffers, sizeof(uint32)));
+
 	return size;
 }
 
@@ -473,6 +895,10 @@ StrategyInitialize(bool init)
 						sizeof(BufferStrategyControl),
 						&found);
 
+	/* in EXEC_BACKEND children, StrategyFindNodes() hasn't been run yet */
+	if (numNumaNodes < 0)
+		StrategyFindNodes();
+
 	if (!found)
 	{
 		/*
@@ -489,18 +915,319 @@ StrategyInitialize(bool init)
 		StrategyControl->firstFreeBuffer = 0;
 		StrategyControl->lastFreeBuffer = NBuffers - 1;
 
-		/* Initialize the clock sweep pointer */
-		pg_atomic_init_u32(&StrategyControl->nextVictimBuffer, 0);
-
 		/* Clear statistics */
-		StrategyControl->completePasses = 0;
 		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
+
+		StrategyControl->numPartitions = StrategyNumPartitionsWanted();
+		StrategyControl->activeBuffers = NBuffers;
 	}
 	else
 		Assert(!init);
+
+	/*
+	 * Get or create the partitions
+	 */
+	StrategyPartitions = (BufferStrategyPartitionPadded *) CACHELINEALIGN(
+									   ShmemInitStruct("Buffer Strategy Partitions",
+						 StrategyControl->numPartitions *
+						 sizeof(BufferStrategyPartitionPadded) +
+						 PG_CACHE_LINE_SIZE,
+													   &found));
+
+	if (!found)
+	{
+		int			nparts = StrategyControl->numPartitions;
+		int			i;
+
+		for (i = 0; i < nparts; i++)
+		{
+			BufferStrategyPartition *part = &StrategyPartitions[i].part;
+
+			SpinLockInit(&part->lock);
+
+			/* Initialize the clock sweep pointer */
+			pg_atomic_init_u32(&part->nextVictimBuffer, 0);
+			part->completePasses = 0;
+
+			part->firstBuffer = (int) ((int64) NBuffers * i / nparts);
+			part->numBuffers = (int) ((int64) NBuffers * (i + 1) / nparts) -
+				part->firstBuffer;
+			part->activeBuffers = part->numBuffers;
+			part->node = (numNumaNodes > 1) ?
+				numaNodes[i % numNumaNodes] : -1;
+
+			pg_atomic_init_u32(&part->numProbation, 0);
+			pg_atomic_init_u32(&part->numAllocs, 0);
+			pg_atomic_init_u32(&part->numRemoteAllocs, 0);
+		}
+	}
+
+	/*
+	 * Get or create the ghost table
+	 */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+	{
+		StrategyGhosts = (uint32 *)
+			ShmemInitStruct("Buffer Strategy Ghosts",
+							NBuffers * sizeof(uint32), &found);
+		if (!found)
+			memset(StrategyGhosts, 0, NBuffers * sizeof(uint32));
+	}
+}
+
+/*
+ * StrategyAdjustProbation -- count a buffer going on or off probation
+ *
+ * Callers change BM_PROBATION under the buffer header lock, and then tell
+ * us with delta +1 or -1.
+ */
+void
+StrategyAdjustProbation(volatile BufferDesc *buf, int delta)
+{
+	BufferStrategyPartition *part = BufferPartition(buf->buf_id);
+
+	if (delta > 0)
+		pg_atomic_fetch_add_u32(&part->numProbation, 1);
+	else
+		pg_atomic_fetch_sub_u32(&part->numProbation, 1);
+}
+
+/*
+ * StrategyRememberEvicted -- enter an evicted page in the ghost table
+ *
+ * hashcode is the BufTableHashCode() of its tag.  Zero can't be told apart
+ * from an empty entry, but it's just one in four billion, so we don't
+ * bother.
+ */
+void
+StrategyRememberEvicted(uint32 hashcode)
+{
+	if (StrategyGhosts == NULL)
+		return;
+	((volatile uint32 *) StrategyGhosts)[hashcode % NBuffers] = hashcode;
+}
+
+/*
+ * StrategyWasEvicted -- is a page about to be read in in the ghost table?
+ *
+ * If so, it is removed, since it will be in a buffer again.  This may be
+ * fooled by an unrelated page with the same hash code, which doesn't do
+ * any harm.
+ */
+bool
+StrategyWasEvicted(uint32 hashcode)
+{
+	volatile uint32 *ghost;
+
+	if (StrategyGhosts == NULL || hashcode == 0)
+		return false;
+	ghost = &((volatile uint32 *) StrategyGhosts)[hashcode % NBuffers];
+	if (*ghost != hashcode)
+		return false;
+	*ghost = 0;
+	return true;
+}
+
+/*
+ * StrategyPlaceBuffers -- put the memory of each partition's buffers on
+ *		its NUMA node
+ *
+ * This has to be done before the memory is first touched, since that is
+ * when the kernel decides where pages go.  It's only a preference; if the
+ * node runs out of memory, pages go elsewhere.  Failures are harmless, so
+ * we only log them.
+ */
+void
+StrategyPlaceBuffers(char *blocks)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+	int			nparts = StrategyControl->numPartitions;
+	long		pagesize = sysconf(_SC_PAGESIZE);
+	int			i;
+
+	if (nparts == 1 || numNumaNodes <= 1 || pagesize <= 0)
+		return;
+
+	for (i = 0; i < nparts; i++)
+	{
+		BufferStrategyPartition *part = &StrategyPartitions[i].part;
+		uintptr_t	start;
+		uintptr_t	end;
+		unsigned long nodemask[1024 / (8 * sizeof(unsigned long))];
+
+		if (part->node < 0 || part->node >= 1024)
+			continue;
+
+		/* mbind() works on whole pages only */
+		start = TYPEALIGN(pagesize,
+						  (uintptr_t) (blocks + (Size) part->firstBuffer * BLCKSZ));
+		end = TYPEALIGN_DOWN(pagesize,
+							 (uintptr_t) (blocks + (Size) (part->firstBuffer +
+											  part->numBuffers) * BLCKSZ));
+		if (end <= start)
+			continue;
+
+		memset(nodemask, 0, sizeof(nodemask));
+		nodemask[part->node / (8 * sizeof(unsigned long))] |=
+			1UL << (part->node % (8 * sizeof(unsigned long)));
+
+		/* 1 is MPOL_PREFERRED; the kernel wants one more than the mask bits */
+		if (syscall(SYS_mbind, (void *) start, (unsigned long) (end - start),
+					1, nodemask, (unsigned long) (8 * sizeof(nodemask) + 1),
+					0) != 0)
+			elog(LOG, "could not place shared buffers on NUMA node %d: %m",
+				 part->node);
+	}
+#endif
+}
+
+/*
+ * StrategyNumPartitions -- number of clock sweep partitions
+ */
+int
+StrategyNumPartitions(void)
+{
+	return StrategyControl->numPartitions;
+}
+
+/*
+ * StrategyGetPartitionStats -- report on a clock sweep partition
+ *
+ * The counters are read without locking, so they aren't necessarily
+ * consistent with each other.
+ */
+void
+StrategyGetPartitionStats(int partno, int *first_buffer, int *num_buffers,
+						  int *node, uint32 *complete_passes,
+						  uint32 *num_allocs, uint32 *num_remote_allocs)
+{
+	BufferStrategyPartition *part;
+
+	Assert(partno >= 0 && partno < StrategyControl->numPartitions);
+	part = &StrategyPartitions[partno].part;
+
+	*first_buffer = part->firstBuffer;
+	*num_buffers = part->numBuffers;
+	*node = part->node;
+	*complete_passes = PartitionPasses(part);
+	*num_allocs = pg_atomic_read_u32(&part->numAllocs);
+	*num_remote_allocs = pg_atomic_read_u32(&part->numRemoteAllocs);
+}
+
+/*
+ * StrategyActiveBuffers -- number of buffers in use
+ */
+int
+StrategyActiveBuffers(void)
+{
+	return INT_ACCESS_ONCE(StrategyControl->activeBuffers);
+}
+
+/*
+ * StrategySetActiveBuffers -- change the number of buffers in use
+ *
+ * The buffers are taken from, or given to, the partitions in proportion to
+ * their size.  Buffers coming into use are put on the freelist if they are
+ * empty, as they will be after having been taken out of use.  Buffers
+ * going out of use are just no longer handed out; emptying them is up to
+ * the caller.
+ *
+ * Only the bgwriter calls this, so there's no need to guard against
+ * concurrent changes.
+ */
+void
+StrategySetActiveBuffers(int nbuffers)
+{
+	int			nparts = StrategyControl->numPartitions;
+	int			total = 0;
+	int			i;
+
+	nbuffers = Min(Max(nbuffers, 0), NBuffers);
+
+	for (i = 0; i < nparts; i++)
+	{
+		BufferStrategyPartition *part = &StrategyPartitions[i].part;
+		int			oldactive = part->activeBuffers;
+		int			nactive;
+		int			buf_id;
+
+		nactive = (int) ((int64) part->numBuffers * nbuffers / NBuffers);
+		nactive = Max(nactive, Min(part->numBuffers,
+								   MIN_ACTIVE_BUFFERS_PER_PARTITION));
+		total += nactive;
+
+		SpinLockAcquire(&part->lock);
+		part->activeBuffers = nactive;
+		SpinLockRelease(&part->lock);
+
+		for (buf_id = part->firstBuffer + oldactive;
+			 buf_id < part->firstBuffer + nactive;
+			 buf_id++)
+		{
+			volatile BufferDesc *buf = GetBufferDescriptor(buf_id);
+			bool		empty;
+
+			LockBufHdr(buf);
+			empty = (buf->refcount == 0 && !(buf->flags & BM_TAG_VALID));
+			UnlockBufHdr(buf);
+			if (empty)
+				StrategyFreeBuffer(buf);
+		}
+	}
+
+	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+	StrategyControl->activeBuffers = total;
+	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+}
+
+/*
+ * StrategyReleaseInactiveBuffers -- give the memory of the buffers out of
+ *		use back to the kernel
+ *
+ * The caller must have made sure that the buffers are empty, and stay so.
+ * If they come into use again, the kernel hands out fresh zeroed pages as
+ * they are touched.  This works only for whole pages of memory, so with
+ * huge pages, it may not free anything; failures are harmless, so we only
+ * log them.
+ */
+void
+StrategyReleaseInactiveBuffers(void)
+{
+#ifdef MADV_REMOVE
+	int			nparts = StrategyControl->numPartitions;
+	long		pagesize = sysconf(_SC_PAGESIZE);
+	int			i;
+
+	if (pagesize <= 0)
+		return;
+
+	for (i = 0; i < nparts; i++)
+	{
+		BufferStrategyPartition *part = &StrategyPartitions[i].part;
+		uintptr_t	start;
+		uintptr_t	end;
+
+		start = TYPEALIGN(pagesize,
+						  (uintptr_t) (BufferBlocks +
+						   (Size) (part->firstBuffer + part->activeBuffers) *
+									   BLCKSZ));
+		end = TYPEALIGN_DOWN(pagesize,
+							 (uintptr_t) (BufferBlocks +
+						 (Size) (part->firstBuffer + part->numBuffers) *
+										  BLCKSZ));
+		if (end <= start)
+			continue;
+
+		if (madvise((void *) start, (size_t) (end - start), MADV_REMOVE) != 0)
+		{
+			elog(LOG, "could not release memory of unused shared buffers: %m");
+			return;
+		}
+	}
+#endif
 }
 
 
@@ -549,8 +1276,8 @@ GetAccessStrategy(BufferAccessStrategyType btype)
 			return NULL;		/* keep compiler quiet */
 	}
 
-	/* Make sure ring isn't an undue fraction of shared buffers */
-	ring_size = Min(NBuffers / 8, ring_size);
+	/* Make sure ring isn't an undue fraction of the buffers in use */
+	ring_size = Min(StrategyActiveBuffers() / 8, ring_size);
 
 	/* Allocate the object and initialize all elements to zeroes */
 	strategy = (BufferAccessStrategy)
@@ -607,7 +1334,8 @@ GetBufferFromRing(BufferAccessStrategy strategy)
 	}
 
 	/*
-	 * If the buffer is pinned we cannot use it under any circumstances.
+	 * If the buffer is pinned or no longer in use we cannot use it under any
+	 * circumstances.
 	 *
 	 * If usage_count is 0 or 1 then the buffer is fair game (we expect 1,
 	 * since our own previous usage of the ring element would have left it
@@ -617,7 +1345,8 @@ GetBufferFromRing(BufferAccessStrategy strategy)
 	 */
 	buf = GetBufferDescriptor(bufnum - 1);
 	LockBufHdr(buf);
-	if (buf->refcount == 0 && buf->usage_count <= 1)
+	if (buf->refcount == 0 && buf->usage_count <= 1 &&
+		StrategyBufferIsActive(buf->buf_id))
 	{
 		strategy->current_was_in_ring = true;
 		return buf;
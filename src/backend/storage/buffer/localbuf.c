@@ -19,6 +19,7 @@
 #include "executor/instrument.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
@@ -50,6 +51,7 @@ static HTAB *LocalBufHash = NULL;
 
 static void InitLocalBuffers(void);
 static Block GetLocalBufferStorage(void);
+static void FlushLocalBufferRun(BufferDesc *bufHdr);
 
 
 /*
@@ -69,8 +71,11 @@ LocalPrefetchBuffer(SMgrRelation smgr, ForkNumber forkNum,
 
 	INIT_BUFFERTAG(newTag, smgr->smgr_rnode.node, forkNum, blockNum);
 
-	/* Initialize local buffers if first request in this session */
-	if (LocalBufHash == NULL)
+	/*
+	 * Initialize local buffers if first request in this session, or add
+	 * more if temp_buffers has been raised since.
+	 */
+	if (NLocBuffer < num_temp_buffers)
 		InitLocalBuffers();
 
 	/* See if the desired buffer already exists */
@@ -111,8 +116,11 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 
 	INIT_BUFFERTAG(newTag, smgr->smgr_rnode.node, forkNum, blockNum);
 
-	/* Initialize local buffers if first request in this session */
-	if (LocalBufHash == NULL)
+	/*
+	 * Initialize local buffers if first request in this session, or add
+	 * more if temp_buffers has been raised since.
+	 */
+	if (NLocBuffer < num_temp_buffers)
 		InitLocalBuffers();
 
 	/* See if the desired buffer already exists */
@@ -194,27 +202,7 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	 * the case, write it out before reusing it!
 	 */
 	if (bufHdr->flags & BM_DIRTY)
-	{
-		SMgrRelation oreln;
-		Page		localpage = (char *) LocalBufHdrGetBlock(bufHdr);
-
-		/* Find smgr relation for buffer */
-		oreln = smgropen(bufHdr->tag.rnode, MyBackendId);
-
-		PageSetChecksumInplace(localpage, bufHdr->tag.blockNum);
-
-		/* And write... */
-		smgrwrite(oreln,
-				  bufHdr->tag.forkNum,
-				  bufHdr->tag.blockNum,
-				  localpage,
-				  false);
-
-		/* Mark not-dirty now in case we error out below */
-		bufHdr->flags &= ~BM_DIRTY;
-
-		pgBufferUsage.local_blks_written++;
-	}
+		FlushLocalBufferRun(bufHdr);
 
 	/*
 	 * lazy memory allocation: allocate space on first use of a buffer.
@@ -258,6 +246,88 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	return bufHdr;
 }
 
+/*
+ * LocalBufferLookupDirty -
+ *	  return the buffer holding the given block of the same relation fork as
+ *	  tag, if there is one and it is dirty and not pinned; else NULL.
+ */
+static BufferDesc *
+LocalBufferLookupDirty(BufferTag *tag, BlockNumber blockNum)
+{
+	BufferTag	key = *tag;
+	LocalBufferLookupEnt *hresult;
+
+	key.blockNum = blockNum;
+	hresult = (LocalBufferLookupEnt *)
+		hash_search(LocalBufHash, (void *) &key, HASH_FIND, NULL);
+	if (hresult == NULL || LocalRefCount[hresult->id] != 0)
+		return NULL;
+	if (!(GetLocalBufferDescriptor(hresult->id)->flags & BM_DIRTY))
+		return NULL;
+	return GetLocalBufferDescriptor(hresult->id);
+}
+
+/*
+ * FlushLocalBufferRun -
+ *	  write out a dirty local buffer that is about to be reused, together
+ *	  with the dirty, unpinned buffers holding the blocks around it.
+ *
+ * Temp tables are usually written sequentially, and evicted in about the
+ * order they were written, so the neighbours of a dirty victim are likely
+ * to be dirty victims-to-be too.  Writing them all with one smgrwritev
+ * saves system calls, and the kernel gets the whole run at once.  The
+ * neighbours stay valid in the buffer pool, just no longer dirty.
+ */
+static void
+FlushLocalBufferRun(BufferDesc *bufHdr)
+{
+	BufferDesc *run[FILE_MAX_WRITEV];
+	char	   *pages[FILE_MAX_WRITEV];
+	BlockNumber first = bufHdr->tag.blockNum;
+	BufferDesc *neighbour;
+	SMgrRelation oreln;
+	int			nrun;
+	int			i;
+
+	/* find the start of the run ... */
+	while (first > 0 && bufHdr->tag.blockNum - first < FILE_MAX_WRITEV / 2 &&
+		   LocalBufferLookupDirty(&bufHdr->tag, first - 1) != NULL)
+		first--;
+
+	/* ... and collect it, with the victim itself in its place */
+	nrun = 0;
+	for (;;)
+	{
+		if (first + nrun == bufHdr->tag.blockNum)
+			neighbour = bufHdr;
+		else
+			neighbour = LocalBufferLookupDirty(&bufHdr->tag, first + nrun);
+		if (neighbour == NULL)
+			break;
+
+		run[nrun] = neighbour;
+		pages[nrun] = (char *) LocalBufHdrGetBlock(neighbour);
+		PageSetChecksumInplace((Page) pages[nrun], first + nrun);
+		if (++nrun == FILE_MAX_WRITEV)
+			break;
+	}
+
+	/* Find smgr relation for buffer */
+	oreln = smgropen(bufHdr->tag.rnode, MyBackendId);
+
+	/* And write... */
+	if (nrun == 1)
+		smgrwrite(oreln, bufHdr->tag.forkNum, first, pages[0], false);
+	else
+		smgrwritev(oreln, bufHdr->tag.forkNum, first, pages, nrun, false);
+
+	/* Mark not-dirty now in case we error out below */
+	for (i = 0; i < nrun; i++)
+		run[i]->flags &= ~BM_DIRTY;
+
+	pgBufferUsage.local_blks_written += nrun;
+}
+
 /*
  * MarkLocalBufferDirty -
  *	  mark a local buffer dirty
@@ -378,27 +448,52 @@ DropRelFileNodeAllLocalBuffers(RelFileNode rnode)
  *	  init the local buffer cache. Since most queries (esp. multi-user ones)
  *	  don't involve local buffers, we delay allocating actual memory for the
  *	  buffers until we need them; just make the buffer headers here.
+ *
+ *	  This is also called to add buffer headers when temp_buffers has been
+ *	  raised after the cache was initialized.  The arrays of headers, block
+ *	  pointers and reference counts may move then, but nothing outside this
+ *	  file and bufmgr.c keeps pointers into them, and those don't across
+ *	  LocalBufferAlloc.  The buffer blocks themselves stay put.  The cache
+ *	  never shrinks.
  */
 static void
 InitLocalBuffers(void)
 {
 	int			nbufs = num_temp_buffers;
+	int			oldnbufs = NLocBuffer;
 	HASHCTL		info;
+	BufferDesc *newDescriptors;
+	Block	   *newBlockPointers;
+	int32	   *newRefCount;
 	int			i;
 
+	Assert(nbufs > oldnbufs);
+
 	/* Allocate and zero buffer headers and auxiliary arrays */
-	LocalBufferDescriptors = (BufferDesc *) calloc(nbufs, sizeof(BufferDesc));
-	LocalBufferBlockPointers = (Block *) calloc(nbufs, sizeof(Block));
-	LocalRefCount = (int32 *) calloc(nbufs, sizeof(int32));
-	if (!LocalBufferDescriptors || !LocalBufferBlockPointers || !LocalRefCount)
-		ereport(FATAL,
+	newDescriptors = (BufferDesc *)
+		realloc(LocalBufferDescriptors, nbufs * sizeof(BufferDesc));
+	if (newDescriptors)
+		LocalBufferDescriptors = newDescriptors;
+	newBlockPointers = (Block *)
+		realloc(LocalBufferBlockPointers, nbufs * sizeof(Block));
+	if (newBlockPointers)
+		LocalBufferBlockPointers = newBlockPointers;
+	newRefCount = (int32 *) realloc(LocalRefCount, nbufs * sizeof(int32));
+	if (newRefCount)
+		LocalRefCount = newRefCount;
+	/* the arrays we did enlarge are fine at their old size, too */
+	if (!newDescriptors || !newBlockPointers || !newRefCount)
+		ereport(ERROR,
 				(errcode(ERRCODE_OUT_OF_MEMORY),
 				 errmsg("out of memory")));
-
-	nextFreeLocalBuf = 0;
+	MemSet(&LocalBufferDescriptors[oldnbufs], 0,
+		   (nbufs - oldnbufs) * sizeof(BufferDesc));
+	MemSet(&LocalBufferBlockPointers[oldnbufs], 0,
+		   (nbufs - oldnbufs) * sizeof(Block));
+	MemSet(&LocalRefCount[oldnbufs], 0, (nbufs - oldnbufs) * sizeof(int32));
 
 	/* initialize fields that need to start off nonzero */
-	for (i = 0; i < nbufs; i++)
+	for (i = oldnbufs; i < nbufs; i++)
 	{
 		BufferDesc *buf = GetLocalBufferDescriptor(i);
 
@@ -411,18 +506,23 @@ InitLocalBuffers(void)
 		buf->buf_id = -i - 2;
 	}
 
-	/* Create the lookup hash table */
-	MemSet(&info, 0, sizeof(info));
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(LocalBufferLookupEnt);
+	/* Create the lookup hash table, the first time; it grows by itself */
+	if (LocalBufHash == NULL)
+	{
+		MemSet(&info, 0, sizeof(info));
+		info.keysize = sizeof(BufferTag);
+		info.entrysize = sizeof(LocalBufferLookupEnt);
 
-	LocalBufHash = hash_create("Local Buffer Lookup Table",
-							   nbufs,
-							   &info,
-							   HASH_ELEM | HASH_BLOBS);
+		LocalBufHash = hash_create("Local Buffer Lookup Table",
+								   nbufs,
+								   &info,
+								   HASH_ELEM | HASH_BLOBS);
 
-	if (!LocalBufHash)
-		elog(ERROR, "could not initialize local buffer hash table");
+		if (!LocalBufHash)
+			elog(ERROR, "could not initialize local buffer hash table");
+
+		nextFreeLocalBuf = 0;
+	}
 
 	/* Initialization done, mark buffers allocated */
 	NLocBuffer = nbufs;
@@ -473,10 +573,12 @@ GetLocalBufferStorage(void)
 		/* But not more than what we need for all remaining local bufs */
 		num_bufs = Min(num_bufs, NLocBuffer - total_bufs_allocated);
 		/* And don't overflow MaxAllocSize, either */
-		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ);
+		num_bufs = Min(num_bufs, (MaxAllocSize - PG_IO_ALIGN_SIZE) / BLCKSZ);
 
+		/* Align the buffers for direct I/O, like the shared ones */
 		cur_block = (char *) MemoryContextAlloc(LocalBufferContext,
-												num_bufs * BLCKSZ);
+									   num_bufs * BLCKSZ + PG_IO_ALIGN_SIZE);
+		cur_block = (char *) TYPEALIGN(PG_IO_ALIGN_SIZE, cur_block);
 		next_buf_in_block = 0;
 		num_bufs_in_block = num_bufs;
 	}
@@ -0,0 +1,251 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.c
+ *	  Reading the blocks of a relation in the order a callback chooses.
+ *
+ * A read stream is for code that knows which blocks it's going to need
+ * next, like a sequential scan, a bitmap heap scan or VACUUM.  It asks a
+ * callback for the block numbers some way ahead of the caller, and reads
+ * each run of consecutive blocks that aren't in the buffer pool with one
+ * ReadBuffers call, that is, with one system call.  That makes up for the
+ * kernel's readahead where there is none, such as with direct_io, or where
+ * it can't tell what we're up to, such as when parallel workers each scan
+ * every few blocks of a table.
+ *
+ * The runs start out at one block and double each time one is read, up to
+ * io_combine_limit blocks, so that a scan stopped early by a LIMIT doesn't
+ * read much more than it needs.  When asynchronous reads are available and
+ * direct_io keeps the kernel from reading ahead, the stream also starts
+ * asynchronous reads of the blocks it has been told about, as far ahead as
+ * effective_io_concurrency says.
+ *
+ * The buffers of the current run are pinned until they have been handed
+ * out, so a stream holds up to io_combine_limit pins.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/read_stream.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "storage/fd.h"
+#include "storage/read_stream.h"
+#include "utils/rel.h"
+
+
+/* size of the circular queue of upcoming blocks */
+#define READ_STREAM_QUEUE_SIZE	MAX_IO_COMBINE_LIMIT
+
+struct ReadStream
+{
+	Relation	rel;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+	ReadStreamBlockCallback callback;
+	void	   *callback_private_data;
+	size_t		per_buffer_data_size;	/* MAXALIGN'd, or 0 */
+	char	   *per_buffer_data;	/* array of READ_STREAM_QUEUE_SIZE */
+
+	int			combine_limit;	/* most blocks to read at once */
+	int			distance;		/* most blocks to read at once, for now */
+	int			readahead;		/* # of blocks to read asynchronously */
+	int			capacity;		/* most blocks to queue */
+	bool		exhausted;		/* has the callback returned the end? */
+
+	int			head;			/* queue index of the next block */
+	int			nqueued;		/* # of blocks in the queue */
+	BlockNumber blocks[READ_STREAM_QUEUE_SIZE];
+	Buffer		buffers[READ_STREAM_QUEUE_SIZE];	/* InvalidBuffer until
+													 * read */
+};
+
+static void read_stream_fill(ReadStream *stream);
+
+
+/*
+ * read_stream_begin_relation
+ *
+ * Set up a stream of blocks of the given relation fork.  The blocks are
+ * read with the given strategy, in the order the callback returns them.
+ * per_buffer_data_size is the size of what the callback wants to store for
+ * each block, or 0.
+ */
+ReadStream *
+read_stream_begin_relation(Relation rel, ForkNumber forknum,
+						   BufferAccessStrategy strategy,
+						   ReadStreamBlockCallback callback,
+						   void *callback_private_data,
+						   size_t per_buffer_data_size)
+{
+	ReadStream *stream;
+
+	stream = (ReadStream *) palloc0(sizeof(ReadStream));
+	stream->rel = rel;
+	stream->forknum = forknum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private_data = callback_private_data;
+
+	if (per_buffer_data_size > 0)
+	{
+		stream->per_buffer_data_size = MAXALIGN(per_buffer_data_size);
+		stream->per_buffer_data = (char *)
+			palloc(READ_STREAM_QUEUE_SIZE * stream->per_buffer_data_size);
+	}
+
+	stream->combine_limit = Min(io_combine_limit, READ_STREAM_QUEUE_SIZE);
+	stream->distance = 1;
+
+	/* see above */
+	if (direct_io && target_prefetch_pages > 0 &&
+		!RelationUsesLocalBuffers(rel) && FileAsyncReadsAvailable())
+		stream->readahead = Min(target_prefetch_pages, READ_STREAM_QUEUE_SIZE);
+	else
+		stream->readahead = 0;
+
+	stream->capacity = Max(stream->combine_limit, stream->readahead);
+
+	return stream;
+}
+
+/*
+ * read_stream_fill
+ *
+ * Ask the callback for blocks until the queue is full.
+ */
+static void
+read_stream_fill(ReadStream *stream)
+{
+	while (!stream->exhausted && stream->nqueued < stream->capacity)
+	{
+		int			tail;
+		void	   *per_buffer_data = NULL;
+		BlockNumber blkno;
+
+		tail = (stream->head + stream->nqueued) % READ_STREAM_QUEUE_SIZE;
+		if (stream->per_buffer_data)
+			per_buffer_data = stream->per_buffer_data +
+				tail * stream->per_buffer_data_size;
+
+		blkno = stream->callback(stream, stream->callback_private_data,
+								 per_buffer_data);
+		if (blkno == InvalidBlockNumber)
+		{
+			stream->exhausted = true;
+			break;
+		}
+
+		stream->blocks[tail] = blkno;
+		stream->buffers[tail] = InvalidBuffer;
+		stream->nqueued++;
+
+		/*
+		 * Start reading it right away, if we can.  The read keeps a pin of
+		 * its own, and ReadBuffers waits for it when the block's turn comes.
+		 */
+		if (stream->readahead > 0)
+			ReleaseBuffer(StartReadBuffer(stream->rel, stream->forknum,
+										  blkno, stream->strategy));
+	}
+}
+
+/*
+ * read_stream_next_buffer
+ *
+ * Return the pinned buffer of the next block, or InvalidBuffer at the end
+ * of the stream.  If per_buffer_data isn't NULL, *per_buffer_data is set to
+ * what the callback stored for the block; it's valid until the next call.
+ */
+Buffer
+read_stream_next_buffer(ReadStream *stream, void **per_buffer_data)
+{
+	int			head;
+	Buffer		buffer;
+
+	read_stream_fill(stream);
+
+	if (stream->nqueued == 0)
+		return InvalidBuffer;
+
+	head = stream->head;
+
+	if (!BufferIsValid(stream->buffers[head]))
+	{
+		Buffer		buffers[READ_STREAM_QUEUE_SIZE];
+		int			n;
+		int			i;
+
+		/* find the run of consecutive blocks to read with this one */
+		for (n = 1; n < stream->nqueued && n < stream->distance; n++)
+		{
+			int			idx = (head + n) % READ_STREAM_QUEUE_SIZE;
+
+			if (stream->blocks[idx] != stream->blocks[head] + n)
+				break;
+		}
+
+		ReadBuffers(stream->rel, stream->forknum, stream->blocks[head], n,
+					stream->strategy, buffers);
+
+		for (i = 0; i < n; i++)
+			stream->buffers[(head + i) % READ_STREAM_QUEUE_SIZE] = buffers[i];
+
+		stream->distance = Min(stream->distance * 2, stream->combine_limit);
+	}
+
+	buffer = stream->buffers[head];
+	stream->buffers[head] = InvalidBuffer;
+	if (per_buffer_data)
+		*per_buffer_data = stream->per_buffer_data ?
+			stream->per_buffer_data + head * stream->per_buffer_data_size :
+			NULL;
+
+	stream->head = (head + 1) % READ_STREAM_QUEUE_SIZE;
+	stream->nqueued--;
+
+	return buffer;
+}
+
+/*
+ * read_stream_reset
+ *
+ * Forget about the queued blocks, releasing their buffers, so that the
+ * stream starts over with asking the callback for blocks.
+ */
+void
+read_stream_reset(ReadStream *stream)
+{
+	while (stream->nqueued > 0)
+	{
+		Buffer		buffer = stream->buffers[stream->head];
+
+		if (BufferIsValid(buffer))
+			ReleaseBuffer(buffer);
+		stream->buffers[stream->head] = InvalidBuffer;
+		stream->head = (stream->head + 1) % READ_STREAM_QUEUE_SIZE;
+		stream->nqueued--;
+	}
+
+	stream->head = 0;
+	stream->exhausted = false;
+	stream->distance = 1;
+}
+
+/*
+ * read_stream_end
+ *
+ * Release the stream's buffers, and free it.
+ */
+void
+read_stream_end(ReadStream *stream)
+{
+	read_stream_reset(stream);
+	if (stream->per_buffer_data)
+		pfree(stream->per_buffer_data);
+	pfree(stream);
+}
@@ -31,11 +31,23 @@
  * BufFile also supports temporary files that exceed the OS file size limit
  * (by opening multiple fd.c temporary files).  This is an essential feature
  * for sorts and hashjoins on large amounts of data.
+ *
+ * If temp_file_compression is set when a temporary BufFile is created, its
+ * contents are compressed.  The logical file is then divided into BLCKSZ
+ * blocks, each of which is compressed on its own when it is dumped, and the
+ * buffer always holds exactly one of them.  A block is stored in a "slot"
+ * in the physical files whose size is a multiple of COMPRESS_SLOT_UNIT, and
+ * the block map remembers where each logical block is.  That keeps seeking
+ * cheap, so callers can't tell the difference; logtape.c in particular
+ * addresses its tapes by block number.  Since blocks are often rewritten,
+ * with a different compressed size each time, the slots given up are kept
+ * in free lists by size and reused.
  *-------------------------------------------------------------------------
  */
 
 #include "postgres.h"
 
+#include "common/pg_lzcompress.h"
 #include "executor/instrument.h"
 #include "storage/fd.h"
 #include "storage/buffile.h"
@@ -50,6 +62,48 @@
 #define MAX_PHYSICAL_FILESIZE	0x40000000
 #define BUFFILE_SEG_SIZE		(MAX_PHYSICAL_FILESIZE / BLCKSZ)
 
+/*
+ * Compressed blocks are stored in slots of 1 to COMPRESS_SLOT_CLASSES units
+ * of COMPRESS_SLOT_UNIT bytes.  A block that doesn't compress takes a whole
+ * BLCKSZ slot and is stored as it is.
+ */
+#define COMPRESS_SLOT_CLASSES	8
+#define COMPRESS_SLOT_UNIT		(BLCKSZ / COMPRESS_SLOT_CLASSES)
+
+/* GUC variable */
+bool		temp_file_compression = false;
+
+/*
+ * Location of one logical block of a compressed BufFile.  len is 0 if the
+ * block has never been written.  The block is stored uncompressed if len
+ * equals rawlen.
+ */
+typedef struct BufFileBlock
+{
+	int64		physpos;		/* position in the physical files */
+	uint16		len;			/* # of bytes stored */
+	uint16		rawlen;			/* # of valid bytes in the block */
+} BufFileBlock;
+
+/*
+ * State of a compressed BufFile.  Physical positions span the component
+ * files as if they were concatenated; no slot straddles two files.
+ */
+typedef struct BufFileCompress
+{
+	BufFileBlock *blocks;		/* the block map, indexed by logical block */
+	long		nblocks;		/* allocated length of blocks[] */
+	int64		physEnd;		/* end of the used physical space */
+	int64		logicalEnd;		/* logical size of the file, except buffer */
+
+	/* free slots of each size, numbered by size in units minus one */
+	int64	   *freeSlots[COMPRESS_SLOT_CLASSES];
+	int			nFreeSlots[COMPRESS_SLOT_CLASSES];
+	int			freeSlotsLen[COMPRESS_SLOT_CLASSES];
+
+	char		cbuffer[PGLZ_MAX_OUTPUT(BLCKSZ)];	/* compressed data */
+} BufFileCompress;
+
 /*
  * This data structure represents a buffered file that consists of one or
  * more physical files (each accessed through a virtual file descriptor
@@ -87,6 +141,13 @@ struct BufFile
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
 	char		buffer[BLCKSZ];
+
+	/*
+	 * For a compressed file, compress is its block map and so on, and
+	 * curFile and curOffset are purely logical; curOffset is always a
+	 * multiple of BLCKSZ.  NULL for a plain file.
+	 */
+	BufFileCompress *compress;
 };
 
 static BufFile *makeBufFile(File firstfile);
@@ -94,6 +155,15 @@ static void extendBufFile(BufFile *file);
 static void BufFileLoadBuffer(BufFile *file);
 static void BufFileDumpBuffer(BufFile *file);
 static int	BufFileFlush(BufFile *file);
+static long BufFileCurrentBlock(BufFile *file);
+static void BufFileCompressedLoad(BufFile *file);
+static void BufFileCompressedDump(BufFile *file);
+static bool BufFileCompressedNextBlock(BufFile *file);
+static int	BufFileCompressedSeek(BufFile *file, int newFile, off_t newOffset);
+static int64 BufFileAllocSlot(BufFile *file, int nunits);
+static void BufFileFreeSlot(BufFile *file, int64 physpos, int nunits);
+static void BufFilePhysicalIO(BufFile *file, int64 physpos, char *data,
+				  int len, bool write);
 
 
 /*
@@ -118,6 +188,7 @@ makeBufFile(File firstfile)
 	file->curOffset = 0L;
 	file->pos = 0;
 	file->nbytes = 0;
+	file->compress = NULL;
 
 	return file;
 }
@@ -175,6 +246,27 @@ BufFileCreateTemp(bool interXact)
 	file->isTemp = true;
 	file->isInterXact = interXact;
 
+	if (temp_file_compression)
+	{
+		BufFileCompress *compress;
+		int			i;
+
+		compress = (BufFileCompress *) palloc(sizeof(BufFileCompress));
+		compress->nblocks = 64;
+		compress->blocks = (BufFileBlock *)
+			palloc0(compress->nblocks * sizeof(BufFileBlock));
+		compress->physEnd = 0;
+		compress->logicalEnd = 0;
+		for (i = 0; i < COMPRESS_SLOT_CLASSES; i++)
+		{
+			compress->freeSlotsLen[i] = 16;
+			compress->freeSlots[i] = (int64 *)
+				palloc(compress->freeSlotsLen[i] * sizeof(int64));
+			compress->nFreeSlots[i] = 0;
+		}
+		file->compress = compress;
+	}
+
 	return file;
 }
 
@@ -211,6 +303,13 @@ BufFileClose(BufFile *file)
 	/* release the buffer space */
 	pfree(file->files);
 	pfree(file->offsets);
+	if (file->compress)
+	{
+		for (i = 0; i < COMPRESS_SLOT_CLASSES; i++)
+			pfree(file->compress->freeSlots[i]);
+		pfree(file->compress->blocks);
+		pfree(file->compress);
+	}
 	pfree(file);
 }
 
@@ -261,6 +360,7 @@ BufFileLoadBuffer(BufFile *file)
 	/* we choose not to advance curOffset here */
 
 	pgBufferUsage.temp_blks_read++;
+	pgBufferUsage.temp_bytes_read += file->nbytes;
 }
 
 /*
@@ -325,6 +425,8 @@ BufFileDumpBuffer(BufFile *file)
 		wpos += bytestowrite;
 
 		pgBufferUsage.temp_blks_written++;
+		pgBufferUsage.temp_bytes_written += bytestowrite;
+		pgBufferUsage.temp_bytes_raw_written += bytestowrite;
 	}
 	file->dirty = false;
 
@@ -369,7 +471,13 @@ BufFileRead(BufFile *file, void *ptr, size_t size)
 
 	while (size > 0)
 	{
-		if (file->pos >= file->nbytes)
+		if (file->pos >= file->nbytes && file->compress)
+		{
+			/* only a full block can be followed by more data */
+			if (file->nbytes < BLCKSZ || !BufFileCompressedNextBlock(file))
+				break;			/* no more data available */
+		}
+		else if (file->pos >= file->nbytes)
 		{
 			/* Try to load more data into buffer. */
 			file->curOffset += file->pos;
@@ -409,7 +517,14 @@ BufFileWrite(BufFile *file, void *ptr, size_t size)
 
 	while (size > 0)
 	{
-		if (file->pos >= BLCKSZ)
+		if (file->pos >= BLCKSZ && file->compress)
+		{
+			/* Go on with the next block */
+			(void) BufFileCompressedNextBlock(file);
+			if (file->dirty)
+				break;			/* I/O error */
+		}
+		else if (file->pos >= BLCKSZ)
 		{
 			/* Buffer full, dump it out */
 			if (file->dirty)
@@ -454,7 +569,14 @@ BufFileWrite(BufFile *file, void *ptr, size_t size)
 static int
 BufFileFlush(BufFile *file)
 {
-	if (file->dirty)
+	if (file->dirty && file->compress)
+	{
+		/* the buffer stays valid, so the position needn't change */
+		BufFileCompressedDump(file);
+		if (file->dirty)
+			return EOF;
+	}
+	else if (file->dirty)
 	{
 		BufFileDumpBuffer(file);
 		if (file->dirty)
@@ -526,6 +648,9 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 		file->pos = (int) (newOffset - file->curOffset);
 		return 0;
 	}
+	if (file->compress)
+		return BufFileCompressedSeek(file, newFile, newOffset);
+
 	/* Otherwise, must reposition buffer, so flush any dirty data */
 	if (BufFileFlush(file) != 0)
 		return EOF;
@@ -587,6 +712,336 @@ BufFileSeekBlock(BufFile *file, long blknum)
 					   SEEK_SET);
 }
 
+/*
+ * BufFilePrefetchBlock --- initiate asynchronous read of blocks
+ *
+ * Tell the kernel that nblocks BLCKSZ-sized blocks starting at blknum will
+ * be read soon.  This is only a hint; blocks beyond the end of the file are
+ * ignored.  The logical position is not moved.
+ */
+void
+BufFilePrefetchBlock(BufFile *file, long blknum, int nblocks)
+{
+	if (file->compress)
+	{
+		/* prefetch the slots of the blocks, wherever they are */
+		for (; nblocks > 0; blknum++, nblocks--)
+		{
+			BufFileBlock *block;
+
+			if (blknum >= file->compress->nblocks)
+				break;
+			block = &file->compress->blocks[blknum];
+			if (block->len == 0)
+				continue;
+			(void) FilePrefetch(file->files[block->physpos / MAX_PHYSICAL_FILESIZE],
+								(off_t) (block->physpos % MAX_PHYSICAL_FILESIZE),
+								block->len);
+		}
+		return;
+	}
+
+	while (nblocks > 0)
+	{
+		int			fileno = (int) (blknum / BUFFILE_SEG_SIZE);
+		long		segblk = blknum % BUFFILE_SEG_SIZE;
+		int			n = (int) Min((long) nblocks, BUFFILE_SEG_SIZE - segblk);
+
+		if (fileno >= file->numFiles)
+			break;
+		(void) FilePrefetch(file->files[fileno], (off_t) segblk * BLCKSZ,
+							n * BLCKSZ);
+		blknum += n;
+		nblocks -= n;
+	}
+}
+
+/*
+ * Compressed file support
+ */
+
+/*
+ * Logical block number of the buffer of a compressed file
+ */
+static long
+BufFileCurrentBlock(BufFile *file)
+{
+	return (long) file->curFile * BUFFILE_SEG_SIZE +
+		(long) (file->curOffset / BLCKSZ);
+}
+
+/*
+ * Load the current block of a compressed file into the buffer.
+ * At call, must have dirty = false.  On exit, nbytes is the number of valid
+ * bytes in the block, zero if it doesn't exist.
+ */
+static void
+BufFileCompressedLoad(BufFile *file)
+{
+	BufFileCompress *compress = file->compress;
+	long		blknum = BufFileCurrentBlock(file);
+	BufFileBlock *block;
+
+	Assert(!file->dirty);
+	file->nbytes = 0;
+	if (blknum >= compress->nblocks || compress->blocks[blknum].len == 0)
+		return;
+	block = &compress->blocks[blknum];
+
+	if (block->len == block->rawlen)
+		BufFilePhysicalIO(file, block->physpos, file->buffer, block->len,
+						  false);
+	else
+	{
+		BufFilePhysicalIO(file, block->physpos, compress->cbuffer, block->len,
+						  false);
+		if (pglz_decompress(compress->cbuffer, block->len, file->buffer,
+							block->rawlen) != block->rawlen)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("compressed data in block %ld of temporary file is corrupt",
+							blknum)));
+	}
+	file->nbytes = block->rawlen;
+
+	pgBufferUsage.temp_blks_read++;
+	pgBufferUsage.temp_bytes_read += block->len;
+}
+
+/*
+ * Compress and write out the buffer of a compressed file.
+ * On exit, dirty is cleared; the buffer and position are unchanged.
+ */
+static void
+BufFileCompressedDump(BufFile *file)
+{
+	BufFileCompress *compress = file->compress;
+	long		blknum = BufFileCurrentBlock(file);
+	BufFileBlock *block;
+	int32		len;
+	char	   *data;
+	int			nunits;
+
+	Assert(file->dirty && file->nbytes > 0);
+
+	/* enlarge the block map if needed */
+	if (blknum >= compress->nblocks)
+	{
+		long		newnblocks = compress->nblocks;
+
+		while (blknum >= newnblocks)
+			newnblocks *= 2;
+		compress->blocks = (BufFileBlock *)
+			repalloc(compress->blocks, newnblocks * sizeof(BufFileBlock));
+		MemSet(compress->blocks + compress->nblocks, 0,
+			   (newnblocks - compress->nblocks) * sizeof(BufFileBlock));
+		compress->nblocks = newnblocks;
+	}
+	block = &compress->blocks[blknum];
+
+	len = pglz_compress(file->buffer, file->nbytes, compress->cbuffer,
+						PGLZ_strategy_default);
+	if (len < 0 || len >= file->nbytes)
+	{
+		/* doesn't compress, store it as it is */
+		len = file->nbytes;
+		data = file->buffer;
+	}
+	else
+		data = compress->cbuffer;
+
+	/* find a slot of the right size, keeping the old one if possible */
+	nunits = (len + COMPRESS_SLOT_UNIT - 1) / COMPRESS_SLOT_UNIT;
+	if (block->len == 0 ||
+		(block->len + COMPRESS_SLOT_UNIT - 1) / COMPRESS_SLOT_UNIT != nunits)
+	{
+		if (block->len != 0)
+			BufFileFreeSlot(file, block->physpos,
+							(block->len + COMPRESS_SLOT_UNIT - 1) /
+							COMPRESS_SLOT_UNIT);
+		block->physpos = BufFileAllocSlot(file, nunits);
+	}
+	block->len = (uint16) len;
+	block->rawlen = (uint16) file->nbytes;
+
+	BufFilePhysicalIO(file, block->physpos, data, len, true);
+
+	compress->logicalEnd = Max(compress->logicalEnd,
+							   (int64) blknum * BLCKSZ + file->nbytes);
+	file->dirty = false;
+
+	pgBufferUsage.temp_blks_written++;
+	pgBufferUsage.temp_bytes_written += len;
+	pgBufferUsage.temp_bytes_raw_written += file->nbytes;
+}
+
+/*
+ * Move the buffer of a compressed file to the start of the next block,
+ * writing out the current one if needed.  Returns false if there is no
+ * data in the next block; the position is then left unchanged.
+ */
+static bool
+BufFileCompressedNextBlock(BufFile *file)
+{
+	int			oldFile = file->curFile;
+	off_t		oldOffset = file->curOffset;
+	int			oldPos = file->pos;
+
+	if (BufFileFlush(file) != 0)
+		return false;
+
+	file->curOffset += BLCKSZ;
+	if (file->curOffset >= MAX_PHYSICAL_FILESIZE)
+	{
+		file->curFile++;
+		file->curOffset = 0L;
+	}
+	file->pos = 0;
+	BufFileCompressedLoad(file);
+	if (file->nbytes > 0)
+		return true;
+
+	/*
+	 * There's only room for more data there.  If we were writing, that's
+	 * what we want; otherwise, go back to the end of the block we were at,
+	 * so that the logical position stays where a reader expects it.
+	 */
+	if (oldPos < BLCKSZ)
+	{
+		file->curFile = oldFile;
+		file->curOffset = oldOffset;
+		BufFileCompressedLoad(file);
+		file->pos = oldPos;
+	}
+	return false;
+}
+
+/*
+ * BufFileSeek for a compressed file, to a point outside the buffer.
+ */
+static int
+BufFileCompressedSeek(BufFile *file, int newFile, off_t newOffset)
+{
+	BufFileCompress *compress = file->compress;
+	int64		logicalEnd;
+	int64		target;
+
+	while (newOffset >= MAX_PHYSICAL_FILESIZE)
+	{
+		newFile++;
+		newOffset -= MAX_PHYSICAL_FILESIZE;
+	}
+
+	/* No seeking past the end, which might be in the (dirty) buffer */
+	target = (int64) newFile * MAX_PHYSICAL_FILESIZE + newOffset;
+	logicalEnd = Max(compress->logicalEnd,
+					 (int64) file->curFile * MAX_PHYSICAL_FILESIZE +
+					 file->curOffset + file->nbytes);
+	if (target > logicalEnd)
+		return EOF;
+
+	if (BufFileFlush(file) != 0)
+		return EOF;
+
+	/* Seek is OK! */
+	file->curFile = newFile;
+	file->curOffset = newOffset - newOffset % BLCKSZ;
+	BufFileCompressedLoad(file);
+	file->pos = (int) (newOffset % BLCKSZ);
+	return 0;
+}
+
+/*
+ * Get a free slot of nunits units in the physical files.
+ */
+static int64
+BufFileAllocSlot(BufFile *file, int nunits)
+{
+	BufFileCompress *compress = file->compress;
+	int			sizeclass = nunits - 1;
+	int64		physpos;
+
+	Assert(nunits >= 1 && nunits <= COMPRESS_SLOT_CLASSES);
+
+	if (compress->nFreeSlots[sizeclass] > 0)
+		return compress->freeSlots[sizeclass][--compress->nFreeSlots[sizeclass]];
+
+	/* Extend the physical space, but don't let the slot cross files */
+	physpos = compress->physEnd;
+	if (physpos / MAX_PHYSICAL_FILESIZE !=
+		(physpos + nunits * COMPRESS_SLOT_UNIT - 1) / MAX_PHYSICAL_FILESIZE)
+		physpos += MAX_PHYSICAL_FILESIZE - physpos % MAX_PHYSICAL_FILESIZE;
+	compress->physEnd = physpos + nunits * COMPRESS_SLOT_UNIT;
+
+	return physpos;
+}
+
+/*
+ * Remember an unused slot of nunits units for reuse.
+ */
+static void
+BufFileFreeSlot(BufFile *file, int64 physpos, int nunits)
+{
+	BufFileCompress *compress = file->compress;
+	int			sizeclass = nunits - 1;
+
+	if (compress->nFreeSlots[sizeclass] >= compress->freeSlotsLen[sizeclass])
+	{
+		compress->freeSlotsLen[sizeclass] *= 2;
+		compress->freeSlots[sizeclass] = (int64 *)
+			repalloc(compress->freeSlots[sizeclass],
+					 compress->freeSlotsLen[sizeclass] * sizeof(int64));
+	}
+	compress->freeSlots[sizeclass][compress->nFreeSlots[sizeclass]++] = physpos;
+}
+
+/*
+ * Read or write len bytes at a physical position of a compressed file,
+ * adding component files as needed.  Errors are reported instead of being
+ * passed on to the caller, since they'd otherwise corrupt the block map.
+ */
+static void
+BufFilePhysicalIO(BufFile *file, int64 physpos, char *data, int len,
+				  bool write)
+{
+	int			fileno = (int) (physpos / MAX_PHYSICAL_FILESIZE);
+	off_t		offset = (off_t) (physpos % MAX_PHYSICAL_FILESIZE);
+	File		thisfile;
+	int			nbytes;
+
+	while (fileno >= file->numFiles)
+		extendBufFile(file);
+	thisfile = file->files[fileno];
+
+	if (offset != file->offsets[fileno])
+	{
+		if (FileSeek(thisfile, offset, SEEK_SET) != offset)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek in temporary file: %m")));
+		file->offsets[fileno] = offset;
+	}
+
+	if (write)
+		nbytes = FileWrite(thisfile, data, len);
+	else
+		nbytes = FileRead(thisfile, data, len);
+	if (nbytes != len)
+	{
+		/* the seek position is unknown now */
+		file->offsets[fileno] = -1;
+		if (write)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to temporary file: %m")));
+		else
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from temporary file: %m")));
+	}
+	file->offsets[fileno] += nbytes;
+}
+
 #ifdef NOT_USED
 /*
  * BufFileTellBlock --- block-oriented tell
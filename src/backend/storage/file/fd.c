@@ -66,6 +66,20 @@
 #ifdef HAVE_SYS_RESOURCE_H
 #include <sys/resource.h>		/* for getrlimit */
 #endif
+#ifndef WIN32
+#include <sys/uio.h>			/* for readv and writev */
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if defined(__linux__) && defined(SYS_io_uring_setup)
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#define USE_IO_URING 1
+#ifndef IORING_FEAT_SINGLE_MMAP
+#define IORING_FEAT_SINGLE_MMAP (1U << 0)
+#endif
+#endif
 
 #include "miscadmin.h"
 #include "access/xact.h"
@@ -73,6 +87,7 @@
 #include "catalog/catalog.h"
 #include "catalog/pg_tablespace.h"
 #include "pgstat.h"
+#include "storage/barrier.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
@@ -118,6 +133,13 @@
  */
 int			max_files_per_process = 1000;
 
+/*
+ * GUC parameter: should md.c open relation files with O_DIRECT, so that
+ * their pages are cached only in our own buffers and not also in the
+ * kernel's page cache?
+ */
+bool		direct_io = false;
+
 /*
  * Maximum number of file descriptors to open for either VFD entries or
  * AllocateFile/AllocateDir/OpenTransientFile operations.  This is initialized
@@ -244,6 +266,61 @@ static Oid *tempTableSpaces = NULL;
 static int	numTempTableSpaces = -1;
 static int	nextTempTableSpace = 0;
 
+/*
+ * Asynchronous reads (FileStartRead/FileWaitRead).
+ *
+ * With io_method = io_uring, each backend sets up its own io_uring the first
+ * time it is asked for an asynchronous read, and submits every read to the
+ * kernel as soon as it's started.  The kernel takes its own reference to the
+ * file at submission, so the VFD is free to be closed before the read is
+ * waited for.  If io_uring can't be used, reads are simply performed right
+ * away, when they're started.
+ *
+ * The ring's own kernel FD isn't counted against max_safe_fds; it fits in
+ * the NUM_RESERVED_FDS slop.
+ */
+int			io_method = IO_METHOD_SYNC;
+
+typedef enum
+{
+	FILE_IO_FREE,				/* slot not in use */
+	FILE_IO_INFLIGHT,			/* submitted, not completed yet */
+	FILE_IO_DONE				/* completed, result not collected yet */
+} FileIOState;
+
+typedef struct
+{
+	FileIOState state;
+	int			result;			/* bytes read, or -errno */
+#ifdef USE_IO_URING
+	struct iovec iov;			/* must live until the read completes */
+#endif
+} FileIORequest;
+
+static FileIORequest ioRequests[FILE_IO_MAX_INFLIGHT];
+
+#ifdef USE_IO_URING
+typedef struct
+{
+	int			fd;				/* ring FD, or -1 if none */
+	pid_t		pid;			/* process that set it up */
+	unsigned   *sq_head;
+	unsigned   *sq_tail;
+	unsigned   *sq_mask;
+	unsigned   *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned   *cq_head;
+	unsigned   *cq_tail;
+	unsigned   *cq_mask;
+	struct io_uring_cqe *cqes;
+} FileIORing;
+
+static FileIORing ioRing = {-1};
+#endif
+
+/* set once io_uring has failed us, to not try again in this process */
+static bool ioRingFailed = false;
+
 
 /*--------------------
  *
@@ -288,6 +365,7 @@ static void FreeVfd(File file);
 
 static int	FileAccess(File file);
 static File OpenTemporaryFileInTablespace(Oid tblspcOid, bool rejectError);
+static void RegisterTemporaryFile(File file, bool interXact);
 static bool reserveAllocatedDesc(void);
 static int	FreeDesc(AllocateDesc *desc);
 static struct dirent *ReadDirExtended(DIR *dir, const char *dirname, int elevel);
@@ -1184,6 +1262,36 @@ OpenTemporaryFile(bool interXact)
 											 DEFAULTTABLESPACE_OID,
 											 true);
 
+	RegisterTemporaryFile(file, interXact);
+
+	return file;
+}
+
+/*
+ * Open a temporary file in the given tablespace, regardless of
+ * temp_tablespaces.  It is deleted at close or at end of transaction, as for
+ * OpenTemporaryFile(false).  This is meant for callers that need to exercise
+ * the storage of one particular tablespace.
+ */
+File
+OpenTablespaceTemporaryFile(Oid tblspcOid)
+{
+	File		file;
+
+	file = OpenTemporaryFileInTablespace(tblspcOid, true);
+	RegisterTemporaryFile(file, false);
+
+	return file;
+}
+
+/*
+ * Mark a newly opened temporary file for deletion at close, and unless it
+ * is to outlive the transaction, register it with the current resource
+ * owner.
+ */
+static void
+RegisterTemporaryFile(File file, bool interXact)
+{
 	/* Mark it for deletion at close */
 	VfdCache[file].fdstate |= FD_TEMPORARY;
 
@@ -1199,8 +1307,6 @@ OpenTemporaryFile(bool interXact)
 		/* ensure cleanup happens at eoxact */
 		have_xact_temporary_files = true;
 	}
-
-	return file;
 }
 
 /*
@@ -1396,6 +1502,79 @@ FilePrefetch(File file, off_t offset, int amount)
 #endif
 }
 
+/*
+ * FileDropCache - ask the kernel to evict a range of the file from its cache
+ *
+ * Clean pages are dropped, so that subsequent reads have to go to storage;
+ * dirty ones should be synced first.  An amount of 0 means to the end of
+ * the file.  Like FilePrefetch, this is a no-op without posix_fadvise.
+ */
+int
+FileDropCache(File file, off_t offset, off_t amount)
+{
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileDropCache: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	returnCode = posix_fadvise(VfdCache[file].fd, offset, amount,
+							   POSIX_FADV_DONTNEED);
+
+	return returnCode;
+#else
+	Assert(FileIsValid(file));
+	return 0;
+#endif
+}
+
+/*
+ * FileWriteback - ask the kernel to start writing out a range of a file
+ *
+ * This is a hint that the data written there won't be written again soon,
+ * so the kernel might as well write it out now instead of letting dirty
+ * pages accumulate until an fsync has to write all of them at once.  It
+ * doesn't wait for the writes to finish.  Errors are ignored, since the
+ * data will be fsync'd later anyway.
+ *
+ * Only sync_file_range() does just that; posix_fadvise(POSIX_FADV_DONTNEED),
+ * which pg_flush_data() falls back on, would also throw the pages out of
+ * the kernel's cache, so we don't use it here.
+ */
+void
+FileWriteback(File file, off_t offset, off_t nbytes)
+{
+#if defined(HAVE_SYNC_FILE_RANGE)
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileWriteback: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) nbytes));
+
+	/* Careful, nbytes 0 would mean the rest of the file */
+	if (nbytes <= 0 || !enableFsync)
+		return;
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return;
+
+	(void) sync_file_range(VfdCache[file].fd, offset, nbytes,
+						   SYNC_FILE_RANGE_WRITE);
+#else
+	Assert(FileIsValid(file));
+#endif
+}
+
 int
 FileRead(File file, char *buffer, int amount)
 {
@@ -1451,6 +1630,332 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileReadV - read into several buffers at once
+ *
+ * Like FileRead, but reads nbuffers consecutive chunks of amount bytes each,
+ * with a single system call where possible.  Returns the total number of
+ * bytes read.
+ */
+int
+FileReadV(File file, char **buffers, int nbuffers, int amount)
+{
+	int			returnCode;
+
+#ifndef WIN32
+	struct iovec iov[FILE_MAX_READV];
+	int			i;
+
+	Assert(FileIsValid(file));
+	Assert(nbuffers > 0 && nbuffers <= FILE_MAX_READV);
+
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d %d",
+			   file, VfdCache[file].fileName,
+			   (int64) VfdCache[file].seekPos,
+			   nbuffers, amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	for (i = 0; i < nbuffers; i++)
+	{
+		iov[i].iov_base = buffers[i];
+		iov[i].iov_len = amount;
+	}
+
+retry:
+	returnCode = readv(VfdCache[file].fd, iov, nbuffers);
+
+	if (returnCode >= 0)
+		VfdCache[file].seekPos += returnCode;
+	else
+	{
+		/* OK to retry if interrupted */
+		if (errno == EINTR)
+			goto retry;
+
+		/* Trouble, so assume we don't know the file position anymore */
+		VfdCache[file].seekPos = FileUnknownPos;
+	}
+#else
+	int			i;
+
+	/* no readv() here, so just read the buffers one by one */
+	returnCode = 0;
+	for (i = 0; i < nbuffers; i++)
+	{
+		int			nbytes = FileRead(file, buffers[i], amount);
+
+		if (nbytes < 0)
+			return (returnCode > 0) ? returnCode : nbytes;
+		returnCode += nbytes;
+		if (nbytes < amount)
+			break;
+	}
+#endif
+
+	return returnCode;
+}
+
+#ifdef USE_IO_URING
+/*
+ * Set up this process's io_uring.  Returns false, after logging why, if the
+ * kernel doesn't let us.
+ */
+static bool
+FileIORingSetup(void)
+{
+	struct io_uring_params p;
+	char	   *sqptr;
+	char	   *cqptr;
+	size_t		sqsize;
+	size_t		cqsize;
+	int			fd;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(SYS_io_uring_setup, FILE_IO_MAX_INFLIGHT, &p);
+	if (fd < 0)
+	{
+		elog(LOG, "could not set up io_uring, reading synchronously: %m");
+		return false;
+	}
+
+	sqsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		sqsize = cqsize = Max(sqsize, cqsize);
+
+	sqptr = (char *) mmap(NULL, sqsize, PROT_READ | PROT_WRITE,
+						  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sqptr == MAP_FAILED)
+		goto fail;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cqptr = sqptr;
+	else
+	{
+		cqptr = (char *) mmap(NULL, cqsize, PROT_READ | PROT_WRITE,
+							  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cqptr == MAP_FAILED)
+			goto fail;
+	}
+	ioRing.sqes = (struct io_uring_sqe *)
+		mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			 fd, IORING_OFF_SQES);
+	if ((void *) ioRing.sqes == MAP_FAILED)
+		goto fail;
+
+	ioRing.sq_head = (unsigned *) (sqptr + p.sq_off.head);
+	ioRing.sq_tail = (unsigned *) (sqptr + p.sq_off.tail);
+	ioRing.sq_mask = (unsigned *) (sqptr + p.sq_off.ring_mask);
+	ioRing.sq_array = (unsigned *) (sqptr + p.sq_off.array);
+	ioRing.cq_head = (unsigned *) (cqptr + p.cq_off.head);
+	ioRing.cq_tail = (unsigned *) (cqptr + p.cq_off.tail);
+	ioRing.cq_mask = (unsigned *) (cqptr + p.cq_off.ring_mask);
+	ioRing.cqes = (struct io_uring_cqe *) (cqptr + p.cq_off.cqes);
+
+	ioRing.fd = fd;
+	ioRing.pid = MyProcPid;
+	return true;
+
+fail:
+	/* any mappings made are left alone, this happens once per process */
+	elog(LOG, "could not map io_uring, reading synchronously: %m");
+	close(fd);
+	return false;
+}
+
+/*
+ * Collect the results of completed reads from the ring.  If wait is true,
+ * block until at least one is there.
+ */
+static void
+FileIORingReap(bool wait)
+{
+	for (;;)
+	{
+		unsigned	head = *ioRing.cq_head;
+		unsigned	tail;
+		bool		found = false;
+
+		tail = *ioRing.cq_tail;
+		pg_read_barrier();
+
+		while (head != tail)
+		{
+			struct io_uring_cqe *cqe = &ioRing.cqes[head & *ioRing.cq_mask];
+			FileIORequest *req = &ioRequests[cqe->user_data];
+
+			Assert(req->state == FILE_IO_INFLIGHT);
+			req->result = cqe->res;
+			req->state = FILE_IO_DONE;
+			head++;
+			found = true;
+		}
+
+		pg_memory_barrier();
+		*ioRing.cq_head = head;
+
+		if (found || !wait)
+			return;
+
+		if (syscall(SYS_io_uring_enter, ioRing.fd, 0, 1,
+					IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+			elog(PANIC, "could not wait for io_uring completions: %m");
+	}
+}
+#endif   /* USE_IO_URING */
+
+/*
+ * FileAsyncReadsAvailable - will FileStartRead return before the data is in?
+ *
+ * This sets up the io_uring on first use, so that callers can fall back to
+ * something cheaper than a synchronous read, like FilePrefetch, if we can't
+ * do asynchronous reads after all.
+ */
+bool
+FileAsyncReadsAvailable(void)
+{
+	if (io_method == IO_METHOD_SYNC || ioRingFailed)
+		return false;
+#ifdef USE_IO_URING
+	if (ioRing.fd >= 0 && ioRing.pid == MyProcPid)
+		return true;
+	/* a ring inherited from the parent process is of no use to us */
+	if (FileIORingSetup())
+		return true;
+#else
+	elog(LOG, "io_uring is not supported by this build, reading synchronously");
+#endif
+	ioRingFailed = true;
+	return false;
+}
+
+/*
+ * FileStartRead - start reading amount bytes at offset into buffer
+ *
+ * Returns a handle to pass to FileWaitRead, which must be called exactly
+ * once for every read started.  The logical seek position is unaffected.
+ * Until FileWaitRead has returned, the buffer mustn't be touched.  At most
+ * FILE_IO_MAX_INFLIGHT reads can be in flight at once.
+ */
+int
+FileStartRead(File file, char *buffer, int amount, off_t offset)
+{
+	FileIORequest *req;
+	int			handle;
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileStartRead: %d (%s) " INT64_FORMAT " %d %p",
+			   file, VfdCache[file].fileName,
+			   (int64) offset, amount, buffer));
+
+	for (handle = 0; handle < FILE_IO_MAX_INFLIGHT; handle++)
+	{
+		if (ioRequests[handle].state == FILE_IO_FREE)
+			break;
+	}
+	if (handle >= FILE_IO_MAX_INFLIGHT)
+		elog(ERROR, "too many asynchronous reads in progress");
+	req = &ioRequests[handle];
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+	{
+		req->result = -errno;
+		req->state = FILE_IO_DONE;
+		return handle;
+	}
+
+#ifdef USE_IO_URING
+	if (FileAsyncReadsAvailable())
+	{
+		unsigned	tail = *ioRing.sq_tail;
+		unsigned	index = tail & *ioRing.sq_mask;
+		struct io_uring_sqe *sqe = &ioRing.sqes[index];
+		int			rc;
+
+		req->iov.iov_base = buffer;
+		req->iov.iov_len = amount;
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = VfdCache[file].fd;
+		sqe->off = offset;
+		sqe->addr = (uint64) (uintptr_t) &req->iov;
+		sqe->len = 1;
+		sqe->user_data = handle;
+
+		ioRing.sq_array[index] = index;
+		pg_write_barrier();
+		*ioRing.sq_tail = tail + 1;
+
+		req->state = FILE_IO_INFLIGHT;
+
+		do
+		{
+			rc = syscall(SYS_io_uring_enter, ioRing.fd, 1, 0, 0, NULL, 0);
+		} while (rc < 0 && errno == EINTR);
+
+		if (rc == 1)
+			return handle;
+
+		/*
+		 * The kernel didn't take it, perhaps for lack of memory.  Since
+		 * FILE_IO_MAX_INFLIGHT is the ring's size, the submission queue can
+		 * only be full if the entry is still there, so retract it and read
+		 * synchronously instead.
+		 */
+		*ioRing.sq_tail = tail;
+	}
+#endif
+
+	/* read synchronously */
+	if (FileSeek(file, offset, SEEK_SET) != offset)
+		returnCode = -1;
+	else
+		returnCode = FileRead(file, buffer, amount);
+
+	req->result = returnCode >= 0 ? returnCode : -errno;
+	req->state = FILE_IO_DONE;
+	return handle;
+}
+
+/*
+ * FileWaitRead - wait for a read started with FileStartRead to complete
+ *
+ * Returns the number of bytes read, or -1 with errno set, like FileRead.
+ * The handle is no longer valid afterwards.
+ */
+int
+FileWaitRead(int handle)
+{
+	FileIORequest *req;
+	int			result;
+
+	Assert(handle >= 0 && handle < FILE_IO_MAX_INFLIGHT);
+	req = &ioRequests[handle];
+	Assert(req->state != FILE_IO_FREE);
+
+#ifdef USE_IO_URING
+	while (req->state == FILE_IO_INFLIGHT)
+		FileIORingReap(true);
+#endif
+
+	result = req->result;
+	req->state = FILE_IO_FREE;
+
+	if (result < 0)
+	{
+		errno = -result;
+		return -1;
+	}
+	return result;
+}
+
 int
 FileWrite(File file, char *buffer, int amount)
 {
@@ -1546,6 +2051,81 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileWriteV - write out several buffers at once
+ *
+ * Like FileWrite, but writes nbuffers consecutive chunks of amount bytes
+ * each, with a single system call where possible.  Returns the total number
+ * of bytes written.  This is meant for relation files, so unlike FileWrite
+ * it doesn't do the bookkeeping for temp_file_limit.
+ */
+int
+FileWriteV(File file, char **buffers, int nbuffers, int amount)
+{
+	int			returnCode;
+
+#ifndef WIN32
+	struct iovec iov[FILE_MAX_WRITEV];
+	int			i;
+
+	Assert(FileIsValid(file));
+	Assert(nbuffers > 0 && nbuffers <= FILE_MAX_WRITEV);
+	Assert(!(VfdCache[file].fdstate & FD_TEMPORARY));
+
+	DO_DB(elog(LOG, "FileWriteV: %d (%s) " INT64_FORMAT " %d %d",
+			   file, VfdCache[file].fileName,
+			   (int64) VfdCache[file].seekPos,
+			   nbuffers, amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	for (i = 0; i < nbuffers; i++)
+	{
+		iov[i].iov_base = buffers[i];
+		iov[i].iov_len = amount;
+	}
+
+retry:
+	errno = 0;
+	returnCode = writev(VfdCache[file].fd, iov, nbuffers);
+
+	/* if write didn't set errno, assume problem is no disk space */
+	if (returnCode != nbuffers * amount && errno == 0)
+		errno = ENOSPC;
+
+	if (returnCode >= 0)
+		VfdCache[file].seekPos += returnCode;
+	else
+	{
+		/* OK to retry if interrupted */
+		if (errno == EINTR)
+			goto retry;
+
+		/* Trouble, so assume we don't know the file position anymore */
+		VfdCache[file].seekPos = FileUnknownPos;
+	}
+#else
+	int			i;
+
+	/* no writev() here, so just write the buffers one by one */
+	returnCode = 0;
+	for (i = 0; i < nbuffers; i++)
+	{
+		int			nbytes = FileWrite(file, buffers[i], amount);
+
+		if (nbytes < 0)
+			return (returnCode > 0) ? returnCode : nbytes;
+		returnCode += nbytes;
+		if (nbytes < amount)
+			break;
+	}
+#endif
+
+	return returnCode;
+}
+
 int
 FileSync(File file)
 {
@@ -1670,6 +2250,73 @@ FileTruncate(File file, off_t offset)
 	return returnCode;
 }
 
+/*
+ * Make the given range of the file read back as zeroes, allocating disk
+ * space for it.  This is for extending a file by many blocks at once: where
+ * the kernel and file system can, we just ask for the space to be allocated,
+ * which costs one system call however big the range; otherwise we write the
+ * zeroes.  Returns 0 on success, or -1 with errno set.
+ */
+int
+FileZero(File file, off_t offset, off_t amount)
+{
+	static char zerobuf_space[BLCKSZ + PG_IO_ALIGN_SIZE];
+	char	   *zerobuf;
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	/* temp files must not escape temp_file_limit accounting */
+	Assert(!(VfdCache[file].fdstate & FD_TEMPORARY));
+
+	DO_DB(elog(LOG, "FileZero: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+#if defined(__linux__)
+	do
+		returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	while (returnCode == EINTR);
+
+	if (returnCode == 0)
+		return 0;
+
+	/* fall back to writing the zeroes if the file system can't do it */
+	if (returnCode != EINVAL && returnCode != EOPNOTSUPP)
+	{
+		errno = returnCode;
+		return -1;
+	}
+#endif
+
+	/* aligned, in case the file was opened with O_DIRECT */
+	zerobuf = (char *) TYPEALIGN(PG_IO_ALIGN_SIZE, zerobuf_space);
+
+	while (amount > 0)
+	{
+		int			chunk = (int) Min(amount, (off_t) BLCKSZ);
+
+		if (FileSeek(file, offset, SEEK_SET) != offset)
+			return -1;
+		returnCode = FileWrite(file, zerobuf, chunk);
+		if (returnCode < 0)
+			return -1;
+		if (returnCode != chunk)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			errno = ENOSPC;
+			return -1;
+		}
+		offset += chunk;
+		amount -= chunk;
+	}
+
+	return 0;
+}
+
 /*
  * Return the pathname associated with an open file.
  *
@@ -21,6 +21,7 @@
 #include "storage/copydir.h"
 #include "storage/fd.h"
 #include "storage/reinit.h"
+#include "storage/smgr.h"
 #include "utils/hsearch.h"
 #include "utils/memutils.h"
 
@@ -93,6 +94,12 @@ ResetUnloggedRelations(int op)
 
 	FreeDir(spc_dir);
 
+	/*
+	 * The main forks we removed or copied over changed size behind smgr's
+	 * back, so forget any sizes it might have.
+	 */
+	smgrforgetdb(InvalidOid);
+
 	/*
 	 * Restore memory context.
 	 */
@@ -109,6 +109,7 @@ static int fsm_set_and_search(Relation rel, FSMAddress addr, uint16 slot,
 				   uint8 newValue, uint8 minValue);
 static BlockNumber fsm_search(Relation rel, uint8 min_cat);
 static uint8 fsm_vacuum_page(Relation rel, FSMAddress addr, bool *eof);
+static void fsm_update_recursive(Relation rel, FSMAddress addr, uint8 new_cat);
 
 
 /******** public API ********/
@@ -188,6 +189,47 @@ RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk, Size spaceAvail)
 	fsm_set_and_search(rel, addr, slot, new_cat, 0);
 }
 
+/*
+ * UpdateFreeSpaceMap - record the same free space for a range of pages
+ *
+ * This is for pages newly added to the relation in bulk.  Unlike
+ * RecordPageWithFreeSpace, we update the upper levels of the map right away,
+ * so that searchers see the space without waiting for FreeSpaceMapVacuum.
+ */
+void
+UpdateFreeSpaceMap(Relation rel, BlockNumber startBlkNum,
+				   BlockNumber endBlkNum, Size freespace)
+{
+	uint8		new_cat = fsm_space_avail_to_cat(freespace);
+	BlockNumber blkno = startBlkNum;
+
+	while (blkno <= endBlkNum)
+	{
+		FSMAddress	addr;
+		uint16		slot;
+		Buffer		buf;
+		Page		page;
+		bool		modified = false;
+
+		/* set all the slots of the range on this bottom-level page */
+		addr = fsm_get_location(blkno, &slot);
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		for (; slot < SlotsPerFSMPage && blkno <= endBlkNum; slot++, blkno++)
+		{
+			if (fsm_set_avail(page, slot, new_cat))
+				modified = true;
+		}
+		if (modified)
+			MarkBufferDirtyHint(buf, false);
+		UnlockReleaseBuffer(buf);
+
+		fsm_update_recursive(rel, addr, new_cat);
+	}
+}
+
 /*
  * XLogRecordPageWithFreeSpace - like RecordPageWithFreeSpace, for use in
  *		WAL replay
@@ -633,6 +675,35 @@ fsm_set_and_search(Relation rel, FSMAddress addr, uint16 slot,
 	return newslot;
 }
 
+/*
+ * Make sure the upper levels of the tree, above the given page, advertise
+ * at least new_cat of free space for it.
+ */
+static void
+fsm_update_recursive(Relation rel, FSMAddress addr, uint8 new_cat)
+{
+	while (addr.level != FSM_ROOT_LEVEL)
+	{
+		FSMAddress	parent;
+		uint16		parentslot;
+		Buffer		buf;
+		Page		page;
+
+		parent = fsm_get_parent(addr, &parentslot);
+		buf = fsm_readbuf(rel, parent, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		/* never lower what's recorded, other pages below may have more */
+		if (fsm_get_avail(page, parentslot) < new_cat &&
+			fsm_set_avail(page, parentslot, new_cat))
+			MarkBufferDirtyHint(buf, false);
+		UnlockReleaseBuffer(buf);
+
+		addr = parent;
+	}
+}
+
 /*
  * Search the tree for a heap page with at least min_cat of free space
  */
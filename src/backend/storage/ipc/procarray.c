@@ -53,6 +53,8 @@
 #include "access/xlog.h"
 #include "catalog/catalog.h"
 #include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/spin.h"
@@ -90,6 +92,22 @@ typedef struct ProcArrayStruct
 	/* oldest catalog xmin of any replication slot */
 	TransactionId replication_slot_catalog_xmin;
 
+	/*
+	 * Shared snapshot cache: the last snapshot built by a backend that has
+	 * no XID of its own, and the xactCompletionCount it was built at, or 0
+	 * if there is none.  The XID arrays live in cachedSnapshotXip and
+	 * cachedSnapshotSubxip.  See SnapshotCacheGet().
+	 */
+	pg_atomic_uint64 cachedXactCompletionCount;
+	pg_atomic_flag cachedSnapshotFilling;	/* held while storing a snapshot */
+	bool		cachedTakenDuringRecovery;
+	bool		cachedSuboverflowed;
+	TransactionId cachedXmin;
+	TransactionId cachedXmax;
+	TransactionId cachedGlobalXmin;
+	int			cachedXcnt;
+	int			cachedSubxcnt;
+
 	/* indexes into allPgXact[], has PROCARRAY_MAXPROCS entries */
 	int			pgprocnos[FLEXIBLE_ARRAY_MEMBER];
 } ProcArrayStruct;
@@ -106,6 +124,12 @@ static TransactionId *KnownAssignedXids;
 static bool *KnownAssignedXidsValid;
 static TransactionId latestObservedXid = InvalidTransactionId;
 
+/*
+ * XID arrays of the shared snapshot cache
+ */
+static TransactionId *cachedSnapshotXip;
+static TransactionId *cachedSnapshotSubxip;
+
 /*
  * If we're in STANDBY_SNAPSHOT_PENDING state, standbySnapshotPendingXmin is
  * the highest xid that might still be running that we don't have in
@@ -150,6 +174,17 @@ static void DisplayXidCache(void);
 #define xc_slow_answer_inc()		((void) 0)
 #endif   /* XIDCACHE_DEBUG */
 
+static inline void ProcArrayEndTransactionInternal(PGPROC *proc,
+								PGXACT *pgxact, TransactionId latestXid);
+static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
+static bool GetSnapshotDataReuse(Snapshot snapshot);
+static bool SnapshotCacheGet(Snapshot snapshot, TransactionId *xmin,
+				 TransactionId *xmax, TransactionId *globalxmin,
+				 int *count, int *subcount, bool *suboverflowed);
+static void SnapshotCachePut(Snapshot snapshot, TransactionId xmin,
+				 TransactionId xmax, TransactionId globalxmin,
+				 int count, int subcount, bool suboverflowed);
+
 /* Primitives for KnownAssignedXids array handling for standby */
 static void KnownAssignedXidsCompress(bool force);
 static void KnownAssignedXidsAdd(TransactionId from_xid, TransactionId to_xid,
@@ -198,6 +233,13 @@ ProcArrayShmemSize(void)
 #define TOTAL_MAX_CACHED_SUBXIDS \
 	((PGPROC_MAX_CACHED_SUBXIDS + 1) * PROCARRAY_MAXPROCS)
 
+	/*
+	 * Outside recovery, a snapshot's subxip[] can hold every backend's whole
+	 * subxid cache, which is bigger if max_cached_subxids has been raised.
+	 */
+#define TOTAL_MAX_SNAPSHOT_SUBXIDS \
+	Max(TOTAL_MAX_CACHED_SUBXIDS, max_cached_subxids * PROCARRAY_MAXPROCS)
+
 	if (EnableHotStandby)
 	{
 		size = add_size(size,
@@ -207,6 +249,12 @@ ProcArrayShmemSize(void)
 						mul_size(sizeof(bool), TOTAL_MAX_CACHED_SUBXIDS));
 	}
 
+	/* The shared snapshot cache is as big as any snapshot */
+	size = add_size(size,
+					mul_size(sizeof(TransactionId), PROCARRAY_MAXPROCS));
+	size = add_size(size,
+					mul_size(sizeof(TransactionId), TOTAL_MAX_SNAPSHOT_SUBXIDS));
+
 	return size;
 }
 
@@ -240,6 +288,11 @@ CreateSharedProcArray(void)
 		procArray->headKnownAssignedXids = 0;
 		SpinLockInit(&procArray->known_assigned_xids_lck);
 		procArray->lastOverflowedXid = InvalidTransactionId;
+
+		/* zero means "not reusable" in a snapshot, so don't start there */
+		ShmemVariableCache->xactCompletionCount = 1;
+		pg_atomic_init_u64(&procArray->cachedXactCompletionCount, 0);
+		pg_atomic_init_flag(&procArray->cachedSnapshotFilling);
 	}
 
 	allProcs = ProcGlobal->allProcs;
@@ -258,6 +311,17 @@ CreateSharedProcArray(void)
 							mul_size(sizeof(bool), TOTAL_MAX_CACHED_SUBXIDS),
 							&found);
 	}
+
+	/* And the shared snapshot cache */
+	cachedSnapshotXip = (TransactionId *)
+		ShmemInitStruct("Cached Snapshot Xip",
+						mul_size(sizeof(TransactionId), PROCARRAY_MAXPROCS),
+						&found);
+	cachedSnapshotSubxip = (TransactionId *)
+		ShmemInitStruct("Cached Snapshot Subxip",
+						mul_size(sizeof(TransactionId),
+								 TOTAL_MAX_SNAPSHOT_SUBXIDS),
+						&found);
 }
 
 /*
@@ -343,6 +407,8 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
+
+		ShmemVariableCache->xactCompletionCount++;
 	}
 	else
 	{
@@ -399,26 +465,18 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 		 */
 		Assert(TransactionIdIsValid(allPgXact[proc->pgprocno].xid));
 
-		LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
-
-		pgxact->xid = InvalidTransactionId;
-		proc->lxid = InvalidLocalTransactionId;
-		pgxact->xmin = InvalidTransactionId;
-		/* must be cleared with xid/xmin: */
-		pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
-		pgxact->delayChkpt = false;		/* be sure this is cleared in abort */
-		proc->recoveryConflictPending = false;
-
-		/* Clear the subtransaction-XID cache too while holding the lock */
-		pgxact->nxids = 0;
-		pgxact->overflowed = false;
-
-		/* Also advance global latestCompletedXid while holding the lock */
-		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
-								  latestXid))
-			ShmemVariableCache->latestCompletedXid = latestXid;
-
-		LWLockRelease(ProcArrayLock);
+		/*
+		 * If we can immediately acquire ProcArrayLock, we clear our own XID
+		 * and release the lock.  If not, use group XID clearing to improve
+		 * efficiency.
+		 */
+		if (LWLockConditionalAcquire(ProcArrayLock, LW_EXCLUSIVE))
+		{
+			ProcArrayEndTransactionInternal(proc, pgxact, latestXid);
+			LWLockRelease(ProcArrayLock);
+		}
+		else
+			ProcArrayGroupClearXid(proc, latestXid);
 	}
 	else
 	{
@@ -441,6 +499,156 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 	}
 }
 
+/*
+ * Mark a write transaction as no longer running.
+ *
+ * We don't do any locking here; caller must handle that.
+ */
+static inline void
+ProcArrayEndTransactionInternal(PGPROC *proc, PGXACT *pgxact,
+								TransactionId latestXid)
+{
+	pgxact->xid = InvalidTransactionId;
+	proc->lxid = InvalidLocalTransactionId;
+	pgxact->xmin = InvalidTransactionId;
+	/* must be cleared with xid/xmin: */
+	pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
+	pgxact->delayChkpt = false;		/* be sure this is cleared in abort */
+	proc->recoveryConflictPending = false;
+
+	/* Clear the subtransaction-XID cache too while holding the lock */
+	pgxact->nxids = 0;
+	pgxact->overflowed = false;
+
+	/* Also advance global latestCompletedXid while holding the lock */
+	if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
+							  latestXid))
+		ShmemVariableCache->latestCompletedXid = latestXid;
+
+	/* and invalidate cached snapshots */
+	ShmemVariableCache->xactCompletionCount++;
+}
+
+/*
+ * ProcArrayGroupClearXid -- group XID clearing
+ *
+ * When we cannot immediately acquire ProcArrayLock in exclusive mode at
+ * commit time, add ourselves to a list of processes that need their XIDs
+ * cleared.  The first process to add itself to the list will acquire
+ * ProcArrayLock in exclusive mode and perform ProcArrayEndTransactionInternal
+ * on behalf of all group members.  This avoids a great deal of contention
+ * around ProcArrayLock when many processes are trying to commit at once,
+ * since the lock need not be repeatedly handed off from one committing
+ * process to the next.
+ */
+static void
+ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid)
+{
+	volatile PROC_HDR *procglobal = ProcGlobal;
+	uint32		nextidx;
+	uint32		wakeidx;
+
+	/* We should definitely have an XID to clear. */
+	Assert(TransactionIdIsValid(allPgXact[proc->pgprocno].xid));
+
+	/* Add ourselves to the list of processes needing a group XID clear. */
+	proc->procArrayGroupMember = true;
+	proc->procArrayGroupMemberXid = latestXid;
+	nextidx = pg_atomic_read_u32(&procglobal->procArrayGroupFirst);
+	for (;;)
+	{
+		pg_atomic_write_u32(&proc->procArrayGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&procglobal->procArrayGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will clear our XID.  It is
+	 * impossible to have followers without a leader because the first process
+	 * that has added itself to the list will always have nextidx as
+	 * INVALID_PGPROCNO.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		/* Sleep until the leader clears our XID. */
+		pgstat_report_wait_start(WAIT_EVENT_PROCARRAY_GROUP_UPDATE);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(&proc->sem);
+			if (!proc->procArrayGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->procArrayGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(&proc->sem);
+		return;
+	}
+
+	/* We are the leader.  Acquire the lock on behalf of everyone. */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
+	/*
+	 * Now that we've got the lock, clear the list of processes waiting for
+	 * group XID clearing, saving a pointer to the head of the list.  Trying
+	 * to pop elements one at a time could lead to an ABA problem.
+	 */
+	nextidx = pg_atomic_exchange_u32(&procglobal->procArrayGroupFirst,
+									 INVALID_PGPROCNO);
+
+	/* Remember head of list so we can perform wakeups after dropping lock. */
+	wakeidx = nextidx;
+
+	/* Walk the list and clear all XIDs. */
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &allProcs[nextidx];
+		PGXACT	   *pgxact = &allPgXact[nextidx];
+
+		ProcArrayEndTransactionInternal(member, pgxact,
+										member->procArrayGroupMemberXid);
+
+		/* Move to next proc in list. */
+		nextidx = pg_atomic_read_u32(&member->procArrayGroupNext);
+	}
+
+	/* We're done with the lock now. */
+	LWLockRelease(ProcArrayLock);
+
+	/*
+	 * Now that we've released the lock, go back and wake everybody up.  We
+	 * don't do this under the lock so as to keep lock hold times to a
+	 * minimum.  The system calls we need to perform to wake other processes
+	 * up are probably much slower than the simple memory writes we did while
+	 * holding the lock.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &allProcs[wakeidx];
+
+		wakeidx = pg_atomic_read_u32(&member->procArrayGroupNext);
+		pg_atomic_write_u32(&member->procArrayGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		member->procArrayGroupMember = false;
+
+		if (member != MyProc)
+			PGSemaphoreUnlock(&member->sem);
+	}
+}
+
 
 /*
  * ProcArrayClearTransaction -- clear the transaction fields
@@ -456,11 +664,14 @@ ProcArrayClearTransaction(PGPROC *proc)
 	PGXACT	   *pgxact = &allPgXact[proc->pgprocno];
 
 	/*
-	 * We can skip locking ProcArrayLock here, because this action does not
-	 * actually change anyone's view of the set of running XIDs: our entry is
-	 * duplicate with the gxact that has already been inserted into the
-	 * ProcArray.
+	 * This action does not actually change anyone's view of the set of
+	 * running XIDs: our entry is duplicate with the gxact that has already
+	 * been inserted into the ProcArray.  But our own snapshots leave out our
+	 * XID, so we must make sure that GetSnapshotData() doesn't reuse them,
+	 * which requires the lock.
 	 */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
 	pgxact->xid = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
@@ -473,6 +684,10 @@ ProcArrayClearTransaction(PGPROC *proc)
 	/* Clear the subtransaction-XID cache too */
 	pgxact->nxids = 0;
 	pgxact->overflowed = false;
+
+	ShmemVariableCache->xactCompletionCount++;
+
+	LWLockRelease(ProcArrayLock);
 }
 
 /*
@@ -1314,7 +1529,154 @@ GetMaxSnapshotXidCount(void)
 int
 GetMaxSnapshotSubxidCount(void)
 {
-	return TOTAL_MAX_CACHED_SUBXIDS;
+	return TOTAL_MAX_SNAPSHOT_SUBXIDS;
+}
+
+/*
+ * GetSnapshotDataReuse -- try to reuse the previous contents of a snapshot
+ *
+ * The set of XIDs that GetSnapshotData() considers running can only shrink
+ * when a transaction (or subtransaction) with an XID ends, which always
+ * happens with ProcArrayLock held exclusively and advances
+ * xactCompletionCount; XIDs assigned since a snapshot was taken are >= its
+ * xmax, so they are running as far as it is concerned anyway.  Hence, if
+ * xactCompletionCount hasn't moved, walking the procarray again would just
+ * produce the same snapshot, with all the connections being scanned for
+ * nothing.  That is the common case when most of the transactions are
+ * read-only.
+ *
+ * Since the snapshot's xmin is still the oldest running XID, it's fine to
+ * advertise it as our xmin again.  RecentGlobalXmin is not recomputed: the
+ * value from the last full computation can only be older than the current
+ * one, which is safe.
+ *
+ * Caller must hold ProcArrayLock.  Returns true if the snapshot was reused.
+ */
+static bool
+GetSnapshotDataReuse(Snapshot snapshot)
+{
+	if (snapshot->snapXactCompletionCount == 0 ||
+		snapshot->snapXactCompletionCount !=
+		ShmemVariableCache->xactCompletionCount)
+		return false;
+
+	/* recovery might have ended in between */
+	if (snapshot->takenDuringRecovery != RecoveryInProgress())
+		return false;
+
+	if (!TransactionIdIsValid(MyPgXact->xmin))
+		MyPgXact->xmin = TransactionXmin = snapshot->xmin;
+	RecentXmin = snapshot->xmin;
+
+	snapshot->curcid = GetCurrentCommandId(false);
+	snapshot->active_count = 0;
+	snapshot->regd_count = 0;
+	snapshot->copied = false;
+
+	return true;
+}
+
+/*
+ * SnapshotCacheGet -- try to copy the shared snapshot cache into a snapshot
+ *
+ * This extends the reasoning of GetSnapshotDataReuse() to snapshots built by
+ * other backends: if xactCompletionCount hasn't moved since the cached
+ * snapshot was built, a scan of the procarray would find the same running
+ * XIDs, so copying them is enough.  The cache is only filled by, and only
+ * used by, backends that have no XID of their own, since a snapshot leaves
+ * out the XIDs of the backend that takes it.
+ *
+ * The cached globalxmin is the one computed when the cache was filled, before
+ * vacuum_defer_cleanup_age and the replication slots were applied; as with
+ * RecentGlobalXmin in GetSnapshotDataReuse(), it can only be older than the
+ * current value.
+ *
+ * Caller must hold ProcArrayLock, and passes in the xmax it computed.
+ * Returns true, with the other output arguments set and the XIDs copied into the snapshot's arrays, on a cache hit.
+ */
+static bool
+SnapshotCacheGet(Snapshot snapshot, TransactionId *xmin, TransactionId *xmax,
+				 TransactionId *globalxmin, int *count, int *subcount,
+				 bool *suboverflowed)
+{
+	ProcArrayStruct *arrayP = procArray;
+
+	/*
+	 * The count can only change under exclusive ProcArrayLock, and the cache
+	 * is only stored into while the count doesn't match, so once we've seen
+	 * a match the contents stay put until we release the lock.
+	 */
+	if (pg_atomic_read_u64(&arrayP->cachedXactCompletionCount) !=
+		ShmemVariableCache->xactCompletionCount)
+		return false;
+	pg_read_barrier();
+
+	/* xmax should match too, but there's no harm in checking */
+	if (arrayP->cachedTakenDuringRecovery != snapshot->takenDuringRecovery ||
+		arrayP->cachedXmax != *xmax)
+		return false;
+
+	*xmin = arrayP->cachedXmin;
+	*globalxmin = arrayP->cachedGlobalXmin;
+	*count = arrayP->cachedXcnt;
+	*subcount = arrayP->cachedSubxcnt;
+	*suboverflowed = arrayP->cachedSuboverflowed;
+
+	memcpy(snapshot->xip, cachedSnapshotXip,
+		   *count * sizeof(TransactionId));
+	memcpy(snapshot->subxip, cachedSnapshotSubxip,
+		   *subcount * sizeof(TransactionId));
+
+	return true;
+}
+
+/*
+ * SnapshotCachePut -- store a freshly built snapshot in the shared cache
+ *
+ * Several backends holding ProcArrayLock in shared mode could try this at
+ * once; whoever gets cachedSnapshotFilling stores its snapshot, and the
+ * others just don't bother.  The snapshot must not have been taken by a
+ * backend with an XID, see SnapshotCacheGet().
+ *
+ * Caller must hold ProcArrayLock.
+ */
+static void
+SnapshotCachePut(Snapshot snapshot, TransactionId xmin, TransactionId xmax,
+				 TransactionId globalxmin, int count, int subcount,
+				 bool suboverflowed)
+{
+	ProcArrayStruct *arrayP = procArray;
+	uint64		completionCount = ShmemVariableCache->xactCompletionCount;
+
+	if (pg_atomic_read_u64(&arrayP->cachedXactCompletionCount) ==
+		completionCount)
+		return;
+	if (!pg_atomic_test_set_flag(&arrayP->cachedSnapshotFilling))
+		return;
+
+	/* somebody else might have filled it while we were getting the flag */
+	if (pg_atomic_read_u64(&arrayP->cachedXactCompletionCount) !=
+		completionCount)
+	{
+		arrayP->cachedTakenDuringRecovery = snapshot->takenDuringRecovery;
+		arrayP->cachedXmin = xmin;
+		arrayP->cachedXmax = xmax;
+		arrayP->cachedGlobalXmin = globalxmin;
+		arrayP->cachedXcnt = count;
+		arrayP->cachedSubxcnt = subcount;
+		arrayP->cachedSuboverflowed = suboverflowed;
+		memcpy(cachedSnapshotXip, snapshot->xip,
+			   count * sizeof(TransactionId));
+		memcpy(cachedSnapshotSubxip, snapshot->subxip,
+			   subcount * sizeof(TransactionId));
+
+		/* make the contents visible before the count that validates them */
+		pg_write_barrier();
+		pg_atomic_write_u64(&arrayP->cachedXactCompletionCount,
+							completionCount);
+	}
+
+	pg_atomic_clear_flag(&arrayP->cachedSnapshotFilling);
 }
 
 /*
@@ -1365,6 +1727,7 @@ GetSnapshotData(Snapshot snapshot)
 	bool		suboverflowed = false;
 	volatile TransactionId replication_slot_xmin = InvalidTransactionId;
 	volatile TransactionId replication_slot_catalog_xmin = InvalidTransactionId;
+	bool		useCache;
 
 	Assert(snapshot != NULL);
 
@@ -1406,6 +1769,14 @@ GetSnapshotData(Snapshot snapshot)
 	 */
 	LWLockAcquire(ProcArrayLock, LW_SHARED);
 
+	if (GetSnapshotDataReuse(snapshot))
+	{
+		LWLockRelease(ProcArrayLock);
+		if (snapshot->suboverflowed)
+			pgstat_count_overflowed_snapshot();
+		return snapshot;
+	}
+
 	/* xmax is always latestCompletedXid + 1 */
 	xmax = ShmemVariableCache->latestCompletedXid;
 	Assert(TransactionIdIsNormal(xmax));
@@ -1416,7 +1787,17 @@ GetSnapshotData(Snapshot snapshot)
 
 	snapshot->takenDuringRecovery = RecoveryInProgress();
 
-	if (!snapshot->takenDuringRecovery)
+	/*
+	 * If we have no XID of our own, a snapshot built by another backend in
+	 * the same state will do, see SnapshotCacheGet().
+	 */
+	useCache = !TransactionIdIsValid(MyPgXact->xid);
+
+	if (useCache &&
+		SnapshotCacheGet(snapshot, &xmin, &xmax, &globalxmin,
+						 &count, &subcount, &suboverflowed))
+		useCache = false;		/* no need to store it back */
+	else if (!snapshot->takenDuringRecovery)
 	{
 		int		   *pgprocnos = arrayP->pgprocnos;
 		int			numProcs;
@@ -1549,6 +1930,9 @@ GetSnapshotData(Snapshot snapshot)
 			suboverflowed = true;
 	}
 
+	if (useCache)
+		SnapshotCachePut(snapshot, xmin, xmax, globalxmin,
+						 count, subcount, suboverflowed);
 
 	/* fetch into volatile var while ProcArrayLock is held */
 	replication_slot_xmin = procArray->replication_slot_xmin;
@@ -1557,6 +1941,8 @@ GetSnapshotData(Snapshot snapshot)
 	if (!TransactionIdIsValid(MyPgXact->xmin))
 		MyPgXact->xmin = TransactionXmin = xmin;
 
+	snapshot->snapXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+
 	LWLockRelease(ProcArrayLock);
 
 	/*
@@ -1595,6 +1981,8 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->xcnt = count;
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
+	if (suboverflowed)
+		pgstat_count_overflowed_snapshot();
 
 	snapshot->curcid = GetCurrentCommandId(false);
 
@@ -1833,7 +2221,13 @@ GetRunningTransactionData(void)
 		if (TransactionIdPrecedes(xid, oldestRunningXid))
 			oldestRunningXid = xid;
 
-		if (pgxact->overflowed)
+		/*
+		 * A cache holding more than PGPROC_MAX_CACHED_SUBXIDS entries could
+		 * give a standby more subxids than it has room for, so treat it as
+		 * overflowed; the standby then waits for the transaction to end, as
+		 * it does for a cache that really overflowed.
+		 */
+		if (pgxact->overflowed || pgxact->nxids > PGPROC_MAX_CACHED_SUBXIDS)
 			suboverflowed = true;
 	}
 
@@ -2836,6 +3230,8 @@ XidCacheRemoveRunningXids(TransactionId xid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
 
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -3019,6 +3415,8 @@ ExpireTreeKnownAssignedTransactionIds(TransactionId xid, int nsubxids,
 							  max_xid))
 		ShmemVariableCache->latestCompletedXid = max_xid;
 
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -3031,6 +3429,7 @@ ExpireAllKnownAssignedTransactionIds(void)
 {
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	KnownAssignedXidsRemovePreceding(InvalidTransactionId);
+	ShmemVariableCache->xactCompletionCount++;
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -3043,6 +3442,7 @@ ExpireOldKnownAssignedTransactionIds(TransactionId xid)
 {
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	KnownAssignedXidsRemovePreceding(xid);
+	ShmemVariableCache->xactCompletionCount++;
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -21,6 +21,8 @@
 #include "storage/proc.h"
 #include "storage/sinvaladt.h"
 #include "utils/inval.h"
+#include "utils/sharedcatcache.h"
+#include "utils/sharedplancache.h"
 
 
 uint64		SharedInvalidMessageCounter;
@@ -44,10 +46,16 @@ volatile sig_atomic_t catchupInterruptPending = false;
 /*
  * SendSharedInvalidMessages
  *	Add shared-cache-invalidation message(s) to the global SI message queue.
+ *
+ * The shared plan and catalog caches are not fed from the queue but get to
+ * see the messages first, so that no backend acting on them can still find
+ * a plan or tuple they invalidate.
  */
 void
 SendSharedInvalidMessages(const SharedInvalidationMessage *msgs, int n)
 {
+	SharedPlanCacheInvalidate(msgs, n);
+	SharedCatCacheInvalidate(msgs, n);
 	SIInsertDataEntries(msgs, n);
 }
 
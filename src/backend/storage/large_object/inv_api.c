@@ -308,6 +308,12 @@ inv_open(Oid lobjId, int flags, MemoryContext mcxt)
 	retval->offset = 0;
 	retval->snapshot = snapshot;
 	retval->flags = descflags;
+	retval->mcxt = mcxt;
+	retval->lastend = PG_UINT64_MAX;
+	retval->rabuf = NULL;
+	retval->rastart = 0;
+	retval->ralen = 0;
+	retval->raeof = false;
 
 	return retval;
 }
@@ -324,6 +330,8 @@ inv_close(LargeObjectDesc *obj_desc)
 	UnregisterSnapshotFromOwner(obj_desc->snapshot,
 								TopTransactionResourceOwner);
 
+	if (obj_desc->rabuf)
+		pfree(obj_desc->rabuf);
 	pfree(obj_desc);
 }
 
@@ -460,27 +468,25 @@ inv_tell(LargeObjectDesc *obj_desc)
 	return obj_desc->offset;
 }
 
-int
-inv_read(LargeObjectDesc *obj_desc, char *buf, int nbytes)
+/*
+ * Read up to nbytes of the LO starting at offset into buf, with one index
+ * scan.  Returns the number of bytes read, which is less than nbytes only
+ * if the end of the LO was reached.
+ */
+static int
+inv_read_pages(LargeObjectDesc *obj_desc, uint64 offset, char *buf,
+			   int nbytes)
 {
 	int			nread = 0;
 	int64		n;
 	int64		off;
 	int			len;
-	int32		pageno = (int32) (obj_desc->offset / LOBLKSIZE);
+	int32		pageno = (int32) (offset / LOBLKSIZE);
 	uint64		pageoff;
 	ScanKeyData skey[2];
 	SysScanDesc sd;
 	HeapTuple	tuple;
 
-	Assert(PointerIsValid(obj_desc));
-	Assert(buf != NULL);
-
-	if (nbytes <= 0)
-		return 0;
-
-	open_lo_relation();
-
 	ScanKeyInit(&skey[0],
 				Anum_pg_largeobject_loid,
 				BTEqualStrategyNumber, F_OIDEQ,
@@ -510,19 +516,19 @@ inv_read(LargeObjectDesc *obj_desc, char *buf, int nbytes)
 		 * want missing sections to read out as zeroes.
 		 */
 		pageoff = ((uint64) data->pageno) * LOBLKSIZE;
-		if (pageoff > obj_desc->offset)
+		if (pageoff > offset)
 		{
-			n = pageoff - obj_desc->offset;
+			n = pageoff - offset;
 			n = (n <= (nbytes - nread)) ? n : (nbytes - nread);
 			MemSet(buf + nread, 0, n);
 			nread += n;
-			obj_desc->offset += n;
+			offset += n;
 		}
 
 		if (nread < nbytes)
 		{
-			Assert(obj_desc->offset >= pageoff);
-			off = (int) (obj_desc->offset - pageoff);
+			Assert(offset >= pageoff);
+			off = (int) (offset - pageoff);
 			Assert(off >= 0 && off < LOBLKSIZE);
 
 			getdatafield(data, &datafield, &len, &pfreeit);
@@ -532,7 +538,7 @@ inv_read(LargeObjectDesc *obj_desc, char *buf, int nbytes)
 				n = (n <= (nbytes - nread)) ? n : (nbytes - nread);
 				memcpy(buf + nread, VARDATA(datafield) + off, n);
 				nread += n;
-				obj_desc->offset += n;
+				offset += n;
 			}
 			if (pfreeit)
 				pfree(datafield);
@@ -547,6 +553,69 @@ inv_read(LargeObjectDesc *obj_desc, char *buf, int nbytes)
 	return nread;
 }
 
+int
+inv_read(LargeObjectDesc *obj_desc, char *buf, int nbytes)
+{
+	int			nread = 0;
+	int			n;
+
+	Assert(PointerIsValid(obj_desc));
+	Assert(buf != NULL);
+
+	if (nbytes <= 0)
+		return 0;
+
+	/*
+	 * A descriptor opened for reading only reads as of a fixed snapshot, so
+	 * data read ahead for it can't go stale.  Take what we can from there.
+	 */
+	if (obj_desc->rabuf != NULL && obj_desc->offset >= obj_desc->rastart)
+	{
+		uint64		raoff = obj_desc->offset - obj_desc->rastart;
+
+		if (raoff < obj_desc->ralen)
+		{
+			n = Min(obj_desc->ralen - (int) raoff, nbytes);
+			memcpy(buf, obj_desc->rabuf + raoff, n);
+			nread += n;
+			obj_desc->offset += n;
+		}
+		if (nread >= nbytes ||
+			(obj_desc->raeof &&
+			 obj_desc->offset >= obj_desc->rastart + obj_desc->ralen))
+		{
+			obj_desc->lastend = obj_desc->offset;
+			return nread;
+		}
+	}
+
+	open_lo_relation();
+
+	if (obj_desc->snapshot != NULL && nbytes - nread < LO_READAHEAD_SIZE &&
+		(nread > 0 || obj_desc->offset == obj_desc->lastend))
+	{
+		/* Fill the read-ahead buffer, and give the caller what it wants */
+		if (obj_desc->rabuf == NULL)
+			obj_desc->rabuf = (char *) MemoryContextAlloc(obj_desc->mcxt,
+														  LO_READAHEAD_SIZE);
+		obj_desc->rastart = obj_desc->offset;
+		obj_desc->ralen = inv_read_pages(obj_desc, obj_desc->rastart,
+										 obj_desc->rabuf, LO_READAHEAD_SIZE);
+		obj_desc->raeof = (obj_desc->ralen < LO_READAHEAD_SIZE);
+
+		n = Min(obj_desc->ralen, nbytes - nread);
+		memcpy(buf + nread, obj_desc->rabuf, n);
+	}
+	else
+		n = inv_read_pages(obj_desc, obj_desc->offset, buf + nread,
+						   nbytes - nread);
+	nread += n;
+	obj_desc->offset += n;
+	obj_desc->lastend = obj_desc->offset;
+
+	return nread;
+}
+
 int
 inv_write(LargeObjectDesc *obj_desc, const char *buf, int nbytes)
 {
@@ -83,6 +83,7 @@
 #include "commands/async.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "pgstat.h"
 #include "postmaster/postmaster.h"
 #include "replication/slot.h"
 #include "storage/ipc.h"
@@ -131,6 +132,66 @@ static int	LWLockTranchesAllocated = 0;
 LWLockPadded *MainLWLockArray = NULL;
 static LWLockTranche MainLWLockTranche;
 
+/*
+ * Names of the individually-named locks in MainLWLockArray, as reported in
+ * pg_stat_activity.wait_event.  Keep in sync with lwlock.h.
+ */
+static const char *const IndividualLWLockNames[] = {
+	"main",						/* formerly BufFreelistLock */
+	"ShmemIndexLock",
+	"OidGenLock",
+	"XidGenLock",
+	"ProcArrayLock",
+	"SInvalReadLock",
+	"SInvalWriteLock",
+	"WALBufMappingLock",
+	"WALWriteLock",
+	"ControlFileLock",
+	"CheckpointLock",
+	"CLogControlLock",
+	"SubtransControlLock",
+	"MultiXactGenLock",
+	"MultiXactOffsetControlLock",
+	"MultiXactMemberControlLock",
+	"RelCacheInitLock",
+	"CheckpointerCommLock",
+	"TwoPhaseStateLock",
+	"TablespaceCreateLock",
+	"BtreeVacuumLock",
+	"AddinShmemInitLock",
+	"AutovacuumLock",
+	"AutovacuumScheduleLock",
+	"SyncScanLock",
+	"RelationMappingLock",
+	"AsyncCtlLock",
+	"AsyncQueueLock",
+	"SerializableXactHashLock",
+	"SerializableFinishedListLock",
+	"SerializablePredicateLockListLock",
+	"OldSerXidLock",
+	"SyncRepLock",
+	"BackgroundWorkerLock",
+	"DynamicSharedMemoryControlLock",
+	"AutoFileLock",
+	"ReplicationSlotAllocationLock",
+	"ReplicationSlotControlLock",
+	"CommitTsControlLock",
+	"CommitTsLock",
+	"ReplicationOriginLock",
+	"MultiXactTruncationLock",
+	"SharedPlanCacheLock",
+	"SharedCatCacheLock",
+	"TSSharedDictLock",
+	"LogicalRepWorkerLock",
+	"PgStatLock"
+};
+
+/*
+ * Wait event IDs of locks outside MainLWLockArray have this bit set, with
+ * the tranche ID in the low bits.
+ */
+#define LWLOCK_EVENT_TRANCHE_FLAG	0x8000
+
 /*
  * We use this structure to keep track of locked LWLocks for release
  * during error recovery.  Normally, only a few will be held at once, but
@@ -348,13 +409,13 @@ NumLWLocks(void)
 	numLocks += CommitTsShmemBuffers();
 
 	/* subtrans.c needs one per SubTrans buffer */
-	numLocks += NUM_SUBTRANS_BUFFERS;
+	numLocks += subtrans_buffers;
 
 	/* multixact.c needs two SLRU areas */
-	numLocks += NUM_MXACTOFFSET_BUFFERS + NUM_MXACTMEMBER_BUFFERS;
+	numLocks += multixact_offsets_buffers + multixact_members_buffers;
 
 	/* async.c needs one per Async buffer */
-	numLocks += NUM_ASYNC_BUFFERS;
+	numLocks += notify_buffers;
 
 	/* predicate.c needs one per old serializable xid buffer */
 	numLocks += NUM_OLDSERXID_BUFFERS;
@@ -570,6 +631,63 @@ LWLockInitialize(LWLock *lock, int tranche_id)
 	dlist_init(&lock->waiters);
 }
 
+/*
+ * LWLockReportWaitStart - report that we're about to sleep on the given lock
+ *
+ * Locks in MainLWLockArray are identified by their position in it, so that
+ * the individually-named ones can be told apart; all others only by their
+ * tranche.
+ */
+static inline void
+LWLockReportWaitStart(LWLock *lock)
+{
+	uint32		eventId;
+
+	if (lock->tranche == 0)
+		eventId = (uint32) T_ID(lock);
+	else
+		eventId = LWLOCK_EVENT_TRANCHE_FLAG | (uint32) lock->tranche;
+	pgstat_report_wait_start(PG_WAIT_LWLOCK | eventId);
+}
+
+/*
+ * GetLWLockIdentifier - return the name of a lock wait event
+ *
+ * eventId is an ID reported by LWLockReportWaitStart, possibly in another
+ * backend.  Tranches registered by that backend but not by this one are
+ * reported as "extension".
+ */
+const char *
+GetLWLockIdentifier(uint16 eventId)
+{
+	StaticAssertStmt(lengthof(IndividualLWLockNames) == NUM_INDIVIDUAL_LWLOCKS,
+					 "IndividualLWLockNames does not match lwlock.h");
+
+	if (eventId & LWLOCK_EVENT_TRANCHE_FLAG)
+	{
+		int			tranche_id = eventId & ~LWLOCK_EVENT_TRANCHE_FLAG;
+
+		if (tranche_id >= LWLockTranchesAllocated ||
+			LWLockTrancheArray[tranche_id] == NULL)
+			return "extension";
+		return LWLockTrancheArray[tranche_id]->name;
+	}
+
+	if (eventId < NUM_INDIVIDUAL_LWLOCKS)
+		return IndividualLWLockNames[eventId];
+	if (eventId < LOCK_MANAGER_LWLOCK_OFFSET)
+		return "buffer_mapping";
+	if (eventId < PREDICATELOCK_MANAGER_LWLOCK_OFFSET)
+		return "lock_manager";
+	if (eventId < SMGR_SIZE_LWLOCK_OFFSET)
+		return "predicate_lock_manager";
+	if (eventId < PAGE_COMPRESS_LWLOCK_OFFSET)
+		return "smgr_size";
+	if (eventId < NUM_FIXED_LWLOCKS)
+		return "page_compress";
+	return "main";
+}
+
 /*
  * Internal function that tries to atomically acquire the lwlock in the passed
  * in mode.
@@ -1021,6 +1139,8 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 
 		TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), T_ID(lock), mode);
 
+		LWLockReportWaitStart(lock);
+
 		for (;;)
 		{
 			PGSemaphoreLock(&proc->sem);
@@ -1029,6 +1149,8 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 			extraWaits++;
 		}
 
+		pgstat_report_wait_end();
+
 		/* Retrying, allow LWLockRelease to release waiters again. */
 		pg_atomic_fetch_or_u32(&lock->state, LW_FLAG_RELEASE_OK);
 
@@ -1179,6 +1301,8 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 #endif
 			TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), T_ID(lock), mode);
 
+			LWLockReportWaitStart(lock);
+
 			for (;;)
 			{
 				PGSemaphoreLock(&proc->sem);
@@ -1187,6 +1311,8 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 				extraWaits++;
 			}
 
+			pgstat_report_wait_end();
+
 #ifdef LOCK_DEBUG
 			{
 				/* not waiting anymore */
@@ -1404,6 +1530,8 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
 		TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), T_ID(lock),
 										   LW_EXCLUSIVE);
 
+		LWLockReportWaitStart(lock);
+
 		for (;;)
 		{
 			PGSemaphoreLock(&proc->sem);
@@ -1412,6 +1540,8 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
 			extraWaits++;
 		}
 
+		pgstat_report_wait_end();
+
 #ifdef LOCK_DEBUG
 		{
 			/* not waiting anymore */
@@ -192,6 +192,7 @@
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/predicate.h"
 #include "storage/predicate_internals.h"
@@ -354,6 +355,10 @@ static SERIALIZABLEXACT *OldCommittedSxact;
 /* This configuration variable is used to set the predicate lock table size */
 int			max_predicate_locks_per_xact;		/* set by guc.c */
 
+/* These control when a transaction's predicate locks get promoted */
+int			max_predicate_locks_per_relation;	/* set by guc.c */
+int			max_predicate_locks_per_page;		/* set by guc.c */
+
 /*
  * This provides a list of objects in order to track transactions
  * participating in predicate locking.  Entries in the list are fixed size,
@@ -1529,7 +1534,7 @@ GetSafeSnapshot(Snapshot origSnapshot)
 				 SxactIsROUnsafe(MySerializableXact)))
 		{
 			LWLockRelease(SerializableXactHashLock);
-			ProcWaitForSignal();
+			ProcWaitForSignal(WAIT_EVENT_SAFE_SNAPSHOT);
 			LWLockAcquire(SerializableXactHashLock, LW_EXCLUSIVE);
 		}
 		MySerializableXact->flags &= ~SXACT_FLAG_DEFERRABLE_WAITING;
@@ -2129,16 +2134,15 @@ DeleteChildTargetLocks(const PREDICATELOCKTARGETTAG *newtargettag)
 
 /*
  * Returns the promotion threshold for a given predicate lock
- * target. This is the number of descendant locks required to promote
- * to the specified tag. Note that the threshold includes non-direct
- * descendants, e.g. both tuples and pages for a relation lock.
+ * target. This is the number of descendant locks a transaction may hold
+ * before it is promoted to the specified tag. Note that the threshold
+ * includes non-direct descendants, e.g. both tuples and pages for a
+ * relation lock.
  *
- * TODO SSI: We should do something more intelligent about what the
- * thresholds are, either making it proportional to the number of
- * tuples in a page & pages in a relation, or at least making it a
- * GUC. Currently the threshold is 3 for a page lock, and
- * max_pred_locks_per_transaction/2 for a relation lock, chosen
- * entirely arbitrarily (and without benchmarking).
+ * The thresholds come from max_pred_locks_per_page, and from
+ * max_pred_locks_per_relation, which when negative is taken as a divisor
+ * of max_pred_locks_per_transaction.  The defaults promote at 3 locks for
+ * a page and max_pred_locks_per_transaction/2 locks for a relation.
  */
 static int
 PredicateLockPromotionThreshold(const PREDICATELOCKTARGETTAG *tag)
@@ -2146,10 +2150,13 @@ PredicateLockPromotionThreshold(const PREDICATELOCKTARGETTAG *tag)
 	switch (GET_PREDICATELOCKTARGETTAG_TYPE(*tag))
 	{
 		case PREDLOCKTAG_RELATION:
-			return max_predicate_locks_per_xact / 2;
+			return max_predicate_locks_per_relation < 0
+				? (max_predicate_locks_per_xact
+				   / -max_predicate_locks_per_relation) - 1
+				: max_predicate_locks_per_relation;
 
 		case PREDLOCKTAG_PAGE:
-			return 3;
+			return max_predicate_locks_per_page;
 
 		case PREDLOCKTAG_TUPLE:
 
@@ -2204,7 +2211,7 @@ CheckAndPromotePredicateLockRequest(const PREDICATELOCKTARGETTAG *reqtag)
 		else
 			parentlock->childLocks++;
 
-		if (parentlock->childLocks >=
+		if (parentlock->childLocks >
 			PredicateLockPromotionThreshold(&targettag))
 		{
 			/*
@@ -3514,6 +3521,7 @@ ClearOldPredicateLocks(void)
 {
 	SERIALIZABLEXACT *finishedSxact;
 	PREDICATELOCK *predlock;
+	SerCommitSeqNo canPartialClearThrough;
 
 	/*
 	 * Loop through finished transactions. They are in commit order, so we can
@@ -3582,10 +3590,27 @@ ClearOldPredicateLocks(void)
 		}
 		finishedSxact = nextSxact;
 	}
+	canPartialClearThrough = PredXact->CanPartialClearThrough;
 	LWLockRelease(SerializableXactHashLock);
 
+	/*
+	 * Nothing more to do unless some transactions have been summarized.
+	 * Only SummarizeOldestCommittedSxact() can make this list non-empty, and
+	 * it needs the lock we're holding, so we can check it without taking
+	 * SerializablePredicateLockListLock.
+	 */
+	if (SHMQueueEmpty(&OldCommittedSxact->predicateLocks))
+	{
+		LWLockRelease(SerializableFinishedListLock);
+		return;
+	}
+
 	/*
 	 * Loop through predicate locks on dummy transaction for summarized data.
+	 *
+	 * CanPartialClearThrough only moves forward, so the value we saw above
+	 * is good enough for all of them; that saves taking
+	 * SerializableXactHashLock for each lock.
 	 */
 	LWLockAcquire(SerializablePredicateLockListLock, LW_SHARED);
 	predlock = (PREDICATELOCK *)
@@ -3602,11 +3627,9 @@ ClearOldPredicateLocks(void)
 						 &predlock->xactLink,
 						 offsetof(PREDICATELOCK, xactLink));
 
-		LWLockAcquire(SerializableXactHashLock, LW_SHARED);
 		Assert(predlock->commitSeqNo != 0);
 		Assert(predlock->commitSeqNo != InvalidSerCommitSeqNo);
-		canDoPartialCleanup = (predlock->commitSeqNo <= PredXact->CanPartialClearThrough);
-		LWLockRelease(SerializableXactHashLock);
+		canDoPartialCleanup = (predlock->commitSeqNo <= canPartialClearThrough);
 
 		/*
 		 * If this lock originally belonged to an old enough transaction, we
@@ -39,9 +39,11 @@
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
+#include "storage/bufmgr.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
 #include "storage/pmsignal.h"
@@ -58,6 +60,10 @@ int			DeadlockTimeout = 1000;
 int			StatementTimeout = 0;
 int			LockTimeout = 0;
 bool		log_lock_waits = false;
+int			max_cached_subxids = PGPROC_MAX_CACHED_SUBXIDS;
+
+/* Number of fast-path lock groups of each PGPROC, see InitializeMaxBackends */
+int			FastPathLockGroupsPerBackend = 0;
 
 /* Pointer to this process's PGPROC and PGXACT structs, if any */
 PGPROC	   *MyProc = NULL;
@@ -89,6 +95,7 @@ static void RemoveProcFromArray(int code, Datum arg);
 static void ProcKill(int code, Datum arg);
 static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
+static Size FastPathLockArraySize(void);
 
 
 /*
@@ -114,9 +121,37 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(PGXACT)));
 	size = add_size(size, mul_size(max_prepared_xacts, sizeof(PGXACT)));
 
+	/* fast-path lock arrays of all the PGPROCs */
+	size = add_size(size,
+					mul_size(MaxBackends + NUM_AUXILIARY_PROCS +
+							 max_prepared_xacts,
+							 FastPathLockArraySize()));
+
+	/* subxid caches of all the PGPROCs */
+	size = add_size(size,
+					mul_size(MaxBackends + NUM_AUXILIARY_PROCS +
+							 max_prepared_xacts,
+							 mul_size(max_cached_subxids,
+									  sizeof(TransactionId))));
+
 	return size;
 }
 
+/*
+ * Report the space needed by the fast-path lock arrays of one PGPROC.
+ */
+static Size
+FastPathLockArraySize(void)
+{
+	Size		size;
+
+	size = mul_size(FastPathLockGroupsPerBackend, sizeof(uint64));
+	size = add_size(size,
+					mul_size(FastPathLockSlotsPerBackend(), sizeof(Oid)));
+
+	return MAXALIGN(size);
+}
+
 /*
  * Report number of semaphores needed by InitProcGlobal.
  */
@@ -159,6 +194,9 @@ InitProcGlobal(void)
 {
 	PGPROC	   *procs;
 	PGXACT	   *pgxacts;
+	char	   *fpPtr;
+	Size		fpSize;
+	TransactionId *subxidPtr;
 	int			i,
 				j;
 	bool		found;
@@ -181,6 +219,8 @@ InitProcGlobal(void)
 	ProcGlobal->startupBufferPinWaitBufId = -1;
 	ProcGlobal->walwriterLatch = NULL;
 	ProcGlobal->checkpointerLatch = NULL;
+	pg_atomic_init_u32(&ProcGlobal->procArrayGroupFirst, INVALID_PGPROCNO);
+	pg_atomic_init_u32(&ProcGlobal->clogGroupFirst, INVALID_PGPROCNO);
 
 	/*
 	 * Create and initialize all the PGPROC structures we'll need.  There are
@@ -212,6 +252,28 @@ InitProcGlobal(void)
 	MemSet(pgxacts, 0, TotalProcs * sizeof(PGXACT));
 	ProcGlobal->allPgXact = pgxacts;
 
+	/*
+	 * And the fast-path lock arrays, whose size depends on
+	 * max_locks_per_transaction.
+	 */
+	fpSize = FastPathLockArraySize();
+	fpPtr = (char *) ShmemAlloc(TotalProcs * fpSize);
+	if (!fpPtr)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory")));
+	MemSet(fpPtr, 0, TotalProcs * fpSize);
+
+	/* Likewise the subxid caches, sized by max_cached_subxids */
+	subxidPtr = (TransactionId *)
+		ShmemAlloc(mul_size(TotalProcs,
+							mul_size(max_cached_subxids,
+									 sizeof(TransactionId))));
+	if (!subxidPtr)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory")));
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		/* Common initialization for all PGPROCs, regardless of type. */
@@ -228,6 +290,15 @@ InitProcGlobal(void)
 			procs[i].backendLock = LWLockAssign();
 		}
 		procs[i].pgprocno = i;
+		procs[i].fpLockBits = (uint64 *) fpPtr;
+		procs[i].fpRelId = (Oid *)
+			(fpPtr + FastPathLockGroupsPerBackend * sizeof(uint64));
+		fpPtr += fpSize;
+		procs[i].subxids.xids = subxidPtr;
+		subxidPtr += max_cached_subxids;
+		pg_atomic_init_u32(&procs[i].walFlushGroupNext, INVALID_PGPROCNO);
+		pg_atomic_init_u32(&procs[i].procArrayGroupNext, INVALID_PGPROCNO);
+		pg_atomic_init_u32(&procs[i].clogGroupNext, INVALID_PGPROCNO);
 
 		/*
 		 * Newly created PGPROCs for normal backends, autovacuum and bgworkers
@@ -380,6 +451,23 @@ InitProcess(void)
 #endif
 	MyProc->recoveryConflictPending = false;
 
+	/* Initialize fields for group WAL flush */
+	MyProc->walFlushGroupMember = false;
+	Assert(pg_atomic_read_u32(&MyProc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+	/* Initialize fields for group XID clearing. */
+	MyProc->procArrayGroupMember = false;
+	MyProc->procArrayGroupMemberXid = InvalidTransactionId;
+	Assert(pg_atomic_read_u32(&MyProc->procArrayGroupNext) == INVALID_PGPROCNO);
+
+	/* Initialize fields for group transaction status update. */
+	MyProc->clogGroupMember = false;
+	MyProc->clogGroupMemberXid = InvalidTransactionId;
+	MyProc->clogGroupMemberXidStatus = TRANSACTION_STATUS_IN_PROGRESS;
+	MyProc->clogGroupMemberPage = -1;
+	MyProc->clogGroupMemberLsn = InvalidXLogRecPtr;
+	Assert(pg_atomic_read_u32(&MyProc->clogGroupNext) == INVALID_PGPROCNO);
+
 	/* Initialize fields for sync rep */
 	MyProc->waitLSN = 0;
 	MyProc->syncRepState = SYNC_REP_NOT_WAITING;
@@ -526,6 +614,12 @@ InitAuxiliaryProcess(void)
 	MyProc->lwWaitMode = 0;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
+	MyProc->walFlushGroupMember = false;
+	Assert(pg_atomic_read_u32(&MyProc->walFlushGroupNext) == INVALID_PGPROCNO);
+	MyProc->procArrayGroupMember = false;
+	Assert(pg_atomic_read_u32(&MyProc->procArrayGroupNext) == INVALID_PGPROCNO);
+	MyProc->clogGroupMember = false;
+	Assert(pg_atomic_read_u32(&MyProc->clogGroupNext) == INVALID_PGPROCNO);
 #ifdef USE_ASSERT_CHECKING
 	{
 		int			i;
@@ -1071,6 +1165,13 @@ ProcSleep(LOCALLOCK *locallock, LockMethod lockMethodTable)
 	if (RecoveryInProgress() && !InRecovery)
 		CheckRecoveryConflictDeadlock();
 
+	/*
+	 * Likewise, finish any asynchronous buffer reads of ours, since the lock
+	 * holder might be waiting for one of them; the deadlock detector doesn't
+	 * know about those.
+	 */
+	CompleteAsyncReads();
+
 	/* Reset deadlock_state before enabling the timeout handler */
 	deadlock_state = DS_NOT_YET_CHECKED;
 	got_deadlock_timeout = false;
@@ -1118,7 +1219,8 @@ ProcSleep(LOCALLOCK *locallock, LockMethod lockMethodTable)
 	 */
 	do
 	{
-		WaitLatch(MyLatch, WL_LATCH_SET, 0);
+		WaitLatch(MyLatch, WL_LATCH_SET, 0,
+				  PG_WAIT_LOCK | locallock->tag.lock.locktag_type);
 		ResetLatch(MyLatch);
 		/* check for deadlocks first, as that's probably log-worthy */
 		if (got_deadlock_timeout)
@@ -1624,9 +1726,9 @@ CheckDeadLockAlert(void)
  * wait again if not.
  */
 void
-ProcWaitForSignal(void)
+ProcWaitForSignal(uint32 wait_event_info)
 {
-	WaitLatch(MyLatch, WL_LATCH_SET, 0);
+	WaitLatch(MyLatch, WL_LATCH_SET, 0, wait_event_info);
 	ResetLatch(MyLatch);
 	CHECK_FOR_INTERRUPTS();
 }
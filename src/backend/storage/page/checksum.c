@@ -13,11 +13,109 @@
  */
 #include "postgres.h"
 
+#ifdef HAVE__GET_CPUID
+#include <cpuid.h>
+#endif
+
 #include "storage/checksum.h"
 
+/*
+ * The checksum algorithm is written so that the compiler can vectorize it,
+ * but unless we were compiled for a particular processor that means SSE2 at
+ * most, four of the 32 partial checksums at a time.  On x86-64, we also
+ * compile it for AVX2 and AVX-512, which do 8 and 16 at a time, and choose
+ * the widest the processor we're running on supports, the first time a page
+ * is checksummed.  This works like the choice of CRC-32C implementation, see
+ * src/port/pg_crc32c_choose.c.
+ */
+#if defined(__x86_64__) && defined(HAVE__GET_CPUID) && \
+	(defined(__clang__) || __GNUC__ >= 5)
+#define USE_AVX_CHECKSUM_WITH_RUNTIME_CHECK
+#endif
+
+#ifdef USE_AVX_CHECKSUM_WITH_RUNTIME_CHECK
+static uint32 pg_checksum_block_choose(char *data, uint32 size);
+
+static uint32 (*pg_checksum_block_impl) (char *data, uint32 size) = pg_checksum_block_choose;
+
+#define PG_CHECKSUM_BLOCK_ATTRIBUTES inline __attribute__((always_inline))
+#define PG_CHECKSUM_BLOCK(data, size) pg_checksum_block_impl(data, size)
+#endif
+
 /*
  * The actual code is in storage/checksum_impl.h.  This is done so that
  * external programs can incorporate the checksum code by #include'ing
  * that file from the exported Postgres headers.  (Compare our CRC code.)
  */
 #include "storage/checksum_impl.h"
+
+#ifdef USE_AVX_CHECKSUM_WITH_RUNTIME_CHECK
+
+static uint32
+pg_checksum_block_default(char *data, uint32 size)
+{
+	return pg_checksum_block(data, size);
+}
+
+static __attribute__((target("avx2"))) uint32
+pg_checksum_block_avx2(char *data, uint32 size)
+{
+	return pg_checksum_block(data, size);
+}
+
+static __attribute__((target("avx512f"))) uint32
+pg_checksum_block_avx512(char *data, uint32 size)
+{
+	return pg_checksum_block(data, size);
+}
+
+/*
+ * Does the operating system save and restore the given register state
+ * (XCR0 bits) on context switches?  The processor supporting AVX isn't
+ * enough, if it doesn't.
+ */
+static bool
+pg_os_saves_xstate(uint64 mask)
+{
+	unsigned int exx[4] = {0, 0, 0, 0};
+	uint32		xcr0_lo,
+				xcr0_hi;
+
+	__get_cpuid(1, &exx[0], &exx[1], &exx[2], &exx[3]);
+	if ((exx[2] & (1 << 27)) == 0)	/* OSXSAVE */
+		return false;
+
+	__asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+
+	return ((((uint64) xcr0_hi << 32) | xcr0_lo) & mask) == mask;
+}
+
+/*
+ * This gets called on the first call. It replaces the function pointer
+ * so that subsequent calls are routed directly to the chosen implementation.
+ */
+static uint32
+pg_checksum_block_choose(char *data, uint32 size)
+{
+	unsigned int exx[4] = {0, 0, 0, 0};
+
+	pg_checksum_block_impl = pg_checksum_block_default;
+
+	if (__get_cpuid_max(0, NULL) >= 7)
+	{
+		__cpuid_count(7, 0, exx[0], exx[1], exx[2], exx[3]);
+
+		/* SSE and AVX state, plus the opmask and upper ZMM registers */
+		if ((exx[1] & (1 << 16)) != 0 &&	/* AVX512F */
+			pg_os_saves_xstate(0xE6))
+			pg_checksum_block_impl = pg_checksum_block_avx512;
+		/* SSE and AVX state */
+		else if ((exx[1] & (1 << 5)) != 0 &&	/* AVX2 */
+				 pg_os_saves_xstate(0x06))
+			pg_checksum_block_impl = pg_checksum_block_avx2;
+	}
+
+	return pg_checksum_block_impl(data, size);
+}
+
+#endif   /* USE_AVX_CHECKSUM_WITH_RUNTIME_CHECK */
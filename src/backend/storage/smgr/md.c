@@ -24,14 +24,17 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 
 #include "miscadmin.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
+#include "pgstat.h"
 #include "portability/instr_time.h"
 #include "postmaster/bgwriter.h"
 #include "storage/fd.h"
 #include "storage/bufmgr.h"
+#include "storage/pagecompress.h"
 #include "storage/relfilenode.h"
 #include "storage/smgr.h"
 #include "utils/hsearch.h"
@@ -46,9 +49,10 @@
 /*
  * Special values for the segno arg to RememberFsyncRequest.
  *
- * Note that CompactCheckpointerRequestQueue assumes that it's OK to remove an
- * fsync request from the queue if an identical, subsequent request is found.
- * See comments there before making changes here.
+ * These must be beyond any real segment number: ForwardFsyncRequest merges
+ * a request with an identical one already queued only if there's no request
+ * with one of these values between them.  See comments there before making
+ * changes here.
  */
 #define FORGET_RELATION_FSYNC	(InvalidBlockNumber)
 #define FORGET_DATABASE_FSYNC	(InvalidBlockNumber-1)
@@ -67,6 +71,9 @@
 #define FILE_POSSIBLY_DELETED(err)	((err) == ENOENT || (err) == EACCES)
 #endif
 
+/* GUC variable */
+int			checkpoint_sync_method = CHECKPOINT_SYNC_FSYNC;
+
 /*
  *	The magnetic disk storage manager keeps track of open file
  *	descriptors in its own descriptor pool.  This is done to make it
@@ -92,31 +99,63 @@
  *	out to an unlinked old copy of a segment file that will eventually
  *	disappear.
  *
- *	The file descriptor pointer (md_fd field) stored in the SMgrRelation
- *	cache is, therefore, just the head of a list of MdfdVec objects, one
- *	per segment.  But note the md_fd pointer can be NULL, indicating
- *	relation not open.
+ *	The file descriptor pointer (md_seg_fds field) stored in the SMgrRelation
+ *	cache is, therefore, an array of MdfdVec objects, one per segment and
+ *	indexed by segment number, so that finding the segment holding a block
+ *	takes constant time however large the relation is.  The number of
+ *	entries in it is md_num_open_segs; zero means the relation is not open.
+ *	Segments are always opened in order, so the array is never sparse.
+ *
+ *	Also note that the last entry in the array is not necessarily the last
+ *	segment of the relation; we may just not have opened the next segment
+ *	yet.  (We could not have "all segments are in the array" as an invariant
+ *	anyway, since another backend could extend the relation when we weren't
+ *	looking.)  We do not make array entries for inactive segments, however;
+ *	as soon as we find a partial segment, we assume that any subsequent
+ *	segments are inactive.  All the segments before the last entry are known
+ *	to be exactly RELSEG_SIZE blocks long, which saves us from checking
+ *	their lengths again.
  *
- *	Also note that mdfd_chain == NULL does not necessarily mean the relation
- *	doesn't have another segment after this one; we may just not have
- *	opened the next segment yet.  (We could not have "all segments are
- *	in the chain" as an invariant anyway, since another backend could
- *	extend the relation when we weren't looking.)  We do not make chain
- *	entries for inactive segments, however; as soon as we find a partial
- *	segment, we assume that any subsequent segments are inactive.
+ *	The array is palloc'd in the MdCxt memory context.  Pointers into it must
+ *	not be kept across operations that might open or close segments, since
+ *	the array may be reallocated then.
  *
- *	All MdfdVec objects are palloc'd in the MdCxt memory context.
+ *	The main fork of a relation may be stored compressed instead, see
+ *	storage/pagecompress.h; md_compressed says whether the open fork is.
+ *	The segments of a compressed fork follow the same rules, except that
+ *	a segment's size is kept in its header rather than being its file size,
+ *	and pagecompress.c does the reads and writes.
  */
 
 typedef struct _MdfdVec
 {
 	File		mdfd_vfd;		/* fd number in fd.c's pool */
 	BlockNumber mdfd_segno;		/* segment number, from 0 */
-	struct _MdfdVec *mdfd_chain;	/* next segment, or NULL */
 } MdfdVec;
 
 static MemoryContext MdCxt;		/* context for all MdfdVec objects */
 
+/* flags for opening relation segment files */
+#define MD_OPEN_FLAGS	(O_RDWR | PG_BINARY | (direct_io ? PG_O_DIRECT : 0))
+
+/*
+ * Compressed segments are read and written in pieces that aren't aligned,
+ * so they are never opened with O_DIRECT.
+ */
+#define MD_COMPRESSED_OPEN_FLAGS	(O_RDWR | PG_BINARY)
+
+/* mdstartread's handle for reads of compressed blocks, done by mdwaitread */
+#define MD_DEFERRED_READ	(-1)
+
+/*
+ * With direct_io, the kernel transfers pages straight between the file and
+ * the caller's memory, which must then be aligned to PG_IO_ALIGN_SIZE.
+ * Shared and local buffers are, but some callers write pages they built in
+ * palloc'd memory (index builds, ALTER TABLE SET TABLESPACE and the like).
+ * Those pages are copied through this buffer.
+ */
+static char *MdBounceBuffer = NULL;
+
 
 /*
  * In some contexts (currently, standalone backends and the checkpointer)
@@ -173,12 +212,18 @@ typedef enum					/* behavior for mdopen & _mdfd_getseg */
 /* local routines */
 static void mdunlinkfork(RelFileNodeBackend rnode, ForkNumber forkNum,
 			 bool isRedo);
+static void mdreadcheck(MdfdVec *v, BlockNumber blocknum, char *buffer,
+			int nbytes);
 static MdfdVec *mdopen(SMgrRelation reln, ForkNumber forknum,
 	   ExtensionBehavior behavior);
 static void register_dirty_segment(SMgrRelation reln, ForkNumber forknum,
 					   MdfdVec *seg);
 static void register_unlink(RelFileNodeBackend rnode);
-static MdfdVec *_fdvec_alloc(void);
+static void mdsyncfs(void);
+static void _fdvec_resize(SMgrRelation reln,
+			   ForkNumber forknum,
+			   int nseg);
+static char *_mdfd_iobuffer(char *buffer);
 static char *_mdfd_segpath(SMgrRelation reln, ForkNumber forknum,
 			  BlockNumber segno);
 static MdfdVec *_mdfd_openseg(SMgrRelation reln, ForkNumber forkno,
@@ -187,6 +232,10 @@ static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 			 BlockNumber blkno, bool skipFsync, ExtensionBehavior behavior);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 		   MdfdVec *seg);
+static File _mdfd_checkcompressed(SMgrRelation reln, ForkNumber forknum,
+					  File fd, char *path);
+static LWLock *_mdfd_compresslock(SMgrRelation reln, ForkNumber forknum,
+				   MdfdVec *seg);
 
 
 /*
@@ -287,17 +336,18 @@ mdexists(SMgrRelation reln, ForkNumber forkNum)
 void
 mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 {
+	MdfdVec    *mdfd;
 	char	   *path;
 	File		fd;
 
-	if (isRedo && reln->md_fd[forkNum] != NULL)
+	if (isRedo && reln->md_num_open_segs[forkNum] > 0)
 		return;					/* created and opened already... */
 
-	Assert(reln->md_fd[forkNum] == NULL);
+	Assert(reln->md_num_open_segs[forkNum] == 0);
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL, 0600);
 
 	if (fd < 0)
 	{
@@ -310,7 +360,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 		 * already, even if isRedo is not set.  (See also mdopen)
 		 */
 		if (isRedo || IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS, 0600);
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -321,13 +371,66 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 		}
 	}
 
+	/* the file may exist already, and be compressed */
+	fd = _mdfd_checkcompressed(reln, forkNum, fd, path);
+
 	pfree(path);
 
-	reln->md_fd[forkNum] = _fdvec_alloc();
+	_fdvec_resize(reln, forkNum, 1);
+	mdfd = &reln->md_seg_fds[forkNum][0];
+	mdfd->mdfd_vfd = fd;
+	mdfd->mdfd_segno = 0;
+}
+
+/*
+ *	mdcompress() -- Make a newly created, empty fork a compressed one.
+ *
+ * If isRedo is true, it's okay for the fork to be compressed already, and
+ * it's left alone if it isn't empty: WAL replay will remove it later.
+ */
+void
+mdcompress(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
+{
+	MdfdVec    *mdfd = mdopen(reln, forkNum, EXTENSION_FAIL);
+	char	   *path;
+
+	if (reln->md_compressed[forkNum])
+	{
+		if (isRedo)
+			return;
+		elog(ERROR, "file \"%s\" is compressed already",
+			 FilePathName(mdfd->mdfd_vfd));
+	}
+
+	if (reln->md_num_open_segs[forkNum] > 1 || _mdnblocks(reln, forkNum, mdfd) > 0)
+	{
+		if (isRedo)
+			return;
+		elog(ERROR, "cannot compress file \"%s\", it isn't empty",
+			 FilePathName(mdfd->mdfd_vfd));
+	}
 
-	reln->md_fd[forkNum]->mdfd_vfd = fd;
-	reln->md_fd[forkNum]->mdfd_segno = 0;
-	reln->md_fd[forkNum]->mdfd_chain = NULL;
+	if (direct_io)
+	{
+		path = relpath(reln->smgr_rnode, forkNum);
+		FileClose(mdfd->mdfd_vfd);
+		mdfd->mdfd_vfd = PathNameOpenFile(path, MD_COMPRESSED_OPEN_FLAGS, 0600);
+		if (mdfd->mdfd_vfd < 0)
+		{
+			/* don't leave a closed file in the array */
+			_fdvec_resize(reln, forkNum, 0);
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", path)));
+		}
+		pfree(path);
+	}
+
+	PageCompressInit(mdfd->mdfd_vfd);
+	reln->md_compressed[forkNum] = true;
+
+	if (!SmgrIsTemp(reln))
+		register_dirty_segment(reln, forkNum, mdfd);
 }
 
 /*
@@ -390,6 +493,13 @@ mdunlink(RelFileNodeBackend rnode, ForkNumber forkNum, bool isRedo)
 	if (!RelFileNodeBackendIsTemp(rnode))
 		ForgetRelationFsyncRequests(rnode.node, forkNum);
 
+	/*
+	 * The I/O latency entry covers all forks, so it goes away with the main
+	 * fork.
+	 */
+	if (forkNum == InvalidForkNumber || forkNum == MAIN_FORKNUM)
+		pgstat_drop_io_latency(&rnode.node);
+
 	/* Now do the per-fork work */
 	if (forkNum == InvalidForkNumber)
 	{
@@ -492,6 +602,7 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuf;
 
 	/* This assert is too expensive to have on normally ... */
 #ifdef CHECK_WRITE_VS_EXTEND
@@ -512,6 +623,18 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	v = _mdfd_getseg(reln, forknum, blocknum, skipFsync, EXTENSION_CREATE);
 
+	if (reln->md_compressed[forknum])
+	{
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_EXTEND);
+		PageCompressWrite(v->mdfd_vfd, _mdfd_compresslock(reln, forknum, v),
+						  blocknum % ((BlockNumber) RELSEG_SIZE), buffer, true);
+		pgstat_report_wait_end();
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+		return;
+	}
+
 	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
@@ -531,7 +654,15 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 				 errmsg("could not seek to block %u in file \"%s\": %m",
 						blocknum, FilePathName(v->mdfd_vfd))));
 
-	if ((nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ)) != BLCKSZ)
+	iobuf = _mdfd_iobuffer(buffer);
+	if (iobuf != buffer)
+		memcpy(iobuf, buffer, BLCKSZ);
+
+	pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_EXTEND);
+	nbytes = FileWrite(v->mdfd_vfd, iobuf, BLCKSZ);
+	pgstat_report_wait_end();
+
+	if (nbytes != BLCKSZ)
 	{
 		if (nbytes < 0)
 			ereport(ERROR,
@@ -554,6 +685,76 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdzeroextend() -- Add nblocks new zero-filled blocks to the specified
+ *		relation, starting at blocknum.
+ *
+ *		This is like calling mdextend with a page of zeroes for each block,
+ *		but takes only a system call or so per segment.
+ */
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 int nblocks, bool skipFsync)
+{
+	BlockNumber curblocknum = blocknum;
+	int			remblocks = nblocks;
+
+	Assert(nblocks > 0);
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/* see mdextend */
+	if ((uint64) blocknum + nblocks >= (uint64) InvalidBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	while (remblocks > 0)
+	{
+		BlockNumber segstartblock = curblocknum % ((BlockNumber) RELSEG_SIZE);
+		off_t		seekpos = (off_t) BLCKSZ * segstartblock;
+		int			numblocks;
+		MdfdVec    *v;
+
+		/* don't cross a segment boundary */
+		if (segstartblock + remblocks > RELSEG_SIZE)
+			numblocks = RELSEG_SIZE - segstartblock;
+		else
+			numblocks = remblocks;
+
+		v = _mdfd_getseg(reln, forknum, curblocknum, skipFsync,
+						 EXTENSION_CREATE);
+
+		Assert(seekpos + (off_t) BLCKSZ * numblocks <=
+			   (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (reln->md_compressed[forknum])
+			PageCompressExtend(v->mdfd_vfd,
+							   _mdfd_compresslock(reln, forknum, v),
+							   segstartblock + numblocks);
+		else if (FileZero(v->mdfd_vfd, seekpos,
+						  (off_t) BLCKSZ * numblocks) != 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not extend file \"%s\": %m",
+							FilePathName(v->mdfd_vfd)),
+					 errhint("Check free disk space.")));
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		curblocknum += numblocks;
+		remblocks -= numblocks;
+	}
+}
+
 /*
  *	mdopen() -- Open the specified relation.
  *
@@ -572,12 +773,12 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 	File		fd;
 
 	/* No work if already open */
-	if (reln->md_fd[forknum])
-		return reln->md_fd[forknum];
+	if (reln->md_num_open_segs[forknum] > 0)
+		return &reln->md_seg_fds[forknum][0];
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS, 0600);
 
 	if (fd < 0)
 	{
@@ -588,7 +789,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 		 * substitute for mdcreate() in bootstrap mode only. (See mdcreate)
 		 */
 		if (IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL, 0600);
 		if (fd < 0)
 		{
 			if (behavior == EXTENSION_RETURN_NULL &&
@@ -603,13 +804,15 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 		}
 	}
 
-	pfree(path);
+	fd = _mdfd_checkcompressed(reln, forknum, fd, path);
 
-	reln->md_fd[forknum] = mdfd = _fdvec_alloc();
+	pfree(path);
 
+	_fdvec_resize(reln, forknum, 1);
+	mdfd = &reln->md_seg_fds[forknum][0];
 	mdfd->mdfd_vfd = fd;
 	mdfd->mdfd_segno = 0;
-	mdfd->mdfd_chain = NULL;
+
 	Assert(_mdnblocks(reln, forknum, mdfd) <= ((BlockNumber) RELSEG_SIZE));
 
 	return mdfd;
@@ -621,25 +824,29 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 void
 mdclose(SMgrRelation reln, ForkNumber forknum)
 {
-	MdfdVec    *v = reln->md_fd[forknum];
+	int			nopensegs = reln->md_num_open_segs[forknum];
 
 	/* No work if already closed */
-	if (v == NULL)
+	if (nopensegs == 0)
 		return;
 
-	reln->md_fd[forknum] = NULL;	/* prevent dangling pointer after error */
-
-	while (v != NULL)
+	/* close segments starting from the end */
+	while (nopensegs > 0)
 	{
-		MdfdVec    *ov = v;
+		MdfdVec    *v = &reln->md_seg_fds[forknum][nopensegs - 1];
 
 		/* if not closed already */
 		if (v->mdfd_vfd >= 0)
+		{
 			FileClose(v->mdfd_vfd);
-		/* Now free vector */
-		v = v->mdfd_chain;
-		pfree(ov);
+			v->mdfd_vfd = -1;
+		}
+
+		nopensegs--;
 	}
+
+	/* resize just once, avoids pointless reallocations */
+	_fdvec_resize(reln, forknum, 0);
 }
 
 /*
@@ -652,8 +859,19 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 	off_t		seekpos;
 	MdfdVec    *v;
 
+	/* With direct_io, the page cache is bypassed, so don't fill it */
+	if (direct_io)
+		return;
+
 	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
 
+	if (reln->md_compressed[forknum])
+	{
+		PageCompressPrefetch(v->mdfd_vfd,
+							 blocknum % ((BlockNumber) RELSEG_SIZE));
+		return;
+	}
+
 	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
@@ -663,6 +881,65 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 }
 
 
+/*
+ *	mdwriteback() -- Tell the kernel to write out a range of blocks of a
+ *				relation.
+ *
+ * This accepts a range of blocks because flushing several pages at once is
+ * considerably more efficient than doing so individually.
+ */
+void
+mdwriteback(SMgrRelation reln, ForkNumber forknum,
+			BlockNumber blocknum, BlockNumber nblocks)
+{
+	/* With direct_io, writes don't linger in the kernel's cache anyway */
+	if (direct_io)
+		return;
+
+	/*
+	 * Issue flush requests in as few requests as possible; have to split at
+	 * segment boundaries though, since those are actually separate files.
+	 */
+	while (nblocks > 0)
+	{
+		BlockNumber nflush = nblocks;
+		off_t		seekpos;
+		MdfdVec    *v;
+		BlockNumber segnum_start,
+					segnum_end;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, true,
+						 EXTENSION_RETURN_NULL);
+
+		/*
+		 * The relation might have been dropped or truncated since the blocks
+		 * were written; that's fine, there's nothing to write back then.
+		 */
+		if (!v)
+			return;
+
+		/* a compressed segment's blocks aren't in order, so don't bother */
+		if (reln->md_compressed[forknum])
+			return;
+
+		/* don't go past the end of the segment */
+		segnum_start = blocknum / ((BlockNumber) RELSEG_SIZE);
+		segnum_end = (blocknum + nblocks - 1) / ((BlockNumber) RELSEG_SIZE);
+		if (segnum_start != segnum_end)
+			nflush = RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(nflush >= 1);
+		Assert(nflush <= nblocks);
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		FileWriteback(v->mdfd_vfd, seekpos, (off_t) BLCKSZ * nflush);
+
+		nblocks -= nflush;
+		blocknum += nflush;
+	}
+}
+
 /*
  *	mdread() -- Read the specified block from a relation.
  */
@@ -673,6 +950,8 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuf;
+	instr_time	io_start;
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -682,17 +961,42 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
 
-	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
 
-	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+	if (reln->md_compressed[forknum])
+	{
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+		nbytes = PageCompressRead(v->mdfd_vfd,
+								  blocknum % ((BlockNumber) RELSEG_SIZE),
+								  buffer);
+		pgstat_report_wait_end();
+	}
+	else
+	{
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
 
-	if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not seek to block %u in file \"%s\": %m",
-						blocknum, FilePathName(v->mdfd_vfd))));
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							blocknum, FilePathName(v->mdfd_vfd))));
+
+		iobuf = _mdfd_iobuffer(buffer);
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ);
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+		nbytes = FileRead(v->mdfd_vfd, iobuf, BLCKSZ);
+		pgstat_report_wait_end();
+
+		if (iobuf != buffer && nbytes > 0)
+			memcpy(buffer, iobuf, nbytes);
+	}
+
+	if (track_io_timing)
+		pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_READ,
+								io_start);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.node.spcNode,
@@ -702,6 +1006,91 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 									   nbytes,
 									   BLCKSZ);
 
+	mdreadcheck(v, blocknum, buffer, nbytes);
+}
+
+/*
+ *	mdreadv() -- Read the specified consecutive blocks from a relation.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, int nblocks)
+{
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		int			nbytes;
+		int			nread = nblocks;
+		int			i;
+		MdfdVec    *v;
+		instr_time	io_start;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+
+		/* compressed blocks can only be read one at a time */
+		if (reln->md_compressed[forknum])
+		{
+			mdread(reln, forknum, blocknum, buffers[0]);
+			buffers++;
+			blocknum++;
+			nblocks--;
+			continue;
+		}
+
+		/* don't go past the end of the segment */
+		if (blocknum / ((BlockNumber) RELSEG_SIZE) !=
+			(blocknum + nblocks - 1) / ((BlockNumber) RELSEG_SIZE))
+			nread = RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							blocknum, FilePathName(v->mdfd_vfd))));
+
+		/* these are shared buffers, so aligned for direct_io */
+		for (i = 0; i < nread; i++)
+			Assert(_mdfd_iobuffer(buffers[i]) == buffers[i]);
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+		nbytes = FileReadV(v->mdfd_vfd, buffers, nread, BLCKSZ);
+		pgstat_report_wait_end();
+
+		if (track_io_timing)
+			pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_READ,
+									io_start);
+
+		/* check each block as if it had been read by itself */
+		for (i = 0; i < nread; i++)
+		{
+			int			blockbytes = nbytes;
+
+			if (nbytes >= 0)
+				blockbytes = Min(Max(nbytes - i * BLCKSZ, 0), BLCKSZ);
+			mdreadcheck(v, blocknum + i, buffers[i], blockbytes);
+		}
+
+		buffers += nread;
+		blocknum += nread;
+		nblocks -= nread;
+	}
+}
+
+/*
+ *	mdreadcheck() -- complain about an unsuccessful read of a block.
+ *
+ *		nbytes is what FileRead (or FileWaitRead) returned for it.
+ */
+static void
+mdreadcheck(MdfdVec *v, BlockNumber blocknum, char *buffer, int nbytes)
+{
 	if (nbytes != BLCKSZ)
 	{
 		if (nbytes < 0)
@@ -729,6 +1118,81 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ *	mdstartread() -- Start reading the specified block from a relation.
+ */
+int
+mdstartread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			char *buffer)
+{
+	off_t		seekpos;
+	MdfdVec    *v;
+
+	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+
+	/* compressed blocks are read synchronously, when waited for */
+	if (reln->md_compressed[forknum])
+		return MD_DEFERRED_READ;
+
+	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
+										reln->smgr_rnode.node.spcNode,
+										reln->smgr_rnode.node.dbNode,
+										reln->smgr_rnode.node.relNode,
+										reln->smgr_rnode.backend);
+
+	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+	/* only shared buffers are read this way, and they're aligned */
+	Assert(_mdfd_iobuffer(buffer) == buffer);
+
+	return FileStartRead(v->mdfd_vfd, buffer, BLCKSZ, seekpos);
+}
+
+/*
+ *	mdwaitread() -- Wait for a read started by mdstartread to finish.
+ */
+void
+mdwaitread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   char *buffer, int handle)
+{
+	int			nbytes;
+	instr_time	io_start;
+
+	if (handle == MD_DEFERRED_READ)
+	{
+		mdread(reln, forknum, blocknum, buffer);
+		return;
+	}
+
+	/* only the time spent waiting is counted as the read's latency */
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+
+	pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_READ);
+	nbytes = FileWaitRead(handle);
+	pgstat_report_wait_end();
+
+	if (track_io_timing)
+		pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_READ,
+								io_start);
+
+	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
+									   reln->smgr_rnode.node.spcNode,
+									   reln->smgr_rnode.node.dbNode,
+									   reln->smgr_rnode.node.relNode,
+									   reln->smgr_rnode.backend,
+									   nbytes,
+									   BLCKSZ);
+
+	/* the segment was open when we started, so it's there for messages */
+	if (nbytes != BLCKSZ)
+		mdreadcheck(_mdfd_getseg(reln, forknum, blocknum, false,
+								 EXTENSION_FAIL),
+					blocknum, buffer, nbytes);
+}
+
 /*
  *	mdwrite() -- Write the supplied block at the appropriate location.
  *
@@ -743,6 +1207,8 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *iobuf;
+	instr_time	io_start;
 
 	/* This assert is too expensive to have on normally ... */
 #ifdef CHECK_WRITE_VS_EXTEND
@@ -757,17 +1223,43 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	v = _mdfd_getseg(reln, forknum, blocknum, skipFsync, EXTENSION_FAIL);
 
-	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
 
-	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+	if (reln->md_compressed[forknum])
+	{
+		/* this reports its own errors */
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+		PageCompressWrite(v->mdfd_vfd, _mdfd_compresslock(reln, forknum, v),
+						  blocknum % ((BlockNumber) RELSEG_SIZE), buffer,
+						  false);
+		pgstat_report_wait_end();
+		nbytes = BLCKSZ;
+	}
+	else
+	{
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
 
-	if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not seek to block %u in file \"%s\": %m",
-						blocknum, FilePathName(v->mdfd_vfd))));
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+				   errmsg("could not seek to block %u in file \"%s\": %m",
+						  blocknum, FilePathName(v->mdfd_vfd))));
+
+		iobuf = _mdfd_iobuffer(buffer);
+		if (iobuf != buffer)
+			memcpy(iobuf, buffer, BLCKSZ);
+
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+		nbytes = FileWrite(v->mdfd_vfd, iobuf, BLCKSZ);
+		pgstat_report_wait_end();
+	}
 
-	nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ);
+	if (track_io_timing)
+		pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_WRITE,
+								io_start);
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -798,39 +1290,127 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		register_dirty_segment(reln, forknum, v);
 }
 
+/*
+ *	mdwritev() -- Write nblocks consecutive blocks, starting at blocknum,
+ *				  from the given buffers.
+ */
+void
+mdwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		 char **buffers, int nblocks, bool skipFsync)
+{
+	while (nblocks > 0)
+	{
+		off_t		seekpos;
+		int			nbytes;
+		int			nwrite = nblocks;
+		int			i;
+		MdfdVec    *v;
+		instr_time	io_start;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, skipFsync, EXTENSION_FAIL);
+
+		/* as in mdreadv, compressed blocks go one at a time */
+		if (reln->md_compressed[forknum])
+		{
+			mdwrite(reln, forknum, blocknum, buffers[0], skipFsync);
+			buffers++;
+			blocknum++;
+			nblocks--;
+			continue;
+		}
+
+		/* don't go past the end of the segment */
+		if (blocknum / ((BlockNumber) RELSEG_SIZE) !=
+			(blocknum + nblocks - 1) / ((BlockNumber) RELSEG_SIZE))
+			nwrite = RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							blocknum, FilePathName(v->mdfd_vfd))));
+
+		/* as for mdreadv, the buffers must be aligned for direct_io */
+		for (i = 0; i < nwrite; i++)
+			Assert(_mdfd_iobuffer(buffers[i]) == buffers[i]);
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_WRITE);
+		nbytes = FileWriteV(v->mdfd_vfd, buffers, nwrite, BLCKSZ);
+		pgstat_report_wait_end();
+
+		if (track_io_timing)
+			pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_WRITE,
+									io_start);
+
+		if (nbytes != nwrite * BLCKSZ)
+		{
+			/* report the first block that didn't get written in full */
+			BlockNumber failed = blocknum + Max(nbytes, 0) / BLCKSZ;
+
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not write block %u in file \"%s\": %m",
+								failed, FilePathName(v->mdfd_vfd))));
+			/* short write: complain appropriately */
+			ereport(ERROR,
+					(errcode(ERRCODE_DISK_FULL),
+					 errmsg("could not write block %u in file \"%s\": wrote only %d of %d bytes",
+							failed,
+							FilePathName(v->mdfd_vfd),
+							nbytes % BLCKSZ, BLCKSZ),
+					 errhint("Check free disk space.")));
+		}
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		buffers += nwrite;
+		blocknum += nwrite;
+		nblocks -= nwrite;
+	}
+}
+
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
  *		Important side effect: all active segments of the relation are opened
- *		and added to the mdfd_chain list.  If this routine has not been
+ *		and added to the md_seg_fds array.  If this routine has not been
  *		called, then only segments up to the last one actually touched
- *		are present in the chain.
+ *		are present in the array.
  */
 BlockNumber
 mdnblocks(SMgrRelation reln, ForkNumber forknum)
 {
 	MdfdVec    *v = mdopen(reln, forknum, EXTENSION_FAIL);
 	BlockNumber nblocks;
-	BlockNumber segno = 0;
+	BlockNumber segno;
+
+	/* mdopen has opened the first segment */
+	Assert(reln->md_num_open_segs[forknum] > 0);
 
 	/*
-	 * Skip through any segments that aren't the last one, to avoid redundant
-	 * seeks on them.  We have previously verified that these segments are
+	 * Start from the last open segment, to avoid redundant seeks on the
+	 * segments before it.  We have previously verified that these segments are
 	 * exactly RELSEG_SIZE long, and it's useless to recheck that each time.
 	 *
 	 * NOTE: this assumption could only be wrong if another backend has
 	 * truncated the relation.  We rely on higher code levels to handle that
 	 * scenario by closing and re-opening the md fd, which is handled via
 	 * relcache flush.  (Since the checkpointer doesn't participate in
-	 * relcache flush, it could have segment chain entries for inactive
+	 * relcache flush, it could have segment array entries for inactive
 	 * segments; that's OK because the checkpointer never needs to compute
 	 * relation size.)
 	 */
-	while (v->mdfd_chain != NULL)
-	{
-		segno++;
-		v = v->mdfd_chain;
-	}
+	segno = reln->md_num_open_segs[forknum] - 1;
+	v = &reln->md_seg_fds[forknum][segno];
 
 	for (;;)
 	{
@@ -845,23 +1425,17 @@ mdnblocks(SMgrRelation reln, ForkNumber forknum)
 		 */
 		segno++;
 
-		if (v->mdfd_chain == NULL)
-		{
-			/*
-			 * Because we pass O_CREAT, we will create the next segment (with
-			 * zero length) immediately, if the last segment is of length
-			 * RELSEG_SIZE.  While perhaps not strictly necessary, this keeps
-			 * the logic simple.
-			 */
-			v->mdfd_chain = _mdfd_openseg(reln, forknum, segno, O_CREAT);
-			if (v->mdfd_chain == NULL)
-				ereport(ERROR,
-						(errcode_for_file_access(),
-						 errmsg("could not open file \"%s\": %m",
-								_mdfd_segpath(reln, forknum, segno))));
-		}
-
-		v = v->mdfd_chain;
+		/*
+		 * Because we pass O_CREAT, we will create the next segment (with zero
+		 * length) immediately, if the last segment is of length RELSEG_SIZE.
+		 * While perhaps not strictly necessary, this keeps the logic simple.
+		 */
+		v = _mdfd_openseg(reln, forknum, segno, O_CREAT);
+		if (v == NULL)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m",
+							_mdfd_segpath(reln, forknum, segno))));
 	}
 }
 
@@ -871,9 +1445,9 @@ mdnblocks(SMgrRelation reln, ForkNumber forknum)
 void
 mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 {
-	MdfdVec    *v;
 	BlockNumber curnblk;
 	BlockNumber priorblocks;
+	int			curopensegs;
 
 	/*
 	 * NOTE: mdnblocks makes sure we have opened all active segments, so that
@@ -893,21 +1467,29 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 	if (nblocks == curnblk)
 		return;					/* no work */
 
-	v = mdopen(reln, forknum, EXTENSION_FAIL);
-
-	priorblocks = 0;
-	while (v != NULL)
+	/*
+	 * Truncate segments, starting at the last one. Starting at the end makes
+	 * managing the memory for the fd array easier, should there be errors.
+	 */
+	curopensegs = reln->md_num_open_segs[forknum];
+	while (curopensegs > 0)
 	{
-		MdfdVec    *ov = v;
+		MdfdVec    *v;
+
+		priorblocks = (BlockNumber) (curopensegs - 1) * RELSEG_SIZE;
+
+		v = &reln->md_seg_fds[forknum][curopensegs - 1];
 
 		if (priorblocks > nblocks)
 		{
 			/*
-			 * This segment is no longer active (and has already been unlinked
-			 * from the mdfd_chain). We truncate the file, but do not delete
-			 * it, for reasons explained in the header comments.
+			 * This segment is no longer active. We truncate the file, but do
+			 * not delete it, for reasons explained in the header comments.
 			 */
-			if (FileTruncate(v->mdfd_vfd, 0) < 0)
+			if (reln->md_compressed[forknum])
+				PageCompressTruncate(v->mdfd_vfd,
+									 _mdfd_compresslock(reln, forknum, v), 0);
+			else if (FileTruncate(v->mdfd_vfd, 0) < 0)
 				ereport(ERROR,
 						(errcode_for_file_access(),
 						 errmsg("could not truncate file \"%s\": %m",
@@ -915,24 +1497,30 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 
 			if (!SmgrIsTemp(reln))
 				register_dirty_segment(reln, forknum, v);
-			v = v->mdfd_chain;
-			Assert(ov != reln->md_fd[forknum]); /* we never drop the 1st
-												 * segment */
-			pfree(ov);
+
+			/* we never drop the 1st segment */
+			Assert(v != &reln->md_seg_fds[forknum][0]);
+
+			FileClose(v->mdfd_vfd);
+			_fdvec_resize(reln, forknum, curopensegs - 1);
 		}
 		else if (priorblocks + ((BlockNumber) RELSEG_SIZE) > nblocks)
 		{
 			/*
 			 * This is the last segment we want to keep. Truncate the file to
-			 * the right length, and clear chain link that points to any
-			 * remaining segments (which we shall zap). NOTE: if nblocks is
-			 * exactly a multiple K of RELSEG_SIZE, we will truncate the K+1st
-			 * segment to 0 length but keep it. This adheres to the invariant
-			 * given in the header comments.
+			 * the right length. NOTE: if nblocks is exactly a multiple K of
+			 * RELSEG_SIZE, we will truncate the K+1st segment to 0 length but
+			 * keep it. This adheres to the invariant given in the header
+			 * comments.
 			 */
 			BlockNumber lastsegblocks = nblocks - priorblocks;
 
-			if (FileTruncate(v->mdfd_vfd, (off_t) lastsegblocks * BLCKSZ) < 0)
+			if (reln->md_compressed[forknum])
+				PageCompressTruncate(v->mdfd_vfd,
+									 _mdfd_compresslock(reln, forknum, v),
+									 lastsegblocks);
+			else if (FileTruncate(v->mdfd_vfd,
+								  (off_t) lastsegblocks * BLCKSZ) < 0)
 				ereport(ERROR,
 						(errcode_for_file_access(),
 					errmsg("could not truncate file \"%s\" to %u blocks: %m",
@@ -940,18 +1528,16 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 						   nblocks)));
 			if (!SmgrIsTemp(reln))
 				register_dirty_segment(reln, forknum, v);
-			v = v->mdfd_chain;
-			ov->mdfd_chain = NULL;
 		}
 		else
 		{
 			/*
-			 * We still need this segment and 0 or more blocks beyond it, so
-			 * nothing to do here.
+			 * We still need this segment, so nothing to do for this and any
+			 * earlier segment.
 			 */
-			v = v->mdfd_chain;
+			break;
 		}
-		priorblocks += RELSEG_SIZE;
+		curopensegs--;
 	}
 }
 
@@ -964,7 +1550,7 @@ mdtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 void
 mdimmedsync(SMgrRelation reln, ForkNumber forknum)
 {
-	MdfdVec    *v;
+	int			segno;
 
 	/*
 	 * NOTE: mdnblocks makes sure we have opened all active segments, so that
@@ -972,16 +1558,30 @@ mdimmedsync(SMgrRelation reln, ForkNumber forknum)
 	 */
 	mdnblocks(reln, forknum);
 
-	v = mdopen(reln, forknum, EXTENSION_FAIL);
+	segno = reln->md_num_open_segs[forknum];
 
-	while (v != NULL)
+	while (segno > 0)
 	{
-		if (FileSync(v->mdfd_vfd) < 0)
+		MdfdVec    *v = &reln->md_seg_fds[forknum][segno - 1];
+		int			rc;
+		instr_time	io_start;
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_SYNC);
+		rc = FileSync(v->mdfd_vfd);
+		pgstat_report_wait_end();
+
+		if (track_io_timing)
+			pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_SYNC,
+									io_start);
+		if (rc < 0)
 			ereport(ERROR,
 					(errcode_for_file_access(),
 					 errmsg("could not fsync file \"%s\": %m",
 							FilePathName(v->mdfd_vfd))));
-		v = v->mdfd_chain;
+		segno--;
 	}
 }
 
@@ -1064,6 +1664,35 @@ mdsync(void)
 	/* Set flag to detect failure if we don't reach the end of the loop */
 	mdsync_in_progress = true;
 
+	/*
+	 * With checkpoint_sync_method = syncfs, sync whole file systems instead
+	 * of the files, and then forget the requests.  We mustn't absorb any
+	 * requests meanwhile, as they might be for writes after the sync.
+	 */
+	if (checkpoint_sync_method == CHECKPOINT_SYNC_SYNCFS && enableFsync)
+	{
+		mdsyncfs();
+
+		hash_seq_init(&hstat, pendingOpsTable);
+		while ((entry = (PendingOperationEntry *) hash_seq_search(&hstat)) != NULL)
+		{
+			ForkNumber	forknum;
+
+			for (forknum = 0; forknum <= MAX_FORKNUM; forknum = forknum + 1)
+			{
+				bms_free(entry->requests[forknum]);
+				entry->requests[forknum] = NULL;
+				entry->canceled[forknum] = false;
+			}
+			if (hash_search(pendingOpsTable, &entry->rnode,
+							HASH_REMOVE, NULL) == NULL)
+				elog(ERROR, "pendingOpsTable corrupted");
+		}
+
+		mdsync_in_progress = false;
+		return;
+	}
+
 	/* Now scan the hashtable for fsync requests to process */
 	absorb_counter = FSYNCS_PER_ABSORB;
 	hash_seq_init(&hstat, pendingOpsTable);
@@ -1168,9 +1797,12 @@ mdsync(void)
 
 					INSTR_TIME_SET_CURRENT(sync_start);
 
+					pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_SYNC);
 					if (seg != NULL &&
 						FileSync(seg->mdfd_vfd) >= 0)
 					{
+						pgstat_report_wait_end();
+
 						/* Success; update statistics about sync timing */
 						INSTR_TIME_SET_CURRENT(sync_end);
 						sync_diff = sync_end;
@@ -1185,9 +1817,14 @@ mdsync(void)
 								 processed,
 								 FilePathName(seg->mdfd_vfd),
 								 (double) elapsed / 1000);
+						if (track_io_timing)
+							pgstat_count_io_latency(&entry->rnode,
+													PGSTAT_IO_SYNC,
+													sync_start);
 
 						break;	/* out of retry loop */
 					}
+					pgstat_report_wait_end();
 
 					/* Compute file name for use in message */
 					save_errno = errno;
@@ -1264,6 +1901,123 @@ mdsync(void)
 	mdsync_in_progress = false;
 }
 
+/*
+ * mdsyncfs() -- Sync the file systems of all the files to be fsync'd
+ *
+ * With many files, one syncfs() per file system is a lot faster than an
+ * fsync() per file; the price is that it also syncs whatever else has been
+ * written to the file systems.  The file systems are found through the
+ * directories of the databases the files are in; those that are on the same
+ * device are synced just once.  We report the number of file systems synced
+ * as the number of files.
+ */
+static void
+mdsyncfs(void)
+{
+#ifdef __linux__
+	HASH_SEQ_STATUS hstat;
+	PendingOperationEntry *entry;
+	List	   *dirs = NIL;
+	dev_t	   *devices;
+	int			ndevices = 0;
+	ListCell   *lc;
+	int			processed = 0;
+	uint64		longest = 0;
+	uint64		total_elapsed = 0;
+
+	/* Collect the database directories, once each */
+	hash_seq_init(&hstat, pendingOpsTable);
+	while ((entry = (PendingOperationEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		char	   *path = GetDatabasePath(entry->rnode.dbNode,
+										   entry->rnode.spcNode);
+
+		foreach(lc, dirs)
+		{
+			if (strcmp((char *) lfirst(lc), path) == 0)
+				break;
+		}
+		if (lc == NULL)
+			dirs = lappend(dirs, path);
+		else
+			pfree(path);
+	}
+
+	devices = (dev_t *) palloc(Max(list_length(dirs), 1) * sizeof(dev_t));
+
+	foreach(lc, dirs)
+	{
+		char	   *path = (char *) lfirst(lc);
+		struct stat st;
+		instr_time	sync_start,
+					sync_end;
+		uint64		elapsed;
+		int			fd;
+		int			i;
+		int			rc;
+
+		fd = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
+		if (fd < 0)
+		{
+			/* the database or tablespace may have been dropped */
+			if (FILE_POSSIBLY_DELETED(errno))
+				continue;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", path)));
+		}
+		if (fstat(fd, &st) < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not stat file \"%s\": %m", path)));
+
+		for (i = 0; i < ndevices; i++)
+		{
+			if (devices[i] == st.st_dev)
+				break;
+		}
+		if (i < ndevices)
+		{
+			CloseTransientFile(fd);
+			continue;
+		}
+		devices[ndevices++] = st.st_dev;
+
+		INSTR_TIME_SET_CURRENT(sync_start);
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_SYNC);
+		rc = syncfs(fd);
+		pgstat_report_wait_end();
+		if (rc < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not synchronize file system for file \"%s\": %m",
+							path)));
+		CloseTransientFile(fd);
+
+		INSTR_TIME_SET_CURRENT(sync_end);
+		INSTR_TIME_SUBTRACT(sync_end, sync_start);
+		elapsed = INSTR_TIME_GET_MICROSEC(sync_end);
+		if (elapsed > longest)
+			longest = elapsed;
+		total_elapsed += elapsed;
+		processed++;
+		if (log_checkpoints)
+			elog(DEBUG1, "checkpoint sync: number=%d file system of=%s time=%.3f msec",
+				 processed, path, (double) elapsed / 1000);
+	}
+
+	pfree(devices);
+	list_free_deep(dirs);
+
+	CheckpointStats.ckpt_sync_rels = processed;
+	CheckpointStats.ckpt_longest_sync = longest;
+	CheckpointStats.ckpt_agg_sync_time = total_elapsed;
+#else
+	/* the GUC check hook doesn't allow syncfs elsewhere */
+	elog(ERROR, "syncfs is not supported on this platform");
+#endif
+}
+
 /*
  * mdpreckpt() -- Do pre-checkpoint work
  *
@@ -1374,13 +2128,26 @@ register_dirty_segment(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
 	}
 	else
 	{
+		int			rc;
+		instr_time	io_start;
+
 		if (ForwardFsyncRequest(reln->smgr_rnode.node, forknum, seg->mdfd_segno))
 			return;				/* passed it off successfully */
 
 		ereport(DEBUG1,
 				(errmsg("could not forward fsync request because request queue is full")));
 
-		if (FileSync(seg->mdfd_vfd) < 0)
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+
+		pgstat_report_wait_start(WAIT_EVENT_DATA_FILE_SYNC);
+		rc = FileSync(seg->mdfd_vfd);
+		pgstat_report_wait_end();
+
+		if (track_io_timing)
+			pgstat_count_io_latency(&reln->smgr_rnode.node, PGSTAT_IO_SYNC,
+									io_start);
+		if (rc < 0)
 			ereport(ERROR,
 					(errcode_for_file_access(),
 					 errmsg("could not fsync file \"%s\": %m",
@@ -1642,12 +2409,60 @@ ForgetDatabaseFsyncRequests(Oid dbid)
 
 
 /*
- *	_fdvec_alloc() -- Make a MdfdVec object.
+ *	_fdvec_resize() -- Resize the fork's open segments array
  */
-static MdfdVec *
-_fdvec_alloc(void)
+static void
+_fdvec_resize(SMgrRelation reln,
+			  ForkNumber forknum,
+			  int nseg)
 {
-	return (MdfdVec *) MemoryContextAlloc(MdCxt, sizeof(MdfdVec));
+	if (nseg == 0)
+	{
+		if (reln->md_num_open_segs[forknum] > 0)
+		{
+			pfree(reln->md_seg_fds[forknum]);
+			reln->md_seg_fds[forknum] = NULL;
+		}
+	}
+	else if (reln->md_num_open_segs[forknum] == 0)
+	{
+		reln->md_seg_fds[forknum] = (MdfdVec *)
+			MemoryContextAlloc(MdCxt, sizeof(MdfdVec) * nseg);
+	}
+	else
+	{
+		/*
+		 * It doesn't seem worthwhile complicating the code by having a more
+		 * aggressive growth strategy here; the number of segments doesn't
+		 * grow that fast, and the memory context internally will sometimes
+		 * avoid doing an actual reallocation.
+		 */
+		reln->md_seg_fds[forknum] = (MdfdVec *)
+			repalloc(reln->md_seg_fds[forknum], sizeof(MdfdVec) * nseg);
+	}
+
+	reln->md_num_open_segs[forknum] = nseg;
+}
+
+/*
+ *	_mdfd_iobuffer() -- Get memory to do a read or write of one block with.
+ *
+ * This is the caller's buffer, unless direct_io requires better alignment
+ * than it has; then it's MdBounceBuffer, and the caller has to copy the
+ * block to or from it.
+ */
+static char *
+_mdfd_iobuffer(char *buffer)
+{
+	if (!direct_io || (uintptr_t) buffer % PG_IO_ALIGN_SIZE == 0)
+		return buffer;
+
+	if (MdBounceBuffer == NULL)
+		MdBounceBuffer = (char *)
+			TYPEALIGN(PG_IO_ALIGN_SIZE,
+					  MemoryContextAlloc(MdCxt, BLCKSZ + PG_IO_ALIGN_SIZE));
+
+	return MdBounceBuffer;
 }
 
 /*
@@ -1674,8 +2489,8 @@ _mdfd_segpath(SMgrRelation reln, ForkNumber forknum, BlockNumber segno)
 }
 
 /*
- * Open the specified segment of the relation,
- * and make a MdfdVec object for it.  Returns NULL on failure.
+ * Open the specified segment of the relation, and add a MdfdVec entry for
+ * it to the end of the fork's array.  Returns NULL on failure.
  */
 static MdfdVec *
 _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
@@ -1688,20 +2503,29 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags, 0600);
+	fd = PathNameOpenFile(fullpath,
+						  (reln->md_compressed[forknum] ?
+						   MD_COMPRESSED_OPEN_FLAGS : MD_OPEN_FLAGS) | oflags,
+						  0600);
 
 	pfree(fullpath);
 
 	if (fd < 0)
 		return NULL;
 
-	/* allocate an mdfdvec entry for it */
-	v = _fdvec_alloc();
+	/*
+	 * Segments are always opened in order from lowest to highest, so we must
+	 * be adding a new one at the end.
+	 */
+	Assert(segno == (BlockNumber) reln->md_num_open_segs[forknum]);
+
+	_fdvec_resize(reln, forknum, segno + 1);
 
 	/* fill the entry */
+	v = &reln->md_seg_fds[forknum][segno];
 	v->mdfd_vfd = fd;
 	v->mdfd_segno = segno;
-	v->mdfd_chain = NULL;
+
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 
 	/* all done */
@@ -1720,66 +2544,82 @@ static MdfdVec *
 _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 			 bool skipFsync, ExtensionBehavior behavior)
 {
-	MdfdVec    *v = mdopen(reln, forknum, behavior);
+	MdfdVec    *v;
 	BlockNumber targetseg;
 	BlockNumber nextsegno;
 
-	if (!v)
-		return NULL;			/* only possible if EXTENSION_RETURN_NULL */
-
 	targetseg = blkno / ((BlockNumber) RELSEG_SIZE);
-	for (nextsegno = 1; nextsegno <= targetseg; nextsegno++)
+
+	/* if an existing and opened segment, we're done */
+	if (targetseg < (BlockNumber) reln->md_num_open_segs[forknum])
+		return &reln->md_seg_fds[forknum][targetseg];
+
+	/*
+	 * The target segment is not yet open. Iterate over all the segments
+	 * between the last opened and the target segment. This way missing
+	 * segments either raise an error, or get created (according to
+	 * 'behavior'). Start with either the last opened, or the first segment if
+	 * none was opened before.
+	 */
+	if (reln->md_num_open_segs[forknum] > 0)
+		v = &reln->md_seg_fds[forknum][reln->md_num_open_segs[forknum] - 1];
+	else
 	{
+		v = mdopen(reln, forknum, behavior);
+		if (!v)
+			return NULL;		/* only possible if EXTENSION_RETURN_NULL */
+	}
+
+	for (nextsegno = reln->md_num_open_segs[forknum];
+		 nextsegno <= targetseg; nextsegno++)
+	{
+		int			flags = 0;
+
 		Assert(nextsegno == v->mdfd_segno + 1);
 
-		if (v->mdfd_chain == NULL)
+		/*
+		 * Normally we will create new segments only if authorized by the
+		 * caller (i.e., we are doing mdextend()).  But when doing WAL
+		 * recovery, create segments anyway; this allows cases such as
+		 * replaying WAL data that has a write into a high-numbered segment of
+		 * a relation that was later deleted.  We want to go ahead and create
+		 * the segments so we can finish out the replay.
+		 *
+		 * We have to maintain the invariant that segments before the last
+		 * active segment are of size RELSEG_SIZE; therefore, pad them out
+		 * with zeroes if needed.  (This only matters if caller is extending
+		 * the relation discontiguously, but that can happen in hash indexes.)
+		 */
+		if (behavior == EXTENSION_CREATE || InRecovery)
 		{
-			/*
-			 * Normally we will create new segments only if authorized by the
-			 * caller (i.e., we are doing mdextend()).  But when doing WAL
-			 * recovery, create segments anyway; this allows cases such as
-			 * replaying WAL data that has a write into a high-numbered
-			 * segment of a relation that was later deleted.  We want to go
-			 * ahead and create the segments so we can finish out the replay.
-			 *
-			 * We have to maintain the invariant that segments before the last
-			 * active segment are of size RELSEG_SIZE; therefore, pad them out
-			 * with zeroes if needed.  (This only matters if caller is
-			 * extending the relation discontiguously, but that can happen in
-			 * hash indexes.)
-			 */
-			if (behavior == EXTENSION_CREATE || InRecovery)
+			if (_mdnblocks(reln, forknum, v) < RELSEG_SIZE)
 			{
-				if (_mdnblocks(reln, forknum, v) < RELSEG_SIZE)
-				{
-					char	   *zerobuf = palloc0(BLCKSZ);
+				char	   *zerobuf = (char *) palloc0(BLCKSZ);
 
-					mdextend(reln, forknum,
-							 nextsegno * ((BlockNumber) RELSEG_SIZE) - 1,
-							 zerobuf, skipFsync);
-					pfree(zerobuf);
-				}
-				v->mdfd_chain = _mdfd_openseg(reln, forknum, +nextsegno, O_CREAT);
+				mdextend(reln, forknum,
+						 nextsegno * ((BlockNumber) RELSEG_SIZE) - 1,
+						 zerobuf, skipFsync);
+				pfree(zerobuf);
 			}
-			else
-			{
-				/* We won't create segment if not existent */
-				v->mdfd_chain = _mdfd_openseg(reln, forknum, nextsegno, 0);
-			}
-			if (v->mdfd_chain == NULL)
-			{
-				if (behavior == EXTENSION_RETURN_NULL &&
-					FILE_POSSIBLY_DELETED(errno))
-					return NULL;
-				ereport(ERROR,
-						(errcode_for_file_access(),
+			flags = O_CREAT;
+		}
+
+		/* We won't create segment if not existent, unless flags say so */
+		v = _mdfd_openseg(reln, forknum, nextsegno, flags);
+
+		if (v == NULL)
+		{
+			if (behavior == EXTENSION_RETURN_NULL &&
+				FILE_POSSIBLY_DELETED(errno))
+				return NULL;
+			ereport(ERROR,
+					(errcode_for_file_access(),
 				   errmsg("could not open file \"%s\" (target block %u): %m",
 						  _mdfd_segpath(reln, forknum, nextsegno),
 						  blkno)));
-			}
 		}
-		v = v->mdfd_chain;
 	}
+
 	return v;
 }
 
@@ -1791,6 +2631,9 @@ _mdnblocks(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
 {
 	off_t		len;
 
+	if (reln->md_compressed[forknum])
+		return PageCompressNBlocks(seg->mdfd_vfd);
+
 	len = FileSeek(seg->mdfd_vfd, 0L, SEEK_END);
 	if (len < 0)
 		ereport(ERROR,
@@ -1800,3 +2643,48 @@ _mdnblocks(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
 	/* note that this calculation will ignore any partial block at EOF */
 	return (BlockNumber) (len / BLCKSZ);
 }
+
+/*
+ * Check whether a fork just opened is compressed, and remember that.  Only
+ * the main fork can be.  Returns the file, which is reopened without
+ * O_DIRECT if need be.
+ */
+static File
+_mdfd_checkcompressed(SMgrRelation reln, ForkNumber forknum, File fd,
+					  char *path)
+{
+	reln->md_compressed[forknum] = false;
+
+	if (forknum != MAIN_FORKNUM || !PageCompressIsCompressed(fd))
+		return fd;
+
+	reln->md_compressed[forknum] = true;
+
+	if (direct_io)
+	{
+		FileClose(fd);
+		fd = PathNameOpenFile(path, MD_COMPRESSED_OPEN_FLAGS, 0600);
+		if (fd < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", path)));
+	}
+
+	return fd;
+}
+
+/*
+ * Get the lock that protects the header of a compressed segment.
+ */
+static LWLock *
+_mdfd_compresslock(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
+{
+	RelFileNode *rnode = &reln->smgr_rnode.node;
+	uint32		hashcode;
+
+	hashcode = rnode->relNode ^ rnode->dbNode ^ (forknum << 24);
+	hashcode += seg->mdfd_segno;
+
+	return &MainLWLockArray[PAGE_COMPRESS_LWLOCK_OFFSET +
+							hashcode % NUM_PAGE_COMPRESS_PARTITIONS].lock;
+}
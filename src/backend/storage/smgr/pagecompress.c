@@ -0,0 +1,523 @@
+/*-------------------------------------------------------------------------
+ *
+ * pagecompress.c
+ *	  Reading and writing blocks of compressed relation segment files.
+ *
+ * See storage/pagecompress.h for the file layout.  md.c decides which
+ * segment files are compressed, and calls these functions instead of doing
+ * the I/O itself.
+ *
+ * Changes to the header of a segment, which allocate chunks or change its
+ * size, are made under the LWLock that md.c passes in, one of a few
+ * partitions hashed by relation and segment.  A map entry only ever
+ * changes when its block is written, which the buffer manager never lets
+ * two processes do at once, so updating or reading an entry needs no lock.
+ *
+ * These files are not crash-safe on their own: a block written in place
+ * may be torn, and the map entry of a block that moved may reach the disk
+ * before its data.  Damage like that is detected by the CRC in each block,
+ * and fixed by replaying the full-page image that the first change to
+ * every block after a checkpoint logs, just as torn pages are.  Changes
+ * that aren't WAL-logged, like setting hint bits, are only covered
+ * when wal_log_hints or data checksums are on.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/smgr/pagecompress.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xlog.h"
+#include "common/pg_lzcompress.h"
+#include "port/pg_crc32c.h"
+#include "storage/bufmgr.h"
+#include "storage/pagecompress.h"
+
+
+/* extra chunks given to a block that outgrows its run, to leak less */
+#define PC_EXTRA_CHUNKS		2
+
+#define PC_CHUNKS_FOR(size) \
+	((int) ((sizeof(PageCompressData) + (size) + PC_CHUNK_SIZE - 1) / \
+			PC_CHUNK_SIZE))
+
+#define PC_ADDR_OFFSET(blkno) \
+	(PC_MAP_OFFSET + (off_t) sizeof(PageCompressAddr) * (blkno))
+#define PC_CHUNK_OFFSET(chunkno) \
+	(PC_DATA_OFFSET + (off_t) PC_CHUNK_SIZE * (chunkno))
+
+static int	pc_read_at(File file, off_t offset, char *buffer, int amount);
+static void pc_write_at(File file, off_t offset, char *buffer, int amount);
+static void pc_read_header(File file, PageCompressHeader *hdr);
+static void pc_read_addr(File file, BlockNumber blkno, PageCompressAddr *addr);
+static void pc_clear_map(File file, BlockNumber startblk, BlockNumber endblk);
+static pg_crc32c pc_crc(BlockNumber blkno, PageCompressData *data);
+
+
+/*
+ * PageCompressIsCompressed() -- Is this the first segment of a compressed
+ *		relation?
+ *
+ * The file might have been opened with O_DIRECT, so read a whole aligned
+ * block.
+ */
+bool
+PageCompressIsCompressed(File file)
+{
+	static char hdrbuf_space[BLCKSZ + PG_IO_ALIGN_SIZE];
+	char	   *hdrbuf = (char *) TYPEALIGN(PG_IO_ALIGN_SIZE, hdrbuf_space);
+	PageCompressHeader *hdr = (PageCompressHeader *) hdrbuf;
+
+	if (pc_read_at(file, 0, hdrbuf, BLCKSZ) < (int) sizeof(PageCompressHeader))
+		return false;
+
+	if (hdr->pch_magic != PAGE_COMPRESS_MAGIC)
+		return false;
+	if (hdr->pch_version != PAGE_COMPRESS_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("compressed file \"%s\" has unsupported version %u",
+						FilePathName(file), hdr->pch_version)));
+	return true;
+}
+
+/*
+ * PageCompressInit() -- Make a new, empty file the first segment of a
+ *		compressed relation.
+ */
+void
+PageCompressInit(File file)
+{
+	PageCompressHeader hdr;
+
+	hdr.pch_magic = PAGE_COMPRESS_MAGIC;
+	hdr.pch_version = PAGE_COMPRESS_VERSION;
+	hdr.pch_nblocks = 0;
+	hdr.pch_nchunks = 0;
+
+	pc_write_at(file, 0, (char *) &hdr, sizeof(hdr));
+}
+
+/*
+ * PageCompressNBlocks() -- Get the number of blocks in a compressed segment
+ */
+BlockNumber
+PageCompressNBlocks(File file)
+{
+	PageCompressHeader hdr;
+
+	pc_read_header(file, &hdr);
+	return hdr.pch_nblocks;
+}
+
+/*
+ * PageCompressRead() -- Read a block of a compressed segment.
+ *
+ * Returns BLCKSZ, or 0 if the block is past the end of the segment, or -1
+ * with errno set if the read failed, so that the caller can handle the
+ * result like that of FileRead.  Damaged blocks are reported here, or
+ * zeroed if zero_damaged_pages is on.
+ */
+int
+PageCompressRead(File file, BlockNumber blkno, char *buffer)
+{
+	PageCompressAddr addr;
+	char		runbuf[PC_MAX_CHUNKS * PC_CHUNK_SIZE];
+	PageCompressData *data = (PageCompressData *) runbuf;
+	char	   *payload = runbuf + sizeof(PageCompressData);
+	int			nbytes;
+
+	pc_read_addr(file, blkno, &addr);
+
+	if (addr.pca_nchunks == 0)
+	{
+		/* never written: zeroes, unless it's past the end */
+		if (blkno >= PageCompressNBlocks(file))
+			return 0;
+		MemSet(buffer, 0, BLCKSZ);
+		return BLCKSZ;
+	}
+
+	if (addr.pca_nchunks > PC_MAX_CHUNKS)
+		goto damaged;
+
+	nbytes = pc_read_at(file, PC_CHUNK_OFFSET(addr.pca_chunkno), runbuf,
+						addr.pca_nchunks * PC_CHUNK_SIZE);
+	if (nbytes < 0)
+		return -1;
+
+	if (nbytes < (int) sizeof(PageCompressData) ||
+		data->pcd_size > BLCKSZ ||
+		nbytes < (int) sizeof(PageCompressData) + data->pcd_size ||
+		!EQ_CRC32C(data->pcd_crc, pc_crc(blkno, data)))
+		goto damaged;
+
+	if (data->pcd_size == BLCKSZ)
+		memcpy(buffer, payload, BLCKSZ);
+	else if (pglz_decompress(payload, data->pcd_size, buffer, BLCKSZ) != BLCKSZ)
+		goto damaged;
+
+	return BLCKSZ;
+
+damaged:
+	if (!zero_damaged_pages)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid compressed data for block %u in file \"%s\"",
+						blkno, FilePathName(file))));
+	ereport(WARNING,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("invalid compressed data for block %u in file \"%s\"; zeroing out page",
+					blkno, FilePathName(file))));
+	MemSet(buffer, 0, BLCKSZ);
+	return BLCKSZ;
+}
+
+/*
+ * PageCompressWrite() -- Write a block of a compressed segment.
+ *
+ * If extend is true, the block is at or past the end of the segment, and
+ * the segment is extended to include it.  Its map entry is ignored then,
+ * since it may be left over from before a crash.
+ *
+ * During recovery, every block gets a new run.  If the header didn't reach
+ * the disk before a crash but some map entries did, those entries may
+ * point to chunks that get allocated again; replay moves the blocks away.
+ */
+void
+PageCompressWrite(File file, LWLock *lock, BlockNumber blkno, char *buffer,
+				  bool extend)
+{
+	PageCompressAddr addr;
+	char		runbuf[sizeof(PageCompressData) + PGLZ_MAX_OUTPUT(BLCKSZ)];
+	PageCompressData *data = (PageCompressData *) runbuf;
+	char	   *payload = runbuf + sizeof(PageCompressData);
+	int32		size;
+	int			nchunks;
+
+	Assert(blkno < RELSEG_SIZE);
+
+	/* store the block as is if compressing it wouldn't save a chunk */
+	size = pglz_compress(buffer, BLCKSZ, payload, PGLZ_strategy_always);
+	if (size < 0 || PC_CHUNKS_FOR(size) >= PC_CHUNKS_FOR(BLCKSZ))
+	{
+		memcpy(payload, buffer, BLCKSZ);
+		size = BLCKSZ;
+	}
+	data->pcd_size = (uint16) size;
+	data->pcd_unused = 0;
+	data->pcd_crc = pc_crc(blkno, data);
+	nchunks = PC_CHUNKS_FOR(size);
+
+	if (extend || InRecovery)
+		MemSet(&addr, 0, sizeof(addr));
+	else
+		pc_read_addr(file, blkno, &addr);
+
+	if (addr.pca_nchunks < (uint32) nchunks)
+	{
+		PageCompressHeader hdr;
+		uint32		alloc;
+
+		/* a block that has grown is likely to grow again */
+		alloc = nchunks;
+		if (addr.pca_nchunks > 0)
+			alloc = Min(nchunks + PC_EXTRA_CHUNKS, PC_MAX_CHUNKS);
+
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		pc_read_header(file, &hdr);
+
+		/* grow the run in place if it's the last one, else start anew */
+		if (addr.pca_nchunks > 0 &&
+			addr.pca_chunkno + addr.pca_nchunks == hdr.pch_nchunks)
+			hdr.pch_nchunks = addr.pca_chunkno + alloc;
+		else
+		{
+			addr.pca_chunkno = hdr.pch_nchunks;
+			hdr.pch_nchunks += alloc;
+		}
+		addr.pca_nchunks = alloc;
+		if (blkno >= hdr.pch_nblocks)
+		{
+			/* skipped blocks read as zeroes, as in PageCompressExtend */
+			pc_clear_map(file, hdr.pch_nblocks, blkno);
+			hdr.pch_nblocks = blkno + 1;
+		}
+
+		hdr.pch_magic = PAGE_COMPRESS_MAGIC;
+		hdr.pch_version = PAGE_COMPRESS_VERSION;
+		pc_write_at(file, 0, (char *) &hdr, sizeof(hdr));
+		LWLockRelease(lock);
+
+		pc_write_at(file, PC_CHUNK_OFFSET(addr.pca_chunkno), runbuf,
+					sizeof(PageCompressData) + size);
+		pc_write_at(file, PC_ADDR_OFFSET(blkno), (char *) &addr, sizeof(addr));
+	}
+	else
+		pc_write_at(file, PC_CHUNK_OFFSET(addr.pca_chunkno), runbuf,
+					sizeof(PageCompressData) + size);
+}
+
+/*
+ * PageCompressExtend() -- Extend a compressed segment to nblocks blocks.
+ *
+ * The new blocks read as zeroes until they are written.  Their map entries
+ * are cleared first, in case a crash left some behind.
+ */
+void
+PageCompressExtend(File file, LWLock *lock, BlockNumber nblocks)
+{
+	PageCompressHeader hdr;
+
+	Assert(nblocks <= RELSEG_SIZE);
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	pc_read_header(file, &hdr);
+	if (nblocks > hdr.pch_nblocks)
+	{
+		pc_clear_map(file, hdr.pch_nblocks, nblocks);
+
+		hdr.pch_magic = PAGE_COMPRESS_MAGIC;
+		hdr.pch_version = PAGE_COMPRESS_VERSION;
+		hdr.pch_nblocks = nblocks;
+		pc_write_at(file, 0, (char *) &hdr, sizeof(hdr));
+	}
+	LWLockRelease(lock);
+}
+
+/*
+ * PageCompressTruncate() -- Truncate a compressed segment to nblocks blocks.
+ *
+ * The map entries of the blocks cut off are cleared, and the data area
+ * is cut back to the end of the last run still in use.  That's done
+ * before the header is updated, so that no entry can point past the
+ * allocated chunks, where new runs would go.
+ */
+void
+PageCompressTruncate(File file, LWLock *lock, BlockNumber nblocks)
+{
+	PageCompressHeader hdr;
+	PageCompressAddr *map;
+	uint32		nchunks = 0;
+	BlockNumber blkno;
+	off_t		maplen;
+
+	Assert(nblocks <= RELSEG_SIZE);
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	pc_read_header(file, &hdr);
+
+	/* the map entries that stay, to find the end of the runs they use */
+	maplen = (off_t) sizeof(PageCompressAddr) * nblocks;
+	map = (PageCompressAddr *) palloc0(Max(maplen, 1));
+	if (nblocks > 0 &&
+		pc_read_at(file, PC_MAP_OFFSET, (char *) map, (int) maplen) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m",
+						FilePathName(file))));
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		if (map[blkno].pca_nchunks > 0)
+			nchunks = Max(nchunks,
+						  map[blkno].pca_chunkno + map[blkno].pca_nchunks);
+	}
+	pfree(map);
+
+	if (nchunks > 0)
+	{
+		pc_clear_map(file, nblocks, Max(hdr.pch_nblocks, nblocks));
+		if (FileTruncate(file, PC_CHUNK_OFFSET(nchunks)) < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not truncate file \"%s\": %m",
+							FilePathName(file))));
+	}
+	else if (FileTruncate(file, PC_MAP_OFFSET) < 0)
+	{
+		/* no block has a run anymore, so the whole map can go */
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not truncate file \"%s\": %m",
+						FilePathName(file))));
+	}
+
+	hdr.pch_magic = PAGE_COMPRESS_MAGIC;
+	hdr.pch_version = PAGE_COMPRESS_VERSION;
+	hdr.pch_nblocks = nblocks;
+	hdr.pch_nchunks = nchunks;
+	pc_write_at(file, 0, (char *) &hdr, sizeof(hdr));
+
+	LWLockRelease(lock);
+}
+
+/*
+ * PageCompressPrefetch() -- Initiate an asynchronous read of a block of a
+ *		compressed segment.
+ */
+void
+PageCompressPrefetch(File file, BlockNumber blkno)
+{
+#ifdef USE_PREFETCH
+	PageCompressAddr addr;
+
+	pc_read_addr(file, blkno, &addr);
+	if (addr.pca_nchunks > 0 && addr.pca_nchunks <= PC_MAX_CHUNKS)
+		(void) FilePrefetch(file, PC_CHUNK_OFFSET(addr.pca_chunkno),
+							addr.pca_nchunks * PC_CHUNK_SIZE);
+#endif   /* USE_PREFETCH */
+}
+
+/*
+ * Read from a compressed segment at the given offset.  Returns the number
+ * of bytes read, which is short at the end of the file, or -1 with errno
+ * set.
+ */
+static int
+pc_read_at(File file, off_t offset, char *buffer, int amount)
+{
+	int			nbytes;
+	int			total = 0;
+
+	if (FileSeek(file, offset, SEEK_SET) != offset)
+		return -1;
+
+	while (total < amount)
+	{
+		nbytes = FileRead(file, buffer + total, amount - total);
+		if (nbytes < 0)
+			return -1;
+		if (nbytes == 0)
+			break;
+		total += nbytes;
+	}
+	return total;
+}
+
+/*
+ * Write to a compressed segment at the given offset, ereporting failures.
+ */
+static void
+pc_write_at(File file, off_t offset, char *buffer, int amount)
+{
+	int			nbytes;
+
+	if (FileSeek(file, offset, SEEK_SET) != offset)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek to offset " INT64_FORMAT " in file \"%s\": %m",
+						(int64) offset, FilePathName(file))));
+
+	if ((nbytes = FileWrite(file, buffer, amount)) != amount)
+	{
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							FilePathName(file))));
+		/* short write: complain appropriately */
+		ereport(ERROR,
+				(errcode(ERRCODE_DISK_FULL),
+				 errmsg("could not write to file \"%s\": wrote only %d of %d bytes at offset " INT64_FORMAT,
+						FilePathName(file), nbytes, amount, (int64) offset),
+				 errhint("Check free disk space.")));
+	}
+}
+
+/*
+ * Read the header of a compressed segment.  A file shorter than that is an
+ * empty segment.
+ */
+static void
+pc_read_header(File file, PageCompressHeader *hdr)
+{
+	int			nbytes;
+
+	nbytes = pc_read_at(file, 0, (char *) hdr, sizeof(PageCompressHeader));
+	if (nbytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m",
+						FilePathName(file))));
+	if (nbytes < (int) sizeof(PageCompressHeader))
+		MemSet(hdr, 0, sizeof(PageCompressHeader));
+}
+
+/*
+ * Read the map entry of a block.  Entries past the end of the file are
+ * unset.
+ */
+static void
+pc_read_addr(File file, BlockNumber blkno, PageCompressAddr *addr)
+{
+	int			nbytes;
+
+	Assert(blkno < RELSEG_SIZE);
+
+	nbytes = pc_read_at(file, PC_ADDR_OFFSET(blkno), (char *) addr,
+						sizeof(PageCompressAddr));
+	if (nbytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m",
+						FilePathName(file))));
+	if (nbytes < (int) sizeof(PageCompressAddr))
+		MemSet(addr, 0, sizeof(PageCompressAddr));
+}
+
+/*
+ * Clear the map entries of blocks startblk up to endblk.  Entries past the
+ * end of the file are unset already.
+ */
+static void
+pc_clear_map(File file, BlockNumber startblk, BlockNumber endblk)
+{
+	PageCompressAddr zeroes[BLCKSZ / sizeof(PageCompressAddr)];
+	off_t		filelen;
+	off_t		offset = PC_ADDR_OFFSET(startblk);
+	off_t		end = PC_ADDR_OFFSET(endblk);
+
+	if (startblk >= endblk)
+		return;
+
+	filelen = FileSeek(file, 0L, SEEK_END);
+	if (filelen < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek to end of file \"%s\": %m",
+						FilePathName(file))));
+	end = Min(end, filelen);
+
+	MemSet(zeroes, 0, sizeof(zeroes));
+	while (offset < end)
+	{
+		int			amount = (int) Min(end - offset, (off_t) sizeof(zeroes));
+
+		pc_write_at(file, offset, (char *) zeroes, amount);
+		offset += amount;
+	}
+}
+
+/*
+ * Compute the CRC of a stored block, seeded with its block number so that a
+ * run read for the wrong block doesn't pass.
+ */
+static pg_crc32c
+pc_crc(BlockNumber blkno, PageCompressData *data)
+{
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, &blkno, sizeof(blkno));
+	COMP_CRC32C(crc, &data->pcd_size,
+				sizeof(PageCompressData) - offsetof(PageCompressData, pcd_size) +
+				data->pcd_size);
+	FIN_CRC32C(crc);
+
+	return crc;
+}
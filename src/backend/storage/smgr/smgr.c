@@ -17,9 +17,12 @@
  */
 #include "postgres.h"
 
+#include "access/xlog.h"
 #include "commands/tablespace.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "utils/hsearch.h"
 #include "utils/inval.h"
@@ -42,17 +45,32 @@ typedef struct f_smgr
 	void		(*smgr_close) (SMgrRelation reln, ForkNumber forknum);
 	void		(*smgr_create) (SMgrRelation reln, ForkNumber forknum,
 											bool isRedo);
+	void		(*smgr_compress) (SMgrRelation reln, ForkNumber forknum,
+											  bool isRedo);
 	bool		(*smgr_exists) (SMgrRelation reln, ForkNumber forknum);
 	void		(*smgr_unlink) (RelFileNodeBackend rnode, ForkNumber forknum,
 											bool isRedo);
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 						 BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
+						 BlockNumber blocknum, int nblocks, bool skipFsync);
 	void		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
 											  BlockNumber blocknum);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
 										  BlockNumber blocknum, char *buffer);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+						BlockNumber blocknum, char **buffers, int nblocks);
+	int			(*smgr_startread) (SMgrRelation reln, ForkNumber forknum,
+										   BlockNumber blocknum, char *buffer);
+	void		(*smgr_waitread) (SMgrRelation reln, ForkNumber forknum,
+							BlockNumber blocknum, char *buffer, int handle);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 						 BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum, char **buffers,
+									int nblocks, bool skipFsync);
+	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
+								   BlockNumber blocknum, BlockNumber nblocks);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
 	void		(*smgr_truncate) (SMgrRelation reln, ForkNumber forknum,
 											  BlockNumber nblocks);
@@ -65,8 +83,11 @@ typedef struct f_smgr
 
 static const f_smgr smgrsw[] = {
 	/* magnetic disk */
-	{mdinit, NULL, mdclose, mdcreate, mdexists, mdunlink, mdextend,
-		mdprefetch, mdread, mdwrite, mdnblocks, mdtruncate, mdimmedsync,
+	{mdinit, NULL, mdclose, mdcreate, mdcompress, mdexists, mdunlink, mdextend,
+		mdzeroextend, mdprefetch, mdread, mdreadv, mdstartread, mdwaitread, mdwrite,
+		mdwritev, mdwriteback,
+		mdnblocks, mdtruncate,
+		mdimmedsync,
 		mdpreckpt, mdsync, mdpostckpt
 	}
 };
@@ -82,10 +103,71 @@ static HTAB *SMgrRelationHash = NULL;
 
 static SMgrRelation first_unowned_reln = NULL;
 
+/*
+ * In addition, the sizes of the forks of permanent and unlogged relations
+ * are kept in a shared hashtable, so that smgrnblocks() doesn't have to ask
+ * the kernel each time.  Every change of a relation's size goes through
+ * smgrextend(), smgrzeroextend() or smgrtruncate(), which keep the table up
+ * to date, so a size found in it can be trusted, on a primary as well as on
+ * a standby.
+ *
+ * An entry can be evicted to make room for another relation, and a fork's
+ * size can be forgotten, at any time.  A backend that finds no size and
+ * measures the file itself must not store a value that has been overtaken
+ * by an extension in the meantime, so each partition counts the times it
+ * has lost information; the value is only stored if the count hasn't
+ * changed since it looked.  Extensions, in turn, always store their new
+ * size, or bump the count if they can't.
+ *
+ * The table is partitioned like the buffer mapping table, by the hash code
+ * of the RelFileNode.  Entries found are marked as referenced without
+ * holding an exclusive lock, which is harmless: the flag is only a hint for
+ * choosing victims.
+ */
+typedef struct SMgrSharedRelation
+{
+	RelFileNode rnode;			/* hash key, must be first */
+	BlockNumber nblocks[MAX_FORKNUM + 1];	/* InvalidBlockNumber if unknown */
+	bool		referenced;		/* looked up since the last sweep? */
+} SMgrSharedRelation;
+
+typedef struct SMgrSharedRelationCtl
+{
+	/* times each partition has lost a size, protected by its lock */
+	uint64		forgotten[NUM_SMGR_SIZE_PARTITIONS];
+} SMgrSharedRelationCtl;
+
+#define SMgrSizePartition(hashcode) \
+	((hashcode) % NUM_SMGR_SIZE_PARTITIONS)
+#define SMgrSizePartitionLock(hashcode) \
+	(&MainLWLockArray[SMGR_SIZE_LWLOCK_OFFSET + \
+		SMgrSizePartition(hashcode)].lock)
+#define SMgrSizePartitionLockByIndex(i) \
+	(&MainLWLockArray[SMGR_SIZE_LWLOCK_OFFSET + (i)].lock)
+
+/* number of entries in the shared relation size table (GUC) */
+int			smgr_shared_relations = 1000;
+
+static HTAB *SMgrSharedRelationHash = NULL;
+static SMgrSharedRelationCtl *SMgrSharedCtl = NULL;
+
 /* local function prototypes */
 static void smgrshutdown(int code, Datum arg);
 static void add_to_unowned_list(SMgrRelation reln);
 static void remove_from_unowned_list(SMgrRelation reln);
+static bool smgr_shared_usable(SMgrRelation reln, uint32 *hashcode);
+static BlockNumber smgr_shared_lookup(SMgrRelation reln, ForkNumber forknum,
+				   uint64 *forgotten);
+static SMgrSharedRelation *smgr_shared_enter(SMgrRelation reln,
+				  uint32 hashcode, LWLock *partitionLock);
+static BlockNumber smgr_shared_offer(SMgrRelation reln, ForkNumber forknum,
+				  BlockNumber nblocks, uint64 forgotten);
+static void smgr_shared_extend(SMgrRelation reln, ForkNumber forknum,
+				   BlockNumber nblocks);
+static void smgr_shared_set(SMgrRelation reln, ForkNumber forknum,
+				BlockNumber nblocks);
+static void smgr_shared_forget(RelFileNodeBackend rnode);
+static void smgr_shared_sweep(Oid dbid, bool evict);
 
 
 /*
@@ -126,6 +208,342 @@ smgrshutdown(int code, Datum arg)
 	}
 }
 
+/*
+ *	SMgrShmemSize() -- Estimate space needed for the shared size table.
+ */
+Size
+SMgrShmemSize(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(SMgrSharedRelationCtl));
+	if (smgr_shared_relations > 0)
+		size = add_size(size, hash_estimate_size(smgr_shared_relations,
+												 sizeof(SMgrSharedRelation)));
+	return size;
+}
+
+/*
+ *	SMgrShmemInit() -- Create or attach to the shared size table.
+ */
+void
+SMgrShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	SMgrSharedCtl = (SMgrSharedRelationCtl *)
+		ShmemInitStruct("Shared Relation Size Control",
+						sizeof(SMgrSharedRelationCtl), &found);
+	if (!found)
+		memset(SMgrSharedCtl, 0, sizeof(SMgrSharedRelationCtl));
+
+	if (smgr_shared_relations <= 0)
+		return;
+
+	info.keysize = sizeof(RelFileNode);
+	info.entrysize = sizeof(SMgrSharedRelation);
+	info.num_partitions = NUM_SMGR_SIZE_PARTITIONS;
+
+	SMgrSharedRelationHash = ShmemInitHash("Shared Relation Size Table",
+										   smgr_shared_relations,
+										   smgr_shared_relations,
+										   &info,
+									HASH_ELEM | HASH_BLOBS | HASH_PARTITION |
+										   HASH_FIXED_SIZE);
+}
+
+/*
+ * Should the size of this relation be kept in the shared table?  Temporary
+ * relations' sizes are backend-local business.  Sets *hashcode if so.
+ */
+static bool
+smgr_shared_usable(SMgrRelation reln, uint32 *hashcode)
+{
+	if (SMgrSharedRelationHash == NULL ||
+		RelFileNodeBackendIsTemp(reln->smgr_rnode))
+		return false;
+
+	*hashcode = get_hash_value(SMgrSharedRelationHash,
+							   (void *) &reln->smgr_rnode.node);
+	return true;
+}
+
+/*
+ * Look up the size of a fork in the shared table.  If it isn't known,
+ * returns InvalidBlockNumber and sets *forgotten for smgr_shared_offer().
+ */
+static BlockNumber
+smgr_shared_lookup(SMgrRelation reln, ForkNumber forknum, uint64 *forgotten)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	SMgrSharedRelation *sr;
+	BlockNumber result = InvalidBlockNumber;
+
+	*forgotten = 0;
+	if (!smgr_shared_usable(reln, &hashcode))
+		return InvalidBlockNumber;
+
+	partitionLock = SMgrSizePartitionLock(hashcode);
+	LWLockAcquire(partitionLock, LW_SHARED);
+	sr = (SMgrSharedRelation *)
+		hash_search_with_hash_value(SMgrSharedRelationHash,
+									(void *) &reln->smgr_rnode.node,
+									hashcode, HASH_FIND, NULL);
+	if (sr != NULL)
+	{
+		result = sr->nblocks[forknum];
+		if (!sr->referenced)
+			sr->referenced = true;
+	}
+	*forgotten = SMgrSharedCtl->forgotten[SMgrSizePartition(hashcode)];
+	LWLockRelease(partitionLock);
+
+	return result;
+}
+
+/*
+ * Find or make the entry for a relation, with its partition lock held
+ * exclusively.  If the table is full, evict some entries first.  Returns
+ * NULL if there's still no room, which can only happen if other backends
+ * took the free entries in the meantime.
+ */
+static SMgrSharedRelation *
+smgr_shared_enter(SMgrRelation reln, uint32 hashcode, LWLock *partitionLock)
+{
+	SMgrSharedRelation *sr;
+	bool		found;
+	int			i;
+	int			tries;
+
+	for (tries = 0;; tries++)
+	{
+		LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+		sr = (SMgrSharedRelation *)
+			hash_search_with_hash_value(SMgrSharedRelationHash,
+										(void *) &reln->smgr_rnode.node,
+										hashcode, HASH_ENTER_NULL, &found);
+		if (sr != NULL)
+		{
+			if (!found)
+			{
+				for (i = 0; i <= MAX_FORKNUM; i++)
+					sr->nblocks[i] = InvalidBlockNumber;
+				sr->referenced = true;
+			}
+			return sr;
+		}
+		if (tries > 0)
+			return NULL;
+
+		/* make room, and try again */
+		LWLockRelease(partitionLock);
+		smgr_shared_sweep(InvalidOid, true);
+	}
+}
+
+/*
+ * Offer the size of a fork measured by md.c to the shared table, after
+ * smgr_shared_lookup() found it unknown.  Returns the size to use, which is
+ * the one already in the table if someone else stored it first.
+ */
+static BlockNumber
+smgr_shared_offer(SMgrRelation reln, ForkNumber forknum,
+				  BlockNumber nblocks, uint64 forgotten)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	SMgrSharedRelation *sr;
+
+	if (!smgr_shared_usable(reln, &hashcode))
+		return nblocks;
+
+	partitionLock = SMgrSizePartitionLock(hashcode);
+	sr = smgr_shared_enter(reln, hashcode, partitionLock);
+	if (sr != NULL)
+	{
+		if (sr->nblocks[forknum] != InvalidBlockNumber)
+			nblocks = sr->nblocks[forknum];
+		else if (SMgrSharedCtl->forgotten[SMgrSizePartition(hashcode)] == forgotten)
+			sr->nblocks[forknum] = nblocks;
+	}
+	LWLockRelease(partitionLock);
+
+	return nblocks;
+}
+
+/*
+ * Record that a fork has been extended to at least nblocks blocks.
+ */
+static void
+smgr_shared_extend(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	SMgrSharedRelation *sr;
+
+	if (!smgr_shared_usable(reln, &hashcode))
+		return;
+
+	partitionLock = SMgrSizePartitionLock(hashcode);
+	sr = smgr_shared_enter(reln, hashcode, partitionLock);
+	if (sr == NULL)
+		SMgrSharedCtl->forgotten[SMgrSizePartition(hashcode)]++;
+	else if (sr->nblocks[forknum] == InvalidBlockNumber ||
+			 sr->nblocks[forknum] < nblocks)
+	{
+		/*
+		 * An unknown size becomes known here: the fork ends at the block we
+		 * just wrote, unless a concurrent extension went further, in which
+		 * case that one will store its own, larger, size.
+		 */
+		sr->nblocks[forknum] = nblocks;
+	}
+	LWLockRelease(partitionLock);
+}
+
+/*
+ * Set the size of a fork, after truncating it, or forget it if nblocks is
+ * InvalidBlockNumber.
+ */
+static void
+smgr_shared_set(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	SMgrSharedRelation *sr;
+
+	if (!smgr_shared_usable(reln, &hashcode))
+		return;
+
+	partitionLock = SMgrSizePartitionLock(hashcode);
+	if (nblocks != InvalidBlockNumber)
+		sr = smgr_shared_enter(reln, hashcode, partitionLock);
+	else
+	{
+		LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+		sr = (SMgrSharedRelation *)
+			hash_search_with_hash_value(SMgrSharedRelationHash,
+										(void *) &reln->smgr_rnode.node,
+										hashcode, HASH_FIND, NULL);
+	}
+	if (sr != NULL)
+		sr->nblocks[forknum] = nblocks;
+	if (sr == NULL || nblocks == InvalidBlockNumber)
+		SMgrSharedCtl->forgotten[SMgrSizePartition(hashcode)]++;
+	LWLockRelease(partitionLock);
+}
+
+/*
+ * Remove a relation that is being dropped from the shared table.
+ */
+static void
+smgr_shared_forget(RelFileNodeBackend rnode)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+
+	if (SMgrSharedRelationHash == NULL || RelFileNodeBackendIsTemp(rnode))
+		return;
+
+	hashcode = get_hash_value(SMgrSharedRelationHash, (void *) &rnode.node);
+	partitionLock = SMgrSizePartitionLock(hashcode);
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	hash_search_with_hash_value(SMgrSharedRelationHash,
+								(void *) &rnode.node,
+								hashcode, HASH_REMOVE, NULL);
+	SMgrSharedCtl->forgotten[SMgrSizePartition(hashcode)]++;
+	LWLockRelease(partitionLock);
+}
+
+/*
+ * Sweep the whole shared size table, holding all of its partition locks.
+ *
+ * If evict is true, remove entries that haven't been referenced since the
+ * last sweep, and clear the flag on the others, until an eighth of the
+ * table is free.  Otherwise remove the entries of the given database, or of
+ * all databases if dbid is InvalidOid.
+ */
+static void
+smgr_shared_sweep(Oid dbid, bool evict)
+{
+	HASH_SEQ_STATUS status;
+	SMgrSharedRelation *sr;
+	long		target = Max(smgr_shared_relations / 8, 1);
+	long		nfree;
+	int			pass;
+	int			i;
+
+	for (i = 0; i < NUM_SMGR_SIZE_PARTITIONS; i++)
+		LWLockAcquire(SMgrSizePartitionLockByIndex(i), LW_EXCLUSIVE);
+
+	nfree = smgr_shared_relations - hash_get_num_entries(SMgrSharedRelationHash);
+
+	/*
+	 * When evicting, a second pass is needed if every entry was referenced;
+	 * the first one cleared all the flags.
+	 */
+	for (pass = 0; pass < 2; pass++)
+	{
+		if (evict && nfree >= target)
+			break;
+
+		hash_seq_init(&status, SMgrSharedRelationHash);
+		while ((sr = (SMgrSharedRelation *) hash_seq_search(&status)) != NULL)
+		{
+			bool		remove;
+
+			if (evict)
+			{
+				if (nfree >= target)
+				{
+					hash_seq_term(&status);
+					break;
+				}
+				remove = !sr->referenced;
+				sr->referenced = false;
+			}
+			else
+				remove = (dbid == InvalidOid || sr->rnode.dbNode == dbid);
+
+			if (remove)
+			{
+				hash_search(SMgrSharedRelationHash, (void *) &sr->rnode,
+							HASH_REMOVE, NULL);
+				nfree++;
+			}
+		}
+
+		if (!evict)
+			break;
+	}
+
+	for (i = NUM_SMGR_SIZE_PARTITIONS - 1; i >= 0; i--)
+	{
+		SMgrSharedCtl->forgotten[i]++;
+		LWLockRelease(SMgrSizePartitionLockByIndex(i));
+	}
+}
+
+/*
+ *	smgrforgetdb() -- Forget the sizes of all relations of a database.
+ *
+ *		This is for when a database's files go away without going through
+ *		smgrdounlink, that is, when it's dropped or moved to another
+ *		tablespace, so that the sizes aren't mistaken for those of
+ *		relations that might appear under the same RelFileNodes later.
+ *		With InvalidOid, the sizes of all relations are forgotten.
+ */
+void
+smgrforgetdb(Oid dbid)
+{
+	if (SMgrSharedRelationHash == NULL)
+		return;
+
+	smgr_shared_sweep(dbid, false);
+}
+
 /*
  *	smgropen() -- Return an SMgrRelation object, creating it if need be.
  *
@@ -172,7 +590,11 @@ smgropen(RelFileNode rnode, BackendId backend)
 
 		/* mark it not open */
 		for (forknum = 0; forknum <= MAX_FORKNUM; forknum = forknum + 1)
-			reln->md_fd[forknum] = NULL;
+		{
+			reln->md_num_open_segs[forknum] = 0;
+			reln->md_compressed[forknum] = false;
+			reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+		}
 
 		/* it has no owner yet */
 		add_to_unowned_list(reln);
@@ -377,7 +799,7 @@ smgrcreate(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 	 * Exit quickly in WAL replay mode if we've already opened the file. If
 	 * it's open, it surely must exist.
 	 */
-	if (isRedo && reln->md_fd[forknum] != NULL)
+	if (isRedo && reln->md_num_open_segs[forknum] > 0)
 		return;
 
 	/*
@@ -396,6 +818,25 @@ smgrcreate(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 	(*(smgrsw[reln->smgr_which].smgr_create)) (reln, forknum, isRedo);
 }
 
+/*
+ *	smgrcompress() -- Store a new fork compressed.
+ *
+ *		The fork must have just been created by smgrcreate, and be empty.
+ *		Its blocks are compressed when written out, and decompressed when
+ *		read back, transparently to the caller.  Only the main fork can be
+ *		compressed.
+ *
+ *		If isRedo is true, it is okay for the fork to have been compressed,
+ *		or filled, already.
+ */
+void
+smgrcompress(SMgrRelation reln, ForkNumber forknum, bool isRedo)
+{
+	Assert(forknum == MAIN_FORKNUM);
+
+	(*(smgrsw[reln->smgr_which].smgr_compress)) (reln, forknum, isRedo);
+}
+
 /*
  *	smgrdounlink() -- Immediately unlink all forks of a relation.
  *
@@ -423,7 +864,7 @@ smgrdounlink(SMgrRelation reln, bool isRedo)
 	 * Get rid of any remaining buffers for the relation.  bufmgr will just
 	 * drop them without bothering to write the contents.
 	 */
-	DropRelFileNodesAllBuffers(&rnode, 1);
+	DropRelFileNodesAllBuffers(&reln, 1);
 
 	/*
 	 * It'd be nice to tell the stats collector to forget it immediately, too.
@@ -442,6 +883,11 @@ smgrdounlink(SMgrRelation reln, bool isRedo)
 	 */
 	CacheInvalidateSmgr(rnode);
 
+	/* Its size is no longer of interest either. */
+	for (forknum = 0; forknum <= MAX_FORKNUM; forknum = forknum + 1)
+		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+	smgr_shared_forget(rnode);
+
 	/*
 	 * Delete the physical file(s).
 	 *
@@ -496,7 +942,7 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 	 * Get rid of any remaining buffers for the relations.  bufmgr will just
 	 * drop them without bothering to write the contents.
 	 */
-	DropRelFileNodesAllBuffers(rnodes, nrels);
+	DropRelFileNodesAllBuffers(rels, nrels);
 
 	/*
 	 * It'd be nice to tell the stats collector to forget them immediately,
@@ -514,6 +960,14 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 	for (i = 0; i < nrels; i++)
 		CacheInvalidateSmgr(rnodes[i]);
 
+	/* Their sizes are no longer of interest either. */
+	for (i = 0; i < nrels; i++)
+	{
+		for (forknum = 0; forknum <= MAX_FORKNUM; forknum = forknum + 1)
+			rels[i]->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+		smgr_shared_forget(rnodes[i]);
+	}
+
 	/*
 	 * Delete the physical file(s).
 	 *
@@ -556,7 +1010,7 @@ smgrdounlinkfork(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 	 * Get rid of any remaining buffers for the fork.  bufmgr will just drop
 	 * them without bothering to write the contents.
 	 */
-	DropRelFileNodeBuffers(rnode, forknum, 0);
+	DropRelFileNodeBuffers(reln, forknum, 0);
 
 	/*
 	 * It'd be nice to tell the stats collector to forget it immediately, too.
@@ -575,6 +1029,10 @@ smgrdounlinkfork(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 	 */
 	CacheInvalidateSmgr(rnode);
 
+	/* Its size is no longer of interest either. */
+	reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+	smgr_shared_set(reln, forknum, InvalidBlockNumber);
+
 	/*
 	 * Delete the physical file(s).
 	 *
@@ -600,6 +1058,40 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 {
 	(*(smgrsw[reln->smgr_which].smgr_extend)) (reln, forknum, blocknum,
 											   buffer, skipFsync);
+
+	/*
+	 * Normally we expect this to increase nblocks by one, but if the cached
+	 * value isn't as expected, just invalidate it so the next call asks the
+	 * kernel.
+	 */
+	if (reln->smgr_cached_nblocks[forknum] == blocknum)
+		reln->smgr_cached_nblocks[forknum] = blocknum + 1;
+	else
+		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+
+	smgr_shared_extend(reln, forknum, blocknum + 1);
+}
+
+/*
+ *	smgrzeroextend() -- Add new zero-filled blocks to a file.
+ *
+ *		This is smgrextend for nblocks blocks from blocknum on, with pages
+ *		of zeroes, done with as few system calls as possible.
+ */
+void
+smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   int nblocks, bool skipFsync)
+{
+	(*(smgrsw[reln->smgr_which].smgr_zeroextend)) (reln, forknum, blocknum,
+												   nblocks, skipFsync);
+
+	/* as in smgrextend() */
+	if (reln->smgr_cached_nblocks[forknum] == blocknum)
+		reln->smgr_cached_nblocks[forknum] = blocknum + nblocks;
+	else
+		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+
+	smgr_shared_extend(reln, forknum, blocknum + nblocks);
 }
 
 /*
@@ -626,6 +1118,52 @@ smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	(*(smgrsw[reln->smgr_which].smgr_read)) (reln, forknum, blocknum, buffer);
 }
 
+/*
+ *	smgrstartread() -- start reading a particular block of a relation into
+ *					   the supplied buffer, without waiting for it.
+ *
+ *		Returns a handle to pass to smgrwaitread, which must be called
+ *		before the buffer can be used, and before anything else is done with
+ *		it.  Errors that smgrread would report are reported by smgrwaitread.
+ */
+int
+smgrstartread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  char *buffer)
+{
+	return (*(smgrsw[reln->smgr_which].smgr_startread)) (reln, forknum,
+														 blocknum, buffer);
+}
+
+/*
+ *	smgrreadv() -- read nblocks consecutive blocks, starting at blocknum,
+ *				   into the given buffers.
+ *
+ *		This is like calling smgrread for each block, but may be done with
+ *		fewer system calls.  nblocks must not exceed FILE_MAX_READV.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, int nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_readv)) (reln, forknum, blocknum,
+											  buffers, nblocks);
+}
+
+/*
+ *	smgrwaitread() -- wait for a read started by smgrstartread to finish.
+ *
+ *		The arguments must be the same ones smgrstartread was given, but
+ *		reln needn't be the same SMgrRelation object; the relation might have
+ *		been closed and reopened in between.
+ */
+void
+smgrwaitread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 char *buffer, int handle)
+{
+	(*(smgrsw[reln->smgr_which].smgr_waitread)) (reln, forknum, blocknum,
+												 buffer, handle);
+}
+
 /*
  *	smgrwrite() -- Write the supplied buffer out.
  *
@@ -649,6 +1187,36 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 											  buffer, skipFsync);
 }
 
+/*
+ *	smgrwritev() -- write out nblocks consecutive blocks, starting at
+ *					blocknum, from the given buffers.
+ *
+ *		This is like calling smgrwrite for each block, but may be done with
+ *		fewer system calls.  nblocks must not exceed FILE_MAX_WRITEV.
+ */
+void
+smgrwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   char **buffers, int nblocks, bool skipFsync)
+{
+	(*(smgrsw[reln->smgr_which].smgr_writev)) (reln, forknum, blocknum,
+											   buffers, nblocks, skipFsync);
+}
+
+/*
+ *	smgrwriteback() -- Trigger kernel writeback for the supplied range of
+ *					   blocks.
+ *
+ *		The blocks have already been written with smgrwrite(); this only
+ *		asks the kernel to start writing them to disk now.
+ */
+void
+smgrwriteback(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  BlockNumber nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_writeback)) (reln, forknum, blocknum,
+												  nblocks);
+}
+
 /*
  *	smgrnblocks() -- Calculate the number of blocks in the
  *					 supplied relation.
@@ -656,7 +1224,47 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 BlockNumber
 smgrnblocks(SMgrRelation reln, ForkNumber forknum)
 {
-	return (*(smgrsw[reln->smgr_which].smgr_nblocks)) (reln, forknum);
+	BlockNumber result;
+	uint64		forgotten;
+
+	/* Check and return if we get the cached value for the number of blocks. */
+	result = smgrnblocks_cached(reln, forknum);
+	if (result != InvalidBlockNumber)
+		return result;
+
+	/* Next, try the shared size table, and failing that ask md.c */
+	result = smgr_shared_lookup(reln, forknum, &forgotten);
+	if (result == InvalidBlockNumber)
+	{
+		result = (*(smgrsw[reln->smgr_which].smgr_nblocks)) (reln, forknum);
+		result = smgr_shared_offer(reln, forknum, result, forgotten);
+	}
+
+	reln->smgr_cached_nblocks[forknum] = result;
+
+	return result;
+}
+
+/*
+ *	smgrnblocks_cached() -- Get the cached number of blocks in the supplied
+ *							relation.
+ *
+ * Returns an InvalidBlockNumber when not in recovery and when the relation
+ * fork size is not cached.
+ *
+ * During recovery the startup process is the only one that extends or
+ * truncates relations, and it does so through this module, so the size we
+ * cached is the true size.  On a primary, other backends can change the
+ * file behind our back, so the cached value is only a hint there and we
+ * always ask the kernel.
+ */
+BlockNumber
+smgrnblocks_cached(SMgrRelation reln, ForkNumber forknum)
+{
+	if (InRecovery && reln->smgr_cached_nblocks[forknum] != InvalidBlockNumber)
+		return reln->smgr_cached_nblocks[forknum];
+
+	return InvalidBlockNumber;
 }
 
 /*
@@ -672,7 +1280,7 @@ smgrtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 	 * Get rid of any buffers for the about-to-be-deleted blocks. bufmgr will
 	 * just drop them without bothering to write the contents.
 	 */
-	DropRelFileNodeBuffers(reln->smgr_rnode, forknum, nblocks);
+	DropRelFileNodeBuffers(reln, forknum, nblocks);
 
 	/*
 	 * Send a shared-inval message to force other backends to close any smgr
@@ -687,9 +1295,20 @@ smgrtruncate(SMgrRelation reln, ForkNumber forknum, BlockNumber nblocks)
 	CacheInvalidateSmgr(reln->smgr_rnode);
 
 	/*
-	 * Do the truncation.
+	 * Do the truncation.  Make the cached size "invalid" in case we fail
+	 * partway through, then record the new size once we're done.
 	 */
+	reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+	smgr_shared_set(reln, forknum, InvalidBlockNumber);
 	(*(smgrsw[reln->smgr_which].smgr_truncate)) (reln, forknum, nblocks);
+	reln->smgr_cached_nblocks[forknum] = nblocks;
+
+	/*
+	 * In recovery, md.c quietly ignores truncations to beyond the current
+	 * end of the file, so we can't be sure of the new size there.
+	 */
+	if (!InRecovery)
+		smgr_shared_set(reln, forknum, nblocks);
 }
 
 /*
@@ -69,6 +69,7 @@
 #include "tcop/utility.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/profiler.h"
 #include "utils/ps_status.h"
 #include "utils/snapmgr.h"
 #include "utils/timeout.h"
@@ -175,6 +176,10 @@ static bool RecoveryConflictPending = false;
 static bool RecoveryConflictRetryable = true;
 static ProcSignalReason RecoveryConflictReason;
 
+/* why a proxied session must keep this backend, and whether we told it */
+static const char *SessionPinReason = NULL;
+static bool SessionPinReported = false;
+
 /* ----------------------------------------------------------------
  *		decls for routines only used in this file
  * ----------------------------------------------------------------
@@ -596,6 +601,26 @@ ProcessClientWriteInterrupt(bool blocked)
 	errno = save_errno;
 }
 
+/*
+ * PinPooledSession --- note that the session now has state that outlives
+ * the current transaction
+ *
+ * The connection proxy hands backends from one client session to another
+ * between transactions.  That is no longer possible once the session has
+ * created prepared statements or temporary tables, changed settings and so
+ * on, so we tell the proxy to keep the session on this backend, before the
+ * next ReadyForQuery.  "reason" must be a constant string.
+ */
+void
+PinPooledSession(const char *reason)
+{
+	if (MyProcPort == NULL || !MyProcPort->pooled || SessionPinReason != NULL)
+		return;
+
+	SessionPinReason = reason;
+	elog(DEBUG1, "pinning pooled session to its backend: %s", reason);
+}
+
 /*
  * Do raw parsing (only).
  *
@@ -2449,6 +2474,9 @@ start_xact_command(void)
 		else
 			disable_timeout(STATEMENT_TIMEOUT, false);
 
+		/* Likewise the sampling profiler */
+		profile_sampling_start();
+
 		xact_started = true;
 	}
 }
@@ -2460,6 +2488,7 @@ finish_xact_command(void)
 	{
 		/* Cancel any active statement timeout before committing */
 		disable_timeout(STATEMENT_TIMEOUT, false);
+		profile_sampling_stop();
 
 		/* Now commit the command */
 		ereport(DEBUG3,
@@ -2991,6 +3020,9 @@ ProcessInterrupts(void)
 
 	if (ParallelMessagePending)
 		HandleParallelMessages();
+
+	if (MemoryContextDumpPending)
+		ProcessMemoryContextDumpInterrupt();
 }
 
 
@@ -3682,21 +3714,27 @@ PostgresMain(int argc, char *argv[],
 		InitializeMaxBackends();
 	}
 
-	/* Early initialization */
-	BaseInit();
-
 	/*
-	 * Create a per-backend PGPROC struct in shared memory, except in the
-	 * EXEC_BACKEND case where this was done in SubPostmasterMain. We must do
-	 * this before we can use LWLocks (and in the EXEC_BACKEND case we already
-	 * had to do some stuff with LWLocks).
+	 * Early initialization.  A pre-forked backend did this, and the early
+	 * part of InitPostgres, before the postmaster handed it a connection.
 	 */
+	if (!IsPreforkedBackend)
+	{
+		BaseInit();
+
+		/*
+		 * Create a per-backend PGPROC struct in shared memory, except in the
+		 * EXEC_BACKEND case where this was done in SubPostmasterMain. We must
+		 * do this before we can use LWLocks (and in the EXEC_BACKEND case we
+		 * already had to do some stuff with LWLocks).
+		 */
 #ifdef EXEC_BACKEND
-	if (!IsUnderPostmaster)
-		InitProcess();
+		if (!IsUnderPostmaster)
+			InitProcess();
 #else
-	InitProcess();
+		InitProcess();
 #endif
+	}
 
 	/* We need to allow SIGINT, etc during the initial transaction */
 	PG_SETMASK(&UnBlockSig);
@@ -3966,6 +4004,22 @@ PostgresMain(int argc, char *argv[],
 				pgstat_report_activity(STATE_IDLE, NULL);
 			}
 
+			/*
+			 * The connection proxy learns about a pinned session from a
+			 * ParameterStatus message that it doesn't pass on to the client.
+			 */
+			if (SessionPinReason != NULL && !SessionPinReported &&
+				whereToSendOutput == DestRemote)
+			{
+				StringInfoData buf;
+
+				pq_beginmessage(&buf, 'S');
+				pq_sendstring(&buf, "session_pinned");
+				pq_sendstring(&buf, SessionPinReason);
+				pq_endmessage(&buf);
+				SessionPinReported = true;
+			}
+
 			ReadyForQuery(whereToSendOutput);
 			send_ready_for_query = false;
 		}
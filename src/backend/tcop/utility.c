@@ -44,9 +44,11 @@
 #include "commands/portalcmds.h"
 #include "commands/prepare.h"
 #include "commands/proclang.h"
+#include "commands/publicationcmds.h"
 #include "commands/schemacmds.h"
 #include "commands/seclabel.h"
 #include "commands/sequence.h"
+#include "commands/subscriptioncmds.h"
 #include "commands/tablecmds.h"
 #include "commands/tablespace.h"
 #include "commands/trigger.h"
@@ -171,6 +173,7 @@ check_xact_readonly(Node *parsetree)
 		case T_RuleStmt:
 		case T_CreateSchemaStmt:
 		case T_CreateSeqStmt:
+		case T_CreateStatsStmt:
 		case T_CreateStmt:
 		case T_CreateTableAsStmt:
 		case T_RefreshMatViewStmt:
@@ -197,6 +200,11 @@ check_xact_readonly(Node *parsetree)
 		case T_CreateExtensionStmt:
 		case T_AlterExtensionStmt:
 		case T_AlterExtensionContentsStmt:
+		case T_CreatePublicationStmt:
+		case T_AlterPublicationStmt:
+		case T_CreateSubscriptionStmt:
+		case T_AlterSubscriptionStmt:
+		case T_DropSubscriptionStmt:
 		case T_CreateFdwStmt:
 		case T_AlterFdwStmt:
 		case T_CreateForeignServerStmt:
@@ -530,6 +538,21 @@ standard_ProcessUtility(Node *parsetree,
 			AlterTableSpaceOptions((AlterTableSpaceOptionsStmt *) parsetree);
 			break;
 
+		case T_CreateSubscriptionStmt:
+			/* no event triggers for global objects */
+			CreateSubscription((CreateSubscriptionStmt *) parsetree);
+			break;
+
+		case T_AlterSubscriptionStmt:
+			/* no event triggers for global objects */
+			AlterSubscription((AlterSubscriptionStmt *) parsetree);
+			break;
+
+		case T_DropSubscriptionStmt:
+			/* no event triggers for global objects */
+			DropSubscription((DropSubscriptionStmt *) parsetree);
+			break;
+
 		case T_TruncateStmt:
 			ExecuteTruncate((TruncateStmt *) parsetree);
 			break;
@@ -1441,6 +1464,10 @@ ProcessUtilitySlow(Node *parsetree,
 				address = CreateTransform((CreateTransformStmt *) parsetree);
 				break;
 
+			case T_CreateStatsStmt:
+				address = CreateStatistics((CreateStatsStmt *) parsetree);
+				break;
+
 			case T_AlterOpFamilyStmt:
 				AlterOpFamily((AlterOpFamilyStmt *) parsetree);
 				/* commands are stashed in AlterOpFamily */
@@ -1511,6 +1538,14 @@ ProcessUtilitySlow(Node *parsetree,
 				address = AlterPolicy((AlterPolicyStmt *) parsetree);
 				break;
 
+			case T_CreatePublicationStmt:
+				address = CreatePublication((CreatePublicationStmt *) parsetree);
+				break;
+
+			case T_AlterPublicationStmt:
+				address = AlterPublication((AlterPublicationStmt *) parsetree);
+				break;
+
 			case T_SecLabelStmt:
 				address = ExecSecLabelStmt((SecLabelStmt *) parsetree);
 				break;
@@ -1827,6 +1862,9 @@ AlterObjectTypeCommandTag(ObjectType objtype)
 		case OBJECT_POLICY:
 			tag = "ALTER POLICY";
 			break;
+		case OBJECT_PUBLICATION:
+			tag = "ALTER PUBLICATION";
+			break;
 		case OBJECT_ROLE:
 			tag = "ALTER ROLE";
 			break;
@@ -1839,6 +1877,12 @@ AlterObjectTypeCommandTag(ObjectType objtype)
 		case OBJECT_SEQUENCE:
 			tag = "ALTER SEQUENCE";
 			break;
+		case OBJECT_STATISTIC_EXT:
+			tag = "ALTER STATISTICS";
+			break;
+		case OBJECT_SUBSCRIPTION:
+			tag = "ALTER SUBSCRIPTION";
+			break;
 		case OBJECT_TABLE:
 		case OBJECT_TABCONSTRAINT:
 			tag = "ALTER TABLE";
@@ -2107,6 +2151,9 @@ CreateCommandTag(Node *parsetree)
 				case OBJECT_TSCONFIGURATION:
 					tag = "DROP TEXT SEARCH CONFIGURATION";
 					break;
+				case OBJECT_STATISTIC_EXT:
+					tag = "DROP STATISTICS";
+					break;
 				case OBJECT_FOREIGN_TABLE:
 					tag = "DROP FOREIGN TABLE";
 					break;
@@ -2152,6 +2199,9 @@ CreateCommandTag(Node *parsetree)
 				case OBJECT_POLICY:
 					tag = "DROP POLICY";
 					break;
+				case OBJECT_PUBLICATION:
+					tag = "DROP PUBLICATION";
+					break;
 				case OBJECT_TRANSFORM:
 					tag = "DROP TRANSFORM";
 					break;
@@ -2284,6 +2334,10 @@ CreateCommandTag(Node *parsetree)
 			tag = "CREATE INDEX";
 			break;
 
+		case T_CreateStatsStmt:
+			tag = "CREATE STATISTICS";
+			break;
+
 		case T_RuleStmt:
 			tag = "CREATE RULE";
 			break;
@@ -2510,6 +2564,26 @@ CreateCommandTag(Node *parsetree)
 			tag = "ALTER POLICY";
 			break;
 
+		case T_CreatePublicationStmt:
+			tag = "CREATE PUBLICATION";
+			break;
+
+		case T_AlterPublicationStmt:
+			tag = "ALTER PUBLICATION";
+			break;
+
+		case T_CreateSubscriptionStmt:
+			tag = "CREATE SUBSCRIPTION";
+			break;
+
+		case T_AlterSubscriptionStmt:
+			tag = "ALTER SUBSCRIPTION";
+			break;
+
+		case T_DropSubscriptionStmt:
+			tag = "DROP SUBSCRIPTION";
+			break;
+
 		case T_PrepareStmt:
 			tag = "PREPARE";
 			break;
@@ -2864,6 +2938,10 @@ GetCommandLogLevel(Node *parsetree)
 			lev = LOGSTMT_DDL;
 			break;
 
+		case T_CreateStatsStmt:
+			lev = LOGSTMT_DDL;
+			break;
+
 		case T_RuleStmt:
 			lev = LOGSTMT_DDL;
 			break;
@@ -3059,6 +3137,14 @@ GetCommandLogLevel(Node *parsetree)
 			lev = LOGSTMT_DDL;
 			break;
 
+		case T_CreatePublicationStmt:
+		case T_AlterPublicationStmt:
+		case T_CreateSubscriptionStmt:
+		case T_AlterSubscriptionStmt:
+		case T_DropSubscriptionStmt:
+			lev = LOGSTMT_DDL;
+			break;
+
 		case T_AlterTSDictionaryStmt:
 			lev = LOGSTMT_DDL;
 			break;
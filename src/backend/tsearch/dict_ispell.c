@@ -13,9 +13,12 @@
  */
 #include "postgres.h"
 
+#include <sys/stat.h>
+
 #include "commands/defrem.h"
 #include "tsearch/dicts/spell.h"
 #include "tsearch/ts_locale.h"
+#include "tsearch/ts_shared.h"
 #include "tsearch/ts_utils.h"
 
 
@@ -25,54 +28,110 @@ typedef struct
 	IspellDict	obj;
 } DictISpell;
 
+/*
+ * Make the key under which a dictionary compiled from the given files is
+ * shared with other backends.  The files' modification times and sizes are
+ * included, so that a changed file is not taken to be the same dictionary.
+ */
+static char *
+ispell_shared_key(const char *dictfile, const char *afffile)
+{
+	struct stat dst,
+				ast;
+
+	if (stat(dictfile, &dst) != 0 || stat(afffile, &ast) != 0)
+		return NULL;
+
+	return psprintf("ispell:%s:%ld:" INT64_FORMAT ":%s:%ld:" INT64_FORMAT,
+					dictfile, (long) dst.st_mtime, (int64) dst.st_size,
+					afffile, (long) ast.st_mtime, (int64) ast.st_size);
+}
+
+/*
+ * Build the dictionary tree from dictfile, or map a copy another backend
+ * has built, and if we built it, offer it to other backends.
+ */
+static void
+ispell_load_dictionary(IspellDict *Conf, const char *dictfile,
+					   const char *afffile)
+{
+	char	   *key;
+	char	   *image;
+	char	   *dest;
+	dsm_segment *seg;
+
+	key = ispell_shared_key(dictfile, afffile);
+
+	if (key != NULL)
+	{
+		image = TSSharedDictFind(key, CurrentMemoryContext);
+		if (image != NULL)
+		{
+			NIDictionaryAttachShared(Conf, image);
+			return;
+		}
+	}
+
+	NIImportDictionary(Conf, dictfile);
+	NISortDictionary(Conf);
+
+	if (key == NULL)
+		return;
+
+	dest = TSSharedDictCreate(key, NIDictionarySharedSize(Conf), &seg);
+	if (dest == NULL)
+		return;
+
+	NIDictionaryWriteShared(Conf, dest);
+	TSSharedDictPublish(seg, CurrentMemoryContext);
+
+	/* Use the shared copy too, and release our private one */
+	if (Conf->DictArena != NULL)
+		pfree(Conf->DictArena);
+	NIDictionaryAttachShared(Conf, dest);
+}
+
 Datum
 dispell_init(PG_FUNCTION_ARGS)
 {
 	List	   *dictoptions = (List *) PG_GETARG_POINTER(0);
 	DictISpell *d;
-	bool		affloaded = false,
-				dictloaded = false,
-				stoploaded = false;
+	char	   *dictfile = NULL,
+			   *afffile = NULL,
+			   *stopfile = NULL;
 	ListCell   *l;
 
 	d = (DictISpell *) palloc0(sizeof(DictISpell));
 
-	NIStartBuild(&(d->obj));
-
 	foreach(l, dictoptions)
 	{
 		DefElem    *defel = (DefElem *) lfirst(l);
 
 		if (pg_strcasecmp(defel->defname, "DictFile") == 0)
 		{
-			if (dictloaded)
+			if (dictfile)
 				ereport(ERROR,
 						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 						 errmsg("multiple DictFile parameters")));
-			NIImportDictionary(&(d->obj),
-							 get_tsearch_config_filename(defGetString(defel),
-														 "dict"));
-			dictloaded = true;
+			dictfile = get_tsearch_config_filename(defGetString(defel),
+												   "dict");
 		}
 		else if (pg_strcasecmp(defel->defname, "AffFile") == 0)
 		{
-			if (affloaded)
+			if (afffile)
 				ereport(ERROR,
 						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 						 errmsg("multiple AffFile parameters")));
-			NIImportAffixes(&(d->obj),
-							get_tsearch_config_filename(defGetString(defel),
-														"affix"));
-			affloaded = true;
+			afffile = get_tsearch_config_filename(defGetString(defel),
+												  "affix");
 		}
 		else if (pg_strcasecmp(defel->defname, "StopWords") == 0)
 		{
-			if (stoploaded)
+			if (stopfile)
 				ereport(ERROR,
 						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 						 errmsg("multiple StopWords parameters")));
-			readstoplist(defGetString(defel), &(d->stoplist), lowerstr);
-			stoploaded = true;
+			stopfile = defGetString(defel);
 		}
 		else
 		{
@@ -83,26 +142,34 @@ dispell_init(PG_FUNCTION_ARGS)
 		}
 	}
 
-	if (affloaded && dictloaded)
-	{
-		NISortDictionary(&(d->obj));
-		NISortAffixes(&(d->obj));
-	}
-	else if (!affloaded)
+	if (!afffile)
 	{
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("missing AffFile parameter")));
 	}
-	else
+	else if (!dictfile)
 	{
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("missing DictFile parameter")));
 	}
 
+	NIStartBuild(&(d->obj));
+
+	/*
+	 * The affix file must be loaded first: the dictionary tree, whether
+	 * built here or shared, refers to the flags it defines.
+	 */
+	NIImportAffixes(&(d->obj), afffile);
+	ispell_load_dictionary(&(d->obj), dictfile, afffile);
+	NISortAffixes(&(d->obj));
+
 	NIFinishBuild(&(d->obj));
 
+	if (stopfile)
+		readstoplist(stopfile, &(d->stoplist), lowerstr);
+
 	PG_RETURN_POINTER(d);
 }
 
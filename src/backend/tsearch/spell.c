@@ -371,7 +371,7 @@ FindWord(IspellDict *Conf, const char *word, int affixflag, int flag)
 					if ((affixflag == 0) || (strchr(Conf->AffixData[StopMiddle->affix], affixflag) != NULL))
 						return 1;
 				}
-				node = StopMiddle->node;
+				node = SPNodeAt(Conf, StopMiddle->node);
 				ptr++;
 				break;
 			}
@@ -1092,16 +1092,66 @@ makeCompoundFlags(IspellDict *Conf, int affix)
 	return (flag & FF_DICTFLAGMASK);
 }
 
-static SPNode *
+/*
+ * Allocate size bytes, zeroed, in the dictionary tree's arena, returning the
+ * offset of the new space.  The arena is enlarged as needed, which moves
+ * it, so callers must not hold pointers into it across calls.
+ */
+static uint32
+dict_arena_alloc(IspellDict *Conf, Size size)
+{
+	Size		result;
+
+	size = MAXALIGN(size);
+
+	if (Conf->DictArena == NULL)
+	{
+		Conf->lenDictArena = 65536;
+		Conf->DictArena = palloc0(Conf->lenDictArena);
+		/* Reserve offset 0, so that it can mean "no node" */
+		Conf->usedDictArena = MAXALIGN(1);
+	}
+
+	if (Conf->usedDictArena + size > Conf->lenDictArena)
+	{
+		Size		newlen = Conf->lenDictArena;
+
+		while (Conf->usedDictArena + size > newlen)
+			newlen *= 2;
+		if (newlen > PG_UINT32_MAX)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("ispell dictionary is too large")));
+		Conf->DictArena = repalloc_huge(Conf->DictArena, newlen);
+		memset(Conf->DictArena + Conf->lenDictArena, 0,
+			   newlen - Conf->lenDictArena);
+		Conf->lenDictArena = newlen;
+	}
+
+	result = Conf->usedDictArena;
+	Conf->usedDictArena += size;
+
+	return (uint32) result;
+}
+
+/*
+ * Build the subtree for Spell[low..high-1] at the given level, returning
+ * its arena offset, or 0 if there is nothing at this level.
+ */
+static uint32
 mkSPNode(IspellDict *Conf, int low, int high, int level)
 {
 	int			i;
 	int			nchar = 0;
 	char		lastchar = '\0';
-	SPNode	   *rs;
-	SPNodeData *data;
+	uint32		rs;
+	int			d;
+	uint32		child;
 	int			lownew = low;
 
+	/* The arena can move during recursion; re-derive pointers into it */
+#define CURDATA (&SPNodeAt(Conf, rs)->data[d])
+
 	for (i = low; i < high; i++)
 		if (Conf->Spell[i]->p.d.len > level && lastchar != Conf->Spell[i]->word[level])
 		{
@@ -1110,11 +1160,11 @@ mkSPNode(IspellDict *Conf, int low, int high, int level)
 		}
 
 	if (!nchar)
-		return NULL;
+		return 0;
 
-	rs = (SPNode *) cpalloc0(SPNHDRSZ + nchar * sizeof(SPNodeData));
-	rs->length = nchar;
-	data = rs->data;
+	rs = dict_arena_alloc(Conf, SPNHDRSZ + nchar * sizeof(SPNodeData));
+	SPNodeAt(Conf, rs)->length = nchar;
+	d = 0;
 
 	lastchar = '\0';
 	for (i = low; i < high; i++)
@@ -1124,15 +1174,17 @@ mkSPNode(IspellDict *Conf, int low, int high, int level)
 			{
 				if (lastchar)
 				{
-					data->node = mkSPNode(Conf, lownew, i, level + 1);
+					child = mkSPNode(Conf, lownew, i, level + 1);
+					CURDATA->node = child;
 					lownew = i;
-					data++;
+					d++;
 				}
 				lastchar = Conf->Spell[i]->word[level];
 			}
-			data->val = ((uint8 *) (Conf->Spell[i]->word))[level];
+			CURDATA->val = ((uint8 *) (Conf->Spell[i]->word))[level];
 			if (Conf->Spell[i]->p.d.len == level + 1)
 			{
+				SPNodeData *data = CURDATA;
 				bool		clearCompoundOnly = false;
 
 				if (data->isword && data->affix != Conf->Spell[i]->p.d.affix)
@@ -1163,7 +1215,10 @@ mkSPNode(IspellDict *Conf, int low, int high, int level)
 			}
 		}
 
-	data->node = mkSPNode(Conf, lownew, high, level + 1);
+	child = mkSPNode(Conf, lownew, high, level + 1);
+	CURDATA->node = child;
+
+#undef CURDATA
 
 	return rs;
 }
@@ -1178,6 +1233,7 @@ NISortDictionary(IspellDict *Conf)
 	int			i;
 	int			naffix = 0;
 	int			curaffix;
+	uint32		root;
 
 	/* compress affixes */
 
@@ -1216,7 +1272,98 @@ NISortDictionary(IspellDict *Conf)
 	Conf->lenAffixData = Conf->nAffixData = naffix;
 
 	qsort((void *) Conf->Spell, Conf->nspell, sizeof(SPELL *), cmpspell);
-	Conf->Dictionary = mkSPNode(Conf, 0, Conf->nspell, 0);
+	root = mkSPNode(Conf, 0, Conf->nspell, 0);
+
+	/* Give back the arena's unused tail */
+	if (Conf->DictArena != NULL)
+	{
+		Conf->DictArena = repalloc_huge(Conf->DictArena, Conf->usedDictArena);
+		Conf->lenDictArena = Conf->usedDictArena;
+	}
+	Conf->Dictionary = SPNodeAt(Conf, root);
+}
+
+/*
+ * Shared copies of a dictionary tree.
+ *
+ * Once NISortDictionary has built the tree, NIDictionaryWriteShared can copy
+ * it and the AffixData strings it refers to into a flat image of
+ * NIDictionarySharedSize bytes.  NIDictionaryAttachShared sets up another
+ * IspellDict, which has imported the same affix file but not the dictionary
+ * file, to use such an image in place of building its own tree.  The image
+ * must stay mapped, read-only, for as long as the dictionary is used.
+ */
+typedef struct
+{
+	Size		arenalen;		/* length of the tree arena */
+	uint32		root;			/* arena offset of the root node, or 0 */
+	int			nAffixData;		/* number of AffixData strings */
+	/* then the tree arena, then the offsets of nAffixData strings */
+} SharedDictHeader;
+
+#define SHAREDDICTHDRSZ		MAXALIGN(sizeof(SharedDictHeader))
+
+Size
+NIDictionarySharedSize(IspellDict *Conf)
+{
+	Size		size;
+	int			i;
+
+	size = SHAREDDICTHDRSZ + MAXALIGN(Conf->usedDictArena);
+	size += MAXALIGN(Conf->nAffixData * sizeof(Size));
+	for (i = 0; i < Conf->nAffixData; i++)
+		size += strlen(Conf->AffixData[i]) + 1;
+
+	return size;
+}
+
+void
+NIDictionaryWriteShared(IspellDict *Conf, char *dest)
+{
+	SharedDictHeader *hdr = (SharedDictHeader *) dest;
+	Size	   *stroffs;
+	Size		off;
+	int			i;
+
+	hdr->arenalen = Conf->usedDictArena;
+	hdr->root = (Conf->Dictionary != NULL) ?
+		(uint32) ((char *) Conf->Dictionary - Conf->DictArena) : 0;
+	hdr->nAffixData = Conf->nAffixData;
+
+	off = SHAREDDICTHDRSZ;
+	if (Conf->usedDictArena > 0)
+		memcpy(dest + off, Conf->DictArena, Conf->usedDictArena);
+	off += MAXALIGN(Conf->usedDictArena);
+
+	stroffs = (Size *) (dest + off);
+	off += MAXALIGN(Conf->nAffixData * sizeof(Size));
+	for (i = 0; i < Conf->nAffixData; i++)
+	{
+		Size		len = strlen(Conf->AffixData[i]) + 1;
+
+		stroffs[i] = off;
+		memcpy(dest + off, Conf->AffixData[i], len);
+		off += len;
+	}
+	Assert(off == NIDictionarySharedSize(Conf));
+}
+
+void
+NIDictionaryAttachShared(IspellDict *Conf, char *src)
+{
+	SharedDictHeader *hdr = (SharedDictHeader *) src;
+	Size	   *stroffs;
+	int			i;
+
+	Conf->DictArena = src + SHAREDDICTHDRSZ;
+	Conf->lenDictArena = Conf->usedDictArena = hdr->arenalen;
+	Conf->Dictionary = SPNodeAt(Conf, hdr->root);
+
+	stroffs = (Size *) (src + SHAREDDICTHDRSZ + MAXALIGN(hdr->arenalen));
+	Conf->AffixData = (char **) palloc(Max(hdr->nAffixData, 1) * sizeof(char *));
+	for (i = 0; i < hdr->nAffixData; i++)
+		Conf->AffixData[i] = src + stroffs[i];
+	Conf->lenAffixData = Conf->nAffixData = hdr->nAffixData;
 }
 
 static AffixNode *
@@ -1874,7 +2021,7 @@ SplitToVariants(IspellDict *Conf, SPNode *snode, SplitVar *orig, char *word, int
 					}
 				}
 			}
-			node = StopMiddle->node;
+			node = SPNodeAt(Conf, StopMiddle->node);
 		}
 		else
 			node = NULL;
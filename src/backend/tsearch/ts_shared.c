@@ -0,0 +1,379 @@
+/*-------------------------------------------------------------------------
+ *
+ * ts_shared.c
+ *	  Sharing of compiled text search dictionaries between backends.
+ *
+ * Some dictionaries, Ispell ones in particular, take seconds and tens of
+ * megabytes to build from their files, and every backend used to build its
+ * own copy on first use.  A dictionary template can instead lay out the
+ * expensive part of its compiled form as a position-independent image in a
+ * dynamic shared memory segment, and publish it here under a key that
+ * identifies the files and settings it was built from.  Other backends
+ * that need the same dictionary find the segment by key and map it
+ * read-only rather than building their own.
+ *
+ * The directory of published segments is a small fixed array in the main
+ * shared memory segment, protected by TSSharedDictLock.  The images
+ * themselves live in DSM segments, which exist as long as some backend has
+ * them mapped: each backend keeps a mapping for as long as a dictionary in
+ * its cache uses it.  A directory slot can therefore name a segment that
+ * has since gone away, or (after handle reuse) a different segment; every
+ * segment starts with a header repeating its key, which is checked on
+ * attach, and a failed attach just makes the caller build and publish the
+ * dictionary afresh.  When the directory is full, the least recently used
+ * slot is taken over.
+ *
+ * Since dictionary files are converted to the database encoding and case-
+ * folded according to LC_CTYPE while they are compiled, the encoding and
+ * LC_CTYPE are made part of every key.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/tsearch/ts_shared.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <locale.h>
+
+#include "access/hash.h"
+#include "mb/pg_wchar.h"
+#include "nodes/pg_list.h"
+#include "storage/dsm_impl.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "tsearch/ts_shared.h"
+#include "utils/memutils.h"
+
+
+/* Number of dictionary images the directory can track */
+#define TS_SHARED_DICT_SLOTS	64
+
+#define TS_SHARED_DICT_MAGIC	0x54534431	/* "TSD1" */
+
+typedef struct TSSharedDictSlot
+{
+	bool		in_use;
+	uint32		keyhash;		/* hash of the full key */
+	dsm_handle	handle;			/* segment holding the image */
+	uint64		lastused;		/* value of counter when last used */
+} TSSharedDictSlot;
+
+typedef struct TSSharedDictDirectory
+{
+	uint64		counter;		/* advanced on every use of a slot */
+	TSSharedDictSlot slots[TS_SHARED_DICT_SLOTS];
+} TSSharedDictDirectory;
+
+/* Header at the start of each image segment */
+typedef struct TSSharedDictHeader
+{
+	uint32		magic;
+	int			keylen;			/* length of the full key that follows */
+	Size		dataoff;		/* offset of the image data */
+	/* full key follows, then the image data at dataoff */
+} TSSharedDictHeader;
+
+/*
+ * A backend keeps one mapping per segment, however many of its cached
+ * dictionaries use it; this counts the users.
+ */
+typedef struct TSSharedDictMapping
+{
+	dsm_segment *seg;
+	int			refcount;
+} TSSharedDictMapping;
+
+/* A reset callback registered in each user's memory context */
+typedef struct TSSharedDictRef
+{
+	MemoryContextCallback cb;
+	TSSharedDictMapping *mapping;
+} TSSharedDictRef;
+
+/* GUC parameter */
+bool		shared_ts_dictionaries = true;
+
+static TSSharedDictDirectory *TSSharedDict = NULL;
+
+/* This backend's mappings, in TopMemoryContext */
+static List *local_mappings = NIL;
+
+
+/*
+ * Report shared-memory space needed by TSSharedDictShmemInit
+ */
+Size
+TSSharedDictShmemSize(void)
+{
+	return sizeof(TSSharedDictDirectory);
+}
+
+/*
+ * Allocate and initialize the dictionary directory
+ */
+void
+TSSharedDictShmemInit(void)
+{
+	bool		found;
+
+	TSSharedDict = (TSSharedDictDirectory *)
+		ShmemInitStruct("Text Search Dictionary Directory",
+						TSSharedDictShmemSize(), &found);
+	if (!found)
+		MemSet(TSSharedDict, 0, TSSharedDictShmemSize());
+}
+
+/*
+ * Is sharing possible and wanted?
+ */
+static bool
+shared_dicts_enabled(void)
+{
+	return shared_ts_dictionaries && TSSharedDict != NULL &&
+		dynamic_shared_memory_type != DSM_IMPL_NONE;
+}
+
+/*
+ * Make the full key for a caller's key, by adding the settings that
+ * influence how dictionary files are compiled.
+ */
+static char *
+make_full_key(const char *key)
+{
+	const char *ctype = setlocale(LC_CTYPE, NULL);
+
+	return psprintf("%d/%s/%s", GetDatabaseEncoding(),
+					ctype ? ctype : "", key);
+}
+
+static uint32
+hash_full_key(const char *fullkey)
+{
+	return DatumGetUInt32(hash_any((const unsigned char *) fullkey,
+								   strlen(fullkey)));
+}
+
+/*
+ * Memory context reset callback: drop one user of a mapping, and unmap
+ * the segment if that was the last.
+ */
+static void
+TSSharedDictRelease(void *arg)
+{
+	TSSharedDictMapping *mapping = (TSSharedDictMapping *) arg;
+
+	if (--mapping->refcount > 0)
+		return;
+
+	local_mappings = list_delete_ptr(local_mappings, mapping);
+	dsm_detach(mapping->seg);
+	pfree(mapping);
+}
+
+/*
+ * Record that the dictionary whose memory is in owner uses seg, so that
+ * the segment stays mapped until owner is reset or deleted.  seg must
+ * already be mapped, and if this is its first user, pinned.
+ */
+static void
+TSSharedDictAddRef(dsm_segment *seg, MemoryContext owner)
+{
+	TSSharedDictMapping *mapping = NULL;
+	TSSharedDictRef *ref;
+	ListCell   *lc;
+
+	foreach(lc, local_mappings)
+	{
+		TSSharedDictMapping *m = (TSSharedDictMapping *) lfirst(lc);
+
+		if (m->seg == seg)
+		{
+			mapping = m;
+			break;
+		}
+	}
+
+	if (mapping == NULL)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+		mapping = (TSSharedDictMapping *) palloc(sizeof(TSSharedDictMapping));
+		mapping->seg = seg;
+		mapping->refcount = 0;
+		local_mappings = lappend(local_mappings, mapping);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	ref = (TSSharedDictRef *) MemoryContextAlloc(owner,
+												 sizeof(TSSharedDictRef));
+	ref->mapping = mapping;
+	ref->cb.func = TSSharedDictRelease;
+	ref->cb.arg = mapping;
+	MemoryContextRegisterResetCallback(owner, &ref->cb);
+	mapping->refcount++;
+}
+
+/*
+ * TSSharedDictFind
+ *		Look for a published dictionary image with the given key.
+ *
+ * Returns the address of the image, which stays mapped until owner is
+ * reset or deleted, or NULL if there is none (or sharing is disabled).
+ */
+char *
+TSSharedDictFind(const char *key, MemoryContext owner)
+{
+	char	   *fullkey;
+	uint32		keyhash;
+	dsm_handle	handle = 0;
+	bool		found = false;
+	dsm_segment *seg;
+	TSSharedDictHeader *hdr;
+	int			i;
+
+	if (!shared_dicts_enabled())
+		return NULL;
+
+	fullkey = make_full_key(key);
+	keyhash = hash_full_key(fullkey);
+
+	LWLockAcquire(TSSharedDictLock, LW_EXCLUSIVE);
+	for (i = 0; i < TS_SHARED_DICT_SLOTS; i++)
+	{
+		TSSharedDictSlot *slot = &TSSharedDict->slots[i];
+
+		if (slot->in_use && slot->keyhash == keyhash)
+		{
+			handle = slot->handle;
+			slot->lastused = ++TSSharedDict->counter;
+			found = true;
+			break;
+		}
+	}
+	LWLockRelease(TSSharedDictLock);
+
+	if (!found)
+		return NULL;
+
+	/* We may have mapped it already, for another dictionary */
+	seg = dsm_find_mapping(handle);
+	if (seg == NULL)
+	{
+		seg = dsm_attach(handle);
+		if (seg == NULL)
+			return NULL;		/* every user is gone, and so is the image */
+		hdr = (TSSharedDictHeader *) dsm_segment_address(seg);
+		if (hdr->magic != TS_SHARED_DICT_MAGIC ||
+			hdr->keylen != strlen(fullkey) ||
+			memcmp((char *) hdr + sizeof(TSSharedDictHeader), fullkey,
+				   hdr->keylen) != 0)
+		{
+			/* handle has been reused for something else */
+			dsm_detach(seg);
+			return NULL;
+		}
+		dsm_pin_mapping(seg);
+	}
+	else
+	{
+		hdr = (TSSharedDictHeader *) dsm_segment_address(seg);
+		if (hdr->magic != TS_SHARED_DICT_MAGIC ||
+			hdr->keylen != strlen(fullkey) ||
+			memcmp((char *) hdr + sizeof(TSSharedDictHeader), fullkey,
+				   hdr->keylen) != 0)
+			return NULL;
+	}
+
+	TSSharedDictAddRef(seg, owner);
+
+	return (char *) hdr + hdr->dataoff;
+}
+
+/*
+ * TSSharedDictCreate
+ *		Make a segment for a dictionary image of the given size and key.
+ *
+ * Returns the address at which the caller is to write the image, and the
+ * segment in *segp; once the image is complete, pass the segment to
+ * TSSharedDictPublish.  If the transaction aborts first, the segment goes
+ * away.  Returns NULL if sharing is disabled or no segment is available.
+ */
+char *
+TSSharedDictCreate(const char *key, Size size, dsm_segment **segp)
+{
+	char	   *fullkey;
+	Size		keylen;
+	Size		dataoff;
+	dsm_segment *seg;
+	TSSharedDictHeader *hdr;
+
+	*segp = NULL;
+	if (!shared_dicts_enabled())
+		return NULL;
+
+	fullkey = make_full_key(key);
+	keylen = strlen(fullkey);
+	dataoff = MAXALIGN(sizeof(TSSharedDictHeader) + keylen);
+
+	seg = dsm_create(add_size(dataoff, size), DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (seg == NULL)
+		return NULL;
+
+	hdr = (TSSharedDictHeader *) dsm_segment_address(seg);
+	hdr->magic = TS_SHARED_DICT_MAGIC;
+	hdr->keylen = keylen;
+	hdr->dataoff = dataoff;
+	memcpy((char *) hdr + sizeof(TSSharedDictHeader), fullkey, keylen);
+
+	*segp = seg;
+	return (char *) hdr + dataoff;
+}
+
+/*
+ * TSSharedDictPublish
+ *		Make a completed image available to other backends.
+ *
+ * The segment stays mapped in this backend until owner is reset or deleted.
+ */
+void
+TSSharedDictPublish(dsm_segment *seg, MemoryContext owner)
+{
+	TSSharedDictHeader *hdr = (TSSharedDictHeader *) dsm_segment_address(seg);
+	char	   *fullkey;
+	uint32		keyhash;
+	TSSharedDictSlot *victim = NULL;
+	int			i;
+
+	dsm_pin_mapping(seg);
+	TSSharedDictAddRef(seg, owner);
+
+	fullkey = pnstrdup((char *) hdr + sizeof(TSSharedDictHeader), hdr->keylen);
+	keyhash = hash_full_key(fullkey);
+	pfree(fullkey);
+
+	LWLockAcquire(TSSharedDictLock, LW_EXCLUSIVE);
+	for (i = 0; i < TS_SHARED_DICT_SLOTS; i++)
+	{
+		TSSharedDictSlot *slot = &TSSharedDict->slots[i];
+
+		/* A slot with the same key is stale, or else we'd have used it */
+		if (slot->in_use && slot->keyhash == keyhash)
+		{
+			victim = slot;
+			break;
+		}
+		if (victim == NULL ||
+			(victim->in_use &&
+			 (!slot->in_use || slot->lastused < victim->lastused)))
+			victim = slot;
+	}
+	victim->in_use = true;
+	victim->keyhash = keyhash;
+	victim->handle = dsm_segment_handle(seg);
+	victim->lastused = ++TSSharedDict->counter;
+	LWLockRelease(TSSharedDictLock);
+}
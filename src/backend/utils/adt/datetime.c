@@ -749,6 +749,148 @@ ParseDateTime(const char *timestr, char *workbuf, size_t buflen,
 }
 
 
+/* Fetch exactly ndigits decimal digits at *cp, advancing *cp past them */
+static inline bool
+ParseISODigits(const char **cp, int ndigits, int *result)
+{
+	const char *p = *cp;
+	int			val = 0;
+
+	while (ndigits-- > 0)
+	{
+		if (!isdigit((unsigned char) *p))
+			return false;
+		val = val * 10 + (*p++ - '0');
+	}
+	*cp = p;
+	*result = val;
+	return true;
+}
+
+/* ParseISODateTime()
+ *	Fast path for the plain ISO 8601 date/time format.
+ *
+ *		External format:
+ *				"YYYY-MM-DD[( |T)HH:MM[:SS[.ffffff]][(+|-)HH[[:]MM]]]"
+ *
+ * This is what the output functions produce with DateStyle ISO, so it is by
+ * far the most common input; recognizing it directly saves the tokenizing
+ * and keyword lookups of ParseDateTime/DecodeDateTime.  Returns true, with
+ * *tm and *fsec filled in, if str is in exactly this format and every field
+ * is in range.  Anything else, including an out-of-range field, returns
+ * false and the caller must fall back to the general parser, which also
+ * produces the error reports.  So this must never accept an input that
+ * DecodeDateTime would interpret differently.
+ *
+ * If tzp isn't NULL, *tzp is set to the given zone offset, or failing that
+ * to the session time zone's offset, just as DecodeDateTime does.
+ */
+bool
+ParseISODateTime(const char *str, struct pg_tm * tm, fsec_t *fsec, int *tzp)
+{
+	const char *cp = str;
+	int			hour = 0,
+				min = 0,
+				sec = 0,
+				usec = 0;
+	bool		have_tz = false;
+	int			tz = 0;
+
+	if (!ParseISODigits(&cp, 4, &tm->tm_year) || *cp++ != '-' ||
+		!ParseISODigits(&cp, 2, &tm->tm_mon) || *cp++ != '-' ||
+		!ParseISODigits(&cp, 2, &tm->tm_mday))
+		return false;
+
+	if (tm->tm_year < 1 ||
+		tm->tm_mon < 1 || tm->tm_mon > MONTHS_PER_YEAR ||
+		tm->tm_mday < 1 ||
+		tm->tm_mday > day_tab[isleap(tm->tm_year)][tm->tm_mon - 1])
+		return false;
+
+	if (*cp == ' ' || *cp == 'T')
+	{
+		cp++;
+		if (!ParseISODigits(&cp, 2, &hour) || *cp++ != ':' ||
+			!ParseISODigits(&cp, 2, &min))
+			return false;
+
+		if (*cp == ':')
+		{
+			cp++;
+			if (!ParseISODigits(&cp, 2, &sec))
+				return false;
+
+			if (*cp == '.')
+			{
+				int			ndigits = 0;
+
+				/* more than microsecond precision needs rounding: punt */
+				cp++;
+				while (isdigit((unsigned char) *cp) && ndigits < 6)
+				{
+					usec = usec * 10 + (*cp++ - '0');
+					ndigits++;
+				}
+				if (ndigits == 0 || isdigit((unsigned char) *cp))
+					return false;
+				while (ndigits++ < 6)
+					usec *= 10;
+			}
+		}
+
+		/* leave hour 24 and leap seconds to the general code */
+		if (hour >= HOURS_PER_DAY || min >= MINS_PER_HOUR ||
+			sec >= SECS_PER_MINUTE)
+			return false;
+
+		/* numeric zone offset, as DecodeTimezone would read it */
+		if (*cp == '+' || *cp == '-')
+		{
+			bool		west = (*cp++ == '-');
+			int			tzhour;
+			int			tzmin = 0;
+
+			if (!ParseISODigits(&cp, 2, &tzhour))
+				return false;
+			if (*cp == ':')
+			{
+				cp++;
+				if (!ParseISODigits(&cp, 2, &tzmin))
+					return false;
+			}
+			else if (isdigit((unsigned char) *cp) &&
+					 !ParseISODigits(&cp, 2, &tzmin))
+				return false;
+			if (tzhour > MAX_TZDISP_HOUR || tzmin >= MINS_PER_HOUR)
+				return false;
+
+			tz = (tzhour * MINS_PER_HOUR + tzmin) * SECS_PER_MINUTE;
+			if (!west)
+				tz = -tz;
+			have_tz = true;
+		}
+	}
+
+	if (*cp != '\0')
+		return false;
+
+	tm->tm_hour = hour;
+	tm->tm_min = min;
+	tm->tm_sec = sec;
+	tm->tm_isdst = -1;
+#ifdef HAVE_INT64_TIMESTAMP
+	*fsec = usec;
+#else
+	*fsec = (double) usec / 1000000.0;
+#endif
+
+	if (tzp != NULL)
+		*tzp = have_tz ? tz : DetermineTimeZoneOffset(tm, session_timezone);
+
+	return true;
+}
+
+
 /* DecodeDateTime()
  * Interpret previously parsed fields for general date and time.
  * Return 0 if full date, 1 if only time, and negative DTERR code if problems.
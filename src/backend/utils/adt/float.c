@@ -20,6 +20,7 @@
 #include <limits.h>
 
 #include "catalog/pg_type.h"
+#include "common/shortest_dec.h"
 #include "libpq/pqformat.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
@@ -350,6 +351,24 @@ float4out(PG_FUNCTION_ARGS)
 			{
 				int			ndig = FLT_DIG + extra_float_digits;
 
+				/*
+				 * With extra_float_digits > 0, emit the shortest output that
+				 * reads back as exactly the same value.  By default, take
+				 * the shortest output when it has no more than FLT_DIG
+				 * digits: it is then exactly what %.6g would print, except
+				 * for subnormal values, whose reduced precision breaks that
+				 * equivalence.
+				 */
+				if (extra_float_digits > 0)
+				{
+					float_to_shortest_decimal_buf(num, ascii);
+					break;
+				}
+				if (extra_float_digits == 0 &&
+					(num == 0 || fabs(num) >= FLT_MIN) &&
+					float_to_limited_decimal_buf(num, FLT_DIG, ascii) >= 0)
+					break;
+
 				if (ndig < 1)
 					ndig = 1;
 
@@ -530,29 +549,58 @@ float8out(PG_FUNCTION_ARGS)
 	float8		num = PG_GETARG_FLOAT8(0);
 	char	   *ascii = (char *) palloc(MAXDOUBLEWIDTH + 1);
 
+	float8out_internal(num, ascii, MAXDOUBLEWIDTH + 1);
+
+	PG_RETURN_CSTRING(ascii);
+}
+
+/*
+ *		float8out_internal	- float8out's work, writing into the caller's
+ *							  buffer of the given size
+ *
+ * printtup uses this to write text output straight into the DataRow message.
+ */
+void
+float8out_internal(float8 num, char *ascii, size_t size)
+{
 	if (isnan(num))
-		PG_RETURN_CSTRING(strcpy(ascii, "NaN"));
+	{
+		strlcpy(ascii, "NaN", size);
+		return;
+	}
 
 	switch (is_infinite(num))
 	{
 		case 1:
-			strcpy(ascii, "Infinity");
+			strlcpy(ascii, "Infinity", size);
 			break;
 		case -1:
-			strcpy(ascii, "-Infinity");
+			strlcpy(ascii, "-Infinity", size);
 			break;
 		default:
 			{
 				int			ndig = DBL_DIG + extra_float_digits;
 
+				/* See comments in float4out */
+				if (size >= DOUBLE_SHORTEST_DECIMAL_LEN)
+				{
+					if (extra_float_digits > 0)
+					{
+						double_to_shortest_decimal_buf(num, ascii);
+						break;
+					}
+					if (extra_float_digits == 0 &&
+						(num == 0 || fabs(num) >= DBL_MIN) &&
+						double_to_limited_decimal_buf(num, DBL_DIG, ascii) >= 0)
+						break;
+				}
+
 				if (ndig < 1)
 					ndig = 1;
 
-				snprintf(ascii, MAXDOUBLEWIDTH + 1, "%.*g", ndig, num);
+				snprintf(ascii, size, "%.*g", ndig, num);
 			}
 	}
-
-	PG_RETURN_CSTRING(ascii);
 }
 
 /*
@@ -1855,6 +1903,64 @@ float8_accum(PG_FUNCTION_ARGS)
 	}
 }
 
+/*
+ * float8_combine
+ *
+ * Combine function for the float8 accumulators: merge two {N, sumX, sumX2}
+ * transition arrays by adding them up component-wise.
+ */
+Datum
+float8_combine(PG_FUNCTION_ARGS)
+{
+	ArrayType  *transarray1 = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *transarray2 = PG_GETARG_ARRAYTYPE_P(1);
+	float8	   *transvalues1;
+	float8	   *transvalues2;
+	float8		N,
+				sumX,
+				sumX2;
+
+	transvalues1 = check_float8_array(transarray1, "float8_combine", 3);
+	transvalues2 = check_float8_array(transarray2, "float8_combine", 3);
+
+	N = transvalues1[0] + transvalues2[0];
+	sumX = transvalues1[1] + transvalues2[1];
+	CHECKFLOATVAL(sumX, isinf(transvalues1[1]) || isinf(transvalues2[1]),
+				  true);
+	sumX2 = transvalues1[2] + transvalues2[2];
+	CHECKFLOATVAL(sumX2, isinf(transvalues1[2]) || isinf(transvalues2[2]),
+				  true);
+
+	/*
+	 * If we're invoked as an aggregate, we can cheat and modify our first
+	 * parameter in-place to reduce palloc overhead. Otherwise we construct a
+	 * new array with the updated transition data and return it.
+	 */
+	if (AggCheckCallContext(fcinfo, NULL))
+	{
+		transvalues1[0] = N;
+		transvalues1[1] = sumX;
+		transvalues1[2] = sumX2;
+
+		PG_RETURN_ARRAYTYPE_P(transarray1);
+	}
+	else
+	{
+		Datum		transdatums[3];
+		ArrayType  *result;
+
+		transdatums[0] = Float8GetDatumFast(N);
+		transdatums[1] = Float8GetDatumFast(sumX);
+		transdatums[2] = Float8GetDatumFast(sumX2);
+
+		result = construct_array(transdatums, 3,
+								 FLOAT8OID,
+								 sizeof(float8), FLOAT8PASSBYVAL, 'd');
+
+		PG_RETURN_ARRAYTYPE_P(result);
+	}
+}
+
 Datum
 float4_accum(PG_FUNCTION_ARGS)
 {
@@ -0,0 +1,278 @@
+/*-------------------------------------------------------------------------
+ *
+ * hllfuncs.c
+ *	  Approximate distinct counting with HyperLogLog sketches.
+ *
+ * approx_count_distinct() estimates count(DISTINCT x) in a fixed amount of
+ * memory per group, without sorting its input.  Its transition state is a
+ * HyperLogLog sketch kept in a bytea, which makes the state both combinable
+ * (so the aggregate can be computed in partial and combining steps) and
+ * storable: hll_sketch_agg() returns the sketch itself, hll_union_agg()
+ * merges stored sketches, and hll_cardinality() gives the estimate for a
+ * sketch.  So for example daily sketches can be stored and rolled up into
+ * weekly distinct counts later.
+ *
+ * A sketch is a format version byte, the precision (the number of hash bits
+ * used to choose a register, between 4 and 16), and then 2 ^ precision
+ * one-byte registers.  The standard error of an estimate is about
+ * 1.04 / sqrt(2 ^ precision); the default precision of 12 gives about 1.6%
+ * in 4kB.  Only sketches of the same precision can be merged.  Elements are
+ * hashed with their type's hash opclass function, so sketches built from
+ * different data types cannot be meaningfully merged, and since those hash
+ * values are 32 bits wide, estimates well beyond 10^9 lose accuracy.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/hllfuncs.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "fmgr.h"
+#include "lib/hyperloglog.h"
+#include "utils/builtins.h"
+#include "utils/typcache.h"
+
+
+#define HLL_SKETCH_VERSION		1
+#define HLL_SKETCH_HDRSZ		2		/* version and precision bytes */
+
+#define HLL_MIN_PRECISION		4
+#define HLL_MAX_PRECISION		16
+#define HLL_DEFAULT_PRECISION	12
+
+#define HLL_SKETCH_PRECISION(s)	(((uint8 *) VARDATA(s))[1])
+#define HLL_SKETCH_REGISTERS(s)	(((uint8 *) VARDATA(s)) + HLL_SKETCH_HDRSZ)
+
+/* Hash function lookup data, cached in fn_extra of the transition function */
+typedef struct HLLHashCache
+{
+	FmgrInfo	hash_proc;
+} HLLHashCache;
+
+
+/*
+ * Make an empty sketch
+ */
+static bytea *
+hll_make_sketch(int precision)
+{
+	Size		size = VARHDRSZ + HLL_SKETCH_HDRSZ + ((Size) 1 << precision);
+	bytea	   *sketch = (bytea *) palloc0(size);
+
+	SET_VARSIZE(sketch, size);
+	((uint8 *) VARDATA(sketch))[0] = HLL_SKETCH_VERSION;
+	HLL_SKETCH_PRECISION(sketch) = (uint8) precision;
+
+	return sketch;
+}
+
+/*
+ * Check that a bytea is a well-formed sketch, and return its precision
+ */
+static int
+hll_sketch_check(bytea *sketch)
+{
+	int			precision;
+
+	if (VARSIZE(sketch) < VARHDRSZ + HLL_SKETCH_HDRSZ ||
+		((uint8 *) VARDATA(sketch))[0] != HLL_SKETCH_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid HyperLogLog sketch")));
+
+	precision = HLL_SKETCH_PRECISION(sketch);
+	if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION ||
+		VARSIZE(sketch) != VARHDRSZ + HLL_SKETCH_HDRSZ + ((Size) 1 << precision))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid HyperLogLog sketch")));
+
+	return precision;
+}
+
+/*
+ * Fetch a sketch argument that the caller means to update and return.
+ *
+ * When called as an aggregate, the transition state belongs to us and can
+ * be updated in place; otherwise we must work on a copy.
+ */
+static bytea *
+hll_sketch_for_update(FunctionCallInfo fcinfo, int argno)
+{
+	if (AggCheckCallContext(fcinfo, NULL))
+		return PG_GETARG_BYTEA_P(argno);
+	return PG_GETARG_BYTEA_P_COPY(argno);
+}
+
+/*
+ * Hash an element of the aggregated input
+ */
+static uint32
+hll_hash_element(FunctionCallInfo fcinfo, Datum value)
+{
+	HLLHashCache *cache = (HLLHashCache *) fcinfo->flinfo->fn_extra;
+
+	if (cache == NULL)
+	{
+		Oid			typid;
+		TypeCacheEntry *typentry;
+
+		typid = get_fn_expr_argtype(fcinfo->flinfo, 1);
+		if (!OidIsValid(typid))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("could not determine input data type")));
+
+		typentry = lookup_type_cache(typid, TYPECACHE_HASH_PROC_FINFO);
+		if (!OidIsValid(typentry->hash_proc_finfo.fn_oid))
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_FUNCTION),
+					 errmsg("could not identify a hash function for type %s",
+							format_type_be(typid))));
+
+		cache = (HLLHashCache *) MemoryContextAlloc(fcinfo->flinfo->fn_mcxt,
+													sizeof(HLLHashCache));
+		fmgr_info_copy(&cache->hash_proc, &typentry->hash_proc_finfo,
+					   fcinfo->flinfo->fn_mcxt);
+		fcinfo->flinfo->fn_extra = (void *) cache;
+	}
+
+	return DatumGetUInt32(FunctionCall1Coll(&cache->hash_proc,
+											PG_GET_COLLATION(),
+											value));
+}
+
+static int64
+hll_sketch_estimate(bytea *sketch)
+{
+	hyperLogLogState hll;
+
+	attachHyperLogLog(&hll, hll_sketch_check(sketch),
+					  HLL_SKETCH_REGISTERS(sketch));
+
+	return (int64) rint(estimateHyperLogLog(&hll));
+}
+
+/*
+ * Add an element to the sketch in the transition state, making the sketch
+ * at the given precision if this is the first call.
+ */
+static bytea *
+hll_add_element(FunctionCallInfo fcinfo, int precision)
+{
+	bytea	   *sketch;
+
+	if (PG_ARGISNULL(0))
+		sketch = hll_make_sketch(precision);
+	else
+	{
+		sketch = hll_sketch_for_update(fcinfo, 0);
+		if (hll_sketch_check(sketch) != precision)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("HyperLogLog precision must not change within a group")));
+	}
+
+	if (!PG_ARGISNULL(1))
+	{
+		hyperLogLogState hll;
+
+		attachHyperLogLog(&hll, (uint8) precision,
+						  HLL_SKETCH_REGISTERS(sketch));
+		addHyperLogLog(&hll, hll_hash_element(fcinfo, PG_GETARG_DATUM(1)));
+	}
+
+	return sketch;
+}
+
+/*
+ * hll_add_trans(sketch bytea, element anyelement)
+ *		Transition function of approx_count_distinct() and hll_sketch_agg().
+ *
+ * Not strict: the state starts out NULL, and NULL elements are ignored.
+ */
+Datum
+hll_add_trans(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BYTEA_P(hll_add_element(fcinfo, HLL_DEFAULT_PRECISION));
+}
+
+/*
+ * hll_add_trans_prec(sketch bytea, element anyelement, precision int4)
+ *		Likewise, for the variants taking a precision.
+ */
+Datum
+hll_add_trans_prec(PG_FUNCTION_ARGS)
+{
+	int			precision = HLL_DEFAULT_PRECISION;
+
+	if (!PG_ARGISNULL(2))
+	{
+		precision = PG_GETARG_INT32(2);
+		if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("HyperLogLog precision must be between %d and %d",
+							HLL_MIN_PRECISION, HLL_MAX_PRECISION)));
+	}
+
+	PG_RETURN_BYTEA_P(hll_add_element(fcinfo, precision));
+}
+
+/*
+ * hll_union(bytea, bytea)
+ *		Union of two sketches of the same precision.
+ *
+ * This is also the combine function of the sketch aggregates, and the
+ * transition function of hll_union_agg().
+ */
+Datum
+hll_union(PG_FUNCTION_ARGS)
+{
+	bytea	   *sketch = hll_sketch_for_update(fcinfo, 0);
+	bytea	   *other = PG_GETARG_BYTEA_P(1);
+	int			precision = hll_sketch_check(sketch);
+	hyperLogLogState hll;
+	hyperLogLogState ohll;
+
+	if (hll_sketch_check(other) != precision)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot combine HyperLogLog sketches of different precisions")));
+
+	attachHyperLogLog(&hll, (uint8) precision, HLL_SKETCH_REGISTERS(sketch));
+	attachHyperLogLog(&ohll, (uint8) precision, HLL_SKETCH_REGISTERS(other));
+	mergeHyperLogLog(&hll, &ohll);
+
+	PG_RETURN_BYTEA_P(sketch);
+}
+
+/*
+ * hll_cardinality(bytea)
+ *		Estimated number of distinct elements added to a sketch.
+ */
+Datum
+hll_cardinality(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT64(hll_sketch_estimate(PG_GETARG_BYTEA_P(0)));
+}
+
+/*
+ * hll_count_final(bytea)
+ *		Final function of approx_count_distinct(); like count(), it returns
+ *		zero rather than NULL if there were no non-NULL inputs.
+ */
+Datum
+hll_count_final(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+		PG_RETURN_INT64(0);
+
+	PG_RETURN_INT64(hll_sketch_estimate(PG_GETARG_BYTEA_P(0)));
+}
@@ -22,6 +22,7 @@
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "parser/parse_coerce.h"
+#include "port/simd.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/date.h"
@@ -76,6 +77,7 @@ typedef struct JsonAggState
 
 static inline void json_lex(JsonLexContext *lex);
 static inline void json_lex_string(JsonLexContext *lex);
+static inline int json_string_run_length(const char *s, int len);
 static inline void json_lex_number(JsonLexContext *lex, char *s,
 				bool *num_err, int *total_len);
 static inline void parse_scalar(JsonLexContext *lex, JsonSemAction *sem);
@@ -965,16 +967,31 @@ json_lex_string(JsonLexContext *lex)
 			}
 
 		}
-		else if (lex->strval != NULL)
+		else
 		{
-			if (hi_surrogate != -1)
-				ereport(ERROR,
-						(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-						 errmsg("invalid input syntax for type json"),
-						 errdetail("Unicode low surrogate must follow a high surrogate."),
-						 report_json_context(lex)));
+			/*
+			 * An ordinary character.  Consume it together with all the
+			 * ordinary characters following it in one go; that's most of any
+			 * real-world string.
+			 */
+			int			run = json_string_run_length(s,
+													 lex->input_length - len);
+
+			if (lex->strval != NULL)
+			{
+				if (hi_surrogate != -1)
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+							 errmsg("invalid input syntax for type json"),
+							 errdetail("Unicode low surrogate must follow a high surrogate."),
+							 report_json_context(lex)));
+
+				appendBinaryStringInfo(lex->strval, s, run);
+			}
 
-			appendStringInfoChar(lex->strval, *s);
+			/* the loop steps over the last one */
+			s += run - 1;
+			len += run - 1;
 		}
 
 	}
@@ -991,6 +1008,45 @@ json_lex_string(JsonLexContext *lex)
 	lex->token_terminator = s + 1;
 }
 
+/*
+ * Return the length of the leading run of s[0..len) that needs no attention
+ * from json_lex_string: no closing quote, no backslash and no control
+ * character.  Where the platform allows, test a whole vector of input at once.
+ *
+ * Every server encoding is ASCII-safe, so looking at individual bytes can't
+ * mistake part of a multibyte character for one of these.
+ */
+static inline int
+json_string_run_length(const char *s, int len)
+{
+	int			i = 0;
+
+#ifndef USE_NO_SIMD
+	const Vector8 quote = vector8_broadcast('"');
+	const Vector8 backslash = vector8_broadcast('\\');
+
+	for (; i + (int) sizeof(Vector8) <= len; i += sizeof(Vector8))
+	{
+		Vector8		chunk = vector8_load(s + i);
+
+		if (vector8_any(vector8_or(vector8_eq(chunk, quote),
+								   vector8_eq(chunk, backslash))) ||
+			vector8_has_le(chunk, 31))
+			break;				/* find the exact position below */
+	}
+#endif
+
+	for (; i < len; i++)
+	{
+		unsigned char c = (unsigned char) s[i];
+
+		if (c == '"' || c == '\\' || c < 32)
+			break;
+	}
+
+	return i;
+}
+
 /*
  * The next token in the input stream is known to be a number; lex it.
  *
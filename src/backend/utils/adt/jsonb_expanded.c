@@ -0,0 +1,518 @@
+/*-------------------------------------------------------------------------
+ *
+ * jsonb_expanded.c
+ *	  Basic functions for manipulating expanded jsonb values.
+ *
+ * An expanded jsonb holds the document as a tree of JsonbValues.  PL/pgSQL
+ * keeps jsonb variables in this form, so that repeated field extractions
+ * don't have to walk the on-disk format each time, and jsonb_set() and ||
+ * can modify the variable in place rather than rebuilding the whole
+ * document.  It is flattened back to an ordinary jsonb only when it has to
+ * be stored or handed to code that needs the flat format.
+ *
+ * Copyright (c) 2014-2015, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/jsonb_expanded.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "utils/jsonb.h"
+#include "utils/memutils.h"
+
+
+/* "Methods" required for an expanded object */
+static Size EJ_get_flat_size(ExpandedObjectHeader *eohptr);
+static void EJ_flatten_into(ExpandedObjectHeader *eohptr,
+				void *result, Size allocated_size);
+
+static const ExpandedObjectMethods EJ_methods =
+{
+	EJ_get_flat_size,
+	EJ_flatten_into
+};
+
+/* Other local functions */
+static void buildJsonbTree(JsonbContainer *container, JsonbValue *result);
+static int	findExpandedJsonbKey(JsonbValue *object, const char *key,
+					 int keylen, bool *found);
+static int	compareExpandedJsonbKeys(const JsonbValue *a, const JsonbValue *b);
+static void invalidateFlatJsonb(ExpandedJsonbHeader *ejh);
+
+
+/*
+ * expand_jsonb: convert a jsonb Datum into an expanded jsonb
+ *
+ * The expanded object will be a child of parentcontext.
+ */
+Datum
+expand_jsonb(Datum jsonbdatum, MemoryContext parentcontext)
+{
+	ExpandedJsonbHeader *ejh;
+	MemoryContext objcxt;
+	MemoryContext oldcxt;
+
+	/*
+	 * Allocate private context for expanded object.  We start by assuming
+	 * that the document won't be very large; but if it does grow a lot,
+	 * don't constrain aset.c's large-context behavior.
+	 */
+	objcxt = AllocSetContextCreate(parentcontext,
+								   "expanded jsonb",
+								   ALLOCSET_SMALL_MINSIZE,
+								   ALLOCSET_SMALL_INITSIZE,
+								   ALLOCSET_DEFAULT_MAXSIZE);
+
+	/* Set up expanded jsonb header */
+	ejh = (ExpandedJsonbHeader *)
+		MemoryContextAlloc(objcxt, sizeof(ExpandedJsonbHeader));
+
+	EOH_init_header(&ejh->hdr, &EJ_methods, objcxt);
+	ejh->ej_magic = EJ_MAGIC;
+
+	/*
+	 * Detoast and copy the source into the private context, and build the
+	 * tree over that copy.  If the source is itself expanded, this flattens
+	 * it first; that costs a copy, but the source's flat form is usually
+	 * cached anyway.
+	 */
+	oldcxt = MemoryContextSwitchTo(objcxt);
+	ejh->fsource = (Jsonb *) PG_DETOAST_DATUM_COPY(jsonbdatum);
+	ejh->fvalue = ejh->fsource;
+	buildJsonbTree(&ejh->fsource->root, &ejh->root);
+	MemoryContextSwitchTo(oldcxt);
+
+	/* return a R/W pointer to the expanded jsonb */
+	return EOHPGetRWDatum(&ejh->hdr);
+}
+
+/*
+ * Build a JsonbValue tree, in the current memory context, for the document
+ * in a flat container.  Strings and numerics in the tree point into the
+ * container, which must outlive the tree.
+ */
+static void
+buildJsonbTree(JsonbContainer *container, JsonbValue *result)
+{
+	JsonbParseState *state = NULL;
+	JsonbIterator *it;
+	JsonbIteratorToken tok;
+	JsonbValue	v;
+	JsonbValue *res = NULL;
+
+	it = JsonbIteratorInit(container);
+
+	while ((tok = JsonbIteratorNext(&it, &v, false)) != WJB_DONE)
+	{
+		/* only a raw scalar array may pass its JsonbValue when starting */
+		if (tok < WJB_BEGIN_ARRAY ||
+			(tok == WJB_BEGIN_ARRAY && v.val.array.rawScalar))
+			res = pushJsonbValue(&state, tok, &v);
+		else
+			res = pushJsonbValue(&state, tok, NULL);
+	}
+
+	Assert(res != NULL);
+	*result = *res;
+}
+
+/*
+ * get_flat_size method for expanded jsonb
+ *
+ * There's no way to know the size of the flat form short of building it, so
+ * build it and keep it until the document is next modified; flatten_into
+ * then just copies it.
+ */
+static Size
+EJ_get_flat_size(ExpandedObjectHeader *eohptr)
+{
+	ExpandedJsonbHeader *ejh = (ExpandedJsonbHeader *) eohptr;
+
+	Assert(ejh->ej_magic == EJ_MAGIC);
+
+	if (ejh->fvalue == NULL)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(ejh->hdr.eoh_context);
+
+		ejh->fvalue = JsonbValueToJsonb(&ejh->root);
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	return VARSIZE(ejh->fvalue);
+}
+
+/*
+ * flatten_into method for expanded jsonb
+ */
+static void
+EJ_flatten_into(ExpandedObjectHeader *eohptr,
+				void *result, Size allocated_size)
+{
+	ExpandedJsonbHeader *ejh = (ExpandedJsonbHeader *) eohptr;
+
+	Assert(ejh->ej_magic == EJ_MAGIC);
+
+	/* get_flat_size must have been called first */
+	Assert(ejh->fvalue != NULL);
+	Assert(allocated_size == VARSIZE(ejh->fvalue));
+
+	memcpy(result, ejh->fvalue, allocated_size);
+}
+
+/*
+ * Forget the flat representation of an expanded jsonb that's about to be
+ * modified.
+ */
+static void
+invalidateFlatJsonb(ExpandedJsonbHeader *ejh)
+{
+	/* fsource may be pointed into by the tree, so it's never freed */
+	if (ejh->fvalue != NULL && ejh->fvalue != ejh->fsource)
+		pfree(ejh->fvalue);
+	ejh->fvalue = NULL;
+}
+
+/*
+ * DatumGetExpandedJsonb: get a writable expanded jsonb from an input argument
+ *
+ * Caution: if the input is a read/write pointer, this returns the input
+ * argument; so callers must be sure that their changes are "safe", that is
+ * they cannot leave the document in a corrupt state.
+ */
+ExpandedJsonbHeader *
+DatumGetExpandedJsonb(Datum d)
+{
+	/* If it's a writable expanded jsonb already, just return it */
+	if (VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(d)))
+	{
+		ExpandedJsonbHeader *ejh = (ExpandedJsonbHeader *) DatumGetEOHP(d);
+
+		Assert(ejh->ej_magic == EJ_MAGIC);
+		return ejh;
+	}
+
+	/* Else expand the hard way */
+	d = expand_jsonb(d, CurrentMemoryContext);
+	return (ExpandedJsonbHeader *) DatumGetEOHP(d);
+}
+
+/*
+ * DatumGetExpandedJsonbRoot: get the document of an expanded jsonb argument
+ *
+ * Returns NULL if the argument is an ordinary jsonb, which the caller should
+ * then detoast as usual.  The tree must not be modified.
+ */
+JsonbValue *
+DatumGetExpandedJsonbRoot(Datum d)
+{
+	ExpandedJsonbHeader *ejh;
+
+	if (!VARATT_IS_EXTERNAL_EXPANDED(DatumGetPointer(d)))
+		return NULL;
+
+	ejh = (ExpandedJsonbHeader *) DatumGetEOHP(d);
+	Assert(ejh->ej_magic == EJ_MAGIC);
+
+	return &ejh->root;
+}
+
+/*
+ * Convert a flat jsonb into a JsonbValue tree in the expanded jsonb's
+ * context, ready to be linked into its document.  A scalar is returned as
+ * itself rather than as a raw scalar pseudo-array.
+ */
+void
+makeExpandedJsonbValue(ExpandedJsonbHeader *ejh, Jsonb *jb,
+					   JsonbValue *result)
+{
+	MemoryContext oldcxt = MemoryContextSwitchTo(ejh->hdr.eoh_context);
+	Jsonb	   *copy;
+
+	copy = (Jsonb *) palloc(VARSIZE(jb));
+	memcpy(copy, jb, VARSIZE(jb));
+	buildJsonbTree(&copy->root, result);
+
+	if (result->type == JsonbValue::jbvArray && result->val.array.rawScalar)
+		*result = result->val.array.elems[0];
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * Compare two object keys in the order used for object pairs, which is
+ * that of lengthCompareJsonbStringValue: length first, then bytes.
+ */
+static int
+compareExpandedJsonbKeys(const JsonbValue *a, const JsonbValue *b)
+{
+	Assert(a->type == JsonbValue::jbvString);
+	Assert(b->type == JsonbValue::jbvString);
+
+	if (a->val.string.len != b->val.string.len)
+		return (a->val.string.len > b->val.string.len) ? 1 : -1;
+
+	return memcmp(a->val.string.val, b->val.string.val, a->val.string.len);
+}
+
+/*
+ * Binary search for key among an expanded object's pairs.  Sets *found and
+ * returns its position if present; otherwise returns the position at which
+ * it would be inserted.
+ */
+static int
+findExpandedJsonbKey(JsonbValue *object, const char *key, int keylen,
+					 bool *found)
+{
+	JsonbPair  *pairs = object->val.object.pairs;
+	JsonbValue	k;
+	int			lo = 0,
+				hi = object->val.object.nPairs;
+
+	Assert(object->type == JsonbValue::jbvObject);
+
+	k.type = JsonbValue::jbvString;
+	k.val.string.len = keylen;
+	k.val.string.val = (char *) key;
+
+	while (lo < hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+		int			difference;
+
+		difference = compareExpandedJsonbKeys(&pairs[mid].key, &k);
+		if (difference == 0)
+		{
+			*found = true;
+			return mid;
+		}
+		else if (difference < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*found = false;
+	return lo;
+}
+
+/*
+ * Find the value of key in an object within an expanded jsonb, or NULL if
+ * there's no such key.
+ */
+JsonbValue *
+findJsonbValueFromExpanded(JsonbValue *object, const char *key, int keylen)
+{
+	bool		found;
+	int			pos;
+
+	pos = findExpandedJsonbKey(object, key, keylen, &found);
+
+	return found ? &object->val.object.pairs[pos].value : NULL;
+}
+
+/*
+ * Set key in an object within an expanded jsonb to val, adding the key if
+ * it isn't there.  val must have been made by makeExpandedJsonbValue.
+ */
+void
+setExpandedJsonbKey(ExpandedJsonbHeader *ejh, JsonbValue *object,
+					const char *key, int keylen, JsonbValue *val)
+{
+	JsonbPair  *pairs;
+	int			npairs = object->val.object.nPairs;
+	bool		found;
+	int			pos;
+	char	   *keycopy;
+
+	pos = findExpandedJsonbKey(object, key, keylen, &found);
+
+	if (found)
+	{
+		invalidateFlatJsonb(ejh);
+		object->val.object.pairs[pos].value = *val;
+		return;
+	}
+
+	if (npairs >= JSONB_MAX_PAIRS)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("number of jsonb object pairs exceeds the maximum allowed (%zu)",
+						JSONB_MAX_PAIRS)));
+
+	/* Allocate everything before changing anything */
+	keycopy = (char *) MemoryContextAlloc(ejh->hdr.eoh_context, keylen + 1);
+	memcpy(keycopy, key, keylen);
+	pairs = (JsonbPair *) repalloc(object->val.object.pairs,
+								   sizeof(JsonbPair) * (npairs + 1));
+
+	invalidateFlatJsonb(ejh);
+	memmove(&pairs[pos + 1], &pairs[pos], sizeof(JsonbPair) * (npairs - pos));
+	pairs[pos].key.type = JsonbValue::jbvString;
+	pairs[pos].key.val.string.len = keylen;
+	pairs[pos].key.val.string.val = keycopy;
+	pairs[pos].value = *val;
+	pairs[pos].order = npairs;
+	object->val.object.pairs = pairs;
+	object->val.object.nPairs = npairs + 1;
+}
+
+/*
+ * Replace element idx of an array within an expanded jsonb with val, which
+ * must have been made by makeExpandedJsonbValue.
+ */
+void
+setExpandedJsonbElem(ExpandedJsonbHeader *ejh, JsonbValue *array, int idx,
+					 JsonbValue *val)
+{
+	Assert(array->type == JsonbValue::jbvArray);
+	Assert(idx >= 0 && idx < array->val.array.nElems);
+
+	invalidateFlatJsonb(ejh);
+	array->val.array.elems[idx] = *val;
+}
+
+/*
+ * Insert val into an array within an expanded jsonb so that it becomes
+ * element idx, which may be one past the current last element.  val must
+ * have been made by makeExpandedJsonbValue.
+ */
+void
+insertExpandedJsonbElem(ExpandedJsonbHeader *ejh, JsonbValue *array,
+						int idx, JsonbValue *val)
+{
+	JsonbValue *elems;
+	int			nelems = array->val.array.nElems;
+
+	Assert(array->type == JsonbValue::jbvArray);
+	Assert(idx >= 0 && idx <= nelems);
+
+	if (nelems >= JSONB_MAX_ELEMS)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("number of jsonb array elements exceeds the maximum allowed (%zu)",
+						JSONB_MAX_ELEMS)));
+
+	elems = (JsonbValue *) repalloc(array->val.array.elems,
+									sizeof(JsonbValue) * (nelems + 1));
+
+	invalidateFlatJsonb(ejh);
+	memmove(&elems[idx + 1], &elems[idx], sizeof(JsonbValue) * (nelems - idx));
+	elems[idx] = *val;
+	array->val.array.elems = elems;
+	array->val.array.nElems = nelems + 1;
+}
+
+/*
+ * Concatenate jb onto an expanded jsonb in place, with the same result as
+ * jsonb_concat.
+ *
+ * Only object || object and array || array (either side possibly a raw
+ * scalar) are handled here.  For anything else we return false without
+ * touching the document, and the caller must take the general path.
+ */
+bool
+concatExpandedJsonb(ExpandedJsonbHeader *ejh, Jsonb *jb)
+{
+	JsonbValue *root = &ejh->root;
+	JsonbValue	other;
+
+	Assert(ejh->ej_magic == EJ_MAGIC);
+
+	if (root->type == JsonbValue::jbvObject && JB_ROOT_IS_OBJECT(jb))
+	{
+		JsonbPair  *pairs1 = root->val.object.pairs;
+		JsonbPair  *pairs2;
+		JsonbPair  *result;
+		int			n1 = root->val.object.nPairs;
+		int			n2;
+		int			i = 0,
+					j = 0,
+					n = 0;
+
+		makeExpandedJsonbValue(ejh, jb, &other);
+		pairs2 = other.val.object.pairs;
+		n2 = other.val.object.nPairs;
+
+		if ((Size) n1 + n2 > JSONB_MAX_PAIRS)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("number of jsonb object pairs exceeds the maximum allowed (%zu)",
+							JSONB_MAX_PAIRS)));
+
+		result = (JsonbPair *)
+			MemoryContextAlloc(ejh->hdr.eoh_context,
+							   sizeof(JsonbPair) * (n1 + n2 + 1));
+
+		/* Merge the two sorted pair lists; on equal keys the right side wins */
+		while (i < n1 || j < n2)
+		{
+			int			cmp;
+
+			if (i >= n1)
+				cmp = 1;
+			else if (j >= n2)
+				cmp = -1;
+			else
+				cmp = compareExpandedJsonbKeys(&pairs1[i].key, &pairs2[j].key);
+
+			if (cmp < 0)
+				result[n] = pairs1[i++];
+			else
+			{
+				if (cmp == 0)
+					i++;
+				result[n] = pairs2[j++];
+			}
+			result[n].order = n;
+			n++;
+		}
+
+		invalidateFlatJsonb(ejh);
+		root->val.object.pairs = result;
+		root->val.object.nPairs = n;
+		pfree(pairs1);
+		return true;
+	}
+
+	if (root->type == JsonbValue::jbvArray && JB_ROOT_IS_ARRAY(jb))
+	{
+		JsonbValue *elems2;
+		JsonbValue *result;
+		int			n1 = root->val.array.nElems;
+		int			n2;
+
+		makeExpandedJsonbValue(ejh, jb, &other);
+		if (JB_ROOT_IS_SCALAR(jb))
+		{
+			elems2 = &other;
+			n2 = 1;
+		}
+		else
+		{
+			elems2 = other.val.array.elems;
+			n2 = other.val.array.nElems;
+		}
+
+		if ((Size) n1 + n2 > JSONB_MAX_ELEMS)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("number of jsonb array elements exceeds the maximum allowed (%zu)",
+							JSONB_MAX_ELEMS)));
+
+		result = (JsonbValue *) repalloc(root->val.array.elems,
+										 sizeof(JsonbValue) * (n1 + n2 + 1));
+
+		/* The result is an array even if both inputs were scalars */
+		invalidateFlatJsonb(ejh);
+		memcpy(&result[n1], elems2, sizeof(JsonbValue) * n2);
+		root->val.array.elems = result;
+		root->val.array.nElems = n1 + n2;
+		root->val.array.rawScalar = false;
+		return true;
+	}
+
+	return false;
+}
@@ -123,6 +123,9 @@ static JsonbValue *findJsonbValueFromContainerLen(JsonbContainer *container,
 							   uint32 flags,
 							   char *key,
 							   uint32 keylen);
+static text *JsonbValueAsText(JsonbValue *v);
+static bool getJsonbPathIndex(Datum pathelem, uint32 nelements,
+				  uint32 *index);
 
 /* functions supporting jsonb_delete, jsonb_set and jsonb_concat */
 static JsonbValue *IteratorConcat(JsonbIterator **it1, JsonbIterator **it2,
@@ -138,7 +141,11 @@ static void setPathObject(JsonbIterator **it, Datum *path_elems,
 static void setPathArray(JsonbIterator **it, Datum *path_elems,
 			 bool *path_nulls, int path_len, JsonbParseState **st,
 			 int level, Jsonb *newval, uint32 nelems, bool create);
+static int	getSetPathIndex(Datum path_elem, int level);
 static void addJsonbToParseState(JsonbParseState **jbps, Jsonb *jb);
+static void setPathExpanded(ExpandedJsonbHeader *ejh, JsonbValue *jbv,
+				Datum *path_elems, bool *path_nulls, int path_len,
+				int level, Jsonb *newval, bool create);
 
 /* state for json_object_keys */
 typedef struct OkeysState
@@ -488,16 +495,30 @@ json_object_field(PG_FUNCTION_ARGS)
 Datum
 jsonb_object_field(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB(0);
+	JsonbValue *root = DatumGetExpandedJsonbRoot(PG_GETARG_DATUM(0));
 	text	   *key = PG_GETARG_TEXT_PP(1);
 	JsonbValue *v;
 
-	if (!JB_ROOT_IS_OBJECT(jb))
-		PG_RETURN_NULL();
+	if (root != NULL)
+	{
+		/* expanded jsonb, look the key up in the tree */
+		if (root->type != JsonbValue::jbvObject)
+			PG_RETURN_NULL();
 
-	v = findJsonbValueFromContainerLen(&jb->root, JB_FOBJECT,
-									   VARDATA_ANY(key),
+		v = findJsonbValueFromExpanded(root, VARDATA_ANY(key),
 									   VARSIZE_ANY_EXHDR(key));
+	}
+	else
+	{
+		Jsonb	   *jb = PG_GETARG_JSONB(0);
+
+		if (!JB_ROOT_IS_OBJECT(jb))
+			PG_RETURN_NULL();
+
+		v = findJsonbValueFromContainerLen(&jb->root, JB_FOBJECT,
+										   VARDATA_ANY(key),
+										   VARSIZE_ANY_EXHDR(key));
+	}
 
 	if (v != NULL)
 		PG_RETURN_JSONB(JsonbValueToJsonb(v));
@@ -524,46 +545,34 @@ json_object_field_text(PG_FUNCTION_ARGS)
 Datum
 jsonb_object_field_text(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB(0);
+	JsonbValue *root = DatumGetExpandedJsonbRoot(PG_GETARG_DATUM(0));
 	text	   *key = PG_GETARG_TEXT_PP(1);
 	JsonbValue *v;
 
-	if (!JB_ROOT_IS_OBJECT(jb))
-		PG_RETURN_NULL();
+	if (root != NULL)
+	{
+		/* expanded jsonb, look the key up in the tree */
+		if (root->type != JsonbValue::jbvObject)
+			PG_RETURN_NULL();
 
-	v = findJsonbValueFromContainerLen(&jb->root, JB_FOBJECT,
-									   VARDATA_ANY(key),
+		v = findJsonbValueFromExpanded(root, VARDATA_ANY(key),
 									   VARSIZE_ANY_EXHDR(key));
-
-	if (v != NULL)
+	}
+	else
 	{
-		text	   *result = NULL;
+		Jsonb	   *jb = PG_GETARG_JSONB(0);
 
-		switch (v->type)
-		{
-			case JsonbValue::jbvNull:
-				break;
-			case JsonbValue::jbvBool:
-				result = cstring_to_text(v->val.boolean ? "true" : "false");
-				break;
-			case JsonbValue::jbvString:
-				result = cstring_to_text_with_len(v->val.string.val, v->val.string.len);
-				break;
-			case JsonbValue::jbvNumeric:
-				result = cstring_to_text(DatumGetCString(DirectFunctionCall1(numeric_out,
-										  PointerGetDatum(v->val.numeric))));
-				break;
-			case JsonbValue::jbvBinary:
-				{
-					StringInfo	jtext = makeStringInfo();
+		if (!JB_ROOT_IS_OBJECT(jb))
+			PG_RETURN_NULL();
 
-					(void) JsonbToCString(jtext, v->val.binary.data, -1);
-					result = cstring_to_text_with_len(jtext->data, jtext->len);
-				}
-				break;
-			default:
-				elog(ERROR, "unrecognized jsonb type: %d", (int) v->type);
-		}
+		v = findJsonbValueFromContainerLen(&jb->root, JB_FOBJECT,
+										   VARDATA_ANY(key),
+										   VARSIZE_ANY_EXHDR(key));
+	}
+
+	if (v != NULL)
+	{
+		text	   *result = JsonbValueAsText(v);
 
 		if (result)
 			PG_RETURN_TEXT_P(result);
@@ -590,25 +599,55 @@ json_array_element(PG_FUNCTION_ARGS)
 Datum
 jsonb_array_element(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB(0);
+	JsonbValue *root = DatumGetExpandedJsonbRoot(PG_GETARG_DATUM(0));
 	int			element = PG_GETARG_INT32(1);
 	JsonbValue *v;
 
-	if (!JB_ROOT_IS_ARRAY(jb))
-		PG_RETURN_NULL();
+	if (root != NULL)
+	{
+		/* expanded jsonb; a raw scalar counts as an array here, too */
+		uint32		nelements;
+
+		if (root->type != JsonbValue::jbvArray)
+			PG_RETURN_NULL();
+
+		nelements = root->val.array.nElems;
 
-	/* Handle negative subscript */
-	if (element < 0)
+		/* Handle negative subscript */
+		if (element < 0)
+		{
+			if (-element > nelements)
+				PG_RETURN_NULL();
+			else
+				element += nelements;
+		}
+
+		if ((uint32) element >= nelements)
+			PG_RETURN_NULL();
+
+		v = &root->val.array.elems[element];
+	}
+	else
 	{
-		uint32	nelements = JB_ROOT_COUNT(jb);
+		Jsonb	   *jb = PG_GETARG_JSONB(0);
 
-		if (-element > nelements)
+		if (!JB_ROOT_IS_ARRAY(jb))
 			PG_RETURN_NULL();
-		else
-			element += nelements;
+
+		/* Handle negative subscript */
+		if (element < 0)
+		{
+			uint32		nelements = JB_ROOT_COUNT(jb);
+
+			if (-element > nelements)
+				PG_RETURN_NULL();
+			else
+				element += nelements;
+		}
+
+		v = getIthJsonbValueFromContainer(&jb->root, element);
 	}
 
-	v = getIthJsonbValueFromContainer(&jb->root, element);
 	if (v != NULL)
 		PG_RETURN_JSONB(JsonbValueToJsonb(v));
 
@@ -633,55 +672,59 @@ json_array_element_text(PG_FUNCTION_ARGS)
 Datum
 jsonb_array_element_text(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB(0);
+	JsonbValue *root = DatumGetExpandedJsonbRoot(PG_GETARG_DATUM(0));
 	int			element = PG_GETARG_INT32(1);
 	JsonbValue *v;
 
-	if (!JB_ROOT_IS_ARRAY(jb))
-		PG_RETURN_NULL();
-
-	/* Handle negative subscript */
-	if (element < 0)
+	if (root != NULL)
 	{
-		uint32	nelements = JB_ROOT_COUNT(jb);
+		/* expanded jsonb; a raw scalar counts as an array here, too */
+		uint32		nelements;
 
-		if (-element > nelements)
+		if (root->type != JsonbValue::jbvArray)
 			PG_RETURN_NULL();
-		else
-			element += nelements;
-	}
 
-	v = getIthJsonbValueFromContainer(&jb->root, element);
-	if (v != NULL)
+		nelements = root->val.array.nElems;
+
+		/* Handle negative subscript */
+		if (element < 0)
+		{
+			if (-element > nelements)
+				PG_RETURN_NULL();
+			else
+				element += nelements;
+		}
+
+		if ((uint32) element >= nelements)
+			PG_RETURN_NULL();
+
+		v = &root->val.array.elems[element];
+	}
+	else
 	{
-		text	   *result = NULL;
+		Jsonb	   *jb = PG_GETARG_JSONB(0);
+
+		if (!JB_ROOT_IS_ARRAY(jb))
+			PG_RETURN_NULL();
 
-		switch (v->type)
+		/* Handle negative subscript */
+		if (element < 0)
 		{
-			case JsonbValue::jbvNull:
-				break;
-			case JsonbValue::jbvBool:
-				result = cstring_to_text(v->val.boolean ? "true" : "false");
-				break;
-			case JsonbValue::jbvString:
-				result = cstring_to_text_with_len(v->val.string.val, v->val.string.len);
-				break;
-			case JsonbValue::jbvNumeric:
-				result = cstring_to_text(DatumGetCString(DirectFunctionCall1(numeric_out,
-										  PointerGetDatum(v->val.numeric))));
-				break;
-			case JsonbValue::jbvBinary:
-				{
-					StringInfo	jtext = makeStringInfo();
+			uint32		nelements = JB_ROOT_COUNT(jb);
 
-					(void) JsonbToCString(jtext, v->val.binary.data, -1);
-					result = cstring_to_text_with_len(jtext->data, jtext->len);
-				}
-				break;
-			default:
-				elog(ERROR, "unrecognized jsonb type: %d", (int) v->type);
+			if (-element > nelements)
+				PG_RETURN_NULL();
+			else
+				element += nelements;
 		}
 
+		v = getIthJsonbValueFromContainer(&jb->root, element);
+	}
+
+	if (v != NULL)
+	{
+		text	   *result = JsonbValueAsText(v);
+
 		if (result)
 			PG_RETURN_TEXT_P(result);
 	}
@@ -1160,7 +1203,8 @@ jsonb_extract_path_text(PG_FUNCTION_ARGS)
 static Datum
 get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB(0);
+	JsonbValue *root = DatumGetExpandedJsonbRoot(PG_GETARG_DATUM(0));
+	Jsonb	   *jb;
 	ArrayType  *path = PG_GETARG_ARRAYTYPE_P(1);
 	Jsonb	   *res;
 	Datum	   *pathtext;
@@ -1186,6 +1230,55 @@ get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 	deconstruct_array(path, TEXTOID, -1, false, 'i',
 					  &pathtext, &pathnulls, &npath);
 
+	/*
+	 * An expanded jsonb is a tree all the way down, so just walk it and
+	 * share the output code below.
+	 */
+	if (root != NULL)
+	{
+		jbvp = root;
+		if (root->type == JsonbValue::jbvArray && root->val.array.rawScalar)
+		{
+			/* scalar, extraction yields a null */
+			if (npath > 0)
+				PG_RETURN_NULL();
+			jbvp = &root->val.array.elems[0];
+		}
+
+		for (i = 0; i < npath; i++)
+		{
+			if (jbvp->type == JsonbValue::jbvObject)
+			{
+				jbvp = findJsonbValueFromExpanded(jbvp,
+												  VARDATA_ANY(pathtext[i]),
+											 VARSIZE_ANY_EXHDR(pathtext[i]));
+			}
+			else if (jbvp->type == JsonbValue::jbvArray)
+			{
+				uint32		index;
+
+				if (!getJsonbPathIndex(pathtext[i], jbvp->val.array.nElems,
+									   &index) ||
+					index >= jbvp->val.array.nElems)
+					PG_RETURN_NULL();
+
+				jbvp = &jbvp->val.array.elems[index];
+			}
+			else
+			{
+				/* scalar, extraction yields a null */
+				PG_RETURN_NULL();
+			}
+
+			if (jbvp == NULL)
+				PG_RETURN_NULL();
+		}
+
+		goto output;
+	}
+
+	jb = PG_GETARG_JSONB(0);
+
 	/* Identify whether we have object, array, or scalar at top-level */
 	container = &jb->root;
 
@@ -1235,37 +1328,15 @@ get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 		}
 		else if (have_array)
 		{
-			long		lindex;
 			uint32		index;
-			char	   *indextext = TextDatumGetCString(pathtext[i]);
-			char	   *endptr;
-
-			errno = 0;
-			lindex = strtol(indextext, &endptr, 10);
-			if (endptr == indextext || *endptr != '\0' || errno != 0 ||
-				lindex > INT_MAX || lindex < INT_MIN)
-				PG_RETURN_NULL();
 
-			if (lindex >= 0)
-			{
-				index = (uint32) lindex;
-			}
-			else
-			{
-				/* Handle negative subscript */
-				uint32		nelements;
+			/* Container must be array, but make sure */
+			if ((container->header & JB_FARRAY) == 0)
+				elog(ERROR, "not a jsonb array");
 
-				/* Container must be array, but make sure */
-				if ((container->header & JB_FARRAY) == 0)
-					elog(ERROR, "not a jsonb array");
-
-				nelements = container->header & JB_CMASK;
-
-				if (-lindex > nelements)
-					PG_RETURN_NULL();
-				else
-					index = nelements + lindex;
-			}
+			if (!getJsonbPathIndex(pathtext[i], container->header & JB_CMASK,
+								   &index))
+				PG_RETURN_NULL();
 
 			jbvp = getIthJsonbValueFromContainer(container, index);
 		}
@@ -1297,6 +1368,7 @@ get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 		}
 	}
 
+output:
 	if (as_text)
 	{
 		/* special-case outputs for string and null values */
@@ -1322,6 +1394,38 @@ get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 	}
 }
 
+/*
+ * Convert a #> or #>> path element to an index into an array of nelements
+ * elements, counting back from the end for a negative subscript.  Returns
+ * false if the element isn't an integer or is too negative; an index past
+ * the end is left for the caller to reject.
+ */
+static bool
+getJsonbPathIndex(Datum pathelem, uint32 nelements, uint32 *index)
+{
+	long		lindex;
+	char	   *indextext = TextDatumGetCString(pathelem);
+	char	   *endptr;
+
+	errno = 0;
+	lindex = strtol(indextext, &endptr, 10);
+	if (endptr == indextext || *endptr != '\0' || errno != 0 ||
+		lindex > INT_MAX || lindex < INT_MIN)
+		return false;
+
+	if (lindex >= 0)
+		*index = (uint32) lindex;
+	else
+	{
+		/* Handle negative subscript */
+		if (-lindex > nelements)
+			return false;
+		*index = nelements + lindex;
+	}
+
+	return true;
+}
+
 /*
  * SQL function json_array_length(json) -> int
  */
@@ -3089,6 +3193,54 @@ findJsonbValueFromContainerLen(JsonbContainer *container, uint32 flags,
 	return findJsonbValueFromContainer(container, flags, &k);
 }
 
+/*
+ * Convert a JsonbValue to text, as the ->> operators do: strings lose their
+ * quotes, and JSON null becomes SQL NULL (returned as a NULL pointer).  v may
+ * be a jbvBinary container or, for an expanded jsonb, an in-memory one.
+ */
+static text *
+JsonbValueAsText(JsonbValue *v)
+{
+	text	   *result = NULL;
+
+	switch (v->type)
+	{
+		case JsonbValue::jbvNull:
+			break;
+		case JsonbValue::jbvBool:
+			result = cstring_to_text(v->val.boolean ? "true" : "false");
+			break;
+		case JsonbValue::jbvString:
+			result = cstring_to_text_with_len(v->val.string.val, v->val.string.len);
+			break;
+		case JsonbValue::jbvNumeric:
+			result = cstring_to_text(DatumGetCString(DirectFunctionCall1(numeric_out,
+									  PointerGetDatum(v->val.numeric))));
+			break;
+		case JsonbValue::jbvBinary:
+			{
+				StringInfo	jtext = makeStringInfo();
+
+				(void) JsonbToCString(jtext, v->val.binary.data, -1);
+				result = cstring_to_text_with_len(jtext->data, jtext->len);
+			}
+			break;
+		case JsonbValue::jbvArray:
+		case JsonbValue::jbvObject:
+			{
+				Jsonb	   *jb = JsonbValueToJsonb(v);
+
+				result = cstring_to_text(JsonbToCString(NULL, &jb->root,
+														VARSIZE(jb)));
+			}
+			break;
+		default:
+			elog(ERROR, "unrecognized jsonb type: %d", (int) v->type);
+	}
+
+	return result;
+}
+
 /*
  * Semantic actions for json_strip_nulls.
  *
@@ -3351,13 +3503,28 @@ jsonb_pretty(PG_FUNCTION_ARGS)
 Datum
 jsonb_concat(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb1 = PG_GETARG_JSONB(0);
+	Jsonb	   *jb1;
 	Jsonb	   *jb2 = PG_GETARG_JSONB(1);
 	JsonbParseState *state = NULL;
 	JsonbValue *res;
 	JsonbIterator *it1,
 			   *it2;
 
+	/*
+	 * If we're handed a read-write expanded jsonb, append to it in place.
+	 * (jb2 was fetched first, so it's a flat copy even if it's the same
+	 * object.)
+	 */
+	if (VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(PG_GETARG_DATUM(0))))
+	{
+		ExpandedJsonbHeader *ejh = DatumGetExpandedJsonb(PG_GETARG_DATUM(0));
+
+		if (concatExpandedJsonb(ejh, jb2))
+			PG_RETURN_DATUM(EOHPGetRWDatum(&ejh->hdr));
+	}
+
+	jb1 = PG_GETARG_JSONB(0);
+
 	/*
 	 * If one of the jsonb is empty, just return the other if it's not
 	 * scalar and both are of the same kind.  If it's a scalar or they are
@@ -3511,7 +3678,7 @@ jsonb_delete_idx(PG_FUNCTION_ARGS)
 Datum
 jsonb_set(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *in = PG_GETARG_JSONB(0);
+	Jsonb	   *in;
 	ArrayType  *path = PG_GETARG_ARRAYTYPE_P(1);
 	Jsonb	   *newval = PG_GETARG_JSONB(2);
 	bool		create = PG_GETARG_BOOL(3);
@@ -3527,6 +3694,34 @@ jsonb_set(PG_FUNCTION_ARGS)
 				(errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
 				 errmsg("wrong number of array subscripts")));
 
+	/* If we're handed a read-write expanded jsonb, modify it in place */
+	if (VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(PG_GETARG_DATUM(0))))
+	{
+		ExpandedJsonbHeader *ejh = DatumGetExpandedJsonb(PG_GETARG_DATUM(0));
+		JsonbValue *root = &ejh->root;
+
+		if (root->type == JsonbValue::jbvArray && root->val.array.rawScalar)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("cannot set path in scalar")));
+
+		if (!create &&
+			(root->type == JsonbValue::jbvObject ?
+			 root->val.object.nPairs : root->val.array.nElems) == 0)
+			PG_RETURN_DATUM(EOHPGetRWDatum(&ejh->hdr));
+
+		deconstruct_array(path, TEXTOID, -1, false, 'i',
+						  &path_elems, &path_nulls, &path_len);
+
+		if (path_len > 0)
+			setPathExpanded(ejh, root, path_elems, path_nulls, path_len,
+							0, newval, create);
+
+		PG_RETURN_DATUM(EOHPGetRWDatum(&ejh->hdr));
+	}
+
+	in = PG_GETARG_JSONB(0);
+
 	if (JB_ROOT_IS_SCALAR(in))
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
@@ -3874,21 +4069,7 @@ setPathArray(JsonbIterator **it, Datum *path_elems, bool *path_nulls,
 
 	/* pick correct index */
 	if (level < path_len && !path_nulls[level])
-	{
-		char	   *c = TextDatumGetCString(path_elems[level]);
-		long		lindex;
-		char	   *badp;
-
-		errno = 0;
-		lindex = strtol(c, &badp, 10);
-		if (errno != 0 || badp == c || *badp != '\0' || lindex > INT_MAX ||
-			lindex < INT_MIN)
-			ereport(ERROR,
-					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-			  errmsg("path element at position %d is not an integer: \"%s\"",
-					 level + 1, c)));
-		idx = lindex;
-	}
+		idx = getSetPathIndex(path_elems[level], level);
 	else
 		idx = nelems;
 
@@ -3965,3 +4146,109 @@ setPathArray(JsonbIterator **it, Datum *path_elems, bool *path_nulls,
 		}
 	}
 }
+
+/*
+ * Parse an array subscript in a jsonb_set or jsonb_delete path
+ */
+static int
+getSetPathIndex(Datum path_elem, int level)
+{
+	char	   *c = TextDatumGetCString(path_elem);
+	long		lindex;
+	char	   *badp;
+
+	errno = 0;
+	lindex = strtol(c, &badp, 10);
+	if (errno != 0 || badp == c || *badp != '\0' || lindex > INT_MAX ||
+		lindex < INT_MIN)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+			  errmsg("path element at position %d is not an integer: \"%s\"",
+					 level + 1, c)));
+
+	return (int) lindex;
+}
+
+/*
+ * jsonb_set for a read-write expanded jsonb: set the value at the given
+ * path in place, following exactly the rules of setPath.
+ *
+ * Everything that can fail is done before the single change made at the end
+ * of the path, so an error leaves the document untouched.
+ */
+static void
+setPathExpanded(ExpandedJsonbHeader *ejh, JsonbValue *jbv,
+				Datum *path_elems, bool *path_nulls, int path_len,
+				int level, Jsonb *newval, bool create)
+{
+	JsonbValue	newjbv;
+
+	check_stack_depth();
+
+	if (path_nulls[level])
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("path element at position %d is null",
+						level + 1)));
+
+	if (jbv->type == JsonbValue::jbvObject)
+	{
+		char	   *key = VARDATA_ANY(path_elems[level]);
+		int			keylen = VARSIZE_ANY_EXHDR(path_elems[level]);
+		JsonbValue *v = findJsonbValueFromExpanded(jbv, key, keylen);
+
+		if (level < path_len - 1)
+		{
+			if (v != NULL)
+				setPathExpanded(ejh, v, path_elems, path_nulls, path_len,
+								level + 1, newval, create);
+		}
+		else if (v != NULL || create)
+		{
+			makeExpandedJsonbValue(ejh, newval, &newjbv);
+			setExpandedJsonbKey(ejh, jbv, key, keylen, &newjbv);
+		}
+	}
+	else if (jbv->type == JsonbValue::jbvArray)
+	{
+		int			nelems = jbv->val.array.nElems;
+		int			idx = getSetPathIndex(path_elems[level], level);
+
+		if (idx < 0)
+		{
+			if (-idx > nelems)
+				idx = INT_MIN;
+			else
+				idx = nelems + idx;
+		}
+
+		if (idx > 0 && idx > nelems)
+			idx = nelems;
+
+		if (level < path_len - 1)
+		{
+			if (idx >= 0 && idx < nelems)
+				setPathExpanded(ejh, &jbv->val.array.elems[idx],
+								path_elems, path_nulls, path_len,
+								level + 1, newval, create);
+		}
+		else if ((idx == INT_MIN || nelems == 0) && create)
+		{
+			/* prepend, as setPathArray does */
+			makeExpandedJsonbValue(ejh, newval, &newjbv);
+			insertExpandedJsonbElem(ejh, jbv, 0, &newjbv);
+		}
+		else if (idx >= 0 && idx < nelems)
+		{
+			makeExpandedJsonbValue(ejh, newval, &newjbv);
+			setExpandedJsonbElem(ejh, jbv, idx, &newjbv);
+		}
+		else if (idx == nelems && create)
+		{
+			makeExpandedJsonbValue(ejh, newval, &newjbv);
+			insertExpandedJsonbElem(ejh, jbv, nelems, &newjbv);
+		}
+	}
+
+	/* a scalar can't be descended into, so there's nothing to do */
+}
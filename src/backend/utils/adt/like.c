@@ -22,6 +22,7 @@
 #include "catalog/pg_collation.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "port/simd.h"
 #include "utils/builtins.h"
 #include "utils/pg_locale.h"
 
@@ -30,6 +31,44 @@
 #define LIKE_FALSE						0
 #define LIKE_ABORT						(-1)
 
+/*
+ * Most patterns in practice are a literal string with at most a % at either
+ * end.  Those can be matched with memcmp() or a substring search instead of
+ * interpreting the pattern for every input string.
+ */
+typedef enum LikePatternKind
+{
+	LIKE_PATTERN_GENERIC,		/* anything else: use MatchText */
+	LIKE_PATTERN_EXACT,			/* literal */
+	LIKE_PATTERN_PREFIX,		/* literal% */
+	LIKE_PATTERN_SUFFIX,		/* %literal */
+	LIKE_PATTERN_CONTAINS		/* %literal% */
+} LikePatternKind;
+
+/*
+ * The analysis of a pattern, cached in fn_extra so that it is done only once
+ * per expression, not once per row.
+ */
+typedef struct LikePattern
+{
+	/* the pattern and collation this was built for */
+	char	   *pattern;
+	int			patlen;
+	Oid			collation;
+
+	LikePatternKind kind;
+	char	   *literal;		/* de-escaped literal, case-folded for ILIKE */
+	int			literal_len;
+
+	/* the rest is for ILIKE only */
+	char	   *lowpat;			/* lower() of the pattern, multibyte only */
+	int			lowpat_len;
+	pg_locale_t locale;			/* for SB_IMatchText */
+	bool		locale_is_c;
+	bool		fold_bytes;		/* fold input with foldtab, not lower()? */
+	char		foldtab[256];
+} LikePattern;
+
 
 static int SB_MatchText(char *t, int tlen, char *p, int plen,
 			 pg_locale_t locale, bool locale_is_c);
@@ -46,7 +85,17 @@ static int SB_IMatchText(char *t, int tlen, char *p, int plen,
 			  pg_locale_t locale, bool locale_is_c);
 
 static int	GenericMatchText(char *s, int slen, char *p, int plen);
-static int	Generic_Text_IC_like(text *str, text *pat, Oid collation);
+static int CachedMatchText(FunctionCallInfo fcinfo, char *s, int slen,
+				char *p, int plen, bool is_bytea);
+static int	Generic_Text_IC_like(FunctionCallInfo fcinfo, text *str, text *pat,
+					 Oid collation);
+
+static LikePattern *get_like_pattern(FunctionCallInfo fcinfo, char *p, int plen,
+				 bool is_bytea, bool ic, Oid collation);
+static LikePatternKind analyze_like_pattern(const char *p, int plen,
+					 bool bytewise, char *literal, int *literal_len);
+static bool match_like_literal(LikePattern *lp, const char *s, int slen);
+static bool like_memmem(const char *s, int slen, const char *n, int nlen);
 
 /*--------------------
  * Support routine for MatchText. Compares given multibyte streams
@@ -158,47 +207,147 @@ GenericMatchText(char *s, int slen, char *p, int plen)
 		return MB_MatchText(s, slen, p, plen, 0, true);
 }
 
+/* Case-sensitive LIKE, using the cached analysis of the pattern */
 static inline int
-Generic_Text_IC_like(text *str, text *pat, Oid collation)
+CachedMatchText(FunctionCallInfo fcinfo, char *s, int slen, char *p, int plen,
+				bool is_bytea)
 {
-	char	   *s,
-			   *p;
-	int			slen,
-				plen;
+	LikePattern *lp = get_like_pattern(fcinfo, p, plen, is_bytea, false,
+									   InvalidOid);
+
+	if (lp->kind != LIKE_PATTERN_GENERIC)
+		return match_like_literal(lp, s, slen) ? LIKE_TRUE : LIKE_FALSE;
+	if (is_bytea)
+		return SB_MatchText(s, slen, p, plen, 0, true);
+	return GenericMatchText(s, slen, p, plen);
+}
+
+static inline int
+Generic_Text_IC_like(FunctionCallInfo fcinfo, text *str, text *pat,
+					 Oid collation)
+{
+	char	   *s = VARDATA_ANY(str);
+	int			slen = VARSIZE_ANY_EXHDR(str);
+	char	   *p = VARDATA_ANY(pat);
+	int			plen = VARSIZE_ANY_EXHDR(pat);
+	LikePattern *lp;
+	char	   *folded = NULL;
+	int			result;
+
+	lp = get_like_pattern(fcinfo, p, plen, false, true, collation);
 
 	/*
 	 * For efficiency reasons, in the single byte case we don't call lower()
-	 * on the pattern and text, but instead call SB_lower_char on each
-	 * character.  In the multi-byte case we don't have much choice :-(
+	 * on the text, but instead call SB_lower_char on each character.  In the
+	 * multi-byte case we don't have much choice :-(, unless the collation
+	 * only folds ASCII letters.  Either way, the pattern was folded when it
+	 * was analyzed.
 	 */
+	if (lp->kind == LIKE_PATTERN_GENERIC &&
+		pg_database_encoding_max_length() == 1)
+		return SB_IMatchText(s, slen, p, plen, lp->locale, lp->locale_is_c);
 
-	if (pg_database_encoding_max_length() > 1)
+	if (lp->fold_bytes)
+	{
+		int			i;
+
+		folded = (char *) palloc(slen + 1);
+		for (i = 0; i < slen; i++)
+			folded[i] = lp->foldtab[(unsigned char) s[i]];
+		s = folded;
+	}
+	else
 	{
 		/* lower's result is never packed, so OK to use old macros here */
-		pat = DatumGetTextP(DirectFunctionCall1Coll(lower, collation,
-													PointerGetDatum(pat)));
-		p = VARDATA(pat);
-		plen = (VARSIZE(pat) - VARHDRSZ);
 		str = DatumGetTextP(DirectFunctionCall1Coll(lower, collation,
 													PointerGetDatum(str)));
 		s = VARDATA(str);
 		slen = (VARSIZE(str) - VARHDRSZ);
-		if (GetDatabaseEncoding() == PG_UTF8)
-			return UTF8_MatchText(s, slen, p, plen, 0, true);
-		else
-			return MB_MatchText(s, slen, p, plen, 0, true);
 	}
+
+	if (lp->kind != LIKE_PATTERN_GENERIC)
+		result = match_like_literal(lp, s, slen) ? LIKE_TRUE : LIKE_FALSE;
+	else if (GetDatabaseEncoding() == PG_UTF8)
+		result = UTF8_MatchText(s, slen, lp->lowpat, lp->lowpat_len, 0, true);
 	else
+		result = MB_MatchText(s, slen, lp->lowpat, lp->lowpat_len, 0, true);
+
+	if (folded)
+		pfree(folded);
+
+	return result;
+}
+
+/*
+ * Look up, or build, the analysis of pattern p for the calling expression.
+ *
+ * For ILIKE, the literal is folded to lower case the same way the input will
+ * be.  In single-byte encodings, and in multibyte encodings with a C ctype,
+ * that's a fixed mapping of bytes, which we tabulate.
+ */
+static LikePattern *
+get_like_pattern(FunctionCallInfo fcinfo, char *p, int plen, bool is_bytea,
+				 bool ic, Oid collation)
+{
+	FmgrInfo   *flinfo = fcinfo->flinfo;
+	LikePattern *lp = flinfo ? (LikePattern *) flinfo->fn_extra : NULL;
+	MemoryContext oldcxt;
+	text	   *lowpat = NULL;
+	bool		bytewise;
+	int			c;
+
+	if (lp != NULL && lp->patlen == plen && lp->collation == collation &&
+		memcmp(lp->pattern, p, plen) == 0)
+		return lp;
+
+	/*
+	 * A byte-wise search for the literal anywhere in the input is only safe
+	 * where the literal can't match part of one character and part of the
+	 * next.  UTF8 is designed that way; other multibyte encodings are not.
+	 */
+	bytewise = (is_bytea || pg_database_encoding_max_length() == 1 ||
+				GetDatabaseEncoding() == PG_UTF8);
+
+	if (ic && pg_database_encoding_max_length() > 1)
+		lowpat = DatumGetTextP(DirectFunctionCall1Coll(lower, collation,
+								PointerGetDatum(cstring_to_text_with_len(p,
+																	 plen))));
+
+	/* The pattern changed, presumably because it's not a constant */
+	if (lp != NULL)
+	{
+		pfree(lp->pattern);
+		pfree(lp->literal);
+		if (lp->lowpat)
+			pfree(lp->lowpat);
+		pfree(lp);
+		if (flinfo)
+			flinfo->fn_extra = NULL;
+	}
+
+	oldcxt = MemoryContextSwitchTo(flinfo ? flinfo->fn_mcxt :
+								   CurrentMemoryContext);
+
+	lp = (LikePattern *) palloc0(sizeof(LikePattern));
+	lp->pattern = (char *) palloc(plen + 1);
+	memcpy(lp->pattern, p, plen);
+	lp->patlen = plen;
+	lp->collation = collation;
+
+	if (!ic)
+	{
+		lp->literal = (char *) palloc(plen + 1);
+		lp->kind = analyze_like_pattern(p, plen, bytewise,
+										lp->literal, &lp->literal_len);
+	}
+	else if (lowpat == NULL)
 	{
 		/*
 		 * Here we need to prepare locale information for SB_lower_char. This
 		 * should match the methods used in str_tolower().
 		 */
-		pg_locale_t locale = 0;
-		bool		locale_is_c = false;
-
 		if (lc_ctype_is_c(collation))
-			locale_is_c = true;
+			lp->locale_is_c = true;
 		else if (collation != DEFAULT_COLLATION_OID)
 		{
 			if (!OidIsValid(collation))
@@ -212,15 +361,180 @@ Generic_Text_IC_like(text *str, text *pat, Oid collation)
 						 errmsg("could not determine which collation to use for ILIKE"),
 						 errhint("Use the COLLATE clause to set the collation explicitly.")));
 			}
-			locale = pg_newlocale_from_collation(collation);
+			lp->locale = pg_newlocale_from_collation(collation);
+		}
+
+		lp->fold_bytes = true;
+		for (c = 0; c < 256; c++)
+			lp->foldtab[c] = SB_lower_char((unsigned char) c, lp->locale,
+										   lp->locale_is_c);
+
+		lp->literal = (char *) palloc(plen + 1);
+		lp->kind = analyze_like_pattern(p, plen, bytewise,
+										lp->literal, &lp->literal_len);
+		for (c = 0; c < lp->literal_len; c++)
+			lp->literal[c] = lp->foldtab[(unsigned char) lp->literal[c]];
+	}
+	else
+	{
+		/* str_tolower() only folds ASCII letters in the C locale */
+		if (lc_ctype_is_c(collation))
+		{
+			lp->fold_bytes = true;
+			for (c = 0; c < 256; c++)
+				lp->foldtab[c] = pg_ascii_tolower((unsigned char) c);
+		}
+
+		lp->lowpat_len = VARSIZE(lowpat) - VARHDRSZ;
+		lp->lowpat = (char *) palloc(lp->lowpat_len + 1);
+		memcpy(lp->lowpat, VARDATA(lowpat), lp->lowpat_len);
+
+		lp->literal = (char *) palloc(lp->lowpat_len + 1);
+		lp->kind = analyze_like_pattern(lp->lowpat, lp->lowpat_len, bytewise,
+										lp->literal, &lp->literal_len);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	if (flinfo)
+		flinfo->fn_extra = lp;
+
+	return lp;
+}
+
+/*
+ * Classify a pattern, and if it's a literal with at most a % at either end,
+ * store the de-escaped literal in *literal, which must have room for plen
+ * bytes.
+ *
+ * Since the escape character and the wildcards are ASCII, and no byte of a
+ * multibyte character in a server encoding is, we can walk the pattern a
+ * byte at a time.  A pattern ending with an escape character is left to
+ * MatchText to complain about.
+ */
+static LikePatternKind
+analyze_like_pattern(const char *p, int plen, bool bytewise,
+					 char *literal, int *literal_len)
+{
+	bool		leading = false;
+	bool		trailing = false;
+	int			i = 0;
+	int			n = 0;
+
+	while (i < plen && p[i] == '%')
+	{
+		leading = true;
+		i++;
+	}
+
+	while (i < plen)
+	{
+		if (p[i] == '%')
+		{
+			for (; i < plen; i++)
+			{
+				if (p[i] != '%')
+					return LIKE_PATTERN_GENERIC;
+			}
+			trailing = true;
+			break;
+		}
+		else if (p[i] == '_')
+			return LIKE_PATTERN_GENERIC;
+		else if (p[i] == '\\')
+		{
+			if (++i >= plen)
+				return LIKE_PATTERN_GENERIC;
 		}
+		literal[n++] = p[i++];
+	}
+	*literal_len = n;
+
+	if (!leading)
+		return trailing ? LIKE_PATTERN_PREFIX : LIKE_PATTERN_EXACT;
+	if (!bytewise)
+		return LIKE_PATTERN_GENERIC;
+	return trailing ? LIKE_PATTERN_CONTAINS : LIKE_PATTERN_SUFFIX;
+}
 
-		p = VARDATA_ANY(pat);
-		plen = VARSIZE_ANY_EXHDR(pat);
-		s = VARDATA_ANY(str);
-		slen = VARSIZE_ANY_EXHDR(str);
-		return SB_IMatchText(s, slen, p, plen, locale, locale_is_c);
+/*
+ * Match s against a pattern that analyze_like_pattern found to be a plain
+ * literal, possibly with a % at either end.
+ */
+static bool
+match_like_literal(LikePattern *lp, const char *s, int slen)
+{
+	const char *lit = lp->literal;
+	int			len = lp->literal_len;
+
+	switch (lp->kind)
+	{
+		case LIKE_PATTERN_EXACT:
+			return slen == len && memcmp(s, lit, len) == 0;
+		case LIKE_PATTERN_PREFIX:
+			return slen >= len && memcmp(s, lit, len) == 0;
+		case LIKE_PATTERN_SUFFIX:
+			return slen >= len && memcmp(s + slen - len, lit, len) == 0;
+		case LIKE_PATTERN_CONTAINS:
+			return like_memmem(s, slen, lit, len);
+		case LIKE_PATTERN_GENERIC:
+			break;
 	}
+	elog(ERROR, "unexpected LIKE pattern kind: %d", (int) lp->kind);
+	return false;				/* keep compiler quiet */
+}
+
+/*
+ * Does s[0..slen) contain n[0..nlen)?
+ *
+ * Where the platform allows, we compare a vector of candidate positions at a
+ * time against the first and last byte of the needle, and only look closer
+ * at the positions where both match.
+ */
+static bool
+like_memmem(const char *s, int slen, const char *n, int nlen)
+{
+	int			last = slen - nlen;		/* last possible starting position */
+	int			i = 0;
+
+	if (nlen == 0)
+		return true;
+	if (last < 0)
+		return false;
+
+#ifndef USE_NO_SIMD
+	{
+		const Vector8 first_byte = vector8_broadcast(n[0]);
+		const Vector8 last_byte = vector8_broadcast(n[nlen - 1]);
+
+		for (; i + (int) sizeof(Vector8) <= last + 1; i += sizeof(Vector8))
+		{
+			Vector8		match;
+			int			j;
+
+			match = vector8_and(vector8_eq(vector8_load(s + i), first_byte),
+								vector8_eq(vector8_load(s + i + nlen - 1),
+										   last_byte));
+			if (!vector8_any(match))
+				continue;
+
+			for (j = i; j < i + (int) sizeof(Vector8); j++)
+			{
+				if (s[j] == n[0] && s[j + nlen - 1] == n[nlen - 1] &&
+					memcmp(s + j, n, nlen) == 0)
+					return true;
+			}
+		}
+	}
+#endif
+
+	for (; i <= last; i++)
+	{
+		if (s[i] == n[0] && memcmp(s + i, n, nlen) == 0)
+			return true;
+	}
+
+	return false;
 }
 
 /*
@@ -243,7 +557,7 @@ namelike(PG_FUNCTION_ARGS)
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (GenericMatchText(s, slen, p, plen) == LIKE_TRUE);
+	result = (CachedMatchText(fcinfo, s, slen, p, plen, false) == LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -264,7 +578,7 @@ namenlike(PG_FUNCTION_ARGS)
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (GenericMatchText(s, slen, p, plen) != LIKE_TRUE);
+	result = (CachedMatchText(fcinfo, s, slen, p, plen, false) != LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -285,7 +599,7 @@ textlike(PG_FUNCTION_ARGS)
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (GenericMatchText(s, slen, p, plen) == LIKE_TRUE);
+	result = (CachedMatchText(fcinfo, s, slen, p, plen, false) == LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -306,7 +620,7 @@ textnlike(PG_FUNCTION_ARGS)
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (GenericMatchText(s, slen, p, plen) != LIKE_TRUE);
+	result = (CachedMatchText(fcinfo, s, slen, p, plen, false) != LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -327,7 +641,7 @@ bytealike(PG_FUNCTION_ARGS)
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (SB_MatchText(s, slen, p, plen, 0, true) == LIKE_TRUE);
+	result = (CachedMatchText(fcinfo, s, slen, p, plen, true) == LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -348,7 +662,7 @@ byteanlike(PG_FUNCTION_ARGS)
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (SB_MatchText(s, slen, p, plen, 0, true) != LIKE_TRUE);
+	result = (CachedMatchText(fcinfo, s, slen, p, plen, true) != LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -367,7 +681,7 @@ nameiclike(PG_FUNCTION_ARGS)
 
 	strtext = DatumGetTextP(DirectFunctionCall1(name_text,
 												NameGetDatum(str)));
-	result = (Generic_Text_IC_like(strtext, pat, PG_GET_COLLATION()) == LIKE_TRUE);
+	result = (Generic_Text_IC_like(fcinfo, strtext, pat, PG_GET_COLLATION()) == LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -382,7 +696,7 @@ nameicnlike(PG_FUNCTION_ARGS)
 
 	strtext = DatumGetTextP(DirectFunctionCall1(name_text,
 												NameGetDatum(str)));
-	result = (Generic_Text_IC_like(strtext, pat, PG_GET_COLLATION()) != LIKE_TRUE);
+	result = (Generic_Text_IC_like(fcinfo, strtext, pat, PG_GET_COLLATION()) != LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -394,7 +708,7 @@ texticlike(PG_FUNCTION_ARGS)
 	text	   *pat = PG_GETARG_TEXT_PP(1);
 	bool		result;
 
-	result = (Generic_Text_IC_like(str, pat, PG_GET_COLLATION()) == LIKE_TRUE);
+	result = (Generic_Text_IC_like(fcinfo, str, pat, PG_GET_COLLATION()) == LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -406,7 +720,7 @@ texticnlike(PG_FUNCTION_ARGS)
 	text	   *pat = PG_GETARG_TEXT_PP(1);
 	bool		result;
 
-	result = (Generic_Text_IC_like(str, pat, PG_GET_COLLATION()) != LIKE_TRUE);
+	result = (Generic_Text_IC_like(fcinfo, str, pat, PG_GET_COLLATION()) != LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
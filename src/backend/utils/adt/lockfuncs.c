@@ -22,7 +22,7 @@
 
 
 /* This must match enum LockTagType! */
-static const char *const LockTagTypeNames[] = {
+const char *const LockTagTypeNames[] = {
 	"relation",
 	"extend",
 	"page",
@@ -32,7 +32,8 @@ static const char *const LockTagTypeNames[] = {
 	"speculative token",
 	"object",
 	"userlock",
-	"advisory"
+	"advisory",
+	"applytransaction"
 };
 
 /* This must match enum PredicateLockTargetType (predicate_internals.h) */
@@ -7,9 +7,12 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "lib/hyperloglog.h"
 #include "libpq/pqformat.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/inet.h"
+#include "utils/sortsupport.h"
 
 
 /*
@@ -22,6 +25,21 @@
 #define lobits(addr) \
   ((unsigned long)(((addr)->d<<16)|((addr)->e<<8)|((addr)->f)))
 
+/* sortsupport for macaddr */
+typedef struct
+{
+	int64		input_count;	/* number of non-null values seen */
+	bool		estimating;		/* true if estimating cardinality */
+
+	hyperLogLogState abbr_card; /* cardinality estimator */
+} macaddr_sortsupport_state;
+
+static int32 macaddr_cmp_internal(macaddr *a1, macaddr *a2);
+static int	macaddr_fast_cmp(Datum x, Datum y, SortSupport ssup);
+static int	macaddr_cmp_abbrev(Datum x, Datum y, SortSupport ssup);
+static bool macaddr_abbrev_abort(int memtupcount, SortSupport ssup);
+static Datum macaddr_abbrev_convert(Datum original, SortSupport ssup);
+
 /*
  *	MAC address reader.  Accepts several common notations.
  */
@@ -175,6 +193,156 @@ macaddr_cmp(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(macaddr_cmp_internal(a1, a2));
 }
 
+/*
+ * Sort support strategy routine
+ */
+Datum
+macaddr_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = macaddr_fast_cmp;
+	ssup->ssup_extra = NULL;
+
+	if (ssup->abbreviate)
+	{
+		macaddr_sortsupport_state *mss;
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+
+		mss = (macaddr_sortsupport_state *)
+			palloc(sizeof(macaddr_sortsupport_state));
+		mss->input_count = 0;
+		mss->estimating = true;
+		initHyperLogLog(&mss->abbr_card, 10);
+
+		ssup->ssup_extra = mss;
+
+		ssup->abbrev_full_comparator = ssup->comparator;
+		ssup->comparator = macaddr_cmp_abbrev;
+		ssup->abbrev_converter = macaddr_abbrev_convert;
+		ssup->abbrev_abort = macaddr_abbrev_abort;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * SortSupport comparison func
+ */
+static int
+macaddr_fast_cmp(Datum x, Datum y, SortSupport ssup)
+{
+	macaddr    *arg1 = DatumGetMacaddrP(x);
+	macaddr    *arg2 = DatumGetMacaddrP(y);
+
+	return macaddr_cmp_internal(arg1, arg2);
+}
+
+/*
+ * Abbreviated key comparison func
+ */
+static int
+macaddr_cmp_abbrev(Datum x, Datum y, SortSupport ssup)
+{
+	if (x > y)
+		return 1;
+	else if (x == y)
+		return 0;
+	else
+		return -1;
+}
+
+/*
+ * Callback for estimating effectiveness of abbreviated key optimization.
+ *
+ * With 8-byte Datums the abbreviated key holds the whole address, so there is
+ * never anything to gain by aborting: equal abbreviations mean equal values.
+ * Otherwise only 4 of the 6 bytes fit, and we give up when they turn out to
+ * be nearly all the same (say, addresses from a single vendor).
+ */
+static bool
+macaddr_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+#if SIZEOF_DATUM == 8
+	return false;
+#else
+	macaddr_sortsupport_state *mss = (macaddr_sortsupport_state *) ssup->ssup_extra;
+	double		abbr_card;
+
+	if (memtupcount < 10000 || mss->input_count < 10000 || !mss->estimating)
+		return false;
+
+	abbr_card = estimateHyperLogLog(&mss->abbr_card);
+
+	/*
+	 * If we have >100k distinct values, then even if we were sorting many
+	 * billion rows we'd likely still break even, so stop even counting.
+	 */
+	if (abbr_card > 100000.0)
+	{
+#ifdef TRACE_SORT
+		if (trace_sort)
+			elog(LOG,
+				 "macaddr_abbrev: estimation ends at cardinality %f"
+				 " after " INT64_FORMAT " values (%d rows)",
+				 abbr_card, mss->input_count, memtupcount);
+#endif
+		mss->estimating = false;
+		return false;
+	}
+
+	/* Target minimum cardinality is 1 per ~2k of non-null inputs */
+	if (abbr_card < mss->input_count / 2000.0 + 0.5)
+	{
+#ifdef TRACE_SORT
+		if (trace_sort)
+			elog(LOG,
+				 "macaddr_abbrev: aborting abbreviation at cardinality %f"
+			   " below threshold %f after " INT64_FORMAT " values (%d rows)",
+				 abbr_card, mss->input_count / 2000.0 + 0.5,
+				 mss->input_count, memtupcount);
+#endif
+		return true;
+	}
+
+	return false;
+#endif   /* SIZEOF_DATUM == 8 */
+}
+
+/*
+ * Conversion routine for sortsupport.  Packs as many leading bytes of the
+ * address as fit into a Datum, most significant byte first, so that unsigned
+ * integer comparison of the keys agrees with macaddr_cmp_internal().
+ */
+static Datum
+macaddr_abbrev_convert(Datum original, SortSupport ssup)
+{
+	macaddr_sortsupport_state *mss = (macaddr_sortsupport_state *) ssup->ssup_extra;
+	macaddr    *authoritative = DatumGetMacaddrP(original);
+	Datum		res;
+
+#if SIZEOF_DATUM == 8
+	res = ((Datum) hibits(authoritative) << 24) | (Datum) lobits(authoritative);
+#else							/* SIZEOF_DATUM != 8 */
+	res = ((Datum) authoritative->a << 24) | ((Datum) authoritative->b << 16) |
+		((Datum) authoritative->c << 8) | (Datum) authoritative->d;
+#endif
+
+	mss->input_count += 1;
+
+#if SIZEOF_DATUM != 8
+	if (mss->estimating)
+		addHyperLogLog(&mss->abbr_card,
+					   DatumGetUInt32(hash_uint32((uint32) res)));
+#endif
+
+	return res;
+}
+
 /*
  *	Boolean comparisons.
  */
@@ -0,0 +1,231 @@
+/*-------------------------------------------------------------------------
+ *
+ * mcxtfuncs.c
+ *	  Functions to show backend memory context.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/mcxtfuncs.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "mb/pg_wchar.h"
+#include "miscadmin.h"
+#include "storage/dsm.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+/* ----------
+ * The max bytes for showing names of memory contexts.
+ * ----------
+ */
+#define MEMORY_CONTEXT_NAME_DISPLAY_SIZE	1024
+
+/* number of columns of the pg_backend_memory_contexts view */
+#define PG_GET_BACKEND_MEMORY_CONTEXTS_COLS	9
+
+/*
+ * PutMemoryContextStatsTuple
+ *		Add the row for one memory context.
+ */
+static void
+PutMemoryContextStatsTuple(Tuplestorestate *tupstore, TupleDesc tupdesc,
+						   const char *name, const char *parent, int level,
+						   MemoryContextCounters *stat, Size peak_allocated)
+{
+	Datum		values[PG_GET_BACKEND_MEMORY_CONTEXTS_COLS];
+	bool		nulls[PG_GET_BACKEND_MEMORY_CONTEXTS_COLS];
+
+	memset(values, 0, sizeof(values));
+	memset(nulls, 0, sizeof(nulls));
+
+	if (name)
+	{
+		char		clipped_name[MEMORY_CONTEXT_NAME_DISPLAY_SIZE];
+		int			namelen = strlen(name);
+
+		/* Don't let a very long name blow up the output */
+		if (namelen >= MEMORY_CONTEXT_NAME_DISPLAY_SIZE)
+			namelen = pg_mbcliplen(name, namelen,
+								   MEMORY_CONTEXT_NAME_DISPLAY_SIZE - 1);
+
+		memcpy(clipped_name, name, namelen);
+		clipped_name[namelen] = '\0';
+		values[0] = CStringGetTextDatum(clipped_name);
+	}
+	else
+		nulls[0] = true;
+
+	if (parent)
+		values[1] = CStringGetTextDatum(parent);
+	else
+		nulls[1] = true;
+
+	values[2] = Int32GetDatum(level);
+	values[3] = Int64GetDatum(stat->totalspace);
+	values[4] = Int64GetDatum(stat->nblocks);
+	values[5] = Int64GetDatum(stat->freespace);
+	values[6] = Int64GetDatum(stat->freechunks);
+	values[7] = Int64GetDatum(stat->totalspace - stat->freespace);
+	values[8] = Int64GetDatum(peak_allocated);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * PutMemoryContextsStatsTupleStore
+ *		One recursion level for pg_get_backend_memory_contexts.
+ */
+static void
+PutMemoryContextsStatsTupleStore(Tuplestorestate *tupstore,
+								 TupleDesc tupdesc, MemoryContext context,
+								 const char *parent, int level)
+{
+	MemoryContextCounters stat;
+	MemoryContext child;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	/* Examine the context itself */
+	memset(&stat, 0, sizeof(stat));
+	(*context->methods->stats) (context, level, false, &stat);
+
+	PutMemoryContextStatsTuple(tupstore, tupdesc, context->name, parent, level,
+							   &stat, context->peak_allocated);
+
+	for (child = context->firstchild; child != NULL; child = child->nextchild)
+	{
+		PutMemoryContextsStatsTupleStore(tupstore, tupdesc,
+										 child, context->name, level + 1);
+	}
+}
+
+/*
+ * Set up to return the rows of a memory context SRF in a tuplestore.
+ */
+static Tuplestorestate *
+BeginMemoryContextsTupleStore(FunctionCallInfo fcinfo,
+							  TupleDesc *result_tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	/* need to build tuplestore in query context */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore =
+		tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random,
+							  false, work_mem);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	*result_tupdesc = tupdesc;
+	return tupstore;
+}
+
+/*
+ * pg_get_backend_memory_contexts
+ *		SQL SRF showing backend memory context.
+ */
+Datum
+pg_get_backend_memory_contexts(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+
+	tupstore = BeginMemoryContextsTupleStore(fcinfo, &tupdesc);
+
+	PutMemoryContextsStatsTupleStore(tupstore, tupdesc,
+									 TopMemoryContext, NULL, 0);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_get_process_memory_contexts
+ *		SQL SRF showing the memory contexts of any backend.
+ *
+ * The other backend is signalled to write its statistics into a DSM
+ * segment we supply, see RequestMemoryContextDump.  Nothing is returned if
+ * it doesn't respond.
+ */
+Datum
+pg_get_process_memory_contexts(PG_FUNCTION_ARGS)
+{
+	int			pid = PG_GETARG_INT32(0);
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	dsm_segment *seg;
+
+	tupstore = BeginMemoryContextsTupleStore(fcinfo, &tupdesc);
+
+	if (pid == MyProcPid)
+	{
+		PutMemoryContextsStatsTupleStore(tupstore, tupdesc,
+										 TopMemoryContext, NULL, 0);
+		tuplestore_donestoring(tupstore);
+		return (Datum) 0;
+	}
+
+	seg = RequestMemoryContextDump(pid);
+	if (seg != NULL)
+	{
+		MemoryContextDump *dump;
+		int			i;
+
+		dump = (MemoryContextDump *) dsm_segment_address(seg);
+		for (i = 0; i < dump->ncontexts; i++)
+		{
+			MemoryContextDumpEntry *entry = &dump->entries[i];
+
+			PutMemoryContextStatsTuple(tupstore, tupdesc, entry->name,
+									   entry->parent >= 0 ?
+									   dump->entries[entry->parent].name :
+									   NULL,
+									   entry->level, &entry->counters,
+									   entry->peak_allocated);
+		}
+		if (dump->nmissing > 0)
+			ereport(NOTICE,
+					(errmsg("%d memory contexts of PID %d did not fit in the result",
+							dump->nmissing, pid)));
+		dsm_detach(seg);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
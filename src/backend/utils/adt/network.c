@@ -14,15 +14,33 @@
 
 #include "access/hash.h"
 #include "catalog/pg_type.h"
+#include "lib/hyperloglog.h"
 #include "libpq/ip.h"
 #include "libpq/libpq-be.h"
 #include "libpq/pqformat.h"
 #include "miscadmin.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/inet.h"
+#include "utils/sortsupport.h"
 
 
+/* sortsupport for inet/cidr */
+typedef struct
+{
+	int64		input_count;	/* number of non-null values seen */
+	bool		estimating;		/* true if estimating cardinality */
+
+	hyperLogLogState abbr_card; /* cardinality estimator */
+} network_sortsupport_state;
+
 static int32 network_cmp_internal(inet *a1, inet *a2);
+static int	network_fast_cmp(Datum x, Datum y, SortSupport ssup);
+#if SIZEOF_DATUM == 8
+static int	network_cmp_abbrev(Datum x, Datum y, SortSupport ssup);
+static bool network_abbrev_abort(int memtupcount, SortSupport ssup);
+static Datum network_abbrev_convert(Datum original, SortSupport ssup);
+#endif
 static bool addressOK(unsigned char *a, int bits, int family);
 static inet *internal_inetpl(inet *ip, int64 addend);
 
@@ -414,6 +432,212 @@ network_cmp(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(network_cmp_internal(a1, a2));
 }
 
+/*
+ * Sort support strategy routine
+ */
+Datum
+network_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = network_fast_cmp;
+	ssup->ssup_extra = NULL;
+
+	/*
+	 * The abbreviated key encoding below needs 64 bits to be of any use, so
+	 * with 4-byte Datums we only save the fmgr overhead.
+	 */
+#if SIZEOF_DATUM == 8
+	if (ssup->abbreviate)
+	{
+		network_sortsupport_state *nss;
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(ssup->ssup_cxt);
+
+		nss = (network_sortsupport_state *)
+			palloc(sizeof(network_sortsupport_state));
+		nss->input_count = 0;
+		nss->estimating = true;
+		initHyperLogLog(&nss->abbr_card, 10);
+
+		ssup->ssup_extra = nss;
+
+		ssup->abbrev_full_comparator = ssup->comparator;
+		ssup->comparator = network_cmp_abbrev;
+		ssup->abbrev_converter = network_abbrev_convert;
+		ssup->abbrev_abort = network_abbrev_abort;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+#endif
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * SortSupport comparison func
+ */
+static int
+network_fast_cmp(Datum x, Datum y, SortSupport ssup)
+{
+	inet	   *arg1 = DatumGetInetPP(x);
+	inet	   *arg2 = DatumGetInetPP(y);
+	int			result;
+
+	result = network_cmp_internal(arg1, arg2);
+
+	/* We can't afford to leak memory here. */
+	if (PointerGetDatum(arg1) != x)
+		pfree(arg1);
+	if (PointerGetDatum(arg2) != y)
+		pfree(arg2);
+
+	return result;
+}
+
+#if SIZEOF_DATUM == 8
+
+/*
+ * Abbreviated key comparison func
+ */
+static int
+network_cmp_abbrev(Datum x, Datum y, SortSupport ssup)
+{
+	if (x > y)
+		return 1;
+	else if (x == y)
+		return 0;
+	else
+		return -1;
+}
+
+/*
+ * Callback for estimating effectiveness of abbreviated key optimization.
+ *
+ * As with uuid, the cardinality of the authoritative values is not tracked,
+ * since there is no cheap equality fast path in network_cmp_internal().
+ */
+static bool
+network_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	network_sortsupport_state *nss = (network_sortsupport_state *) ssup->ssup_extra;
+	double		abbr_card;
+
+	if (memtupcount < 10000 || nss->input_count < 10000 || !nss->estimating)
+		return false;
+
+	abbr_card = estimateHyperLogLog(&nss->abbr_card);
+
+	/*
+	 * If we have >100k distinct values, then even if we were sorting many
+	 * billion rows we'd likely still break even, so stop even counting.
+	 */
+	if (abbr_card > 100000.0)
+	{
+#ifdef TRACE_SORT
+		if (trace_sort)
+			elog(LOG,
+				 "network_abbrev: estimation ends at cardinality %f"
+				 " after " INT64_FORMAT " values (%d rows)",
+				 abbr_card, nss->input_count, memtupcount);
+#endif
+		nss->estimating = false;
+		return false;
+	}
+
+	/* Target minimum cardinality is 1 per ~2k of non-null inputs */
+	if (abbr_card < nss->input_count / 2000.0 + 0.5)
+	{
+#ifdef TRACE_SORT
+		if (trace_sort)
+			elog(LOG,
+				 "network_abbrev: aborting abbreviation at cardinality %f"
+			   " below threshold %f after " INT64_FORMAT " values (%d rows)",
+				 abbr_card, nss->input_count / 2000.0 + 0.5,
+				 nss->input_count, memtupcount);
+#endif
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Conversion routine for sortsupport.
+ *
+ * network_cmp_internal() orders by family, then by the network part of the
+ * address, then by netmask length, and finally by the whole address.  That is
+ * the same as ordering by (family, address & netmask, netmask length, address
+ * & ~netmask), because when the shorter netmask's bits agree, the longer
+ * network can only have more bits set.  So we pack those fields into the
+ * Datum, most significant first:
+ *
+ * IPv4:	1 bit family (0), 32 bits network, 6 bits netmask length, and the
+ *			top 25 bits of the host part
+ * IPv6:	1 bit family (1), and the top 63 bits of the network
+ *
+ * Truncating the trailing field keeps the order, but makes ties possible;
+ * those are resolved by the authoritative comparator.
+ */
+static Datum
+network_abbrev_convert(Datum original, SortSupport ssup)
+{
+	network_sortsupport_state *nss = (network_sortsupport_state *) ssup->ssup_extra;
+	inet	   *authoritative = DatumGetInetPP(original);
+	unsigned char *addr = ip_addr(authoritative);
+	int			bits = ip_bits(authoritative);
+	uint64		res;
+	uint64		ipaddr = 0;
+	uint64		netmask;
+	int			i;
+
+	if (ip_family(authoritative) == PGSQL_AF_INET)
+	{
+		for (i = 0; i < 4; i++)
+			ipaddr = (ipaddr << BITS_PER_BYTE) | addr[i];
+
+		netmask = (bits == 0) ? 0 : (UINT64CONST(0xFFFFFFFF) << (32 - bits)) &
+			UINT64CONST(0xFFFFFFFF);
+
+		res = ((ipaddr & netmask) << 31) |
+			((uint64) bits << 25) |
+			((ipaddr & ~netmask) >> 7);
+	}
+	else
+	{
+		for (i = 0; i < 8; i++)
+			ipaddr = (ipaddr << BITS_PER_BYTE) | addr[i];
+
+		if (bits >= 64)
+			netmask = ~UINT64CONST(0);
+		else if (bits == 0)
+			netmask = 0;
+		else
+			netmask = ~UINT64CONST(0) << (64 - bits);
+
+		res = (UINT64CONST(1) << 63) | ((ipaddr & netmask) >> 1);
+	}
+
+	nss->input_count += 1;
+
+	if (nss->estimating)
+	{
+		uint32		tmp;
+
+		tmp = (uint32) res ^ (uint32) (res >> 32);
+		addHyperLogLog(&nss->abbr_card, DatumGetUInt32(hash_uint32(tmp)));
+	}
+
+	/* Don't leak memory here */
+	if (PointerGetDatum(authoritative) != original)
+		pfree(authoritative);
+
+	return (Datum) res;
+}
+
+#endif   /* SIZEOF_DATUM == 8 */
+
 /*
  *	Boolean ordering tests.
  */
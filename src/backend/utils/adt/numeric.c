@@ -3145,6 +3145,10 @@ typedef struct NumericAggState
 	int			maxScale;		/* maximum scale seen so far */
 	int64		maxScaleCount;	/* number of values seen with maximum scale */
 	int64		NaNcount;		/* count of NaN values (not included in N!) */
+#ifdef HAVE_INT128
+	int128		sumXInt;		/* rest of the sum, times 10^intScale */
+	int			intScale;		/* maximum scale of inputs in sumXInt */
+#endif
 } NumericAggState;
 
 /*
@@ -3172,6 +3176,206 @@ makeNumericAggState(FunctionCallInfo fcinfo, bool calcSumX2)
 	return state;
 }
 
+#ifdef HAVE_INT128
+/*
+ * sum(numeric) and avg(numeric) don't need NumericVar arithmetic for most
+ * inputs.  An input whose value times 10^dscale fits in an int64, and whose
+ * dscale is at most NUMERIC_INT_SUM_MAX_SCALE, is instead added to sumXInt,
+ * a 128-bit integer holding the rest of the sum scaled by 10^intScale; the
+ * true sum is always sumX + sumXInt / 10^intScale.  intScale only grows, to
+ * the largest dscale seen, so the sum gets the same display scale add_var
+ * would have given it.  Inputs that don't qualify go to sumX as before, and
+ * whenever sumXInt gets within a few bits of overflowing it is flushed into
+ * sumX, so the sum is always exact.
+ *
+ * Aggregates that need sumX2 don't use this.
+ */
+#define NUMERIC_INT_SUM_MAX_SCALE	18
+#define NUMERIC_INT_SUM_LIMIT		(((int128) 1) << 124)
+
+static const int64 int_sum_pow10[NUMERIC_INT_SUM_MAX_SCALE + 1] = {
+	INT64CONST(1),
+	INT64CONST(10),
+	INT64CONST(100),
+	INT64CONST(1000),
+	INT64CONST(10000),
+	INT64CONST(100000),
+	INT64CONST(1000000),
+	INT64CONST(10000000),
+	INT64CONST(100000000),
+	INT64CONST(1000000000),
+	INT64CONST(10000000000),
+	INT64CONST(100000000000),
+	INT64CONST(1000000000000),
+	INT64CONST(10000000000000),
+	INT64CONST(100000000000000),
+	INT64CONST(1000000000000000),
+	INT64CONST(10000000000000000),
+	INT64CONST(100000000000000000),
+	INT64CONST(1000000000000000000)
+};
+
+/*
+ * Convert a NumericVar to its value times 10^dscale.  Returns false if that
+ * doesn't fit in an int64 or the dscale is too large for the integer sum.
+ */
+static bool
+numericvar_to_scaled_int64(NumericVar *var, int64 *result)
+{
+	int128		val = 0;
+	int			exp;
+	int			i;
+
+	if (var->ndigits == 0)
+	{
+		*result = 0;
+		return var->dscale <= NUMERIC_INT_SUM_MAX_SCALE;
+	}
+	if (var->dscale > NUMERIC_INT_SUM_MAX_SCALE ||
+		var->ndigits > 36 / DEC_DIGITS)
+		return false;
+
+	for (i = 0; i < var->ndigits; i++)
+		val = val * NBASE + var->digits[i];
+
+	/*
+	 * val is the value times NBASE^(ndigits - 1 - weight).  The digits past
+	 * dscale are zero, so if that's more than 10^dscale, dividing is exact
+	 * and by less than NBASE.
+	 */
+	exp = var->dscale - (var->ndigits - 1 - var->weight) * DEC_DIGITS;
+	if (exp >= 0)
+	{
+		if (exp > NUMERIC_INT_SUM_MAX_SCALE ||
+			val > PG_INT64_MAX / int_sum_pow10[exp])
+			return false;
+		val *= int_sum_pow10[exp];
+	}
+	else
+	{
+		if (-exp >= DEC_DIGITS || val % int_sum_pow10[-exp] != 0)
+			return false;		/* not normalized; play safe */
+		val /= int_sum_pow10[-exp];
+		if (val > PG_INT64_MAX)
+			return false;
+	}
+
+	*result = (var->sign == NUMERIC_NEG) ? -(int64) val : (int64) val;
+	return true;
+}
+
+/*
+ * Convert val / 10^scale to a NumericVar with dscale scale.
+ */
+static void
+int128_scaled_to_numericvar(int128 val, int scale, NumericVar *var)
+{
+	int			pad = (DEC_DIGITS - scale % DEC_DIGITS) % DEC_DIGITS;
+
+	int128_to_numericvar(val, var);
+	if (var->ndigits > 0)
+	{
+		/* pad to a whole number of NBASE digits, then shift the point */
+		if (pad > 0)
+		{
+			NumericVar	factor;
+
+			init_var(&factor);
+			int64_to_numericvar(int_sum_pow10[pad], &factor);
+			mul_var(var, &factor, var, 0);
+			free_var(&factor);
+		}
+		var->weight -= (scale + pad) / DEC_DIGITS;
+	}
+	var->dscale = scale;
+}
+
+/*
+ * Move the integer part of the sum into sumX.  Must be called in the
+ * aggregate context.
+ */
+static void
+numeric_int_sum_flush(NumericAggState *state)
+{
+	NumericVar	tmp;
+
+	if (state->sumXInt == 0)
+		return;
+
+	init_var(&tmp);
+	int128_scaled_to_numericvar(state->sumXInt, state->intScale, &tmp);
+	add_var(&tmp, &(state->sumX), &(state->sumX));
+	free_var(&tmp);
+	state->sumXInt = 0;
+}
+
+/*
+ * Add val / 10^scale to the integer part of the sum.  The absolute value of
+ * val must not exceed NUMERIC_INT_SUM_LIMIT.  Must be called in the
+ * aggregate context.
+ */
+static void
+numeric_int_sum_add(NumericAggState *state, int128 val, int scale)
+{
+	if (scale > state->intScale)
+	{
+		int64		factor = int_sum_pow10[scale - state->intScale];
+
+		if (state->sumXInt > NUMERIC_INT_SUM_LIMIT / factor ||
+			state->sumXInt < -NUMERIC_INT_SUM_LIMIT / factor)
+			numeric_int_sum_flush(state);
+		state->sumXInt *= factor;
+		state->intScale = scale;
+	}
+	else if (scale < state->intScale)
+	{
+		int64		factor = int_sum_pow10[state->intScale - scale];
+
+		if (val > NUMERIC_INT_SUM_LIMIT / factor ||
+			val < -NUMERIC_INT_SUM_LIMIT / factor)
+		{
+			/* too big to rescale, so add it the slow way */
+			NumericVar	tmp;
+
+			init_var(&tmp);
+			int128_scaled_to_numericvar(val, scale, &tmp);
+			add_var(&tmp, &(state->sumX), &(state->sumX));
+			free_var(&tmp);
+			return;
+		}
+		val *= factor;
+	}
+
+	state->sumXInt += val;
+	if (state->sumXInt > NUMERIC_INT_SUM_LIMIT ||
+		state->sumXInt < -NUMERIC_INT_SUM_LIMIT)
+		numeric_int_sum_flush(state);
+}
+#endif   /* HAVE_INT128 */
+
+/*
+ * Compute the sum of the inputs of a numeric aggregate into result, which
+ * must have been initialized.  The state is not modified.
+ */
+static void
+numeric_agg_state_sum(NumericAggState *state, NumericVar *result)
+{
+	set_var_from_var(&(state->sumX), result);
+
+#ifdef HAVE_INT128
+	if (!state->calcSumX2)
+	{
+		NumericVar	tmp;
+
+		/* this also applies intScale to the result's dscale */
+		init_var(&tmp);
+		int128_scaled_to_numericvar(state->sumXInt, state->intScale, &tmp);
+		add_var(&tmp, result, result);
+		free_var(&tmp);
+	}
+#endif
+}
+
 /*
  * Accumulate a new input value for numeric aggregate functions.
  */
@@ -3181,6 +3385,9 @@ do_numeric_accum(NumericAggState *state, Numeric newval)
 	NumericVar	X;
 	NumericVar	X2;
 	MemoryContext old_context;
+#ifdef HAVE_INT128
+	int64		intval;
+#endif
 
 	/* Count NaN inputs separately from all else */
 	if (NUMERIC_IS_NAN(newval))
@@ -3214,6 +3421,24 @@ do_numeric_accum(NumericAggState *state, Numeric newval)
 	/* The rest of this needs to work in the aggregate context */
 	old_context = MemoryContextSwitchTo(state->agg_context);
 
+#ifdef HAVE_INT128
+	if (!state->calcSumX2 && numericvar_to_scaled_int64(&X, &intval))
+	{
+		if (state->N++ == 0)
+		{
+			/* First input, so initialize sums */
+			zero_var(&(state->sumX));
+			state->sumX.dscale = 0;
+			state->sumXInt = 0;
+			state->intScale = 0;
+		}
+		numeric_int_sum_add(state, intval, X.dscale);
+
+		MemoryContextSwitchTo(old_context);
+		return;
+	}
+#endif
+
 	if (state->N++ > 0)
 	{
 		/* Accumulate sums */
@@ -3229,6 +3454,10 @@ do_numeric_accum(NumericAggState *state, Numeric newval)
 
 		if (state->calcSumX2)
 			set_var_from_var(&X2, &(state->sumX2));
+#ifdef HAVE_INT128
+		state->sumXInt = 0;
+		state->intScale = 0;
+#endif
 	}
 
 	MemoryContextSwitchTo(old_context);
@@ -3255,6 +3484,9 @@ do_numeric_discard(NumericAggState *state, Numeric newval)
 	NumericVar	X;
 	NumericVar	X2;
 	MemoryContext old_context;
+#ifdef HAVE_INT128
+	int64		intval;
+#endif
 
 	/* Count NaN inputs separately from all else */
 	if (NUMERIC_IS_NAN(newval))
@@ -3309,7 +3541,12 @@ do_numeric_discard(NumericAggState *state, Numeric newval)
 	if (state->N-- > 1)
 	{
 		/* De-accumulate sums */
-		sub_var(&(state->sumX), &X, &(state->sumX));
+#ifdef HAVE_INT128
+		if (!state->calcSumX2 && numericvar_to_scaled_int64(&X, &intval))
+			numeric_int_sum_add(state, -(int128) intval, X.dscale);
+		else
+#endif
+			sub_var(&(state->sumX), &X, &(state->sumX));
 
 		if (state->calcSumX2)
 			sub_var(&(state->sumX2), &X2, &(state->sumX2));
@@ -3391,6 +3628,66 @@ numeric_accum_inv(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * Combine function for sum(numeric) and avg(numeric): merge the second
+ * transition state into the first.  This can't be strict, since it must
+ * create the first state if the combining Agg hasn't got one yet.
+ */
+Datum
+numeric_avg_combine(PG_FUNCTION_ARGS)
+{
+	NumericAggState *state1;
+	NumericAggState *state2;
+	MemoryContext old_context;
+
+	state1 = PG_ARGISNULL(0) ? NULL : (NumericAggState *) PG_GETARG_POINTER(0);
+	state2 = PG_ARGISNULL(1) ? NULL : (NumericAggState *) PG_GETARG_POINTER(1);
+
+	if (state2 == NULL)
+		PG_RETURN_POINTER(state1);
+
+	/* Create the state data on the first call */
+	if (state1 == NULL)
+		state1 = makeNumericAggState(fcinfo, false);
+
+	state1->NaNcount += state2->NaNcount;
+
+	if (state2->N > 0)
+	{
+		old_context = MemoryContextSwitchTo(state1->agg_context);
+
+		if (state1->N == 0)
+		{
+			/* sums may be stale after inverse transitions */
+			zero_var(&(state1->sumX));
+			state1->sumX.dscale = 0;
+#ifdef HAVE_INT128
+			state1->sumXInt = 0;
+			state1->intScale = 0;
+#endif
+		}
+		state1->N += state2->N;
+
+		if (state2->maxScale > state1->maxScale)
+		{
+			state1->maxScale = state2->maxScale;
+			state1->maxScaleCount = state2->maxScaleCount;
+		}
+		else if (state2->maxScale == state1->maxScale)
+			state1->maxScaleCount += state2->maxScaleCount;
+
+		add_var(&(state2->sumX), &(state1->sumX), &(state1->sumX));
+#ifdef HAVE_INT128
+		numeric_int_sum_add(state1, state2->sumXInt, state2->intScale);
+#endif
+
+		MemoryContextSwitchTo(old_context);
+	}
+
+	PG_RETURN_POINTER(state1);
+}
+
+
 /*
  * Integer data types in general use Numeric accumulators to share code
  * and avoid risk of overflow.
@@ -3762,6 +4059,7 @@ Datum
 numeric_avg(PG_FUNCTION_ARGS)
 {
 	NumericAggState *state;
+	NumericVar	sumX;
 	Datum		N_datum;
 	Datum		sumX_datum;
 
@@ -3774,8 +4072,12 @@ numeric_avg(PG_FUNCTION_ARGS)
 	if (state->NaNcount > 0)	/* there was at least one NaN input */
 		PG_RETURN_NUMERIC(make_result(&const_nan));
 
+	init_var(&sumX);
+	numeric_agg_state_sum(state, &sumX);
+
 	N_datum = DirectFunctionCall1(int8_numeric, Int64GetDatum(state->N));
-	sumX_datum = NumericGetDatum(make_result(&state->sumX));
+	sumX_datum = NumericGetDatum(make_result(&sumX));
+	free_var(&sumX);
 
 	PG_RETURN_DATUM(DirectFunctionCall2(numeric_div, sumX_datum, N_datum));
 }
@@ -3784,6 +4086,8 @@ Datum
 numeric_sum(PG_FUNCTION_ARGS)
 {
 	NumericAggState *state;
+	NumericVar	sumX;
+	Numeric		result;
 
 	state = PG_ARGISNULL(0) ? NULL : (NumericAggState *) PG_GETARG_POINTER(0);
 
@@ -3794,7 +4098,12 @@ numeric_sum(PG_FUNCTION_ARGS)
 	if (state->NaNcount > 0)	/* there was at least one NaN input */
 		PG_RETURN_NUMERIC(make_result(&const_nan));
 
-	PG_RETURN_NUMERIC(make_result(&(state->sumX)));
+	init_var(&sumX);
+	numeric_agg_state_sum(state, &sumX);
+	result = make_result(&sumX);
+	free_var(&sumX);
+
+	PG_RETURN_NUMERIC(result);
 }
 
 /*
@@ -4306,6 +4615,44 @@ int4_avg_accum(PG_FUNCTION_ARGS)
 	PG_RETURN_ARRAYTYPE_P(transarray);
 }
 
+/*
+ * int4_avg_combine
+ *
+ * Combine function for the int2/int4 avg and sum accumulators: add up the
+ * counts and sums of two {count, sum} transition arrays.
+ */
+Datum
+int4_avg_combine(PG_FUNCTION_ARGS)
+{
+	ArrayType  *transarray1;
+	ArrayType  *transarray2;
+	Int8TransTypeData *state1;
+	Int8TransTypeData *state2;
+
+	/* see int4_avg_accum */
+	if (AggCheckCallContext(fcinfo, NULL))
+		transarray1 = PG_GETARG_ARRAYTYPE_P(0);
+	else
+		transarray1 = PG_GETARG_ARRAYTYPE_P_COPY(0);
+	transarray2 = PG_GETARG_ARRAYTYPE_P(1);
+
+	if (ARR_HASNULL(transarray1) ||
+		ARR_SIZE(transarray1) != ARR_OVERHEAD_NONULLS(1) + sizeof(Int8TransTypeData))
+		elog(ERROR, "expected 2-element int8 array");
+
+	if (ARR_HASNULL(transarray2) ||
+		ARR_SIZE(transarray2) != ARR_OVERHEAD_NONULLS(1) + sizeof(Int8TransTypeData))
+		elog(ERROR, "expected 2-element int8 array");
+
+	state1 = (Int8TransTypeData *) ARR_DATA_PTR(transarray1);
+	state2 = (Int8TransTypeData *) ARR_DATA_PTR(transarray2);
+
+	state1->count += state2->count;
+	state1->sum += state2->sum;
+
+	PG_RETURN_ARRAYTYPE_P(transarray1);
+}
+
 Datum
 int2_avg_accum_inv(PG_FUNCTION_ARGS)
 {
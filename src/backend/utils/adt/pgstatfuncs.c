@@ -15,14 +15,19 @@
 #include "postgres.h"
 
 #include "access/htup_details.h"
+#include "catalog/pg_tablespace.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "libpq/ip.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "storage/procarray.h"
 #include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/inet.h"
+#include "utils/profiler.h"
+#include "utils/relfilenodemap.h"
 #include "utils/timestamp.h"
 
 /* bogus ... these externs should be in a header file */
@@ -82,6 +87,7 @@ extern Datum pg_stat_get_db_conflict_bufferpin(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_conflict_startup_deadlock(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_conflict_all(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_deadlocks(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_db_overflowed_snapshots(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_stat_reset_time(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_temp_files(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_temp_bytes(PG_FUNCTION_ARGS);
@@ -89,6 +95,8 @@ extern Datum pg_stat_get_db_blk_read_time(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_db_blk_write_time(PG_FUNCTION_ARGS);
 
 extern Datum pg_stat_get_archiver(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_io_latency(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_profile_samples(PG_FUNCTION_ARGS);
 
 extern Datum pg_stat_get_bgwriter_timed_checkpoints(PG_FUNCTION_ARGS);
 extern Datum pg_stat_get_bgwriter_requested_checkpoints(PG_FUNCTION_ARGS);
@@ -530,7 +538,7 @@ pg_stat_get_backend_idset(PG_FUNCTION_ARGS)
 Datum
 pg_stat_get_activity(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_ACTIVITY_COLS	22
+#define PG_STAT_GET_ACTIVITY_COLS	24
 	int			num_backends = pgstat_fetch_stat_numbackends();
 	int			curr_backend;
 	int			pid = PG_ARGISNULL(0) ? -1 : PG_GETARG_INT32(0);
@@ -645,6 +653,9 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 		if (has_privs_of_role(GetUserId(), beentry->st_userid))
 		{
 			SockAddr	zero_clientaddr;
+			volatile PGPROC *proc;
+			const char *wait_event_type;
+			const char *wait_event;
 
 			switch (beentry->st_state)
 			{
@@ -674,6 +685,31 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 			values[5] = CStringGetTextDatum(beentry->st_activity);
 			values[6] = BoolGetDatum(beentry->st_waiting);
 
+			/* The process may have changed its wait event since; no matter */
+			proc = BackendPidGetProc(beentry->st_procpid);
+			if (proc != NULL)
+			{
+				uint32		raw_wait_event = proc->wait_event_info;
+
+				wait_event_type = pgstat_get_wait_event_type(raw_wait_event);
+				wait_event = pgstat_get_wait_event(raw_wait_event);
+			}
+			else
+			{
+				wait_event_type = NULL;
+				wait_event = NULL;
+			}
+
+			if (wait_event_type)
+				values[22] = CStringGetTextDatum(wait_event_type);
+			else
+				nulls[22] = true;
+
+			if (wait_event)
+				values[23] = CStringGetTextDatum(wait_event);
+			else
+				nulls[23] = true;
+
 			if (beentry->st_xact_start_timestamp != 0)
 				values[7] = TimestampTzGetDatum(beentry->st_xact_start_timestamp);
 			else
@@ -775,6 +811,8 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 			nulls[11] = true;
 			nulls[12] = true;
 			nulls[13] = true;
+			nulls[22] = true;
+			nulls[23] = true;
 		}
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -1364,6 +1402,21 @@ pg_stat_get_db_deadlocks(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(result);
 }
 
+Datum
+pg_stat_get_db_overflowed_snapshots(PG_FUNCTION_ARGS)
+{
+	Oid			dbid = PG_GETARG_OID(0);
+	int64		result;
+	PgStat_StatDBEntry *dbentry;
+
+	if ((dbentry = pgstat_fetch_stat_dbentry(dbid)) == NULL)
+		result = 0;
+	else
+		result = (int64) (dbentry->n_overflowed_snapshots);
+
+	PG_RETURN_INT64(result);
+}
+
 Datum
 pg_stat_get_db_blk_read_time(PG_FUNCTION_ARGS)
 {
@@ -1775,3 +1828,198 @@ pg_stat_get_archiver(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(HeapTupleGetDatum(
 								   heap_form_tuple(tupdesc, values, nulls)));
 }
+
+/*
+ * Returns the read, write and fsync latencies of relation files and
+ * tablespaces, one row per file or tablespace and operation.  Tablespace
+ * totals have database and relfilenode set to 0.
+ */
+Datum
+pg_stat_get_io_latency(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_IO_LATENCY_COLS	8
+	static const char *const opnames[PGSTAT_NUM_IO_OPS] = {
+		"read", "write", "fsync"
+	};
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	PgStat_StatIOEntry *entries;
+	int			nentries;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	entries = pgstat_fetch_io_latency(&nentries);
+
+	for (i = 0; i < nentries; i++)
+	{
+		PgStat_StatIOEntry *entry = &entries[i];
+		Oid			relid = InvalidOid;
+		int			op;
+
+		/*
+		 * We can only map relfilenodes of our own database and of shared
+		 * relations back to a relation.
+		 */
+		if (OidIsValid(entry->rnode.relNode) &&
+			(entry->rnode.dbNode == MyDatabaseId ||
+			 (entry->rnode.dbNode == InvalidOid &&
+			  entry->rnode.spcNode == GLOBALTABLESPACE_OID)))
+			relid = RelidByRelfilenode(entry->rnode.spcNode,
+									   entry->rnode.relNode);
+
+		for (op = 0; op < PGSTAT_NUM_IO_OPS; op++)
+		{
+			PgStat_IOLatency *lat = &entry->ops[op];
+			Datum		values[PG_STAT_GET_IO_LATENCY_COLS];
+			bool		nulls[PG_STAT_GET_IO_LATENCY_COLS];
+			Datum		hist[PGSTAT_IO_HIST_BUCKETS];
+			int			j;
+
+			if (lat->count == 0)
+				continue;
+
+			MemSet(nulls, 0, sizeof(nulls));
+
+			for (j = 0; j < PGSTAT_IO_HIST_BUCKETS; j++)
+				hist[j] = Int64GetDatum(lat->hist[j]);
+
+			values[0] = ObjectIdGetDatum(entry->rnode.spcNode);
+			values[1] = ObjectIdGetDatum(entry->rnode.dbNode);
+			values[2] = ObjectIdGetDatum(entry->rnode.relNode);
+			if (OidIsValid(relid))
+				values[3] = ObjectIdGetDatum(relid);
+			else
+				nulls[3] = true;
+			values[4] = CStringGetTextDatum(opnames[op]);
+			values[5] = Int64GetDatum(lat->count);
+			/* convert counter from microsec to millisec for display */
+			values[6] = Float8GetDatum(((double) lat->total_time) / 1000.0);
+			values[7] = PointerGetDatum(construct_array(hist,
+														PGSTAT_IO_HIST_BUCKETS,
+														INT8OID, sizeof(int64),
+														FLOAT8PASSBYVAL, 'd'));
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the samples currently held by the sampling profiler.
+ */
+Datum
+pg_stat_get_profile_samples(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PROFILE_SAMPLES_COLS	7
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	ProfileSample *samples;
+	int			nsamples;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	samples = profile_fetch_samples(&nsamples);
+
+	for (i = 0; i < nsamples; i++)
+	{
+		ProfileSample *sample = &samples[i];
+		Datum		values[PG_STAT_GET_PROFILE_SAMPLES_COLS];
+		bool		nulls[PG_STAT_GET_PROFILE_SAMPLES_COLS];
+		const char *node_type;
+		const char *wait_event_type;
+		const char *wait_event;
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = TimestampTzGetDatum(sample->sample_time);
+		values[1] = Int32GetDatum(sample->pid);
+		values[2] = ObjectIdGetDatum(sample->databaseid);
+		if (sample->queryid != 0)
+			values[3] = Int64GetDatum((int64) sample->queryid);
+		else
+			nulls[3] = true;
+
+		node_type = profile_plan_node_name(sample->plan_node);
+		if (node_type)
+			values[4] = CStringGetTextDatum(node_type);
+		else
+			nulls[4] = true;
+
+		wait_event_type = pgstat_get_wait_event_type(sample->wait_event_info);
+		wait_event = pgstat_get_wait_event(sample->wait_event_info);
+		if (wait_event_type)
+			values[5] = CStringGetTextDatum(wait_event_type);
+		else
+			nulls[5] = true;
+		if (wait_event)
+			values[6] = CStringGetTextDatum(wait_event);
+		else
+			nulls[6] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -19,6 +19,7 @@
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/rangetypes.h"
+#include "utils/sortsupport.h"
 
 
 /*
@@ -694,6 +695,75 @@ range_gist_same(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(result);
 }
 
+/*
+ * Sort support comparator for sorted GiST index build: orders ranges by
+ * lower bound and then upper bound, with empty ranges first, as range_cmp
+ * does.  Ranges next to each other in this order are likely to belong in
+ * the same index page.
+ */
+static int
+range_gist_sort_cmp(Datum a, Datum b, SortSupport ssup)
+{
+	RangeType  *r1 = DatumGetRangeType(a);
+	RangeType  *r2 = DatumGetRangeType(b);
+	TypeCacheEntry *typcache = (TypeCacheEntry *) ssup->ssup_extra;
+	RangeBound	lower1,
+				lower2;
+	RangeBound	upper1,
+				upper2;
+	bool		empty1,
+				empty2;
+	int			cmp;
+
+	/* look up the range type's info on first use */
+	if (typcache == NULL || typcache->type_id != RangeTypeGetOid(r1))
+	{
+		typcache = lookup_type_cache(RangeTypeGetOid(r1),
+									 TYPECACHE_RANGE_INFO);
+		if (typcache->rngelemtype == NULL)
+			elog(ERROR, "type %u is not a range type", RangeTypeGetOid(r1));
+		ssup->ssup_extra = typcache;
+	}
+
+	range_deserialize(typcache, r1, &lower1, &upper1, &empty1);
+	range_deserialize(typcache, r2, &lower2, &upper2, &empty2);
+
+	if (empty1 && empty2)
+		cmp = 0;
+	else if (empty1)
+		cmp = -1;
+	else if (empty2)
+		cmp = 1;
+	else
+	{
+		cmp = range_cmp_bounds(typcache, &lower1, &lower2);
+		if (cmp == 0)
+			cmp = range_cmp_bounds(typcache, &upper1, &upper2);
+	}
+
+	/* the sort makes very many comparisons, so don't leak detoasted copies */
+	if ((Pointer) r1 != DatumGetPointer(a))
+		pfree(r1);
+	if ((Pointer) r2 != DatumGetPointer(b))
+		pfree(r2);
+
+	return cmp;
+}
+
+/*
+ * GiST sortsupport support function
+ */
+Datum
+range_gist_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = range_gist_sort_cmp;
+	ssup->ssup_extra = NULL;
+
+	PG_RETURN_VOID();
+}
+
 /*
  *----------------------------------------------------------
  * STATIC FUNCTIONS
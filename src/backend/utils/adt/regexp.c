@@ -29,12 +29,15 @@
  */
 #include "postgres.h"
 
+#include "access/hash.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 #include "regex/regex.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/hsearch.h"
 
 #define PG_GETARG_TEXT_PP_IF_EXISTS(_n) \
 	(PG_NARGS() > (_n) ? PG_GETARG_TEXT_PP(_n) : NULL)
@@ -63,49 +66,58 @@ typedef struct regexp_matches_ctx
 } regexp_matches_ctx;
 
 /*
- * We cache precompiled regular expressions using a "self organizing list"
- * structure, in which recently-used items tend to be near the front.
- * Whenever we use an entry, it's moved up to the front of the list.
- * Over time, an item's average position corresponds to its frequency of use.
+ * We cache precompiled regular expressions, since compiling one is far more
+ * expensive than running it.  The cache holds up to regex_cache_size
+ * entries.  Lookups go through a hash table keyed on the pattern text,
+ * flags and collation, so a large cache costs no more to search than a
+ * small one, and the entries are also kept on a list in order of last use.
+ * When the cache is full, the least recently used entry is discarded to
+ * make room for a new one.  A newly compiled entry starts at the
+ * most-recently-used end, so a sudden shift in the query mix is adapted to
+ * at once, and a reusable pattern stays cached as long as it is used at
+ * least once in every regex_cache_size distinct patterns.
  *
- * When we first create an entry, it's inserted at the front of
- * the array, dropping the entry at the end of the array if necessary to
- * make room.  (This might seem to be weighting the new entry too heavily,
- * but if we insert new entries further back, we'll be unable to adjust to
- * a sudden shift in the query mix where we are presented with MAX_CACHED_RES
- * never-before-seen items used circularly.  We ought to be able to handle
- * that case, so we have to insert at the front.)
- *
- * Knuth mentions a variant strategy in which a used item is moved up just
- * one place in the list.  Although he says this uses fewer comparisons on
- * average, it seems not to adapt very well to the situation where you have
- * both some reusable patterns and a steady stream of non-reusable patterns.
- * A reusable pattern that isn't used at least as often as non-reusable
- * patterns are seen will "fail to keep up" and will drop off the end of the
- * cache.  With move-to-front, a reusable pattern is guaranteed to stay in
- * the cache as long as it's used at least once in every MAX_CACHED_RES uses.
+ * Along with each compiled RE we remember, when we can work one out, a
+ * literal byte string that every matching data string must contain, either
+ * at its very start or anywhere.  RE_compile_and_execute checks for it
+ * before converting the data to pg_wchar and running the regex engine, so
+ * that most non-matching strings are rejected with a memcmp or a memchr
+ * scan.
  */
 
-/* this is the maximum number of cached regular expressions */
-#ifndef MAX_CACHED_RES
-#define MAX_CACHED_RES	32
-#endif
+/* GUC variable: maximum number of cached regular expressions */
+int			regex_cache_size = 32;
 
-/* this structure describes one cached regular expression */
-typedef struct cached_re_str
+/* hash key of a cached regular expression */
+typedef struct cached_re_key
 {
 	char	   *cre_pat;		/* original RE (not null terminated!) */
 	int			cre_pat_len;	/* length of original RE, in bytes */
 	int			cre_flags;		/* compile flags: extended,icase etc */
 	Oid			cre_collation;	/* collation to use */
+} cached_re_key;
+
+/* this structure describes one cached regular expression */
+typedef struct cached_re_str
+{
+	cached_re_key key;			/* hash key; must be first */
+	dlist_node	cre_lru;		/* link in re_lru, most recently used first */
 	regex_t		cre_re;			/* the compiled regular expression */
+	char	   *cre_must;		/* literal any match must contain, or NULL */
+	int			cre_must_len;	/* length of cre_must, in bytes */
+	bool		cre_must_at_start;	/* must cre_must begin the data? */
 } cached_re_str;
 
+static HTAB *re_hash = NULL;	/* cached re's, by key */
+static dlist_head re_lru = DLIST_STATIC_INIT(re_lru);	/* ditto, by use */
 static int	num_res = 0;		/* # of cached re's */
-static cached_re_str re_array[MAX_CACHED_RES];	/* cached re's */
 
 
 /* Local functions */
+static cached_re_str *RE_compile_and_cache_entry(text *text_re, int cflags,
+						   Oid collation);
+static bool RE_contains_literal(const char *dat, int dat_len,
+					const char *lit, int lit_len);
 static regexp_matches_ctx *setup_regexp_matches(text *orig_str, text *pattern,
 					 text *flags,
 					 Oid collation,
@@ -118,53 +130,203 @@ static Datum build_regexp_split_result(regexp_matches_ctx *splitctx);
 
 
 /*
- * RE_compile_and_cache - compile a RE, caching if possible
- *
- * Returns regex_t *
+ * Hash and match support functions for re_hash.
+ */
+static uint32
+cached_re_hash(const void *key, Size keysize)
+{
+	const cached_re_key *k = (const cached_re_key *) key;
+	uint32		h;
+
+	h = DatumGetUInt32(hash_any((const unsigned char *) k->cre_pat,
+								k->cre_pat_len));
+	h = (h << 1) | (h >> 31);
+	h ^= DatumGetUInt32(hash_uint32((uint32) k->cre_flags));
+	h = (h << 1) | (h >> 31);
+	h ^= DatumGetUInt32(hash_uint32((uint32) k->cre_collation));
+	return h;
+}
+
+static int
+cached_re_match(const void *key1, const void *key2, Size keysize)
+{
+	const cached_re_key *k1 = (const cached_re_key *) key1;
+	const cached_re_key *k2 = (const cached_re_key *) key2;
+
+	if (k1->cre_pat_len == k2->cre_pat_len &&
+		k1->cre_flags == k2->cre_flags &&
+		k1->cre_collation == k2->cre_collation &&
+		memcmp(k1->cre_pat, k2->cre_pat, k1->cre_pat_len) == 0)
+		return 0;
+	return 1;
+}
+
+/*
+ * Allocator for re_hash.  The cache has to persist across transactions, and
+ * we want to get control back on out-of-memory, so like the pattern copies
+ * the hash entries are malloc'd.  They are never returned to malloc, but
+ * dynahash recycles them.
+ */
+static void *
+cached_re_alloc(Size size)
+{
+	return malloc(size);
+}
+
+/*
+ * Discard the least recently used cache entry.
+ */
+static void
+RE_evict_oldest(void)
+{
+	cached_re_str *oldest;
+	char	   *pat;
+	char	   *must;
+
+	Assert(num_res > 0);
+	oldest = dlist_tail_element(cached_re_str, cre_lru, &re_lru);
+	dlist_delete(&oldest->cre_lru);
+	pg_regfree(&oldest->cre_re);
+
+	/* the key is needed to find the entry, so free the pattern afterwards */
+	pat = oldest->key.cre_pat;
+	must = oldest->cre_must;
+	if (hash_search(re_hash, &oldest->key, HASH_REMOVE, NULL) == NULL)
+		elog(ERROR, "regular expression cache is corrupted");
+	free(pat);
+	if (must)
+		free(must);
+	num_res--;
+}
+
+/*
+ * RE_find_required_literal - work out a literal any match must contain
  *
- *	text_re --- the pattern, expressed as a TEXT object
- *	cflags --- compile options for the pattern
- *	collation --- collation to use for LC_CTYPE-dependent behavior
+ * If the regex can only match at the start of the data and begins with a
+ * fixed string, that string must begin any matching data.  Failing that, if
+ * the pattern contains no special characters at all, any matching data must
+ * contain the pattern itself.  The result is stored into *cre in the
+ * database encoding, malloc'd; cre_must is left NULL if we find nothing
+ * usable, including if we run out of memory.
+ */
+static void
+RE_find_required_literal(cached_re_str *cre)
+{
+	const char *pat = cre->key.cre_pat;
+	int			pat_len = cre->key.cre_pat_len;
+	int			cflags = cre->key.cre_flags;
+	pg_wchar   *str;
+	size_t		slen;
+	int			i;
+
+	cre->cre_must = NULL;
+	cre->cre_must_len = 0;
+	cre->cre_must_at_start = false;
+
+	/*
+	 * pg_regprefix only finds prefixes of left-anchored patterns.  With
+	 * REG_NLANCH, "^" also matches after any newline, so the prefix need not
+	 * begin the data; skip that case.  A director or embedded options at the
+	 * start of an ARE can turn REG_NLANCH on without it showing in cflags,
+	 * so skip those patterns too.
+	 */
+	if ((cflags & REG_NLANCH) == 0 &&
+		!(pat_len >= 2 && pat[0] == '(' && pat[1] == '?') &&
+		!(pat_len >= 3 && memcmp(pat, "***", 3) == 0))
+	{
+		int			re_result = pg_regprefix(&cre->cre_re, &str, &slen);
+
+		if ((re_result == REG_PREFIX || re_result == REG_EXACT) && slen > 0)
+		{
+			int			maxlen = pg_database_encoding_max_length() * slen + 1;
+
+			cre->cre_must = (char *) malloc(maxlen);
+			if (cre->cre_must != NULL)
+			{
+				cre->cre_must_len = pg_wchar2mb_with_len(str, cre->cre_must,
+														 slen);
+				Assert(cre->cre_must_len < maxlen);
+				cre->cre_must_at_start = true;
+			}
+		}
+		if (str)
+			free(str);
+		if (cre->cre_must != NULL)
+			return;
+	}
+
+	/*
+	 * Otherwise, see if the pattern is a plain literal.  This is conservative:
+	 * the characters tested for are special in AREs, EREs or BREs, and in
+	 * expanded syntax whitespace and "#" are too.  Case-insensitive matching
+	 * can match different bytes, so it's out.
+	 */
+	if (pat_len == 0 || (cflags & (REG_ICASE | REG_EXPANDED)) != 0)
+		return;
+	if ((cflags & REG_QUOTE) == 0)
+	{
+		for (i = 0; i < pat_len; i++)
+		{
+			if (strchr("^$.[]()|*+?{}\\", pat[i]) != NULL || pat[i] == '\0')
+				return;
+		}
+	}
+
+	cre->cre_must = (char *) malloc(pat_len);
+	if (cre->cre_must != NULL)
+	{
+		memcpy(cre->cre_must, pat, pat_len);
+		cre->cre_must_len = pat_len;
+	}
+}
+
+/*
+ * RE_compile_and_cache_entry - compile a RE, caching if possible
  *
- * Pattern is given in the database encoding.  We internally convert to
- * an array of pg_wchar, which is what Spencer's regex package wants.
+ * As RE_compile_and_cache, but returns the cache entry.
  */
-static regex_t *
-RE_compile_and_cache(text *text_re, int cflags, Oid collation)
+static cached_re_str *
+RE_compile_and_cache_entry(text *text_re, int cflags, Oid collation)
 {
 	int			text_re_len = VARSIZE_ANY_EXHDR(text_re);
 	char	   *text_re_val = VARDATA_ANY(text_re);
 	pg_wchar   *pattern;
 	int			pattern_len;
-	int			i;
 	int			regcomp_result;
+	cached_re_key key;
 	cached_re_str re_temp;
+	cached_re_str *cre;
+	bool		found;
 	char		errMsg[100];
 
+	if (re_hash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(cached_re_key);
+		ctl.entrysize = sizeof(cached_re_str);
+		ctl.hash = cached_re_hash;
+		ctl.match = cached_re_match;
+		ctl.alloc = cached_re_alloc;
+		re_hash = hash_create("Regular expression cache", 64, &ctl,
+						  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_ALLOC);
+	}
+
 	/*
-	 * Look for a match among previously compiled REs.  Since the data
-	 * structure is self-organizing with most-used entries at the front, our
-	 * search strategy can just be to scan from the front.
+	 * Look for a match among previously compiled REs; if found, mark it as
+	 * the most recently used.
 	 */
-	for (i = 0; i < num_res; i++)
-	{
-		if (re_array[i].cre_pat_len == text_re_len &&
-			re_array[i].cre_flags == cflags &&
-			re_array[i].cre_collation == collation &&
-			memcmp(re_array[i].cre_pat, text_re_val, text_re_len) == 0)
-		{
-			/*
-			 * Found a match; move it to front if not there already.
-			 */
-			if (i > 0)
-			{
-				re_temp = re_array[i];
-				memmove(&re_array[1], &re_array[0], i * sizeof(cached_re_str));
-				re_array[0] = re_temp;
-			}
+	key.cre_pat = text_re_val;
+	key.cre_pat_len = text_re_len;
+	key.cre_flags = cflags;
+	key.cre_collation = collation;
 
-			return &re_array[0].cre_re;
-		}
+	cre = (cached_re_str *) hash_search(re_hash, &key, HASH_FIND, NULL);
+	if (cre != NULL)
+	{
+		dlist_move_head(&re_lru, &cre->cre_lru);
+		return cre;
 	}
 
 	/*
@@ -210,38 +372,66 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 	 * out-of-memory.  The Max() is because some malloc implementations return
 	 * NULL for malloc(0).
 	 */
-	re_temp.cre_pat = malloc(Max(text_re_len, 1));
-	if (re_temp.cre_pat == NULL)
+	re_temp.key.cre_pat = (char *) malloc(Max(text_re_len, 1));
+	if (re_temp.key.cre_pat == NULL)
 	{
 		pg_regfree(&re_temp.cre_re);
 		ereport(ERROR,
 				(errcode(ERRCODE_OUT_OF_MEMORY),
 				 errmsg("out of memory")));
 	}
-	memcpy(re_temp.cre_pat, text_re_val, text_re_len);
-	re_temp.cre_pat_len = text_re_len;
-	re_temp.cre_flags = cflags;
-	re_temp.cre_collation = collation;
+	memcpy(re_temp.key.cre_pat, text_re_val, text_re_len);
+	re_temp.key.cre_pat_len = text_re_len;
+	re_temp.key.cre_flags = cflags;
+	re_temp.key.cre_collation = collation;
+
+	RE_find_required_literal(&re_temp);
 
 	/*
-	 * Okay, we have a valid new item in re_temp; insert it into the storage
-	 * array.  Discard last entry if needed.
+	 * Okay, we have a valid new item in re_temp; insert it into the cache.
+	 * Discard old entries if needed; there can be more than one if
+	 * regex_cache_size has been reduced.
 	 */
-	if (num_res >= MAX_CACHED_RES)
+	while (num_res > 0 && num_res >= regex_cache_size)
+		RE_evict_oldest();
+
+	cre = (cached_re_str *) hash_search(re_hash, &re_temp.key,
+										HASH_ENTER_NULL, &found);
+	if (cre == NULL)
 	{
-		--num_res;
-		Assert(num_res < MAX_CACHED_RES);
-		pg_regfree(&re_array[num_res].cre_re);
-		free(re_array[num_res].cre_pat);
+		pg_regfree(&re_temp.cre_re);
+		free(re_temp.key.cre_pat);
+		if (re_temp.cre_must)
+			free(re_temp.cre_must);
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
 	}
+	Assert(!found);
 
-	if (num_res > 0)
-		memmove(&re_array[1], &re_array[0], num_res * sizeof(cached_re_str));
-
-	re_array[0] = re_temp;
+	*cre = re_temp;
+	dlist_push_head(&re_lru, &cre->cre_lru);
 	num_res++;
 
-	return &re_array[0].cre_re;
+	return cre;
+}
+
+/*
+ * RE_compile_and_cache - compile a RE, caching if possible
+ *
+ * Returns regex_t *
+ *
+ *	text_re --- the pattern, expressed as a TEXT object
+ *	cflags --- compile options for the pattern
+ *	collation --- collation to use for LC_CTYPE-dependent behavior
+ *
+ * Pattern is given in the database encoding.  We internally convert to
+ * an array of pg_wchar, which is what Spencer's regex package wants.
+ */
+static regex_t *
+RE_compile_and_cache(text *text_re, int cflags, Oid collation)
+{
+	return &RE_compile_and_cache_entry(text_re, cflags, collation)->cre_re;
 }
 
 /*
@@ -340,12 +530,53 @@ RE_compile_and_execute(text *text_re, char *dat, int dat_len,
 					   int cflags, Oid collation,
 					   int nmatch, regmatch_t *pmatch)
 {
-	regex_t    *re;
+	cached_re_str *cre;
 
 	/* Compile RE */
-	re = RE_compile_and_cache(text_re, cflags, collation);
+	cre = RE_compile_and_cache_entry(text_re, cflags, collation);
 
-	return RE_execute(re, dat, dat_len, nmatch, pmatch);
+	/* Reject data that lacks the RE's required literal, if it has one */
+	if (cre->cre_must != NULL)
+	{
+		if (cre->cre_must_at_start)
+		{
+			if (dat_len < cre->cre_must_len ||
+				memcmp(dat, cre->cre_must, cre->cre_must_len) != 0)
+				return false;
+		}
+		else if (!RE_contains_literal(dat, dat_len,
+									  cre->cre_must, cre->cre_must_len))
+			return false;
+	}
+
+	return RE_execute(&cre->cre_re, dat, dat_len, nmatch, pmatch);
+}
+
+/*
+ * RE_contains_literal - does dat contain the byte string lit?
+ *
+ * Since lit is a sequence of whole characters in the database encoding, a
+ * string containing those characters contains those bytes.  The converse
+ * can fail in some multibyte encodings, which is harmless here: the regex
+ * engine still has the final say.
+ */
+static bool
+RE_contains_literal(const char *dat, int dat_len, const char *lit, int lit_len)
+{
+	const char *p = dat;
+	const char *last = dat + dat_len - lit_len;
+
+	Assert(lit_len > 0);
+	while (p <= last)
+	{
+		p = (const char *) memchr(p, lit[0], last - p + 1);
+		if (p == NULL)
+			return false;
+		if (memcmp(p + 1, lit + 1, lit_len - 1) == 0)
+			return true;
+		p++;
+	}
+	return false;
 }
 
 
@@ -45,7 +45,9 @@
 #include "parser/parse_relation.h"
 #include "miscadmin.h"
 #include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/datum.h"
 #include "utils/fmgroids.h"
 #include "utils/guc.h"
 #include "utils/inval.h"
@@ -76,16 +78,20 @@
 /* these queries are executed against the PK (referenced) table: */
 #define RI_PLAN_CHECK_LOOKUPPK			1
 #define RI_PLAN_CHECK_LOOKUPPK_FROM_PK	2
-#define RI_PLAN_LAST_ON_PK				RI_PLAN_CHECK_LOOKUPPK_FROM_PK
+#define RI_PLAN_CHECK_LOOKUPPK_BATCH	3
+#define RI_PLAN_LAST_ON_PK				RI_PLAN_CHECK_LOOKUPPK_BATCH
 /* these queries are executed against the FK (referencing) table: */
-#define RI_PLAN_CASCADE_DEL_DODELETE	3
-#define RI_PLAN_CASCADE_UPD_DOUPDATE	4
-#define RI_PLAN_RESTRICT_DEL_CHECKREF	5
-#define RI_PLAN_RESTRICT_UPD_CHECKREF	6
-#define RI_PLAN_SETNULL_DEL_DOUPDATE	7
-#define RI_PLAN_SETNULL_UPD_DOUPDATE	8
-#define RI_PLAN_SETDEFAULT_DEL_DOUPDATE 9
-#define RI_PLAN_SETDEFAULT_UPD_DOUPDATE 10
+#define RI_PLAN_CASCADE_DEL_DODELETE	4
+#define RI_PLAN_CASCADE_UPD_DOUPDATE	5
+#define RI_PLAN_RESTRICT_DEL_CHECKREF	6
+#define RI_PLAN_RESTRICT_UPD_CHECKREF	7
+#define RI_PLAN_SETNULL_DEL_DOUPDATE	8
+#define RI_PLAN_SETNULL_UPD_DOUPDATE	9
+#define RI_PLAN_SETDEFAULT_DEL_DOUPDATE 10
+#define RI_PLAN_SETDEFAULT_UPD_DOUPDATE 11
+
+/* Number of FK rows whose checks are collected before looking them up */
+#define RI_MAX_PENDING_CHECKS			1024
 
 #define MAX_QUOTED_NAME_LEN  (NAMEDATALEN*2+3)
 #define MAX_QUOTED_REL_NAME_LEN  (MAX_QUOTED_NAME_LEN*2)
@@ -180,6 +186,25 @@ typedef struct RI_CompareHashEntry
 } RI_CompareHashEntry;
 
 
+/* ----------
+ * RI_PendingCheck
+ *
+ *	The keys of FK rows whose existence check has been put off, so that
+ *	they can be looked up together; there is one of these per constraint
+ *	with pending checks.
+ * ----------
+ */
+typedef struct RI_PendingCheck
+{
+	Oid			constraint_id;	/* OID of pg_constraint entry */
+	Oid			fk_relid;		/* referencing relation */
+	int			nkeys;			/* number of key columns */
+	int			nrows;			/* number of pending rows */
+	Datum	   *keys;			/* nrows * nkeys key values, row by row */
+	uint32	   *seqnos;			/* queueing order of each row */
+} RI_PendingCheck;
+
+
 /* ----------
  * Local data
  * ----------
@@ -190,6 +215,11 @@ static HTAB *ri_compare_cache = NULL;
 static dlist_head ri_constraint_cache_valid_list;
 static int	ri_constraint_cache_valid_count = 0;
 
+/* Pending FK checks, in ri_pending_cxt */
+static MemoryContext ri_pending_cxt = NULL;
+static List *ri_pending_checks = NIL;
+static int	ri_pending_count = 0;
+
 
 /* ----------
  * Local function prototypes
@@ -198,6 +228,9 @@ static int	ri_constraint_cache_valid_count = 0;
 static bool ri_Check_Pk_Match(Relation pk_rel, Relation fk_rel,
 				  HeapTuple old_row,
 				  const RI_ConstraintInfo *riinfo);
+static bool ri_QueueCheck(const RI_ConstraintInfo *riinfo, Relation fk_rel,
+			  HeapTuple new_row);
+static int	ri_PerformBatchCheck(RI_PendingCheck *check);
 static Datum ri_restrict_del(TriggerData *trigdata, bool is_no_action);
 static Datum ri_restrict_upd(TriggerData *trigdata, bool is_no_action);
 static void quoteOneName(char *buffer, const char *name);
@@ -301,14 +334,7 @@ RI_FKey_check(TriggerData *trigdata)
 	if (!HeapTupleSatisfiesVisibility(new_row, SnapshotSelf, new_row_buf))
 		return PointerGetDatum(NULL);
 
-	/*
-	 * Get the relation descriptors of the FK and PK tables.
-	 *
-	 * pk_rel is opened in RowShareLock mode since that's what our eventual
-	 * SELECT FOR KEY SHARE will get on it.
-	 */
 	fk_rel = trigdata->tg_relation;
-	pk_rel = heap_open(riinfo->pk_relid, RowShareLock);
 
 	if (riinfo->confmatchtype == FKCONSTR_MATCH_PARTIAL)
 		ereport(ERROR,
@@ -323,7 +349,6 @@ RI_FKey_check(TriggerData *trigdata)
 			 * No further check needed - an all-NULL key passes every type of
 			 * foreign key constraint.
 			 */
-			heap_close(pk_rel, RowShareLock);
 			return PointerGetDatum(NULL);
 
 		case RI_KEYS_SOME_NULL:
@@ -338,8 +363,11 @@ RI_FKey_check(TriggerData *trigdata)
 
 					/*
 					 * Not allowed - MATCH FULL says either all or none of the
-					 * attributes can be NULLs
+					 * attributes can be NULLs.  Complete the checks of any
+					 * earlier rows first, so that the first violation is the
+					 * one reported.
 					 */
+					RI_FlushPendingChecks();
 					ereport(ERROR,
 							(errcode(ERRCODE_FOREIGN_KEY_VIOLATION),
 							 errmsg("insert or update on table \"%s\" violates foreign key constraint \"%s\"",
@@ -348,7 +376,6 @@ RI_FKey_check(TriggerData *trigdata)
 							 errdetail("MATCH FULL does not allow mixing of null and nonnull key values."),
 							 errtableconstraint(fk_rel,
 												NameStr(riinfo->conname))));
-					heap_close(pk_rel, RowShareLock);
 					return PointerGetDatum(NULL);
 
 				case FKCONSTR_MATCH_SIMPLE:
@@ -357,7 +384,6 @@ RI_FKey_check(TriggerData *trigdata)
 					 * MATCH SIMPLE - if ANY column is null, the key passes
 					 * the constraint.
 					 */
-					heap_close(pk_rel, RowShareLock);
 					return PointerGetDatum(NULL);
 
 				case FKCONSTR_MATCH_PARTIAL:
@@ -371,7 +397,6 @@ RI_FKey_check(TriggerData *trigdata)
 					ereport(ERROR,
 							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 							 errmsg("MATCH PARTIAL not yet implemented")));
-					heap_close(pk_rel, RowShareLock);
 					return PointerGetDatum(NULL);
 
 				default:
@@ -389,6 +414,20 @@ RI_FKey_check(TriggerData *trigdata)
 			break;
 	}
 
+	/*
+	 * Looking up each key as its row is checked costs a query execution per
+	 * row, so normally we just collect the key, and look up many at once
+	 * later; see RI_FlushPendingChecks.
+	 */
+	if (ri_QueueCheck(riinfo, fk_rel, new_row))
+		return PointerGetDatum(NULL);
+
+	/*
+	 * Otherwise check the key now.  pk_rel is opened in RowShareLock mode
+	 * since that's what our eventual SELECT FOR KEY SHARE will get on it.
+	 */
+	pk_rel = heap_open(riinfo->pk_relid, RowShareLock);
+
 	if (SPI_connect() != SPI_OK_CONNECT)
 		elog(ERROR, "SPI_connect failed");
 
@@ -500,6 +539,348 @@ RI_FKey_check_upd(PG_FUNCTION_ARGS)
 }
 
 
+/* ----------
+ * ri_QueueCheck -
+ *
+ *	Queue the existence check of new_row's key, which has no NULLs, for
+ *	RI_FlushPendingChecks.  Returns false if the check can't be batched,
+ *	which is when some key column's type has no array type.
+ * ----------
+ */
+static bool
+ri_QueueCheck(const RI_ConstraintInfo *riinfo, Relation fk_rel,
+			  HeapTuple new_row)
+{
+	TupleDesc	tupdesc = RelationGetDescr(fk_rel);
+	RI_PendingCheck *check = NULL;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+	Datum	   *keys;
+	uint32		seqno;
+	int			i;
+
+	foreach(lc, ri_pending_checks)
+	{
+		RI_PendingCheck *c = (RI_PendingCheck *) lfirst(lc);
+
+		if (c->constraint_id == riinfo->constraint_id)
+		{
+			check = c;
+			break;
+		}
+	}
+
+	if (ri_pending_cxt == NULL)
+		ri_pending_cxt = AllocSetContextCreate(TopTransactionContext,
+											   "RI pending checks",
+											   ALLOCSET_DEFAULT_MINSIZE,
+											   ALLOCSET_DEFAULT_INITSIZE,
+											   ALLOCSET_DEFAULT_MAXSIZE);
+	oldcontext = MemoryContextSwitchTo(ri_pending_cxt);
+
+	if (check == NULL)
+	{
+		/* The keys are passed to the lookup query as arrays */
+		for (i = 0; i < riinfo->nkeys; i++)
+		{
+			if (!OidIsValid(get_array_type(RIAttType(fk_rel,
+													 riinfo->fk_attnums[i]))))
+			{
+				MemoryContextSwitchTo(oldcontext);
+				return false;
+			}
+		}
+
+		check = (RI_PendingCheck *) palloc(sizeof(RI_PendingCheck));
+		check->constraint_id = riinfo->constraint_id;
+		check->fk_relid = RelationGetRelid(fk_rel);
+		check->nkeys = riinfo->nkeys;
+		check->nrows = 0;
+		check->keys = (Datum *)
+			palloc(RI_MAX_PENDING_CHECKS * riinfo->nkeys * sizeof(Datum));
+		check->seqnos = (uint32 *)
+			palloc(RI_MAX_PENDING_CHECKS * sizeof(uint32));
+		ri_pending_checks = lappend(ri_pending_checks, check);
+	}
+
+	/* Save a copy of the key, detoasted since it goes into an array */
+	keys = check->keys + check->nrows * check->nkeys;
+	for (i = 0; i < riinfo->nkeys; i++)
+	{
+		Form_pg_attribute att = tupdesc->attrs[riinfo->fk_attnums[i] - 1];
+		bool		isnull;
+		Datum		value;
+
+		value = heap_getattr(new_row, riinfo->fk_attnums[i], tupdesc, &isnull);
+		Assert(!isnull);
+		if (att->attlen == -1)
+			value = PointerGetDatum(PG_DETOAST_DATUM(value));
+		keys[i] = datumCopy(value, att->attbyval, att->attlen);
+	}
+
+	seqno = ri_pending_count++;
+	check->seqnos[check->nrows++] = seqno;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (ri_pending_count >= RI_MAX_PENDING_CHECKS)
+		RI_FlushPendingChecks();
+
+	return true;
+}
+
+
+/* ----------
+ * RI_FlushPendingChecks -
+ *
+ *	Perform the FK existence checks queued by ri_QueueCheck, reporting the
+ *	violation by the earliest queued row if there is any.
+ *
+ *	The trigger manager calls this at the end of each pass over its event
+ *	list, and before firing any trigger other than an FK check trigger;
+ *	so no other code can see the state between queueing and checking, and
+ *	the outcome is the same as checking each row as it is queued.
+ * ----------
+ */
+void
+RI_FlushPendingChecks(void)
+{
+	List	   *checks = ri_pending_checks;
+	RI_PendingCheck *violation = NULL;
+	int			violation_row = -1;
+	ListCell   *lc;
+
+	if (checks == NIL)
+		return;
+
+	/* Detach the list, in case the lookup queries fire triggers of their own */
+	ri_pending_checks = NIL;
+	ri_pending_count = 0;
+
+	foreach(lc, checks)
+	{
+		RI_PendingCheck *check = (RI_PendingCheck *) lfirst(lc);
+		int			row = ri_PerformBatchCheck(check);
+
+		if (row >= 0 &&
+			(violation == NULL ||
+			 check->seqnos[row] < violation->seqnos[violation_row]))
+		{
+			violation = check;
+			violation_row = row;
+		}
+	}
+
+	if (violation != NULL)
+	{
+		const RI_ConstraintInfo *riinfo;
+		Relation	fk_rel;
+		Relation	pk_rel;
+		TupleDesc	tupdesc;
+		Datum	   *values;
+		bool	   *nulls;
+		HeapTuple	violator;
+		int			i;
+
+		/* Make up a row holding just the offending key, for the message */
+		riinfo = ri_LoadConstraintInfo(violation->constraint_id);
+		fk_rel = heap_open(violation->fk_relid, NoLock);
+		pk_rel = heap_open(riinfo->pk_relid, RowShareLock);
+		tupdesc = RelationGetDescr(fk_rel);
+		values = (Datum *) palloc0(tupdesc->natts * sizeof(Datum));
+		nulls = (bool *) palloc(tupdesc->natts * sizeof(bool));
+		memset(nulls, true, tupdesc->natts * sizeof(bool));
+		for (i = 0; i < violation->nkeys; i++)
+		{
+			values[riinfo->fk_attnums[i] - 1] =
+				violation->keys[violation_row * violation->nkeys + i];
+			nulls[riinfo->fk_attnums[i] - 1] = false;
+		}
+		violator = heap_form_tuple(tupdesc, values, nulls);
+
+		ri_ReportViolation(riinfo, pk_rel, fk_rel, violator, NULL,
+						   RI_PLAN_CHECK_LOOKUPPK, false);
+	}
+
+	MemoryContextReset(ri_pending_cxt);
+}
+
+
+/* ----------
+ * RI_DiscardPendingChecks -
+ *
+ *	Forget pending FK checks, at transaction or subtransaction abort (or
+ *	commit, though there should be none then).  Since checks are never
+ *	left pending while other triggers run, any pending at subtransaction
+ *	abort belong to the subtransaction.
+ * ----------
+ */
+void
+RI_DiscardPendingChecks(void)
+{
+	if (ri_pending_cxt != NULL)
+		MemoryContextDelete(ri_pending_cxt);
+	ri_pending_cxt = NULL;
+	ri_pending_checks = NIL;
+	ri_pending_count = 0;
+}
+
+
+/* ----------
+ * ri_PerformBatchCheck -
+ *
+ *	Look up the pending keys of one constraint in the PK table, locking the
+ *	PK rows found as RI_FKey_check does.  Returns the index of the first
+ *	row whose key is missing, or -1 if all are present.
+ * ----------
+ */
+static int
+ri_PerformBatchCheck(RI_PendingCheck *check)
+{
+	const RI_ConstraintInfo *riinfo;
+	Relation	fk_rel;
+	Relation	pk_rel;
+	RI_QueryKey qkey;
+	SPIPlanPtr	qplan;
+	Datum		vals[RI_MAX_NUMKEYS];
+	char		nulls[RI_MAX_NUMKEYS];
+	bool	   *found;
+	int			spi_result;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			missing = -1;
+	uint64		i;
+
+	riinfo = ri_LoadConstraintInfo(check->constraint_id);
+	fk_rel = heap_open(check->fk_relid, NoLock);
+	pk_rel = heap_open(riinfo->pk_relid, RowShareLock);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	ri_BuildQueryKey(&qkey, riinfo, RI_PLAN_CHECK_LOOKUPPK_BATCH);
+
+	if ((qplan = ri_FetchPreparedPlan(&qkey)) == NULL)
+	{
+		StringInfoData querybuf;
+		char		pkrelname[MAX_QUOTED_REL_NAME_LEN];
+		char		attname[MAX_QUOTED_NAME_LEN + 2];
+		char		paramname[16];
+		const char *querysep;
+		Oid			queryoids[RI_MAX_NUMKEYS];
+		int			k;
+
+		/* ----------
+		 * The query string built is
+		 *	SELECT u.n FROM ONLY <pktable> x,
+		 *		   pg_catalog.unnest($1 [, ...]) WITH ORDINALITY u(k1 [, ...], n)
+		 *		   WHERE x.pkatt1 = u.k1 [AND ...] FOR KEY SHARE OF x
+		 * The $ parameters are arrays of the corresponding FK attributes'
+		 * types, holding the pending keys column by column; the result
+		 * is the positions of the keys that were found.
+		 * ----------
+		 */
+		initStringInfo(&querybuf);
+		quoteRelationName(pkrelname, pk_rel);
+		appendStringInfo(&querybuf,
+						 "SELECT u.n FROM ONLY %s x, pg_catalog.unnest(",
+						 pkrelname);
+		for (k = 0; k < riinfo->nkeys; k++)
+			appendStringInfo(&querybuf, "%s$%d", k > 0 ? ", " : "", k + 1);
+		appendStringInfoString(&querybuf, ") WITH ORDINALITY u(");
+		for (k = 0; k < riinfo->nkeys; k++)
+			appendStringInfo(&querybuf, "k%d, ", k + 1);
+		appendStringInfoString(&querybuf, "n)");
+		querysep = "WHERE";
+		for (k = 0; k < riinfo->nkeys; k++)
+		{
+			Oid			pk_type = RIAttType(pk_rel, riinfo->pk_attnums[k]);
+			Oid			fk_type = RIAttType(fk_rel, riinfo->fk_attnums[k]);
+
+			strcpy(attname, "x.");
+			quoteOneName(attname + 2,
+						 RIAttName(pk_rel, riinfo->pk_attnums[k]));
+			sprintf(paramname, "u.k%d", k + 1);
+			ri_GenerateQual(&querybuf, querysep,
+							attname, pk_type,
+							riinfo->pf_eq_oprs[k],
+							paramname, fk_type);
+			querysep = "AND";
+			queryoids[k] = get_array_type(fk_type);
+		}
+		appendStringInfoString(&querybuf, " FOR KEY SHARE OF x");
+
+		/* Prepare and save the plan */
+		qplan = ri_PlanCheck(querybuf.data, riinfo->nkeys, queryoids,
+							 &qkey, fk_rel, pk_rel, true);
+	}
+
+	/* Build the key arrays, in SPI's memory */
+	for (i = 0; i < riinfo->nkeys; i++)
+	{
+		Form_pg_attribute att =
+		RelationGetDescr(fk_rel)->attrs[riinfo->fk_attnums[i] - 1];
+		Datum	   *elems = (Datum *) palloc(check->nrows * sizeof(Datum));
+		int			r;
+
+		for (r = 0; r < check->nrows; r++)
+			elems[r] = check->keys[r * check->nkeys + i];
+		vals[i] = PointerGetDatum(construct_array(elems, check->nrows,
+												  att->atttypid, att->attlen,
+												  att->attbyval,
+												  att->attalign));
+		nulls[i] = ' ';
+	}
+
+	/* Run the lookup as the PK table's owner, as ri_PerformCheck does */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(RelationGetForm(pk_rel)->relowner,
+						   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+						   SECURITY_NOFORCE_RLS);
+
+	spi_result = SPI_execute_snapshot(qplan, vals, nulls,
+									  InvalidSnapshot, InvalidSnapshot,
+									  false, false, 0);
+
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	if (spi_result < 0)
+		elog(ERROR, "SPI_execute_snapshot returned %d", spi_result);
+	if (spi_result != SPI_OK_SELECT)
+		ri_ReportViolation(riinfo, pk_rel, fk_rel, NULL, NULL,
+						   RI_PLAN_CHECK_LOOKUPPK, true);
+
+	found = (bool *) palloc0(check->nrows * sizeof(bool));
+	for (i = 0; i < SPI_processed; i++)
+	{
+		bool		isnull;
+		int64		n;
+
+		n = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[i],
+										SPI_tuptable->tupdesc, 1, &isnull));
+		Assert(!isnull && n >= 1 && n <= check->nrows);
+		found[n - 1] = true;
+	}
+
+	for (i = 0; i < check->nrows; i++)
+	{
+		if (!found[i])
+		{
+			missing = (int) i;
+			break;
+		}
+	}
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish failed");
+
+	heap_close(pk_rel, RowShareLock);
+	heap_close(fk_rel, NoLock);
+
+	return missing;
+}
+
+
 /* ----------
  * ri_Check_Pk_Match
  *
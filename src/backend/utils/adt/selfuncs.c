@@ -108,6 +108,7 @@
 #include "catalog/pg_operator.h"
 #include "catalog/pg_opfamily.h"
 #include "catalog/pg_statistic.h"
+#include "catalog/pg_statistic_ext.h"
 #include "catalog/pg_type.h"
 #include "executor/executor.h"
 #include "mb/pg_wchar.h"
@@ -124,6 +125,7 @@
 #include "parser/parse_clause.h"
 #include "parser/parse_coerce.h"
 #include "parser/parsetree.h"
+#include "statistics/statistics.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
 #include "utils/date.h"
@@ -160,6 +162,8 @@ static double eqjoinsel_inner(Oid operator__,
 static double eqjoinsel_semi(Oid operator__,
 			   VariableStatData *vardata1, VariableStatData *vardata2,
 			   RelOptInfo *inner_rel);
+static bool estimate_multivariate_ndistinct(PlannerInfo *root,
+					   RelOptInfo *rel, List **varinfos, double *ndistinct);
 static bool convert_to_scalar(Datum value, Oid valuetypid, double *scaledvalue,
 				  Datum lobound, Datum hibound, Oid boundstypid,
 				  double *scaledlobound, double *scaledhibound);
@@ -301,12 +305,11 @@ var_eq_const(VariableStatData *vardata, Oid operator__,
 		 * don't like this, maybe you shouldn't be using eqsel for your
 		 * operator...)
 		 */
-		if (get_attstatsslot(vardata->statsTuple,
-							 vardata->atttype, vardata->atttypmod,
-							 STATISTIC_KIND_MCV, InvalidOid,
-							 NULL,
-							 &values, &nvalues,
-							 &numbers, &nnumbers))
+		if (get_variable_statsslot(vardata,
+								   STATISTIC_KIND_MCV, InvalidOid,
+								   NULL,
+								   &values, &nvalues,
+								   &numbers, &nnumbers))
 		{
 			FmgrInfo	eqproc;
 
@@ -377,8 +380,8 @@ var_eq_const(VariableStatData *vardata, Oid operator__,
 				selec = numbers[nnumbers - 1];
 		}
 
-		free_attstatsslot(vardata->atttype, values, nvalues,
-						  numbers, nnumbers);
+		free_variable_statsslot(vardata, values, nvalues,
+								numbers, nnumbers);
 	}
 	else
 	{
@@ -445,16 +448,15 @@ var_eq_non_const(VariableStatData *vardata, Oid operator__,
 		 * Cross-check: selectivity should never be estimated as more than the
 		 * most common value's.
 		 */
-		if (get_attstatsslot(vardata->statsTuple,
-							 vardata->atttype, vardata->atttypmod,
-							 STATISTIC_KIND_MCV, InvalidOid,
-							 NULL,
-							 NULL, NULL,
-							 &numbers, &nnumbers))
+		if (get_variable_statsslot(vardata,
+								   STATISTIC_KIND_MCV, InvalidOid,
+								   NULL,
+								   NULL, NULL,
+								   &numbers, &nnumbers))
 		{
 			if (nnumbers > 0 && selec > numbers[0])
 				selec = numbers[0];
-			free_attstatsslot(vardata->atttype, NULL, 0, numbers, nnumbers);
+			free_variable_statsslot(vardata, NULL, 0, numbers, nnumbers);
 		}
 	}
 	else
@@ -616,12 +618,11 @@ mcv_selectivity(VariableStatData *vardata, FmgrInfo *opproc,
 	sumcommon = 0.0;
 
 	if (HeapTupleIsValid(vardata->statsTuple) &&
-		get_attstatsslot(vardata->statsTuple,
-						 vardata->atttype, vardata->atttypmod,
-						 STATISTIC_KIND_MCV, InvalidOid,
-						 NULL,
-						 &values, &nvalues,
-						 &numbers, &nnumbers))
+		get_variable_statsslot(vardata,
+							   STATISTIC_KIND_MCV, InvalidOid,
+							   NULL,
+							   &values, &nvalues,
+							   &numbers, &nnumbers))
 	{
 		for (i = 0; i < nvalues; i++)
 		{
@@ -637,8 +638,8 @@ mcv_selectivity(VariableStatData *vardata, FmgrInfo *opproc,
 				mcv_selec += numbers[i];
 			sumcommon += numbers[i];
 		}
-		free_attstatsslot(vardata->atttype, values, nvalues,
-						  numbers, nnumbers);
+		free_variable_statsslot(vardata, values, nvalues,
+								numbers, nnumbers);
 	}
 
 	*sumcommonp = sumcommon;
@@ -692,12 +693,11 @@ histogram_selectivity(VariableStatData *vardata, FmgrInfo *opproc,
 	Assert(min_hist_size > 2 * n_skip);
 
 	if (HeapTupleIsValid(vardata->statsTuple) &&
-		get_attstatsslot(vardata->statsTuple,
-						 vardata->atttype, vardata->atttypmod,
-						 STATISTIC_KIND_HISTOGRAM, InvalidOid,
-						 NULL,
-						 &values, &nvalues,
-						 NULL, NULL))
+		get_variable_statsslot(vardata,
+							   STATISTIC_KIND_HISTOGRAM, InvalidOid,
+							   NULL,
+							   &values, &nvalues,
+							   NULL, NULL))
 	{
 		*hist_size = nvalues;
 		if (nvalues >= min_hist_size)
@@ -722,7 +722,7 @@ histogram_selectivity(VariableStatData *vardata, FmgrInfo *opproc,
 		}
 		else
 			result = -1;
-		free_attstatsslot(vardata->atttype, values, nvalues, NULL, 0);
+		free_variable_statsslot(vardata, values, nvalues, NULL, 0);
 	}
 	else
 	{
@@ -769,12 +769,11 @@ ineq_histogram_selectivity(PlannerInfo *root,
 	 * the reverse way if isgt is TRUE.
 	 */
 	if (HeapTupleIsValid(vardata->statsTuple) &&
-		get_attstatsslot(vardata->statsTuple,
-						 vardata->atttype, vardata->atttypmod,
-						 STATISTIC_KIND_HISTOGRAM, InvalidOid,
-						 &hist_op,
-						 &values, &nvalues,
-						 NULL, NULL))
+		get_variable_statsslot(vardata,
+							   STATISTIC_KIND_HISTOGRAM, InvalidOid,
+							   &hist_op,
+							   &values, &nvalues,
+							   NULL, NULL))
 	{
 		if (nvalues > 1)
 		{
@@ -947,7 +946,7 @@ ineq_histogram_selectivity(PlannerInfo *root,
 			}
 		}
 
-		free_attstatsslot(vardata->atttype, values, nvalues, NULL, 0);
+		free_variable_statsslot(vardata, values, nvalues, NULL, 0);
 	}
 
 	return hist_selec;
@@ -1508,12 +1507,11 @@ booltestsel(PlannerInfo *root, BoolTestType booltesttype, Node *arg,
 		stats = (Form_pg_statistic) GETSTRUCT(vardata.statsTuple);
 		freq_null = stats->stanullfrac;
 
-		if (get_attstatsslot(vardata.statsTuple,
-							 vardata.atttype, vardata.atttypmod,
-							 STATISTIC_KIND_MCV, InvalidOid,
-							 NULL,
-							 &values, &nvalues,
-							 &numbers, &nnumbers)
+		if (get_variable_statsslot(&vardata,
+								   STATISTIC_KIND_MCV, InvalidOid,
+								   NULL,
+								   &values, &nvalues,
+								   &numbers, &nnumbers)
 			&& nnumbers > 0)
 		{
 			double		freq_true;
@@ -1566,8 +1564,8 @@ booltestsel(PlannerInfo *root, BoolTestType booltesttype, Node *arg,
 					break;
 			}
 
-			free_attstatsslot(vardata.atttype, values, nvalues,
-							  numbers, nnumbers);
+			free_variable_statsslot(&vardata, values, nvalues,
+									numbers, nnumbers);
 		}
 		else
 		{
@@ -2272,27 +2270,23 @@ eqjoinsel_inner(Oid operator__,
 	if (HeapTupleIsValid(vardata1->statsTuple))
 	{
 		stats1 = (Form_pg_statistic) GETSTRUCT(vardata1->statsTuple);
-		have_mcvs1 = get_attstatsslot(vardata1->statsTuple,
-									  vardata1->atttype,
-									  vardata1->atttypmod,
-									  STATISTIC_KIND_MCV,
-									  InvalidOid,
-									  NULL,
-									  &values1, &nvalues1,
-									  &numbers1, &nnumbers1);
+		have_mcvs1 = get_variable_statsslot(vardata1,
+											STATISTIC_KIND_MCV,
+											InvalidOid,
+											NULL,
+											&values1, &nvalues1,
+											&numbers1, &nnumbers1);
 	}
 
 	if (HeapTupleIsValid(vardata2->statsTuple))
 	{
 		stats2 = (Form_pg_statistic) GETSTRUCT(vardata2->statsTuple);
-		have_mcvs2 = get_attstatsslot(vardata2->statsTuple,
-									  vardata2->atttype,
-									  vardata2->atttypmod,
-									  STATISTIC_KIND_MCV,
-									  InvalidOid,
-									  NULL,
-									  &values2, &nvalues2,
-									  &numbers2, &nnumbers2);
+		have_mcvs2 = get_variable_statsslot(vardata2,
+											STATISTIC_KIND_MCV,
+											InvalidOid,
+											NULL,
+											&values2, &nvalues2,
+											&numbers2, &nnumbers2);
 	}
 
 	if (have_mcvs1 && have_mcvs2)
@@ -2455,11 +2449,11 @@ eqjoinsel_inner(Oid operator__,
 	}
 
 	if (have_mcvs1)
-		free_attstatsslot(vardata1->atttype, values1, nvalues1,
-						  numbers1, nnumbers1);
+		free_variable_statsslot(vardata1, values1, nvalues1,
+								numbers1, nnumbers1);
 	if (have_mcvs2)
-		free_attstatsslot(vardata2->atttype, values2, nvalues2,
-						  numbers2, nnumbers2);
+		free_variable_statsslot(vardata2, values2, nvalues2,
+								numbers2, nnumbers2);
 
 	return selec;
 }
@@ -2517,26 +2511,22 @@ eqjoinsel_semi(Oid operator__,
 	if (HeapTupleIsValid(vardata1->statsTuple))
 	{
 		stats1 = (Form_pg_statistic) GETSTRUCT(vardata1->statsTuple);
-		have_mcvs1 = get_attstatsslot(vardata1->statsTuple,
-									  vardata1->atttype,
-									  vardata1->atttypmod,
-									  STATISTIC_KIND_MCV,
-									  InvalidOid,
-									  NULL,
-									  &values1, &nvalues1,
-									  &numbers1, &nnumbers1);
+		have_mcvs1 = get_variable_statsslot(vardata1,
+											STATISTIC_KIND_MCV,
+											InvalidOid,
+											NULL,
+											&values1, &nvalues1,
+											&numbers1, &nnumbers1);
 	}
 
 	if (HeapTupleIsValid(vardata2->statsTuple))
 	{
-		have_mcvs2 = get_attstatsslot(vardata2->statsTuple,
-									  vardata2->atttype,
-									  vardata2->atttypmod,
-									  STATISTIC_KIND_MCV,
-									  InvalidOid,
-									  NULL,
-									  &values2, &nvalues2,
-									  &numbers2, &nnumbers2);
+		have_mcvs2 = get_variable_statsslot(vardata2,
+											STATISTIC_KIND_MCV,
+											InvalidOid,
+											NULL,
+											&values2, &nvalues2,
+											&numbers2, &nnumbers2);
 	}
 
 	if (have_mcvs1 && have_mcvs2 && OidIsValid(operator__))
@@ -2660,11 +2650,11 @@ eqjoinsel_semi(Oid operator__,
 	}
 
 	if (have_mcvs1)
-		free_attstatsslot(vardata1->atttype, values1, nvalues1,
-						  numbers1, nnumbers1);
+		free_variable_statsslot(vardata1, values1, nvalues1,
+								numbers1, nnumbers1);
 	if (have_mcvs2)
-		free_attstatsslot(vardata2->atttype, values2, nvalues2,
-						  numbers2, nnumbers2);
+		free_variable_statsslot(vardata2, values2, nvalues2,
+								numbers2, nnumbers2);
 
 	return selec;
 }
@@ -3379,25 +3369,25 @@ estimate_num_groups(PlannerInfo *root, List *groupExprs, double input_rows,
 	{
 		GroupVarInfo *varinfo1 = (GroupVarInfo *) linitial(varinfos);
 		RelOptInfo *rel = varinfo1->rel;
-		double		reldistinct = varinfo1->ndistinct;
+		double		reldistinct = 1;
 		double		relmaxndistinct = reldistinct;
-		int			relvarcount = 1;
+		int			relvarcount = 0;
 		List	   *newvarinfos = NIL;
+		List	   *relvarinfos = NIL;
 
 		/*
-		 * Get the product of numdistinct estimates of the Vars for this rel.
-		 * Also, construct new varinfos list of remaining Vars.
+		 * Split the list of varinfos in two - one for the current rel, one
+		 * for remaining Vars on other rels.
 		 */
+		relvarinfos = lcons(varinfo1, relvarinfos);
 		for_each_cell(l, lnext(list_head(varinfos)))
 		{
 			GroupVarInfo *varinfo2 = (GroupVarInfo *) lfirst(l);
 
 			if (varinfo2->rel == varinfo1->rel)
 			{
-				reldistinct *= varinfo2->ndistinct;
-				if (relmaxndistinct < varinfo2->ndistinct)
-					relmaxndistinct = varinfo2->ndistinct;
-				relvarcount++;
+				/* varinfos on current rel */
+				relvarinfos = lcons(varinfo2, relvarinfos);
 			}
 			else
 			{
@@ -3406,6 +3396,43 @@ estimate_num_groups(PlannerInfo *root, List *groupExprs, double input_rows,
 			}
 		}
 
+		/*
+		 * Get the numdistinct estimate for the Vars of this rel.  We
+		 * iteratively search for multivariate n-distinct with maximum number
+		 * of vars; assuming that each var group is independent of the others,
+		 * we multiply them together.  Any remaining relvarinfos after no more
+		 * multivariate matches are found are assumed independent too, so
+		 * their individual ndistinct estimates are multiplied also.
+		 */
+		while (relvarinfos)
+		{
+			double		mvndistinct;
+
+			if (estimate_multivariate_ndistinct(root, rel, &relvarinfos,
+												&mvndistinct))
+			{
+				reldistinct *= mvndistinct;
+				if (relmaxndistinct < mvndistinct)
+					relmaxndistinct = mvndistinct;
+				relvarcount++;
+			}
+			else
+			{
+				foreach(l, relvarinfos)
+				{
+					GroupVarInfo *varinfo2 = (GroupVarInfo *) lfirst(l);
+
+					reldistinct *= varinfo2->ndistinct;
+					if (relmaxndistinct < varinfo2->ndistinct)
+						relmaxndistinct = varinfo2->ndistinct;
+					relvarcount++;
+				}
+
+				/* we're done with this relation */
+				relvarinfos = NIL;
+			}
+		}
+
 		/*
 		 * Sanity check --- don't divide by zero if empty relation.
 		 */
@@ -3460,6 +3487,137 @@ estimate_num_groups(PlannerInfo *root, List *groupExprs, double input_rows,
 	return numdistinct;
 }
 
+/*
+ * Find applicable ndistinct statistics for the given list of GroupVarInfos
+ * (which must all belong to the given rel), and update *ndistinct to the
+ * estimate of the MVNDistinctItem that best matches.  If a match it found,
+ * *varinfos is updated to remove the list of matched varinfos.
+ *
+ * Varinfos that aren't for simple Vars are ignored.
+ *
+ * Return TRUE if we're able to find a match, FALSE otherwise.
+ */
+static bool
+estimate_multivariate_ndistinct(PlannerInfo *root, RelOptInfo *rel,
+								List **varinfos, double *ndistinct)
+{
+	ListCell   *lc;
+	Bitmapset  *attnums = NULL;
+	int			nmatches;
+	Oid			statOid = InvalidOid;
+	MVNDistinct *stats;
+	Bitmapset  *matched = NULL;
+
+	/* bail out immediately if the table has no extended statistics */
+	if (!rel->statlist)
+		return false;
+
+	/* Determine the attnums we're looking for */
+	foreach(lc, *varinfos)
+	{
+		GroupVarInfo *varinfo = (GroupVarInfo *) lfirst(lc);
+		Var		   *var;
+
+		Assert(varinfo->rel == rel);
+
+		if (!IsA(varinfo->var, Var))
+			continue;
+
+		var = (Var *) varinfo->var;
+		if (var->varno != rel->relid || var->varlevelsup != 0 ||
+			var->varattno <= 0)
+			continue;
+
+		attnums = bms_add_member(attnums, var->varattno);
+	}
+
+	/* look for the ndistinct statistics matching the most vars */
+	nmatches = 1;				/* we require at least two matches */
+	foreach(lc, rel->statlist)
+	{
+		StatisticExtInfo *info = (StatisticExtInfo *) lfirst(lc);
+		Bitmapset  *shared;
+		int			nshared;
+
+		/* skip statistics of other kinds */
+		if (info->kind != STATS_EXT_NDISTINCT)
+			continue;
+
+		/* compute attnums shared by the vars and the statistics object */
+		shared = bms_intersect(info->keys, attnums);
+		nshared = bms_num_members(shared);
+
+		/*
+		 * Does this statistics object match more columns than the currently
+		 * best object?  If so, use this one instead.
+		 */
+		if (nshared > nmatches)
+		{
+			statOid = info->statOid;
+			nmatches = nshared;
+			matched = shared;
+		}
+	}
+
+	/* No match? */
+	if (statOid == InvalidOid)
+		return false;
+	Assert(nmatches > 1 && matched != NULL);
+
+	stats = statext_ndistinct_load(statOid);
+
+	/*
+	 * If we have a match, search it for the specific item that matches (there
+	 * must be one), and construct the output values.
+	 */
+	if (stats)
+	{
+		int			i;
+		List	   *newlist = NIL;
+		MVNDistinctItem *item = NULL;
+
+		/* Find the specific item that exactly matches the combination */
+		for (i = 0; i < stats->nitems; i++)
+		{
+			MVNDistinctItem *tmpitem = &stats->items[i];
+
+			if (bms_equal(tmpitem->attrs, matched))
+			{
+				item = tmpitem;
+				break;
+			}
+		}
+
+		/* make sure we found an item */
+		if (!item)
+			elog(ERROR, "corrupt MVNDistinct entry");
+
+		/* Form the output varinfo list, keeping only unmatched ones */
+		foreach(lc, *varinfos)
+		{
+			GroupVarInfo *varinfo = (GroupVarInfo *) lfirst(lc);
+			Var		   *var;
+
+			if (!IsA(varinfo->var, Var))
+			{
+				newlist = lappend(newlist, varinfo);
+				continue;
+			}
+
+			var = (Var *) varinfo->var;
+			if (var->varno != rel->relid || var->varlevelsup != 0 ||
+				!bms_is_member(var->varattno, matched))
+				newlist = lappend(newlist, varinfo);
+		}
+
+		*varinfos = newlist;
+		*ndistinct = item->ndistinct;
+		return true;
+	}
+
+	return false;
+}
+
 /*
  * Estimate hash bucketsize fraction (ie, number of entries in a bucket
  * divided by total tuples in relation) if the specified expression is used
@@ -3557,20 +3715,19 @@ estimate_hash_bucketsize(PlannerInfo *root, Node *hashkey, double nbuckets)
 
 	if (HeapTupleIsValid(vardata.statsTuple))
 	{
-		if (get_attstatsslot(vardata.statsTuple,
-							 vardata.atttype, vardata.atttypmod,
-							 STATISTIC_KIND_MCV, InvalidOid,
-							 NULL,
-							 NULL, NULL,
-							 &numbers, &nnumbers))
+		if (get_variable_statsslot(&vardata,
+								   STATISTIC_KIND_MCV, InvalidOid,
+								   NULL,
+								   NULL, NULL,
+								   &numbers, &nnumbers))
 		{
 			/*
 			 * The first MCV stat is for the most common value.
 			 */
 			if (nnumbers > 0)
 				mcvfreq = numbers[0];
-			free_attstatsslot(vardata.atttype, NULL, 0,
-							  numbers, nnumbers);
+			free_variable_statsslot(&vardata, NULL, 0,
+									numbers, nnumbers);
 		}
 	}
 
@@ -4347,6 +4504,9 @@ examine_variable(PlannerInfo *root, Node *node, int varRelid,
 	/* Make sure we don't return dangling pointers in vardata */
 	MemSet(vardata, 0, sizeof(VariableStatData));
 
+	/* Remember the planner info, for get_variable_statsslot */
+	vardata->root = root;
+
 	/* Save the exposed type of the expression */
 	vardata->vartype = exprType(node);
 
@@ -4466,7 +4626,7 @@ examine_variable(PlannerInfo *root, Node *node, int varRelid,
 						 * should match has_unique_index().
 						 */
 						if (index->unique &&
-							index->ncolumns == 1 &&
+							index->nkeycolumns == 1 &&
 							(index->indpred == NIL || index->predOK))
 							vardata->isunique = true;
 
@@ -4669,6 +4829,180 @@ examine_simple_variable(PlannerInfo *root, Var *var,
 	}
 }
 
+/*
+ * Hash table entry for the planner's cache of pg_statistic slots.
+ *
+ * The key identifies the pg_statistic row and the slot within it, plus
+ * which parts of the slot were extracted: a caller that doesn't ask for the
+ * values might not know the right type to extract them with, so entries
+ * made with and without values are kept apart.
+ */
+typedef struct StatsSlotCacheKey
+{
+	Oid			starelid;		/* pg_statistic row identity */
+	int16		staattnum;
+	bool		stainherit;
+	bool		wantvalues;		/* were stavalues extracted? */
+	bool		wantnumbers;	/* were stanumbers extracted? */
+	int			reqkind;		/* slot identity */
+	Oid			reqop;
+	Oid			atttype;		/* type the values were extracted as */
+} StatsSlotCacheKey;
+
+typedef struct StatsSlotCacheEntry
+{
+	StatsSlotCacheKey key;		/* hash key --- MUST BE FIRST */
+	bool		found;			/* did get_attstatsslot find the slot? */
+	Oid			actualop;
+	Datum	   *values;
+	int			nvalues;
+	float4	   *numbers;
+	int			nnumbers;
+} StatsSlotCacheEntry;
+
+/*
+ * Can the statistics slots of this variable be served from the cache?
+ *
+ * Only tuples that really came from the pg_statistic syscache qualify; a
+ * stats hook might hand out different data each time it's called.  We also
+ * need a PlannerGlobal and a long-lived context to keep the entries in.
+ */
+static bool
+statsslot_cache_usable(VariableStatData *vardata)
+{
+	return (vardata->root != NULL &&
+			vardata->root->glob != NULL &&
+			vardata->root->planner_cxt != NULL &&
+			HeapTupleIsValid(vardata->statsTuple) &&
+			vardata->freefunc == ReleaseSysCache);
+}
+
+/*
+ * get_variable_statsslot
+ *	  Extract a slot of the variable's pg_statistic tuple, using the cache
+ *	  kept in PlannerGlobal.
+ *
+ * This is get_attstatsslot() applied to vardata->statsTuple, with the
+ * variable's own atttype and atttypmod.  A query with many clauses on the
+ * same column, or one whose joins are costed many times over, would
+ * otherwise deconstruct (and detoast) the same arrays again for every
+ * estimate; instead the first extraction is kept for the rest of the
+ * planning cycle.  Since the cache lives in the planner's memory context,
+ * it goes away with the finished plan and never sees statistics newer than
+ * the ones it was filled from in the middle of planning a query.
+ *
+ * When the slot came out of the cache, the arrays must not be modified, and
+ * the caller must release them with free_variable_statsslot() rather than
+ * free_attstatsslot().
+ */
+bool
+get_variable_statsslot(VariableStatData *vardata,
+					   int reqkind, Oid reqop, Oid *actualop,
+					   Datum **values, int *nvalues,
+					   float4 **numbers, int *nnumbers)
+{
+	PlannerGlobal *glob;
+	Form_pg_statistic stats;
+	StatsSlotCacheKey key;
+	StatsSlotCacheEntry *entry;
+	bool		found;
+	MemoryContext oldcxt;
+
+	if (!statsslot_cache_usable(vardata))
+		return get_attstatsslot(vardata->statsTuple,
+								vardata->atttype, vardata->atttypmod,
+								reqkind, reqop, actualop,
+								values, nvalues, numbers, nnumbers);
+
+	glob = vardata->root->glob;
+	if (glob->statsslot_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(StatsSlotCacheKey);
+		ctl.entrysize = sizeof(StatsSlotCacheEntry);
+		ctl.hcxt = vardata->root->planner_cxt;
+		glob->statsslot_cache = hash_create("pg_statistic slot cache", 64,
+											&ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	stats = (Form_pg_statistic) GETSTRUCT(vardata->statsTuple);
+
+	/* zero the whole key, since it is hashed as a blob including padding */
+	MemSet(&key, 0, sizeof(key));
+	key.starelid = stats->starelid;
+	key.staattnum = stats->staattnum;
+	key.stainherit = stats->stainherit;
+	key.wantvalues = (values != NULL);
+	key.wantnumbers = (numbers != NULL);
+	key.reqkind = reqkind;
+	key.reqop = reqop;
+	key.atttype = (values != NULL) ? vardata->atttype : InvalidOid;
+
+	entry = (StatsSlotCacheEntry *) hash_search(glob->statsslot_cache,
+												&key, HASH_ENTER, &found);
+	if (!found)
+	{
+		/*
+		 * Extract the slot into the planner's context, so that it survives
+		 * short-lived contexts such as GEQO's.
+		 */
+		entry->found = false;
+		entry->actualop = InvalidOid;
+		entry->values = NULL;
+		entry->nvalues = 0;
+		entry->numbers = NULL;
+		entry->nnumbers = 0;
+
+		oldcxt = MemoryContextSwitchTo(vardata->root->planner_cxt);
+		entry->found = get_attstatsslot(vardata->statsTuple,
+										vardata->atttype, vardata->atttypmod,
+										reqkind, reqop, &entry->actualop,
+										values ? &entry->values : NULL,
+										values ? &entry->nvalues : NULL,
+										numbers ? &entry->numbers : NULL,
+										numbers ? &entry->nnumbers : NULL);
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	if (!entry->found)
+		return false;
+
+	if (actualop)
+		*actualop = entry->actualop;
+	if (values)
+	{
+		*values = entry->values;
+		*nvalues = entry->nvalues;
+	}
+	if (numbers)
+	{
+		*numbers = entry->numbers;
+		*nnumbers = entry->nnumbers;
+	}
+	return true;
+}
+
+/*
+ * free_variable_statsslot
+ *	  Release the arrays returned by get_variable_statsslot().
+ *
+ * Cached arrays stay around until the end of planning; only those that
+ * were extracted without the cache are freed here.
+ */
+void
+free_variable_statsslot(VariableStatData *vardata,
+						Datum *values, int nvalues,
+						float4 *numbers, int nnumbers)
+{
+	if (statsslot_cache_usable(vardata))
+		return;
+
+	free_attstatsslot(vardata->atttype, values, nvalues, numbers, nnumbers);
+}
+
 /*
  * get_variable_numdistinct
  *	  Estimate the number of distinct values of a variable.
@@ -4838,12 +5172,11 @@ get_variable_range(PlannerInfo *root, VariableStatData *vardata, Oid sortop,
 	 * the one we want, fail --- this suggests that there is data we can't
 	 * use.
 	 */
-	if (get_attstatsslot(vardata->statsTuple,
-						 vardata->atttype, vardata->atttypmod,
-						 STATISTIC_KIND_HISTOGRAM, sortop,
-						 NULL,
-						 &values, &nvalues,
-						 NULL, NULL))
+	if (get_variable_statsslot(vardata,
+							   STATISTIC_KIND_HISTOGRAM, sortop,
+							   NULL,
+							   &values, &nvalues,
+							   NULL, NULL))
 	{
 		if (nvalues > 0)
 		{
@@ -4851,16 +5184,15 @@ get_variable_range(PlannerInfo *root, VariableStatData *vardata, Oid sortop,
 			tmax = datumCopy(values[nvalues - 1], typByVal, typLen);
 			have_data = true;
 		}
-		free_attstatsslot(vardata->atttype, values, nvalues, NULL, 0);
+		free_variable_statsslot(vardata, values, nvalues, NULL, 0);
 	}
-	else if (get_attstatsslot(vardata->statsTuple,
-							  vardata->atttype, vardata->atttypmod,
-							  STATISTIC_KIND_HISTOGRAM, InvalidOid,
-							  NULL,
-							  &values, &nvalues,
-							  NULL, NULL))
+	else if (get_variable_statsslot(vardata,
+									STATISTIC_KIND_HISTOGRAM, InvalidOid,
+									NULL,
+									&values, &nvalues,
+									NULL, NULL))
 	{
-		free_attstatsslot(vardata->atttype, values, nvalues, NULL, 0);
+		free_variable_statsslot(vardata, values, nvalues, NULL, 0);
 		return false;
 	}
 
@@ -4870,12 +5202,11 @@ get_variable_range(PlannerInfo *root, VariableStatData *vardata, Oid sortop,
 	 * the MCVs.  However, usually the MCVs will not be the extreme values, so
 	 * avoid unnecessary data copying.
 	 */
-	if (get_attstatsslot(vardata->statsTuple,
-						 vardata->atttype, vardata->atttypmod,
-						 STATISTIC_KIND_MCV, InvalidOid,
-						 NULL,
-						 &values, &nvalues,
-						 NULL, NULL))
+	if (get_variable_statsslot(vardata,
+							   STATISTIC_KIND_MCV, InvalidOid,
+							   NULL,
+							   &values, &nvalues,
+							   NULL, NULL))
 	{
 		bool		tmin_is_mcv = false;
 		bool		tmax_is_mcv = false;
@@ -4910,7 +5241,7 @@ get_variable_range(PlannerInfo *root, VariableStatData *vardata, Oid sortop,
 			tmin = datumCopy(tmin, typByVal, typLen);
 		if (tmax_is_mcv)
 			tmax = datumCopy(tmax, typByVal, typLen);
-		free_attstatsslot(vardata->atttype, values, nvalues, NULL, 0);
+		free_variable_statsslot(vardata, values, nvalues, NULL, 0);
 	}
 
 	*min = tmin;
@@ -6436,6 +6767,81 @@ add_predicate_to_quals(IndexOptInfo *index, List *indexQuals)
 	return list_concat(predExtraQuals, indexQuals);
 }
 
+/*
+ * Estimate the cost of a btree skip scan, which does a primitive index scan
+ * for each distinct value of the first index column, bounded by the quals on
+ * the second column (see _bt_advance_skip_key).  Returns false if we don't
+ * know the number of distinct values.
+ */
+static bool
+btcost_skip_scan(PlannerInfo *root, IndexPath *path, double loop_count,
+				 List *qinfos, GenericCosts *costs)
+{
+	IndexOptInfo *index = path->indexinfo;
+	TargetEntry *tle = (TargetEntry *) linitial(index->indextlist);
+	VariableStatData vardata;
+	double		ndistinct;
+	bool		isdefault;
+	List	   *skipBoundQuals = NIL;
+	List	   *selectivityQuals;
+	double		num_sa_scans = 1;
+	double		numIndexTuples;
+	Cost		descentCost;
+	ListCell   *lc;
+
+	examine_variable(root, (Node *) tle->expr, 0, &vardata);
+	ndistinct = get_variable_numdistinct(&vardata, &isdefault);
+	ReleaseVariableStats(vardata);
+	if (isdefault)
+		return false;
+
+	foreach(lc, qinfos)
+	{
+		IndexQualInfo *qinfo = (IndexQualInfo *) lfirst(lc);
+
+		if (qinfo->indexcol != 1)
+			break;
+		if (IsA(qinfo->rinfo->clause, ScalarArrayOpExpr))
+		{
+			int			alength = estimate_array_length(qinfo->other_operand);
+
+			if (alength > 1)
+				num_sa_scans *= alength;
+		}
+		skipBoundQuals = lappend(skipBoundQuals, qinfo->rinfo);
+	}
+
+	selectivityQuals = add_predicate_to_quals(index, skipBoundQuals);
+	numIndexTuples = clauselist_selectivity(root, selectivityQuals,
+											index->rel->relid,
+											JOIN_INNER,
+											NULL) * index->rel->tuples;
+
+	/* We have to visit at least one leaf page per primitive scan */
+	if (index->pages > 1 && index->tuples > 1)
+		numIndexTuples = Max(numIndexTuples,
+							 Min(ndistinct * num_sa_scans, index->pages) *
+							 index->tuples / index->pages);
+	numIndexTuples = rint(numIndexTuples / num_sa_scans);
+
+	MemSet(costs, 0, sizeof(GenericCosts));
+	costs->numIndexTuples = numIndexTuples;
+
+	genericcostestimate(root, path, loop_count, qinfos, costs);
+
+	/*
+	 * Charge for the descents as btcostestimate does, once per SA scan for
+	 * each distinct value, plus once more to find the next distinct value.
+	 */
+	descentCost = (index->tree_height + 1) * 50.0 * cpu_operator_cost;
+	if (index->tuples > 1)		/* avoid computing log(0) */
+		descentCost += ceil(log(index->tuples) / log(2.0)) * cpu_operator_cost;
+	costs->indexStartupCost += descentCost;
+	costs->indexTotalCost += ndistinct * (costs->num_sa_scans + 1) * descentCost;
+
+	return true;
+}
+
 
 Datum
 btcostestimate(PG_FUNCTION_ARGS)
@@ -6556,7 +6962,7 @@ btcostestimate(PG_FUNCTION_ARGS)
 	 * NullTest invalidates that theory, even though it sets eqQualHere.
 	 */
 	if (index->unique &&
-		indexcol == index->ncolumns - 1 &&
+		indexcol == index->nkeycolumns - 1 &&
 		eqQualHere &&
 		!found_saop &&
 		!found_is_null_op)
@@ -6627,6 +7033,23 @@ btcostestimate(PG_FUNCTION_ARGS)
 	costs.indexStartupCost += descentCost;
 	costs.indexTotalCost += costs.num_sa_scans * descentCost;
 
+	/*
+	 * With no quals on the first index column, the whole index has to be
+	 * read, unless there are quals on the second column: then the scan can
+	 * skip from each distinct value of the first column to the next.  Use
+	 * that estimate if it's cheaper; the scan itself falls back to reading
+	 * everything if skipping turns out not to pay.
+	 */
+	if (indexBoundQuals == NIL && index->nkeycolumns > 1 && qinfos != NIL &&
+		((IndexQualInfo *) linitial(qinfos))->indexcol == 1)
+	{
+		GenericCosts skipcosts;
+
+		if (btcost_skip_scan(root, path, loop_count, qinfos, &skipcosts) &&
+			skipcosts.indexTotalCost < costs.indexTotalCost)
+			costs = skipcosts;
+	}
+
 	/*
 	 * If we can get an estimate of the first column's ordering correlation C
 	 * from pg_statistic, estimate the index correlation as C for a
@@ -6636,6 +7059,7 @@ btcostestimate(PG_FUNCTION_ARGS)
 	 * correlation by the number of columns, but that seems too strong.)
 	 */
 	MemSet(&vardata, 0, sizeof(vardata));
+	vardata.root = root;
 
 	if (index->indexkeys[0] != 0)
 	{
@@ -6705,12 +7129,12 @@ btcostestimate(PG_FUNCTION_ARGS)
 									 index->opcintype[0],
 									 BTLessStrategyNumber);
 		if (OidIsValid(sortop) &&
-			get_attstatsslot(vardata.statsTuple, InvalidOid, 0,
-							 STATISTIC_KIND_CORRELATION,
-							 sortop,
-							 NULL,
-							 NULL, NULL,
-							 &numbers, &nnumbers))
+			get_variable_statsslot(&vardata,
+								   STATISTIC_KIND_CORRELATION,
+								   sortop,
+								   NULL,
+								   NULL, NULL,
+								   &numbers, &nnumbers))
 		{
 			double		varCorrelation;
 
@@ -6720,12 +7144,12 @@ btcostestimate(PG_FUNCTION_ARGS)
 			if (index->reverse_sort[0])
 				varCorrelation = -varCorrelation;
 
-			if (index->ncolumns > 1)
+			if (index->nkeycolumns > 1)
 				costs.indexCorrelation = varCorrelation * 0.75;
 			else
 				costs.indexCorrelation = varCorrelation;
 
-			free_attstatsslot(InvalidOid, NULL, 0, numbers, nnumbers);
+			free_variable_statsslot(&vardata, NULL, 0, numbers, nnumbers);
 		}
 	}
 
@@ -15,7 +15,6 @@
 #include "postgres.h"
 
 #include "access/genam.h"
-#include "access/hash.h"
 #include "access/heapam.h"
 #include "access/relscan.h"
 #include "access/sysattr.h"
@@ -24,6 +23,7 @@
 #include "access/xact.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_type.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #ifdef CATCACHE_STATS
 #include "storage/ipc.h"		/* for on_proc_exit */
@@ -31,10 +31,12 @@
 #include "storage/lmgr.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
+#include "utils/hashutils.h"
 #include "utils/inval.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
+#include "utils/sharedcatcache.h"
 #include "utils/syscache.h"
 #include "utils/tqual.h"
 
@@ -72,6 +74,9 @@
 /* Cache management header --- pointer is NULL until created */
 static CatCacheHeader *CacheHdr = NULL;
 
+/* GUC parameter: limit on memory used by catcache tuples, in kB; 0 = none */
+int			catalog_cache_memory_limit = 0;
+
 
 static uint32 CatalogCacheComputeHashValue(CatCache *cache, int nkeys,
 							 ScanKey cur_skey);
@@ -83,6 +88,7 @@ static void CatCachePrintStats(int code, Datum arg);
 #endif
 static void CatCacheRemoveCTup(CatCache *cache, CatCTup *ct);
 static void CatCacheRemoveCList(CatCache *cache, CatCList *cl);
+static void CatCacheEnforceMemoryLimit(Size newsize);
 static void CatalogCacheInitializeCache(CatCache *cache);
 static CatCTup *CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 						uint32 hashValue, Index hashIndex,
@@ -94,6 +100,80 @@ static HeapTuple build_dummy_tuple(CatCache *cache, int nkeys, ScanKey skeys);
  *					internal support functions
  */
 
+/*
+ * Hash functions for the catcache key types.
+ *
+ * Catcache hash values are only ever kept in memory (they are shipped in
+ * invalidation messages, but those never outlive the cluster's processes),
+ * so these use the fast in-memory hash functions instead of going through
+ * the fmgr-callable hash opclass functions.
+ */
+static uint32
+charhashfast(Datum datum)
+{
+	return murmurhash32((int32) DatumGetChar(datum));
+}
+
+static uint32
+namehashfast(Datum datum)
+{
+	char	   *key = NameStr(*DatumGetName(datum));
+
+	return hash_bytes_fast((unsigned char *) key, strlen(key));
+}
+
+static uint32
+int2hashfast(Datum datum)
+{
+	return murmurhash32((int32) DatumGetInt16(datum));
+}
+
+static uint32
+int4hashfast(Datum datum)
+{
+	return murmurhash32((int32) DatumGetInt32(datum));
+}
+
+static uint32
+texthashfast(Datum datum)
+{
+	text	   *key = DatumGetTextPP(datum);
+	uint32		result;
+
+	result = hash_bytes_fast((unsigned char *) VARDATA_ANY(key),
+							 VARSIZE_ANY_EXHDR(key));
+
+	/* Avoid leaking memory for toasted inputs */
+	if ((Pointer) key != DatumGetPointer(datum))
+		pfree(key);
+
+	return result;
+}
+
+static uint32
+oidhashfast(Datum datum)
+{
+	return murmurhash32((uint32) DatumGetObjectId(datum));
+}
+
+static uint32
+int2vectorhashfast(Datum datum)
+{
+	int2vector *key = (int2vector *) DatumGetPointer(datum);
+
+	return hash_bytes_fast((unsigned char *) key->values,
+						   key->dim1 * sizeof(int16));
+}
+
+static uint32
+oidvectorhashfast(Datum datum)
+{
+	oidvector  *key = (oidvector *) DatumGetPointer(datum);
+
+	return hash_bytes_fast((unsigned char *) key->values,
+						   key->dim1 * sizeof(Oid));
+}
+
 /*
  * Look up the hash and equality functions for system types that are used
  * as cache key fields.
@@ -102,42 +182,42 @@ static HeapTuple build_dummy_tuple(CatCache *cache, int nkeys, ScanKey skeys);
  * but that seems to pose considerable risk of circularity...
  */
 static void
-GetCCHashEqFuncs(Oid keytype, PGFunction *hashfunc, RegProcedure *eqfunc)
+GetCCHashEqFuncs(Oid keytype, CCHashFN *hashfunc, RegProcedure *eqfunc)
 {
 	switch (keytype)
 	{
 		case BOOLOID:
-			*hashfunc = hashchar;
+			*hashfunc = charhashfast;
 
 			*eqfunc = F_BOOLEQ;
 			break;
 		case CHAROID:
-			*hashfunc = hashchar;
+			*hashfunc = charhashfast;
 
 			*eqfunc = F_CHAREQ;
 			break;
 		case NAMEOID:
-			*hashfunc = hashname;
+			*hashfunc = namehashfast;
 
 			*eqfunc = F_NAMEEQ;
 			break;
 		case INT2OID:
-			*hashfunc = hashint2;
+			*hashfunc = int2hashfast;
 
 			*eqfunc = F_INT2EQ;
 			break;
 		case INT2VECTOROID:
-			*hashfunc = hashint2vector;
+			*hashfunc = int2vectorhashfast;
 
 			*eqfunc = F_INT2VECTOREQ;
 			break;
 		case INT4OID:
-			*hashfunc = hashint4;
+			*hashfunc = int4hashfast;
 
 			*eqfunc = F_INT4EQ;
 			break;
 		case TEXTOID:
-			*hashfunc = hashtext;
+			*hashfunc = texthashfast;
 
 			*eqfunc = F_TEXTEQ;
 			break;
@@ -152,12 +232,12 @@ GetCCHashEqFuncs(Oid keytype, PGFunction *hashfunc, RegProcedure *eqfunc)
 		case REGDICTIONARYOID:
 		case REGROLEOID:
 		case REGNAMESPACEOID:
-			*hashfunc = hashoid;
+			*hashfunc = oidhashfast;
 
 			*eqfunc = F_OIDEQ;
 			break;
 		case OIDVECTOROID:
-			*hashfunc = hashoidvector;
+			*hashfunc = oidvectorhashfast;
 
 			*eqfunc = F_OIDVECTOREQ;
 			break;
@@ -189,30 +269,22 @@ CatalogCacheComputeHashValue(CatCache *cache, int nkeys, ScanKey cur_skey)
 	switch (nkeys)
 	{
 		case 4:
-			oneHash =
-				DatumGetUInt32(DirectFunctionCall1(cache->cc_hashfunc[3],
-												   cur_skey[3].sk_argument));
+			oneHash = (cache->cc_hashfunc[3]) (cur_skey[3].sk_argument);
 			hashValue ^= oneHash << 24;
 			hashValue ^= oneHash >> 8;
 			/* FALLTHROUGH */
 		case 3:
-			oneHash =
-				DatumGetUInt32(DirectFunctionCall1(cache->cc_hashfunc[2],
-												   cur_skey[2].sk_argument));
+			oneHash = (cache->cc_hashfunc[2]) (cur_skey[2].sk_argument);
 			hashValue ^= oneHash << 16;
 			hashValue ^= oneHash >> 16;
 			/* FALLTHROUGH */
 		case 2:
-			oneHash =
-				DatumGetUInt32(DirectFunctionCall1(cache->cc_hashfunc[1],
-												   cur_skey[1].sk_argument));
+			oneHash = (cache->cc_hashfunc[1]) (cur_skey[1].sk_argument);
 			hashValue ^= oneHash << 8;
 			hashValue ^= oneHash >> 24;
 			/* FALLTHROUGH */
 		case 1:
-			oneHash =
-				DatumGetUInt32(DirectFunctionCall1(cache->cc_hashfunc[0],
-												   cur_skey[0].sk_argument));
+			oneHash = (cache->cc_hashfunc[0]) (cur_skey[0].sk_argument);
 			hashValue ^= oneHash;
 			break;
 		default:
@@ -302,6 +374,7 @@ CatCachePrintStats(int code, Datum arg)
 	long		cc_invals = 0;
 	long		cc_lsearches = 0;
 	long		cc_lhits = 0;
+	long		cc_evictions = 0;
 
 	slist_foreach(iter, &CacheHdr->ch_caches)
 	{
@@ -309,7 +382,7 @@ CatCachePrintStats(int code, Datum arg)
 
 		if (cache->cc_ntup == 0 && cache->cc_searches == 0)
 			continue;			/* don't print unused caches */
-		elog(DEBUG2, "catcache %s/%u: %d tup, %ld srch, %ld+%ld=%ld hits, %ld+%ld=%ld loads, %ld invals, %ld lsrch, %ld lhits",
+		elog(DEBUG2, "catcache %s/%u: %d tup, %ld srch, %ld+%ld=%ld hits, %ld+%ld=%ld loads, %ld invals, %ld lsrch, %ld lhits, %ld evicts",
 			 cache->cc_relname,
 			 cache->cc_indexoid,
 			 cache->cc_ntup,
@@ -322,7 +395,8 @@ CatCachePrintStats(int code, Datum arg)
 			 cache->cc_searches - cache->cc_hits - cache->cc_neg_hits,
 			 cache->cc_invals,
 			 cache->cc_lsearches,
-			 cache->cc_lhits);
+			 cache->cc_lhits,
+			 cache->cc_evictions);
 		cc_searches += cache->cc_searches;
 		cc_hits += cache->cc_hits;
 		cc_neg_hits += cache->cc_neg_hits;
@@ -330,8 +404,9 @@ CatCachePrintStats(int code, Datum arg)
 		cc_invals += cache->cc_invals;
 		cc_lsearches += cache->cc_lsearches;
 		cc_lhits += cache->cc_lhits;
+		cc_evictions += cache->cc_evictions;
 	}
-	elog(DEBUG2, "catcache totals: %d tup, %ld srch, %ld+%ld=%ld hits, %ld+%ld=%ld loads, %ld invals, %ld lsrch, %ld lhits",
+	elog(DEBUG2, "catcache totals: %d tup, %ld srch, %ld+%ld=%ld hits, %ld+%ld=%ld loads, %ld invals, %ld lsrch, %ld lhits, %ld evicts",
 		 CacheHdr->ch_ntup,
 		 cc_searches,
 		 cc_hits,
@@ -342,7 +417,8 @@ CatCachePrintStats(int code, Datum arg)
 		 cc_searches - cc_hits - cc_neg_hits,
 		 cc_invals,
 		 cc_lsearches,
-		 cc_lhits);
+		 cc_lhits,
+		 cc_evictions);
 }
 #endif   /* CATCACHE_STATS */
 
@@ -373,8 +449,12 @@ CatCacheRemoveCTup(CatCache *cache, CatCTup *ct)
 		return;					/* nothing left to do */
 	}
 
-	/* delink from linked list */
+	/* delink from linked lists */
 	dlist_delete(&ct->cache_elem);
+	dlist_delete(&ct->lru_elem);
+
+	cache->cc_memusage -= ct->ct_size;
+	CacheHdr->ch_memusage -= ct->ct_size;
 
 	/* free associated tuple data */
 	if (ct->tuple.t_data != NULL)
@@ -385,6 +465,52 @@ CatCacheRemoveCTup(CatCache *cache, CatCTup *ct)
 	--CacheHdr->ch_ntup;
 }
 
+/*
+ *		CatCacheEnforceMemoryLimit
+ *
+ * Evict least recently used entries until there is room for newsize more
+ * bytes under catalog_cache_memory_limit, or nothing evictable is left.
+ *
+ * Only entries that nobody holds a reference to, directly or through a
+ * CatCList, can go; evicting one that is a list member takes the list with
+ * it.  This is the same thing an invalidation would do to the entry, so
+ * callers see nothing but an extra catalog lookup later.
+ */
+static void
+CatCacheEnforceMemoryLimit(Size newsize)
+{
+	Size		limit = (Size) catalog_cache_memory_limit * 1024;
+
+	while (CacheHdr->ch_memusage + newsize > limit)
+	{
+		dlist_iter	iter;
+		CatCTup    *victim = NULL;
+
+		/*
+		 * Search from the LRU end for an unreferenced entry.  We start over
+		 * after each eviction, because removing a list can also remove other
+		 * members of it.
+		 */
+		dlist_reverse_foreach(iter, &CacheHdr->ch_lru)
+		{
+			CatCTup    *ct = dlist_container(CatCTup, lru_elem, iter.cur);
+
+			if (ct->refcount == 0 &&
+				(ct->c_list == NULL || ct->c_list->refcount == 0))
+			{
+				victim = ct;
+				break;
+			}
+		}
+
+		if (victim == NULL)
+			break;				/* everything left is in use */
+
+		victim->my_cache->cc_evictions++;
+		CatCacheRemoveCTup(victim->my_cache, victim);
+	}
+}
+
 /*
  *		CatCacheRemoveCList
  *
@@ -503,9 +629,7 @@ CatalogCacheIdInvalidate(int cacheId, uint32 hashValue)
 				else
 					CatCacheRemoveCTup(ccp, ct);
 				CACHE1_elog(DEBUG2, "CatalogCacheIdInvalidate: invalidated");
-#ifdef CATCACHE_STATS
 				ccp->cc_invals++;
-#endif
 				/* could be multiple matches, so keep looking! */
 			}
 		}
@@ -636,9 +760,7 @@ ResetCatalogCache(CatCache *cache)
 			}
 			else
 				CatCacheRemoveCTup(cache, ct);
-#ifdef CATCACHE_STATS
 			cache->cc_invals++;
-#endif
 		}
 	}
 }
@@ -764,6 +886,8 @@ InitCatCache(int id,
 		CacheHdr = (CatCacheHeader *) palloc(sizeof(CatCacheHeader));
 		slist_init(&CacheHdr->ch_caches);
 		CacheHdr->ch_ntup = 0;
+		CacheHdr->ch_memusage = 0;
+		dlist_init(&CacheHdr->ch_lru);
 #ifdef CATCACHE_STATS
 		/* set up to dump stats at backend exit */
 		on_proc_exit(CatCachePrintStats, 0);
@@ -1122,6 +1246,7 @@ SearchCatCache(CatCache *cache,
 	Relation	relation;
 	SysScanDesc scandesc;
 	HeapTuple	ntp;
+	SharedCatCacheTag shared_tag;
 
 	/* Make sure we're in an xact, even if this ends up being a cache hit */
 	Assert(IsTransactionState());
@@ -1132,9 +1257,7 @@ SearchCatCache(CatCache *cache,
 	if (cache->cc_tupdesc == NULL)
 		CatalogCacheInitializeCache(cache);
 
-#ifdef CATCACHE_STATS
 	cache->cc_searches++;
-#endif
 
 	/*
 	 * initialize the search key information
@@ -1188,6 +1311,7 @@ SearchCatCache(CatCache *cache,
 		 * near the front of the hashbucket's list.)
 		 */
 		dlist_move_head(bucket, &ct->cache_elem);
+		dlist_move_head(&CacheHdr->ch_lru, &ct->lru_elem);
 
 		/*
 		 * If it's a positive entry, bump its refcount and return it. If it's
@@ -1202,9 +1326,7 @@ SearchCatCache(CatCache *cache,
 			CACHE3_elog(DEBUG2, "SearchCatCache(%s): found in bucket %d",
 						cache->cc_relname, hashIndex);
 
-#ifdef CATCACHE_STATS
 			cache->cc_hits++;
-#endif
 
 			return &ct->tuple;
 		}
@@ -1213,9 +1335,7 @@ SearchCatCache(CatCache *cache,
 			CACHE3_elog(DEBUG2, "SearchCatCache(%s): found neg entry in bucket %d",
 						cache->cc_relname, hashIndex);
 
-#ifdef CATCACHE_STATS
 			cache->cc_neg_hits++;
-#endif
 
 			return NULL;
 		}
@@ -1235,7 +1355,37 @@ SearchCatCache(CatCache *cache,
 	 * will eventually age out of the cache, so there's no functional problem.
 	 * This case is rare enough that it's not worth expending extra cycles to
 	 * detect.
+	 *
+	 * Before reading the relation, see whether another backend has put the
+	 * tuple in the shared catalog cache.
 	 */
+	ntp = SharedCatCacheLookup(cache, hashValue, &shared_tag);
+	if (ntp != NULL)
+	{
+		bool		res;
+
+		HeapKeyTest(ntp, cache->cc_tupdesc, cache->cc_nkeys, cur_skey, res);
+		if (res)
+		{
+			ct = CatalogCacheCreateEntry(cache, ntp,
+										 hashValue, hashIndex,
+										 false);
+			heap_freetuple(ntp);
+			/* immediately set the refcount to 1 */
+			ResourceOwnerEnlargeCatCacheRefs(CurrentResourceOwner);
+			ct->refcount++;
+			ResourceOwnerRememberCatCacheRef(CurrentResourceOwner, &ct->tuple);
+
+			CACHE3_elog(DEBUG2, "SearchCatCache(%s): put shared tuple in bucket %d",
+						cache->cc_relname, hashIndex);
+
+			cache->cc_newloads++;
+
+			return &ct->tuple;
+		}
+		heap_freetuple(ntp);
+	}
+
 	relation = heap_open(cache->cc_reloid, AccessShareLock);
 
 	scandesc = systable_beginscan(relation,
@@ -1252,6 +1402,8 @@ SearchCatCache(CatCache *cache,
 		ct = CatalogCacheCreateEntry(cache, ntp,
 									 hashValue, hashIndex,
 									 false);
+		/* offer the flattened copy to other backends */
+		SharedCatCacheStore(cache, &ct->tuple, &shared_tag);
 		/* immediately set the refcount to 1 */
 		ResourceOwnerEnlargeCatCacheRefs(CurrentResourceOwner);
 		ct->refcount++;
@@ -1302,9 +1454,7 @@ SearchCatCache(CatCache *cache,
 	CACHE3_elog(DEBUG2, "SearchCatCache(%s): put in bucket %d",
 				cache->cc_relname, hashIndex);
 
-#ifdef CATCACHE_STATS
 	cache->cc_newloads++;
-#endif
 
 	return &ct->tuple;
 }
@@ -1421,9 +1571,7 @@ SearchCatCacheList(CatCache *cache,
 
 	Assert(nkeys > 0 && nkeys < cache->cc_nkeys);
 
-#ifdef CATCACHE_STATS
 	cache->cc_lsearches++;
-#endif
 
 	/*
 	 * initialize the search key information
@@ -1477,9 +1625,16 @@ SearchCatCacheList(CatCache *cache,
 		 * cache's list-of-lists, to speed subsequent searches.  (We do not
 		 * move the members to the fronts of their hashbucket lists, however,
 		 * since there's no point in that unless they are searched for
-		 * individually.)
+		 * individually.)  The members do count as used for the purposes of
+		 * eviction, though, since evicting any of them would kill the list.
 		 */
 		dlist_move_head(&cache->cc_lists, &cl->cache_elem);
+		if (catalog_cache_memory_limit > 0)
+		{
+			for (i = 0; i < cl->n_members; i++)
+				dlist_move_head(&CacheHdr->ch_lru,
+								&cl->members[i]->lru_elem);
+		}
 
 		/* Bump the list's refcount and return it */
 		ResourceOwnerEnlargeCatCacheListRefs(CurrentResourceOwner);
@@ -1489,9 +1644,7 @@ SearchCatCacheList(CatCache *cache,
 		CACHE2_elog(DEBUG2, "SearchCatCacheList(%s): found list",
 					cache->cc_relname);
 
-#ifdef CATCACHE_STATS
 		cache->cc_lhits++;
-#endif
 
 		return cl;
 	}
@@ -1711,6 +1864,13 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 	else
 		dtp = ntp;
 
+	/*
+	 * If the caches are over their memory limit, make room first.  Doing it
+	 * before the new entry exists means it can't be chosen as a victim.
+	 */
+	if (catalog_cache_memory_limit > 0)
+		CatCacheEnforceMemoryLimit(sizeof(CatCTup) + dtp->t_len);
+
 	/*
 	 * Allocate CatCTup header in cache memory, and copy the tuple there too.
 	 */
@@ -1719,6 +1879,9 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 	heap_copytuple_with_tuple(dtp, &ct->tuple);
 	MemoryContextSwitchTo(oldcxt);
 
+	ct->ct_size = GetMemoryChunkSpace(ct) +
+		GetMemoryChunkSpace(ct->tuple.t_data);
+
 	if (dtp != ntp)
 		heap_freetuple(dtp);
 
@@ -1735,9 +1898,12 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 	ct->hash_value = hashValue;
 
 	dlist_push_head(&cache->cc_bucket[hashIndex], &ct->cache_elem);
+	dlist_push_head(&CacheHdr->ch_lru, &ct->lru_elem);
 
 	cache->cc_ntup++;
 	CacheHdr->ch_ntup++;
+	cache->cc_memusage += ct->ct_size;
+	CacheHdr->ch_memusage += ct->ct_size;
 
 	/*
 	 * If the hash table has become too full, enlarge the buckets array. Quite
@@ -1936,3 +2102,104 @@ PrintCatCacheListLeakWarning(CatCList *list)
 		 list->my_cache->cc_relname, list->my_cache->id,
 		 list, list->refcount);
 }
+
+
+/*
+ * pg_get_catalog_cache_stats
+ *		SQL SRF showing the size and hit rates of this backend's catalog
+ *		caches, with one extra row for the relation cache.
+ */
+#define PG_GET_CATALOG_CACHE_STATS_COLS	10
+
+Datum
+pg_get_catalog_cache_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Datum		values[PG_GET_CATALOG_CACHE_STATS_COLS];
+	bool		nulls[PG_GET_CATALOG_CACHE_STATS_COLS];
+	long		nentries;
+	long		searches;
+	long		hits;
+	long		invals;
+	long		evictions;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	/* need to build tuplestore in query context */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore =
+		tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random,
+							  false, work_mem);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (CacheHdr != NULL)
+	{
+		slist_iter	iter;
+
+		slist_foreach(iter, &CacheHdr->ch_caches)
+		{
+			CatCache   *cache = slist_container(CatCache, cc_next, iter.cur);
+			long		nhits = cache->cc_hits + cache->cc_neg_hits;
+
+			memset(nulls, 0, sizeof(nulls));
+
+			values[0] = CStringGetTextDatum(cache->cc_relname);
+			values[1] = Int32GetDatum(cache->id);
+			values[2] = Int64GetDatum(cache->cc_ntup);
+			values[3] = Int64GetDatum(cache->cc_memusage);
+			values[4] = Int64GetDatum(cache->cc_searches);
+			values[5] = Int64GetDatum(nhits);
+			values[6] = Int64GetDatum(cache->cc_neg_hits);
+			values[7] = Int64GetDatum(cache->cc_searches - nhits);
+			values[8] = Int64GetDatum(cache->cc_invals);
+			values[9] = Int64GetDatum(cache->cc_evictions);
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	/* the relcache has no id, and doesn't track its memory or negatives */
+	RelationCacheGetStats(&nentries, &searches, &hits, &invals, &evictions);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = CStringGetTextDatum("relcache");
+	nulls[1] = true;
+	values[2] = Int64GetDatum(nentries);
+	nulls[3] = true;
+	values[4] = Int64GetDatum(searches);
+	values[5] = Int64GetDatum(hits);
+	nulls[6] = true;
+	values[7] = Int64GetDatum(searches - hits);
+	values[8] = Int64GetDatum(invals);
+	values[9] = Int64GetDatum(evictions);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	return (Datum) 0;
+}
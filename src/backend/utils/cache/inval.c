@@ -1059,6 +1059,19 @@ CommandEndInvalidationMessages(void)
 }
 
 
+/*
+ * TransactionHasPendingInvalidations
+ *		Has the current transaction queued any invalidation messages?
+ *
+ * This is the case once it has changed the contents of any catalog, which
+ * means its catalog snapshot may see rows nobody else can.
+ */
+bool
+TransactionHasPendingInvalidations(void)
+{
+	return transInvalInfo != NULL;
+}
+
 /*
  * CacheInvalidateHeapTuple
  *		Register the given tuple for invalidation at end of command
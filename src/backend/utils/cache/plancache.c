@@ -19,6 +19,11 @@
  * re-planning if the active search_path is different from the previous time
  * or, if RLS is involved, if the user changes or the RLS environment changes.
  *
+ * Generic plans of saved statements can also be shared with other backends
+ * through sharedplancache.c, if shared_plan_cache_size is set.  The query
+ * tree is still built and validated locally; only planning is skipped when
+ * another backend already published a plan for the same statement.
+ *
  * Note that if the sinval was a result of user DDL actions, parse analysis
  * could throw an error, for example if a column referenced by the query is
  * no longer present.  Another possibility is for the query's output tupdesc
@@ -68,6 +73,7 @@
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
 #include "utils/rls.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -883,6 +889,7 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	List	   *plist;
 	bool		snapshot_set;
 	bool		spi_pushed;
+	SharedPlanTag shared_tag;
 	MemoryContext plan_context;
 	MemoryContext oldcxt = CurrentMemoryContext;
 
@@ -903,50 +910,68 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 		qlist = RevalidateCachedQuery(plansource);
 
 	/*
-	 * If we don't already have a copy of the querytree list that can be
-	 * scribbled on by the planner, make one.  For a one-shot plan, we assume
-	 * it's okay to scribble on the original query_list.
+	 * A generic plan may already have been built by another backend; see
+	 * sharedplancache.c.  This must come before planning starts, so that the
+	 * shared cache can tell whether its invalidations overlap our planning.
 	 */
-	if (qlist == NIL)
-	{
-		if (!plansource->is_oneshot)
-			qlist = (List *) copyObject(plansource->query_list);
-		else
-			qlist = plansource->query_list;
-	}
+	plist = NIL;
+	shared_tag.shareable = false;
+	if (boundParams == NULL)
+		plist = SharedPlanCacheLookup(plansource, &shared_tag);
 
-	/*
-	 * If a snapshot is already set (the normal case), we can just use that
-	 * for planning.  But if it isn't, and we need one, install one.
-	 */
-	snapshot_set = false;
-	if (!ActiveSnapshotSet() &&
-		plansource->raw_parse_tree &&
-		analyze_requires_snapshot(plansource->raw_parse_tree))
+	if (plist == NIL)
 	{
-		PushActiveSnapshot(GetTransactionSnapshot());
-		snapshot_set = true;
-	}
+		/*
+		 * If we don't already have a copy of the querytree list that can be
+		 * scribbled on by the planner, make one.  For a one-shot plan, we
+		 * assume it's okay to scribble on the original query_list.
+		 */
+		if (qlist == NIL)
+		{
+			if (!plansource->is_oneshot)
+				qlist = (List *) copyObject(plansource->query_list);
+			else
+				qlist = plansource->query_list;
+		}
 
-	/*
-	 * The planner may try to call SPI-using functions, which causes a problem
-	 * if we're already inside one.  Rather than expect all SPI-using code to
-	 * do SPI_push whenever a replan could happen, it seems best to take care
-	 * of the case here.
-	 */
-	spi_pushed = SPI_push_conditional();
+		/*
+		 * If a snapshot is already set (the normal case), we can just use
+		 * that for planning.  But if it isn't, and we need one, install one.
+		 */
+		snapshot_set = false;
+		if (!ActiveSnapshotSet() &&
+			plansource->raw_parse_tree &&
+			analyze_requires_snapshot(plansource->raw_parse_tree))
+		{
+			PushActiveSnapshot(GetTransactionSnapshot());
+			snapshot_set = true;
+		}
 
-	/*
-	 * Generate the plan.
-	 */
-	plist = pg_plan_queries(qlist, plansource->cursor_options, boundParams);
+		/*
+		 * The planner may try to call SPI-using functions, which causes a
+		 * problem if we're already inside one.  Rather than expect all
+		 * SPI-using code to do SPI_push whenever a replan could happen, it
+		 * seems best to take care of the case here.
+		 */
+		spi_pushed = SPI_push_conditional();
 
-	/* Clean up SPI state */
-	SPI_pop_conditional(spi_pushed);
+		/*
+		 * Generate the plan.
+		 */
+		plist = pg_plan_queries(qlist, plansource->cursor_options,
+								boundParams);
 
-	/* Release snapshot if we got one */
-	if (snapshot_set)
-		PopActiveSnapshot();
+		/* Clean up SPI state */
+		SPI_pop_conditional(spi_pushed);
+
+		/* Release snapshot if we got one */
+		if (snapshot_set)
+			PopActiveSnapshot();
+
+		/* Offer the new generic plan to other backends */
+		if (shared_tag.shareable)
+			SharedPlanCacheStore(plansource, &shared_tag, plist);
+	}
 
 	/*
 	 * Normally we make a dedicated memory context for the CachedPlan and its
@@ -1262,6 +1287,114 @@ ReleaseCachedPlan(CachedPlan *plan, bool useResOwner)
 	}
 }
 
+/*
+ * CachedPlanAllowsSimpleValidityCheck: can we use CachedPlanIsSimplyValid?
+ *
+ * GetCachedPlan has to do a fair amount of work every time even when the
+ * generic plan turns out to be still good, mostly on account of the locks
+ * the plan needs.  A plan that touches no tables needs no locks, and then
+ * it is enough to check that nothing has marked it invalid, which callers
+ * executing such a plan very often can do with CachedPlanIsSimplyValid.
+ * This function tells whether plan, just obtained from GetCachedPlan, is
+ * a generic plan of that kind.
+ */
+bool
+CachedPlanAllowsSimpleValidityCheck(CachedPlanSource *plansource,
+									CachedPlan *plan)
+{
+	ListCell   *lc;
+
+	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
+	Assert(plan->magic == CACHEDPLAN_MAGIC);
+
+	if (plansource->is_oneshot || !plansource->is_saved ||
+		!plansource->is_valid)
+		return false;
+	if (plan != plansource->gplan || !plan->is_valid)
+		return false;
+
+	/*
+	 * Row security and transient plans ought not be possible without tables,
+	 * but these are what RevalidateCachedQuery and CheckCachedPlan would
+	 * look at besides locks, so make sure.
+	 */
+	if (plansource->hasRowSecurity)
+		return false;
+	if (TransactionIdIsValid(plan->saved_xmin))
+		return false;
+
+	/* Reject if AcquirePlannerLocks would have anything to do */
+	if (plansource->relationOids != NIL)
+		return false;
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = (Query *) lfirst(lc);
+
+		Assert(IsA(query, Query));
+		if (query->commandType == CMD_UTILITY)
+			return false;
+		if (query->rtable || query->cteList || query->hasSubLinks)
+			return false;
+	}
+
+	/* Reject if AcquireExecutorLocks would have anything to do */
+	foreach(lc, plan->stmt_list)
+	{
+		PlannedStmt *plannedstmt = (PlannedStmt *) lfirst(lc);
+		ListCell   *lc2;
+
+		if (!IsA(plannedstmt, PlannedStmt))
+			return false;
+		foreach(lc2, plannedstmt->rtable)
+		{
+			RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc2);
+
+			if (rte->rtekind == RTE_RELATION)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * CachedPlanIsSimplyValid: quick check whether a plan is still good to use
+ *
+ * plan must be one that CachedPlanAllowsSimpleValidityCheck accepted for
+ * plansource, though it may since have been released: we only look at it
+ * once we know it's still plansource's generic plan.  If it is still valid,
+ * its refcount is incremented as by GetCachedPlan, and true is returned.
+ * Otherwise the caller must fall back on GetCachedPlan.
+ */
+bool
+CachedPlanIsSimplyValid(CachedPlanSource *plansource, CachedPlan *plan,
+						bool useResOwner)
+{
+	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
+
+	if (!plansource->is_valid || plan != plansource->gplan || !plan->is_valid)
+		return false;
+
+	Assert(plan->magic == CACHEDPLAN_MAGIC);
+
+	/* Is the search_path still the same as when we made it? */
+	Assert(plansource->search_path != NULL);
+	if (!OverrideSearchPathMatchesCurrent(plansource->search_path))
+		return false;
+
+	/* Flag the plan as in use by caller */
+	if (useResOwner)
+	{
+		Assert(plan->is_saved);
+		ResourceOwnerEnlargePlanCacheRefs(CurrentResourceOwner);
+	}
+	plan->refcount++;
+	if (useResOwner)
+		ResourceOwnerRememberPlanCacheRef(CurrentResourceOwner, plan);
+
+	return true;
+}
+
 /*
  * CachedPlanSetParentContext: move a CachedPlanSource to a new memory context
  *
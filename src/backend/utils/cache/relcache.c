@@ -51,6 +51,7 @@
 #include "catalog/pg_opclass.h"
 #include "catalog/pg_proc.h"
 #include "catalog/pg_rewrite.h"
+#include "catalog/pg_statistic_ext.h"
 #include "catalog/pg_tablespace.h"
 #include "catalog/pg_trigger.h"
 #include "catalog/pg_type.h"
@@ -133,6 +134,18 @@ bool		criticalSharedRelcachesBuilt = false;
  */
 static long relcacheInvalsReceived = 0L;
 
+/*
+ * GUC parameter: if more than this many relcache entries exist, unreferenced
+ * entries are evicted, using a clock sweep over the hashtable.  Zero means
+ * no limit.
+ */
+int			relation_cache_max_entries = 0;
+
+/* statistics, see pg_catalog_cache_stats */
+static long relcacheSearches = 0L;
+static long relcacheHits = 0L;
+static long relcacheEvictions = 0L;
+
 /*
  * eoxact_list[] stores the OIDs of relations that (might) need AtEOXact
  * cleanup work.  This list intentionally has limited size; if it overflows,
@@ -237,6 +250,7 @@ static HTAB *OpClassCache = NULL;
 
 static void RelationDestroyRelation(Relation relation, bool remember_tupdesc);
 static void RelationClearRelation(Relation relation, bool rebuild);
+static void RelationCacheEvict(void);
 
 static void RelationReloadIndexInfo(Relation relation);
 static void RelationFlushRelation(Relation relation);
@@ -1288,11 +1302,13 @@ RelationInitIndexAccessInfo(Relation relation)
 	/*
 	 * Fill the support procedure OID array, as well as the info about
 	 * opfamilies and opclass input types.  (aminfo and supportinfo are left
-	 * as zeroes, and are filled on-the-fly when used)
+	 * as zeroes, and are filled on-the-fly when used)  Included columns have
+	 * no opclass, so their entries stay zero too.
 	 */
 	IndexSupportInitialize(indclass, relation->rd_support,
 						   relation->rd_opfamily, relation->rd_opcintype,
-						   amsupport, natts);
+						   amsupport,
+						   IndexRelationGetNumberOfKeyAttributes(relation));
 
 	/*
 	 * Similarly extract indoption and copy it to the cache entry
@@ -1741,8 +1757,12 @@ RelationIdGetRelation(Oid relationId)
 	 */
 	RelationIdCacheLookup(relationId, rd);
 
+	relcacheSearches++;
+
 	if (RelationIsValid(rd))
 	{
+		relcacheHits++;
+		rd->rd_recentlyused = true;
 		RelationIncrementReferenceCount(rd);
 		/* revalidate cache entry if necessary */
 		if (!rd->rd_isvalid)
@@ -1767,10 +1787,95 @@ RelationIdGetRelation(Oid relationId)
 	 */
 	rd = RelationBuildDesc(relationId, true);
 	if (RelationIsValid(rd))
+	{
 		RelationIncrementReferenceCount(rd);
+		rd->rd_recentlyused = true;
+
+		/* Now that it's pinned, make room if the cache is over its limit */
+		if (relation_cache_max_entries > 0 && criticalRelcachesBuilt &&
+			hash_get_num_entries(RelationIdCache) > relation_cache_max_entries)
+			RelationCacheEvict();
+	}
 	return rd;
 }
 
+/*
+ * RelationCacheEvict
+ *
+ *	 Shrink the relcache to 90% of relation_cache_max_entries, by throwing
+ *	 away entries nobody has open.
+ *
+ *	 This is a clock sweep: an entry used since the previous sweep only has
+ *	 its rd_recentlyused flag cleared, and goes the next time around.  Nailed
+ *	 entries, and entries with transaction-local state, are never evicted.
+ *	 Dropping an unreferenced entry is exactly what a relcache invalidation
+ *	 would do to it, so nobody can tell the difference other than by the
+ *	 cost of rebuilding it later.
+ */
+static void
+RelationCacheEvict(void)
+{
+	long		target;
+	int			pass;
+
+	target = relation_cache_max_entries - relation_cache_max_entries / 10;
+
+	/* two passes suffice, since the first one clears all the flags */
+	for (pass = 0; pass < 2; pass++)
+	{
+		HASH_SEQ_STATUS status;
+		RelIdCacheEnt *idhentry;
+
+		if (hash_get_num_entries(RelationIdCache) <= target)
+			break;
+
+		hash_seq_init(&status, RelationIdCache);
+		while ((idhentry = (RelIdCacheEnt *) hash_seq_search(&status)) != NULL)
+		{
+			Relation	relation = idhentry->reldesc;
+
+			if (!RelationHasReferenceCountZero(relation) ||
+				relation->rd_isnailed ||
+				relation->rd_createSubid != InvalidSubTransactionId ||
+				relation->rd_newRelfilenodeSubid != InvalidSubTransactionId)
+				continue;
+
+			if (relation->rd_recentlyused)
+			{
+				relation->rd_recentlyused = false;
+				continue;
+			}
+
+			/* this deletes the current hashtable entry, which is allowed */
+			RelationClearRelation(relation, false);
+			relcacheEvictions++;
+
+			if (hash_get_num_entries(RelationIdCache) <= target)
+			{
+				hash_seq_term(&status);
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * RelationCacheGetStats
+ *
+ *	 Report the size of the relcache and its hit, invalidation and eviction
+ *	 counts.
+ */
+void
+RelationCacheGetStats(long *nentries, long *searches, long *hits,
+					  long *invals, long *evictions)
+{
+	*nentries = RelationIdCache ? hash_get_num_entries(RelationIdCache) : 0;
+	*searches = relcacheSearches;
+	*hits = relcacheHits;
+	*invals = relcacheInvalsReceived;
+	*evictions = relcacheEvictions;
+}
+
 /* ----------------------------------------------------------------
  *				cache invalidation support routines
  * ----------------------------------------------------------------
@@ -2001,6 +2106,7 @@ RelationDestroyRelation(Relation relation, bool remember_tupdesc)
 			FreeTupleDesc(relation->rd_att);
 	}
 	list_free(relation->rd_indexlist);
+	list_free(relation->rd_statlist);
 	bms_free(relation->rd_indexattr);
 	bms_free(relation->rd_keyattr);
 	bms_free(relation->rd_idattr);
@@ -2019,6 +2125,8 @@ RelationDestroyRelation(Relation relation, bool remember_tupdesc)
 		MemoryContextDelete(relation->rd_rsdesc->rscxt);
 	if (relation->rd_fdwroutine)
 		pfree(relation->rd_fdwroutine);
+	if (relation->rd_tableam)
+		pfree(relation->rd_tableam);
 	pfree(relation);
 }
 
@@ -3087,7 +3195,8 @@ RelationSetNewRelfilenode(Relation relation, char persistence,
 	newrnode.node = relation->rd_node;
 	newrnode.node.relNode = newrelfilenode;
 	newrnode.backend = relation->rd_backend;
-	RelationCreateStorage(newrnode.node, persistence);
+	RelationCreateStorage(newrnode.node, persistence,
+						  RelationWantsCompression(relation));
 	smgrclosenode(newrnode);
 
 	/*
@@ -3922,6 +4031,77 @@ RelationGetIndexList(Relation relation)
 	return result;
 }
 
+/*
+ * RelationGetStatExtList
+ *		get a list of OIDs of extended statistics on this relation
+ *
+ * The statistics list is created only if someone requests it, in a way
+ * similar to RelationGetIndexList().  We scan pg_statistic_ext to find
+ * relevant statistics, and add the list to the relcache entry so that we
+ * won't have to compute it again.  Note that shared cache inval of a
+ * relcache entry will delete the old list and set rd_statvalid to false,
+ * so that we must recompute the statistics list on next request.  This
+ * handles creation or deletion of a statistics object.
+ *
+ * The returned list is guaranteed to be sorted in order by OID, although
+ * this is not currently needed.
+ *
+ * The caller may list_free() the returned list after scanning it.
+ */
+List *
+RelationGetStatExtList(Relation relation)
+{
+	Relation	indrel;
+	SysScanDesc indscan;
+	ScanKeyData skey;
+	HeapTuple	htup;
+	List	   *result;
+	List	   *oldlist;
+	MemoryContext oldcxt;
+
+	/* Quick exit if we already computed the list. */
+	if (relation->rd_statvalid)
+		return list_copy(relation->rd_statlist);
+
+	/*
+	 * We build the list we intend to return (in the caller's context) while
+	 * doing the scan.  After successfully completing the scan, we copy that
+	 * list into the relcache entry.  This avoids cache-context memory leakage
+	 * if we get some sort of error partway through.
+	 */
+	result = NIL;
+
+	/* Prepare to scan pg_statistic_ext for entries having stxrelid = this rel. */
+	ScanKeyInit(&skey,
+				Anum_pg_statistic_ext_stxrelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(RelationGetRelid(relation)));
+
+	indrel = heap_open(StatisticExtRelationId, AccessShareLock);
+	indscan = systable_beginscan(indrel, StatisticExtRelidIndexId, true,
+								 NULL, 1, &skey);
+
+	while (HeapTupleIsValid(htup = systable_getnext(indscan)))
+		result = insert_ordered_oid(result, HeapTupleGetOid(htup));
+
+	systable_endscan(indscan);
+
+	heap_close(indrel, AccessShareLock);
+
+	/* Now save a copy of the completed list in the relcache entry. */
+	oldcxt = MemoryContextSwitchTo(CacheMemoryContext);
+	oldlist = relation->rd_statlist;
+	relation->rd_statlist = list_copy(result);
+
+	relation->rd_statvalid = true;
+	MemoryContextSwitchTo(oldcxt);
+
+	/* Don't leak the old list, if there is one */
+	list_free(oldlist);
+
+	return result;
+}
+
 /*
  * insert_ordered_oid
  *		Insert a new Oid into a sorted list of Oids, preserving ordering
@@ -4281,7 +4461,10 @@ RelationGetIndexAttrBitmap(Relation relation, IndexAttrBitmapKind attrKind)
 		/* Is this index the configured (or default) replica identity? */
 		isIDKey = (indexOid == relreplindex);
 
-		/* Collect simple attribute references */
+		/*
+		 * Collect simple attribute references.  Included columns are not
+		 * part of the unique or replica identity key.
+		 */
 		for (i = 0; i < indexInfo->ii_NumIndexAttrs; i++)
 		{
 			int			attrnum = indexInfo->ii_KeyAttrNumbers[i];
@@ -4291,11 +4474,11 @@ RelationGetIndexAttrBitmap(Relation relation, IndexAttrBitmapKind attrKind)
 				indexattrs = bms_add_member(indexattrs,
 							   attrnum - FirstLowInvalidHeapAttributeNumber);
 
-				if (isKey)
+				if (isKey && i < indexInfo->ii_NumIndexKeyAttrs)
 					uindexattrs = bms_add_member(uindexattrs,
 							   attrnum - FirstLowInvalidHeapAttributeNumber);
 
-				if (isIDKey)
+				if (isIDKey && i < indexInfo->ii_NumIndexKeyAttrs)
 					idindexattrs = bms_add_member(idindexattrs,
 							   attrnum - FirstLowInvalidHeapAttributeNumber);
 			}
@@ -4875,6 +5058,7 @@ load_relcache_init_file(bool shared)
 		rel->rd_exclprocs = NULL;
 		rel->rd_exclstrats = NULL;
 		rel->rd_fdwroutine = NULL;
+		rel->rd_tableam = NULL;
 
 		/*
 		 * Reset transient-state fields in the relcache entry
@@ -4886,6 +5070,8 @@ load_relcache_init_file(bool shared)
 			rel->rd_refcnt = 0;
 		rel->rd_indexvalid = 0;
 		rel->rd_indexlist = NIL;
+		rel->rd_statvalid = false;
+		rel->rd_statlist = NIL;
 		rel->rd_oidindex = InvalidOid;
 		rel->rd_replidindex = InvalidOid;
 		rel->rd_indexattr = NULL;
@@ -4894,6 +5080,7 @@ load_relcache_init_file(bool shared)
 		rel->rd_createSubid = InvalidSubTransactionId;
 		rel->rd_newRelfilenodeSubid = InvalidSubTransactionId;
 		rel->rd_amcache = NULL;
+		rel->rd_sortedinsert = false;
 		MemSet(&rel->pgstat_info, 0, sizeof(rel->pgstat_info));
 
 		/*
@@ -0,0 +1,493 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedcatcache.c
+ *	  Cross-backend cache of system catalog tuples.
+ *
+ * Every backend fills its own catcache by reading the catalogs, so with
+ * many connections the same pg_class, pg_attribute and pg_proc rows are
+ * fetched over and over, and each new connection pays for all of them
+ * again.  When shared_catalog_cache_size is set, catalog tuples loaded by
+ * SearchCatCache are also published in a shared memory area, and a backend
+ * that misses its local catcache checks there before scanning the catalog.
+ * The local catcache stays in front as the private cache; it can be kept
+ * small with catalog_cache_memory_limit.
+ *
+ * Entries are keyed on the database, the syscache id and the hash value of
+ * the lookup keys, which is exactly what a catcache invalidation message
+ * carries, so invalidating an entry is a single hash probe.  The shared
+ * cache can hold only one tuple per key; the caller still checks that a
+ * tuple it gets back matches its search keys, so a hash collision costs at
+ * most a catalog scan.  Only positive entries are shared, and list searches
+ * are not.
+ *
+ * Invalidation piggybacks on the sinval machinery: SendSharedInvalidMessages
+ * passes every batch of messages here before queueing it, so an entry is
+ * gone before any backend can act on the message that invalidates it.
+ * That leaves three races to close, all on the storing side:
+ *
+ * - A tuple must not be stored if it was read before a concurrent change
+ *	 but the change's invalidation went past before the store.  As in
+ *	 sharedplancache.c, a counter of invalidations is read before the
+ *	 catalog scan and the store is skipped if it moved.
+ * - A tuple that somebody has deleted or updated, but whose deletion our
+ *	 catalog snapshot doesn't see yet, must not be stored, since that
+ *	 transaction's invalidation may have gone past already.  We only store
+ *	 tuples with no xmax other than a row lock.
+ * - A transaction that changed catalogs itself sees its own uncommitted
+ *	 state, which must neither be published nor be shadowed by shared
+ *	 entries, so such transactions don't use the shared cache at all.
+ *
+ * On the reading side, an entry is only used if its inserting transaction
+ * precedes the xmin of our catalog snapshot, so that we never see a tuple
+ * our own catalog scan would not have returned.  Deletions are covered by
+ * invalidation, exactly as for entries in the local catcache.
+ *
+ * Tuples are kept in flattened form, in a pool of fixed-size chunks chained
+ * per entry, like in sharedplancache.c.  When the pool or the hash table
+ * runs out, the older half of the entries is evicted in one sweep.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedcatcache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/sharedcatcache.h"
+#include "utils/snapmgr.h"
+
+
+/* Size of a chunk of tuple data, including its link word */
+#define SCC_CHUNK_SIZE		256
+#define SCC_CHUNK_DATA		(SCC_CHUNK_SIZE - sizeof(int))
+
+/* Tuples larger than this are not shared */
+#define SCC_MAX_TUPLE_SIZE	BLCKSZ
+
+typedef struct SharedCatCacheChunk
+{
+	int			next;			/* next chunk of the entry, or -1 */
+	char		data[SCC_CHUNK_DATA];
+} SharedCatCacheChunk;
+
+typedef struct SharedCatCacheEntry
+{
+	SharedCatCacheKey key;		/* hash key; must be first */
+	Oid			reloid;			/* catalog the tuple belongs to */
+	TransactionId xmin;			/* inserting transaction of the tuple */
+	ItemPointerData t_self;		/* location of the tuple in the catalog */
+	uint32		t_len;			/* length of the tuple data */
+	int			first_chunk;	/* first chunk of the tuple data */
+	uint32		last_used;		/* clock value at last use */
+} SharedCatCacheEntry;
+
+typedef struct SharedCatCacheCtl
+{
+	int			nchunks;		/* size of the chunk pool */
+	int			max_entries;	/* size of the hash table */
+	int			free_chunk;		/* head of the free chunk list, or -1 */
+	int			nfree;			/* number of free chunks */
+	uint64		inval_count;	/* bumped by every relevant invalidation */
+	pg_atomic_uint32 clock;		/* source of last_used values */
+} SharedCatCacheCtl;
+
+/* GUC parameter */
+int			shared_catalog_cache_size = 0;
+
+/* Pointers to shared state; all NULL if the cache is disabled */
+static SharedCatCacheCtl *SharedCatCache = NULL;
+static SharedCatCacheChunk *SharedCatCacheChunks = NULL;
+static HTAB *SharedCatCacheHash = NULL;
+
+static void scc_get_sizes(int *nchunks, int *max_entries);
+static void scc_remove_entry(SharedCatCacheEntry *entry);
+static bool scc_evict(void);
+
+
+/*
+ * Work out the shape of the shared area from shared_catalog_cache_size.
+ * Most catalog tuples fit in one or two chunks, so there is one hash table
+ * slot per chunk.
+ */
+static void
+scc_get_sizes(int *nchunks, int *max_entries)
+{
+	*nchunks = (int) (((Size) shared_catalog_cache_size * 1024) /
+					  SCC_CHUNK_SIZE);
+	*max_entries = Max(*nchunks, 1);
+}
+
+/*
+ * SharedCatCacheShmemSize
+ *		Compute space needed for the shared catalog cache
+ */
+Size
+SharedCatCacheShmemSize(void)
+{
+	Size		size;
+	int			nchunks;
+	int			max_entries;
+
+	if (shared_catalog_cache_size <= 0)
+		return 0;
+
+	scc_get_sizes(&nchunks, &max_entries);
+
+	size = MAXALIGN(sizeof(SharedCatCacheCtl));
+	size = add_size(size, mul_size(nchunks, sizeof(SharedCatCacheChunk)));
+	size = add_size(size, hash_estimate_size(max_entries,
+											 sizeof(SharedCatCacheEntry)));
+
+	return size;
+}
+
+/*
+ * SharedCatCacheShmemInit
+ *		Allocate and initialize the shared catalog cache
+ */
+void
+SharedCatCacheShmemInit(void)
+{
+	HASHCTL		info;
+	int			nchunks;
+	int			max_entries;
+	bool		found;
+
+	if (shared_catalog_cache_size <= 0)
+		return;
+
+	scc_get_sizes(&nchunks, &max_entries);
+
+	SharedCatCache = (SharedCatCacheCtl *)
+		ShmemInitStruct("Shared Catalog Cache Ctl",
+						sizeof(SharedCatCacheCtl), &found);
+	SharedCatCacheChunks = (SharedCatCacheChunk *)
+		ShmemInitStruct("Shared Catalog Cache Chunks",
+						mul_size(nchunks, sizeof(SharedCatCacheChunk)),
+						&found);
+
+	if (!found)
+	{
+		int			i;
+
+		SharedCatCache->nchunks = nchunks;
+		SharedCatCache->max_entries = max_entries;
+		for (i = 0; i < nchunks; i++)
+			SharedCatCacheChunks[i].next = (i + 1 < nchunks) ? i + 1 : -1;
+		SharedCatCache->free_chunk = (nchunks > 0) ? 0 : -1;
+		SharedCatCache->nfree = nchunks;
+		SharedCatCache->inval_count = 0;
+		pg_atomic_init_u32(&SharedCatCache->clock, 0);
+	}
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(SharedCatCacheKey);
+	info.entrysize = sizeof(SharedCatCacheEntry);
+	SharedCatCacheHash = ShmemInitHash("Shared Catalog Cache Hash",
+									   max_entries, max_entries,
+									   &info,
+									   HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * SharedCatCacheLookup
+ *		Look for a catalog tuple loaded by some backend.
+ *
+ * Returns a palloc'd copy of the tuple stored under the cache's id and
+ * hashValue, or NULL if there is none.  The caller must check that the
+ * tuple matches its search keys.  If it gets NULL or a tuple that doesn't
+ * match, it should read the catalog and pass what it finds to
+ * SharedCatCacheStore along with the same tag.
+ */
+HeapTuple
+SharedCatCacheLookup(CatCache *cache, uint32 hashValue,
+					 SharedCatCacheTag *tag)
+{
+	SharedCatCacheEntry *entry;
+	Snapshot	snapshot;
+	HeapTuple	tuple = NULL;
+
+	tag->shareable = false;
+
+	if (SharedCatCache == NULL ||
+		IsBootstrapProcessingMode() ||
+		TransactionHasPendingInvalidations())
+		return NULL;
+
+	MemSet(&tag->key, 0, sizeof(SharedCatCacheKey));
+	tag->key.dbid = cache->cc_relisshared ? InvalidOid : MyDatabaseId;
+	tag->key.cacheid = cache->id;
+	tag->key.hashvalue = hashValue;
+	tag->shareable = true;
+
+	snapshot = GetCatalogSnapshot(cache->cc_reloid);
+
+	LWLockAcquire(SharedCatCacheLock, LW_SHARED);
+
+	tag->inval_count = SharedCatCache->inval_count;
+
+	entry = (SharedCatCacheEntry *) hash_search(SharedCatCacheHash,
+												&tag->key, HASH_FIND, NULL);
+	if (entry != NULL && TransactionIdPrecedes(entry->xmin, snapshot->xmin))
+	{
+		Size		off = 0;
+		int			chunk = entry->first_chunk;
+
+		tuple = (HeapTuple) palloc(HEAPTUPLESIZE + entry->t_len);
+		tuple->t_len = entry->t_len;
+		tuple->t_self = entry->t_self;
+		tuple->t_tableOid = entry->reloid;
+		tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
+
+		while (off < entry->t_len)
+		{
+			Size		n = Min(entry->t_len - off, SCC_CHUNK_DATA);
+
+			Assert(chunk >= 0);
+			memcpy((char *) tuple->t_data + off,
+				   SharedCatCacheChunks[chunk].data, n);
+			off += n;
+			chunk = SharedCatCacheChunks[chunk].next;
+		}
+
+		/* a racy store is fine; the clock only guides eviction */
+		entry->last_used = pg_atomic_fetch_add_u32(&SharedCatCache->clock, 1);
+	}
+
+	LWLockRelease(SharedCatCacheLock);
+
+	return tuple;
+}
+
+/*
+ * SharedCatCacheStore
+ *		Publish a catalog tuple the caller just read.
+ *
+ * tag must have been filled in by a SharedCatCacheLookup call made before
+ * the catalog scan started.  tuple must be flattened, as catcache entries
+ * are.  Tuples that can't be shared are silently skipped.
+ */
+void
+SharedCatCacheStore(CatCache *cache, HeapTuple tuple, SharedCatCacheTag *tag)
+{
+	HeapTupleHeader tup = tuple->t_data;
+	TransactionId xmin = HeapTupleHeaderGetXmin(tup);
+	SharedCatCacheEntry *entry;
+	Size		off;
+	int			nchunks;
+	int		   *chunkp;
+	bool		found;
+
+	if (!tag->shareable || tuple->t_len > SCC_MAX_TUPLE_SIZE)
+		return;
+
+	/* Our own uncommitted tuples are none of anybody else's business */
+	if (TransactionIdIsNormal(xmin) && TransactionIdIsCurrentTransactionId(xmin))
+		return;
+
+	/* Don't store tuples somebody is deleting or has deleted, see above */
+	if (!(tup->t_infomask & HEAP_XMAX_INVALID) &&
+		TransactionIdIsValid(HeapTupleHeaderGetRawXmax(tup)) &&
+		!HEAP_XMAX_IS_LOCKED_ONLY(tup->t_infomask))
+		return;
+
+	nchunks = (int) ((tuple->t_len + SCC_CHUNK_DATA - 1) / SCC_CHUNK_DATA);
+
+	LWLockAcquire(SharedCatCacheLock, LW_EXCLUSIVE);
+
+	/*
+	 * If anything was invalidated since the lookup, the tuple might be one
+	 * that is already gone.  We'll get another chance next time.
+	 */
+	if (SharedCatCache->inval_count != tag->inval_count)
+		goto done;
+
+	/*
+	 * Somebody else may have stored the tuple in the meantime; keep theirs.
+	 * (This also makes the first of two colliding tuples win.)
+	 */
+	if (hash_search(SharedCatCacheHash, &tag->key, HASH_FIND, NULL) != NULL)
+		goto done;
+
+	/* Make room */
+	while (SharedCatCache->nfree < nchunks ||
+		   hash_get_num_entries(SharedCatCacheHash) >=
+		   SharedCatCache->max_entries)
+	{
+		if (!scc_evict())
+			goto done;
+	}
+
+	entry = (SharedCatCacheEntry *) hash_search(SharedCatCacheHash,
+												&tag->key,
+												HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+		goto done;
+	Assert(!found);
+
+	entry->reloid = cache->cc_reloid;
+	entry->xmin = xmin;
+	entry->t_self = tuple->t_self;
+	entry->t_len = tuple->t_len;
+	entry->last_used = pg_atomic_fetch_add_u32(&SharedCatCache->clock, 1);
+
+	/* Copy the tuple into chunks taken off the free list */
+	off = 0;
+	chunkp = &entry->first_chunk;
+	while (off < tuple->t_len)
+	{
+		int			chunk = SharedCatCache->free_chunk;
+		Size		n = Min(tuple->t_len - off, SCC_CHUNK_DATA);
+
+		Assert(chunk >= 0);
+		SharedCatCache->free_chunk = SharedCatCacheChunks[chunk].next;
+		SharedCatCache->nfree--;
+
+		memcpy(SharedCatCacheChunks[chunk].data, (char *) tup + off, n);
+		off += n;
+		*chunkp = chunk;
+		chunkp = &SharedCatCacheChunks[chunk].next;
+	}
+	*chunkp = -1;
+
+done:
+	LWLockRelease(SharedCatCacheLock);
+}
+
+/*
+ * Remove an entry, returning its chunks to the free list.  Caller must hold
+ * SharedCatCacheLock exclusively.
+ */
+static void
+scc_remove_entry(SharedCatCacheEntry *entry)
+{
+	int			chunk = entry->first_chunk;
+
+	while (chunk >= 0)
+	{
+		int			next = SharedCatCacheChunks[chunk].next;
+
+		SharedCatCacheChunks[chunk].next = SharedCatCache->free_chunk;
+		SharedCatCache->free_chunk = chunk;
+		SharedCatCache->nfree++;
+		chunk = next;
+	}
+
+	hash_search(SharedCatCacheHash, &entry->key, HASH_REMOVE, NULL);
+}
+
+/*
+ * Evict the least recently used half of the entries, by age.  There can be
+ * a great many entries, so unlike sharedplancache.c we don't evict them one
+ * at a time; a sweep costs two passes over the hash table and normally
+ * makes room for many stores.  Returns false if the cache is empty.
+ * Caller must hold SharedCatCacheLock exclusively.
+ */
+static bool
+scc_evict(void)
+{
+	HASH_SEQ_STATUS status;
+	SharedCatCacheEntry *entry;
+	uint32		now = pg_atomic_read_u32(&SharedCatCache->clock);
+	uint32		max_age = 0;
+	bool		any = false;
+
+	hash_seq_init(&status, SharedCatCacheHash);
+	while ((entry = (SharedCatCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		max_age = Max(max_age, now - entry->last_used);
+		any = true;
+	}
+
+	if (!any)
+		return false;
+
+	hash_seq_init(&status, SharedCatCacheHash);
+	while ((entry = (SharedCatCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		/* dynahash allows deleting the entry just returned */
+		if (now - entry->last_used >= max_age / 2)
+			scc_remove_entry(entry);
+	}
+
+	return true;
+}
+
+/*
+ * SharedCatCacheInvalidate
+ *		Drop the shared tuples affected by invalidation messages.
+ *
+ * Called by SendSharedInvalidMessages for every batch of messages a process
+ * is about to broadcast.  Catcache messages drop the one entry they name;
+ * catalog messages, sent when a catalog was rewritten, drop all entries of
+ * the catalog, since their t_self is no longer valid.
+ */
+void
+SharedCatCacheInvalidate(const SharedInvalidationMessage *msgs, int n)
+{
+	HASH_SEQ_STATUS status;
+	SharedCatCacheEntry *entry;
+	bool		locked = false;
+	int			i;
+
+	if (SharedCatCache == NULL)
+		return;
+
+	for (i = 0; i < n; i++)
+	{
+		const SharedInvalidationMessage *msg = &msgs[i];
+
+		if (msg->id < 0 && msg->id != SHAREDINVALCATALOG_ID)
+			continue;
+
+		if (!locked)
+		{
+			LWLockAcquire(SharedCatCacheLock, LW_EXCLUSIVE);
+			SharedCatCache->inval_count++;
+			locked = true;
+		}
+
+		if (msg->id >= 0)
+		{
+			SharedCatCacheKey key;
+
+			MemSet(&key, 0, sizeof(SharedCatCacheKey));
+			key.dbid = msg->cc.dbId;
+			key.cacheid = msg->cc.id;
+			key.hashvalue = msg->cc.hashValue;
+
+			entry = (SharedCatCacheEntry *)
+				hash_search(SharedCatCacheHash, &key, HASH_FIND, NULL);
+			if (entry != NULL)
+				scc_remove_entry(entry);
+		}
+		else
+		{
+			hash_seq_init(&status, SharedCatCacheHash);
+			while ((entry = (SharedCatCacheEntry *)
+					hash_seq_search(&status)) != NULL)
+			{
+				if (entry->reloid == msg->cat.catId &&
+					(!OidIsValid(msg->cat.dbId) ||
+					 entry->key.dbid == msg->cat.dbId))
+					scc_remove_entry(entry);
+			}
+		}
+	}
+
+	if (locked)
+		LWLockRelease(SharedCatCacheLock);
+}
@@ -0,0 +1,696 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.c
+ *	  Cross-backend cache of generic plans for saved statements.
+ *
+ * plancache.c keeps its CachedPlanSources and CachedPlans in backend-local
+ * memory, so with many connections running the same prepared statements,
+ * every backend plans every statement for itself.  When
+ * shared_plan_cache_size is set, the generic plans of saved statements are
+ * also published in a shared memory area, and a backend about to build a
+ * generic plan first checks whether one was already built elsewhere.
+ *
+ * Plan trees are full of pointers into backend-local memory, so what is
+ * shared is their nodeToString() form; a backend that finds a plan reads
+ * it back with stringToNode() and from then on caches it locally like one
+ * it planned itself.  Parse analysis and rewriting still happen in each
+ * backend, which is what lets us identify a statement reliably: the
+ * identity of a shared plan is the text form of the analyzed-and-rewritten
+ * query list, together with the cursor options and the active search_path
+ * (the planner can parse SQL function bodies while inlining them).  Entries
+ * are hashed on that identity plus the database and the current role, and
+ * the identity is compared in full on lookup, so a hash collision costs at
+ * most a plan.  Custom plans are never shared, and neither are plans that
+ * can't be read back in a different backend: utility statements, plans
+ * depending on TransactionXmin, and plans containing custom or foreign
+ * scans, whose private data may not have readfuncs support.
+ *
+ * Invalidation mirrors plancache.c's sinval callbacks.  Each entry records
+ * the relations and functions its plan depends on, and whenever a backend
+ * (or the startup process, during hot standby replay) broadcasts
+ * invalidation messages, SendSharedInvalidMessages passes them here first so
+ * that the entries they affect are dropped before anyone can act on the
+ * messages.  A plan is stored only if no invalidation happened since its
+ * planner started looking at the catalogs, which closes the window in which
+ * a plan built from catalog rows that were just replaced could be stored
+ * after the invalidation already went past.
+ *
+ * The shared area is a fixed-size hash table of entries plus a pool of
+ * fixed-size chunks holding their text, chained per entry.  When either runs
+ * out, the least recently used entries are evicted.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedplancache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/namespace.h"
+#include "catalog/pg_amop.h"
+#include "catalog/pg_namespace.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_proc.h"
+#include "miscadmin.h"
+#include "nodes/parsenodes.h"
+#include "nodes/plannodes.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/hashutils.h"
+#include "utils/hsearch.h"
+#include "utils/sharedplancache.h"
+#include "utils/syscache.h"
+
+
+/* Size of a chunk of entry text, including its link word */
+#define SPC_CHUNK_SIZE		1024
+#define SPC_CHUNK_DATA		(SPC_CHUNK_SIZE - sizeof(int))
+
+/* Plans with more dependencies than this are not shared */
+#define SPC_MAX_RELIDS		64
+#define SPC_MAX_ITEMS		32
+
+typedef struct SharedPlanChunk
+{
+	int			next;			/* next chunk of the entry, or -1 */
+	char		data[SPC_CHUNK_DATA];
+} SharedPlanChunk;
+
+typedef struct SharedPlanEntry
+{
+	SharedPlanKey key;			/* hash key; must be first */
+	int			first_chunk;	/* first chunk of the text */
+	Size		ident_len;		/* length of the identity data */
+	Size		plan_len;		/* length of the plan text, incl. NUL */
+	uint32		last_used;		/* clock value at last use */
+	int			nrelids;
+	int			nitems;
+	Oid			relids[SPC_MAX_RELIDS];		/* relations the plan uses */
+	int			item_cacheids[SPC_MAX_ITEMS];	/* and other objects, as */
+	uint32		item_hashvalues[SPC_MAX_ITEMS]; /* in PlanInvalItems */
+} SharedPlanEntry;
+
+typedef struct SharedPlanCacheCtl
+{
+	int			nchunks;		/* size of the chunk pool */
+	int			max_entries;	/* size of the hash table */
+	int			free_chunk;		/* head of the free chunk list, or -1 */
+	int			nfree;			/* number of free chunks */
+	uint64		inval_count;	/* bumped by every relevant invalidation */
+	pg_atomic_uint32 clock;		/* source of last_used values */
+} SharedPlanCacheCtl;
+
+/* GUC parameter */
+int			shared_plan_cache_size = 0;
+
+/* Pointers to shared state; all NULL if the cache is disabled */
+static SharedPlanCacheCtl *SharedPlanCache = NULL;
+static SharedPlanChunk *SharedPlanChunks = NULL;
+static HTAB *SharedPlanHash = NULL;
+
+static void spc_get_sizes(int *nchunks, int *max_entries);
+static bool plan_tree_is_shareable(Plan *plan);
+static bool plan_list_is_shareable(List *plans);
+static void spc_remove_entry(SharedPlanEntry *entry);
+static bool spc_evict_one(void);
+static bool spc_message_is_relevant(const SharedInvalidationMessage *msg);
+static bool spc_message_matches(const SharedInvalidationMessage *msg,
+					SharedPlanEntry *entry);
+
+
+/*
+ * Work out the shape of the shared area from shared_plan_cache_size.  Most
+ * entries need several chunks, so there is one hash table slot for every
+ * four of them.
+ */
+static void
+spc_get_sizes(int *nchunks, int *max_entries)
+{
+	*nchunks = (int) (((Size) shared_plan_cache_size * 1024) / SPC_CHUNK_SIZE);
+	*max_entries = Max(*nchunks / 4, 1);
+}
+
+/*
+ * SharedPlanCacheShmemSize
+ *		Compute space needed for the shared plan cache
+ */
+Size
+SharedPlanCacheShmemSize(void)
+{
+	Size		size;
+	int			nchunks;
+	int			max_entries;
+
+	if (shared_plan_cache_size <= 0)
+		return 0;
+
+	spc_get_sizes(&nchunks, &max_entries);
+
+	size = MAXALIGN(sizeof(SharedPlanCacheCtl));
+	size = add_size(size, mul_size(nchunks, sizeof(SharedPlanChunk)));
+	size = add_size(size, hash_estimate_size(max_entries,
+											 sizeof(SharedPlanEntry)));
+
+	return size;
+}
+
+/*
+ * SharedPlanCacheShmemInit
+ *		Allocate and initialize the shared plan cache
+ */
+void
+SharedPlanCacheShmemInit(void)
+{
+	HASHCTL		info;
+	int			nchunks;
+	int			max_entries;
+	bool		found;
+
+	if (shared_plan_cache_size <= 0)
+		return;
+
+	spc_get_sizes(&nchunks, &max_entries);
+
+	SharedPlanCache = (SharedPlanCacheCtl *)
+		ShmemInitStruct("Shared Plan Cache Ctl",
+						sizeof(SharedPlanCacheCtl), &found);
+	SharedPlanChunks = (SharedPlanChunk *)
+		ShmemInitStruct("Shared Plan Cache Chunks",
+						mul_size(nchunks, sizeof(SharedPlanChunk)), &found);
+
+	if (!found)
+	{
+		int			i;
+
+		SharedPlanCache->nchunks = nchunks;
+		SharedPlanCache->max_entries = max_entries;
+		for (i = 0; i < nchunks; i++)
+			SharedPlanChunks[i].next = (i + 1 < nchunks) ? i + 1 : -1;
+		SharedPlanCache->free_chunk = (nchunks > 0) ? 0 : -1;
+		SharedPlanCache->nfree = nchunks;
+		SharedPlanCache->inval_count = 0;
+		pg_atomic_init_u32(&SharedPlanCache->clock, 0);
+	}
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(SharedPlanKey);
+	info.entrysize = sizeof(SharedPlanEntry);
+	SharedPlanHash = ShmemInitHash("Shared Plan Cache Hash",
+								   max_entries, max_entries,
+								   &info,
+								   HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * SharedPlanCacheLookup
+ *		Look for a generic plan of the statement built by some backend.
+ *
+ * Returns the statement's planned statement list, read into the current
+ * memory context, or NIL if there is none.  In the latter case, the caller
+ * should plan the statement and pass the result to SharedPlanCacheStore
+ * along with the same tag.
+ *
+ * The caller must have made sure that plansource's query_list is valid, and
+ * hold the locks that come with that.
+ */
+List *
+SharedPlanCacheLookup(CachedPlanSource *plansource, SharedPlanTag *tag)
+{
+	StringInfoData buf;
+	SharedPlanEntry *entry;
+	List	   *search_path;
+	ListCell   *lc;
+	char	   *querystr;
+	char	   *data = NULL;
+	int			npath;
+	List	   *stmt_list;
+
+	tag->shareable = false;
+
+	if (SharedPlanCache == NULL ||
+		!plansource->is_saved || plansource->is_oneshot)
+		return NIL;
+
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = (Query *) lfirst(lc);
+
+		if (query->commandType == CMD_UTILITY)
+			return NIL;
+	}
+
+	/*
+	 * Build the statement's identity data: the cursor options, the active
+	 * search_path and the text form of the query list.
+	 */
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, (char *) &plansource->cursor_options,
+						   sizeof(int));
+	search_path = fetch_search_path(true);
+	npath = list_length(search_path);
+	appendBinaryStringInfo(&buf, (char *) &npath, sizeof(int));
+	foreach(lc, search_path)
+	{
+		Oid			nspid = lfirst_oid(lc);
+
+		appendBinaryStringInfo(&buf, (char *) &nspid, sizeof(Oid));
+	}
+	list_free(search_path);
+	querystr = nodeToString(plansource->query_list);
+	appendStringInfoString(&buf, querystr);
+	pfree(querystr);
+
+	tag->ident = buf.data;
+	tag->ident_len = buf.len;
+	MemSet(&tag->key, 0, sizeof(SharedPlanKey));
+	tag->key.dbid = MyDatabaseId;
+	tag->key.userid = GetUserId();
+	tag->key.hashvalue = hash_bytes_fast((unsigned char *) buf.data,
+										 buf.len);
+	tag->shareable = true;
+
+	LWLockAcquire(SharedPlanCacheLock, LW_SHARED);
+
+	tag->inval_count = SharedPlanCache->inval_count;
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &tag->key,
+											HASH_FIND, NULL);
+	if (entry != NULL && entry->ident_len == tag->ident_len)
+	{
+		Size		len = entry->ident_len + entry->plan_len;
+		Size		off = 0;
+		int			chunk = entry->first_chunk;
+
+		data = (char *) palloc(len);
+		while (off < len)
+		{
+			Size		n = Min(len - off, SPC_CHUNK_DATA);
+
+			Assert(chunk >= 0);
+			memcpy(data + off, SharedPlanChunks[chunk].data, n);
+			off += n;
+			chunk = SharedPlanChunks[chunk].next;
+		}
+
+		/* a racy store is fine; the clock only guides eviction */
+		entry->last_used = pg_atomic_fetch_add_u32(&SharedPlanCache->clock, 1);
+	}
+
+	LWLockRelease(SharedPlanCacheLock);
+
+	if (data == NULL)
+		return NIL;
+	if (memcmp(data, tag->ident, tag->ident_len) != 0)
+	{
+		/* hash collision with a different statement */
+		pfree(data);
+		return NIL;
+	}
+
+	stmt_list = (List *) stringToNode(data + tag->ident_len);
+	pfree(data);
+
+	return stmt_list;
+}
+
+/*
+ * SharedPlanCacheStore
+ *		Publish a generic plan the caller just built.
+ *
+ * tag must have been filled in by a SharedPlanCacheLookup call made before
+ * planning started.  Plans that can't be shared are silently skipped.
+ */
+void
+SharedPlanCacheStore(CachedPlanSource *plansource, SharedPlanTag *tag,
+					 List *stmt_list)
+{
+	List	   *relids;
+	List	   *items;
+	ListCell   *lc;
+	char	   *planstr;
+	char	   *data;
+	Size		plan_len;
+	Size		len;
+	Size		off;
+	int			nchunks;
+	int		   *chunkp;
+	SharedPlanEntry *entry;
+	bool		found;
+
+	if (!tag->shareable)
+		return;
+
+	/* Check that the plans can be read back, and collect dependencies */
+	relids = list_copy(plansource->relationOids);
+	items = list_copy(plansource->invalItems);
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt *stmt = (PlannedStmt *) lfirst(lc);
+		ListCell   *lc2;
+
+		if (!IsA(stmt, PlannedStmt) ||
+			stmt->commandType == CMD_UTILITY ||
+			stmt->transientPlan ||
+			!plan_tree_is_shareable(stmt->planTree) ||
+			!plan_list_is_shareable(stmt->subplans))
+			return;
+
+		foreach(lc2, stmt->relationOids)
+			relids = list_append_unique_oid(relids, lfirst_oid(lc2));
+		items = list_concat(items, list_copy(stmt->invalItems));
+	}
+	if (list_length(relids) > SPC_MAX_RELIDS ||
+		list_length(items) > SPC_MAX_ITEMS)
+		return;
+
+	planstr = nodeToString(stmt_list);
+	plan_len = strlen(planstr) + 1;
+	len = tag->ident_len + plan_len;
+	nchunks = (int) ((len + SPC_CHUNK_DATA - 1) / SPC_CHUNK_DATA);
+
+	/* Don't let a single huge plan push out a good part of the cache */
+	if (nchunks > SharedPlanCache->nchunks / 4)
+	{
+		pfree(planstr);
+		return;
+	}
+
+	data = (char *) palloc(len);
+	memcpy(data, tag->ident, tag->ident_len);
+	memcpy(data + tag->ident_len, planstr, plan_len);
+	pfree(planstr);
+
+	LWLockAcquire(SharedPlanCacheLock, LW_EXCLUSIVE);
+
+	/*
+	 * If anything was invalidated since the lookup, the plan might have been
+	 * built from catalog contents that are already gone.  We'll get another
+	 * chance the next time the statement is planned.
+	 */
+	if (SharedPlanCache->inval_count != tag->inval_count)
+		goto done;
+
+	/*
+	 * Somebody else may have stored the statement in the meantime; keep
+	 * theirs.  (This also makes the first of two colliding statements win.)
+	 */
+	if (hash_search(SharedPlanHash, &tag->key, HASH_FIND, NULL) != NULL)
+		goto done;
+
+	/* Make room */
+	while (SharedPlanCache->nfree < nchunks ||
+		   hash_get_num_entries(SharedPlanHash) >= SharedPlanCache->max_entries)
+	{
+		if (!spc_evict_one())
+			goto done;
+	}
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &tag->key,
+											HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+		goto done;
+	Assert(!found);
+
+	entry->ident_len = tag->ident_len;
+	entry->plan_len = plan_len;
+	entry->last_used = pg_atomic_fetch_add_u32(&SharedPlanCache->clock, 1);
+
+	entry->nrelids = 0;
+	foreach(lc, relids)
+		entry->relids[entry->nrelids++] = lfirst_oid(lc);
+	entry->nitems = 0;
+	foreach(lc, items)
+	{
+		PlanInvalItem *item = (PlanInvalItem *) lfirst(lc);
+
+		entry->item_cacheids[entry->nitems] = item->cacheId;
+		entry->item_hashvalues[entry->nitems] = item->hashValue;
+		entry->nitems++;
+	}
+
+	/* Copy the text into chunks taken off the free list */
+	off = 0;
+	chunkp = &entry->first_chunk;
+	while (off < len)
+	{
+		int			chunk = SharedPlanCache->free_chunk;
+		Size		n = Min(len - off, SPC_CHUNK_DATA);
+
+		Assert(chunk >= 0);
+		SharedPlanCache->free_chunk = SharedPlanChunks[chunk].next;
+		SharedPlanCache->nfree--;
+
+		memcpy(SharedPlanChunks[chunk].data, data + off, n);
+		off += n;
+		*chunkp = chunk;
+		chunkp = &SharedPlanChunks[chunk].next;
+	}
+	*chunkp = -1;
+
+done:
+	LWLockRelease(SharedPlanCacheLock);
+
+	pfree(data);
+	list_free(relids);
+	list_free(items);
+}
+
+/*
+ * Can the plan tree be written out and read back in another backend?
+ */
+static bool
+plan_tree_is_shareable(Plan *plan)
+{
+	ListCell   *lc;
+
+	if (plan == NULL)
+		return true;
+
+	switch (nodeTag(plan))
+	{
+		case T_CustomScan:
+		case T_ForeignScan:
+			return false;
+		case T_ModifyTable:
+			{
+				ModifyTable *mtplan = (ModifyTable *) plan;
+
+				foreach(lc, mtplan->fdwPrivLists)
+				{
+					if (lfirst(lc) != NIL)
+						return false;
+				}
+				if (!plan_list_is_shareable(mtplan->plans))
+					return false;
+			}
+			break;
+		case T_Append:
+			if (!plan_list_is_shareable(((Append *) plan)->appendplans))
+				return false;
+			break;
+		case T_MergeAppend:
+			if (!plan_list_is_shareable(((MergeAppend *) plan)->mergeplans))
+				return false;
+			break;
+		case T_BitmapAnd:
+			if (!plan_list_is_shareable(((BitmapAnd *) plan)->bitmapplans))
+				return false;
+			break;
+		case T_BitmapOr:
+			if (!plan_list_is_shareable(((BitmapOr *) plan)->bitmapplans))
+				return false;
+			break;
+		case T_SubqueryScan:
+			if (!plan_tree_is_shareable(((SubqueryScan *) plan)->subplan))
+				return false;
+			break;
+		default:
+			break;
+	}
+
+	return plan_tree_is_shareable(plan->lefttree) &&
+		plan_tree_is_shareable(plan->righttree);
+}
+
+static bool
+plan_list_is_shareable(List *plans)
+{
+	ListCell   *lc;
+
+	foreach(lc, plans)
+	{
+		if (!plan_tree_is_shareable((Plan *) lfirst(lc)))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Remove an entry, returning its chunks to the free list.  Caller must hold
+ * SharedPlanCacheLock exclusively.
+ */
+static void
+spc_remove_entry(SharedPlanEntry *entry)
+{
+	int			chunk = entry->first_chunk;
+
+	while (chunk >= 0)
+	{
+		int			next = SharedPlanChunks[chunk].next;
+
+		SharedPlanChunks[chunk].next = SharedPlanCache->free_chunk;
+		SharedPlanCache->free_chunk = chunk;
+		SharedPlanCache->nfree++;
+		chunk = next;
+	}
+
+	hash_search(SharedPlanHash, &entry->key, HASH_REMOVE, NULL);
+}
+
+/*
+ * Evict the least recently used entry.  Returns false if the cache is
+ * empty.  Caller must hold SharedPlanCacheLock exclusively.
+ */
+static bool
+spc_evict_one(void)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanEntry *entry;
+	SharedPlanEntry *victim = NULL;
+	uint32		now = pg_atomic_read_u32(&SharedPlanCache->clock);
+	uint32		victim_age = 0;
+
+	hash_seq_init(&status, SharedPlanHash);
+	while ((entry = (SharedPlanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		uint32		age = now - entry->last_used;
+
+		if (victim == NULL || age > victim_age)
+		{
+			victim = entry;
+			victim_age = age;
+		}
+	}
+
+	if (victim == NULL)
+		return false;
+	spc_remove_entry(victim);
+	return true;
+}
+
+/*
+ * Could the message affect any shared plan?  These are the events
+ * plancache.c's sinval callbacks react to.
+ */
+static bool
+spc_message_is_relevant(const SharedInvalidationMessage *msg)
+{
+	if (msg->id >= 0)
+		return msg->cc.id == PROCOID ||
+			msg->cc.id == NAMESPACEOID ||
+			msg->cc.id == OPEROID ||
+			msg->cc.id == AMOPOPID;
+	else if (msg->id == SHAREDINVALCATALOG_ID)
+		return msg->cat.catId == ProcedureRelationId ||
+			msg->cat.catId == NamespaceRelationId ||
+			msg->cat.catId == OperatorRelationId ||
+			msg->cat.catId == AccessMethodOperatorRelationId;
+	else if (msg->id == SHAREDINVALRELCACHE_ID)
+		return true;
+	return false;
+}
+
+/*
+ * Does the (relevant) message invalidate the entry's plan?
+ */
+static bool
+spc_message_matches(const SharedInvalidationMessage *msg,
+					SharedPlanEntry *entry)
+{
+	int			i;
+
+	if (msg->id >= 0)
+	{
+		if (OidIsValid(msg->cc.dbId) && msg->cc.dbId != entry->key.dbid)
+			return false;
+		if (msg->cc.id != PROCOID)
+			return true;		/* plancache.c resets all plans for these */
+		for (i = 0; i < entry->nitems; i++)
+		{
+			if (entry->item_cacheids[i] == msg->cc.id &&
+				entry->item_hashvalues[i] == msg->cc.hashValue)
+				return true;
+		}
+	}
+	else if (msg->id == SHAREDINVALCATALOG_ID)
+	{
+		if (OidIsValid(msg->cat.dbId) && msg->cat.dbId != entry->key.dbid)
+			return false;
+		return true;
+	}
+	else if (msg->id == SHAREDINVALRELCACHE_ID)
+	{
+		if (OidIsValid(msg->rc.dbId) && msg->rc.dbId != entry->key.dbid)
+			return false;
+		if (!OidIsValid(msg->rc.relId))
+			return true;
+		for (i = 0; i < entry->nrelids; i++)
+		{
+			if (entry->relids[i] == msg->rc.relId)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * SharedPlanCacheInvalidate
+ *		Drop the shared plans affected by invalidation messages.
+ *
+ * Called by SendSharedInvalidMessages for every batch of messages a process
+ * is about to broadcast.
+ */
+void
+SharedPlanCacheInvalidate(const SharedInvalidationMessage *msgs, int n)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanEntry *entry;
+	int			i;
+
+	if (SharedPlanCache == NULL)
+		return;
+
+	for (i = 0; i < n; i++)
+	{
+		if (spc_message_is_relevant(&msgs[i]))
+			break;
+	}
+	if (i >= n)
+		return;
+
+	LWLockAcquire(SharedPlanCacheLock, LW_EXCLUSIVE);
+
+	SharedPlanCache->inval_count++;
+
+	hash_seq_init(&status, SharedPlanHash);
+	while ((entry = (SharedPlanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (spc_message_is_relevant(&msgs[i]) &&
+				spc_message_matches(&msgs[i], entry))
+			{
+				/* dynahash allows deleting the entry just returned */
+				spc_remove_entry(entry);
+				break;
+			}
+		}
+	}
+
+	LWLockRelease(SharedPlanCacheLock);
+}
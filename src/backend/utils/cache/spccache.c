@@ -198,3 +198,20 @@ get_tablespace_page_costs(Oid spcid,
 			*spc_seq_page_cost = spc->opts->seq_page_cost;
 	}
 }
+
+/*
+ * get_tablespace_autovac_cost_limit
+ *		Return the vacuum cost limit that autovacuum workers processing tables
+ *		in a given tablespace share, or -1 if the tablespace has none.
+ */
+int
+get_tablespace_autovac_cost_limit(Oid spcid)
+{
+	TableSpaceCacheEntry *spc = get_tablespace(spcid);
+
+	Assert(spc != NULL);
+
+	if (!spc->opts || spc->opts->autovacuum_vacuum_cost_limit <= 0)
+		return -1;
+	return spc->opts->autovacuum_vacuum_cost_limit;
+}
@@ -15,13 +15,164 @@
  *	  It is expected that every bit of a hash function's 32-bit result is
  *	  as random as every other; failure to ensure this is likely to lead
  *	  to poor performance of hash tables.  In most cases a hash
- *	  function should use hash_any() or its variant hash_uint32().
+ *	  function should use hash_bytes_fast() or murmurhash32().
+ *
+ *	  These hash values only ever live in memory.  Anything that stores
+ *	  hash values on disk must use hash_any() or hash_uint32() instead,
+ *	  whose results are fixed.
  *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
 
-#include "access/hash.h"
+#include "nodes/bitmapset.h"
+#include "utils/hashutils.h"
+
+
+/*
+ * hash_bytes_fast() -- hash a variable-length key into a 32-bit value
+ *
+ * This follows the design of wyhash: the key is consumed eight bytes at a
+ * time, and each pair of words is mixed by a 64x64->128 bit multiply whose
+ * halves are folded together.  Keys longer than 48 bytes are run through
+ * three independent lanes, so that the multiplies of one round don't wait
+ * on each other; that is where most of the speedup over hash_any() comes
+ * from for long keys.  Keys of up to 16 bytes take no loop at all.
+ *
+ * The result depends on the machine's byte order, which is fine as the
+ * value is never persisted or sent to another machine.
+ */
+#define HASH_FAST_P0	UINT64CONST(0xa0761d6478bd642f)
+#define HASH_FAST_P1	UINT64CONST(0xe7037ed1a0b428db)
+#define HASH_FAST_P2	UINT64CONST(0x8ebc6af09c88c6e3)
+#define HASH_FAST_P3	UINT64CONST(0x589965cc75374cc3)
+
+/* multiply *a and *b, returning the product's low half in *a, high in *b */
+static inline void
+hash_fast_mum(uint64 *a, uint64 *b)
+{
+#ifdef HAVE_INT128
+	uint128		r = (uint128) *a * *b;
+
+	*a = (uint64) r;
+	*b = (uint64) (r >> 64);
+#else
+	uint64		ha = *a >> 32,
+				hb = *b >> 32,
+				la = (uint32) *a,
+				lb = (uint32) *b;
+	uint64		rh = ha * hb,
+				rm0 = ha * lb,
+				rm1 = hb * la,
+				rl = la * lb,
+				t = rl + (rm0 << 32),
+				lo,
+				hi;
+
+	hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl);
+	lo = t + (rm1 << 32);
+	hi += (lo < t);
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+/* multiply a and b, and return the xor of the product's two halves */
+static inline uint64
+hash_fast_mix(uint64 a, uint64 b)
+{
+	hash_fast_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64
+hash_fast_read8(const unsigned char *p)
+{
+	uint64		v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64
+hash_fast_read4(const unsigned char *p)
+{
+	uint32		v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+uint32
+hash_bytes_fast(const unsigned char *k, Size keylen)
+{
+	const unsigned char *p = k;
+	uint64		seed = HASH_FAST_P0;
+	uint64		a,
+				b;
+
+	if (keylen <= 16)
+	{
+		if (keylen >= 4)
+		{
+			/* two possibly overlapping 4-byte reads from each end */
+			Size		off = (keylen >> 3) << 2;
+
+			a = (hash_fast_read4(p) << 32) | hash_fast_read4(p + off);
+			b = (hash_fast_read4(p + keylen - 4) << 32) |
+				hash_fast_read4(p + keylen - 4 - off);
+		}
+		else if (keylen > 0)
+		{
+			a = ((uint64) p[0] << 16) | ((uint64) p[keylen >> 1] << 8) |
+				p[keylen - 1];
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else
+	{
+		Size		i = keylen;
+
+		if (i > 48)
+		{
+			uint64		see1 = seed,
+						see2 = seed;
+
+			do
+			{
+				seed = hash_fast_mix(hash_fast_read8(p) ^ HASH_FAST_P1,
+									 hash_fast_read8(p + 8) ^ seed);
+				see1 = hash_fast_mix(hash_fast_read8(p + 16) ^ HASH_FAST_P2,
+									 hash_fast_read8(p + 24) ^ see1);
+				see2 = hash_fast_mix(hash_fast_read8(p + 32) ^ HASH_FAST_P3,
+									 hash_fast_read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16)
+		{
+			seed = hash_fast_mix(hash_fast_read8(p) ^ HASH_FAST_P1,
+								 hash_fast_read8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		/* last 16 bytes, possibly overlapping what we already consumed */
+		a = hash_fast_read8(p + i - 16);
+		b = hash_fast_read8(p + i - 8);
+	}
+
+	a ^= HASH_FAST_P1;
+	b ^= seed;
+	hash_fast_mum(&a, &b);
+	seed = hash_fast_mix(a ^ HASH_FAST_P0 ^ (uint64) keylen,
+						 b ^ HASH_FAST_P1);
+
+	return (uint32) (seed ^ (seed >> 32));
+}
 
 
 /*
@@ -40,8 +191,7 @@ string_hash(const void *key, Size keysize)
 	Size		s_len = strlen((const char *) key);
 
 	s_len = Min(s_len, keysize - 1);
-	return DatumGetUInt32(hash_any((const unsigned char *) key,
-								   (int) s_len));
+	return hash_bytes_fast((const unsigned char *) key, s_len);
 }
 
 /*
@@ -50,8 +200,7 @@ string_hash(const void *key, Size keysize)
 uint32
 tag_hash(const void *key, Size keysize)
 {
-	return DatumGetUInt32(hash_any((const unsigned char *) key,
-								   (int) keysize));
+	return hash_bytes_fast((const unsigned char *) key, keysize);
 }
 
 /*
@@ -63,7 +212,7 @@ uint32
 uint32_hash(const void *key, Size keysize)
 {
 	Assert(keysize == sizeof(uint32));
-	return DatumGetUInt32(hash_uint32(*((const uint32 *) key)));
+	return murmurhash32(*((const uint32 *) key));
 }
 
 /*
@@ -97,6 +97,7 @@ bool		IsPostmasterEnvironment = false;
 bool		IsUnderPostmaster = false;
 bool		IsBinaryUpgrade = false;
 bool		IsBackgroundWorker = false;
+bool		IsPreforkedBackend = false;
 
 bool		ExitOnAnyError = false;
 
@@ -118,6 +119,7 @@ int			maintenance_work_mem = 16384;
 int			NBuffers = 1000;
 int			MaxConnections = 90;
 int			max_worker_processes = 8;
+int			max_parallel_maintenance_workers = 2;
 int			MaxBackends = 0;
 
 int			VacuumCostPageHit = 1;		/* GUC parameters for vacuum */
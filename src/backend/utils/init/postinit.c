@@ -54,6 +54,7 @@
 #include "utils/guc.h"
 #include "utils/pg_locale.h"
 #include "utils/portal.h"
+#include "utils/profiler.h"
 #include "utils/ps_status.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
@@ -67,6 +68,7 @@ static void PerformAuthentication(Port *port);
 static void CheckMyDatabase(const char *name, bool am_superuser);
 static void InitCommunication(void);
 static void ShutdownPostgres(int code, Datum arg);
+static void RegisterBackendTimeouts(void);
 static void StatementTimeoutHandler(void);
 static void LockTimeoutHandler(void);
 static bool ThereIsAtLeastOneRole(void);
@@ -467,7 +469,9 @@ pg_split_opts(char **argv, int *argcp, const char *optstr)
 }
 
 /*
- * Initialize MaxBackends value from config options.
+ * Initialize MaxBackends value from config options.  The number of fast-path
+ * lock groups per backend is set here as well, since it also determines the
+ * size of the PGPROC array in shared memory.
  *
  * This must be called after modules have had the chance to register background
  * workers in shared_preload_libraries, and before shared memory size is
@@ -490,6 +494,17 @@ InitializeMaxBackends(void)
 	/* internal error because the values were all checked previously */
 	if (MaxBackends > MAX_BACKENDS)
 		elog(ERROR, "too many backends configured");
+
+	/*
+	 * Give each backend enough fast-path slots for max_locks_per_transaction
+	 * relation locks, in a power-of-two number of groups.  At least one
+	 * group is needed.
+	 */
+	Assert(FastPathLockGroupsPerBackend == 0);
+	FastPathLockGroupsPerBackend = 1;
+	while (FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX &&
+		   FastPathLockSlotsPerBackend() < max_locks_per_xact)
+		FastPathLockGroupsPerBackend *= 2;
 }
 
 /*
@@ -518,39 +533,20 @@ BaseInit(void)
 
 
 /* --------------------------------
- * InitPostgres
- *		Initialize POSTGRES.
- *
- * The database can be specified by name, using the in_dbname parameter, or by
- * OID, using the dboid parameter.  In the latter case, the actual database
- * name can be returned to the caller in out_dbname.  If out_dbname isn't
- * NULL, it must point to a buffer of size NAMEDATALEN.
- *
- * Similarly, the username can be passed by name, using the username parameter,
- * or by OID using the useroid parameter.
- *
- * In bootstrap mode no parameters are used.  The autovacuum launcher process
- * doesn't use any parameters either, because it only goes far enough to be
- * able to read pg_database; it doesn't connect to any particular database.
- * In walsender mode only username is used.
- *
- * As of PostgreSQL 8.2, we expect InitProcess() was already called, so we
- * already have a PGPROC struct ... but it's not completely filled in yet.
+ * InitPostgresEarly
+ *		The part of InitPostgres that doesn't depend on the database or user.
  *
- * Note:
- *		Be very careful with the order of calls in the InitPostgres function.
+ * This attaches us to the shared-memory machinery and loads the relcache
+ * entries for the shared catalogs.  InitPostgres calls it first, except in a
+ * pre-forked backend, which calls it while waiting for a connection (see
+ * postmaster.c); by the time it has finished we can run transactions, but
+ * only against shared catalogs.
  * --------------------------------
  */
 void
-InitPostgres(const char *in_dbname, Oid dboid, const char *username,
-			 Oid useroid, char *out_dbname)
+InitPostgresEarly(void)
 {
 	bool		bootstrap = IsBootstrapProcessingMode();
-	bool		am_superuser;
-	char	   *fullpath;
-	char		dbname[NAMEDATALEN];
-
-	elog(DEBUG3, "InitPostgres");
 
 	/*
 	 * Add my PGPROC struct to the ProcArray.
@@ -580,11 +576,7 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 	 * these in every case except bootstrap.
 	 */
 	if (!bootstrap)
-	{
-		RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
-		RegisterTimeout(STATEMENT_TIMEOUT, StatementTimeoutHandler);
-		RegisterTimeout(LOCK_TIMEOUT, LockTimeoutHandler);
-	}
+		RegisterBackendTimeouts();
 
 	/*
 	 * bufmgr needs another initialization call too
@@ -647,6 +639,54 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 	 * entirely possible, we need the AbortTransaction call to clean up.
 	 */
 	before_shmem_exit(ShutdownPostgres, 0);
+}
+
+
+/* --------------------------------
+ * InitPostgres
+ *		Initialize POSTGRES.
+ *
+ * The database can be specified by name, using the in_dbname parameter, or by
+ * OID, using the dboid parameter.  In the latter case, the actual database
+ * name can be returned to the caller in out_dbname.  If out_dbname isn't
+ * NULL, it must point to a buffer of size NAMEDATALEN.
+ *
+ * Similarly, the username can be passed by name, using the username parameter,
+ * or by OID using the useroid parameter.
+ *
+ * In bootstrap mode no parameters are used.  The autovacuum launcher process
+ * doesn't use any parameters either, because it only goes far enough to be
+ * able to read pg_database; it doesn't connect to any particular database.
+ * In walsender mode only username is used.
+ *
+ * As of PostgreSQL 8.2, we expect InitProcess() was already called, so we
+ * already have a PGPROC struct ... but it's not completely filled in yet.
+ *
+ * Note:
+ *		Be very careful with the order of calls in the InitPostgres function.
+ * --------------------------------
+ */
+void
+InitPostgres(const char *in_dbname, Oid dboid, const char *username,
+			 Oid useroid, char *out_dbname)
+{
+	bool		bootstrap = IsBootstrapProcessingMode();
+	bool		am_superuser;
+	char	   *fullpath;
+	char		dbname[NAMEDATALEN];
+
+	elog(DEBUG3, "InitPostgres");
+
+	if (!IsPreforkedBackend)
+		InitPostgresEarly();
+	else
+	{
+		/*
+		 * The early part was done before we had a client, but receiving the
+		 * startup packet reset the timeout module since then.
+		 */
+		RegisterBackendTimeouts();
+	}
 
 	/* The autovacuum launcher is done here */
 	if (IsAutoVacuumLauncherProcess())
@@ -1130,6 +1170,18 @@ ShutdownPostgres(int code, Datum arg)
 }
 
 
+/*
+ * Register the timeout handlers every backend needs.
+ */
+static void
+RegisterBackendTimeouts(void)
+{
+	RegisterTimeout(DEADLOCK_TIMEOUT, CheckDeadLockAlert);
+	RegisterTimeout(STATEMENT_TIMEOUT, StatementTimeoutHandler);
+	RegisterTimeout(LOCK_TIMEOUT, LockTimeoutHandler);
+	RegisterTimeout(PROFILE_SAMPLE_TIMEOUT, ProfileSampleHandler);
+}
+
 /*
  * STATEMENT_TIMEOUT handler: trigger a query-cancel interrupt.
  */
@@ -43,6 +43,18 @@ iso8859_1_to_utf8(PG_FUNCTION_ARGS)
 
 	while (len > 0)
 	{
+		/* copy runs of ASCII-subset characters a chunk at a time */
+		int			n = pg_valid_ascii_len(src, len);
+
+		if (n > 0)
+		{
+			memcpy(dest, src, n);
+			dest += n;
+			src += n;
+			len -= n;
+			continue;
+		}
+
 		c = *src;
 		if (c == 0)
 			report_invalid_encoding(PG_LATIN1, (const char *) src, len);
@@ -74,6 +86,18 @@ utf8_to_iso8859_1(PG_FUNCTION_ARGS)
 
 	while (len > 0)
 	{
+		/* copy runs of ASCII-subset characters a chunk at a time */
+		int			n = pg_valid_ascii_len(src, len);
+
+		if (n > 0)
+		{
+			memcpy(dest, src, n);
+			dest += n;
+			src += n;
+			len -= n;
+			continue;
+		}
+
 		c = *src;
 		if (c == 0)
 			report_invalid_encoding(PG_UTF8, (const char *) src, len);
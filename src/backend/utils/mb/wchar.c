@@ -12,6 +12,7 @@
 #endif
 
 #include "mb/pg_wchar.h"
+#include "port/simd.h"
 
 
 /*
@@ -1879,6 +1880,62 @@ pg_verify_mbstr(int encoding, const char *mbstr, int len, bool noError)
 	return pg_verify_mbstr_len(encoding, mbstr, len, noError) >= 0;
 }
 
+/*
+ * Size of the chunks examined by pg_valid_ascii_len: a vector register's
+ * worth where we have vector instructions, else a uint64.
+ */
+#ifndef USE_NO_SIMD
+#define ASCII_CHUNK_SIZE	((int) sizeof(Vector8))
+#else
+#define ASCII_CHUNK_SIZE	((int) sizeof(uint64))
+#endif
+
+/*
+ * Return the length of the longest prefix of s, in whole chunks of
+ * ASCII_CHUNK_SIZE bytes, that consists only of non-null ASCII characters.
+ *
+ * Such bytes are complete, valid characters in every supported encoding, so
+ * verification and conversion loops can skip or copy that many bytes
+ * without looking at them one at a time.  Returns 0 if len is less than a
+ * chunk or the first chunk contains anything else.
+ */
+int
+pg_valid_ascii_len(const unsigned char *s, int len)
+{
+	int			n = 0;
+
+	while (len - n >= ASCII_CHUNK_SIZE)
+	{
+#ifndef USE_NO_SIMD
+		Vector8		chunk = vector8_load((const char *) s + n);
+
+		/* reject the chunk if any byte has its high bit set or is zero */
+		if (vector8_is_highbit_set(chunk) ||
+			vector8_any(vector8_eq(chunk, vector8_broadcast(0))))
+			break;
+#else
+		uint64		chunk;
+
+		memcpy(&chunk, s + n, sizeof(chunk));
+
+		/* reject the chunk if any byte has its high bit set */
+		if (chunk & UINT64CONST(0x8080808080808080))
+			break;
+
+		/*
+		 * Adding 0x7F to a byte below 0x80 sets its high bit unless the byte
+		 * was zero, and can't carry into the next byte.
+		 */
+		if (((chunk + UINT64CONST(0x7f7f7f7f7f7f7f7f)) &
+			 UINT64CONST(0x8080808080808080)) != UINT64CONST(0x8080808080808080))
+			break;
+#endif
+		n += ASCII_CHUNK_SIZE;
+	}
+
+	return n;
+}
+
 /*
  * Verify mbstr to make sure that it is validly encoded in the specified
  * encoding.
@@ -1924,6 +1981,16 @@ pg_verify_mbstr_len(int encoding, const char *mbstr, int len, bool noError)
 		/* fast path for ASCII-subset characters */
 		if (!IS_HIGHBIT_SET(*mbstr))
 		{
+			/* skip over a run of them a chunk at a time, if we can */
+			l = pg_valid_ascii_len((const unsigned char *) mbstr, len);
+			if (l > 0)
+			{
+				mb_len += l;
+				mbstr += l;
+				len -= l;
+				continue;
+			}
+
 			if (*mbstr != '\0')
 			{
 				mb_len++;
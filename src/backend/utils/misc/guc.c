@@ -26,17 +26,26 @@
 #include <syslog.h>
 #endif
 
+#include "access/clog.h"
 #include "access/commit_ts.h"
 #include "access/gin.h"
+#include "access/multixact.h"
+#include "access/slru.h"
+#include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/twophase.h"
+#include "access/tuptoaster.h"
 #include "access/xact.h"
+#include "access/xlogparallel.h"
+#include "access/xlogprefetch.h"
 #include "catalog/namespace.h"
 #include "commands/async.h"
 #include "commands/prepare.h"
 #include "commands/vacuum.h"
 #include "commands/variable.h"
 #include "commands/trigger.h"
+#include "executor/execBatch.h"
+#include "executor/execFlatExpr.h"
 #include "funcapi.h"
 #include "libpq/auth.h"
 #include "libpq/be-fsstubs.h"
@@ -56,14 +65,19 @@
 #include "postmaster/bgworker.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/proxy.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
+#include "replication/logicallauncher.h"
+#include "replication/reorderbuffer.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
+#include "storage/buffile.h"
 #include "storage/dsm_impl.h"
+#include "storage/smgr.h"
 #include "storage/standby.h"
 #include "storage/fd.h"
 #include "storage/pg_shmem.h"
@@ -71,15 +85,21 @@
 #include "storage/predicate.h"
 #include "tcop/tcopprot.h"
 #include "tsearch/ts_cache.h"
+#include "tsearch/ts_shared.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
+#include "utils/catcache.h"
 #include "utils/guc_tables.h"
 #include "utils/memutils.h"
 #include "utils/pg_locale.h"
 #include "utils/plancache.h"
+#include "utils/profiler.h"
 #include "utils/portal.h"
+#include "utils/relcache.h"
 #include "utils/ps_status.h"
 #include "utils/rls.h"
+#include "utils/sharedcatcache.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/tzparser.h"
 #include "utils/xml.h"
@@ -153,8 +173,10 @@ static int	syslog_facility = 0;
 static void assign_syslog_facility(int newval, void *extra);
 static void assign_syslog_ident(const char *newval, void *extra);
 static void assign_session_replication_role(int newval, void *extra);
-static bool check_temp_buffers(int *newval, void **extra, GucSource source);
 static bool check_bonjour(bool *newval, void **extra, GucSource source);
+static bool check_direct_io(bool *newval, void **extra, GucSource source);
+static bool check_checkpoint_sync_method(int *newval, void **extra,
+							 GucSource source);
 static bool check_ssl(bool *newval, void **extra, GucSource source);
 static bool check_stage_log_stats(bool *newval, void **extra, GucSource source);
 static bool check_log_stats(bool *newval, void **extra, GucSource source);
@@ -170,6 +192,7 @@ static const char *show_tcp_keepalives_idle(void);
 static const char *show_tcp_keepalives_interval(void);
 static const char *show_tcp_keepalives_count(void);
 static bool check_maxconnections(int *newval, void **extra, GucSource source);
+static bool check_spare_backends(int *newval, void **extra, GucSource source);
 static bool check_max_worker_processes(int *newval, void **extra, GucSource source);
 static bool check_autovacuum_max_workers(int *newval, void **extra, GucSource source);
 static bool check_autovacuum_work_mem(int *newval, void **extra, GucSource source);
@@ -199,6 +222,14 @@ static const struct config_enum_entry bytea_output_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry default_toast_compression_options[] = {
+	{"pglz", TOAST_PGLZ_COMPRESSION, false},
+#ifdef USE_LZ4
+	{"lz4", TOAST_LZ4_COMPRESSION, false},
+#endif
+	{NULL, 0, false}
+};
+
 /*
  * We have different sets for client and server message level options because
  * they sort slightly different (see "log" level)
@@ -344,6 +375,12 @@ static const struct config_enum_entry constraint_exclusion_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry join_search_heuristic_options[] = {
+	{"genetic", JOIN_SEARCH_GENETIC, false},
+	{"greedy", JOIN_SEARCH_GREEDY, false},
+	{NULL, 0, false}
+};
+
 /*
  * Although only "on", "off", "remote_write", and "local" are documented, we
  * accept all the likely variants of "on" and "off".
@@ -379,12 +416,31 @@ static const struct config_enum_entry huge_pages_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry buffer_replacement_policy_options[] = {
+	{"clock", BUFFER_REPLACEMENT_CLOCK, false},
+	{"2q", BUFFER_REPLACEMENT_2Q, false},
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry io_method_options[] = {
+	{"sync", IO_METHOD_SYNC, false},
+	{"io_uring", IO_METHOD_IO_URING, false},
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry checkpoint_sync_method_options[] = {
+	{"fsync", CHECKPOINT_SYNC_FSYNC, false},
+	{"syncfs", CHECKPOINT_SYNC_SYNCFS, false},
+	{NULL, 0, false}
+};
+
 /*
  * Options for enum values stored in other modules
  */
 extern const struct config_enum_entry wal_level_options[];
 extern const struct config_enum_entry archive_mode_options[];
 extern const struct config_enum_entry sync_method_options[];
+extern const struct config_enum_entry wal_compression_options[];
 extern const struct config_enum_entry dynamic_shared_memory_options[];
 
 /*
@@ -819,6 +875,25 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_incremental_sort", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of incremental sort steps."),
+			NULL
+		},
+		&enable_incremental_sort,
+		true,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_eager_aggregate", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of partial aggregation below joins."),
+			gettext_noop("The aggregated relation is then grouped by its join "
+						 "keys before it is joined to the other relations.")
+		},
+		&enable_eager_aggregate,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_hashagg", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of hashed aggregation plans."),
@@ -837,6 +912,15 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_memoize", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of memoization."),
+			NULL
+		},
+		&enable_memoize,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_nestloop", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of nested-loop join plans."),
@@ -864,6 +948,27 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_partitionwise_join", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables joining inheritance trees child by child."),
+			gettext_noop("Children whose CHECK constraints show they have "
+						 "no matching join keys are not joined at all.")
+		},
+		&enable_partitionwise_join,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_batch_execution", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Enables batch-at-a-time execution of simple scan and aggregate pipelines."),
+			gettext_noop("Plain aggregates over a sequential scan with simple "
+						 "comparison quals are then evaluated with vectorized "
+						 "kernels.")
+		},
+		&enable_batch_execution,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"geqo", PGC_USERSET, QUERY_TUNING_GEQO,
 			gettext_noop("Enables genetic query optimization."),
@@ -921,6 +1026,15 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"ssl_ktls", PGC_SIGHUP, CONN_AUTH_SECURITY,
+			gettext_noop("Has the kernel encrypt data sent over SSL connections, where possible."),
+			NULL
+		},
+		&SSLKernelTLS,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"fsync", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Forces synchronization of updates to disk."),
@@ -948,6 +1062,18 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_flat_expressions", PGC_USERSET, DEVELOPER_OPTIONS,
+			gettext_noop("Enables flattened evaluation of per-row expressions."),
+			gettext_noop("Quals and targetlist expressions of plan nodes are "
+						 "then evaluated by a linear step interpreter rather "
+						 "than by recursing through the expression tree."),
+			GUC_NOT_IN_SAMPLE
+		},
+		&enable_flat_expressions,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"zero_damaged_pages", PGC_SUSET, DEVELOPER_OPTIONS,
 			gettext_noop("Continues processing past damaged page headers."),
@@ -986,16 +1112,6 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
-	{
-		{"wal_compression", PGC_SUSET, WAL_SETTINGS,
-			gettext_noop("Compresses full-page writes written in WAL file."),
-			NULL
-		},
-		&wal_compression,
-		false,
-		NULL, NULL, NULL
-	},
-
 	{
 		{"log_checkpoints", PGC_SIGHUP, LOGGING_WHAT,
 			gettext_noop("Logs each checkpoint."),
@@ -1619,6 +1735,37 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"temp_file_compression", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Compresses temporary files used for sorts, hashes and tuplestores."),
+			NULL
+		},
+		&temp_file_compression,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"direct_io", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Bypasses the kernel's page cache for relation data files."),
+			NULL
+		},
+		&direct_io,
+		false,
+		check_direct_io, NULL, NULL
+	},
+
+	{
+		{"shared_ts_dictionaries", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Shares compiled text search dictionaries between sessions."),
+			gettext_noop("Ispell dictionaries are compiled once and kept in dynamic "
+						 "shared memory, instead of once per session.")
+		},
+		&shared_ts_dictionaries,
+		true,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, false, NULL, NULL, NULL
@@ -1692,6 +1839,16 @@ static struct config_int ConfigureNamesInt[] =
 		12, 2, INT_MAX,
 		NULL, NULL, NULL
 	},
+	{
+		{"hypergraph_join_threshold", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the threshold of FROM items beyond which the hypergraph join search is used."),
+			gettext_noop("Planning problems with fewer FROM items use the "
+						 "level-by-level join search.")
+		},
+		&hypergraph_join_threshold,
+		9, 2, INT_MAX,
+		NULL, NULL, NULL
+	},
 	{
 		{"geqo_effort", PGC_USERSET, QUERY_TUNING_GEQO,
 			gettext_noop("GEQO: effort is used to set the default for other GEQO parameters."),
@@ -1811,6 +1968,27 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"active_shared_buffers", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers in use."),
+			gettext_noop("-1 means all of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&active_shared_buffers,
+		-1, -1, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"buffer_partitions", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of partitions of the shared buffers for buffer replacement."),
+			gettext_noop("0 means one partition per NUMA node.")
+		},
+		&buffer_partitions,
+		0, 0, 64,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"temp_buffers", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the maximum number of temporary buffers used by each session."),
@@ -1819,7 +1997,116 @@ static struct config_int ConfigureNamesInt[] =
 		},
 		&num_temp_buffers,
 		1024, 100, INT_MAX / 2,
-		check_temp_buffers, NULL, NULL
+		NULL, NULL, NULL
+	},
+
+	{
+		{"smgr_shared_relations", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of relations whose size is kept in shared memory."),
+			gettext_noop("0 disables the shared relation size table.")
+		},
+		&smgr_shared_relations,
+		1000, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_plan_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of shared memory used to share generic plans of prepared statements between sessions."),
+			gettext_noop("0 disables the shared plan cache."),
+			GUC_UNIT_KB
+		},
+		&shared_plan_cache_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_catalog_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of shared memory used to share system catalog tuples between sessions."),
+			gettext_noop("0 disables the shared catalog cache."),
+			GUC_UNIT_KB
+		},
+		&shared_catalog_cache_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"clog_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared buffers used to cache transaction status pages."),
+			gettext_noop("0 means a value chosen based on shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&clog_buffers,
+		0, 0, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"commit_ts_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared buffers used to cache commit timestamp pages."),
+			gettext_noop("0 means a value chosen based on shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&commit_ts_buffers,
+		0, 0, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"subtrans_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared buffers used to cache subtransaction parent pages."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&subtrans_buffers,
+		32, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"multixact_offsets_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared buffers used to cache MultiXact offset pages."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_offsets_buffers,
+		8, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"multixact_members_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared buffers used to cache MultiXact member pages."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_members_buffers,
+		16, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared buffers used to cache notification queue pages."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&notify_buffers,
+		16, 4, SLRU_MAX_BUFFERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_cached_subxids", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of subtransaction XIDs each backend advertises in shared memory."),
+			gettext_noop("Transactions with more subtransactions than this make "
+						 "other sessions look up pg_subtrans to check row visibility.")
+		},
+		&max_cached_subxids,
+		PGPROC_MAX_CACHED_SUBXIDS, PGPROC_MAX_CACHED_SUBXIDS, MAX_CACHED_SUBXIDS_LIMIT,
+		NULL, NULL, NULL
 	},
 
 	{
@@ -1832,6 +2119,46 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"proxy_port", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the port the connection proxy listens on."),
+			gettext_noop("Zero disables the connection proxy.")
+		},
+		&ProxyPortNumber,
+		0, 0, 65535,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"session_pool_size", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the number of backends the connection proxy keeps for each database and user."),
+			NULL
+		},
+		&SessionPoolSize,
+		10, 1, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"proxy_max_clients", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the maximum number of clients connected to the connection proxy."),
+			NULL
+		},
+		&ProxyMaxClients,
+		1000, 1, 65535,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"spare_backends", PGC_SIGHUP, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the number of pre-forked backends kept ready for new connections."),
+			NULL
+		},
+		&SpareBackends,
+		0, 0, MAX_BACKENDS,
+		check_spare_backends, NULL, NULL
+	},
+
 	{
 		{"unix_socket_permissions", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
 			gettext_noop("Sets the access permissions of the Unix-domain socket."),
@@ -1885,6 +2212,50 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"catalog_cache_memory_limit", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used by the catalog caches."),
+			gettext_noop("Least recently used entries are evicted when the limit is exceeded. "
+						 "0 means no limit."),
+			GUC_UNIT_KB
+		},
+		&catalog_cache_memory_limit,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"relation_cache_max_entries", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum number of entries in the relation cache."),
+			gettext_noop("Entries not used recently are evicted when the limit is exceeded. "
+						 "0 means no limit."),
+		},
+		&relation_cache_max_entries,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"detoast_cache_size", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for caching detoasted values within a transaction."),
+			gettext_noop("0 disables the cache."),
+			GUC_UNIT_KB
+		},
+		&detoast_cache_size,
+		4096, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"regex_cache_size", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum number of compiled regular expressions cached by each session."),
+			gettext_noop("The least recently used expression is discarded when the limit is reached.")
+		},
+		&regex_cache_size,
+		32, 1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We use the hopefully-safely-small value of 100kB as the compiled-in
 	 * default for max_stack_depth.  InitializeGUCOptions will increase it if
@@ -1984,6 +2355,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"autovacuum_parallel_workers", PGC_SIGHUP, AUTOVACUUM,
+			gettext_noop("Sets the number of parallel workers each autovacuum worker may use to vacuum indexes."),
+			gettext_noop("-1 chooses the number as VACUUM does, 0 disables parallel index vacuuming.")
+		},
+		&autovacuum_parallel_workers,
+		0, -1, 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_files_per_process", PGC_POSTMASTER, RESOURCES_KERNEL,
 			gettext_noop("Sets the maximum number of simultaneously open files for each server process."),
@@ -2129,6 +2510,30 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_pred_locks_per_relation", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Sets the maximum number of predicate-locked pages and tuples per relation."),
+			gettext_noop("If more than this total of pages and tuples in the same relation are locked "
+						 "by a connection, those locks are replaced by a relation-level lock.  "
+						 "Negative values mean max_pred_locks_per_transaction divided by "
+						 "the absolute value of this setting.")
+		},
+		&max_predicate_locks_per_relation,
+		-2, -INT_MAX, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_pred_locks_per_page", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Sets the maximum number of predicate-locked tuples per page."),
+			gettext_noop("If more than this number of tuples on the same page are locked "
+						 "by a connection, those locks are replaced by a page-level lock.")
+		},
+		&max_predicate_locks_per_page,
+		2, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"authentication_timeout", PGC_SIGHUP, CONN_AUTH_SECURITY,
 			gettext_noop("Sets the maximum allowed time to complete client authentication."),
@@ -2209,6 +2614,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"checkpoint_flush_after", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&checkpoint_flush_after,
+		DEFAULT_CHECKPOINT_FLUSH_AFTER, 0, WRITEBACK_MAX_PENDING_FLUSHES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_buffers", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the number of disk-page buffers in shared memory for WAL."),
@@ -2220,6 +2636,16 @@ static struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"wal_insert_locks", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of locks used for concurrent insertions into WAL."),
+			NULL
+		},
+		&wal_insert_locks,
+		8, 1, 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("WAL writer sleep time between WAL flushes."),
@@ -2231,6 +2657,38 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_writer_flush_after", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Amount of WAL written out by WAL writer that triggers a flush."),
+			NULL,
+			GUC_UNIT_XBLOCKS
+		},
+		&WalWriterFlushAfter,
+		128, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"wal_preallocate_segments", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Sets the number of WAL segments the WAL writer creates ahead of the current one."),
+			gettext_noop("Zero disables creating them ahead of time.")
+		},
+		&wal_preallocate_segments,
+		2, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"recovery_prefetch_distance", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Sets how far ahead of replay to prefetch blocks during recovery."),
+			gettext_noop("Zero disables prefetching."),
+			GUC_UNIT_KB
+		},
+		&recovery_prefetch_distance,
+		256, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		/* see max_connections */
 		{"max_wal_senders", PGC_POSTMASTER, REPLICATION_SENDING,
@@ -2344,6 +2802,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"bgwriter_flush_after", PGC_SIGHUP, RESOURCES_BGWRITER,
+			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&bgwriter_flush_after,
+		DEFAULT_BGWRITER_FLUSH_AFTER, 0, WRITEBACK_MAX_PENDING_FLUSHES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"effective_io_concurrency",
 			PGC_USERSET,
@@ -2360,6 +2829,28 @@ static struct config_int ConfigureNamesInt[] =
 		check_effective_io_concurrency, assign_effective_io_concurrency, NULL
 	},
 
+	{
+		{"io_combine_limit", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Limit on the number of consecutive pages read with one request."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&io_combine_limit,
+		DEFAULT_IO_COMBINE_LIMIT, 1, MAX_IO_COMBINE_LIMIT,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"backend_flush_after", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&backend_flush_after,
+		DEFAULT_BACKEND_FLUSH_AFTER, 0, WRITEBACK_MAX_PENDING_FLUSHES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_worker_processes",
 			PGC_POSTMASTER,
@@ -2372,6 +2863,18 @@ static struct config_int ConfigureNamesInt[] =
 		check_max_worker_processes, NULL, NULL
 	},
 
+	{
+		{"max_parallel_maintenance_workers",
+			PGC_USERSET,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum number of parallel workers used by a single utility command."),
+			gettext_noop("Currently only B-tree index builds use parallel workers.")
+		},
+		&max_parallel_maintenance_workers,
+		2, 0, 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"log_rotation_age", PGC_SIGHUP, LOGGING_WHERE,
 			gettext_noop("Automatic log file rotation will occur after N minutes."),
@@ -2472,6 +2975,36 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"recovery_parallel_workers", PGC_POSTMASTER, REPLICATION_STANDBY,
+			gettext_noop("Sets the number of background workers that replay WAL records in parallel on a standby."),
+			gettext_noop("Zero replays all records in the startup process.")
+		},
+		&recovery_parallel_workers,
+		0, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_logical_replication_workers", PGC_POSTMASTER, REPLICATION_STANDBY,
+			gettext_noop("Sets the maximum number of logical replication apply workers."),
+			gettext_noop("Parallel apply workers count against this limit too.")
+		},
+		&max_logical_replication_workers,
+		4, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_parallel_apply_workers_per_subscription", PGC_SIGHUP, REPLICATION_STANDBY,
+			gettext_noop("Sets the maximum number of parallel apply workers per subscription."),
+			gettext_noop("Zero applies every streamed transaction in the subscription's own worker.")
+		},
+		&max_parallel_apply_workers_per_subscription,
+		2, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_segment_size", PGC_INTERNAL, PRESET_OPTIONS,
 			gettext_noop("Shows the number of pages per write ahead log segment."),
@@ -2556,6 +3089,19 @@ static struct config_int ConfigureNamesInt[] =
 		check_autovacuum_work_mem, NULL, NULL
 	},
 
+	{
+		{"logical_decoding_work_mem", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for logical decoding."),
+			gettext_noop("This much memory can be used by the changes of the "
+						 "transactions being decoded before the largest are "
+						 "streamed to the output plugin or spilled to disk."),
+			GUC_UNIT_KB
+		},
+		&logical_decoding_work_mem,
+		65536, 64, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"tcp_keepalives_idle", PGC_USERSET, CLIENT_CONN_OTHER,
 			gettext_noop("Time between issuing TCP keepalives."),
@@ -2663,6 +3209,37 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_stats_objects", PGC_POSTMASTER, STATS_COLLECTOR,
+			gettext_noop("Sets the maximum number of tables and functions to track statistics for."),
+			NULL
+		},
+		&pgstat_max_objects,
+		10000, 100, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"profile_sample_interval", PGC_SUSET, STATS_COLLECTOR,
+			gettext_noop("Sets the interval between samples taken by the sampling profiler."),
+			gettext_noop("Zero turns off sampling."),
+			GUC_UNIT_MS
+		},
+		&profile_sample_interval,
+		0, 0, 60000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_profile_samples", PGC_POSTMASTER, STATS_COLLECTOR,
+			gettext_noop("Sets the number of samples the sampling profiler keeps."),
+			NULL
+		},
+		&max_profile_samples,
+		65536, 1024, INT_MAX / 64,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gin_pending_list_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the maximum size of the pending list for GIN index."),
@@ -3315,7 +3892,7 @@ static struct config_string ConfigureNamesString[] =
 
 	{
 		{"stats_temp_directory", PGC_SIGHUP, STATS_COLLECTOR,
-			gettext_noop("Writes temporary statistics files to the specified directory."),
+			gettext_noop("Obsolete; statistics are no longer written to temporary files."),
 			NULL,
 			GUC_SUPERUSER_ONLY
 		},
@@ -3326,13 +3903,13 @@ static struct config_string ConfigureNamesString[] =
 
 	{
 		{"synchronous_standby_names", PGC_SIGHUP, REPLICATION_MASTER,
-			gettext_noop("List of names of potential synchronous standbys."),
+			gettext_noop("Number of synchronous standbys and list of names of potential synchronous ones."),
 			NULL,
 			GUC_LIST_INPUT
 		},
 		&SyncRepStandbyNames,
 		"",
-		check_synchronous_standby_names, NULL, NULL
+		check_synchronous_standby_names, assign_synchronous_standby_names, NULL
 	},
 
 	{
@@ -3448,6 +4025,26 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"join_search_heuristic", PGC_USERSET, QUERY_TUNING_GEQO,
+			gettext_noop("Selects the join search used at or above geqo_threshold."),
+			NULL
+		},
+		&join_search_heuristic,
+		JOIN_SEARCH_GENETIC, join_search_heuristic_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"default_toast_compression", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the default compression method for compressible values."),
+			NULL
+		},
+		&default_toast_compression,
+		TOAST_PGLZ_COMPRESSION, default_toast_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"default_transaction_isolation", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the transaction isolation level of each new transaction."),
@@ -3612,6 +4209,16 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, assign_xlog_sync_method, NULL
 	},
 
+	{
+		{"wal_compression", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Compresses full-page writes written in WAL file with the specified method."),
+			NULL
+		},
+		&wal_compression,
+		WAL_COMPRESSION_NONE, wal_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"xmlbinary", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets how binary values are to be encoded in XML."),
@@ -3643,6 +4250,36 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"buffer_replacement_policy", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Selects the algorithm for choosing shared buffers to replace."),
+			NULL
+		},
+		&buffer_replacement_policy,
+		BUFFER_REPLACEMENT_CLOCK, buffer_replacement_policy_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"io_method", PGC_SIGHUP, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method for asynchronous reads of data files."),
+			NULL
+		},
+		&io_method,
+		IO_METHOD_SYNC, io_method_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"checkpoint_sync_method", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Selects the method checkpoints use to sync data files to disk."),
+			NULL
+		},
+		&checkpoint_sync_method,
+		CHECKPOINT_SYNC_FSYNC, checkpoint_sync_method_options,
+		check_checkpoint_sync_method, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, 0, NULL, NULL, NULL, NULL
@@ -5683,6 +6320,10 @@ set_config_option(const char *name, const char *value,
 		return 0;
 	}
 
+	/* a session-level setting ties a pooled session to its backend */
+	if (changeVal && source == PGC_S_SESSION && action == GUC_ACTION_SET)
+		PinPooledSession("SET");
+
 	/*
 	 * Check if the option can be set at this time. See guc.h for the precise
 	 * rules.
@@ -9725,26 +10366,42 @@ assign_session_replication_role(int newval, void *extra)
 }
 
 static bool
-check_temp_buffers(int *newval, void **extra, GucSource source)
+check_bonjour(bool *newval, void **extra, GucSource source)
 {
-	/*
-	 * Once local buffers have been initialized, it's too late to change this.
-	 */
-	if (NLocBuffer && NLocBuffer != *newval)
+#ifndef USE_BONJOUR
+	if (*newval)
+	{
+		GUC_check_errmsg("Bonjour is not supported by this build");
+		return false;
+	}
+#endif
+	return true;
+}
+
+static bool
+check_direct_io(bool *newval, void **extra, GucSource source)
+{
+	if (*newval && PG_O_DIRECT == 0)
+	{
+		GUC_check_errmsg("direct I/O is not supported on this platform");
+		return false;
+	}
+	if (*newval && BLCKSZ % PG_IO_ALIGN_SIZE != 0)
 	{
-		GUC_check_errdetail("\"temp_buffers\" cannot be changed after any temporary tables have been accessed in the session.");
+		GUC_check_errmsg("direct I/O requires a block size that is a multiple of %d bytes",
+						 PG_IO_ALIGN_SIZE);
 		return false;
 	}
 	return true;
 }
 
 static bool
-check_bonjour(bool *newval, void **extra, GucSource source)
+check_checkpoint_sync_method(int *newval, void **extra, GucSource source)
 {
-#ifndef USE_BONJOUR
-	if (*newval)
+#ifndef __linux__
+	if (*newval == CHECKPOINT_SYNC_SYNCFS)
 	{
-		GUC_check_errmsg("Bonjour is not supported by this build");
+		GUC_check_errmsg("syncfs is not supported on this platform");
 		return false;
 	}
 #endif
@@ -9938,6 +10595,19 @@ check_maxconnections(int *newval, void **extra, GucSource source)
 	return true;
 }
 
+static bool
+check_spare_backends(int *newval, void **extra, GucSource source)
+{
+#ifndef HAVE_SPARE_BACKENDS
+	if (*newval != 0)
+	{
+		GUC_check_errmsg("spare backends are not supported on this platform");
+		return false;
+	}
+#endif
+	return true;
+}
+
 static bool
 check_autovacuum_max_workers(int *newval, void **extra, GucSource source)
 {
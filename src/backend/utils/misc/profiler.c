@@ -0,0 +1,283 @@
+/*-------------------------------------------------------------------------
+ *
+ * profiler.c
+ *	  Built-in sampling profiler for backends.
+ *
+ * While profile_sample_interval is set, each backend arms a timeout for the
+ * duration of every statement.  When it fires, the signal handler records
+ * the plan node the executor is working on, the query id and the wait event
+ * into a ring buffer in shared memory, and re-arms the timeout.  Because the
+ * timer runs on wall-clock time, a backend that is waiting produces samples
+ * as well as one that is burning CPU.  The pg_stat_profile view aggregates
+ * whatever is in the ring at the time it is read.
+ *
+ * Writers never block: each sample claims a slot with an atomic increment
+ * and marks it with a sequence number once filled, so that readers can
+ * recognize and skip slots that are being overwritten as they copy them.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/misc/profiler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/profiler.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
+
+
+typedef struct ProfileSlot
+{
+	pg_atomic_uint32 seq;		/* 0 while empty or being written */
+	ProfileSample sample;
+} ProfileSlot;
+
+typedef struct ProfileSharedState
+{
+	pg_atomic_uint32 next;		/* number of samples taken so far */
+	ProfileSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} ProfileSharedState;
+
+/* GUC parameters */
+int			profile_sample_interval = 0;
+int			max_profile_samples = 65536;
+
+volatile NodeTag ProfileActivePlanNode = T_Invalid;
+volatile uint32 ProfileActiveQueryId = 0;
+
+static ProfileSharedState *ProfileShared = NULL;
+
+/* is the sampling timeout (possibly) armed? */
+static bool profile_timer_armed = false;
+
+
+/*
+ * Report shared-memory space needed by ProfilerShmemInit
+ */
+Size
+ProfilerShmemSize(void)
+{
+	return add_size(offsetof(ProfileSharedState, slots),
+					mul_size(max_profile_samples, sizeof(ProfileSlot)));
+}
+
+/*
+ * Allocate and initialize the sample ring buffer
+ */
+void
+ProfilerShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	ProfileShared = (ProfileSharedState *)
+		ShmemInitStruct("Profile Samples", ProfilerShmemSize(), &found);
+
+	if (!found)
+	{
+		pg_atomic_init_u32(&ProfileShared->next, 0);
+		for (i = 0; i < max_profile_samples; i++)
+			pg_atomic_init_u32(&ProfileShared->slots[i].seq, 0);
+	}
+}
+
+/*
+ * PROFILE_SAMPLE_TIMEOUT handler: record a sample and schedule the next one.
+ *
+ * This runs inside the SIGALRM handler, so it must only look at plain
+ * variables and must not allocate or take locks.
+ */
+void
+ProfileSampleHandler(void)
+{
+	ProfileSlot *slot;
+	uint32		pos;
+	uint32		seq;
+
+	if (ProfileShared == NULL || profile_sample_interval <= 0)
+		return;
+
+	pos = pg_atomic_fetch_add_u32(&ProfileShared->next, 1);
+	slot = &ProfileShared->slots[pos % max_profile_samples];
+
+	pg_atomic_write_u32(&slot->seq, 0);
+	pg_write_barrier();
+
+	slot->sample.sample_time = GetCurrentTimestamp();
+	slot->sample.pid = MyProcPid;
+	slot->sample.databaseid = MyDatabaseId;
+	slot->sample.queryid = ProfileActiveQueryId;
+	slot->sample.plan_node = ProfileActivePlanNode;
+	slot->sample.wait_event_info = MyProc ? MyProc->wait_event_info : 0;
+
+	pg_write_barrier();
+	seq = pos + 1;
+	if (seq == 0)
+		seq = 1;
+	pg_atomic_write_u32(&slot->seq, seq);
+
+	enable_timeout_after(PROFILE_SAMPLE_TIMEOUT, profile_sample_interval);
+}
+
+/*
+ * Start sampling at the beginning of a statement, if enabled.
+ *
+ * This also forgets whatever a statement that failed left behind in the
+ * active plan node and query id.
+ */
+void
+profile_sampling_start(void)
+{
+	ProfileActivePlanNode = T_Invalid;
+	ProfileActiveQueryId = 0;
+
+	if (profile_sample_interval > 0 && ProfileShared != NULL)
+	{
+		enable_timeout_after(PROFILE_SAMPLE_TIMEOUT, profile_sample_interval);
+		profile_timer_armed = true;
+	}
+}
+
+/*
+ * Stop sampling at the end of a statement.
+ */
+void
+profile_sampling_stop(void)
+{
+	if (profile_timer_armed)
+	{
+		disable_timeout(PROFILE_SAMPLE_TIMEOUT, false);
+		profile_timer_armed = false;
+	}
+}
+
+/*
+ * Return a palloc'd copy of the samples currently in the ring buffer, and
+ * their number in *nsamples.  Slots that are overwritten while we copy them
+ * are skipped.
+ */
+ProfileSample *
+profile_fetch_samples(int *nsamples)
+{
+	ProfileSample *result;
+	int			n = 0;
+	int			i;
+
+	result = (ProfileSample *) palloc(max_profile_samples * sizeof(ProfileSample));
+
+	for (i = 0; i < max_profile_samples; i++)
+	{
+		ProfileSlot *slot = &ProfileShared->slots[i];
+		uint32		seq;
+
+		seq = pg_atomic_read_u32(&slot->seq);
+		if (seq == 0)
+			continue;
+		pg_read_barrier();
+
+		memcpy(&result[n], &slot->sample, sizeof(ProfileSample));
+
+		pg_read_barrier();
+		if (pg_atomic_read_u32(&slot->seq) != seq)
+			continue;
+		n++;
+	}
+
+	*nsamples = n;
+	return result;
+}
+
+/*
+ * Name of a plan node type, as EXPLAIN shows it.
+ */
+const char *
+profile_plan_node_name(NodeTag tag)
+{
+	switch (tag)
+	{
+		case T_Result:
+			return "Result";
+		case T_ModifyTable:
+			return "ModifyTable";
+		case T_Append:
+			return "Append";
+		case T_MergeAppend:
+			return "Merge Append";
+		case T_RecursiveUnion:
+			return "Recursive Union";
+		case T_BitmapAnd:
+			return "BitmapAnd";
+		case T_BitmapOr:
+			return "BitmapOr";
+		case T_NestLoop:
+			return "Nested Loop";
+		case T_MergeJoin:
+			return "Merge Join";
+		case T_HashJoin:
+			return "Hash Join";
+		case T_SeqScan:
+			return "Seq Scan";
+		case T_SampleScan:
+			return "Sample Scan";
+		case T_IndexScan:
+			return "Index Scan";
+		case T_IndexOnlyScan:
+			return "Index Only Scan";
+		case T_BitmapIndexScan:
+			return "Bitmap Index Scan";
+		case T_BitmapHeapScan:
+			return "Bitmap Heap Scan";
+		case T_TidScan:
+			return "Tid Scan";
+		case T_SubqueryScan:
+			return "Subquery Scan";
+		case T_FunctionScan:
+			return "Function Scan";
+		case T_ValuesScan:
+			return "Values Scan";
+		case T_CteScan:
+			return "CTE Scan";
+		case T_WorkTableScan:
+			return "WorkTable Scan";
+		case T_ForeignScan:
+			return "Foreign Scan";
+		case T_CustomScan:
+			return "Custom Scan";
+		case T_Material:
+			return "Materialize";
+		case T_Memoize:
+			return "Memoize";
+		case T_Sort:
+			return "Sort";
+		case T_IncrementalSort:
+			return "Incremental Sort";
+		case T_Group:
+			return "Group";
+		case T_Agg:
+			return "Aggregate";
+		case T_WindowAgg:
+			return "WindowAgg";
+		case T_Unique:
+			return "Unique";
+		case T_Hash:
+			return "Hash";
+		case T_SetOp:
+			return "SetOp";
+		case T_LockRows:
+			return "LockRows";
+		case T_Limit:
+			return "Limit";
+		default:
+			break;
+	}
+	return NULL;
+}
@@ -24,9 +24,21 @@
 
 #include "postgres.h"
 
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/dsm.h"
+#include "storage/latch.h"
+#include "storage/ipc.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "storage/procsignal.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/timestamp.h"
 
 
 /*****************************************************************************
@@ -54,8 +66,32 @@ MemoryContext CurTransactionContext = NULL;
 /* This is a transient link to the active portal's memory context: */
 MemoryContext PortalContext = NULL;
 
+/*
+ * One slot per backend, through which another backend asks it for its
+ * memory context statistics; see RequestMemoryContextDump.
+ */
+typedef struct McxtDumpSlot
+{
+	slock_t		mutex;			/* protects the fields below */
+	PGPROC	   *requester;		/* backend waiting for the dump, or NULL */
+	dsm_handle	handle;			/* segment to write the dump into */
+	bool		done;			/* has the dump been written? */
+} McxtDumpSlot;
+
+static McxtDumpSlot *McxtDumpSlots = NULL;
+
+/* How long to wait for the other backend to respond, in milliseconds */
+#define MCXT_DUMP_TIMEOUT		5000
+
+/* Set by the SIGUSR1 handler when a dump has been requested of us */
+volatile bool MemoryContextDumpPending = false;
+
 static void MemoryContextCallResetCallbacks(MemoryContext context);
-static void MemoryContextStatsInternal(MemoryContext context, int level);
+static void MemoryContextStatsInternal(MemoryContext context, int level,
+						   MemoryContextCounters *totals);
+static void MemoryContextDumpInternal(MemoryContext context, int parent,
+						  int level, MemoryContextDump *dump);
+static void McxtDumpRelease(int code, Datum arg);
 
 /*
  * You should not do memory allocations within a critical section, because
@@ -476,6 +512,65 @@ MemoryContextIsEmpty(MemoryContext context)
 	return (*context->methods->is_empty) (context);
 }
 
+/*
+ * MemoryContextMemAllocated
+ *		Return the amount of memory allocated for the context, including
+ *		that of its descendants if "recurse" is true.
+ *
+ * This counts whole blocks obtained from malloc, whether or not the space in
+ * them is in use, so it's the figure to compare against a memory budget.
+ */
+Size
+MemoryContextMemAllocated(MemoryContext context, bool recurse)
+{
+	Size		total;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	total = (*context->methods->mem_allocated) (context);
+
+	if (recurse)
+	{
+		MemoryContext child;
+
+		for (child = context->firstchild; child != NULL;
+			 child = child->nextchild)
+			total += MemoryContextMemAllocated(child, true);
+	}
+
+	return total;
+}
+
+/*
+ * MemoryContextMemPeak
+ *		Return the largest amount of memory that was allocated for the context
+ *		at any one time, since it was created.
+ *
+ * With "recurse", the peaks of all current descendants are added in.  They
+ * need not have been reached at the same moment, so this is an upper bound;
+ * children already deleted are not counted at all.
+ */
+Size
+MemoryContextMemPeak(MemoryContext context, bool recurse)
+{
+	Size		total;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	total = context->peak_allocated;
+
+	if (recurse)
+	{
+		MemoryContext child;
+
+		for (child = context->firstchild; child != NULL;
+			 child = child->nextchild)
+			total += MemoryContextMemPeak(child, true);
+	}
+
+	return total;
+}
+
 /*
  * MemoryContextStats
  *		Print statistics about the named context and all its descendants.
@@ -486,19 +581,316 @@ MemoryContextIsEmpty(MemoryContext context)
 void
 MemoryContextStats(MemoryContext context)
 {
-	MemoryContextStatsInternal(context, 0);
+	MemoryContextCounters grand_totals;
+
+	memset(&grand_totals, 0, sizeof(grand_totals));
+
+	MemoryContextStatsInternal(context, 0, &grand_totals);
+
+	fprintf(stderr,
+			"Grand total: %zu bytes in %zd blocks; %zu free (%zd chunks); %zu used\n",
+			grand_totals.totalspace, grand_totals.nblocks,
+			grand_totals.freespace, grand_totals.freechunks,
+			grand_totals.totalspace - grand_totals.freespace);
 }
 
 static void
-MemoryContextStatsInternal(MemoryContext context, int level)
+MemoryContextStatsInternal(MemoryContext context, int level,
+						   MemoryContextCounters *totals)
 {
 	MemoryContext child;
 
 	AssertArg(MemoryContextIsValid(context));
 
-	(*context->methods->stats) (context, level);
+	(*context->methods->stats) (context, level, true, totals);
+	for (child = context->firstchild; child != NULL; child = child->nextchild)
+		MemoryContextStatsInternal(child, level + 1, totals);
+}
+
+/*
+ * Report shared-memory space needed by MemoryContextDumpShmemInit
+ */
+Size
+MemoryContextDumpShmemSize(void)
+{
+	return mul_size(MaxBackends, sizeof(McxtDumpSlot));
+}
+
+/*
+ * Allocate and initialize the per-backend memory context dump slots
+ */
+void
+MemoryContextDumpShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	McxtDumpSlots = (McxtDumpSlot *)
+		ShmemInitStruct("Memory Context Dump Slots",
+						MemoryContextDumpShmemSize(), &found);
+
+	if (!found)
+	{
+		for (i = 0; i < MaxBackends; i++)
+		{
+			SpinLockInit(&McxtDumpSlots[i].mutex);
+			McxtDumpSlots[i].requester = NULL;
+			McxtDumpSlots[i].done = false;
+		}
+	}
+}
+
+/*
+ * RequestMemoryContextDump
+ *		Get the memory context statistics of another backend.
+ *
+ * We create a DSM segment big enough for MCXT_DUMP_MAX_CONTEXTS contexts,
+ * put its handle in the backend's slot, and signal it.  The backend writes
+ * its statistics into the segment the next time it checks for interrupts,
+ * and sets our latch.  The segment, holding a MemoryContextDump, is
+ * returned; it is the caller's to detach.
+ *
+ * If the process is not a backend, or doesn't respond in time, we warn
+ * and return NULL.
+ */
+dsm_segment *
+RequestMemoryContextDump(int pid)
+{
+	PGPROC	   *proc = BackendPidGetProc(pid);
+	McxtDumpSlot *slot;
+	dsm_segment *seg;
+	MemoryContextDump *dump;
+	TimestampTz start;
+	bool		busy;
+	bool		done = false;
+
+	if (proc == NULL || proc->backendId == InvalidBackendId)
+	{
+		ereport(WARNING,
+				(errmsg("PID %d is not a PostgreSQL server process", pid)));
+		return NULL;
+	}
+
+	seg = dsm_create(offsetof(MemoryContextDump, entries) +
+					 MCXT_DUMP_MAX_CONTEXTS * sizeof(MemoryContextDumpEntry),
+					 0);
+	dump = (MemoryContextDump *) dsm_segment_address(seg);
+	dump->ncontexts = 0;
+	dump->nmissing = 0;
+
+	slot = &McxtDumpSlots[proc->backendId - 1];
+	SpinLockAcquire(&slot->mutex);
+	busy = (slot->requester != NULL);
+	if (!busy)
+	{
+		slot->requester = MyProc;
+		slot->handle = dsm_segment_handle(seg);
+		slot->done = false;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (busy)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_IN_USE),
+				 errmsg("memory contexts of PID %d are already being requested",
+						pid)));
+
+	PG_ENSURE_ERROR_CLEANUP(McxtDumpRelease, PointerGetDatum(slot));
+	{
+		if (SendProcSignal(pid, PROCSIG_MEMORY_CONTEXTS, proc->backendId) < 0)
+			ereport(WARNING,
+					(errmsg("could not send signal to process %d: %m", pid)));
+		else
+		{
+			start = GetCurrentTimestamp();
+			for (;;)
+			{
+				int			rc;
+
+				SpinLockAcquire(&slot->mutex);
+				done = slot->done;
+				SpinLockRelease(&slot->mutex);
+				if (done)
+					break;
+
+				/* give up if the process has exited, or takes too long */
+				if (BackendPidGetProc(pid) != proc ||
+					TimestampDifferenceExceeds(start, GetCurrentTimestamp(),
+											   MCXT_DUMP_TIMEOUT))
+				{
+					ereport(WARNING,
+							(errmsg("PID %d did not respond to the memory context request",
+									pid)));
+					break;
+				}
+
+				rc = WaitLatch(MyLatch,
+							   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+							   100L, WAIT_EVENT_MEMORY_CONTEXT_DUMP);
+				if (rc & WL_POSTMASTER_DEATH)
+					proc_exit(1);
+				ResetLatch(MyLatch);
+				CHECK_FOR_INTERRUPTS();
+			}
+		}
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(McxtDumpRelease, PointerGetDatum(slot));
+	McxtDumpRelease(0, PointerGetDatum(slot));
+
+	if (!done)
+	{
+		dsm_detach(seg);
+		return NULL;
+	}
+	return seg;
+}
+
+/*
+ * Give up our claim on another backend's dump slot.
+ */
+static void
+McxtDumpRelease(int code, Datum arg)
+{
+	McxtDumpSlot *slot = (McxtDumpSlot *) DatumGetPointer(arg);
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->requester == MyProc)
+	{
+		slot->requester = NULL;
+		slot->done = false;
+	}
+	SpinLockRelease(&slot->mutex);
+}
+
+/*
+ * HandleMemoryContextDumpInterrupt
+ *		Handle receipt of an interrupt asking for our memory context
+ *		statistics.
+ *
+ * All the actual work is deferred to ProcessMemoryContextDumpInterrupt,
+ * because we cannot safely walk the context tree inside a signal handler.
+ */
+void
+HandleMemoryContextDumpInterrupt(void)
+{
+	int			save_errno = errno;
+
+	InterruptPending = true;
+	MemoryContextDumpPending = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * ProcessMemoryContextDumpInterrupt
+ *		Write our memory context statistics for the backend that asked.
+ *
+ * Called from ProcessInterrupts(), which also runs while we're idle.
+ */
+void
+ProcessMemoryContextDumpInterrupt(void)
+{
+	McxtDumpSlot *slot;
+	PGPROC	   *requester;
+	dsm_handle	handle;
+	dsm_segment *seg = NULL;
+	ResourceOwner owner;
+	ResourceOwner oldowner = CurrentResourceOwner;
+
+	MemoryContextDumpPending = false;
+
+	if (MyBackendId == InvalidBackendId || McxtDumpSlots == NULL)
+		return;
+	slot = &McxtDumpSlots[MyBackendId - 1];
+
+	SpinLockAcquire(&slot->mutex);
+	requester = slot->done ? NULL : slot->requester;
+	handle = slot->handle;
+	SpinLockRelease(&slot->mutex);
+
+	if (requester == NULL)
+		return;
+
+	/*
+	 * The requester may have given up already, in which case the segment is
+	 * gone.  We may be between transactions, so attach it under a resource
+	 * owner of our own.
+	 */
+	owner = ResourceOwnerCreate(NULL, "memory context dump");
+	CurrentResourceOwner = owner;
+	PG_TRY();
+	{
+		seg = dsm_attach(handle);
+		if (seg != NULL)
+		{
+			MemoryContextDump *dump;
+
+			dump = (MemoryContextDump *) dsm_segment_address(seg);
+			MemoryContextDumpInternal(TopMemoryContext, -1, 0, dump);
+			dsm_detach(seg);
+		}
+	}
+	PG_CATCH();
+	{
+		CurrentResourceOwner = oldowner;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	CurrentResourceOwner = oldowner;
+	ResourceOwnerDelete(owner);
+
+	if (seg == NULL)
+		return;
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->requester == requester && slot->handle == handle)
+		slot->done = true;
+	else
+		requester = NULL;
+	SpinLockRelease(&slot->mutex);
+
+	if (requester != NULL)
+		SetLatch(&requester->procLatch);
+}
+
+/*
+ * MemoryContextDumpInternal
+ *		Add a context and its descendants to a MemoryContextDump.
+ */
+static void
+MemoryContextDumpInternal(MemoryContext context, int parent, int level,
+						  MemoryContextDump *dump)
+{
+	MemoryContext child;
+	int			self = -1;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	if (dump->ncontexts < MCXT_DUMP_MAX_CONTEXTS)
+	{
+		MemoryContextDumpEntry *entry;
+		const char *name = context->name ? context->name : "";
+		int			namelen = strlen(name);
+
+		self = dump->ncontexts++;
+		entry = &dump->entries[self];
+
+		if (namelen >= MCXT_DUMP_NAME_LEN)
+			namelen = pg_mbcliplen(name, namelen, MCXT_DUMP_NAME_LEN - 1);
+		memcpy(entry->name, name, namelen);
+		entry->name[namelen] = '\0';
+		entry->parent = parent;
+		entry->level = level;
+		memset(&entry->counters, 0, sizeof(entry->counters));
+		(*context->methods->stats) (context, level, false, &entry->counters);
+		entry->peak_allocated = context->peak_allocated;
+	}
+	else
+		dump->nmissing++;
+
 	for (child = context->firstchild; child != NULL; child = child->nextchild)
-		MemoryContextStatsInternal(child, level + 1);
+		MemoryContextDumpInternal(child, self, level + 1, dump);
 }
 
 /*
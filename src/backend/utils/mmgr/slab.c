@@ -0,0 +1,833 @@
+/*-------------------------------------------------------------------------
+ *
+ * slab.c
+ *	  SLAB allocator definitions.
+ *
+ * SLAB is a MemoryContext implementation designed for cases where large
+ * numbers of equally-sized objects are allocated (and freed).
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/mmgr/slab.c
+ *
+ * NOTE:
+ *	The constant allocation size allows significant simplification and
+ *	various optimizations over more general purpose allocators.  The blocks
+ *	are carved into chunks of exactly the right size (plus alignment), not
+ *	wasting any memory, and unlike in aset.c a block whose chunks have all
+ *	been freed is handed back to malloc().
+ *
+ *	The information about free chunks is maintained both at the block level
+ *	and global (context) level.  This is possible as the chunk size (and
+ *	thus also the number of chunks per block) is fixed.
+ *
+ *	On each block, free chunks are tracked in a simple linked list.  The
+ *	contents of free chunks is replaced with the index of the next free
+ *	chunk, forming a very simple linked list.  Each block also contains a
+ *	counter of free chunks.  Combined with the local block-level freelist,
+ *	it makes it trivial to eventually free the whole block.
+ *
+ *	At the context level, we use 'freelist' to track blocks ordered by
+ *	number of free chunks, starting with blocks having a single allocated
+ *	chunk, and with completely full blocks on the tail.
+ *
+ *	This also allows various optimizations - for example when searching for
+ *	a free chunk, the allocator reuses space from the fullest blocks first,
+ *	in the hope that some of the less full blocks will get completely empty
+ *	(and returned back to the OS).
+ *
+ *	To avoid calling malloc() and free() over and over when a context
+ *	alternates between allocating and freeing a single chunk, we keep one
+ *	completely empty block around; any other block is freed as soon as it
+ *	gets empty.
+ *
+ *	For each block, we maintain pointer to the first free chunk - this is
+ *	quite cheap and allows us to skip all the preceding used chunks,
+ *	eliminating a significant number of lookups in many common usage
+ *	patterns.  In the worst case this performs as if the pointer was not
+ *	maintained.
+ *
+ *	We cache the freelist index for the blocks with the fewest free chunks
+ *	(minFreeChunks), so that we don't have to search the freelist on every
+ *	SlabAlloc() call, which is quite expensive.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "lib/ilist.h"
+#include "utils/memdebug.h"
+#include "utils/memutils.h"
+
+
+/*
+ * SlabContext is a specialized implementation of MemoryContext.
+ */
+typedef struct SlabContext
+{
+	MemoryContextData header;	/* Standard memory-context fields */
+	/* Allocation parameters for this context: */
+	Size		chunkSize;		/* chunk size */
+	Size		fullChunkSize;	/* chunk size including header and alignment */
+	Size		blockSize;		/* block size */
+	int			chunksPerBlock; /* number of chunks per block */
+	int			minFreeChunks;	/* min number of free chunks in any block */
+	int			nblocks;		/* number of blocks allocated */
+#ifdef MEMORY_CONTEXT_CHECKING
+	bool	   *freechunks;		/* bitmap of free chunks in a block */
+#endif
+	/* blocks with free space, grouped by number of free chunks: */
+	dlist_head	freelist[FLEXIBLE_ARRAY_MEMBER];
+} SlabContext;
+
+typedef SlabContext *Slab;
+
+/*
+ * SlabBlock
+ *		Structure of a single block in SLAB allocator.
+ *
+ * node: doubly-linked list of blocks in global freelist
+ * nfree: number of free chunks in this block
+ * firstFreeChunk: index of the first free chunk
+ */
+typedef struct SlabBlockData
+{
+	dlist_node	node;			/* doubly-linked list */
+	int			nfree;			/* number of free chunks */
+	int			firstFreeChunk; /* index of the first free chunk in block */
+} SlabBlockData;
+
+typedef SlabBlockData *SlabBlock;
+
+/*
+ * SlabChunk
+ *		The prefix of each piece of memory in a SlabBlock
+ *
+ * The chunk header ends with a StandardChunkHeader, as mcxt.c expects, and
+ * starts with a pointer to the owning block, which lets SlabFree find it
+ * without searching.
+ */
+typedef struct SlabChunkData
+{
+	/* block owning this chunk */
+	SlabBlock	block;
+} SlabChunkData;
+
+typedef SlabChunkData *SlabChunk;
+
+#define SLAB_BLOCKHDRSZ		MAXALIGN(sizeof(SlabBlockData))
+#define SLAB_CHUNKHDRSZ		\
+	(MAXALIGN(sizeof(SlabChunkData)) + STANDARDCHUNKHEADERSIZE)
+
+#define SlabPointerGetChunk(ptr)	\
+	((SlabChunk)(((char *)(ptr)) - SLAB_CHUNKHDRSZ))
+#define SlabChunkGetPointer(chk)	\
+	((void *)(((char *)(chk)) + SLAB_CHUNKHDRSZ))
+#define SlabPointerGetHeader(ptr)	\
+	((StandardChunkHeader *)(((char *)(ptr)) - STANDARDCHUNKHEADERSIZE))
+#define SlabBlockGetChunk(slab, block, idx) \
+	((SlabChunk) ((char *) (block) + SLAB_BLOCKHDRSZ	\
+					+ (idx * (slab)->fullChunkSize)))
+#define SlabBlockStart(block)	\
+	((char *) block + SLAB_BLOCKHDRSZ)
+#define SlabChunkIndex(slab, block, chunk)	\
+	(((char *) chunk - SlabBlockStart(block)) / (slab)->fullChunkSize)
+
+/*
+ * SlabIsValid
+ *		True iff set is valid slab allocation set.
+ */
+#define SlabIsValid(set) PointerIsValid(set)
+
+/*
+ * Keep track of the space obtained from malloc for a context, and of its
+ * high water mark, for MemoryContextMemAllocated and MemoryContextMemPeak.
+ */
+#define SlabMemAdd(slab, size) \
+	do { \
+		(slab)->header.mem_allocated += (size); \
+		if ((slab)->header.mem_allocated > (slab)->header.peak_allocated) \
+			(slab)->header.peak_allocated = (slab)->header.mem_allocated; \
+	} while (0)
+#define SlabMemSub(slab, size) \
+	((slab)->header.mem_allocated -= (size))
+
+/*
+ * These functions implement the MemoryContext API for Slab contexts.
+ */
+static void *SlabAlloc(MemoryContext context, Size size);
+static void SlabFree(MemoryContext context, void *pointer);
+static void *SlabRealloc(MemoryContext context, void *pointer, Size size);
+static void SlabInit(MemoryContext context);
+static void SlabReset(MemoryContext context);
+static void SlabDelete(MemoryContext context);
+static Size SlabGetChunkSpace(MemoryContext context, void *pointer);
+static bool SlabIsEmpty(MemoryContext context);
+static Size SlabMemAllocated(MemoryContext context);
+static void SlabStats(MemoryContext context, int level, bool print,
+		  MemoryContextCounters *totals);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+static void SlabCheck(MemoryContext context);
+#endif
+
+/*
+ * This is the virtual function table for Slab contexts.
+ */
+static MemoryContextMethods SlabMethods = {
+	SlabAlloc,
+	SlabFree,
+	SlabRealloc,
+	SlabInit,
+	SlabReset,
+	SlabDelete,
+	SlabGetChunkSpace,
+	SlabIsEmpty,
+	SlabMemAllocated,
+	SlabStats
+#ifdef MEMORY_CONTEXT_CHECKING
+	,SlabCheck
+#endif
+};
+
+/* ----------
+ * Debug macros
+ * ----------
+ */
+#ifdef HAVE_ALLOCINFO
+#define SlabFreeInfo(_cxt, _chunk) \
+			fprintf(stderr, "SlabFree: %s: %p, %zu\n", \
+				(_cxt)->header.name, (_chunk), (_cxt)->chunkSize)
+#define SlabAllocInfo(_cxt, _chunk) \
+			fprintf(stderr, "SlabAlloc: %s: %p, %zu\n", \
+				(_cxt)->header.name, (_chunk), (_cxt)->chunkSize)
+#else
+#define SlabFreeInfo(_cxt, _chunk)
+#define SlabAllocInfo(_cxt, _chunk)
+#endif
+
+
+/*
+ * SlabContextCreate
+ *		Create a new Slab context.
+ *
+ * parent: parent context, or NULL if top-level context
+ * name: name of context (for debugging --- string will be copied)
+ * blockSize: allocation block size
+ * chunkSize: allocation chunk size
+ *
+ * The chunkSize may not exceed:
+ *		MAXALIGN_DOWN(SIZE_MAX) - SLAB_BLOCKHDRSZ - SLAB_CHUNKHDRSZ
+ */
+MemoryContext
+SlabContextCreate(MemoryContext parent,
+				  const char *name,
+				  Size blockSize,
+				  Size chunkSize)
+{
+	int			chunksPerBlock;
+	Size		fullChunkSize;
+	Size		freelistSize;
+	Size		headerSize;
+	Slab		slab;
+	int			i;
+
+	/* Make sure the linked list node fits inside a freed chunk */
+	if (chunkSize < sizeof(int))
+		chunkSize = sizeof(int);
+
+	/* chunk, including SLAB header (both addresses nicely aligned) */
+	fullChunkSize = SLAB_CHUNKHDRSZ + MAXALIGN(chunkSize);
+
+	/* Make sure the block can store at least one chunk. */
+	if (blockSize - SLAB_BLOCKHDRSZ < fullChunkSize)
+		elog(ERROR, "block size %zu for slab is too small for %zu chunks",
+			 blockSize, chunkSize);
+
+	/* Compute maximum number of chunks per block */
+	chunksPerBlock = (blockSize - SLAB_BLOCKHDRSZ) / fullChunkSize;
+
+	/* The freelist starts with 0, ends with chunksPerBlock. */
+	freelistSize = sizeof(dlist_head) * (chunksPerBlock + 1);
+
+	/* possibly allocate the freechunks bitmap right after the freelists */
+	headerSize = offsetof(SlabContext, freelist) + freelistSize;
+#ifdef MEMORY_CONTEXT_CHECKING
+	headerSize += chunksPerBlock * sizeof(bool);
+#endif
+
+	/* Do the type-independent part of context creation */
+	slab = (Slab) MemoryContextCreate(T_SlabContext, headerSize,
+									  &SlabMethods, parent, name);
+
+	slab->blockSize = blockSize;
+	slab->chunkSize = chunkSize;
+	slab->fullChunkSize = fullChunkSize;
+	slab->chunksPerBlock = chunksPerBlock;
+	slab->nblocks = 0;
+	slab->minFreeChunks = 0;
+
+	for (i = 0; i < (slab->chunksPerBlock + 1); i++)
+		dlist_init(&slab->freelist[i]);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	slab->freechunks = (bool *) ((char *) slab +
+								 offsetof(SlabContext, freelist) +
+								 freelistSize);
+#endif
+
+	return (MemoryContext) slab;
+}
+
+/*
+ * SlabInit
+ *		Context-type-specific initialization routine.
+ */
+static void
+SlabInit(MemoryContext context)
+{
+	/*
+	 * Since MemoryContextCreate already zeroed the context node, we don't
+	 * have to do anything here: the freelists are set up by our caller.
+	 */
+}
+
+/*
+ * SlabReset
+ *		Frees all memory which is allocated in the given set.
+ *
+ * The code simply frees all the blocks in the context - we don't keep any
+ * keeper blocks or anything like that.
+ */
+static void
+SlabReset(MemoryContext context)
+{
+	int			i;
+	Slab		slab = (Slab) context;
+
+	AssertArg(SlabIsValid(slab));
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Check for corruption and leaks before freeing */
+	SlabCheck(context);
+#endif
+
+	/* walk over freelists and free the blocks */
+	for (i = 0; i <= slab->chunksPerBlock; i++)
+	{
+		dlist_mutable_iter miter;
+
+		dlist_foreach_modify(miter, &slab->freelist[i])
+		{
+			SlabBlock	block = dlist_container(SlabBlockData, node, miter.cur);
+
+			dlist_delete(miter.cur);
+
+#ifdef CLOBBER_FREED_MEMORY
+			wipe_mem(block, slab->blockSize);
+#endif
+			free(block);
+			slab->nblocks--;
+			SlabMemSub(slab, slab->blockSize);
+		}
+	}
+
+	slab->minFreeChunks = 0;
+
+	Assert(slab->nblocks == 0);
+	Assert(slab->header.mem_allocated == 0);
+}
+
+/*
+ * SlabDelete
+ *		Frees all memory which is allocated in the given slab, in preparation
+ *		for deletion of the slab.  We simply call SlabReset().
+ */
+static void
+SlabDelete(MemoryContext context)
+{
+	SlabReset(context);
+}
+
+/*
+ * SlabFindMinFreeChunks
+ *		Point minFreeChunks to the first non-empty freelist from idx on, or
+ *		set it to zero if all the blocks are full.
+ */
+static inline void
+SlabFindMinFreeChunks(Slab slab, int idx)
+{
+	for (; idx <= slab->chunksPerBlock; idx++)
+	{
+		if (!dlist_is_empty(&slab->freelist[idx]))
+		{
+			slab->minFreeChunks = idx;
+			return;
+		}
+	}
+	slab->minFreeChunks = 0;
+}
+
+/*
+ * SlabAlloc
+ *		Returns pointer to allocated memory of given size or NULL if
+ *		request could not be completed; memory is added to the slab.
+ */
+static void *
+SlabAlloc(MemoryContext context, Size size)
+{
+	Slab		slab = (Slab) context;
+	SlabBlock	block;
+	SlabChunk	chunk;
+	StandardChunkHeader *header;
+	int			idx;
+	int			oldMinFreeChunks;
+
+	AssertArg(SlabIsValid(slab));
+
+	/* make sure we only allow correct request size */
+	if (size != slab->chunkSize)
+		elog(ERROR, "unexpected alloc chunk size %zu (expected %zu)",
+			 size, slab->chunkSize);
+
+	/*
+	 * If there are no free chunks in any existing block, create a new block
+	 * and put it to the last freelist bucket.
+	 */
+	if (slab->minFreeChunks == 0)
+	{
+		block = (SlabBlock) malloc(slab->blockSize);
+
+		if (block == NULL)
+			return NULL;
+
+		block->nfree = slab->chunksPerBlock;
+		block->firstFreeChunk = 0;
+
+		/*
+		 * Put all the chunks on a freelist. Walk the chunks and point each
+		 * one to the next one.
+		 */
+		for (idx = 0; idx < slab->chunksPerBlock; idx++)
+		{
+			chunk = SlabBlockGetChunk(slab, block, idx);
+			*(int32 *) SlabChunkGetPointer(chunk) = (idx + 1);
+		}
+
+		/*
+		 * And add it to the last freelist with all chunks empty.
+		 *
+		 * We know there are no blocks in the freelist, otherwise we wouldn't
+		 * need a new block.
+		 */
+		Assert(dlist_is_empty(&slab->freelist[slab->chunksPerBlock]));
+
+		dlist_push_head(&slab->freelist[slab->chunksPerBlock], &block->node);
+
+		slab->minFreeChunks = slab->chunksPerBlock;
+		slab->nblocks += 1;
+		SlabMemAdd(slab, slab->blockSize);
+	}
+
+	/* grab the block from the freelist (even the new block is there) */
+	block = dlist_head_element(SlabBlockData, node,
+							   &slab->freelist[slab->minFreeChunks]);
+
+	/* make sure we actually got a valid block, with matching nfree */
+	Assert(block != NULL);
+	Assert(slab->minFreeChunks == block->nfree);
+	Assert(block->nfree > 0);
+
+	/* we know index of the first free chunk in the block */
+	idx = block->firstFreeChunk;
+
+	/* make sure the chunk index is valid, and that it's marked as empty */
+	Assert((idx >= 0) && (idx < slab->chunksPerBlock));
+
+	/* compute the chunk location block start (after the block header) */
+	chunk = SlabBlockGetChunk(slab, block, idx);
+
+	/*
+	 * Update the block nfree count, and also the minFreeChunks as we've
+	 * decreased nfree for a block with the minimum number of free chunks
+	 * (because that's how we chose the block).
+	 */
+	block->nfree--;
+	oldMinFreeChunks = slab->minFreeChunks;
+
+	/*
+	 * Remove the chunk from the freelist head. The index of the next free
+	 * chunk is stored in the chunk itself.
+	 */
+	VALGRIND_MAKE_MEM_DEFINED(SlabChunkGetPointer(chunk), sizeof(int32));
+	block->firstFreeChunk = *(int32 *) SlabChunkGetPointer(chunk);
+
+	Assert(block->firstFreeChunk >= 0);
+	Assert(block->firstFreeChunk <= slab->chunksPerBlock);
+
+	Assert((block->nfree != 0 &&
+			block->firstFreeChunk < slab->chunksPerBlock) ||
+		   (block->nfree == 0 &&
+			block->firstFreeChunk == slab->chunksPerBlock));
+
+	/* move the whole block to the right place in the freelist */
+	dlist_delete(&block->node);
+	dlist_push_head(&slab->freelist[block->nfree], &block->node);
+
+	/*
+	 * And finally update minFreeChunks.  The block we took the chunk from
+	 * had the fewest free chunks, so it still does unless it got full; in
+	 * that case look for the next non-empty freelist.
+	 */
+	if (block->nfree > 0)
+		slab->minFreeChunks = block->nfree;
+	else
+		SlabFindMinFreeChunks(slab, oldMinFreeChunks);
+
+	/* Prepare to initialize the chunk header. */
+	VALGRIND_MAKE_MEM_UNDEFINED(chunk, SLAB_CHUNKHDRSZ);
+
+	chunk->block = block;
+	header = SlabPointerGetHeader(SlabChunkGetPointer(chunk));
+	header->context = (MemoryContext) slab;
+	header->size = MAXALIGN(slab->chunkSize);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	header->requested_size = size;
+	VALGRIND_MAKE_MEM_NOACCESS(&header->requested_size,
+							   sizeof(header->requested_size));
+	/* slab mark to catch clobber of "unused" space */
+	if (slab->chunkSize < (slab->fullChunkSize - SLAB_CHUNKHDRSZ))
+		set_sentinel(SlabChunkGetPointer(chunk), size);
+#endif
+#ifdef RANDOMIZE_ALLOCATED_MEMORY
+	/* fill the allocated space with junk */
+	randomize_mem((char *) SlabChunkGetPointer(chunk), size);
+#endif
+
+	SlabAllocInfo(slab, chunk);
+	return SlabChunkGetPointer(chunk);
+}
+
+/*
+ * SlabFree
+ *		Frees allocated memory; memory is removed from the slab.
+ */
+static void
+SlabFree(MemoryContext context, void *pointer)
+{
+	int			idx;
+	Slab		slab = (Slab) context;
+	SlabChunk	chunk = SlabPointerGetChunk(pointer);
+	SlabBlock	block = chunk->block;
+	int			oldFreeChunks;
+
+	SlabFreeInfo(slab, chunk);
+
+#ifdef MEMORY_CONTEXT_CHECKING
+	/* Test for someone scribbling on unused space in chunk */
+	if (slab->chunkSize < (slab->fullChunkSize - SLAB_CHUNKHDRSZ))
+		if (!sentinel_ok(pointer, slab->chunkSize))
+			elog(WARNING, "detected write past chunk end in %s %p",
+				 slab->header.name, chunk);
+#endif
+
+	/* compute index of the chunk with respect to block start */
+	idx = SlabChunkIndex(slab, block, chunk);
+
+	/* add chunk to freelist, and update block nfree count */
+	*(int32 *) pointer = block->firstFreeChunk;
+	block->firstFreeChunk = idx;
+	oldFreeChunks = block->nfree;
+	block->nfree++;
+
+	Assert(block->nfree > 0);
+	Assert(block->nfree <= slab->chunksPerBlock);
+
+#ifdef CLOBBER_FREED_MEMORY
+	/* XXX don't wipe the int32 index, used for block-level freelist */
+	wipe_mem((char *) pointer + sizeof(int32),
+			 slab->chunkSize - sizeof(int32));
+#endif
+
+	/* remove the block from the freelist it was in */
+	dlist_delete(&block->node);
+
+	/*
+	 * If the block is now completely empty, free it, unless it's the only
+	 * empty one; we keep one around so that a context that keeps allocating
+	 * and freeing a single chunk doesn't go to malloc() every time.
+	 */
+	if (block->nfree == slab->chunksPerBlock &&
+		!dlist_is_empty(&slab->freelist[slab->chunksPerBlock]))
+	{
+		free(block);
+		slab->nblocks--;
+		SlabMemSub(slab, slab->blockSize);
+		block = NULL;
+	}
+	else
+		dlist_push_head(&slab->freelist[block->nfree], &block->node);
+
+	/*
+	 * See if we need to update the minFreeChunks field for the slab: the
+	 * block now has the fewest free chunks if it was full or had fewer
+	 * than the minimum already, and if it was alone in the minimum's
+	 * freelist, the minimum moves up.
+	 */
+	if (block != NULL &&
+		(slab->minFreeChunks == 0 || block->nfree < slab->minFreeChunks))
+		slab->minFreeChunks = block->nfree;
+	else if (slab->minFreeChunks == oldFreeChunks &&
+			 dlist_is_empty(&slab->freelist[oldFreeChunks]))
+		SlabFindMinFreeChunks(slab, oldFreeChunks + 1);
+
+	Assert(slab->nblocks >= 0);
+}
+
+/*
+ * SlabRealloc
+ *		Change the allocated size of a chunk.
+ *
+ * As Slab is designed for allocating equally-sized chunks of memory, it can't
+ * do an actual chunk size change.  We try to be gentle and allow calls with
+ * exactly the same size, as in that case we can simply return the same
+ * chunk.  When the size differs, we throw an error.
+ *
+ * We could also allow requests with size < chunkSize.  That however seems
+ * rather pointless - Slab is meant for chunks of constant size, and moreover
+ * realloc is usually used to enlarge the chunk.
+ */
+static void *
+SlabRealloc(MemoryContext context, void *pointer, Size size)
+{
+	Slab		slab = (Slab) context;
+
+	AssertArg(SlabIsValid(slab));
+
+	/* can't do actual realloc with slab, but let's try to be gentle */
+	if (size == slab->chunkSize)
+		return pointer;
+
+	elog(ERROR, "slab allocator does not support realloc()");
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * SlabGetChunkSpace
+ *		Given a currently-allocated chunk, determine the total space
+ *		it occupies (including all memory-allocation overhead).
+ */
+static Size
+SlabGetChunkSpace(MemoryContext context, void *pointer)
+{
+	Slab		slab = (Slab) context;
+
+	AssertArg(SlabIsValid(slab));
+
+	return slab->fullChunkSize;
+}
+
+/*
+ * SlabIsEmpty
+ *		Is an Slab empty of any allocated space?
+ */
+static bool
+SlabIsEmpty(MemoryContext context)
+{
+	Slab		slab = (Slab) context;
+
+	AssertArg(SlabIsValid(slab));
+
+	/* at most the one empty block we keep around */
+	return (slab->nblocks == 0 ||
+			(slab->nblocks == 1 &&
+			 !dlist_is_empty(&slab->freelist[slab->chunksPerBlock])));
+}
+
+/*
+ * SlabMemAllocated
+ *		Returns the total size of the blocks allocated for a slab.
+ */
+static Size
+SlabMemAllocated(MemoryContext context)
+{
+	Slab		slab = (Slab) context;
+
+	Assert(slab->header.mem_allocated == slab->nblocks * slab->blockSize);
+
+	return slab->header.mem_allocated;
+}
+
+/*
+ * SlabStats
+ *		Compute stats about memory consumption of a Slab context.
+ *
+ * level: recursion level (0 at top level); used for print indentation.
+ * print: true to print stats to stderr.
+ * totals: if not NULL, add stats about this context into *totals.
+ */
+static void
+SlabStats(MemoryContext context, int level, bool print,
+		  MemoryContextCounters *totals)
+{
+	Slab		slab = (Slab) context;
+	Size		nblocks = 0;
+	Size		freechunks = 0;
+	Size		totalspace = 0;
+	Size		freespace = 0;
+	int			i;
+
+	for (i = 0; i <= slab->chunksPerBlock; i++)
+	{
+		dlist_iter	iter;
+
+		dlist_foreach(iter, &slab->freelist[i])
+		{
+			SlabBlock	block = dlist_container(SlabBlockData, node, iter.cur);
+
+			nblocks++;
+			totalspace += slab->blockSize;
+			freespace += slab->fullChunkSize * block->nfree;
+			freechunks += block->nfree;
+		}
+	}
+
+	if (print)
+	{
+		for (i = 0; i < level; i++)
+			fprintf(stderr, "  ");
+
+		fprintf(stderr,
+				"%s: %zu total in %zd blocks; %zu free (%zd chunks); %zu used\n",
+				slab->header.name, totalspace, nblocks, freespace, freechunks,
+				totalspace - freespace);
+	}
+
+	if (totals)
+	{
+		totals->nblocks += nblocks;
+		totals->freechunks += freechunks;
+		totals->totalspace += totalspace;
+		totals->freespace += freespace;
+	}
+}
+
+
+#ifdef MEMORY_CONTEXT_CHECKING
+
+/*
+ * SlabCheck
+ *		Walk through chunks and check consistency of memory.
+ *
+ * NOTE: report errors as WARNING, *not* ERROR or FATAL.  Otherwise you'll
+ * find yourself in an infinite loop when trouble occurs, because this
+ * routine will be entered again when elog cleanup tries to release memory!
+ */
+static void
+SlabCheck(MemoryContext context)
+{
+	int			i;
+	Slab		slab = (Slab) context;
+	char	   *name = slab->header.name;
+	int			nblocks = 0;
+
+	Assert(slab);
+	Assert(slab->chunksPerBlock > 0);
+
+	/* walk all the freelists */
+	for (i = 0; i <= slab->chunksPerBlock; i++)
+	{
+		int			j,
+					nfree;
+		dlist_iter	iter;
+
+		/* walk all blocks on this freelist */
+		dlist_foreach(iter, &slab->freelist[i])
+		{
+			int			idx;
+			SlabBlock	block = dlist_container(SlabBlockData, node, iter.cur);
+
+			nblocks++;
+
+			/*
+			 * Make sure the number of free chunks (in the block header)
+			 * matches position in the freelist.
+			 */
+			if (block->nfree != i)
+				elog(WARNING, "problem in slab %s: number of free chunks %d in block %p does not match freelist %d",
+					 name, block->nfree, block, i);
+
+			/* reset the bitmap of free chunks for this block */
+			memset(slab->freechunks, 0, (slab->chunksPerBlock * sizeof(bool)));
+			idx = block->firstFreeChunk;
+
+			/*
+			 * Now walk through the chunks, count the free ones and also
+			 * perform some additional checks for the used ones.  As the
+			 * chunk freelist is stored within the chunks themselves, we have
+			 * to walk through the chunks and construct our own bitmap.
+			 */
+			nfree = 0;
+			while (idx < slab->chunksPerBlock)
+			{
+				SlabChunk	chunk;
+
+				/* count the chunk as free, add it to the bitmap */
+				nfree++;
+				slab->freechunks[idx] = true;
+
+				/* read index of the next free chunk */
+				chunk = SlabBlockGetChunk(slab, block, idx);
+				VALGRIND_MAKE_MEM_DEFINED(SlabChunkGetPointer(chunk),
+										  sizeof(int32));
+				idx = *(int32 *) SlabChunkGetPointer(chunk);
+			}
+
+			for (j = 0; j < slab->chunksPerBlock; j++)
+			{
+				/* a chunk not in the bitmap is in use */
+				if (!slab->freechunks[j])
+				{
+					SlabChunk	chunk = SlabBlockGetChunk(slab, block, j);
+					StandardChunkHeader *header =
+					SlabPointerGetHeader(SlabChunkGetPointer(chunk));
+
+					/* chunks link to both block and slab, so check both */
+					if (chunk->block != block)
+						elog(WARNING, "problem in slab %s: bogus block link in block %p, chunk %p",
+							 name, block, chunk);
+
+					if (header->context != (MemoryContext) slab)
+						elog(WARNING, "problem in slab %s: bogus slab link in block %p, chunk %p",
+							 name, block, chunk);
+
+					/* there might be sentinel (thanks to alignment) */
+					if (slab->chunkSize < (slab->fullChunkSize - SLAB_CHUNKHDRSZ))
+						if (!sentinel_ok(SlabChunkGetPointer(chunk),
+										 slab->chunkSize))
+							elog(WARNING, "problem in slab %s: detected write past chunk end in block %p, chunk %p",
+								 name, block, chunk);
+				}
+			}
+
+			/*
+			 * Make sure we got the expected number of free chunks (as
+			 * tracked in the block header).
+			 */
+			if (nfree != block->nfree)
+				elog(WARNING, "problem in slab %s: number of free chunks %d in block %p does not match bitmap %d",
+					 name, block->nfree, block, nfree);
+		}
+	}
+
+	if (nblocks != slab->nblocks)
+		elog(WARNING, "problem in slab %s: found %d blocks, expected %d",
+			 name, nblocks, slab->nblocks);
+}
+
+#endif   /* MEMORY_CONTEXT_CHECKING */
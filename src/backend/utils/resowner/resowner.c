@@ -20,7 +20,7 @@
  */
 #include "postgres.h"
 
-#include "access/hash.h"
+#include "storage/bufmgr.h"
 #include "storage/predicate.h"
 #include "storage/proc.h"
 #include "utils/memutils.h"
@@ -393,9 +393,6 @@ ResourceOwnerReleaseInternal(ResourceOwner owner,
 				PrintFileLeakWarning(owner->files[owner->nfiles - 1]);
 			FileClose(owner->files[owner->nfiles - 1]);
 		}
-
-		/* Clean up index scans too */
-		ReleaseResources_hash();
 	}
 
 	/* Let add-on modules get a chance too */
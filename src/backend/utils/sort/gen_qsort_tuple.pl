@@ -22,6 +22,10 @@
 #     Instead of sorting arbitrary objects, we're always sorting SortTuples.
 #     Add CHECK_FOR_INTERRUPTS().
 #
+#     Besides the generic versions, emit single-key versions for the common
+#     comparators in sortsupport.c, so that the comparison of datum1 values
+#     is inlined as well (see tuplesort_sort_memtuples()).
+#
 # CAUTION: if you change this file, see also qsort.c and qsort_arg.c
 #
 
@@ -53,6 +57,32 @@ print <<'EOM';
 EOM
 emit_qsort_implementation();
 
+$SUFFIX      = 'int32';
+print <<'EOM';
+
+#define cmp_int32(a, b, ssup) \
+	ApplyInt32SortComparator((a)->datum1, (a)->isnull1, \
+							 (b)->datum1, (b)->isnull1, ssup)
+
+EOM
+emit_qsort_implementation();
+
+$SUFFIX      = 'signed';
+print <<'EOM';
+
+#if SIZEOF_DATUM >= 8
+
+#define cmp_signed(a, b, ssup) \
+	ApplySignedSortComparator((a)->datum1, (a)->isnull1, \
+							  (b)->datum1, (b)->isnull1, ssup)
+
+EOM
+emit_qsort_implementation();
+print <<'EOM';
+
+#endif   /* SIZEOF_DATUM >= 8 */
+EOM
+
 sub emit_qsort_boilerplate
 {
 	print <<'EOM';
@@ -59,6 +59,18 @@
  * of releasing many blocks followed by re-using many blocks, due to
  * tuplesort.c's "preread" behavior.
  *
+ * Reading a tape one block at a time makes a merge look like random I/O
+ * spread over all of its input tapes, even though each tape is mostly laid
+ * out sequentially.  So a tape that is read destructively (that is, a merge
+ * input) can be given a larger buffer with LogicalTapeAssignReadBufferSize,
+ * which we fill with several consecutive blocks at a time, reading
+ * physically adjacent blocks with a single request.  We also look up to a
+ * buffer's worth of blocks beyond that, and tell the kernel that we'll need
+ * them soon, so that the next refill usually finds them already in cache.
+ * Read-ahead blocks are not released to the free pool until they have been
+ * read, so that the merge output can't overwrite them in the meantime.
+ * Frozen tapes, which support random access, are always read block by block.
+ *
  * Since all the bookkeeping and buffer memory is allocated with palloc(),
  * and the underlying file(s) are made with OpenTemporaryFile, all resources
  * for a logical tape set are certain to be cleaned up even if processing
@@ -79,6 +91,7 @@
 
 #include "storage/buffile.h"
 #include "utils/logtape.h"
+#include "utils/memutils.h"
 
 /*
  * Block indexes are "long"s, so we can fit this many per indirect block.
@@ -131,9 +144,22 @@ typedef struct LogicalTape
 	 * reading.
 	 */
 	char	   *buffer;			/* physical buffer (separately palloc'd) */
+	int			bufsize;		/* allocated size of buffer */
 	long		curBlockNumber; /* this block's logical blk# within tape */
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
+
+	/*
+	 * Multi-block reading of an unfrozen tape.  The buffer then holds the
+	 * blocks up to curBlockNumber, and readahead[] the block numbers of the
+	 * nreadahead blocks that follow, of which the first nadvised have already
+	 * been prefetched.  readbufsize is the buffer size to use from the next
+	 * rewind for reading on.
+	 */
+	int			readbufsize;	/* requested read buffer size */
+	long	   *readahead;		/* next block numbers, or NULL */
+	int			nreadahead;		/* # of valid entries in readahead[] */
+	int			nadvised;		/* # of those already prefetched */
 } LogicalTape;
 
 /*
@@ -188,6 +214,7 @@ static long ltsRecallNextBlockNum(LogicalTapeSet *lts,
 static long ltsRecallPrevBlockNum(LogicalTapeSet *lts,
 					  IndirectBlock *indirect);
 static void ltsDumpBuffer(LogicalTapeSet *lts, LogicalTape *lt);
+static bool ltsFillReadBuffer(LogicalTapeSet *lts, LogicalTape *lt);
 
 
 /*
@@ -546,9 +573,14 @@ LogicalTapeSetCreate(int ntapes)
 		lt->numFullBlocks = 0L;
 		lt->lastBlockBytes = 0;
 		lt->buffer = NULL;
+		lt->bufsize = 0;
 		lt->curBlockNumber = 0L;
 		lt->pos = 0;
 		lt->nbytes = 0;
+		lt->readbufsize = BLCKSZ;
+		lt->readahead = NULL;
+		lt->nreadahead = 0;
+		lt->nadvised = 0;
 	}
 	return lts;
 }
@@ -575,6 +607,8 @@ LogicalTapeSetClose(LogicalTapeSet *lts)
 		}
 		if (lt->buffer)
 			pfree(lt->buffer);
+		if (lt->readahead)
+			pfree(lt->readahead);
 	}
 	pfree(lts->freeBlocks);
 	pfree(lts);
@@ -595,6 +629,104 @@ LogicalTapeSetForgetFreeSpace(LogicalTapeSet *lts)
 	lts->forgetFreeSpace = true;
 }
 
+/*
+ * Set the size of the buffer to use when tapenum is next rewound for a
+ * destructive read.  The size is rounded down to a multiple of BLCKSZ; the
+ * minimum, and the default, is one block.
+ *
+ * The caller is responsible for accounting for the memory: every tape that
+ * has been read with a larger buffer keeps it until the tape set is closed.
+ */
+void
+LogicalTapeAssignReadBufferSize(LogicalTapeSet *lts, int tapenum,
+								size_t bufsize)
+{
+	LogicalTape *lt;
+
+	Assert(tapenum >= 0 && tapenum < lts->nTapes);
+	lt = &lts->tapes[tapenum];
+
+	bufsize = Min(bufsize, MaxAllocSize / 2);
+	bufsize -= bufsize % BLCKSZ;
+	lt->readbufsize = (int) Max(bufsize, BLCKSZ);
+}
+
+/*
+ * Refill the buffer of an unfrozen tape being read, with as many of the
+ * following blocks as fit.  Returns false at end of tape.
+ */
+static bool
+ltsFillReadBuffer(LogicalTapeSet *lts, LogicalTape *lt)
+{
+	int			nblocks = lt->bufsize / BLCKSZ;
+	int			maxreadahead = 2 * nblocks;
+	int			nread;
+	int			i;
+
+	Assert(!lt->writing && !lt->frozen);
+
+	lt->pos = 0;
+	lt->nbytes = 0;
+
+	/* Look up the numbers of the blocks to read now, and of the next ones */
+	while (lt->nreadahead < maxreadahead)
+	{
+		long		datablocknum = ltsRecallNextBlockNum(lts, lt->indirect,
+														 false);
+
+		if (datablocknum == -1L)
+			break;
+		lt->readahead[lt->nreadahead++] = datablocknum;
+	}
+	if (lt->nreadahead == 0)
+		return false;			/* EOF */
+
+	/* Read up to nblocks, issuing one read per physically contiguous range */
+	nread = Min(nblocks, lt->nreadahead);
+	for (i = 0; i < nread;)
+	{
+		long		first = lt->readahead[i];
+		int			n = 1;
+		size_t		len;
+
+		while (i + n < nread && lt->readahead[i + n] == first + n)
+			n++;
+		len = (size_t) n * BLCKSZ;
+		if (BufFileSeekBlock(lts->pfile, first) != 0 ||
+			BufFileRead(lts->pfile, lt->buffer + lt->nbytes, len) != len)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read block %ld of temporary file: %m",
+							first)));
+		for (; n > 0; n--, i++)
+		{
+			ltsReleaseBlock(lts, lt->readahead[i]);
+			lt->curBlockNumber++;
+			lt->nbytes += (lt->curBlockNumber < lt->numFullBlocks) ?
+				BLCKSZ : lt->lastBlockBytes;
+		}
+	}
+
+	/* Forget the blocks just read, and prefetch all of the rest */
+	lt->nreadahead -= nread;
+	memmove(lt->readahead, lt->readahead + nread,
+			lt->nreadahead * sizeof(long));
+	lt->nadvised = Max(lt->nadvised - nread, 0);
+	while (lt->nadvised < lt->nreadahead)
+	{
+		long		first = lt->readahead[lt->nadvised];
+		int			n = 1;
+
+		while (lt->nadvised + n < lt->nreadahead &&
+			   lt->readahead[lt->nadvised + n] == first + n)
+			n++;
+		BufFilePrefetchBlock(lts->pfile, first, n);
+		lt->nadvised += n;
+	}
+
+	return lt->nbytes > 0;
+}
+
 /*
  * Dump the dirty buffer of a logical tape.
  */
@@ -628,7 +760,10 @@ LogicalTapeWrite(LogicalTapeSet *lts, int tapenum,
 
 	/* Allocate data buffer and first indirect block on first write */
 	if (lt->buffer == NULL)
+	{
 		lt->buffer = (char *) palloc(BLCKSZ);
+		lt->bufsize = BLCKSZ;
+	}
 	if (lt->indirect == NULL)
 	{
 		lt->indirect = (IndirectBlock *) palloc(sizeof(IndirectBlock));
@@ -710,10 +845,31 @@ LogicalTapeRewind(LogicalTapeSet *lts, int tapenum, bool forWrite)
 			datablocknum = ltsRewindFrozenIndirectBlock(lts, lt->indirect);
 		}
 		/* Read the first block, or reset if tape is empty */
+		Assert(lt->readahead == NULL);
 		lt->curBlockNumber = 0L;
 		lt->pos = 0;
 		lt->nbytes = 0;
-		if (datablocknum != -1L)
+		if (datablocknum != -1L && !lt->frozen && lt->readbufsize > BLCKSZ)
+		{
+			/*
+			 * Read the first block along with the following ones.  We've
+			 * written to the tape, so it has a buffer to replace.
+			 */
+			if (lt->bufsize < lt->readbufsize)
+			{
+				pfree(lt->buffer);
+				lt->buffer = (char *) palloc(lt->readbufsize);
+				lt->bufsize = lt->readbufsize;
+			}
+			lt->readahead = (long *) palloc(2 * (lt->bufsize / BLCKSZ) *
+											sizeof(long));
+			lt->readahead[0] = datablocknum;
+			lt->nreadahead = 1;
+			lt->nadvised = 0;
+			lt->curBlockNumber = -1L;
+			(void) ltsFillReadBuffer(lts, lt);
+		}
+		else if (datablocknum != -1L)
 		{
 			ltsReadBlock(lts, datablocknum, (void *) lt->buffer);
 			if (!lt->frozen)
@@ -747,6 +903,12 @@ LogicalTapeRewind(LogicalTapeSet *lts, int tapenum, bool forWrite)
 			lt->indirect->nextSlot = 0;
 			lt->indirect->nextup = NULL;
 		}
+		if (lt->readahead)
+		{
+			Assert(lt->nreadahead == 0);
+			pfree(lt->readahead);
+			lt->readahead = NULL;
+		}
 		lt->writing = true;
 		lt->dirty = false;
 		lt->numFullBlocks = 0L;
@@ -776,7 +938,13 @@ LogicalTapeRead(LogicalTapeSet *lts, int tapenum,
 
 	while (size > 0)
 	{
-		if (lt->pos >= lt->nbytes)
+		if (lt->pos >= lt->nbytes && lt->readahead != NULL)
+		{
+			/* Multi-block read of an unfrozen tape */
+			if (!ltsFillReadBuffer(lts, lt))
+				break;			/* EOF */
+		}
+		else if (lt->pos >= lt->nbytes)
 		{
 			/* Try to load more data into buffer. */
 			long		datablocknum = ltsRecallNextBlockNum(lts, lt->indirect,
@@ -1002,6 +1170,8 @@ LogicalTapeTell(LogicalTapeSet *lts, int tapenum,
 
 	Assert(tapenum >= 0 && tapenum < lts->nTapes);
 	lt = &lts->tapes[tapenum];
+	/* the position is not well-defined in a multi-block buffer */
+	Assert(lt->readahead == NULL);
 	*blocknum = lt->curBlockNumber;
 	*offset = lt->pos;
 }
@@ -73,6 +73,17 @@
  * on-the-fly as the caller repeatedly calls tuplesort_getXXX; this
  * saves one cycle of writing all the data out to disk and reading it in.
  *
+ * A sort can also be split among parallel workers.  Each worker sorts its
+ * share of the input in its own Tuplesortstate, and streams the sorted run
+ * to the leader through a shm_mq with tuplesort_send_sorted().  The leader
+ * then merges the streams of all workers, plus optionally a run it sorted
+ * itself, on-the-fly like a final merge (see tuplesort_merge_sorted()).
+ * Streaming the runs means that workers never have to share temporary files,
+ * and that the leader can start producing output as soon as every worker
+ * has finished sorting; each worker stays blocked on its queue until the
+ * leader's merge consumes its tuples.  Only the CLUSTER and btree index
+ * cases support this, since those are the sorts done outside the executor.
+ *
  * Before Postgres 8.2, we always used a seven-tape polyphase merge, on the
  * grounds that 7 is the "sweet spot" on the tapes-to-passes curve according
  * to Knuth's figure 70 (section 5.4.2).  However, Knuth is assuming that
@@ -100,6 +111,7 @@
 
 #include <limits.h>
 
+#include "access/gin_private.h"
 #include "access/htup_details.h"
 #include "access/nbtree.h"
 #include "catalog/index.h"
@@ -107,6 +119,7 @@
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "storage/shm_mq.h"
 #include "utils/datum.h"
 #include "utils/logtape.h"
 #include "utils/lsyscache.h"
@@ -186,7 +199,8 @@ typedef enum
 	TSS_BUILDRUNS,				/* Loading tuples; writing to tape */
 	TSS_SORTEDINMEM,			/* Sort completed entirely in memory */
 	TSS_SORTEDONTAPE,			/* Sort completed, final run is on tape */
-	TSS_FINALMERGE				/* Performing final merge on-the-fly */
+	TSS_FINALMERGE,				/* Performing final merge on-the-fly */
+	TSS_MERGESORTED				/* Merging sorted streams on-the-fly */
 } TupSortStatus;
 
 /*
@@ -199,10 +213,15 @@ typedef enum
  *
  * MERGE_BUFFER_SIZE is how much data we'd like to read from each input
  * tape during a preread cycle (see discussion at top of file).
+ *
+ * MAX_TAPE_READ_BUFFER_SIZE caps the read buffer each tape gets for merging
+ * (see mergeruns); beyond that, larger reads don't make the I/O any more
+ * sequential.
  */
 #define MINORDER		6		/* minimum merge order */
 #define TAPE_BUFFER_OVERHEAD		(BLCKSZ * 3)
 #define MERGE_BUFFER_SIZE			(BLCKSZ * 32)
+#define MAX_TAPE_READ_BUFFER_SIZE	(BLCKSZ * 256)
 
 typedef int (*SortTupleComparator) (const SortTuple *a, const SortTuple *b,
 												Tuplesortstate *state);
@@ -224,6 +243,7 @@ struct Tuplesortstate
 	int			maxTapes;		/* number of tapes (Knuth's T) */
 	int			tapeRange;		/* maxTapes-1 (Knuth's P) */
 	MemoryContext sortcontext;	/* memory context holding all sort data */
+	MemoryContext tuplecontext; /* sub-context of sortcontext for tuple data */
 	LogicalTapeSet *tapeset;	/* logtape.c object for tapes in a temp file */
 
 	/*
@@ -335,6 +355,18 @@ struct Tuplesortstate
 	int			current;		/* array index (only used if SORTEDINMEM) */
 	bool		eof_reached;	/* reached EOF (needed for cursors) */
 
+	/*
+	 * These variables are used by a leader merging the sorted runs of
+	 * parallel workers, in state MERGESORTED.  Sources 0 .. nqueues - 1 are
+	 * the workers' queues; source nqueues, if localsort is set, is a sort the
+	 * leader did itself.  sourcehead[i] is the first not yet merged tuple of
+	 * source i; the heap in memtuples[] holds exactly those tuples of
+	 * sources that are not exhausted yet.
+	 */
+	int			nqueues;		/* number of worker queues */
+	shm_mq_handle **queues;		/* worker queues, NULL once exhausted */
+	Tuplesortstate *localsort;	/* leader's own sorted run, or NULL */
+
 	/* markpos_xxx holds marked position for mark and restore */
 	long		markpos_block;	/* tape block# (only used if SORTEDONTAPE) */
 	int			markpos_offset; /* saved "current", or offset in tape block */
@@ -383,6 +415,9 @@ struct Tuplesortstate
 	/* These are specific to the index_hash subcase: */
 	uint32		hash_mask;		/* mask for sortable part of hash code */
 
+	/* These are specific to the index_gin subcase: */
+	GinState   *ginstate;		/* for comparing the keys */
+
 	/*
 	 * These variables are specific to the Datum case; they are set by
 	 * tuplesort_begin_datum and used only by the DatumTuple routines.
@@ -494,11 +529,17 @@ static int comparetup_index_btree(const SortTuple *a, const SortTuple *b,
 					   Tuplesortstate *state);
 static int comparetup_index_hash(const SortTuple *a, const SortTuple *b,
 					  Tuplesortstate *state);
+static int comparetup_index_gin(const SortTuple *a, const SortTuple *b,
+					 Tuplesortstate *state);
 static void copytup_index(Tuplesortstate *state, SortTuple *stup, void *tup);
+static void copytup_index_gin(Tuplesortstate *state, SortTuple *stup,
+				  void *tup);
 static void writetup_index(Tuplesortstate *state, int tapenum,
 			   SortTuple *stup);
 static void readtup_index(Tuplesortstate *state, SortTuple *stup,
 			  int tapenum, unsigned int len);
+static void readtup_index_gin(Tuplesortstate *state, SortTuple *stup,
+				  int tapenum, unsigned int len);
 static int comparetup_datum(const SortTuple *a, const SortTuple *b,
 				 Tuplesortstate *state);
 static void copytup_datum(Tuplesortstate *state, SortTuple *stup, void *tup);
@@ -507,13 +548,21 @@ static void writetup_datum(Tuplesortstate *state, int tapenum,
 static void readtup_datum(Tuplesortstate *state, SortTuple *stup,
 			  int tapenum, unsigned int len);
 static void free_sort_tuple(Tuplesortstate *state, SortTuple *stup);
+static void tuplesort_sort_memtuples(Tuplesortstate *state);
+static void send_sort_tuple(Tuplesortstate *state, shm_mq_handle *mqh,
+				SortTuple *stup);
+static bool receive_sort_tuple(Tuplesortstate *state, shm_mq_handle *mqh,
+				   SortTuple *stup);
+static bool merge_sorted_next(Tuplesortstate *state, int srcno,
+				  SortTuple *stup);
 
 /*
  * Special versions of qsort just for SortTuple objects.  qsort_tuple() sorts
  * any variant of SortTuples, using the appropriate comparetup function.
  * qsort_ssup() is specialized for the case where the comparetup function
  * reduces to ApplySortComparator(), that is single-key MinimalTuple sorts
- * and Datum sorts.
+ * and Datum sorts.  qsort_int32() and qsort_signed() further specialize that
+ * for the comparators of the common integer-like datatypes.
  */
 #include "qsort_tuple.c"
 
@@ -576,6 +625,16 @@ tuplesort_begin_common(int workMem, bool randomAccess)
 	state->sortcontext = sortcontext;
 	state->tapeset = NULL;
 
+	/*
+	 * Tuples are mostly freed all at once, or in about the order they were
+	 * loaded as runs are written out or merged, so keep them in a generation
+	 * context: without aset.c's power-of-2 rounding, more of them fit in
+	 * workMem.
+	 */
+	state->tuplecontext = GenerationContextCreate(sortcontext,
+												  "Caller tuples",
+												  GENERATION_DEFAULT_BLOCK_SIZE);
+
 	state->memtupcount = 0;
 
 	/*
@@ -698,11 +757,11 @@ tuplesort_begin_cluster(TupleDesc tupDesc,
 	if (trace_sort)
 		elog(LOG,
 			 "begin tuple sort: nkeys = %d, workMem = %d, randomAccess = %c",
-			 RelationGetNumberOfAttributes(indexRel),
+			 IndexRelationGetNumberOfKeyAttributes(indexRel),
 			 workMem, randomAccess ? 't' : 'f');
 #endif
 
-	state->nKeys = RelationGetNumberOfAttributes(indexRel);
+	state->nKeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
 
 	TRACE_POSTGRESQL_SORT_START(CLUSTER_SORT,
 								false,	/* no unique check */
@@ -793,7 +852,7 @@ tuplesort_begin_index_btree(Relation heapRel,
 			 workMem, randomAccess ? 't' : 'f');
 #endif
 
-	state->nKeys = RelationGetNumberOfAttributes(indexRel);
+	state->nKeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
 
 	TRACE_POSTGRESQL_SORT_START(INDEX_SORT,
 								enforceUnique,
@@ -812,7 +871,7 @@ tuplesort_begin_index_btree(Relation heapRel,
 	state->enforceUnique = enforceUnique;
 
 	indexScanKey = _bt_mkscankey_nodata(indexRel);
-	state->nKeys = RelationGetNumberOfAttributes(indexRel);
+	state->nKeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
 
 	/* Prepare SortSupport data for each column */
 	state->sortKeys = (SortSupport) palloc0(state->nKeys *
@@ -883,6 +942,112 @@ tuplesort_begin_index_hash(Relation heapRel,
 	return state;
 }
 
+Tuplesortstate *
+tuplesort_begin_index_gist(Relation heapRel,
+						   Relation indexRel,
+						   int workMem, bool randomAccess)
+{
+	Tuplesortstate *state = tuplesort_begin_common(workMem, randomAccess);
+	MemoryContext oldcontext;
+	int			i;
+
+	oldcontext = MemoryContextSwitchTo(state->sortcontext);
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG,
+			 "begin index sort: workMem = %d, randomAccess = %c",
+			 workMem, randomAccess ? 't' : 'f');
+#endif
+
+	state->nKeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
+
+	TRACE_POSTGRESQL_SORT_START(INDEX_SORT,
+								false,
+								state->nKeys,
+								workMem,
+								randomAccess);
+
+	/*
+	 * The tuples are compared just like btree index tuples, only with the
+	 * comparators supplied by the GiST opclasses.
+	 */
+	state->comparetup = comparetup_index_btree;
+	state->copytup = copytup_index;
+	state->writetup = writetup_index;
+	state->readtup = readtup_index;
+	state->abbrevNext = 10;
+
+	state->heapRel = heapRel;
+	state->indexRel = indexRel;
+	state->enforceUnique = false;
+
+	/* Prepare SortSupport data for each column */
+	state->sortKeys = (SortSupport) palloc0(state->nKeys *
+											sizeof(SortSupportData));
+
+	for (i = 0; i < state->nKeys; i++)
+	{
+		SortSupport sortKey = state->sortKeys + i;
+
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_collation = indexRel->rd_indcollation[i];
+		sortKey->ssup_nulls_first = false;
+		sortKey->ssup_attno = i + 1;
+		/* Convey if abbreviation optimization is applicable in principle */
+		sortKey->abbreviate = (i == 0);
+
+		AssertState(sortKey->ssup_attno != 0);
+
+		PrepareSortSupportFromGistIndexRel(indexRel, sortKey);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return state;
+}
+
+Tuplesortstate *
+tuplesort_begin_index_gin(Relation heapRel,
+						  Relation indexRel,
+						  int workMem, bool randomAccess)
+{
+	Tuplesortstate *state = tuplesort_begin_common(workMem, randomAccess);
+	MemoryContext oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(state->sortcontext);
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG,
+			 "begin GIN entry sort: workMem = %d, randomAccess = %c",
+			 workMem, randomAccess ? 't' : 'f');
+#endif
+
+	state->nKeys = 1;			/* the key, compared by the GIN opclass */
+
+	TRACE_POSTGRESQL_SORT_START(INDEX_SORT,
+								false,
+								state->nKeys,
+								workMem,
+								randomAccess);
+
+	state->comparetup = comparetup_index_gin;
+	state->copytup = copytup_index_gin;
+	state->writetup = writetup_index;
+	state->readtup = readtup_index_gin;
+
+	state->heapRel = heapRel;
+	state->indexRel = indexRel;
+
+	state->ginstate = (GinState *) palloc(sizeof(GinState));
+	initGinState(state->ginstate, indexRel);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return state;
+}
+
 Tuplesortstate *
 tuplesort_begin_datum(Oid datumType, Oid sortOperator, Oid sortCollation,
 					  bool nullsFirstFlag,
@@ -989,6 +1154,18 @@ tuplesort_set_bound(Tuplesortstate *state, int64 bound)
 	state->bounded = true;
 	state->bound = (int) bound;
 
+	/*
+	 * A bounded heap discards tuples in no particular order, and a generation
+	 * context could not reuse their space, so switch to an aset.c context.
+	 * No tuples have been loaded yet, so there is nothing to carry over.
+	 */
+	MemoryContextDelete(state->tuplecontext);
+	state->tuplecontext = AllocSetContextCreate(state->sortcontext,
+												"Caller tuples",
+												ALLOCSET_DEFAULT_MINSIZE,
+												ALLOCSET_DEFAULT_INITSIZE,
+												ALLOCSET_DEFAULT_MAXSIZE);
+
 	/*
 	 * Bounded sorts are not an effective target for abbreviated key
 	 * optimization.  Disable by setting state to be consistent with no
@@ -1057,6 +1234,10 @@ tuplesort_end(Tuplesortstate *state)
 	TRACE_POSTGRESQL_SORT_DONE(state->tapeset != NULL, 0L);
 #endif
 
+	/* End the leader's own run, if a merge of streamed runs didn't */
+	if (state->localsort != NULL)
+		tuplesort_end(state->localsort);
+
 	/* Free any execution state created for CLUSTER case */
 	if (state->estate != NULL)
 	{
@@ -1248,6 +1429,24 @@ tuplesort_putheaptuple(Tuplesortstate *state, HeapTuple tup)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Collect one ready-made index tuple while collecting input data for sort.
+ *
+ * Note that the input data is always copied; the caller need not save it.
+ */
+void
+tuplesort_putindextuple(Tuplesortstate *state, IndexTuple tuple)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(state->sortcontext);
+	SortTuple	stup;
+
+	COPYTUP(state, &stup, (void *) tuple);
+
+	puttuple_common(state, &stup);
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
 /*
  * Collect one index tuple while collecting input data for sort, building
  * it from caller-supplied values.
@@ -1262,7 +1461,9 @@ tuplesort_putindextuplevalues(Tuplesortstate *state, Relation rel,
 	Datum		original;
 	IndexTuple	tuple;
 
+	MemoryContextSwitchTo(state->tuplecontext);
 	stup.tuple = index_form_tuple(RelationGetDescr(rel), values, isnull);
+	MemoryContextSwitchTo(state->sortcontext);
 	tuple = ((IndexTuple) stup.tuple);
 	tuple->t_tid = *self;
 	USEMEM(state, GetMemoryChunkSpace(stup.tuple));
@@ -1354,7 +1555,11 @@ tuplesort_putdatum(Tuplesortstate *state, Datum val, bool isNull)
 	}
 	else
 	{
-		Datum		original = datumCopy(val, false, state->datumTypeLen);
+		Datum		original;
+
+		MemoryContextSwitchTo(state->tuplecontext);
+		original = datumCopy(val, false, state->datumTypeLen);
+		MemoryContextSwitchTo(state->sortcontext);
 
 		stup.isnull1 = false;
 		stup.tuple = DatumGetPointer(original);
@@ -1567,6 +1772,36 @@ consider_abort_common(Tuplesortstate *state)
 	return false;
 }
 
+/*
+ * Sort all memtuples using the fastest applicable qsort variant.
+ */
+static void
+tuplesort_sort_memtuples(Tuplesortstate *state)
+{
+	if (state->memtupcount <= 1)
+		return;
+
+	/* Can we use the single-key sort function? */
+	if (state->onlyKey != NULL)
+	{
+		SortSupport onlyKey = state->onlyKey;
+
+		if (onlyKey->comparator == ssup_datum_int32_cmp)
+			qsort_int32(state->memtuples, state->memtupcount, onlyKey);
+#if SIZEOF_DATUM >= 8
+		else if (onlyKey->comparator == ssup_datum_signed_cmp)
+			qsort_signed(state->memtuples, state->memtupcount, onlyKey);
+#endif
+		else
+			qsort_ssup(state->memtuples, state->memtupcount, onlyKey);
+	}
+	else
+		qsort_tuple(state->memtuples,
+					state->memtupcount,
+					state->comparetup,
+					state);
+}
+
 /*
  * All tuples have been provided; finish the sort.
  */
@@ -1589,18 +1824,7 @@ tuplesort_performsort(Tuplesortstate *state)
 			 * We were able to accumulate all the tuples within the allowed
 			 * amount of memory.  Just qsort 'em and we're done.
 			 */
-			if (state->memtupcount > 1)
-			{
-				/* Can we use the single-key sort function? */
-				if (state->onlyKey != NULL)
-					qsort_ssup(state->memtuples, state->memtupcount,
-							   state->onlyKey);
-				else
-					qsort_tuple(state->memtuples,
-								state->memtupcount,
-								state->comparetup,
-								state);
-			}
+			tuplesort_sort_memtuples(state);
 			state->current = 0;
 			state->eof_reached = false;
 			state->markpos_offset = 0;
@@ -1639,6 +1863,14 @@ tuplesort_performsort(Tuplesortstate *state)
 			state->markpos_eof = false;
 			break;
 
+		case TSS_MERGESORTED:
+
+			/*
+			 * tuplesort_merge_sorted() has already set up the merge, which we
+			 * perform on-the-fly.
+			 */
+			break;
+
 		default:
 			elog(ERROR, "invalid tuplesort state");
 			break;
@@ -1855,6 +2087,28 @@ tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 			}
 			return false;
 
+		case TSS_MERGESORTED:
+			Assert(forward);
+			*should_free = true;
+
+			if (state->memtupcount > 0)
+			{
+				int			srcno = state->memtuples[0].tupindex;
+				SortTuple	newtup;
+
+				*stup = state->memtuples[0];
+				/* returned tuple is no longer counted in our memory space */
+				if (stup->tuple)
+					FREEMEM(state, GetMemoryChunkSpace(stup->tuple));
+				tuplesort_heap_siftup(state, false);
+
+				/* replace it with the next tuple from the same source */
+				if (merge_sorted_next(state, srcno, &newtup))
+					tuplesort_heap_insert(state, &newtup, srcno, false);
+				return true;
+			}
+			return false;
+
 		default:
 			elog(ERROR, "invalid tuplesort state");
 			return false;		/* keep compiler quiet */
@@ -2227,6 +2481,7 @@ mergeruns(Tuplesortstate *state)
 				svTape,
 				svRuns,
 				svDummy;
+	int64		readBufferSize;
 
 	Assert(state->status == TSS_BUILDRUNS);
 	Assert(state->memtupcount == 0);
@@ -2262,6 +2517,30 @@ mergeruns(Tuplesortstate *state)
 		state->sortKeys->abbrev_full_comparator = NULL;
 	}
 
+	/*
+	 * Now that the memory used for building runs is free again, give half of
+	 * it to the tapes as read buffers, so that each input tape is read (and
+	 * read ahead) several blocks at a time; the other half is left for
+	 * prereading tuples, see beginmerge.  Since every tape may be an input
+	 * tape in some merge pass, and keeps its buffer from then on, we must
+	 * budget for all of them.  TAPE_BUFFER_OVERHEAD already covers one block.
+	 */
+	readBufferSize = state->availMem / 2 / state->maxTapes;
+	readBufferSize -= readBufferSize % BLCKSZ;
+	readBufferSize = Min(readBufferSize, MAX_TAPE_READ_BUFFER_SIZE);
+	if (readBufferSize > BLCKSZ)
+	{
+		for (tapenum = 0; tapenum < state->maxTapes; tapenum++)
+			LogicalTapeAssignReadBufferSize(state->tapeset, tapenum,
+											(size_t) readBufferSize);
+		USEMEM(state, (readBufferSize - BLCKSZ) * state->maxTapes);
+#ifdef TRACE_SORT
+		if (trace_sort)
+			elog(LOG, "using " INT64_FORMAT " KB of read buffer per tape: %s",
+				 readBufferSize / 1024, pg_rusage_show(&state->ru_start));
+#endif
+	}
+
 	/* End of step D2: rewind all output tapes to prepare for merging */
 	for (tapenum = 0; tapenum < state->tapeRange; tapenum++)
 		LogicalTapeRewind(state->tapeset, tapenum, false);
@@ -2824,12 +3103,284 @@ tuplesort_get_stats(Tuplesortstate *state,
 		case TSS_FINALMERGE:
 			*sortMethod = "external merge";
 			break;
+		case TSS_MERGESORTED:
+			*sortMethod = "parallel merge";
+			break;
 		default:
 			*sortMethod = "still in progress";
 			break;
 	}
 }
 
+/*
+ * tuplesort_get_peak_memory - the most memory the sort has held at once
+ *
+ * Unlike the space reported by tuplesort_get_stats, this comes from the
+ * memory context code and so is also accurate for disk-based sorts.  Bytes.
+ */
+Size
+tuplesort_get_peak_memory(Tuplesortstate *state)
+{
+	return MemoryContextMemPeak(state->sortcontext, true);
+}
+
+
+/*
+ * Parallel sort support.
+ *
+ * A sorted run travels through a shm_mq as one message per tuple, in sort
+ * order, followed by an empty message marking the end of the run.  An index
+ * tuple is sent as it is.  A CLUSTER heap tuple is sent as a ParallelSortHeader
+ * holding the fields of HeapTupleData the receiver needs, followed by the
+ * tuple body at a MAXALIGN'd offset, so that it can be used in place.
+ */
+typedef struct ParallelSortHeader
+{
+	ItemPointerData t_self;		/* SelfItemPointer */
+	Oid			t_tableOid;		/* table the tuple came from */
+} ParallelSortHeader;
+
+/*
+ * tuplesort_send_sorted - stream a sorted run to another backend
+ *
+ * Call this in a parallel worker, after tuplesort_performsort, to send every
+ * tuple in order to the leader, who attaches the other end of the queue to
+ * its sort with tuplesort_merge_sorted or tuplesort_receive_sorted.  The
+ * sort is consumed; it can only be ended afterwards.
+ */
+void
+tuplesort_send_sorted(Tuplesortstate *state, shm_mq_handle *mqh)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(state->sortcontext);
+	SortTuple	stup;
+	bool		should_free;
+	shm_mq_result result;
+
+	while (tuplesort_gettuple_common(state, true, &stup, &should_free))
+	{
+		send_sort_tuple(state, mqh, &stup);
+		if (should_free && stup.tuple)
+			pfree(stup.tuple);
+	}
+
+	/* an empty message marks the end of the run */
+	result = shm_mq_send(mqh, 0, NULL, false);
+	if (result != SHM_MQ_SUCCESS)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not send sorted tuples to parallel leader")));
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * tuplesort_receive_sorted - add a streamed run to a sort
+ *
+ * Read one run sent with tuplesort_send_sorted, and add its tuples to the
+ * sort like tuplesort_puttuple would.  This is for runs that are better
+ * sorted again along with the leader's other input than merged, because
+ * they are expected to be small.  Returns the number of tuples added.
+ */
+int64
+tuplesort_receive_sorted(Tuplesortstate *state, shm_mq_handle *mqh)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(state->sortcontext);
+	SortTuple	stup;
+	int64		ntuples = 0;
+
+	while (receive_sort_tuple(state, mqh, &stup))
+	{
+		puttuple_common(state, &stup);
+		ntuples++;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return ntuples;
+}
+
+/*
+ * tuplesort_merge_sorted - merge streamed runs
+ *
+ * Instead of accepting tuples, make the sort return the merge of the runs
+ * being sent through the given queues with tuplesort_send_sorted, plus the
+ * output of localsort if that is not NULL.  localsort must be of the same
+ * kind and have been performed already; it is ended along with this sort.
+ * The queues must remain valid while the merge is read.
+ *
+ * This waits for the first tuple of every run.  After that, tuples are
+ * returned by tuplesort_getXXX in the usual way; tuplesort_performsort does
+ * nothing.  Uniqueness is checked across runs as for any other merge.
+ */
+void
+tuplesort_merge_sorted(Tuplesortstate *state, shm_mq_handle **queues,
+					   int nqueues, Tuplesortstate *localsort)
+{
+	MemoryContext oldcontext = MemoryContextSwitchTo(state->sortcontext);
+	int			srcno;
+
+	Assert(state->status == TSS_INITIAL && state->memtupcount == 0);
+	Assert(!state->randomAccess);
+
+	if (nqueues + 1 > state->memtupsize)
+		elog(ERROR, "too many sorted runs to merge");
+
+	state->nqueues = nqueues;
+	state->queues = (shm_mq_handle **)
+		palloc(nqueues * sizeof(shm_mq_handle *));
+	memcpy(state->queues, queues, nqueues * sizeof(shm_mq_handle *));
+	state->localsort = localsort;
+
+	/*
+	 * Switching state first keeps copytup from trying to abort abbreviation
+	 * in the middle of the merge (see consider_abort_common).
+	 */
+	state->status = TSS_MERGESORTED;
+
+	/* load the first tuple of each run into the heap */
+	for (srcno = 0; srcno <= nqueues; srcno++)
+	{
+		SortTuple	stup;
+
+		if (merge_sorted_next(state, srcno, &stup))
+			tuplesort_heap_insert(state, &stup, srcno, false);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Fetch the next tuple of source srcno of a merge of streamed runs into
+ * *stup.  Returns FALSE if the source is exhausted.
+ */
+static bool
+merge_sorted_next(Tuplesortstate *state, int srcno, SortTuple *stup)
+{
+	if (srcno < state->nqueues)
+	{
+		if (state->queues[srcno] == NULL)
+			return false;
+		if (receive_sort_tuple(state, state->queues[srcno], stup))
+			return true;
+		state->queues[srcno] = NULL;
+		return false;
+	}
+	else if (state->localsort != NULL)
+	{
+		SortTuple	localtup;
+		bool		should_free;
+		bool		found;
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(state->localsort->sortcontext);
+		found = tuplesort_gettuple_common(state->localsort, true,
+										  &localtup, &should_free);
+		MemoryContextSwitchTo(oldcontext);
+
+		if (!found)
+		{
+			tuplesort_end(state->localsort);
+			state->localsort = NULL;
+			return false;
+		}
+
+		/* copy it, so that its key is set up the way this sort wants */
+		COPYTUP(state, stup, localtup.tuple);
+		if (should_free && localtup.tuple)
+			pfree(localtup.tuple);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Send one tuple of a sorted run.
+ */
+static void
+send_sort_tuple(Tuplesortstate *state, shm_mq_handle *mqh, SortTuple *stup)
+{
+	shm_mq_result result;
+
+	if (state->copytup == copytup_index ||
+		state->copytup == copytup_index_gin)
+	{
+		IndexTuple	tuple = (IndexTuple) stup->tuple;
+
+		result = shm_mq_send(mqh, IndexTupleSize(tuple), tuple, false);
+	}
+	else if (state->copytup == copytup_cluster)
+	{
+		HeapTuple	tuple = (HeapTuple) stup->tuple;
+		char		header[MAXALIGN(sizeof(ParallelSortHeader))];
+		ParallelSortHeader *hdr = (ParallelSortHeader *) header;
+		shm_mq_iovec iov[2];
+
+		memset(header, 0, sizeof(header));
+		hdr->t_self = tuple->t_self;
+		hdr->t_tableOid = tuple->t_tableOid;
+		iov[0].data = header;
+		iov[0].len = sizeof(header);
+		iov[1].data = (const char *) tuple->t_data;
+		iov[1].len = tuple->t_len;
+		result = shm_mq_sendv(mqh, iov, 2, false);
+	}
+	else
+	{
+		elog(ERROR, "parallel sort is not supported for this kind of tuple");
+		result = SHM_MQ_DETACHED;	/* keep compiler quiet */
+	}
+
+	if (result != SHM_MQ_SUCCESS)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not send sorted tuples to parallel leader")));
+}
+
+/*
+ * Receive one tuple of a sorted run into a SortTuple, copying it into sort
+ * memory.  Returns FALSE at the end of the run.
+ *
+ * A sender that goes away without marking the end of its run has failed;
+ * we expect it to have reported its error to the parallel leader, which will
+ * rethrow it when waiting for the workers to finish.  For a worker that
+ * never started at all, the end of its (empty) run is all there is to see.
+ */
+static bool
+receive_sort_tuple(Tuplesortstate *state, shm_mq_handle *mqh, SortTuple *stup)
+{
+	shm_mq_result result;
+	Size		nbytes;
+	void	   *data;
+
+	result = shm_mq_receive(mqh, &nbytes, &data, false);
+	if (result == SHM_MQ_DETACHED)
+		return false;
+	Assert(result == SHM_MQ_SUCCESS);
+	if (nbytes == 0)
+		return false;
+
+	if (state->copytup == copytup_cluster)
+	{
+		ParallelSortHeader *hdr = (ParallelSortHeader *) data;
+		HeapTupleData tuple;
+
+		tuple.t_self = hdr->t_self;
+		tuple.t_tableOid = hdr->t_tableOid;
+		tuple.t_len = nbytes - MAXALIGN(sizeof(ParallelSortHeader));
+		tuple.t_data = (HeapTupleHeader)
+			((char *) data + MAXALIGN(sizeof(ParallelSortHeader)));
+		COPYTUP(state, stup, &tuple);
+	}
+	else
+	{
+		Assert(state->copytup == copytup_index ||
+			   state->copytup == copytup_index_gin);
+		COPYTUP(state, stup, data);
+	}
+
+	return true;
+}
+
 
 /*
  * Heap manipulation routines, per Knuth's Algorithm 5.2.3H.
@@ -3143,9 +3694,12 @@ copytup_heap(Tuplesortstate *state, SortTuple *stup, void *tup)
 	Datum		original;
 	MinimalTuple tuple;
 	HeapTupleData htup;
+	MemoryContext oldcontext;
 
 	/* copy the tuple into sort storage */
+	oldcontext = MemoryContextSwitchTo(state->tuplecontext);
 	tuple = ExecCopySlotMinimalTuple(slot);
+	MemoryContextSwitchTo(oldcontext);
 	stup->tuple = (void *) tuple;
 	USEMEM(state, GetMemoryChunkSpace(tuple));
 	/* set up first-column key value */
@@ -3237,7 +3791,8 @@ readtup_heap(Tuplesortstate *state, SortTuple *stup,
 {
 	unsigned int tupbodylen = len - sizeof(int);
 	unsigned int tuplen = tupbodylen + MINIMAL_TUPLE_DATA_OFFSET;
-	MinimalTuple tuple = (MinimalTuple) palloc(tuplen);
+	MinimalTuple tuple = (MinimalTuple) MemoryContextAlloc(state->tuplecontext,
+														   tuplen);
 	char	   *tupbody = (char *) tuple + MINIMAL_TUPLE_DATA_OFFSET;
 	HeapTupleData htup;
 
@@ -3380,9 +3935,12 @@ copytup_cluster(Tuplesortstate *state, SortTuple *stup, void *tup)
 {
 	HeapTuple	tuple = (HeapTuple) tup;
 	Datum		original;
+	MemoryContext oldcontext;
 
 	/* copy the tuple into sort storage */
+	oldcontext = MemoryContextSwitchTo(state->tuplecontext);
 	tuple = heap_copytuple(tuple);
+	MemoryContextSwitchTo(oldcontext);
 	stup->tuple = (void *) tuple;
 	USEMEM(state, GetMemoryChunkSpace(tuple));
 
@@ -3471,7 +4029,8 @@ readtup_cluster(Tuplesortstate *state, SortTuple *stup,
 				int tapenum, unsigned int tuplen)
 {
 	unsigned int t_len = tuplen - sizeof(ItemPointerData) - sizeof(int);
-	HeapTuple	tuple = (HeapTuple) palloc(t_len + HEAPTUPLESIZE);
+	HeapTuple	tuple = (HeapTuple) MemoryContextAlloc(state->tuplecontext,
+													  t_len + HEAPTUPLESIZE);
 
 	USEMEM(state, GetMemoryChunkSpace(tuple));
 	/* Reconstruct the HeapTupleData header */
@@ -3683,6 +4242,75 @@ comparetup_index_hash(const SortTuple *a, const SortTuple *b,
 	return 0;
 }
 
+/*
+ * The GIN case sorts entry tuples as made by the parallel GIN build: the key,
+ * in the index's own tuple format, and a compressed posting list.  They are
+ * ordered by attribute number, null category and key, as in the index, and
+ * then by first heap TID.  The index's tuple descriptor describes the indexed
+ * columns rather than these tuples, so there is no leading key to cache in
+ * datum1.
+ */
+static int
+comparetup_index_gin(const SortTuple *a, const SortTuple *b,
+					 Tuplesortstate *state)
+{
+	GinState   *ginstate = state->ginstate;
+	IndexTuple	tuple1 = (IndexTuple) a->tuple;
+	IndexTuple	tuple2 = (IndexTuple) b->tuple;
+	Datum		key1,
+				key2;
+	GinNullCategory category1,
+				category2;
+	int			compare;
+
+	key1 = gintuple_get_key(ginstate, tuple1, &category1);
+	key2 = gintuple_get_key(ginstate, tuple2, &category2);
+	compare = ginCompareAttEntries(ginstate,
+								   gintuple_get_attrnum(ginstate, tuple1),
+								   key1, category1,
+								   gintuple_get_attrnum(ginstate, tuple2),
+								   key2, category2);
+	if (compare != 0)
+		return compare;
+
+	return ginCompareItemPointers(&((GinPostingList *) GinGetPosting(tuple1))->first,
+								  &((GinPostingList *) GinGetPosting(tuple2))->first);
+}
+
+static void
+copytup_index_gin(Tuplesortstate *state, SortTuple *stup, void *tup)
+{
+	IndexTuple	tuple = (IndexTuple) tup;
+	unsigned int tuplen = IndexTupleSize(tuple);
+	IndexTuple	newtuple;
+
+	newtuple = (IndexTuple) MemoryContextAlloc(state->tuplecontext, tuplen);
+	memcpy(newtuple, tuple, tuplen);
+	USEMEM(state, GetMemoryChunkSpace(newtuple));
+	stup->tuple = (void *) newtuple;
+	stup->datum1 = (Datum) 0;
+	stup->isnull1 = false;
+}
+
+static void
+readtup_index_gin(Tuplesortstate *state, SortTuple *stup,
+				  int tapenum, unsigned int len)
+{
+	unsigned int tuplen = len - sizeof(unsigned int);
+	IndexTuple	tuple = (IndexTuple) MemoryContextAlloc(state->tuplecontext,
+													   tuplen);
+
+	USEMEM(state, GetMemoryChunkSpace(tuple));
+	LogicalTapeReadExact(state->tapeset, tapenum,
+						 tuple, tuplen);
+	if (state->randomAccess)	/* need trailing length word? */
+		LogicalTapeReadExact(state->tapeset, tapenum,
+							 &tuplen, sizeof(tuplen));
+	stup->tuple = (void *) tuple;
+	stup->datum1 = (Datum) 0;
+	stup->isnull1 = false;
+}
+
 static void
 copytup_index(Tuplesortstate *state, SortTuple *stup, void *tup)
 {
@@ -3692,7 +4320,7 @@ copytup_index(Tuplesortstate *state, SortTuple *stup, void *tup)
 	Datum		original;
 
 	/* copy the tuple into sort storage */
-	newtuple = (IndexTuple) palloc(tuplen);
+	newtuple = (IndexTuple) MemoryContextAlloc(state->tuplecontext, tuplen);
 	memcpy(newtuple, tuple, tuplen);
 	USEMEM(state, GetMemoryChunkSpace(newtuple));
 	stup->tuple = (void *) newtuple;
@@ -3773,7 +4401,8 @@ readtup_index(Tuplesortstate *state, SortTuple *stup,
 			  int tapenum, unsigned int len)
 {
 	unsigned int tuplen = len - sizeof(unsigned int);
-	IndexTuple	tuple = (IndexTuple) palloc(tuplen);
+	IndexTuple	tuple = (IndexTuple) MemoryContextAlloc(state->tuplecontext,
+													   tuplen);
 
 	USEMEM(state, GetMemoryChunkSpace(tuple));
 	LogicalTapeReadExact(state->tapeset, tapenum,
@@ -3885,7 +4514,7 @@ readtup_datum(Tuplesortstate *state, SortTuple *stup,
 	}
 	else
 	{
-		void	   *raddr = palloc(tuplen);
+		void	   *raddr = MemoryContextAlloc(state->tuplecontext, tuplen);
 
 		LogicalTapeReadExact(state->tapeset, tapenum,
 							 raddr, tuplen);
@@ -262,7 +262,13 @@ tuplestore_begin_common(int eflags, bool interXact, int maxKBytes)
 	state->allowedMem = maxKBytes * 1024L;
 	state->availMem = state->allowedMem;
 	state->myfile = NULL;
-	state->context = CurrentMemoryContext;
+	/*
+	 * Tuples are freed in the order they were stored when the tuplestore is
+	 * trimmed, or all at once, so a generation context suits them.
+	 */
+	state->context = GenerationContextCreate(CurrentMemoryContext,
+											 "Tuplestore tuples",
+											 GENERATION_DEFAULT_BLOCK_SIZE);
 	state->resowner = CurrentResourceOwner;
 
 	state->memtupdeleted = 0;
@@ -449,16 +455,11 @@ tuplestore_clear(Tuplestorestate *state)
 void
 tuplestore_end(Tuplestorestate *state)
 {
-	int			i;
-
 	if (state->myfile)
 		BufFileClose(state->myfile);
+	MemoryContextDelete(state->context);
 	if (state->memtuples)
-	{
-		for (i = state->memtupdeleted; i < state->memtupcount; i++)
-			pfree(state->memtuples[i]);
 		pfree(state->memtuples);
-	}
 	pfree(state->readptrs);
 	pfree(state);
 }
@@ -62,6 +62,7 @@ static char *label = "pg_basebackup base backup";
 static bool showprogress = false;
 static int	verbose = 0;
 static int	compresslevel = 0;
+static char *server_compression = NULL;		/* gzip/zstd, done by server */
 static bool includewal = false;
 static bool streamwal = false;
 static bool fastcheckpoint = false;
@@ -248,6 +249,8 @@ usage(void)
 	printf(_("      --xlogdir=XLOGDIR  location for the transaction log directory\n"));
 	printf(_("  -z, --gzip             compress tar output\n"));
 	printf(_("  -Z, --compress=0-9     compress tar output with given compression level\n"));
+	printf(_("      --server-compress=gzip|zstd\n"
+			 "                         have the server compress tar output with given method\n"));
 	printf(_("\nGeneral options:\n"));
 	printf(_("  -c, --checkpoint=fast|spread\n"
 			 "                         set fast or spread checkpointing\n"));
@@ -763,10 +766,11 @@ writeTarData(
 /*
  * Receive a tar format file from the connection to the server, and write
  * the data from this file directly into a tar file. If compression is
- * enabled, the data will be compressed while written to the file.
+ * enabled, the data will be compressed while written to the file. If the
+ * server compresses the data, it is written out as received.
  *
- * The file will be named base.tar[.gz] if it's for the main data directory
- * or <tablespaceoid>.tar[.gz] if it's for another tablespace.
+ * The file will be named base.tar[.gz|.zst] if it's for the main data
+ * directory or <tablespaceoid>.tar[.gz|.zst] if it's for another tablespace.
  *
  * No attempt to inspect or validate the contents of the file is done.
  */
@@ -778,6 +782,7 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 	FILE	   *tarfile = NULL;
 	char		tarhdr[512];
 	bool		basetablespace = PQgetisnull(res, rownum, 0);
+	const char *suffix = "";
 	bool		in_tarhdr = true;
 	bool		skip_file = false;
 	size_t		tarhdrsz = 0;
@@ -787,6 +792,9 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 	gzFile		ztarfile = NULL;
 #endif
 
+	if (server_compression != NULL)
+		suffix = strcmp(server_compression, "zstd") == 0 ? ".zst" : ".gz";
+
 	if (basetablespace)
 	{
 		/*
@@ -831,7 +839,8 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 			else
 #endif
 			{
-				snprintf(filename, sizeof(filename), "%s/base.tar", basedir);
+				snprintf(filename, sizeof(filename), "%s/base.tar%s",
+						 basedir, suffix);
 				tarfile = fopen(filename, "wb");
 			}
 		}
@@ -859,8 +868,8 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 		else
 #endif
 		{
-			snprintf(filename, sizeof(filename), "%s/%s.tar", basedir,
-					 PQgetvalue(res, rownum, 0));
+			snprintf(filename, sizeof(filename), "%s/%s.tar%s", basedir,
+					 PQgetvalue(res, rownum, 0), suffix);
 			tarfile = fopen(filename, "wb");
 		}
 	}
@@ -919,7 +928,8 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 			 * (but not stdout).
 			 *
 			 * Also, write two completely empty blocks at the end of the tar
-			 * file, as required by some tar programs.
+			 * file, as required by some tar programs.  A stream compressed by
+			 * the server already ends with them.
 			 */
 			char		zerobuf[1024];
 
@@ -944,7 +954,8 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 			}
 
 			/* 2 * 512 bytes empty data at end of file */
-			WRITE_TAR_DATA(zerobuf, sizeof(zerobuf));
+			if (server_compression == NULL)
+				WRITE_TAR_DATA(zerobuf, sizeof(zerobuf));
 
 #ifdef HAVE_LIBZ
 			if (ztarfile != NULL)
@@ -1581,6 +1592,7 @@ BaseBackup(void)
 	char	   *basebkp;
 	char		escaped_label[MAXPGPATH];
 	char	   *maxrate_clause = NULL;
+	char	   *compression_clause = NULL;
 	int			i;
 	char		xlogstart[64];
 	char		xlogend[64];
@@ -1642,15 +1654,19 @@ BaseBackup(void)
 	if (maxrate > 0)
 		maxrate_clause = psprintf("MAX_RATE %u", maxrate);
 
+	if (server_compression != NULL)
+		compression_clause = psprintf("COMPRESSION '%s'", server_compression);
+
 	basebkp =
-		psprintf("BASE_BACKUP LABEL '%s' %s %s %s %s %s %s",
+		psprintf("BASE_BACKUP LABEL '%s' %s %s %s %s %s %s %s",
 				 escaped_label,
 				 showprogress ? "PROGRESS" : "",
 				 includewal && !streamwal ? "WAL" : "",
 				 fastcheckpoint ? "FAST" : "",
 				 includewal ? "NOWAIT" : "",
 				 maxrate_clause ? maxrate_clause : "",
-				 format == 't' ? "TABLESPACE_MAP" : "");
+				 format == 't' ? "TABLESPACE_MAP" : "",
+				 compression_clause ? compression_clause : "");
 
 	if (PQsendQuery(conn, basebkp) == 0)
 	{
@@ -1946,6 +1962,7 @@ main(int argc, char **argv)
 		{"verbose", no_argument, NULL, 'v'},
 		{"progress", no_argument, NULL, 'P'},
 		{"xlogdir", required_argument, NULL, 1},
+		{"server-compress", required_argument, NULL, 2},
 		{NULL, 0, NULL, 0}
 	};
 	int			c;
@@ -2039,6 +2056,16 @@ main(int argc, char **argv)
 			case 1:
 				xlog_dir = pg_strdup(optarg);
 				break;
+			case 2:
+				if (strcmp(optarg, "gzip") != 0 && strcmp(optarg, "zstd") != 0)
+				{
+					fprintf(stderr,
+							_("%s: invalid server compression method \"%s\", must be \"gzip\" or \"zstd\"\n"),
+							progname, optarg);
+					exit(1);
+				}
+				server_compression = pg_strdup(optarg);
+				break;
 			case 'l':
 				label = pg_strdup(optarg);
 				break;
@@ -2151,6 +2178,37 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (server_compression != NULL)
+	{
+		if (format == 'p')
+		{
+			fprintf(stderr,
+					_("%s: only tar mode backups can be compressed\n"),
+					progname);
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+		if (compresslevel != 0)
+		{
+			fprintf(stderr,
+					_("%s: --server-compress cannot be used together with --gzip or --compress\n"),
+					progname);
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+		if (writerecoveryconf)
+		{
+			fprintf(stderr,
+					_("%s: --server-compress cannot be used together with --write-recovery-conf\n"),
+					progname);
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+	}
+
 	if (format != 'p' && streamwal)
 	{
 		fprintf(stderr,
@@ -3,7 +3,7 @@ use warnings;
 use Cwd;
 use Config;
 use TestLib;
-use Test::More tests => 46;
+use Test::More tests => 49;
 
 program_help_ok('pg_basebackup');
 program_version_ok('pg_basebackup');
@@ -79,6 +79,19 @@ command_fails(
 	[ 'pg_basebackup', '-D', "$tempdir/backup_foo", '-Fp', "-Tfoo" ],
 	'-T with invalid format fails');
 
+command_fails(
+	[   'pg_basebackup', '-D', "$tempdir/backup_foo", '-Ft',
+		'--server-compress=lzma' ],
+	'--server-compress with unknown method fails');
+command_fails(
+	[   'pg_basebackup', '-D', "$tempdir/backup_foo", '-Fp',
+		'--server-compress=gzip' ],
+	'--server-compress in plain mode fails');
+command_fails(
+	[   'pg_basebackup', '-D', "$tempdir/backup_foo", '-Ft', '-z',
+		'--server-compress=gzip' ],
+	'--server-compress with --gzip fails');
+
 # Tar format doesn't support filenames longer than 100 bytes.
 my $superlongname = "superlongname_" . ("x" x 100);
 my $superlongpath = "$tempdir/pgdata/$superlongname";
@@ -853,6 +853,7 @@ WaitForCommands(ArchiveHandle *AH, int pipefd[2])
 {
 	char	   *command;
 	DumpId		dumpId;
+	int			maintenanceWorkMem;
 	int			nBytes;
 	char	   *str = NULL;
 	TocEntry   *te;
@@ -899,11 +900,13 @@ WaitForCommands(ArchiveHandle *AH, int pipefd[2])
 			Assert(AH->format == archDirectory || AH->format == archCustom);
 			Assert(AH->connection != NULL);
 
-			sscanf(command + strlen("RESTORE "), "%d%n", &dumpId, &nBytes);
+			sscanf(command + strlen("RESTORE "), "%d %d%n", &dumpId,
+				   &maintenanceWorkMem, &nBytes);
 			Assert(nBytes == strlen(command) - strlen("RESTORE "));
 
 			te = getTocEntryByDumpId(AH, dumpId);
 			Assert(te != NULL);
+			te->maintenanceWorkMem = maintenanceWorkMem;
 
 			/*
 			 * The message we return here has been pg_malloc()ed and we are
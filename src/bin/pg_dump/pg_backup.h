@@ -116,6 +116,8 @@ typedef struct _restoreOptions
 
 	bool	   *idWanted;		/* array showing which dump IDs to emit */
 	int			enable_row_security;
+	int			index_memory;	/* MB of maintenance_work_mem to share among
+								 * parallel index builds, or 0 */
 } RestoreOptions;
 
 typedef struct _dumpOptions
@@ -149,6 +151,7 @@ typedef struct _dumpOptions
 	int			outputNoTablespaces;
 	int			use_setsessauth;
 	int			enable_row_security;
+	int			chunk_size;		/* split table data larger than this, in MB */
 
 	/* default, if no "inclusion" switches appear, is to dump everything */
 	bool		include_everything;
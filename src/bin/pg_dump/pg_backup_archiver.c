@@ -92,6 +92,13 @@ static void restore_toc_entries_postfork(ArchiveHandle *AH, TocEntry *pending_li
 static void par_list_header_init(TocEntry *l);
 static void par_list_append(TocEntry *l, TocEntry *te);
 static void par_list_remove(TocEntry *te);
+static void ready_list_insert(TocEntry *ready_list, TocEntry *te);
+static void ready_list_sort(TocEntry *ready_list);
+static int	ready_list_cmp(const void *a, const void *b);
+static void estimate_work_sizes(ArchiveHandle *AH);
+static bool builds_index(TocEntry *te);
+static int grant_index_memory(ArchiveHandle *AH, TocEntry *ready_list,
+				   ParallelState *pstate);
 static TocEntry *get_next_work_item(ArchiveHandle *AH,
 				   TocEntry *ready_list,
 				   ParallelState *pstate);
@@ -2685,7 +2692,8 @@ _tocEntryRequired(TocEntry *te, teSection curSection, RestoreOptions *ropt)
 	if (ropt->selTypes)
 	{
 		if (strcmp(te->desc, "TABLE") == 0 ||
-			strcmp(te->desc, "TABLE DATA") == 0)
+			strcmp(te->desc, "TABLE DATA") == 0 ||
+			strcmp(te->desc, "TABLE DATA CHUNK") == 0)
 		{
 			if (!ropt->selTable)
 				return 0;
@@ -3126,6 +3134,7 @@ _getObjectDescription(PQExpBuffer buf, TocEntry *te, ArchiveHandle *AH)
 		strcmp(type, "TABLE") == 0 ||
 		strcmp(type, "TYPE") == 0 ||
 		strcmp(type, "FOREIGN TABLE") == 0 ||
+		strcmp(type, "STATISTICS") == 0 ||
 		strcmp(type, "TEXT SEARCH DICTIONARY") == 0 ||
 		strcmp(type, "TEXT SEARCH CONFIGURATION") == 0 ||
 	/* non-schema-specified objects */
@@ -3134,6 +3143,8 @@ _getObjectDescription(PQExpBuffer buf, TocEntry *te, ArchiveHandle *AH)
 		strcmp(type, "SCHEMA") == 0 ||
 		strcmp(type, "FOREIGN DATA WRAPPER") == 0 ||
 		strcmp(type, "SERVER") == 0 ||
+		strcmp(type, "PUBLICATION") == 0 ||
+		strcmp(type, "SUBSCRIPTION") == 0 ||
 		strcmp(type, "USER MAPPING") == 0)
 	{
 		/* We already know that search_path was set properly */
@@ -3334,10 +3345,13 @@ _printTocEntry(ArchiveHandle *AH, TocEntry *te, bool isData, bool acl_pass)
 			strcmp(te->desc, "MATERIALIZED VIEW") == 0 ||
 			strcmp(te->desc, "SEQUENCE") == 0 ||
 			strcmp(te->desc, "FOREIGN TABLE") == 0 ||
+			strcmp(te->desc, "STATISTICS") == 0 ||
 			strcmp(te->desc, "TEXT SEARCH DICTIONARY") == 0 ||
 			strcmp(te->desc, "TEXT SEARCH CONFIGURATION") == 0 ||
 			strcmp(te->desc, "FOREIGN DATA WRAPPER") == 0 ||
-			strcmp(te->desc, "SERVER") == 0)
+			strcmp(te->desc, "SERVER") == 0 ||
+			strcmp(te->desc, "PUBLICATION") == 0 ||
+			strcmp(te->desc, "SUBSCRIPTION") == 0)
 		{
 			PQExpBuffer temp = createPQExpBuffer();
 
@@ -3357,6 +3371,7 @@ _printTocEntry(ArchiveHandle *AH, TocEntry *te, bool isData, bool acl_pass)
 				 strcmp(te->desc, "TRIGGER") == 0 ||
 				 strcmp(te->desc, "ROW SECURITY") == 0 ||
 				 strcmp(te->desc, "POLICY") == 0 ||
+				 strcmp(te->desc, "PUBLICATION TABLE") == 0 ||
 				 strcmp(te->desc, "USER MAPPING") == 0)
 		{
 			/* these object types don't have separate owners */
@@ -3703,7 +3718,13 @@ restore_toc_entries_parallel(ArchiveHandle *AH, ParallelState *pstate,
 	 * aren't going to be restored. They might participate in dependency
 	 * chains connecting entries that should be restored, so we treat them as
 	 * live until we actually process them.
+	 *
+	 * The ready list is kept in decreasing order of estimated work, so that
+	 * the big tables, and the indexes on them, are started first and the
+	 * small items fill in around them, rather than one worker being left
+	 * with a big item at the end.
 	 */
+	estimate_work_sizes(AH);
 	par_list_header_init(&ready_list);
 	skipped_some = false;
 	for (next_work_item = AH->toc->next; next_work_item != AH->toc; next_work_item = next_work_item->next)
@@ -3732,6 +3753,7 @@ restore_toc_entries_parallel(ArchiveHandle *AH, ParallelState *pstate,
 		else
 			par_list_append(&ready_list, next_work_item);
 	}
+	ready_list_sort(&ready_list);
 
 	/*
 	 * main parent loop
@@ -3765,6 +3787,16 @@ restore_toc_entries_parallel(ArchiveHandle *AH, ParallelState *pstate,
 				  next_work_item->dumpId,
 				  next_work_item->desc, next_work_item->tag);
 
+			if (AH->public__.ropt->index_memory > 0 &&
+				builds_index(next_work_item))
+			{
+				next_work_item->maintenanceWorkMem =
+					grant_index_memory(AH, &ready_list, pstate);
+				ahlog(AH, 2, "giving %d kB of memory to item %d\n",
+					  next_work_item->maintenanceWorkMem,
+					  next_work_item->dumpId);
+			}
+
 			par_list_remove(next_work_item);
 
 			Assert(GetIdleWorker(pstate) != NO_SLOT);
@@ -3909,6 +3941,177 @@ par_list_remove(TocEntry *te)
 	te->par_next = NULL;
 }
 
+/*
+ * Add te to the ready list, after all the items with at least as much work.
+ */
+static void
+ready_list_insert(TocEntry *ready_list, TocEntry *te)
+{
+	TocEntry   *pos;
+
+	/* the usual case, when there's nothing to go on, is quick */
+	if (ready_list->par_prev == ready_list ||
+		ready_list->par_prev->workSize >= te->workSize)
+	{
+		par_list_append(ready_list, te);
+		return;
+	}
+
+	for (pos = ready_list->par_next; pos != ready_list; pos = pos->par_next)
+	{
+		if (pos->workSize < te->workSize)
+			break;
+	}
+
+	/* insert before pos */
+	te->par_prev = pos->par_prev;
+	te->par_next = pos;
+	pos->par_prev->par_next = te;
+	pos->par_prev = te;
+}
+
+typedef struct
+{
+	TocEntry   *te;
+	int			pos;			/* position in the list, to keep ties in order */
+} ReadyListItem;
+
+/*
+ * Sort the ready list into decreasing order of work, keeping items of equal
+ * work in the order they were in.
+ */
+static void
+ready_list_sort(TocEntry *ready_list)
+{
+	ReadyListItem *items;
+	TocEntry   *te;
+	int			n = 0;
+	int			i;
+
+	for (te = ready_list->par_next; te != ready_list; te = te->par_next)
+		n++;
+	if (n < 2)
+		return;
+
+	items = (ReadyListItem *) pg_malloc(n * sizeof(ReadyListItem));
+	for (te = ready_list->par_next, i = 0; te != ready_list; te = te->par_next, i++)
+	{
+		items[i].te = te;
+		items[i].pos = i;
+	}
+	qsort(items, n, sizeof(ReadyListItem), ready_list_cmp);
+
+	par_list_header_init(ready_list);
+	for (i = 0; i < n; i++)
+		par_list_append(ready_list, items[i].te);
+
+	free(items);
+}
+
+static int
+ready_list_cmp(const void *a, const void *b)
+{
+	const ReadyListItem *ia = (const ReadyListItem *) a;
+	const ReadyListItem *ib = (const ReadyListItem *) b;
+
+	if (ia->te->workSize != ib->te->workSize)
+		return (ia->te->workSize > ib->te->workSize) ? -1 : 1;
+	return ia->pos - ib->pos;
+}
+
+/*
+ * Estimate how much work each item is, for ordering the ready list.
+ *
+ * For a data item that is the size of its data in the archive, if the format
+ * knows it.  For a post-data item, such as an index, it is the size of the
+ * data of the tables it depends on, since building an index or checking a
+ * constraint means reading the table.  Everything else counts as no work.
+ * This must be called after fix_dependencies, so that the dependencies of
+ * post-data items point at the TABLE DATA items.
+ */
+static void
+estimate_work_sizes(ArchiveHandle *AH)
+{
+	TocEntry   *te;
+	int			i;
+
+	for (te = AH->toc->next; te != AH->toc; te = te->next)
+	{
+		te->workSize = 0;
+		if (te->section == SECTION_DATA)
+			te->workSize = te->dataLength;
+		else if (te->section == SECTION_POST_DATA)
+		{
+			for (i = 0; i < te->nDeps; i++)
+			{
+				DumpId		depid = te->dependencies[i];
+				TocEntry   *dep;
+
+				if (depid > AH->maxDumpId)
+					continue;
+				dep = AH->tocsByDumpId[depid];
+				if (dep != NULL && dep->section == SECTION_DATA)
+					te->workSize += dep->dataLength;
+			}
+		}
+	}
+}
+
+/*
+ * Does restoring te build an index, and so use maintenance_work_mem?
+ * Primary key, unique and exclusion constraints are CONSTRAINT items;
+ * check and foreign key constraints have their own descriptions.
+ */
+static bool
+builds_index(TocEntry *te)
+{
+	return (strcmp(te->desc, "INDEX") == 0 ||
+			strcmp(te->desc, "CONSTRAINT") == 0);
+}
+
+/*
+ * Decide how much of the --index-memory budget, in kB, to give the index
+ * build that is about to be launched.
+ *
+ * What the running index builds haven't got is shared evenly among as many
+ * builds as could start now: there are no more of those than idle workers,
+ * nor than ready items that build indexes, counting the one being launched.
+ * So an index build that runs alone gets the whole budget, and several on
+ * the same big table split it.  Every build gets at least 1MB, the least
+ * maintenance_work_mem can be, even if that goes over the budget.
+ */
+static int
+grant_index_memory(ArchiveHandle *AH, TocEntry *ready_list,
+				   ParallelState *pstate)
+{
+	int			budget = AH->public__.ropt->index_memory * 1024;
+	int			nidle = 0;
+	int			nready = 0;
+	int			nshares;
+	TocEntry   *te;
+	int			i;
+
+	for (i = 0; i < pstate->numWorkers; i++)
+	{
+		ParallelSlot *slot = &pstate->parallelSlot[i];
+
+		if (slot->workerStatus == WRKR_WORKING)
+			budget -= slot->args->te->maintenanceWorkMem;
+		else if (slot->workerStatus == WRKR_IDLE)
+			nidle++;
+	}
+
+	for (te = ready_list->par_next; te != ready_list; te = te->par_next)
+	{
+		if (builds_index(te))
+			nready++;
+	}
+
+	nshares = Max(Min(nidle, nready), 1);
+
+	return Max(budget / nshares, 1024);
+}
+
 
 /*
  * Find the next work item (if any) that is capable of being run now.
@@ -4021,6 +4224,16 @@ parallel_restore(ParallelArgs *args)
 
 	AH->public__.n_errors = 0;
 
+	/* Use the memory the master gave an index build, see grant_index_memory */
+	if (te->maintenanceWorkMem > 0)
+	{
+		char		buf[64];
+
+		snprintf(buf, sizeof(buf), "SET maintenance_work_mem = '%dkB'",
+				 te->maintenanceWorkMem);
+		ExecuteSqlStatement(&AH->public__, buf);
+	}
+
 	/* Restore the TOC item */
 	status = restore_toc_entry(AH, te, true);
 
@@ -4201,15 +4414,27 @@ fix_dependencies(ArchiveHandle *AH)
 
 /*
  * Change dependencies on table items to depend on table data items instead,
- * but only in POST_DATA items.
+ * but only in POST_DATA items.  If the table's data was dumped in chunks,
+ * the item must wait for all the TABLE DATA CHUNK items too.
  */
 static void
 repoint_table_dependencies(ArchiveHandle *AH)
 {
 	TocEntry   *te;
+	TocEntry   *chunk;
+	bool	   *hasChunks;
 	int			i;
 	DumpId		olddep;
 
+	/* note the tables whose data is split, to save searching for the rest */
+	hasChunks = (bool *) pg_malloc0((AH->maxDumpId + 1) * sizeof(bool));
+	for (te = AH->toc->next; te != AH->toc; te = te->next)
+	{
+		if (strcmp(te->desc, "TABLE DATA CHUNK") == 0 && te->nDeps > 0 &&
+			te->dependencies[0] > 0 && te->dependencies[0] <= AH->maxDumpId)
+			hasChunks[te->dependencies[0]] = true;
+	}
+
 	for (te = AH->toc->next; te != AH->toc; te = te->next)
 	{
 		if (te->section != SECTION_POST_DATA)
@@ -4223,9 +4448,27 @@ repoint_table_dependencies(ArchiveHandle *AH)
 				te->dependencies[i] = AH->tableDataId[olddep];
 				ahlog(AH, 2, "transferring dependency %d -> %d to %d\n",
 					  te->dumpId, olddep, AH->tableDataId[olddep]);
+
+				if (!hasChunks[olddep])
+					continue;
+				for (chunk = AH->toc->next; chunk != AH->toc; chunk = chunk->next)
+				{
+					if (strcmp(chunk->desc, "TABLE DATA CHUNK") != 0 ||
+						chunk->dependencies[0] != olddep)
+						continue;
+					te->dependencies = (DumpId *)
+						pg_realloc(te->dependencies,
+								   (te->nDeps + 1) * sizeof(DumpId));
+					te->dependencies[te->nDeps++] = chunk->dumpId;
+					te->depCount++;
+					ahlog(AH, 2, "adding dependency %d -> %d\n",
+						  te->dumpId, chunk->dumpId);
+				}
 			}
 		}
 	}
+
+	free(hasChunks);
 }
 
 /*
@@ -4306,7 +4549,7 @@ reduce_dependencies(ArchiveHandle *AH, TocEntry *te, TocEntry *ready_list)
 			/* It must be in the pending list, so remove it ... */
 			par_list_remove(otherte);
 			/* ... and add to ready_list */
-			par_list_append(ready_list, otherte);
+			ready_list_insert(ready_list, otherte);
 		}
 	}
 }
@@ -4333,15 +4576,24 @@ mark_create_done(ArchiveHandle *AH, TocEntry *te)
 static void
 inhibit_data_for_failed_table(ArchiveHandle *AH, TocEntry *te)
 {
+	TocEntry   *ted;
+
 	ahlog(AH, 1, "table \"%s\" could not be created, will not restore its data\n",
 		  te->tag);
 
 	if (AH->tableDataId[te->dumpId] != 0)
 	{
-		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
-
+		ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 		ted->reqs = 0;
 	}
+
+	/* likewise for the rest of the data, if it was dumped in chunks */
+	for (ted = AH->toc->next; ted != AH->toc; ted = ted->next)
+	{
+		if (strcmp(ted->desc, "TABLE DATA CHUNK") == 0 &&
+			ted->dependencies[0] == te->dumpId)
+			ted->reqs = 0;
+	}
 }
 
 /*
@@ -357,6 +357,8 @@ struct _tocEntry
 	DataDumperPtr dataDumper;	/* Routine to dump data for object */
 	void	   *dataDumperArg;	/* Arg for above routine */
 	void	   *formatData;		/* TOC Entry data specific to file format */
+	pgoff_t		dataLength;		/* size of the item's data in the archive, if
+								 * the format can tell; else 0 */
 
 	/* working state while dumping/restoring */
 	teReqs		reqs;			/* do we need schema and/or data of object */
@@ -370,6 +372,9 @@ struct _tocEntry
 	int			nRevDeps;		/* number of such dependencies */
 	DumpId	   *lockDeps;		/* dumpIds of objects this one needs lock on */
 	int			nLockDeps;		/* number of such dependencies */
+	pgoff_t		workSize;		/* estimated amount of work, see
+								 * estimate_work_sizes() */
+	int			maintenanceWorkMem;		/* kB granted to an index build, or 0 */
 };
 
 extern int	parallel_restore(struct ParallelArgs *args);
@@ -25,6 +25,8 @@
  */
 #include "postgres_fe.h"
 
+#include <sys/stat.h>
+
 #include "compress_io.h"
 #include "parallel.h"
 #include "pg_backup_utils.h"
@@ -86,6 +88,8 @@ typedef struct
  */
 static void _readBlockHeader(ArchiveHandle *AH, int *type, int *id);
 static pgoff_t _getFilePos(ArchiveHandle *AH, lclContext *ctx);
+static void _setDataLengths(ArchiveHandle *AH);
+static int	_dataPosCmp(const void *a, const void *b);
 
 static void _CustomWriteFunc(ArchiveHandle *AH, const char *buf, size_t len);
 static size_t _CustomReadFunc(ArchiveHandle *AH, char **buf, size_t *buflen);
@@ -194,6 +198,9 @@ InitArchiveFmt_Custom(ArchiveHandle *AH)
 		ReadHead(AH);
 		ReadToc(AH);
 		ctx->dataStart = _getFilePos(AH, ctx);
+
+		if (ctx->hasSeek)
+			_setDataLengths(AH);
 	}
 
 }
@@ -851,7 +858,8 @@ _MasterStartParallelItem(ArchiveHandle *AH, TocEntry *te, T_Action act)
 	/* no parallel dump in the custom archive format */
 	Assert(act == ACT_RESTORE);
 
-	snprintf(buf, sizeof(buf), "RESTORE %d", te->dumpId);
+	snprintf(buf, sizeof(buf), "RESTORE %d %d", te->dumpId,
+			 te->maintenanceWorkMem);
 
 	return buf;
 }
@@ -916,6 +924,59 @@ _getFilePos(ArchiveHandle *AH, lclContext *ctx)
 	return pos;
 }
 
+/*
+ * Work out the size of each TOC entry's data from the offsets of the data
+ * blocks, which follow one another in the file.  Parallel restore uses the
+ * sizes to decide what to start first.
+ */
+static void
+_setDataLengths(ArchiveHandle *AH)
+{
+	TocEntry  **tes;
+	int			ntes = 0;
+	TocEntry   *te;
+	struct stat st;
+	int			i;
+
+	tes = (TocEntry **) pg_malloc(AH->tocCount * sizeof(TocEntry *));
+	for (te = AH->toc->next; te != AH->toc; te = te->next)
+	{
+		lclTocEntry *tctx = (lclTocEntry *) te->formatData;
+
+		if (tctx->dataState == K_OFFSET_POS_SET)
+			tes[ntes++] = te;
+	}
+
+	if (ntes > 0 && fstat(fileno(AH->FH), &st) == 0)
+	{
+		qsort(tes, ntes, sizeof(TocEntry *), _dataPosCmp);
+		for (i = 0; i < ntes; i++)
+		{
+			pgoff_t		start = ((lclTocEntry *) tes[i]->formatData)->dataPos;
+			pgoff_t		end;
+
+			if (i + 1 < ntes)
+				end = ((lclTocEntry *) tes[i + 1]->formatData)->dataPos;
+			else
+				end = st.st_size;
+			tes[i]->dataLength = end - start;
+		}
+	}
+
+	free(tes);
+}
+
+static int
+_dataPosCmp(const void *a, const void *b)
+{
+	pgoff_t		pa = ((lclTocEntry *) (*(TocEntry *const *) a)->formatData)->dataPos;
+	pgoff_t		pb = ((lclTocEntry *) (*(TocEntry *const *) b)->formatData)->dataPos;
+
+	if (pa < pb)
+		return -1;
+	return (pa > pb) ? 1 : 0;
+}
+
 /*
  * Read a data block header. The format changed in V1.3, so we
  * centralize the code here for simplicity.  Returns *type = EOF
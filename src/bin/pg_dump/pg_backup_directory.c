@@ -303,6 +303,23 @@ _ReadExtraToc(ArchiveHandle *AH, TocEntry *te)
 		free(tctx->filename);
 		tctx->filename = NULL;
 	}
+
+	/*
+	 * Note the size of the data file, which parallel restore uses to decide
+	 * what to start first.  It's the compressed size if the file was
+	 * compressed, but that's good enough for comparing items.
+	 */
+	if (tctx->filename && strcmp(te->desc, "BLOBS") != 0)
+	{
+		char		fname[MAXPGPATH];
+		struct stat st;
+
+		setFilePath(AH, fname, tctx->filename);
+		if (stat(fname, &st) == 0 ||
+			(strlcat(fname, ".gz", MAXPGPATH) < MAXPGPATH &&
+			 stat(fname, &st) == 0))
+			te->dataLength = st.st_size;
+	}
 }
 
 /*
@@ -774,7 +791,8 @@ _MasterStartParallelItem(ArchiveHandle *AH, TocEntry *te, T_Action act)
 	if (act == ACT_DUMP)
 		snprintf(buf, sizeof(buf), "DUMP %d", te->dumpId);
 	else if (act == ACT_RESTORE)
-		snprintf(buf, sizeof(buf), "RESTORE %d", te->dumpId);
+		snprintf(buf, sizeof(buf), "RESTORE %d %d", te->dumpId,
+				 te->maintenanceWorkMem);
 
 	return buf;
 }
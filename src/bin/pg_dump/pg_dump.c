@@ -182,6 +182,7 @@ static void dumpAttrDef(Archive *fout, AttrDefInfo *adinfo);
 static void dumpSequence(Archive *fout, TableInfo *tbinfo);
 static void dumpSequenceData(Archive *fout, TableDataInfo *tdinfo);
 static void dumpIndex(Archive *fout, IndxInfo *indxinfo);
+static void dumpStatisticsExt(Archive *fout, StatsExtInfo *statsextinfo);
 static void dumpConstraint(Archive *fout, ConstraintInfo *coninfo);
 static void dumpTableConstraintComment(Archive *fout, ConstraintInfo *coninfo);
 static void dumpTSParser(Archive *fout, TSParserInfo *prsinfo);
@@ -211,6 +212,7 @@ static void addBoundaryDependencies(DumpableObject **dobjs, int numObjs,
 
 static void getDomainConstraints(Archive *fout, TypeInfo *tyinfo);
 static void getTableData(DumpOptions *dopt, TableInfo *tblinfo, int numTables, bool oids);
+static void getTableDataChunks(Archive *fout);
 static void makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo, bool oids);
 static void buildMatViewRefreshDependencies(Archive *fout);
 static void getTableDataFKConstraints(void);
@@ -236,6 +238,9 @@ static void getBlobs(Archive *fout);
 static void dumpBlob(Archive *fout, BlobInfo *binfo);
 static int	dumpBlobs(Archive *fout, void *arg);
 static void dumpPolicy(Archive *fout, PolicyInfo *polinfo);
+static void dumpPublication(Archive *fout, PublicationInfo *pubinfo);
+static void dumpPublicationTable(Archive *fout, PublicationRelInfo *pubrinfo);
+static void dumpSubscription(Archive *fout, SubscriptionInfo *subinfo);
 static void dumpDatabase(Archive *AH);
 static void dumpEncoding(Archive *AH);
 static void dumpStdStrings(Archive *AH);
@@ -327,6 +332,7 @@ main(int argc, char **argv)
 		{"disable-triggers", no_argument, &dopt.disable_triggers, 1},
 		{"enable-row-security", no_argument, &dopt.enable_row_security, 1},
 		{"exclude-table-data", required_argument, NULL, 4},
+		{"chunk-size", required_argument, NULL, 7},
 		{"if-exists", no_argument, &dopt.if_exists, 1},
 		{"inserts", no_argument, &dopt.dump_inserts, 1},
 		{"lock-wait-timeout", required_argument, NULL, 2},
@@ -520,6 +526,15 @@ main(int argc, char **argv)
 				dumpsnapshot = pg_strdup(optarg);
 				break;
 
+			case 7:				/* chunk size */
+				dopt.chunk_size = atoi(optarg);
+				if (dopt.chunk_size <= 0)
+				{
+					write_msg(NULL, "chunk size must be a positive number of megabytes\n");
+					exit_nicely(1);
+				}
+				break;
+
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit_nicely(1);
@@ -736,6 +751,8 @@ main(int argc, char **argv)
 	if (!dopt.schemaOnly)
 	{
 		getTableData(&dopt, tblinfo, numTables, dopt.oids);
+		if (dopt.chunk_size > 0)
+			getTableDataChunks(fout);
 		buildMatViewRefreshDependencies(fout);
 		if (dopt.dataOnly)
 			getTableDataFKConstraints();
@@ -896,6 +913,7 @@ help(const char *progname)
 	printf(_("  -T, --exclude-table=TABLE    do NOT dump the named table(s)\n"));
 	printf(_("  -x, --no-privileges          do not dump privileges (grant/revoke)\n"));
 	printf(_("  --binary-upgrade             for use by upgrade utilities only\n"));
+	printf(_("  --chunk-size=MB              dump larger tables in chunks of about MB megabytes\n"));
 	printf(_("  --column-inserts             dump data as INSERT commands with column names\n"));
 	printf(_("  --disable-dollar-quoting     disable dollar quoting, use SQL standard quoting\n"));
 	printf(_("  --disable-triggers           disable triggers during data-only restore\n"));
@@ -1867,6 +1885,8 @@ dumpTableData(Archive *fout, TableDataInfo *tdinfo)
 	PQExpBuffer clistBuf = createPQExpBuffer();
 	DataDumperPtr dumpFn;
 	char	   *copyStmt;
+	DumpId		deps[2];
+	int			ndeps;
 
 	if (!dopt->dump_inserts)
 	{
@@ -1890,14 +1910,22 @@ dumpTableData(Archive *fout, TableDataInfo *tdinfo)
 	/*
 	 * Note: although the TableDataInfo is a full DumpableObject, we treat its
 	 * dependency on its table as "special" and pass it to ArchiveEntry now.
-	 * See comments for BuildArchiveDependencies.
+	 * See comments for BuildArchiveDependencies.  Chunks after the first one
+	 * of a split table also depend on the first, see getTableDataChunks.
 	 */
+	deps[0] = tbinfo->dobj.dumpId;
+	ndeps = 1;
+	if (tdinfo->chunkno > 1)
+		deps[ndeps++] = tbinfo->dataObj->dobj.dumpId;
+
 	ArchiveEntry(fout, tdinfo->dobj.catId, tdinfo->dobj.dumpId,
 				 tbinfo->dobj.name, tbinfo->dobj.namespace__->dobj.name,
 				 NULL, tbinfo->rolname,
-				 false, "TABLE DATA", SECTION_DATA,
+				 false,
+				 tdinfo->chunkno > 1 ? "TABLE DATA CHUNK" : "TABLE DATA",
+				 SECTION_DATA,
 				 "", "", copyStmt,
-				 &(tbinfo->dobj.dumpId), 1,
+				 deps, ndeps,
 				 dumpFn, tdinfo);
 
 	destroyPQExpBuffer(copyBuf);
@@ -2018,11 +2046,172 @@ makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo, bool oids)
 	tdinfo->tdtable = tbinfo;
 	tdinfo->oids = oids;
 	tdinfo->filtercond = NULL;	/* might get set later */
+	tdinfo->chunkno = 0;
+	tdinfo->nextChunk = NULL;
 	addObjectDependency(&tdinfo->dobj, tbinfo->dobj.dumpId);
 
 	tbinfo->dataObj = tdinfo;
 }
 
+/*
+ * getTableDataChunks -
+ *	  split the data of large tables into chunks that can be dumped and
+ *	  restored in parallel
+ *
+ * A table is split if its size estimate from pg_class is above the chunk
+ * size and it has a single-column integer primary key; the chunks are equal
+ * ranges of the key between its smallest and largest value.  The table's
+ * TableDataInfo becomes the first chunk, and the others are TableDataInfos
+ * of their own, dumped as TABLE DATA CHUNK items that depend on it, so that
+ * pg_restore loads them after it (it may truncate the table, see
+ * restore_toc_entry) but in parallel with each other.
+ *
+ * Tables with inheritance children are left alone, since the chunk queries
+ * would see the children's rows too, and so are tables dumped WITH OIDS or
+ * with a filter condition already.
+ */
+static void
+getTableDataChunks(Archive *fout)
+{
+	DumpOptions *dopt = fout->dopt;
+	PQExpBuffer query;
+	PGresult   *res;
+	int			ntups;
+	int			i;
+
+	/* COPY (SELECT ...) is needed to dump part of a table */
+	if (fout->remoteVersion < 80200)
+		return;
+
+	query = createPQExpBuffer();
+
+	selectSourceSchema(fout, "pg_catalog");
+
+	appendPQExpBuffer(query,
+					  "SELECT c.oid, a.attname, "
+					  "c.relpages::pg_catalog.int8 * "
+					  "pg_catalog.current_setting('block_size')::pg_catalog.int8 AS size "
+					  "FROM pg_catalog.pg_class c "
+					  "JOIN pg_catalog.pg_index i ON i.indrelid = c.oid "
+					  "JOIN pg_catalog.pg_attribute a "
+					  "ON a.attrelid = c.oid AND a.attnum = i.indkey[0] "
+					  "WHERE c.relkind = 'r' AND i.indisprimary AND i.indnatts = 1 "
+					  "AND a.atttypid IN ('pg_catalog.int2'::pg_catalog.regtype, "
+					  "'pg_catalog.int4'::pg_catalog.regtype, "
+					  "'pg_catalog.int8'::pg_catalog.regtype) "
+					  "AND c.relpages::pg_catalog.int8 * "
+					  "pg_catalog.current_setting('block_size')::pg_catalog.int8 > "
+					  INT64_FORMAT " "
+					  "AND NOT EXISTS (SELECT 1 FROM pg_catalog.pg_inherits h "
+					  "WHERE h.inhparent = c.oid)",
+					  (int64) dopt->chunk_size * 1024 * 1024);
+
+	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
+	ntups = PQntuples(res);
+
+	for (i = 0; i < ntups; i++)
+	{
+		TableInfo  *tbinfo = findTableByOid(atooid(PQgetvalue(res, i, 0)));
+		char	   *keycol;
+		int64		size;
+		int64		minkey;
+		int64		maxkey;
+		uint64		step;
+		int64		nchunks;
+		TableDataInfo *first;
+		TableDataInfo *prev;
+		PGresult   *keyres;
+		int64		chunk;
+
+		if (tbinfo == NULL || tbinfo->dataObj == NULL)
+			continue;
+		first = tbinfo->dataObj;
+		if (first->dobj.objType != DO_TABLE_DATA ||
+			first->filtercond != NULL ||
+			(first->oids && tbinfo->hasoids))
+			continue;
+
+		/* find the range of the key */
+		keycol = pg_strdup(fmtId(PQgetvalue(res, i, 1)));
+		resetPQExpBuffer(query);
+		appendPQExpBuffer(query, "SELECT min(%s), max(%s) FROM ONLY ",
+						  keycol, keycol);
+		appendPQExpBufferStr(query,
+							 fmtQualifiedId(fout->remoteVersion,
+											tbinfo->dobj.namespace__->dobj.name,
+											tbinfo->dobj.name));
+		keyres = ExecuteSqlQueryForSingleRow(fout, query->data);
+		if (PQgetisnull(keyres, 0, 0))
+		{
+			/* table is empty */
+			PQclear(keyres);
+			free(keycol);
+			continue;
+		}
+		sscanf(PQgetvalue(keyres, 0, 0), INT64_FORMAT, &minkey);
+		sscanf(PQgetvalue(keyres, 0, 1), INT64_FORMAT, &maxkey);
+		PQclear(keyres);
+
+		sscanf(PQgetvalue(res, i, 2), INT64_FORMAT, &size);
+		nchunks = (size + (int64) dopt->chunk_size * 1024 * 1024 - 1) /
+			((int64) dopt->chunk_size * 1024 * 1024);
+		if ((uint64) maxkey - (uint64) minkey < (uint64) nchunks)
+			nchunks = (uint64) maxkey - (uint64) minkey + 1;
+		if (nchunks < 2)
+		{
+			free(keycol);
+			continue;
+		}
+		step = ((uint64) maxkey - (uint64) minkey) / nchunks + 1;
+
+		if (g_verbose)
+			write_msg(NULL, "dumping table \"%s.%s\" in " INT64_FORMAT " chunks\n",
+					  tbinfo->dobj.namespace__->dobj.name, tbinfo->dobj.name,
+					  nchunks);
+
+		/*
+		 * Chunk n covers the keys from minkey + (n - 1) * step up to the next
+		 * chunk's.  The first and last chunks are left open-ended.
+		 */
+		first->chunkno = 1;
+		first->filtercond = psprintf("WHERE %s < " INT64_FORMAT, keycol,
+									 (int64) ((uint64) minkey + step));
+		prev = first;
+		for (chunk = 2; chunk <= nchunks; chunk++)
+		{
+			TableDataInfo *tdinfo = (TableDataInfo *) pg_malloc(sizeof(TableDataInfo));
+			int64		lo = (int64) ((uint64) minkey + (chunk - 1) * step);
+
+			tdinfo->dobj.objType = DO_TABLE_DATA;
+			tdinfo->dobj.catId = first->dobj.catId;
+			AssignDumpId(&tdinfo->dobj);
+			tdinfo->dobj.name = tbinfo->dobj.name;
+			tdinfo->dobj.namespace__ = tbinfo->dobj.namespace__;
+			tdinfo->tdtable = tbinfo;
+			tdinfo->oids = first->oids;
+			tdinfo->chunkno = chunk;
+			if (chunk < nchunks)
+				tdinfo->filtercond = psprintf("WHERE %s >= " INT64_FORMAT
+											  " AND %s < " INT64_FORMAT,
+											  keycol, lo, keycol,
+											  (int64) ((uint64) lo + step));
+			else
+				tdinfo->filtercond = psprintf("WHERE %s >= " INT64_FORMAT,
+											  keycol, lo);
+			tdinfo->nextChunk = NULL;
+			addObjectDependency(&tdinfo->dobj, tbinfo->dobj.dumpId);
+			addObjectDependency(&tdinfo->dobj, first->dobj.dumpId);
+
+			prev->nextChunk = tdinfo;
+			prev = tdinfo;
+		}
+		free(keycol);
+	}
+
+	PQclear(res);
+	destroyPQExpBuffer(query);
+}
+
 /*
  * The refresh for a materialized view must be dependent on the refresh for
  * any materialized view that this one is dependent on.
@@ -2161,6 +2350,7 @@ getTableDataFKConstraints(void)
 		{
 			ConstraintInfo *cinfo = (ConstraintInfo *) dobjs[i];
 			TableInfo  *ftable;
+			TableDataInfo *chunk;
 
 			/* Not interesting unless both tables are to be dumped */
 			if (cinfo->contable == NULL ||
@@ -2173,10 +2363,12 @@ getTableDataFKConstraints(void)
 
 			/*
 			 * Okay, make referencing table's TABLE_DATA object depend on the
-			 * referenced table's TABLE_DATA object.
+			 * referenced table's TABLE_DATA object, and all its chunks if the
+			 * data is split.
 			 */
-			addObjectDependency(&cinfo->contable->dataObj->dobj,
-								ftable->dataObj->dobj.dumpId);
+			for (chunk = ftable->dataObj; chunk != NULL; chunk = chunk->nextChunk)
+				addObjectDependency(&cinfo->contable->dataObj->dobj,
+									chunk->dobj.dumpId);
 		}
 	}
 	free(dobjs);
@@ -3119,6 +3311,406 @@ dumpPolicy(Archive *fout, PolicyInfo *polinfo)
 	destroyPQExpBuffer(delqry);
 }
 
+/*
+ * getPublications
+ *	  get information about publications
+ */
+void
+getPublications(Archive *fout)
+{
+	DumpOptions *dopt = fout->dopt;
+	PQExpBuffer query;
+	PGresult   *res;
+	PublicationInfo *pubinfo;
+	int			i_tableoid;
+	int			i_oid;
+	int			i_pubname;
+	int			i_rolname;
+	int			i_puballtables;
+	int			i,
+				ntups;
+
+	if (fout->remoteVersion < 90500)
+		return;
+
+	query = createPQExpBuffer();
+
+	/* Make sure we are in proper schema */
+	selectSourceSchema(fout, "pg_catalog");
+
+	appendPQExpBuffer(query,
+					  "SELECT p.tableoid, p.oid, p.pubname, "
+					  "(%s p.pubowner) AS rolname, p.puballtables "
+					  "FROM pg_catalog.pg_publication p",
+					  username_subquery);
+
+	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
+
+	ntups = PQntuples(res);
+
+	i_tableoid = PQfnumber(res, "tableoid");
+	i_oid = PQfnumber(res, "oid");
+	i_pubname = PQfnumber(res, "pubname");
+	i_rolname = PQfnumber(res, "rolname");
+	i_puballtables = PQfnumber(res, "puballtables");
+
+	pubinfo = pg_malloc(ntups * sizeof(PublicationInfo));
+
+	for (i = 0; i < ntups; i++)
+	{
+		pubinfo[i].dobj.objType = DO_PUBLICATION;
+		pubinfo[i].dobj.catId.tableoid =
+			atooid(PQgetvalue(res, i, i_tableoid));
+		pubinfo[i].dobj.catId.oid = atooid(PQgetvalue(res, i, i_oid));
+		AssignDumpId(&pubinfo[i].dobj);
+		pubinfo[i].dobj.name = pg_strdup(PQgetvalue(res, i, i_pubname));
+		pubinfo[i].rolname = pg_strdup(PQgetvalue(res, i, i_rolname));
+		pubinfo[i].puballtables =
+			(strcmp(PQgetvalue(res, i, i_puballtables), "t") == 0);
+
+		if (strlen(pubinfo[i].rolname) == 0)
+			write_msg(NULL, "WARNING: owner of publication \"%s\" appears to be invalid\n",
+					  pubinfo[i].dobj.name);
+
+		/* Decide whether we want to dump it */
+		selectDumpableObject(&(pubinfo[i].dobj), dopt);
+	}
+	PQclear(res);
+
+	destroyPQExpBuffer(query);
+}
+
+/*
+ * dumpPublication
+ *	  dump the definition of the given publication
+ */
+static void
+dumpPublication(Archive *fout, PublicationInfo *pubinfo)
+{
+	DumpOptions *dopt = fout->dopt;
+	PQExpBuffer delq;
+	PQExpBuffer query;
+
+	if (!pubinfo->dobj.dump || dopt->dataOnly)
+		return;
+
+	delq = createPQExpBuffer();
+	query = createPQExpBuffer();
+
+	appendPQExpBuffer(delq, "DROP PUBLICATION %s;\n",
+					  fmtId(pubinfo->dobj.name));
+
+	appendPQExpBuffer(query, "CREATE PUBLICATION %s",
+					  fmtId(pubinfo->dobj.name));
+
+	if (pubinfo->puballtables)
+		appendPQExpBufferStr(query, " FOR ALL TABLES");
+
+	appendPQExpBufferStr(query, ";\n");
+
+	ArchiveEntry(fout, pubinfo->dobj.catId, pubinfo->dobj.dumpId,
+				 pubinfo->dobj.name,
+				 NULL,
+				 NULL,
+				 pubinfo->rolname, false,
+				 "PUBLICATION", SECTION_POST_DATA,
+				 query->data, delq->data, NULL,
+				 NULL, 0,
+				 NULL, NULL);
+
+	destroyPQExpBuffer(delq);
+	destroyPQExpBuffer(query);
+}
+
+/*
+ * getPublicationTables
+ *	  get information about publication membership for dumpable tables.
+ *
+ * Tables of FOR ALL TABLES publications have no pg_publication_rel entry
+ * and so need nothing here.
+ */
+void
+getPublicationTables(Archive *fout)
+{
+	PQExpBuffer query;
+	PGresult   *res;
+	PublicationRelInfo *pubrinfo;
+	int			i_tableoid;
+	int			i_oid;
+	int			i_pubtableoid;
+	int			i_prpubid;
+	int			i_prrelid;
+	int			i,
+				j,
+				ntups;
+
+	if (fout->remoteVersion < 90500)
+		return;
+
+	query = createPQExpBuffer();
+
+	/* Make sure we are in proper schema */
+	selectSourceSchema(fout, "pg_catalog");
+
+	appendPQExpBufferStr(query,
+						 "SELECT pr.tableoid, pr.oid, "
+						 "p.tableoid AS pubtableoid, pr.prpubid, pr.prrelid "
+						 "FROM pg_catalog.pg_publication_rel pr "
+						 "JOIN pg_catalog.pg_publication p "
+						 "ON p.oid = pr.prpubid");
+
+	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
+
+	ntups = PQntuples(res);
+
+	i_tableoid = PQfnumber(res, "tableoid");
+	i_oid = PQfnumber(res, "oid");
+	i_pubtableoid = PQfnumber(res, "pubtableoid");
+	i_prpubid = PQfnumber(res, "prpubid");
+	i_prrelid = PQfnumber(res, "prrelid");
+
+	pubrinfo = pg_malloc(ntups * sizeof(PublicationRelInfo));
+
+	for (i = 0, j = 0; i < ntups; i++)
+	{
+		CatalogId	pubId;
+		PublicationInfo *pubinfo;
+		TableInfo  *tbinfo;
+
+		pubId.tableoid = atooid(PQgetvalue(res, i, i_pubtableoid));
+		pubId.oid = atooid(PQgetvalue(res, i, i_prpubid));
+		pubinfo = (PublicationInfo *) findObjectByCatalogId(pubId);
+		tbinfo = findTableByOid(atooid(PQgetvalue(res, i, i_prrelid)));
+
+		/* Ignore publication membership of tables not to be dumped */
+		if (pubinfo == NULL || tbinfo == NULL || !tbinfo->dobj.dump)
+			continue;
+
+		pubrinfo[j].dobj.objType = DO_PUBLICATION_REL;
+		pubrinfo[j].dobj.catId.tableoid =
+			atooid(PQgetvalue(res, i, i_tableoid));
+		pubrinfo[j].dobj.catId.oid = atooid(PQgetvalue(res, i, i_oid));
+		AssignDumpId(&pubrinfo[j].dobj);
+		pubrinfo[j].dobj.namespace__ = tbinfo->dobj.namespace__;
+		pubrinfo[j].dobj.name = tbinfo->dobj.name;
+		pubrinfo[j].dobj.dump = pubinfo->dobj.dump;
+		pubrinfo[j].publication = pubinfo;
+		pubrinfo[j].pubtable = tbinfo;
+		j++;
+	}
+	PQclear(res);
+
+	destroyPQExpBuffer(query);
+}
+
+/*
+ * dumpPublicationTable
+ *	  dump the definition of the given publication table mapping
+ */
+static void
+dumpPublicationTable(Archive *fout, PublicationRelInfo *pubrinfo)
+{
+	DumpOptions *dopt = fout->dopt;
+	TableInfo  *tbinfo = pubrinfo->pubtable;
+	PQExpBuffer query;
+
+	if (!pubrinfo->dobj.dump || dopt->dataOnly)
+		return;
+
+	query = createPQExpBuffer();
+
+	appendPQExpBuffer(query, "ALTER PUBLICATION %s ADD TABLE ONLY",
+					  fmtId(pubrinfo->publication->dobj.name));
+	appendPQExpBuffer(query, " %s;\n",
+					  fmtId(tbinfo->dobj.name));
+
+	/*
+	 * There is no point in creating a drop query as the drop is done by
+	 * table drop.
+	 */
+	ArchiveEntry(fout, pubrinfo->dobj.catId, pubrinfo->dobj.dumpId,
+				 tbinfo->dobj.name,
+				 tbinfo->dobj.namespace__->dobj.name,
+				 NULL,
+				 "", false,
+				 "PUBLICATION TABLE", SECTION_POST_DATA,
+				 query->data, "", NULL,
+				 NULL, 0,
+				 NULL, NULL);
+
+	destroyPQExpBuffer(query);
+}
+
+/*
+ * getSubscriptions
+ *	  get information about subscriptions of the current database
+ *
+ * The connection string may contain a password, so pg_subscription.subconninfo
+ * is only readable by superusers; without it, warn and dump no subscriptions.
+ */
+void
+getSubscriptions(Archive *fout)
+{
+	DumpOptions *dopt = fout->dopt;
+	PQExpBuffer query;
+	PGresult   *res;
+	SubscriptionInfo *subinfo;
+	int			i_tableoid;
+	int			i_oid;
+	int			i_subname;
+	int			i_rolname;
+	int			i_substream;
+	int			i_subbinary;
+	int			i_subconninfo;
+	int			i_subslotname;
+	int			i_subpublications;
+	int			i,
+				ntups;
+
+	if (fout->remoteVersion < 90500)
+		return;
+
+	query = createPQExpBuffer();
+
+	/* Make sure we are in proper schema */
+	selectSourceSchema(fout, "pg_catalog");
+
+	res = ExecuteSqlQueryForSingleRow(fout,
+									  "SELECT pg_catalog.has_column_privilege("
+									  "'pg_catalog.pg_subscription', "
+									  "'subconninfo', 'SELECT')");
+	if (strcmp(PQgetvalue(res, 0, 0), "t") != 0)
+	{
+		PQclear(res);
+		res = ExecuteSqlQueryForSingleRow(fout,
+										  "SELECT count(*) FROM pg_catalog.pg_subscription "
+										  "WHERE subdbid = (SELECT oid FROM pg_catalog.pg_database"
+										  " WHERE datname = pg_catalog.current_database())");
+		if (atoi(PQgetvalue(res, 0, 0)) > 0)
+			write_msg(NULL, "WARNING: subscriptions not dumped because current user is not a superuser\n");
+		PQclear(res);
+		destroyPQExpBuffer(query);
+		return;
+	}
+	PQclear(res);
+
+	appendPQExpBuffer(query,
+					  "SELECT s.tableoid, s.oid, s.subname, "
+					  "(%s s.subowner) AS rolname, "
+					  "s.substream, s.subbinary, s.subconninfo, "
+					  "s.subslotname, "
+					  "pg_catalog.array_to_string(ARRAY("
+					  "SELECT pg_catalog.quote_ident(p.pubname) "
+					  "FROM pg_catalog.unnest(s.subpublications) "
+					  "WITH ORDINALITY p(pubname, n) ORDER BY p.n), ', ') "
+					  "AS subpublications "
+					  "FROM pg_catalog.pg_subscription s "
+					  "WHERE s.subdbid = (SELECT oid FROM pg_catalog.pg_database"
+					  " WHERE datname = pg_catalog.current_database())",
+					  username_subquery);
+
+	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
+
+	ntups = PQntuples(res);
+
+	i_tableoid = PQfnumber(res, "tableoid");
+	i_oid = PQfnumber(res, "oid");
+	i_subname = PQfnumber(res, "subname");
+	i_rolname = PQfnumber(res, "rolname");
+	i_substream = PQfnumber(res, "substream");
+	i_subbinary = PQfnumber(res, "subbinary");
+	i_subconninfo = PQfnumber(res, "subconninfo");
+	i_subslotname = PQfnumber(res, "subslotname");
+	i_subpublications = PQfnumber(res, "subpublications");
+
+	subinfo = pg_malloc(ntups * sizeof(SubscriptionInfo));
+
+	for (i = 0; i < ntups; i++)
+	{
+		subinfo[i].dobj.objType = DO_SUBSCRIPTION;
+		subinfo[i].dobj.catId.tableoid =
+			atooid(PQgetvalue(res, i, i_tableoid));
+		subinfo[i].dobj.catId.oid = atooid(PQgetvalue(res, i, i_oid));
+		AssignDumpId(&subinfo[i].dobj);
+		subinfo[i].dobj.name = pg_strdup(PQgetvalue(res, i, i_subname));
+		subinfo[i].rolname = pg_strdup(PQgetvalue(res, i, i_rolname));
+		subinfo[i].substream =
+			(strcmp(PQgetvalue(res, i, i_substream), "t") == 0);
+		subinfo[i].subbinary =
+			(strcmp(PQgetvalue(res, i, i_subbinary), "t") == 0);
+		subinfo[i].subconninfo =
+			pg_strdup(PQgetvalue(res, i, i_subconninfo));
+		subinfo[i].subslotname =
+			pg_strdup(PQgetvalue(res, i, i_subslotname));
+		subinfo[i].subpublications =
+			pg_strdup(PQgetvalue(res, i, i_subpublications));
+
+		if (strlen(subinfo[i].rolname) == 0)
+			write_msg(NULL, "WARNING: owner of subscription \"%s\" appears to be invalid\n",
+					  subinfo[i].dobj.name);
+
+		/* Decide whether we want to dump it */
+		selectDumpableObject(&(subinfo[i].dobj), dopt);
+	}
+	PQclear(res);
+
+	destroyPQExpBuffer(query);
+}
+
+/*
+ * dumpSubscription
+ *	  dump the definition of the given subscription
+ *
+ * The subscription is always created disabled, so that restoring a dump
+ * doesn't start an apply worker that connects to the publisher and
+ * consumes from its slot.  The user has to ENABLE it once the slot and
+ * connection are known to be right.
+ */
+static void
+dumpSubscription(Archive *fout, SubscriptionInfo *subinfo)
+{
+	DumpOptions *dopt = fout->dopt;
+	PQExpBuffer delq;
+	PQExpBuffer query;
+
+	if (!subinfo->dobj.dump || dopt->dataOnly)
+		return;
+
+	delq = createPQExpBuffer();
+	query = createPQExpBuffer();
+
+	appendPQExpBuffer(delq, "DROP SUBSCRIPTION %s;\n",
+					  fmtId(subinfo->dobj.name));
+
+	appendPQExpBuffer(query, "CREATE SUBSCRIPTION %s CONNECTION ",
+					  fmtId(subinfo->dobj.name));
+	appendStringLiteralAH(query, subinfo->subconninfo, fout);
+	appendPQExpBuffer(query, " PUBLICATION %s WITH (enabled = false, slot_name = ",
+					  subinfo->subpublications);
+	appendStringLiteralAH(query, subinfo->subslotname, fout);
+
+	if (subinfo->substream)
+		appendPQExpBufferStr(query, ", streaming = true");
+
+	if (subinfo->subbinary)
+		appendPQExpBufferStr(query, ", binary = true");
+
+	appendPQExpBufferStr(query, ");\n");
+
+	ArchiveEntry(fout, subinfo->dobj.catId, subinfo->dobj.dumpId,
+				 subinfo->dobj.name,
+				 NULL,
+				 NULL,
+				 subinfo->rolname, false,
+				 "SUBSCRIPTION", SECTION_POST_DATA,
+				 query->data, delq->data, NULL,
+				 NULL, 0,
+				 NULL, NULL);
+
+	destroyPQExpBuffer(delq);
+	destroyPQExpBuffer(query);
+}
+
 static void
 binary_upgrade_set_type_oids_by_type_oid(Archive *fout,
 										 PQExpBuffer upgrade_buffer,
@@ -4636,6 +5228,7 @@ getTables(Archive *fout, int *numTables)
 	int			i_toastreloptions;
 	int			i_reloftype;
 	int			i_relpages;
+	int			i_amname;
 
 	/* Make sure we are in proper schema */
 	selectSourceSchema(fout, "pg_catalog");
@@ -4679,6 +5272,7 @@ getTables(Archive *fout, int *numTables)
 						  "c.relpersistence, c.relispopulated, "
 						  "c.relreplident, c.relpages, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
+						  "CASE WHEN c.relkind = '%c' AND c.relam <> 0 THEN c.relam::pg_catalog.regproc ELSE NULL END AS amname, "
 						  "d.refobjid AS owning_tab, "
 						  "d.refobjsubid AS owning_col, "
 						  "(SELECT spcname FROM pg_tablespace t WHERE t.oid = c.reltablespace) AS reltablespace, "
@@ -4696,6 +5290,7 @@ getTables(Archive *fout, int *numTables)
 				   "WHERE c.relkind in ('%c', '%c', '%c', '%c', '%c', '%c') "
 						  "ORDER BY c.oid",
 						  username_subquery,
+						  RELKIND_RELATION,
 						  RELKIND_SEQUENCE,
 						  RELKIND_RELATION, RELKIND_SEQUENCE,
 						  RELKIND_VIEW, RELKIND_COMPOSITE_TYPE,
@@ -5162,6 +5757,7 @@ getTables(Archive *fout, int *numTables)
 	i_checkoption = PQfnumber(res, "checkoption");
 	i_toastreloptions = PQfnumber(res, "toast_reloptions");
 	i_reloftype = PQfnumber(res, "reloftype");
+	i_amname = PQfnumber(res, "amname");
 
 	if (dopt->lockWaitTimeout && fout->remoteVersion >= 70300)
 	{
@@ -5211,6 +5807,10 @@ getTables(Archive *fout, int *numTables)
 			tblinfo[i].reloftype = NULL;
 		else
 			tblinfo[i].reloftype = pg_strdup(PQgetvalue(res, i, i_reloftype));
+		if (i_amname == -1 || PQgetisnull(res, i, i_amname))
+			tblinfo[i].amname = NULL;
+		else
+			tblinfo[i].amname = pg_strdup(PQgetvalue(res, i, i_amname));
 		tblinfo[i].ncheck = atoi(PQgetvalue(res, i, i_relchecks));
 		if (PQgetisnull(res, i, i_owning_tab))
 		{
@@ -5748,6 +6348,82 @@ getIndexes(Archive *fout, TableInfo tblinfo[], int numTables)
 	destroyPQExpBuffer(query);
 }
 
+/*
+ * getExtendedStatistics
+ *	  get information about extended statistics objects.
+ *
+ * Like indexes, statistics objects are dumped if their table is.
+ */
+void
+getExtendedStatistics(Archive *fout)
+{
+	PQExpBuffer query;
+	PGresult   *res;
+	StatsExtInfo *statsextinfo;
+	int			ntups;
+	int			i_tableoid;
+	int			i_oid;
+	int			i_stxname;
+	int			i_stxnamespace;
+	int			i_rolname;
+	int			i_stxrelid;
+	int			i;
+
+	if (fout->remoteVersion < 90500)
+		return;
+
+	query = createPQExpBuffer();
+
+	/* Make sure we are in proper schema */
+	selectSourceSchema(fout, "pg_catalog");
+
+	appendPQExpBuffer(query, "SELECT tableoid, oid, stxname, "
+					  "stxnamespace, (%s stxowner) AS rolname, stxrelid "
+					  "FROM pg_catalog.pg_statistic_ext",
+					  username_subquery);
+
+	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
+
+	ntups = PQntuples(res);
+
+	i_tableoid = PQfnumber(res, "tableoid");
+	i_oid = PQfnumber(res, "oid");
+	i_stxname = PQfnumber(res, "stxname");
+	i_stxnamespace = PQfnumber(res, "stxnamespace");
+	i_rolname = PQfnumber(res, "rolname");
+	i_stxrelid = PQfnumber(res, "stxrelid");
+
+	statsextinfo = (StatsExtInfo *) pg_malloc(ntups * sizeof(StatsExtInfo));
+
+	for (i = 0; i < ntups; i++)
+	{
+		TableInfo  *tbinfo;
+
+		tbinfo = findTableByOid(atooid(PQgetvalue(res, i, i_stxrelid)));
+		if (tbinfo == NULL)
+			exit_horribly(NULL, "failed sanity check, parent table OID %s of statistics object \"%s\" not found\n",
+						  PQgetvalue(res, i, i_stxrelid),
+						  PQgetvalue(res, i, i_stxname));
+
+		statsextinfo[i].dobj.objType = DO_STATSEXT;
+		statsextinfo[i].dobj.catId.tableoid = atooid(PQgetvalue(res, i, i_tableoid));
+		statsextinfo[i].dobj.catId.oid = atooid(PQgetvalue(res, i, i_oid));
+		AssignDumpId(&statsextinfo[i].dobj);
+		statsextinfo[i].dobj.name = pg_strdup(PQgetvalue(res, i, i_stxname));
+		statsextinfo[i].dobj.namespace__ =
+			findNamespace(fout,
+						  atooid(PQgetvalue(res, i, i_stxnamespace)),
+						  statsextinfo[i].dobj.catId.oid);
+		statsextinfo[i].rolname = pg_strdup(PQgetvalue(res, i, i_rolname));
+		statsextinfo[i].stattable = tbinfo;
+		statsextinfo[i].dobj.dump = tbinfo->dobj.dump;
+	}
+
+	PQclear(res);
+
+	destroyPQExpBuffer(query);
+}
+
 /*
  * getConstraints
  *
@@ -6835,6 +7511,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 	int			i_attstattarget;
 	int			i_attstorage;
 	int			i_typstorage;
+	int			i_attcompression;
 	int			i_attnotnull;
 	int			i_atthasdef;
 	int			i_attisdropped;
@@ -6882,7 +7559,32 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 
 		resetPQExpBuffer(q);
 
-		if (fout->remoteVersion >= 90200)
+		if (fout->remoteVersion >= 90500)
+		{
+			/* attcompression is new in 9.5 */
+			appendPQExpBuffer(q, "SELECT a.attnum, a.attname, a.atttypmod, "
+							  "a.attstattarget, a.attstorage, t.typstorage, "
+							  "a.attcompression, "
+							  "a.attnotnull, a.atthasdef, a.attisdropped, "
+							  "a.attlen, a.attalign, a.attislocal, "
+				  "pg_catalog.format_type(t.oid,a.atttypmod) AS atttypname, "
+						"array_to_string(a.attoptions, ', ') AS attoptions, "
+							  "CASE WHEN a.attcollation <> t.typcollation "
+						   "THEN a.attcollation ELSE 0 END AS attcollation, "
+							  "pg_catalog.array_to_string(ARRAY("
+							  "SELECT pg_catalog.quote_ident(option_name) || "
+							  "' ' || pg_catalog.quote_literal(option_value) "
+						"FROM pg_catalog.pg_options_to_table(attfdwoptions) "
+							  "ORDER BY option_name"
+							  "), E',\n    ') AS attfdwoptions "
+			 "FROM pg_catalog.pg_attribute a LEFT JOIN pg_catalog.pg_type t "
+							  "ON a.atttypid = t.oid "
+							  "WHERE a.attrelid = '%u'::pg_catalog.oid "
+							  "AND a.attnum > 0::pg_catalog.int2 "
+							  "ORDER BY a.attrelid, a.attnum",
+							  tbinfo->dobj.catId.oid);
+		}
+		else if (fout->remoteVersion >= 90200)
 		{
 			/*
 			 * attfdwoptions is new in 9.2.
@@ -7022,6 +7724,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 		i_attstattarget = PQfnumber(res, "attstattarget");
 		i_attstorage = PQfnumber(res, "attstorage");
 		i_typstorage = PQfnumber(res, "typstorage");
+		i_attcompression = PQfnumber(res, "attcompression");
 		i_attnotnull = PQfnumber(res, "attnotnull");
 		i_atthasdef = PQfnumber(res, "atthasdef");
 		i_attisdropped = PQfnumber(res, "attisdropped");
@@ -7039,6 +7742,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 		tbinfo->attstattarget = (int *) pg_malloc(ntups * sizeof(int));
 		tbinfo->attstorage = (char *) pg_malloc(ntups * sizeof(char));
 		tbinfo->typstorage = (char *) pg_malloc(ntups * sizeof(char));
+		tbinfo->attcompression = (char *) pg_malloc(ntups * sizeof(char));
 		tbinfo->attisdropped = (bool *) pg_malloc(ntups * sizeof(bool));
 		tbinfo->attlen = (int *) pg_malloc(ntups * sizeof(int));
 		tbinfo->attalign = (char *) pg_malloc(ntups * sizeof(char));
@@ -7063,6 +7767,10 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 			tbinfo->attstattarget[j] = atoi(PQgetvalue(res, j, i_attstattarget));
 			tbinfo->attstorage[j] = *(PQgetvalue(res, j, i_attstorage));
 			tbinfo->typstorage[j] = *(PQgetvalue(res, j, i_typstorage));
+			if (i_attcompression == -1)
+				tbinfo->attcompression[j] = '\0';
+			else
+				tbinfo->attcompression[j] = *(PQgetvalue(res, j, i_attcompression));
 			tbinfo->attisdropped[j] = (PQgetvalue(res, j, i_attisdropped)[0] == 't');
 			tbinfo->attlen[j] = atoi(PQgetvalue(res, j, i_attlen));
 			tbinfo->attalign[j] = *(PQgetvalue(res, j, i_attalign));
@@ -8410,6 +9118,9 @@ dumpDumpableObject(Archive *fout, DumpableObject *dobj)
 		case DO_INDEX:
 			dumpIndex(fout, (IndxInfo *) dobj);
 			break;
+		case DO_STATSEXT:
+			dumpStatisticsExt(fout, (StatsExtInfo *) dobj);
+			break;
 		case DO_REFRESH_MATVIEW:
 			refreshMatViewData(fout, (TableDataInfo *) dobj);
 			break;
@@ -8481,6 +9192,15 @@ dumpDumpableObject(Archive *fout, DumpableObject *dobj)
 		case DO_POLICY:
 			dumpPolicy(fout, (PolicyInfo *) dobj);
 			break;
+		case DO_PUBLICATION:
+			dumpPublication(fout, (PublicationInfo *) dobj);
+			break;
+		case DO_PUBLICATION_REL:
+			dumpPublicationTable(fout, (PublicationRelInfo *) dobj);
+			break;
+		case DO_SUBSCRIPTION:
+			dumpSubscription(fout, (SubscriptionInfo *) dobj);
+			break;
 		case DO_PRE_DATA_BOUNDARY:
 		case DO_POST_DATA_BOUNDARY:
 			/* never dumped, nothing to do */
@@ -12281,6 +13001,7 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	PGresult   *res;
 	int			i_aggtransfn;
 	int			i_aggfinalfn;
+	int			i_aggcombinefn;
 	int			i_aggmtransfn;
 	int			i_aggminvtransfn;
 	int			i_aggmfinalfn;
@@ -12297,6 +13018,7 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	int			i_convertok;
 	const char *aggtransfn;
 	const char *aggfinalfn;
+	const char *aggcombinefn;
 	const char *aggmtransfn;
 	const char *aggminvtransfn;
 	const char *aggmfinalfn;
@@ -12327,10 +13049,31 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	selectSourceSchema(fout, agginfo->aggfn.dobj.namespace__->dobj.name);
 
 	/* Get aggregate-specific details */
-	if (fout->remoteVersion >= 90400)
+	if (fout->remoteVersion >= 90500)
+	{
+		appendPQExpBuffer(query, "SELECT aggtransfn, "
+						  "aggfinalfn, aggtranstype::pg_catalog.regtype, "
+						  "aggcombinefn, "
+						  "aggmtransfn, aggminvtransfn, aggmfinalfn, "
+						  "aggmtranstype::pg_catalog.regtype, "
+						  "aggfinalextra, aggmfinalextra, "
+						  "aggsortop::pg_catalog.regoperator, "
+						  "(aggkind = 'h') AS hypothetical, "
+						  "aggtransspace, agginitval, "
+						  "aggmtransspace, aggminitval, "
+						  "true AS convertok, "
+				  "pg_catalog.pg_get_function_arguments(p.oid) AS funcargs, "
+		 "pg_catalog.pg_get_function_identity_arguments(p.oid) AS funciargs "
+					  "FROM pg_catalog.pg_aggregate a, pg_catalog.pg_proc p "
+						  "WHERE a.aggfnoid = p.oid "
+						  "AND p.oid = '%u'::pg_catalog.oid",
+						  agginfo->aggfn.dobj.catId.oid);
+	}
+	else if (fout->remoteVersion >= 90400)
 	{
 		appendPQExpBuffer(query, "SELECT aggtransfn, "
 						  "aggfinalfn, aggtranstype::pg_catalog.regtype, "
+						  "'-' AS aggcombinefn, "
 						  "aggmtransfn, aggminvtransfn, aggmfinalfn, "
 						  "aggmtranstype::pg_catalog.regtype, "
 						  "aggfinalextra, aggmfinalextra, "
@@ -12350,7 +13093,8 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	{
 		appendPQExpBuffer(query, "SELECT aggtransfn, "
 						  "aggfinalfn, aggtranstype::pg_catalog.regtype, "
-						  "'-' AS aggmtransfn, '-' AS aggminvtransfn, "
+						  "'-' AS aggcombinefn, '-' AS aggmtransfn, "
+						  "'-' AS aggminvtransfn, "
 						  "'-' AS aggmfinalfn, 0 AS aggmtranstype, "
 						  "false AS aggfinalextra, false AS aggmfinalextra, "
 						  "aggsortop::pg_catalog.regoperator, "
@@ -12369,7 +13113,8 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	{
 		appendPQExpBuffer(query, "SELECT aggtransfn, "
 						  "aggfinalfn, aggtranstype::pg_catalog.regtype, "
-						  "'-' AS aggmtransfn, '-' AS aggminvtransfn, "
+						  "'-' AS aggcombinefn, '-' AS aggmtransfn, "
+						  "'-' AS aggminvtransfn, "
 						  "'-' AS aggmfinalfn, 0 AS aggmtranstype, "
 						  "false AS aggfinalextra, false AS aggmfinalextra, "
 						  "aggsortop::pg_catalog.regoperator, "
@@ -12386,7 +13131,8 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	{
 		appendPQExpBuffer(query, "SELECT aggtransfn, "
 						  "aggfinalfn, aggtranstype::pg_catalog.regtype, "
-						  "'-' AS aggmtransfn, '-' AS aggminvtransfn, "
+						  "'-' AS aggcombinefn, '-' AS aggmtransfn, "
+						  "'-' AS aggminvtransfn, "
 						  "'-' AS aggmfinalfn, 0 AS aggmtranstype, "
 						  "false AS aggfinalextra, false AS aggmfinalextra, "
 						  "0 AS aggsortop, "
@@ -12403,7 +13149,8 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 	{
 		appendPQExpBuffer(query, "SELECT aggtransfn, aggfinalfn, "
 						  "format_type(aggtranstype, NULL) AS aggtranstype, "
-						  "'-' AS aggmtransfn, '-' AS aggminvtransfn, "
+						  "'-' AS aggcombinefn, '-' AS aggmtransfn, "
+						  "'-' AS aggminvtransfn, "
 						  "'-' AS aggmfinalfn, 0 AS aggmtranstype, "
 						  "false AS aggfinalextra, false AS aggmfinalextra, "
 						  "0 AS aggsortop, "
@@ -12420,7 +13167,8 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 		appendPQExpBuffer(query, "SELECT aggtransfn1 AS aggtransfn, "
 						  "aggfinalfn, "
 						  "(SELECT typname FROM pg_type WHERE oid = aggtranstype1) AS aggtranstype, "
-						  "'-' AS aggmtransfn, '-' AS aggminvtransfn, "
+						  "'-' AS aggcombinefn, '-' AS aggmtransfn, "
+						  "'-' AS aggminvtransfn, "
 						  "'-' AS aggmfinalfn, 0 AS aggmtranstype, "
 						  "false AS aggfinalextra, false AS aggmfinalextra, "
 						  "0 AS aggsortop, "
@@ -12437,6 +13185,7 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 
 	i_aggtransfn = PQfnumber(res, "aggtransfn");
 	i_aggfinalfn = PQfnumber(res, "aggfinalfn");
+	i_aggcombinefn = PQfnumber(res, "aggcombinefn");
 	i_aggmtransfn = PQfnumber(res, "aggmtransfn");
 	i_aggminvtransfn = PQfnumber(res, "aggminvtransfn");
 	i_aggmfinalfn = PQfnumber(res, "aggmfinalfn");
@@ -12454,6 +13203,7 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 
 	aggtransfn = PQgetvalue(res, 0, i_aggtransfn);
 	aggfinalfn = PQgetvalue(res, 0, i_aggfinalfn);
+	aggcombinefn = PQgetvalue(res, 0, i_aggcombinefn);
 	aggmtransfn = PQgetvalue(res, 0, i_aggmtransfn);
 	aggminvtransfn = PQgetvalue(res, 0, i_aggminvtransfn);
 	aggmfinalfn = PQgetvalue(res, 0, i_aggmfinalfn);
@@ -12542,6 +13292,12 @@ dumpAgg(Archive *fout, AggInfo *agginfo)
 			appendPQExpBufferStr(details, ",\n    FINALFUNC_EXTRA");
 	}
 
+	if (strcmp(aggcombinefn, "-") != 0)
+	{
+		appendPQExpBuffer(details, ",\n    COMBINEFUNC = %s",
+						  aggcombinefn);
+	}
+
 	if (strcmp(aggmtransfn, "-") != 0)
 	{
 		appendPQExpBuffer(details, ",\n    MSFUNC = %s,\n    MINVFUNC = %s,\n    MSTYPE = %s",
@@ -14125,6 +14881,10 @@ dumpTableSchema(Archive *fout, TableInfo *tbinfo)
 				appendPQExpBuffer(q, "\nSERVER %s", fmtId(srvname));
 		}
 
+		/* regproc output is already quoted and qualified as needed */
+		if (tbinfo->amname != NULL)
+			appendPQExpBuffer(q, "\nUSING %s", tbinfo->amname);
+
 		if (nonemptyReloptions(tbinfo->reloptions) ||
 			nonemptyReloptions(tbinfo->toast_reloptions))
 		{
@@ -14381,6 +15141,37 @@ dumpTableSchema(Archive *fout, TableInfo *tbinfo)
 				}
 			}
 
+			/*
+			 * Dump per-column compression method, if one was chosen; columns
+			 * without one follow default_toast_compression.
+			 */
+			if (tbinfo->attcompression[j] != '\0')
+			{
+				const char *cmname;
+
+				switch (tbinfo->attcompression[j])
+				{
+					case 'p':
+						cmname = "pglz";
+						break;
+					case 'l':
+						cmname = "lz4";
+						break;
+					default:
+						cmname = NULL;
+				}
+
+				if (cmname != NULL)
+				{
+					appendPQExpBuffer(q, "ALTER TABLE ONLY %s ",
+									  fmtId(tbinfo->dobj.name));
+					appendPQExpBuffer(q, "ALTER COLUMN %s ",
+									  fmtId(tbinfo->attnames[j]));
+					appendPQExpBuffer(q, "SET COMPRESSION %s;\n",
+									  cmname);
+				}
+			}
+
 			/*
 			 * Dump per-column attributes.
 			 */
@@ -14658,6 +15449,104 @@ dumpIndex(Archive *fout, IndxInfo *indxinfo)
 	destroyPQExpBuffer(labelq);
 }
 
+/*
+ * dumpStatisticsExt
+ *	  write out to fout an extended statistics object
+ */
+static void
+dumpStatisticsExt(Archive *fout, StatsExtInfo *statsextinfo)
+{
+	DumpOptions *dopt = fout->dopt;
+	TableInfo  *tbinfo = statsextinfo->stattable;
+	PQExpBuffer q;
+	PQExpBuffer delq;
+	PQExpBuffer labelq;
+	PQExpBuffer query;
+	PGresult   *res;
+	char	   *qstatsextname;
+
+	/* Skip if not to be dumped */
+	if (!statsextinfo->dobj.dump || dopt->dataOnly)
+		return;
+
+	q = createPQExpBuffer();
+	delq = createPQExpBuffer();
+	labelq = createPQExpBuffer();
+	query = createPQExpBuffer();
+
+	/* Make sure we are in proper schema */
+	selectSourceSchema(fout, "pg_catalog");
+
+	/*
+	 * Build the list of statistics kinds and the column list; there is no
+	 * server function that deparses a statistics object.
+	 */
+	appendPQExpBuffer(query, "SELECT "
+					  "pg_catalog.array_to_string(ARRAY("
+					  "SELECT CASE k.kind WHEN 'd' THEN 'ndistinct' "
+					  "WHEN 'f' THEN 'dependencies' "
+					  "WHEN 'm' THEN 'mcv' END "
+					  "FROM pg_catalog.unnest(s.stxkind) "
+					  "WITH ORDINALITY k(kind, n) ORDER BY k.n), ', ') "
+					  "AS stxkinds, "
+					  "pg_catalog.array_to_string(ARRAY("
+					  "SELECT pg_catalog.quote_ident(a.attname) "
+					  "FROM pg_catalog.unnest(s.stxkeys::pg_catalog.int2[]) "
+					  "WITH ORDINALITY k(attnum, n) "
+					  "JOIN pg_catalog.pg_attribute a "
+					  "ON (a.attrelid = s.stxrelid AND a.attnum = k.attnum) "
+					  "ORDER BY k.n), ', ') AS stxcolumns "
+					  "FROM pg_catalog.pg_statistic_ext s "
+					  "WHERE s.oid = '%u'::pg_catalog.oid",
+					  statsextinfo->dobj.catId.oid);
+
+	res = ExecuteSqlQueryForSingleRow(fout, query->data);
+
+	qstatsextname = pg_strdup(fmtId(statsextinfo->dobj.name));
+
+	appendPQExpBuffer(q, "CREATE STATISTICS %s (%s) ON %s FROM ",
+					  qstatsextname,
+					  PQgetvalue(res, 0, PQfnumber(res, "stxkinds")),
+					  PQgetvalue(res, 0, PQfnumber(res, "stxcolumns")));
+	appendPQExpBuffer(q, "%s;\n",
+					  fmtQualifiedId(fout->remoteVersion,
+									 tbinfo->dobj.namespace__->dobj.name,
+									 tbinfo->dobj.name));
+
+	/*
+	 * DROP must be fully qualified in case same name appears in pg_catalog
+	 */
+	appendPQExpBuffer(delq, "DROP STATISTICS %s.",
+					  fmtId(statsextinfo->dobj.namespace__->dobj.name));
+	appendPQExpBuffer(delq, "%s;\n", qstatsextname);
+
+	appendPQExpBuffer(labelq, "STATISTICS %s", qstatsextname);
+
+	ArchiveEntry(fout, statsextinfo->dobj.catId, statsextinfo->dobj.dumpId,
+				 statsextinfo->dobj.name,
+				 statsextinfo->dobj.namespace__->dobj.name,
+				 NULL,
+				 statsextinfo->rolname, false,
+				 "STATISTICS", SECTION_POST_DATA,
+				 q->data, delq->data, NULL,
+				 NULL, 0,
+				 NULL, NULL);
+
+	/* Dump Statistics Comments */
+	dumpComment(fout, labelq->data,
+				statsextinfo->dobj.namespace__->dobj.name,
+				statsextinfo->rolname,
+				statsextinfo->dobj.catId, 0,
+				statsextinfo->dobj.dumpId);
+
+	PQclear(res);
+	free(qstatsextname);
+	destroyPQExpBuffer(q);
+	destroyPQExpBuffer(delq);
+	destroyPQExpBuffer(labelq);
+	destroyPQExpBuffer(query);
+}
+
 /*
  * dumpConstraint
  *	  write out to fout a user-defined constraint
@@ -16119,11 +17008,15 @@ addBoundaryDependencies(DumpableObject **dobjs, int numObjs,
 				addObjectDependency(postDataBound, dobj->dumpId);
 				break;
 			case DO_INDEX:
+			case DO_STATSEXT:
 			case DO_REFRESH_MATVIEW:
 			case DO_TRIGGER:
 			case DO_EVENT_TRIGGER:
 			case DO_DEFAULT_ACL:
 			case DO_POLICY:
+			case DO_PUBLICATION:
+			case DO_PUBLICATION_REL:
+			case DO_SUBSCRIPTION:
 				/* Post-data objects: must come after the post-data boundary */
 				addObjectDependency(dobj, postDataBound->dumpId);
 				break;
@@ -114,6 +114,7 @@ main(int argc, char **argv)
 		{"disable-triggers", no_argument, &disable_triggers, 1},
 		{"enable-row-security", no_argument, &enable_row_security, 1},
 		{"if-exists", no_argument, &if_exists, 1},
+		{"index-memory", required_argument, NULL, 4},
 		{"no-data-for-failed-tables", no_argument, &no_data_for_failed_tables, 1},
 		{"no-tablespaces", no_argument, &outputNoTablespaces, 1},
 		{"role", required_argument, NULL, 2},
@@ -273,6 +274,16 @@ main(int argc, char **argv)
 				set_dump_section(optarg, &(opts->dumpSections));
 				break;
 
+			case 4:				/* index memory */
+				opts->index_memory = atoi(optarg);
+				if (opts->index_memory <= 0)
+				{
+					fprintf(stderr, _("%s: invalid index memory size \"%s\"\n"),
+							progname, optarg);
+					exit_nicely(1);
+				}
+				break;
+
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit_nicely(1);
@@ -331,6 +342,13 @@ main(int argc, char **argv)
 		exit_nicely(1);
 	}
 
+	if (opts->index_memory > 0 && numWorkers <= 1)
+	{
+		fprintf(stderr, _("%s: option --index-memory requires option -j/--jobs\n"),
+				progname);
+		exit_nicely(1);
+	}
+
 	opts->disable_triggers = disable_triggers;
 	opts->enable_row_security = enable_row_security;
 	opts->noDataForFailedTables = no_data_for_failed_tables;
@@ -464,6 +482,8 @@ usage(const char *progname)
 	printf(_("  --disable-triggers           disable triggers during data-only restore\n"));
 	printf(_("  --enable-row-security        enable row security\n"));
 	printf(_("  --if-exists                  use IF EXISTS when dropping objects\n"));
+	printf(_("  --index-memory=MB            memory to share among index builds in parallel\n"
+			 "                               restore\n"));
 	printf(_("  --no-data-for-failed-tables  do not restore data of tables that could not be\n"
 			 "                               created\n"));
 	printf(_("  --no-security-labels         do not restore security labels\n"));
@@ -0,0 +1,93 @@
+use strict;
+use warnings;
+use TestLib;
+use Test::More tests => 42;
+
+my $tempdir = tempdir;
+start_test_server $tempdir;
+
+psql 'postgres',
+    'CREATE TABLE amtest (a int) USING columnar; '
+  . 'CREATE TABLE heaptest (a int) USING heap';
+
+command_like(
+	[ 'pg_dump', '-s', '-t', 'amtest', 'postgres' ],
+	qr/^CREATE TABLE amtest \(\n    a integer\n\)\nUSING columnar;$/m,
+	'table access method is dumped');
+command_like(
+	[ 'pg_dump', '-s', '-t', 'heaptest', 'postgres' ],
+	qr/^CREATE TABLE heaptest \(\n    a integer\n\);$/m,
+	'heap table is dumped without USING');
+command_like(
+	[ 'psql', '-X', '-c', '\d+ amtest', 'postgres' ],
+	qr/^Access method: columnar$/m,
+	'psql \d+ shows table access method');
+
+psql 'postgres',
+    'CREATE AGGREGATE mysum (int4) '
+  . '(SFUNC = int4pl, STYPE = int4, COMBINEFUNC = int4pl)';
+command_like(
+	[ 'pg_dump', '-s', 'postgres' ],
+	qr/^CREATE AGGREGATE mysum\(integer\) \(\n    SFUNC = int4pl,\n    STYPE = integer,\n    COMBINEFUNC = int4pl\n\);$/m,
+	'aggregate combine function is dumped');
+
+psql 'postgres',
+    'CREATE TABLE stxtest (a int, b int); '
+  . 'CREATE STATISTICS stxtest_ab ON b, a FROM stxtest';
+command_like(
+	[ 'pg_dump', '-s', '-t', 'stxtest', 'postgres' ],
+	qr/^CREATE STATISTICS stxtest_ab \(ndistinct, dependencies, mcv\) ON a, b FROM public\.stxtest;$/m,
+	'extended statistics are dumped');
+command_like(
+	[ 'psql', '-X', '-c', '\d stxtest', 'postgres' ],
+	qr/^Statistics objects:\n    public\.stxtest_ab \(ndistinct, dependencies, mcv\) ON a, b FROM stxtest$/m,
+	'psql \d shows extended statistics');
+
+psql 'postgres', 'CREATE TABLE cmtest (a text COMPRESSION pglz, b text)';
+command_like(
+	[ 'pg_dump', '-s', '-t', 'cmtest', 'postgres' ],
+	qr/^ALTER TABLE ONLY cmtest ALTER COLUMN a SET COMPRESSION pglz;$(?!.*COLUMN b SET COMPRESSION)/ms,
+	'column compression method is dumped');
+
+psql 'postgres',
+    'CREATE TABLE pubtest (a int); '
+  . 'CREATE PUBLICATION pub1 FOR TABLE pubtest; '
+  . 'CREATE PUBLICATION puball FOR ALL TABLES; '
+  . "CREATE SUBSCRIPTION sub1 CONNECTION 'dbname=nosuchdb' "
+  . 'PUBLICATION pub1, puball WITH (enabled = false, streaming = true)';
+command_like(
+	[ 'pg_dump', '-s', 'postgres' ],
+	qr/^CREATE PUBLICATION puball FOR ALL TABLES;$/m,
+	'publication is dumped');
+command_like(
+	[ 'pg_dump', '-s', 'postgres' ],
+	qr/^ALTER PUBLICATION pub1 ADD TABLE ONLY pubtest;$/m,
+	'publication membership is dumped');
+command_like(
+	[ 'pg_dump', '-s', 'postgres' ],
+	qr/^CREATE SUBSCRIPTION sub1 CONNECTION 'dbname=nosuchdb' PUBLICATION pub1, puball WITH \(enabled = false, slot_name = 'sub1', streaming = true\);$/m,
+	'subscription is dumped disabled');
+command_like(
+	[ 'psql', '-X', '-c', '\dRp+ pub1', 'postgres' ],
+	qr/^Tables:\n    "public\.pubtest"$/m,
+	'psql \dRp+ shows publication tables');
+command_like(
+	[ 'psql', '-X', '-A', '-t', '-c', '\dRs', 'postgres' ],
+	qr/^sub1\|.*\|f\|\{pub1,puball\}$/m,
+	'psql \dRs lists subscriptions');
+
+# Everything dumped must restore into an empty database
+command_ok([ 'createdb', 'restored' ], 'create database to restore into');
+command_ok([ 'pg_dump', '-f', "$tempdir/dump.sql", 'postgres' ],
+	'dump database');
+command_ok(
+	[   'psql', '-X', '-q', '-v', 'ON_ERROR_STOP=1',
+		'-f', "$tempdir/dump.sql", 'restored' ],
+	'restore dump');
+
+command_like(
+	[   'psql', '-X', '-A', '-t', '-c',
+		"SELECT relam::regproc FROM pg_class WHERE relname = 'amtest'",
+		'restored' ],
+	qr/^columnar$/m,
+	'restored table uses the same access method');
@@ -29,6 +29,16 @@ main(int argc, char *argv[])
 
 	handle_args(argc, argv);
 
+	/* test the clock that EXPLAIN ANALYZE uses */
+	pg_initialize_timing();
+#ifdef HAVE_INSTR_TIME_TSC
+	if (pg_timing_use_tsc)
+		printf("Using the CPU time-stamp counter, %0.3f nsec per tick.\n",
+			   pg_timing_ns_per_tsc);
+	else
+#endif
+		printf("Using the system clock.\n");
+
 	loop_count = test_timing(test_duration);
 
 	output(loop_count);
@@ -117,7 +127,7 @@ test_timing(int32 duration)
 
 	total_time = duration > 0 ? duration * INT64CONST(1000000) : 0;
 
-	INSTR_TIME_SET_CURRENT(start_time);
+	INSTR_TIME_SET_CURRENT_FAST(start_time);
 	cur = INSTR_TIME_GET_MICROSEC(start_time);
 
 	while (time_elapsed < total_time)
@@ -126,7 +136,7 @@ test_timing(int32 duration)
 					bits = 0;
 
 		prev = cur;
-		INSTR_TIME_SET_CURRENT(temp);
+		INSTR_TIME_SET_CURRENT_FAST(temp);
 		cur = INSTR_TIME_GET_MICROSEC(temp);
 		diff = cur - prev;
 
@@ -153,7 +163,7 @@ test_timing(int32 duration)
 		time_elapsed = INSTR_TIME_GET_MICROSEC(temp);
 	}
 
-	INSTR_TIME_SET_CURRENT(end_time);
+	INSTR_TIME_SET_CURRENT_FAST(end_time);
 
 	INSTR_TIME_SUBTRACT(end_time, start_time);
 
@@ -12,6 +12,12 @@
 #include "pg_upgrade.h"
 
 #include <fcntl.h>
+#include <sys/stat.h>
+
+#include "access/visibilitymap.h"
+#include "storage/bufpage.h"
+#include "storage/checksum.h"
+#include "storage/checksum_impl.h"
 
 
 
@@ -127,6 +133,127 @@ linkAndUpdateFile(pageCnvCtx *pageConverter,
 }
 
 
+/*
+ * rewriteVisibilityMap()
+ *
+ * Copies a visibility map file from src to dst, converting it from the old
+ * format with one bit per heap page to the current one, which also has an
+ * all-frozen bit per heap page.  The all-visible bits are kept and the
+ * all-frozen bits are left clear, so each old page becomes two new ones;
+ * but the second half of the last old page is dropped if it has no bits
+ * set, as the server would never have extended the map that far.
+ */
+const char *
+rewriteVisibilityMap(const char *src, const char *dst)
+{
+	int			src_fd;
+	int			dst_fd;
+	char		old_page[BLCKSZ];
+	char		new_page[BLCKSZ];
+	ssize_t		bytesRead;
+	struct stat statbuf;
+	BlockNumber old_nblocks;
+	BlockNumber old_blkno = 0;
+	BlockNumber new_blkno = 0;
+	const char *msg = NULL;
+
+	/* number of old map bytes that fill a new page */
+	const int	bytes_per_half = (BLCKSZ - SizeOfPageHeaderData) / 2;
+
+	if ((src_fd = open(src, O_RDONLY | PG_BINARY, 0)) < 0)
+		return getErrorText();
+
+	if (fstat(src_fd, &statbuf) != 0)
+	{
+		msg = getErrorText();
+		close(src_fd);
+		return msg;
+	}
+	old_nblocks = statbuf.st_size / BLCKSZ;
+
+	if ((dst_fd = open(dst, O_RDWR | O_CREAT | O_EXCL | PG_BINARY,
+					   S_IRUSR | S_IWUSR)) < 0)
+	{
+		msg = getErrorText();
+		close(src_fd);
+		return msg;
+	}
+
+	while ((bytesRead = read(src_fd, old_page, BLCKSZ)) == BLCKSZ)
+	{
+		int			half;
+
+		for (half = 0; half < 2; half++)
+		{
+			uint8	   *old_cur;
+			uint8	   *new_cur;
+			bool		empty = true;
+			int			i;
+
+			/* The new page gets the old one's header */
+			memcpy(new_page, old_page, SizeOfPageHeaderData);
+
+			old_cur = (uint8 *) old_page + SizeOfPageHeaderData +
+				half * bytes_per_half;
+			new_cur = (uint8 *) new_page + SizeOfPageHeaderData;
+
+			/* Each old byte covers 8 heap pages, each new one only 4 */
+			for (i = 0; i < bytes_per_half; i++)
+			{
+				uint8		byte = old_cur[i];
+				uint16		new_bits = 0;
+				int			bit;
+
+				for (bit = 0; bit < BITS_PER_BYTE; bit++)
+				{
+					if (byte & (1 << bit))
+						new_bits |= VISIBILITYMAP_ALL_VISIBLE <<
+							(BITS_PER_HEAPBLOCK * bit);
+				}
+				if (new_bits != 0)
+					empty = false;
+
+				new_cur[2 * i] = (uint8) (new_bits & 0xFF);
+				new_cur[2 * i + 1] = (uint8) (new_bits >> 8);
+			}
+
+			/* Don't extend the map with an empty page at its end */
+			if (half == 1 && empty && old_blkno + 1 == old_nblocks)
+				break;
+
+			if (new_cluster.controldata.data_checksum_version != 0)
+				((PageHeader) new_page)->pd_checksum =
+					pg_checksum_page(new_page, new_blkno);
+
+			errno = 0;
+			if (write(dst_fd, new_page, BLCKSZ) != BLCKSZ)
+			{
+				/* if write didn't set errno, assume problem is no disk space */
+				if (errno == 0)
+					errno = ENOSPC;
+				msg = getErrorText();
+				break;
+			}
+			new_blkno++;
+		}
+
+		if (msg)
+			break;
+		old_blkno++;
+	}
+
+	if (!msg && bytesRead < 0)
+		msg = getErrorText();
+	else if (!msg && bytesRead != 0)
+		msg = "found partial page in source file";
+
+	close(src_fd);
+	close(dst_fd);
+
+	return msg;
+}
+
+
 #ifndef WIN32
 static int
 copy_file(const char *srcfile, const char *dstfile, bool force)
@@ -128,6 +128,12 @@ extern char *output_files[];
  */
 #define JSONB_FORMAT_CHANGE_CAT_VER 201409291
 
+/*
+ * The visibility map gained an all-frozen bit for each heap page, which
+ * doubled its size, with this catalog version.
+ */
+#define VISIBILITY_MAP_FROZEN_BIT_CAT_VER 201610152
+
 /*
  * Each relation is represented by a relinfo structure.
  */
@@ -397,6 +403,7 @@ const char *copyAndUpdateFile(pageCnvCtx *pageConverter, const char *src,
 				  const char *dst, bool force);
 const char *linkAndUpdateFile(pageCnvCtx *pageConverter, const char *src,
 				  const char *dst);
+const char *rewriteVisibilityMap(const char *src, const char *dst);
 
 void		check_hard_link(void);
 FILE	   *fopen_priv(const char *path, const char *mode);
@@ -181,6 +181,7 @@ int			progress_nthreads = 0;		/* number of threads for progress
 										 * report */
 bool		is_connect;			/* establish connection for each transaction */
 bool		is_latencies;		/* report per-command latencies */
+bool		latency_percentiles;	/* report latency percentiles */
 int			main_pid;			/* main process id used in log filename */
 
 char	   *pghost = "";
@@ -201,6 +202,28 @@ typedef struct
 #define MAX_FILES		128		/* max number of SQL script files allowed */
 #define SHELL_COMMAND_SIZE	256 /* maximum size allowed for shell command */
 
+/*
+ * Histogram of transaction latencies in microseconds.  The buckets grow
+ * logarithmically, the way HdrHistogram's do: values below twice
+ * LATENCY_HIST_SUB each get a bucket of their own, and above that every
+ * power of two is split into LATENCY_HIST_SUB buckets, so a value read back
+ * from the histogram is within about 3% of the recorded one whatever its
+ * magnitude.  Values of 2^LATENCY_HIST_MAX_BITS us (19 hours) and more all
+ * go to the last bucket.
+ */
+#define LATENCY_HIST_SUB_BITS	5
+#define LATENCY_HIST_SUB		(1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_MAX_BITS	36
+#define LATENCY_HIST_BUCKETS	\
+	((LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB)
+
+typedef struct
+{
+	int64		count;			/* number of values recorded */
+	int64		max;			/* largest value recorded */
+	int64		buckets[LATENCY_HIST_BUCKETS];
+} LatencyHist;
+
 /*
  * structures used in custom query mode
  */
@@ -226,6 +249,7 @@ typedef struct
 	bool		is_throttled;	/* whether transaction throttling is done */
 	int			use_file;		/* index in sql_files for this client */
 	bool		prepared[MAX_FILES];
+	bool		in_pipeline;	/* between \startpipeline and \endpipeline */
 } CState;
 
 /*
@@ -240,6 +264,7 @@ typedef struct
 	instr_time	start_time;		/* thread start time */
 	instr_time *exec_elapsed;	/* time spent executing cmds (per Command) */
 	int		   *exec_count;		/* number of cmd executions (per Command) */
+	LatencyHist *latency_hist;	/* transaction latencies (per script file) */
 	unsigned short random_state[3];		/* separate randomness for each thread */
 	int64		throttle_trigger;		/* previous/next throttling (us) */
 	int64		throttle_lag;	/* total transaction lag behind throttling */
@@ -404,6 +429,7 @@ usage(void)
 		 "  -T, --time=NUM           duration of benchmark test in seconds\n"
 		   "  -v, --vacuum-all         vacuum all four standard tables before tests\n"
 		   "  --aggregate-interval=NUM aggregate data over NUM seconds\n"
+		   "  --latency-percentiles    report latency percentiles per script\n"
 		   "  --sampling-rate=NUM      fraction of transactions to log (e.g. 0.01 for 1%%)\n"
 		   "\nCommon options:\n"
 		   "  -d, --debug              print debugging output\n"
@@ -1171,6 +1197,205 @@ agg_vals_init(AggVals *aggs, instr_time start)
 	aggs->start_time = INSTR_TIME_GET_DOUBLE(start);
 }
 
+/* map a latency in microseconds to its histogram bucket */
+static int
+latencyHistBucket(int64 value)
+{
+	int			shift = 0;
+
+	if (value < 2 * LATENCY_HIST_SUB)
+		return (int) Max(value, 0);
+
+	while ((value >> shift) >= 2 * LATENCY_HIST_SUB)
+		shift++;
+	if (shift > LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS - 1)
+		return LATENCY_HIST_BUCKETS - 1;
+	return shift * LATENCY_HIST_SUB + (int) (value >> shift);
+}
+
+/* the highest latency that falls in a histogram bucket */
+static int64
+latencyHistValue(int bucket)
+{
+	int			shift;
+
+	if (bucket < 2 * LATENCY_HIST_SUB)
+		return bucket;
+
+	shift = bucket / LATENCY_HIST_SUB - 1;
+	return ((int64) (bucket - shift * LATENCY_HIST_SUB + 1) << shift) - 1;
+}
+
+static void
+latencyHistRecord(LatencyHist *hist, int64 latency)
+{
+	hist->buckets[latencyHistBucket(latency)]++;
+	hist->count++;
+	if (latency > hist->max)
+		hist->max = latency;
+}
+
+/* add the contents of src to dst */
+static void
+latencyHistAdd(LatencyHist *dst, const LatencyHist *src)
+{
+	int			i;
+
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * Return the latency below which the given percentage of the recorded
+ * latencies fall, in microseconds.
+ */
+static int64
+latencyHistPercentile(const LatencyHist *hist, double percent)
+{
+	int64		rank = (int64) ceil(hist->count * percent / 100.0);
+	int64		seen = 0;
+	int			i;
+
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	return Min(latencyHistValue(i), hist->max);
+}
+
+/* add up the latency histograms of all script files of the given threads */
+static void
+sumLatencyHists(LatencyHist *result, TState *threads, int nthreads)
+{
+	int			i,
+				f;
+
+	memset(result, 0, sizeof(LatencyHist));
+	for (i = 0; i < nthreads; i++)
+		for (f = 0; f < num_files; f++)
+			latencyHistAdd(result, &threads[i].latency_hist[f]);
+}
+
+/*
+ * Print the latency percentiles of a progress report interval, given the
+ * histograms at its start and its end.  The latter becomes the former for
+ * the next interval.
+ */
+static void
+printProgressPercentiles(LatencyHist *last, LatencyHist *now)
+{
+	LatencyHist interval;
+	int			i;
+
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		interval.buckets[i] = now->buckets[i] - last->buckets[i];
+	interval.count = now->count - last->count;
+	interval.max = now->max;
+
+	if (interval.count > 0)
+		fprintf(stderr, ", p50 %.3f p99 %.3f p99.9 %.3f ms",
+				0.001 * latencyHistPercentile(&interval, 50.0),
+				0.001 * latencyHistPercentile(&interval, 99.0),
+				0.001 * latencyHistPercentile(&interval, 99.9));
+
+	memcpy(last, now, sizeof(LatencyHist));
+}
+
+/* prepare the statements of the client's current script, if not done yet */
+static void
+prepareCommands(CState *st)
+{
+	Command   **commands = sql_files[st->use_file];
+	int			j;
+
+	if (st->prepared[st->use_file])
+		return;
+
+	for (j = 0; commands[j] != NULL; j++)
+	{
+		PGresult   *res;
+		char		name[MAX_PREPARE_NAME];
+
+		if (commands[j]->type != SQL_COMMAND)
+			continue;
+		preparedStatementName(name, st->use_file, j);
+		res = PQprepare(st->con, name,
+						commands[j]->argv[0], commands[j]->argc - 1, NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			fprintf(stderr, "%s", PQerrorMessage(st->con));
+		PQclear(res);
+	}
+	st->prepared[st->use_file] = true;
+}
+
+static bool
+isPipelineEnd(const Command *command)
+{
+	return command->type == META_COMMAND &&
+		pg_strcasecmp(command->argv[0], "endpipeline") == 0;
+}
+
+/*
+ * Is the client waiting for the results of a pipeline?  Its current command
+ * is then the \endpipeline meta command, but it's the socket that tells when
+ * the client can proceed.
+ */
+static bool
+waitingForPipeline(CState *st)
+{
+	return st->in_pipeline && st->listen &&
+		isPipelineEnd(sql_files[st->use_file][st->state]);
+}
+
+/*
+ * Read the results of a pipeline, up to the synchronization point that
+ * \endpipeline sent, and leave pipeline mode.  Returns 1 when done, 0 if
+ * more results are yet to arrive, or -1 if a command failed.
+ */
+static int
+readPipelineResults(CState *st)
+{
+	while (!PQisBusy(st->con))
+	{
+		PGresult   *res = PQgetResult(st->con);
+
+		if (res == NULL)
+			continue;			/* on to the next command's results */
+
+		switch (PQresultStatus(res))
+		{
+			case PGRES_COMMAND_OK:
+			case PGRES_TUPLES_OK:
+				break;			/* OK */
+			case PGRES_PIPELINE_SYNC:
+				PQclear(res);
+				if (!PQexitPipelineMode(st->con))
+				{
+					fprintf(stderr, "client %d could not leave pipeline mode: %s",
+							st->id, PQerrorMessage(st->con));
+					return -1;
+				}
+				st->in_pipeline = false;
+				return 1;
+			default:
+				fprintf(stderr, "client %d aborted in state %d: %s",
+						st->id, st->state, PQerrorMessage(st->con));
+				PQclear(res);
+				return -1;
+		}
+		PQclear(res);
+	}
+
+	return 0;
+}
+
 /* return false iff client should be disconnected */
 static bool
 doCustom(TState *thread, CState *st, instr_time *conn_time, FILE *logfile, AggVals *agg)
@@ -1273,7 +1498,7 @@ top:
 
 	if (st->listen)
 	{							/* are we receiver? */
-		if (commands[st->state]->type == SQL_COMMAND)
+		if (commands[st->state]->type == SQL_COMMAND && !st->in_pipeline)
 		{
 			if (debug)
 				fprintf(stderr, "client %d receiving\n", st->id);
@@ -1285,10 +1510,30 @@ top:
 			if (PQisBusy(st->con))
 				return true;	/* don't have the whole result yet */
 		}
+		else if (st->in_pipeline && isPipelineEnd(commands[st->state]))
+		{
+			int			r;
+
+			if (debug)
+				fprintf(stderr, "client %d receiving pipeline results\n",
+						st->id);
+			if (!PQconsumeInput(st->con))
+			{					/* there's something wrong */
+				fprintf(stderr, "client %d aborted in state %d; perhaps the backend died while processing\n", st->id, st->state);
+				return clientDone(st, false);
+			}
+			r = readPipelineResults(st);
+			if (r < 0)
+				return clientDone(st, false);
+			if (r == 0)
+				return true;	/* don't have all the results yet */
+		}
 
 		/*
 		 * command finished: accumulate per-command execution times in
-		 * thread-local data structure, if per-command latencies are requested
+		 * thread-local data structure, if per-command latencies are requested.
+		 * For a command sent in a pipeline that only covers sending it; the
+		 * wait for its result is counted against \endpipeline.
 		 */
 		if (is_latencies)
 		{
@@ -1305,7 +1550,8 @@ top:
 		if (commands[st->state + 1] == NULL)
 		{
 			/* only calculate latency if an option is used that needs it */
-			if (progress || throttle_delay || latency_limit)
+			if (progress || throttle_delay || latency_limit ||
+				latency_percentiles)
 			{
 				int64		latency;
 
@@ -1328,6 +1574,10 @@ top:
 				/* record over the limit transactions if needed. */
 				if (latency_limit && latency > latency_limit)
 					thread->latency_late++;
+
+				if (latency_percentiles)
+					latencyHistRecord(&thread->latency_hist[st->use_file],
+									  latency);
 			}
 
 			/* record the time it took in the log */
@@ -1335,7 +1585,7 @@ top:
 				doLog(thread, st, logfile, &now, agg, false);
 		}
 
-		if (commands[st->state]->type == SQL_COMMAND)
+		if (commands[st->state]->type == SQL_COMMAND && !st->in_pipeline)
 		{
 			/*
 			 * Read and discard the query result; note this is not included in
@@ -1411,6 +1661,7 @@ top:
 		st->sleeping = 0;
 		st->throttling = false;
 		st->is_throttled = false;
+		st->in_pipeline = false;
 		memset(st->prepared, 0, sizeof(st->prepared));
 	}
 
@@ -1426,7 +1677,8 @@ top:
 	}
 
 	/* Record transaction start time under logging, progress or throttling */
-	if ((logfile || progress || throttle_delay || latency_limit) && st->state == 0)
+	if ((logfile || progress || throttle_delay || latency_limit ||
+		 latency_percentiles) && st->state == 0)
 	{
 		INSTR_TIME_SET_CURRENT(st->txn_begin);
 
@@ -1476,26 +1728,7 @@ top:
 			char		name[MAX_PREPARE_NAME];
 			const char *params[MAX_ARGS];
 
-			if (!st->prepared[st->use_file])
-			{
-				int			j;
-
-				for (j = 0; commands[j] != NULL; j++)
-				{
-					PGresult   *res;
-					char		name[MAX_PREPARE_NAME];
-
-					if (commands[j]->type != SQL_COMMAND)
-						continue;
-					preparedStatementName(name, st->use_file, j);
-					res = PQprepare(st->con, name,
-						  commands[j]->argv[0], commands[j]->argc - 1, NULL);
-					if (PQresultStatus(res) != PGRES_COMMAND_OK)
-						fprintf(stderr, "%s", PQerrorMessage(st->con));
-					PQclear(res);
-				}
-				st->prepared[st->use_file] = true;
-			}
+			prepareCommands(st);
 
 			getQueryParams(st, command, params);
 			preparedStatementName(name, st->use_file, st->state);
@@ -1516,7 +1749,13 @@ top:
 			st->ecnt++;
 		}
 		else
+		{
 			st->listen = 1;		/* flags that should be listened */
+
+			/* in a pipeline, go on without waiting for the result */
+			if (st->in_pipeline)
+				goto top;
+		}
 	}
 	else if (commands[st->state]->type == META_COMMAND)
 	{
@@ -1754,6 +1993,38 @@ top:
 			else	/* succeeded */
 				st->listen = 1;
 		}
+		else if (pg_strcasecmp(argv[0], "startpipeline") == 0)
+		{
+			/*
+			 * The statements must be prepared first, since PQprepare can't be
+			 * used in pipeline mode.
+			 */
+			if (querymode == QUERY_PREPARED)
+				prepareCommands(st);
+
+			if (!PQenterPipelineMode(st->con))
+			{
+				fprintf(stderr, "client %d could not enter pipeline mode: %s",
+						st->id, PQerrorMessage(st->con));
+				st->ecnt++;
+				return true;
+			}
+			st->in_pipeline = true;
+			st->listen = 1;
+		}
+		else if (pg_strcasecmp(argv[0], "endpipeline") == 0)
+		{
+			if (!PQpipelineSync(st->con))
+			{
+				fprintf(stderr, "client %d could not send pipeline sync: %s",
+						st->id, PQerrorMessage(st->con));
+				st->ecnt++;
+				return true;
+			}
+
+			/* the results are read as they arrive, see above */
+			st->listen = 1;
+		}
 		goto top;
 	}
 
@@ -1897,14 +2168,16 @@ doLog(TState *thread, CState *st, FILE *logfile, instr_time *now, AggVals *agg,
 #ifndef WIN32
 
 		/* This is more than we really ought to know about instr_time */
+		uint64		now_us = INSTR_TIME_GET_MICROSEC(*now);
+
 		if (skipped)
 			fprintf(logfile, "%d %d skipped %d %ld %ld",
 					st->id, st->cnt, st->use_file,
-					(long) now->tv_sec, (long) now->tv_usec);
+					(long) (now_us / 1000000), (long) (now_us % 1000000));
 		else
 			fprintf(logfile, "%d %d %.0f %d %ld %ld",
 					st->id, st->cnt, latency, st->use_file,
-					(long) now->tv_sec, (long) now->tv_usec);
+					(long) (now_us / 1000000), (long) (now_us % 1000000));
 #else
 
 		/* On Windows, instr_time doesn't provide a timestamp anyway */
@@ -2470,6 +2743,24 @@ process_commands(char *buf, const char *source, const int lineno)
 							 "missing command", NULL, -1);
 			}
 		}
+		else if (pg_strcasecmp(my_commands->argv[0], "startpipeline") == 0 ||
+				 pg_strcasecmp(my_commands->argv[0], "endpipeline") == 0)
+		{
+			if (my_commands->argc > 1)
+			{
+				syntax_error(source, lineno, my_commands->line, my_commands->argv[0],
+							 "unexpected argument", my_commands->argv[1],
+							 my_commands->cols[1]);
+			}
+
+			/* the simple query protocol can't be pipelined */
+			if (querymode == QUERY_SIMPLE)
+			{
+				syntax_error(source, lineno, my_commands->line, my_commands->argv[0],
+							 "pipeline mode requires the extended or prepared protocol (-M)",
+							 NULL, -1);
+			}
+		}
 		else
 		{
 			syntax_error(source, lineno, my_commands->line, my_commands->argv[0],
@@ -2542,6 +2833,54 @@ read_line_from_file(FILE *fd)
 	return NULL;
 }
 
+/*
+ * Check that every \startpipeline of a script is closed by an \endpipeline
+ * further on, with no nesting, so that a transaction never ends with a
+ * pipeline still open.
+ */
+static void
+checkPipelines(Command **commands, const char *source)
+{
+	bool		in_pipeline = false;
+	int			i;
+
+	for (i = 0; commands[i] != NULL; i++)
+	{
+		Command    *command = commands[i];
+
+		if (command->type != META_COMMAND)
+			continue;
+
+		if (pg_strcasecmp(command->argv[0], "startpipeline") == 0)
+		{
+			if (in_pipeline)
+			{
+				fprintf(stderr, "%s: \\startpipeline cannot be nested: \"%s\"\n",
+						source, command->line);
+				exit(1);
+			}
+			in_pipeline = true;
+		}
+		else if (pg_strcasecmp(command->argv[0], "endpipeline") == 0)
+		{
+			if (!in_pipeline)
+			{
+				fprintf(stderr, "%s: \\endpipeline without \\startpipeline: \"%s\"\n",
+						source, command->line);
+				exit(1);
+			}
+			in_pipeline = false;
+		}
+	}
+
+	if (in_pipeline)
+	{
+		fprintf(stderr, "%s: \\startpipeline without \\endpipeline at end of script\n",
+				source);
+		exit(1);
+	}
+}
+
 static int
 process_file(char *filename)
 {
@@ -2602,6 +2941,8 @@ process_file(char *filename)
 
 	my_commands[index] = NULL;
 
+	checkPipelines(my_commands, filename);
+
 	sql_files[num_files++] = my_commands;
 
 	return true;
@@ -2722,7 +3063,7 @@ printResults(int ttype, int64 normal_xacts, int nclients,
 			   latency_limit / 1000.0, latency_late,
 		   100.0 * latency_late / (throttle_latency_skipped + normal_xacts));
 
-	if (throttle_delay || progress || latency_limit)
+	if (throttle_delay || progress || latency_limit || latency_percentiles)
 	{
 		/* compute and show latency average and standard deviation */
 		double		latency = 0.001 * total_latencies / normal_xacts;
@@ -2754,6 +3095,39 @@ printResults(int ttype, int64 normal_xacts, int nclients,
 	printf("tps = %f (including connections establishing)\n", tps_include);
 	printf("tps = %f (excluding connections establishing)\n", tps_exclude);
 
+	/* Report latency percentiles per script */
+	if (latency_percentiles)
+	{
+		static const double percents[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+		int			i,
+					p,
+					t;
+
+		for (i = 0; i < num_files; i++)
+		{
+			LatencyHist hist;
+
+			memset(&hist, 0, sizeof(hist));
+			for (t = 0; t < nthreads; t++)
+				latencyHistAdd(&hist, &threads[t].latency_hist[i]);
+
+			if (num_files > 1)
+				printf("latency percentiles in milliseconds, file %d (" INT64_FORMAT " transactions):\n",
+					   i + 1, hist.count);
+			else
+				printf("latency percentiles in milliseconds:\n");
+
+			if (hist.count == 0)
+				continue;
+
+			for (p = 0; p < lengthof(percents); p++)
+				printf("\t%g%%\t%.3f\n",
+					   percents[p],
+					   0.001 * latencyHistPercentile(&hist, percents[p]));
+			printf("\tmax\t%.3f\n", 0.001 * hist.max);
+		}
+	}
+
 	/* Report per-command latencies */
 	if (is_latencies)
 	{
@@ -2838,6 +3212,7 @@ main(int argc, char **argv)
 		{"aggregate-interval", required_argument, NULL, 5},
 		{"rate", required_argument, NULL, 'R'},
 		{"latency-limit", required_argument, NULL, 'L'},
+		{"latency-percentiles", no_argument, NULL, 6},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -3166,6 +3541,10 @@ main(int argc, char **argv)
 				}
 #endif
 				break;
+			case 6:
+				benchmarking_option_set = true;
+				latency_percentiles = true;
+				break;
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit(1);
@@ -3251,10 +3630,10 @@ main(int argc, char **argv)
 	}
 
 	/*
-	 * is_latencies only works with multiple threads in thread-based
-	 * implementations, not fork-based ones, because it supposes that the
-	 * parent can see changes made to the per-thread execution stats by child
-	 * threads.  It seems useful enough to accept despite this limitation, but
+	 * is_latencies and latency_percentiles only work with multiple threads
+	 * in thread-based implementations, not fork-based ones, because they
+	 * suppose that the parent can see changes made to the per-thread
+	 * execution stats by child threads.  It seems useful enough to accept despite this limitation, but
 	 * perhaps we should FIXME someday (by passing the stats data back up
 	 * through the parent-to-child pipes).
 	 */
@@ -3264,6 +3643,11 @@ main(int argc, char **argv)
 		fprintf(stderr, "-r does not work with -j larger than 1 on this platform.\n");
 		exit(1);
 	}
+	if (latency_percentiles && nthreads > 1)
+	{
+		fprintf(stderr, "--latency-percentiles does not work with -j larger than 1 on this platform.\n");
+		exit(1);
+	}
 #endif
 
 	/*
@@ -3453,6 +3837,14 @@ main(int argc, char **argv)
 			thread->exec_elapsed = NULL;
 			thread->exec_count = NULL;
 		}
+
+		if (latency_percentiles)
+		{
+			thread->latency_hist = (LatencyHist *)
+				pg_malloc0(sizeof(LatencyHist) * num_files);
+		}
+		else
+			thread->latency_hist = NULL;
 	}
 
 	/* get start up time */
@@ -3557,6 +3949,8 @@ threadRun(void *arg)
 				last_sqlats = 0,
 				last_lags = 0,
 				last_skipped = 0;
+	LatencyHist *last_hist = NULL,
+			   *now_hist = NULL;
 
 	AggVals		aggs;
 
@@ -3575,6 +3969,13 @@ threadRun(void *arg)
 
 	INSTR_TIME_SET_ZERO(result->conn_time);
 
+	/* latency histograms at the last progress report, and now */
+	if (progress && latency_percentiles)
+	{
+		last_hist = pg_malloc0(sizeof(LatencyHist));
+		now_hist = pg_malloc0(sizeof(LatencyHist));
+	}
+
 	/* open log file if requested */
 	if (use_log)
 	{
@@ -3681,7 +4082,8 @@ threadRun(void *arg)
 						min_usec = this_usec;
 				}
 			}
-			else if (commands[st->state]->type == META_COMMAND)
+			else if (commands[st->state]->type == META_COMMAND &&
+					 !waitingForPipeline(st))
 			{
 				min_usec = 0;	/* the connection is ready to run */
 				break;
@@ -3768,7 +4170,8 @@ threadRun(void *arg)
 					goto done;
 				}
 				if (FD_ISSET(sock, &input_mask) ||
-					commands[st->state]->type == META_COMMAND)
+					(commands[st->state]->type == META_COMMAND &&
+					 !waitingForPipeline(st)))
 				{
 					if (!doCustom(thread, st, &result->conn_time, logfile, &aggs))
 						remains--;	/* I've aborted */
@@ -3835,6 +4238,11 @@ threadRun(void *arg)
 					if (latency_limit)
 						fprintf(stderr, ", skipped " INT64_FORMAT, skipped);
 				}
+				if (latency_percentiles)
+				{
+					sumLatencyHists(now_hist, thread, 1);
+					printProgressPercentiles(last_hist, now_hist);
+				}
 				fprintf(stderr, "\n");
 
 				last_count = count;
@@ -3907,6 +4315,11 @@ threadRun(void *arg)
 					if (latency_limit)
 						fprintf(stderr, ", " INT64_FORMAT " skipped", skipped);
 				}
+				if (latency_percentiles)
+				{
+					sumLatencyHists(now_hist, thread, progress_nthreads);
+					printProgressPercentiles(last_hist, now_hist);
+				}
 				fprintf(stderr, "\n");
 
 				last_count = count;
@@ -3950,6 +4363,10 @@ done:
 	INSTR_TIME_ACCUM_DIFF(result->conn_time, end, start);
 	if (logfile)
 		fclose(logfile);
+	if (last_hist)
+		free(last_hist);
+	if (now_hist)
+		free(now_hist);
 	return result;
 }
 
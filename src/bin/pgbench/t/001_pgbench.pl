@@ -2,7 +2,7 @@ use strict;
 use warnings;
 
 use TestLib;
-use Test::More tests => 3;
+use Test::More tests => 6;
 
 # Test concurrent insertion into table with UNIQUE oid column.  DDL expects
 # GetNewOidWithIndex() to successfully avoid violating uniqueness for indexes
@@ -22,3 +22,17 @@ command_like(
 		  --transactions=25 --file), $script, 'postgres' ],
 	qr{processed: 125/125},
 	'concurrent OID generation');
+
+# Run the same inserts in a pipeline, and check the percentile report.
+open $fh, ">", $script or die "could not open file $script";
+print $fh "\\startpipeline\n"
+  . "INSERT INTO oid_tbl SELECT FROM generate_series(1,10);\n"
+  . "INSERT INTO oid_tbl SELECT FROM generate_series(1,10);\n"
+  . "\\endpipeline\n";
+close $fh;
+command_like(
+	[   qw(pgbench --no-vacuum --client=5 --protocol=extended
+		  --transactions=25 --latency-percentiles --file), $script,
+		'postgres' ],
+	qr{processed: 125/125.*latency percentiles in milliseconds:.*99\.9%}s,
+	'pipelined inserts with latency percentiles');
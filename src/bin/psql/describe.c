@@ -1241,6 +1241,7 @@ describeOneTableDetails(const char *schemaname,
 		char	   *reloftype;
 		char		relpersistence;
 		char		relreplident;
+		char	   *amname;
 	}			tableinfo;
 	bool		show_modifiers = false;
 	bool		retval;
@@ -1263,7 +1264,8 @@ describeOneTableDetails(const char *schemaname,
 				"c.relhastriggers, c.relrowsecurity, c.relforcerowsecurity, "
 						  "c.relhasoids, %s, c.reltablespace, "
 						  "CASE WHEN c.reloftype = 0 THEN '' ELSE c.reloftype::pg_catalog.regtype::pg_catalog.text END, "
-						  "c.relpersistence, c.relreplident\n"
+						  "c.relpersistence, c.relreplident, "
+						  "CASE WHEN c.relkind = 'r' AND c.relam <> 0 THEN c.relam::pg_catalog.regproc::pg_catalog.text ELSE '' END\n"
 						  "FROM pg_catalog.pg_class c\n "
 		   "LEFT JOIN pg_catalog.pg_class tc ON (c.reltoastrelid = tc.oid)\n"
 						  "WHERE c.oid = '%s';",
@@ -1399,6 +1401,9 @@ describeOneTableDetails(const char *schemaname,
 		*(PQgetvalue(res, 0, 11)) : 0;
 	tableinfo.relreplident = (pset.sversion >= 90400) ?
 		*(PQgetvalue(res, 0, 12)) : 'd';
+	tableinfo.amname = (pset.sversion >= 90500 &&
+						strcmp(PQgetvalue(res, 0, 13), "") != 0) ?
+		pg_strdup(PQgetvalue(res, 0, 13)) : NULL;
 	PQclear(res);
 	res = NULL;
 
@@ -2104,6 +2109,54 @@ describeOneTableDetails(const char *schemaname,
 			PQclear(result);
 		}
 
+		/* print any extended statistics */
+		if (pset.sversion >= 90500)
+		{
+			printfPQExpBuffer(&buf,
+							  "SELECT pg_catalog.quote_ident(n.nspname) || '.' ||\n"
+							  "  pg_catalog.quote_ident(s.stxname),\n"
+							  "  pg_catalog.array_to_string(ARRAY(\n"
+							  "    SELECT CASE k.kind WHEN 'd' THEN 'ndistinct'\n"
+							  "      WHEN 'f' THEN 'dependencies'\n"
+							  "      WHEN 'm' THEN 'mcv' END\n"
+							  "    FROM pg_catalog.unnest(s.stxkind)\n"
+							  "      WITH ORDINALITY k(kind, n) ORDER BY k.n), ', '),\n"
+							  "  pg_catalog.array_to_string(ARRAY(\n"
+							  "    SELECT pg_catalog.quote_ident(a.attname)\n"
+							  "    FROM pg_catalog.unnest(s.stxkeys::pg_catalog.int2[])\n"
+							  "      WITH ORDINALITY k(attnum, n)\n"
+							  "    JOIN pg_catalog.pg_attribute a\n"
+							  "      ON (a.attrelid = s.stxrelid AND a.attnum = k.attnum)\n"
+							  "    ORDER BY k.n), ', ')\n"
+							  "FROM pg_catalog.pg_statistic_ext s\n"
+							  "JOIN pg_catalog.pg_namespace n ON n.oid = s.stxnamespace\n"
+							  "WHERE s.stxrelid = '%s'\n"
+							  "ORDER BY 1;",
+							  oid);
+
+			result = PSQLexec(buf.data);
+			if (!result)
+				goto error_return;
+			else
+				tuples = PQntuples(result);
+
+			if (tuples > 0)
+			{
+				printTableAddFooter(&cont, _("Statistics objects:"));
+
+				for (i = 0; i < tuples; i++)
+				{
+					printfPQExpBuffer(&buf, "    %s (%s) ON %s FROM %s",
+									  PQgetvalue(result, i, 0),
+									  PQgetvalue(result, i, 1),
+									  PQgetvalue(result, i, 2),
+									  relationname);
+					printTableAddFooter(&cont, buf.data);
+				}
+			}
+			PQclear(result);
+		}
+
 		/* print rules */
 		if (tableinfo.hasrules && tableinfo.relkind != 'm')
 		{
@@ -2531,6 +2584,15 @@ describeOneTableDetails(const char *schemaname,
 		if (verbose && tableinfo.relkind != 'm' && tableinfo.hasoids)
 			printTableAddFooter(&cont, _("Has OIDs: yes"));
 
+		/* Access method, if verbose and not the heap */
+		if (verbose && tableinfo.amname)
+		{
+			const char *s = _("Access method");
+
+			printfPQExpBuffer(&buf, "%s: %s", s, tableinfo.amname);
+			printTableAddFooter(&cont, buf.data);
+		}
+
 		/* Tablespace info */
 		add_tablespace_footer(&cont, tableinfo.relkind, tableinfo.tablespace,
 							  true);
@@ -4593,6 +4655,264 @@ listOneExtensionContents(const char *extname, const char *oid)
 	return true;
 }
 
+/*
+ * \dRp
+ * Lists publications.
+ *
+ * Takes an optional regexp to select particular publications
+ */
+bool
+listPublications(const char *pattern)
+{
+	PQExpBufferData buf;
+	PGresult   *res;
+	printQueryOpt myopt = pset.popt;
+	static const bool translate_columns[] = {false, false, false};
+
+	if (pset.sversion < 90500)
+	{
+		psql_error("The server (version %d.%d) does not support publications.\n",
+				   pset.sversion / 10000, (pset.sversion / 100) % 100);
+		return true;
+	}
+
+	initPQExpBuffer(&buf);
+
+	printfPQExpBuffer(&buf,
+					  "SELECT pubname AS \"%s\",\n"
+					  "  pg_catalog.pg_get_userbyid(pubowner) AS \"%s\",\n"
+					  "  puballtables AS \"%s\"\n"
+					  "FROM pg_catalog.pg_publication\n",
+					  gettext_noop("Name"),
+					  gettext_noop("Owner"),
+					  gettext_noop("All tables"));
+
+	processSQLNamePattern(pset.db, &buf, pattern, false, false,
+						  NULL, "pubname", NULL, NULL);
+
+	appendPQExpBufferStr(&buf, "ORDER BY 1;");
+
+	res = PSQLexec(buf.data);
+	termPQExpBuffer(&buf);
+	if (!res)
+		return false;
+
+	myopt.nullPrint = NULL;
+	myopt.title = _("List of publications");
+	myopt.translate_header = true;
+	myopt.translate_columns = translate_columns;
+	myopt.n_translate_columns = lengthof(translate_columns);
+
+	printQuery(res, &myopt, pset.queryFout, false, pset.logfile);
+
+	PQclear(res);
+
+	return true;
+}
+
+/*
+ * \dRp+
+ * Describes publications including the contents.
+ *
+ * Takes an optional regexp to select particular publications
+ */
+bool
+describePublications(const char *pattern)
+{
+	PQExpBufferData buf;
+	int			i;
+	PGresult   *res;
+
+	if (pset.sversion < 90500)
+	{
+		psql_error("The server (version %d.%d) does not support publications.\n",
+				   pset.sversion / 10000, (pset.sversion / 100) % 100);
+		return true;
+	}
+
+	initPQExpBuffer(&buf);
+
+	printfPQExpBuffer(&buf,
+					  "SELECT oid, pubname,\n"
+					  "  pg_catalog.pg_get_userbyid(pubowner) AS owner,\n"
+					  "  puballtables\n"
+					  "FROM pg_catalog.pg_publication\n");
+
+	processSQLNamePattern(pset.db, &buf, pattern, false, false,
+						  NULL, "pubname", NULL, NULL);
+
+	appendPQExpBufferStr(&buf, "ORDER BY 2;");
+
+	res = PSQLexec(buf.data);
+	if (!res)
+	{
+		termPQExpBuffer(&buf);
+		return false;
+	}
+
+	if (PQntuples(res) == 0)
+	{
+		if (!pset.quiet)
+		{
+			if (pattern)
+				psql_error("Did not find any publication named \"%s\".\n",
+						   pattern);
+			else
+				psql_error("Did not find any publications.\n");
+		}
+
+		termPQExpBuffer(&buf);
+		PQclear(res);
+		return false;
+	}
+
+	for (i = 0; i < PQntuples(res); i++)
+	{
+		const char	align = 'l';
+		const char *pubid = PQgetvalue(res, i, 0);
+		const char *pubname = PQgetvalue(res, i, 1);
+		bool		puballtables = strcmp(PQgetvalue(res, i, 3), "t") == 0;
+		printTableOpt myopt = pset.popt.topt;
+		printTableContent cont;
+		PQExpBufferData title;
+
+		initPQExpBuffer(&title);
+		printfPQExpBuffer(&title, _("Publication %s"), pubname);
+		printTableInit(&cont, &myopt, title.data, 2, 1);
+
+		printTableAddHeader(&cont, gettext_noop("Owner"), true, align);
+		printTableAddHeader(&cont, gettext_noop("All tables"), true, align);
+
+		printTableAddCell(&cont, PQgetvalue(res, i, 2), false, false);
+		printTableAddCell(&cont, PQgetvalue(res, i, 3), false, false);
+
+		if (!puballtables)
+		{
+			PGresult   *tabres;
+			int			j;
+
+			printfPQExpBuffer(&buf,
+							  "SELECT n.nspname, c.relname\n"
+							  "FROM pg_catalog.pg_class c,\n"
+							  "     pg_catalog.pg_namespace n,\n"
+							  "     pg_catalog.pg_publication_rel pr\n"
+							  "WHERE c.relnamespace = n.oid\n"
+							  "  AND c.oid = pr.prrelid\n"
+							  "  AND pr.prpubid = '%s'\n"
+							  "ORDER BY 1,2", pubid);
+
+			tabres = PSQLexec(buf.data);
+			if (!tabres)
+			{
+				printTableCleanup(&cont);
+				termPQExpBuffer(&title);
+				termPQExpBuffer(&buf);
+				PQclear(res);
+				return false;
+			}
+
+			if (PQntuples(tabres) > 0)
+				printTableAddFooter(&cont, _("Tables:"));
+
+			for (j = 0; j < PQntuples(tabres); j++)
+			{
+				printfPQExpBuffer(&buf, "    \"%s.%s\"",
+								  PQgetvalue(tabres, j, 0),
+								  PQgetvalue(tabres, j, 1));
+
+				printTableAddFooter(&cont, buf.data);
+			}
+			PQclear(tabres);
+		}
+
+		printTable(&cont, pset.queryFout, false, pset.logfile);
+		printTableCleanup(&cont);
+
+		termPQExpBuffer(&title);
+	}
+
+	termPQExpBuffer(&buf);
+	PQclear(res);
+
+	return true;
+}
+
+/*
+ * \dRs
+ * Describes subscriptions.
+ *
+ * Takes an optional regexp to select particular subscriptions
+ */
+bool
+describeSubscriptions(const char *pattern, bool verbose)
+{
+	PQExpBufferData buf;
+	PGresult   *res;
+	printQueryOpt myopt = pset.popt;
+	static const bool translate_columns[] = {false, false, false, false,
+	false, false, false, false};
+
+	if (pset.sversion < 90500)
+	{
+		psql_error("The server (version %d.%d) does not support subscriptions.\n",
+				   pset.sversion / 10000, (pset.sversion / 100) % 100);
+		return true;
+	}
+
+	initPQExpBuffer(&buf);
+
+	printfPQExpBuffer(&buf,
+					  "SELECT subname AS \"%s\"\n"
+					  ",  pg_catalog.pg_get_userbyid(subowner) AS \"%s\"\n"
+					  ",  subenabled AS \"%s\"\n"
+					  ",  subpublications AS \"%s\"\n",
+					  gettext_noop("Name"),
+					  gettext_noop("Owner"),
+					  gettext_noop("Enabled"),
+					  gettext_noop("Publication"));
+
+	/* subconninfo is only readable by superusers */
+	if (verbose)
+		appendPQExpBuffer(&buf,
+						  ",  substream AS \"%s\"\n"
+						  ",  subbinary AS \"%s\"\n"
+						  ",  subslotname AS \"%s\"\n"
+						  ",  subconninfo AS \"%s\"\n",
+						  gettext_noop("Streaming"),
+						  gettext_noop("Binary"),
+						  gettext_noop("Slot name"),
+						  gettext_noop("Conninfo"));
+
+	/* Only display subscriptions in current database. */
+	appendPQExpBufferStr(&buf,
+						 "FROM pg_catalog.pg_subscription\n"
+						 "WHERE subdbid = (SELECT oid\n"
+						 "                 FROM pg_catalog.pg_database\n"
+						 "                 WHERE datname = pg_catalog.current_database())\n");
+
+	processSQLNamePattern(pset.db, &buf, pattern, true, false,
+						  NULL, "subname", NULL,
+						  NULL);
+
+	appendPQExpBufferStr(&buf, "ORDER BY 1;");
+
+	res = PSQLexec(buf.data);
+	termPQExpBuffer(&buf);
+	if (!res)
+		return false;
+
+	myopt.nullPrint = NULL;
+	myopt.title = _("List of subscriptions");
+	myopt.translate_header = true;
+	myopt.translate_columns = translate_columns;
+	myopt.n_translate_columns = lengthof(translate_columns);
+
+	printQuery(res, &myopt, pset.queryFout, false, pset.logfile);
+
+	PQclear(res);
+	return true;
+}
+
 /*
  * printACLColumn
  *
@@ -99,4 +99,13 @@ extern bool listExtensionContents(const char *pattern);
 /* \dy */
 extern bool listEventTriggers(const char *pattern, bool verbose);
 
+/* \dRp */
+extern bool listPublications(const char *pattern);
+
+/* \dRp+ */
+extern bool describePublications(const char *pattern);
+
+/* \dRs */
+extern bool describeSubscriptions(const char *pattern, bool verbose);
+
 #endif   /* DESCRIBE_H */
@@ -0,0 +1,678 @@
+/*---------------------------------------------------------------------------
+ *
+ * Ryu floating-point output for double precision.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/common/d2s.c
+ *
+ * This is a modification of code taken from github.com/ulfjack/ryu under the
+ * terms of the Boost license (not the Apache license). The original copyright
+ * notice follows:
+ *
+ * Copyright 2018 Ulf Adams
+ *
+ * The contents of this file may be used under the terms of the Apache
+ * License, Version 2.0.
+ *
+ *     (See accompanying file LICENSE-Apache or copy at
+ *      http://www.apache.org/licenses/LICENSE-2.0)
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * Boost Software License, Version 1.0.
+ *
+ *     (See accompanying file LICENSE-Boost or copy at
+ *      https://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Unless required by applicable law or agreed to in writing, this software is
+ * distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+/*
+ *  Runtime compiler options:
+ *
+ *  -DRYU_ONLY_64_BIT_OPS Avoid using uint128 if this is defined; it may be
+ *	 faster on 32-bit machines.
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include "common/shortest_dec.h"
+
+#include "ryu_common.h"
+#include "d2s_full_table.h"
+
+#if defined(HAVE_INT128) && !defined(RYU_ONLY_64_BIT_OPS)
+#define RYU_HAVE_UINT128
+#endif
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BITS 11
+#define DOUBLE_BIAS 1023
+
+/*
+ * Fixed-point notation is used for decimal exponents in [-4, 15), which is
+ * what %.15g (that is, %.*g with DBL_DIG digits) does.
+ */
+#define DOUBLE_FIXED_LIMIT 15
+
+static inline uint32
+pow5Factor(uint64 value)
+{
+	uint32		count = 0;
+
+	for (;;)
+	{
+		uint64		q = value / 5;
+		uint32		r = (uint32) (value - 5 * q);
+
+		if (r != 0)
+			break;
+
+		value = q;
+		++count;
+	}
+	return count;
+}
+
+/*  Returns true if value is divisible by 5^p. */
+static inline bool
+multipleOfPowerOf5(const uint64 value, const uint32 p)
+{
+	/*
+	 * I tried a case distinction on p, but there was no performance
+	 * difference.
+	 */
+	return pow5Factor(value) >= p;
+}
+
+/*  Returns true if value is divisible by 2^p. */
+static inline bool
+multipleOfPowerOf2(const uint64 value, const uint32 p)
+{
+	/* return __builtin_ctzll(value) >= p; */
+	return (value & ((UINT64CONST(1) << p) - 1)) == 0;
+}
+
+/*
+ * We need a 64x128-bit multiplication and a subsequent 128-bit shift.
+ *
+ * Multiplication:
+ *
+ *	  The 64-bit factor is variable and passed in, the 128-bit factor comes
+ *	  from a lookup table. We know that the 64-bit factor only has 55
+ *	  significant bits (i.e., the 9 topmost bits are zeros). The 128-bit
+ *	  factor only has 124 significant bits (i.e., the 4 topmost bits are
+ *	  zeros).
+ *
+ * Shift:
+ *
+ *	  In principle, the multiplication result requires 55 + 124 = 179 bits to
+ *	  represent. However, we then shift this value to the right by j, which is
+ *	  at least j >= 115, so the result is guaranteed to fit into 179 - 115 =
+ *	  64 bits. This means that we only need the topmost 64 significant bits of
+ *	  the 64x128-bit multiplication.
+ *
+ * There are several ways to do this:
+ *
+ *	1. Best case: the compiler exposes a 128-bit type.
+ *	   We perform two 64x64-bit multiplications, add the higher 64 bits of the
+ *	   lower result to the higher result, and shift by j - 64 bits.
+ *
+ *	   We explicitly cast from 64-bit to 128-bit, so the compiler can tell
+ *	   that these are only 64-bit inputs, and can map these to the best
+ *	   possible sequence of assembly instructions. x86-64 machines happen to
+ *	   have matching assembly instructions for 64x64-bit multiplications and
+ *	   128-bit shifts.
+ *
+ *	2. Second best case: the compiler exposes intrinsics for the x86-64
+ *	   assembly instructions mentioned in 1.
+ *
+ *	3. We only have 64x64 bit instructions that return the lower 64 bits of
+ *	   the result, i.e., we have to use plain C.
+ *
+ *	   Our inputs are less than the full width, so we have three options:
+ *	   a. Ignore this fact and just implement the intrinsics manually.
+ *	   b. Split both into 31-bit pieces, which guarantees no internal
+ *		  overflow, but requires extra work upfront (unless we change the
+ *		  lookup table).
+ *	   c. Split only the first factor into 31-bit pieces, which also
+ *		  guarantees no internal overflow, but requires extra work since the
+ *		  intermediate results are not perfectly aligned.
+ *
+ * We use 1 where available and 3a otherwise.
+ */
+#if defined(RYU_HAVE_UINT128)
+
+/*  Best case: use 128-bit type. */
+static inline uint64
+mulShift(const uint64 m, const uint64 *const mul, const int32 j)
+{
+	const uint128 b0 = ((uint128) m) * mul[0];
+	const uint128 b2 = ((uint128) m) * mul[1];
+
+	return (uint64) (((b0 >> 64) + b2) >> (j - 64));
+}
+
+static inline uint64
+mulShiftAll(const uint64 m, const uint64 *const mul, const int32 j,
+			uint64 *const vp, uint64 *const vm, const uint32 mmShift)
+{
+	*vp = mulShift(4 * m + 2, mul, j);
+	*vm = mulShift(4 * m - 1 - mmShift, mul, j);
+	return mulShift(4 * m, mul, j);
+}
+
+#else							/* RYU_HAVE_UINT128 */
+
+static inline uint64
+umul128(const uint64 a, const uint64 b, uint64 *const productHi)
+{
+	const uint32 aLo = (uint32) a;
+	const uint32 aHi = (uint32) (a >> 32);
+	const uint32 bLo = (uint32) b;
+	const uint32 bHi = (uint32) (b >> 32);
+
+	const uint64 b00 = (uint64) aLo * bLo;
+	const uint64 b01 = (uint64) aLo * bHi;
+	const uint64 b10 = (uint64) aHi * bLo;
+	const uint64 b11 = (uint64) aHi * bHi;
+
+	const uint32 b00Lo = (uint32) b00;
+	const uint32 b00Hi = (uint32) (b00 >> 32);
+
+	const uint64 mid1 = b10 + b00Hi;
+	const uint32 mid1Lo = (uint32) (mid1);
+	const uint32 mid1Hi = (uint32) (mid1 >> 32);
+
+	const uint64 mid2 = b01 + mid1Lo;
+	const uint32 mid2Lo = (uint32) (mid2);
+	const uint32 mid2Hi = (uint32) (mid2 >> 32);
+
+	const uint64 pHi = b11 + mid1Hi + mid2Hi;
+	const uint64 pLo = ((uint64) mid2Lo << 32) + b00Lo;
+
+	*productHi = pHi;
+	return pLo;
+}
+
+static inline uint64
+shiftright128(const uint64 lo, const uint64 hi, const uint32 dist)
+{
+	/* We don't need to handle the case dist >= 64 here (see above). */
+	Assert(dist < 64);
+	Assert(dist > 0);
+
+	return (hi << (64 - dist)) | (lo >> dist);
+}
+
+static inline uint64
+mulShift(const uint64 m, const uint64 *const mul, const int32 j)
+{
+	/* m is maximum 55 bits */
+	uint64		high1;			/* 128 */
+	const uint64 low1 = umul128(m, mul[1], &high1);		/* 64 */
+	uint64		high0;
+	uint64		sum;
+
+	/* 64 */
+	(void) umul128(m, mul[0], &high0);
+	/* 0 */
+	sum = high0 + low1;
+
+	if (sum < high0)
+		++high1;				/* overflow into high1 */
+	return shiftright128(sum, high1, j - 64);
+}
+
+static inline uint64
+mulShiftAll(const uint64 m, const uint64 *const mul, const int32 j,
+			uint64 *const vp, uint64 *const vm, const uint32 mmShift)
+{
+	*vp = mulShift(4 * m + 2, mul, j);
+	*vm = mulShift(4 * m - 1 - mmShift, mul, j);
+	return mulShift(4 * m, mul, j);
+}
+
+#endif							/* RYU_HAVE_UINT128 */
+
+static inline uint32
+decimalLength(const uint64 v)
+{
+	/*
+	 * This is slightly faster than a loop. The average output length is
+	 * 16.38 digits, so we check high-to-low. Function precondition: v is not
+	 * an 18, 19, or 20-digit number. (17 digits are sufficient for
+	 * round-tripping.)
+	 */
+	Assert(v < UINT64CONST(100000000000000000));
+	if (v >= UINT64CONST(10000000000000000))
+		return 17;
+	if (v >= UINT64CONST(1000000000000000))
+		return 16;
+	if (v >= UINT64CONST(100000000000000))
+		return 15;
+	if (v >= UINT64CONST(10000000000000))
+		return 14;
+	if (v >= UINT64CONST(1000000000000))
+		return 13;
+	if (v >= UINT64CONST(100000000000))
+		return 12;
+	if (v >= UINT64CONST(10000000000))
+		return 11;
+	if (v >= 1000000000)
+		return 10;
+	if (v >= 100000000)
+		return 9;
+	if (v >= 10000000)
+		return 8;
+	if (v >= 1000000)
+		return 7;
+	if (v >= 100000)
+		return 6;
+	if (v >= 10000)
+		return 5;
+	if (v >= 1000)
+		return 4;
+	if (v >= 100)
+		return 3;
+	if (v >= 10)
+		return 2;
+	return 1;
+}
+
+/*  A floating decimal representing m * 10^e. */
+typedef struct floating_decimal_64
+{
+	uint64		mantissa;
+	int32		exponent;
+} floating_decimal_64;
+
+static inline floating_decimal_64
+d2d(const uint64 ieeeMantissa, const uint32 ieeeExponent)
+{
+	int32		e2;
+	uint64		m2;
+	uint64		mv;
+	uint32		mmShift;
+	uint64		vr,
+				vp,
+				vm;
+	int32		e10;
+	bool		vmIsTrailingZeros = false;
+	bool		vrIsTrailingZeros = false;
+	int32		removed = 0;
+	uint8		lastRemovedDigit = 0;
+	uint64		output;
+	floating_decimal_64 fd;
+
+#if STRICTLY_SHORTEST
+	bool		acceptBounds;
+#else
+	const bool	acceptBounds = false;
+#endif
+
+	if (ieeeExponent == 0)
+	{
+		/* We subtract 2 so that the bounds computation has 2 additional bits. */
+		e2 = 1 - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+		m2 = ieeeMantissa;
+	}
+	else
+	{
+		e2 = ieeeExponent - DOUBLE_BIAS - DOUBLE_MANTISSA_BITS - 2;
+		m2 = (UINT64CONST(1) << DOUBLE_MANTISSA_BITS) | ieeeMantissa;
+	}
+
+#if STRICTLY_SHORTEST
+	acceptBounds = (m2 & 1) == 0;
+#endif
+
+	/* Step 2: Determine the interval of legal decimal representations. */
+	mv = 4 * m2;
+
+	/* Implicit bool -> int conversion. True is 1, false is 0. */
+	mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+	/* We would compute mp and mm like this: */
+	/* uint64 mp = 4 * m2 + 2; */
+	/* uint64 mm = mv - 1 - mmShift; */
+
+	/* Step 3: Convert to a decimal power base using 128-bit arithmetic. */
+	if (e2 >= 0)
+	{
+		/*
+		 * I tried special-casing q == 0, but there was no effect on
+		 * performance.
+		 *
+		 * This expression is slightly faster than max(0, log10Pow2(e2) - 1).
+		 */
+		const uint32 q = log10Pow2(e2) - (e2 > 3);
+		const int32 k = DOUBLE_POW5_INV_BITCOUNT + pow5bits(q) - 1;
+		const int32 i = -e2 + q + k;
+
+		e10 = q;
+
+		vr = mulShiftAll(m2, DOUBLE_POW5_INV_SPLIT[q], i, &vp, &vm, mmShift);
+
+		if (q <= 21)
+		{
+			/*
+			 * This should use q <= 22, but I think 21 is also safe. Smaller
+			 * values may still be safe, but it's more difficult to reason
+			 * about them.
+			 *
+			 * Only one of mp, mv, and mm can be a multiple of 5, if any.
+			 */
+			const uint32 mvMod5 = (uint32) (mv - 5 * (mv / 5));
+
+			if (mvMod5 == 0)
+				vrIsTrailingZeros = multipleOfPowerOf5(mv, q);
+			else if (acceptBounds)
+			{
+				/*----
+				 * Same as min(e2 + (~mm & 1), pow5Factor(mm)) >= q
+				 * <=> e2 + (~mm & 1) >= q && pow5Factor(mm) >= q
+				 * <=> true && pow5Factor(mm) >= q, since e2 >= q.
+				 *----
+				 */
+				vmIsTrailingZeros = multipleOfPowerOf5(mv - 1 - mmShift, q);
+			}
+			else
+			{
+				/* Same as min(e2 + 1, pow5Factor(mp)) >= q. */
+				vp -= multipleOfPowerOf5(mv + 2, q);
+			}
+		}
+	}
+	else
+	{
+		/*
+		 * This expression is slightly faster than max(0, log10Pow5(-e2) - 1).
+		 */
+		const uint32 q = log10Pow5(-e2) - (-e2 > 1);
+		const int32 i = -e2 - q;
+		const int32 k = pow5bits(i) - DOUBLE_POW5_BITCOUNT;
+		const int32 j = q - k;
+
+		e10 = q + e2;
+
+		vr = mulShiftAll(m2, DOUBLE_POW5_SPLIT[i], j, &vp, &vm, mmShift);
+
+		if (q <= 1)
+		{
+			/*
+			 * {vr,vp,vm} is trailing zeros if {mv,mp,mm} has at least q
+			 * trailing 0 bits.
+			 */
+			/* mv = 4 * m2, so it always has at least two trailing 0 bits. */
+			vrIsTrailingZeros = true;
+			if (acceptBounds)
+			{
+				/*
+				 * mm = mv - 1 - mmShift, so it has 1 trailing 0 bit iff
+				 * mmShift == 1.
+				 */
+				vmIsTrailingZeros = mmShift == 1;
+			}
+			else
+			{
+				/*
+				 * mp = mv + 2, so it always has at least one trailing 0 bit.
+				 */
+				--vp;
+			}
+		}
+		else if (q < 63)
+		{
+			/*----
+			 * We want to know if the full product has at least q trailing
+			 * zeros.  We need to compute min(p2(mv), p5(mv) - e2) >= q
+			 * <=> p2(mv) >= q (because -e2 >= q)
+			 *----
+			 */
+			vrIsTrailingZeros = multipleOfPowerOf2(mv, q);
+		}
+	}
+
+	/*
+	 * Step 4: Find the shortest decimal representation in the interval of
+	 * legal representations.
+	 */
+	if (vmIsTrailingZeros || vrIsTrailingZeros)
+	{
+		/* General case, which happens rarely (~0.7%). */
+		for (;;)
+		{
+			const uint64 vpDiv10 = vp / 10;
+			const uint64 vmDiv10 = vm / 10;
+			uint32		vmMod10;
+			uint64		vrDiv10;
+			uint32		vrMod10;
+
+			if (vpDiv10 <= vmDiv10)
+				break;
+
+			vmMod10 = (uint32) (vm - 10 * vmDiv10);
+			vrDiv10 = vr / 10;
+			vrMod10 = (uint32) (vr - 10 * vrDiv10);
+			vmIsTrailingZeros &= vmMod10 == 0;
+			vrIsTrailingZeros &= lastRemovedDigit == 0;
+			lastRemovedDigit = (uint8) vrMod10;
+			vr = vrDiv10;
+			vp = vpDiv10;
+			vm = vmDiv10;
+			++removed;
+		}
+
+		if (vmIsTrailingZeros)
+		{
+			for (;;)
+			{
+				const uint64 vmDiv10 = vm / 10;
+				const uint32 vmMod10 = (uint32) (vm - 10 * vmDiv10);
+				uint64		vpDiv10;
+				uint64		vrDiv10;
+				uint32		vrMod10;
+
+				if (vmMod10 != 0)
+					break;
+
+				vpDiv10 = vp / 10;
+				vrDiv10 = vr / 10;
+				vrMod10 = (uint32) (vr - 10 * vrDiv10);
+				vrIsTrailingZeros &= lastRemovedDigit == 0;
+				lastRemovedDigit = (uint8) vrMod10;
+				vr = vrDiv10;
+				vp = vpDiv10;
+				vm = vmDiv10;
+				++removed;
+			}
+		}
+
+		if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0)
+		{
+			/* Round even if the exact number is .....50..0. */
+			lastRemovedDigit = 4;
+		}
+
+		/*
+		 * We need to take vr + 1 if vr is outside bounds or we need to round
+		 * up.
+		 */
+		output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+	}
+	else
+	{
+		/*
+		 * Specialized for the common case (~99.3%). Percentages below are
+		 * relative to this.
+		 */
+		bool		roundUp = false;
+		const uint64 vpDiv100 = vp / 100;
+		const uint64 vmDiv100 = vm / 100;
+
+		if (vpDiv100 > vmDiv100)
+		{
+			/* Optimization: remove two digits at a time (~86.2%). */
+			const uint64 vrDiv100 = vr / 100;
+			const uint32 vrMod100 = (uint32) (vr - 100 * vrDiv100);
+
+			roundUp = vrMod100 >= 50;
+			vr = vrDiv100;
+			vp = vpDiv100;
+			vm = vmDiv100;
+			removed += 2;
+		}
+
+		/*----
+		 * Loop iterations below (approximately), without optimization
+		 * above:
+		 *
+		 * 0: 0.03%, 1: 13.8%, 2: 70.6%, 3: 14.0%, 4: 1.40%, 5: 0.14%,
+		 * 6+: 0.02%
+		 *
+		 * Loop iterations below (approximately), with optimization
+		 * above:
+		 *
+		 * 0: 70.6%, 1: 27.8%, 2: 1.40%, 3: 0.14%, 4+: 0.02%
+		 *----
+		 */
+		for (;;)
+		{
+			const uint64 vpDiv10 = vp / 10;
+			const uint64 vmDiv10 = vm / 10;
+			uint64		vrDiv10;
+			uint32		vrMod10;
+
+			if (vpDiv10 <= vmDiv10)
+				break;
+
+			vrDiv10 = vr / 10;
+			vrMod10 = (uint32) (vr - 10 * vrDiv10);
+			roundUp = vrMod10 >= 5;
+			vr = vrDiv10;
+			vp = vpDiv10;
+			vm = vmDiv10;
+			++removed;
+		}
+
+		/*
+		 * We need to take vr + 1 if vr is outside bounds or we need to round
+		 * up.
+		 */
+		output = vr + (vr == vm || roundUp);
+	}
+
+	fd.exponent = e10 + removed;
+	fd.mantissa = output;
+
+	return fd;
+}
+
+/*
+ * Decompose f into sign, mantissa and exponent bits.  Returns true, having
+ * written the output for it, if f is zero, infinite or NaN.
+ */
+static inline bool
+d2s_special(double f, bool *sign, uint64 *mantissa, uint32 *exponent,
+			char *result, int *len)
+{
+	uint64		bits;
+
+	memcpy(&bits, &f, sizeof(double));
+
+	*sign = ((bits >> (DOUBLE_MANTISSA_BITS + DOUBLE_EXPONENT_BITS)) & 1) != 0;
+	*mantissa = bits & ((UINT64CONST(1) << DOUBLE_MANTISSA_BITS) - 1);
+	*exponent = (uint32) ((bits >> DOUBLE_MANTISSA_BITS) & ((1u << DOUBLE_EXPONENT_BITS) - 1));
+
+	if (*exponent == ((1u << DOUBLE_EXPONENT_BITS) - 1u) ||
+		(*exponent == 0 && *mantissa == 0))
+	{
+		*len = copy_special_str(result, *sign, *exponent != 0, *mantissa != 0);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Store the shortest decimal representation of the given double as an
+ * UNTERMINATED string in the caller's supplied buffer (which must be at least
+ * DOUBLE_SHORTEST_DECIMAL_LEN-1 bytes long).
+ *
+ * Returns the number of bytes stored.
+ */
+int
+double_to_shortest_decimal_bufn(double f, char *result)
+{
+	bool		sign;
+	uint64		ieeeMantissa;
+	uint32		ieeeExponent;
+	floating_decimal_64 v;
+	int			len;
+
+	if (d2s_special(f, &sign, &ieeeMantissa, &ieeeExponent, result, &len))
+		return len;
+
+	v = d2d(ieeeMantissa, ieeeExponent);
+
+	return ryu_to_chars(v.mantissa, decimalLength(v.mantissa), v.exponent,
+						sign, DOUBLE_FIXED_LIMIT, result);
+}
+
+/*
+ * Store the shortest decimal representation of the given double as a
+ * null-terminated string in the caller's supplied buffer (which must be at
+ * least DOUBLE_SHORTEST_DECIMAL_LEN bytes long).
+ *
+ * Returns the string length.
+ */
+int
+double_to_shortest_decimal_buf(double f, char *result)
+{
+	const int	index = double_to_shortest_decimal_bufn(f, result);
+
+	/* Terminate the string. */
+	Assert(index < DOUBLE_SHORTEST_DECIMAL_LEN);
+	result[index] = '\0';
+	return index;
+}
+
+/*
+ * As double_to_shortest_decimal_buf, but give up and return -1, leaving the
+ * buffer contents unspecified, if the shortest representation has more than
+ * maxdigits significant digits.
+ */
+int
+double_to_limited_decimal_buf(double f, int maxdigits, char *result)
+{
+	bool		sign;
+	uint64		ieeeMantissa;
+	uint32		ieeeExponent;
+	floating_decimal_64 v;
+	int			olength;
+	int			len;
+
+	if (d2s_special(f, &sign, &ieeeMantissa, &ieeeExponent, result, &len))
+	{
+		result[len] = '\0';
+		return len;
+	}
+
+	v = d2d(ieeeMantissa, ieeeExponent);
+	olength = decimalLength(v.mantissa);
+	if (olength > maxdigits)
+		return -1;
+
+	len = ryu_to_chars(v.mantissa, olength, v.exponent,
+					   sign, DOUBLE_FIXED_LIMIT, result);
+	result[len] = '\0';
+	return len;
+}
@@ -0,0 +1,676 @@
+/*---------------------------------------------------------------------------
+ *
+ * Ryu floating-point output for double precision.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/common/d2s_full_table.h
+ *
+ * This is a modification of code taken from github.com/ulfjack/ryu under the
+ * terms of the Boost license (not the Apache license). The original copyright
+ * notice follows:
+ *
+ * Copyright 2018 Ulf Adams
+ *
+ * The contents of this file may be used under the terms of the Apache
+ * License, Version 2.0.
+ *
+ *     (See accompanying file LICENSE-Apache or copy at
+ *      http://www.apache.org/licenses/LICENSE-2.0)
+ *
+ * Alternatively, the contents of this file may be used under the terms of the
+ * Boost Software License, Version 1.0.
+ *
+ *     (See accompanying file LICENSE-Boost or copy at
+ *      https://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Unless required by applicable law or agreed to in writing, this software is
+ * distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.
+ *
+ *---------------------------------------------------------------------------
+ */
+#ifndef RYU_D2S_FULL_TABLE_H
+#define RYU_D2S_FULL_TABLE_H
+
+/*
+ * These tables are generated (by the upstream) by PrintDoubleLookupTable,
+ * and modified (by us) to add UINT64CONST.
+ *
+ * DOUBLE_POW5_SPLIT[i] holds 5^i scaled to exactly DOUBLE_POW5_BITCOUNT
+ * bits; DOUBLE_POW5_INV_SPLIT[i] holds floor(2^k / 5^i) + 1 with
+ * k = pow5bits(i) - 1 + DOUBLE_POW5_INV_BITCOUNT.  Each 128-bit entry is
+ * stored as {low, high} 64-bit halves.
+ */
+#define DOUBLE_POW5_INV_BITCOUNT 125
+#define DOUBLE_POW5_BITCOUNT 125
+
+#define DOUBLE_POW5_INV_TABLE_SIZE 292
+#define DOUBLE_POW5_TABLE_SIZE 326
+
+static const uint64 DOUBLE_POW5_INV_SPLIT[DOUBLE_POW5_INV_TABLE_SIZE][2] = {
+	{UINT64CONST(1), UINT64CONST(2305843009213693952)},
+	{UINT64CONST(11068046444225730970), UINT64CONST(1844674407370955161)},
+	{UINT64CONST(5165088340638674453), UINT64CONST(1475739525896764129)},
+	{UINT64CONST(7821419487252849886), UINT64CONST(1180591620717411303)},
+	{UINT64CONST(8824922364862649494), UINT64CONST(1888946593147858085)},
+	{UINT64CONST(7059937891890119595), UINT64CONST(1511157274518286468)},
+	{UINT64CONST(13026647942995916322), UINT64CONST(1208925819614629174)},
+	{UINT64CONST(9774590264567735146), UINT64CONST(1934281311383406679)},
+	{UINT64CONST(11509021026396098440), UINT64CONST(1547425049106725343)},
+	{UINT64CONST(16585914450600699399), UINT64CONST(1237940039285380274)},
+	{UINT64CONST(15469416676735388068), UINT64CONST(1980704062856608439)},
+	{UINT64CONST(16064882156130220778), UINT64CONST(1584563250285286751)},
+	{UINT64CONST(9162556910162266299), UINT64CONST(1267650600228229401)},
+	{UINT64CONST(7281393426775805432), UINT64CONST(2028240960365167042)},
+	{UINT64CONST(16893161185646375315), UINT64CONST(1622592768292133633)},
+	{UINT64CONST(2446482504291369283), UINT64CONST(1298074214633706907)},
+	{UINT64CONST(7603720821608101175), UINT64CONST(2076918743413931051)},
+	{UINT64CONST(2393627842544570617), UINT64CONST(1661534994731144841)},
+	{UINT64CONST(16672297533003297786), UINT64CONST(1329227995784915872)},
+	{UINT64CONST(11918280793837635165), UINT64CONST(2126764793255865396)},
+	{UINT64CONST(5845275820328197809), UINT64CONST(1701411834604692317)},
+	{UINT64CONST(15744267100488289217), UINT64CONST(1361129467683753853)},
+	{UINT64CONST(3054734472329800808), UINT64CONST(2177807148294006166)},
+	{UINT64CONST(17201182836831481939), UINT64CONST(1742245718635204932)},
+	{UINT64CONST(6382248639981364905), UINT64CONST(1393796574908163946)},
+	{UINT64CONST(2832900194486363201), UINT64CONST(2230074519853062314)},
+	{UINT64CONST(5955668970331000884), UINT64CONST(1784059615882449851)},
+	{UINT64CONST(1075186361522890384), UINT64CONST(1427247692705959881)},
+	{UINT64CONST(12788344622662355584), UINT64CONST(2283596308329535809)},
+	{UINT64CONST(13920024512871794791), UINT64CONST(1826877046663628647)},
+	{UINT64CONST(3757321980813615186), UINT64CONST(1461501637330902918)},
+	{UINT64CONST(10384555214134712795), UINT64CONST(1169201309864722334)},
+	{UINT64CONST(5547241898389809503), UINT64CONST(1870722095783555735)},
+	{UINT64CONST(4437793518711847602), UINT64CONST(1496577676626844588)},
+	{UINT64CONST(10928932444453298728), UINT64CONST(1197262141301475670)},
+	{UINT64CONST(17486291911125277965), UINT64CONST(1915619426082361072)},
+	{UINT64CONST(6610335899416401726), UINT64CONST(1532495540865888858)},
+	{UINT64CONST(12666966349016942027), UINT64CONST(1225996432692711086)},
+	{UINT64CONST(12888448528943286597), UINT64CONST(1961594292308337738)},
+	{UINT64CONST(17689456452638449924), UINT64CONST(1569275433846670190)},
+	{UINT64CONST(14151565162110759939), UINT64CONST(1255420347077336152)},
+	{UINT64CONST(7885109000409574610), UINT64CONST(2008672555323737844)},
+	{UINT64CONST(9997436015069570011), UINT64CONST(1606938044258990275)},
+	{UINT64CONST(7997948812055656009), UINT64CONST(1285550435407192220)},
+	{UINT64CONST(12796718099289049614), UINT64CONST(2056880696651507552)},
+	{UINT64CONST(2858676849947419045), UINT64CONST(1645504557321206042)},
+	{UINT64CONST(13354987924183666206), UINT64CONST(1316403645856964833)},
+	{UINT64CONST(17678631863951955605), UINT64CONST(2106245833371143733)},
+	{UINT64CONST(3074859046935833515), UINT64CONST(1684996666696914987)},
+	{UINT64CONST(13527933681774397782), UINT64CONST(1347997333357531989)},
+	{UINT64CONST(10576647446613305481), UINT64CONST(2156795733372051183)},
+	{UINT64CONST(15840015586774465031), UINT64CONST(1725436586697640946)},
+	{UINT64CONST(8982663654677661702), UINT64CONST(1380349269358112757)},
+	{UINT64CONST(18061610662226169046), UINT64CONST(2208558830972980411)},
+	{UINT64CONST(10759939715039024913), UINT64CONST(1766847064778384329)},
+	{UINT64CONST(12297300586773130254), UINT64CONST(1413477651822707463)},
+	{UINT64CONST(15986332124095098083), UINT64CONST(2261564242916331941)},
+	{UINT64CONST(9099716884534168143), UINT64CONST(1809251394333065553)},
+	{UINT64CONST(14658471137111155161), UINT64CONST(1447401115466452442)},
+	{UINT64CONST(4348079280205103483), UINT64CONST(1157920892373161954)},
+	{UINT64CONST(14335624477811986218), UINT64CONST(1852673427797059126)},
+	{UINT64CONST(7779150767507678651), UINT64CONST(1482138742237647301)},
+	{UINT64CONST(2533971799264232598), UINT64CONST(1185710993790117841)},
+	{UINT64CONST(15122401323048503126), UINT64CONST(1897137590064188545)},
+	{UINT64CONST(12097921058438802501), UINT64CONST(1517710072051350836)},
+	{UINT64CONST(5988988032009131678), UINT64CONST(1214168057641080669)},
+	{UINT64CONST(16961078480698431330), UINT64CONST(1942668892225729070)},
+	{UINT64CONST(13568862784558745064), UINT64CONST(1554135113780583256)},
+	{UINT64CONST(7165741412905085728), UINT64CONST(1243308091024466605)},
+	{UINT64CONST(11465186260648137165), UINT64CONST(1989292945639146568)},
+	{UINT64CONST(16550846638002330379), UINT64CONST(1591434356511317254)},
+	{UINT64CONST(16930026125143774626), UINT64CONST(1273147485209053803)},
+	{UINT64CONST(4951948911778577463), UINT64CONST(2037035976334486086)},
+	{UINT64CONST(272210314680951647), UINT64CONST(1629628781067588869)},
+	{UINT64CONST(3907117066486671641), UINT64CONST(1303703024854071095)},
+	{UINT64CONST(6251387306378674625), UINT64CONST(2085924839766513752)},
+	{UINT64CONST(16069156289328670670), UINT64CONST(1668739871813211001)},
+	{UINT64CONST(9165976216721026213), UINT64CONST(1334991897450568801)},
+	{UINT64CONST(7286864317269821294), UINT64CONST(2135987035920910082)},
+	{UINT64CONST(16897537898041588005), UINT64CONST(1708789628736728065)},
+	{UINT64CONST(13518030318433270404), UINT64CONST(1367031702989382452)},
+	{UINT64CONST(6871453250525591353), UINT64CONST(2187250724783011924)},
+	{UINT64CONST(9186511415162383406), UINT64CONST(1749800579826409539)},
+	{UINT64CONST(11038557946871817048), UINT64CONST(1399840463861127631)},
+	{UINT64CONST(10282995085511086630), UINT64CONST(2239744742177804210)},
+	{UINT64CONST(8226396068408869304), UINT64CONST(1791795793742243368)},
+	{UINT64CONST(13959814484210916090), UINT64CONST(1433436634993794694)},
+	{UINT64CONST(11267656730511734774), UINT64CONST(2293498615990071511)},
+	{UINT64CONST(5324776569667477496), UINT64CONST(1834798892792057209)},
+	{UINT64CONST(7949170070475892320), UINT64CONST(1467839114233645767)},
+	{UINT64CONST(17427382500606444826), UINT64CONST(1174271291386916613)},
+	{UINT64CONST(5747719112518849781), UINT64CONST(1878834066219066582)},
+	{UINT64CONST(15666221734240810795), UINT64CONST(1503067252975253265)},
+	{UINT64CONST(12532977387392648636), UINT64CONST(1202453802380202612)},
+	{UINT64CONST(5295368560860596524), UINT64CONST(1923926083808324180)},
+	{UINT64CONST(4236294848688477220), UINT64CONST(1539140867046659344)},
+	{UINT64CONST(7078384693692692099), UINT64CONST(1231312693637327475)},
+	{UINT64CONST(11325415509908307358), UINT64CONST(1970100309819723960)},
+	{UINT64CONST(9060332407926645887), UINT64CONST(1576080247855779168)},
+	{UINT64CONST(14626963555825137356), UINT64CONST(1260864198284623334)},
+	{UINT64CONST(12335095245094488799), UINT64CONST(2017382717255397335)},
+	{UINT64CONST(9868076196075591040), UINT64CONST(1613906173804317868)},
+	{UINT64CONST(15273158586344293478), UINT64CONST(1291124939043454294)},
+	{UINT64CONST(13369007293925138595), UINT64CONST(2065799902469526871)},
+	{UINT64CONST(7005857020398200553), UINT64CONST(1652639921975621497)},
+	{UINT64CONST(16672732060544291412), UINT64CONST(1322111937580497197)},
+	{UINT64CONST(11918976037903224966), UINT64CONST(2115379100128795516)},
+	{UINT64CONST(5845832015580669650), UINT64CONST(1692303280103036413)},
+	{UINT64CONST(12055363241948356366), UINT64CONST(1353842624082429130)},
+	{UINT64CONST(841837113407818570), UINT64CONST(2166148198531886609)},
+	{UINT64CONST(4362818505468165179), UINT64CONST(1732918558825509287)},
+	{UINT64CONST(14558301248600263113), UINT64CONST(1386334847060407429)},
+	{UINT64CONST(12225235553534690011), UINT64CONST(2218135755296651887)},
+	{UINT64CONST(2401490813343931363), UINT64CONST(1774508604237321510)},
+	{UINT64CONST(1921192650675145090), UINT64CONST(1419606883389857208)},
+	{UINT64CONST(17831303500047873437), UINT64CONST(2271371013423771532)},
+	{UINT64CONST(6886345170554478103), UINT64CONST(1817096810739017226)},
+	{UINT64CONST(1819727321701672159), UINT64CONST(1453677448591213781)},
+	{UINT64CONST(16213177116328979020), UINT64CONST(1162941958872971024)},
+	{UINT64CONST(14873036941900635463), UINT64CONST(1860707134196753639)},
+	{UINT64CONST(15587778368262418694), UINT64CONST(1488565707357402911)},
+	{UINT64CONST(8780873879868024632), UINT64CONST(1190852565885922329)},
+	{UINT64CONST(2981351763563108441), UINT64CONST(1905364105417475727)},
+	{UINT64CONST(13453127855076217722), UINT64CONST(1524291284333980581)},
+	{UINT64CONST(7073153469319063855), UINT64CONST(1219433027467184465)},
+	{UINT64CONST(11317045550910502167), UINT64CONST(1951092843947495144)},
+	{UINT64CONST(12742985255470312057), UINT64CONST(1560874275157996115)},
+	{UINT64CONST(10194388204376249646), UINT64CONST(1248699420126396892)},
+	{UINT64CONST(1553625868034358140), UINT64CONST(1997919072202235028)},
+	{UINT64CONST(8621598323911307159), UINT64CONST(1598335257761788022)},
+	{UINT64CONST(17965325103354776697), UINT64CONST(1278668206209430417)},
+	{UINT64CONST(13987124906400001422), UINT64CONST(2045869129935088668)},
+	{UINT64CONST(121653480894270168), UINT64CONST(1636695303948070935)},
+	{UINT64CONST(97322784715416134), UINT64CONST(1309356243158456748)},
+	{UINT64CONST(14913111714512307107), UINT64CONST(2094969989053530796)},
+	{UINT64CONST(8241140556867935363), UINT64CONST(1675975991242824637)},
+	{UINT64CONST(17660958889720079260), UINT64CONST(1340780792994259709)},
+	{UINT64CONST(17189487779326395846), UINT64CONST(2145249268790815535)},
+	{UINT64CONST(13751590223461116677), UINT64CONST(1716199415032652428)},
+	{UINT64CONST(18379969808252713988), UINT64CONST(1372959532026121942)},
+	{UINT64CONST(14650556434236701088), UINT64CONST(2196735251241795108)},
+	{UINT64CONST(652398703163629901), UINT64CONST(1757388200993436087)},
+	{UINT64CONST(11589965406756634890), UINT64CONST(1405910560794748869)},
+	{UINT64CONST(7475898206584884855), UINT64CONST(2249456897271598191)},
+	{UINT64CONST(2291369750525997561), UINT64CONST(1799565517817278553)},
+	{UINT64CONST(9211793429904618695), UINT64CONST(1439652414253822842)},
+	{UINT64CONST(18428218302589300235), UINT64CONST(2303443862806116547)},
+	{UINT64CONST(7363877012587619542), UINT64CONST(1842755090244893238)},
+	{UINT64CONST(13269799239553916280), UINT64CONST(1474204072195914590)},
+	{UINT64CONST(10615839391643133024), UINT64CONST(1179363257756731672)},
+	{UINT64CONST(2227947767661371545), UINT64CONST(1886981212410770676)},
+	{UINT64CONST(16539753473096738529), UINT64CONST(1509584969928616540)},
+	{UINT64CONST(13231802778477390823), UINT64CONST(1207667975942893232)},
+	{UINT64CONST(6413489186596184024), UINT64CONST(1932268761508629172)},
+	{UINT64CONST(16198837793502678189), UINT64CONST(1545815009206903337)},
+	{UINT64CONST(5580372605318321905), UINT64CONST(1236652007365522670)},
+	{UINT64CONST(8928596168509315048), UINT64CONST(1978643211784836272)},
+	{UINT64CONST(18210923379033183008), UINT64CONST(1582914569427869017)},
+	{UINT64CONST(7190041073742725760), UINT64CONST(1266331655542295214)},
+	{UINT64CONST(436019273762630246), UINT64CONST(2026130648867672343)},
+	{UINT64CONST(7727513048493924843), UINT64CONST(1620904519094137874)},
+	{UINT64CONST(9871359253537050198), UINT64CONST(1296723615275310299)},
+	{UINT64CONST(4726128361433549347), UINT64CONST(2074757784440496479)},
+	{UINT64CONST(7470251503888749801), UINT64CONST(1659806227552397183)},
+	{UINT64CONST(13354898832594820487), UINT64CONST(1327844982041917746)},
+	{UINT64CONST(13989140502667892133), UINT64CONST(2124551971267068394)},
+	{UINT64CONST(14880661216876224029), UINT64CONST(1699641577013654715)},
+	{UINT64CONST(11904528973500979224), UINT64CONST(1359713261610923772)},
+	{UINT64CONST(4289851098633925465), UINT64CONST(2175541218577478036)},
+	{UINT64CONST(18189276137874781665), UINT64CONST(1740432974861982428)},
+	{UINT64CONST(3483374466074094362), UINT64CONST(1392346379889585943)},
+	{UINT64CONST(1884050330976640656), UINT64CONST(2227754207823337509)},
+	{UINT64CONST(5196589079523222848), UINT64CONST(1782203366258670007)},
+	{UINT64CONST(15225317707844309248), UINT64CONST(1425762693006936005)},
+	{UINT64CONST(5913764258841343181), UINT64CONST(2281220308811097609)},
+	{UINT64CONST(8420360221814984868), UINT64CONST(1824976247048878087)},
+	{UINT64CONST(17804334621677718864), UINT64CONST(1459980997639102469)},
+	{UINT64CONST(17932816512084085415), UINT64CONST(1167984798111281975)},
+	{UINT64CONST(10245762345624985047), UINT64CONST(1868775676978051161)},
+	{UINT64CONST(4507261061758077715), UINT64CONST(1495020541582440929)},
+	{UINT64CONST(7295157664148372495), UINT64CONST(1196016433265952743)},
+	{UINT64CONST(7982903447895485668), UINT64CONST(1913626293225524389)},
+	{UINT64CONST(10075671573058298858), UINT64CONST(1530901034580419511)},
+	{UINT64CONST(4371188443704728763), UINT64CONST(1224720827664335609)},
+	{UINT64CONST(14372599139411386667), UINT64CONST(1959553324262936974)},
+	{UINT64CONST(15187428126271019657), UINT64CONST(1567642659410349579)},
+	{UINT64CONST(15839291315758726049), UINT64CONST(1254114127528279663)},
+	{UINT64CONST(3206773216762499739), UINT64CONST(2006582604045247462)},
+	{UINT64CONST(13633465017635730761), UINT64CONST(1605266083236197969)},
+	{UINT64CONST(14596120828850494932), UINT64CONST(1284212866588958375)},
+	{UINT64CONST(4907049252451240275), UINT64CONST(2054740586542333401)},
+	{UINT64CONST(236290587219081897), UINT64CONST(1643792469233866721)},
+	{UINT64CONST(14946427728742906810), UINT64CONST(1315033975387093376)},
+	{UINT64CONST(16535586736504830250), UINT64CONST(2104054360619349402)},
+	{UINT64CONST(5849771759720043554), UINT64CONST(1683243488495479522)},
+	{UINT64CONST(15747863852001765813), UINT64CONST(1346594790796383617)},
+	{UINT64CONST(10439186904235184007), UINT64CONST(2154551665274213788)},
+	{UINT64CONST(15730047152871967852), UINT64CONST(1723641332219371030)},
+	{UINT64CONST(12584037722297574282), UINT64CONST(1378913065775496824)},
+	{UINT64CONST(9066413911450387881), UINT64CONST(2206260905240794919)},
+	{UINT64CONST(10942479943902220628), UINT64CONST(1765008724192635935)},
+	{UINT64CONST(8753983955121776503), UINT64CONST(1412006979354108748)},
+	{UINT64CONST(10317025513452932081), UINT64CONST(2259211166966573997)},
+	{UINT64CONST(874922781278525018), UINT64CONST(1807368933573259198)},
+	{UINT64CONST(8078635854506640661), UINT64CONST(1445895146858607358)},
+	{UINT64CONST(13841606313089133175), UINT64CONST(1156716117486885886)},
+	{UINT64CONST(14767872471458792434), UINT64CONST(1850745787979017418)},
+	{UINT64CONST(746251532941302978), UINT64CONST(1480596630383213935)},
+	{UINT64CONST(597001226353042382), UINT64CONST(1184477304306571148)},
+	{UINT64CONST(15712597221132509104), UINT64CONST(1895163686890513836)},
+	{UINT64CONST(8880728962164096960), UINT64CONST(1516130949512411069)},
+	{UINT64CONST(10793931984473187891), UINT64CONST(1212904759609928855)},
+	{UINT64CONST(17270291175157100626), UINT64CONST(1940647615375886168)},
+	{UINT64CONST(2748186495899949531), UINT64CONST(1552518092300708935)},
+	{UINT64CONST(2198549196719959625), UINT64CONST(1242014473840567148)},
+	{UINT64CONST(18275073973719576693), UINT64CONST(1987223158144907436)},
+	{UINT64CONST(10930710364233751031), UINT64CONST(1589778526515925949)},
+	{UINT64CONST(12433917106128911148), UINT64CONST(1271822821212740759)},
+	{UINT64CONST(8826220925580526867), UINT64CONST(2034916513940385215)},
+	{UINT64CONST(7060976740464421494), UINT64CONST(1627933211152308172)},
+	{UINT64CONST(16716827836597268165), UINT64CONST(1302346568921846537)},
+	{UINT64CONST(11989529279587987770), UINT64CONST(2083754510274954460)},
+	{UINT64CONST(9591623423670390216), UINT64CONST(1667003608219963568)},
+	{UINT64CONST(15051996368420132820), UINT64CONST(1333602886575970854)},
+	{UINT64CONST(13015147745246481542), UINT64CONST(2133764618521553367)},
+	{UINT64CONST(3033420566713364587), UINT64CONST(1707011694817242694)},
+	{UINT64CONST(6116085268112601993), UINT64CONST(1365609355853794155)},
+	{UINT64CONST(9785736428980163188), UINT64CONST(2184974969366070648)},
+	{UINT64CONST(15207286772667951197), UINT64CONST(1747979975492856518)},
+	{UINT64CONST(1097782973908629988), UINT64CONST(1398383980394285215)},
+	{UINT64CONST(1756452758253807981), UINT64CONST(2237414368630856344)},
+	{UINT64CONST(5094511021344956708), UINT64CONST(1789931494904685075)},
+	{UINT64CONST(4075608817075965366), UINT64CONST(1431945195923748060)},
+	{UINT64CONST(6520974107321544586), UINT64CONST(2291112313477996896)},
+	{UINT64CONST(1527430471115325346), UINT64CONST(1832889850782397517)},
+	{UINT64CONST(12289990821117991246), UINT64CONST(1466311880625918013)},
+	{UINT64CONST(17210690286378213644), UINT64CONST(1173049504500734410)},
+	{UINT64CONST(9090360384495590213), UINT64CONST(1876879207201175057)},
+	{UINT64CONST(18340334751822203140), UINT64CONST(1501503365760940045)},
+	{UINT64CONST(14672267801457762512), UINT64CONST(1201202692608752036)},
+	{UINT64CONST(16096930852848599373), UINT64CONST(1921924308174003258)},
+	{UINT64CONST(1809498238053148529), UINT64CONST(1537539446539202607)},
+	{UINT64CONST(12515645034668249793), UINT64CONST(1230031557231362085)},
+	{UINT64CONST(1578287981759648052), UINT64CONST(1968050491570179337)},
+	{UINT64CONST(12330676829633449412), UINT64CONST(1574440393256143469)},
+	{UINT64CONST(13553890278448669853), UINT64CONST(1259552314604914775)},
+	{UINT64CONST(3239480371808320148), UINT64CONST(2015283703367863641)},
+	{UINT64CONST(17348979556414297411), UINT64CONST(1612226962694290912)},
+	{UINT64CONST(6500486015647617283), UINT64CONST(1289781570155432730)},
+	{UINT64CONST(10400777625036187652), UINT64CONST(2063650512248692368)},
+	{UINT64CONST(15699319729512770768), UINT64CONST(1650920409798953894)},
+	{UINT64CONST(16248804598352126938), UINT64CONST(1320736327839163115)},
+	{UINT64CONST(7551343283653851484), UINT64CONST(2113178124542660985)},
+	{UINT64CONST(6041074626923081187), UINT64CONST(1690542499634128788)},
+	{UINT64CONST(12211557331022285596), UINT64CONST(1352433999707303030)},
+	{UINT64CONST(1091747655926105338), UINT64CONST(2163894399531684849)},
+	{UINT64CONST(4562746939482794594), UINT64CONST(1731115519625347879)},
+	{UINT64CONST(7339546366328145998), UINT64CONST(1384892415700278303)},
+	{UINT64CONST(8053925371383123274), UINT64CONST(2215827865120445285)},
+	{UINT64CONST(6443140297106498619), UINT64CONST(1772662292096356228)},
+	{UINT64CONST(12533209867169019542), UINT64CONST(1418129833677084982)},
+	{UINT64CONST(5295740528502789974), UINT64CONST(2269007733883335972)},
+	{UINT64CONST(15304638867027962949), UINT64CONST(1815206187106668777)},
+	{UINT64CONST(4865013464138549713), UINT64CONST(1452164949685335022)},
+	{UINT64CONST(14960057215536570740), UINT64CONST(1161731959748268017)},
+	{UINT64CONST(9178696285890871890), UINT64CONST(1858771135597228828)},
+	{UINT64CONST(14721654658196518159), UINT64CONST(1487016908477783062)},
+	{UINT64CONST(4398626097073393881), UINT64CONST(1189613526782226450)},
+	{UINT64CONST(7037801755317430209), UINT64CONST(1903381642851562320)},
+	{UINT64CONST(5630241404253944167), UINT64CONST(1522705314281249856)},
+	{UINT64CONST(814844308661245011), UINT64CONST(1218164251424999885)},
+	{UINT64CONST(1303750893857992017), UINT64CONST(1949062802279999816)},
+	{UINT64CONST(15800395974054034906), UINT64CONST(1559250241823999852)},
+	{UINT64CONST(5261619149759407279), UINT64CONST(1247400193459199882)},
+	{UINT64CONST(12107939454356961969), UINT64CONST(1995840309534719811)},
+	{UINT64CONST(5997002748743659252), UINT64CONST(1596672247627775849)},
+	{UINT64CONST(8486951013736837725), UINT64CONST(1277337798102220679)},
+	{UINT64CONST(2511075177753209390), UINT64CONST(2043740476963553087)},
+	{UINT64CONST(13076906586428298482), UINT64CONST(1634992381570842469)},
+	{UINT64CONST(14150874083884549109), UINT64CONST(1307993905256673975)},
+	{UINT64CONST(4194654460505726958), UINT64CONST(2092790248410678361)},
+	{UINT64CONST(18113118827372222859), UINT64CONST(1674232198728542688)},
+	{UINT64CONST(3422448617672047318), UINT64CONST(1339385758982834151)},
+	{UINT64CONST(16543964232501006678), UINT64CONST(2143017214372534641)},
+	{UINT64CONST(9545822571258895019), UINT64CONST(1714413771498027713)},
+	{UINT64CONST(15015355686490936662), UINT64CONST(1371531017198422170)},
+	{UINT64CONST(5577825024675947042), UINT64CONST(2194449627517475473)},
+	{UINT64CONST(11840957649224578280), UINT64CONST(1755559702013980378)},
+	{UINT64CONST(16851463748863483271), UINT64CONST(1404447761611184302)},
+	{UINT64CONST(12204946739213931940), UINT64CONST(2247116418577894884)},
+	{UINT64CONST(13453306206113055875), UINT64CONST(1797693134862315907)},
+	{UINT64CONST(3383947335406624054), UINT64CONST(1438154507889852726)}
+};
+
+static const uint64 DOUBLE_POW5_SPLIT[DOUBLE_POW5_TABLE_SIZE][2] = {
+	{UINT64CONST(0), UINT64CONST(1152921504606846976)},
+	{UINT64CONST(0), UINT64CONST(1441151880758558720)},
+	{UINT64CONST(0), UINT64CONST(1801439850948198400)},
+	{UINT64CONST(0), UINT64CONST(2251799813685248000)},
+	{UINT64CONST(0), UINT64CONST(1407374883553280000)},
+	{UINT64CONST(0), UINT64CONST(1759218604441600000)},
+	{UINT64CONST(0), UINT64CONST(2199023255552000000)},
+	{UINT64CONST(0), UINT64CONST(1374389534720000000)},
+	{UINT64CONST(0), UINT64CONST(1717986918400000000)},
+	{UINT64CONST(0), UINT64CONST(2147483648000000000)},
+	{UINT64CONST(0), UINT64CONST(1342177280000000000)},
+	{UINT64CONST(0), UINT64CONST(1677721600000000000)},
+	{UINT64CONST(0), UINT64CONST(2097152000000000000)},
+	{UINT64CONST(0), UINT64CONST(1310720000000000000)},
+	{UINT64CONST(0), UINT64CONST(1638400000000000000)},
+	{UINT64CONST(0), UINT64CONST(2048000000000000000)},
+	{UINT64CONST(0), UINT64CONST(1280000000000000000)},
+	{UINT64CONST(0), UINT64CONST(1600000000000000000)},
+	{UINT64CONST(0), UINT64CONST(2000000000000000000)},
+	{UINT64CONST(0), UINT64CONST(1250000000000000000)},
+	{UINT64CONST(0), UINT64CONST(1562500000000000000)},
+	{UINT64CONST(0), UINT64CONST(1953125000000000000)},
+	{UINT64CONST(0), UINT64CONST(1220703125000000000)},
+	{UINT64CONST(0), UINT64CONST(1525878906250000000)},
+	{UINT64CONST(0), UINT64CONST(1907348632812500000)},
+	{UINT64CONST(0), UINT64CONST(1192092895507812500)},
+	{UINT64CONST(0), UINT64CONST(1490116119384765625)},
+	{UINT64CONST(4611686018427387904), UINT64CONST(1862645149230957031)},
+	{UINT64CONST(9799832789158199296), UINT64CONST(1164153218269348144)},
+	{UINT64CONST(12249790986447749120), UINT64CONST(1455191522836685180)},
+	{UINT64CONST(15312238733059686400), UINT64CONST(1818989403545856475)},
+	{UINT64CONST(14528612397897220096), UINT64CONST(2273736754432320594)},
+	{UINT64CONST(13692068767113150464), UINT64CONST(1421085471520200371)},
+	{UINT64CONST(12503399940464050176), UINT64CONST(1776356839400250464)},
+	{UINT64CONST(15629249925580062720), UINT64CONST(2220446049250313080)},
+	{UINT64CONST(9768281203487539200), UINT64CONST(1387778780781445675)},
+	{UINT64CONST(7598665485932036096), UINT64CONST(1734723475976807094)},
+	{UINT64CONST(274959820560269312), UINT64CONST(2168404344971008868)},
+	{UINT64CONST(9395221924704944128), UINT64CONST(1355252715606880542)},
+	{UINT64CONST(2520655369026404352), UINT64CONST(1694065894508600678)},
+	{UINT64CONST(12374191248137781248), UINT64CONST(2117582368135750847)},
+	{UINT64CONST(14651398557727195136), UINT64CONST(1323488980084844279)},
+	{UINT64CONST(13702562178731606016), UINT64CONST(1654361225106055349)},
+	{UINT64CONST(3293144668132343808), UINT64CONST(2067951531382569187)},
+	{UINT64CONST(18199116482078572544), UINT64CONST(1292469707114105741)},
+	{UINT64CONST(8913837547316051968), UINT64CONST(1615587133892632177)},
+	{UINT64CONST(15753982952572452864), UINT64CONST(2019483917365790221)},
+	{UINT64CONST(12152082354571476992), UINT64CONST(1262177448353618888)},
+	{UINT64CONST(15190102943214346240), UINT64CONST(1577721810442023610)},
+	{UINT64CONST(9764256642163156992), UINT64CONST(1972152263052529513)},
+	{UINT64CONST(17631875447420442880), UINT64CONST(1232595164407830945)},
+	{UINT64CONST(8204786253993389888), UINT64CONST(1540743955509788682)},
+	{UINT64CONST(1032610780636961552), UINT64CONST(1925929944387235853)},
+	{UINT64CONST(2951224747111794922), UINT64CONST(1203706215242022408)},
+	{UINT64CONST(3689030933889743652), UINT64CONST(1504632769052528010)},
+	{UINT64CONST(13834660704216955373), UINT64CONST(1880790961315660012)},
+	{UINT64CONST(17870034976990372916), UINT64CONST(1175494350822287507)},
+	{UINT64CONST(17725857702810578241), UINT64CONST(1469367938527859384)},
+	{UINT64CONST(3710578054803671186), UINT64CONST(1836709923159824231)},
+	{UINT64CONST(26536550077201078), UINT64CONST(2295887403949780289)},
+	{UINT64CONST(11545800389866720434), UINT64CONST(1434929627468612680)},
+	{UINT64CONST(14432250487333400542), UINT64CONST(1793662034335765850)},
+	{UINT64CONST(8816941072311974870), UINT64CONST(2242077542919707313)},
+	{UINT64CONST(17039803216263454053), UINT64CONST(1401298464324817070)},
+	{UINT64CONST(12076381983474541759), UINT64CONST(1751623080406021338)},
+	{UINT64CONST(5872105442488401391), UINT64CONST(2189528850507526673)},
+	{UINT64CONST(15199280947623720629), UINT64CONST(1368455531567204170)},
+	{UINT64CONST(9775729147674874978), UINT64CONST(1710569414459005213)},
+	{UINT64CONST(16831347453020981627), UINT64CONST(2138211768073756516)},
+	{UINT64CONST(1296220121283337709), UINT64CONST(1336382355046097823)},
+	{UINT64CONST(15455333206886335848), UINT64CONST(1670477943807622278)},
+	{UINT64CONST(10095794471753144002), UINT64CONST(2088097429759527848)},
+	{UINT64CONST(6309871544845715001), UINT64CONST(1305060893599704905)},
+	{UINT64CONST(12499025449484531656), UINT64CONST(1631326116999631131)},
+	{UINT64CONST(11012095793428276666), UINT64CONST(2039157646249538914)},
+	{UINT64CONST(11494245889320060820), UINT64CONST(1274473528905961821)},
+	{UINT64CONST(532749306367912313), UINT64CONST(1593091911132452277)},
+	{UINT64CONST(5277622651387278295), UINT64CONST(1991364888915565346)},
+	{UINT64CONST(7910200175544436838), UINT64CONST(1244603055572228341)},
+	{UINT64CONST(14499436237857933952), UINT64CONST(1555753819465285426)},
+	{UINT64CONST(8900923260467641632), UINT64CONST(1944692274331606783)},
+	{UINT64CONST(12480606065433357876), UINT64CONST(1215432671457254239)},
+	{UINT64CONST(10989071563364309441), UINT64CONST(1519290839321567799)},
+	{UINT64CONST(9124653435777998898), UINT64CONST(1899113549151959749)},
+	{UINT64CONST(8008751406574943263), UINT64CONST(1186945968219974843)},
+	{UINT64CONST(5399253239791291175), UINT64CONST(1483682460274968554)},
+	{UINT64CONST(15972438586593889776), UINT64CONST(1854603075343710692)},
+	{UINT64CONST(759402079766405302), UINT64CONST(1159126922089819183)},
+	{UINT64CONST(14784310654990170340), UINT64CONST(1448908652612273978)},
+	{UINT64CONST(9257016281882937117), UINT64CONST(1811135815765342473)},
+	{UINT64CONST(16182956370781059300), UINT64CONST(2263919769706678091)},
+	{UINT64CONST(7808504722524468110), UINT64CONST(1414949856066673807)},
+	{UINT64CONST(5148944884728197234), UINT64CONST(1768687320083342259)},
+	{UINT64CONST(1824495087482858639), UINT64CONST(2210859150104177824)},
+	{UINT64CONST(1140309429676786649), UINT64CONST(1381786968815111140)},
+	{UINT64CONST(1425386787095983311), UINT64CONST(1727233711018888925)},
+	{UINT64CONST(6393419502297367043), UINT64CONST(2159042138773611156)},
+	{UINT64CONST(13219259225790630210), UINT64CONST(1349401336733506972)},
+	{UINT64CONST(16524074032238287762), UINT64CONST(1686751670916883715)},
+	{UINT64CONST(16043406521870471799), UINT64CONST(2108439588646104644)},
+	{UINT64CONST(803757039314269066), UINT64CONST(1317774742903815403)},
+	{UINT64CONST(14839754354425000045), UINT64CONST(1647218428629769253)},
+	{UINT64CONST(4714634887749086344), UINT64CONST(2059023035787211567)},
+	{UINT64CONST(9864175832484260821), UINT64CONST(1286889397367007229)},
+	{UINT64CONST(16941905809032713930), UINT64CONST(1608611746708759036)},
+	{UINT64CONST(2730638187581340797), UINT64CONST(2010764683385948796)},
+	{UINT64CONST(10930020904093113806), UINT64CONST(1256727927116217997)},
+	{UINT64CONST(18274212148543780162), UINT64CONST(1570909908895272496)},
+	{UINT64CONST(4396021111970173586), UINT64CONST(1963637386119090621)},
+	{UINT64CONST(5053356204195052443), UINT64CONST(1227273366324431638)},
+	{UINT64CONST(15540067292098591362), UINT64CONST(1534091707905539547)},
+	{UINT64CONST(14813398096695851299), UINT64CONST(1917614634881924434)},
+	{UINT64CONST(13870059828862294966), UINT64CONST(1198509146801202771)},
+	{UINT64CONST(12725888767650480803), UINT64CONST(1498136433501503464)},
+	{UINT64CONST(15907360959563101004), UINT64CONST(1872670541876879330)},
+	{UINT64CONST(14553786618154326031), UINT64CONST(1170419088673049581)},
+	{UINT64CONST(4357175217410743827), UINT64CONST(1463023860841311977)},
+	{UINT64CONST(10058155040190817688), UINT64CONST(1828779826051639971)},
+	{UINT64CONST(7961007781811134206), UINT64CONST(2285974782564549964)},
+	{UINT64CONST(14199001900486734687), UINT64CONST(1428734239102843727)},
+	{UINT64CONST(13137066357181030455), UINT64CONST(1785917798878554659)},
+	{UINT64CONST(11809646928048900164), UINT64CONST(2232397248598193324)},
+	{UINT64CONST(16604401366885338411), UINT64CONST(1395248280373870827)},
+	{UINT64CONST(16143815690179285109), UINT64CONST(1744060350467338534)},
+	{UINT64CONST(10956397575869330579), UINT64CONST(2180075438084173168)},
+	{UINT64CONST(6847748484918331612), UINT64CONST(1362547148802608230)},
+	{UINT64CONST(17783057643002690323), UINT64CONST(1703183936003260287)},
+	{UINT64CONST(17617136035325974999), UINT64CONST(2128979920004075359)},
+	{UINT64CONST(17928239049719816230), UINT64CONST(1330612450002547099)},
+	{UINT64CONST(17798612793722382384), UINT64CONST(1663265562503183874)},
+	{UINT64CONST(13024893955298202172), UINT64CONST(2079081953128979843)},
+	{UINT64CONST(5834715712847682405), UINT64CONST(1299426220705612402)},
+	{UINT64CONST(16516766677914378815), UINT64CONST(1624282775882015502)},
+	{UINT64CONST(11422586310538197711), UINT64CONST(2030353469852519378)},
+	{UINT64CONST(11750802462513761473), UINT64CONST(1268970918657824611)},
+	{UINT64CONST(10076817059714813937), UINT64CONST(1586213648322280764)},
+	{UINT64CONST(12596021324643517422), UINT64CONST(1982767060402850955)},
+	{UINT64CONST(5566670318688504437), UINT64CONST(1239229412751781847)},
+	{UINT64CONST(2346651879933242642), UINT64CONST(1549036765939727309)},
+	{UINT64CONST(7545000868343941206), UINT64CONST(1936295957424659136)},
+	{UINT64CONST(4715625542714963254), UINT64CONST(1210184973390411960)},
+	{UINT64CONST(5894531928393704067), UINT64CONST(1512731216738014950)},
+	{UINT64CONST(16591536947346905892), UINT64CONST(1890914020922518687)},
+	{UINT64CONST(17287239619732898039), UINT64CONST(1181821263076574179)},
+	{UINT64CONST(16997363506238734644), UINT64CONST(1477276578845717724)},
+	{UINT64CONST(2799960309088866689), UINT64CONST(1846595723557147156)},
+	{UINT64CONST(10973347230035317489), UINT64CONST(1154122327223216972)},
+	{UINT64CONST(13716684037544146861), UINT64CONST(1442652909029021215)},
+	{UINT64CONST(12534169028502795672), UINT64CONST(1803316136286276519)},
+	{UINT64CONST(11056025267201106687), UINT64CONST(2254145170357845649)},
+	{UINT64CONST(18439230838069161439), UINT64CONST(1408840731473653530)},
+	{UINT64CONST(13825666510731675991), UINT64CONST(1761050914342066913)},
+	{UINT64CONST(3447025083132431277), UINT64CONST(2201313642927583642)},
+	{UINT64CONST(6766076695385157452), UINT64CONST(1375821026829739776)},
+	{UINT64CONST(8457595869231446815), UINT64CONST(1719776283537174720)},
+	{UINT64CONST(10571994836539308519), UINT64CONST(2149720354421468400)},
+	{UINT64CONST(6607496772837067824), UINT64CONST(1343575221513417750)},
+	{UINT64CONST(17482743002901110588), UINT64CONST(1679469026891772187)},
+	{UINT64CONST(17241742735199000331), UINT64CONST(2099336283614715234)},
+	{UINT64CONST(15387775227926763111), UINT64CONST(1312085177259197021)},
+	{UINT64CONST(5399660979626290177), UINT64CONST(1640106471573996277)},
+	{UINT64CONST(11361262242960250625), UINT64CONST(2050133089467495346)},
+	{UINT64CONST(11712474920277544544), UINT64CONST(1281333180917184591)},
+	{UINT64CONST(10028907631919542777), UINT64CONST(1601666476146480739)},
+	{UINT64CONST(7924448521472040567), UINT64CONST(2002083095183100924)},
+	{UINT64CONST(14176152362774801162), UINT64CONST(1251301934489438077)},
+	{UINT64CONST(3885132398186337741), UINT64CONST(1564127418111797597)},
+	{UINT64CONST(9468101516160310080), UINT64CONST(1955159272639746996)},
+	{UINT64CONST(15140935484454969608), UINT64CONST(1221974545399841872)},
+	{UINT64CONST(479425281859160394), UINT64CONST(1527468181749802341)},
+	{UINT64CONST(5210967620751338397), UINT64CONST(1909335227187252926)},
+	{UINT64CONST(17091912818251750210), UINT64CONST(1193334516992033078)},
+	{UINT64CONST(12141518985959911954), UINT64CONST(1491668146240041348)},
+	{UINT64CONST(15176898732449889943), UINT64CONST(1864585182800051685)},
+	{UINT64CONST(11791404716994875166), UINT64CONST(1165365739250032303)},
+	{UINT64CONST(10127569877816206054), UINT64CONST(1456707174062540379)},
+	{UINT64CONST(8047776328842869663), UINT64CONST(1820883967578175474)},
+	{UINT64CONST(836348374198811271), UINT64CONST(2276104959472719343)},
+	{UINT64CONST(7440246761515338900), UINT64CONST(1422565599670449589)},
+	{UINT64CONST(13911994470321561530), UINT64CONST(1778206999588061986)},
+	{UINT64CONST(8166621051047176104), UINT64CONST(2222758749485077483)},
+	{UINT64CONST(2798295147690791113), UINT64CONST(1389224218428173427)},
+	{UINT64CONST(17332926989895652603), UINT64CONST(1736530273035216783)},
+	{UINT64CONST(17054472718942177850), UINT64CONST(2170662841294020979)},
+	{UINT64CONST(8353202440125167204), UINT64CONST(1356664275808763112)},
+	{UINT64CONST(10441503050156459005), UINT64CONST(1695830344760953890)},
+	{UINT64CONST(3828506775840797949), UINT64CONST(2119787930951192363)},
+	{UINT64CONST(86973725686804766), UINT64CONST(1324867456844495227)},
+	{UINT64CONST(13943775212390669669), UINT64CONST(1656084321055619033)},
+	{UINT64CONST(3594660960206173375), UINT64CONST(2070105401319523792)},
+	{UINT64CONST(2246663100128858359), UINT64CONST(1293815875824702370)},
+	{UINT64CONST(12031700912015848757), UINT64CONST(1617269844780877962)},
+	{UINT64CONST(5816254103165035138), UINT64CONST(2021587305976097453)},
+	{UINT64CONST(5941001823691840913), UINT64CONST(1263492066235060908)},
+	{UINT64CONST(7426252279614801142), UINT64CONST(1579365082793826135)},
+	{UINT64CONST(4671129331091113523), UINT64CONST(1974206353492282669)},
+	{UINT64CONST(5225298841145639904), UINT64CONST(1233878970932676668)},
+	{UINT64CONST(6531623551432049880), UINT64CONST(1542348713665845835)},
+	{UINT64CONST(3552843420862674446), UINT64CONST(1927935892082307294)},
+	{UINT64CONST(16055585193321335241), UINT64CONST(1204959932551442058)},
+	{UINT64CONST(10846109454796893243), UINT64CONST(1506199915689302573)},
+	{UINT64CONST(18169322836923504458), UINT64CONST(1882749894611628216)},
+	{UINT64CONST(11355826773077190286), UINT64CONST(1176718684132267635)},
+	{UINT64CONST(9583097447919099954), UINT64CONST(1470898355165334544)},
+	{UINT64CONST(11978871809898874942), UINT64CONST(1838622943956668180)},
+	{UINT64CONST(14973589762373593678), UINT64CONST(2298278679945835225)},
+	{UINT64CONST(2440964573842414192), UINT64CONST(1436424174966147016)},
+	{UINT64CONST(3051205717303017741), UINT64CONST(1795530218707683770)},
+	{UINT64CONST(13037379183483547984), UINT64CONST(2244412773384604712)},
+	{UINT64CONST(8148361989677217490), UINT64CONST(1402757983365377945)},
+	{UINT64CONST(14797138505523909766), UINT64CONST(1753447479206722431)},
+	{UINT64CONST(13884737113477499304), UINT64CONST(2191809349008403039)},
+	{UINT64CONST(15595489723564518921), UINT64CONST(1369880843130251899)},
+	{UINT64CONST(14882676136028260747), UINT64CONST(1712351053912814874)},
+	{UINT64CONST(9379973133180550126), UINT64CONST(2140438817391018593)},
+	{UINT64CONST(17391698254306313589), UINT64CONST(1337774260869386620)},
+	{UINT64CONST(3292878744173340370), UINT64CONST(1672217826086733276)},
+	{UINT64CONST(4116098430216675462), UINT64CONST(2090272282608416595)},
+	{UINT64CONST(266718509671728212), UINT64CONST(1306420176630260372)},
+	{UINT64CONST(333398137089660265), UINT64CONST(1633025220787825465)},
+	{UINT64CONST(5028433689789463235), UINT64CONST(2041281525984781831)},
+	{UINT64CONST(10060300083759496378), UINT64CONST(1275800953740488644)},
+	{UINT64CONST(12575375104699370472), UINT64CONST(1594751192175610805)},
+	{UINT64CONST(1884160825592049379), UINT64CONST(1993438990219513507)},
+	{UINT64CONST(17318501580490888525), UINT64CONST(1245899368887195941)},
+	{UINT64CONST(7813068920331446945), UINT64CONST(1557374211108994927)},
+	{UINT64CONST(5154650131986920777), UINT64CONST(1946717763886243659)},
+	{UINT64CONST(915813323278131534), UINT64CONST(1216698602428902287)},
+	{UINT64CONST(14979824709379828129), UINT64CONST(1520873253036127858)},
+	{UINT64CONST(9501408849870009354), UINT64CONST(1901091566295159823)},
+	{UINT64CONST(12855909558809837702), UINT64CONST(1188182228934474889)},
+	{UINT64CONST(2234828893230133415), UINT64CONST(1485227786168093612)},
+	{UINT64CONST(2793536116537666769), UINT64CONST(1856534732710117015)},
+	{UINT64CONST(8663489100477123587), UINT64CONST(1160334207943823134)},
+	{UINT64CONST(1605989338741628675), UINT64CONST(1450417759929778918)},
+	{UINT64CONST(11230858710281811652), UINT64CONST(1813022199912223647)},
+	{UINT64CONST(9426887369424876662), UINT64CONST(2266277749890279559)},
+	{UINT64CONST(12809333633531629769), UINT64CONST(1416423593681424724)},
+	{UINT64CONST(16011667041914537212), UINT64CONST(1770529492101780905)},
+	{UINT64CONST(6179525747111007803), UINT64CONST(2213161865127226132)},
+	{UINT64CONST(13085575628799155685), UINT64CONST(1383226165704516332)},
+	{UINT64CONST(16356969535998944606), UINT64CONST(1729032707130645415)},
+	{UINT64CONST(15834525901571292854), UINT64CONST(2161290883913306769)},
+	{UINT64CONST(2979049660840976177), UINT64CONST(1350806802445816731)},
+	{UINT64CONST(17558870131333383934), UINT64CONST(1688508503057270913)},
+	{UINT64CONST(8113529608884566205), UINT64CONST(2110635628821588642)},
+	{UINT64CONST(9682642023980241782), UINT64CONST(1319147268013492901)},
+	{UINT64CONST(16714988548402690132), UINT64CONST(1648934085016866126)},
+	{UINT64CONST(11670363648648586857), UINT64CONST(2061167606271082658)},
+	{UINT64CONST(11905663298832754689), UINT64CONST(1288229753919426661)},
+	{UINT64CONST(1047021068258779650), UINT64CONST(1610287192399283327)},
+	{UINT64CONST(15143834390605638274), UINT64CONST(2012858990499104158)},
+	{UINT64CONST(4853210475701136017), UINT64CONST(1258036869061940099)},
+	{UINT64CONST(1454827076199032118), UINT64CONST(1572546086327425124)},
+	{UINT64CONST(1818533845248790147), UINT64CONST(1965682607909281405)},
+	{UINT64CONST(3442426662494187794), UINT64CONST(1228551629943300878)},
+	{UINT64CONST(13526405364972510550), UINT64CONST(1535689537429126097)},
+	{UINT64CONST(3072948650933474476), UINT64CONST(1919611921786407622)},
+	{UINT64CONST(15755650962115585259), UINT64CONST(1199757451116504763)},
+	{UINT64CONST(15082877684217093670), UINT64CONST(1499696813895630954)},
+	{UINT64CONST(9630225068416591280), UINT64CONST(1874621017369538693)},
+	{UINT64CONST(8324733676974063502), UINT64CONST(1171638135855961683)},
+	{UINT64CONST(5794231077790191473), UINT64CONST(1464547669819952104)},
+	{UINT64CONST(7242788847237739342), UINT64CONST(1830684587274940130)},
+	{UINT64CONST(18276858095901949986), UINT64CONST(2288355734093675162)},
+	{UINT64CONST(16034722328366106645), UINT64CONST(1430222333808546976)},
+	{UINT64CONST(1596658836748081690), UINT64CONST(1787777917260683721)},
+	{UINT64CONST(6607509564362490017), UINT64CONST(2234722396575854651)},
+	{UINT64CONST(1823850468512862308), UINT64CONST(1396701497859909157)},
+	{UINT64CONST(6891499104068465790), UINT64CONST(1745876872324886446)},
+	{UINT64CONST(17837745916940358045), UINT64CONST(2182346090406108057)},
+	{UINT64CONST(4231062170446641922), UINT64CONST(1363966306503817536)},
+	{UINT64CONST(5288827713058302403), UINT64CONST(1704957883129771920)},
+	{UINT64CONST(6611034641322878003), UINT64CONST(2131197353912214900)},
+	{UINT64CONST(13355268687681574560), UINT64CONST(1331998346195134312)},
+	{UINT64CONST(16694085859601968200), UINT64CONST(1664997932743917890)},
+	{UINT64CONST(11644235287647684442), UINT64CONST(2081247415929897363)},
+	{UINT64CONST(4971804045566108824), UINT64CONST(1300779634956185852)},
+	{UINT64CONST(6214755056957636030), UINT64CONST(1625974543695232315)},
+	{UINT64CONST(3156757802769657134), UINT64CONST(2032468179619040394)},
+	{UINT64CONST(6584659645158423613), UINT64CONST(1270292612261900246)},
+	{UINT64CONST(17454196593302805324), UINT64CONST(1587865765327375307)},
+	{UINT64CONST(17206059723201118751), UINT64CONST(1984832206659219134)},
+	{UINT64CONST(6142101308573311315), UINT64CONST(1240520129162011959)},
+	{UINT64CONST(3065940617289251240), UINT64CONST(1550650161452514949)},
+	{UINT64CONST(8444111790038951954), UINT64CONST(1938312701815643686)},
+	{UINT64CONST(665883850346957067), UINT64CONST(1211445438634777304)},
+	{UINT64CONST(832354812933696334), UINT64CONST(1514306798293471630)},
+	{UINT64CONST(10263815553021896226), UINT64CONST(1892883497866839537)},
+	{UINT64CONST(17944099766707154901), UINT64CONST(1183052186166774710)},
+	{UINT64CONST(13206752671529167818), UINT64CONST(1478815232708468388)},
+	{UINT64CONST(16508440839411459773), UINT64CONST(1848519040885585485)},
+	{UINT64CONST(12623618533845856310), UINT64CONST(1155324400553490928)},
+	{UINT64CONST(15779523167307320387), UINT64CONST(1444155500691863660)},
+	{UINT64CONST(1277659885424598868), UINT64CONST(1805194375864829576)},
+	{UINT64CONST(1597074856780748586), UINT64CONST(2256492969831036970)},
+	{UINT64CONST(5609857803915355770), UINT64CONST(1410308106144398106)},
+	{UINT64CONST(16235694291748970521), UINT64CONST(1762885132680497632)},
+	{UINT64CONST(1847873790976661535), UINT64CONST(2203606415850622041)},
+	{UINT64CONST(12684136165428883219), UINT64CONST(1377254009906638775)},
+	{UINT64CONST(11243484188358716120), UINT64CONST(1721567512383298469)},
+	{UINT64CONST(219297180166231438), UINT64CONST(2151959390479123087)},
+	{UINT64CONST(7054589765244976505), UINT64CONST(1344974619049451929)},
+	{UINT64CONST(13429923224983608535), UINT64CONST(1681218273811814911)},
+	{UINT64CONST(12175718012802122765), UINT64CONST(2101522842264768639)},
+	{UINT64CONST(14527352785642408584), UINT64CONST(1313451776415480399)},
+	{UINT64CONST(13547504963625622826), UINT64CONST(1641814720519350499)},
+	{UINT64CONST(12322695186104640628), UINT64CONST(2052268400649188124)},
+	{UINT64CONST(16925056528170176201), UINT64CONST(1282667750405742577)},
+	{UINT64CONST(7321262604930556539), UINT64CONST(1603334688007178222)},
+	{UINT64CONST(18374950293017971482), UINT64CONST(2004168360008972777)},
+	{UINT64CONST(4566814905495150320), UINT64CONST(1252605225005607986)},
+	{UINT64CONST(14931890668723713708), UINT64CONST(1565756531257009982)},
+	{UINT64CONST(9441491299049866327), UINT64CONST(1957195664071262478)},
+	{UINT64CONST(1289246043478778550), UINT64CONST(1223247290044539049)},
+	{UINT64CONST(6223243572775861092), UINT64CONST(1529059112555673811)},
+	{UINT64CONST(3167368447542438461), UINT64CONST(1911323890694592264)},
+	{UINT64CONST(1979605279714024038), UINT64CONST(1194577431684120165)},
+	{UINT64CONST(7086192618069917952), UINT64CONST(1493221789605150206)},
+	{UINT64CONST(18081112809442173248), UINT64CONST(1866527237006437757)},
+	{UINT64CONST(13606538515115052232), UINT64CONST(1166579523129023598)},
+	{UINT64CONST(7784801107039039482), UINT64CONST(1458224403911279498)},
+	{UINT64CONST(507629346944023544), UINT64CONST(1822780504889099373)},
+	{UINT64CONST(5246222702107417334), UINT64CONST(2278475631111374216)},
+	{UINT64CONST(3278889188817135834), UINT64CONST(1424047269444608885)},
+	{UINT64CONST(8710297504448807696), UINT64CONST(1780059086805761106)}
+};
+
+#endif   /* RYU_D2S_FULL_TABLE_H */
@@ -0,0 +1,562 @@
+/*-------------------------------------------------------------------------
+ *
+ * zpq_stream.c
+ *	  streaming compression of frontend/backend protocol traffic
+ *
+ * A ZpqStream sits between the protocol buffers and the transport (the
+ * plain socket or the SSL layer).  Everything handed to zpq_write is
+ * compressed and flushed at the end of the call, so that a message the
+ * caller has flushed is never held back waiting for more input; zpq_read
+ * delivers whatever the peer's compressor has flushed.  The transport
+ * functions are called with the same conventions as send() and recv(),
+ * including partial transfers and EAGAIN in non-blocking mode, and those
+ * conventions are passed back to the caller.
+ *
+ * The same code is used by libpq and by the backend, so it must not use
+ * palloc or elog.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/common/zpq_stream.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#include "common/zpq_stream.h"
+
+/* size of the buffers of compressed data on each side */
+#define ZPQ_BUFFER_SIZE		8192
+
+/* compression level; the defaults favor ratio over speed too much here */
+#define ZPQ_ZSTD_LEVEL		1
+#define ZPQ_ZLIB_LEVEL		1
+
+typedef enum ZpqAlgorithm
+{
+	ZPQ_ALGORITHM_ZSTD,
+	ZPQ_ALGORITHM_ZLIB
+} ZpqAlgorithm;
+
+typedef struct ZpqAlgorithmName
+{
+	const char *name;
+	ZpqAlgorithm algorithm;
+} ZpqAlgorithmName;
+
+/* the algorithms this build supports, in order of preference */
+static const ZpqAlgorithmName zpq_algorithms[] = {
+#ifdef USE_ZSTD
+	{"zstd", ZPQ_ALGORITHM_ZSTD},
+#endif
+#ifdef HAVE_LIBZ
+	{"zlib", ZPQ_ALGORITHM_ZLIB},
+#endif
+	{NULL, ZPQ_ALGORITHM_ZSTD}
+};
+
+struct ZpqStream
+{
+	ZpqAlgorithm algorithm;
+	const char *name;
+
+	zpq_tx_func tx;
+	zpq_rx_func rx;
+	void	   *arg;
+
+#ifdef USE_ZSTD
+	ZSTD_CStream *zstd_tx;
+	ZSTD_DStream *zstd_rx;
+#endif
+#ifdef HAVE_LIBZ
+	z_stream	zlib_tx;
+	z_stream	zlib_rx;
+	bool		zlib_tx_ready;
+	bool		zlib_rx_ready;
+#endif
+
+	/* compressed data not yet handed to the transport */
+	char		tx_buf[ZPQ_BUFFER_SIZE];
+	size_t		tx_pos;
+	size_t		tx_len;
+	bool		tx_more;		/* compressor may hold more output */
+
+	/* compressed data received but not yet decompressed */
+	char	   *rx_buf;
+	size_t		rx_size;
+	size_t		rx_pos;
+	size_t		rx_len;
+	bool		rx_more;		/* decompressor may hold more output */
+
+	const char *error;			/* last compression library error */
+
+	uint64		raw_sent;
+	uint64		sent;
+	uint64		raw_received;
+	uint64		received;
+};
+
+static bool zpq_compress(ZpqStream *zs, const char *src, size_t srclen,
+			 size_t *consumed);
+static bool zpq_decompress(ZpqStream *zs, char *dst, size_t dstlen,
+			   size_t *produced);
+
+
+/*
+ * zpq_supported_algorithms
+ *		Comma-separated list of the algorithms of this build, best first,
+ *		in the format the client sends in its startup packet.  It's empty
+ *		if compression is not available at all.
+ */
+const char *
+zpq_supported_algorithms(void)
+{
+#if defined(USE_ZSTD) && defined(HAVE_LIBZ)
+	return "zstd,zlib";
+#elif defined(USE_ZSTD)
+	return "zstd";
+#elif defined(HAVE_LIBZ)
+	return "zlib";
+#else
+	return "";
+#endif
+}
+
+/*
+ * zpq_choose_algorithm
+ *		Pick the first algorithm of a comma-separated list that this build
+ *		supports.  Returns a static string, or NULL if there is none.
+ */
+const char *
+zpq_choose_algorithm(const char *requested)
+{
+	const char *p = requested;
+
+	while (*p)
+	{
+		const char *start;
+		size_t		len;
+		int			i;
+
+		while (*p == ',' || *p == ' ')
+			p++;
+		start = p;
+		while (*p && *p != ',' && *p != ' ')
+			p++;
+		len = p - start;
+		if (len == 0)
+			continue;
+
+		for (i = 0; zpq_algorithms[i].name != NULL; i++)
+		{
+			if (strlen(zpq_algorithms[i].name) == len &&
+				pg_strncasecmp(zpq_algorithms[i].name, start, len) == 0)
+				return zpq_algorithms[i].name;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * zpq_create
+ *		Set up compression in both directions with the given algorithm.
+ *
+ * rx_data holds compressed bytes that were already read from the transport
+ * by the caller, if any.  Returns NULL if the algorithm is not supported or
+ * memory runs out.
+ */
+ZpqStream *
+zpq_create(const char *algorithm, zpq_tx_func tx, zpq_rx_func rx, void *arg,
+		   const char *rx_data, size_t rx_len)
+{
+	ZpqStream  *zs;
+	int			i;
+
+	for (i = 0; zpq_algorithms[i].name != NULL; i++)
+	{
+		if (pg_strcasecmp(zpq_algorithms[i].name, algorithm) == 0)
+			break;
+	}
+	if (zpq_algorithms[i].name == NULL)
+		return NULL;
+
+	zs = (ZpqStream *) malloc(sizeof(ZpqStream));
+	if (zs == NULL)
+		return NULL;
+	memset(zs, 0, sizeof(ZpqStream));
+	zs->algorithm = zpq_algorithms[i].algorithm;
+	zs->name = zpq_algorithms[i].name;
+	zs->tx = tx;
+	zs->rx = rx;
+	zs->arg = arg;
+
+	zs->rx_size = Max(ZPQ_BUFFER_SIZE, rx_len);
+	zs->rx_buf = (char *) malloc(zs->rx_size);
+	if (zs->rx_buf == NULL)
+	{
+		zpq_free(zs);
+		return NULL;
+	}
+	if (rx_len > 0)
+	{
+		memcpy(zs->rx_buf, rx_data, rx_len);
+		zs->rx_len = rx_len;
+		zs->received = rx_len;
+	}
+
+	switch (zs->algorithm)
+	{
+		case ZPQ_ALGORITHM_ZSTD:
+#ifdef USE_ZSTD
+			zs->zstd_tx = ZSTD_createCStream();
+			zs->zstd_rx = ZSTD_createDStream();
+			if (zs->zstd_tx == NULL || zs->zstd_rx == NULL ||
+				ZSTD_isError(ZSTD_initCStream(zs->zstd_tx, ZPQ_ZSTD_LEVEL)) ||
+				ZSTD_isError(ZSTD_initDStream(zs->zstd_rx)))
+			{
+				zpq_free(zs);
+				return NULL;
+			}
+#endif
+			break;
+		case ZPQ_ALGORITHM_ZLIB:
+#ifdef HAVE_LIBZ
+			if (deflateInit(&zs->zlib_tx, ZPQ_ZLIB_LEVEL) != Z_OK)
+			{
+				zpq_free(zs);
+				return NULL;
+			}
+			zs->zlib_tx_ready = true;
+			if (inflateInit(&zs->zlib_rx) != Z_OK)
+			{
+				zpq_free(zs);
+				return NULL;
+			}
+			zs->zlib_rx_ready = true;
+#endif
+			break;
+	}
+
+	return zs;
+}
+
+/*
+ * zpq_compress
+ *		Compress as much of src as fits into the empty tx buffer, and flush
+ *		the compressor.
+ *
+ * If the buffer fills up, tx_more is set, and the caller must call again
+ * (with the rest of the input, possibly none) once the buffer is sent.
+ */
+static bool
+zpq_compress(ZpqStream *zs, const char *src, size_t srclen, size_t *consumed)
+{
+	Assert(zs->tx_pos == 0 && zs->tx_len == 0);
+
+	*consumed = 0;
+	switch (zs->algorithm)
+	{
+		case ZPQ_ALGORITHM_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_inBuffer in;
+				ZSTD_outBuffer out;
+				size_t		rc;
+
+				in.src = src;
+				in.size = srclen;
+				in.pos = 0;
+				out.dst = zs->tx_buf;
+				out.size = ZPQ_BUFFER_SIZE;
+				out.pos = 0;
+
+				rc = ZSTD_compressStream(zs->zstd_tx, &out, &in);
+				if (!ZSTD_isError(rc) && in.pos == in.size)
+					rc = ZSTD_flushStream(zs->zstd_tx, &out);
+				if (ZSTD_isError(rc))
+				{
+					zs->error = ZSTD_getErrorName(rc);
+					return false;
+				}
+				*consumed = in.pos;
+				zs->tx_len = out.pos;
+				/* rc is the amount still to be flushed, if input is done */
+				zs->tx_more = (in.pos < in.size || rc > 0);
+			}
+#endif
+			break;
+		case ZPQ_ALGORITHM_ZLIB:
+#ifdef HAVE_LIBZ
+			{
+				int			rc;
+
+				zs->zlib_tx.next_in = (Bytef *) src;
+				zs->zlib_tx.avail_in = srclen;
+				zs->zlib_tx.next_out = (Bytef *) zs->tx_buf;
+				zs->zlib_tx.avail_out = ZPQ_BUFFER_SIZE;
+
+				rc = deflate(&zs->zlib_tx, Z_SYNC_FLUSH);
+				/* Z_BUF_ERROR only means there was nothing to do */
+				if (rc != Z_OK && rc != Z_BUF_ERROR)
+				{
+					zs->error = zs->zlib_tx.msg ? zs->zlib_tx.msg :
+						"compression failed";
+					return false;
+				}
+				*consumed = srclen - zs->zlib_tx.avail_in;
+				zs->tx_len = ZPQ_BUFFER_SIZE - zs->zlib_tx.avail_out;
+				zs->tx_more = (zs->zlib_tx.avail_out == 0);
+			}
+#endif
+			break;
+	}
+
+	return true;
+}
+
+/*
+ * zpq_decompress
+ *		Decompress buffered input into dst.
+ *
+ * If dst fills up, rx_more is set, since the decompressor may have more
+ * output even with no input left.
+ */
+static bool
+zpq_decompress(ZpqStream *zs, char *dst, size_t dstlen, size_t *produced)
+{
+	*produced = 0;
+	switch (zs->algorithm)
+	{
+		case ZPQ_ALGORITHM_ZSTD:
+#ifdef USE_ZSTD
+			{
+				ZSTD_inBuffer in;
+				ZSTD_outBuffer out;
+				size_t		rc;
+
+				in.src = zs->rx_buf;
+				in.size = zs->rx_len;
+				in.pos = zs->rx_pos;
+				out.dst = dst;
+				out.size = dstlen;
+				out.pos = 0;
+
+				rc = ZSTD_decompressStream(zs->zstd_rx, &out, &in);
+				if (ZSTD_isError(rc))
+				{
+					zs->error = ZSTD_getErrorName(rc);
+					return false;
+				}
+				zs->rx_pos = in.pos;
+				*produced = out.pos;
+				zs->rx_more = (out.pos == out.size);
+			}
+#endif
+			break;
+		case ZPQ_ALGORITHM_ZLIB:
+#ifdef HAVE_LIBZ
+			{
+				int			rc;
+
+				zs->zlib_rx.next_in = (Bytef *) (zs->rx_buf + zs->rx_pos);
+				zs->zlib_rx.avail_in = zs->rx_len - zs->rx_pos;
+				zs->zlib_rx.next_out = (Bytef *) dst;
+				zs->zlib_rx.avail_out = dstlen;
+
+				rc = inflate(&zs->zlib_rx, Z_SYNC_FLUSH);
+				/* the peer never ends its stream */
+				if (rc != Z_OK && rc != Z_BUF_ERROR)
+				{
+					zs->error = zs->zlib_rx.msg ? zs->zlib_rx.msg :
+						"invalid compressed data";
+					return false;
+				}
+				zs->rx_pos = zs->rx_len - zs->zlib_rx.avail_in;
+				*produced = dstlen - zs->zlib_rx.avail_out;
+				zs->rx_more = (zs->zlib_rx.avail_out == 0);
+			}
+#endif
+			break;
+	}
+
+	return true;
+}
+
+/*
+ * zpq_read
+ *		Read and decompress up to size bytes.
+ *
+ * Buffered input is decompressed first; the transport is read only when
+ * that yields nothing.  Returns the number of bytes stored in buf, the
+ * transport's result if it reported EOF or an error, or ZPQ_STREAM_ERROR
+ * if the data could not be decompressed.
+ */
+ssize_t
+zpq_read(ZpqStream *zs, void *buf, size_t size)
+{
+	for (;;)
+	{
+		ssize_t		rc;
+
+		if (zs->rx_pos < zs->rx_len || zs->rx_more)
+		{
+			size_t		prev_pos = zs->rx_pos;
+			size_t		produced;
+
+			if (!zpq_decompress(zs, (char *) buf, size, &produced))
+				return ZPQ_STREAM_ERROR;
+			if (produced > 0)
+			{
+				zs->raw_received += produced;
+				return produced;
+			}
+			if (zs->rx_pos < zs->rx_len && zs->rx_pos == prev_pos)
+			{
+				/* input left but no progress: can't happen with sane data */
+				zs->error = "invalid compressed data";
+				return ZPQ_STREAM_ERROR;
+			}
+		}
+
+		/* everything buffered is consumed, so read more */
+		rc = zs->rx(zs->arg, zs->rx_buf, zs->rx_size);
+		if (rc <= 0)
+			return rc;
+		zs->received += rc;
+		zs->rx_pos = 0;
+		zs->rx_len = rc;
+	}
+}
+
+/*
+ * zpq_write
+ *		Compress and send size bytes.
+ *
+ * Like send(), this may consume only part of the input if the transport
+ * would block; any compressed data that could not be sent yet is kept and
+ * sent first by the next call.  A call with size zero just pushes out such
+ * pending data.  Returns the number of input bytes consumed, the
+ * transport's result if it failed before any input was consumed, or
+ * ZPQ_STREAM_ERROR if the data could not be compressed.
+ */
+ssize_t
+zpq_write(ZpqStream *zs, const void *buf, size_t size)
+{
+	size_t		processed = 0;
+
+	for (;;)
+	{
+		size_t		consumed;
+
+		/* send what has been compressed already */
+		while (zs->tx_pos < zs->tx_len)
+		{
+			ssize_t		rc;
+
+			rc = zs->tx(zs->arg, zs->tx_buf + zs->tx_pos,
+						zs->tx_len - zs->tx_pos);
+			if (rc <= 0)
+				return processed > 0 ? (ssize_t) processed : rc;
+			zs->tx_pos += rc;
+			zs->sent += rc;
+		}
+		zs->tx_pos = zs->tx_len = 0;
+
+		if (processed == size && !zs->tx_more)
+			return processed;
+
+		if (!zpq_compress(zs, (const char *) buf + processed, size - processed,
+						  &consumed))
+			return ZPQ_STREAM_ERROR;
+		processed += consumed;
+		zs->raw_sent += consumed;
+	}
+}
+
+/*
+ * zpq_buffered_rx
+ *		Nonzero if zpq_read might return data without reading the
+ *		transport, so that callers know not to wait for the socket.
+ */
+size_t
+zpq_buffered_rx(ZpqStream *zs)
+{
+	return (zs->rx_len - zs->rx_pos) + (zs->rx_more ? 1 : 0);
+}
+
+/*
+ * zpq_buffered_tx
+ *		Nonzero if compressed output is still waiting to be sent.
+ */
+size_t
+zpq_buffered_tx(ZpqStream *zs)
+{
+	return (zs->tx_len - zs->tx_pos) + (zs->tx_more ? 1 : 0);
+}
+
+/* name of the stream's algorithm */
+const char *
+zpq_algorithm(ZpqStream *zs)
+{
+	return zs->name;
+}
+
+/* description of the last ZPQ_STREAM_ERROR */
+const char *
+zpq_error(ZpqStream *zs)
+{
+	return zs->error ? zs->error : "unknown error";
+}
+
+/*
+ * zpq_get_counters
+ *		Report the bytes passed through the stream, before compression and
+ *		as they went over the wire, in each direction.
+ */
+void
+zpq_get_counters(ZpqStream *zs, uint64 *raw_sent, uint64 *sent,
+				 uint64 *raw_received, uint64 *received)
+{
+	*raw_sent = zs->raw_sent;
+	*sent = zs->sent;
+	*raw_received = zs->raw_received;
+	*received = zs->received;
+}
+
+void
+zpq_free(ZpqStream *zs)
+{
+	if (zs == NULL)
+		return;
+
+#ifdef USE_ZSTD
+	if (zs->zstd_tx)
+		ZSTD_freeCStream(zs->zstd_tx);
+	if (zs->zstd_rx)
+		ZSTD_freeDStream(zs->zstd_rx);
+#endif
+#ifdef HAVE_LIBZ
+	if (zs->zlib_tx_ready)
+		deflateEnd(&zs->zlib_tx);
+	if (zs->zlib_rx_ready)
+		inflateEnd(&zs->zlib_rx);
+#endif
+	if (zs->rx_buf)
+		free(zs->rx_buf);
+	free(zs);
+}
@@ -12,6 +12,7 @@
 #define BRIN_INTERNAL_H
 
 #include "fmgr.h"
+#include "storage/block.h"
 #include "storage/buf.h"
 #include "storage/bufpage.h"
 #include "storage/off.h"
@@ -73,6 +74,9 @@ typedef struct BrinDesc
 #define BRIN_PROCNUM_UNION			4
 /* procedure numbers up to 10 are reserved for BRIN future expansion */
 
+/* when passed as a page range to summarize, means "all of them" */
+#define BRIN_ALL_BLOCKRANGES		InvalidBlockNumber
+
 #undef BRIN_DEBUG
 
 #ifdef BRIN_DEBUG
@@ -85,5 +89,6 @@ typedef struct BrinDesc
 extern BrinDesc *brin_build_desc(Relation rel);
 extern void brin_free_desc(BrinDesc *bdesc);
 extern Datum brin_summarize_new_values(PG_FUNCTION_ARGS);
+extern Datum brin_summarize_range(PG_FUNCTION_ARGS);
 
 #endif   /* BRIN_INTERNAL_H */
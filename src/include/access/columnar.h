@@ -0,0 +1,20 @@
+/*
+ * columnar.h
+ *		the columnar table access method
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/columnar.h
+ */
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+/* columnar_writer.c */
+extern void PreCommit_Columnar(void);
+extern void AtEOXact_Columnar(bool isCommit);
+extern void AtEOSubXact_Columnar(bool isCommit, SubTransactionId mySubid,
+					 SubTransactionId parentSubid);
+
+#endif   /* COLUMNAR_H */
@@ -0,0 +1,198 @@
+/*
+ * columnar_internal.h
+ *		internal declarations for the columnar table access method
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/columnar_internal.h
+ */
+#ifndef COLUMNAR_INTERNAL_H
+#define COLUMNAR_INTERNAL_H
+
+#include "access/heapam.h"
+#include "access/tupdesc.h"
+#include "lib/stringinfo.h"
+#include "nodes/bitmapset.h"
+#include "storage/bufmgr.h"
+#include "storage/itemptr.h"
+#include "utils/relcache.h"
+#include "utils/snapshot.h"
+
+
+/*
+ * A columnar table is a metapage followed by a sequence of stripes.  Each
+ * stripe holds the rows written by one statement (or up to
+ * COLUMNAR_STRIPE_ROWS of them), stored column by column: the values of a
+ * column are cut into chunks of up to COLUMNAR_CHUNK_ROWS rows, and each
+ * chunk is encoded and compressed on its own.  Rows with the same position
+ * in the stripe form a "chunk group"; scans skip whole chunk groups whose
+ * min/max values show that the scan keys can't match.
+ *
+ * A stripe is written as one byte stream spread over the content area of
+ * consecutive pages:
+ *
+ *	ColumnarStripeHeader
+ *	uint32 chunk_nrows[nchunks]			rows in each chunk group
+ *	ColumnarColumnInfo colinfo[natts]
+ *	for each column:
+ *		ColumnarChunkDesc desc[nchunks]	the column's directory,
+ *		min/max values					followed by the chunks' min/max
+ *		chunk data
+ *
+ * so that a scan only needs to read the directory and data of the columns
+ * it projects.  Stripes are never modified after they're written, except
+ * that VACUUM freezes their xmin.
+ *
+ * Rows get numbers from a counter in the metapage, reserved a stripe's
+ * worth at a time, and a row's TID encodes its row number, (rowno /
+ * COLUMNAR_ROWS_PER_TID_BLOCK, rowno % COLUMNAR_ROWS_PER_TID_BLOCK + 1),
+ * so TIDs are known as soon as a row is inserted and don't point at the
+ * block the row is stored in.
+ */
+#define COLUMNAR_MAGIC				0x434F4C31	/* "COL1" */
+#define COLUMNAR_VERSION			1
+
+#define COLUMNAR_METAPAGE_BLKNO		0
+#define COLUMNAR_FIRST_STRIPE_BLKNO 1
+
+#define COLUMNAR_STRIPE_ROWS		150000
+#define COLUMNAR_CHUNK_ROWS			10000
+#define COLUMNAR_ROWS_PER_TID_BLOCK 32768
+
+/* chunks and stripes are also cut short when they get this big */
+#define COLUMNAR_CHUNK_MAX_BYTES	(64 * 1024 * 1024)
+#define COLUMNAR_STRIPE_MAX_BYTES	(256 * 1024 * 1024)
+
+/* min/max values longer than this aren't kept */
+#define COLUMNAR_MAX_MINMAX_LEN		256
+
+/* bytes of stripe stream stored on each page */
+#define COLUMNAR_PAGE_PAYLOAD		(BLCKSZ - MAXALIGN(SizeOfPageHeaderData))
+
+typedef struct ColumnarMetaPageData
+{
+	uint32		magic;
+	uint32		version;
+	uint64		next_rowno;		/* first row number not yet reserved */
+} ColumnarMetaPageData;
+
+typedef struct ColumnarStripeHeader
+{
+	uint32		magic;
+	uint32		natts;			/* columns stored; later ones read as NULL */
+	uint32		nblocks;		/* pages taken by the stripe */
+	uint32		length;			/* bytes in the stripe stream */
+	TransactionId xmin;			/* inserting transaction, frozen, or invalid
+								 * if it aborted */
+	CommandId	cmin;			/* inserting command */
+	uint64		first_rowno;	/* row number of the stripe's first row */
+	uint32		nrows;
+	uint32		nchunks;
+} ColumnarStripeHeader;
+
+/* where a column's directory and chunk data are in the stripe stream */
+typedef struct ColumnarColumnInfo
+{
+	uint32		dir_offset;
+	uint32		dir_length;
+	uint32		data_offset;
+	uint32		data_length;
+} ColumnarColumnInfo;
+
+/* chunk encodings */
+#define COLUMNAR_ENCODING_PLAIN		0	/* values one after the other */
+#define COLUMNAR_ENCODING_RLE		1	/* (repeat count, value) runs */
+#define COLUMNAR_ENCODING_DELTA		2	/* differences between integers */
+#define COLUMNAR_ENCODING_DICT		3	/* distinct values, then indexes */
+
+/* chunk flags */
+#define COLUMNAR_CHUNK_HASNULLS		0x01	/* null bitmap precedes values */
+#define COLUMNAR_CHUNK_ALLNULL		0x02	/* no values at all */
+#define COLUMNAR_CHUNK_COMPRESSED	0x04	/* pglz'd after encoding */
+#define COLUMNAR_CHUNK_HASMINMAX	0x08	/* min/max values are stored */
+
+typedef struct ColumnarChunkDesc
+{
+	uint32		offset;			/* within the column's chunk data */
+	uint32		length;			/* stored bytes */
+	uint32		rawlength;		/* bytes before compression */
+	uint32		minmax_offset;	/* within the column's min/max values */
+	uint16		min_length;
+	uint16		max_length;
+	uint8		encoding;
+	uint8		flags;
+} ColumnarChunkDesc;
+
+/* A stripe's header, as read by columnar_read_stripe */
+typedef struct ColumnarStripe
+{
+	BlockNumber start;			/* first page */
+	ColumnarStripeHeader hdr;
+	uint32	   *chunk_nrows;	/* [nchunks] */
+	ColumnarColumnInfo *colinfo;	/* [natts] */
+} ColumnarStripe;
+
+
+/* columnar_storage.c */
+extern uint64 columnar_reserve_rownos(Relation rel, uint32 nrows);
+extern void columnar_rowno_to_tid(uint64 rowno, ItemPointer tid);
+extern bool columnar_tid_to_rowno(ItemPointer tid, uint64 *rowno);
+extern void columnar_write_stripe(Relation rel, ColumnarStripeHeader *hdr,
+					  StringInfo pieces, int npieces);
+extern bool columnar_read_stripe_header(Relation rel,
+							BufferAccessStrategy strategy,
+							BlockNumber start, BlockNumber nblocks,
+							ColumnarStripeHeader *hdr);
+extern void columnar_read_stripe(Relation rel, BufferAccessStrategy strategy,
+					 BlockNumber start, ColumnarStripeHeader *hdr,
+					 ColumnarStripe *stripe);
+extern void columnar_read_bytes(Relation rel, BufferAccessStrategy strategy,
+					BlockNumber start, uint32 offset, uint32 length,
+					char *dest);
+extern char *columnar_read_directory(Relation rel,
+						BufferAccessStrategy strategy,
+						ColumnarStripe *stripe, int attnum);
+extern void columnar_set_stripe_xmin(Relation rel,
+						 BufferAccessStrategy strategy,
+						 BlockNumber start, TransactionId xmin);
+extern bool columnar_stripe_visible(ColumnarStripeHeader *hdr,
+						Snapshot snapshot);
+
+/* columnar_encoding.c */
+extern void columnar_encode_chunk(Form_pg_attribute att, Datum *values,
+					  bool *isnull, int nrows, StringInfo out,
+					  ColumnarChunkDesc *desc);
+extern void columnar_decode_chunk(Form_pg_attribute att, const char *data,
+					  ColumnarChunkDesc *desc, int nrows,
+					  Datum *values, bool *isnull);
+extern void columnar_serialize_datum(Form_pg_attribute att, Datum value,
+						 StringInfo out);
+extern Datum columnar_deserialize_datum(Form_pg_attribute att,
+						   const char *data, int length);
+extern Size columnar_datum_size(Form_pg_attribute att, Datum value);
+
+/* columnar_writer.c */
+extern Oid columnar_tuple_insert(Relation rel, HeapTuple tup, CommandId cid,
+					  int options, BulkInsertState bistate);
+extern void columnar_finish_bulk_insert(Relation rel, int options);
+extern void columnar_flush_pending(Relation rel);
+
+/* columnar_reader.c */
+extern HeapScanDesc columnar_beginscan(Relation rel, Snapshot snapshot,
+				   int nkeys, ScanKey key);
+extern void columnar_scan_set_columns(HeapScanDesc scan, Bitmapset *attrs);
+extern HeapTuple columnar_getnext(HeapScanDesc scan, ScanDirection direction);
+extern int columnar_getbatch(HeapScanDesc scan, int ncols,
+				  AttrNumber *attnums, Datum **values, bool **isnull,
+				  int maxrows);
+extern void columnar_rescan(HeapScanDesc scan, ScanKey key);
+extern void columnar_endscan(HeapScanDesc scan);
+extern bool columnar_fetch(Relation rel, Snapshot snapshot, HeapTuple tuple,
+			   Buffer *userbuf, bool keep_buf, Relation stats_relation);
+extern int columnar_acquire_sample_rows(Relation rel, int elevel,
+							 HeapTuple *rows, int targrows,
+							 double *totalrows, double *totaldeadrows);
+
+#endif   /* COLUMNAR_INTERNAL_H */
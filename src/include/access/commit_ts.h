@@ -18,6 +18,7 @@
 
 
 extern PGDLLIMPORT bool track_commit_timestamp;
+extern int	commit_ts_buffers;
 
 extern bool check_track_commit_timestamp(bool *newval, void **extra,
 							 GucSource source);
@@ -287,6 +287,12 @@ typedef struct
 /* root page of a gist index */
 #define GIST_ROOT_BLKNO				0
 
+/*
+ * Fake LSN given to the pages of a sorted index build that isn't WAL-logged
+ * although the index is.  Any real LSN is higher.
+ */
+#define GistBuildLSN	((XLogRecPtr) 1)
+
 /*
  * Before PostgreSQL 9.1, we used rely on so-called "invalid tuples" on inner
  * pages to finish crash recovery of incomplete page splits. If a crash
@@ -497,12 +503,15 @@ extern IndexTuple gistgetadjusted(Relation r,
 				GISTSTATE *giststate);
 extern IndexTuple gistFormTuple(GISTSTATE *giststate,
 			  Relation r, Datum *attdata, bool *isnull, bool isleaf);
+extern void gistCompressValues(GISTSTATE *giststate, Relation r,
+				   Datum *attdata, bool *isnull, bool isleaf, Datum *compatt);
 
 extern OffsetNumber gistchoose(Relation r, Page p,
 		   IndexTuple it,
 		   GISTSTATE *giststate);
 
 extern void GISTInitBuffer(Buffer b, uint32 f);
+extern void gistinitpage(Page page, Size pageSize, uint32 f);
 extern void gistdentryinit(GISTSTATE *giststate, int nkey, GISTENTRY *e,
 			   Datum k, Relation r, Page pg, OffsetNumber o,
 			   bool l, bool isNull);
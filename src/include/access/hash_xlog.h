@@ -0,0 +1,159 @@
+/*-------------------------------------------------------------------------
+ *
+ * hash_xlog.h
+ *	  header file for Postgres hash AM implementation
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/hash_xlog.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef HASH_XLOG_H
+#define HASH_XLOG_H
+
+#include "access/xlogreader.h"
+#include "lib/stringinfo.h"
+#include "storage/off.h"
+
+
+/*
+ * XLOG records for hash operations
+ *
+ * Index creation doesn't need a record type of its own: the metapage, the
+ * initial bucket pages and the first bitmap page are logged as full page
+ * images with log_newpage_buffer().  The same goes for the pages a bucket
+ * split fills in the new bucket, which no one else can see until the split
+ * publishes the new bucket in the metapage.
+ */
+#define XLOG_HASH_INSERT		0x10	/* add index tuple without split */
+#define XLOG_HASH_ADD_OVFL_PAGE 0x20	/* add overflow page */
+#define XLOG_HASH_NEW_SPLITPOINT	0x30	/* allocate a new splitpoint */
+#define XLOG_HASH_SPLIT_COMPLETE	0x40	/* publish the new bucket */
+#define XLOG_HASH_MOVE_PAGE_CONTENTS	0x50	/* remove tuples from one page
+												 * and add them to another */
+#define XLOG_HASH_SQUEEZE_PAGE	0x60	/* add tuples to one of the previous
+										 * pages in chain and free the ovfl
+										 * page */
+#define XLOG_HASH_DELETE		0x70	/* delete index tuples from a page */
+#define XLOG_HASH_SPLIT_CLEANUP 0x80	/* clear split-cleanup flag in primary
+										 * bucket page after deleting tuples
+										 * that are moved due to split	*/
+#define XLOG_HASH_UPDATE_META_PAGE	0x90	/* update meta page after
+											 * vacuum */
+
+/*
+ * The overflow page operations (XLOG_HASH_ADD_OVFL_PAGE,
+ * XLOG_HASH_MOVE_PAGE_CONTENTS and XLOG_HASH_SQUEEZE_PAGE) touch up to
+ * seven pages at once: the bucket chain neighbours, a bitmap page and the
+ * metapage.  Rather than teaching redo to repeat each of them, they log a
+ * full image of every page they change, and redo just restores the images.
+ *
+ * Backup block 0, if present, is the primary bucket page of the bucket
+ * being reorganized.  Redo takes a cleanup lock on it before restoring the
+ * other pages, to wait out any hot standby scan that is stopped in the
+ * bucket.  It's registered without an image if the operation doesn't change
+ * it.  The remaining blocks, numbered from 1, are the changed pages.
+ */
+#define HASH_XLOG_MAX_PAGES		7
+
+/*
+ * This is what we need to know about simple (without split) insert.
+ *
+ * This data record is used for XLOG_HASH_INSERT
+ *
+ * Backup Blk 0: original page (data contains the inserted tuple)
+ * Backup Blk 1: metapage (HashMetaPageData)
+ */
+typedef struct xl_hash_insert
+{
+	OffsetNumber offnum;
+} xl_hash_insert;
+
+#define SizeOfHashInsert	(offsetof(xl_hash_insert, offnum) + sizeof(OffsetNumber))
+
+/*
+ * This is what we need to know about the allocation of a new splitpoint's
+ * worth of bucket pages.  The pages themselves aren't touched; the last one
+ * is logged as a full page image beforehand, so that redo extends the
+ * relation the same way.
+ *
+ * This data record is used for XLOG_HASH_NEW_SPLITPOINT
+ *
+ * Backup Blk 0: metapage
+ */
+typedef struct xl_hash_new_splitpoint
+{
+	uint32		ovflpoint;		/* new value of hashm_ovflpoint */
+} xl_hash_new_splitpoint;
+
+#define SizeOfHashNewSplitpoint \
+	(offsetof(xl_hash_new_splitpoint, ovflpoint) + sizeof(uint32))
+
+/*
+ * This is what we need to know about the completion of a split: the new
+ * bucket mapping, and the flags of the old bucket's primary page.  By the
+ * time this is logged, the new bucket already holds its copy of the tuples.
+ *
+ * This data record is used for XLOG_HASH_SPLIT_COMPLETE
+ *
+ * Backup Blk 0: old bucket's primary page
+ * Backup Blk 1: metapage
+ */
+typedef struct xl_hash_split_complete
+{
+	uint32		maxbucket;		/* new hashm_maxbucket */
+	uint32		highmask;		/* new hashm_highmask */
+	uint32		lowmask;		/* new hashm_lowmask */
+	uint16		old_bucket_flag;	/* new hasho_flag of the old bucket */
+} xl_hash_split_complete;
+
+#define SizeOfHashSplitComplete \
+	(offsetof(xl_hash_split_complete, old_bucket_flag) + sizeof(uint16))
+
+/*
+ * This is what we need to know about delete operations.
+ *
+ * This data record is used for XLOG_HASH_DELETE
+ *
+ * Backup Blk 0: primary bucket page, unless it's the page the tuples are
+ * deleted from (registered only so that redo can take a cleanup lock on it)
+ * Backup Blk 1: page from which tuples are deleted (data contains the
+ * deleted offsets)
+ */
+typedef struct xl_hash_delete
+{
+	bool		is_primary_bucket_page; /* TRUE if the operation is for
+										 * primary bucket page */
+} xl_hash_delete;
+
+#define SizeOfHashDelete	(offsetof(xl_hash_delete, is_primary_bucket_page) + sizeof(bool))
+
+/*
+ * This is what we need for metapage update operation.
+ *
+ * This data record is used for XLOG_HASH_UPDATE_META_PAGE
+ *
+ * Backup Blk 0: meta page
+ */
+typedef struct xl_hash_update_meta_page
+{
+	double		ntuples;
+} xl_hash_update_meta_page;
+
+#define SizeOfHashUpdateMetaPage	\
+	(offsetof(xl_hash_update_meta_page, ntuples) + sizeof(double))
+
+/*
+ * XLOG_HASH_SPLIT_CLEANUP has no data of its own.
+ *
+ * Backup Blk 0: primary bucket page
+ */
+
+extern void hash_redo(XLogReaderState *record);
+extern void hash_desc(StringInfo buf, XLogReaderState *record);
+extern const char *hash_identify(uint8 info);
+
+#endif   /* HASH_XLOG_H */
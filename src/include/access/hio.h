@@ -32,6 +32,15 @@ typedef struct BulkInsertStateData
 {
 	BufferAccessStrategy strategy;		/* our BULKWRITE strategy object */
 	Buffer		current_buf;	/* current insertion target page */
+
+	/*
+	 * State for extending temporary relations by several blocks at a time:
+	 * the range of blocks added to the file but not used yet, if any, and
+	 * how many blocks we've added in total.
+	 */
+	BlockNumber next_free;
+	BlockNumber last_free;
+	uint32		already_extended_by;
 }	BulkInsertStateData;
 
 
@@ -28,9 +28,9 @@
 
 #define MaxMultiXactOffset	((MultiXactOffset) 0xFFFFFFFF)
 
-/* Number of SLRU buffers to use for multixact */
-#define NUM_MXACTOFFSET_BUFFERS		8
-#define NUM_MXACTMEMBER_BUFFERS		16
+/* GUC variables: number of SLRU buffers to use for multixact */
+extern int	multixact_offsets_buffers;
+extern int	multixact_members_buffers;
 
 /*
  * Possible multixact lock modes ("status").  The first four modes are for
@@ -108,7 +108,22 @@ typedef struct BTMetaPageData
 
 #define BTREE_METAPAGE	0		/* first page is meta */
 #define BTREE_MAGIC		0x053162	/* magic number of btree pages */
-#define BTREE_VERSION	2		/* current version number */
+#define BTREE_VERSION	4		/* current version number */
+#define BTREE_MIN_VERSION	2	/* minimal supported version number */
+
+/*
+ * Version 3 indexes may contain posting list tuples (see below); version 2
+ * indexes, which can still be present after pg_upgrade, never do.  We keep
+ * reading and writing those as they are, and REINDEX brings them up to date.
+ */
+#define BTREE_VERSION_DEDUP	3
+
+/*
+ * Version 4 indexes may also contain truncated pivot tuples (see below).
+ * Those are only ever created in indexes whose metapage says so, for the
+ * same reason.
+ */
+#define BTREE_VERSION_TRUNCATE	4
 
 /*
  * Maximum size of a btree index entry, including its tuple header.
@@ -132,6 +147,110 @@ typedef struct BTMetaPageData
 #define BTREE_DEFAULT_FILLFACTOR	90
 #define BTREE_NONLEAF_FILLFACTOR	70
 
+/*
+ * Posting list tuples.
+ *
+ * In a non-unique index, leaf items whose keys are bitwise identical can be
+ * merged into a single "posting list" tuple: the key, once, followed by a
+ * sorted array of the heap TIDs of all the merged items.  A posting tuple is
+ * flagged with INDEX_AM_RESERVED_BIT in t_info.  Its t_tid doesn't point to
+ * the heap; instead ip_posid holds the number of heap TIDs, and the block
+ * number the offset of the TID array from the start of the tuple (which is
+ * also the MAXALIGN'd size of the key part).  Posting tuples appear only on
+ * leaf pages, never as high keys or downlinks; those are pivot tuples.
+ *
+ * A posting tuple is kept no bigger than BTMaxPostingSize, so that the page
+ * split code always has room to work with.
+ */
+#define BT_ALT_TID		INDEX_AM_RESERVED_BIT
+
+#define BTMaxPostingSize(page)	MAXALIGN_DOWN(BTMaxItemSize(page) / 2)
+
+#define BTreeTupleIsPosting(itup) \
+	(((itup)->t_info & BT_ALT_TID) != 0 && \
+	 ((itup)->t_tid.ip_posid & BT_PIVOT_TRUNCATED) == 0)
+#define BTreeTupleGetNPosting(itup) \
+	( \
+		AssertMacro(BTreeTupleIsPosting(itup)), \
+		(int) (itup)->t_tid.ip_posid \
+	)
+#define BTreeTupleGetPostingOffset(itup) \
+	( \
+		AssertMacro(BTreeTupleIsPosting(itup)), \
+		(Size) BlockIdGetBlockNumber(&(itup)->t_tid.ip_blkid) \
+	)
+#define BTreeTupleSetPosting(itup, nhtids, off) \
+	do { \
+		(itup)->t_info |= BT_ALT_TID; \
+		BlockIdSet(&(itup)->t_tid.ip_blkid, (off)); \
+		(itup)->t_tid.ip_posid = (nhtids); \
+	} while (0)
+#define BTreeTupleGetPosting(itup) \
+	((ItemPointer) ((char *) (itup) + BTreeTupleGetPostingOffset(itup)))
+#define BTreeTupleGetPostingN(itup, n) \
+	(BTreeTupleGetPosting(itup) + (n))
+
+/* Size of the key part of any tuple, header and alignment included */
+#define BTreeTupleGetKeySize(itup) \
+	(BTreeTupleIsPosting(itup) ? BTreeTupleGetPostingOffset(itup) : \
+	 IndexTupleSize(itup))
+
+/* First (or only) heap TID of any leaf tuple, and how many it has */
+#define BTreeTupleGetHeapTID(itup) \
+	(BTreeTupleIsPosting(itup) ? BTreeTupleGetPosting(itup) : &(itup)->t_tid)
+#define BTreeTupleGetNHeapTIDs(itup) \
+	(BTreeTupleIsPosting(itup) ? BTreeTupleGetNPosting(itup) : 1)
+
+/*
+ * Pivot tuples.
+ *
+ * High keys and downlinks only need to separate the keys on either side of
+ * them, so when a leaf page is split the new high key is cut down to the
+ * attributes that tell the last item on the left from the first one on the
+ * right; the ones after that are dropped and considered to be minus
+ * infinity.  For a key attribute whose ordering is plain byte order, the
+ * last attribute kept is shortened too, to the shortest prefix that still
+ * sorts above the last item on the left.  See _bt_truncate().
+ *
+ * A pivot tuple with fewer attributes than the index is flagged with
+ * BT_ALT_TID in t_info and with BT_PIVOT_TRUNCATED in ip_posid, whose other
+ * bits hold the number of attributes kept.  Its block number is the downlink
+ * as usual, so code that sets a downlink must use BTreeTupleSetDownLink to
+ * leave the attribute count alone.  A pivot tuple that keeps all attributes
+ * is a plain tuple whose t_tid is the first heap TID of the item it was made
+ * from, with the offset number of a downlink set to P_HIKEY.
+ */
+#define BT_PIVOT_TRUNCATED	0x8000
+#define BT_PIVOT_NATTS_MASK	0x7FFF
+
+#define BTreeTupleIsTruncated(itup) \
+	(((itup)->t_info & BT_ALT_TID) != 0 && \
+	 ((itup)->t_tid.ip_posid & BT_PIVOT_TRUNCATED) != 0)
+#define BTreeTupleGetNAtts(itup, rel) \
+	(BTreeTupleIsTruncated(itup) ? \
+	 (int) ((itup)->t_tid.ip_posid & BT_PIVOT_NATTS_MASK) : \
+	 (int) RelationGetNumberOfAttributes(rel))
+#define BTreeTupleSetNAtts(itup, natts) \
+	do { \
+		(itup)->t_info |= BT_ALT_TID; \
+		(itup)->t_tid.ip_posid = (natts) | BT_PIVOT_TRUNCATED; \
+	} while (0)
+#define BTreeTupleSetDownLink(itup, blkno) \
+	do { \
+		if (BTreeTupleIsTruncated(itup)) \
+			BlockIdSet(&(itup)->t_tid.ip_blkid, (blkno)); \
+		else \
+			ItemPointerSet(&(itup)->t_tid, (blkno), P_HIKEY); \
+	} while (0)
+
+/*
+ * Most heap TIDs that can be found on a leaf page: a page holding nothing
+ * but posting list TID arrays.  Scans size their per-page arrays by this.
+ */
+#define MaxTIDsPerBTreePage \
+	((int) ((BLCKSZ - SizeOfPageHeaderData - sizeof(BTPageOpaqueData)) / \
+			sizeof(ItemPointerData)))
+
 /*
  *	Test whether two btree entries are "the same".
  *
@@ -149,13 +268,14 @@ typedef struct BTMetaPageData
  *	are unique, not in ALL INDEX. So, we can use the t_tid
  *	as unique identifier for a given index tuple (logical position
  *	within a level). - vadim 04/09/97
+ *
+ *	Only the block number is compared, since the offset number of a
+ *	truncated pivot tuple holds its attribute count; a downlink's block
+ *	number is unique within its level all by itself.
  */
-#define BTTidSame(i1, i2)	\
-	( (i1).ip_blkid.bi_hi == (i2).ip_blkid.bi_hi && \
-	  (i1).ip_blkid.bi_lo == (i2).ip_blkid.bi_lo && \
-	  (i1).ip_posid == (i2).ip_posid )
-#define BTEntrySame(i1, i2) \
-	BTTidSame((i1)->t_tid, (i2)->t_tid)
+#define BTEntrySame(i1, i2)	\
+	( (i1)->t_tid.ip_blkid.bi_hi == (i2)->t_tid.ip_blkid.bi_hi && \
+	  (i1)->t_tid.ip_blkid.bi_lo == (i2)->t_tid.ip_blkid.bi_lo )
 
 
 /*
@@ -226,6 +346,7 @@ typedef struct BTMetaPageData
 										 * vacuum */
 #define XLOG_BTREE_REUSE_PAGE	0xD0	/* old page is about to be reused from
 										 * FSM */
+#define XLOG_BTREE_DEDUP		0xE0	/* merge duplicates into posting lists */
 
 /*
  * All that we need to regenerate the meta-data page
@@ -236,6 +357,7 @@ typedef struct xl_btree_metadata
 	uint32		level;
 	BlockNumber fastroot;
 	uint32		fastlevel;
+	uint32		version;
 } xl_btree_metadata;
 
 /*
@@ -275,9 +397,10 @@ typedef struct xl_btree_insert
  *
  * The left page's data portion contains the new item, if it's the _L variant.
  * (In the _R variants, the new item is one of the right page's tuples.)
- * If level > 0, an IndexTuple representing the HIKEY of the left page
- * follows.  We don't need this on leaf pages, because it's the same as the
- * leftmost key in the new right page.
+ * An IndexTuple representing the HIKEY of the left page follows.  On leaf
+ * pages it's made from the leftmost key in the new right page, but it may
+ * have been truncated (or cut down from a posting list tuple), so it can't be
+ * derived from the right page.
  *
  * Backup Blk 1: new right page
  *
@@ -344,17 +467,47 @@ typedef struct xl_btree_reuse_page
  * starting from the last block vacuumed through until this one. Individual
  * block numbers aren't given.
  *
+ * Posting list tuples that lose only some of their heap TIDs are not deleted
+ * but replaced by a smaller version of themselves ("updated").
+ *
  * Note that the *last* WAL record in any vacuum of an index is allowed to
- * have a zero length array of offsets. Earlier records must have at least one.
+ * have zero deleted and updated items. Earlier records must have at least one.
  */
 typedef struct xl_btree_vacuum
 {
 	BlockNumber lastBlockVacuumed;
+	uint16		ndeleted;
+	uint16		nupdated;
 
-	/* TARGET OFFSET NUMBERS FOLLOW */
+	/*
+	 * Block 0 data: ndeleted target offset numbers, then nupdated target
+	 * offset numbers, then the nupdated replacement tuples
+	 */
 } xl_btree_vacuum;
 
-#define SizeOfBtreeVacuum	(offsetof(xl_btree_vacuum, lastBlockVacuumed) + sizeof(BlockNumber))
+#define SizeOfBtreeVacuum	(offsetof(xl_btree_vacuum, nupdated) + sizeof(uint16))
+
+/*
+ * This is what we need to know about a deduplication pass over a leaf page.
+ * Each interval gives a run of adjacent items that were merged into a single
+ * posting list tuple, which takes the place of the run's first item.
+ *
+ * Backup Blk 0: leaf page (data contains the BTDedupInterval array)
+ */
+typedef struct xl_btree_dedup
+{
+	uint16		nintervals;
+
+	/* BTDedupInterval ARRAY FOLLOWS */
+} xl_btree_dedup;
+
+#define SizeOfBtreeDedup	(offsetof(xl_btree_dedup, nintervals) + sizeof(uint16))
+
+typedef struct BTDedupInterval
+{
+	OffsetNumber baseoff;		/* offset of the run's first item */
+	uint16		nitems;			/* number of items in the run */
+} BTDedupInterval;
 
 /*
  * This is what we need to know about marking an empty branch for deletion.
@@ -505,6 +658,10 @@ typedef BTStackData *BTStack;
  * matched item, otherwise only its heap TID and offset.  The IndexTuples go
  * into a separate workspace array; each BTScanPosItem stores its tuple's
  * offset within that array.
+ *
+ * A posting list tuple yields one BTScanPosItem per heap TID, all with the
+ * same indexOffset; for an index-only scan, they share a single copy of the
+ * tuple's key, stored as a plain tuple.
  */
 
 typedef struct BTScanPosItem	/* what we remember about each match */
@@ -548,7 +705,7 @@ typedef struct BTScanPosData
 	int			lastItem;		/* last valid index in items[] */
 	int			itemIndex;		/* current index in items[] */
 
-	BTScanPosItem items[MaxIndexTuplesPerPage]; /* MUST BE LAST */
+	BTScanPosItem items[MaxTIDsPerBTreePage];	/* MUST BE LAST */
 } BTScanPosData;
 
 typedef BTScanPosData *BTScanPos;
@@ -595,6 +752,60 @@ typedef struct BTArrayKeyInfo
 	Datum	   *elem_values;	/* array of num_elems Datums */
 } BTArrayKeyInfo;
 
+/*
+ * When a scan has no keys on the first index column but has keys on the
+ * second one, we avoid reading the whole index by doing a "skip scan": one
+ * primitive indexscan per distinct value of the first column, with an equality
+ * key for that value added to the scan keys.  Since the distinct values are
+ * not known in advance, they are discovered as the scan proceeds, either from
+ * the tuple that ended the previous primitive scan or by a separate descent
+ * looking for the first tuple beyond the last value.  See
+ * _bt_advance_skip_key().
+ *
+ * If a new descent keeps landing on the page where the previous primitive
+ * scan stopped, the first column has too many distinct values for skipping to
+ * pay off, and the rest of the index is read in one primitive scan instead.
+ */
+typedef enum BTSkipMode
+{
+	BT_SKIP_PROBE,				/* find first tuple beyond the current value */
+	BT_SKIP_EQUAL,				/* scan tuples equal to the current value */
+	BT_SKIP_REST				/* scan all tuples beyond the current value */
+} BTSkipMode;
+
+typedef struct BTSkipPos
+{
+	BTSkipMode	mode;
+	bool		haveValue;		/* false if scanning from the start */
+	Datum		value;			/* current first-column value */
+	bool		isnull;			/* current value is NULL */
+	bool		strict;			/* PROBE/REST exclude the value itself */
+	ScanDirection dir;			/* direction PROBE/REST move in */
+} BTSkipPos;
+
+typedef struct BTSkipKeyInfo
+{
+	BTSkipPos	cur;			/* current position */
+	BTSkipPos	mark;			/* marked position */
+
+	/* first-column value of the tuple that ended the last primitive scan */
+	bool		nextValid;
+	Datum		nextValue;
+	bool		nextIsNull;
+	ScanDirection nextDir;
+
+	/* to detect when skipping does no good */
+	BlockNumber lastPage;		/* leaf page the last primitive scan ended on */
+	int			nWasted;		/* consecutive descents back to lastPage */
+	bool		newGroup;		/* next descent is for a new EQUAL value */
+
+	ScanKey		inKeys;			/* skip key followed by the scan's keys */
+	FmgrInfo	procs[BTMaxStrategyNumber]; /* first column's operators */
+	int16		typlen;			/* first column's type */
+	bool		typbyval;
+	MemoryContext skipContext;	/* holds the Datum values above */
+} BTSkipKeyInfo;
+
 typedef struct BTScanOpaqueData
 {
 	/* these fields are set by _bt_preprocess_keys(): */
@@ -609,6 +820,10 @@ typedef struct BTScanOpaqueData
 	BTArrayKeyInfo *arrayKeys;	/* info about each equality-type array key */
 	MemoryContext arrayContext; /* scan-lifespan context for array data */
 
+	/* workspace for skip scans, see BTSkipKeyInfo */
+	BTSkipKeyInfo *skipInfo;	/* NULL if never used by the scan */
+	bool		skipActive;		/* doing a skip scan now? */
+
 	/* info about killed items if any (killedItems is NULL if never used) */
 	int		   *killedItems;	/* currPos.items indexes of killed items */
 	int			numKilled;		/* number of currently stored items */
@@ -644,6 +859,7 @@ typedef BTScanOpaqueData *BTScanOpaque;
  */
 #define SK_BT_REQFWD	0x00010000		/* required to continue forward scan */
 #define SK_BT_REQBKWD	0x00020000		/* required to continue backward scan */
+#define SK_BT_SKIP		0x00040000		/* key added for a skip scan */
 #define SK_BT_INDOPTION_SHIFT  24		/* must clear the above bits */
 #define SK_BT_DESC			(INDOPTION_DESC << SK_BT_INDOPTION_SHIFT)
 #define SK_BT_NULLS_FIRST	(INDOPTION_NULLS_FIRST << SK_BT_INDOPTION_SHIFT)
@@ -652,6 +868,8 @@ typedef BTScanOpaqueData *BTScanOpaque;
  * prototypes for functions in nbtree.c (external entry points for btree)
  */
 extern Datum btbuild(PG_FUNCTION_ARGS);
+extern void btbuildCallback(Relation index, HeapTuple htup, Datum *values,
+				bool *isnull, bool tupleIsAlive, void *state);
 extern Datum btbuildempty(PG_FUNCTION_ARGS);
 extern Datum btinsert(PG_FUNCTION_ARGS);
 extern Datum btbeginscan(PG_FUNCTION_ARGS);
@@ -681,6 +899,8 @@ extern void _bt_initmetapage(Page page, BlockNumber rootbknum, uint32 level);
 extern Buffer _bt_getroot(Relation rel, int access);
 extern Buffer _bt_gettrueroot(Relation rel);
 extern int	_bt_getrootheight(Relation rel);
+extern bool _bt_dedup_allowed(Relation rel);
+extern bool _bt_truncate_allowed(Relation rel);
 extern void _bt_checkpage(Relation rel, Buffer buf);
 extern Buffer _bt_getbuf(Relation rel, BlockNumber blkno, int access);
 extern Buffer _bt_relandgetbuf(Relation rel, Buffer obuf,
@@ -692,7 +912,8 @@ extern void _bt_delitems_delete(Relation rel, Buffer buf,
 					OffsetNumber *itemnos, int nitems, Relation heapRel);
 extern void _bt_delitems_vacuum(Relation rel, Buffer buf,
 					OffsetNumber *itemnos, int nitems,
-					BlockNumber lastBlockVacuumed);
+					OffsetNumber *updatedoffs, IndexTuple *updated,
+					int nupdated, BlockNumber lastBlockVacuumed);
 extern int	_bt_pagedel(Relation rel, Buffer buf);
 
 /*
@@ -724,11 +945,25 @@ extern void _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir);
 extern bool _bt_advance_array_keys(IndexScanDesc scan, ScanDirection dir);
 extern void _bt_mark_array_keys(IndexScanDesc scan);
 extern void _bt_restore_array_keys(IndexScanDesc scan);
+extern void _bt_preprocess_skip_key(IndexScanDesc scan);
+extern void _bt_start_skip_key(IndexScanDesc scan, ScanDirection dir);
+extern bool _bt_advance_skip_key(IndexScanDesc scan, ScanDirection dir);
+extern bool _bt_advance_scan_keys(IndexScanDesc scan, ScanDirection dir);
+extern void _bt_mark_skip_key(IndexScanDesc scan);
+extern void _bt_restore_skip_key(IndexScanDesc scan);
+extern void _bt_skip_count_descent(IndexScanDesc scan, BlockNumber blkno);
 extern void _bt_preprocess_keys(IndexScanDesc scan);
 extern IndexTuple _bt_checkkeys(IndexScanDesc scan,
 			  Page page, OffsetNumber offnum,
 			  ScanDirection dir, bool *continuescan);
 extern void _bt_killitems(IndexScanDesc scan);
+extern IndexTuple _bt_form_posting(IndexTuple base, ItemPointer htids,
+				 int nhtids);
+extern bool _bt_keys_identical(IndexTuple itup1, IndexTuple itup2);
+extern IndexTuple _bt_truncate(Relation rel, IndexTuple lastleft,
+			 IndexTuple firstright);
+extern Page _bt_dedup_build_page(Page page, BTDedupInterval *intervals,
+					 int nintervals);
 extern BTCycleId _bt_vacuum_cycleid(Relation rel);
 extern BTCycleId _bt_start_vacuum(Relation rel);
 extern void _bt_end_vacuum(Relation rel);
@@ -741,17 +976,43 @@ extern void BTreeShmemInit(void);
  */
 typedef struct BTSpool BTSpool; /* opaque type known only within nbtsort.c */
 
+/* Working state for btbuild and its callback */
+typedef struct
+{
+	bool		isUnique;
+	bool		haveDead;
+	Relation	heapRel;
+	BTSpool    *spool;
+
+	/*
+	 * spool2 is needed only when the index is a unique index. Dead tuples are
+	 * put into spool2 instead of spool in order to avoid uniqueness check.
+	 */
+	BTSpool    *spool2;
+	double		indtuples;
+} BTBuildState;
+
+struct IndexInfo;
+struct dsm_segment;
+struct shm_toc;
+
 extern BTSpool *_bt_spoolinit(Relation heap, Relation index,
 			  bool isunique, bool isdead);
 extern void _bt_spooldestroy(BTSpool *btspool);
 extern void _bt_spool(BTSpool *btspool, ItemPointer self,
 		  Datum *values, bool *isnull);
 extern void _bt_leafbuild(BTSpool *btspool, BTSpool *spool2);
+extern int	_bt_parallel_workers(Relation heap, struct IndexInfo *indexInfo);
+extern double _bt_parallel_build(BTBuildState *buildstate, Relation index,
+				   struct IndexInfo *indexInfo, int nworkers);
+extern void _bt_parallel_build_main(struct dsm_segment *seg,
+						struct shm_toc *toc);
 
 /*
  * prototypes for functions in nbtxlog.c
  */
 extern void btree_redo(XLogReaderState *record);
+extern bool btree_parallel_safe(XLogReaderState *record);
 extern void btree_desc(StringInfo buf, XLogReaderState *record);
 extern const char *btree_identify(uint8 info);
 
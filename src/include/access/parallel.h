@@ -22,6 +22,7 @@
 #include "utils/elog.h"
 
 typedef void (*parallel_worker_main_type) (dsm_segment *seg, shm_toc *toc);
+typedef void (*parallel_message_callback) (void *arg, Size nbytes, void *data);
 
 typedef struct ParallelWorkerInfo
 {
@@ -60,6 +61,18 @@ extern void WaitForParallelWorkersToFinish(ParallelContext *);
 extern void DestroyParallelContext(ParallelContext *);
 extern bool ParallelContextActive(void);
 
+extern void EstimateParallelQueues(ParallelContext *pcxt, Size queue_size);
+extern char *InitializeParallelQueues(ParallelContext *pcxt, uint64 key,
+						 Size queue_size, bool leader_sends);
+extern int AttachParallelQueues(ParallelContext *pcxt, char *queuespace,
+					 Size queue_size, shm_mq_handle **queues, int *workers);
+extern void ReceiveFromParallelQueues(shm_mq_handle **queues, int *nqueues,
+						  bool nowait, parallel_message_callback callback,
+						  void *arg, uint32 wait_event_info);
+extern shm_mq_handle *AttachParallelLeaderQueue(dsm_segment *seg,
+						  char *queuespace, Size queue_size,
+						  bool leader_sends);
+
 extern void HandleParallelMessageInterrupt(void);
 extern void HandleParallelMessages(void);
 extern void AtEOXact_Parallel(bool isCommit);
@@ -19,8 +19,28 @@
 #include "access/htup_details.h"
 #include "access/itup.h"
 #include "access/tupdesc.h"
+#include "storage/spin.h"
 
 
+/*
+ * Shared state for a parallel heap scan.  This lives in dynamic shared
+ * memory; each participating backend attaches a HeapScanDesc to it with
+ * heap_beginscan_parallel, and blocks are then handed out one at a time to
+ * whichever participant asks next.
+ */
+typedef struct ParallelHeapScanDescData
+{
+	Oid			phs_relid;		/* OID of relation to scan */
+	bool		phs_syncscan;	/* report location to syncscan logic? */
+	BlockNumber phs_nblocks;	/* # blocks in relation at start of scan */
+	slock_t		phs_mutex;		/* mutual exclusion for block number fields */
+	BlockNumber phs_startblock; /* starting block number */
+	BlockNumber phs_cblock;		/* next block to hand out, or
+								 * InvalidBlockNumber when done */
+	bool		phs_snapshot_any;	/* SnapshotAny, not phs_snapshot_data? */
+	char		phs_snapshot_data[FLEXIBLE_ARRAY_MEMBER];
+}	ParallelHeapScanDescData;
+
 typedef struct HeapScanDescData
 {
 	/* scan parameters */
@@ -42,6 +62,13 @@ typedef struct HeapScanDescData
 	/* rs_numblocks is usually InvalidBlockNumber, meaning "scan whole rel" */
 	BufferAccessStrategy rs_strategy;	/* access strategy for reads */
 	bool		rs_syncscan;	/* report location to syncscan logic? */
+	ParallelHeapScanDesc rs_parallel;	/* parallel scan information, or
+										 * NULL */
+	struct ReadStream *rs_stream;	/* stream of pages to scan, or NULL */
+	BlockNumber rs_stream_next; /* next page for the stream to return */
+	BlockNumber rs_stream_expected; /* next page the stream will hand out */
+	BlockNumber rs_stream_end;	/* page the stream stops before */
+	Buffer		rs_stream_buf;	/* its buffer, if already handed out */
 
 	/* scan current state */
 	bool		rs_inited;		/* false = scan not init'd yet */
@@ -56,6 +83,29 @@ typedef struct HeapScanDescData
 	OffsetNumber rs_vistuples[MaxHeapTuplesPerPage];	/* their offsets */
 }	HeapScanDescData;
 
+/*
+ * Lookahead state for an amgettuple scan that prefetches heap pages (see
+ * index_setprefetch).  TIDs are read from the index up to "distance" entries
+ * ahead of the one being returned, and a prefetch is issued for the heap
+ * block of each one as it enters the queue.
+ */
+typedef struct IndexPrefetchEntry
+{
+	ItemPointerData tid;		/* heap TID returned by the AM */
+	bool		recheck;		/* xs_recheck as the AM set it */
+}	IndexPrefetchEntry;
+
+typedef struct IndexPrefetchData
+{
+	int			maxdistance;	/* lookahead limit; queue holds one more */
+	int			distance;		/* current lookahead, ramps up to max */
+	int			head;			/* queue slot of the oldest entry */
+	int			count;			/* number of queued entries */
+	bool		exhausted;		/* AM has returned its last TID */
+	BlockNumber last_block;		/* heap block prefetched most recently */
+	IndexPrefetchEntry queue[FLEXIBLE_ARRAY_MEMBER];
+}	IndexPrefetchData;
+
 /*
  * We use the same IndexScanDescData structure for both amgettuple-based
  * and amgetbitmap-based index scans.  Some fields are only relevant in
@@ -105,6 +155,9 @@ typedef struct IndexScanDescData
 
 	/* state data for traversing HOT chains in index_getnext */
 	bool		xs_continue_hot;	/* T if must keep walking HOT chain */
+
+	/* heap prefetching lookahead, or NULL if not prefetching */
+	IndexPrefetchData *xs_prefetch;
 }	IndexScanDescData;
 
 /* Struct for heap-or-index scans of system tables */
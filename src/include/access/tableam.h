@@ -0,0 +1,217 @@
+/*-------------------------------------------------------------------------
+ *
+ * tableam.h
+ *	  API for table access methods
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * src/include/access/tableam.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef TABLEAM_H
+#define TABLEAM_H
+
+#include "access/heapam.h"
+#include "access/relscan.h"
+#include "foreign/fdwapi.h"
+#include "utils/rel.h"
+
+struct VacuumParams;
+
+
+/*
+ * Callback function signatures --- see tableam.sgml for more info.
+ *
+ * Tuples are passed to and from a table access method as HeapTuples, with a
+ * complete HeapTupleHeader: the executor consults xmin, xmax and t_ctid of
+ * the tuples it fetches and locks, for EvalPlanQual rechecks.  The other
+ * signatures likewise follow the equivalent heapam.c functions.
+ */
+
+typedef HeapScanDesc (*TableScanBegin_function) (Relation rel,
+														 Snapshot snapshot,
+															 int nkeys,
+															 ScanKey key);
+
+typedef HeapTuple (*TableScanGetNext_function) (HeapScanDesc scan,
+												   ScanDirection direction);
+
+typedef void (*TableScanRescan_function) (HeapScanDesc scan,
+													  ScanKey key);
+
+typedef void (*TableScanEnd_function) (HeapScanDesc scan);
+
+typedef void (*TableScanSetColumns_function) (HeapScanDesc scan,
+														  Bitmapset *attrs);
+
+typedef int (*TableScanGetBatch_function) (HeapScanDesc scan,
+													   int ncols,
+													   AttrNumber *attnums,
+													   Datum **values,
+													   bool **isnull,
+													   int maxrows);
+
+typedef bool (*TableTupleFetch_function) (Relation rel,
+													  Snapshot snapshot,
+													  HeapTuple tuple,
+													  Buffer *userbuf,
+													  bool keep_buf,
+												   Relation stats_relation);
+
+typedef void (*TableTupleGetLatestTid_function) (Relation rel,
+														   Snapshot snapshot,
+															ItemPointer tid);
+
+typedef Oid (*TableTupleInsert_function) (Relation rel,
+													  HeapTuple tup,
+													  CommandId cid,
+													  int options,
+												   BulkInsertState bistate);
+
+typedef void (*TableMultiInsert_function) (Relation rel,
+													   HeapTuple *tuples,
+													   int ntuples,
+													   CommandId cid,
+													   int options,
+												   BulkInsertState bistate);
+
+typedef HTSU_Result (*TableTupleDelete_function) (Relation rel,
+														   ItemPointer tid,
+															CommandId cid,
+													  Snapshot crosscheck,
+																bool wait,
+											   HeapUpdateFailureData *hufd);
+
+typedef HTSU_Result (*TableTupleUpdate_function) (Relation rel,
+														  ItemPointer otid,
+														   HeapTuple newtup,
+															CommandId cid,
+													  Snapshot crosscheck,
+																bool wait,
+												HeapUpdateFailureData *hufd,
+												   LockTupleMode *lockmode);
+
+typedef HTSU_Result (*TableTupleLock_function) (Relation rel,
+														 HeapTuple tuple,
+														   CommandId cid,
+														LockTupleMode mode,
+											   LockWaitPolicy wait_policy,
+														bool follow_update,
+														   Buffer *buffer,
+											   HeapUpdateFailureData *hufd);
+
+typedef void (*TableFinishBulkInsert_function) (Relation rel,
+															 int options);
+
+typedef void (*TableRelationSync_function) (Relation rel);
+
+typedef void (*TableRelationVacuum_function) (Relation rel,
+														  int options,
+											   struct VacuumParams *params,
+											  BufferAccessStrategy bstrategy);
+
+typedef bool (*TableRelationAnalyze_function) (Relation rel,
+											   AcquireSampleRowsFunc *func,
+												  BlockNumber *totalpages);
+
+typedef void (*TableRelationEstimateSize_function) (Relation rel,
+														int32 *attr_widths,
+														 BlockNumber *pages,
+															  double *tuples,
+														 double *allvisfrac);
+
+/*
+ * TableAmRoutine is the struct returned by a table access method's handler
+ * function.  It provides pointers to the callback functions the executor,
+ * COPY, VACUUM and ANALYZE use to read and modify the table's contents.
+ * The built-in heap is the access method of every table created without a
+ * USING clause; see heapam_handler.c.
+ *
+ * A scan descriptor is handed back to the access method unchanged, so it
+ * may allocate a larger struct beginning with HeapScanDescData.  Executor
+ * code only looks at rs_rd and rs_cbuf; the latter must hold a pin on the
+ * buffer containing the last tuple returned, or be InvalidBuffer if the
+ * tuple is not in a shared buffer.  Either way the tuple must remain valid
+ * until the next call on the scan.
+ *
+ * More function pointers are likely to be added in the future.
+ * Therefore it's recommended that the handler initialize the struct with
+ * makeNode(TableAmRoutine) so that all fields are set to NULL.  This will
+ * ensure that no fields are accidentally left undefined.
+ */
+typedef struct TableAmRoutine
+{
+	NodeTag		type;
+
+	/* Functions for sequential scans */
+	TableScanBegin_function scan_begin;
+	TableScanGetNext_function scan_getnext;
+	TableScanRescan_function scan_rescan;
+	TableScanEnd_function scan_end;
+	TableScanSetColumns_function scan_set_columns;	/* can be NULL */
+	TableScanGetBatch_function scan_getbatch;	/* can be NULL */
+
+	/* Functions for fetching, modifying and locking individual tuples */
+	TableTupleFetch_function tuple_fetch;
+	TableTupleGetLatestTid_function tuple_get_latest_tid;	/* can be NULL */
+	TableTupleInsert_function tuple_insert;
+	TableMultiInsert_function multi_insert;		/* can be NULL */
+	TableTupleDelete_function tuple_delete;
+	TableTupleUpdate_function tuple_update;
+	TableTupleLock_function tuple_lock;
+	TableFinishBulkInsert_function finish_bulk_insert;	/* can be NULL */
+
+	/* Functions for maintenance and planning */
+	TableRelationSync_function relation_sync;	/* can be NULL */
+	TableRelationVacuum_function relation_vacuum;
+	TableRelationAnalyze_function relation_analyze;		/* can be NULL */
+	TableRelationEstimateSize_function relation_estimate_size;	/* can be NULL */
+} TableAmRoutine;
+
+
+/* Functions in access/table/tableam.c */
+extern TableAmRoutine *GetTableAmRoutine(Oid amhandler);
+extern TableAmRoutine *GetTableAmRoutineForRelation(Relation relation,
+							 bool makecopy);
+
+extern HeapScanDesc table_beginscan(Relation rel, Snapshot snapshot,
+				int nkeys, ScanKey key);
+extern HeapTuple table_getnext(HeapScanDesc scan, ScanDirection direction);
+extern void table_rescan(HeapScanDesc scan, ScanKey key);
+extern void table_endscan(HeapScanDesc scan);
+extern void table_scan_set_columns(HeapScanDesc scan, Bitmapset *attrs);
+extern bool table_scan_has_getbatch(HeapScanDesc scan);
+extern int table_scan_getbatch(HeapScanDesc scan, int ncols,
+					AttrNumber *attnums, Datum **values, bool **isnull,
+					int maxrows);
+
+extern bool table_fetch(Relation rel, Snapshot snapshot, HeapTuple tuple,
+			Buffer *userbuf, bool keep_buf, Relation stats_relation);
+extern void table_get_latest_tid(Relation rel, Snapshot snapshot,
+					 ItemPointer tid);
+extern Oid table_insert(Relation rel, HeapTuple tup, CommandId cid,
+			 int options, BulkInsertState bistate);
+extern void table_multi_insert(Relation rel, HeapTuple *tuples, int ntuples,
+				   CommandId cid, int options, BulkInsertState bistate);
+extern HTSU_Result table_delete(Relation rel, ItemPointer tid, CommandId cid,
+			 Snapshot crosscheck, bool wait, HeapUpdateFailureData *hufd);
+extern HTSU_Result table_update(Relation rel, ItemPointer otid,
+			 HeapTuple newtup, CommandId cid, Snapshot crosscheck, bool wait,
+			 HeapUpdateFailureData *hufd, LockTupleMode *lockmode);
+extern HTSU_Result table_lock_tuple(Relation rel, HeapTuple tuple,
+				 CommandId cid, LockTupleMode mode, LockWaitPolicy wait_policy,
+				 bool follow_update, Buffer *buffer,
+				 HeapUpdateFailureData *hufd);
+extern void table_finish_bulk_insert(Relation rel, int options);
+
+extern void table_sync(Relation rel);
+extern void table_vacuum(Relation rel, int options,
+			 struct VacuumParams *params, BufferAccessStrategy bstrategy);
+extern bool table_analyze(Relation rel, AcquireSampleRowsFunc *func,
+			  BlockNumber *totalpages);
+
+/* Functions in access/heap/heapam_handler.c */
+extern TableAmRoutine *GetHeapamTableAmRoutine(void);
+
+#endif   /* TABLEAM_H */
@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * tidstore.h
+ *	  compact store of heap TIDs, such as the dead tuples found by vacuum
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/tidstore.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef TIDSTORE_H
+#define TIDSTORE_H
+
+#include "storage/block.h"
+#include "storage/itemptr.h"
+#include "storage/off.h"
+
+typedef struct TidStore TidStore;
+
+/* A store can't be larger than this */
+#define TIDSTORE_MAX_SIZE	((Size) PG_UINT32_MAX)
+
+extern Size TidStoreSizeForBlocks(BlockNumber nblocks);
+extern TidStore *TidStoreCreate(void *space, Size size);
+extern void TidStoreReset(TidStore *store);
+extern bool TidStoreIsFull(TidStore *store);
+extern void TidStoreAddBlock(TidStore *store, BlockNumber blkno,
+				 OffsetNumber *offsets, int noffsets);
+extern bool TidStoreIsMember(TidStore *store, ItemPointer tid);
+extern int64 TidStoreNumTids(TidStore *store);
+extern int	TidStoreNumBlocks(TidStore *store);
+extern BlockNumber TidStoreGetBlock(TidStore *store, int blockno,
+				 OffsetNumber *offsets, int *noffsets);
+
+#endif   /* TIDSTORE_H */
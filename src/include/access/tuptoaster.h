@@ -23,6 +23,34 @@
  */
 #define TOAST_INDEX_HACK
 
+/*
+ * Compression methods, as stored in the two high-order bits of the size
+ * word of a compressed datum.  pglz must stay 0, so that values compressed
+ * before the method was recorded remain readable.  There is room for one
+ * more method besides.
+ */
+typedef enum ToastCompressionId
+{
+	TOAST_PGLZ_COMPRESSION_ID = 0,
+	TOAST_LZ4_COMPRESSION_ID = 1,
+	TOAST_INVALID_COMPRESSION_ID = 2
+} ToastCompressionId;
+
+/*
+ * Compression methods, as stored in pg_attribute.attcompression and in
+ * default_toast_compression.  InvalidCompressionMethod in attcompression
+ * means to use default_toast_compression.
+ */
+#define TOAST_PGLZ_COMPRESSION			'p'
+#define TOAST_LZ4_COMPRESSION			'l'
+#define InvalidCompressionMethod		'\0'
+
+#define CompressionMethodIsValid(cm)  ((cm) != InvalidCompressionMethod)
+
+/* GUC variables */
+extern int	default_toast_compression;
+extern int	detoast_cache_size;
+
 
 /*
  * Find the maximum size of a tuple if there are to be N tuples per page.
@@ -101,6 +129,24 @@
 /* Size of an EXTERNAL datum that contains an indirection pointer */
 #define INDIRECT_POINTER_SIZE (VARHDRSZ_EXTERNAL + sizeof(varatt_indirect))
 
+/*
+ * The external size of a toast pointer shares va_extinfo with the
+ * compression method, like the size word of a compressed in-line datum.
+ */
+#define VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer) \
+	((toast_pointer).va_extinfo & VARLENA_EXTSIZE_MASK)
+
+#define VARATT_EXTERNAL_GET_COMPRESS_METHOD(toast_pointer) \
+	((toast_pointer).va_extinfo >> VARLENA_EXTSIZE_BITS)
+
+#define VARATT_EXTERNAL_SET_SIZE_AND_COMPRESS_METHOD(toast_pointer, len, cm) \
+	do { \
+		Assert((cm) == TOAST_PGLZ_COMPRESSION_ID || \
+			   (cm) == TOAST_LZ4_COMPRESSION_ID); \
+		((toast_pointer).va_extinfo = \
+			(len) | ((uint32) (cm) << VARLENA_EXTSIZE_BITS)); \
+	} while (0)
+
 /*
  * Testing whether an externally-stored value is compressed now requires
  * comparing extsize (the actual length of the external data) to rawsize
@@ -109,7 +155,8 @@
  * saves space, so we expect either equality or less-than.
  */
 #define VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer) \
-	((toast_pointer).va_extsize < (toast_pointer).va_rawsize - VARHDRSZ)
+	(VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer) < \
+	 (uint32) (toast_pointer).va_rawsize - VARHDRSZ)
 
 /*
  * Macro to fetch the possibly-unaligned contents of an EXTERNAL datum
@@ -163,6 +210,15 @@ extern struct varlena *heap_tuple_fetch_attr(struct varlena * attr);
  */
 extern struct varlena *heap_tuple_untoast_attr(struct varlena * attr);
 
+/* ----------
+ * AtEOXact_DetoastCache() -
+ *
+ *		Discards the cache of detoasted values kept by
+ *		heap_tuple_untoast_attr().
+ * ----------
+ */
+extern void AtEOXact_DetoastCache(void);
+
 /* ----------
  * heap_tuple_untoast_attr_slice() -
  *
@@ -196,10 +252,31 @@ extern Datum toast_flatten_tuple_to_datum(HeapTupleHeader tup,
 /* ----------
  * toast_compress_datum -
  *
- *	Create a compressed version of a varlena datum, if possible
+ *	Create a compressed version of a varlena datum, if possible, with the
+ *	given compression method, or default_toast_compression if it's invalid
+ * ----------
+ */
+extern Datum toast_compress_datum(Datum value, char cmethod);
+
+/* ----------
+ * toast_get_compression_id -
+ *
+ *	Return the compression method of a compressed varlena datum, or
+ *	TOAST_INVALID_COMPRESSION_ID if it isn't compressed
+ * ----------
+ */
+extern ToastCompressionId toast_get_compression_id(struct varlena * attr);
+
+/* ----------
+ * CompressionNameToMethod, GetCompressionMethodName -
+ *
+ *	Convert between compression method names and attcompression values.
+ *	CompressionNameToMethod returns InvalidCompressionMethod for an unknown
+ *	name, and errors out for a method that this server was built without.
  * ----------
  */
-extern Datum toast_compress_datum(Datum value);
+extern char CompressionNameToMethod(const char *compression);
+extern const char *GetCompressionMethodName(char method);
 
 /* ----------
  * toast_raw_datum_size -
@@ -31,5 +31,8 @@ extern Datum pg_is_xlog_replay_paused(PG_FUNCTION_ARGS);
 extern Datum pg_xlog_location_diff(PG_FUNCTION_ARGS);
 extern Datum pg_is_in_backup(PG_FUNCTION_ARGS);
 extern Datum pg_backup_start_time(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_wal_insert_locks(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_wal_flush_groups(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_wal_segment_creations(PG_FUNCTION_ARGS);
 
 #endif   /* XLOG_FN_H */
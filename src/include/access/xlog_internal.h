@@ -31,7 +31,7 @@
 /*
  * Each page of XLOG file has a header like this:
  */
-#define XLOG_PAGE_MAGIC 0xD087	/* can be used as WAL version indicator */
+#define XLOG_PAGE_MAGIC 0xD08E	/* can be used as WAL version indicator */
 
 typedef struct XLogPageHeaderData
 {
@@ -266,6 +266,10 @@ typedef enum
  * "VACUUM". rm_desc can then be called to obtain additional detail for the
  * record, if available (e.g. the last block).
  *
+ * rm_parallel_safe, if not NULL, tells whether a record that references a
+ * single block can be replayed by a parallel redo worker, concurrently with
+ * records for other blocks (see xlogparallel.c).
+ *
  * RmgrTable[] is indexed by RmgrId values (see rmgrlist.h).
  */
 typedef struct RmgrData
@@ -276,10 +280,13 @@ typedef struct RmgrData
 	const char *(*rm_identify) (uint8 info);
 	void		(*rm_startup) (void);
 	void		(*rm_cleanup) (void);
+	bool		(*rm_parallel_safe) (XLogReaderState *record);
 } RmgrData;
 
 extern const RmgrData RmgrTable[];
 
+extern void rm_redo_error_callback(void *arg);
+
 /*
  * Exported to support xlog switching from checkpointer
  */
@@ -0,0 +1,33 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.h
+ *		Declarations for parallel WAL redo.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/xlogparallel.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGPARALLEL_H
+#define XLOGPARALLEL_H
+
+#include "access/xlogreader.h"
+
+/* GUCs */
+extern int	recovery_parallel_workers;
+
+/* true in a parallel redo worker */
+extern bool am_parallel_redo_worker;
+
+extern Size ParallelRedoShmemSize(void);
+extern void ParallelRedoShmemInit(void);
+
+extern bool ParallelRedoDispatch(XLogReaderState *record);
+extern void ParallelRedoWaitForWorkers(void);
+extern void ParallelRedoShutdown(void);
+
+extern void ParallelRedoWorkerMain(Datum main_arg);
+
+#endif   /* XLOGPARALLEL_H */
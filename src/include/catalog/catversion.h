@@ -53,6 +53,6 @@
  */
 
 /*							yyyymmddN */
-#define CATALOG_VERSION_NO	201510051
+#define CATALOG_VERSION_NO	201610180
 
 #endif
@@ -49,6 +49,7 @@ extern Relation heap_create(const char *relname,
 			char relpersistence,
 			bool shared_relation,
 			bool mapped_relation,
+			bool compressed,
 			bool allow_system_table_mods);
 
 extern Oid heap_create_with_catalog(const char *relname,
@@ -58,6 +59,7 @@ extern Oid heap_create_with_catalog(const char *relname,
 						 Oid reltypeid,
 						 Oid reloftypeid,
 						 Oid ownerid,
+						 Oid relam,
 						 TupleDesc tupdesc,
 						 List *cooked_constraints,
 						 char relkind,
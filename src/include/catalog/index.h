@@ -109,9 +109,12 @@ extern double IndexBuildHeapRangeScan(Relation heapRelation,
 						BlockNumber start_blockno,
 						BlockNumber end_blockno,
 						IndexBuildCallback callback,
-						void *callback_state);
+						void *callback_state,
+						HeapScanDesc scan);
 
 extern void validate_index(Oid heapId, Oid indexId, Snapshot snapshot);
+extern void validate_index_worker_main(struct dsm_segment *seg,
+						   struct shm_toc *toc);
 
 extern void index_set_state_flags(Oid indexId, IndexStateFlagsAction action);
 
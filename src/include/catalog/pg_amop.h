@@ -767,6 +767,7 @@ DATA(insert (	4015   600 600 5 s	508 4000 0 ));
 DATA(insert (	4015   600 600 10 s 509 4000 0 ));
 DATA(insert (	4015   600 600 6 s	510 4000 0 ));
 DATA(insert (	4015   600 603 8 s	511 4000 0 ));
+DATA(insert (	4015   600 600 15 o 517 4000 1970 ));
 
 /*
  * SP-GiST kd_point_ops
@@ -777,6 +778,7 @@ DATA(insert (	4016   600 600 5 s	508 4000 0 ));
 DATA(insert (	4016   600 600 10 s 509 4000 0 ));
 DATA(insert (	4016   600 600 6 s	510 4000 0 ));
 DATA(insert (	4016   600 603 8 s	511 4000 0 ));
+DATA(insert (	4016   600 600 15 o 517 4000 1970 ));
 
 /*
  * SP-GiST text_ops
@@ -1094,6 +1096,56 @@ DATA(insert (	4103   3831 3831 20 s	  3884	  3580 0 ));
 DATA(insert (	4103   3831 3831 21 s	  3885	  3580 0 ));
 DATA(insert (	4103   3831 3831 22 s	  3887	  3580 0 ));
 DATA(insert (	4103   3831 3831 23 s	  3886	  3580 0 ));
+/* bloom int4 */
+DATA(insert (	4123     23   23 1 s	    96	  3580 0 ));
+/* bloom int8 */
+DATA(insert (	4124     20   20 1 s	   410	  3580 0 ));
+/* bloom text */
+DATA(insert (	4125     25   25 1 s	    98	  3580 0 ));
+/* bloom date */
+DATA(insert (	4126   1082 1082 1 s	  1093	  3580 0 ));
+/* bloom timestamp */
+DATA(insert (	4127   1114 1114 1 s	  2060	  3580 0 ));
+/* bloom timestamptz */
+DATA(insert (	4128   1184 1184 1 s	  1320	  3580 0 ));
+/* bloom uuid */
+DATA(insert (	4129   2950 2950 1 s	  2972	  3580 0 ));
+/* multi-minmax int4 */
+DATA(insert (	4130     23   23 1 s	    97	  3580 0 ));
+DATA(insert (	4130     23   23 2 s	   523	  3580 0 ));
+DATA(insert (	4130     23   23 3 s	    96	  3580 0 ));
+DATA(insert (	4130     23   23 4 s	   525	  3580 0 ));
+DATA(insert (	4130     23   23 5 s	   521	  3580 0 ));
+/* multi-minmax int8 */
+DATA(insert (	4131     20   20 1 s	   412	  3580 0 ));
+DATA(insert (	4131     20   20 2 s	   414	  3580 0 ));
+DATA(insert (	4131     20   20 3 s	   410	  3580 0 ));
+DATA(insert (	4131     20   20 4 s	   415	  3580 0 ));
+DATA(insert (	4131     20   20 5 s	   413	  3580 0 ));
+/* multi-minmax float8 */
+DATA(insert (	4132    701  701 1 s	   672	  3580 0 ));
+DATA(insert (	4132    701  701 2 s	   673	  3580 0 ));
+DATA(insert (	4132    701  701 3 s	   670	  3580 0 ));
+DATA(insert (	4132    701  701 4 s	   675	  3580 0 ));
+DATA(insert (	4132    701  701 5 s	   674	  3580 0 ));
+/* multi-minmax date */
+DATA(insert (	4133   1082 1082 1 s	  1095	  3580 0 ));
+DATA(insert (	4133   1082 1082 2 s	  1096	  3580 0 ));
+DATA(insert (	4133   1082 1082 3 s	  1093	  3580 0 ));
+DATA(insert (	4133   1082 1082 4 s	  1098	  3580 0 ));
+DATA(insert (	4133   1082 1082 5 s	  1097	  3580 0 ));
+/* multi-minmax timestamp */
+DATA(insert (	4134   1114 1114 1 s	  2062	  3580 0 ));
+DATA(insert (	4134   1114 1114 2 s	  2063	  3580 0 ));
+DATA(insert (	4134   1114 1114 3 s	  2060	  3580 0 ));
+DATA(insert (	4134   1114 1114 4 s	  2065	  3580 0 ));
+DATA(insert (	4134   1114 1114 5 s	  2064	  3580 0 ));
+/* multi-minmax timestamptz */
+DATA(insert (	4135   1184 1184 1 s	  1322	  3580 0 ));
+DATA(insert (	4135   1184 1184 2 s	  1323	  3580 0 ));
+DATA(insert (	4135   1184 1184 3 s	  1320	  3580 0 ));
+DATA(insert (	4135   1184 1184 4 s	  1325	  3580 0 ));
+DATA(insert (	4135   1184 1184 5 s	  1324	  3580 0 ));
 /* minmax pg_lsn */
 DATA(insert (	4082   3220 3220 1 s	  3224	  3580 0 ));
 DATA(insert (	4082   3220 3220 2 s	  3226	  3580 0 ));
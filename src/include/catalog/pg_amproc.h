@@ -80,7 +80,9 @@ DATA(insert (	421   702 702 1 357 ));
 DATA(insert (	423   1560 1560 1 1596 ));
 DATA(insert (	424   16 16 1 1693 ));
 DATA(insert (	426   1042 1042 1 1078 ));
+DATA(insert (	426   1042 1042 2 3319 ));
 DATA(insert (	428   17 17 1 1954 ));
+DATA(insert (	428   17 17 2 3320 ));
 DATA(insert (	429   18 18 1 358 ));
 DATA(insert (	434   1082 1082 1 1092 ));
 DATA(insert (	434   1082 1082 2 3136 ));
@@ -101,6 +103,7 @@ DATA(insert (	1970   701 701 1 355 ));
 DATA(insert (	1970   701 701 2 3133 ));
 DATA(insert (	1970   701 700 1 2195 ));
 DATA(insert (	1974   869 869 1 926 ));
+DATA(insert (	1974   869 869 2 3318 ));
 DATA(insert (	1976   21 21 1 350 ));
 DATA(insert (	1976   21 21 2 3129 ));
 DATA(insert (	1976   21 23 1 2190 ));
@@ -115,6 +118,7 @@ DATA(insert (	1976   20 23 1 2189 ));
 DATA(insert (	1976   20 21 1 2193 ));
 DATA(insert (	1982   1186 1186 1 1315 ));
 DATA(insert (	1984   829 829 1 836 ));
+DATA(insert (	1984   829 829 2 3321 ));
 DATA(insert (	1986   19 19 1 359 ));
 DATA(insert (	1986   19 19 2 3135 ));
 DATA(insert (	1988   1700 1700 1 1769 ));
@@ -134,6 +138,7 @@ DATA(insert (	2233   703 703 1  380 ));
 DATA(insert (	2234   704 704 1  381 ));
 DATA(insert (	2789   27 27 1 2794 ));
 DATA(insert (	2968   2950 2950 1 2960 ));
+DATA(insert (	2968   2950 2950 2 3317 ));
 DATA(insert (	2994   2249 2249 1 2987 ));
 DATA(insert (	3194   2249 2249 1 3187 ));
 DATA(insert (	3253   3220 3220 1 3251 ));
@@ -193,6 +198,7 @@ DATA(insert (	1029   600 600 6 2582 ));
 DATA(insert (	1029   600 600 7 2584 ));
 DATA(insert (	1029   600 600 8 3064 ));
 DATA(insert (	1029   600 600 9 3282 ));
+DATA(insert (	1029   600 600 10 4137 ));
 DATA(insert (	2593   603 603 1 2578 ));
 DATA(insert (	2593   603 603 2 2583 ));
 DATA(insert (	2593   603 603 3 2579 ));
@@ -239,6 +245,7 @@ DATA(insert (	3919   3831 3831 5 3879 ));
 DATA(insert (	3919   3831 3831 6 3880 ));
 DATA(insert (	3919   3831 3831 7 3881 ));
 DATA(insert (	3919   3831 3831 9 3996 ));
+DATA(insert (	3919   3831 3831 10 4138 ));
 DATA(insert (	3550   869 869 1 3553 ));
 DATA(insert (	3550   869 869 2 3554 ));
 DATA(insert (	3550   869 869 3 3555 ));
@@ -647,6 +654,84 @@ DATA(insert (	4103  3831	3831  4  4108 ));
 DATA(insert (	4103  3831	3831  11 4057 ));
 DATA(insert (	4103  3831	3831  13 3859 ));
 DATA(insert (	4103  3831	3831  14 3850 ));
+/* bloom int4 */
+DATA(insert (	4123    23	  23  1  4110 ));
+DATA(insert (	4123    23	  23  2  4111 ));
+DATA(insert (	4123    23	  23  3  4112 ));
+DATA(insert (	4123    23	  23  4  4113 ));
+DATA(insert (	4123    23	  23  15  450 ));
+/* bloom int8 */
+DATA(insert (	4124    20	  20  1  4110 ));
+DATA(insert (	4124    20	  20  2  4111 ));
+DATA(insert (	4124    20	  20  3  4112 ));
+DATA(insert (	4124    20	  20  4  4113 ));
+DATA(insert (	4124    20	  20  15  949 ));
+/* bloom text */
+DATA(insert (	4125    25	  25  1  4110 ));
+DATA(insert (	4125    25	  25  2  4111 ));
+DATA(insert (	4125    25	  25  3  4112 ));
+DATA(insert (	4125    25	  25  4  4113 ));
+DATA(insert (	4125    25	  25  15  400 ));
+/* bloom date */
+DATA(insert (	4126  1082	1082  1  4110 ));
+DATA(insert (	4126  1082	1082  2  4111 ));
+DATA(insert (	4126  1082	1082  3  4112 ));
+DATA(insert (	4126  1082	1082  4  4113 ));
+DATA(insert (	4126  1082	1082  15  450 ));
+/* bloom timestamp */
+DATA(insert (	4127  1114	1114  1  4110 ));
+DATA(insert (	4127  1114	1114  2  4111 ));
+DATA(insert (	4127  1114	1114  3  4112 ));
+DATA(insert (	4127  1114	1114  4  4113 ));
+DATA(insert (	4127  1114	1114  15  2039 ));
+/* bloom timestamptz */
+DATA(insert (	4128  1184	1184  1  4110 ));
+DATA(insert (	4128  1184	1184  2  4111 ));
+DATA(insert (	4128  1184	1184  3  4112 ));
+DATA(insert (	4128  1184	1184  4  4113 ));
+DATA(insert (	4128  1184	1184  15  2039 ));
+/* bloom uuid */
+DATA(insert (	4129  2950	2950  1  4110 ));
+DATA(insert (	4129  2950	2950  2  4111 ));
+DATA(insert (	4129  2950	2950  3  4112 ));
+DATA(insert (	4129  2950	2950  4  4113 ));
+DATA(insert (	4129  2950	2950  15  2963 ));
+/* multi-minmax int4 */
+DATA(insert (	4130    23	  23  1  4114 ));
+DATA(insert (	4130    23	  23  2  4115 ));
+DATA(insert (	4130    23	  23  3  4116 ));
+DATA(insert (	4130    23	  23  4  4117 ));
+DATA(insert (	4130    23	  23  11  4118 ));
+/* multi-minmax int8 */
+DATA(insert (	4131    20	  20  1  4114 ));
+DATA(insert (	4131    20	  20  2  4115 ));
+DATA(insert (	4131    20	  20  3  4116 ));
+DATA(insert (	4131    20	  20  4  4117 ));
+DATA(insert (	4131    20	  20  11  4119 ));
+/* multi-minmax float8 */
+DATA(insert (	4132   701	 701  1  4114 ));
+DATA(insert (	4132   701	 701  2  4115 ));
+DATA(insert (	4132   701	 701  3  4116 ));
+DATA(insert (	4132   701	 701  4  4117 ));
+DATA(insert (	4132   701	 701  11  4120 ));
+/* multi-minmax date */
+DATA(insert (	4133  1082	1082  1  4114 ));
+DATA(insert (	4133  1082	1082  2  4115 ));
+DATA(insert (	4133  1082	1082  3  4116 ));
+DATA(insert (	4133  1082	1082  4  4117 ));
+DATA(insert (	4133  1082	1082  11  4121 ));
+/* multi-minmax timestamp */
+DATA(insert (	4134  1114	1114  1  4114 ));
+DATA(insert (	4134  1114	1114  2  4115 ));
+DATA(insert (	4134  1114	1114  3  4116 ));
+DATA(insert (	4134  1114	1114  4  4117 ));
+DATA(insert (	4134  1114	1114  11  4122 ));
+/* multi-minmax timestamptz */
+DATA(insert (	4135  1184	1184  1  4114 ));
+DATA(insert (	4135  1184	1184  2  4115 ));
+DATA(insert (	4135  1184	1184  3  4116 ));
+DATA(insert (	4135  1184	1184  4  4117 ));
+DATA(insert (	4135  1184	1184  11  4122 ));
 /* minmax pg_lsn */
 DATA(insert (	4082  3220	3220  1  3383 ));
 DATA(insert (	4082  3220	3220  2  3384 ));
@@ -271,5 +271,19 @@ DATA(insert (	3580	pg_lsn_minmax_ops		PGNSP PGUID 4082  3220 t 3220 ));
 /* no brin opclass for enum, tsvector, tsquery, jsonb */
 DATA(insert (	3580	box_inclusion_ops		PGNSP PGUID 4104   603 t 603 ));
 /* no brin opclass for the geometric types except box */
+/* non-default brin opclasses for some of the types above */
+DATA(insert (	3580	int4_bloom_ops			PGNSP PGUID 4123    23 f 23 ));
+DATA(insert (	3580	int8_bloom_ops			PGNSP PGUID 4124    20 f 20 ));
+DATA(insert (	3580	text_bloom_ops			PGNSP PGUID 4125    25 f 25 ));
+DATA(insert (	3580	date_bloom_ops			PGNSP PGUID 4126  1082 f 1082 ));
+DATA(insert (	3580	timestamp_bloom_ops		PGNSP PGUID 4127  1114 f 1114 ));
+DATA(insert (	3580	timestamptz_bloom_ops	PGNSP PGUID 4128  1184 f 1184 ));
+DATA(insert (	3580	uuid_bloom_ops			PGNSP PGUID 4129  2950 f 2950 ));
+DATA(insert (	3580	int4_minmax_multi_ops	PGNSP PGUID 4130    23 f 23 ));
+DATA(insert (	3580	int8_minmax_multi_ops	PGNSP PGUID 4131    20 f 20 ));
+DATA(insert (	3580	float8_minmax_multi_ops	PGNSP PGUID 4132   701 f 701 ));
+DATA(insert (	3580	date_minmax_multi_ops	PGNSP PGUID 4133  1082 f 1082 ));
+DATA(insert (	3580	timestamp_minmax_multi_ops	PGNSP PGUID 4134  1114 f 1114 ));
+DATA(insert (	3580	timestamptz_minmax_multi_ops	PGNSP PGUID 4135  1184 f 1184 ));
 
 #endif   /* PG_OPCLASS_H */
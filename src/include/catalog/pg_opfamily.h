@@ -182,5 +182,18 @@ DATA(insert OID = 4081 (	3580	uuid_minmax_ops			PGNSP PGUID ));
 DATA(insert OID = 4103 (	3580	range_inclusion_ops		PGNSP PGUID ));
 DATA(insert OID = 4082 (	3580	pg_lsn_minmax_ops		PGNSP PGUID ));
 DATA(insert OID = 4104 (	3580	box_inclusion_ops		PGNSP PGUID ));
+DATA(insert OID = 4123 (	3580	int4_bloom_ops			PGNSP PGUID ));
+DATA(insert OID = 4124 (	3580	int8_bloom_ops			PGNSP PGUID ));
+DATA(insert OID = 4125 (	3580	text_bloom_ops			PGNSP PGUID ));
+DATA(insert OID = 4126 (	3580	date_bloom_ops			PGNSP PGUID ));
+DATA(insert OID = 4127 (	3580	timestamp_bloom_ops		PGNSP PGUID ));
+DATA(insert OID = 4128 (	3580	timestamptz_bloom_ops	PGNSP PGUID ));
+DATA(insert OID = 4129 (	3580	uuid_bloom_ops			PGNSP PGUID ));
+DATA(insert OID = 4130 (	3580	int4_minmax_multi_ops	PGNSP PGUID ));
+DATA(insert OID = 4131 (	3580	int8_minmax_multi_ops	PGNSP PGUID ));
+DATA(insert OID = 4132 (	3580	float8_minmax_multi_ops	PGNSP PGUID ));
+DATA(insert OID = 4133 (	3580	date_minmax_multi_ops	PGNSP PGUID ));
+DATA(insert OID = 4134 (	3580	timestamp_minmax_multi_ops	PGNSP PGUID ));
+DATA(insert OID = 4135 (	3580	timestamptz_minmax_multi_ops	PGNSP PGUID ));
 
 #endif   /* PG_OPFAMILY_H */
@@ -0,0 +1,86 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_statistic_ext.h
+ *	  definition of the system "extended statistic" relation
+ *	  (pg_statistic_ext), which holds statistics on groups of columns
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/catalog/pg_statistic_ext.h
+ *
+ * NOTES
+ *	  the genbki.pl script reads this file and generates .bki
+ *	  information from the DATA() statements.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_STATISTIC_EXT_H
+#define PG_STATISTIC_EXT_H
+
+#include "catalog/genbki.h"
+
+/* ----------------
+ *		pg_statistic_ext definition.  cpp turns this into
+ *		typedef struct FormData_pg_statistic_ext
+ * ----------------
+ */
+#define StatisticExtRelationId	3381
+
+CATALOG(pg_statistic_ext,3381)
+{
+	/* These fields form the unique key for the entry: */
+	Oid			stxrelid;		/* relation containing attributes */
+	NameData	stxname;		/* statistics object name */
+	Oid			stxnamespace;	/* OID of statistics object's namespace */
+
+	Oid			stxowner;		/* statistics object's owner */
+
+	/*
+	 * variable-length fields start here, but we allow direct access to
+	 * stxkeys
+	 */
+	int2vector	stxkeys;		/* array of column keys, in ascending order */
+
+#ifdef CATALOG_VARLEN
+	char		stxkind[1] BKI_FORCE_NOT_NULL;	/* statistics kinds requested
+												 * to build */
+	bytea		stxndistinct;	/* ndistinct coefficients (serialized) */
+	bytea		stxdependencies;	/* functional dependencies (serialized) */
+	bytea		stxmcv;			/* multi-column MCV list (serialized) */
+#endif
+
+} FormData_pg_statistic_ext;
+
+/* ----------------
+ *		Form_pg_statistic_ext corresponds to a pointer to a tuple with
+ *		the format of pg_statistic_ext relation.
+ * ----------------
+ */
+typedef FormData_pg_statistic_ext *Form_pg_statistic_ext;
+
+/* ----------------
+ *		compiler constants for pg_statistic_ext
+ * ----------------
+ */
+#define Natts_pg_statistic_ext					9
+#define Anum_pg_statistic_ext_stxrelid			1
+#define Anum_pg_statistic_ext_stxname			2
+#define Anum_pg_statistic_ext_stxnamespace		3
+#define Anum_pg_statistic_ext_stxowner			4
+#define Anum_pg_statistic_ext_stxkeys			5
+#define Anum_pg_statistic_ext_stxkind			6
+#define Anum_pg_statistic_ext_stxndistinct		7
+#define Anum_pg_statistic_ext_stxdependencies	8
+#define Anum_pg_statistic_ext_stxmcv			9
+
+/*
+ * Statistics kinds, as stored in stxkind.  The serialized data of each kind
+ * that has been built by ANALYZE is in the matching bytea column.
+ */
+#define STATS_EXT_NDISTINCT			'd'
+#define STATS_EXT_DEPENDENCIES		'f'
+#define STATS_EXT_MCV				'm'
+
+#endif   /* PG_STATISTIC_EXT_H */
@@ -0,0 +1,105 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_subscription.h
+ *	  definition of the system "subscription" relation (pg_subscription),
+ *	  which holds the logical replication subscriptions of the cluster
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/catalog/pg_subscription.h
+ *
+ * NOTES
+ *	  the genbki.pl script reads this file and generates .bki
+ *	  information from the DATA() statements.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_SUBSCRIPTION_H
+#define PG_SUBSCRIPTION_H
+
+#include "catalog/genbki.h"
+
+/* ----------------
+ *		pg_subscription definition.  cpp turns this into
+ *		typedef struct FormData_pg_subscription
+ *
+ * The catalog is shared, so that the logical replication launcher, which
+ * is not connected to any database, can see the subscriptions of every
+ * database.
+ * ----------------
+ */
+#define SubscriptionRelationId	6100
+
+CATALOG(pg_subscription,6100) BKI_SHARED_RELATION
+{
+	Oid			subdbid;		/* Database the subscription is in. */
+	NameData	subname;		/* Name of the subscription */
+
+	Oid			subowner;		/* Owner of the subscription */
+
+	bool		subenabled;		/* True if the subscription is enabled (the
+								 * worker should be running) */
+
+	bool		substream;		/* Stream in-progress transactions, and apply
+								 * them with parallel apply workers */
+
+	bool		subbinary;		/* Request the binary representation of
+								 * built-in types */
+
+	NameData	subslotname;	/* Slot name on the publisher */
+
+#ifdef CATALOG_VARLEN			/* variable-length fields start here */
+	text		subconninfo BKI_FORCE_NOT_NULL;	/* Connection string to the
+												 * publisher */
+	text		subpublications[1] BKI_FORCE_NOT_NULL;	/* List of
+														 * publications
+														 * subscribed to */
+#endif
+} FormData_pg_subscription;
+
+/* ----------------
+ *		Form_pg_subscription corresponds to a pointer to a tuple with
+ *		the format of pg_subscription relation.
+ * ----------------
+ */
+typedef FormData_pg_subscription *Form_pg_subscription;
+
+/* ----------------
+ *		compiler constants for pg_subscription
+ * ----------------
+ */
+#define Natts_pg_subscription					9
+#define Anum_pg_subscription_subdbid			1
+#define Anum_pg_subscription_subname			2
+#define Anum_pg_subscription_subowner			3
+#define Anum_pg_subscription_subenabled			4
+#define Anum_pg_subscription_substream			5
+#define Anum_pg_subscription_subbinary			6
+#define Anum_pg_subscription_subslotname		7
+#define Anum_pg_subscription_subconninfo		8
+#define Anum_pg_subscription_subpublications	9
+
+typedef struct Subscription
+{
+	Oid			oid;			/* Oid of the subscription */
+	Oid			dbid;			/* Oid of the database which subscription is
+								 * in */
+	char	   *name;			/* Name of the subscription */
+	Oid			owner;			/* Oid of the subscription owner */
+	bool		enabled;		/* Indicates if the subscription is enabled */
+	bool		stream;			/* Stream in-progress transactions */
+	bool		binary;			/* Use the binary format where possible */
+	char	   *conninfo;		/* Connection string to the publisher */
+	char	   *slotname;		/* Name of the replication slot */
+	List	   *publications;	/* List of publication names to subscribe to */
+} Subscription;
+
+extern Subscription *GetSubscription(Oid subid, bool missing_ok);
+extern void FreeSubscription(Subscription *sub);
+extern Oid	get_subscription_oid(const char *subname, bool missing_ok);
+extern char *get_subscription_name(Oid subid);
+extern List *get_subscription_list(void);
+
+#endif   /* PG_SUBSCRIPTION_H */
@@ -34,15 +34,20 @@ typedef struct xl_smgr_create
 {
 	RelFileNode rnode;
 	ForkNumber	forkNum;
+	uint32		flags;
 } xl_smgr_create;
 
+/* flags for xl_smgr_create */
+#define SMGR_CREATE_COMPRESSED		0x0001	/* fork stores pages compressed */
+
 typedef struct xl_smgr_truncate
 {
 	BlockNumber blkno;
 	RelFileNode rnode;
 } xl_smgr_truncate;
 
-extern void log_smgrcreate(RelFileNode *rnode, ForkNumber forkNum);
+extern void log_smgrcreate(RelFileNode *rnode, ForkNumber forkNum,
+			   bool compressed);
 
 extern void smgr_redo(XLogReaderState *record);
 extern void smgr_desc(StringInfo buf, XLogReaderState *record);
@@ -17,6 +17,9 @@
 #include "storage/lock.h"
 #include "utils/relcache.h"
 
+struct dsm_segment;
+struct shm_toc;
+
 
 extern void cluster(ClusterStmt *stmt, bool isTopLevel);
 extern void cluster_rel(Oid tableOid, Oid indexOid, bool recheck,
@@ -35,5 +38,7 @@ extern void finish_heap_swap(Oid OIDOldHeap, Oid OIDNewHeap,
 				 TransactionId frozenXid,
 				 MultiXactId minMulti,
 				 char newrelpersistence);
+extern void cluster_parallel_sort_main(struct dsm_segment *seg,
+						   struct shm_toc *toc);
 
 #endif   /* CLUSTER_H */
@@ -33,6 +33,10 @@ extern bool NextCopyFrom(CopyState cstate, ExprContext *econtext,
 extern bool NextCopyFromRawFields(CopyState cstate,
 					  char ***fields, int *nfields);
 extern void CopyFromErrorCallback(void *arg);
+extern void CopyFromParallelMain(struct dsm_segment *seg,
+					 struct shm_toc *toc);
+extern void CopyToParallelMain(struct dsm_segment *seg,
+				   struct shm_toc *toc);
 
 extern DestReceiver *CreateCopyDestReceiver(void);
 
@@ -30,4 +30,10 @@ extern DestReceiver *CreateTransientRelDestReceiver(Oid oid);
 
 extern bool MatViewIncrementalMaintenanceIsEnabled(void);
 
+extern bool MatViewMaintenanceRequested(List *options);
+extern void LockMatViewBaseTables(Query *query);
+extern void CreateMatViewMaintenanceTriggers(Relation matviewRel);
+extern void DropMatViewMaintenanceTriggers(Relation matviewRel);
+extern void SetMatViewIncrementalMaintenance(Relation matviewRel, bool enable);
+
 #endif   /* MATVIEW_H */
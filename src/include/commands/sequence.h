@@ -19,6 +19,7 @@
 #include "lib/stringinfo.h"
 #include "nodes/parsenodes.h"
 #include "storage/relfilenode.h"
+#include "utils/relcache.h"
 
 
 typedef struct FormData_pg_sequence
@@ -78,6 +79,13 @@ extern ObjectAddress AlterSequence(AlterSeqStmt *stmt);
 extern void ResetSequence(Oid seq_relid);
 extern void ResetSequenceCaches(void);
 
+extern Size SequenceShmemSize(void);
+extern void SequenceShmemInit(void);
+extern void ShutdownSequences(void);
+extern void SequenceSyncShared(Relation seqrel);
+extern void SequenceForgetShared(RelFileNode rnode);
+extern void SequenceForgetSharedDatabase(Oid dbid);
+
 extern void seq_redo(XLogReaderState *rptr);
 extern void seq_desc(StringInfo buf, XLogReaderState *rptr);
 extern const char *seq_identify(uint8 info);
@@ -0,0 +1,48 @@
+/*---------------------------------------------------------------------------
+ *
+ * shortest_dec.h
+ *	  Shortest-exact decimal output of floating-point values
+ *
+ * The routines declared here produce the shortest string of decimal digits
+ * that reads back (via strtod/strtof) as exactly the same value, using the
+ * Ryu algorithm.  The output layout follows printf's %g: fixed-point for
+ * moderate exponents, otherwise d.ddde+XX.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ *
+ * src/include/common/shortest_dec.h
+ *
+ *---------------------------------------------------------------------------
+ */
+#ifndef SHORTEST_DEC_H
+#define SHORTEST_DEC_H
+
+/*----
+ * The length of 25 comes from:
+ *
+ * Case 1: -9.9999999999999999e-299  = 24 bytes, plus 1 for null
+ *
+ * Case 2: -0.00099999999999999999 = 23 bytes, plus 1 for null
+ *
+ * Case 3: -999999999999999.99 = 19 bytes, plus 1 for null
+ */
+#define DOUBLE_SHORTEST_DECIMAL_LEN 25
+
+extern int	double_to_shortest_decimal_bufn(double f, char *result);
+extern int	double_to_shortest_decimal_buf(double f, char *result);
+extern int	double_to_limited_decimal_buf(double f, int maxdigits, char *result);
+
+/*----
+ * The length of 16 comes from:
+ *
+ * Case 1: -1.17549435e-38 = 15 bytes, plus 1 for null
+ *
+ * Case 2: -0.000123456789 = 15 bytes, plus 1 for null
+ */
+#define FLOAT_SHORTEST_DECIMAL_LEN 16
+
+extern int	float_to_shortest_decimal_bufn(float f, char *result);
+extern int	float_to_shortest_decimal_buf(float f, char *result);
+extern int	float_to_limited_decimal_buf(float f, int maxdigits, char *result);
+
+#endif   /* SHORTEST_DEC_H */
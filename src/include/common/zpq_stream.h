@@ -0,0 +1,41 @@
+/*
+ *	zpq_stream.h
+ *		streaming compression of frontend/backend protocol traffic
+ *
+ *	Copyright (c) 2003-2015, PostgreSQL Global Development Group
+ *
+ *	src/include/common/zpq_stream.h
+ */
+#ifndef ZPQ_STREAM_H
+#define ZPQ_STREAM_H
+
+/*
+ * zpq_read and zpq_write return this when the data itself could not be
+ * compressed or decompressed, as opposed to a failure of the transport
+ * (which is passed through as the transport function's result).
+ */
+#define ZPQ_STREAM_ERROR	(-2)
+
+typedef struct ZpqStream ZpqStream;
+
+/* transport functions, with the calling conventions of send() and recv() */
+typedef ssize_t (*zpq_tx_func) (void *arg, const void *data, size_t size);
+typedef ssize_t (*zpq_rx_func) (void *arg, void *data, size_t size);
+
+extern const char *zpq_supported_algorithms(void);
+extern const char *zpq_choose_algorithm(const char *requested);
+extern ZpqStream *zpq_create(const char *algorithm,
+		   zpq_tx_func tx, zpq_rx_func rx, void *arg,
+		   const char *rx_data, size_t rx_len);
+extern ssize_t zpq_read(ZpqStream *zs, void *buf, size_t size);
+extern ssize_t zpq_write(ZpqStream *zs, const void *buf, size_t size);
+extern size_t zpq_buffered_rx(ZpqStream *zs);
+extern size_t zpq_buffered_tx(ZpqStream *zs);
+extern const char *zpq_algorithm(ZpqStream *zs);
+extern const char *zpq_error(ZpqStream *zs);
+extern void zpq_get_counters(ZpqStream *zs,
+				 uint64 *raw_sent, uint64 *sent,
+				 uint64 *raw_received, uint64 *received);
+extern void zpq_free(ZpqStream *zs);
+
+#endif   /* ZPQ_STREAM_H */
@@ -0,0 +1,85 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.h
+ *	  Support for batch-at-a-time (vectorized) execution of simple
+ *	  SeqScan -> Qual -> Agg pipelines.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/executor/execBatch.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECBATCH_H
+#define EXECBATCH_H
+
+#include "nodes/execnodes.h"
+
+/* GUC variable */
+extern bool enable_batch_execution;
+
+/* Maximum number of rows gathered into one TupleBatch */
+#define EXEC_BATCH_SIZE		1024
+
+/*
+ * TupleBatch holds up to EXEC_BATCH_SIZE deformed scan tuples in columnar
+ * form.  Only the columns some consumer asked for are materialized; column
+ * number "col" of the batch holds scan attribute attnums[col].  Values of
+ * pass-by-reference columns are not kept (they would point into buffer
+ * pages that are no longer pinned once the scan moves on), so consumers
+ * may only look at their null flags.
+ *
+ * The selection vector lists, in ascending order, the rows that passed all
+ * the scan quals; only those rows should be fed to the consumer.
+ */
+typedef struct TupleBatch
+{
+	int			ncols;			/* number of materialized columns */
+	AttrNumber *attnums;		/* scan attno of each column */
+	bool	   *byval;			/* is the column's value stored? */
+	int			ntuples;		/* number of rows fetched into the batch */
+	int			nselected;		/* number of entries in selection[] */
+	Datum	  **values;			/* values[col][row] */
+	bool	  **isnull;			/* isnull[col][row] */
+	int		   *selection;		/* rows passing the quals */
+} TupleBatch;
+
+/* opaque; private to execBatch.c */
+typedef struct BatchScanState BatchScanState;
+
+/*
+ * Vectorized transition kernels, identified from the aggregate's transfn.
+ */
+typedef enum BatchAggKind
+{
+	BATCH_AGG_NONE = 0,			/* not supported, use the row path */
+	BATCH_AGG_COUNT_STAR,		/* int8inc */
+	BATCH_AGG_COUNT,			/* int8inc_any */
+	BATCH_AGG_INT4_SUM,			/* int4_sum */
+	BATCH_AGG_FLOAT8_SUM,		/* float8pl */
+	BATCH_AGG_INT4_MAX,			/* int4larger, date_larger */
+	BATCH_AGG_INT4_MIN,			/* int4smaller, date_smaller */
+	BATCH_AGG_INT8_MAX,			/* int8larger */
+	BATCH_AGG_INT8_MIN,			/* int8smaller */
+	BATCH_AGG_FLOAT8_MAX,		/* float8larger */
+	BATCH_AGG_FLOAT8_MIN,		/* float8smaller */
+	BATCH_AGG_INT4_AVG,			/* int4_avg_accum */
+	BATCH_AGG_FLOAT8_AVG		/* float8_accum */
+} BatchAggKind;
+
+extern BatchScanState *ExecInitBatchScan(ScanState *node,
+				  Bitmapset *attnums);
+extern void ExecEndBatchScan(BatchScanState *bstate);
+extern void ExecReScanBatchScan(BatchScanState *bstate);
+extern int	ExecBatchScanColumn(BatchScanState *bstate, AttrNumber attnum);
+extern TupleBatch *ExecSeqScanBatch(BatchScanState *bstate);
+
+extern BatchAggKind ExecBatchAggKind(Oid transfn_oid, bool inputByVal,
+				 bool transtypeByVal);
+extern void ExecBatchAdvanceAggregate(BatchAggKind kind, TupleBatch *batch,
+						  int col, Datum *transValue,
+						  bool *transValueIsNull, bool *noTransValue);
+
+#endif   /* EXECBATCH_H */
@@ -0,0 +1,144 @@
+/*-------------------------------------------------------------------------
+ *
+ * execFlatExpr.h
+ *	  Flattened, opcode-based evaluation of expression state trees.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/executor/execFlatExpr.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECFLATEXPR_H
+#define EXECFLATEXPR_H
+
+#include "nodes/execnodes.h"
+
+/* GUC variable */
+extern bool enable_flat_expressions;
+
+/*
+ * Step opcodes.  Each step computes one value into its result location;
+ * function arguments are computed straight into the callee's
+ * FunctionCallInfo, so no copying happens between steps.
+ */
+typedef enum FlatExprOp
+{
+	FEOP_DONE = 0,
+
+	/* make sure slot_getsomeattrs has been done up to d.fetch.last_var */
+	FEOP_INNER_FETCHSOME,
+	FEOP_OUTER_FETCHSOME,
+	FEOP_SCAN_FETCHSOME,
+
+	/* fetch an already-deformed user attribute */
+	FEOP_INNER_VAR,
+	FEOP_OUTER_VAR,
+	FEOP_SCAN_VAR,
+
+	FEOP_CONST,
+
+	/* call a non-set-returning function whose arguments are in place */
+	FEOP_FUNCEXPR,
+	FEOP_FUNCEXPR_STRICT,
+
+	/* evaluate one argument's outcome for an AND, OR or NOT */
+	FEOP_BOOL_AND_STEP_FIRST,
+	FEOP_BOOL_AND_STEP,
+	FEOP_BOOL_AND_STEP_LAST,
+	FEOP_BOOL_OR_STEP_FIRST,
+	FEOP_BOOL_OR_STEP,
+	FEOP_BOOL_OR_STEP_LAST,
+	FEOP_BOOL_NOT_STEP,
+
+	FEOP_NULLTEST_ISNULL,
+	FEOP_NULLTEST_ISNOTNULL,
+
+	/*
+	 * inlined builtin comparisons and arithmetic; arguments are in the
+	 * fcinfo exactly as for FEOP_FUNCEXPR_STRICT, but no call is made
+	 */
+	FEOP_INT4_CMP,
+	FEOP_INT8_CMP,
+	FEOP_FLOAT8_CMP,
+	FEOP_INT4_PL,
+	FEOP_INT4_MI,
+	FEOP_INT8_PL,
+	FEOP_INT8_MI,
+
+	/* anything else: run the recursive ExprState evaluator on a subtree */
+	FEOP_SUBTREE,
+
+	FEOP_LAST
+} FlatExprOp;
+
+/* Comparison made by FEOP_*_CMP */
+typedef enum FlatCompareOp
+{
+	FLAT_CMP_EQ,
+	FLAT_CMP_NE,
+	FLAT_CMP_LT,
+	FLAT_CMP_LE,
+	FLAT_CMP_GT,
+	FLAT_CMP_GE
+} FlatCompareOp;
+
+typedef struct FlatExprStep
+{
+	/* a FlatExprOp, replaced by a label address when direct-threaded */
+	intptr_t	opcode;
+
+	/* where to store the result of this step */
+	Datum	   *resvalue;
+	bool	   *resnull;
+
+	union
+	{
+		/* for FEOP_*_FETCHSOME */
+		struct
+		{
+			int			last_var;
+		}			fetch;
+
+		/* for FEOP_*_VAR; attnum is zero-based */
+		struct
+		{
+			int			attnum;
+		}			var;
+
+		/* for FEOP_CONST */
+		struct
+		{
+			Datum		value;
+			bool		isnull;
+		}			constval;
+
+		/* for FEOP_FUNCEXPR* and the inlined builtins */
+		struct
+		{
+			FunctionCallInfo fcinfo;
+			int			nargs;
+			FlatCompareOp cmpop;	/* for FEOP_*_CMP only */
+		}			func;
+
+		/* for FEOP_BOOL_* */
+		struct
+		{
+			bool	   *anynull;	/* shared by all steps of one BoolExpr */
+			int			jumpdone;	/* step to go to once result is known */
+		}			boolexpr;
+
+		/* for FEOP_SUBTREE */
+		struct
+		{
+			ExprState  *state;
+		}			subtree;
+	}			d;
+} FlatExprStep;
+
+extern ExprState *ExecFlattenExpr(ExprState *state);
+extern void ExecFlattenPlanExprs(PlanState *planstate);
+
+#endif   /* EXECFLATEXPR_H */
@@ -150,6 +150,8 @@ extern TupleHashEntry FindTupleHashEntry(TupleHashTable hashtable,
 				   TupleTableSlot *slot,
 				   FmgrInfo *eqfunctions,
 				   FmgrInfo *hashfunctions);
+extern TupleHashEntry RemoveTupleHashEntry(TupleHashTable hashtable,
+					 TupleTableSlot *slot);
 
 /*
  * prototypes from functions in execJunk.c
@@ -218,6 +220,17 @@ extern TupleTableSlot *EvalPlanQualNext(EPQState *epqstate);
 extern void EvalPlanQualBegin(EPQState *epqstate, EState *parentestate);
 extern void EvalPlanQualEnd(EPQState *epqstate);
 
+/*
+ * prototypes from functions in execPrune.c
+ */
+extern List *ExecPruneSubplansAtInit(List *subplans,
+						List *prune_constraints, List *prune_clauses,
+						ExprContext *econtext,
+						List ***constraints, List ***clauses,
+						int *nremoved);
+extern void ExecPruneSubplansAtScan(int nplans, List **constraints,
+						List **clauses, ExprContext *econtext, bool *valid);
+
 /*
  * prototypes from functions in execProcnode.c
  */
@@ -368,6 +381,10 @@ extern void ExecCloseIndices(ResultRelInfo *resultRelInfo);
 extern List *ExecInsertIndexTuples(TupleTableSlot *slot, ItemPointer tupleid,
 					  EState *estate, bool noDupErr, bool *specConflict,
 					  List *arbiterIndexes);
+extern void ExecInsertIndexTuplesBatch(TupleTableSlot *slot, HeapTuple *tuples,
+						   int ntuples, EState *estate,
+						   List **recheckIndexes,
+						   int *curpos, int firstpos);
 extern bool ExecCheckIndexConstraints(TupleTableSlot *slot, EState *estate,
 						  ItemPointer conflictTid, List *arbiterIndexes);
 extern void check_exclusion_constraint(Relation heap, Relation index,
@@ -15,7 +15,9 @@
 #define HASHJOIN_H
 
 #include "nodes/execnodes.h"
+#include "port/atomics.h"
 #include "storage/buffile.h"
+#include "storage/spin.h"
 
 /* ----------------------------------------------------------------
  *				hash-join hash table structures
@@ -63,7 +65,12 @@
 
 typedef struct HashJoinTupleData
 {
-	struct HashJoinTupleData *next;		/* link to next tuple in same bucket */
+	/* link to next tuple in same bucket */
+	union
+	{
+		struct HashJoinTupleData *unshared;
+		uint32		shared;		/* see SharedHashJoinTableData */
+	}			next;
 	uint32		hashvalue;		/* tuple's hash code */
 	/* Tuple data, in MinimalTuple format, follows on a MAXALIGN boundary */
 }	HashJoinTupleData;
@@ -123,6 +130,29 @@ typedef struct HashMemoryChunkData *HashMemoryChunk;
 #define HASH_CHUNK_SIZE			(32 * 1024L)
 #define HASH_CHUNK_THRESHOLD	(HASH_CHUNK_SIZE / 4)
 
+/*
+ * Once a batch has been loaded into a large enough hash table, the main
+ * table's tuples are also laid out as an array of (hash value, tuple)
+ * entries grouped by bucket, which is what probes use.  A bucket's entries
+ * are contiguous and carry the hash value inline, so most non-matching
+ * tuples are rejected without touching the tuples themselves, which are
+ * scattered across the dense_alloc chunks.  bucketStart[i] is the index of
+ * bucket i's first entry, and bucketStart[nbuckets] the number of entries.
+ *
+ * The array is built by radix-partitioning the entries on their bucket
+ * number: first on its high-order bits, then within each partition on the
+ * rest, so that no pass writes to more places at once than the CPU caches
+ * can cope with.  The bucket chains are left intact for everything else.
+ */
+typedef struct HashJoinBucketEntry
+{
+	uint32		hashvalue;		/* tuple's hash code */
+	HashJoinTuple tuple;		/* the tuple itself */
+} HashJoinBucketEntry;
+
+/* don't bother with the entry array for fewer tuples than this */
+#define HJ_BUCKET_ENTRIES_MIN_TUPLES	4096
+
 typedef struct HashJoinTableData
 {
 	int			nbuckets;		/* # buckets in the in-memory hash table */
@@ -186,6 +216,59 @@ typedef struct HashJoinTableData
 
 	/* used for dense allocation of tuples (into linked chunks) */
 	HashMemoryChunk chunks;		/* one list for the whole batch */
+
+	/* bucket-grouped entries for probing, or NULL if not built */
+	uint32	   *bucketStart;	/* first entry of each bucket, and the end */
+	HashJoinBucketEntry *bucketEntries;
+
+	/* bloom filter over the hash values of all inner tuples, or NULL */
+	uint64	   *bloomFilter;
+	int			log2_bloombits; /* log2 of the filter's size in bits */
+
+	/* shared table we are helping to build and probe, or NULL */
+	SharedHashJoinTable shared;
+	Size		sharedChunkPos; /* free space in our current shared chunk */
+	Size		sharedChunkEnd;
 }	HashJoinTableData;
 
+/*
+ * A parallel-aware hash join builds a single table in shared memory (in
+ * practice a DSM segment), which all participating backends fill and then
+ * probe.  The segment may be mapped at a different address in each backend,
+ * so the table links tuples by position rather than by pointer: bucket heads
+ * and HashJoinTupleData.next.shared hold the offset of a tuple from the start
+ * of the SharedHashJoinTableData, in MAXALIGN units, with zero meaning end of
+ * list.  That lets 32-bit atomics address tables of up to 32GB on 64-bit
+ * machines.  Bucket heads are updated by compare-and-swap, so inserting needs
+ * no lock; tuple storage is handed out to participants a chunk at a time
+ * under the mutex.
+ *
+ * A shared table always has one batch; it is sized by whoever creates it,
+ * and running out of space is an error.  Right and full joins can't use it,
+ * because marking tuples as matched would race between participants.
+ */
+typedef struct SharedHashJoinTableData
+{
+	slock_t		mutex;			/* protects the fields below */
+	Size		spaceUsed;		/* bytes of tuple storage handed out */
+	int			nbuilt;			/* participants done inserting */
+	double		totalTuples;	/* tuples inserted by those participants */
+
+	/* these are constant after initialization */
+	int			nparticipants;	/* number of backends building the table */
+	int			nbuckets;		/* a power of 2 */
+	int			log2_nbuckets;
+	Size		spaceAllowed;	/* size of the tuple storage area */
+	Size		tuplesOffset;	/* where tuple storage starts */
+
+	/* bucket heads, followed by tuple storage */
+	pg_atomic_uint32 buckets[FLEXIBLE_ARRAY_MEMBER];
+}	SharedHashJoinTableData;
+
+#define SHARED_HJ_OFFSET(shared, ptr) \
+	((uint32) (((char *) (ptr) - (char *) (shared)) / MAXIMUM_ALIGNOF))
+#define SHARED_HJ_TUPLE(shared, off) \
+	((HashJoinTuple) ((off) == 0 ? NULL : \
+					  (char *) (shared) + (Size) (off) * MAXIMUM_ALIGNOF))
+
 #endif   /* HASHJOIN_H */
@@ -28,6 +28,11 @@ typedef struct BufferUsage
 	long		local_blks_written;		/* # of local disk blocks written */
 	long		temp_blks_read; /* # of temp blocks read */
 	long		temp_blks_written;		/* # of temp blocks written */
+	int64		temp_bytes_read;	/* # of bytes read from temp files */
+	int64		temp_bytes_written;		/* # of bytes written to temp files */
+	int64		temp_bytes_raw_written;	/* same, before compression */
+	long		wal_records;	/* # of WAL records generated */
+	int64		wal_bytes;		/* # of WAL bytes generated */
 	instr_time	blk_read_time;	/* time spent reading */
 	instr_time	blk_write_time; /* time spent writing */
 } BufferUsage;
@@ -38,6 +43,7 @@ typedef enum InstrumentOption
 	INSTRUMENT_TIMER = 1 << 0,	/* needs timer (and row counts) */
 	INSTRUMENT_BUFFERS = 1 << 1,	/* needs buffer usage */
 	INSTRUMENT_ROWS = 1 << 2,	/* needs row count */
+	INSTRUMENT_MEMORY = 1 << 3, /* needs temp file usage, for EXPLAIN MEMORY */
 	INSTRUMENT_ALL = PG_INT32_MAX
 } InstrumentOption;
 
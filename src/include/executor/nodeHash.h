@@ -49,5 +49,16 @@ extern void ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 						int *numbatches,
 						int *num_skew_mcvs);
 extern int	ExecHashGetSkewBucket(HashJoinTable hashtable, uint32 hashvalue);
+extern void ExecHashBuildBucketEntries(HashJoinTable hashtable);
+extern void ExecHashTableCreateBloom(HashJoinTable hashtable, double ntuples);
+extern void ExecHashActivateRuntimeFilter(RuntimeFilterState *filter,
+							  HashJoinTable hashtable);
+extern bool ExecHashRuntimeFilterPasses(RuntimeFilterState *filter,
+							ExprContext *econtext);
+extern Size ExecHashSharedEstimate(int nbuckets, Size space);
+extern void ExecHashSharedInitialize(SharedHashJoinTable shared, Size size,
+						 int nbuckets, int nparticipants);
+extern void ExecHashTableAttachShared(HashJoinTable hashtable,
+						  SharedHashJoinTable shared);
 
 #endif   /* NODEHASH_H */
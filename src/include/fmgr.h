@@ -65,6 +65,10 @@ typedef struct FmgrInfo
 
 /*
  * This struct is the data actually passed to an fmgr-called function.
+ *
+ * arg[] must be the last field: a called function never looks at arg[i]
+ * for i >= nargs, so a caller passing few arguments need not allocate the
+ * whole array (see LOCAL_FCINFO).
  */
 typedef struct FunctionCallInfoData
 {
@@ -74,10 +78,32 @@ typedef struct FunctionCallInfoData
 	Oid			fncollation;	/* collation for function to use */
 	bool		isnull;			/* function must set true if result is NULL */
 	short		nargs;			/* # arguments actually passed */
-	Datum		arg[FUNC_MAX_ARGS];		/* Arguments passed to function */
 	bool		argnull[FUNC_MAX_ARGS]; /* T if arg[i] is actually NULL */
+	Datum		arg[FUNC_MAX_ARGS];		/* Arguments passed to function */
 } FunctionCallInfoData;
 
+/*
+ * Space needed for a FunctionCallInfoData that can hold nargs arguments.
+ */
+#define SizeForFunctionCallInfo(nargs) \
+	(offsetof(FunctionCallInfoData, arg) + sizeof(Datum) * (nargs))
+
+/*
+ * Declare a FunctionCallInfo "name" pointing to stack space for nargs
+ * arguments.  With FUNC_MAX_ARGS at 100 a full FunctionCallInfoData is
+ * close to a kilobyte, which is a lot of stack to dirty for a two-argument
+ * comparison function called per tuple; this is about a sixth of that.
+ * The result must only be passed to functions called with at most nargs
+ * arguments, and must not be copied as a whole.
+ */
+#define LOCAL_FCINFO(name, nargs) \
+	union \
+	{ \
+		Datum		align; \
+		char		data[SizeForFunctionCallInfo(nargs)]; \
+	}			name##data; \
+	FunctionCallInfo name = (FunctionCallInfo) &name##data
+
 /*
  * This routine fills a FmgrInfo struct, given the OID
  * of the function to be called.
@@ -122,6 +122,10 @@ typedef bool (*AnalyzeForeignTable_function) (Relation relation,
 typedef List *(*ImportForeignSchema_function) (ImportForeignSchemaStmt *stmt,
 														   Oid serverOid);
 
+typedef bool (*ForeignAsyncRequest_function) (ForeignScanState *node);
+
+typedef bool (*ForeignAsyncReady_function) (ForeignScanState *node);
+
 /*
  * FdwRoutine is the struct returned by a foreign-data wrapper's handler
  * function.  It provides pointers to the callback functions needed by the
@@ -177,6 +181,10 @@ typedef struct FdwRoutine
 
 	/* Support functions for IMPORT FOREIGN SCHEMA */
 	ImportForeignSchema_function ImportForeignSchema;
+
+	/* Support functions for asynchronous execution */
+	ForeignAsyncRequest_function ForeignAsyncRequest;
+	ForeignAsyncReady_function ForeignAsyncReady;
 } FdwRoutine;
 
 
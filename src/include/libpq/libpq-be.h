@@ -134,11 +134,22 @@ typedef struct Port
 	 * Information that needs to be saved from the startup packet and passed
 	 * into backend execution.  "char *" fields are NULL if not set.
 	 * guc_options points to a List of alternating option names and values.
+	 * compression is the protocol compression algorithm picked from the
+	 * client's list.  pooled is set if the connection comes from the
+	 * connection proxy, and proxy_trusted if the proxy vouched for the
+	 * client so that it need not authenticate again.  When the proxy relays
+	 * the authentication of a Unix-domain socket client, proxy_peer_uid is
+	 * that client's user ID, if proxy_peer_known.
 	 */
 	char	   *database_name;
 	char	   *user_name;
 	char	   *cmdline_options;
 	List	   *guc_options;
+	char	   *compression;
+	bool		pooled;
+	bool		proxy_trusted;
+	bool		proxy_peer_known;
+	uid_t		proxy_peer_uid;
 
 	/*
 	 * Information that needs to be held during the authentication cycle.
@@ -182,6 +193,7 @@ typedef struct Port
 	 * SSL structures.
 	 */
 	bool		ssl_in_use;
+	bool		ssl_ktls_tx;	/* kernel encrypts what we send? */
 	char	   *peer_cn;
 	bool		peer_cert_valid;
 
@@ -19,6 +19,7 @@
 
 #include "lib/stringinfo.h"
 #include "libpq/libpq-be.h"
+#include "storage/latch.h"
 
 
 typedef struct
@@ -35,6 +36,16 @@ typedef struct
 
 extern PGDLLIMPORT PQcommMethods *PqCommMethods;
 
+/*
+ * Wait event set for the client socket, set up by pq_init.  The positions
+ * of its events are fixed, so that callers can adjust them in place.
+ */
+extern WaitEventSet *FeBeWaitSet;
+
+#define FeBeWaitSetSocketPos	0
+#define FeBeWaitSetLatchPos		1
+#define FeBeWaitSetNEvents		3
+
 #define pq_comm_reset() (PqCommMethods->comm_reset())
 #define pq_flush() (PqCommMethods->flush())
 #define pq_flush_if_writable() (PqCommMethods->flush_if_writable())
@@ -71,6 +82,7 @@ extern int	pq_getbyte(void);
 extern int	pq_peekbyte(void);
 extern int	pq_getbyte_if_available(unsigned char *c);
 extern int	pq_putbytes(const char *s, size_t len);
+extern void pq_enable_compression(const char *algorithm);
 
 /*
  * prototypes for functions in be-secure.c
@@ -92,6 +104,11 @@ extern ssize_t secure_read(Port *port, void *ptr, size_t len);
 extern ssize_t secure_write(Port *port, void *ptr, size_t len);
 extern ssize_t secure_raw_read(Port *port, void *ptr, size_t len);
 extern ssize_t secure_raw_write(Port *port, const void *ptr, size_t len);
+#ifndef WIN32
+struct iovec;
+extern ssize_t secure_writev(Port *port, struct iovec *iov, int iovcnt,
+			  bool more);
+#endif
 
 extern bool ssl_loaded_verify_locations;
 
@@ -99,5 +116,6 @@ extern bool ssl_loaded_verify_locations;
 extern char *SSLCipherSuites;
 extern char *SSLECDHCurve;
 extern bool SSLPreferServerCiphers;
+extern bool SSLKernelTLS;
 
 #endif   /* LIBPQ_H */
@@ -537,6 +537,7 @@ extern bool pg_verify_mbstr(int encoding, const char *mbstr, int len,
 				bool noError);
 extern int pg_verify_mbstr_len(int encoding, const char *mbstr, int len,
 					bool noError);
+extern int	pg_valid_ascii_len(const unsigned char *s, int len);
 
 extern void check_encoding_conversion_args(int src_encoding,
 							   int dest_encoding,
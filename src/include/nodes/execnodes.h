@@ -17,6 +17,7 @@
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "executor/instrument.h"
+#include "lib/ilist.h"
 #include "lib/pairingheap.h"
 #include "nodes/params.h"
 #include "nodes/plannodes.h"
@@ -33,7 +34,8 @@
  *		entries for a particular index.  Used for both index_build and
  *		retail creation of index entries.
  *
- *		NumIndexAttrs		number of columns in this index
+ *		NumIndexAttrs		total number of columns in this index
+ *		NumIndexKeyAttrs	number of key columns; the rest are INCLUDE columns
  *		KeyAttrNumbers		underlying-rel attribute numbers used as keys
  *							(zeroes indicate expressions)
  *		Expressions			expr trees for expression entries, or NIL if none
@@ -59,6 +61,7 @@ typedef struct IndexInfo
 {
 	NodeTag		type;
 	int			ii_NumIndexAttrs;
+	int			ii_NumIndexKeyAttrs;
 	AttrNumber	ii_KeyAttrNumbers[INDEX_MAX_KEYS];
 	List	   *ii_Expressions; /* list of Expr */
 	List	   *ii_ExpressionsState;	/* list of ExprState */
@@ -501,9 +504,30 @@ typedef struct TupleHashEntryData
 	/* there may be additional data beyond the end of this struct */
 } TupleHashEntryData;			/* VARIABLE LENGTH STRUCT */
 
+/*
+ * The buckets of the underlying open-addressing table only point at the
+ * entries, which are allocated separately in the table's context.  That keeps
+ * the bucket array dense whatever the caller's entry size is, and keeps an
+ * entry's address stable when the bucket array grows or shifts.
+ */
+typedef struct TupleHashBucket
+{
+	TupleHashEntry entry;		/* the entry, or NULL during a lookup */
+	uint32		hash;			/* hash value of the entry's key columns */
+	char		status;			/* hash status */
+} TupleHashBucket;
+
+/* define parameters necessary to generate the tuple hash table interface */
+#define SH_PREFIX tuplehash
+#define SH_ELEMENT_TYPE TupleHashBucket
+#define SH_KEY_TYPE TupleHashEntry
+#define SH_SCOPE extern
+#define SH_DECLARE
+#include "lib/simplehash.h"
+
 typedef struct TupleHashTableData
 {
-	HTAB	   *hashtab;		/* underlying dynahash table */
+	tuplehash_hash *hashtab;	/* underlying hash table */
 	int			numCols;		/* number of columns in lookup key */
 	AttrNumber *keyColIdx;		/* attr numbers of key columns */
 	FmgrInfo   *tab_hash_funcs; /* hash functions for table datatype(s) */
@@ -511,6 +535,10 @@ typedef struct TupleHashTableData
 	MemoryContext tablecxt;		/* memory context containing table */
 	MemoryContext tempcxt;		/* context for function evaluations */
 	Size		entrysize;		/* actual size to make each hash entry */
+	char	   *entrybatch;		/* next unused entry of current batch */
+	int			nbatchfree;		/* number of unused entries in batch */
+	TupleHashEntry freelist;	/* removed entries, linked by firstTuple */
+	TupleHashEntry removedentry;	/* entry removed most recently */
 	TupleTableSlot *tableslot;	/* slot for referencing table entries */
 	/* The following fields are set transiently for each table search: */
 	TupleTableSlot *inputslot;	/* current input tuple's slot */
@@ -518,7 +546,7 @@ typedef struct TupleHashTableData
 	FmgrInfo   *cur_eq_funcs;	/* equality functions for input vs. table */
 }	TupleHashTableData;
 
-typedef HASH_SEQ_STATUS TupleHashIterator;
+typedef tuplehash_iterator TupleHashIterator;
 
 /*
  * Use InitTupleHashIterator/TermTupleHashIterator for a read/write scan.
@@ -526,16 +554,19 @@ typedef HASH_SEQ_STATUS TupleHashIterator;
  * explicit scan termination is needed).
  */
 #define InitTupleHashIterator(htable, iter) \
-	hash_seq_init(iter, (htable)->hashtab)
+	tuplehash_start_iterate((htable)->hashtab, iter)
 #define TermTupleHashIterator(iter) \
-	hash_seq_term(iter)
+	((void) 0)
 #define ResetTupleHashIterator(htable, iter) \
-	do { \
-		hash_freeze((htable)->hashtab); \
-		hash_seq_init(iter, (htable)->hashtab); \
-	} while (0)
-#define ScanTupleHashTable(iter) \
-	((TupleHashEntry) hash_seq_search(iter))
+	InitTupleHashIterator(htable, iter)
+#define ScanTupleHashTable(htable, iter) \
+	ScanTupleHashTableBucket(tuplehash_iterate((htable)->hashtab, iter))
+
+static inline TupleHashEntry
+ScanTupleHashTableBucket(TupleHashBucket *bucket)
+{
+	return bucket ? bucket->entry : NULL;
+}
 
 
 /* ----------------------------------------------------------------
@@ -746,6 +777,11 @@ typedef struct ScalarArrayOpExprState
 	int16		typlen;
 	bool		typbyval;
 	char		typalign;
+	/* Hash table of the array's elements, if the planner asked for one */
+	struct saophash_hash *elements_tab;
+	FmgrInfo	hash_finfo;		/* element hash function */
+	FmgrInfo	eq_finfo;		/* equality function probing the table */
+	bool		has_nulls;		/* does the array contain any NULLs? */
 } ScalarArrayOpExprState;
 
 /* ----------------
@@ -1005,6 +1041,26 @@ typedef struct DomainConstraintState
 	ExprState  *check_expr;		/* for CHECK, a boolean expression */
 } DomainConstraintState;
 
+/* ----------------
+ *		FlatExprState node
+ *
+ * Replaces the root of an ExprState tree whose upper levels have been
+ * linearized into an array of steps (see execFlatExpr.c).  xprstate.expr
+ * is the root's Expr, so callers that look at it see no difference.  The
+ * steps are built on first evaluation, in "cxt".
+ * ----------------
+ */
+typedef struct FlatExprState
+{
+	ExprState	xprstate;
+	ExprState  *tree;			/* the ExprState tree being replaced */
+	MemoryContext cxt;			/* context to build the steps in */
+	int			nsteps;			/* number of valid entries in steps[] */
+	struct FlatExprStep *steps; /* NULL until first evaluation */
+	Datum		resvalue;		/* result of the whole expression */
+	bool		resnull;
+} FlatExprState;
+
 
 /* ----------------------------------------------------------------
  *				 Executor State Trees
@@ -1136,6 +1192,14 @@ typedef struct ModifyTableState
 										 * tlist  */
 	TupleTableSlot *mt_conflproj;		/* CONFLICT ... SET ... projection
 										 * target */
+	/* for an INSERT writing rows in batches with heap_multi_insert: */
+	bool		mt_multiInsert; /* are we batching rows? */
+	HeapTuple  *mt_bufferedTuples;	/* rows not yet written */
+	int			mt_nBufferedTuples;
+	Size		mt_bufferedBytes;	/* total size of those rows */
+	MemoryContext mt_batchcxt;	/* context holding those rows */
+	struct BulkInsertStateData *mt_bistate;
+	TupleTableSlot *mt_batchslot;	/* for inserting index entries */
 } ModifyTableState;
 
 /* ----------------
@@ -1143,6 +1207,9 @@ typedef struct ModifyTableState
  *
  *		nplans			how many plans are in the array
  *		whichplan		which plan is being executed (0 .. n-1)
+ *		async			are async-capable subplans run concurrently?
+ *		asyncplans		which subplans are async-capable foreign scans
+ *		finished		which subplans are exhausted (only if async)
  * ----------------
  */
 typedef struct AppendState
@@ -1151,6 +1218,15 @@ typedef struct AppendState
 	PlanState **appendplans;	/* array of PlanStates for my inputs */
 	int			as_nplans;
 	int			as_whichplan;
+	bool		as_async;
+	bool	   *as_asyncplans;
+	bool	   *as_finished;
+	/* run-time pruning state, see execPrune.c */
+	int			as_nremoved;	/* # of subplans pruned at startup */
+	List	  **as_prune_constraints;	/* per-subplan info, or NULL */
+	List	  **as_prune_clauses;
+	bool	   *as_valid;		/* subplans to scan, or NULL if all */
+	bool		as_prune_pending;	/* must recompute as_valid? */
 } AppendState;
 
 /* ----------------
@@ -1174,6 +1250,11 @@ typedef struct MergeAppendState
 	TupleTableSlot **ms_slots;	/* array of length ms_nplans */
 	struct binaryheap *ms_heap; /* binary heap of slot indices */
 	bool		ms_initialized; /* are subplans started? */
+	/* run-time pruning state, as in AppendState */
+	int			ms_nremoved;
+	List	  **ms_prune_constraints;
+	List	  **ms_prune_clauses;
+	bool	   *ms_valid;		/* recomputed whenever !ms_initialized */
 } MergeAppendState;
 
 /* ----------------
@@ -1229,6 +1310,28 @@ typedef struct BitmapOrState
  * ----------------------------------------------------------------
  */
 
+/* ----------------
+ *	 RuntimeFilterState information
+ *
+ *		A hash join can push a filter down into the scan feeding its outer
+ *		side.  Once the hash table is built, the scan drops tuples whose join
+ *		keys hash to a value missing from the hash table's bloom filter,
+ *		since those can't join; it does so before checking its own quals.
+ *
+ *		hashtable		   hash table (and bloom filter) to check against
+ *		hashkeys		   outer hash keys, rewritten to use the scan tuple
+ *		active			   is the filter built and worth checking?
+ *		nfiltered		   number of tuples the filter has rejected
+ * ----------------
+ */
+typedef struct RuntimeFilterState
+{
+	struct HashJoinTableData *hashtable;
+	List	   *hashkeys;		/* list of ExprState nodes */
+	bool		active;
+	double		nfiltered;
+} RuntimeFilterState;
+
 /* ----------------
  *	 ScanState information
  *
@@ -1241,6 +1344,7 @@ typedef struct BitmapOrState
  *		currentRelation    relation being scanned (NULL if none)
  *		currentScanDesc    current scan descriptor for scan (NULL if none)
  *		ScanTupleSlot	   pointer to slot in tuple table holding scan tuple
+ *		runtimeFilter	   filter pushed down by a hash join (NULL if none)
  * ----------------
  */
 typedef struct ScanState
@@ -1249,6 +1353,7 @@ typedef struct ScanState
 	Relation	ss_currentRelation;
 	HeapScanDesc ss_currentScanDesc;
 	TupleTableSlot *ss_ScanTupleSlot;
+	RuntimeFilterState *ss_runtimeFilter;
 } ScanState;
 
 /*
@@ -1422,6 +1527,7 @@ typedef struct BitmapIndexScanState
  *		bitmapqualorig	   execution state for bitmapqualorig expressions
  *		tbm				   bitmap obtained from child index scan(s)
  *		tbmiterator		   iterator for scanning current pages
+ *		stream			   read stream of the pages tbmiterator returns
  *		tbmres			   current-page data
  *		exact_pages		   total number of exact pages retrieved
  *		lossy_pages		   total number of lossy pages retrieved
@@ -1436,6 +1542,7 @@ typedef struct BitmapHeapScanState
 	List	   *bitmapqualorig;
 	TIDBitmap  *tbm;
 	TBMIterator *tbmiterator;
+	struct ReadStream *stream;
 	TBMIterateResult *tbmres;
 	long		exact_pages;
 	long		lossy_pages;
@@ -1718,9 +1825,13 @@ typedef struct MergeJoinState
  *		hj_HashOperators		the join operators in the hashjoin condition
  *		hj_HashTable			hash table for the hashjoin
  *								(NULL if table not built yet)
+ *		hj_RuntimeFilter		filter pushed down into the outer scan
+ *								(NULL if none)
  *		hj_CurHashValue			hash value for current outer tuple
  *		hj_CurBucketNo			regular bucket# for current outer tuple
  *		hj_CurSkewBucketNo		skew bucket# for current outer tuple
+ *		hj_CurEntryNo			index of hj_CurTuple in the table's bucket
+ *								entry array, when probing that
  *		hj_CurTuple				last inner tuple matched to current outer
  *								tuple, or NULL if starting search
  *								(hj_CurXXX variables are undefined if
@@ -1739,6 +1850,7 @@ typedef struct MergeJoinState
 /* these structs are defined in executor/hashjoin.h: */
 typedef struct HashJoinTupleData *HashJoinTuple;
 typedef struct HashJoinTableData *HashJoinTable;
+typedef struct SharedHashJoinTableData *SharedHashJoinTable;
 
 typedef struct HashJoinState
 {
@@ -1748,9 +1860,11 @@ typedef struct HashJoinState
 	List	   *hj_InnerHashKeys;		/* list of ExprState nodes */
 	List	   *hj_HashOperators;		/* list of operator OIDs */
 	HashJoinTable hj_HashTable;
+	RuntimeFilterState *hj_RuntimeFilter;	/* filter for outer scan, if any */
 	uint32		hj_CurHashValue;
 	int			hj_CurBucketNo;
 	int			hj_CurSkewBucketNo;
+	int			hj_CurEntryNo;
 	HashJoinTuple hj_CurTuple;
 	TupleTableSlot *hj_OuterTupleSlot;
 	TupleTableSlot *hj_HashTupleSlot;
@@ -1785,6 +1899,43 @@ typedef struct MaterialState
 	Tuplestorestate *tuplestorestate;
 } MaterialState;
 
+/* ----------------
+ *	 MemoizeState information
+ *
+ *		memoize nodes cache the results of each scan of their subplan in
+ *		a hash table keyed by the values of the plan's param_exprs.  The
+ *		least recently used entries are thrown away to stay within
+ *		work_mem.  The entries themselves are private to nodeMemoize.c.
+ * ----------------
+ */
+typedef struct MemoizeState
+{
+	PlanState	ps;				/* its first field is NodeTag */
+	int			mstatus;		/* state of the current scan, see
+								 * nodeMemoize.c */
+	int			numKeys;		/* number of cache keys */
+	List	   *param_exprs;	/* ExprStates computing the cache keys */
+	AttrNumber *keyColIdx;		/* 1..numKeys, for the hash table */
+	FmgrInfo   *eqfunctions;	/* per-key equality functions */
+	FmgrInfo   *hashfunctions;	/* per-key hash functions */
+	TupleTableSlot *probeslot;	/* virtual slot holding the current keys */
+	TupleTableSlot *keyslot;	/* slot for an entry's stored keys */
+	TupleHashTable hashtable;	/* the cache */
+	MemoryContext tablecxt;		/* memory context for the cache */
+	dlist_head	lru_list;		/* entries, least recently used first */
+	Size		mem_used;		/* memory used by the cache */
+	Size		mem_limit;		/* memory the cache may use */
+	Bitmapset  *keyparamids;	/* PARAM_EXEC params used by param_exprs */
+	struct MemoizeEntry *entry; /* entry of the current scan, if any */
+	struct MemoizeTuple *last_tuple;	/* tuple last returned from entry */
+	/* statistics for EXPLAIN ANALYZE */
+	long		cache_hits;		/* rescans answered from the cache */
+	long		cache_misses;	/* rescans that had to run the subplan */
+	long		cache_evictions;	/* entries thrown away for space */
+	long		cache_overflows;	/* scans too big to be cached at all */
+	Size		mem_peak;		/* peak value of mem_used */
+} MemoizeState;
+
 /* ----------------
  *	 SortState information
  * ----------------
@@ -1801,6 +1952,37 @@ typedef struct SortState
 	void	   *tuplesortstate; /* private state of tuplesort.c */
 } SortState;
 
+/* ----------------
+ *	 IncrementalSortState information
+ *
+ *		The input arrives sorted on a prefix of the sort keys.  Tuples are
+ *		collected into batches that never split a group of equal prefix
+ *		keys, and each batch is sorted by its own tuplesort on all the keys.
+ *		group_pivot is the tuple that a batch's last group must match on the
+ *		prefix keys; transfer_tuple holds the first tuple of the next batch
+ *		when it has already been read from the outer plan.
+ * ----------------
+ */
+typedef struct IncrementalSortState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	bool		bounded;		/* is the result set bounded? */
+	int64		bound;			/* if bounded, how many tuples are needed */
+	int64		tuples_returned;	/* number of tuples returned so far */
+	bool		batch_Sorted;	/* is the current batch being returned? */
+	bool		outerNodeDone;	/* has the outer plan been exhausted? */
+	bool		transfer_Valid; /* does transfer_tuple hold a tuple? */
+	FmgrInfo   *eqfunctions;	/* equality fns for the presorted keys */
+	TupleTableSlot *group_pivot;	/* last group's representative tuple */
+	TupleTableSlot *transfer_tuple; /* first tuple of the next batch */
+	void	   *tuplesortstate; /* private state of tuplesort.c */
+	/* statistics for EXPLAIN ANALYZE */
+	long		n_batches;		/* number of batches sorted */
+	long		peakSpaceUsed;	/* largest batch's space usage, in kB */
+	const char *peakSpaceType;	/* "Memory" or "Disk" for that batch */
+	Size		peakMemory;		/* largest batch's peak memory, in bytes */
+} IncrementalSortState;
+
 /* ---------------------
  *	GroupState information
  * -------------------------
@@ -1842,6 +2024,8 @@ typedef struct AggState
 	ExprContext **aggcontexts;	/* econtexts for long-lived data (per GS) */
 	ExprContext *tmpcontext;	/* econtext for input expressions */
 	AggStatePerAgg curperagg;	/* identifies currently active aggregate */
+	bool		combineStates;	/* input tuples contain transition states */
+	bool		finalizeAggs;	/* should we call the finalfn on agg states? */
 	bool		input_done;		/* indicates end of input */
 	bool		agg_done;		/* indicates completion of Agg scan */
 	int			projected_set;	/* The last projected grouping set */
@@ -1864,6 +2048,16 @@ typedef struct AggState
 	List	   *hash_needed;	/* list of columns needed in hash table */
 	bool		table_filled;	/* hash table filled yet? */
 	TupleHashIterator hashiter; /* for iterating through hash table */
+	Size		hash_mem_limit; /* stop adding groups past this much memory */
+	struct HashAggSpill *hash_spill;	/* partitions being written, or NULL */
+	List	   *hash_batches;	/* spilled partitions still to process */
+	struct BufFile *hash_input_file;	/* partition being read, or NULL */
+	int			hash_input_bits;	/* hash bits used to partition it */
+	TupleTableSlot *hash_spill_slot;	/* slot for reading spilled tuples */
+	int			hash_batches_used;	/* number of batches processed */
+	Size		hash_mem_peak;	/* peak hash table memory usage */
+	/* set if input is consumed in batches; see executor/execBatch.c */
+	struct BatchScanState *batchscan;
 } AggState;
 
 /* ----------------
@@ -1959,6 +2153,7 @@ typedef struct HashState
 	HashJoinTable hashtable;	/* hash table for the hashjoin */
 	List	   *hashkeys;		/* list of ExprState nodes */
 	/* hashkeys is same as parent's hj_InnerHashKeys */
+	SharedHashJoinTable shared_table;	/* shared table to build, or NULL */
 } HashState;
 
 /* ----------------
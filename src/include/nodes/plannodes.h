@@ -173,6 +173,7 @@ typedef struct ModifyTable
 	Plan		plan;
 	CmdType		operation;		/* INSERT, UPDATE, or DELETE */
 	bool		canSetTag;		/* do we set the command tag/es_processed? */
+	bool		canMultiInsert; /* may INSERT batch rows, if no triggers? */
 	Index		nominalRelation;	/* Parent RT index for use of EXPLAIN */
 	List	   *resultRelations;	/* integer list of RT indexes */
 	int			resultRelIndex; /* index of first resultRel in plan's list */
@@ -199,6 +200,9 @@ typedef struct Append
 {
 	Plan		plan;
 	List	   *appendplans;
+	/* run-time pruning info, lists parallel to appendplans or NIL */
+	List	   *prune_constraints;	/* per-subplan CHECK constraints */
+	List	   *prune_clauses;	/* per-subplan quals mentioning Params */
 } Append;
 
 /* ----------------
@@ -216,6 +220,9 @@ typedef struct MergeAppend
 	Oid		   *sortOperators;	/* OIDs of operators to sort them by */
 	Oid		   *collations;		/* OIDs of collations */
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
+	/* run-time pruning info, as in struct Append */
+	List	   *prune_constraints;
+	List	   *prune_clauses;
 } MergeAppend;
 
 /* ----------------
@@ -664,6 +671,24 @@ typedef struct Material
 	Plan		plan;
 } Material;
 
+/* ----------------
+ *		memoize node
+ *
+ * Caches the output of its subplan, usually the parameterized inner side of
+ * a nestloop, keyed by the values of param_exprs.  A rescan whose
+ * parameter values have been seen before is then answered from the cache.
+ * ----------------
+ */
+typedef struct Memoize
+{
+	Plan		plan;
+	int			numKeys;		/* number of cache keys */
+	Oid		   *eqOperators;	/* equality operators to compare keys with */
+	List	   *param_exprs;	/* expressions computing the cache keys */
+	uint32		est_entries;	/* planner's estimate of the number of cache
+								 * entries, or 0 if unknown */
+} Memoize;
+
 /* ----------------
  *		sort node
  * ----------------
@@ -678,6 +703,19 @@ typedef struct Sort
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
 } Sort;
 
+/* ----------------
+ *		incremental sort node
+ *
+ * The input is known to be sorted already on the first presortedCols sort
+ * keys; only groups of tuples that are equal on those keys need sorting.
+ * ----------------
+ */
+typedef struct IncrementalSort
+{
+	Sort		sort;
+	int			presortedCols;	/* number of presorted leading columns */
+} IncrementalSort;
+
 /* ---------------
  *	 group node -
  *		Used for queries with GROUP BY (but no aggregates) specified.
@@ -717,6 +755,8 @@ typedef struct Agg
 {
 	Plan		plan;
 	AggStrategy aggstrategy;
+	bool		combineStates;	/* input tuples contain transition states */
+	bool		finalizeAggs;	/* should we call the finalfn on agg states? */
 	int			numCols;		/* number of grouping columns */
 	AttrNumber *grpColIdx;		/* their indexes in the target list */
 	Oid		   *grpOperators;	/* equality operators to compare with */
@@ -255,6 +255,12 @@ typedef struct Param
  * DISTINCT is not supported in this case, so aggdistinct will be NIL.
  * The direct arguments appear in aggdirectargs (as a list of plain
  * expressions, not TargetEntry nodes).
+ *
+ * The planner may split an aggregate into a partial step and a combining
+ * step.  A partial Aggref (aggpartial) returns its transition state rather
+ * than the finalized result, and its aggtype is the transition type.  A
+ * combining Aggref (aggcombine) has a single argument that evaluates to a
+ * transition state produced by a partial step.  The parser never sets these.
  */
 typedef struct Aggref
 {
@@ -271,6 +277,8 @@ typedef struct Aggref
 	bool		aggstar;		/* TRUE if argument list was really '*' */
 	bool		aggvariadic;	/* true if variadic arguments have been
 								 * combined into an array last argument */
+	bool		aggcombine;		/* input is a transition state to combine */
+	bool		aggpartial;		/* result is the unfinalized transition state */
 	char		aggkind;		/* aggregate kind (see pg_aggregate.h) */
 	Index		agglevelsup;	/* > 0 if agg belongs to outer query */
 	int			location;		/* token location, or -1 if unknown */
@@ -493,12 +501,21 @@ typedef OpExpr NullIfExpr;
  * is almost the same as for the underlying operator, but we need a useOr
  * flag to remember whether it's ANY or ALL, and we don't have to store
  * the result type (or the collation) because it must be boolean.
+ *
+ * If the planner chooses to have the array's elements looked up in a hash
+ * table rather than searched linearly, hashfuncid is the element hash
+ * function.  For ALL, negfuncid is then the function of the operator's
+ * negator, the equality the table is probed with; it is InvalidOid for ANY,
+ * where the operator itself is the equality.
  */
 typedef struct ScalarArrayOpExpr
 {
 	Expr		xpr;
 	Oid			opno;			/* PG_OPERATOR OID of the operator */
 	Oid			opfuncid;		/* PG_PROC OID of underlying function */
+	Oid			hashfuncid;		/* PG_PROC OID of hash func or InvalidOid */
+	Oid			negfuncid;		/* PG_PROC OID of negator of opfuncid, or
+								 * InvalidOid */
 	bool		useOr;			/* true for ANY, false for ALL */
 	Oid			inputcollid;	/* OID of collation that operator should use */
 	List	   *args;			/* the scalar and array operands */
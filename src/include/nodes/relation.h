@@ -102,6 +102,9 @@ typedef struct PlannerGlobal
 	bool		transientPlan;	/* redo plan when TransactionXmin changes? */
 
 	bool		hasRowSecurity; /* row security applied? */
+
+	struct HTAB *statsslot_cache;	/* deconstructed pg_statistic slots, see
+									 * get_variable_statsslot() */
 } PlannerGlobal;
 
 /* macro for fetching the Plan associated with a SubPlan node */
@@ -151,6 +154,13 @@ typedef struct PlannerInfo
 	 */
 	RangeTblEntry **simple_rte_array;	/* rangetable as an array */
 
+	/*
+	 * append_rel_array is the same length as simple_rel_array and holds
+	 * pointers to the AppendRelInfo of each appendrel child relid, or NULL
+	 * for other relids.  It is NULL if append_rel_list is empty.
+	 */
+	struct AppendRelInfo **append_rel_array;
+
 	/*
 	 * all_baserels is a Relids set of all base relids (but not "other"
 	 * relids) in the query; that is, the Relids identifier of the final join
@@ -363,6 +373,8 @@ typedef struct PlannerInfo
  *				(includes both direct and indirect lateral references)
  *		indexlist - list of IndexOptInfo nodes for relation's indexes
  *					(always NIL if it's not a table)
+ *		statlist - list of StatisticExtInfo nodes for the extended statistics
+ *				   built on the relation (always NIL if it's not a table)
  *		pages - number of disk pages in relation (zero if not a table)
  *		tuples - number of tuples in relation (not considering restrictions)
  *		allvisfrac - fraction of disk pages that are marked all-visible
@@ -465,6 +477,7 @@ typedef struct RelOptInfo
 	List	   *lateral_vars;	/* LATERAL Vars and PHVs referenced by rel */
 	Relids		lateral_referencers;	/* rels that reference me laterally */
 	List	   *indexlist;		/* list of IndexOptInfo */
+	List	   *statlist;		/* list of StatisticExtInfo */
 	BlockNumber pages;			/* size estimates derived from pg_class */
 	double		tuples;
 	double		allvisfrac;
@@ -493,7 +506,9 @@ typedef struct RelOptInfo
  *		Per-index information for planning/optimization
  *
  *		indexkeys[], indexcollations[], opfamily[], and opcintype[]
- *		each have ncolumns entries.
+ *		each have ncolumns entries.  Only the first nkeycolumns of them are
+ *		key columns; the rest are INCLUDE columns, which can be returned by
+ *		an index-only scan but have no opfamily and can't be searched on.
  *
  *		sortopfamily[], reverse_sort[], and nulls_first[] likewise have
  *		ncolumns entries, if the index is ordered; but if it is unordered,
@@ -529,6 +544,7 @@ typedef struct IndexOptInfo
 
 	/* index descriptor information */
 	int			ncolumns;		/* number of columns in index */
+	int			nkeycolumns;	/* number of key columns in index */
 	int		   *indexkeys;		/* column numbers of index's keys, or 0 */
 	Oid		   *indexcollations;	/* OIDs of collations of index columns */
 	Oid		   *opfamily;		/* OIDs of operator families for columns */
@@ -559,6 +575,24 @@ typedef struct IndexOptInfo
 	bool		amhasgetbitmap; /* does AM have amgetbitmap interface? */
 } IndexOptInfo;
 
+/*
+ * StatisticExtInfo
+ *		Information about extended statistics for planning/optimization
+ *
+ * Each pg_statistic_ext row is represented by one or more nodes of this
+ * type, or even zero if ANALYZE has not computed them.  There is one node
+ * for each kind of statistics that has actually been built.
+ */
+typedef struct StatisticExtInfo
+{
+	NodeTag		type;
+
+	Oid			statOid;		/* OID of the statistics row */
+	RelOptInfo *rel;			/* back-link to statistic's table */
+	char		kind;			/* statistic kind of this entry */
+	Bitmapset  *keys;			/* attnums of the columns covered */
+} StatisticExtInfo;
+
 
 /*
  * EquivalenceClasses
@@ -1009,6 +1043,25 @@ typedef struct MaterialPath
 	Path	   *subpath;
 } MaterialPath;
 
+/*
+ * MemoizePath represents use of a Memoize plan node, i.e., caching of the
+ * output of a parameterized subpath keyed by the parameter values.
+ * param_exprs are the (outer-relation) expressions the parameters are
+ * computed from, and eq_operators the equality operators used to compare
+ * their values.  calls is the number of times we expect the subpath to be
+ * rescanned, and est_entries the number of distinct keys we expect to keep
+ * in the cache at once (filled in by cost_memoize_rescan).
+ */
+typedef struct MemoizePath
+{
+	Path		path;
+	Path	   *subpath;
+	List	   *eq_operators;	/* OIDs of equality operators for keys */
+	List	   *param_exprs;	/* cache keys */
+	double		calls;			/* expected number of rescans */
+	uint32		est_entries;	/* expected number of cache entries */
+} MemoizePath;
+
 /*
  * UniquePath represents elimination of distinct rows from the output of
  * its subpath.
@@ -101,6 +101,27 @@ extern bool have_join_order_restriction(PlannerInfo *root,
 extern bool have_dangerous_phv(PlannerInfo *root,
 				   Relids outer_relids, Relids inner_params);
 
+/*
+ * joinsearch.c
+ *	  alternative join-order search strategies
+ */
+typedef enum
+{
+	JOIN_SEARCH_GENETIC,		/* GEQO */
+	JOIN_SEARCH_GREEDY			/* greedy_join_search() */
+}	JoinSearchHeuristic;
+
+/* hypergraph_join_search() represents sets of jointree items as uint64 */
+#define HYPERGRAPH_MAX_NODES	64
+
+extern int	hypergraph_join_threshold;
+extern int	join_search_heuristic;
+
+extern RelOptInfo *hypergraph_join_search(PlannerInfo *root,
+					   int levels_needed, List *initial_rels);
+extern RelOptInfo *greedy_join_search(PlannerInfo *root, int levels_needed,
+				   List *initial_rels);
+
 /*
  * equivclass.c
  *	  routines for managing EquivalenceClasses
@@ -172,6 +193,8 @@ typedef enum
 
 extern PathKeysComparison compare_pathkeys(List *keys1, List *keys2);
 extern bool pathkeys_contained_in(List *keys1, List *keys2);
+extern bool pathkeys_count_contained_in(List *keys1, List *keys2,
+							int *n_common);
 extern Path *get_cheapest_path_for_pathkeys(List *paths, List *pathkeys,
 							   Relids required_outer,
 							   CostSelector cost_criterion);
@@ -27,6 +27,11 @@ extern PGDLLIMPORT get_relation_info_hook_type get_relation_info_hook;
 
 extern void get_relation_info(PlannerInfo *root, Oid relationObjectId,
 				  bool inhparent, RelOptInfo *rel);
+extern void get_relation_attr_info(PlannerInfo *root, Oid relationObjectId,
+					   RelOptInfo *rel);
+extern void get_relation_physical_info(PlannerInfo *root,
+						   Oid relationObjectId, bool inhparent,
+						   RelOptInfo *rel);
 
 extern List *infer_arbiter_indexes(PlannerInfo *root);
 
@@ -38,6 +43,9 @@ extern int32 get_relation_data_width(Oid relid, int32 *attr_widths);
 extern bool relation_excluded_by_constraints(PlannerInfo *root,
 								 RelOptInfo *rel, RangeTblEntry *rte);
 
+extern List *get_relation_pruning_constraints(PlannerInfo *root,
+								 RelOptInfo *rel, RangeTblEntry *rte);
+
 extern List *build_physical_tlist(PlannerInfo *root, RelOptInfo *rel);
 
 extern bool has_unique_index(RelOptInfo *rel, AttrNumber attno);
@@ -37,6 +37,11 @@ extern void preprocess_minmax_aggregates(PlannerInfo *root, List *tlist);
 extern Plan *optimize_minmax_aggregates(PlannerInfo *root, List *tlist,
 						   const AggClauseCosts *aggcosts, Path *best_path);
 
+/*
+ * prototypes for plan/planeager.c
+ */
+extern Query *make_eager_aggregate_query(Query *parse);
+
 /*
  * prototypes for plan/createplan.c
  */
@@ -53,6 +58,9 @@ extern RecursiveUnion *make_recursive_union(List *tlist,
 					 List *distinctList, long numGroups);
 extern Sort *make_sort_from_pathkeys(PlannerInfo *root, Plan *lefttree,
 						List *pathkeys, double limit_tuples);
+extern IncrementalSort *make_incrementalsort_from_pathkeys(PlannerInfo *root,
+								   Plan *lefttree, List *pathkeys,
+								   int presortedCols, double limit_tuples);
 extern Sort *make_sort_from_sortclauses(PlannerInfo *root, List *sortcls,
 						   Plan *lefttree);
 extern Sort *make_sort_from_groupcols(PlannerInfo *root, List *groupcls,
@@ -119,6 +119,14 @@
  */
 #define ALIGNOF_BUFFER	32
 
+/*
+ * Alignment required for the memory, file offset and length of I/O on files
+ * opened with O_DIRECT (see direct_io).  4096 satisfies the logical block
+ * size of practically all devices and filesystems; shared and local buffers
+ * are always aligned this way.
+ */
+#define PG_IO_ALIGN_SIZE	4096
+
 /*
  * Disable UNIX sockets for certain operating systems.
  */
@@ -18,8 +18,28 @@
 #endif
 
 /*
- * 64 bit atomics on arm are implemented using kernel fallbacks and might be
- * slow, so disable entirely for now.
- * XXX: We might want to change that at some point for AARCH64
+ * 64 bit atomics on 32 bit arm are implemented using kernel fallbacks and
+ * might be slow, so disable them there.  AARCH64 has native 64 bit atomics;
+ * the compiler builtins use its LSE instructions (casal, ldaddal etc.) when
+ * built for ARMv8.1, or when built with -moutline-atomics and the processor
+ * turns out to support them at runtime, and LL/SC loops otherwise.
  */
+#if !defined(__aarch64__) && !defined(__aarch64)
 #define PG_DISABLE_64_BIT_ATOMICS
+#endif
+
+/*
+ * On AARCH64, ISB makes the processor wait for its pipeline to drain, which
+ * takes long enough to be a useful pause in a spin-wait loop.  YIELD is
+ * a no-op on most implementations.
+ */
+#if !defined(PG_HAVE_SPIN_DELAY) && defined(__GNUC__) && \
+	(defined(__aarch64__) || defined(__aarch64))
+#define PG_HAVE_SPIN_DELAY
+static __inline__ void
+pg_spin_delay_impl(void)
+{
+	__asm__ __volatile__(
+		" isb			\n");
+}
+#endif
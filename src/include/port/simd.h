@@ -0,0 +1,151 @@
+/*-------------------------------------------------------------------------
+ *
+ * simd.h
+ *	  Support for platform-specific vector operations.
+ *
+ * We only make use of instructions that are part of the baseline
+ * instruction set of the target architecture (SSE2 on x86-64, Advanced SIMD
+ * on AArch64), so no runtime check is required.  Wider instruction sets such
+ * as AVX2 would need a CPUID test and function-pointer dispatch, which is not
+ * worth it for the short runs of data these routines are used on.
+ *
+ * Callers must provide a scalar fallback; when USE_NO_SIMD is defined none
+ * of the functions below are available.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/port/simd.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMD_H
+#define SIMD_H
+
+#if (defined(__x86_64__) || defined(_M_AMD64))
+/*
+ * SSE2 instructions are part of the spec for the 64-bit x86 ISA.
+ */
+#include <emmintrin.h>
+#define USE_SSE2
+typedef __m128i Vector8;
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+/*
+ * Advanced SIMD (NEON) instructions are mandatory on AArch64.
+ */
+#include <arm_neon.h>
+#define USE_NEON
+typedef uint8x16_t Vector8;
+
+#else
+#define USE_NO_SIMD
+#endif
+
+#ifndef USE_NO_SIMD
+
+/*
+ * Load a chunk of memory into the given vector.  No alignment is required.
+ */
+static inline Vector8
+vector8_load(const char *s)
+{
+#ifdef USE_SSE2
+	return _mm_loadu_si128((const __m128i *) s);
+#else
+	return vld1q_u8((const uint8_t *) s);
+#endif
+}
+
+/*
+ * Create a vector with all lanes set to the given byte.
+ */
+static inline Vector8
+vector8_broadcast(char c)
+{
+#ifdef USE_SSE2
+	return _mm_set1_epi8(c);
+#else
+	return vdupq_n_u8((uint8_t) c);
+#endif
+}
+
+/*
+ * Compare lanes for equality; each lane of the result is all ones where the
+ * inputs match and zero otherwise.
+ */
+static inline Vector8
+vector8_eq(const Vector8 v1, const Vector8 v2)
+{
+#ifdef USE_SSE2
+	return _mm_cmpeq_epi8(v1, v2);
+#else
+	return vceqq_u8(v1, v2);
+#endif
+}
+
+static inline Vector8
+vector8_or(const Vector8 v1, const Vector8 v2)
+{
+#ifdef USE_SSE2
+	return _mm_or_si128(v1, v2);
+#else
+	return vorrq_u8(v1, v2);
+#endif
+}
+
+static inline Vector8
+vector8_and(const Vector8 v1, const Vector8 v2)
+{
+#ifdef USE_SSE2
+	return _mm_and_si128(v1, v2);
+#else
+	return vandq_u8(v1, v2);
+#endif
+}
+
+/*
+ * Return true if any lane of the vector is nonzero.
+ */
+static inline bool
+vector8_any(const Vector8 v)
+{
+#ifdef USE_SSE2
+	return _mm_movemask_epi8(v) != 0;
+#else
+	return vmaxvq_u8(v) != 0;
+#endif
+}
+
+/*
+ * Return true if any lane of the vector is less than or equal to the given
+ * byte, comparing as unsigned.
+ */
+static inline bool
+vector8_has_le(const Vector8 v, unsigned char c)
+{
+#ifdef USE_SSE2
+	/* there is no unsigned comparison in SSE2, but min(v, c) == v works */
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(c)),
+											v)) != 0;
+#else
+	return vmaxvq_u8(vcleq_u8(v, vdupq_n_u8(c))) != 0;
+#endif
+}
+
+/*
+ * Return true if the high bit is set in any lane of the vector.
+ */
+static inline bool
+vector8_is_highbit_set(const Vector8 v)
+{
+#ifdef USE_SSE2
+	return _mm_movemask_epi8(v) != 0;
+#else
+	return vmaxvq_u8(v) > 0x7F;
+#endif
+}
+
+#endif   /* !USE_NO_SIMD */
+
+#endif   /* SIMD_H */
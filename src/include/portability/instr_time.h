@@ -9,6 +9,12 @@
  * instead.  These macros also give some breathing room to use other
  * high-precision-timing APIs on yet other platforms.
  *
+ * On x86 we can also read the CPU's time-stamp counter, which is much
+ * cheaper than a system call, provided its rate is constant.  That is what
+ * INSTR_TIME_SET_CURRENT_FAST uses, once pg_initialize_timing() has checked
+ * that the counter is invariant and calibrated it; otherwise it is the same
+ * as INSTR_TIME_SET_CURRENT.
+ *
  * The basic data type is instr_time, which all callers should treat as an
  * opaque typedef.  instr_time can store either an absolute time (of
  * unspecified reference time) or an interval.  The operations provided
@@ -20,6 +26,9 @@
  *
  * INSTR_TIME_SET_CURRENT(t)		set t to current time
  *
+ * INSTR_TIME_SET_CURRENT_FAST(t)	set t to current time, cheaply but with
+ *									an unspecified reference time
+ *
  * INSTR_TIME_ADD(x, y)				x += y
  *
  * INSTR_TIME_SUBTRACT(x, y)		x -= y
@@ -34,7 +43,8 @@
  *
  * Note that INSTR_TIME_SUBTRACT and INSTR_TIME_ACCUM_DIFF convert
  * absolute times to intervals.  The INSTR_TIME_GET_xxx operations are
- * only useful on intervals.
+ * only useful on intervals.  Times set by INSTR_TIME_SET_CURRENT_FAST may
+ * only be combined with other such times.
  *
  * When summing multiple measurements, it's recommended to leave the
  * running sum in instr_time form (ie, use INSTR_TIME_ADD or
@@ -56,63 +66,83 @@
 
 #include <sys/time.h>
 
-typedef struct timeval instr_time;
+/*
+ * We keep times as nanoseconds.  INSTR_TIME_SET_CURRENT counts them from the
+ * Unix epoch, like gettimeofday().
+ */
+typedef struct instr_time
+{
+	int64		ticks;			/* in nanoseconds */
+} instr_time;
 
-#define INSTR_TIME_IS_ZERO(t)	((t).tv_usec == 0 && (t).tv_sec == 0)
+#define NS_PER_S	INT64CONST(1000000000)
+#define NS_PER_MS	INT64CONST(1000000)
+#define NS_PER_US	INT64CONST(1000)
 
-#define INSTR_TIME_SET_ZERO(t)	((t).tv_sec = 0, (t).tv_usec = 0)
+static inline instr_time
+pg_gettimeofday_ns(void)
+{
+	instr_time	now;
+	struct timeval tv;
 
-#define INSTR_TIME_SET_CURRENT(t)	gettimeofday(&(t), NULL)
+	gettimeofday(&tv, NULL);
+	now.ticks = (int64) tv.tv_sec * NS_PER_S + (int64) tv.tv_usec * NS_PER_US;
+
+	return now;
+}
+
+#define INSTR_TIME_IS_ZERO(t)	((t).ticks == 0)
+
+#define INSTR_TIME_SET_ZERO(t)	((t).ticks = 0)
+
+#define INSTR_TIME_SET_CURRENT(t)	((t) = pg_gettimeofday_ns())
 
 #define INSTR_TIME_ADD(x,y) \
-	do { \
-		(x).tv_sec += (y).tv_sec; \
-		(x).tv_usec += (y).tv_usec; \
-		/* Normalize */ \
-		while ((x).tv_usec >= 1000000) \
-		{ \
-			(x).tv_usec -= 1000000; \
-			(x).tv_sec++; \
-		} \
-	} while (0)
+	((x).ticks += (y).ticks)
 
 #define INSTR_TIME_SUBTRACT(x,y) \
-	do { \
-		(x).tv_sec -= (y).tv_sec; \
-		(x).tv_usec -= (y).tv_usec; \
-		/* Normalize */ \
-		while ((x).tv_usec < 0) \
-		{ \
-			(x).tv_usec += 1000000; \
-			(x).tv_sec--; \
-		} \
-	} while (0)
+	((x).ticks -= (y).ticks)
 
 #define INSTR_TIME_ACCUM_DIFF(x,y,z) \
-	do { \
-		(x).tv_sec += (y).tv_sec - (z).tv_sec; \
-		(x).tv_usec += (y).tv_usec - (z).tv_usec; \
-		/* Normalize after each add to avoid overflow/underflow of tv_usec */ \
-		while ((x).tv_usec < 0) \
-		{ \
-			(x).tv_usec += 1000000; \
-			(x).tv_sec--; \
-		} \
-		while ((x).tv_usec >= 1000000) \
-		{ \
-			(x).tv_usec -= 1000000; \
-			(x).tv_sec++; \
-		} \
-	} while (0)
+	((x).ticks += (y).ticks - (z).ticks)
 
 #define INSTR_TIME_GET_DOUBLE(t) \
-	(((double) (t).tv_sec) + ((double) (t).tv_usec) / 1000000.0)
+	((double) (t).ticks / NS_PER_S)
 
 #define INSTR_TIME_GET_MILLISEC(t) \
-	(((double) (t).tv_sec * 1000.0) + ((double) (t).tv_usec) / 1000.0)
+	((double) (t).ticks / NS_PER_MS)
 
 #define INSTR_TIME_GET_MICROSEC(t) \
-	(((uint64) (t).tv_sec * (uint64) 1000000) + (uint64) (t).tv_usec)
+	((uint64) ((t).ticks / NS_PER_US))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_INSTR_TIME_TSC 1
+
+/* these are set up by pg_initialize_timing() */
+extern bool pg_timing_use_tsc;
+extern uint64 pg_timing_tsc_base;
+extern double pg_timing_ns_per_tsc;
+
+extern void pg_initialize_timing(void);
+
+static inline instr_time
+pg_tsc_ns(void)
+{
+	instr_time	now;
+
+	if (!pg_timing_use_tsc)
+		return pg_gettimeofday_ns();
+
+	/* count from the calibration, to keep the double arithmetic precise */
+	now.ticks = (int64) ((double) (__builtin_ia32_rdtsc() - pg_timing_tsc_base) *
+						 pg_timing_ns_per_tsc);
+
+	return now;
+}
+
+#define INSTR_TIME_SET_CURRENT_FAST(t)	((t) = pg_tsc_ns())
+#endif   /* x86 */
+
 #else							/* WIN32 */
 
 typedef LARGE_INTEGER instr_time;
@@ -151,4 +181,9 @@ GetTimerFrequency(void)
 }
 #endif   /* WIN32 */
 
+#ifndef HAVE_INSTR_TIME_TSC
+#define INSTR_TIME_SET_CURRENT_FAST(t)	INSTR_TIME_SET_CURRENT(t)
+#define pg_initialize_timing()	((void) 0)
+#endif
+
 #endif   /* INSTR_TIME_H */
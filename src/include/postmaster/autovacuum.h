@@ -14,6 +14,18 @@
 #ifndef AUTOVACUUM_H
 #define AUTOVACUUM_H
 
+#include "fmgr.h"
+#include "storage/block.h"
+
+/*
+ * Other processes can request specific work from autovacuum, identified by
+ * AutoVacuumWorkItem elements.
+ */
+typedef enum
+{
+	AVW_BRINSummarizeRange,
+	AVW_GINCleanPendingList
+} AutoVacuumWorkItemType;
 
 /* GUC variables */
 extern bool autovacuum_start_daemon;
@@ -28,6 +40,7 @@ extern int	autovacuum_freeze_max_age;
 extern int	autovacuum_multixact_freeze_max_age;
 extern int	autovacuum_vac_cost_delay;
 extern int	autovacuum_vac_cost_limit;
+extern int	autovacuum_parallel_workers;
 
 /* autovacuum launcher PID, only valid when worker is shutting down */
 extern int	AutovacuumLauncherPid;
@@ -60,8 +73,14 @@ extern void AutovacuumWorkerIAm(void);
 extern void AutovacuumLauncherIAm(void);
 #endif
 
+extern bool AutoVacuumRequestWork(AutoVacuumWorkItemType type,
+					  Oid relationId, BlockNumber blkno);
+
 /* shared memory stuff */
 extern Size AutoVacuumShmemSize(void);
 extern void AutoVacuumShmemInit(void);
 
+/* monitoring */
+extern Datum pg_stat_get_autovacuum_workers(PG_FUNCTION_ARGS);
+
 #endif   /* AUTOVACUUM_H */
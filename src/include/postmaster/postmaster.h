@@ -17,6 +17,7 @@
 extern bool EnableSSL;
 extern int	ReservedBackends;
 extern int	PostPortNumber;
+extern int	SpareBackends;
 extern int	Unix_socket_permissions;
 extern char *Unix_socket_group;
 extern char *Unix_socket_directories;
@@ -44,6 +45,14 @@ extern int	postmaster_alive_fds[2];
 #define POSTMASTER_FD_OWN		1		/* kept open by postmaster only */
 #endif
 
+/*
+ * Spare backends are handed their client socket over a Unix-domain socket,
+ * and must have been started with fork() alone to have anything to spare.
+ */
+#if defined(HAVE_UNIX_SOCKETS) && !defined(EXEC_BACKEND)
+#define HAVE_SPARE_BACKENDS 1
+#endif
+
 extern const char *progname;
 
 extern void PostmasterMain(int argc, char *argv[]) pg_attribute_noreturn();
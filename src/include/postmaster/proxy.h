@@ -0,0 +1,46 @@
+/*-------------------------------------------------------------------------
+ *
+ * proxy.h
+ *	  Exports from postmaster/proxy.c.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/postmaster/proxy.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _PROXY_H
+#define _PROXY_H
+
+/* The proxy relies on poll() and Unix-domain sockets, and on fork() alone */
+#if defined(HAVE_POLL) && defined(HAVE_UNIX_SOCKETS) && !defined(EXEC_BACKEND)
+#define HAVE_CONNECTION_PROXY 1
+#endif
+
+/* GUC options */
+extern int	ProxyPortNumber;
+extern int	SessionPoolSize;
+extern int	ProxyMaxClients;
+
+/*
+ * Secret that lets the proxy open backends without authenticating again,
+ * generated by the postmaster at startup and inherited by its children.
+ */
+#define PROXY_TOKEN_LEN 32
+extern char ProxyToken[PROXY_TOKEN_LEN + 1];
+
+/* Sockets the proxy accepts clients on, opened by the postmaster */
+#define PROXY_MAXLISTEN 64
+extern pgsocket ProxyListenSocket[PROXY_MAXLISTEN];
+
+extern bool IsConnectionProxy;
+
+/* ----------
+ * Functions called from postmaster
+ * ----------
+ */
+extern int	proxy_start(void);
+extern void proxy_init_token(void);
+
+#endif   /* _PROXY_H */
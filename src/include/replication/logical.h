@@ -40,6 +40,13 @@ typedef struct LogicalDecodingContext
 	OutputPluginCallbacks callbacks;
 	OutputPluginOptions options;
 
+	/*
+	 * Does the output plugin receive large transactions while they are still
+	 * in progress? Set if it provides the stream callbacks; it may clear this
+	 * in its startup callback.
+	 */
+	bool		streaming;
+
 	/*
 	 * User specified options
 	 */
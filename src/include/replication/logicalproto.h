@@ -0,0 +1,133 @@
+/*-------------------------------------------------------------------------
+ *
+ * logicalproto.h
+ *		logical replication protocol
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/include/replication/logicalproto.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef LOGICAL_PROTO_H
+#define LOGICAL_PROTO_H
+
+#include "nodes/bitmapset.h"
+#include "replication/reorderbuffer.h"
+#include "utils/rel.h"
+
+/*
+ * Protocol capabilities
+ *
+ * LOGICALREP_PROTO_VERSION_NUM is our native protocol and the greatest
+ * version we can support.  LOGICALREP_PROTO_MIN_VERSION_NUM is the oldest
+ * version we have backwards compatibility for.  The client requests the
+ * protocol version at connect time.
+ */
+#define LOGICALREP_PROTO_MIN_VERSION_NUM 1
+#define LOGICALREP_PROTO_VERSION_NUM 1
+
+/*
+ * Message types.  The changes of a streamed transaction are framed by
+ * STREAM START and STREAM STOP, and carry the xid of the (sub)transaction
+ * that made them right after the message type.
+ */
+#define LOGICAL_REP_MSG_BEGIN			'B'
+#define LOGICAL_REP_MSG_COMMIT			'C'
+#define LOGICAL_REP_MSG_RELATION		'R'
+#define LOGICAL_REP_MSG_INSERT			'I'
+#define LOGICAL_REP_MSG_UPDATE			'U'
+#define LOGICAL_REP_MSG_DELETE			'D'
+#define LOGICAL_REP_MSG_STREAM_START	'S'
+#define LOGICAL_REP_MSG_STREAM_STOP		'E'
+#define LOGICAL_REP_MSG_STREAM_COMMIT	'c'
+#define LOGICAL_REP_MSG_STREAM_ABORT	'A'
+
+/* Column kinds in tuple data */
+#define LOGICALREP_COLUMN_NULL		'n'
+#define LOGICALREP_COLUMN_UNCHANGED 'u'
+#define LOGICALREP_COLUMN_TEXT		't'
+#define LOGICALREP_COLUMN_BINARY	'b'
+
+/* Tuple coming via logical replication. */
+typedef struct LogicalRepTupleData
+{
+	/* column values, in text or binary form; unused for 'n' and 'u' */
+	StringInfoData *colvalues;
+	/* one of the LOGICALREP_COLUMN_* kinds, per column */
+	char	   *colstatus;
+	int			ncols;
+} LogicalRepTupleData;
+
+typedef uint32 LogicalRepRelId;
+
+/* Relation information */
+typedef struct LogicalRepRelation
+{
+	/* Info coming from the remote side. */
+	LogicalRepRelId remoteid;	/* unique id of the relation */
+	char	   *nspname;		/* schema name */
+	char	   *relname;		/* relation name */
+	int			natts;			/* number of columns */
+	char	  **attnames;		/* column names */
+	Oid		   *atttyps;		/* column types */
+	char		replident;		/* replica identity */
+	Bitmapset  *attkeys;		/* Bitmap of key columns */
+} LogicalRepRelation;
+
+/* Transaction info */
+typedef struct LogicalRepBeginData
+{
+	XLogRecPtr	final_lsn;
+	TimestampTz committime;
+	TransactionId xid;
+} LogicalRepBeginData;
+
+typedef struct LogicalRepCommitData
+{
+	XLogRecPtr	commit_lsn;
+	XLogRecPtr	end_lsn;
+	TimestampTz committime;
+} LogicalRepCommitData;
+
+extern void logicalrep_write_begin(StringInfo out, ReorderBufferTXN *txn);
+extern void logicalrep_read_begin(StringInfo in,
+					  LogicalRepBeginData *begin_data);
+extern void logicalrep_write_commit(StringInfo out, ReorderBufferTXN *txn,
+						XLogRecPtr commit_lsn);
+extern void logicalrep_read_commit(StringInfo in,
+					   LogicalRepCommitData *commit_data);
+extern void logicalrep_write_insert(StringInfo out, TransactionId xid,
+						Relation rel, HeapTuple newtuple, bool binary);
+extern LogicalRepRelId logicalrep_read_insert(StringInfo in,
+					   LogicalRepTupleData *newtup);
+extern void logicalrep_write_update(StringInfo out, TransactionId xid,
+						Relation rel, HeapTuple oldtuple,
+						HeapTuple newtuple, bool binary);
+extern LogicalRepRelId logicalrep_read_update(StringInfo in,
+					   bool *has_oldtuple, LogicalRepTupleData *oldtup,
+					   LogicalRepTupleData *newtup);
+extern void logicalrep_write_delete(StringInfo out, TransactionId xid,
+						Relation rel, HeapTuple oldtuple, bool binary);
+extern LogicalRepRelId logicalrep_read_delete(StringInfo in,
+					   LogicalRepTupleData *oldtup);
+extern void logicalrep_write_rel(StringInfo out, TransactionId xid,
+					 Relation rel);
+extern LogicalRepRelation *logicalrep_read_rel(StringInfo in);
+
+extern void logicalrep_write_stream_start(StringInfo out, TransactionId xid,
+							  bool first_segment);
+extern TransactionId logicalrep_read_stream_start(StringInfo in,
+							 bool *first_segment);
+extern void logicalrep_write_stream_stop(StringInfo out);
+extern void logicalrep_write_stream_commit(StringInfo out,
+							   ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
+extern TransactionId logicalrep_read_stream_commit(StringInfo in,
+							  LogicalRepCommitData *commit_data);
+extern void logicalrep_write_stream_abort(StringInfo out, TransactionId xid,
+							  TransactionId subxid);
+extern void logicalrep_read_stream_abort(StringInfo in, TransactionId *xid,
+							 TransactionId *subxid);
+
+#endif   /* LOGICAL_PROTO_H */
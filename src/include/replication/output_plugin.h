@@ -73,6 +73,53 @@ typedef void (*LogicalDecodeCommitCB) (
 												   ReorderBufferTXN *txn,
 												   XLogRecPtr commit_lsn);
 
+/*
+ * Called when a block of changes of a large, still in-progress transaction
+ * begins to be streamed. Optional, as are the other stream callbacks; a
+ * plugin providing all of them receives such transactions in blocks of
+ * changes, delimited by stream_start and stream_stop, followed eventually by
+ * stream_commit or stream_abort, instead of only when they commit.
+ */
+typedef void (*LogicalDecodeStreamStartCB) (
+											 struct LogicalDecodingContext *,
+													   ReorderBufferTXN *txn);
+
+/*
+ * Called when a streamed block of changes ends.
+ */
+typedef void (*LogicalDecodeStreamStopCB) (
+											 struct LogicalDecodingContext *,
+													  ReorderBufferTXN *txn);
+
+/*
+ * Callback for every individual change in a streamed block. txn is the
+ * (sub-)transaction that made the change.
+ */
+typedef void (*LogicalDecodeStreamChangeCB) (
+											 struct LogicalDecodingContext *,
+														 ReorderBufferTXN *txn,
+														 Relation relation,
+												 ReorderBufferChange *change
+);
+
+/*
+ * Called when a streamed transaction, or one of its subtransactions, aborts.
+ * The changes already streamed for it are to be discarded.
+ */
+typedef void (*LogicalDecodeStreamAbortCB) (
+											 struct LogicalDecodingContext *,
+														ReorderBufferTXN *txn,
+													   XLogRecPtr abort_lsn);
+
+/*
+ * Called when a streamed transaction commits, after its remaining changes
+ * have been streamed.
+ */
+typedef void (*LogicalDecodeStreamCommitCB) (
+											 struct LogicalDecodingContext *,
+														 ReorderBufferTXN *txn,
+													  XLogRecPtr commit_lsn);
+
 /*
  * Filter changes by origin.
  */
@@ -98,6 +145,12 @@ typedef struct OutputPluginCallbacks
 	LogicalDecodeCommitCB commit_cb;
 	LogicalDecodeFilterByOriginCB filter_by_origin_cb;
 	LogicalDecodeShutdownCB shutdown_cb;
+	/* streaming of in-progress transactions */
+	LogicalDecodeStreamStartCB stream_start_cb;
+	LogicalDecodeStreamStopCB stream_stop_cb;
+	LogicalDecodeStreamChangeCB stream_change_cb;
+	LogicalDecodeStreamAbortCB stream_abort_cb;
+	LogicalDecodeStreamCommitCB stream_commit_cb;
 } OutputPluginCallbacks;
 
 void		OutputPluginPrepareWrite(struct LogicalDecodingContext *ctx, bool last_write);
@@ -20,17 +20,17 @@
 #include "utils/snapshot.h"
 #include "utils/timestamp.h"
 
+/* GUC variable */
+extern PGDLLIMPORT int logical_decoding_work_mem;
+
 /* an individual tuple, stored in one chunk of memory */
 typedef struct ReorderBufferTupleBuf
 {
-	/* position in preallocated list */
-	slist_node	node;
-
 	/* tuple header, the interesting bit for users of logical decoding */
 	HeapTupleData tuple;
 
-	/* pre-allocated size of tuple buffer, different from tuple size */
-	Size	alloc_tuple_size;
+	/* allocated size of tuple buffer, can differ from tuple size */
+	Size		alloc_tuple_size;
 
 	/* actual tuple data follows */
 } ReorderBufferTupleBuf;
@@ -80,6 +80,9 @@ typedef struct ReorderBufferChange
 
 	RepOriginId origin_id;
 
+	/* The (sub-)transaction this change belongs to. */
+	struct ReorderBufferTXN *txn;
+
 	/*
 	 * Context data for the change. Which part of the union is valid depends
 	 * on action.
@@ -146,6 +149,17 @@ typedef struct ReorderBufferTXN
 	 */
 	bool		is_known_as_subxact;
 
+	/*
+	 * Toplevel transaction of a known subxact, NULL otherwise.
+	 */
+	struct ReorderBufferTXN *toptxn;
+
+	/*
+	 * Have some of the changes of this toplevel transaction already been
+	 * passed to the output plugin before its commit was read?
+	 */
+	bool		is_streamed;
+
 	/*
 	 * LSN of the first data carrying, WAL record with knowledge about this
 	 * xid. This is allowed to *not* be first record adorned with this xid, if
@@ -193,6 +207,12 @@ typedef struct ReorderBufferTXN
 	Snapshot	base_snapshot;
 	XLogRecPtr	base_snapshot_lsn;
 
+	/*
+	 * Snapshot (and command id) in effect at the end of the last streamed
+	 * block of changes, or NULL if the transaction hasn't been streamed.
+	 */
+	Snapshot	snapshot_now;
+
 	/*
 	 * How many ReorderBufferChange's do we have in this txn.
 	 *
@@ -206,6 +226,13 @@ typedef struct ReorderBufferTXN
 	 */
 	uint64		nentries_mem;
 
+	/*
+	 * Memory used by the in-memory changes of this transaction, and for a
+	 * toplevel transaction, by those of its known subtransactions as well.
+	 */
+	Size		size;
+	Size		total_size;
+
 	/*
 	 * List of ReorderBufferChange structs, including new Snapshots and new
 	 * CommandIds
@@ -277,6 +304,28 @@ typedef void (*ReorderBufferCommitCB) (
 												   ReorderBufferTXN *txn,
 												   XLogRecPtr commit_lsn);
 
+/* stream start callback signature */
+typedef void (*ReorderBufferStreamStartCB) (
+														ReorderBuffer *rb,
+														ReorderBufferTXN *txn);
+
+/* stream stop callback signature */
+typedef void (*ReorderBufferStreamStopCB) (
+													   ReorderBuffer *rb,
+													   ReorderBufferTXN *txn);
+
+/* stream abort callback signature */
+typedef void (*ReorderBufferStreamAbortCB) (
+														ReorderBuffer *rb,
+														ReorderBufferTXN *txn,
+														XLogRecPtr abort_lsn);
+
+/* stream commit callback signature */
+typedef void (*ReorderBufferStreamCommitCB) (
+														 ReorderBuffer *rb,
+														 ReorderBufferTXN *txn,
+														 XLogRecPtr commit_lsn);
+
 struct ReorderBuffer
 {
 	/*
@@ -304,6 +353,17 @@ struct ReorderBuffer
 	ReorderBufferApplyChangeCB apply_change;
 	ReorderBufferCommitCB commit;
 
+	/*
+	 * Callbacks to pass the changes of large transactions to the output
+	 * plugin while they are still in progress. Streaming is disabled if
+	 * stream_start is NULL.
+	 */
+	ReorderBufferStreamStartCB stream_start;
+	ReorderBufferStreamStopCB stream_stop;
+	ReorderBufferApplyChangeCB stream_change;
+	ReorderBufferStreamAbortCB stream_abort;
+	ReorderBufferStreamCommitCB stream_commit;
+
 	/*
 	 * Pointer that will be passed untouched to the callbacks.
 	 */
@@ -315,26 +375,14 @@ struct ReorderBuffer
 	MemoryContext context;
 
 	/*
-	 * Data structure slab cache.
-	 *
-	 * We allocate/deallocate some structures very frequently, to avoid bigger
-	 * overhead we cache some unused ones here.
-	 *
-	 * The maximum number of cached entries is controlled by const variables
-	 * on top of reorderbuffer.c
+	 * Memory contexts for specific types objects
 	 */
+	MemoryContext change_context;
+	MemoryContext txn_context;
+	MemoryContext tup_context;
 
-	/* cached ReorderBufferTXNs */
-	dlist_head	cached_transactions;
-	Size		nr_cached_transactions;
-
-	/* cached ReorderBufferChanges */
-	dlist_head	cached_changes;
-	Size		nr_cached_changes;
-
-	/* cached ReorderBufferTupleBufs */
-	slist_head	cached_tuplebufs;
-	Size		nr_cached_tuplebufs;
+	/* memory used by the in-memory changes of all transactions */
+	Size		size;
 
 	XLogRecPtr	current_restart_decoding_lsn;
 
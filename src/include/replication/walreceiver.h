@@ -146,6 +146,13 @@ extern PGDLLIMPORT walrcv_send_type walrcv_send;
 typedef void (*walrcv_disconnect_type) (void);
 extern PGDLLIMPORT walrcv_disconnect_type walrcv_disconnect;
 
+/* hooks used by logical replication apply workers */
+typedef void (*walrcv_connect_logical_type) (char *conninfo, char *appname);
+extern PGDLLIMPORT walrcv_connect_logical_type walrcv_connect_logical;
+
+typedef void (*walrcv_startstreaming_logical_type) (char *slotname, XLogRecPtr startpoint, char *options);
+extern PGDLLIMPORT walrcv_startstreaming_logical_type walrcv_startstreaming_logical;
+
 /* prototypes for functions in walreceiver.c */
 extern void WalReceiverMain(void) pg_attribute_noreturn();
 
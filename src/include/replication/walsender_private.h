@@ -47,6 +47,14 @@ typedef struct WalSnd
 	XLogRecPtr	flush;
 	XLogRecPtr	apply;
 
+	/*
+	 * How long it took, at the latest reply, for WAL we sent to be written,
+	 * flushed and applied by the standby, in microseconds; -1 if unknown.
+	 */
+	int64		writeLag;
+	int64		flushLag;
+	int64		applyLag;
+
 	/* Protects shared variables shown above. */
 	slock_t		mutex;
 
@@ -0,0 +1,101 @@
+/*-------------------------------------------------------------------------
+ *
+ * worker_internal.h
+ *	  Internal headers shared by logical replication workers.
+ *
+ * Portions Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * src/include/replication/worker_internal.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef WORKER_INTERNAL_H
+#define WORKER_INTERNAL_H
+
+#include "catalog/pg_subscription.h"
+#include "datatype/timestamp.h"
+#include "lib/stringinfo.h"
+#include "replication/logicalproto.h"
+#include "storage/lock.h"
+#include "storage/proc.h"
+
+/*
+ * Shared memory slot of a leader apply worker, one per running
+ * subscription.  The parallel apply workers a leader starts don't have
+ * slots of their own.
+ */
+typedef struct LogicalRepWorker
+{
+	/* Time at which this worker was launched. */
+	TimestampTz launch_time;
+
+	/* Indicates if this slot is used or free. */
+	bool		in_use;
+
+	/* Increased every time the slot is taken by new worker. */
+	uint16		generation;
+
+	/* Pointer to proc array. NULL if not running. */
+	PGPROC	   *proc;
+
+	/* Database id to connect to. */
+	Oid			dbid;
+
+	/* User to use for connection (will be same as owner of subscription). */
+	Oid			userid;
+
+	/* Subscription id for the worker. */
+	Oid			subid;
+} LogicalRepWorker;
+
+/*
+ * The session-level locks taken on a remote transaction applied by a
+ * parallel apply worker, see applyparallel.c.
+ */
+#define PARALLEL_APPLY_LOCK_STREAM	0
+#define PARALLEL_APPLY_LOCK_XACT	1
+
+/* Main memory context for apply worker. Permanent during worker lifetime. */
+extern MemoryContext ApplyContext;
+
+/* Memory context for the message being applied, reset after each one. */
+extern MemoryContext ApplyMessageContext;
+
+/* Worker and subscription objects. */
+extern Subscription *MySubscription;
+extern LogicalRepWorker *MyLogicalRepWorker;
+
+extern bool in_remote_transaction;
+extern bool am_parallel_apply_worker;
+
+/* launcher.c */
+extern void logicalrep_worker_attach(int slot);
+extern LogicalRepWorker *logicalrep_worker_find(Oid subid, bool only_running);
+extern void logicalrep_worker_launch(Oid dbid, Oid subid, const char *subname,
+						 Oid userid);
+extern void logicalrep_worker_stop(Oid subid);
+
+/* worker.c */
+extern void ApplyWorkerMain(Datum main_arg);
+extern void apply_dispatch(StringInfo s);
+
+/* applyparallel.c, in the leader apply worker */
+extern bool pa_send_stream_start(TransactionId xid, bool first_segment,
+					 StringInfo s);
+extern void pa_send_data(TransactionId xid, StringInfo s);
+extern void pa_send_stream_stop(TransactionId xid, StringInfo s);
+extern bool pa_send_stream_abort(TransactionId xid, TransactionId subxid,
+					 StringInfo s);
+extern bool pa_send_stream_commit(TransactionId xid, StringInfo s,
+					  XLogRecPtr *local_end);
+extern void pa_shutdown_workers(void);
+
+/* applyparallel.c, in a parallel apply worker */
+extern void ParallelApplyWorkerMain(Datum main_arg);
+extern void pa_apply_stream_start(TransactionId xid, bool first_segment);
+extern void pa_apply_stream_stop(void);
+extern void pa_start_subtrans(TransactionId xid);
+extern void pa_apply_stream_abort(TransactionId xid, TransactionId subxid);
+extern void pa_apply_stream_commit(LogicalRepCommitData *commit_data);
+
+#endif   /* WORKER_INTERNAL_H */
@@ -0,0 +1,96 @@
+/*-------------------------------------------------------------------------
+ *
+ * extended_stats_internal.h
+ *	  POSTGRES extended statistics internal declarations
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/include/statistics/extended_stats_internal.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXTENDED_STATS_INTERNAL_H
+#define EXTENDED_STATS_INTERNAL_H
+
+#include "statistics/statistics.h"
+#include "utils/sortsupport.h"
+
+/*
+ * The sample rows of one statistics object, taken apart into one array of
+ * values per column of the object (in the ascending attnum order of
+ * stxkeys), together with what we need to know about the column types to
+ * sort, compare and copy the values.
+ */
+typedef struct StatsBuildData
+{
+	int			numrows;		/* number of sample rows */
+	int			nattnums;		/* number of columns */
+	AttrNumber *attnums;		/* column numbers */
+	Oid		   *types;			/* column data types */
+	Oid		   *collations;		/* column collations */
+	Oid		   *ltopers;		/* "<" operators to sort the values by */
+	int16	   *typlens;		/* typlen of each column type */
+	bool	   *typbyvals;		/* typbyval of each column type */
+	Datum	  **values;			/* values[column][row] */
+	bool	  **nulls;			/* nulls[column][row] */
+} StatsBuildData;
+
+/* one sample row (or a group of equal rows), restricted to some columns */
+typedef struct SortItem
+{
+	Datum	   *values;
+	bool	   *isnull;
+	int			count;
+} SortItem;
+
+/* multi-sort */
+typedef struct MultiSortSupportData
+{
+	int			ndims;			/* number of dimensions */
+	/* sort support data for each dimension: */
+	SortSupportData ssup[FLEXIBLE_ARRAY_MEMBER];
+} MultiSortSupportData;
+
+typedef MultiSortSupportData *MultiSortSupport;
+
+extern MultiSortSupport multi_sort_init(int ndims);
+extern void multi_sort_add_dimension(MultiSortSupport mss, int sortdim,
+						 Oid oper, Oid collation);
+extern int	multi_sort_compare(const void *a, const void *b, void *arg);
+extern int multi_sort_compare_dim(int dim, const SortItem *a,
+					   const SortItem *b, MultiSortSupport mss);
+extern int multi_sort_compare_dims(int start, int end, const SortItem *a,
+						const SortItem *b, MultiSortSupport mss);
+extern SortItem *build_sorted_items(StatsBuildData *data, int ndims,
+				   const int *dims, MultiSortSupport *mss);
+
+extern bool statext_is_compatible_clause(Node *clause, Index relid,
+							 bool eqonly, AttrNumber *attnum);
+
+extern MVNDistinct *statext_ndistinct_build(double totalrows,
+						StatsBuildData *data);
+extern bytea *statext_ndistinct_serialize(MVNDistinct *ndistinct);
+extern MVNDistinct *statext_ndistinct_deserialize(bytea *data);
+
+extern MVDependencies *statext_dependencies_build(StatsBuildData *data);
+extern bytea *statext_dependencies_serialize(MVDependencies *dependencies);
+extern MVDependencies *statext_dependencies_deserialize(bytea *data);
+extern Selectivity dependencies_clauselist_selectivity(PlannerInfo *root,
+									List *clauses, int varRelid,
+									JoinType jointype,
+									SpecialJoinInfo *sjinfo,
+									RelOptInfo *rel,
+									Bitmapset **estimatedclauses);
+
+extern MCVList *statext_mcv_build(StatsBuildData *data, int stattarget);
+extern bytea *statext_mcv_serialize(MCVList *mcvlist);
+extern MCVList *statext_mcv_deserialize(bytea *data);
+extern Selectivity mcv_clauselist_selectivity(PlannerInfo *root,
+						   StatisticExtInfo *stat, List *clauses,
+						   RelOptInfo *rel,
+						   Selectivity *basesel, Selectivity *totalsel);
+
+#endif   /* EXTENDED_STATS_INTERNAL_H */
@@ -16,6 +16,7 @@
 #define BUFMGR_INTERNALS_H
 
 #include "storage/buf.h"
+#include "storage/bufmgr.h"
 #include "storage/latch.h"
 #include "storage/lwlock.h"
 #include "storage/shmem.h"
@@ -40,6 +41,8 @@
 #define BM_CHECKPOINT_NEEDED	(1 << 7)		/* must write for checkpoint */
 #define BM_PERMANENT			(1 << 8)		/* permanent relation (not
 												 * unlogged) */
+#define BM_PROBATION			(1 << 9)		/* not used again since read
+												 * in, with the 2Q policy */
 
 typedef bits16 BufFlags;
 
@@ -220,8 +223,46 @@ typedef union BufferDescPadded
 #define UnlockBufHdr(bufHdr)	SpinLockRelease(&(bufHdr)->buf_hdr_lock)
 
 
+/*
+ * The PendingWriteback & WritebackContext structure are used to keep
+ * information about pending flush requests to be issued to the OS.
+ */
+typedef struct PendingWriteback
+{
+	/* could store different types of pending flushes here */
+	BufferTag	tag;
+} PendingWriteback;
+
+/* struct forward declared in bufmgr.h */
+typedef struct WritebackContext
+{
+	/* pointer to the max number of writeback requests to coalesce */
+	int		   *max_pending;
+
+	/* current number of pending writeback requests */
+	int			nr_pending;
+
+	/* pending requests */
+	PendingWriteback pending_writebacks[WRITEBACK_MAX_PENDING_FLUSHES];
+} WritebackContext;
+
+/*
+ * Entry of the array of buffers a checkpoint has to write, which BufferSync
+ * sorts to write them in file order.
+ */
+typedef struct CkptSortItem
+{
+	Oid			tsId;
+	Oid			relNode;
+	ForkNumber	forkNum;
+	BlockNumber blockNum;
+	int			buf_id;
+} CkptSortItem;
+
+
 /* in buf_init.c */
 extern PGDLLIMPORT BufferDescPadded *BufferDescriptors;
+extern CkptSortItem *CkptBufferIds;
 
 /* in localbuf.c */
 extern BufferDesc *LocalBufferDescriptors;
@@ -231,9 +272,16 @@ extern BufferDesc *LocalBufferDescriptors;
  * Internal routines: only called by bufmgr
  */
 
+/* bufmgr.c */
+extern void WritebackContextInit(WritebackContext *context, int *max_pending);
+extern void IssuePendingWritebacks(WritebackContext *context);
+extern void ScheduleBufferTagForWriteback(WritebackContext *context,
+							  BufferTag *tag);
+
 /* freelist.c */
 extern volatile BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy);
 extern void StrategyFreeBuffer(volatile BufferDesc *buf);
+extern bool StrategyHaveFreeBuffer(void);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 					 volatile BufferDesc *buf);
 
@@ -242,12 +290,26 @@ extern void StrategyNotifyBgWriter(int bgwprocno);
 
 extern Size StrategyShmemSize(void);
 extern void StrategyInitialize(bool init);
+extern void StrategyPlaceBuffers(char *blocks);
+extern void StrategyAdjustProbation(volatile BufferDesc *buf, int delta);
+extern void StrategyRememberEvicted(uint32 hashcode);
+extern bool StrategyWasEvicted(uint32 hashcode);
+extern int	StrategyNumPartitions(void);
+extern bool StrategyBufferIsActive(int buf_id);
+extern int	StrategyActiveBuffers(void);
+extern void StrategySetActiveBuffers(int nbuffers);
+extern void StrategyReleaseInactiveBuffers(void);
+extern void StrategyGetPartitionStats(int partno, int *first_buffer,
+						  int *num_buffers, int *node,
+						  uint32 *complete_passes, uint32 *num_allocs,
+						  uint32 *num_remote_allocs);
 
 /* buf_table.c */
 extern Size BufTableShmemSize(int size);
 extern void InitBufTable(int size);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
+extern int	BufTableLookupUnlocked(BufferTag *tagPtr, uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
 extern void BufTableDelete(BufferTag *tagPtr, uint32 hashcode);
 
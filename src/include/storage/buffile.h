@@ -30,6 +30,9 @@
 
 typedef struct BufFile BufFile;
 
+/* GUC variable */
+extern bool temp_file_compression;
+
 /*
  * prototypes for functions in buffile.c
  */
@@ -41,5 +44,6 @@ extern size_t BufFileWrite(BufFile *file, void *ptr, size_t size);
 extern int	BufFileSeek(BufFile *file, int fileno, off_t offset, int whence);
 extern void BufFileTell(BufFile *file, int *fileno, off_t *offset);
 extern int	BufFileSeekBlock(BufFile *file, long blknum);
+extern void BufFilePrefetchBlock(BufFile *file, long blknum, int nblocks);
 
 #endif   /* BUFFILE_H */
@@ -48,16 +48,59 @@ typedef enum
 /* in globals.c ... this duplicates miscadmin.h */
 extern PGDLLIMPORT int NBuffers;
 
+/* forward declared, to avoid having to expose buf_internals.h here */
+struct WritebackContext;
+
 /* in bufmgr.c */
 extern bool zero_damaged_pages;
 extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
 extern bool track_io_timing;
 extern int	target_prefetch_pages;
+extern int	io_combine_limit;
+
+/*
+ * Limits for io_combine_limit, the number of consecutive blocks ReadBuffers
+ * reads with one system call.  The maximum must not exceed FILE_MAX_READV.
+ */
+#define DEFAULT_IO_COMBINE_LIMIT	16
+#define MAX_IO_COMBINE_LIMIT		32
+
+extern int	checkpoint_flush_after;
+extern int	backend_flush_after;
+extern int	bgwriter_flush_after;
+
+/*
+ * Defaults for the *_flush_after settings, in blocks.  Writeback hints only
+ * work with sync_file_range(), so default to off elsewhere.
+ */
+#ifdef HAVE_SYNC_FILE_RANGE
+#define DEFAULT_CHECKPOINT_FLUSH_AFTER 32
+#define DEFAULT_BGWRITER_FLUSH_AFTER 64
+#else
+#define DEFAULT_CHECKPOINT_FLUSH_AFTER 0
+#define DEFAULT_BGWRITER_FLUSH_AFTER 0
+#endif
+#define DEFAULT_BACKEND_FLUSH_AFTER 0
+
+/* upper limit for all of the above */
+#define WRITEBACK_MAX_PENDING_FLUSHES 256
 
 /* in buf_init.c */
 extern PGDLLIMPORT char *BufferBlocks;
 
+/* in freelist.c */
+extern int	buffer_partitions;
+extern int	buffer_replacement_policy;
+extern int	active_shared_buffers;
+
+/* Possible values for buffer_replacement_policy */
+typedef enum
+{
+	BUFFER_REPLACEMENT_CLOCK,	/* plain clock sweep */
+	BUFFER_REPLACEMENT_2Q		/* 2Q-like, scan resistant */
+}	BufferReplacementPolicy;
+
 /* in localbuf.c */
 extern PGDLLIMPORT int NLocBuffer;
 extern PGDLLIMPORT Block *LocalBufferBlockPointers;
@@ -146,6 +189,9 @@ extern PGDLLIMPORT int32 *LocalRefCount;
  */
 extern void PrefetchBuffer(Relation reln, ForkNumber forkNum,
 			   BlockNumber blockNum);
+extern bool PrefetchSharedBuffer(struct SMgrRelationData *smgr_reln,
+					 char relpersistence, ForkNumber forkNum,
+					 BlockNumber blockNum);
 extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
 extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 				   BlockNumber blockNum, ReadBufferMode mode,
@@ -153,6 +199,13 @@ extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 extern Buffer ReadBufferWithoutRelcache(RelFileNode rnode,
 						  ForkNumber forkNum, BlockNumber blockNum,
 						  ReadBufferMode mode, BufferAccessStrategy strategy);
+extern Buffer StartReadBuffer(Relation reln, ForkNumber forkNum,
+				BlockNumber blockNum, BufferAccessStrategy strategy);
+extern void WaitReadBuffer(Buffer buffer);
+extern void CompleteAsyncReads(void);
+extern void ReadBuffers(Relation reln, ForkNumber forkNum,
+			BlockNumber blockNum, int nblocks,
+			BufferAccessStrategy strategy, Buffer *buffers);
 extern void ReleaseBuffer(Buffer buffer);
 extern void UnlockReleaseBuffer(Buffer buffer);
 extern void MarkBufferDirty(Buffer buffer);
@@ -172,9 +225,10 @@ extern BlockNumber RelationGetNumberOfBlocksInFork(Relation relation,
 extern void FlushOneBuffer(Buffer buffer);
 extern void FlushRelationBuffers(Relation rel);
 extern void FlushDatabaseBuffers(Oid dbid);
-extern void DropRelFileNodeBuffers(RelFileNodeBackend rnode,
+extern void DropRelFileNodeBuffers(struct SMgrRelationData *smgr_reln,
 					   ForkNumber forkNum, BlockNumber firstDelBlock);
-extern void DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes);
+extern void DropRelFileNodesAllBuffers(struct SMgrRelationData **smgr_reln,
+						   int nnodes);
 extern void DropDatabaseBuffers(Oid dbid);
 
 #define RelationGetNumberOfBlocks(reln) \
@@ -202,7 +256,8 @@ extern bool HoldingBufferPinThatDelaysRecovery(void);
 extern void AbortBufferIO(void);
 
 extern void BufmgrCommit(void);
-extern bool BgBufferSync(void);
+extern bool BgBufferSync(struct WritebackContext *wb_context);
+extern bool AdjustActiveBuffers(void);
 
 extern void AtProcExit_LocalBuffers(void);
 
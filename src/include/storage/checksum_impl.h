@@ -91,6 +91,8 @@
  * largest state that fits into architecturally visible x86 SSE registers while
  * leaving some free registers for intermediate values. For future processors
  * with 256bit vector registers this will leave some performance on the table.
+ * (The backend recovers some of it by also compiling the algorithm for AVX2
+ * and AVX-512, and choosing among them at runtime; see checksum.c.)
  * When vectorization is not available it might be beneficial to restructure
  * the computation to calculate a subset of the columns at a time and perform
  * multiple passes to avoid register spilling. This optimization opportunity
@@ -131,11 +133,25 @@ do { \
 	(checksum) = __tmp * FNV_PRIME ^ (__tmp >> 17); \
 } while (0)
 
+/*
+ * The includer can define PG_CHECKSUM_BLOCK_ATTRIBUTES, to have
+ * pg_checksum_block inlined into variants of it compiled for different
+ * instruction sets, and PG_CHECKSUM_BLOCK, to have pg_checksum_page call one
+ * of those instead.
+ */
+#ifndef PG_CHECKSUM_BLOCK_ATTRIBUTES
+#define PG_CHECKSUM_BLOCK_ATTRIBUTES
+#endif
+
+#ifndef PG_CHECKSUM_BLOCK
+#define PG_CHECKSUM_BLOCK(data, size) pg_checksum_block(data, size)
+#endif
+
 /*
  * Block checksum algorithm.  The data argument must be aligned on a 4-byte
  * boundary.
  */
-static uint32
+static PG_CHECKSUM_BLOCK_ATTRIBUTES uint32
 pg_checksum_block(char *data, uint32 size)
 {
 	uint32		sums[N_SUMS];
@@ -193,7 +209,7 @@ pg_checksum_page(char *page, BlockNumber blkno)
 	 */
 	save_checksum = phdr->pd_checksum;
 	phdr->pd_checksum = 0;
-	checksum = pg_checksum_block(page, BLCKSZ);
+	checksum = PG_CHECKSUM_BLOCK(page, BLCKSZ);
 	phdr->pd_checksum = save_checksum;
 
 	/* Mix in the block number to detect transposed pages */
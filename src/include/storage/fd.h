@@ -51,8 +51,26 @@ typedef char *FileName;
 typedef int File;
 
 
-/* GUC parameter */
+/* possible values for io_method */
+typedef enum IOMethod
+{
+	IO_METHOD_SYNC,				/* read right away when asked to start */
+	IO_METHOD_IO_URING			/* submit reads to a per-process io_uring */
+} IOMethod;
+
+/* maximum number of asynchronous reads a process can have in progress */
+#define FILE_IO_MAX_INFLIGHT	32
+
+/* maximum number of buffers FileReadV can read into */
+#define FILE_MAX_READV			32
+
+/* maximum number of buffers FileWriteV can write out */
+#define FILE_MAX_WRITEV			32
+
+/* GUC parameters */
 extern int	max_files_per_process;
+extern int	io_method;
+extern bool direct_io;
 
 /*
  * This is private to fd.c, but exported for save/restore_backend_variables()
@@ -67,13 +85,22 @@ extern int	max_safe_fds;
 /* Operations on virtual Files --- equivalent to Unix kernel file ops */
 extern File PathNameOpenFile(FileName fileName, int fileFlags, int fileMode);
 extern File OpenTemporaryFile(bool interXact);
+extern File OpenTablespaceTemporaryFile(Oid tblspcOid);
 extern void FileClose(File file);
 extern int	FilePrefetch(File file, off_t offset, int amount);
+extern int	FileDropCache(File file, off_t offset, off_t amount);
+extern void FileWriteback(File file, off_t offset, off_t nbytes);
 extern int	FileRead(File file, char *buffer, int amount);
+extern int	FileReadV(File file, char **buffers, int nbuffers, int amount);
+extern bool FileAsyncReadsAvailable(void);
+extern int	FileStartRead(File file, char *buffer, int amount, off_t offset);
+extern int	FileWaitRead(int handle);
 extern int	FileWrite(File file, char *buffer, int amount);
+extern int	FileWriteV(File file, char **buffers, int nbuffers, int amount);
 extern int	FileSync(File file);
 extern off_t FileSeek(File file, off_t offset, int whence);
 extern int	FileTruncate(File file, off_t offset);
+extern int	FileZero(File file, off_t offset, off_t amount);
 extern char *FilePathName(File file);
 
 /* Operations that allow use of regular stdio --- USE WITH CAUTION */
@@ -26,6 +26,7 @@
  * subid is the subtransaction that opened the desc (or currently owns it)
  * offset is the current seek offset within the LO
  * flags contains some flag bits
+ * rabuf etc. hold data read ahead of the caller, for read-only descriptors
  *
  * NOTE: in current usage, flag bit IFS_RDLOCK is *always* set, and we don't
  * bother to test for it.  Permission checks are made at first read or write
@@ -43,6 +44,12 @@ typedef struct LargeObjectDesc
 	SubTransactionId subid;		/* owning subtransaction ID */
 	uint64		offset;			/* current seek pointer */
 	int			flags;			/* see flag bits below */
+	MemoryContext mcxt;			/* context holding the descriptor */
+	uint64		lastend;		/* offset just past the last read, if any */
+	char	   *rabuf;			/* read-ahead data, or NULL */
+	uint64		rastart;		/* LO offset of rabuf's first byte */
+	int			ralen;			/* number of valid bytes in rabuf */
+	bool		raeof;			/* does rabuf reach the end of the LO? */
 
 /* bits in flags: */
 #define IFS_RDLOCK		(1 << 0)	/* LO was opened for reading */
@@ -77,6 +84,13 @@ typedef struct LargeObjectDesc
  */
 #define MAX_LARGE_OBJECT_SIZE	((int64) INT_MAX * LOBLKSIZE)
 
+/*
+ * Small reads from a read-only descriptor that continue where the previous
+ * read stopped fetch this much, so that a series of small sequential reads
+ * doesn't start an index scan for each one.
+ */
+#define LO_READAHEAD_SIZE		(64 * LOBLKSIZE)
+
 
 /*
  * Function definitions...
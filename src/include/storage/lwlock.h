@@ -136,7 +136,12 @@ extern PGDLLIMPORT LWLockPadded *MainLWLockArray;
 #define CommitTsLock				(&MainLWLockArray[39].lock)
 #define ReplicationOriginLock		(&MainLWLockArray[40].lock)
 #define MultiXactTruncationLock		(&MainLWLockArray[41].lock)
-#define NUM_INDIVIDUAL_LWLOCKS		42
+#define SharedPlanCacheLock			(&MainLWLockArray[42].lock)
+#define SharedCatCacheLock			(&MainLWLockArray[43].lock)
+#define TSSharedDictLock			(&MainLWLockArray[44].lock)
+#define LogicalRepWorkerLock		(&MainLWLockArray[45].lock)
+#define PgStatLock					(&MainLWLockArray[46].lock)
+#define NUM_INDIVIDUAL_LWLOCKS		47
 
 /*
  * It's a bit odd to declare NUM_BUFFER_PARTITIONS and NUM_LOCK_PARTITIONS
@@ -148,21 +153,31 @@ extern PGDLLIMPORT LWLockPadded *MainLWLockArray;
 #define NUM_BUFFER_PARTITIONS  128
 
 /* Number of partitions the shared lock tables are divided into */
-#define LOG2_NUM_LOCK_PARTITIONS  4
+#define LOG2_NUM_LOCK_PARTITIONS  6
 #define NUM_LOCK_PARTITIONS  (1 << LOG2_NUM_LOCK_PARTITIONS)
 
 /* Number of partitions the shared predicate lock tables are divided into */
 #define LOG2_NUM_PREDICATELOCK_PARTITIONS  4
 #define NUM_PREDICATELOCK_PARTITIONS  (1 << LOG2_NUM_PREDICATELOCK_PARTITIONS)
 
+/* Number of partitions of the shared relation size table */
+#define NUM_SMGR_SIZE_PARTITIONS  16
+
+/* Number of locks for the headers of compressed relation segments */
+#define NUM_PAGE_COMPRESS_PARTITIONS  16
+
 /* Offsets for various chunks of preallocated lwlocks. */
 #define BUFFER_MAPPING_LWLOCK_OFFSET	NUM_INDIVIDUAL_LWLOCKS
 #define LOCK_MANAGER_LWLOCK_OFFSET		\
 	(BUFFER_MAPPING_LWLOCK_OFFSET + NUM_BUFFER_PARTITIONS)
 #define PREDICATELOCK_MANAGER_LWLOCK_OFFSET \
 	(LOCK_MANAGER_LWLOCK_OFFSET + NUM_LOCK_PARTITIONS)
-#define NUM_FIXED_LWLOCKS \
+#define SMGR_SIZE_LWLOCK_OFFSET \
 	(PREDICATELOCK_MANAGER_LWLOCK_OFFSET + NUM_PREDICATELOCK_PARTITIONS)
+#define PAGE_COMPRESS_LWLOCK_OFFSET \
+	(SMGR_SIZE_LWLOCK_OFFSET + NUM_SMGR_SIZE_PARTITIONS)
+#define NUM_FIXED_LWLOCKS \
+	(PAGE_COMPRESS_LWLOCK_OFFSET + NUM_PAGE_COMPRESS_PARTITIONS)
 
 typedef enum LWLockMode
 {
@@ -189,6 +204,8 @@ extern bool LWLockHeldByMe(LWLock *lock);
 extern bool LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval);
 extern void LWLockUpdateVar(LWLock *lock, uint64 *valptr, uint64 value);
 
+extern const char *GetLWLockIdentifier(uint16 eventId);
+
 extern Size LWLockShmemSize(void);
 extern void CreateLWLocks(void);
 extern void InitLWLockAccess(void);
@@ -0,0 +1,87 @@
+/*-------------------------------------------------------------------------
+ *
+ * pagecompress.h
+ *	  compressed relation segment files
+ *
+ * A relation segment file normally holds its blocks back to back, block N
+ * at offset N * BLCKSZ.  A compressed segment file instead starts with a
+ * header and a block address map, followed by the compressed blocks:
+ *
+ *	offset 0			PageCompressHeader, padded to BLCKSZ
+ *	PC_MAP_OFFSET		one PageCompressAddr per block of the segment
+ *	PC_DATA_OFFSET		chunks of PC_CHUNK_SIZE bytes
+ *
+ * Each block that has been written is stored in a run of consecutive
+ * chunks, which its map entry points to.  The run starts with a
+ * PageCompressData header, followed by the pglz-compressed block, or by the
+ * block as is if it didn't compress.  A block whose map entry is unset
+ * reads as zeroes, as if it were a hole in an ordinary segment file.
+ *
+ * A block keeps its run for as long as it fits; when it grows, it gets a
+ * new, somewhat larger run at the end of the data area, and the old one is
+ * leaked until the segment is truncated or the relation rewritten.
+ *
+ * Only the first segment of a relation is identified by its header: its
+ * pch_magic is the high half of an LSN that no real page could carry.
+ * The later segments of a compressed relation are compressed too, and are
+ * simply empty as long as they are shorter than the header.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/pagecompress.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PAGECOMPRESS_H
+#define PAGECOMPRESS_H
+
+#include "storage/block.h"
+#include "storage/fd.h"
+#include "storage/lwlock.h"
+
+typedef struct PageCompressHeader
+{
+	uint32		pch_magic;		/* PAGE_COMPRESS_MAGIC */
+	uint32		pch_version;	/* PAGE_COMPRESS_VERSION */
+	uint32		pch_nblocks;	/* number of blocks in the segment */
+	uint32		pch_nchunks;	/* number of chunks allocated */
+} PageCompressHeader;
+
+#define PAGE_COMPRESS_MAGIC		0xFFFFFFF0
+#define PAGE_COMPRESS_VERSION	1
+
+typedef struct PageCompressAddr
+{
+	uint32		pca_chunkno;	/* first chunk of the block's run */
+	uint32		pca_nchunks;	/* length of the run, or 0 if none */
+} PageCompressAddr;
+
+typedef struct PageCompressData
+{
+	uint32		pcd_crc;		/* CRC of the rest, seeded with block number */
+	uint16		pcd_size;		/* bytes following; BLCKSZ if not compressed */
+	uint16		pcd_unused;
+} PageCompressData;
+
+#define PC_CHUNK_SIZE		512
+#define PC_MAX_CHUNKS \
+	((sizeof(PageCompressData) + BLCKSZ + PC_CHUNK_SIZE - 1) / PC_CHUNK_SIZE)
+
+#define PC_MAP_OFFSET		((off_t) BLCKSZ)
+#define PC_DATA_OFFSET \
+	(PC_MAP_OFFSET + \
+	 (off_t) TYPEALIGN(BLCKSZ, sizeof(PageCompressAddr) * RELSEG_SIZE))
+
+extern bool PageCompressIsCompressed(File file);
+extern void PageCompressInit(File file);
+extern BlockNumber PageCompressNBlocks(File file);
+extern int PageCompressRead(File file, BlockNumber blkno, char *buffer);
+extern void PageCompressWrite(File file, LWLock *lock, BlockNumber blkno,
+				  char *buffer, bool extend);
+extern void PageCompressExtend(File file, LWLock *lock, BlockNumber nblocks);
+extern void PageCompressTruncate(File file, LWLock *lock, BlockNumber nblocks);
+extern void PageCompressPrefetch(File file, BlockNumber blkno);
+
+#endif   /* PAGECOMPRESS_H */
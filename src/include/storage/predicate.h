@@ -22,6 +22,8 @@
  * GUC variables
  */
 extern int	max_predicate_locks_per_xact;
+extern int	max_predicate_locks_per_relation;
+extern int	max_predicate_locks_per_page;
 
 
 /* Number of SLRU buffers to use for predicate locking */
@@ -14,6 +14,7 @@
 #ifndef _PROC_H_
 #define _PROC_H_
 
+#include "access/clog.h"
 #include "access/xlogdefs.h"
 #include "lib/ilist.h"
 #include "storage/latch.h"
@@ -21,21 +22,30 @@
 #include "storage/pg_sema.h"
 
 /*
- * Each backend advertises up to PGPROC_MAX_CACHED_SUBXIDS TransactionIds
- * for non-aborted subtransactions of its current top transaction.  These
- * have to be treated as running XIDs by other backends.
+ * Each backend advertises up to max_cached_subxids TransactionIds for
+ * non-aborted subtransactions of its current top transaction.  These have to
+ * be treated as running XIDs by other backends.
  *
  * We also keep track of whether the cache overflowed (ie, the transaction has
  * generated at least one subtransaction that didn't fit in the cache).
  * If none of the caches have overflowed, we can assume that an XID that's not
  * listed anywhere in the PGPROC array is not a running transaction.  Else we
  * have to look at pg_subtrans.
+ *
+ * PGPROC_MAX_CACHED_SUBXIDS is the smallest cache we allow.  It is also how
+ * many subxids a transaction may assign between XLOG_XACT_ASSIGNMENT records,
+ * which bounds what a hot standby has to track, so that part doesn't change
+ * with max_cached_subxids.
  */
 #define PGPROC_MAX_CACHED_SUBXIDS 64	/* XXX guessed-at value */
+#define MAX_CACHED_SUBXIDS_LIMIT 8192	/* must fit in PGXACT->nxids */
+
+extern PGDLLIMPORT int max_cached_subxids;
 
 struct XidCache
 {
-	TransactionId xids[PGPROC_MAX_CACHED_SUBXIDS];
+	/* max_cached_subxids entries, allocated along with the PGPROCs */
+	TransactionId *xids;
 };
 
 /* Flags for PGXACT->vacuumFlags */
@@ -51,12 +61,20 @@ struct XidCache
 	(PROC_IN_VACUUM | PROC_IN_ANALYZE | PROC_VACUUM_FOR_WRAPAROUND)
 
 /*
- * We allow a small number of "weak" relation locks (AccesShareLock,
- * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure
- * rather than the main lock table.  This eases contention on the lock
- * manager LWLocks.  See storage/lmgr/README for additional details.
+ * We allow a number of "weak" relation locks (AccesShareLock, RowShareLock,
+ * RowExclusiveLock) to be recorded in the PGPROC structure rather than the
+ * main lock table.  This eases contention on the lock manager LWLocks.  See
+ * storage/lmgr/README for additional details.
+ *
+ * The slots come in groups of FP_LOCK_SLOTS_PER_GROUP; the number of groups
+ * is derived from max_locks_per_transaction, see InitializeMaxBackends().
  */
-#define		FP_LOCK_SLOTS_PER_BACKEND 16
+extern PGDLLIMPORT int FastPathLockGroupsPerBackend;
+
+#define		FP_LOCK_GROUPS_PER_BACKEND_MAX	1024
+#define		FP_LOCK_SLOTS_PER_GROUP		16	/* don't change */
+#define		FastPathLockSlotsPerBackend() \
+	(FP_LOCK_SLOTS_PER_GROUP * FastPathLockGroupsPerBackend)
 
 /*
  * Each backend has a PGPROC struct in shared memory.  There is also a list of
@@ -102,6 +120,9 @@ struct PGPROC
 	 */
 	bool		recoveryConflictPending;
 
+	/* Wait event the process is currently waiting for, see pgstat.h */
+	uint32		wait_event_info;
+
 	/* Info about LWLock the process is currently waiting for, if any. */
 	bool		lwWaiting;		/* true if waiting for an LW lock */
 	uint8		lwWaitMode;		/* lwlock mode being waited for */
@@ -125,6 +146,40 @@ struct PGPROC
 	int			syncRepState;	/* wait state for sync rep */
 	SHM_QUEUE	syncRepLinks;	/* list link if process is in syncrep queue */
 
+	/*
+	 * Info to allow a group of backends to have their WAL flushed by one of
+	 * them, see XLogFlush().  walFlushGroupUpto is how far this backend wants
+	 * WAL flushed; all WAL before it has already been inserted.
+	 */
+	bool		walFlushGroupMember;	/* true, if member of flush group */
+	pg_atomic_uint32 walFlushGroupNext; /* next flush group member */
+	XLogRecPtr	walFlushGroupUpto;		/* flush request of this member */
+
+	/*
+	 * Info to allow a group of ending transactions to have their XIDs
+	 * cleared by one of them, see ProcArrayEndTransaction().
+	 */
+	bool		procArrayGroupMember;	/* true, if member of ProcArray group
+										 * waiting for XID clear */
+	pg_atomic_uint32 procArrayGroupNext;	/* next ProcArray group member */
+	TransactionId procArrayGroupMemberXid;	/* latest transaction id among
+											 * the transaction's main XID and
+											 * subtransactions */
+
+	/*
+	 * Info to allow a group of committing or aborting transactions to have
+	 * their CLOG status set by one of them, see TransactionIdSetPageStatus().
+	 */
+	bool		clogGroupMember;	/* true, if member of clog group */
+	pg_atomic_uint32 clogGroupNext;		/* next clog group member */
+	TransactionId clogGroupMemberXid;	/* transaction id of clog group member */
+	XidStatus	clogGroupMemberXidStatus;	/* transaction status of clog
+											 * group member */
+	int			clogGroupMemberPage;	/* clog page corresponding to
+										 * transaction id of clog group member */
+	XLogRecPtr	clogGroupMemberLsn;		/* WAL location of commit record for
+										 * clog group member */
+
 	/*
 	 * All PROCLOCK objects for locks held or awaited by this backend are
 	 * linked into one of these lists, according to the partition number of
@@ -137,9 +192,12 @@ struct PGPROC
 	/* Per-backend LWLock.  Protects fields below. */
 	LWLock	   *backendLock;	/* protects the fields below */
 
-	/* Lock manager data, recording fast-path locks taken by this backend. */
-	uint64		fpLockBits;		/* lock modes held for each fast-path slot */
-	Oid			fpRelId[FP_LOCK_SLOTS_PER_BACKEND];		/* slots for rel oids */
+	/*
+	 * Lock manager data, recording fast-path locks taken by this backend.
+	 * The arrays are allocated along with the PGPROCs, see InitProcGlobal().
+	 */
+	uint64	   *fpLockBits;		/* lock modes held, one uint64 per group */
+	Oid		   *fpRelId;		/* slots for rel oids */
 	bool		fpVXIDLock;		/* are we holding a fast-path VXID lock? */
 	LocalTransactionId fpLocalTransactionId;	/* lxid for fast-path VXID
 												 * lock */
@@ -147,6 +205,9 @@ struct PGPROC
 
 /* NOTE: "typedef struct PGPROC PGPROC" appears in storage/lock.h. */
 
+/* marks the end of a list of PGPROCs linked by pgprocno */
+#define INVALID_PGPROCNO		PG_INT32_MAX
+
 
 extern PGDLLIMPORT PGPROC *MyProc;
 extern PGDLLIMPORT struct PGXACT *MyPgXact;
@@ -175,7 +236,7 @@ typedef struct PGXACT
 	bool		delayChkpt;		/* true if this proc delays checkpoint start;
 								 * previously called InCommit */
 
-	uint8		nxids;
+	uint16		nxids;
 } PGXACT;
 
 /*
@@ -195,6 +256,10 @@ typedef struct PROC_HDR
 	PGPROC	   *autovacFreeProcs;
 	/* Head of list of bgworker free PGPROC structures */
 	PGPROC	   *bgworkerFreeProcs;
+	/* First pgproc waiting for group XID clear */
+	pg_atomic_uint32 procArrayGroupFirst;
+	/* First pgproc waiting for group transaction status update */
+	pg_atomic_uint32 clogGroupFirst;
 	/* WALWriter process's latch */
 	Latch	   *walwriterLatch;
 	/* Checkpointer process's latch */
@@ -255,7 +320,7 @@ extern void CheckDeadLockAlert(void);
 extern bool IsWaitingForLock(void);
 extern void LockErrorCleanup(void);
 
-extern void ProcWaitForSignal(void);
+extern void ProcWaitForSignal(uint32 wait_event_info);
 extern void ProcSendSignal(int pid);
 
 #endif   /* PROC_H */
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.h
+ *	  Reading the blocks of a relation in the order a callback chooses.
+ *
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/read_stream.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef READ_STREAM_H
+#define READ_STREAM_H
+
+#include "storage/bufmgr.h"
+
+typedef struct ReadStream ReadStream;
+
+/*
+ * Returns the next block to read, or InvalidBlockNumber at the end.  The
+ * callback may store something about the block in *per_buffer_data, which
+ * read_stream_next_buffer hands back along with the block's buffer.
+ */
+typedef BlockNumber (*ReadStreamBlockCallback) (ReadStream *stream,
+												 void *callback_private_data,
+												 void *per_buffer_data);
+
+extern ReadStream *read_stream_begin_relation(Relation rel,
+						   ForkNumber forknum,
+						   BufferAccessStrategy strategy,
+						   ReadStreamBlockCallback callback,
+						   void *callback_private_data,
+						   size_t per_buffer_data_size);
+extern Buffer read_stream_next_buffer(ReadStream *stream,
+						void **per_buffer_data);
+extern void read_stream_reset(ReadStream *stream);
+extern void read_stream_end(ReadStream *stream);
+
+#endif   /* READ_STREAM_H */
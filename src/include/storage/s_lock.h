@@ -324,6 +324,27 @@ tas(volatile slock_t *lock)
 
 #define S_UNLOCK(lock) __sync_lock_release(lock)
 
+#if defined(__aarch64__) || defined(__aarch64)
+
+/*
+ * On ARM64, poll a contended lock with plain loads, as on x86_64: retrying
+ * the exchange (SWPAL, or an LL/SC loop without LSE) right away takes the
+ * cache line exclusive each time, and with many waiters the lock holder
+ * itself ends up waiting for it to release the lock.
+ */
+#define TAS_SPIN(lock)    (*(lock) ? 1 : TAS(lock))
+
+#define SPIN_DELAY() spin_delay()
+
+static __inline__ void
+spin_delay(void)
+{
+	/* see pg_spin_delay_impl() in port/atomics/arch-arm.h */
+	__asm__ __volatile__(
+		" isb;				\n");
+}
+
+#endif	 /* __aarch64__ || __aarch64 */
 #endif	 /* HAVE_GCC__SYNC_INT32_TAS */
 #endif	 /* __arm__ || __arm || __aarch64__ || __aarch64 */
 
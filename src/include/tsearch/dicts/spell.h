@@ -24,15 +24,19 @@
  */
 #define MAXFLAGLEN 16
 
-struct SPNode;
-
+/*
+ * The nodes of the dictionary tree are kept in one contiguous arena and
+ * refer to their children by offset within it, rather than by pointer, so
+ * that a finished tree can be placed in shared memory and used at whatever
+ * address each backend maps it.  Offset 0 means "no node".
+ */
 typedef struct
 {
 	uint32		val:8,
 				isword:1,
 				compoundflag:4,
 				affix:19;
-	struct SPNode *node;
+	uint32		node;			/* arena offset of child node, or 0 */
 } SPNodeData;
 
 /*
@@ -54,6 +58,10 @@ typedef struct SPNode
 
 #define SPNHDRSZ	(offsetof(SPNode,data))
 
+/* Get the node at arena offset off, or NULL if off is 0 */
+#define SPNodeAt(Conf, off) \
+	((off) != 0 ? (SPNode *) ((Conf)->DictArena + (off)) : (SPNode *) NULL)
+
 
 typedef struct spell_struct
 {
@@ -141,7 +149,10 @@ typedef struct
 	AffixNode  *Suffix;
 	AffixNode  *Prefix;
 
-	SPNode	   *Dictionary;
+	SPNode	   *Dictionary;		/* root of the tree in DictArena */
+	char	   *DictArena;		/* storage of all SPNodes */
+	Size		lenDictArena;	/* allocated length of DictArena */
+	Size		usedDictArena;	/* bytes of DictArena in use */
 	char	  **AffixData;
 	int			lenAffixData;
 	int			nAffixData;
@@ -176,4 +187,8 @@ extern void NISortDictionary(IspellDict *Conf);
 extern void NISortAffixes(IspellDict *Conf);
 extern void NIFinishBuild(IspellDict *Conf);
 
+extern Size NIDictionarySharedSize(IspellDict *Conf);
+extern void NIDictionaryWriteShared(IspellDict *Conf, char *dest);
+extern void NIDictionaryAttachShared(IspellDict *Conf, char *src);
+
 #endif
@@ -0,0 +1,30 @@
+/*-------------------------------------------------------------------------
+ *
+ * ts_shared.h
+ *	  Sharing of compiled text search dictionaries between backends.
+ *
+ * See ts_shared.c for comments.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ *
+ * src/include/tsearch/ts_shared.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef TS_SHARED_H
+#define TS_SHARED_H
+
+#include "storage/dsm.h"
+
+/* GUC parameter */
+extern bool shared_ts_dictionaries;
+
+extern Size TSSharedDictShmemSize(void);
+extern void TSSharedDictShmemInit(void);
+
+extern char *TSSharedDictFind(const char *key, MemoryContext owner);
+extern char *TSSharedDictCreate(const char *key, Size size,
+				   dsm_segment **segp);
+extern void TSSharedDictPublish(dsm_segment *seg, MemoryContext owner);
+
+#endif   /* TS_SHARED_H */
@@ -0,0 +1,54 @@
+/*-------------------------------------------------------------------------
+ *
+ * hashutils.h
+ *	  Hash functions for in-memory hash tables
+ *
+ * The functions declared here are for hash values that are never stored
+ * on disk, so they are free to change between releases.  Hash values that
+ * are persisted (hash indexes) must keep using hash_any() and hash_uint32()
+ * from access/hash.h.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/hashutils.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef HASHUTILS_H
+#define HASHUTILS_H
+
+/*
+ * Combine two hash values, resulting in another hash value, with decent bit
+ * mixing.
+ *
+ * Similar to boost's hash_combine().
+ */
+static inline uint32
+hash_combine(uint32 a, uint32 b)
+{
+	a ^= b + 0x9e3779b9 + (a << 6) + (a >> 2);
+	return a;
+}
+
+/*
+ * Simple inline murmur hash implementation hashing a 32 bit integer, for
+ * performance.
+ */
+static inline uint32
+murmurhash32(uint32 data)
+{
+	uint32		h = data;
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/* in utils/hash/hashfn.c */
+extern uint32 hash_bytes_fast(const unsigned char *k, Size keylen);
+
+#endif   /* HASHUTILS_H */
@@ -275,6 +275,18 @@ struct JsonbValue
 #define IsAJsonbScalar(jsonbval)	((jsonbval)->type >= JsonbValue::jbvNull && \
 									 (jsonbval)->type <= JsonbValue::jbvBool)
 
+/*
+ * Maximum number of elements in an array (or key/value pairs in an object).
+ * This is limited by two things: the size of the JEntry array must fit
+ * in MaxAllocSize, and the number of elements (or pairs) must fit in the bits
+ * reserved for that in the JsonbContainer.header field.
+ *
+ * (The total size of an array's or object's elements is also limited by
+ * JENTRY_OFFLENMASK, but we're not concerned about that here.)
+ */
+#define JSONB_MAX_ELEMS (Min(MaxAllocSize / sizeof(JsonbValue), JB_CMASK))
+#define JSONB_MAX_PAIRS (Min(MaxAllocSize / sizeof(JsonbPair), JB_CMASK))
+
 /*
  * Key/value pair within an Object.
  *
@@ -343,6 +355,37 @@ typedef struct JsonbIterator
 	struct JsonbIterator *parent;
 } JsonbIterator;
 
+/*
+ * An expanded jsonb is contained within a private memory context (as all
+ * expanded objects must be) and has a control structure as below.
+ *
+ * The document is held as a tree of JsonbValues whose containers are always
+ * jbvObject or jbvArray, never jbvBinary, so that nested values can be
+ * reached and replaced without decoding the on-disk format.  Object pairs
+ * are kept in the on-disk key order, so key lookups are a binary search.  A
+ * scalar document is a raw-scalar pseudo-array, as in the on-disk format.
+ *
+ * Strings and numerics in the tree may point into the flat value the tree
+ * was built from (fsource), so that is kept for the life of the object.
+ * fvalue points to a flat representation if one is known to be valid, else
+ * it is NULL; it is either fsource or a copy cached by get_flat_size.
+ */
+#define EJ_MAGIC 301487269		/* ID for debugging crosschecks */
+
+typedef struct ExpandedJsonbHeader
+{
+	/* Standard header for expanded objects */
+	ExpandedObjectHeader hdr;
+
+	/* Magic value identifying an expanded jsonb (for debugging only) */
+	int			ej_magic;
+
+	JsonbValue	root;			/* the document, as an in-memory tree */
+
+	Jsonb	   *fsource;		/* flat value the tree was built from */
+	Jsonb	   *fvalue;			/* valid flat representation, or NULL */
+} ExpandedJsonbHeader;
+
 /* I/O routines */
 extern Datum jsonb_in(PG_FUNCTION_ARGS);
 extern Datum jsonb_out(PG_FUNCTION_ARGS);
@@ -427,6 +470,22 @@ extern bool JsonbDeepContains(JsonbIterator **val,
 				  JsonbIterator **mContained);
 extern void JsonbHashScalarValue(const JsonbValue *scalarVal, uint32 *hash);
 
+/* expanded jsonb support, in jsonb_expanded.c */
+extern Datum expand_jsonb(Datum jsonbdatum, MemoryContext parentcontext);
+extern ExpandedJsonbHeader *DatumGetExpandedJsonb(Datum d);
+extern JsonbValue *DatumGetExpandedJsonbRoot(Datum d);
+extern void makeExpandedJsonbValue(ExpandedJsonbHeader *ejh, Jsonb *jb,
+					   JsonbValue *result);
+extern JsonbValue *findJsonbValueFromExpanded(JsonbValue *object,
+						   const char *key, int keylen);
+extern void setExpandedJsonbKey(ExpandedJsonbHeader *ejh, JsonbValue *object,
+					const char *key, int keylen, JsonbValue *val);
+extern void setExpandedJsonbElem(ExpandedJsonbHeader *ejh, JsonbValue *array,
+					 int idx, JsonbValue *val);
+extern void insertExpandedJsonbElem(ExpandedJsonbHeader *ejh,
+						JsonbValue *array, int idx, JsonbValue *val);
+extern bool concatExpandedJsonb(ExpandedJsonbHeader *ejh, Jsonb *jb);
+
 /* jsonb.c support functions */
 extern char *JsonbToCString(StringInfo out, JsonbContainer *in,
 			   int estimated_len);
@@ -103,10 +103,44 @@ extern Size GetMemoryChunkSpace(void *pointer);
 extern MemoryContext GetMemoryChunkContext(void *pointer);
 extern MemoryContext MemoryContextGetParent(MemoryContext context);
 extern bool MemoryContextIsEmpty(MemoryContext context);
+extern Size MemoryContextMemAllocated(MemoryContext context, bool recurse);
+extern Size MemoryContextMemPeak(MemoryContext context, bool recurse);
 extern void MemoryContextStats(MemoryContext context);
 extern void MemoryContextAllowInCriticalSection(MemoryContext context,
 									bool allow);
 
+/*
+ * Memory context statistics of another backend, which it writes into a DSM
+ * segment at the request of pg_get_process_memory_contexts().  There is one
+ * entry per context, in depth-first order, so a parent precedes its children.
+ */
+#define MCXT_DUMP_NAME_LEN		128
+#define MCXT_DUMP_MAX_CONTEXTS	8192
+
+typedef struct MemoryContextDumpEntry
+{
+	char		name[MCXT_DUMP_NAME_LEN];	/* clipped context name */
+	int			parent;			/* index of the parent's entry, or -1 */
+	int			level;			/* distance from TopMemoryContext */
+	MemoryContextCounters counters;
+	Size		peak_allocated;
+} MemoryContextDumpEntry;
+
+typedef struct MemoryContextDump
+{
+	int			ncontexts;		/* number of entries filled in */
+	int			nmissing;		/* number of contexts that didn't fit */
+	MemoryContextDumpEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} MemoryContextDump;
+
+extern PGDLLIMPORT volatile bool MemoryContextDumpPending;
+
+extern Size MemoryContextDumpShmemSize(void);
+extern void MemoryContextDumpShmemInit(void);
+extern struct dsm_segment *RequestMemoryContextDump(int pid);
+extern void HandleMemoryContextDumpInterrupt(void);
+extern void ProcessMemoryContextDumpInterrupt(void);
+
 #ifdef MEMORY_CONTEXT_CHECKING
 extern void MemoryContextCheck(MemoryContext context);
 #endif
@@ -134,6 +168,17 @@ extern MemoryContext AllocSetContextCreate(MemoryContext parent,
 					  Size initBlockSize,
 					  Size maxBlockSize);
 
+/* slab.c */
+extern MemoryContext SlabContextCreate(MemoryContext parent,
+				  const char *name,
+				  Size blockSize,
+				  Size chunkSize);
+
+/* generation.c */
+extern MemoryContext GenerationContextCreate(MemoryContext parent,
+						const char *name,
+						Size blockSize);
+
 /*
  * Recommended default alloc parameters, suitable for "ordinary" contexts
  * that might hold quite a lot of data.
@@ -158,4 +203,17 @@ extern MemoryContext AllocSetContextCreate(MemoryContext parent,
  */
 #define ALLOCSET_SEPARATE_THRESHOLD  8192
 
+/*
+ * Recommended block sizes for slab contexts; objects of a few hundred bytes
+ * call for the larger one.
+ */
+#define SLAB_DEFAULT_BLOCK_SIZE		(8 * 1024)
+#define SLAB_LARGE_BLOCK_SIZE		(8 * 1024 * 1024)
+
+/*
+ * Recommended block size for generation contexts.  Requests larger than an
+ * eighth of the block size get a block of their own.
+ */
+#define GENERATION_DEFAULT_BLOCK_SIZE	(32 * 1024)
+
 #endif   /* MEMUTILS_H */
@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------------
+ *
+ * profiler.h
+ *	  Built-in sampling profiler for backends.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/profiler.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "datatype/timestamp.h"
+#include "nodes/nodes.h"
+
+/* One sample, as returned by profile_fetch_samples() */
+typedef struct ProfileSample
+{
+	TimestampTz sample_time;
+	int			pid;
+	Oid			databaseid;
+	uint32		queryid;		/* 0 if unknown */
+	NodeTag		plan_node;		/* T_Invalid outside the executor */
+	uint32		wait_event_info;
+} ProfileSample;
+
+/* GUC parameters */
+extern int	profile_sample_interval;
+extern int	max_profile_samples;
+
+/*
+ * What the backend is doing right now, maintained by the executor and read
+ * from the sampling timer's signal handler.
+ */
+extern PGDLLIMPORT volatile NodeTag ProfileActivePlanNode;
+extern PGDLLIMPORT volatile uint32 ProfileActiveQueryId;
+
+extern Size ProfilerShmemSize(void);
+extern void ProfilerShmemInit(void);
+
+extern void ProfileSampleHandler(void);
+extern void profile_sampling_start(void);
+extern void profile_sampling_stop(void);
+
+extern ProfileSample *profile_fetch_samples(int *nsamples);
+extern const char *profile_plan_node_name(NodeTag tag);
+
+#endif   /* PROFILER_H */
@@ -77,8 +77,10 @@ typedef struct RelationData
 	bool		rd_islocaltemp; /* rel is a temp rel of this session */
 	bool		rd_isnailed;	/* rel is nailed in cache */
 	bool		rd_isvalid;		/* relcache entry is valid */
+	bool		rd_recentlyused;	/* used since last eviction sweep? */
 	char		rd_indexvalid;	/* state of rd_indexlist: 0 = not valid, 1 =
 								 * valid, 2 = temporarily forced */
+	bool		rd_statvalid;	/* is rd_statlist valid? */
 
 	/*
 	 * rd_createSubid is the ID of the highest subtransaction the rel has
@@ -112,6 +114,9 @@ typedef struct RelationData
 	Oid			rd_oidindex;	/* OID of unique index on OID, if any */
 	Oid			rd_replidindex; /* OID of replica identity index, if any */
 
+	/* data managed by RelationGetStatExtList: */
+	List	   *rd_statlist;	/* list of OIDs of extended stats */
+
 	/* data managed by RelationGetIndexAttrBitmap: */
 	Bitmapset  *rd_indexattr;	/* identifies columns used in indexes */
 	Bitmapset  *rd_keyattr;		/* cols that can be ref'd by foreign keys */
@@ -144,6 +149,10 @@ typedef struct RelationData
 	 * index).  If used, it must point to a single memory chunk palloc'd in
 	 * rd_indexcxt.  A relcache reset will include freeing that chunk and
 	 * setting rd_amcache = NULL.
+	 *
+	 * Note: rd_sortedinsert is set by the executor only while it inserts a
+	 * batch of entries in the index's key order (see
+	 * ExecInsertIndexTuplesBatch), as a hint to the index AM.
 	 */
 	MemoryContext rd_indexcxt;	/* private memory cxt for this stuff */
 	RelationAmInfo *rd_aminfo;	/* lookup info for funcs found in pg_am */
@@ -158,6 +167,7 @@ typedef struct RelationData
 	Oid		   *rd_exclprocs;	/* OIDs of exclusion ops' procs, if any */
 	uint16	   *rd_exclstrats;	/* exclusion ops' strategy numbers, if any */
 	void	   *rd_amcache;		/* available for use by index AM */
+	bool		rd_sortedinsert;	/* inserts are arriving in key order */
 	Oid		   *rd_indcollation;	/* OIDs of index collations */
 
 	/*
@@ -171,6 +181,14 @@ typedef struct RelationData
 	/* use "struct" here to avoid needing to include fdwapi.h: */
 	struct FdwRoutine *rd_fdwroutine;	/* cached function pointers, or NULL */
 
+	/*
+	 * table access method support
+	 *
+	 * rd_tableam is managed like rd_fdwroutine; see
+	 * GetTableAmRoutineForRelation.
+	 */
+	struct TableAmRoutine *rd_tableam;	/* cached function pointers, or NULL */
+
 	/*
 	 * Hack for CLUSTER, rewriting ALTER TABLE, etc: when writing a new
 	 * version of a table, we need to make any toast pointers inserted into it
@@ -220,6 +238,10 @@ typedef struct StdRdOptions
 	AutoVacOpts autovacuum;		/* autovacuum-related options */
 	bool		user_catalog_table;		/* use as an additional catalog
 										 * relation */
+	int			parallel_workers;	/* max number of parallel workers */
+	bool		compression;	/* store the main fork compressed */
+	bool		incremental_maintenance;	/* matview kept up to date by
+											 * triggers on its base tables */
 } StdRdOptions;
 
 #define HEAP_MIN_FILLFACTOR			10
@@ -247,6 +269,14 @@ typedef struct StdRdOptions
 #define RelationGetTargetPageFreeSpace(relation, defaultff) \
 	(BLCKSZ * (100 - RelationGetFillFactor(relation, defaultff)) / 100)
 
+/*
+ * RelationGetParallelWorkers
+ *		Returns the relation's parallel_workers.  Note multiple eval of argument!
+ */
+#define RelationGetParallelWorkers(relation, defaultpw) \
+	((relation)->rd_options ? \
+	 ((StdRdOptions *) (relation)->rd_options)->parallel_workers : (defaultpw))
+
 /*
  * RelationIsUsedAsCatalogTable
  *		Returns whether the relation should be treated as a catalog table
@@ -256,6 +286,29 @@ typedef struct StdRdOptions
 	((relation)->rd_options ?				\
 	 ((StdRdOptions *) (relation)->rd_options)->user_catalog_table : false)
 
+/*
+ * RelationIsIncrementallyMaintained
+ *		Returns whether a materialized view is kept up to date by triggers
+ *		on its base tables.  Note multiple eval of argument!
+ */
+#define RelationIsIncrementallyMaintained(relation) \
+	((relation)->rd_options ? \
+	 ((StdRdOptions *) (relation)->rd_options)->incremental_maintenance : false)
+
+/*
+ * RelationWantsCompression
+ *		Returns whether new storage for the relation should be compressed.
+ *		Only tables, materialized views and btree indexes can be, see
+ *		storage/pagecompress.h.  Note multiple eval of argument!
+ */
+#define RelationWantsCompression(relation)								\
+	((relation)->rd_options &&											\
+	 ((relation)->rd_rel->relkind == RELKIND_RELATION ||				\
+	  (relation)->rd_rel->relkind == RELKIND_MATVIEW ||					\
+	  ((relation)->rd_rel->relkind == RELKIND_INDEX &&					\
+	   (relation)->rd_rel->relam == BTREE_AM_OID)) &&					\
+	 ((StdRdOptions *) (relation)->rd_options)->compression)
+
 
 /*
  * ViewOptions
@@ -350,6 +403,14 @@ typedef struct ViewOptions
  */
 #define RelationGetNumberOfAttributes(relation) ((relation)->rd_rel->relnatts)
 
+/*
+ * IndexRelationGetNumberOfKeyAttributes
+ *		Returns the number of key attributes in an index, that is, the
+ *		columns before any INCLUDE columns.
+ */
+#define IndexRelationGetNumberOfKeyAttributes(relation) \
+	((relation)->rd_index->indnkeyatts)
+
 /*
  * RelationGetDescr
  *		Returns tuple descriptor for a relation.
@@ -434,6 +495,17 @@ typedef struct ViewOptions
 #define RelationNeedsWAL(relation) \
 	((relation)->rd_rel->relpersistence == RELPERSISTENCE_PERMANENT)
 
+/*
+ * RelationUsesHeapAM
+ *		True if the table is stored by the built-in heap access method,
+ *		rather than by one given in CREATE TABLE ... USING.
+ *
+ * NB: this is only meaningful for tables, materialized views and TOAST
+ * tables; indexes keep their index access method in relam.
+ */
+#define RelationUsesHeapAM(relation) \
+	(!OidIsValid((relation)->rd_rel->relam))
+
 /*
  * RelationUsesLocalBuffers
  *		True if relation's pages are stored in local buffers.
@@ -38,6 +38,7 @@ extern void RelationClose(Relation relation);
  * Routines to compute/retrieve additional cached information
  */
 extern List *RelationGetIndexList(Relation relation);
+extern List *RelationGetStatExtList(Relation relation);
 extern Oid	RelationGetOidIndex(Relation relation);
 extern Oid	RelationGetReplicaIndex(Relation relation);
 extern List *RelationGetIndexExpressions(Relation relation);
@@ -121,6 +122,12 @@ extern void RelationCacheInitFilePreInvalidate(void);
 extern void RelationCacheInitFilePostInvalidate(void);
 extern void RelationCacheInitFileRemove(void);
 
+extern void RelationCacheGetStats(long *nentries, long *searches,
+					  long *hits, long *invals, long *evictions);
+
+/* GUC parameter */
+extern int	relation_cache_max_entries;
+
 /* should be used only by relcache.c and catcache.c */
 extern bool criticalRelcachesBuilt;
 
@@ -67,6 +67,7 @@
 typedef struct VariableStatData
 {
 	Node	   *var;			/* the Var or expression tree */
+	PlannerInfo *root;			/* planner info, or NULL if not known */
 	RelOptInfo *rel;			/* Relation, or NULL if not identifiable */
 	HeapTuple	statsTuple;		/* pg_statistic tuple, or NULL if none */
 	/* NB: if statsTuple!=NULL, it must be freed when caller is done */
@@ -111,6 +112,13 @@ extern PGDLLIMPORT get_index_stats_hook_type get_index_stats_hook;
 
 extern void examine_variable(PlannerInfo *root, Node *node, int varRelid,
 				 VariableStatData *vardata);
+extern bool get_variable_statsslot(VariableStatData *vardata,
+					   int reqkind, Oid reqop, Oid *actualop,
+					   Datum **values, int *nvalues,
+					   float4 **numbers, int *nnumbers);
+extern void free_variable_statsslot(VariableStatData *vardata,
+						Datum *values, int nvalues,
+						float4 *numbers, int nnumbers);
 extern bool get_restriction_variable(PlannerInfo *root, List *args,
 						 int varRelid,
 						 VariableStatData *vardata, Node **other,
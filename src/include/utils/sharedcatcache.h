@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedcatcache.h
+ *	  Cross-backend cache of system catalog tuples.
+ *
+ * See sharedcatcache.c for comments.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedcatcache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDCATCACHE_H
+#define SHAREDCATCACHE_H
+
+#include "access/htup.h"
+#include "storage/sinval.h"
+#include "utils/catcache.h"
+
+/*
+ * Hash key of a shared catalog tuple.  These are the same three values a
+ * catcache invalidation message carries, so a message can find the entry
+ * it invalidates with a single probe.  dbid is InvalidOid for tuples of
+ * shared catalogs.
+ */
+typedef struct SharedCatCacheKey
+{
+	Oid			dbid;
+	int			cacheid;
+	uint32		hashvalue;
+} SharedCatCacheKey;
+
+/*
+ * State carried from SharedCatCacheLookup to SharedCatCacheStore while
+ * a backend reads a tuple the shared cache didn't have.
+ */
+typedef struct SharedCatCacheTag
+{
+	bool		shareable;		/* may the tuple be stored at all? */
+	SharedCatCacheKey key;
+	uint64		inval_count;	/* invalidation counter seen at lookup */
+} SharedCatCacheTag;
+
+/* GUC parameter */
+extern int	shared_catalog_cache_size;
+
+extern Size SharedCatCacheShmemSize(void);
+extern void SharedCatCacheShmemInit(void);
+
+extern HeapTuple SharedCatCacheLookup(CatCache *cache, uint32 hashValue,
+					 SharedCatCacheTag *tag);
+extern void SharedCatCacheStore(CatCache *cache, HeapTuple tuple,
+					SharedCatCacheTag *tag);
+extern void SharedCatCacheInvalidate(const SharedInvalidationMessage *msgs,
+						 int n);
+
+#endif   /* SHAREDCATCACHE_H */
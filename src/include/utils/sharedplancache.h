@@ -0,0 +1,60 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.h
+ *	  Cross-backend cache of generic plans for saved statements.
+ *
+ * See sharedplancache.c for comments.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedplancache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDPLANCACHE_H
+#define SHAREDPLANCACHE_H
+
+#include "nodes/pg_list.h"
+#include "storage/sinval.h"
+#include "utils/plancache.h"
+
+/*
+ * Hash key of a shared plan.  hashvalue covers the statement's identity
+ * data (see sharedplancache.c), which is kept with the entry and compared
+ * in full on lookup.
+ */
+typedef struct SharedPlanKey
+{
+	Oid			dbid;			/* database the plan was built in */
+	Oid			userid;			/* role the plan was built for */
+	uint32		hashvalue;		/* hash of the identity data */
+} SharedPlanKey;
+
+/*
+ * State carried from SharedPlanCacheLookup to SharedPlanCacheStore while
+ * a backend plans a statement the shared cache didn't have.
+ */
+typedef struct SharedPlanTag
+{
+	bool		shareable;		/* may the plan be stored at all? */
+	SharedPlanKey key;
+	char	   *ident;			/* identity data, palloc'd */
+	Size		ident_len;
+	uint64		inval_count;	/* invalidation counter seen at lookup */
+} SharedPlanTag;
+
+/* GUC parameter */
+extern int	shared_plan_cache_size;
+
+extern Size SharedPlanCacheShmemSize(void);
+extern void SharedPlanCacheShmemInit(void);
+
+extern List *SharedPlanCacheLookup(CachedPlanSource *plansource,
+					  SharedPlanTag *tag);
+extern void SharedPlanCacheStore(CachedPlanSource *plansource,
+					 SharedPlanTag *tag, List *stmt_list);
+extern void SharedPlanCacheInvalidate(const SharedInvalidationMessage *msgs,
+						  int n);
+
+#endif   /* SHAREDPLANCACHE_H */
@@ -93,6 +93,12 @@ typedef struct SnapshotData
 
 	CommandId	curcid;			/* in my xact, CID < curcid are visible */
 
+	/*
+	 * For a static snapshot filled in by GetSnapshotData(), the value of
+	 * xactCompletionCount when it was taken, or zero.
+	 */
+	uint64		snapXactCompletionCount;
+
 	/*
 	 * An extra return value for HeapTupleSatisfiesDirty, not used in MVCC
 	 * snapshots.
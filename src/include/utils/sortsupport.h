@@ -204,6 +204,14 @@ extern int ApplySortComparator(Datum datum1, bool isNull1,
 extern int ApplySortAbbrevFullComparator(Datum datum1, bool isNull1,
 							  Datum datum2, bool isNull2,
 							  SortSupport ssup);
+extern int ApplyInt32SortComparator(Datum datum1, bool isNull1,
+						 Datum datum2, bool isNull2,
+						 SortSupport ssup);
+#if SIZEOF_DATUM >= 8
+extern int ApplySignedSortComparator(Datum datum1, bool isNull1,
+						  Datum datum2, bool isNull2,
+						  SortSupport ssup);
+#endif
 #endif   /* !PG_USE_INLINE */
 #if defined(PG_USE_INLINE) || defined(SORTSUPPORT_INCLUDE_DEFINITIONS)
 /*
@@ -280,12 +288,106 @@ ApplySortAbbrevFullComparator(Datum datum1, bool isNull1,
 
 	return compare;
 }
+
+/*
+ * Like ApplySortComparator, for a comparator known to be
+ * ssup_datum_int32_cmp, so that the comparison itself is inlined too.
+ */
+STATIC_IF_INLINE int
+ApplyInt32SortComparator(Datum datum1, bool isNull1,
+						 Datum datum2, bool isNull2,
+						 SortSupport ssup)
+{
+	int			compare;
+
+	if (isNull1)
+	{
+		if (isNull2)
+			compare = 0;		/* NULL "=" NULL */
+		else if (ssup->ssup_nulls_first)
+			compare = -1;		/* NULL "<" NOT_NULL */
+		else
+			compare = 1;		/* NULL ">" NOT_NULL */
+	}
+	else if (isNull2)
+	{
+		if (ssup->ssup_nulls_first)
+			compare = 1;		/* NOT_NULL ">" NULL */
+		else
+			compare = -1;		/* NOT_NULL "<" NULL */
+	}
+	else
+	{
+		int32		a = DatumGetInt32(datum1);
+		int32		b = DatumGetInt32(datum2);
+
+		compare = (a > b) ? 1 : ((a < b) ? -1 : 0);
+		if (ssup->ssup_reverse)
+			compare = -compare;
+	}
+
+	return compare;
+}
+
+#if SIZEOF_DATUM >= 8
+/*
+ * Like ApplySortComparator, for a comparator known to be
+ * ssup_datum_signed_cmp.
+ */
+STATIC_IF_INLINE int
+ApplySignedSortComparator(Datum datum1, bool isNull1,
+						  Datum datum2, bool isNull2,
+						  SortSupport ssup)
+{
+	int			compare;
+
+	if (isNull1)
+	{
+		if (isNull2)
+			compare = 0;		/* NULL "=" NULL */
+		else if (ssup->ssup_nulls_first)
+			compare = -1;		/* NULL "<" NOT_NULL */
+		else
+			compare = 1;		/* NULL ">" NOT_NULL */
+	}
+	else if (isNull2)
+	{
+		if (ssup->ssup_nulls_first)
+			compare = 1;		/* NOT_NULL ">" NULL */
+		else
+			compare = -1;		/* NOT_NULL "<" NULL */
+	}
+	else
+	{
+		int64		a = DatumGetInt64(datum1);
+		int64		b = DatumGetInt64(datum2);
+
+		compare = (a > b) ? 1 : ((a < b) ? -1 : 0);
+		if (ssup->ssup_reverse)
+			compare = -compare;
+	}
+
+	return compare;
+}
+#endif   /* SIZEOF_DATUM >= 8 */
 #endif   /*-- PG_USE_INLINE || SORTSUPPORT_INCLUDE_DEFINITIONS */
 
+/*
+ * Comparators for datatypes whose values can be compared as plain integers.
+ * tuplesort.c recognizes these, and uses specialized sort routines that
+ * inline them; so datatypes should use one of these where possible.
+ */
+extern int	ssup_datum_int32_cmp(Datum x, Datum y, SortSupport ssup);
+#if SIZEOF_DATUM >= 8
+extern int	ssup_datum_signed_cmp(Datum x, Datum y, SortSupport ssup);
+#endif
+
 /* Other functions in utils/sort/sortsupport.c */
 extern void PrepareSortSupportComparisonShim(Oid cmpFunc, SortSupport ssup);
 extern void PrepareSortSupportFromOrderingOp(Oid orderingOp, SortSupport ssup);
 extern void PrepareSortSupportFromIndexRel(Relation indexRel, int16 strategy,
 							   SortSupport ssup);
+extern void PrepareSortSupportFromGistIndexRel(Relation indexRel,
+								   SortSupport ssup);
 
 #endif   /* SORTSUPPORT_H */
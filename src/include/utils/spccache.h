@@ -15,5 +15,6 @@
 
 void get_tablespace_page_costs(Oid spcid, float8 *spc_random_page_cost,
 						  float8 *spc_seq_page_cost);
+int			get_tablespace_autovac_cost_limit(Oid spcid);
 
 #endif   /* SPCCACHE_H */
@@ -74,13 +74,21 @@ enum SysCacheIdentifier
 	OPFAMILYOID,
 	PROCNAMEARGSNSP,
 	PROCOID,
+	PUBLICATIONNAME,
+	PUBLICATIONOID,
+	PUBLICATIONREL,
+	PUBLICATIONRELMAP,
 	RANGETYPE,
 	RELNAMENSP,
 	RELOID,
 	REPLORIGIDENT,
 	REPLORIGNAME,
 	RULERELNAME,
+	STATEXTNAMENSP,
+	STATEXTOID,
 	STATRELATTINH,
+	SUBSCRIPTIONNAME,
+	SUBSCRIPTIONOID,
 	TABLESPACEOID,
 	TRFOID,
 	TRFTYPELANG,
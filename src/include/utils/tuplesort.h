@@ -56,6 +56,14 @@ typedef struct Tuplesortstate Tuplesortstate;
  *
  * The "index_hash" API is similar to index_btree, but the tuples are
  * actually sorted by their hash codes not the raw data.
+ *
+ * The "index_gist" API is also similar to index_btree, but the sort order
+ * is the one given by the GiST opclasses' sortsupport functions, typically
+ * a space-filling curve over the compressed keys.
+ *
+ * The "index_gin" API sorts the GIN entry tuples that parallel GIN build
+ * workers make, each holding a key and some of its heap TIDs, into the order
+ * of the keys in the index.  Tuples are added with tuplesort_putindextuple.
  */
 
 extern Tuplesortstate *tuplesort_begin_heap(TupleDesc tupDesc,
@@ -74,6 +82,12 @@ extern Tuplesortstate *tuplesort_begin_index_hash(Relation heapRel,
 						   Relation indexRel,
 						   uint32 hash_mask,
 						   int workMem, bool randomAccess);
+extern Tuplesortstate *tuplesort_begin_index_gist(Relation heapRel,
+						   Relation indexRel,
+						   int workMem, bool randomAccess);
+extern Tuplesortstate *tuplesort_begin_index_gin(Relation heapRel,
+						  Relation indexRel,
+						  int workMem, bool randomAccess);
 extern Tuplesortstate *tuplesort_begin_datum(Oid datumType,
 					  Oid sortOperator, Oid sortCollation,
 					  bool nullsFirstFlag,
@@ -84,6 +98,7 @@ extern void tuplesort_set_bound(Tuplesortstate *state, int64 bound);
 extern void tuplesort_puttupleslot(Tuplesortstate *state,
 					   TupleTableSlot *slot);
 extern void tuplesort_putheaptuple(Tuplesortstate *state, HeapTuple tup);
+extern void tuplesort_putindextuple(Tuplesortstate *state, IndexTuple tuple);
 extern void tuplesort_putindextuplevalues(Tuplesortstate *state,
 							  Relation rel, ItemPointer self,
 							  Datum *values, bool *isnull);
@@ -110,6 +125,20 @@ extern void tuplesort_get_stats(Tuplesortstate *state,
 					const char **sortMethod,
 					const char **spaceType,
 					long *spaceUsed);
+extern Size tuplesort_get_peak_memory(Tuplesortstate *state);
+
+/*
+ * Parallel sort support; for the CLUSTER, index_btree and index_gin APIs only.
+ */
+struct shm_mq_handle;
+
+extern void tuplesort_send_sorted(Tuplesortstate *state,
+					  struct shm_mq_handle *mqh);
+extern int64 tuplesort_receive_sorted(Tuplesortstate *state,
+						 struct shm_mq_handle *mqh);
+extern void tuplesort_merge_sorted(Tuplesortstate *state,
+					   struct shm_mq_handle **queues, int nqueues,
+					   Tuplesortstate *localsort);
 
 extern int	tuplesort_merge_order(int64 allowedMem);
 
@@ -281,6 +281,10 @@ static const internalPQconninfoOption PQconninfoOptions[] = {
 		"Require-Peer", "", 10,
 	offsetof(struct pg_conn, requirepeer)},
 
+	{"compression", "PGCOMPRESSION", "0", NULL,
+		"Compression", "", 10,	/* should be '0', '1' or algorithms */
+	offsetof(struct pg_conn, compression)},
+
 #if defined(ENABLE_GSS) || defined(ENABLE_SSPI)
 	/* Kerberos and GSSAPI authentication support specifying the service name */
 	{"krbsrvname", "PGKRBSRVNAME", PG_KRB_SRVNAM, NULL,
@@ -337,8 +341,10 @@ static int	connectDBComplete(PGconn *conn);
 static PGPing internal_ping(PGconn *conn);
 static PGconn *makeEmptyPGconn(void);
 static bool fillPGconn(PGconn *conn, PQconninfoOption *connOptions);
+static bool parse_compression_option(PGconn *conn);
 static void freePGconn(PGconn *conn);
 static void closePGconn(PGconn *conn);
+static void pqFreeCommandQueue(PGcmdQueueEntry *queue);
 static PQconninfoOption *conninfo_init(PQExpBuffer errorMessage);
 static PQconninfoOption *parse_connection_string(const char *conninfo,
 						PQExpBuffer errorMessage, bool use_defaults);
@@ -404,6 +410,12 @@ pqDropConnection(PGconn *conn, bool flushInput)
 {
 	/* Drop any SSL state */
 	pqsecure_close(conn);
+	/* ... and the compression stream, which is layered over it */
+	if (conn->zstream)
+	{
+		zpq_free(conn->zstream);
+		conn->zstream = NULL;
+	}
 	/* Close the socket itself */
 	if (conn->sock != PGINVALID_SOCKET)
 		closesocket(conn->sock);
@@ -416,6 +428,100 @@ pqDropConnection(PGconn *conn, bool flushInput)
 }
 
 
+/*
+ *		parse_compression_option
+ *
+ * Validate the compression option, and work out the list of algorithms to
+ * offer the server, best first: "0" means none, "1" means all those this
+ * build supports, and otherwise the option lists them.
+ *
+ * Returns false, with a message in conn->errorMessage, if the option asks
+ * for something this build can't do.
+ */
+static bool
+parse_compression_option(PGconn *conn)
+{
+	const char *value = conn->compression;
+	PQExpBufferData algorithms;
+	const char *p;
+
+	if (conn->compression_algorithms)
+	{
+		free(conn->compression_algorithms);
+		conn->compression_algorithms = NULL;
+	}
+
+	if (value == NULL || value[0] == '\0' || strcmp(value, "0") == 0)
+		return true;
+	if (strcmp(value, "1") == 0)
+	{
+		value = zpq_supported_algorithms();
+		if (value[0] == '\0')
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("compression is not supported by this build\n"));
+			return false;
+		}
+	}
+
+	initPQExpBuffer(&algorithms);
+	for (p = value; *p;)
+	{
+		const char *start;
+		char		name[32];
+		size_t		len;
+		const char *algorithm = NULL;
+
+		while (*p == ',' || *p == ' ')
+			p++;
+		start = p;
+		while (*p && *p != ',' && *p != ' ')
+			p++;
+		len = p - start;
+		if (len == 0)
+			continue;
+
+		if (len < sizeof(name))
+		{
+			memcpy(name, start, len);
+			name[len] = '\0';
+			algorithm = zpq_choose_algorithm(name);
+		}
+		if (algorithm == NULL)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("compression algorithm \"%.*s\" is not supported by this build\n"),
+							  (int) len, start);
+			termPQExpBuffer(&algorithms);
+			return false;
+		}
+
+		if (algorithms.len > 0)
+			appendPQExpBufferChar(&algorithms, ',');
+		appendPQExpBufferStr(&algorithms, algorithm);
+	}
+
+	if (PQExpBufferDataBroken(algorithms))
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("out of memory\n"));
+		termPQExpBuffer(&algorithms);
+		return false;
+	}
+	if (algorithms.len == 0)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("invalid compression value: \"%s\"\n"),
+						  conn->compression);
+		termPQExpBuffer(&algorithms);
+		return false;
+	}
+
+	conn->compression_algorithms = algorithms.data;
+	return true;
+}
+
+
 /*
  *		Connecting to a Database
  *
@@ -880,6 +986,15 @@ connectOptions2(PGconn *conn)
 			goto oom_error;
 	}
 
+	/*
+	 * validate compression option
+	 */
+	if (!parse_compression_option(conn))
+	{
+		conn->status = CONNECTION_BAD;
+		return false;
+	}
+
 	/*
 	 * Resolve special "auto" client_encoding from the locale
 	 */
@@ -2266,6 +2381,40 @@ keep_going:						/* We will come back to here until there is
 					return PGRES_POLLING_READING;
 				}
 
+				/*
+				 * If we asked for compression, the server may first confirm
+				 * the algorithm it chose.  Everything after that message is
+				 * compressed.
+				 */
+				if (beresp == 'z' && conn->compression_algorithms &&
+					conn->zstream == NULL &&
+					PG_PROTOCOL_MAJOR(conn->pversion) >= 3)
+				{
+					if (pqGetInt(&msgLength, 4, conn))
+					{
+						/* We'll come back when there is more data */
+						return PGRES_POLLING_READING;
+					}
+					if (msgLength < 5 || msgLength > 100)
+					{
+						appendPQExpBuffer(&conn->errorMessage,
+										  libpq_gettext("invalid compression acknowledgement from server\n"));
+						goto error_return;
+					}
+					if (pqGets(&conn->workBuffer, conn))
+					{
+						/* We'll come back when there is more data */
+						return PGRES_POLLING_READING;
+					}
+					/* OK, we read the message; mark data consumed */
+					conn->inStart = conn->inCursor;
+
+					if (!pqsecure_enable_compression(conn,
+													 conn->workBuffer.data))
+						goto error_return;
+					goto keep_going;
+				}
+
 				/*
 				 * Validate message type: we expect only an authentication
 				 * request or an error here.  Anything else probably means
@@ -2784,6 +2933,7 @@ makeEmptyPGconn(void)
 
 	conn->status = CONNECTION_BAD;
 	conn->asyncStatus = PGASYNC_IDLE;
+	conn->pipelineStatus = PQ_PIPELINE_OFF;
 	conn->xactStatus = PQTRANS_IDLE;
 	conn->options_valid = false;
 	conn->nonblocking = false;
@@ -2912,6 +3062,10 @@ freePGconn(PGconn *conn)
 		free(conn->sslcompression);
 	if (conn->requirepeer)
 		free(conn->requirepeer);
+	if (conn->compression)
+		free(conn->compression);
+	if (conn->compression_algorithms)
+		free(conn->compression_algorithms);
 #if defined(ENABLE_GSS) || defined(ENABLE_SSPI)
 	if (conn->krbsrvname)
 		free(conn->krbsrvname);
@@ -2923,6 +3077,8 @@ freePGconn(PGconn *conn)
 	/* Note that conn->Pfdebug is not ours to close or free */
 	if (conn->last_query)
 		free(conn->last_query);
+	pqFreeCommandQueue(conn->cmd_queue_head);
+	pqFreeCommandQueue(conn->cmd_queue_recycle);
 	if (conn->inBuffer)
 		free(conn->inBuffer);
 	if (conn->outBuffer)
@@ -2939,6 +3095,24 @@ freePGconn(PGconn *conn)
 #endif
 }
 
+/*
+ * pqFreeCommandQueue
+ * Free all the entries of PGcmdQueueEntry queue passed.
+ */
+static void
+pqFreeCommandQueue(PGcmdQueueEntry *queue)
+{
+	while (queue != NULL)
+	{
+		PGcmdQueueEntry *cur = queue;
+
+		queue = cur->next;
+		if (cur->query)
+			free(cur->query);
+		free(cur);
+	}
+}
+
 /*
  * closePGconn
  *	 - properly close a connection to the backend
@@ -2983,6 +3157,9 @@ closePGconn(PGconn *conn)
 	conn->status = CONNECTION_BAD;		/* Well, not really _bad_ - just
 										 * absent */
 	conn->asyncStatus = PGASYNC_IDLE;
+	conn->pipelineStatus = PQ_PIPELINE_OFF;
+	pqFreeCommandQueue(conn->cmd_queue_head);
+	conn->cmd_queue_head = conn->cmd_queue_tail = NULL;
 	pqClearAsyncResult(conn);	/* deallocate result */
 	resetPQExpBuffer(&conn->errorMessage);
 	pg_freeaddrinfo_all(conn->addrlist_family, conn->addrlist);
@@ -5404,6 +5581,15 @@ PQtransactionStatus(const PGconn *conn)
 	return conn->xactStatus;
 }
 
+PGpipelineStatus
+PQpipelineStatus(const PGconn *conn)
+{
+	if (!conn)
+		return PQ_PIPELINE_OFF;
+
+	return conn->pipelineStatus;
+}
+
 const char *
 PQparameterStatus(const PGconn *conn, const char *paramName)
 {
@@ -5473,6 +5659,49 @@ PQbackendPID(const PGconn *conn)
 	return conn->be_pid;
 }
 
+/*
+ * PQcompression
+ *		Name of the protocol compression algorithm in use, or NULL.
+ */
+const char *
+PQcompression(const PGconn *conn)
+{
+	if (!conn || conn->zstream == NULL)
+		return NULL;
+	return zpq_algorithm(conn->zstream);
+}
+
+/*
+ * PQcompressionStats
+ *		Report the number of bytes sent and received, before compression and
+ *		as they went over the wire.  Returns 0 if compression is not in use.
+ */
+int
+PQcompressionStats(const PGconn *conn,
+				   pg_int64 *rawSent, pg_int64 *sent,
+				   pg_int64 *rawReceived, pg_int64 *received)
+{
+	uint64		raw_sent,
+				total_sent,
+				raw_received,
+				total_received;
+
+	if (!conn || conn->zstream == NULL)
+		return 0;
+
+	zpq_get_counters(conn->zstream, &raw_sent, &total_sent,
+					 &raw_received, &total_received);
+	if (rawSent)
+		*rawSent = (pg_int64) raw_sent;
+	if (sent)
+		*sent = (pg_int64) total_sent;
+	if (rawReceived)
+		*rawReceived = (pg_int64) raw_received;
+	if (received)
+		*received = (pg_int64) total_received;
+	return 1;
+}
+
 int
 PQconnectionNeedsPassword(const PGconn *conn)
 {
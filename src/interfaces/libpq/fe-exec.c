@@ -42,13 +42,21 @@ char	   *const pgresStatus[] = {
 	"PGRES_NONFATAL_ERROR",
 	"PGRES_FATAL_ERROR",
 	"PGRES_COPY_BOTH",
-	"PGRES_SINGLE_TUPLE"
+	"PGRES_SINGLE_TUPLE",
+	"PGRES_PIPELINE_SYNC",
+	"PGRES_PIPELINE_ABORTED"
 };
 
 /*
  * static state needed by PQescapeString and PQescapeBytea; initialize to
  * values that result in backward-compatible behavior
  */
+/*
+ * In pipeline mode, output is only pushed to the server once this much has
+ * accumulated (or the application asks for it).
+ */
+#define OUTBUFFER_THRESHOLD	65536
+
 static int	static_client_encoding = PG_SQL_ASCII;
 static bool static_std_strings = false;
 
@@ -56,6 +64,12 @@ static bool static_std_strings = false;
 static PGEvent *dupEvents(PGEvent *events, int count);
 static bool pqAddTuple(PGresult *res, PGresAttValue *tup);
 static bool PQsendQueryStart(PGconn *conn);
+static PGcmdQueueEntry *pqAllocCmdQueueEntry(PGconn *conn);
+static void pqRecycleCmdQueueEntry(PGconn *conn, PGcmdQueueEntry *entry);
+static void pqAppendCmdQueueEntry(PGconn *conn, PGcmdQueueEntry *entry);
+static void pqBeginCommand(PGconn *conn);
+static void pqPipelineProcessQueue(PGconn *conn);
+static int	pqPipelineFlush(PGconn *conn);
 static int PQsendQueryGuts(PGconn *conn,
 				const char *command,
 				const char *stmtName,
@@ -1126,6 +1140,14 @@ PQsendQuery(PGconn *conn, const char *query)
 		return 0;
 	}
 
+	/* the simple query protocol can't be mixed with pipelined commands */
+	if (conn->pipelineStatus != PQ_PIPELINE_OFF)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+				libpq_gettext("PQsendQuery not allowed in pipeline mode\n"));
+		return 0;
+	}
+
 	/* construct the outgoing Query message */
 	if (pqPutMsgStart('Q', false, conn) < 0 ||
 		pqPuts(query, conn) < 0 ||
@@ -1213,6 +1235,8 @@ PQsendPrepare(PGconn *conn,
 			  const char *stmtName, const char *query,
 			  int nParams, const Oid *paramTypes)
 {
+	PGcmdQueueEntry *entry;
+
 	if (!PQsendQueryStart(conn))
 		return 0;
 
@@ -1244,6 +1268,10 @@ PQsendPrepare(PGconn *conn,
 		return 0;
 	}
 
+	entry = pqAllocCmdQueueEntry(conn);
+	if (entry == NULL)
+		return 0;
+
 	/* construct the Parse message */
 	if (pqPutMsgStart('P', false, conn) < 0 ||
 		pqPuts(stmtName, conn) < 0 ||
@@ -1270,32 +1298,34 @@ PQsendPrepare(PGconn *conn,
 	if (pqPutMsgEnd(conn) < 0)
 		goto sendFailed;
 
-	/* construct the Sync message */
-	if (pqPutMsgStart('S', false, conn) < 0 ||
-		pqPutMsgEnd(conn) < 0)
-		goto sendFailed;
+	/* construct the Sync message, unless the application sends its own */
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF)
+	{
+		if (pqPutMsgStart('S', false, conn) < 0 ||
+			pqPutMsgEnd(conn) < 0)
+			goto sendFailed;
+	}
 
 	/* remember we are doing just a Parse */
-	conn->queryclass = PGQUERY_PREPARE;
+	entry->queryclass = PGQUERY_PREPARE;
 
 	/* and remember the query text too, if possible */
-	/* if insufficient memory, last_query just winds up NULL */
-	if (conn->last_query)
-		free(conn->last_query);
-	conn->last_query = strdup(query);
+	/* if insufficient memory, query just winds up NULL */
+	entry->query = strdup(query);
 
 	/*
 	 * Give the data a push.  In nonblock mode, don't complain if we're unable
 	 * to send it all; PQgetResult() will do any additional flushing needed.
 	 */
-	if (pqFlush(conn) < 0)
+	if (pqPipelineFlush(conn) < 0)
 		goto sendFailed;
 
 	/* OK, it's launched! */
-	conn->asyncStatus = PGASYNC_BUSY;
+	pqAppendCmdQueueEntry(conn, entry);
 	return 1;
 
 sendFailed:
+	pqRecycleCmdQueueEntry(conn, entry);
 	pqHandleSendFailure(conn);
 	return 0;
 }
@@ -1361,25 +1391,220 @@ PQsendQueryStart(PGconn *conn)
 						  libpq_gettext("no connection to the server\n"));
 		return false;
 	}
-	/* Can't send while already busy, either. */
-	if (conn->asyncStatus != PGASYNC_IDLE)
+
+	/*
+	 * Can't send while already busy, either, unless we're in pipeline mode,
+	 * in which case the command is queued behind the ones already sent.
+	 */
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF)
 	{
-		printfPQExpBuffer(&conn->errorMessage,
+		if (conn->asyncStatus != PGASYNC_IDLE)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
 				  libpq_gettext("another command is already in progress\n"));
-		return false;
+			return false;
+		}
+	}
+	else
+	{
+		switch (conn->asyncStatus)
+		{
+			case PGASYNC_IDLE:
+			case PGASYNC_PIPELINE_IDLE:
+			case PGASYNC_READY:
+			case PGASYNC_BUSY:
+				/* OK to queue */
+				break;
+			case PGASYNC_COPY_IN:
+			case PGASYNC_COPY_OUT:
+			case PGASYNC_COPY_BOTH:
+				printfPQExpBuffer(&conn->errorMessage,
+						 libpq_gettext("cannot queue commands during COPY\n"));
+				return false;
+		}
 	}
 
-	/* initialize async result-accumulation state */
-	conn->result = NULL;
-	conn->next_result = NULL;
+	/*
+	 * Initialize async result-accumulation state, unless the results of an
+	 * earlier pipelined command are still being collected.
+	 */
+	if (conn->asyncStatus == PGASYNC_IDLE)
+	{
+		conn->result = NULL;
+		conn->next_result = NULL;
 
-	/* reset single-row processing mode */
-	conn->singleRowMode = false;
+		/* reset single-row processing mode */
+		conn->singleRowMode = false;
+	}
 
 	/* ready to send command message */
 	return true;
 }
 
+/*
+ * pqAllocCmdQueueEntry
+ *		Get a command queue entry for the caller to fill in.
+ *
+ * Entries are taken from the connection's recycle list if possible.  On
+ * failure, conn->errorMessage is set and NULL is returned.
+ */
+static PGcmdQueueEntry *
+pqAllocCmdQueueEntry(PGconn *conn)
+{
+	PGcmdQueueEntry *entry;
+
+	if (conn->cmd_queue_recycle == NULL)
+	{
+		entry = (PGcmdQueueEntry *) malloc(sizeof(PGcmdQueueEntry));
+		if (entry == NULL)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("out of memory\n"));
+			return NULL;
+		}
+	}
+	else
+	{
+		entry = conn->cmd_queue_recycle;
+		conn->cmd_queue_recycle = entry->next;
+	}
+	entry->next = NULL;
+	entry->query = NULL;
+
+	return entry;
+}
+
+/*
+ * pqRecycleCmdQueueEntry
+ *		Push a command queue entry onto the connection's recycle list.
+ */
+static void
+pqRecycleCmdQueueEntry(PGconn *conn, PGcmdQueueEntry *entry)
+{
+	if (entry == NULL)
+		return;
+
+	if (entry->query)
+	{
+		free(entry->query);
+		entry->query = NULL;
+	}
+
+	entry->next = conn->cmd_queue_recycle;
+	conn->cmd_queue_recycle = entry;
+}
+
+/*
+ * pqAppendCmdQueueEntry
+ *		Record a command that has just been sent to the server.
+ *
+ * If no command is in progress, the new one becomes the current command
+ * (conn->queryclass and conn->last_query) right away.  Otherwise, which
+ * can only happen in pipeline mode, it waits in the queue until the results
+ * of the commands sent before it have been consumed.
+ */
+static void
+pqAppendCmdQueueEntry(PGconn *conn, PGcmdQueueEntry *entry)
+{
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF ||
+		conn->asyncStatus == PGASYNC_IDLE)
+	{
+		Assert(conn->cmd_queue_head == NULL);
+
+		conn->queryclass = entry->queryclass;
+		if (conn->last_query)
+			free(conn->last_query);
+		conn->last_query = entry->query;
+		entry->query = NULL;
+		pqRecycleCmdQueueEntry(conn, entry);
+
+		pqBeginCommand(conn);
+		return;
+	}
+
+	if (conn->cmd_queue_tail == NULL)
+		conn->cmd_queue_head = entry;
+	else
+		conn->cmd_queue_tail->next = entry;
+	conn->cmd_queue_tail = entry;
+}
+
+/*
+ * pqBeginCommand
+ *		Start collecting the results of the current command.
+ *
+ * If an earlier command of the pipeline failed, the server will skip
+ * everything up to the next Sync, so the result is known already.
+ */
+static void
+pqBeginCommand(PGconn *conn)
+{
+	if (conn->pipelineStatus == PQ_PIPELINE_ABORTED &&
+		conn->queryclass != PGQUERY_SYNC)
+	{
+		conn->result = PQmakeEmptyPGresult(conn, PGRES_PIPELINE_ABORTED);
+		if (!conn->result)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("out of memory\n"));
+			pqSaveErrorResult(conn);
+		}
+		conn->asyncStatus = PGASYNC_READY;
+	}
+	else
+		conn->asyncStatus = PGASYNC_BUSY;
+}
+
+/*
+ * pqPipelineProcessQueue
+ *		Advance to the next queued command, once all the results of the
+ *		current one have been consumed.
+ */
+static void
+pqPipelineProcessQueue(PGconn *conn)
+{
+	PGcmdQueueEntry *entry = conn->cmd_queue_head;
+
+	if (entry == NULL)
+	{
+		conn->asyncStatus = PGASYNC_IDLE;
+		return;
+	}
+
+	conn->cmd_queue_head = entry->next;
+	if (conn->cmd_queue_head == NULL)
+		conn->cmd_queue_tail = NULL;
+
+	conn->queryclass = entry->queryclass;
+	if (conn->last_query)
+		free(conn->last_query);
+	conn->last_query = entry->query;
+	entry->query = NULL;
+	pqRecycleCmdQueueEntry(conn, entry);
+
+	/* initialize async result-accumulation state for the new command */
+	pqClearAsyncResult(conn);
+	resetPQExpBuffer(&conn->errorMessage);
+	conn->singleRowMode = false;
+
+	pqBeginCommand(conn);
+}
+
+/*
+ * pqPipelineFlush
+ *		Give the data a push, except that in pipeline mode we let the output
+ *		buffer fill up some before sending, so that many small commands can
+ *		go out in a few packets.
+ */
+static int
+pqPipelineFlush(PGconn *conn)
+{
+	if (conn->pipelineStatus != PQ_PIPELINE_ON ||
+		conn->outCount >= OUTBUFFER_THRESHOLD)
+		return pqFlush(conn);
+	return 0;
+}
+
 /*
  * PQsendQueryGuts
  *		Common code for protocol-3.0 query sending
@@ -1399,6 +1624,7 @@ PQsendQueryGuts(PGconn *conn,
 				int resultFormat)
 {
 	int			i;
+	PGcmdQueueEntry *entry;
 
 	/* This isn't gonna work on a 2.0 server */
 	if (PG_PROTOCOL_MAJOR(conn->pversion) < 3)
@@ -1408,6 +1634,10 @@ PQsendQueryGuts(PGconn *conn,
 		return 0;
 	}
 
+	entry = pqAllocCmdQueueEntry(conn);
+	if (entry == NULL)
+		return 0;
+
 	/*
 	 * We will send Parse (if needed), Bind, Describe Portal, Execute, Sync,
 	 * using specified statement name and the unnamed portal.
@@ -1520,35 +1750,35 @@ PQsendQueryGuts(PGconn *conn,
 		pqPutMsgEnd(conn) < 0)
 		goto sendFailed;
 
-	/* construct the Sync message */
-	if (pqPutMsgStart('S', false, conn) < 0 ||
-		pqPutMsgEnd(conn) < 0)
-		goto sendFailed;
+	/* construct the Sync message, unless the application sends its own */
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF)
+	{
+		if (pqPutMsgStart('S', false, conn) < 0 ||
+			pqPutMsgEnd(conn) < 0)
+			goto sendFailed;
+	}
 
 	/* remember we are using extended query protocol */
-	conn->queryclass = PGQUERY_EXTENDED;
+	entry->queryclass = PGQUERY_EXTENDED;
 
 	/* and remember the query text too, if possible */
-	/* if insufficient memory, last_query just winds up NULL */
-	if (conn->last_query)
-		free(conn->last_query);
+	/* if insufficient memory, query just winds up NULL */
 	if (command)
-		conn->last_query = strdup(command);
-	else
-		conn->last_query = NULL;
+		entry->query = strdup(command);
 
 	/*
 	 * Give the data a push.  In nonblock mode, don't complain if we're unable
 	 * to send it all; PQgetResult() will do any additional flushing needed.
 	 */
-	if (pqFlush(conn) < 0)
+	if (pqPipelineFlush(conn) < 0)
 		goto sendFailed;
 
 	/* OK, it's launched! */
-	conn->asyncStatus = PGASYNC_BUSY;
+	pqAppendCmdQueueEntry(conn, entry);
 	return 1;
 
 sendFailed:
+	pqRecycleCmdQueueEntry(conn, entry);
 	pqHandleSendFailure(conn);
 	return 0;
 }
@@ -1720,6 +1950,17 @@ PQgetResult(PGconn *conn)
 			 */
 			pqSaveErrorResult(conn);
 			conn->asyncStatus = PGASYNC_IDLE;
+
+			/* whatever was queued behind the current command is lost too */
+			while (conn->cmd_queue_head != NULL)
+			{
+				PGcmdQueueEntry *entry = conn->cmd_queue_head;
+
+				conn->cmd_queue_head = entry->next;
+				pqRecycleCmdQueueEntry(conn, entry);
+			}
+			conn->cmd_queue_tail = NULL;
+
 			return pqPrepareAsyncResult(conn);
 		}
 
@@ -1733,10 +1974,43 @@ PQgetResult(PGconn *conn)
 		case PGASYNC_IDLE:
 			res = NULL;			/* query is complete */
 			break;
+		case PGASYNC_PIPELINE_IDLE:
+			Assert(conn->pipelineStatus != PQ_PIPELINE_OFF);
+
+			/*
+			 * All results of the current pipelined command have been
+			 * returned; report that with a NULL and move on to the next one.
+			 */
+			pqPipelineProcessQueue(conn);
+			res = NULL;
+			break;
 		case PGASYNC_READY:
 			res = pqPrepareAsyncResult(conn);
-			/* Set the state back to BUSY, allowing parsing to proceed. */
-			conn->asyncStatus = PGASYNC_BUSY;
+			if (conn->pipelineStatus == PQ_PIPELINE_OFF ||
+				res == NULL)
+			{
+				/* Set the state back to BUSY, allowing parsing to proceed. */
+				conn->asyncStatus = PGASYNC_BUSY;
+			}
+			else if (res->resultStatus == PGRES_PIPELINE_SYNC)
+			{
+				/* a sync point is not followed by a NULL result */
+				pqPipelineProcessQueue(conn);
+			}
+			else if (res->resultStatus == PGRES_SINGLE_TUPLE ||
+					 conn->queryclass == PGQUERY_SYNC)
+			{
+				/* more results of this same command are still to come */
+				conn->asyncStatus = PGASYNC_BUSY;
+			}
+			else
+			{
+				/*
+				 * The server sends nothing more for this command in pipeline
+				 * mode, because there's no Sync message behind it.
+				 */
+				conn->asyncStatus = PGASYNC_PIPELINE_IDLE;
+			}
 			break;
 		case PGASYNC_COPY_IN:
 			res = getCopyResult(conn, PGRES_COPY_IN);
@@ -1914,6 +2188,13 @@ PQexecStart(PGconn *conn)
 	if (!conn)
 		return false;
 
+	if (conn->pipelineStatus != PQ_PIPELINE_OFF)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("synchronous command execution functions are not allowed in pipeline mode\n"));
+		return false;
+	}
+
 	/*
 	 * Silently discard any prior query result that application didn't eat.
 	 * This is probably poor design, but it's here for backward compatibility.
@@ -2108,6 +2389,8 @@ PQsendDescribePortal(PGconn *conn, const char *portal)
 static int
 PQsendDescribe(PGconn *conn, char desc_type, const char *desc_target)
 {
+	PGcmdQueueEntry *entry;
+
 	/* Treat null desc_target as empty string */
 	if (!desc_target)
 		desc_target = "";
@@ -2123,6 +2406,10 @@ PQsendDescribe(PGconn *conn, char desc_type, const char *desc_target)
 		return 0;
 	}
 
+	entry = pqAllocCmdQueueEntry(conn);
+	if (entry == NULL)
+		return 0;
+
 	/* construct the Describe message */
 	if (pqPutMsgStart('D', false, conn) < 0 ||
 		pqPutc(desc_type, conn) < 0 ||
@@ -2130,37 +2417,245 @@ PQsendDescribe(PGconn *conn, char desc_type, const char *desc_target)
 		pqPutMsgEnd(conn) < 0)
 		goto sendFailed;
 
-	/* construct the Sync message */
-	if (pqPutMsgStart('S', false, conn) < 0 ||
-		pqPutMsgEnd(conn) < 0)
+	/* construct the Sync message, unless the application sends its own */
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF)
+	{
+		if (pqPutMsgStart('S', false, conn) < 0 ||
+			pqPutMsgEnd(conn) < 0)
+			goto sendFailed;
+	}
+
+	/* remember we are doing a Describe (the query string is not relevant) */
+	entry->queryclass = PGQUERY_DESCRIBE;
+
+	/*
+	 * Give the data a push.  In nonblock mode, don't complain if we're unable
+	 * to send it all; PQgetResult() will do any additional flushing needed.
+	 */
+	if (pqPipelineFlush(conn) < 0)
 		goto sendFailed;
 
-	/* remember we are doing a Describe */
-	conn->queryclass = PGQUERY_DESCRIBE;
+	/* OK, it's launched! */
+	pqAppendCmdQueueEntry(conn, entry);
+	return 1;
 
-	/* reset last-query string (not relevant now) */
-	if (conn->last_query)
+sendFailed:
+	pqRecycleCmdQueueEntry(conn, entry);
+	pqHandleSendFailure(conn);
+	return 0;
+}
+
+/*
+ * PQenterPipelineMode
+ *		Put an idle connection in pipeline mode.
+ *
+ * In pipeline mode, the application can send commands without waiting for
+ * the results of the previous ones; the results are collected in order with
+ * PQgetResult, each command's results being followed by a NULL.  Commands
+ * are not followed by Sync messages: the application calls PQpipelineSync
+ * to mark the end of a group of commands that are to succeed or fail
+ * together.
+ *
+ * Returns 1 on success; on failure, conn->errorMessage is set and 0 is
+ * returned.  Entering pipeline mode when already in it is a no-op.
+ */
+int
+PQenterPipelineMode(PGconn *conn)
+{
+	if (!conn)
+		return 0;
+
+	/* succeed with no action if already in pipeline mode */
+	if (conn->pipelineStatus != PQ_PIPELINE_OFF)
+		return 1;
+
+	if (PG_PROTOCOL_MAJOR(conn->pversion) < 3)
 	{
-		free(conn->last_query);
-		conn->last_query = NULL;
+		printfPQExpBuffer(&conn->errorMessage,
+		 libpq_gettext("pipeline mode requires at least protocol version 3.0\n"));
+		return 0;
+	}
+
+	if (conn->asyncStatus != PGASYNC_IDLE)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("cannot enter pipeline mode, connection not idle\n"));
+		return 0;
+	}
+
+	conn->pipelineStatus = PQ_PIPELINE_ON;
+
+	return 1;
+}
+
+/*
+ * PQexitPipelineMode
+ *		Leave pipeline mode, once all results have been collected.
+ *
+ * Returns 1 on success; on failure, conn->errorMessage is set and 0 is
+ * returned.  Leaving pipeline mode when not in it is a no-op.
+ */
+int
+PQexitPipelineMode(PGconn *conn)
+{
+	if (!conn)
+		return 0;
+
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF)
+		return 1;
+
+	switch (conn->asyncStatus)
+	{
+		case PGASYNC_READY:
+		case PGASYNC_BUSY:
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("cannot exit pipeline mode with uncollected results\n"));
+			return 0;
+
+		case PGASYNC_COPY_IN:
+		case PGASYNC_COPY_OUT:
+		case PGASYNC_COPY_BOTH:
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("cannot exit pipeline mode while in COPY\n"));
+			return 0;
+
+		case PGASYNC_IDLE:
+		case PGASYNC_PIPELINE_IDLE:
+			/* OK */
+			break;
 	}
 
+	/* still work to process */
+	if (conn->cmd_queue_head != NULL)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("cannot exit pipeline mode with uncollected results\n"));
+		return 0;
+	}
+
+	conn->pipelineStatus = PQ_PIPELINE_OFF;
+	conn->asyncStatus = PGASYNC_IDLE;
+
+	/* Flush any pending data in out buffer */
+	if (pqFlush(conn) < 0)
+		return 0;				/* error message is setup already */
+	return 1;
+}
+
+/*
+ * PQpipelineSync
+ *		Send a Sync message, marking the end of a group of pipelined commands.
+ *
+ * The server processes the commands up to this point as a unit: if one of
+ * them fails, the rest are skipped until the Sync, and their results are
+ * reported as PGRES_PIPELINE_ABORTED.  The Sync itself yields a result of
+ * status PGRES_PIPELINE_SYNC, which is not followed by a NULL.  The output
+ * buffer is flushed.
+ *
+ * Returns 1 on success, 0 on failure (conn->errorMessage is set).
+ */
+int
+PQpipelineSync(PGconn *conn)
+{
+	PGcmdQueueEntry *entry;
+
+	if (!conn)
+		return 0;
+
+	if (conn->pipelineStatus == PQ_PIPELINE_OFF)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("cannot send pipeline when not in pipeline mode\n"));
+		return 0;
+	}
+
+	switch (conn->asyncStatus)
+	{
+		case PGASYNC_COPY_IN:
+		case PGASYNC_COPY_OUT:
+		case PGASYNC_COPY_BOTH:
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("cannot send pipeline sync during COPY\n"));
+			return 0;
+		case PGASYNC_READY:
+		case PGASYNC_BUSY:
+		case PGASYNC_IDLE:
+		case PGASYNC_PIPELINE_IDLE:
+			/* OK to send sync */
+			break;
+	}
+
+	entry = pqAllocCmdQueueEntry(conn);
+	if (entry == NULL)
+		return 0;
+	entry->queryclass = PGQUERY_SYNC;
+
+	/* construct the Sync message */
+	if (pqPutMsgStart('S', false, conn) < 0 ||
+		pqPutMsgEnd(conn) < 0)
+		goto sendFailed;
+
 	/*
 	 * Give the data a push.  In nonblock mode, don't complain if we're unable
 	 * to send it all; PQgetResult() will do any additional flushing needed.
 	 */
-	if (pqFlush(conn) < 0)
+	if (PQflush(conn) < 0)
 		goto sendFailed;
 
 	/* OK, it's launched! */
-	conn->asyncStatus = PGASYNC_BUSY;
+	pqAppendCmdQueueEntry(conn, entry);
 	return 1;
 
 sendFailed:
-	pqHandleSendFailure(conn);
+	pqRecycleCmdQueueEntry(conn, entry);
+	/* error message should be set up already */
 	return 0;
 }
 
+/*
+ * PQsendFlushRequest
+ *		Send a Flush message, asking the server to send out the results of
+ *		the commands it has processed so far without waiting for a Sync.
+ *
+ * The message is sent along with the rest of the output buffer, so the
+ * application may still need to call PQflush.
+ *
+ * Returns 1 on success, 0 on failure (conn->errorMessage is set).
+ */
+int
+PQsendFlushRequest(PGconn *conn)
+{
+	if (!conn)
+		return 0;
+
+	/* Don't try to send if we know there's no live connection. */
+	if (conn->status != CONNECTION_OK)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("no connection to the server\n"));
+		return 0;
+	}
+
+	/* Can't send while already busy, either, unless enqueuing for later */
+	if (conn->asyncStatus != PGASYNC_IDLE &&
+		conn->pipelineStatus == PQ_PIPELINE_OFF)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+				  libpq_gettext("another command is already in progress\n"));
+		return 0;
+	}
+
+	if (pqPutMsgStart('H', false, conn) < 0 ||
+		pqPutMsgEnd(conn) < 0)
+		return 0;
+
+	/* Give the data a push if we're past the size threshold */
+	if (pqPipelineFlush(conn) < 0)
+		return 0;
+
+	return 1;
+}
+
 /*
  * PQnotifies
  *	  returns a PGnotify* structure of the latest async notification
@@ -2551,6 +3046,13 @@ PQfn(PGconn *conn,
 	/* clear the error string */
 	resetPQExpBuffer(&conn->errorMessage);
 
+	if (conn->pipelineStatus != PQ_PIPELINE_OFF)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("PQfn not allowed in pipeline mode\n"));
+		return NULL;
+	}
+
 	if (conn->sock == PGINVALID_SOCKET || conn->asyncStatus != PGASYNC_IDLE ||
 		conn->result != NULL)
 	{
@@ -62,6 +62,10 @@
 #include "pg_config_paths.h"
 
 
+/* Is there compressed output that could not be sent yet? */
+#define pqCompressionPending(conn) \
+	((conn)->zstream != NULL && zpq_buffered_tx((conn)->zstream) > 0)
+
 static int	pqPutMsgBytes(const void *buf, size_t len, PGconn *conn);
 static int	pqSendSome(PGconn *conn, int len);
 static int pqSocketCheck(PGconn *conn, int forRead, int forWrite,
@@ -731,6 +735,18 @@ retry3:
 			someread = 1;
 			goto retry3;
 		}
+
+		/*
+		 * Likewise, if the decompressor has more data for us, take it now:
+		 * it's not going to make the socket read-ready.
+		 */
+		if (conn->zstream && zpq_buffered_rx(conn->zstream) > 0 &&
+			((conn->inBufSize - conn->inEnd) >= 8192 ||
+			 pqCheckInBufferSpace(conn->inEnd + (size_t) 8192, conn) == 0))
+		{
+			someread = 1;
+			goto retry3;
+		}
 		return 1;
 	}
 
@@ -849,8 +865,12 @@ pqSendSome(PGconn *conn, int len)
 		return -1;
 	}
 
-	/* while there's still data to send */
-	while (len > 0)
+	/*
+	 * While there's still data to send.  With compression, that includes
+	 * compressed data the last write couldn't send, which a zero-length
+	 * write pushes out.
+	 */
+	while (len > 0 || pqCompressionPending(conn))
 	{
 		int			sent;
 
@@ -904,7 +924,7 @@ pqSendSome(PGconn *conn, int len)
 			remaining -= sent;
 		}
 
-		if (len > 0)
+		if (len > 0 || pqCompressionPending(conn))
 		{
 			/*
 			 * We didn't send it all, wait till we can send more.
@@ -971,7 +991,7 @@ pqFlush(PGconn *conn)
 	if (conn->Pfdebug)
 		fflush(conn->Pfdebug);
 
-	if (conn->outCount > 0)
+	if (conn->outCount > 0 || pqCompressionPending(conn))
 		return pqSendSome(conn, conn->outCount);
 
 	return 0;
@@ -1074,6 +1094,10 @@ pqSocketCheck(PGconn *conn, int forRead, int forWrite, time_t end_time)
 	}
 #endif
 
+	/* Likewise for the decompressor */
+	if (forRead && conn->zstream && zpq_buffered_rx(conn->zstream) > 0)
+		return 1;
+
 	/* We will retry as long as we get EINTR */
 	do
 		result = pqSocketPoll(conn->sock, forRead, forWrite, end_time);
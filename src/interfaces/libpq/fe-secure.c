@@ -58,6 +58,9 @@
 #endif
 #endif
 
+static ssize_t pqsecure_rx(void *arg, void *ptr, size_t len);
+static ssize_t pqsecure_tx(void *arg, const void *ptr, size_t len);
+
 /*
  * Macros to handle disabling and then restoring the state of SIGPIPE handling.
  * On Windows, these are all no-ops since there's no SIGPIPEs.
@@ -197,6 +200,36 @@ pqsecure_close(PGconn *conn)
 #endif
 }
 
+/*
+ *	Start compressing the connection with the algorithm the server chose.
+ *
+ * Whatever is in the input buffer past the server's acknowledgement was
+ * already compressed, so it is handed over to the decompressor, and then
+ * read back so that nobody ends up waiting on the socket for data that has
+ * already arrived.  Returns false, with a message in conn->errorMessage, on
+ * failure.
+ */
+bool
+pqsecure_enable_compression(PGconn *conn, const char *algorithm)
+{
+	conn->zstream = zpq_create(algorithm, pqsecure_tx, pqsecure_rx, conn,
+							   conn->inBuffer + conn->inStart,
+							   conn->inEnd - conn->inStart);
+	if (conn->zstream == NULL)
+	{
+		appendPQExpBuffer(&conn->errorMessage,
+				 libpq_gettext("could not initialize \"%s\" compression\n"),
+						  algorithm);
+		return false;
+	}
+	conn->inCursor = conn->inEnd = conn->inStart;
+
+	if (zpq_buffered_rx(conn->zstream) > 0 && pqReadData(conn) < 0)
+		return false;
+
+	return true;
+}
+
 /*
  *	Read data from a secure connection.
  *
@@ -209,6 +242,33 @@ pqsecure_read(PGconn *conn, void *ptr, size_t len)
 {
 	ssize_t		n;
 
+	if (conn->zstream)
+	{
+		n = zpq_read(conn->zstream, ptr, len);
+		if (n == ZPQ_STREAM_ERROR)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+				  libpq_gettext("could not decompress data from server: %s\n"),
+							  zpq_error(conn->zstream));
+			SOCK_ERRNO_SET(EIO);
+			n = -1;
+		}
+		return n;
+	}
+
+	return pqsecure_rx(conn, ptr, len);
+}
+
+/*
+ * Read from the connection below the compression layer, if any.  This is
+ * also the compression stream's transport function.
+ */
+static ssize_t
+pqsecure_rx(void *arg, void *ptr, size_t len)
+{
+	PGconn	   *conn = (PGconn *) arg;
+	ssize_t		n;
+
 #ifdef USE_SSL
 	if (conn->ssl_in_use)
 	{
@@ -286,6 +346,33 @@ pqsecure_write(PGconn *conn, const void *ptr, size_t len)
 {
 	ssize_t		n;
 
+	if (conn->zstream)
+	{
+		n = zpq_write(conn->zstream, ptr, len);
+		if (n == ZPQ_STREAM_ERROR)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("could not compress data: %s\n"),
+							  zpq_error(conn->zstream));
+			SOCK_ERRNO_SET(EIO);
+			n = -1;
+		}
+		return n;
+	}
+
+	return pqsecure_tx(conn, ptr, len);
+}
+
+/*
+ * Write to the connection below the compression layer, if any.  This is
+ * also the compression stream's transport function.
+ */
+static ssize_t
+pqsecure_tx(void *arg, const void *ptr, size_t len)
+{
+	PGconn	   *conn = (PGconn *) arg;
+	ssize_t		n;
+
 #ifdef USE_SSL
 	if (conn->ssl_in_use)
 	{
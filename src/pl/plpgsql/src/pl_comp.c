@@ -2216,6 +2216,8 @@ build_datatype(HeapTuple typeTup, int32 typmod, Oid collation)
 	}
 	else
 		typ->typisarray = false;
+	/* NB: this is only used to decide whether to apply expand_jsonb */
+	typ->typisjsonb = (typ->typoid == JSONBOID);
 	typ->atttypmod = typmod;
 
 	return typ;
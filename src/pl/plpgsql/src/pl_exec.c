@@ -26,6 +26,7 @@
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/planner.h"
 #include "parser/parse_coerce.h"
 #include "parser/scansup.h"
@@ -35,6 +36,7 @@
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
+#include "utils/jsonb.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
@@ -44,6 +46,16 @@
 
 static const char *const raise_skip_msg = "RAISE";
 
+/*
+ * FOR-IN-query loops fetch their rows from the cursor in batches, when the
+ * query allows, to save trips through the executor.  The first batch is
+ * small since many loops exit early; later ones grow geometrically, but
+ * stop growing once a batch holds more than FORQ_MAX_FETCH_BYTES of rows.
+ */
+#define FORQ_FIRST_FETCH		10
+#define FORQ_MAX_FETCH			1000
+#define FORQ_MAX_FETCH_BYTES	(1024 * 1024)
+
 typedef struct
 {
 	int			nargs;			/* number of arguments */
@@ -341,10 +353,10 @@ plpgsql_exec_function(PLpgSQL_function *func, FunctionCallInfo fcinfo,
 					var->freeval = false;
 
 					/*
-					 * Force any array-valued parameter to be stored in
-					 * expanded form in our local variable, in hopes of
+					 * Force any array-valued or jsonb parameter to be stored
+					 * in expanded form in our local variable, in hopes of
 					 * improving efficiency of uses of the variable.  (This is
-					 * a hack, really: why only arrays? Need more thought
+					 * a hack, really: why only these types? Need more thought
 					 * about which cases are likely to win.  See also
 					 * typisarray-specific heuristic in exec_assign_value.)
 					 *
@@ -355,7 +367,9 @@ plpgsql_exec_function(PLpgSQL_function *func, FunctionCallInfo fcinfo,
 					 * it to R/W if the variable gets modified, but that may
 					 * very well never happen.)
 					 */
-					if (!var->isnull && var->datatype->typisarray)
+					if (!var->isnull &&
+						(var->datatype->typisarray ||
+						 var->datatype->typisjsonb))
 					{
 						if (VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(var->value)))
 						{
@@ -368,7 +382,7 @@ plpgsql_exec_function(PLpgSQL_function *func, FunctionCallInfo fcinfo,
 						{
 							/* R/O pointer, keep it as-is until assigned to */
 						}
-						else
+						else if (var->datatype->typisarray)
 						{
 							/* flat array, so force to expanded form */
 							var->value = expand_array(var->value,
@@ -376,6 +390,13 @@ plpgsql_exec_function(PLpgSQL_function *func, FunctionCallInfo fcinfo,
 													  NULL);
 							var->freeval = true;
 						}
+						else
+						{
+							/* likewise for flat jsonb */
+							var->value = expand_jsonb(var->value,
+													  CurrentMemoryContext);
+							var->freeval = true;
+						}
 					}
 				}
 				break;
@@ -4317,9 +4338,9 @@ exec_assign_value(PLpgSQL_execstate *estate,
 				 * expanded form.  This wins if the function later does, say,
 				 * a lot of array subscripting operations on the variable, and
 				 * otherwise might lose.  We might need to use a different
-				 * heuristic, but it's too soon to tell.  Also, are there
-				 * cases where it'd be useful to force non-array values into
-				 * expanded form?
+				 * heuristic, but it's too soon to tell.  jsonb gets the same
+				 * treatment, for the benefit of repeated field extractions
+				 * and in-place jsonb_set() and || on the variable.
 				 */
 				if (!var->datatype->typbyval && !isNull)
 				{
@@ -4331,6 +4352,13 @@ exec_assign_value(PLpgSQL_execstate *estate,
 												CurrentMemoryContext,
 												NULL);
 					}
+					else if (var->datatype->typisjsonb &&
+						 !VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(newvalue)))
+					{
+						/* jsonb and not already R/W, so apply expand_jsonb */
+						newvalue = expand_jsonb(newvalue,
+												CurrentMemoryContext);
+					}
 					else
 					{
 						/* else transfer value if R/W, else just datumCopy */
@@ -5191,8 +5219,10 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 	PLpgSQL_rec *rec = NULL;
 	PLpgSQL_row *row = NULL;
 	SPITupleTable *tuptab;
+	TupleDesc	rec_tupdesc = NULL;
 	bool		found = false;
 	int			rc = PLPGSQL_RC_OK;
+	long		fetch;
 	int			n;
 
 	/*
@@ -5216,7 +5246,8 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 	 * few more rows to avoid multiple trips through executor startup
 	 * overhead.
 	 */
-	SPI_cursor_fetch(portal, true, prefetch_ok ? 10 : 1);
+	fetch = prefetch_ok ? FORQ_FIRST_FETCH : 1;
+	SPI_cursor_fetch(portal, true, fetch);
 	tuptab = SPI_tuptable;
 	n = SPI_processed;
 
@@ -5230,8 +5261,18 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 		exec_eval_cleanup(estate);
 	}
 	else
+	{
 		found = true;			/* processed at least one tuple */
 
+		/*
+		 * Every row assigned to a record target has the same descriptor, so
+		 * rather than have exec_move_row copy it for each row, make one copy
+		 * that the record borrows for the duration of the loop.
+		 */
+		if (rec != NULL)
+			rec_tupdesc = CreateTupleDescCopy(tuptab->tupdesc);
+	}
+
 	/*
 	 * Now do the loop
 	 */
@@ -5239,12 +5280,38 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 	{
 		int			i;
 
+		/* Size the next batch by this one, while we can cheaply */
+		if (prefetch_ok && fetch < FORQ_MAX_FETCH)
+		{
+			Size		batch_bytes = 0;
+
+			for (i = 0; i < n; i++)
+				batch_bytes += tuptab->vals[i]->t_len;
+			if (batch_bytes < FORQ_MAX_FETCH_BYTES / 2)
+				fetch = Min(fetch * 2, FORQ_MAX_FETCH);
+		}
+
 		for (i = 0; i < n; i++)
 		{
 			/*
 			 * Assign the tuple to the target
 			 */
-			exec_move_row(estate, rec, row, tuptab->vals[i], tuptab->tupdesc);
+			if (rec != NULL)
+			{
+				HeapTuple	tup = heap_copytuple(tuptab->vals[i]);
+
+				if (rec->freetup)
+					heap_freetuple(rec->tup);
+				if (rec->freetupdesc)
+					FreeTupleDesc(rec->tupdesc);
+				rec->tup = tup;
+				rec->freetup = true;
+				rec->tupdesc = rec_tupdesc;
+				rec->freetupdesc = false;
+			}
+			else
+				exec_move_row(estate, rec, row, tuptab->vals[i],
+							  tuptab->tupdesc);
 			exec_eval_cleanup(estate);
 
 			/*
@@ -5311,9 +5378,9 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 		SPI_freetuptable(tuptab);
 
 		/*
-		 * Fetch more tuples.  If prefetching is allowed, grab 50 at a time.
+		 * Fetch more tuples.
 		 */
-		SPI_cursor_fetch(portal, true, prefetch_ok ? 50 : 1);
+		SPI_cursor_fetch(portal, true, fetch);
 		tuptab = SPI_tuptable;
 		n = SPI_processed;
 	}
@@ -5325,6 +5392,18 @@ loop_exit:
 	 */
 	SPI_freetuptable(tuptab);
 
+	/*
+	 * If the record still has the loop's descriptor, it now owns it;
+	 * otherwise the descriptor is no longer needed.
+	 */
+	if (rec_tupdesc != NULL)
+	{
+		if (rec->tupdesc == rec_tupdesc)
+			rec->freetupdesc = true;
+		else
+			FreeTupleDesc(rec_tupdesc);
+	}
+
 	UnpinPortal(portal);
 
 	/*
@@ -5399,9 +5478,25 @@ exec_eval_simple_expr(PLpgSQL_execstate *estate,
 
 	/*
 	 * Revalidate cached plan, so that we will notice if it became stale. (We
-	 * need to hold a refcount while using the plan, anyway.)
-	 */
-	cplan = SPI_plan_get_cached_plan(expr->plan);
+	 * need to hold a refcount while using the plan, anyway.)  Usually the
+	 * plan is one for which a quick check that nothing has invalidated it
+	 * will do, which saves most of the cost of SPI_plan_get_cached_plan.
+	 */
+	cplan = NULL;
+	if (expr->expr_simple_plan != NULL &&
+		CachedPlanIsSimplyValid(expr->expr_simple_plansource,
+								expr->expr_simple_plan, true))
+	{
+		cplan = expr->expr_simple_plan;
+		/* It could be a newer plan that was allocated at the same address */
+		if (cplan->generation != expr->expr_simple_generation)
+		{
+			ReleaseCachedPlan(cplan, true);
+			cplan = NULL;
+		}
+	}
+	if (cplan == NULL)
+		cplan = SPI_plan_get_cached_plan(expr->plan);
 
 	/*
 	 * We can't get a failure here, because the number of CachedPlanSources in
@@ -5449,12 +5544,14 @@ exec_eval_simple_expr(PLpgSQL_execstate *estate,
 	 * We have to do some of the things SPI_execute_plan would do, in
 	 * particular advance the snapshot if we are in a non-read-only function.
 	 * Without this, stable functions within the expression would fail to see
-	 * updates made so far by our own function.
+	 * updates made so far by our own function.  An expression containing
+	 * only immutable functions, such as "x + 1", can't see the database at
+	 * all, so it needs neither.
 	 */
 	SPI_push();
 
 	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
-	if (!estate->readonly_func)
+	if (!estate->readonly_func && expr->expr_simple_mutable)
 	{
 		CommandCounterIncrement();
 		PushActiveSnapshot(GetTransactionSnapshot());
@@ -5487,7 +5584,7 @@ exec_eval_simple_expr(PLpgSQL_execstate *estate,
 
 	estate->paramLI->parserSetupArg = save_setup_arg;
 
-	if (!estate->readonly_func)
+	if (!estate->readonly_func && expr->expr_simple_mutable)
 		PopActiveSnapshot();
 
 	MemoryContextSwitchTo(oldcontext);
@@ -6470,6 +6567,8 @@ exec_simple_check_plan(PLpgSQL_expr *expr)
 	 */
 	expr->expr_simple_expr = NULL;
 	expr->expr_simple_generation = 0;
+	expr->expr_simple_plansource = NULL;
+	expr->expr_simple_plan = NULL;
 
 	/*
 	 * We can only test queries that resulted in exactly one CachedPlanSource
@@ -6478,6 +6577,7 @@ exec_simple_check_plan(PLpgSQL_expr *expr)
 	if (list_length(plansources) != 1)
 		return;
 	plansource = (CachedPlanSource *) linitial(plansources);
+	expr->expr_simple_plansource = plansource;
 
 	/*
 	 * Do some checking on the analyzed-and-rewritten form of the query. These
@@ -6563,6 +6663,7 @@ exec_simple_recheck_plan(PLpgSQL_expr *expr, CachedPlan *cplan)
 	 */
 	expr->expr_simple_expr = NULL;
 	expr->expr_simple_generation = cplan->generation;
+	expr->expr_simple_plan = NULL;
 
 	/*
 	 * 1. There must be one single plantree
@@ -6617,6 +6718,12 @@ exec_simple_recheck_plan(PLpgSQL_expr *expr, CachedPlan *cplan)
 	/* Also stash away the expression result type */
 	expr->expr_simple_type = exprType((Node *) tle->expr);
 	expr->expr_simple_typmod = exprTypmod((Node *) tle->expr);
+	expr->expr_simple_mutable = contain_mutable_functions((Node *) tle->expr);
+
+	/* And remember the plan, if it can be revalidated the cheap way */
+	if (CachedPlanAllowsSimpleValidityCheck(expr->expr_simple_plansource,
+											cplan))
+		expr->expr_simple_plan = cplan;
 }
 
 /*
@@ -6682,7 +6789,9 @@ exec_check_rw_parameter(PLpgSQL_expr *expr, int target_dno)
 	 * allow extensions to mark their functions as safe ...
 	 */
 	if (!(funcid == F_ARRAY_APPEND ||
-		  funcid == F_ARRAY_PREPEND))
+		  funcid == F_ARRAY_PREPEND ||
+		  funcid == F_JSONB_SET ||
+		  funcid == F_JSONB_CONCAT))
 		return;
 
 	/*
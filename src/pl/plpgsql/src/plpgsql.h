@@ -189,6 +189,7 @@ typedef struct
 	Oid			typrelid;
 	Oid			collation;		/* from pg_type, but can be overridden */
 	bool		typisarray;		/* is "true" array, or domain over one */
+	bool		typisjsonb;		/* is jsonb (not a domain over it) */
 	int32		atttypmod;		/* typmod (taken from someplace else) */
 } PLpgSQL_type;
 
@@ -235,6 +236,15 @@ typedef struct PLpgSQL_expr
 	int			expr_simple_generation; /* plancache generation we checked */
 	Oid			expr_simple_type;		/* result type Oid, if simple */
 	int32		expr_simple_typmod;		/* result typmod, if simple */
+	bool		expr_simple_mutable;	/* true if may depend on DB state */
+
+	/*
+	 * If the simple expression's generic plan allows it, expr_simple_plan is
+	 * that plan, to be revalidated with CachedPlanIsSimplyValid; else NULL.
+	 * We hold no reference to it between evaluations.
+	 */
+	struct CachedPlanSource *expr_simple_plansource;
+	struct CachedPlan *expr_simple_plan;
 
 	/*
 	 * if expr is simple AND prepared in current transaction,
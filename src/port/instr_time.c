@@ -0,0 +1,140 @@
+/*-------------------------------------------------------------------------
+ *
+ * instr_time.c
+ *	  Set up the time-stamp counter as a clock source for
+ *	  INSTR_TIME_SET_CURRENT_FAST, if it is usable.
+ *
+ * Reading the time-stamp counter costs a few nanoseconds, instead of the
+ * system call (or at best vDSO call) of gettimeofday().  That matters for
+ * EXPLAIN ANALYZE, which reads the clock twice per tuple per plan node.  But
+ * we can only use the counter if the CPU says it is invariant, that is, it
+ * ticks at a constant rate regardless of frequency scaling and sleep states.
+ * We then measure that rate against gettimeofday(), taking the same care as
+ * pg_test_timing to ensure neither clock goes backwards.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/port/instr_time.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "c.h"
+
+#include <math.h>
+
+#ifdef HAVE__GET_CPUID
+#include <cpuid.h>
+#endif
+
+#include "portability/instr_time.h"
+
+#ifdef HAVE_INSTR_TIME_TSC
+
+/* length of each of the two calibration rounds, in nanoseconds */
+#define TSC_CALIBRATION_NS	(5 * NS_PER_MS)
+
+bool		pg_timing_use_tsc = false;
+uint64		pg_timing_tsc_base = 0;
+double		pg_timing_ns_per_tsc = 0;
+
+/*
+ * Does the CPU have an invariant time-stamp counter?
+ */
+static bool
+pg_tsc_invariant(void)
+{
+#if defined(HAVE__GET_CPUID)
+	unsigned int exx[4] = {0, 0, 0, 0};
+
+	/* __get_cpuid checks that the extended leaf exists */
+	if (!__get_cpuid(0x80000007, &exx[0], &exx[1], &exx[2], &exx[3]))
+		return false;
+
+	return (exx[3] & (1 << 8)) != 0;	/* invariant TSC */
+#else
+	return false;
+#endif
+}
+
+/*
+ * Measure the length of a time-stamp counter tick in nanoseconds, over a
+ * period of TSC_CALIBRATION_NS.  Returns 0 if either clock went backwards.
+ */
+static double
+pg_tsc_calibrate(void)
+{
+	instr_time	start,
+				now,
+				prev;
+	uint64		tsc_start,
+				tsc,
+				tsc_prev;
+
+	INSTR_TIME_SET_CURRENT(start);
+	tsc_start = __builtin_ia32_rdtsc();
+	prev = start;
+	tsc_prev = tsc_start;
+
+	for (;;)
+	{
+		INSTR_TIME_SET_CURRENT(now);
+		tsc = __builtin_ia32_rdtsc();
+
+		if (now.ticks < prev.ticks || tsc < tsc_prev)
+			return 0;
+		if (now.ticks - start.ticks >= TSC_CALIBRATION_NS)
+			break;
+
+		prev = now;
+		tsc_prev = tsc;
+	}
+
+	if (tsc == tsc_start)
+		return 0;
+
+	return (double) (now.ticks - start.ticks) / (double) (tsc - tsc_start);
+}
+
+/*
+ * pg_initialize_timing
+ *
+ * Decide whether INSTR_TIME_SET_CURRENT_FAST can use the time-stamp counter.
+ * This is done once at process start; forked children inherit the result.
+ */
+void
+pg_initialize_timing(void)
+{
+	double		ns_per_tsc1,
+				ns_per_tsc2;
+
+	pg_timing_use_tsc = false;
+
+	if (!pg_tsc_invariant())
+		return;
+
+	/*
+	 * Calibrate twice, and insist that the results agree within 1%, in case
+	 * something like a hypervisor makes the counter unreliable after all.
+	 * We also reject rates outside of 100 MHz to 20 GHz as implausible.
+	 */
+	ns_per_tsc1 = pg_tsc_calibrate();
+	ns_per_tsc2 = pg_tsc_calibrate();
+
+	if (ns_per_tsc1 <= 0 || ns_per_tsc2 <= 0)
+		return;
+	if (fabs(ns_per_tsc1 - ns_per_tsc2) > 0.01 * ns_per_tsc1)
+		return;
+
+	pg_timing_ns_per_tsc = (ns_per_tsc1 + ns_per_tsc2) / 2;
+	if (pg_timing_ns_per_tsc < 0.05 || pg_timing_ns_per_tsc > 10.0)
+		return;
+
+	pg_timing_tsc_base = __builtin_ia32_rdtsc();
+	pg_timing_use_tsc = true;
+}
+
+#endif   /* HAVE_INSTR_TIME_TSC */
@@ -5,7 +5,9 @@
  *
  * Try to the special CRC instructions introduced in Intel SSE 4.2,
  * if available on the platform we're running on, but fall back to the
- * slicing-by-8 implementation otherwise.
+ * slicing-by-8 implementation otherwise.  If the processor can also do
+ * carry-less multiplication, use that for large inputs.  On ARM, likewise
+ * try the CRC instructions of the ARMv8 CRC Extension.
  *
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -27,10 +29,21 @@
 #include <intrin.h>
 #endif
 
+#ifdef USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 #include "port/pg_crc32c.h"
 
-static bool
-pg_crc32c_sse42_available(void)
+#if defined(USE_SSE42_CRC32C) || defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK)
+
+/*
+ * Return the ECX register of cpuid leaf 1, which has the feature bits we're
+ * interested in.
+ */
+static unsigned int
+pg_crc32c_cpuid_ecx(void)
 {
 	unsigned int exx[4] = {0, 0, 0, 0};
 
@@ -42,8 +55,32 @@ pg_crc32c_sse42_available(void)
 #error cpuid instruction not available
 #endif
 
-	return (exx[2] & (1 << 20)) != 0;	/* SSE 4.2 */
+	return exx[2];
+}
+
+static bool
+pg_crc32c_sse42_available(void)
+{
+	return (pg_crc32c_cpuid_ecx() & (1 << 20)) != 0;	/* SSE 4.2 */
+}
+
+#ifdef USE_PCLMUL_CRC32C_WITH_RUNTIME_CHECK
+static bool
+pg_crc32c_pclmul_available(void)
+{
+	return (pg_crc32c_cpuid_ecx() & (1 << 1)) != 0;	/* PCLMULQDQ */
+}
+#endif
+
+#endif   /* USE_SSE42_CRC32C || USE_SSE42_CRC32C_WITH_RUNTIME_CHECK */
+
+#ifdef USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK
+static bool
+pg_crc32c_armv8_available(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
 }
+#endif
 
 /*
  * This gets called on the first call. It replaces the function pointer
@@ -52,10 +89,25 @@ pg_crc32c_sse42_available(void)
 static pg_crc32c
 pg_comp_crc32c_choose(pg_crc32c crc, const void *data, size_t len)
 {
+#if defined(USE_SSE42_CRC32C)
+	/* we were compiled to require SSE 4.2 already */
+	pg_comp_crc32c = pg_comp_crc32c_sse42;
+#elif defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK)
 	if (pg_crc32c_sse42_available())
 		pg_comp_crc32c = pg_comp_crc32c_sse42;
 	else
 		pg_comp_crc32c = pg_comp_crc32c_sb8;
+#elif defined(USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK)
+	if (pg_crc32c_armv8_available())
+		pg_comp_crc32c = pg_comp_crc32c_armv8;
+	else
+		pg_comp_crc32c = pg_comp_crc32c_sb8;
+#endif
+
+#ifdef USE_PCLMUL_CRC32C_WITH_RUNTIME_CHECK
+	if (pg_comp_crc32c == pg_comp_crc32c_sse42 && pg_crc32c_pclmul_available())
+		pg_comp_crc32c = pg_comp_crc32c_pclmul;
+#endif
 
 	return pg_comp_crc32c(crc, data, len);
 }
@@ -0,0 +1,103 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_crc32c_pclmul.c
+ *	  Compute CRC-32C checksum using Intel PCLMULQDQ and SSE 4.2
+ *	  instructions.
+ *
+ * The SSE 4.2 CRC instruction has a latency of three cycles, and each step
+ * depends on the result of the previous one, so a single stream of them
+ * can't process more than eight bytes every three cycles.  For large inputs,
+ * we instead keep four 16-byte accumulators and, for every 64 bytes of
+ * input, "fold" each of them forward by multiplying it by x^512 modulo the
+ * CRC polynomial, using carry-less multiplication.  The four accumulators are
+ * independent, so the multiplications can all be in flight at once.  At the
+ * end, they are folded into one, and the CRC of that is computed with the
+ * SSE 4.2 instruction.  See "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction", Intel, 2009.
+ *
+ * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/port/pg_crc32c_pclmul.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "c.h"
+
+#include "port/pg_crc32c.h"
+
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
+/*
+ * Inputs shorter than this are passed straight to the SSE 4.2 implementation.
+ * Folding doesn't pay off until there are a few 64-byte blocks to process.
+ */
+#define PCLMUL_CRC32C_THRESHOLD 256
+
+/*
+ * Fold the 128-bit accumulator x forward, over the distance encoded in k,
+ * and add in y.  The low 32 bits of each half of k are the bit-reflected
+ * x^(D+31) mod P and x^(D-33) mod P, for a fold distance of D bits.
+ */
+#define FOLD(x, k, y) \
+	_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128((x), (k), 0x00), \
+								_mm_clmulepi64_si128((x), (k), 0x11)), \
+				  (y))
+
+pg_crc32c
+pg_comp_crc32c_pclmul(pg_crc32c crc, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	__m128i		x0,
+				x1,
+				x2,
+				x3,
+				k;
+	union
+	{
+		__m128i		v;
+		uint8		bytes[16];
+	}			acc;
+
+	if (len < PCLMUL_CRC32C_THRESHOLD)
+		return pg_comp_crc32c_sse42(crc, data, len);
+
+	/*
+	 * The CRC is linear, so starting from crc is the same as starting from
+	 * zero with crc XORed into the first four bytes of input.
+	 */
+	x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) p),
+					   _mm_cvtsi32_si128((int) crc));
+	x1 = _mm_loadu_si128((const __m128i *) (p + 16));
+	x2 = _mm_loadu_si128((const __m128i *) (p + 32));
+	x3 = _mm_loadu_si128((const __m128i *) (p + 48));
+	p += 64;
+	len -= 64;
+
+	/* fold each accumulator over the other three, 512 bits ahead */
+	k = _mm_setr_epi32(0x740eef02, 0, 0x9e4addf8, 0);
+	while (len >= 64)
+	{
+		x0 = FOLD(x0, k, _mm_loadu_si128((const __m128i *) p));
+		x1 = FOLD(x1, k, _mm_loadu_si128((const __m128i *) (p + 16)));
+		x2 = FOLD(x2, k, _mm_loadu_si128((const __m128i *) (p + 32)));
+		x3 = FOLD(x3, k, _mm_loadu_si128((const __m128i *) (p + 48)));
+		p += 64;
+		len -= 64;
+	}
+
+	/* fold the four accumulators into one, 128 bits at a time */
+	k = _mm_setr_epi32(0xf20c0dfe, 0, 0x493c7d27, 0);
+	x0 = FOLD(x0, k, x1);
+	x0 = FOLD(x0, k, x2);
+	x0 = FOLD(x0, k, x3);
+
+	/* reduce the accumulator, then process whatever input is left */
+	_mm_storeu_si128(&acc.v, x0);
+	crc = pg_comp_crc32c_sse42(0, acc.bytes, sizeof(acc.bytes));
+
+	return pg_comp_crc32c_sse42(crc, p, len);
+}
@@ -0,0 +1,172 @@
+/*
+ * src/test/examples/testlibpq5.c
+ *
+ *
+ * testlibpq5.c
+ *		Test pipeline mode, and what happens when a pipelined query fails.
+ *
+ * This sends two groups of queries in a single pipeline, each ended by a
+ * Sync.  The second query of the first group fails, so the third one is
+ * not run; the second group runs normally again.
+ *
+ * The expected output is:
+ *
+ * SELECT 1: PGRES_TUPLES_OK
+ * SELECT 1/0: PGRES_FATAL_ERROR
+ * SELECT 2: PGRES_PIPELINE_ABORTED
+ * sync: PGRES_PIPELINE_SYNC
+ * SELECT 3: PGRES_TUPLES_OK
+ * sync: PGRES_PIPELINE_SYNC
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "libpq-fe.h"
+
+static void
+exit_nicely(PGconn *conn)
+{
+	PQfinish(conn);
+	exit(1);
+}
+
+static void
+send_query(PGconn *conn, const char *query)
+{
+	if (!PQsendQueryParams(conn, query, 0, NULL, NULL, NULL, NULL, 0))
+	{
+		fprintf(stderr, "could not send \"%s\": %s",
+				query, PQerrorMessage(conn));
+		exit_nicely(conn);
+	}
+}
+
+static void
+send_sync(PGconn *conn)
+{
+	if (!PQpipelineSync(conn))
+	{
+		fprintf(stderr, "could not send sync: %s", PQerrorMessage(conn));
+		exit_nicely(conn);
+	}
+}
+
+/*
+ * Read the result of the next pipelined query, which must have the given
+ * status.  Each query's results are followed by a NULL, but a sync's are not.
+ */
+static void
+check_result(PGconn *conn, const char *what, ExecStatusType expected)
+{
+	PGresult   *res;
+
+	res = PQgetResult(conn);
+	if (res == NULL)
+	{
+		fprintf(stderr, "%s: unexpected NULL result: %s",
+				what, PQerrorMessage(conn));
+		exit_nicely(conn);
+	}
+	if (PQresultStatus(res) != expected)
+	{
+		fprintf(stderr, "%s: expected %s, got %s: %s",
+				what, PQresStatus(expected),
+				PQresStatus(PQresultStatus(res)),
+				PQresultErrorMessage(res));
+		PQclear(res);
+		exit_nicely(conn);
+	}
+	printf("%s: %s\n", what, PQresStatus(expected));
+	PQclear(res);
+
+	if (expected == PGRES_PIPELINE_SYNC)
+		return;
+
+	res = PQgetResult(conn);
+	if (res != NULL)
+	{
+		fprintf(stderr, "%s: expected NULL after the result, got %s\n",
+				what, PQresStatus(PQresultStatus(res)));
+		PQclear(res);
+		exit_nicely(conn);
+	}
+}
+
+static void
+check_pipeline_status(PGconn *conn, PGpipelineStatus expected)
+{
+	if (PQpipelineStatus(conn) != expected)
+	{
+		fprintf(stderr, "unexpected pipeline status %d, expected %d\n",
+				PQpipelineStatus(conn), expected);
+		exit_nicely(conn);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *conninfo;
+	PGconn	   *conn;
+
+	/*
+	 * If the user supplies a parameter on the command line, use it as the
+	 * conninfo string; otherwise default to setting dbname=postgres and using
+	 * environment variables or defaults for all other connection parameters.
+	 */
+	if (argc > 1)
+		conninfo = argv[1];
+	else
+		conninfo = "dbname = postgres";
+
+	/* Make a connection to the database */
+	conn = PQconnectdb(conninfo);
+
+	/* Check to see that the backend connection was successfully made */
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		fprintf(stderr, "Connection to database failed: %s",
+				PQerrorMessage(conn));
+		exit_nicely(conn);
+	}
+
+	if (!PQenterPipelineMode(conn))
+	{
+		fprintf(stderr, "could not enter pipeline mode: %s",
+				PQerrorMessage(conn));
+		exit_nicely(conn);
+	}
+
+	/* Send everything before reading any result */
+	send_query(conn, "SELECT 1");
+	send_query(conn, "SELECT 1/0");
+	send_query(conn, "SELECT 2");
+	send_sync(conn);
+	send_query(conn, "SELECT 3");
+	send_sync(conn);
+
+	check_result(conn, "SELECT 1", PGRES_TUPLES_OK);
+	check_pipeline_status(conn, PQ_PIPELINE_ON);
+
+	/* The error aborts the pipeline up to the next sync */
+	check_result(conn, "SELECT 1/0", PGRES_FATAL_ERROR);
+	check_pipeline_status(conn, PQ_PIPELINE_ABORTED);
+	check_result(conn, "SELECT 2", PGRES_PIPELINE_ABORTED);
+	check_result(conn, "sync", PGRES_PIPELINE_SYNC);
+	check_pipeline_status(conn, PQ_PIPELINE_ON);
+
+	/* and the queries after the sync run again */
+	check_result(conn, "SELECT 3", PGRES_TUPLES_OK);
+	check_result(conn, "sync", PGRES_PIPELINE_SYNC);
+
+	if (!PQexitPipelineMode(conn))
+	{
+		fprintf(stderr, "could not exit pipeline mode: %s",
+				PQerrorMessage(conn));
+		exit_nicely(conn);
+	}
+
+	/* close the connection to the database and cleanup */
+	PQfinish(conn);
+
+	return 0;
+}
@@ -0,0 +1,403 @@
+/*--------------------------------------------------------------------------
+ *
+ * bench_access.c
+ *		Micro-benchmarks for B-tree page search, page checksums, COPY
+ *		input parsing and TID bitmaps.
+ *
+ * The B-tree and COPY benchmarks need a table to work on; they create a
+ * temporary one in setup and drop it in teardown.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/microbench/bench_access.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/nbtree.h"
+#include "catalog/namespace.h"
+#include "commands/copy.h"
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/tidbitmap.h"
+#include "storage/bufpage.h"
+#include "storage/checksum.h"
+#include "storage/fd.h"
+#include "utils/rel.h"
+
+#include "microbench.h"
+
+/* number of rows in the table the B-tree benchmark searches */
+#define BTREE_ROWS	100000
+
+typedef struct BtreeData
+{
+	Relation	index;
+	Buffer		buf;
+	ScanKeyData skey;
+	Datum	   *keys;
+} BtreeData;
+
+typedef struct CopyData
+{
+	Relation	rel;
+	char		path[MAXPGPATH];
+	List	   *options;
+} CopyData;
+
+/* TIDs per tbm_add_tuples call, like an index page's worth */
+#define TBM_BATCH	64
+
+typedef struct TbmData
+{
+	ItemPointerData *tids;
+	TIDBitmap  *tbm;
+	void	   *shared;
+} TbmData;
+
+/* ----------
+ * B-tree page search
+ * ----------
+ */
+
+/*
+ * Descend an int4 index to a leaf page in the middle, and keep it locked;
+ * the keys to search for are spread over the range that page covers, so
+ * that each search has to go all the way down.
+ */
+static void *
+btree_setup(int64 loops)
+{
+	BtreeData  *data = palloc0(sizeof(BtreeData));
+	Oid			indexoid;
+	BTStack		stack;
+	Page		page;
+	BTPageOpaque opaque;
+	IndexTuple	itup;
+	bool		isnull;
+	int32		lo;
+	int32		hi;
+	uint32		seed = 1;
+	int64		i;
+
+	microbench_execute("DROP TABLE IF EXISTS pg_temp.microbench_btree;"
+					   "CREATE TEMP TABLE microbench_btree (k int4);"
+					   "INSERT INTO microbench_btree"
+					   "  SELECT generate_series(1, " CppAsString2(BTREE_ROWS) ");"
+					   "CREATE INDEX microbench_btree_idx ON microbench_btree (k)");
+
+	indexoid = RangeVarGetRelid(makeRangeVar("pg_temp", "microbench_btree_idx",
+											 -1),
+								AccessShareLock, false);
+	data->index = index_open(indexoid, NoLock);
+
+	ScanKeyEntryInitializeWithInfo(&data->skey, 0, 1, InvalidStrategy,
+								   InvalidOid,
+								   data->index->rd_indcollation[0],
+								   index_getprocinfo(data->index, 1,
+													 BTORDER_PROC),
+								   Int32GetDatum(BTREE_ROWS / 2));
+	stack = _bt_search(data->index, 1, &data->skey, false, &data->buf,
+					   BT_READ);
+	_bt_freestack(stack);
+
+	page = BufferGetPage(data->buf);
+	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	itup = (IndexTuple) PageGetItem(page,
+						 PageGetItemId(page, P_FIRSTDATAKEY(opaque)));
+	lo = DatumGetInt32(index_getattr(itup, 1, RelationGetDescr(data->index),
+									 &isnull));
+	itup = (IndexTuple) PageGetItem(page,
+						   PageGetItemId(page, PageGetMaxOffsetNumber(page)));
+	hi = DatumGetInt32(index_getattr(itup, 1, RelationGetDescr(data->index),
+									 &isnull));
+
+	data->keys = palloc(loops * sizeof(Datum));
+	for (i = 0; i < loops; i++)
+		data->keys[i] = Int32GetDatum(lo + (int32) (microbench_random(&seed) %
+													(hi - lo + 1)));
+
+	return data;
+}
+
+static void
+btree_run(void *arg, int64 loops)
+{
+	BtreeData  *data = (BtreeData *) arg;
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+	{
+		data->skey.sk_argument = data->keys[i];
+		(void) _bt_binsrch(data->index, data->buf, 1, &data->skey, false);
+	}
+}
+
+static void
+btree_teardown(void *arg)
+{
+	BtreeData  *data = (BtreeData *) arg;
+
+	_bt_relbuf(data->index, data->buf);
+	index_close(data->index, AccessShareLock);
+	microbench_execute("DROP TABLE pg_temp.microbench_btree");
+}
+
+/* ----------
+ * Page checksums
+ * ----------
+ */
+
+static void *
+checksum_setup(int64 loops)
+{
+	char	   *page = palloc(BLCKSZ);
+	uint32		seed = 1;
+	int			i;
+
+	PageInit((Page) page, BLCKSZ, 0);
+	for (i = SizeOfPageHeaderData; i < BLCKSZ; i++)
+		page[i] = (char) microbench_random(&seed);
+	return page;
+}
+
+static void
+checksum_run(void *arg, int64 loops)
+{
+	char	   *page = (char *) arg;
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+		(void) pg_checksum_page(page, (BlockNumber) i);
+}
+
+/* ----------
+ * COPY input parsing
+ * ----------
+ */
+
+/*
+ * Write "loops" lines for COPY to a temporary file, and open the table they
+ * are for.  The file is named like other temporary files, so that it's
+ * removed at the next restart if we don't get to it.
+ */
+static CopyData *
+copy_setup(int64 loops, bool csv)
+{
+	CopyData   *data = palloc0(sizeof(CopyData));
+	FILE	   *file;
+	uint32		seed = 1;
+	int64		i;
+	Oid			relid;
+
+	microbench_execute("DROP TABLE IF EXISTS pg_temp.microbench_copy;"
+					   "CREATE TEMP TABLE microbench_copy"
+					   "  (a int4, b text, c float8, d date, e bool)");
+	relid = RangeVarGetRelid(makeRangeVar("pg_temp", "microbench_copy", -1),
+							 RowExclusiveLock, false);
+	data->rel = heap_open(relid, NoLock);
+
+	if (mkdir("base/" PG_TEMP_FILES_DIR, S_IRWXU) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m",
+						"base/" PG_TEMP_FILES_DIR)));
+	snprintf(data->path, sizeof(data->path), "base/%s/%s%d.microbench",
+			 PG_TEMP_FILES_DIR, PG_TEMP_FILE_PREFIX, MyProcPid);
+
+	file = AllocateFile(data->path, PG_BINARY_W);
+	if (file == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", data->path)));
+	for (i = 0; i < loops; i++)
+	{
+		uint32		r = microbench_random(&seed);
+
+		if (csv)
+			fprintf(file, "%d,\"row %u, \"\"quoted\"\"\",%u.%03u,2015-%02u-%02u,%s\n",
+					(int32) r, r % 10000, r % 1000, r % 997,
+					r % 12 + 1, r % 28 + 1, (r & 1) ? "t" : "f");
+		else
+			fprintf(file, "%d\trow %u with some text\t%u.%03u\t2015-%02u-%02u\t%s\n",
+					(int32) r, r % 10000, r % 1000, r % 997,
+					r % 12 + 1, r % 28 + 1, (r & 1) ? "t" : "f");
+	}
+	if (FreeFile(file))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", data->path)));
+
+	if (csv)
+		data->options = list_make1(makeDefElem("format",
+											   (Node *) makeString("csv")));
+	return data;
+}
+
+static void *
+copy_text_setup(int64 loops)
+{
+	return copy_setup(loops, false);
+}
+
+static void *
+copy_csv_setup(int64 loops)
+{
+	return copy_setup(loops, true);
+}
+
+static void
+copy_run(void *arg, int64 loops)
+{
+	CopyData   *data = (CopyData *) arg;
+	TupleDesc	tupdesc = RelationGetDescr(data->rel);
+	ExprContext *econtext = CreateStandaloneExprContext();
+	Datum	   *values = palloc(tupdesc->natts * sizeof(Datum));
+	bool	   *nulls = palloc(tupdesc->natts * sizeof(bool));
+	CopyState	cstate;
+	Oid			tupleOid;
+	MemoryContext oldcxt;
+
+	cstate = BeginCopyFrom(data->rel, data->path, false, NIL, data->options);
+
+	oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	for (;;)
+	{
+		ResetExprContext(econtext);
+		if (!NextCopyFrom(cstate, econtext, values, nulls, &tupleOid))
+			break;
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	EndCopyFrom(cstate);
+	FreeExprContext(econtext, true);
+}
+
+static void
+copy_teardown(void *arg)
+{
+	CopyData   *data = (CopyData *) arg;
+
+	unlink(data->path);
+	heap_close(data->rel, RowExclusiveLock);
+	microbench_execute("DROP TABLE pg_temp.microbench_copy");
+}
+
+/* ----------
+ * TID bitmaps
+ * ----------
+ */
+
+/*
+ * Make "loops" TIDs, a few per page on pages all over a big table, in
+ * random order as from an index on an uncorrelated column.
+ */
+static void *
+tbm_setup(int64 loops)
+{
+	TbmData    *data = palloc0(sizeof(TbmData));
+	uint32		seed = 1;
+	int64		i;
+
+	data->tids = palloc(loops * sizeof(ItemPointerData));
+	for (i = 0; i < loops; i++)
+	{
+		uint32		r = microbench_random(&seed);
+
+		ItemPointerSet(&data->tids[i], (BlockNumber) (r % (loops / 4 + 1)),
+					   (OffsetNumber) (r % 50 + 1));
+	}
+	return data;
+}
+
+static void
+tbm_add_run(void *arg, int64 loops)
+{
+	TbmData    *data = (TbmData *) arg;
+	TIDBitmap  *tbm = tbm_create(work_mem * 1024L);
+	int64		i;
+
+	for (i = 0; i < loops; i += TBM_BATCH)
+		tbm_add_tuples(tbm, data->tids + i, (int) Min(loops - i, TBM_BATCH),
+					   false);
+}
+
+/*
+ * For the iteration benchmarks, build the bitmap in setup.  An operation
+ * is still one TID, to be comparable with tbm_add.
+ */
+static void *
+tbm_iterate_setup(int64 loops)
+{
+	TbmData    *data = (TbmData *) tbm_setup(loops);
+
+	data->tbm = tbm_create(work_mem * 1024L);
+	tbm_add_tuples(data->tbm, data->tids, (int) loops, false);
+	return data;
+}
+
+static void
+tbm_iterate_run(void *arg, int64 loops)
+{
+	TbmData    *data = (TbmData *) arg;
+	TBMIterator *iterator = tbm_begin_iterate(data->tbm);
+
+	while (tbm_iterate(iterator) != NULL)
+		;
+	tbm_end_iterate(iterator);
+}
+
+static void *
+tbm_shared_iterate_setup(int64 loops)
+{
+	TbmData    *data = (TbmData *) tbm_iterate_setup(loops);
+
+	data->shared = palloc(tbm_shared_size(data->tbm));
+	return data;
+}
+
+/*
+ * Time copying the bitmap and iterating over the copy, in a single process
+ * and local memory, so this shows the overhead of sharing.
+ */
+static void
+tbm_shared_iterate_run(void *arg, int64 loops)
+{
+	TbmData    *data = (TbmData *) arg;
+	TBMSharedIterator *iterator;
+
+	iterator = tbm_attach_shared_iterate(
+						 tbm_prepare_shared_iterate(data->tbm, data->shared));
+	while (tbm_shared_iterate(iterator) != NULL)
+		;
+	tbm_end_shared_iterate(iterator);
+}
+
+const Microbenchmark access_benchmarks[] = {
+	{"btree_binsrch", "_bt_binsrch on an int4 leaf page, per search",
+	 1000000, false, btree_setup, btree_run, btree_teardown},
+	{"page_checksum", "pg_checksum_page, per page",
+	 100000, false, checksum_setup, checksum_run, NULL},
+	{"copy_text", "NextCopyFrom of a 5-column text-format line, per line",
+	 100000, false, copy_text_setup, copy_run, copy_teardown},
+	{"copy_csv", "NextCopyFrom of a 5-column CSV line with quoting, per line",
+	 100000, false, copy_csv_setup, copy_run, copy_teardown},
+	{"tbm_add", "tbm_add_tuples of random TIDs in batches, per TID",
+	 1000000, false, tbm_setup, tbm_add_run, NULL},
+	{"tbm_iterate", "tbm_begin_iterate and tbm_iterate, per TID",
+	 1000000, false, tbm_iterate_setup, tbm_iterate_run, NULL},
+	{"tbm_shared_iterate",
+	 "tbm_prepare_shared_iterate and tbm_shared_iterate, per TID",
+	 1000000, false, tbm_shared_iterate_setup, tbm_shared_iterate_run, NULL}
+};
+
+const int	num_access_benchmarks = lengthof(access_benchmarks);
@@ -0,0 +1,490 @@
+/*--------------------------------------------------------------------------
+ *
+ * bench_executor.c
+ *		Micro-benchmarks for sorting, hash joins and tuple deforming.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/microbench/bench_executor.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "access/htup_details.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_type.h"
+#include "executor/executor.h"
+#include "executor/hashjoin.h"
+#include "executor/nodeHash.h"
+#include "executor/tuptable.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/planmain.h"
+#include "utils/builtins.h"
+#include "utils/tuplesort.h"
+#include "utils/typcache.h"
+
+#include "microbench.h"
+
+/* number of distinct tuples the deforming benchmark cycles through */
+#define DEFORM_TUPLES	1024
+
+/*
+ * Data for the sort benchmarks: either datums, or tuples for a two-key
+ * heap sort.
+ */
+typedef struct SortData
+{
+	Oid			type;
+	Datum	   *datums;
+	TupleDesc	tupdesc;
+	HeapTuple  *tuples;
+	TupleTableSlot *slot;
+} SortData;
+
+/*
+ * Data for the hash join benchmarks.  The inner side has keys 0 .. loops - 1
+ * in random order; about half the outer keys fall in that range.
+ */
+typedef struct HashData
+{
+	HashJoinTable hashtable;
+	TupleDesc	tupdesc;
+	TupleTableSlot *innerslot;
+	HeapTuple  *inner;
+	uint32	   *innerhash;
+	HeapTuple  *outer;
+	uint32	   *outerhash;
+	TupleTableSlot *outerslot;
+	HashJoinState *hjstate;
+	ExprContext *econtext;
+} HashData;
+
+typedef struct DeformData
+{
+	HeapTuple	tuples[DEFORM_TUPLES];
+	TupleTableSlot *slot;
+} DeformData;
+
+static HeapTuple
+form_pair(TupleDesc tupdesc, Datum a, Datum b)
+{
+	Datum		values[2];
+	bool		nulls[2] = {false, false};
+
+	values[0] = a;
+	values[1] = b;
+	return heap_form_tuple(tupdesc, values, nulls);
+}
+
+static TupleDesc
+make_pair_tupdesc(Oid type1, Oid type2)
+{
+	TupleDesc	tupdesc = CreateTemplateTupleDesc(2, false);
+
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "a", type1, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "b", type2, -1, 0);
+	return tupdesc;
+}
+
+/* ----------
+ * Sorting
+ * ----------
+ */
+
+static void *
+sort_datum_setup(Oid type, int64 loops)
+{
+	SortData   *data = palloc0(sizeof(SortData));
+	uint32		seed = 1;
+	int64		i;
+
+	data->type = type;
+	data->datums = palloc(loops * sizeof(Datum));
+	for (i = 0; i < loops; i++)
+	{
+		uint32		r = microbench_random(&seed);
+
+		if (type == INT4OID)
+			data->datums[i] = Int32GetDatum((int32) r);
+		else
+		{
+			char		buf[32];
+
+			/* a shared prefix, to defeat abbreviated keys some of the time */
+			snprintf(buf, sizeof(buf), "key %u %08x", r % 1000, r);
+			data->datums[i] = CStringGetTextDatum(buf);
+		}
+	}
+	return data;
+}
+
+static void *
+sort_int4_setup(int64 loops)
+{
+	return sort_datum_setup(INT4OID, loops);
+}
+
+static void *
+sort_text_setup(int64 loops)
+{
+	return sort_datum_setup(TEXTOID, loops);
+}
+
+static void
+sort_datum_run(void *arg, int64 loops)
+{
+	SortData   *data = (SortData *) arg;
+	TypeCacheEntry *typentry;
+	Tuplesortstate *sortstate;
+	Datum		val;
+	bool		isnull;
+	int64		i;
+
+	typentry = lookup_type_cache(data->type, TYPECACHE_LT_OPR);
+	sortstate = tuplesort_begin_datum(data->type, typentry->lt_opr,
+									  (data->type == TEXTOID) ?
+									  DEFAULT_COLLATION_OID : InvalidOid,
+									  false, work_mem, false);
+	for (i = 0; i < loops; i++)
+		tuplesort_putdatum(sortstate, data->datums[i], false);
+	tuplesort_performsort(sortstate);
+	while (tuplesort_getdatum(sortstate, true, &val, &isnull))
+		;
+	tuplesort_end(sortstate);
+}
+
+static void *
+sort_multikey_setup(int64 loops)
+{
+	SortData   *data = palloc0(sizeof(SortData));
+	uint32		seed = 1;
+	int64		i;
+
+	data->tupdesc = make_pair_tupdesc(INT4OID, INT8OID);
+	data->tuples = palloc(loops * sizeof(HeapTuple));
+	for (i = 0; i < loops; i++)
+	{
+		uint32		r = microbench_random(&seed);
+
+		/* few distinct leading keys, so that the second key matters */
+		data->tuples[i] = form_pair(data->tupdesc,
+									Int32GetDatum((int32) (r % 64)),
+									Int64GetDatum((int64) r));
+	}
+	data->slot = MakeSingleTupleTableSlot(data->tupdesc);
+	return data;
+}
+
+static void
+sort_multikey_run(void *arg, int64 loops)
+{
+	SortData   *data = (SortData *) arg;
+	AttrNumber	attnums[2] = {1, 2};
+	Oid			sortops[2] = {Int4LessOperator, Int8LessOperator};
+	Oid			collations[2] = {InvalidOid, InvalidOid};
+	bool		nullsfirst[2] = {false, false};
+	Tuplesortstate *sortstate;
+	int64		i;
+
+	sortstate = tuplesort_begin_heap(data->tupdesc, 2, attnums,
+									 sortops, collations, nullsfirst,
+									 work_mem, false);
+	for (i = 0; i < loops; i++)
+	{
+		ExecStoreTuple(data->tuples[i], data->slot, InvalidBuffer, false);
+		tuplesort_puttupleslot(sortstate, data->slot);
+	}
+	tuplesort_performsort(sortstate);
+	while (tuplesort_gettupleslot(sortstate, true, data->slot))
+		;
+	tuplesort_end(sortstate);
+}
+
+static void
+sort_teardown(void *arg)
+{
+	SortData   *data = (SortData *) arg;
+
+	if (data->slot)
+		ExecDropSingleTupleTableSlot(data->slot);
+}
+
+/* ----------
+ * Hash joins
+ * ----------
+ */
+
+/*
+ * Create an empty hash table for "loops" (int4, int4) tuples hashed on the
+ * first column, as ExecHashTableCreate would for a Hash node over a scan
+ * with that many rows.
+ */
+static HashData *
+hashjoin_create(int64 loops)
+{
+	HashData   *data = palloc0(sizeof(HashData));
+	Hash	   *hash = makeNode(Hash);
+	Plan	   *scan = (Plan *) makeNode(Result);
+	uint32		seed = 1;
+	int64		i;
+
+	scan->plan_rows = (double) loops;
+	scan->plan_width = 8;
+	outerPlan(hash) = scan;
+
+	data->hashtable = ExecHashTableCreate(hash,
+										  list_make1_oid(Int4EqualOperator),
+										  false);
+	if (data->hashtable->nbatch > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("hash table for " INT64_FORMAT " tuples does not fit in work_mem",
+						loops)));
+
+	data->tupdesc = make_pair_tupdesc(INT4OID, INT4OID);
+	data->innerslot = MakeSingleTupleTableSlot(data->tupdesc);
+	data->inner = palloc(loops * sizeof(HeapTuple));
+	data->innerhash = palloc(loops * sizeof(uint32));
+
+	/* a random permutation of 0 .. loops - 1 */
+	for (i = 0; i < loops; i++)
+	{
+		int64		j = microbench_random(&seed) % (i + 1);
+
+		data->inner[i] = data->inner[j];
+		data->inner[j] = form_pair(data->tupdesc, Int32GetDatum((int32) i),
+								   Int32GetDatum((int32) i));
+	}
+	for (i = 0; i < loops; i++)
+	{
+		bool		isnull;
+		Datum		key = heap_getattr(data->inner[i], 1, data->tupdesc,
+									   &isnull);
+
+		data->innerhash[i] = DatumGetUInt32(hash_uint32(DatumGetInt32(key)));
+	}
+
+	return data;
+}
+
+static void
+hashjoin_insert_all(HashData *data, int64 loops)
+{
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+	{
+		ExecStoreTuple(data->inner[i], data->innerslot, InvalidBuffer, false);
+		ExecHashTableInsert(data->hashtable, data->innerslot,
+							data->innerhash[i]);
+		data->hashtable->totalTuples += 1;
+	}
+}
+
+static void *
+hashjoin_build_setup(int64 loops)
+{
+	return hashjoin_create(loops);
+}
+
+static void
+hashjoin_build_run(void *arg, int64 loops)
+{
+	HashData   *data = (HashData *) arg;
+
+	hashjoin_insert_all(data, loops);
+	ExecHashBuildBucketEntries(data->hashtable);
+}
+
+/*
+ * For probing, build the table beforehand, and set up just as much of a
+ * HashJoinState as ExecScanHashBucket looks at: the hash clause
+ * "outer.a = inner.a" and the slot for inner tuples.
+ */
+static void *
+hashjoin_probe_setup(int64 loops)
+{
+	HashData   *data = hashjoin_create(loops);
+	HashJoinState *hjstate = makeNode(HashJoinState);
+	Expr	   *clause;
+	uint32		seed = 2;
+	int64		i;
+
+	hashjoin_insert_all(data, loops);
+	ExecHashBuildBucketEntries(data->hashtable);
+
+	clause = make_opclause(Int4EqualOperator, BOOLOID, false,
+						   (Expr *) makeVar(OUTER_VAR, 1, INT4OID, -1,
+											InvalidOid, 0),
+						   (Expr *) makeVar(INNER_VAR, 1, INT4OID, -1,
+											InvalidOid, 0),
+						   InvalidOid, InvalidOid);
+	fix_opfuncids((Node *) clause);
+
+	hjstate->hashclauses = (List *) ExecInitExpr((Expr *) list_make1(clause),
+												 NULL);
+	hjstate->hj_HashTable = data->hashtable;
+	hjstate->hj_HashTupleSlot = MakeSingleTupleTableSlot(data->tupdesc);
+	hjstate->hj_CurSkewBucketNo = INVALID_SKEW_BUCKET_NO;
+	data->hjstate = hjstate;
+	data->econtext = CreateStandaloneExprContext();
+
+	data->outerslot = MakeSingleTupleTableSlot(data->tupdesc);
+	data->outer = palloc(loops * sizeof(HeapTuple));
+	data->outerhash = palloc(loops * sizeof(uint32));
+	for (i = 0; i < loops; i++)
+	{
+		int32		key = (int32) (microbench_random(&seed) % (2 * loops));
+
+		data->outer[i] = form_pair(data->tupdesc, Int32GetDatum(key),
+								   Int32GetDatum(key));
+		data->outerhash[i] = DatumGetUInt32(hash_uint32(key));
+	}
+
+	return data;
+}
+
+static void
+hashjoin_probe_run(void *arg, int64 loops)
+{
+	HashData   *data = (HashData *) arg;
+	HashJoinState *hjstate = data->hjstate;
+	ExprContext *econtext = data->econtext;
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+	{
+		int			batchno;
+
+		ExecStoreTuple(data->outer[i], data->outerslot, InvalidBuffer, false);
+		econtext->ecxt_outertuple = data->outerslot;
+
+		hjstate->hj_CurHashValue = data->outerhash[i];
+		ExecHashGetBucketAndBatch(data->hashtable, data->outerhash[i],
+								  &hjstate->hj_CurBucketNo, &batchno);
+		hjstate->hj_CurTuple = NULL;
+
+		while (ExecScanHashBucket(hjstate, econtext))
+			;
+	}
+}
+
+static void
+hashjoin_teardown(void *arg)
+{
+	HashData   *data = (HashData *) arg;
+
+	if (data->hjstate)
+	{
+		ExecDropSingleTupleTableSlot(data->hjstate->hj_HashTupleSlot);
+		ExecDropSingleTupleTableSlot(data->outerslot);
+		FreeExprContext(data->econtext, true);
+	}
+	ExecDropSingleTupleTableSlot(data->innerslot);
+	ExecHashTableDestroy(data->hashtable);
+}
+
+/* ----------
+ * Tuple deforming
+ * ----------
+ */
+
+/*
+ * Tuples with a mix of fixed- and variable-width columns, some of them NULL,
+ * so that slot_deform_tuple can't rely on cached offsets past the first few.
+ */
+static void *
+deform_setup(int64 loops)
+{
+	DeformData *data = palloc0(sizeof(DeformData));
+	TupleDesc	tupdesc = CreateTemplateTupleDesc(10, false);
+	uint32		seed = 1;
+	int			i;
+
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "c1", INT4OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "c2", INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "c3", INT4OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "c4", TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "c5", FLOAT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "c6", BOOLOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 7, "c7", TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 8, "c8", INT2OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 9, "c9", INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 10, "c10", TEXTOID, -1, 0);
+
+	for (i = 0; i < DEFORM_TUPLES; i++)
+	{
+		Datum		values[10];
+		bool		nulls[10];
+		uint32		r = microbench_random(&seed);
+		char		buf[64];
+
+		memset(nulls, 0, sizeof(nulls));
+		snprintf(buf, sizeof(buf), "value %u", r);
+
+		values[0] = Int32GetDatum(i);
+		values[1] = Int64GetDatum((int64) r * 3);
+		values[2] = Int32GetDatum((int32) r);
+		values[3] = CStringGetTextDatum(buf + (r % 6));
+		values[4] = Float8GetDatum(r / 7.0);
+		values[5] = BoolGetDatum(r & 1);
+		values[6] = CStringGetTextDatum(buf);
+		values[7] = Int16GetDatum((int16) r);
+		values[8] = Int64GetDatum(i);
+		values[9] = CStringGetTextDatum(buf + (r % 3));
+
+		/* one tuple in four has a NULL in the middle */
+		if (r % 4 == 0)
+			nulls[4] = true;
+
+		data->tuples[i] = heap_form_tuple(tupdesc, values, nulls);
+	}
+	data->slot = MakeSingleTupleTableSlot(tupdesc);
+	return data;
+}
+
+static void
+deform_run(void *arg, int64 loops)
+{
+	DeformData *data = (DeformData *) arg;
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+	{
+		ExecStoreTuple(data->tuples[i % DEFORM_TUPLES], data->slot,
+					   InvalidBuffer, false);
+		slot_getallattrs(data->slot);
+	}
+}
+
+static void
+deform_teardown(void *arg)
+{
+	DeformData *data = (DeformData *) arg;
+
+	ExecDropSingleTupleTableSlot(data->slot);
+}
+
+const Microbenchmark executor_benchmarks[] = {
+	{"sort_int4", "tuplesort of int4 datums, per datum",
+	 100000, false, sort_int4_setup, sort_datum_run, sort_teardown},
+	{"sort_text", "tuplesort of text datums in the default collation, per datum",
+	 100000, false, sort_text_setup, sort_datum_run, sort_teardown},
+	{"sort_multikey", "tuplesort of heap tuples on (int4, int8), per tuple",
+	 100000, false, sort_multikey_setup, sort_multikey_run, sort_teardown},
+	{"hashjoin_build", "ExecHashTableInsert of an int4 key, per tuple",
+	 50000, false, hashjoin_build_setup, hashjoin_build_run, hashjoin_teardown},
+	{"hashjoin_probe", "ExecScanHashBucket with an int4 key, per outer tuple",
+	 50000, false, hashjoin_probe_setup, hashjoin_probe_run, hashjoin_teardown},
+	{"deform_tuple", "slot_getallattrs of a 10-column tuple, per tuple",
+	 1000000, false, deform_setup, deform_run, deform_teardown}
+};
+
+const int	num_executor_benchmarks = lengthof(executor_benchmarks);
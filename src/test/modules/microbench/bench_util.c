@@ -0,0 +1,436 @@
+/*--------------------------------------------------------------------------
+ *
+ * bench_util.c
+ *		Micro-benchmarks for hashing, memory allocation and LWLocks.
+ *
+ * The contended LWLock benchmarks start background workers that hammer the
+ * same lock as the backend running the benchmark, so they can't be run in
+ * single-user mode.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/microbench/bench_util.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+#include "microbench.h"
+
+/* number of backends besides our own contending for the lock */
+#define LWLOCK_WORKERS		3
+
+/* number of chunks the allocation benchmark keeps allocated */
+#define ALLOC_WINDOW		64
+
+/* the hashing benchmarks hash keys at HASH_OFFSETS offsets in their data */
+#define HASH_OFFSETS		512
+#define HASH_DATA_SIZE		(HASH_OFFSETS + 64)
+
+typedef struct LWLockBenchShared
+{
+	LWLock		lock;
+	int			tranche_id;
+	LWLockMode	mode;
+	int64		loops;
+	pg_atomic_uint32 attached;	/* number of workers ready to go */
+	pg_atomic_uint32 go;		/* set when the workers should start */
+	pg_atomic_uint32 done;		/* number of workers finished */
+} LWLockBenchShared;
+
+typedef struct LWLockBenchData
+{
+	LWLockMode	mode;
+	LWLock	   *lock;			/* for the uncontended case */
+	dsm_segment *seg;
+	LWLockBenchShared *shared;
+	int			nworkers;
+	BackgroundWorkerHandle *handle[LWLOCK_WORKERS];
+} LWLockBenchData;
+
+typedef struct HashBenchData
+{
+	int			keylen;
+	unsigned char data[HASH_DATA_SIZE];
+} HashBenchData;
+
+typedef struct AllocBenchData
+{
+	MemoryContext cxt;
+	void	   *chunks[ALLOC_WINDOW];
+} AllocBenchData;
+
+static LWLockTranche microbench_tranche;
+static int	microbench_tranche_id = 0;
+
+/* chunk sizes the allocation benchmark cycles through */
+static const Size alloc_sizes[] = {16, 24, 40, 64, 100, 200, 500, 1000};
+
+static void lwlock_register_tranche(int tranche_id, LWLock *lock);
+static void lwlock_loop(LWLock *lock, LWLockMode mode, int64 loops);
+static void lwlock_check_workers(LWLockBenchData *data);
+static void lwlock_cleanup(dsm_segment *seg, Datum arg);
+
+/* ----------
+ * Hashing
+ * ----------
+ */
+
+static void *
+hash_setup(int keylen)
+{
+	HashBenchData *data = palloc(sizeof(HashBenchData));
+	uint32		seed = 1;
+	int			i;
+
+	data->keylen = keylen;
+	for (i = 0; i < HASH_DATA_SIZE; i++)
+		data->data[i] = (unsigned char) microbench_random(&seed);
+	return data;
+}
+
+static void *
+hash_any_8_setup(int64 loops)
+{
+	return hash_setup(8);
+}
+
+static void *
+hash_any_64_setup(int64 loops)
+{
+	return hash_setup(64);
+}
+
+/*
+ * Hash keys at varying offsets, so that misaligned ones are included.
+ */
+static void
+hash_any_run(void *arg, int64 loops)
+{
+	HashBenchData *data = (HashBenchData *) arg;
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+		(void) hash_any(data->data + (i % HASH_OFFSETS), data->keylen);
+}
+
+/* ----------
+ * Memory allocation
+ * ----------
+ */
+
+static void *
+alloc_setup(int64 loops)
+{
+	AllocBenchData *data = palloc0(sizeof(AllocBenchData));
+	int			i;
+
+	data->cxt = AllocSetContextCreate(CurrentMemoryContext,
+									  "microbench allocations",
+									  ALLOCSET_DEFAULT_MINSIZE,
+									  ALLOCSET_DEFAULT_INITSIZE,
+									  ALLOCSET_DEFAULT_MAXSIZE);
+	for (i = 0; i < ALLOC_WINDOW; i++)
+		data->chunks[i] = MemoryContextAlloc(data->cxt,
+									alloc_sizes[i % lengthof(alloc_sizes)]);
+	return data;
+}
+
+/*
+ * Replace the chunks round-robin with chunks of another size, so that the
+ * allocator has to find free chunks of the right size rather than handing
+ * back the one that was just freed.
+ */
+static void
+alloc_run(void *arg, int64 loops)
+{
+	AllocBenchData *data = (AllocBenchData *) arg;
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+	{
+		int			slot = i % ALLOC_WINDOW;
+
+		pfree(data->chunks[slot]);
+		data->chunks[slot] = MemoryContextAlloc(data->cxt,
+							 alloc_sizes[(i / 3) % lengthof(alloc_sizes)]);
+	}
+}
+
+/* ----------
+ * LWLocks
+ * ----------
+ */
+
+static void
+lwlock_register_tranche(int tranche_id, LWLock *lock)
+{
+	microbench_tranche.name = "microbench";
+	microbench_tranche.array_base = lock;
+	microbench_tranche.array_stride = sizeof(LWLock);
+	LWLockRegisterTranche(tranche_id, &microbench_tranche);
+}
+
+static void
+lwlock_loop(LWLock *lock, LWLockMode mode, int64 loops)
+{
+	int64		i;
+
+	for (i = 0; i < loops; i++)
+	{
+		LWLockAcquire(lock, mode);
+		LWLockRelease(lock);
+	}
+}
+
+static void *
+lwlock_uncontended_setup(int64 loops)
+{
+	LWLockBenchData *data = palloc0(sizeof(LWLockBenchData));
+
+	if (microbench_tranche_id == 0)
+		microbench_tranche_id = LWLockNewTrancheId();
+
+	data->mode = LW_EXCLUSIVE;
+	data->lock = palloc(sizeof(LWLock));
+	lwlock_register_tranche(microbench_tranche_id, data->lock);
+	LWLockInitialize(data->lock, microbench_tranche_id);
+	return data;
+}
+
+static void
+lwlock_uncontended_run(void *arg, int64 loops)
+{
+	LWLockBenchData *data = (LWLockBenchData *) arg;
+
+	lwlock_loop(data->lock, data->mode, loops);
+}
+
+/*
+ * Put the lock in a dynamic shared memory segment, start the workers, and
+ * wait until they're all spinning, ready to go.
+ */
+static void *
+lwlock_contended_setup(int64 loops, LWLockMode mode)
+{
+	LWLockBenchData *data;
+	LWLockBenchShared *shared;
+	BackgroundWorker worker;
+	MemoryContext oldcxt;
+	int			i;
+
+	if (microbench_tranche_id == 0)
+		microbench_tranche_id = LWLockNewTrancheId();
+
+	/*
+	 * The worker handles must survive until the on_dsm_detach callback runs,
+	 * which may be after our memory context is gone if we error out.
+	 */
+	oldcxt = MemoryContextSwitchTo(TopTransactionContext);
+	data = palloc0(sizeof(LWLockBenchData));
+	data->mode = mode;
+
+	data->seg = dsm_create(sizeof(LWLockBenchShared), 0);
+	shared = data->shared = dsm_segment_address(data->seg);
+	shared->tranche_id = microbench_tranche_id;
+	shared->mode = mode;
+	shared->loops = loops;
+	pg_atomic_init_u32(&shared->attached, 0);
+	pg_atomic_init_u32(&shared->go, 0);
+	pg_atomic_init_u32(&shared->done, 0);
+	lwlock_register_tranche(microbench_tranche_id, &shared->lock);
+	LWLockInitialize(&shared->lock, microbench_tranche_id);
+
+	on_dsm_detach(data->seg, lwlock_cleanup, PointerGetDatum(data));
+
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	worker.bgw_main = NULL;
+	sprintf(worker.bgw_library_name, "microbench");
+	sprintf(worker.bgw_function_name, "microbench_lwlock_worker");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "microbench worker");
+	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(data->seg));
+	worker.bgw_notify_pid = MyProcPid;
+
+	for (i = 0; i < LWLOCK_WORKERS; i++)
+	{
+		if (!RegisterDynamicBackgroundWorker(&worker, &data->handle[i]))
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("could not register background process"),
+				 errhint("You may need to increase max_worker_processes.")));
+		data->nworkers++;
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	for (i = 0; i < data->nworkers; i++)
+	{
+		pid_t		pid;
+
+		if (WaitForBackgroundWorkerStartup(data->handle[i], &pid) != BGWH_STARTED)
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("could not start background process")));
+	}
+	while (pg_atomic_read_u32(&shared->attached) < data->nworkers)
+	{
+		lwlock_check_workers(data);
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(1000L);
+	}
+
+	return data;
+}
+
+static void *
+lwlock_exclusive_setup(int64 loops)
+{
+	return lwlock_contended_setup(loops, LW_EXCLUSIVE);
+}
+
+static void *
+lwlock_shared_setup(int64 loops)
+{
+	return lwlock_contended_setup(loops, LW_SHARED);
+}
+
+/*
+ * Let the workers go, take our share of the lock acquisitions, and wait for
+ * the workers to finish theirs.
+ */
+static void
+lwlock_contended_run(void *arg, int64 loops)
+{
+	LWLockBenchData *data = (LWLockBenchData *) arg;
+	LWLockBenchShared *shared = data->shared;
+	uint32		spins = 0;
+
+	pg_atomic_write_u32(&shared->go, 1);
+	lwlock_loop(&shared->lock, data->mode, loops);
+
+	while (pg_atomic_read_u32(&shared->done) < data->nworkers)
+	{
+		if (++spins % 1000000 == 0)
+		{
+			lwlock_check_workers(data);
+			CHECK_FOR_INTERRUPTS();
+		}
+		pg_spin_delay();
+	}
+}
+
+static void
+lwlock_contended_teardown(void *arg)
+{
+	LWLockBenchData *data = (LWLockBenchData *) arg;
+	int			i;
+
+	for (i = 0; i < data->nworkers; i++)
+		WaitForBackgroundWorkerShutdown(data->handle[i]);
+	data->nworkers = 0;
+	dsm_detach(data->seg);
+	pfree(data);
+}
+
+/*
+ * Complain if any of the workers has died.
+ */
+static void
+lwlock_check_workers(LWLockBenchData *data)
+{
+	int			i;
+
+	for (i = 0; i < data->nworkers; i++)
+	{
+		BgwHandleStatus status;
+		pid_t		pid;
+
+		status = GetBackgroundWorkerPid(data->handle[i], &pid);
+		if (status == BGWH_STOPPED || status == BGWH_POSTMASTER_DIED)
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("background worker exited prematurely")));
+	}
+}
+
+/*
+ * on_dsm_detach callback: if we error out with workers still running, kill
+ * them rather than leaving them waiting for us forever.
+ */
+static void
+lwlock_cleanup(dsm_segment *seg, Datum arg)
+{
+	LWLockBenchData *data = (LWLockBenchData *) DatumGetPointer(arg);
+
+	while (data->nworkers > 0)
+	{
+		--data->nworkers;
+		TerminateBackgroundWorker(data->handle[data->nworkers]);
+	}
+}
+
+/*
+ * Background worker entrypoint for the contended LWLock benchmarks.
+ */
+void
+microbench_lwlock_worker(Datum main_arg)
+{
+	dsm_segment *seg;
+	LWLockBenchShared *shared;
+
+	BackgroundWorkerUnblockSignals();
+
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "microbench worker");
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("unable to map dynamic shared memory segment")));
+	shared = dsm_segment_address(seg);
+	lwlock_register_tranche(shared->tranche_id, &shared->lock);
+
+	pg_atomic_fetch_add_u32(&shared->attached, 1);
+	while (pg_atomic_read_u32(&shared->go) == 0)
+		pg_spin_delay();
+
+	lwlock_loop(&shared->lock, shared->mode, shared->loops);
+
+	pg_atomic_fetch_add_u32(&shared->done, 1);
+	dsm_detach(seg);
+	proc_exit(0);
+}
+
+const Microbenchmark util_benchmarks[] = {
+	{"hash_any_8", "hash_any of an 8-byte key, per key",
+	 10000000, false, hash_any_8_setup, hash_any_run, NULL},
+	{"hash_any_64", "hash_any of a 64-byte key, per key",
+	 10000000, false, hash_any_64_setup, hash_any_run, NULL},
+	{"allocset_alloc", "AllocSetAlloc and AllocSetFree of small chunks, per pair",
+	 10000000, false, alloc_setup, alloc_run, NULL},
+	{"lwlock_uncontended", "LWLockAcquire and LWLockRelease in exclusive mode, per pair",
+	 10000000, false, lwlock_uncontended_setup, lwlock_uncontended_run, NULL},
+	{"lwlock_exclusive_contended",
+	 "LWLockAcquire and LWLockRelease in exclusive mode, 4 backends, per pair and backend",
+	 1000000, true, lwlock_exclusive_setup, lwlock_contended_run,
+	 lwlock_contended_teardown},
+	{"lwlock_shared_contended",
+	 "LWLockAcquire and LWLockRelease in shared mode, 4 backends, per pair and backend",
+	 1000000, true, lwlock_shared_setup, lwlock_contended_run,
+	 lwlock_contended_teardown}
+};
+
+const int	num_util_benchmarks = lengthof(util_benchmarks);
@@ -0,0 +1,23 @@
+/* src/test/modules/microbench/microbench--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION microbench" to load this file. \quit
+
+CREATE FUNCTION microbench_list(
+    OUT benchmark pg_catalog.text,
+    OUT default_loops pg_catalog.int8,
+    OUT description pg_catalog.text)
+    RETURNS SETOF record
+	AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION microbench(benchmarks pg_catalog.text[] DEFAULT NULL,
+    loop_count pg_catalog.int8 DEFAULT 0,
+    repeat_count pg_catalog.int4 DEFAULT 5,
+    OUT benchmark pg_catalog.text,
+    OUT loops pg_catalog.int8,
+    OUT repeats pg_catalog.int4,
+    OUT min_ns pg_catalog.float8,
+    OUT median_ns pg_catalog.float8,
+    OUT max_ns pg_catalog.float8)
+    RETURNS SETOF record
+	AS 'MODULE_PATHNAME' LANGUAGE C VOLATILE;
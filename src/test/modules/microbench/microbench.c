@@ -0,0 +1,325 @@
+/*--------------------------------------------------------------------------
+ *
+ * microbench.c
+ *		Driver for the backend micro-benchmarks.
+ *
+ * Each benchmark runs one hot path of the backend in a tight loop, on data
+ * prepared beforehand, so that changes to that code can be measured without
+ * the noise of a whole query.  The driver runs each benchmark once to warm
+ * up, then the requested number of times, and reports the fastest, median
+ * and slowest time per operation.  The median is the figure to compare
+ * across builds; a wide spread means the measurement can't be trusted.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/microbench/microbench.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+#include "microbench.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(microbench_list);
+PG_FUNCTION_INFO_V1(microbench);
+
+typedef struct BenchmarkGroup
+{
+	const Microbenchmark *benchmarks;
+	const int  *count;
+} BenchmarkGroup;
+
+static const BenchmarkGroup groups[] = {
+	{executor_benchmarks, &num_executor_benchmarks},
+	{access_benchmarks, &num_access_benchmarks},
+	{util_benchmarks, &num_util_benchmarks}
+};
+
+#define NUM_GROUPS	lengthof(groups)
+
+static Tuplestorestate *begin_result(FunctionCallInfo fcinfo,
+			 TupleDesc *tupdesc);
+static double run_benchmark(const Microbenchmark *bench, int64 loops);
+static int	compare_doubles(const void *a, const void *b);
+
+/*
+ * A cheap, repeatable pseudo-random number generator (xorshift), so that
+ * every run of a benchmark works on the same data.  *seed must not be zero.
+ */
+uint32
+microbench_random(uint32 *seed)
+{
+	uint32		x = *seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+	return x;
+}
+
+/*
+ * Run a utility statement through SPI, for benchmarks that need tables.
+ */
+void
+microbench_execute(const char *sql)
+{
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+	if (SPI_execute(sql, false, 0) < 0)
+		elog(ERROR, "SPI_execute failed: %s", sql);
+	SPI_finish();
+}
+
+/*
+ * List the available benchmarks.
+ */
+Datum
+microbench_list(PG_FUNCTION_ARGS)
+{
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	int			g;
+	int			i;
+
+	tupstore = begin_result(fcinfo, &tupdesc);
+
+	for (g = 0; g < NUM_GROUPS; g++)
+	{
+		for (i = 0; i < *groups[g].count; i++)
+		{
+			const Microbenchmark *bench = &groups[g].benchmarks[i];
+			Datum		values[3];
+			bool		nulls[3];
+
+			memset(nulls, 0, sizeof(nulls));
+			values[0] = CStringGetTextDatum(bench->name);
+			values[1] = Int64GetDatum(bench->default_loops);
+			values[2] = CStringGetTextDatum(bench->description);
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Run the given benchmarks, or all of them if the array is NULL, each
+ * repeat_count times with loop_count operations, or the benchmark's default
+ * number if that's zero.
+ */
+Datum
+microbench(PG_FUNCTION_ARGS)
+{
+	int64		loop_count = PG_ARGISNULL(1) ? 0 : PG_GETARG_INT64(1);
+	int32		repeat_count = PG_ARGISNULL(2) ? 5 : PG_GETARG_INT32(2);
+	Datum	   *names = NULL;
+	int			nnames = 0;
+	bool	   *found = NULL;
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	double	   *times;
+	int			g;
+	int			i;
+
+	if (loop_count < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("loop count must not be negative")));
+	if (repeat_count < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("repeat count must be at least 1")));
+
+	if (!PG_ARGISNULL(0))
+	{
+		deconstruct_array(PG_GETARG_ARRAYTYPE_P(0), TEXTOID, -1, false, 'i',
+						  &names, NULL, &nnames);
+		found = (bool *) palloc0(nnames * sizeof(bool));
+	}
+
+	/* complain about unknown names before spending any time */
+	for (i = 0; i < nnames; i++)
+	{
+		char	   *name = TextDatumGetCString(names[i]);
+		int			j;
+
+		for (g = 0; g < NUM_GROUPS && !found[i]; g++)
+			for (j = 0; j < *groups[g].count && !found[i]; j++)
+				found[i] = (strcmp(groups[g].benchmarks[j].name, name) == 0);
+		if (!found[i])
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_OBJECT),
+					 errmsg("benchmark \"%s\" does not exist", name)));
+	}
+
+	tupstore = begin_result(fcinfo, &tupdesc);
+	times = (double *) palloc(repeat_count * sizeof(double));
+
+	for (g = 0; g < NUM_GROUPS; g++)
+	{
+		for (i = 0; i < *groups[g].count; i++)
+		{
+			const Microbenchmark *bench = &groups[g].benchmarks[i];
+			int64		loops;
+			int			r;
+			Datum		values[6];
+			bool		nulls[6];
+
+			if (names != NULL)
+			{
+				int			j;
+
+				for (j = 0; j < nnames; j++)
+				{
+					char	   *name = TextDatumGetCString(names[j]);
+
+					if (strcmp(bench->name, name) == 0)
+						break;
+				}
+				if (j >= nnames)
+					continue;
+			}
+
+			if (bench->needs_workers && !IsUnderPostmaster)
+			{
+				ereport(NOTICE,
+						(errmsg("skipping benchmark \"%s\", which needs background workers",
+								bench->name)));
+				continue;
+			}
+
+			loops = (loop_count > 0) ? loop_count : bench->default_loops;
+
+			/* the first run only warms up caches and the like */
+			for (r = -1; r < repeat_count; r++)
+			{
+				double		elapsed = run_benchmark(bench, loops);
+
+				if (r >= 0)
+					times[r] = elapsed / loops;
+				CHECK_FOR_INTERRUPTS();
+			}
+
+			qsort(times, repeat_count, sizeof(double), compare_doubles);
+
+			memset(nulls, 0, sizeof(nulls));
+			values[0] = CStringGetTextDatum(bench->name);
+			values[1] = Int64GetDatum(loops);
+			values[2] = Int32GetDatum(repeat_count);
+			values[3] = Float8GetDatum(times[0]);
+			if (repeat_count % 2 == 1)
+				values[4] = Float8GetDatum(times[repeat_count / 2]);
+			else
+				values[4] = Float8GetDatum((times[repeat_count / 2 - 1] +
+											times[repeat_count / 2]) / 2);
+			values[5] = Float8GetDatum(times[repeat_count - 1]);
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * Set up to return a materialized result set.
+ */
+static Tuplestorestate *
+begin_result(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = *tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return tupstore;
+}
+
+/*
+ * Run a benchmark once, and return the time it took in nanoseconds.
+ */
+static double
+run_benchmark(const Microbenchmark *bench, int64 loops)
+{
+	MemoryContext benchcxt;
+	MemoryContext oldcxt;
+	void	   *arg;
+	instr_time	start;
+	instr_time	duration;
+
+	benchcxt = AllocSetContextCreate(CurrentMemoryContext,
+									 "microbench",
+									 ALLOCSET_DEFAULT_MINSIZE,
+									 ALLOCSET_DEFAULT_INITSIZE,
+									 ALLOCSET_DEFAULT_MAXSIZE);
+	oldcxt = MemoryContextSwitchTo(benchcxt);
+
+	arg = bench->setup(loops);
+
+	INSTR_TIME_SET_CURRENT(start);
+	bench->run(arg, loops);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	if (bench->teardown)
+		bench->teardown(arg);
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(benchcxt);
+
+	return INSTR_TIME_GET_DOUBLE(duration) * 1000000000.0;
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double		x = *(const double *) a;
+	double		y = *(const double *) b;
+
+	if (x < y)
+		return -1;
+	return (x > y) ? 1 : 0;
+}
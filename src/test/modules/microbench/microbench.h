@@ -0,0 +1,54 @@
+/*--------------------------------------------------------------------------
+ *
+ * microbench.h
+ *		Definitions for the backend micro-benchmarks
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/microbench/microbench.h
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+/*
+ * A benchmark times "loops" operations of one kind, run by a single call of
+ * its run function.  The setup function prepares whatever the operations
+ * work on and returns it, to be passed to run and then to teardown; neither
+ * of those is timed.  All three are called once per repetition, in a memory
+ * context that is deleted afterwards, so teardown need only release what
+ * memory context deletion doesn't.
+ */
+typedef struct Microbenchmark
+{
+	const char *name;
+	const char *description;
+	int64		default_loops;
+	bool		needs_workers;	/* uses background workers? */
+	void	   *(*setup) (int64 loops);
+	void		(*run) (void *arg, int64 loops);
+	void		(*teardown) (void *arg);	/* may be NULL */
+} Microbenchmark;
+
+/* bench_access.c */
+extern const Microbenchmark access_benchmarks[];
+extern const int num_access_benchmarks;
+
+/* bench_executor.c */
+extern const Microbenchmark executor_benchmarks[];
+extern const int num_executor_benchmarks;
+
+/* bench_util.c */
+extern const Microbenchmark util_benchmarks[];
+extern const int num_util_benchmarks;
+
+extern void microbench_lwlock_worker(Datum main_arg);
+
+/* microbench.c */
+extern uint32 microbench_random(uint32 *seed);
+extern void microbench_execute(const char *sql);
+
+#endif   /* MICROBENCH_H */
@@ -0,0 +1,18 @@
+CREATE EXTENSION microbench;
+
+SELECT benchmark, default_loops FROM microbench_list();
+
+--
+-- Run every benchmark with a small loop count.  The timings themselves vary
+-- from run to run, so only check that they add up.
+--
+SELECT benchmark, loops, repeats,
+	min_ns > 0 AND min_ns <= median_ns AND median_ns <= max_ns AS sane
+FROM microbench(NULL, 100, 3);
+
+SELECT benchmark, loops FROM microbench(ARRAY['hash_any_8', 'deform_tuple'], 10);
+
+-- errors
+SELECT * FROM microbench(ARRAY['no_such_benchmark']);
+SELECT * FROM microbench(NULL, -1);
+SELECT * FROM microbench(NULL, 10, 0);
@@ -0,0 +1,17 @@
+CREATE EXTENSION test_atomics;
+
+--
+-- Benchmark functions.  The counters are shared by all sessions, so only
+-- check that they went up by at least as much as we added.  To time the
+-- primitives, run these with larger counts, in several sessions at once.
+--
+SELECT bench_atomic_fetch_add(0) AS before32 \gset
+SELECT bench_atomic_fetch_add(1000) - :before32 >= 1000 AS ok;
+SELECT bench_atomic_compare_exchange(1000) - :before32 >= 2000 AS ok;
+
+SELECT bench_spinlock(0) AS before \gset
+SELECT bench_spinlock(1000) - :before >= 1000 AS ok;
+
+SELECT bench_lwlock(0) AS before \gset
+SELECT bench_lwlock(1000) - :before >= 1000 AS ok;
+SELECT bench_lwlock(1000, false) - :before >= 1000 AS ok;
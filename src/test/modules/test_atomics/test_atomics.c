@@ -0,0 +1,231 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_atomics.c
+ *		Benchmark code for atomic operations, spinlocks and LWLocks.
+ *
+ * All the benchmarks work on counters in a small chunk of shared memory,
+ * allocated when first used, so that running them in several sessions at
+ * once shows how the primitives behave under contention.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_atomics/test_atomics.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(bench_atomic_fetch_add);
+PG_FUNCTION_INFO_V1(bench_atomic_compare_exchange);
+PG_FUNCTION_INFO_V1(bench_atomic_fetch_add_u64);
+PG_FUNCTION_INFO_V1(bench_spinlock);
+PG_FUNCTION_INFO_V1(bench_lwlock);
+
+/*
+ * Each counter, with whatever protects it, gets a cache line of its own, so
+ * that the benchmarks don't disturb each other.
+ */
+typedef struct BenchAtomicsState
+{
+	pg_atomic_uint32 counter32;
+	char		pad1[PG_CACHE_LINE_SIZE - sizeof(pg_atomic_uint32)];
+#ifdef PG_HAVE_ATOMIC_U64_SUPPORT
+	pg_atomic_uint64 counter64;
+	char		pad2[PG_CACHE_LINE_SIZE - sizeof(pg_atomic_uint64)];
+#endif
+	slock_t		mutex;
+	int64		spin_counter;	/* protected by mutex */
+	char		pad3[PG_CACHE_LINE_SIZE - sizeof(slock_t) - sizeof(int64)];
+	LWLockPadded lock;
+	int64		lwlock_counter;	/* protected by lock */
+	int			tranche_id;
+} BenchAtomicsState;
+
+static BenchAtomicsState *bench_state = NULL;
+static LWLockTranche bench_tranche;
+
+/*
+ * Attach to the shared state, creating it if we're the first.
+ */
+static BenchAtomicsState *
+bench_attach(void)
+{
+	bool		found;
+
+	if (bench_state != NULL)
+		return bench_state;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+	bench_state = (BenchAtomicsState *)
+		ShmemInitStruct("test_atomics", sizeof(BenchAtomicsState), &found);
+	if (!found)
+	{
+		pg_atomic_init_u32(&bench_state->counter32, 0);
+#ifdef PG_HAVE_ATOMIC_U64_SUPPORT
+		pg_atomic_init_u64(&bench_state->counter64, 0);
+#endif
+		SpinLockInit(&bench_state->mutex);
+		bench_state->spin_counter = 0;
+		bench_state->tranche_id = LWLockNewTrancheId();
+		LWLockInitialize(&bench_state->lock.lock, bench_state->tranche_id);
+		bench_state->lwlock_counter = 0;
+	}
+	LWLockRelease(AddinShmemInitLock);
+
+	bench_tranche.name = "test_atomics";
+	bench_tranche.array_base = &bench_state->lock;
+	bench_tranche.array_stride = sizeof(LWLockPadded);
+	LWLockRegisterTranche(bench_state->tranche_id, &bench_tranche);
+
+	return bench_state;
+}
+
+/*
+ * Increment the 32 bit counter with fetch-and-add, count times.
+ */
+Datum
+bench_atomic_fetch_add(PG_FUNCTION_ARGS)
+{
+	int32		count = PG_GETARG_INT32(0);
+	BenchAtomicsState *state = bench_attach();
+	int32		i;
+
+	for (i = 0; i < count; i++)
+	{
+		pg_atomic_fetch_add_u32(&state->counter32, 1);
+
+		if ((i & 0xFFFF) == 0)
+			CHECK_FOR_INTERRUPTS();
+	}
+
+	PG_RETURN_INT64((int64) pg_atomic_read_u32(&state->counter32));
+}
+
+/*
+ * Increment the 32 bit counter with a compare-and-exchange loop, count
+ * times.
+ */
+Datum
+bench_atomic_compare_exchange(PG_FUNCTION_ARGS)
+{
+	int32		count = PG_GETARG_INT32(0);
+	BenchAtomicsState *state = bench_attach();
+	int32		i;
+
+	for (i = 0; i < count; i++)
+	{
+		uint32		old = pg_atomic_read_u32(&state->counter32);
+
+		/* on failure, old is updated to the current value */
+		while (!pg_atomic_compare_exchange_u32(&state->counter32,
+											   &old, old + 1))
+			;
+
+		if ((i & 0xFFFF) == 0)
+			CHECK_FOR_INTERRUPTS();
+	}
+
+	PG_RETURN_INT64((int64) pg_atomic_read_u32(&state->counter32));
+}
+
+/*
+ * Increment the 64 bit counter with fetch-and-add, count times.
+ */
+Datum
+bench_atomic_fetch_add_u64(PG_FUNCTION_ARGS)
+{
+#ifdef PG_HAVE_ATOMIC_U64_SUPPORT
+	int32		count = PG_GETARG_INT32(0);
+	BenchAtomicsState *state = bench_attach();
+	int32		i;
+
+	for (i = 0; i < count; i++)
+	{
+		pg_atomic_fetch_add_u64(&state->counter64, 1);
+
+		if ((i & 0xFFFF) == 0)
+			CHECK_FOR_INTERRUPTS();
+	}
+
+	PG_RETURN_INT64((int64) pg_atomic_read_u64(&state->counter64));
+#else
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("64 bit atomics are not supported on this platform")));
+	PG_RETURN_NULL();			/* keep compiler quiet */
+#endif
+}
+
+/*
+ * Increment the spinlock-protected counter, count times.
+ */
+Datum
+bench_spinlock(PG_FUNCTION_ARGS)
+{
+	int32		count = PG_GETARG_INT32(0);
+	BenchAtomicsState *state = bench_attach();
+	volatile BenchAtomicsState *vstate = state;
+	int64		result;
+	int32		i;
+
+	for (i = 0; i < count; i++)
+	{
+		SpinLockAcquire(&vstate->mutex);
+		vstate->spin_counter++;
+		SpinLockRelease(&vstate->mutex);
+
+		if ((i & 0xFFFF) == 0)
+			CHECK_FOR_INTERRUPTS();
+	}
+
+	SpinLockAcquire(&vstate->mutex);
+	result = vstate->spin_counter;
+	SpinLockRelease(&vstate->mutex);
+
+	PG_RETURN_INT64(result);
+}
+
+/*
+ * Acquire the LWLock count times, incrementing the counter it protects if
+ * exclusive, or just reading it if not.
+ */
+Datum
+bench_lwlock(PG_FUNCTION_ARGS)
+{
+	int32		count = PG_GETARG_INT32(0);
+	bool		exclusive = PG_GETARG_BOOL(1);
+	BenchAtomicsState *state = bench_attach();
+	volatile int64 *counter = &state->lwlock_counter;
+	int64		result;
+	int32		i;
+
+	for (i = 0; i < count; i++)
+	{
+		LWLockAcquire(&state->lock.lock, exclusive ? LW_EXCLUSIVE : LW_SHARED);
+		if (exclusive)
+			(*counter)++;
+		else
+			result = *counter;
+		LWLockRelease(&state->lock.lock);
+
+		if ((i & 0xFFFF) == 0)
+			CHECK_FOR_INTERRUPTS();
+	}
+
+	LWLockAcquire(&state->lock.lock, LW_SHARED);
+	result = *counter;
+	LWLockRelease(&state->lock.lock);
+
+	PG_RETURN_INT64(result);
+}
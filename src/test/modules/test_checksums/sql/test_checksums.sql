@@ -0,0 +1,30 @@
+CREATE EXTENSION test_checksums;
+
+--
+-- CRC-32C.  The inputs are long and misaligned enough to exercise all the
+-- code paths of the implementations chosen at runtime.
+--
+SELECT test_crc32c('');
+SELECT test_crc32c('123456789');
+
+SELECT n, test_crc32c(repeat('abcdefghij', n)::bytea) AS "offset 0",
+	test_crc32c(substring(repeat('abcdefghij', n)::bytea from 2)) AS "offset 1",
+	test_crc32c(substring(repeat('abcdefghij', n)::bytea from 4)) AS "offset 3"
+FROM (VALUES (1), (6), (25), (26), (100), (820)) v(n);
+
+--
+-- Page checksums
+--
+SELECT test_page_checksum(decode(repeat('0123456789abcdef', 1024), 'hex'), 0);
+SELECT test_page_checksum(decode(repeat('0123456789abcdef', 1024), 'hex'), 12345);
+
+-- errors
+SELECT test_page_checksum(decode(repeat('00', 8192), 'hex'), 0);
+SELECT test_page_checksum('\x0123', 0);
+
+--
+-- Benchmark functions.  To time the implementations in use, run these with
+-- larger counts.
+--
+SELECT bench_crc32c(1000, 3);
+SELECT bench_page_checksum(5);
@@ -0,0 +1,157 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_checksums.c
+ *		Test and benchmark code for CRC-32C and page checksums.
+ *
+ * Both are computed by several implementations, one of which is chosen at
+ * runtime depending on the processor, so the tests only check that we get
+ * the values of the reference algorithms, whichever one is in use.
+ *
+ * Copyright (c) 2015, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_checksums/test_checksums.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "port/pg_crc32c.h"
+#include "storage/bufpage.h"
+#include "storage/checksum.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(test_crc32c);
+PG_FUNCTION_INFO_V1(test_page_checksum);
+PG_FUNCTION_INFO_V1(bench_crc32c);
+PG_FUNCTION_INFO_V1(bench_page_checksum);
+
+/*
+ * Fill a buffer with some arbitrary, but repeatable, data.
+ */
+static void
+fill_buffer(char *buf, int len)
+{
+	uint32		x = 1;
+	int			i;
+
+	for (i = 0; i < len; i++)
+	{
+		x = x * 1103515245 + 12345;
+		buf[i] = (char) (x >> 16);
+	}
+}
+
+/*
+ * Compute the CRC-32C of a bytea.
+ */
+Datum
+test_crc32c(PG_FUNCTION_ARGS)
+{
+	bytea	   *data = PG_GETARG_BYTEA_PP(0);
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, VARDATA_ANY(data), VARSIZE_ANY_EXHDR(data));
+	FIN_CRC32C(crc);
+
+	PG_RETURN_INT64((int64) crc);
+}
+
+/*
+ * Compute the checksum of a bytea holding a page image, as if it was stored
+ * at the given block number.
+ */
+Datum
+test_page_checksum(PG_FUNCTION_ARGS)
+{
+	bytea	   *data = PG_GETARG_BYTEA_PP(0);
+	int64		blkno = PG_GETARG_INT64(1);
+	char	   *page;
+
+	if (VARSIZE_ANY_EXHDR(data) != BLCKSZ)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("page image must be exactly %d bytes", BLCKSZ)));
+	if (blkno < 0 || blkno > MaxBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid block number " INT64_FORMAT, blkno)));
+
+	/* copy the image, to get it suitably aligned */
+	page = (char *) palloc(BLCKSZ);
+	memcpy(page, VARDATA_ANY(data), BLCKSZ);
+
+	if (PageIsNew(page))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("page image is not initialized")));
+
+	PG_RETURN_INT32((int32) pg_checksum_page(page, (BlockNumber) blkno));
+}
+
+/*
+ * Compute the CRC-32C of len bytes of data, count times over, for timing
+ * the implementation in use.  Returns the last CRC.
+ */
+Datum
+bench_crc32c(PG_FUNCTION_ARGS)
+{
+	int32		len = PG_GETARG_INT32(0);
+	int32		count = PG_GETARG_INT32(1);
+	char	   *buf;
+	pg_crc32c	crc = 0;
+	int32		i;
+
+	if (len < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("length must not be negative")));
+
+	buf = (char *) palloc(len + 1);
+	fill_buffer(buf, len);
+
+	for (i = 0; i < count; i++)
+	{
+		/* chain the CRCs, so that none of the work can be skipped */
+		INIT_CRC32C(crc);
+		COMP_CRC32C(crc, buf, len);
+		FIN_CRC32C(crc);
+		if (len > 0)
+			buf[0] = (char) crc;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	PG_RETURN_INT64((int64) crc);
+}
+
+/*
+ * Compute the checksum of a page count times over, for timing the
+ * implementation in use.  Returns the XOR of all the checksums.
+ */
+Datum
+bench_page_checksum(PG_FUNCTION_ARGS)
+{
+	int32		count = PG_GETARG_INT32(0);
+	char	   *page;
+	uint16		result = 0;
+	int32		i;
+
+	page = (char *) palloc(BLCKSZ);
+	fill_buffer(page, BLCKSZ);
+	((PageHeader) page)->pd_upper = BLCKSZ;
+
+	for (i = 0; i < count; i++)
+	{
+		result ^= pg_checksum_page(page, (BlockNumber) i);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	PG_RETURN_INT32((int32) result);
+}
@@ -16,6 +16,7 @@
 #include "fmgr.h"
 #include "miscadmin.h"
 
+#include "pgstat.h"
 #include "test_shm_mq.h"
 
 PG_MODULE_MAGIC;
@@ -230,7 +231,7 @@ test_shm_mq_pipelined(PG_FUNCTION_ARGS)
 			 * have read or written data and therefore there may now be work
 			 * for us to do.
 			 */
-			WaitLatch(MyLatch, WL_LATCH_SET, 0);
+			WaitLatch(MyLatch, WL_LATCH_SET, 0, PG_WAIT_EXTENSION);
 			CHECK_FOR_INTERRUPTS();
 			ResetLatch(MyLatch);
 		}
@@ -0,0 +1,54 @@
+# Check that pg_hba.conf applies to the clients of the connection proxy,
+# not to the proxy's own connections to the server.
+use strict;
+use warnings;
+use TestLib;
+use Test::More tests => 10;
+
+my $tempdir = TestLib::tempdir;
+my $pgdata = "$tempdir/pgdata";
+my $proxy_port = ($ENV{PGPORT} + 1) % 65536;
+my $socketdir;
+
+start_test_server $tempdir;
+$socketdir = $ENV{PGHOST};
+
+open CONF, ">>$pgdata/postgresql.conf";
+print CONF "listen_addresses = '127.0.0.1'\n";
+print CONF "proxy_port = $proxy_port\n";
+close CONF;
+
+# Write pg_hba.conf with the given line for TCP connections from localhost.
+# Unix-domain socket connections are always trusted, as the proxy's own
+# connections to the server would be on a typical installation.
+sub set_host_line
+{
+	my $line = shift;
+
+	open HBA, ">$pgdata/pg_hba.conf";
+	print HBA "local all all trust\n";
+	print HBA "$line\n";
+	close HBA;
+	restart_test_server();
+}
+
+sub proxy_psql
+{
+	my ($host, $sql) = @_;
+	return [ 'psql', '-X', '-A', '-t', '-h', $host, '-p', $proxy_port,
+		'-d', 'postgres', '-c', $sql ];
+}
+
+set_host_line("host all all 127.0.0.1/32 reject");
+
+command_fails(proxy_psql('127.0.0.1', 'SELECT 1'),
+	'host line rejecting the client is enforced through the proxy');
+command_like(proxy_psql($socketdir, 'SELECT 1'), qr/^1$/m,
+	'local line applies to Unix-domain socket clients of the proxy');
+
+set_host_line("host all all 127.0.0.1/32 trust");
+
+command_like(proxy_psql('127.0.0.1', 'SELECT inet_client_addr()'),
+	qr/^127\.0\.0\.1$/m, 'host line admitting the client is used');
+command_like(proxy_psql($socketdir, 'SELECT inet_client_addr() IS NULL'),
+	qr/^t$/m, 'Unix-domain socket clients of the proxy are local');
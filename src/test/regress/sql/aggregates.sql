@@ -51,6 +51,14 @@ select avg(null::float8) from generate_series(1,3);
 select sum('NaN'::numeric) from generate_series(1,3);
 select avg('NaN'::numeric) from generate_series(1,3);
 
+-- sum(numeric) accumulates most inputs as scaled integers; check inputs
+-- that don't fit, mixed display scales, and inverse transitions
+select sum(x) from (values (1.5::numeric), (2.25), (-0.125), (99999999999999999999.1)) v(x);
+select sum(x) from (values (9223372036854775807::numeric), (9223372036854775807), (0.000000000000000001)) v(x);
+select sum(x) from (values (0.0000000000000000001::numeric), (1), (-1)) v(x);
+select i, sum(x) over (order by i rows between current row and 1 following)
+from (values (1, 1.5::numeric), (2, 2.25), (3, -0.125), (4, 99999999999999999999.1)) v(i, x);
+
 -- SQL2003 binary aggregates
 SELECT regr_count(b, a) FROM aggtest;
 SELECT regr_sxx(b, a) FROM aggtest;
@@ -590,3 +598,93 @@ drop view aggordview1;
 -- variadic aggregates
 select least_agg(q1,q2) from int8_tbl;
 select least_agg(variadic array[q1,q2]) from int8_tbl;
+
+-- batch-at-a-time execution of simple aggregates over a seqscan
+set enable_batch_execution = on;
+select count(*), count(ten), sum(four), min(ten), max(ten), avg(four)
+  from tenk1 where four < 3 and ten >= 0;
+select min(q1), max(q2), count(q2) from int8_tbl where q1 > 100;
+reset enable_batch_execution;
+
+-- hash aggregation that exceeds work_mem and spills to disk
+set work_mem = '64kB';
+set enable_sort = off;
+explain (costs off)
+select unique1 % 5000, count(*) from tenk1 group by 1;
+select count(*), sum(c), min(c), max(c)
+  from (select unique1 % 5000 as k, count(*) as c from tenk1 group by 1) s;
+select count(*), count(distinct k), min(total), max(total)
+  from (select unique1 % 4000 as k, sum(ten) as total, array_agg(ten) as a
+          from tenk1 group by 1) s;
+reset enable_sort;
+reset work_mem;
+
+-- the same, and an external sort, with compressed temporary files
+set temp_file_compression = on;
+set work_mem = '64kB';
+set enable_sort = off;
+select count(*), sum(c), min(c), max(c)
+  from (select unique1 % 5000 as k, count(*) as c from tenk1 group by 1) s;
+reset enable_sort;
+select count(*) from
+  (select ten, unique1,
+          lag(ten) over w as prevten, lag(unique1) over w as prev
+     from tenk1 window w as (order by ten, unique1)) s
+  where prevten > ten or (prevten = ten and prev >= unique1);
+reset work_mem;
+reset temp_file_compression;
+
+-- eager aggregation below joins
+create temp table eager_fact (k int, amount int);
+create temp table eager_dim (k int, name text);
+insert into eager_fact select g % 10, g from generate_series(1, 1000) g;
+insert into eager_dim select g, 'name' || (g % 3) from generate_series(0, 9) g;
+analyze eager_fact;
+analyze eager_dim;
+set enable_eager_aggregate = on;
+select d.name, sum(f.amount), count(*), min(f.amount), max(f.amount),
+       avg(f.amount)
+  from eager_fact f join eager_dim d on f.k = d.k
+  group by d.name order by d.name;
+select d.name, sum(f.amount), count(*)
+  from eager_fact f join eager_dim d on f.k = d.k
+  where f.amount > 500 and d.name <> 'name2'
+  group by d.name having count(*) > 10 order by d.name;
+select name, sum(amount) from eager_fact join eager_dim using (k)
+  group by name order by name;
+select count(*), sum(f.amount)
+  from eager_fact f, eager_dim d where f.k = d.k and d.name = 'name1';
+reset enable_eager_aggregate;
+drop table eager_fact;
+drop table eager_dim;
+
+-- approximate distinct counting with HyperLogLog sketches
+select approx_count_distinct(x) from (values (null::int)) v(x);
+select approx_count_distinct(g % 1000) between 950 and 1050
+  from generate_series(1, 20000) g;
+select approx_count_distinct(g::text, 14) between 94000 and 106000
+  from generate_series(1, 100000) g;
+select g % 3 as k, approx_count_distinct(g) between 950 and 1050
+  from generate_series(1, 3000) g group by k order by k;
+select length(hll_sketch_agg(g)), length(hll_sketch_agg(g, 4))
+  from generate_series(1, 10) g;
+select hll_sketch_agg(x) is null from (values (null::int)) v(x);
+-- stored sketches can be rolled up, with the same result as one pass
+create temp table hll_daily as
+  select g % 7 as day, hll_sketch_agg(g % 3000) as sketch
+  from generate_series(1, 30000) g group by day;
+select hll_cardinality(hll_union_agg(sketch)) between 2850 and 3150
+  from hll_daily;
+select (select hll_cardinality(hll_union_agg(sketch)) from hll_daily) =
+       (select approx_count_distinct(g % 3000) from generate_series(1, 30000) g);
+select hll_cardinality(hll_union(a.sketch, b.sketch)) =
+       (select approx_count_distinct(g % 3000) from generate_series(1, 30000) g
+        where g % 7 in (0, 1))
+  from hll_daily a, hll_daily b where a.day = 0 and b.day = 1;
+drop table hll_daily;
+-- errors
+select approx_count_distinct(g, 3) from generate_series(1, 10) g;
+select approx_count_distinct(point(g, g)) from generate_series(1, 10) g;
+select hll_union(hll_sketch_agg(g, 10), hll_sketch_agg(g))
+  from generate_series(1, 10) g;
+select hll_cardinality('\x0102'::bytea);
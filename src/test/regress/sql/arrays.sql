@@ -609,3 +609,13 @@ SELECT width_bucket(5, '{}');
 SELECT width_bucket('5'::text, ARRAY[3, 4]::integer[]);
 SELECT width_bucket(5, ARRAY[3, 4, NULL]);
 SELECT width_bucket(5, ARRAY[ARRAY[1, 2], ARRAY[3, 4]]);
+
+-- IN, NOT IN and = ANY over constant arrays long enough to use hashing
+SELECT x, x IN (1, 2, 3, 4, 5, 6, 7, 8, 9, 10) AS in_list,
+       x NOT IN (1, 2, 3, 4, 5, 6, 7, 8, 9, 10) AS not_in_list
+FROM (VALUES (0), (5), (10), (NULL::int)) v(x);
+SELECT x, x IN (1, 2, 3, 4, 5, 6, 7, 8, 9, NULL) AS in_list,
+       x NOT IN (1, 2, 3, 4, 5, 6, 7, 8, 9, NULL) AS not_in_list
+FROM (VALUES (0), (5)) v(x);
+SELECT s, s = ANY ('{a,b,c,d,e,f,g,h,i,j}'::text[]) AS found
+FROM (VALUES ('c'), ('z')) v(s);
@@ -201,6 +201,25 @@ SELECT '' AS "Not True", f1
    FROM BOOLTBL2
    WHERE f1 IS NOT TRUE;
 
+--
+-- Three-valued logic in per-row quals and targetlists
+--
+
+CREATE TEMP TABLE BOOLTBL5 (a bool, b bool);
+
+INSERT INTO BOOLTBL5 VALUES (true, true), (true, false), (true, null),
+   (false, false), (false, null), (null, null);
+
+SELECT a, b, a AND b AS "and", a OR b AS "or", NOT a AS "not",
+   (a AND b) IS NULL AS and_null
+   FROM BOOLTBL5
+   ORDER BY 1, 2;
+
+SELECT a, b
+   FROM BOOLTBL5
+   WHERE a OR b IS NULL
+   ORDER BY 1, 2;
+
 --
 -- Clean up
 -- Many tables are retained by the regression test, but these do not seem
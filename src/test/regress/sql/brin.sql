@@ -421,3 +421,36 @@ UPDATE brintest SET textcol = '' WHERE textcol IS NOT NULL;
 SELECT brin_summarize_new_values('brintest'); -- error, not an index
 SELECT brin_summarize_new_values('tenk1_unique1'); -- error, not a BRIN index
 SELECT brin_summarize_new_values('brinidx'); -- ok, no change expected
+
+-- Tests for brin_summarize_range
+CREATE TABLE brin_summarize (value int) WITH (fillfactor=10, autovacuum_enabled=false);
+CREATE INDEX brin_summarize_idx ON brin_summarize USING brin (value) WITH (pages_per_range=2);
+INSERT INTO brin_summarize SELECT generate_series(1, 1000);
+SELECT brin_summarize_range('brin_summarize_idx', 0);
+SELECT brin_summarize_range('brin_summarize_idx', 1); -- already summarized
+SELECT brin_summarize_range('brin_summarize_idx', 100000); -- past the end
+SELECT brin_summarize_range('brin_summarize_idx', -1); -- error
+SELECT brin_summarize_range('brin_summarize_idx', 4294967296); -- error
+ALTER INDEX brin_summarize_idx SET (autosummarize = on);
+ALTER INDEX brin_summarize_idx SET (autosummarize = off);
+
+-- Tests for the bloom and multi-minmax opclasses
+CREATE TABLE brin_opclasses (i int4, t text, ts timestamp);
+INSERT INTO brin_opclasses SELECT g, 'v' || (g % 100),
+	timestamp '2016-01-01' + g * interval '1 minute'
+FROM generate_series(1, 2000) g;
+INSERT INTO brin_opclasses VALUES (-1, 'outlier', timestamp '2000-01-01');
+CREATE INDEX brin_opclasses_idx ON brin_opclasses USING brin
+	(i int4_bloom_ops, t text_bloom_ops, ts timestamp_minmax_multi_ops)
+	WITH (pages_per_range = 1);
+SET enable_seqscan = off;
+SELECT count(*) FROM brin_opclasses WHERE i = 42;
+SELECT count(*) FROM brin_opclasses WHERE t = 'v7';
+SELECT count(*) FROM brin_opclasses WHERE t = 'nope';
+SELECT count(*) FROM brin_opclasses WHERE ts = timestamp '2016-01-01 00:42';
+SELECT count(*) FROM brin_opclasses WHERE ts < timestamp '2016-01-01';
+SELECT count(*) FROM brin_opclasses
+	WHERE ts BETWEEN timestamp '2016-01-02' AND timestamp '2016-01-02 00:59';
+SELECT count(*) FROM brin_opclasses WHERE i = -1 AND ts = timestamp '2000-01-01';
+RESET enable_seqscan;
+DROP TABLE brin_summarize, brin_opclasses;
@@ -92,3 +92,217 @@ vacuum btree_tall_tbl;
 -- need to insert some rows to cause the fast root page to split.
 insert into btree_tall_tbl (id, t)
   select g, repeat('x', 100) from generate_series(1, 500) g;
+
+--
+-- Test skip scans, for quals on the second index column only
+--
+create table btree_skip_tbl (a int, b int);
+insert into btree_skip_tbl select i % 4, i from generate_series(1, 2000) i;
+insert into btree_skip_tbl values (null, 42), (null, 43);
+create index btree_skip_idx on btree_skip_tbl (a, b);
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select * from btree_skip_tbl where b = 42 order by a, b;
+select * from btree_skip_tbl where b between 41 and 44 order by a desc, b desc;
+select count(*) from btree_skip_tbl where b < 100;
+select a, count(*) from btree_skip_tbl where b in (7, 8, 2000) group by a order by a;
+
+-- change scan direction in the middle of a skip scan
+begin;
+declare c scroll cursor for
+  select * from btree_skip_tbl where b between 41 and 44 order by a, b;
+fetch 3 from c;
+fetch backward 2 from c;
+fetch 3 from c;
+fetch all from c;
+commit;
+
+-- many distinct values in the first column make the scan stop skipping
+create table btree_noskip_tbl (a int, b int);
+insert into btree_noskip_tbl select i, i % 10 from generate_series(1, 2000) i;
+create index btree_noskip_idx on btree_noskip_tbl (a, b);
+select count(*) from btree_noskip_tbl where b = 3;
+select * from btree_noskip_tbl where b = 3 order by a desc limit 3;
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+drop table btree_skip_tbl;
+drop table btree_noskip_tbl;
+
+-- parallel index builds
+create table btree_par_tbl (a int, b text) with (parallel_workers = 2);
+insert into btree_par_tbl
+  select (i * 7919) % 10007, 'x' || i from generate_series(1, 10000) i;
+delete from btree_par_tbl where a % 10 = 0;
+set max_parallel_maintenance_workers = 2;
+create unique index btree_par_uniq on btree_par_tbl (a);
+create index btree_par_idx on btree_par_tbl (b, a);
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*) from btree_par_tbl where a >= 0;
+select count(*) from
+  (select a, lag(a) over () as prev from btree_par_tbl where a >= 0) s
+  where prev >= a;
+select * from btree_par_tbl where b > 'x9995' order by b, a;
+insert into btree_par_tbl values (7919, 'dup');
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+reset max_parallel_maintenance_workers;
+drop table btree_par_tbl;
+
+-- equal keys are merged into posting lists, by builds and by insertions
+create table btree_dedup_tbl (a int, b text, c int);
+insert into btree_dedup_tbl
+  select i % 10, 'v' || (i % 3), i from generate_series(1, 5000) i;
+create index btree_dedup_idx on btree_dedup_tbl (a);
+create index btree_dedup_b_idx on btree_dedup_tbl (b);
+create unique index btree_dedup_uniq on btree_dedup_tbl (a, c);
+insert into btree_dedup_tbl
+  select i % 10, 'v' || (i % 3), i + 5000 from generate_series(1, 5000) i;
+select pg_relation_size('btree_dedup_idx') * 2 <
+  pg_relation_size('btree_dedup_uniq') as smaller;
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*) from btree_dedup_tbl where a = 3;
+select count(*) from btree_dedup_tbl where b = 'v1';
+select a from btree_dedup_tbl where a < 2 order by a desc limit 3;
+
+-- vacuum removes some or all of the heap TIDs of posting lists
+delete from btree_dedup_tbl where a = 3 and b = 'v1';
+delete from btree_dedup_tbl where a = 5;
+select count(*) from btree_dedup_tbl where a = 5;
+vacuum btree_dedup_tbl;
+select a, count(*) from btree_dedup_tbl where a between 2 and 6
+  group by a order by a;
+select count(*) from btree_dedup_tbl where b = 'v1';
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+drop table btree_dedup_tbl;
+
+-- leaf split high keys keep only what tells the two pages apart
+create table btree_trunc_tbl (i int, a int, b text collate "C", u text collate "C");
+insert into btree_trunc_tbl
+  select i, i % 100, repeat('x', 200) || i,
+    'http://www.example.com/' || repeat('dir/', 20) || lpad(i::text, 5, '0')
+  from generate_series(1, 3000) i;
+create index btree_trunc_ab on btree_trunc_tbl (a, b);
+create index btree_trunc_u on btree_trunc_tbl (u);
+create index btree_trunc_udesc on btree_trunc_tbl (u desc);
+insert into btree_trunc_tbl
+  select i, i % 100, repeat('x', 200) || i,
+    'http://www.example.com/' || repeat('dir/', 20) || lpad(i::text, 5, '0')
+  from generate_series(3001, 6000) i;
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*) from btree_trunc_tbl where a = 42;
+select count(*) from btree_trunc_tbl where a = 42 and b > repeat('x', 200) || '5';
+select a, right(b, 4) from btree_trunc_tbl where a = 99
+  order by a desc, b desc limit 2;
+select count(*) from btree_trunc_tbl
+  where u = 'http://www.example.com/' || repeat('dir/', 20) || '04321';
+select count(*) from btree_trunc_tbl
+  where u >= 'http://www.example.com/' || repeat('dir/', 20) || '00100'
+    and u < 'http://www.example.com/' || repeat('dir/', 20) || '00200';
+select right(u, 5) from btree_trunc_tbl order by u desc limit 2;
+select right(u, 5) from btree_trunc_tbl order by u limit 2;
+
+-- deleting the pages between truncated high keys
+delete from btree_trunc_tbl where a between 10 and 59;
+delete from btree_trunc_tbl where i between 2000 and 3999;
+vacuum btree_trunc_tbl;
+select count(*) from btree_trunc_tbl where a = 42;
+select count(*) from btree_trunc_tbl where a = 60;
+select count(*) from btree_trunc_tbl where a < 10;
+select count(*) from btree_trunc_tbl where a >= 55 and a < 65;
+select count(*) from btree_trunc_tbl
+  where u >= 'http://www.example.com/' || repeat('dir/', 20) || '01950'
+    and u < 'http://www.example.com/' || repeat('dir/', 20) || '02050';
+insert into btree_trunc_tbl
+  select i, i % 100, repeat('x', 200) || i,
+    'http://www.example.com/' || repeat('dir/', 20) || lpad(i::text, 5, '0')
+  from generate_series(2000, 2999) i;
+select count(*) from btree_trunc_tbl where a = 42;
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+drop table btree_trunc_tbl;
+
+-- inserts at the right end of the index go straight to the rightmost leaf
+create table btree_fastpath_tbl (a int, b text);
+create index btree_fastpath_idx on btree_fastpath_tbl (b, a);
+create unique index btree_fastpath_uniq on btree_fastpath_tbl (a);
+insert into btree_fastpath_tbl
+  select i, repeat('x', 480) from generate_series(1, 3000) i;
+insert into btree_fastpath_tbl values (3000, 'x');
+insert into btree_fastpath_tbl values (0, repeat('x', 480)), (3001, repeat('x', 480));
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*), min(a), max(a) from btree_fastpath_tbl
+  where b = repeat('x', 480);
+
+-- the remembered leaf page may have lost its items in the meantime
+delete from btree_fastpath_tbl where a > 2000;
+vacuum btree_fastpath_tbl;
+insert into btree_fastpath_tbl
+  select i, repeat('x', 480) from generate_series(2501, 2600) i;
+select count(*), min(a), max(a) from btree_fastpath_tbl
+  where b = repeat('x', 480);
+select a from btree_fastpath_tbl where b = repeat('x', 480)
+  order by b desc, a desc limit 3;
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+drop table btree_fastpath_tbl;
+
+-- parallel concurrent index builds, which also validate the index in parallel
+create table btree_parcic_tbl (a int, b text) with (parallel_workers = 2);
+insert into btree_parcic_tbl
+  select (i * 7919) % 10007, 'x' || i from generate_series(1, 10000) i;
+delete from btree_parcic_tbl where a % 10 = 0;
+set max_parallel_maintenance_workers = 2;
+create unique index concurrently btree_parcic_uniq on btree_parcic_tbl (a);
+create index concurrently btree_parcic_idx on btree_parcic_tbl (b, a);
+select indexrelid::regclass, indisvalid, indisready from pg_index
+  where indrelid = 'btree_parcic_tbl'::regclass order by 1;
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*) from btree_parcic_tbl where a >= 0;
+select * from btree_parcic_tbl where b > 'x9995' order by b, a;
+insert into btree_parcic_tbl values (7919, 'dup');
+
+reset enable_seqscan;
+reset enable_bitmapscan;
+reset max_parallel_maintenance_workers;
+drop table btree_parcic_tbl;
+
+-- multi-row inserts add each index's entries in key order
+create table btree_sorted_tbl (a int, b text);
+create index btree_sorted_idx on btree_sorted_tbl (b, a desc);
+create unique index btree_sorted_uniq on btree_sorted_tbl (a);
+create index btree_sorted_part on btree_sorted_tbl (a) where a % 2 = 0;
+insert into btree_sorted_tbl
+  select (i * 7919) % 3000, repeat('x', 480) from generate_series(1, 3000) i;
+insert into btree_sorted_tbl
+  select (i * 7919) % 3000 + 3000, repeat('x', 480) from generate_series(1, 3000) i;
+-- duplicates within a batch, and of an existing key
+insert into btree_sorted_tbl select i % 2 + 10000, 'y' from generate_series(1, 3) i;
+insert into btree_sorted_tbl values (6000, 'y'), (5, 'y');
+
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*), min(a), max(a) from btree_sorted_tbl
+  where b = repeat('x', 480);
+select a from btree_sorted_tbl where b = repeat('x', 480)
+  order by b, a desc limit 3;
+select count(*) from btree_sorted_tbl where a % 2 = 0 and a < 100;
+reset enable_seqscan;
+reset enable_bitmapscan;
+drop table btree_sorted_tbl;
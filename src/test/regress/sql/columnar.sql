@@ -0,0 +1,67 @@
+--
+-- Tests for the columnar table access method
+--
+CREATE TABLE columnar_test (a int, b text, c float8) USING columnar;
+SELECT relam::regproc FROM pg_class WHERE relname = 'columnar_test';
+
+-- three chunk groups
+INSERT INTO columnar_test
+  SELECT i, 'row ' || (i % 10), i / 2.0 FROM generate_series(1, 25000) i;
+SELECT count(*), count(b), sum(a), max(c) FROM columnar_test;
+SELECT a, b, c FROM columnar_test WHERE a = 12345;
+
+-- scan keys only skip chunk groups; the quals are still checked
+SELECT count(*) FROM columnar_test WHERE a < 10;
+SELECT count(*) FROM columnar_test WHERE a <= 10;
+SELECT count(*) FROM columnar_test WHERE 10 > a;
+SELECT count(*) FROM columnar_test WHERE a >= 24995;
+SELECT count(*) FROM columnar_test WHERE a > 24990;
+SELECT count(*) FROM columnar_test WHERE a = 30000;
+SELECT count(*) FROM columnar_test WHERE b = 'row 3';
+
+INSERT INTO columnar_test VALUES (NULL, NULL, NULL);
+SELECT count(*), count(a) FROM columnar_test;
+SELECT count(*) FROM columnar_test WHERE a IS NULL;
+
+-- fetching rows by TID
+SELECT a FROM columnar_test
+  WHERE ctid = (SELECT ctid FROM columnar_test WHERE a = 100);
+
+-- rows of aborted transactions and subtransactions are invisible
+BEGIN;
+INSERT INTO columnar_test VALUES (99999, 'aborted', 0);
+SELECT count(*) FROM columnar_test WHERE a = 99999;
+ROLLBACK;
+SELECT count(*) FROM columnar_test WHERE a = 99999;
+
+BEGIN;
+INSERT INTO columnar_test VALUES (100001, 'kept', 1);
+SAVEPOINT s1;
+INSERT INTO columnar_test VALUES (100002, 'rolled back', 2);
+ROLLBACK TO SAVEPOINT s1;
+INSERT INTO columnar_test VALUES (100003, 'kept', 3);
+COMMIT;
+SELECT a, b FROM columnar_test WHERE a > 100000 ORDER BY a;
+
+-- columns added later read as NULL in older stripes
+ALTER TABLE columnar_test ADD COLUMN d int;
+INSERT INTO columnar_test VALUES (200000, 'new', 0, 42);
+SELECT a, coalesce(d, -1) AS d FROM columnar_test WHERE a > 100000 ORDER BY a;
+
+COPY columnar_test (a, b) FROM stdin;
+300000	copied
+300001	copied
+\.
+SELECT a FROM columnar_test WHERE b = 'copied' ORDER BY a;
+
+-- rows can't be modified
+UPDATE columnar_test SET b = 'updated' WHERE a = 1;
+DELETE FROM columnar_test WHERE a = 1;
+SELECT a FROM columnar_test WHERE a = 1 FOR UPDATE;
+CREATE INDEX ON columnar_test (a);
+
+VACUUM columnar_test;
+ANALYZE columnar_test;
+SELECT reltuples FROM pg_class WHERE relname = 'columnar_test';
+
+DROP TABLE columnar_test;
@@ -0,0 +1,39 @@
+--
+-- Page compression
+--
+CREATE TABLE compress_tbl (a int, b text) WITH (compression = on);
+CREATE INDEX compress_tbl_a ON compress_tbl (a) WITH (compression = on);
+
+INSERT INTO compress_tbl SELECT g, repeat('x', g % 200) FROM generate_series(1, 10000) g;
+SELECT count(*), sum(length(b)) FROM compress_tbl;
+
+-- pages that grow need new space
+UPDATE compress_tbl SET b = md5(b) || b WHERE a % 3 = 0;
+DELETE FROM compress_tbl WHERE a % 5 = 0;
+VACUUM compress_tbl;
+SELECT count(*), sum(length(b)) FROM compress_tbl;
+
+SET enable_seqscan = off;
+SELECT a, length(b) FROM compress_tbl WHERE a BETWEEN 4997 AND 5003 ORDER BY a;
+RESET enable_seqscan;
+
+-- rewriting keeps the storage compressed
+VACUUM FULL compress_tbl;
+REINDEX TABLE compress_tbl;
+SELECT count(*), sum(length(b)) FROM compress_tbl;
+
+TRUNCATE compress_tbl;
+SELECT count(*) FROM compress_tbl;
+INSERT INTO compress_tbl SELECT g, 'y' FROM generate_series(1, 1000) g;
+SELECT count(*) FROM compress_tbl;
+
+-- the setting only applies to new storage
+ALTER TABLE compress_tbl SET (compression = off);
+SELECT reloptions FROM pg_class WHERE relname = 'compress_tbl';
+SELECT count(*) FROM compress_tbl WHERE a > 500;
+
+-- only tables and btree indexes can be compressed
+CREATE INDEX compress_tbl_brin ON compress_tbl USING brin (a) WITH (compression = on);
+CREATE VIEW compress_view WITH (compression = on) AS SELECT 1;
+
+DROP TABLE compress_tbl;
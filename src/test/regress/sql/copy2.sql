@@ -327,6 +327,40 @@ copy check_con_tbl from stdin;
 \.
 select * from check_con_tbl;
 
+-- parallel COPY FROM
+CREATE TABLE parcopy (a int PRIMARY KEY, b text, c text DEFAULT 'dflt');
+SET max_parallel_maintenance_workers = 2;
+COPY parcopy (a, b) FROM stdin WITH (parallel 2);
+1	one
+2	two
+3	\N
+\.
+COPY parcopy (a, b) FROM stdin WITH (format csv, header, parallel 2);
+a,b
+4,"four, quoted"
+5,""
+\.
+SELECT * FROM parcopy ORDER BY a;
+\set VERBOSITY terse
+COPY parcopy (a, b) FROM stdin WITH (parallel 2);
+6	six
+1	dup
+\.
+\set VERBOSITY default
+SELECT count(*) FROM parcopy;
+DROP TABLE parcopy;
+
+-- parallel COPY TO; a single page all goes to one worker, so the order holds
+CREATE TABLE parcopyto (a int, b text);
+INSERT INTO parcopyto VALUES (1, 'one'), (2, NULL), (3, 'three, quoted');
+COPY parcopyto TO stdout WITH (format csv, header, force_quote (b), parallel 2);
+COPY parcopyto (b) TO stdout WITH (parallel 2, oids false);
+COPY (SELECT a FROM parcopyto WHERE a > 1) TO stdout WITH (parallel 2);
+RESET max_parallel_maintenance_workers;
+COPY parcopyto TO stdout WITH (compression 'lz4');
+COPY parcopyto TO stdout WITH (compression 'none');
+DROP TABLE parcopyto;
+
 DROP TABLE forcetest;
 DROP TABLE vistest;
 DROP FUNCTION truncate_in_subxact();
@@ -144,3 +144,24 @@ CREATE AGGREGATE wrongreturntype (float8)
     msfunc = float8pl,
     minvfunc = float8mi_int
 );
+
+-- combine functions
+
+CREATE AGGREGATE sumdouble_combine (float8)
+(
+    stype = float8,
+    sfunc = float8pl,
+    combinefunc = float8pl
+);
+
+-- invalid: combine function returning the wrong type
+
+CREATE AGGREGATE wrongcombinetype (float8)
+(
+    stype = float8,
+    sfunc = float8pl,
+    combinefunc = float8mi_int
+);
+
+SELECT aggcombinefn FROM pg_aggregate
+WHERE aggfnoid = 'sumdouble_combine'::regproc;
@@ -265,3 +265,12 @@ CREATE TABLE as_select1 AS SELECT * FROM pg_class WHERE relkind = 'r';
 CREATE TABLE as_select1 AS SELECT * FROM pg_class WHERE relkind = 'r';
 CREATE TABLE IF NOT EXISTS as_select1 AS SELECT * FROM pg_class WHERE relkind = 'r';
 DROP TABLE as_select1;
+
+-- table access methods
+CREATE TABLE tableam_heap (a int) USING heap;
+SELECT relam FROM pg_class WHERE relname = 'tableam_heap';
+INSERT INTO tableam_heap VALUES (1), (2);
+SELECT * FROM tableam_heap;
+CREATE TABLE tableam_bad (a int) USING no_such_method;	-- fail
+CREATE TABLE tableam_bad (a int) USING system;			-- fail, not a table AM
+DROP TABLE tableam_heap;
@@ -287,3 +287,8 @@ select make_date(2013, 11, -1);
 select make_date(-44, 3, 15);  -- perhaps we should allow this sometime?
 select make_time(10, 55, 100.1);
 select make_time(24, 0, 2.1);
+
+-- plain ISO 8601 input is parsed by a fast path; check it agrees with
+-- the general parser, including on values it leaves to the latter
+SELECT x::date FROM (VALUES ('2016-02-29'), ('2016-02-29 23:59:59+05'), ('2016-02-29T10:00')) AS t(x);
+SELECT '2016-02-30'::date;
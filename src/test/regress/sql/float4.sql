@@ -81,3 +81,12 @@ UPDATE FLOAT4_TBL
    WHERE FLOAT4_TBL.f1 > '0.0';
 
 SELECT '' AS five, * FROM FLOAT4_TBL;
+
+-- shortest-precise output, and its round trip through text
+SET extra_float_digits = 3;
+SELECT x, x::text::float4 = x AS roundtrip
+  FROM (VALUES ('0.1'::float4), ('1e23'), ('3.4e38'), ('1.2e-38'), ('-0.0'), ('1234567'), ('4.35'), ('100')) AS t(x);
+
+SELECT '1'::float4 / '3' AS third, '0.1'::float4 + '0.2' AS sum;
+
+RESET extra_float_digits;
@@ -167,3 +167,12 @@ INSERT INTO FLOAT8_TBL(f1) VALUES ('-1.2345678901234e+200');
 INSERT INTO FLOAT8_TBL(f1) VALUES ('-1.2345678901234e-200');
 
 SELECT '' AS five, * FROM FLOAT8_TBL;
+
+-- shortest-precise output, and its round trip through text
+SET extra_float_digits = 3;
+SELECT x, x::text::float8 = x AS roundtrip
+  FROM (VALUES ('0.1'::float8), ('1e23'), ('1.7976931348623157e308'), ('-0.0'), ('123456789012345678'), ('4.35'), ('1e-5'), ('1e15'), ('100')) AS t(x);
+
+SELECT '1'::float8 / '3' AS third, '0.1'::float8 + '0.2' AS sum;
+
+RESET extra_float_digits;
@@ -1009,3 +1009,18 @@ update pp set f1=f1+1;
 insert into cc values(13);
 update pp set f1=f1+1; -- fail
 drop table pp, cc;
+
+--
+-- Foreign key checks of many rows are done in batches; the first violating
+-- row is still the one reported
+--
+create temp table pp (f1 int, f2 text, primary key (f1, f2));
+create temp table cc (f1 int, f2 text,
+                      constraint cc_fk foreign key (f1, f2) references pp);
+insert into pp select i, 'x' || i from generate_series(1, 3000) i;
+insert into cc select i, 'x' || i from generate_series(1, 3000) i;
+insert into cc select i, 'x' || i from generate_series(2990, 3010) i; -- fail
+insert into cc values (5, 'x5'), (7, 'x8'), (3001, 'x1'); -- fail
+update cc set f1 = f1 + 1 where f1 > 2990; -- fail
+select count(*) from cc;
+drop table pp, cc;
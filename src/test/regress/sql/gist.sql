@@ -24,6 +24,25 @@ delete from gist_point_tbl where id < 10000;
 
 vacuum analyze gist_point_tbl;
 
+-- Build indexes on the populated table, by sorting (the default for point
+-- opclass) and with buffering forced, and check that both find the points.
+drop index gist_pointidx;
+
+set enable_seqscan=off;
+
+create index gist_pointidx2 on gist_point_tbl using gist(p);
+select count(*) from gist_point_tbl;
+select count(*) from gist_point_tbl where p <@ box(point(0,0), point(1000, 1000));
+select count(*) from gist_point_tbl where p <@ box(point(0,0), point(200000, 200000));
+drop index gist_pointidx2;
+
+create index gist_pointidx3 on gist_point_tbl using gist(p) with (buffering = on);
+select count(*) from gist_point_tbl where p <@ box(point(0,0), point(1000, 1000));
+select count(*) from gist_point_tbl where p <@ box(point(0,0), point(200000, 200000));
+drop index gist_pointidx3;
+
+reset enable_seqscan;
+
 
 --
 -- Test Index-only plans on GiST indexes
@@ -41,6 +41,10 @@ create function gstest_data(v integer, out a integer, out b integer)
     end;
   $f$ language plpgsql;
 
+-- the tests below exercise sort-based grouping sets; hashed grouping sets
+-- are tested near the end
+set enable_hashagg = false;
+
 -- basic functionality
 
 -- simple rollup with multiple plain aggregates, with and without ordering
@@ -224,4 +228,14 @@ select array(select row(v.a,s1.*) from (select two,four, count(*) from onek grou
 select sum(ten) from onek group by two, rollup(four::text) order by 1;
 select sum(ten) from onek group by rollup(four::text), two order by 1;
 
+-- Hashed grouping sets; with sorting disabled, every set gets a hash table
+reset enable_hashagg;
+set enable_sort = false;
+explain (costs off)
+  select two, four, count(*) from onek group by rollup(two, four) order by two, four;
+select two, four, grouping(two, four), count(*), sum(ten)
+  from onek group by cube(two, four) order by two, four;
+select a, b, sum(v), count(*) from gstest_empty group by grouping sets ((a,b),());
+reset enable_sort;
+
 -- end
@@ -151,3 +151,38 @@ SELECT h.seqno AS f20000
 
 -- SELECT count(*) AS i988 FROM hash_ovfl_heap
 --  WHERE x = 1000;
+
+--
+-- grow the index through bucket splits and overflow pages, then shrink it
+-- with VACUUM, which also squeezes the buckets and removes the tuples the
+-- splits left behind
+--
+CREATE TABLE hash_split_heap (keycol INT);
+INSERT INTO hash_split_heap SELECT 1 FROM generate_series(1, 500) a;
+CREATE INDEX hash_split_index on hash_split_heap USING HASH (keycol);
+INSERT INTO hash_split_heap SELECT a/2 FROM generate_series(1, 50000) a;
+
+SET enable_seqscan = OFF;
+SET enable_bitmapscan = OFF;
+
+SELECT count(*) FROM hash_split_heap WHERE keycol = 1;
+SELECT count(*) FROM hash_split_heap WHERE keycol = 12345;
+
+DELETE FROM hash_split_heap WHERE keycol % 3 = 0;
+VACUUM hash_split_heap;
+
+SELECT count(*) FROM hash_split_heap WHERE keycol = 1;
+SELECT count(*) FROM hash_split_heap WHERE keycol = 12345;
+SELECT count(*) FROM hash_split_heap WHERE keycol = 12346;
+
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+
+DROP TABLE hash_split_heap;
+
+-- hash indexes on unlogged tables get an init fork
+CREATE UNLOGGED TABLE hash_unlogged_heap (keycol INT);
+CREATE INDEX hash_unlogged_index on hash_unlogged_heap USING HASH (keycol);
+INSERT INTO hash_unlogged_heap SELECT a FROM generate_series(1, 1000) a;
+SELECT count(*) FROM hash_unlogged_heap WHERE keycol = 500;
+DROP TABLE hash_unlogged_heap;
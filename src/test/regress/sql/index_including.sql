@@ -0,0 +1,64 @@
+--
+-- Test btree indexes with INCLUDE columns
+--
+
+create table tbl_include (c1 int, c2 int, c3 int, c4 text);
+insert into tbl_include
+  select x, 2 * x, 3 * x, 'row ' || x from generate_series(1, 1000) x;
+create unique index tbl_include_unique1 on tbl_include (c1, c2) include (c3, c4);
+create index tbl_include_idx on tbl_include (c1) include (c4);
+select pg_get_indexdef('tbl_include_unique1'::regclass);
+select pg_get_indexdef('tbl_include_idx'::regclass);
+select indnatts, indnkeyatts from pg_index
+  where indexrelid = 'tbl_include_unique1'::regclass;
+
+-- uniqueness is enforced on the key columns only
+insert into tbl_include values (1, 2, 0, 'dup');
+insert into tbl_include values (1, 3, 3, 'not a dup');
+
+-- included columns can be returned by an index-only scan
+vacuum analyze tbl_include;
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+explain (costs off)
+select c1, c2, c3 from tbl_include where c1 between 10 and 12;
+select c1, c2, c3 from tbl_include where c1 between 10 and 12 order by c1, c2;
+select c1, c4 from tbl_include where c1 = 1 order by c4;
+reset enable_seqscan;
+reset enable_bitmapscan;
+
+-- included columns are plain columns, without any options
+create index on tbl_include (c1) include ((c2 + 1));
+create index on tbl_include (c1) include (c2 desc);
+create index on tbl_include (c1) include (c2 nulls first);
+create index on tbl_include (c1) include (c4 collate "C");
+create index on tbl_include (c1) include (c2 int4_ops);
+create index on tbl_include using gist (c1) include (c2);
+
+-- changing the type of an included column rebuilds the index
+alter table tbl_include alter column c3 type bigint;
+select pg_get_indexdef('tbl_include_unique1'::regclass);
+
+-- included columns are copied along with the indexes
+create table tbl_include_copy (like tbl_include including indexes);
+select pg_get_indexdef(indexrelid) from pg_index
+  where indrelid = 'tbl_include_copy'::regclass order by 1;
+drop table tbl_include_copy;
+drop table tbl_include;
+
+-- many duplicates of each key, told apart by an included column
+create table tbl_include_dup (a int, b text);
+create index tbl_include_dup_idx on tbl_include_dup (a) include (b);
+insert into tbl_include_dup
+  select i % 10, 'value ' || i from generate_series(1, 10000) i;
+vacuum tbl_include_dup;
+set enable_seqscan to false;
+set enable_bitmapscan to false;
+select count(*), count(distinct b) from tbl_include_dup where a = 3;
+delete from tbl_include_dup where a = 3 and b > 'value 5';
+vacuum tbl_include_dup;
+select count(*) from tbl_include_dup where a = 3;
+select count(*) from tbl_include_dup where a >= 3 and a < 5;
+reset enable_seqscan;
+reset enable_bitmapscan;
+drop table tbl_include_dup;
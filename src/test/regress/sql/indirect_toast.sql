@@ -59,3 +59,18 @@ SELECT substring(toasttest::text, 1, 200) FROM toasttest;
 
 DROP TABLE toasttest;
 DROP FUNCTION update_using_indirect();
+
+-- values read repeatedly come from the detoast cache; make sure the cache
+-- doesn't outlive a TRUNCATE of the table
+CREATE TABLE detoasttest(f1 text);
+ALTER TABLE detoasttest ALTER COLUMN f1 SET STORAGE EXTERNAL;
+BEGIN;
+INSERT INTO detoasttest VALUES (repeat('x', 10000));
+SELECT f1 = repeat('x', 10000) AS is_x, f1 || '' = repeat('x', 10000) AS again
+FROM detoasttest;
+TRUNCATE detoasttest;
+INSERT INTO detoasttest VALUES (repeat('y', 10000));
+SELECT f1 = repeat('y', 10000) AS is_y FROM detoasttest;
+COMMIT;
+SELECT f1 = repeat('y', 10000) AS is_y FROM detoasttest;
+DROP TABLE detoasttest;
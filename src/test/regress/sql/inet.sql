@@ -123,3 +123,20 @@ INSERT INTO INET_TBL (c, i) VALUES ('10', '10::/8');
 SELECT inet_merge(c, i) FROM INET_TBL;
 -- fix it by inet_same_family() condition
 SELECT inet_merge(c, i) FROM INET_TBL WHERE inet_same_family(c, i);
+
+-- sorts with abbreviated keys must agree with the comparison operators
+CREATE TEMP TABLE inet_sort AS
+  SELECT ((i * 7919 % 256) || '.' || (i * 31 % 256) || '.' || (i % 7) || '.' ||
+          (i % 256) || '/' || (i % 33))::inet AS a
+  FROM generate_series(1, 10000) i
+  UNION ALL
+  SELECT (to_hex(i * 13 % 65536) || ':' || to_hex(i % 3) || '::' || to_hex(i) ||
+          '/' || (i % 129))::inet
+  FROM generate_series(1, 10000) i;
+SELECT count(*) FROM
+  (SELECT a, lag(a) OVER (ORDER BY a) AS prev FROM inet_sort) s
+  WHERE prev > a;
+SELECT count(*) FROM
+  (SELECT a, lag(a) OVER (ORDER BY a DESC) AS prev FROM inet_sort) s
+  WHERE prev < a;
+DROP TABLE inet_sort;
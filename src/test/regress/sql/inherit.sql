@@ -494,3 +494,56 @@ FROM generate_series(1, 3) g(i);
 reset enable_seqscan;
 reset enable_indexscan;
 reset enable_bitmapscan;
+
+--
+-- Check run-time pruning of children using parameter values
+--
+create table rtp (a int, b text);
+create table rtp1 (check (a < 10)) inherits (rtp);
+create table rtp2 (check (a >= 10 and a < 20)) inherits (rtp);
+create table rtp3 (check (a >= 20)) inherits (rtp);
+insert into rtp1 values (1, 'one'), (5, 'five');
+insert into rtp2 values (10, 'ten'), (15, 'fifteen');
+insert into rtp3 values (20, 'twenty'), (25, 'twenty-five');
+
+-- queries in a multi-statement SQL function get generic plans
+create function rtp_count(int, int) returns bigint as
+$$ select 1; select count(*) from rtp where a >= $1 and a < $2 $$ language sql;
+select rtp_count(0, 5), rtp_count(5, 20), rtp_count(12, 100),
+       rtp_count(30, 40), rtp_count(12, 5);
+
+-- PARAM_EXEC values are checked again on each rescan
+select x, (select string_agg(b, ',' order by a) from rtp
+           where a between x and x + 5)
+from (values (0), (5), (12), (30)) v(x);
+
+drop function rtp_count(int, int);
+drop table rtp cascade;
+
+--
+-- Check inheritance-wise joins
+--
+create table iwj_a (a int, x text);
+create table iwj_a1 (check (a < 10)) inherits (iwj_a);
+create table iwj_a2 (check (a >= 10 and a < 20)) inherits (iwj_a);
+create table iwj_a3 (check (a >= 20)) inherits (iwj_a);
+create table iwj_b (b int, y text);
+create table iwj_b1 (check (b < 10)) inherits (iwj_b);
+create table iwj_b2 (check (b >= 10 and b < 20)) inherits (iwj_b);
+create table iwj_b3 (check (b >= 20)) inherits (iwj_b);
+-- the parents have no constraints, so their rows must be joined with all
+insert into iwj_a values (15, 'pa15');
+insert into iwj_a1 values (1, 'a1'), (5, 'a5');
+insert into iwj_a2 values (10, 'a10'), (15, 'a15');
+insert into iwj_a3 values (20, 'a20'), (25, 'a25');
+insert into iwj_b values (5, 'pb5'), (20, 'pb20');
+insert into iwj_b1 values (1, 'b1');
+insert into iwj_b2 values (10, 'b10'), (15, 'b15');
+insert into iwj_b3 values (25, 'b25'), (30, 'b30');
+set enable_partitionwise_join = on;
+select a, x, y from iwj_a join iwj_b on a = b order by a, x, y;
+select a, x, y from iwj_a join iwj_b on a = b where a < 12 order by a, x, y;
+select count(*) from iwj_a t1 join iwj_a t2 on t1.a = t2.a;
+reset enable_partitionwise_join;
+drop table iwj_a cascade;
+drop table iwj_b cascade;
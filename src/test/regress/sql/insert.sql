@@ -36,3 +36,29 @@ insert into inserttest values(30, 50, repeat('x', 10000));
 select col1, col2, char_length(col3) from inserttest;
 
 drop table inserttest;
+
+--
+-- INSERT ... SELECT writing its rows in batches
+--
+create table insertbatch (a int primary key, b text);
+create table insertbatch_log (a int);
+create function insertbatch_log() returns trigger language plpgsql as
+$$ begin insert into insertbatch_log values (new.a); return null; end $$;
+create trigger insertbatch_after after insert on insertbatch
+    for each row execute procedure insertbatch_log();
+
+insert into insertbatch select i, repeat('x', i % 100) from generate_series(1, 2500) i;
+
+select count(*), sum(a), sum(length(b)) from insertbatch;
+select count(*), sum(a) from insertbatch_log;
+
+set enable_seqscan = off;
+select a, length(b) from insertbatch where a in (1, 1000, 1001, 2500) order by a;
+reset enable_seqscan;
+
+-- unique violations are still detected, also within one batch
+insert into insertbatch select 3000 from generate_series(1, 2);
+select count(*) from insertbatch where a = 3000;
+
+drop table insertbatch, insertbatch_log;
+drop function insertbatch_log();
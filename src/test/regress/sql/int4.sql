@@ -145,3 +145,10 @@ FROM (VALUES (-2.5::float8),
              (0.5::float8),
              (1.5::float8),
              (2.5::float8)) t(x);
+
+-- per-row arithmetic and comparisons, including overflow
+SELECT f1, f1 - 1 AS minus_one
+FROM INT4_TBL
+WHERE f1 > -2147483647 AND f1 <> 0
+ORDER BY f1;
+SELECT f1 + 1 FROM INT4_TBL WHERE f1 >= 100;
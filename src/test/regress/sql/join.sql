@@ -496,6 +496,53 @@ select count(*) from tenk1 a, tenk1 b
 reset work_mem;
 reset enable_mergejoin;
 
+--
+-- hash join runtime filters, which let the outer scan skip rows that
+-- can't have a match; outer joins must still see every row
+--
+
+set enable_mergejoin to off;
+set enable_nestloop to off;
+
+select count(*), sum(a.unique1) from tenk1 a
+  join (select unique1 from onek where unique1 < 10) b on a.unique2 = b.unique1;
+select count(*), sum(a.unique1) from tenk1 a
+  join (select unique1 from onek where unique1 < 3) b on a.unique2 % 1000 = b.unique1;
+select count(*) from tenk1 a
+  where a.unique2 in (select unique1 from onek where unique1 < 10);
+select count(*) from tenk1 a
+  left join (select unique1 from onek where unique1 < 10) b on a.unique2 = b.unique1;
+-- large enough inner sides are probed through the bucket entry array
+select count(*), sum(b.unique2) from tenk1 a join tenk1 b on a.unique1 = b.unique2;
+select count(*), count(a.unique1) from tenk1 a
+  right join tenk1 b on a.unique1 = b.unique2 + 5000;
+
+reset enable_mergejoin;
+reset enable_nestloop;
+
+--
+-- memoize nodes caching parameterized inner scans; the small work_mem
+-- forces some evictions
+--
+
+set enable_hashjoin to off;
+set enable_mergejoin to off;
+
+select count(*), sum(t1.unique2) from tenk1 t2
+  join tenk1 t1 on t1.unique1 = t2.twenty
+  where t2.unique1 < 1000;
+select count(*), count(t1.unique1), sum(t1.unique2) from tenk1 t2
+  left join tenk1 t1 on t1.unique1 = t2.thousand * 20
+  where t2.unique1 < 2000;
+set work_mem to '64kB';
+select count(*), count(t1.unique1), sum(t1.unique2) from tenk1 t2
+  left join tenk1 t1 on t1.unique1 = t2.thousand * 20
+  where t2.unique1 < 2000;
+
+reset work_mem;
+reset enable_hashjoin;
+reset enable_mergejoin;
+
 --
 -- regression test for 8.2 bug with improper re-ordering of left joins
 --
@@ -1470,6 +1517,37 @@ select atts.relid::regclass, s.* from pg_stats s join
     indexrelid from pg_index i) atts on atts.attnum = a.attnum where
     schemaname != 'pg_catalog';
 
+--
+-- Check the hypergraph and greedy join searches
+--
+
+set hypergraph_join_threshold = 2;
+select count(*) from
+  tenk1 t1 join tenk1 t2 on t2.unique1 = t1.unique2
+  join tenk1 t3 on t3.unique1 = t2.unique2
+  join tenk1 t4 on t4.unique1 = t3.unique2
+  join tenk1 t5 on t5.unique1 = t4.unique2
+  join tenk1 t6 on t6.unique1 = t5.unique2
+where t1.unique1 < 10;
+-- b and c can only be joined by a clauseless join
+select count(*) from
+  int4_tbl a left join (int4_tbl b cross join int4_tbl c) on a.f1 = b.f1;
+reset hypergraph_join_threshold;
+
+set geqo_threshold = 2;
+set join_search_heuristic = greedy;
+select count(*) from
+  tenk1 t1 join tenk1 t2 on t2.unique1 = t1.unique2
+  join tenk1 t3 on t3.unique1 = t2.unique2
+  join tenk1 t4 on t4.unique1 = t3.unique2
+  join tenk1 t5 on t5.unique1 = t4.unique2
+  join tenk1 t6 on t6.unique1 = t5.unique2
+where t1.unique1 < 10;
+select count(*) from
+  int4_tbl a left join (int4_tbl b cross join int4_tbl c) on a.f1 = b.f1;
+reset geqo_threshold;
+reset join_search_heuristic;
+
 --
 -- Test LATERAL
 --
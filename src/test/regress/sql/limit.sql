@@ -39,3 +39,13 @@ SELECT
           (SELECT n FROM generate_series(1,10) AS n
              ORDER BY n LIMIT 1 OFFSET s-1) AS y) AS z
   FROM generate_series(1,10) AS s;
+
+-- Input presorted on a prefix of the ORDER BY keys (may use incremental sort)
+
+SELECT hundred, unique1 FROM tenk1
+		ORDER BY hundred, unique1 DESC LIMIT 4 OFFSET 98;
+
+SELECT
+  (SELECT unique1 FROM tenk1 WHERE hundred < 3
+     ORDER BY hundred, unique1 DESC LIMIT 1 OFFSET s*50) AS z
+  FROM generate_series(0,5) AS s;
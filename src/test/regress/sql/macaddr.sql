@@ -40,4 +40,13 @@ SELECT ~b                       FROM macaddr_data;
 SELECT  b & '00:00:00:ff:ff:ff' FROM macaddr_data;
 SELECT  b | '01:02:03:04:05:06' FROM macaddr_data;
 
+-- sorts with abbreviated keys must agree with the comparison operators
+CREATE TEMP TABLE macaddr_sort AS
+  SELECT substr(md5((i % 3000)::text), 1, 12)::macaddr AS m
+  FROM generate_series(1, 20000) i;
+SELECT count(*) FROM
+  (SELECT m, lag(m) OVER (ORDER BY m) AS prev FROM macaddr_sort) s
+  WHERE prev > m;
+DROP TABLE macaddr_sort;
+
 DROP TABLE macaddr_data;
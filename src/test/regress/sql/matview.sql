@@ -209,3 +209,42 @@ REFRESH MATERIALIZED VIEW mv_foo;
 REFRESH MATERIALIZED VIEW CONCURRENTLY mv_foo;
 DROP OWNED BY user_dw CASCADE;
 DROP ROLE user_dw;
+
+-- incremental maintenance
+CREATE TABLE mvi_a (id int, grp text, val int);
+CREATE TABLE mvi_b (grp text, label text);
+INSERT INTO mvi_a VALUES (1, 'x', 10), (2, 'x', 20), (3, 'y', NULL);
+INSERT INTO mvi_b VALUES ('x', 'ex'), ('y', 'why');
+CREATE MATERIALIZED VIEW mvi_join WITH (incremental_maintenance) AS
+  SELECT a.id, b.label FROM mvi_a a JOIN mvi_b b ON a.grp = b.grp;
+CREATE MATERIALIZED VIEW mvi_agg WITH (incremental_maintenance) AS
+  SELECT grp, sum(val) AS total, count(val) AS nval, count(*) AS n
+  FROM mvi_a GROUP BY grp;
+INSERT INTO mvi_a VALUES (4, 'y', 5), (5, 'z', 1);
+UPDATE mvi_a SET val = val + 1 WHERE id = 1;
+DELETE FROM mvi_a WHERE id = 2;
+INSERT INTO mvi_b VALUES ('z', 'zed');
+DELETE FROM mvi_a WHERE grp = 'y' AND val IS NOT NULL;
+SELECT * FROM mvi_join ORDER BY id;
+SELECT * FROM mvi_agg ORDER BY grp;
+TRUNCATE mvi_b;
+INSERT INTO mvi_b VALUES ('x', 'ex');
+SELECT * FROM mvi_join ORDER BY id;
+-- unsupported queries
+CREATE MATERIALIZED VIEW mvi_bad WITH (incremental_maintenance) AS
+  SELECT grp, sum(val) FROM mvi_a GROUP BY grp;
+CREATE MATERIALIZED VIEW mvi_bad WITH (incremental_maintenance) AS
+  SELECT DISTINCT grp FROM mvi_a;
+CREATE TABLE mvi_bad WITH (incremental_maintenance) AS SELECT 1;
+-- enabling maintenance requires a refresh
+CREATE MATERIALIZED VIEW mvi_later AS SELECT id, val FROM mvi_a WHERE val > 0;
+ALTER MATERIALIZED VIEW mvi_later SET (incremental_maintenance = true);
+SELECT * FROM mvi_later;
+REFRESH MATERIALIZED VIEW mvi_later;
+INSERT INTO mvi_a VALUES (6, 'x', 7);
+SELECT * FROM mvi_later ORDER BY id;
+ALTER MATERIALIZED VIEW mvi_later RESET (incremental_maintenance);
+INSERT INTO mvi_a VALUES (7, 'x', 8);
+SELECT * FROM mvi_later ORDER BY id;
+DROP MATERIALIZED VIEW mvi_join, mvi_agg, mvi_later;
+DROP TABLE mvi_a, mvi_b;
@@ -749,6 +749,19 @@ WHERE a.aggfnoid = p.oid AND
      -- we could carry the check further, but 3 args is enough for now
     );
 
+-- Cross-check combinefn (if present) against its entry in pg_proc.
+-- It must take two arguments of the transition type and return that type.
+
+SELECT a.aggfnoid::oid, p.proname, pcm.oid, pcm.proname
+FROM pg_aggregate AS a, pg_proc AS p, pg_proc AS pcm
+WHERE a.aggfnoid = p.oid AND
+    a.aggcombinefn = pcm.oid AND
+    (pcm.proretset OR
+     pcm.pronargs != 2 OR
+     NOT binary_coercible(pcm.prorettype, a.aggtranstype) OR
+     NOT binary_coercible(a.aggtranstype, pcm.proargtypes[0]) OR
+     NOT binary_coercible(a.aggtranstype, pcm.proargtypes[1]));
+
 -- If transfn is strict then either initval should be non-NULL, or
 -- input type should match transtype so that the first non-null input
 -- can be assigned as the state value.
@@ -1329,7 +1342,8 @@ WHERE p1.amproc = p2.oid AND
 SELECT p1.indexrelid, p1.indrelid
 FROM pg_index as p1
 WHERE p1.indexrelid = 0 OR p1.indrelid = 0 OR
-      p1.indnatts <= 0 OR p1.indnatts > 32;
+      p1.indnatts <= 0 OR p1.indnatts > 32 OR
+      p1.indnkeyatts <= 0 OR p1.indnkeyatts > p1.indnatts;
 
 -- oidvector and int2vector fields should be of length indnatts.
 
@@ -4348,3 +4348,86 @@ exception when others then
   null; -- do nothing
 end;
 $$;
+
+-- jsonb variables are kept in expanded form; check that extraction from
+-- them and in-place jsonb_set() and || give the usual results
+create function jsonb_expanded_test() returns jsonb as $$
+declare
+  d jsonb := '{"a": 1, "b": {"c": [1, 2, 3]}, "s": "x"}';
+  s jsonb := '1';
+begin
+  d := jsonb_set(d, '{b,c,0}', '"first"');
+  d := jsonb_set(d, '{b,c,-1}', '4');
+  d := jsonb_set(d, '{b,c,10}', '5');
+  d := jsonb_set(d, '{b,c,-10}', '0');
+  d := jsonb_set(d, '{b,new}', 'true');
+  d := jsonb_set(d, '{b,missing,x}', 'true');
+  d := jsonb_set(d, '{zz}', '1', false);
+  d := jsonb_set(d, '{a}', '{"nested": null}');
+  d := d || '{"s": "y", "t": [1]}';
+  begin
+    d := jsonb_set(d, '{b,c,x}', '1');
+  exception when others then
+    raise notice '%', sqlerrm;
+  end;
+  raise notice '% % % % %', d->'a', d->>'s', d#>'{b,c}', d#>>'{b,c,1}', d->'t'->-1;
+  s := s || '2';
+  s := s || s;
+  raise notice '% %', s, s->>-1;
+  return d;
+end
+$$ language plpgsql;
+
+select jsonb_expanded_test();
+
+drop function jsonb_expanded_test();
+
+-- Test that simple expressions notice search_path changes and redefinition
+-- of the functions they call
+
+create schema simple_expr_s1;
+create schema simple_expr_s2;
+create function simple_expr_s1.sxf() returns int as 'select 1' language sql;
+create function simple_expr_s2.sxf() returns int as 'select 2' language sql;
+
+create function simple_expr_test() returns int as $$
+declare x int := 0;
+begin
+  for i in 1..3 loop
+    x := x + sxf();
+  end loop;
+  return x;
+end
+$$ language plpgsql;
+
+set search_path = simple_expr_s1, public;
+select simple_expr_test();
+set search_path = simple_expr_s2, public;
+select simple_expr_test();
+create or replace function simple_expr_s2.sxf() returns int as 'select 5' language sql;
+select simple_expr_test();
+reset search_path;
+
+drop function simple_expr_test();
+drop schema simple_expr_s1 cascade;
+drop schema simple_expr_s2 cascade;
+
+-- Test FOR-IN-query loops spanning many fetch batches
+
+create function forq_batch_test() returns text as $$
+declare r record; n int := 0; s bigint := 0;
+begin
+  for r in select i, 'x' || i as t from generate_series(1, 5000) i loop
+    n := n + 1;
+    s := s + r.i;
+    if r.i = 2500 then
+      r := row(0);  -- reassigning the loop variable is harmless
+    end if;
+  end loop;
+  return n || ' ' || s || ' ' || r.t;
+end
+$$ language plpgsql;
+
+select forq_batch_test();
+
+drop function forq_batch_test();
@@ -0,0 +1,55 @@
+--
+-- PUBLICATION
+--
+CREATE ROLE regress_publication_user LOGIN SUPERUSER;
+SET SESSION AUTHORIZATION 'regress_publication_user';
+
+CREATE PUBLICATION testpub_default;
+
+CREATE PUBLICATION testpub_default;
+
+CREATE TABLE testpub_tbl1 (id serial primary key, data text);
+CREATE TABLE testpub_tbl2 (id serial primary key, data text);
+CREATE VIEW testpub_view AS SELECT 1;
+CREATE TEMP TABLE testpub_temptbl (a int);
+
+CREATE PUBLICATION testpub_foralltables FOR ALL TABLES;
+CREATE PUBLICATION testpub_fortbl FOR TABLE testpub_tbl1;
+
+SELECT pubname, puballtables FROM pg_publication ORDER BY pubname;
+
+-- only regular, permanent, user tables can be published
+ALTER PUBLICATION testpub_default ADD TABLE testpub_view;
+ALTER PUBLICATION testpub_default ADD TABLE testpub_temptbl;
+ALTER PUBLICATION testpub_default ADD TABLE pg_publication;
+
+ALTER PUBLICATION testpub_default ADD TABLE testpub_tbl1, testpub_tbl2;
+ALTER PUBLICATION testpub_default ADD TABLE testpub_tbl1;
+ALTER PUBLICATION testpub_default DROP TABLE testpub_tbl1;
+ALTER PUBLICATION testpub_default DROP TABLE testpub_tbl1;
+ALTER PUBLICATION testpub_fortbl SET TABLE testpub_tbl2;
+
+-- tables of a FOR ALL TABLES publication can't be changed
+ALTER PUBLICATION testpub_foralltables ADD TABLE testpub_tbl1;
+
+SELECT p.pubname, c.relname
+  FROM pg_publication_rel pr
+  JOIN pg_publication p ON p.oid = pr.prpubid
+  JOIN pg_class c ON c.oid = pr.prrelid
+  ORDER BY 1, 2;
+
+-- dropping a table removes it from its publications
+DROP TABLE testpub_tbl2;
+SELECT count(*) FROM pg_publication_rel;
+
+ALTER PUBLICATION testpub_default OWNER TO regress_publication_user;
+
+DROP PUBLICATION testpub_nonexistent;
+DROP PUBLICATION IF EXISTS testpub_nonexistent;
+DROP PUBLICATION testpub_default, testpub_foralltables, testpub_fortbl;
+
+DROP VIEW testpub_view;
+DROP TABLE testpub_tbl1;
+
+RESET SESSION AUTHORIZATION;
+DROP ROLE regress_publication_user;
@@ -87,3 +87,14 @@ select 'a' ~ '()+\1';
 select 'xyz' ~ 'x(\w)(?=\1)';  -- no backrefs in LACONs
 select 'xyz' ~ 'x(\w)(?=(\1))';
 select 'a' ~ '\x7fffffff';  -- invalid chr code
+
+-- Test the required-literal check done before running the regex engine
+select s, s ~ '^abc' as prefix, s ~ 'bcd' as literal, s ~* 'BCD' as icase
+from (values ('abcd'), ('xabcd'), ('ab')) v(s);
+select E'x\nbcd' ~ '(?n)^bcd';
+select 'xbcd' ~ '***=bcd';
+
+-- Test eviction from a small regex cache
+set regex_cache_size = 1;
+select 'abc' ~ 'b', 'abc' ~ 'x', 'abc' ~ 'b';
+reset regex_cache_size;
@@ -148,5 +148,22 @@ SELECT st.heap_blks_read + st.heap_blks_hit >= pr.heap_blks + cl.relpages,
 SELECT pr.snap_ts < pg_stat_get_snapshot_timestamp() as snapshot_newer
 FROM prevstats AS pr;
 
+-- one row per WAL insertion lock
+SELECT count(*) = current_setting('wal_insert_locks')::int AS all_locks,
+       sum(acquired) > 0 AS used, bool_and(contended <= acquired) AS sane
+  FROM pg_stat_get_wal_insert_locks();
+
+-- every group flush serves at least one request
+SELECT requests >= flushes AS sane, wait_time >= 0 AS wait_time_ok
+  FROM pg_stat_get_wal_flush_groups();
+
+SELECT foreground >= 0 AND background >= 0 AS sane
+  FROM pg_stat_get_wal_segment_creations();
+
+-- no recovery is in progress
+SELECT prefetch >= 0 AND hit >= 0 AND skip_new >= 0 AND skip_fpw >= 0 AND
+       skip_rep >= 0 AS sane, distance
+  FROM pg_stat_get_recovery_prefetch();
+
 DROP TABLE trunc_stats_test, trunc_stats_test1, trunc_stats_test2, trunc_stats_test3, trunc_stats_test4;
 -- End of Stats Test
@@ -0,0 +1,110 @@
+-- Generic extended statistics support
+
+-- We will be checking execution plans without/with statistics, so
+-- let's make sure we get simple non-parallel plans.  The row estimates
+-- are what matter here, so use a helper that extracts the estimated and
+-- actual row counts from the top plan node.
+create function check_estimated_rows(text) returns table (estimated int, actual int)
+language plpgsql as
+$$
+declare
+    ln text;
+    tmp text[];
+    first_row bool := true;
+begin
+    for ln in
+        execute format('explain analyze %s', $1)
+    loop
+        if first_row then
+            first_row := false;
+            select regexp_matches(ln, 'rows=(\d*) .* rows=(\d*)') into tmp;
+            return query select tmp[1]::int, tmp[2]::int;
+        end if;
+    end loop;
+end;
+$$;
+
+-- Verify failures
+CREATE TABLE ext_stats_test (x int, y int, z int);
+CREATE STATISTICS tst ON a, b FROM nonexistent;
+CREATE STATISTICS tst ON a, b FROM ext_stats_test;
+CREATE STATISTICS tst ON x, x, y FROM ext_stats_test;
+CREATE STATISTICS tst ON x FROM ext_stats_test;
+CREATE STATISTICS tst ON xmin, y FROM ext_stats_test;
+CREATE STATISTICS tst (unrecognized) ON x, y FROM ext_stats_test;
+DROP STATISTICS tst;
+DROP STATISTICS IF EXISTS tst;
+
+-- Ensure stats are dropped sanely, and test IF NOT EXISTS while at it
+CREATE STATISTICS IF NOT EXISTS ab1_a_b_stats ON x, y FROM ext_stats_test;
+CREATE STATISTICS IF NOT EXISTS ab1_a_b_stats ON x, y FROM ext_stats_test;
+CREATE STATISTICS ab1_a_b_stats ON x, y FROM ext_stats_test;
+SELECT stxname, stxkeys, stxkind
+  FROM pg_statistic_ext WHERE stxrelid = 'ext_stats_test'::regclass;
+DROP STATISTICS ab1_a_b_stats;
+
+-- Dropping a column drops the statistics objects on it
+CREATE STATISTICS ab1_x_y_stats (ndistinct) ON x, y FROM ext_stats_test;
+CREATE STATISTICS ab1_y_z_stats (mcv) ON y, z FROM ext_stats_test;
+ALTER TABLE ext_stats_test DROP COLUMN x;
+SELECT stxname FROM pg_statistic_ext WHERE stxrelid = 'ext_stats_test'::regclass;
+-- and so does dropping the table
+DROP TABLE ext_stats_test;
+SELECT count(*) FROM pg_statistic_ext WHERE stxname = 'ab1_y_z_stats';
+
+-- Data for the estimation tests: a and b are perfectly correlated
+CREATE TABLE ab1 (a int, b int, c text);
+INSERT INTO ab1 SELECT mod(i, 100), mod(i, 100), 'x' || mod(i, 7)
+  FROM generate_series(1, 5000) s(i);
+ANALYZE ab1;
+
+-- without extended statistics the conditions are assumed independent
+SELECT * FROM check_estimated_rows('SELECT * FROM ab1 WHERE a = 1 AND b = 1');
+SELECT * FROM check_estimated_rows('SELECT a, b FROM ab1 GROUP BY a, b');
+
+-- functional dependencies alone fix the WHERE estimate
+CREATE STATISTICS ab1_deps (dependencies) ON a, b FROM ab1;
+ANALYZE ab1;
+SELECT stxndistinct IS NULL AS no_ndistinct,
+       stxdependencies IS NOT NULL AS has_dependencies,
+       stxmcv IS NULL AS no_mcv
+  FROM pg_statistic_ext WHERE stxname = 'ab1_deps';
+SELECT * FROM check_estimated_rows('SELECT * FROM ab1 WHERE a = 1 AND b = 1');
+SELECT * FROM check_estimated_rows('SELECT a, b FROM ab1 GROUP BY a, b');
+DROP STATISTICS ab1_deps;
+
+-- ndistinct fixes the GROUP BY estimate
+CREATE STATISTICS ab1_nd (ndistinct) ON a, b FROM ab1;
+ANALYZE ab1;
+SELECT * FROM check_estimated_rows('SELECT a, b FROM ab1 GROUP BY a, b');
+DROP STATISTICS ab1_nd;
+
+-- MCV lists fix the WHERE estimate, also for inequalities
+CREATE STATISTICS ab1_mcv (mcv) ON a, b FROM ab1;
+ANALYZE ab1;
+SELECT * FROM check_estimated_rows('SELECT * FROM ab1 WHERE a = 1 AND b = 1');
+SELECT * FROM check_estimated_rows('SELECT * FROM ab1 WHERE a < 5 AND b < 5');
+DROP STATISTICS ab1_mcv;
+
+-- a statistics object with all kinds, surviving ALTER COLUMN TYPE
+CREATE STATISTICS ab1_all ON a, b FROM ab1;
+ANALYZE ab1;
+SELECT * FROM check_estimated_rows('SELECT * FROM ab1 WHERE a = 1 AND b = 1');
+SELECT * FROM check_estimated_rows('SELECT a, b FROM ab1 GROUP BY a, b');
+ALTER TABLE ab1 ALTER COLUMN a TYPE bigint;
+SELECT stxndistinct IS NULL AND stxdependencies IS NULL AND stxmcv IS NULL
+    AS reset
+  FROM pg_statistic_ext WHERE stxname = 'ab1_all';
+ANALYZE ab1;
+SELECT * FROM check_estimated_rows('SELECT * FROM ab1 WHERE a = 1 AND b = 1');
+
+-- ALTER STATISTICS
+CREATE SCHEMA stats_ext_schema;
+ALTER STATISTICS ab1_all RENAME TO ab1_renamed;
+ALTER STATISTICS ab1_renamed SET SCHEMA stats_ext_schema;
+SELECT stxname, stxnamespace::regnamespace
+  FROM pg_statistic_ext WHERE stxrelid = 'ab1'::regclass;
+DROP SCHEMA stats_ext_schema CASCADE;
+
+DROP TABLE ab1;
+DROP FUNCTION check_estimated_rows(text);
@@ -319,6 +319,26 @@ SELECT 'foo' LIKE '%__' as t, 'foo' LIKE '%___' as t, 'foo' LIKE '%____' as f;
 
 SELECT 'jack' LIKE '%____%' AS t;
 
+--
+-- test patterns that are just a literal with % at either end, which are
+-- matched without the general matcher; some text is long enough for the
+-- vectorized substring search, and the last query varies the pattern
+--
+
+SELECT 'hawkeye' LIKE 'hawkeye' AS t, 'hawkeye' LIKE 'hawk' AS f,
+       'hawkeye' LIKE '%eye' AS t, 'hawkeye' LIKE '%hawk' AS f;
+SELECT 'the quick brown fox jumps over the lazy dog' LIKE '%lazy%' AS t,
+       'the quick brown fox jumps over the lazy dog' LIKE '%lazy cat%' AS f,
+       'the quick brown fox jumps over the lazy dog' LIKE '%%dog%%' AS t,
+       '' LIKE '%%' AS t;
+SELECT 'the quick brown fox jumps over the lazy dog' ILIKE '%LAZY%' AS t,
+       'the quick brown fox jumps over the lazy dog' ILIKE 'The Quick%' AS t,
+       'the quick brown fox jumps over the lazy dog' ILIKE '%Lazy Cat%' AS f;
+SELECT 'a%b_c' LIKE '%\%b\_%' AS t, 'a%bxc' LIKE '%\%b\_%' AS f;
+SELECT v, p, v LIKE p AS "like", v ILIKE p AS "ilike"
+FROM (VALUES ('abc', 'a%'), ('abc', '%C'), ('abc', '%x%'), ('abc', 'abc'))
+     AS x(v, p);
+
 
 --
 -- test implicit type conversion
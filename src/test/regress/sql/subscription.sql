@@ -0,0 +1,47 @@
+--
+-- SUBSCRIPTION
+--
+CREATE ROLE regress_subscription_user LOGIN SUPERUSER;
+SET SESSION AUTHORIZATION 'regress_subscription_user';
+
+-- subscriptions are created disabled so that no worker tries to connect
+CREATE SUBSCRIPTION testsub CONNECTION 'dbname=doesnotexist' PUBLICATION testpub WITH (enabled = false);
+
+CREATE SUBSCRIPTION testsub CONNECTION 'dbname=doesnotexist' PUBLICATION testpub WITH (enabled = false);
+
+CREATE SUBSCRIPTION testsub2 CONNECTION 'dbname=doesnotexist' PUBLICATION testpub, testpub WITH (enabled = false);
+
+CREATE SUBSCRIPTION testsub2 CONNECTION 'dbname=doesnotexist' PUBLICATION testpub WITH (enabled = false, nonsense = true);
+
+CREATE SUBSCRIPTION testsub2 CONNECTION 'dbname=doesnotexist' PUBLICATION testpub WITH (enabled = false, enabled = false);
+
+SELECT subname, subenabled, substream, subbinary, subslotname, subpublications
+  FROM pg_subscription ORDER BY subname;
+
+ALTER SUBSCRIPTION testsub SET PUBLICATION testpub2, testpub3;
+ALTER SUBSCRIPTION testsub CONNECTION 'dbname=doesnotexist2';
+ALTER SUBSCRIPTION testsub SET (slot_name = 'newname', streaming = on, binary = on);
+
+SELECT subname, subenabled, substream, subbinary, subslotname, subpublications,
+       subconninfo
+  FROM pg_subscription ORDER BY subname;
+
+ALTER SUBSCRIPTION doesnotexist SET PUBLICATION testpub;
+
+-- the connection string is hidden from ordinary users
+CREATE ROLE regress_subscription_user2;
+SET ROLE regress_subscription_user2;
+SELECT subconninfo FROM pg_subscription;
+SELECT subname FROM pg_subscription;
+RESET ROLE;
+
+-- the owner of a subscription must be a superuser
+ALTER SUBSCRIPTION testsub OWNER TO regress_subscription_user2;
+
+DROP SUBSCRIPTION testsub;
+DROP SUBSCRIPTION testsub;
+DROP SUBSCRIPTION IF EXISTS testsub;
+
+RESET SESSION AUTHORIZATION;
+DROP ROLE regress_subscription_user;
+DROP ROLE regress_subscription_user2;
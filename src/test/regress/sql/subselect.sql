@@ -481,3 +481,37 @@ select * from
   order by 1;
 
 select nextval('ts1');
+
+--
+-- Tests for CTE inlining behavior
+--
+
+-- Basic subquery that can be inlined
+explain (verbose, costs off)
+with x as (select * from (select f1 from subselect_tbl) ss)
+select * from x where f1 = 1;
+
+-- Explicitly request materialization
+explain (verbose, costs off)
+with x as materialized (select * from (select f1 from subselect_tbl) ss)
+select * from x where f1 = 1;
+
+-- Stable functions are safe to inline
+explain (verbose, costs off)
+with x as (select * from (select f1, now() from subselect_tbl) ss)
+select * from x where f1 = 1;
+
+-- Volatile functions prevent inlining
+explain (verbose, costs off)
+with x as (select * from (select f1, random() from subselect_tbl) ss)
+select * from x where f1 = 1;
+
+-- Multiply-referenced CTEs are inlined only when requested
+with x as not materialized (select f1, f2 from subselect_tbl)
+select x.f1, x2.f2 from x, x x2 where x.f1 = x2.f2 and x.f1 = 1;
+
+-- References from sublinks are inlined too
+with x as (select f1 from subselect_tbl where f2 > 2)
+select f1 from subselect_tbl s
+  where exists (select 1 from x where x.f1 = s.f1 + 1)
+  order by 1;
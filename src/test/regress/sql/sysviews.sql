@@ -0,0 +1,20 @@
+--
+-- Test assorted system views
+--
+
+-- There will surely be at least one memory context below the top one.
+select name, parent, level, total_bytes >= free_bytes as ok,
+       peak_bytes >= total_bytes as peak_ok
+  from pg_backend_memory_contexts where level = 0;
+select count(*) > 1 as ok from pg_backend_memory_contexts where level = 1;
+select count(*) = 0 as ok from pg_backend_memory_contexts
+  where used_bytes <> total_bytes - free_bytes;
+
+-- one row per syscache plus one for the relcache
+select count(*) > 1 as ok from pg_catalog_cache_stats;
+select count(*) = 0 as ok from pg_catalog_cache_stats
+  where hits + misses <> searches;
+-- Any backend's contexts can be fetched by PID; ours are read directly.
+select count(*) > 1 as ok from pg_get_process_memory_contexts(pg_backend_pid())
+  where level = 1;
+select count(*) from pg_get_process_memory_contexts(0);
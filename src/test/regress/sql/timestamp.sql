@@ -225,3 +225,8 @@ SELECT '' AS to_char_11, to_char(d1, 'FMIYYY FMIYY FMIY FMI FMIW FMIDDD FMID')
 
 -- timestamp numeric fields constructor
 SELECT make_timestamp(2014,12,28,6,30,45.887);
+
+-- plain ISO 8601 input is parsed by a fast path; check it agrees with
+-- the general parser, including on values it leaves to the latter
+SELECT x::timestamp FROM (VALUES ('2016-02-29 23:59:59.999999'), ('2016-07-01T12:00:00+05'), ('2016-07-01 12:00'), ('2016-07-01 24:00:00'), ('2016-07-01 12:00:00.1234567')) AS t(x);
+SELECT '2015-02-29 00:00:00'::timestamp;
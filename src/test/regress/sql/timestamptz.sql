@@ -449,3 +449,8 @@ SELECT '2007-12-09 07:00:00 UTC'::timestamptz AT TIME ZONE 'VET';
 SELECT '2007-12-09 07:00:01 UTC'::timestamptz AT TIME ZONE 'VET';
 SELECT '2007-12-09 07:29:59 UTC'::timestamptz AT TIME ZONE 'VET';
 SELECT '2007-12-09 07:30:00 UTC'::timestamptz AT TIME ZONE 'VET';
+
+-- plain ISO 8601 input is parsed by a fast path; check it agrees with
+-- the general parser, including on values it leaves to the latter
+SELECT x::timestamptz FROM (VALUES ('2016-02-29 23:59:59.999999+05:30'), ('2016-07-01T12:00:00-0300'), ('2016-07-01 12:00'), ('2016-07-01 24:00:00'), ('2016-07-01 12:00:00.1234567+00')) AS t(x);
+SELECT '2016-07-01 12:00:00+16'::timestamptz;
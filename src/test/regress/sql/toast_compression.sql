@@ -0,0 +1,58 @@
+--
+-- TOAST compression methods
+--
+CREATE TABLE cmdata(f1 text COMPRESSION pglz);
+INSERT INTO cmdata VALUES (repeat('1234567890', 1000));
+INSERT INTO cmdata VALUES ('short');
+SELECT pg_column_compression(f1), length(f1) FROM cmdata ORDER BY 2;
+
+-- only toastable types can be compressed, and only with known methods
+CREATE TABLE cmbad(f1 int COMPRESSION pglz);
+CREATE TABLE cmbad(f1 text COMPRESSION I_Do_Not_Exist_Compression);
+ALTER TABLE cmdata ADD COLUMN f2 int COMPRESSION pglz;
+ALTER TABLE cmdata ALTER COLUMN f1 SET COMPRESSION I_Do_Not_Exist_Compression;
+
+-- columns without a method follow default_toast_compression
+ALTER TABLE cmdata ALTER COLUMN f1 SET COMPRESSION default;
+ALTER TABLE cmdata ADD COLUMN f2 text;
+SELECT attname, attcompression = '' AS uses_default FROM pg_attribute
+  WHERE attrelid = 'cmdata'::regclass AND attnum > 0 ORDER BY attnum;
+SET default_toast_compression = 'I do not exist compression';
+SET default_toast_compression = 'pglz';
+INSERT INTO cmdata VALUES (repeat('0987654321', 1000), repeat('x', 10000));
+SELECT pg_column_compression(f1), pg_column_compression(f2) FROM cmdata
+  WHERE f2 IS NOT NULL;
+RESET default_toast_compression;
+
+-- children inherit the method, and must not conflict with it
+ALTER TABLE cmdata ALTER COLUMN f1 SET COMPRESSION pglz;
+CREATE TABLE cminh() INHERITS (cmdata);
+SELECT attcompression FROM pg_attribute
+  WHERE attrelid = 'cminh'::regclass AND attname = 'f1';
+CREATE TABLE cmbad(f1 text COMPRESSION default) INHERITS (cmdata);
+DROP TABLE cminh;
+
+-- a non-toastable type loses the method
+CREATE TABLE cmtype(f1 varchar COMPRESSION pglz);
+ALTER TABLE cmtype ALTER COLUMN f1 TYPE int USING 0;
+SELECT attcompression = '' AS uses_default FROM pg_attribute
+  WHERE attrelid = 'cmtype'::regclass AND attname = 'f1';
+DROP TABLE cmtype;
+
+-- values copied from another table keep their method
+CREATE TABLE cmcopy(f1 text COMPRESSION pglz);
+INSERT INTO cmcopy SELECT f1 FROM cmdata;
+SELECT pg_column_compression(f1), length(f1) FROM cmcopy ORDER BY 2;
+DROP TABLE cmcopy;
+
+-- lz4, if the server was built with it
+CREATE TABLE cmdata1(f1 text COMPRESSION lz4);
+INSERT INTO cmdata1 VALUES (repeat('1234567890', 1004));
+SELECT pg_column_compression(f1), length(f1) FROM cmdata1;
+SET default_toast_compression = 'lz4';
+INSERT INTO cmdata (f2) VALUES (repeat('1234567890', 1004));
+SELECT pg_column_compression(f2) FROM cmdata WHERE length(f2) = 10040;
+RESET default_toast_compression;
+DROP TABLE cmdata1;
+
+DROP TABLE cmdata;
@@ -75,5 +75,13 @@ INSERT INTO guid2(guid_field) VALUES('3f3e3c3b3a3039383736353433a2313e');
 SELECT COUNT(*) FROM guid1 g1 INNER JOIN guid2 g2 ON g1.guid_field = g2.guid_field;
 SELECT COUNT(*) FROM guid1 g1 LEFT JOIN guid2 g2 ON g1.guid_field = g2.guid_field WHERE g2.guid_field IS NULL;
 
+-- sorts with abbreviated keys must agree with the comparison operators
+CREATE TEMP TABLE uuid_sort AS
+  SELECT md5((i % 5000)::text)::uuid AS u FROM generate_series(1, 20000) i;
+SELECT count(*) FROM
+  (SELECT u, lag(u) OVER (ORDER BY u) AS prev FROM uuid_sort) s
+  WHERE prev > u;
+DROP TABLE uuid_sort;
+
 -- clean up
 DROP TABLE guid1, guid2 CASCADE;
@@ -42,6 +42,18 @@ SELECT * FROM vactst;
 VACUUM (FULL, FREEZE) vactst;
 VACUUM (ANALYZE, FULL) vactst;
 
+CREATE TABLE vacparallel (i INT, t TEXT);
+CREATE INDEX ON vacparallel (i);
+CREATE INDEX ON vacparallel (t);
+INSERT INTO vacparallel SELECT g, 'row ' || g FROM generate_series(1, 1000) g;
+DELETE FROM vacparallel WHERE i % 2 = 0;
+VACUUM (PARALLEL 2) vacparallel;
+VACUUM (PARALLEL 0, ANALYZE) vacparallel;
+SELECT count(*) FROM vacparallel WHERE i < 100;
+VACUUM (PARALLEL -1) vacparallel;
+VACUUM (FULL, PARALLEL 2) vacparallel;
+DROP TABLE vacparallel;
+
 CREATE TABLE vaccluster (i INT PRIMARY KEY);
 ALTER TABLE vaccluster CLUSTER ON vaccluster_pkey;
 CLUSTER vaccluster;
@@ -62,3 +74,14 @@ VACUUM FULL vactst;
 
 DROP TABLE vaccluster;
 DROP TABLE vactst;
+
+-- sample the children of an inheritance tree in parallel
+CREATE TABLE vacparent (i INT);
+CREATE TABLE vacchild1 () INHERITS (vacparent);
+CREATE TABLE vacchild2 () INHERITS (vacparent);
+INSERT INTO vacchild1 SELECT generate_series(1, 100);
+INSERT INTO vacchild2 SELECT generate_series(101, 200);
+VACUUM (ANALYZE, PARALLEL 2) vacparent;
+SELECT attname, null_frac, n_distinct FROM pg_stats
+	WHERE tablename = 'vacparent' AND inherited;
+DROP TABLE vacchild1, vacchild2, vacparent;
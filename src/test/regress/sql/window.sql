@@ -641,3 +641,35 @@ SELECT to_char(SUM(n::float8) OVER (ORDER BY i ROWS BETWEEN CURRENT ROW AND 1 FO
 SELECT i, b, bool_and(b) OVER w, bool_or(b) OVER w
   FROM (VALUES (1,true), (2,true), (3,false), (4,false), (5,true)) v(i,b)
   WINDOW w AS (ORDER BY i ROWS BETWEEN CURRENT ROW AND 1 FOLLOWING);
+
+-- aggregates with a combine function but no inverse transition function
+-- are evaluated as sliding aggregates
+SELECT i, v, min(v) OVER w, max(v) OVER w
+  FROM (VALUES (1,3),(2,NULL),(3,1),(4,5),(5,NULL),(6,NULL),(7,2),(8,4)) t(i,v)
+  WINDOW w AS (ORDER BY i ROWS BETWEEN 2 PRECEDING AND CURRENT ROW);
+
+SELECT i, v, min(v) OVER w, max(v) OVER w
+  FROM (VALUES (1,'d'),(2,'b'),(3,NULL),(4,'a'),(5,'e'),(6,'c')) t(i,v)
+  WINDOW w AS (ORDER BY i ROWS BETWEEN 1 PRECEDING AND 1 FOLLOWING);
+
+SELECT i, avg(i::float8) OVER (ORDER BY i ROWS BETWEEN 2 PRECEDING AND CURRENT ROW)
+  FROM generate_series(1, 6) i;
+
+-- compare against aggregating each frame separately
+SELECT count(*)
+  FROM (SELECT i,
+               max(v) OVER w AS mx,
+               min(v) FILTER (WHERE v % 2 = 0) OVER w AS mn,
+               sum(v::float8) OVER w AS s,
+               max(v) OVER (ORDER BY i / 10 RANGE BETWEEN CURRENT ROW AND UNBOUNDED FOLLOWING) AS mr
+          FROM (SELECT i, (i * 37) % 101 AS v FROM generate_series(1, 500) i) t
+        WINDOW w AS (ORDER BY i ROWS BETWEEN 7 PRECEDING AND 3 FOLLOWING)) w,
+       LATERAL (SELECT max((j * 37) % 101) AS mx,
+                       min((j * 37) % 101) FILTER (WHERE (j * 37) % 101 % 2 = 0) AS mn,
+                       sum(((j * 37) % 101)::float8) AS s
+                  FROM generate_series(greatest(i - 7, 1), least(i + 3, 500)) j) b,
+       LATERAL (SELECT max((j * 37) % 101) AS mr
+                  FROM generate_series(1, 500) j
+                 WHERE j / 10 >= i / 10) r
+ WHERE w.mx IS DISTINCT FROM b.mx OR w.mn IS DISTINCT FROM b.mn OR
+       w.s IS DISTINCT FROM b.s OR w.mr IS DISTINCT FROM r.mr;
@@ -93,11 +93,13 @@ sub configure_test_server_for_ssl
 }
 
 # Change the configuration to use given server cert file, and restart
-# the server so that the configuration takes effect.
+# the server so that the configuration takes effect.  Any further settings
+# can be given as an optional third argument.
 sub switch_server_cert
 {
 	my $tempdir  = $_[0];
 	my $certfile = $_[1];
+	my $extra    = $_[2];
 
 	diag "Restarting server with certfile \"$certfile\"...";
 
@@ -107,6 +109,7 @@ sub switch_server_cert
 	print SSLCONF "ssl_cert_file='$certfile.crt'\n";
 	print SSLCONF "ssl_key_file='$certfile.key'\n";
 	print SSLCONF "ssl_crl_file='root+client.crl'\n";
+	print SSLCONF "$extra\n" if defined $extra;
 	close SSLCONF;
 
    # Stop and restart server to reload the new config. We cannot use
@@ -1,7 +1,7 @@
 use strict;
 use warnings;
 use TestLib;
-use Test::More tests => 38;
+use Test::More tests => 42;
 use ServerSetup;
 use File::Copy;
 
@@ -242,6 +242,34 @@ test_connect_fails(
 "user=ssltestuser sslcert=ssl/client-revoked.crt sslkey=ssl/client-revoked.key"
 );
 
+### Part 3. Kernel TLS.
+###
+### With ssl_ktls on, the server hands encryption of what it sends to the
+### kernel where it can.  Either way, the client must get everything the
+### server sends, alerts included.
+
+diag "Testing kernel TLS...";
+switch_server_cert($tempdir, 'server-cn-only', 'ssl_ktls=on');
+$common_connstr =
+"user=ssltestuser dbname=trustdb sslcert=invalid sslrootcert=ssl/root+server_ca.crt hostaddr=$SERVERHOSTADDR host=common-name.pg-ssltest.test";
+
+test_connect_ok("sslmode=verify-full");
+
+my ($stdout, $stderr);
+run [ 'psql', '-X', '-A', '-t', '-d', "$common_connstr sslmode=require",
+	'-c', "SELECT repeat('x', 1000000)" ], '>', \$stdout, '2>', \$stderr;
+is(length($stdout), 1000001, 'large result is sent with ssl_ktls');
+
+run [ 'psql', '-X', '-d', "$common_connstr sslmode=require",
+	'-c', 'SELECT 1/0' ], '>', \$stdout, '2>', \$stderr;
+like($stderr, qr/division by zero/, 'error is sent with ssl_ktls');
+
+# A terminated backend sends its FATAL error, then a close_notify alert on
+# the way out
+run [ 'psql', '-X', '-d', "$common_connstr sslmode=require",
+	'-c', 'SELECT pg_terminate_backend(pg_backend_pid())' ],
+  '>', \$stdout, '2>', \$stderr;
+like($stderr, qr/terminating connection/, 'termination is sent with ssl_ktls');
 
 # All done! Save the log, before the temporary installation is deleted
 copy("$tempdir/client-log", "./client-log");